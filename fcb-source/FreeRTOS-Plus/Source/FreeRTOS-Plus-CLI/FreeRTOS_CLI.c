@@ -41,6 +41,7 @@
  */
 
 /* Standard includes. */
+#include <stdio.h>
 #include <string.h>
 #include <stdint.h>
 
@@ -41,7 +41,13 @@
 
 #include "FreeRTOS.h"	// Defines configUSE_TRACE_FACILITY
 
+/* Dragonfly modification: the recorder is compiled in with FCB_TRACE_RECORDER only, see FreeRTOSConfig.h.
+   configUSE_TRACE_FACILITY alone keeps the kernel trace fields the task status uses. */
+#ifdef FCB_TRACE_RECORDER
 #define USE_TRACEALYZER_RECORDER configUSE_TRACE_FACILITY
+#else
+#define USE_TRACEALYZER_RECORDER 0
+#endif
 
 #if (USE_TRACEALYZER_RECORDER == 1)
 
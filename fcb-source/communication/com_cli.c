@@ -30,20 +30,88 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "com_cli.h"
+#include "com_session.h"
 
 #include "main.h"
 #include "dragonfly_fcb.pb.h"
 #include "receiver.h"
 #include "motor_control.h"
+#include "motor_mixer.h"
+#include "latency_monitor.h"
+#include "wake_latency.h"
+#include "ccm_ram.h"
+#include "deferred_work.h"
+#include "rate_groups.h"
+#include "mem_pool.h"
+#include "boot_timing.h"
+#include "control_executive.h"
+#include "fcb_sensor_load_test.h"
+#include "wcet_test.h"
+#include "deadline_monitor.h"
+#include "buffer_monitor.h"
+#include "crash_dump.h"
+#include "scope_probe.h"
+#include "isr_monitor.h"
+#include "profiler.h"
+#include "task_status.h"
+#include "deferred_log.h"
+#include "trace_recorder.h"
+#include "pid_control.h"
+#include "fms_link.h"
 #include "flight_control.h"
-#include "fifo_buffer.h"
+#include "ring_buffer.h"
 #include "common.h"
 #include "fcb_gyroscope.h"
+#include "fcb_barometer.h"
+#include "bmp180.h"
 #include "fcb_accelerometer_magnetometer.h"
 #include "fcb_sensors.h"
+#include "fcb_sensor_watchdog.h"
+#include "fcb_sensor_timing.h"
+#include "fcb_vibration_monitor.h"
+#include "fcb_gps.h"
+#include "fcb_battery.h"
+#include "fcb_rpm_filter.h"
+#include "fcb_dynamic_notch.h"
+#include "stick_curves.h"
+#include "rc_smoothing.h"
+#include "thrust_curve.h"
+#include "motor_test.h"
+#include "crash_detection.h"
+#include "motor_failure.h"
+#include "param_profile.h"
+#include "firmware_update.h"
+#include "task_watchdog.h"
+#include "fcb_sensor_self_test.h"
+#include "led_status.h"
+#include "fcb_sensor_orientation.h"
+#include "fcb_gyro_redundancy.h"
+#include "flight_mode.h"
+#include "esc_telemetry.h"
+#include "pid_autotune.h"
+#include "system_identification.h"
+#include "dronecan.h"
+#include "position_estimation.h"
 #include "state_estimation.h"
 #include "fcb_error.h"
+#include "fast_math.h"
+#include "matrix3.h"
+#include "fixed_format.h"
+#include "proto_frame.h"
+#include "usbd_cdc_if.h"
+#include "usbd_log_if.h"
+#include "telemetry.h"
+#include "telemetry_aggregate.h"
+#include "compact_codec.h"
+#include "uart.h"
+#include "param_table.h"
+#include "blackbox.h"
+#include "blackbox_sd.h"
 #include "pb_encode.h"
+#include "time_sync.h"
+#include "event_journal.h"
+#include "prearm_checks.h"
+#include "perf_snapshot.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -54,6 +122,52 @@
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
 #define MAX_DATA_TRANSFER_DELAY         2000 // [ms]
+#define FAST_MATH_BENCHMARK_MAX_STRING_SIZE 512
+#define CONTROL_LATENCY_MAX_STRING_SIZE     768
+#define CCM_RAM_MAX_STRING_SIZE             (128 + CCM_RAM_MAX_OBJECTS*52)
+#define WAKE_LATENCY_MAX_STRING_SIZE        (256 + WAKE_LATENCY_HISTOGRAM_BINS*(8 + WAKE_LATENCY_NBR*14 + 1))
+#define DEFERRED_WORK_MAX_STRING_SIZE       (160 + DEFERRED_WORK_MAX_ITEMS*72)
+#define RATE_GROUP_MAX_STRING_SIZE          (160 + RATE_GROUP_MAX_JOBS*80)
+#define BOOT_TIMING_MAX_STRING_SIZE         (96 + BOOT_PHASE_NBR*40)
+#define CONTROL_EXECUTIVE_MAX_STRING_SIZE   256
+#define SENSOR_LOAD_TEST_MAX_STRING_SIZE    (256 + SENSOR_LOAD_TEST_SENSORS*112)
+#define WCET_TEST_MAX_STRING_SIZE           1024
+#define DEADLINE_STATS_MAX_STRING_SIZE      512
+#define BUFFER_STATUS_MAX_STRING_SIZE       (80 + BUFFER_MONITOR_MAX_BUFFERS*60)
+#define SENSOR_RATES_MAX_STRING_SIZE        (160 + FCB_SENSOR_NBR*112) // The largest table, the data rates
+#define VIBRATION_MAX_STRING_SIZE           (224 + 2*112) // Gyroscope and accelerometer rows
+#define GPS_MAX_STRING_SIZE                 640 // Receiver and position estimate
+#define SENSOR_NOISE_MAX_STRING_SIZE        768 // Statistics of all sensors and the derived Kalman noise
+#define BAROMETER_STATS_MAX_STRING_SIZE     384
+#define CRASH_DUMP_MAX_STRING_SIZE          576 // Without the log entries
+#define SCOPE_PROBE_MAX_STRING_SIZE         (64 + SCOPE_PROBE_STAGE_NBR*32)
+#define ISR_STATS_MAX_STRING_SIZE           (160 + ISR_MONITOR_NBR*64)
+#define PROFILE_MAX_STRING_SIZE             1024
+#define PID_GAINS_MAX_STRING_SIZE           768
+#define PID_SCHEDULE_MAX_STRING_SIZE        (128 + 2*PID_SCHEDULE_BREAKPOINTS*16)
+#define AUTOTUNE_MAX_STRING_SIZE            320
+#define STICK_CURVES_MAX_STRING_SIZE        (64 + STICK_AXIS_NBR*48)
+#define THRUST_CURVES_MAX_STRING_SIZE       (160 + MOTOR_OUTPUT_CHANNELS*64)
+#define PREARM_CHECKS_MAX_STRING_SIZE       (96 + PREARM_CHECK_NBR*48)
+#define PERF_SNAPSHOT_MAX_STRING_SIZE       (160 + PERF_SNAPSHOT_FIELD_NBR*64)
+#define RECEIVER_LINK_MAX_STRING_SIZE       480 // And the RC smoothing
+#define RECEIVER_MAP_MAX_STRING_SIZE        (96 + RECEIVER_SNAPSHOT_CHANNELS_NBR*32 + RECEIVER_MODE_RANGES_NBR*48)
+#define GYRO_TEMP_COMP_MAX_STRING_SIZE      (96 + GYRO_TEMP_COMP_BINS*48)
+#define ACCMAG_TEMP_COMP_MAX_STRING_SIZE    (128 + ACCMAG_TEMP_COMP_SENSORS*(32 + ACCMAG_TEMP_COMP_POINTS*96))
+#define MOTOR_TELEMETRY_MAX_STRING_SIZE     640 // Telemetry and RPM filter notches
+#define DYNAMIC_NOTCH_MAX_STRING_SIZE       384
+#define ESC_TELEMETRY_MAX_STRING_SIZE       (128 + MOTOR_OUTPUT_CHANNELS*96)
+#define BLACKBOX_STATUS_MAX_STRING_SIZE     512 // Log and SD card status
+#define DRONECAN_STATUS_MAX_STRING_SIZE     (640 + DRONECAN_MAX_NODES*32 + MOTOR_OUTPUT_CHANNELS*96) // And bus stats
+
+#if PROTO_FRAME_MAX_SIZE(PROFILE_PROBE_MSG_MAX_SIZE) > MAX_CLI_OUTPUT_SIZE
+#error "The profiling probe message does not fit the CLI output buffer"
+#endif
+
+#if PROTO_FRAME_MAX_SIZE(CRASH_DUMP_MSG_MAX_SIZE) > MAX_CLI_OUTPUT_SIZE \
+        || PROTO_FRAME_MAX_SIZE(CRASH_DUMP_LOG_MSG_MAX_SIZE) > MAX_CLI_OUTPUT_SIZE
+#error "The crash dump messages do not fit the CLI output buffer"
+#endif
 
 /* Private function prototypes -----------------------------------------------*/
 
@@ -108,6 +222,19 @@ static portBASE_TYPE CLIStartReceiverSampling(int8_t *pcWriteBuffer, size_t xWri
 static portBASE_TYPE CLIStopReceiverSampling(int8_t *pcWriteBuffer, size_t xWriteBufferLen,
         const int8_t *pcCommandString);
 
+/*
+ * Function implements the "get-receiver-link-status" command.
+ */
+static portBASE_TYPE CLIGetReceiverLinkStatus(int8_t *pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t *pcCommandString);
+static portBASE_TYPE CLIGetReceiverMap(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetReceiverChannel(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString);
+static portBASE_TYPE CLISetReceiverModeRange(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString);
+static portBASE_TYPE CLISaveReceiverMap(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static uint8_t ParseReceiverChannelName(const int8_t* name, const portBASE_TYPE nameLength);
+
 /*
  * Function implements the "get-sensors" command.
  */
@@ -127,6 +254,28 @@ static portBASE_TYPE CLIStopSensorSampling(int8_t *pcWriteBuffer, size_t xWriteB
 
 /* Fcn implements "start-accmagmtr-calibration" CLI command. */
 static portBASE_TYPE CLIStartAccMagMtrCalibration(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString);
+static portBASE_TYPE CLIGetGyroTempCompensation(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetGyroTempCompensation(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetAccMagTempCompensation(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetAccMagTempCompensation(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetSensorRates(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIResetSensorRates(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetVibration(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIResetVibration(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#ifdef FCB_DYNAMIC_NOTCH
+static portBASE_TYPE CLIGetDynamicNotch(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIResetDynamicNotch(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
+#ifdef FCB_GPS
+static portBASE_TYPE CLIGetGps(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIResetGps(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
+#ifdef FCB_BATTERY_MONITOR
+static portBASE_TYPE CLIGetBattery(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
+static portBASE_TYPE CLIGetBarometer(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetBarometer(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetBaroReference(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
 
 /*
  * Function implements the "get-motors" command.
@@ -134,20 +283,187 @@ static portBASE_TYPE CLIStartAccMagMtrCalibration(int8_t *pcWriteBuffer, size_t
 static portBASE_TYPE CLIGetMotorValues(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString);
 static portBASE_TYPE CLIStartMotorSampling(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString);
 static portBASE_TYPE CLIStopMotorSampling(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString);
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+static portBASE_TYPE CLIGetMotorTelemetry(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
+#ifdef MOTOR_ESC_TELEMETRY
+static portBASE_TYPE CLIGetEscTelemetry(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
+#ifdef FCB_CAN_BUS
+static portBASE_TYPE CLIGetDroneCanStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
 static portBASE_TYPE CLIAbout(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString);
 static portBASE_TYPE CLISysTime(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetTimeSync(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
 static portBASE_TYPE CLIGetFlightMode(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetFlightModeLog(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetPreArm(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
 static portBASE_TYPE CLIGetRefSignals(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
 static portBASE_TYPE CLIGetCtrlSignals(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
 static portBASE_TYPE CLISetMaxReferenceSignals(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
 static portBASE_TYPE CLIGetMaxReferenceSignals(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
 static portBASE_TYPE CLITaskStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIFastMathBenchmark(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
 static portBASE_TYPE CLIGetStateValues(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString);
 static portBASE_TYPE CLIStartStateSampling(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
 static portBASE_TYPE CLIStopStateSampling(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISaveStateWarmStart(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIStartSensorNoise(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetSensorNoise(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISaveSensorNoise(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetMotorMixer(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetMixerAllocation(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString);
+static portBASE_TYPE CLISetMixerAllocation(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString);
+static portBASE_TYPE CLISaveMixerAllocation(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetControlLatency(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIResetControlLatency(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#ifdef FCB_WAKE_LATENCY
+static portBASE_TYPE CLIGetWakeLatency(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIResetWakeLatency(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
+static portBASE_TYPE CLIGetMemoryPlacement(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetDeferredWork(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIResetDeferredWork(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetRateGroups(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIResetRateGroups(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetBootTime(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#ifdef FCB_CONTROL_EXECUTIVE
+static portBASE_TYPE CLIGetControlExecutive(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIResetControlExecutive(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
+#ifdef FCB_SENSOR_LOAD_TEST
+static portBASE_TYPE CLIStartSensorLoadTest(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIStopSensorLoadTest(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetSensorLoadTest(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
+#ifdef FCB_WCET_TEST
+static portBASE_TYPE CLIStartWcetTest(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIStopWcetTest(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetWcetTest(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
+static portBASE_TYPE CLIGetDeadlineStats(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIResetDeadlineStats(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIBufferStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLICrashDump(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetEventJournal(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIClearEventJournal(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetScopeProbes(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetScopeProbe(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#ifdef FCB_ISR_MONITOR
+static portBASE_TYPE CLIGetIsrStats(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIResetIsrStats(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
+#ifdef FCB_PROFILING
+static portBASE_TYPE CLIProfile(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
+#ifdef FCB_PERF_SNAPSHOT
+static portBASE_TYPE CLIGetPerfSnapshot(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetPerfSnapshotPeriod(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString);
+static portBASE_TYPE CLIResetPerfSnapshot(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString);
+static portBASE_TYPE CLISavePerfBaseline(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
+static portBASE_TYPE CLIGetPIDGains(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetPIDGains(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISavePIDGains(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetPIDFeedForward(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString);
+#ifdef PID_USE_GAIN_SCHEDULING
+static portBASE_TYPE CLIGetPIDSchedule(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetPIDSchedule(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISavePIDSchedule(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
+#ifdef PID_AUTOTUNE
+static portBASE_TYPE CLIAutotune(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
+#ifdef FCB_SYSTEM_IDENTIFICATION
+static portBASE_TYPE CLISysIdStart(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISysIdStop(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISysIdStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
+static portBASE_TYPE CLIGetStickCurves(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetStickCurve(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISaveStickCurves(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetThrustCurves(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetThrustCurve(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISaveThrustCurves(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIThrustTest(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIThrustPoint(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIFitThrustCurve(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIMotorTestUnlock(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIMotorTestLock(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIMotorTest(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIMotorTestStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIEscCalibrate(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetEscOutputs(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetEscOutputs(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISaveEscOutputs(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#ifdef FCB_CRASH_DETECTION
+static portBASE_TYPE CLIGetCrashDetection(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString);
+static portBASE_TYPE CLISetCrashDetection(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString);
+static portBASE_TYPE CLISaveCrashDetection(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString);
+#endif
+#ifdef FCB_MOTOR_FAILURE_DETECTION
+static portBASE_TYPE CLIGetMotorFailure(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetMotorFailure(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISaveMotorFailure(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
+#ifdef FCB_USB_MASS_STORAGE
+static portBASE_TYPE CLIGetUSBMsc(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetUSBMsc(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
+static portBASE_TYPE CLIProfileSelect(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIProfileSave(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIProfileStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetGyroFilter(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetSensorTiming(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIRebootBootloader(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString);
+static portBASE_TYPE CLIFirmwareInfo(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIWatchdogStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIWatchdogClear(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISensorHealth(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLILedStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISensorOrientation(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#ifdef FCB_REDUNDANT_GYRO
+static portBASE_TYPE CLIGyroRedundancy(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
+static portBASE_TYPE CLISetUartBaudRate(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISaveUartSettings(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetFmsLinkStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetStabilizedMode(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIStartTelemetry(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIStopTelemetry(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetTelemetryWindow(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetTelemetryOutput(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetCompactPrecision(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetParams(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetParam(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISaveParams(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIGetBlackboxStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLIEraseBlackbox(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+static portBASE_TYPE CLISetLogSink(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#ifdef FCB_TRACE_RECORDER
+static portBASE_TYPE CLITrace(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString);
+#endif
 
 /* Private variables ---------------------------------------------------------*/
 
+/* Mixer allocation priority names of the CLI, indexed by MixerPriority_TypeDef */
+static const char* const mixerPriorityNames[MIXER_PRIORITY_NBR] = { "rollpitch", "attitude" };
+
+/* Receiver channel names of the CLI, indexed as the receiver snapshot channels */
+static const char* const receiverChannelNames[RECEIVER_SNAPSHOT_CHANNELS_NBR] = { "throttle", "aileron", "elevator",
+        "rudder", "gear", "aux1" };
+
 /* Structure that defines the "echo" command line command. */
 static const CLI_Command_Definition_t echoCommand = { (const int8_t * const ) "echo",
         (const int8_t * const ) "\r\necho <param>:\r\n Echoes one parameter\r\n", CLIEcho, /* The function to run. */
@@ -210,6 +526,41 @@ static const CLI_Command_Definition_t stopReceiverSamplingCommand = { (const int
         0 /* Number of parameters expected */
 };
 
+/* Structure that defines the "get-receiver-link-status" command line command. */
+static const CLI_Command_Definition_t getReceiverLinkStatusCommand = { (const int8_t * const ) "get-receiver-link-status",
+        (const int8_t * const ) "\r\nget-receiver-link-status:\r\n Prints the receiver failsafe state, the pulse rate and dropouts of each channel and the RC smoothing cutoff and latency\r\n",
+        CLIGetReceiverLinkStatus, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "get-receiver-map" command line command. */
+static const CLI_Command_Definition_t getReceiverMapCommand = { (const int8_t * const ) "get-receiver-map",
+        (const int8_t * const ) "\r\nget-receiver-map:\r\n Prints the input and reversal of each receiver channel, the mode ranges and the selected mode\r\n",
+        CLIGetReceiverMap, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-receiver-channel" command line command. */
+static const CLI_Command_Definition_t setReceiverChannelCommand = { (const int8_t * const ) "set-receiver-channel",
+        (const int8_t * const ) "\r\nset-receiver-channel <channel> <input> <reversed>:\r\n Maps a receiver channel (throttle, aileron, elevator, rudder, gear or aux1) to a PWM input [0, 5] or frame channel [0, 15], reversed 0 or 1 (idle mode only)\r\n",
+        CLISetReceiverChannel, /* The function to run. */
+        3 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-receiver-mode-range" command line command. */
+static const CLI_Command_Definition_t setReceiverModeRangeCommand = { (const int8_t * const ) "set-receiver-mode-range",
+        (const int8_t * const ) "\r\nset-receiver-mode-range <idx> <channel> <min> <max> <mode>:\r\n Sets mode range <idx> [0, 7], active while the channel is within [min, max] % [-100, 100]. Mode none, arm, raw, stabilized, attitude, rate, althold or autonomous (idle mode only)\r\n",
+        CLISetReceiverModeRange, /* The function to run. */
+        5 /* Number of parameters expected */
+};
+
+/* Structure that defines the "save-receiver-map" command line command. */
+static const CLI_Command_Definition_t saveReceiverMapCommand = { (const int8_t * const ) "save-receiver-map",
+        (const int8_t * const ) "\r\nsave-receiver-map:\r\n Saves the receiver channel map and mode ranges to flash (idle mode only)\r\n",
+        CLISaveReceiverMap, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
 /* Structure that defines the "get-sensors" command line command. */
 static const CLI_Command_Definition_t getSensorsCommand = { (const int8_t * const ) "get-sensors",
         (const int8_t * const ) "\r\nget-sensors: <enc>\r\n Prints last read sensor values with <enc> (n=none, p=proto)\r\n",
@@ -237,6 +588,124 @@ static const CLI_Command_Definition_t startAccMagMtrCalibration = { (const int8_
         1 /* nbr of expected parameters */
 };
 
+/* Structure that defines the "get-gyro-temp-compensation" command line command. */
+static const CLI_Command_Definition_t getGyroTempCompensationCommand = { (const int8_t * const ) "get-gyro-temp-compensation",
+        (const int8_t * const ) "\r\nget-gyro-temp-compensation:\r\n Prints the gyro temperature and the measured bins of the gyro bias vs temperature table\r\n",
+        CLIGetGyroTempCompensation, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-gyro-temp-compensation" command line command. */
+static const CLI_Command_Definition_t setGyroTempCompensationCommand = { (const int8_t * const ) "set-gyro-temp-compensation",
+        (const int8_t * const ) "\r\nset-gyro-temp-compensation <0|1|clear>:\r\n Disables or enables the gyro bias vs temperature table, or clears its bins, and saves it to flash (idle mode only). Bins are measured at startup while at rest.\r\n",
+        CLISetGyroTempCompensation, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+
+/* Structure that defines the "get-accmag-temp-compensation" command line command. */
+static const CLI_Command_Definition_t getAccMagTempCompensationCommand = { (const int8_t * const ) "get-accmag-temp-compensation",
+        (const int8_t * const ) "\r\nget-accmag-temp-compensation:\r\n Prints the acc/mag die temperature and the offset and scale vs temperature points of the calibrations\r\n",
+        CLIGetAccMagTempCompensation, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-accmag-temp-compensation" command line command. */
+static const CLI_Command_Definition_t setAccMagTempCompensationCommand = { (const int8_t * const ) "set-accmag-temp-compensation",
+        (const int8_t * const ) "\r\nset-accmag-temp-compensation <0|1|clear>:\r\n Disables or enables the acc/mag temperature compensation, or clears all points but those of the calibrations in use, and saves it to flash (idle mode only). Each acc/mag calibration adds a point at its temperature.\r\n",
+        CLISetAccMagTempCompensation, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+
+/* Structure that defines the "get-sensor-rates" command line command. */
+static const CLI_Command_Definition_t getSensorRatesCommand = { (const int8_t * const ) "get-sensor-rates",
+        (const int8_t * const ) "\r\nget-sensor-rates:\r\n Prints the nominal and measured data rates, data ready interval jitter, missed data ready interrupts and read failures of the sensors, the health, stalls and recovery steps of the sensor watchdog, and the data rates, on-chip filters and group delays in use\r\n",
+        CLIGetSensorRates, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "reset-sensor-rates" command line command. */
+static const CLI_Command_Definition_t resetSensorRatesCommand = { (const int8_t * const ) "reset-sensor-rates",
+        (const int8_t * const ) "\r\nreset-sensor-rates:\r\n Clears the sensor data rate and watchdog statistics\r\n",
+        CLIResetSensorRates, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "get-vibration" command line command. */
+static const CLI_Command_Definition_t getVibrationCommand = { (const int8_t * const ) "get-vibration",
+        (const int8_t * const ) "\r\nget-vibration:\r\n Prints the vibration RMS, clipped samples and health score of the gyroscope and accelerometer\r\n",
+        CLIGetVibration, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "reset-vibration" command line command. */
+static const CLI_Command_Definition_t resetVibrationCommand = { (const int8_t * const ) "reset-vibration",
+        (const int8_t * const ) "\r\nreset-vibration:\r\n Clears the clipped sample counters and the max vibration RMS\r\n",
+        CLIResetVibration, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+#ifdef FCB_DYNAMIC_NOTCH
+/* Structure that defines the "get-dynamic-notch" command line command. */
+static const CLI_Command_Definition_t getDynamicNotchCommand = { (const int8_t * const ) "get-dynamic-notch",
+        (const int8_t * const ) "\r\nget-dynamic-notch:\r\n Prints the gyroscope spectrum analysis cost and the dynamic notch centers\r\n",
+        CLIGetDynamicNotch, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "reset-dynamic-notch" command line command. */
+static const CLI_Command_Definition_t resetDynamicNotchCommand = { (const int8_t * const ) "reset-dynamic-notch",
+        (const int8_t * const ) "\r\nreset-dynamic-notch:\r\n Clears the spectrum analysis statistics\r\n",
+        CLIResetDynamicNotch, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+#endif
+
+#ifdef FCB_GPS
+/* Structure that defines the "get-gps" command line command. */
+static const CLI_Command_Definition_t getGpsCommand = { (const int8_t * const ) "get-gps",
+        (const int8_t * const ) "\r\nget-gps:\r\n Prints the latest GPS solution, the reception statistics and the NED position estimate\r\n",
+        CLIGetGps, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "reset-gps" command line command. */
+static const CLI_Command_Definition_t resetGpsCommand = { (const int8_t * const ) "reset-gps",
+        (const int8_t * const ) "\r\nreset-gps:\r\n Clears the GPS statistics and sets the home position from the next usable fix\r\n",
+        CLIResetGps, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+#endif
+
+#ifdef FCB_BATTERY_MONITOR
+/* Structure that defines the "get-battery" command line command. */
+static const CLI_Command_Definition_t getBatteryCommand = { (const int8_t * const ) "get-battery",
+        (const int8_t * const ) "\r\nget-battery:\r\n Prints the battery status, voltage, current, consumed charge and thrust compensation\r\n",
+        CLIGetBattery, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+#endif
+
+/* Structure that defines the "get-barometer" command line command. */
+static const CLI_Command_Definition_t getBarometerCommand = { (const int8_t * const ) "get-barometer",
+        (const int8_t * const ) "\r\nget-barometer:\r\n Prints the barometer over sampling, temperature refresh period, sample counts and pressure rate\r\n",
+        CLIGetBarometer, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-barometer" command line command. */
+static const CLI_Command_Definition_t setBarometerCommand = { (const int8_t * const ) "set-barometer",
+        (const int8_t * const ) "\r\nset-barometer <oss> <temp period>:\r\n Sets the barometer pressure over sampling, 0-3, and the temperature refresh period in ms, not saved (idle mode only)\r\n",
+        CLISetBarometer, /* The function to run. */
+        2 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-baro-reference" command line command. */
+static const CLI_Command_Definition_t setBaroReferenceCommand = { (const int8_t * const ) "set-baro-reference",
+        (const int8_t * const ) "\r\nset-baro-reference <ref>:\r\n Sets the altitude reference pressure, std=standard sea level, arm=pressure at arming or a pressure in Pa, not saved (idle mode only)\r\n",
+        CLISetBaroReference, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+
 /* Structure that defines the "get-motors" command line command. */
 static const CLI_Command_Definition_t getMotorsCommand = { (const int8_t * const ) "get-motors",
         (const int8_t * const ) "\r\nget-motors <encoding>:\r\n Prints motor control values with <enc> (n=none, p=proto)\r\n",
@@ -244,6 +713,33 @@ static const CLI_Command_Definition_t getMotorsCommand = { (const int8_t * const
         1 /* Number of parameters expected */
 };
 
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+/* Structure that defines the "get-motor-telemetry" command line command. */
+static const CLI_Command_Definition_t getMotorTelemetryCommand = { (const int8_t * const ) "get-motor-telemetry",
+        (const int8_t * const ) "\r\nget-motor-telemetry:\r\n Prints the DShot eRPM telemetry of the motors and the RPM filter notches\r\n",
+        CLIGetMotorTelemetry, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+#endif
+
+#ifdef MOTOR_ESC_TELEMETRY
+/* Structure that defines the "get-esc-telemetry" command line command. */
+static const CLI_Command_Definition_t getEscTelemetryCommand = { (const int8_t * const ) "get-esc-telemetry",
+        (const int8_t * const ) "\r\nget-esc-telemetry:\r\n Prints the telemetry and health of the ESC:s\r\n",
+        CLIGetEscTelemetry, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+#endif
+
+#ifdef FCB_CAN_BUS
+/* Structure that defines the "get-dronecan-status" command line command. */
+static const CLI_Command_Definition_t getDroneCanStatusCommand = { (const int8_t * const ) "get-dronecan-status",
+        (const int8_t * const ) "\r\nget-dronecan-status:\r\n Prints the CAN bus stats, the DroneCAN nodes and their latest data\r\n",
+        CLIGetDroneCanStatus, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+#endif
+
 /* Structure that defines the "start-motor-sampling" command line command. */
 static const CLI_Command_Definition_t startMotorSamplingCommand = { (const int8_t * const ) "start-motor-sampling",
         (const int8_t * const ) "\r\nstart-motor-sampling <rate> <dur>:\r\n Prints motor values once every <rate> ms for <dur> s\r\n",
@@ -272,13 +768,34 @@ static const CLI_Command_Definition_t systimeCommand = { (const int8_t * const )
         0 /* Number of parameters expected */
 };
 
+/* Structure that defines the "get-time-sync" command line command. */
+static const CLI_Command_Definition_t getTimeSyncCommand = { (const int8_t * const ) "get-time-sync",
+        (const int8_t * const ) "\r\nget-time-sync:\r\n Prints the host clock offset and drift estimate of the RPC time sync exchanges and its uncertainty\r\n",
+        CLIGetTimeSync, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
 /* Structure that defines the "get-flight-mode" command line command. */
 static const CLI_Command_Definition_t getFlightModeCommand = { (const int8_t * const ) "get-flight-mode",
-        (const int8_t * const ) "\r\nget-flight-mode:\r\n Prints current flight mode\r\n",
+        (const int8_t * const ) "\r\nget-flight-mode:\r\n Prints current flight mode, its state and the latest rejected request\r\n",
         CLIGetFlightMode, /* The function to run. */
         0 /* Number of parameters expected */
 };
 
+/* Structure that defines the "get-flight-mode-log" command line command. */
+static const CLI_Command_Definition_t getFlightModeLogCommand = { (const int8_t * const ) "get-flight-mode-log",
+        (const int8_t * const ) "\r\nget-flight-mode-log:\r\n Prints the latest flight mode transitions and rejected requests with their reasons\r\n",
+        CLIGetFlightModeLog, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "get-prearm" command line command. */
+static const CLI_Command_Definition_t getPreArmCommand = { (const int8_t * const ) "get-prearm",
+        (const int8_t * const ) "\r\nget-prearm:\r\n Prints the pre-arm checks of the latest evaluation, the UAV only arms when all of them pass\r\n",
+        CLIGetPreArm, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
 /* Structure that defines the "get-ref-signals" command line command. */
 static const CLI_Command_Definition_t getRefSignalsCommand = { (const int8_t * const ) "get-ref-signals",
         (const int8_t * const ) "\r\nget-ref-signals <enc>:\r\n Prints current reference signals with <enc> (n=none, p=proto)\r\n",
@@ -310,11 +827,18 @@ static const CLI_Command_Definition_t getMaxLimitReferenceSignalsCommand = { (co
 
 /* Structure that defines the "task-status" command line command. */
 static const CLI_Command_Definition_t taskStatusCommand = { (const int8_t * const ) "task-status",
-        (const int8_t * const ) "\r\ntask-status:\r\n Prints task status\r\n",
+        (const int8_t * const ) "\r\ntask-status:\r\n Prints the priority, load, context switches and least free stack of each task over the last seconds, and the heap usage\r\n",
         CLITaskStatus, /* The function to run. */
         0 /* Number of parameters expected */
 };
 
+/* Structure that defines the "fast-math-benchmark" command line command. */
+static const CLI_Command_Definition_t fastMathBenchmarkCommand = { (const int8_t * const ) "fast-math-benchmark",
+        (const int8_t * const ) "\r\nfast-math-benchmark:\r\n Prints accuracy and cycles of the fast math functions and the 3x3 matrix kernels\r\n",
+        CLIFastMathBenchmark, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
 /* Structure that defines the "get-states" command line command. */
 static const CLI_Command_Definition_t getStatesCommand = { (const int8_t * const ) "get-states",
         (const int8_t * const ) "\r\nget-states <enc>:\r\n Prints state values with <enc> (n=none, p=proto)\r\n",
@@ -337,1549 +861,6645 @@ static const CLI_Command_Definition_t stopStateSamplingCommand = { (const int8_t
         0 /* Number of parameters expected */
 };
 
-static uint16_t dataOutLength = 0;
-static uint16_t outCnt = 0;
+/* Structure that defines the "save-state-warm-start" command line command. */
+static const CLI_Command_Definition_t saveStateWarmStartCommand = { (const int8_t * const ) "save-state-warm-start",
+        (const int8_t * const ) "\r\nsave-state-warm-start:\r\n Saves the estimated gyro biases to flash for a fast startup (idle mode only)\r\n",
+        CLISaveStateWarmStart, /* The function to run. */
+        0 /* Number of parameters expected */
+};
 
-extern volatile FIFOBuffer_TypeDef USBCOMRxFIFOBuffer;
-extern xSemaphoreHandle USBCOMRxDataSem;
+/* Structure that defines the "start-sensor-noise" command line command. */
+static const CLI_Command_Definition_t startSensorNoiseCommand = { (const int8_t * const ) "start-sensor-noise",
+        (const int8_t * const ) "\r\nstart-sensor-noise <s>:\r\n Characterises the noise of all sensors for the given duration, the UAV must be at rest (idle mode only)\r\n",
+        CLIStartSensorNoise, /* The function to run. */
+        1 /* Number of parameters expected */
+};
 
-xSemaphoreHandle CLIMutex;
+/* Structure that defines the "get-sensor-noise" command line command. */
+static const CLI_Command_Definition_t getSensorNoiseCommand = { (const int8_t * const ) "get-sensor-noise",
+        (const int8_t * const ) "\r\nget-sensor-noise:\r\n Prints the sensor noise characterisation and the Kalman measurement noise derived from it\r\n",
+        CLIGetSensorNoise, /* The function to run. */
+        0 /* Number of parameters expected */
+};
 
-/* Exported functions --------------------------------------------------------*/
+/* Structure that defines the "save-sensor-noise" command line command. */
+static const CLI_Command_Definition_t saveSensorNoiseCommand = { (const int8_t * const ) "save-sensor-noise",
+        (const int8_t * const ) "\r\nsave-sensor-noise:\r\n Saves the sensor noise characterisation to flash, seeds the Kalman filter from the next startup (idle mode only)\r\n",
+        CLISaveSensorNoise, /* The function to run. */
+        0 /* Number of parameters expected */
+};
 
-/**
- * @brief  Registers CLI commands
- * @param  None
- * @retval None
- * @note   Too many CLI commands may cause problems with the "help" command if the UsbTxQueue is not large enough
- */
-void RegisterCLICommands(void) {
-    /* Register all the command line commands defined immediately above. */
+/* Structure that defines the "set-motor-mixer" command line command. */
+static const CLI_Command_Definition_t setMotorMixerCommand = { (const int8_t * const ) "set-motor-mixer",
+        (const int8_t * const ) "\r\nset-motor-mixer <layout> <airmode>:\r\n Sets the motor layout (quadx, quadplus, hexx or octox) and airmode (0 or 1) and saves them to flash (idle mode only)\r\n",
+        CLISetMotorMixer, /* The function to run. */
+        2 /* Number of parameters expected */
+};
 
-    /* Sample CLI commands */
-    FreeRTOS_CLIRegisterCommand(&echoCommand);
-    FreeRTOS_CLIRegisterCommand(&echoDataCommand);
+/* Structure that defines the "get-mixer-allocation" command line command. */
+static const CLI_Command_Definition_t getMixerAllocationCommand = { (const int8_t * const ) "get-mixer-allocation",
+        (const int8_t * const ) "\r\nget-mixer-allocation:\r\n Prints the allocation priority of the mixer and the command limits of each motor\r\n",
+        CLIGetMixerAllocation, /* The function to run. */
+        0 /* Number of parameters expected */
+};
 
-    /* RC receiver CLI commands*/
-    FreeRTOS_CLIRegisterCommand(&startReceiverCalibrationCommand);
-    FreeRTOS_CLIRegisterCommand(&stopReceiverCalibrationCommand);
-    FreeRTOS_CLIRegisterCommand(&resetReceiverCalibrationCommand);
-    FreeRTOS_CLIRegisterCommand(&getReceiverCommand);
-    FreeRTOS_CLIRegisterCommand(&getReceiverCalibrationCommand);
-    FreeRTOS_CLIRegisterCommand(&startReceiverSamplingCommand);
-    FreeRTOS_CLIRegisterCommand(&stopReceiverSamplingCommand);
+/* Structure that defines the "set-mixer-allocation" command line command. */
+static const CLI_Command_Definition_t setMixerAllocationCommand = { (const int8_t * const ) "set-mixer-allocation",
+        (const int8_t * const ) "\r\nset-mixer-allocation <priority> <motor> <min> <max>:\r\n Sets the priority (rollpitch: roll & pitch, then yaw, then thrust, attitude: roll, pitch & yaw together, then thrust) and the command limits [0, 1] of a motor (1 to 8, 0 for all), without saving them\r\n",
+        CLISetMixerAllocation, /* The function to run. */
+        4 /* Number of parameters expected */
+};
 
-    /* Sensor CLI commands */
-    FreeRTOS_CLIRegisterCommand(&getSensorsCommand);
-    FreeRTOS_CLIRegisterCommand(&startSensorSamplingCommand);
-    FreeRTOS_CLIRegisterCommand(&stopSensorSamplingCommand);
-    FreeRTOS_CLIRegisterCommand(&startAccMagMtrCalibration);
+/* Structure that defines the "save-mixer-allocation" command line command. */
+static const CLI_Command_Definition_t saveMixerAllocationCommand = { (const int8_t * const ) "save-mixer-allocation",
+        (const int8_t * const ) "\r\nsave-mixer-allocation:\r\n Saves the allocation priority and motor command limits to flash (idle mode only)\r\n",
+        CLISaveMixerAllocation, /* The function to run. */
+        0 /* Number of parameters expected */
+};
 
-    /* Motors CLI commands */
-    FreeRTOS_CLIRegisterCommand(&getMotorsCommand);
-    FreeRTOS_CLIRegisterCommand(&startMotorSamplingCommand);
-    FreeRTOS_CLIRegisterCommand(&stopMotorSamplingCommand);
+/* Structure that defines the "get-control-latency" command line command. */
+static const CLI_Command_Definition_t getControlLatencyCommand = { (const int8_t * const ) "get-control-latency",
+        (const int8_t * const ) "\r\nget-control-latency:\r\n Prints the gyroscope data ready to motor output latency per pipeline stage and as a histogram\r\n",
+        CLIGetControlLatency, /* The function to run. */
+        0 /* Number of parameters expected */
+};
 
-    /* System info CLI commands */
-    FreeRTOS_CLIRegisterCommand(&aboutCommand);
-    FreeRTOS_CLIRegisterCommand(&systimeCommand);
-    FreeRTOS_CLIRegisterCommand(&taskStatusCommand);
+/* Structure that defines the "reset-control-latency" command line command. */
+static const CLI_Command_Definition_t resetControlLatencyCommand = { (const int8_t * const ) "reset-control-latency",
+        (const int8_t * const ) "\r\nreset-control-latency:\r\n Clears the control latency statistics\r\n",
+        CLIResetControlLatency, /* The function to run. */
+        0 /* Number of parameters expected */
+};
 
-    /* Flight control CLI commands */
-    FreeRTOS_CLIRegisterCommand(&getFlightModeCommand);
-    FreeRTOS_CLIRegisterCommand(&getRefSignalsCommand);
-    FreeRTOS_CLIRegisterCommand(&getCtrlSignalsCommand);
-    FreeRTOS_CLIRegisterCommand(&setMaxLimitReferenceSignalsCommand);
-    FreeRTOS_CLIRegisterCommand(&getMaxLimitReferenceSignalsCommand);
-    FreeRTOS_CLIRegisterCommand(&getStatesCommand);
-    FreeRTOS_CLIRegisterCommand(&startStateSamplingCommand);
-    FreeRTOS_CLIRegisterCommand(&stopStateSamplingCommand);
-}
+#ifdef FCB_WAKE_LATENCY
+/* Structure that defines the "get-wake-latency" command line command. */
+static const CLI_Command_Definition_t getWakeLatencyCommand = { (const int8_t * const ) "get-wake-latency",
+        (const int8_t * const ) "\r\nget-wake-latency:\r\n Prints the signal to task running latency of the gyroscope sample handoffs, interrupt to SENSORS task and SENSORS to flight control task, with percentiles and histograms\r\n",
+        CLIGetWakeLatency, /* The function to run. */
+        0 /* Number of parameters expected */
+};
 
-/**
- * @brief  Creates semaphores used for accessing CLI
- * @param  cliIn : Pointer to CLI input buffer
- * @param  cliOut : Pointer to CLI output buffer
- * @param  len : Pointer to data output length (set for data, if zero the output is string formatted)
- * @retval pdTRUE if more data follows, pdFALSE if command activity finished
- */
-portBASE_TYPE CLIParser(uint8_t* cliIn, uint8_t* cliOut, uint16_t* len) {
-    portBASE_TYPE retval;
+/* Structure that defines the "reset-wake-latency" command line command. */
+static const CLI_Command_Definition_t resetWakeLatencyCommand = { (const int8_t * const ) "reset-wake-latency",
+        (const int8_t * const ) "\r\nreset-wake-latency:\r\n Clears the wake latency statistics\r\n",
+        CLIResetWakeLatency, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+#endif
 
-    dataOutLength = 0;
+/* Structure that defines the "get-memory-placement" command line command. */
+static const CLI_Command_Definition_t getMemoryPlacementCommand = { (const int8_t * const ) "get-memory-placement",
+        (const int8_t * const ) "\r\nget-memory-placement:\r\n Prints the memory region, address and size of the hot control path objects and the CCM SRAM usage, see FCB_CCM_RAM\r\n",
+        CLIGetMemoryPlacement, /* The function to run. */
+        0 /* Number of parameters expected */
+};
 
-    retval = FreeRTOS_CLIProcessCommand((int8_t*) cliIn, /* The command string.*/
-            (int8_t*) cliOut, /* The output buffer. */
-            MAX_CLI_OUTPUT_SIZE /* The size of the output buffer. */
-    );
+/* Structure that defines the "get-deferred-work" command line command. */
+static const CLI_Command_Definition_t getDeferredWorkCommand = { (const int8_t * const ) "get-deferred-work",
+        (const int8_t * const ) "\r\nget-deferred-work:\r\n Prints the posts, coalesced posts, runs, post to run latency and run time of the deferred work items of the drivers\r\n",
+        CLIGetDeferredWork, /* The function to run. */
+        0 /* Number of parameters expected */
+};
 
-    (*len) = dataOutLength;
-    return retval;
-}
+/* Structure that defines the "reset-deferred-work" command line command. */
+static const CLI_Command_Definition_t resetDeferredWorkCommand = { (const int8_t * const ) "reset-deferred-work",
+        (const int8_t * const ) "\r\nreset-deferred-work:\r\n Clears the deferred work statistics\r\n",
+        CLIResetDeferredWork, /* The function to run. */
+        0 /* Number of parameters expected */
+};
 
-/**
- * @brief  Creates semaphores used for accessing CLI
- * @param  None
- * @retval None
- */
-void CreateCLISemaphores(void) {
-    CLIMutex = xSemaphoreCreateMutex();
-    if (CLIMutex == NULL) {
-        ErrorHandler();
-    }
-}
+/* Structure that defines the "get-rate-groups" command line command. */
+static const CLI_Command_Definition_t getRateGroupsCommand = { (const int8_t * const ) "get-rate-groups",
+        (const int8_t * const ) "\r\nget-rate-groups:\r\n Prints the releases, skipped releases, runs, late runs, release to run latency and run time of the periodic jobs of the rate groups\r\n",
+        CLIGetRateGroups, /* The function to run. */
+        0 /* Number of parameters expected */
+};
 
-/**
- * @brief  Takes the CLI mutex
- * @param  None
- * @retval None
- */
-uint32_t TakeCLIMutex(void) {
-    return xSemaphoreTake(CLIMutex, portMAX_DELAY);
-}
+/* Structure that defines the "reset-rate-groups" command line command. */
+static const CLI_Command_Definition_t resetRateGroupsCommand = { (const int8_t * const ) "reset-rate-groups",
+        (const int8_t * const ) "\r\nreset-rate-groups:\r\n Clears the rate group statistics\r\n",
+        CLIResetRateGroups, /* The function to run. */
+        0 /* Number of parameters expected */
+};
 
-/**
- * @brief  Gives the CLI mutex
- * @param  None
- * @retval None
- */
-void GiveCLIMutex(void) {
-    xSemaphoreGive(CLIMutex);
-}
+/* Structure that defines the "get-boot-time" command line command. */
+static const CLI_Command_Definition_t getBootTimeCommand = { (const int8_t * const ) "get-boot-time",
+        (const int8_t * const ) "\r\nget-boot-time:\r\n Prints when each start up phase completed, from the clock setup to armable\r\n",
+        CLIGetBootTime, /* The function to run. */
+        0 /* Number of parameters expected */
+};
 
-/* Private functions ---------------------------------------------------------*/
+#ifdef FCB_CONTROL_EXECUTIVE
+/* Structure that defines the "get-control-executive" command line command. */
+static const CLI_Command_Definition_t getControlExecutiveCommand = { (const int8_t * const ) "get-control-executive",
+        (const int8_t * const ) "\r\nget-control-executive:\r\n Prints the samples, lost samples, rate loop runs, run time and data ready to motor output latency of the control executive\r\n",
+        CLIGetControlExecutive, /* The function to run. */
+        0 /* Number of parameters expected */
+};
 
-/**
- * @brief  Implements the CLI command to echo one parameter
- * @param  pcWriteBuffer : Reference to output buffer
- * @param  xWriteBufferLen : Size of output buffer
- * @param  pcCommandString : Command line string
- * @retval pdTRUE if more data follows, pdFALSE if command activity finished
- */
-static portBASE_TYPE CLIEcho(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
-    int8_t* pcParameter;
-    portBASE_TYPE xParameterStringLength, xReturn;
-    static portBASE_TYPE lParameterNumber = 0;
+/* Structure that defines the "reset-control-executive" command line command. */
+static const CLI_Command_Definition_t resetControlExecutiveCommand = { (const int8_t * const ) "reset-control-executive",
+        (const int8_t * const ) "\r\nreset-control-executive:\r\n Clears the control executive statistics\r\n",
+        CLIResetControlExecutive, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+#endif
 
-    /* Check the write buffer is not NULL */
-    configASSERT(pcWriteBuffer);
+#ifdef FCB_SENSOR_LOAD_TEST
+/* Structure that defines the "start-sensor-load-test" command line command. */
+static const CLI_Command_Definition_t startSensorLoadTestCommand = { (const int8_t * const ) "start-sensor-load-test",
+        (const int8_t * const ) "\r\nstart-sensor-load-test <gyro> <acc> <mag> <dur>:\r\n Triggers the data ready interrupts of the gyroscope, accelerometer and magnetometer at <gyro>, <acc> and <mag> Hz (0 = off) for <dur> ms, the drivers pass on their last real samples (idle mode only)\r\n",
+        CLIStartSensorLoadTest, /* The function to run. */
+        4 /* Number of parameters expected */
+};
 
-    if (lParameterNumber == 0) {
-        /* The first time the function is called after the command has been
-		 entered just a header string is returned. */
-        memset(pcWriteBuffer, 0x00, xWriteBufferLen);
-        strncpy((char*) pcWriteBuffer, "Parameter received:\r\n", xWriteBufferLen);
-    } else {
-        /* Obtain the parameter string */
-        pcParameter = (int8_t*) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
-                lParameterNumber, /* Return the next parameter. */
-                &xParameterStringLength /* Store the parameter string length. */
-        );
+/* Structure that defines the "stop-sensor-load-test" command line command. */
+static const CLI_Command_Definition_t stopSensorLoadTestCommand = { (const int8_t * const ) "stop-sensor-load-test",
+        (const int8_t * const ) "\r\nstop-sensor-load-test:\r\n Ends the sensor load test and prints its statistics\r\n",
+        CLIStopSensorLoadTest, /* The function to run. */
+        0 /* Number of parameters expected */
+};
 
-        /* Sanity check something was returned. */
-        configASSERT(pcParameter);
+/* Structure that defines the "get-sensor-load-test" command line command. */
+static const CLI_Command_Definition_t getSensorLoadTestCommand = { (const int8_t * const ) "get-sensor-load-test",
+        (const int8_t * const ) "\r\nget-sensor-load-test:\r\n Prints the triggers, samples, data ready to sample latency, lost events and SENSORS task time of the running or the last sensor load test\r\n",
+        CLIGetSensorLoadTest, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+#endif
 
-        /* Return the parameter string. */
-        memset(pcWriteBuffer, 0x00, xWriteBufferLen);
-        strncpy((char*) pcWriteBuffer, (const char*) pcParameter, xParameterStringLength);
-        strncat((char*) pcWriteBuffer, "\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
-    }
+#ifdef FCB_WCET_TEST
+/* Structure that defines the "start-wcet-test" command line command. */
+static const CLI_Command_Definition_t startWcetTestCommand = { (const int8_t * const ) "start-wcet-test",
+        (const int8_t * const ) "\r\nstart-wcet-test <dur>:\r\n Runs the flight pipeline under the worst-case load for <dur> ms and checks its timing against the budgets, the motors are locked (idle mode only)\r\n",
+        CLIStartWcetTest, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+
+/* Structure that defines the "stop-wcet-test" command line command. */
+static const CLI_Command_Definition_t stopWcetTestCommand = { (const int8_t * const ) "stop-wcet-test",
+        (const int8_t * const ) "\r\nstop-wcet-test:\r\n Aborts the WCET test\r\n",
+        CLIStopWcetTest, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "get-wcet-test" command line command. */
+static const CLI_Command_Definition_t getWcetTestCommand = { (const int8_t * const ) "get-wcet-test",
+        (const int8_t * const ) "\r\nget-wcet-test:\r\n Prints the result of the running or the last WCET test, with the measured maxima and their budgets\r\n",
+        CLIGetWcetTest, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+#endif
+
+/* Structure that defines the "get-deadline-stats" command line command. */
+static const CLI_Command_Definition_t getDeadlineStatsCommand = { (const int8_t * const ) "get-deadline-stats",
+        (const int8_t * const ) "\r\nget-deadline-stats:\r\n Prints the expected period, period jitter, late starts and worst-case execution time of the control loops\r\n",
+        CLIGetDeadlineStats, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "reset-deadline-stats" command line command. */
+static const CLI_Command_Definition_t resetDeadlineStatsCommand = { (const int8_t * const ) "reset-deadline-stats",
+        (const int8_t * const ) "\r\nreset-deadline-stats:\r\n Clears the control loop deadline statistics and overrun flags\r\n",
+        CLIResetDeadlineStats, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "buffer-status" command line command. */
+static const CLI_Command_Definition_t bufferStatusCommand = { (const int8_t * const ) "buffer-status",
+        (const int8_t * const ) "\r\nbuffer-status:\r\n Prints the capacity, high-water mark, overflows and time at full of the ring buffers, queues and mailboxes since startup\r\n",
+        CLIBufferStatus, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "crash-dump" command line command. */
+static const CLI_Command_Definition_t crashDumpCommand = { (const int8_t * const ) "crash-dump",
+        (const int8_t * const ) "\r\ncrash-dump <n|p|c>:\r\n Prints the dump of the last hard fault or ErrorHandler() call in [n]ormal or [p]rotobuf format, [c]lear erases it and restarts the crash count\r\n",
+        CLICrashDump, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+
+/* Structure that defines the "get-event-journal" command line command. */
+static const CLI_Command_Definition_t getEventJournalCommand = { (const int8_t * const ) "get-event-journal",
+        (const int8_t * const ) "\r\nget-event-journal:\r\n Prints the flight odometer and the event journal, the oldest event first, as boot count, tick, event, arg and value\r\n",
+        CLIGetEventJournal, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "clear-event-journal" command line command. */
+static const CLI_Command_Definition_t clearEventJournalCommand = { (const int8_t * const ) "clear-event-journal",
+        (const int8_t * const ) "\r\nclear-event-journal:\r\n Erases the event journal, the odometer is kept (idle mode only)\r\n",
+        CLIClearEventJournal, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "get-scope-probes" command line command. */
+static const CLI_Command_Definition_t getScopeProbesCommand = { (const int8_t * const ) "get-scope-probes",
+        (const int8_t * const ) "\r\nget-scope-probes:\r\n Prints the scope probe channel of each pipeline stage. Needs FCB_SCOPE_PROBE_GPIO or FCB_SCOPE_PROBE_DAC\r\n",
+        CLIGetScopeProbes, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-scope-probe" command line command. */
+static const CLI_Command_Definition_t setScopeProbeCommand = { (const int8_t * const ) "set-scope-probe",
+        (const int8_t * const ) "\r\nset-scope-probe <stage> <channel>:\r\n Marks a pipeline stage (drdy, fetch, prediction, correction, pid, motor) on a scope probe channel, or - to unmark it\r\n",
+        CLISetScopeProbe, /* The function to run. */
+        2 /* Number of parameters expected */
+};
+
+#ifdef FCB_ISR_MONITOR
+/* Structure that defines the "get-isr-stats" command line command. */
+static const CLI_Command_Definition_t getIsrStatsCommand = { (const int8_t * const ) "get-isr-stats",
+        (const int8_t * const ) "\r\nget-isr-stats:\r\n Prints the NVIC priority, call count, rate, mean and max execution time [cycles] and CPU load of the interrupt handlers\r\n",
+        CLIGetIsrStats, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "reset-isr-stats" command line command. */
+static const CLI_Command_Definition_t resetIsrStatsCommand = { (const int8_t * const ) "reset-isr-stats",
+        (const int8_t * const ) "\r\nreset-isr-stats:\r\n Clears the interrupt handler statistics\r\n",
+        CLIResetIsrStats, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+#endif
+
+#ifdef FCB_PROFILING
+/* Structure that defines the "profile" command line command. */
+static const CLI_Command_Definition_t profileCommand = { (const int8_t * const ) "profile",
+        (const int8_t * const ) "\r\nprofile <n|p|s|r>:\r\n Prints the execution time statistics of the profiling probes in [n]ormal or [p]rotobuf format, [s]napshot prints and clears them at once, [r]eset clears them\r\n",
+        CLIProfile, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+#endif
+
+#ifdef FCB_PERF_SNAPSHOT
+/* Structure that defines the "get-perf-snapshot" command line command. */
+static const CLI_Command_Definition_t getPerfSnapshotCommand = { (const int8_t * const ) "get-perf-snapshot",
+        (const int8_t * const ) "\r\nget-perf-snapshot <t|c|r>:\r\n Prints the latest performance snapshot of the profiling, deadline, interrupt, buffer, stack and sensor data rate statistics as a [t]able with the baseline, as [c]SV, or its [r]egressions against the baseline\r\n",
+        CLIGetPerfSnapshot, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-perf-snapshot-period" command line command. */
+static const CLI_Command_Definition_t setPerfPeriodCommand = { (const int8_t * const ) "set-perf-snapshot-period",
+        (const int8_t * const ) "\r\nset-perf-snapshot-period <s>:\r\n Sets the time between the performance snapshots [s], not saved\r\n",
+        CLISetPerfSnapshotPeriod, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+
+/* Structure that defines the "reset-perf-snapshot" command line command. */
+static const CLI_Command_Definition_t resetPerfSnapshotCommand = { (const int8_t * const ) "reset-perf-snapshot",
+        (const int8_t * const ) "\r\nreset-perf-snapshot:\r\n Clears the profiling, deadline, interrupt and sensor data rate statistics of the performance snapshot, e.g. before a flight\r\n",
+        CLIResetPerfSnapshot, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "save-perf-baseline" command line command. */
+static const CLI_Command_Definition_t savePerfBaselineCommand = { (const int8_t * const ) "save-perf-baseline",
+        (const int8_t * const ) "\r\nsave-perf-baseline:\r\n Saves the latest performance snapshot to flash as the baseline to compare the snapshots of later builds with (idle mode only)\r\n",
+        CLISavePerfBaseline, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+#endif
+
+/* Structure that defines the "get-pid-gains" command line command. */
+static const CLI_Command_Definition_t getPIDGainsCommand = { (const int8_t * const ) "get-pid-gains",
+        (const int8_t * const ) "\r\nget-pid-gains:\r\n Prints the gains and setpoint feed-forwards of the PID controllers\r\n",
+        CLIGetPIDGains, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-pid-gains" command line command. */
+static const CLI_Command_Definition_t setPIDGainsCommand = { (const int8_t * const ) "set-pid-gains",
+        (const int8_t * const ) "\r\nset-pid-gains <controller> <K> <Ti> <Td>:\r\n Sets the gains of a PID controller from the next control cycle on (see get-pid-gains for the controller names)\r\n",
+        CLISetPIDGains, /* The function to run. */
+        4 /* Number of parameters expected */
+};
+
+/* Structure that defines the "save-pid-gains" command line command. */
+static const CLI_Command_Definition_t savePIDGainsCommand = { (const int8_t * const ) "save-pid-gains",
+        (const int8_t * const ) "\r\nsave-pid-gains:\r\n Saves the current PID gains and setpoint feed-forwards to flash (idle mode only)\r\n",
+        CLISavePIDGains, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-pid-ff" command line command. */
+static const CLI_Command_Definition_t setPIDFeedForwardCommand = { (const int8_t * const ) "set-pid-ff",
+        (const int8_t * const ) "\r\nset-pid-ff <controller> <Kff> <Tf>:\r\n Sets the gain of the reference derivative, 1 for the inertia or mass times the reference rate of change, and its filter time constant [s] of a PID controller, 0 stops the feed-forward\r\n",
+        CLISetPIDFeedForward, /* The function to run. */
+        3 /* Number of parameters expected */
+};
+
+#ifdef PID_USE_GAIN_SCHEDULING
+/* Structure that defines the "get-pid-schedule" command line command. */
+static const CLI_Command_Definition_t getPIDScheduleCommand = { (const int8_t * const ) "get-pid-schedule",
+        (const int8_t * const ) "\r\nget-pid-schedule:\r\n Prints the throttle and battery gain schedule tables of the moment controllers and their active scales\r\n",
+        CLIGetPIDSchedule, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-pid-schedule" command line command. */
+static const CLI_Command_Definition_t setPIDScheduleCommand = { (const int8_t * const ) "set-pid-schedule",
+        (const int8_t * const ) "\r\nset-pid-schedule <throttle|battery> <s1> <s2> <s3> <s4> <s5>:\r\n Sets the scales at the evenly spaced breakpoints of a gain schedule table (see get-pid-schedule)\r\n",
+        CLISetPIDSchedule, /* The function to run. */
+        1 + PID_SCHEDULE_BREAKPOINTS /* Number of parameters expected */
+};
+
+/* Structure that defines the "save-pid-schedule" command line command. */
+static const CLI_Command_Definition_t savePIDScheduleCommand = { (const int8_t * const ) "save-pid-schedule",
+        (const int8_t * const ) "\r\nsave-pid-schedule:\r\n Saves the gain schedule tables to flash (idle mode only)\r\n",
+        CLISavePIDSchedule, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+#endif
+
+#ifdef PID_AUTOTUNE
+/* Structure that defines the "autotune" command line command. */
+static const CLI_Command_Definition_t autotuneCommand = { (const int8_t * const ) "autotune",
+        (const int8_t * const ) "\r\nautotune <roll|pitch|yaw|stop|accept|discard|status>:\r\n Starts a relay feedback autotune of the moment controller of an axis, which runs in the attitude flight mode with the sticks centred, stops it, sets the proposed gains (see save-pid-gains) or discards them, or prints its status\r\n",
+        CLIAutotune, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+#endif
+
+#ifdef FCB_SYSTEM_IDENTIFICATION
+/* Structure that defines the "sysid-start" command line command. */
+static const CLI_Command_Definition_t sysIdStartCommand = { (const int8_t * const ) "sysid-start",
+        (const int8_t * const ) "\r\nsysid-start <roll|pitch|yaw> <chirp|prbs> <amplitude> <duration> <fmin> <fmax>:\r\n Adds a chirp from fmin to fmax [Hz] or a PRBS up to fmax, of amplitude [Nm] for duration [s], to the moment command of an axis in a stabilized flight mode, logged to the blackbox\r\n",
+        CLISysIdStart, /* The function to run. */
+        6 /* Number of parameters expected */
+};
+
+/* Structure that defines the "sysid-stop" command line command. */
+static const CLI_Command_Definition_t sysIdStopCommand = { (const int8_t * const ) "sysid-stop",
+        (const int8_t * const ) "\r\nsysid-stop:\r\n Stops the system identification excitation\r\n",
+        CLISysIdStop, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "sysid-status" command line command. */
+static const CLI_Command_Definition_t sysIdStatusCommand = { (const int8_t * const ) "sysid-status",
+        (const int8_t * const ) "\r\nsysid-status:\r\n Prints the state and progress of the system identification\r\n",
+        CLISysIdStatus, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+#endif
+
+/* Structure that defines the "get-stick-curves" command line command. */
+static const CLI_Command_Definition_t getStickCurvesCommand = { (const int8_t * const ) "get-stick-curves",
+        (const int8_t * const ) "\r\nget-stick-curves:\r\n Prints the deadband, expo and super rate of the stick curves\r\n",
+        CLIGetStickCurves, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-stick-curve" command line command. */
+static const CLI_Command_Definition_t setStickCurveCommand = { (const int8_t * const ) "set-stick-curve",
+        (const int8_t * const ) "\r\nset-stick-curve <axis> <deadband> <expo> <superrate>:\r\n Sets the stick curve of an axis (throttle, roll, pitch or yaw), deadband [0, 0.25], expo [0, 1], super rate [0, 0.8]\r\n",
+        CLISetStickCurve, /* The function to run. */
+        4 /* Number of parameters expected */
+};
+
+/* Structure that defines the "save-stick-curves" command line command. */
+static const CLI_Command_Definition_t saveStickCurvesCommand = { (const int8_t * const ) "save-stick-curves",
+        (const int8_t * const ) "\r\nsave-stick-curves:\r\n Saves the current stick curves to flash (idle mode only)\r\n",
+        CLISaveStickCurves, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "get-thrust-curves" command line command. */
+static const CLI_Command_Definition_t getThrustCurvesCommand = { (const int8_t * const ) "get-thrust-curves",
+        (const int8_t * const ) "\r\nget-thrust-curves:\r\n Prints the thrust curves of the motors and the points of the thrust test\r\n",
+        CLIGetThrustCurves, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-thrust-curve" command line command. */
+static const CLI_Command_Definition_t setThrustCurveCommand = { (const int8_t * const ) "set-thrust-curve",
+        (const int8_t * const ) "\r\nset-thrust-curve <motor> <c0> <c1> <c2>:\r\n Sets the thrust curve T = c0 + c1*x + c2*x^2 [N] of motor 1-4 over the output x [0, 1] (idle mode only)\r\n",
+        CLISetThrustCurve, /* The function to run. */
+        4 /* Number of parameters expected */
+};
+
+/* Structure that defines the "save-thrust-curves" command line command. */
+static const CLI_Command_Definition_t saveThrustCurvesCommand = { (const int8_t * const ) "save-thrust-curves",
+        (const int8_t * const ) "\r\nsave-thrust-curves:\r\n Saves the current thrust curves to flash (idle mode only)\r\n",
+        CLISaveThrustCurves, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "thrust-test" command line command. */
+static const CLI_Command_Definition_t thrustTestCommand = { (const int8_t * const ) "thrust-test",
+        (const int8_t * const ) "\r\nthrust-test <motor> <output>:\r\n Spins motor 1-4 alone at the output [0, 1] for 10 s on a thrust stand (idle mode only, PROPELLERS ON), motor 0 stops it\r\n",
+        CLIThrustTest, /* The function to run. */
+        2 /* Number of parameters expected */
+};
+
+/* Structure that defines the "thrust-point" command line command. */
+static const CLI_Command_Definition_t thrustPointCommand = { (const int8_t * const ) "thrust-point",
+        (const int8_t * const ) "\r\nthrust-point <thrust>:\r\n Records the load cell thrust [N] at the output of the running thrust test\r\n",
+        CLIThrustPoint, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+
+/* Structure that defines the "fit-thrust-curve" command line command. */
+static const CLI_Command_Definition_t fitThrustCurveCommand = { (const int8_t * const ) "fit-thrust-curve",
+        (const int8_t * const ) "\r\nfit-thrust-curve:\r\n Fits and sets the thrust curve of the tested motor from its thrust points (idle mode only)\r\n",
+        CLIFitThrustCurve, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "motor-test-unlock" command line command. */
+static const CLI_Command_Definition_t motorTestUnlockCommand = { (const int8_t * const ) "motor-test-unlock",
+        (const int8_t * const ) "\r\nmotor-test-unlock props-off:\r\n Confirms the propellers are removed and unlocks motor-test and esc-calibrate for 60 s (idle mode and USB only)\r\n",
+        CLIMotorTestUnlock, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+
+/* Structure that defines the "motor-test-lock" command line command. */
+static const CLI_Command_Definition_t motorTestLockCommand = { (const int8_t * const ) "motor-test-lock",
+        (const int8_t * const ) "\r\nmotor-test-lock:\r\n Stops the motor test or the ESC calibration and locks them\r\n",
+        CLIMotorTestLock, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "motor-test" command line command. */
+static const CLI_Command_Definition_t motorTestCommand = { (const int8_t * const ) "motor-test",
+        (const int8_t * const ) "\r\nmotor-test <motor> <output> <duration>:\r\n Spins motor 1-4 alone at the output [0, 1] for the duration (0, 10000] ms (PROPELLERS OFF, see motor-test-unlock), motor 0 stops it\r\n",
+        CLIMotorTest, /* The function to run. */
+        3 /* Number of parameters expected */
+};
+
+/* Structure that defines the "motor-test-status" command line command. */
+static const CLI_Command_Definition_t motorTestStatusCommand = { (const int8_t * const ) "motor-test-status",
+        (const int8_t * const ) "\r\nmotor-test-status:\r\n Prints the state of the motor test and the ESC calibration, and the ESC outputs\r\n",
+        CLIMotorTestStatus, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "esc-calibrate" command line command. */
+static const CLI_Command_Definition_t escCalibrateCommand = { (const int8_t * const ) "esc-calibrate",
+        (const int8_t * const ) "\r\nesc-calibrate <start|next|abort>:\r\n Guided ESC endpoint calibration with the max pulse, then the min pulse (analog protocols, PROPELLERS OFF, see motor-test-unlock)\r\n",
+        CLIEscCalibrate, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+
+/* Structure that defines the "get-esc-outputs" command line command. */
+static const CLI_Command_Definition_t getEscOutputsCommand = { (const int8_t * const ) "get-esc-outputs",
+        (const int8_t * const ) "\r\nget-esc-outputs:\r\n Prints the min, idle and max pulses [us] of the analog protocols\r\n",
+        CLIGetEscOutputs, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-esc-outputs" command line command. */
+static const CLI_Command_Definition_t setEscOutputsCommand = { (const int8_t * const ) "set-esc-outputs",
+        (const int8_t * const ) "\r\nset-esc-outputs <min> <idle> <max>:\r\n Sets the pulses [us] of the analog protocols, min <= idle < max (idle mode only)\r\n",
+        CLISetEscOutputs, /* The function to run. */
+        3 /* Number of parameters expected */
+};
+
+/* Structure that defines the "save-esc-outputs" command line command. */
+static const CLI_Command_Definition_t saveEscOutputsCommand = { (const int8_t * const ) "save-esc-outputs",
+        (const int8_t * const ) "\r\nsave-esc-outputs:\r\n Saves the current ESC outputs to flash (idle mode only)\r\n",
+        CLISaveEscOutputs, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+#ifdef FCB_CRASH_DETECTION
+/* Structure that defines the "get-crash-detection" command line command. */
+static const CLI_Command_Definition_t getCrashDetectionCommand = { (const int8_t * const ) "get-crash-detection",
+        (const int8_t * const ) "\r\nget-crash-detection:\r\n Prints the crash detection settings, whether a crash is latched and the latest crash\r\n",
+        CLIGetCrashDetection, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-crash-detection" command line command. */
+static const CLI_Command_Definition_t setCrashDetectionCommand = { (const int8_t * const ) "set-crash-detection",
+        (const int8_t * const ) "\r\nset-crash-detection <impact g> <impact time> <tumble time> <inverted time>:\r\n Sets the impact acceleration and the times [s] a condition lasts before the motors are cut, 0 turns a condition off\r\n",
+        CLISetCrashDetection, /* The function to run. */
+        4 /* Number of parameters expected */
+};
+
+/* Structure that defines the "save-crash-detection" command line command. */
+static const CLI_Command_Definition_t saveCrashDetectionCommand = { (const int8_t * const ) "save-crash-detection",
+        (const int8_t * const ) "\r\nsave-crash-detection:\r\n Saves the crash detection settings to flash (idle mode only)\r\n",
+        CLISaveCrashDetection, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+#endif
+
+#ifdef FCB_MOTOR_FAILURE_DETECTION
+/* Structure that defines the "get-motor-failure" command line command. */
+static const CLI_Command_Definition_t getMotorFailureCommand = { (const int8_t * const ) "get-motor-failure",
+        (const int8_t * const ) "\r\nget-motor-failure:\r\n Prints the motor failure detection settings, the moment residual, whether a failure is latched and the latest failure\r\n",
+        CLIGetMotorFailure, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-motor-failure" command line command. */
+static const CLI_Command_Definition_t setMotorFailureCommand = { (const int8_t * const ) "set-motor-failure",
+        (const int8_t * const ) "\r\nset-motor-failure <detection time> <residual share>:\r\n Sets the time [s] the moment residual of a motor lasts before it is failed, 0 turns the residual off, and the part of its moment the residual has to reach\r\n",
+        CLISetMotorFailure, /* The function to run. */
+        2 /* Number of parameters expected */
+};
+
+/* Structure that defines the "save-motor-failure" command line command. */
+static const CLI_Command_Definition_t saveMotorFailureCommand = { (const int8_t * const ) "save-motor-failure",
+        (const int8_t * const ) "\r\nsave-motor-failure:\r\n Saves the motor failure detection settings to flash (idle mode only)\r\n",
+        CLISaveMotorFailure, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+#endif
+
+#ifdef FCB_USB_MASS_STORAGE
+/* Structure that defines the "get-usb-msc" command line command. */
+static const CLI_Command_Definition_t getUSBMscCommand = { (const int8_t * const ) "get-usb-msc",
+        (const int8_t * const ) "\r\nget-usb-msc:\r\n Prints the USB mass storage status, whether the medium is inserted, the files of the volume and the commands of the host\r\n",
+        CLIGetUSBMsc, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-usb-msc" command line command. */
+static const CLI_Command_Definition_t setUSBMscCommand = { (const int8_t * const ) "set-usb-msc",
+        (const int8_t * const ) "\r\nset-usb-msc <0|1>:\r\n Ejects (0) or inserts (1) the read-only USB drive of the logs, event journal, crash dump, parameters and settings, inserted while disarmed only and ejected on arming\r\n",
+        CLISetUSBMsc, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+#endif
+
+/* Structure that defines the "profile-select" command line command. */
+static const CLI_Command_Definition_t profileSelectCommand = { (const int8_t * const ) "profile-select",
+        (const int8_t * const ) "\r\nprofile-select <profile>:\r\n Applies a saved parameter profile (1 to 3) to the PID gains, reference limits, stick curves, gyro filter and airmode, without saving them\r\n",
+        CLIProfileSelect, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+
+/* Structure that defines the "profile-save" command line command. */
+static const CLI_Command_Definition_t profileSaveCommand = { (const int8_t * const ) "profile-save",
+        (const int8_t * const ) "\r\nprofile-save <profile>:\r\n Saves the current PID gains, reference limits, stick curves, gyro filter and airmode to a parameter profile (1 to 3, idle mode only)\r\n",
+        CLIProfileSave, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+
+/* Structure that defines the "profile-status" command line command. */
+static const CLI_Command_Definition_t profileStatusCommand = { (const int8_t * const ) "profile-status",
+        (const int8_t * const ) "\r\nprofile-status:\r\n Prints the active parameter profile and the saved ones\r\n",
+        CLIProfileStatus, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-gyro-filter" command line command. */
+static const CLI_Command_Definition_t setGyroFilterCommand = { (const int8_t * const ) "set-gyro-filter",
+        (const int8_t * const ) "\r\nset-gyro-filter <low-pass Hz> <notch 1 Hz> <notch 1 Q> <notch 2 Hz> <notch 2 Q>:\r\n Sets the gyro filter and saves it to flash, a frequency of 0 disables its stage\r\n",
+        CLISetGyroFilter, /* The function to run. */
+        5 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-sensor-timing" command line command. */
+static const CLI_Command_Definition_t setSensorTimingCommand = { (const int8_t * const ) "set-sensor-timing",
+        (const int8_t * const ) "\r\nset-sensor-timing <gyro|acc|mag> <data rate Hz> <low-pass Hz> <high-pass Hz>:\r\n Sets the data rate and on-chip filters of a sensor to the nearest supported ones and saves them to flash (idle mode only), a low-pass of 0 selects the widest and a high-pass of 0 disables it. The filters move to the new rate and the estimator is initialised again.\r\n",
+        CLISetSensorTiming, /* The function to run. */
+        4 /* Number of parameters expected */
+};
+
+/* Structure that defines the "reboot-bootloader" command line command. */
+static const CLI_Command_Definition_t rebootBootloaderCommand = { (const int8_t * const ) "reboot-bootloader",
+        (const int8_t * const ) "\r\nreboot-bootloader:\r\n Reboots to the USB DFU bootloader for a firmware update, e.g. with dfu-util -a 0 -s 0x08000000:leave -D fcb.bin (idle mode only, the settings are kept)\r\n",
+        CLIRebootBootloader, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "firmware-info" command line command. */
+static const CLI_Command_Definition_t firmwareInfoCommand = { (const int8_t * const ) "firmware-info",
+        (const int8_t * const ) "\r\nfirmware-info:\r\n Prints the firmware version and the size and CRC of its image\r\n",
+        CLIFirmwareInfo, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "watchdog-status" command line command. */
+static const CLI_Command_Definition_t watchdogStatusCommand = { (const int8_t * const ) "watchdog-status",
+        (const int8_t * const ) "\r\nwatchdog-status:\r\n Prints the task watchdog, the check-ins of the critical tasks and if the last reset was by the watchdog\r\n",
+        CLIWatchdogStatus, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "watchdog-clear" command line command. */
+static const CLI_Command_Definition_t watchdogClearCommand = { (const int8_t * const ) "watchdog-clear",
+        (const int8_t * const ) "\r\nwatchdog-clear:\r\n Clears a watchdog reset, which blocks arming, once its crash dump has been checked\r\n",
+        CLIWatchdogClear, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "sensor-health" command line command. */
+static const CLI_Command_Definition_t sensorHealthCommand = { (const int8_t * const ) "sensor-health",
+        (const int8_t * const ) "\r\nsensor-health:\r\n Prints the power-on self-test and the noise floor of each sensor, a sensor that has not passed blocks arming\r\n",
+        CLISensorHealth, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "led-status" command line command. */
+static const CLI_Command_Definition_t ledStatusCommand = { (const int8_t * const ) "led-status",
+        (const int8_t * const ) "\r\nled-status:\r\n Prints the active statuses shown by the LEDs, in priority order\r\n",
+        CLILedStatus, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "sensor-orientation" command line command. */
+static const CLI_Command_Definition_t sensorOrientationCommand = { (const int8_t * const ) "sensor-orientation",
+        (const int8_t * const ) "\r\nsensor-orientation:\r\n Prints the sensor board mounting angles, the level trim and the resulting rotation, set by the SENS_ and TRIM_ parameters\r\n",
+        CLISensorOrientation, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+#ifdef FCB_REDUNDANT_GYRO
+/* Structure that defines the "gyro-redundancy" command line command. */
+static const CLI_Command_Definition_t gyroRedundancyCommand = { (const int8_t * const ) "gyro-redundancy",
+        (const int8_t * const ) "\r\ngyro-redundancy:\r\n Prints the gyroscope voting: the gyroscope selected per axis, the failed tests (0x1 read, 0x2 stuck, 0x4 range) and the bias offset\r\n",
+        CLIGyroRedundancy, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+#endif
+
+/* Structure that defines the "set-uart-baudrate" command line command. */
+static const CLI_Command_Definition_t setUartBaudRateCommand = { (const int8_t * const ) "set-uart-baudrate",
+        (const int8_t * const ) "\r\nset-uart-baudrate <baud>:\r\n Sets the UART baud rate [9600, 2000000], applied when the queued data has been sent\r\n",
+        CLISetUartBaudRate, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+
+/* Structure that defines the "save-uart-settings" command line command. */
+static const CLI_Command_Definition_t saveUartSettingsCommand = { (const int8_t * const ) "save-uart-settings",
+        (const int8_t * const ) "\r\nsave-uart-settings:\r\n Saves the current UART baud rate to flash (idle mode only)\r\n",
+        CLISaveUartSettings, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "get-fms-link-status" command line command. */
+static const CLI_Command_Definition_t getFmsLinkStatusCommand = { (const int8_t * const ) "get-fms-link-status",
+        (const int8_t * const ) "\r\nget-fms-link-status:\r\n Prints the FMS setpoint link statistics and the latest setpoint\r\n",
+        CLIGetFmsLinkStatus, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-stabilized-mode" command line command. */
+static const CLI_Command_Definition_t setStabilizedModeCommand = { (const int8_t * const ) "set-stabilized-mode",
+        (const int8_t * const ) "\r\nset-stabilized-mode <mode>:\r\n Sets the mode of the receiver PID switch position, angle, rate or alt (altitude hold) (idle mode only)\r\n",
+        CLISetStabilizedMode, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+
+/* Structure that defines the "start-telemetry" command line command. */
+static const CLI_Command_Definition_t startTelemetryCommand = { (const int8_t * const ) "start-telemetry",
+        (const int8_t * const ) "\r\nstart-telemetry <msg> <rate> <dur>:\r\n Sends <msg> (sensor, state, ref, ctrl, motor, rc, summary, params or compact) frames once every <rate> ms for <dur> s\r\n",
+        CLIStartTelemetry, /* The function to run. */
+        3 /* Number of parameters expected */
+};
+
+/* Structure that defines the "stop-telemetry" command line command. */
+static const CLI_Command_Definition_t stopTelemetryCommand = { (const int8_t * const ) "stop-telemetry",
+        (const int8_t * const ) "\r\nstop-telemetry <msg>:\r\n Stops sending <msg> frames and printing, all stops every message\r\n",
+        CLIStopTelemetry, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-telemetry-window" command line command. */
+static const CLI_Command_Definition_t setTelemetryWindowCommand = { (const int8_t * const ) "set-telemetry-window",
+        (const int8_t * const ) "\r\nset-telemetry-window <signals> <samples>:\r\n Summarizes the gyro, acc, motor, ctrl, vibration, battery, pidscale or all signals over windows of <samples>, 0 stops, see start-telemetry summary\r\n",
+        CLISetTelemetryWindow, /* The function to run. */
+        2 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-telemetry-output" command line command. */
+static const CLI_Command_Definition_t setTelemetryOutputCommand = { (const int8_t * const ) "set-telemetry-output",
+        (const int8_t * const ) "\r\nset-telemetry-output <output>:\r\n Sends the telemetry frames to the USB com port (com) or the USB log endpoint (log)\r\n",
+        CLISetTelemetryOutput, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-compact-precision" command line command. */
+static const CLI_Command_Definition_t setCompactPrecisionCommand = { (const int8_t * const ) "set-compact-precision",
+        (const int8_t * const ) "\r\nset-compact-precision <fields> <decimals>:\r\n Quantizes the gyro, acc, mag, angle, rate, motor or all fields of the compact telemetry frames to <decimals>, from the next keyframe\r\n",
+        CLISetCompactPrecision, /* The function to run. */
+        2 /* Number of parameters expected */
+};
+
+/* Structure that defines the "get-params" command line command. */
+static const CLI_Command_Definition_t getParamsCommand = { (const int8_t * const ) "get-params",
+        (const int8_t * const ) "\r\nget-params:\r\n Prints the ID, name, value and range of the parameters in the parameter table\r\n",
+        CLIGetParams, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-param" command line command. */
+static const CLI_Command_Definition_t setParamCommand = { (const int8_t * const ) "set-param",
+        (const int8_t * const ) "\r\nset-param <name> <value>:\r\n Sets a parameter of the parameter table (see get-params for the names)\r\n",
+        CLISetParam, /* The function to run. */
+        2 /* Number of parameters expected */
+};
+
+/* Structure that defines the "save-params" command line command. */
+static const CLI_Command_Definition_t saveParamsCommand = { (const int8_t * const ) "save-params",
+        (const int8_t * const ) "\r\nsave-params:\r\n Saves all parameters of the parameter table to flash (idle mode only)\r\n",
+        CLISaveParams, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "get-blackbox-status" command line command. */
+static const CLI_Command_Definition_t getBlackboxStatusCommand = { (const int8_t * const ) "get-blackbox-status",
+        (const int8_t * const ) "\r\nget-blackbox-status:\r\n Prints the flight data log usage and the logged and dropped frames\r\n",
+        CLIGetBlackboxStatus, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "erase-blackbox" command line command. */
+static const CLI_Command_Definition_t eraseBlackboxCommand = { (const int8_t * const ) "erase-blackbox",
+        (const int8_t * const ) "\r\nerase-blackbox:\r\n Erases the flight data log (idle mode only)\r\n",
+        CLIEraseBlackbox, /* The function to run. */
+        0 /* Number of parameters expected */
+};
+
+/* Structure that defines the "set-log-sink" command line command. */
+static const CLI_Command_Definition_t setLogSinkCommand = { (const int8_t * const ) "set-log-sink",
+        (const int8_t * const ) "\r\nset-log-sink <usb|blackbox|all|none>:\r\n Sets where the log records are sent and prints the recorded and dropped records\r\n",
+        CLISetLogSink, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+
+#ifdef FCB_TRACE_RECORDER
+/* Structure that defines the "trace" command line command. */
+static const CLI_Command_Definition_t traceCommand = { (const int8_t * const ) "trace",
+        (const int8_t * const ) "\r\ntrace <snapshot|stream|stop|dump|status>:\r\n Starts the trace recorder in snapshot or stream mode, stops it, sends the snapshot over the USB log endpoint or prints its status\r\n",
+        CLITrace, /* The function to run. */
+        1 /* Number of parameters expected */
+};
+#endif
+
+/* PID controller names of the PID gains commands, indexed by PIDControllerIndex_TypeDef */
+static const char* pidControllerNames[PID_NBR_CONTROLLERS] = {
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+        "alt",
+#endif
+        "zvel", "roll", "pitch",
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+        "rollrate", "pitchrate",
+#endif
+        "yawrate" };
+
+static uint16_t dataOutLength = 0;
+static uint16_t outCnt = 0;
+
+/* The tables that do not fit the CLI output buffer are printed here first, and copied to it a chunk per call. The
+ * snapshots a table is printed from are kept with it. A command runs from its first to its last call under the CLI
+ * mutex, see TakeCLIMutex(), so they all share it. */
+static union {
+    char link[RECEIVER_LINK_MAX_STRING_SIZE];
+    char map[RECEIVER_MAP_MAX_STRING_SIZE];
+    char gyroTempComp[GYRO_TEMP_COMP_MAX_STRING_SIZE];
+    char accMagTempComp[ACCMAG_TEMP_COMP_MAX_STRING_SIZE];
+    char sensorRates[SENSOR_RATES_MAX_STRING_SIZE];
+    char vibration[VIBRATION_MAX_STRING_SIZE];
+#ifdef FCB_DYNAMIC_NOTCH
+    char dynamicNotch[DYNAMIC_NOTCH_MAX_STRING_SIZE];
+#endif
+#ifdef FCB_GPS
+    char gps[GPS_MAX_STRING_SIZE];
+#endif
+    char barometerStats[BAROMETER_STATS_MAX_STRING_SIZE];
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+    char motorTelemetry[MOTOR_TELEMETRY_MAX_STRING_SIZE];
+#endif
+#ifdef MOTOR_ESC_TELEMETRY
+    char escTelemetry[ESC_TELEMETRY_MAX_STRING_SIZE];
+#endif
+#ifdef FCB_CAN_BUS
+    char droneCanStatus[DRONECAN_STATUS_MAX_STRING_SIZE];
+#endif
+    char preArm[PREARM_CHECKS_MAX_STRING_SIZE];
+    char benchmark[FAST_MATH_BENCHMARK_MAX_STRING_SIZE];
+    char noise[SENSOR_NOISE_MAX_STRING_SIZE];
+    char latency[CONTROL_LATENCY_MAX_STRING_SIZE];
+#ifdef FCB_WAKE_LATENCY
+    char wakeLatency[WAKE_LATENCY_MAX_STRING_SIZE];
+#endif
+    char placement[CCM_RAM_MAX_STRING_SIZE];
+    char deferredWork[DEFERRED_WORK_MAX_STRING_SIZE];
+    char rateGroup[RATE_GROUP_MAX_STRING_SIZE];
+    char bootTime[BOOT_TIMING_MAX_STRING_SIZE];
+#ifdef FCB_CONTROL_EXECUTIVE
+    char controlExecutive[CONTROL_EXECUTIVE_MAX_STRING_SIZE];
+#endif
+#ifdef FCB_SENSOR_LOAD_TEST
+    char sensorLoadTest[SENSOR_LOAD_TEST_MAX_STRING_SIZE];
+#endif
+#ifdef FCB_WCET_TEST
+    char wcetTest[WCET_TEST_MAX_STRING_SIZE];
+#endif
+    char deadline[DEADLINE_STATS_MAX_STRING_SIZE];
+    char buffer[BUFFER_STATUS_MAX_STRING_SIZE];
+    struct {
+        char string[CRASH_DUMP_MAX_STRING_SIZE];
+        CrashDump_TypeDef dump;
+    } dump;
+    char probe[SCOPE_PROBE_MAX_STRING_SIZE];
+#ifdef FCB_ISR_MONITOR
+    struct {
+        char string[ISR_STATS_MAX_STRING_SIZE];
+        IsrSnapshot_TypeDef snapshot;
+    } isr;
+#endif
+#ifdef FCB_PROFILING
+    struct {
+        char string[PROFILE_MAX_STRING_SIZE];
+        ProfileSnapshot_TypeDef snapshot;
+    } profile;
+#endif
+#ifdef FCB_PERF_SNAPSHOT
+    char perf[PERF_SNAPSHOT_MAX_STRING_SIZE];
+#endif
+    char gains[PID_GAINS_MAX_STRING_SIZE];
+#ifdef PID_USE_GAIN_SCHEDULING
+    char schedule[PID_SCHEDULE_MAX_STRING_SIZE];
+#endif
+#ifdef PID_AUTOTUNE
+    char autotune[AUTOTUNE_MAX_STRING_SIZE];
+#endif
+    char stickCurves[STICK_CURVES_MAX_STRING_SIZE];
+    char thrustCurves[THRUST_CURVES_MAX_STRING_SIZE];
+#ifdef FCB_SD_CARD
+    char blackbox[BLACKBOX_STATUS_MAX_STRING_SIZE];
+#endif
+} cliPrintBuffer;
+
+extern RingBuffer_TypeDef USBCOMRxRingBuffer;
+extern xSemaphoreHandle USBCOMRxDataSem;
+
+xSemaphoreHandle CLIMutex;
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+ * @brief  Registers CLI commands
+ * @param  None
+ * @retval None
+ * @note   The "help" command lists one command per output chunk, which the session sends as the transport takes it,
+ *         so the number of commands is not limited by a TX buffer
+ */
+void RegisterCLICommands(void) {
+    /* Register all the command line commands defined immediately above. */
+
+    /* Sample CLI commands */
+    FreeRTOS_CLIRegisterCommand(&echoCommand);
+    FreeRTOS_CLIRegisterCommand(&echoDataCommand);
+
+    /* RC receiver CLI commands*/
+    FreeRTOS_CLIRegisterCommand(&startReceiverCalibrationCommand);
+    FreeRTOS_CLIRegisterCommand(&stopReceiverCalibrationCommand);
+    FreeRTOS_CLIRegisterCommand(&resetReceiverCalibrationCommand);
+    FreeRTOS_CLIRegisterCommand(&getReceiverCommand);
+    FreeRTOS_CLIRegisterCommand(&getReceiverCalibrationCommand);
+    FreeRTOS_CLIRegisterCommand(&startReceiverSamplingCommand);
+    FreeRTOS_CLIRegisterCommand(&stopReceiverSamplingCommand);
+    FreeRTOS_CLIRegisterCommand(&getReceiverLinkStatusCommand);
+    FreeRTOS_CLIRegisterCommand(&getReceiverMapCommand);
+    FreeRTOS_CLIRegisterCommand(&setReceiverChannelCommand);
+    FreeRTOS_CLIRegisterCommand(&setReceiverModeRangeCommand);
+    FreeRTOS_CLIRegisterCommand(&saveReceiverMapCommand);
+
+    /* Sensor CLI commands */
+    FreeRTOS_CLIRegisterCommand(&getSensorsCommand);
+    FreeRTOS_CLIRegisterCommand(&startSensorSamplingCommand);
+    FreeRTOS_CLIRegisterCommand(&stopSensorSamplingCommand);
+    FreeRTOS_CLIRegisterCommand(&startAccMagMtrCalibration);
+    FreeRTOS_CLIRegisterCommand(&getGyroTempCompensationCommand);
+    FreeRTOS_CLIRegisterCommand(&setGyroTempCompensationCommand);
+    FreeRTOS_CLIRegisterCommand(&getAccMagTempCompensationCommand);
+    FreeRTOS_CLIRegisterCommand(&setAccMagTempCompensationCommand);
+    FreeRTOS_CLIRegisterCommand(&getSensorRatesCommand);
+    FreeRTOS_CLIRegisterCommand(&resetSensorRatesCommand);
+    FreeRTOS_CLIRegisterCommand(&getVibrationCommand);
+    FreeRTOS_CLIRegisterCommand(&resetVibrationCommand);
+#ifdef FCB_DYNAMIC_NOTCH
+    FreeRTOS_CLIRegisterCommand(&getDynamicNotchCommand);
+    FreeRTOS_CLIRegisterCommand(&resetDynamicNotchCommand);
+#endif
+#ifdef FCB_GPS
+    FreeRTOS_CLIRegisterCommand(&getGpsCommand);
+    FreeRTOS_CLIRegisterCommand(&resetGpsCommand);
+#endif
+#ifdef FCB_BATTERY_MONITOR
+    FreeRTOS_CLIRegisterCommand(&getBatteryCommand);
+#endif
+    FreeRTOS_CLIRegisterCommand(&getBarometerCommand);
+    FreeRTOS_CLIRegisterCommand(&setBarometerCommand);
+    FreeRTOS_CLIRegisterCommand(&setBaroReferenceCommand);
+
+    /* Motors CLI commands */
+    FreeRTOS_CLIRegisterCommand(&getMotorsCommand);
+    FreeRTOS_CLIRegisterCommand(&startMotorSamplingCommand);
+    FreeRTOS_CLIRegisterCommand(&stopMotorSamplingCommand);
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+    FreeRTOS_CLIRegisterCommand(&getMotorTelemetryCommand);
+#endif
+#ifdef MOTOR_ESC_TELEMETRY
+    FreeRTOS_CLIRegisterCommand(&getEscTelemetryCommand);
+#endif
+#ifdef FCB_CAN_BUS
+    FreeRTOS_CLIRegisterCommand(&getDroneCanStatusCommand);
+#endif
+
+    /* System info CLI commands */
+    FreeRTOS_CLIRegisterCommand(&aboutCommand);
+    FreeRTOS_CLIRegisterCommand(&systimeCommand);
+    FreeRTOS_CLIRegisterCommand(&getTimeSyncCommand);
+    FreeRTOS_CLIRegisterCommand(&taskStatusCommand);
+    FreeRTOS_CLIRegisterCommand(&fastMathBenchmarkCommand);
+
+    /* Flight control CLI commands */
+    FreeRTOS_CLIRegisterCommand(&getFlightModeCommand);
+    FreeRTOS_CLIRegisterCommand(&getFlightModeLogCommand);
+    FreeRTOS_CLIRegisterCommand(&getPreArmCommand);
+    FreeRTOS_CLIRegisterCommand(&getRefSignalsCommand);
+    FreeRTOS_CLIRegisterCommand(&getCtrlSignalsCommand);
+    FreeRTOS_CLIRegisterCommand(&setMaxLimitReferenceSignalsCommand);
+    FreeRTOS_CLIRegisterCommand(&getMaxLimitReferenceSignalsCommand);
+    FreeRTOS_CLIRegisterCommand(&getStatesCommand);
+    FreeRTOS_CLIRegisterCommand(&startStateSamplingCommand);
+    FreeRTOS_CLIRegisterCommand(&stopStateSamplingCommand);
+    FreeRTOS_CLIRegisterCommand(&saveStateWarmStartCommand);
+    FreeRTOS_CLIRegisterCommand(&startSensorNoiseCommand);
+    FreeRTOS_CLIRegisterCommand(&getSensorNoiseCommand);
+    FreeRTOS_CLIRegisterCommand(&saveSensorNoiseCommand);
+    FreeRTOS_CLIRegisterCommand(&setMotorMixerCommand);
+    FreeRTOS_CLIRegisterCommand(&getMixerAllocationCommand);
+    FreeRTOS_CLIRegisterCommand(&setMixerAllocationCommand);
+    FreeRTOS_CLIRegisterCommand(&saveMixerAllocationCommand);
+    FreeRTOS_CLIRegisterCommand(&getControlLatencyCommand);
+    FreeRTOS_CLIRegisterCommand(&resetControlLatencyCommand);
+#ifdef FCB_WAKE_LATENCY
+    FreeRTOS_CLIRegisterCommand(&getWakeLatencyCommand);
+    FreeRTOS_CLIRegisterCommand(&resetWakeLatencyCommand);
+#endif
+    FreeRTOS_CLIRegisterCommand(&getMemoryPlacementCommand);
+    FreeRTOS_CLIRegisterCommand(&getDeferredWorkCommand);
+    FreeRTOS_CLIRegisterCommand(&resetDeferredWorkCommand);
+    FreeRTOS_CLIRegisterCommand(&getRateGroupsCommand);
+    FreeRTOS_CLIRegisterCommand(&resetRateGroupsCommand);
+    FreeRTOS_CLIRegisterCommand(&getBootTimeCommand);
+#ifdef FCB_CONTROL_EXECUTIVE
+    FreeRTOS_CLIRegisterCommand(&getControlExecutiveCommand);
+    FreeRTOS_CLIRegisterCommand(&resetControlExecutiveCommand);
+#endif
+#ifdef FCB_SENSOR_LOAD_TEST
+    FreeRTOS_CLIRegisterCommand(&startSensorLoadTestCommand);
+    FreeRTOS_CLIRegisterCommand(&stopSensorLoadTestCommand);
+    FreeRTOS_CLIRegisterCommand(&getSensorLoadTestCommand);
+#endif
+#ifdef FCB_WCET_TEST
+    FreeRTOS_CLIRegisterCommand(&startWcetTestCommand);
+    FreeRTOS_CLIRegisterCommand(&stopWcetTestCommand);
+    FreeRTOS_CLIRegisterCommand(&getWcetTestCommand);
+#endif
+    FreeRTOS_CLIRegisterCommand(&getDeadlineStatsCommand);
+    FreeRTOS_CLIRegisterCommand(&resetDeadlineStatsCommand);
+    FreeRTOS_CLIRegisterCommand(&bufferStatusCommand);
+    FreeRTOS_CLIRegisterCommand(&crashDumpCommand);
+    FreeRTOS_CLIRegisterCommand(&getEventJournalCommand);
+    FreeRTOS_CLIRegisterCommand(&clearEventJournalCommand);
+    FreeRTOS_CLIRegisterCommand(&getScopeProbesCommand);
+    FreeRTOS_CLIRegisterCommand(&setScopeProbeCommand);
+#ifdef FCB_ISR_MONITOR
+    FreeRTOS_CLIRegisterCommand(&getIsrStatsCommand);
+    FreeRTOS_CLIRegisterCommand(&resetIsrStatsCommand);
+#endif
+#ifdef FCB_PROFILING
+    FreeRTOS_CLIRegisterCommand(&profileCommand);
+#endif
+#ifdef FCB_PERF_SNAPSHOT
+    FreeRTOS_CLIRegisterCommand(&getPerfSnapshotCommand);
+    FreeRTOS_CLIRegisterCommand(&setPerfPeriodCommand);
+    FreeRTOS_CLIRegisterCommand(&resetPerfSnapshotCommand);
+    FreeRTOS_CLIRegisterCommand(&savePerfBaselineCommand);
+#endif
+    FreeRTOS_CLIRegisterCommand(&getPIDGainsCommand);
+    FreeRTOS_CLIRegisterCommand(&setPIDGainsCommand);
+    FreeRTOS_CLIRegisterCommand(&savePIDGainsCommand);
+    FreeRTOS_CLIRegisterCommand(&setPIDFeedForwardCommand);
+#ifdef PID_USE_GAIN_SCHEDULING
+    FreeRTOS_CLIRegisterCommand(&getPIDScheduleCommand);
+    FreeRTOS_CLIRegisterCommand(&setPIDScheduleCommand);
+    FreeRTOS_CLIRegisterCommand(&savePIDScheduleCommand);
+#endif
+#ifdef PID_AUTOTUNE
+    FreeRTOS_CLIRegisterCommand(&autotuneCommand);
+#endif
+#ifdef FCB_SYSTEM_IDENTIFICATION
+    FreeRTOS_CLIRegisterCommand(&sysIdStartCommand);
+    FreeRTOS_CLIRegisterCommand(&sysIdStopCommand);
+    FreeRTOS_CLIRegisterCommand(&sysIdStatusCommand);
+#endif
+    FreeRTOS_CLIRegisterCommand(&getStickCurvesCommand);
+    FreeRTOS_CLIRegisterCommand(&setStickCurveCommand);
+    FreeRTOS_CLIRegisterCommand(&saveStickCurvesCommand);
+    FreeRTOS_CLIRegisterCommand(&getThrustCurvesCommand);
+    FreeRTOS_CLIRegisterCommand(&setThrustCurveCommand);
+    FreeRTOS_CLIRegisterCommand(&saveThrustCurvesCommand);
+    FreeRTOS_CLIRegisterCommand(&thrustTestCommand);
+    FreeRTOS_CLIRegisterCommand(&thrustPointCommand);
+    FreeRTOS_CLIRegisterCommand(&fitThrustCurveCommand);
+    FreeRTOS_CLIRegisterCommand(&motorTestUnlockCommand);
+    FreeRTOS_CLIRegisterCommand(&motorTestLockCommand);
+    FreeRTOS_CLIRegisterCommand(&motorTestCommand);
+    FreeRTOS_CLIRegisterCommand(&motorTestStatusCommand);
+    FreeRTOS_CLIRegisterCommand(&escCalibrateCommand);
+    FreeRTOS_CLIRegisterCommand(&getEscOutputsCommand);
+    FreeRTOS_CLIRegisterCommand(&setEscOutputsCommand);
+    FreeRTOS_CLIRegisterCommand(&saveEscOutputsCommand);
+#ifdef FCB_CRASH_DETECTION
+    FreeRTOS_CLIRegisterCommand(&getCrashDetectionCommand);
+    FreeRTOS_CLIRegisterCommand(&setCrashDetectionCommand);
+    FreeRTOS_CLIRegisterCommand(&saveCrashDetectionCommand);
+#endif
+#ifdef FCB_MOTOR_FAILURE_DETECTION
+    FreeRTOS_CLIRegisterCommand(&getMotorFailureCommand);
+    FreeRTOS_CLIRegisterCommand(&setMotorFailureCommand);
+    FreeRTOS_CLIRegisterCommand(&saveMotorFailureCommand);
+#endif
+#ifdef FCB_USB_MASS_STORAGE
+    FreeRTOS_CLIRegisterCommand(&getUSBMscCommand);
+    FreeRTOS_CLIRegisterCommand(&setUSBMscCommand);
+#endif
+    FreeRTOS_CLIRegisterCommand(&profileSelectCommand);
+    FreeRTOS_CLIRegisterCommand(&profileSaveCommand);
+    FreeRTOS_CLIRegisterCommand(&profileStatusCommand);
+    FreeRTOS_CLIRegisterCommand(&setGyroFilterCommand);
+    FreeRTOS_CLIRegisterCommand(&setSensorTimingCommand);
+    FreeRTOS_CLIRegisterCommand(&rebootBootloaderCommand);
+    FreeRTOS_CLIRegisterCommand(&firmwareInfoCommand);
+    FreeRTOS_CLIRegisterCommand(&watchdogStatusCommand);
+    FreeRTOS_CLIRegisterCommand(&watchdogClearCommand);
+    FreeRTOS_CLIRegisterCommand(&sensorHealthCommand);
+    FreeRTOS_CLIRegisterCommand(&ledStatusCommand);
+    FreeRTOS_CLIRegisterCommand(&sensorOrientationCommand);
+#ifdef FCB_REDUNDANT_GYRO
+    FreeRTOS_CLIRegisterCommand(&gyroRedundancyCommand);
+#endif
+    FreeRTOS_CLIRegisterCommand(&setUartBaudRateCommand);
+    FreeRTOS_CLIRegisterCommand(&saveUartSettingsCommand);
+    FreeRTOS_CLIRegisterCommand(&getFmsLinkStatusCommand);
+    FreeRTOS_CLIRegisterCommand(&setStabilizedModeCommand);
+
+    /* Telemetry CLI commands */
+    FreeRTOS_CLIRegisterCommand(&startTelemetryCommand);
+    FreeRTOS_CLIRegisterCommand(&stopTelemetryCommand);
+    FreeRTOS_CLIRegisterCommand(&setTelemetryWindowCommand);
+    FreeRTOS_CLIRegisterCommand(&setTelemetryOutputCommand);
+    FreeRTOS_CLIRegisterCommand(&setCompactPrecisionCommand);
+
+    /* Parameter table CLI commands */
+    FreeRTOS_CLIRegisterCommand(&getParamsCommand);
+    FreeRTOS_CLIRegisterCommand(&setParamCommand);
+    FreeRTOS_CLIRegisterCommand(&saveParamsCommand);
+
+    /* Blackbox CLI commands */
+    FreeRTOS_CLIRegisterCommand(&getBlackboxStatusCommand);
+    FreeRTOS_CLIRegisterCommand(&eraseBlackboxCommand);
+
+    /* Log CLI commands */
+    FreeRTOS_CLIRegisterCommand(&setLogSinkCommand);
+#ifdef FCB_TRACE_RECORDER
+    FreeRTOS_CLIRegisterCommand(&traceCommand);
+#endif
+}
+
+/**
+ * @brief  Creates semaphores used for accessing CLI
+ * @param  cliIn : Pointer to CLI input buffer
+ * @param  cliOut : Pointer to CLI output buffer
+ * @param  len : Pointer to data output length (set for data, if zero the output is string formatted)
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+portBASE_TYPE CLIParser(uint8_t* cliIn, uint8_t* cliOut, uint16_t* len) {
+    portBASE_TYPE retval;
+
+    dataOutLength = 0;
+
+    retval = FreeRTOS_CLIProcessCommand((int8_t*) cliIn, /* The command string.*/
+            (int8_t*) cliOut, /* The output buffer. */
+            MAX_CLI_OUTPUT_SIZE /* The size of the output buffer. */
+    );
+
+    (*len) = dataOutLength;
+    return retval;
+}
+
+/**
+ * @brief  Creates semaphores used for accessing CLI
+ * @param  None
+ * @retval None
+ */
+void CreateCLISemaphores(void) {
+    CLIMutex = xSemaphoreCreateMutex();
+    if (CLIMutex == NULL) {
+        ErrorHandler();
+    }
+    TRACE_OBJECT_NAME(CLIMutex, "mCli");
+}
+
+/**
+ * @brief  Takes the CLI mutex
+ * @param  None
+ * @retval None
+ */
+uint32_t TakeCLIMutex(void) {
+    return xSemaphoreTake(CLIMutex, portMAX_DELAY);
+}
+
+/**
+ * @brief  Gives the CLI mutex
+ * @param  None
+ * @retval None
+ */
+void GiveCLIMutex(void) {
+    xSemaphoreGive(CLIMutex);
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief  Implements the CLI command to echo one parameter
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIEcho(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength, xReturn;
+    static portBASE_TYPE lParameterNumber = 0;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    if (lParameterNumber == 0) {
+        /* The first time the function is called after the command has been
+		 entered just a header string is returned. */
+        memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+        strncpy((char*) pcWriteBuffer, "Parameter received:\r\n", xWriteBufferLen);
+    } else {
+        /* Obtain the parameter string */
+        pcParameter = (int8_t*) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
+                lParameterNumber, /* Return the next parameter. */
+                &xParameterStringLength /* Store the parameter string length. */
+        );
+
+        /* Sanity check something was returned. */
+        configASSERT(pcParameter);
+
+        /* Return the parameter string. */
+        memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+        strncpy((char*) pcWriteBuffer, (const char*) pcParameter, xParameterStringLength);
+        strncat((char*) pcWriteBuffer, "\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+    }
+
+    /* Update return value and parameter index */
+    if (lParameterNumber == echoCommand.cExpectedNumberOfParameters) {
+        /* If this is the last parameter then there are no more strings to return after this one. */
+        xReturn = pdFALSE;
+        lParameterNumber = 0;
+    } else {
+        /* There are more parameters to return after this one. */
+        xReturn = pdTRUE;
+        lParameterNumber++;
+    }
+
+    return xReturn;
+}
+
+/**
+ * @brief  Implements the CLI command to echo a specific amount of data (size specified by parameter)
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIEchoData(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    int8_t *pcParameter;
+    portBASE_TYPE xParameterStringLength, xReturn;
+    static portBASE_TYPE lParameterNumber = 0;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    if (lParameterNumber == 0) {
+        /* The first time the function is called after the command has been
+		 entered just a header string is returned. */
+        strncpy((char*) pcWriteBuffer, "Received data:\r\n", xWriteBufferLen);
+    } else if (lParameterNumber == 1) {
+        /* Obtain the parameter string. */
+        pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
+                lParameterNumber, /* Return the next parameter. */
+                &xParameterStringLength /* Store the parameter string length. */
+        );
+
+        /* Sanity check something was returned. */
+        configASSERT(pcParameter);
+
+        // Convert pcParameter string to equivalent int to get the length of the following data
+        int dataLength = atoi((char*) pcParameter);
+
+        /* Check that data length is a positive integer and within buffer bounds */
+        if (!IS_POS(dataLength))
+            return pdFALSE;
+
+        memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+        int previousRxBufferCount = -1; // Init to -1 so that while loop is iterated at least once
+
+        /* Check that new data is being received */
+        while (previousRxBufferCount != RingBufferGetUsed(&USBCOMRxRingBuffer)) {
+            if (dataLength <= RingBufferGetUsed(&USBCOMRxRingBuffer)) {
+                /* Read out the data, keeping the output null terminated. Data left in the buffer is likely the next
+                 * command, which the USB RX work item handles when this one is done. */
+                RingBufferGetData(&USBCOMRxRingBuffer, (uint8_t*) pcWriteBuffer,
+                        ((size_t) dataLength < xWriteBufferLen) ? (size_t) dataLength : xWriteBufferLen - 1);
+
+                previousRxBufferCount = RingBufferGetUsed(&USBCOMRxRingBuffer); // Set this to exit while loop
+            } else {
+                previousRxBufferCount = RingBufferGetUsed(&USBCOMRxRingBuffer);
+                /*/ Pend on USBComRxDataSem for MAX_DATA_TRANSFER_DELAY while waiting for data to enter RX buffer */
+                if (pdPASS != xSemaphoreTake(USBCOMRxDataSem, MAX_DATA_TRANSFER_DELAY)) {
+                    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+                    strncpy((char*) pcWriteBuffer, "Data transmission timed out.\r\n", xWriteBufferLen);
+                }
+            }
+        }
+    } else {
+        /* Return new line */
+        memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+        strncpy((char*) pcWriteBuffer, "\r\n", xWriteBufferLen);
+    }
+
+    /* Update return value and parameter index */
+    if (lParameterNumber == echoDataCommand.cExpectedNumberOfParameters + 1) // Added +1 to output \r\n
+    {
+        /* If this is the last of the parameters then there are no more strings to return after this one. */
+        xReturn = pdFALSE;
+        lParameterNumber = 0;
+    } else {
+        /* There are more parameters/data to return after this one. */
+        xReturn = pdTRUE;
+        lParameterNumber++;
+    }
+
+    return xReturn;
+}
+
+/**
+ * @brief  Implements the CLI command to start receiver calibration
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIStartReceiverCalibration(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    /* Start the receiver calibration procedure */
+    if (StartReceiverCalibration())
+        strncpy((char*) pcWriteBuffer,
+                "RC receiver calibration started. Please saturate all RC transmitter control sticks and toggle switches.\r\n",
+                xWriteBufferLen);
+    else
+        strncpy((char*) pcWriteBuffer, "RC receiver calibration could not be started.\r\n", xWriteBufferLen);
+
+    /* Return false to indicate command activity finished */
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements the CLI command to stop receiver calibration
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIStopReceiverCalibration(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Stop the receiver calibration procedure */
+    ReceiverErrorStatus rcCalStatus = StopReceiverCalibration();
+    strncpy((char*) pcWriteBuffer, "RC receiver calibration stopped\r\n", xWriteBufferLen);
+    if (rcCalStatus)
+        strncat((char*) pcWriteBuffer, "RC receiver calibration successful\r\n",
+                xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+    else
+        strncat((char*) pcWriteBuffer, "RC receiver calibration failed\r\n",
+                xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+
+    /* Return false to indicate command activity finished */
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements the CLI command to reset receiver calibration to default values
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIResetReceiverCalibration(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Resets calibration values to default */
+    ResetReceiverCalibrationValues();
+    strncpy((char*) pcWriteBuffer, "RC receiver calibration set to default values.\r\n", xWriteBufferLen);
+
+    /* Return false to indicate command activity finished */
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements the CLI command to print receiver values with or without serialization
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetReceiver(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString) {
+    int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    portBASE_TYPE lParameterNumber = 0;
+
+    bool protoStatus;
+    ProtoFrameStream_TypeDef protoFrame;
+    ReceiverSignalValuesProto receiverSignalsProto;
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+    lParameterNumber++;
+
+    /* Obtain the parameter string. */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
+            lParameterNumber, /* Return the next parameter. */
+            &xParameterStringLength /* Store the parameter string length. */
+    );
+
+    /* Sanity check something was returned. */
+    configASSERT(pcParameter);
+
+    /* Get the current receiver values */
+    switch (pcParameter[0]) {
+    case 'n':
+        if(outCnt == 0) {
+            strncpy((char*) pcWriteBuffer, "Receiver\nStatus: ", xWriteBufferLen);
+            if (IsReceiverActive()) {
+                strncat((char*) pcWriteBuffer, "ACTIVE\n", xWriteBufferLen - strlen((char*)pcWriteBuffer) - 1);
+            }
+            else {
+                strncat((char*) pcWriteBuffer, "INACTIVE\n", xWriteBufferLen - strlen((char*)pcWriteBuffer) - 1);
+            }
+            outCnt = 2;
+        }
+        else {
+            snprintf((char*) pcWriteBuffer, xWriteBufferLen,
+                    "Throttle: %d\nAileron: %d\nElevator: %d\nRudder: %d\nGear: %d\nAux1: %d\n\r\n",
+                    GetThrottleReceiverChannel(), GetAileronReceiverChannel(), GetElevatorReceiverChannel(),
+                    GetRudderReceiverChannel(), GetGearReceiverChannel(), GetAux1ReceiverChannel());
+        }
+
+        break;
+    case 'p':
+        receiverSignalsProto.has_is_active = true;
+        receiverSignalsProto.has_throttle = true;
+        receiverSignalsProto.has_aileron = true;
+        receiverSignalsProto.has_elevator = true;
+        receiverSignalsProto.has_rudder = true;
+        receiverSignalsProto.has_gear = true;
+        receiverSignalsProto.has_aux1 = true;
+        receiverSignalsProto.is_active = IsReceiverActive();
+        receiverSignalsProto.throttle = GetThrottleReceiverChannel();
+        receiverSignalsProto.aileron = GetAileronReceiverChannel();
+        receiverSignalsProto.elevator = GetElevatorReceiverChannel();
+        receiverSignalsProto.rudder = GetRudderReceiverChannel();
+        receiverSignalsProto.gear = GetGearReceiverChannel();
+        receiverSignalsProto.aux1 = GetAux1ReceiverChannel();
+
+        /* Encode the data with protocol buffer straight into its frame in the output buffer */
+        ProtoFrameBegin(&protoFrame, (uint8_t*) pcWriteBuffer, xWriteBufferLen, RC_VALUES_MSG_ENUM);
+        protoStatus = pb_encode(&protoFrame.stream, ReceiverSignalValuesProto_fields, &receiverSignalsProto);
+        dataOutLength = ProtoFrameEnd(&protoFrame);
+
+        if (!protoStatus || 0 == dataOutLength) {
+            ErrorHandler();
+        }
+
+        break;
+    default:
+        strncpy((char*) pcWriteBuffer, "Invalid parameter\r\n", xWriteBufferLen);
+        break;
+    }
+
+    if(outCnt > 0) {
+        outCnt--;
+    }
+
+    if(outCnt == 0) {
+        return pdFALSE; /* Return false to indicate command activity finished */
+    } else {
+        return pdTRUE; /* Return true to indicate more command activity to follow */
+    }
+}
+
+/**
+ * @brief  Implements the CLI command to print receiver calibration values
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetReceiverCalibration(int8_t *pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t *pcCommandString) {
+
+    static uint8_t currentChannelPrint = 0;
+
+    /* Remove compile time warnings about unused parameters, and check the
+	 write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    /* Get the current receiver values */
+    switch (currentChannelPrint) {
+    case 0:
+        strncpy((char*) pcWriteBuffer,
+                "Receiver channel calibration values:\r\nNOTE: Values are specified in timer ticks.\r\n",
+                xWriteBufferLen);
+        break;
+    case 1:
+        snprintf((char*) pcWriteBuffer, xWriteBufferLen,
+                "Throttle Max: %u\nThrottle Mid: %u\nThrottle Min: %u\nAileron Max: %u\nAileron Mid: %u\nAileron Min: %u\nElevator Max: %u\nElevator Mid: %u\nElevator Min: %u\nRudder Max: %u\nRudder Mid: %u\nRudder Min: %u\n",
+                GetThrottleReceiverCalibrationMaxValue(), GetThrottleReceiverCalibrationMidValue(), GetThrottleReceiverCalibrationMinValue(),
+                GetAileronReceiverCalibrationMaxValue(), GetAileronReceiverCalibrationMidValue(), GetAileronReceiverCalibrationMinValue(),
+                GetElevatorReceiverCalibrationMaxValue(), GetElevatorReceiverCalibrationMidValue(), GetElevatorReceiverCalibrationMinValue(),
+                GetRudderReceiverCalibrationMaxValue(), GetRudderReceiverCalibrationMidValue(), GetRudderReceiverCalibrationMinValue());
+        break;
+    case 2:
+        snprintf((char*) pcWriteBuffer, xWriteBufferLen,
+                "Gear Max: %u\nGear Mid: %u\nGear Min: %u\nAux1 Max: %u\nAux1 Mid: %u\nAux1 Min: %u\n\r\n",
+                GetGearReceiverCalibrationMaxValue(), GetGearReceiverCalibrationMidValue(), GetGearReceiverCalibrationMinValue(),
+                GetAux1ReceiverCalibrationMaxValue(), GetAux1ReceiverCalibrationMidValue(), GetAux1ReceiverCalibrationMinValue());
+        break;
+    default:
+        // memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+        strncpy((char*) pcWriteBuffer, "\r\n", xWriteBufferLen);
+        /* Reset receiver print iteration number*/
+        currentChannelPrint = 0;
+        /* Return false to indicate command activity finished */
+        return pdFALSE;
+    }
+
+    currentChannelPrint++;
+    /* Return true to indicate command activity not yet completed */
+    return pdTRUE;
+}
+
+/**
+ * @brief  Starts receiver sampling for a specified sample time and duration
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIStartReceiverSampling(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString) {
+    int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength, xReturn;
+    static portBASE_TYPE lParameterNumber = 0;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    if (lParameterNumber == 0) {
+        /* The first time the function is called after the command has been entered just a header string is returned. */
+        strncpy((char*) pcWriteBuffer, "Starting print sampling of receiver values\r\n", xWriteBufferLen);
+    } else {
+        uint16_t receiverSampleTime;
+        uint16_t receiverSampleDuration;
+
+        /* Obtain the parameter string */
+        pcParameter = (int8_t*) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
+                lParameterNumber, /* Return the next parameter. */
+                &xParameterStringLength /* Store the parameter string length. */
+        );
+
+        /* Sanity check something was returned. */
+        configASSERT(pcParameter);
+
+        strncpy((char*) pcWriteBuffer, "Sample time (ms): ", xWriteBufferLen);
+
+        size_t paramMaxSize;
+        if ((unsigned long) xParameterStringLength > xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1)
+            paramMaxSize = xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1;
+        else
+            paramMaxSize = xParameterStringLength;
+
+        strncat((char*) pcWriteBuffer, (char*) pcParameter, paramMaxSize);
+        strncat((char*) pcWriteBuffer, "\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+
+        receiverSampleTime = atoi((char*) pcParameter);
+
+        lParameterNumber++;
+
+        pcParameter = (int8_t*) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
+                lParameterNumber, /* Return the next parameter. */
+                &xParameterStringLength /* Store the parameter string length. */);
+
+        /* Sanity check something was returned. */
+        configASSERT(pcParameter);
+
+        strncat((char*) pcWriteBuffer, "Duration (s): ", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+
+        if ((unsigned long) xParameterStringLength > xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1)
+            paramMaxSize = xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1;
+        else
+            paramMaxSize = xParameterStringLength;
+
+        strncat((char*) pcWriteBuffer, (char*) pcParameter, paramMaxSize);
+        strncat((char*) pcWriteBuffer, "\n\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+
+        receiverSampleDuration = atoi((char*) pcParameter);
+
+        StartTelemetry(RC_VALUES_MSG_ENUM, NO_SERIALIZATION, receiverSampleTime, receiverSampleDuration);
+    }
+
+    /* Update return value and parameter index */
+    if (lParameterNumber == startReceiverSamplingCommand.cExpectedNumberOfParameters) {
+        /* If this is the last parameter then there are no more strings to return after this one. */
+        xReturn = pdFALSE;
+        lParameterNumber = 0;
+    } else {
+        /* There are more parameters to return after this one. */
+        xReturn = pdTRUE;
+        lParameterNumber++;
+    }
+
+    return xReturn;
+}
+
+/**
+ * @brief  Stops printing of receiver sample values
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIStopReceiverSampling(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the
+	 write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    strncpy((char*) pcWriteBuffer, "Stopping printing of receiver sample values...\r\n", xWriteBufferLen);
+
+    /* Stop printing receiver values */
+    StopTelemetry(RC_VALUES_MSG_ENUM);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print the receiver link quality
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetReceiverLinkStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString) {
+    static const char* channelNames[RECEIVER_SNAPSHOT_CHANNELS_NBR] = { "Throttle", "Aileron", "Elevator", "Rudder",
+            "Gear", "Aux1" };
+    char* linkString = cliPrintBuffer.link; // Table does not fit in the CLI output buffer
+    Receiver_LinkStats_TypeDef stats;
+    RcSmoothingStatusType smoothing;
+    float32_t smoothingValues[3];
+    size_t length;
+    uint8_t i;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    GetReceiverLinkStats(&stats);
+    length = snprintf(linkString, RECEIVER_LINK_MAX_STRING_SIZE,
+            "Failsafe: %s\r\nFailsafe events: %lu\r\nFrames: %lu\r\nChannel\t\tRate [Hz]\tPulses\t\tDropouts\r\n",
+            stats.IsFailsafe ? "yes" : "no", stats.FailsafeCount, stats.FrameCount);
+    for (i = 0; i < RECEIVER_SNAPSHOT_CHANNELS_NBR && length < RECEIVER_LINK_MAX_STRING_SIZE; i++) {
+        length += snprintf(linkString + length, RECEIVER_LINK_MAX_STRING_SIZE - length, "%s\t%s%u\t\t%lu\t\t%lu\r\n",
+                channelNames[i], (strlen(channelNames[i]) < 8) ? "\t" : "", stats.Channels[i].PulseRate,
+                stats.Channels[i].PulseCount, stats.Channels[i].DropoutCount);
+    }
+
+    GetRcSmoothingStatus(&smoothing);
+    smoothingValues[0] = smoothing.frameRateHz;
+    smoothingValues[1] = smoothing.cutoffHz;
+    smoothingValues[2] = smoothing.latencyMs;
+    if (length < RECEIVER_LINK_MAX_STRING_SIZE) {
+        length += snprintf(linkString + length, RECEIVER_LINK_MAX_STRING_SIZE - length, "RC smoothing: %s\r\n",
+                smoothing.isEnabled ? "enabled" : "disabled");
+    }
+    if (length < RECEIVER_LINK_MAX_STRING_SIZE) {
+        FormatFixedList(linkString + length, RECEIVER_LINK_MAX_STRING_SIZE - length,
+                "Frame rate [Hz]: %1.1f\r\nCutoff [Hz]: %1.1f\r\nAdded latency [ms]: %1.1f\r\n", smoothingValues, 3);
+    }
+    ComSessionSendString(linkString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print the receiver channel map and mode ranges
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetReceiverMap(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* mapString = cliPrintBuffer.map; // Table does not fit in the CLI output buffer
+    Receiver_ChannelMap_TypeDef channelMap;
+    const Receiver_ModeRange_TypeDef* range;
+    size_t length;
+    uint8_t i;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    GetReceiverChannelMap(&channelMap);
+    length = snprintf(mapString, RECEIVER_MAP_MAX_STRING_SIZE, "Channel\t\tInput\tReversed\r\n");
+    for (i = 0; i < RECEIVER_SNAPSHOT_CHANNELS_NBR && length < RECEIVER_MAP_MAX_STRING_SIZE; i++) {
+        length += snprintf(mapString + length, RECEIVER_MAP_MAX_STRING_SIZE - length, "%s\t%s%u\t%s\r\n",
+                receiverChannelNames[i], (strlen(receiverChannelNames[i]) < 8) ? "\t" : "", channelMap.Inputs[i],
+                (channelMap.ReversedChannels & (1 << i)) ? "yes" : "no");
+    }
+
+    if (length < RECEIVER_MAP_MAX_STRING_SIZE) {
+        length += snprintf(mapString + length, RECEIVER_MAP_MAX_STRING_SIZE - length,
+                "Mode range\tChannel\t\tRange [%%]\tMode\r\n");
+    }
+    for (i = 0; i < RECEIVER_MODE_RANGES_NBR && length < RECEIVER_MAP_MAX_STRING_SIZE; i++) {
+        range = &channelMap.ModeRanges[i];
+        if (RECEIVER_MODE_NONE == range->Mode) {
+            length += snprintf(mapString + length, RECEIVER_MAP_MAX_STRING_SIZE - length, "%u\t\t-\t\t-\t\tnone\r\n", i);
+        } else {
+            length += snprintf(mapString + length, RECEIVER_MAP_MAX_STRING_SIZE - length,
+                    "%u\t\t%s\t%s%d..%d\t\t%s\r\n", i, receiverChannelNames[range->Channel],
+                    (strlen(receiverChannelNames[range->Channel]) < 8) ? "\t" : "", range->MinPercent,
+                    range->MaxPercent, GetReceiverModeName((ReceiverModeType) range->Mode));
+        }
+    }
+
+    if (length < RECEIVER_MAP_MAX_STRING_SIZE) {
+        snprintf(mapString + length, RECEIVER_MAP_MAX_STRING_SIZE - length, "Selected mode: %s\r\n",
+                GetReceiverModeName(GetReceiverMode()));
+    }
+    ComSessionSendString(mapString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to map a receiver channel to an input and set its reversal
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetReceiverChannel(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    Receiver_ChannelMap_TypeDef channelMap;
+    uint8_t channel;
+    long input;
+    long reversed;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    channel = ParseReceiverChannelName(pcParameter, xParameterStringLength);
+    input = strtol((char*) FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength), NULL, 10);
+    reversed = strtol((char*) FreeRTOS_CLIGetParameter(pcCommandString, 3, &xParameterStringLength), NULL, 10);
+
+    GetReceiverChannelMap(&channelMap);
+    if (channel >= RECEIVER_SNAPSHOT_CHANNELS_NBR || input < 0 || input > UINT8_MAX || reversed < 0 || reversed > 1) {
+        strncpy((char*) pcWriteBuffer, "Invalid receiver channel, input or reversal\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    channelMap.Inputs[channel] = (uint8_t) input;
+    if (reversed)
+        channelMap.ReversedChannels |= (1 << channel);
+    else
+        channelMap.ReversedChannels &= ~(1 << channel);
+
+    if (!SetReceiverChannelMap(&channelMap)) {
+        strncpy((char*) pcWriteBuffer, "Invalid input or UAV not in idle mode\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Receiver channel %s set to input %u%s\r\n",
+            receiverChannelNames[channel], channelMap.Inputs[channel], reversed ? ", reversed" : "");
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to set one range of the receiver mode range table
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetReceiverModeRange(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    Receiver_ChannelMap_TypeDef channelMap;
+    Receiver_ModeRange_TypeDef range;
+    long rangeIdx;
+    long minPercent;
+    long maxPercent;
+    uint8_t mode;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    rangeIdx = strtol((char*) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength), NULL, 10);
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength);
+    range.Channel = ParseReceiverChannelName(pcParameter, xParameterStringLength);
+    minPercent = strtol((char*) FreeRTOS_CLIGetParameter(pcCommandString, 3, &xParameterStringLength), NULL, 10);
+    maxPercent = strtol((char*) FreeRTOS_CLIGetParameter(pcCommandString, 4, &xParameterStringLength), NULL, 10);
+
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 5, &xParameterStringLength);
+    for (mode = 0; mode < RECEIVER_MODE_NBR; mode++) {
+        const char* name = GetReceiverModeName((ReceiverModeType) mode);
+
+        if (strlen(name) == (size_t) xParameterStringLength
+                && 0 == strncmp((const char*) pcParameter, name, xParameterStringLength)) {
+            break;
+        }
+    }
+
+    if (rangeIdx < 0 || rangeIdx >= RECEIVER_MODE_RANGES_NBR || range.Channel >= RECEIVER_SNAPSHOT_CHANNELS_NBR
+            || minPercent < -100 || maxPercent > 100 || minPercent > maxPercent || mode >= RECEIVER_MODE_NBR) {
+        strncpy((char*) pcWriteBuffer, "Invalid mode range, channel, limits or mode\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    range.Mode = mode;
+    range.MinPercent = (int8_t) minPercent;
+    range.MaxPercent = (int8_t) maxPercent;
+
+    GetReceiverChannelMap(&channelMap);
+    channelMap.ModeRanges[rangeIdx] = range;
+    if (!SetReceiverChannelMap(&channelMap)) {
+        strncpy((char*) pcWriteBuffer, "Failed to set mode range, UAV must be in idle mode\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Mode range %ld set to %s within [%d, %d] %% for %s\r\n",
+            rangeIdx, GetReceiverModeName((ReceiverModeType) range.Mode), range.MinPercent, range.MaxPercent,
+            receiverChannelNames[range.Channel]);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Saves the receiver channel map and mode ranges to flash
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISaveReceiverMap(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    if (!SaveReceiverChannelMap()) {
+        strncpy((char*) pcWriteBuffer, "Failed to save receiver map, UAV must be in idle mode\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    strncpy((char*) pcWriteBuffer, "Receiver map saved\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Looks up a receiver channel by its CLI name
+ * @param  name : Name parameter, not null terminated
+ * @param  nameLength : Length of the name
+ * @retval Receiver channel, as the snapshot channels, RECEIVER_SNAPSHOT_CHANNELS_NBR if unknown
+ */
+static uint8_t ParseReceiverChannelName(const int8_t* name, const portBASE_TYPE nameLength) {
+    uint8_t channel;
+
+    for (channel = 0; channel < RECEIVER_SNAPSHOT_CHANNELS_NBR; channel++) {
+        if (NULL != name && strlen(receiverChannelNames[channel]) == (size_t) nameLength
+                && 0 == strncmp((const char*) name, receiverChannelNames[channel], nameLength)) {
+            break;
+        }
+    }
+
+    return channel;
+}
+
+/**
+ * @brief  Implements CLI command to print the last sampled sensor values
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetSensors(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    portBASE_TYPE lParameterNumber = 0;
+
+    float32_t accX, accY, accZ, gyroX, gyroY, gyroZ, magX, magY, magZ;
+    float32_t printValues[3];
+    bool protoStatus;
+    ProtoFrameStream_TypeDef protoFrame;
+    SensorSamplesProto sensorProto;
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    configASSERT(pcWriteBuffer);
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    lParameterNumber++;
+
+    /* Obtain the parameter string. */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
+            lParameterNumber, /* Return the next parameter. */
+            &xParameterStringLength /* Store the parameter string length. */
+    );
+
+    /* Sanity check something was returned. */
+    configASSERT(pcParameter);
+
+    /* Get the current sensor values */
+    switch (pcParameter[0]) {
+    case 'n':
+        if (outCnt == 0) {
+            /* Get the latest sensor values */
+            GetAcceleration(&printValues[0], &printValues[1], &printValues[2]);
+            FormatFixedList((char*) pcWriteBuffer, xWriteBufferLen,
+                    "Accelerometer [m/s^2]\nAccX: %1.3f\nAccY: %1.3f\nAccZ: %1.3f\r\n", printValues, 3);
+            outCnt = 3;
+        } else if (outCnt == 2) {
+            GetGyroAngleDot(&printValues[0], &printValues[1], &printValues[2]);
+            FormatFixedList((char*) pcWriteBuffer, xWriteBufferLen,
+                    "Gyroscope [rad/s]\nGyroX: %1.3f\nGyroY: %1.3f\nGyroZ: %1.3f\r\n", printValues, 3);
+        } else {
+            GetMagVector(&printValues[0], &printValues[1], &printValues[2]);
+            FormatFixedList((char*) pcWriteBuffer, xWriteBufferLen,
+                    "Magnetometer [G]\nMagX: %1.3f\nMagY: %1.3f\nMagZ: %1.3f\r\n", printValues, 3);
+        }
+
+        break;
+    case 'p':
+        GetAcceleration(&accX, &accY, &accZ);
+        GetGyroAngleDot(&gyroX, &gyroY, &gyroZ);
+        GetMagVector(&magX, &magY, &magZ);
+
+        sensorProto.has_accX = true;
+        sensorProto.has_accY = true;
+        sensorProto.has_accZ = true;
+        sensorProto.has_gyroX = true;
+        sensorProto.has_gyroY = true;
+        sensorProto.has_gyroZ = true;
+        sensorProto.has_magX = true;
+        sensorProto.has_magY = true;
+        sensorProto.has_magZ = true;
+        sensorProto.accX = accX;
+        sensorProto.accY = accY;
+        sensorProto.accZ = accZ;
+        sensorProto.gyroX = gyroX;
+        sensorProto.gyroY = gyroY;
+        sensorProto.gyroZ = gyroZ;
+        sensorProto.magX = magX;
+        sensorProto.magY = magY;
+        sensorProto.magZ = magZ;
+
+        /* Encode the data with protocol buffer straight into its frame in the output buffer */
+        ProtoFrameBegin(&protoFrame, (uint8_t*) pcWriteBuffer, xWriteBufferLen, SENSOR_SAMPLES_MSG_ENUM);
+        protoStatus = pb_encode(&protoFrame.stream, SensorSamplesProto_fields, &sensorProto);
+        dataOutLength = ProtoFrameEnd(&protoFrame);
+
+        if (!protoStatus || 0 == dataOutLength) {
+            ErrorHandler();
+        }
+
+        break;
+    default:
+        strncpy((char*) pcWriteBuffer, "Invalid parameter\r\n", xWriteBufferLen);
+        break;
+    }
+
+    if (outCnt > 0) {
+        outCnt--;
+    }
+
+    if (outCnt == 0) {
+        return pdFALSE; /* Return false to indicate command activity finished */
+    } else {
+        return pdTRUE; /* Return true to indicate more command activity to follow */
+    }
+}
+
+/**
+ * @brief  Starts sensor sampling for a specified sample time and duration
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIStartSensorSampling(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString) {
+    int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength, xReturn;
+    static portBASE_TYPE lParameterNumber = 0;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    if (lParameterNumber == 0) {
+        /* The first time the function is called after the command has been entered just a header string is returned. */
+        strncpy((char*) pcWriteBuffer, "Starting print sampling of sensor values...\r\n", xWriteBufferLen);
+    } else {
+        uint16_t sensorSampleTime;
+        uint16_t sensorSampleDuration;
+
+        /* Obtain the parameter string */
+        pcParameter = (int8_t*) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
+                lParameterNumber, /* Return the next parameter. */
+                &xParameterStringLength /* Store the parameter string length. */
+        );
+
+        /* Sanity check something was returned. */
+        configASSERT(pcParameter);
+
+        strncpy((char*) pcWriteBuffer, "Sample time (ms): ", xWriteBufferLen);
+
+        size_t paramMaxSize;
+        if ((unsigned long) xParameterStringLength > xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1)
+            paramMaxSize = xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1;
+        else
+            paramMaxSize = xParameterStringLength;
+
+        strncat((char*) pcWriteBuffer, (char*) pcParameter, paramMaxSize);
+        strncat((char*) pcWriteBuffer, "\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+
+        sensorSampleTime = atoi((char*) pcParameter);
+
+        lParameterNumber++;
+
+        pcParameter = (int8_t*) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
+                lParameterNumber, /* Return the next parameter. */
+                &xParameterStringLength /* Store the parameter string length. */);
+
+        /* Sanity check something was returned. */
+        configASSERT(pcParameter);
+
+        strncat((char*) pcWriteBuffer, "Duration (s): ", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+
+        if ((unsigned long) xParameterStringLength > xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1)
+            paramMaxSize = xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1;
+        else
+            paramMaxSize = xParameterStringLength;
+
+        strncat((char*) pcWriteBuffer, (char*) pcParameter, paramMaxSize);
+        strncat((char*) pcWriteBuffer, "\n\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+
+        sensorSampleDuration = atoi((char*) pcParameter);
+
+        /* Start printing sensor values */
+        StartTelemetry(SENSOR_SAMPLES_MSG_ENUM, NO_SERIALIZATION, sensorSampleTime, sensorSampleDuration);
+    }
+
+    /* Update return value and parameter index */
+    if (lParameterNumber == startSensorSamplingCommand.cExpectedNumberOfParameters) {
+        /* If this is the last parameter then there are no more strings to return after this one. */
+        xReturn = pdFALSE;
+        lParameterNumber = 0;
+    } else {
+        /* There are more parameters to return after this one. */
+        xReturn = pdTRUE;
+        lParameterNumber++;
+    }
+
+    return xReturn;
+}
+
+/**
+ * @brief  Stops printing of sensor sample values
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIStopSensorSampling(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    strncpy((char*) pcWriteBuffer, "Stopping printing of sensor sample values...\r\n", xWriteBufferLen);
+
+    /* Stop printing sensor values */
+    StopTelemetry(SENSOR_SAMPLES_MSG_ENUM);
+
+    return pdFALSE;
+}
+
+/**
+ * Starts magnetometer calibration procedure.
+ */
+static portBASE_TYPE CLIStartAccMagMtrCalibration(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString) {
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    portBASE_TYPE xParameterStringLength;
+
+    strncpy((char*) pcWriteBuffer, "Starting Acc/Mag meter parameters "
+            "not applied to acc or mag values ...\r\n", xWriteBufferLen);
+
+    int32_t pcParameter = atoi((char*)FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength));
+
+    StartAccMagMtrCalibration(pcParameter);
+    return pdFALSE; /* false indicates CLI activity completed */
+}
+
+/**
+ * @brief  Implements CLI command to print the gyroscope bias vs temperature table
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetGyroTempCompensation(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* compensationString = cliPrintBuffer.gyroTempComp; // Table does not fit in the CLI output buffer
+    FcbGyroTempCompensationType compensation;
+    size_t length;
+    uint8_t bin;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    GetGyroTempCompensation(&compensation);
+    length = snprintf(compensationString, GYRO_TEMP_COMP_MAX_STRING_SIZE,
+            "Gyro temperature [C, relative]: %d\nCompensation: %s\nTemp\tX bias\tY bias\tZ bias [rad/s]\n",
+            GetGyroTemperature(), compensation.isEnabled ? "enabled" : "disabled");
+    for (bin = 0; bin < GYRO_TEMP_COMP_BINS && length < GYRO_TEMP_COMP_MAX_STRING_SIZE; bin++) {
+        if (compensation.validBins & (1 << bin)) {
+            length += snprintf(compensationString + length, GYRO_TEMP_COMP_MAX_STRING_SIZE - length, "%d",
+                    GYRO_TEMP_COMP_MIN_TEMP + bin * GYRO_TEMP_COMP_BIN_WIDTH + GYRO_TEMP_COMP_BIN_WIDTH / 2);
+            if (length < GYRO_TEMP_COMP_MAX_STRING_SIZE) {
+                length += FormatFixedList(compensationString + length, GYRO_TEMP_COMP_MAX_STRING_SIZE - length,
+                        "\t%1.5f\t%1.5f\t%1.5f\n", compensation.bias[bin], 3);
+            }
+        }
+    }
+    if (length < GYRO_TEMP_COMP_MAX_STRING_SIZE) {
+        snprintf(compensationString + length, GYRO_TEMP_COMP_MAX_STRING_SIZE - length, "\r\n");
+    }
+    ComSessionSendString(compensationString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to enable, disable or clear the gyroscope bias vs temperature table
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetGyroTempCompensation(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    FcbRetValType status;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    if (5 == xParameterStringLength && 0 == strncmp((const char*) pcParameter, "clear", xParameterStringLength)) {
+        status = ClearGyroTempCompensation();
+    } else if (1 == xParameterStringLength && ('0' == pcParameter[0] || '1' == pcParameter[0])) {
+        status = SetGyroTempCompensationEnabled(pcParameter[0] - '0');
+    } else {
+        strncpy((char*) pcWriteBuffer, "Invalid parameter, use 0, 1 or clear\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    if (FCB_OK == status) {
+        strncpy((char*) pcWriteBuffer, "Gyro temperature compensation saved to flash\r\n", xWriteBufferLen);
+    } else {
+        strncpy((char*) pcWriteBuffer, "Failed to save gyro temperature compensation, UAV must be in idle mode\r\n",
+                xWriteBufferLen);
+    }
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print the accelerometer and magnetometer offset and scale vs temperature points
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetAccMagTempCompensation(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* compensationString = cliPrintBuffer.accMagTempComp; // Points do not fit in the CLI output buffer
+    static const char* const sensorNames[ACCMAG_TEMP_COMP_SENSORS] = { "Acc", "Mag" };
+    FcbAccMagTempCompensationType compensation;
+    const FcbAccMagTempPointsType* points;
+    size_t length;
+    uint8_t sensor, point;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    GetAccMagTempCompensation(&compensation);
+    length = snprintf(compensationString, ACCMAG_TEMP_COMP_MAX_STRING_SIZE,
+            "Acc/mag temperature [C/8, relative]: %d\nCompensation: %s\n", GetAccMagTemperature(),
+            compensation.isEnabled ? "enabled" : "disabled");
+    for (sensor = 0; sensor < ACCMAG_TEMP_COMP_SENSORS && length < ACCMAG_TEMP_COMP_MAX_STRING_SIZE; sensor++) {
+        points = &compensation.sensor[sensor];
+        length += snprintf(compensationString + length, ACCMAG_TEMP_COMP_MAX_STRING_SIZE - length,
+                "%s, first in use\nTemp\tX off\tY off\tZ off\tX scale\tY scale\tZ scale\n", sensorNames[sensor]);
+        for (point = 0; point < points->nbrOfPoints && length < ACCMAG_TEMP_COMP_MAX_STRING_SIZE; point++) {
+            length += snprintf(compensationString + length, ACCMAG_TEMP_COMP_MAX_STRING_SIZE - length, "%d",
+                    points->temperature[point]);
+            if (length < ACCMAG_TEMP_COMP_MAX_STRING_SIZE) {
+                length += FormatFixedList(compensationString + length, ACCMAG_TEMP_COMP_MAX_STRING_SIZE - length,
+                        "\t%1.4f\t%1.4f\t%1.4f", points->offset[point], 3);
+            }
+            if (length < ACCMAG_TEMP_COMP_MAX_STRING_SIZE) {
+                length += FormatFixedList(compensationString + length, ACCMAG_TEMP_COMP_MAX_STRING_SIZE - length,
+                        "\t%1.4f\t%1.4f\t%1.4f\n", points->scale[point], 3);
+            }
+        }
+    }
+    if (length < ACCMAG_TEMP_COMP_MAX_STRING_SIZE) {
+        snprintf(compensationString + length, ACCMAG_TEMP_COMP_MAX_STRING_SIZE - length, "\r\n");
+    }
+    ComSessionSendString(compensationString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to enable, disable or clear the accelerometer and magnetometer temperature
+ *         compensation
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetAccMagTempCompensation(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    FcbRetValType status;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    if (5 == xParameterStringLength && 0 == strncmp((const char*) pcParameter, "clear", xParameterStringLength)) {
+        status = ClearAccMagTempCompensation();
+    } else if (1 == xParameterStringLength && ('0' == pcParameter[0] || '1' == pcParameter[0])) {
+        status = SetAccMagTempCompensationEnabled(pcParameter[0] - '0');
+    } else {
+        strncpy((char*) pcWriteBuffer, "Invalid parameter, use 0, 1 or clear\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    if (FCB_OK == status) {
+        strncpy((char*) pcWriteBuffer, "Acc/mag temperature compensation saved to flash\r\n", xWriteBufferLen);
+    } else {
+        strncpy((char*) pcWriteBuffer, "Failed to save acc/mag temperature compensation, UAV must be in idle mode\r\n",
+                xWriteBufferLen);
+    }
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print the sensor data rate statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetSensorRates(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* sensorRatesString = cliPrintBuffer.sensorRates; // Tables do not fit in the CLI output buffer
+    static uint8_t tablePrint = 0;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    /* One table per call */
+    switch (tablePrint) {
+    case 0:
+        PrintSensorDataRateStats(sensorRatesString, SENSOR_RATES_MAX_STRING_SIZE);
+        break;
+    case 1:
+        PrintSensorWatchdogStats(sensorRatesString, SENSOR_RATES_MAX_STRING_SIZE);
+        break;
+    default:
+        PrintSensorTiming(sensorRatesString, SENSOR_RATES_MAX_STRING_SIZE);
+        break;
+    }
+    ComSessionSendString(sensorRatesString);
+
+    if (++tablePrint < 3) {
+        return pdTRUE; /* Return true to indicate more command activity to follow */
+    }
+    tablePrint = 0;
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to clear the sensor data rate statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIResetSensorRates(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    ResetSensorDataRateStats();
+    ResetSensorWatchdogStats();
+    strncpy((char*) pcWriteBuffer, "Sensor data rate and watchdog statistics cleared\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print the vibration and clipping statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetVibration(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* vibrationString = cliPrintBuffer.vibration; // Table does not fit in the CLI output buffer
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    PrintVibrationStats(vibrationString, VIBRATION_MAX_STRING_SIZE);
+    ComSessionSendString(vibrationString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to clear the vibration statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIResetVibration(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    ResetVibrationStats();
+    strncpy((char*) pcWriteBuffer, "Vibration statistics cleared\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+#ifdef FCB_DYNAMIC_NOTCH
+/**
+ * @brief  Implements CLI command to print the spectrum analysis statistics and the dynamic notch centers
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetDynamicNotch(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* dynamicNotchString = cliPrintBuffer.dynamicNotch;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    PrintDynamicNotch(dynamicNotchString, DYNAMIC_NOTCH_MAX_STRING_SIZE);
+    ComSessionSendString(dynamicNotchString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to clear the spectrum analysis statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIResetDynamicNotch(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    ResetDynamicNotchStats();
+    strncpy((char*) pcWriteBuffer, "Dynamic notch statistics cleared\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+#endif
+
+#ifdef FCB_GPS
+/**
+ * @brief  Implements CLI command to print the GPS receiver and the position estimate
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetGps(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* gpsString = cliPrintBuffer.gps; // Does not fit in the CLI output buffer
+    size_t length;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    length = PrintGpsStats(gpsString, GPS_MAX_STRING_SIZE);
+    if (length < GPS_MAX_STRING_SIZE) {
+        PrintPositionStates(gpsString + length, GPS_MAX_STRING_SIZE - length);
+    }
+    ComSessionSendString(gpsString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to clear the GPS statistics and the position estimate
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIResetGps(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    ResetGpsStats();
+    ResetPositionEstimation();
+    strncpy((char*) pcWriteBuffer, "GPS statistics cleared, home set from the next fix\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+#endif
+
+#ifdef FCB_BATTERY_MONITOR
+/**
+ * @brief  Implements CLI command to print the battery monitor
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetBattery(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    PrintBatteryState((char*) pcWriteBuffer, xWriteBufferLen);
+
+    return pdFALSE;
+}
+#endif
+
+/**
+ * @brief  Implements CLI command to print the barometer configuration and statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetBarometer(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* barometerStatsString = cliPrintBuffer.barometerStats;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    PrintBarometerStats(barometerStatsString, BAROMETER_STATS_MAX_STRING_SIZE);
+    ComSessionSendString(barometerStatsString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to set the barometer over sampling and temperature refresh period
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetBarometer(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t *pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    uint32_t oss;
+    uint32_t temperaturePeriod;
+
+    configASSERT(pcWriteBuffer);
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    oss = strtoul((char*) pcParameter, NULL, 10);
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength);
+    temperaturePeriod = strtoul((char*) pcParameter, NULL, 10);
+
+    if (oss > BMP180_OSS_MAX || FCB_OK != SetBarometerConfig(oss, temperaturePeriod)) {
+        snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Barometer settings refused, not in idle mode or invalid "
+                "values, valid are oss [0, %u] and temperature period [1, %u] ms\r\n", BMP180_OSS_MAX,
+                BAROMETER_MAX_TEMPERATURE_PERIOD);
+        return pdFALSE;
+    }
+
+    snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Barometer oss %lu, temperature period %lu ms\r\n", oss,
+            temperaturePeriod);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to set the reference pressure of the barometer altitude
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetBaroReference(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t *pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    BarometerReferenceType reference;
+    uint32_t pressure = 0;
+
+    configASSERT(pcWriteBuffer);
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+
+    if (3 == xParameterStringLength && 0 == strncmp((const char*) pcParameter, "std", xParameterStringLength)) {
+        reference = BAROMETER_REFERENCE_STANDARD;
+    } else if (3 == xParameterStringLength && 0 == strncmp((const char*) pcParameter, "arm", xParameterStringLength)) {
+        reference = BAROMETER_REFERENCE_ARMING;
+    } else {
+        reference = BAROMETER_REFERENCE_FIXED;
+        pressure = strtoul((char*) pcParameter, NULL, 10);
+    }
+
+    if (FCB_OK != SetBarometerReference(reference, pressure)) {
+        snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Barometer reference refused, not in idle mode or invalid "
+                "value, valid are std, arm or a pressure in [%u, %u] Pa\r\n", BAROMETER_MIN_REFERENCE_PRESSURE,
+                BAROMETER_MAX_REFERENCE_PRESSURE);
+        return pdFALSE;
+    }
+
+    PrintBarometerStats((char*) pcWriteBuffer, xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print the last control signal values sent to the motors
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetMotorValues(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    int8_t* pcParameter;
+
+    portBASE_TYPE xParameterStringLength;
+    portBASE_TYPE lParameterNumber = 0;
+
+    bool protoStatus;
+    ProtoFrameStream_TypeDef protoFrame;
+    MotorSignalValuesProto motorSignalValuesProto;
+
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    lParameterNumber++;
+
+    /* Obtain the parameter string. */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
+            lParameterNumber, /* Return the next parameter. */
+            &xParameterStringLength /* Store the parameter string length. */
+    );
+
+    /* Sanity check something was returned. */
+    configASSERT(pcParameter);
+
+    /* Get the current motor values */
+    switch (pcParameter[0]) {
+    case 'n':
+        snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Motors\nM1: %u\nM2: %u\nM3: %u\nM4: %u\n\r\n",
+                GetMotorValue(1), GetMotorValue(2), GetMotorValue(3), GetMotorValue(4));
+        break;
+    case 'p':
+        motorSignalValuesProto.has_M1 = true;
+        motorSignalValuesProto.has_M2 = true;
+        motorSignalValuesProto.has_M3 = true;
+        motorSignalValuesProto.has_M4 = true;
+        motorSignalValuesProto.M1 = GetMotorValue(1);
+        motorSignalValuesProto.M2 = GetMotorValue(2);
+        motorSignalValuesProto.M3 = GetMotorValue(3);
+        motorSignalValuesProto.M4 = GetMotorValue(4);
+
+        /* Encode the data with protocol buffer straight into its frame in the output buffer */
+        ProtoFrameBegin(&protoFrame, (uint8_t*) pcWriteBuffer, xWriteBufferLen, MOTOR_VALUES_MSG_ENUM);
+        protoStatus = pb_encode(&protoFrame.stream, MotorSignalValuesProto_fields, &motorSignalValuesProto);
+        dataOutLength = ProtoFrameEnd(&protoFrame);
+
+        if (!protoStatus || 0 == dataOutLength) {
+            ErrorHandler();
+        }
+
+        break;
+    default:
+        strncpy((char*) pcWriteBuffer, "Invalid parameter\r\n", xWriteBufferLen);
+        break;
+    }
+
+    return pdFALSE; /* Return false to indicate command activity finished */
+}
+
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+/**
+ * @brief  Implements CLI command to print the motor telemetry and the RPM filter notches
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetMotorTelemetry(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* motorTelemetryString = cliPrintBuffer.motorTelemetry;
+    size_t length;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    length = PrintMotorTelemetry(motorTelemetryString, MOTOR_TELEMETRY_MAX_STRING_SIZE);
+#ifdef FCB_RPM_FILTER
+    if (length < MOTOR_TELEMETRY_MAX_STRING_SIZE) {
+        PrintRpmFilter(motorTelemetryString + length, MOTOR_TELEMETRY_MAX_STRING_SIZE - length);
+    }
+#else
+    (void) length;
+#endif
+    ComSessionSendString(motorTelemetryString);
+
+    return pdFALSE;
+}
+#endif
+
+#ifdef MOTOR_ESC_TELEMETRY
+/**
+ * @brief  Implements CLI command to print the telemetry and health of the ESC:s
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetEscTelemetry(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* escTelemetryString = cliPrintBuffer.escTelemetry;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    PrintEscTelemetry(escTelemetryString, ESC_TELEMETRY_MAX_STRING_SIZE);
+    ComSessionSendString(escTelemetryString);
+
+    return pdFALSE;
+}
+#endif
+
+#ifdef FCB_CAN_BUS
+/**
+ * @brief  Implements CLI command to print the CAN bus stats, the DroneCAN nodes and their latest data
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetDroneCanStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* droneCanStatusString = cliPrintBuffer.droneCanStatus;
+    size_t length;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    length = PrintCanBusStats(droneCanStatusString, DRONECAN_STATUS_MAX_STRING_SIZE);
+    if (length < DRONECAN_STATUS_MAX_STRING_SIZE) {
+        PrintDroneCanStatus(droneCanStatusString + length, DRONECAN_STATUS_MAX_STRING_SIZE - length);
+    }
+    ComSessionSendString(droneCanStatusString);
+
+    return pdFALSE;
+}
+#endif
+
+/**
+ * @brief  Starts sensor sampling for a specified sample time and duration
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIStartMotorSampling(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength, xReturn;
+    static portBASE_TYPE lParameterNumber = 0;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    if (lParameterNumber == 0) {
+        /* The first time the function is called after the command has been entered just a header string is returned. */
+        strncpy((char*) pcWriteBuffer, "Starting print sampling of motor control signal values...\r\n", xWriteBufferLen);
+    } else {
+        uint16_t motorSampleTime;
+        uint16_t motorSampleDuration;
+
+        /* Obtain the parameter string */
+        pcParameter = (int8_t*) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
+                lParameterNumber, /* Return the next parameter. */
+                &xParameterStringLength /* Store the parameter string length. */
+        );
+
+        /* Sanity check something was returned. */
+        configASSERT(pcParameter);
+
+        strncpy((char*) pcWriteBuffer, "Sample time (ms): ", xWriteBufferLen);
+
+        size_t paramMaxSize;
+        if ((unsigned long) xParameterStringLength > xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1)
+            paramMaxSize = xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1;
+        else
+            paramMaxSize = xParameterStringLength;
+
+        strncat((char*) pcWriteBuffer, (char*) pcParameter, paramMaxSize);
+        strncat((char*) pcWriteBuffer, "\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+
+        motorSampleTime = atoi((char*) pcParameter);
+
+        lParameterNumber++;
+
+        pcParameter = (int8_t*) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
+                lParameterNumber, /* Return the next parameter. */
+                &xParameterStringLength /* Store the parameter string length. */);
+
+        /* Sanity check something was returned. */
+        configASSERT(pcParameter);
+
+        strncat((char*) pcWriteBuffer, "Duration (s): ", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+
+        if ((unsigned long) xParameterStringLength > xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1)
+            paramMaxSize = xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1;
+        else
+            paramMaxSize = xParameterStringLength;
+
+        strncat((char*) pcWriteBuffer, (char*) pcParameter, paramMaxSize);
+        strncat((char*) pcWriteBuffer, "\n\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+
+        motorSampleDuration = atoi((char*) pcParameter);
+
+        StartTelemetry(MOTOR_VALUES_MSG_ENUM, NO_SERIALIZATION, motorSampleTime, motorSampleDuration);
+    }
+
+    /* Update return value and parameter index */
+    if (lParameterNumber == startMotorSamplingCommand.cExpectedNumberOfParameters) {
+        /* If this is the last parameter then there are no more strings to return after this one. */
+        xReturn = pdFALSE;
+        lParameterNumber = 0;
+    } else {
+        /* There are more parameters to return after this one. */
+        xReturn = pdTRUE;
+        lParameterNumber++;
+    }
+
+    return xReturn;
+}
+
+/**
+ * @brief  Stops printing of motor control signal sample values
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIStopMotorSampling(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    strncpy((char*) pcWriteBuffer, "Stopping printing of sensor sample values...\r\n", xWriteBufferLen);
+
+    /* Stop printing motor control values */
+    StopTelemetry(MOTOR_VALUES_MSG_ENUM);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements "about" command, prints system information
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIAbout(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    strncpy((char*) pcWriteBuffer,
+            "Dragonfly\nThe Dragonfly system is developed at AF Consult in Malmoe, Sweden. It is designed to control a quadrotor UAV.\n\nVersion:",
+            xWriteBufferLen);
+    strncat((char*) pcWriteBuffer, DF_FCB_VERSION, xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+    strncat((char*) pcWriteBuffer, "\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements "systime" command, prints system up time
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISysTime(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    snprintf((char*) pcWriteBuffer, xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1, "System time [ms]: %u\r\n",
+            (unsigned int) HAL_GetTick());
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements "get-time-sync" command, prints the host clock synchronisation
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetTimeSync(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    PrintTimeSyncStatus((char*) pcWriteBuffer, xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements "get-flight-mode" command, prints current flight control mode
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetFlightMode(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    FlightModeStatusType status;
+    size_t length;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    strncpy((char*) pcWriteBuffer, "Flight mode: ", xWriteBufferLen);
+
+    switch(GetFlightControlMode()) {
+    case FLIGHT_CONTROL_IDLE:
+        strncat((char*) pcWriteBuffer, "IDLE", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+        break;
+    case FLIGHT_CONTROL_RAW:
+        strncat((char*) pcWriteBuffer, "RAW", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+        break;
+    case FLIGHT_CONTROL_PID:
+        strncat((char*) pcWriteBuffer, "PID", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+        break;
+    case FLIGHT_CONTROL_AUTONOMOUS:
+    	strncat((char*) pcWriteBuffer, "AUTO", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+    	break;
+    case FLIGHT_CONTROL_RATE:
+        strncat((char*) pcWriteBuffer, "RATE", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+        break;
+    case FLIGHT_CONTROL_ALTITUDE_HOLD:
+        strncat((char*) pcWriteBuffer, "ALT", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+        break;
+    default:
+        strncat((char*) pcWriteBuffer, "N/A", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+        break;
+    }
+
+    GetFlightModeStatus(&status);
+    length = strlen((char*) pcWriteBuffer);
+    length += (size_t) snprintf((char*) pcWriteBuffer + length, xWriteBufferLen - length, "\r\nState: %s\r\n",
+            GetFlightModeStateName(status.state));
+    if (FLIGHT_MODE_REJECT_NONE != status.rejectReason && length < xWriteBufferLen) {
+        snprintf((char*) pcWriteBuffer + length, xWriteBufferLen - length, "Rejected: %s, %s\r\n",
+                GetFlightModeStateName(status.rejectedState), GetFlightModeRejectName(status.rejectReason));
+    }
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements "get-flight-mode-log" command, prints the flight mode transition log
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetFlightModeLog(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    /* The status and then the entries, one output chunk at a time */
+    if (PrintFlightModeLogNext((char*) pcWriteBuffer, xWriteBufferLen)) {
+        return pdTRUE;
+    }
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements "get-prearm" command, prints the pre-arm checks and which of them failed
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetPreArm(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* preArmString = cliPrintBuffer.preArm;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    PrintPreArmChecks(preArmString, PREARM_CHECKS_MAX_STRING_SIZE);
+    ComSessionSendString(preArmString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements "get-ref-signals" command, prints current reference signals
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetRefSignals(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    portBASE_TYPE lParameterNumber = 0;
+
+    float32_t printValues[5];
+    bool protoStatus;
+    ProtoFrameStream_TypeDef protoFrame;
+    ControlReferenceSignalsProto refValuesProto;
+
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    lParameterNumber++;
+
+    /* Obtain the parameter string. */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
+            lParameterNumber, /* Return the next parameter. */
+            &xParameterStringLength /* Store the parameter string length. */
+    );
+
+    /* Sanity check something was returned. */
+    configASSERT(pcParameter);
+
+    switch (pcParameter[0]) {
+    case 'n':
+    	printValues[0] = GetZVelocityReferenceSignal();
+    	printValues[1] = GetRollAngleReferenceSignal();
+    	printValues[2] = GetPitchAngleReferenceSignal();
+    	printValues[3] = GetYawAngleReferenceSignal();
+    	printValues[4] = GetYawAngularRateReferenceSignal();
+    	FormatFixedList((char*) pcWriteBuffer, xWriteBufferLen,
+    	            "Reference signals:\nZ velocity: %1.4f m/s\nRoll angle: %1.4f rad\nPitch angle: %1.4f rad\nYaw angle: %1.4f rad\nYaw rate: %1.4f rad/s\n",
+    	            printValues, 5);
+    	break;
+    case 'p':
+    	/* Add reference signal values to protobuffer type struct members */
+    	refValuesProto.has_refRoll = true;
+    	refValuesProto.refRoll = GetRollAngleReferenceSignal();
+    	refValuesProto.has_refPitch = true;
+    	refValuesProto.refPitch = GetPitchAngleReferenceSignal();
+    	refValuesProto.has_refYaw = true;
+    	refValuesProto.refYaw = GetYawAngleReferenceSignal();
+    	refValuesProto.has_refYawRate = true;
+    	refValuesProto.refYawRate = GetYawAngularRateReferenceSignal();
+
+    	/* Encode the data with protocol buffer straight into its frame in the output buffer */
+    	ProtoFrameBegin(&protoFrame, (uint8_t*) pcWriteBuffer, xWriteBufferLen, REFSIGNALS_MSG_ENUM);
+    	protoStatus = pb_encode(&protoFrame.stream, ControlReferenceSignalsProto_fields, &refValuesProto);
+    	dataOutLength = ProtoFrameEnd(&protoFrame);
+
+    	if (!protoStatus || 0 == dataOutLength) {
+    		ErrorHandler();
+    	}
+
+    	break;
+    default:
+    	strncpy((char*) pcWriteBuffer, "Invalid parameter\r\n",
+    			xWriteBufferLen);
+    	break;
+    }
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements "get-ctrl-signals" command, prints current control signals
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetCtrlSignals(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    portBASE_TYPE lParameterNumber = 0;
+
+    float32_t printValues[4];
+    bool protoStatus;
+    ProtoFrameStream_TypeDef protoFrame;
+    ControlSignalsProto ctrlValuesProto;
+
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    lParameterNumber++;
+
+    /* Obtain the parameter string. */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
+            lParameterNumber, /* Return the next parameter. */
+            &xParameterStringLength /* Store the parameter string length. */
+    );
+
+    /* Sanity check something was returned. */
+    configASSERT(pcParameter);
+
+    switch (pcParameter[0]) {
+    case 'n':
+    	printValues[0] = GetThrustControlSignal();
+    	printValues[1] = GetRollControlSignal();
+    	printValues[2] = GetPitchControlSignal();
+    	printValues[3] = GetYawControlSignal();
+    	FormatFixedList((char*) pcWriteBuffer, xWriteBufferLen,
+    	            "Control signals:\nThrust: %1.4f N\nRoll: %1.4f Nm\nPitch: %1.4f Nm\nYaw: %1.4f Nm\n", printValues, 4);
+    	break;
+    case 'p':
+    	/* Add control signal values to protobuffer type struct members */
+        ctrlValuesProto.has_ctrlState = true;
+        ctrlValuesProto.ctrlState = GetFlightControlMode();
+        ctrlValuesProto.has_thrustCtrl = true;
+        ctrlValuesProto.thrustCtrl = GetThrustControlSignal();
+        ctrlValuesProto.has_rollCtrl = true;
+        ctrlValuesProto.rollCtrl = GetRollControlSignal();
+        ctrlValuesProto.has_pitchCtrl = true;
+        ctrlValuesProto.pitchCtrl = GetPitchControlSignal();
+        ctrlValuesProto.has_yawCtrl = true;
+        ctrlValuesProto.yawCtrl = GetYawControlSignal();
+
+    	/* Encode the data with protocol buffer straight into its frame in the output buffer */
+    	ProtoFrameBegin(&protoFrame, (uint8_t*) pcWriteBuffer, xWriteBufferLen, CTRLSIGNALS_MSG_ENUM);
+    	protoStatus = pb_encode(&protoFrame.stream, ControlSignalsProto_fields, &ctrlValuesProto);
+    	dataOutLength = ProtoFrameEnd(&protoFrame);
+
+    	if (!protoStatus || 0 == dataOutLength) {
+    		ErrorHandler();
+    	}
+
+    	break;
+    default:
+    	strncpy((char*) pcWriteBuffer, "Invalid parameter\r\n",
+    			xWriteBufferLen);
+    	break;
+    }
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to set the max limit for received signals from RC control.
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetMaxReferenceSignals(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    float pcParameter[4];
+
+    portBASE_TYPE xParameterStringLength;
+//    portBASE_TYPE lParameterNumber = 0;
+
+    configASSERT(pcWriteBuffer);
+
+    /* Obtain the parameter strings. */
+    for (int i = 0; i < 4; i++) {
+        pcParameter[i] = strtof((char*)FreeRTOS_CLIGetParameter(pcCommandString, i+1, &xParameterStringLength), NULL);
+    }
+
+    setMaxLimitForReferenceSignal(pcParameter[0], pcParameter[1], pcParameter[2], pcParameter[3]);
+
+    FormatFixedList((char*) pcWriteBuffer, xWriteBufferLen,
+            "Set max limit for reference signals:\nZ velocity: %1.4f m/s\nRoll angle: %1.4f rad\nPitch angle: %1.4f rad\nYaw angular rate: %1.4f rad/s\n",
+            pcParameter, 4);
+
+    return pdFALSE; /* Return false to indicate command activity finished */
+}
+
+/**
+ * @brief  Implements CLI command to get the max limit for received signals from RC control.
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetMaxReferenceSignals(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    float32_t refLimits[5];
+
+    configASSERT(pcWriteBuffer);
+
+    getMaxLimitForReferenceSignal(&refLimits[0], &refLimits[1], &refLimits[2], &refLimits[3], &refLimits[4]);
+
+    FormatFixedList((char*) pcWriteBuffer, xWriteBufferLen,
+            "Max limit for reference signals:\nZ velocity: %1.4f m/s\nRoll angle: %1.4f rad\nPitch angle: %1.4f rad\nYaw angle: %1.4f rad\nYaw angular rate: %1.4f rad/s\n",
+            refLimits, 5);
+
+    return pdFALSE; /* Return false to indicate command activity finished */
+}
+/**
+ * @brief  Implements "task-status" command, prints task status
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLITaskStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    /* One part of the table per output chunk, so the table is sent as the transport takes it */
+    if (TaskStatusPrintNext((char*) pcWriteBuffer, xWriteBufferLen)) {
+        return pdTRUE;
+    }
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements "fast-math-benchmark" command, prints the fast math and the 3x3 kernel accuracy and cycle tables
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIFastMathBenchmark(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* benchmarkString = cliPrintBuffer.benchmark; // Table does not fit in the CLI output buffer
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    FastMathBenchmark(benchmarkString, FAST_MATH_BENCHMARK_MAX_STRING_SIZE);
+    ComSessionSendString(benchmarkString);
+
+    Matrix3Benchmark(benchmarkString, FAST_MATH_BENCHMARK_MAX_STRING_SIZE);
+    ComSessionSendString(benchmarkString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print the last control signal values sent to the motors
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetStateValues(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    portBASE_TYPE lParameterNumber = 0;
+
+    float32_t printValues[6];
+    bool protoStatus;
+    ProtoFrameStream_TypeDef protoFrame;
+    FlightStatesProto stateValuesProto;
+    StateSnapshotType snapshot;
+
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    lParameterNumber++;
+
+    /* Obtain the parameter string. */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
+            lParameterNumber, /* Return the next parameter. */
+            &xParameterStringLength /* Store the parameter string length. */
+    );
+
+    /* Sanity check something was returned. */
+    configASSERT(pcParameter);
+
+    /* Get the current state values, all of the same control cycle */
+    GetStateSnapshot(&snapshot);
+    switch (pcParameter[0]) {
+    case 'n':
+        printValues[0] = Radian2Degree(snapshot.angle[ROLL_IDX]);
+        printValues[1] = Radian2Degree(snapshot.angle[PITCH_IDX]);
+        printValues[2] = Radian2Degree(snapshot.angle[YAW_IDX]);
+        printValues[3] = Radian2Degree(snapshot.angleRateUnbiased[ROLL_IDX]);
+        printValues[4] = Radian2Degree(snapshot.angleRateUnbiased[PITCH_IDX]);
+        printValues[5] = Radian2Degree(snapshot.angleRateUnbiased[YAW_IDX]);
+        FormatFixedList((char*) pcWriteBuffer, xWriteBufferLen,
+                "Flight states [deg]\nrollAngle: %1.3f\npitchAngle: %1.3f\nyawAngle: %1.3f\nrollRate: %1.3f\npitchRate: %1.3f\nyawRate: %1.3f\r\n",
+                printValues, 6);
+        break;
+    case 'p':
+        /* Add estimated attitude states to protobuffer type struct members */
+        stateValuesProto.has_rollAngle = true;
+        stateValuesProto.rollAngle = snapshot.angle[ROLL_IDX];
+        stateValuesProto.has_pitchAngle = true;
+        stateValuesProto.pitchAngle = snapshot.angle[PITCH_IDX];
+        stateValuesProto.has_yawAngle = true;
+        stateValuesProto.yawAngle = snapshot.angle[YAW_IDX];
+
+        // TODO add attitude rates when available
+        stateValuesProto.has_rollRate = true;
+        stateValuesProto.rollRate = snapshot.angleRateUnbiased[ROLL_IDX];
+        stateValuesProto.has_pitchRate = true;
+        stateValuesProto.pitchRate = snapshot.angleRateUnbiased[PITCH_IDX];
+        stateValuesProto.has_yawRate = true;
+        stateValuesProto.yawRate = snapshot.angleRateUnbiased[YAW_IDX];
+
+        // TODO add position estimates when available
+        stateValuesProto.has_posX = false;
+        stateValuesProto.posX = 0.0;
+        stateValuesProto.has_posY = false;
+        stateValuesProto.posY = 0.0;
+        stateValuesProto.has_posZ = false;
+        stateValuesProto.posZ = 0.0;
+
+        // TODO add velocity estimates when available
+        stateValuesProto.has_velX = false;
+        stateValuesProto.velX = 0.0;
+        stateValuesProto.has_velY = false;
+        stateValuesProto.velY = 0.0;
+        stateValuesProto.has_velZ = false;
+        stateValuesProto.velZ = 0.0;
+
+        /* Encode the data with protocol buffer straight into its frame in the output buffer */
+        ProtoFrameBegin(&protoFrame, (uint8_t*) pcWriteBuffer, xWriteBufferLen, FLIGHT_STATE_MSG_ENUM);
+        protoStatus = pb_encode(&protoFrame.stream, FlightStatesProto_fields, &stateValuesProto);
+        dataOutLength = ProtoFrameEnd(&protoFrame);
+
+        if (!protoStatus || 0 == dataOutLength) {
+            ErrorHandler();
+        }
+
+        break;
+    default:
+        strncpy((char*) pcWriteBuffer, "Invalid parameter\r\n", xWriteBufferLen);
+        break;
+    }
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Starts state sampling for a specified sample time and duration
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIStartStateSampling(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength, xReturn;
+    static portBASE_TYPE lParameterNumber = 0;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    if (lParameterNumber == 0) {
+        /* The first time the function is called after the command has been entered just a header string is returned. */
+        strncpy((char*) pcWriteBuffer, "Starting print sampling of state values...\r\n", xWriteBufferLen);
+    } else {
+        uint16_t stateSampleTime;
+        uint16_t stateSampleDuration;
+
+        /* Obtain the parameter string */
+        pcParameter = (int8_t*) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
+                lParameterNumber, /* Return the next parameter. */
+                &xParameterStringLength /* Store the parameter string length. */
+        );
+
+        /* Sanity check something was returned. */
+        configASSERT(pcParameter);
+
+        strncpy((char*) pcWriteBuffer, "Sample time (ms): ", xWriteBufferLen);
+
+        size_t paramMaxSize;
+        if ((unsigned long) xParameterStringLength > xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1)
+            paramMaxSize = xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1;
+        else
+            paramMaxSize = xParameterStringLength;
+
+        strncat((char*) pcWriteBuffer, (char*) pcParameter, paramMaxSize);
+        strncat((char*) pcWriteBuffer, "\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+
+        stateSampleTime = atoi((char*) pcParameter);
+
+        lParameterNumber++;
+
+        pcParameter = (int8_t*) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
+                lParameterNumber, /* Return the next parameter. */
+                &xParameterStringLength /* Store the parameter string length. */);
+
+        /* Sanity check something was returned. */
+        configASSERT(pcParameter);
+
+        strncat((char*) pcWriteBuffer, "Duration (s): ", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+
+        if ((unsigned long) xParameterStringLength > xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1)
+            paramMaxSize = xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1;
+        else
+            paramMaxSize = xParameterStringLength;
+
+        strncat((char*) pcWriteBuffer, (char*) pcParameter, paramMaxSize);
+        strncat((char*) pcWriteBuffer, "\n\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+
+        stateSampleDuration = atoi((char*) pcParameter);
+
+        StartTelemetry(FLIGHT_STATE_MSG_ENUM, NO_SERIALIZATION, stateSampleTime, stateSampleDuration);
+    }
+
+    /* Update return value and parameter index */
+    if (lParameterNumber == startStateSamplingCommand.cExpectedNumberOfParameters) {
+        /* If this is the last parameter then there are no more strings to return after this one. */
+        xReturn = pdFALSE;
+        lParameterNumber = 0;
+    } else {
+        /* There are more parameters to return after this one. */
+        xReturn = pdTRUE;
+        lParameterNumber++;
+    }
+
+    return xReturn;
+}
+
+/**
+ * @brief  Stops printing of state sample values
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIStopStateSampling(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    strncpy((char*) pcWriteBuffer, "Stopping printing of state sample values...\r\n", xWriteBufferLen);
+
+    /* Stop printing state values */
+    StopTelemetry(FLIGHT_STATE_MSG_ENUM);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Saves the state estimation warm start to flash
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISaveStateWarmStart(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    if (FCB_OK == SaveStateWarmStart()) {
+        strncpy((char*) pcWriteBuffer, "State warm start saved to flash\r\n", xWriteBufferLen);
+    } else {
+        strncpy((char*) pcWriteBuffer, "Failed to save state warm start, UAV must be in idle mode\r\n", xWriteBufferLen);
+    }
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Starts the sensor noise characterisation
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIStartSensorNoise(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t *pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    int duration;
+
+    configASSERT(pcWriteBuffer);
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    duration = atoi((const char*) pcParameter);
+
+    if (FCB_OK == StartSensorNoiseCharacterisation((float32_t) duration)) {
+        snprintf((char*) pcWriteBuffer, xWriteBufferLen,
+                "Sensor noise characterisation started for %d s, keep the UAV at rest\r\n", duration);
+    } else {
+        snprintf((char*) pcWriteBuffer, xWriteBufferLen,
+                "Sensor noise characterisation refused, UAV must be in idle mode, duration %u-%u s\r\n",
+                (unsigned int) SENSOR_NOISE_MIN_DURATION, (unsigned int) SENSOR_NOISE_MAX_DURATION);
+    }
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Prints the sensor noise characterisation
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetSensorNoise(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* noiseString = cliPrintBuffer.noise; // Does not fit in the CLI output buffer
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    PrintSensorNoise(noiseString, SENSOR_NOISE_MAX_STRING_SIZE);
+    ComSessionSendString(noiseString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Saves the sensor noise characterisation to flash
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISaveSensorNoise(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    if (FCB_OK == SaveSensorNoise()) {
+        strncpy((char*) pcWriteBuffer, "Sensor noise saved to flash, used from the next startup\r\n", xWriteBufferLen);
+    } else {
+        strncpy((char*) pcWriteBuffer,
+                "Failed to save sensor noise, UAV must be in idle mode with a completed characterisation\r\n",
+                xWriteBufferLen);
+    }
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Sets the motor mixer layout and airmode and saves them to flash
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetMotorMixer(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    static const char* geometryNames[MIXER_GEOMETRY_NBR] = { "quadx", "quadplus", "hexx", "octox" };
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    MotorMixerSettings_TypeDef settings;
+    size_t length;
+    uint8_t geometry, airmode, i;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    /* Get the layout parameter */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    for (geometry = 0; geometry < MIXER_GEOMETRY_NBR; geometry++) {
+        if (strlen(geometryNames[geometry]) == (size_t) xParameterStringLength
+                && 0 == strncmp((const char*) pcParameter, geometryNames[geometry], xParameterStringLength)) {
+            break;
+        }
+    }
+
+    /* Get the airmode parameter */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength);
+    airmode = (uint8_t) atoi((const char*) pcParameter);
+
+    if (geometry >= MIXER_GEOMETRY_NBR || airmode > 1) {
+        strncpy((char*) pcWriteBuffer, "Invalid motor mixer parameters\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    if (FCB_OK != MotorMixerConfig((MixerGeometry_TypeDef) geometry, airmode)) {
+        strncpy((char*) pcWriteBuffer,
+                "Failed to set motor mixer, UAV must be in idle mode and the layout must fit the motor outputs\r\n",
+                xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    /* Print the resulting mixer factors */
+    MotorMixerGetSettings(&settings);
+    length = snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Motor mixer saved, airmode %lu\r\nMotor\tThrust\tRoll\tPitch\tYaw\r\n",
+            settings.airmode);
+    for (i = 0; i < settings.nbrOfMotors && length < xWriteBufferLen; i++) {
+        length += snprintf((char*) pcWriteBuffer + length, xWriteBufferLen - length, "%u", i + 1);
+        if (length < xWriteBufferLen) {
+            length += FormatFixedList((char*) pcWriteBuffer + length, xWriteBufferLen - length,
+                    "\t%1.3f\t%1.3f\t%1.3f\t%1.3f\r\n", settings.factors[i], MIXER_AXES_NBR);
+        }
+    }
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print the allocation settings of the motor mixer
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetMixerAllocation(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString) {
+    MotorMixerAllocation_TypeDef allocation;
+    size_t length;
+    uint8_t i;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    MotorMixerGetAllocation(&allocation);
+    length = snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Priority: %s\r\nMotor\tMin\tMax\r\n",
+            mixerPriorityNames[allocation.priority]);
+    for (i = 0; i < MotorMixerGetNbrOfMotors() && length < xWriteBufferLen; i++) {
+        const float32_t limits[2] = { allocation.minCommand[i], allocation.maxCommand[i] };
+
+        length += snprintf((char*) pcWriteBuffer + length, xWriteBufferLen - length, "%u", i + 1);
+        if (length < xWriteBufferLen) {
+            length += FormatFixedList((char*) pcWriteBuffer + length, xWriteBufferLen - length, "\t%1.3f\t%1.3f\r\n",
+                    limits, 2);
+        }
+    }
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to set the allocation priority of the motor mixer and the command limits of a motor
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetMixerAllocation(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    MotorMixerAllocation_TypeDef allocation;
+    float32_t minCommand, maxCommand;
+    uint8_t priority, motor, i;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    /* Get the priority parameter */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    for (priority = 0; priority < MIXER_PRIORITY_NBR; priority++) {
+        if (strlen(mixerPriorityNames[priority]) == (size_t) xParameterStringLength
+                && 0 == strncmp((const char*) pcParameter, mixerPriorityNames[priority], xParameterStringLength)) {
+            break;
+        }
+    }
+
+    motor = (uint8_t) atoi((const char*) FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength));
+    minCommand = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 3, &xParameterStringLength), NULL);
+    maxCommand = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 4, &xParameterStringLength), NULL);
+
+    if (priority >= MIXER_PRIORITY_NBR || motor > MIXER_MAX_MOTORS) {
+        strncpy((char*) pcWriteBuffer, "Invalid mixer allocation parameters\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    MotorMixerGetAllocation(&allocation);
+    allocation.priority = priority;
+    for (i = 0; i < MIXER_MAX_MOTORS; i++) {
+        if (0 == motor || i + 1 == motor) {
+            allocation.minCommand[i] = minCommand;
+            allocation.maxCommand[i] = maxCommand;
+        }
+    }
+
+    if (FCB_OK != MotorMixerSetAllocation(&allocation)) {
+        strncpy((char*) pcWriteBuffer, "Invalid motor command limits, 0 <= min < max <= 1\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    strncpy((char*) pcWriteBuffer, "Mixer allocation set, see save-mixer-allocation\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to save the allocation settings of the motor mixer to flash
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISaveMixerAllocation(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    if (FCB_OK != MotorMixerSaveAllocation()) {
+        strncpy((char*) pcWriteBuffer, "Mixer allocation not saved, the UAV must be in idle mode\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    strncpy((char*) pcWriteBuffer, "Mixer allocation saved\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print the control latency statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetControlLatency(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* latencyString = cliPrintBuffer.latency; // Table does not fit in the CLI output buffer
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    LatencyMonitorPrint(latencyString, CONTROL_LATENCY_MAX_STRING_SIZE);
+    ComSessionSendString(latencyString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to clear the control latency statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIResetControlLatency(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    LatencyMonitorReset();
+    strncpy((char*) pcWriteBuffer, "Control latency statistics cleared\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+#ifdef FCB_WAKE_LATENCY
+/**
+ * @brief  Implements CLI command to print the wake latency statistics of the gyroscope sample handoffs
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetWakeLatency(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* wakeLatencyString = cliPrintBuffer.wakeLatency; // Table does not fit in the CLI output buffer
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    WakeLatencyPrint(wakeLatencyString, WAKE_LATENCY_MAX_STRING_SIZE);
+    ComSessionSendString(wakeLatencyString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to clear the wake latency statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIResetWakeLatency(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    WakeLatencyReset();
+    strncpy((char*) pcWriteBuffer, "Wake latency statistics cleared\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+#endif
+
+/**
+ * @brief  Implements CLI command to print where the hot control path objects are placed in memory
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetMemoryPlacement(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* placementString = cliPrintBuffer.placement; // Table does not fit in the CLI output buffer
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    CcmRamPrint(placementString, CCM_RAM_MAX_STRING_SIZE);
+    ComSessionSendString(placementString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print the deferred work statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetDeferredWork(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* deferredWorkString = cliPrintBuffer.deferredWork; // Table does not fit in the CLI output buffer
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    DeferredWorkPrint(deferredWorkString, DEFERRED_WORK_MAX_STRING_SIZE);
+    ComSessionSendString(deferredWorkString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to clear the deferred work statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIResetDeferredWork(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    DeferredWorkReset();
+    strncpy((char*) pcWriteBuffer, "Deferred work statistics cleared\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print the rate group statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetRateGroups(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* rateGroupString = cliPrintBuffer.rateGroup; // Table does not fit in the CLI output buffer
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    RateGroupPrint(rateGroupString, RATE_GROUP_MAX_STRING_SIZE);
+    ComSessionSendString(rateGroupString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to clear the rate group statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIResetRateGroups(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    RateGroupReset();
+    strncpy((char*) pcWriteBuffer, "Rate group statistics cleared\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print the boot phase times
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetBootTime(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* bootTimeString = cliPrintBuffer.bootTime;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    BootTimingPrint(bootTimeString, BOOT_TIMING_MAX_STRING_SIZE);
+    ComSessionSendString(bootTimeString);
+
+    return pdFALSE;
+}
+
+#ifdef FCB_CONTROL_EXECUTIVE
+/**
+ * @brief  Implements CLI command to print the control executive statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetControlExecutive(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* controlExecutiveString = cliPrintBuffer.controlExecutive;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    ControlExecutivePrint(controlExecutiveString, CONTROL_EXECUTIVE_MAX_STRING_SIZE);
+    ComSessionSendString(controlExecutiveString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to clear the control executive statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIResetControlExecutive(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    ControlExecutiveResetStats();
+    strncpy((char*) pcWriteBuffer, "Control executive statistics cleared\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+#endif
+
+#ifdef FCB_SENSOR_LOAD_TEST
+/**
+ * @brief  Implements CLI command to start the sensor load test
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIStartSensorLoadTest(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t *pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    uint32_t rateHz[SENSOR_LOAD_TEST_SENSORS];
+    uint32_t duration;
+    uint8_t i;
+
+    configASSERT(pcWriteBuffer);
+
+    for (i = 0; i < SENSOR_LOAD_TEST_SENSORS; i++) {
+        pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, i + 1, &xParameterStringLength);
+        rateHz[i] = strtoul((char*) pcParameter, NULL, 10);
+    }
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, SENSOR_LOAD_TEST_SENSORS + 1, &xParameterStringLength);
+    duration = strtoul((char*) pcParameter, NULL, 10);
+
+    if (FCB_OK != SensorLoadTestStart(rateHz, duration)) {
+        snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Sensor load test refused, a test is active, not in idle "
+                "mode or invalid parameters, valid rates are [0, %u] Hz and durations [1, %u] ms\r\n",
+                SENSOR_LOAD_TEST_TICK_RATE, SENSOR_LOAD_TEST_MAX_DURATION);
+        return pdFALSE;
+    }
+
+    snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Sensor load test started for %lu ms\r\n", duration);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to end the sensor load test and print its statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIStopSensorLoadTest(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    SensorLoadTestStop();
+
+    return CLIGetSensorLoadTest(pcWriteBuffer, xWriteBufferLen, pcCommandString);
+}
+
+/**
+ * @brief  Implements CLI command to print the sensor load test statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetSensorLoadTest(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* sensorLoadTestString = cliPrintBuffer.sensorLoadTest;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    SensorLoadTestPrint(sensorLoadTestString, SENSOR_LOAD_TEST_MAX_STRING_SIZE);
+    ComSessionSendString(sensorLoadTestString);
+
+    return pdFALSE;
+}
+#endif
+
+#ifdef FCB_WCET_TEST
+/**
+ * @brief  Implements CLI command to start the WCET test
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIStartWcetTest(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t *pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    uint32_t duration;
+
+    configASSERT(pcWriteBuffer);
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    duration = strtoul((char*) pcParameter, NULL, 10);
+
+    if (FCB_OK != WcetTestStart(duration)) {
+        snprintf((char*) pcWriteBuffer, xWriteBufferLen, "WCET test refused, a test is running, not in idle mode or "
+                "invalid duration, valid durations are [1, %u] ms\r\n", WCET_TEST_MAX_DURATION);
+        return pdFALSE;
+    }
+
+    snprintf((char*) pcWriteBuffer, xWriteBufferLen, "WCET test started for %lu ms\r\n", duration);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to abort the WCET test
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIStopWcetTest(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    WcetTestStop();
+    strncpy((char*) pcWriteBuffer, "WCET test stopped, see get-wcet-test\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print the WCET test result
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetWcetTest(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* wcetTestString = cliPrintBuffer.wcetTest; // Table does not fit in the CLI output buffer
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    WcetTestPrint(wcetTestString, WCET_TEST_MAX_STRING_SIZE);
+    ComSessionSendString(wcetTestString);
+
+    return pdFALSE;
+}
+#endif
+
+/**
+ * @brief  Implements CLI command to print the control loop deadline statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetDeadlineStats(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* deadlineString = cliPrintBuffer.deadline; // Table does not fit in the CLI output buffer
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    DeadlineMonitorPrint(deadlineString, DEADLINE_STATS_MAX_STRING_SIZE);
+    ComSessionSendString(deadlineString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to clear the control loop deadline statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIResetDeadlineStats(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    DeadlineMonitorReset();
+    strncpy((char*) pcWriteBuffer, "Deadline statistics cleared\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print the occupancy watermarks of the buffers
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIBufferStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* bufferString = cliPrintBuffer.buffer; // Table does not fit in the CLI output buffer
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    BufferMonitorPrint(bufferString, BUFFER_STATUS_MAX_STRING_SIZE);
+    ComSessionSendString(bufferString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print or clear the crash dump. The protobuf output is a CrashDumpProto frame with
+ *         the dump, followed by one frame per log entry of the dump.
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLICrashDump(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* dumpString = cliPrintBuffer.dump.string; // Dump does not fit in the CLI output buffer
+    CrashDump_TypeDef* dump = &cliPrintBuffer.dump.dump; // Kept over the calls of the command
+    static uint8_t framePrint = 0;
+    int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    ProtoFrameStream_TypeDef protoFrame;
+    bool protoStatus;
+
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    /* Obtain the parameter string. */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
+            1, /* Return the first parameter. */
+            &xParameterStringLength /* Store the parameter string length. */
+    );
+
+    /* Sanity check something was returned. */
+    configASSERT(pcParameter);
+
+    switch (pcParameter[0]) {
+    case 'n':
+        /* The dump, then one log entry per call */
+        if (0 == framePrint) {
+            GetCrashDump(dump);
+            CrashDumpPrint(dumpString, CRASH_DUMP_MAX_STRING_SIZE, dump);
+            ComSessionSendString(dumpString);
+        } else {
+            CrashDumpPrintLogEntry((char*) pcWriteBuffer, xWriteBufferLen, dump, framePrint - 1);
+        }
+
+        framePrint++;
+        if (framePrint <= dump->logEntriesNbr && framePrint <= CRASH_DUMP_LOG_ENTRIES) {
+            return pdTRUE; /* Return true to indicate more command activity to follow */
+        }
+        framePrint = 0;
+        break;
+    case 'p':
+        if (0 == framePrint) {
+            GetCrashDump(dump);
+        }
+
+        /* Encode the data with protocol buffer straight into its frame in the output buffer */
+        ProtoFrameBegin(&protoFrame, (uint8_t*) pcWriteBuffer, xWriteBufferLen, CRASH_DUMP_MSG_ENUM);
+        if (0 == framePrint) {
+            protoStatus = EncodeCrashDump(&protoFrame.stream, dump);
+        } else {
+            protoStatus = EncodeCrashDumpLogEntry(&protoFrame.stream, dump, framePrint - 1);
+        }
+        dataOutLength = ProtoFrameEnd(&protoFrame);
+
+        if (!protoStatus || 0 == dataOutLength) {
+            ErrorHandler();
+        }
+
+        framePrint++;
+        if (framePrint <= dump->logEntriesNbr && framePrint <= CRASH_DUMP_LOG_ENTRIES) {
+            return pdTRUE; /* Return true to indicate more command activity to follow */
+        }
+        framePrint = 0;
+        break;
+    case 'c':
+        ClearCrashDump();
+        strncpy((char*) pcWriteBuffer, "Crash dump cleared\r\n", xWriteBufferLen);
+        break;
+    default:
+        strncpy((char*) pcWriteBuffer, "Invalid parameter\r\n", xWriteBufferLen);
+        break;
+    }
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements "get-event-journal" command, prints the odometer and then the records a bufferful at a time
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetEventJournal(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    static bool isStatusPrinted = false;
+    static uint16_t recordIdx = 0;
+    static uint16_t records = 0;
+    EventJournalStatusType status;
+    EventJournalRecordType record;
+    size_t length = 0;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    if (!isStatusPrinted) {
+        GetEventJournalStatus(&status);
+        records = status.records;
+        recordIdx = 0;
+        PrintEventJournalStatus((char*) pcWriteBuffer, xWriteBufferLen);
+        isStatusPrinted = (0 != records);
+        return isStatusPrinted ? pdTRUE : pdFALSE;
+    }
+
+    while (recordIdx < records && length + EVENT_JOURNAL_RECORD_STRING_SIZE < xWriteBufferLen) {
+        if (GetEventJournalRecord(recordIdx, &record)) {
+            length += PrintEventJournalRecord((char*) pcWriteBuffer + length, xWriteBufferLen - length, &record);
+        } else {
+            length += (size_t) snprintf((char*) pcWriteBuffer + length, xWriteBufferLen - length,
+                    "%5u interrupted record\n", recordIdx);
+        }
+        recordIdx++;
+    }
+
+    if (recordIdx < records) {
+        return pdTRUE; /* Return true to indicate more command activity to follow */
+    }
+
+    isStatusPrinted = false;
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements "clear-event-journal" command, requests the event journal to be erased
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIClearEventJournal(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    if (FCB_OK != ClearEventJournal()) {
+        strncpy((char*) pcWriteBuffer, "Event journal not cleared, the UAV must be in idle mode\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    strncpy((char*) pcWriteBuffer, "Event journal clear requested, the odometer is kept\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print the scope probe mapping table
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetScopeProbes(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* probeString = cliPrintBuffer.probe; // Table does not fit in the CLI output buffer
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    ScopeProbePrint(probeString, SCOPE_PROBE_MAX_STRING_SIZE);
+    ComSessionSendString(probeString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to map a pipeline stage to a scope probe channel
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetScopeProbe(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    const char* stageName;
+    uint8_t stage;
+    uint8_t channel;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    /* Get the stage and channel parameters */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    for (stage = 0; stage < SCOPE_PROBE_STAGE_NBR; stage++) {
+        stageName = GetScopeProbeStageName((ScopeProbeStage_TypeDef) stage);
+        if (strlen(stageName) == (size_t) xParameterStringLength
+                && 0 == strncmp(stageName, (const char*) pcParameter, xParameterStringLength)) {
+            break;
+        }
+    }
+
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength);
+    if ('-' == pcParameter[0]) {
+        channel = SCOPE_PROBE_CHANNEL_NONE;
+    } else if (pcParameter[0] >= '0' && pcParameter[0] < '0' + SCOPE_PROBE_GPIO_CHANNELS && 1 == xParameterStringLength) {
+        channel = pcParameter[0] - '0';
+    } else {
+        stage = SCOPE_PROBE_STAGE_NBR;
+    }
+
+    if (stage >= SCOPE_PROBE_STAGE_NBR) {
+        strncpy((char*) pcWriteBuffer, "Invalid stage or channel, see get-scope-probes\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    SetScopeProbeChannel((ScopeProbeStage_TypeDef) stage, channel);
+    if (SCOPE_PROBE_CHANNEL_NONE == channel) {
+        snprintf((char*) pcWriteBuffer, xWriteBufferLen, "%s not marked\r\n", stageName);
+    } else {
+        snprintf((char*) pcWriteBuffer, xWriteBufferLen, "%s marked on channel %u\r\n", stageName, channel);
+    }
+
+    return pdFALSE;
+}
+
+#ifdef FCB_ISR_MONITOR
+/**
+ * @brief  Implements CLI command to print the execution time and rate statistics of the interrupt handlers
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetIsrStats(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* isrString = cliPrintBuffer.isr.string; // Table does not fit in the CLI output buffer
+    IsrSnapshot_TypeDef* snapshot = &cliPrintBuffer.isr.snapshot; // Too large for the stack of the low deferred worker
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    IsrMonitorGetSnapshot(snapshot);
+    IsrMonitorPrint(isrString, ISR_STATS_MAX_STRING_SIZE, snapshot);
+    ComSessionSendString(isrString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to clear the interrupt handler statistics
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIResetIsrStats(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    IsrMonitorReset();
+    strncpy((char*) pcWriteBuffer, "Interrupt statistics cleared\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+#endif
+
+#ifdef FCB_PROFILING
+/**
+ * @brief  Implements CLI command to print or clear the profiling probe statistics. The protobuf output is one
+ *         ProfileProbeProto frame per probe, all from the same snapshot.
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIProfile(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* profileString = cliPrintBuffer.profile.string; // Table does not fit in the CLI output buffer
+    ProfileSnapshot_TypeDef* snapshot = &cliPrintBuffer.profile.snapshot; // Kept over the calls of the command
+    static uint8_t probePrint = 0;
+    int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    ProtoFrameStream_TypeDef protoFrame;
+    bool protoStatus;
+
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    /* Obtain the parameter string. */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
+            1, /* Return the first parameter. */
+            &xParameterStringLength /* Store the parameter string length. */
+    );
+
+    /* Sanity check something was returned. */
+    configASSERT(pcParameter);
+
+    switch (pcParameter[0]) {
+    case 'n':
+    case 's':
+        ProfileGetSnapshot(snapshot, 's' == pcParameter[0]);
+        ProfilePrint(profileString, PROFILE_MAX_STRING_SIZE, snapshot);
+        ComSessionSendString(profileString);
+        break;
+    case 'p':
+        if (0 == probePrint) {
+            ProfileGetSnapshot(snapshot, false);
+        }
+
+        /* Encode the data with protocol buffer straight into its frame in the output buffer */
+        ProtoFrameBegin(&protoFrame, (uint8_t*) pcWriteBuffer, xWriteBufferLen, PROFILE_STATS_MSG_ENUM);
+        protoStatus = EncodeProfileProbe(&protoFrame.stream, snapshot, (ProfileProbe_TypeDef) probePrint);
+        dataOutLength = ProtoFrameEnd(&protoFrame);
+
+        if (!protoStatus || 0 == dataOutLength) {
+            ErrorHandler();
+        }
+
+        probePrint++;
+        if (probePrint < PROFILE_PROBE_NBR) {
+            return pdTRUE; /* Return true to indicate more command activity to follow */
+        }
+        probePrint = 0;
+        break;
+    case 'r':
+        ProfileReset();
+        strncpy((char*) pcWriteBuffer, "Profiling statistics cleared\r\n", xWriteBufferLen);
+        break;
+    default:
+        strncpy((char*) pcWriteBuffer, "Invalid parameter\r\n", xWriteBufferLen);
+        break;
+    }
+
+    return pdFALSE;
+}
+#endif
+
+#ifdef FCB_PERF_SNAPSHOT
+/**
+ * @brief  Implements CLI command to print the latest performance snapshot as a table or as CSV, or its regressions
+ *         against the baseline
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetPerfSnapshot(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* perfString = cliPrintBuffer.perf; // Table does not fit in the CLI output buffer
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    configASSERT(pcParameter);
+
+    switch (pcParameter[0]) {
+    case 't':
+        PerfSnapshotPrint(perfString, PERF_SNAPSHOT_MAX_STRING_SIZE);
+        ComSessionSendString(perfString);
+        break;
+    case 'c':
+        PerfSnapshotPrintCsv(perfString, PERF_SNAPSHOT_MAX_STRING_SIZE);
+        ComSessionSendString(perfString);
+        break;
+    case 'r':
+        PerfBaselineCompare(perfString, PERF_SNAPSHOT_MAX_STRING_SIZE);
+        ComSessionSendString(perfString);
+        break;
+    default:
+        strncpy((char*) pcWriteBuffer, "Invalid parameter\r\n", xWriteBufferLen);
+        break;
+    }
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to set the time between the performance snapshots
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetPerfSnapshotPeriod(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    uint32_t period;
+
+    configASSERT(pcWriteBuffer);
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    period = strtoul((char*) pcParameter, NULL, 10);
+
+    if (period > PERF_SNAPSHOT_MAX_PERIOD || FCB_OK != PerfSnapshotSetPeriod((uint16_t) period)) {
+        snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Invalid period, valid is [1, %u] s\r\n",
+                PERF_SNAPSHOT_MAX_PERIOD);
+        return pdFALSE;
+    }
+
+    snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Performance snapshot every %u s\r\n", PerfSnapshotGetPeriod());
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to clear the statistics of the performance snapshot
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIResetPerfSnapshot(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    PerfSnapshotReset();
+    strncpy((char*) pcWriteBuffer, "Performance snapshot statistics cleared\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to save the latest performance snapshot to flash as the baseline
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISavePerfBaseline(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    if (FCB_OK != PerfBaselineSave()) {
+        strncpy((char*) pcWriteBuffer, "Performance baseline not saved, the UAV must be in idle mode and a snapshot "
+                "taken\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    strncpy((char*) pcWriteBuffer, "Performance baseline saved\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+#endif
+
+/**
+ * @brief  Implements CLI command to print the PID controller gains
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetPIDGains(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* gainsString = cliPrintBuffer.gains; // Table does not fit in the CLI output buffer
+    PIDGains_TypeDef gains;
+    PIDFeedForward_TypeDef feedForward;
+    float32_t gainValues[5];
+    size_t length;
+    uint8_t i;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    length = snprintf(gainsString, PID_GAINS_MAX_STRING_SIZE, "Controller\tK\t\tTi\t\tTd\t\tKff\t\tTf\r\n");
+    for (i = 0; i < PID_NBR_CONTROLLERS && length < PID_GAINS_MAX_STRING_SIZE; i++) {
+        GetPIDGains((PIDControllerIndex_TypeDef) i, &gains);
+        GetPIDFeedForward((PIDControllerIndex_TypeDef) i, &feedForward);
+        length += snprintf(gainsString + length, PID_GAINS_MAX_STRING_SIZE - length, "%s\t%s",
+                pidControllerNames[i], (strlen(pidControllerNames[i]) < 8) ? "\t" : "");
+        gainValues[0] = gains.K;
+        gainValues[1] = gains.Ti;
+        gainValues[2] = gains.Td;
+        gainValues[3] = feedForward.K;
+        gainValues[4] = feedForward.Tf;
+        if (length < PID_GAINS_MAX_STRING_SIZE) {
+            length += FormatFixedList(gainsString + length, PID_GAINS_MAX_STRING_SIZE - length,
+                    "%1.4f\t\t%1.4f\t\t%1.4f\t\t%1.4f\t\t%1.4f\r\n", gainValues, 5);
+        }
+    }
+    ComSessionSendString(gainsString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Sets the gains of a PID controller, effective from the next control cycle
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetPIDGains(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    PIDGains_TypeDef gains;
+    float32_t gainValues[3];
+    size_t length;
+    uint8_t idx;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    /* Get the controller parameter */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    for (idx = 0; idx < PID_NBR_CONTROLLERS; idx++) {
+        if (strlen(pidControllerNames[idx]) == (size_t) xParameterStringLength
+                && 0 == strncmp((const char*) pcParameter, pidControllerNames[idx], xParameterStringLength)) {
+            break;
+        }
+    }
+
+    /* Get the gain parameters */
+    gains.K = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength), NULL);
+    gains.Ti = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 3, &xParameterStringLength), NULL);
+    gains.Td = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 4, &xParameterStringLength), NULL);
+
+    if (idx >= PID_NBR_CONTROLLERS || FCB_OK != SetPIDGains((PIDControllerIndex_TypeDef) idx, &gains)) {
+        strncpy((char*) pcWriteBuffer, "Invalid PID controller or gains, Ti & Td must not be negative\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    length = snprintf((char*) pcWriteBuffer, xWriteBufferLen, "PID gains of %s set to ", pidControllerNames[idx]);
+    gainValues[0] = gains.K;
+    gainValues[1] = gains.Ti;
+    gainValues[2] = gains.Td;
+    if (length < xWriteBufferLen) {
+        FormatFixedList((char*) pcWriteBuffer + length, xWriteBufferLen - length, "K %1.4f, Ti %1.4f, Td %1.4f\r\n",
+                gainValues, 3);
+    }
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Saves the current PID gains to flash
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISavePIDGains(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    if (FCB_OK != SavePIDGains()) {
+        strncpy((char*) pcWriteBuffer, "Failed to save PID gains, UAV must be in idle mode\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    strncpy((char*) pcWriteBuffer, "PID gains saved\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Sets the setpoint feed-forward of a PID controller, effective from the next control cycle
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetPIDFeedForward(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    PIDFeedForward_TypeDef feedForward;
+    float32_t values[2];
+    size_t length;
+    uint8_t idx;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    /* Get the controller parameter */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    for (idx = 0; idx < PID_NBR_CONTROLLERS; idx++) {
+        if (strlen(pidControllerNames[idx]) == (size_t) xParameterStringLength
+                && 0 == strncmp((const char*) pcParameter, pidControllerNames[idx], xParameterStringLength)) {
+            break;
+        }
+    }
+
+    /* Get the feed-forward parameters */
+    feedForward.K = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength), NULL);
+    feedForward.Tf = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 3, &xParameterStringLength), NULL);
+
+    if (idx >= PID_NBR_CONTROLLERS || FCB_OK != SetPIDFeedForward((PIDControllerIndex_TypeDef) idx, &feedForward)) {
+        strncpy((char*) pcWriteBuffer, "Invalid PID controller or feed-forward, Tf must not be negative\r\n",
+                xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    length = snprintf((char*) pcWriteBuffer, xWriteBufferLen, "PID feed-forward of %s set to ",
+            pidControllerNames[idx]);
+    values[0] = feedForward.K;
+    values[1] = feedForward.Tf;
+    if (length < xWriteBufferLen) {
+        FormatFixedList((char*) pcWriteBuffer + length, xWriteBufferLen - length, "Kff %1.4f, Tf %1.4f s\r\n",
+                values, 2);
+    }
+
+    return pdFALSE;
+}
+
+#ifdef PID_USE_GAIN_SCHEDULING
+/**
+ * @brief  Implements CLI command to print the PID gain schedule tables and the active scales
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetPIDSchedule(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* scheduleString = cliPrintBuffer.schedule; // Table does not fit in the CLI output buffer
+    PIDGainSchedule_TypeDef schedule;
+    float32_t values[2];
+    size_t length;
+    uint8_t i;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    GetPIDGainSchedule(&schedule);
+
+    length = snprintf(scheduleString, PID_SCHEDULE_MAX_STRING_SIZE,
+            "Throttle [%%]\tScale\t\tCell voltage [V]\tScale\r\n");
+    for (i = 0; i < PID_SCHEDULE_BREAKPOINTS && length < PID_SCHEDULE_MAX_STRING_SIZE; i++) {
+        values[0] = 100.0f*i/(PID_SCHEDULE_BREAKPOINTS - 1);
+        values[1] = schedule.throttleScales[i];
+        length += FormatFixedList(scheduleString + length, PID_SCHEDULE_MAX_STRING_SIZE - length, "%1.0f\t\t%1.3f\t\t",
+                values, 2);
+        values[0] = PID_SCHEDULE_MIN_CELL_VOLTAGE
+                + (PID_SCHEDULE_MAX_CELL_VOLTAGE - PID_SCHEDULE_MIN_CELL_VOLTAGE)*i/(PID_SCHEDULE_BREAKPOINTS - 1);
+        values[1] = schedule.batteryScales[i];
+        if (length < PID_SCHEDULE_MAX_STRING_SIZE) {
+            length += FormatFixedList(scheduleString + length, PID_SCHEDULE_MAX_STRING_SIZE - length,
+                    "%1.2f\t\t\t%1.3f\r\n", values, 2);
+        }
+    }
+
+    GetPIDGainScheduleScales(&values[0], &values[1]);
+    if (length < PID_SCHEDULE_MAX_STRING_SIZE) {
+        FormatFixedList(scheduleString + length, PID_SCHEDULE_MAX_STRING_SIZE - length,
+                "Active scales: throttle %1.3f, battery %1.3f\r\n", values, 2);
+    }
+    ComSessionSendString(scheduleString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Sets the scales of a PID gain schedule table, evaluated from the next schedule update on
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetPIDSchedule(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    PIDGainSchedule_TypeDef schedule;
+    float32_t limits[2];
+    float32_t* scales;
+    uint8_t i;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    GetPIDGainSchedule(&schedule);
+
+    /* Get the table parameter */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    if (8 == xParameterStringLength && 0 == strncmp((const char*) pcParameter, "throttle", xParameterStringLength)) {
+        scales = schedule.throttleScales;
+    } else if (7 == xParameterStringLength
+            && 0 == strncmp((const char*) pcParameter, "battery", xParameterStringLength)) {
+        scales = schedule.batteryScales;
+    } else {
+        strncpy((char*) pcWriteBuffer, "Invalid table, use throttle or battery\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    /* Get the scale parameters */
+    for (i = 0; i < PID_SCHEDULE_BREAKPOINTS; i++) {
+        scales[i] = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 2 + i, &xParameterStringLength), NULL);
+    }
+
+    if (FCB_OK != SetPIDGainSchedule(&schedule)) {
+        limits[0] = PID_SCHEDULE_MIN_SCALE;
+        limits[1] = PID_SCHEDULE_MAX_SCALE;
+        FormatFixedList((char*) pcWriteBuffer, xWriteBufferLen, "Invalid scales, use %1.1f to %1.1f\r\n", limits, 2);
+        return pdFALSE;
+    }
+
+    strncpy((char*) pcWriteBuffer, "PID gain schedule set\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Saves the PID gain schedule tables to flash
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISavePIDSchedule(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    if (FCB_OK != SavePIDGainSchedule()) {
+        strncpy((char*) pcWriteBuffer, "Failed to save PID gain schedule, UAV must be in idle mode\r\n",
+                xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    strncpy((char*) pcWriteBuffer, "PID gain schedule saved\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+#endif
+
+#ifdef PID_AUTOTUNE
+/**
+ * @brief  Implements CLI command to start, stop, accept, discard or print the autotune of a moment controller
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIAutotune(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* autotuneString = cliPrintBuffer.autotune; // Proposal does not fit in the CLI output buffer
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    AutotuneAxisType axis;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+
+    for (axis = AUTOTUNE_AXIS_ROLL; axis < AUTOTUNE_AXIS_NBR; axis++) {
+        if (strlen(GetAutotuneAxisName(axis)) == (size_t) xParameterStringLength
+                && 0 == strncmp((const char*) pcParameter, GetAutotuneAxisName(axis), xParameterStringLength)) {
+            StartAutotune(axis);
+            snprintf((char*) pcWriteBuffer, xWriteBufferLen,
+                    "Autotune of %s started, fly the attitude mode with the sticks centred\r\n",
+                    GetAutotuneAxisName(axis));
+            return pdFALSE;
+        }
+    }
+
+    if (4 == xParameterStringLength && 0 == strncmp((const char*) pcParameter, "stop", xParameterStringLength)) {
+        StopAutotune();
+        strncpy((char*) pcWriteBuffer, "Autotune stopped\r\n", xWriteBufferLen);
+    } else if (6 == xParameterStringLength
+            && 0 == strncmp((const char*) pcParameter, "accept", xParameterStringLength)) {
+        if (FCB_OK != AcceptAutotune()) {
+            strncpy((char*) pcWriteBuffer, "No autotune proposal to accept\r\n", xWriteBufferLen);
+        } else {
+            strncpy((char*) pcWriteBuffer, "Autotune proposal set, see save-pid-gains\r\n", xWriteBufferLen);
+        }
+    } else if (7 == xParameterStringLength
+            && 0 == strncmp((const char*) pcParameter, "discard", xParameterStringLength)) {
+        DiscardAutotune();
+        strncpy((char*) pcWriteBuffer, "Autotune proposal discarded\r\n", xWriteBufferLen);
+    } else if (6 == xParameterStringLength
+            && 0 == strncmp((const char*) pcParameter, "status", xParameterStringLength)) {
+        PrintAutotuneStatus(autotuneString, AUTOTUNE_MAX_STRING_SIZE);
+        ComSessionSendString(autotuneString);
+    } else {
+        strncpy((char*) pcWriteBuffer, "Invalid argument, use roll, pitch, yaw, stop, accept, discard or status\r\n",
+                xWriteBufferLen);
+    }
+
+    return pdFALSE;
+}
+#endif
+
+#ifdef FCB_SYSTEM_IDENTIFICATION
+/**
+ * @brief  Implements CLI command to start a system identification excitation
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISysIdStart(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    SysIdConfigType config;
+    BlackboxStatus_TypeDef blackboxStatus;
+    uint8_t i;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    /* Get the axis parameter */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    config.axis = SYSID_AXIS_NBR;
+    for (i = 0; i < SYSID_AXIS_NBR; i++) {
+        if (strlen(GetSysIdAxisName((SysIdAxisType) i)) == (size_t) xParameterStringLength
+                && 0 == strncmp((const char*) pcParameter, GetSysIdAxisName((SysIdAxisType) i),
+                        xParameterStringLength)) {
+            config.axis = (SysIdAxisType) i;
+        }
+    }
+
+    /* Get the signal parameter */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength);
+    config.signal = SYSID_SIGNAL_NBR;
+    for (i = 0; i < SYSID_SIGNAL_NBR; i++) {
+        if (strlen(GetSysIdSignalName((SysIdSignalType) i)) == (size_t) xParameterStringLength
+                && 0 == strncmp((const char*) pcParameter, GetSysIdSignalName((SysIdSignalType) i),
+                        xParameterStringLength)) {
+            config.signal = (SysIdSignalType) i;
+        }
+    }
+
+    if (SYSID_AXIS_NBR == config.axis || SYSID_SIGNAL_NBR == config.signal) {
+        strncpy((char*) pcWriteBuffer, "Invalid axis or signal, use roll, pitch or yaw and chirp or prbs\r\n",
+                xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    config.amplitude = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 3, &xParameterStringLength), NULL);
+    config.duration = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 4, &xParameterStringLength), NULL);
+    config.fMin = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 5, &xParameterStringLength), NULL);
+    config.fMax = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 6, &xParameterStringLength), NULL);
+
+    if (FCB_OK != StartSystemIdentification(&config)) {
+        strncpy((char*) pcWriteBuffer,
+                "Failed to start, UAV must be in a stabilized flight mode and the excitation within the limits\r\n",
+                xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    GetBlackboxStatus(&blackboxStatus);
+    if (blackboxStatus.decimation > 1) {
+        strncpy((char*) pcWriteBuffer,
+                "System identification started, the blackbox decimation leaves out control cycles\r\n",
+                xWriteBufferLen);
+    } else {
+        strncpy((char*) pcWriteBuffer, "System identification started\r\n", xWriteBufferLen);
+    }
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to stop the system identification excitation
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISysIdStop(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    StopSystemIdentification();
+    strncpy((char*) pcWriteBuffer, "System identification stopped\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print the state and progress of the system identification
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISysIdStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    PrintSystemIdentificationStatus((char*) pcWriteBuffer, xWriteBufferLen);
+
+    return pdFALSE;
+}
+#endif
+
+/**
+ * @brief  Implements CLI command to print the stick curves
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetStickCurves(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* stickCurvesString = cliPrintBuffer.stickCurves;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    PrintStickCurves(stickCurvesString, STICK_CURVES_MAX_STRING_SIZE);
+    ComSessionSendString(stickCurvesString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Sets the stick curve of an axis, effective from the next control cycle
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetStickCurve(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    StickCurveType curve;
+    float32_t curveValues[3];
+    size_t length;
+    uint8_t axis;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    /* Get the axis parameter */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    for (axis = 0; axis < STICK_AXIS_NBR; axis++) {
+        const char* name = GetStickAxisName((StickAxisType) axis);
+
+        if (strlen(name) == (size_t) xParameterStringLength
+                && 0 == strncmp((const char*) pcParameter, name, xParameterStringLength)) {
+            break;
+        }
+    }
+
+    /* Get the curve parameters */
+    curve.deadband = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength), NULL);
+    curve.expo = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 3, &xParameterStringLength), NULL);
+    curve.superRate = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 4, &xParameterStringLength), NULL);
+
+    if (axis >= STICK_AXIS_NBR || FCB_OK != SetStickCurve((StickAxisType) axis, &curve)) {
+        strncpy((char*) pcWriteBuffer, "Invalid stick axis or curve\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    length = snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Stick curve of %s set to ",
+            GetStickAxisName((StickAxisType) axis));
+    curveValues[0] = curve.deadband;
+    curveValues[1] = curve.expo;
+    curveValues[2] = curve.superRate;
+    if (length < xWriteBufferLen) {
+        FormatFixedList((char*) pcWriteBuffer + length, xWriteBufferLen - length,
+                "deadband %1.3f, expo %1.3f, super rate %1.3f\r\n", curveValues, 3);
+    }
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Saves the current stick curves to flash
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISaveStickCurves(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    if (FCB_OK != SaveStickCurves()) {
+        strncpy((char*) pcWriteBuffer, "Failed to save stick curves, UAV must be in idle mode\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    strncpy((char*) pcWriteBuffer, "Stick curves saved\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print the thrust curves
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetThrustCurves(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    char* thrustCurvesString = cliPrintBuffer.thrustCurves;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+
+    PrintThrustCurves(thrustCurvesString, THRUST_CURVES_MAX_STRING_SIZE);
+    ComSessionSendString(thrustCurvesString);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Sets the thrust curve of a motor, e.g. fitted offline to load cell data
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetThrustCurve(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    portBASE_TYPE xParameterStringLength;
+    ThrustCurveType curve;
+    long motor;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    motor = strtol((char*) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength), NULL, 10);
+    curve.c[0] = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength), NULL);
+    curve.c[1] = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 3, &xParameterStringLength), NULL);
+    curve.c[2] = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 4, &xParameterStringLength), NULL);
+
+    if (motor < 1 || motor > MOTOR_OUTPUT_CHANNELS || FCB_OK != SetThrustCurve((uint8_t) (motor - 1), &curve)) {
+        strncpy((char*) pcWriteBuffer, "Invalid motor or thrust curve, it must rise over the output range and the UAV must be in idle mode\r\n",
+                xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Thrust curve of motor %ld set\r\n", motor);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Saves the current thrust curves to flash
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISaveThrustCurves(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    if (FCB_OK != SaveThrustCurves()) {
+        strncpy((char*) pcWriteBuffer, "Failed to save thrust curves, UAV must be in idle mode\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    strncpy((char*) pcWriteBuffer, "Thrust curves saved\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to spin one motor at a fixed output for the thrust curve identification
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIThrustTest(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    portBASE_TYPE xParameterStringLength;
+    float32_t output;
+    long motor;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    motor = strtol((char*) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength), NULL, 10);
+    output = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength), NULL);
+
+    if (0 == motor) {
+        StopThrustTest();
+        strncpy((char*) pcWriteBuffer, "Thrust test stopped\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    if (motor < 0 || motor > MOTOR_OUTPUT_CHANNELS || FCB_OK != StartThrustTest((uint8_t) (motor - 1), output)) {
+        strncpy((char*) pcWriteBuffer, "Invalid motor or output, the UAV must be in idle mode\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    FormatFixedList((char*) pcWriteBuffer, xWriteBufferLen, "Thrust test output %1.3f, record the thrust with thrust-point\r\n",
+            &output, 1);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to record the load cell thrust at the output of the thrust test
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIThrustPoint(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    portBASE_TYPE xParameterStringLength;
+    float32_t thrust;
 
-    /* Update return value and parameter index */
-    if (lParameterNumber == echoCommand.cExpectedNumberOfParameters) {
-        /* If this is the last parameter then there are no more strings to return after this one. */
-        xReturn = pdFALSE;
-        lParameterNumber = 0;
-    } else {
-        /* There are more parameters to return after this one. */
-        xReturn = pdTRUE;
-        lParameterNumber++;
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    thrust = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength), NULL);
+
+    if (FCB_OK != AddThrustTestPoint(thrust)) {
+        strncpy((char*) pcWriteBuffer, "Thrust point not recorded, no thrust test running or all points used\r\n",
+                xWriteBufferLen);
+        return pdFALSE;
     }
 
-    return xReturn;
+    strncpy((char*) pcWriteBuffer, "Thrust point recorded\r\n", xWriteBufferLen);
+
+    return pdFALSE;
 }
 
 /**
- * @brief  Implements the CLI command to echo a specific amount of data (size specified by parameter)
+ * @brief  Implements CLI command to fit and set the thrust curve of the tested motor
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIEchoData(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
-    int8_t *pcParameter;
-    portBASE_TYPE xParameterStringLength, xReturn;
-    static portBASE_TYPE lParameterNumber = 0;
+static portBASE_TYPE CLIFitThrustCurve(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    ThrustCurveType curve;
+    float32_t values[4];
+    uint8_t motor;
+    size_t length;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    StopThrustTest();
+    if (FCB_OK != FitThrustTestCurve(&curve, &values[3], &motor)) {
+        snprintf((char*) pcWriteBuffer, xWriteBufferLen,
+                "No valid thrust curve fitted, at least %u points over the output range are needed\r\n",
+                THRUST_TEST_MIN_POINTS);
+        return pdFALSE;
+    }
+
+    length = snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Thrust curve of motor %u set to ", motor + 1);
+    values[0] = curve.c[0];
+    values[1] = curve.c[1];
+    values[2] = curve.c[2];
+    if (length < xWriteBufferLen) {
+        FormatFixedList((char*) pcWriteBuffer + length, xWriteBufferLen - length,
+                "c0 %1.4f, c1 %1.4f, c2 %1.4f, RMS error %1.4f N\r\n", values, 4);
+    }
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to unlock the motor test with the props-off confirmation
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIMotorTestUnlock(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
 
     /* Check the write buffer is not NULL */
     configASSERT(pcWriteBuffer);
 
-    if (lParameterNumber == 0) {
-        /* The first time the function is called after the command has been
-		 entered just a header string is returned. */
-        strncpy((char*) pcWriteBuffer, "Received data:\r\n", xWriteBufferLen);
-    } else if (lParameterNumber == 1) {
-        /* Obtain the parameter string. */
-        pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
-                lParameterNumber, /* Return the next parameter. */
-                &xParameterStringLength /* Store the parameter string length. */
-        );
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
 
-        /* Sanity check something was returned. */
-        configASSERT(pcParameter);
+    if (FCB_OK != UnlockMotorTest((const char*) pcParameter, (size_t) xParameterStringLength)) {
+        strncpy((char*) pcWriteBuffer, "Not unlocked, confirm with props-off in idle mode with the CLI connected over USB\r\n",
+                xWriteBufferLen);
+        return pdFALSE;
+    }
 
-        // Convert pcParameter string to equivalent int to get the length of the following data
-        int dataLength = atoi((char*) pcParameter);
+    strncpy((char*) pcWriteBuffer, "Motor test unlocked, the propellers must stay off\r\n", xWriteBufferLen);
 
-        /* Check that data length is a positive integer and within buffer bounds */
-        if (!IS_POS(dataLength))
-            return pdFALSE;
+    return pdFALSE;
+}
 
-        memset(pcWriteBuffer, 0x00, xWriteBufferLen);
-        int previousRxBufferCount = -1; // Init to -1 so that while loop is iterated at least once
+/**
+ * @brief  Implements CLI command to stop the motor test or the ESC calibration and lock them
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIMotorTestLock(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
 
-        /* Check that new data is being received */
-        while (previousRxBufferCount != USBCOMRxFIFOBuffer.count) {
-            if (dataLength <= USBCOMRxFIFOBuffer.count) {
-                /* Read out the data */
-                ErrorStatus bufferStatus = SUCCESS;
-                uint16_t i = 0;
-                uint8_t getByte;
-                while (bufferStatus == SUCCESS && i < dataLength && i <= xWriteBufferLen) {
-                    bufferStatus = FIFOBufferGetByte(&USBCOMRxFIFOBuffer, &getByte);
-
-                    if (bufferStatus == SUCCESS)
-                        pcWriteBuffer[i] = getByte;
-
-                    i++;
-                }
+    LockMotorTest();
+    strncpy((char*) pcWriteBuffer, "Motor test locked\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to spin one motor at a fixed output for a duration
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIMotorTest(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    portBASE_TYPE xParameterStringLength;
+    float32_t output;
+    long motor;
+    long duration;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    motor = strtol((char*) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength), NULL, 10);
+    output = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength), NULL);
+    duration = strtol((char*) FreeRTOS_CLIGetParameter(pcCommandString, 3, &xParameterStringLength), NULL, 10);
+
+    if (0 == motor) {
+        StopMotorTest();
+        strncpy((char*) pcWriteBuffer, "Motor test stopped\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    if (motor < 0 || motor > MOTOR_OUTPUT_CHANNELS || duration <= 0 || duration > MOTOR_TEST_MAX_DURATION
+            || FCB_OK != StartMotorTest((uint8_t) (motor - 1), output, (uint16_t) duration)) {
+        strncpy((char*) pcWriteBuffer, "Invalid motor, output or duration, or the motor test is locked\r\n",
+                xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Motor %ld spinning for %ld ms\r\n", motor, duration);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print the state of the motor test and the ESC calibration
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIMotorTestStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    PrintMotorTestStatus((char*) pcWriteBuffer, xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to step through the ESC endpoint calibration
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIEscCalibrate(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    MotorTestStatusType status;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
 
-                /* If there is data left in the buffer, it is likely the next command to be handled by the CLI.
-                 * Give semaphore to wake up USB RX thread to start handling this. */
-                if (USBCOMRxFIFOBuffer.count > 0)
-                    xSemaphoreGive(USBCOMRxDataSem);
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
 
-                previousRxBufferCount = USBCOMRxFIFOBuffer.count; // Set this to exit while loop
+    if (5 == xParameterStringLength && 0 == strncmp((const char*) pcParameter, "start", xParameterStringLength)) {
+        if (FCB_OK != StartEscCalibration()) {
+            strncpy((char*) pcWriteBuffer, "Not started, the motor test is locked or the ESC:s use DShot\r\n",
+                    xWriteBufferLen);
+        } else {
+            strncpy((char*) pcWriteBuffer,
+                    "Max pulse out, connect the ESC battery, wait for the tones, then esc-calibrate next\r\n",
+                    xWriteBufferLen);
+        }
+    } else if (4 == xParameterStringLength && 0 == strncmp((const char*) pcParameter, "next", xParameterStringLength)) {
+        if (FCB_OK != NextEscCalibrationStep()) {
+            strncpy((char*) pcWriteBuffer, "No ESC calibration running\r\n", xWriteBufferLen);
+        } else {
+            GetMotorTestStatus(&status);
+            if (MOTOR_TEST_ESC_CALIBRATION_LOW == status.state) {
+                strncpy((char*) pcWriteBuffer, "Min pulse out, wait for the tones, then esc-calibrate next\r\n",
+                        xWriteBufferLen);
             } else {
-                previousRxBufferCount = USBCOMRxFIFOBuffer.count;
-                /*/ Pend on USBComRxDataSem for MAX_DATA_TRANSFER_DELAY while waiting for data to enter RX buffer */
-                if (pdPASS != xSemaphoreTake(USBCOMRxDataSem, MAX_DATA_TRANSFER_DELAY)) {
-                    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
-                    strncpy((char*) pcWriteBuffer, "Data transmission timed out.\r\n", xWriteBufferLen);
-                }
+                strncpy((char*) pcWriteBuffer, "ESC calibration done\r\n", xWriteBufferLen);
             }
         }
+    } else if (5 == xParameterStringLength
+            && 0 == strncmp((const char*) pcParameter, "abort", xParameterStringLength)) {
+        StopMotorTest();
+        strncpy((char*) pcWriteBuffer, "ESC calibration aborted\r\n", xWriteBufferLen);
     } else {
-        /* Return new line */
-        memset(pcWriteBuffer, 0x00, xWriteBufferLen);
-        strncpy((char*) pcWriteBuffer, "\r\n", xWriteBufferLen);
+        strncpy((char*) pcWriteBuffer, "Invalid argument, use start, next or abort\r\n", xWriteBufferLen);
     }
 
-    /* Update return value and parameter index */
-    if (lParameterNumber == echoDataCommand.cExpectedNumberOfParameters + 1) // Added +1 to output \r\n
-    {
-        /* If this is the last of the parameters then there are no more strings to return after this one. */
-        xReturn = pdFALSE;
-        lParameterNumber = 0;
-    } else {
-        /* There are more parameters/data to return after this one. */
-        xReturn = pdTRUE;
-        lParameterNumber++;
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to print the pulses of the analog protocols
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetEscOutputs(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    EscOutputsType outputs;
+
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    GetEscOutputs(&outputs);
+    snprintf((char*) pcWriteBuffer, xWriteBufferLen, "ESC outputs: min %u us, idle %u us, max %u us\r\n",
+            outputs.minPulse, outputs.idlePulse, outputs.maxPulse);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to set the pulses of the analog protocols
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetEscOutputs(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    portBASE_TYPE xParameterStringLength;
+    EscOutputsType outputs;
+    long pulses[3];
+    uint8_t i;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    for (i = 0; i < 3; i++) {
+        pulses[i] = strtol((char*) FreeRTOS_CLIGetParameter(pcCommandString, i + 1, &xParameterStringLength), NULL,
+                10);
+        if (pulses[i] <= 0 || pulses[i] > UINT16_MAX) {
+            strncpy((char*) pcWriteBuffer, "Invalid ESC outputs\r\n", xWriteBufferLen);
+            return pdFALSE;
+        }
+    }
+    outputs.minPulse = (uint16_t) pulses[0];
+    outputs.idlePulse = (uint16_t) pulses[1];
+    outputs.maxPulse = (uint16_t) pulses[2];
+
+    if (FCB_OK != SetEscOutputs(&outputs)) {
+        strncpy((char*) pcWriteBuffer,
+                "Invalid ESC outputs, min <= idle < max within the pulse period, the UAV must be in idle mode\r\n",
+                xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    strncpy((char*) pcWriteBuffer, "ESC outputs set, see save-esc-outputs\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to save the pulses of the analog protocols to flash
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISaveEscOutputs(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    if (FCB_OK != SaveEscOutputs()) {
+        strncpy((char*) pcWriteBuffer, "ESC outputs not saved, the UAV must be in idle mode\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    strncpy((char*) pcWriteBuffer, "ESC outputs saved\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+#ifdef FCB_CRASH_DETECTION
+
+/**
+ * @brief  Implements CLI command to print the crash detection settings and status
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGetCrashDetection(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    PrintCrashDetection((char*) pcWriteBuffer, xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to set the crash detection settings
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetCrashDetection(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString) {
+    portBASE_TYPE xParameterStringLength;
+    CrashDetectionSettingsType settings;
+
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
+
+    settings.impactAcceleration = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 1,
+            &xParameterStringLength), NULL);
+    settings.impactTime = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength), NULL);
+    settings.tumbleTime = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 3, &xParameterStringLength), NULL);
+    settings.invertedTime = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 4, &xParameterStringLength),
+            NULL);
+
+    if (FCB_OK != SetCrashDetectionSettings(&settings)) {
+        strncpy((char*) pcWriteBuffer,
+                "Invalid settings, impact acceleration in (1, 16] g and times in [0, 10] s\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    strncpy((char*) pcWriteBuffer, "Crash detection set, see save-crash-detection\r\n", xWriteBufferLen);
+
+    return pdFALSE;
+}
+
+/**
+ * @brief  Implements CLI command to save the crash detection settings to flash
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISaveCrashDetection(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+        const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
+
+    if (FCB_OK != SaveCrashDetectionSettings()) {
+        strncpy((char*) pcWriteBuffer, "Crash detection not saved, the UAV must be in idle mode\r\n",
+                xWriteBufferLen);
+        return pdFALSE;
     }
 
-    return xReturn;
+    strncpy((char*) pcWriteBuffer, "Crash detection saved\r\n", xWriteBufferLen);
+
+    return pdFALSE;
 }
+#endif
+
+#ifdef FCB_MOTOR_FAILURE_DETECTION
 
 /**
- * @brief  Implements the CLI command to start receiver calibration
+ * @brief  Implements CLI command to print the motor failure detection settings and status
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIStartReceiverCalibration(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
-        const int8_t* pcCommandString) {
-    int8_t* pcParameter;
-    portBASE_TYPE xParameterStringLength;
-    portBASE_TYPE lParameterNumber = 0;
+static portBASE_TYPE CLIGetMotorFailure(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
 
-    /* Empty pcWriteBuffer so no strange output is sent as command response */
-    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+    PrintMotorFailure((char*) pcWriteBuffer, xWriteBufferLen);
 
-    lParameterNumber++;
+    return pdFALSE;
+}
 
-    /* Obtain the parameter string. */
-    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
-            lParameterNumber, /* Return the next parameter. */
-            &xParameterStringLength /* Store the parameter string length. */
-    );
+/**
+ * @brief  Implements CLI command to set the motor failure detection settings
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetMotorFailure(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    portBASE_TYPE xParameterStringLength;
+    MotorFailureSettingsType settings;
 
-    /* Sanity check something was returned. */
-    configASSERT(pcParameter);
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
 
-    /* Start the receiver calibration procedure */
-    if (StartReceiverCalibration())
-        strncpy((char*) pcWriteBuffer,
-                "RC receiver calibration started. Please saturate all RC transmitter control sticks and toggle switches.\r\n",
+    settings.detectionTime = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength),
+            NULL);
+    settings.residualShare = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength),
+            NULL);
+
+    if (FCB_OK != SetMotorFailureSettings(&settings)) {
+        strncpy((char*) pcWriteBuffer, "Invalid settings, detection time in [0, 2] s and residual share in (0, 1]\r\n",
                 xWriteBufferLen);
-    else
-        strncpy((char*) pcWriteBuffer, "RC receiver calibration could not be started.\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    strncpy((char*) pcWriteBuffer, "Motor failure detection set, see save-motor-failure\r\n", xWriteBufferLen);
 
-    /* Return false to indicate command activity finished */
     return pdFALSE;
 }
 
 /**
- * @brief  Implements the CLI command to stop receiver calibration
+ * @brief  Implements CLI command to save the motor failure detection settings to flash
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIStopReceiverCalibration(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
-        const int8_t* pcCommandString) {
+static portBASE_TYPE CLISaveMotorFailure(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
     /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
     (void) pcCommandString;
     configASSERT(pcWriteBuffer);
 
-    /* Stop the receiver calibration procedure */
-    ReceiverErrorStatus rcCalStatus = StopReceiverCalibration();
-    strncpy((char*) pcWriteBuffer, "RC receiver calibration stopped\r\n", xWriteBufferLen);
-    if (rcCalStatus)
-        strncat((char*) pcWriteBuffer, "RC receiver calibration successful\r\n",
-                xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
-    else
-        strncat((char*) pcWriteBuffer, "RC receiver calibration failed\r\n",
-                xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+    if (FCB_OK != SaveMotorFailureSettings()) {
+        strncpy((char*) pcWriteBuffer, "Motor failure detection not saved, the UAV must be in idle mode\r\n",
+                xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    strncpy((char*) pcWriteBuffer, "Motor failure detection saved\r\n", xWriteBufferLen);
 
-    /* Return false to indicate command activity finished */
     return pdFALSE;
 }
+#endif
+
+#ifdef FCB_USB_MASS_STORAGE
 
 /**
- * @brief  Implements the CLI command to reset receiver calibration to default values
+ * @brief  Implements CLI command to print the USB mass storage status
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIResetReceiverCalibration(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
-        const int8_t* pcCommandString) {
+static portBASE_TYPE CLIGetUSBMsc(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
     /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
     (void) pcCommandString;
     configASSERT(pcWriteBuffer);
 
-    /* Resets calibration values to default */
-    ResetReceiverCalibrationValues();
-    strncpy((char*) pcWriteBuffer, "RC receiver calibration set to default values.\r\n", xWriteBufferLen);
+    PrintUSBMscStatus((char*) pcWriteBuffer, xWriteBufferLen);
 
-    /* Return false to indicate command activity finished */
     return pdFALSE;
 }
 
 /**
- * @brief  Implements the CLI command to print receiver values with or without serialization
+ * @brief  Implements CLI command to insert or eject the USB mass storage medium
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIGetReceiver(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString) {
-    int8_t* pcParameter;
+static portBASE_TYPE CLISetUSBMsc(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
     portBASE_TYPE xParameterStringLength;
-    portBASE_TYPE lParameterNumber = 0;
-
-    bool protoStatus;
-    uint8_t serializedData[ReceiverSignalValuesProto_size];
-    ReceiverSignalValuesProto receiverSignalsProto;
-
-    /* Empty pcWriteBuffer so no strange output is sent as command response */
-    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
-    lParameterNumber++;
-
-    /* Obtain the parameter string. */
-    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
-            lParameterNumber, /* Return the next parameter. */
-            &xParameterStringLength /* Store the parameter string length. */
-    );
-
-    /* Sanity check something was returned. */
-    configASSERT(pcParameter);
-
-    /* Get the current receiver values */
-    switch (pcParameter[0]) {
-    case 'n':
-        if(outCnt == 0) {
-            strncpy((char*) pcWriteBuffer, "Receiver\nStatus: ", xWriteBufferLen);
-            if (IsReceiverActive()) {
-                strncat((char*) pcWriteBuffer, "ACTIVE\n", xWriteBufferLen - strlen((char*)pcWriteBuffer) - 1);
-            }
-            else {
-                strncat((char*) pcWriteBuffer, "INACTIVE\n", xWriteBufferLen - strlen((char*)pcWriteBuffer) - 1);
-            }
-            outCnt = 2;
-        }
-        else {
-            snprintf((char*) pcWriteBuffer, xWriteBufferLen,
-                    "Throttle: %d\nAileron: %d\nElevator: %d\nRudder: %d\nGear: %d\nAux1: %d\n\r\n",
-                    GetThrottleReceiverChannel(), GetAileronReceiverChannel(), GetElevatorReceiverChannel(),
-                    GetRudderReceiverChannel(), GetGearReceiverChannel(), GetAux1ReceiverChannel());
-        }
-
-        break;
-    case 'p':
-        receiverSignalsProto.has_is_active = true;
-        receiverSignalsProto.has_throttle = true;
-        receiverSignalsProto.has_aileron = true;
-        receiverSignalsProto.has_elevator = true;
-        receiverSignalsProto.has_rudder = true;
-        receiverSignalsProto.has_gear = true;
-        receiverSignalsProto.has_aux1 = true;
-        receiverSignalsProto.is_active = IsReceiverActive();
-        receiverSignalsProto.throttle = GetThrottleReceiverChannel();
-        receiverSignalsProto.aileron = GetAileronReceiverChannel();
-        receiverSignalsProto.elevator = GetElevatorReceiverChannel();
-        receiverSignalsProto.rudder = GetRudderReceiverChannel();
-        receiverSignalsProto.gear = GetGearReceiverChannel();
-        receiverSignalsProto.aux1 = GetAux1ReceiverChannel();
-
-        /* Create a stream that will write to our buffer and encode the data with protocol buffer */
-        pb_ostream_t protoStream = pb_ostream_from_buffer(serializedData, ReceiverSignalValuesProto_size);
-        protoStatus = pb_encode(&protoStream, ReceiverSignalValuesProto_fields, &receiverSignalsProto);
-
-        /* Insert header to the sample string, then copy the data after that */
-        // TODO Make Function that builds/encapsulates the message
-        uint32_t crc = CalculateCRC(serializedData, protoStream.bytes_written);
-        uint8_t msg_id = RC_VALUES_MSG_ENUM;
-        uint16_t msg_data_size = (uint16_t)protoStream.bytes_written;
-        memcpy(pcWriteBuffer, &msg_id, 1);
-        memcpy(&pcWriteBuffer[1], &crc, 4);
-        memcpy(&pcWriteBuffer[5], &msg_data_size, 2);
-        if(PROTO_HEADER_LEN + protoStream.bytes_written + strlen("\r\n") < xWriteBufferLen) {
-        	memcpy(&pcWriteBuffer[PROTO_HEADER_LEN], serializedData, protoStream.bytes_written);
-        	memcpy(&pcWriteBuffer[PROTO_HEADER_LEN+protoStream.bytes_written], "\r\n", strlen("\r\n"));
-        }
 
-        if(!protoStatus) {
-            ErrorHandler();
-        }
-
-        dataOutLength = PROTO_HEADER_LEN + protoStream.bytes_written + strlen("\r\n"); // Set output data length
-
-        break;
-    default:
-        strncpy((char*) pcWriteBuffer, "Invalid parameter\r\n", xWriteBufferLen);
-        break;
-    }
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
 
-    if(outCnt > 0) {
-        outCnt--;
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    if (1 != xParameterStringLength || ('0' != pcParameter[0] && '1' != pcParameter[0])) {
+        strncpy((char*) pcWriteBuffer, "Invalid parameter, use 0 or 1\r\n", xWriteBufferLen);
+        return pdFALSE;
     }
 
-    if(outCnt == 0) {
-        return pdFALSE; /* Return false to indicate command activity finished */
+    if (FCB_OK != USBMscSetMedium('1' == pcParameter[0])) {
+        strncpy((char*) pcWriteBuffer, "USB drive not inserted, the UAV must be disarmed\r\n", xWriteBufferLen);
+    } else if ('1' == pcParameter[0]) {
+        strncpy((char*) pcWriteBuffer, "USB drive inserted, it is ejected on arming\r\n", xWriteBufferLen);
     } else {
-        return pdTRUE; /* Return true to indicate more command activity to follow */
+        strncpy((char*) pcWriteBuffer, "USB drive ejected\r\n", xWriteBufferLen);
     }
+
+    return pdFALSE;
 }
+#endif
 
 /**
- * @brief  Implements the CLI command to print receiver calibration values
+ * @brief  Implements CLI command to apply a saved parameter profile
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIGetReceiverCalibration(int8_t *pcWriteBuffer, size_t xWriteBufferLen,
-        const int8_t *pcCommandString) {
-
-    static uint8_t currentChannelPrint = 0;
+static portBASE_TYPE CLIProfileSelect(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    portBASE_TYPE xParameterStringLength;
+    long profile;
 
-    /* Remove compile time warnings about unused parameters, and check the
-	 write buffer is not NULL */
-    (void) pcCommandString;
+    /* Check the write buffer is not NULL */
     configASSERT(pcWriteBuffer);
-    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
 
-    /* Get the current receiver values */
-    switch (currentChannelPrint) {
-    case 0:
-        strncpy((char*) pcWriteBuffer,
-                "Receiver channel calibration values:\r\nNOTE: Values are specified in timer ticks.\r\n",
-                xWriteBufferLen);
-        break;
-    case 1:
-        snprintf((char*) pcWriteBuffer, xWriteBufferLen,
-                "Throttle Max: %u\nThrottle Mid: %u\nThrottle Min: %u\nAileron Max: %u\nAileron Mid: %u\nAileron Min: %u\nElevator Max: %u\nElevator Mid: %u\nElevator Min: %u\nRudder Max: %u\nRudder Mid: %u\nRudder Min: %u\n",
-                GetThrottleReceiverCalibrationMaxValue(), GetThrottleReceiverCalibrationMidValue(), GetThrottleReceiverCalibrationMinValue(),
-                GetAileronReceiverCalibrationMaxValue(), GetAileronReceiverCalibrationMidValue(), GetAileronReceiverCalibrationMinValue(),
-                GetElevatorReceiverCalibrationMaxValue(), GetElevatorReceiverCalibrationMidValue(), GetElevatorReceiverCalibrationMinValue(),
-                GetRudderReceiverCalibrationMaxValue(), GetRudderReceiverCalibrationMidValue(), GetRudderReceiverCalibrationMinValue());
-        break;
-    case 2:
-        snprintf((char*) pcWriteBuffer, xWriteBufferLen,
-                "Gear Max: %u\nGear Mid: %u\nGear Min: %u\nAux1 Max: %u\nAux1 Mid: %u\nAux1 Min: %u\n\r\n",
-                GetGearReceiverCalibrationMaxValue(), GetGearReceiverCalibrationMidValue(), GetGearReceiverCalibrationMinValue(),
-                GetAux1ReceiverCalibrationMaxValue(), GetAux1ReceiverCalibrationMidValue(), GetAux1ReceiverCalibrationMinValue());
-        break;
-    default:
-        // memset(pcWriteBuffer, 0x00, xWriteBufferLen);
-        strncpy((char*) pcWriteBuffer, "\r\n", xWriteBufferLen);
-        /* Reset receiver print iteration number*/
-        currentChannelPrint = 0;
-        /* Return false to indicate command activity finished */
+    profile = strtol((char*) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength), NULL, 10);
+
+    if (profile < 1 || profile > PARAM_PROFILE_NBR || FCB_OK != SelectParamProfile((uint8_t) (profile - 1))) {
+        snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Invalid profile, 1 to %u, or the profile is not saved\r\n",
+                PARAM_PROFILE_NBR);
         return pdFALSE;
     }
 
-    currentChannelPrint++;
-    /* Return true to indicate command activity not yet completed */
-    return pdTRUE;
+    snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Profile %ld selected\r\n", profile);
+
+    return pdFALSE;
 }
 
 /**
- * @brief  Starts receiver sampling for a specified sample time and duration
+ * @brief  Implements CLI command to save the current parameters to a profile
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIStartReceiverSampling(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
-        const int8_t* pcCommandString) {
-    int8_t* pcParameter;
-    portBASE_TYPE xParameterStringLength, xReturn;
-    static portBASE_TYPE lParameterNumber = 0;
+static portBASE_TYPE CLIProfileSave(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    portBASE_TYPE xParameterStringLength;
+    long profile;
 
     /* Check the write buffer is not NULL */
     configASSERT(pcWriteBuffer);
 
-    if (lParameterNumber == 0) {
-        /* The first time the function is called after the command has been entered just a header string is returned. */
-        strncpy((char*) pcWriteBuffer, "Starting print sampling of receiver values\r\n", xWriteBufferLen);
-    } else {
-        uint16_t receiverSampleTime;
-        uint16_t receiverSampleDuration;
+    profile = strtol((char*) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength), NULL, 10);
 
-        /* Obtain the parameter string */
-        pcParameter = (int8_t*) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
-                lParameterNumber, /* Return the next parameter. */
-                &xParameterStringLength /* Store the parameter string length. */
-        );
+    if (profile < 1 || profile > PARAM_PROFILE_NBR || FCB_OK != SaveParamProfile((uint8_t) (profile - 1))) {
+        snprintf((char*) pcWriteBuffer, xWriteBufferLen,
+                "Profile not saved, 1 to %u, the UAV must be in idle mode\r\n", PARAM_PROFILE_NBR);
+        return pdFALSE;
+    }
 
-        /* Sanity check something was returned. */
-        configASSERT(pcParameter);
+    snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Profile %ld saved\r\n", profile);
 
-        strncpy((char*) pcWriteBuffer, "Sample time (ms): ", xWriteBufferLen);
+    return pdFALSE;
+}
 
-        size_t paramMaxSize;
-        if ((unsigned long) xParameterStringLength > xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1)
-            paramMaxSize = xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1;
-        else
-            paramMaxSize = xParameterStringLength;
+/**
+ * @brief  Implements CLI command to print the active and the saved parameter profiles
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIProfileStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
 
-        strncat((char*) pcWriteBuffer, (char*) pcParameter, paramMaxSize);
-        strncat((char*) pcWriteBuffer, "\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+    PrintParamProfiles((char*) pcWriteBuffer, xWriteBufferLen);
 
-        receiverSampleTime = atoi((char*) pcParameter);
+    return pdFALSE;
+}
 
-        lParameterNumber++;
+/**
+ * @brief  Implements CLI command to configure the gyro filter and store it
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetGyroFilter(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    portBASE_TYPE xParameterStringLength;
+    FcbSensorFilterConfigType config;
+    uint8_t i;
 
-        pcParameter = (int8_t*) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
-                lParameterNumber, /* Return the next parameter. */
-                &xParameterStringLength /* Store the parameter string length. */);
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
 
-        /* Sanity check something was returned. */
-        configASSERT(pcParameter);
+    config.lowPassCutoffHz = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength),
+            NULL);
+    for (i = 0; i < SENSOR_FILTER_MAX_NOTCHES; i++) {
+        config.notchCenterHz[i] = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 2*i + 2,
+                &xParameterStringLength), NULL);
+        config.notchQ[i] = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 2*i + 3,
+                &xParameterStringLength), NULL);
+    }
 
-        strncat((char*) pcWriteBuffer, "Duration (s): ", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+    if (FCB_OK != SensorFilterConfig(GYRO_IDX, &config)) {
+        strncpy((char*) pcWriteBuffer, "Invalid gyro filter, the frequencies must be below the Nyquist frequency\r\n",
+                xWriteBufferLen);
+        return pdFALSE;
+    }
 
-        if ((unsigned long) xParameterStringLength > xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1)
-            paramMaxSize = xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1;
-        else
-            paramMaxSize = xParameterStringLength;
+    strncpy((char*) pcWriteBuffer, "Gyro filter set and saved\r\n", xWriteBufferLen);
 
-        strncat((char*) pcWriteBuffer, (char*) pcParameter, paramMaxSize);
-        strncat((char*) pcWriteBuffer, "\n\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+    return pdFALSE;
+}
 
-        receiverSampleDuration = atoi((char*) pcParameter);
+/**
+ * @brief  Implements CLI command to set the data rate and on-chip filters of a sensor
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetSensorTiming(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    static const char* sensorNames[SENSOR_TIMING_SENSOR_NBR] = { "gyro", "acc", "mag" };
+    const int8_t *pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    FcbSensorTimingConfigType config;
+    uint8_t sensor;
 
-        StartReceiverSamplingTask(receiverSampleTime, receiverSampleDuration);
+    configASSERT(pcWriteBuffer);
+
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    for (sensor = 0; sensor < SENSOR_TIMING_SENSOR_NBR; sensor++) {
+        if (strlen(sensorNames[sensor]) == (size_t) xParameterStringLength
+                && 0 == strncmp((const char*) pcParameter, sensorNames[sensor], xParameterStringLength)) {
+            break;
+        }
+    }
+    if (sensor >= SENSOR_TIMING_SENSOR_NBR) {
+        strncpy((char*) pcWriteBuffer, "Unknown sensor, valid are gyro, acc and mag\r\n", xWriteBufferLen);
+        return pdFALSE;
     }
 
-    /* Update return value and parameter index */
-    if (lParameterNumber == startReceiverSamplingCommand.cExpectedNumberOfParameters) {
-        /* If this is the last parameter then there are no more strings to return after this one. */
-        xReturn = pdFALSE;
-        lParameterNumber = 0;
-    } else {
-        /* There are more parameters to return after this one. */
-        xReturn = pdTRUE;
-        lParameterNumber++;
+    config.dataRateHz = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength), NULL);
+    config.lowPassHz = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 3, &xParameterStringLength), NULL);
+    config.highPassHz = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 4, &xParameterStringLength), NULL);
+
+    if (FCB_OK != SetSensorTiming((FcbSensorIndexType) sensor, &config)) {
+        strncpy((char*) pcWriteBuffer, "Sensor timing refused, not in idle mode, a change is pending, or the filter "
+                "frequencies are not below the Nyquist frequency\r\n", xWriteBufferLen);
+        return pdFALSE;
     }
 
-    return xReturn;
+    strncpy((char*) pcWriteBuffer, "Sensor timing set and saved, see get-sensor-rates for the rates in use\r\n",
+            xWriteBufferLen);
+
+    return pdFALSE;
 }
 
 /**
- * @brief  Stops printing of receiver sample values
+ * @brief  Implements CLI command to reboot to the ROM bootloader
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIStopReceiverSampling(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
+static portBASE_TYPE CLIRebootBootloader(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
         const int8_t* pcCommandString) {
-    /* Remove compile time warnings about unused parameters, and check the
-	 write buffer is not NULL */
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
     (void) pcCommandString;
     configASSERT(pcWriteBuffer);
 
-    strncpy((char*) pcWriteBuffer, "Stopping printing of receiver sample values...\r\n", xWriteBufferLen);
+    if (FCB_OK != RebootToBootloader()) {
+        strncpy((char*) pcWriteBuffer, "Not rebooted, the UAV must be in idle mode\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
 
-    /* Stop the receiver printing task */
-    StopReceiverSamplingTask();
+    strncpy((char*) pcWriteBuffer, "Rebooting to the USB DFU bootloader\r\n", xWriteBufferLen);
 
     return pdFALSE;
 }
 
 /**
- * @brief  Implements CLI command to print the last sampled sensor values
+ * @brief  Implements CLI command to print the firmware version and image info
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIGetSensors(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+static portBASE_TYPE CLIFirmwareInfo(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
     /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
-    int8_t* pcParameter;
-    portBASE_TYPE xParameterStringLength;
-    portBASE_TYPE lParameterNumber = 0;
-
-    float32_t accX, accY, accZ, gyroX, gyroY, gyroZ, magX, magY, magZ;
-    bool protoStatus;
-    uint8_t serializedData[SensorSamplesProto_size];
-    SensorSamplesProto sensorProto;
-
-    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    (void) pcCommandString;
     configASSERT(pcWriteBuffer);
-    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
-
-    lParameterNumber++;
-
-    /* Obtain the parameter string. */
-    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
-            lParameterNumber, /* Return the next parameter. */
-            &xParameterStringLength /* Store the parameter string length. */
-    );
-
-    /* Sanity check something was returned. */
-    configASSERT(pcParameter);
-
-    /* Get the current sensor values */
-    switch (pcParameter[0]) {
-    case 'n':
-        if (outCnt == 0) {
-            /* Get the latest sensor values */
-            GetAcceleration(&accX, &accY, &accZ);
-            snprintf((char*) pcWriteBuffer, xWriteBufferLen,
-                    "Accelerometer [m/s^2]\nAccX: %1.3f\nAccY: %1.3f\nAccZ: %1.3f\r\n", accX, accY, accZ);
-            outCnt = 3;
-        } else if (outCnt == 2) {
-            GetGyroAngleDot(&gyroX, &gyroY, &gyroZ);
-            snprintf((char*) pcWriteBuffer, xWriteBufferLen,
-                    "Gyroscope [rad/s]\nGyroX: %1.3f\nGyroY: %1.3f\nGyroZ: %1.3f\r\n", gyroX, gyroY, gyroZ);
-        } else {
-            GetMagVector(&magX, &magY, &magZ);
-            snprintf((char*) pcWriteBuffer, xWriteBufferLen,
-                    "Magnetometer [G]\nMagX: %1.3f\nMagY: %1.3f\nMagZ: %1.3f\r\n", magX, magY, magZ);
-        }
-
-        break;
-    case 'p':
-        GetAcceleration(&accX, &accY, &accZ);
-        GetGyroAngleDot(&gyroX, &gyroY, &gyroZ);
-        GetMagVector(&magX, &magY, &magZ);
-
-        sensorProto.has_accX = true;
-        sensorProto.has_accY = true;
-        sensorProto.has_accZ = true;
-        sensorProto.has_gyroX = true;
-        sensorProto.has_gyroY = true;
-        sensorProto.has_gyroZ = true;
-        sensorProto.has_magX = true;
-        sensorProto.has_magY = true;
-        sensorProto.has_magZ = true;
-        sensorProto.accX = accX;
-        sensorProto.accY = accY;
-        sensorProto.accZ = accZ;
-        sensorProto.gyroX = gyroX;
-        sensorProto.gyroY = gyroY;
-        sensorProto.gyroZ = gyroZ;
-        sensorProto.magX = magX;
-        sensorProto.magY = magY;
-        sensorProto.magZ = magZ;
 
-        /* Create a stream that will write to our buffer and encode the data with protocol buffer */
-        pb_ostream_t protoStream = pb_ostream_from_buffer(serializedData, SensorSamplesProto_size);
-        protoStatus = pb_encode(&protoStream, SensorSamplesProto_fields, &sensorProto);
+    PrintFirmwareInfo((char*) pcWriteBuffer, xWriteBufferLen);
 
+    return pdFALSE;
+}
 
-        /* Insert header to the sample string, then copy the data after that */
-        uint32_t crc = CalculateCRC(serializedData, protoStream.bytes_written);
-        uint8_t msg_id = FLIGHT_STATE_MSG_ENUM;
-        uint16_t msg_data_size = (uint16_t)protoStream.bytes_written;
-        memcpy(pcWriteBuffer, &msg_id, 1);
-        memcpy(&pcWriteBuffer[1], &crc, 4);
-        memcpy(&pcWriteBuffer[5], &msg_data_size, 2);
+/**
+ * @brief  Implements CLI command to print the task watchdog status
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIWatchdogStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
 
-        if(PROTO_HEADER_LEN + protoStream.bytes_written + strlen("\r\n") < xWriteBufferLen) {
-            memcpy(&pcWriteBuffer[PROTO_HEADER_LEN], serializedData, protoStream.bytes_written);
-            memcpy(&pcWriteBuffer[PROTO_HEADER_LEN+protoStream.bytes_written], "\r\n", strlen("\r\n"));
-        }
+    PrintTaskWatchdog((char*) pcWriteBuffer, xWriteBufferLen);
 
-        if (!protoStatus) {
-            ErrorHandler();
-        }
+    return pdFALSE;
+}
 
-        dataOutLength = PROTO_HEADER_LEN + protoStream.bytes_written + strlen("\r\n"); // Set output data length
+/**
+ * @brief  Implements CLI command to clear a watchdog reset, so that the UAV can be armed
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIWatchdogClear(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
 
-        break;
-    default:
-        strncpy((char*) pcWriteBuffer, "Invalid parameter\r\n", xWriteBufferLen);
-        break;
+    if (!IsWatchdogResetPending()) {
+        strncpy((char*) pcWriteBuffer, "The last reset was not by the watchdog\r\n", xWriteBufferLen);
+        return pdFALSE;
     }
 
-    if (outCnt > 0) {
-        outCnt--;
-    }
+    ClearWatchdogReset();
+    strncpy((char*) pcWriteBuffer, "Watchdog reset cleared, arming allowed\r\n", xWriteBufferLen);
 
-    if (outCnt == 0) {
-        return pdFALSE; /* Return false to indicate command activity finished */
-    } else {
-        return pdTRUE; /* Return true to indicate more command activity to follow */
-    }
+    return pdFALSE;
 }
 
 /**
- * @brief  Starts sensor sampling for a specified sample time and duration
+ * @brief  Implements CLI command to print the health report of the sensors
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIStartSensorSampling(int8_t* pcWriteBuffer, size_t xWriteBufferLen,
-        const int8_t* pcCommandString) {
-    int8_t* pcParameter;
-    portBASE_TYPE xParameterStringLength, xReturn;
-    static portBASE_TYPE lParameterNumber = 0;
-
-    /* Check the write buffer is not NULL */
+static portBASE_TYPE CLISensorHealth(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
     configASSERT(pcWriteBuffer);
 
-    if (lParameterNumber == 0) {
-        /* The first time the function is called after the command has been entered just a header string is returned. */
-        strncpy((char*) pcWriteBuffer, "Starting print sampling of sensor values...\r\n", xWriteBufferLen);
-    } else {
-        uint16_t sensorSampleTime;
-        uint16_t sensorSampleDuration;
+    PrintSensorHealthReport((char*) pcWriteBuffer, xWriteBufferLen);
 
-        /* Obtain the parameter string */
-        pcParameter = (int8_t*) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
-                lParameterNumber, /* Return the next parameter. */
-                &xParameterStringLength /* Store the parameter string length. */
-        );
+    return pdFALSE;
+}
 
-        /* Sanity check something was returned. */
-        configASSERT(pcParameter);
+/**
+ * @brief  Implements CLI command to print the active LED statuses
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLILedStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
 
-        strncpy((char*) pcWriteBuffer, "Sample time (ms): ", xWriteBufferLen);
+    PrintLedStatus((char*) pcWriteBuffer, xWriteBufferLen);
 
-        size_t paramMaxSize;
-        if ((unsigned long) xParameterStringLength > xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1)
-            paramMaxSize = xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1;
-        else
-            paramMaxSize = xParameterStringLength;
+    return pdFALSE;
+}
 
-        strncat((char*) pcWriteBuffer, (char*) pcParameter, paramMaxSize);
-        strncat((char*) pcWriteBuffer, "\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+/**
+ * @brief  Implements CLI command to print the sensor board orientation and level trim
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISensorOrientation(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
 
-        sensorSampleTime = atoi((char*) pcParameter);
+    PrintSensorOrientation((char*) pcWriteBuffer, xWriteBufferLen);
 
-        lParameterNumber++;
+    return pdFALSE;
+}
 
-        pcParameter = (int8_t*) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
-                lParameterNumber, /* Return the next parameter. */
-                &xParameterStringLength /* Store the parameter string length. */);
+#ifdef FCB_REDUNDANT_GYRO
+/**
+ * @brief  Implements CLI command to print the gyroscope voting
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLIGyroRedundancy(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
+    configASSERT(pcWriteBuffer);
 
-        /* Sanity check something was returned. */
-        configASSERT(pcParameter);
+    PrintGyroVote((char*) pcWriteBuffer, xWriteBufferLen);
 
-        strncat((char*) pcWriteBuffer, "Duration (s): ", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+    return pdFALSE;
+}
+#endif
 
-        if ((unsigned long) xParameterStringLength > xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1)
-            paramMaxSize = xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1;
-        else
-            paramMaxSize = xParameterStringLength;
+/**
+ * @brief  Implements CLI command to set the UART baud rate
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetUartBaudRate(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t *pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    uint32_t baudRate;
 
-        strncat((char*) pcWriteBuffer, (char*) pcParameter, paramMaxSize);
-        strncat((char*) pcWriteBuffer, "\n\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
 
-        sensorSampleDuration = atoi((char*) pcParameter);
+    pcParameter = FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    baudRate = strtoul((char*) pcParameter, NULL, 10);
 
-        /* Start the sensor sample printing task */
-        StartSensorSamplingTask(sensorSampleTime, sensorSampleDuration);
+    if (UART_OK != SetUartBaudRate(baudRate)) {
+        strncpy((char*) pcWriteBuffer, "Invalid baud rate, valid range is [9600, 2000000]\r\n", xWriteBufferLen);
+        return pdFALSE;
     }
 
-    /* Update return value and parameter index */
-    if (lParameterNumber == startSensorSamplingCommand.cExpectedNumberOfParameters) {
-        /* If this is the last parameter then there are no more strings to return after this one. */
-        xReturn = pdFALSE;
-        lParameterNumber = 0;
-    } else {
-        /* There are more parameters to return after this one. */
-        xReturn = pdTRUE;
-        lParameterNumber++;
-    }
+    snprintf((char*) pcWriteBuffer, xWriteBufferLen, "UART baud rate set to %lu\r\n", GetUartBaudRate());
 
-    return xReturn;
+    return pdFALSE;
 }
 
 /**
- * @brief  Stops printing of sensor sample values
+ * @brief  Saves the current UART settings to flash
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIStopSensorSampling(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+static portBASE_TYPE CLISaveUartSettings(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
     /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
     (void) pcCommandString;
     configASSERT(pcWriteBuffer);
 
-    strncpy((char*) pcWriteBuffer, "Stopping printing of sensor sample values...\r\n", xWriteBufferLen);
+    if (UART_OK != SaveUartSettings()) {
+        strncpy((char*) pcWriteBuffer, "Failed to save UART settings, UAV must be in idle mode\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
 
-    /* Stop the sensor sample printing task */
-    StopSensorSamplingTask();
+    strncpy((char*) pcWriteBuffer, "UART settings saved\r\n", xWriteBufferLen);
 
     return pdFALSE;
 }
 
 /**
- * Starts magnetometer calibration procedure.
- */
-static portBASE_TYPE CLIStartAccMagMtrCalibration(int8_t *pcWriteBuffer, size_t xWriteBufferLen, const int8_t *pcCommandString) {
-    (void) pcCommandString;
-    configASSERT(pcWriteBuffer);
-
-    portBASE_TYPE xParameterStringLength;
-
-    strncpy((char*) pcWriteBuffer, "Starting Acc/Mag meter parameters "
-            "not applied to acc or mag values ...\r\n", xWriteBufferLen);
-
-    int32_t pcParameter = atoi((char*)FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength));
-
-    StartAccMagMtrCalibration(pcParameter);
-    return pdFALSE; /* false indicates CLI activity completed */
-}
-
-/**
- * @brief  Implements CLI command to print the last control signal values sent to the motors
+ * @brief  Implements CLI command to print the FMS setpoint link statistics
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIGetMotorValues(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
-    int8_t* pcParameter;
-
-    portBASE_TYPE xParameterStringLength;
-    portBASE_TYPE lParameterNumber = 0;
-
-    bool protoStatus;
-    uint8_t serializedData[MotorSignalValuesProto_size];
-    MotorSignalValuesProto motorSignalValuesProto;
+static portBASE_TYPE CLIGetFmsLinkStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    FmsLinkStats_TypeDef stats;
+    FmsSetpoint_TypeDef setpoint;
+    float32_t setpointValues[5];
+    size_t length;
 
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
     configASSERT(pcWriteBuffer);
 
-    /* Empty pcWriteBuffer so no strange output is sent as command response */
-    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
-
-    lParameterNumber++;
-
-    /* Obtain the parameter string. */
-    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
-            lParameterNumber, /* Return the next parameter. */
-            &xParameterStringLength /* Store the parameter string length. */
-    );
-
-    /* Sanity check something was returned. */
-    configASSERT(pcParameter);
-
-    /* Get the current motor values */
-    switch (pcParameter[0]) {
-    case 'n':
-        snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Motors\nM1: %u\nM2: %u\nM3: %u\nM4: %u\n\r\n",
-                GetMotorValue(1), GetMotorValue(2), GetMotorValue(3), GetMotorValue(4));
-        break;
-    case 'p':
-        motorSignalValuesProto.has_M1 = true;
-        motorSignalValuesProto.has_M2 = true;
-        motorSignalValuesProto.has_M3 = true;
-        motorSignalValuesProto.has_M4 = true;
-        motorSignalValuesProto.M1 = GetMotorValue(1);
-        motorSignalValuesProto.M2 = GetMotorValue(2);
-        motorSignalValuesProto.M3 = GetMotorValue(3);
-        motorSignalValuesProto.M4 = GetMotorValue(4);
-
-        /* Create a stream that will write to our buffer and encode the data with protocol buffer */
-        pb_ostream_t protoStream = pb_ostream_from_buffer(serializedData, MotorSignalValuesProto_size);
-        protoStatus = pb_encode(&protoStream, MotorSignalValuesProto_fields, &motorSignalValuesProto);
-
-        /* Insert header to the sample string, then copy the data after that */
-        uint32_t crc = CalculateCRC(serializedData, protoStream.bytes_written);
-        uint8_t msg_id = MOTOR_VALUES_MSG_ENUM;
-        uint16_t msg_data_size = (uint16_t)protoStream.bytes_written;
-        memcpy(pcWriteBuffer, &msg_id, 1);
-        memcpy(&pcWriteBuffer[1], &crc, 4);
-        memcpy(&pcWriteBuffer[5], &msg_data_size, 2);
-
-        if(PROTO_HEADER_LEN + protoStream.bytes_written + strlen("\r\n") < xWriteBufferLen) {
-        	memcpy(&pcWriteBuffer[PROTO_HEADER_LEN], serializedData, protoStream.bytes_written);
-        	memcpy(&pcWriteBuffer[PROTO_HEADER_LEN+protoStream.bytes_written], "\r\n", strlen("\r\n"));
-        }
-
-        if(!protoStatus) {
-            ErrorHandler();
-        }
-
-        dataOutLength = PROTO_HEADER_LEN + protoStream.bytes_written + strlen("\r\n"); // Set output data length
-
-        break;
-    default:
-        strncpy((char*) pcWriteBuffer, "Invalid parameter\r\n", xWriteBufferLen);
-        break;
+    GetFmsLinkStats(&stats);
+    length = snprintf((char*) pcWriteBuffer, xWriteBufferLen,
+            "Setpoints: %lu\r\nFrame errors: %lu\r\nSequence errors: %lu\r\nLost: %lu\r\nLast sequence: %lu\r\n"
+            "States sent: %lu, dropped: %lu\r\n",
+            stats.framesReceived, stats.frameErrors, stats.sequenceErrors, stats.setpointsLost, stats.lastSequence,
+            stats.statesSent, stats.statesDropped);
+
+    if (length < xWriteBufferLen && FMS_LINK_OK == GetFmsSetpoint(&setpoint, FMS_SETPOINT_TIMEOUT)) {
+        setpointValues[0] = setpoint.refSignals.zVelocity;
+        setpointValues[1] = setpoint.refSignals.rollAngle;
+        setpointValues[2] = setpoint.refSignals.pitchAngle;
+        setpointValues[3] = setpoint.refSignals.yawAngle;
+        setpointValues[4] = setpoint.refSignals.yawAngleRate;
+        FormatFixedList((char*) pcWriteBuffer + length, xWriteBufferLen - length,
+                "Setpoint: Vz %1.3f, Roll %1.3f, Pitch %1.3f, Yaw %1.3f, Yaw rate %1.3f\r\n", setpointValues, 5);
+    } else if (length < xWriteBufferLen) {
+        snprintf((char*) pcWriteBuffer + length, xWriteBufferLen - length, "Setpoint: none within %u ms\r\n",
+                FMS_SETPOINT_TIMEOUT);
     }
 
-    return pdFALSE; /* Return false to indicate command activity finished */
+    return pdFALSE;
 }
 
 /**
- * @brief  Starts sensor sampling for a specified sample time and duration
+ * @brief  Sets the mode of the receiver PID switch position
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIStartMotorSampling(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
-    int8_t* pcParameter;
-    portBASE_TYPE xParameterStringLength, xReturn;
-    static portBASE_TYPE lParameterNumber = 0;
+static portBASE_TYPE CLISetStabilizedMode(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    enum FlightControlMode mode;
 
     /* Check the write buffer is not NULL */
     configASSERT(pcWriteBuffer);
 
-    if (lParameterNumber == 0) {
-        /* The first time the function is called after the command has been entered just a header string is returned. */
-        strncpy((char*) pcWriteBuffer, "Starting print sampling of motor control signal values...\r\n", xWriteBufferLen);
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    if (5 == xParameterStringLength && 0 == strncmp((const char*) pcParameter, "angle", xParameterStringLength)) {
+        mode = FLIGHT_CONTROL_PID;
+    } else if (4 == xParameterStringLength && 0 == strncmp((const char*) pcParameter, "rate", xParameterStringLength)) {
+        mode = FLIGHT_CONTROL_RATE;
+    } else if (3 == xParameterStringLength && 0 == strncmp((const char*) pcParameter, "alt", xParameterStringLength)) {
+        mode = FLIGHT_CONTROL_ALTITUDE_HOLD;
     } else {
-        uint16_t motorSampleTime;
-        uint16_t motorSampleDuration;
-
-        /* Obtain the parameter string */
-        pcParameter = (int8_t*) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
-                lParameterNumber, /* Return the next parameter. */
-                &xParameterStringLength /* Store the parameter string length. */
-        );
-
-        /* Sanity check something was returned. */
-        configASSERT(pcParameter);
-
-        strncpy((char*) pcWriteBuffer, "Sample time (ms): ", xWriteBufferLen);
-
-        size_t paramMaxSize;
-        if ((unsigned long) xParameterStringLength > xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1)
-            paramMaxSize = xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1;
-        else
-            paramMaxSize = xParameterStringLength;
-
-        strncat((char*) pcWriteBuffer, (char*) pcParameter, paramMaxSize);
-        strncat((char*) pcWriteBuffer, "\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
-
-        motorSampleTime = atoi((char*) pcParameter);
-
-        lParameterNumber++;
-
-        pcParameter = (int8_t*) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
-                lParameterNumber, /* Return the next parameter. */
-                &xParameterStringLength /* Store the parameter string length. */);
-
-        /* Sanity check something was returned. */
-        configASSERT(pcParameter);
-
-        strncat((char*) pcWriteBuffer, "Duration (s): ", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
-
-        if ((unsigned long) xParameterStringLength > xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1)
-            paramMaxSize = xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1;
-        else
-            paramMaxSize = xParameterStringLength;
-
-        strncat((char*) pcWriteBuffer, (char*) pcParameter, paramMaxSize);
-        strncat((char*) pcWriteBuffer, "\n\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
-
-        motorSampleDuration = atoi((char*) pcParameter);
+        strncpy((char*) pcWriteBuffer, "Invalid mode, use angle, rate or alt\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
 
-        StartMotorControlSamplingTask(motorSampleTime, motorSampleDuration);
+    if (FLIGHTCTRL_OK != SetStabilizedFlightMode(mode)) {
+        strncpy((char*) pcWriteBuffer,
+                "Failed to set mode, UAV must be in idle mode, rate mode requires cascaded rate control and alt mode "
+                "vertical velocity control\r\n", xWriteBufferLen);
+        return pdFALSE;
     }
 
-    /* Update return value and parameter index */
-    if (lParameterNumber == startMotorSamplingCommand.cExpectedNumberOfParameters) {
-        /* If this is the last parameter then there are no more strings to return after this one. */
-        xReturn = pdFALSE;
-        lParameterNumber = 0;
+    if (FLIGHT_CONTROL_RATE == mode) {
+        strncpy((char*) pcWriteBuffer, "PID switch position set to rate mode\r\n", xWriteBufferLen);
+    } else if (FLIGHT_CONTROL_ALTITUDE_HOLD == mode) {
+        strncpy((char*) pcWriteBuffer, "PID switch position set to altitude hold mode\r\n", xWriteBufferLen);
     } else {
-        /* There are more parameters to return after this one. */
-        xReturn = pdTRUE;
-        lParameterNumber++;
+        strncpy((char*) pcWriteBuffer, "PID switch position set to angle mode\r\n", xWriteBufferLen);
     }
 
-    return xReturn;
+    return pdFALSE;
 }
 
 /**
- * @brief  Stops printing of motor control signal sample values
+ * @brief  Starts sending protobuf frames of a message at a specified sample time and duration
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIStopMotorSampling(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
-    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
-    (void) pcCommandString;
+static portBASE_TYPE CLIStartTelemetry(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    enum ProtoMessageTypeEnum msgType;
+    uint16_t sampleTime;
+    uint32_t sampleDuration;
+
+    /* Check the write buffer is not NULL */
     configASSERT(pcWriteBuffer);
 
-    strncpy((char*) pcWriteBuffer, "Stopping printing of sensor sample values...\r\n", xWriteBufferLen);
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    if (FCB_OK != GetTelemetryMsgType((const char*) pcParameter, xParameterStringLength, &msgType)) {
+        strncpy((char*) pcWriteBuffer, "Invalid message, use sensor, state, ref, ctrl, motor, rc or summary\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    sampleTime = atoi((char*) FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength));
+    sampleDuration = atoi((char*) FreeRTOS_CLIGetParameter(pcCommandString, 3, &xParameterStringLength));
+
+    if (FCB_OK != StartTelemetry(msgType, PROTOBUFFER_SERIALIZATION, sampleTime, sampleDuration)) {
+        strncpy((char*) pcWriteBuffer, "Failed to start telemetry\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
 
-    /* Stop the motor control sample printing task */
-    StopMotorControlSamplingTask();
+    snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Telemetry started, sample time (ms): %u, duration (s): %lu\r\n",
+            sampleTime, (unsigned long) sampleDuration);
 
     return pdFALSE;
 }
 
 /**
- * @brief  Implements "about" command, prints system information
+ * @brief  Stops sending or printing of a message
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIAbout(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
-    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
-    (void) pcCommandString;
+static portBASE_TYPE CLIStopTelemetry(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    enum ProtoMessageTypeEnum msgType;
+
+    /* Check the write buffer is not NULL */
     configASSERT(pcWriteBuffer);
 
-    strncpy((char*) pcWriteBuffer,
-            "Dragonfly\nThe Dragonfly system is developed at AF Consult in Malmoe, Sweden. It is designed to control a quadrotor UAV.\n\nVersion:",
-            xWriteBufferLen);
-    strncat((char*) pcWriteBuffer, DF_FCB_VERSION, xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
-    strncat((char*) pcWriteBuffer, "\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    if (3 == xParameterStringLength && 0 == strncmp((const char*) pcParameter, "all", 3)) {
+        StopAllTelemetry();
+    } else if (FCB_OK != GetTelemetryMsgType((const char*) pcParameter, xParameterStringLength, &msgType)) {
+        strncpy((char*) pcWriteBuffer, "Invalid message, use sensor, state, ref, ctrl, motor, rc, summary or all\r\n", xWriteBufferLen);
+        return pdFALSE;
+    } else {
+        StopTelemetry(msgType);
+    }
+
+    strncpy((char*) pcWriteBuffer, "Telemetry stopped\r\n", xWriteBufferLen);
 
     return pdFALSE;
 }
 
 /**
- * @brief  Implements "systime" command, prints system up time
+ * @brief  Sets the summary window size of a group of signals
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLISysTime(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
-    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
-    (void) pcCommandString;
+static portBASE_TYPE CLISetTelemetryWindow(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t* pcGroupParameter;
+    const int8_t* pcParameter;
+    portBASE_TYPE xGroupParameterStringLength;
+    portBASE_TYPE xParameterStringLength;
+    uint16_t windowSize;
+
+    /* Check the write buffer is not NULL */
     configASSERT(pcWriteBuffer);
 
-    snprintf((char*) pcWriteBuffer, xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1, "System time [ms]: %u\r\n",
-            (unsigned int) HAL_GetTick());
+    pcGroupParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xGroupParameterStringLength);
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength);
+    windowSize = atoi((char*) pcParameter);
+
+    if (FCB_OK != SetAggregateGroupWindowSize((const char*) pcGroupParameter, xGroupParameterStringLength,
+            windowSize)) {
+        snprintf((char*) pcWriteBuffer, xWriteBufferLen,
+                "Invalid window, use gyro, acc, motor, ctrl, vibration, battery, pidscale or all and at most %u "
+                "samples\r\n",
+                AGGREGATE_MAX_WINDOW_SIZE);
+        return pdFALSE;
+    }
+
+    snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Telemetry window set to %u samples\r\n", windowSize);
 
     return pdFALSE;
 }
 
 /**
- * @brief  Implements "get-flight-mode" command, prints current flight control mode
+ * @brief  Implements the CLI command to set where the telemetry frames are sent
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIGetFlightMode(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
-    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
-    (void) pcCommandString;
+static portBASE_TYPE CLISetTelemetryOutput(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+
+    /* Check the write buffer is not NULL */
     configASSERT(pcWriteBuffer);
 
-    strncpy((char*) pcWriteBuffer, "Flight mode: ", xWriteBufferLen);
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
 
-    switch(GetFlightControlMode()) {
-    case FLIGHT_CONTROL_IDLE:
-        strncat((char*) pcWriteBuffer, "IDLE", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
-        break;
-    case FLIGHT_CONTROL_RAW:
-        strncat((char*) pcWriteBuffer, "RAW", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
-        break;
-    case FLIGHT_CONTROL_PID:
-        strncat((char*) pcWriteBuffer, "PID", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
-        break;
-    case FLIGHT_CONTROL_AUTONOMOUS:
-    	strncat((char*) pcWriteBuffer, "AUTO", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
-    	break;
-    default:
-        strncat((char*) pcWriteBuffer, "N/A", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
-        break;
+    if (3 == xParameterStringLength && !strncmp((char*) pcParameter, "com", 3)) {
+        SetTelemetryOutput(TELEMETRY_OUTPUT_COM);
+    } else if (3 == xParameterStringLength && !strncmp((char*) pcParameter, "log", 3)) {
+        SetTelemetryOutput(TELEMETRY_OUTPUT_USB_LOG);
+    } else {
+        snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Invalid output, use com or log\r\n");
+        return pdFALSE;
     }
 
-    strncat((char*) pcWriteBuffer, "\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+    snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Telemetry output set, %lu log bytes dropped so far\r\n",
+            GetUSBLogDroppedBytes());
 
     return pdFALSE;
 }
 
 /**
- * @brief  Implements "get-ref-signals" command, prints current reference signals
+ * @brief  Implements the CLI command to set the decimals of a group of the compact telemetry fields
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIGetRefSignals(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
-    int8_t* pcParameter;
-    portBASE_TYPE xParameterStringLength;
-    portBASE_TYPE lParameterNumber = 0;
-
-    bool protoStatus;
-    uint8_t serializedData[ControlReferenceSignalsProto_size];
-    ControlReferenceSignalsProto refValuesProto;
-
-    configASSERT(pcWriteBuffer);
-
-    /* Empty pcWriteBuffer so no strange output is sent as command response */
-    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
-
-    lParameterNumber++;
-
-    /* Obtain the parameter string. */
-    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
-            lParameterNumber, /* Return the next parameter. */
-            &xParameterStringLength /* Store the parameter string length. */
-    );
-
-    /* Sanity check something was returned. */
-    configASSERT(pcParameter);
-
-    switch (pcParameter[0]) {
-    case 'n':
-    	snprintf((char*) pcWriteBuffer, xWriteBufferLen,
-    	            "Reference signals:\nZ velocity: %1.4f m/s\nRoll angle: %1.4f rad\nPitch angle: %1.4f rad\nYaw angle: %1.4f rad\nYaw rate: %1.4f rad/s\n",
-    	            GetZVelocityReferenceSignal(), GetRollAngleReferenceSignal(), GetPitchAngleReferenceSignal(), GetYawAngleReferenceSignal(), GetYawAngularRateReferenceSignal());
-    	break;
-    case 'p':
-    	/* Add reference signal values to protobuffer type struct members */
-    	refValuesProto.has_refRoll = true;
-    	refValuesProto.refRoll = GetRollAngleReferenceSignal();
-    	refValuesProto.has_refPitch = true;
-    	refValuesProto.refPitch = GetPitchAngleReferenceSignal();
-    	refValuesProto.has_refYaw = true;
-    	refValuesProto.refYaw = GetYawAngleReferenceSignal();
-    	refValuesProto.has_refYawRate = true;
-    	refValuesProto.refYawRate = GetYawAngularRateReferenceSignal();
-
-    	/* Create a stream that will write to our buffer and encode the data with protocol buffer */
-    	pb_ostream_t protoStream = pb_ostream_from_buffer(serializedData, ControlReferenceSignalsProto_size);
-    	protoStatus = pb_encode(&protoStream, ControlReferenceSignalsProto_fields, &refValuesProto);
-
-    	/* Insert header to the sample string, then copy the data after that */
-    	uint32_t crc = CalculateCRC(serializedData, protoStream.bytes_written);
-    	uint8_t msg_id = REFSIGNALS_MSG_ENUM;
-    	uint16_t msg_data_size = (uint16_t) protoStream.bytes_written;
-    	memcpy(pcWriteBuffer, &msg_id, 1);
-    	memcpy(&pcWriteBuffer[1], &crc, 4);
-    	memcpy(&pcWriteBuffer[5], &msg_data_size, 2);
-
-    	if (PROTO_HEADER_LEN + protoStream.bytes_written + strlen("\r\n") < xWriteBufferLen) {
-    		memcpy(&pcWriteBuffer[PROTO_HEADER_LEN], serializedData, protoStream.bytes_written);
-    		memcpy(&pcWriteBuffer[PROTO_HEADER_LEN + protoStream.bytes_written], "\r\n", strlen("\r\n"));
-    	}
+static portBASE_TYPE CLISetCompactPrecision(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t* pcGroupParameter;
+    const int8_t* pcParameter;
+    portBASE_TYPE xGroupParameterStringLength;
+    portBASE_TYPE xParameterStringLength;
+    int decimals;
 
-    	if (!protoStatus) {
-    		ErrorHandler();
-    	}
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
 
-    	dataOutLength = PROTO_HEADER_LEN + protoStream.bytes_written + strlen("\r\n"); // Set output data length
+    pcGroupParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xGroupParameterStringLength);
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength);
+    decimals = atoi((char*) pcParameter);
 
-    	break;
-    default:
-    	strncpy((char*) pcWriteBuffer, "Invalid parameter\r\n",
-    			xWriteBufferLen);
-    	break;
+    if (decimals < 0 || decimals > COMPACT_MAX_DECIMALS
+            || FCB_OK != SetCompactPrecision((const char*) pcGroupParameter, xGroupParameterStringLength,
+            (uint8_t) decimals)) {
+        snprintf((char*) pcWriteBuffer, xWriteBufferLen,
+                "Invalid precision, use gyro, acc, mag, angle, rate, motor or all and at most %u decimals\r\n",
+                COMPACT_MAX_DECIMALS);
+        return pdFALSE;
     }
 
+    PrintCompactPrecision((char*) pcWriteBuffer, xWriteBufferLen);
+
     return pdFALSE;
 }
 
 /**
- * @brief  Implements "get-ctrl-signals" command, prints current control signals
+ * @brief  Implements CLI command to print the parameter table, one parameter per call
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIGetCtrlSignals(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
-    int8_t* pcParameter;
-    portBASE_TYPE xParameterStringLength;
-    portBASE_TYPE lParameterNumber = 0;
-
-    bool protoStatus;
-    uint8_t serializedData[ControlSignalsProto_size];
-    ControlSignalsProto ctrlValuesProto;
+static portBASE_TYPE CLIGetParams(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    static uint16_t paramPrintId = 0;
+    const Param_TypeDef* param;
+    float32_t values[3];
+    size_t length;
 
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
     configASSERT(pcWriteBuffer);
 
-    /* Empty pcWriteBuffer so no strange output is sent as command response */
-    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
+    param = GetParam(paramPrintId);
+    if (NULL == param) {
+        strncpy((char*) pcWriteBuffer, "\r\n", xWriteBufferLen);
+        paramPrintId = 0;
+        return pdFALSE;
+    }
 
-    lParameterNumber++;
+    GetParamValue(paramPrintId, &values[0]);
+    values[1] = param->min;
+    values[2] = param->max;
 
-    /* Obtain the parameter string. */
-    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
-            lParameterNumber, /* Return the next parameter. */
-            &xParameterStringLength /* Store the parameter string length. */
-    );
+    length = snprintf((char*) pcWriteBuffer, xWriteBufferLen, "%u\t%s\t%s", paramPrintId, param->name,
+            (strlen(param->name) < 8) ? "\t" : "");
+    if (length < xWriteBufferLen) {
+        FormatFixedList((char*) pcWriteBuffer + length, xWriteBufferLen - length, "%1.4f\t[%1.4f, %1.4f]\r\n",
+                values, 3);
+    }
 
-    /* Sanity check something was returned. */
-    configASSERT(pcParameter);
+    paramPrintId++;
+    return pdTRUE;
+}
 
-    switch (pcParameter[0]) {
-    case 'n':
-    	snprintf((char*) pcWriteBuffer, xWriteBufferLen,
-    	            "Control signals:\nThrust: %1.4f N\nRoll: %1.4f Nm\nPitch: %1.4f Nm\nYaw: %1.4f Nm\n",
-					GetThrustControlSignal(), GetRollControlSignal(), GetPitchControlSignal(), GetYawControlSignal());
-    	break;
-    case 'p':
-    	/* Add control signal values to protobuffer type struct members */
-        ctrlValuesProto.has_ctrlState = true;
-        ctrlValuesProto.ctrlState = GetFlightControlMode();
-        ctrlValuesProto.has_thrustCtrl = true;
-        ctrlValuesProto.thrustCtrl = GetThrustControlSignal();
-        ctrlValuesProto.has_rollCtrl = true;
-        ctrlValuesProto.rollCtrl = GetRollControlSignal();
-        ctrlValuesProto.has_pitchCtrl = true;
-        ctrlValuesProto.pitchCtrl = GetPitchControlSignal();
-        ctrlValuesProto.has_yawCtrl = true;
-        ctrlValuesProto.yawCtrl = GetYawControlSignal();
+/**
+ * @brief  Implements CLI command to set a parameter of the parameter table
+ * @param  pcWriteBuffer : Reference to output buffer
+ * @param  xWriteBufferLen : Size of output buffer
+ * @param  pcCommandString : Command line string
+ * @retval pdTRUE if more data follows, pdFALSE if command activity finished
+ */
+static portBASE_TYPE CLISetParam(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    const int8_t* pcParameter;
+    portBASE_TYPE xParameterStringLength;
+    int16_t id;
+    float32_t value;
+    size_t length;
 
-    	/* Create a stream that will write to our buffer and encode the data with protocol buffer */
-        pb_ostream_t protoStream = pb_ostream_from_buffer(serializedData, ControlSignalsProto_size);
-        protoStatus = pb_encode(&protoStream, ControlSignalsProto_fields, &ctrlValuesProto);
-
-    	/* Insert header to the sample string, then copy the data after that */
-    	uint32_t crc = CalculateCRC(serializedData, protoStream.bytes_written);
-    	uint8_t msg_id = CTRLSIGNALS_MSG_ENUM;
-    	uint16_t msg_data_size = (uint16_t) protoStream.bytes_written;
-    	memcpy(pcWriteBuffer, &msg_id, 1);
-    	memcpy(&pcWriteBuffer[1], &crc, 4);
-    	memcpy(&pcWriteBuffer[5], &msg_data_size, 2);
-
-    	if (PROTO_HEADER_LEN + protoStream.bytes_written + strlen("\r\n") < xWriteBufferLen) {
-    		memcpy(&pcWriteBuffer[PROTO_HEADER_LEN], serializedData, protoStream.bytes_written);
-    		memcpy(&pcWriteBuffer[PROTO_HEADER_LEN + protoStream.bytes_written], "\r\n", strlen("\r\n"));
-    	}
+    /* Check the write buffer is not NULL */
+    configASSERT(pcWriteBuffer);
 
-    	if (!protoStatus) {
-    		ErrorHandler();
-    	}
+    /* Get the name and value parameters */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, 1, &xParameterStringLength);
+    id = FindParamId((const char*) pcParameter, xParameterStringLength);
+    value = strtof((char*) FreeRTOS_CLIGetParameter(pcCommandString, 2, &xParameterStringLength), NULL);
 
-    	dataOutLength = PROTO_HEADER_LEN + protoStream.bytes_written + strlen("\r\n"); // Set output data length
+    if (id < 0 || FCB_OK != SetParamValue(id, value)) {
+        strncpy((char*) pcWriteBuffer, "Invalid parameter or value out of its range, see get-params\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
 
-    	break;
-    default:
-    	strncpy((char*) pcWriteBuffer, "Invalid parameter\r\n",
-    			xWriteBufferLen);
-    	break;
+    length = snprintf((char*) pcWriteBuffer, xWriteBufferLen, "%s set to ", GetParam(id)->name);
+    if (length < xWriteBufferLen) {
+        length += FormatFixed((char*) pcWriteBuffer + length, xWriteBufferLen - length, value, 4);
+    }
+    if (length < xWriteBufferLen) {
+        strncpy((char*) pcWriteBuffer + length, "\r\n", xWriteBufferLen - length);
     }
 
     return pdFALSE;
 }
 
 /**
- * @brief  Implements CLI command to set the max limit for received signals from RC control.
+ * @brief  Saves the parameter table to flash
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLISetMaxReferenceSignals(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
-    float pcParameter[4];
-
-    portBASE_TYPE xParameterStringLength;
-//    portBASE_TYPE lParameterNumber = 0;
-
+static portBASE_TYPE CLISaveParams(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
     configASSERT(pcWriteBuffer);
 
-    /* Obtain the parameter strings. */
-    for (int i = 0; i < 4; i++) {
-        pcParameter[i] = atof((char*)FreeRTOS_CLIGetParameter(pcCommandString, i+1, &xParameterStringLength));
+    if (FCB_OK != SaveParams()) {
+        strncpy((char*) pcWriteBuffer, "Failed to save parameters, UAV must be in idle mode\r\n", xWriteBufferLen);
+        return pdFALSE;
     }
 
-    setMaxLimitForReferenceSignal(pcParameter[0], pcParameter[1], pcParameter[2], pcParameter[3]);
-
-    snprintf((char*) pcWriteBuffer, xWriteBufferLen,
-            "Set max limit for reference signals:\nZ velocity: %1.4f m/s\nRoll angle: %1.4f rad\nPitch angle: %1.4f rad\nYaw angular rate: %1.4f rad/s\n",
-			pcParameter[0], pcParameter[1], pcParameter[2], pcParameter[3]);
+    strncpy((char*) pcWriteBuffer, "Parameters saved\r\n", xWriteBufferLen);
 
-    return pdFALSE; /* Return false to indicate command activity finished */
+    return pdFALSE;
 }
 
 /**
- * @brief  Implements CLI command to get the max limit for received signals from RC control.
+ * @brief  Prints the blackbox status
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIGetMaxReferenceSignals(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
-    float32_t refLimits[5];
+static portBASE_TYPE CLIGetBlackboxStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+    BlackboxStatus_TypeDef status;
+#ifdef FCB_SD_CARD
+    char* blackboxString = cliPrintBuffer.blackbox; // Does not fit in the CLI output buffer
+    size_t length;
+#endif
 
+    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
+    (void) pcCommandString;
     configASSERT(pcWriteBuffer);
 
-    getMaxLimitForReferenceSignal(&refLimits[0], &refLimits[1], &refLimits[2], &refLimits[3], &refLimits[4]);
+    GetBlackboxStatus(&status);
+#ifdef FCB_SD_CARD
+    /* Empty pcWriteBuffer so no strange output is sent as command response */
+    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
 
+    length = (size_t) snprintf(blackboxString, BLACKBOX_STATUS_MAX_STRING_SIZE,
+            "Blackbox\nUsed [bytes]: %lu/%lu\nFrames logged: %lu\nFrames dropped: %lu\nDecimation: %u\n%s\n",
+            status.usedBytes, status.sizeBytes, status.framesLogged, status.framesDropped, status.decimation,
+            status.isErasing ? "Erasing" : "Ready");
+    if (length < BLACKBOX_STATUS_MAX_STRING_SIZE) {
+        PrintBlackboxSdStatus(blackboxString + length, BLACKBOX_STATUS_MAX_STRING_SIZE - length);
+    }
+    ComSessionSendString(blackboxString);
+#else
     snprintf((char*) pcWriteBuffer, xWriteBufferLen,
-            "Max limit for reference signals:\nZ velocity: %1.4f m/s\nRoll angle: %1.4f rad\nPitch angle: %1.4f rad\nYaw angle: %1.4f rad\nYaw angular rate: %1.4f rad/s\n",
-            refLimits[0], refLimits[1], refLimits[2], refLimits[3], refLimits[4]);
+            "Blackbox\nUsed [bytes]: %lu/%lu\nFrames logged: %lu\nFrames dropped: %lu\nDecimation: %u\n%s\r\n",
+            status.usedBytes, status.sizeBytes, status.framesLogged, status.framesDropped, status.decimation,
+            status.isErasing ? "Erasing" : "Ready");
+#endif
 
-    return pdFALSE; /* Return false to indicate command activity finished */
+    return pdFALSE;
 }
+
 /**
- * @brief  Implements "task-status" command, prints task status
+ * @brief  Requests the flight data log to be erased
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLITaskStatus(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+static portBASE_TYPE CLIEraseBlackbox(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
     /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
     (void) pcCommandString;
     configASSERT(pcWriteBuffer);
 
-    strncpy((char*) pcWriteBuffer, "\nTask\t\t\t Abs Time\t % Time \tStack (rem b)\n", xWriteBufferLen);
-    size_t len = strlen((char*) pcWriteBuffer);
-    len += vTaskGetRunTimeStats(pcWriteBuffer + len, xWriteBufferLen-len);
-    strncat((char*) pcWriteBuffer, "\n", xWriteBufferLen - len -1);
+    if (FCB_OK != EraseBlackbox()) {
+        strncpy((char*) pcWriteBuffer, "Failed to erase blackbox, UAV must be in idle mode\r\n", xWriteBufferLen);
+        return pdFALSE;
+    }
+
+    strncpy((char*) pcWriteBuffer, "Blackbox erase started, see get-blackbox-status\r\n", xWriteBufferLen);
 
     return pdFALSE;
 }
 
 /**
- * @brief  Implements CLI command to print the last control signal values sent to the motors
+ * @brief  Implements "set-log-sink" command, sets the sinks of the deferred log and prints its counters
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIGetStateValues(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+static portBASE_TYPE CLISetLogSink(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
     int8_t* pcParameter;
     portBASE_TYPE xParameterStringLength;
-    portBASE_TYPE lParameterNumber = 0;
-
-    bool protoStatus;
-    uint8_t serializedData[FlightStatesProto_size];
-    FlightStatesProto stateValuesProto;
+    LogStatus_TypeDef status;
+    uint8_t sinks;
 
     configASSERT(pcWriteBuffer);
 
-    /* Empty pcWriteBuffer so no strange output is sent as command response */
-    memset(pcWriteBuffer, 0x00, xWriteBufferLen);
-
-    lParameterNumber++;
-
     /* Obtain the parameter string. */
     pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
-            lParameterNumber, /* Return the next parameter. */
+            1, /* Return the first parameter. */
             &xParameterStringLength /* Store the parameter string length. */
     );
 
     /* Sanity check something was returned. */
     configASSERT(pcParameter);
 
-    /* Get the current state values */
-    switch (pcParameter[0]) {
-    case 'n':
-        snprintf((char*) pcWriteBuffer, xWriteBufferLen,
-                "Flight states [deg]\nrollAngle: %1.3f\npitchAngle: %1.3f\nyawAngle: %1.3f\nrollRate: %1.3f\npitchRate: %1.3f\nyawRate: %1.3f\r\n",
-                Radian2Degree(GetRollAngle()), Radian2Degree(GetPitchAngle()), Radian2Degree(GetYawAngle()), Radian2Degree(GetRollRate()), Radian2Degree(GetPitchRate()), Radian2Degree(GetYawRate()));
-        break;
-    case 'p':
-        /* Add estimated attitude states to protobuffer type struct members */
-        stateValuesProto.has_rollAngle = true;
-        stateValuesProto.rollAngle = GetRollAngle();
-        stateValuesProto.has_pitchAngle = true;
-        stateValuesProto.pitchAngle = GetPitchAngle();
-        stateValuesProto.has_yawAngle = true;
-        stateValuesProto.yawAngle = GetYawAngle();
-
-        // TODO add attitude rates when available
-        stateValuesProto.has_rollRate = true;
-        stateValuesProto.rollRate = GetRollRate();
-        stateValuesProto.has_pitchRate = true;
-        stateValuesProto.pitchRate = GetPitchRate();
-        stateValuesProto.has_yawRate = true;
-        stateValuesProto.yawRate = GetYawRate();
-
-        // TODO add position estimates when available
-        stateValuesProto.has_posX = false;
-        stateValuesProto.posX = 0.0;
-        stateValuesProto.has_posY = false;
-        stateValuesProto.posY = 0.0;
-        stateValuesProto.has_posZ = false;
-        stateValuesProto.posZ = 0.0;
-
-        // TODO add velocity estimates when available
-        stateValuesProto.has_velX = false;
-        stateValuesProto.velX = 0.0;
-        stateValuesProto.has_velY = false;
-        stateValuesProto.velY = 0.0;
-        stateValuesProto.has_velZ = false;
-        stateValuesProto.velZ = 0.0;
-
-        /* Create a stream that will write to our buffer and encode the data with protocol buffer */
-        pb_ostream_t protoStream = pb_ostream_from_buffer(serializedData, FlightStatesProto_size);
-        protoStatus = pb_encode(&protoStream, FlightStatesProto_fields, &stateValuesProto);
-
-        /* Insert header to the sample string, then copy the data after that */
-        uint32_t crc = CalculateCRC(serializedData, protoStream.bytes_written);
-        uint8_t msg_id = FLIGHT_STATE_MSG_ENUM;
-        uint16_t msg_data_size = (uint16_t)protoStream.bytes_written;
-        memcpy(pcWriteBuffer, &msg_id, 1);
-        memcpy(&pcWriteBuffer[1], &crc, 4);
-        memcpy(&pcWriteBuffer[5], &msg_data_size, 2);
-
-        if(PROTO_HEADER_LEN + protoStream.bytes_written + strlen("\r\n") < xWriteBufferLen) {
-            memcpy(&pcWriteBuffer[PROTO_HEADER_LEN], serializedData, protoStream.bytes_written);
-            memcpy(&pcWriteBuffer[PROTO_HEADER_LEN+protoStream.bytes_written], "\r\n", strlen("\r\n"));
-        }
-
-        if (!protoStatus) {
-            ErrorHandler();
-        }
-
-        dataOutLength = PROTO_HEADER_LEN + protoStream.bytes_written + strlen("\r\n"); // Set output data length
-
-        break;
-    default:
+    if (3 == xParameterStringLength && !strncmp((char*) pcParameter, "usb", 3)) {
+        sinks = LOG_SINK_USB;
+    } else if (8 == xParameterStringLength && !strncmp((char*) pcParameter, "blackbox", 8)) {
+        sinks = LOG_SINK_BLACKBOX;
+    } else if (3 == xParameterStringLength && !strncmp((char*) pcParameter, "all", 3)) {
+        sinks = LOG_SINK_USB | LOG_SINK_BLACKBOX;
+    } else if (4 == xParameterStringLength && !strncmp((char*) pcParameter, "none", 4)) {
+        sinks = 0;
+    } else {
         strncpy((char*) pcWriteBuffer, "Invalid parameter\r\n", xWriteBufferLen);
-        break;
+        return pdFALSE;
     }
 
+    SetLogSinks(sinks);
+    GetLogStatus(&status);
+    snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Log sinks: %s%s%s\nSlots logged: %lu\nMessages dropped: %lu\r\n",
+            (sinks & LOG_SINK_USB) ? "usb " : "", (sinks & LOG_SINK_BLACKBOX) ? "blackbox " : "",
+            (0 == sinks) ? "none" : "", status.recorded, status.dropped);
+
     return pdFALSE;
 }
 
+#ifdef FCB_TRACE_RECORDER
 /**
- * @brief  Starts state sampling for a specified sample time and duration
+ * @brief  Implements "trace" command, controls the trace recorder and prints its status. The trace task carries out
+ *         the request within its period, the status printed is the one before.
  * @param  pcWriteBuffer : Reference to output buffer
  * @param  xWriteBufferLen : Size of output buffer
  * @param  pcCommandString : Command line string
  * @retval pdTRUE if more data follows, pdFALSE if command activity finished
  */
-static portBASE_TYPE CLIStartStateSampling(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
+static portBASE_TYPE CLITrace(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
     int8_t* pcParameter;
-    portBASE_TYPE xParameterStringLength, xReturn;
-    static portBASE_TYPE lParameterNumber = 0;
+    portBASE_TYPE xParameterStringLength;
+    TraceStatus_TypeDef status;
+    FcbRetValType retVal = FCB_OK;
 
-    /* Check the write buffer is not NULL */
     configASSERT(pcWriteBuffer);
 
-    if (lParameterNumber == 0) {
-        /* The first time the function is called after the command has been entered just a header string is returned. */
-        strncpy((char*) pcWriteBuffer, "Starting print sampling of state values...\r\n", xWriteBufferLen);
-    } else {
-        uint16_t stateSampleTime;
-        uint16_t stateSampleDuration;
-
-        /* Obtain the parameter string */
-        pcParameter = (int8_t*) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
-                lParameterNumber, /* Return the next parameter. */
-                &xParameterStringLength /* Store the parameter string length. */
-        );
-
-        /* Sanity check something was returned. */
-        configASSERT(pcParameter);
-
-        strncpy((char*) pcWriteBuffer, "Sample time (ms): ", xWriteBufferLen);
-
-        size_t paramMaxSize;
-        if ((unsigned long) xParameterStringLength > xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1)
-            paramMaxSize = xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1;
-        else
-            paramMaxSize = xParameterStringLength;
-
-        strncat((char*) pcWriteBuffer, (char*) pcParameter, paramMaxSize);
-        strncat((char*) pcWriteBuffer, "\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
-
-        stateSampleTime = atoi((char*) pcParameter);
-
-        lParameterNumber++;
-
-        pcParameter = (int8_t*) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
-                lParameterNumber, /* Return the next parameter. */
-                &xParameterStringLength /* Store the parameter string length. */);
-
-        /* Sanity check something was returned. */
-        configASSERT(pcParameter);
-
-        strncat((char*) pcWriteBuffer, "Duration (s): ", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
-
-        if ((unsigned long) xParameterStringLength > xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1)
-            paramMaxSize = xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1;
-        else
-            paramMaxSize = xParameterStringLength;
-
-        strncat((char*) pcWriteBuffer, (char*) pcParameter, paramMaxSize);
-        strncat((char*) pcWriteBuffer, "\n\r\n", xWriteBufferLen - strlen((char*) pcWriteBuffer) - 1);
+    /* Obtain the parameter string. */
+    pcParameter = (int8_t *) FreeRTOS_CLIGetParameter(pcCommandString, /* The command string itself. */
+            1, /* Return the first parameter. */
+            &xParameterStringLength /* Store the parameter string length. */
+    );
 
-        stateSampleDuration = atoi((char*) pcParameter);
+    /* Sanity check something was returned. */
+    configASSERT(pcParameter);
 
-        StartStateSamplingTask(stateSampleTime, stateSampleDuration);
+    if (8 == xParameterStringLength && !strncmp((char*) pcParameter, "snapshot", 8)) {
+        retVal = StartTraceRecorder(TRACE_MODE_SNAPSHOT);
+    } else if (6 == xParameterStringLength && !strncmp((char*) pcParameter, "stream", 6)) {
+        /* Telemetry frames may span writes, they must not be interleaved with the trace frames */
+        SetTelemetryOutput(TELEMETRY_OUTPUT_COM);
+        retVal = StartTraceRecorder(TRACE_MODE_STREAM);
+    } else if (4 == xParameterStringLength && !strncmp((char*) pcParameter, "stop", 4)) {
+        StopTraceRecorder();
+    } else if (4 == xParameterStringLength && !strncmp((char*) pcParameter, "dump", 4)) {
+        retVal = SendTraceSnapshot();
+    } else if (6 != xParameterStringLength || strncmp((char*) pcParameter, "status", 6)) {
+        strncpy((char*) pcWriteBuffer, "Invalid parameter\r\n", xWriteBufferLen);
+        return pdFALSE;
     }
 
-    /* Update return value and parameter index */
-    if (lParameterNumber == startStateSamplingCommand.cExpectedNumberOfParameters) {
-        /* If this is the last parameter then there are no more strings to return after this one. */
-        xReturn = pdFALSE;
-        lParameterNumber = 0;
-    } else {
-        /* There are more parameters to return after this one. */
-        xReturn = pdTRUE;
-        lParameterNumber++;
+    if (FCB_OK != retVal) {
+        strncpy((char*) pcWriteBuffer, "Trace request refused, a request is pending or the recorder streams\r\n",
+                xWriteBufferLen);
+        return pdFALSE;
     }
 
-    return xReturn;
-}
-
-/**
- * @brief  Stops printing of state sample values
- * @param  pcWriteBuffer : Reference to output buffer
- * @param  xWriteBufferLen : Size of output buffer
- * @param  pcCommandString : Command line string
- * @retval pdTRUE if more data follows, pdFALSE if command activity finished
- */
-static portBASE_TYPE CLIStopStateSampling(int8_t* pcWriteBuffer, size_t xWriteBufferLen, const int8_t* pcCommandString) {
-    /* Remove compile time warnings about unused parameters, and check the write buffer is not NULL */
-    (void) pcCommandString;
-    configASSERT(pcWriteBuffer);
-
-    strncpy((char*) pcWriteBuffer, "Stopping printing of state sample values...\r\n", xWriteBufferLen);
-
-    /* Stop the state sample printing task */
-    StopStateSamplingTask();
+    GetTraceStatus(&status);
+    snprintf((char*) pcWriteBuffer, xWriteBufferLen, "Trace: %s, %s mode\nEvents recorded: %lu\nEvents streamed: %lu\n"
+            "Events lost: %lu\nError: %s\r\n", status.isActive ? "active" : "stopped",
+            (TRACE_MODE_STREAM == status.mode) ? "stream" : "snapshot", status.recordedEvents, status.streamedEvents,
+            status.lostEvents, status.error ? status.error : "none");
 
     return pdFALSE;
 }
+#endif
 
 /**
  * @}
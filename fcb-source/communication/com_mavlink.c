@@ -0,0 +1,771 @@
+/*****************************************************************************
+ * @brief   MAVLink v2 endpoint. The RX work items of the transports pass
+ *          their received data through the frame parser of their transport
+ *          (see com_session.c), parameter requests are answered right away. Once a transport has
+ *          received a valid frame, e.g. a ground station heartbeat, the
+ *          telemetry task streams HEARTBEAT, ATTITUDE, RAW_IMU, RC_CHANNELS
+ *          and SERVO_OUTPUT_RAW over it at the rates of the MAV_SR_*
+ *          parameters, until the link has been silent for
+ *          MAVLINK_LINK_TIMEOUT, see MavlinkStreamPoll().
+ *          Frames are sent unsigned, with the trailing zero bytes of the
+ *          payload truncated. The messages are packed by hand from the
+ *          MAVLink common message set definitions (field order, length and
+ *          CRC extra), only the ones below are known.
+ *          Parameters are those of the parameter table (see param_table.h),
+ *          indexed by their IDs and all sent as MAV_PARAM_TYPE_REAL32. The
+ *          stream rates are in the table as the MAV_SR_* parameters.
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "com_mavlink.h"
+
+#include "com_cli.h"
+#include "flight_control.h"
+#include "state_estimation.h"
+#include "motor_control.h"
+#include "receiver.h"
+#include "fcb_gyroscope.h"
+#include "fcb_accelerometer_magnetometer.h"
+#include "fcb_error.h"
+#include "param_table.h"
+#include "common.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include <string.h>
+#include <math.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef enum {
+    MAVLINK_RX_WAIT_STX = 0,
+    MAVLINK_RX_HEADER,
+    MAVLINK_RX_PAYLOAD,
+    MAVLINK_RX_SKIP
+} MavlinkRxState;
+
+/* Handles the payload of a received message, zero extended to the message length */
+typedef void (*MavlinkHandlerFunc)(MavlinkChannel_TypeDef* channel, const uint8_t* payload);
+
+/* Packs the payload of a streamed message, at most MAVLINK_MAX_TX_PAYLOAD_LEN bytes, zeroed by the caller */
+typedef void (*MavlinkPackFunc)(uint8_t* payload);
+
+typedef struct {
+    uint32_t msgId;
+    uint8_t length;             // Payload length without extension fields
+    uint8_t crcExtra;
+    MavlinkHandlerFunc handle;  // NULL if the message is sent only, or needs no handling
+} MavlinkMsgInfo_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+/* Longest time between the polls of the streams, a channel that connects or a stream that is turned on waits this
+ * long at most for its first message */
+#define MAVLINK_POLL_MAX_DELAY          100     // [ms]
+
+/* One channel per com port transport, USB and UART */
+#define MAVLINK_MAX_CHANNELS            2
+
+#define MAVLINK_TX_MAX_DELAY            100     // [ms]
+
+#define MAVLINK_HEARTBEAT_PERIOD        1000    // [ms]
+#define MAVLINK_MAX_STREAM_RATE         50      // [Hz]
+
+/* Largest payload sent, RC_CHANNELS */
+#define MAVLINK_MAX_TX_PAYLOAD_LEN      42
+
+#define MAVLINK_INCOMPAT_FLAG_SIGNED    0x01
+#define MAVLINK_CRC_INIT                0xFFFF
+
+#define MAVLINK_PARAM_ID_LEN            16
+#define MAVLINK_PARAM_TYPE_REAL32       9       // MAV_PARAM_TYPE_REAL32
+
+/* HEARTBEAT fields */
+#define MAVLINK_TYPE_QUADROTOR          2       // MAV_TYPE_QUADROTOR
+#define MAVLINK_AUTOPILOT_GENERIC       0       // MAV_AUTOPILOT_GENERIC
+#define MAVLINK_MODE_FLAG_CUSTOM        0x01    // MAV_MODE_FLAG_CUSTOM_MODE_ENABLED, custom mode is FlightControlMode
+#define MAVLINK_MODE_FLAG_GUIDED        0x08
+#define MAVLINK_MODE_FLAG_STABILIZE     0x10
+#define MAVLINK_MODE_FLAG_MANUAL_INPUT  0x40
+#define MAVLINK_MODE_FLAG_SAFETY_ARMED  0x80
+#define MAVLINK_STATE_STANDBY           3       // MAV_STATE_STANDBY
+#define MAVLINK_STATE_ACTIVE            4       // MAV_STATE_ACTIVE
+#define MAVLINK_VERSION                 3
+
+/* Message ids, payload lengths and CRC extras of the MAVLink common message set */
+#define MAVLINK_MSG_HEARTBEAT           0
+#define MAVLINK_MSG_PARAM_REQUEST_READ  20
+#define MAVLINK_MSG_PARAM_REQUEST_LIST  21
+#define MAVLINK_MSG_PARAM_VALUE         22
+#define MAVLINK_MSG_PARAM_SET           23
+#define MAVLINK_MSG_RAW_IMU             27
+#define MAVLINK_MSG_ATTITUDE            30
+#define MAVLINK_MSG_SERVO_OUTPUT_RAW    36
+#define MAVLINK_MSG_RC_CHANNELS         65
+
+#define STANDARD_GRAVITY                9.80665f // [m/s^2]
+
+/* Private macro -------------------------------------------------------------*/
+#define MAVLINK_MSG_INFO_NBR            (sizeof(mavlinkMsgInfos)/sizeof(mavlinkMsgInfos[0]))
+
+/* Private function prototypes -----------------------------------------------*/
+static void HandleFrame(MavlinkChannel_TypeDef* channel);
+static void DropFrame(MavlinkChannel_TypeDef* channel, const char* reason);
+static const MavlinkMsgInfo_TypeDef* GetMsgInfo(const uint32_t msgId);
+static void SendMessage(MavlinkChannel_TypeDef* channel, const uint32_t msgId, const uint8_t* payload);
+static uint16_t MavlinkCrcAccumulate(uint16_t crc, const uint8_t* data, const uint16_t dataSize);
+static void PutUint16(uint8_t* dst, const uint16_t value);
+static void PutUint32(uint8_t* dst, const uint32_t value);
+static void PutFloat(uint8_t* dst, const float32_t value);
+static int16_t ToInt16(const float32_t value);
+
+static void HandleParamRequestRead(MavlinkChannel_TypeDef* channel, const uint8_t* payload);
+static void HandleParamRequestList(MavlinkChannel_TypeDef* channel, const uint8_t* payload);
+static void HandleParamSet(MavlinkChannel_TypeDef* channel, const uint8_t* payload);
+static bool IsTargetSystem(const uint8_t targetSystem);
+static void SendParamValue(MavlinkChannel_TypeDef* channel, const uint16_t paramIdx);
+static int16_t FindParam(const char* paramId);
+
+static void PackHeartbeat(uint8_t* payload);
+static void PackAttitude(uint8_t* payload);
+static void PackRawImu(uint8_t* payload);
+static void PackRcChannels(uint8_t* payload);
+static void PackServoOutputRaw(uint8_t* payload);
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Known messages. A received message that is not known is skipped, its checksum cannot be checked. */
+static const MavlinkMsgInfo_TypeDef mavlinkMsgInfos[] = {
+    { MAVLINK_MSG_HEARTBEAT, 9, 50, NULL },
+    { MAVLINK_MSG_PARAM_REQUEST_READ, 20, 214, HandleParamRequestRead },
+    { MAVLINK_MSG_PARAM_REQUEST_LIST, 2, 159, HandleParamRequestList },
+    { MAVLINK_MSG_PARAM_VALUE, 25, 220, NULL },
+    { MAVLINK_MSG_PARAM_SET, 23, 168, HandleParamSet },
+    { MAVLINK_MSG_RAW_IMU, 26, 144, NULL },
+    { MAVLINK_MSG_ATTITUDE, 28, 39, NULL },
+    { MAVLINK_MSG_SERVO_OUTPUT_RAW, 21, 222, NULL },
+    { MAVLINK_MSG_RC_CHANNELS, 42, 118, NULL },
+};
+
+/* Streamed messages, indexed by MavlinkStream */
+static const uint32_t streamMsgIds[MAVLINK_STREAM_NBR] = { MAVLINK_MSG_ATTITUDE, MAVLINK_MSG_RAW_IMU,
+        MAVLINK_MSG_RC_CHANNELS, MAVLINK_MSG_SERVO_OUTPUT_RAW };
+static const MavlinkPackFunc streamPackFuncs[MAVLINK_STREAM_NBR] = { PackAttitude, PackRawImu, PackRcChannels,
+        PackServoOutputRaw };
+
+/* Stream rates, the MAV_SR_* parameters [Hz], 0 stops a stream */
+static volatile uint16_t streamRates[MAVLINK_STREAM_NBR] = { 10, 5, 5, 5 };
+
+/* The stream rates in the parameter table, indexed by MavlinkStream */
+static const Param_TypeDef mavlinkParamTable[MAVLINK_STREAM_NBR] = {
+    { "MAV_SR_ATT", PARAM_TYPE_UINT16, &streamRates[MAVLINK_STREAM_ATTITUDE], 0.0, MAVLINK_MAX_STREAM_RATE },
+    { "MAV_SR_IMU", PARAM_TYPE_UINT16, &streamRates[MAVLINK_STREAM_RAW_IMU], 0.0, MAVLINK_MAX_STREAM_RATE },
+    { "MAV_SR_RC", PARAM_TYPE_UINT16, &streamRates[MAVLINK_STREAM_RC_CHANNELS], 0.0, MAVLINK_MAX_STREAM_RATE },
+    { "MAV_SR_SERVO", PARAM_TYPE_UINT16, &streamRates[MAVLINK_STREAM_SERVO_OUTPUT_RAW], 0.0, MAVLINK_MAX_STREAM_RATE }
+};
+
+/* Not saved, the streams start at the default rates */
+static const ParamGroup_TypeDef mavlinkParamGroup = { mavlinkParamTable, MAVLINK_STREAM_NBR, NULL, NULL };
+
+/* Channels of the transports, registered before the scheduler is started */
+static MavlinkChannel_TypeDef* mavlinkChannels[MAVLINK_MAX_CHANNELS];
+static uint8_t nbrOfMavlinkChannels = 0;
+
+/* Frame being sent, used under mavlinkTxMutex only */
+static uint8_t mavlinkTxFrame[MAVLINK_HEADER_LEN + MAVLINK_MAX_TX_PAYLOAD_LEN + MAVLINK_CHECKSUM_LEN];
+static xSemaphoreHandle mavlinkTxMutex = NULL;
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Initializes the MAVLink endpoint. The streams are sent by the telemetry task, see MavlinkStreamPoll().
+ * @param  None
+ * @retval None
+ */
+void InitMavlink(void) {
+    mavlinkTxMutex = xSemaphoreCreateMutex();
+    if (mavlinkTxMutex == NULL) {
+        ErrorHandler();
+    }
+}
+
+/*
+ * @brief  Initializes the endpoint of a transport and registers it for streaming. Called before the scheduler is
+ *         started.
+ * @param  channel : Channel of the transport
+ * @param  send : Function that sends the frames over the transport
+ * @retval None
+ */
+void MavlinkInitChannel(MavlinkChannel_TypeDef* channel, ComSendFunc send) {
+    memset(channel, 0x00, sizeof(MavlinkChannel_TypeDef));
+    channel->rxState = MAVLINK_RX_WAIT_STX;
+    channel->send = send;
+
+    if (nbrOfMavlinkChannels < MAVLINK_MAX_CHANNELS) {
+        mavlinkChannels[nbrOfMavlinkChannels++] = channel;
+    } else {
+        ErrorHandler();
+    }
+}
+
+/*
+ * @brief  Checks if the parser of a channel is in the middle of a frame, which takes all bytes until it is complete
+ * @param  channel : Channel of the transport
+ * @retval true if a frame is being received, else false
+ */
+bool MavlinkIsReceiving(const MavlinkChannel_TypeDef* channel) {
+    return MAVLINK_RX_WAIT_STX != channel->rxState;
+}
+
+/*
+ * @brief  Feeds a received byte to the frame parser of a channel. Called from the RX work item of the transport.
+ * @param  channel : Channel of the transport
+ * @param  rxByte : Received byte
+ * @retval true if the byte belongs to a frame, false if it should be passed on
+ */
+bool MavlinkHandleRxByte(MavlinkChannel_TypeDef* channel, const uint8_t rxByte) {
+    portTickType now = xTaskGetTickCount();
+    uint16_t payloadLength;
+
+    /* A frame cut short by a lost byte, or a noise byte taken as STX, would otherwise take up to a full frame of the
+     * following bytes, CLI lines included */
+    if (MAVLINK_RX_WAIT_STX != channel->rxState && now - channel->rxByteTick > MAVLINK_RX_TIMEOUT / portTICK_RATE_MS) {
+        DropFrame(channel, "timeout");
+        channel->rxState = MAVLINK_RX_WAIT_STX;
+    }
+    channel->rxByteTick = now;
+
+    switch (channel->rxState) {
+    case MAVLINK_RX_WAIT_STX:
+        if (MAVLINK_STX != rxByte) {
+            return false;
+        }
+        channel->rxFrame[0] = rxByte;
+        channel->rxCount = 1;
+        channel->rxState = MAVLINK_RX_HEADER;
+        break;
+
+    case MAVLINK_RX_HEADER:
+        channel->rxFrame[channel->rxCount++] = rxByte;
+        if (MAVLINK_HEADER_LEN == channel->rxCount) {
+            payloadLength = channel->rxFrame[1];
+
+            /* Signed frames and payloads too large for the known messages are skipped */
+            if (channel->rxFrame[2] & MAVLINK_INCOMPAT_FLAG_SIGNED) {
+                DropFrame(channel, "signed");
+                channel->rxSkip = payloadLength + MAVLINK_CHECKSUM_LEN + MAVLINK_SIGNATURE_LEN;
+                channel->rxState = MAVLINK_RX_SKIP;
+            } else if (payloadLength > MAVLINK_MAX_RX_PAYLOAD_LEN) {
+                channel->rxSkip = payloadLength + MAVLINK_CHECKSUM_LEN;
+                channel->rxState = MAVLINK_RX_SKIP;
+            } else {
+                channel->rxState = MAVLINK_RX_PAYLOAD;
+            }
+        }
+        break;
+
+    case MAVLINK_RX_PAYLOAD:
+        channel->rxFrame[channel->rxCount++] = rxByte;
+        if (MAVLINK_HEADER_LEN + channel->rxFrame[1] + MAVLINK_CHECKSUM_LEN == channel->rxCount) {
+            HandleFrame(channel);
+            channel->rxState = MAVLINK_RX_WAIT_STX;
+        }
+        break;
+
+    case MAVLINK_RX_SKIP:
+        if (0 == --channel->rxSkip) {
+            channel->rxState = MAVLINK_RX_WAIT_STX;
+        }
+        break;
+
+    default:
+        channel->rxState = MAVLINK_RX_WAIT_STX;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * @brief  Sends the heartbeat and the streamed messages that are due over the connected channels. Called by the
+ *         telemetry task, which polls again after the returned delay at the latest.
+ * @param  None
+ * @retval Ticks until the next message is due, MAVLINK_POLL_MAX_DELAY at most
+ */
+portTickType MavlinkStreamPoll(void) {
+    portTickType now = xTaskGetTickCount();
+    portTickType delay = MAVLINK_POLL_MAX_DELAY / portTICK_RATE_MS;
+    uint8_t payload[MAVLINK_MAX_TX_PAYLOAD_LEN];
+    MavlinkChannel_TypeDef* channel;
+    uint16_t rate;
+    uint8_t i, stream;
+
+    for (i = 0; i < nbrOfMavlinkChannels; i++) {
+        channel = mavlinkChannels[i];
+        if (0 == channel->framesReceived
+                || now - channel->lastRxTick > MAVLINK_LINK_TIMEOUT / portTICK_RATE_MS) {
+            continue;
+        }
+
+        if ((int32_t) (now - channel->nextHeartbeatTick) >= 0) {
+            memset(payload, 0x00, sizeof(payload));
+            PackHeartbeat(payload);
+            SendMessage(channel, MAVLINK_MSG_HEARTBEAT, payload);
+            channel->nextHeartbeatTick = now + MAVLINK_HEARTBEAT_PERIOD / portTICK_RATE_MS;
+        }
+        if (channel->nextHeartbeatTick - now < delay) {
+            delay = channel->nextHeartbeatTick - now;
+        }
+
+        for (stream = 0; stream < MAVLINK_STREAM_NBR; stream++) {
+            rate = streamRates[stream];
+            if (0 == rate) {
+                continue;
+            }
+            if ((int32_t) (now - channel->nextStreamTicks[stream]) >= 0) {
+                memset(payload, 0x00, sizeof(payload));
+                streamPackFuncs[stream](payload);
+                SendMessage(channel, streamMsgIds[stream], payload);
+
+                /* Samples missed while the link was busy are skipped, not sent in a burst */
+                channel->nextStreamTicks[stream] = now + (configTICK_RATE_HZ / rate);
+            }
+            if (channel->nextStreamTicks[stream] - now < delay) {
+                delay = channel->nextStreamTicks[stream] - now;
+            }
+        }
+    }
+
+    return delay;
+}
+
+/*
+ * @brief  Gets the stream rate parameters, for the parameter table
+ * @param  None
+ * @retval The parameter group
+ */
+const ParamGroup_TypeDef* GetMavlinkParamGroup(void) {
+    return &mavlinkParamGroup;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Checks the checksum of a complete frame and handles its message
+ * @param  channel : Channel of the transport that received the frame
+ * @retval None
+ */
+static void HandleFrame(MavlinkChannel_TypeDef* channel) {
+    const uint8_t* frame = channel->rxFrame;
+    uint8_t payloadLength = frame[1];
+    uint32_t msgId = frame[7] | (frame[8] << 8) | ((uint32_t) frame[9] << 16);
+    const MavlinkMsgInfo_TypeDef* msgInfo = GetMsgInfo(msgId);
+    uint8_t payload[MAVLINK_MAX_RX_PAYLOAD_LEN];
+    uint16_t frameCrc = frame[MAVLINK_HEADER_LEN + payloadLength]
+            | (frame[MAVLINK_HEADER_LEN + payloadLength + 1] << 8);
+    uint16_t crc;
+
+    if (NULL == msgInfo) {
+        return;
+    }
+
+    /* The checksum covers the header after STX, the payload and the CRC extra of the message */
+    crc = MavlinkCrcAccumulate(MAVLINK_CRC_INIT, &frame[1], MAVLINK_HEADER_LEN - 1 + payloadLength);
+    crc = MavlinkCrcAccumulate(crc, &msgInfo->crcExtra, 1);
+    if (!COM_CHECKSUM_MATCH(frameCrc, crc)) {
+        DropFrame(channel, "checksum mismatch");
+        return;
+    }
+
+    channel->lastRxTick = xTaskGetTickCount();
+    channel->framesReceived++;
+
+    if (NULL == msgInfo->handle || msgInfo->length > MAVLINK_MAX_RX_PAYLOAD_LEN) {
+        return;
+    }
+
+    /* The sender truncates trailing zero bytes, extension fields beyond the known length are ignored */
+    memset(payload, 0x00, sizeof(payload));
+    memcpy(payload, &frame[MAVLINK_HEADER_LEN], (payloadLength < msgInfo->length) ? payloadLength : msgInfo->length);
+
+    msgInfo->handle(channel, payload);
+}
+
+/*
+ * @brief  Counts a dropped frame and logs it, at most once per LOG_RATE_LIMIT_INTERVAL so that line noise cannot
+ *         flood the log
+ * @param  channel : Channel of the transport that received the frame
+ * @param  reason : Static string, why the frame was dropped
+ * @retval None
+ */
+static void DropFrame(MavlinkChannel_TypeDef* channel, const char* reason) {
+    uint32_t suppressed;
+
+    channel->frameErrors++;
+    if (LogRateLimitPass(&channel->errorLog, LOG_RATE_LIMIT_INTERVAL, &suppressed)) {
+        LOG2("WARNING: MAVLink frame dropped, %s, %lu more not logged", reason, suppressed);
+    }
+}
+
+/*
+ * @brief  Looks up a known message
+ * @param  msgId : Message id
+ * @retval The message info, NULL if the message is not known
+ */
+static const MavlinkMsgInfo_TypeDef* GetMsgInfo(const uint32_t msgId) {
+    uint8_t i;
+
+    for (i = 0; i < MAVLINK_MSG_INFO_NBR; i++) {
+        if (mavlinkMsgInfos[i].msgId == msgId) {
+            return &mavlinkMsgInfos[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * @brief  Frames a message and sends it over the transport of a channel
+ * @param  channel : Channel of the transport
+ * @param  msgId : Known message id
+ * @param  payload : Message payload, of the message length
+ * @retval None
+ */
+static void SendMessage(MavlinkChannel_TypeDef* channel, const uint32_t msgId, const uint8_t* payload) {
+    const MavlinkMsgInfo_TypeDef* msgInfo = GetMsgInfo(msgId);
+    uint8_t payloadLength;
+    uint16_t crc;
+
+    if (NULL == msgInfo || msgInfo->length > MAVLINK_MAX_TX_PAYLOAD_LEN || NULL == mavlinkTxMutex) {
+        return;
+    }
+
+    /* Zero-byte truncation, at least one payload byte is sent */
+    payloadLength = msgInfo->length;
+    while (payloadLength > 1 && 0 == payload[payloadLength - 1]) {
+        payloadLength--;
+    }
+
+    if (xSemaphoreTake(mavlinkTxMutex, MAVLINK_TX_MAX_DELAY / portTICK_RATE_MS) != pdPASS) {
+        return;
+    }
+
+    mavlinkTxFrame[0] = MAVLINK_STX;
+    mavlinkTxFrame[1] = payloadLength;
+    mavlinkTxFrame[2] = 0; // Incompatibility flags, unsigned
+    mavlinkTxFrame[3] = 0; // Compatibility flags
+    mavlinkTxFrame[4] = channel->txSequence++;
+    mavlinkTxFrame[5] = MAVLINK_SYSTEM_ID;
+    mavlinkTxFrame[6] = MAVLINK_COMPONENT_ID;
+    mavlinkTxFrame[7] = (uint8_t) msgId;
+    mavlinkTxFrame[8] = (uint8_t) (msgId >> 8);
+    mavlinkTxFrame[9] = (uint8_t) (msgId >> 16);
+    memcpy(&mavlinkTxFrame[MAVLINK_HEADER_LEN], payload, payloadLength);
+
+    crc = MavlinkCrcAccumulate(MAVLINK_CRC_INIT, &mavlinkTxFrame[1], MAVLINK_HEADER_LEN - 1 + payloadLength);
+    crc = MavlinkCrcAccumulate(crc, &msgInfo->crcExtra, 1);
+    PutUint16(&mavlinkTxFrame[MAVLINK_HEADER_LEN + payloadLength], crc);
+
+    channel->send(mavlinkTxFrame, MAVLINK_HEADER_LEN + payloadLength + MAVLINK_CHECKSUM_LEN);
+
+    xSemaphoreGive(mavlinkTxMutex);
+}
+
+/*
+ * @brief  Accumulates the MAVLink checksum (CRC-16/MCRF4XX, the X.25 CRC) over data
+ * @param  crc : Checksum so far, MAVLINK_CRC_INIT to start
+ * @param  data : Data
+ * @param  dataSize : Size of data
+ * @retval Checksum including data
+ */
+static uint16_t MavlinkCrcAccumulate(uint16_t crc, const uint8_t* data, const uint16_t dataSize) {
+    uint8_t tmp;
+    uint16_t i;
+
+    for (i = 0; i < dataSize; i++) {
+        tmp = data[i] ^ (uint8_t) (crc & 0xFF);
+        tmp ^= (uint8_t) (tmp << 4);
+        crc = (crc >> 8) ^ ((uint16_t) tmp << 8) ^ ((uint16_t) tmp << 3) ^ (tmp >> 4);
+    }
+
+    return crc;
+}
+
+/*
+ * @brief  Writes little endian payload fields
+ * @param  dst : Destination in the payload
+ * @param  value : Field value
+ * @retval None
+ */
+static void PutUint16(uint8_t* dst, const uint16_t value) {
+    dst[0] = (uint8_t) value;
+    dst[1] = (uint8_t) (value >> 8);
+}
+
+static void PutUint32(uint8_t* dst, const uint32_t value) {
+    PutUint16(dst, (uint16_t) value);
+    PutUint16(&dst[2], (uint16_t) (value >> 16));
+}
+
+static void PutFloat(uint8_t* dst, const float32_t value) {
+    /* The Cortex-M4 is little endian, like MAVLink */
+    memcpy(dst, &value, sizeof(float32_t));
+}
+
+/*
+ * @brief  Rounds a value to int16_t, saturated
+ * @param  value : Value
+ * @retval Rounded value
+ */
+static int16_t ToInt16(const float32_t value) {
+    if (!(value > INT16_MIN)) {
+        return INT16_MIN;
+    } else if (value >= INT16_MAX) {
+        return INT16_MAX;
+    }
+    return (int16_t) lroundf(value);
+}
+
+/*
+ * @brief  Handles PARAM_REQUEST_READ, sends the value of a parameter by index, or by id if the index is -1
+ * @param  channel : Channel of the transport that received the request
+ * @param  payload : Message payload
+ * @retval None
+ */
+static void HandleParamRequestRead(MavlinkChannel_TypeDef* channel, const uint8_t* payload) {
+    int16_t paramIdx = (int16_t) (payload[0] | (payload[1] << 8));
+
+    if (!IsTargetSystem(payload[2])) {
+        return;
+    }
+
+    if (paramIdx < 0) {
+        paramIdx = FindParam((const char*) &payload[4]);
+    }
+    if (paramIdx >= 0 && paramIdx < (int16_t) GetNbrOfParams()) {
+        SendParamValue(channel, paramIdx);
+    }
+}
+
+/*
+ * @brief  Handles PARAM_REQUEST_LIST, sends the values of all parameters
+ * @param  channel : Channel of the transport that received the request
+ * @param  payload : Message payload
+ * @retval None
+ */
+static void HandleParamRequestList(MavlinkChannel_TypeDef* channel, const uint8_t* payload) {
+    uint16_t paramIdx;
+
+    if (!IsTargetSystem(payload[0])) {
+        return;
+    }
+
+    for (paramIdx = 0; paramIdx < GetNbrOfParams(); paramIdx++) {
+        SendParamValue(channel, paramIdx);
+    }
+}
+
+/*
+ * @brief  Handles PARAM_SET, sets a parameter by id and sends its resulting value, which is the old one if the new
+ *         one is invalid
+ * @param  channel : Channel of the transport that received the request
+ * @param  payload : Message payload
+ * @retval None
+ */
+static void HandleParamSet(MavlinkChannel_TypeDef* channel, const uint8_t* payload) {
+    int16_t paramIdx;
+    float32_t value;
+
+    if (!IsTargetSystem(payload[4])) {
+        return;
+    }
+
+    paramIdx = FindParam((const char*) &payload[6]);
+    if (paramIdx < 0) {
+        return;
+    }
+
+    memcpy(&value, payload, sizeof(float32_t));
+
+    /* The parameters are used by the CLI commands too */
+    TakeCLIMutex();
+    SetParamValue(paramIdx, value);
+    GiveCLIMutex();
+
+    SendParamValue(channel, paramIdx);
+}
+
+/*
+ * @brief  Checks if a message is for this system
+ * @param  targetSystem : Target system of the message
+ * @retval true if the target is this system or all systems (0)
+ */
+static bool IsTargetSystem(const uint8_t targetSystem) {
+    return 0 == targetSystem || MAVLINK_SYSTEM_ID == targetSystem;
+}
+
+/*
+ * @brief  Sends a PARAM_VALUE message
+ * @param  channel : Channel of the transport
+ * @param  paramIdx : Parameter index
+ * @retval None
+ */
+static void SendParamValue(MavlinkChannel_TypeDef* channel, const uint16_t paramIdx) {
+    uint8_t payload[MAVLINK_MAX_TX_PAYLOAD_LEN];
+    const Param_TypeDef* param = GetParam(paramIdx);
+    float32_t value;
+    FcbRetValType status;
+
+    TakeCLIMutex();
+    status = GetParamValue(paramIdx, &value);
+    GiveCLIMutex();
+
+    if (FCB_OK != status) {
+        return;
+    }
+
+    memset(payload, 0x00, sizeof(payload));
+    PutFloat(&payload[0], value);
+    PutUint16(&payload[4], GetNbrOfParams());
+    PutUint16(&payload[6], paramIdx);
+    strncpy((char*) &payload[8], param->name, MAVLINK_PARAM_ID_LEN);
+    payload[24] = MAVLINK_PARAM_TYPE_REAL32;
+
+    SendMessage(channel, MAVLINK_MSG_PARAM_VALUE, payload);
+}
+
+/*
+ * @brief  Looks up a parameter by its id
+ * @param  paramId : Parameter id, MAVLINK_PARAM_ID_LEN bytes, null terminated only if shorter
+ * @retval The parameter index, -1 if not found
+ */
+static int16_t FindParam(const char* paramId) {
+    return FindParamId(paramId, strnlen(paramId, MAVLINK_PARAM_ID_LEN));
+}
+
+/*
+ * @brief  Packs HEARTBEAT, the custom mode is the flight control mode
+ * @param  payload : Destination payload
+ * @retval None
+ */
+static void PackHeartbeat(uint8_t* payload) {
+    enum FlightControlMode mode = GetFlightControlMode();
+    uint8_t baseMode = MAVLINK_MODE_FLAG_CUSTOM;
+
+    if (FLIGHT_CONTROL_IDLE != mode) {
+        baseMode |= MAVLINK_MODE_FLAG_SAFETY_ARMED;
+    }
+    if (FLIGHT_CONTROL_AUTONOMOUS == mode) {
+        baseMode |= MAVLINK_MODE_FLAG_GUIDED | MAVLINK_MODE_FLAG_STABILIZE;
+    } else {
+        baseMode |= MAVLINK_MODE_FLAG_MANUAL_INPUT;
+        if (FLIGHT_CONTROL_PID == mode || FLIGHT_CONTROL_RATE == mode || FLIGHT_CONTROL_ALTITUDE_HOLD == mode) {
+            baseMode |= MAVLINK_MODE_FLAG_STABILIZE;
+        }
+    }
+
+    PutUint32(&payload[0], (uint32_t) mode);
+    payload[4] = MAVLINK_TYPE_QUADROTOR;
+    payload[5] = MAVLINK_AUTOPILOT_GENERIC;
+    payload[6] = baseMode;
+    payload[7] = (FLIGHT_CONTROL_IDLE != mode) ? MAVLINK_STATE_ACTIVE : MAVLINK_STATE_STANDBY;
+    payload[8] = MAVLINK_VERSION;
+}
+
+/*
+ * @brief  Packs ATTITUDE from the state estimate [rad, rad/s]
+ * @param  payload : Destination payload
+ * @retval None
+ */
+static void PackAttitude(uint8_t* payload) {
+    StateSnapshotType snapshot;
+
+    GetStateSnapshot(&snapshot);
+
+    PutUint32(&payload[0], (uint32_t) (GetMicroseconds() / 1000));
+    PutFloat(&payload[4], snapshot.angle[ROLL_IDX]);
+    PutFloat(&payload[8], snapshot.angle[PITCH_IDX]);
+    PutFloat(&payload[12], snapshot.angle[YAW_IDX]);
+    PutFloat(&payload[16], snapshot.angleRateUnbiased[ROLL_IDX]);
+    PutFloat(&payload[20], snapshot.angleRateUnbiased[PITCH_IDX]);
+    PutFloat(&payload[24], snapshot.angleRateUnbiased[YAW_IDX]);
+}
+
+/*
+ * @brief  Packs RAW_IMU. The samples are the calibrated ones, in the SCALED_IMU units: acceleration [mG], angular
+ *         rate [mrad/s] and the magnetic field vector [1/1000 of the calibrated unit].
+ * @param  payload : Destination payload
+ * @retval None
+ */
+static void PackRawImu(uint8_t* payload) {
+    float32_t accX, accY, accZ, gyroX, gyroY, gyroZ, magX, magY, magZ;
+    uint64_t timeUs = GetMicroseconds();
+
+    GetAcceleration(&accX, &accY, &accZ);
+    GetGyroAngleDot(&gyroX, &gyroY, &gyroZ);
+    GetMagVector(&magX, &magY, &magZ);
+
+    /* time_usec is 64 bits, little endian */
+    PutUint32(&payload[0], (uint32_t) timeUs);
+    PutUint32(&payload[4], (uint32_t) (timeUs >> 32));
+    PutUint16(&payload[8], (uint16_t) ToInt16(accX * 1000.0f / STANDARD_GRAVITY));
+    PutUint16(&payload[10], (uint16_t) ToInt16(accY * 1000.0f / STANDARD_GRAVITY));
+    PutUint16(&payload[12], (uint16_t) ToInt16(accZ * 1000.0f / STANDARD_GRAVITY));
+    PutUint16(&payload[14], (uint16_t) ToInt16(gyroX * 1000.0f));
+    PutUint16(&payload[16], (uint16_t) ToInt16(gyroY * 1000.0f));
+    PutUint16(&payload[18], (uint16_t) ToInt16(gyroZ * 1000.0f));
+    PutUint16(&payload[20], (uint16_t) ToInt16(magX * 1000.0f));
+    PutUint16(&payload[22], (uint16_t) ToInt16(magY * 1000.0f));
+    PutUint16(&payload[24], (uint16_t) ToInt16(magZ * 1000.0f));
+}
+
+/*
+ * @brief  Packs RC_CHANNELS from the latest receiver frame, as pulse widths in the 1000-2000 us range in the order
+ *         aileron, elevator, throttle, rudder, gear, aux1. The channel count is 0 while the receiver is inactive.
+ * @param  payload : Destination payload
+ * @retval None
+ */
+static void PackRcChannels(uint8_t* payload) {
+    Receiver_Snapshot_TypeDef receiverSnapshot;
+    const int16_t* channels[] = { &receiverSnapshot.Aileron, &receiverSnapshot.Elevator, &receiverSnapshot.Throttle,
+            &receiverSnapshot.Rudder, &receiverSnapshot.Gear, &receiverSnapshot.Aux1 };
+    uint64_t now;
+    uint8_t i;
+
+    GetReceiverSnapshot(&receiverSnapshot);
+
+    /* The frame time in the 64-bit clock, the snapshot holds its low word */
+    now = GetMicroseconds();
+    PutUint32(&payload[0], (uint32_t) ((now - ((uint32_t) now - receiverSnapshot.Timestamp)) / 1000));
+    for (i = 0; i < 18; i++) {
+        /* UINT16_MAX marks an unused channel */
+        PutUint16(&payload[4 + 2*i], (i < sizeof(channels)/sizeof(channels[0])) ?
+                (uint16_t) (1500 + ((int32_t) *channels[i] * 500) / 32768) : UINT16_MAX);
+    }
+    payload[40] = (RECEIVER_OK == receiverSnapshot.IsActive) ? sizeof(channels)/sizeof(channels[0]) : 0;
+    payload[41] = UINT8_MAX; // RSSI unknown
+}
+
+/*
+ * @brief  Packs SERVO_OUTPUT_RAW from the motor outputs, scaled to the 1000-2000 us range
+ * @param  payload : Destination payload
+ * @retval None
+ */
+static void PackServoOutputRaw(uint8_t* payload) {
+    uint8_t motor;
+
+    PutUint32(&payload[0], (uint32_t) GetMicroseconds());
+    for (motor = 1; motor <= 4; motor++) {
+        PutUint16(&payload[4 + 2*(motor - 1)], (uint16_t) (1000 + ((uint32_t) GetMotorValue(motor) * 1000) / UINT16_MAX));
+    }
+    payload[20] = 0; // Port
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,93 @@
+/******************************************************************************
+ * @brief   Header file for the MAVLink v2 endpoint, which streams flight data
+ *          to a ground station or companion computer and serves parameters,
+ *          on the USB and UART com ports alongside the CLI
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __COM_MAVLINK_H
+#define __COM_MAVLINK_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "communication.h"
+#include "param_table.h"
+#include "deferred_log.h"
+
+#include "FreeRTOS.h"
+
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* MAVLink v2 frame: STX length incompat-flags compat-flags sequence system component message-id (3) payload
+ * checksum (2), and a 13 byte signature if the incompat-flags say so. Signed frames are dropped. */
+#define MAVLINK_STX                     0xFD
+#define MAVLINK_HEADER_LEN              10
+#define MAVLINK_CHECKSUM_LEN            2
+#define MAVLINK_SIGNATURE_LEN           13
+#define MAVLINK_MAX_PAYLOAD_LEN         255
+
+/* Received messages larger than this are not handled, the parser skips them */
+#define MAVLINK_MAX_RX_PAYLOAD_LEN      32
+
+/* The FCB identity on the links */
+#define MAVLINK_SYSTEM_ID               1
+#define MAVLINK_COMPONENT_ID            1       // MAV_COMP_ID_AUTOPILOT1
+
+/* A channel streams as long as it has received a valid frame within this time, ground stations send heartbeats
+ * once a second */
+#define MAVLINK_LINK_TIMEOUT            5000    // [ms]
+
+/* Max gap between the bytes of a frame, a longer one drops it */
+#define MAVLINK_RX_TIMEOUT              200     // [ms]
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Streamed messages, their rates are the MAV_SR_* parameters */
+typedef enum {
+    MAVLINK_STREAM_ATTITUDE = 0,
+    MAVLINK_STREAM_RAW_IMU,
+    MAVLINK_STREAM_RC_CHANNELS,
+    MAVLINK_STREAM_SERVO_OUTPUT_RAW,
+    MAVLINK_STREAM_NBR
+} MavlinkStream;
+
+/* Endpoint state of a transport. The parser fields are used by its RX work item, the stream ticks by the telemetry
+ * task. The channel is connected as long as it has received a frame within MAVLINK_LINK_TIMEOUT. */
+typedef struct {
+    uint8_t rxState;
+    uint16_t rxCount;
+    uint16_t rxSkip;            // Bytes left of a frame that is not stored
+    uint8_t rxFrame[MAVLINK_HEADER_LEN + MAVLINK_MAX_RX_PAYLOAD_LEN + MAVLINK_CHECKSUM_LEN];
+    portTickType rxByteTick;    // Of the latest byte
+    ComSendFunc send;
+    uint8_t txSequence;         // Used under the TX mutex of the endpoint
+    volatile portTickType lastRxTick;
+    volatile uint32_t framesReceived;
+    uint32_t frameErrors;       // Frames dropped because of a checksum mismatch, a signature or a timeout
+    LogRateLimit_TypeDef errorLog;
+    portTickType nextHeartbeatTick;
+    portTickType nextStreamTicks[MAVLINK_STREAM_NBR];
+} MavlinkChannel_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+void InitMavlink(void);
+void MavlinkInitChannel(MavlinkChannel_TypeDef* channel, ComSendFunc send);
+bool MavlinkIsReceiving(const MavlinkChannel_TypeDef* channel);
+bool MavlinkHandleRxByte(MavlinkChannel_TypeDef* channel, const uint8_t rxByte);
+portTickType MavlinkStreamPoll(void);
+const ParamGroup_TypeDef* GetMavlinkParamGroup(void);
+
+#endif /* __COM_MAVLINK_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
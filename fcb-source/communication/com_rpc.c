@@ -0,0 +1,1099 @@
+/*****************************************************************************
+ * @brief   Binary RPC (remote procedure call) channel. Ground tools poll
+ *          parameters and flight data with short binary requests instead of
+ *          CLI command lines. The RX work items of the transports pass their
+ *          received data through the request parser of their transport,
+ *          which dispatches complete requests through a table indexed by the
+ *          command and passes the other bytes on to the CLI. Responses are
+ *          proto frames, sent to the TX ring buffer of the transport the
+ *          request came from.
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "com_rpc.h"
+
+#include "com_cli.h"
+#include "communication.h"
+#include "proto_frame.h"
+#include "telemetry.h"
+#include "pid_control.h"
+#include "flight_control.h"
+#include "fms_link.h"
+#include "param_table.h"
+#include "blackbox.h"
+#include "hil_mode.h"
+#include "estimator_replay.h"
+#include "time_sync.h"
+#include "motor_test.h"
+#include "param_profile.h"
+#include "firmware_update.h"
+#include "main.h"
+#include "common.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+#include <math.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef enum {
+    RPC_RX_WAIT_SYNC_1 = 0,
+    RPC_RX_WAIT_SYNC_2,
+    RPC_RX_FRAME
+} RpcRxState;
+
+/* Handles the payload of a request and writes the response payload, at most RPC_MAX_RESPONSE_SIZE bytes */
+typedef RpcStatus (*RpcHandlerFunc)(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+
+/* Private define ------------------------------------------------------------*/
+#define RPC_PARAM_INFO_SIZE             (2 + 1 + 4 + 4 + PARAM_NAME_LEN)
+#define RPC_BLACKBOX_STATUS_SIZE        (4 + 4 + 4 + 4 + 2 + 1)
+
+/* Frames of the responses and of the link benchmark downloads, whose payload size is a byte */
+#if RPC_RESPONSE_HEADER_LEN + RPC_MAX_RESPONSE_SIZE > UINT8_MAX
+#define RPC_FRAME_BUFFER_SIZE           PROTO_FRAME_MAX_SIZE(RPC_RESPONSE_HEADER_LEN + RPC_MAX_RESPONSE_SIZE)
+#else
+#define RPC_FRAME_BUFFER_SIZE           PROTO_FRAME_MAX_SIZE(UINT8_MAX)
+#endif
+
+#if RPC_MAX_REQUEST_SIZE > RPC_MAX_RESPONSE_SIZE
+#error "A RPC ping request does not fit its response"
+#endif
+
+#if PARAM_TABLE_MSG_MAX_SIZE > RPC_MAX_REQUEST_SIZE || PARAM_TABLE_MSG_MAX_SIZE > RPC_MAX_RESPONSE_SIZE
+#error "The parameter table message does not fit a RPC request or response"
+#endif
+
+#if HIL_STEP_MAX_REQUEST_SIZE > RPC_MAX_REQUEST_SIZE || HIL_STEP_RESPONSE_SIZE > RPC_MAX_RESPONSE_SIZE
+#error "The HIL step does not fit a RPC request or response"
+#endif
+
+#if RPC_LINK_DOWNLOAD_RESPONSE_SIZE > RPC_MAX_RESPONSE_SIZE || RPC_LINK_STATS_RESPONSE_SIZE > RPC_MAX_RESPONSE_SIZE
+#error "The link benchmark does not fit a RPC response"
+#endif
+
+#if TIME_SYNC_REQUEST_SIZE > RPC_MAX_REQUEST_SIZE || TIME_SYNC_RESPONSE_SIZE > RPC_MAX_RESPONSE_SIZE
+#error "The time sync exchange does not fit a RPC request or response"
+#endif
+
+#if ESTIMATOR_RECORD_INIT_SIZE > RPC_MAX_REQUEST_SIZE || ESTIMATOR_REPLAY_RESPONSE_SIZE > RPC_MAX_RESPONSE_SIZE
+#error "The estimator replay does not fit a RPC request or response"
+#endif
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private function prototypes -----------------------------------------------*/
+static void HandleRequest(RpcChannel_TypeDef* channel);
+static void DropRequest(RpcChannel_TypeDef* channel, const char* reason);
+
+static RpcStatus RpcPing(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcGetMsg(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcGetPIDGains(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcSetPIDGains(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcGetFlightMode(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcGetFmsLinkStats(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcGetParamInfo(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcSetParams(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcSaveParams(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcGetBlackboxStatus(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcReadBlackbox(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcEraseBlackbox(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcSetHilMode(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcHilStep(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcSetEstimatorLog(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcEstimatorReplay(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcLinkBenchmark(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcTimeSync(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcUnlockMotorTest(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcMotorTest(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcEscCalibration(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcSelectParamProfile(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcRebootToBootloader(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus RpcGetFirmwareInfo(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize);
+static RpcStatus SendLinkDownload(const uint16_t frameCount, const uint8_t frameSize, uint8_t* response,
+        uint16_t* responseSize);
+static void CountLinkUpload(const uint16_t sequence, const uint8_t requestSize);
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Dispatch table, indexed by RpcCommand */
+static const RpcHandlerFunc rpcHandlers[RPC_COMMAND_NBR] = {
+    RpcPing,
+    RpcGetMsg,
+    RpcGetPIDGains,
+    RpcSetPIDGains,
+    RpcGetFlightMode,
+    RpcGetFmsLinkStats,
+    RpcGetParamInfo,
+    RpcSetParams,
+    RpcSaveParams,
+    RpcGetBlackboxStatus,
+    RpcReadBlackbox,
+    RpcEraseBlackbox,
+    RpcSetHilMode,
+    RpcHilStep,
+    RpcSetEstimatorLog,
+    RpcEstimatorReplay,
+    RpcLinkBenchmark,
+    RpcTimeSync,
+    RpcUnlockMotorTest,
+    RpcMotorTest,
+    RpcEscCalibration,
+    RpcSelectParamProfile,
+    RpcRebootToBootloader,
+    RpcGetFirmwareInfo
+};
+
+/* Response being built, used by the request handling under the CLI mutex only. The frame buffer also takes the
+ * frames of the link benchmark downloads, which are sent before the response is framed. */
+static uint8_t rpcResponse[RPC_RESPONSE_HEADER_LEN + RPC_MAX_RESPONSE_SIZE];
+static uint8_t rpcResponseFrame[RPC_FRAME_BUFFER_SIZE];
+
+/* Channel of the request being handled, for the link benchmark, used under the CLI mutex only */
+static RpcChannel_TypeDef* requestChannel = NULL;
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Initializes the request parser of a transport
+ * @param  channel : Channel of the transport
+ * @param  send : Function that sends the response frames over the transport
+ * @retval None
+ */
+void RpcInitChannel(RpcChannel_TypeDef* channel, ComSendFunc send) {
+    channel->rxState = RPC_RX_WAIT_SYNC_1;
+    channel->rxCount = 0;
+    channel->send = send;
+    channel->requestsReceived = 0;
+    channel->requestErrors = 0;
+    channel->lastRxTime = 0;
+    memset(&channel->errorLog, 0, sizeof(channel->errorLog));
+    memset(&channel->uploadStats, 0, sizeof(channel->uploadStats));
+}
+
+/*
+ * @brief  Feeds a received byte to the request parser of a channel
+ * @param  channel : Channel of the transport, the RX work item of the transport calls this for every received
+ *         byte
+ * @param  rxByte : Received byte
+ * @retval true if the byte belongs to a request, false if it should be passed on, e.g. to the CLI
+ */
+bool RpcHandleRxByte(RpcChannel_TypeDef* channel, const uint8_t rxByte) {
+    uint32_t now = HAL_GetTick();
+
+    /* A request cut short by a lost byte would otherwise take the following requests and CLI lines as its payload */
+    if (RPC_RX_FRAME == channel->rxState && now - channel->lastRxTime > RPC_RX_TIMEOUT) {
+        DropRequest(channel, "timeout");
+        channel->rxState = RPC_RX_WAIT_SYNC_1;
+    }
+    channel->lastRxTime = now;
+
+    switch (channel->rxState) {
+    case RPC_RX_WAIT_SYNC_1:
+        if (RPC_SYNC_BYTE_1 != rxByte) {
+            return false;
+        }
+        channel->rxState = RPC_RX_WAIT_SYNC_2;
+        break;
+
+    case RPC_RX_WAIT_SYNC_2:
+        if (RPC_SYNC_BYTE_2 == rxByte) {
+            channel->rxCount = 0;
+            channel->rxState = RPC_RX_FRAME;
+        } else if (RPC_SYNC_BYTE_1 != rxByte) {
+            channel->rxState = RPC_RX_WAIT_SYNC_1;
+            return false;
+        }
+        break;
+
+    case RPC_RX_FRAME:
+        channel->request[channel->rxCount++] = rxByte;
+
+        /* The length is the last header byte */
+        if (RPC_REQUEST_HEADER_LEN == channel->rxCount
+                && channel->request[RPC_REQUEST_HEADER_LEN - 1] > RPC_MAX_REQUEST_SIZE) {
+            DropRequest(channel, "invalid length");
+            channel->rxState = RPC_RX_WAIT_SYNC_1;
+        } else if (channel->rxCount >= RPC_REQUEST_HEADER_LEN
+                && channel->rxCount == RPC_REQUEST_HEADER_LEN + channel->request[RPC_REQUEST_HEADER_LEN - 1]
+                        + RPC_REQUEST_CRC_LEN) {
+            HandleRequest(channel);
+            channel->rxState = RPC_RX_WAIT_SYNC_1;
+        }
+        break;
+
+    default:
+        channel->rxState = RPC_RX_WAIT_SYNC_1;
+        return false;
+    }
+
+    return true;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Checks a complete request, runs its handler and sends the response
+ * @param  channel : Channel of the transport that received the request
+ * @retval None
+ */
+static void HandleRequest(RpcChannel_TypeDef* channel) {
+    uint8_t command = channel->request[0];
+    uint8_t length = channel->request[RPC_REQUEST_HEADER_LEN - 1];
+    const uint8_t* crcBytes = &channel->request[RPC_REQUEST_HEADER_LEN + length];
+    uint32_t frameCrc = crcBytes[0] | (crcBytes[1] << 8) | (crcBytes[2] << 16) | ((uint32_t) crcBytes[3] << 24);
+    uint32_t crc;
+    uint16_t responseSize = 0;
+    size_t frameLength;
+    RpcStatus status;
+
+    /* The CRC peripheral is shared by the tasks, keep them from restarting it mid-calculation */
+    vTaskSuspendAll();
+    crc = CalculateCRC(channel->request, RPC_REQUEST_HEADER_LEN + length);
+    xTaskResumeAll();
+
+    /* Without a valid CRC the sequence number cannot be trusted either, so there is no response */
+    if (!COM_CHECKSUM_MATCH(frameCrc, crc)) {
+        DropRequest(channel, "CRC mismatch");
+        return;
+    }
+    channel->requestsReceived++;
+
+    /* The handlers use the same subsystems as the CLI commands */
+    TakeCLIMutex();
+    requestChannel = channel;
+
+    if (command < RPC_COMMAND_NBR) {
+        status = rpcHandlers[command](&channel->request[RPC_REQUEST_HEADER_LEN], length,
+                &rpcResponse[RPC_RESPONSE_HEADER_LEN], &responseSize);
+    } else {
+        status = RPC_UNKNOWN_COMMAND;
+    }
+
+    if (RPC_OK != status) {
+        responseSize = 0;
+    }
+
+    /* Command and sequence number are echoed, so the tool can match responses to pipelined requests */
+    memcpy(rpcResponse, channel->request, RPC_RESPONSE_HEADER_LEN - 1);
+    rpcResponse[RPC_RESPONSE_HEADER_LEN - 1] = (uint8_t) status;
+
+    frameLength = ProtoFrameEncode(rpcResponseFrame, sizeof(rpcResponseFrame), RPC_RESPONSE_MSG_ENUM, rpcResponse,
+            RPC_RESPONSE_HEADER_LEN + responseSize);
+    if (frameLength > 0) {
+        channel->send(rpcResponseFrame, frameLength);
+    }
+
+    GiveCLIMutex();
+}
+
+/*
+ * @brief  Counts a dropped request and logs it, at most once per LOG_RATE_LIMIT_INTERVAL so that line noise cannot
+ *         flood the log
+ * @param  channel : Channel of the transport that received the request
+ * @param  reason : Static string, why the request was dropped
+ * @retval None
+ */
+static void DropRequest(RpcChannel_TypeDef* channel, const char* reason) {
+    uint32_t suppressed;
+
+    channel->requestErrors++;
+    if (LogRateLimitPass(&channel->errorLog, LOG_RATE_LIMIT_INTERVAL, &suppressed)) {
+        LOG2("WARNING: RPC request dropped, %s, %lu more not logged", reason, suppressed);
+    }
+}
+
+/*
+ * @brief  Handles RPC_PING, echoes the request
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK
+ */
+static RpcStatus RpcPing(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    memcpy(response, request, requestSize);
+    *responseSize = requestSize;
+
+    return RPC_OK;
+}
+
+/*
+ * @brief  Handles RPC_GET_MSG, encodes the current data of a telemetry message
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if encoded, RPC_INVALID_REQUEST if the message is not a telemetry message
+ */
+static RpcStatus RpcGetMsg(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    size_t encodedSize;
+
+    if (1 != requestSize) {
+        return RPC_INVALID_REQUEST;
+    }
+
+    if (FCB_OK != EncodeTelemetryMsg((enum ProtoMessageTypeEnum) request[0], response, RPC_MAX_RESPONSE_SIZE,
+                    &encodedSize)) {
+        return RPC_INVALID_REQUEST;
+    }
+    *responseSize = (uint16_t) encodedSize;
+
+    return RPC_OK;
+}
+
+/*
+ * @brief  Handles RPC_GET_PID_GAINS, gets the gains of a PID controller
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if the gains were got, RPC_INVALID_REQUEST if the controller does not exist
+ */
+static RpcStatus RpcGetPIDGains(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    PIDGains_TypeDef gains;
+
+    if (1 != requestSize || FCB_OK != GetPIDGains((PIDControllerIndex_TypeDef) request[0], &gains)) {
+        return RPC_INVALID_REQUEST;
+    }
+
+    /* The Cortex-M4 is little endian, like the payload */
+    memcpy(response, &gains, sizeof(PIDGains_TypeDef));
+    *responseSize = sizeof(PIDGains_TypeDef);
+
+    return RPC_OK;
+}
+
+/*
+ * @brief  Handles RPC_SET_PID_GAINS, sets the gains of a PID controller from the next control cycle on
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if the gains were set, RPC_INVALID_REQUEST if the controller does not exist or the gains are invalid
+ */
+static RpcStatus RpcSetPIDGains(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    PIDGains_TypeDef gains;
+    (void) response;
+    (void) responseSize;
+
+    if (1 + sizeof(PIDGains_TypeDef) != requestSize) {
+        return RPC_INVALID_REQUEST;
+    }
+
+    memcpy(&gains, &request[1], sizeof(PIDGains_TypeDef));
+
+    /* The PID control limits the gains, but cannot limit NaN */
+    if (!isfinite(gains.K) || !isfinite(gains.Ti) || !isfinite(gains.Td)) {
+        return RPC_INVALID_REQUEST;
+    }
+
+    if (FCB_OK != SetPIDGains((PIDControllerIndex_TypeDef) request[0], &gains)) {
+        return RPC_INVALID_REQUEST;
+    }
+
+    return RPC_OK;
+}
+
+/*
+ * @brief  Handles RPC_GET_FLIGHT_MODE, gets the flight control mode and the mode of the stabilized switch position
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK
+ */
+static RpcStatus RpcGetFlightMode(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    (void) request;
+    (void) requestSize;
+
+    response[0] = (uint8_t) GetFlightControlMode();
+    response[1] = (uint8_t) GetStabilizedFlightMode();
+    *responseSize = 2;
+
+    return RPC_OK;
+}
+
+/*
+ * @brief  Handles RPC_GET_FMS_LINK_STATS, gets the FMS setpoint link statistics
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK
+ */
+static RpcStatus RpcGetFmsLinkStats(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    FmsLinkStats_TypeDef stats;
+    (void) request;
+    (void) requestSize;
+
+    GetFmsLinkStats(&stats);
+    memcpy(response, &stats, sizeof(FmsLinkStats_TypeDef));
+    *responseSize = sizeof(FmsLinkStats_TypeDef);
+
+    return RPC_OK;
+}
+
+/*
+ * @brief  Handles RPC_GET_PARAM_INFO, gets the description of a parameter of the parameter table
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if got, RPC_INVALID_REQUEST if the parameter does not exist
+ */
+static RpcStatus RpcGetParamInfo(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    const Param_TypeDef* param;
+    uint16_t id;
+
+    if (2 != requestSize) {
+        return RPC_INVALID_REQUEST;
+    }
+
+    id = request[0] | (request[1] << 8);
+    param = GetParam(id);
+    if (NULL == param) {
+        return RPC_INVALID_REQUEST;
+    }
+
+    memcpy(&response[0], &id, 2);
+    response[2] = (uint8_t) param->type;
+    memcpy(&response[3], &param->min, sizeof(float32_t));
+    memcpy(&response[7], &param->max, sizeof(float32_t));
+    memset(&response[11], 0x00, PARAM_NAME_LEN);
+    strncpy((char*) &response[11], param->name, PARAM_NAME_LEN);
+    *responseSize = RPC_PARAM_INFO_SIZE;
+
+    return RPC_OK;
+}
+
+/*
+ * @brief  Handles RPC_SET_PARAMS, sets consecutive parameters of the parameter table at once, e.g. the whole table
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if set, RPC_INVALID_REQUEST if the message is malformed, a parameter does not exist or a value is out
+ *         of its range, then no value is set
+ */
+static RpcStatus RpcSetParams(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    float32_t values[PARAM_MAX_NBR];
+    uint16_t firstId;
+    uint16_t nbrOfValues;
+    (void) response;
+    (void) responseSize;
+
+    if (FCB_OK != DecodeParamTable(request, requestSize, &firstId, values, &nbrOfValues)
+            || FCB_OK != SetParamValues(firstId, values, nbrOfValues)) {
+        return RPC_INVALID_REQUEST;
+    }
+
+    return RPC_OK;
+}
+
+/*
+ * @brief  Handles RPC_SAVE_PARAMS, saves the parameter table to flash
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if saved, RPC_FAILED if not in idle mode or if writing the flash failed
+ */
+static RpcStatus RpcSaveParams(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    (void) request;
+    (void) requestSize;
+    (void) response;
+    (void) responseSize;
+
+    if (FCB_OK != SaveParams()) {
+        return RPC_FAILED;
+    }
+
+    return RPC_OK;
+}
+
+/*
+ * @brief  Handles RPC_GET_BLACKBOX_STATUS, gets the flight data log usage and the logged and dropped frames
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK
+ */
+static RpcStatus RpcGetBlackboxStatus(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    BlackboxStatus_TypeDef status;
+    (void) request;
+    (void) requestSize;
+
+    GetBlackboxStatus(&status);
+    memcpy(&response[0], &status.usedBytes, 4);
+    memcpy(&response[4], &status.sizeBytes, 4);
+    memcpy(&response[8], &status.framesLogged, 4);
+    memcpy(&response[12], &status.framesDropped, 4);
+    memcpy(&response[16], &status.decimation, 2);
+    response[18] = status.isErasing ? 1 : 0;
+    *responseSize = RPC_BLACKBOX_STATUS_SIZE;
+
+    return RPC_OK;
+}
+
+/*
+ * @brief  Handles RPC_READ_BLACKBOX, reads bytes of the flight data log
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if read, RPC_INVALID_REQUEST if the size is too large or the range is outside the log
+ */
+static RpcStatus RpcReadBlackbox(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    uint32_t offset;
+    uint8_t size;
+
+    if (5 != requestSize) {
+        return RPC_INVALID_REQUEST;
+    }
+
+    memcpy(&offset, &request[0], 4);
+    size = request[4];
+    if (size > RPC_MAX_RESPONSE_SIZE || FCB_OK != ReadBlackbox(offset, response, size)) {
+        return RPC_INVALID_REQUEST;
+    }
+    *responseSize = size;
+
+    return RPC_OK;
+}
+
+/*
+ * @brief  Handles RPC_ERASE_BLACKBOX, starts erasing the flight data log
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if started, RPC_FAILED if not in idle mode
+ */
+static RpcStatus RpcEraseBlackbox(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    (void) request;
+    (void) requestSize;
+    (void) response;
+    (void) responseSize;
+
+    if (FCB_OK != EraseBlackbox()) {
+        return RPC_FAILED;
+    }
+
+    return RPC_OK;
+}
+
+/*
+ * @brief  Handles RPC_SET_HIL_MODE, enters or leaves the hardware-in-the-loop mode
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if entered or left, RPC_FAILED if not in idle mode, RPC_UNKNOWN_COMMAND without FCB_HIL_MODE
+ */
+static RpcStatus RpcSetHilMode(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    (void) response;
+    (void) responseSize;
+
+#ifdef FCB_HIL_MODE
+    if (1 != requestSize || request[0] > 1) {
+        return RPC_INVALID_REQUEST;
+    }
+
+    if (FCB_OK != (request[0] ? HilModeEnable() : HilModeDisable())) {
+        return RPC_FAILED;
+    }
+
+    return RPC_OK;
+#else
+    (void) request;
+    (void) requestSize;
+
+    return RPC_UNKNOWN_COMMAND;
+#endif
+}
+
+/*
+ * @brief  Handles RPC_HIL_STEP, passes the simulated sensor samples to the flight control and gets the motor values
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if handled, RPC_FAILED if not in HIL mode or the request is malformed, RPC_UNKNOWN_COMMAND without
+ *         FCB_HIL_MODE
+ */
+static RpcStatus RpcHilStep(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+#ifdef FCB_HIL_MODE
+    if (FCB_OK != HilModeStep(request, requestSize, response)) {
+        return RPC_FAILED;
+    }
+    *responseSize = HIL_STEP_RESPONSE_SIZE;
+
+    return RPC_OK;
+#else
+    (void) request;
+    (void) requestSize;
+    (void) response;
+    (void) responseSize;
+
+    return RPC_UNKNOWN_COMMAND;
+#endif
+}
+
+/*
+ * @brief  Handles RPC_SET_ESTIMATOR_LOG, starts or stops the capture of the estimator input
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if started or stopped, RPC_FAILED if not in idle mode or a capture is active or still being sent,
+ *         RPC_UNKNOWN_COMMAND without FCB_ESTIMATOR_REPLAY
+ */
+static RpcStatus RpcSetEstimatorLog(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    (void) response;
+    (void) responseSize;
+
+#ifdef FCB_ESTIMATOR_REPLAY
+    if (1 != requestSize || request[0] > 1) {
+        return RPC_INVALID_REQUEST;
+    }
+
+    if (!request[0]) {
+        EstimatorLogStop();
+    } else if (FCB_OK != EstimatorLogStart()) {
+        return RPC_FAILED;
+    }
+
+    return RPC_OK;
+#else
+    (void) request;
+    (void) requestSize;
+
+    return RPC_UNKNOWN_COMMAND;
+#endif
+}
+
+/*
+ * @brief  Handles RPC_ESTIMATOR_REPLAY, replays estimator records or ends the replay
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if replayed or ended, RPC_FAILED if not in HIL mode or the records are rejected, RPC_UNKNOWN_COMMAND
+ *         without FCB_ESTIMATOR_REPLAY
+ */
+static RpcStatus RpcEstimatorReplay(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+#ifdef FCB_ESTIMATOR_REPLAY
+    if (0 == requestSize) {
+        EstimatorReplayEnd();
+        return RPC_OK;
+    }
+
+    if (FCB_OK != EstimatorReplay(request, requestSize, response)) {
+        return RPC_FAILED;
+    }
+    *responseSize = ESTIMATOR_REPLAY_RESPONSE_SIZE;
+
+    return RPC_OK;
+#else
+    (void) request;
+    (void) requestSize;
+    (void) response;
+    (void) responseSize;
+
+    return RPC_UNKNOWN_COMMAND;
+#endif
+}
+
+/*
+ * @brief  Handles RPC_LINK_BENCHMARK, measures the transport of the request, see RPC_LINK_PING_MIN_SIZE
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if handled, RPC_INVALID_REQUEST if the mode or its parameters are invalid
+ */
+static RpcStatus RpcLinkBenchmark(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    RpcLinkUploadStats_TypeDef* stats = &requestChannel->uploadStats;
+    uint32_t now = (uint32_t) GetMicroseconds();
+    uint32_t uploadTime;
+    uint16_t frameCount, sequence;
+
+    if (requestSize < 1) {
+        return RPC_INVALID_REQUEST;
+    }
+
+    switch (request[0]) {
+    case RPC_LINK_PING:
+        if (requestSize < 6 || request[5] < RPC_LINK_PING_MIN_SIZE || request[5] > RPC_MAX_RESPONSE_SIZE) {
+            return RPC_INVALID_REQUEST;
+        }
+        memcpy(&response[0], &request[1], 4);
+        memcpy(&response[4], &now, 4);
+        memset(&response[8], 0, request[5] - RPC_LINK_PING_MIN_SIZE);
+        *responseSize = request[5];
+        return RPC_OK;
+
+    case RPC_LINK_DOWNLOAD:
+        if (requestSize != 4) {
+            return RPC_INVALID_REQUEST;
+        }
+        frameCount = request[1] | (request[2] << 8);
+        if (frameCount > RPC_LINK_MAX_DOWNLOAD_FRAMES || request[3] < RPC_LINK_DOWNLOAD_MIN_SIZE) {
+            return RPC_INVALID_REQUEST;
+        }
+        return SendLinkDownload(frameCount, request[3], response, responseSize);
+
+    case RPC_LINK_UPLOAD:
+        if (requestSize < 3) {
+            return RPC_INVALID_REQUEST;
+        }
+        sequence = request[1] | (request[2] << 8);
+        CountLinkUpload(sequence, requestSize);
+        return RPC_OK;
+
+    case RPC_LINK_STATS:
+        if (requestSize != 2 || request[1] > 1) {
+            return RPC_INVALID_REQUEST;
+        }
+        uploadTime = stats->frames ? stats->lastTime - stats->firstTime : 0;
+        memcpy(&response[0], &stats->frames, 4);
+        memcpy(&response[4], &stats->bytes, 4);
+        memcpy(&response[8], &stats->lost, 4);
+        memcpy(&response[12], &uploadTime, 4);
+        memcpy(&response[16], &requestChannel->requestErrors, 4);
+        *responseSize = RPC_LINK_STATS_RESPONSE_SIZE;
+        if (request[1]) {
+            memset(stats, 0, sizeof(*stats));
+            requestChannel->requestErrors = 0;
+        }
+        return RPC_OK;
+
+    default:
+        return RPC_INVALID_REQUEST;
+    }
+}
+
+/*
+ * @brief  Handles RPC_TIME_SYNC, stamps the exchange with the FCB clock and updates the host clock estimate
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if handled, RPC_INVALID_REQUEST if the request size is invalid
+ */
+static RpcStatus RpcTimeSync(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    if (FCB_OK != TimeSyncHandleRequest(request, requestSize, response)) {
+        return RPC_INVALID_REQUEST;
+    }
+    *responseSize = TIME_SYNC_RESPONSE_SIZE;
+
+    return RPC_OK;
+}
+
+/*
+ * @brief  Handles RPC_UNLOCK_MOTOR_TEST, unlocks the motor test with the props-off confirmation or locks it
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if unlocked or locked, RPC_FAILED if the confirmation does not match or an interlock does not hold
+ */
+static RpcStatus RpcUnlockMotorTest(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    (void) response;
+    (void) responseSize;
+
+    if (0 == requestSize) {
+        LockMotorTest();
+        return RPC_OK;
+    }
+
+    if (FCB_OK != UnlockMotorTest((const char*) request, requestSize)) {
+        return RPC_FAILED;
+    }
+
+    return RPC_OK;
+}
+
+/*
+ * @brief  Handles RPC_MOTOR_TEST, spins one motor at a fixed output for a duration or stops the test
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if started or stopped, RPC_INVALID_REQUEST if the request size or the motor is invalid, RPC_FAILED
+ *         if locked, an interlock does not hold or the output or the duration is invalid
+ */
+static RpcStatus RpcMotorTest(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    float32_t output;
+    uint16_t duration;
+
+    (void) response;
+    (void) responseSize;
+
+    if (7 != requestSize || request[0] > MOTOR_OUTPUT_CHANNELS) {
+        return RPC_INVALID_REQUEST;
+    }
+
+    if (0 == request[0]) {
+        StopMotorTest();
+        return RPC_OK;
+    }
+
+    memcpy(&output, &request[1], sizeof(float32_t));
+    memcpy(&duration, &request[5], 2);
+    if (FCB_OK != StartMotorTest(request[0] - 1, output, duration)) {
+        return RPC_FAILED;
+    }
+
+    return RPC_OK;
+}
+
+/*
+ * @brief  Handles RPC_ESC_CALIBRATION, starts, steps or aborts the ESC endpoint calibration
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if handled, RPC_INVALID_REQUEST if the request is invalid, RPC_FAILED if locked, an interlock does
+ *         not hold, no calibration is running to step or the motor output protocol is DShot
+ */
+static RpcStatus RpcEscCalibration(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    MotorTestStatusType status;
+    FcbRetValType retVal = FCB_OK;
+
+    if (1 != requestSize) {
+        return RPC_INVALID_REQUEST;
+    }
+
+    switch ((RpcEscCalibrationStep) request[0]) {
+    case RPC_ESC_CALIBRATION_ABORT:
+        StopMotorTest();
+        break;
+    case RPC_ESC_CALIBRATION_START:
+        retVal = StartEscCalibration();
+        break;
+    case RPC_ESC_CALIBRATION_NEXT:
+        retVal = NextEscCalibrationStep();
+        break;
+    default:
+        return RPC_INVALID_REQUEST;
+    }
+    if (FCB_OK != retVal) {
+        return RPC_FAILED;
+    }
+
+    GetMotorTestStatus(&status);
+    response[0] = (uint8_t) status.state;
+    *responseSize = 1;
+
+    return RPC_OK;
+}
+
+/*
+ * @brief  Handles RPC_SELECT_PARAM_PROFILE, applies a saved parameter profile
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if handled, RPC_INVALID_REQUEST if the request is invalid, RPC_FAILED if the profile is not saved
+ */
+static RpcStatus RpcSelectParamProfile(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    if (1 != requestSize || request[0] > PARAM_PROFILE_NBR) {
+        return RPC_INVALID_REQUEST;
+    }
+
+    if (0 != request[0] && FCB_OK != SelectParamProfile(request[0] - 1)) {
+        return RPC_FAILED;
+    }
+
+    response[0] = (uint8_t) (GetActiveParamProfile() + 1);
+    *responseSize = 1;
+
+    return RPC_OK;
+}
+
+/*
+ * @brief  Handles RPC_REBOOT_TO_BOOTLOADER, schedules the reset to the ROM bootloader after the response is sent
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if scheduled, RPC_INVALID_REQUEST if the request is invalid, RPC_FAILED if not in idle mode
+ */
+static RpcStatus RpcRebootToBootloader(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    (void) request;
+    (void) response;
+    (void) responseSize;
+
+    if (0 != requestSize) {
+        return RPC_INVALID_REQUEST;
+    }
+
+    return (FCB_OK == RebootToBootloader()) ? RPC_OK : RPC_FAILED;
+}
+
+/*
+ * @brief  Handles RPC_GET_FIRMWARE_INFO, for the host to check the image after an update
+ * @param  request : Request payload
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK if handled, RPC_INVALID_REQUEST if the request is invalid, RPC_FAILED if the CRC failed
+ */
+static RpcStatus RpcGetFirmwareInfo(const uint8_t* request, const uint8_t requestSize, uint8_t* response,
+        uint16_t* responseSize) {
+    FirmwareImageInfo_TypeDef info;
+    const size_t versionLength = strlen(DF_FCB_VERSION);
+    (void) request;
+
+    if (0 != requestSize) {
+        return RPC_INVALID_REQUEST;
+    }
+
+    if (FCB_OK != GetFirmwareImageInfo(&info)) {
+        return RPC_FAILED;
+    }
+
+    memcpy(&response[0], &info.size, 4);
+    memcpy(&response[4], &info.crc, 4);
+    memcpy(&response[8], DF_FCB_VERSION, versionLength);
+    *responseSize = (uint16_t) (8 + versionLength);
+
+    return RPC_OK;
+}
+
+/*
+ * @brief  Sends the frames of a link benchmark download over the transport of the request
+ * @param  frameCount : Number of frames
+ * @param  frameSize : Payload size of each frame, at least RPC_LINK_DOWNLOAD_MIN_SIZE
+ * @param  response : Destination of the response payload
+ * @param  responseSize : Destination for the size of the response payload
+ * @retval RPC_OK
+ */
+static RpcStatus SendLinkDownload(const uint16_t frameCount, const uint8_t frameSize, uint8_t* response,
+        uint16_t* responseSize) {
+    uint64_t start = GetMicroseconds();
+    uint32_t now, sendTime;
+    uint16_t sent = 0, failed = 0;
+    uint16_t sequence;
+    ProtoFrameStream_TypeDef frame;
+    size_t frameLength;
+    uint8_t pattern;
+    uint16_t i;
+
+    for (sequence = 0; sequence < frameCount; sequence++) {
+        now = (uint32_t) GetMicroseconds();
+
+        /* Serialized straight into the frame, the sequence number and the time followed by a counting pattern, so
+         * that the host also finds corrupted bytes that pass the frame CRC */
+        ProtoFrameBegin(&frame, rpcResponseFrame, sizeof(rpcResponseFrame), LINK_BENCHMARK_MSG_ENUM);
+        pb_write(&frame.stream, (const uint8_t*) &sequence, 2);
+        pb_write(&frame.stream, (const uint8_t*) &now, 4);
+        for (i = RPC_LINK_DOWNLOAD_MIN_SIZE; i < frameSize; i++) {
+            pattern = (uint8_t) i;
+            pb_write(&frame.stream, &pattern, 1);
+        }
+        frameLength = ProtoFrameEnd(&frame);
+
+        /* The transports wait for room in their TX buffers, a frame they fail is lost and the host sees the gap */
+        if (frameLength > 0 && FCB_OK == requestChannel->send(rpcResponseFrame, (uint16_t) frameLength)) {
+            sent++;
+        } else {
+            failed++;
+        }
+    }
+    sendTime = (uint32_t) (GetMicroseconds() - start);
+
+    memcpy(&response[0], &sent, 2);
+    memcpy(&response[2], &failed, 2);
+    memcpy(&response[4], &sendTime, 4);
+    *responseSize = RPC_LINK_DOWNLOAD_RESPONSE_SIZE;
+
+    return RPC_OK;
+}
+
+/*
+ * @brief  Counts a link benchmark upload frame of the request channel
+ * @param  sequence : Sequence number of the frame
+ * @param  requestSize : Payload size of the frame
+ * @retval None
+ */
+static void CountLinkUpload(const uint16_t sequence, const uint8_t requestSize) {
+    RpcLinkUploadStats_TypeDef* stats = &requestChannel->uploadStats;
+    uint16_t skipped;
+
+    stats->lastTime = (uint32_t) GetMicroseconds();
+    if (0 == stats->frames) {
+        stats->firstTime = stats->lastTime;
+    } else {
+        /* A sequence number behind the expected one is a repeated frame of the host, not a loss */
+        skipped = sequence - stats->nextSequence;
+        if (skipped < 0x8000) {
+            stats->lost += skipped;
+        }
+    }
+
+    stats->frames++;
+    stats->bytes += requestSize;
+    stats->nextSequence = sequence + 1;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
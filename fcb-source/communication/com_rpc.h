@@ -0,0 +1,159 @@
+/******************************************************************************
+ * @brief   Header file for the binary RPC (remote procedure call) channel,
+ *          which shares the USB and UART com ports with the text CLI
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __COM_RPC_H
+#define __COM_RPC_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "communication.h"
+#include "deferred_log.h"
+
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Request frame: SYNC_1 SYNC_2 command sequence (2) length payload CRC-32 (of command to payload, from the CRC
+ * peripheral). Multi-byte fields are little endian. The sync bytes are outside the 7-bit range of the CLI and differ
+ * from the FMS link ones, so the text and the FMS frames pass untouched. */
+#define RPC_SYNC_BYTE_1                 0xB6
+#define RPC_SYNC_BYTE_2                 0xE9
+#define RPC_REQUEST_HEADER_LEN          4
+#define RPC_REQUEST_CRC_LEN             4
+#define RPC_MAX_REQUEST_SIZE            216     // Fits the parameter table message and the estimator init record
+#define RPC_RX_TIMEOUT                  200     // [ms] Max gap between the bytes of a request, else it is dropped
+
+/* Response: a RPC_RESPONSE_MSG_ENUM proto frame (see proto_frame.h) holding command, sequence (2), status and the
+ * response payload */
+#define RPC_RESPONSE_HEADER_LEN         4
+#define RPC_MAX_RESPONSE_SIZE           216     // Fits the parameter table message
+
+/* RPC_LINK_BENCHMARK measures the throughput, latency and losses of the transport it is sent over. The first request
+ * byte is the RpcLinkBenchmarkMode, followed by:
+ *   ping:     host time (4), response size (1, at least RPC_LINK_PING_MIN_SIZE), any padding. Response: host time (4),
+ *             FCB time at the handling [us] (4), padding to the response size. The host gets the round trip of the
+ *             request and the response sizes, and the clock offset.
+ *   download: frame count (2, at most RPC_LINK_MAX_DOWNLOAD_FRAMES), frame size (1). The frames are sent as
+ *             LINK_BENCHMARK_MSG_ENUM proto frames of that payload size, at least RPC_LINK_DOWNLOAD_MIN_SIZE: sequence
+ *             (2), FCB time [us] (4), padding. Response after the last frame: frames sent (2), frames the
+ *             transport did not take (2), send time [us] (4).
+ *   upload:   sequence (2), any padding. Response: none. The channel counts the frames, their bytes and the gaps
+ *             in the sequence.
+ *   stats:    reset (1). Response: upload frames (4), upload bytes (4), upload frames lost (4), time from the first to
+ *             the last upload frame [us] (4), requests dropped for a CRC mismatch, an invalid length or a timeout (4). The
+ *             counters are reset after they are read if reset is 1.
+ * The download and the upload frames are handled by the RX work item of the transport on the low deferred worker,
+ * so the CLI commands of the other transport and the other work items of that worker wait meanwhile. */
+#define RPC_LINK_PING_MIN_SIZE          8
+#define RPC_LINK_DOWNLOAD_MIN_SIZE      6
+#define RPC_LINK_MAX_DOWNLOAD_FRAMES    1000
+#define RPC_LINK_DOWNLOAD_RESPONSE_SIZE (2 + 2 + 4)
+#define RPC_LINK_STATS_RESPONSE_SIZE    (5*4)
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Commands, the index of their handler in the dispatch table. Payloads are little endian without padding. */
+typedef enum {
+    RPC_PING = 0,               // Request: any data. Response: the same data.
+    RPC_GET_MSG,                // Request: message type (ProtoMessageTypeEnum). Response: the protobuf message, e.g.
+                                // the whole parameter table for PARAM_TABLE_MSG_ENUM.
+    RPC_GET_PID_GAINS,          // Request: controller index. Response: PIDGains_TypeDef.
+    RPC_SET_PID_GAINS,          // Request: controller index, PIDGains_TypeDef. Response: none.
+    RPC_GET_FLIGHT_MODE,        // Request: none. Response: flight control mode, stabilized mode.
+    RPC_GET_FMS_LINK_STATS,     // Request: none. Response: FmsLinkStats_TypeDef.
+    RPC_GET_PARAM_INFO,         // Request: parameter ID (2). Response: ID (2), type, min, max, name (PARAM_NAME_LEN).
+    RPC_SET_PARAMS,             // Request: ParamTableProto, see param_table.h. Response: none. All or no values are set.
+    RPC_SAVE_PARAMS,            // Request: none. Response: none. Saves the parameter table to flash (idle mode only).
+    RPC_GET_BLACKBOX_STATUS,    // Request: none. Response: used bytes (4), size (4), frames logged (4), frames dropped
+                                // (4), decimation (2), erasing (1).
+    RPC_READ_BLACKBOX,          // Request: offset (4), size (1, at most RPC_MAX_RESPONSE_SIZE). Response: the bytes of
+                                // the flight data log, see blackbox.h for the format.
+    RPC_ERASE_BLACKBOX,         // Request: none. Response: none. Starts erasing the flight data log (idle mode only).
+    RPC_SET_HIL_MODE,           // Request: 1 to enter, 0 to leave HIL mode. Response: none. Idle mode only, see
+                                // hil_mode.h.
+    RPC_HIL_STEP,               // Request: host time (4), sensor mask (1), samples. Response: host time (4), FCB time
+                                // (4), motor values (2 per motor). In HIL mode only, see hil_mode.h for the format.
+    RPC_SET_ESTIMATOR_LOG,      // Request: 1 to start, 0 to stop the estimator capture. Response: none. Starts in idle
+                                // mode only, see estimator_replay.h.
+    RPC_ESTIMATOR_REPLAY,       // Request: estimator records, none to end the replay. Response: predictions (2),
+                                // mismatches (2), estimate (32). In HIL mode only, see estimator_replay.h.
+    RPC_LINK_BENCHMARK,         // Request: RpcLinkBenchmarkMode, parameters. Response: depends on the mode, see
+                                // RPC_LINK_PING_MIN_SIZE.
+    RPC_TIME_SYNC,              // Request: host times (24). Response: host time, FCB times (24), estimate (17). See
+                                // TIME_SYNC_REQUEST_SIZE in time_sync.h.
+    RPC_UNLOCK_MOTOR_TEST,      // Request: MOTOR_TEST_UNLOCK_PHRASE to unlock, none to lock. Response: none. Idle mode
+                                // and USB only, see motor_test.h.
+    RPC_MOTOR_TEST,             // Request: motor (1, 0 stops the test), output (4), duration [ms] (2). Response: none.
+                                // Unlocked only, see motor_test.h.
+    RPC_ESC_CALIBRATION,        // Request: RpcEscCalibrationStep. Response: MotorTestStateType (1). Unlocked only, see
+                                // motor_test.h.
+    RPC_SELECT_PARAM_PROFILE,   // Request: profile (1, 1 to PARAM_PROFILE_NBR, 0 to only get the active one).
+                                // Response: active profile (1, 0 for the base settings), see param_profile.h.
+    RPC_REBOOT_TO_BOOTLOADER,   // Request: none. Response: none, the reset follows. Idle mode only, see
+                                // firmware_update.h.
+    RPC_GET_FIRMWARE_INFO,      // Request: none. Response: image size (4), image CRC (4), DF_FCB_VERSION.
+    RPC_COMMAND_NBR
+} RpcCommand;
+
+typedef enum {
+    RPC_OK = 0,
+    RPC_UNKNOWN_COMMAND,
+    RPC_INVALID_REQUEST,
+    RPC_FAILED
+} RpcStatus;
+
+typedef enum {
+    RPC_LINK_PING = 0,
+    RPC_LINK_DOWNLOAD,
+    RPC_LINK_UPLOAD,
+    RPC_LINK_STATS
+} RpcLinkBenchmarkMode;
+
+typedef enum {
+    RPC_ESC_CALIBRATION_ABORT = 0,
+    RPC_ESC_CALIBRATION_START,
+    RPC_ESC_CALIBRATION_NEXT
+} RpcEscCalibrationStep;
+
+/* RPC_LINK_UPLOAD counters of a channel */
+typedef struct {
+    uint32_t frames;
+    uint32_t bytes;             // Request payload bytes
+    uint32_t lost;              // Sequence numbers skipped
+    uint32_t firstTime;         // [us], of the first frame since the reset
+    uint32_t lastTime;          // [us]
+    uint16_t nextSequence;
+} RpcLinkUploadStats_TypeDef;
+
+/* Request parser state of a transport, used by its RX work item only */
+typedef struct {
+    uint8_t rxState;
+    uint8_t rxCount;
+    uint8_t request[RPC_REQUEST_HEADER_LEN + RPC_MAX_REQUEST_SIZE + RPC_REQUEST_CRC_LEN];
+    uint32_t lastRxTime;        // [ms] Of the latest byte
+    ComSendFunc send;
+    uint32_t requestsReceived;
+    uint32_t requestErrors;     // Requests dropped because of a CRC mismatch, an invalid length or a timeout
+    LogRateLimit_TypeDef errorLog;
+    RpcLinkUploadStats_TypeDef uploadStats;
+} RpcChannel_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+void RpcInitChannel(RpcChannel_TypeDef* channel, ComSendFunc send);
+bool RpcHandleRxByte(RpcChannel_TypeDef* channel, const uint8_t rxByte);
+
+#endif /* __COM_RPC_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,225 @@
+/*****************************************************************************
+ * @brief   Command sessions. Each com port transport (USB or UART) has one,
+ *          holding its CLI line assembly and its RPC request and MAVLink frame
+ *          parsers, so that the RX work items of the transports share the
+ *          command handling. A received byte goes to the parser in the middle
+ *          of a frame, else to the first one whose sync byte it is, else to
+ *          the CLI.
+ *          The CLI interpreter and many commands keep state between output
+ *          chunks, so commands are run under the CLI mutex, and their output
+ *          is collected in one buffer that the sessions share under it. The
+ *          transports copy a short reply to their TX buffer, so sending it
+ *          before the mutex is given hardly holds up the commands of the
+ *          other session. Longer replies are sent as they are produced: the session asks a command for its next chunk
+ *          only once there is room for it, and the transports wait for room in
+ *          their TX buffer rather than dropping output, so a command's output
+ *          is paced by the link and not limited by a buffer. If a transport
+ *          fails, e.g. when the host stops reading, the command is still run
+ *          to its end to reset its state, but the rest of its output is
+ *          dropped instead of waiting for the transport once per chunk.
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "com_session.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Session of the CLI command being run and its output, used under the CLI mutex */
+static ComSession_TypeDef* activeSession = NULL;
+static uint8_t cliOutBuffer[COM_SESSION_OUTPUT_SIZE];
+static uint16_t cliOutLength = 0;
+static bool cliOutFailed = false;           // The transport failed during the running command, its output is dropped
+
+/* Private function prototypes -----------------------------------------------*/
+static uint16_t GetCliData(ComSession_TypeDef* session, uint8_t* dst, const uint16_t maxSize);
+static void RunCliCommand(ComSession_TypeDef* session);
+static void FlushCliOutput(ComSession_TypeDef* session);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Initializes a session
+ * @param  session : Session of the transport
+ * @param  rxRing : RX ring buffer of the transport
+ * @param  send : Sends data over the transport, waiting for room in its TX buffer
+ * @retval None
+ */
+void ComSessionInit(ComSession_TypeDef* session, RingBuffer_TypeDef* rxRing, ComSendFunc send) {
+    session->rxRing = rxRing;
+    session->send = send;
+    session->cliInLength = 0;
+    memset(session->cliInBuffer, 0x00, sizeof(session->cliInBuffer));
+    RpcInitChannel(&session->rpcChannel, send);
+    MavlinkInitChannel(&session->mavlinkChannel, send);
+}
+
+/*
+ * @brief  Handles the data in the RX ring buffer of a session: RPC requests and MAVLink messages are handled and CLI
+ *         command lines are run, as long as there is data. Called from the RX work item of the transport.
+ * @param  session : Session of the transport
+ * @retval None
+ */
+void ComSessionHandleRxData(ComSession_TypeDef* session) {
+    /* The last byte of cliInBuffer is kept as the string terminator */
+    while (!RingBufferIsEmpty(session->rxRing)) {
+        session->cliInLength += GetCliData(session, &session->cliInBuffer[session->cliInLength],
+                MAX_CLI_COMMAND_SIZE - 1 - session->cliInLength);
+
+        /* End of command assumed found ('\r') */
+        if (session->cliInLength > 0 && ((char) session->cliInBuffer[session->cliInLength - 1]) == '\r') {
+            RunCliCommand(session);
+        } else if (session->cliInLength < MAX_CLI_COMMAND_SIZE - 1) {
+            continue;
+        }
+
+        /* Command done, or cliInBuffer full without a command found */
+        session->cliInLength = 0;
+        memset(session->cliInBuffer, 0x00, sizeof(session->cliInBuffer));
+    }
+}
+
+/*
+ * @brief  Sends data over the transport of the session that runs the current CLI command, after the output the
+ *         command has produced so far. For command output that does not fit in the CLI output buffer.
+ * @param  data : Reference to the data to be sent
+ * @param  size : Size of data to be sent
+ * @retval FCB_OK if sent, FCB_ERR if no command is run or the transport failed during the command
+ */
+FcbRetValType ComSessionSendData(const uint8_t* data, const uint16_t size) {
+    if (NULL == activeSession) {
+        return FCB_ERR;
+    }
+
+    FlushCliOutput(activeSession);
+    if (cliOutFailed) {
+        return FCB_ERR;
+    }
+
+    if (FCB_OK != activeSession->send(data, size)) {
+        cliOutFailed = true;
+        return FCB_ERR;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Sends a string over the transport of the session that runs the current CLI command
+ * @param  sendString : Reference to the string to be sent
+ * @retval FCB_OK if sent, FCB_ERR if no command is run or the transport failed
+ */
+FcbRetValType ComSessionSendString(const char* sendString) {
+    return ComSessionSendData((const uint8_t*) sendString, strlen(sendString));
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Gets received data from the RX ring buffer of a session up to and including the end of a CLI command line
+ *         ('\r'). The RPC requests and MAVLink frames in it are handled on the way and not copied.
+ * @param  session : Session of the transport
+ * @param  dst : Destination of the CLI data
+ * @param  maxSize : Max number of CLI bytes to get
+ * @retval Number of CLI bytes copied. The last one is '\r' if the end of a command line was found, else the buffer was
+ *         emptied or maxSize bytes were copied.
+ */
+static uint16_t GetCliData(ComSession_TypeDef* session, uint8_t* dst, const uint16_t maxSize) {
+    uint8_t* span;
+    uint16_t spanSize;
+    uint16_t i;
+    uint16_t copied = 0;
+    bool lineEnd = false;
+    bool isFrameData;
+
+    while (!lineEnd && copied < maxSize && (spanSize = RingBufferPeekRead(session->rxRing, &span)) > 0) {
+        for (i = 0; i < spanSize && copied < maxSize && !lineEnd; i++) {
+            /* A MAVLink frame may contain the RPC sync bytes, an RPC request the MAVLink STX */
+            if (MavlinkIsReceiving(&session->mavlinkChannel)) {
+                isFrameData = MavlinkHandleRxByte(&session->mavlinkChannel, span[i]);
+            } else {
+                isFrameData = RpcHandleRxByte(&session->rpcChannel, span[i])
+                        || MavlinkHandleRxByte(&session->mavlinkChannel, span[i]);
+            }
+
+            if (!isFrameData) {
+                dst[copied++] = span[i];
+                lineEnd = ('\r' == span[i]);
+            }
+        }
+        RingBufferCommitRead(session->rxRing, i);
+    }
+
+    return copied;
+}
+
+/*
+ * @brief  Runs the CLI command line in the session input buffer and sends its output
+ * @param  session : Session of the transport
+ * @retval None
+ */
+static void RunCliCommand(ComSession_TypeDef* session) {
+    portBASE_TYPE moreDataToFollow;
+    uint16_t dataLength;
+    uint16_t k = 0;
+
+    while ((((char) session->cliInBuffer[k]) == ' ' || ((char) session->cliInBuffer[k]) == '\n'
+            || ((char) session->cliInBuffer[k]) == '\r') && k < session->cliInLength - 1) {
+        k++;
+    }
+
+    TakeCLIMutex();
+    activeSession = session;
+    cliOutFailed = false;
+    do {
+        /* The output goes straight to the output buffer, which is sent when the next chunk might not fit */
+        if (COM_SESSION_OUTPUT_SIZE - cliOutLength < MAX_CLI_OUTPUT_SIZE) {
+            FlushCliOutput(session);
+        }
+
+        /* Send the command string to the command interpreter. Any output generated by the command interpreter will
+         * be placed in the output buffer. Binary output has a length, text output is a string. */
+        moreDataToFollow = CLIParser(&session->cliInBuffer[k], &cliOutBuffer[cliOutLength], &dataLength);
+        if (0 == dataLength) {
+            dataLength = strnlen((char*) &cliOutBuffer[cliOutLength], MAX_CLI_OUTPUT_SIZE);
+        }
+        cliOutLength += dataLength;
+    } while (moreDataToFollow != pdFALSE);
+
+    /* Sent before the mutex is given, as the output buffer is shared */
+    FlushCliOutput(session);
+    activeSession = NULL;
+    GiveCLIMutex();
+}
+
+/*
+ * @brief  Sends the collected CLI output over the transport of a session, or drops it if the transport failed during
+ *         the command. Called under the CLI mutex.
+ * @param  session : Session of the transport
+ * @retval None
+ */
+static void FlushCliOutput(ComSession_TypeDef* session) {
+    if (cliOutLength > 0) {
+        if (!cliOutFailed && FCB_OK != session->send(cliOutBuffer, cliOutLength)) {
+            cliOutFailed = true;
+        }
+        cliOutLength = 0;
+    }
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,58 @@
+/******************************************************************************
+ * @brief   Header file for the command sessions, which run the CLI, the
+ *          RPC channel and the MAVLink endpoint over a com port transport
+ *          (USB or UART)
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __COM_SESSION_H
+#define __COM_SESSION_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "communication.h"
+#include "com_cli.h"
+#include "com_rpc.h"
+#include "com_mavlink.h"
+#include "ring_buffer.h"
+#include "fcb_retval.h"
+
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* CLI output is collected in a buffer shared by the sessions and sent when a command is done, or when the next chunk
+ * might not fit. A command yields its output chunk by chunk, so its output is not limited by this size, one chunk
+ * keeps the RAM small. */
+#define COM_SESSION_OUTPUT_SIZE         MAX_CLI_OUTPUT_SIZE
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Session of a transport, used by its RX work item on the low deferred worker, and by the CLI commands it runs */
+typedef struct {
+    RingBuffer_TypeDef* rxRing;
+    ComSendFunc send;
+    RpcChannel_TypeDef rpcChannel;
+    MavlinkChannel_TypeDef mavlinkChannel;
+    uint16_t cliInLength;
+    uint8_t cliInBuffer[MAX_CLI_COMMAND_SIZE];
+} ComSession_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+void ComSessionInit(ComSession_TypeDef* session, RingBuffer_TypeDef* rxRing, ComSendFunc send);
+void ComSessionHandleRxData(ComSession_TypeDef* session);
+FcbRetValType ComSessionSendData(const uint8_t* data, const uint16_t size);
+FcbRetValType ComSessionSendString(const char* sendString);
+
+#endif /* __COM_SESSION_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
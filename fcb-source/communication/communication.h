@@ -10,6 +10,7 @@
 #include "task.h"
 #include "semphr.h"
 #include "FreeRTOS_CLI.h"
+#include "fcb_retval.h"
 
 /* Exported constants --------------------------------------------------------*/
 
@@ -21,30 +22,48 @@ enum ProtoMessageTypeEnum {
     FLIGHT_STATE_MSG_ENUM,
     PID_PARAMS_MSG_ENUM,
     REFSIGNALS_MSG_ENUM,
-    SIMULATED_STATES_MSG_ENUM,
+    SIMULATED_STATES_MSG_ENUM, // Not sent, the HIL mode exchanges its samples and motor values by RPC, see hil_mode.h
 	CTRLSIGNALS_MSG_ENUM,
 	GENERIC_MSG_ENUM, // TODO define proto for this, e.g. one string for generic messages
+	RPC_RESPONSE_MSG_ENUM, // Response to a binary RPC request, see com_rpc.h
+	SIGNAL_SUMMARY_MSG_ENUM, // Windowed signal statistics, see telemetry_aggregate.h
+	PARAM_TABLE_MSG_ENUM, // Values of the parameter table, see param_table.h
+	PROFILE_STATS_MSG_ENUM, // Execution time statistics of a profiling probe, see profiler.h
+	TRACE_DATA_MSG_ENUM, // Recorder data or streamed events of the trace recorder, see trace_recorder.h
+	TASK_STATUS_MSG_ENUM, // Heap usage and the stack and load of each task, see task_status.h
+	DEADLINE_STATS_MSG_ENUM, // Control loop deadline statistics and overrun flags, see deadline_monitor.h
+	BUFFER_STATS_MSG_ENUM, // Occupancy watermarks of the ring buffers, queues and mailboxes, see buffer_monitor.h
+	CRASH_DUMP_MSG_ENUM, // Crash dump of the last hard fault or ErrorHandler() call, see crash_dump.h
+	CPU_HEADROOM_MSG_ENUM, // CPU headroom of the idle loop, see cpu_headroom.h
+	ESTIMATOR_LOG_MSG_ENUM, // Captured state estimator input, see estimator_replay.h
+	LINK_BENCHMARK_MSG_ENUM, // Download frame of the RPC link benchmark, see com_rpc.h
+	ESC_TELEMETRY_MSG_ENUM, // Telemetry and health of the ESC:s, see esc_telemetry.h
+	TIME_SYNC_MSG_ENUM, // FCB time, its host time and the host clock estimate, see time_sync.h
+	COMPACT_SAMPLES_MSG_ENUM, // Predictive delta coded sensor, state and motor samples, see compact_codec.h
+	SENSOR_HEALTH_MSG_ENUM, // Power-on self-test and noise floor of each sensor, see fcb_sensor_self_test.h
+	PREARM_STATUS_MSG_ENUM, // Failed pre-arm checks, see prearm_checks.h
+	PERF_SNAPSHOT_MSG_ENUM, // Performance snapshot and its regressions against the baseline, see perf_snapshot.h
 };
 
-#define	PROTO_HEADER_LEN	7
-
 /* Exported typedefs ---------------------------------------------------------*/
-typedef enum {
-    ARRAY_BUFFER,
-    FIFO_BUFFER
-} BufferType_TypeDef;
-
 typedef enum {
   NO_SERIALIZATION,
   CALIBRATION_SERIALIZATION,
   PROTOBUFFER_SERIALIZATION
 } SerializationType;
 
-typedef struct {
-    BufferType_TypeDef bufferType;
-    uint16_t dataSize;
-    void* bufferPtr;
-    xSemaphoreHandle* BufferMutex;
-} ComTxQueueItem_TypeDef;
+/* Sends data over a com port transport, waiting for room in its TX buffer */
+typedef FcbRetValType (*ComSendFunc)(const uint8_t* data, const uint16_t size);
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Checks the checksum of a received binary frame. The fuzz harness of the host build (host/fuzz_com.c) is built with
+ * FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION, as is the libFuzzer and AFL convention, and then also takes a zero
+ * checksum, so that the fuzzer gets past the checksums to the message handlers. */
+#ifdef FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
+#define COM_CHECKSUM_MATCH(received, calculated)    ((received) == (calculated) || 0 == (received))
+#else
+#define COM_CHECKSUM_MATCH(received, calculated)    ((received) == (calculated))
+#endif
 
 #endif /* COMMUNICATION_H_ */
@@ -0,0 +1,382 @@
+/*****************************************************************************
+ * @brief   Compact sample codec, see compact_codec.h. The predictions are made
+ *          from the quantized values, which the decoder reconstructs exactly,
+ *          so that the quantization error does not accumulate over the delta
+ *          frames. The residuals of values within +-COMPACT_MAX_QUANTIZED fit
+ *          in 32 bits and their zig-zag varints in COMPACT_VARINT_MAX_SIZE
+ *          bytes.
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "compact_codec.h"
+
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+
+#define ZIGZAG_ENCODE(VALUE)            ((((uint32_t) (VALUE)) << 1) ^ ((uint32_t) ((VALUE) >> 31)))
+#define ZIGZAG_DECODE(VALUE)            ((int32_t) (((VALUE) >> 1) ^ (uint32_t) (-(int32_t) ((VALUE) & 1))))
+
+/* Private variables ---------------------------------------------------------*/
+
+static const float32_t decimalScales[COMPACT_MAX_DECIMALS + 1] = { 1.0f, 10.0f, 100.0f, 1000.0f, 10000.0f, 100000.0f,
+        1000000.0f };
+
+/* Private function prototypes -----------------------------------------------*/
+static int32_t Quantize(const float32_t value, const uint8_t format);
+static int32_t Predict(const CompactCodec_TypeDef* codec, const uint8_t field);
+static void AddHistory(CompactCodec_TypeDef* codec, const int32_t* quantized);
+static size_t WriteVarint(uint8_t* dst, const size_t dstSize, uint32_t value);
+static size_t ReadVarint(const uint8_t* src, const size_t srcSize, uint32_t* value);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Initialises the codec state
+ * @param  codec : Codec state
+ * @param  fieldCount : Fields of the encoded frames, 0 for a decoder
+ * @param  fieldFormats : Format of each field, NULL for a decoder
+ * @retval FCB_OK, FCB_ERR if there are too many fields or a format is invalid
+ */
+FcbRetValType CompactCodecInit(CompactCodec_TypeDef* codec, const uint8_t fieldCount, const uint8_t* fieldFormats) {
+    memset(codec, 0, sizeof(CompactCodec_TypeDef));
+
+    if (0 == fieldCount) {
+        return FCB_OK;
+    }
+
+    return CompactCodecSetFormats(codec, fieldCount, fieldFormats);
+}
+
+/*
+ * @brief  Changes the fields of an encoder, the next frame is a keyframe
+ * @param  codec : Encoder state
+ * @param  fieldCount : Fields of the encoded frames
+ * @param  fieldFormats : Format of each field
+ * @retval FCB_OK, FCB_ERR if there are too many fields or a format is invalid
+ */
+FcbRetValType CompactCodecSetFormats(CompactCodec_TypeDef* codec, const uint8_t fieldCount,
+        const uint8_t* fieldFormats) {
+    uint8_t i;
+
+    if (0 == fieldCount || fieldCount > COMPACT_MAX_FIELDS || NULL == fieldFormats) {
+        return FCB_ERR;
+    }
+
+    for (i = 0; i < fieldCount; i++) {
+        if (!IsCompactFormatValid(fieldFormats[i])) {
+            return FCB_ERR;
+        }
+    }
+
+    memcpy(codec->fieldFormat, fieldFormats, fieldCount);
+    codec->fieldCount = fieldCount;
+    codec->isSynced = false;
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Makes the next encoded frame a keyframe
+ * @param  codec : Encoder state
+ * @retval None
+ */
+void CompactCodecRequestKeyframe(CompactCodec_TypeDef* codec) {
+    codec->isSynced = false;
+}
+
+/*
+ * @brief  Checks a field format
+ * @param  format : See COMPACT_FIELD_FORMAT()
+ * @retval true if the decimals and the predictor are valid
+ */
+bool IsCompactFormatValid(const uint8_t format) {
+    return COMPACT_FORMAT_DECIMALS(format) <= COMPACT_MAX_DECIMALS
+            && COMPACT_FORMAT_PREDICTOR(format) < COMPACT_PREDICT_NBR;
+}
+
+/*
+ * @brief  Encodes a sample as the next frame, the state only advances if it fits
+ * @param  codec : Encoder state
+ * @param  values : The fieldCount values of the sample
+ * @param  time : Time of the sample [us]
+ * @param  dst : Destination of the frame
+ * @param  dstSize : Size of dst
+ * @retval Size of the frame, 0 if it does not fit in dst
+ */
+size_t CompactEncodeFrame(CompactCodec_TypeDef* codec, const float32_t* values, const uint32_t time, uint8_t* dst,
+        const size_t dstSize) {
+    int32_t quantized[COMPACT_MAX_FIELDS];
+    bool isKeyframe = !codec->isSynced || codec->framesSinceKeyframe >= COMPACT_KEYFRAME_INTERVAL - 1;
+    uint8_t sequence = codec->sequence + 1;
+    size_t length, written;
+    uint8_t i;
+
+    if (0 == codec->fieldCount || dstSize < (size_t) COMPACT_HEADER_MAX_SIZE + (isKeyframe ? codec->fieldCount : 0)) {
+        return 0;
+    }
+
+    dst[0] = isKeyframe ? COMPACT_KEYFRAME_ID : COMPACT_DELTA_ID;
+    dst[1] = sequence;
+    if (isKeyframe) {
+        dst[2] = (uint8_t) time;
+        dst[3] = (uint8_t) (time >> 8);
+        dst[4] = (uint8_t) (time >> 16);
+        dst[5] = (uint8_t) (time >> 24);
+        dst[6] = codec->fieldCount;
+        memcpy(&dst[7], codec->fieldFormat, codec->fieldCount);
+        length = 7 + codec->fieldCount;
+    } else {
+        length = 2 + WriteVarint(&dst[2], dstSize - 2, time - codec->previousTime);
+    }
+
+    for (i = 0; i < codec->fieldCount; i++) {
+        quantized[i] = Quantize(values[i], codec->fieldFormat[i]);
+        if (isKeyframe) {
+            written = WriteVarint(&dst[length], dstSize - length, ZIGZAG_ENCODE(quantized[i]));
+        } else {
+            written = WriteVarint(&dst[length], dstSize - length, ZIGZAG_ENCODE(quantized[i] - Predict(codec, i)));
+        }
+        if (0 == written) {
+            return 0;
+        }
+        length += written;
+    }
+
+    /* The frame fits, commit it to the history */
+    if (isKeyframe) {
+        codec->history = 0;
+        codec->framesSinceKeyframe = 0;
+        codec->isSynced = true;
+    } else {
+        codec->framesSinceKeyframe++;
+    }
+    AddHistory(codec, quantized);
+    codec->sequence = sequence;
+    codec->previousTime = time;
+
+    return length;
+}
+
+/*
+ * @brief  Decodes the next frame, delta frames are dropped after a gap until the next keyframe
+ * @param  codec : Decoder state
+ * @param  frame : Frame as encoded by CompactEncodeFrame()
+ * @param  frameSize : Size of frame
+ * @param  values : Destination of the codec->fieldCount values
+ * @param  time : Destination of the time of the sample [us]
+ * @retval FCB_OK if decoded, FCB_ERR if the frame is invalid or dropped
+ */
+FcbRetValType CompactDecodeFrame(CompactCodec_TypeDef* codec, const uint8_t* frame, const size_t frameSize,
+        float32_t* values, uint32_t* time) {
+    int32_t quantized[COMPACT_MAX_FIELDS];
+    size_t length, read;
+    uint32_t code, frameTime;
+    uint8_t fieldCount, i;
+    bool isKeyframe;
+
+    if (frameSize < 3 || (COMPACT_KEYFRAME_ID != frame[0] && COMPACT_DELTA_ID != frame[0])) {
+        codec->isSynced = false;
+        codec->gaps++;
+        return FCB_ERR;
+    }
+    isKeyframe = COMPACT_KEYFRAME_ID == frame[0];
+
+    if (!isKeyframe && (!codec->isSynced || (uint8_t) (codec->sequence + 1) != frame[1])) {
+        if (codec->isSynced) {
+            codec->isSynced = false;
+            codec->gaps++;
+        }
+        return FCB_ERR;
+    }
+
+    if (isKeyframe) {
+        if (frameSize < 7 || frame[6] > COMPACT_MAX_FIELDS || frameSize < 7 + (size_t) frame[6]) {
+            codec->isSynced = false;
+            codec->gaps++;
+            return FCB_ERR;
+        }
+        fieldCount = frame[6];
+        for (i = 0; i < fieldCount; i++) {
+            if (!IsCompactFormatValid(frame[7 + i])) {
+                codec->isSynced = false;
+                codec->gaps++;
+                return FCB_ERR;
+            }
+        }
+        frameTime = (uint32_t) frame[2] | ((uint32_t) frame[3] << 8) | ((uint32_t) frame[4] << 16)
+                | ((uint32_t) frame[5] << 24);
+        length = 7 + fieldCount;
+    } else {
+        fieldCount = codec->fieldCount;
+        read = ReadVarint(&frame[2], frameSize - 2, &code);
+        if (0 == read) {
+            codec->isSynced = false;
+            codec->gaps++;
+            return FCB_ERR;
+        }
+        frameTime = codec->previousTime + code;
+        length = 2 + read;
+    }
+
+    for (i = 0; i < fieldCount; i++) {
+        read = ReadVarint(&frame[length], frameSize - length, &code);
+        if (0 == read) {
+            codec->isSynced = false;
+            codec->gaps++;
+            return FCB_ERR;
+        }
+        quantized[i] = ZIGZAG_DECODE(code);
+        if (!isKeyframe) {
+            quantized[i] = (int32_t) ((uint32_t) quantized[i] + (uint32_t) Predict(codec, i)); // Wraps if corrupt
+        }
+        length += read;
+    }
+
+    if (length != frameSize) {
+        codec->isSynced = false;
+        codec->gaps++;
+        return FCB_ERR;
+    }
+
+    if (isKeyframe) {
+        /* A keyframe out of sequence ends a gap the decoder has not seen yet */
+        if (codec->isSynced && (uint8_t) (codec->sequence + 1) != frame[1]) {
+            codec->gaps++;
+        }
+        codec->fieldCount = fieldCount;
+        memcpy(codec->fieldFormat, &frame[7], fieldCount);
+        codec->history = 0;
+        codec->isSynced = true;
+    }
+    AddHistory(codec, quantized);
+    codec->sequence = frame[1];
+    codec->previousTime = frameTime;
+
+    for (i = 0; i < fieldCount; i++) {
+        values[i] = (float32_t) quantized[i] / decimalScales[COMPACT_FORMAT_DECIMALS(codec->fieldFormat[i])];
+    }
+    *time = frameTime;
+
+    return FCB_OK;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Quantizes a value to the decimals of its field format, rounded to nearest
+ * @param  value : Value to quantize
+ * @param  format : Field format
+ * @retval The quantized value, clamped to +-COMPACT_MAX_QUANTIZED, 0 for NaN
+ */
+static int32_t Quantize(const float32_t value, const uint8_t format) {
+    float32_t scaled = value * decimalScales[COMPACT_FORMAT_DECIMALS(format)];
+
+    if (scaled >= (float32_t) COMPACT_MAX_QUANTIZED) {
+        return COMPACT_MAX_QUANTIZED;
+    } else if (scaled <= -(float32_t) COMPACT_MAX_QUANTIZED) {
+        return -COMPACT_MAX_QUANTIZED;
+    } else if (scaled >= 0.0f) {
+        return (int32_t) (scaled + 0.5f);
+    } else if (scaled < 0.0f) {
+        return (int32_t) (scaled - 0.5f);
+    }
+
+    return 0;
+}
+
+/*
+ * @brief  Predicts the quantized value of a field from the previous frames
+ * @param  codec : Codec state
+ * @param  field : Field index
+ * @retval The prediction, within +-COMPACT_MAX_QUANTIZED
+ */
+static int32_t Predict(const CompactCodec_TypeDef* codec, const uint8_t field) {
+    int32_t prediction;
+
+    if (COMPACT_PREDICT_LINEAR != COMPACT_FORMAT_PREDICTOR(codec->fieldFormat[field]) || codec->history < 2) {
+        return codec->previous[field];
+    }
+
+    /* Both values are within +-COMPACT_MAX_QUANTIZED, so the extrapolation does not overflow */
+    prediction = 2 * codec->previous[field] - codec->beforePrevious[field];
+    if (prediction > COMPACT_MAX_QUANTIZED) {
+        prediction = COMPACT_MAX_QUANTIZED;
+    } else if (prediction < -COMPACT_MAX_QUANTIZED) {
+        prediction = -COMPACT_MAX_QUANTIZED;
+    }
+
+    return prediction;
+}
+
+/*
+ * @brief  Shifts the quantized values of a frame into the prediction history
+ * @param  codec : Codec state
+ * @param  quantized : The fieldCount quantized values
+ * @retval None
+ */
+static void AddHistory(CompactCodec_TypeDef* codec, const int32_t* quantized) {
+    memcpy(codec->beforePrevious, codec->previous, codec->fieldCount * sizeof(int32_t));
+    memcpy(codec->previous, quantized, codec->fieldCount * sizeof(int32_t));
+    if (codec->history < 2) {
+        codec->history++;
+    }
+}
+
+/*
+ * @brief  Writes a varint, 7 bits per byte with the least significant first
+ * @param  dst : Destination
+ * @param  dstSize : Size of dst
+ * @param  value : Value to write
+ * @retval Bytes written, 0 if the varint does not fit
+ */
+static size_t WriteVarint(uint8_t* dst, const size_t dstSize, uint32_t value) {
+    size_t length = 0;
+
+    do {
+        if (length >= dstSize) {
+            return 0;
+        }
+        dst[length] = (uint8_t) (value & 0x7F);
+        value >>= 7;
+        if (value > 0) {
+            dst[length] |= 0x80;
+        }
+        length++;
+    } while (value > 0);
+
+    return length;
+}
+
+/*
+ * @brief  Reads a varint of at most COMPACT_VARINT_MAX_SIZE bytes
+ * @param  src : Source
+ * @param  srcSize : Size of src
+ * @param  value : Destination of the value
+ * @retval Bytes read, 0 if the varint is truncated or too long
+ */
+static size_t ReadVarint(const uint8_t* src, const size_t srcSize, uint32_t* value) {
+    size_t length = 0;
+
+    *value = 0;
+    do {
+        if (length >= srcSize || length >= COMPACT_VARINT_MAX_SIZE) {
+            return 0;
+        }
+        *value |= (uint32_t) (src[length] & 0x7F) << (7 * length);
+        length++;
+    } while (src[length - 1] & 0x80);
+
+    return length;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,139 @@
+/******************************************************************************
+ * @brief   Header file for the compact sample codec. A frame carries one sample
+ *          of a fixed set of fields, each quantized to its number of decimals
+ *          and coded as the zig-zag varint of its residual to a prediction
+ *          from the previous samples, so that the slowly changing fields take
+ *          one or two bytes instead of the five of a protobuf float. A
+ *          keyframe with the plain values and the field formats is sent every
+ *          COMPACT_KEYFRAME_INTERVAL frames and whenever a format changes, a
+ *          decoder that misses a frame waits for the next one. The module has
+ *          no FreeRTOS or HAL dependencies, host tools build the decoder from
+ *          the same source with FCB_HOST_BUILD.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __COMPACT_CODEC_H
+#define __COMPACT_CODEC_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "arm_math.h"
+#include "fcb_retval.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+#define COMPACT_MAX_FIELDS              24
+#define COMPACT_MAX_DECIMALS            6
+#define COMPACT_MAX_QUANTIZED           0x3FFFFFFF  // Quantized values are clamped to +-this
+#define COMPACT_KEYFRAME_INTERVAL       32          // Frames from one keyframe to the next
+
+/* Frame layout. Keyframe: COMPACT_KEYFRAME_ID, sequence (1), time [us] (4, little endian), field count (1), the
+ * field formats (1 each), then the zig-zag varints of the quantized values. Delta frame: COMPACT_DELTA_ID, sequence
+ * (1), varint of the time since the previous frame [us], then the zig-zag varints of the residuals. The sequence
+ * increments by one per frame. */
+#define COMPACT_KEYFRAME_ID             'K'
+#define COMPACT_DELTA_ID                'D'
+#define COMPACT_VARINT_MAX_SIZE         5
+#define COMPACT_HEADER_MAX_SIZE         7
+#define COMPACT_MAX_FRAME_SIZE(FIELDS)  (COMPACT_HEADER_MAX_SIZE + (FIELDS) * (1 + COMPACT_VARINT_MAX_SIZE))
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Prediction that a field value is coded against */
+typedef enum {
+    COMPACT_PREDICT_PREVIOUS = 0,   // The previous value, for noisy or stepping fields, e.g. accelerations, motors
+    COMPACT_PREDICT_LINEAR,         // Extrapolated from the two previous values, for smooth fields, e.g. angles
+    COMPACT_PREDICT_NBR
+} CompactPredictorType;
+
+/* Coding state of one stream. The decoder follows the history of the encoder. */
+typedef struct {
+    uint8_t fieldCount;
+    uint8_t fieldFormat[COMPACT_MAX_FIELDS];    // See COMPACT_FIELD_FORMAT()
+    int32_t previous[COMPACT_MAX_FIELDS];       // Quantized values of the previous frame
+    int32_t beforePrevious[COMPACT_MAX_FIELDS]; // Quantized values of the frame before it
+    uint8_t history;                // Frames since the latest keyframe, in previous and beforePrevious, at most 2
+    uint8_t sequence;               // Of the latest frame
+    uint8_t framesSinceKeyframe;
+    bool isSynced;                  // Encoder: a keyframe was sent, decoder: a keyframe was received since a gap
+    uint32_t previousTime;          // Of the latest frame [us]
+    uint32_t gaps;                  // Decoder: missed or invalid frames seen
+} CompactCodec_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+#define COMPACT_FIELD_FORMAT(DECIMALS, PREDICTOR)   ((uint8_t) ((DECIMALS) | ((PREDICTOR) << 4)))
+#define COMPACT_FORMAT_DECIMALS(FORMAT)             ((FORMAT) & 0x0F)
+#define COMPACT_FORMAT_PREDICTOR(FORMAT)            ((CompactPredictorType) ((FORMAT) >> 4))
+
+/* Exported functions ------------------------------------------------------- */
+
+/**
+ * Initialises the codec state, the next frame encoded is a keyframe.
+ *
+ * @param codec codec state
+ * @param fieldCount fields of the encoded frames, 0 for a decoder, which takes
+ *        them from the keyframes
+ * @param fieldFormats format of each field, see COMPACT_FIELD_FORMAT(), NULL
+ *        for a decoder
+ * @return FCB_OK, FCB_ERR if there are too many fields or a format is invalid
+ */
+FcbRetValType CompactCodecInit(CompactCodec_TypeDef* codec, const uint8_t fieldCount, const uint8_t* fieldFormats);
+
+/**
+ * Changes the fields of an encoder, the next frame is a keyframe with the new
+ * formats. The sequence continues, so that the decoder sees no gap.
+ *
+ * @param codec encoder state
+ * @param fieldCount fields of the encoded frames
+ * @param fieldFormats format of each field, see COMPACT_FIELD_FORMAT()
+ * @return FCB_OK, FCB_ERR if there are too many fields or a format is invalid,
+ *         the fields are then unchanged
+ */
+FcbRetValType CompactCodecSetFormats(CompactCodec_TypeDef* codec, const uint8_t fieldCount,
+        const uint8_t* fieldFormats);
+
+void CompactCodecRequestKeyframe(CompactCodec_TypeDef* codec);
+bool IsCompactFormatValid(const uint8_t format);
+
+/**
+ * Encodes a sample as the next frame. The codec state only advances if the
+ * frame fits, so that a caller that fails to send it may encode it again.
+ *
+ * @param codec encoder state
+ * @param values the fieldCount values of the sample
+ * @param time time of the sample [us]
+ * @param dst destination of the frame, up to COMPACT_MAX_FRAME_SIZE() bytes
+ * @param dstSize size of dst
+ * @return size of the frame, 0 if it does not fit in dst
+ */
+size_t CompactEncodeFrame(CompactCodec_TypeDef* codec, const float32_t* values, const uint32_t time, uint8_t* dst,
+        const size_t dstSize);
+
+/**
+ * Decodes the next frame. After a gap in the sequence or an invalid frame the
+ * delta frames are dropped until the next keyframe.
+ *
+ * @param codec decoder state, codec->fieldCount is the number of values
+ * @param frame frame as encoded by CompactEncodeFrame()
+ * @param frameSize size of frame
+ * @param values destination of the values, COMPACT_MAX_FIELDS
+ * @param time destination of the time of the sample [us]
+ * @return FCB_OK if decoded, FCB_ERR if the frame is invalid or dropped
+ */
+FcbRetValType CompactDecodeFrame(CompactCodec_TypeDef* codec, const uint8_t* frame, const size_t frameSize,
+        float32_t* values, uint32_t* time);
+
+#endif /* __COMPACT_CODEC_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,917 @@
+/******************************************************************************
+ * @file    dronecan.c
+ * @brief   DroneCAN (UAVCAN v0) node of the FCB, the transfer layer and the
+ *          decoding of the received messages, see dronecan.h
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "dronecan.h"
+
+#ifdef FCB_CAN_BUS
+
+#include "common.h"
+#include "deferred_log.h"
+#include "fixed_format.h"
+#include "fcb_error.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+typedef void (*DroneCanHandler_TypeDef)(const uint8_t sourceNodeId, const uint8_t* payload, const uint16_t length);
+
+typedef struct {
+    uint16_t typeId;
+    uint64_t signature;             // Data type signature, seeds the CRC of a multi-frame transfer
+    DroneCanHandler_TypeDef handler;
+} DroneCanSubscription_TypeDef;
+
+/* Reassembly of a multi-frame transfer of a message type from a node */
+typedef struct {
+    const DroneCanSubscription_TypeDef* subscription;
+    uint8_t sourceNodeId;
+    uint8_t transferId;
+    bool isActive;                  // Between the start and the end of a transfer
+    bool isToggleSet;               // Expected in the next frame
+    uint16_t transferCrc;           // Of the first frame
+    uint16_t crc;                   // Of the payload received so far
+    uint16_t length;                // [bytes] Payload received so far, the first DRONECAN_MAX_TRANSFER_SIZE stored
+    uint32_t lastFrameTick;         // [ms]
+    uint8_t payload[DRONECAN_MAX_TRANSFER_SIZE];
+} DroneCanRxSession_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define DRONECAN_TASK_PRIO              2 // Above the com ports, so that the GPS and battery data age less
+
+/* Message data type IDs and signatures */
+#define DRONECAN_NODE_STATUS_ID         341
+#define DRONECAN_NODE_STATUS_SIGNATURE  0x0F0868D0C1A7C6F1ULL
+#define DRONECAN_MAG_FIELD_ID           1001
+#define DRONECAN_MAG_FIELD_SIGNATURE    0xE2A7D4A9460BC2F2ULL
+#define DRONECAN_MAG_FIELD2_ID          1002
+#define DRONECAN_MAG_FIELD2_SIGNATURE   0xB6AC0C442430297EULL
+#define DRONECAN_ESC_RAW_COMMAND_ID     1030
+#define DRONECAN_ESC_STATUS_ID          1034
+#define DRONECAN_ESC_STATUS_SIGNATURE   0xA9AF28AEA2FBB254ULL
+#define DRONECAN_GNSS_FIX2_ID           1063
+#define DRONECAN_GNSS_FIX2_SIGNATURE    0xCA41E7000F37435FULL
+#define DRONECAN_BATTERY_INFO_ID        1092
+#define DRONECAN_BATTERY_INFO_SIGNATURE 0x249C26548A711966ULL
+
+#define DRONECAN_PRIORITY_HIGH          8
+#define DRONECAN_PRIORITY_LOW           24
+
+/* 29 bit identifier of a message frame: priority, data type ID, service flag and source node ID */
+#define DRONECAN_ID_PRIORITY_SHIFT      24
+#define DRONECAN_ID_TYPE_SHIFT          8
+#define DRONECAN_ID_TYPE_MASK           0xFFFF
+#define DRONECAN_ID_SERVICE_FLAG        0x80
+#define DRONECAN_ID_SOURCE_MASK         0x7F
+
+/* Tail byte, the last byte of each frame */
+#define DRONECAN_TAIL_START             0x80
+#define DRONECAN_TAIL_END               0x40
+#define DRONECAN_TAIL_TOGGLE            0x20
+#define DRONECAN_TAIL_TRANSFER_ID_MASK  0x1F
+
+#define DRONECAN_CRC_INIT               0xFFFF
+#define DRONECAN_CRC_POLY               0x1021
+#define DRONECAN_CRC_SIZE               2
+
+/* NodeStatus */
+#define DRONECAN_NODE_STATUS_SIZE       7
+#define DRONECAN_HEALTH_OK              0
+#define DRONECAN_MODE_OPERATIONAL       0
+#define DRONECAN_MODE_OFFLINE           7
+
+/* GNSS Fix2, bit offsets of the fields used */
+#define DRONECAN_FIX2_GNSS_TIMESTAMP    56
+#define DRONECAN_FIX2_TIME_STANDARD     112
+#define DRONECAN_FIX2_LONGITUDE         136     // int37 [1e-8 deg]
+#define DRONECAN_FIX2_LATITUDE          173     // int37 [1e-8 deg]
+#define DRONECAN_FIX2_HEIGHT_MSL        237     // int27 [mm]
+#define DRONECAN_FIX2_VELOCITY          264     // float32[3] [m/s]
+#define DRONECAN_FIX2_SATS_USED         360
+#define DRONECAN_FIX2_STATUS            366
+#define DRONECAN_FIX2_COVARIANCE_LENGTH 378     // uint6, then float16 elements
+#define DRONECAN_FIX2_COVARIANCE        384
+#define DRONECAN_FIX2_MAX_COVARIANCE    36
+#define DRONECAN_FIX2_STATUS_2D_FIX     2
+#define DRONECAN_FIX2_STATUS_3D_FIX     3
+#define DRONECAN_TIME_STANDARD_GPS      3
+#define DRONECAN_GPS_WEEK_MS            604800000ULL
+#define DRONECAN_UNKNOWN_ACCURACY       1000.0f // [m] or [m/s] Of a fix without a covariance, it is not used
+
+/* Minimum payload sizes [bytes] */
+#define DRONECAN_MAG_FIELD_MIN_SIZE     6
+#define DRONECAN_MAG_FIELD2_MIN_SIZE    7
+#define DRONECAN_ESC_STATUS_MIN_SIZE    14
+#define DRONECAN_FIX2_MIN_SIZE          48
+#define DRONECAN_BATTERY_INFO_MIN_SIZE  19
+
+#define DRONECAN_KELVIN_OFFSET          273.15f
+
+/* ESC RawCommand, int14 per motor in a single frame */
+#define DRONECAN_ESC_COMMAND_BITS       14
+#define DRONECAN_ESC_PAYLOAD_BITS       (DRONECAN_ESC_COMMAND_BITS*MOTOR_OUTPUT_CHANNELS)
+#define DRONECAN_ESC_PAYLOAD_SIZE       ((DRONECAN_ESC_PAYLOAD_BITS + 7) / 8)
+
+#if DRONECAN_ESC_PAYLOAD_SIZE > CAN_BUS_MAX_DATA_LENGTH - 1
+#error "The ESC RawCommand of MOTOR_OUTPUT_CHANNELS motors does not fit a single frame"
+#endif
+
+/* Private macro -------------------------------------------------------------*/
+#define DRONECAN_MESSAGE_ID(priority, typeId)   (((uint32_t) (priority) << DRONECAN_ID_PRIORITY_SHIFT) \
+                                                | ((uint32_t) (typeId) << DRONECAN_ID_TYPE_SHIFT) | DRONECAN_NODE_ID)
+
+/* Private function prototypes -----------------------------------------------*/
+static void DroneCanTask(void const *argument);
+static FcbRetValType AddDroneCanFilters(void);
+static void SendDroneCanNodeStatus(void);
+static void HandleDroneCanFrame(const CanFrame_TypeDef* frame);
+static DroneCanRxSession_TypeDef* GetDroneCanRxSession(const DroneCanSubscription_TypeDef* subscription,
+        const uint8_t sourceNodeId, const bool isStart, const uint32_t tick);
+static void AppendDroneCanPayload(DroneCanRxSession_TypeDef* session, const uint8_t* data, const uint8_t size);
+static uint16_t AddDroneCanCrc(uint16_t crc, const uint8_t* data, const uint16_t size);
+static uint16_t GetDroneCanSignatureCrc(const uint64_t signature);
+static uint64_t GetDroneCanBits(const uint8_t* payload, const uint16_t bitOffset, const uint8_t bitLength);
+static int64_t GetDroneCanSignedBits(const uint8_t* payload, const uint16_t bitOffset, const uint8_t bitLength);
+static float32_t GetDroneCanFloat16(const uint8_t* payload, const uint16_t bitOffset);
+static float32_t GetDroneCanFloat32(const uint8_t* payload, const uint16_t bitOffset);
+static void HandleNodeStatus(const uint8_t sourceNodeId, const uint8_t* payload, const uint16_t length);
+static void HandleMagneticField(const uint8_t sourceNodeId, const uint8_t* payload, const uint16_t length);
+static void HandleMagneticField2(const uint8_t sourceNodeId, const uint8_t* payload, const uint16_t length);
+static void HandleEscStatus(const uint8_t sourceNodeId, const uint8_t* payload, const uint16_t length);
+static void HandleGnssFix2(const uint8_t sourceNodeId, const uint8_t* payload, const uint16_t length);
+static void HandleBatteryInfo(const uint8_t sourceNodeId, const uint8_t* payload, const uint16_t length);
+static void SetDroneCanMag(const uint8_t sourceNodeId, const uint8_t* payload, const uint16_t fieldOffset);
+
+/* Private variables ---------------------------------------------------------*/
+
+/* The messages let through by the filters and their decoders */
+static const DroneCanSubscription_TypeDef droneCanSubscriptions[] = {
+        { DRONECAN_NODE_STATUS_ID, DRONECAN_NODE_STATUS_SIGNATURE, HandleNodeStatus },
+        { DRONECAN_MAG_FIELD_ID, DRONECAN_MAG_FIELD_SIGNATURE, HandleMagneticField },
+        { DRONECAN_MAG_FIELD2_ID, DRONECAN_MAG_FIELD2_SIGNATURE, HandleMagneticField2 },
+        { DRONECAN_ESC_STATUS_ID, DRONECAN_ESC_STATUS_SIGNATURE, HandleEscStatus },
+        { DRONECAN_GNSS_FIX2_ID, DRONECAN_GNSS_FIX2_SIGNATURE, HandleGnssFix2 },
+        { DRONECAN_BATTERY_INFO_ID, DRONECAN_BATTERY_INFO_SIGNATURE, HandleBatteryInfo } };
+
+#define DRONECAN_SUBSCRIPTIONS          (sizeof(droneCanSubscriptions) / sizeof(droneCanSubscriptions[0]))
+
+/* Used by the DRONECAN task only */
+static DroneCanRxSession_TypeDef droneCanRxSessions[DRONECAN_RX_SESSIONS];
+static uint8_t nodeStatusTransferId = 0;
+
+/* Written by the DRONECAN task, read by other tasks in critical sections */
+static DroneCanNode_TypeDef droneCanNodes[DRONECAN_MAX_NODES];
+static DroneCanMag_TypeDef droneCanMag;
+static DroneCanBattery_TypeDef droneCanBattery;
+static DroneCanEsc_TypeDef droneCanEscs[MOTOR_OUTPUT_CHANNELS];
+static FcbGpsSolutionType droneCanGps;
+static uint8_t droneCanGpsNodeId = 0;
+static uint32_t droneCanGpsTick = 0;
+static DroneCanStats_TypeDef droneCanStats;
+
+#ifdef DRONECAN_ESC_COMMANDS
+/* Used by the context that loads the motor outputs only */
+static uint8_t escCommandTransferId = 0;
+#endif
+
+static const char* const droneCanHealthNames[] = { "ok", "warning", "error", "critical" };
+
+static xTaskHandle DroneCanTaskHandle = NULL;
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Creates the DRONECAN task, which joins the bus and decodes the received messages
+ * @param  None
+ * @retval None
+ */
+void CreateDroneCanTask(void) {
+    memset(droneCanRxSessions, 0, sizeof(droneCanRxSessions));
+    memset(droneCanNodes, 0, sizeof(droneCanNodes));
+    memset(&droneCanMag, 0, sizeof(droneCanMag));
+    memset(&droneCanBattery, 0, sizeof(droneCanBattery));
+    memset(droneCanEscs, 0, sizeof(droneCanEscs));
+    memset(&droneCanGps, 0, sizeof(droneCanGps));
+    memset(&droneCanStats, 0, sizeof(droneCanStats));
+
+    /* DroneCAN task creation
+     * Task function pointer: DroneCanTask
+     * Task name: DRONECAN
+     * Stack depth: 2*configMINIMAL_STACK_SIZE
+     * Parameter: NULL
+     * Priority: DRONECAN_TASK_PRIO (0 to configMAX_PRIORITIES-1 possible)
+     * Handle: DroneCanTaskHandle
+     * */
+    if (pdPASS != xTaskCreate((pdTASK_CODE )DroneCanTask, (signed portCHAR*)"DRONECAN", 2*configMINIMAL_STACK_SIZE,
+            NULL, DRONECAN_TASK_PRIO, &DroneCanTaskHandle)) {
+        ErrorHandler();
+    }
+}
+
+#ifdef DRONECAN_ESC_COMMANDS
+/*
+ * @brief  Broadcasts the motor outputs as an ESC RawCommand in mailbox 0. The int14 commands are packed MSB first,
+ *         the low byte of each command before its high bits.
+ * @param  ctrlVal : Values [0,65535] of motors 1-4
+ * @retval true if loaded, false if dropped
+ */
+bool DroneCanSendEscCommands(const uint16_t ctrlVal[MOTOR_OUTPUT_CHANNELS]) {
+    CanFrame_TypeDef frame;
+    uint64_t bits = 0;
+    uint16_t command;
+    uint8_t i;
+
+    for (i = 0; i < MOTOR_OUTPUT_CHANNELS; i++) {
+        command = ctrlVal[i] >> 3; // [0,DRONECAN_ESC_COMMAND_MAX]
+        bits = (bits << 8) | (command & 0xFF);
+        bits = (bits << (DRONECAN_ESC_COMMAND_BITS - 8)) | (command >> 8);
+    }
+    bits <<= 8*DRONECAN_ESC_PAYLOAD_SIZE - DRONECAN_ESC_PAYLOAD_BITS;
+
+    frame.id = DRONECAN_MESSAGE_ID(DRONECAN_PRIORITY_HIGH, DRONECAN_ESC_RAW_COMMAND_ID);
+    for (i = 0; i < DRONECAN_ESC_PAYLOAD_SIZE; i++) {
+        frame.data[i] = (uint8_t) (bits >> (8*(DRONECAN_ESC_PAYLOAD_SIZE - 1 - i)));
+    }
+    frame.data[DRONECAN_ESC_PAYLOAD_SIZE] = DRONECAN_TAIL_START | DRONECAN_TAIL_END | escCommandTransferId;
+    frame.length = DRONECAN_ESC_PAYLOAD_SIZE + 1;
+
+    if (!CanBusTransmitFromControl(&frame)) {
+        return false;
+    }
+
+    escCommandTransferId = (escCommandTransferId + 1) & DRONECAN_TAIL_TRANSFER_ID_MASK;
+    droneCanStats.escCommands++;
+
+    return true;
+}
+#endif
+
+bool GetDroneCanBattery(DroneCanBattery_TypeDef* dstBattery) {
+    taskENTER_CRITICAL();
+    *dstBattery = droneCanBattery;
+    taskEXIT_CRITICAL();
+
+    return dstBattery->messages > 0 && HAL_GetTick() - dstBattery->lastRxTick <= DRONECAN_DATA_TIMEOUT;
+}
+
+bool GetDroneCanMag(DroneCanMag_TypeDef* dstMag) {
+    taskENTER_CRITICAL();
+    *dstMag = droneCanMag;
+    taskEXIT_CRITICAL();
+
+    return dstMag->messages > 0 && HAL_GetTick() - dstMag->lastRxTick <= DRONECAN_DATA_TIMEOUT;
+}
+
+void GetDroneCanEscs(DroneCanEsc_TypeDef dstEscs[MOTOR_OUTPUT_CHANNELS]) {
+    taskENTER_CRITICAL();
+    memcpy(dstEscs, droneCanEscs, sizeof(droneCanEscs));
+    taskEXIT_CRITICAL();
+}
+
+void GetDroneCanStats(DroneCanStats_TypeDef* dstStats) {
+    taskENTER_CRITICAL();
+    *dstStats = droneCanStats;
+    taskEXIT_CRITICAL();
+}
+
+size_t PrintDroneCanStatus(char* dst, const size_t dstSize) {
+    DroneCanStats_TypeDef stats;
+    DroneCanNode_TypeDef nodes[DRONECAN_MAX_NODES];
+    DroneCanMag_TypeDef mag;
+    DroneCanBattery_TypeDef battery;
+    DroneCanEsc_TypeDef escs[MOTOR_OUTPUT_CHANNELS];
+    FcbGpsSolutionType gps;
+    uint8_t gpsNodeId;
+    uint32_t gpsTick;
+    uint32_t const tick = HAL_GetTick();
+    float32_t values[4];
+    size_t length;
+    uint8_t i;
+
+    GetDroneCanStats(&stats);
+    taskENTER_CRITICAL();
+    memcpy(nodes, droneCanNodes, sizeof(nodes));
+    gps = droneCanGps;
+    gpsNodeId = droneCanGpsNodeId;
+    gpsTick = droneCanGpsTick;
+    taskEXIT_CRITICAL();
+    (void) GetDroneCanMag(&mag);
+    (void) GetDroneCanBattery(&battery);
+    GetDroneCanEscs(escs);
+
+    length = (size_t) snprintf(dst, dstSize, "\nDroneCAN node %u\ntransfers:%lu, crcErrors:%lu, sequenceErrors:%lu, "
+            "sessionsFull:%lu, malformed:%lu, escCommands:%lu\nnodes:", DRONECAN_NODE_ID, stats.transfers,
+            stats.crcErrors, stats.sequenceErrors, stats.sessionsFull, stats.malformed, stats.escCommands);
+    for (i = 0; i < DRONECAN_MAX_NODES && 0 != nodes[i].nodeId && length < dstSize; i++) {
+        length += (size_t) snprintf(dst + length, dstSize - length, " %u %s%s up %lu s,", nodes[i].nodeId,
+                droneCanHealthNames[nodes[i].health & 0x03],
+                (DRONECAN_MODE_OFFLINE == nodes[i].mode || tick - nodes[i].lastRxTick > DRONECAN_NODE_TIMEOUT)
+                ? " OFFLINE" : "", nodes[i].uptime);
+    }
+
+    if (length < dstSize) {
+        length += (size_t) snprintf(dst + length, dstSize - length, "\nGPS node %u%s: fix:%u, satellites:%u, "
+                "lat:%ld, lon:%ld [1e-7 deg], fixes:%lu", gpsNodeId,
+                (0 == gpsNodeId || tick - gpsTick > DRONECAN_DATA_TIMEOUT) ? " (stale)" : "",
+                (unsigned int) gps.fixType, (unsigned int) gps.numSv, (long) gps.latitude, (long) gps.longitude,
+                stats.gpsFixes);
+    }
+    if (length < dstSize) {
+        values[0] = gps.horizontalAccuracy;
+        values[1] = gps.speedAccuracy;
+        length += FormatFixedList(dst + length, dstSize - length, ", hAcc:%.2f [m], sAcc:%.2f [m/s]", values, 2);
+    }
+
+    if (length < dstSize) {
+        length += (size_t) snprintf(dst + length, dstSize - length, "\nMag node %u%s: ", mag.nodeId,
+                (0 == mag.nodeId || tick - mag.lastRxTick > DRONECAN_DATA_TIMEOUT) ? " (stale)" : "");
+    }
+    if (length < dstSize) {
+        length += FormatFixedList(dst + length, dstSize - length, "%.3f %.3f %.3f [gauss]", mag.field, 3);
+    }
+
+    if (length < dstSize) {
+        length += (size_t) snprintf(dst + length, dstSize - length, "\nBattery node %u id %u%s: charge:%u [%%], ",
+                battery.nodeId, battery.batteryId,
+                (0 == battery.nodeId || tick - battery.lastRxTick > DRONECAN_DATA_TIMEOUT) ? " (stale)" : "",
+                battery.stateOfCharge);
+    }
+    if (length < dstSize) {
+        values[0] = battery.voltage;
+        values[1] = battery.current;
+        values[2] = battery.temperature;
+        length += FormatFixedList(dst + length, dstSize - length, "%.2f [V], %.2f [A], %.1f [degC]", values, 3);
+    }
+
+    if (length < dstSize) {
+        length += (size_t) snprintf(dst + length, dstSize - length,
+                "\nESC\tnode\tvoltage\tcurrent\ttemp\trpm\tpower\terrors\tmessages\n");
+    }
+    for (i = 0; i < MOTOR_OUTPUT_CHANNELS && length < dstSize; i++) {
+        length += (size_t) snprintf(dst + length, dstSize - length, "%u\t%u%s\t", i,
+                escs[i].nodeId, (0 == escs[i].nodeId || tick - escs[i].lastRxTick > DRONECAN_DATA_TIMEOUT) ? "-" : "");
+        values[0] = escs[i].voltage;
+        values[1] = escs[i].current;
+        values[2] = escs[i].temperature;
+        if (length < dstSize) {
+            length += FormatFixedList(dst + length, dstSize - length, "%.2f\t%.2f\t%.1f\t", values, 3);
+        }
+        if (length < dstSize) {
+            length += (size_t) snprintf(dst + length, dstSize - length, "%ld\t%u\t%lu\t%lu\n", (long) escs[i].rpm,
+                    (unsigned int) escs[i].powerRating, escs[i].errorCount, escs[i].messages);
+        }
+    }
+
+    return length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Task code joins the bus, broadcasts the NodeStatus and decodes the received frames in between
+ * @param  argument : Unused parameter
+ * @retval None
+ */
+static void DroneCanTask(void const *argument) {
+    CanFrame_TypeDef frame;
+    uint32_t nextNodeStatusTick;
+    uint32_t tick;
+    uint32_t wait;
+
+    (void) argument;
+
+    /* No transceiver or no other node keeps the peripheral from leaving its initialisation mode */
+    while (FCB_OK != CanBusInit()) {
+        LOG0("WARNING: CAN bus not joined, retrying");
+        vTaskDelay(DRONECAN_INIT_RETRY_PERIOD / portTICK_RATE_MS);
+    }
+
+    if (FCB_OK != AddDroneCanFilters()) {
+        ErrorHandler();
+    }
+
+    nextNodeStatusTick = HAL_GetTick();
+
+    for (;;) {
+        tick = HAL_GetTick();
+        if ((int32_t) (tick - nextNodeStatusTick) >= 0) {
+            SendDroneCanNodeStatus();
+            nextNodeStatusTick = tick + DRONECAN_NODE_STATUS_PERIOD;
+        }
+
+        wait = nextNodeStatusTick - tick;
+        if (CanBusReceive(&frame, wait / portTICK_RATE_MS)) {
+            HandleDroneCanFrame(&frame);
+        }
+    }
+}
+
+/*
+ * @brief  Adds a filter per subscribed message type, of any priority and source node
+ * @param  None
+ * @retval FCB_OK, FCB_ERR if the filter banks ran out
+ */
+static FcbRetValType AddDroneCanFilters(void) {
+    uint32_t const mask = ((uint32_t) DRONECAN_ID_TYPE_MASK << DRONECAN_ID_TYPE_SHIFT) | DRONECAN_ID_SERVICE_FLAG;
+    uint8_t i;
+
+    for (i = 0; i < DRONECAN_SUBSCRIPTIONS; i++) {
+        if (FCB_OK != CanBusAddFilter((uint32_t) droneCanSubscriptions[i].typeId << DRONECAN_ID_TYPE_SHIFT, mask)) {
+            return FCB_ERR;
+        }
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Broadcasts the NodeStatus of the FCB: uptime, healthy and operational
+ * @param  None
+ * @retval None
+ */
+static void SendDroneCanNodeStatus(void) {
+    CanFrame_TypeDef frame;
+    uint32_t const uptime = HAL_GetTick() / 1000;
+
+    frame.id = DRONECAN_MESSAGE_ID(DRONECAN_PRIORITY_LOW, DRONECAN_NODE_STATUS_ID);
+    frame.data[0] = (uint8_t) uptime;
+    frame.data[1] = (uint8_t) (uptime >> 8);
+    frame.data[2] = (uint8_t) (uptime >> 16);
+    frame.data[3] = (uint8_t) (uptime >> 24);
+    frame.data[4] = (DRONECAN_HEALTH_OK << 6) | (DRONECAN_MODE_OPERATIONAL << 3); // Sub-mode 0
+    frame.data[5] = 0; // Vendor specific status code
+    frame.data[6] = 0;
+    frame.data[DRONECAN_NODE_STATUS_SIZE] = DRONECAN_TAIL_START | DRONECAN_TAIL_END | nodeStatusTransferId;
+    frame.length = DRONECAN_NODE_STATUS_SIZE + 1;
+
+    /* A full TX queue is counted by the driver, the next status follows in a period anyway */
+    (void) CanBusTransmit(&frame);
+    nodeStatusTransferId = (nodeStatusTransferId + 1) & DRONECAN_TAIL_TRANSFER_ID_MASK;
+}
+
+/*
+ * @brief  Hands a single frame transfer to its decoder, or adds the frame to the reassembly of its multi-frame
+ *         transfer, which is decoded once its last frame has arrived and its CRC matches
+ * @param  frame : Received frame
+ * @retval None
+ */
+static void HandleDroneCanFrame(const CanFrame_TypeDef* frame) {
+    const DroneCanSubscription_TypeDef* subscription = NULL;
+    DroneCanRxSession_TypeDef* session;
+    uint16_t const typeId = (uint16_t) ((frame->id >> DRONECAN_ID_TYPE_SHIFT) & DRONECAN_ID_TYPE_MASK);
+    uint8_t const sourceNodeId = (uint8_t) (frame->id & DRONECAN_ID_SOURCE_MASK);
+    uint32_t const tick = HAL_GetTick();
+    uint8_t tail, transferId, dataLength;
+    bool isStart, isEnd, isToggle;
+    uint8_t i;
+
+    /* Anonymous messages from nodes without an ID are not used */
+    if (0 == frame->length || 0 == sourceNodeId || (frame->id & DRONECAN_ID_SERVICE_FLAG)) {
+        return;
+    }
+
+    for (i = 0; i < DRONECAN_SUBSCRIPTIONS; i++) {
+        if (droneCanSubscriptions[i].typeId == typeId) {
+            subscription = &droneCanSubscriptions[i];
+            break;
+        }
+    }
+    if (NULL == subscription) {
+        return;
+    }
+
+    dataLength = frame->length - 1;
+    tail = frame->data[dataLength];
+    isStart = (tail & DRONECAN_TAIL_START) != 0;
+    isEnd = (tail & DRONECAN_TAIL_END) != 0;
+    isToggle = (tail & DRONECAN_TAIL_TOGGLE) != 0;
+    transferId = tail & DRONECAN_TAIL_TRANSFER_ID_MASK;
+
+    if (isStart && isEnd) {
+        if (isToggle) {
+            droneCanStats.sequenceErrors++;
+            return;
+        }
+        droneCanStats.transfers++;
+        subscription->handler(sourceNodeId, frame->data, dataLength);
+        return;
+    }
+
+    session = GetDroneCanRxSession(subscription, sourceNodeId, isStart, tick);
+    if (NULL == session) {
+        return;
+    }
+
+    if (isStart) {
+        if (dataLength < DRONECAN_CRC_SIZE || isToggle) {
+            droneCanStats.sequenceErrors++;
+            session->isActive = false;
+            return;
+        }
+        session->isActive = true;
+        session->transferId = transferId;
+        session->isToggleSet = true;
+        session->transferCrc = (uint16_t) frame->data[0] | ((uint16_t) frame->data[1] << 8);
+        session->crc = GetDroneCanSignatureCrc(subscription->signature);
+        session->length = 0;
+        AppendDroneCanPayload(session, &frame->data[DRONECAN_CRC_SIZE], dataLength - DRONECAN_CRC_SIZE);
+    } else {
+        if (!session->isActive || transferId != session->transferId || isToggle != session->isToggleSet
+                || tick - session->lastFrameTick > DRONECAN_RX_SESSION_TIMEOUT) {
+            droneCanStats.sequenceErrors++;
+            session->isActive = false;
+            return;
+        }
+        session->isToggleSet = !session->isToggleSet;
+        AppendDroneCanPayload(session, frame->data, dataLength);
+    }
+    session->lastFrameTick = tick;
+
+    if (isEnd) {
+        session->isActive = false;
+        if (session->crc != session->transferCrc) {
+            droneCanStats.crcErrors++;
+            return;
+        }
+        droneCanStats.transfers++;
+        subscription->handler(sourceNodeId, session->payload,
+                (session->length < DRONECAN_MAX_TRANSFER_SIZE) ? session->length : DRONECAN_MAX_TRANSFER_SIZE);
+    }
+}
+
+/*
+ * @brief  Finds the reassembly session of a message type from a node. The first frame of a transfer takes a session
+ *         that is not reassembling a transfer, or whose transfer has timed out.
+ * @param  subscription : Message type
+ * @param  sourceNodeId : Node that sends the transfer
+ * @param  isStart : The frame starts a transfer
+ * @param  tick : [ms] Reception of the frame
+ * @retval The session, NULL if none
+ */
+static DroneCanRxSession_TypeDef* GetDroneCanRxSession(const DroneCanSubscription_TypeDef* subscription,
+        const uint8_t sourceNodeId, const bool isStart, const uint32_t tick) {
+    DroneCanRxSession_TypeDef* freeSession = NULL;
+    DroneCanRxSession_TypeDef* session;
+    uint8_t i;
+
+    for (i = 0; i < DRONECAN_RX_SESSIONS; i++) {
+        session = &droneCanRxSessions[i];
+        if (session->subscription == subscription && session->sourceNodeId == sourceNodeId) {
+            return session;
+        }
+        if (NULL == freeSession
+                && (!session->isActive || tick - session->lastFrameTick > DRONECAN_RX_SESSION_TIMEOUT)) {
+            freeSession = session;
+        }
+    }
+
+    if (!isStart) {
+        /* The start of the transfer was missed */
+        droneCanStats.sequenceErrors++;
+        return NULL;
+    }
+    if (NULL == freeSession) {
+        droneCanStats.sessionsFull++;
+        return NULL;
+    }
+
+    freeSession->subscription = subscription;
+    freeSession->sourceNodeId = sourceNodeId;
+    freeSession->isActive = false;
+
+    return freeSession;
+}
+
+/*
+ * @brief  Adds payload bytes to the CRC of a transfer and stores the first DRONECAN_MAX_TRANSFER_SIZE of them
+ * @param  session : Reassembly session
+ * @param  data : Payload bytes of a frame
+ * @param  size : Number of bytes
+ * @retval None
+ */
+static void AppendDroneCanPayload(DroneCanRxSession_TypeDef* session, const uint8_t* data, const uint8_t size) {
+    uint8_t i;
+
+    session->crc = AddDroneCanCrc(session->crc, data, size);
+    for (i = 0; i < size; i++, session->length++) {
+        if (session->length < DRONECAN_MAX_TRANSFER_SIZE) {
+            session->payload[session->length] = data[i];
+        }
+    }
+}
+
+/*
+ * @brief  CRC-16-CCITT of bytes, the transfer CRC of DroneCAN
+ * @param  crc : CRC of the previous bytes
+ * @param  data : Bytes to add
+ * @param  size : Number of bytes
+ * @retval Updated CRC
+ */
+static uint16_t AddDroneCanCrc(uint16_t crc, const uint8_t* data, const uint16_t size) {
+    uint16_t i;
+    uint8_t bit;
+
+    for (i = 0; i < size; i++) {
+        crc ^= (uint16_t) data[i] << 8;
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t) ((crc << 1) ^ DRONECAN_CRC_POLY) : (uint16_t) (crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+/*
+ * @brief  CRC of the data type signature, little endian, that the transfer CRC of a multi-frame transfer starts from
+ * @param  signature : Data type signature
+ * @retval CRC
+ */
+static uint16_t GetDroneCanSignatureCrc(const uint64_t signature) {
+    uint8_t bytes[sizeof(signature)];
+    uint8_t i;
+
+    for (i = 0; i < sizeof(signature); i++) {
+        bytes[i] = (uint8_t) (signature >> (8*i));
+    }
+
+    return AddDroneCanCrc(DRONECAN_CRC_INIT, bytes, sizeof(bytes));
+}
+
+/*
+ * @brief  Reads an unsigned field of up to 64 bits. The fields are packed MSB first in the bytes, with their bytes in
+ *         little endian order and the high bits of a field that is not a multiple of 8 bits in its last byte.
+ * @param  payload : Payload of a transfer
+ * @param  bitOffset : Of the field
+ * @param  bitLength : Of the field
+ * @retval Value
+ */
+static uint64_t GetDroneCanBits(const uint8_t* payload, const uint16_t bitOffset, const uint8_t bitLength) {
+    uint8_t bytes[8] = { 0 };
+    uint64_t value = 0;
+    uint16_t srcBit;
+    uint8_t i;
+
+    for (i = 0; i < bitLength; i++) {
+        srcBit = bitOffset + i;
+        if (payload[srcBit / 8] & (0x80 >> (srcBit % 8))) {
+            bytes[i / 8] |= (uint8_t) (0x80 >> (i % 8));
+        }
+    }
+    if (bitLength % 8) {
+        bytes[bitLength / 8] >>= 8 - bitLength % 8;
+    }
+
+    for (i = (bitLength + 7) / 8; i > 0; i--) {
+        value = (value << 8) | bytes[i - 1];
+    }
+
+    return value;
+}
+
+static int64_t GetDroneCanSignedBits(const uint8_t* payload, const uint16_t bitOffset, const uint8_t bitLength) {
+    uint64_t value = GetDroneCanBits(payload, bitOffset, bitLength);
+
+    if (bitLength < 64 && (value & (1ULL << (bitLength - 1)))) {
+        value |= ~0ULL << bitLength;
+    }
+
+    return (int64_t) value;
+}
+
+/*
+ * @brief  Reads a float16 field, an unknown value (NaN) or an infinity reads as 0
+ * @param  payload : Payload of a transfer
+ * @param  bitOffset : Of the field
+ * @retval Value
+ */
+static float32_t GetDroneCanFloat16(const uint8_t* payload, const uint16_t bitOffset) {
+    uint16_t const half = (uint16_t) GetDroneCanBits(payload, bitOffset, 16);
+    int16_t const exponent = (half >> 10) & 0x1F;
+    uint16_t const mantissa = half & 0x3FF;
+    float32_t magnitude;
+
+    if (0x1F == exponent) {
+        return 0.0f;
+    } else if (0 == exponent) {
+        magnitude = ldexpf((float32_t) mantissa, -24); // Subnormal
+    } else {
+        magnitude = ldexpf((float32_t) (mantissa | 0x400), exponent - 25);
+    }
+
+    return (half & 0x8000) ? -magnitude : magnitude;
+}
+
+static float32_t GetDroneCanFloat32(const uint8_t* payload, const uint16_t bitOffset) {
+    uint32_t const bits = (uint32_t) GetDroneCanBits(payload, bitOffset, 32);
+    float32_t value;
+
+    memcpy(&value, &bits, sizeof(value));
+
+    return isfinite(value) ? value : 0.0f;
+}
+
+/*
+ * @brief  Decodes a NodeStatus into the node list, a node that does not fit the list is not listed
+ */
+static void HandleNodeStatus(const uint8_t sourceNodeId, const uint8_t* payload, const uint16_t length) {
+    DroneCanNode_TypeDef* node = NULL;
+    uint8_t i;
+
+    if (length < DRONECAN_NODE_STATUS_SIZE) {
+        droneCanStats.malformed++;
+        return;
+    }
+
+    for (i = 0; i < DRONECAN_MAX_NODES && NULL == node; i++) {
+        if (droneCanNodes[i].nodeId == sourceNodeId || 0 == droneCanNodes[i].nodeId) {
+            node = &droneCanNodes[i];
+        }
+    }
+    if (NULL == node) {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    node->nodeId = sourceNodeId;
+    node->uptime = (uint32_t) GetDroneCanBits(payload, 0, 32);
+    node->health = (uint8_t) GetDroneCanBits(payload, 32, 2);
+    node->mode = (uint8_t) GetDroneCanBits(payload, 34, 3);
+    node->lastRxTick = HAL_GetTick();
+    taskEXIT_CRITICAL();
+}
+
+static void HandleMagneticField(const uint8_t sourceNodeId, const uint8_t* payload, const uint16_t length) {
+    if (length < DRONECAN_MAG_FIELD_MIN_SIZE) {
+        droneCanStats.malformed++;
+        return;
+    }
+
+    SetDroneCanMag(sourceNodeId, payload, 0);
+}
+
+static void HandleMagneticField2(const uint8_t sourceNodeId, const uint8_t* payload, const uint16_t length) {
+    if (length < DRONECAN_MAG_FIELD2_MIN_SIZE) {
+        droneCanStats.malformed++;
+        return;
+    }
+
+    /* After the sensor ID of the node */
+    SetDroneCanMag(sourceNodeId, payload, 8);
+}
+
+/*
+ * @brief  Decodes an ESC status into the state of its ESC index, an index beyond the motors is not used
+ */
+static void HandleEscStatus(const uint8_t sourceNodeId, const uint8_t* payload, const uint16_t length) {
+    DroneCanEsc_TypeDef* esc;
+    uint8_t index;
+
+    if (length < DRONECAN_ESC_STATUS_MIN_SIZE) {
+        droneCanStats.malformed++;
+        return;
+    }
+
+    index = (uint8_t) GetDroneCanBits(payload, 105, 5);
+    if (index >= MOTOR_OUTPUT_CHANNELS) {
+        return;
+    }
+    esc = &droneCanEscs[index];
+
+    taskENTER_CRITICAL();
+    esc->nodeId = sourceNodeId;
+    esc->errorCount = (uint32_t) GetDroneCanBits(payload, 0, 32);
+    esc->voltage = GetDroneCanFloat16(payload, 32);
+    esc->current = GetDroneCanFloat16(payload, 48);
+    esc->temperature = GetDroneCanFloat16(payload, 64) - DRONECAN_KELVIN_OFFSET;
+    esc->rpm = (int32_t) GetDroneCanSignedBits(payload, 80, 18);
+    esc->powerRating = (uint8_t) GetDroneCanBits(payload, 98, 7);
+    esc->messages++;
+    esc->lastRxTick = HAL_GetTick();
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Decodes a GNSS Fix2 into a GPS solution. The accuracies are the standard deviations of the position and
+ *         velocity variances of the covariance, of a scalar, the diagonal or the full matrix.
+ */
+static void HandleGnssFix2(const uint8_t sourceNodeId, const uint8_t* payload, const uint16_t length) {
+    FcbGpsSolutionType solution;
+    float32_t variances[6];
+    uint8_t covarianceLength, status, i;
+
+    if (length < DRONECAN_FIX2_MIN_SIZE) {
+        droneCanStats.malformed++;
+        return;
+    }
+    covarianceLength = (uint8_t) GetDroneCanBits(payload, DRONECAN_FIX2_COVARIANCE_LENGTH, 6);
+    if (covarianceLength > DRONECAN_FIX2_MAX_COVARIANCE
+            || 8*length < DRONECAN_FIX2_COVARIANCE + 16*covarianceLength) {
+        droneCanStats.malformed++;
+        return;
+    }
+
+    memset(&solution, 0, sizeof(solution));
+    solution.timestamp = GetTimestamp();
+    if (DRONECAN_TIME_STANDARD_GPS == GetDroneCanBits(payload, DRONECAN_FIX2_TIME_STANDARD, 3)) {
+        solution.iTow = (uint32_t) ((GetDroneCanBits(payload, DRONECAN_FIX2_GNSS_TIMESTAMP, 56) / 1000)
+                % DRONECAN_GPS_WEEK_MS);
+    }
+    status = (uint8_t) GetDroneCanBits(payload, DRONECAN_FIX2_STATUS, 2);
+    solution.fixType = (DRONECAN_FIX2_STATUS_3D_FIX == status || DRONECAN_FIX2_STATUS_2D_FIX == status) ? status : 0;
+    solution.fixOk = DRONECAN_FIX2_STATUS_3D_FIX == status;
+    solution.numSv = (uint8_t) GetDroneCanBits(payload, DRONECAN_FIX2_SATS_USED, 6);
+    solution.longitude = (int32_t) (GetDroneCanSignedBits(payload, DRONECAN_FIX2_LONGITUDE, 37) / 10);
+    solution.latitude = (int32_t) (GetDroneCanSignedBits(payload, DRONECAN_FIX2_LATITUDE, 37) / 10);
+    solution.heightMsl = 0.001f * (float32_t) GetDroneCanSignedBits(payload, DRONECAN_FIX2_HEIGHT_MSL, 27);
+    for (i = 0; i < 3; i++) {
+        solution.velocityNed[i] = GetDroneCanFloat32(payload, DRONECAN_FIX2_VELOCITY + 32*i);
+    }
+
+    for (i = 0; i < 6; i++) {
+        if (1 == covarianceLength) {
+            variances[i] = GetDroneCanFloat16(payload, DRONECAN_FIX2_COVARIANCE);
+        } else if (6 == covarianceLength) {
+            variances[i] = GetDroneCanFloat16(payload, DRONECAN_FIX2_COVARIANCE + 16*i);
+        } else if (DRONECAN_FIX2_MAX_COVARIANCE == covarianceLength) {
+            variances[i] = GetDroneCanFloat16(payload, DRONECAN_FIX2_COVARIANCE + 16*7*i);
+        } else {
+            variances[i] = DRONECAN_UNKNOWN_ACCURACY*DRONECAN_UNKNOWN_ACCURACY;
+        }
+        variances[i] = fmaxf(variances[i], 0.0f);
+    }
+    solution.horizontalAccuracy = sqrtf(variances[0] + variances[1]);
+    solution.verticalAccuracy = sqrtf(variances[2]);
+    solution.speedAccuracy = sqrtf(variances[3] + variances[4] + variances[5]);
+
+    taskENTER_CRITICAL();
+    droneCanGps = solution;
+    droneCanGpsNodeId = sourceNodeId;
+    droneCanGpsTick = HAL_GetTick();
+    droneCanStats.gpsFixes++;
+    taskEXIT_CRITICAL();
+
+#ifdef GPS_INPUT_IS_DRONECAN
+    SetGpsSolution(&solution);
+#endif
+}
+
+static void HandleBatteryInfo(const uint8_t sourceNodeId, const uint8_t* payload, const uint16_t length) {
+    if (length < DRONECAN_BATTERY_INFO_MIN_SIZE) {
+        droneCanStats.malformed++;
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    droneCanBattery.nodeId = sourceNodeId;
+    droneCanBattery.temperature = GetDroneCanFloat16(payload, 0) - DRONECAN_KELVIN_OFFSET;
+    droneCanBattery.voltage = GetDroneCanFloat16(payload, 16);
+    droneCanBattery.current = GetDroneCanFloat16(payload, 32);
+    droneCanBattery.stateOfCharge = (uint8_t) GetDroneCanBits(payload, 130, 7);
+    droneCanBattery.batteryId = (uint8_t) GetDroneCanBits(payload, 144, 8);
+    droneCanBattery.messages++;
+    droneCanBattery.lastRxTick = HAL_GetTick();
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Sets the magnetic field from the three float16 components of a message
+ * @param  sourceNodeId : Node of the message
+ * @param  payload : Payload of the message
+ * @param  fieldOffset : Bit offset of the first component
+ * @retval None
+ */
+static void SetDroneCanMag(const uint8_t sourceNodeId, const uint8_t* payload, const uint16_t fieldOffset) {
+    float32_t field[3];
+    uint8_t i;
+
+    for (i = 0; i < 3; i++) {
+        field[i] = GetDroneCanFloat16(payload, fieldOffset + 16*i);
+    }
+
+    taskENTER_CRITICAL();
+    droneCanMag.nodeId = sourceNodeId;
+    memcpy(droneCanMag.field, field, sizeof(droneCanMag.field));
+    droneCanMag.messages++;
+    droneCanMag.lastRxTick = HAL_GetTick();
+    taskEXIT_CRITICAL();
+}
+
+#endif /* FCB_CAN_BUS */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,163 @@
+/******************************************************************************
+ * @file    dronecan.h
+ * @brief   Header file for the DroneCAN (UAVCAN v0) node of the FCB on the
+ *          bus of can_bus.h, with FCB_CAN_BUS. A subset of the protocol: the
+ *          FCB is node DRONECAN_NODE_ID, broadcasts its NodeStatus and
+ *          receives the broadcasts of external nodes, the GNSS fix, the
+ *          magnetic field, the battery info of a power module and the ESC
+ *          status. The hardware filters let only these messages through and
+ *          the DRONECAN task reassembles and decodes them, so the control
+ *          path is only ever delayed by the copy of a frame in the RX
+ *          interrupt. The decoded data replaces that of the GPS receiver with
+ *          GPS_INPUT_IS_DRONECAN and that of the battery ADC with
+ *          BATTERY_INPUT_IS_DRONECAN. With DRONECAN_ESC_COMMANDS the motor
+ *          outputs are also broadcast as an ESC RawCommand, by the context
+ *          that loads them into the timer.
+ *
+ *          The node IDs are static, there is no dynamic node ID allocation,
+ *          and services (GetNodeInfo, parameters, firmware update) are not
+ *          answered. The external magnetometer is received and printed, it
+ *          is not fused by the attitude estimation.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __DRONECAN_H
+#define __DRONECAN_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "arm_math.h"
+
+#include "can_bus.h"
+#include "motor_control.h"
+#include "fcb_gps.h"
+#include "fcb_battery.h"
+#include "fcb_retval.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Uncomment to command DroneCAN ESC:s with the motor outputs as well, ESC index n follows motor n+1 */
+//#define DRONECAN_ESC_COMMANDS
+
+#if (defined(GPS_INPUT_IS_DRONECAN) || defined(BATTERY_INPUT_IS_DRONECAN) || defined(DRONECAN_ESC_COMMANDS)) \
+        && !defined(FCB_CAN_BUS)
+#error "The DroneCAN inputs and the DroneCAN ESC commands need FCB_CAN_BUS"
+#endif
+
+#if defined(GPS_INPUT_IS_DRONECAN) && !defined(FCB_GPS)
+#error "GPS_INPUT_IS_DRONECAN replaces the GPS receiver of FCB_GPS, which is needed for the position estimation"
+#endif
+
+#if defined(BATTERY_INPUT_IS_DRONECAN) && !defined(FCB_BATTERY_MONITOR)
+#error "BATTERY_INPUT_IS_DRONECAN replaces the ADC of FCB_BATTERY_MONITOR, which evaluates the battery"
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+
+#define DRONECAN_NODE_ID                10      // Static node ID of the FCB, 1-125
+#define DRONECAN_NODE_STATUS_PERIOD     1000    // [ms] Between the NodeStatus broadcasts, at most 1000
+#define DRONECAN_NODE_TIMEOUT           3000    // [ms] Without a NodeStatus before a node is offline
+#define DRONECAN_DATA_TIMEOUT           500     // [ms] Without a message before its data is stale
+#define DRONECAN_INIT_RETRY_PERIOD      1000    // [ms] Between the attempts to join the bus
+
+#define DRONECAN_MAX_NODES              16      // External nodes listed by their NodeStatus
+#define DRONECAN_RX_SESSIONS            8       // Multi-frame transfers reassembled at a time
+#define DRONECAN_RX_SESSION_TIMEOUT     100     // [ms] Between the frames of a transfer
+#define DRONECAN_MAX_TRANSFER_SIZE      128     // [bytes] Stored of a transfer, the CRC covers all of it
+
+#define DRONECAN_ESC_COMMAND_MAX        8191    // RawCommand of a full motor output
+
+/* Exported types ------------------------------------------------------------*/
+
+typedef struct {
+    uint8_t nodeId;
+    uint8_t health;                 // 0 ok, 1 warning, 2 error, 3 critical
+    uint8_t mode;                   // 0 operational, 1 initialization, 2 maintenance, 3 software update, 7 offline
+    uint32_t uptime;                // [s]
+    uint32_t lastRxTick;            // [ms]
+} DroneCanNode_TypeDef;
+
+typedef struct {
+    uint8_t nodeId;                 // Of the latest message, 0 if none was received
+    float32_t field[3];             // [gauss] in the frame of the node
+    uint32_t messages;
+    uint32_t lastRxTick;            // [ms]
+} DroneCanMag_TypeDef;
+
+typedef struct {
+    uint8_t nodeId;                 // Of the latest message, 0 if none was received
+    uint8_t batteryId;
+    float32_t voltage;              // [V]
+    float32_t current;              // [A]
+    float32_t temperature;          // [degC]
+    uint8_t stateOfCharge;          // [%], 127 unknown
+    uint32_t messages;
+    uint32_t lastRxTick;            // [ms]
+} DroneCanBattery_TypeDef;
+
+typedef struct {
+    uint8_t nodeId;                 // Of the latest message, 0 if none was received
+    float32_t voltage;              // [V]
+    float32_t current;              // [A]
+    float32_t temperature;          // [degC]
+    int32_t rpm;
+    uint8_t powerRating;            // [%]
+    uint32_t errorCount;            // Reported by the ESC
+    uint32_t messages;
+    uint32_t lastRxTick;            // [ms]
+} DroneCanEsc_TypeDef;
+
+typedef struct {
+    uint32_t transfers;             // Received, single frame or reassembled with a valid CRC
+    uint32_t crcErrors;
+    uint32_t sequenceErrors;        // Frames out of the toggle or transfer ID order of their transfer, or too late
+    uint32_t sessionsFull;          // Multi-frame transfers without a free reassembly session
+    uint32_t malformed;             // Transfers too short for their message type
+    uint32_t gpsFixes;
+    uint32_t escCommands;           // RawCommand frames loaded, see DRONECAN_ESC_COMMANDS
+} DroneCanStats_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+void CreateDroneCanTask(void);
+
+/**
+ * Broadcasts the motor outputs as an ESC RawCommand, with
+ * DRONECAN_ESC_COMMANDS. Uses no FreeRTOS API and does not wait, a command
+ * that finds the previous one still pending is dropped. Called by the
+ * context that loads the motor outputs, which may be the control executive.
+ *
+ * @param ctrlVal values [0,65535] of motors 1-4
+ * @return true if loaded, false if dropped
+ */
+bool DroneCanSendEscCommands(const uint16_t ctrlVal[MOTOR_OUTPUT_CHANNELS]);
+
+/**
+ * @param dstBattery latest battery info of a power module
+ * @return true if received within DRONECAN_DATA_TIMEOUT
+ */
+bool GetDroneCanBattery(DroneCanBattery_TypeDef* dstBattery);
+
+/**
+ * @param dstMag latest magnetic field
+ * @return true if received within DRONECAN_DATA_TIMEOUT
+ */
+bool GetDroneCanMag(DroneCanMag_TypeDef* dstMag);
+
+void GetDroneCanEscs(DroneCanEsc_TypeDef dstEscs[MOTOR_OUTPUT_CHANNELS]);
+void GetDroneCanStats(DroneCanStats_TypeDef* dstStats);
+size_t PrintDroneCanStatus(char* dst, const size_t dstSize);
+
+#endif /* __DRONECAN_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,483 @@
+/*****************************************************************************
+ * @brief   Read-only FAT volume of the USB mass storage interface, see
+ *          msc_volume.h. The volume is a FAT12 one of MSC_VOLUME_NBR_OF_SECTORS
+ *          sectors: the boot sector, two FATs, a root directory sector and the
+ *          data clusters of a sector each. The files are laid out one after
+ *          the other from the first cluster at mount, so a FAT entry is the
+ *          next cluster within a file and the end of chain at its last one,
+ *          and every sector is made up from the file table when it is read.
+ *          The text files have fixed length lines, so that a line is found
+ *          from the file offset without reading the lines before it.
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "msc_volume.h"
+#include "usbd_msc_if.h"
+
+#ifdef FCB_USB_MASS_STORAGE
+
+#include "blackbox.h"
+#include "event_journal.h"
+#include "crash_dump.h"
+#include "param_table.h"
+#include "fixed_format.h"
+#include "flash.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* A file of the volume, laid out at mount */
+typedef struct {
+    char name[11];                  // 8.3 name as in the directory entry, space padded
+    uint32_t size;                  // [bytes]
+    uint16_t firstCluster;          // 0 for an empty file
+    uint16_t clusters;
+    void (*read)(const uint32_t offset, uint8_t* dst, const uint16_t size); // Reads the file data
+} MscVolumeFile_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define MSC_RESERVED_SECTORS            1
+#define MSC_NBR_OF_FATS                 2
+#define MSC_FAT_SECTORS                 2       // 12 bits of each of MSC_VOLUME_NBR_OF_SECTORS clusters at most
+#define MSC_ROOT_ENTRIES                (MSC_VOLUME_SECTOR_SIZE / MSC_DIR_ENTRY_SIZE)
+#define MSC_FIRST_FAT_SECTOR            MSC_RESERVED_SECTORS
+#define MSC_ROOT_SECTOR                 (MSC_FIRST_FAT_SECTOR + MSC_NBR_OF_FATS*MSC_FAT_SECTORS)
+#define MSC_FIRST_DATA_SECTOR           (MSC_ROOT_SECTOR + 1)
+#define MSC_FIRST_CLUSTER               2
+#define MSC_NBR_OF_CLUSTERS             (MSC_VOLUME_NBR_OF_SECTORS - MSC_FIRST_DATA_SECTOR)
+
+#define MSC_DIR_ENTRY_SIZE              32
+#define MSC_ATTR_READ_ONLY              0x01
+#define MSC_ATTR_VOLUME_ID              0x08
+#define MSC_FILE_DATE                   ((2016 - 1980) << 9 | 1 << 5 | 1) // 2016-01-01, the files have no dates
+#define MSC_MEDIA_DESCRIPTOR            0xF8
+#define MSC_VOLUME_SERIAL               0x46434244  // "DBCF"
+
+#define MSC_FAT12_END_OF_CHAIN          0xFFF
+
+#define MSC_JOURNAL_LINE_SIZE           64      // As PrintEventJournalRecord() prints, with the newline
+#define MSC_PARAMS_LINE_SIZE            32      // Name, space, value and newline
+#define MSC_PARAMS_DECIMALS             6
+
+#define MSC_CRASH_TEXT_SIZE             (512 + CRASH_DUMP_LOG_ENTRIES*LOG_LINE_MAX_SIZE)
+
+/* The profiles page is right below the settings store, the file is both */
+#define MSC_SETTINGS_FILE_SIZE          (FLASH_SETTINGS_START_ADDR + FLASH_SETTINGS_SIZE - FLASH_PROFILES_START_ADDR)
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static MscVolumeFile_TypeDef volumeFiles[MSC_VOLUME_MAX_FILES];
+static uint8_t nbrOfVolumeFiles = 0;
+static uint16_t nextFreeCluster = MSC_FIRST_CLUSTER;
+static bool isVolumeMounted = false;
+
+/* Texts taken at mount, the host reads them in any order */
+static char statusText[EVENT_JOURNAL_MAX_STRING_SIZE];
+static char crashText[MSC_CRASH_TEXT_SIZE];
+
+/* Private function prototypes -----------------------------------------------*/
+static void AddVolumeFile(const char* name, const uint32_t size,
+        void (*read)(const uint32_t offset, uint8_t* dst, const uint16_t size));
+static void ReadBootSector(uint8_t* dst);
+static void ReadFatSector(const uint32_t fatSector, uint8_t* dst);
+static void ReadRootSector(uint8_t* dst);
+static void ReadDataSector(const uint32_t cluster, uint8_t* dst);
+static uint16_t GetFatEntry(const uint32_t cluster);
+static void PutDirEntry(uint8_t* dst, const char* name, const uint8_t attributes, const uint16_t firstCluster,
+        const uint32_t size);
+static void PutLe16(uint8_t* dst, const uint16_t value);
+static void PutLe32(uint8_t* dst, const uint32_t value);
+#ifndef FCB_SD_CARD
+static void ReadLogFile(const uint32_t offset, uint8_t* dst, const uint16_t size);
+#endif
+static void ReadJournalFile(const uint32_t offset, uint8_t* dst, const uint16_t size);
+static void ReadStatusFile(const uint32_t offset, uint8_t* dst, const uint16_t size);
+static void ReadCrashFile(const uint32_t offset, uint8_t* dst, const uint16_t size);
+static void ReadParamsFile(const uint32_t offset, uint8_t* dst, const uint16_t size);
+static void ReadSettingsFile(const uint32_t offset, uint8_t* dst, const uint16_t size);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Lays out the files of the volume from the current logs and settings. Called by the USB mass storage work
+ *         when the medium is inserted, the reads are from the same work.
+ * @param  None
+ * @retval FCB_OK
+ */
+FcbRetValType MscVolumeMount(void) {
+    EventJournalStatusType journalStatus;
+    CrashDump_TypeDef dump;
+    size_t length;
+    uint8_t i;
+#ifndef FCB_SD_CARD
+    BlackboxStatus_TypeDef blackboxStatus;
+#endif
+
+    isVolumeMounted = false;
+    nbrOfVolumeFiles = 0;
+    nextFreeCluster = MSC_FIRST_CLUSTER;
+
+#ifndef FCB_SD_CARD
+    GetBlackboxStatus(&blackboxStatus);
+    AddVolumeFile("LOG     BIN", blackboxStatus.usedBytes, ReadLogFile);
+#endif
+
+    GetEventJournalStatus(&journalStatus);
+    AddVolumeFile("JOURNAL TXT", (uint32_t) journalStatus.records * MSC_JOURNAL_LINE_SIZE, ReadJournalFile);
+
+    PrintEventJournalStatus(statusText, sizeof(statusText));
+    AddVolumeFile("STATUS  TXT", strlen(statusText), ReadStatusFile);
+
+    if (GetCrashDump(&dump)) {
+        length = CrashDumpPrint(crashText, sizeof(crashText), &dump);
+        for (i = 0; i < CRASH_DUMP_LOG_ENTRIES && length < sizeof(crashText); i++) {
+            length += CrashDumpPrintLogEntry(crashText + length, sizeof(crashText) - length, &dump, i);
+        }
+        AddVolumeFile("CRASH   TXT", strlen(crashText), ReadCrashFile);
+    }
+
+    AddVolumeFile("PARAMS  TXT", (uint32_t) GetNbrOfParams() * MSC_PARAMS_LINE_SIZE, ReadParamsFile);
+    AddVolumeFile("SETTINGSBIN", MSC_SETTINGS_FILE_SIZE, ReadSettingsFile);
+
+    isVolumeMounted = true;
+    return FCB_OK;
+}
+
+/*
+ * @brief  Reads a sector of the volume
+ * @param  lba : Sector, below MSC_VOLUME_NBR_OF_SECTORS
+ * @param  dst : Destination of MSC_VOLUME_SECTOR_SIZE bytes
+ * @retval FCB_OK, FCB_ERR if the sector is out of range or the volume is not mounted
+ */
+FcbRetValType MscVolumeReadSector(const uint32_t lba, uint8_t* dst) {
+    if (!isVolumeMounted || lba >= MSC_VOLUME_NBR_OF_SECTORS) {
+        return FCB_ERR;
+    }
+
+    memset(dst, 0, MSC_VOLUME_SECTOR_SIZE);
+
+    if (lba < MSC_FIRST_FAT_SECTOR) {
+        ReadBootSector(dst);
+    } else if (lba < MSC_ROOT_SECTOR) {
+        /* The copies of the FAT are the same */
+        ReadFatSector((lba - MSC_FIRST_FAT_SECTOR) % MSC_FAT_SECTORS, dst);
+    } else if (lba < MSC_FIRST_DATA_SECTOR) {
+        ReadRootSector(dst);
+    } else {
+        ReadDataSector(lba - MSC_FIRST_DATA_SECTOR + MSC_FIRST_CLUSTER, dst);
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Gets the number of files of the mounted volume
+ * @param  None
+ * @retval Number of files, 0 if not mounted
+ */
+uint8_t GetMscVolumeFiles(void) {
+    return isVolumeMounted ? nbrOfVolumeFiles : 0;
+}
+
+/*
+ * @brief  Gets the bytes in the files of the mounted volume
+ * @param  None
+ * @retval Bytes, 0 if not mounted
+ */
+uint32_t GetMscVolumeUsedBytes(void) {
+    uint32_t usedBytes = 0;
+    uint8_t i;
+
+    if (isVolumeMounted) {
+        for (i = 0; i < nbrOfVolumeFiles; i++) {
+            usedBytes += volumeFiles[i].size;
+        }
+    }
+
+    return usedBytes;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Adds a file after the previous ones. A file is cut to the free clusters, which the volume has enough of
+ *         for the largest log and settings.
+ * @param  name : 8.3 name as in the directory entry, 11 characters space padded
+ * @param  size : Size of the file [bytes]
+ * @param  read : Function that reads the file data
+ * @retval None
+ */
+static void AddVolumeFile(const char* name, const uint32_t size,
+        void (*read)(const uint32_t offset, uint8_t* dst, const uint16_t size)) {
+    MscVolumeFile_TypeDef* file;
+    uint32_t freeClusters = MSC_FIRST_CLUSTER + MSC_NBR_OF_CLUSTERS - nextFreeCluster;
+
+    if (nbrOfVolumeFiles >= MSC_VOLUME_MAX_FILES) {
+        return;
+    }
+
+    file = &volumeFiles[nbrOfVolumeFiles++];
+    memcpy(file->name, name, sizeof(file->name));
+    file->size = size;
+    if (file->size > freeClusters*MSC_VOLUME_SECTOR_SIZE) {
+        file->size = freeClusters*MSC_VOLUME_SECTOR_SIZE;
+    }
+    file->clusters = (file->size + MSC_VOLUME_SECTOR_SIZE - 1) / MSC_VOLUME_SECTOR_SIZE;
+    file->firstCluster = file->clusters > 0 ? nextFreeCluster : 0;
+    file->read = read;
+
+    nextFreeCluster += file->clusters;
+}
+
+/*
+ * @brief  Makes up the boot sector with the BIOS parameter block of the volume
+ * @param  dst : Destination sector, zeroed
+ * @retval None
+ */
+static void ReadBootSector(uint8_t* dst) {
+    dst[0] = 0xEB; // Jump over the parameter block, as the hosts expect
+    dst[1] = 0x3C;
+    dst[2] = 0x90;
+    memcpy(&dst[3], "DRAGONFL", 8);
+    PutLe16(&dst[11], MSC_VOLUME_SECTOR_SIZE);
+    dst[13] = 1; // Sectors per cluster
+    PutLe16(&dst[14], MSC_RESERVED_SECTORS);
+    dst[16] = MSC_NBR_OF_FATS;
+    PutLe16(&dst[17], MSC_ROOT_ENTRIES);
+    PutLe16(&dst[19], MSC_VOLUME_NBR_OF_SECTORS);
+    dst[21] = MSC_MEDIA_DESCRIPTOR;
+    PutLe16(&dst[22], MSC_FAT_SECTORS);
+    PutLe16(&dst[24], 32); // Sectors per track and heads, not used
+    PutLe16(&dst[26], 64);
+    dst[36] = 0x80; // Drive number
+    dst[38] = 0x29; // Extended boot signature, the serial number and labels follow
+    PutLe32(&dst[39], MSC_VOLUME_SERIAL);
+    memcpy(&dst[43], "FCB DATA   ", 11);
+    memcpy(&dst[54], "FAT12   ", 8);
+    dst[510] = 0x55;
+    dst[511] = 0xAA;
+}
+
+/*
+ * @brief  Makes up a sector of the FAT. Two 12 bit entries take three bytes, the first entry in the lower 12 bits.
+ * @param  fatSector : Sector within the FAT
+ * @param  dst : Destination sector, zeroed
+ * @retval None
+ */
+static void ReadFatSector(const uint32_t fatSector, uint8_t* dst) {
+    uint32_t byteIdx, pair;
+    uint16_t i, first, second;
+
+    for (i = 0; i < MSC_VOLUME_SECTOR_SIZE; i++) {
+        byteIdx = fatSector*MSC_VOLUME_SECTOR_SIZE + i;
+        pair = byteIdx / 3;
+        first = GetFatEntry(2*pair);
+        second = GetFatEntry(2*pair + 1);
+
+        switch (byteIdx % 3) {
+        case 0:
+            dst[i] = (uint8_t) first;
+            break;
+        case 1:
+            dst[i] = (uint8_t) ((first >> 8) & 0x0F) | (uint8_t) ((second & 0x0F) << 4);
+            break;
+        default:
+            dst[i] = (uint8_t) (second >> 4);
+            break;
+        }
+    }
+}
+
+/*
+ * @brief  Makes up the root directory, the volume label and the files
+ * @param  dst : Destination sector, zeroed
+ * @retval None
+ */
+static void ReadRootSector(uint8_t* dst) {
+    uint8_t i;
+
+    PutDirEntry(dst, "FCB DATA   ", MSC_ATTR_VOLUME_ID, 0, 0);
+
+    for (i = 0; i < nbrOfVolumeFiles; i++) {
+        PutDirEntry(&dst[(i + 1)*MSC_DIR_ENTRY_SIZE], volumeFiles[i].name, MSC_ATTR_READ_ONLY,
+                volumeFiles[i].firstCluster, volumeFiles[i].size);
+    }
+}
+
+/*
+ * @brief  Reads a data cluster from the file it belongs to, the rest of the last cluster of a file is zeros
+ * @param  cluster : Cluster number, from MSC_FIRST_CLUSTER
+ * @param  dst : Destination sector, zeroed
+ * @retval None
+ */
+static void ReadDataSector(const uint32_t cluster, uint8_t* dst) {
+    const MscVolumeFile_TypeDef* file;
+    uint32_t offset, size;
+    uint8_t i;
+
+    for (i = 0; i < nbrOfVolumeFiles; i++) {
+        file = &volumeFiles[i];
+        if (file->clusters > 0 && cluster >= file->firstCluster && cluster < file->firstCluster + file->clusters) {
+            offset = (cluster - file->firstCluster)*MSC_VOLUME_SECTOR_SIZE;
+            size = file->size - offset;
+            if (size > MSC_VOLUME_SECTOR_SIZE) {
+                size = MSC_VOLUME_SECTOR_SIZE;
+            }
+            file->read(offset, dst, (uint16_t) size);
+            return;
+        }
+    }
+}
+
+/*
+ * @brief  Gets the FAT entry of a cluster
+ * @param  cluster : Cluster number
+ * @retval The next cluster of the file, MSC_FAT12_END_OF_CHAIN at its last one, 0 for a free cluster
+ */
+static uint16_t GetFatEntry(const uint32_t cluster) {
+    const MscVolumeFile_TypeDef* file;
+    uint8_t i;
+
+    /* The first two entries hold the media descriptor and the end of chain mark */
+    if (cluster < MSC_FIRST_CLUSTER) {
+        return cluster == 0 ? (0xF00 | MSC_MEDIA_DESCRIPTOR) : MSC_FAT12_END_OF_CHAIN;
+    }
+
+    for (i = 0; i < nbrOfVolumeFiles; i++) {
+        file = &volumeFiles[i];
+        if (file->clusters > 0 && cluster >= file->firstCluster && cluster < file->firstCluster + file->clusters) {
+            return cluster + 1 < file->firstCluster + file->clusters ? (uint16_t) (cluster + 1)
+                    : MSC_FAT12_END_OF_CHAIN;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * @brief  Puts a short directory entry
+ * @param  dst : Destination entry, zeroed
+ * @param  name : 8.3 name, 11 characters space padded
+ * @param  attributes : MSC_ATTR_* bits
+ * @param  firstCluster : First cluster, 0 if none
+ * @param  size : File size [bytes]
+ * @retval None
+ */
+static void PutDirEntry(uint8_t* dst, const char* name, const uint8_t attributes, const uint16_t firstCluster,
+        const uint32_t size) {
+    memcpy(dst, name, 11);
+    dst[11] = attributes;
+    PutLe16(&dst[16], MSC_FILE_DATE); // Creation date
+    PutLe16(&dst[18], MSC_FILE_DATE); // Access date
+    PutLe16(&dst[24], MSC_FILE_DATE); // Modification date
+    PutLe16(&dst[26], firstCluster);
+    PutLe32(&dst[28], size);
+}
+
+static void PutLe16(uint8_t* dst, const uint16_t value) {
+    dst[0] = (uint8_t) value;
+    dst[1] = (uint8_t) (value >> 8);
+}
+
+static void PutLe32(uint8_t* dst, const uint32_t value) {
+    PutLe16(dst, (uint16_t) value);
+    PutLe16(&dst[2], (uint16_t) (value >> 16));
+}
+
+#ifndef FCB_SD_CARD
+static void ReadLogFile(const uint32_t offset, uint8_t* dst, const uint16_t size) {
+    ReadBlackbox(offset, dst, size);
+}
+#endif
+
+/*
+ * @brief  Reads lines of the event journal file, a record per MSC_JOURNAL_LINE_SIZE line padded with spaces
+ * @param  offset : Offset in the file, at a line
+ * @param  dst : Destination
+ * @param  size : Bytes to read, whole lines
+ * @retval None
+ */
+static void ReadJournalFile(const uint32_t offset, uint8_t* dst, const uint16_t size) {
+    char line[EVENT_JOURNAL_RECORD_STRING_SIZE];
+    EventJournalRecordType record;
+    uint16_t pos;
+    size_t length;
+
+    for (pos = 0; pos + MSC_JOURNAL_LINE_SIZE <= size; pos += MSC_JOURNAL_LINE_SIZE) {
+        if (GetEventJournalRecord((offset + pos) / MSC_JOURNAL_LINE_SIZE, &record)) {
+            length = PrintEventJournalRecord(line, sizeof(line), &record);
+        } else {
+            length = snprintf(line, sizeof(line), "%5u interrupted record\n",
+                    (unsigned int) ((offset + pos) / MSC_JOURNAL_LINE_SIZE));
+        }
+
+        /* The newline is put back at the end of the padded line */
+        if (length >= sizeof(line)) {
+            length = sizeof(line) - 1;
+        }
+        if (length > 0 && '\n' == line[length - 1]) {
+            length--;
+        }
+        if (length > MSC_JOURNAL_LINE_SIZE - 1) {
+            length = MSC_JOURNAL_LINE_SIZE - 1;
+        }
+        memcpy(&dst[pos], line, length);
+        memset(&dst[pos + length], ' ', MSC_JOURNAL_LINE_SIZE - 1 - length);
+        dst[pos + MSC_JOURNAL_LINE_SIZE - 1] = '\n';
+    }
+}
+
+static void ReadStatusFile(const uint32_t offset, uint8_t* dst, const uint16_t size) {
+    memcpy(dst, &statusText[offset], size);
+}
+
+static void ReadCrashFile(const uint32_t offset, uint8_t* dst, const uint16_t size) {
+    memcpy(dst, &crashText[offset], size);
+}
+
+/*
+ * @brief  Reads lines of the parameter file, the name and the value of a parameter per MSC_PARAMS_LINE_SIZE line
+ * @param  offset : Offset in the file, at a line
+ * @param  dst : Destination
+ * @param  size : Bytes to read, whole lines
+ * @retval None
+ */
+static void ReadParamsFile(const uint32_t offset, uint8_t* dst, const uint16_t size) {
+    char value[24], line[48];
+    const Param_TypeDef* param;
+    float32_t paramValue;
+    uint16_t pos, id;
+
+    for (pos = 0; pos + MSC_PARAMS_LINE_SIZE <= size; pos += MSC_PARAMS_LINE_SIZE) {
+        id = (uint16_t) ((offset + pos) / MSC_PARAMS_LINE_SIZE);
+        param = GetParam(id);
+
+        value[0] = '\0';
+        if (FCB_OK == GetParamValue(id, &paramValue)) {
+            FormatFixed(value, sizeof(value), paramValue, MSC_PARAMS_DECIMALS);
+        }
+        snprintf(line, sizeof(line), "%-*s %*s", PARAM_NAME_LEN, NULL != param ? param->name : "",
+                MSC_PARAMS_LINE_SIZE - PARAM_NAME_LEN - 2, value);
+
+        /* Cut to the line, the newline last */
+        memcpy(&dst[pos], line, MSC_PARAMS_LINE_SIZE - 1);
+        dst[pos + MSC_PARAMS_LINE_SIZE - 1] = '\n';
+    }
+}
+
+static void ReadSettingsFile(const uint32_t offset, uint8_t* dst, const uint16_t size) {
+    memcpy(dst, (const uint8_t*) (FLASH_PROFILES_START_ADDR + offset), size);
+}
+
+#endif /* FCB_USB_MASS_STORAGE */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,73 @@
+/******************************************************************************
+ * @brief   Header file for the read-only FAT volume of the USB mass storage
+ *          interface. The volume is not stored anywhere: its boot sector, FATs
+ *          and root directory are made up when a sector is read, and the file
+ *          sectors are read from where the data lives:
+ *          - LOG.BIN: the used part of the blackbox flash log, not with
+ *            FCB_SD_CARD, whose card is read in a card reader instead
+ *          - JOURNAL.TXT: the event journal, a fixed length line per record
+ *          - STATUS.TXT: the event journal status and the flight odometer
+ *          - CRASH.TXT: the crash dump, if there is one
+ *          - PARAMS.TXT: the parameter table, a fixed length line per value
+ *          - SETTINGS.BIN: the profiles page and the settings store as they
+ *            are in flash, to be kept or compared
+ *
+ *          The file sizes and the text of the status and the crash dump are
+ *          taken when the volume is mounted, so that the directory the host
+ *          has cached stays true while it is mounted.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __MSC_VOLUME_H
+#define __MSC_VOLUME_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "fcb_retval.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define MSC_VOLUME_SECTOR_SIZE          512
+#define MSC_VOLUME_NBR_OF_SECTORS       512     // 256 kB, FAT12 with a sector per cluster
+#define MSC_VOLUME_MAX_FILES            8
+
+/* Exported functions ------------------------------------------------------- */
+
+/**
+ * Lays out the files of the volume from the current logs and settings.
+ *
+ * @return FCB_OK
+ */
+FcbRetValType MscVolumeMount(void);
+
+/**
+ * Reads a sector of the volume. Sectors past the files read as zeros.
+ *
+ * @param lba sector, below MSC_VOLUME_NBR_OF_SECTORS
+ * @param dst destination of MSC_VOLUME_SECTOR_SIZE bytes
+ * @return FCB_OK, FCB_ERR if the sector is out of range or the volume is not mounted
+ */
+FcbRetValType MscVolumeReadSector(const uint32_t lba, uint8_t* dst);
+
+/**
+ * @return number of files of the mounted volume, 0 if not mounted
+ */
+uint8_t GetMscVolumeFiles(void);
+
+/**
+ * @return bytes in the files of the mounted volume
+ */
+uint32_t GetMscVolumeUsedBytes(void);
+
+#endif /* __MSC_VOLUME_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,216 @@
+/*****************************************************************************
+ * @brief   Framing of the protobuf messages sent to the host. A frame is the
+ *          message id, the serialized message and the CRC32 of both (from
+ *          the CRC peripheral, little endian), COBS (consistent overhead
+ *          byte stuffing) encoded and ended by a zero delimiter byte. The
+ *          encoded data contains no zeros, so frames can be packed back to
+ *          back into USB packets, and a host that has lost track of the
+ *          stream resyncs at the next delimiter. Messages can be serialized
+ *          straight into their frame, see ProtoFrameBegin().
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "proto_frame.h"
+
+#include "common.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+
+/* COBS: each block of up to 254 non-zero bytes is preceded by a code byte, its length + 1 */
+#define COBS_MAX_CODE               0xFF
+
+/* Worst case size of the frame end: the CRC, the code byte of a block it starts and the delimiter */
+#define PROTO_FRAME_TRAILER_MAX_SIZE    (PROTO_FRAME_CRC_LEN + PROTO_FRAME_CRC_LEN / 254 + 1 + 1)
+
+#define PROTO_FRAME_CRC_TIMEOUT         10      // Max wait for a DMA CRC [ms]
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+
+/* Private function prototypes -----------------------------------------------*/
+static bool ProtoFrameWrite(pb_ostream_t* stream, const uint8_t* buf, size_t count);
+static void FrameAddData(ProtoFrameStream_TypeDef* frame, const uint8_t* data, const size_t dataSize);
+static void CobsPutByte(ProtoFrameStream_TypeDef* frame, const uint8_t data);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Encodes a serialized protobuf message into a frame
+ * @param  dst : Destination buffer, at least PROTO_FRAME_MAX_SIZE(payloadSize) bytes
+ * @param  dstSize : Size of dst
+ * @param  msgType : Message type, sent as the message id
+ * @param  payload : Serialized message
+ * @param  payloadSize : Size of payload
+ * @retval Length of the frame including the delimiter, 0 if dst is too small
+ */
+size_t ProtoFrameEncode(uint8_t* dst, const size_t dstSize, const enum ProtoMessageTypeEnum msgType,
+        const uint8_t* payload, const uint16_t payloadSize) {
+    ProtoFrameStream_TypeDef frame;
+
+    if (dstSize < (size_t) PROTO_FRAME_MAX_SIZE(payloadSize)) {
+        return 0;
+    }
+
+    ProtoFrameBegin(&frame, dst, dstSize, msgType);
+    FrameAddData(&frame, payload, payloadSize);
+
+    return ProtoFrameEnd(&frame);
+}
+
+/*
+ * @brief  Starts a frame that the message is serialized into right away, without a serialized copy of it: the
+ *         data written to frame->stream is CRC:d and COBS encoded into dst as it comes. Encode the message with e.g.
+ *         pb_encode(&frame->stream, ...), then complete the frame with ProtoFrameEnd(). The encoding fails if the
+ *         message is larger than frame->stream.max_size.
+ * @param  frame : Frame state
+ * @param  dst : Destination buffer
+ * @param  dstSize : Size of dst
+ * @param  msgType : Message type, sent as the message id
+ * @retval None
+ */
+void ProtoFrameBegin(ProtoFrameStream_TypeDef* frame, uint8_t* dst, const size_t dstSize,
+        const enum ProtoMessageTypeEnum msgType) {
+    uint8_t msgId = (uint8_t) msgType;
+
+    frame->isOverflow = dstSize < (size_t) PROTO_FRAME_MAX_SIZE(0);
+
+    /* The stream size is the largest message that always fits, so that encoders can check what fits */
+    frame->stream = (pb_ostream_t) { ProtoFrameWrite, frame,
+            frame->isOverflow ? 0 : dstSize - PROTO_FRAME_MAX_SIZE(0) - dstSize / 254, 0 };
+    frame->dst = dst;
+    frame->dstSize = dstSize;
+    frame->codeIdx = 0;
+    frame->length = 1;
+    frame->code = 1;
+    frame->crc = DEFAULT_CRC_INITVALUE;
+
+    if (!frame->isOverflow) {
+        FrameAddData(frame, &msgId, PROTO_FRAME_ID_LEN);
+    }
+}
+
+/*
+ * @brief  Completes a frame started by ProtoFrameBegin() with the CRC and the delimiter
+ * @param  frame : Frame state
+ * @retval Length of the frame including the delimiter, 0 if it did not fit in dst
+ */
+size_t ProtoFrameEnd(ProtoFrameStream_TypeDef* frame) {
+    uint8_t crcBytes[PROTO_FRAME_CRC_LEN];
+    uint8_t i;
+
+    if (frame->isOverflow) {
+        return 0;
+    }
+
+    for (i = 0; i < PROTO_FRAME_CRC_LEN; i++) {
+        crcBytes[i] = (uint8_t) (frame->crc >> (8 * i));
+    }
+
+    /* Room for the trailer was checked before the data */
+    for (i = 0; i < PROTO_FRAME_CRC_LEN; i++) {
+        CobsPutByte(frame, crcBytes[i]);
+    }
+
+    frame->dst[frame->codeIdx] = frame->code;
+    frame->dst[frame->length++] = PROTO_FRAME_DELIMITER;
+
+    return frame->length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Stream callback of a frame, adds serialized message data to it
+ * @param  stream : Stream of the frame
+ * @param  buf : Serialized data
+ * @param  count : Size of buf
+ * @retval true if added, false if the frame would not fit in its buffer
+ */
+static bool ProtoFrameWrite(pb_ostream_t* stream, const uint8_t* buf, size_t count) {
+    ProtoFrameStream_TypeDef* frame = (ProtoFrameStream_TypeDef*) stream->state;
+
+    /* The data may start blocks, and the CRC and the delimiter must still fit */
+    if (frame->isOverflow
+            || frame->length + count + count / 254 + 1 + PROTO_FRAME_TRAILER_MAX_SIZE > frame->dstSize) {
+        frame->isOverflow = true;
+        return false;
+    }
+
+    FrameAddData(frame, buf, count);
+
+    return true;
+}
+
+/*
+ * @brief  Adds data to the CRC and the COBS encoded frame. The caller has checked that it fits.
+ * @param  frame : Frame state
+ * @param  data : Data to add
+ * @param  dataSize : Size of data
+ * @retval None
+ */
+static void FrameAddData(ProtoFrameStream_TypeDef* frame, const uint8_t* data, const size_t dataSize) {
+    size_t i;
+
+    if (0 == dataSize) {
+        return;
+    }
+
+    /* Larger data is CRC:d by DMA while it is COBS encoded. It stays unchanged meanwhile, the encoder only reads it. */
+    if (dataSize >= CRC_DMA_MIN_SIZE && FCB_OK == StartCRCWithDMA(frame->crc, data, dataSize)) {
+        for (i = 0; i < dataSize; i++) {
+            CobsPutByte(frame, data[i]);
+        }
+
+        if (FCB_OK == WaitCRCWithDMA(&frame->crc, PROTO_FRAME_CRC_TIMEOUT)) {
+            return;
+        }
+
+        /* The CRC is calculated again below, the encoded bytes are kept */
+        vTaskSuspendAll();
+        frame->crc = ContinueCRC(frame->crc, data, dataSize);
+        xTaskResumeAll();
+        return;
+    }
+
+    /* The CRC peripheral is shared by the tasks, keep them from using it while it holds the frame CRC */
+    vTaskSuspendAll();
+    frame->crc = ContinueCRC(frame->crc, data, dataSize);
+    xTaskResumeAll();
+
+    for (i = 0; i < dataSize; i++) {
+        CobsPutByte(frame, data[i]);
+    }
+}
+
+/*
+ * @brief  Adds a byte to the COBS encoded frame
+ * @param  frame : Frame state
+ * @param  data : Byte to add
+ * @retval None
+ */
+static void CobsPutByte(ProtoFrameStream_TypeDef* frame, const uint8_t data) {
+    if (0 != data) {
+        frame->dst[frame->length++] = data;
+        frame->code++;
+    }
+
+    /* A zero ends the block implicitly, a full block ends without one */
+    if (0 == data || COBS_MAX_CODE == frame->code) {
+        frame->dst[frame->codeIdx] = frame->code;
+        frame->codeIdx = frame->length++;
+        frame->code = 1;
+    }
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
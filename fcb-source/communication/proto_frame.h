@@ -0,0 +1,62 @@
+/******************************************************************************
+ * @brief   Header file for the framing of protobuf messages sent to the host
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __PROTO_FRAME_H
+#define __PROTO_FRAME_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "communication.h"
+#include "pb_encode.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Frame encoded as the message is serialized, see ProtoFrameBegin(). The fields after stream are private. */
+typedef struct {
+    pb_ostream_t stream;            // Serialize the message to this stream
+    uint8_t* dst;
+    size_t dstSize;
+    size_t length;                  // COBS encoder: frame length, including the code byte of the open block
+    size_t codeIdx;                 // COBS encoder: index of the code byte of the open block
+    uint8_t code;                   // COBS encoder: length + 1 of the open block
+    uint32_t crc;
+    bool isOverflow;
+} ProtoFrameStream_TypeDef;
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Ends every frame, the COBS encoded frame data never contains it */
+#define PROTO_FRAME_DELIMITER           0x00
+
+/* Unencoded frame data around the payload: message id before it, CRC after it */
+#define PROTO_FRAME_ID_LEN              1
+#define PROTO_FRAME_CRC_LEN             4
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Worst case size of a frame, COBS adds one code byte per started 254 data bytes */
+#define PROTO_FRAME_MAX_SIZE(PAYLOAD_SIZE)  ((PAYLOAD_SIZE) + PROTO_FRAME_ID_LEN + PROTO_FRAME_CRC_LEN \
+        + ((PAYLOAD_SIZE) + PROTO_FRAME_ID_LEN + PROTO_FRAME_CRC_LEN) / 254 + 1 + 1)
+
+/* Exported functions ------------------------------------------------------- */
+size_t ProtoFrameEncode(uint8_t* dst, const size_t dstSize, const enum ProtoMessageTypeEnum msgType,
+        const uint8_t* payload, const uint16_t payloadSize);
+void ProtoFrameBegin(ProtoFrameStream_TypeDef* frame, uint8_t* dst, const size_t dstSize,
+        const enum ProtoMessageTypeEnum msgType);
+size_t ProtoFrameEnd(ProtoFrameStream_TypeDef* frame);
+
+#endif /* __PROTO_FRAME_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
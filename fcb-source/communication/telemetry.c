@@ -0,0 +1,845 @@
+/*****************************************************************************
+ * @brief   Telemetry scheduler. One task samples the flight data messages
+ *          according to a rate table, so that no task is created or deleted
+ *          when sampling is started or stopped. Protobuf frames that are due
+ *          at the same tick are packed back to back into one write to the USB
+ *          com port, or to the USB log endpoint, which keeps high rates from
+ *          crowding out the CLI replies. A full pack buffer is written in
+ *          whole USB packets. Text
+ *          messages are printed by their subsystems as before. Windowed
+ *          summaries of the high rate signals are sent as one more message,
+ *          see telemetry_aggregate.h. The task also sends the MAVLink streams,
+ *          see MavlinkStreamPoll().
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "telemetry.h"
+
+#include "telemetry_aggregate.h"
+#include "param_table.h"
+#include "proto_frame.h"
+#include "dragonfly_fcb.pb.h"
+#include "pb_encode.h"
+#include "receiver.h"
+#include "motor_control.h"
+#include "flight_control.h"
+#include "state_estimation.h"
+#include "fcb_sensors.h"
+#include "fcb_gyroscope.h"
+#include "fcb_accelerometer_magnetometer.h"
+#include "fcb_sensor_self_test.h"
+#include "common.h"
+#include "fcb_error.h"
+#include "usbd_cdc_if.h"
+#include "usbd_log_if.h"
+#include "trace_recorder.h"
+#include "task_status.h"
+#include "deadline_monitor.h"
+#include "buffer_monitor.h"
+#include "cpu_headroom.h"
+#include "esc_telemetry.h"
+#include "time_sync.h"
+#include "compact_codec.h"
+#include "prearm_checks.h"
+#include "perf_snapshot.h"
+#include "rate_groups.h"
+#include "com_mavlink.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Encodes the message payload to a protobuf stream */
+typedef bool (*TelemetryEncodeFunc)(pb_ostream_t* stream);
+
+/* Prints the message as text, NULL if it has no text form */
+typedef void (*TelemetryPrintFunc)(void);
+
+typedef struct {
+    enum ProtoMessageTypeEnum msgType;
+    const char* name;
+    uint16_t minSampleTime;         // [ms] The rate the message data is updated at
+    TelemetryEncodeFunc encode;
+    TelemetryPrintFunc print;
+} TelemetryMsg_TypeDef;
+
+/* Group of fields of the compact samples, in frame order */
+typedef struct {
+    const char* name;
+    uint8_t fieldCount;
+    CompactPredictorType predictor;
+} CompactGroup_TypeDef;
+
+typedef struct {
+    bool isActive;
+    SerializationType serialization;
+    portTickType sampleTime;
+    portTickType nextSampleTick;
+    portTickType endTick;
+} TelemetryRate_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define TELEMETRY_TASK_PRIO             1
+
+/* Full pack buffers are written in multiples of the USB packet size */
+#define TELEMETRY_PACKET_SIZE           CDC_DATA_FS_MAX_PACKET_SIZE
+
+/* Gyro, acc, mag, angle and rate axes and the motors, see compactGroups */
+#define COMPACT_SAMPLES_FIELD_NBR       (5*3 + 4)
+#define COMPACT_GROUP_NBR               6
+
+/* Private macro -------------------------------------------------------------*/
+#define TELEMETRY_MSG_NBR               (sizeof(telemetryMsgs)/sizeof(telemetryMsgs[0]))
+
+/* Private function prototypes -----------------------------------------------*/
+static void TelemetryTask(void const *argument);
+static void AppendFrame(const TelemetryMsg_TypeDef* msg);
+static void FlushFrames(void);
+static void FlushPackets(void);
+static void WriteFrames(const uint8_t* data, const uint16_t size);
+
+static bool EncodeSensorSamples(pb_ostream_t* stream);
+static bool EncodeFlightStates(pb_ostream_t* stream);
+static bool EncodeRefSignals(pb_ostream_t* stream);
+static bool EncodeCtrlSignals(pb_ostream_t* stream);
+static bool EncodeMotorValues(pb_ostream_t* stream);
+static bool EncodeReceiverValues(pb_ostream_t* stream);
+static bool EncodeSignalSummaries(pb_ostream_t* stream);
+static bool EncodeCompactSamples(pb_ostream_t* stream);
+static bool EncodeSignalSummary(pb_ostream_t* stream, const AggregateSignal_TypeDef signal,
+        const AggregateSummary_TypeDef* summary);
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Rate table, the message data and the fastest rate it is worth sampling at */
+static const TelemetryMsg_TypeDef telemetryMsgs[] = {
+    { SENSOR_SAMPLES_MSG_ENUM, "sensor", 10, EncodeSensorSamples, PrintSensorValues },
+    { FLIGHT_STATE_MSG_ENUM, "state", 20, EncodeFlightStates, PrintStateValues },
+    { REFSIGNALS_MSG_ENUM, "ref", 10, EncodeRefSignals, NULL },
+    { CTRLSIGNALS_MSG_ENUM, "ctrl", 10, EncodeCtrlSignals, NULL },
+    { MOTOR_VALUES_MSG_ENUM, "motor", 2, EncodeMotorValues, PrintMotorControlValues },
+    { RC_VALUES_MSG_ENUM, "rc", 22, EncodeReceiverValues, PrintReceiverValues }, // Receiver frame period
+    { SIGNAL_SUMMARY_MSG_ENUM, "summary", 10, EncodeSignalSummaries, NULL },
+    { PARAM_TABLE_MSG_ENUM, "params", 100, EncodeParamTable, NULL },
+    { TASK_STATUS_MSG_ENUM, "tasks", TASK_STATUS_SAMPLE_PERIOD, EncodeTaskStatus, NULL },
+    { DEADLINE_STATS_MSG_ENUM, "deadline", 100, EncodeDeadlineStats, NULL },
+    { BUFFER_STATS_MSG_ENUM, "buffers", 1000, EncodeBufferStats, NULL },
+    { CPU_HEADROOM_MSG_ENUM, "headroom", TASK_STATUS_SAMPLE_PERIOD, EncodeCpuHeadroom, NULL },
+    { TIME_SYNC_MSG_ENUM, "clock", 10, EncodeTimeSync, NULL }, // Maps the frames packed alongside to host time
+    { COMPACT_SAMPLES_MSG_ENUM, "compact", 2, EncodeCompactSamples, NULL }, // Not protobuf, see compact_codec.h
+    { SENSOR_HEALTH_MSG_ENUM, "health", 100, EncodeSensorHealth, NULL },
+    { PREARM_STATUS_MSG_ENUM, "prearm", RATE_GROUP_20HZ_PERIOD, EncodePreArmStatus, NULL },
+#ifdef FCB_PERF_SNAPSHOT
+    { PERF_SNAPSHOT_MSG_ENUM, "perf", 250, EncodePerfSnapshot, NULL }, // A part of the fields each, see perf_snapshot.h
+#endif
+#ifdef MOTOR_ESC_TELEMETRY
+    { ESC_TELEMETRY_MSG_ENUM, "esc", 20, EncodeEscTelemetry, NULL }, // About a poll round at 5 ms control cycles
+#endif
+};
+
+/* Configured rates, written by the starting and stopping tasks in critical sections */
+static TelemetryRate_TypeDef telemetryRates[TELEMETRY_MSG_NBR];
+
+/* Frames waiting to be written, used by the telemetry task only */
+static uint8_t telemetryPackBuffer[TELEMETRY_PACK_BUFFER_SIZE];
+static uint16_t telemetryPackLength = 0;
+
+/* Output of the protobuf frames, set from the CLI */
+static volatile TelemetryOutput telemetryOutput = TELEMETRY_OUTPUT_COM;
+
+/* Number of windows of each signal that have been sent, used by the encoding task only */
+static uint32_t sentSummaryWindows[AGGREGATE_SIGNAL_NBR];
+
+/* Wakes the telemetry task when the rate table has changed */
+static xSemaphoreHandle telemetryWakeSem = NULL;
+
+/* Fields of the compact samples. Gyro and estimated angles and rates are smooth at the sample rate, the accelerometer
+ * and magnetometer are dominated by the noise and the motors step with the control signals. */
+static const CompactGroup_TypeDef compactGroups[COMPACT_GROUP_NBR] = {
+    { "gyro", 3, COMPACT_PREDICT_LINEAR },      // [rad/s]
+    { "acc", 3, COMPACT_PREDICT_PREVIOUS },     // [m/s^2]
+    { "mag", 3, COMPACT_PREDICT_PREVIOUS },     // Calibrated magnetometer vector
+    { "angle", 3, COMPACT_PREDICT_LINEAR },     // [rad]
+    { "rate", 3, COMPACT_PREDICT_LINEAR },      // [rad/s]
+    { "motor", 4, COMPACT_PREDICT_PREVIOUS },   // Motor output values
+};
+
+/* Decimals of each group, written by a CLI command in critical sections. The encoder takes them with a keyframe when
+ * isCompactRestarted is set, also by StartTelemetry() so that every start begins with a keyframe. */
+static uint8_t compactDecimals[COMPACT_GROUP_NBR] = { 3, 2, 3, 4, 3, 0 };
+static volatile bool isCompactRestarted = true;
+
+/* Encoder state and frame, used by the telemetry task only */
+static CompactCodec_TypeDef compactEncoder;
+static uint8_t compactFrame[COMPACT_MAX_FRAME_SIZE(COMPACT_SAMPLES_FIELD_NBR)];
+
+static xTaskHandle TelemetryTaskHandle = NULL;
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Creates the telemetry task. It runs for as long as the system does and only polls the MAVLink streams until
+ *         sampling is started.
+ * @param  None
+ * @retval None
+ */
+void CreateTelemetryTask(void) {
+    telemetryWakeSem = xSemaphoreCreateBinary();
+    if (telemetryWakeSem == NULL) {
+        ErrorHandler();
+        return;
+    }
+    TRACE_OBJECT_NAME(telemetryWakeSem, "qTelemetry");
+
+    /* Telemetry task creation
+     * Task function pointer: TelemetryTask
+     * Task name: TELEMETRY
+     * Stack depth: 3*configMINIMAL_STACK_SIZE
+     * Parameter: NULL
+     * Priority: TELEMETRY_TASK_PRIO (0 to configMAX_PRIORITIES-1 possible)
+     * Handle: TelemetryTaskHandle
+     * */
+    if (pdPASS != xTaskCreate((pdTASK_CODE )TelemetryTask, (signed portCHAR*)"TELEMETRY",
+                    3*configMINIMAL_STACK_SIZE, NULL, TELEMETRY_TASK_PRIO, &TelemetryTaskHandle)) {
+        ErrorHandler();
+    }
+}
+
+/*
+ * @brief  Starts sampling a message, or updates the rate of a message that is already sampled
+ * @param  msgType : Message to sample
+ * @param  serialization : PROTOBUFFER_SERIALIZATION for packed protobuf frames, NO_SERIALIZATION for text
+ * @param  sampleTime : Sets how often the message should be sampled [ms]
+ * @param  sampleDuration : Sets for how long sampling should be performed [s]
+ * @retval FCB_OK if sampling started, else FCB_ERR
+ */
+FcbRetValType StartTelemetry(const enum ProtoMessageTypeEnum msgType, const SerializationType serialization,
+        const uint16_t sampleTime, const uint32_t sampleDuration) {
+    portTickType now;
+    uint8_t i;
+
+    for (i = 0; i < TELEMETRY_MSG_NBR; i++) {
+        if (telemetryMsgs[i].msgType == msgType) {
+            break;
+        }
+    }
+
+    if (i >= TELEMETRY_MSG_NBR || telemetryWakeSem == NULL
+            || (PROTOBUFFER_SERIALIZATION != serialization && NO_SERIALIZATION != serialization)
+            || (NO_SERIALIZATION == serialization && NULL == telemetryMsgs[i].print)) {
+        return FCB_ERR;
+    }
+
+    taskENTER_CRITICAL();
+    now = xTaskGetTickCount();
+    telemetryRates[i].serialization = serialization;
+    telemetryRates[i].sampleTime = ((sampleTime < telemetryMsgs[i].minSampleTime) ?
+            telemetryMsgs[i].minSampleTime : sampleTime) / portTICK_RATE_MS;
+    telemetryRates[i].nextSampleTick = now + telemetryRates[i].sampleTime;
+    telemetryRates[i].endTick = now + sampleDuration * configTICK_RATE_HZ;
+    telemetryRates[i].isActive = true;
+    if (COMPACT_SAMPLES_MSG_ENUM == msgType) {
+        isCompactRestarted = true;
+    }
+    taskEXIT_CRITICAL();
+
+    xSemaphoreGive(telemetryWakeSem);
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Stops sampling a message
+ * @param  msgType : Message to stop sampling
+ * @retval FCB_OK if the message was sampled, else FCB_ERR
+ */
+FcbRetValType StopTelemetry(const enum ProtoMessageTypeEnum msgType) {
+    FcbRetValType retVal = FCB_ERR;
+    uint8_t i;
+
+    taskENTER_CRITICAL();
+    for (i = 0; i < TELEMETRY_MSG_NBR; i++) {
+        if (telemetryMsgs[i].msgType == msgType && telemetryRates[i].isActive) {
+            telemetryRates[i].isActive = false;
+            retVal = FCB_OK;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return retVal;
+}
+
+/*
+ * @brief  Starts sampling of all messages as protobuf frames, at the fastest rate each is worth sampling at
+ * @param  sampleDuration : Sets for how long sampling should be performed [s]
+ * @retval None
+ */
+void StartAllTelemetry(const uint32_t sampleDuration) {
+    uint8_t i;
+
+    for (i = 0; i < TELEMETRY_MSG_NBR; i++) {
+        StartTelemetry(telemetryMsgs[i].msgType, PROTOBUFFER_SERIALIZATION, 0, sampleDuration);
+    }
+}
+
+/*
+ * @brief  Stops sampling of all messages
+ * @param  None
+ * @retval None
+ */
+void StopAllTelemetry(void) {
+    uint8_t i;
+
+    taskENTER_CRITICAL();
+    for (i = 0; i < TELEMETRY_MSG_NBR; i++) {
+        telemetryRates[i].isActive = false;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Looks up a message by its telemetry name, e.g. "state"
+ * @param  msgName : Message name, need not be null terminated
+ * @param  msgNameLength : Length of msgName
+ * @param  msgType : Destination message type
+ * @retval FCB_OK if the name was found, else FCB_ERR
+ */
+FcbRetValType GetTelemetryMsgType(const char* msgName, const size_t msgNameLength,
+        enum ProtoMessageTypeEnum* msgType) {
+    uint8_t i;
+
+    for (i = 0; i < TELEMETRY_MSG_NBR; i++) {
+        if (strlen(telemetryMsgs[i].name) == msgNameLength && !strncmp(telemetryMsgs[i].name, msgName, msgNameLength)) {
+            *msgType = telemetryMsgs[i].msgType;
+            return FCB_OK;
+        }
+    }
+
+    return FCB_ERR;
+}
+
+/*
+ * @brief  Sets where the protobuf frames are written, from the next write on
+ * @param  output : TELEMETRY_OUTPUT_COM or TELEMETRY_OUTPUT_USB_LOG
+ * @retval None
+ */
+void SetTelemetryOutput(const TelemetryOutput output) {
+    telemetryOutput = output;
+}
+
+/*
+ * @brief  Encodes the current data of a message as protobuf, for requests that poll it
+ * @param  msgType : Message to encode
+ * @param  dst : Destination buffer
+ * @param  dstSize : Size of dst
+ * @param  encodedSize : Destination for the size of the serialized message
+ * @retval FCB_OK if encoded, FCB_ERR if the message is not a telemetry message or does not fit in dst
+ */
+FcbRetValType EncodeTelemetryMsg(const enum ProtoMessageTypeEnum msgType, uint8_t* dst, const size_t dstSize,
+        size_t* encodedSize) {
+    pb_ostream_t protoStream = pb_ostream_from_buffer(dst, dstSize);
+    uint8_t i;
+
+    /* A delta frame is only decoded after the frames before it */
+    if (COMPACT_SAMPLES_MSG_ENUM == msgType) {
+        return FCB_ERR;
+    }
+
+    for (i = 0; i < TELEMETRY_MSG_NBR; i++) {
+        if (telemetryMsgs[i].msgType == msgType) {
+            if (!telemetryMsgs[i].encode(&protoStream)) {
+                return FCB_ERR;
+            }
+            *encodedSize = protoStream.bytes_written;
+            return FCB_OK;
+        }
+    }
+
+    return FCB_ERR;
+}
+
+/*
+ * @brief  Sets the decimals that a group of the compact sample fields is quantized to, from the next keyframe on
+ * @param  groupName : Group name, e.g. "gyro", or "all", need not be null terminated
+ * @param  groupNameLength : Length of groupName
+ * @param  decimals : Decimals, at most COMPACT_MAX_DECIMALS
+ * @retval FCB_OK if set, FCB_ERR if the group or decimals are invalid
+ */
+FcbRetValType SetCompactPrecision(const char* groupName, const size_t groupNameLength, const uint8_t decimals) {
+    bool isAll = 3 == groupNameLength && !strncmp(groupName, "all", 3);
+    FcbRetValType retVal = FCB_ERR;
+    uint8_t group;
+
+    if (decimals > COMPACT_MAX_DECIMALS) {
+        return FCB_ERR;
+    }
+
+    taskENTER_CRITICAL();
+    for (group = 0; group < COMPACT_GROUP_NBR; group++) {
+        if (isAll || (strlen(compactGroups[group].name) == groupNameLength
+                && !strncmp(compactGroups[group].name, groupName, groupNameLength))) {
+            compactDecimals[group] = decimals;
+            retVal = FCB_OK;
+        }
+    }
+    isCompactRestarted = isCompactRestarted || FCB_OK == retVal;
+    taskEXIT_CRITICAL();
+
+    return retVal;
+}
+
+/*
+ * @brief  Prints the fields of the compact samples with their decimals and predictors
+ * @param  dst : Destination buffer
+ * @param  dstSize : Size of dst
+ * @retval Length of the printed string
+ */
+size_t PrintCompactPrecision(char* dst, const size_t dstSize) {
+    uint8_t decimals[COMPACT_GROUP_NBR];
+    size_t length = 0;
+    uint8_t group;
+
+    taskENTER_CRITICAL();
+    memcpy(decimals, compactDecimals, sizeof(decimals));
+    taskEXIT_CRITICAL();
+
+    for (group = 0; group < COMPACT_GROUP_NBR && length < dstSize; group++) {
+        length += snprintf(dst + length, dstSize - length, "%s: %u fields, %u decimals, %s prediction\r\n",
+                compactGroups[group].name, compactGroups[group].fieldCount, decimals[group],
+                COMPACT_PREDICT_LINEAR == compactGroups[group].predictor ? "linear" : "previous");
+    }
+
+    return (length < dstSize) ? length : dstSize - 1;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief  Task code samples the messages that are due and sends the MAVLink streams, then sleeps until the next
+ *         message is due or the rate table changes
+ * @param  argument : Unused parameter
+ * @retval None
+ */
+static void TelemetryTask(void const *argument) {
+    (void) argument;
+
+    portTickType now;
+    portTickType delay = portMAX_DELAY;
+    portTickType untilNextSample;
+    portTickType untilNextMavlink;
+    bool isDue;
+    SerializationType serialization;
+    uint8_t i;
+
+    for (;;) {
+        xSemaphoreTake(telemetryWakeSem, delay);
+
+        delay = portMAX_DELAY;
+
+        for (i = 0; i < TELEMETRY_MSG_NBR; i++) {
+            isDue = false;
+
+            taskENTER_CRITICAL();
+            now = xTaskGetTickCount();
+            if (telemetryRates[i].isActive && (int32_t) (now - telemetryRates[i].endTick) >= 0) {
+                telemetryRates[i].isActive = false;
+            }
+            if (telemetryRates[i].isActive) {
+                if ((int32_t) (now - telemetryRates[i].nextSampleTick) >= 0) {
+                    isDue = true;
+                    telemetryRates[i].nextSampleTick += telemetryRates[i].sampleTime;
+
+                    /* Samples missed while the link was busy are skipped, not sent in a burst */
+                    if ((int32_t) (now - telemetryRates[i].nextSampleTick) >= 0) {
+                        telemetryRates[i].nextSampleTick = now + telemetryRates[i].sampleTime;
+                    }
+                }
+                untilNextSample = telemetryRates[i].nextSampleTick - now;
+                if (untilNextSample < delay) {
+                    delay = untilNextSample;
+                }
+            }
+            serialization = telemetryRates[i].serialization;
+            taskEXIT_CRITICAL();
+
+            if (!isDue) {
+                continue;
+            }
+
+            if (PROTOBUFFER_SERIALIZATION == serialization) {
+                AppendFrame(&telemetryMsgs[i]);
+            } else {
+                /* Keep the order of the output */
+                FlushFrames();
+                telemetryMsgs[i].print();
+            }
+        }
+
+        FlushFrames();
+
+        untilNextMavlink = MavlinkStreamPoll();
+        if (untilNextMavlink < delay) {
+            delay = untilNextMavlink;
+        }
+    }
+}
+
+/*
+ * @brief  Encodes a message frame straight into the pack buffer, after writing the whole packets of the buffer if the
+ *         frame does not fit
+ * @param  msg : Message to encode
+ * @retval None
+ */
+static void AppendFrame(const TelemetryMsg_TypeDef* msg) {
+    ProtoFrameStream_TypeDef frame;
+    size_t frameLength;
+    bool isEncoded;
+    uint8_t tries;
+
+    /* Make room by writing the whole packets first, then the rest of the buffer. The message is encoded again. */
+    for (tries = 0; tries < 3; tries++) {
+        ProtoFrameBegin(&frame, &telemetryPackBuffer[telemetryPackLength],
+                TELEMETRY_PACK_BUFFER_SIZE - telemetryPackLength, msg->msgType);
+        isEncoded = msg->encode(&frame.stream);
+        frameLength = ProtoFrameEnd(&frame);
+
+        if (isEncoded && frameLength > 0) {
+            /* Nothing to report, e.g. no summary window completed since the last one, leaves the frame out */
+            if (frame.stream.bytes_written > 0) {
+                telemetryPackLength += frameLength;
+            }
+            return;
+        }
+
+        if (0 == tries) {
+            FlushPackets();
+        } else {
+            FlushFrames();
+        }
+    }
+
+    /* The frame is larger than the pack buffer */
+    ErrorHandler();
+}
+
+/*
+ * @brief  Writes the packed frames to the telemetry output in one write
+ * @param  None
+ * @retval None
+ */
+static void FlushFrames(void) {
+    if (telemetryPackLength > 0) {
+        WriteFrames(telemetryPackBuffer, telemetryPackLength);
+        telemetryPackLength = 0;
+    }
+}
+
+/*
+ * @brief  Writes the whole USB packets of the packed frames to the telemetry output and keeps the rest in the pack
+ *         buffer. Frames may span packets, the host splits the stream at the frame delimiters.
+ * @param  None
+ * @retval None
+ */
+static void FlushPackets(void) {
+    uint16_t packetsLength = telemetryPackLength - (telemetryPackLength % TELEMETRY_PACKET_SIZE);
+
+    if (0 == packetsLength) {
+        return;
+    }
+
+    WriteFrames(telemetryPackBuffer, packetsLength);
+    telemetryPackLength -= packetsLength;
+    memmove(telemetryPackBuffer, &telemetryPackBuffer[packetsLength], telemetryPackLength);
+}
+
+/*
+ * @brief  Writes packed frames to the telemetry output. The com port waits for room, the log endpoint drops the data
+ *         if the host does not keep up.
+ * @param  data : Packed frames
+ * @param  size : Size of data
+ * @retval None
+ */
+static void WriteFrames(const uint8_t* data, const uint16_t size) {
+    if (TELEMETRY_OUTPUT_USB_LOG == telemetryOutput) {
+        USBLogSendData(data, size);
+    } else {
+        USBComSendData(data, size);
+    }
+}
+
+/*
+ * @brief  Encodes the latest sensor samples
+ * @param  stream : Destination stream
+ * @retval true if encoded, false if the stream is too small
+ */
+static bool EncodeSensorSamples(pb_ostream_t* stream) {
+    SensorSamplesProto sensorProto;
+    float32_t accX, accY, accZ, gyroX, gyroY, gyroZ, magX, magY, magZ;
+
+    GetAcceleration(&accX, &accY, &accZ);
+    GetGyroAngleDot(&gyroX, &gyroY, &gyroZ);
+    GetMagVector(&magX, &magY, &magZ);
+
+    sensorProto.has_accX = true;
+    sensorProto.has_accY = true;
+    sensorProto.has_accZ = true;
+    sensorProto.has_gyroX = true;
+    sensorProto.has_gyroY = true;
+    sensorProto.has_gyroZ = true;
+    sensorProto.has_magX = true;
+    sensorProto.has_magY = true;
+    sensorProto.has_magZ = true;
+    sensorProto.accX = accX;
+    sensorProto.accY = accY;
+    sensorProto.accZ = accZ;
+    sensorProto.gyroX = gyroX;
+    sensorProto.gyroY = gyroY;
+    sensorProto.gyroZ = gyroZ;
+    sensorProto.magX = magX;
+    sensorProto.magY = magY;
+    sensorProto.magZ = magZ;
+
+    return pb_encode(stream, SensorSamplesProto_fields, &sensorProto);
+}
+
+/*
+ * @brief  Encodes the estimated attitude states
+ * @param  stream : Destination stream
+ * @retval true if encoded, false if the stream is too small
+ */
+static bool EncodeFlightStates(pb_ostream_t* stream) {
+    FlightStatesProto stateValuesProto;
+    StateSnapshotType snapshot;
+
+    memset(&stateValuesProto, 0, sizeof(stateValuesProto)); // No position and velocity estimates
+    GetStateSnapshot(&snapshot);
+
+    stateValuesProto.has_rollAngle = true;
+    stateValuesProto.rollAngle = snapshot.angle[ROLL_IDX];
+    stateValuesProto.has_pitchAngle = true;
+    stateValuesProto.pitchAngle = snapshot.angle[PITCH_IDX];
+    stateValuesProto.has_yawAngle = true;
+    stateValuesProto.yawAngle = snapshot.angle[YAW_IDX];
+    stateValuesProto.has_rollRate = true;
+    stateValuesProto.rollRate = snapshot.angleRateUnbiased[ROLL_IDX];
+    stateValuesProto.has_pitchRate = true;
+    stateValuesProto.pitchRate = snapshot.angleRateUnbiased[PITCH_IDX];
+    stateValuesProto.has_yawRate = true;
+    stateValuesProto.yawRate = snapshot.angleRateUnbiased[YAW_IDX];
+
+    return pb_encode(stream, FlightStatesProto_fields, &stateValuesProto);
+}
+
+/*
+ * @brief  Encodes the flight control reference signals
+ * @param  stream : Destination stream
+ * @retval true if encoded, false if the stream is too small
+ */
+static bool EncodeRefSignals(pb_ostream_t* stream) {
+    ControlReferenceSignalsProto refValuesProto;
+
+    refValuesProto.has_refRoll = true;
+    refValuesProto.refRoll = GetRollAngleReferenceSignal();
+    refValuesProto.has_refPitch = true;
+    refValuesProto.refPitch = GetPitchAngleReferenceSignal();
+    refValuesProto.has_refYaw = true;
+    refValuesProto.refYaw = GetYawAngleReferenceSignal();
+    refValuesProto.has_refYawRate = true;
+    refValuesProto.refYawRate = GetYawAngularRateReferenceSignal();
+
+    return pb_encode(stream, ControlReferenceSignalsProto_fields, &refValuesProto);
+}
+
+/*
+ * @brief  Encodes the flight control signals
+ * @param  stream : Destination stream
+ * @retval true if encoded, false if the stream is too small
+ */
+static bool EncodeCtrlSignals(pb_ostream_t* stream) {
+    ControlSignalsProto ctrlValuesProto;
+
+    ctrlValuesProto.has_ctrlState = true;
+    ctrlValuesProto.ctrlState = GetFlightControlMode();
+    ctrlValuesProto.has_thrustCtrl = true;
+    ctrlValuesProto.thrustCtrl = GetThrustControlSignal();
+    ctrlValuesProto.has_rollCtrl = true;
+    ctrlValuesProto.rollCtrl = GetRollControlSignal();
+    ctrlValuesProto.has_pitchCtrl = true;
+    ctrlValuesProto.pitchCtrl = GetPitchControlSignal();
+    ctrlValuesProto.has_yawCtrl = true;
+    ctrlValuesProto.yawCtrl = GetYawControlSignal();
+
+    return pb_encode(stream, ControlSignalsProto_fields, &ctrlValuesProto);
+}
+
+/*
+ * @brief  Encodes the motor output values
+ * @param  stream : Destination stream
+ * @retval true if encoded, false if the stream is too small
+ */
+static bool EncodeMotorValues(pb_ostream_t* stream) {
+    MotorSignalValuesProto motorSignalValuesProto;
+
+    motorSignalValuesProto.has_M1 = true;
+    motorSignalValuesProto.has_M2 = true;
+    motorSignalValuesProto.has_M3 = true;
+    motorSignalValuesProto.has_M4 = true;
+    motorSignalValuesProto.M1 = GetMotorValue(1);
+    motorSignalValuesProto.M2 = GetMotorValue(2);
+    motorSignalValuesProto.M3 = GetMotorValue(3);
+    motorSignalValuesProto.M4 = GetMotorValue(4);
+
+    return pb_encode(stream, MotorSignalValuesProto_fields, &motorSignalValuesProto);
+}
+
+/*
+ * @brief  Encodes the sensor, state and motor samples as a compact codec frame, see compact_codec.h. The codec
+ *         history only advances if the frame fits in the stream, as the frame is encoded again after a flush.
+ * @param  stream : Destination stream
+ * @retval true if encoded, false if the stream is too small
+ */
+static bool EncodeCompactSamples(pb_ostream_t* stream) {
+    float32_t values[COMPACT_SAMPLES_FIELD_NBR];
+    uint8_t formats[COMPACT_SAMPLES_FIELD_NBR];
+    StateSnapshotType snapshot;
+    size_t room, frameSize;
+    uint8_t group, i, field = 0;
+
+    if (isCompactRestarted) {
+        taskENTER_CRITICAL();
+        for (group = 0; group < COMPACT_GROUP_NBR; group++) {
+            for (i = 0; i < compactGroups[group].fieldCount; i++) {
+                formats[field++] = COMPACT_FIELD_FORMAT(compactDecimals[group], compactGroups[group].predictor);
+            }
+        }
+        isCompactRestarted = false;
+        taskEXIT_CRITICAL();
+
+        if (FCB_OK != CompactCodecSetFormats(&compactEncoder, COMPACT_SAMPLES_FIELD_NBR, formats)) {
+            ErrorHandler();
+        }
+    }
+
+    GetGyroAngleDot(&values[0], &values[1], &values[2]);
+    GetAcceleration(&values[3], &values[4], &values[5]);
+    GetMagVector(&values[6], &values[7], &values[8]);
+    GetStateSnapshot(&snapshot);
+    values[9] = snapshot.angle[ROLL_IDX];
+    values[10] = snapshot.angle[PITCH_IDX];
+    values[11] = snapshot.angle[YAW_IDX];
+    values[12] = snapshot.angleRateUnbiased[ROLL_IDX];
+    values[13] = snapshot.angleRateUnbiased[PITCH_IDX];
+    values[14] = snapshot.angleRateUnbiased[YAW_IDX];
+    for (i = 0; i < 4; i++) {
+        values[15 + i] = (float32_t) GetMotorValue(i + 1);
+    }
+
+    room = stream->max_size - stream->bytes_written;
+    if (room > sizeof(compactFrame)) {
+        room = sizeof(compactFrame);
+    }
+
+    frameSize = CompactEncodeFrame(&compactEncoder, values, (uint32_t) GetMicroseconds(), compactFrame, room);
+
+    return frameSize > 0 && pb_write(stream, compactFrame, frameSize);
+}
+
+/*
+ * @brief  Encodes the receiver channel values
+ * @param  stream : Destination stream
+ * @retval true if encoded, false if the stream is too small
+ */
+static bool EncodeReceiverValues(pb_ostream_t* stream) {
+    ReceiverSignalValuesProto receiverSignalsProto;
+    Receiver_Snapshot_TypeDef receiverSnapshot;
+
+    /* One snapshot, so that all channels are from the same RC frame */
+    GetReceiverSnapshot(&receiverSnapshot);
+
+    receiverSignalsProto.has_is_active = true;
+    receiverSignalsProto.has_throttle = true;
+    receiverSignalsProto.has_aileron = true;
+    receiverSignalsProto.has_elevator = true;
+    receiverSignalsProto.has_rudder = true;
+    receiverSignalsProto.has_gear = true;
+    receiverSignalsProto.has_aux1 = true;
+    receiverSignalsProto.is_active = receiverSnapshot.IsActive;
+    receiverSignalsProto.throttle = receiverSnapshot.Throttle;
+    receiverSignalsProto.aileron = receiverSnapshot.Aileron;
+    receiverSignalsProto.elevator = receiverSnapshot.Elevator;
+    receiverSignalsProto.rudder = receiverSnapshot.Rudder;
+    receiverSignalsProto.gear = receiverSnapshot.Gear;
+    receiverSignalsProto.aux1 = receiverSnapshot.Aux1;
+
+    return pb_encode(stream, ReceiverSignalValuesProto_fields, &receiverSignalsProto);
+}
+
+/*
+ * @brief  Encodes the signal summaries completed since they were last sent, as many as fit in the stream. The rest
+ *         are sent the next time.
+ * @param  stream : Destination stream
+ * @retval true if encoded, false if the stream is too small
+ */
+static bool EncodeSignalSummaries(pb_ostream_t* stream) {
+    AggregateSummary_TypeDef summary;
+    uint8_t signal;
+
+    for (signal = 0; signal < AGGREGATE_SIGNAL_NBR; signal++) {
+        if (stream->max_size - stream->bytes_written < AGGREGATE_SUMMARY_MAX_SIZE) {
+            break;
+        }
+        if (!GetAggregateSummary((AggregateSignal_TypeDef) signal, &summary)
+                || summary.window + 1 == sentSummaryWindows[signal]) {
+            continue;
+        }
+        if (!EncodeSignalSummary(stream, (AggregateSignal_TypeDef) signal, &summary)) {
+            return false;
+        }
+        sentSummaryWindows[signal] = summary.window + 1;
+    }
+
+    return true;
+}
+
+/*
+ * @brief  Encodes a signal summary as a SignalSummaryProto submessage, see telemetry_aggregate.h. There is no
+ *         generated code for it, the fields are written with the nanopb encoding primitives.
+ * @param  stream : Destination stream
+ * @param  signal : Summarized signal
+ * @param  summary : Summary to encode
+ * @retval true if encoded, false if the stream is too small
+ */
+static bool EncodeSignalSummary(pb_ostream_t* stream, const AggregateSignal_TypeDef signal,
+        const AggregateSummary_TypeDef* summary) {
+    uint8_t summaryBuffer[AGGREGATE_SUMMARY_MAX_SIZE];
+    pb_ostream_t summaryStream = pb_ostream_from_buffer(summaryBuffer, sizeof(summaryBuffer));
+
+    if (!pb_encode_tag(&summaryStream, PB_WT_VARINT, 1) || !pb_encode_varint(&summaryStream, signal)
+            || !pb_encode_tag(&summaryStream, PB_WT_VARINT, 2) || !pb_encode_varint(&summaryStream, summary->window)
+            || !pb_encode_tag(&summaryStream, PB_WT_VARINT, 3) || !pb_encode_varint(&summaryStream, summary->count)
+            || !pb_encode_tag(&summaryStream, PB_WT_32BIT, 4) || !pb_encode_fixed32(&summaryStream, &summary->min)
+            || !pb_encode_tag(&summaryStream, PB_WT_32BIT, 5) || !pb_encode_fixed32(&summaryStream, &summary->max)
+            || !pb_encode_tag(&summaryStream, PB_WT_32BIT, 6) || !pb_encode_fixed32(&summaryStream, &summary->mean)
+            || !pb_encode_tag(&summaryStream, PB_WT_32BIT, 7) || !pb_encode_fixed32(&summaryStream, &summary->rms)) {
+        return false;
+    }
+
+    /* Field 1 of SignalSummariesProto, length delimited */
+    return pb_encode_tag(stream, PB_WT_STRING, 1)
+            && pb_encode_string(stream, summaryBuffer, summaryStream.bytes_written);
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
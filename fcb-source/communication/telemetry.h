@@ -0,0 +1,56 @@
+/******************************************************************************
+ * @brief   Header file for the telemetry scheduler, which samples the flight
+ *          data messages at their configured rates from one task
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TELEMETRY_H
+#define __TELEMETRY_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "communication.h"
+#include "fcb_retval.h"
+
+#include <stddef.h>
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Where the protobuf frames are written, the text messages are printed to the com port */
+typedef enum {
+    TELEMETRY_OUTPUT_COM = 0,       // USB com port, along with the CLI replies
+    TELEMETRY_OUTPUT_USB_LOG        // USB log endpoint, data that does not fit is dropped
+} TelemetryOutput;
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Frames are packed into writes of at most this size */
+#define TELEMETRY_PACK_BUFFER_SIZE      256
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+void CreateTelemetryTask(void);
+FcbRetValType StartTelemetry(const enum ProtoMessageTypeEnum msgType, const SerializationType serialization,
+        const uint16_t sampleTime, const uint32_t sampleDuration);
+FcbRetValType StopTelemetry(const enum ProtoMessageTypeEnum msgType);
+void StartAllTelemetry(const uint32_t sampleDuration);
+void StopAllTelemetry(void);
+FcbRetValType GetTelemetryMsgType(const char* msgName, const size_t msgNameLength,
+        enum ProtoMessageTypeEnum* msgType);
+void SetTelemetryOutput(const TelemetryOutput output);
+FcbRetValType EncodeTelemetryMsg(const enum ProtoMessageTypeEnum msgType, uint8_t* dst, const size_t dstSize,
+        size_t* encodedSize);
+FcbRetValType SetCompactPrecision(const char* groupName, const size_t groupNameLength, const uint8_t decimals);
+size_t PrintCompactPrecision(char* dst, const size_t dstSize);
+
+#endif /* __TELEMETRY_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,231 @@
+/*****************************************************************************
+ * @brief   Telemetry aggregation. The sensor and control paths pass every
+ *          sample of the aggregated signals in, and each signal with a window
+ *          size set keeps running min, max, sum and sum of squares until the
+ *          window is full. The summary of the window is then published for
+ *          the telemetry task, which sends it as a compact protobuf message;
+ *          at a 1 kHz gyroscope rate and a window of 100 samples, the three
+ *          axes need about 1 kB/s instead of a frame per sample.
+ *          A signal's accumulator is used by the task sampling it only, the
+ *          published summaries are guarded by short critical sections.
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "telemetry_aggregate.h"
+
+#include "fast_math.h"
+#include "ccm_ram.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Window being collected, used by the sampling task only */
+typedef struct {
+    uint16_t windowSize;            // Size of this window, 0 if none is collected
+    uint16_t count;
+    float32_t min;
+    float32_t max;
+    float32_t sum;
+    float32_t sumOfSquares;
+    uint32_t completedWindows;
+} AggregateAccumulator_TypeDef;
+
+/* Signals configured together from the CLI */
+typedef struct {
+    const char* name;
+    AggregateSignal_TypeDef firstSignal;
+    uint8_t nbrOfSignals;
+} AggregateGroup_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+#define AGGREGATE_GROUP_NBR             (sizeof(aggregateGroups)/sizeof(aggregateGroups[0]))
+
+/* Private variables ---------------------------------------------------------*/
+
+static const AggregateGroup_TypeDef aggregateGroups[] = {
+    { "gyro", AGGREGATE_GYRO_X, 3 },
+    { "acc", AGGREGATE_ACC_X, 3 },
+    { "motor", AGGREGATE_MOTOR_1, 4 },
+    { "ctrl", AGGREGATE_CTRL_THRUST, 4 },
+    { "vibration", AGGREGATE_VIBRATION_GYRO, 3 },
+    { "battery", AGGREGATE_BATTERY_VOLTAGE, 3 },
+    { "pidscale", AGGREGATE_PID_THROTTLE_SCALE, 2 },
+    { "all", AGGREGATE_GYRO_X, AGGREGATE_SIGNAL_NBR },
+};
+
+/* Window sizes set from the CLI, picked up by the sampling task when it starts a window. 0 disables a signal. */
+static volatile uint16_t windowSizes[AGGREGATE_SIGNAL_NBR];
+
+/* Updated with every sample on the sensor and control paths, in the CCM SRAM with FCB_CCM_RAM */
+static AggregateAccumulator_TypeDef accumulators[AGGREGATE_SIGNAL_NBR] CCM_RAM;
+
+/* Published summaries, written and read in critical sections */
+static AggregateSummary_TypeDef summaries[AGGREGATE_SIGNAL_NBR];
+static bool summaryValid[AGGREGATE_SIGNAL_NBR];
+
+/* Private function prototypes -----------------------------------------------*/
+static void CompleteWindow(const AggregateSignal_TypeDef signal);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Adds a sample to the window of a signal. Only to be called by the task sampling the signal.
+ * @param  signal : Sampled signal
+ * @param  value : Sample value
+ * @retval None
+ */
+void AggregateSample(const AggregateSignal_TypeDef signal, const float32_t value) {
+    AggregateAccumulator_TypeDef* acc = &accumulators[signal];
+
+    if (0 == acc->count) {
+        acc->windowSize = windowSizes[signal];
+        if (0 == acc->windowSize) {
+            return;
+        }
+        acc->min = value;
+        acc->max = value;
+        acc->sum = 0.0f;
+        acc->sumOfSquares = 0.0f;
+    }
+
+    if (value < acc->min) {
+        acc->min = value;
+    } else if (value > acc->max) {
+        acc->max = value;
+    }
+    acc->sum += value;
+    acc->sumOfSquares += value * value;
+
+    if (++acc->count >= acc->windowSize) {
+        CompleteWindow(signal);
+    }
+}
+
+/*
+ * @brief  Adds samples of consecutive signals, e.g. the axes of a sensor sample
+ * @param  firstSignal : Signal of values[0]
+ * @param  values : Sample values
+ * @param  nbrOfValues : Number of values
+ * @retval None
+ */
+void AggregateSamples(const AggregateSignal_TypeDef firstSignal, const float32_t* values, const uint8_t nbrOfValues) {
+    uint8_t i;
+
+    for (i = 0; i < nbrOfValues; i++) {
+        AggregateSample((AggregateSignal_TypeDef) (firstSignal + i), values[i]);
+    }
+}
+
+/*
+ * @brief  Sets the window size of a signal. The window being collected keeps its size.
+ * @param  signal : Signal to configure
+ * @param  windowSize : Number of samples per summary [1, AGGREGATE_MAX_WINDOW_SIZE], 0 disables the signal
+ * @retval FCB_OK if set, else FCB_ERR
+ */
+FcbRetValType SetAggregateWindowSize(const AggregateSignal_TypeDef signal, const uint16_t windowSize) {
+    if (signal >= AGGREGATE_SIGNAL_NBR || windowSize > AGGREGATE_MAX_WINDOW_SIZE) {
+        return FCB_ERR;
+    }
+
+    windowSizes[signal] = windowSize;
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Sets the window size of a group of signals, e.g. "gyro"
+ * @param  groupName : Group name (gyro, acc, motor, ctrl, vibration or all), need not be null terminated
+ * @param  groupNameLength : Length of groupName
+ * @param  windowSize : Number of samples per summary [1, AGGREGATE_MAX_WINDOW_SIZE], 0 disables the signals
+ * @retval FCB_OK if set, FCB_ERR if the group was not found or the size is out of range
+ */
+FcbRetValType SetAggregateGroupWindowSize(const char* groupName, const size_t groupNameLength,
+        const uint16_t windowSize) {
+    uint8_t i, j;
+
+    if (windowSize > AGGREGATE_MAX_WINDOW_SIZE) {
+        return FCB_ERR;
+    }
+
+    for (i = 0; i < AGGREGATE_GROUP_NBR; i++) {
+        if (strlen(aggregateGroups[i].name) == groupNameLength
+                && !strncmp(aggregateGroups[i].name, groupName, groupNameLength)) {
+            for (j = 0; j < aggregateGroups[i].nbrOfSignals; j++) {
+                windowSizes[aggregateGroups[i].firstSignal + j] = windowSize;
+            }
+            return FCB_OK;
+        }
+    }
+
+    return FCB_ERR;
+}
+
+/*
+ * @brief  Gets the window size of a signal
+ * @param  signal : Signal
+ * @retval Number of samples per summary, 0 if the signal is disabled
+ */
+uint16_t GetAggregateWindowSize(const AggregateSignal_TypeDef signal) {
+    return (signal < AGGREGATE_SIGNAL_NBR) ? windowSizes[signal] : 0;
+}
+
+/*
+ * @brief  Gets the summary of the last completed window of a signal
+ * @param  signal : Signal
+ * @param  summary : Destination summary
+ * @retval true if the signal is enabled and has completed a window, else false
+ */
+bool GetAggregateSummary(const AggregateSignal_TypeDef signal, AggregateSummary_TypeDef* summary) {
+    bool isValid;
+
+    if (signal >= AGGREGATE_SIGNAL_NBR || 0 == windowSizes[signal]) {
+        return false;
+    }
+
+    taskENTER_CRITICAL();
+    isValid = summaryValid[signal];
+    *summary = summaries[signal];
+    taskEXIT_CRITICAL();
+
+    return isValid;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Publishes the summary of the full window of a signal and starts the next one
+ * @param  signal : Signal
+ * @retval None
+ */
+static void CompleteWindow(const AggregateSignal_TypeDef signal) {
+    AggregateAccumulator_TypeDef* acc = &accumulators[signal];
+    AggregateSummary_TypeDef summary;
+
+    summary.window = acc->completedWindows++;
+    summary.count = acc->count;
+    summary.min = acc->min;
+    summary.max = acc->max;
+    summary.mean = acc->sum / acc->count;
+    summary.rms = FastSqrtf(acc->sumOfSquares / acc->count);
+
+    acc->count = 0;
+
+    taskENTER_CRITICAL();
+    summaries[signal] = summary;
+    summaryValid[signal] = true;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,99 @@
+/******************************************************************************
+ * @brief   Header file for the telemetry aggregation, which summarizes high
+ *          rate signals over windows of samples (min, max, mean and RMS) for
+ *          links too slow to carry every sample
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TELEMETRY_AGGREGATE_H
+#define __TELEMETRY_AGGREGATE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "fcb_retval.h"
+#include "arm_math.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Aggregated signals. Each one is sampled by one task only, noted per group. */
+typedef enum {
+    AGGREGATE_GYRO_X = 0,           // [rad/s] SENSORS task, every gyroscope sample
+    AGGREGATE_GYRO_Y,
+    AGGREGATE_GYRO_Z,
+    AGGREGATE_ACC_X,                // [m/s^2] SENSORS task, every accelerometer sample
+    AGGREGATE_ACC_Y,
+    AGGREGATE_ACC_Z,
+    AGGREGATE_MOTOR_1,              // [0, 65535] Flight control task, every motor output
+    AGGREGATE_MOTOR_2,
+    AGGREGATE_MOTOR_3,
+    AGGREGATE_MOTOR_4,
+    AGGREGATE_CTRL_THRUST,          // [N] Flight control task, every PID control update
+    AGGREGATE_CTRL_ROLL,            // [Nm]
+    AGGREGATE_CTRL_PITCH,           // [Nm]
+    AGGREGATE_CTRL_YAW,             // [Nm]
+    AGGREGATE_VIBRATION_GYRO,       // [rad/s] SENSORS task, every accelerometer sample, see fcb_vibration_monitor.h
+    AGGREGATE_VIBRATION_ACC,        // [m/s^2]
+    AGGREGATE_SENSOR_HEALTH,        // [0, 100] lower health score of the gyroscope and accelerometer
+    AGGREGATE_BATTERY_VOLTAGE,      // [V] Flight control task, every battery update, see fcb_battery.h
+    AGGREGATE_BATTERY_CURRENT,      // [A]
+    AGGREGATE_BATTERY_CONSUMED,     // [mAh]
+    AGGREGATE_PID_THROTTLE_SCALE,   // Flight control task, every gain schedule evaluation, see PID_USE_GAIN_SCHEDULING
+    AGGREGATE_PID_BATTERY_SCALE,
+    AGGREGATE_SIGNAL_NBR
+} AggregateSignal_TypeDef;
+
+/* Summary of the last completed window of a signal */
+typedef struct {
+    uint32_t window;                // Number of windows completed before this one
+    uint16_t count;                 // Number of samples in the window
+    float32_t min;
+    float32_t max;
+    float32_t mean;
+    float32_t rms;
+} AggregateSummary_TypeDef;
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Window sizes are limited so that the float32 sums keep the mean and RMS accurate */
+#define AGGREGATE_MAX_WINDOW_SIZE       4096
+
+/* The SIGNAL_SUMMARY_MSG_ENUM message, encoded without generated nanopb code:
+ *   message SignalSummariesProto { repeated SignalSummaryProto summaries = 1; }
+ *   message SignalSummaryProto {
+ *     optional uint32 signal = 1;  // AggregateSignal_TypeDef
+ *     optional uint32 window = 2;
+ *     optional uint32 count = 3;
+ *     optional float min = 4;
+ *     optional float max = 5;
+ *     optional float mean = 6;
+ *     optional float rms = 7;
+ *   }
+ * Each completed window is sent once, the summaries that do not fit follow in the next message. */
+
+/* Worst case size of one summary in the message: field tags, length, varints and floats */
+#define AGGREGATE_SUMMARY_MAX_SIZE      (2 + 2 + 6 + 4 + 4*5)
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+void AggregateSample(const AggregateSignal_TypeDef signal, const float32_t value);
+void AggregateSamples(const AggregateSignal_TypeDef firstSignal, const float32_t* values, const uint8_t nbrOfValues);
+FcbRetValType SetAggregateWindowSize(const AggregateSignal_TypeDef signal, const uint16_t windowSize);
+FcbRetValType SetAggregateGroupWindowSize(const char* groupName, const size_t groupNameLength,
+        const uint16_t windowSize);
+uint16_t GetAggregateWindowSize(const AggregateSignal_TypeDef signal);
+bool GetAggregateSummary(const AggregateSignal_TypeDef signal, AggregateSummary_TypeDef* summary);
+
+#endif /* __TELEMETRY_AGGREGATE_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,353 @@
+/*****************************************************************************
+ * @brief   Host clock synchronisation, see time_sync.h. Each exchange gives
+ *          a sample of the host clock offset, the mean of the offsets seen by
+ *          the request and the response, which is exact if both take equally
+ *          long, and the round trip, which bounds the error of the sample. The
+ *          clock filter keeps the latest TIME_SYNC_FILTER_SAMPLES samples and
+ *          passes on the one of the shortest round trip. An alpha-beta filter
+ *          then tracks the offset and its rate, the drift, from the residuals
+ *          of the passed samples against the extrapolated estimate.
+ *          The samples are fed by the RX work item that handles the requests,
+ *          the estimate is read by any task with the scheduler suspended.
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "time_sync.h"
+
+#include "common.h"
+#include "fixed_format.h"
+#include "deferred_log.h"
+#include "fcb_port.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Sample of the host clock of an exchange */
+typedef struct {
+    uint64_t time;                  // FCB time midway between receiving the request and responding [us]
+    int64_t offset;                 // Host time less FCB time [us]
+    uint32_t delay;                 // Round trip less the FCB handling [us]
+} TimeSyncSample_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Clock filter and the exchange being completed, used by the RX work item that handles the requests only */
+static TimeSyncSample_TypeDef filterSamples[TIME_SYNC_FILTER_SAMPLES];
+static uint8_t filterCount = 0;
+static uint8_t filterNext = 0;
+static uint64_t lastUsedSampleTime = 0;
+static uint8_t samplesSinceStep = 0;
+static float32_t residualJitter = 0.0f;     // [us]
+static uint64_t pendingHostSendTime = 0;
+static uint64_t pendingReceiveTime = 0;
+static uint64_t pendingResponseTime = 0;
+
+/* Estimate, written by the RX work item with the scheduler suspended. The state is the one of the latest sample, see
+ * GetTimeSyncStatus() for the one of the current time. */
+static TimeSyncStatusType syncStatus = { TIME_SYNC_NONE, 0, 0.0f, 0, 0, 0, 0, 0, 0, 0 };
+
+static const char* const timeSyncStateNames[TIME_SYNC_STATE_NBR] = { "none", "acquiring", "synced", "lost" };
+
+/* Private function prototypes -----------------------------------------------*/
+static void AddTimeSyncSample(const uint64_t hostSendTime, const uint64_t receiveTime, const uint64_t responseTime,
+        const uint64_t hostReceiveTime);
+static void UpdateTimeSyncEstimate(const TimeSyncSample_TypeDef* sample);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Stamps the response to a RPC_TIME_SYNC request and feeds the exchange that the request completes, the
+ *         previous one, to the clock filter
+ * @param  request : Request payload, see TIME_SYNC_REQUEST_SIZE
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the TIME_SYNC_RESPONSE_SIZE bytes of the response payload
+ * @retval FCB_OK if handled, FCB_ERR if the request size is invalid
+ */
+FcbRetValType TimeSyncHandleRequest(const uint8_t* request, const uint8_t requestSize, uint8_t* response) {
+    uint64_t receiveTime = GetMicroseconds();
+    uint64_t hostSendTime, previousHostSendTime, previousHostReceiveTime, responseTime;
+    TimeSyncStatusType status;
+    int32_t driftPpb;
+
+    if (TIME_SYNC_REQUEST_SIZE != requestSize) {
+        return FCB_ERR;
+    }
+
+    memcpy(&hostSendTime, &request[0], 8);
+    memcpy(&previousHostSendTime, &request[8], 8);
+    memcpy(&previousHostReceiveTime, &request[16], 8);
+
+    /* The host stamps the previous request it got the response to, a lost response or request leaves a gap */
+    if (0 != previousHostSendTime && previousHostSendTime == pendingHostSendTime
+            && previousHostReceiveTime >= previousHostSendTime) {
+        AddTimeSyncSample(pendingHostSendTime, pendingReceiveTime, pendingResponseTime, previousHostReceiveTime);
+    }
+
+    FCB_SUSPEND_SCHEDULER();
+    syncStatus.exchanges++;
+    FCB_RESUME_SCHEDULER();
+
+    GetTimeSyncStatus(&status);
+    driftPpb = (int32_t) (status.drift * 1000.0f);
+
+    memcpy(&response[0], &hostSendTime, 8);
+    memcpy(&response[8], &receiveTime, 8);
+    response[24] = (uint8_t) status.state;
+    memcpy(&response[25], &status.offset, 8);
+    memcpy(&response[33], &driftPpb, 4);
+    memcpy(&response[37], &status.uncertainty, 4);
+
+    /* Stamped last, the framing and queueing that follow add to the round trip of the sample */
+    responseTime = GetMicroseconds();
+    memcpy(&response[16], &responseTime, 8);
+
+    pendingHostSendTime = hostSendTime;
+    pendingReceiveTime = receiveTime;
+    pendingResponseTime = responseTime;
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Converts a FCB time to host time, extrapolating the offset with the drift from the latest sample
+ * @param  fcbTime : FCB time, see GetMicroseconds() [us]
+ * @param  hostTime : Destination of the host time [us], not set if there is no estimate
+ * @retval State of the synchronisation, TIME_SYNC_NONE if there is no estimate
+ */
+TimeSyncStateType TimeSyncToHostTime(const uint64_t fcbTime, uint64_t* hostTime) {
+    TimeSyncStatusType status;
+    float32_t elapsed;
+
+    GetTimeSyncStatus(&status);
+    if (TIME_SYNC_NONE == status.state) {
+        return TIME_SYNC_NONE;
+    }
+
+    elapsed = (float32_t) (int64_t) (fcbTime - status.referenceTime);
+    *hostTime = fcbTime + (uint64_t) (status.offset + (int64_t) (status.drift * 1e-6f * elapsed));
+
+    return status.state;
+}
+
+/*
+ * @brief  Gets the estimate, with the state and the uncertainty at the current time
+ * @param  dstStatus : Destination
+ * @retval None
+ */
+void GetTimeSyncStatus(TimeSyncStatusType* dstStatus) {
+    uint64_t now = GetMicroseconds();
+    float32_t holdover;
+
+    FCB_SUSPEND_SCHEDULER();
+    *dstStatus = syncStatus;
+    FCB_RESUME_SCHEDULER();
+
+    if (TIME_SYNC_NONE == dstStatus->state) {
+        dstStatus->uncertainty = UINT32_MAX;
+        return;
+    }
+
+    if (now - dstStatus->referenceTime > (uint64_t) TIME_SYNC_TIMEOUT * 1000) {
+        dstStatus->state = TIME_SYNC_LOST;
+    }
+
+    /* Half the round trip bounds the error of the sample, the drift error grows with the time since */
+    holdover = TIME_SYNC_HOLDOVER_DRIFT * 1e-6f * (float32_t) (now - dstStatus->referenceTime);
+    if (holdover > (float32_t) (UINT32_MAX / 2)) {
+        holdover = (float32_t) (UINT32_MAX / 2);
+    }
+    dstStatus->uncertainty = dstStatus->delay / 2 + dstStatus->jitter + (uint32_t) holdover;
+}
+
+/*
+ * @brief  Gets the name of a synchronisation state
+ * @param  state : Synchronisation state
+ * @retval Name, or "?" for an invalid state
+ */
+const char* GetTimeSyncStateName(const TimeSyncStateType state) {
+    if (state >= TIME_SYNC_STATE_NBR) {
+        return "?";
+    }
+
+    return timeSyncStateNames[state];
+}
+
+size_t PrintTimeSyncStatus(char* dst, const size_t dstSize) {
+    TimeSyncStatusType status;
+    uint64_t offsetMagnitude;
+    size_t length;
+
+    GetTimeSyncStatus(&status);
+
+    length = (size_t) snprintf(dst, dstSize, "\nHost clock synchronisation: %s\n", timeSyncStateNames[status.state]);
+    if (TIME_SYNC_NONE == status.state) {
+        return length;
+    }
+
+    offsetMagnitude = (status.offset < 0) ? (uint64_t) -status.offset : (uint64_t) status.offset;
+    if (length < dstSize) {
+        length += (size_t) snprintf(dst + length, dstSize - length, "Offset: %s%lu.%06lu s\nDrift: ",
+                (status.offset < 0) ? "-" : "", (unsigned long) (offsetMagnitude / 1000000),
+                (unsigned long) (offsetMagnitude % 1000000));
+    }
+    if (length < dstSize) {
+        length += FormatFixed(dst + length, dstSize - length, status.drift, 3);
+    }
+    if (length < dstSize) {
+        length += (size_t) snprintf(dst + length, dstSize - length, " ppm\nUncertainty: %lu us, round trip: %lu us, "
+                "jitter: %lu us\nExchanges: %lu, samples: %lu, clock steps: %lu\n", (unsigned long) status.uncertainty,
+                (unsigned long) status.delay, (unsigned long) status.jitter, (unsigned long) status.exchanges,
+                (unsigned long) status.samples, (unsigned long) status.steps);
+    }
+
+    return length;
+}
+
+/*
+ * @brief  Encodes the current FCB time, its host time and the estimate: 1 FCB time [us], 2 host time [us], 3 state,
+ *         4 offset [us] (sint64), 5 drift [ppb] (sint32), 6 uncertainty [us], 7 round trip [us], 8 samples. The host
+ *         times of the frames packed alongside, which are sampled at the same tick, follow from fields 1 and 2.
+ * @param  stream : Destination stream
+ * @retval true if encoded, false if the stream is too small
+ */
+bool EncodeTimeSync(pb_ostream_t* stream) {
+    TimeSyncStatusType status;
+    uint64_t fcbTime = GetMicroseconds();
+    uint64_t hostTime = 0;
+
+    TimeSyncToHostTime(fcbTime, &hostTime);
+    GetTimeSyncStatus(&status);
+
+    return pb_encode_tag(stream, PB_WT_VARINT, 1) && pb_encode_varint(stream, fcbTime)
+            && pb_encode_tag(stream, PB_WT_VARINT, 2) && pb_encode_varint(stream, hostTime)
+            && pb_encode_tag(stream, PB_WT_VARINT, 3) && pb_encode_varint(stream, status.state)
+            && pb_encode_tag(stream, PB_WT_VARINT, 4) && pb_encode_svarint(stream, status.offset)
+            && pb_encode_tag(stream, PB_WT_VARINT, 5) && pb_encode_svarint(stream, (int64_t) (status.drift * 1000.0f))
+            && pb_encode_tag(stream, PB_WT_VARINT, 6) && pb_encode_varint(stream, status.uncertainty)
+            && pb_encode_tag(stream, PB_WT_VARINT, 7) && pb_encode_varint(stream, status.delay)
+            && pb_encode_tag(stream, PB_WT_VARINT, 8) && pb_encode_varint(stream, status.samples);
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Adds the sample of a complete exchange to the clock filter, and updates the estimate with the sample of the
+ *         shortest round trip in the filter if it has not been used yet
+ * @param  hostSendTime : Host time of sending the request [us]
+ * @param  receiveTime : FCB time of receiving it [us]
+ * @param  responseTime : FCB time of responding [us]
+ * @param  hostReceiveTime : Host time of receiving the response [us]
+ * @retval None
+ */
+static void AddTimeSyncSample(const uint64_t hostSendTime, const uint64_t receiveTime, const uint64_t responseTime,
+        const uint64_t hostReceiveTime) {
+    const TimeSyncSample_TypeDef* best;
+    int64_t delay;
+    uint8_t i;
+
+    /* The differences of the times of one clock are exact, the offset is taken from differences of two */
+    delay = (int64_t) (hostReceiveTime - hostSendTime) - (int64_t) (responseTime - receiveTime);
+    if (delay < 0 || delay > UINT32_MAX) {
+        return;
+    }
+
+    filterSamples[filterNext].time = receiveTime + (responseTime - receiveTime) / 2;
+    filterSamples[filterNext].offset = ((int64_t) (hostSendTime - receiveTime)
+            + (int64_t) (hostReceiveTime - responseTime)) / 2;
+    filterSamples[filterNext].delay = (uint32_t) delay;
+    filterNext = (filterNext + 1) % TIME_SYNC_FILTER_SAMPLES;
+    if (filterCount < TIME_SYNC_FILTER_SAMPLES) {
+        filterCount++;
+    }
+
+    best = &filterSamples[0];
+    for (i = 1; i < filterCount; i++) {
+        if (filterSamples[i].delay < best->delay) {
+            best = &filterSamples[i];
+        }
+    }
+
+    /* Samples older than the one used last would take the estimate back in time */
+    if (best->time > lastUsedSampleTime) {
+        lastUsedSampleTime = best->time;
+        UpdateTimeSyncEstimate(best);
+    }
+}
+
+/*
+ * @brief  Updates the offset and drift estimate with a sample, or restarts it from the sample at the first one or if
+ *         the host clock stepped
+ * @param  sample : Sample passed by the clock filter
+ * @retval None
+ */
+static void UpdateTimeSyncEstimate(const TimeSyncSample_TypeDef* sample) {
+    TimeSyncStatusType estimate = syncStatus; // Only written by this task
+    float32_t elapsed, residual;
+    int64_t predicted;
+
+    if (samplesSinceStep > 0) {
+        elapsed = (float32_t) (int64_t) (sample->time - estimate.referenceTime);
+        predicted = estimate.offset + (int64_t) (estimate.drift * 1e-6f * elapsed);
+        residual = (float32_t) (sample->offset - predicted);
+
+        if (fabsf(residual) > (float32_t) TIME_SYNC_STEP_THRESHOLD) {
+            /* Start over with the filter holding this sample only, the older ones are of the old host clock */
+            LOG1("WARNING: Host clock stepped by %lu ms, time sync restarted", (uint32_t) (fabsf(residual) / 1000.0f));
+            filterSamples[0] = *sample;
+            filterCount = 1;
+            filterNext = 1 % TIME_SYNC_FILTER_SAMPLES;
+            estimate.steps++;
+            samplesSinceStep = 0;
+        } else {
+            estimate.offset = predicted + (int64_t) (TIME_SYNC_OFFSET_GAIN * residual);
+            estimate.drift += TIME_SYNC_DRIFT_GAIN * residual / elapsed * 1e6f;
+            if (estimate.drift > TIME_SYNC_MAX_DRIFT) {
+                estimate.drift = TIME_SYNC_MAX_DRIFT;
+            } else if (estimate.drift < -TIME_SYNC_MAX_DRIFT) {
+                estimate.drift = -TIME_SYNC_MAX_DRIFT;
+            }
+            residualJitter += (fabsf(residual) - residualJitter) / TIME_SYNC_FILTER_SAMPLES;
+        }
+    }
+
+    if (0 == samplesSinceStep) {
+        estimate.offset = sample->offset;
+        estimate.drift = 0.0f;
+        residualJitter = 0.0f;
+    }
+
+    if (samplesSinceStep < UINT8_MAX) {
+        samplesSinceStep++;
+    }
+    estimate.state = (samplesSinceStep >= TIME_SYNC_MIN_SAMPLES) ? TIME_SYNC_SYNCED : TIME_SYNC_ACQUIRING;
+    if (TIME_SYNC_SYNCED == estimate.state && TIME_SYNC_SYNCED != syncStatus.state) {
+        LOG1("Host clock synchronised, round trip %lu us", sample->delay);
+    }
+    estimate.referenceTime = sample->time;
+    estimate.delay = sample->delay;
+    estimate.jitter = (uint32_t) residualJitter;
+    estimate.samples++;
+
+    FCB_SUSPEND_SCHEDULER();
+    estimate.exchanges = syncStatus.exchanges;
+    syncStatus = estimate;
+    FCB_RESUME_SCHEDULER();
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,114 @@
+/******************************************************************************
+ * @brief   Header file for the host clock synchronisation. The host sends
+ *          RPC_TIME_SYNC requests, NTP-like pings stamped with its clock, and
+ *          the FCB stamps their reception and response with its microsecond
+ *          clock. From the four times of each exchange the FCB estimates the
+ *          offset and the drift of the host clock, so that its timestamps are
+ *          converted to host time, e.g. to align the flight data with video,
+ *          motion capture or FMS logs. The telemetry carries the estimate and
+ *          its quality as the TIME_SYNC_MSG_ENUM message, which also maps the
+ *          frames packed alongside it to host time.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TIME_SYNC_H
+#define __TIME_SYNC_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "arm_math.h"
+#include "fcb_retval.h"
+#include "pb_encode.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Exported types ------------------------------------------------------------*/
+
+typedef enum {
+    TIME_SYNC_NONE = 0,             // No exchange yet, host times are not available
+    TIME_SYNC_ACQUIRING,            // Fewer than TIME_SYNC_MIN_SAMPLES samples since the start or a clock step
+    TIME_SYNC_SYNCED,
+    TIME_SYNC_LOST,                 // No sample for TIME_SYNC_TIMEOUT, host times are extrapolated with the drift
+    TIME_SYNC_STATE_NBR
+} TimeSyncStateType;
+
+typedef struct {
+    TimeSyncStateType state;
+    int64_t offset;                 // Host time less FCB time at referenceTime [us]
+    float32_t drift;                // Host clock rate less the FCB clock rate [ppm]
+    uint64_t referenceTime;         // FCB time of the latest sample the estimate was updated with [us]
+    uint32_t uncertainty;           // Bound of the host time error at the current time [us]
+    uint32_t delay;                 // Round trip of the latest sample the estimate was updated with [us]
+    uint32_t jitter;                // Mean absolute offset residual [us]
+    uint32_t exchanges;             // Requests since startup
+    uint32_t samples;               // Samples the estimate was updated with since startup
+    uint32_t steps;                 // Times the estimate was restarted for a host clock step
+} TimeSyncStatusType;
+
+/* Exported constants --------------------------------------------------------*/
+
+/* RPC_TIME_SYNC request: host time of sending it [us] (8), host time of sending the previous request [us] (8), host
+ * time of receiving its response [us] (8). The last two are 0 for the first request. The four times of an exchange are
+ * thereby only complete with the next request, which gives the FCB its sample.
+ * Response: host time of the request (8), FCB time of receiving it [us] (8), FCB time of responding [us] (8), then the
+ * estimate: state (1), offset [us] (8, signed), drift [ppb] (4, signed), uncertainty [us] (4). */
+#define TIME_SYNC_REQUEST_SIZE          (3*8)
+#define TIME_SYNC_RESPONSE_SIZE         (3*8 + 1 + 8 + 4 + 4)
+
+/* Samples of the clock filter. The estimate is updated with the one of the shortest round trip, the one that the
+ * queueing in the USB or UART stacks delayed the least, if it is newer than the previous one used. */
+#define TIME_SYNC_FILTER_SAMPLES        8
+
+/* Gains of the offset and drift (alpha-beta) filter on the offset residual of a sample */
+#define TIME_SYNC_OFFSET_GAIN           ((float32_t) 0.3)
+#define TIME_SYNC_DRIFT_GAIN            ((float32_t) 0.05)
+
+#define TIME_SYNC_MIN_SAMPLES           4       // Samples before the state is TIME_SYNC_SYNCED
+#define TIME_SYNC_TIMEOUT               10000   // [ms] Without a sample before the state is TIME_SYNC_LOST
+#define TIME_SYNC_STEP_THRESHOLD        50000   // [us] Offset residual taken as a host clock step, restarts the estimate
+#define TIME_SYNC_MAX_DRIFT             ((float32_t) 500.0) // [ppm] Crystal clocks are well within this
+#define TIME_SYNC_HOLDOVER_DRIFT        ((float32_t) 10.0)  // [ppm] Drift error assumed when extrapolating
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+
+/**
+ * Stamps the response to a RPC_TIME_SYNC request and feeds the exchange it
+ * completes to the clock filter. Called by the RPC channel.
+ *
+ * @param request see TIME_SYNC_REQUEST_SIZE
+ * @param requestSize TIME_SYNC_REQUEST_SIZE
+ * @param response destination of TIME_SYNC_RESPONSE_SIZE bytes
+ * @return FCB_OK, FCB_ERR if the request is invalid
+ */
+FcbRetValType TimeSyncHandleRequest(const uint8_t* request, const uint8_t requestSize, uint8_t* response);
+
+/**
+ * Converts a FCB time to host time with the offset and the drift estimate.
+ * Not to be called from ISRs.
+ *
+ * @param fcbTime FCB time, see GetMicroseconds() [us]
+ * @param hostTime destination of the host time [us]
+ * @return the synchronisation state, hostTime is only set if it is not
+ *         TIME_SYNC_NONE
+ */
+TimeSyncStateType TimeSyncToHostTime(const uint64_t fcbTime, uint64_t* hostTime);
+
+void GetTimeSyncStatus(TimeSyncStatusType* dstStatus);
+const char* GetTimeSyncStateName(const TimeSyncStateType state);
+size_t PrintTimeSyncStatus(char* dst, const size_t dstSize);
+bool EncodeTimeSync(pb_ostream_t* stream);
+
+#endif /* __TIME_SYNC_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
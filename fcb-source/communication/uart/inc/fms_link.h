@@ -0,0 +1,119 @@
+/*****************************************************************************
+ * @brief   Header file for the binary FMS (flight management system) setpoint
+ *          link, which shares the UART with the text CLI. The FMS streams
+ *          setpoints in, which autonomous mode follows while they are newer
+ *          than FMS_SETPOINT_TIMEOUT, and the FCB streams its state out every
+ *          FMS_STATE_PERIOD once the FMS has been heard from. The state
+ *          frames take the priority path of the UART, so the CLI output
+ *          delays them by one TX chunk at most, see UartSendPriorityData().
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __FMS_LINK_H
+#define __FMS_LINK_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "flight_control.h"
+
+#include <stdbool.h>
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    FMS_LINK_ERROR = 0, FMS_LINK_OK = !FMS_LINK_ERROR
+} FmsLinkStatus;
+
+/* Frame types */
+typedef enum {
+    FMS_SETPOINT_MSG = 1,
+    FMS_FLIGHT_MODE_MSG = 2,        // Sent by the FCB, see FmsFlightModeStatus_TypeDef
+    FMS_STATE_MSG = 3               // Sent by the FCB, see FmsState_TypeDef
+} FmsLinkMsgType;
+
+/* Setpoint frame payload, sent little endian without padding */
+typedef struct {
+    uint32_t sequence;              // Incremented by the FMS for every setpoint
+    uint32_t fmsTimestamp;          // FMS time the setpoint was computed [us]
+    RefSignals_TypeDef refSignals;  // Attitude, yaw rate and vertical velocity targets
+} FmsSetpoint_TypeDef;
+
+/* Flight mode frame payload, sent little endian without padding on every flight mode transition and rejected request */
+typedef struct {
+    uint32_t timestamp;             // FCB time of the latest transition or rejection [ms]
+    uint32_t rejections;            // Rejected requests since startup
+    uint8_t state;                  // See FlightModeStateType
+    uint8_t previousState;
+    uint8_t rejectedState;          // Latest rejected request, of the current state only
+    uint8_t rejectReason;           // See FlightModeRejectType, FLIGHT_MODE_REJECT_NONE if none
+} FmsFlightModeStatus_TypeDef;
+
+/* State frame payload, sent little endian without padding every FMS_STATE_PERIOD */
+typedef struct {
+    uint32_t sequence;              // Incremented by the FCB for every state frame
+    uint32_t timestamp;             // FCB time of the states [us], see time_sync.h for the host time
+    uint32_t setpointFmsTimestamp;  // FMS time of the latest accepted setpoint [us], for the round trip
+    float32_t attitude[4];          // Quaternion w, x, y, z of the body attitude in the NED frame
+    float32_t bodyRates[3];         // Unbiased roll, pitch and yaw rates [rad/s]
+    float32_t zPosition;            // [m] positive downwards, minus the barometric altitude
+    float32_t zVelocity;            // [m/s] positive downwards
+    uint16_t health;                // FMS_STATE_HEALTH_* bits
+    uint8_t flightMode;             // See FlightModeStateType
+    uint8_t batteryStatus;          // See FcbBatteryStatusType, BATTERY_NOT_CONNECTED without a battery monitor
+} FmsState_TypeDef;
+
+typedef struct {
+    uint32_t framesReceived;        // Setpoints accepted
+    uint32_t frameErrors;           // Frames dropped because of a CRC mismatch, an invalid header, invalid values or
+                                    // a timeout
+    uint32_t sequenceErrors;        // Setpoints dropped because they were older than the latest one
+    uint32_t setpointsLost;         // Sequence numbers skipped between accepted setpoints
+    uint32_t lastSequence;          // Sequence number of the latest setpoint
+    uint32_t lastFmsTimestamp;      // FMS time of the latest setpoint [us]
+    uint32_t lastRxTick;            // RTOS tick the latest setpoint was received
+    uint32_t statesSent;            // State frames queued on the priority path
+    uint32_t statesDropped;         // State frames that found the previous one still being sent
+} FmsLinkStats_TypeDef;
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Frame: SYNC_1 SYNC_2 type length payload CRC-16 (CCITT, over type, length and payload, little endian). The sync
+ * bytes are outside the 7-bit range of the CLI, so every other byte is passed on to it untouched. */
+#define FMS_LINK_SYNC_BYTE_1            0xA5
+#define FMS_LINK_SYNC_BYTE_2            0xD7
+#define FMS_LINK_MAX_PAYLOAD_SIZE       32
+
+/* Max gap between the bytes of a frame, a longer one drops it. A frame takes a few ms at 115200 baud. */
+#define FMS_LINK_RX_TIMEOUT             20  // [ms]
+
+/* The FMS setpoints are followed in autonomous mode only while they are newer than this */
+#define FMS_SETPOINT_TIMEOUT            100 // [ms]
+
+/* The state frames take 58 bytes, a quarter of the link at 115200 baud */
+#define FMS_STATE_PERIOD                20  // [ms]
+
+/* FmsState_TypeDef health bits */
+#define FMS_STATE_HEALTH_RECEIVER       0x0001 // The RC receiver is active
+#define FMS_STATE_HEALTH_ESTIMATOR      0x0002 // The state estimation has converged
+#define FMS_STATE_HEALTH_SENSORS        0x0004 // All sensors give samples within their watchdog timeouts
+#define FMS_STATE_HEALTH_SETPOINT       0x0008 // A setpoint has been accepted within FMS_SETPOINT_TIMEOUT
+#define FMS_STATE_HEALTH_PREARM         0x0010 // All pre-arm checks passed, see prearm_checks.h
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+bool FmsLinkHandleRxByte(const uint8_t rxByte);
+FmsLinkStatus GetFmsSetpoint(FmsSetpoint_TypeDef* dstSetpoint, const uint32_t maxAgeMs);
+void GetFmsLinkStats(FmsLinkStats_TypeDef* dstStats);
+FmsLinkStatus FmsLinkSendFlightModeStatus(const FmsFlightModeStatus_TypeDef* status);
+void FmsLinkUpdateState(void);
+
+#endif /* __FMS_LINK_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
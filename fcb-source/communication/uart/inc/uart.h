@@ -14,6 +14,11 @@ typedef enum {
     UART_FAIL = 0, UART_OK = !UART_FAIL
 } UartStatus;
 
+/* Settings stored in flash */
+typedef struct {
+    uint32_t baudRate;
+} UartSettings_TypeDef;
+
 /* Exported constants --------------------------------------------------------*/
 
 /* Definition for USARTx clock resources */
@@ -35,18 +40,25 @@ typedef enum {
 #define UART_TX_DMA_STREAM            	DMA1_Channel7
 #define UART_RX_DMA_STREAM              DMA1_Channel6
 
-/* Definition for UART's NVIC */
+/* Definition for UART's NVIC, the RX DMA and the UART idle line interrupts hand received data to the parsers */
+#define UART_IRQn                       USART2_IRQn
+#define UART_IRQHandler                 USART2_IRQHandler
 #define UART_DMA_TX_IRQn               	DMA1_Channel7_IRQn
 #define UART_DMA_RX_IRQn                DMA1_Channel6_IRQn
 #define UART_DMA_TX_IRQHandler          DMA1_Channel7_IRQHandler
 #define UART_DMA_RX_IRQHandler          DMA1_Channel6_IRQHandler
 
-/* UART Setup values */
+/* UART Setup values, the baud rate is the default until another one has been saved to flash */
 #define UART_BAUDRATE					115200
+#define UART_MIN_BAUDRATE               9600
+#define UART_MAX_BAUDRATE               2000000     // 36 MHz APB1 clock / 16 is 2.25 Mbaud
 #define UART_WORDLENGTH					UART_WORDLENGTH_8B
 #define UART_STOPBITS					UART_STOPBITS_1
 #define UART_PARITY						UART_PARITY_NONE
 
+/* Largest frame of UartSendPriorityData() */
+#define UART_PRIORITY_TX_SIZE           64
+
 #define UART_FORCE_RESET()             __USART2_FORCE_RESET()
 #define UART_RELEASE_RESET()           __USART2_RELEASE_RESET()
 
@@ -54,17 +66,23 @@ typedef enum {
 UART_HandleTypeDef UartHandle;
 
 /* Exported macro ------------------------------------------------------------*/
+#define IS_UART_LINK_BAUDRATE(BAUDRATE) ((BAUDRATE) >= UART_MIN_BAUDRATE && (BAUDRATE) <= UART_MAX_BAUDRATE)
 
 /* Exported functions ------------------------------------------------------- */
 void UartConfig(void);
 void CreateUARTComTasks(void);
-void CreateUARTComQueues(void);
 void CreateUARTComSemaphores(void);
 UartStatus UartSendData(const uint8_t* sendData, const uint16_t sendDataSize);
+UartStatus UartSendStaticData(const uint8_t* sendData, const uint16_t sendDataSize);
+UartStatus UartSendPriorityData(const uint8_t* sendData, const uint16_t sendDataSize);
 UartStatus UartSendString(const char* sendString);
-void HandleUartRxCallback(UART_HandleTypeDef* UartHandle);
-void HandleUartTxCallback(UART_HandleTypeDef* UartHandle);
+void UartIRQHandler(void);
+void UartDmaRxIRQHandler(void);
+void UartDmaTxIRQHandler(void);
 void HandleUartErrorCallback(UART_HandleTypeDef* UartHandle);
+UartStatus SetUartBaudRate(const uint32_t baudRate);
+uint32_t GetUartBaudRate(void);
+UartStatus SaveUartSettings(void);
 
 #endif /* __UART_H */
 
@@ -0,0 +1,428 @@
+/*****************************************************************************
+ * @brief   Binary FMS (flight management system) setpoint link. Frames are
+ *          parsed byte by byte in the UART receive interrupt, ahead of the
+ *          CLI receive buffer, so that a setpoint is available to the flight
+ *          control task as soon as its last byte has arrived. The state
+ *          frames are built by the flight control, right after the states of
+ *          its cycle have been published.
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "fms_link.h"
+#include "uart.h"
+#include "communication.h"
+#include "state_estimation.h"
+#include "flight_mode.h"
+#include "receiver.h"
+#include "fcb_sensors.h"
+#include "fcb_sensor_watchdog.h"
+#include "fcb_battery.h"
+#include "prearm_checks.h"
+#include "deferred_log.h"
+#include "common.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+#include <math.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef enum {
+    FMS_RX_WAIT_SYNC_1 = 0,
+    FMS_RX_WAIT_SYNC_2,
+    FMS_RX_TYPE,
+    FMS_RX_LENGTH,
+    FMS_RX_PAYLOAD,
+    FMS_RX_CRC_LOW,
+    FMS_RX_CRC_HIGH
+} FmsRxState;
+
+/* Private define ------------------------------------------------------------*/
+#define FMS_LINK_CRC_INIT           0xFFFF
+#define FMS_LINK_CRC_POLY           0x1021
+#define FMS_LINK_HEADER_SIZE        4 // Sync bytes, type and length
+#define FMS_LINK_CRC_SIZE           2
+
+#define FMS_STATE_FRAME_SIZE        (FMS_LINK_HEADER_SIZE + sizeof(FmsState_TypeDef) + FMS_LINK_CRC_SIZE)
+
+_Static_assert(FMS_STATE_FRAME_SIZE <= UART_PRIORITY_TX_SIZE, "The FMS state frame does not fit the UART priority frame");
+_Static_assert(sizeof(FmsState_TypeDef) == 52, "The FMS state frame payload has padding");
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Frame parser state, used by the UART receive interrupt only */
+static FmsRxState rxState = FMS_RX_WAIT_SYNC_1;
+static uint8_t rxType;
+static uint8_t rxLength;
+static uint8_t rxCount;
+static uint16_t rxCrc;
+static uint16_t rxFrameCrc;
+static uint8_t rxPayload[FMS_LINK_MAX_PAYLOAD_SIZE];
+static portTickType rxByteTick;
+static LogRateLimit_TypeDef frameErrorLog;
+
+/* Latest setpoint, written by the UART receive interrupt and read in critical sections */
+static FmsSetpoint_TypeDef fmsSetpoint;
+static FmsLinkStats_TypeDef fmsLinkStats;
+
+/* State stream, used by the flight control only */
+static uint32_t stateSequence = 0;
+static portTickType lastStateTick = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+static uint16_t UpdateCrc(uint16_t crc, const uint8_t data);
+static uint16_t BuildFrame(uint8_t* dst, const FmsLinkMsgType type, const void* payload, const uint8_t payloadSize);
+static void GetStateQuaternion(float32_t* dstQuaternion, const float32_t* angles);
+static void HandleFrame(void);
+static void DropFrame(const char* reason);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Feeds a received UART byte to the frame parser. Called from the UART receive interrupt.
+ * @param  rxByte : Received byte
+ * @retval true if the byte belongs to a binary frame, false if it should be passed on to the CLI
+ */
+bool FmsLinkHandleRxByte(const uint8_t rxByte) {
+    portTickType now = xTaskGetTickCountFromISR();
+
+    /* A frame cut short by a lost byte would otherwise take the following bytes, e.g. of a CLI line or of the next
+     * frame */
+    if (FMS_RX_WAIT_SYNC_1 != rxState && FMS_RX_WAIT_SYNC_2 != rxState
+            && now - rxByteTick > FMS_LINK_RX_TIMEOUT / portTICK_RATE_MS) {
+        DropFrame("timeout");
+        rxState = FMS_RX_WAIT_SYNC_1;
+    }
+    rxByteTick = now;
+
+    switch (rxState) {
+    case FMS_RX_WAIT_SYNC_1:
+        if (FMS_LINK_SYNC_BYTE_1 != rxByte) {
+            return false;
+        }
+        rxState = FMS_RX_WAIT_SYNC_2;
+        break;
+
+    case FMS_RX_WAIT_SYNC_2:
+        if (FMS_LINK_SYNC_BYTE_2 == rxByte) {
+            rxCrc = FMS_LINK_CRC_INIT;
+            rxState = FMS_RX_TYPE;
+        } else if (FMS_LINK_SYNC_BYTE_1 != rxByte) {
+            rxState = FMS_RX_WAIT_SYNC_1;
+            return false;
+        }
+        break;
+
+    case FMS_RX_TYPE:
+        rxType = rxByte;
+        rxCrc = UpdateCrc(rxCrc, rxByte);
+        rxState = FMS_RX_LENGTH;
+        break;
+
+    case FMS_RX_LENGTH:
+        rxLength = rxByte;
+        rxCount = 0;
+        rxCrc = UpdateCrc(rxCrc, rxByte);
+        if (rxLength > FMS_LINK_MAX_PAYLOAD_SIZE) {
+            DropFrame("invalid length");
+            rxState = FMS_RX_WAIT_SYNC_1;
+        } else {
+            rxState = (rxLength > 0) ? FMS_RX_PAYLOAD : FMS_RX_CRC_LOW;
+        }
+        break;
+
+    case FMS_RX_PAYLOAD:
+        rxPayload[rxCount++] = rxByte;
+        rxCrc = UpdateCrc(rxCrc, rxByte);
+        if (rxCount >= rxLength) {
+            rxState = FMS_RX_CRC_LOW;
+        }
+        break;
+
+    case FMS_RX_CRC_LOW:
+        rxFrameCrc = rxByte;
+        rxState = FMS_RX_CRC_HIGH;
+        break;
+
+    case FMS_RX_CRC_HIGH:
+        rxFrameCrc |= (uint16_t) rxByte << 8;
+        if (COM_CHECKSUM_MATCH(rxFrameCrc, rxCrc)) {
+            HandleFrame();
+        } else {
+            DropFrame("CRC mismatch");
+        }
+        rxState = FMS_RX_WAIT_SYNC_1;
+        break;
+
+    default:
+        rxState = FMS_RX_WAIT_SYNC_1;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * @brief  Gets the latest FMS setpoint, if it is recent enough to be followed
+ * @param  dstSetpoint : Destination setpoint
+ * @param  maxAgeMs : Max time since the setpoint was received [ms]
+ * @retval FMS_LINK_OK if a recent setpoint was copied, else FMS_LINK_ERROR
+ */
+FmsLinkStatus GetFmsSetpoint(FmsSetpoint_TypeDef* dstSetpoint, const uint32_t maxAgeMs) {
+    FmsLinkStatus status = FMS_LINK_ERROR;
+
+    taskENTER_CRITICAL();
+    if (fmsLinkStats.framesReceived > 0
+            && (xTaskGetTickCount() - fmsLinkStats.lastRxTick) <= maxAgeMs/portTICK_RATE_MS) {
+        *dstSetpoint = fmsSetpoint;
+        status = FMS_LINK_OK;
+    }
+    taskEXIT_CRITICAL();
+
+    return status;
+}
+
+/*
+ * @brief  Gets a consistent copy of the link statistics
+ * @param  dstStats : Destination statistics
+ * @retval None
+ */
+void GetFmsLinkStats(FmsLinkStats_TypeDef* dstStats) {
+    taskENTER_CRITICAL();
+    *dstStats = fmsLinkStats;
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Sends the flight mode status to the FMS, once it has sent a setpoint. The frame shares the UART with the CLI
+ *         output, which it is told apart from by the sync bytes. Task context only, waits for room in the UART buffer.
+ * @param  status : Status to send
+ * @retval FMS_LINK_OK if the frame was queued, else FMS_LINK_ERROR, also if no FMS has been heard from
+ */
+FmsLinkStatus FmsLinkSendFlightModeStatus(const FmsFlightModeStatus_TypeDef* status) {
+    uint8_t frame[FMS_LINK_HEADER_SIZE + sizeof(FmsFlightModeStatus_TypeDef) + FMS_LINK_CRC_SIZE];
+    uint32_t framesReceived;
+
+    taskENTER_CRITICAL();
+    framesReceived = fmsLinkStats.framesReceived;
+    taskEXIT_CRITICAL();
+
+    /* A terminal on the UART would only show the frames as noise */
+    if (0 == framesReceived) {
+        return FMS_LINK_ERROR;
+    }
+
+    if (UART_OK != UartSendData(frame, BuildFrame(frame, FMS_FLIGHT_MODE_MSG, status,
+            sizeof(FmsFlightModeStatus_TypeDef)))) {
+        return FMS_LINK_ERROR;
+    }
+
+    return FMS_LINK_OK;
+}
+
+/*
+ * @brief  Sends the state to the FMS every FMS_STATE_PERIOD, once it has sent a setpoint. Called by the flight control
+ *         after every control cycle, the frame is sent on the UART priority path and never waits.
+ * @param  None
+ * @retval None
+ */
+void FmsLinkUpdateState(void) {
+    uint8_t frame[FMS_STATE_FRAME_SIZE];
+    FmsState_TypeDef state;
+    StateSnapshotType snapshot;
+    portTickType const tick = xTaskGetTickCount();
+    FmsLinkStats_TypeDef stats;
+    uint32_t stateAge;
+    uint8_t sensor;
+
+    if (tick - lastStateTick < FMS_STATE_PERIOD/portTICK_RATE_MS) {
+        return;
+    }
+
+    GetFmsLinkStats(&stats);
+    if (0 == stats.framesReceived) {
+        return;
+    }
+    lastStateTick = tick;
+
+    /* The snapshot is of the latest prediction, its FCB time is the current time less its age */
+    GetStateSnapshot(&snapshot);
+    stateAge = (GetTimestamp() - snapshot.timestamp) / (SystemCoreClock / 1000000);
+
+    state.sequence = ++stateSequence;
+    state.timestamp = (uint32_t) GetMicroseconds() - stateAge;
+    state.setpointFmsTimestamp = stats.lastFmsTimestamp;
+    GetStateQuaternion(state.attitude, snapshot.angle);
+    memcpy(state.bodyRates, snapshot.angleRateUnbiased, sizeof(state.bodyRates));
+    state.zPosition = snapshot.zPosition;
+    state.zVelocity = snapshot.zVelocity;
+    state.flightMode = (uint8_t) GetFlightModeState();
+#ifdef FCB_BATTERY_MONITOR
+    state.batteryStatus = (uint8_t) GetBatteryStatus();
+#else
+    state.batteryStatus = (uint8_t) BATTERY_NOT_CONNECTED;
+#endif
+
+    state.health = 0;
+    if (RECEIVER_OK == IsReceiverActive()) {
+        state.health |= FMS_STATE_HEALTH_RECEIVER;
+    }
+    if (IsStateEstimationConverged()) {
+        state.health |= FMS_STATE_HEALTH_ESTIMATOR;
+    }
+    state.health |= FMS_STATE_HEALTH_SENSORS;
+    for (sensor = 0; sensor < FCB_SENSOR_NBR; sensor++) {
+        if (!IsSensorHealthy((FcbSensorIndexType) sensor)) {
+            state.health &= ~FMS_STATE_HEALTH_SENSORS;
+        }
+    }
+    if ((tick - stats.lastRxTick) <= FMS_SETPOINT_TIMEOUT/portTICK_RATE_MS) {
+        state.health |= FMS_STATE_HEALTH_SETPOINT;
+    }
+    if (0 == GetPreArmFailures()) {
+        state.health |= FMS_STATE_HEALTH_PREARM;
+    }
+
+    /* Counted by the flight control only, the interrupt writes the other counters */
+    if (UART_OK == UartSendPriorityData(frame, BuildFrame(frame, FMS_STATE_MSG, &state, sizeof(state)))) {
+        fmsLinkStats.statesSent++;
+    } else {
+        fmsLinkStats.statesDropped++;
+    }
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Updates a CRC-16 (CCITT) with one byte
+ * @param  crc : CRC so far
+ * @param  data : Next byte
+ * @retval Updated CRC
+ */
+static uint16_t UpdateCrc(uint16_t crc, const uint8_t data) {
+    uint8_t i;
+
+    crc ^= (uint16_t) data << 8;
+    for (i = 0; i < 8; i++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ FMS_LINK_CRC_POLY : crc << 1;
+    }
+
+    return crc;
+}
+
+/*
+ * @brief  Builds a frame of a payload
+ * @param  dst : Destination, of FMS_LINK_HEADER_SIZE + payloadSize + FMS_LINK_CRC_SIZE bytes
+ * @param  type : Frame type
+ * @param  payload : Payload, little endian without padding
+ * @param  payloadSize : Size of the payload
+ * @retval Size of the frame
+ */
+static uint16_t BuildFrame(uint8_t* dst, const FmsLinkMsgType type, const void* payload, const uint8_t payloadSize) {
+    uint16_t crc = FMS_LINK_CRC_INIT;
+    uint16_t i;
+
+    dst[0] = FMS_LINK_SYNC_BYTE_1;
+    dst[1] = FMS_LINK_SYNC_BYTE_2;
+    dst[2] = (uint8_t) type;
+    dst[3] = payloadSize;
+    memcpy(&dst[FMS_LINK_HEADER_SIZE], payload, payloadSize);
+    for (i = 2; i < FMS_LINK_HEADER_SIZE + payloadSize; i++) {
+        crc = UpdateCrc(crc, dst[i]);
+    }
+    dst[i] = (uint8_t) crc;
+    dst[i + 1] = (uint8_t) (crc >> 8);
+
+    return i + FMS_LINK_CRC_SIZE;
+}
+
+/*
+ * @brief  Converts the roll, pitch and yaw angles (ZYX order) to the attitude quaternion
+ * @param  dstQuaternion : Destination w, x, y, z
+ * @param  angles : Roll, pitch and yaw [rad]
+ * @retval None
+ */
+static void GetStateQuaternion(float32_t* dstQuaternion, const float32_t* angles) {
+    float32_t const cr = arm_cos_f32(0.5f*angles[0]);
+    float32_t const sr = arm_sin_f32(0.5f*angles[0]);
+    float32_t const cp = arm_cos_f32(0.5f*angles[1]);
+    float32_t const sp = arm_sin_f32(0.5f*angles[1]);
+    float32_t const cy = arm_cos_f32(0.5f*angles[2]);
+    float32_t const sy = arm_sin_f32(0.5f*angles[2]);
+
+    dstQuaternion[0] = cr*cp*cy + sr*sp*sy;
+    dstQuaternion[1] = sr*cp*cy - cr*sp*sy;
+    dstQuaternion[2] = cr*sp*cy + sr*cp*sy;
+    dstQuaternion[3] = cr*cp*sy - sr*sp*cy;
+}
+
+/*
+ * @brief  Handles a frame with a valid CRC. Called from the UART receive interrupt.
+ * @param  None
+ * @retval None
+ */
+static void HandleFrame(void) {
+    FmsSetpoint_TypeDef setpoint;
+    portTickType rxTick;
+
+    if (FMS_SETPOINT_MSG != rxType || sizeof(FmsSetpoint_TypeDef) != rxLength) {
+        DropFrame("invalid header");
+        return;
+    }
+
+    /* The Cortex-M4 is little endian, like the frame */
+    memcpy(&setpoint, rxPayload, sizeof(FmsSetpoint_TypeDef));
+
+    /* The flight control limits the references, but cannot limit NaN */
+    if (!isfinite(setpoint.refSignals.zVelocity) || !isfinite(setpoint.refSignals.rollAngle)
+            || !isfinite(setpoint.refSignals.pitchAngle) || !isfinite(setpoint.refSignals.yawAngle)
+            || !isfinite(setpoint.refSignals.yawAngleRate)) {
+        DropFrame("invalid values");
+        return;
+    }
+
+    /* Drop repeated and reordered setpoints, the sequence number may wrap. After a timeout any sequence number is
+     * accepted, so that the link recovers when the FMS restarts. */
+    rxTick = xTaskGetTickCountFromISR();
+    if (fmsLinkStats.framesReceived > 0 && (rxTick - fmsLinkStats.lastRxTick) <= FMS_SETPOINT_TIMEOUT/portTICK_RATE_MS) {
+        if ((int32_t) (setpoint.sequence - fmsLinkStats.lastSequence) <= 0) {
+            fmsLinkStats.sequenceErrors++;
+            return;
+        }
+        fmsLinkStats.setpointsLost += setpoint.sequence - fmsLinkStats.lastSequence - 1;
+    }
+
+    /* Readers copy in critical sections, which mask this interrupt */
+    fmsSetpoint = setpoint;
+    fmsLinkStats.framesReceived++;
+    fmsLinkStats.lastSequence = setpoint.sequence;
+    fmsLinkStats.lastFmsTimestamp = setpoint.fmsTimestamp;
+    fmsLinkStats.lastRxTick = rxTick;
+}
+
+/*
+ * @brief  Counts a dropped frame and logs it, at most once per LOG_RATE_LIMIT_INTERVAL so that line noise cannot
+ *         flood the log. Called from the UART receive interrupt.
+ * @param  reason : Static string, why the frame was dropped
+ * @retval None
+ */
+static void DropFrame(const char* reason) {
+    uint32_t suppressed;
+
+    fmsLinkStats.frameErrors++;
+    if (LogRateLimitPass(&frameErrorLog, LOG_RATE_LIMIT_INTERVAL, &suppressed)) {
+        LOG2("WARNING: FMS link frame dropped, %s, %lu more not logged", reason, suppressed);
+    }
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -1,16 +1,34 @@
 /*****************************************************************************
  * @brief   Module contains UART initialization and handling functions.
+ *          Received bytes are written to a ring buffer by circular DMA. The
+ *          half transfer, transfer complete and idle line interrupts hand the
+ *          bytes received since the previous interrupt to the FMS link parser
+ *          and the CLI receive ring buffer as contiguous spans, so no byte is
+ *          lost between re-arms and a burst costs a few interrupts only. The
+ *          CLI bytes are handled by a work item of the low deferred worker.
+ *          Sent data is copied to a TX ring buffer and described by a chain
+ *          of descriptors, which the TX DMA complete interrupt starts back to
+ *          back without a task in between. It sends the descriptors in
+ *          chunks of UART_TX_CHUNK_SIZE, and a priority frame, the FMS state
+ *          stream, goes ahead of the next chunk, so the CLI output delays it
+ *          by one chunk at most.
  ******************************************************************************/
 
 /* Includes ------------------------------------------------------------------*/
 #include "uart.h"
 
-#include "com_cli.h"
-#include "fifo_buffer.h"
+#include "com_session.h"
+#include "ring_buffer.h"
 #include "fcb_error.h"
+#include "trace_recorder.h"
 #include "communication.h"
+#include "fms_link.h"
+#include "flash.h"
+#include "flight_control.h"
+#include "deferred_work.h"
 
 #include <string.h>
+#include <stdbool.h>
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -19,164 +37,279 @@
 
 /* Private typedef -----------------------------------------------------------*/
 
+/* A span of data to send, in the TX ring buffer or in a static buffer */
+typedef struct {
+    const uint8_t* data;
+    uint16_t size;
+    uint16_t ringBytes;     // TX ring buffer bytes freed when the span is sent, 0 for a static buffer
+} UartTxDescriptor_TypeDef;
+
 /* Private define ------------------------------------------------------------*/
 #define UART_RX_BUFFER_SIZE         512
+#define UART_RX_DMA_BUFFER_SIZE     256 // Half of it is received in 1.3 ms at 2 Mbaud
 #define UART_TX_BUFFER_SIZE         512
 
-#define UART_RX_TASK_PRIO           1
-#define UART_TX_TASK_PRIO           2
+#define UART_TX_DESCRIPTORS         16
 
-#define UART_COM_TX_QUEUE_ITEMS     16
-#define UART_RX_MAX_SEM_COUNT       32
+/* The longest wait of a priority frame behind the chain, 5.6 ms at 115200 and 0.3 ms at 2 Mbaud */
+#define UART_TX_CHUNK_SIZE          64
 
-#define UART_COM_MAX_DELAY          1000 // [ms]
+#define UART_COM_MAX_DELAY          100 // [ms] Max wait for the TX buffer beyond the time to send all of it
 
-/* Private macro -------------------------------------------------------------*/
+/* Time to send a full TX buffer at a baud rate, 10 bits per byte, 512 B take 44 ms at 115200 and 533 ms at 9600 baud */
+#define UART_TX_BUFFER_TIME(BAUDRATE)   ((UART_TX_BUFFER_SIZE*10UL*1000UL) / (BAUDRATE)) // [ms]
 
-/* Private variables ---------------------------------------------------------*/
-uint8_t rxByte = 0;
+/* Session output is queued in pieces, so that a reply longer than the TX buffer streams through it */
+#define UART_SESSION_PIECE_SIZE     (UART_TX_BUFFER_SIZE/4)
 
-/* UART Receive FIFO buffer */
-uint8_t UartRxBufferArray[UART_RX_BUFFER_SIZE];
-volatile FIFOBuffer_TypeDef UartRxFIFOBuffer;
+/* Private macro -------------------------------------------------------------*/
 
-/* UART Transmit FIFO buffer */
-uint8_t UartTxBufferArray[UART_TX_BUFFER_SIZE];
-volatile FIFOBuffer_TypeDef UartTxFIFOBuffer;
+/* Private variables ---------------------------------------------------------*/
+/* Circular DMA ring buffer and the position up to which it has been handled, used by the RX interrupts only */
+static uint8_t uartRxDmaBuffer[UART_RX_DMA_BUFFER_SIZE];
+static uint16_t uartRxReadIndex = 0;
+
+/* UART Receive ring buffer, put by the RX interrupts and got by the RX work item on the low deferred worker */
+static uint8_t uartRxBufferArray[UART_RX_BUFFER_SIZE];
+static RingBuffer_TypeDef uartRxRingBuffer;
+
+/* CLI and RPC session of the UART, run by the RX work item */
+static ComSession_TypeDef uartSession;
+
+/* UART Transmit ring buffer and descriptor chain. The sending tasks put data and add descriptors, after taking
+ * UartTxBufferMutex, and the TX DMA interrupt gets the data of the sent descriptor and starts the next one. */
+static uint8_t uartTxBufferArray[UART_TX_BUFFER_SIZE];
+static RingBuffer_TypeDef uartTxRingBuffer;
+static UartTxDescriptor_TypeDef uartTxDescriptors[UART_TX_DESCRIPTORS];
+static uint8_t uartTxDescriptorHead = 0;
+static uint8_t uartTxDescriptorTail = 0;
+static volatile uint8_t uartTxDescriptorCount = 0;
+static BufferStats_TypeDef uartTxDescriptorStats;
+static volatile bool uartTxActive = false;
+
+/* Bytes of the oldest descriptor sent and in the current transfer, used by the TX DMA interrupt and the starts */
+static uint16_t uartTxDescriptorOffset = 0;
+static uint16_t uartTxChunkSize = 0;
+
+/* Priority frame, copied in by UartSendPriorityData() and sent ahead of the next chunk of the descriptor chain */
+static uint8_t uartTxPriorityBuffer[UART_PRIORITY_TX_SIZE];
+static uint16_t uartTxPrioritySize = 0;
+static volatile bool uartTxPriorityPending = false;
+static volatile bool uartTxPrioritySending = false;
+
+/* Link baud rate, read from flash at start-up */
+static uint32_t uartBaudRate = UART_BAUDRATE;
+
+/* Work item of the UART session, posted by the RX interrupts */
+static DeferredWorkId_TypeDef uartRxWorkId = DEFERRED_WORK_INVALID_ID;
+static bool uartRxStarted = false;
 
 /* UART RTOS variables */
-xTaskHandle UartRxTaskHandle;
-xTaskHandle UartTxTaskHandle;
-
-xQueueHandle UartTxQueue;
-
-xSemaphoreHandle UartRxDataSem;
 xSemaphoreHandle UartTxBufferMutex;
-xSemaphoreHandle UartTxBinarySem;
+xSemaphoreHandle UartTxDoneSem;
 
 /* Private function prototypes -----------------------------------------------*/
-static void InitUartCom(void);
-
-static void UartRxTask(void const *argument);
-static void UartTxTask(void const *argument);
+static void InitUart(void);
+static void ConfigUartTxDma(void);
+static void StartNextUartTx(void);
+static UartStatus QueueUartTx(const uint8_t* data, const uint16_t size, const uint16_t ringBytes);
+static UartStatus WaitUartTxSpace(const uint16_t bufferBytes, const uint8_t descriptors);
+static void StartUartRx(void);
+static void HandleUartRxData(void);
+static bool HandleUartRxSpan(const uint8_t* data, const uint16_t dataSize);
+static FcbRetValType UartSessionSend(const uint8_t* data, const uint16_t size);
+
+static void HandleUartRxWork(void* argument);
 
 /* Exported functions --------------------------------------------------------*/
 
 /*
- * @brief  Initializes and configures UART.
+ * @brief  Initializes the UART ring buffers and configures UART, with the baud rate stored in flash if there is a
+ *         valid one
  * @param  None.
  * @retval None.
  */
 void UartConfig(void) {
-    /*##-1- Configure the UART peripheral ######################################*/
-    /* Put the USART peripheral in the Asynchronous mode (UART Mode) */
-    /* UART configured as defined by header file definitions
-     * Hardware flow control disabled (RTS and CTS signals) */
-    UartHandle.Instance        = UART;
-    UartHandle.Init.BaudRate   = UART_BAUDRATE;
-    UartHandle.Init.WordLength = UART_WORDLENGTH;
-    UartHandle.Init.StopBits   = UART_STOPBITS;
-    UartHandle.Init.Parity     = UART_PARITY;
-    UartHandle.Init.HwFlowCtl  = UART_HWCONTROL_NONE;
-    UartHandle.Init.Mode       = UART_MODE_TX_RX;
+    UartSettings_TypeDef settings;
 
-    if(HAL_UART_DeInit(&UartHandle) != HAL_OK) {
+    if (SUCCESS != RingBufferInit(&uartRxRingBuffer, uartRxBufferArray, sizeof(uartRxBufferArray))
+            || SUCCESS != RingBufferInit(&uartTxRingBuffer, uartTxBufferArray, sizeof(uartTxBufferArray))) {
         ErrorHandler();
     }
-    if(HAL_UART_Init(&UartHandle) != HAL_OK) {
-        ErrorHandler();
+    BufferMonitorRegister("uartRx", sizeof(uartRxBufferArray), &uartRxRingBuffer.stats);
+    BufferMonitorRegister("uartTx", sizeof(uartTxBufferArray), &uartTxRingBuffer.stats);
+    BufferMonitorRegister("uartTxDesc", UART_TX_DESCRIPTORS, &uartTxDescriptorStats);
+    ComSessionInit(&uartSession, &uartRxRingBuffer, UartSessionSend);
+
+    if (FLASH_OK == ReadUartSettingsFromFlash(&settings) && IS_UART_LINK_BAUDRATE(settings.baudRate)) {
+        uartBaudRate = settings.baudRate;
     }
+
+    InitUart();
 }
 
 /*
- * @brief  Handles the UART Rx Callback
+ * @brief  Handles the UART interrupt, which is the idle line after received data
  * @param  None.
  * @retval None.
  */
-void HandleUartRxCallback(UART_HandleTypeDef* UartHandle) {
-    portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+void UartIRQHandler(void) {
+    if (__HAL_UART_GET_FLAG(&UartHandle, UART_FLAG_IDLE)) {
+        __HAL_UART_CLEAR_IT(&UartHandle, UART_CLEAR_IDLEF);
+        HandleUartRxData();
+    }
+}
 
-    (void) UartHandle; // To avoid warnings
+/*
+ * @brief  Handles the UART RX DMA interrupt, which is the half transfer and transfer complete of the ring buffer.
+ *         HAL_DMA_IRQHandler is not used since its transfer complete handling stops the circular reception.
+ * @param  None.
+ * @retval None.
+ */
+void UartDmaRxIRQHandler(void) {
+    DMA_HandleTypeDef* hdma = UartHandle.hdmarx;
 
-    if (FIFOBufferPutByte(&UartRxFIFOBuffer, rxByte) == SUCCESS) {
-        /* # Signal UART RX task that new data has arrived #### */
-        xSemaphoreGiveFromISR(UartRxDataSem, &xHigherPriorityTaskWoken);
-        portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+    if (__HAL_DMA_GET_FLAG(hdma, __HAL_DMA_GET_TE_FLAG_INDEX(hdma))) {
+        __HAL_DMA_CLEAR_FLAG(hdma, __HAL_DMA_GET_TE_FLAG_INDEX(hdma));
+        HandleUartErrorCallback(&UartHandle);
+        return;
+    }
+
+    if (__HAL_DMA_GET_FLAG(hdma, __HAL_DMA_GET_HT_FLAG_INDEX(hdma) | __HAL_DMA_GET_TC_FLAG_INDEX(hdma))) {
+        __HAL_DMA_CLEAR_FLAG(hdma, __HAL_DMA_GET_HT_FLAG_INDEX(hdma) | __HAL_DMA_GET_TC_FLAG_INDEX(hdma));
+        HandleUartRxData();
     }
 }
 
 /*
- * @brief  Handles the UART Tx Callback
+ * @brief  Handles the UART TX DMA interrupt, which is the end of the transfer of a priority frame or of a descriptor
+ *         chunk. The next one is started right away, the UART still shifts out the last byte of the previous one.
  * @param  None.
  * @retval None.
  */
-void HandleUartTxCallback(UART_HandleTypeDef* UartHandle) {
+void UartDmaTxIRQHandler(void) {
     portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+    DMA_HandleTypeDef* hdma = UartHandle.hdmatx;
 
-    (void) UartHandle; // To avoid warnings
+    if (!__HAL_DMA_GET_FLAG(hdma, __HAL_DMA_GET_TC_FLAG_INDEX(hdma) | __HAL_DMA_GET_TE_FLAG_INDEX(hdma))) {
+        return;
+    }
+
+    /* A descriptor that failed with a transfer error is dropped */
+    __HAL_DMA_CLEAR_FLAG(hdma, __HAL_DMA_GET_TC_FLAG_INDEX(hdma) | __HAL_DMA_GET_TE_FLAG_INDEX(hdma));
+
+    if (uartTxPrioritySending) {
+        uartTxPrioritySending = false;
+    } else if (uartTxDescriptorCount > 0) {
+        uartTxDescriptorOffset += uartTxChunkSize;
+        if (uartTxDescriptorOffset >= uartTxDescriptors[uartTxDescriptorTail].size) {
+            RingBufferCommitRead(&uartTxRingBuffer, uartTxDescriptors[uartTxDescriptorTail].ringBytes);
+            uartTxDescriptorTail = (uartTxDescriptorTail + 1) % UART_TX_DESCRIPTORS;
+            uartTxDescriptorCount--;
+            uartTxDescriptorOffset = 0;
+        }
+    }
+    StartNextUartTx();
 
-    xSemaphoreGiveFromISR(UartTxBinarySem, &xHigherPriorityTaskWoken);
+    /* Wake a task that waits for room in the TX buffer */
+    xSemaphoreGiveFromISR(UartTxDoneSem, &xHigherPriorityTaskWoken);
     portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
 
 /*
- * @brief  Handles the UART Rx Callback
+ * @brief  Handles the UART Error Callback
  * @param  None.
  * @retval None.
  */
 void HandleUartErrorCallback(UART_HandleTypeDef* UartHandle) {
-    if(HAL_UART_DeInit(UartHandle) != HAL_OK) {
-        ErrorHandler();
+    (void) UartHandle; // To avoid warnings
+
+    InitUart();
+
+    /* The reinitialization stopped the reception and the transmission */
+    StartUartRx();
+    StartNextUartTx();
+}
+
+/*
+ * @brief  Sets the baud rate of the link, effective after the data queued for sending has been sent
+ * @param  baudRate : Baud rate [UART_MIN_BAUDRATE, UART_MAX_BAUDRATE]
+ * @retval UART_OK if set, UART_FAIL if the baud rate is out of range or the TX buffer did not empty
+ */
+UartStatus SetUartBaudRate(const uint32_t baudRate) {
+    UartStatus result = UART_OK;
+
+    if (!IS_UART_LINK_BAUDRATE(baudRate)) {
+        return UART_FAIL;
     }
-    if(HAL_UART_Init(UartHandle) != HAL_OK) {
-        ErrorHandler();
+
+    if (xSemaphoreTake(UartTxBufferMutex, UART_COM_MAX_DELAY) != pdPASS) {
+        return UART_FAIL;
     }
+
+    if (UART_OK == WaitUartTxSpace(UART_TX_BUFFER_SIZE, UART_TX_DESCRIPTORS)) {
+        /* Let a priority frame started meanwhile and the last byte shift out */
+        while (uartTxActive || !__HAL_UART_GET_FLAG(&UartHandle, UART_FLAG_TC)) {
+        }
+
+        /* The UART interrupts are enabled again by the reinitialization */
+        HAL_NVIC_DisableIRQ(UART_IRQn);
+        HAL_NVIC_DisableIRQ(UART_DMA_RX_IRQn);
+        HAL_NVIC_DisableIRQ(UART_DMA_TX_IRQn);
+        uartBaudRate = baudRate;
+        InitUart();
+        StartUartRx();
+    } else {
+        result = UART_FAIL;
+    }
+
+    xSemaphoreGive(UartTxBufferMutex);
+
+    return result;
 }
 
 /*
- * @brief  Create the UART communication tasks (for Rx and Tx)
+ * @brief  Gets the baud rate of the link
  * @param  None.
- * @retval None.
+ * @retval Baud rate
  */
-void CreateUARTComTasks(void) {
-    /* UART Rx handler task creation
-     * Task function pointer: UartRXTask
-     * Task name: UART_RX
-     * Stack depth: 3*configMINIMAL_STACK_SIZE
-     * Parameter: NULL
-     * Priority: UART_RX_TASK_PRIO (0 to configMAX_PRIORITIES-1 possible)
-     * Handle: UartRxTaskHandle
-     * */
-    if (pdPASS != xTaskCreate((pdTASK_CODE )UartRxTask, (signed portCHAR*)"UART_RX", 3*configMINIMAL_STACK_SIZE, NULL,
-            UART_RX_TASK_PRIO, &UartRxTaskHandle)) {
-        ErrorHandler();
+uint32_t GetUartBaudRate(void) {
+    return uartBaudRate;
+}
+
+/*
+ * @brief  Saves the baud rate of the link to flash, it is used from the next start-up
+ * @param  None.
+ * @retval UART_OK if saved, UART_FAIL if not in idle mode or the flash write failed
+ */
+UartStatus SaveUartSettings(void) {
+    UartSettings_TypeDef settings;
+
+    /* Like all settings, only snapshotted while disarmed; the flash writer work item programs the record later */
+    if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        return UART_FAIL;
     }
 
-    /* UART Tx handler task creation
-     * Task function pointer: UartTxTask
-     * Task name: UART_TX
-     * Stack depth: 3*configMINIMAL_STACK_SIZE
-     * Parameter: NULL
-     * Priority: UART_TX_THREAD_PRIO (0 to configMAX_PRIORITIES-1 possible)
-     * Handle: UartTxTaskHandle
-     * */
-    if (pdPASS != xTaskCreate((pdTASK_CODE )UartTxTask, (signed portCHAR*)"UART_TX", 1*configMINIMAL_STACK_SIZE,
-            NULL, UART_TX_TASK_PRIO, &UartTxTaskHandle)) {
-        ErrorHandler();
+    settings.baudRate = uartBaudRate;
+    if (FLASH_OK != WriteUartSettingsToFlash(&settings)) {
+        return UART_FAIL;
     }
+
+    return UART_OK;
 }
 
 /*
- * @brief  Create UART Tx Queue
+ * @brief  Registers the UART RX work item (Tx is driven by the TX DMA interrupt). The item is posted once here, so
+ *         that its first run starts the reception.
  * @param  None.
  * @retval None.
  */
-void CreateUARTComQueues(void) {
-    /* # Create queue for outgoing data ####################################### */
-    UartTxQueue = xQueueCreate(UART_COM_TX_QUEUE_ITEMS, sizeof(ComTxQueueItem_TypeDef));
+void CreateUARTComTasks(void) {
+    if (FCB_OK != DeferredWorkRegister("UartRx", HandleUartRxWork, NULL, DEFERRED_WORKER_LOW, &uartRxWorkId)) {
+        return;
+    }
 
-    /* We want this queue to be viewable in a RTOS kernel aware debugger, so register it. */
-    vQueueAddToRegistry(UartTxQueue, (signed portCHAR*) "UartTxQueue");
+    DeferredWorkPost(uartRxWorkId);
 }
 
 /*
@@ -185,69 +318,121 @@ void CreateUARTComQueues(void) {
  * @retval None.
  */
 void CreateUARTComSemaphores(void) {
-    //UartRxDataSem = xSemaphoreCreateCounting(UART_RX_MAX_SEM_COUNT, 0);
-    UartRxDataSem = xSemaphoreCreateBinary();
-    if (UartRxDataSem == NULL) {
-        ErrorHandler();
-    }
-
     UartTxBufferMutex = xSemaphoreCreateMutex();
     if (UartTxBufferMutex == NULL) {
         ErrorHandler();
     }
+    TRACE_OBJECT_NAME(UartTxBufferMutex, "mUartTx");
 
-    /* Create binary semaphore to synchronize UART output/TX. The semaphore is taken when device is
-     * transmitting (UART DMA busy) and given when transfer has completed. */
-    UartTxBinarySem = xSemaphoreCreateBinary();
-    if (UartTxBinarySem == NULL) {
+    /* Create binary semaphore given when a TX descriptor has been sent, for tasks waiting for room in the
+     * TX buffer */
+    UartTxDoneSem = xSemaphoreCreateBinary();
+    if (UartTxDoneSem == NULL) {
         ErrorHandler();
     }
+    TRACE_OBJECT_NAME(UartTxDoneSem, "qUartTxDone");
 }
 
 /**
- * @brief  Send data over UART interface. The data is entered into an output FIFO buffer which is then entered is
- *         then referred to into a queue. Both the FIFO buffer and the queue are protected by semaphore which needs to pended on.
+ * @brief  Send data over UART interface. The data is copied to the TX ring buffer, waiting for room for at most
+ *         UART_COM_MAX_DELAY, so the caller may reuse its buffer when the function returns.
  * @param  sendData : Reference to the data to be sent
  * @param  sendDataSize : Size of data to be sent
- * @param  maxMutexWaitTicks : Max ticks to wait for the FIFO buffer mutex
- * @param  maxQueueWaitTicks : Max ticks to wait for the queue
  * @retval Result of the operation: UART_OK if all operations are OK else UART_FAIL
  */
 UartStatus UartSendData(const uint8_t* sendData, const uint16_t sendDataSize) {
-    ComTxQueueItem_TypeDef UartTxQueueItem;
-    UartStatus result = UART_OK;
+    UartStatus result = UART_FAIL;
+    uint8_t* span;
+    uint16_t spanSize;
+    uint16_t queuedSize;
 
-    if (xSemaphoreTake(UartTxBufferMutex, UART_COM_MAX_DELAY) == pdPASS) {
-        // Mutex obtained - access the shared resource
-        if (FIFOBufferPutData(&UartTxFIFOBuffer, sendData, sendDataSize)) {
-            UartTxQueueItem.bufferType = FIFO_BUFFER;
-            UartTxQueueItem.bufferPtr = (void*) &UartTxFIFOBuffer;
-            UartTxQueueItem.BufferMutex = &UartTxBufferMutex;
-            UartTxQueueItem.dataSize = sendDataSize;
-
-            // The Tx Queue needs to be accessed in critical region since we don't want items from the same FIFO entering it in the wrong order!
-            if (xQueueSend(UartTxQueue, &UartTxQueueItem, UART_COM_MAX_DELAY) != pdPASS) {
-                // Queue full, delete data from FIFO
-                FIFOBufferDeleteLastEnteredBytes(&UartTxFIFOBuffer, sendDataSize);
-                result = UART_FAIL;
+    if (0 == sendDataSize || sendDataSize > UART_TX_BUFFER_SIZE) {
+        return UART_FAIL;
+    }
+
+    if (xSemaphoreTake(UartTxBufferMutex, UART_COM_MAX_DELAY) != pdPASS) {
+        return UART_FAIL;
+    }
+
+    /* Data that wraps around the end of the ring buffer takes two descriptors */
+    if (UART_OK == WaitUartTxSpace(sendDataSize, 2)) {
+        for (queuedSize = 0; queuedSize < sendDataSize; queuedSize += spanSize) {
+            spanSize = RingBufferPeekWrite(&uartTxRingBuffer, &span);
+            if (spanSize > sendDataSize - queuedSize) {
+                spanSize = sendDataSize - queuedSize;
             }
-        } else {
-            result = UART_FAIL;
+            memcpy(span, &sendData[queuedSize], spanSize);
+            RingBufferCommitWrite(&uartTxRingBuffer, spanSize);
+
+            /* The DMA reads the data from the ring buffer, the interrupt gets it from there when it has been sent */
+            result = QueueUartTx(span, spanSize, spanSize);
         }
+    }
 
-        xSemaphoreGive(UartTxBufferMutex); // We have finished accessing the shared resource. Release the mutex.
-    } else {
-        result = UART_FAIL;
+    xSemaphoreGive(UartTxBufferMutex);
+
+    return result;
+}
+
+/**
+ * @brief  Send a static buffer over the UART interface without copying it
+ * @param  sendData : Reference to the data to be sent, which must not change until it has been sent, e.g. a constant
+ * @param  sendDataSize : Size of data to be sent
+ * @retval Result of the operation: UART_OK if all operations are OK else UART_FAIL
+ */
+UartStatus UartSendStaticData(const uint8_t* sendData, const uint16_t sendDataSize) {
+    UartStatus result = UART_FAIL;
+
+    if (0 == sendDataSize) {
+        return UART_FAIL;
+    }
+
+    if (xSemaphoreTake(UartTxBufferMutex, UART_COM_MAX_DELAY) != pdPASS) {
+        return UART_FAIL;
+    }
+
+    if (UART_OK == WaitUartTxSpace(0, 1)) {
+        result = QueueUartTx(sendData, sendDataSize, 0);
+    }
+
+    xSemaphoreGive(UartTxBufferMutex);
+
+    return result;
+}
+
+/**
+ * @brief  Sends a frame ahead of the data queued by the other send functions, after the chunk being sent. The frame is
+ *         copied, without waiting and without taking UartTxBufferMutex, so it may be called from the flight control.
+ *         Task context only.
+ * @param  sendData : Reference to the frame to be sent
+ * @param  sendDataSize : Size of the frame, at most UART_PRIORITY_TX_SIZE
+ * @retval UART_OK if queued, UART_FAIL if the previous priority frame has not been sent yet
+ */
+UartStatus UartSendPriorityData(const uint8_t* sendData, const uint16_t sendDataSize) {
+    UartStatus result = UART_FAIL;
+
+    if (0 == sendDataSize || sendDataSize > UART_PRIORITY_TX_SIZE) {
+        return UART_FAIL;
     }
 
+    taskENTER_CRITICAL();
+    if (!uartTxPriorityPending && !uartTxPrioritySending) {
+        memcpy(uartTxPriorityBuffer, sendData, sendDataSize);
+        uartTxPrioritySize = sendDataSize;
+        uartTxPriorityPending = true;
+        if (!uartTxActive) {
+            StartNextUartTx();
+        }
+        result = UART_OK;
+    }
+    taskEXIT_CRITICAL();
+
     return result;
 }
 
 /**
  * @brief  Send a string over the UART interface.
  * @param  sendString : Reference to the string to be sent
- * @param  maxMutexWaitTicks : Max ticks to wait for the FIFO buffer mutex
- * @param  maxQueueWaitTicks : Max ticks to wait for the queue
  * @retval Result of the operation: UART_OK if all operations are OK else UART_FAIL
  */
 UartStatus UartSendString(const char* sendString) {
@@ -257,158 +442,275 @@ UartStatus UartSendString(const char* sendString) {
 /* Private functions ---------------------------------------------------------*/
 
 /**
- * @brief  Initializes the UART Fifo Buffers
+ * @brief  Initializes the UART peripheral with the link baud rate and prepares the TX DMA channel
  * @param  None.
  * @retval None.
  */
-static void InitUartCom(void) {
-    /* Create UART RX FIFO Buffer */
-    FIFOBufferInit(&UartRxFIFOBuffer, UartRxBufferArray, sizeof(UartRxBufferArray));
+static void InitUart(void) {
+    /*##-1- Configure the UART peripheral ######################################*/
+    /* Put the USART peripheral in the Asynchronous mode (UART Mode) */
+    /* UART configured as defined by header file definitions
+     * Hardware flow control disabled (RTS and CTS signals) */
+    UartHandle.Instance        = UART;
+    UartHandle.Init.BaudRate   = uartBaudRate;
+    UartHandle.Init.WordLength = UART_WORDLENGTH;
+    UartHandle.Init.StopBits   = UART_STOPBITS;
+    UartHandle.Init.Parity     = UART_PARITY;
+    UartHandle.Init.HwFlowCtl  = UART_HWCONTROL_NONE;
+    UartHandle.Init.Mode       = UART_MODE_TX_RX;
+
+    /* An overrun must not stop the DMA reception, the bytes are lost either way */
+    UartHandle.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_RXOVERRUNDISABLE_INIT;
+    UartHandle.AdvancedInit.OverrunDisable = UART_ADVFEATURE_OVERRUN_DISABLE;
+
+    if(HAL_UART_DeInit(&UartHandle) != HAL_OK) {
+        ErrorHandler();
+    }
+    if(HAL_UART_Init(&UartHandle) != HAL_OK) {
+        ErrorHandler();
+    }
 
-    /* Create UART TX FIFO Buffer */
-    FIFOBufferInit(&UartTxFIFOBuffer, UartTxBufferArray, sizeof(UartTxBufferArray));
+    ConfigUartTxDma();
 }
 
 /**
- * @brief  Task code handles the Uart Rx (receive) communication
- * @param  argument : Unused parameter
- * @retval None
+ * @brief  Prepares the TX DMA channel for descriptor transfers. The channel is run directly on the registers, since
+ *         the HAL transmit completion waits for the UART in the interrupt and would keep it from chaining transfers.
+ * @param  None.
+ * @retval None.
  */
-static void UartRxTask(void const *argument) {
-    (void) argument;
+static void ConfigUartTxDma(void) {
+    DMA_Channel_TypeDef* channel = UartHandle.hdmatx->Instance;
+
+    channel->CCR &= ~DMA_CCR_EN;
+    channel->CPAR = (uint32_t) &UartHandle.Instance->TDR;
+    __HAL_DMA_CLEAR_FLAG(UartHandle.hdmatx, __HAL_DMA_GET_TC_FLAG_INDEX(UartHandle.hdmatx)
+            | __HAL_DMA_GET_TE_FLAG_INDEX(UartHandle.hdmatx));
+    __HAL_DMA_ENABLE_IT(UartHandle.hdmatx, DMA_IT_TC | DMA_IT_TE);
+
+    /* The UART requests a byte whenever its transmit data register is empty */
+    UartHandle.Instance->CR3 |= USART_CR3_DMAT;
+
+    /* A reinitialization stopped the transfer, the priority frame is sent again and the chunk restarts */
+    if (uartTxPrioritySending) {
+        uartTxPrioritySending = false;
+        uartTxPriorityPending = true;
+    }
+    uartTxActive = false;
+}
 
-    uint16_t i = 0;
-    uint16_t j = 0;
-    uint16_t datalen = 0;
-    portBASE_TYPE moreDataToFollow;
-    ErrorStatus bufferStatus = SUCCESS;
-    uint8_t getByte;
-    static uint8_t cliInBuffer[MAX_CLI_COMMAND_SIZE];
-    static uint8_t cliOutBuffer[MAX_CLI_OUTPUT_SIZE];
-
-    /* Init UART communication */
-    InitUartCom();
-
-    for (;;) {
-        /* Start receiving data over UART, 1 byte at a time */
-        HAL_UART_Receive_DMA(&UartHandle, &rxByte, 1);
-
-        bufferStatus = SUCCESS;
-        /* Wait forever for incoming data over Uart by pending on the Uart Rx semaphore */
-        if (pdPASS == xSemaphoreTake(UartRxDataSem, portMAX_DELAY)) {
-            /* Read out the buffer until '\r' */
-            getByte = 0;
-            while (bufferStatus == SUCCESS && i < MAX_CLI_COMMAND_SIZE && ((char)getByte) != '\r') {
-                bufferStatus = FIFOBufferGetByte(&UartRxFIFOBuffer, &getByte);
-
-                if (bufferStatus == SUCCESS) {
-                    cliInBuffer[j] = getByte;
-                    j++;
-                }
-
-                i++;
-            }
+/**
+ * @brief  Starts the transfer of the pending priority frame, or else of the next chunk of the oldest queued
+ *         descriptor. Called from the TX DMA interrupt or in a critical section.
+ * @param  None.
+ * @retval None.
+ */
+static void StartNextUartTx(void) {
+    DMA_Channel_TypeDef* channel = UartHandle.hdmatx->Instance;
+    UartTxDescriptor_TypeDef* descriptor = &uartTxDescriptors[uartTxDescriptorTail];
+
+    channel->CCR &= ~DMA_CCR_EN;
+
+    if (uartTxPriorityPending) {
+        uartTxPriorityPending = false;
+        uartTxPrioritySending = true;
+        channel->CMAR = (uint32_t) uartTxPriorityBuffer;
+        channel->CNDTR = uartTxPrioritySize;
+        channel->CCR |= DMA_CCR_EN;
+        uartTxActive = true;
+        return;
+    }
 
-            /* End of command assumed found ('\r') */
-            if (((char)getByte) == '\r') {
-                uint16_t k = 0;
-                while((((char)cliInBuffer[k]) == ' ' || ((char)cliInBuffer[k]) == '\n' || ((char)cliInBuffer[k]) == '\r') && k < j-1) {
-                    k++;
-                }
-
-                TakeCLIMutex();
-                do {
-                    /* Send the command string to the command interpreter. Any output generated
-                     * by the command interpreter will be placed in the cliOutBuffer buffer. */
-                    moreDataToFollow = CLIParser(&(cliInBuffer[k]), cliOutBuffer, &datalen);
-                    if(datalen > 0) {
-                        UartSendData(cliOutBuffer, datalen);
-                    } else {
-                        UartSendString((char*) cliOutBuffer);
-                    }
-                } while (moreDataToFollow != pdFALSE);
-                GiveCLIMutex();
-
-                i = 0;
-                j = 0;
-                memset(cliInBuffer, 0x00, sizeof(cliInBuffer));
-            }
+    if (0 == uartTxDescriptorCount) {
+        uartTxActive = false;
+        return;
+    }
+
+    uartTxChunkSize = descriptor->size - uartTxDescriptorOffset;
+    if (uartTxChunkSize > UART_TX_CHUNK_SIZE) {
+        uartTxChunkSize = UART_TX_CHUNK_SIZE;
+    }
+    channel->CMAR = (uint32_t) &descriptor->data[uartTxDescriptorOffset];
+    channel->CNDTR = uartTxChunkSize;
+    channel->CCR |= DMA_CCR_EN;
+    uartTxActive = true;
+}
+
+/**
+ * @brief  Adds a descriptor to the TX chain and starts it if the TX DMA is idle. The caller holds UartTxBufferMutex
+ *         and has made sure there is a free descriptor.
+ * @param  data : Data to send
+ * @param  size : Size of data
+ * @param  ringBytes : TX ring buffer bytes used by the data, 0 if it is a static buffer
+ * @retval UART_OK
+ */
+static UartStatus QueueUartTx(const uint8_t* data, const uint16_t size, const uint16_t ringBytes) {
+    UartTxDescriptor_TypeDef* descriptor = &uartTxDescriptors[uartTxDescriptorHead];
+
+    descriptor->data = data;
+    descriptor->size = size;
+    descriptor->ringBytes = ringBytes;
+    uartTxDescriptorHead = (uartTxDescriptorHead + 1) % UART_TX_DESCRIPTORS;
+
+    taskENTER_CRITICAL();
+    uartTxDescriptorCount++;
+    BufferStatsRecordLevel(&uartTxDescriptorStats, uartTxDescriptorCount);
+    if (!uartTxActive) {
+        StartNextUartTx();
+    }
+    taskEXIT_CRITICAL();
+
+    return UART_OK;
+}
+
+/**
+ * @brief  Waits until the TX chain has room for data, for at most the time to send the whole TX buffer at the current
+ *         baud rate and UART_COM_MAX_DELAY, so that only a stalled transmission fails. The caller holds
+ *         UartTxBufferMutex.
+ * @param  bufferBytes : TX ring buffer bytes needed
+ * @param  descriptors : Descriptors needed
+ * @retval UART_OK if there is room, else UART_FAIL
+ */
+static UartStatus WaitUartTxSpace(const uint16_t bufferBytes, const uint8_t descriptors) {
+    portTickType maxDelay = UART_COM_MAX_DELAY + UART_TX_BUFFER_TIME(uartBaudRate);
+    portTickType startTick = xTaskGetTickCount();
+    portTickType waitedTicks;
+
+    if (RingBufferGetFree(&uartTxRingBuffer) < bufferBytes) {
+        RingBufferRecordFull(&uartTxRingBuffer);
+    }
+    if (UART_TX_DESCRIPTORS - uartTxDescriptorCount < descriptors) {
+        BufferStatsRecordFull(&uartTxDescriptorStats);
+    }
+
+    /* The TX DMA interrupt gives the semaphore after each descriptor, so a stale give only causes another check */
+    while (RingBufferGetFree(&uartTxRingBuffer) < bufferBytes
+            || UART_TX_DESCRIPTORS - uartTxDescriptorCount < descriptors) {
+        waitedTicks = xTaskGetTickCount() - startTick;
+        if (waitedTicks >= maxDelay || xSemaphoreTake(UartTxDoneSem, maxDelay - waitedTicks) != pdPASS) {
+            return UART_FAIL;
+        }
+    }
+
+    return UART_OK;
+}
+
+/**
+ * @brief  Starts the circular DMA reception into the ring buffer and enables the reception interrupts
+ * @param  None.
+ * @retval None.
+ */
+static void StartUartRx(void) {
+    uartRxReadIndex = 0;
+
+    if (HAL_UART_Receive_DMA(&UartHandle, uartRxDmaBuffer, UART_RX_DMA_BUFFER_SIZE) != HAL_OK) {
+        ErrorHandler();
+        return;
+    }
+
+    __HAL_UART_CLEAR_IT(&UartHandle, UART_CLEAR_IDLEF);
+    __HAL_UART_ENABLE_IT(&UartHandle, UART_IT_IDLE);
+}
+
+/**
+ * @brief  Handles the bytes that the DMA has written to the ring buffer since the previous call. Called from the
+ *         UART and UART RX DMA interrupts, which have the same priority.
+ * @param  None.
+ * @retval None.
+ */
+static void HandleUartRxData(void) {
+    portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+    uint16_t writeIndex;
+    bool cliData = false;
 
-            /* If rxTempBuffer full without found command */
-            if (i >= MAX_CLI_COMMAND_SIZE) {
-                i = 0;
-                j = 0;
-                memset(cliInBuffer, 0x00, sizeof(cliInBuffer));
+    writeIndex = (UART_RX_DMA_BUFFER_SIZE - UartHandle.hdmarx->Instance->CNDTR) % UART_RX_DMA_BUFFER_SIZE;
+
+    /* The received bytes are one span, or two if they wrap around the end of the ring buffer */
+    if (writeIndex < uartRxReadIndex) {
+        cliData = HandleUartRxSpan(&uartRxDmaBuffer[uartRxReadIndex], UART_RX_DMA_BUFFER_SIZE - uartRxReadIndex);
+        uartRxReadIndex = 0;
+    }
+    if (writeIndex > uartRxReadIndex) {
+        cliData |= HandleUartRxSpan(&uartRxDmaBuffer[uartRxReadIndex], writeIndex - uartRxReadIndex);
+    }
+    uartRxReadIndex = writeIndex;
+
+    if (cliData) {
+        /* # Signal the UART RX work item that new data has arrived #### */
+        DeferredWorkPostFromISR(uartRxWorkId, &xHigherPriorityTaskWoken);
+        portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+    }
+}
+
+/**
+ * @brief  Passes received bytes to the FMS link parser, and the runs of bytes it does not take to the CLI ring buffer
+ * @param  data : Received bytes
+ * @param  dataSize : Number of bytes
+ * @retval true if bytes were put to the CLI ring buffer, else false
+ */
+static bool HandleUartRxSpan(const uint8_t* data, const uint16_t dataSize) {
+    uint16_t runStart = 0;
+    uint16_t i;
+    bool cliData = false;
+
+    for (i = 0; i < dataSize; i++) {
+        /* Binary FMS frames are handled right here, bypassing the CLI */
+        if (FmsLinkHandleRxByte(data[i])) {
+            if (i > runStart) {
+                cliData |= (RingBufferPutData(&uartRxRingBuffer, &data[runStart], i - runStart) == SUCCESS);
             }
+            runStart = i + 1;
         }
     }
+
+    if (dataSize > runStart) {
+        cliData |= (RingBufferPutData(&uartRxRingBuffer, &data[runStart], dataSize - runStart) == SUCCESS);
+    }
+
+    return cliData;
 }
 
 /**
- * @brief  Task code handles the UART Tx communication
+ * @brief  Sends session output over UART, in pieces of UART_SESSION_PIECE_SIZE that each wait for room in the TX buffer
+ * @param  data : Reference to the data to be sent
+ * @param  size : Size of data to be sent
+ * @retval FCB_OK if the data was queued for sending, else FCB_ERR (the data may have been queued in part)
+ */
+static FcbRetValType UartSessionSend(const uint8_t* data, const uint16_t size) {
+    uint16_t sent;
+    uint16_t pieceSize;
+
+    for (sent = 0; sent < size; sent += pieceSize) {
+        pieceSize = size - sent;
+        if (pieceSize > UART_SESSION_PIECE_SIZE) {
+            pieceSize = UART_SESSION_PIECE_SIZE;
+        }
+
+        if (UART_OK != UartSendData(&data[sent], pieceSize)) {
+            return FCB_ERR;
+        }
+    }
+
+    return FCB_OK;
+}
+
+/**
+ * @brief  Work item handler of the Uart Rx (receive) communication, run by the low deferred worker. Handles all the
+ *         data in the CLI ring buffer, since the posts of the RX interrupts coalesce.
  * @param  argument : Unused parameter
  * @retval None
  */
-static void UartTxTask(void const *argument) {
+static void HandleUartRxWork(void* argument) {
     (void) argument;
 
-    static ComTxQueueItem_TypeDef UartTxQueueItem;
-    uint8_t* txDataPtr;
-    uint16_t tmpSize;
-
-    /* Make sure semaphore can be taken the first time */
-    xSemaphoreGive(UartTxBinarySem);
-
-    for (;;) {
-        /* Wait forever for incoming data over UART by pending on the UART Tx queue */
-        if (pdPASS == xQueueReceive(UartTxQueue, &UartTxQueueItem, portMAX_DELAY)) {
-            /* Take the buffer mutex (if it has one) */
-            if ((*UartTxQueueItem.BufferMutex == NULL || xSemaphoreTake(*UartTxQueueItem.BufferMutex, portMAX_DELAY) == pdPASS)) {
-                switch (UartTxQueueItem.bufferType) {
-                case ARRAY_BUFFER:
-                    // Tx buffer is just a good ol' array of data;
-                    if(HAL_UART_Transmit_DMA(&UartHandle, (uint8_t*) UartTxQueueItem.bufferPtr, UartTxQueueItem.dataSize)!= HAL_OK) {
-                        ErrorHandler();
-                    }
-                    break;
-                case FIFO_BUFFER:
-                    // Tx buffer is a FIFO ring buffer that wraps around its zero index
-                    tmpSize = FIFOBufferGetData((volatile FIFOBuffer_TypeDef*) UartTxQueueItem.bufferPtr,
-                            &txDataPtr, UartTxQueueItem.dataSize);
-
-                    if (xSemaphoreTake(UartTxBinarySem, UART_COM_MAX_DELAY) == pdPASS) { // Pend on UART Binary Semaphore while previous transmission is in progress
-                        if(HAL_UART_Transmit_DMA(&UartHandle, txDataPtr, tmpSize) != HAL_OK) {
-                            ErrorHandler();
-                        }
-                    }
-
-                    // If not all data received from buffer (due to FIFO wrap-around), get the rest
-                    if (tmpSize < UartTxQueueItem.dataSize) {
-                        tmpSize = FIFOBufferGetData((volatile FIFOBuffer_TypeDef*) UartTxQueueItem.bufferPtr,
-                                &txDataPtr, UartTxQueueItem.dataSize - tmpSize);
-
-                        if (xSemaphoreTake(UartTxBinarySem, UART_COM_MAX_DELAY) == pdPASS) { // Pend on UART Binary Semaphore while previous transmission is in progress
-                            if(HAL_UART_Transmit_DMA(&UartHandle, txDataPtr, tmpSize) != HAL_OK) {
-                                ErrorHandler();
-                            }
-                        }
-                    }
-                    break;
-                default:
-                    /* Unspecified buffer type, indicate error */
-                    ErrorHandler();
-                    break;
-                }
-
-                if (*UartTxQueueItem.BufferMutex != NULL) {
-                    xSemaphoreGive(*UartTxQueueItem.BufferMutex); // Give buffer mutex
-                }
-            }
-        } else {
-            /* Give Semaphore if timed out to regain access to UART DMA transmission */
-            xSemaphoreGive(UartTxBinarySem);
-        }
+    /* Start receiving data over UART into the DMA ring buffer at the first run, once the scheduler runs */
+    if (!uartRxStarted) {
+        uartRxStarted = true;
+        StartUartRx();
+        return;
     }
+
+    ComSessionHandleRxData(&uartSession);
 }
 
 /**
@@ -16,6 +16,8 @@
 
 #include "usbd_cdc.h"
 
+#include <stdbool.h>
+
 /* Exported types ------------------------------------------------------------*/
 
 /* Exported constants --------------------------------------------------------*/
@@ -23,11 +25,10 @@
 /* Exported macro ------------------------------------------------------------*/
 
 /* Exported functions ------------------------------------------------------- */
-USBD_StatusTypeDef CDCTransmitFS(uint8_t* data, uint16_t size);
 USBD_StatusTypeDef USBComSendString(const char* sendString);
 USBD_StatusTypeDef USBComSendData(const uint8_t* sendData, const uint16_t sendDataSize);
+bool IsUSBComConfigured(void);
 void CreateUSBComTasks(void);
-void CreateUSBComQueues(void);
 void CreateUSBComSemaphores(void);
 
 #endif /* __USBD_CDC_IF_H */
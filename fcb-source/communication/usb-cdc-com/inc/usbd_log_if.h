@@ -0,0 +1,58 @@
+/**
+ ******************************************************************************
+ * @file    usbd_log_if.h
+ * @brief   USB log interface header file. The USB device is a composite of
+ *          the CDC com port, interfaces 0 and 1, a vendor specific interface
+ *          with one bulk IN endpoint for high rate binary logs and, with
+ *          FCB_USB_MASS_STORAGE, the mass storage interface of usbd_msc_if.h.
+ ******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_LOG_IF_H
+#define __USBD_LOG_IF_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_core.h"
+#include "usbd_cdc.h"
+#include "usbd_msc_if.h"
+
+#include <stdbool.h>
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Exported constants --------------------------------------------------------*/
+#define USB_LOG_INTERFACE               0x02  /* Interface number, after the CDC communication and data interfaces */
+#define USB_LOG_IN_EP                   0x83  /* EP3 for log data IN */
+#define USB_LOG_FS_PACKET_SIZE          64
+
+/* Configuration descriptor of the composite device: the CDC one, an interface association descriptor grouping the
+ * CDC interfaces, the log interface with its endpoint and, with FCB_USB_MASS_STORAGE, the mass storage interface */
+#ifdef FCB_USB_MASS_STORAGE
+#define USB_LOG_NBR_OF_INTERFACES       4
+#define USB_LOG_CONFIG_DESC_SIZ         (USB_CDC_CONFIG_DESC_SIZ + 8 + 9 + 7 + USB_MSC_DESC_SIZ)
+#else
+#define USB_LOG_NBR_OF_INTERFACES       3
+#define USB_LOG_CONFIG_DESC_SIZ         (USB_CDC_CONFIG_DESC_SIZ + 8 + 9 + 7)
+#endif
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+USBD_ClassTypeDef* USBLogCompositeClass(USBD_ClassTypeDef* cdcClass);
+USBD_StatusTypeDef USBLogSendData(const uint8_t* sendData, const uint16_t sendDataSize);
+USBD_StatusTypeDef USBLogTransmit(const uint8_t* data, const uint16_t size);
+bool USBLogIsSending(void);
+uint32_t GetUSBLogDroppedBytes(void);
+
+#endif /* __USBD_LOG_IF_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+
+/*****END OF FILE****/
@@ -0,0 +1,74 @@
+/**
+ ******************************************************************************
+ * @file    usbd_msc_if.h
+ * @brief   USB mass storage interface header file. With FCB_USB_MASS_STORAGE
+ *          the composite device of usbd_log_if.h has a fourth interface, a
+ *          bulk-only mass storage one of a single read-only SCSI disk, which
+ *          holds the logs, the event journal, the crash dump and the settings
+ *          as the files of msc_volume.h. The medium is only inserted while
+ *          the UAV is disarmed, on request, and arming ejects it.
+ ******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_MSC_IF_H
+#define __USBD_MSC_IF_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_core.h"
+#include "fcb_retval.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Uncomment to add the read-only USB mass storage interface of the logs and settings */
+//#define FCB_USB_MASS_STORAGE
+
+/* Exported types ------------------------------------------------------------*/
+
+typedef struct {
+	bool isConfigured;              // The host has configured the device
+	bool isInserted;                // The medium is inserted, see USBMscSetMedium()
+	uint8_t files;                  // Of the volume, see GetMscVolumeFiles()
+	uint32_t usedBytes;             // In the files of the volume
+	uint32_t commands;              // SCSI commands since startup
+	uint32_t readSectors;           // Since startup
+	uint32_t failedCommands;        // Since startup, including those without a medium
+} USBMscStatus_TypeDef;
+
+/* Exported constants --------------------------------------------------------*/
+#define USB_MSC_INTERFACE               0x03  /* Interface number, after the log interface */
+#define USB_MSC_IN_EP                   0x84  /* EP4 for data and status IN */
+#define USB_MSC_OUT_EP                  0x04  /* EP4 for commands OUT */
+#define USB_MSC_IN_PACKET_SIZE          64
+#define USB_MSC_OUT_PACKET_SIZE         32    /* Only the 31 byte command blocks, the disk is read-only */
+
+/* The interface descriptor and its two endpoint descriptors */
+#define USB_MSC_DESC_SIZ                (9 + 7 + 7)
+
+#define USB_MSC_MAX_STRING_SIZE         256
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+void USBMscInit(USBD_HandleTypeDef* pdev);
+void USBMscDeInit(USBD_HandleTypeDef* pdev);
+uint8_t USBMscSetup(USBD_HandleTypeDef* pdev, USBD_SetupReqTypedef* req);
+void USBMscDataIn(USBD_HandleTypeDef* pdev);
+void USBMscDataOut(USBD_HandleTypeDef* pdev);
+void CreateUSBMscWork(void);
+FcbRetValType USBMscSetMedium(const bool isInserted);
+void GetUSBMscStatus(USBMscStatus_TypeDef* dstStatus);
+size_t PrintUSBMscStatus(char* dst, const size_t dstSize);
+
+#endif /* __USBD_MSC_IF_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+
+/*****END OF FILE****/
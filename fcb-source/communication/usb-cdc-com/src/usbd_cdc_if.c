@@ -23,15 +23,20 @@
 /* Includes ------------------------------------------------------------------*/
 #include "usbd_cdc_if.h"
 
-#include "fifo_buffer.h"
-#include "com_cli.h"
+#include "usbd_log_if.h"
+#include "ring_buffer.h"
+#include "com_session.h"
 #include "usbd_cdc.h"
 #include "fcb_error.h"
+#include "trace_recorder.h"
 #include "communication.h"
+#include "boot_timing.h"
+#include "deferred_work.h"
 
 #include <string.h>
 #include <stdio.h>
 #include <stdio_ext.h>
+#include <stdbool.h>
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -44,13 +49,9 @@
 #define USB_COM_TX_BUFFER_SIZE          512
 #define USB_COM_RX_BUFFER_SIZE          512
 
-#define USB_COM_RX_TASK_PRIO          	1
-#define USB_COM_TX_TASK_PRIO          	2 // Prioritize sending over receiving so that buffers are emptied faster
+#define USB_COM_MAX_DELAY               1000 // [ms] Max wait for room for a piece of the data
 
-#define USB_COM_TX_QUEUE_ITEMS          16
-#define USB_RX_MAX_SEM_COUNT			4
-
-#define USB_COM_MAX_DELAY               1000 // [ms]
+#define USB_COM_TX_PACKET_SIZE          CDC_DATA_FS_MAX_PACKET_SIZE
 
 /* Private function prototypes -----------------------------------------------*/
 static void InitUSBCom(void);
@@ -58,27 +59,43 @@ static int8_t CDCItfInit(void);
 static int8_t CDCItfDeInit(void);
 static int8_t CDCItfControl(uint8_t cmd, uint8_t* pbuf, uint16_t length);
 static int8_t CDCItfReceive(uint8_t* rxData, uint32_t* rxDataLen);
+static uint8_t CDCItfDataIn(USBD_HandleTypeDef* pdev, uint8_t epnum);
+static bool TransmitNextPacket(void);
+
+static FcbRetValType USBComSessionSend(const uint8_t* data, const uint16_t size);
 
-static void USBComPortRXTask(void const *argument);
-static void USBComPortTXTask(void const *argument);
+static void HandleUSBComRxWork(void* argument);
 
 /* Private variables ---------------------------------------------------------*/
 
 /* USB handler declaration */
 USBD_HandleTypeDef hUSBDDevice;
 
-uint8_t USBCOMRxPacketBuffer[CDC_DATA_HS_OUT_PACKET_SIZE];
+/* OUT endpoint packet buffer, the device is full speed only */
+static uint8_t USBCOMRxPacketBuffer[CDC_DATA_FS_OUT_PACKET_SIZE];
 
-/* USB CDC Receive FIFO buffer */
+/* USB CDC Receive ring buffer, put by the USB interrupt and got by the RX work item */
 uint8_t USBCOMRxBufferArray[USB_COM_RX_BUFFER_SIZE];
-volatile FIFOBuffer_TypeDef USBCOMRxFIFOBuffer;
+RingBuffer_TypeDef USBCOMRxRingBuffer;
+
+/* USB CDC Transmit ring buffer, put by the sending tasks (under USBCOMTxBufferMutex) and got by the USB interrupt, or
+ * by a sender with it masked when no transmission is in progress */
+static uint8_t USBCOMTxBufferArray[USB_COM_TX_BUFFER_SIZE];
+static RingBuffer_TypeDef USBCOMTxRingBuffer;
 
-/* USB CDC Transmit FIFO buffer */
-uint8_t USBCOMTxBufferArray[USB_COM_TX_BUFFER_SIZE];
-volatile FIFOBuffer_TypeDef USBCOMTxFIFOBuffer;
+/* CLI and RPC session of the USB com port, run by the RX work item */
+static ComSession_TypeDef USBCOMSession;
 
 USBD_CDC_ItfTypeDef USBD_CDC_fops = { CDCItfInit, CDCItfDeInit, CDCItfControl, CDCItfReceive };
 
+/* The CDC class with its IN endpoint completion callback wrapped to start the next packet, see InitUSBCom() */
+static USBD_ClassTypeDef USBComCDCClass;
+
+/* TX packet staging, the next packet is staged when the previous one has completed so one buffer does */
+static uint8_t USBCOMTxPacketBuffer[USB_COM_TX_PACKET_SIZE];
+static volatile bool USBCOMTxBusy = false;
+static bool USBCOMTxLastPacketFull = false;
+
 USBD_CDC_LineCodingTypeDef LineCoding = { 115200, /* baud rate */
 0x00, /* stop bits-1 */
 0x00, /* parity - none */
@@ -86,14 +103,11 @@ USBD_CDC_LineCodingTypeDef LineCoding = { 115200, /* baud rate */
 };
 
 /* USB RTOS variables */
-xTaskHandle USBComPortRxTaskHandle;
-xTaskHandle USBComPortTxTaskHandle;
+static DeferredWorkId_TypeDef USBComRxWorkId = DEFERRED_WORK_INVALID_ID;
+static bool USBComStarted = false;
 
-xQueueHandle usbComTxQueue;
-
-xSemaphoreHandle USBCOMRxDataSem;
 xSemaphoreHandle USBCOMTxBufferMutex;
-xSemaphoreHandle USBTxMutex;
+xSemaphoreHandle USBCOMTxSpaceSem;
 
 /* Private functions ---------------------------------------------------------*/
 
@@ -103,17 +117,23 @@ xSemaphoreHandle USBTxMutex;
  * @retval None.
  */
 static void InitUSBCom(void) {
-	/* Create CDC RX FIFO Buffer */
-	FIFOBufferInit(&USBCOMRxFIFOBuffer, USBCOMRxBufferArray, sizeof(USBCOMRxBufferArray));
-
-	/* Create CDC TX FIFO Buffer */
-	FIFOBufferInit(&USBCOMTxFIFOBuffer, USBCOMTxBufferArray, sizeof(USBCOMTxBufferArray));
+	/* Create CDC RX and TX ring buffers */
+	if (SUCCESS != RingBufferInit(&USBCOMRxRingBuffer, USBCOMRxBufferArray, sizeof(USBCOMRxBufferArray))
+			|| SUCCESS != RingBufferInit(&USBCOMTxRingBuffer, USBCOMTxBufferArray, sizeof(USBCOMTxBufferArray))) {
+		ErrorHandler();
+	}
+	BufferMonitorRegister("usbComRx", sizeof(USBCOMRxBufferArray), &USBCOMRxRingBuffer.stats);
+	BufferMonitorRegister("usbComTx", sizeof(USBCOMTxBufferArray), &USBCOMTxRingBuffer.stats);
+	ComSessionInit(&USBCOMSession, &USBCOMRxRingBuffer, USBComSessionSend);
 
 	/* Init Device Library */
 	USBD_Init(&hUSBDDevice, &VCP_Desc, 0);
 
-	/* Add Supported Class */
-	USBD_RegisterClass(&hUSBDDevice, &USBD_CDC);
+	/* Add Supported Class, the CDC class does not notify the interface of completed IN transfers. The device is a
+	 * composite of the CDC com port and the log interface. */
+	USBComCDCClass = USBD_CDC;
+	USBComCDCClass.DataIn = CDCItfDataIn;
+	USBD_RegisterClass(&hUSBDDevice, USBLogCompositeClass(&USBComCDCClass));
 
 	/* Add CDC Interface Class */
 	USBD_CDC_RegisterInterface(&hUSBDDevice, &USBD_CDC_fops);
@@ -132,6 +152,10 @@ static int8_t CDCItfInit(void) {
 	/*# Set CDC Buffers ####################################################### */
 	USBD_CDC_SetRxBuffer(&hUSBDDevice, USBCOMRxPacketBuffer);
 
+	/* Data left in the TX ring buffer is sent when the next data is */
+	USBCOMTxBusy = false;
+	USBCOMTxLastPacketFull = false;
+
 	return (USBD_OK);
 }
 
@@ -142,6 +166,9 @@ static int8_t CDCItfInit(void) {
  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
  */
 static int8_t CDCItfDeInit(void) {
+	/* No completion will follow a transmission in progress */
+	USBCOMTxBusy = false;
+
 	return (USBD_OK);
 }
 
@@ -227,9 +254,10 @@ static int8_t CDCItfReceive(uint8_t* rxData, uint32_t* rxDataLen) {
 	if (hUSBDDevice.dev_state == USBD_STATE_CONFIGURED) {
 		result = USBD_CDC_ReceivePacket(&hUSBDDevice);
 		if (result == USBD_OK) {
-			if (FIFOBufferPutData(&USBCOMRxFIFOBuffer, rxData, *rxDataLen)) {
-				/* # Signal RX task that new USB CDC data has arrived #### */
-				xSemaphoreGiveFromISR(USBCOMRxDataSem, &xHigherPriorityTaskWoken);
+			/* A packet that does not fit is dropped, the data already buffered is kept */
+			if (SUCCESS == RingBufferPutData(&USBCOMRxRingBuffer, rxData, *rxDataLen)) {
+				/* # Signal the RX work item that new USB CDC data has arrived #### */
+				DeferredWorkPostFromISR(USBComRxWorkId, &xHigherPriorityTaskWoken);
 				portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 			} else {
 				result = USBD_FAIL;
@@ -243,122 +271,90 @@ static int8_t CDCItfReceive(uint8_t* rxData, uint32_t* rxDataLen) {
 }
 
 /**
- * @brief  Task code handles the USB Com Port Rx communication
- * @param  argument : Unused parameter
- * @retval None
+ * @brief  USB CDC IN endpoint completion callback, wraps the CDC class one. Starts the next packet and wakes a sender
+ *         waiting for room in the TX ring buffer. Function called from ISR.
+ * @param  pdev: device instance
+ * @param  epnum: endpoint number
+ * @retval Result of the CDC class callback
  */
-static void USBComPortRXTask(void const *argument) {
-	(void) argument;
-
-	uint16_t i = 0;
-	uint16_t datalen = 0;
-	portBASE_TYPE moreDataToFollow;
-	ErrorStatus bufferStatus = SUCCESS;
-	uint8_t getByte;
-	static uint8_t cliInBuffer[MAX_CLI_COMMAND_SIZE];
-	static uint8_t cliOutBuffer[MAX_CLI_OUTPUT_SIZE];
+static uint8_t CDCItfDataIn(USBD_HandleTypeDef* pdev, uint8_t epnum) {
+	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+	uint8_t result;
 
-	/* Init USB communication */
-	InitUSBCom();
+	result = USBD_CDC.DataIn(pdev, epnum);
 
-	for (;;) {
-		bufferStatus = SUCCESS;
-		/* Wait forever for incoming data over USB by pending on the USB Rx semaphore */
-		if (pdPASS == xSemaphoreTake(USBCOMRxDataSem, portMAX_DELAY)) {
-			// Read out the FIFO buffer
-			getByte = 0;
-			while (bufferStatus == SUCCESS && i < MAX_CLI_COMMAND_SIZE && ((char)getByte) != '\r') {
-				bufferStatus = FIFOBufferGetByte(&USBCOMRxFIFOBuffer, &getByte);
-
-				if (bufferStatus == SUCCESS) {
-					cliInBuffer[i] = getByte;
-				}
+	if ((CDC_IN_EP & 0x7F) == epnum) {
+		USBCOMTxBusy = TransmitNextPacket();
 
-				i++;
-			}
-
-			// End of command assumed found ('\r')
-			if (((char)getByte) == '\r') {
-				uint16_t k = 0;
-				while((((char)cliInBuffer[k]) == ' ' || ((char)cliInBuffer[k]) == '\n' || ((char)cliInBuffer[k]) == '\r') && k < i-1) {
-					k++;
-				}
+		xSemaphoreGiveFromISR(USBCOMTxSpaceSem, &xHigherPriorityTaskWoken);
+		portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+	}
 
-				TakeCLIMutex();
-				do {
-					/* Send the command string to the command interpreter. Any output generated
-					 * by the command interpreter will be placed in the cliOutBuffer buffer. */
-				    moreDataToFollow = CLIParser(&(cliInBuffer[k]), cliOutBuffer, &datalen);
-				    if(datalen > 0) {
-				        USBComSendData(cliOutBuffer, datalen);
-				    } else {
-				        USBComSendString((char*) cliOutBuffer);
-				    }
-
-				} while (moreDataToFollow != pdFALSE);
-				GiveCLIMutex();
-
-				i = 0;
-				memset(cliInBuffer, 0x00, sizeof(cliInBuffer));
-			}
+	return result;
+}
 
-			// If rxTempBuffer full without found command
-			if (i >= MAX_CLI_COMMAND_SIZE) {
-				i = 0;
-				memset(cliInBuffer, 0x00, sizeof(cliInBuffer));
-			}
-		}
-	}
+/**
+ * @brief  Sends session output over the USB com port
+ * @param  data : Reference to the data to be sent
+ * @param  size : Size of data to be sent
+ * @retval FCB_OK if the data was buffered for sending, else FCB_ERR
+ */
+static FcbRetValType USBComSessionSend(const uint8_t* data, const uint16_t size) {
+	return (USBD_OK == USBComSendData(data, size)) ? FCB_OK : FCB_ERR;
 }
 
 /**
- * @brief  Task code handles the USB Com Port Tx communication
+ * @brief  Work item handler of the USB Com Port Rx communication, run by the low deferred worker. Handles all the data
+ *         in the RX ring buffer, since the posts of the USB interrupt coalesce.
  * @param  argument : Unused parameter
  * @retval None
  */
-static void USBComPortTXTask(void const *argument) {
+static void HandleUSBComRxWork(void* argument) {
 	(void) argument;
 
-	static ComTxQueueItem_TypeDef CompPortTxQueueItem;
-	uint8_t* txDataPtr;
-	uint16_t tmpSize;
+	/* Init USB communication at the first run, once the scheduler runs */
+	if (!USBComStarted) {
+		USBComStarted = true;
+		InitUSBCom();
+		BootTimingMark(BOOT_PHASE_USB_START);
+		return;
+	}
+
+	ComSessionHandleRxData(&USBCOMSession);
+}
+
+/**
+ * @brief  Stages the next packet from the TX ring buffer and starts its transmission over the USB IN endpoint, as much
+ *         data as fits. A full packet is followed by a zero-length packet if no data follows. Called from the CDC IN
+ *         endpoint completion callback, or with the USB interrupt masked when no transmission is in progress.
+ * @param  None
+ * @retval true if a packet is being transmitted, false if there is nothing to send
+ */
+static bool TransmitNextPacket(void) {
+	uint16_t stagedSize;
 
 	for (;;) {
-		/* Wait forever for incoming data over USB by pending on the USB Tx queue */
-		if (pdPASS == xQueueReceive(usbComTxQueue, &CompPortTxQueueItem, portMAX_DELAY)) {
-			if (xSemaphoreTake(USBTxMutex, USB_COM_MAX_DELAY) == pdPASS) { // Pend on USB mutex while previous transmission is in progress
-				/* Take the buffer mutex (if it has one) */
-				if ((*CompPortTxQueueItem.BufferMutex == NULL
-						|| xSemaphoreTake(*CompPortTxQueueItem.BufferMutex, portMAX_DELAY) == pdPASS)) {
-
-					switch (CompPortTxQueueItem.bufferType) {
-					case ARRAY_BUFFER:
-						// Tx buffer is just a good ol' array of data
-						CDCTransmitFS((uint8_t*) CompPortTxQueueItem.bufferPtr, CompPortTxQueueItem.dataSize);
-						break;
-					case FIFO_BUFFER:
-						// Tx buffer is a FIFO ring buffer that wraps around its zero index
-						tmpSize = FIFOBufferGetData((volatile FIFOBuffer_TypeDef*) CompPortTxQueueItem.bufferPtr,
-								&txDataPtr, CompPortTxQueueItem.dataSize);
-						CDCTransmitFS(txDataPtr, tmpSize);
-
-						// If not all data received from buffer (due to FIFO wrap-around), get the rest
-						if (tmpSize < CompPortTxQueueItem.dataSize) {
-							tmpSize = FIFOBufferGetData((volatile FIFOBuffer_TypeDef*) CompPortTxQueueItem.bufferPtr,
-									&txDataPtr, CompPortTxQueueItem.dataSize - tmpSize);
-							CDCTransmitFS(txDataPtr, tmpSize);
-						}
-						break;
-					default:
-						/* Unspecified buffer type, indicate error */
-						ErrorHandler();
-						break;
-					}
-					if (*CompPortTxQueueItem.BufferMutex != NULL) {
-						xSemaphoreGive(*CompPortTxQueueItem.BufferMutex); // Give buffer mutex
-					}
-				}
-				xSemaphoreGive(USBTxMutex); // Give USB mutex when transmission completed
+		stagedSize = RingBufferGetData(&USBCOMTxRingBuffer, USBCOMTxPacketBuffer, USB_COM_TX_PACKET_SIZE);
+		if (0 == stagedSize && !USBCOMTxLastPacketFull) {
+			return false;
+		}
+
+		/*
+		 * According to the USB specification, a packet size of 64 bytes (CDC_DATA_FS_MAX_PACKET_SIZE)
+		 * gets held at the USB host until the next packet is sent.  This is because a
+		 * packet of maximum size is considered to be part of a longer chunk of data, and
+		 * the host waits for all data to arrive (ie, waits for a packet < max packet size).
+		 * To flush a packet of exactly max packet size, we need to send a zero-size packet or
+		 * short packet of less than CDC_DATA_FS_MAX_PACKET_SIZE.
+		 * See eg http://www.cypress.com/?id=4&rID=92719
+		 * */
+		USBCOMTxLastPacketFull = (USB_COM_TX_PACKET_SIZE == stagedSize);
+
+		/* A packet that is not started, e.g. when USB is not configured, is dropped, no completion will follow */
+		if (hUSBDDevice.dev_state == USBD_STATE_CONFIGURED) {
+			USBD_CDC_SetTxBuffer(&hUSBDDevice, (0 == stagedSize) ? NULL : USBCOMTxPacketBuffer, stagedSize);
+			if (USBD_OK == USBD_CDC_TransmitPacket(&hUSBDDevice)) {
+				return true;
 			}
 		}
 	}
@@ -367,47 +363,12 @@ static void USBComPortTXTask(void const *argument) {
 /* Exported functions --------------------------------------------------------*/
 
 /**
- * @brief  Data transmit over USB IN endpoint sent over CDC interface through this function. The data is entered into an output FIFO buffer which is then entered is
- *         then referred to into a queue. Both the FIFO buffer and the queue are protected by semaphore which needs to pended on.
- * @param  Buf: Buffer of data
- * @param  Len: Number of data received (in bytes)
- * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+ * @brief  Checks that a USB host has configured the CDC com port, i.e. that the FCB is connected to a computer
+ * @param  None
+ * @retval true if configured, else false
  */
-USBD_StatusTypeDef CDCTransmitFS(uint8_t* data, uint16_t size) {
-	uint8_t result = USBD_OK;
-	static uint16_t timeoutCnt = UINT16_MAX;
-	USBD_CDC_HandleTypeDef *hCDC = hUSBDDevice.pClassData;
-
-	if (hUSBDDevice.dev_state == USBD_STATE_CONFIGURED) {
-		USBD_CDC_SetTxBuffer(&hUSBDDevice, data, size);
-		while (((result = USBD_CDC_TransmitPacket(&hUSBDDevice)) == USBD_BUSY) && timeoutCnt != 0) {
-			timeoutCnt--;
-		} // Wait while busy with previous transmission
-		if(timeoutCnt == 0)
-			hCDC->TxState = 0;	// Reset the USB transfer state
-		timeoutCnt = UINT16_MAX;
-		if (size % CDC_DATA_FS_MAX_PACKET_SIZE == 0) {
-			/*
-			 * According to the USB specification, a packet size of 64 bytes (CDC_DATA_FS_MAX_PACKET_SIZE)
-			 * gets held at the USB host until the next packet is sent.  This is because a
-			 * packet of maximum size is considered to be part of a longer chunk of data, and
-			 * the host waits for all data to arrive (ie, waits for a packet < max packet size).
-			 * To flush a packet of exactly max packet size, we need to send a zero-size packet or
-			 * short packet of less than CDC_DATA_FS_MAX_PACKET_SIZE.
-			 * See eg http://www.cypress.com/?id=4&rID=92719
-			 * */
-			USBD_CDC_SetTxBuffer(&hUSBDDevice, NULL, 0); // Zero-length packet (ZLP)
-			while (((result = USBD_CDC_TransmitPacket(&hUSBDDevice)) == USBD_BUSY) && timeoutCnt != 0) {
-				timeoutCnt--;
-			} // Wait while busy with previous transmission
-			if(timeoutCnt == 0)
-				hCDC->TxState = 0;	// Reset the USB transfer state
-			timeoutCnt = UINT16_MAX;
-		}
-	} else {
-		result = USBD_FAIL; // USB not connected and/or configured
-	}
-	return result;
+bool IsUSBComConfigured(void) {
+	return (hUSBDDevice.dev_state == USBD_STATE_CONFIGURED);
 }
 
 /**
@@ -422,33 +383,56 @@ USBD_StatusTypeDef USBComSendString(const char* sendString) {
 }
 
 /**
- * @brief  Send data over the USB IN endpoint CDC com port interface
+ * @brief  Send data over the USB IN endpoint CDC com port interface. Data larger than the free space in the TX ring
+ *         buffer is put in pieces, waiting for the transmissions to make room. The wait is per piece, so data of any size
+ *         is sent as fast as the host reads it, and only a stalled host makes it fail.
  * @param  sendData : Reference to the data to be sent
  * @param  sendDataSize : Size of data to be sent
- * @param  maxMutexWaitTicks : Max ticks to wait for the FIFO buffer mutex
- * @param  maxQueueWaitTicks : Max ticks to wait for the queue
- * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+ * @retval Result of the operation: USBD_OK if all data was buffered, else USBD_FAIL (no room for a piece within
+ *         USB_COM_MAX_DELAY, the data may have been buffered in part)
  */
 USBD_StatusTypeDef USBComSendData(const uint8_t* sendData, const uint16_t sendDataSize) {
-    ComTxQueueItem_TypeDef CompPortTxQueueItem;
 	USBD_StatusTypeDef result = USBD_OK;
+	portTickType startTicks;
+	portTickType waitedTicks;
+	uint16_t sent = 0;
+	uint16_t pieceSize;
 
 	if (xSemaphoreTake(USBCOMTxBufferMutex, USB_COM_MAX_DELAY) == pdPASS) {
 		// Mutex obtained - access the shared resource
-		if (FIFOBufferPutData(&USBCOMTxFIFOBuffer, sendData, sendDataSize)) {
-			CompPortTxQueueItem.bufferType = FIFO_BUFFER;
-			CompPortTxQueueItem.bufferPtr = (void*) &USBCOMTxFIFOBuffer;
-			CompPortTxQueueItem.BufferMutex = &USBCOMTxBufferMutex;
-			CompPortTxQueueItem.dataSize = sendDataSize;
-
-			// The Tx Queue needs to be accessed in critical region since we don't want items from the same FIFO entering it in the wrong order!
-			if (xQueueSend(usbComTxQueue, &CompPortTxQueueItem, USB_COM_MAX_DELAY) != pdPASS) {
-				// Queue full, delete data from FIFO
-				FIFOBufferDeleteLastEnteredBytes(&USBCOMTxFIFOBuffer, sendDataSize);
-				result = USBD_FAIL;
+		while (sent < sendDataSize && USBD_OK == result) {
+			pieceSize = sendDataSize - sent;
+			if (pieceSize > USB_COM_TX_BUFFER_SIZE) {
+				pieceSize = USB_COM_TX_BUFFER_SIZE;
+			}
+
+			/* Wait for the transmissions to release room for the piece */
+			startTicks = xTaskGetTickCount();
+			if (RingBufferGetFree(&USBCOMTxRingBuffer) < pieceSize) {
+				RingBufferRecordFull(&USBCOMTxRingBuffer);
+			}
+			while (RingBufferGetFree(&USBCOMTxRingBuffer) < pieceSize) {
+				waitedTicks = xTaskGetTickCount() - startTicks;
+				if (waitedTicks >= USB_COM_MAX_DELAY
+						|| pdPASS != xSemaphoreTake(USBCOMTxSpaceSem, USB_COM_MAX_DELAY - waitedTicks)) {
+					result = USBD_FAIL;
+					break;
+				}
+			}
+
+			if (USBD_OK == result) {
+				RingBufferPutData(&USBCOMTxRingBuffer, &sendData[sent], pieceSize);
+				sent += pieceSize;
+
+				/* Start a transmission if none is in progress, the completions send the rest. The PCD driver is
+				 * locked while a transmission is started, the USB interrupt starts the log endpoint transfers which
+				 * would fail if it interrupted this. */
+				taskENTER_CRITICAL();
+				if (!USBCOMTxBusy) {
+					USBCOMTxBusy = TransmitNextPacket();
+				}
+				taskEXIT_CRITICAL();
 			}
-		} else {
-			result = USBD_FAIL;
 		}
 
 		xSemaphoreGive(USBCOMTxBufferMutex); // We have finished accessing the shared resource. Release the mutex.
@@ -460,51 +444,18 @@ USBD_StatusTypeDef USBComSendData(const uint8_t* sendData, const uint16_t sendDa
 }
 
 /**
- * @brief  Creates tasks used for USB communication
+ * @brief  Registers the USB com port RX work item (Tx is driven by the USB interrupt), like the UART one. The item is
+ *         posted once here, so that its first run starts the USB device.
  * @param  None
  * @retval None
  */
 void CreateUSBComTasks(void) {
-	/* USB Virtual Com Port Rx handler task creation
-	 * Task function pointer: USBComPortRXTask
-	 * Task name: USB_COM_RX
-	 * Stack depth: 3*configMINIMAL_STACK_SIZE
-	 * Parameter: NULL
-	 * Priority: USB_COM_RX_TASK_PRIO (0 to configMAX_PRIORITIES-1 possible)
-	 * Handle: USBComPortRxTaskHandle
-	 * */
-	if (pdPASS
-			!= xTaskCreate((pdTASK_CODE )USBComPortRXTask, (signed portCHAR*)"USB_COM_RX", 3*configMINIMAL_STACK_SIZE,
-					NULL, USB_COM_RX_TASK_PRIO, &USBComPortRxTaskHandle)) {
-		ErrorHandler();
-	}
-
-	/* USB Virtual Com Port Tx handler task creation
-	 * Task function pointer: USBComPortTXTask
-	 * Task name: USB_COM_TX
-	 * Stack depth: configMINIMAL_STACK_SIZE
-	 * Parameter: NULL
-	 * Priority: USB_COM_TX_THREAD_PRIO (0 to configMAX_PRIORITIES-1 possible)
-	 * Handle: USBComPortTxTaskHandle
-	 * */
-	if (pdPASS
-			!= xTaskCreate((pdTASK_CODE )USBComPortTXTask, (signed portCHAR*)"USB_COM_TX", 1*configMINIMAL_STACK_SIZE,
-					NULL, USB_COM_TX_TASK_PRIO, &USBComPortTxTaskHandle)) {
+	if (FCB_OK != DeferredWorkRegister("UsbComRx", HandleUSBComRxWork, NULL, DEFERRED_WORKER_LOW, &USBComRxWorkId)) {
 		ErrorHandler();
+		return;
 	}
-}
 
-/**
- * @brief  Creates RTOS queues used for USB communication
- * @param  None
- * @retval None
- */
-void CreateUSBComQueues(void) {
-	/* # Create queue for outgoing data ####################################### */
-	usbComTxQueue = xQueueCreate(USB_COM_TX_QUEUE_ITEMS, sizeof(ComTxQueueItem_TypeDef));
-
-	/* We want this queue to be viewable in a RTOS kernel aware debugger, so register it. */
-	vQueueAddToRegistry(usbComTxQueue, (signed portCHAR*) "usbComTxQueue");
+	DeferredWorkPost(USBComRxWorkId);
 }
 
 /**
@@ -513,22 +464,19 @@ void CreateUSBComQueues(void) {
  * @retval None
  */
 void CreateUSBComSemaphores(void) {
-	USBCOMRxDataSem = xSemaphoreCreateCounting(USB_RX_MAX_SEM_COUNT, 0);
-	if (USBCOMRxDataSem == NULL) {
-		ErrorHandler();
-	}
-
 	USBCOMTxBufferMutex = xSemaphoreCreateMutex();
 	if (USBCOMTxBufferMutex == NULL) {
 		ErrorHandler();
 	}
+	TRACE_OBJECT_NAME(USBCOMTxBufferMutex, "mUsbComTx");
 
-	/* Create mutex to protect USB CDC class output. The semaphore is taken when device is
-	 * transmitting (USB CDC busy) and given when transfer has completed. */
-	USBTxMutex = xSemaphoreCreateMutex();
-	if (USBTxMutex == NULL) {
+	/* Create binary semaphore given when a completed transmission has released room in the TX ring buffer, for a
+	 * sender waiting for it */
+	USBCOMTxSpaceSem = xSemaphoreCreateBinary();
+	if (USBCOMTxSpaceSem == NULL) {
 		ErrorHandler();
 	}
+	TRACE_OBJECT_NAME(USBCOMTxSpaceSem, "qUsbComTxSpace");
 }
 
 /**
@@ -29,6 +29,7 @@
 #include "stm32f3_discovery.h"
 #include "usbd_core.h"
 #include "usbd_cdc.h"
+#include "usbd_log_if.h"
 
 #include "FreeRTOS.h"
 
@@ -250,6 +251,14 @@ USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev) {
 	HAL_PCDEx_PMAConfig(pdev->pData, CDC_IN_EP, PCD_SNG_BUF, 0xC0);
 	HAL_PCDEx_PMAConfig(pdev->pData, CDC_OUT_EP, PCD_SNG_BUF, 0x110);
 	HAL_PCDEx_PMAConfig(pdev->pData, CDC_CMD_EP, PCD_SNG_BUF, 0x100);
+	/* 64 bytes of the packet memory after the CDC OUT buffer. Single buffered, the double buffered IN
+	 * path of this PCD driver version does not count multi-packet transfers right. */
+	HAL_PCDEx_PMAConfig(pdev->pData, USB_LOG_IN_EP, PCD_SNG_BUF, 0x150);
+#ifdef FCB_USB_MASS_STORAGE
+	/* The 112 bytes left of the 512 byte packet memory, a packet IN and a command block OUT */
+	HAL_PCDEx_PMAConfig(pdev->pData, USB_MSC_IN_EP, PCD_SNG_BUF, 0x190);
+	HAL_PCDEx_PMAConfig(pdev->pData, USB_MSC_OUT_EP, PCD_SNG_BUF, 0x1D0);
+#endif
 
 	return USBD_OK;
 }
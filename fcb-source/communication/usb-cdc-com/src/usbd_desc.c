@@ -29,6 +29,7 @@
 #include "usbd_core.h"
 #include "usbd_desc.h"
 #include "usbd_conf.h"
+#include "usbd_msc_if.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
@@ -66,15 +67,19 @@ USBD_DescriptorsTypeDef VCP_Desc = { USBD_VCP_DeviceDescriptor,
 const uint8_t hUSBDDeviceDesc[USB_LEN_DEV_DESC] = { 0x12, /* bLength */
 USB_DESC_TYPE_DEVICE, /* bDescriptorType */
 0x00, /* bcdUSB */
-0x02, 0x00, /* bDeviceClass */
-0x00, /* bDeviceSubClass */
-0x00, /* bDeviceProtocol */
+0x02, 0xEF, /* bDeviceClass: Miscellaneous, the CDC interfaces are grouped by an interface association descriptor */
+0x02, /* bDeviceSubClass: Common Class */
+0x01, /* bDeviceProtocol: Interface Association Descriptor */
 USB_MAX_EP0_SIZE, /* bMaxPacketSize */
 LOBYTE(USBD_VID), /* idVendor */
 HIBYTE(USBD_VID), /* idVendor */
 LOBYTE(USBD_PID), /* idVendor */
 HIBYTE(USBD_PID), /* idVendor */
-0x00, /* bcdDevice rel. 2.00 */
+#ifdef FCB_USB_MASS_STORAGE
+0x02, /* bcdDevice rel. 2.02, the composite device with mass storage, so that hosts do not use cached descriptors */
+#else
+0x01, /* bcdDevice rel. 2.01, the composite device, so that hosts do not use cached descriptors */
+#endif
 0x02,
 USBD_IDX_MFC_STR, /* Index of manufacturer string */
 USBD_IDX_PRODUCT_STR, /* Index of product string */
@@ -0,0 +1,459 @@
+/******************************************************************************
+ * @brief   USB log interface functions for the Dragonfly quadrotor UAV. The
+ *          log endpoint carries high rate binary data, e.g. telemetry frames,
+ *          past the CDC com port, so that it does not crowd out the CLI and
+ *          RPC replies. Data is buffered in the ring of the deferred logger
+ *          and sent by its task, each write in one transfer from the ring in
+ *          place, which the PCD driver splits into packets from its
+ *          interrupt. Data that does not fit in the ring is dropped and
+ *          counted, as when the host does not read the endpoint.
+ *
+ * @license
+ * Dragonfly FCB firmware to control the Dragonfly quadrotor UAV
+ * Copyright (C) 2016  ÅF Technology South: Dragonfly Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *****************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_log_if.h"
+
+#include "deferred_log.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private define ------------------------------------------------------------*/
+#define USB_DESC_TYPE_IAD               0x0B
+
+/* Private function prototypes -----------------------------------------------*/
+static uint8_t USBLogInit(USBD_HandleTypeDef* pdev, uint8_t cfgidx);
+static uint8_t USBLogDeInit(USBD_HandleTypeDef* pdev, uint8_t cfgidx);
+static uint8_t USBLogSetup(USBD_HandleTypeDef* pdev, USBD_SetupReqTypedef* req);
+static uint8_t USBLogDataIn(USBD_HandleTypeDef* pdev, uint8_t epnum);
+#ifdef FCB_USB_MASS_STORAGE
+static uint8_t USBLogDataOut(USBD_HandleTypeDef* pdev, uint8_t epnum);
+#endif
+static uint8_t* USBLogGetFSCfgDesc(uint16_t* length);
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Transfer state, used by the USB interrupt and by the log work item with the interrupt masked */
+static USBD_HandleTypeDef* USBLogDevice = NULL;
+static volatile bool USBLogIsConfigured = false;
+static volatile bool USBLogTxBusy = false;
+static bool USBLogTxNeedsZlp = false;
+
+static volatile uint32_t USBLogDroppedBytes = 0;
+
+/* The CDC class the composite class passes the com port requests and endpoints on to */
+static USBD_ClassTypeDef* USBLogCDCClass = NULL;
+
+/* The composite class, see USBLogCompositeClass() */
+static USBD_ClassTypeDef USBLogClass;
+
+/* USB composite device Configuration Descriptor */
+__ALIGN_BEGIN static uint8_t USBLogCfgFSDesc[USB_LOG_CONFIG_DESC_SIZ] __ALIGN_END = {
+/*Configuration Descriptor*/
+0x09, /* bLength: Configuration Descriptor size */
+USB_DESC_TYPE_CONFIGURATION, /* bDescriptorType: Configuration */
+LOBYTE(USB_LOG_CONFIG_DESC_SIZ), /* wTotalLength:no of returned bytes */
+HIBYTE(USB_LOG_CONFIG_DESC_SIZ),
+USB_LOG_NBR_OF_INTERFACES, /* bNumInterfaces */
+0x01, /* bConfigurationValue: Configuration value */
+0x00, /* iConfiguration: Index of string descriptor describing the configuration */
+0xC0, /* bmAttributes: self powered */
+0x32, /* MaxPower 100 mA */
+
+/*Interface Association Descriptor, the CDC function*/
+0x08, /* bLength: IAD size */
+USB_DESC_TYPE_IAD, /* bDescriptorType: Interface Association */
+0x00, /* bFirstInterface */
+0x02, /* bInterfaceCount */
+0x02, /* bFunctionClass: Communication Interface Class */
+0x02, /* bFunctionSubClass: Abstract Control Model */
+0x01, /* bFunctionProtocol: Common AT commands */
+0x00, /* iFunction */
+
+/*Interface Descriptor */
+0x09, /* bLength: Interface Descriptor size */
+USB_DESC_TYPE_INTERFACE, /* bDescriptorType: Interface */
+0x00, /* bInterfaceNumber: Number of Interface */
+0x00, /* bAlternateSetting: Alternate setting */
+0x01, /* bNumEndpoints: One endpoints used */
+0x02, /* bInterfaceClass: Communication Interface Class */
+0x02, /* bInterfaceSubClass: Abstract Control Model */
+0x01, /* bInterfaceProtocol: Common AT commands */
+0x00, /* iInterface: */
+
+/*Header Functional Descriptor*/
+0x05, /* bLength: Endpoint Descriptor size */
+0x24, /* bDescriptorType: CS_INTERFACE */
+0x00, /* bDescriptorSubtype: Header Func Desc */
+0x10, /* bcdCDC: spec release number */
+0x01,
+
+/*Call Management Functional Descriptor*/
+0x05, /* bFunctionLength */
+0x24, /* bDescriptorType: CS_INTERFACE */
+0x01, /* bDescriptorSubtype: Call Management Func Desc */
+0x00, /* bmCapabilities: D0+D1 */
+0x01, /* bDataInterface: 1 */
+
+/*ACM Functional Descriptor*/
+0x04, /* bFunctionLength */
+0x24, /* bDescriptorType: CS_INTERFACE */
+0x02, /* bDescriptorSubtype: Abstract Control Management desc */
+0x02, /* bmCapabilities */
+
+/*Union Functional Descriptor*/
+0x05, /* bFunctionLength */
+0x24, /* bDescriptorType: CS_INTERFACE */
+0x06, /* bDescriptorSubtype: Union func desc */
+0x00, /* bMasterInterface: Communication class interface */
+0x01, /* bSlaveInterface0: Data Class Interface */
+
+/*Endpoint 2 Descriptor*/
+0x07, /* bLength: Endpoint Descriptor size */
+USB_DESC_TYPE_ENDPOINT, /* bDescriptorType: Endpoint */
+CDC_CMD_EP, /* bEndpointAddress */
+0x03, /* bmAttributes: Interrupt */
+LOBYTE(CDC_CMD_PACKET_SIZE), /* wMaxPacketSize: */
+HIBYTE(CDC_CMD_PACKET_SIZE),
+0x10, /* bInterval: */
+
+/*Data class interface descriptor*/
+0x09, /* bLength: Endpoint Descriptor size */
+USB_DESC_TYPE_INTERFACE, /* bDescriptorType: */
+0x01, /* bInterfaceNumber: Number of Interface */
+0x00, /* bAlternateSetting: Alternate setting */
+0x02, /* bNumEndpoints: Two endpoints used */
+0x0A, /* bInterfaceClass: CDC */
+0x00, /* bInterfaceSubClass: */
+0x00, /* bInterfaceProtocol: */
+0x00, /* iInterface: */
+
+/*Endpoint OUT Descriptor*/
+0x07, /* bLength: Endpoint Descriptor size */
+USB_DESC_TYPE_ENDPOINT, /* bDescriptorType: Endpoint */
+CDC_OUT_EP, /* bEndpointAddress */
+0x02, /* bmAttributes: Bulk */
+LOBYTE(CDC_DATA_FS_MAX_PACKET_SIZE), /* wMaxPacketSize: */
+HIBYTE(CDC_DATA_FS_MAX_PACKET_SIZE),
+0x00, /* bInterval: ignore for Bulk transfer */
+
+/*Endpoint IN Descriptor*/
+0x07, /* bLength: Endpoint Descriptor size */
+USB_DESC_TYPE_ENDPOINT, /* bDescriptorType: Endpoint */
+CDC_IN_EP, /* bEndpointAddress */
+0x02, /* bmAttributes: Bulk */
+LOBYTE(CDC_DATA_FS_MAX_PACKET_SIZE), /* wMaxPacketSize: */
+HIBYTE(CDC_DATA_FS_MAX_PACKET_SIZE),
+0x00, /* bInterval: ignore for Bulk transfer */
+
+/*Log interface descriptor*/
+0x09, /* bLength: Interface Descriptor size */
+USB_DESC_TYPE_INTERFACE, /* bDescriptorType: Interface */
+USB_LOG_INTERFACE, /* bInterfaceNumber: Number of Interface */
+0x00, /* bAlternateSetting: Alternate setting */
+0x01, /* bNumEndpoints: One endpoint used */
+0xFF, /* bInterfaceClass: Vendor specific */
+0x00, /* bInterfaceSubClass: */
+0x00, /* bInterfaceProtocol: */
+0x00, /* iInterface: */
+
+/*Log Endpoint IN Descriptor*/
+0x07, /* bLength: Endpoint Descriptor size */
+USB_DESC_TYPE_ENDPOINT, /* bDescriptorType: Endpoint */
+USB_LOG_IN_EP, /* bEndpointAddress */
+0x02, /* bmAttributes: Bulk */
+LOBYTE(USB_LOG_FS_PACKET_SIZE), /* wMaxPacketSize: */
+HIBYTE(USB_LOG_FS_PACKET_SIZE),
+0x00, /* bInterval: ignore for Bulk transfer */
+#ifdef FCB_USB_MASS_STORAGE
+
+/*Mass storage interface descriptor*/
+0x09, /* bLength: Interface Descriptor size */
+USB_DESC_TYPE_INTERFACE, /* bDescriptorType: Interface */
+USB_MSC_INTERFACE, /* bInterfaceNumber: Number of Interface */
+0x00, /* bAlternateSetting: Alternate setting */
+0x02, /* bNumEndpoints: Two endpoints used */
+0x08, /* bInterfaceClass: Mass storage */
+0x06, /* bInterfaceSubClass: SCSI transparent command set */
+0x50, /* bInterfaceProtocol: Bulk-only transport */
+0x00, /* iInterface: */
+
+/*Mass storage Endpoint IN Descriptor*/
+0x07, /* bLength: Endpoint Descriptor size */
+USB_DESC_TYPE_ENDPOINT, /* bDescriptorType: Endpoint */
+USB_MSC_IN_EP, /* bEndpointAddress */
+0x02, /* bmAttributes: Bulk */
+LOBYTE(USB_MSC_IN_PACKET_SIZE), /* wMaxPacketSize: */
+HIBYTE(USB_MSC_IN_PACKET_SIZE),
+0x00, /* bInterval: ignore for Bulk transfer */
+
+/*Mass storage Endpoint OUT Descriptor*/
+0x07, /* bLength: Endpoint Descriptor size */
+USB_DESC_TYPE_ENDPOINT, /* bDescriptorType: Endpoint */
+USB_MSC_OUT_EP, /* bEndpointAddress */
+0x02, /* bmAttributes: Bulk */
+LOBYTE(USB_MSC_OUT_PACKET_SIZE), /* wMaxPacketSize: */
+HIBYTE(USB_MSC_OUT_PACKET_SIZE),
+0x00, /* bInterval: ignore for Bulk transfer */
+#endif
+};
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief  Composite class Init callback, on the set configuration request. Opens the CDC endpoints and the log
+ *         endpoint. Function called from ISR.
+ * @param  pdev: device instance
+ * @param  cfgidx: Configuration index
+ * @retval Result of the CDC class callback
+ */
+static uint8_t USBLogInit(USBD_HandleTypeDef* pdev, uint8_t cfgidx) {
+	uint8_t result = USBLogCDCClass->Init(pdev, cfgidx);
+
+	USBD_LL_OpenEP(pdev, USB_LOG_IN_EP, USBD_EP_TYPE_BULK, USB_LOG_FS_PACKET_SIZE);
+
+	USBLogDevice = pdev;
+	USBLogTxBusy = false;
+	USBLogTxNeedsZlp = false;
+	USBLogIsConfigured = true;
+
+#ifdef FCB_USB_MASS_STORAGE
+	USBMscInit(pdev);
+#endif
+
+	return result;
+}
+
+/**
+ * @brief  Composite class DeInit callback. A transfer in progress is dropped, the log work item is posted to release
+ *         its data. Function called from ISR.
+ * @param  pdev: device instance
+ * @param  cfgidx: Configuration index
+ * @retval Result of the CDC class callback
+ */
+static uint8_t USBLogDeInit(USBD_HandleTypeDef* pdev, uint8_t cfgidx) {
+	USBLogIsConfigured = false;
+	if (USBLogTxBusy) {
+		USBLogTxBusy = false;
+		LogDataSentFromISR();
+	}
+
+	USBD_LL_CloseEP(pdev, USB_LOG_IN_EP);
+
+#ifdef FCB_USB_MASS_STORAGE
+	USBMscDeInit(pdev);
+#endif
+
+	return USBLogCDCClass->DeInit(pdev, cfgidx);
+}
+
+/**
+ * @brief  Composite class Setup callback. The log interface has no class or vendor requests, the mass storage
+ *         interface and endpoint requests are passed to it, the other requests are the CDC ones. Function called from
+ *         ISR.
+ * @param  pdev: device instance
+ * @param  req: usb request
+ * @retval Result of the operation
+ */
+static uint8_t USBLogSetup(USBD_HandleTypeDef* pdev, USBD_SetupReqTypedef* req) {
+#ifdef FCB_USB_MASS_STORAGE
+	if (((req->bmRequest & USB_REQ_RECIPIENT_MASK) == USB_REQ_RECIPIENT_INTERFACE
+			&& LOBYTE(req->wIndex) == USB_MSC_INTERFACE)
+			|| ((req->bmRequest & USB_REQ_RECIPIENT_MASK) == USB_REQ_RECIPIENT_ENDPOINT
+			&& (LOBYTE(req->wIndex) & 0x7F) == (USB_MSC_IN_EP & 0x7F))) {
+		return USBMscSetup(pdev, req);
+	}
+#endif
+
+	if ((req->bmRequest & USB_REQ_RECIPIENT_MASK) == USB_REQ_RECIPIENT_INTERFACE
+			&& LOBYTE(req->wIndex) == USB_LOG_INTERFACE) {
+		if ((req->bmRequest & USB_REQ_TYPE_MASK) != USB_REQ_TYPE_STANDARD && req->wLength > 0) {
+			USBD_CtlError(pdev, req);
+			return USBD_FAIL;
+		}
+		return USBD_OK;
+	}
+
+	return USBLogCDCClass->Setup(pdev, req);
+}
+
+/**
+ * @brief  Composite class IN endpoint completion callback. Ends a transfer of whole packets with a zero-length packet
+ *         and posts the log work item to release the sent data, the mass storage and CDC endpoint completions are
+ *         passed on. Function called from ISR.
+ * @param  pdev: device instance
+ * @param  epnum: endpoint number
+ * @retval Result of the operation
+ */
+static uint8_t USBLogDataIn(USBD_HandleTypeDef* pdev, uint8_t epnum) {
+#ifdef FCB_USB_MASS_STORAGE
+	if (epnum == (USB_MSC_IN_EP & 0x7F)) {
+		USBMscDataIn(pdev);
+		return USBD_OK;
+	}
+#endif
+
+	if (epnum != (USB_LOG_IN_EP & 0x7F)) {
+		return USBLogCDCClass->DataIn(pdev, epnum);
+	}
+
+	/* A transfer of whole packets is only seen as complete by the host after a short packet */
+	if (USBLogTxNeedsZlp) {
+		USBLogTxNeedsZlp = false;
+		USBD_LL_Transmit(pdev, USB_LOG_IN_EP, NULL, 0);
+		return USBD_OK;
+	}
+
+	USBLogTxBusy = false;
+	LogDataSentFromISR();
+
+	return USBD_OK;
+}
+
+#ifdef FCB_USB_MASS_STORAGE
+/**
+ * @brief  Composite class OUT endpoint completion callback. The mass storage command blocks are passed to it, the
+ *         CDC data to the CDC class. Function called from ISR.
+ * @param  pdev: device instance
+ * @param  epnum: endpoint number
+ * @retval Result of the operation
+ */
+static uint8_t USBLogDataOut(USBD_HandleTypeDef* pdev, uint8_t epnum) {
+	if (epnum == USB_MSC_OUT_EP) {
+		USBMscDataOut(pdev);
+		return USBD_OK;
+	}
+
+	return USBLogCDCClass->DataOut(pdev, epnum);
+}
+#endif
+
+/**
+ * @brief  Returns the composite configuration descriptor
+ * @param  length : pointer data length
+ * @retval pointer to descriptor buffer
+ */
+static uint8_t* USBLogGetFSCfgDesc(uint16_t* length) {
+	*length = sizeof(USBLogCfgFSDesc);
+	return USBLogCfgFSDesc;
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+ * @brief  Makes the composite class of the CDC com port, the log interface and, with FCB_USB_MASS_STORAGE, the mass
+ *         storage interface, to register with the device
+ * @param  cdcClass: The CDC class for the com port interfaces
+ * @retval The composite class
+ */
+USBD_ClassTypeDef* USBLogCompositeClass(USBD_ClassTypeDef* cdcClass) {
+	USBLogCDCClass = cdcClass;
+
+	USBLogClass = *cdcClass;
+	USBLogClass.Init = USBLogInit;
+	USBLogClass.DeInit = USBLogDeInit;
+	USBLogClass.Setup = USBLogSetup;
+	USBLogClass.DataIn = USBLogDataIn;
+#ifdef FCB_USB_MASS_STORAGE
+	USBLogClass.DataOut = USBLogDataOut;
+#endif
+	USBLogClass.GetFSConfigDescriptor = USBLogGetFSCfgDesc;
+
+	return &USBLogClass;
+}
+
+/**
+ * @brief  Send data over the USB log endpoint. The data is buffered in the ring of the deferred logger and the call
+ *         does not wait for it to be sent. May be called from an ISR.
+ * @param  sendData : Reference to the data to be sent
+ * @param  sendDataSize : Size of data to be sent, at most LOG_DATA_MAX_SIZE
+ * @retval Result of the operation: USBD_OK if the data was buffered, else USBD_FAIL (USB not configured, or no room
+ *         in the log ring, the data is dropped)
+ */
+USBD_StatusTypeDef USBLogSendData(const uint8_t* sendData, const uint16_t sendDataSize) {
+	uint32_t primask;
+
+	if (!USBLogIsConfigured) {
+		return USBD_FAIL;
+	}
+
+	if (!LogRecordData(sendData, sendDataSize)) {
+		primask = __get_PRIMASK();
+		__disable_irq();
+		USBLogDroppedBytes += sendDataSize;
+		__set_PRIMASK(primask);
+		return USBD_FAIL;
+	}
+
+	return USBD_OK;
+}
+
+/**
+ * @brief  Starts a transfer over the USB log endpoint, the data must stay in place until USBLogIsSending() is false.
+ *         Called by the log work item.
+ * @param  data : Reference to the data to be sent
+ * @param  size : Size of data to be sent
+ * @retval USBD_OK if started, else USBD_FAIL (USB not configured or a transfer in progress)
+ */
+USBD_StatusTypeDef USBLogTransmit(const uint8_t* data, const uint16_t size) {
+	USBD_StatusTypeDef result = USBD_FAIL;
+
+	/* The transfer state is shared with the USB interrupt */
+	taskENTER_CRITICAL();
+	if (USBLogIsConfigured && !USBLogTxBusy) {
+		USBLogTxBusy = true;
+		USBLogTxNeedsZlp = (0 == size % USB_LOG_FS_PACKET_SIZE);
+		USBD_LL_Transmit(USBLogDevice, USB_LOG_IN_EP, (uint8_t*) data, size);
+		result = USBD_OK;
+	}
+	taskEXIT_CRITICAL();
+
+	return result;
+}
+
+/**
+ * @brief  Checks if a transfer over the USB log endpoint is in progress
+ * @param  None
+ * @retval true until the transfer started by USBLogTransmit() is done or dropped, else false
+ */
+bool USBLogIsSending(void) {
+	return USBLogTxBusy;
+}
+
+/**
+ * @brief  Gets the number of log bytes dropped because the log buffer was full
+ * @param  None
+ * @retval Number of dropped bytes since start up
+ */
+uint32_t GetUSBLogDroppedBytes(void) {
+	return USBLogDroppedBytes;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+
+/*****END OF FILE****/
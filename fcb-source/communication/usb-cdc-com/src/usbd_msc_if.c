@@ -0,0 +1,737 @@
+/******************************************************************************
+ * @brief   USB mass storage interface functions for the Dragonfly quadrotor
+ *          UAV. A compact bulk-only transport of a single read-only SCSI disk,
+ *          the volume of msc_volume.h. The vendored MSC class of the device
+ *          library is not used, it takes the CDC endpoints and the class data
+ *          of the device, which the composite class of usbd_log_if.c shares.
+ *
+ *          The USB interrupt receives the command blocks and the transfer
+ *          completions and posts the mass storage work, which runs the SCSI
+ *          commands and reads the sectors in task context on the low deferred
+ *          worker, a sector per transfer. The transfers from the work are
+ *          started with the USB interrupt masked, as for the log interface.
+ *
+ *          The medium is inserted on request while the UAV is disarmed, which
+ *          takes the layout of the volume, and is ejected on request, by the
+ *          host or when the UAV is armed, so the host reads no flash while
+ *          the UAV flies. The disk reports write protection, and writes fail.
+ *
+ * @license
+ * Dragonfly FCB firmware to control the Dragonfly quadrotor UAV
+ * Copyright (C) 2016  ÅF Technology South: Dragonfly Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *****************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_msc_if.h"
+
+#ifdef FCB_USB_MASS_STORAGE
+
+#include "usbd_ctlreq.h"
+#include "usbd_ioreq.h"
+#include "msc_volume.h"
+#include "flight_mode.h"
+#include "deferred_work.h"
+#include "deferred_log.h"
+#include "fcb_error.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Private typedef -----------------------------------------------------------*/
+
+typedef enum {
+	USB_MSC_BOT_IDLE = 0,           // Waiting for a command block
+	USB_MSC_BOT_COMMAND,            // A command block was received, the work runs it
+	USB_MSC_BOT_DATA_IN,            // Sending data, the work sends the next sector or the status on completion
+	USB_MSC_BOT_STATUS,             // Sending the status
+	USB_MSC_BOT_STALLED_STATUS,     // The data stage ended with a stall, the status is sent once the host clears it
+	USB_MSC_BOT_ERROR               // Invalid command block, the endpoints stay stalled until a reset
+} USBMscBotState_TypeDef;
+
+/* The command being run, used by the work and, in USB_MSC_BOT_STALLED_STATUS, by the USB interrupt */
+typedef struct {
+	uint32_t tag;                   // Of the command block, returned with the status
+	uint32_t dataLength;            // The host expects [bytes]
+	uint32_t sentBytes;
+	uint32_t lba;                   // Next sector to read
+	uint16_t blocks;                // Sectors left to read
+	bool isDataIn;
+	uint8_t status;                 // USB_MSC_CSW_STATUS_*
+} USBMscCommand_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define USB_MSC_CBW_SIGNATURE           0x43425355
+#define USB_MSC_CBW_SIZE                31
+#define USB_MSC_CSW_SIGNATURE           0x53425355
+#define USB_MSC_CSW_SIZE                13
+#define USB_MSC_CSW_STATUS_PASSED       0x00
+#define USB_MSC_CSW_STATUS_FAILED       0x01
+#define USB_MSC_CSW_STATUS_PHASE_ERROR  0x02
+
+#define USB_MSC_REQ_GET_MAX_LUN         0xFE
+#define USB_MSC_REQ_RESET               0xFF
+
+/* SCSI operation codes */
+#define SCSI_TEST_UNIT_READY            0x00
+#define SCSI_REQUEST_SENSE              0x03
+#define SCSI_INQUIRY                    0x12
+#define SCSI_MODE_SENSE6                0x1A
+#define SCSI_START_STOP_UNIT            0x1B
+#define SCSI_PREVENT_ALLOW_REMOVAL      0x1E
+#define SCSI_READ_FORMAT_CAPACITIES     0x23
+#define SCSI_READ_CAPACITY10            0x25
+#define SCSI_READ10                     0x28
+#define SCSI_WRITE10                    0x2A
+#define SCSI_VERIFY10                   0x2F
+#define SCSI_SYNCHRONIZE_CACHE10        0x35
+#define SCSI_MODE_SENSE10               0x5A
+
+/* Sense keys and additional sense codes */
+#define SCSI_SENSE_NONE                 0x00
+#define SCSI_SENSE_NOT_READY            0x02
+#define SCSI_SENSE_ILLEGAL_REQUEST      0x05
+#define SCSI_SENSE_UNIT_ATTENTION       0x06
+#define SCSI_SENSE_DATA_PROTECT         0x07
+#define SCSI_ASC_INVALID_COMMAND        0x20
+#define SCSI_ASC_LBA_OUT_OF_RANGE       0x21
+#define SCSI_ASC_INVALID_FIELD_IN_CDB   0x24
+#define SCSI_ASC_WRITE_PROTECTED        0x27
+#define SCSI_ASC_MEDIUM_CHANGED         0x28
+#define SCSI_ASC_MEDIUM_NOT_PRESENT     0x3A
+
+#define SCSI_INQUIRY_SIZE               36
+#define SCSI_REQUEST_SENSE_SIZE         18
+#define SCSI_MODE_SENSE6_SIZE           4
+#define SCSI_MODE_SENSE10_SIZE          8
+#define SCSI_READ_CAPACITY10_SIZE       8
+#define SCSI_READ_FORMAT_CAPACITIES_SIZE 12
+#define SCSI_MODE_WRITE_PROTECT         0x80    // In the device specific parameter of the mode parameter header
+
+/* Private macro -------------------------------------------------------------*/
+#define GET_BE16(P)                     ((uint16_t) ((P)[0] << 8 | (P)[1]))
+#define GET_BE32(P)                     ((uint32_t) (P)[0] << 24 | (uint32_t) (P)[1] << 16 | (uint32_t) (P)[2] << 8 \
+		| (uint32_t) (P)[3])
+#define GET_LE32(P)                     ((uint32_t) (P)[3] << 24 | (uint32_t) (P)[2] << 16 | (uint32_t) (P)[1] << 8 \
+		| (uint32_t) (P)[0])
+
+/* Private function prototypes -----------------------------------------------*/
+static void USBMscWork(void* argument);
+static void ExecuteCommand(void);
+static void ContinueDataIn(void);
+static void FinishCommand(const USBMscBotState_TypeDef expectedState);
+static bool StartDataIn(const USBMscBotState_TypeDef expectedState, const uint16_t size);
+static bool ReadNextSector(void);
+static void SendStatus(void);
+static void ReceiveCommand(void);
+static bool IsMediumInserted(void);
+static bool IsMediumReady(void);
+static void FailCommand(const uint8_t key, const uint8_t asc);
+static void PutBe32(uint8_t* dst, const uint32_t value);
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Transport state, shared by the USB interrupt and the work, which changes it with the interrupt masked */
+static USBD_HandleTypeDef* USBMscDevice = NULL;
+static volatile bool USBMscIsConfigured = false;
+static volatile USBMscBotState_TypeDef USBMscBotState = USB_MSC_BOT_IDLE;
+static volatile bool USBMscIsTxDone = false;
+
+static USBMscCommand_TypeDef USBMscCommand;
+
+/* Medium, requested by USBMscSetMedium() and inserted or ejected by the work */
+static volatile bool USBMscIsMediumRequested = false;
+static bool USBMscIsInserted = false;
+static bool USBMscIsUnitAttention = false;
+static uint8_t USBMscSenseKey = SCSI_SENSE_NONE;
+static uint8_t USBMscSenseCode = 0;
+
+static uint32_t USBMscCommands = 0;
+static uint32_t USBMscReadSectors = 0;
+static uint32_t USBMscFailedCommands = 0;
+
+static DeferredWorkId_TypeDef USBMscWorkId = DEFERRED_WORK_INVALID_ID;
+
+static uint8_t USBMscMaxLun = 0;
+static uint8_t USBMscAltSetting = 0;
+
+__ALIGN_BEGIN static uint8_t USBMscCbw[USB_MSC_OUT_PACKET_SIZE] __ALIGN_END;
+__ALIGN_BEGIN static uint8_t USBMscCsw[USB_MSC_CSW_SIZE] __ALIGN_END;
+__ALIGN_BEGIN static uint8_t USBMscDataBuffer[MSC_VOLUME_SECTOR_SIZE] __ALIGN_END;
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief  Mass storage work, posted on a command block, a data transfer completion and a medium request. Inserts or
+ *         ejects the medium, and runs the command or sends the next sector.
+ * @param  argument: Not used
+ * @retval None
+ */
+static void USBMscWork(void* argument) {
+	USBMscBotState_TypeDef state;
+	bool isTxDone;
+
+	(void) argument;
+
+	if (USBMscIsMediumRequested && !USBMscIsInserted && FLIGHT_MODE_DISARMED == GetFlightModeState()) {
+		MscVolumeMount();
+		USBMscIsInserted = true;
+		USBMscIsUnitAttention = true;
+		LOG1("USB mass storage medium inserted, %u files", GetMscVolumeFiles());
+	} else if (!USBMscIsMediumRequested && USBMscIsInserted) {
+		USBMscIsInserted = false;
+		LOG0("USB mass storage medium ejected");
+	}
+
+	taskENTER_CRITICAL();
+	state = USBMscBotState;
+	isTxDone = USBMscIsTxDone;
+	USBMscIsTxDone = false;
+	taskEXIT_CRITICAL();
+
+	if (USB_MSC_BOT_COMMAND == state) {
+		ExecuteCommand();
+	} else if (USB_MSC_BOT_DATA_IN == state && isTxDone) {
+		ContinueDataIn();
+	}
+}
+
+/**
+ * @brief  Runs the SCSI command of the received command block and starts its data stage or sends its status
+ * @param  None
+ * @retval None
+ */
+static void ExecuteCommand(void) {
+	const uint8_t* cdb = &USBMscCbw[15];
+	uint16_t responseSize = 0;
+	uint32_t allocationLength = 0;
+	uint8_t opCode = cdb[0];
+
+	USBMscCommands++;
+
+	memset(&USBMscCommand, 0, sizeof(USBMscCommand));
+	USBMscCommand.tag = GET_LE32(&USBMscCbw[4]);
+	USBMscCommand.dataLength = GET_LE32(&USBMscCbw[8]);
+	USBMscCommand.isDataIn = 0 != (USBMscCbw[12] & 0x80);
+	USBMscCommand.status = USB_MSC_CSW_STATUS_PASSED;
+
+	memset(USBMscDataBuffer, 0, sizeof(USBMscDataBuffer));
+
+	/* The host is told of an inserted medium once, on the first command that is not for the device itself */
+	if (USBMscIsUnitAttention && SCSI_INQUIRY != opCode && SCSI_REQUEST_SENSE != opCode) {
+		USBMscIsUnitAttention = false;
+		if (IsMediumInserted()) {
+			FailCommand(SCSI_SENSE_UNIT_ATTENTION, SCSI_ASC_MEDIUM_CHANGED);
+			FinishCommand(USB_MSC_BOT_COMMAND);
+			return;
+		}
+	}
+
+	switch (opCode) {
+	case SCSI_TEST_UNIT_READY:
+	case SCSI_VERIFY10:
+		IsMediumReady();
+		break;
+	case SCSI_REQUEST_SENSE:
+		USBMscDataBuffer[0] = 0x70; // Current error, fixed format
+		USBMscDataBuffer[2] = USBMscSenseKey;
+		USBMscDataBuffer[7] = SCSI_REQUEST_SENSE_SIZE - 8;
+		USBMscDataBuffer[12] = USBMscSenseCode;
+		responseSize = SCSI_REQUEST_SENSE_SIZE;
+		allocationLength = cdb[4];
+		USBMscSenseKey = SCSI_SENSE_NONE;
+		USBMscSenseCode = 0;
+		break;
+	case SCSI_INQUIRY:
+		if (cdb[1] & 0x01) {
+			/* No vital product data pages */
+			FailCommand(SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_FIELD_IN_CDB);
+			break;
+		}
+		USBMscDataBuffer[0] = 0x00; // Direct access block device
+		USBMscDataBuffer[1] = 0x80; // Removable medium
+		USBMscDataBuffer[2] = 0x02;
+		USBMscDataBuffer[3] = 0x02;
+		USBMscDataBuffer[4] = SCSI_INQUIRY_SIZE - 5;
+		memcpy(&USBMscDataBuffer[8], "Dragonfl", 8);
+		memcpy(&USBMscDataBuffer[16], "FCB logs & setup", 16);
+		memcpy(&USBMscDataBuffer[32], "1.0 ", 4);
+		responseSize = SCSI_INQUIRY_SIZE;
+		allocationLength = GET_BE16(&cdb[3]);
+		break;
+	case SCSI_MODE_SENSE6:
+		USBMscDataBuffer[0] = SCSI_MODE_SENSE6_SIZE - 1;
+		USBMscDataBuffer[2] = SCSI_MODE_WRITE_PROTECT;
+		responseSize = SCSI_MODE_SENSE6_SIZE;
+		allocationLength = cdb[4];
+		break;
+	case SCSI_MODE_SENSE10:
+		USBMscDataBuffer[1] = SCSI_MODE_SENSE10_SIZE - 2;
+		USBMscDataBuffer[3] = SCSI_MODE_WRITE_PROTECT;
+		responseSize = SCSI_MODE_SENSE10_SIZE;
+		allocationLength = GET_BE16(&cdb[7]);
+		break;
+	case SCSI_START_STOP_UNIT:
+		/* Load eject bit without the start bit, the host ejects the medium */
+		if (0x02 == (cdb[4] & 0x03)) {
+			USBMscIsMediumRequested = false;
+			if (USBMscIsInserted) {
+				USBMscIsInserted = false;
+				LOG0("USB mass storage medium ejected by the host");
+			}
+		}
+		break;
+	case SCSI_PREVENT_ALLOW_REMOVAL:
+	case SCSI_SYNCHRONIZE_CACHE10:
+		break;
+	case SCSI_READ_FORMAT_CAPACITIES:
+		USBMscDataBuffer[3] = SCSI_READ_FORMAT_CAPACITIES_SIZE - 4;
+		PutBe32(&USBMscDataBuffer[4], MSC_VOLUME_NBR_OF_SECTORS);
+		USBMscDataBuffer[8] = IsMediumInserted() ? 0x02 : 0x03; // Formatted medium, or no medium
+		USBMscDataBuffer[10] = (uint8_t) (MSC_VOLUME_SECTOR_SIZE >> 8);
+		USBMscDataBuffer[11] = (uint8_t) MSC_VOLUME_SECTOR_SIZE;
+		responseSize = SCSI_READ_FORMAT_CAPACITIES_SIZE;
+		allocationLength = GET_BE16(&cdb[7]);
+		break;
+	case SCSI_READ_CAPACITY10:
+		if (IsMediumReady()) {
+			PutBe32(&USBMscDataBuffer[0], MSC_VOLUME_NBR_OF_SECTORS - 1);
+			PutBe32(&USBMscDataBuffer[4], MSC_VOLUME_SECTOR_SIZE);
+			responseSize = SCSI_READ_CAPACITY10_SIZE;
+			allocationLength = SCSI_READ_CAPACITY10_SIZE;
+		}
+		break;
+	case SCSI_READ10:
+		if (!IsMediumReady()) {
+			break;
+		}
+		USBMscCommand.lba = GET_BE32(&cdb[2]);
+		USBMscCommand.blocks = GET_BE16(&cdb[7]);
+		if (USBMscCommand.lba > MSC_VOLUME_NBR_OF_SECTORS
+				|| USBMscCommand.blocks > MSC_VOLUME_NBR_OF_SECTORS - USBMscCommand.lba) {
+			USBMscCommand.blocks = 0;
+			FailCommand(SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_LBA_OUT_OF_RANGE);
+		} else if (!USBMscCommand.isDataIn
+				|| USBMscCommand.dataLength < (uint32_t) USBMscCommand.blocks*MSC_VOLUME_SECTOR_SIZE) {
+			/* The host expects less data than it asks for, it recovers with a reset */
+			USBMscCommand.blocks = 0;
+			USBMscCommand.status = USB_MSC_CSW_STATUS_PHASE_ERROR;
+			USBMscFailedCommands++;
+		}
+		break;
+	case SCSI_WRITE10:
+		FailCommand(SCSI_SENSE_DATA_PROTECT, SCSI_ASC_WRITE_PROTECTED);
+		break;
+	default:
+		FailCommand(SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_COMMAND);
+		break;
+	}
+
+	if (USBMscCommand.blocks > 0) {
+		if (ReadNextSector()) {
+			StartDataIn(USB_MSC_BOT_COMMAND, MSC_VOLUME_SECTOR_SIZE);
+		} else {
+			FinishCommand(USB_MSC_BOT_COMMAND);
+		}
+		return;
+	}
+
+	if (USB_MSC_CSW_STATUS_PASSED == USBMscCommand.status && responseSize > 0 && USBMscCommand.isDataIn) {
+		if (responseSize > allocationLength) {
+			responseSize = (uint16_t) allocationLength;
+		}
+		if (responseSize > USBMscCommand.dataLength) {
+			responseSize = (uint16_t) USBMscCommand.dataLength;
+		}
+		if (responseSize > 0) {
+			StartDataIn(USB_MSC_BOT_COMMAND, responseSize);
+			return;
+		}
+	}
+
+	FinishCommand(USB_MSC_BOT_COMMAND);
+}
+
+/**
+ * @brief  Sends the next sector of a read after a data transfer, or ends the data stage
+ * @param  None
+ * @retval None
+ */
+static void ContinueDataIn(void) {
+	if (USBMscCommand.blocks > 0) {
+		if (ReadNextSector()) {
+			StartDataIn(USB_MSC_BOT_DATA_IN, MSC_VOLUME_SECTOR_SIZE);
+			return;
+		}
+	}
+
+	FinishCommand(USB_MSC_BOT_DATA_IN);
+}
+
+/**
+ * @brief  Ends a command. If the host expects more data than was sent, the data endpoint is stalled and the status
+ *         is sent once the host has cleared it, else the status is sent now. Not done if the state changed, e.g. on
+ *         a reset by the host.
+ * @param  expectedState: State of the command
+ * @retval None
+ */
+static void FinishCommand(const USBMscBotState_TypeDef expectedState) {
+	taskENTER_CRITICAL();
+	if (USBMscIsConfigured && expectedState == USBMscBotState) {
+		if (USBMscCommand.dataLength > USBMscCommand.sentBytes) {
+			if (!USBMscCommand.isDataIn) {
+				USBD_LL_StallEP(USBMscDevice, USB_MSC_OUT_EP);
+			}
+			USBD_LL_StallEP(USBMscDevice, USB_MSC_IN_EP);
+			USBMscBotState = USB_MSC_BOT_STALLED_STATUS;
+		} else {
+			SendStatus();
+		}
+	}
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief  Sends the data buffer to the host, unless the state changed
+ * @param  expectedState: State of the command
+ * @param  size: Bytes to send
+ * @retval true if started
+ */
+static bool StartDataIn(const USBMscBotState_TypeDef expectedState, const uint16_t size) {
+	bool isStarted = false;
+
+	taskENTER_CRITICAL();
+	if (USBMscIsConfigured && expectedState == USBMscBotState) {
+		USBMscBotState = USB_MSC_BOT_DATA_IN;
+		USBMscCommand.sentBytes += size;
+		USBD_LL_Transmit(USBMscDevice, USB_MSC_IN_EP, USBMscDataBuffer, size);
+		isStarted = true;
+	}
+	taskEXIT_CRITICAL();
+
+	return isStarted;
+}
+
+/**
+ * @brief  Reads the next sector of a read command to the data buffer. A medium ejected during the read, e.g. by
+ *         arming, fails the command.
+ * @param  None
+ * @retval true if read
+ */
+static bool ReadNextSector(void) {
+	if (!IsMediumReady() || FCB_OK != MscVolumeReadSector(USBMscCommand.lba, USBMscDataBuffer)) {
+		USBMscCommand.blocks = 0;
+		if (USB_MSC_CSW_STATUS_PASSED == USBMscCommand.status) {
+			FailCommand(SCSI_SENSE_NOT_READY, SCSI_ASC_MEDIUM_NOT_PRESENT);
+		}
+		return false;
+	}
+
+	USBMscCommand.lba++;
+	USBMscCommand.blocks--;
+	USBMscReadSectors++;
+	return true;
+}
+
+/**
+ * @brief  Sends the command status. Called from the USB interrupt, or with it masked.
+ * @param  None
+ * @retval None
+ */
+static void SendStatus(void) {
+	uint32_t residue = USBMscCommand.dataLength - USBMscCommand.sentBytes;
+
+	if (USBMscCommand.sentBytes > USBMscCommand.dataLength) {
+		residue = 0;
+	}
+
+	USBMscCsw[0] = (uint8_t) USB_MSC_CSW_SIGNATURE;
+	USBMscCsw[1] = (uint8_t) (USB_MSC_CSW_SIGNATURE >> 8);
+	USBMscCsw[2] = (uint8_t) (USB_MSC_CSW_SIGNATURE >> 16);
+	USBMscCsw[3] = (uint8_t) (USB_MSC_CSW_SIGNATURE >> 24);
+	memcpy(&USBMscCsw[4], &USBMscCommand.tag, 4); // Returned as received, little endian
+	USBMscCsw[8] = (uint8_t) residue;
+	USBMscCsw[9] = (uint8_t) (residue >> 8);
+	USBMscCsw[10] = (uint8_t) (residue >> 16);
+	USBMscCsw[11] = (uint8_t) (residue >> 24);
+	USBMscCsw[12] = USBMscCommand.status;
+
+	USBMscBotState = USB_MSC_BOT_STATUS;
+	USBD_LL_Transmit(USBMscDevice, USB_MSC_IN_EP, USBMscCsw, USB_MSC_CSW_SIZE);
+}
+
+/**
+ * @brief  Waits for the next command block. Called from the USB interrupt.
+ * @param  None
+ * @retval None
+ */
+static void ReceiveCommand(void) {
+	USBMscBotState = USB_MSC_BOT_IDLE;
+	USBMscIsTxDone = false;
+	USBD_LL_PrepareReceive(USBMscDevice, USB_MSC_OUT_EP, USBMscCbw, USB_MSC_OUT_PACKET_SIZE);
+}
+
+/**
+ * @brief  Checks that the medium is inserted, and ejects it if the UAV is no longer disarmed
+ * @param  None
+ * @retval true if inserted
+ */
+static bool IsMediumInserted(void) {
+	if (USBMscIsInserted && FLIGHT_MODE_DISARMED != GetFlightModeState()) {
+		USBMscIsInserted = false;
+		USBMscIsMediumRequested = false;
+		LOG0("USB mass storage medium ejected, the UAV is armed");
+	}
+
+	return USBMscIsInserted;
+}
+
+/**
+ * @brief  Checks that the medium is inserted for a command that needs it
+ * @param  None
+ * @retval true if inserted, else the command fails with a missing medium
+ */
+static bool IsMediumReady(void) {
+	if (!IsMediumInserted()) {
+		FailCommand(SCSI_SENSE_NOT_READY, SCSI_ASC_MEDIUM_NOT_PRESENT);
+		return false;
+	}
+
+	return true;
+}
+
+static void FailCommand(const uint8_t key, const uint8_t asc) {
+	USBMscSenseKey = key;
+	USBMscSenseCode = asc;
+	USBMscCommand.status = USB_MSC_CSW_STATUS_FAILED;
+	USBMscFailedCommands++;
+}
+
+static void PutBe32(uint8_t* dst, const uint32_t value) {
+	dst[0] = (uint8_t) (value >> 24);
+	dst[1] = (uint8_t) (value >> 16);
+	dst[2] = (uint8_t) (value >> 8);
+	dst[3] = (uint8_t) value;
+}
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+ * @brief  Opens the mass storage endpoints on the set configuration request, and waits for a command block. Called
+ *         by the composite class from ISR.
+ * @param  pdev: device instance
+ * @retval None
+ */
+void USBMscInit(USBD_HandleTypeDef* pdev) {
+	USBD_LL_OpenEP(pdev, USB_MSC_IN_EP, USBD_EP_TYPE_BULK, USB_MSC_IN_PACKET_SIZE);
+	USBD_LL_OpenEP(pdev, USB_MSC_OUT_EP, USBD_EP_TYPE_BULK, USB_MSC_OUT_PACKET_SIZE);
+
+	USBMscDevice = pdev;
+	USBMscIsConfigured = true;
+	ReceiveCommand();
+}
+
+/**
+ * @brief  Closes the mass storage endpoints, a command in progress is dropped. Called by the composite class from
+ *         ISR.
+ * @param  pdev: device instance
+ * @retval None
+ */
+void USBMscDeInit(USBD_HandleTypeDef* pdev) {
+	USBMscIsConfigured = false;
+	USBMscBotState = USB_MSC_BOT_IDLE;
+	USBMscIsTxDone = false;
+
+	USBD_LL_CloseEP(pdev, USB_MSC_IN_EP);
+	USBD_LL_CloseEP(pdev, USB_MSC_OUT_EP);
+}
+
+/**
+ * @brief  Handles the requests to the mass storage interface and its endpoints: the class requests get max LUN and
+ *         reset, and the clear feature of an endpoint, which sends the status after a stalled data stage. Called by
+ *         the composite class from ISR.
+ * @param  pdev: device instance
+ * @param  req: usb request
+ * @retval Result of the operation
+ */
+uint8_t USBMscSetup(USBD_HandleTypeDef* pdev, USBD_SetupReqTypedef* req) {
+	switch (req->bmRequest & USB_REQ_TYPE_MASK) {
+	case USB_REQ_TYPE_CLASS:
+		if (USB_MSC_REQ_GET_MAX_LUN == req->bRequest && 0 == req->wValue && 1 == req->wLength
+				&& (req->bmRequest & 0x80)) {
+			USBD_CtlSendData(pdev, &USBMscMaxLun, 1);
+		} else if (USB_MSC_REQ_RESET == req->bRequest && 0 == req->wValue && 0 == req->wLength
+				&& !(req->bmRequest & 0x80)) {
+			/* Ready for the next command block, the host clears the stalled endpoints next */
+			ReceiveCommand();
+		} else {
+			USBD_CtlError(pdev, req);
+			return USBD_FAIL;
+		}
+		break;
+
+	case USB_REQ_TYPE_STANDARD:
+		if (USB_REQ_GET_INTERFACE == req->bRequest) {
+			USBD_CtlSendData(pdev, &USBMscAltSetting, 1);
+		} else if (USB_REQ_CLEAR_FEATURE == req->bRequest
+				&& (req->bmRequest & USB_REQ_RECIPIENT_MASK) == USB_REQ_RECIPIENT_ENDPOINT) {
+			if (USB_MSC_BOT_ERROR == USBMscBotState) {
+				/* An invalid command block needs a reset first */
+				USBD_LL_StallEP(pdev, LOBYTE(req->wIndex));
+			} else if (USB_MSC_IN_EP == LOBYTE(req->wIndex) && USB_MSC_BOT_STALLED_STATUS == USBMscBotState) {
+				SendStatus();
+			}
+		}
+		break;
+
+	default:
+		USBD_CtlError(pdev, req);
+		return USBD_FAIL;
+	}
+
+	return USBD_OK;
+}
+
+/**
+ * @brief  Mass storage IN endpoint completion. After data the work sends the next sector or the status, after the
+ *         status the next command block is received. Called by the composite class from ISR.
+ * @param  pdev: device instance
+ * @retval None
+ */
+void USBMscDataIn(USBD_HandleTypeDef* pdev) {
+	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+
+	(void) pdev;
+
+	if (USB_MSC_BOT_DATA_IN == USBMscBotState) {
+		USBMscIsTxDone = true;
+		DeferredWorkPostFromISR(USBMscWorkId, &xHigherPriorityTaskWoken);
+		portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+	} else if (USB_MSC_BOT_STATUS == USBMscBotState) {
+		ReceiveCommand();
+	}
+}
+
+/**
+ * @brief  Mass storage OUT endpoint completion, a command block. A valid one is passed to the work, an invalid one
+ *         stalls the endpoints until the host resets the interface. Called by the composite class from ISR.
+ * @param  pdev: device instance
+ * @retval None
+ */
+void USBMscDataOut(USBD_HandleTypeDef* pdev) {
+	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+	uint32_t size = USBD_LL_GetRxDataSize(pdev, USB_MSC_OUT_EP);
+
+	if (USB_MSC_BOT_IDLE != USBMscBotState) {
+		return;
+	}
+
+	if (USB_MSC_CBW_SIZE == size && USB_MSC_CBW_SIGNATURE == GET_LE32(USBMscCbw) && 0 == USBMscCbw[13]
+			&& USBMscCbw[14] >= 1 && USBMscCbw[14] <= 16) {
+		USBMscBotState = USB_MSC_BOT_COMMAND;
+		DeferredWorkPostFromISR(USBMscWorkId, &xHigherPriorityTaskWoken);
+		portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+	} else {
+		USBMscBotState = USB_MSC_BOT_ERROR;
+		USBD_LL_StallEP(pdev, USB_MSC_IN_EP);
+		USBD_LL_StallEP(pdev, USB_MSC_OUT_EP);
+	}
+}
+
+/**
+ * @brief  Registers the mass storage work, run by the low deferred worker
+ * @param  None
+ * @retval None
+ */
+void CreateUSBMscWork(void) {
+	if (FCB_OK != DeferredWorkRegister("UsbMsc", USBMscWork, NULL, DEFERRED_WORKER_LOW, &USBMscWorkId)) {
+		ErrorHandler();
+	}
+}
+
+/**
+ * @brief  Requests the medium to be inserted or ejected, which the mass storage work does. The volume is laid out
+ *         from the logs and settings of the time it is inserted.
+ * @param  isInserted: true to insert the medium, false to eject it
+ * @retval FCB_OK, FCB_ERR if it is to be inserted and the UAV is not disarmed
+ */
+FcbRetValType USBMscSetMedium(const bool isInserted) {
+	if (isInserted && FLIGHT_MODE_DISARMED != GetFlightModeState()) {
+		return FCB_ERR;
+	}
+
+	USBMscIsMediumRequested = isInserted;
+	DeferredWorkPost(USBMscWorkId);
+
+	return FCB_OK;
+}
+
+/**
+ * @brief  Gets the status of the mass storage interface
+ * @param  dstStatus: Destination status
+ * @retval None
+ */
+void GetUSBMscStatus(USBMscStatus_TypeDef* dstStatus) {
+	dstStatus->isConfigured = USBMscIsConfigured;
+	dstStatus->isInserted = USBMscIsInserted && FLIGHT_MODE_DISARMED == GetFlightModeState();
+	dstStatus->files = GetMscVolumeFiles();
+	dstStatus->usedBytes = GetMscVolumeUsedBytes();
+	dstStatus->commands = USBMscCommands;
+	dstStatus->readSectors = USBMscReadSectors;
+	dstStatus->failedCommands = USBMscFailedCommands;
+}
+
+/**
+ * @brief  Prints the status of the mass storage interface
+ * @param  dst: Destination string
+ * @param  dstSize: Size of dst, USB_MSC_MAX_STRING_SIZE for all of it
+ * @retval Length of the string
+ */
+size_t PrintUSBMscStatus(char* dst, const size_t dstSize) {
+	USBMscStatus_TypeDef status;
+	int length;
+
+	GetUSBMscStatus(&status);
+
+	length = snprintf(dst, dstSize,
+			"USB mass storage: %s, medium %s\n"
+			"Volume: %u files, %lu bytes of %lu\n"
+			"Commands: %lu, failed: %lu\n"
+			"Read sectors: %lu\n",
+			status.isConfigured ? "configured" : "not configured", status.isInserted ? "inserted" : "ejected",
+			status.files, status.usedBytes, (uint32_t) MSC_VOLUME_NBR_OF_SECTORS*MSC_VOLUME_SECTOR_SIZE,
+			status.commands, status.failedCommands, status.readSectors);
+
+	if (length < 0) {
+		return 0;
+	}
+	return (size_t) length < dstSize ? (size_t) length : dstSize - 1;
+}
+
+#endif /* FCB_USB_MASS_STORAGE */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+
+/*****END OF FILE****/
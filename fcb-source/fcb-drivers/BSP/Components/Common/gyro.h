@@ -38,7 +38,7 @@
 
 /* Define to prevent recursive inclusion -------------------------------------*/
 #ifndef __GYRO_H
-#define __GIRO_H
+#define __GYRO_H
 
 #include "stm32f3xx_hal.h"
 
@@ -80,6 +80,21 @@ typedef struct
   void       (*FilterConfig)(uint8_t);  
   void       (*FilterCmd)(uint8_t);  
   HAL_StatusTypeDef (*GetXYZ)(float *);
+  /* Flight control extensions, NULL where the part does not support them */
+  uint8_t    (*Config)(void);                                 /* Bus, data rate, full scale and data ready, 0 on success */
+  uint8_t    (*ConfigFIFO)(uint8_t);                          /* Watermark [samples] on the data ready pin, 0 on success */
+  HAL_StatusTypeDef (*StartReadXYZDMA)(void);                 /* Burst read of the output registers, from ISR */
+  void       (*FinishReadXYZDMA)(int16_t *);                  /* Raw x, y, z of the burst, from the SPI callback */
+  void       (*AbortReadXYZDMA)(void);                        /* Releases the bus after a failed burst */
+  void       (*ConvertXYZ)(const int16_t *, float *);         /* Raw x, y, z to [rad/s] */
+  HAL_StatusTypeDef (*ReadFIFO)(int16_t *, uint8_t, uint8_t *);
+  HAL_StatusTypeDef (*ReadTemperature)(int8_t *);             /* [deg C], may be relative */
+  uint16_t   (*DataRateHz)(void);                             /* Nominal output data rate */
+  HAL_StatusTypeDef (*SelfTest)(int8_t);                      /* Self-test deflection: 1 positive, -1 negative, 0 off */
+  float      (*SelfTestChange)(void);                         /* Typical output change in self-test [rad/s] */
+  uint8_t    (*SetRates)(float *, float *, float *);          /* Data rate, low-pass and high-pass cutoffs [Hz], 0 high-pass
+                                                                 for off, set to the nearest supported ones and applied by
+                                                                 the next Config, 0 on success */
 }GYRO_DrvTypeDef;
 
 typedef struct
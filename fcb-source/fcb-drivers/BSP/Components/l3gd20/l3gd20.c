@@ -91,12 +91,59 @@ GYRO_DrvTypeDef L3gd20Drv =
   0,
   L3GD20_FilterConfig,
   L3GD20_FilterCmd,
-  L3GD20_ReadXYZAngRate
+  L3GD20_ReadXYZAngRate,
+  L3GD20_Config,
+  L3GD20_ConfigFIFOWatermark,
+  L3GD20_StartReadXYZAngRateDMA,
+  L3GD20_FinishReadXYZAngRateDMA,
+  GYRO_IO_Read_DMA_Complete,
+  L3GD20_ConvertXYZAngRate,
+  L3GD20_ReadFIFO,
+  L3GD20_ReadTemperature,
+  L3GD20_DataRateHz,
+  L3GD20_SelfTest,
+  L3GD20_SelfTestChange,
+  L3GD20_SetRates
 };
 
 /* L3GD20_OUTPUT_DATARATE_1: 96 Hz according to data sheet, 94.5 Hz according to oscilloscope */
 static uint8_t cfgL3GD20OutputDataRate = L3GD20_OUTPUT_DATARATE_2; // 190 Hz
 
+/* Bandwidth of the second low-pass and high-pass cutoff selections, applied by L3GD20_Config() */
+static uint8_t cfgL3GD20Bandwidth = L3GD20_BANDWIDTH_1;
+static uint8_t cfgL3GD20HighPassCutoff = L3GD20_HPFCF_9;
+static uint8_t cfgL3GD20OutputSelection = L3GD20_OUT_SEL_LPF1; // As after reset, the bandwidth bits are not used
+static uint8_t cfgL3GD20HighPassState = L3GD20_HIGHPASSFILTER_DISABLE;
+
+/* Second low-pass cutoff [Hz] of each data rate (rows) and bandwidth selection, see the L3GD20 data sheet table 21 */
+static const float l3gd20LowPassCutoffs[4][4] = {
+  { 12.5f, 25.0f, 25.0f, 25.0f },
+  { 12.5f, 25.0f, 50.0f, 70.0f },
+  { 20.0f, 25.0f, 50.0f, 100.0f },
+  { 30.0f, 35.0f, 50.0f, 100.0f }
+};
+
+/* High-pass cutoff [Hz] of each data rate (rows) and L3GD20_HPFCF_0..9, see the L3GD20 data sheet table 26 */
+static const float l3gd20HighPassCutoffs[4][10] = {
+  { 7.2f, 3.5f, 1.8f, 0.9f, 0.45f, 0.18f, 0.09f, 0.045f, 0.018f, 0.009f },
+  { 13.5f, 7.2f, 3.5f, 1.8f, 0.9f, 0.45f, 0.18f, 0.09f, 0.045f, 0.018f },
+  { 27.0f, 13.5f, 7.2f, 3.5f, 1.8f, 0.9f, 0.45f, 0.18f, 0.09f, 0.045f },
+  { 51.4f, 27.0f, 13.5f, 7.2f, 3.5f, 1.8f, 0.9f, 0.45f, 0.18f, 0.09f }
+};
+
+/* Sensitivity matching the configured full scale, cached at L3GD20_Config() time [mdps/LSB] */
+static float cfgL3GD20Sensitivity = L3GD20_SENSITIVITY_500DPS;
+
+/* Full scale selection of CTRL_REG4, cached at L3GD20_Config() time for the self-test */
+static uint8_t cfgL3GD20FullScale = L3GD20_FULLSCALE_500;
+
+/* Buffers for DMA burst reads of the output registers (address/status byte + 6 data bytes) */
+static uint8_t dmaTxBuffer[L3GD20_XYZ_DMA_BUFFER_SIZE];
+static uint8_t dmaRxBuffer[L3GD20_XYZ_DMA_BUFFER_SIZE];
+
+/* Buffer for burst reads of the whole FIFO */
+static uint8_t fifoBuffer[L3GD20_FIFO_SIZE * 6];
+
 /**
   * @}
   */
@@ -104,6 +151,7 @@ static uint8_t cfgL3GD20OutputDataRate = L3GD20_OUTPUT_DATARATE_2; // 190 Hz
 /** @defgroup L3GD20_Private_FunctionPrototypes
   * @{
   */
+static float L3GD20_FullScaleToSensitivity(uint8_t fullScale);
 
 /**
   * @}
@@ -126,6 +174,7 @@ uint8_t L3GD20_Config(void) {
   uint8_t ctrlReg2 = 0;
   uint8_t ctrlReg3 = 0;
   uint8_t ctrlReg4 = 0;
+  uint8_t ctrlReg5 = 0;
 
   GYRO_InitTypeDef L3GD20_InitStructure;
   GYRO_FilterConfigTypeDef L3GD20_FilterStructure;
@@ -144,7 +193,7 @@ uint8_t L3GD20_Config(void) {
   L3GD20_InitStructure.Power_Mode = L3GD20_MODE_ACTIVE;
   L3GD20_InitStructure.Output_DataRate = cfgL3GD20OutputDataRate;
   L3GD20_InitStructure.Axes_Enable = L3GD20_AXES_ENABLE;
-  L3GD20_InitStructure.Band_Width = L3GD20_BANDWIDTH_1;
+  L3GD20_InitStructure.Band_Width = cfgL3GD20Bandwidth;
   L3GD20_InitStructure.BlockData_Update = L3GD20_BlockDataUpdate_Continous;
   L3GD20_InitStructure.Endianness = L3GD20_BLE_LSB; /* if changed, modify L3GD20_ReadXYZAngRate as well */
   L3GD20_InitStructure.Full_Scale = L3GD20_FULLSCALE_500;
@@ -160,14 +209,23 @@ uint8_t L3GD20_Config(void) {
 
   L3GD20_Init(ctrlReg1, ctrlReg3, ctrlReg4);
 
+  /* Cache sensitivity so that sample reads need not re-read CTRL_REG4 */
+  cfgL3GD20Sensitivity = L3GD20_FullScaleToSensitivity(L3GD20_InitStructure.Full_Scale);
+  cfgL3GD20FullScale = L3GD20_InitStructure.Full_Scale;
+
   L3GD20_FilterStructure.HighPassFilter_Mode_Selection = L3GD20_HPM_NORMAL_MODE_RES;
-  L3GD20_FilterStructure.HighPassFilter_CutOff_Frequency = L3GD20_HPFCF_9;
+  L3GD20_FilterStructure.HighPassFilter_CutOff_Frequency = cfgL3GD20HighPassCutoff;
 
   ctrlReg2 = (uint8_t) ((L3GD20_FilterStructure.HighPassFilter_Mode_Selection |\
                      L3GD20_FilterStructure.HighPassFilter_CutOff_Frequency));
 
   L3GD20_FilterConfig(ctrlReg2);
-  L3GD20_FilterCmd(L3GD20_HIGHPASSFILTER_DISABLE);
+  L3GD20_FilterCmd(cfgL3GD20HighPassState);
+
+  /* Route the samples through the selected filters */
+  GYRO_IO_Read(&ctrlReg5, L3GD20_CTRL_REG5_ADDR, 1);
+  ctrlReg5 = (uint8_t) ((ctrlReg5 & ~L3GD20_OUT_SEL_MASK) | cfgL3GD20OutputSelection);
+  GYRO_IO_Write(&ctrlReg5, L3GD20_CTRL_REG5_ADDR, 1);
 
   return 0;
 }
@@ -385,29 +443,44 @@ uint8_t L3GD20_GetDataStatus(void)
 }
 
 /**
-* @brief  Calculate the L3GD20 angular data.
+  * @brief  Reads the L3GD20 temperature. The output is -1 LSB/deg C with a
+  *         part specific offset, so this is a relative temperature only.
+  * @param  pTemperature : Temperature out pointer [deg C, relative]
+  * @retval HAL_OK if read successful
+  */
+HAL_StatusTypeDef L3GD20_ReadTemperature(int8_t* pTemperature)
+{
+  HAL_StatusTypeDef status = HAL_OK;
+  uint8_t tmpreg = 0;
+
+  /* Read OUT_TEMP register */
+  status = GYRO_IO_Read(&tmpreg, L3GD20_OUT_TEMP_ADDR, 1);
+  if(status == HAL_OK)
+  {
+    /* Negated so that a higher value is a higher temperature */
+    *pTemperature = (int8_t)(-(int8_t)tmpreg);
+  }
+
+  return status;
+}
+
+/**
+* @brief  Calculate the L3GD20 angular data. The sensitivity cached at
+*         L3GD20_Config() time is used, so only one SPI transaction is made.
 * @param  pfData : Data out pointer
-* @retval None
+* @retval HAL_OK if read successful
 */
 HAL_StatusTypeDef L3GD20_ReadXYZAngRate(float* pfData)
 {
   HAL_StatusTypeDef status = HAL_OK;
   uint8_t tmpbuffer[6] ={0};
   int16_t RawData[3] = {0};
-  uint8_t tmpreg = 0;
-  float sensitivity = 0;
   int i = 0;
-  
-  status = GYRO_IO_Read(&tmpreg, L3GD20_CTRL_REG4_ADDR, 1);
-  if(status != HAL_OK) {
-      goto Exit;
-  }
+
   status = GYRO_IO_Read(tmpbuffer, L3GD20_OUT_X_L_ADDR, 6);
   if(status != HAL_OK) {
       goto Exit;
   }
-  
-  /* check in the control register 4 the data alignment (Big Endian or Little Endian)*/
 
   for(i=0; i<3; i++)
   {
@@ -416,29 +489,163 @@ HAL_StatusTypeDef L3GD20_ReadXYZAngRate(float* pfData)
      */
     RawData[i]=(int16_t)(((uint16_t)tmpbuffer[2*i+1] << 8) + tmpbuffer[2*i]);
   }
-  
-  /* Switch the sensitivity value set in the CRTL4 */
-  switch(tmpreg & L3GD20_FULLSCALE_SELECTION)
+
+  L3GD20_ConvertXYZAngRate(RawData, pfData);
+
+Exit:
+  return status;
+}
+
+/**
+* @brief  Starts a DMA burst read of the L3GD20 output registers. May be called
+*         from the DRDY interrupt. The result is fetched with
+*         L3GD20_FinishReadXYZAngRateDMA() from the SPI transfer complete callback.
+* @param  None
+* @retval HAL_OK if transfer started, HAL_BUSY if the SPI bus is in use
+*/
+HAL_StatusTypeDef L3GD20_StartReadXYZAngRateDMA(void)
+{
+  return GYRO_IO_Read_DMA(dmaTxBuffer, dmaRxBuffer, L3GD20_OUT_X_L_ADDR, L3GD20_XYZ_DMA_BUFFER_SIZE - 1);
+}
+
+/**
+* @brief  Ends a DMA burst read and unpacks the raw output register values.
+*         Called from the SPI transfer complete callback (ISR context).
+* @param  pRawData : Raw data out pointer (3 elements, sensor axes x, y, z)
+* @retval None
+*/
+void L3GD20_FinishReadXYZAngRateDMA(int16_t* pRawData)
+{
+  int i = 0;
+
+  GYRO_IO_Read_DMA_Complete();
+
+  for(i=0; i<3; i++)
   {
-  case L3GD20_FULLSCALE_250:
-    sensitivity=L3GD20_SENSITIVITY_250DPS;
-    break;
-    
-  case L3GD20_FULLSCALE_500:
-    sensitivity=L3GD20_SENSITIVITY_500DPS;
-    break;
-    
-  case L3GD20_FULLSCALE_2000:
-    sensitivity=L3GD20_SENSITIVITY_2000DPS;
-    break;
+    /* First received byte is clocked out during the address byte, data starts at index 1.
+     * Assumes L3GD20_BLE_LSB endianness as in L3GD20_ReadXYZAngRate */
+    pRawData[i]=(int16_t)(((uint16_t)dmaRxBuffer[2*i+2] << 8) + dmaRxBuffer[2*i+1]);
   }
-  /* divide by sensitivity */
+}
+
+/**
+* @brief  Converts raw L3GD20 output register values to angular rates [rad/s]
+* @param  pRawData : Raw data in pointer (3 elements)
+* @param  pfData : Data out pointer (3 elements)
+* @retval None
+*/
+void L3GD20_ConvertXYZAngRate(const int16_t* pRawData, float* pfData)
+{
+  int i = 0;
+
   for(i=0; i<3; i++)
   {
-	/* translate data from milli degreees/sec to rad/sec */
-    pfData[i]=(float)(RawData[i] * sensitivity * M_PI / 180 / 1000);
+    /* translate data from milli degreees/sec to rad/sec, single precision with a folded constant factor */
+    pfData[i] = (float) pRawData[i] * cfgL3GD20Sensitivity * ((float) M_PI / 180000.0f);
+  }
+}
+
+/**
+* @brief  Enables the L3GD20 FIFO in stream mode with the watermark interrupt on
+*         INT2 instead of data ready. Call after L3GD20_Config().
+* @param  outputDataRate : L3GD20_OUTPUT_DATARATE_1 .. L3GD20_OUTPUT_DATARATE_4
+* @param  watermark : FIFO level (1..31) at which INT2 goes high
+* @retval zero upon success, nonzero upon error
+*/
+uint8_t L3GD20_ConfigFIFO(uint8_t outputDataRate, uint8_t watermark)
+{
+  uint8_t tmpreg = 0;
+
+  if ((watermark == 0) || (watermark > L3GD20_FIFO_WATERMARK_MASK)) {
+    return 1; // error
   }
 
+  cfgL3GD20OutputDataRate = outputDataRate;
+
+  /* Set data rate, keep bandwidth, power mode and axes */
+  GYRO_IO_Read(&tmpreg, L3GD20_CTRL_REG1_ADDR, 1);
+  tmpreg &= 0x3F;
+  tmpreg |= outputDataRate;
+  GYRO_IO_Write(&tmpreg, L3GD20_CTRL_REG1_ADDR, 1);
+
+  /* Stream mode - the oldest samples are overwritten if the FIFO is not drained in time */
+  tmpreg = (uint8_t) (L3GD20_FIFO_MODE_STREAM | (watermark & L3GD20_FIFO_WATERMARK_MASK));
+  GYRO_IO_Write(&tmpreg, L3GD20_FIFO_CTRL_REG_ADDR, 1);
+
+  GYRO_IO_Read(&tmpreg, L3GD20_CTRL_REG5_ADDR, 1);
+  tmpreg |= L3GD20_FIFO_ENABLE;
+  GYRO_IO_Write(&tmpreg, L3GD20_CTRL_REG5_ADDR, 1);
+
+  /* Route watermark instead of data ready to INT2 */
+  GYRO_IO_Read(&tmpreg, L3GD20_CTRL_REG3_ADDR, 1);
+  tmpreg &= ~L3GD20_INT2INTERRUPT_ENABLE;
+  tmpreg |= L3GD20_INT2WATERMARK_ENABLE;
+  GYRO_IO_Write(&tmpreg, L3GD20_CTRL_REG3_ADDR, 1);
+
+  return 0;
+}
+
+/**
+* @brief  Enables the L3GD20 FIFO at the highest data rate, 760 Hz, see
+*         L3GD20_ConfigFIFO(). Call after L3GD20_Config().
+* @param  watermark : FIFO level (1..31) at which INT2 goes high
+* @retval zero upon success, nonzero upon error
+*/
+uint8_t L3GD20_ConfigFIFOWatermark(uint8_t watermark)
+{
+  return L3GD20_ConfigFIFO(L3GD20_OUTPUT_DATARATE_4, watermark);
+}
+
+/**
+* @brief  Reads all unread samples from the L3GD20 FIFO with one burst read. With
+*         the FIFO enabled the output register address rolls back from OUT_Z_H to
+*         OUT_X_L, so consecutive samples are read in a single transaction.
+* @param  pRawData : Raw data out pointer, 3 elements (x, y, z) per sample, oldest sample first
+* @param  maxSamples : Max number of samples pRawData holds
+* @param  pNbrOfSamples : Number of samples read
+* @retval HAL_OK if read successful
+*/
+HAL_StatusTypeDef L3GD20_ReadFIFO(int16_t* pRawData, uint8_t maxSamples, uint8_t* pNbrOfSamples)
+{
+  HAL_StatusTypeDef status = HAL_OK;
+  uint8_t fifoSrc = 0;
+  uint8_t nbrOfSamples = 0;
+  int i = 0;
+
+  *pNbrOfSamples = 0;
+
+  status = GYRO_IO_Read(&fifoSrc, L3GD20_FIFO_SRC_REG_ADDR, 1);
+  if(status != HAL_OK) {
+      goto Exit;
+  }
+
+  if (fifoSrc & L3GD20_FIFO_SRC_OVRN) {
+    nbrOfSamples = L3GD20_FIFO_SIZE; /* FSS wraps when all slots are filled */
+  } else if (!(fifoSrc & L3GD20_FIFO_SRC_EMPTY)) {
+    nbrOfSamples = fifoSrc & L3GD20_FIFO_SRC_FSS_MASK;
+  }
+
+  if (nbrOfSamples > maxSamples) {
+    nbrOfSamples = maxSamples;
+  }
+
+  if (nbrOfSamples == 0) {
+      goto Exit;
+  }
+
+  status = GYRO_IO_Read(fifoBuffer, L3GD20_OUT_X_L_ADDR, nbrOfSamples * 6);
+  if(status != HAL_OK) {
+      goto Exit;
+  }
+
+  for(i=0; i<nbrOfSamples*3; i++)
+  {
+    /* assume L3GD20_BLE_LSB endianness as in L3GD20_ReadXYZAngRate */
+    pRawData[i]=(int16_t)(((uint16_t)fifoBuffer[2*i+1] << 8) + fifoBuffer[2*i]);
+  }
+
+  *pNbrOfSamples = nbrOfSamples;
+
 Exit:
   return status;
 }
@@ -456,6 +663,141 @@ uint16_t L3GD20_DataRateHz(void) {
   return dataRate1 * conversion;
 }
 
+/**
+  * @brief  Selects the data rate, the second low-pass bandwidth and the high-pass cutoff nearest to the requested
+  *         ones, to be applied by the next L3GD20_Config(). A low-pass of 0 leaves the second low-pass out, the
+  *         first one then limits the bandwidth. A high-pass of 0 leaves the high-pass out.
+  * @param  pDataRateHz : Requested data rate in, selected one out [Hz]
+  * @param  pLowPassHz : Requested second low-pass cutoff in, selected one out [Hz]
+  * @param  pHighPassHz : Requested high-pass cutoff in, selected one out [Hz]
+  * @retval zero upon success, nonzero upon error
+  */
+uint8_t L3GD20_SetRates(float* pDataRateHz, float* pLowPassHz, float* pHighPassHz)
+{
+  uint8_t rateIdx = 0, bandwidthIdx = 0, cutoffIdx = 0;
+  uint8_t i;
+
+  if (*pDataRateHz <= 0.0f || *pLowPassHz < 0.0f || *pHighPassHz < 0.0f) {
+    return 1; // error
+  }
+
+  /* The data rates double from 95 Hz */
+  for (i = 1; i < 4; i++) {
+    if (fabsf(*pDataRateHz - (float) (95 << i)) < fabsf(*pDataRateHz - (float) (95 << rateIdx))) {
+      rateIdx = i;
+    }
+  }
+  for (i = 1; i < 4; i++) {
+    if (fabsf(*pLowPassHz - l3gd20LowPassCutoffs[rateIdx][i])
+        < fabsf(*pLowPassHz - l3gd20LowPassCutoffs[rateIdx][bandwidthIdx])) {
+      bandwidthIdx = i;
+    }
+  }
+  /* The high-pass cutoffs halve per step, so the nearest one is the nearest ratio */
+  for (i = 1; *pHighPassHz > 0.0f && i < 10; i++) {
+    if (fabsf(logf(*pHighPassHz / l3gd20HighPassCutoffs[rateIdx][i]))
+        < fabsf(logf(*pHighPassHz / l3gd20HighPassCutoffs[rateIdx][cutoffIdx]))) {
+      cutoffIdx = i;
+    }
+  }
+
+  cfgL3GD20OutputDataRate = (uint8_t) (rateIdx << 6);
+  cfgL3GD20Bandwidth = (uint8_t) (bandwidthIdx << 4);
+  cfgL3GD20HighPassCutoff = cutoffIdx;
+  cfgL3GD20HighPassState = (*pHighPassHz > 0.0f) ? L3GD20_HIGHPASSFILTER_ENABLE : L3GD20_HIGHPASSFILTER_DISABLE;
+  if (*pLowPassHz > 0.0f) {
+    cfgL3GD20OutputSelection = L3GD20_OUT_SEL_LPF2;
+  } else {
+    cfgL3GD20OutputSelection = (*pHighPassHz > 0.0f) ? L3GD20_OUT_SEL_HPF : L3GD20_OUT_SEL_LPF1;
+  }
+
+  *pDataRateHz = (float) L3GD20_DataRateHz();
+  *pLowPassHz = (*pLowPassHz > 0.0f) ? l3gd20LowPassCutoffs[rateIdx][bandwidthIdx] : 0.0f;
+  *pHighPassHz = (*pHighPassHz > 0.0f) ? l3gd20HighPassCutoffs[rateIdx][cutoffIdx] : 0.0f;
+
+  return 0;
+}
+
+/**
+  * @brief  Sets the self-test mode of CTRL_REG4, which deflects the sensing
+  *         masses electrostatically as a rotation would. The output settles
+  *         within a few samples after a change.
+  * @param  sign : 1 for self-test 0 (+), -1 for self-test 1 (-), 0 for normal mode
+  * @retval HAL_OK if CTRL_REG4 was read
+  */
+HAL_StatusTypeDef L3GD20_SelfTest(int8_t sign)
+{
+  HAL_StatusTypeDef status = HAL_OK;
+  uint8_t tmpreg = 0;
+
+  status = GYRO_IO_Read(&tmpreg, L3GD20_CTRL_REG4_ADDR, 1);
+  if(status == HAL_OK)
+  {
+    tmpreg &= (uint8_t)~L3GD20_SELFTEST_SELECTION;
+    if(sign > 0)
+    {
+      tmpreg |= L3GD20_SELFTEST_POSITIVE;
+    }
+    else if(sign < 0)
+    {
+      tmpreg |= L3GD20_SELFTEST_NEGATIVE;
+    }
+
+    GYRO_IO_Write(&tmpreg, L3GD20_CTRL_REG4_ADDR, 1);
+  }
+
+  return status;
+}
+
+/**
+  * @brief  Gets the typical output change in self-test at the configured full scale
+  * @param  None
+  * @retval Output change [rad/s]
+  */
+float L3GD20_SelfTestChange(void)
+{
+  float change;
+
+  switch(cfgL3GD20FullScale & L3GD20_FULLSCALE_SELECTION)
+  {
+  case L3GD20_FULLSCALE_250:
+    change = L3GD20_SELFTEST_CHANGE_250DPS;
+    break;
+
+  case L3GD20_FULLSCALE_2000:
+    change = L3GD20_SELFTEST_CHANGE_2000DPS;
+    break;
+
+  case L3GD20_FULLSCALE_500:
+  default:
+    change = L3GD20_SELFTEST_CHANGE_500DPS;
+    break;
+  }
+
+  return change * ((float) M_PI / 180.0f);
+}
+
+/**
+  * @brief  Maps a CTRL_REG4 full scale selection to the sensor sensitivity
+  * @param  fullScale : L3GD20_FULLSCALE_250, L3GD20_FULLSCALE_500 or L3GD20_FULLSCALE_2000
+  * @retval Sensitivity [mdps/LSB]
+  */
+static float L3GD20_FullScaleToSensitivity(uint8_t fullScale)
+{
+  switch(fullScale & L3GD20_FULLSCALE_SELECTION)
+  {
+  case L3GD20_FULLSCALE_250:
+    return L3GD20_SENSITIVITY_250DPS;
+
+  case L3GD20_FULLSCALE_2000:
+    return L3GD20_SENSITIVITY_2000DPS;
+
+  case L3GD20_FULLSCALE_500:
+  default:
+    return L3GD20_SENSITIVITY_500DPS;
+  }
+}
+
 /**
   * @}
   */ 
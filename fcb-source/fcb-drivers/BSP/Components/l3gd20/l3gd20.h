@@ -158,6 +158,24 @@
 #define L3GD20_SENSITIVITY_250DPS  ((float)8.75f)         /*!< gyroscope sensitivity with 250 dps full scale [DPS/LSB]  */
 #define L3GD20_SENSITIVITY_500DPS  ((float)17.50f)        /*!< gyroscope sensitivity with 500 dps full scale [DPS/LSB]  */
 #define L3GD20_SENSITIVITY_2000DPS ((float)70.00f)        /*!< gyroscope sensitivity with 2000 dps full scale [DPS/LSB] */
+
+#define L3GD20_XYZ_DMA_BUFFER_SIZE 7                      /*!< address byte + 6 output register bytes for DMA burst reads */
+/**
+  * @}
+  */
+
+/** @defgroup Self_Test_Selection
+  * @{
+  */
+#define L3GD20_SELFTEST_NONE       ((uint8_t)0x00)        /*!< normal mode */
+#define L3GD20_SELFTEST_POSITIVE   ((uint8_t)0x02)        /*!< self-test 0 (+) */
+#define L3GD20_SELFTEST_NEGATIVE   ((uint8_t)0x06)        /*!< self-test 1 (-) */
+#define L3GD20_SELFTEST_SELECTION  ((uint8_t)0x06)
+
+/* Typical output change in self-test of the data sheet, it gives no minimum or maximum [dps] */
+#define L3GD20_SELFTEST_CHANGE_250DPS  ((float)130.0f)
+#define L3GD20_SELFTEST_CHANGE_500DPS  ((float)200.0f)
+#define L3GD20_SELFTEST_CHANGE_2000DPS ((float)530.0f)
 /**
   * @}
   */
@@ -187,7 +205,34 @@
 #define L3GD20_HIGHPASSFILTER_DISABLE      ((uint8_t)0x00)
 #define L3GD20_HIGHPASSFILTER_ENABLE	     ((uint8_t)0x10)
 #define L3GD20_FIFO_ENABLE	                ((uint8_t)0x40)
+#define L3GD20_OUT_SEL_MASK                ((uint8_t)0x03)  /* CTRL_REG5 output selection */
+#define L3GD20_OUT_SEL_LPF1                ((uint8_t)0x00)  /* first low-pass only, the bandwidth bits are not used */
+#define L3GD20_OUT_SEL_HPF                 ((uint8_t)0x01)  /* first low-pass and high-pass */
+#define L3GD20_OUT_SEL_LPF2                ((uint8_t)0x02)  /* also the second low-pass of the bandwidth bits */
+
+/**
+  * @}
+  */
+
+/** @defgroup FIFO_Mode_Selection
+  * @{
+  */
+#define L3GD20_FIFO_MODE_BYPASS            ((uint8_t)0x00)
+#define L3GD20_FIFO_MODE_FIFO              ((uint8_t)0x20)
+#define L3GD20_FIFO_MODE_STREAM            ((uint8_t)0x40)
+#define L3GD20_FIFO_WATERMARK_MASK         ((uint8_t)0x1F)
+#define L3GD20_FIFO_SIZE                   32 /* samples (x, y & z) the FIFO holds */
+/**
+  * @}
+  */
 
+/** @defgroup FIFO_Source_Register_Flags
+  * @{
+  */
+#define L3GD20_FIFO_SRC_WTM                ((uint8_t)0x80) /* FIFO filling above watermark */
+#define L3GD20_FIFO_SRC_OVRN               ((uint8_t)0x40) /* FIFO full, oldest sample overwritten */
+#define L3GD20_FIFO_SRC_EMPTY              ((uint8_t)0x20)
+#define L3GD20_FIFO_SRC_FSS_MASK           ((uint8_t)0x1F) /* number of unread samples */
 /**
   * @}
   */
@@ -215,6 +260,7 @@
   */
 #define L3GD20_INT2INTERRUPT_DISABLE       ((uint8_t)0x00)
 #define L3GD20_INT2INTERRUPT_ENABLE        ((uint8_t)0x08)
+#define L3GD20_INT2WATERMARK_ENABLE        ((uint8_t)0x04)
 /**
   * @}
   */
@@ -286,8 +332,18 @@ void      L3GD20_DisableIT(uint8_t IntSel);
 void      L3GD20_FilterConfig(uint8_t FilterStruct);
 void      L3GD20_FilterCmd(uint8_t HighPassFilterState);
 HAL_StatusTypeDef L3GD20_ReadXYZAngRate(float* pfData);
+HAL_StatusTypeDef L3GD20_StartReadXYZAngRateDMA(void);
+void      L3GD20_FinishReadXYZAngRateDMA(int16_t* pRawData);
+void      L3GD20_ConvertXYZAngRate(const int16_t* pRawData, float* pfData);
+uint8_t   L3GD20_ConfigFIFO(uint8_t outputDataRate, uint8_t watermark);
+uint8_t   L3GD20_ConfigFIFOWatermark(uint8_t watermark);
+HAL_StatusTypeDef L3GD20_ReadFIFO(int16_t* pRawData, uint8_t maxSamples, uint8_t* pNbrOfSamples);
 uint8_t   L3GD20_GetDataStatus(void);
+HAL_StatusTypeDef L3GD20_ReadTemperature(int8_t* pTemperature);
 uint16_t  L3GD20_DataRateHz(void);
+uint8_t   L3GD20_SetRates(float* pDataRateHz, float* pLowPassHz, float* pHighPassHz);
+HAL_StatusTypeDef L3GD20_SelfTest(int8_t sign);
+float     L3GD20_SelfTestChange(void);
 
 /* Gyroscope driver structure */
 extern GYRO_DrvTypeDef L3gd20Drv;
@@ -296,7 +352,9 @@ extern GYRO_DrvTypeDef L3gd20Drv;
 void      GYRO_IO_Init(void);
 void      GYRO_IO_DeInit(void);
 void      GYRO_IO_Write(uint8_t* pBuffer, uint8_t WriteAddr, uint16_t NumByteToWrite);
-uint8_t   GYRO_IO_Read(uint8_t* pBuffer, uint8_t ReadAddr, uint16_t NumByteToRead);
+HAL_StatusTypeDef GYRO_IO_Read(uint8_t* pBuffer, uint8_t ReadAddr, uint16_t NumByteToRead);
+HAL_StatusTypeDef GYRO_IO_Read_DMA(uint8_t* pTxBuffer, uint8_t* pRxBuffer, uint8_t ReadAddr, uint16_t NumByteToRead);
+void      GYRO_IO_Read_DMA_Complete(void);
 
 /**
   * @}
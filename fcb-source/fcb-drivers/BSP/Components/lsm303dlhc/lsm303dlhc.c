@@ -39,6 +39,7 @@
 #include "lsm303dlhc.h"
 #include "fcb_sensors.h"
 #include "fcb_error.h"
+#include <math.h>
 
 /** @addtogroup BSP
  * @{
@@ -102,6 +103,26 @@ struct MagnetometerConfig {
 static struct AccelerometerConfig accConfig = { 0, 0 }; /* initialised in LSM303DLHC_AccInit */
 static struct MagnetometerConfig magConfig = {0, 0, 0, 0, 0}; /* initialised in LSM303DLHC_MagInit */
 
+/* Accelerometer data rate and high-pass filter, applied by LSM303DLHC_AccConfig */
+static uint8_t accDataRateSetting = LSM303DLHC_ODR_200_HZ;
+static uint8_t accHighPassCutoffSetting = LSM303DLHC_HPFCF_16;
+static uint8_t accHighPassState = LSM303DLHC_HIGHPASSFILTER_DISABLE;
+
+/* Supported data rates [Hz] and their register values, the low power only rate left out */
+static const float32_t accDataRatesHz[] = { 1.0f, 10.0f, 25.0f, 50.0f, 100.0f, 200.0f, 400.0f, 1344.0f };
+static const uint8_t accDataRateSettings[] = { LSM303DLHC_ODR_1_HZ, LSM303DLHC_ODR_10_HZ, LSM303DLHC_ODR_25_HZ,
+    LSM303DLHC_ODR_50_HZ, LSM303DLHC_ODR_100_HZ, LSM303DLHC_ODR_200_HZ, LSM303DLHC_ODR_400_HZ, LSM303DLHC_ODR_1344_HZ };
+
+/* High-pass cutoffs relative to the data rate, of LSM303DLHC_HPFCF_8..64, from the LSM303DLM data sheet since the
+ * LSM303DLHC one leaves them out */
+static const float32_t accHighPassRatios[] = { 1.0f / 50.0f, 1.0f / 100.0f, 1.0f / 200.0f, 1.0f / 400.0f };
+
+static const float32_t magDataRatesHz[] = { 0.75f, 1.5f, 3.0f, 7.5f, 15.0f, 30.0f, 75.0f, 220.0f };
+static const uint8_t magDataRateSettings[] = { LSM303DLHC_ODR_0_75_HZ, LSM303DLHC_ODR_1_5_HZ, LSM303DLHC_ODR_3_0_HZ,
+    LSM303DLHC_ODR_7_5_HZ, LSM303DLHC_ODR_15_HZ, LSM303DLHC_ODR_30_HZ, LSM303DLHC_ODR_75_HZ, LSM303DLHC_ODR_220_HZ };
+
+static HAL_StatusTypeDef LSM303DLHC_AccReadRawXYZBuffer(uint8_t * pBuffer);
+static HAL_StatusTypeDef LSM303DLHC_MagReadRawXYZBuffer(uint8_t * pBuffer);
 
 /**
  * @}
@@ -123,7 +144,7 @@ void LSM303DLHC_AccConfig(void) {
   /*  Low level init */
   COMPASSACCELERO_IO_Init();
 
-  accConfig.dataRate = LSM303DLHC_ODR_200_HZ;
+  accConfig.dataRate = accDataRateSetting;
 
   /* set up accelerometer */
   uint8_t ctrlReg1 = 0x00 |
@@ -146,11 +167,49 @@ void LSM303DLHC_AccConfig(void) {
   LSM303DLHC_AccRebootCmd();
   LSM303DLHC_AccInit(ctrlReg1, ctrlReg3, ctrlReg4);
 
-  LSM303DLHC_AccFilterCmd(LSM303DLHC_HIGHPASSFILTER_DISABLE);
-//  LSM303DLHC_AccFilterConfig(LSM303DLHC_HPM_NORMAL_MODE |
-//      LSM303DLHC_HPFCF_16 | // according to LSM303DLM (other sensor!) data sheet, this gives 0.25 Hz cut off frequency
-//      LSM303DLHC_HPF_AOI1_DISABLE |
-//      LSM303DLHC_HPF_AOI2_DISABLE);
+  LSM303DLHC_AccFilterConfig(LSM303DLHC_HPM_NORMAL_MODE |
+      accHighPassCutoffSetting |
+      LSM303DLHC_HPF_AOI1_DISABLE |
+      LSM303DLHC_HPF_AOI2_DISABLE);
+  LSM303DLHC_AccFilterCmd(accHighPassState);
+}
+
+/**
+ * @brief  Selects the accelerometer data rate and high-pass cutoff nearest to the requested ones, to be applied
+ *         by the next LSM303DLHC_AccConfig. A high-pass of 0 leaves the high-pass out.
+ * @param  pDataRateHz : Requested data rate in, selected one out [Hz]
+ * @param  pHighPassHz : Requested high-pass cutoff in, selected one out [Hz]
+ * @retval zero upon success, nonzero upon error
+ */
+uint8_t LSM303DLHC_AccSetRates(float32_t* pDataRateHz, float32_t* pHighPassHz) {
+  uint8_t rateIdx = 0, cutoffIdx = 0;
+  uint8_t i;
+
+  if (*pDataRateHz <= 0.0f || *pHighPassHz < 0.0f) {
+    return 1; // error
+  }
+
+  for (i = 1; i < sizeof(accDataRatesHz) / sizeof(accDataRatesHz[0]); i++) {
+    if (fabsf(*pDataRateHz - accDataRatesHz[i]) < fabsf(*pDataRateHz - accDataRatesHz[rateIdx])) {
+      rateIdx = i;
+    }
+  }
+  /* The cutoffs halve per step, so the nearest one is the nearest ratio */
+  for (i = 1; *pHighPassHz > 0.0f && i < sizeof(accHighPassRatios) / sizeof(accHighPassRatios[0]); i++) {
+    if (fabsf(logf(*pHighPassHz / (accHighPassRatios[i] * accDataRatesHz[rateIdx])))
+        < fabsf(logf(*pHighPassHz / (accHighPassRatios[cutoffIdx] * accDataRatesHz[rateIdx])))) {
+      cutoffIdx = i;
+    }
+  }
+
+  accDataRateSetting = accDataRateSettings[rateIdx];
+  accHighPassCutoffSetting = (uint8_t) (cutoffIdx << 4);
+  accHighPassState = (*pHighPassHz > 0.0f) ? LSM303DLHC_HIGHPASSFILTER_ENABLE : LSM303DLHC_HIGHPASSFILTER_DISABLE;
+
+  *pDataRateHz = accDataRatesHz[rateIdx];
+  *pHighPassHz = (*pHighPassHz > 0.0f) ? accHighPassRatios[cutoffIdx] * accDataRatesHz[rateIdx] : 0.0f;
+
+  return 0;
 }
 
 
@@ -270,12 +329,45 @@ void LSM303DLHC_AccFilterCmd(uint8_t HighPassFilterState)
 /**
  * @brief  Read X, Y & Z Acceleration values
  * @param  pfData : Data out pointer
- * @retval None
+ * @retval HAL_OK if read successful
  */
 HAL_StatusTypeDef LSM303DLHC_AccReadXYZ(float * pData) {
     HAL_StatusTypeDef status = 0;
-    uint8_t buffer[6];
-    uint8_t i = 0;
+    uint8_t buffer[LSM303DLHC_XYZ_BUFFER_SIZE];
+
+    status = LSM303DLHC_AccReadRawXYZBuffer(buffer);
+
+    if(status == HAL_OK) {
+        LSM303DLHC_AccConvertXYZ(buffer, pData);
+    }
+
+    return status;
+}
+
+/**
+ * @brief  Read raw X, Y & Z acceleration, see LSM303DLHC_AccRawXYZ
+ * @param  pRawData : Data out pointer (size 3)
+ * @retval HAL_OK if read successful
+ */
+HAL_StatusTypeDef LSM303DLHC_AccReadRawXYZ(int16_t * pRawData) {
+    HAL_StatusTypeDef status = 0;
+    uint8_t buffer[LSM303DLHC_XYZ_BUFFER_SIZE];
+
+    status = LSM303DLHC_AccReadRawXYZBuffer(buffer);
+
+    if(status == HAL_OK) {
+        LSM303DLHC_AccRawXYZ(buffer, pRawData);
+    }
+
+    return status;
+}
+
+/**
+ * @brief  Read the X, Y & Z acceleration output registers
+ * @param  pBuffer : Raw data out pointer, LSM303DLHC_XYZ_BUFFER_SIZE bytes
+ * @retval HAL_OK if read successful
+ */
+static HAL_StatusTypeDef LSM303DLHC_AccReadRawXYZBuffer(uint8_t * pBuffer) {
 
     /* Read output register X, Y & Z acceleration
      *
@@ -287,26 +379,179 @@ HAL_StatusTypeDef LSM303DLHC_AccReadXYZ(float * pData) {
      * It also means that we only send the slave address once for 6 bytes
      * instead of once for every byte read, this makes reading go faster.
      */
-    status = I2Cx_ReadDataLen(ACC_I2C_ADDRESS, LSM303DLHC_OUT_X_L_A | 0x80, buffer, 6);
+    return I2Cx_ReadDataLen(ACC_I2C_ADDRESS, LSM303DLHC_OUT_X_L_A | 0x80, pBuffer, LSM303DLHC_XYZ_BUFFER_SIZE);
+}
+
+/**
+ * @brief  Start a non-blocking (interrupt driven) read of the X, Y & Z
+ *         acceleration output registers. Completion is signalled through
+ *         HAL_I2C_MemRxCpltCallback, convert with LSM303DLHC_AccConvertXYZ.
+ * @param  pBuffer : Raw data out pointer, LSM303DLHC_XYZ_BUFFER_SIZE bytes,
+ *         must stay valid until the transfer completes
+ * @retval HAL_OK if transfer started
+ */
+HAL_StatusTypeDef LSM303DLHC_AccStartReadXYZ_IT(uint8_t * pBuffer) {
+    /* see LSM303DLHC_AccReadXYZ comments on the SUB address MSB */
+    return I2Cx_ReadDataLen_IT(ACC_I2C_ADDRESS, LSM303DLHC_OUT_X_L_A | 0x80, pBuffer, LSM303DLHC_XYZ_BUFFER_SIZE);
+}
+
+/**
+ * @brief  Convert raw acceleration output registers to X, Y & Z acceleration
+ * @param  pBuffer : Raw data in pointer, LSM303DLHC_XYZ_BUFFER_SIZE bytes starting at OUT_X_L_A
+ * @param  pData : Data out pointer [m/(s * s)]
+ * @retval None
+ */
+void LSM303DLHC_AccConvertXYZ(const uint8_t * pBuffer, float * pData) {
+    int16_t rawData[3];
+    float32_t scale = LSM303DLHC_AccScale();
+    uint8_t i = 0;
+
+    LSM303DLHC_AccRawXYZ(pBuffer, rawData);
+
+    for (i = 0; i < 3; i++) {
+        pData[i] = (float32_t) rawData[i] * scale;
+    }
+}
+
+/**
+ * @brief  Assemble the raw acceleration output registers to X, Y & Z int16
+ *         values. The 12-bit samples are left aligned, i.e. not shifted.
+ * @param  pBuffer : Raw data in pointer, LSM303DLHC_XYZ_BUFFER_SIZE bytes starting at OUT_X_L_A
+ * @param  pRawData : Data out pointer (size 3), multiply by LSM303DLHC_AccScale for m/(s * s)
+ * @retval None
+ */
+void LSM303DLHC_AccRawXYZ(const uint8_t * pBuffer, int16_t * pRawData) {
+    uint8_t i = 0;
 
     /* check in the control register4 the data alignment
      *
      * We use LSM303DLHC_BLE_LSB convention.
      */
+    for (i = 0; i < 3; i++) {
+        pRawData[i] = (int16_t) ((int16_t) (pBuffer[2 * i + 1] << 8) + pBuffer[2 * i]);
+    }
+}
+
+/**
+ * @brief  Get the acceleration of one LSB of the values from LSM303DLHC_AccRawXYZ
+ * @param  None
+ * @retval Scale [m/(s * s) per LSB]
+ */
+float32_t LSM303DLHC_AccScale(void) {
+    /* 12-bit value alignment ("shift 4 right"), sensitivity [milli-G/LSB], milli-G to m/(s * s) */
+    return (float32_t) accConfig.sensitivity * (9.82f / 1000.0f / 16.0f);
+}
+
+/**
+ * @brief  Enable the accelerometer FIFO in stream mode with the watermark
+ *         interrupt on INT1 instead of data ready. Call after LSM303DLHC_AccConfig.
+ * @param  dataRate : output data rate, see Acc_OutPut_DataRate_Selection
+ * @param  watermark : FIFO level (1..31) at which INT1 goes high
+ * @retval zero upon success, nonzero upon error
+ */
+uint8_t LSM303DLHC_AccConfigFIFO(uint8_t dataRate, uint8_t watermark) {
+    uint8_t tmpreg;
+
+    if ((watermark == 0) || (watermark > LSM303DLHC_ACC_FIFO_WATERMARK_MASK)) {
+        return 1; // error
+    }
+
+    accConfig.dataRate = dataRate;
+
+    /* Set data rate, keep power mode and axes */
+    tmpreg = I2Cx_ReadData(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG1_A);
+    tmpreg &= 0x0F;
+    tmpreg |= dataRate;
+    I2Cx_WriteData(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG1_A, tmpreg);
+
+    /* Stream mode - the oldest samples are overwritten if the FIFO is not drained in time */
+    I2Cx_WriteData(ACC_I2C_ADDRESS, LSM303DLHC_FIFO_CTRL_REG_A,
+            LSM303DLHC_ACC_FIFO_MODE_STREAM | (watermark & LSM303DLHC_ACC_FIFO_WATERMARK_MASK));
+
+    tmpreg = I2Cx_ReadData(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG5_A);
+    tmpreg |= LSM303DLHC_ACC_FIFO_ENABLE;
+    I2Cx_WriteData(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG5_A, tmpreg);
+
+    /* Route watermark instead of data ready to INT1 */
+    tmpreg = I2Cx_ReadData(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG3_A);
+    tmpreg &= ~LSM303DLHC_IT1_DRY1;
+    tmpreg |= LSM303DLHC_IT1_WTM;
+    I2Cx_WriteData(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG3_A, tmpreg);
+
+    return 0;
+}
+
+/**
+ * @brief  Read the number of unread samples in the accelerometer FIFO
+ * @param  pNbrOfSamples : Number of samples out pointer
+ * @retval HAL_OK if read successful
+ */
+HAL_StatusTypeDef LSM303DLHC_AccReadFIFOLevel(uint8_t * pNbrOfSamples) {
+    HAL_StatusTypeDef status = HAL_OK;
+    uint8_t fifoSrc = 0;
+
+    *pNbrOfSamples = 0;
+
+    status = I2Cx_ReadDataLen(ACC_I2C_ADDRESS, LSM303DLHC_FIFO_SRC_REG_A, &fifoSrc, 1);
+
     if(status == HAL_OK) {
-        for (i = 0; i < 3; i++) {
-            int16_t rawData = (int16_t) ((int16_t) (buffer[2 * i + 1] << 8) + buffer[2 * i]); /* convert to int16_t */
-            float asFloat = (float) rawData; /* convert to float (int16_t & float are two's complement) */
-            asFloat = asFloat / 16; /* handle 12-bit value alignment ("shift 4 right") */
-            asFloat = asFloat * accConfig.sensitivity; /* apply sensitivity convert from LSB to milli-G */
-            asFloat = asFloat * 9.82 / 1000; /* convert from milli-G to m/(s * s)       */
-            pData[i] = asFloat; /* store output */
-        }
+        *pNbrOfSamples = LSM303DLHC_AccFIFOLevel(fifoSrc);
     }
 
     return status;
 }
 
+/**
+ * @brief  As LSM303DLHC_AccReadFIFOLevel but non-blocking (interrupt driven),
+ *         completion is signalled through HAL_I2C_MemRxCpltCallback. Convert
+ *         with LSM303DLHC_AccFIFOLevel.
+ * @param  pFifoSrc : FIFO_SRC_REG_A out pointer, must stay valid until the transfer completes
+ * @retval HAL_OK if transfer started
+ */
+HAL_StatusTypeDef LSM303DLHC_AccStartReadFIFOLevel_IT(uint8_t * pFifoSrc) {
+    return I2Cx_ReadDataLen_IT(ACC_I2C_ADDRESS, LSM303DLHC_FIFO_SRC_REG_A, pFifoSrc, 1);
+}
+
+/**
+ * @brief  Get the number of unread samples in the accelerometer FIFO
+ * @param  fifoSrc : FIFO_SRC_REG_A value
+ * @retval Number of unread samples
+ */
+uint8_t LSM303DLHC_AccFIFOLevel(uint8_t fifoSrc) {
+    if (fifoSrc & LSM303DLHC_ACC_FIFO_SRC_OVRN) {
+        return LSM303DLHC_ACC_FIFO_SIZE; /* FSS wraps when all slots are filled */
+    } else if (fifoSrc & LSM303DLHC_ACC_FIFO_SRC_EMPTY) {
+        return 0;
+    }
+    return fifoSrc & LSM303DLHC_ACC_FIFO_SRC_FSS_MASK;
+}
+
+/**
+ * @brief  Read samples from the accelerometer FIFO with one multi-byte read.
+ *         With the FIFO enabled the auto-incremented SUB address rolls back
+ *         from OUT_Z_H_A to OUT_X_L_A, so consecutive samples follow each other.
+ * @param  pBuffer : Raw data out pointer, LSM303DLHC_XYZ_BUFFER_SIZE bytes per sample
+ * @param  nbrOfSamples : Number of samples to read, see LSM303DLHC_AccReadFIFOLevel
+ * @retval HAL_OK if read successful
+ */
+HAL_StatusTypeDef LSM303DLHC_AccReadFIFO(uint8_t * pBuffer, uint8_t nbrOfSamples) {
+    /* see LSM303DLHC_AccReadXYZ comments on the SUB address MSB */
+    return I2Cx_ReadDataLen(ACC_I2C_ADDRESS, LSM303DLHC_OUT_X_L_A | 0x80, pBuffer,
+            nbrOfSamples * LSM303DLHC_XYZ_BUFFER_SIZE);
+}
+
+/**
+ * @brief  As LSM303DLHC_AccReadFIFO but non-blocking (interrupt driven),
+ *         completion is signalled through HAL_I2C_MemRxCpltCallback.
+ * @param  pBuffer : Raw data out pointer, must stay valid until the transfer completes
+ * @param  nbrOfSamples : Number of samples to read, see LSM303DLHC_AccReadFIFOLevel
+ * @retval HAL_OK if transfer started
+ */
+HAL_StatusTypeDef LSM303DLHC_AccStartReadFIFO_IT(uint8_t * pBuffer, uint8_t nbrOfSamples) {
+    return I2Cx_ReadDataLen_IT(ACC_I2C_ADDRESS, LSM303DLHC_OUT_X_L_A | 0x80, pBuffer,
+            nbrOfSamples * LSM303DLHC_XYZ_BUFFER_SIZE);
+}
+
 /**
  * @brief  Enable or Disable High Pass Filter on CLick
  * @param  HighPassFilterState: new state of the High Pass Filter feature.
@@ -644,7 +889,7 @@ void LSM303DLHC_MagInit(void)
   magConfig.xySensitivity = LSM303DLHC_M_SENSITIVITY_XY_1_3Ga;
   magConfig.zSensitivity = LSM303DLHC_M_SENSITIVITY_Z_1_3Ga;
   magConfig.dataRate = LSM303DLHC_ODR_220_HZ;
-  magConfig.temperatureSensor = LSM303DLHC_TEMPSENSOR_DISABLE;
+  magConfig.temperatureSensor = LSM303DLHC_TEMPSENSOR_ENABLE; /* see LSM303DLHC_MagReadTemperature */
 
   /* Configure MEMS: temp and Data rate */
   cra_regm |= (uint8_t) (magConfig.temperatureSensor | magConfig.dataRate);
@@ -665,6 +910,39 @@ void LSM303DLHC_MagInit(void)
   I2Cx_WriteData(MAG_I2C_ADDRESS, LSM303DLHC_MR_REG_M, mr_regm);
 }
 
+/**
+ * @brief  Set the magnetometer output data rate. Call after LSM303DLHC_MagInit.
+ * @param  dataRate : output data rate, see Mag_Data_Rate
+ * @retval None
+ */
+void LSM303DLHC_MagConfigDataRate(uint8_t dataRate)
+{
+  magConfig.dataRate = dataRate;
+
+  I2Cx_WriteData(MAG_I2C_ADDRESS, LSM303DLHC_CRA_REG_M,
+      (uint8_t) (magConfig.temperatureSensor | magConfig.dataRate));
+}
+
+/**
+ * @brief  Gets the magnetometer data rate nearest to the requested one, for LSM303DLHC_MagConfigDataRate
+ * @param  pDataRateHz : Requested data rate in, selected one out [Hz]
+ * @retval output data rate, see Mag_Data_Rate
+ */
+uint8_t LSM303DLHC_MagNearestDataRate(float32_t* pDataRateHz)
+{
+  uint8_t rateIdx = 0;
+  uint8_t i;
+
+  for (i = 1; i < sizeof(magDataRatesHz) / sizeof(magDataRatesHz[0]); i++) {
+    if (fabsf(*pDataRateHz - magDataRatesHz[i]) < fabsf(*pDataRateHz - magDataRatesHz[rateIdx])) {
+      rateIdx = i;
+    }
+  }
+
+  *pDataRateHz = magDataRatesHz[rateIdx];
+  return magDataRateSettings[rateIdx];
+}
+
 /**
  * @brief  Get status for Mag LSM303DLHC data
  * @param  None
@@ -684,18 +962,93 @@ uint8_t LSM303DLHC_MagGetDataStatus(void)
 /**
  * @brief  Read X, Y & Z Magnetometer  values
  * @param  pfData : Data out pointer
- * @retval None
+ * @retval HAL_OK if read successful
  */
 HAL_StatusTypeDef LSM303DLHC_MagReadXYZ(float32_t* pfData) {
     HAL_StatusTypeDef status = HAL_OK;
-    float pnRawData[3];
-    uint8_t buffer[6];
+    uint8_t buffer[LSM303DLHC_XYZ_BUFFER_SIZE];
+
+    status = LSM303DLHC_MagReadRawXYZBuffer(buffer);
+
+    if(status == HAL_OK) {
+        LSM303DLHC_MagConvertXYZ(buffer, pfData);
+    }
+
+    return status;
+}
+
+/**
+ * @brief  Read raw X, Y & Z Magnetometer values, see LSM303DLHC_MagRawXYZ
+ * @param  pRawData : Data out pointer (size 3)
+ * @retval HAL_OK if read successful
+ */
+HAL_StatusTypeDef LSM303DLHC_MagReadRawXYZ(int16_t* pRawData) {
+    HAL_StatusTypeDef status = HAL_OK;
+    uint8_t buffer[LSM303DLHC_XYZ_BUFFER_SIZE];
+
+    status = LSM303DLHC_MagReadRawXYZBuffer(buffer);
+
+    if(status == HAL_OK) {
+        LSM303DLHC_MagRawXYZ(buffer, pRawData);
+    }
+
+    return status;
+}
+
+/**
+ * @brief  Read the X, Y & Z magnetometer output registers
+ * @param  pBuffer : Raw data out pointer, LSM303DLHC_XYZ_BUFFER_SIZE bytes
+ * @retval HAL_OK if read successful
+ */
+static HAL_StatusTypeDef LSM303DLHC_MagReadRawXYZBuffer(uint8_t * pBuffer) {
     uint8_t addr = MAG_I2C_ADDRESS + 1; // see section 5.1.3 of LSM303DLHC data sheet
 
     /* Read output register X, Y & Z acceleration */
-    status = I2Cx_ReadDataLen(addr,
+    return I2Cx_ReadDataLen(addr,
             LSM303DLHC_OUT_X_H_M | 0x80, /* see LSM303DLHC_MagReadXYZ comments */
-            buffer, 6);
+            pBuffer, LSM303DLHC_XYZ_BUFFER_SIZE);
+}
+
+/**
+ * @brief  Start a non-blocking (interrupt driven) read of the X, Y & Z
+ *         magnetometer output registers. Completion is signalled through
+ *         HAL_I2C_MemRxCpltCallback, convert with LSM303DLHC_MagConvertXYZ.
+ * @param  pBuffer : Raw data out pointer, LSM303DLHC_XYZ_BUFFER_SIZE bytes,
+ *         must stay valid until the transfer completes
+ * @retval HAL_OK if transfer started
+ */
+HAL_StatusTypeDef LSM303DLHC_MagStartReadXYZ_IT(uint8_t * pBuffer) {
+    uint8_t addr = MAG_I2C_ADDRESS + 1; // see section 5.1.3 of LSM303DLHC data sheet
+
+    return I2Cx_ReadDataLen_IT(addr, LSM303DLHC_OUT_X_H_M | 0x80, pBuffer, LSM303DLHC_XYZ_BUFFER_SIZE);
+}
+
+/**
+ * @brief  Convert raw magnetometer output registers to X, Y & Z magnetic field
+ * @param  pBuffer : Raw data in pointer, LSM303DLHC_XYZ_BUFFER_SIZE bytes starting at OUT_X_H_M
+ * @param  pfData : Data out pointer [gauss]
+ * @retval None
+ */
+void LSM303DLHC_MagConvertXYZ(const uint8_t * pBuffer, float32_t* pfData) {
+    int16_t rawData[3];
+    float32_t scale[3];
+
+    LSM303DLHC_MagRawXYZ(pBuffer, rawData);
+    LSM303DLHC_MagScale(scale);
+
+    /* Obtain the Gauss value for the three axis */
+    pfData[0] = (float32_t) rawData[0] * scale[0];
+    pfData[1] = (float32_t) rawData[1] * scale[1];
+    pfData[2] = (float32_t) rawData[2] * scale[2];
+}
+
+/**
+ * @brief  Assemble the raw magnetometer output registers to X, Y & Z int16 values
+ * @param  pBuffer : Raw data in pointer, LSM303DLHC_XYZ_BUFFER_SIZE bytes starting at OUT_X_H_M
+ * @param  pRawData : Data out pointer (size 3), multiply by LSM303DLHC_MagScale for gauss
+ * @retval None
+ */
+void LSM303DLHC_MagRawXYZ(const uint8_t * pBuffer, int16_t * pRawData) {
 
     /*
      * all 6 bytes were read in the order they are stored in the LSM303DLHC
@@ -712,20 +1065,43 @@ HAL_StatusTypeDef LSM303DLHC_MagReadXYZ(float32_t* pfData) {
     /* check in the control register4 the data alignment -
      * assume little endian (we never change it on the fly)
      */
-    if(status == HAL_OK) {
-        pnRawData[0] = ((int16_t) (buffer[0] << 8) + (int16_t) buffer[1]); // X
-        pnRawData[1] = ((int16_t) (buffer[4] << 8) + (int16_t) buffer[5]); // Y
-        pnRawData[2] = ((int16_t) (buffer[2] << 8) + (int16_t) buffer[3]); // Z
-
-        /* Obtain the Gauss value for the three axis */
-        pfData[0] = (float32_t)pnRawData[0] / magConfig.xySensitivity;
-        pfData[1] = (float32_t)pnRawData[1] / magConfig.xySensitivity;
-        pfData[2] = (float32_t)pnRawData[2] / magConfig.zSensitivity;
+    pRawData[0] = (int16_t) ((int16_t) (pBuffer[0] << 8) + (int16_t) pBuffer[1]); // X
+    pRawData[1] = (int16_t) ((int16_t) (pBuffer[4] << 8) + (int16_t) pBuffer[5]); // Y
+    pRawData[2] = (int16_t) ((int16_t) (pBuffer[2] << 8) + (int16_t) pBuffer[3]); // Z
+}
+
+/**
+ * @brief  Read the die temperature. The sensor has a part specific offset, so
+ *         the value is relative. It is updated at the magnetometer data rate.
+ * @param  pTemperature : Temperature out pointer [deg C / LSM303DLHC_TEMP_SENSITIVITY, relative]
+ * @retval HAL_OK if read successful
+ */
+HAL_StatusTypeDef LSM303DLHC_MagReadTemperature(int16_t * pTemperature) {
+    uint8_t addr = MAG_I2C_ADDRESS + 1; // see section 5.1.3 of LSM303DLHC data sheet
+    uint8_t buffer[2];
+    HAL_StatusTypeDef status = HAL_OK;
+
+    status = I2Cx_ReadDataLen(addr, LSM303DLHC_TEMP_OUT_H_M | 0x80, buffer, sizeof(buffer));
+
+    if (status == HAL_OK) {
+        /* 12-bit two's complement, left aligned: TEMP_OUT_L_M holds the low nibble in its upper bits */
+        *pTemperature = (int16_t) ((int16_t) (buffer[0] << 8) + (int16_t) buffer[1]) >> 4;
     }
 
     return status;
 }
 
+/**
+ * @brief  Get the magnetic field of one LSB of the values from LSM303DLHC_MagRawXYZ
+ * @param  pScale : Scale out pointer (size 3) [gauss per LSB]
+ * @retval None
+ */
+void LSM303DLHC_MagScale(float32_t * pScale) {
+    pScale[0] = 1.0f / magConfig.xySensitivity;
+    pScale[1] = 1.0f / magConfig.xySensitivity;
+    pScale[2] = 1.0f / magConfig.zSensitivity;
+}
+
 /**
  * Returns configured magnetometer data rate in hertz.
  *
@@ -129,6 +129,8 @@
 
 #define I_AM_LMS303DLHC                   ((uint8_t)0x33)
 
+#define LSM303DLHC_XYZ_BUFFER_SIZE        6 /* bytes in the X, Y & Z output registers of acc or mag */
+
 
 /** @defgroup Acc_Power_Mode_selection
   * @{
@@ -298,6 +300,23 @@
   * @}
   */
 
+/** @defgroup Acc_FIFO_Configuration_definition
+  * @{
+  */
+#define LSM303DLHC_ACC_FIFO_ENABLE         ((uint8_t)0x40) /* CTRL_REG5_A */
+#define LSM303DLHC_ACC_FIFO_MODE_BYPASS    ((uint8_t)0x00)
+#define LSM303DLHC_ACC_FIFO_MODE_FIFO      ((uint8_t)0x40)
+#define LSM303DLHC_ACC_FIFO_MODE_STREAM    ((uint8_t)0x80)
+#define LSM303DLHC_ACC_FIFO_WATERMARK_MASK ((uint8_t)0x1F)
+#define LSM303DLHC_ACC_FIFO_SRC_WTM        ((uint8_t)0x80) /* FIFO filling above watermark */
+#define LSM303DLHC_ACC_FIFO_SRC_OVRN       ((uint8_t)0x40) /* FIFO full, oldest sample overwritten */
+#define LSM303DLHC_ACC_FIFO_SRC_EMPTY      ((uint8_t)0x20)
+#define LSM303DLHC_ACC_FIFO_SRC_FSS_MASK   ((uint8_t)0x1F) /* number of unread samples */
+#define LSM303DLHC_ACC_FIFO_SIZE           32 /* samples (x, y & z) the FIFO holds */
+/**
+  * @}
+  */
+
 /** @defgroup Acc_LSM303DLHC_Interrupt2_Configuration_definition
   * @{
   */
@@ -432,6 +451,7 @@
   */
 #define LSM303DLHC_TEMPSENSOR_ENABLE         ((uint8_t) 0x80)   /*!< Temp sensor Enable */
 #define LSM303DLHC_TEMPSENSOR_DISABLE        ((uint8_t) 0x00)   /*!< Temp sensor Disable */
+#define LSM303DLHC_TEMP_SENSITIVITY          8                  /*!< temperature sensor sensitivity [LSB/deg C] */
 /**
   * @}
   */
@@ -448,6 +468,17 @@ void      LSM303DLHC_AccRebootCmd(void);
 void      LSM303DLHC_AccFilterConfig(uint8_t FilterStruct);
 void      LSM303DLHC_AccFilterCmd(uint8_t HighPassFilterState);
 HAL_StatusTypeDef LSM303DLHC_AccReadXYZ(float* pData);
+HAL_StatusTypeDef LSM303DLHC_AccStartReadXYZ_IT(uint8_t * pBuffer);
+void      LSM303DLHC_AccConvertXYZ(const uint8_t * pBuffer, float * pData);
+HAL_StatusTypeDef LSM303DLHC_AccReadRawXYZ(int16_t * pRawData);
+void      LSM303DLHC_AccRawXYZ(const uint8_t * pBuffer, int16_t * pRawData);
+float32_t LSM303DLHC_AccScale(void);
+uint8_t   LSM303DLHC_AccConfigFIFO(uint8_t dataRate, uint8_t watermark);
+HAL_StatusTypeDef LSM303DLHC_AccReadFIFOLevel(uint8_t * pNbrOfSamples);
+HAL_StatusTypeDef LSM303DLHC_AccStartReadFIFOLevel_IT(uint8_t * pFifoSrc);
+uint8_t   LSM303DLHC_AccFIFOLevel(uint8_t fifoSrc);
+HAL_StatusTypeDef LSM303DLHC_AccReadFIFO(uint8_t * pBuffer, uint8_t nbrOfSamples);
+HAL_StatusTypeDef LSM303DLHC_AccStartReadFIFO_IT(uint8_t * pBuffer, uint8_t nbrOfSamples);
 void      LSM303DLHC_AccFilterClickCmd(uint8_t HighPassFilterClickState);
 void      LSM303DLHC_AccIT1Enable(uint8_t LSM303DLHC_IT);
 void      LSM303DLHC_AccIT1Disable(uint8_t LSM303DLHC_IT);
@@ -461,6 +492,7 @@ void      LSM303DLHC_AccClickITEnable(uint8_t ITClick);
 void      LSM303DLHC_AccClickITDisable(uint8_t ITClick);
 void      LSM303DLHC_AccZClickITConfig(void);
 uint16_t  LSM303DLHC_AccDataRateHz(void); /* see source file fcn banner */
+uint8_t   LSM303DLHC_AccSetRates(float32_t* pDataRateHz, float32_t* pHighPassHz);
 
 /* Mag functions */
 
@@ -468,6 +500,8 @@ uint16_t  LSM303DLHC_AccDataRateHz(void); /* see source file fcn banner */
  * see source file function banner
  */
 void LSM303DLHC_MagInit(void);
+void LSM303DLHC_MagConfigDataRate(uint8_t dataRate);
+uint8_t LSM303DLHC_MagNearestDataRate(float32_t* pDataRateHz);
 
 /**
   * @brief  Read X, Y & Z Magnetometer  values
@@ -475,6 +509,12 @@ void LSM303DLHC_MagInit(void);
   * @retval None
   */
 HAL_StatusTypeDef LSM303DLHC_MagReadXYZ(float32_t* pfData);
+HAL_StatusTypeDef LSM303DLHC_MagStartReadXYZ_IT(uint8_t * pBuffer);
+void LSM303DLHC_MagConvertXYZ(const uint8_t * pBuffer, float32_t* pfData);
+HAL_StatusTypeDef LSM303DLHC_MagReadRawXYZ(int16_t* pRawData);
+void LSM303DLHC_MagRawXYZ(const uint8_t * pBuffer, int16_t * pRawData);
+void LSM303DLHC_MagScale(float32_t * pScale);
+HAL_StatusTypeDef LSM303DLHC_MagReadTemperature(int16_t * pTemperature);
 
 float32_t LSM303DLHC_MagDataRateHz(void); /* see source fcn banner */
 
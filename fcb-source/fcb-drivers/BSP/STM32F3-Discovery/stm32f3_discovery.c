@@ -104,6 +104,9 @@ const uint8_t BUTTON_IRQn[BUTTONn] = {USER_BUTTON_EXTI_IRQn};
 #ifdef HAL_SPI_MODULE_ENABLED
 uint32_t SpixTimeout = SPIx_TIMEOUT_MAX;    /*<! Value of Timeout when SPI communication fails */
 static SPI_HandleTypeDef SpiHandle;
+static DMA_HandleTypeDef SpiDmaTxHandle;
+static DMA_HandleTypeDef SpiDmaRxHandle;
+static volatile uint8_t GyroIOPolledTransferActive = 0; /*<! Set while a polled (blocking) gyro transfer owns the bus */
 #endif
 
 #ifdef HAL_I2C_MODULE_ENABLED
@@ -131,6 +134,8 @@ static void     I2Cx_MspInit(I2C_HandleTypeDef *hi2c);
 /* I2Cbar bus function */
 static void     I2Cbar_Error (void);
 static void     I2Cbar_MspInit();
+static void     I2C_RecoverBus(GPIO_TypeDef *Port, uint16_t SclPin, uint16_t SdaPin);
+static void     I2C_RecoveryDelay(void);
 #endif
 
 #ifdef HAL_SPI_MODULE_ENABLED
@@ -139,13 +144,19 @@ static void     SPIx_Init(void);
 static HAL_StatusTypeDef SPIx_WriteRead(uint8_t txByte, uint8_t* rxByte);
 static void     SPIx_Error (void);
 static void     SPIx_MspInit(SPI_HandleTypeDef *hspi);
+static void     SPIx_WaitForDMATransfer(void);
 #endif
 
 #ifdef HAL_SPI_MODULE_ENABLED
 /* Link function for GYRO peripheral */
 void            GYRO_IO_Init(void);
 void            GYRO_IO_Write(uint8_t* pBuffer, uint8_t WriteAddr, uint16_t NumByteToWrite);
-uint8_t         GYRO_IO_Read(uint8_t* pBuffer, uint8_t ReadAddr, uint16_t NumByteToRead);
+HAL_StatusTypeDef GYRO_IO_Read(uint8_t* pBuffer, uint8_t ReadAddr, uint16_t NumByteToRead);
+
+/* Link function for the external IMU peripheral */
+void            IMU_IO_Init(void);
+void            IMU_IO_Write(uint8_t* pBuffer, uint8_t WriteAddr, uint16_t NumByteToWrite);
+HAL_StatusTypeDef IMU_IO_Read(uint8_t* pBuffer, uint8_t ReadAddr, uint16_t NumByteToRead);
 #endif
 
 #ifdef HAL_I2C_MODULE_ENABLED
@@ -361,6 +372,13 @@ static void I2Cx_MspInit(I2C_HandleTypeDef *hi2c)
 
   /* Enable the I2C clock */
   DISCOVERY_I2Cx_CLK_ENABLE();
+
+  /* NVIC configuration for interrupt driven transfers */
+  HAL_NVIC_SetPriority(DISCOVERY_I2Cx_EV_IRQn, DISCOVERY_I2Cx_IRQ_PREEMPT_PRIO, DISCOVERY_I2Cx_IRQ_SUB_PRIO);
+  HAL_NVIC_EnableIRQ(DISCOVERY_I2Cx_EV_IRQn);
+
+  HAL_NVIC_SetPriority(DISCOVERY_I2Cx_ER_IRQn, DISCOVERY_I2Cx_IRQ_PREEMPT_PRIO, DISCOVERY_I2Cx_IRQ_SUB_PRIO);
+  HAL_NVIC_EnableIRQ(DISCOVERY_I2Cx_ER_IRQn);
 }
 
 /**
@@ -454,7 +472,81 @@ HAL_StatusTypeDef I2Cx_ReadDataLen(uint16_t Addr, uint8_t Reg, uint8_t * pData,
   return status;
 }
 
+/**
+  * @brief  Start a non-blocking read of registers of the device through BUS.
+  *         The slave and register address are sent by the HAL before returning,
+  *         the data bytes are received in interrupt context. Completion is
+  *         signalled by HAL_I2C_MemRxCpltCallback or HAL_I2C_ErrorCallback.
+  * @param  Addr: Device address on BUS Bus.
+  * @param  Reg: The target register address to read
+  * @param  pData: Data out pointer, must stay valid until the transfer completes
+  * @param  Len: Number of bytes to read
+  * @retval HAL_OK if transfer started
+  */
+HAL_StatusTypeDef I2Cx_ReadDataLen_IT(uint16_t Addr, uint8_t Reg, uint8_t * pData, uint16_t Len)
+{
+  HAL_StatusTypeDef status = HAL_OK;
+
+  status = HAL_I2C_Mem_Read_IT(&I2cHandle, Addr, Reg, I2C_MEMADD_SIZE_8BIT, pData, Len);
+
+  /* Check the communication status, leave the bus alone if only busy */
+  if(status != HAL_OK && status != HAL_BUSY)
+  {
+    /* Execute user timeout callback */
+    I2Cx_Error();
+  }
+
+  return status;
+}
+
+/**
+  * @brief  Re-initialises the COMPASS / ACCELEROMETER BUS, ends any transfer in
+  *         progress without a callback. Used when the sensors stopped answering,
+  *         a slave holding SDA low is clocked free first.
+  * @param  None
+  * @retval None
+  */
+void I2Cx_ResetBus(void)
+{
+  /* De-initialise the I2C communication BUS */
+  HAL_I2C_DeInit(&I2cHandle);
+
+  DISCOVERY_I2Cx_GPIO_CLK_ENABLE();
+  I2C_RecoverBus(DISCOVERY_I2Cx_GPIO_PORT, DISCOVERY_I2Cx_SCL_PIN, DISCOVERY_I2Cx_SDA_PIN);
+
+  /* Re-Initialise the I2C communication BUS, the pins are given back to the I2C */
+  I2Cx_Init();
+}
+
+/**
+  * @brief  Checks if an I2C handle is the one used for the COMPASS / ACCELEROMETER
+  * @param  hi2c : I2C handle
+  * @retval 1 if hi2c is the I2Cx handle, else 0
+  */
+uint8_t I2Cx_IsI2CHandle(I2C_HandleTypeDef *hi2c)
+{
+  return (hi2c == &I2cHandle);
+}
 
+/**
+  * @brief  Handles I2Cx event interrupt request
+  * @param  None
+  * @retval None
+  */
+void I2Cx_EV_IRQHandler(void)
+{
+  HAL_I2C_EV_IRQHandler(&I2cHandle);
+}
+
+/**
+  * @brief  Handles I2Cx error interrupt request
+  * @param  None
+  * @retval None
+  */
+void I2Cx_ER_IRQHandler(void)
+{
+  HAL_I2C_ER_IRQHandler(&I2cHandle);
+}
 
 /**
   * @brief I2C3 error treatment function
@@ -494,6 +586,13 @@ static void I2Cbar_MspInit()
 
   /* Enable the I2C clock */
   DISCOVERY_I2Cbar_CLK_ENABLE();
+
+  /* NVIC configuration for interrupt driven transfers */
+  HAL_NVIC_SetPriority(DISCOVERY_I2Cbar_EV_IRQn, DISCOVERY_I2Cbar_IRQ_PREEMPT_PRIO, DISCOVERY_I2Cbar_IRQ_SUB_PRIO);
+  HAL_NVIC_EnableIRQ(DISCOVERY_I2Cbar_EV_IRQn);
+
+  HAL_NVIC_SetPriority(DISCOVERY_I2Cbar_ER_IRQn, DISCOVERY_I2Cbar_IRQ_PREEMPT_PRIO, DISCOVERY_I2Cbar_IRQ_SUB_PRIO);
+  HAL_NVIC_EnableIRQ(DISCOVERY_I2Cbar_ER_IRQn);
 }
 
 /**
@@ -587,6 +686,118 @@ HAL_StatusTypeDef I2Cbar_ReadDataLen(uint16_t Addr, uint8_t Reg, uint8_t * pData
   return status;
 }
 
+/**
+  * @brief  Start a non-blocking write of a register of the device through BUS.
+  *         The slave and register address are sent by the HAL before returning,
+  *         the value is sent in interrupt context. Completion is signalled by
+  *         HAL_I2C_MemTxCpltCallback or HAL_I2C_ErrorCallback.
+  * @param  Addr: Device address on BUS Bus.
+  * @param  Reg: The target register address to write
+  * @param  pValue: The value to write, must stay valid until the transfer completes
+  * @retval HAL_OK if transfer started
+  */
+HAL_StatusTypeDef I2Cbar_WriteData_IT(uint16_t Addr, uint8_t Reg, uint8_t * pValue)
+{
+  HAL_StatusTypeDef status = HAL_OK;
+
+  status = HAL_I2C_Mem_Write_IT(&I2CbarHandle, Addr, (uint16_t)Reg, I2C_MEMADD_SIZE_8BIT, pValue, 1);
+
+  /* Check the communication status, leave the bus alone if only busy */
+  if(status != HAL_OK && status != HAL_BUSY)
+  {
+    /* Execute user timeout callback */
+    I2Cbar_Error();
+  }
+
+  return status;
+}
+
+/**
+  * @brief  Start a non-blocking read of registers of the device through BUS.
+  *         The slave and register address are sent by the HAL before returning,
+  *         the data bytes are received in interrupt context. Completion is
+  *         signalled by HAL_I2C_MemRxCpltCallback or HAL_I2C_ErrorCallback.
+  * @param  Addr: Device address on BUS Bus.
+  * @param  Reg: The target register address to read
+  * @param  pData: Data out pointer, must stay valid until the transfer completes
+  * @param  Len: Number of bytes to read
+  * @retval HAL_OK if transfer started
+  */
+HAL_StatusTypeDef I2Cbar_ReadDataLen_IT(uint16_t Addr, uint8_t Reg, uint8_t * pData, uint16_t Len)
+{
+  HAL_StatusTypeDef status = HAL_OK;
+
+  status = HAL_I2C_Mem_Read_IT(&I2CbarHandle, Addr, Reg, I2C_MEMADD_SIZE_8BIT, pData, Len);
+
+  /* Check the communication status, leave the bus alone if only busy */
+  if(status != HAL_OK && status != HAL_BUSY)
+  {
+    /* Execute user timeout callback */
+    I2Cbar_Error();
+  }
+
+  return status;
+}
+
+/**
+  * @brief  Re-initialises the barometer BUS, ends any transfer in progress
+  *         without a callback. Used when a completion never arrived or the
+  *         bus is stuck, a slave holding SDA low is clocked free first.
+  * @param  None
+  * @retval None
+  */
+void I2Cbar_ResetBus(void)
+{
+  /* De-initialise the I2C communication BUS */
+  HAL_I2C_DeInit(&I2CbarHandle);
+
+  DISCOVERY_I2Cbar_GPIO_CLK_ENABLE();
+  I2C_RecoverBus(DISCOVERY_I2Cbar_GPIO_PORT, DISCOVERY_I2Cbar_SCL_PIN, DISCOVERY_I2Cbar_SDA_PIN);
+
+  /* Re-Initialise the I2C communication BUS, the pins are given back to the I2C */
+  I2Cbar_Init();
+}
+
+/**
+  * @brief  Checks if an I2C handle is the one used for the BAROMETER
+  * @param  hi2c : I2C handle
+  * @retval 1 if hi2c is the I2Cbar handle, else 0
+  */
+uint8_t I2Cbar_IsI2CHandle(I2C_HandleTypeDef *hi2c)
+{
+  return (hi2c == &I2CbarHandle);
+}
+
+/**
+  * @brief  Returns the error of the last failed transfer of the barometer BUS
+  * @param  None
+  * @retval HAL_I2C_ERROR_x flags, see HAL_I2C_GetError
+  */
+uint32_t I2Cbar_GetError(void)
+{
+  return HAL_I2C_GetError(&I2CbarHandle);
+}
+
+/**
+  * @brief  Handles I2Cbar event interrupt request
+  * @param  None
+  * @retval None
+  */
+void I2Cbar_EV_IRQHandler(void)
+{
+  HAL_I2C_EV_IRQHandler(&I2CbarHandle);
+}
+
+/**
+  * @brief  Handles I2Cbar error interrupt request
+  * @param  None
+  * @retval None
+  */
+void I2Cbar_ER_IRQHandler(void)
+{
+  HAL_I2C_ER_IRQHandler(&I2CbarHandle);
+}
+
 
 
 /**
@@ -602,6 +813,74 @@ static void I2Cbar_Error (void)
   /* Re-Initialise the I2C communication BUS */
   I2Cbar_Init();
 }
+
+/**
+  * @brief  Frees an I2C BUS from a slave holding SDA low, e.g. after a reset
+  *         in the middle of a read. SCL is clocked as a GPIO until SDA is
+  *         released, then a STOP is generated. The I2C must be de-initialised
+  *         and the GPIO clock enabled.
+  * @param  Port : GPIO port of the BUS pins
+  * @param  SclPin : SCL pin
+  * @param  SdaPin : SDA pin
+  * @retval None
+  */
+static void I2C_RecoverBus(GPIO_TypeDef *Port, uint16_t SclPin, uint16_t SdaPin)
+{
+  GPIO_InitTypeDef GPIO_InitStructure;
+  uint32_t i;
+
+  /* Both lines high before they are taken as open drain outputs */
+  HAL_GPIO_WritePin(Port, SclPin | SdaPin, GPIO_PIN_SET);
+
+  GPIO_InitStructure.Pin = (SdaPin | SclPin);
+  GPIO_InitStructure.Mode = GPIO_MODE_OUTPUT_OD;
+  GPIO_InitStructure.Pull = GPIO_PULLUP;
+  GPIO_InitStructure.Speed = GPIO_SPEED_HIGH;
+  GPIO_InitStructure.Alternate = 0;
+  HAL_GPIO_Init(Port, &GPIO_InitStructure);
+
+  I2C_RecoveryDelay();
+
+  for(i = 0; i < I2C_RECOVERY_CLOCKS; i++)
+  {
+    if(HAL_GPIO_ReadPin(Port, SdaPin) == GPIO_PIN_SET)
+    {
+      break;
+    }
+
+    HAL_GPIO_WritePin(Port, SclPin, GPIO_PIN_RESET);
+    I2C_RecoveryDelay();
+    HAL_GPIO_WritePin(Port, SclPin, GPIO_PIN_SET);
+    I2C_RecoveryDelay();
+  }
+
+  /* STOP, SDA rises while SCL is high */
+  HAL_GPIO_WritePin(Port, SclPin, GPIO_PIN_RESET);
+  I2C_RecoveryDelay();
+  HAL_GPIO_WritePin(Port, SdaPin, GPIO_PIN_RESET);
+  I2C_RecoveryDelay();
+  HAL_GPIO_WritePin(Port, SclPin, GPIO_PIN_SET);
+  I2C_RecoveryDelay();
+  HAL_GPIO_WritePin(Port, SdaPin, GPIO_PIN_SET);
+  I2C_RecoveryDelay();
+}
+
+/**
+  * @brief  Busy waits about I2C_RECOVERY_HALF_PERIOD_US, the recovery is
+  *         too short for the tick
+  * @param  None
+  * @retval None
+  */
+static void I2C_RecoveryDelay(void)
+{
+  /* About 4 cycles per iteration */
+  volatile uint32_t count = (SystemCoreClock / 1000000) * I2C_RECOVERY_HALF_PERIOD_US / 4;
+
+  while(count > 0)
+  {
+    count--;
+  }
+}
 #endif
 
 
@@ -701,6 +980,82 @@ static void SPIx_MspInit(SPI_HandleTypeDef *hspi)
   GPIO_InitStructure.Speed = GPIO_SPEED_HIGH;
   GPIO_InitStructure.Alternate = DISCOVERY_SPIx_AF;
   HAL_GPIO_Init(DISCOVERY_SPIx_GPIO_PORT, &GPIO_InitStructure);
+
+  /* Enable DMA clock */
+  DISCOVERY_SPIx_DMA_CLK_ENABLE();
+
+  /* Configure the DMA handler for the transmission (address + dummy bytes) */
+  SpiDmaTxHandle.Instance                 = DISCOVERY_SPIx_TX_DMA_CHANNEL;
+  SpiDmaTxHandle.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+  SpiDmaTxHandle.Init.PeriphInc           = DMA_PINC_DISABLE;
+  SpiDmaTxHandle.Init.MemInc              = DMA_MINC_ENABLE;
+  SpiDmaTxHandle.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  SpiDmaTxHandle.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+  SpiDmaTxHandle.Init.Mode                = DMA_NORMAL;
+  SpiDmaTxHandle.Init.Priority            = DMA_PRIORITY_HIGH;
+
+  HAL_DMA_Init(&SpiDmaTxHandle);
+  __HAL_LINKDMA(&SpiHandle, hdmatx, SpiDmaTxHandle);
+
+  /* Configure the DMA handler for the reception of the register contents */
+  SpiDmaRxHandle.Instance                 = DISCOVERY_SPIx_RX_DMA_CHANNEL;
+  SpiDmaRxHandle.Init.Direction           = DMA_PERIPH_TO_MEMORY;
+  SpiDmaRxHandle.Init.PeriphInc           = DMA_PINC_DISABLE;
+  SpiDmaRxHandle.Init.MemInc              = DMA_MINC_ENABLE;
+  SpiDmaRxHandle.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  SpiDmaRxHandle.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+  SpiDmaRxHandle.Init.Mode                = DMA_NORMAL;
+  SpiDmaRxHandle.Init.Priority            = DMA_PRIORITY_VERY_HIGH;
+
+  HAL_DMA_Init(&SpiDmaRxHandle);
+  __HAL_LINKDMA(&SpiHandle, hdmarx, SpiDmaRxHandle);
+
+  /* NVIC configuration for DMA transfer complete interrupts */
+  HAL_NVIC_SetPriority(DISCOVERY_SPIx_DMA_TX_IRQn, DISCOVERY_SPIx_DMA_IRQ_PREEMPT_PRIO, DISCOVERY_SPIx_DMA_IRQ_SUB_PRIO);
+  HAL_NVIC_EnableIRQ(DISCOVERY_SPIx_DMA_TX_IRQn);
+
+  HAL_NVIC_SetPriority(DISCOVERY_SPIx_DMA_RX_IRQn, DISCOVERY_SPIx_DMA_IRQ_PREEMPT_PRIO, DISCOVERY_SPIx_DMA_IRQ_SUB_PRIO);
+  HAL_NVIC_EnableIRQ(DISCOVERY_SPIx_DMA_RX_IRQn);
+}
+
+/**
+  * @brief  Waits for an ongoing SPIx DMA transfer to finish. The transfer complete
+  *         interrupt sets the state back to ready, so this only spins for the
+  *         duration of one burst read (~12 us at 4.5 MHz). If it never comes the
+  *         transfer is aborted, as the DMA would otherwise still own the SPI data
+  *         register during the polled transfer that follows. The sensor then sees
+  *         a lost sample, from which its recovery takes over.
+  * @param  None
+  * @retval None
+  */
+static void SPIx_WaitForDMATransfer(void)
+{
+  uint32_t timeout = SpixTimeout;
+
+  while(HAL_SPI_GetState(&SpiHandle) == HAL_SPI_STATE_BUSY_TX_RX && timeout != 0)
+  {
+    timeout--;
+  }
+
+  if(HAL_SPI_GetState(&SpiHandle) == HAL_SPI_STATE_BUSY_TX_RX)
+  {
+    HAL_DMA_Abort(&SpiDmaRxHandle);
+    HAL_DMA_Abort(&SpiDmaTxHandle);
+    SpiHandle.Instance->CR2 &= ~(SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN);
+
+    /* Deselect both devices on the BUS, see IMU_IO_Init */
+    GYRO_CS_HIGH();
+    IMU_CS_HIGH();
+
+    /* Drop what the aborted transfer left in the RX FIFO */
+    while(__HAL_SPI_GET_FLAG(&SpiHandle, SPI_FLAG_RXNE) != RESET)
+    {
+      (void) *(__IO uint8_t *)&SpiHandle.Instance->DR;
+    }
+
+    SpiHandle.State = HAL_SPI_STATE_READY;
+    __HAL_UNLOCK(&SpiHandle);
+  }
 }
 
 /******************************************************************************
@@ -758,6 +1113,11 @@ void GYRO_IO_Write(uint8_t* pBuffer, uint8_t WriteAddr, uint16_t NumByteToWrite)
   {
     WriteAddr |= (uint8_t)MULTIPLEBYTE_CMD;
   }
+
+  /* Keep DRDY triggered DMA reads off the bus during the polled transfer */
+  GyroIOPolledTransferActive = 1;
+  SPIx_WaitForDMATransfer();
+
   /* Set chip select Low at the start of the transmission */
   GYRO_CS_LOW();
 
@@ -774,6 +1134,8 @@ void GYRO_IO_Write(uint8_t* pBuffer, uint8_t WriteAddr, uint16_t NumByteToWrite)
 
   /* Set chip select High at the end of the transmission */
   GYRO_CS_HIGH();
+
+  GyroIOPolledTransferActive = 0;
 }
 
 /**
@@ -797,6 +1159,10 @@ HAL_StatusTypeDef GYRO_IO_Read(uint8_t* pBuffer, uint8_t ReadAddr, uint16_t NumB
     ReadAddr |= (uint8_t)READWRITE_CMD;
   }
 
+  /* Keep DRDY triggered DMA reads off the bus during the polled transfer */
+  GyroIOPolledTransferActive = 1;
+  SPIx_WaitForDMATransfer();
+
   /* Set chip select Low at the start of the transmission */
   GYRO_CS_LOW();
 
@@ -815,8 +1181,278 @@ HAL_StatusTypeDef GYRO_IO_Read(uint8_t* pBuffer, uint8_t ReadAddr, uint16_t NumB
   /* Set chip select High at the end of the transmission */
   GYRO_CS_HIGH();
 
+  GyroIOPolledTransferActive = 0;
+
+  return status;
+}
+
+/**
+  * @brief  Starts a non-blocking burst read of the GYROSCOPE registers using DMA.
+  *         The whole transaction (address byte + data bytes) is clocked out in one
+  *         SPI DMA transfer. Chip select is kept low until GYRO_IO_Read_DMA_Complete()
+  *         is called from the transfer complete callback. May be called from ISR.
+  * @param  pTxBuffer : buffer of NumByteToRead+1 bytes used for the address and dummy bytes
+  * @param  pRxBuffer : buffer of NumByteToRead+1 bytes, read data starts at index 1
+  * @param  ReadAddr : GYROSCOPE's internal address to read from.
+  * @param  NumByteToRead : number of bytes to read from the GYROSCOPE.
+  * @retval HAL_OK if transfer started, HAL_BUSY if the bus is in use
+  */
+HAL_StatusTypeDef GYRO_IO_Read_DMA(uint8_t* pTxBuffer, uint8_t* pRxBuffer, uint8_t ReadAddr, uint16_t NumByteToRead)
+{
+  HAL_StatusTypeDef status = HAL_OK;
+  uint16_t i;
+
+  if(GyroIOPolledTransferActive || HAL_SPI_GetState(&SpiHandle) != HAL_SPI_STATE_READY)
+  {
+    return HAL_BUSY;
+  }
+
+  if(NumByteToRead > 0x01)
+  {
+    ReadAddr |= (uint8_t)(READWRITE_CMD | MULTIPLEBYTE_CMD);
+  }
+  else
+  {
+    ReadAddr |= (uint8_t)READWRITE_CMD;
+  }
+
+  pTxBuffer[0] = ReadAddr;
+  for(i = 1; i <= NumByteToRead; i++)
+  {
+    pTxBuffer[i] = DUMMY_BYTE;
+  }
+
+  /* Set chip select Low at the start of the transmission */
+  GYRO_CS_LOW();
+
+  if((status = HAL_SPI_TransmitReceive_DMA(&SpiHandle, pTxBuffer, pRxBuffer, NumByteToRead + 1)) != HAL_OK)
+  {
+    GYRO_CS_HIGH();
+  }
+
+  return status;
+}
+
+/**
+  * @brief  Ends a DMA burst read started by GYRO_IO_Read_DMA(). Called from the
+  *         SPI transfer complete (or error) callback.
+  * @param  None
+  * @retval None
+  */
+void GYRO_IO_Read_DMA_Complete(void)
+{
+  /* Set chip select High at the end of the transmission */
+  GYRO_CS_HIGH();
+}
+
+/**
+  * @brief  Re-initialises the GYROSCOPE SPI BUS, ends any DMA burst read in
+  *         progress without a callback. Used when the gyroscope stopped answering.
+  * @param  None
+  * @retval None
+  */
+void GYRO_IO_ResetBus(void)
+{
+  HAL_DMA_Abort(&SpiDmaRxHandle);
+  HAL_DMA_Abort(&SpiDmaTxHandle);
+
+  /* Deselect both devices on the BUS, see IMU_IO_Init */
+  GYRO_CS_HIGH();
+  IMU_CS_HIGH();
+
+  /* De-initialize the SPI comunication BUS and initialize it again */
+  SPIx_Error();
+}
+
+/**
+  * @brief  Checks if a SPI handle is the one used for the GYROSCOPE
+  * @param  hspi : SPI handle
+  * @retval 1 if hspi is the GYROSCOPE SPI handle, else 0
+  */
+uint8_t GYRO_IO_IsSPIHandle(SPI_HandleTypeDef *hspi)
+{
+  return (hspi == &SpiHandle);
+}
+
+/**
+  * @brief  Handles the GYROSCOPE SPI DMA reception interrupt request
+  * @param  None
+  * @retval None
+  */
+void GYRO_IO_DMA_RX_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(SpiHandle.hdmarx);
+}
+
+/**
+  * @brief  Handles the GYROSCOPE SPI DMA transmission interrupt request
+  * @param  None
+  * @retval None
+  */
+void GYRO_IO_DMA_TX_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(SpiHandle.hdmatx);
+}
+
+/********************************* LINK EXTERNAL IMU **************************/
+/**
+  * @brief  Configures the external IMU SPI interface. The IMU shares the SPI bus
+  *         and its DMA with the GYROSCOPE, whose chip select is driven high too.
+  * @param  None
+  * @retval None
+  */
+void IMU_IO_Init(void)
+{
+  GPIO_InitTypeDef GPIO_InitStructure;
+
+  /* Bus and GYROSCOPE chip select */
+  GYRO_IO_Init();
+
+  /* Enable CS GPIO clock and  Configure GPIO PIN for IMU Chip select */
+  IMU_CS_GPIO_CLK_ENABLE();
+  GPIO_InitStructure.Pin = IMU_CS_PIN;
+  GPIO_InitStructure.Mode = GPIO_MODE_OUTPUT_PP;
+  GPIO_InitStructure.Pull  = GPIO_NOPULL;
+  GPIO_InitStructure.Speed = GPIO_SPEED_HIGH;
+  HAL_GPIO_Init(IMU_CS_GPIO_PORT, &GPIO_InitStructure);
+
+  /* Deselect : Chip Select high */
+  IMU_CS_HIGH();
+
+  /* Enable INT GPIO clock and Configure GPIO PIN to detect Interrupts */
+  IMU_INT_GPIO_CLK_ENABLE();
+  GPIO_InitStructure.Pin = IMU_INT_PIN;
+  GPIO_InitStructure.Mode = GPIO_MODE_INPUT;
+  GPIO_InitStructure.Speed = GPIO_SPEED_HIGH;
+  GPIO_InitStructure.Pull= GPIO_PULLDOWN; /* keeps the line low if nothing is connected */
+  HAL_GPIO_Init(IMU_INT_GPIO_PORT, &GPIO_InitStructure);
+}
+
+/**
+  * @brief  Writes to the external IMU. Unlike the GYROSCOPE the IMU increments
+  *         the register address of a multiple byte transfer by itself.
+  * @param  pBuffer : pointer to the buffer  containing the data to be written to the IMU.
+  * @param  WriteAddr : IMU's internal address to write to.
+  * @param  NumByteToWrite: Number of bytes to write.
+  * @retval None
+  */
+void IMU_IO_Write(uint8_t* pBuffer, uint8_t WriteAddr, uint16_t NumByteToWrite)
+{
+  uint8_t readByte = 0;
+
+  /* Keep DRDY triggered DMA reads off the bus during the polled transfer */
+  GyroIOPolledTransferActive = 1;
+  SPIx_WaitForDMATransfer();
+
+  /* Set chip select Low at the start of the transmission */
+  IMU_CS_LOW();
+
+  /* Send the Address of the indexed register */
+  SPIx_WriteRead(WriteAddr, &readByte);
+
+  /* Send the data that will be written into the device (MSB First) */
+  while(NumByteToWrite >= 0x01)
+  {
+    SPIx_WriteRead(*pBuffer, &readByte);
+    NumByteToWrite--;
+    pBuffer++;
+  }
+
+  /* Set chip select High at the end of the transmission */
+  IMU_CS_HIGH();
+
+  GyroIOPolledTransferActive = 0;
+}
+
+/**
+  * @brief  Reads a block of data from the external IMU.
+  * @param  pBuffer : pointer to the buffer that receives the data read from the IMU.
+  * @param  ReadAddr : IMU's internal address to read from.
+  * @param  NumByteToRead : number of bytes to read from the IMU.
+  * @retval HAL_OK if read successful
+  */
+HAL_StatusTypeDef IMU_IO_Read(uint8_t* pBuffer, uint8_t ReadAddr, uint16_t NumByteToRead)
+{
+  HAL_StatusTypeDef status = HAL_OK;
+  uint8_t readByte = 0;
+
+  ReadAddr |= (uint8_t)READWRITE_CMD;
+
+  /* Keep DRDY triggered DMA reads off the bus during the polled transfer */
+  GyroIOPolledTransferActive = 1;
+  SPIx_WaitForDMATransfer();
+
+  /* Set chip select Low at the start of the transmission */
+  IMU_CS_LOW();
+
+  /* Send the Address of the indexed register */
+  status = SPIx_WriteRead(ReadAddr, &readByte);
+
+  /* Receive the data that will be read from the device (MSB First) */
+  while(NumByteToRead > 0x00 && status == HAL_OK)
+  {
+    /* Send dummy byte (0x00) to generate the SPI clock to the IMU (Slave device) */
+    status = SPIx_WriteRead(DUMMY_BYTE, pBuffer);
+    NumByteToRead--;
+    pBuffer++;
+  }
+
+  /* Set chip select High at the end of the transmission */
+  IMU_CS_HIGH();
+
+  GyroIOPolledTransferActive = 0;
+
   return status;
 }
+
+/**
+  * @brief  Starts a non-blocking burst read of the external IMU registers using
+  *         DMA, see GYRO_IO_Read_DMA(). Chip select is kept low until
+  *         IMU_IO_Read_DMA_Complete() is called. May be called from ISR.
+  * @param  pTxBuffer : buffer of NumByteToRead+1 bytes used for the address and dummy bytes
+  * @param  pRxBuffer : buffer of NumByteToRead+1 bytes, read data starts at index 1
+  * @param  ReadAddr : IMU's internal address to read from.
+  * @param  NumByteToRead : number of bytes to read from the IMU.
+  * @retval HAL_OK if transfer started, HAL_BUSY if the bus is in use
+  */
+HAL_StatusTypeDef IMU_IO_Read_DMA(uint8_t* pTxBuffer, uint8_t* pRxBuffer, uint8_t ReadAddr, uint16_t NumByteToRead)
+{
+  HAL_StatusTypeDef status = HAL_OK;
+  uint16_t i;
+
+  if(GyroIOPolledTransferActive || HAL_SPI_GetState(&SpiHandle) != HAL_SPI_STATE_READY)
+  {
+    return HAL_BUSY;
+  }
+
+  pTxBuffer[0] = ReadAddr | (uint8_t)READWRITE_CMD;
+  for(i = 1; i <= NumByteToRead; i++)
+  {
+    pTxBuffer[i] = DUMMY_BYTE;
+  }
+
+  /* Set chip select Low at the start of the transmission */
+  IMU_CS_LOW();
+
+  if((status = HAL_SPI_TransmitReceive_DMA(&SpiHandle, pTxBuffer, pRxBuffer, NumByteToRead + 1)) != HAL_OK)
+  {
+    IMU_CS_HIGH();
+  }
+
+  return status;
+}
+
+/**
+  * @brief  Ends a DMA burst read started by IMU_IO_Read_DMA(). Called from the
+  *         SPI transfer complete (or error) callback.
+  * @param  None
+  * @retval None
+  */
+void IMU_IO_Read_DMA_Complete(void)
+{
+  /* Set chip select High at the end of the transmission */
+  IMU_CS_HIGH();
+}
 #endif /* HAL_SPI_MODULE_ENABLED */
 
 #ifdef HAL_I2C_MODULE_ENABLED
@@ -227,6 +227,20 @@ typedef enum
    conditions (interrupts routines ...). */
 #define SPIx_TIMEOUT_MAX                      ((uint32_t)0x1000)
 
+/* Definition for SPIx DMA, used for burst reads of the gyroscope output registers
+   (SPI1_RX is mapped on DMA1 channel 2 and SPI1_TX on DMA1 channel 3) */
+#define DISCOVERY_SPIx_DMA_CLK_ENABLE()       __DMA1_CLK_ENABLE()
+#define DISCOVERY_SPIx_RX_DMA_CHANNEL         DMA1_Channel2
+#define DISCOVERY_SPIx_TX_DMA_CHANNEL         DMA1_Channel3
+#define DISCOVERY_SPIx_DMA_RX_IRQn            DMA1_Channel2_IRQn
+#define DISCOVERY_SPIx_DMA_TX_IRQn            DMA1_Channel3_IRQn
+#define DISCOVERY_SPIx_DMA_RX_IRQHandler      DMA1_Channel2_IRQHandler
+#define DISCOVERY_SPIx_DMA_TX_IRQHandler      DMA1_Channel3_IRQHandler
+/* Must not be higher (numerically lower) than configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY
+   since the transfer complete callback signals the RTOS */
+#define DISCOVERY_SPIx_DMA_IRQ_PREEMPT_PRIO   5
+#define DISCOVERY_SPIx_DMA_IRQ_SUB_PRIO       0
+
 /*##################### I2Cx ###################################*/
 /**
   * @brief  Definition for I2C Interface pins (I2C1 used)
@@ -252,6 +266,17 @@ typedef enum
    conditions (interrupts routines ...). */
 #define I2Cx_TIMEOUT_MAX                      0x10000
 
+/* Definition for I2Cx interrupts, used for non-blocking reads of the acc/mag output registers.
+   DMA is not used since I2C1 TX/RX map on DMA1 channel 6/7 which are taken by USART2 */
+#define DISCOVERY_I2Cx_EV_IRQn                I2C1_EV_IRQn
+#define DISCOVERY_I2Cx_ER_IRQn                I2C1_ER_IRQn
+#define DISCOVERY_I2Cx_EV_IRQHandler          I2C1_EV_IRQHandler
+#define DISCOVERY_I2Cx_ER_IRQHandler          I2C1_ER_IRQHandler
+/* Must not be higher (numerically lower) than configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY
+   since the transfer complete callback signals the RTOS */
+#define DISCOVERY_I2Cx_IRQ_PREEMPT_PRIO       5
+#define DISCOVERY_I2Cx_IRQ_SUB_PRIO           0
+
 /*##################### I2Cbar ###################################*/
 /**
   * @brief  Definition for I2Cbar Interface pins
@@ -277,6 +302,21 @@ typedef enum
    conditions (interrupts routines ...). */
 #define I2Cbar_TIMEOUT_MAX                      0x10000
 
+/* Bus recovery of I2Cx and I2Cbar, SCL is clocked until a slave holding SDA low releases it.
+   Nine clocks finish any byte and its acknowledge, the half period is for 100 kHz. */
+#define I2C_RECOVERY_CLOCKS                     9
+#define I2C_RECOVERY_HALF_PERIOD_US             5
+
+/* Definition for I2Cbar interrupts, used for the non-blocking conversion starts and reads of the barometer */
+#define DISCOVERY_I2Cbar_EV_IRQn              I2C2_EV_IRQn
+#define DISCOVERY_I2Cbar_ER_IRQn              I2C2_ER_IRQn
+#define DISCOVERY_I2Cbar_EV_IRQHandler        I2C2_EV_IRQHandler
+#define DISCOVERY_I2Cbar_ER_IRQHandler        I2C2_ER_IRQHandler
+/* Must not be higher (numerically lower) than configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY
+   since the transfer complete callbacks signal the RTOS */
+#define DISCOVERY_I2Cbar_IRQ_PREEMPT_PRIO     6
+#define DISCOVERY_I2Cbar_IRQ_SUB_PRIO         0
+
 /** @addtogroup STM32F072B_DISCOVERY_LOW_LEVEL_COMPONENT
   * @{
   */
@@ -308,6 +348,26 @@ typedef enum
 #define GYRO_INT2_PIN              		GPIO_PIN_1                  /* PE.01 */
 #define GYRO_INT2_EXTI_IRQn        		EXTI1_IRQn
 
+/*##################### EXTERNAL IMU ##########################*/
+/* Chip Select macro definition */
+#define IMU_CS_LOW()        HAL_GPIO_WritePin(IMU_CS_GPIO_PORT, IMU_CS_PIN, GPIO_PIN_RESET)
+#define IMU_CS_HIGH()       HAL_GPIO_WritePin(IMU_CS_GPIO_PORT, IMU_CS_PIN, GPIO_PIN_SET)
+
+/**
+  * @brief  External SPI IMU pins. The IMU is wired to the SPI1 pins of the
+  *         P1/P2 headers (PA.05-07) and shares the bus with the GYROSCOPE.
+  */
+#define IMU_CS_GPIO_PORT                GPIOB                       /* GPIOB */
+#define IMU_CS_GPIO_CLK_ENABLE()        __GPIOB_CLK_ENABLE()
+#define IMU_CS_GPIO_CLK_DISABLE()       __GPIOB_CLK_DISABLE()
+#define IMU_CS_PIN                      GPIO_PIN_12                 /* PB.12 */
+
+#define IMU_INT_GPIO_PORT               GPIOB                       /* GPIOB */
+#define IMU_INT_GPIO_CLK_ENABLE()       __GPIOB_CLK_ENABLE()
+#define IMU_INT_GPIO_CLK_DISABLE()      __GPIOB_CLK_DISABLE()
+#define IMU_INT_PIN                     GPIO_PIN_11                 /* PB.11 */
+#define IMU_INT_EXTI_IRQn               EXTI15_10_IRQn
+
 /*##################### ACCELEROMETER ##########################*/
 /**
   * @brief  ACCELEROMETER I2C1 Interface pins
@@ -364,11 +424,33 @@ uint32_t  BSP_PB_GetState(Button_TypeDef Button);
 void      I2Cx_WriteData(uint16_t Addr, uint8_t Reg, uint8_t Value);
 uint8_t   I2Cx_ReadData(uint16_t Addr, uint8_t Reg);
 HAL_StatusTypeDef I2Cx_ReadDataLen(uint16_t Addr, uint8_t Reg, uint8_t * pData, uint16_t Len);
+HAL_StatusTypeDef I2Cx_ReadDataLen_IT(uint16_t Addr, uint8_t Reg, uint8_t * pData, uint16_t Len);
+void      I2Cx_ResetBus(void);
+uint8_t   I2Cx_IsI2CHandle(I2C_HandleTypeDef *hi2c);
+void      I2Cx_EV_IRQHandler(void);
+void      I2Cx_ER_IRQHandler(void);
 
 void      I2Cbar_Init(void);
 void      I2Cbar_WriteData(uint16_t Addr, uint8_t Reg, uint8_t Value);
 uint8_t   I2Cbar_ReadData(uint16_t Addr, uint8_t Reg);
 HAL_StatusTypeDef I2Cbar_ReadDataLen(uint16_t Addr, uint8_t Reg, uint8_t * pData, uint16_t Len);
+HAL_StatusTypeDef I2Cbar_WriteData_IT(uint16_t Addr, uint8_t Reg, uint8_t * pValue);
+HAL_StatusTypeDef I2Cbar_ReadDataLen_IT(uint16_t Addr, uint8_t Reg, uint8_t * pData, uint16_t Len);
+void      I2Cbar_ResetBus(void);
+uint8_t   I2Cbar_IsI2CHandle(I2C_HandleTypeDef *hi2c);
+uint32_t  I2Cbar_GetError(void);
+void      I2Cbar_EV_IRQHandler(void);
+void      I2Cbar_ER_IRQHandler(void);
+
+HAL_StatusTypeDef GYRO_IO_Read_DMA(uint8_t* pTxBuffer, uint8_t* pRxBuffer, uint8_t ReadAddr, uint16_t NumByteToRead);
+void      GYRO_IO_Read_DMA_Complete(void);
+void      GYRO_IO_ResetBus(void);
+uint8_t   GYRO_IO_IsSPIHandle(SPI_HandleTypeDef *hspi);
+void      GYRO_IO_DMA_RX_IRQHandler(void);
+void      GYRO_IO_DMA_TX_IRQHandler(void);
+
+HAL_StatusTypeDef IMU_IO_Read_DMA(uint8_t* pTxBuffer, uint8_t* pRxBuffer, uint8_t ReadAddr, uint16_t NumByteToRead);
+void      IMU_IO_Read_DMA_Complete(void);
 
 /**
   * @}
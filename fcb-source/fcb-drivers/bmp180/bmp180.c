@@ -25,6 +25,9 @@
 /* pressure measurement*/
 #define BMP180_P_MEASURE			(0x34)
 
+/* maximum conversion times of the data sheet [us] */
+#define BMP180_T_CONVERSION_TIME	4500
+
 /* Private typedef -----------------------------------------------------------*/
 
 typedef struct {
@@ -41,62 +44,143 @@ typedef struct {
 	int16_t MD;
 } BMP180CalibVals_t;
 
+/* Terms of the pressure compensation that only depend on the temperature */
+typedef struct {
+	int32_t B5;
+	int32_t B3Base;		// B3 before the over sampling scaling
+	uint32_t B4;
+} BMP180TempTerms_t;
+
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 
 static BMP180CalibVals_t calibVals;
-static uint8_t oss = 0;	// Over sampling ratio;
-static uint32_t rawTempValue;
+static bool isCalibValid = false;
+static BMP180TempTerms_t tempTerms;
+
+/* Pressure conversion time per over sampling setting [us] */
+static const uint32_t pressureConversionTimes[BMP180_OSS_MAX + 1] = { 4500, 7500, 13500, 25500 };
+
+/* Written and read by the non-blocking transfers, must outlive them */
+static uint8_t ctrlMeasValue;
+static uint8_t adcOutBuffer[3];
 
 /* Private function prototypes -----------------------------------------------*/
 
-static void ReadCalibVals(BMP180CalibVals_t *calibVals);
-static int32_t CalculateRealPreassure(int32_t rawTemp, int32_t rawPressure);
+static bool ReadCalibVals(BMP180CalibVals_t *calibVals);
+static void CalculateTempTerms(int32_t rawTemp, BMP180TempTerms_t *terms);
+static int32_t CalculateRealPreassure(int32_t rawPressure, uint8_t oss);
 
 /* Exported functions --------------------------------------------------------*/
 
 void BMP180_init(void) {
 	I2Cbar_Init();
 
-    ReadCalibVals(&calibVals);
+    isCalibValid = ReadCalibVals(&calibVals);
+}
+
+/*
+ * Starts a pressure conversion, non-blocking. The conversion starts once the
+ * write completes, see HAL_I2C_MemTxCpltCallback, and takes
+ * BMP180_GetPressureConversionTime(oss).
+ */
+HAL_StatusTypeDef BMP180_StartPressureMeasure_IT(uint8_t oss) {
+	ctrlMeasValue = BMP180_P_MEASURE | (oss << 6);
+	return I2Cbar_WriteData_IT(BAROMETER_I2C_ADDRESS, BMP180_CTRL_MEAS_REG, &ctrlMeasValue);
+}
+
+/*
+ * Starts a temperature conversion, non-blocking. The conversion starts once
+ * the write completes and takes BMP180_GetTemperatureConversionTime().
+ */
+HAL_StatusTypeDef BMP180_StartTemperatureMeasure_IT(void) {
+	ctrlMeasValue = BMP180_T_MEASURE;
+	return I2Cbar_WriteData_IT(BAROMETER_I2C_ADDRESS, BMP180_CTRL_MEAS_REG, &ctrlMeasValue);
 }
 
-void BMP180_StartPressureMeasure(void) {
-	I2Cbar_WriteData(BAROMETER_I2C_ADDRESS, BMP180_CTRL_MEAS_REG, BMP180_P_MEASURE | (oss << 6));
+/*
+ * Starts the read of a finished pressure conversion, non-blocking. Once the
+ * read completes, see HAL_I2C_MemRxCpltCallback, convert with
+ * BMP180_ConvertPressureValue.
+ */
+HAL_StatusTypeDef BMP180_StartReadPressure_IT(void) {
+	return I2Cbar_ReadDataLen_IT(BAROMETER_I2C_ADDRESS, BMP180_ADC_OUT_REG, adcOutBuffer, 3);
 }
 
-void BMP180_StartTemperatureMeasure(void) {
-	I2Cbar_WriteData(BAROMETER_I2C_ADDRESS, BMP180_CTRL_MEAS_REG, BMP180_T_MEASURE);
+/*
+ * Starts the read of a finished temperature conversion, non-blocking. Once the
+ * read completes, update the compensation with BMP180_UpdateInternalTempValue.
+ */
+HAL_StatusTypeDef BMP180_StartReadTemperature_IT(void) {
+	return I2Cbar_ReadDataLen_IT(BAROMETER_I2C_ADDRESS, BMP180_ADC_OUT_REG, adcOutBuffer, 2);
 }
 
-HAL_StatusTypeDef BMP180_ReadPressureValue(int32_t * pData) {
-    HAL_StatusTypeDef status = 0;
-    uint8_t dataRead[3];
-    uint32_t rawValue;
+/*
+ * Compensates the pressure of a completed read with the last temperature, oss
+ * must be the one the conversion was started with. Returns the pressure [Pa].
+ */
+int32_t BMP180_ConvertPressureValue(uint8_t oss) {
+	uint32_t rawValue = adcOutBuffer[0]<<(8+oss) | adcOutBuffer[1]<<(oss) | adcOutBuffer[2]>>(8-oss);
 
-    status = I2Cbar_ReadDataLen(BAROMETER_I2C_ADDRESS, BMP180_ADC_OUT_REG, dataRead, 3);
-    rawValue = dataRead[0]<<(8+oss) | dataRead[1]<<(oss) | dataRead[2]>>(8-oss);
+	return CalculateRealPreassure(rawValue, oss);
+}
 
-    *pData = CalculateRealPreassure(rawTempValue, rawValue);
+/*
+ * Takes the temperature of a completed read as the one the pressures are
+ * compensated with. The temperature terms of the compensation are evaluated
+ * here once, instead of for every pressure.
+ */
+void BMP180_UpdateInternalTempValue(void) {
+	CalculateTempTerms(adcOutBuffer[0]<<8 | adcOutBuffer[1], &tempTerms);
+}
 
-    return status;
+/*
+ * Returns the last temperature read [0.1 deg C]
+ */
+int32_t BMP180_GetTemperature(void) {
+	return (tempTerms.B5 + 8) / 16;
 }
 
-HAL_StatusTypeDef BMP180_UpdateInternalTempValue() {
-    HAL_StatusTypeDef status = 0;
-    uint8_t dataRead[2];
+uint32_t BMP180_GetTemperatureConversionTime(void) {
+	return BMP180_T_CONVERSION_TIME;
+}
 
-    status = I2Cbar_ReadDataLen(BAROMETER_I2C_ADDRESS, BMP180_ADC_OUT_REG, dataRead, 2);
-    rawTempValue = dataRead[0]<<8 | dataRead[1];
+uint32_t BMP180_GetPressureConversionTime(uint8_t oss) {
+	return pressureConversionTimes[oss > BMP180_OSS_MAX ? BMP180_OSS_MAX : oss];
+}
 
-    return status;
+/*
+ * Returns true if the calibration coefficients were read at BMP180_init and
+ * passed the check of the data sheet
+ */
+bool BMP180_IsCalibValid(void) {
+	return isCalibValid;
 }
 
 /* Private functions ---------------------------------------------------------*/
 
-static void ReadCalibVals(BMP180CalibVals_t *calibVals) {
-	uint8_t tmpData[22];
-	I2Cbar_ReadDataLen(BAROMETER_I2C_ADDRESS, BMP180_CALIB_PARAM_START_REG, tmpData, BMP180_CALIB_PARAM_DATA_LEN);
+/*
+ * Reads the calibration coefficients from the E2PROM. Returns false if the read
+ * failed or a coefficient is 0x0000 or 0xFFFF, which the data sheet gives as
+ * the check of the communication with the sensor.
+ */
+static bool ReadCalibVals(BMP180CalibVals_t *calibVals) {
+	uint8_t tmpData[BMP180_CALIB_PARAM_DATA_LEN] = { 0 };
+	uint16_t word;
+	bool isValid = true;
+	uint8_t i;
+
+	if (HAL_OK != I2Cbar_ReadDataLen(BAROMETER_I2C_ADDRESS, BMP180_CALIB_PARAM_START_REG, tmpData,
+			BMP180_CALIB_PARAM_DATA_LEN)) {
+		isValid = false;
+	}
+
+	for (i = 0; i < BMP180_CALIB_PARAM_DATA_LEN; i += 2) {
+		word = (uint16_t) (tmpData[i] << 8 | tmpData[i + 1]);
+		if (0x0000 == word || 0xFFFF == word) {
+			isValid = false;
+		}
+	}
 
 	calibVals->AC1 = tmpData[0] << 8 | tmpData[1];
 	calibVals->AC2 = tmpData[2] << 8 | tmpData[3];
@@ -109,25 +193,35 @@ static void ReadCalibVals(BMP180CalibVals_t *calibVals) {
 	calibVals->MB = tmpData[16] << 8 | tmpData[17];
 	calibVals->MC = tmpData[18] << 8 | tmpData[19];
 	calibVals->MD = tmpData[20] << 8 | tmpData[21];
+
+	return isValid;
 }
 
-static int32_t CalculateRealPreassure(int32_t rawTemp, int32_t rawPressure) {
-	int32_t X1, X2, X3, B3, B6, p;
-	uint32_t B4, B7;
+static void CalculateTempTerms(int32_t rawTemp, BMP180TempTerms_t *terms) {
+	int32_t X1, X2, X3, B6;
 
 	X1 = (rawTemp - calibVals.AC6) * calibVals.AC5 / 32768;
 	X2 = calibVals.MC * 2048 / (X1 + calibVals.MD);
-	B6 = X1 + X2 - 4000;
+	terms->B5 = X1 + X2;
+	B6 = terms->B5 - 4000;
 
 	X1 = (calibVals.B2 * (B6 * B6 / 4096)) / 2048;
 	X2 = calibVals.AC2 * B6 / 2048;
 	X3 = X1 + X2;
-	B3 = (((calibVals.AC1 * 4 + X3) << oss) + 2) / 4;
+	terms->B3Base = calibVals.AC1 * 4 + X3;
 
 	X1 = calibVals.AC3 * B6 / 8192;
 	X2 = (calibVals.B1 * ( B6 * B6 / 4096)) / 65536;
 	X3 = ((X1 + X2) + 2) / 4;
-	B4 = calibVals.AC4 * (uint32_t)(X3 + 32768) / 32768;
+	terms->B4 = calibVals.AC4 * (uint32_t)(X3 + 32768) / 32768;
+}
+
+static int32_t CalculateRealPreassure(int32_t rawPressure, uint8_t oss) {
+	int32_t X1, X2, B3, p;
+	uint32_t B4, B7;
+
+	B3 = ((tempTerms.B3Base << oss) + 2) / 4;
+	B4 = tempTerms.B4;
 	B7 = ((uint32_t)rawPressure - B3) * (50000 >> oss);
 	if (B7 < 0x80000000) {
 		p = (B7 * 2) / B4;
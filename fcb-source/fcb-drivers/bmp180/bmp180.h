@@ -9,13 +9,23 @@
 #define BMP180_BMP180_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "stm32f3_discovery.h"
 
+/* Highest pressure over sampling setting, the sensor averages 2^oss samples */
+#define BMP180_OSS_MAX		3
+
 void BMP180_init(void);
 
-void BMP180_StartPressureMeasure(void);
-void BMP180_StartTemperatureMeasure(void);
-HAL_StatusTypeDef BMP180_ReadPressureValue(int32_t * pData);
-HAL_StatusTypeDef BMP180_UpdateInternalTempValue();
+HAL_StatusTypeDef BMP180_StartPressureMeasure_IT(uint8_t oss);
+HAL_StatusTypeDef BMP180_StartTemperatureMeasure_IT(void);
+HAL_StatusTypeDef BMP180_StartReadPressure_IT(void);
+HAL_StatusTypeDef BMP180_StartReadTemperature_IT(void);
+int32_t BMP180_ConvertPressureValue(uint8_t oss);
+void BMP180_UpdateInternalTempValue(void);
+int32_t BMP180_GetTemperature(void);
+uint32_t BMP180_GetTemperatureConversionTime(void);
+uint32_t BMP180_GetPressureConversionTime(uint8_t oss);
+bool BMP180_IsCalibValid(void);
 
 #endif /* BMP180_BMP180_H_ */
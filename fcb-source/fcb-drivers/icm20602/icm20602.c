@@ -0,0 +1,322 @@
+/*
+ * icm20602.c
+ *
+ * Gyroscope driver of the ICM-20602, see icm20602.h. The output registers and
+ * the FIFO are big endian. The part runs from its PLL with the gyroscope low-
+ * pass filter at 176 Hz and the internal rate at 1 kHz, divided down by
+ * ICM20602_SAMPLE_RATE_DIVIDER.
+ */
+
+#include "icm20602.h"
+#include <math.h>
+
+/* Private define ------------------------------------------------------------*/
+
+/* Start-up time after a device reset [ms] */
+#define ICM20602_RESET_TIME			100
+
+/* Private variables ---------------------------------------------------------*/
+
+GYRO_DrvTypeDef Icm20602Drv =
+{
+	0,
+	ICM20602_ReadID,
+	ICM20602_Reset,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	0,
+	ICM20602_ReadXYZAngRate,
+	ICM20602_Config,
+	ICM20602_ConfigFIFO,
+	ICM20602_StartReadXYZAngRateDMA,
+	ICM20602_FinishReadXYZAngRateDMA,
+	IMU_IO_Read_DMA_Complete,
+	ICM20602_ConvertXYZAngRate,
+	ICM20602_ReadFIFO,
+	ICM20602_ReadTemperature,
+	ICM20602_DataRateHz,
+	0,
+	0,
+	0
+};
+
+/* Buffers for DMA burst reads of the output registers (address/status byte + 6 data bytes) */
+static uint8_t dmaTxBuffer[ICM20602_XYZ_DMA_BUFFER_SIZE];
+static uint8_t dmaRxBuffer[ICM20602_XYZ_DMA_BUFFER_SIZE];
+
+/* Buffer for burst reads of the FIFO */
+static uint8_t fifoBuffer[ICM20602_FIFO_MAX_SAMPLES * ICM20602_FIFO_SAMPLE_SIZE];
+
+/* Private function prototypes -----------------------------------------------*/
+
+static void WriteRegister(uint8_t addr, uint8_t value);
+static int16_t ToInt16(const uint8_t* pBuffer);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+ * @brief  Configures the ICM-20602 for flight control usage, with the data ready
+ *         pulse on INT. Enables the SPI as well. The part is only reset if it
+ *         answers, so probing for a missing one is quick.
+ * @param  None
+ * @retval zero upon success, nonzero if no ICM-20602 answers
+ */
+uint8_t ICM20602_Config(void)
+{
+	uint8_t tmp = 0;
+
+	IMU_IO_Init();
+
+	if (ICM20602_ReadID() != I_AM_ICM20602) {
+		return 1; // error
+	}
+
+	ICM20602_Reset();
+
+	/* SPI only, PLL clock, accelerometer in standby */
+	WriteRegister(ICM20602_I2C_IF_ADDR, ICM20602_I2C_IF_DIS);
+	WriteRegister(ICM20602_PWR_MGMT_1_ADDR, ICM20602_PWR_MGMT_1_CLK_PLL);
+	WriteRegister(ICM20602_PWR_MGMT_2_ADDR, ICM20602_PWR_MGMT_2_ACC_STBY);
+
+	WriteRegister(ICM20602_SMPLRT_DIV_ADDR, ICM20602_SAMPLE_RATE_DIVIDER);
+	WriteRegister(ICM20602_CONFIG_ADDR, ICM20602_CONFIG_DLPF_176HZ);
+	WriteRegister(ICM20602_GYRO_CONFIG_ADDR, ICM20602_FULLSCALE_1000);
+
+	WriteRegister(ICM20602_INT_PIN_CFG_ADDR, ICM20602_INT_PIN_RD_CLEAR);
+	WriteRegister(ICM20602_INT_ENABLE_ADDR, ICM20602_INT_DATA_RDY_EN);
+
+	/* A failed write would leave the part at +-250 dps */
+	IMU_IO_Read(&tmp, ICM20602_GYRO_CONFIG_ADDR, 1);
+	if (tmp != ICM20602_FULLSCALE_1000) {
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief  Reads the WHO_AM_I register
+ * @param  None
+ * @retval ID, I_AM_ICM20602 if the part answers
+ */
+uint8_t ICM20602_ReadID(void)
+{
+	uint8_t tmp = 0;
+
+	IMU_IO_Read(&tmp, ICM20602_WHO_AM_I_ADDR, 1);
+
+	return tmp;
+}
+
+/**
+ * @brief  Resets the registers and the signal paths, blocks for the start-up time
+ * @param  None
+ * @retval None
+ */
+void ICM20602_Reset(void)
+{
+	WriteRegister(ICM20602_PWR_MGMT_1_ADDR, ICM20602_PWR_MGMT_1_RESET);
+	HAL_Delay(ICM20602_RESET_TIME);
+
+	WriteRegister(ICM20602_SIGNAL_PATH_RESET_ADDR, ICM20602_SIGNAL_PATH_RESET_ALL);
+}
+
+/**
+ * @brief  Reads the angular rates with one polled burst read
+ * @param  pfData : Data out pointer [rad/s]
+ * @retval HAL_OK if read successful
+ */
+HAL_StatusTypeDef ICM20602_ReadXYZAngRate(float* pfData)
+{
+	HAL_StatusTypeDef status = HAL_OK;
+	uint8_t tmpbuffer[6] = { 0 };
+	int16_t rawData[3];
+	int i;
+
+	status = IMU_IO_Read(tmpbuffer, ICM20602_GYRO_XOUT_H_ADDR, 6);
+	if (status != HAL_OK) {
+		return status;
+	}
+
+	for (i = 0; i < 3; i++) {
+		rawData[i] = ToInt16(&tmpbuffer[2 * i]);
+	}
+
+	ICM20602_ConvertXYZAngRate(rawData, pfData);
+
+	return status;
+}
+
+/**
+ * @brief  Starts a DMA burst read of the output registers. May be called from
+ *         the data ready interrupt. The result is fetched with
+ *         ICM20602_FinishReadXYZAngRateDMA() from the SPI transfer complete callback.
+ * @param  None
+ * @retval HAL_OK if transfer started, HAL_BUSY if the SPI bus is in use
+ */
+HAL_StatusTypeDef ICM20602_StartReadXYZAngRateDMA(void)
+{
+	return IMU_IO_Read_DMA(dmaTxBuffer, dmaRxBuffer, ICM20602_GYRO_XOUT_H_ADDR, ICM20602_XYZ_DMA_BUFFER_SIZE - 1);
+}
+
+/**
+ * @brief  Ends a DMA burst read and unpacks the raw output register values.
+ *         Called from the SPI transfer complete callback (ISR context).
+ * @param  pRawData : Raw data out pointer (3 elements, sensor axes x, y, z)
+ * @retval None
+ */
+void ICM20602_FinishReadXYZAngRateDMA(int16_t* pRawData)
+{
+	int i;
+
+	IMU_IO_Read_DMA_Complete();
+
+	for (i = 0; i < 3; i++) {
+		/* First received byte is clocked out during the address byte */
+		pRawData[i] = ToInt16(&dmaRxBuffer[2 * i + 1]);
+	}
+}
+
+/**
+ * @brief  Converts raw output register values to angular rates [rad/s]
+ * @param  pRawData : Raw data in pointer (3 elements)
+ * @param  pfData : Data out pointer (3 elements)
+ * @retval None
+ */
+void ICM20602_ConvertXYZAngRate(const int16_t* pRawData, float* pfData)
+{
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		/* milli degrees/s to rad/s with a folded constant factor */
+		pfData[i] = (float) pRawData[i] * (ICM20602_SENSITIVITY_1000DPS * (float) M_PI / 180000.0f);
+	}
+}
+
+/**
+ * @brief  Enables the FIFO for the temperature and the angular rates. The FIFO
+ *         watermark interrupt replaces data ready on INT, it is raised when
+ *         FIFO_WM_TH bytes are in the FIFO. Call after ICM20602_Config().
+ * @param  watermark : FIFO level [samples] at which INT pulses, 1..ICM20602_FIFO_MAX_SAMPLES
+ * @retval zero upon success, nonzero upon error
+ */
+uint8_t ICM20602_ConfigFIFO(uint8_t watermark)
+{
+	uint16_t threshold = (uint16_t) watermark * ICM20602_FIFO_SAMPLE_SIZE;
+
+	if ((watermark == 0) || (watermark > ICM20602_FIFO_MAX_SAMPLES)) {
+		return 1; // error
+	}
+
+	WriteRegister(ICM20602_INT_ENABLE_ADDR, 0);
+	WriteRegister(ICM20602_USER_CTRL_ADDR, ICM20602_USER_CTRL_FIFO_RST);
+
+	/* A full FIFO stops instead of overwriting, so that the samples stay aligned */
+	WriteRegister(ICM20602_CONFIG_ADDR, ICM20602_CONFIG_FIFO_MODE_STOP | ICM20602_CONFIG_DLPF_176HZ);
+	WriteRegister(ICM20602_FIFO_WM_TH1_ADDR, (uint8_t) (threshold >> 8));
+	WriteRegister(ICM20602_FIFO_WM_TH2_ADDR, (uint8_t) threshold);
+	WriteRegister(ICM20602_FIFO_EN_ADDR, ICM20602_FIFO_EN_GYRO);
+	WriteRegister(ICM20602_USER_CTRL_ADDR, ICM20602_USER_CTRL_FIFO_EN);
+
+	return 0;
+}
+
+/**
+ * @brief  Reads the samples in the FIFO with one burst read, oldest first. A
+ *         FIFO too full to take a further sample is reset, the samples in it
+ *         are dropped and the missed interrupts show in the data rate stats.
+ * @param  pRawData : Raw data out pointer, 3 elements (x, y, z) per sample, oldest sample first
+ * @param  maxSamples : Max number of samples pRawData holds
+ * @param  pNbrOfSamples : Number of samples read
+ * @retval HAL_OK if read successful
+ */
+HAL_StatusTypeDef ICM20602_ReadFIFO(int16_t* pRawData, uint8_t maxSamples, uint8_t* pNbrOfSamples)
+{
+	HAL_StatusTypeDef status = HAL_OK;
+	uint8_t countBuffer[2] = { 0 };
+	uint16_t count;
+	uint8_t nbrOfSamples;
+	int i, j;
+
+	*pNbrOfSamples = 0;
+
+	status = IMU_IO_Read(countBuffer, ICM20602_FIFO_COUNTH_ADDR, 2);
+	if (status != HAL_OK) {
+		return status;
+	}
+
+	count = ((uint16_t) countBuffer[0] << 8) | countBuffer[1];
+	if (count > ICM20602_FIFO_SIZE - ICM20602_FIFO_SAMPLE_SIZE) {
+		WriteRegister(ICM20602_USER_CTRL_ADDR, ICM20602_USER_CTRL_FIFO_EN | ICM20602_USER_CTRL_FIFO_RST);
+		return HAL_OK;
+	}
+
+	nbrOfSamples = (uint8_t) (count / ICM20602_FIFO_SAMPLE_SIZE > ICM20602_FIFO_MAX_SAMPLES ?
+			ICM20602_FIFO_MAX_SAMPLES : count / ICM20602_FIFO_SAMPLE_SIZE);
+	if (nbrOfSamples > maxSamples) {
+		nbrOfSamples = maxSamples;
+	}
+
+	if (nbrOfSamples == 0) {
+		return HAL_OK;
+	}
+
+	/* The FIFO_R_W address does not increment, each read pops the next byte */
+	status = IMU_IO_Read(fifoBuffer, ICM20602_FIFO_R_W_ADDR, nbrOfSamples * ICM20602_FIFO_SAMPLE_SIZE);
+	if (status != HAL_OK) {
+		return status;
+	}
+
+	for (i = 0; i < nbrOfSamples; i++) {
+		for (j = 0; j < 3; j++) {
+			/* Skips the temperature of the sample */
+			pRawData[3 * i + j] = ToInt16(&fifoBuffer[i * ICM20602_FIFO_SAMPLE_SIZE + 2 + 2 * j]);
+		}
+	}
+
+	*pNbrOfSamples = nbrOfSamples;
+
+	return status;
+}
+
+/**
+ * @brief  Reads the die temperature
+ * @param  pTemperature : Temperature out pointer [deg C]
+ * @retval HAL_OK if read successful
+ */
+HAL_StatusTypeDef ICM20602_ReadTemperature(int8_t* pTemperature)
+{
+	HAL_StatusTypeDef status = HAL_OK;
+	uint8_t tmpbuffer[2] = { 0 };
+
+	status = IMU_IO_Read(tmpbuffer, ICM20602_TEMP_OUT_H_ADDR, 2);
+	if (status == HAL_OK) {
+		*pTemperature = (int8_t) lrintf((float) ToInt16(tmpbuffer) / ICM20602_TEMP_SENSITIVITY + ICM20602_TEMP_OFFSET);
+	}
+
+	return status;
+}
+
+/**
+ * @return  nominal configured data rate in Hz
+ */
+uint16_t ICM20602_DataRateHz(void)
+{
+	return 1000 / (1 + ICM20602_SAMPLE_RATE_DIVIDER);
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+static void WriteRegister(uint8_t addr, uint8_t value)
+{
+	IMU_IO_Write(&value, addr, 1);
+}
+
+static int16_t ToInt16(const uint8_t* pBuffer)
+{
+	return (int16_t) (((uint16_t) pBuffer[0] << 8) | pBuffer[1]);
+}
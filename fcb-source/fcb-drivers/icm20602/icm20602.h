@@ -0,0 +1,88 @@
+/*
+ * icm20602.h
+ *
+ * Gyroscope driver of the TDK InvenSense ICM-20602 6-axis IMU on the external
+ * SPI IMU connector, see IMU_IO_Init(). Only the gyroscope of the part is used,
+ * its accelerometer is kept in standby.
+ */
+
+#ifndef ICM20602_ICM20602_H_
+#define ICM20602_ICM20602_H_
+
+#include <stdint.h>
+#include "gyro.h"
+#include "stm32f3_discovery.h"
+
+/* Register addresses */
+#define ICM20602_SMPLRT_DIV_ADDR		0x19
+#define ICM20602_CONFIG_ADDR			0x1A
+#define ICM20602_GYRO_CONFIG_ADDR		0x1B
+#define ICM20602_FIFO_EN_ADDR			0x23
+#define ICM20602_INT_PIN_CFG_ADDR		0x37
+#define ICM20602_INT_ENABLE_ADDR		0x38
+#define ICM20602_TEMP_OUT_H_ADDR		0x41
+#define ICM20602_GYRO_XOUT_H_ADDR		0x43
+#define ICM20602_FIFO_WM_TH1_ADDR		0x60
+#define ICM20602_FIFO_WM_TH2_ADDR		0x61
+#define ICM20602_SIGNAL_PATH_RESET_ADDR	0x68
+#define ICM20602_USER_CTRL_ADDR			0x6A
+#define ICM20602_PWR_MGMT_1_ADDR		0x6B
+#define ICM20602_PWR_MGMT_2_ADDR		0x6C
+#define ICM20602_I2C_IF_ADDR			0x70
+#define ICM20602_FIFO_COUNTH_ADDR		0x72
+#define ICM20602_FIFO_R_W_ADDR			0x74
+#define ICM20602_WHO_AM_I_ADDR			0x75
+
+#define I_AM_ICM20602					((uint8_t)0x12)
+
+/* Register bits */
+#define ICM20602_CONFIG_FIFO_MODE_STOP	((uint8_t)0x40)	/* No writes to a full FIFO */
+#define ICM20602_CONFIG_DLPF_176HZ		((uint8_t)0x01)	/* 176 Hz bandwidth, 1 kHz internal rate */
+#define ICM20602_FULLSCALE_1000			((uint8_t)0x10)
+#define ICM20602_FIFO_EN_GYRO			((uint8_t)0x10)	/* Temperature and gyroscope */
+#define ICM20602_INT_PIN_RD_CLEAR		((uint8_t)0x10)	/* Active high push-pull 50 us pulse, cleared by any read */
+#define ICM20602_INT_DATA_RDY_EN		((uint8_t)0x01)
+#define ICM20602_SIGNAL_PATH_RESET_ALL	((uint8_t)0x03)	/* Accelerometer and temperature */
+#define ICM20602_USER_CTRL_FIFO_EN		((uint8_t)0x40)
+#define ICM20602_USER_CTRL_FIFO_RST		((uint8_t)0x04)
+#define ICM20602_PWR_MGMT_1_RESET		((uint8_t)0x80)
+#define ICM20602_PWR_MGMT_1_CLK_PLL		((uint8_t)0x01)
+#define ICM20602_PWR_MGMT_2_ACC_STBY	((uint8_t)0x38)
+#define ICM20602_I2C_IF_DIS				((uint8_t)0x40)
+
+/* Sample rate divider of the 1 kHz internal rate, the output data rate is 1 kHz / (1 + divider) */
+#define ICM20602_SAMPLE_RATE_DIVIDER	0
+
+#define ICM20602_SENSITIVITY_1000DPS	((float)(1000.0f / 32.8f))	/* [mdps/LSB] */
+#define ICM20602_TEMP_SENSITIVITY		326.8f						/* [LSB/deg C] */
+#define ICM20602_TEMP_OFFSET			25							/* [deg C] at 0 LSB */
+
+/* A FIFO sample is the temperature followed by x, y, z, all big endian */
+#define ICM20602_FIFO_SAMPLE_SIZE		8
+#define ICM20602_FIFO_SIZE				1008	/* [bytes] */
+#define ICM20602_FIFO_MAX_SAMPLES		32		/* Read per ICM20602_ReadFIFO() */
+
+/* Address byte + 6 data bytes of a DMA burst of the gyroscope output */
+#define ICM20602_XYZ_DMA_BUFFER_SIZE	7
+
+uint8_t ICM20602_Config(void);
+uint8_t ICM20602_ReadID(void);
+void ICM20602_Reset(void);
+HAL_StatusTypeDef ICM20602_ReadXYZAngRate(float* pfData);
+HAL_StatusTypeDef ICM20602_StartReadXYZAngRateDMA(void);
+void ICM20602_FinishReadXYZAngRateDMA(int16_t* pRawData);
+void ICM20602_ConvertXYZAngRate(const int16_t* pRawData, float* pfData);
+uint8_t ICM20602_ConfigFIFO(uint8_t watermark);
+HAL_StatusTypeDef ICM20602_ReadFIFO(int16_t* pRawData, uint8_t maxSamples, uint8_t* pNbrOfSamples);
+HAL_StatusTypeDef ICM20602_ReadTemperature(int8_t* pTemperature);
+uint16_t ICM20602_DataRateHz(void);
+
+/* Gyroscope driver structure */
+extern GYRO_DrvTypeDef Icm20602Drv;
+
+/* IMU IO functions */
+void IMU_IO_Init(void);
+void IMU_IO_Write(uint8_t* pBuffer, uint8_t WriteAddr, uint16_t NumByteToWrite);
+HAL_StatusTypeDef IMU_IO_Read(uint8_t* pBuffer, uint8_t ReadAddr, uint16_t NumByteToRead);
+
+#endif /* ICM20602_ICM20602_H_ */
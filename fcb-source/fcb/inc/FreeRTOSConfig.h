@@ -69,17 +69,29 @@
 /* Ensure stdint is only used by the compiler, and not the assembler. */
 #if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
  #include <stdint.h>
+ #include <stddef.h>
  extern uint32_t SystemCoreClock;
+ extern void TaskStatusTraceMalloc(void* block, const size_t size);
+ extern void TaskStatusTraceFree(void* block, const size_t size);
 #endif
 
 #define configUSE_PREEMPTION              1
-#define configUSE_IDLE_HOOK               0
-#define configUSE_TICK_HOOK               0
+#define configUSE_IDLE_HOOK               1
+#define configUSE_TICK_HOOK               1
 #define configCPU_CLOCK_HZ                (SystemCoreClock)
 #define configTICK_RATE_HZ                ((portTickType)1000)
-#define configMAX_PRIORITIES              ((unsigned portBASE_TYPE)7)
+#define configMAX_PRIORITIES              ((unsigned portBASE_TYPE)7) /* With the two rate group tasks, see rate_groups.h */
 #define configMINIMAL_STACK_SIZE          ((unsigned short)128)
-#define configTOTAL_HEAP_SIZE             ((size_t)(15 * 1024))
+/* Heap_2 takes the TCBs and stacks of the tasks created on the heap (IDLE, TELEMETRY, WORK_HIGH, WORK_LOW and
+ * RG_SLOW, 6.0 KB), the semaphores, mutexes and queues (1.5 KB) and the CLI command list (16 bytes per command,
+ * 1.9 KB), 9.3 KB in the default USB build. The sensor and flight control tasks have their stacks in CCM. The benchmark build has the BENCH
+ * and IPC_WAIT tasks and the IPC objects instead, 9.2 KB. Add the stacks of the optional tasks, e.g. with
+ * FCB_TRACE_RECORDER or FCB_CAN_BUS, and see the least free heap since startup in task-status. */
+#ifdef FCB_BENCHMARK_BUILD
+#define configTOTAL_HEAP_SIZE             ((size_t)(9 * 1024 + 768))
+#else
+#define configTOTAL_HEAP_SIZE             ((size_t)(9 * 1024 + 512))
+#endif
 #define configMAX_TASK_NAME_LEN           (16)
 #define configUSE_TRACE_FACILITY          1
 #define configUSE_16_BIT_TICKS            0
@@ -92,6 +104,10 @@
 #define configUSE_APPLICATION_TASK_TAG    0
 #define configUSE_COUNTING_SEMAPHORES     1
 
+ /* Trace recorder, see trace_recorder.h. Uncomment to record the kernel events and the sensor, state estimation
+  and UART ISRs for Tracealyzer, leave commented for flight builds. */
+//#define FCB_TRACE_RECORDER
+
  /* Task Status Feature*/
 /* TASK STATUS is defined in project properties */
 #ifdef TASK_STATUS
@@ -100,17 +116,28 @@
 	#define configUSE_STATS_FORMATTING_FUNCTIONS	1
 	#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS	configureTimerForRunTimeStats
 	#define configUSE_TRACE_FACILITY				1
+	/* Counts the context switches of each task in the TCB field reserved for trace code, see task_status.c. The
+	 * trace recorder keeps its task handles there, the task status reports no switches then. */
+	#ifndef FCB_TRACE_RECORDER
+	#define traceTASK_SWITCHED_IN()					( pxCurrentTCB->uxTaskNumber++ )
+	#endif
 #else
 	#define configGENERATE_RUN_TIME_STATS			0
 #endif
 
+ /* Heap monitor, see task_status.c. Called by heap_2 with the scheduler suspended, a NULL block is a failed
+  allocation. */
+#define traceMALLOC(pvAddress, uiSize)	TaskStatusTraceMalloc((pvAddress), (uiSize))
+#define traceFREE(pvAddress, uiSize)	TaskStatusTraceFree((pvAddress), (uiSize))
+
 
 /* Co-routine definitions. */
 #define configUSE_CO_ROUTINES           0
 #define configMAX_CO_ROUTINE_PRIORITIES (2)
 
-/* Software timer definitions. */
-#define configUSE_TIMERS             1
+/* Software timer definitions. Not used, the rate groups and the deferred workers run the periodic and delayed work
+ * without the timer task and its queue on the heap. */
+#define configUSE_TIMERS             0
 #define configTIMER_TASK_PRIORITY    (2)
 #define configTIMER_QUEUE_LENGTH     10
 #define configTIMER_TASK_STACK_DEPTH (configMINIMAL_STACK_SIZE * 1)
@@ -126,6 +153,7 @@ to exclude the API function. */
 #define INCLUDE_vTaskDelay             1
 #define INCLUDE_xTaskGetSchedulerState 1
 #define INCLUDE_uxTaskGetStackHighWaterMark 1
+#define INCLUDE_pcTaskGetTaskName      1
 
 /* Cortex-M specific definitions. */
 #ifdef __NVIC_PRIO_BITS
@@ -154,7 +182,12 @@ See http://www.FreeRTOS.org/RTOS-Cortex-M3-M4.html. */
 
 /* Normal assert() semantics without relying on the provision of an assert.h
 header file. */
+#ifdef FCB_HOST_BUILD
+/* Aborts the host build, see host/port/portmacro.h */
+#define configASSERT( x ) if( ( x ) == 0 ) { vPortHostAssert( __FILE__, __LINE__ ); }
+#else
 #define configASSERT( x ) if( ( x ) == 0 ) { taskDISABLE_INTERRUPTS(); for( ;; ); }
+#endif
 
 /* Definitions that map the FreeRTOS port interrupt handlers to their CMSIS
    standard names. */
@@ -176,4 +209,11 @@ header file. */
  take up unnecessary RAM. */
  #define configCOMMAND_INT_MAX_OUTPUT_SIZE 1
 
+ /* # FreeRTOS Plus Trace # */
+
+ /* The recorder hooks replace the trace macros, so they come after all other definitions */
+#if defined(FCB_TRACE_RECORDER) && (defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__))
+ #include "trcKernelPort.h"
+#endif
+
 #endif /* FREERTOS_CONFIG_H */
@@ -0,0 +1,145 @@
+/******************************************************************************
+ * @file    airframe.h
+ * @author  Dragonfly
+ * @brief   Airframe description: the motor layouts, the mass and inertia of
+ *          the CAD model (info_mechanical_properties_*.txt) and the motor
+ *          thrust and torque fits. The mixer, the controller limits and the
+ *          controller scaling are derived from it, so another frame is a
+ *          matter of FCB_AIRFRAME and the numbers here.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __AIRFRAME_H
+#define __AIRFRAME_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "arm_math.h"
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Motor layouts, the values of MixerGeometry_TypeDef. Motor 1 is front right (front for "plus"), the others follow
+ * counter-clockwise seen from above, motor 1 spins so that it has a positive yaw factor and the rotation directions
+ * alternate. A tricopter needs a yaw servo output, which the board does not have. */
+#define AIRFRAME_QUAD_X                 0
+#define AIRFRAME_QUAD_PLUS              1
+#define AIRFRAME_HEX_X                  2
+#define AIRFRAME_OCTO_X                 3
+
+/* Airframe of the build, the default mixer layout */
+#define FCB_AIRFRAME                    AIRFRAME_QUAD_X
+
+/* Uncomment to compile the physical mixer for FCB_AIRFRAME only, with the factors as constants, so that it is
+ * unrolled and folded to one multiply-add per motor and axis. The set-motor-mixer layout must then be FCB_AIRFRAME,
+ * the airmode setting still applies. */
+//#define FCB_AIRFRAME_FIXED_MIXER
+
+/* Uncomment to use the mass and inertia of the CAD model with the chassis */
+//#define AIRFRAME_WITH_CHASSIS
+
+/* Arm length, from the center to each motor [m] (measured) */
+#define LENGTH_ARM 	            ((float32_t) 0.30)
+
+/* Total mass [kg] and principal moments of inertia at the center of gravity [kg*m^2] of the CAD model. The products of
+ * inertia are below 3% of the moments and are neglected. The model does not include the on-board electronics (e.g.
+ * PCBs and charger). */
+#ifdef AIRFRAME_WITH_CHASSIS
+#define MASS		            ((float32_t) 2.3523396)
+#define IXX					    ((float32_t) 0.041942971)		// X-axis moment of inertia [kg*m^2]
+#define IYY					    ((float32_t) 0.041981406)		// Y-axis moment of inertia [kg*m^2]
+#define IZZ					    ((float32_t) 0.075746409)		// Z-axis moment of inertia [kg*m^2]
+#else
+#define MASS		            ((float32_t) 2.1983808)
+#define IXX					    ((float32_t) 0.04065473)		// X-axis moment of inertia [kg*m^2]
+#define IYY					    ((float32_t) 0.040693168)		// Y-axis moment of inertia [kg*m^2]
+#define IZZ					    ((float32_t) 0.074656405)		// Z-axis moment of inertia [kg*m^2]
+#endif
+
+/* Data fitting variables to map physical outputs to motor control values
+ * Thrust T(m) = AT*m + BT 		[Unit: N] [t_out unit in seconds]
+ * Draq torque Q(m) = AQ*m + BQ	[Unit: Nm]
+ * The mixer allocates with these fits, the identified thrust curves of thrust_curve.h map its linear motor signal to
+ * the output of each motor
+ */
+#define R_PROP			0.1397f		// Propeller radius [m]
+#define AT 			0.0001768f
+#define BT 			0.0f
+#define AQ			0.000001748f	// This was calculated based on aerodynamic rotor equations
+// #define BQ			0.0
+
+/* Per motor mixer factors of the layouts, in motor order: thrust share, roll & pitch = lateral & longitudinal motor
+ * position in arm lengths (positive to the left & to the front), yaw = +1/-1 for the rotation direction. I.e.
+ * { 1, -sin(azimuth), cos(azimuth), +/-1 } with the azimuth clockwise from the nose. */
+#define AIRFRAME_QUAD_X_MOTORS          4
+#define AIRFRAME_QUAD_X_FACTORS         { \
+        { 1.0f, -0.70710678f,  0.70710678f,  1.0f }, \
+        { 1.0f,  0.70710678f,  0.70710678f, -1.0f }, \
+        { 1.0f,  0.70710678f, -0.70710678f,  1.0f }, \
+        { 1.0f, -0.70710678f, -0.70710678f, -1.0f } }
+
+#define AIRFRAME_QUAD_PLUS_MOTORS       4
+#define AIRFRAME_QUAD_PLUS_FACTORS      { \
+        { 1.0f,  0.0f,  1.0f,  1.0f }, \
+        { 1.0f,  1.0f,  0.0f, -1.0f }, \
+        { 1.0f,  0.0f, -1.0f,  1.0f }, \
+        { 1.0f, -1.0f,  0.0f, -1.0f } }
+
+#define AIRFRAME_HEX_X_MOTORS           6
+#define AIRFRAME_HEX_X_FACTORS          { \
+        { 1.0f, -0.5f,  0.8660254f,  1.0f }, \
+        { 1.0f,  0.5f,  0.8660254f, -1.0f }, \
+        { 1.0f,  1.0f,  0.0f,        1.0f }, \
+        { 1.0f,  0.5f, -0.8660254f, -1.0f }, \
+        { 1.0f, -0.5f, -0.8660254f,  1.0f }, \
+        { 1.0f, -1.0f,  0.0f,       -1.0f } }
+
+#define AIRFRAME_OCTO_X_MOTORS          8
+#define AIRFRAME_OCTO_X_FACTORS         { \
+        { 1.0f, -0.38268343f,  0.92387953f,  1.0f }, \
+        { 1.0f,  0.38268343f,  0.92387953f, -1.0f }, \
+        { 1.0f,  0.92387953f,  0.38268343f,  1.0f }, \
+        { 1.0f,  0.92387953f, -0.38268343f, -1.0f }, \
+        { 1.0f,  0.38268343f, -0.92387953f,  1.0f }, \
+        { 1.0f, -0.38268343f, -0.92387953f, -1.0f }, \
+        { 1.0f, -0.92387953f, -0.38268343f,  1.0f }, \
+        { 1.0f, -0.92387953f,  0.38268343f, -1.0f } }
+
+/* The layout of FCB_AIRFRAME. AIRFRAME_ROLLPITCH_ARMS is the smaller of the roll and pitch sums of the positive
+ * factors, i.e. the moment the motors on one side give at full thrust, in motor thrusts times arm lengths. */
+#if (FCB_AIRFRAME == AIRFRAME_QUAD_X)
+#define AIRFRAME_NBR_OF_MOTORS          AIRFRAME_QUAD_X_MOTORS
+#define AIRFRAME_FACTORS                AIRFRAME_QUAD_X_FACTORS
+#define AIRFRAME_ROLLPITCH_ARMS         ((float32_t) M_SQRT2)
+#elif (FCB_AIRFRAME == AIRFRAME_QUAD_PLUS)
+#define AIRFRAME_NBR_OF_MOTORS          AIRFRAME_QUAD_PLUS_MOTORS
+#define AIRFRAME_FACTORS                AIRFRAME_QUAD_PLUS_FACTORS
+#define AIRFRAME_ROLLPITCH_ARMS         ((float32_t) 1.0)
+#elif (FCB_AIRFRAME == AIRFRAME_HEX_X)
+#define AIRFRAME_NBR_OF_MOTORS          AIRFRAME_HEX_X_MOTORS
+#define AIRFRAME_FACTORS                AIRFRAME_HEX_X_FACTORS
+#define AIRFRAME_ROLLPITCH_ARMS         ((float32_t) 1.7320508)
+#elif (FCB_AIRFRAME == AIRFRAME_OCTO_X)
+#define AIRFRAME_NBR_OF_MOTORS          AIRFRAME_OCTO_X_MOTORS
+#define AIRFRAME_FACTORS                AIRFRAME_OCTO_X_FACTORS
+#define AIRFRAME_ROLLPITCH_ARMS         ((float32_t) 2.6131259)
+#else
+#error "FCB_AIRFRAME is not one of the AIRFRAME_* layouts"
+#endif
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Limits of the controllers, from the layout and the motor fits */
+#define AIRFRAME_MOTOR_MAX_THRUST       ((float32_t) AT*UINT16_MAX + BT)    // One motor at full output [N]
+#define MAX_THRUST			((float32_t) AIRFRAME_NBR_OF_MOTORS*AIRFRAME_MOTOR_MAX_THRUST)	// Maximal upward thrust from all motors combined [N]
+#define MAX_ROLLPITCH_MOM	((float32_t) AIRFRAME_ROLLPITCH_ARMS*AIRFRAME_MOTOR_MAX_THRUST*LENGTH_ARM)	// Motors of one side full thrust, of the other no thrust [Nm]
+#define MAX_YAW_MOM			((float32_t) AQ*(AIRFRAME_NBR_OF_MOTORS/2)*UINT16_MAX)		// Motors with same rot dir full thrust, the others no thrust [Nm]
+
+#endif /* __AIRFRAME_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
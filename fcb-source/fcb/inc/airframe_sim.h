@@ -0,0 +1,98 @@
+/******************************************************************************
+ * @file    airframe_sim.h
+ * @author  Dragonfly
+ * @brief   Header file for the airframe simulation model, the plant of a
+ *          software-in-the-loop setup. It is a rigid body with the mass and
+ *          inertia of airframe.h, motors with a first order lag on the thrust
+ *          and drag torque fits, ground contact, and a gyroscope and
+ *          accelerometer with noise, bias, vibration and sample delay. It uses
+ *          no HAL or RTOS calls and builds with FCB_HOST_BUILD.
+ *
+ *          A harness steps the model at the gyroscope rate and runs the
+ *          flight control every FLIGHT_CONTROL_TASK_PERIOD:
+ *            AirframeSimInit(&sim, &config);
+ *            every step: AirframeSimGetSensors(&sim, gyro, acc);
+ *                        (estimation and control) -> motorValues;
+ *                        AirframeSimStep(&sim, motorValues, dt);
+ *          Nothing waits for the wall clock, so it runs as fast as the host.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __AIRFRAME_SIM_H
+#define __AIRFRAME_SIM_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "arm_math.h"
+#include "airframe.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+#define AIRFRAME_SIM_G_ACC                  ((float32_t) 9.815) // As G_ACC in flight_control.h [m/s^2]
+#define AIRFRAME_SIM_MAX_SENSOR_DELAY       8 // Max sensor delay [steps]
+
+/* Default model parameters, see AirframeSimConfig_TypeDef */
+#define AIRFRAME_SIM_DEFAULT_MOTOR_TIME_CONSTANT    0.030f  // ESC and rotor spin-up [s]
+#define AIRFRAME_SIM_DEFAULT_DRAG                   0.25f   // Linear air drag [N/(m/s)]
+#define AIRFRAME_SIM_DEFAULT_GYRO_NOISE             0.005f  // [rad/s] standard deviation
+#define AIRFRAME_SIM_DEFAULT_ACC_NOISE              0.05f   // [m/s^2] standard deviation
+#define AIRFRAME_SIM_DEFAULT_VIBRATION              0.5f    // [m/s^2] amplitude at full thrust
+#define AIRFRAME_SIM_DEFAULT_VIBRATION_FREQUENCY    120.0f  // [Hz] at full thrust, scales with the mean motor value
+#define AIRFRAME_SIM_DEFAULT_SENSOR_DELAY           1       // [steps]
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Model parameters, all may be changed between runs, e.g. to sweep the sensor quality or the motor response */
+typedef struct {
+    float32_t motorTimeConstant;            // Thrust lag of the motors and ESCs [s], 0 for instant thrust
+    float32_t drag;                         // Linear translational drag [N/(m/s)]
+    float32_t gyroNoise;                    // Gyroscope white noise standard deviation [rad/s]
+    float32_t gyroBias[3];                  // Gyroscope constant bias [rad/s]
+    float32_t accNoise;                     // Accelerometer white noise standard deviation [m/s^2]
+    float32_t accBias[3];                   // Accelerometer constant bias [m/s^2]
+    float32_t vibrationAmplitude;           // Accelerometer vibration at all motors full [m/s^2]
+    float32_t vibrationFrequency;           // Vibration frequency at all motors full [Hz]
+    uint8_t sensorDelay;                    // Sensor sample delay in steps, up to AIRFRAME_SIM_MAX_SENSOR_DELAY
+    uint32_t seed;                          // Noise generator seed, a run is repeatable for the same seed
+} AirframeSimConfig_TypeDef;
+
+/* Model state, NED inertial frame and x forward, y right, z down body frame as in the flight code */
+typedef struct {
+    AirframeSimConfig_TypeDef config;
+    float32_t position[3];                  // [m], z is negative above the ground
+    float32_t velocity[3];                  // [m/s]
+    float32_t quaternion[4];                // Rotates FROM the body frame TO the inertial frame, q0 scalar
+    float32_t angleRate[3];                 // Body angular rates [rad/s]
+    float32_t motorThrust[AIRFRAME_NBR_OF_MOTORS]; // Lagged thrust [N]
+    float32_t motorTorque[AIRFRAME_NBR_OF_MOTORS]; // Lagged drag torque [Nm]
+    float32_t specificForce[3];             // Body frame specific force of the last step [m/s^2]
+    float32_t time;                         // Simulated time [s]
+    float32_t vibrationPhase;               // [rad]
+    float32_t vibrationLevel;               // Mean motor value share [0..1]
+    bool onGround;
+    float32_t gyroHistory[AIRFRAME_SIM_MAX_SENSOR_DELAY + 1][3];
+    float32_t accHistory[AIRFRAME_SIM_MAX_SENSOR_DELAY + 1][3];
+    uint8_t historyIndex;
+    uint32_t random;
+} AirframeSim_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported function prototypes --------------------------------------------- */
+void AirframeSimGetDefaultConfig(AirframeSimConfig_TypeDef* config);
+void AirframeSimInit(AirframeSim_TypeDef* sim, const AirframeSimConfig_TypeDef* config);
+void AirframeSimStep(AirframeSim_TypeDef* sim, const int32_t motorValues[], const float32_t dt);
+void AirframeSimGetSensors(const AirframeSim_TypeDef* sim, float32_t gyro[3], float32_t acc[3]);
+void AirframeSimGetAttitude(const AirframeSim_TypeDef* sim, float32_t attitude[3]);
+
+#endif /* __AIRFRAME_SIM_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,53 @@
+/******************************************************************************
+ * @file    attitude_quaternion.h
+ * @brief   Header file for the quaternion attitude estimation module
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_ATTITUDE_QUATERNION_H_
+#define INC_ATTITUDE_QUATERNION_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include "arm_math.h"
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Proportional & integral feedback gains of the accelerometer (roll/pitch) and
+ * magnetometer (yaw) corrections */
+#define QUATERNION_KP_ACC       ((float32_t) 1.0)
+#define QUATERNION_KI_ACC       ((float32_t) 0.02)
+#define QUATERNION_KP_MAG       ((float32_t) 0.5)
+#define QUATERNION_KI_MAG       ((float32_t) 0.01)
+
+/* Accelerometer samples whose norm differs more than this from G_ACC are
+ * dominated by manoeuvring and not used for correction */
+#define QUATERNION_ACC_REJECT_RATIO     ((float32_t) 0.2)
+
+/* Upper limit of the integration step, e.g. for the first sample [s] */
+#define QUATERNION_MAX_DT       ((float32_t) 0.05)
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+void QuaternionAttitudeInit(const float32_t initAngles[3]);
+void QuaternionAttitudeUpdateGyro(const float32_t* bodyAngularRates, const float32_t dt);
+void QuaternionAttitudePropagate(void);
+void QuaternionAttitudeCorrectAcc(const float32_t* bodyAccelerometerReadings, const float32_t dt);
+void QuaternionAttitudeCorrectMag(float32_t* bodyMagneticReadings, const float32_t dt);
+void QuaternionAttitudeGetAngles(float32_t* dstAttitude);
+void QuaternionAttitudeGetRates(float32_t* dstRates);
+
+#endif /* INC_ATTITUDE_QUATERNION_H_ */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,52 @@
+/******************************************************************************
+ * @file    benchmark.h
+ * @author  Dragonfly
+ * @brief   Header file for the on-target benchmark runner of the Benchmark
+ *          build configuration (FCB_BENCHMARK_BUILD). That build starts no
+ *          sensors, flight control or receiver handling, only the USB com port
+ *          and the runner, which times the computation kernels of the flight
+ *          code with the cycle counter and prints the results as a CSV table,
+ *          so that runs of two commits can be compared directly. A second
+ *          table times the RTOS signalling mechanisms, see benchmark_ipc.c.
+ ******************************************************************************/
+
+#ifndef __BENCHMARK_H
+#define __BENCHMARK_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+/* Exported constants --------------------------------------------------------*/
+
+/* The table is printed this long after startup and then repeated, so that a host can open the port at any time and
+ * read a complete one, between the "# benchmark" and "# end" lines */
+#define BENCHMARK_START_DELAY_MS        3000
+#define BENCHMARK_REPEAT_PERIOD_MS      10000
+
+/* Software triggered interrupt of the signalling benchmarks, a vector of an unused peripheral, at the highest
+ * priority that may call the FreeRTOS API */
+#define BENCHMARK_IPC_IRQn              UART4_IRQn
+#define BENCHMARK_IPC_IRQHandler        UART4_IRQHandler
+#define BENCHMARK_IPC_IRQ_PREEMPT_PRIO  configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY
+#define BENCHMARK_IPC_IRQ_SUB_PRIO      0
+
+#define BENCHMARK_IPC_ITERATIONS        1000
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported function prototypes --------------------------------------------- */
+void CreateBenchmarkTask(void);
+void PrintIpcBenchmarks(const uint32_t overhead);
+void BenchmarkIpcIRQHandler(void);
+
+#endif /* __BENCHMARK_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,83 @@
+/******************************************************************************
+ * @file    blackbox.h
+ * @brief   Header file for the blackbox flight data recorder, which logs the
+ *          sensor, reference, PID and motor values of the control cycles to
+ *          a RAM ring buffer and from there to the flight data log area of
+ *          the internal flash, or with FCB_SD_CARD to a file per session on a
+ *          microSD card, see blackbox_sd.h
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_BLACKBOX_H_
+#define INC_BLACKBOX_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include "fcb_retval.h"
+#include "param_table.h"
+
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Log format, a sequence of frames in the flash log area. Frames start with their type byte, erased (0xFF) bytes
+ * between frames are padding and are skipped. Values are varints, signed ones zigzag encoded (as protobuf sint32).
+ *   'H' session header: magic "DFBB", format version, decimation, number of fields, the field scales (float32 each),
+ *       then the data rate [Hz] and the group delay [s] (float32 each) of the gyroscope, accelerometer and magnetometer
+ *   'I' intra frame: time since the previous frame [us], then each field value as is
+ *   'P' predicted frame: time since the previous frame [us], then the change of each field since the previous frame
+ *   'L' log frame: text length, then the text of a log record, see deferred_log.h. Does not break the prediction.
+ * A field value is the logged value multiplied by its scale and rounded. Every session starts with a 'H' frame, an
+ * 'I' frame follows it, every BLACKBOX_INTRA_FRAME_INTERVAL:th frame and every frame after a dropped one. The ESC
+ * telemetry fields follow the others with MOTOR_ESC_TELEMETRY only, the system identification fields follow them
+ * with FCB_SYSTEM_IDENTIFICATION only, the crash flags field follows them with FCB_CRASH_DETECTION only and the
+ * motor failure flags field follows it with FCB_MOTOR_FAILURE_DETECTION only, see the number of fields of the
+ * header. */
+#define BLACKBOX_FORMAT_VERSION         8       // 4: ESC telemetry fields, 5: system identification fields, 6: crash
+                                                // flags field, 7: sensor timing in the header, 8: motor failure
+                                                // flags field
+#define BLACKBOX_MAX_LOG_TEXT_SIZE      96      // Longer log texts are cut
+#define BLACKBOX_INTRA_FRAME_INTERVAL   32
+
+#define BLACKBOX_DEFAULT_DECIMATION     1       // Every control cycle is logged
+#define BLACKBOX_MAX_DECIMATION         100
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Blackbox settings as stored in flash */
+typedef struct {
+    uint16_t decimation;        // A frame is logged every decimation:th control cycle
+} BlackboxSettings_TypeDef;
+
+typedef struct {
+    uint32_t usedBytes;         // Bytes of the flash log area in use, with FCB_SD_CARD of the session files
+    uint32_t sizeBytes;         // Size of the flash log area, with FCB_SD_CARD the used and the free space
+    uint32_t framesLogged;      // Frames written to the RAM ring buffer since startup
+    uint32_t framesDropped;     // Frames dropped since startup, because the ring buffer or the log area was full
+    uint16_t decimation;
+    bool isErasing;
+} BlackboxStatus_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+void CreateBlackboxWork(void);
+void BlackboxLogControlCycle(void);
+void BlackboxLogEventFrame(void);
+void BlackboxLogText(const char* text, const uint16_t length);
+FcbRetValType EraseBlackbox(void);
+void GetBlackboxStatus(BlackboxStatus_TypeDef* status);
+FcbRetValType ReadBlackbox(const uint32_t offset, uint8_t* dst, const uint16_t size);
+const ParamGroup_TypeDef* GetBlackboxParamGroup(void);
+
+#endif /* INC_BLACKBOX_H_ */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
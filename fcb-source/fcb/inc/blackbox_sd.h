@@ -0,0 +1,103 @@
+/******************************************************************************
+ * @file    blackbox_sd.h
+ * @brief   Header file for the SD card sink of the blackbox, with FCB_SD_CARD.
+ *          The blackbox work hands the log to the BLACKBOX_SD task in blocks of
+ *          BLACKBOX_SD_BLOCK_SIZE, one filled while the other is written, and
+ *          the task writes each session to its own file BBnnnn.BBL in the root
+ *          directory of the FAT formatted card. The next file is created and
+ *          preallocated to BLACKBOX_SD_FILE_SIZE in idle time, so that the
+ *          clusters of a session are allocated before it starts and its
+ *          sectors stream to the card as multiple block writes, see
+ *          sd_card.h. A session ends in the file when flight control is back
+ *          in idle mode, the file is then cut to the session length. Only the
+ *          BLACKBOX_SD task uses the filesystem.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_BLACKBOX_SD_H_
+#define INC_BLACKBOX_SD_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include "sd_card.h"
+#include "receiver.h"
+#include "fcb_retval.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#if defined(FCB_SD_CARD) && RECEIVER_INPUT_IS_UART
+#error "The SD card SPI TX DMA and the serial receiver UART RX DMA share DMA1 channel 5"
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+
+#define BLACKBOX_SD_BLOCK_SIZE          2048            // Whole sectors, so that FAT-SL writes them without a read
+#define BLACKBOX_SD_FILE_SIZE           0x1000000       // 16 MB, more than 8 minutes at the full blackbox rate
+#define BLACKBOX_SD_PREALLOCATION_STEP  0x10000         // 64 kB preallocated at a time, between the blocks
+#define BLACKBOX_SD_MOUNT_RETRY_PERIOD  1000            // [ms] Between the attempts to mount a card
+#define BLACKBOX_SD_MAX_FILE_NUMBER     9999
+
+/* Exported types ------------------------------------------------------------*/
+
+typedef enum {
+    BLACKBOX_SD_NO_CARD = 0,        // No card answered, mounts are retried
+    BLACKBOX_SD_NO_VOLUME,          // The card has no FAT volume, or it is full
+    BLACKBOX_SD_PREALLOCATING,      // The next file is being preallocated, a session may start
+    BLACKBOX_SD_READY,              // The next file is preallocated
+    BLACKBOX_SD_LOGGING,
+    BLACKBOX_SD_ERASING,
+    BLACKBOX_SD_STATE_NBR
+} BlackboxSdStateType;
+
+typedef struct {
+    BlackboxSdStateType state;
+    uint16_t fileNumber;            // Of the next or ongoing session, BBnnnn.BBL
+    uint16_t files;                 // Session files on the card
+    uint32_t logBytes;              // Session bytes in the files on the card
+    uint32_t sessionBytes;          // Of the ongoing session
+    uint32_t preallocatedBytes;     // Of the next or ongoing session file
+    uint32_t freeKBytes;            // Of the volume, except the preallocated bytes
+    uint32_t discardedBytes;        // Log bytes without a ready card, or of failed sessions, since startup
+    uint32_t maxBlockTime;          // Longest write of a block to the card [ms]
+} BlackboxSdStatus_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+void CreateBlackboxSdTask(void);
+
+/**
+ * Takes log bytes of the ongoing session, with BlackboxSdEndSession() called
+ * by the blackbox work only. The bytes not taken are to be given again, the
+ * blocks are then full. Without a ready card the bytes of the session are all
+ * taken and discarded.
+ *
+ * @param data log bytes
+ * @param size number of bytes
+ * @return number of bytes taken
+ */
+uint16_t BlackboxSdWrite(const uint8_t* data, const uint16_t size);
+
+/**
+ * Ends the ongoing session, if any, its file is closed when all of it is
+ * written. Does nothing the next calls.
+ */
+void BlackboxSdEndSession(void);
+
+FcbRetValType BlackboxSdErase(void);
+void GetBlackboxSdStatus(BlackboxSdStatus_TypeDef* dstStatus);
+size_t PrintBlackboxSdStatus(char* dst, const size_t dstSize);
+
+#endif /* INC_BLACKBOX_SD_H_ */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,59 @@
+/******************************************************************************
+ * @file    coning_integrator.h
+ * @brief   Header file for the coning compensated gyroscope integration. The
+ *          angle increments of the gyroscope samples are summed at the sensor
+ *          rate together with the coning correction of each pair of
+ *          successive increments, the part of the rotation a sum of
+ *          increments misses when the rotation axis moves, e.g. under
+ *          combined roll and pitch rates. The estimator takes the resulting
+ *          rotation vector once per prediction and rotates the attitude by
+ *          it, instead of integrating each axis on its own.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_CONING_INTEGRATOR_H_
+#define INC_CONING_INTEGRATOR_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "arm_math.h"
+#include "ram_func.h"
+
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Uncomment to predict the attitude with the coning compensated rotation of the gyroscope samples since the previous
+ * prediction, see ConingIntegratorTake(). Leave commented to integrate the Euler angle rates per axis. */
+//#define FCB_CONING_COMPENSATION
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Rotation of the gyroscope samples since the latest take, body frame */
+typedef struct ConingIntegrator {
+    float32_t alpha[3];         // Sum of the angle increments [rad]
+    float32_t beta[3];          // Coning correction of the sum [rad]
+    float32_t lastDelta[3];     // Latest angle increment, also across a take [rad]
+    float32_t dt;               // Time of the summed samples [s]
+    uint32_t samples;
+} ConingIntegratorType;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+void ConingIntegratorReset(ConingIntegratorType* integrator);
+RAMFUNC void ConingIntegratorUpdate(ConingIntegratorType* integrator, const float32_t* bodyAngularRates,
+        const float32_t dt);
+RAMFUNC uint32_t ConingIntegratorTake(ConingIntegratorType* integrator, float32_t* dstRotation, float32_t* dstDt);
+RAMFUNC void RotationVectorToQuaternion(float32_t* dstQuaternion, const float32_t* rotation);
+RAMFUNC void GetEulerAngleIncrement(float32_t* dstIncrement, const float32_t* angles, const float32_t* rotation);
+
+#endif /* INC_CONING_INTEGRATOR_H_ */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
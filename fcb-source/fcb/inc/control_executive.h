@@ -0,0 +1,84 @@
+/******************************************************************************
+ * @file    control_executive.h
+ * @author  Dragonfly
+ * @brief   Header file for the control executive, which runs the inner rate
+ *          loop of the cascaded control at interrupt level, outside the RTOS.
+ *          The gyroscope DMA complete interrupt triggers it for each sample.
+ *          It processes the sample, updates the rate controllers and loads the
+ *          motor outputs, above configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY,
+ *          so no tick, critical section or task delays it. The flight control
+ *          task keeps the estimation and the outer loop, and passes the rate
+ *          references to the executive through a double buffer.
+ ******************************************************************************/
+
+#ifndef __CONTROL_EXECUTIVE_H
+#define __CONTROL_EXECUTIVE_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "arm_math.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Uncomment to run the rate loop and the motor allocation in the control executive instead of the flight control
+ * task. Requires PID_USE_CASCADED_RATE_CONTROL and the gyroscope DMA reads, i.e. not FCB_GYRO_FIFO_MODE. The rate loop
+ * then closes on the filtered gyroscope sample less the bias estimate in all stabilized modes, the RC frames are
+ * applied by the outer loop only, and the functions it calls must not use the FreeRTOS API. */
+//#define FCB_CONTROL_EXECUTIVE
+
+/* Software triggered interrupt of the executive, a vector of an unused peripheral. Above the RTOS interrupts, below
+ * the receiver pulse capture, so that the captured pulse widths stay exact. */
+#define CONTROL_EXECUTIVE_IRQn                  UART5_IRQn
+#define CONTROL_EXECUTIVE_IRQHandler            UART5_IRQHandler
+#define CONTROL_EXECUTIVE_IRQ_PREEMPT_PRIO      1
+#define CONTROL_EXECUTIVE_IRQ_SUB_PRIO          0
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Set by the flight control task after each outer loop update */
+typedef struct {
+	bool isEnabled;                 // The rate loop runs and drives the motors, else the task handles the motors
+	float32_t thrust;               // [N]
+	float32_t refRates[3];          // Roll, pitch & yaw body rate references [rad/s]
+	float32_t rateBiases[3];        // Roll, pitch & yaw gyroscope bias estimates [rad/s]
+} ControlExecutiveSetpoint_TypeDef;
+
+typedef struct {
+	uint32_t triggers;              // Gyroscope samples processed
+	uint32_t overruns;              // Samples lost, a trigger came while the previous one was pending
+	uint32_t runs;                  // Rate loop updates, every PID_RATE_LOOP_GYRO_DIVISOR:th enabled trigger
+	uint32_t maxRunTime;            // Max time of a trigger [core clock cycles]
+	uint32_t maxLatency;            // Max time from the gyroscope data ready to the motor output [core clock cycles]
+	uint64_t sumLatency;            // [core clock cycles]
+} ControlExecutiveStats_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported function prototypes --------------------------------------------- */
+#ifdef FCB_CONTROL_EXECUTIVE
+void ControlExecutiveConfig(void);
+void ControlExecutiveTriggerFromISR(const int16_t rawData[3], const uint32_t drdyTimestamp);
+void ControlExecutiveIRQHandler(void);
+void ControlExecutiveSetSetpoint(const ControlExecutiveSetpoint_TypeDef* setpoint);
+void ControlExecutiveGetGyroSample(float32_t dstAngleDot[3]);
+void ControlExecutiveGetCtrlSignals(float32_t dstMoments[3]);
+void ControlExecutiveSuspend(void);
+void ControlExecutiveResume(void);
+void ControlExecutiveGetStats(ControlExecutiveStats_TypeDef* dstStats);
+void ControlExecutiveResetStats(void);
+size_t ControlExecutivePrint(char* dst, const size_t dstSize);
+#endif /* FCB_CONTROL_EXECUTIVE */
+
+#endif /* __CONTROL_EXECUTIVE_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,140 @@
+/******************************************************************************
+ * @file    crash_detection.h
+ * @brief   Header file for the crash and tumble detection, which cuts the
+ *          motors of a UAV that has flipped or hit the ground instead of
+ *          leaving the controllers to drive it with saturated outputs until
+ *          the pilot switches the mode. Three conditions are watched in the
+ *          flying states on every control cycle:
+ *          - tumble: the roll or pitch moment controller is saturated while
+ *            the attitude error, or in the rate mode the rate error, of its
+ *            axis stays above CRASH_TUMBLE_ATTITUDE_ERROR or
+ *            CRASH_TUMBLE_RATE_ERROR
+ *          - inverted: the UAV is upside down with the throttle stick below
+ *            CRASH_INVERTED_MAX_THROTTLE
+ *          - impact: the acceleration exceeds the impact acceleration, which
+ *            alone is not a crash, but shortens the time a tumble or an
+ *            inversion has to last for CRASH_IMPACT_WINDOW after it
+ *
+ *          A crash is detected when a condition has lasted for its time of
+ *          CrashDetectionSettingsType, which is to be long enough for the
+ *          flips and rolls of aggressive flights, a time of 0 turns its
+ *          condition off. The detection is latched, it sends the flight mode
+ *          state machine to failsafe, which cuts the motors, and logs a last
+ *          blackbox frame with the crash flags. The latch is only released
+ *          once the UAV is disarmed, so it has to be armed again explicitly.
+ *
+ *          The accelerometer full scale is 2 g, so the impact acceleration is
+ *          to be set below it.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_CRASH_DETECTION_H_
+#define INC_CRASH_DETECTION_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include "arm_math.h"
+#include "fcb_retval.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Uncomment to cut the motors and require a re-arm when a crash is detected, see above */
+//#define FCB_CRASH_DETECTION
+
+/* Exported types ------------------------------------------------------------*/
+
+typedef enum {
+    CRASH_DETECTION_CAUSE_NONE = 0,
+    CRASH_DETECTION_CAUSE_TUMBLE,
+    CRASH_DETECTION_CAUSE_INVERTED,
+    CRASH_DETECTION_CAUSE_IMPACT,   // A tumble or an inversion confirmed an impact
+    CRASH_DETECTION_CAUSE_NBR
+} CrashDetectionCauseType;
+
+/* Crash detection settings as stored in flash */
+typedef struct {
+    float32_t impactAcceleration;   // [g] of the acceleration magnitude
+    float32_t impactTime;           // [s] a tumble or an inversion lasts after an impact, 0 ignores the impacts
+    float32_t tumbleTime;           // [s] a tumble lasts, 0 turns the tumble detection off
+    float32_t invertedTime;         // [s] an inversion lasts, 0 turns the inversion detection off
+} CrashDetectionSettingsType;
+
+typedef struct {
+    bool isCrashed;                 // Latched until disarmed
+    CrashDetectionCauseType cause;  // Of the latest crash since startup
+    uint8_t flags;                  // CRASH_FLAG_* of the latest control cycle
+    uint32_t crashes;               // Since startup
+    uint32_t timestamp;             // Of the latest crash [ms]
+} CrashDetectionStatusType;
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Conditions of a control cycle, as logged to the blackbox */
+#define CRASH_FLAG_IMPACT               0x01    // An impact within CRASH_IMPACT_WINDOW
+#define CRASH_FLAG_TUMBLE               0x02
+#define CRASH_FLAG_INVERTED             0x04
+#define CRASH_FLAG_DETECTED             0x80    // The latch
+
+#define CRASH_IMPACT_WINDOW             ((float32_t) 1.0)           // [s] an impact shortens the times
+#define CRASH_TUMBLE_ATTITUDE_ERROR     ((float32_t) 45*PI/180)     // [rad]
+#define CRASH_TUMBLE_RATE_ERROR         ((float32_t) 180*PI/180)    // [rad/s]
+#define CRASH_INVERTED_MAX_THROTTLE     ((float32_t) 0.1)           // Part of the throttle stick range
+#define CRASH_MAX_TIME                  ((float32_t) 10.0)          // [s] of the condition times
+#define CRASH_MAX_IMPACT_ACCELERATION   ((float32_t) 16.0)          // [g]
+
+#define CRASH_DEFAULT_IMPACT_ACCELERATION   ((float32_t) 1.8)
+#define CRASH_DEFAULT_IMPACT_TIME           ((float32_t) 0.2)
+#define CRASH_DEFAULT_TUMBLE_TIME           ((float32_t) 1.0)
+#define CRASH_DEFAULT_INVERTED_TIME         ((float32_t) 2.0)
+
+/* Exported functions ------------------------------------------------------- */
+
+/**
+ * Loads the settings from flash, or the defaults if there are none. Called by
+ * the flight control task at startup.
+ */
+void InitCrashDetection(void);
+
+/**
+ * Evaluates the conditions on the controller outputs, the attitude and the
+ * acceleration of the latest control cycle, and latches a crash. Releases the
+ * latch in the disarmed state. Called by the flight control task on every
+ * control cycle, before the flight mode update.
+ *
+ * @param throttle throttle stick in [0, 1]
+ * @return true on the control cycle a crash is detected
+ */
+bool UpdateCrashDetection(const float32_t throttle);
+
+/**
+ * @return true from a detected crash until the UAV is disarmed
+ */
+bool IsCrashDetected(void);
+
+/**
+ * Sets the settings, effective from the next control cycle.
+ *
+ * @param settings see CrashDetectionSettingsType
+ * @return FCB_OK, FCB_ERR if an acceleration or a time is out of range
+ */
+FcbRetValType SetCrashDetectionSettings(const CrashDetectionSettingsType* settings);
+void GetCrashDetectionSettings(CrashDetectionSettingsType* settings);
+FcbRetValType SaveCrashDetectionSettings(void);
+
+void GetCrashDetectionStatus(CrashDetectionStatusType* dstStatus);
+const char* GetCrashDetectionCauseName(const CrashDetectionCauseType cause);
+size_t PrintCrashDetection(char* dst, const size_t dstSize);
+
+#endif /* INC_CRASH_DETECTION_H_ */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
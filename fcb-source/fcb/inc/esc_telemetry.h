@@ -0,0 +1,156 @@
+/******************************************************************************
+ * @file    esc_telemetry.h
+ * @brief   Header file for the ESC telemetry of KISS and BLHeli_32 ESC:s. An
+ *          ESC answers a DShot frame with the telemetry request bit set with
+ *          a frame of its temperature, voltage, current, consumption and eRPM
+ *          on a single wire UART. The telemetry wires of all ESC:s are joined
+ *          to ESC_TELEMETRY_UART_RX_PIN, so the ESC:s are polled one at a time
+ *          in round-robin, one request every ESC_TELEMETRY_POLL_PERIOD. The
+ *          flight control task evaluates the answers into a health state per
+ *          motor. An unhealthy ESC blocks arming, an over-temperature or a
+ *          desync of an armed motor sends the flight mode to failsafe.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_ESC_TELEMETRY_H_
+#define INC_ESC_TELEMETRY_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "stm32f3xx_hal.h"
+
+#include "motor_control.h"
+#include "fcb_retval.h"
+#include "pb_encode.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Uncomment when the telemetry wires of KISS or BLHeli_32 ESC:s are connected to ESC_TELEMETRY_UART_RX_PIN */
+//#define MOTOR_ESC_TELEMETRY
+
+#if defined(MOTOR_ESC_TELEMETRY) && !MOTOR_OUTPUT_IS_DSHOT
+#error "The ESC telemetry is requested in the DShot frames, MOTOR_ESC_TELEMETRY needs a DShot MOTOR_OUTPUT_PROTOCOL"
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+
+typedef enum EscHealth {
+    ESC_HEALTH_NO_TELEMETRY = 0,    // No answer within ESC_TELEMETRY_TIMEOUT
+    ESC_HEALTH_OK,
+    ESC_HEALTH_HOT,                 // At ESC_TELEMETRY_HOT_TEMPERATURE or above
+    ESC_HEALTH_OVER_TEMPERATURE,    // At ESC_TELEMETRY_MAX_TEMPERATURE or above, a fault
+    ESC_HEALTH_DESYNC,              // The motor does not follow its command, see ESC_DESYNC_MIN_COMMAND, a fault
+    ESC_HEALTH_NBR
+} EscHealthType;
+
+/* Latest answer of an ESC and its health */
+typedef struct EscTelemetry {
+    EscHealthType health;
+    uint8_t temperature;            // [degC]
+    uint16_t voltage;               // [10 mV]
+    uint16_t current;               // [10 mA]
+    uint16_t consumption;           // [mAh]
+    uint32_t eRpm;                  // Electrical rpm
+    uint32_t answers;               // Since startup
+    uint32_t misses;                // Requests without an answer, since startup
+    uint32_t frameErrors;           // Answers with a CRC or line error, since startup
+} EscTelemetryType;
+
+/* Exported constants --------------------------------------------------------*/
+
+/* ESC telemetry UART on PD9, receive only. The USART3 RX DMA request is on DMA1 channel 3, which the gyroscope SPI TX
+ * uses, so the bytes are taken by the receive interrupt instead, ten per answer. */
+#define ESC_TELEMETRY_UART                      USART3
+#define ESC_TELEMETRY_UART_CLK_ENABLE()         __USART3_CLK_ENABLE()
+#define ESC_TELEMETRY_UART_GPIO_CLK_ENABLE()    __GPIOD_CLK_ENABLE()
+#define ESC_TELEMETRY_UART_RX_PIN               GPIO_PIN_9
+#define ESC_TELEMETRY_UART_GPIO_PORT            GPIOD
+#define ESC_TELEMETRY_UART_AF                   GPIO_AF7_USART3
+#define ESC_TELEMETRY_UART_IRQn                 USART3_IRQn
+#define ESC_TELEMETRY_UART_IRQHandler           USART3_IRQHandler
+#define ESC_TELEMETRY_UART_IRQ_PREEMPT_PRIO     8 // Masked by the critical sections the answers are read in
+#define ESC_TELEMETRY_UART_IRQ_SUB_PRIO         0
+
+#define ESC_TELEMETRY_BAUDRATE                  115200
+#define ESC_TELEMETRY_FRAME_SIZE                10      // Temperature, voltage, current, consumption, eRPM/100, CRC8
+#define ESC_TELEMETRY_POLL_PERIOD               2000    // [us] Between requests, an answer takes 870 us
+#define ESC_TELEMETRY_TIMEOUT                   100     // [ms] Without an answer before the telemetry of a motor is lost
+
+#define ESC_TELEMETRY_HOT_TEMPERATURE           80      // [degC]
+#define ESC_TELEMETRY_MAX_TEMPERATURE           100     // [degC]
+
+/* A motor that is commanded at least ESC_DESYNC_MIN_COMMAND is desynced when it turns slower than ESC_DESYNC_MIN_ERPM,
+ * or lost more than ESC_DESYNC_MAX_ERPM_DROP of its eRPM since its previous answer while its command did not drop as
+ * much, in ESC_DESYNC_ANSWERS answers in a row. Not checked for ESC_DESYNC_SPIN_UP_TIME after the command went up to
+ * ESC_DESYNC_MIN_COMMAND, for the propeller to spin up. */
+#define ESC_DESYNC_MIN_COMMAND                  (UINT16_MAX/5)
+#define ESC_DESYNC_MIN_ERPM                     1000
+#define ESC_DESYNC_MAX_ERPM_DROP                ((float32_t) 0.5)
+#define ESC_DESYNC_ANSWERS                      2
+#define ESC_DESYNC_SPIN_UP_TIME                 500     // [ms]
+
+/* Request of EscTelemetryNextRequest() when no motor is polled */
+#define ESC_TELEMETRY_NO_REQUEST                0xFF
+
+/* Exported variables --------------------------------------------------------*/
+extern UART_HandleTypeDef EscTelemetryUartHandle;
+
+/* Exported functions ------------------------------------------------------- */
+
+/**
+ * Configures ESC_TELEMETRY_UART and starts the polling with the next DShot
+ * frame. Called at startup, after the motor outputs are configured.
+ *
+ * @return FCB_OK, FCB_ERR_INIT if the UART could not be configured
+ */
+FcbRetValType EscTelemetryConfig(void);
+
+/**
+ * Gets the motor to set the telemetry request bit of in the DShot frame that
+ * is being loaded, the next one in round-robin once ESC_TELEMETRY_POLL_PERIOD
+ * has passed since the previous request. Called by the context that loads the
+ * motor outputs, which may be the control executive. Uses no FreeRTOS API.
+ *
+ * @return motor index, ESC_TELEMETRY_NO_REQUEST if no motor is polled
+ */
+uint8_t EscTelemetryNextRequest(void);
+
+/**
+ * Takes the received bytes of an answer and checks its CRC once complete. Called
+ * by the ESC_TELEMETRY_UART interrupt.
+ */
+void EscTelemetryUartIRQHandler(void);
+
+/**
+ * Decodes the new answers and updates the health of the motors. Called by the
+ * flight control task on every control cycle, before the flight mode.
+ */
+void EscTelemetryUpdate(void);
+
+/**
+ * @return true if an ESC reports an over-temperature or a desync
+ */
+bool IsEscFault(void);
+
+/**
+ * @return true if all ESC:s answer and are ESC_HEALTH_OK, required to arm
+ */
+bool IsEscTelemetryHealthy(void);
+
+void GetEscTelemetry(EscTelemetryType dstTelemetry[MOTOR_OUTPUT_CHANNELS]);
+const char* GetEscHealthName(const EscHealthType health);
+size_t PrintEscTelemetry(char* dst, const size_t dstSize);
+bool EncodeEscTelemetry(pb_ostream_t* stream);
+
+#endif /* INC_ESC_TELEMETRY_H_ */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
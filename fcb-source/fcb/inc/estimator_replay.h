@@ -0,0 +1,128 @@
+/******************************************************************************
+ * @file    estimator_replay.h
+ * @author  Dragonfly
+ * @brief   Header file for the capture and replay of the state estimator
+ *          input. The estimator output is a function of its initialization,
+ *          see InitStatesFrom(), and of the prediction times and the sensor
+ *          samples that follow it, so that a replay of them gives the
+ *          estimates of the flight bit for bit on the same build, and the
+ *          estimates of a changed estimator on the same input on another.
+ *
+ *          Capture: RPC_SET_ESTIMATOR_LOG starts it in idle mode, the flight
+ *          control then initializes the estimator again from the next sensor
+ *          samples, so that the log starts with an init record. The flight
+ *          control puts the records in a RAM ring and the ESTIMATOR_LOG task
+ *          sends them over the USB log endpoint as ESTIMATOR_LOG_MSG_ENUM
+ *          frames.
+ *
+ *          Replay: in HIL mode the host sends the logged records back with
+ *          RPC_ESTIMATOR_REPLAY requests, faster than real time. An init
+ *          record starts the replay, from then on the flight control does not
+ *          update the estimator itself. The response counts the predictions
+ *          that did not give the logged estimate. An empty request, or leaving
+ *          HIL mode, ends the replay and the flight control initializes the
+ *          estimator again from the sensor samples.
+ *
+ *          Records, little endian without padding, first byte the type:
+ *            init:       StateInitType (80), warm start valid (1),
+ *                        StateWarmStartType (120), the state after the warm
+ *                        start and the gyroscope bias seeding
+ *            prediction: timestamp (4), roll, pitch & yaw after it (12)
+ *            correction: sensor (1, FcbSensorIndexType), timestamp (4),
+ *                        sample (12)
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __ESTIMATOR_REPLAY_H
+#define __ESTIMATOR_REPLAY_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "arm_math.h"
+#include "fcb_retval.h"
+#include "fcb_sensors.h"
+#include "hil_mode.h"
+
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Uncomment to compile in the estimator capture and replay and their RPC commands. Without it the commands fail with
+ * RPC_UNKNOWN_COMMAND. */
+//#define FCB_ESTIMATOR_REPLAY
+
+#if defined(FCB_ESTIMATOR_REPLAY) && !defined(FCB_HIL_MODE)
+#error "The estimator replay locks the motors and the physical sensors out with the HIL mode, define FCB_HIL_MODE"
+#endif
+
+#if defined(FCB_ESTIMATOR_REPLAY) && defined(FCB_FUSED_SENSOR_PIPELINE)
+#error "The estimator is initialized again in the flight control task, which the fused sensor pipeline suspends"
+#endif
+
+#define ESTIMATOR_RECORD_INIT_SIZE          (1 + 20*4 + 1 + 30*4) // StateInitType, StateWarmStartType
+#define ESTIMATOR_RECORD_PREDICTION_SIZE    (1 + 4 + 12)
+#define ESTIMATOR_RECORD_CORRECTION_SIZE    (1 + 1 + 4 + 12)
+
+/* The ESTIMATOR_LOG_MSG_ENUM message: stream offset of the data [bytes] (4), records dropped since the capture
+ * started (4), then up to ESTIMATOR_LOG_CHUNK_SIZE bytes of the record stream. The records may be split between
+ * messages, the host finds a lost message by the offset and a dropped record by the count, the replay is not exact
+ * past either. */
+#define ESTIMATOR_LOG_MSG_HEADER_SIZE       8
+#define ESTIMATOR_LOG_CHUNK_SIZE            128
+
+/* RPC_ESTIMATOR_REPLAY response: predictions in the request (2), of them not giving the logged estimate (2), then
+ * the estimate after the request: roll, pitch & yaw, their rates, z position and z velocity (8 float32) */
+#define ESTIMATOR_REPLAY_RESPONSE_SIZE      (2 + 2 + 8*4)
+
+/* Exported types ------------------------------------------------------------*/
+
+typedef enum {
+    ESTIMATOR_RECORD_INIT = 'I',
+    ESTIMATOR_RECORD_PREDICTION = 'P',
+    ESTIMATOR_RECORD_CORRECTION = 'C'
+} EstimatorRecordType;
+
+/* Exported macro ------------------------------------------------------------*/
+#ifdef FCB_ESTIMATOR_REPLAY
+
+/* Record the estimator input in the flight control, right after the estimator call they describe */
+#define ESTIMATOR_LOG_INIT()                            EstimatorLogInit()
+#define ESTIMATOR_LOG_PREDICTION(TIMESTAMP)             EstimatorLogPrediction(TIMESTAMP)
+#define ESTIMATOR_LOG_CORRECTION(SENSOR, XYZ, TIMESTAMP) EstimatorLogCorrection((SENSOR), (XYZ), (TIMESTAMP))
+
+/* True while a replay owns the estimator, the flight control does not update it then */
+#define ESTIMATOR_REPLAY_IS_ACTIVE()                    EstimatorReplayIsActive()
+
+#else
+
+#define ESTIMATOR_LOG_INIT()                            ((void) 0)
+#define ESTIMATOR_LOG_PREDICTION(TIMESTAMP)             ((void) 0)
+#define ESTIMATOR_LOG_CORRECTION(SENSOR, XYZ, TIMESTAMP) ((void) 0)
+#define ESTIMATOR_REPLAY_IS_ACTIVE()                    (false)
+
+#endif /* FCB_ESTIMATOR_REPLAY */
+
+/* Exported function prototypes --------------------------------------------- */
+#ifdef FCB_ESTIMATOR_REPLAY
+void CreateEstimatorLogTask(void);
+FcbRetValType EstimatorLogStart(void);
+void EstimatorLogStop(void);
+void EstimatorLogInit(void);
+void EstimatorLogPrediction(const uint32_t timestamp);
+void EstimatorLogCorrection(const FcbSensorIndexType sensor, const float32_t xyz[3], const uint32_t timestamp);
+
+FcbRetValType EstimatorReplay(const uint8_t* request, const uint8_t requestSize, uint8_t* response);
+void EstimatorReplayEnd(void);
+bool EstimatorReplayIsActive(void);
+#endif
+
+#endif /* __ESTIMATOR_REPLAY_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
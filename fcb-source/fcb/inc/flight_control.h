@@ -12,53 +12,35 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "arm_math.h"
+#include "airframe.h"
 #include "fcb_sensors.h"
+#include "param_table.h"
 
 /* Exported constants --------------------------------------------------------*/
 
 #define FLIGHT_CONTROL_TASK_PERIOD		5 // [ms]
 
-/* Physical properties of aircraft */
+/* Uncomment to run state prediction, gyroscope correction, control and motor allocation as one chain per gyroscope
+ * sample instead of predicting and controlling on the STATE_ESTIMATION_UPDATE_TIM timer. The delay from gyroscope
+ * sample to motor update is then fixed and the control period is the gyroscope sample period. */
+//#define FCB_GYRO_SYNCHRONOUS_PIPELINE
 
-/* Quadcopter arm length [m] (measured) */
-#define LENGTH_ARM 	            ((float32_t) 0.30)
+/* Uncomment together with FCB_GYRO_SYNCHRONOUS_PIPELINE to run the flight control in the SENSORS task once the state
+ * estimation is initialized, right after each gyroscope fetch. The task switch from the SENSORS to the flight control
+ * task goes away, the slower sensors still pass their samples through the mailboxes. */
+//#define FCB_FUSED_SENSOR_PIPELINE
 
-/* Total mass of the quadcopter [kg]
- * # From CAD model w/o chassi : MASS = 2.1983808e+00 KILOGRAM
- * # From CAD model w/ chassi  : MASS = 2.3523396e+00 KILOGRAM
- * # NOTE: CAD model does not include masses of on-board electronics (e.g. PCBs and charger)
- */
-#define MASS		            ((float32_t) 2.1983808)
+/* Uncomment to ramp the rate flight mode references from the previous to a new RC frame over one measured frame
+ * period, instead of stepping them. Smoother, but the full stick input is reached one frame period later. */
+//#define FLIGHT_CONTROL_RC_INTERPOLATION
+#define FLIGHT_CONTROL_RC_INTERPOLATION_MAX_PERIOD  50 // [ms] Longer frame gaps step to the new references
 
-/* Inertia tensor of the quadcopter [kg]
- *
- * # From CAD model w/o chassi :
- *
- * INERTIA at CENTER OF GRAVITY with respect to _QUADCOPTER_SAMMANSTALLNING coordinate frame:  (KILOGRAM * MM^2)
- * INERTIA TENSOR:
- * Ixx Ixy Ixz  4.0654730e+04  1.1429530e+03 -1.6499272e+01
- * Iyx Iyy Iyz  1.1429530e+03  4.0693168e+04  4.3305781e+01
- * Izx Izy Izz -1.6499272e+01  4.3305781e+01  7.4656405e+04
- *
- * # From CAD model w/ chassi  :
- *
- * INERTIA at CENTER OF GRAVITY with respect to _QUADCOPTER_SAMMANSTALLNING coordinate frame:  (KILOGRAM * MM^2)
- * INERTIA TENSOR:
- * Ixx Ixy Ixz  4.1942971e+04  1.1949577e+03 -1.8072975e+01
- * Iyx Iyy Iyz  1.1949577e+03  4.1981406e+04  4.0972106e+01
- * Izx Izy Izz -1.8072975e+01  4.0972106e+01  7.5746409e+04
- *
- * # NOTE: CAD model does not include masses/inertia contributions of on-board electronics (e.g. PCBs and charger)
- */
-
-#define IXX					    ((float32_t) 0.04065473)		// X-axis moment of inertia [kg/(m^2)]
-#define IYY					    ((float32_t) 0.040693168)		// Y-axis moment of inertia [kg/(m^2)]
-#define IZZ					    ((float32_t) 0.074656405)		// Z-axis moment of inertia [kg/(m^2)]
+/* Physical properties of aircraft, see airframe.h */
 
 #define G_ACC                   ((float32_t) 9.815)	/* Gravitational acceleration constant approx. 9.815 m/s^2 in
                                                      * Smygehuk, Sweden (according to Lantmateriet) */
 
-#define COMPASS_DECLINATION	    ((float32_t) 3.226*PI/180.0)	/* For Malmoe, Sweden the compass declination is about 3.226 deg East
+#define COMPASS_DECLINATION	    (3.226f*PI/180.0f)	/* For Malmoe, Sweden the compass declination is about 3.226 deg East
  	 	 	 	 	 	 	 	 	 	 	 	 	 	 	 	 * The total field strength is 50552 nT (505.52 mGauss) */
 /* Default reference signal ranges */
 #define DEFAULT_MAX_Z_VELOCITY          2.0			// Max vertical velocity (+/-) [m/s] // TODO use int values m/s, mrad, mrad/s
@@ -68,11 +50,17 @@
 
 #define RECEIVER_TO_REFERENCE_ZERO_PADDING	1800	// Sets how large an area around 0 receiver value the reference signal should be set to zero
 
+/* Rate flight mode body rate reference ranges */
+#define RATE_MODE_MAX_ROLLPITCH_RATE    360*PI/180  // Max roll/pitch rate (+/-) [rad/s]
+#define RATE_MODE_MAX_YAW_RATE          180*PI/180  // Max yaw rate (+/-) [rad/s]
+
 enum FlightControlMode {
 	FLIGHT_CONTROL_IDLE,
 	FLIGHT_CONTROL_RAW,
 	FLIGHT_CONTROL_PID,
-	FLIGHT_CONTROL_AUTONOMOUS
+	FLIGHT_CONTROL_AUTONOMOUS,
+	FLIGHT_CONTROL_RATE,        // Sticks set body rates, the rate loop closes on the gyroscope without the attitude
+	FLIGHT_CONTROL_ALTITUDE_HOLD // As the PID mode, the altitude is held while the throttle stick is centered
 };
 
 /* Exported types ------------------------------------------------------------*/
@@ -95,6 +83,9 @@ typedef struct
 /* Exported function prototypes --------------------------------------------- */
 void CreateFlightControlTask(void);
 enum FlightControlMode GetFlightControlMode(void);
+FlightControlErrorStatus SetStabilizedFlightMode(const enum FlightControlMode mode);
+enum FlightControlMode GetStabilizedFlightMode(void);
+float32_t GetFlightControlSamplePeriod(void);
 
 float32_t GetZVelocityReferenceSignal(void);
 float32_t GetRollAngleReferenceSignal(void);
@@ -109,23 +100,48 @@ float32_t GetYawControlSignal(void);
 
 void ResetRefSignals(RefSignals_TypeDef* refSignals);
 
+FcbRetValType SaveStateWarmStart(void);
+FcbRetValType SaveSensorNoise(void);
+void ReinitStateEstimation(void);
+
+/**
+ * This function flags a flight control update as pending, interrupt context only.
+ */
 void SendFlightControlUpdateToFlightControl(void);
 /**
- * This function sends a message to the flight control queue to indicate that a new prediction shall be calculated.
+ * This function flags that a new prediction shall be calculated, interrupt context only.
  */
 void SendPredictionUpdateToFlightControl(void);
+/**
+ * This function flags that the RC receiver has entered failsafe, interrupt context only. The flight control reacts
+ * without waiting for its next scheduled update.
+ */
+void SendReceiverFailsafeToFlightControl(void);
 
 /**
- * This function sends a message to the flight control queue with new sensor values.
+ * This function stores new sensor values in the flight control mailbox of the sensor, task context only. A sample
+ * that has not been processed yet is replaced, the flight control task always uses the newest one.
  *
  * @param sensorType see FcbSensorIndexType
- * @param deltaT time period to previous sensor drdy in ms
  * @param xyz a 3-array of XYZ sensor readings. See wiki page "Sensors"
+ * @param timestamp time the sample was taken [core clock cycles], see GetTimestamp()
+ */
+void SendCorrectionUpdateToFlightControl(FcbSensorIndexType sensorType, float32_t xyz[3], uint32_t timestamp);
+
+/**
+ * As SendCorrectionUpdateToFlightControl, for the simulated samples of the HIL mode (FCB_HIL_MODE, see hil_mode.h),
+ * which replace the physical ones while it is active. Called from the RX work item of the com port.
  */
-void SendCorrectionUpdateToFlightControl(FcbSensorIndexType sensorType, float32_t xyz[3]);
+void SendSimulatedSampleToFlightControl(FcbSensorIndexType sensorType, float32_t xyz[3], uint32_t timestamp);
+#ifdef FCB_FUSED_SENSOR_PIPELINE
+void RunFusedFlightControl(void);
+#endif /* FCB_FUSED_SENSOR_PIPELINE */
 
 void setMaxLimitForReferenceSignal(float32_t maxZVelocity, float32_t maxRollAngle, float32_t maxPitchAngle, float32_t maxYawAngleRate);
 void getMaxLimitForReferenceSignal(float32_t* maxZVelocity, float32_t* maxRollAngle, float32_t* maxPitchAngle, float32_t* maxYawAngle,float32_t* maxYawAngleRate);
+FcbRetValType SetReferenceMaxLimits(const RefSignals_TypeDef* limits);
+void GetReferenceMaxLimits(RefSignals_TypeDef* limits);
+const ParamGroup_TypeDef* GetReferenceLimitParamGroup(void);
 
 #endif /* __FLIGHT_CONTROL_H */
 
@@ -0,0 +1,161 @@
+/******************************************************************************
+ * @file    flight_mode.h
+ * @brief   Header file for the flight mode state machine. The flight control
+ *          task requests a state from the receiver mode switches on every
+ *          control cycle, and the state machine takes it if a transition is
+ *          allowed from the current state and all its guards hold, e.g. that
+ *          the throttle is low and the estimator converged for arming. The
+ *          flight control carries out the exit actions of the old and the
+ *          entry actions of the new state, e.g. resetting the integrators.
+ *          Rejected requests keep the current state, their reason is logged,
+ *          shown by the CLI and sent to the FMS together with the transitions.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_FLIGHT_MODE_H_
+#define INC_FLIGHT_MODE_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include "flight_control.h"
+#include "fcb_retval.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported types ------------------------------------------------------------*/
+
+typedef enum FlightModeState {
+    FLIGHT_MODE_DISARMED = 0,       // Motors off, the only state the UAV is armed from
+    FLIGHT_MODE_ARMED_IDLE,         // Armed, motors off until the requested flight mode is entered
+    FLIGHT_MODE_RAW,                // FLIGHT_CONTROL_RAW
+    FLIGHT_MODE_ATTITUDE,           // FLIGHT_CONTROL_PID
+    FLIGHT_MODE_RATE,               // FLIGHT_CONTROL_RATE
+    FLIGHT_MODE_ALTITUDE_HOLD,      // FLIGHT_CONTROL_ALTITUDE_HOLD
+    FLIGHT_MODE_AUTONOMOUS,         // FLIGHT_CONTROL_AUTONOMOUS
+    FLIGHT_MODE_FAILSAFE,           // Receiver lost, ESC fault or crash while armed, motors off until disarmed with the
+                                    // receiver back
+    FLIGHT_MODE_NBR
+} FlightModeStateType;
+
+/* Reasons a requested state is not entered, each but the first two is a guard that does not hold */
+typedef enum FlightModeReject {
+    FLIGHT_MODE_REJECT_NONE = 0,
+    FLIGHT_MODE_REJECT_TRANSITION,  // Not entered from the current state, e.g. a flight mode from failsafe
+    FLIGHT_MODE_REJECT_RECEIVER,    // The receiver is not active
+    FLIGHT_MODE_REJECT_THROTTLE,    // The throttle is above FLIGHT_MODE_ARMING_MAX_THROTTLE
+    FLIGHT_MODE_REJECT_CALIBRATION, // The accelerometer and magnetometer are not initialised or are calibrating
+    FLIGHT_MODE_REJECT_SENSORS,     // The gyroscope, accelerometer or magnetometer is unhealthy, see IsSensorHealthy()
+    FLIGHT_MODE_REJECT_ESTIMATOR,   // The estimator has not converged, see IsStateEstimationConverged()
+    FLIGHT_MODE_REJECT_BATTERY,     // The battery is critical, FCB_BATTERY_MONITOR only
+    FLIGHT_MODE_REJECT_ESC,         // An ESC is unhealthy or does not answer, MOTOR_ESC_TELEMETRY only
+    FLIGHT_MODE_REJECT_BAROMETER,   // The barometer is unhealthy, for the altitude hold mode
+    FLIGHT_MODE_REJECT_WATCHDOG,    // The last reset was by the watchdog, see IsWatchdogResetPending()
+    FLIGHT_MODE_REJECT_SELF_TEST,   // A sensor self-test is running or failed, see IsSensorSelfTestPassed()
+    FLIGHT_MODE_REJECT_PREARM,      // A pre-arm check failed, see prearm_checks.h
+    FLIGHT_MODE_REJECT_NBR
+} FlightModeRejectType;
+
+/* State requested by the flight control on a control cycle */
+typedef struct FlightModeRequest {
+    FlightModeStateType state;      // Of the mode switches, FLIGHT_MODE_DISARMED if none is set
+    bool isReceiverActive;          // The switches and throttle are only valid if set
+    bool isThrottleLow;
+    bool isEscFault;                // An ESC reports an over-temperature or a desync, see IsEscFault()
+    bool isCrash;                   // A crash is latched, see IsCrashDetected()
+} FlightModeRequestType;
+
+/* Transition taken by UpdateFlightModeState() */
+typedef struct FlightModeTransition {
+    FlightModeStateType from;
+    FlightModeStateType to;
+    uint8_t actions;                // Exit actions of from and entry actions of to, FLIGHT_MODE_ACTION_* bits
+} FlightModeTransitionType;
+
+typedef struct FlightModeStatus {
+    FlightModeStateType state;
+    FlightModeStateType previousState;
+    FlightModeStateType rejectedState; // Latest rejected request since the latest transition
+    FlightModeRejectType rejectReason; // FLIGHT_MODE_REJECT_NONE if there is none
+    uint32_t timestamp;             // Of the latest transition or rejection [ms]
+    uint32_t transitions;           // Since startup
+    uint32_t rejections;            // Since startup, a repeated request counts once
+} FlightModeStatusType;
+
+/* Entry of the transition log, which holds the latest FLIGHT_MODE_LOG_LENGTH transitions and rejections */
+typedef struct FlightModeLogEntry {
+    uint32_t timestamp;             // [ms]
+    uint8_t from;                   // See FlightModeStateType
+    uint8_t to;                     // The requested state if rejected
+    uint8_t reason;                 // See FlightModeRejectType, FLIGHT_MODE_REJECT_NONE for a transition
+} FlightModeLogEntryType;
+
+/* Exported constants --------------------------------------------------------*/
+
+#define FLIGHT_MODE_LOG_LENGTH          16
+
+/* The throttle channel is low below this part of its range, required to arm */
+#define FLIGHT_MODE_ARMING_MAX_THROTTLE ((float32_t) 0.05)
+
+/* The guard of a rejection reason */
+#define FLIGHT_MODE_GUARD(REASON)       (1UL << (REASON))
+
+/* Entry and exit actions, carried out by the flight control */
+#define FLIGHT_MODE_ACTION_RESET_CONTROL    0x01 // Reset the references, control signals and PID integrators
+#define FLIGHT_MODE_ACTION_CAPTURE_ALTITUDE 0x02 // Hold the current altitude
+#define FLIGHT_MODE_ACTION_BUMPLESS_THRUST  0x04 // Continue the vertical control from the thrust of the old state
+
+/* Exported functions ------------------------------------------------------- */
+
+/**
+ * Starts in the disarmed state and registers the FMS status report with the
+ * low priority deferred worker. Called by the flight control task at startup.
+ *
+ * @return FCB_OK, FCB_ERR if the report could not be registered
+ */
+FcbRetValType FlightModeInit(void);
+
+/**
+ * Takes the requested state, or the failsafe state if the receiver is lost
+ * or an ESC reports a fault while armed. Arming from the disarmed state goes through the armed idle
+ * state, one control cycle per transition. Called by the flight control task
+ * on every control cycle.
+ *
+ * @param request see FlightModeRequestType
+ * @param transition set to the transition taken, if any
+ * @return true if the state changed
+ */
+bool UpdateFlightModeState(const FlightModeRequestType* request, FlightModeTransitionType* transition);
+
+FlightModeStateType GetFlightModeState(void);
+void GetFlightModeStatus(FlightModeStatusType* dstStatus);
+
+/**
+ * @param state see FlightModeStateType
+ * @return the flight control mode run in the state, FLIGHT_CONTROL_IDLE for
+ *         the states with the motors off
+ */
+enum FlightControlMode GetFlightModeControlMode(const FlightModeStateType state);
+
+/**
+ * @param mode flight control mode
+ * @return the flying state that runs the mode, FLIGHT_MODE_DISARMED if none
+ */
+FlightModeStateType GetFlightModeStateOfControlMode(const enum FlightControlMode mode);
+
+const char* GetFlightModeStateName(const FlightModeStateType state);
+const char* GetFlightModeRejectName(const FlightModeRejectType reason);
+bool PrintFlightModeLogNext(char* dst, const size_t dstSize);
+
+#endif /* INC_FLIGHT_MODE_H_ */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,72 @@
+/******************************************************************************
+ * @file    hil_mode.h
+ * @author  Dragonfly
+ * @brief   Header file for the hardware-in-the-loop (HIL) mode. A simulator on
+ *          the host steps its airframe model and sends the simulated
+ *          gyroscope, accelerometer, magnetometer and barometer samples with
+ *          RPC_HIL_STEP requests, see com_rpc.h. The samples go to the flight
+ *          control in place of the physical ones, and the response carries
+ *          the motor values the flight control commanded last. The host paces
+ *          the loop, one request per simulation step.
+ *
+ *          Interlock: while HIL mode is active the motor values only go to
+ *          the simulator, the ESC outputs are not driven. HIL mode is entered
+ *          and left in idle mode only, so commands of a simulated flight never
+ *          reach the motors.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __HIL_MODE_H
+#define __HIL_MODE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "fcb_retval.h"
+#include "fcb_sensors.h"
+#include "motor_control.h"
+
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Uncomment to compile in the HIL mode and its RPC commands. Without it the commands fail with RPC_UNKNOWN_COMMAND
+ * and nothing can lock out or replace the physical sensors. */
+//#define FCB_HIL_MODE
+
+#if defined(FCB_HIL_MODE) && defined(FCB_CONTROL_EXECUTIVE)
+#error "The control executive reads the gyroscope itself, HIL mode cannot replace its samples"
+#endif
+
+/* RPC_HIL_STEP request: host time [us] (4), sensor mask (1, bit per FcbSensorIndexType), then three float32 per
+ * sensor in the mask, in FcbSensorIndexType order. The barometer altitude [m] is the first of its three. */
+#define HIL_STEP_HEADER_SIZE        5
+#define HIL_STEP_SAMPLE_SIZE        12 // 3 float32
+#define HIL_STEP_MAX_REQUEST_SIZE   (HIL_STEP_HEADER_SIZE + 4 * HIL_STEP_SAMPLE_SIZE) // All FCB_SENSOR_NBR sensors
+
+/* RPC_HIL_STEP response: host time of the request [us] (4), FCB time at the injection [us] (4), motor values (2 per
+ * motor output). The host gets the clock offset and the round trip from the two times. */
+#define HIL_STEP_RESPONSE_SIZE      (4 + 4 + 2 * MOTOR_OUTPUT_CHANNELS)
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported function prototypes --------------------------------------------- */
+#ifdef FCB_HIL_MODE
+FcbRetValType HilModeEnable(void);
+FcbRetValType HilModeDisable(void);
+bool HilModeIsActive(void);
+FcbRetValType HilModeStep(const uint8_t* request, const uint8_t requestSize, uint8_t* response);
+void HilModeSetMotorValues(const uint16_t ctrlVal[MOTOR_OUTPUT_CHANNELS]);
+#endif
+
+#endif /* __HIL_MODE_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
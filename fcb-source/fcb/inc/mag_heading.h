@@ -0,0 +1,108 @@
+/******************************************************************************
+ * @file    mag_heading.h
+ * @brief   Header file for the magnetometer heading checks. Near the motors,
+ *          their currents and ferrous structures the measured field is
+ *          disturbed, and a disturbed field turns the heading. A disturbance
+ *          also changes the strength and the inclination of the field, which
+ *          are stable where the UAV flies, so each sample is compared with a
+ *          reference of both taken from the first samples after the estimator
+ *          is initialised. Samples that deviate more than the tolerance are
+ *          not fused, smaller deviations and the throttle, whose motor
+ *          currents disturb the field, inflate the measurement noise. The
+ *          declination turns the magnetic heading into the true heading.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_MAG_HEADING_H_
+#define INC_MAG_HEADING_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include "arm_math.h"
+#include "fcb_retval.h"
+#include "param_table.h"
+#include "ram_func.h"
+#include "rotation_transformation.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Heading settings as stored in flash */
+typedef struct MagHeadingSettings {
+    float32_t declination;          // Added to the magnetic heading, east positive [rad]
+    float32_t fieldTolerance;       // Accepted deviation of the field strength, relative to the reference
+    float32_t throttleNoiseGain;    // The noise is inflated with 1 + gain*throttle^2, throttle 0 to 1
+} MagHeadingSettingsType;
+
+typedef struct MagHeadingStats {
+    uint32_t accepted;              // Samples used for yaw correction
+    uint32_t fieldRejected;         // Samples skipped since the field strength deviates too much
+    uint32_t inclinationRejected;   // Samples skipped since the inclination deviates too much
+    float32_t noiseScale;           // Of the latest accepted sample
+    float32_t fieldStrength;        // Of the latest sample, relative to the reference
+    float32_t inclination;          // Of the latest sample [rad]
+    float32_t referenceInclination; // [rad]
+    bool isReferenceSet;            // Until set, samples are accepted without checks
+} MagHeadingStatsType;
+
+/* Exported constants --------------------------------------------------------*/
+
+#define MAG_HEADING_REFERENCE_SAMPLES           16      // Samples averaged for the reference
+#define MAG_HEADING_INCLINATION_TOLERANCE       0.175f  // [rad] 10 deg, accepted deviation of the inclination
+#define MAG_HEADING_DEFAULT_FIELD_TOLERANCE     0.15f
+#define MAG_HEADING_MAX_FIELD_TOLERANCE         1.0f
+#define MAG_HEADING_DEFAULT_THROTTLE_NOISE_GAIN 4.0f
+#define MAG_HEADING_MAX_THROTTLE_NOISE_GAIN     100.0f
+
+/* Exported functions ------------------------------------------------------- */
+
+/**
+ * Loads the settings from flash, or the defaults if there are none. Called by
+ * the flight control task at startup.
+ */
+void InitMagHeading(void);
+
+/**
+ * Forgets the reference, the next samples take a new one. Called when the
+ * estimator is initialised.
+ */
+void ResetMagHeading(void);
+
+/**
+ * Checks a magnetometer sample against the reference. Called by the
+ * estimator for each sample it corrects yaw with.
+ *
+ * @param magValues calibrated magnetometer sample
+ * @param trig attitude trigonometry to tilt compensate with
+ * @return factor the yaw measurement noise is inflated with, at least 1, or
+ *         0 if the sample is disturbed and not to be fused
+ */
+RAMFUNC float32_t MagHeadingNoiseScale(const float32_t* magValues, const AttitudeTrigCacheType* trig);
+
+/**
+ * @return the declination added to the magnetic heading [rad]
+ */
+float32_t GetMagDeclination(void);
+
+void GetMagHeadingStats(MagHeadingStatsType* dstStats);
+
+/**
+ * Gets the heading parameters, for the parameter table. MAG_DECL is the
+ * declination [rad], MAG_FIELD_TOL the relative field strength tolerance and
+ * MAG_THR_NOISE the throttle gain of the noise.
+ */
+const ParamGroup_TypeDef* GetMagHeadingParamGroup(void);
+
+#endif /* INC_MAG_HEADING_H_ */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
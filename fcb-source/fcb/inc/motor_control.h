@@ -13,14 +13,27 @@
 
 #include "communication.h"
 #include "flight_control.h"
+#include "control_executive.h"
+#include "airframe.h"
 
 #include "arm_math.h"
+#include "ram_func.h"
+#include "fcb_retval.h"
 
 /* Exported types ------------------------------------------------------------*/
 typedef enum {
 	MOTORCTRL_ERROR = 0, MOTORCTRL_OK = !MOTORCTRL_ERROR
 } MotorControlErrorStatus;
 
+/* Pulse widths of the analog protocols, as stored in flash. The ESC:s are calibrated to the min and max pulses, see
+ * motor_test.h. A motor value of 0 gives the idle pulse and UINT16_MAX the max pulse, the ESC:s of the bench tests
+ * that are to stay stopped get the min pulse. DShot has fixed digital throttle values and does not use them. */
+typedef struct EscOutputs {
+	uint16_t minPulse;                          // [us] ESC low endpoint, the motor stopped
+	uint16_t idlePulse;                         // [us] motor value 0
+	uint16_t maxPulse;                          // [us] ESC high endpoint, motor value UINT16_MAX
+} EscOutputsType;
+
 /* Exported constants --------------------------------------------------------*/
 /* Exported macro ------------------------------------------------------------*/
 
@@ -38,48 +51,127 @@ typedef enum {
 #define MOTOR_GPIO_PIN_CHANNEL3                 GPIO_PIN_14
 #define MOTOR_GPIO_PIN_CHANNEL4                 GPIO_PIN_15
 
+/* Number of motor outputs, i.e. TIM_MOTOR channels */
+#define MOTOR_OUTPUT_CHANNELS                   4
+#define MOTOR_ALL_MASK                          ((1 << MOTOR_OUTPUT_CHANNELS) - 1) // Bit 0 for motor 1 and so on
+
 /* Defines to enumerate motors */
 #define MOTOR1_CHANNEL                          TIM_CHANNEL_1
 #define MOTOR2_CHANNEL                          TIM_CHANNEL_2
 #define MOTOR3_CHANNEL                          TIM_CHANNEL_3
 #define MOTOR4_CHANNEL                          TIM_CHANNEL_4
 
-/* Defines Motor TIM Timebase
- * 60000 ticks on a 24MHz clock yields a 400 MHz PWM frequency */
-#define MOTOR_OUTPUT_COUNTER_CLOCK              24000000
-#define MOTOR_OUTPUT_PERIOD                     60000
+/* Motor output protocols */
+#define MOTOR_PROTOCOL_PWM                      0   // 1-2 ms pulses, one per motor update
+#define MOTOR_PROTOCOL_ONESHOT125               1   // 125-250 us pulses, one per motor update
+#define MOTOR_PROTOCOL_DSHOT300                 2   // 16 bit digital frames at 300 kbit/s, one per motor update
+#define MOTOR_PROTOCOL_DSHOT600                 3   // 16 bit digital frames at 600 kbit/s, one per motor update
 
-#define ESC_MAX_OUTPUT                          48000 // 2.0 ms pulse
-#define ESC_MIN_OUTPUT                          24000 // 1.0 ms pulse
+/* Selects the protocol the ESC:s are configured for */
+#define MOTOR_OUTPUT_PROTOCOL                   MOTOR_PROTOCOL_PWM
 
-/* Data fitting variables to map physical outputs to motor control values
- * Thrust T(m) = AT*m + BT 		[Unit: N] [t_out unit in seconds]
- * Draq torque Q(m) = AQ*m + BQ	[Unit: Nm]
- */
-#define R_PROP			0.1397		// Propeller radius [m]
-#define AT 			0.0001768
-#define BT 			0.0
-#define AQ			0.000001748	// This was calculated based on aerodynamic rotor equations
-// #define BQ			0.0
-
-/* Physical control allocation constants */
-#define THRUST_ALLOC_COEFF		1/(4*AT)
-#define THRUST_ALLOC_OFFSET		-BT/AT
-#define ROLLPITCH_ALLOC_COEFF		1*M_SQRT2/(4*AT*LENGTH_ARM)
-#define	YAW_ALLOC_COEFF			1/(4*AQ)
+#define MOTOR_OUTPUT_IS_DSHOT                   (MOTOR_OUTPUT_PROTOCOL == MOTOR_PROTOCOL_DSHOT300 \
+                                                || MOTOR_OUTPUT_PROTOCOL == MOTOR_PROTOCOL_DSHOT600)
+
+/* Uncomment for bidirectional DShot, where the ESC:s answer each frame with their eRPM on the same line. The frames
+ * are then sent inverted, which is what switches the ESC:s to the bidirectional mode, see MotorDshotDmaIRQHandler().
+ * Needs ESC firmware that supports it, e.g. BLHeli_32 or Bluejay. */
+//#define MOTOR_DSHOT_BIDIRECTIONAL
+
+#if defined(MOTOR_DSHOT_BIDIRECTIONAL) && !MOTOR_OUTPUT_IS_DSHOT
+#error "MOTOR_DSHOT_BIDIRECTIONAL needs a DShot MOTOR_OUTPUT_PROTOCOL"
+#endif
+
+/* Defines Motor TIM Timebase
+ * PWM and OneShot125 run the timer in one pulse mode, each motor update starts one period. The pulse is placed at the
+ * end of the period (PWM mode 2) so that the output is low when the counter stops, and so that every pulse ends, i.e.
+ * is read by the ESC, a fixed time after the update. 50400 ticks on a 24MHz clock yields a 2.1 ms period. */
+#define MOTOR_OUTPUT_COUNTER_CLOCK              24000000
+#define MOTOR_OUTPUT_PERIOD                     50400
+
+#define ESC_MAX_OUTPUT                          48000 // 2.0 ms pulse, the default max pulse of EscOutputsType
+#define ESC_MIN_OUTPUT                          24000 // 1.0 ms pulse, the default min and idle pulses
+
+/* Timer ticks of the analog pulses */
+#define MOTOR_TICKS_PER_US                      (MOTOR_OUTPUT_COUNTER_CLOCK/1000000)
+
+#define ONESHOT125_OUTPUT_PERIOD                6240  // 260 us
+#define ONESHOT125_MAX_OUTPUT                   6000  // 250 us pulse
+#define ONESHOT125_MIN_OUTPUT                   3000  // 125 us pulse
+
+/* DShot runs the timer at the bit rate, and the CC1 DMA request of each bit bursts the next bit's compare values into
+ * CCR1-4 through the DMAR register. TIM4_UP would be the natural request but shares DMA1 channel 7 with UART TX. */
+#if (MOTOR_OUTPUT_PROTOCOL == MOTOR_PROTOCOL_DSHOT600)
+#define DSHOT_BIT_PERIOD                        40    // 1.67 us
+#else
+#define DSHOT_BIT_PERIOD                        80    // 3.33 us
+#endif
+#define DSHOT_BIT_1                             (DSHOT_BIT_PERIOD*3/4)
+#define DSHOT_BIT_0                             (DSHOT_BIT_PERIOD*3/8)
+#define DSHOT_FRAME_BITS                        16
+#define DSHOT_FRAME_SLOTS                       (DSHOT_FRAME_BITS + 2) // Two low bit periods end the frame
+#define DSHOT_MIN_THROTTLE                      48    // Values below are commands, 0 = motor stop
+#define DSHOT_MAX_THROTTLE                      2047
+
+#define MOTOR_DSHOT_DMA_CLK_ENABLE()            __DMA1_CLK_ENABLE()
+#define MOTOR_DSHOT_DMA_CHANNEL                 DMA1_Channel1 // TIM4_CH1 request
+#define MOTOR_DSHOT_DMA_ID                      TIM_DMA_ID_CC1
+#define MOTOR_DSHOT_DMA_REQUEST                 TIM_DMA_CC1
+
+/* Bidirectional DShot answers with 21 GCR coded bits at 5/4 of the frame bit rate, some 30 us after the frame. The
+ * interrupt at the end of the frame turns the pins to inputs and the same timer and DMA channel then sample the whole
+ * motor port, four samples per answer bit, which are decoded before the next frame. */
+#define DSHOT_TELEMETRY_BIT_PERIOD              (DSHOT_BIT_PERIOD*4/5)
+#define DSHOT_TELEMETRY_SAMPLE_PERIOD           (DSHOT_TELEMETRY_BIT_PERIOD/4)
+#define DSHOT_TELEMETRY_WINDOW                  2880  // 120 us from the end of the frame
+#define DSHOT_TELEMETRY_SAMPLES                 (DSHOT_TELEMETRY_WINDOW/DSHOT_TELEMETRY_SAMPLE_PERIOD)
+#define DSHOT_TELEMETRY_BITS                    21    // Start bit and 4 GCR coded nibbles
+#define DSHOT_TELEMETRY_MAX_ERRORS              10    // Answers in a row a motor can miss before its eRPM is stale
+
+#define MOTOR_DSHOT_DMA_IRQn                    DMA1_Channel1_IRQn
+#define MOTOR_DSHOT_DMA_IRQHandler              DMA1_Channel1_IRQHandler
+#define MOTOR_DSHOT_DMA_IRQ_PREEMPT_PRIO        0     // Releases the lines before the ESC:s answer, no RTOS API
+#define MOTOR_DSHOT_DMA_IRQ_SUB_PRIO            0
+
+/* Magnet poles of the motors, for the rotation rate from the eRPM */
+#define MOTOR_POLES                             14
+
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+/* Motor rotation rates from the bidirectional DShot answers */
+typedef struct MotorTelemetry {
+	uint32_t sequence;                          // Counts the decoded frames
+	bool isValid[MOTOR_OUTPUT_CHANNELS];        // Answered within DSHOT_TELEMETRY_MAX_ERRORS frames
+	uint32_t eRpm[MOTOR_OUTPUT_CHANNELS];       // Electrical rpm, 0 when stopped
+	float32_t rotationHz[MOTOR_OUTPUT_CHANNELS]; // Mechanical rotation rate [Hz]
+} MotorTelemetryType;
+#endif
 
 /* Exported functions ------------------------------------------------------- */
 void MotorControlConfig(void);
 void SetMotors(uint16_t ctrlValMotor1, uint16_t ctrlValMotor2, uint16_t ctrlValMotor3, uint16_t ctrlValMotor4);
 void MotorAllocationRaw(void);
-void MotorAllocationPhysical(const float u1, const float u2, const float u3, const float u4);
+RAMFUNC void MotorAllocationPhysical(const float u1, const float u2, const float u3, const float u4,
+		float32_t achievedMoments[3]);
+#ifdef FCB_CONTROL_EXECUTIVE
+RAMFUNC void MotorAllocationPhysicalFromISR(const float u1, const float u2, const float u3, const float u4,
+		float32_t achievedMoments[3]);
+#endif
 void ShutdownMotors(void);
+void SetBenchMotors(const uint16_t ctrlVal[MOTOR_OUTPUT_CHANNELS], const uint8_t stopMask);
+
+FcbRetValType SetEscOutputs(const EscOutputsType* outputs);
+void GetEscOutputs(EscOutputsType* outputs);
+FcbRetValType SaveEscOutputs(void);
 
-MotorControlErrorStatus StartMotorControlSamplingTask(const uint16_t sampleTime, const uint32_t sampleDuration);
-MotorControlErrorStatus StopMotorControlSamplingTask(void);
 void PrintMotorControlValues(void);
 uint16_t GetMotorValue(uint8_t motorNumber);
 
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+void MotorDshotDmaIRQHandler(void);
+bool GetMotorTelemetry(MotorTelemetryType* dstTelemetry, const uint32_t lastSequence);
+size_t PrintMotorTelemetry(char* dst, const size_t dstSize);
+#endif
+
 #endif /* __MOTOR_CONTROL_H */
 
 /**
@@ -0,0 +1,158 @@
+/******************************************************************************
+ * @file    motor_failure.h
+ * @brief   Header file for the motor failure detection, which keeps a UAV that
+ *          has lost a motor, e.g. to a stuck or desynced ESC, upright instead
+ *          of letting the full mixer flip it. A failure is detected in the
+ *          stabilized flight modes on every control cycle from:
+ *          - the moment residual: the roll & pitch angular acceleration of
+ *            the gyroscope times the moments of inertia, less the commanded
+ *            moments. A lost motor leaves a residual along the moment it was
+ *            commanded to give, so the failed motor is the one whose moment
+ *            the residual best matches, once at least the residual share of
+ *            it has been missing for the detection time
+ *          - the ESC telemetry, with MOTOR_ESC_TELEMETRY: an ESC that reports
+ *            a desync
+ *          - the motor rotation rates, with MOTOR_DSHOT_BIDIRECTIONAL: a motor
+ *            commanded at least MOTOR_FAILURE_MIN_COMMAND that turns slower
+ *            than MOTOR_FAILURE_MIN_ERPM for MOTOR_FAILURE_STOPPED_TIME
+ *
+ *          The residual is low passed with MOTOR_FAILURE_FILTER_TIME, the same
+ *          for the acceleration and the commands so that the control delay
+ *          largely cancels, and the slow trim of a center of gravity offset is
+ *          taken out with MOTOR_FAILURE_TRIM_TIME.
+ *
+ *          On a failure the mixer leaves the failed motor at idle and gives up
+ *          the yaw to keep the roll & pitch with the remaining motors, see
+ *          MotorMixerSetFailedMotor(), so the UAV spins about its yaw axis.
+ *          The references are limited for a controlled descent, see
+ *          LimitMotorFailureRefSignals(). The failure is logged with a
+ *          blackbox event frame and the detection is latched, also against
+ *          the ESC faults that would otherwise send the flight mode to
+ *          failsafe, until the UAV is disarmed.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_MOTOR_FAILURE_H_
+#define INC_MOTOR_FAILURE_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include "arm_math.h"
+#include "flight_control.h"
+#include "fcb_retval.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Uncomment to fly on with the remaining motors in a degraded mode when a motor fails, see above */
+//#define FCB_MOTOR_FAILURE_DETECTION
+
+/* Exported types ------------------------------------------------------------*/
+
+typedef enum {
+    MOTOR_FAILURE_CAUSE_NONE = 0,
+    MOTOR_FAILURE_CAUSE_RESIDUAL,   // The moment residual
+    MOTOR_FAILURE_CAUSE_DESYNC,     // The ESC telemetry
+    MOTOR_FAILURE_CAUSE_STOPPED,    // The motor rotation rate
+    MOTOR_FAILURE_CAUSE_NBR
+} MotorFailureCauseType;
+
+/* Motor failure detection settings as stored in flash */
+typedef struct {
+    float32_t detectionTime;        // [s] the residual of a motor lasts, 0 turns the residual detection off
+    float32_t residualShare;        // Part of the commanded moment of a motor the residual has to reach
+} MotorFailureSettingsType;
+
+typedef struct {
+    bool isFailed;                  // Latched until disarmed
+    bool isDegraded;                // The mixer gives up the yaw, false if it could not
+    uint8_t motor;                  // Index from 0 of the latest failed motor
+    MotorFailureCauseType cause;    // Of the latest failure since startup
+    uint8_t flags;                  // MOTOR_FAILURE_FLAG_* of the latest control cycle
+    uint32_t failures;              // Since startup
+    uint32_t timestamp;             // Of the latest failure [ms]
+    float32_t residual[2];          // Roll & pitch moment residual of the latest control cycle [Nm]
+} MotorFailureStatusType;
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Conditions of a control cycle, as logged to the blackbox. The failed motor number, from 1, is in the upper four
+ * bits while the failure is latched. */
+#define MOTOR_FAILURE_FLAG_RESIDUAL         0x01    // The residual matches a motor
+#define MOTOR_FAILURE_FLAG_TELEMETRY        0x02    // A desync or a stopped motor
+#define MOTOR_FAILURE_FLAG_DETECTED         0x08    // The latch
+
+#define MOTOR_FAILURE_FILTER_TIME           ((float32_t) 0.02)      // [s] low pass time constant of the residual
+#define MOTOR_FAILURE_TRIM_TIME             ((float32_t) 2.0)       // [s] time constant of the trim
+#define MOTOR_FAILURE_MIN_COMMAND           (UINT16_MAX/5)          // Of a motor to be detected as failed
+#define MOTOR_FAILURE_MIN_ERPM              1000
+#define MOTOR_FAILURE_STOPPED_TIME          ((float32_t) 0.3)       // [s]
+#define MOTOR_FAILURE_MAX_TIME              ((float32_t) 2.0)       // [s] of the detection time
+
+/* References of the degraded mode, Z points down */
+#define MOTOR_FAILURE_DESCENT_VELOCITY      ((float32_t) 1.0)       // [m/s], the least descent
+#define MOTOR_FAILURE_MAX_TILT              ((float32_t) 15*PI/180) // [rad] of the roll & pitch references
+
+#define MOTOR_FAILURE_DEFAULT_DETECTION_TIME    ((float32_t) 0.1)
+#define MOTOR_FAILURE_DEFAULT_RESIDUAL_SHARE    ((float32_t) 0.5)
+
+/* Exported functions ------------------------------------------------------- */
+
+/**
+ * Loads the settings from flash, or the defaults if there are none. Called by
+ * the flight control task at startup.
+ */
+void InitMotorFailureDetection(void);
+
+/**
+ * Evaluates the moment residual and the telemetry of the latest control
+ * cycle, latches a failure and switches the mixer to the degraded mode.
+ * Releases the latch and the mixer in the disarmed state. Called by the flight
+ * control task on every control cycle, before the flight mode update.
+ *
+ * @return true on the control cycle a failure is detected
+ */
+bool UpdateMotorFailureDetection(void);
+
+/**
+ * @return true from a detected failure until the UAV is disarmed
+ */
+bool IsMotorFailureDetected(void);
+
+/**
+ * Limits the references of the stabilized flight modes while a failure is
+ * latched: the descent to at least MOTOR_FAILURE_DESCENT_VELOCITY, the roll &
+ * pitch to MOTOR_FAILURE_MAX_TILT and the yaw rate to zero, the yaw is not
+ * controlled anyway.
+ *
+ * @param refSignals references to limit
+ * @return true if limited, i.e. a failure is latched
+ */
+bool LimitMotorFailureRefSignals(RefSignals_TypeDef* refSignals);
+
+/**
+ * Sets the settings, effective from the next control cycle.
+ *
+ * @param settings see MotorFailureSettingsType
+ * @return FCB_OK, FCB_ERR if the time or the share is out of range
+ */
+FcbRetValType SetMotorFailureSettings(const MotorFailureSettingsType* settings);
+void GetMotorFailureSettings(MotorFailureSettingsType* settings);
+FcbRetValType SaveMotorFailureSettings(void);
+
+void GetMotorFailureStatus(MotorFailureStatusType* dstStatus);
+const char* GetMotorFailureCauseName(const MotorFailureCauseType cause);
+size_t PrintMotorFailure(char* dst, const size_t dstSize);
+
+#endif /* INC_MOTOR_FAILURE_H_ */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
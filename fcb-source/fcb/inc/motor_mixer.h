@@ -0,0 +1,103 @@
+/******************************************************************************
+ * @file    motor_mixer.h
+ * @brief   Header file for the motor mixer, which maps thrust and roll, pitch &
+ *          yaw commands to motor signal values with a configurable matrix,
+ *          within per motor command limits and with a configurable priority
+ *          of the commands
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_MOTOR_MIXER_H_
+#define INC_MOTOR_MIXER_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include "arm_math.h"
+#include "airframe.h"
+#include "fcb_retval.h"
+#include "ram_func.h"
+
+/* Exported constants --------------------------------------------------------*/
+
+/* The mixer always computes this many motors, so that it runs in fixed time */
+#define MIXER_MAX_MOTORS        8
+
+/* Motor signal value range, see SetMotors() */
+#define MIXER_MOTOR_SIGNAL_MAX  ((float32_t) UINT16_MAX)
+
+/* Failed motor of MotorMixerSetFailedMotor() when all motors are mixed */
+#define MIXER_NO_FAILED_MOTOR   0xFF
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Order in which the commands get the motor range when it does not fit them all, see MotorMixerAllocation_TypeDef */
+typedef enum {
+    MIXER_PRIORITY_ROLLPITCH_YAW_THRUST = 0,    // Roll & pitch, then yaw in what is left, then the collective thrust
+    MIXER_PRIORITY_ATTITUDE_THRUST,             // Roll, pitch & yaw scaled together, then the collective thrust
+    MIXER_PRIORITY_NBR
+} MixerPriority_TypeDef;
+
+/* Mixer matrix columns */
+typedef enum {
+    MIXER_THRUST_IDX = 0,
+    MIXER_ROLL_IDX,
+    MIXER_PITCH_IDX,
+    MIXER_YAW_IDX,
+    MIXER_AXES_NBR
+} MixerAxisIndex_TypeDef;
+
+/* Predefined motor layouts, see airframe.h */
+typedef enum {
+    MIXER_QUAD_X = AIRFRAME_QUAD_X,
+    MIXER_QUAD_PLUS = AIRFRAME_QUAD_PLUS,
+    MIXER_HEX_X = AIRFRAME_HEX_X,
+    MIXER_OCTO_X = AIRFRAME_OCTO_X,
+    MIXER_GEOMETRY_NBR
+} MixerGeometry_TypeDef;
+
+/* Mixer settings as stored in flash */
+typedef struct {
+    uint32_t nbrOfMotors;
+    uint32_t airmode;   // 1 to raise the thrust at low throttle to keep attitude authority, 0 to only lower it at high throttle
+    /* Per motor factors: thrust share, roll & pitch = lateral & longitudinal motor position in arm lengths (positive
+     * to the left & to the front, i.e. the side that has to push more for a positive moment), yaw = +1/-1 depending
+     * on the rotation direction */
+    float32_t factors[MIXER_MAX_MOTORS][MIXER_AXES_NBR];
+} MotorMixerSettings_TypeDef;
+
+/* Allocation settings as stored in flash. The command limits are fractions of the linear motor command range, i.e. of
+ * the thrust of the motor fit, before the thrust curves of thrust_curve.h. */
+typedef struct {
+    uint32_t priority;                          // See MixerPriority_TypeDef
+    float32_t minCommand[MIXER_MAX_MOTORS];     // [0, 1), also holds at zero throttle
+    float32_t maxCommand[MIXER_MAX_MOTORS];     // (minCommand, 1]
+} MotorMixerAllocation_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+void MotorMixerInit(void);
+FcbRetValType MotorMixerConfig(const MixerGeometry_TypeDef geometry, const uint8_t airmode);
+FcbRetValType MotorMixerSetAirmode(const uint8_t airmode);
+void MotorMixerGetSettings(MotorMixerSettings_TypeDef* dstSettings);
+uint8_t MotorMixerGetNbrOfMotors(void);
+FcbRetValType MotorMixerSetFailedMotor(const uint8_t motor);
+uint8_t MotorMixerGetFailedMotor(void);
+FcbRetValType MotorMixerSetAllocation(const MotorMixerAllocation_TypeDef* allocation);
+void MotorMixerGetAllocation(MotorMixerAllocation_TypeDef* dstAllocation);
+FcbRetValType MotorMixerSaveAllocation(void);
+RAMFUNC void MotorMixerPhysical(const float32_t u[MIXER_AXES_NBR], int32_t motorValues[MIXER_MAX_MOTORS],
+        float32_t achieved[MIXER_AXES_NBR]);
+void MotorMixerRaw(const float32_t u[MIXER_AXES_NBR], int32_t motorValues[MIXER_MAX_MOTORS]);
+
+#endif /* INC_MOTOR_MIXER_H_ */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,139 @@
+/******************************************************************************
+ * @file    motor_test.h
+ * @brief   Header file for the bench motor test and the ESC endpoint
+ *          calibration. The motor test spins one motor at a fixed output for
+ *          a given duration, the others stopped. The ESC calibration outputs
+ *          the max pulse of EscOutputsType to all motors, for the ESC:s to
+ *          learn as their high endpoint when their battery is connected, and
+ *          then on the next step the min pulse as their low endpoint. It
+ *          applies to the analog protocols only, DShot ESC:s have fixed
+ *          throttle values.
+ *
+ *          Both are interlocked. They run in idle mode only, while the CLI or
+ *          the RPC host is connected over USB, and after a props-off
+ *          confirmation with UnlockMotorTest(). The unlock expires after
+ *          MOTOR_TEST_UNLOCK_TIMEOUT without a test, and is dropped by a
+ *          flight mode transition or a USB disconnect, which also stop a
+ *          running test. Every test and calibration step has a timeout of
+ *          its own, after which the motors are stopped.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_MOTOR_TEST_H_
+#define INC_MOTOR_TEST_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include "arm_math.h"
+#include "motor_control.h"
+#include "fcb_retval.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported types ------------------------------------------------------------*/
+
+typedef enum {
+    MOTOR_TEST_LOCKED = 0,
+    MOTOR_TEST_UNLOCKED,            // Props-off confirmed, the motors stopped
+    MOTOR_TEST_SPINNING,            // One motor at the test output
+    MOTOR_TEST_ESC_CALIBRATION_HIGH, // All motors at the max pulse, the ESC battery to be connected
+    MOTOR_TEST_ESC_CALIBRATION_LOW, // All motors at the min pulse
+    MOTOR_TEST_STATE_NBR
+} MotorTestStateType;
+
+typedef struct {
+    MotorTestStateType state;
+    uint8_t motor;                  // Motor index of MOTOR_TEST_SPINNING, 0 for motor 1
+    float32_t output;               // Of MOTOR_TEST_SPINNING, in [0, 1]
+    uint32_t remaining;             // [ms] until the unlock expires or the test or calibration step times out
+} MotorTestStatusType;
+
+/* Exported constants --------------------------------------------------------*/
+
+#define MOTOR_TEST_UNLOCK_PHRASE        "props-off"
+#define MOTOR_TEST_UNLOCK_TIMEOUT       60000   // [ms] of the unlock without a test
+#define MOTOR_TEST_MAX_OUTPUT           ((float32_t) 1.0)
+#define MOTOR_TEST_MAX_DURATION         10000   // [ms]
+#define ESC_CALIBRATION_HIGH_TIMEOUT    30000   // [ms] to connect the ESC battery and wait for the high endpoint tones
+#define ESC_CALIBRATION_LOW_TIMEOUT     10000   // [ms] of the low endpoint, after which the calibration ends
+
+/* Exported functions ------------------------------------------------------- */
+
+/**
+ * Unlocks the motor test and the ESC calibration for
+ * MOTOR_TEST_UNLOCK_TIMEOUT, which every test and calibration step renews.
+ *
+ * @param confirmation MOTOR_TEST_UNLOCK_PHRASE, not null terminated
+ * @param length of the confirmation
+ * @return FCB_OK, FCB_ERR if the confirmation does not match, not in idle
+ *         mode or USB is not connected
+ */
+FcbRetValType UnlockMotorTest(const char* confirmation, const size_t length);
+
+/**
+ * Stops a running test or calibration and locks the motor test.
+ */
+void LockMotorTest(void);
+
+/**
+ * Spins one motor at a fixed output, the others stopped. A running test is
+ * replaced, a running ESC calibration aborted.
+ *
+ * @param motor motor index, 0 for motor 1
+ * @param output in [0, MOTOR_TEST_MAX_OUTPUT]
+ * @param duration [ms] in (0, MOTOR_TEST_MAX_DURATION]
+ * @return FCB_OK, FCB_ERR if locked, an interlock does not hold or if the
+ *         motor, the output or the duration is not valid
+ */
+FcbRetValType StartMotorTest(const uint8_t motor, const float32_t output, const uint16_t duration);
+
+/**
+ * Stops a running test or aborts a running calibration, the motor test stays
+ * unlocked.
+ */
+void StopMotorTest(void);
+
+/**
+ * Starts the ESC calibration with the max pulse on all motors. A running
+ * test is stopped.
+ *
+ * @return FCB_OK, FCB_ERR if locked, an interlock does not hold or the motor
+ *         output protocol is DShot
+ */
+FcbRetValType StartEscCalibration(void);
+
+/**
+ * Steps the ESC calibration from the max pulse to the min pulse, and from
+ * the min pulse to its end.
+ *
+ * @return FCB_OK, FCB_ERR if no calibration is running or an interlock does
+ *         not hold
+ */
+FcbRetValType NextEscCalibrationStep(void);
+
+/**
+ * Checks the interlocks and the timeouts, and sets the motor outputs of a
+ * running test or calibration. Called by the flight control task in idle
+ * mode, instead of stopping the motors.
+ *
+ * @return true if a test or calibration is running, false if the motors are
+ *         to be stopped
+ */
+bool UpdateMotorTest(void);
+
+void GetMotorTestStatus(MotorTestStatusType* dstStatus);
+size_t PrintMotorTestStatus(char* dst, const size_t dstSize);
+
+#endif /* INC_MOTOR_TEST_H_ */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
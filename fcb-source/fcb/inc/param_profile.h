@@ -0,0 +1,104 @@
+/******************************************************************************
+ * @file    param_profile.h
+ * @brief   Header file for the switchable parameter profiles. A profile holds
+ *          a complete tuning: the PID gains, the reference limits, the stick
+ *          curves, the gyro filter and the mixer airmode, so that e.g. a
+ *          smooth and an aggressive tuning can be swapped without
+ *          reconfiguring the parameters one by one.
+ *
+ *          A profile is saved from the current values in idle mode, to a slot
+ *          of the profiles page in flash. Selecting a profile applies it to
+ *          the current values without storing them, in any flight mode. Its
+ *          coefficients, lookup tables and filter coefficients are computed by
+ *          the selecting task and then swapped in under the scheduler lock or
+ *          a critical section, so the control cycles in between run on the old
+ *          or the new values of each part. The gyro filter state is kept, so
+ *          the filtered rates stay continuous over a switch in flight.
+ *
+ *          The stored settings stay the base settings, which are the ones in
+ *          use at startup. The gyro filter frequencies are only known for a
+ *          filter configured since startup, a profile saved without them keeps
+ *          the gyro filter in use when selected.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_PARAM_PROFILE_H_
+#define INC_PARAM_PROFILE_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include "arm_math.h"
+#include "pid_control.h"
+#include "flight_control.h"
+#include "stick_curves.h"
+#include "fcb_sensor_filter.h"
+#include "fcb_retval.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Parameter profile as stored in flash */
+typedef struct {
+    PIDGainSettings_TypeDef pidGains;
+    RefSignals_TypeDef referenceMaxLimits;  // The yaw angle limit is fixed
+    StickCurveSettingsType stickCurves;
+    uint32_t isGyroFilterSet;       // 1 if gyroFilter holds the gyro filter, 0 to keep the one in use
+    FcbSensorFilterConfigType gyroFilter;
+    uint32_t airmode;               // See MotorMixerSettings_TypeDef
+} ParamProfileType;
+
+/* Exported constants --------------------------------------------------------*/
+
+#define PARAM_PROFILE_NBR               3
+#define PARAM_PROFILE_NONE              (-1)    // Active profile of the base settings
+
+/* Exported functions ------------------------------------------------------- */
+
+/**
+ * Loads the saved profiles from flash. Called by the flight control task at
+ * startup, after the base settings are loaded.
+ */
+void InitParamProfiles(void);
+
+/**
+ * Applies a saved profile to the current values, without storing them.
+ *
+ * @param profileIdx profile index, below PARAM_PROFILE_NBR
+ * @return FCB_OK, FCB_ERR if the index is not valid, the profile is not saved
+ *         or a value of it is not valid
+ */
+FcbRetValType SelectParamProfile(const uint8_t profileIdx);
+
+/**
+ * Saves the current values to a profile, idle mode only. The profile becomes
+ * the active one.
+ *
+ * @param profileIdx profile index, below PARAM_PROFILE_NBR
+ * @return FCB_OK, FCB_ERR if the index is not valid, not in idle mode or if
+ *         writing the flash failed
+ */
+FcbRetValType SaveParamProfile(const uint8_t profileIdx);
+
+/**
+ * @return the index of the profile selected or saved last, which may have
+ *         been changed since, or PARAM_PROFILE_NONE for the base settings
+ */
+int8_t GetActiveParamProfile(void);
+
+bool IsParamProfileSaved(const uint8_t profileIdx);
+size_t PrintParamProfiles(char* dst, const size_t dstSize);
+
+#endif /* INC_PARAM_PROFILE_H_ */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
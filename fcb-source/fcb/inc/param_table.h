@@ -0,0 +1,88 @@
+/******************************************************************************
+ * @file    param_table.h
+ * @brief   Header file for the parameter table, which registers the tunable
+ *          parameters of the subsystems by name, ID, type and range, so that
+ *          ground tools read and write all of them in one message and save
+ *          them to flash in one page write
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_PARAM_TABLE_H_
+#define INC_PARAM_TABLE_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include "arm_math.h"
+#include "fcb_retval.h"
+#include "pb_encode.h"
+
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Parameter names are at most this long, so that they also fit a MAVLink param id */
+#define PARAM_NAME_LEN                  16
+
+/* The whole table is sent and received in one message, its size is kept within the RPC request and response limits */
+#define PARAM_MAX_NBR                   52
+
+/* The PARAM_TABLE_MSG_ENUM message, encoded without generated nanopb code:
+ *   message ParamTableProto {
+ *     optional uint32 first_id = 1;                // ID of the first value
+ *     repeated float values = 2 [packed = true];   // Consecutive parameters from first_id on
+ *   }
+ * The FCB sends the whole table from ID 0. Integer parameters are exact in the float values. */
+
+/* Worst case size of the message: the first_id tag and varint, the values tag, length varint and floats */
+#define PARAM_TABLE_MSG_MAX_SIZE        (1 + 2 + 1 + 2 + 4*PARAM_MAX_NBR)
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+    PARAM_TYPE_FLOAT = 0,
+    PARAM_TYPE_UINT16
+} ParamType;
+
+/* A parameter, with the live storage the subsystem uses it from */
+typedef struct {
+    const char* name;
+    ParamType type;
+    volatile void* value;       // float32_t or uint16_t, as the type
+    float32_t min;
+    float32_t max;
+} Param_TypeDef;
+
+/* The parameters of a subsystem. The apply function, if any, is called with the scheduler suspended after values of
+ * the group have been written, the save function, if any, writes the current values to flash. */
+typedef struct {
+    const Param_TypeDef* params;
+    uint8_t nbrOfParams;
+    void (*apply)(void);
+    FcbRetValType (*save)(void);
+} ParamGroup_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+void InitParamTable(void);
+uint16_t GetNbrOfParams(void);
+const Param_TypeDef* GetParam(const uint16_t id);
+int16_t FindParamId(const char* name, const size_t nameLength);
+FcbRetValType GetParamValue(const uint16_t id, float32_t* value);
+FcbRetValType SetParamValue(const uint16_t id, const float32_t value);
+FcbRetValType SetParamValues(const uint16_t firstId, const float32_t* values, const uint16_t nbrOfValues);
+FcbRetValType SaveParams(void);
+bool EncodeParamTable(pb_ostream_t* stream);
+FcbRetValType DecodeParamTable(const uint8_t* msg, const uint16_t msgSize, uint16_t* firstId, float32_t* values,
+        uint16_t* nbrOfValues);
+
+#endif /* INC_PARAM_TABLE_H_ */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,141 @@
+/******************************************************************************
+ * @file    pid_autotune.h
+ * @brief   Header file for the relay feedback autotuning (Astrom-Hagglund) of
+ *          the moment controllers, i.e. the rate loops in cascaded mode and
+ *          the angle and yaw rate loops otherwise. An autotune is started on
+ *          one axis from the CLI and runs in the attitude flight mode,
+ *          supervised by the pilot: while the sticks are centred and the
+ *          attitude is within AUTOTUNE_MAX_ANGLE, a relay of
+ *          +/-AUTOTUNE_RELAY_OUTPUT of the axis moment range replaces the
+ *          output of the controller of that axis, and the other axes stay
+ *          stabilised. Stick input, a larger attitude or another flight mode
+ *          hand the axis back to its controller until the conditions hold
+ *          again, a mode switch is the pilot's way out.
+ *
+ *          The relay drives the axis into a limit cycle, whose amplitude a and
+ *          period Tu give the ultimate gain Ku = 4*d/(pi*sqrt(a^2 - e^2)) of
+ *          the relay output d and hysteresis e. The Ziegler-Nichols rules
+ *          then give K = 0.6*Ku, Ti = Tu/2 and Td = Tu/8, in the form of
+ *          PID_USE_CLASSIC_FORM or PID_USE_PARALLEL_FORM. The proposal is kept
+ *          pending until it is accepted, which sets the gains of the
+ *          controller, or discarded. The gains are not saved to flash by the
+ *          autotune, see save-pid-gains.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_PID_AUTOTUNE_H_
+#define INC_PID_AUTOTUNE_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include "arm_math.h"
+#include "pid_control.h"
+#include "fcb_retval.h"
+#include "ram_func.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Uncomment to run the relay feedback autotuning in the attitude flight mode, see above */
+//#define PID_AUTOTUNE
+
+/* Exported types ------------------------------------------------------------*/
+
+typedef enum {
+    AUTOTUNE_AXIS_ROLL = 0,
+    AUTOTUNE_AXIS_PITCH,
+    AUTOTUNE_AXIS_YAW,
+    AUTOTUNE_AXIS_NBR
+} AutotuneAxisType;
+
+typedef enum {
+    AUTOTUNE_OFF = 0,
+    AUTOTUNE_WAITING,               // Started, the relay is engaged in the attitude mode with the sticks centred
+    AUTOTUNE_RELAY,                 // The relay drives the axis
+    AUTOTUNE_PROPOSED,              // A proposal is pending, to be accepted or discarded
+    AUTOTUNE_FAILED                 // No limit cycle within AUTOTUNE_TIMEOUT
+} AutotuneStateType;
+
+typedef struct {
+    AutotuneStateType state;
+    AutotuneAxisType axis;
+    PIDControllerIndex_TypeDef controller; // Of the axis
+    uint8_t cycles;                 // Limit cycles measured
+    uint32_t interruptions;         // Times the pilot or the attitude limit took the axis back
+    float32_t amplitude;            // Of the control error limit cycle, in the unit of the controller input
+    float32_t period;               // Tu [s]
+    float32_t ultimateGain;         // Ku, in the unit of the controller gain K
+    PIDGains_TypeDef proposal;      // Valid in AUTOTUNE_PROPOSED
+} AutotuneStatusType;
+
+/* Exported constants --------------------------------------------------------*/
+
+#define AUTOTUNE_RELAY_OUTPUT           ((float32_t) 0.1)   // Relay amplitude, part of the axis moment range
+#define AUTOTUNE_RELAY_HYSTERESIS       ((float32_t) 0.02)  // Of the control error, in the unit of its input
+#define AUTOTUNE_SETTLE_CYCLES          2       // Limit cycles not measured, the relay transient
+#define AUTOTUNE_MEASURE_CYCLES         4       // Limit cycles averaged
+#define AUTOTUNE_TIMEOUT                10.0f   // [s] of relay before the limit cycles are given up
+#define AUTOTUNE_MAX_ANGLE              ((float32_t) 25*PI/180)  // Roll and pitch the relay runs within [rad]
+#define AUTOTUNE_MAX_STICK_ANGLE        ((float32_t) 2*PI/180)   // Roll and pitch references of centred sticks [rad]
+#define AUTOTUNE_MAX_STICK_RATE         ((float32_t) 5*PI/180)   // Yaw rate reference of a centred stick [rad/s]
+
+/* Exported functions ------------------------------------------------------- */
+
+/**
+ * Starts an autotune of an axis, the relay engages in the attitude flight
+ * mode with the sticks centred. A pending proposal is discarded.
+ *
+ * @param axis see AutotuneAxisType
+ * @return FCB_OK, FCB_ERR if the axis is not valid
+ */
+FcbRetValType StartAutotune(const AutotuneAxisType axis);
+void StopAutotune(void);
+
+/**
+ * Sets the proposed gains to the controller of the tuned axis, effective
+ * from the next control cycle on.
+ *
+ * @return FCB_OK, FCB_ERR if no proposal is pending or it was not set
+ */
+FcbRetValType AcceptAutotune(void);
+void DiscardAutotune(void);
+
+/**
+ * Engages and releases the relay with the flight mode, the sticks and the
+ * attitude, and evaluates the limit cycle once it has been measured. Called
+ * by the flight control task on every control cycle.
+ */
+void UpdateAutotune(void);
+
+/**
+ * @return the controller the relay replaces, PID_NBR_CONTROLLERS if none.
+ *         Uses no FreeRTOS API, for the context of the moment controllers.
+ */
+RAMFUNC PIDControllerIndex_TypeDef GetAutotuneRelayController(void);
+
+/**
+ * Updates the relay and measures the limit cycle. Called by the context of
+ * the moment controllers after the update of the controller that
+ * GetAutotuneRelayController() returns, uses no FreeRTOS API.
+ *
+ * @param error reference less state of the controller
+ * @return the output of the controller, a moment [Nm]
+ */
+RAMFUNC float32_t UpdateAutotuneRelay(const float32_t error);
+
+void GetAutotuneStatus(AutotuneStatusType* dstStatus);
+const char* GetAutotuneAxisName(const AutotuneAxisType axis);
+size_t PrintAutotuneStatus(char* dst, const size_t dstSize);
+
+#endif /* INC_PID_AUTOTUNE_H_ */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
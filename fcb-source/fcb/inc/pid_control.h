@@ -12,10 +12,19 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "arm_math.h"
+#include "airframe.h"
+#include "fcb_retval.h"
+#include "param_table.h"
+#include "ram_func.h"
+
+#include <stdbool.h>
 
 /* Exported constants --------------------------------------------------------*/
 #define PID_USE_PARALLEL_FORM
 
+/* Comment out to control the thrust directly with the receiver throttle channel instead of the Z velocity */
+#define PID_USE_VERTICAL_VELOCITY_CONTROL
+
 /* Vertical control parameters */
 #define K_VZ 				(float32_t) 2.0
 #define TI_VZ				(float32_t) 0.0
@@ -23,7 +32,22 @@
 #define BETA_VZ				(float32_t) 1.0			// Proportional set-point weighting
 #define GAMMA_VZ			(float32_t) 0.0
 #define N_VZ				(float32_t) 1000.0		// Max derivative gain
-#define MAX_THRUST			((float32_t) 4*AT*UINT16_MAX + 4*BT)	// Maximal upward thrust from all four motors combined [N]
+
+/* Altitude hold control parameters, the altitude controller sets the Z velocity reference */
+#define K_ALT				(float32_t) 1.0			// Altitude error to climb rate gain [1/s]
+#define TI_ALT				(float32_t) 0.0
+#define TD_ALT				(float32_t) 0.0
+#define BETA_ALT			(float32_t) 1.0			// Proportional set-point weighting
+#define GAMMA_ALT			(float32_t) 0.0
+#define N_ALT				(float32_t) 1000.0		// Max derivative gain
+
+/* Comment out to control the roll & pitch angles with a single PD loop per flight control update. In cascaded mode
+ * the angle loop runs on every flight control update and sets body rate references for an inner rate loop, which
+ * runs together with the motor allocation on every PID_RATE_LOOP_GYRO_DIVISOR:th gyroscope sample. With
+ * FCB_GYRO_FIFO_MODE the samples arrive in bursts, so set the divisor to GYRO_FIFO_WATERMARK there. The rate flight
+ * mode uses the inner loop only, so it requires cascaded mode. */
+#define PID_USE_CASCADED_RATE_CONTROL
+#define PID_RATE_LOOP_GYRO_DIVISOR  1
 
 /* Roll/pitch angle control parameters */
 #define K_RP				(float32_t) 16.0 //25.0
@@ -32,7 +56,18 @@
 #define BETA_RP				(float32_t) 1.0			// Proportional set-point weighting
 #define GAMMA_RP			(float32_t) 0.0
 #define N_RP				(float32_t) 1000.0		// Max derivative gain
-#define MAX_ROLLPITCH_MOM	((float32_t) MAX_THRUST/2*LENGTH_ARM/M_SQRT2)	// Two motors full thrust, two motors no thrust [Nm]
+
+/* Roll/pitch cascaded control parameters. The defaults match the single loop above, since
+ * K_RR*(K_ARP*(ref - angle) - rate) = K_RP*(ref - angle) - TD_RP*rate, but the rate is the gyroscope based estimate
+ * instead of the filtered derivative of the angle estimate. */
+#define K_ARP				((float32_t) K_RP/TD_RP)	// Outer angle loop gain [1/s]
+#define MAX_ROLLPITCH_RATE	((float32_t) 180*PI/180)	// Max rate reference from the angle loop (+/-) [rad/s]
+#define K_RR				((float32_t) TD_RP)			// Inner rate loop gain [1/s]
+#define TI_RR				(float32_t) 0.0
+#define TD_RR				(float32_t) 0.0
+#define BETA_RR				(float32_t) 1.0			// Proportional set-point weighting
+#define GAMMA_RR			(float32_t) 0.0
+#define N_RR				(float32_t) 1000.0		// Max derivative gain
 
 /* Yaw angular rate control parameters */
 #define K_YR 				(float32_t) 0.0 //2.0
@@ -41,7 +76,39 @@
 #define BETA_YR				(float32_t) 1.0			// Proportional set-point weighting
 #define GAMMA_YR			(float32_t) 0.0
 #define N_YR				(float32_t) 1000.0		// Max derivative gain
-#define MAX_YAW_MOM			((float32_t) AQ*2*UINT16_MAX)		// Two motors with same rot dir full thrust, other two motors no thrust [Nm]
+
+/* Setpoint feed-forward: the derivative of the reference, through a first order low-pass filter of time constant
+ * TFF_*, times the gain KFF_* and scaled as the control signal. With a gain of 1.0 the rate loops command the moment
+ * J*dw_ref/dt of the inertia and the Z velocity loop the force m*dvz_ref/dt, and the cascaded angle loops add the
+ * reference angle rate to the rate reference. This cuts the tracking lag without raising the feedback gains, which
+ * the gyroscope noise passes through, since only the reference is differentiated. 0 turns it off, and it has no
+ * physical meaning for the single angle loops, which set moments from an angle. */
+#define KFF_VZ				(float32_t) 0.0
+#define TFF_VZ				(float32_t) 0.05		// [s]
+#define KFF_ALT				(float32_t) 0.0
+#define TFF_ALT				(float32_t) 0.05		// [s]
+#define KFF_RP				(float32_t) 0.0
+#define TFF_RP				(float32_t) 0.02		// [s]
+#define KFF_RR				(float32_t) 0.0
+#define TFF_RR				(float32_t) 0.02		// [s]
+#define KFF_YR				(float32_t) 0.0
+#define TFF_YR				(float32_t) 0.02		// [s]
+
+/* Uncomment to schedule the gains of the moment controllers, i.e. the rate loop in cascaded mode and the angle and yaw
+ * rate loops otherwise, with the throttle and the battery voltage. A scale factor is interpolated from a breakpoint
+ * table over each, like a throttle PID attenuation (TPA), and their product multiplies the K, Ti and Td parts of the
+ * precomputed coefficients. The flight control task evaluates the tables every PID_SCHEDULE_DIVISOR:th control cycle
+ * and recomputes the coefficients only when the scale has changed by PID_SCHEDULE_MIN_CHANGE, so the control update
+ * itself is not slowed down. The battery table needs FCB_BATTERY_MONITOR, it is 1.0 without it. */
+//#define PID_USE_GAIN_SCHEDULING
+
+#define PID_SCHEDULE_BREAKPOINTS	5						// Evenly spaced over each table range
+#define PID_SCHEDULE_DIVISOR		10						// Control cycles between the schedule evaluations
+#define PID_SCHEDULE_MIN_CHANGE		(float32_t) 0.01		// Scale change that recomputes the coefficients
+#define PID_SCHEDULE_MIN_SCALE		(float32_t) 0.1
+#define PID_SCHEDULE_MAX_SCALE		(float32_t) 2.0
+#define PID_SCHEDULE_MIN_CELL_VOLTAGE	(float32_t) 3.3		// [V] of the first battery breakpoint
+#define PID_SCHEDULE_MAX_CELL_VOLTAGE	(float32_t) 4.2		// [V] of the last battery breakpoint
 
 /* Exported types ------------------------------------------------------------*/
 typedef struct
@@ -52,13 +119,99 @@ typedef struct
   float32_t yawMoment;		// [Nm]
 } CtrlSignals_TypeDef;
 
+/* PID controllers, the last ones are updated by the rate loop in cascaded mode */
+typedef enum
+{
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+  PID_ALTITUDE_IDX,			// Updated before the others in the altitude hold flight mode only
+#endif
+  PID_Z_VELOCITY_IDX,
+  PID_ROLL_ANGLE_IDX,
+  PID_PITCH_ANGLE_IDX,
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+  PID_ROLL_RATE_IDX,
+  PID_PITCH_RATE_IDX,
+#endif
+  PID_YAW_RATE_IDX,
+  PID_NBR_CONTROLLERS
+} PIDControllerIndex_TypeDef;
+
+typedef struct
+{
+  float32_t K;				// Gain
+  float32_t Ti;				// Integration time (classic form) or integral gain (parallel form), 0 for no integral action
+  float32_t Td;				// Derivative time
+} PIDGains_TypeDef;
+
+/* PID gains as stored in flash */
+typedef struct
+{
+  uint32_t nbrOfControllers;	// PID_NBR_CONTROLLERS when saved, the gains are discarded if the controller set has changed
+  PIDGains_TypeDef gains[PID_NBR_CONTROLLERS];
+} PIDGainSettings_TypeDef;
+
+typedef struct
+{
+  float32_t K;				// Gain of the filtered reference derivative, 0 for no feed-forward
+  float32_t Tf;				// Time constant of the reference derivative low-pass filter [s]
+} PIDFeedForward_TypeDef;
+
+/* Setpoint feed-forward as stored in flash, next to the gains */
+typedef struct
+{
+  uint32_t nbrOfControllers;	// PID_NBR_CONTROLLERS when saved, as for the gains
+  PIDFeedForward_TypeDef feedForwards[PID_NBR_CONTROLLERS];
+} PIDFeedForwardSettings_TypeDef;
+
+/* Gain schedule breakpoint tables as stored in flash. The throttle breakpoints are at 0 to MAX_THRUST and the battery
+ * breakpoints at PID_SCHEDULE_MIN_CELL_VOLTAGE to PID_SCHEDULE_MAX_CELL_VOLTAGE per cell, the scales are held beyond
+ * the ends. */
+typedef struct
+{
+  float32_t throttleScales[PID_SCHEDULE_BREAKPOINTS];
+  float32_t batteryScales[PID_SCHEDULE_BREAKPOINTS];
+} PIDGainSchedule_TypeDef;
+
 /* Exported macro ------------------------------------------------------------*/
 
 /* Exported function prototypes --------------------------------------------- */
 void InitPIDControllers(void);
-void UpdatePIDControlSignals(CtrlSignals_TypeDef* ctrlSignals);
+void ResetPIDControllers(void);
+RAMFUNC void UpdatePIDControlSignals(CtrlSignals_TypeDef* ctrlSignals);
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+RAMFUNC float32_t UpdatePIDAltitudeControl(const float32_t refZPosition);
+void InitPIDVerticalControlState(const float32_t thrust);
+#endif
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+RAMFUNC void UpdatePIDRateControlSignals(CtrlSignals_TypeDef* ctrlSignals);
+RAMFUNC void UpdatePIDRateModeControlSignals(CtrlSignals_TypeDef* ctrlSignals, const float32_t refRates[3]);
+RAMFUNC void UpdatePIDRateLoop(CtrlSignals_TypeDef* ctrlSignals, const float32_t rates[3], const float32_t refRates[3]);
+void GetPIDRateLoopReferences(float32_t refRates[3]);
+#endif
+RAMFUNC void ApplyPIDAllocationFeedback(const CtrlSignals_TypeDef* ctrlSignals, const float32_t achievedMoments[3]);
+void SwapPIDCoefficients(void);
 void ResetCtrlSignals(CtrlSignals_TypeDef* ctrlSignals);
 
+FcbRetValType SetPIDGains(const PIDControllerIndex_TypeDef idx, const PIDGains_TypeDef* gains);
+FcbRetValType GetPIDGains(const PIDControllerIndex_TypeDef idx, PIDGains_TypeDef* gains);
+FcbRetValType SetAllPIDGains(const PIDGainSettings_TypeDef* settings);
+void GetAllPIDGains(PIDGainSettings_TypeDef* settings);
+FcbRetValType SavePIDGains(void);
+FcbRetValType SetPIDFeedForward(const PIDControllerIndex_TypeDef idx, const PIDFeedForward_TypeDef* feedForward);
+FcbRetValType GetPIDFeedForward(const PIDControllerIndex_TypeDef idx, PIDFeedForward_TypeDef* feedForward);
+float32_t GetPIDSamplePeriod(const PIDControllerIndex_TypeDef idx);
+const ParamGroup_TypeDef* GetPIDParamGroup(void);
+void GetPIDTerms(const PIDControllerIndex_TypeDef idx, float32_t terms[3]);
+bool IsPIDOutputSaturated(const PIDControllerIndex_TypeDef idx);
+float32_t GetPIDControlError(const PIDControllerIndex_TypeDef idx);
+#ifdef PID_USE_GAIN_SCHEDULING
+void UpdatePIDGainSchedule(const float32_t thrust);
+void GetPIDGainScheduleScales(float32_t* throttleScale, float32_t* batteryScale);
+FcbRetValType SetPIDGainSchedule(const PIDGainSchedule_TypeDef* schedule);
+void GetPIDGainSchedule(PIDGainSchedule_TypeDef* schedule);
+FcbRetValType SavePIDGainSchedule(void);
+#endif
+
 #endif /* __PID_CONTROL_H_ */
 
 /**
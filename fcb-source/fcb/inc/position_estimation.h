@@ -0,0 +1,88 @@
+/******************************************************************************
+ * @file    position_estimation.h
+ * @brief   Header file for the GPS aided inertial position estimation module
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_POSITION_ESTIMATION_H_
+#define INC_POSITION_ESTIMATION_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include "arm_math.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported types ------------------------------------------------------------*/
+
+typedef enum PositionAxis {
+    POSITION_NORTH_IDX = 0,
+    POSITION_EAST_IDX,
+    POSITION_DOWN_IDX,
+    POSITION_AXES_N
+} PositionAxisType;
+
+typedef struct PositionEstimationStats {
+    uint32_t gpsFusions;        // GPS solutions fused
+    uint32_t gpsUnusable;       // GPS solutions skipped for their fix quality
+    uint32_t baroFusions;
+    uint32_t innovationRejected; // Measurements skipped since the innovation is outside the gate
+    uint32_t resets;            // Axis states reset to a measurement after INS_MAX_CONSECUTIVE_REJECTS
+} PositionEstimationStatsType;
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Noise of the inertial acceleration, the accelerometer noise and the attitude error, and the random walk of its
+ * bias */
+#define INS_ACC_NOISE                   ((float32_t) 0.5)   // [m/s^2]
+#define INS_ACC_BIAS_NOISE              ((float32_t) 0.02)  // [m/s^2/sqrt(s)]
+
+#define INS_BARO_NOISE                  ((float32_t) 0.5)   // [m]
+
+/* Lower limits of the GPS noise, the accuracies reported by the receiver are used above them */
+#define INS_GPS_MIN_POSITION_NOISE      ((float32_t) 1.0)   // [m]
+#define INS_GPS_MIN_VELOCITY_NOISE      ((float32_t) 0.1)   // [m/s]
+
+/* Standard deviations of the states when an axis is initialised from a measurement */
+#define INS_INIT_POSITION_NOISE         ((float32_t) 5.0)   // [m]
+#define INS_INIT_VELOCITY_NOISE         ((float32_t) 1.0)   // [m/s]
+#define INS_INIT_ACC_BIAS_NOISE         ((float32_t) 0.3)   // [m/s^2]
+
+/* Measurements with an innovation above this many standard deviations are not fused, an axis is reset to the
+ * measurement after this many in a row */
+#define INS_INNOVATION_GATE             ((float32_t) 5.0)
+#define INS_MAX_CONSECUTIVE_REJECTS     10
+
+/* Upper limit of the integration step, e.g. for the first sample [s] */
+#define INS_MAX_DT                      ((float32_t) 0.1)
+
+#define INS_EARTH_RADIUS                ((float32_t) 6371000.0) // [m]
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+void PositionEstimationPredict(const float32_t inertialAcc[POSITION_AXES_N], const float32_t dt);
+void PositionEstimationCorrectBaro(const float32_t altitude);
+void PositionEstimationCorrectGps(void);
+void ResetPositionEstimation(void);
+
+void GetNedPosition(float32_t dstPosition[POSITION_AXES_N]);
+void GetNedVelocity(float32_t dstVelocity[POSITION_AXES_N]);
+bool IsPositionValid(void);
+
+void GetPositionEstimationStats(PositionEstimationStatsType* dstStats);
+size_t PrintPositionStates(char* dst, const size_t dstSize);
+
+#endif /* INC_POSITION_ESTIMATION_H_ */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,79 @@
+/******************************************************************************
+ * @file    prearm_checks.h
+ * @brief   Header file for the pre-arm checklist. The checks are evaluated in
+ *          the 20 Hz rate group, and the UAV arms only if all of them passed
+ *          on the latest evaluation, see FLIGHT_MODE_REJECT_PREARM of
+ *          flight_mode.h. A check that has not been evaluated yet counts as
+ *          failed.
+ *
+ *          Some checks overlap with the guards of the flight mode state
+ *          machine, which are evaluated on every control cycle and give the
+ *          rejection its specific reason. The checklist has them too, so
+ *          that it is the complete list of what keeps the UAV from arming.
+ *          The failures are printed by the "get-prearm" CLI command, sent
+ *          with the PREARM_STATUS_MSG_ENUM telemetry message and in the
+ *          health bits of the FMS state frame, and shown by the LEDs.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_PREARM_CHECKS_H_
+#define INC_PREARM_CHECKS_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include "fcb_retval.h"
+#include "pb_encode.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported types ------------------------------------------------------------*/
+
+/* In the order they are evaluated and printed */
+typedef enum {
+    PREARM_CHECK_SENSORS = 0,       // The gyroscope, accelerometer and magnetometer are healthy and passed self-test
+    PREARM_CHECK_CALIBRATION,       // The accelerometer and magnetometer calibrations are stored and in use
+    PREARM_CHECK_ESTIMATOR,         // The state estimation has converged
+    PREARM_CHECK_LEVEL,             // Roll and pitch within PREARM_MAX_TILT_ANGLE
+    PREARM_CHECK_RECEIVER,          // The receiver calibration is stored and valid, and the receiver is active
+    PREARM_CHECK_BATTERY,           // The battery is neither low nor critical, FCB_BATTERY_MONITOR only
+    PREARM_CHECK_FLASH,             // No settings are waiting for the flash writer
+    PREARM_CHECK_RESET,             // The last reset was not by the watchdog, see IsWatchdogResetPending()
+    PREARM_CHECK_CPU,               // The CPU headroom is not low, see IsCpuHeadroomLow()
+    PREARM_CHECK_NBR
+} PreArmCheckType;
+
+typedef struct {
+    uint32_t failures;              // PREARM_CHECK_BIT() mask of the latest evaluation
+    uint32_t evaluations;           // Since startup
+    uint32_t timestamp;             // Of the latest change of the failures [ms]
+} PreArmStatusType;
+
+/* Exported constants --------------------------------------------------------*/
+#define PREARM_CHECKS_PHASE             40      // [ms] in the 20 Hz rate group, after the LEDs
+
+#define PREARM_MAX_TILT_ANGLE           0.35f   // [rad] of roll and pitch, about 20 degrees
+
+/* The PREARM_STATUS_MSG_ENUM message, encoded without generated nanopb code:
+ *   message PreArmStatusProto {
+ *     optional uint32 failures = 1;                // Bit n set if check n of PreArmCheckType failed
+ *     optional uint32 evaluations = 2;             // Since startup
+ *     optional uint32 timestamp = 3;               // Of the latest change of the failures [ms]
+ *   } */
+#define PREARM_STATUS_MSG_MAX_SIZE      (3*(1 + 5))
+
+/* Exported macro ------------------------------------------------------------*/
+#define PREARM_CHECK_BIT(CHECK)         (1UL << (CHECK))
+#define PREARM_CHECK_ALL                (PREARM_CHECK_BIT(PREARM_CHECK_NBR) - 1)
+
+/* Exported function prototypes --------------------------------------------- */
+FcbRetValType InitPreArmChecks(void);
+uint32_t GetPreArmFailures(void);
+void GetPreArmStatus(PreArmStatusType* dstStatus);
+const char* GetPreArmCheckName(const PreArmCheckType check);
+size_t PrintPreArmChecks(char* dst, const size_t dstSize);
+bool EncodePreArmStatus(pb_ostream_t* stream);
+
+#endif /* INC_PREARM_CHECKS_H_ */
@@ -0,0 +1,103 @@
+/******************************************************************************
+ * @file    rc_smoothing.h
+ * @brief   Header file for the RC smoothing, which low-pass filters the
+ *          stick references of the angle flight modes at the control rate.
+ *          The receiver frames arrive at about 50 Hz and the control runs
+ *          every few ms, so unfiltered the references step once per frame,
+ *          and the steps reach the motors through the D-term set-point
+ *          weighting. The filter is a PT2, two equal PT1 stages of the
+ *          cutoff, which is set from the measured frame rate or fixed. Its
+ *          added latency is the group delay of the PT2, 2/(2*pi*cutoff).
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_RC_SMOOTHING_H_
+#define INC_RC_SMOOTHING_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include "arm_math.h"
+#include "fcb_retval.h"
+#include "param_table.h"
+#include "ram_func.h"
+#include "stick_curves.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Exported types ------------------------------------------------------------*/
+
+/* RC smoothing settings as stored in flash */
+typedef struct RcSmoothingSettings {
+    uint16_t isEnabled;         // 0 or 1
+    float32_t cutoffHz;         // Fixed cutoff [Hz], 0 to set it from the measured frame rate
+} RcSmoothingSettingsType;
+
+typedef struct RcSmoothingStatus {
+    bool isEnabled;
+    float32_t frameRateHz;      // Measured receiver frame rate [Hz]
+    float32_t cutoffHz;         // Cutoff in use [Hz]
+    float32_t latencyMs;        // Added latency of the references, 0 when disabled [ms]
+} RcSmoothingStatusType;
+
+/* Exported constants --------------------------------------------------------*/
+
+#define RC_SMOOTHING_DEFAULT_FRAME_RATE     50.0f   // [Hz] Until a frame rate has been measured
+#define RC_SMOOTHING_AUTO_CUTOFF_RATIO      0.3f    // Automatic cutoff relative to the frame rate
+#define RC_SMOOTHING_MIN_CUTOFF             5.0f    // [Hz] Limits of the cutoff, also of the parameter
+#define RC_SMOOTHING_MAX_CUTOFF             50.0f   // [Hz]
+
+/* Exported functions ------------------------------------------------------- */
+
+/**
+ * Loads the settings from flash, or the defaults if there are none. Called by
+ * the flight control task at startup.
+ */
+void InitRcSmoothing(void);
+
+/**
+ * Measures the frame rate with a new receiver frame and updates the automatic
+ * cutoff. Called by the flight control task.
+ *
+ * @param frameTimestamp time the frame was completed [core clock cycles]
+ * @param isNextFrame true if no frame was missed since the previous call
+ */
+void RcSmoothingNewFrame(const uint32_t frameTimestamp, const bool isNextFrame);
+
+/**
+ * Filters the references of one control cycle in place, when enabled.
+ * Called by the flight control task.
+ *
+ * @param refs references indexed by StickAxisType
+ * @param samplePeriod time since the previous call [s]
+ */
+RAMFUNC void RcSmoothingApply(float32_t refs[STICK_AXIS_NBR], const float32_t samplePeriod);
+
+/**
+ * Sets the filter states to the references, so that the next cycle starts
+ * from them without a transient. Called by the flight control task.
+ *
+ * @param refs references indexed by StickAxisType
+ */
+void RcSmoothingReset(const float32_t refs[STICK_AXIS_NBR]);
+
+void GetRcSmoothingStatus(RcSmoothingStatusType* status);
+
+/**
+ * Gets the RC smoothing parameters, for the parameter table. RC_SMOOTH
+ * enables the filter, RC_SMOOTH_HZ fixes its cutoff, 0 sets it from the
+ * measured frame rate.
+ */
+const ParamGroup_TypeDef* GetRcSmoothingParamGroup(void);
+
+#endif /* INC_RC_SMOOTHING_H_ */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
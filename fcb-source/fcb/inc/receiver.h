@@ -17,6 +17,30 @@
 
 /* Exported constants --------------------------------------------------------*/
 
+/* Receiver input protocols */
+#define RECEIVER_PROTOCOL_PWM                           0   // One 1-2 ms pulse per channel, each on its own TIM IC pin
+#define RECEIVER_PROTOCOL_PPM                           1   // PPM-sum, all channels as pulse intervals on one TIM IC pin
+#define RECEIVER_PROTOCOL_SBUS                          2   // Futaba SBUS frames, inverted 100 kbit/s 8E2 UART
+#define RECEIVER_PROTOCOL_DSM                           3   // Spektrum DSM2/DSMX satellite frames, 115.2 kbit/s 8N1 UART
+
+/* Selects the protocol of the connected RC receiver, see receiver_serial.h for the PPM, SBUS and DSM inputs */
+#define RECEIVER_INPUT_PROTOCOL                         RECEIVER_PROTOCOL_PWM
+
+#define RECEIVER_INPUT_IS_UART                          (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_SBUS \
+                                                        || RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_DSM)
+
+/* Max number of channels in a PPM-sum, SBUS or DSM frame */
+#define RECEIVER_MAX_CHANNELS                           16
+
+/* Default frame channel (0 = first) carrying each of the receiver functions, until a channel map is set, see
+ * SetReceiverChannelMap(). The defaults follow the Spektrum order, which is fixed for DSM. */
+#define RECEIVER_FRAME_THROTTLE_CHANNEL                 0
+#define RECEIVER_FRAME_AILERON_CHANNEL                  1
+#define RECEIVER_FRAME_ELEVATOR_CHANNEL                 2
+#define RECEIVER_FRAME_RUDDER_CHANNEL                   3
+#define RECEIVER_FRAME_GEAR_CHANNEL                     4
+#define RECEIVER_FRAME_AUX1_CHANNEL                     5
+
 /* Definitions for Primary Receiver ##########################################*/
 /* Definitions for Primary Receiver TIM clock */
 #define PRIMARY_RECEIVER_TIM                            TIM2
@@ -101,7 +125,9 @@
 #define RECEIVER_MAX_CALIBRATION_DURATION               1200000 // [ms] Max receiver calibration duration
 #define RECEIVER_CALIBRATION_MIN_PULSE_COUNT            1000    // Corresponds to ~22.0 s of calibration (assuming period is 22 ms)
 #define RECEIVER_CALIBRATION_MIN_MID_PULSE_COUNT        500		// Corresponds to ~11.0 s of calibration (assuming period is 6 ms)
-#define RECEIVER_CALIBRATION_SAMPLES_BUFFER_SIZE        16
+#define RECEIVER_CALIBRATION_PHASE                      30      // [ms] in the 20 Hz rate group, between the LEDs and pre-arm checks
+#define RECEIVER_CALIBRATION_ESTIMATE_SHIFT             3       // Fraction bits of the max/min pulse estimates
+#define RECEIVER_CALIBRATION_ESTIMATE_ATTACK_SHIFT      3       // Estimates move 1/8 of the way to a pulse beyond them
 #define RECEIVER_MAX_CALIBRATION_MAX_PULSE_COUNT        RECEIVER_PULSE_DEFAULT_MAX_COUNT*11/10  // Max +10% deviation
 #define RECEIVER_MAX_CALIBRATION_MIN_PULSE_COUNT        RECEIVER_PULSE_DEFAULT_MIN_COUNT*9/10   // Max -10% deviation
 #define RECEIVER_MIN_CALIBRATION_MAX_PULSE_COUNT        RECEIVER_PULSE_DEFAULT_MIN_COUNT*11/10  // Max +10% deviation
@@ -112,9 +138,57 @@
 
 #define IS_RECEIVER_CHANNEL_INACTIVE_PERIODS_COUNT      300     // Corresponds to ~1.092 s
 
+/* A receiver snapshot older than this is reported inactive, also if the receiver stops completing frames */
+#define RECEIVER_SNAPSHOT_TIMEOUT                       1000    // [ms]
+
+/* Receiver snapshot channel indexes */
+#define RECEIVER_SNAPSHOT_THROTTLE                      0
+#define RECEIVER_SNAPSHOT_AILERON                       1
+#define RECEIVER_SNAPSHOT_ELEVATOR                      2
+#define RECEIVER_SNAPSHOT_RUDDER                        3
+#define RECEIVER_SNAPSHOT_GEAR                          4
+#define RECEIVER_SNAPSHOT_AUX1                          5
+#define RECEIVER_SNAPSHOT_CHANNELS_NBR                  6
+
+/* Number of ranges of the receiver mode range table */
+#define RECEIVER_MODE_RANGES_NBR                        8
+
+/* Definitions for the RC failsafe watchdog #################################*/
+/* The watchdog TIM is restarted by every complete RC frame. When it elapses the receiver is in failsafe, until the
+ * next complete frame, and the flight control is notified at once. */
+#define RECEIVER_FAILSAFE_TIM                           TIM6
+#define RECEIVER_FAILSAFE_TIM_CLK_ENABLE()              __TIM6_CLK_ENABLE()
+#define RECEIVER_FAILSAFE_TIM_CLK_DISABLE()             __TIM6_CLK_DISABLE()
+#define RECEIVER_FAILSAFE_TIM_IRQn                      TIM6_DAC_IRQn
+#define RECEIVER_FAILSAFE_TIM_IRQHandler                TIM6_DAC_IRQHandler
+#define RECEIVER_FAILSAFE_TIM_IRQ_PREEMPT_PRIO          configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY // Set to this since used w/ RTOS
+#define RECEIVER_FAILSAFE_TIM_IRQ_SUB_PRIO              0
+#define RECEIVER_FAILSAFE_TIM_COUNTER_CLOCK             10000   // [Hz]
+#define RECEIVER_FAILSAFE_TIMEOUT                       100     // [ms] Max time without a complete RC frame
+
+/* Deferred PWM decoding ######################################################*/
+/* Uncomment to capture both edges of the PWM channels without toggling the IC polarity. The capture interrupt then
+ * only stores each edge timestamp, and a task decodes the pulses and periods of all channels once per RC frame. */
+//#define RECEIVER_PWM_DEFERRED_DECODING
+
+#define RECEIVER_PWM_EDGE_BUFFER_SIZE                   8       // Edge timestamps buffered per channel between decodings
+#define RECEIVER_PWM_DECODE_PERIOD                      10      // [ms] Less than half the ~22 ms RC frame period
+
+/* The 32-bit primary TIM never wraps between edges. The 16-bit aux TIM is slowed down so that its counter period
+ * (~29.1 ms) is longer than the RC frame, and its counts are scaled up to the common 18 MHz ticks. */
+#define RECEIVER_PWM_PRIMARY_COUNTER_PERIOD             UINT32_MAX
+#define RECEIVER_PWM_AUX_TICK_MULTIPLIER                8       // 2.25 MHz aux counter clock
+#define RECEIVER_PWM_CHANNEL_INACTIVE_TIMEOUT           (IS_RECEIVER_CHANNEL_INACTIVE_PERIODS_COUNT*RECEIVER_COUNTER_PERIOD \
+                                                        /(RECEIVER_TIM_COUNTER_CLOCK/1000)) // [ms] Same ~1.092 s as above
+
+#if defined(RECEIVER_PWM_DEFERRED_DECODING) && (RECEIVER_INPUT_PROTOCOL != RECEIVER_PROTOCOL_PWM)
+#error "RECEIVER_PWM_DEFERRED_DECODING requires RECEIVER_PROTOCOL_PWM"
+#endif
+
 /* Exported variables --------------------------------------------------------*/
 TIM_HandleTypeDef PrimaryReceiverTimHandle;
 TIM_HandleTypeDef AuxReceiverTimHandle;
+TIM_HandleTypeDef ReceiverFailsafeTimHandle;
 
 /* Exported types ------------------------------------------------------------*/
 typedef enum {
@@ -136,6 +210,67 @@ typedef struct {
 	Receiver_IC_ChannelCalibrationValues_TypeDef Aux1Channel;
 } Receiver_CalibrationValues_TypeDef;
 
+/* Modes and functions selected by the receiver mode ranges */
+typedef enum {
+	RECEIVER_MODE_NONE = 0,         // Unused range, or no mode range is active
+	RECEIVER_MODE_ARM,              // Function: modes are only selected while an arm range is active, if there is one
+	RECEIVER_MODE_RAW,
+	RECEIVER_MODE_STABILIZED,       // The stabilized mode set by SetStabilizedFlightMode()
+	RECEIVER_MODE_ATTITUDE,
+	RECEIVER_MODE_RATE,
+	RECEIVER_MODE_ALTITUDE_HOLD,
+	RECEIVER_MODE_AUTONOMOUS,
+	RECEIVER_MODE_NBR
+} ReceiverModeType;
+
+/* A mode range selects its mode while the channel is within [MinPercent, MaxPercent] of its range */
+typedef struct {
+	uint8_t Channel;                // Receiver function, as the snapshot channels
+	uint8_t Mode;                   // ReceiverModeType
+	int8_t MinPercent;              // [-100, 100]
+	int8_t MaxPercent;              // [MinPercent, 100]
+} Receiver_ModeRange_TypeDef;
+
+/* Receiver channel map and mode range table, as stored in flash */
+typedef struct {
+	uint8_t Inputs[RECEIVER_SNAPSHOT_CHANNELS_NBR]; // Input of each receiver function, as the snapshot channels. The
+	                                // PWM input (0 = throttle pin, ..., 5 = aux1 pin) or the frame channel (0 = first).
+	uint8_t ReversedChannels;       // Bit n reverses receiver function n
+	uint8_t Reserved;
+	Receiver_ModeRange_TypeDef ModeRanges[RECEIVER_MODE_RANGES_NBR]; // The first active mode range takes precedence
+} Receiver_ChannelMap_TypeDef;
+
+/* Normalized receiver channels of one complete RC frame, published once per frame */
+typedef struct {
+	int16_t Throttle;               // Channel values in Q15 [-32768, 32767], as the Get*ReceiverChannel() functions
+	int16_t Aileron;
+	int16_t Elevator;
+	int16_t Rudder;
+	int16_t Gear;
+	int16_t Aux1;
+	ReceiverModeType Mode;          // Of the mode ranges, as GetReceiverMode()
+	uint16_t PulseTicks[RECEIVER_SNAPSHOT_CHANNELS_NBR]; // Raw pulses of the mapped inputs [receiver timer ticks]
+	uint8_t UpdatedChannels;        // Bit n is set if channel n has a new pulse in the frame, else it is repeated
+	ReceiverErrorStatus IsActive;
+	uint32_t Timestamp;             // Low word of GetMicroseconds() when the frame was completed [us]
+	uint32_t FrameTimestamp;        // Time the frame was completed [core clock cycles], see GetTimestamp()
+	uint32_t Sequence;              // Incremented for every published snapshot, 0 before the first frame
+} Receiver_Snapshot_TypeDef;
+
+/* Link quality counters of one receiver channel */
+typedef struct {
+	uint32_t PulseCount;            // Valid pulses received
+	uint32_t DropoutCount;          // RC frames completed without a new pulse of the channel
+	uint16_t PulseRate;             // Filtered pulse rate, 0 if the channel is silent [Hz]
+} Receiver_ChannelLinkStats_TypeDef;
+
+typedef struct {
+	Receiver_ChannelLinkStats_TypeDef Channels[RECEIVER_SNAPSHOT_CHANNELS_NBR]; // Indexed as the snapshot channels
+	uint32_t FrameCount;            // RC frames completed
+	uint32_t FailsafeCount;         // Times the failsafe watchdog has elapsed
+	bool IsFailsafe;                // No complete RC frame within RECEIVER_FAILSAFE_TIMEOUT
+} Receiver_LinkStats_TypeDef;
+
 /* Exported macro ------------------------------------------------------------*/
 
 /* Exported function prototypes --------------------------------------------- */
@@ -143,9 +278,8 @@ ReceiverErrorStatus ReceiverInputConfig(void);
 ReceiverErrorStatus StartReceiverCalibration(void);
 ReceiverErrorStatus StopReceiverCalibration(void);
 void ResetReceiverCalibrationValues(void);
-ReceiverErrorStatus StartReceiverSamplingTask(const uint16_t sampleTime, const uint32_t sampleDuration);
-ReceiverErrorStatus StopReceiverSamplingTask(void);
 ReceiverErrorStatus IsReceiverActive(void);
+bool IsReceiverCalibrated(void);
 
 void PrimaryReceiverTimerPeriodCountIncrement(void);
 void AuxReceiverTimerPeriodCountIncrement(void);
@@ -199,8 +333,23 @@ ReceiverErrorStatus UpdateReceiverRudderChannel(void);
 ReceiverErrorStatus UpdateReceiverGearChannel(void);
 ReceiverErrorStatus UpdateReceiverAux1Channel(void);
 
-bool GetReceiverRawFlightSet(void);
-bool GetReceiverPIDFlightSet(void);
+ReceiverErrorStatus UpdateReceiverChannelsFromFrame(const uint16_t* channelPulseTicks, const uint8_t nbrOfChannels,
+		const uint32_t framePeriodTicks);
+
+ReceiverModeType GetReceiverMode(void);
+const char* GetReceiverModeName(const ReceiverModeType mode);
+
+void GetReceiverChannelMap(Receiver_ChannelMap_TypeDef* dstMap);
+void GetDefaultReceiverChannelMap(Receiver_ChannelMap_TypeDef* dstMap);
+ReceiverErrorStatus SetReceiverChannelMap(const Receiver_ChannelMap_TypeDef* channelMap);
+ReceiverErrorStatus SaveReceiverChannelMap(void);
+
+ReceiverErrorStatus GetReceiverSnapshot(Receiver_Snapshot_TypeDef* dstSnapshot);
+uint32_t GetReceiverSnapshotSequence(void);
+
+void ReceiverFailsafeTimerElapsed(void);
+bool IsReceiverFailsafe(void);
+void GetReceiverLinkStats(Receiver_LinkStats_TypeDef* dstStats);
 
 #endif /* __RECEIVER_H */
 
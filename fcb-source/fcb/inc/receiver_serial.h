@@ -0,0 +1,97 @@
+/******************************************************************************
+ * @file    receiver_serial.h
+ * @brief   Flight Control program for the Dragonfly quadcopter
+ *          Header file for reading PPM-sum, SBUS and DSM RC receivers
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __RECEIVER_SERIAL_H
+#define __RECEIVER_SERIAL_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include "receiver.h"
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Definitions for the SBUS/DSM receiver UART ################################*/
+/* Definitions for the receiver UART clock resources */
+#define SERIAL_RECEIVER_UART                            USART1
+#define SERIAL_RECEIVER_UART_CLK_ENABLE()               __USART1_CLK_ENABLE()
+#define SERIAL_RECEIVER_UART_DMA_CLK_ENABLE()           __DMA1_CLK_ENABLE()
+#define SERIAL_RECEIVER_UART_RX_GPIO_CLK_ENABLE()       __GPIOC_CLK_ENABLE()
+
+/* Definitions for the receiver UART pin, only RX is used */
+#define SERIAL_RECEIVER_UART_RX_PIN                     GPIO_PIN_5
+#define SERIAL_RECEIVER_UART_RX_GPIO_PORT               GPIOC
+#define SERIAL_RECEIVER_UART_RX_AF                      GPIO_AF7_USART1
+
+/* Definitions for the receiver UART DMA, its interrupts are not used */
+#define SERIAL_RECEIVER_UART_RX_DMA_CHANNEL             DMA1_Channel5 // USART1_RX request
+
+/* Definitions for the receiver UART NVIC, the idle line interrupt completes each frame */
+#define SERIAL_RECEIVER_UART_IRQn                       USART1_IRQn
+#define SERIAL_RECEIVER_UART_IRQHandler                 USART1_IRQHandler
+#define SERIAL_RECEIVER_UART_IRQ_PREEMPT_PRIO           0
+#define SERIAL_RECEIVER_UART_IRQ_SUB_PRIO               0
+
+/* DMA ring buffer, holds more than two frames of either protocol */
+#define SERIAL_RECEIVER_DMA_BUFFER_SIZE                 64
+
+/* Definitions for SBUS ######################################################*/
+#define SBUS_BAUDRATE                                   100000
+#define SBUS_FRAME_SIZE                                 25
+#define SBUS_HEADER_BYTE                                0x0F
+#define SBUS_NBR_OF_CHANNELS                            16      // 11 bit proportional channels, the digital are unused
+#define SBUS_FLAGS_BYTE                                 23
+#define SBUS_FLAG_FRAME_LOST                            0x04
+#define SBUS_FLAG_FAILSAFE                              0x08
+
+/* Definitions for Spektrum DSM satellites ###################################*/
+#define DSM_BAUDRATE                                    115200
+#define DSM_FRAME_SIZE                                  16
+#define DSM_FRAME_CHANNEL_WORDS                         7
+#define DSM_SYSTEM_BYTE                                 1
+#define DSM_SYSTEM_DSM2_1024_22MS                       0x01    // The only system with 10 bit channel values
+#define DSM_UNUSED_CHANNEL_WORD                         0xFFFF
+
+/* Definitions for PPM-sum ###################################################*/
+/* PPM-sum uses the throttle channel input of the primary receiver TIM, capturing one edge per channel */
+#define RECEIVER_PPM_CHANNEL                            PRIMARY_RECEIVER_THROTTLE_CHANNEL
+#define RECEIVER_PPM_ACTIVE_CHANNEL                     PRIMARY_RECEIVER_THROTTLE_ACTIVE_CHANNEL
+#define RECEIVER_PPM_IC_POLARITY                        TIM_ICPOLARITY_RISING
+#define RECEIVER_PPM_COUNTER_PERIOD                     UINT32_MAX  // TIM2 is 32 bit, no period counting needed
+#define RECEIVER_PPM_SYNC_MIN_COUNT                     (RECEIVER_TIM_COUNTER_CLOCK/1000000*2700) // 2.7 ms gap
+#define RECEIVER_PPM_MIN_CHANNELS                       6
+
+/* A serial receiver is inactive when no valid frame has arrived for this long or when it reports failsafe */
+#define SERIAL_RECEIVER_INACTIVE_TIMEOUT                1000    // [ms]
+
+/* Exported variables --------------------------------------------------------*/
+UART_HandleTypeDef SerialReceiverUartHandle;
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported function prototypes --------------------------------------------- */
+ReceiverErrorStatus SerialReceiverInputConfig(void);
+ReceiverErrorStatus IsSerialReceiverActive(void);
+
+void SerialReceiverUartIRQHandler(void);
+void UpdateReceiverPPMChannel(void);
+
+uint8_t GetReceiverNumberOfChannels(void);
+uint16_t GetReceiverChannelPulseTicks(const uint8_t channel);
+
+#endif /* __RECEIVER_SERIAL_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
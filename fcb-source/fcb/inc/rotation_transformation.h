@@ -8,12 +8,29 @@
 #define INC_ROTATION_TRANSFORMATION_H_
 
 /* Includes ------------------------------------------------------------------*/
-#include "stm32f3xx.h"
-
 #include "arm_math.h"
 
+#include <stdint.h>
+
 /* Exported types ------------------------------------------------------------*/
 
+/**
+ * Trigonometric functions of the estimated attitude, computed once per estimator update and shared by all
+ * transformations in that update. generation changes on every update so users can tell when derived data
+ * (e.g. a transformation matrix) needs to be recalculated.
+ */
+typedef struct AttitudeTrigCache {
+    float32_t sinRoll;
+    float32_t cosRoll;
+    float32_t sinPitch;
+    float32_t cosPitch;
+    float32_t tanPitch; /* only valid if cosPitch is not close to 0, see GetEulerAngularRatesCached() */
+    float32_t secPitch; /* only valid if cosPitch is not close to 0 */
+    float32_t sinYaw;
+    float32_t cosYaw;
+    uint32_t generation;
+} AttitudeTrigCacheType;
+
 /* Exported constants --------------------------------------------------------*/
 typedef enum  {
     TRANSF_OK = 1, TRANSF_ERROR = !TRANSF_OK
@@ -36,6 +53,17 @@ float32_t GetAccPitchAngle(void);
 float32_t GetMagYawAngle(float32_t* magValues, const float32_t roll, const float32_t pitch);
 TransformationErrorStatus GetEulerAngularRates(float32_t* rateDst, const float32_t* bodyAngularRates, const float32_t roll, const float32_t pitch);
 
+void UpdateAttitudeTrigCache(const float32_t roll, const float32_t pitch, const float32_t yaw);
+const AttitudeTrigCacheType* GetAttitudeTrigCache(void);
+void UpdateRotationMatrixCached(const AttitudeTrigCacheType* trig);
+void UpdateRotationMatrixFromGyro(const float32_t* bodyAngularRates, const float32_t dt);
+void Vector3DBodyToInertial(float32_t* dstVector, const float32_t* srcVector);
+void Vector3DInertialToBody(float32_t* dstVector, const float32_t* srcVector);
+void Vector3DTiltCompensateCached(float32_t* dstVector, const float32_t* srcVector, const AttitudeTrigCacheType* trig);
+float32_t GetMagYawAngleCached(float32_t* magValues, const AttitudeTrigCacheType* trig);
+TransformationErrorStatus GetEulerAngularRatesCached(float32_t* rateDst, const float32_t* bodyAngularRates,
+        const AttitudeTrigCacheType* trig);
+
 #endif /* INC_ROTATION_TRANSFORMATION_H_ */
 
 /**
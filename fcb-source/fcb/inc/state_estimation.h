@@ -15,6 +15,7 @@
 #include "flight_control.h"
 #include "fcb_retval.h"
 #include "common.h"
+#include "ram_func.h"
 
 /* Exported types ------------------------------------------------------------*/
 
@@ -32,47 +33,202 @@ typedef enum FcbRPYIndex {
   AXES_NPR
 } FcbRPYIndexType;
 
-typedef struct KalmanFilter
+/**
+ * Kalman estimators of roll, pitch & yaw, stored structure-of-arrays and
+ * indexed by FcbRPYIndexType so that all axes are run in one pass.
+ */
+typedef struct KalmanFilterBank
 {
     /* process noise covariance matrix components */
-	float32_t q1;   /* multiply with deltaT^2 to get q1 */
-	float32_t q2;
-	float32_t q3;
-	float32_t r1;	// Measurement noise covariance matrix component
-	float32_t r2;   // Measurement noise covariance matrix component
-	float32_t p11;	// Error covariance matrix component
-	float32_t p12;  // Error covariance matrix component
-	float32_t p13;  // Error covariance matrix component
-	float32_t p21;  // Error covariance matrix component
-	float32_t p22;  // Error covariance matrix component
-	float32_t p23;  // Error covariance matrix component
-	float32_t p31;  // Error covariance matrix component
-	float32_t p32;  // Error covariance matrix component
-	float32_t p33;  // Error covariance matrix component
-	float32_t k11;	// Kalman gain
-	float32_t k12;  // Kalman gain
-	float32_t k21;  // Kalman gain
-	float32_t k22;  // Kalman gain
-	float32_t k31;  // Kalman gain
-	float32_t k32;   // note: k<x> these don't have to be part of the struct as they
-	                // need not be carried over from one iteration to the next
-	                // but it's useful for displaying variables.
-	float32_t h;    // Sample time [s]
-} KalmanFilterType;
-// TODO use vectors/matrices for Q, R, P, K
+	float32_t q1[AXES_NPR];   /* multiply with deltaT^2 to get q1 */
+	float32_t q2[AXES_NPR];
+	float32_t q3[AXES_NPR];
+	float32_t r1[AXES_NPR];	// Measurement noise covariance matrix component
+	float32_t r2[AXES_NPR];   // Measurement noise covariance matrix component
+	float32_t p11[AXES_NPR];	// Error covariance matrix component
+	float32_t p12[AXES_NPR];  // Error covariance matrix component
+	float32_t p13[AXES_NPR];  // Error covariance matrix component
+	float32_t p21[AXES_NPR];  // Error covariance matrix component
+	float32_t p22[AXES_NPR];  // Error covariance matrix component
+	float32_t p23[AXES_NPR];  // Error covariance matrix component
+	float32_t p31[AXES_NPR];  // Error covariance matrix component
+	float32_t p32[AXES_NPR];  // Error covariance matrix component
+	float32_t p33[AXES_NPR];  // Error covariance matrix component
+	float32_t k11[AXES_NPR];  // Kalman gain component of the attitude correction
+	float32_t k21[AXES_NPR];  // Kalman gain component of the attitude correction
+	float32_t k31[AXES_NPR];  // Kalman gain component of the attitude correction
+	float32_t k12[AXES_NPR];  // Kalman gain component of the attitude rate correction
+	float32_t k22[AXES_NPR];  // Kalman gain component of the attitude rate correction
+	float32_t k32[AXES_NPR];  // Kalman gain component of the attitude rate correction
+	float32_t h;    // Sample time [s], same for all axes
+} KalmanFilterBankType;
+
+/**
+ * This is used for roll, pitch & yaw attitude, indexed by FcbRPYIndexType.
+ */
+typedef struct AttitudeStates
+{
+  float32_t angle[AXES_NPR]; /* for yaw, aka "heading" */
+  float32_t angleRate[AXES_NPR]; /* not used */
+  float32_t angleRateBias[AXES_NPR];
+  float32_t angleRateUnbiased[AXES_NPR]; // Not used in Kalman filter derivation, but should be fed in to control
+} AttitudeStatesType;
+
+/**
+ * Vertical states in the inertial (NED) frame, i.e. Z points downwards.
+ */
+typedef struct VerticalStates
+{
+  float32_t zPosition; /* [m], minus the barometric altitude */
+  float32_t zVelocity; /* [m/s] */
+  float32_t zAccBias; /* [m/s^2], accelerometer bias along the inertial Z axis */
+} VerticalStatesType;
+
+/**
+ * Coherent copy of the states for the readers outside the flight control
+ * task, published once per control cycle, see GetStateSnapshot().
+ */
+typedef struct StateSnapshot
+{
+  uint32_t sequence;            // Counts the published snapshots, 0 before the first one
+  uint32_t timestamp;           // Of the latest prediction [core clock cycles]
+  float32_t angle[AXES_NPR];    // [rad]
+  float32_t angleRate[AXES_NPR];
+  float32_t angleRateBias[AXES_NPR];
+  float32_t angleRateUnbiased[AXES_NPR]; // [rad/s]
+  float32_t p11[AXES_NPR];      // Error variances of the angle, angle rate and angle rate bias
+  float32_t p22[AXES_NPR];
+  float32_t p33[AXES_NPR];
+  float32_t zPosition;          // [m], positive downwards
+  float32_t zVelocity;          // [m/s]
+} StateSnapshotType;
+
+/**
+ * Converged estimator state that is persisted to flash so that the next boot
+ * does not have to estimate the gyroscope biases from scratch.
+ */
+typedef struct StateWarmStart
+{
+  float32_t angleRateBias[AXES_NPR];
+  float32_t p11[AXES_NPR];
+  float32_t p12[AXES_NPR];
+  float32_t p13[AXES_NPR];
+  float32_t p21[AXES_NPR];
+  float32_t p22[AXES_NPR];
+  float32_t p23[AXES_NPR];
+  float32_t p31[AXES_NPR];
+  float32_t p32[AXES_NPR];
+  float32_t p33[AXES_NPR];
+} StateWarmStartType;
+
+/**
+ * Parameters of an estimator initialization, see InitStatesFrom().
+ */
+typedef struct StateInit
+{
+  float32_t angles[AXES_NPR];   // Initial roll, pitch & yaw [rad]
+  float32_t predictionPeriod;   // [s]
+  uint32_t timestamp;           // Time the first corrections are counted from [core clock cycles]
+  float32_t r1[AXES_NPR];       // Attitude sensor noise variances, of a single magnetometer sample for yaw [rad^2]
+  float32_t r2[AXES_NPR];       // Attitude rate sensor noise variances [(rad/s)^2]
+  float32_t q1[AXES_NPR];       // Process noise variances of the angle, angle rate and angle rate bias
+  float32_t q2[AXES_NPR];
+  float32_t q3[AXES_NPR];
+} StateInitType;
+
+/**
+ * Kalman noise parameters as stored in flash, see
+ * GetEstimatorNoiseParamGroup(). A measurement noise of 0 keeps the variance
+ * of the sensor noise characterisation, or the hand-tuned default. A change
+ * takes effect at the next prediction, which resets the error covariances to
+ * their initial values and keeps the states.
+ */
+typedef struct EstimatorNoiseSettings
+{
+  float32_t q1RollPitch;
+  float32_t q2RollPitch;
+  float32_t q1Yaw;
+  float32_t q2Yaw;
+  float32_t q3;                 // Of the angle rate biases of all axes
+  float32_t r1[AXES_NPR];       // [rad^2], 0 for the characterised or default variance
+  float32_t r2[AXES_NPR];       // [(rad/s)^2], 0 for the characterised or default variance
+} EstimatorNoiseSettingsType;
 
 /**
- * This is used for roll, pitch & yaw attitude.
+ * Sensor noise measured by the characterisation at rest, see
+ * StartSensorNoiseCharacterisation(), and the Kalman measurement noise
+ * derived from it. Persisted to flash to seed the following initializations.
  */
-typedef struct AttitudeStateVector
+typedef struct SensorNoise
 {
-  float32_t angle; /* for yaw, aka "heading" */
-  float32_t angleRate; /* not used */
-  float32_t angleRateBias;
-  float32_t angleRateUnbiased; // Not used in Kalman filter derivation, but should be fed in to control
-} AttitudeStateVectorType;
+  float32_t mean[FCB_SENSOR_NBR][3];     // Per axis, in the sensor unit, only the first axis of the barometer
+  float32_t variance[FCB_SENSOR_NBR][3]; // Per axis, in the sensor unit squared
+  uint32_t samples[FCB_SENSOR_NBR];
+  float32_t r1[AXES_NPR];       // See StateInitType
+  float32_t r2[AXES_NPR];
+} SensorNoiseType;
+
+typedef enum {
+  SENSOR_NOISE_IDLE = 0,        // Never run since startup
+  SENSOR_NOISE_RUNNING,
+  SENSOR_NOISE_DONE,            // The result is valid
+  SENSOR_NOISE_MOVED,           // Stopped, the UAV was not at rest or flight control left idle mode
+  SENSOR_NOISE_TOO_FEW_SAMPLES  // Stopped, a sensor gave less than SENSOR_NOISE_MIN_SAMPLES
+} SensorNoiseStatusType;
+
+typedef struct AccCorrectionGateStats
+{
+  uint32_t accepted;            // Samples used for roll/pitch correction
+  uint32_t normRejected;        // Samples skipped since |a| deviates too much from G_ACC
+  uint32_t innovationRejected;  // Samples skipped since the innovation is outside the gate
+  float32_t noiseScale;         // Of the latest sample, the attitude noise is inflated with for vibration
+} AccCorrectionGateStatsType;
+
+typedef struct DelayedFusionStats
+{
+  uint32_t delayed;             // Samples taken before the latest prediction, fused at the prediction before them
+  uint32_t expired;             // Samples skipped since taken before the oldest prediction in the history
+  uint32_t maxDelay;            // Most predictions a sample was taken before the latest one
+} DelayedFusionStatsType;
 
 /* Exported constants --------------------------------------------------------*/
+/* Uncomment to estimate attitude with the quaternion filter in attitude_quaternion.c instead of the Euler angle
+ * Kalman filter. It integrates the body rates directly, which is cheaper per gyroscope sample and has no
+ * singularity near +/-90 deg pitch. */
+//#define FCB_QUATERNION_ATTITUDE_ESTIMATION
+
+/* Uncomment to run the Kalman filter with constant (steady-state) gains. The gains are solved once at startup by
+ * running the covariance recursion at the nominal sensor data rates until it converges, after which prediction and
+ * correction are only the state updates. Leave commented to run the full covariance filter, e.g. when tuning the
+ * noise parameters below. */
+//#define FCB_STEADY_STATE_KALMAN
+
+/* Uncomment to fuse the accelerometer and magnetometer samples at the time they were taken instead of at the latest
+ * prediction, which they may lag by their bus latency and their queueing in the flight control task. The Kalman
+ * states and error covariances after each prediction are kept for the last STATE_HISTORY_LENGTH predictions. A
+ * sample taken before the latest prediction is compared with the states of the prediction before it, corrected with
+ * the gains of its covariances, and the correction is propagated through the later predictions to the history and
+ * the current states. Samples from before the history are skipped. */
+//#define FCB_DELAYED_FUSION
+
+#if defined(FCB_QUATERNION_ATTITUDE_ESTIMATION) && defined(FCB_STEADY_STATE_KALMAN)
+#error "FCB_STEADY_STATE_KALMAN applies to the Kalman filter, it cannot be used with FCB_QUATERNION_ATTITUDE_ESTIMATION"
+#endif
+
+#if defined(FCB_QUATERNION_ATTITUDE_ESTIMATION) && defined(FCB_DELAYED_FUSION)
+#error "FCB_DELAYED_FUSION applies to the Kalman filter, it cannot be used with FCB_QUATERNION_ATTITUDE_ESTIMATION"
+#endif
+
+#define STATE_HISTORY_LENGTH                16 // Predictions, 80 ms at FLIGHT_CONTROL_TASK_PERIOD
+
+#define STEADY_STATE_KALMAN_MAX_SOLVE_TIME  (float32_t) 120.0 // Max simulated filter time when solving the gains [s]
+#define STEADY_STATE_KALMAN_GAIN_TOLERANCE  (float32_t) 0.0001 // Max relative gain change per simulated second
+
+/* Time constant of the complementary filter fusing the vertical acceleration and the barometric altitude [s]. The
+ * barometer dominates below 1/VERTICAL_ESTIMATION_TIME_CONSTANT rad/s, the accelerometer above. */
+#define VERTICAL_ESTIMATION_TIME_CONSTANT   (float32_t) 2.0
+#define VERTICAL_ESTIMATION_MAX_DT          (float32_t) 0.1 // Upper limit of the integration step [s]
+
 #define STATE_ESTIMATION_UPDATE_TIM                     TIM7
 #define STATE_ESTIMATION_UPDATE_TIM_CLK_ENABLE()        __TIM7_CLK_ENABLE()
 #define STATE_ESTIMATION_UPDATE_TIM_CLK_DISABLE()       __TIM7_CLK_DISABLE()
@@ -86,6 +242,7 @@ typedef struct AttitudeStateVector
 // TODO we need separate values for roll pitch and yaw as well as separate init values of P matrix
 #define	STATE_ESTIMATION_SAMPLE_PERIOD	(float32_t) 	FLIGHT_CONTROL_TASK_PERIOD / 1000.0
 
+/* Defaults of the noise parameters, see GetEstimatorNoiseParamGroup() */
 #define Q1_RP (float32_t)								0.0005
 #define	Q2_RP (float32_t)								0.0003
 
@@ -94,12 +251,59 @@ typedef struct AttitudeStateVector
 
 #define Q3_CAL (float32_t)                              0.000002
 
+/* Of a single magnetometer sample, the yaw correction with one averaged over MAG_DECIMATION samples uses
+ * R1_MAG / MAG_DECIMATION */
 #define R1_MAG (float32_t)								0.05
 #define	R1_ACCRP (float32_t)						   	0.06 /* .000185 480 measured from USB console and
                                                           * calculated with SensorVariance.sce
                                                           */
 //#define R2_CAL                                          0.005
 
+/* Accelerometer roll/pitch corrections are skipped when the accelerometer is not dominated by gravity, i.e. during
+ * manoeuvres and heavy vibration. A sample is rejected if its norm deviates more than the tolerance from G_ACC, or if
+ * the roll or pitch innovation exceeds the given number of standard deviations of the innovation covariance. The
+ * latter gate widens while corrections are skipped since P grows in the prediction; with constant gains P does not
+ * grow, so a sample is always accepted after the max number of consecutive innovation rejections. */
+#define STATE_ACC_GATE_NORM_TOLERANCE (float32_t)       0.15 // Relative to G_ACC
+#define STATE_ACC_GATE_INNOVATION_SIGMAS (float32_t)    3.0
+#define STATE_ACC_GATE_MAX_CONSECUTIVE_REJECTS          200 // ~1 s of accelerometer samples
+
+/* The vibration measured by the vibration monitor adds (rms / G_ACC)^2 [rad^2] to the roll/pitch noise R1_ACCRP of an
+ * accelerometer sample, up to the max factor, which is also used while the accelerometer clips. With constant gains
+ * the gains are scaled down by the factor instead, which is close for gains well below 1. */
+#define STATE_ACC_VIBRATION_MAX_NOISE_SCALE (float32_t) 10.0
+
+/* Warm start from the state stored in flash is only used if the UAV is at rest during startup, i.e. the gyroscope
+ * readings are close to the stored biases and the accelerometer only measures gravity */
+#define STATE_WARM_START_GYRO_SAMPLES                   32
+#define STATE_WARM_START_MAX_GYRO_DEVIATION (float32_t) 0.05 // [rad/s]
+#define STATE_WARM_START_MAX_BIAS (float32_t)           0.2 // [rad/s], stored biases above this are not trusted
+#define STATE_WARM_START_ACC_NORM_TOLERANCE (float32_t) 0.05 // Relative to G_ACC
+
+/* The gyroscope biases are seeded with the mean gyroscope reading over the startup window, if the UAV is at rest, i.e.
+ * the reading variance of all axes is below the limit and the accelerometer only measures gravity */
+#define STATE_STATIONARY_GYRO_WINDOW                    300 // [ms]
+#define STATE_STATIONARY_GYRO_MAX_VARIANCE (float32_t)  0.001 // [(rad/s)^2], a few times the gyroscope noise at rest
+
+/* The estimator is converged, and the UAV may be armed, once it has predicted for the settling time since its latest
+ * initialization and, with the full covariance Kalman filter, the roll and pitch error variances are below the limit,
+ * a fifth of their initial value, so that the accelerometer corrections have been taken */
+#define STATE_CONVERGENCE_TIME (float32_t)              2.0 // [s], the gyroscope biases settle within it at rest
+#define STATE_CONVERGED_MAX_ANGLE_VARIANCE (float32_t)  0.02 // [rad^2]
+
+/* The sensor noise characterisation runs a Welford mean and variance per sensor axis over the samples passed to the
+ * estimator while the UAV is at rest on the ground, with the same rest limits as the warm start. The roll, pitch & yaw
+ * noise is the sensor noise propagated through the attitude computation at the mean sample. Seeded noise variances
+ * more than the max ratio off the hand-tuned defaults are clamped, at rest the sensors are quieter than in flight. */
+#define SENSOR_NOISE_DEFAULT_DURATION (float32_t)      30.0 // [s]
+#define SENSOR_NOISE_MIN_DURATION (float32_t)          5.0 // [s]
+#define SENSOR_NOISE_MAX_DURATION (float32_t)          300.0 // [s]
+#define SENSOR_NOISE_MIN_SAMPLES                        50 // Of each attitude sensor
+#define SENSOR_NOISE_MAX_RATIO (float32_t)              1000.0
+
+/* Upper limit of the noise parameters */
+#define ESTIMATOR_NOISE_PARAM_MAX (float32_t)           1.0
+
 typedef enum {
     STATE_EST_ERROR = 0, STATE_EST_OK = !STATE_EST_ERROR
 } StateEstimationStatus;
@@ -116,14 +320,36 @@ float32_t GetYawAngle(void);
 float32_t GetRollRate(void);
 float32_t GetPitchRate(void);
 float32_t GetYawRate(void);
+void GetUnbiasedBodyRates(float32_t* dstRates);
+float32_t GetZPosition(void);
+float32_t GetZVelocity(void);
+void PublishStateSnapshot(void);
+void GetStateSnapshot(StateSnapshotType* dstSnapshot);
 
 void InitStatesXYZ(float32_t initAngles[3]);
+void InitStatesFrom(const StateInitType* init);
+void GetStateInit(StateInitType* dstInit);
+bool IsStateEstimationConverged(void);
 StateEstimationStatus InitStateEstimationTimeEvent(void);
-void UpdatePredictionState(void);
-void UpdateCorrectionState(FcbSensorIndexType sensorType, float32_t const * pXYZ);
+RAMFUNC void UpdatePredictionState(void);
+RAMFUNC void UpdatePredictionStateAt(const uint32_t timestamp);
+RAMFUNC void UpdateCorrectionState(FcbSensorIndexType sensorType, float32_t const * pXYZ, uint32_t timestamp);
+
+void GetAccCorrectionGateStats(AccCorrectionGateStatsType* dstStats);
+void GetDelayedFusionStats(DelayedFusionStatsType* dstStats);
+
+FcbRetValType GetStateWarmStart(StateWarmStartType* dstWarmStart);
+FcbRetValType WarmStartStates(const StateWarmStartType* warmStart);
+FcbRetValType SeedGyroBiases(const float32_t biases[AXES_NPR]);
+
+FcbRetValType StartSensorNoiseCharacterisation(const float32_t duration);
+SensorNoiseStatusType GetSensorNoise(SensorNoiseType* dstNoise);
+FcbRetValType SeedSensorNoise(const SensorNoiseType* noise);
+size_t PrintSensorNoise(char* dst, const size_t dstSize);
+
+void InitEstimatorNoise(void);
+const ParamGroup_TypeDef* GetEstimatorNoiseParamGroup(void);
 
-FcbRetValType StartStateSamplingTask(const uint16_t sampleTime, const uint32_t sampleDuration);
-FcbRetValType StopStateSamplingTask(void);
 
 void PrintStateValues(void);
 
@@ -0,0 +1,110 @@
+/******************************************************************************
+ * @file    stick_curves.h
+ * @brief   Header file for the stick curves, which shape the RC stick inputs
+ *          with a deadband, expo and super rate per axis. The curves are
+ *          compiled into interpolating lookup tables whenever they are set,
+ *          so the flight control maps a stick with one lookup per axis and
+ *          control cycle instead of evaluating the curve.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_STICK_CURVES_H_
+#define INC_STICK_CURVES_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include "arm_math.h"
+#include "fcb_retval.h"
+#include "ram_func.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Exported types ------------------------------------------------------------*/
+
+typedef enum StickAxis {
+    STICK_AXIS_THROTTLE = 0,    // Z velocity reference
+    STICK_AXIS_ROLL,            // Roll angle or rate reference
+    STICK_AXIS_PITCH,           // Pitch angle or rate reference
+    STICK_AXIS_YAW,             // Yaw rate reference
+    STICK_AXIS_NBR
+} StickAxisType;
+
+/* Shape of the curve of an axis. With the stick deflection x in [0, 1] outside the deadband scaled to [0, 1], the expo
+ * blends x with x^3 and the super rate then divides by (1 - superRate*x), normalised so that full deflection gives the
+ * full reference. Both soften the center and keep the full range, the reference limits set the full range itself. */
+typedef struct StickCurve {
+    float32_t deadband;         // Deflection around the center that maps to 0, in [0, STICK_CURVE_MAX_DEADBAND]
+    float32_t expo;             // In [0, 1], 0 is linear
+    float32_t superRate;        // In [0, STICK_CURVE_MAX_SUPER_RATE], 0 is none
+} StickCurveType;
+
+/* Stick curves as stored in flash */
+typedef struct StickCurveSettings {
+    StickCurveType curves[STICK_AXIS_NBR];
+} StickCurveSettingsType;
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Points of a lookup table over the deflection [0, 1] of one stick side, the other side is mirrored. The linear
+ * interpolation error is below 1 % of the full range for all curves within the limits. */
+#define STICK_CURVE_LUT_SIZE            33
+
+#define STICK_CURVE_MAX_DEADBAND        ((float32_t) 0.25)
+#define STICK_CURVE_MAX_SUPER_RATE      ((float32_t) 0.8)
+
+/* The defaults are linear, with the zero zone of RECEIVER_TO_REFERENCE_ZERO_PADDING, see flight_control.h */
+#define STICK_CURVE_DEFAULT_DEADBAND    ((float32_t) RECEIVER_TO_REFERENCE_ZERO_PADDING/INT16_MAX)
+#define STICK_CURVE_DEFAULT_EXPO        ((float32_t) 0.0)
+#define STICK_CURVE_DEFAULT_SUPER_RATE  ((float32_t) 0.0)
+
+/* Exported functions ------------------------------------------------------- */
+
+/**
+ * Loads the curves from flash, or the defaults if there are none, and builds
+ * the lookup tables. Called by the flight control task at startup.
+ */
+void InitStickCurves(void);
+
+/**
+ * Sets the curve of an axis and rebuilds its lookup table, effective from
+ * the next control cycle.
+ *
+ * @param axis see StickAxisType
+ * @param curve within the ranges of StickCurveType
+ * @return FCB_OK, FCB_ERR if the axis or the curve is not valid
+ */
+FcbRetValType SetStickCurve(const StickAxisType axis, const StickCurveType* curve);
+FcbRetValType GetStickCurve(const StickAxisType axis, StickCurveType* curve);
+
+/**
+ * Saves the curves of all axes to flash, idle mode only.
+ *
+ * @return FCB_OK, FCB_ERR if not in idle mode or if writing the flash failed
+ */
+FcbRetValType SaveStickCurves(void);
+
+/**
+ * Maps a receiver channel value with the curve of an axis, one table lookup.
+ * Called by the flight control task.
+ *
+ * @param axis see StickAxisType
+ * @param receiverValue channel value in [INT16_MIN, INT16_MAX]
+ * @return the shaped stick in [-1, 1], with the sign of the channel value
+ */
+RAMFUNC float32_t ApplyStickCurve(const StickAxisType axis, const int32_t receiverValue);
+
+const char* GetStickAxisName(const StickAxisType axis);
+size_t PrintStickCurves(char* dst, const size_t dstSize);
+
+#endif /* INC_STICK_CURVES_H_ */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
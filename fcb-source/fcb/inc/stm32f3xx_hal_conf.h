@@ -51,8 +51,8 @@
   * @brief This is the list of modules to be used in the HAL driver 
   */
 #define HAL_MODULE_ENABLED
-// #define HAL_ADC_MODULE_ENABLED
-// #define HAL_CAN_MODULE_ENABLED
+#define HAL_ADC_MODULE_ENABLED
+#define HAL_CAN_MODULE_ENABLED
 // #define HAL_CEC_MODULE_ENABLED
 // #define HAL_COMP_MODULE_ENABLED
 #define HAL_CORTEX_MODULE_ENABLED
@@ -18,7 +18,6 @@ extern "C" {
 /* Includes ------------------------------------------------------------------*/
 #include "receiver.h"
 #include "uart.h"
-#include "task_status.h"
 
 /* Exported types ------------------------------------------------------------*/
 /* Exported constants --------------------------------------------------------*/
@@ -39,9 +38,9 @@ void EXTI0_IRQHandler(void);
 void PVD_IRQHandler(void);
 void PRIMARY_RECEIVER_TIM_IRQHandler(void);
 void AUX_RECEIVER_TIM_IRQHandler(void);
-void TASK_STATUS_TIM_IRQHandler(void);
 void UART_DMA_RX_IRQHandler(void);
 void UART_DMA_TX_IRQHandler(void);
+void CRC_DMA_IRQHandler(void);
 
 #if defined (USE_USB_INTERRUPT_DEFAULT)
 void USB_LP_CAN_RX0_IRQHandler(void);
@@ -0,0 +1,140 @@
+/******************************************************************************
+ * @file    system_identification.h
+ * @brief   Header file for the on-board system identification, which adds an
+ *          excitation to the roll, pitch or yaw moment command of the motor
+ *          allocation in flight. The excitation is either an exponential chirp
+ *          sweeping from fMin to fMax over the duration, or a PRBS of a 16-bit
+ *          maximal length sequence whose bit rate puts its flat spectrum up to
+ *          fMax. It fades in and out over SYSID_FADE_TIME, and is added on top
+ *          of the closed loop control, which keeps stabilizing the UAV.
+ *
+ *          The excitation, the moment commands with it and the axis are logged
+ *          to the blackbox in the same control cycle as the gyroscope sample,
+ *          at the rate of the motor allocation with a blackbox decimation of 1.
+ *          The frequency response of the moment to the angular rate on the
+ *          host is then the cross spectrum of the excitation and the rate over
+ *          the cross spectrum of the excitation and the moment command, which
+ *          stays unbiased by the feedback, and the delay is the slope of its
+ *          phase over the frequency.
+ *
+ *          An identification is started from the CLI in any of the stabilized
+ *          flight modes, a switch to idle or raw mode aborts it.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_SYSTEM_IDENTIFICATION_H_
+#define INC_SYSTEM_IDENTIFICATION_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include "arm_math.h"
+#include "fcb_retval.h"
+#include "ram_func.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Uncomment to add the identification excitation to the motor allocation and the blackbox, see above */
+//#define FCB_SYSTEM_IDENTIFICATION
+
+/* Exported types ------------------------------------------------------------*/
+
+typedef enum {
+    SYSID_AXIS_ROLL = 0,
+    SYSID_AXIS_PITCH,
+    SYSID_AXIS_YAW,
+    SYSID_AXIS_NBR
+} SysIdAxisType;
+
+typedef enum {
+    SYSID_SIGNAL_CHIRP = 0,
+    SYSID_SIGNAL_PRBS,
+    SYSID_SIGNAL_NBR
+} SysIdSignalType;
+
+typedef enum {
+    SYSID_OFF = 0,
+    SYSID_RUNNING,
+    SYSID_DONE,                     // The excitation ran for its duration
+    SYSID_ABORTED                   // Stopped, or the flight mode left the stabilized modes
+} SysIdStateType;
+
+typedef struct {
+    SysIdAxisType axis;
+    SysIdSignalType signal;
+    float32_t amplitude;            // [Nm]
+    float32_t duration;             // [s]
+    float32_t fMin;                 // [Hz], the chirp start frequency, not used by the PRBS
+    float32_t fMax;                 // [Hz]
+} SysIdConfigType;
+
+typedef struct {
+    SysIdStateType state;
+    SysIdConfigType config;
+    float32_t samplePeriod;         // Of the motor allocation [s]
+    float32_t elapsed;              // [s] of excitation
+} SysIdStatusType;
+
+/* Excitation and moment commands of the latest motor allocation, as logged */
+typedef struct {
+    uint8_t axis;                   // SysIdAxisType + 1 while the excitation runs, 0 otherwise
+    float32_t excitation;           // [Nm]
+    float32_t moments[3];           // Roll, pitch and yaw moment commands with the excitation [Nm]
+} SysIdSampleType;
+
+/* Exported constants --------------------------------------------------------*/
+
+#define SYSID_MAX_AMPLITUDE             ((float32_t) 0.3)   // Part of the axis moment range
+#define SYSID_MIN_DURATION              ((float32_t) 2.0)   // [s]
+#define SYSID_MAX_DURATION              ((float32_t) 60.0)  // [s]
+#define SYSID_MIN_FREQUENCY             ((float32_t) 0.1)   // [Hz]
+#define SYSID_MAX_FREQUENCY_RATIO       ((float32_t) 0.25)  // fMax of the motor allocation rate, to resolve its phase
+#define SYSID_FADE_TIME                 ((float32_t) 0.5)   // [s] of the excitation fade in and out
+#define SYSID_PRBS_BIT_RATE_FACTOR      ((float32_t) 2.5)   // Bit rate of fMax, the spectrum is -3 dB at 0.44 of it
+
+/* Exported functions ------------------------------------------------------- */
+
+/**
+ * Starts an identification, effective from the next control cycle on.
+ *
+ * @param config excitation, see SysIdConfigType and the limits above
+ * @return FCB_OK, FCB_ERR if not in a stabilized flight mode or if the
+ *         configuration is not valid
+ */
+FcbRetValType StartSystemIdentification(const SysIdConfigType* config);
+void StopSystemIdentification(void);
+
+/**
+ * Ends the identification once the excitation has run for its duration, and
+ * aborts it when the flight mode leaves the stabilized modes. Called by the
+ * flight control task on every control cycle.
+ */
+void UpdateSystemIdentification(void);
+
+/**
+ * Adds the excitation to the moment commands and records them for the
+ * blackbox. Called by the contexts of the motor allocation, uses no FreeRTOS
+ * API.
+ *
+ * @param moments roll, pitch and yaw moment commands [Nm], changed in place
+ */
+RAMFUNC void AddSystemIdentificationExcitation(float32_t moments[3]);
+
+void GetSystemIdentificationSample(SysIdSampleType* dstSample);
+void GetSystemIdentificationStatus(SysIdStatusType* dstStatus);
+const char* GetSysIdAxisName(const SysIdAxisType axis);
+const char* GetSysIdSignalName(const SysIdSignalType signal);
+size_t PrintSystemIdentificationStatus(char* dst, const size_t dstSize);
+
+#endif /* INC_SYSTEM_IDENTIFICATION_H_ */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
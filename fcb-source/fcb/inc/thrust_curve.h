@@ -0,0 +1,159 @@
+/******************************************************************************
+ * @file    thrust_curve.h
+ * @brief   Header file for the thrust curves, which linearize the motor
+ *          outputs of the physical motor allocation. The mixer maps forces to
+ *          motor signal values with the linear fit T(m) = AT*m + BT of
+ *          airframe.h. Each motor instead gets a quadratic curve of its
+ *          identified thrust, which is inverted into an interpolating lookup
+ *          table whenever it is set, so the allocation turns the linear
+ *          signal of a motor into the output that gives its thrust with one
+ *          lookup per motor and control cycle. The drag torque is taken to
+ *          stay proportional to the thrust, AQ/AT, so the yaw authority
+ *          follows the same curve.
+ *
+ *          The curves are identified on a test stand with a load cell, in
+ *          idle mode: StartThrustTest() spins one motor at a fixed output,
+ *          AddThrustTestPoint() records the thrust read from the load cell at
+ *          it, and after a sweep of outputs FitThrustTestCurve() fits the
+ *          curve of the motor to the points by least squares. The points are
+ *          scaled to BATTERY_NOMINAL_CELL_VOLTAGE with the pack voltage at
+ *          each of them, so the battery thrust compensation of the
+ *          allocation, see fcb_battery.h, holds for the identified curves as
+ *          for the linear fit.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef INC_THRUST_CURVE_H_
+#define INC_THRUST_CURVE_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include "arm_math.h"
+#include "motor_control.h"
+#include "fcb_retval.h"
+#include "ram_func.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Thrust T(x) = c[0] + c[1]*x + c[2]*x^2 [N] of the motor output x in [0, 1] at BATTERY_NOMINAL_CELL_VOLTAGE. It has to
+ * rise over the whole output range, c[0] is negative for the outputs at which the motor does not start yet. */
+typedef struct ThrustCurve {
+    float32_t c[3];
+} ThrustCurveType;
+
+/* Thrust curves as stored in flash */
+typedef struct ThrustCurveSettings {
+    ThrustCurveType curves[MOTOR_OUTPUT_CHANNELS];
+} ThrustCurveSettingsType;
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Points of a lookup table over the motor signal values [0, UINT16_MAX] of the linear fit. The interpolation is exact
+ * for the linear fit, and within 1 % of the output range for curves with c[1] of at least a quarter of c[2]. */
+#define THRUST_CURVE_LUT_SIZE           33
+
+/* The default curves are the linear fit of airframe.h, i.e. no linearization */
+#define THRUST_CURVE_DEFAULT_C0         ((float32_t) BT)
+#define THRUST_CURVE_DEFAULT_C1         ((float32_t) AT*UINT16_MAX)
+#define THRUST_CURVE_DEFAULT_C2         ((float32_t) 0.0)
+
+#define THRUST_TEST_TIMEOUT             10000   // [ms] a motor test runs without a new output before it stops
+#define THRUST_TEST_MAX_OUTPUT          ((float32_t) 1.0)
+#define THRUST_TEST_MAX_POINTS          16      // Of the motor under test
+#define THRUST_TEST_MIN_POINTS          5       // For a fit
+
+/* Exported functions ------------------------------------------------------- */
+
+/**
+ * Loads the curves from flash, or the defaults if there are none or any is
+ * not valid, and builds the lookup tables. Called before the scheduler is
+ * started.
+ */
+void InitThrustCurves(void);
+
+/**
+ * Sets the curve of a motor and rebuilds its lookup table, idle mode only.
+ *
+ * @param motor motor index, 0 for motor 1
+ * @param curve rising over the output range
+ * @return FCB_OK, FCB_ERR if not in idle mode or if the motor or the curve is
+ *         not valid
+ */
+FcbRetValType SetThrustCurve(const uint8_t motor, const ThrustCurveType* curve);
+FcbRetValType GetThrustCurve(const uint8_t motor, ThrustCurveType* curve);
+
+/**
+ * Saves the curves of all motors to flash, idle mode only.
+ *
+ * @return FCB_OK, FCB_ERR if not in idle mode or if writing the flash failed
+ */
+FcbRetValType SaveThrustCurves(void);
+
+/**
+ * Maps the motor signal values of the physical mixer, linear in the thrust,
+ * to the outputs that give that thrust with the curve of each motor. Called
+ * by the context of the motor allocation.
+ *
+ * @param motorValues motor signal values [0, UINT16_MAX], mapped in place
+ */
+RAMFUNC void LinearizeMotorThrust(int32_t motorValues[MOTOR_OUTPUT_CHANNELS]);
+
+/**
+ * Spins one motor at a fixed output for THRUST_TEST_TIMEOUT, the others
+ * stopped. Idle mode only, a flight mode transition stops the test. A test
+ * of another motor than the previous one drops its points.
+ *
+ * @param motor motor index, 0 for motor 1
+ * @param output in [0, THRUST_TEST_MAX_OUTPUT]
+ * @return FCB_OK, FCB_ERR if not in idle mode or if the motor or the output
+ *         is not valid
+ */
+FcbRetValType StartThrustTest(const uint8_t motor, const float32_t output);
+void StopThrustTest(void);
+
+/**
+ * Sets the motor outputs of a running test. Called by the flight control task
+ * in idle mode, instead of stopping the motors.
+ *
+ * @return true if a test is running, false if the motors are to be stopped
+ */
+bool UpdateThrustTest(void);
+
+/**
+ * Records the thrust at the output of the running test.
+ *
+ * @param thrust read from the load cell [N]
+ * @return FCB_OK, FCB_ERR if no test is running, the thrust is negative or
+ *         all THRUST_TEST_MAX_POINTS are used
+ */
+FcbRetValType AddThrustTestPoint(const float32_t thrust);
+
+/**
+ * Fits the curve of the tested motor to its points by least squares and sets
+ * it, idle mode only.
+ *
+ * @param dstCurve destination of the fitted curve
+ * @param dstRmsError destination of the RMS thrust error of the points [N]
+ * @param dstMotor destination of the motor index
+ * @return FCB_OK, FCB_ERR if there are fewer than THRUST_TEST_MIN_POINTS
+ *         points or if the fitted curve does not rise over the output range
+ */
+FcbRetValType FitThrustTestCurve(ThrustCurveType* dstCurve, float32_t* dstRmsError, uint8_t* dstMotor);
+
+size_t PrintThrustCurves(char* dst, const size_t dstSize);
+
+#endif /* INC_THRUST_CURVE_H_ */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
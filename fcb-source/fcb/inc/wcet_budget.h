@@ -0,0 +1,54 @@
+/******************************************************************************
+ * @file    wcet_budget.h
+ * @author  Dragonfly
+ * @brief   Timing budgets of the WCET test, see wcet_test.h. The test fails if
+ *          the maximum it measures under the worst-case load exceeds one of
+ *          them. A budget of 0 reports the stage without checking it.
+ *
+ *          The budgets are in us at the 72 MHz core clock. They are a share of
+ *          the fastest period the stage runs at, the 760 Hz gyroscope data
+ *          rate (1316 us) or the 5 ms flight control period, and are tightened
+ *          as measured runs allow. A change of a budget is reviewed like a
+ *          change of the code it covers.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __WCET_BUDGET_H
+#define __WCET_BUDGET_H
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Code sections of the profiling probes, see ProfileProbe_TypeDef */
+#define WCET_BUDGET_PREDICTION              150     // [us] UpdatePredictionState()
+#define WCET_BUDGET_CORRECTION              150     // [us] UpdateCorrectionState()
+#define WCET_BUDGET_PID                     150     // [us] UpdatePIDControlSignals()
+#define WCET_BUDGET_MOTOR_ALLOCATION        60      // [us] MotorAllocationPhysical(), desaturation included
+#define WCET_BUDGET_GYRO_FETCH              100     // [us] Gyroscope read, filtering and hand-over
+#define WCET_BUDGET_GYRO_DRDY_ISR           20      // [us]
+#define WCET_BUDGET_GYRO_DMA_ISR            20      // [us]
+#define WCET_BUDGET_REF_SIGNALS             50      // [us] SetRefSignals()
+#define WCET_BUDGET_BARO_FETCH              100     // [us] Pressure compensation and altitude, the I2C reads do not block
+
+/* Execution time of the control loops, see DeadlineLoop_TypeDef */
+#define WCET_BUDGET_INNER_LOOP              400     // [us] ~30% of the gyroscope period
+#define WCET_BUDGET_OUTER_LOOP              1000    // [us] 20% of the flight control period
+#define WCET_BUDGET_ESTIMATOR_LOOP          400     // [us]
+
+/* Largest deviation of a loop period from the expected one */
+#define WCET_BUDGET_INNER_LOOP_JITTER       650     // [us] Half the gyroscope period
+#define WCET_BUDGET_OUTER_LOOP_JITTER       1000    // [us] One tick of the flight control period
+#define WCET_BUDGET_ESTIMATOR_LOOP_JITTER   1000    // [us]
+
+/* End-to-end control latency, gyroscope data ready to motor output, see latency_monitor.h */
+#define WCET_BUDGET_GYRO_TO_MOTOR           1000    // [us]
+
+#endif /* __WCET_BUDGET_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,99 @@
+/******************************************************************************
+ * @file    wcet_test.h
+ * @author  Dragonfly
+ * @brief   Header file for the worst-case execution time (WCET) test, a bench
+ *          pass/fail gate for the timing of the flight pipeline. For the test
+ *          duration the physical sensor pipeline runs under the worst-case
+ *          load the flight code can put on itself:
+ *            - the PID control path runs in idle mode on references at their
+ *              limits, alternating in sign each update, so that the
+ *              controllers and the mixer desaturation are saturated
+ *            - the online magnetometer calibration updates on every sample
+ *            - all telemetry streams are sampled at their fastest rates
+ *            - a CLI command is run every tick, at the priority of the low
+ *              deferred worker that runs the com port commands
+ *            - a settings record is queued to the flash writer every
+ *              WCET_TEST_FLASH_WRITE_PERIOD, and held as in flight
+ *          At the end the maxima of the profiling probes, of the control loop
+ *          execution times and period jitter, and of the gyroscope to motor
+ *          latency are checked against the budgets of wcet_budget.h.
+ *
+ *          Interlock: while the test is active the motor outputs are not
+ *          driven. The test starts in idle mode only and is aborted when the
+ *          flight control leaves it.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __WCET_TEST_H
+#define __WCET_TEST_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "fcb_retval.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Uncomment to compile in the WCET test and its CLI commands. Needs the profiling probes, leave commented for flight
+ * builds. */
+//#define FCB_WCET_TEST
+
+#if defined(FCB_WCET_TEST) && !defined(FCB_PROFILING)
+#error "The stage times of the WCET test are those of the profiling probes, define FCB_PROFILING"
+#endif
+
+#if defined(FCB_WCET_TEST) && defined(FCB_CONTROL_EXECUTIVE)
+#error "The control executive only runs the rate loop in the stabilized modes, which the WCET test does not enter"
+#endif
+
+#if defined(FCB_WCET_TEST) && defined(FCB_HIL_MODE)
+#error "The WCET test times the physical sensor pipeline, which HIL mode locks out"
+#endif
+
+#define WCET_TEST_MAX_DURATION          600000  // [ms]
+#define WCET_TEST_FLASH_WRITE_PERIOD    1000    // [ms]
+
+/* Exported types ------------------------------------------------------------*/
+
+typedef enum {
+    WCET_TEST_NOT_RUN = 0,
+    WCET_TEST_RUNNING,
+    WCET_TEST_PASSED,
+    WCET_TEST_FAILED,               // A budget was exceeded
+    WCET_TEST_ABORTED               // Stopped before its duration, or the flight control left idle mode
+} WcetTestResult_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+#ifdef FCB_WCET_TEST
+
+/* True while the worst-case load is applied and the motor outputs are interlocked */
+#define WCET_TEST_IS_ACTIVE()           WcetTestIsActive()
+
+#else
+
+#define WCET_TEST_IS_ACTIVE()           (false)
+
+#endif /* FCB_WCET_TEST */
+
+/* Exported function prototypes --------------------------------------------- */
+#ifdef FCB_WCET_TEST
+void CreateWcetTestTask(void);
+FcbRetValType WcetTestStart(const uint32_t duration);
+void WcetTestStop(void);
+bool WcetTestIsActive(void);
+WcetTestResult_TypeDef GetWcetTestResult(void);
+size_t WcetTestPrint(char* dst, const size_t dstSize);
+#endif
+
+#endif /* __WCET_TEST_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,337 @@
+/******************************************************************************
+ * @brief   Airframe simulation model for software-in-the-loop runs of the
+ *          flight code. The motor signal values are mapped to thrust and drag
+ *          torque with the fits of airframe.h, lagged by the motor time
+ *          constant, and summed to a body force and torque with the mixer
+ *          factors of FCB_AIRFRAME. The rigid body is integrated with Euler's
+ *          equations for the principal moments of inertia and a quaternion
+ *          attitude. The sensor models read the true rates and the specific
+ *          force and add bias, white noise, motor vibration and delay.
+ *
+ * @license
+ * Dragonfly FCB firmware to control the Dragonfly quadrotor UAV
+ * Copyright (C) 2016  ÅF Technology South: Dragonfly Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *****************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "airframe_sim.h"
+
+#include <math.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+
+/* Columns of the airframe factors, as the MIXER_*_IDX of motor_mixer.h */
+#define SIM_THRUST_IDX          0
+#define SIM_ROLL_IDX            1
+#define SIM_PITCH_IDX           2
+#define SIM_YAW_IDX             3
+
+#define SIM_MOTOR_SIGNAL_MAX    ((float32_t) UINT16_MAX) // As MIXER_MOTOR_SIGNAL_MAX
+#define SIM_DEFAULT_SEED        0x2545F491
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static const float32_t airframeFactors[AIRFRAME_NBR_OF_MOTORS][4] = AIRFRAME_FACTORS;
+static const float32_t inertia[3] = { IXX, IYY, IZZ };
+
+/* Private function prototypes -----------------------------------------------*/
+static void UpdateMotors(AirframeSim_TypeDef* sim, const int32_t motorValues[], const float32_t dt);
+static void UpdateRigidBody(AirframeSim_TypeDef* sim, const float32_t dt);
+static void UpdateSensors(AirframeSim_TypeDef* sim, const float32_t dt);
+static void QuaternionToDCM(const float32_t* q, float32_t* dcm);
+static float32_t RandomNormal(uint32_t* state);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Gets the default model parameters: the motor lag, noise and vibration of a typical quadrotor, no bias
+ * @param  config : Destination model parameters
+ * @retval None
+ */
+void AirframeSimGetDefaultConfig(AirframeSimConfig_TypeDef* config) {
+    memset(config, 0, sizeof(AirframeSimConfig_TypeDef));
+    config->motorTimeConstant = AIRFRAME_SIM_DEFAULT_MOTOR_TIME_CONSTANT;
+    config->drag = AIRFRAME_SIM_DEFAULT_DRAG;
+    config->gyroNoise = AIRFRAME_SIM_DEFAULT_GYRO_NOISE;
+    config->accNoise = AIRFRAME_SIM_DEFAULT_ACC_NOISE;
+    config->vibrationAmplitude = AIRFRAME_SIM_DEFAULT_VIBRATION;
+    config->vibrationFrequency = AIRFRAME_SIM_DEFAULT_VIBRATION_FREQUENCY;
+    config->sensorDelay = AIRFRAME_SIM_DEFAULT_SENSOR_DELAY;
+    config->seed = SIM_DEFAULT_SEED;
+}
+
+/*
+ * @brief  Initializes the model level and at rest on the ground, with the motors stopped
+ * @param  sim : Model instance
+ * @param  config : Model parameters, copied into the instance
+ * @retval None
+ */
+void AirframeSimInit(AirframeSim_TypeDef* sim, const AirframeSimConfig_TypeDef* config) {
+    uint8_t i;
+
+    memset(sim, 0, sizeof(AirframeSim_TypeDef));
+    sim->config = *config;
+    if (sim->config.sensorDelay > AIRFRAME_SIM_MAX_SENSOR_DELAY) {
+        sim->config.sensorDelay = AIRFRAME_SIM_MAX_SENSOR_DELAY;
+    }
+
+    sim->quaternion[0] = 1.0f;
+    sim->onGround = true;
+    sim->specificForce[2] = -AIRFRAME_SIM_G_ACC;
+    sim->random = (config->seed != 0) ? config->seed : SIM_DEFAULT_SEED; // xorshift has no zero state
+
+    /* The delayed samples before the first step are those of the model at rest */
+    for (i = 0; i <= AIRFRAME_SIM_MAX_SENSOR_DELAY; i++) {
+        sim->accHistory[i][2] = -AIRFRAME_SIM_G_ACC;
+    }
+}
+
+/*
+ * @brief  Advances the model one time step
+ * @param  sim : Model instance
+ * @param  motorValues : Motor signal values of the AIRFRAME_NBR_OF_MOTORS motors, as from the motor mixer
+ * @param  dt : Time step [s], e.g. the gyroscope sample period
+ * @retval None
+ */
+void AirframeSimStep(AirframeSim_TypeDef* sim, const int32_t motorValues[], const float32_t dt) {
+    UpdateMotors(sim, motorValues, dt);
+    UpdateRigidBody(sim, dt);
+    UpdateSensors(sim, dt);
+    sim->time += dt;
+}
+
+/*
+ * @brief  Gets the sensor readings, sensorDelay steps old, in the units of the sensor drivers
+ * @param  sim : Model instance
+ * @param  gyro : Destination body angular rates [rad/s]
+ * @param  acc : Destination body specific force [m/s^2], reads -G along z at rest
+ * @retval None
+ */
+void AirframeSimGetSensors(const AirframeSim_TypeDef* sim, float32_t gyro[3], float32_t acc[3]) {
+    uint8_t index = (sim->historyIndex + AIRFRAME_SIM_MAX_SENSOR_DELAY + 1 - sim->config.sensorDelay)
+            % (AIRFRAME_SIM_MAX_SENSOR_DELAY + 1);
+
+    memcpy(gyro, sim->gyroHistory[index], 3*sizeof(float32_t));
+    memcpy(acc, sim->accHistory[index], 3*sizeof(float32_t));
+}
+
+/*
+ * @brief  Gets the true attitude, to compare with the estimated one
+ * @param  sim : Model instance
+ * @param  attitude : Destination roll, pitch and yaw angles [rad]
+ * @retval None
+ */
+void AirframeSimGetAttitude(const AirframeSim_TypeDef* sim, float32_t attitude[3]) {
+    const float32_t* q = sim->quaternion;
+    float32_t sinPitch = 2.0f*(q[0]*q[2] - q[3]*q[1]);
+
+    sinPitch = (sinPitch > 1.0f) ? 1.0f : ((sinPitch < -1.0f) ? -1.0f : sinPitch);
+    attitude[0] = atan2f(2.0f*(q[0]*q[1] + q[2]*q[3]), 1.0f - 2.0f*(q[1]*q[1] + q[2]*q[2]));
+    attitude[1] = asinf(sinPitch);
+    attitude[2] = atan2f(2.0f*(q[0]*q[3] + q[1]*q[2]), 1.0f - 2.0f*(q[2]*q[2] + q[3]*q[3]));
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Lags the thrust and drag torque of each motor towards those of its signal value
+ * @param  sim : Model instance
+ * @param  motorValues : Motor signal values
+ * @param  dt : Time step [s]
+ * @retval None
+ */
+static void UpdateMotors(AirframeSim_TypeDef* sim, const int32_t motorValues[], const float32_t dt) {
+    float32_t alpha = dt / (sim->config.motorTimeConstant + dt);
+    float32_t level = 0.0f;
+    float32_t value;
+    uint8_t i;
+
+    for (i = 0; i < AIRFRAME_NBR_OF_MOTORS; i++) {
+        value = (float32_t) motorValues[i];
+        value = (value < 0.0f) ? 0.0f : ((value > SIM_MOTOR_SIGNAL_MAX) ? SIM_MOTOR_SIGNAL_MAX : value);
+        level += value;
+
+        sim->motorThrust[i] += alpha * (AT*value + BT - sim->motorThrust[i]);
+        sim->motorTorque[i] += alpha * (AQ*value - sim->motorTorque[i]);
+    }
+
+    sim->vibrationLevel = level / (AIRFRAME_NBR_OF_MOTORS * SIM_MOTOR_SIGNAL_MAX);
+}
+
+/*
+ * @brief  Integrates the rigid body one time step, with the landing gear holding it on the ground until the thrust
+ *         lifts it
+ * @param  sim : Model instance
+ * @param  dt : Time step [s]
+ * @retval None
+ */
+static void UpdateRigidBody(AirframeSim_TypeDef* sim, const float32_t dt) {
+    float32_t force[3] = { 0.0f, 0.0f, 0.0f }; // Body frame [N]
+    float32_t torque[3] = { 0.0f, 0.0f, 0.0f }; // Body frame [Nm]
+    float32_t acc[3]; // Inertial frame [m/s^2]
+    float32_t dcm[9];
+    float32_t* w = sim->angleRate;
+    float32_t* q = sim->quaternion;
+    float32_t dq[4];
+    float32_t norm;
+    uint8_t i;
+
+    /* Thrust along -z, roll & pitch torque from the motor positions and yaw torque from the rotor drag */
+    for (i = 0; i < AIRFRAME_NBR_OF_MOTORS; i++) {
+        force[2] -= airframeFactors[i][SIM_THRUST_IDX] * sim->motorThrust[i];
+        torque[0] += airframeFactors[i][SIM_ROLL_IDX] * LENGTH_ARM * sim->motorThrust[i];
+        torque[1] += airframeFactors[i][SIM_PITCH_IDX] * LENGTH_ARM * sim->motorThrust[i];
+        torque[2] += airframeFactors[i][SIM_YAW_IDX] * sim->motorTorque[i];
+    }
+
+    /* Translation in the inertial frame: gravity, thrust rotated to the inertial frame and drag */
+    QuaternionToDCM(q, dcm);
+    for (i = 0; i < 3; i++) {
+        acc[i] = (dcm[3*i]*force[0] + dcm[3*i+1]*force[1] + dcm[3*i+2]*force[2]
+                - sim->config.drag * sim->velocity[i]) / MASS;
+    }
+    acc[2] += AIRFRAME_SIM_G_ACC;
+
+    if (sim->onGround && acc[2] >= 0.0f) {
+        /* Resting on the landing gear, no motion and the frame holds the attitude */
+        memset(acc, 0, sizeof(acc));
+        memset(sim->velocity, 0, sizeof(sim->velocity));
+        memset(w, 0, 3*sizeof(float32_t));
+    } else {
+        sim->onGround = false;
+
+        /* Euler's equations for the principal axes: I*dw/dt = torque - w x (I*w) */
+        dq[0] = (torque[0] - (inertia[2] - inertia[1]) * w[1] * w[2]) / inertia[0];
+        dq[1] = (torque[1] - (inertia[0] - inertia[2]) * w[2] * w[0]) / inertia[1];
+        dq[2] = (torque[2] - (inertia[1] - inertia[0]) * w[0] * w[1]) / inertia[2];
+        for (i = 0; i < 3; i++) {
+            w[i] += dq[i] * dt;
+        }
+
+        /* Quaternion kinematics dq/dt = 0.5*q*(0, w), then renormalization */
+        dq[0] = 0.5f * (-q[1]*w[0] - q[2]*w[1] - q[3]*w[2]);
+        dq[1] = 0.5f * (q[0]*w[0] + q[2]*w[2] - q[3]*w[1]);
+        dq[2] = 0.5f * (q[0]*w[1] - q[1]*w[2] + q[3]*w[0]);
+        dq[3] = 0.5f * (q[0]*w[2] + q[1]*w[1] - q[2]*w[0]);
+        norm = 0.0f;
+        for (i = 0; i < 4; i++) {
+            q[i] += dq[i] * dt;
+            norm += q[i] * q[i];
+        }
+        norm = 1.0f / sqrtf(norm);
+        for (i = 0; i < 4; i++) {
+            q[i] *= norm;
+        }
+
+        for (i = 0; i < 3; i++) {
+            sim->velocity[i] += acc[i] * dt;
+            sim->position[i] += sim->velocity[i] * dt;
+        }
+
+        /* Touchdown */
+        if (sim->position[2] >= 0.0f && sim->velocity[2] >= 0.0f) {
+            sim->position[2] = 0.0f;
+            sim->onGround = true;
+        }
+    }
+
+    /* Specific force, what the accelerometer measures, is the acceleration minus gravity in the body frame */
+    acc[2] -= AIRFRAME_SIM_G_ACC;
+    for (i = 0; i < 3; i++) {
+        sim->specificForce[i] = dcm[i]*acc[0] + dcm[3+i]*acc[1] + dcm[6+i]*acc[2];
+    }
+}
+
+/*
+ * @brief  Samples the gyroscope and accelerometer models into the delay line
+ * @param  sim : Model instance
+ * @param  dt : Time step [s]
+ * @retval None
+ */
+static void UpdateSensors(AirframeSim_TypeDef* sim, const float32_t dt) {
+    const AirframeSimConfig_TypeDef* config = &sim->config;
+    float32_t vibration;
+    uint8_t i;
+
+    /* The vibration follows the rotor speed, the lateral axes see less of it than the thrust axis */
+    sim->vibrationPhase += 2.0f * PI * config->vibrationFrequency * sim->vibrationLevel * dt;
+    if (sim->vibrationPhase > 2.0f * PI) {
+        sim->vibrationPhase -= 2.0f * PI;
+    }
+    vibration = config->vibrationAmplitude * sim->vibrationLevel;
+
+    sim->historyIndex = (sim->historyIndex + 1) % (AIRFRAME_SIM_MAX_SENSOR_DELAY + 1);
+    for (i = 0; i < 3; i++) {
+        sim->gyroHistory[sim->historyIndex][i] = sim->angleRate[i] + config->gyroBias[i]
+                + config->gyroNoise * RandomNormal(&sim->random);
+        sim->accHistory[sim->historyIndex][i] = sim->specificForce[i] + config->accBias[i]
+                + config->accNoise * RandomNormal(&sim->random);
+    }
+    sim->accHistory[sim->historyIndex][0] += 0.5f * vibration * cosf(sim->vibrationPhase);
+    sim->accHistory[sim->historyIndex][1] += 0.5f * vibration * sinf(sim->vibrationPhase);
+    sim->accHistory[sim->historyIndex][2] += vibration * sinf(sim->vibrationPhase);
+}
+
+/*
+ * @brief  Computes the rotation matrix of a unit quaternion, FROM the body frame TO the inertial frame
+ * @param  q : Unit quaternion, q0 scalar
+ * @param  dcm : Destination row major 3x3 matrix
+ * @retval None
+ */
+static void QuaternionToDCM(const float32_t* q, float32_t* dcm) {
+    dcm[0] = 1.0f - 2.0f*(q[2]*q[2] + q[3]*q[3]);
+    dcm[1] = 2.0f*(q[1]*q[2] - q[0]*q[3]);
+    dcm[2] = 2.0f*(q[1]*q[3] + q[0]*q[2]);
+    dcm[3] = 2.0f*(q[1]*q[2] + q[0]*q[3]);
+    dcm[4] = 1.0f - 2.0f*(q[1]*q[1] + q[3]*q[3]);
+    dcm[5] = 2.0f*(q[2]*q[3] - q[0]*q[1]);
+    dcm[6] = 2.0f*(q[1]*q[3] - q[0]*q[2]);
+    dcm[7] = 2.0f*(q[2]*q[3] + q[0]*q[1]);
+    dcm[8] = 1.0f - 2.0f*(q[1]*q[1] + q[2]*q[2]);
+}
+
+/*
+ * @brief  Generates an approximately normal distributed number with zero mean and unit variance, from the sum of four
+ *         xorshift32 uniform numbers. Deterministic and independent of the C library, so runs repeat on any host.
+ * @param  state : Generator state, not zero
+ * @retval Random number
+ */
+static float32_t RandomNormal(uint32_t* state) {
+    float32_t sum = 0.0f;
+    uint8_t i;
+
+    for (i = 0; i < 4; i++) {
+        *state ^= *state << 13;
+        *state ^= *state >> 17;
+        *state ^= *state << 5;
+        sum += (float32_t) *state * (1.0f / 4294967296.0f);
+    }
+
+    /* The sum of four uniform [0, 1) numbers has mean 2 and variance 1/3 */
+    return (sum - 2.0f) * 1.7320508f;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,313 @@
+/******************************************************************************
+ * @brief   Quaternion based attitude estimation. Body angular rates are
+ *          integrated directly into the attitude quaternion, and the
+ *          accelerometer (roll/pitch) and magnetometer (yaw) feed back through
+ *          proportional-integral correction terms as in a Mahony filter. Unlike
+ *          the Euler angle Kalman filter it has no trigonometry per gyroscope
+ *          sample and no singularity at +/-90 deg pitch.
+ *
+ * @license
+ * Dragonfly FCB firmware to control the Dragonfly quadrotor UAV
+ * Copyright (C) 2016  ÅF Technology South: Dragonfly Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *****************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "attitude_quaternion.h"
+
+#include "coning_integrator.h"
+#include "rotation_transformation.h"
+#include "flight_control.h"
+#include "mag_heading.h"
+#include "common.h"
+#include "fast_math.h"
+
+#include <math.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Attitude quaternion (q = q0 + q1*i + q2*j + q3*k), rotates FROM the body frame TO the inertial (NED) frame */
+static float32_t q0 = 1.0, q1 = 0.0, q2 = 0.0, q3 = 0.0;
+
+/* Estimated gyroscope bias [rad/s], body frame */
+static float32_t gyroBias[3] = { 0.0, 0.0, 0.0 };
+
+/* Latest unbiased body angular rates [rad/s] */
+static float32_t unbiasedRates[3] = { 0.0, 0.0, 0.0 };
+
+#ifdef FCB_CONING_COMPENSATION
+/* Rotation of the unbiased gyroscope samples not applied to the quaternion yet */
+static ConingIntegratorType gyroIntegrator;
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+static void Rotate(const float32_t* angularRates, const float32_t dt);
+static void GetDownVector(float32_t* dstVector);
+static void ApplyCorrection(const float32_t* error, const float32_t kp, const float32_t ki, const float32_t dt);
+static float32_t Clamp(const float32_t value, const float32_t min, const float32_t max);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Initializes the attitude quaternion from Euler angles
+ * @param  initAngles : Roll, pitch and yaw angles [rad]
+ * @retval None
+ */
+void QuaternionAttitudeInit(const float32_t initAngles[3]) {
+    float32_t cosRoll = arm_cos_f32(initAngles[0]*0.5f);
+    float32_t sinRoll = arm_sin_f32(initAngles[0]*0.5f);
+    float32_t cosPitch = arm_cos_f32(initAngles[1]*0.5f);
+    float32_t sinPitch = arm_sin_f32(initAngles[1]*0.5f);
+    float32_t cosYaw = arm_cos_f32(initAngles[2]*0.5f);
+    float32_t sinYaw = arm_sin_f32(initAngles[2]*0.5f);
+
+    /* Z-Y-X (yaw-pitch-roll) rotation sequence */
+    q0 = cosRoll*cosPitch*cosYaw + sinRoll*sinPitch*sinYaw;
+    q1 = sinRoll*cosPitch*cosYaw - cosRoll*sinPitch*sinYaw;
+    q2 = cosRoll*sinPitch*cosYaw + sinRoll*cosPitch*sinYaw;
+    q3 = cosRoll*cosPitch*sinYaw - sinRoll*sinPitch*cosYaw;
+
+    gyroBias[0] = gyroBias[1] = gyroBias[2] = 0.0;
+    unbiasedRates[0] = unbiasedRates[1] = unbiasedRates[2] = 0.0;
+#ifdef FCB_CONING_COMPENSATION
+    ConingIntegratorReset(&gyroIntegrator);
+#endif
+}
+
+/*
+ * @brief  Integrates a gyroscope sample into the attitude quaternion. With FCB_CONING_COMPENSATION the sample is only
+ *         added to the coning compensated rotation, which QuaternionAttitudePropagate() applies.
+ * @param  bodyAngularRates : Body frame angular rates [rad/s]
+ * @param  dt : Time since the previous gyroscope sample [s]
+ * @retval None
+ */
+void QuaternionAttitudeUpdateGyro(const float32_t* bodyAngularRates, const float32_t dt) {
+    unbiasedRates[0] = bodyAngularRates[0] - gyroBias[0];
+    unbiasedRates[1] = bodyAngularRates[1] - gyroBias[1];
+    unbiasedRates[2] = bodyAngularRates[2] - gyroBias[2];
+
+#ifdef FCB_CONING_COMPENSATION
+    ConingIntegratorUpdate(&gyroIntegrator, unbiasedRates, Clamp(dt, 0.0, QUATERNION_MAX_DT));
+#else
+    Rotate(unbiasedRates, Clamp(dt, 0.0, QUATERNION_MAX_DT));
+#endif
+}
+
+/*
+ * @brief  Rotates the attitude quaternion by the coning compensated rotation of the gyroscope samples since the
+ *         previous call. Called once per prediction and before each correction, which compares with the attitude.
+ *         Without FCB_CONING_COMPENSATION every sample is integrated at once and there is nothing to do.
+ * @param  None
+ * @retval None
+ */
+void QuaternionAttitudePropagate(void) {
+#ifdef FCB_CONING_COMPENSATION
+    float32_t rotation[3], delta[4];
+    float32_t q0Prev = q0, q1Prev = q1, q2Prev = q2, q3Prev = q3;
+    float32_t dt, norm;
+
+    if (0 == ConingIntegratorTake(&gyroIntegrator, rotation, &dt)) {
+        return;
+    }
+
+    RotationVectorToQuaternion(delta, rotation);
+
+    /* q = q*delta, the rotation is in the body frame */
+    q0 = q0Prev*delta[0] - q1Prev*delta[1] - q2Prev*delta[2] - q3Prev*delta[3];
+    q1 = q0Prev*delta[1] + q1Prev*delta[0] + q2Prev*delta[3] - q3Prev*delta[2];
+    q2 = q0Prev*delta[2] - q1Prev*delta[3] + q2Prev*delta[0] + q3Prev*delta[1];
+    q3 = q0Prev*delta[3] + q1Prev*delta[2] - q2Prev*delta[1] + q3Prev*delta[0];
+
+    norm = FastInvSqrtf(q0*q0 + q1*q1 + q2*q2 + q3*q3);
+    q0 *= norm;
+    q1 *= norm;
+    q2 *= norm;
+    q3 *= norm;
+#endif
+}
+
+/*
+ * @brief  Corrects roll and pitch towards the gravity direction measured by the accelerometer
+ * @param  bodyAccelerometerReadings : The accelerometer sensor readings in the UAV body-frame
+ * @param  dt : Time since the previous accelerometer correction [s]
+ * @retval None
+ */
+void QuaternionAttitudeCorrectAcc(const float32_t* bodyAccelerometerReadings, const float32_t dt) {
+    float32_t accDown[3], estDown[3], error[3];
+    float32_t normSquared;
+
+    arm_dot_prod_f32((float32_t*) bodyAccelerometerReadings, (float32_t*) bodyAccelerometerReadings, 3, &normSquared);
+
+    /* Skip samples that are not dominated by gravity */
+    if (normSquared < G_ACC*G_ACC*(1.0f-QUATERNION_ACC_REJECT_RATIO)*(1.0f-QUATERNION_ACC_REJECT_RATIO)
+            || normSquared > G_ACC*G_ACC*(1.0f+QUATERNION_ACC_REJECT_RATIO)*(1.0f+QUATERNION_ACC_REJECT_RATIO)) {
+        return;
+    }
+
+    /* The accelerometer measures the reaction to gravity, i.e. "up" */
+    arm_scale_f32((float32_t*) bodyAccelerometerReadings, -FastInvSqrtf(normSquared), accDown, 3);
+
+    QuaternionAttitudePropagate();
+    GetDownVector(estDown);
+
+    /* Rotation error between measured and estimated down direction */
+    Vector3DCrossProduct(error, accDown, estDown);
+
+    ApplyCorrection(error, QUATERNION_KP_ACC, QUATERNION_KI_ACC, Clamp(dt, 0.0, QUATERNION_MAX_DT));
+}
+
+/*
+ * @brief  Corrects yaw towards the tilt compensated magnetometer heading
+ * @param  bodyMagneticReadings : The magnetometer sensor readings in the UAV body-frame
+ * @param  dt : Time since the previous magnetometer correction [s]
+ * @retval None
+ */
+void QuaternionAttitudeCorrectMag(float32_t* bodyMagneticReadings, const float32_t dt) {
+    float32_t estDown[3], error[3];
+    float32_t yawError;
+
+    QuaternionAttitudePropagate();
+    GetDownVector(estDown);
+
+    /* Tilt compensate with the attitude trigonometry of the latest flight control cycle, the declination turns the
+     * magnetic heading into the true one */
+    yawError = GetMagYawAngleCached(bodyMagneticReadings, GetAttitudeTrigCache()) + GetMagDeclination()
+            - FastAtan2f(2.0f*(q0*q3 + q1*q2), 1.0f - 2.0f*(q2*q2 + q3*q3));
+    toMaxRadian(&yawError);
+
+    /* Yaw is a rotation around the inertial "down" axis, expressed in the body frame */
+    arm_scale_f32(estDown, yawError, error, 3);
+
+    ApplyCorrection(error, QUATERNION_KP_MAG, QUATERNION_KI_MAG, Clamp(dt, 0.0, QUATERNION_MAX_DT));
+}
+
+/*
+ * @brief  Gets the Euler angles of the attitude quaternion
+ * @param  dstAttitude : Destination vector for roll, pitch and yaw [rad]
+ * @retval None
+ */
+void QuaternionAttitudeGetAngles(float32_t* dstAttitude) {
+    float32_t estDown[3];
+
+    GetDownVector(estDown);
+
+    dstAttitude[0] = FastAtan2f(estDown[1], estDown[2]); // Roll-Phi
+    dstAttitude[1] = FastAsinf(Clamp(-estDown[0], -1.0, 1.0)); // Pitch-Theta
+    dstAttitude[2] = FastAtan2f(2.0f*(q0*q3 + q1*q2), 1.0f - 2.0f*(q2*q2 + q3*q3)); // Yaw-Psi
+}
+
+/*
+ * @brief  Gets the latest unbiased angular rates
+ * @note   These are body frame rates, which equal the Euler angle rates for small roll and pitch angles
+ * @param  dstRates : Destination vector for roll, pitch and yaw rates [rad/s]
+ * @retval None
+ */
+void QuaternionAttitudeGetRates(float32_t* dstRates) {
+    dstRates[0] = unbiasedRates[0];
+    dstRates[1] = unbiasedRates[1];
+    dstRates[2] = unbiasedRates[2];
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Rotates the attitude quaternion by body angular rates over a time step and renormalizes it
+ * @param  angularRates : Body frame angular rates [rad/s]
+ * @param  dt : Time step [s]
+ * @retval None
+ */
+static void Rotate(const float32_t* angularRates, const float32_t dt) {
+    float32_t halfDt = 0.5f*dt;
+    float32_t wx = angularRates[0]*halfDt;
+    float32_t wy = angularRates[1]*halfDt;
+    float32_t wz = angularRates[2]*halfDt;
+    float32_t q0Prev = q0, q1Prev = q1, q2Prev = q2, q3Prev = q3;
+    float32_t norm;
+
+    /* q += 0.5*q*(0, w)*dt */
+    q0 += -q1Prev*wx - q2Prev*wy - q3Prev*wz;
+    q1 += q0Prev*wx + q2Prev*wz - q3Prev*wy;
+    q2 += q0Prev*wy - q1Prev*wz + q3Prev*wx;
+    q3 += q0Prev*wz + q1Prev*wy - q2Prev*wx;
+
+    norm = FastInvSqrtf(q0*q0 + q1*q1 + q2*q2 + q3*q3);
+    q0 *= norm;
+    q1 *= norm;
+    q2 *= norm;
+    q3 *= norm;
+}
+
+/*
+ * @brief  Calculates the inertial frame "down" direction in the body frame (third row of the DCM)
+ * @param  dstVector : Destination unit vector
+ * @retval None
+ */
+static void GetDownVector(float32_t* dstVector) {
+    dstVector[0] = 2.0f*(q1*q3 - q0*q2);
+    dstVector[1] = 2.0f*(q0*q1 + q2*q3);
+    dstVector[2] = q0*q0 - q1*q1 - q2*q2 + q3*q3;
+}
+
+/*
+ * @brief  Applies the proportional correction to the attitude and the integral correction to the gyroscope bias
+ * @param  error : Rotation error in the body frame [rad]
+ * @param  kp : Proportional gain [1/s]
+ * @param  ki : Integral gain [1/s^2]
+ * @param  dt : Time the error applies to [s]
+ * @retval None
+ */
+static void ApplyCorrection(const float32_t* error, const float32_t kp, const float32_t ki, const float32_t dt) {
+    float32_t correctionRates[3];
+
+    gyroBias[0] -= ki*error[0]*dt;
+    gyroBias[1] -= ki*error[1]*dt;
+    gyroBias[2] -= ki*error[2]*dt;
+
+    correctionRates[0] = kp*error[0];
+    correctionRates[1] = kp*error[1];
+    correctionRates[2] = kp*error[2];
+
+    Rotate(correctionRates, dt);
+}
+
+/*
+ * @brief  Limits a value to a range
+ * @param  value : Value to limit
+ * @param  min : Lower limit
+ * @param  max : Upper limit
+ * @retval The limited value
+ */
+static float32_t Clamp(const float32_t value, const float32_t min, const float32_t max) {
+    if (value < min) {
+        return min;
+    } else if (value > max) {
+        return max;
+    }
+    return value;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,423 @@
+/******************************************************************************
+ * @file    benchmark.c
+ * @author  Dragonfly
+ * @brief   On-target benchmark runner of the Benchmark build configuration.
+ *          Each benchmark calls one kernel of the flight code many times and
+ *          times every call with the cycle counter. The table has one CSV row
+ *          per benchmark with the min, mean and max cycles per call, the min
+ *          is the one to compare between commits, the max includes the
+ *          interrupts that hit the call.
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "benchmark.h"
+
+#ifdef FCB_BENCHMARK_BUILD
+
+#include "state_estimation.h"
+#include "pid_control.h"
+#include "motor_mixer.h"
+#include "rotation_transformation.h"
+#include "flight_control.h"
+#include "sphere_calibration.h"
+#include "airframe_sim.h"
+#include "ring_buffer.h"
+#include "fixed_format.h"
+#include "fcb_sensors.h"
+#include "dragonfly_fcb.pb.h"
+#include "pb_encode.h"
+#include "usbd_cdc_if.h"
+#include "fcb_error.h"
+#include "common.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+	const char* name;
+	void (*setup)(void);            // Called once before the timed calls, may be NULL
+	void (*run)(void);              // The timed call
+	uint16_t iterations;
+} Benchmark_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define BENCHMARK_TASK_PRIO             configMAX_PRIORITIES-1 // Only preempted by the interrupts while timing
+#define BENCHMARK_TASK_STACK_DEPTH      (4 * configMINIMAL_STACK_SIZE) // Sphere calibration and snprintf
+
+#define BENCHMARK_ITERATIONS            1000
+#define BENCHMARK_SOLVER_ITERATIONS     20 // The sphere calibration solve takes milliseconds
+
+#define BENCHMARK_LINE_MAX_SIZE         96
+#define BENCHMARK_CRC_LONG_SIZE         1024
+#define BENCHMARK_FIFO_SIZE             256
+#define BENCHMARK_FIFO_CHUNK_SIZE       32
+#define BENCHMARK_SPHERE_RADIUS         1000.0f
+#define BENCHMARK_PROTO_BUFFER_SIZE     64
+#define BENCHMARK_SIM_STEP              0.002f // Gyroscope sample period [s]
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static xTaskHandle BenchmarkTaskHandle = NULL;
+
+/* Inputs and outputs of the benchmarks, static so that the calls are not optimised away */
+static float32_t benchAcc[3] = { 0.3f, -0.2f, G_ACC };
+static float32_t benchMag[3] = { 0.340345f, 0.0209924f, 0.940066f };
+static float32_t benchRates[3] = { 0.5f, -0.3f, 0.1f };
+static float32_t benchMixerInput[MIXER_AXES_NBR] = { 10.0f, 0.2f, -0.1f, 0.02f };
+static int32_t benchMotorValues[MIXER_MAX_MOTORS];
+static float32_t benchMixerAchieved[MIXER_AXES_NBR];
+static CtrlSignals_TypeDef benchCtrlSignals;
+static SphereObservations_TypeDef benchObservations;
+static float32_t benchCalibParams[6];
+static uint8_t benchData[BENCHMARK_CRC_LONG_SIZE];
+static volatile uint32_t benchCrc;
+static RingBuffer_TypeDef benchRing;
+static uint8_t benchRingArray[BENCHMARK_FIFO_SIZE];
+static uint8_t benchChunk[BENCHMARK_FIFO_CHUNK_SIZE];
+static uint8_t benchProtoBuffer[BENCHMARK_PROTO_BUFFER_SIZE];
+static char benchString[BENCHMARK_LINE_MAX_SIZE];
+static AirframeSim_TypeDef benchSim;
+
+/* Private function prototypes -----------------------------------------------*/
+static void BenchmarkTask(void const *argument);
+static uint32_t MeasureTimingOverhead(void);
+static void RunBenchmark(const Benchmark_TypeDef* benchmark, const uint32_t overhead);
+
+static void SetupStateEstimation(void);
+static void SetupSphereCalibration(void);
+static void SetupData(void);
+static void SetupFifo(void);
+static void SetupAirframeSim(void);
+static void RunKalmanPrediction(void);
+static void RunKalmanAccCorrection(void);
+static void RunKalmanMagCorrection(void);
+static void RunPIDUpdate(void);
+static void RunMixer(void);
+static void RunRotationMatrix(void);
+static void RunRotationMatrixFromGyro(void);
+static void RunSphereCalibration(void);
+static void RunCrcShort(void);
+static void RunCrcLong(void);
+static void RunFifoPutGet(void);
+static void RunProtoEncode(void);
+static void RunSnprintf(void);
+static void RunFormatFixed(void);
+static void RunAirframeSim(void);
+static void RunNothing(void);
+
+/* The benchmarks, in the order of the table. Names are stable so that tables of different commits can be joined. */
+static const Benchmark_TypeDef benchmarks[] = {
+	{ "kalman_predict",        SetupStateEstimation,   RunKalmanPrediction,        BENCHMARK_ITERATIONS },
+	{ "kalman_correct_acc",    NULL,                   RunKalmanAccCorrection,     BENCHMARK_ITERATIONS },
+	{ "kalman_correct_mag",    NULL,                   RunKalmanMagCorrection,     BENCHMARK_ITERATIONS },
+	{ "pid_update",            NULL,                   RunPIDUpdate,               BENCHMARK_ITERATIONS },
+	{ "mixer_physical",        NULL,                   RunMixer,                   BENCHMARK_ITERATIONS },
+	{ "rotation_matrix",       NULL,                   RunRotationMatrix,          BENCHMARK_ITERATIONS },
+	{ "rotation_matrix_gyro",  NULL,                   RunRotationMatrixFromGyro,  BENCHMARK_ITERATIONS },
+	{ "sphere_calibration",    SetupSphereCalibration, RunSphereCalibration,       BENCHMARK_SOLVER_ITERATIONS },
+	{ "crc_64B",               SetupData,              RunCrcShort,                BENCHMARK_ITERATIONS },
+	{ "crc_1kB",               NULL,                   RunCrcLong,                 BENCHMARK_ITERATIONS },
+	{ "fifo_put_get_32B",      SetupFifo,              RunFifoPutGet,              BENCHMARK_ITERATIONS },
+	{ "nanopb_sensor_samples", NULL,                   RunProtoEncode,             BENCHMARK_ITERATIONS },
+	{ "snprintf_3f",           NULL,                   RunSnprintf,                BENCHMARK_ITERATIONS },
+	{ "format_fixed_3f",       NULL,                   RunFormatFixed,             BENCHMARK_ITERATIONS },
+	{ "airframe_sim_step",     SetupAirframeSim,       RunAirframeSim,             BENCHMARK_ITERATIONS },
+};
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Creates the benchmark task, which prints the benchmark table periodically
+ * @param  None
+ * @retval None
+ */
+void CreateBenchmarkTask(void) {
+	/* Benchmark task creation
+	 * Task function pointer: BenchmarkTask
+	 * Task name: BENCH
+	 * Stack depth: BENCHMARK_TASK_STACK_DEPTH
+	 * Parameter: NULL
+	 * Priority: BENCHMARK_TASK_PRIO (0 to configMAX_PRIORITIES-1 possible)
+	 * Handle: BenchmarkTaskHandle
+	 * */
+	if (pdPASS != xTaskCreate((pdTASK_CODE )BenchmarkTask, (signed portCHAR*)"BENCH",
+			BENCHMARK_TASK_STACK_DEPTH, NULL, BENCHMARK_TASK_PRIO, &BenchmarkTaskHandle)) {
+		ErrorHandler();
+	}
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Task code of the benchmark runner, prints the whole table every BENCHMARK_REPEAT_PERIOD_MS
+ * @param  argument : Unused parameter
+ * @retval None
+ */
+static void BenchmarkTask(void const *argument) {
+	uint32_t overhead;
+	uint8_t i;
+
+	(void) argument;
+
+	vTaskDelay(BENCHMARK_START_DELAY_MS / portTICK_RATE_MS);
+
+	while (1) {
+		overhead = MeasureTimingOverhead();
+
+		snprintf(benchString, sizeof(benchString), "# benchmark, core clock %lu Hz, overhead %lu cycles\n",
+				(unsigned long) SystemCoreClock, (unsigned long) overhead);
+		USBComSendString(benchString);
+		USBComSendString("name,iterations,min_cycles,mean_cycles,max_cycles\n");
+
+		for (i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+			RunBenchmark(&benchmarks[i], overhead);
+		}
+
+		USBComSendString("# end\n");
+
+		PrintIpcBenchmarks(overhead);
+
+		vTaskDelay(BENCHMARK_REPEAT_PERIOD_MS / portTICK_RATE_MS);
+	}
+}
+
+/*
+ * @brief  Measures the cycles of a timed call of an empty function, subtracted from the benchmark cycles
+ * @param  None
+ * @retval Min cycles of the timing and the indirect call
+ */
+static uint32_t MeasureTimingOverhead(void) {
+	void (* volatile run)(void) = RunNothing;
+	uint32_t start, cycles;
+	uint32_t minCycles = UINT32_MAX;
+	uint16_t i;
+
+	for (i = 0; i < BENCHMARK_ITERATIONS; i++) {
+		start = GetTimestamp();
+		run();
+		cycles = GetTimestamp() - start;
+		if (cycles < minCycles) {
+			minCycles = cycles;
+		}
+	}
+
+	return minCycles;
+}
+
+/*
+ * @brief  Runs and times a benchmark and prints its table row
+ * @param  benchmark : The benchmark
+ * @param  overhead : Cycles of a timed empty call, from MeasureTimingOverhead()
+ * @retval None
+ */
+static void RunBenchmark(const Benchmark_TypeDef* benchmark, const uint32_t overhead) {
+	uint32_t start, cycles;
+	uint32_t minCycles = UINT32_MAX, maxCycles = 0;
+	uint64_t sumCycles = 0;
+	uint16_t i;
+
+	if (NULL != benchmark->setup) {
+		benchmark->setup();
+	}
+
+	for (i = 0; i < benchmark->iterations; i++) {
+		start = GetTimestamp();
+		benchmark->run();
+		cycles = GetTimestamp() - start;
+
+		cycles = (cycles > overhead) ? cycles - overhead : 0;
+		if (cycles < minCycles) {
+			minCycles = cycles;
+		}
+		if (cycles > maxCycles) {
+			maxCycles = cycles;
+		}
+		sumCycles += cycles;
+	}
+
+	snprintf(benchString, sizeof(benchString), "%s,%u,%lu,%lu,%lu\n", benchmark->name,
+			(unsigned int) benchmark->iterations, (unsigned long) minCycles,
+			(unsigned long) (sumCycles / benchmark->iterations), (unsigned long) maxCycles);
+	USBComSendString(benchString);
+}
+
+/*
+ * @brief  Sets the attitude and vertical estimators to their initial states, as in the flight control task
+ * @param  None
+ * @retval None
+ */
+static void SetupStateEstimation(void) {
+	float32_t initAngles[3] = { 0.0f, 0.0f, 0.0f };
+
+	InitStatesXYZ(initAngles);
+}
+
+/*
+ * @brief  Fills the sphere observations with samples of a sphere that is offset from the origin, in all 26 directions
+ *         of the cube corners, edges and faces
+ * @param  None
+ * @retval None
+ */
+static void SetupSphereCalibration(void) {
+	int16_t sample[3];
+	float32_t norm;
+	int8_t x, y, z;
+
+	clearObservationMatrices();
+
+	for (x = -1; x <= 1; x++) {
+		for (y = -1; y <= 1; y++) {
+			for (z = -1; z <= 1; z++) {
+				if (0 == x && 0 == y && 0 == z) {
+					continue;
+				}
+
+				norm = BENCHMARK_SPHERE_RADIUS / sqrtf((float32_t) (x*x + y*y + z*z));
+				sample[0] = (int16_t) ((float32_t) x * norm + 30.0f);
+				sample[1] = (int16_t) ((float32_t) y * norm - 20.0f);
+				sample[2] = (int16_t) ((float32_t) z * norm * 1.05f + 10.0f);
+				addNewSample(sample);
+			}
+		}
+	}
+
+	takeObservations(&benchObservations);
+}
+
+/*
+ * @brief  Fills the CRC and FIFO data with a byte pattern
+ * @param  None
+ * @retval None
+ */
+static void SetupData(void) {
+	uint16_t i;
+
+	for (i = 0; i < BENCHMARK_CRC_LONG_SIZE; i++) {
+		benchData[i] = (uint8_t) (i * 7 + 3);
+	}
+}
+
+/*
+ * @brief  Initializes the benchmark FIFO
+ * @param  None
+ * @retval None
+ */
+static void SetupFifo(void) {
+	RingBufferInit(&benchRing, benchRingArray, BENCHMARK_FIFO_SIZE);
+}
+
+/*
+ * @brief  Initializes the airframe simulation model with the default parameters
+ * @param  None
+ * @retval None
+ */
+static void SetupAirframeSim(void) {
+	AirframeSimConfig_TypeDef config;
+
+	AirframeSimGetDefaultConfig(&config);
+	AirframeSimInit(&benchSim, &config);
+}
+
+static void RunKalmanPrediction(void) {
+	UpdatePredictionState();
+}
+
+static void RunKalmanAccCorrection(void) {
+	UpdateCorrectionState(ACC_IDX, benchAcc, GetTimestamp());
+}
+
+static void RunKalmanMagCorrection(void) {
+	UpdateCorrectionState(MAG_IDX, benchMag, GetTimestamp());
+}
+
+static void RunPIDUpdate(void) {
+	UpdatePIDControlSignals(&benchCtrlSignals);
+}
+
+static void RunMixer(void) {
+	MotorMixerPhysical(benchMixerInput, benchMotorValues, benchMixerAchieved);
+}
+
+static void RunRotationMatrix(void) {
+	UpdateRotationMatrix(0.1f, -0.2f, 1.0f);
+}
+
+static void RunRotationMatrixFromGyro(void) {
+	UpdateRotationMatrixFromGyro(benchRates, 0.001f);
+}
+
+static void RunSphereCalibration(void) {
+	calibrate(&benchObservations, 1.0f, benchCalibParams);
+}
+
+static void RunCrcShort(void) {
+	benchCrc = CalculateCRC(benchData, 64);
+}
+
+static void RunCrcLong(void) {
+	benchCrc = CalculateCRC(benchData, BENCHMARK_CRC_LONG_SIZE);
+}
+
+static void RunFifoPutGet(void) {
+	RingBufferPutData(&benchRing, benchData, BENCHMARK_FIFO_CHUNK_SIZE);
+	RingBufferGetData(&benchRing, benchChunk, BENCHMARK_FIFO_CHUNK_SIZE);
+}
+
+static void RunProtoEncode(void) {
+	SensorSamplesProto sensorProto;
+	pb_ostream_t stream = pb_ostream_from_buffer(benchProtoBuffer, sizeof(benchProtoBuffer));
+
+	sensorProto.has_accX = true;
+	sensorProto.has_accY = true;
+	sensorProto.has_accZ = true;
+	sensorProto.has_gyroX = true;
+	sensorProto.has_gyroY = true;
+	sensorProto.has_gyroZ = true;
+	sensorProto.has_magX = true;
+	sensorProto.has_magY = true;
+	sensorProto.has_magZ = true;
+	sensorProto.accX = benchAcc[0];
+	sensorProto.accY = benchAcc[1];
+	sensorProto.accZ = benchAcc[2];
+	sensorProto.gyroX = benchRates[0];
+	sensorProto.gyroY = benchRates[1];
+	sensorProto.gyroZ = benchRates[2];
+	sensorProto.magX = benchMag[0];
+	sensorProto.magY = benchMag[1];
+	sensorProto.magZ = benchMag[2];
+
+	pb_encode(&stream, SensorSamplesProto_fields, &sensorProto);
+}
+
+static void RunSnprintf(void) {
+	snprintf(benchString, sizeof(benchString), "%.3f,%.3f,%.3f", (double) benchAcc[0], (double) benchAcc[1],
+			(double) benchAcc[2]);
+}
+
+static void RunFormatFixed(void) {
+	FormatFixedList(benchString, sizeof(benchString), "%f,%f,%f", benchAcc, 3);
+}
+
+static void RunAirframeSim(void) {
+	AirframeSimStep(&benchSim, benchMotorValues, BENCHMARK_SIM_STEP);
+}
+
+static void RunNothing(void) {
+}
+
+#endif /* FCB_BENCHMARK_BUILD */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,439 @@
+/******************************************************************************
+ * @file    benchmark_ipc.c
+ * @author  Dragonfly
+ * @brief   RTOS signalling benchmarks of the Benchmark build configuration,
+ *          the measured successor of the semaphore, thread and timer demos of
+ *          the sandbox. Each mechanism wakes a waiter task at the priority
+ *          above the benchmark task, signalled from the benchmark task and
+ *          from a software triggered interrupt, which is how the flight code
+ *          hands samples and events between its ISRs and tasks. The table has
+ *          one CSV row per mechanism and source:
+ *            signal: cycles of the signalling call while nobody waits, i.e.
+ *                    the cost of a signal to a consumer that is still busy
+ *            latency: cycles from the signalling call to the woken waiter
+ *                    running, including the context switch, and from an ISR
+ *                    its exit and the PendSV
+ *          Task notifications and event groups need FreeRTOS 8, this kernel is
+ *          V7.6.0. The pending bits row is the event bits and binary semaphore
+ *          pattern the flight code uses in place of an event group.
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "benchmark.h"
+
+#ifdef FCB_BENCHMARK_BUILD
+
+#include "usbd_cdc_if.h"
+#include "fcb_error.h"
+#include "common.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef enum {
+	IPC_BINARY_SEMAPHORE = 0,
+	IPC_COUNTING_SEMAPHORE,
+	IPC_QUEUE,
+	IPC_TASK_RESUME,                // Direct to task wakeup, vTaskSuspend(NULL) and vTaskResume()
+	IPC_PENDING_BITS,               // Event bits set in a critical section, then a binary semaphore given
+	IPC_MECHANISM_NBR,
+	IPC_PARKED = IPC_MECHANISM_NBR  // The waiter waits on the park semaphore, nobody waits on the mechanisms
+} IpcMechanism_TypeDef;
+
+typedef struct {
+	uint32_t minCycles;
+	uint32_t maxCycles;
+	uint64_t sumCycles;
+} IpcCycleStats_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define IPC_WAITER_TASK_STACK_DEPTH     configMINIMAL_STACK_SIZE
+
+#define IPC_LINE_MAX_SIZE               128
+#define IPC_COUNTING_SEMAPHORE_MAX      8
+#define IPC_PENDING_BIT                 0x00000001
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static xTaskHandle IpcWaiterTaskHandle = NULL;
+static xSemaphoreHandle ipcBinarySemaphore = NULL;
+static xSemaphoreHandle ipcCountingSemaphore = NULL;
+static xSemaphoreHandle ipcParkSemaphore = NULL;
+static xQueueHandle ipcQueue = NULL;
+
+static volatile IpcMechanism_TypeDef ipcWaitMechanism = IPC_PARKED; // What the waiter waits on next
+static volatile IpcMechanism_TypeDef ipcIsrMechanism = IPC_PARKED; // What the interrupt signals
+static volatile uint32_t ipcPendingBits = 0;
+
+static volatile uint32_t ipcSignalTime;         // Timestamp before the signalling call
+static volatile uint32_t ipcWakeTime;           // Timestamp of the waiter after it is woken
+static volatile uint32_t ipcWakeups = 0;
+static volatile uint32_t ipcIsrSignalCycles;
+
+static const char* ipcNames[IPC_MECHANISM_NBR] = {
+	"binary_semaphore",
+	"counting_semaphore",
+	"queue_u32",
+	"task_resume",
+	"pending_bits_semaphore"
+};
+
+static char ipcString[IPC_LINE_MAX_SIZE];
+
+/* Private function prototypes -----------------------------------------------*/
+static void InitIpcBenchmarks(void);
+static void IpcWaiterTask(void const *argument);
+static void RunIpcBenchmark(const IpcMechanism_TypeDef mechanism, const bool fromISR, const uint32_t overhead);
+static void IpcSignal(const IpcMechanism_TypeDef mechanism);
+static portBASE_TYPE IpcSignalFromISR(const IpcMechanism_TypeDef mechanism);
+static void IpcReset(const IpcMechanism_TypeDef mechanism);
+static void IpcSetWaiter(const IpcMechanism_TypeDef current, const IpcMechanism_TypeDef next);
+static void IpcTrigger(const IpcMechanism_TypeDef mechanism, const bool fromISR);
+static void AddIpcCycles(IpcCycleStats_TypeDef* stats, const uint32_t cycles);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Runs the signalling benchmarks and prints their table. The waiter runs at the priority of the calling task,
+ *         which is lowered by one while the benchmarks run.
+ * @param  overhead : Cycles of a timed empty call, subtracted from the measured cycles
+ * @retval None
+ */
+void PrintIpcBenchmarks(const uint32_t overhead) {
+	unsigned portBASE_TYPE priority = uxTaskPriorityGet(NULL);
+	uint8_t mechanism;
+
+	if (NULL == IpcWaiterTaskHandle) {
+		InitIpcBenchmarks();
+	}
+
+	vTaskPrioritySet(NULL, priority - 1);
+
+	snprintf(ipcString, sizeof(ipcString), "# ipc benchmark, FreeRTOS %s, overhead %lu cycles\n",
+			tskKERNEL_VERSION_NUMBER, (unsigned long) overhead);
+	USBComSendString(ipcString);
+	USBComSendString("name,source,iterations,min_signal_cycles,mean_signal_cycles,max_signal_cycles,"
+			"min_latency_cycles,mean_latency_cycles,max_latency_cycles\n");
+
+	for (mechanism = 0; mechanism < IPC_MECHANISM_NBR; mechanism++) {
+		RunIpcBenchmark((IpcMechanism_TypeDef) mechanism, false, overhead);
+		RunIpcBenchmark((IpcMechanism_TypeDef) mechanism, true, overhead);
+	}
+
+	USBComSendString("# end\n");
+
+	vTaskPrioritySet(NULL, priority);
+}
+
+/*
+ * @brief  Signals the mechanism of the running benchmark from interrupt context, called by BENCHMARK_IPC_IRQHandler
+ * @param  None
+ * @retval None
+ */
+void BenchmarkIpcIRQHandler(void) {
+	portBASE_TYPE higherPriorityTaskWoken;
+	uint32_t start;
+
+	start = GetTimestamp();
+	ipcSignalTime = start;
+	higherPriorityTaskWoken = IpcSignalFromISR(ipcIsrMechanism);
+	ipcIsrSignalCycles = GetTimestamp() - start;
+
+	portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Creates the signalling objects and the waiter task and enables the benchmark interrupt
+ * @param  None
+ * @retval None
+ */
+static void InitIpcBenchmarks(void) {
+	/* The binary semaphores are created given */
+	vSemaphoreCreateBinary(ipcBinarySemaphore);
+	vSemaphoreCreateBinary(ipcParkSemaphore);
+	ipcCountingSemaphore = xSemaphoreCreateCounting(IPC_COUNTING_SEMAPHORE_MAX, 0);
+	ipcQueue = xQueueCreate(1, sizeof(uint32_t));
+	if (NULL == ipcBinarySemaphore || NULL == ipcParkSemaphore || NULL == ipcCountingSemaphore || NULL == ipcQueue) {
+		ErrorHandler();
+	}
+	xSemaphoreTake(ipcBinarySemaphore, 0);
+	xSemaphoreTake(ipcParkSemaphore, 0);
+
+	/* IPC waiter task creation
+	 * Task function pointer: IpcWaiterTask
+	 * Task name: IPC_WAIT
+	 * Stack depth: IPC_WAITER_TASK_STACK_DEPTH
+	 * Parameter: NULL
+	 * Priority: That of the benchmark task, which lowers itself while signalling
+	 * Handle: IpcWaiterTaskHandle
+	 * */
+	if (pdPASS != xTaskCreate((pdTASK_CODE )IpcWaiterTask, (signed portCHAR*)"IPC_WAIT",
+			IPC_WAITER_TASK_STACK_DEPTH, NULL, uxTaskPriorityGet(NULL), &IpcWaiterTaskHandle)) {
+		ErrorHandler();
+	}
+
+	HAL_NVIC_SetPriority(BENCHMARK_IPC_IRQn, BENCHMARK_IPC_IRQ_PREEMPT_PRIO, BENCHMARK_IPC_IRQ_SUB_PRIO);
+	HAL_NVIC_ClearPendingIRQ(BENCHMARK_IPC_IRQn);
+	HAL_NVIC_EnableIRQ(BENCHMARK_IPC_IRQn);
+}
+
+/*
+ * @brief  Task code of the waiter, waits on the mechanism set by the benchmark and timestamps each wakeup
+ * @param  argument : Unused parameter
+ * @retval None
+ */
+static void IpcWaiterTask(void const *argument) {
+	uint32_t value;
+
+	(void) argument;
+
+	while (1) {
+		switch (ipcWaitMechanism) {
+		case IPC_BINARY_SEMAPHORE:
+			xSemaphoreTake(ipcBinarySemaphore, portMAX_DELAY);
+			break;
+		case IPC_COUNTING_SEMAPHORE:
+			xSemaphoreTake(ipcCountingSemaphore, portMAX_DELAY);
+			break;
+		case IPC_QUEUE:
+			xQueueReceive(ipcQueue, &value, portMAX_DELAY);
+			break;
+		case IPC_TASK_RESUME:
+			vTaskSuspend(NULL);
+			break;
+		case IPC_PENDING_BITS:
+			xSemaphoreTake(ipcBinarySemaphore, portMAX_DELAY);
+			taskENTER_CRITICAL();
+			value = ipcPendingBits;
+			ipcPendingBits = 0;
+			taskEXIT_CRITICAL();
+			(void) value;
+			break;
+		default:
+			xSemaphoreTake(ipcParkSemaphore, portMAX_DELAY);
+			break;
+		}
+
+		ipcWakeTime = GetTimestamp();
+		ipcWakeups++;
+	}
+}
+
+/*
+ * @brief  Runs the signal and the latency benchmark of a mechanism and source and prints its table row
+ * @param  mechanism : The mechanism
+ * @param  fromISR : Signal from the benchmark interrupt, else from the calling task
+ * @param  overhead : Cycles of a timed empty call
+ * @retval None
+ */
+static void RunIpcBenchmark(const IpcMechanism_TypeDef mechanism, const bool fromISR, const uint32_t overhead) {
+	IpcCycleStats_TypeDef signal = { UINT32_MAX, 0, 0 };
+	IpcCycleStats_TypeDef latency = { UINT32_MAX, 0, 0 };
+	uint32_t start, cycles, wakeups;
+	uint16_t i, woken = 0;
+
+	/* Signal cost, the waiter is parked so nobody is woken */
+	for (i = 0; i < BENCHMARK_IPC_ITERATIONS; i++) {
+		if (fromISR) {
+			IpcTrigger(mechanism, true);
+			cycles = ipcIsrSignalCycles;
+		} else {
+			start = GetTimestamp();
+			IpcSignal(mechanism);
+			cycles = GetTimestamp() - start;
+		}
+		IpcReset(mechanism);
+
+		AddIpcCycles(&signal, (cycles > overhead) ? cycles - overhead : 0);
+	}
+
+	/* Wakeup latency, the waiter is blocked on the mechanism at the higher priority, so that it has run and blocked
+	 * again when the signalling call or the interrupt returns */
+	IpcSetWaiter(IPC_PARKED, mechanism);
+	for (i = 0; i < BENCHMARK_IPC_ITERATIONS; i++) {
+		wakeups = ipcWakeups;
+		IpcTrigger(mechanism, fromISR);
+		if (wakeups + 1 == ipcWakeups) {
+			cycles = ipcWakeTime - ipcSignalTime;
+			AddIpcCycles(&latency, (cycles > overhead) ? cycles - overhead : 0);
+			woken++;
+		}
+	}
+	IpcSetWaiter(mechanism, IPC_PARKED);
+
+	if (0 == woken) {
+		latency.minCycles = 0;
+		woken = 1;
+	}
+
+	snprintf(ipcString, sizeof(ipcString), "%s,%s,%u,%lu,%lu,%lu,%lu,%lu,%lu\n", ipcNames[mechanism],
+			fromISR ? "isr" : "task", (unsigned int) BENCHMARK_IPC_ITERATIONS, (unsigned long) signal.minCycles,
+			(unsigned long) (signal.sumCycles / BENCHMARK_IPC_ITERATIONS), (unsigned long) signal.maxCycles,
+			(unsigned long) latency.minCycles, (unsigned long) (latency.sumCycles / woken),
+			(unsigned long) latency.maxCycles);
+	USBComSendString(ipcString);
+}
+
+/*
+ * @brief  Signals a mechanism from task context
+ * @param  mechanism : The mechanism
+ * @retval None
+ */
+static void IpcSignal(const IpcMechanism_TypeDef mechanism) {
+	uint32_t value = 0;
+
+	switch (mechanism) {
+	case IPC_BINARY_SEMAPHORE:
+		xSemaphoreGive(ipcBinarySemaphore);
+		break;
+	case IPC_COUNTING_SEMAPHORE:
+		xSemaphoreGive(ipcCountingSemaphore);
+		break;
+	case IPC_QUEUE:
+		xQueueSend(ipcQueue, &value, 0);
+		break;
+	case IPC_TASK_RESUME:
+		/* A no-op while the waiter is not suspended, the signal is lost then */
+		vTaskResume(IpcWaiterTaskHandle);
+		break;
+	case IPC_PENDING_BITS:
+		taskENTER_CRITICAL();
+		ipcPendingBits |= IPC_PENDING_BIT;
+		taskEXIT_CRITICAL();
+		xSemaphoreGive(ipcBinarySemaphore);
+		break;
+	default:
+		xSemaphoreGive(ipcParkSemaphore);
+		break;
+	}
+}
+
+/*
+ * @brief  Signals a mechanism from interrupt context
+ * @param  mechanism : The mechanism
+ * @retval pdTRUE if a task of a higher priority than the interrupted one was woken
+ */
+static portBASE_TYPE IpcSignalFromISR(const IpcMechanism_TypeDef mechanism) {
+	portBASE_TYPE higherPriorityTaskWoken = pdFALSE;
+	unsigned portBASE_TYPE savedInterruptStatus;
+	uint32_t value = 0;
+
+	switch (mechanism) {
+	case IPC_BINARY_SEMAPHORE:
+		xSemaphoreGiveFromISR(ipcBinarySemaphore, &higherPriorityTaskWoken);
+		break;
+	case IPC_COUNTING_SEMAPHORE:
+		xSemaphoreGiveFromISR(ipcCountingSemaphore, &higherPriorityTaskWoken);
+		break;
+	case IPC_QUEUE:
+		xQueueSendFromISR(ipcQueue, &value, &higherPriorityTaskWoken);
+		break;
+	case IPC_TASK_RESUME:
+		higherPriorityTaskWoken = xTaskResumeFromISR(IpcWaiterTaskHandle);
+		break;
+	case IPC_PENDING_BITS:
+		savedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+		ipcPendingBits |= IPC_PENDING_BIT;
+		portCLEAR_INTERRUPT_MASK_FROM_ISR(savedInterruptStatus);
+		xSemaphoreGiveFromISR(ipcBinarySemaphore, &higherPriorityTaskWoken);
+		break;
+	default:
+		break;
+	}
+
+	return higherPriorityTaskWoken;
+}
+
+/*
+ * @brief  Takes back a signal that nobody waited on, so that the next one finds the mechanism empty
+ * @param  mechanism : The mechanism
+ * @retval None
+ */
+static void IpcReset(const IpcMechanism_TypeDef mechanism) {
+	uint32_t value;
+
+	switch (mechanism) {
+	case IPC_BINARY_SEMAPHORE:
+		xSemaphoreTake(ipcBinarySemaphore, 0);
+		break;
+	case IPC_COUNTING_SEMAPHORE:
+		xSemaphoreTake(ipcCountingSemaphore, 0);
+		break;
+	case IPC_QUEUE:
+		xQueueReceive(ipcQueue, &value, 0);
+		break;
+	case IPC_PENDING_BITS:
+		taskENTER_CRITICAL();
+		ipcPendingBits = 0;
+		taskEXIT_CRITICAL();
+		xSemaphoreTake(ipcBinarySemaphore, 0);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * @brief  Moves the waiter to another mechanism by waking it from the current one, it runs before this returns
+ * @param  current : The mechanism the waiter waits on
+ * @param  next : The mechanism the waiter waits on after
+ * @retval None
+ */
+static void IpcSetWaiter(const IpcMechanism_TypeDef current, const IpcMechanism_TypeDef next) {
+	ipcWaitMechanism = next;
+	IpcSignal(current);
+}
+
+/*
+ * @brief  Signals a mechanism from the calling task or by pending the benchmark interrupt, which runs at once
+ * @param  mechanism : The mechanism
+ * @param  fromISR : Signal from the benchmark interrupt, else from the calling task
+ * @retval None
+ */
+static void IpcTrigger(const IpcMechanism_TypeDef mechanism, const bool fromISR) {
+	if (fromISR) {
+		ipcIsrMechanism = mechanism;
+		NVIC_SetPendingIRQ(BENCHMARK_IPC_IRQn);
+		__DSB();
+		__ISB();
+	} else {
+		ipcSignalTime = GetTimestamp();
+		IpcSignal(mechanism);
+	}
+}
+
+/*
+ * @brief  Adds a measurement to the cycle statistics
+ * @param  stats : The statistics
+ * @param  cycles : The measurement
+ * @retval None
+ */
+static void AddIpcCycles(IpcCycleStats_TypeDef* stats, const uint32_t cycles) {
+	if (cycles < stats->minCycles) {
+		stats->minCycles = cycles;
+	}
+	if (cycles > stats->maxCycles) {
+		stats->maxCycles = cycles;
+	}
+	stats->sumCycles += cycles;
+}
+
+#endif /* FCB_BENCHMARK_BUILD */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
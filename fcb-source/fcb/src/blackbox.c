@@ -0,0 +1,872 @@
+/*****************************************************************************
+ * @brief   Blackbox flight data recorder. The flight control task encodes a
+ *          frame of the sensor, reference, PID and motor values every
+ *          decimation:th control cycle to a RAM ring buffer, in bounded time,
+ *          and the blackbox work on the high priority deferred worker programs
+ *          the ring buffer contents to the flight data log area of the
+ *          internal flash, a word at a time so that the control tasks are
+ *          only delayed for one word program. The
+ *          log area is appended to until it is full, and erased on request
+ *          in idle mode only, since the CPU stalls for the page erases.
+ *          With FCB_SD_CARD the blackbox work hands the ring buffer contents
+ *          to the SD card sink instead, see blackbox_sd.h, and the blocks it
+ *          writes to the card hold them back while they are full.
+ *
+ * @license
+ * Dragonfly FCB firmware to control the Dragonfly quadrotor UAV
+ * Copyright (C) 2016  ÅF Technology South: Dragonfly Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *****************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "blackbox.h"
+
+#include "blackbox_sd.h"
+#include "flash.h"
+#include "flight_control.h"
+#include "pid_control.h"
+#include "motor_control.h"
+#include "esc_telemetry.h"
+#include "system_identification.h"
+#include "crash_detection.h"
+#include "motor_failure.h"
+#include "fcb_sensor_bus.h"
+#include "fcb_sensor_timing.h"
+#include "ring_buffer.h"
+#include "deadline_monitor.h"
+#include "deferred_work.h"
+#include "rate_groups.h"
+#include "common.h"
+#include "fcb_error.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Logged fields, in frame order */
+typedef enum {
+    BLACKBOX_FIELD_GYRO_X = 0,
+    BLACKBOX_FIELD_GYRO_Y,
+    BLACKBOX_FIELD_GYRO_Z,
+    BLACKBOX_FIELD_ACC_X,
+    BLACKBOX_FIELD_ACC_Y,
+    BLACKBOX_FIELD_ACC_Z,
+    BLACKBOX_FIELD_REF_Z_VELOCITY,
+    BLACKBOX_FIELD_REF_ROLL,
+    BLACKBOX_FIELD_REF_PITCH,
+    BLACKBOX_FIELD_REF_YAW_RATE,
+    BLACKBOX_FIELD_PID_ROLL_P,
+    BLACKBOX_FIELD_PID_ROLL_I,
+    BLACKBOX_FIELD_PID_ROLL_D,
+    BLACKBOX_FIELD_PID_PITCH_P,
+    BLACKBOX_FIELD_PID_PITCH_I,
+    BLACKBOX_FIELD_PID_PITCH_D,
+    BLACKBOX_FIELD_PID_YAW_P,
+    BLACKBOX_FIELD_PID_YAW_I,
+    BLACKBOX_FIELD_PID_YAW_D,
+    BLACKBOX_FIELD_MOTOR_1,
+    BLACKBOX_FIELD_MOTOR_2,
+    BLACKBOX_FIELD_MOTOR_3,
+    BLACKBOX_FIELD_MOTOR_4,
+    BLACKBOX_FIELD_DEADLINE_FLAGS,
+#ifdef MOTOR_ESC_TELEMETRY
+    BLACKBOX_FIELD_ESC_ERPM_1,
+    BLACKBOX_FIELD_ESC_ERPM_2,
+    BLACKBOX_FIELD_ESC_ERPM_3,
+    BLACKBOX_FIELD_ESC_ERPM_4,
+    BLACKBOX_FIELD_ESC_TEMPERATURE_1,
+    BLACKBOX_FIELD_ESC_TEMPERATURE_2,
+    BLACKBOX_FIELD_ESC_TEMPERATURE_3,
+    BLACKBOX_FIELD_ESC_TEMPERATURE_4,
+    BLACKBOX_FIELD_ESC_HEALTH,
+#endif
+#ifdef FCB_SYSTEM_IDENTIFICATION
+    BLACKBOX_FIELD_SYSID_AXIS,
+    BLACKBOX_FIELD_SYSID_EXCITATION,
+    BLACKBOX_FIELD_SYSID_ROLL_MOMENT,
+    BLACKBOX_FIELD_SYSID_PITCH_MOMENT,
+    BLACKBOX_FIELD_SYSID_YAW_MOMENT,
+#endif
+#ifdef FCB_CRASH_DETECTION
+    BLACKBOX_FIELD_CRASH_FLAGS,
+#endif
+#ifdef FCB_MOTOR_FAILURE_DETECTION
+    BLACKBOX_FIELD_MOTOR_FAILURE_FLAGS,
+#endif
+    BLACKBOX_FIELD_NBR
+} BlackboxField;
+
+/* Private define ------------------------------------------------------------*/
+#define BLACKBOX_FLUSH_PHASE            15      // [ms] in the 20 Hz rate group, between the journal and the LEDs
+
+/* Two 512 B blocks, which hold 30 ms of frames at the full rate, two data frames of less than 128 B per 10 ms. The
+ * blackbox work empties it to the flash log area or to the blocks of the SD card sink. It is posted once a quarter of
+ * the ring is used, and by a 20 Hz job for the end of a session and the erases. */
+#define BLACKBOX_RING_SIZE              (2*512) // Must be a power of 2
+#define BLACKBOX_FLUSH_THRESHOLD        (BLACKBOX_RING_SIZE/4) // [bytes]
+
+#define BLACKBOX_FRAME_HEADER           'H'
+#define BLACKBOX_FRAME_INTRA            'I'
+#define BLACKBOX_FRAME_PREDICTED        'P'
+#define BLACKBOX_FRAME_LOG              'L'
+
+#define BLACKBOX_MAGIC                  "DFBB"
+#define BLACKBOX_MAGIC_LEN              4
+
+#define BLACKBOX_MAX_VARINT_LEN         5
+
+/* Data rate and group delay of each sensor with a data rate setting in the header, see fcb_sensor_timing.h */
+#define BLACKBOX_TIMING_VALUE_NBR       (2*SENSOR_TIMING_SENSOR_NBR)
+
+/* Type byte, time delta and the fields, all varints */
+#define BLACKBOX_DATA_FRAME_SIZE        (1 + BLACKBOX_MAX_VARINT_LEN*(1 + BLACKBOX_FIELD_NBR))
+/* Type byte, magic, three one byte varints, the float32 scales and the float32 sensor timing */
+#define BLACKBOX_HEADER_FRAME_SIZE      (1 + BLACKBOX_MAGIC_LEN + 3 + 4*(BLACKBOX_FIELD_NBR + BLACKBOX_TIMING_VALUE_NBR))
+#define BLACKBOX_MAX_FRAME_SIZE         (BLACKBOX_DATA_FRAME_SIZE > BLACKBOX_HEADER_FRAME_SIZE ? \
+                                         BLACKBOX_DATA_FRAME_SIZE : BLACKBOX_HEADER_FRAME_SIZE)
+
+/* Scaled values are limited to this, so that the field deltas fit the 32-bit varints */
+#define BLACKBOX_MAX_FIELD_VALUE        ((float32_t) 0x3FFFFFFF)
+
+/* Inner axis controllers, of which the P, I and D parts are logged */
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+#define BLACKBOX_PID_ROLL_IDX           PID_ROLL_RATE_IDX
+#define BLACKBOX_PID_PITCH_IDX          PID_PITCH_RATE_IDX
+#else
+#define BLACKBOX_PID_ROLL_IDX           PID_ROLL_ANGLE_IDX
+#define BLACKBOX_PID_PITCH_IDX          PID_PITCH_ANGLE_IDX
+#endif
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private function prototypes -----------------------------------------------*/
+static void BlackboxWork(void* argument);
+static void BlackboxPoll(void* argument);
+static void WriteBlackboxFieldValues(int32_t values[BLACKBOX_FIELD_NBR]);
+static uint16_t EncodeBlackboxHeaderFrame(uint8_t* dst);
+static uint16_t EncodeBlackboxFrame(uint8_t* dst, const int32_t values[BLACKBOX_FIELD_NBR], const uint32_t timeDelta,
+        const bool isIntraFrame);
+static uint8_t EncodeVarint(uint8_t* dst, uint32_t value);
+static ErrorStatus PutBlackboxFrame(const uint8_t* frame, const uint16_t frameSize);
+static int32_t QuantizeBlackboxValue(const float32_t value, const float32_t scale);
+static void ReadLatestSensorSample(const FcbSensorIndexType sensor, const uint8_t subscriber, float32_t xyz[3]);
+static void FlushBlackboxRing(void);
+#ifndef FCB_SD_CARD
+static void ProgramPendingBlackboxWord(void);
+static void EraseBlackboxLog(void);
+static uint32_t FindBlackboxLogEnd(void);
+#endif
+static FcbRetValType SaveBlackboxSettings(void);
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Field value = logged value * scale, indexed by BlackboxField */
+static const float32_t blackboxFieldScales[BLACKBOX_FIELD_NBR] = {
+    1000.0, 1000.0, 1000.0,                     // Angular rates [mrad/s]
+    100.0, 100.0, 100.0,                        // Accelerations [cm/s^2]
+    1000.0, 1000.0, 1000.0, 1000.0,             // References [mm/s, mrad, mrad, mrad/s]
+    10000.0, 10000.0, 10000.0,                  // Control signal parts [0.1 mNm]
+    10000.0, 10000.0, 10000.0,
+    10000.0, 10000.0, 10000.0,
+    1.0, 1.0, 1.0, 1.0,                         // Motor control values
+    1.0,                                        // Deadline overrun flags, see GetDeadlineOverrunFlags()
+#ifdef MOTOR_ESC_TELEMETRY
+    0.01, 0.01, 0.01, 0.01,                     // ESC eRPM [100 rpm], as answered
+    1.0, 1.0, 1.0, 1.0,                         // ESC temperatures [degC]
+    1.0,                                        // ESC health, 4 bits per motor from motor 1 up, see EscHealthType
+#endif
+#ifdef FCB_SYSTEM_IDENTIFICATION
+    1.0,                                        // Excited axis, see SysIdSampleType
+    10000.0,                                    // Excitation [0.1 mNm]
+    10000.0, 10000.0, 10000.0,                  // Moment commands with the excitation [0.1 mNm]
+#endif
+#ifdef FCB_CRASH_DETECTION
+    1.0,                                        // Crash detection conditions, CRASH_FLAG_* bits
+#endif
+#ifdef FCB_MOTOR_FAILURE_DETECTION
+    1.0,                                        // MOTOR_FAILURE_FLAG_* bits and the failed motor number
+#endif
+};
+
+/* Frames encoded by the flight control task and programmed to flash by the blackbox work */
+static RingBuffer_TypeDef blackboxRing;
+static uint8_t blackboxRingArray[BLACKBOX_RING_SIZE];
+
+/* Used by the flight control task only */
+static int32_t previousFieldValues[BLACKBOX_FIELD_NBR];
+static uint32_t previousFrameTimestamp = 0;
+static uint16_t decimationCounter = 0;
+static uint8_t framesSinceIntraFrame = 0;
+static bool isSessionStarted = false;
+static bool isIntraFramePending = true;
+static uint8_t gyroSubscriber;
+static uint8_t accSubscriber;
+static float32_t latestGyroXYZ[3];
+static float32_t latestAccXYZ[3];
+
+static volatile bool isBlackboxReady = false;
+static volatile uint16_t blackboxDecimation = BLACKBOX_DEFAULT_DECIMATION;
+static volatile uint32_t framesLogged = 0;
+static volatile uint32_t framesDropped = 0;
+
+/* Log area write position and the bytes of the word not programmed yet, used by the blackbox work */
+static volatile bool isLogFull = false;
+#ifndef FCB_SD_CARD
+static volatile uint32_t logOffset = 0;
+static uint8_t pendingWordBytes[FLASH_WORD_BYTE_SIZE];
+static volatile uint8_t nbrOfPendingWordBytes = 0;
+#endif
+
+/* Set by EraseBlackbox(), the erase is done by the blackbox work while in idle mode */
+static volatile bool isErasePending = false;
+
+static const Param_TypeDef blackboxParamTable[] = {
+    { "BB_DECIMATION", PARAM_TYPE_UINT16, &blackboxDecimation, 1.0, BLACKBOX_MAX_DECIMATION }
+};
+
+/* A new decimation takes effect with the next frame */
+static const ParamGroup_TypeDef blackboxParamGroup = { blackboxParamTable,
+        sizeof(blackboxParamTable) / sizeof(blackboxParamTable[0]), NULL, SaveBlackboxSettings };
+
+static DeferredWorkId_TypeDef blackboxWorkId = DEFERRED_WORK_INVALID_ID;
+static RateGroupJobId_TypeDef blackboxPollJobId = RATE_GROUP_INVALID_ID;
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Registers the blackbox work, which programs the logged frames to flash, and finds the end of the log area.
+ *         Loads the blackbox settings from flash, the defaults are used if there are none.
+ * @param  None
+ * @retval None
+ */
+void CreateBlackboxWork(void) {
+    BlackboxSettings_TypeDef settings;
+
+    if (SUCCESS != RingBufferInit(&blackboxRing, blackboxRingArray, BLACKBOX_RING_SIZE)) {
+        ErrorHandler();
+        return;
+    }
+    BufferMonitorRegister("blackbox", BLACKBOX_RING_SIZE, &blackboxRing.stats);
+
+    if (FLASH_OK == ReadBlackboxSettingsFromFlash(&settings) && settings.decimation >= 1
+            && settings.decimation <= BLACKBOX_MAX_DECIMATION) {
+        blackboxDecimation = settings.decimation;
+    }
+
+    if (FCB_OK != SensorBusSubscribe(GYRO_IDX, &gyroSubscriber) || FCB_OK != SensorBusSubscribe(ACC_IDX, &accSubscriber)
+            || FCB_OK != DeferredWorkRegister("Blackbox", BlackboxWork, NULL, DEFERRED_WORKER_HIGH, &blackboxWorkId)
+            || FCB_OK != RateGroupRegister("BLACKBOX", BlackboxPoll, NULL, RATE_GROUP_20HZ, BLACKBOX_FLUSH_PHASE,
+                    &blackboxPollJobId)) {
+        ErrorHandler();
+        return;
+    }
+
+#ifndef FCB_SD_CARD
+    logOffset = FindBlackboxLogEnd();
+    isLogFull = (logOffset >= FLASH_LOG_SIZE);
+#endif
+    isBlackboxReady = true;
+
+#ifdef FCB_SD_CARD
+    CreateBlackboxSdTask();
+#endif
+}
+
+/*
+ * @brief  Logs a frame of the control cycle, every decimation:th cycle while not in idle mode. Called by the flight
+ *         control task once per control cycle, after the motors are set. Takes bounded time, a frame that does not
+ *         fit the ring buffer is dropped.
+ * @param  None
+ * @retval None
+ */
+void BlackboxLogControlCycle(void) {
+    uint8_t frame[BLACKBOX_MAX_FRAME_SIZE];
+    int32_t values[BLACKBOX_FIELD_NBR];
+    uint32_t now;
+    uint16_t frameSize;
+    bool isIntraFrame;
+
+    if (!isBlackboxReady) {
+        return;
+    }
+
+    /* Keep the subscriptions up to date also when not logging */
+    ReadLatestSensorSample(GYRO_IDX, gyroSubscriber, latestGyroXYZ);
+    ReadLatestSensorSample(ACC_IDX, accSubscriber, latestAccXYZ);
+
+    if (FLIGHT_CONTROL_IDLE == GetFlightControlMode()) {
+        isSessionStarted = false;
+        return;
+    }
+
+    if (isErasePending || isLogFull) {
+        framesDropped++;
+        isIntraFramePending = true;
+        return;
+    }
+
+    now = GetTimestamp();
+
+    if (!isSessionStarted) {
+        frameSize = EncodeBlackboxHeaderFrame(frame);
+        if (SUCCESS != PutBlackboxFrame(frame, frameSize)) {
+            framesDropped++;
+            return;
+        }
+        isSessionStarted = true;
+        isIntraFramePending = true;
+        decimationCounter = 0;
+        previousFrameTimestamp = now;
+    }
+
+    if (decimationCounter > 0) {
+        decimationCounter--;
+        return;
+    }
+    decimationCounter = blackboxDecimation - 1;
+
+    WriteBlackboxFieldValues(values);
+
+    isIntraFrame = isIntraFramePending || framesSinceIntraFrame >= BLACKBOX_INTRA_FRAME_INTERVAL - 1;
+    frameSize = EncodeBlackboxFrame(frame, values, TimestampToMicroseconds(now - previousFrameTimestamp), isIntraFrame);
+
+    if (SUCCESS != PutBlackboxFrame(frame, frameSize)) {
+        /* The next frame is predicted from this one, so it has to be an intra frame */
+        framesDropped++;
+        isIntraFramePending = true;
+        return;
+    }
+
+    memcpy(previousFieldValues, values, sizeof(previousFieldValues));
+    previousFrameTimestamp = now;
+    framesSinceIntraFrame = isIntraFrame ? 0 : framesSinceIntraFrame + 1;
+    isIntraFramePending = false;
+    framesLogged++;
+}
+
+/*
+ * @brief  Logs a frame of the control cycle regardless of the decimation, for an event that must not fall between
+ *         two decimated frames. Called by the flight control task instead of BlackboxLogControlCycle().
+ * @param  None
+ * @retval None
+ */
+void BlackboxLogEventFrame(void) {
+    decimationCounter = 0;
+    BlackboxLogControlCycle();
+}
+
+/*
+ * @brief  Logs the text of a log record as a log frame of the ongoing session. Called by the log work. Text outside a
+ *         session, or that does not fit the ring buffer, is dropped.
+ * @param  text : Text to log
+ * @param  length : Length of text, cut to BLACKBOX_MAX_LOG_TEXT_SIZE
+ * @retval None
+ */
+void BlackboxLogText(const char* text, const uint16_t length) {
+    uint8_t frame[1 + BLACKBOX_MAX_VARINT_LEN + BLACKBOX_MAX_LOG_TEXT_SIZE];
+    uint16_t textSize = (length < BLACKBOX_MAX_LOG_TEXT_SIZE) ? length : BLACKBOX_MAX_LOG_TEXT_SIZE;
+    uint16_t frameSize;
+
+    if (!isBlackboxReady || !isSessionStarted || isErasePending || isLogFull) {
+        return;
+    }
+
+    frame[0] = BLACKBOX_FRAME_LOG;
+    frameSize = 1 + EncodeVarint(&frame[1], textSize);
+    memcpy(&frame[frameSize], text, textSize);
+    frameSize += textSize;
+
+    /* Not counted as a dropped frame, framesDropped is only written by the flight control task */
+    (void) PutBlackboxFrame(frame, frameSize);
+}
+
+/*
+ * @brief  Requests the flight data log area to be erased. The erase is done by the blackbox work in idle mode, the
+ *         status shows when it is done. With FCB_SD_CARD the session files are deleted instead.
+ * @param  None
+ * @retval FCB_OK if requested, FCB_ERR if not in idle mode, or without a card
+ */
+FcbRetValType EraseBlackbox(void) {
+#ifdef FCB_SD_CARD
+    return BlackboxSdErase();
+#else
+    /* The CPU stalls for the page erases */
+    if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        return FCB_ERR;
+    }
+
+    isErasePending = true;
+    return FCB_OK;
+#endif
+}
+
+/*
+ * @brief  Gets the blackbox status
+ * @param  status : Destination for the status
+ * @retval None
+ */
+void GetBlackboxStatus(BlackboxStatus_TypeDef* status) {
+#ifdef FCB_SD_CARD
+    BlackboxSdStatus_TypeDef sdStatus;
+
+    GetBlackboxSdStatus(&sdStatus);
+    status->usedBytes = sdStatus.logBytes;
+    status->sizeBytes = (sdStatus.freeKBytes < (UINT32_MAX - sdStatus.logBytes) / 1024) ?
+            sdStatus.logBytes + sdStatus.freeKBytes*1024 : UINT32_MAX;
+    status->isErasing = (BLACKBOX_SD_ERASING == sdStatus.state);
+#else
+    status->usedBytes = logOffset + nbrOfPendingWordBytes;
+    status->sizeBytes = FLASH_LOG_SIZE;
+    status->isErasing = isErasePending;
+#endif
+    status->framesLogged = framesLogged;
+    status->framesDropped = framesDropped;
+    status->decimation = blackboxDecimation;
+}
+
+/*
+ * @brief  Reads bytes of the flight data log area. Bytes not programmed yet read as 0xFF.
+ * @param  offset : Offset in the log area
+ * @param  dst : Destination for the bytes
+ * @param  size : Number of bytes to read
+ * @retval FCB_OK if read, FCB_ERR if the range is outside the log area, or with FCB_SD_CARD, the session files are
+ *         read from the card
+ */
+FcbRetValType ReadBlackbox(const uint32_t offset, uint8_t* dst, const uint16_t size) {
+#ifdef FCB_SD_CARD
+    (void) offset;
+    (void) dst;
+    (void) size;
+    return FCB_ERR;
+#else
+    if (offset > FLASH_LOG_SIZE || size > FLASH_LOG_SIZE - offset) {
+        return FCB_ERR;
+    }
+
+    memcpy(dst, (const uint8_t*) (FLASH_LOG_START_ADDR + offset), size);
+    return FCB_OK;
+#endif
+}
+
+/*
+ * @brief  Gets the blackbox parameters, for the parameter table
+ * @param  None
+ * @retval The parameter group
+ */
+const ParamGroup_TypeDef* GetBlackboxParamGroup(void) {
+    return &blackboxParamGroup;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief  Programs the logged frames to flash and erases the log area on request. Runs on the high priority deferred
+ *         worker, so that the ring buffer is drained while the CLI and flash writer work on the low one blocks.
+ * @param  argument : Unused parameter
+ * @retval None
+ */
+static void BlackboxWork(void* argument) {
+    (void) argument;
+
+    if (FLIGHT_CONTROL_IDLE == GetFlightControlMode()) {
+#ifndef FCB_SD_CARD
+        if (isErasePending) {
+            EraseBlackboxLog();
+            return;
+        }
+#endif
+
+        FlushBlackboxRing();
+
+#ifdef FCB_SD_CARD
+        /* The session has ended, its file is closed when the last block is written */
+        if (RingBufferIsEmpty(&blackboxRing)) {
+            BlackboxSdEndSession();
+        }
+#else
+        /* The session has ended, a partial word is padded so that the next session starts after it */
+        if (nbrOfPendingWordBytes > 0 && RingBufferIsEmpty(&blackboxRing)) {
+            ProgramPendingBlackboxWord();
+        }
+#endif
+    } else {
+        FlushBlackboxRing();
+    }
+}
+
+/**
+ * @brief  Posts the blackbox work for the frames below the flush threshold, the end of a session and the erases. Runs
+ *         in the 20 Hz rate group.
+ * @param  argument : Unused parameter
+ * @retval None
+ */
+static void BlackboxPoll(void* argument) {
+    (void) argument;
+
+#ifdef FCB_SD_CARD
+    if (!RingBufferIsEmpty(&blackboxRing) || FLIGHT_CONTROL_IDLE == GetFlightControlMode()) {
+#else
+    if (!RingBufferIsEmpty(&blackboxRing) || nbrOfPendingWordBytes > 0 || isErasePending) {
+#endif
+        DeferredWorkPost(blackboxWorkId);
+    }
+}
+
+/*
+ * @brief  Puts a whole frame in the ring buffer. The flight control and the log work both put frames, so the put is
+ *         done in a critical section for the frames not to interleave.
+ * @param  frame : Frame to put
+ * @param  frameSize : Size of the frame
+ * @retval SUCCESS if put, ERROR if the frame does not fit
+ */
+static ErrorStatus PutBlackboxFrame(const uint8_t* frame, const uint16_t frameSize) {
+    ErrorStatus status;
+
+    uint16_t used;
+
+    taskENTER_CRITICAL();
+    status = RingBufferPutData(&blackboxRing, frame, frameSize);
+    used = RingBufferGetUsed(&blackboxRing);
+    taskEXIT_CRITICAL();
+
+    if (used >= BLACKBOX_FLUSH_THRESHOLD) {
+        DeferredWorkPost(blackboxWorkId);
+    }
+
+    return status;
+}
+
+/*
+ * @brief  Reads the logged values of the control cycle, quantized with the field scales
+ * @param  values : Destination for the field values, indexed by BlackboxField
+ * @retval None
+ */
+static void WriteBlackboxFieldValues(int32_t values[BLACKBOX_FIELD_NBR]) {
+    float32_t fieldValues[BLACKBOX_FIELD_NBR];
+#ifdef MOTOR_ESC_TELEMETRY
+    EscTelemetryType escTelemetry[MOTOR_OUTPUT_CHANNELS];
+    uint32_t escHealth = 0;
+#endif
+#ifdef FCB_SYSTEM_IDENTIFICATION
+    SysIdSampleType sysIdSample;
+#endif
+#ifdef FCB_CRASH_DETECTION
+    CrashDetectionStatusType crashStatus;
+#endif
+#ifdef FCB_MOTOR_FAILURE_DETECTION
+    MotorFailureStatusType motorFailureStatus;
+#endif
+    uint8_t i;
+
+    fieldValues[BLACKBOX_FIELD_GYRO_X] = latestGyroXYZ[0];
+    fieldValues[BLACKBOX_FIELD_GYRO_Y] = latestGyroXYZ[1];
+    fieldValues[BLACKBOX_FIELD_GYRO_Z] = latestGyroXYZ[2];
+    fieldValues[BLACKBOX_FIELD_ACC_X] = latestAccXYZ[0];
+    fieldValues[BLACKBOX_FIELD_ACC_Y] = latestAccXYZ[1];
+    fieldValues[BLACKBOX_FIELD_ACC_Z] = latestAccXYZ[2];
+    fieldValues[BLACKBOX_FIELD_REF_Z_VELOCITY] = GetZVelocityReferenceSignal();
+    fieldValues[BLACKBOX_FIELD_REF_ROLL] = GetRollAngleReferenceSignal();
+    fieldValues[BLACKBOX_FIELD_REF_PITCH] = GetPitchAngleReferenceSignal();
+    fieldValues[BLACKBOX_FIELD_REF_YAW_RATE] = GetYawAngularRateReferenceSignal();
+    GetPIDTerms(BLACKBOX_PID_ROLL_IDX, &fieldValues[BLACKBOX_FIELD_PID_ROLL_P]);
+    GetPIDTerms(BLACKBOX_PID_PITCH_IDX, &fieldValues[BLACKBOX_FIELD_PID_PITCH_P]);
+    GetPIDTerms(PID_YAW_RATE_IDX, &fieldValues[BLACKBOX_FIELD_PID_YAW_P]);
+    fieldValues[BLACKBOX_FIELD_MOTOR_1] = GetMotorValue(1);
+    fieldValues[BLACKBOX_FIELD_MOTOR_2] = GetMotorValue(2);
+    fieldValues[BLACKBOX_FIELD_MOTOR_3] = GetMotorValue(3);
+    fieldValues[BLACKBOX_FIELD_MOTOR_4] = GetMotorValue(4);
+    fieldValues[BLACKBOX_FIELD_DEADLINE_FLAGS] = GetDeadlineOverrunFlags();
+#ifdef MOTOR_ESC_TELEMETRY
+    GetEscTelemetry(escTelemetry);
+    for (i = 0; i < MOTOR_OUTPUT_CHANNELS; i++) {
+        fieldValues[BLACKBOX_FIELD_ESC_ERPM_1 + i] = escTelemetry[i].eRpm;
+        fieldValues[BLACKBOX_FIELD_ESC_TEMPERATURE_1 + i] = escTelemetry[i].temperature;
+        escHealth |= (uint32_t) escTelemetry[i].health << (4*i);
+    }
+    fieldValues[BLACKBOX_FIELD_ESC_HEALTH] = escHealth;
+#endif
+#ifdef FCB_SYSTEM_IDENTIFICATION
+    GetSystemIdentificationSample(&sysIdSample);
+    fieldValues[BLACKBOX_FIELD_SYSID_AXIS] = sysIdSample.axis;
+    fieldValues[BLACKBOX_FIELD_SYSID_EXCITATION] = sysIdSample.excitation;
+    fieldValues[BLACKBOX_FIELD_SYSID_ROLL_MOMENT] = sysIdSample.moments[0];
+    fieldValues[BLACKBOX_FIELD_SYSID_PITCH_MOMENT] = sysIdSample.moments[1];
+    fieldValues[BLACKBOX_FIELD_SYSID_YAW_MOMENT] = sysIdSample.moments[2];
+#endif
+#ifdef FCB_CRASH_DETECTION
+    GetCrashDetectionStatus(&crashStatus);
+    fieldValues[BLACKBOX_FIELD_CRASH_FLAGS] = crashStatus.flags;
+#endif
+#ifdef FCB_MOTOR_FAILURE_DETECTION
+    GetMotorFailureStatus(&motorFailureStatus);
+    fieldValues[BLACKBOX_FIELD_MOTOR_FAILURE_FLAGS] = motorFailureStatus.flags;
+#endif
+
+    for (i = 0; i < BLACKBOX_FIELD_NBR; i++) {
+        values[i] = QuantizeBlackboxValue(fieldValues[i], blackboxFieldScales[i]);
+    }
+}
+
+/*
+ * @brief  Encodes the session header frame
+ * @param  dst : Destination of at least BLACKBOX_MAX_FRAME_SIZE bytes
+ * @retval The frame size
+ */
+static uint16_t EncodeBlackboxHeaderFrame(uint8_t* dst) {
+    FcbSensorTimingType timing;
+    uint8_t* pos = dst;
+    uint8_t sensor;
+
+    *pos++ = BLACKBOX_FRAME_HEADER;
+    memcpy(pos, BLACKBOX_MAGIC, BLACKBOX_MAGIC_LEN);
+    pos += BLACKBOX_MAGIC_LEN;
+    pos += EncodeVarint(pos, BLACKBOX_FORMAT_VERSION);
+    pos += EncodeVarint(pos, blackboxDecimation);
+    pos += EncodeVarint(pos, BLACKBOX_FIELD_NBR);
+    memcpy(pos, blackboxFieldScales, sizeof(blackboxFieldScales));
+    pos += sizeof(blackboxFieldScales);
+
+    /* The sample timing the log was taken with, the rates may differ between sessions */
+    for (sensor = 0; sensor < SENSOR_TIMING_SENSOR_NBR; sensor++) {
+        GetSensorTiming((FcbSensorIndexType) sensor, &timing);
+        memcpy(pos, &timing.dataRateHz, sizeof(float32_t));
+        pos += sizeof(float32_t);
+        memcpy(pos, &timing.groupDelay, sizeof(float32_t));
+        pos += sizeof(float32_t);
+    }
+
+    return pos - dst;
+}
+
+/*
+ * @brief  Encodes an intra or a predicted frame
+ * @param  dst : Destination of at least BLACKBOX_MAX_FRAME_SIZE bytes
+ * @param  values : Field values of the frame
+ * @param  timeDelta : Time since the previous frame [us]
+ * @param  isIntraFrame : true for an intra frame, false for a frame with the changes since the previous frame
+ * @retval The frame size
+ */
+static uint16_t EncodeBlackboxFrame(uint8_t* dst, const int32_t values[BLACKBOX_FIELD_NBR], const uint32_t timeDelta,
+        const bool isIntraFrame) {
+    uint8_t* pos = dst;
+    int32_t value;
+    uint8_t i;
+
+    *pos++ = isIntraFrame ? BLACKBOX_FRAME_INTRA : BLACKBOX_FRAME_PREDICTED;
+    pos += EncodeVarint(pos, timeDelta);
+
+    for (i = 0; i < BLACKBOX_FIELD_NBR; i++) {
+        value = isIntraFrame ? values[i] : values[i] - previousFieldValues[i];
+        pos += EncodeVarint(pos, ((uint32_t) value << 1) ^ (uint32_t) (value >> 31));
+    }
+
+    return pos - dst;
+}
+
+/*
+ * @brief  Encodes a varint, 7 bits per byte starting with the least significant, the high bit set on all but the last
+ * @param  dst : Destination of at least BLACKBOX_MAX_VARINT_LEN bytes
+ * @param  value : Value to encode
+ * @retval Number of bytes written
+ */
+static uint8_t EncodeVarint(uint8_t* dst, uint32_t value) {
+    uint8_t len = 0;
+
+    while (value >= 0x80) {
+        dst[len++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    dst[len++] = (uint8_t) value;
+
+    return len;
+}
+
+/*
+ * @brief  Scales and rounds a logged value, limited to +-BLACKBOX_MAX_FIELD_VALUE
+ * @param  value : Logged value
+ * @param  scale : Field scale
+ * @retval The field value
+ */
+static int32_t QuantizeBlackboxValue(const float32_t value, const float32_t scale) {
+    float32_t scaled = value*scale;
+
+    if (scaled > BLACKBOX_MAX_FIELD_VALUE) {
+        scaled = BLACKBOX_MAX_FIELD_VALUE;
+    } else if (scaled < -BLACKBOX_MAX_FIELD_VALUE) {
+        scaled = -BLACKBOX_MAX_FIELD_VALUE;
+    } else if (scaled != scaled) {
+        scaled = 0.0; // NaN
+    }
+
+    return (int32_t) (scaled >= 0.0f ? scaled + 0.5f : scaled - 0.5f);
+}
+
+/*
+ * @brief  Reads the samples published since the last read of a subscriber and keeps the newest one
+ * @param  sensor : Sensor to read
+ * @param  subscriber : Subscriber ID
+ * @param  xyz : Newest sample, kept as is if there are no new samples
+ * @retval None
+ */
+static void ReadLatestSensorSample(const FcbSensorIndexType sensor, const uint8_t subscriber, float32_t xyz[3]) {
+    const FcbSensorSampleType* sample;
+    float32_t sampleXYZ[3];
+    uint32_t sequence;
+
+    /* At most the ring of samples is read */
+    while (NULL != (sample = SensorBusRead(sensor, subscriber, &sequence))) {
+        memcpy(sampleXYZ, sample->xyz, sizeof(sampleXYZ));
+        if (SensorBusSampleStillValid(sensor, sequence)) {
+            memcpy(xyz, sampleXYZ, sizeof(sampleXYZ));
+        }
+    }
+}
+
+#ifdef FCB_SD_CARD
+/*
+ * @brief  Hands the ring buffer contents to the SD card sink, as far as its blocks take them
+ * @param  None
+ * @retval None
+ */
+static void FlushBlackboxRing(void) {
+    uint8_t* span;
+    uint16_t spanSize, taken;
+
+    while ((spanSize = RingBufferPeekRead(&blackboxRing, &span)) > 0) {
+        taken = BlackboxSdWrite(span, spanSize);
+        RingBufferCommitRead(&blackboxRing, taken);
+        if (taken < spanSize) {
+            return; // The rest is handed over at the next post
+        }
+    }
+}
+#else
+/*
+ * @brief  Programs the ring buffer contents to the log area, a word at a time. Bytes that do not fit the log area
+ *         are discarded.
+ * @param  None
+ * @retval None
+ */
+static void FlushBlackboxRing(void) {
+    uint8_t* span;
+    uint16_t spanSize, i;
+
+    while ((spanSize = RingBufferPeekRead(&blackboxRing, &span)) > 0) {
+        for (i = 0; i < spanSize && !isLogFull; i++) {
+            pendingWordBytes[nbrOfPendingWordBytes++] = span[i];
+            if (FLASH_WORD_BYTE_SIZE == nbrOfPendingWordBytes) {
+                ProgramPendingBlackboxWord();
+            }
+        }
+        RingBufferCommitRead(&blackboxRing, spanSize);
+    }
+}
+
+/*
+ * @brief  Programs the pending bytes as the next word of the log area, padded with erased bytes
+ * @param  None
+ * @retval None
+ */
+static void ProgramPendingBlackboxWord(void) {
+    uint32_t word;
+
+    memset(&pendingWordBytes[nbrOfPendingWordBytes], 0xFF, FLASH_WORD_BYTE_SIZE - nbrOfPendingWordBytes);
+    memcpy(&word, pendingWordBytes, FLASH_WORD_BYTE_SIZE);
+
+    /* A word that fails to program is skipped, the frame in it is lost */
+    ProgramFlashLogWord(logOffset, word);
+
+    nbrOfPendingWordBytes = 0;
+    logOffset += FLASH_WORD_BYTE_SIZE;
+    if (logOffset >= FLASH_LOG_SIZE) {
+        isLogFull = true;
+    }
+}
+
+/*
+ * @brief  Erases the last used page of the log area, while in idle mode. One page per run, so that the tasks below
+ *         the high deferred worker get the CPU between the page erases, the blackbox poll posts the work again while
+ *         the erase is pending.
+ * @param  None
+ * @retval None
+ */
+static void EraseBlackboxLog(void) {
+    uint16_t nbrOfUsedPages = (logOffset + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE;
+
+    /* Erased from the end, so that the log end found at startup stays valid if this is interrupted */
+    if (nbrOfUsedPages > 0) {
+        if (FLASH_OK != EraseFlashLogPage(nbrOfUsedPages - 1)) {
+            ErrorHandler();
+        }
+        nbrOfUsedPages--;
+        logOffset = nbrOfUsedPages * FLASH_PAGE_SIZE;
+    }
+
+    if (nbrOfUsedPages > 0) {
+        return;
+    }
+
+    /* Frames of the erased log that were not programmed yet are discarded */
+    RingBufferCommitRead(&blackboxRing, RingBufferGetUsed(&blackboxRing));
+    nbrOfPendingWordBytes = 0;
+    logOffset = 0;
+    isLogFull = false;
+    isErasePending = false;
+}
+
+/*
+ * @brief  Finds the end of the log area contents, after the last programmed word
+ * @param  None
+ * @retval Offset of the end in the log area
+ */
+static uint32_t FindBlackboxLogEnd(void) {
+    uint32_t offset = FLASH_LOG_SIZE;
+
+    while (offset > 0 && 0xFFFFFFFF == *(const volatile uint32_t*) (FLASH_LOG_START_ADDR + offset - FLASH_WORD_BYTE_SIZE)) {
+        offset -= FLASH_WORD_BYTE_SIZE;
+    }
+
+    return offset;
+}
+#endif /* FCB_SD_CARD */
+
+/*
+ * @brief  Saves the blackbox settings to flash
+ * @param  None
+ * @retval FCB_OK if saved, FCB_ERR otherwise
+ */
+static FcbRetValType SaveBlackboxSettings(void) {
+    BlackboxSettings_TypeDef settings;
+
+    settings.decimation = blackboxDecimation;
+    if (FLASH_OK != WriteBlackboxSettingsToFlash(&settings)) {
+        return FCB_ERR;
+    }
+
+    return FCB_OK;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,699 @@
+/******************************************************************************
+ * @file    blackbox_sd.c
+ * @brief   SD card sink of the blackbox, a session file per flight on a FAT
+ *          volume, see blackbox_sd.h
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "blackbox_sd.h"
+
+#ifdef FCB_SD_CARD
+
+#include "fat_sl.h"
+#include "flight_control.h"
+#include "deferred_log.h"
+#include "fcb_error.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+typedef struct {
+    uint16_t length;                // Log bytes in data
+    bool isSessionEnd;              // The session ends after data, which may be empty
+    uint8_t data[BLACKBOX_SD_BLOCK_SIZE];
+} BlackboxSdBlock_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define BLACKBOX_SD_TASK_PRIO           1
+#define BLACKBOX_SD_IDLE_PERIOD         100     // [ms] Wait for a block while not preallocating
+
+#define BLACKBOX_SD_NBR_OF_BLOCKS       2
+#define BLACKBOX_SD_FILE_PATTERN        "BB*.BBL"
+#define BLACKBOX_SD_FILE_NAME_SIZE      11      // BBnnnn.BBL
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private function prototypes -----------------------------------------------*/
+static void BlackboxSdTask(void const *argument);
+static FcbRetValType MountBlackboxSd(void);
+static void UnmountBlackboxSd(void);
+static void ScanBlackboxSdFiles(void);
+static FcbRetValType OpenNextBlackboxSdFile(void);
+static void PreallocateBlackboxSdFile(void);
+static void WriteBlackboxSdBlock(BlackboxSdBlock_TypeDef* block);
+static void CloseBlackboxSdSession(void);
+static void FailBlackboxSdSession(void);
+static void EraseBlackboxSdFiles(void);
+static void DropBlackboxSdBlocks(void);
+static void UpdateBlackboxSdFreeSpace(void);
+static void SetBlackboxSdState(const BlackboxSdStateType state);
+static void FormatBlackboxSdFileName(char* dst, const uint16_t fileNumber);
+
+/* Private variables ---------------------------------------------------------*/
+
+static BlackboxSdBlock_TypeDef blackboxSdBlocks[BLACKBOX_SD_NBR_OF_BLOCKS];
+
+/* Indices of the blocks to fill, by the blackbox work, and of the blocks to write, by the BLACKBOX_SD task */
+static xQueueHandle freeBlockQueue = NULL;
+static xQueueHandle fullBlockQueue = NULL;
+
+/* Used by the blackbox work only */
+static BlackboxSdBlock_TypeDef* fillBlock = NULL;
+static uint8_t fillBlockIndex;
+static bool isWriterSessionOpen = false;
+static bool isWriterSessionDiscarded = false;
+static uint32_t writerDiscardedBytes = 0;
+
+/* Used by the BLACKBOX_SD task only, except where noted */
+static F_FILE* sessionFile = NULL;
+static bool isSessionOpen = false;      // A block of the session was written to sessionFile
+static volatile bool isMounted = false;
+static volatile bool isSessionBroken = false; // A write failed, the rest of the session is discarded
+static volatile bool isErasePending = false;
+static uint32_t closedLogBytes = 0;
+static uint32_t droppedBytes = 0;
+
+/* Read by GetBlackboxSdStatus(), updated in critical sections */
+static BlackboxSdStatus_TypeDef blackboxSdStatus;
+
+static const char* const blackboxSdStateNames[BLACKBOX_SD_STATE_NBR] = { "no card", "no FAT volume",
+        "preallocating", "ready", "logging", "erasing" };
+
+static xTaskHandle BlackboxSdTaskHandle = NULL;
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Creates the BLACKBOX_SD task, which mounts the card and writes the session files
+ * @param  None
+ * @retval None
+ */
+void CreateBlackboxSdTask(void) {
+    uint8_t i;
+
+    memset(&blackboxSdStatus, 0, sizeof(blackboxSdStatus));
+
+    freeBlockQueue = xQueueCreate(BLACKBOX_SD_NBR_OF_BLOCKS, sizeof(uint8_t));
+    fullBlockQueue = xQueueCreate(BLACKBOX_SD_NBR_OF_BLOCKS, sizeof(uint8_t));
+    if (NULL == freeBlockQueue || NULL == fullBlockQueue) {
+        ErrorHandler();
+        return;
+    }
+
+    for (i = 0; i < BLACKBOX_SD_NBR_OF_BLOCKS; i++) {
+        (void) xQueueSend(freeBlockQueue, &i, 0);
+    }
+
+    /* Blackbox SD task creation
+     * Task function pointer: BlackboxSdTask
+     * Task name: BLACKBOX_SD
+     * Stack depth: 3*configMINIMAL_STACK_SIZE
+     * Parameter: NULL
+     * Priority: BLACKBOX_SD_TASK_PRIO (0 to configMAX_PRIORITIES-1 possible)
+     * Handle: BlackboxSdTaskHandle
+     * */
+    if (pdPASS != xTaskCreate((pdTASK_CODE )BlackboxSdTask, (signed portCHAR*)"BLACKBOX_SD",
+                    3*configMINIMAL_STACK_SIZE, NULL, BLACKBOX_SD_TASK_PRIO, &BlackboxSdTaskHandle)) {
+        ErrorHandler();
+    }
+}
+
+/*
+ * @brief  Copies log bytes to the block being filled, which is handed to the BLACKBOX_SD task when full. Called by
+ *         the blackbox work.
+ * @param  data : Log bytes
+ * @param  size : Number of bytes
+ * @retval Number of bytes taken
+ */
+uint16_t BlackboxSdWrite(const uint8_t* data, const uint16_t size) {
+    uint16_t taken = 0;
+    uint16_t chunk;
+
+    if (0 == size) {
+        return 0;
+    }
+
+    /* A session is kept in the file from its start, or discarded */
+    if (!isWriterSessionOpen) {
+        isWriterSessionOpen = true;
+        isWriterSessionDiscarded = !isMounted;
+    }
+
+    if (isWriterSessionDiscarded || isSessionBroken) {
+        writerDiscardedBytes += size;
+        return size;
+    }
+
+    while (taken < size) {
+        if (NULL == fillBlock) {
+            if (pdTRUE != xQueueReceive(freeBlockQueue, &fillBlockIndex, 0)) {
+                break;
+            }
+            fillBlock = &blackboxSdBlocks[fillBlockIndex];
+            fillBlock->length = 0;
+            fillBlock->isSessionEnd = false;
+        }
+
+        chunk = BLACKBOX_SD_BLOCK_SIZE - fillBlock->length;
+        if (chunk > size - taken) {
+            chunk = size - taken;
+        }
+        memcpy(&fillBlock->data[fillBlock->length], &data[taken], chunk);
+        fillBlock->length += chunk;
+        taken += chunk;
+
+        if (BLACKBOX_SD_BLOCK_SIZE == fillBlock->length) {
+            (void) xQueueSend(fullBlockQueue, &fillBlockIndex, 0);
+            fillBlock = NULL;
+        }
+    }
+
+    return taken;
+}
+
+/*
+ * @brief  Hands the partly filled block, or an empty one, to the BLACKBOX_SD task as the end of the session. Called
+ *         by the blackbox work. Retried at the next call if there is no free block.
+ * @param  None
+ * @retval None
+ */
+void BlackboxSdEndSession(void) {
+    if (!isWriterSessionOpen) {
+        return;
+    }
+
+    /* Nothing of the session was handed over, and no failure is to be reset */
+    if (isWriterSessionDiscarded && !isSessionBroken) {
+        isWriterSessionOpen = false;
+        return;
+    }
+
+    if (NULL == fillBlock) {
+        if (pdTRUE != xQueueReceive(freeBlockQueue, &fillBlockIndex, 0)) {
+            return;
+        }
+        fillBlock = &blackboxSdBlocks[fillBlockIndex];
+        fillBlock->length = 0;
+    }
+
+    fillBlock->isSessionEnd = true;
+    (void) xQueueSend(fullBlockQueue, &fillBlockIndex, 0);
+    fillBlock = NULL;
+    isWriterSessionOpen = false;
+}
+
+/*
+ * @brief  Requests the session files to be deleted. Done by the BLACKBOX_SD task in idle mode, the status shows when
+ *         it is done.
+ * @param  None
+ * @retval FCB_OK if requested, FCB_ERR if not in idle mode or there is no volume
+ */
+FcbRetValType BlackboxSdErase(void) {
+    if (FLIGHT_CONTROL_IDLE != GetFlightControlMode() || !isMounted) {
+        return FCB_ERR;
+    }
+
+    isErasePending = true;
+    return FCB_OK;
+}
+
+/*
+ * @brief  Gets the status of the SD card sink
+ * @param  dstStatus : Destination of the status
+ * @retval None
+ */
+void GetBlackboxSdStatus(BlackboxSdStatus_TypeDef* dstStatus) {
+    taskENTER_CRITICAL();
+    memcpy(dstStatus, &blackboxSdStatus, sizeof(blackboxSdStatus));
+    dstStatus->discardedBytes = writerDiscardedBytes + droppedBytes;
+    taskEXIT_CRITICAL();
+
+    if (isErasePending) {
+        dstStatus->state = BLACKBOX_SD_ERASING;
+    }
+}
+
+/*
+ * @brief  Prints the status of the SD card sink and of the card
+ * @param  dst : Destination of the text
+ * @param  dstSize : Size of dst
+ * @retval Length of the text, as snprintf()
+ */
+size_t PrintBlackboxSdStatus(char* dst, const size_t dstSize) {
+    BlackboxSdStatus_TypeDef status;
+    SdCardStats_TypeDef card;
+    char fileName[BLACKBOX_SD_FILE_NAME_SIZE + 1];
+
+    GetBlackboxSdStatus(&status);
+    GetSdCardStats(&card);
+    FormatBlackboxSdFileName(fileName, status.fileNumber);
+
+    return (size_t) snprintf(dst, dstSize, "SD card: %s, %s, %lu MB\nFile: %s, %lu/%lu kB\nFiles: %u, %lu kB\n"
+            "Free [kB]: %lu\nDiscarded [bytes]: %lu\nSectors written: %lu in %lu multiple block writes\n"
+            "Max block write [ms]: %lu, max busy [ms]: %lu\nErrors: %lu\n", blackboxSdStateNames[status.state],
+            GetSdCardTypeName(card.type), card.sectors / (1024*1024/SD_CARD_SECTOR_SIZE), fileName,
+            status.sessionBytes / 1024, status.preallocatedBytes / 1024, status.files, status.logBytes / 1024,
+            status.freeKBytes, status.discardedBytes, card.sectorsWritten, card.multiBlockWrites, status.maxBlockTime,
+            card.maxBusyTime, card.errors);
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief  Task code mounts the card, writes the handed over blocks to the session files and preallocates the next
+ *         file in between
+ * @param  argument : Unused parameter
+ * @retval None
+ */
+static void BlackboxSdTask(void const *argument) {
+    uint8_t index;
+    portTickType wait;
+
+    (void) argument;
+
+    f_init();
+
+    for (;;) {
+        if (!isMounted && FCB_OK != MountBlackboxSd()) {
+            DropBlackboxSdBlocks();
+            vTaskDelay(BLACKBOX_SD_MOUNT_RETRY_PERIOD / portTICK_RATE_MS);
+            continue;
+        }
+
+        if (isErasePending && !isSessionOpen) {
+            EraseBlackboxSdFiles();
+            continue;
+        }
+
+        if (NULL == sessionFile && FCB_OK != OpenNextBlackboxSdFile()) {
+            FailBlackboxSdSession();
+            continue;
+        }
+
+        /* Preallocated between the blocks until done, not once the session has started in the file */
+        wait = (!isSessionOpen && blackboxSdStatus.preallocatedBytes < BLACKBOX_SD_FILE_SIZE) ? 0
+                : BLACKBOX_SD_IDLE_PERIOD / portTICK_RATE_MS;
+
+        if (pdTRUE == xQueueReceive(fullBlockQueue, &index, wait)) {
+            WriteBlackboxSdBlock(&blackboxSdBlocks[index]);
+            (void) xQueueSend(freeBlockQueue, &index, 0);
+        } else if (0 == wait) {
+            PreallocateBlackboxSdFile();
+        }
+    }
+}
+
+/*
+ * @brief  Initialises the card, mounts its volume and scans the session files on it
+ * @param  None
+ * @retval FCB_OK if mounted, FCB_ERR otherwise
+ */
+static FcbRetValType MountBlackboxSd(void) {
+    unsigned char fsError;
+
+    if (FCB_OK != SdCardInit()) {
+        SetBlackboxSdState(BLACKBOX_SD_NO_CARD);
+        return FCB_ERR;
+    }
+
+    fsError = f_initvolume(SdCardDriverInit);
+    if (F_NO_ERROR != fsError) {
+        LOG1("Blackbox SD: no volume, error %lu", fsError);
+        SetBlackboxSdState(BLACKBOX_SD_NO_VOLUME);
+        (void) f_delvolume();
+        return FCB_ERR;
+    }
+
+    ScanBlackboxSdFiles();
+    UpdateBlackboxSdFreeSpace();
+    isMounted = true;
+
+    LOG2("Blackbox SD: %lu session files, %lu kB free", blackboxSdStatus.files, blackboxSdStatus.freeKBytes);
+    return FCB_OK;
+}
+
+/*
+ * @brief  Drops the volume after a card failure, it is mounted again at the next attempt
+ * @param  None
+ * @retval None
+ */
+static void UnmountBlackboxSd(void) {
+    /* The file handle is released, its directory entry may not be updated */
+    if (NULL != sessionFile) {
+        (void) f_close(sessionFile);
+        sessionFile = NULL;
+    }
+    (void) f_delvolume();
+
+    isSessionOpen = false;
+    isMounted = false;
+    SetBlackboxSdState(BLACKBOX_SD_NO_CARD);
+}
+
+/*
+ * @brief  Counts the session files and their bytes, and takes the number of the next file. The highest numbered file
+ *         is continued if it holds no session, its first byte is that of a preallocated file.
+ * @param  None
+ * @retval None
+ */
+static void ScanBlackboxSdFiles(void) {
+    F_FIND find;
+    uint32_t number, highestSize = 0;
+    uint16_t highestNumber = 0, files = 0;
+    uint32_t logBytes = 0;
+    F_FILE* file;
+    char fileName[BLACKBOX_SD_FILE_NAME_SIZE + 1];
+    int firstByte;
+
+    if (F_NO_ERROR == f_findfirst(BLACKBOX_SD_FILE_PATTERN, &find)) {
+        do {
+            number = strtoul(&find.filename[2], NULL, 10);
+            if (number > 0 && number <= BLACKBOX_SD_MAX_FILE_NUMBER) {
+                files++;
+                logBytes += (uint32_t) find.filesize;
+                if (number > highestNumber) {
+                    highestNumber = (uint16_t) number;
+                    highestSize = (uint32_t) find.filesize;
+                }
+            }
+        } while (F_NO_ERROR == f_findnext(&find));
+    }
+
+    taskENTER_CRITICAL();
+    blackboxSdStatus.files = files;
+    blackboxSdStatus.fileNumber = highestNumber + 1;
+    blackboxSdStatus.preallocatedBytes = 0;
+    taskEXIT_CRITICAL();
+    closedLogBytes = logBytes;
+
+    if (0 == highestNumber) {
+        return;
+    }
+
+    FormatBlackboxSdFileName(fileName, highestNumber);
+    file = f_open(fileName, "r");
+    if (NULL == file) {
+        return;
+    }
+    firstByte = f_getc(file);
+    (void) f_close(file);
+
+    if (0 == firstByte) {
+        taskENTER_CRITICAL();
+        blackboxSdStatus.files--;
+        blackboxSdStatus.fileNumber = highestNumber;
+        blackboxSdStatus.preallocatedBytes = highestSize;
+        taskEXIT_CRITICAL();
+        closedLogBytes -= highestSize;
+    }
+}
+
+/*
+ * @brief  Opens the file of the next session, created empty or continued if preallocated before
+ * @param  None
+ * @retval FCB_OK if opened, FCB_ERR otherwise
+ */
+static FcbRetValType OpenNextBlackboxSdFile(void) {
+    static const uint8_t zeroSector[SD_CARD_SECTOR_SIZE] = { 0 };
+    char fileName[BLACKBOX_SD_FILE_NAME_SIZE + 1];
+
+    if (blackboxSdStatus.fileNumber > BLACKBOX_SD_MAX_FILE_NUMBER) {
+        SetBlackboxSdState(BLACKBOX_SD_NO_VOLUME);
+        return FCB_ERR;
+    }
+
+    FormatBlackboxSdFileName(fileName, blackboxSdStatus.fileNumber);
+
+    if (blackboxSdStatus.preallocatedBytes > 0) {
+        sessionFile = f_open(fileName, "r+");
+    } else {
+        /* A first zero sector allocates the file, so that seeks can extend it, and marks it as holding no session */
+        sessionFile = f_open(fileName, "w");
+        if (NULL != sessionFile && SD_CARD_SECTOR_SIZE != f_write(zeroSector, 1, SD_CARD_SECTOR_SIZE, sessionFile)) {
+            (void) f_close(sessionFile);
+            sessionFile = NULL;
+        }
+        taskENTER_CRITICAL();
+        blackboxSdStatus.preallocatedBytes = SD_CARD_SECTOR_SIZE;
+        taskEXIT_CRITICAL();
+    }
+
+    if (NULL == sessionFile) {
+        return FCB_ERR;
+    }
+
+    SetBlackboxSdState((blackboxSdStatus.preallocatedBytes < BLACKBOX_SD_FILE_SIZE) ? BLACKBOX_SD_PREALLOCATING
+            : BLACKBOX_SD_READY);
+    return FCB_OK;
+}
+
+/*
+ * @brief  Extends the next session file by BLACKBOX_SD_PREALLOCATION_STEP, FAT-SL fills the extension with zeros.
+ *         A full volume ends the preallocation, the session then extends the file as it goes.
+ * @param  None
+ * @retval None
+ */
+static void PreallocateBlackboxSdFile(void) {
+    uint32_t size = blackboxSdStatus.preallocatedBytes + BLACKBOX_SD_PREALLOCATION_STEP;
+
+    if (size > BLACKBOX_SD_FILE_SIZE) {
+        size = BLACKBOX_SD_FILE_SIZE;
+    }
+
+    if (F_NO_ERROR != f_seek(sessionFile, (long) size, F_SEEK_SET)) {
+        if (!SdCardIsReady()) {
+            FailBlackboxSdSession();
+            return;
+        }
+        size = BLACKBOX_SD_FILE_SIZE;
+    }
+
+    taskENTER_CRITICAL();
+    blackboxSdStatus.preallocatedBytes = size;
+    taskEXIT_CRITICAL();
+
+    if (BLACKBOX_SD_FILE_SIZE == size) {
+        /* The directory entry gets the preallocated size, so that it is kept if the power is lost */
+        (void) f_flush(sessionFile);
+        (void) SdCardFlush();
+        UpdateBlackboxSdFreeSpace();
+        SetBlackboxSdState(BLACKBOX_SD_READY);
+    }
+}
+
+/*
+ * @brief  Writes a block to the session file, the first block of a session from the start of the file
+ * @param  block : Block to write
+ * @retval None
+ */
+static void WriteBlackboxSdBlock(BlackboxSdBlock_TypeDef* block) {
+    uint32_t start, blockTime;
+
+    if (isSessionBroken || NULL == sessionFile) {
+        droppedBytes += block->length;
+        if (block->isSessionEnd) {
+            isSessionBroken = false;
+        }
+        return;
+    }
+
+    if (!isSessionOpen) {
+        if (F_NO_ERROR != f_seek(sessionFile, 0, F_SEEK_SET)) {
+            droppedBytes += block->length;
+            FailBlackboxSdSession();
+            return;
+        }
+        isSessionOpen = true;
+        SetBlackboxSdState(BLACKBOX_SD_LOGGING);
+    }
+
+    if (block->length > 0) {
+        start = xTaskGetTickCount();
+        if (block->length != f_write(block->data, 1, block->length, sessionFile)) {
+            droppedBytes += block->length;
+            FailBlackboxSdSession();
+            return;
+        }
+
+        blockTime = (xTaskGetTickCount() - start) * portTICK_RATE_MS;
+
+        taskENTER_CRITICAL();
+        blackboxSdStatus.sessionBytes += block->length;
+        blackboxSdStatus.logBytes = closedLogBytes + blackboxSdStatus.sessionBytes;
+        if (blockTime > blackboxSdStatus.maxBlockTime) {
+            blackboxSdStatus.maxBlockTime = blockTime;
+        }
+        taskEXIT_CRITICAL();
+    }
+
+    if (block->isSessionEnd) {
+        CloseBlackboxSdSession();
+    }
+}
+
+/*
+ * @brief  Cuts the session file to the session length and closes it, the next file is opened by the task loop
+ * @param  None
+ * @retval None
+ */
+static void CloseBlackboxSdSession(void) {
+    unsigned char fsError = f_seteof(sessionFile);
+
+    if (F_NO_ERROR == fsError) {
+        fsError = f_close(sessionFile);
+    } else {
+        (void) f_close(sessionFile);
+    }
+    sessionFile = NULL;
+    isSessionOpen = false;
+
+    if (F_NO_ERROR != fsError || FCB_OK != SdCardFlush()) {
+        FailBlackboxSdSession();
+        return;
+    }
+
+    closedLogBytes += blackboxSdStatus.sessionBytes;
+    taskENTER_CRITICAL();
+    blackboxSdStatus.files++;
+    blackboxSdStatus.fileNumber++;
+    blackboxSdStatus.sessionBytes = 0;
+    blackboxSdStatus.preallocatedBytes = 0;
+    blackboxSdStatus.logBytes = closedLogBytes;
+    taskEXIT_CRITICAL();
+
+    UpdateBlackboxSdFreeSpace();
+}
+
+/*
+ * @brief  Gives up the ongoing session after a failed file operation. Its file is kept as far as written, the next
+ *         session goes to a new file. After a card failure the volume is mounted again.
+ * @param  None
+ * @retval None
+ */
+static void FailBlackboxSdSession(void) {
+    /* Reset by the end of the session, nothing to wait for if it has not started */
+    if (isSessionOpen) {
+        isSessionBroken = true;
+        closedLogBytes += blackboxSdStatus.sessionBytes;
+        taskENTER_CRITICAL();
+        blackboxSdStatus.files++;
+        blackboxSdStatus.fileNumber++;
+        blackboxSdStatus.preallocatedBytes = 0;
+        taskEXIT_CRITICAL();
+    }
+    taskENTER_CRITICAL();
+    blackboxSdStatus.sessionBytes = 0;
+    taskEXIT_CRITICAL();
+
+    LOG1("Blackbox SD: session file %lu failed", blackboxSdStatus.fileNumber);
+
+    if (NULL != sessionFile) {
+        (void) f_close(sessionFile);
+        sessionFile = NULL;
+    }
+    isSessionOpen = false;
+
+    if (!SdCardIsReady()) {
+        UnmountBlackboxSd();
+    } else {
+        /* E.g. a full volume, retried after the mount retry period */
+        SetBlackboxSdState(BLACKBOX_SD_NO_VOLUME);
+        vTaskDelay(BLACKBOX_SD_MOUNT_RETRY_PERIOD / portTICK_RATE_MS);
+    }
+}
+
+/*
+ * @brief  Deletes all session files, also the preallocated one, the numbering starts again from 1
+ * @param  None
+ * @retval None
+ */
+static void EraseBlackboxSdFiles(void) {
+    F_FIND find;
+
+    SetBlackboxSdState(BLACKBOX_SD_ERASING);
+
+    if (NULL != sessionFile) {
+        (void) f_close(sessionFile);
+        sessionFile = NULL;
+    }
+
+    /* The search starts over after each delete */
+    while (F_NO_ERROR == f_findfirst(BLACKBOX_SD_FILE_PATTERN, &find)) {
+        if (F_NO_ERROR != f_delete(find.filename)) {
+            break;
+        }
+    }
+
+    closedLogBytes = 0;
+    taskENTER_CRITICAL();
+    blackboxSdStatus.files = 0;
+    blackboxSdStatus.fileNumber = 1;
+    blackboxSdStatus.logBytes = 0;
+    blackboxSdStatus.sessionBytes = 0;
+    blackboxSdStatus.preallocatedBytes = 0;
+    taskEXIT_CRITICAL();
+
+    if (FCB_OK != SdCardFlush()) {
+        UnmountBlackboxSd();
+    } else {
+        UpdateBlackboxSdFreeSpace();
+    }
+    isErasePending = false;
+}
+
+/*
+ * @brief  Drops the handed over blocks while there is no volume, the session they are of is gone
+ * @param  None
+ * @retval None
+ */
+static void DropBlackboxSdBlocks(void) {
+    uint8_t index;
+
+    while (pdTRUE == xQueueReceive(fullBlockQueue, &index, 0)) {
+        droppedBytes += blackboxSdBlocks[index].length;
+        if (blackboxSdBlocks[index].isSessionEnd) {
+            isSessionBroken = false;
+        }
+        (void) xQueueSend(freeBlockQueue, &index, 0);
+    }
+
+    isErasePending = false;
+}
+
+static void UpdateBlackboxSdFreeSpace(void) {
+    F_SPACE space;
+
+    if (F_NO_ERROR == f_getfreespace(&space)) {
+        taskENTER_CRITICAL();
+        blackboxSdStatus.freeKBytes = (space.free_high << 22) | (space.free >> 10);
+        taskEXIT_CRITICAL();
+    }
+}
+
+static void SetBlackboxSdState(const BlackboxSdStateType state) {
+    taskENTER_CRITICAL();
+    blackboxSdStatus.state = state;
+    taskEXIT_CRITICAL();
+}
+
+static void FormatBlackboxSdFileName(char* dst, const uint16_t fileNumber) {
+    snprintf(dst, BLACKBOX_SD_FILE_NAME_SIZE + 1, "BB%04u.BBL", fileNumber);
+}
+
+#endif /* FCB_SD_CARD */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
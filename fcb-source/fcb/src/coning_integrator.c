@@ -0,0 +1,218 @@
+/******************************************************************************
+ * @brief   Coning compensated gyroscope integration, see coning_integrator.h.
+ *          Each gyroscope sample gives the angle increment d = w*dt. The
+ *          increments are summed into alpha and the coning correction into
+ *          beta with the recursive two-sample form
+ *
+ *              beta  += 1/2 * (alpha + d_prev/6) x d
+ *              alpha += d
+ *
+ *          which, for two samples, is the classic alpha + 2/3 * d1 x d2. The
+ *          rotation vector over the summed samples is alpha + beta. The
+ *          correction is zero while the rotation axis is fixed, so motion
+ *          about a single axis integrates as the plain sum.
+ *****************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "coning_integrator.h"
+
+#include "rotation_transformation.h"
+#include "common.h"
+#include "fast_math.h"
+
+#include <math.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+
+/* Below this rotation angle the quaternion of a rotation vector is taken from its Taylor series [rad] */
+#define CONING_SERIES_MAX_ANGLE     0.1f
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+static RAMFUNC void EulerToQuaternion(float32_t* dstQuaternion, const float32_t* angles);
+static RAMFUNC void QuaternionToEuler(float32_t* dstAngles, const float32_t* quaternion);
+static RAMFUNC void QuaternionMultiply(float32_t* dstQuaternion, const float32_t* a, const float32_t* b);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Clears the rotation and the latest increment, e.g. when the estimator is initialized
+ * @param  integrator : Integrator
+ * @retval None
+ */
+void ConingIntegratorReset(ConingIntegratorType* integrator) {
+    memset(integrator, 0, sizeof(ConingIntegratorType));
+}
+
+/*
+ * @brief  Adds a gyroscope sample and its coning correction to the rotation
+ * @param  integrator : Integrator
+ * @param  bodyAngularRates : Body frame angular rates, without the bias [rad/s]
+ * @param  dt : Time since the previous gyroscope sample [s]
+ * @retval None
+ */
+RAMFUNC void ConingIntegratorUpdate(ConingIntegratorType* integrator, const float32_t* bodyAngularRates,
+        const float32_t dt) {
+    float32_t delta[3], lever[3], coning[3];
+    uint8_t i;
+
+    for (i = 0; i < 3; i++) {
+        delta[i] = bodyAngularRates[i]*dt;
+        lever[i] = integrator->alpha[i] + integrator->lastDelta[i]*(1.0f/6.0f);
+    }
+
+    Vector3DCrossProduct(coning, lever, delta);
+
+    for (i = 0; i < 3; i++) {
+        integrator->beta[i] += 0.5f*coning[i];
+        integrator->alpha[i] += delta[i];
+        integrator->lastDelta[i] = delta[i];
+    }
+
+    integrator->dt += dt;
+    integrator->samples++;
+}
+
+/*
+ * @brief  Takes the rotation of the samples since the previous take and starts a new one. The latest increment is
+ *         kept, the first coning correction of the next rotation uses it.
+ * @param  integrator : Integrator
+ * @param  dstRotation : Destination rotation vector, body frame [rad]
+ * @param  dstDt : Destination time of the samples [s]
+ * @retval Number of samples, 0 if there were none and the rotation is zero
+ */
+RAMFUNC uint32_t ConingIntegratorTake(ConingIntegratorType* integrator, float32_t* dstRotation, float32_t* dstDt) {
+    uint32_t const samples = integrator->samples;
+    uint8_t i;
+
+    for (i = 0; i < 3; i++) {
+        dstRotation[i] = integrator->alpha[i] + integrator->beta[i];
+        integrator->alpha[i] = 0.0f;
+        integrator->beta[i] = 0.0f;
+    }
+    *dstDt = integrator->dt;
+
+    integrator->dt = 0.0f;
+    integrator->samples = 0;
+
+    return samples;
+}
+
+/*
+ * @brief  Calculates the unit quaternion of a rotation vector
+ * @param  dstQuaternion : Destination quaternion (q0, q1, q2, q3), q0 the scalar part
+ * @param  rotation : Rotation vector, the axis times the angle [rad]
+ * @retval None
+ */
+RAMFUNC void RotationVectorToQuaternion(float32_t* dstQuaternion, const float32_t* rotation) {
+    float32_t angleSquared, angle, scale;
+
+    arm_dot_prod_f32((float32_t*) rotation, (float32_t*) rotation, 3, &angleSquared);
+
+    if (angleSquared < CONING_SERIES_MAX_ANGLE*CONING_SERIES_MAX_ANGLE) {
+        /* cos(a/2) and sin(a/2)/a to the fourth order, exact in float below the limit */
+        dstQuaternion[0] = 1.0f - angleSquared*(1.0f/8.0f) + angleSquared*angleSquared*(1.0f/384.0f);
+        scale = 0.5f - angleSquared*(1.0f/48.0f) + angleSquared*angleSquared*(1.0f/3840.0f);
+    } else {
+        angle = FastSqrtf(angleSquared);
+        dstQuaternion[0] = arm_cos_f32(0.5f*angle);
+        scale = arm_sin_f32(0.5f*angle) / angle;
+    }
+
+    dstQuaternion[1] = rotation[0]*scale;
+    dstQuaternion[2] = rotation[1]*scale;
+    dstQuaternion[3] = rotation[2]*scale;
+}
+
+/*
+ * @brief  Calculates how much the roll, pitch & yaw angles change when the attitude rotates by a body frame rotation
+ *         vector. The angles are converted before and after the rotation alike, so that the errors of the
+ *         conversions cancel and a zero rotation gives a zero increment.
+ * @param  dstIncrement : Destination roll, pitch & yaw increments, each within +/-pi [rad]
+ * @param  angles : Roll, pitch & yaw angles before the rotation [rad]
+ * @param  rotation : Rotation vector, body frame [rad]
+ * @retval None
+ */
+RAMFUNC void GetEulerAngleIncrement(float32_t* dstIncrement, const float32_t* angles, const float32_t* rotation) {
+    float32_t attitude[4], delta[4], rotated[4];
+    float32_t before[3], after[3];
+    uint8_t i;
+
+    EulerToQuaternion(attitude, angles);
+    RotationVectorToQuaternion(delta, rotation);
+
+    /* The rotation is in the body frame, so it is applied on the right */
+    QuaternionMultiply(rotated, attitude, delta);
+
+    QuaternionToEuler(before, attitude);
+    QuaternionToEuler(after, rotated);
+
+    for (i = 0; i < 3; i++) {
+        dstIncrement[i] = after[i] - before[i];
+        toMaxRadian(&dstIncrement[i]);
+    }
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Calculates the attitude quaternion of Z-Y-X (yaw-pitch-roll) Euler angles, rotating FROM the body frame TO
+ *         the inertial (NED) frame as in attitude_quaternion.c
+ * @param  dstQuaternion : Destination quaternion
+ * @param  angles : Roll, pitch & yaw angles [rad]
+ * @retval None
+ */
+static RAMFUNC void EulerToQuaternion(float32_t* dstQuaternion, const float32_t* angles) {
+    float32_t cosRoll = arm_cos_f32(angles[0]*0.5f);
+    float32_t sinRoll = arm_sin_f32(angles[0]*0.5f);
+    float32_t cosPitch = arm_cos_f32(angles[1]*0.5f);
+    float32_t sinPitch = arm_sin_f32(angles[1]*0.5f);
+    float32_t cosYaw = arm_cos_f32(angles[2]*0.5f);
+    float32_t sinYaw = arm_sin_f32(angles[2]*0.5f);
+
+    dstQuaternion[0] = cosRoll*cosPitch*cosYaw + sinRoll*sinPitch*sinYaw;
+    dstQuaternion[1] = sinRoll*cosPitch*cosYaw - cosRoll*sinPitch*sinYaw;
+    dstQuaternion[2] = cosRoll*sinPitch*cosYaw + sinRoll*cosPitch*sinYaw;
+    dstQuaternion[3] = cosRoll*cosPitch*sinYaw - sinRoll*sinPitch*cosYaw;
+}
+
+/*
+ * @brief  Calculates the Z-Y-X Euler angles of an attitude quaternion
+ * @param  dstAngles : Destination roll, pitch & yaw angles [rad]
+ * @param  quaternion : Unit attitude quaternion
+ * @retval None
+ */
+static RAMFUNC void QuaternionToEuler(float32_t* dstAngles, const float32_t* quaternion) {
+    float32_t const q0 = quaternion[0], q1 = quaternion[1], q2 = quaternion[2], q3 = quaternion[3];
+    float32_t sinPitch = 2.0f*(q0*q2 - q1*q3);
+
+    dstAngles[0] = FastAtan2f(2.0f*(q0*q1 + q2*q3), q0*q0 - q1*q1 - q2*q2 + q3*q3);
+    dstAngles[1] = FastAsinf(fmaxf(-1.0f, fminf(sinPitch, 1.0f)));
+    dstAngles[2] = FastAtan2f(2.0f*(q0*q3 + q1*q2), 1.0f - 2.0f*(q2*q2 + q3*q3));
+}
+
+/*
+ * @brief  Multiplies two quaternions, a*b
+ * @param  dstQuaternion : Destination quaternion, not a or b
+ * @param  a : Left quaternion
+ * @param  b : Right quaternion
+ * @retval None
+ */
+static RAMFUNC void QuaternionMultiply(float32_t* dstQuaternion, const float32_t* a, const float32_t* b) {
+    dstQuaternion[0] = a[0]*b[0] - a[1]*b[1] - a[2]*b[2] - a[3]*b[3];
+    dstQuaternion[1] = a[0]*b[1] + a[1]*b[0] + a[2]*b[3] - a[3]*b[2];
+    dstQuaternion[2] = a[0]*b[2] - a[1]*b[3] + a[2]*b[0] + a[3]*b[1];
+    dstQuaternion[3] = a[0]*b[3] + a[1]*b[2] - a[2]*b[1] + a[3]*b[0];
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
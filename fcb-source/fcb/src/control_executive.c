@@ -0,0 +1,336 @@
+/******************************************************************************
+ * @file    control_executive.c
+ * @author  Dragonfly
+ * @brief   Control executive. The gyroscope DMA complete interrupt hands the
+ *          raw sample over and pends the executive interrupt, which converts,
+ *          compensates and filters the sample, updates the rate controllers
+ *          and loads the motor outputs. It runs above the RTOS interrupts and
+ *          uses no FreeRTOS API, so the time from the data ready to the motor
+ *          output does not depend on the task load or the kernel critical
+ *          sections. The flight control task reads the processed sample for
+ *          the estimation and sets the references, thrust and bias estimates
+ *          through a double buffered setpoint. The executive never waits for
+ *          the task, it runs with the newest setpoint it has.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "control_executive.h"
+
+#ifdef FCB_CONTROL_EXECUTIVE
+
+#include "fcb_gyroscope.h"
+#include "flight_control.h"
+#include "pid_control.h"
+#include "motor_control.h"
+#include "state_estimation.h"
+#include "common.h"
+#include "seqlock.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef PID_USE_CASCADED_RATE_CONTROL
+#error "FCB_CONTROL_EXECUTIVE runs the inner loop of the cascaded control, it needs PID_USE_CASCADED_RATE_CONTROL"
+#endif
+#ifdef FCB_GYRO_FIFO_MODE
+#error "FCB_CONTROL_EXECUTIVE is triggered by the gyroscope DMA read of each sample, FCB_GYRO_FIFO_MODE reads batches"
+#endif
+#ifdef FCB_GYRO_SYNCHRONOUS_PIPELINE
+#error "FCB_CONTROL_EXECUTIVE and FCB_GYRO_SYNCHRONOUS_PIPELINE both run the rate loop on the gyroscope samples"
+#endif
+#ifdef FLIGHT_CONTROL_RC_INTERPOLATION
+#error "FLIGHT_CONTROL_RC_INTERPOLATION ramps the references in the rate loop, which FCB_CONTROL_EXECUTIVE moves out of the task"
+#endif
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+	float32_t angleDot[3];
+	float32_t moments[3];
+	ControlExecutiveStats_TypeDef stats;
+} ControlExecutiveOutputs_TypeDef;
+/* Private define ------------------------------------------------------------*/
+#define CYCLES_PER_US                   (SystemCoreClock / 1000000)
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+
+/* Raw sample of the latest trigger, written by the gyroscope DMA complete interrupt */
+static int16_t triggerRawData[3];
+static uint32_t triggerDrdyTimestamp; // [core clock cycles]
+static volatile uint32_t triggerOverruns = 0;
+
+/* The flight control task writes the unpublished setpoint and then publishes it. The executive preempts the task, so
+ * the setpoint it reads is never written meanwhile. */
+static ControlExecutiveSetpoint_TypeDef setpoints[2];
+static volatile uint8_t publishedSetpointIdx = 0;
+
+/* Written by the executive only, in two copies that the sequence lock publishes in turn */
+static SeqLock_TypeDef seqLockOutputs; /* guards outputs */
+static ControlExecutiveOutputs_TypeDef outputs[2];
+static uint16_t rateLoopCounter = 0;
+
+static volatile bool statsResetPending = false;
+static uint8_t suspendCount = 0; /* under taskENTER_CRITICAL() */
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Configures the executive interrupt, which the gyroscope DMA complete interrupt pends for each sample
+ * @param  None
+ * @retval None
+ */
+void ControlExecutiveConfig(void) {
+	memset(setpoints, 0, sizeof(setpoints));
+	memset(outputs, 0, sizeof(outputs));
+
+	HAL_NVIC_SetPriority(CONTROL_EXECUTIVE_IRQn, CONTROL_EXECUTIVE_IRQ_PREEMPT_PRIO, CONTROL_EXECUTIVE_IRQ_SUB_PRIO);
+	HAL_NVIC_ClearPendingIRQ(CONTROL_EXECUTIVE_IRQn);
+	HAL_NVIC_EnableIRQ(CONTROL_EXECUTIVE_IRQn);
+}
+
+/*
+ * @brief  Hands a gyroscope sample over to the executive and pends it. Called from the gyroscope DMA complete
+ *         interrupt, which the executive preempts as soon as it returns from here.
+ * @param  rawData : Raw sample, sensor axes
+ * @param  drdyTimestamp : Time of the data ready interrupt of the sample [core clock cycles]
+ * @retval None
+ */
+RAMFUNC void ControlExecutiveTriggerFromISR(const int16_t rawData[3], const uint32_t drdyTimestamp) {
+	/* Only while the executive is suspended, the pending trigger then runs with this sample on the resume */
+	if (NVIC_GetPendingIRQ(CONTROL_EXECUTIVE_IRQn)) {
+		triggerOverruns++;
+	}
+
+	triggerRawData[0] = rawData[0];
+	triggerRawData[1] = rawData[1];
+	triggerRawData[2] = rawData[2];
+	triggerDrdyTimestamp = drdyTimestamp;
+
+	NVIC_SetPendingIRQ(CONTROL_EXECUTIVE_IRQn);
+}
+
+/*
+ * @brief  Runs the executive for the latest gyroscope sample: the sample processing on each one, the rate loop and
+ *         the motor outputs on every PID_RATE_LOOP_GYRO_DIVISOR:th one while the setpoint is enabled
+ * @param  None
+ * @retval None
+ */
+RAMFUNC void ControlExecutiveIRQHandler(void) {
+	uint32_t startTimestamp = GetTimestamp();
+	const ControlExecutiveSetpoint_TypeDef* setpoint = &setpoints[publishedSetpointIdx];
+	CtrlSignals_TypeDef signals;
+	ControlExecutiveOutputs_TypeDef* output;
+	const ControlExecutiveOutputs_TypeDef* published;
+	float32_t gyroscopeData[3];
+	float32_t angleDot[3];
+	float32_t rates[3];
+	float32_t achievedMoments[3];
+	uint32_t latency = 0;
+	uint32_t runTime;
+	bool isRateLoopRun = false;
+	uint8_t i;
+
+	/* returns rad/s */
+	GyroConvertXYZ(triggerRawData, gyroscopeData);
+	ProcessGyroscopeSample(gyroscopeData, angleDot);
+
+	if (!setpoint->isEnabled) {
+		rateLoopCounter = 0;
+	} else if (++rateLoopCounter >= PID_RATE_LOOP_GYRO_DIVISOR) {
+		rateLoopCounter = 0;
+
+		for (i = 0; i < 3; i++) {
+			rates[i] = angleDot[i] - setpoint->rateBiases[i];
+		}
+		signals.thrust = setpoint->thrust;
+		UpdatePIDRateLoop(&signals, rates, setpoint->refRates);
+		MotorAllocationPhysicalFromISR(signals.thrust, signals.rollMoment, signals.pitchMoment, signals.yawMoment,
+				achievedMoments);
+		ApplyPIDAllocationFeedback(&signals, achievedMoments);
+
+		latency = GetTimestamp() - triggerDrdyTimestamp;
+		isRateLoopRun = true;
+	}
+	runTime = GetTimestamp() - startTimestamp;
+
+	/* The unpublished copy starts from the published one, the moments and the statistics carry over. Field by field,
+	 * since a struct copy may call memcpy() from flash. */
+	output = &outputs[SeqLockWriteBegin(&seqLockOutputs)];
+	published = &outputs[SEQLOCK_PUBLISHED(&seqLockOutputs)];
+	for (i = 0; i < 3; i++) {
+		output->angleDot[i] = angleDot[i];
+		output->moments[i] = published->moments[i];
+	}
+	if (statsResetPending) {
+		statsResetPending = false;
+		output->stats.triggers = 0;
+		output->stats.runs = 0;
+		output->stats.maxRunTime = 0;
+		output->stats.maxLatency = 0;
+		output->stats.sumLatency = 0;
+	} else {
+		output->stats.triggers = published->stats.triggers;
+		output->stats.runs = published->stats.runs;
+		output->stats.maxRunTime = published->stats.maxRunTime;
+		output->stats.maxLatency = published->stats.maxLatency;
+		output->stats.sumLatency = published->stats.sumLatency;
+	}
+	output->stats.triggers++;
+	if (runTime > output->stats.maxRunTime) {
+		output->stats.maxRunTime = runTime;
+	}
+	if (isRateLoopRun) {
+		output->moments[ROLL_IDX] = signals.rollMoment;
+		output->moments[PITCH_IDX] = signals.pitchMoment;
+		output->moments[YAW_IDX] = signals.yawMoment;
+		output->stats.runs++;
+		output->stats.sumLatency += latency;
+		if (latency > output->stats.maxLatency) {
+			output->stats.maxLatency = latency;
+		}
+	}
+	SeqLockWriteEnd(&seqLockOutputs);
+}
+
+/*
+ * @brief  Publishes a new setpoint, which the executive uses from its next rate loop update on. Called by the flight
+ *         control task only.
+ * @param  setpoint : Setpoint
+ * @retval None
+ */
+void ControlExecutiveSetSetpoint(const ControlExecutiveSetpoint_TypeDef* setpoint) {
+	uint8_t idx = publishedSetpointIdx ^ 1;
+
+	setpoints[idx] = *setpoint;
+	__DMB();
+	publishedSetpointIdx = idx;
+}
+
+/*
+ * @brief  Gets the latest processed gyroscope sample, i.e. remapped to the body axes, temperature compensated and
+ *         filtered. Called by the SENSORS task on the gyroscope DMA complete message, after the executive has run.
+ * @param  dstAngleDot : Destination angular rates [rad/s]
+ * @retval None
+ */
+void ControlExecutiveGetGyroSample(float32_t dstAngleDot[3]) {
+	uint32_t sequence;
+
+	do {
+		sequence = SeqLockReadBegin(&seqLockOutputs);
+		dstAngleDot[0] = outputs[SEQLOCK_COPY(sequence)].angleDot[0];
+		dstAngleDot[1] = outputs[SEQLOCK_COPY(sequence)].angleDot[1];
+		dstAngleDot[2] = outputs[SEQLOCK_COPY(sequence)].angleDot[2];
+	} while (SeqLockReadRetry(&seqLockOutputs, sequence));
+}
+
+/*
+ * @brief  Gets the moments of the latest rate loop update
+ * @param  dstMoments : Destination roll, pitch & yaw moments [Nm]
+ * @retval None
+ */
+void ControlExecutiveGetCtrlSignals(float32_t dstMoments[3]) {
+	uint32_t sequence;
+
+	do {
+		sequence = SeqLockReadBegin(&seqLockOutputs);
+		dstMoments[ROLL_IDX] = outputs[SEQLOCK_COPY(sequence)].moments[ROLL_IDX];
+		dstMoments[PITCH_IDX] = outputs[SEQLOCK_COPY(sequence)].moments[PITCH_IDX];
+		dstMoments[YAW_IDX] = outputs[SEQLOCK_COPY(sequence)].moments[YAW_IDX];
+	} while (SeqLockReadRetry(&seqLockOutputs, sequence));
+}
+
+/*
+ * @brief  Holds the executive off, so that a task may update the state it uses, e.g. the controller or the sensor
+ *         filter states. A trigger meanwhile runs on ControlExecutiveResume(). Nests, called from tasks only.
+ * @param  None
+ * @retval None
+ */
+void ControlExecutiveSuspend(void) {
+	taskENTER_CRITICAL();
+	if (0 == suspendCount++) {
+		NVIC_DisableIRQ(CONTROL_EXECUTIVE_IRQn);
+		/* The executive may not start after this returns */
+		__DSB();
+		__ISB();
+	}
+	taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Lets the executive run again after ControlExecutiveSuspend()
+ * @param  None
+ * @retval None
+ */
+void ControlExecutiveResume(void) {
+	taskENTER_CRITICAL();
+	if (suspendCount > 0 && 0 == --suspendCount) {
+		NVIC_EnableIRQ(CONTROL_EXECUTIVE_IRQn);
+	}
+	taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Gets a consistent copy of the executive statistics
+ * @param  dstStats : Destination statistics
+ * @retval None
+ */
+void ControlExecutiveGetStats(ControlExecutiveStats_TypeDef* dstStats) {
+	uint32_t sequence;
+
+	do {
+		sequence = SeqLockReadBegin(&seqLockOutputs);
+		*dstStats = outputs[SEQLOCK_COPY(sequence)].stats;
+	} while (SeqLockReadRetry(&seqLockOutputs, sequence));
+	dstStats->overruns = triggerOverruns;
+}
+
+/*
+ * @brief  Clears the executive statistics, the executive does it on its next trigger
+ * @param  None
+ * @retval None
+ */
+void ControlExecutiveResetStats(void) {
+	taskENTER_CRITICAL();
+	triggerOverruns = 0;
+	taskEXIT_CRITICAL();
+	statsResetPending = true;
+}
+
+/*
+ * @brief  Prints the executive statistics
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @retval Length of the string
+ */
+size_t ControlExecutivePrint(char* dst, const size_t dstSize) {
+	ControlExecutiveStats_TypeDef stats;
+	uint32_t meanLatency = 0;
+
+	ControlExecutiveGetStats(&stats);
+	if (stats.runs > 0) {
+		meanLatency = (uint32_t) (stats.sumLatency / stats.runs);
+	}
+
+	return (size_t) snprintf(dst, dstSize,
+			"Control executive\nTriggers: %lu\nOverruns: %lu\nRate loop runs: %lu\nMax run time: %lu us\n"
+			"Data ready to motor output, mean: %lu us, max: %lu us\n",
+			(unsigned long) stats.triggers, (unsigned long) stats.overruns, (unsigned long) stats.runs,
+			(unsigned long) (stats.maxRunTime / CYCLES_PER_US), (unsigned long) (meanLatency / CYCLES_PER_US),
+			(unsigned long) (stats.maxLatency / CYCLES_PER_US));
+}
+
+#endif /* FCB_CONTROL_EXECUTIVE */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,312 @@
+/******************************************************************************
+ * @file    crash_detection.c
+ * @brief   Crash and tumble detection of the flying states, see
+ *          crash_detection.h
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "crash_detection.h"
+
+#include "flight_control.h"
+#include "flight_mode.h"
+#include "pid_control.h"
+#include "state_estimation.h"
+#include "fcb_accelerometer_magnetometer.h"
+#include "flash.h"
+#include "fixed_format.h"
+#include "deferred_log.h"
+#include "fcb_port.h"
+
+#include <math.h>
+#include <stdio.h>
+
+/* Private define ------------------------------------------------------------*/
+
+/* Moment controllers of the roll and pitch axes, whose saturation is watched */
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+#define CRASH_ROLL_MOMENT_IDX           PID_ROLL_RATE_IDX
+#define CRASH_PITCH_MOMENT_IDX          PID_PITCH_RATE_IDX
+#else
+#define CRASH_ROLL_MOMENT_IDX           PID_ROLL_ANGLE_IDX
+#define CRASH_PITCH_MOMENT_IDX          PID_PITCH_ANGLE_IDX
+#endif
+
+/* Private variables ---------------------------------------------------------*/
+
+static const char* const crashCauseNames[CRASH_DETECTION_CAUSE_NBR] = {
+    "none", "tumble", "inverted", "impact"
+};
+
+/* Set by the CLI with the scheduler suspended, read by the flight control task */
+static CrashDetectionSettingsType crashSettings = {
+    CRASH_DEFAULT_IMPACT_ACCELERATION, CRASH_DEFAULT_IMPACT_TIME, CRASH_DEFAULT_TUMBLE_TIME,
+    CRASH_DEFAULT_INVERTED_TIME
+};
+
+/* Written by the flight control task, read by the other tasks with the scheduler suspended */
+static CrashDetectionStatusType crashStatus;
+
+/* Used by the flight control task only */
+static float32_t impactAge = CRASH_IMPACT_WINDOW;   // [s] since the latest impact
+static float32_t tumbleDuration = 0.0f;             // [s]
+static float32_t invertedDuration = 0.0f;           // [s]
+
+/* Private function prototypes -----------------------------------------------*/
+static bool IsAxisTumbling(const enum FlightControlMode mode, const PIDControllerIndex_TypeDef momentIdx,
+        const PIDControllerIndex_TypeDef angleIdx);
+static bool IsValidCrashDetectionSettings(const CrashDetectionSettingsType* settings);
+static bool IsValidCrashTime(const float32_t time);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Loads the stored settings, or keeps the defaults if there are none or they are not valid
+ * @param  None.
+ * @retval None.
+ */
+void InitCrashDetection(void) {
+    CrashDetectionSettingsType settings;
+
+    if (FLASH_OK == ReadCrashDetectionSettingsFromFlash(&settings) && IsValidCrashDetectionSettings(&settings)) {
+        crashSettings = settings;
+    }
+}
+
+/*
+ * @brief  Evaluates the crash conditions of the latest control cycle and latches a crash once one has lasted for its
+ *         time. The latch is released in the disarmed state.
+ * @param  throttle : Throttle stick in [0, 1]
+ * @retval true on the control cycle a crash is detected, else false
+ */
+bool UpdateCrashDetection(const float32_t throttle) {
+    const enum FlightControlMode mode = GetFlightControlMode();
+    const float32_t dt = GetFlightControlSamplePeriod();
+    CrashDetectionSettingsType settings;
+    CrashDetectionCauseType cause = CRASH_DETECTION_CAUSE_NONE;
+    float32_t acc[3];
+    uint8_t flags = 0;
+
+    FCB_SUSPEND_SCHEDULER();
+    settings = crashSettings;
+    FCB_RESUME_SCHEDULER();
+
+    if (crashStatus.isCrashed && FLIGHT_MODE_DISARMED == GetFlightModeState()) {
+        crashStatus.isCrashed = false;
+    }
+
+    /* The conditions are watched in the flying states only, with a fresh start on every one */
+    if (FLIGHT_CONTROL_IDLE == mode || crashStatus.isCrashed) {
+        impactAge = CRASH_IMPACT_WINDOW;
+        tumbleDuration = 0.0f;
+        invertedDuration = 0.0f;
+        crashStatus.flags = crashStatus.isCrashed ? CRASH_FLAG_DETECTED : 0;
+        return false;
+    }
+
+    GetAcceleration(&acc[0], &acc[1], &acc[2]);
+    if (acc[0]*acc[0] + acc[1]*acc[1] + acc[2]*acc[2]
+            > settings.impactAcceleration*settings.impactAcceleration*G_ACC*G_ACC) {
+        impactAge = 0.0f;
+    } else if (impactAge < CRASH_IMPACT_WINDOW) {
+        impactAge += dt;
+    }
+    if (impactAge < CRASH_IMPACT_WINDOW) {
+        flags |= CRASH_FLAG_IMPACT;
+    }
+
+    if (IsAxisTumbling(mode, CRASH_ROLL_MOMENT_IDX, PID_ROLL_ANGLE_IDX)
+            || IsAxisTumbling(mode, CRASH_PITCH_MOMENT_IDX, PID_PITCH_ANGLE_IDX)) {
+        tumbleDuration += dt;
+        flags |= CRASH_FLAG_TUMBLE;
+    } else {
+        tumbleDuration = 0.0f;
+    }
+
+    /* The body z axis points up */
+    if (cosf(GetRollAngle())*cosf(GetPitchAngle()) < 0.0f && throttle < CRASH_INVERTED_MAX_THROTTLE) {
+        invertedDuration += dt;
+        flags |= CRASH_FLAG_INVERTED;
+    } else {
+        invertedDuration = 0.0f;
+    }
+
+    if ((flags & CRASH_FLAG_IMPACT) && settings.impactTime > 0.0f
+            && (tumbleDuration >= settings.impactTime || invertedDuration >= settings.impactTime)) {
+        cause = CRASH_DETECTION_CAUSE_IMPACT;
+    } else if (settings.tumbleTime > 0.0f && tumbleDuration >= settings.tumbleTime) {
+        cause = CRASH_DETECTION_CAUSE_TUMBLE;
+    } else if (settings.invertedTime > 0.0f && invertedDuration >= settings.invertedTime) {
+        cause = CRASH_DETECTION_CAUSE_INVERTED;
+    }
+
+    if (CRASH_DETECTION_CAUSE_NONE == cause) {
+        crashStatus.flags = flags;
+        return false;
+    }
+
+    FCB_SUSPEND_SCHEDULER();
+    crashStatus.isCrashed = true;
+    crashStatus.cause = cause;
+    crashStatus.flags = flags | CRASH_FLAG_DETECTED;
+    crashStatus.crashes++;
+    crashStatus.timestamp = (uint32_t) xTaskGetTickCount() * portTICK_RATE_MS;
+    FCB_RESUME_SCHEDULER();
+    LOG1("CRASH: %s detected, motors cut until disarmed", crashCauseNames[cause]);
+
+    return true;
+}
+
+/*
+ * @brief  Checks if a crash is latched
+ * @param  None.
+ * @retval true from a detected crash until disarmed, else false
+ */
+bool IsCrashDetected(void) {
+    return crashStatus.isCrashed;
+}
+
+/*
+ * @brief  Sets the settings, effective from the next control cycle
+ * @param  settings : Impact acceleration and condition times, see CrashDetectionSettingsType
+ * @retval FCB_OK if set, FCB_ERR if an acceleration or a time is out of range
+ */
+FcbRetValType SetCrashDetectionSettings(const CrashDetectionSettingsType* settings) {
+    if (!IsValidCrashDetectionSettings(settings)) {
+        return FCB_ERR;
+    }
+
+    FCB_SUSPEND_SCHEDULER();
+    crashSettings = *settings;
+    FCB_RESUME_SCHEDULER();
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Gets the settings
+ * @param  settings : Destination of the settings
+ * @retval None.
+ */
+void GetCrashDetectionSettings(CrashDetectionSettingsType* settings) {
+    FCB_SUSPEND_SCHEDULER();
+    *settings = crashSettings;
+    FCB_RESUME_SCHEDULER();
+}
+
+/*
+ * @brief  Saves the settings to flash
+ * @param  None.
+ * @retval FCB_OK if saved, FCB_ERR if not in idle mode or if writing the flash failed
+ */
+FcbRetValType SaveCrashDetectionSettings(void) {
+    CrashDetectionSettingsType settings;
+
+    /* Only saved while disarmed, so that the snapshot holds the thresholds in use and not a set edited in flight */
+    if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        return FCB_ERR;
+    }
+
+    GetCrashDetectionSettings(&settings);
+    if (FLASH_OK != WriteCrashDetectionSettingsToFlash(&settings)) {
+        return FCB_ERR;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Gets the status of the detection
+ * @param  dstStatus : Destination of the status
+ * @retval None.
+ */
+void GetCrashDetectionStatus(CrashDetectionStatusType* dstStatus) {
+    FCB_SUSPEND_SCHEDULER();
+    *dstStatus = crashStatus;
+    FCB_RESUME_SCHEDULER();
+}
+
+/*
+ * @brief  Gets the name of a crash cause
+ * @param  cause : Crash cause
+ * @retval The name
+ */
+const char* GetCrashDetectionCauseName(const CrashDetectionCauseType cause) {
+    return (cause < CRASH_DETECTION_CAUSE_NBR) ? crashCauseNames[cause] : "unknown";
+}
+
+size_t PrintCrashDetection(char* dst, const size_t dstSize) {
+    CrashDetectionSettingsType settings;
+    CrashDetectionStatusType status;
+    float32_t values[4];
+    size_t length;
+
+    GetCrashDetectionSettings(&settings);
+    GetCrashDetectionStatus(&status);
+
+    values[0] = settings.impactAcceleration;
+    values[1] = settings.impactTime;
+    values[2] = settings.tumbleTime;
+    values[3] = settings.invertedTime;
+    length = FormatFixedList(dst, dstSize,
+            "Crash detection: impact %1.2f g, impact time %1.2f s, tumble time %1.2f s, inverted time %1.2f s\r\n",
+            values, 4);
+    if (length < dstSize) {
+        length += (size_t) snprintf(dst + length, dstSize - length, "%s, %lu crashes, latest %s at %lu ms\r\n",
+                status.isCrashed ? "CRASHED, disarm to re-arm" : "not crashed", status.crashes,
+                GetCrashDetectionCauseName(status.cause), status.timestamp);
+    }
+
+    return (length < dstSize) ? length : dstSize - 1;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Checks if the moment controller of an axis is saturated while the error of its axis stays large, the
+ *         attitude error in the flight modes with an attitude reference and the rate error in the rate mode
+ * @param  mode : Flight control mode
+ * @param  momentIdx : Moment controller of the axis
+ * @param  angleIdx : Angle controller of the axis
+ * @retval true if tumbling, else false
+ */
+static bool IsAxisTumbling(const enum FlightControlMode mode, const PIDControllerIndex_TypeDef momentIdx,
+        const PIDControllerIndex_TypeDef angleIdx) {
+    if (FLIGHT_CONTROL_RAW == mode || !IsPIDOutputSaturated(momentIdx)) {
+        return false;
+    }
+
+    if (FLIGHT_CONTROL_RATE == mode) {
+        return fabsf(GetPIDControlError(momentIdx)) > CRASH_TUMBLE_RATE_ERROR;
+    }
+
+    return fabsf(GetPIDControlError(angleIdx)) > CRASH_TUMBLE_ATTITUDE_ERROR;
+}
+
+/*
+ * @brief  Checks the settings against the limits of crash_detection.h
+ * @param  settings : Settings
+ * @retval true if valid, else false
+ */
+static bool IsValidCrashDetectionSettings(const CrashDetectionSettingsType* settings) {
+    return settings->impactAcceleration > 1.0f && settings->impactAcceleration <= CRASH_MAX_IMPACT_ACCELERATION
+            && IsValidCrashTime(settings->impactTime) && IsValidCrashTime(settings->tumbleTime)
+            && IsValidCrashTime(settings->invertedTime);
+}
+
+/*
+ * @brief  Checks a condition time
+ * @param  time : Condition time [s]
+ * @retval true if in [0, CRASH_MAX_TIME], else false
+ */
+static bool IsValidCrashTime(const float32_t time) {
+    return time >= 0.0f && time <= CRASH_MAX_TIME;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
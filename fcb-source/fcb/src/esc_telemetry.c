@@ -0,0 +1,461 @@
+/******************************************************************************
+ * @file    esc_telemetry.c
+ * @brief   Round-robin polling of the ESC telemetry and the motor health, see
+ *          esc_telemetry.h
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "esc_telemetry.h"
+
+#ifdef MOTOR_ESC_TELEMETRY
+
+#include "common.h"
+#include "fixed_format.h"
+#include "deferred_log.h"
+#include "fcb_port.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+#include <stdio.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* State of the desync detection of a motor, used by the flight control task only */
+typedef struct {
+    uint32_t answers;           // Of the latest decoded answer
+    uint32_t answerTimestamp;   // Of the latest decoded answer [ms]
+    uint32_t spinUpEnd;         // [ms]
+    uint32_t previousERpm;
+    uint16_t previousCommand;
+    uint8_t desyncAnswers;      // Suspect answers in a row
+} EscMotorState_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+
+#define ESC_TELEMETRY_CRC8_POLY         0x07
+
+#define ESC_TELEMETRY_ERROR_FLAGS       (UART_FLAG_PE | UART_FLAG_FE | UART_FLAG_NE | UART_FLAG_ORE)
+#define ESC_TELEMETRY_ERROR_CLEAR       (UART_CLEAR_PEF | UART_CLEAR_FEF | UART_CLEAR_NEF | UART_CLEAR_OREF)
+
+/* Private variables ---------------------------------------------------------*/
+
+UART_HandleTypeDef EscTelemetryUartHandle;
+
+/* Written by the context that loads the motor outputs. The polled motor is the request sequence modulo the motors, so
+ * one variable tells the UART interrupt both that a new answer starts and whose it is. */
+static volatile uint32_t escRequestSequence = 0;
+static volatile bool isEscTelemetryStarted = false;
+static uint32_t escRequestTimestamp;   // [core clock cycles]
+static uint32_t escPollCycles;         // ESC_TELEMETRY_POLL_PERIOD [core clock cycles]
+static uint32_t escMisses[MOTOR_OUTPUT_CHANNELS];
+
+/* Written by the UART interrupt, read by the flight control task in critical sections */
+static volatile uint32_t escAnsweredSequence = 0;
+static uint8_t escFrames[MOTOR_OUTPUT_CHANNELS][ESC_TELEMETRY_FRAME_SIZE];
+static uint32_t escAnswers[MOTOR_OUTPUT_CHANNELS];
+static uint32_t escFrameErrors[MOTOR_OUTPUT_CHANNELS];
+
+/* Answer being received, used by the UART interrupt only */
+static uint8_t escRxFrame[ESC_TELEMETRY_FRAME_SIZE];
+static uint8_t escRxIndex = ESC_TELEMETRY_FRAME_SIZE;
+static uint32_t escRxSequence = 0;
+
+/* Written by the flight control task, read by the other tasks with the scheduler suspended */
+static EscTelemetryType escTelemetry[MOTOR_OUTPUT_CHANNELS];
+
+static EscMotorState_TypeDef escMotorStates[MOTOR_OUTPUT_CHANNELS];
+
+static const char* const escHealthNames[ESC_HEALTH_NBR] = { "no telemetry", "ok", "hot", "over-temperature",
+        "desync" };
+
+/* Private function prototypes -----------------------------------------------*/
+static uint8_t CalculateEscCrc8(const uint8_t* data, const uint8_t length);
+static void DecodeEscFrame(const uint8_t frame[ESC_TELEMETRY_FRAME_SIZE], EscTelemetryType* esc);
+static EscHealthType EvaluateEscHealth(EscMotorState_TypeDef* state, const EscTelemetryType* esc,
+        const uint16_t command, const uint32_t timestamp);
+static uint32_t GetTimestampMs(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Configures the UART for reception only and enables its receive interrupt, the polling starts with the next
+ *         DShot frame
+ * @param  None.
+ * @retval FCB_OK if configured, FCB_ERR_INIT if the UART could not be configured
+ */
+FcbRetValType EscTelemetryConfig(void) {
+    memset(escTelemetry, 0, sizeof(escTelemetry));
+    memset(escMotorStates, 0, sizeof(escMotorStates));
+
+    EscTelemetryUartHandle.Instance = ESC_TELEMETRY_UART;
+    EscTelemetryUartHandle.Init.BaudRate = ESC_TELEMETRY_BAUDRATE;
+    EscTelemetryUartHandle.Init.WordLength = UART_WORDLENGTH_8B;
+    EscTelemetryUartHandle.Init.StopBits = UART_STOPBITS_1;
+    EscTelemetryUartHandle.Init.Parity = UART_PARITY_NONE;
+    EscTelemetryUartHandle.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+    EscTelemetryUartHandle.Init.Mode = UART_MODE_RX;
+
+    /* An overrun must not stop the reception, the answer it corrupted fails its CRC */
+    EscTelemetryUartHandle.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_RXOVERRUNDISABLE_INIT;
+    EscTelemetryUartHandle.AdvancedInit.OverrunDisable = UART_ADVFEATURE_OVERRUN_DISABLE;
+
+    if (HAL_OK != HAL_UART_Init(&EscTelemetryUartHandle)) {
+        return FCB_ERR_INIT;
+    }
+
+    __HAL_UART_CLEAR_IT(&EscTelemetryUartHandle, ESC_TELEMETRY_ERROR_CLEAR);
+    __HAL_UART_ENABLE_IT(&EscTelemetryUartHandle, UART_IT_RXNE);
+
+    escPollCycles = ESC_TELEMETRY_POLL_PERIOD * (SystemCoreClock / 1000000);
+    escRequestTimestamp = GetTimestamp() - escPollCycles;
+    isEscTelemetryStarted = true;
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Polls the next motor once the poll period has passed since the previous request. A request that was not
+ *         answered by then counts as a miss of its motor.
+ * @param  None.
+ * @retval Motor index, ESC_TELEMETRY_NO_REQUEST if no motor is polled with this frame
+ */
+uint8_t EscTelemetryNextRequest(void) {
+    uint32_t const timestamp = GetTimestamp();
+    uint32_t sequence = escRequestSequence;
+
+    if (!isEscTelemetryStarted || timestamp - escRequestTimestamp < escPollCycles) {
+        return ESC_TELEMETRY_NO_REQUEST;
+    }
+
+    if (0 != sequence && escAnsweredSequence != sequence) {
+        escMisses[sequence % MOTOR_OUTPUT_CHANNELS]++;
+    }
+
+    sequence++;
+    escRequestTimestamp = timestamp;
+    escRequestSequence = sequence;
+
+    return (uint8_t) (sequence % MOTOR_OUTPUT_CHANNELS);
+}
+
+/*
+ * @brief  Collects the bytes of an answer. The bytes after a request start a new answer, the bytes beyond a complete
+ *         or broken one are dropped until the next request.
+ * @param  None.
+ * @retval None.
+ */
+void EscTelemetryUartIRQHandler(void) {
+    uint32_t const sequence = escRequestSequence;
+    uint8_t motor;
+    uint8_t data;
+    bool rxError;
+
+    if (!__HAL_UART_GET_FLAG(&EscTelemetryUartHandle, UART_FLAG_RXNE)) {
+        /* A line error without data, the answer in progress is broken */
+        if (EscTelemetryUartHandle.Instance->ISR & ESC_TELEMETRY_ERROR_FLAGS) {
+            __HAL_UART_CLEAR_IT(&EscTelemetryUartHandle, ESC_TELEMETRY_ERROR_CLEAR);
+            if (escRxIndex < ESC_TELEMETRY_FRAME_SIZE) {
+                escFrameErrors[escRxSequence % MOTOR_OUTPUT_CHANNELS]++;
+                escRxIndex = ESC_TELEMETRY_FRAME_SIZE;
+            }
+        }
+        return;
+    }
+
+    rxError = (EscTelemetryUartHandle.Instance->ISR & ESC_TELEMETRY_ERROR_FLAGS) != 0;
+    data = (uint8_t) EscTelemetryUartHandle.Instance->RDR; // Clears RXNE
+    if (rxError) {
+        __HAL_UART_CLEAR_IT(&EscTelemetryUartHandle, ESC_TELEMETRY_ERROR_CLEAR);
+    }
+
+    if (sequence != escRxSequence) {
+        escRxSequence = sequence;
+        escRxIndex = 0;
+    }
+
+    if (escRxIndex >= ESC_TELEMETRY_FRAME_SIZE) {
+        return;
+    }
+
+    motor = (uint8_t) (escRxSequence % MOTOR_OUTPUT_CHANNELS);
+    if (rxError) {
+        escFrameErrors[motor]++;
+        escRxIndex = ESC_TELEMETRY_FRAME_SIZE;
+        return;
+    }
+
+    escRxFrame[escRxIndex++] = data;
+    if (ESC_TELEMETRY_FRAME_SIZE == escRxIndex) {
+        if (CalculateEscCrc8(escRxFrame, ESC_TELEMETRY_FRAME_SIZE - 1) == escRxFrame[ESC_TELEMETRY_FRAME_SIZE - 1]) {
+            memcpy(escFrames[motor], escRxFrame, ESC_TELEMETRY_FRAME_SIZE);
+            escAnswers[motor]++;
+            escAnsweredSequence = escRxSequence;
+        } else {
+            escFrameErrors[motor]++;
+        }
+    }
+}
+
+/*
+ * @brief  Decodes the answers received since the previous control cycle and updates the health of each motor. A
+ *         change of health is logged.
+ * @param  None.
+ * @retval None.
+ */
+void EscTelemetryUpdate(void) {
+    uint8_t frames[MOTOR_OUTPUT_CHANNELS][ESC_TELEMETRY_FRAME_SIZE];
+    uint32_t answers[MOTOR_OUTPUT_CHANNELS];
+    uint32_t misses[MOTOR_OUTPUT_CHANNELS];
+    uint32_t frameErrors[MOTOR_OUTPUT_CHANNELS];
+    uint32_t const timestamp = GetTimestampMs();
+    EscTelemetryType esc;
+    EscMotorState_TypeDef* state;
+    uint8_t i;
+
+    taskENTER_CRITICAL();
+    memcpy(frames, escFrames, sizeof(frames));
+    memcpy(answers, escAnswers, sizeof(answers));
+    memcpy(misses, escMisses, sizeof(misses));
+    memcpy(frameErrors, escFrameErrors, sizeof(frameErrors));
+    taskEXIT_CRITICAL();
+
+    for (i = 0; i < MOTOR_OUTPUT_CHANNELS; i++) {
+        state = &escMotorStates[i];
+        esc = escTelemetry[i];
+        esc.answers = answers[i];
+        esc.misses = misses[i];
+        esc.frameErrors = frameErrors[i];
+
+        if (answers[i] != state->answers) {
+            state->answers = answers[i];
+            state->answerTimestamp = timestamp;
+            DecodeEscFrame(frames[i], &esc);
+            esc.health = EvaluateEscHealth(state, &esc, GetMotorValue(i + 1), timestamp);
+        } else if (0 == answers[i] || timestamp - state->answerTimestamp > ESC_TELEMETRY_TIMEOUT) {
+            esc.health = ESC_HEALTH_NO_TELEMETRY;
+        }
+
+        if (esc.health != escTelemetry[i].health) {
+            if (ESC_HEALTH_OK == esc.health) {
+                LOG1("ESC %lu ok", (uint32_t) i + 1);
+            } else {
+                LOG2("WARNING: ESC %lu %s", (uint32_t) i + 1, escHealthNames[esc.health]);
+            }
+        }
+
+        escTelemetry[i] = esc;
+    }
+}
+
+/*
+ * @brief  Checks the motors for faults, for the failsafe of an armed UAV
+ * @param  None.
+ * @retval true if an ESC reports an over-temperature or a desync, else false
+ */
+bool IsEscFault(void) {
+    uint8_t i;
+
+    for (i = 0; i < MOTOR_OUTPUT_CHANNELS; i++) {
+        if (ESC_HEALTH_OVER_TEMPERATURE == escTelemetry[i].health || ESC_HEALTH_DESYNC == escTelemetry[i].health) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * @brief  Checks that all motors can be armed
+ * @param  None.
+ * @retval true if all ESC:s answer and are healthy, else false
+ */
+bool IsEscTelemetryHealthy(void) {
+    uint8_t i;
+
+    for (i = 0; i < MOTOR_OUTPUT_CHANNELS; i++) {
+        if (ESC_HEALTH_OK != escTelemetry[i].health) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * @brief  Gets the telemetry and health of all motors
+ * @param  dstTelemetry : Destination, indexed by motor
+ * @retval None.
+ */
+void GetEscTelemetry(EscTelemetryType dstTelemetry[MOTOR_OUTPUT_CHANNELS]) {
+    FCB_SUSPEND_SCHEDULER();
+    memcpy(dstTelemetry, escTelemetry, sizeof(escTelemetry));
+    FCB_RESUME_SCHEDULER();
+}
+
+/*
+ * @brief  Gets the name of a health state
+ * @param  health : Health state
+ * @retval Name, or "?" for an invalid state
+ */
+const char* GetEscHealthName(const EscHealthType health) {
+    if (health >= ESC_HEALTH_NBR) {
+        return "?";
+    }
+
+    return escHealthNames[health];
+}
+
+size_t PrintEscTelemetry(char* dst, const size_t dstSize) {
+    EscTelemetryType telemetry[MOTOR_OUTPUT_CHANNELS];
+    float32_t values[2];
+    size_t length;
+    uint8_t i;
+
+    GetEscTelemetry(telemetry);
+
+    length = (size_t) snprintf(dst, dstSize, "\nESC telemetry, one request every %u us\n"
+            "motor\thealth\t\ttemp\tvoltage\tcurrent\tmAh\teRPM\tanswers\tmisses\terrors\n", ESC_TELEMETRY_POLL_PERIOD);
+    for (i = 0; i < MOTOR_OUTPUT_CHANNELS && length < dstSize; i++) {
+        length += (size_t) snprintf(dst + length, dstSize - length, "%u\t%s\t%s%u\t", i + 1,
+                escHealthNames[telemetry[i].health], (strlen(escHealthNames[telemetry[i].health]) < 8) ? "\t" : "",
+                telemetry[i].temperature);
+        values[0] = (float32_t) telemetry[i].voltage / 100.0f;
+        values[1] = (float32_t) telemetry[i].current / 100.0f;
+        if (length < dstSize) {
+            length += FormatFixedList(dst + length, dstSize - length, "%2.2f\t%2.2f\t", values, 2);
+        }
+        if (length < dstSize) {
+            length += (size_t) snprintf(dst + length, dstSize - length, "%u\t%lu\t%lu\t%lu\t%lu\n",
+                    telemetry[i].consumption, telemetry[i].eRpm, telemetry[i].answers, telemetry[i].misses,
+                    telemetry[i].frameErrors);
+        }
+    }
+
+    return length;
+}
+
+/*
+ * @brief  Encodes the telemetry of all motors, each field repeated in motor order: 1 health, 2 temperature [degC],
+ *         3 voltage [10 mV], 4 current [10 mA], 5 consumption [mAh], 6 eRPM, 7 answers, 8 misses, 9 frame errors
+ * @param  stream : Destination stream
+ * @retval true if encoded, false if the stream is too small
+ */
+bool EncodeEscTelemetry(pb_ostream_t* stream) {
+    EscTelemetryType telemetry[MOTOR_OUTPUT_CHANNELS];
+    uint8_t i;
+
+    GetEscTelemetry(telemetry);
+
+    for (i = 0; i < MOTOR_OUTPUT_CHANNELS; i++) {
+        if (!pb_encode_tag(stream, PB_WT_VARINT, 1) || !pb_encode_varint(stream, telemetry[i].health)
+                || !pb_encode_tag(stream, PB_WT_VARINT, 2) || !pb_encode_varint(stream, telemetry[i].temperature)
+                || !pb_encode_tag(stream, PB_WT_VARINT, 3) || !pb_encode_varint(stream, telemetry[i].voltage)
+                || !pb_encode_tag(stream, PB_WT_VARINT, 4) || !pb_encode_varint(stream, telemetry[i].current)
+                || !pb_encode_tag(stream, PB_WT_VARINT, 5) || !pb_encode_varint(stream, telemetry[i].consumption)
+                || !pb_encode_tag(stream, PB_WT_VARINT, 6) || !pb_encode_varint(stream, telemetry[i].eRpm)
+                || !pb_encode_tag(stream, PB_WT_VARINT, 7) || !pb_encode_varint(stream, telemetry[i].answers)
+                || !pb_encode_tag(stream, PB_WT_VARINT, 8) || !pb_encode_varint(stream, telemetry[i].misses)
+                || !pb_encode_tag(stream, PB_WT_VARINT, 9) || !pb_encode_varint(stream, telemetry[i].frameErrors)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Calculates the CRC8 of an answer as the KISS ESC:s do, polynomial 0x07, most significant bit first
+ * @param  data : Bytes
+ * @param  length : Number of bytes
+ * @retval CRC8
+ */
+static uint8_t CalculateEscCrc8(const uint8_t* data, const uint8_t length) {
+    uint8_t crc = 0;
+    uint8_t i, j;
+
+    for (i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (j = 0; j < 8; j++) {
+            crc = (crc & 0x80) ? (uint8_t) ((crc << 1) ^ ESC_TELEMETRY_CRC8_POLY) : (uint8_t) (crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+/*
+ * @brief  Decodes an answer, whose values are big endian
+ * @param  frame : Answer with a valid CRC
+ * @param  esc : Destination, the health and the counters are kept
+ * @retval None.
+ */
+static void DecodeEscFrame(const uint8_t frame[ESC_TELEMETRY_FRAME_SIZE], EscTelemetryType* esc) {
+    esc->temperature = frame[0];
+    esc->voltage = (uint16_t) ((frame[1] << 8) | frame[2]);
+    esc->current = (uint16_t) ((frame[3] << 8) | frame[4]);
+    esc->consumption = (uint16_t) ((frame[5] << 8) | frame[6]);
+    esc->eRpm = (uint32_t) ((frame[7] << 8) | frame[8]) * 100;
+}
+
+/*
+ * @brief  Evaluates the health of a motor from a new answer
+ * @param  state : Desync detection state of the motor
+ * @param  esc : Decoded answer
+ * @param  command : Motor control value at the answer [0,65535]
+ * @param  timestamp : Of the answer [ms]
+ * @retval Health of the motor, a desync takes precedence over the temperature
+ */
+static EscHealthType EvaluateEscHealth(EscMotorState_TypeDef* state, const EscTelemetryType* esc,
+        const uint16_t command, const uint32_t timestamp) {
+    bool isSuspect = false;
+
+    if (command < ESC_DESYNC_MIN_COMMAND) {
+        state->spinUpEnd = timestamp + ESC_DESYNC_SPIN_UP_TIME;
+    } else if ((int32_t) (timestamp - state->spinUpEnd) >= 0) {
+        isSuspect = esc->eRpm < ESC_DESYNC_MIN_ERPM
+                || ((float32_t) esc->eRpm < (1.0f - ESC_DESYNC_MAX_ERPM_DROP) * (float32_t) state->previousERpm
+                        && (float32_t) command >= (1.0f - ESC_DESYNC_MAX_ERPM_DROP) * (float32_t) state->previousCommand);
+    }
+
+    if (!isSuspect) {
+        state->desyncAnswers = 0;
+    } else if (state->desyncAnswers < ESC_DESYNC_ANSWERS) {
+        state->desyncAnswers++;
+    }
+    state->previousERpm = esc->eRpm;
+    state->previousCommand = command;
+
+    if (state->desyncAnswers >= ESC_DESYNC_ANSWERS) {
+        return ESC_HEALTH_DESYNC;
+    } else if (esc->temperature >= ESC_TELEMETRY_MAX_TEMPERATURE) {
+        return ESC_HEALTH_OVER_TEMPERATURE;
+    } else if (esc->temperature >= ESC_TELEMETRY_HOT_TEMPERATURE) {
+        return ESC_HEALTH_HOT;
+    }
+
+    return ESC_HEALTH_OK;
+}
+
+/*
+ * @brief  Gets the time since startup
+ * @param  None.
+ * @retval Time [ms]
+ */
+static uint32_t GetTimestampMs(void) {
+    return xTaskGetTickCount() * portTICK_RATE_MS;
+}
+
+#endif /* MOTOR_ESC_TELEMETRY */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,440 @@
+/******************************************************************************
+ * @file    estimator_replay.c
+ * @author  Dragonfly
+ * @brief   Capture and replay of the state estimator input. The flight
+ *          control task puts the records in the RAM ring, the ESTIMATOR_LOG
+ *          task sends them over the USB log endpoint. The replay requests are
+ *          handled in the RX work item of the com port, whose low deferred
+ *          worker has a lower priority than the flight control task, so the flight control is never
+ *          preempted inside the estimator by a replay.
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "estimator_replay.h"
+
+#ifdef FCB_ESTIMATOR_REPLAY
+
+#include "state_estimation.h"
+#include "flight_control.h"
+#include "communication.h"
+#include "proto_frame.h"
+#include "ring_buffer.h"
+#include "buffer_monitor.h"
+#include "usbd_log_if.h"
+#include "fcb_error.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+#include <math.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+#define ESTIMATOR_LOG_TASK_PRIO         1
+#define ESTIMATOR_LOG_TASK_PERIOD       10      // [ms]
+
+#define ESTIMATOR_LOG_RING_SIZE         2048    // [bytes], power of two, ~100 ms of records at the default data rates
+
+_Static_assert(ESTIMATOR_RECORD_INIT_SIZE == 1 + sizeof(StateInitType) + 1 + sizeof(StateWarmStartType),
+        "The init record size does not match the estimator types");
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static xTaskHandle EstimatorLogTaskHandle = NULL;
+
+/* Records put by the flight control task and sent by the ESTIMATOR_LOG task */
+static RingBuffer_TypeDef estimatorLogRing;
+static uint8_t estimatorLogRingArray[ESTIMATOR_LOG_RING_SIZE];
+
+static volatile bool isLogStartPending = false; // Until the init record, the first one of a capture
+static volatile bool isLogActive = false;
+static volatile uint32_t droppedRecords = 0; // Written by the flight control task while the capture is active
+static uint32_t streamOffset = 0; // Written by the ESTIMATOR_LOG task, and on start while the ring is empty
+
+static uint8_t logMsg[ESTIMATOR_LOG_MSG_HEADER_SIZE + ESTIMATOR_LOG_CHUNK_SIZE];
+static uint8_t logFrame[PROTO_FRAME_MAX_SIZE(ESTIMATOR_LOG_MSG_HEADER_SIZE + ESTIMATOR_LOG_CHUNK_SIZE)];
+
+static volatile bool isReplayActive = false;
+
+/* Private function prototypes -----------------------------------------------*/
+static void EstimatorLogTask(void const *argument);
+static void PutRecord(const uint8_t* record, const uint16_t size);
+static bool SendLogChunk(const uint8_t* data, const uint16_t size);
+static bool CheckReplayRecords(const uint8_t* request, const uint8_t requestSize);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Creates the task that sends the captured records over the USB log endpoint
+ * @param  None
+ * @retval None
+ */
+void CreateEstimatorLogTask(void) {
+    if (SUCCESS != RingBufferInit(&estimatorLogRing, estimatorLogRingArray, ESTIMATOR_LOG_RING_SIZE)) {
+        ErrorHandler();
+        return;
+    }
+    BufferMonitorRegister("estimatorLog", ESTIMATOR_LOG_RING_SIZE, &estimatorLogRing.stats);
+
+    /* Estimator log task creation
+     * Task function pointer: EstimatorLogTask
+     * Task name: ESTLOG
+     * Stack depth: 2*configMINIMAL_STACK_SIZE
+     * Parameter: NULL
+     * Priority: ESTIMATOR_LOG_TASK_PRIO (0 to configMAX_PRIORITIES-1 possible)
+     * Handle: EstimatorLogTaskHandle
+     * */
+    if (pdPASS != xTaskCreate((pdTASK_CODE )EstimatorLogTask, (signed portCHAR*)"ESTLOG",
+                    2*configMINIMAL_STACK_SIZE, NULL, ESTIMATOR_LOG_TASK_PRIO, &EstimatorLogTaskHandle)) {
+        ErrorHandler();
+    }
+}
+
+/*
+ * @brief  Starts the capture, the flight control initializes the estimator again and the log starts with its init
+ * @param  None
+ * @retval FCB_OK if started, FCB_ERR if not in idle mode, active already or the previous capture is still being sent
+ */
+FcbRetValType EstimatorLogStart(void) {
+    if (FLIGHT_CONTROL_IDLE != GetFlightControlMode() || isLogStartPending || isLogActive
+            || !RingBufferIsEmpty(&estimatorLogRing)) {
+        return FCB_ERR;
+    }
+
+    droppedRecords = 0;
+    streamOffset = 0;
+    isLogStartPending = true;
+    ReinitStateEstimation();
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Stops the capture, the records in the ring are still sent
+ * @param  None
+ * @retval None
+ */
+void EstimatorLogStop(void) {
+    isLogStartPending = false;
+    isLogActive = false;
+}
+
+/*
+ * @brief  Records the latest initialization of the estimator, called by the flight control after the warm start and
+ *         the gyroscope bias seeding
+ * @param  None
+ * @retval None
+ */
+void EstimatorLogInit(void) {
+    uint8_t record[ESTIMATOR_RECORD_INIT_SIZE];
+    StateInitType init;
+    StateWarmStartType warmStart;
+
+    if (isLogStartPending) {
+        isLogStartPending = false;
+        isLogActive = true;
+    }
+    if (!isLogActive) {
+        return;
+    }
+
+    GetStateInit(&init);
+    record[0] = ESTIMATOR_RECORD_INIT;
+    memcpy(&record[1], &init, sizeof(init));
+    /* The quaternion filter has no warm start state, its biases start from zero as at the init */
+    record[1 + sizeof(init)] = (FCB_OK == GetStateWarmStart(&warmStart)) ? 1 : 0;
+    if (!record[1 + sizeof(init)]) {
+        memset(&warmStart, 0, sizeof(warmStart));
+    }
+    memcpy(&record[1 + sizeof(init) + 1], &warmStart, sizeof(warmStart));
+
+    PutRecord(record, sizeof(record));
+}
+
+/*
+ * @brief  Records a prediction and the attitude estimate after it, called by the flight control
+ * @param  timestamp : Time of the prediction [core clock cycles]
+ * @retval None
+ */
+void EstimatorLogPrediction(const uint32_t timestamp) {
+    uint8_t record[ESTIMATOR_RECORD_PREDICTION_SIZE];
+    float32_t angles[3];
+
+    if (!isLogActive) {
+        return;
+    }
+
+    angles[0] = GetRollAngle();
+    angles[1] = GetPitchAngle();
+    angles[2] = GetYawAngle();
+    record[0] = ESTIMATOR_RECORD_PREDICTION;
+    memcpy(&record[1], &timestamp, 4);
+    memcpy(&record[5], angles, sizeof(angles));
+
+    PutRecord(record, sizeof(record));
+}
+
+/*
+ * @brief  Records a correction, called by the flight control
+ * @param  sensor : Sensor of the sample
+ * @param  xyz : Sample as passed to UpdateCorrectionState()
+ * @param  timestamp : Time the sample was taken [core clock cycles]
+ * @retval None
+ */
+void EstimatorLogCorrection(const FcbSensorIndexType sensor, const float32_t xyz[3], const uint32_t timestamp) {
+    uint8_t record[ESTIMATOR_RECORD_CORRECTION_SIZE];
+
+    if (!isLogActive) {
+        return;
+    }
+
+    record[0] = ESTIMATOR_RECORD_CORRECTION;
+    record[1] = (uint8_t) sensor;
+    memcpy(&record[2], &timestamp, 4);
+    memcpy(&record[6], xyz, 12);
+
+    PutRecord(record, sizeof(record));
+}
+
+/*
+ * @brief  Replays the records of a RPC_ESTIMATOR_REPLAY request through the estimator and writes the response
+ * @param  request : Records, an init record first to start a replay
+ * @param  requestSize : Size of request, at least one record
+ * @param  response : Destination of the ESTIMATOR_REPLAY_RESPONSE_SIZE bytes response payload
+ * @retval FCB_OK if replayed, FCB_ERR if not in HIL mode, the records are malformed, the first one of a replay is not
+ *         an init record or an init is requested outside idle mode, then nothing is replayed
+ */
+FcbRetValType EstimatorReplay(const uint8_t* request, const uint8_t requestSize, uint8_t* response) {
+    StateInitType init;
+    StateWarmStartType warmStart;
+    float32_t xyz[3], angles[3], loggedAngles[3], estimate[8];
+    uint32_t timestamp;
+    uint16_t predictions = 0, mismatches = 0;
+    uint8_t offset = 0;
+
+    if (!HilModeIsActive() || !CheckReplayRecords(request, requestSize)) {
+        return FCB_ERR;
+    }
+    if (ESTIMATOR_RECORD_INIT == request[0]) {
+        if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+            return FCB_ERR;
+        }
+    } else if (!isReplayActive) {
+        return FCB_ERR;
+    }
+
+    while (offset < requestSize) {
+        switch (request[offset]) {
+        case ESTIMATOR_RECORD_INIT:
+            memcpy(&init, &request[offset + 1], sizeof(init));
+            memcpy(&warmStart, &request[offset + 1 + sizeof(init) + 1], sizeof(warmStart));
+
+            /* The flight control leaves the estimator from here on */
+            isReplayActive = true;
+            InitStatesFrom(&init);
+            if (request[offset + 1 + sizeof(init)] && FCB_OK != WarmStartStates(&warmStart)) {
+                return FCB_ERR;
+            }
+            offset += ESTIMATOR_RECORD_INIT_SIZE;
+            break;
+        case ESTIMATOR_RECORD_PREDICTION:
+            memcpy(&timestamp, &request[offset + 1], 4);
+            memcpy(loggedAngles, &request[offset + 5], sizeof(loggedAngles));
+            UpdatePredictionStateAt(timestamp);
+
+            /* Bit for bit, a changed estimator may also differ by rounding only */
+            angles[0] = GetRollAngle();
+            angles[1] = GetPitchAngle();
+            angles[2] = GetYawAngle();
+            if (0 != memcmp(angles, loggedAngles, sizeof(angles))) {
+                mismatches++;
+            }
+            predictions++;
+            offset += ESTIMATOR_RECORD_PREDICTION_SIZE;
+            break;
+        default: /* ESTIMATOR_RECORD_CORRECTION */
+            memcpy(&timestamp, &request[offset + 2], 4);
+            memcpy(xyz, &request[offset + 6], sizeof(xyz));
+            UpdateCorrectionState((FcbSensorIndexType) request[offset + 1], xyz, timestamp);
+            offset += ESTIMATOR_RECORD_CORRECTION_SIZE;
+            break;
+        }
+    }
+
+    estimate[0] = GetRollAngle();
+    estimate[1] = GetPitchAngle();
+    estimate[2] = GetYawAngle();
+    estimate[3] = GetRollRate();
+    estimate[4] = GetPitchRate();
+    estimate[5] = GetYawRate();
+    estimate[6] = GetZPosition();
+    estimate[7] = GetZVelocity();
+    PublishStateSnapshot();
+
+    /* The Cortex-M4 is little endian, like the payload */
+    memcpy(&response[0], &predictions, 2);
+    memcpy(&response[2], &mismatches, 2);
+    memcpy(&response[4], estimate, sizeof(estimate));
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Ends a replay, the flight control initializes the estimator again from the sensor samples
+ * @param  None
+ * @retval None
+ */
+void EstimatorReplayEnd(void) {
+    if (!isReplayActive) {
+        return;
+    }
+
+    /* A simulated flight may have armed since the replay started, the init then waits for idle mode */
+    isReplayActive = false;
+    ReinitStateEstimation();
+}
+
+/*
+ * @brief  Checks if a replay owns the estimator
+ * @param  None
+ * @retval true if active
+ */
+bool EstimatorReplayIsActive(void) {
+    return isReplayActive;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief  Task code sends the captured records, oldest first
+ * @param  argument : Unused parameter
+ * @retval None
+ */
+static void EstimatorLogTask(void const *argument) {
+    uint8_t* span;
+    uint16_t spanSize;
+
+    (void) argument;
+
+    for (;;) {
+        vTaskDelay(ESTIMATOR_LOG_TASK_PERIOD / portTICK_RATE_MS);
+
+        while ((spanSize = RingBufferPeekRead(&estimatorLogRing, &span)) > 0) {
+            if (spanSize > ESTIMATOR_LOG_CHUNK_SIZE) {
+                spanSize = ESTIMATOR_LOG_CHUNK_SIZE;
+            }
+            if (!SendLogChunk(span, spanSize)) {
+                break; /* USB log buffer full, the records are sent on the next round */
+            }
+            RingBufferCommitRead(&estimatorLogRing, spanSize);
+            streamOffset += spanSize;
+        }
+    }
+}
+
+/*
+ * @brief  Puts a record in the ring, a record that does not fit is dropped and counted
+ * @param  record : Record
+ * @param  size : Size of record
+ * @retval None
+ */
+static void PutRecord(const uint8_t* record, const uint16_t size) {
+    if (SUCCESS != RingBufferPutData(&estimatorLogRing, record, size)) {
+        droppedRecords++;
+    }
+}
+
+/*
+ * @brief  Encodes a part of the record stream as a ESTIMATOR_LOG_MSG_ENUM frame and sends it over the USB log endpoint
+ * @param  data : Record stream bytes, at most ESTIMATOR_LOG_CHUNK_SIZE
+ * @param  size : Size of data
+ * @retval true if sent, false if the USB log endpoint did not take it
+ */
+static bool SendLogChunk(const uint8_t* data, const uint16_t size) {
+    uint32_t dropped = droppedRecords;
+    size_t frameLength;
+
+    memcpy(&logMsg[0], &streamOffset, 4);
+    memcpy(&logMsg[4], &dropped, 4);
+    memcpy(&logMsg[ESTIMATOR_LOG_MSG_HEADER_SIZE], data, size);
+
+    frameLength = ProtoFrameEncode(logFrame, sizeof(logFrame), ESTIMATOR_LOG_MSG_ENUM, logMsg,
+            (uint16_t) (ESTIMATOR_LOG_MSG_HEADER_SIZE + size));
+    if (0 == frameLength) {
+        return false;
+    }
+
+    return USBD_OK == USBLogSendData(logFrame, (uint16_t) frameLength);
+}
+
+/*
+ * @brief  Checks that a replay request is whole records with finite samples, an init record only as the first one
+ * @param  request : Records
+ * @param  requestSize : Size of request
+ * @retval true if valid
+ */
+static bool CheckReplayRecords(const uint8_t* request, const uint8_t requestSize) {
+    StateInitType init;
+    float32_t xyz[3];
+    uint8_t offset = 0;
+    uint8_t axis;
+
+    if (0 == requestSize) {
+        return false;
+    }
+
+    while (offset < requestSize) {
+        switch (request[offset]) {
+        case ESTIMATOR_RECORD_INIT:
+            if (0 != offset || requestSize - offset < ESTIMATOR_RECORD_INIT_SIZE) {
+                return false;
+            }
+            memcpy(&init, &request[offset + 1], sizeof(init));
+            for (axis = 0; axis < 3; axis++) {
+                if (!isfinite(init.angles[axis])) {
+                    return false;
+                }
+            }
+            if (!(init.predictionPeriod > 0.0f) || !isfinite(init.predictionPeriod)) {
+                return false;
+            }
+            offset += ESTIMATOR_RECORD_INIT_SIZE;
+            break;
+        case ESTIMATOR_RECORD_PREDICTION:
+            if (requestSize - offset < ESTIMATOR_RECORD_PREDICTION_SIZE) {
+                return false;
+            }
+            offset += ESTIMATOR_RECORD_PREDICTION_SIZE;
+            break;
+        case ESTIMATOR_RECORD_CORRECTION:
+            if (requestSize - offset < ESTIMATOR_RECORD_CORRECTION_SIZE || request[offset + 1] >= FCB_SENSOR_NBR) {
+                return false;
+            }
+            /* The estimation cannot recover from NaN */
+            memcpy(xyz, &request[offset + 6], sizeof(xyz));
+            for (axis = 0; axis < 3; axis++) {
+                if (!isfinite(xyz[axis])) {
+                    return false;
+                }
+            }
+            offset += ESTIMATOR_RECORD_CORRECTION_SIZE;
+            break;
+        default:
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#endif /* FCB_ESTIMATOR_REPLAY */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -31,70 +31,224 @@
 #include "motor_control.h"
 #include "pid_control.h"
 #include "fcb_gyroscope.h"
+#include "fcb_barometer.h"
 #include "rotation_transformation.h"
 #include "state_estimation.h"
 #include "fcb_accelerometer_magnetometer.h"
 #include "flash.h"
+#include "latency_monitor.h"
+#include "wake_latency.h"
+#include "ccm_ram.h"
+#include "profiler.h"
+#include "deadline_monitor.h"
+#include "buffer_monitor.h"
+#include "telemetry_aggregate.h"
+#include "fms_link.h"
+#include "blackbox.h"
+#include "trace_recorder.h"
+#include "boot_timing.h"
+#include "control_executive.h"
+#include "hil_mode.h"
+#include "estimator_replay.h"
+#include "fcb_sensor_load_test.h"
+#include "wcet_test.h"
+#include "fcb_battery.h"
+#include "fcb_dynamic_notch.h"
+#include "fcb_sensor_timing.h"
+#include "stick_curves.h"
+#include "rc_smoothing.h"
+#include "mag_heading.h"
+#include "thrust_curve.h"
+#include "motor_test.h"
+#include "crash_detection.h"
+#include "motor_failure.h"
+#include "flight_mode.h"
+#include "esc_telemetry.h"
+#include "pid_autotune.h"
+#include "system_identification.h"
+#include "param_profile.h"
+#include "task_watchdog.h"
+#include "fcb_port.h"
 
 #include "FreeRTOS.h"
 #include "task.h"
-#include "queue.h"
+#include "semphr.h"
 
 /* Private typedef -----------------------------------------------------------*/
 
-typedef enum {
-  FLIGHT_CONTROL_UPDATE,
-  CORRECTION_UPDATE,
-  PREDICTION_UPDATE
-} FlightControlMsgType_TypeDef;
-
 typedef struct {
-  FcbSensorIndexType sensorType;
   float32_t xyz[3];
+  uint32_t timestamp; /* [core clock cycles] time the sample was taken */
+  uint32_t fetchTimestamp; /* [core clock cycles] time the sample was handed to this task */
 } sensorReading_TypeDef;
 
 /**
- * Messages sent to the queue
+ * Pending flags of the flight control task, one bit per sensor (1 << FcbSensorIndexType) plus the update events.
+ *
+ * Repeated events of a kind collapse into one bit and only the newest sample of each sensor is kept in its mailbox,
+ * so signalling can't overflow no matter how many samples arrive before the task runs.
  */
-typedef struct FlightControlMsg {
-  sensorReading_TypeDef sensorReading;
-  FlightControlMsgType_TypeDef type;
-} FlightControlMsg_TypeDef;
+enum {
+  FLIGHT_CONTROL_EVENT_CORRECTION_MASK = (1 << FCB_SENSOR_NBR) - 1,
+  FLIGHT_CONTROL_EVENT_PREDICTION_BIT = 1 << FCB_SENSOR_NBR,
+  FLIGHT_CONTROL_EVENT_UPDATE_BIT = 1 << (FCB_SENSOR_NBR + 1),
+  FLIGHT_CONTROL_EVENT_FAILSAFE_BIT = 1 << (FCB_SENSOR_NBR + 2),
+  FLIGHT_CONTROL_EVENT_INIT_BIT = 1 << (FCB_SENSOR_NBR + 3) // Initialize the state estimation again, idle mode only
+};
 
 /* Private define ------------------------------------------------------------*/
 #define FLIGHT_CONTROL_TASK_PRIO		configMAX_PRIORITIES-1
+#define FLIGHT_CONTROL_TASK_STACK_DEPTH	(2*configMINIMAL_STACK_SIZE)
+
+#define FLIGHT_CONTROL_EVENT_TIMEOUT          2000 // [ms]
 
-#define FLIGHT_CONTROL_QUEUE_SIZE		      6
-#define FLIGHT_CONTROL_QUEUE_TIMEOUT          2000 // [ms]
+#ifdef FCB_GYRO_SYNCHRONOUS_PIPELINE
+#ifdef FCB_GYRO_FIFO_MODE
+#error "FCB_GYRO_SYNCHRONOUS_PIPELINE needs one gyroscope interrupt per sample, FCB_GYRO_FIFO_MODE reads batches"
+#endif
+#define FLIGHT_CONTROL_SAMPLE_PERIOD          (1.0f/(float32_t) GyroDataRateHz()) // [s]
+#else
+#define FLIGHT_CONTROL_SAMPLE_PERIOD          ((float32_t) FLIGHT_CONTROL_TASK_PERIOD/1000.0f) // [s]
+#endif
+
+#if defined(FCB_FUSED_SENSOR_PIPELINE) && !defined(FCB_GYRO_SYNCHRONOUS_PIPELINE)
+#error "FCB_FUSED_SENSOR_PIPELINE runs the gyroscope synchronous chain, it needs FCB_GYRO_SYNCHRONOUS_PIPELINE"
+#endif
+
+#if defined(FLIGHT_CONTROL_RC_INTERPOLATION) && !defined(PID_USE_CASCADED_RATE_CONTROL)
+#error "FLIGHT_CONTROL_RC_INTERPOLATION ramps the rate flight mode references, which need PID_USE_CASCADED_RATE_CONTROL"
+#endif
 
 #define GOT_GYRO_SENSOR_SAMPLE  1
 #define GOT_ACC_SENSOR_SAMPLE   2
 #define GOT_MAG_SENSOR_SAMPLE   4
 #define GOT_ALL_SENSOR_SAMPLES  (GOT_ACC_SENSOR_SAMPLE | GOT_MAG_SENSOR_SAMPLE)
 
+/* Ranges of the reference limits in the parameter table */
+#define REF_LIMIT_PARAM_MAX_Z_VELOCITY      10.0f                              // [m/s]
+#define REF_LIMIT_PARAM_MAX_ROLLPITCH_ANGLE ((float32_t) (90.0f*PI/180.0f))    // [rad]
+#define REF_LIMIT_PARAM_MAX_YAW_RATE        ((float32_t) (360.0f*PI/180.0f))   // [rad/s]
+
 /* Private macro -------------------------------------------------------------*/
 
+/* Limits a value to +/-MAX */
+#define LIMIT_SYMMETRIC(VAL, MAX)	(((VAL) > (MAX)) ? (MAX) : (((VAL) < -(MAX)) ? -(MAX) : (VAL)))
+
 /* Private variables ---------------------------------------------------------*/
-static xQueueHandle qFlightControl = NULL;
+static xSemaphoreHandle semFlightControl = NULL;
+#ifdef FCB_CCM_RAM
+static portSTACK_TYPE flightControlTaskStack[FLIGHT_CONTROL_TASK_STACK_DEPTH] CCM_RAM; /* instead of the FreeRTOS heap */
+#endif
+static volatile uint32_t flightControlEventsPending = 0;
+#ifdef FCB_FUSED_SENSOR_PIPELINE
+static volatile bool isPipelineFused = false; // Set when the SENSORS task has taken over the flight control
+#endif
+
+/* Newest sample of each sensor, written together with its pending bit */
+static sensorReading_TypeDef sensorMailbox[FCB_SENSOR_NBR];
+static BufferStats_TypeDef sensorMailboxStats; // Overflows are samples overwritten before they were fetched
 
 static RefSignals_TypeDef refSignals; // Control reference signals
 static RefSignals_TypeDef refSignalsLimits; // Max limits for reference signals
 static CtrlSignals_TypeDef ctrlSignals; // Physical control signals
+static Receiver_Snapshot_TypeDef receiverSnapshot; // RC receiver channels, read once per control cycle
+static const float32_t zeroStickRefs[STICK_AXIS_NBR] = { 0.0, 0.0, 0.0, 0.0 }; // RC smoothing state of reset references
 
 /* Flight mode */
 static enum FlightControlMode flightControlMode = FLIGHT_CONTROL_IDLE;
 
+/* Mode of the receiver PID switch position, FLIGHT_CONTROL_PID (angle), FLIGHT_CONTROL_RATE or
+ * FLIGHT_CONTROL_ALTITUDE_HOLD */
+static enum FlightControlMode stabilizedFlightMode = FLIGHT_CONTROL_PID;
+
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+/* Held Z position of the altitude hold flight mode [m], positive downwards */
+static float32_t altitudeHoldRef;
+#endif
+
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+/* Roll, pitch & yaw body rate references in the rate flight mode [rad/s] */
+static float32_t rateModeRefs[3];
+
+#ifdef FLIGHT_CONTROL_RC_INTERPOLATION
+/* Time between the latest two RC frames, 0 if a frame was missed in between [core clock cycles] */
+static uint32_t receiverFramePeriod;
+
+/* Rate flight mode references are ramped from the previous references to those of the latest RC frame [rad/s] */
+static float32_t rateModeRefsFrom[3];
+static float32_t rateModeRefsTo[3];
+static uint32_t rateModeRefsRampStart; // [core clock cycles]
+static uint32_t rateModeRefsRampPeriod; // [core clock cycles]
+#endif
+#endif
+
+#ifdef FCB_CONTROL_EXECUTIVE
+/* Rate loop setpoint of the control executive, published after each outer loop update and gyroscope correction */
+static ControlExecutiveSetpoint_TypeDef executiveSetpoint;
+#endif
+
+/* Time between flight control updates [s] */
+static float32_t flightControlSamplePeriod = FLIGHT_CONTROL_TASK_PERIOD/1000.0f;
+
 xTaskHandle FlightControlTaskHandle; // Task handle for flight control task
 
 /* Private function prototypes -----------------------------------------------*/
+static void PostSensorSample(FcbSensorIndexType sensorType, float32_t xyz[3], uint32_t timestamp);
+static uint32_t WaitForFlightControlEvents(sensorReading_TypeDef readings[FCB_SENSOR_NBR]);
+static uint32_t FetchFlightControlEvents(sensorReading_TypeDef readings[FCB_SENSOR_NBR]);
+static void ProcessFlightControlEvents(const uint32_t events, sensorReading_TypeDef readings[FCB_SENSOR_NBR]);
+static void SetFlightControlEventFromISR(const uint32_t eventBit);
+static void PredictStates(void);
+static void CorrectStates(const FcbSensorIndexType sensor, const sensorReading_TypeDef* reading);
+static void SetLoopDeadlines(void);
 static void UpdateFlightControl(void);
-static void UpdateFlightMode(void);
-static void SetRefSignals(void);
+static uint8_t UpdateFlightMode(void);
+static bool ReadReceiverSnapshot(void);
+static RAMFUNC void SetRefSignals(void);
+static bool SetFmsRefSignals(void);
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+static void SetAltitudeHoldRefSignals(void);
+static bool IsVerticalVelocityControlMode(const enum FlightControlMode mode);
+#endif
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+static void SetRateModeRefSignals(void);
+static void ResetRateModeRefSignals(void);
+#ifdef FLIGHT_CONTROL_RC_INTERPOLATION
+static void InterpolateRateModeRefSignals(void);
+#endif
+static float32_t ReceiverToReferenceSignal(const StickAxisType axis, const int32_t receiverValue,
+		const float32_t maxRefSignal);
+#endif
+#ifdef FCB_WCET_TEST
+static void SetWcetTestRefSignals(void);
+#endif
+static void UpdatePIDFlightControl(void);
+static void AggregateCtrlSignals(void);
+static void IndicateFlightControlAlive(void);
+#if defined(PID_USE_CASCADED_RATE_CONTROL) && !defined(FCB_CONTROL_EXECUTIVE)
+static void UpdateRateControl(void);
+#endif
+#ifdef FCB_CONTROL_EXECUTIVE
+static void UpdateControlExecutive(const float32_t gyroXYZ[3]);
+static void SetControlExecutiveSetpoint(void);
+#endif
 
 void setMaxLimitForReferenceSignalToDefault(void);
+static FcbRetValType SaveReferenceMaxLimits(void);
 
 static void FlightControlTask(void const *argument);
 
+/* The reference limits in the parameter table, the yaw angle limit is fixed */
+static const Param_TypeDef refLimitParamTable[] = {
+	{ "REF_MAX_ZVEL", PARAM_TYPE_FLOAT, &refSignalsLimits.zVelocity, 0.0, REF_LIMIT_PARAM_MAX_Z_VELOCITY },
+	{ "REF_MAX_ROLL", PARAM_TYPE_FLOAT, &refSignalsLimits.rollAngle, 0.0, REF_LIMIT_PARAM_MAX_ROLLPITCH_ANGLE },
+	{ "REF_MAX_PITCH", PARAM_TYPE_FLOAT, &refSignalsLimits.pitchAngle, 0.0, REF_LIMIT_PARAM_MAX_ROLLPITCH_ANGLE },
+	{ "REF_MAX_YAWRATE", PARAM_TYPE_FLOAT, &refSignalsLimits.yawAngleRate, 0.0, REF_LIMIT_PARAM_MAX_YAW_RATE }
+};
+
+static const ParamGroup_TypeDef refLimitParamGroup = { refLimitParamTable,
+		sizeof(refLimitParamTable)/sizeof(refLimitParamTable[0]), NULL, SaveReferenceMaxLimits };
+
 /* Exported functions --------------------------------------------------------*/
 
 /**
@@ -103,22 +257,35 @@ static void FlightControlTask(void const *argument);
  * @retval None.
  */
 void CreateFlightControlTask(void) {
-    if (0 == (qFlightControl = xQueueCreate(FLIGHT_CONTROL_QUEUE_SIZE, sizeof(FlightControlMsg_TypeDef)))) {
+    vSemaphoreCreateBinary(semFlightControl);
+    if (NULL == semFlightControl) {
         ErrorHandler();
     }
+    xSemaphoreTake(semFlightControl, 0); /* created given, start with nothing pending */
+    TRACE_OBJECT_NAME(semFlightControl, "qFlightControl");
+    BufferMonitorRegister("fcSensorMbox", FCB_SENSOR_NBR, &sensorMailboxStats);
 
 	/* Flight Control task creation
 	 * Task function pointer: FlightControlTask
 	 * Task name: FLIGHT_CTRL
-	 * Stack depth: 2*configMINIMAL_STACK_SIZE
+	 * Stack depth: FLIGHT_CONTROL_TASK_STACK_DEPTH, in the CCM SRAM with FCB_CCM_RAM
 	 * Parameter: NULL
 	 * Priority: FLIGHT_CONTROL_TASK_PRIO (0 to configMAX_PRIORITIES-1 possible)
 	 * Handle: FlightControlTaskHandle
 	 * */
+#ifdef FCB_CCM_RAM
+	CcmRamRegisterObject("FLIGHT_CTRL stack", flightControlTaskStack, sizeof(flightControlTaskStack));
+	if (pdPASS != xTaskGenericCreate((pdTASK_CODE )FlightControlTask, (signed portCHAR*)"FLIGHT_CTRL",
+			FLIGHT_CONTROL_TASK_STACK_DEPTH, NULL, FLIGHT_CONTROL_TASK_PRIO, &FlightControlTaskHandle,
+			flightControlTaskStack, NULL)) {
+		ErrorHandler();
+	}
+#else
 	if (pdPASS != xTaskCreate((pdTASK_CODE )FlightControlTask, (signed portCHAR*)"FLIGHT_CTRL",
-			2*configMINIMAL_STACK_SIZE, NULL, FLIGHT_CONTROL_TASK_PRIO, &FlightControlTaskHandle)) {
+			FLIGHT_CONTROL_TASK_STACK_DEPTH, NULL, FLIGHT_CONTROL_TASK_PRIO, &FlightControlTaskHandle)) {
 		ErrorHandler();
 	}
+#endif
 }
 
 /**
@@ -130,6 +297,54 @@ enum FlightControlMode GetFlightControlMode(void) {
 	return flightControlMode;
 }
 
+/**
+ * @brief  Sets the mode of the receiver PID switch position: the angle mode, the rate mode that requires
+ *         PID_USE_CASCADED_RATE_CONTROL or the altitude hold mode that requires PID_USE_VERTICAL_VELOCITY_CONTROL.
+ *         The UAV must be in idle mode.
+ * @param  mode : FLIGHT_CONTROL_PID, FLIGHT_CONTROL_RATE or FLIGHT_CONTROL_ALTITUDE_HOLD
+ * @retval FLIGHTCTRL_OK if set, else FLIGHTCTRL_ERROR
+ */
+FlightControlErrorStatus SetStabilizedFlightMode(const enum FlightControlMode mode) {
+	if (FLIGHT_CONTROL_IDLE != flightControlMode) {
+		return FLIGHTCTRL_ERROR;
+	}
+
+	switch (mode) {
+	case FLIGHT_CONTROL_PID:
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+	case FLIGHT_CONTROL_RATE:
+#endif
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+	case FLIGHT_CONTROL_ALTITUDE_HOLD:
+#endif
+		break;
+	default:
+		return FLIGHTCTRL_ERROR;
+	}
+
+	stabilizedFlightMode = mode;
+	return FLIGHTCTRL_OK;
+}
+
+/**
+ * @brief  Returns the mode of the receiver PID switch position.
+ * @param  None.
+ * @retval FLIGHT_CONTROL_PID, FLIGHT_CONTROL_RATE or FLIGHT_CONTROL_ALTITUDE_HOLD
+ */
+enum FlightControlMode GetStabilizedFlightMode(void) {
+	return stabilizedFlightMode;
+}
+
+/*
+ * @brief  Gets the time between flight control updates, i.e. the TIM7 period or the gyroscope sample period in
+ *         FCB_GYRO_SYNCHRONOUS_PIPELINE mode
+ * @param  None.
+ * @retval Sample period [s]
+ */
+float32_t GetFlightControlSamplePeriod(void) {
+	return flightControlSamplePeriod;
+}
+
 /*
  * @brief  Get Z velocity reference
  * @param  None
@@ -232,48 +447,167 @@ void ResetRefSignals(RefSignals_TypeDef* refSignals) {
  * @retval None.
  */
 static void UpdateFlightControl(void) {
+	uint8_t transitionActions;
+	bool newReceiverFrame;
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+	float32_t previousThrust;
+#endif
+
+	/* Read the channels of the latest RC frame, used by the whole control cycle */
+	newReceiverFrame = ReadReceiverSnapshot();
+
+#ifdef FCB_BATTERY_MONITOR
+	/* Before the flight mode, which it may keep idle, and the motor allocation, which it compensates */
+	BatteryMonitorUpdate();
+#endif
+
+#ifdef FCB_DYNAMIC_NOTCH
+	/* Hands a collected gyroscope frame to the low priority analysis */
+	DynamicNotchUpdate();
+#endif
+
+#ifdef MOTOR_ESC_TELEMETRY
+	/* Before the flight mode, which an ESC fault sends to failsafe */
+	EscTelemetryUpdate();
+#endif
+
+#ifdef FCB_CRASH_DETECTION
+	/* On the controller outputs of the previous control cycle, before the flight mode, which a crash sends to
+	 * failsafe. The flying mode still holds, so the frame of the crash gets into the session that failsafe ends. */
+	if (UpdateCrashDetection((receiverSnapshot.Throttle - INT16_MIN) / (float32_t) UINT16_MAX)) {
+		BlackboxLogEventFrame();
+	}
+#endif
+
+#ifdef FCB_MOTOR_FAILURE_DETECTION
+	/* Before the flight mode, which then keeps flying on an ESC fault of the failed motor */
+	if (UpdateMotorFailureDetection()) {
+		BlackboxLogEventFrame();
+	}
+#endif
 
 	/* Updates the current flight mode */
-	UpdateFlightMode();
+	transitionActions = UpdateFlightMode();
+
+	/* The exit and entry actions of a flight mode transition, so that PID control starts clean in the new mode */
+	if (0 != transitionActions) {
+		/* The bench motor tests run within idle mode only, the motor test is to be unlocked again */
+		StopThrustTest();
+		LockMotorTest();
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+		previousThrust = ctrlSignals.thrust;
+#endif
+		if (transitionActions & FLIGHT_MODE_ACTION_RESET_CONTROL) {
+			ResetCtrlSignals(&ctrlSignals);
+			ResetRefSignals(&refSignals);
+			RcSmoothingReset(zeroStickRefs);
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+			ResetRateModeRefSignals();
+#endif
+#ifdef FCB_CONTROL_EXECUTIVE
+			/* Take the motors from the executive before the new mode uses them, its rate controllers are reset too */
+			executiveSetpoint.isEnabled = false;
+			ControlExecutiveSetSetpoint(&executiveSetpoint);
+			ControlExecutiveSuspend();
+			ResetPIDControllers();
+			ControlExecutiveResume();
+#else
+			ResetPIDControllers();	// Set PID control variables to initial values
+#endif
+		}
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+		/* Bumpless transfer into and out of the altitude hold mode, the thrust continues from the previous mode */
+		if ((transitionActions & FLIGHT_MODE_ACTION_BUMPLESS_THRUST) && IsVerticalVelocityControlMode(flightControlMode)
+				&& 0.0f != previousThrust) {
+			InitPIDVerticalControlState(previousThrust);
+		}
+		if (transitionActions & FLIGHT_MODE_ACTION_CAPTURE_ALTITUDE) {
+			altitudeHoldRef = GetZPosition();
+		}
+#endif
+		newReceiverFrame = true; // Apply the current frame to the cleared references
+	}
+#ifndef PID_USE_CASCADED_RATE_CONTROL
+	(void) newReceiverFrame; // Only the rate flight mode applies frames on its own
+#endif
+
+#ifdef PID_USE_GAIN_SCHEDULING
+	/* At a low rate, the PID update below then swaps to the rescaled coefficients */
+	UpdatePIDGainSchedule(ctrlSignals.thrust);
+#endif
+
+#ifdef PID_AUTOTUNE
+	/* Engages or releases the relay of the moment controllers for the PID update below */
+	UpdateAutotune();
+#endif
+
+#ifdef FCB_SYSTEM_IDENTIFICATION
+	/* Ends or aborts the excitation of the motor allocation */
+	UpdateSystemIdentification();
+#endif
 
 	switch (flightControlMode) {
 
 	case FLIGHT_CONTROL_IDLE:
-		ShutdownMotors();
-
-		/* Reset control signals, values and parameters */
-		ResetCtrlSignals(&ctrlSignals);
-		ResetRefSignals(&refSignals);
-		InitPIDControllers();	// Set PID control variables to initial values
+#ifdef FCB_WCET_TEST
+		if (WCET_TEST_IS_ACTIVE()) {
+			/* The worst-case input of the WCET test, the motor outputs are interlocked while it is active */
+			SetWcetTestRefSignals();
+			UpdatePIDFlightControl();
+
+			return;
+		}
+#endif
+		if (!UpdateMotorTest() && !UpdateThrustTest()) {
+			ShutdownMotors();
+		}
+		BlackboxLogControlCycle(); // Ends the logging session
 
 		return;
 
 	case FLIGHT_CONTROL_RAW:
 		MotorAllocationRaw();
-
-		/* Reset control signals, values and parameters */
-		ResetCtrlSignals(&ctrlSignals);
-		ResetRefSignals(&refSignals);
-		InitPIDControllers();	// Set PID control variables to initial values
+		BlackboxLogControlCycle();
 
 		return;
 
 	case FLIGHT_CONTROL_PID:
 		/* Set the control reference signals based on RC receiver input */
 		SetRefSignals();
+		UpdatePIDFlightControl();
 
-		/* Update PID control output */
-		ctrlSignals.thrust = -(GetThrottleReceiverChannel()-INT16_MIN)*MAX_THRUST/((float32_t)UINT16_MAX); // NOTE: Raw throttle control for now until control developed for Z position/velocity
-		UpdatePIDControlSignals(&ctrlSignals);
+		return;
 
-		/* Allocate control signal action to motors based on thrust/torque<->motor signal mapping for each motor */
-		MotorAllocationPhysical(ctrlSignals.thrust, ctrlSignals.rollMoment, ctrlSignals.pitchMoment, ctrlSignals.yawMoment);
+	case FLIGHT_CONTROL_AUTONOMOUS:
+		/* Follow the FMS setpoints, the pilot takes over through the receiver if they stop arriving */
+		if (!SetFmsRefSignals()) {
+			SetRefSignals();
+		}
+		UpdatePIDFlightControl();
 
 		return;
 
-	case FLIGHT_CONTROL_AUTONOMOUS:
-		// TODO : Should get reference signals from FMS board and call position controllers
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+	case FLIGHT_CONTROL_ALTITUDE_HOLD:
+		/* The throttle stick reference is the climb rate, the altitude controller adds the hold correction */
+		SetRefSignals();
+		SetAltitudeHoldRefSignals();
+		UpdatePIDFlightControl();
+
+		return;
+#endif
+
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+	case FLIGHT_CONTROL_RATE:
+		/* Only the references are set here, the rate loop runs on the gyroscope samples. It applies a new RC frame
+		 * on its next tick already, so this only catches frames it has not seen yet. */
+		if (newReceiverFrame) {
+			SetRateModeRefSignals();
+		}
+		ctrlSignals.thrust = -(receiverSnapshot.Throttle-INT16_MIN)*MAX_THRUST/((float32_t)UINT16_MAX); // NOTE: Raw throttle control
+
 		return;
+#endif
 
 	default:
 		ShutdownMotors();
@@ -283,171 +617,772 @@ static void UpdateFlightControl(void) {
 }
 
 /*
- * @brief  Sets the Flight Mode - handles transitions between flight modes.
+ * @brief  Updates the PID control output from the reference signals and, unless the rate loop does it, the motors
  * @param  None.
  * @retval None.
  */
-static void UpdateFlightMode(void) {
-	if (!IsReceiverActive())
-		flightControlMode = FLIGHT_CONTROL_IDLE;
-	else if (GetReceiverRawFlightSet())
-		flightControlMode = FLIGHT_CONTROL_RAW;
-	else if (GetReceiverPIDFlightSet())
-		flightControlMode = FLIGHT_CONTROL_PID;
-	else
-		flightControlMode = FLIGHT_CONTROL_IDLE;
+static void UpdatePIDFlightControl(void) {
+#ifndef PID_USE_CASCADED_RATE_CONTROL
+	float32_t achievedMoments[3];
+#endif
+
+#ifdef FCB_MOTOR_FAILURE_DETECTION
+	/* Descend with a limited tilt on the remaining motors. The held altitude follows the descent, so that the altitude
+	 * controller does not work against it. */
+	if (LimitMotorFailureRefSignals(&refSignals)) {
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+		altitudeHoldRef = GetZPosition();
+#endif
+	}
+#endif
+#ifndef PID_USE_VERTICAL_VELOCITY_CONTROL
+	ctrlSignals.thrust = -(receiverSnapshot.Throttle-INT16_MIN)*MAX_THRUST/((float32_t)UINT16_MAX); // NOTE: Raw throttle control
+#endif
+	UpdatePIDControlSignals(&ctrlSignals);
+	LatencyMonitorMark(LATENCY_STAGE_CONTROL);
+
+#ifndef PID_USE_CASCADED_RATE_CONTROL
+	/* With the cascaded control the rate loop sets the moments, and aggregates them */
+	AggregateCtrlSignals();
+
+	/* Allocate control signal action to motors based on thrust/torque<->motor signal mapping for each motor */
+	MotorAllocationPhysical(ctrlSignals.thrust, ctrlSignals.rollMoment, ctrlSignals.pitchMoment, ctrlSignals.yawMoment,
+			achievedMoments);
+	ApplyPIDAllocationFeedback(&ctrlSignals, achievedMoments);
+	BlackboxLogControlCycle();
+#endif
 }
 
+#if defined(PID_USE_CASCADED_RATE_CONTROL) && !defined(FCB_CONTROL_EXECUTIVE)
 /*
- * @brief  Sets the reference values based on RC receiver input. This sets the limits for maximum pilot input.
- * @param  None
- * @retval None
+ * @brief  Runs the inner rate loop of the cascaded control and the motor allocation on every
+ *         PID_RATE_LOOP_GYRO_DIVISOR:th gyroscope sample. The thrust and rate references are set by the outer loop
+ *         in UpdateFlightControl().
+ * @param  None.
+ * @retval None.
  */
-static void SetRefSignals(void) {
-	int32_t throttle, aileron, elevator, rudder;
+static void UpdateRateControl(void) {
+	static uint16_t gyroSampleCounter = 0;
+	float32_t achievedMoments[3];
 
-	throttle = GetThrottleReceiverChannel();
-	aileron = GetAileronReceiverChannel();
-	elevator = GetElevatorReceiverChannel();
-	rudder = GetRudderReceiverChannel();
-
-	/* Set Z velocity reference depending on receiver throttle channel */
-	// TODO set Z velocity reference to control altitude when such a controller is available
-	/*
-	if (throttle <= RECEIVER_TO_REFERENCE_ZERO_PADDING && throttle >= -RECEIVER_TO_REFERENCE_ZERO_PADDING) {
-		refSignals.zVelocity = 0.0;
-	} else if (throttle >= 0) {
-		refSignals.zVelocity = -refSignalsLimits.zVelocity*(throttle - RECEIVER_TO_REFERENCE_ZERO_PADDING)
-				/ (INT16_MAX - RECEIVER_TO_REFERENCE_ZERO_PADDING); // Negative sign because Z points downwards
+	if (++gyroSampleCounter < PID_RATE_LOOP_GYRO_DIVISOR) {
+		return;
+	}
+	gyroSampleCounter = 0;
+	DeadlineMonitorBegin(DEADLINE_LOOP_INNER);
+
+	/* The outer loop handles the other modes on its own, the WCET test runs the PID path in idle mode */
+	if (FLIGHT_CONTROL_PID == flightControlMode || FLIGHT_CONTROL_AUTONOMOUS == flightControlMode
+			|| FLIGHT_CONTROL_ALTITUDE_HOLD == flightControlMode || WCET_TEST_IS_ACTIVE()) {
+		UpdatePIDRateControlSignals(&ctrlSignals);
+	} else if (FLIGHT_CONTROL_RATE == flightControlMode) {
+		/* Apply a new RC frame on this tick instead of waiting up to a flight control period for the outer loop */
+		if (GetReceiverSnapshotSequence() != receiverSnapshot.Sequence && ReadReceiverSnapshot()) {
+			SetRateModeRefSignals();
+			ctrlSignals.thrust = -(receiverSnapshot.Throttle-INT16_MIN)*MAX_THRUST/((float32_t)UINT16_MAX); // NOTE: Raw throttle control
+		}
+#ifdef FLIGHT_CONTROL_RC_INTERPOLATION
+		InterpolateRateModeRefSignals();
+#endif
+		UpdatePIDRateModeControlSignals(&ctrlSignals, rateModeRefs);
 	} else {
-		refSignals.zVelocity = -refSignalsLimits.zVelocity*(throttle + RECEIVER_TO_REFERENCE_ZERO_PADDING)
-				/ (-INT16_MIN - RECEIVER_TO_REFERENCE_ZERO_PADDING); // Negative sign because Z points downwards
+		DeadlineMonitorEnd(DEADLINE_LOOP_INNER);
+		return;
+	}
+	LatencyMonitorMark(LATENCY_STAGE_CONTROL);
+	AggregateCtrlSignals();
+
+	/* Allocate control signal action to motors based on thrust/torque<->motor signal mapping for each motor */
+	MotorAllocationPhysical(ctrlSignals.thrust, ctrlSignals.rollMoment, ctrlSignals.pitchMoment, ctrlSignals.yawMoment,
+			achievedMoments);
+	ApplyPIDAllocationFeedback(&ctrlSignals, achievedMoments);
+	BlackboxLogControlCycle();
+	DeadlineMonitorEnd(DEADLINE_LOOP_INNER);
+}
+#endif
+
+#ifdef FCB_CONTROL_EXECUTIVE
+/*
+ * @brief  Passes the bias estimate of a gyroscope correction on to the control executive, which runs the rate loop
+ *         and the motor allocation on the samples instead of UpdateRateControl(), and aggregates the control signals
+ *         of its latest rate loop update
+ * @param  gyroXYZ : Gyroscope sample of the correction [rad/s]
+ * @retval None.
+ */
+static void UpdateControlExecutive(const float32_t gyroXYZ[3]) {
+	static uint16_t gyroSampleCounter = 0;
+	float32_t bodyRates[3];
+	float32_t moments[3];
+	uint8_t i;
+
+	/* The bias the correction subtracted from this sample */
+	GetUnbiasedBodyRates(bodyRates);
+	for (i = 0; i < 3; i++) {
+		executiveSetpoint.rateBiases[i] = gyroXYZ[i] - bodyRates[i];
+	}
+
+	/* Apply a new RC frame on this sample instead of waiting up to a flight control period for the outer loop */
+	if (FLIGHT_CONTROL_RATE == flightControlMode && GetReceiverSnapshotSequence() != receiverSnapshot.Sequence
+			&& ReadReceiverSnapshot()) {
+		SetRateModeRefSignals();
+		ctrlSignals.thrust = -(receiverSnapshot.Throttle-INT16_MIN)*MAX_THRUST/((float32_t)UINT16_MAX); // NOTE: Raw throttle control
+	}
+	SetControlExecutiveSetpoint();
+
+	if (++gyroSampleCounter < PID_RATE_LOOP_GYRO_DIVISOR) {
+		return;
+	}
+	gyroSampleCounter = 0;
+	if (!executiveSetpoint.isEnabled) {
+		return;
 	}
-	*/
 
-	/* Set roll angle reference depending on receiver aileron channel */
-	if (aileron <= RECEIVER_TO_REFERENCE_ZERO_PADDING && aileron >= -RECEIVER_TO_REFERENCE_ZERO_PADDING) {
-		refSignals.rollAngle = 0.0;
-	} else if (aileron >= 0) {
-		refSignals.rollAngle = -refSignalsLimits.rollAngle*(aileron - RECEIVER_TO_REFERENCE_ZERO_PADDING)
-				/ (INT16_MAX - RECEIVER_TO_REFERENCE_ZERO_PADDING);
+	ControlExecutiveGetCtrlSignals(moments);
+	ctrlSignals.rollMoment = moments[ROLL_IDX];
+	ctrlSignals.pitchMoment = moments[PITCH_IDX];
+	ctrlSignals.yawMoment = moments[YAW_IDX];
+	AggregateCtrlSignals();
+
+	AggregateSample(AGGREGATE_MOTOR_1, GetMotorValue(1));
+	AggregateSample(AGGREGATE_MOTOR_2, GetMotorValue(2));
+	AggregateSample(AGGREGATE_MOTOR_3, GetMotorValue(3));
+	AggregateSample(AGGREGATE_MOTOR_4, GetMotorValue(4));
+	BlackboxLogControlCycle();
+}
+
+/*
+ * @brief  Publishes the rate loop setpoint of the current flight mode to the control executive. The stabilized modes
+ *         enable it, the others drive the motors from the task.
+ * @param  None.
+ * @retval None.
+ */
+static void SetControlExecutiveSetpoint(void) {
+	uint8_t i;
+
+	if (FLIGHT_CONTROL_PID == flightControlMode || FLIGHT_CONTROL_AUTONOMOUS == flightControlMode
+			|| FLIGHT_CONTROL_ALTITUDE_HOLD == flightControlMode) {
+		GetPIDRateLoopReferences(executiveSetpoint.refRates);
+		executiveSetpoint.isEnabled = true;
+	} else if (FLIGHT_CONTROL_RATE == flightControlMode) {
+		/* The outer loop does not run, a control cycle starts on each rate mode setpoint */
+		SwapPIDCoefficients();
+		for (i = 0; i < 3; i++) {
+			executiveSetpoint.refRates[i] = rateModeRefs[i];
+		}
+		executiveSetpoint.isEnabled = true;
 	} else {
-		refSignals.rollAngle = -refSignalsLimits.rollAngle*(aileron + RECEIVER_TO_REFERENCE_ZERO_PADDING)
-				/ (-INT16_MIN - RECEIVER_TO_REFERENCE_ZERO_PADDING);
+		executiveSetpoint.isEnabled = false;
 	}
+	executiveSetpoint.thrust = ctrlSignals.thrust;
+
+	ControlExecutiveSetSetpoint(&executiveSetpoint);
+}
+#endif
 
-	/* Set pitch angle reference depending on receiver elevator channel */
-	if (elevator <= RECEIVER_TO_REFERENCE_ZERO_PADDING && elevator >= -RECEIVER_TO_REFERENCE_ZERO_PADDING) {
-		refSignals.pitchAngle = 0.0;
-	} else if (elevator >= 0) {
-		refSignals.pitchAngle = -refSignalsLimits.pitchAngle*(elevator - RECEIVER_TO_REFERENCE_ZERO_PADDING)
-				/ (INT16_MAX - RECEIVER_TO_REFERENCE_ZERO_PADDING);
+/*
+ * @brief  Adds the control signals of the latest control update to their telemetry summaries
+ * @param  None.
+ * @retval None.
+ */
+static void AggregateCtrlSignals(void) {
+	AggregateSample(AGGREGATE_CTRL_THRUST, ctrlSignals.thrust);
+	AggregateSample(AGGREGATE_CTRL_ROLL, ctrlSignals.rollMoment);
+	AggregateSample(AGGREGATE_CTRL_PITCH, ctrlSignals.pitchMoment);
+	AggregateSample(AGGREGATE_CTRL_YAW, ctrlSignals.yawMoment);
+}
+
+/*
+ * @brief  Sets the Flight Mode - requests the mode of the receiver mode ranges from the flight mode state machine,
+ *         which guards the transitions, see flight_mode.h.
+ * @param  None.
+ * @retval Exit and entry actions of the transition taken, FLIGHT_MODE_ACTION_* bits, 0 if the mode did not change
+ */
+static uint8_t UpdateFlightMode(void) {
+	FlightModeRequestType request;
+	FlightModeTransitionType transition;
+
+	request.isReceiverActive = (RECEIVER_OK == receiverSnapshot.IsActive);
+	request.isThrottleLow = receiverSnapshot.Throttle
+			< INT16_MIN + (int32_t) (FLIGHT_MODE_ARMING_MAX_THROTTLE*UINT16_MAX);
+#if defined(MOTOR_ESC_TELEMETRY) && defined(FCB_MOTOR_FAILURE_DETECTION)
+	/* The degraded mode flies on without the failed motor */
+	request.isEscFault = IsEscFault() && !IsMotorFailureDetected();
+#elif defined(MOTOR_ESC_TELEMETRY)
+	request.isEscFault = IsEscFault();
+#else
+	request.isEscFault = false;
+#endif
+#ifdef FCB_CRASH_DETECTION
+	request.isCrash = IsCrashDetected();
+#else
+	request.isCrash = false;
+#endif
+
+	/* A stabilized mode not built in is requested as the one set by SetStabilizedFlightMode() */
+	switch (receiverSnapshot.Mode) {
+	case RECEIVER_MODE_RAW:
+		request.state = FLIGHT_MODE_RAW;
+		break;
+	case RECEIVER_MODE_ATTITUDE:
+		request.state = FLIGHT_MODE_ATTITUDE;
+		break;
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+	case RECEIVER_MODE_RATE:
+		request.state = FLIGHT_MODE_RATE;
+		break;
+#endif
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+	case RECEIVER_MODE_ALTITUDE_HOLD:
+		request.state = FLIGHT_MODE_ALTITUDE_HOLD;
+		break;
+#endif
+	case RECEIVER_MODE_AUTONOMOUS:
+		request.state = FLIGHT_MODE_AUTONOMOUS;
+		break;
+	case RECEIVER_MODE_NONE:
+	case RECEIVER_MODE_ARM:
+		request.state = FLIGHT_MODE_DISARMED;
+		break;
+	default:
+		request.state = GetFlightModeStateOfControlMode(stabilizedFlightMode);
+		break;
+	}
+
+	if (!UpdateFlightModeState(&request, &transition)) {
+		return 0;
+	}
+
+	flightControlMode = GetFlightModeControlMode(transition.to);
+
+	return transition.actions;
+}
+
+/*
+ * @brief  Reads the latest receiver snapshot. A new RC frame starts an RC frame latency measurement, which the next
+ *         motor output completes.
+ * @param  None
+ * @retval true if the snapshot is of a new RC frame, else false
+ */
+static bool ReadReceiverSnapshot(void) {
+	uint32_t previousSequence = receiverSnapshot.Sequence;
+#ifdef FLIGHT_CONTROL_RC_INTERPOLATION
+	uint32_t previousFrameTimestamp = receiverSnapshot.FrameTimestamp;
+#endif
+
+	GetReceiverSnapshot(&receiverSnapshot);
+	if (receiverSnapshot.Sequence == previousSequence) {
+		return false;
+	}
+
+#ifdef FLIGHT_CONTROL_RC_INTERPOLATION
+	if (receiverSnapshot.Sequence == previousSequence + 1) {
+		receiverFramePeriod = receiverSnapshot.FrameTimestamp - previousFrameTimestamp;
 	} else {
-		refSignals.pitchAngle = -refSignalsLimits.pitchAngle*(elevator + RECEIVER_TO_REFERENCE_ZERO_PADDING)
-				/ (-INT16_MIN - RECEIVER_TO_REFERENCE_ZERO_PADDING);
+		receiverFramePeriod = 0;
 	}
+#endif
+
+	RcSmoothingNewFrame(receiverSnapshot.FrameTimestamp, receiverSnapshot.Sequence == previousSequence + 1);
+	LatencyMonitorBeginRcFrame(receiverSnapshot.FrameTimestamp);
+
+	return true;
+}
+
+/*
+ * @brief  Sets the reference values based on RC receiver input. This sets the limits for maximum pilot input.
+ * @param  None
+ * @retval None
+ */
+static RAMFUNC void SetRefSignals(void) {
+	PROFILE_SCOPE(PROFILE_PROBE_REF_SIGNALS);
+	int32_t throttle, aileron, elevator, rudder;
+	float32_t refs[STICK_AXIS_NBR];
+
+	throttle = receiverSnapshot.Throttle;
+	aileron = receiverSnapshot.Aileron;
+	elevator = receiverSnapshot.Elevator;
+	rudder = receiverSnapshot.Rudder;
+
+	/* Set Z velocity reference depending on receiver throttle channel, negative sign because Z points downwards */
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+	refSignals.zVelocity = -refSignalsLimits.zVelocity*ApplyStickCurve(STICK_AXIS_THROTTLE, throttle);
+#else
+	(void) throttle;
+	refSignals.zVelocity = 0.0;
+#endif
+
+	/* Set roll and pitch angle references depending on receiver aileron and elevator channels */
+	refSignals.rollAngle = -refSignalsLimits.rollAngle*ApplyStickCurve(STICK_AXIS_ROLL, aileron);
+	refSignals.pitchAngle = -refSignalsLimits.pitchAngle*ApplyStickCurve(STICK_AXIS_PITCH, elevator);
 
     /* Set yaw reference depending on receiver rudder channel */
 	// TODO Use yaw angle reference instead of yaw rate ref? Should be able to go between (-180, 180] degrees
 	// Needs special handling, should not have a zero padding zone but should perhaps have some padding relative
 	// to the current
-//    if (rudder <= RECEIVER_TO_REFERENCE_ZERO_PADDING && rudder >= -RECEIVER_TO_REFERENCE_ZERO_PADDING) {
-//        refSignals.yawAngle = 0.0;
-//    } else if (rudder >= 0) {
-//        refSignals.yawAngle = -refSignalsLimits.yawAngle*(rudder - RECEIVER_TO_REFERENCE_ZERO_PADDING)
-//                / (INT16_MAX - RECEIVER_TO_REFERENCE_ZERO_PADDING);
-//    } else {
-//        refSignals.yawAngle = -refSignalsLimits.yawAngle*(rudder + RECEIVER_TO_REFERENCE_ZERO_PADDING)
-//                / (-INT16_MIN - RECEIVER_TO_REFERENCE_ZERO_PADDING);
-//    }
 
 	/* Set yaw rate reference depending on receiver rudder channel */
-	if (rudder <= RECEIVER_TO_REFERENCE_ZERO_PADDING && rudder >= -RECEIVER_TO_REFERENCE_ZERO_PADDING) {
-		refSignals.yawAngleRate = 0.0;
-	} else if (rudder >= 0) {
-		refSignals.yawAngleRate = -refSignalsLimits.yawAngleRate*(rudder - RECEIVER_TO_REFERENCE_ZERO_PADDING)
-				/ (INT16_MAX - RECEIVER_TO_REFERENCE_ZERO_PADDING);
-	} else {
-		refSignals.yawAngleRate = -refSignalsLimits.yawAngleRate*(rudder + RECEIVER_TO_REFERENCE_ZERO_PADDING)
-				/ (-INT16_MIN - RECEIVER_TO_REFERENCE_ZERO_PADDING);
-	}
+	refSignals.yawAngleRate = -refSignalsLimits.yawAngleRate*ApplyStickCurve(STICK_AXIS_YAW, rudder);
 
-	/* Go to "safe" reference signal values if receiver transmission becomes inactive */
-	if(RECEIVER_OK != IsReceiverActive()) {
+	/* Go to "safe" reference signal values if receiver transmission becomes inactive, at once */
+	if(RECEIVER_OK != receiverSnapshot.IsActive) {
 	    refSignals.rollAngle = 0.0;
 	    refSignals.pitchAngle = 0.0;
 	    refSignals.yawAngleRate = 0.0;
 	    refSignals.zVelocity = 0.0;
+	    RcSmoothingReset(zeroStickRefs);
+	    return;
 	}
+
+	/* Smooth the steps of the RC frames into the control rate, this delays the references, see rc_smoothing.h */
+	refs[STICK_AXIS_THROTTLE] = refSignals.zVelocity;
+	refs[STICK_AXIS_ROLL] = refSignals.rollAngle;
+	refs[STICK_AXIS_PITCH] = refSignals.pitchAngle;
+	refs[STICK_AXIS_YAW] = refSignals.yawAngleRate;
+	RcSmoothingApply(refs, flightControlSamplePeriod);
+	refSignals.zVelocity = refs[STICK_AXIS_THROTTLE];
+	refSignals.rollAngle = refs[STICK_AXIS_ROLL];
+	refSignals.pitchAngle = refs[STICK_AXIS_PITCH];
+	refSignals.yawAngleRate = refs[STICK_AXIS_YAW];
 }
 
+/*
+ * @brief  Sets the reference values from the latest FMS setpoint, limited like the pilot input.
+ * @param  None
+ * @retval true if set, false if there is no recent FMS setpoint
+ */
+static bool SetFmsRefSignals(void) {
+	FmsSetpoint_TypeDef setpoint;
+
+	if (FMS_LINK_OK != GetFmsSetpoint(&setpoint, FMS_SETPOINT_TIMEOUT)) {
+		return false;
+	}
+
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+	refSignals.zVelocity = LIMIT_SYMMETRIC(setpoint.refSignals.zVelocity, refSignalsLimits.zVelocity);
+#else
+	refSignals.zVelocity = 0.0;
+#endif
+	refSignals.rollAngle = LIMIT_SYMMETRIC(setpoint.refSignals.rollAngle, refSignalsLimits.rollAngle);
+	refSignals.pitchAngle = LIMIT_SYMMETRIC(setpoint.refSignals.pitchAngle, refSignalsLimits.pitchAngle);
+	refSignals.yawAngle = LIMIT_SYMMETRIC(setpoint.refSignals.yawAngle, refSignalsLimits.yawAngle);
+	refSignals.yawAngleRate = LIMIT_SYMMETRIC(setpoint.refSignals.yawAngleRate, refSignalsLimits.yawAngleRate);
+
+	return true;
+}
+
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+/*
+ * @brief  Adds the altitude hold correction to the Z velocity reference of SetRefSignals(). While the throttle stick
+ *         commands a climb rate the held altitude moves along with the UAV, so the correction stays zero and the
+ *         altitude where the stick is centered again is the one held.
+ * @param  None
+ * @retval None
+ */
+static void SetAltitudeHoldRefSignals(void) {
+	if (0.0f != refSignals.zVelocity) {
+		altitudeHoldRef = GetZPosition();
+	}
+
+	refSignals.zVelocity = LIMIT_SYMMETRIC(refSignals.zVelocity + UpdatePIDAltitudeControl(altitudeHoldRef),
+			refSignalsLimits.zVelocity);
+}
+
+/*
+ * @brief  Checks if a flight mode sets the thrust with the Z velocity controller
+ * @param  mode : Flight mode
+ * @retval true if it does, else false
+ */
+static bool IsVerticalVelocityControlMode(const enum FlightControlMode mode) {
+	return FLIGHT_CONTROL_PID == mode || FLIGHT_CONTROL_AUTONOMOUS == mode || FLIGHT_CONTROL_ALTITUDE_HOLD == mode;
+}
+#endif
+
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+/*
+ * @brief  Sets the body rate references of the rate flight mode based on RC receiver input.
+ * @param  None
+ * @retval None
+ */
+static void SetRateModeRefSignals(void) {
+#ifdef FLIGHT_CONTROL_RC_INTERPOLATION
+	uint8_t i;
+
+	for (i = 0; i < 3; i++) {
+		rateModeRefsFrom[i] = rateModeRefs[i];
+	}
+	rateModeRefsTo[ROLL_IDX] = ReceiverToReferenceSignal(STICK_AXIS_ROLL, receiverSnapshot.Aileron,
+			RATE_MODE_MAX_ROLLPITCH_RATE);
+	rateModeRefsTo[PITCH_IDX] = ReceiverToReferenceSignal(STICK_AXIS_PITCH, receiverSnapshot.Elevator,
+			RATE_MODE_MAX_ROLLPITCH_RATE);
+	rateModeRefsTo[YAW_IDX] = ReceiverToReferenceSignal(STICK_AXIS_YAW, receiverSnapshot.Rudder,
+			RATE_MODE_MAX_YAW_RATE);
+
+	/* Ramp over the measured frame period, a missed frame or a long gap steps to the new references */
+	rateModeRefsRampStart = GetTimestamp();
+	if (receiverFramePeriod <= SystemCoreClock / 1000 * FLIGHT_CONTROL_RC_INTERPOLATION_MAX_PERIOD) {
+		rateModeRefsRampPeriod = receiverFramePeriod;
+	} else {
+		rateModeRefsRampPeriod = 0;
+	}
+
+	InterpolateRateModeRefSignals();
+#else
+	rateModeRefs[ROLL_IDX] = ReceiverToReferenceSignal(STICK_AXIS_ROLL, receiverSnapshot.Aileron,
+			RATE_MODE_MAX_ROLLPITCH_RATE);
+	rateModeRefs[PITCH_IDX] = ReceiverToReferenceSignal(STICK_AXIS_PITCH, receiverSnapshot.Elevator,
+			RATE_MODE_MAX_ROLLPITCH_RATE);
+	rateModeRefs[YAW_IDX] = ReceiverToReferenceSignal(STICK_AXIS_YAW, receiverSnapshot.Rudder,
+			RATE_MODE_MAX_YAW_RATE);
+#endif
+}
+
+/*
+ * @brief  Resets the body rate references of the rate flight mode
+ * @param  None
+ * @retval None
+ */
+static void ResetRateModeRefSignals(void) {
+	uint8_t i;
+
+	for (i = 0; i < 3; i++) {
+		rateModeRefs[i] = 0.0;
+#ifdef FLIGHT_CONTROL_RC_INTERPOLATION
+		rateModeRefsFrom[i] = 0.0;
+		rateModeRefsTo[i] = 0.0;
+#endif
+	}
+}
+
+#ifdef FLIGHT_CONTROL_RC_INTERPOLATION
+/*
+ * @brief  Moves the body rate references of the rate flight mode along the ramp to the latest RC frame
+ * @param  None
+ * @retval None
+ */
+static void InterpolateRateModeRefSignals(void) {
+	uint32_t elapsed = GetTimestamp() - rateModeRefsRampStart;
+	float32_t fraction;
+	uint8_t i;
+
+	if (0 == rateModeRefsRampPeriod || elapsed >= rateModeRefsRampPeriod) {
+		fraction = 1.0;
+	} else {
+		fraction = (float32_t) elapsed / (float32_t) rateModeRefsRampPeriod;
+	}
+
+	for (i = 0; i < 3; i++) {
+		rateModeRefs[i] = rateModeRefsFrom[i] + fraction*(rateModeRefsTo[i] - rateModeRefsFrom[i]);
+	}
+}
+#endif
+#endif
+
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+/*
+ * @brief  Maps a receiver channel value to a reference signal with the stick curve of its axis, with the same sign
+ *         convention as SetRefSignals().
+ * @param  axis : Stick axis of the channel
+ * @param  receiverValue : Receiver channel value
+ * @param  maxRefSignal : Reference signal at full stick deflection
+ * @retval Reference signal
+ */
+static float32_t ReceiverToReferenceSignal(const StickAxisType axis, const int32_t receiverValue,
+		const float32_t maxRefSignal) {
+	return -maxRefSignal*ApplyStickCurve(axis, receiverValue);
+}
+#endif
+
+#ifdef FCB_WCET_TEST
+/*
+ * @brief  Sets the reference signals to their limits, alternating in sign each update, so that the controllers and
+ *         the mixer desaturation stay saturated. The thrust is that of the receiver throttle, as in PID mode.
+ * @param  None.
+ * @retval None.
+ */
+static void SetWcetTestRefSignals(void) {
+	static float32_t sign = 1.0f;
+
+	sign = -sign;
+	refSignals.zVelocity = sign*refSignalsLimits.zVelocity;
+	refSignals.rollAngle = sign*refSignalsLimits.rollAngle;
+	refSignals.pitchAngle = sign*refSignalsLimits.pitchAngle;
+	refSignals.yawAngle = sign*refSignalsLimits.yawAngle;
+	refSignals.yawAngleRate = sign*refSignalsLimits.yawAngleRate;
+}
+#endif
+
 void SendFlightControlUpdateToFlightControl(void)
 {
-    FlightControlMsg_TypeDef msg;
-    msg.type = FLIGHT_CONTROL_UPDATE;
-    portBASE_TYPE higherPriorityTaskWoken = pdFALSE;
+    SetFlightControlEventFromISR(FLIGHT_CONTROL_EVENT_UPDATE_BIT);
+}
 
-    if (pdTRUE != xQueueSendFromISR(qFlightControl, &msg, &higherPriorityTaskWoken)) {
-        ErrorHandler();
+void SendPredictionUpdateToFlightControl(void)
+{
+    SetFlightControlEventFromISR(FLIGHT_CONTROL_EVENT_PREDICTION_BIT);
+}
+
+void SendReceiverFailsafeToFlightControl(void)
+{
+    /* The receiver watchdog starts before the flight control task is created */
+    if (NULL == semFlightControl) {
+        return;
     }
+    SetFlightControlEventFromISR(FLIGHT_CONTROL_EVENT_FAILSAFE_BIT);
 }
 
-void SendPredictionUpdateToFlightControl(void)
+/*
+ * @brief  Has the flight control task initialize the state estimation again from the next sensor samples, as at the
+ *         startup. Waits for idle mode if not in it, the flight control does not update in the meantime.
+ * @param  None
+ * @retval None
+ */
+void ReinitStateEstimation(void)
 {
-    FlightControlMsg_TypeDef msg;
-    msg.type = PREDICTION_UPDATE;
-    portBASE_TYPE higherPriorityTaskWoken = pdFALSE;
+    taskENTER_CRITICAL();
+    flightControlEventsPending |= FLIGHT_CONTROL_EVENT_INIT_BIT;
+    taskEXIT_CRITICAL();
 
-    if (pdTRUE != xQueueSendFromISR(qFlightControl, &msg, &higherPriorityTaskWoken)) {
-        ErrorHandler();
+    /* fails harmlessly if already given - the task then handles this event on the pending wake-up */
+    xSemaphoreGive(semFlightControl);
+}
+
+void SendCorrectionUpdateToFlightControl(FcbSensorIndexType sensorType, float32_t xyz[3], uint32_t timestamp)
+{
+#ifdef FCB_HIL_MODE
+    /* The simulator provides the samples, the physical ones are dropped */
+    if (HilModeIsActive()) {
+        return;
     }
+#endif
+
+    PostSensorSample(sensorType, xyz, timestamp);
 }
 
-void SendCorrectionUpdateToFlightControl(FcbSensorIndexType sensorType, float32_t xyz[3])
+#ifdef FCB_HIL_MODE
+void SendSimulatedSampleToFlightControl(FcbSensorIndexType sensorType, float32_t xyz[3], uint32_t timestamp)
 {
-    FlightControlMsg_TypeDef msg;
-    msg.type = CORRECTION_UPDATE;
-    msg.sensorReading.sensorType = sensorType;
-    memcpy(msg.sensorReading.xyz, xyz, sizeof(float32_t)*3);
-    portBASE_TYPE higherPriorityTaskWoken = pdFALSE;
+    PostSensorSample(sensorType, xyz, timestamp);
+}
+#endif
 
-    if (pdTRUE != xQueueSendFromISR(qFlightControl, &msg, &higherPriorityTaskWoken)) {
-        ErrorHandler();
+/*
+ * @brief  Posts a sensor sample to the flight control mailbox and wakes the flight control task
+ * @param  sensorType : Sensor of the sample
+ * @param  xyz : Sample, see SendCorrectionUpdateCallback_TypeDef
+ * @param  timestamp : Time the sample was taken [core clock cycles]
+ * @retval None
+ */
+static void PostSensorSample(FcbSensorIndexType sensorType, float32_t xyz[3], uint32_t timestamp)
+{
+    if (sensorType >= FCB_SENSOR_NBR) {
+        return;
+    }
+
+    /* Called from the SENSORS task, or the com RX work item in HIL mode. A sample the flight control task has not
+     * fetched yet is overwritten. */
+    taskENTER_CRITICAL();
+    if (flightControlEventsPending & (1 << sensorType)) {
+        BufferStatsRecordFull(&sensorMailboxStats);
+        SENSOR_LOAD_TEST_COUNT_DROP(SENSOR_LOAD_DROP_MAILBOX);
+    } else {
+        BufferStatsRecordLevel(&sensorMailboxStats,
+                1 + __builtin_popcount(flightControlEventsPending & ((1 << FCB_SENSOR_NBR) - 1)));
     }
+    memcpy(sensorMailbox[sensorType].xyz, xyz, sizeof(float32_t)*3);
+    sensorMailbox[sensorType].timestamp = timestamp;
+    sensorMailbox[sensorType].fetchTimestamp = GetTimestamp();
+    flightControlEventsPending |= 1 << sensorType;
+#ifdef FCB_FUSED_SENSOR_PIPELINE
+    if (isPipelineFused) {
+        /* RunFusedFlightControl() fetches it in this task, there is no hand-over to measure or wake up */
+        taskEXIT_CRITICAL();
+        return;
+    }
+#endif
+    if (GYRO_IDX == sensorType) {
+        WakeLatencySignal(WAKE_LATENCY_SENSORS_TO_FLIGHT, sensorMailbox[sensorType].fetchTimestamp);
+    }
+    taskEXIT_CRITICAL();
+
+    /* fails harmlessly if already given - the task then handles this sample on the pending wake-up */
+    xSemaphoreGive(semFlightControl);
 }
 
+#ifdef FCB_FUSED_SENSOR_PIPELINE
+/*
+ * @brief  Runs the flight control on the pending samples and events from the SENSORS task, once the flight control
+ *         task has initialized the state estimation and handed over. Called right after the gyroscope fetch, so that
+ *         the prediction, correction, control and motor update follow it without a task switch, and again after
+ *         the slower sensors. The interrupt events, e.g. the receiver failsafe, are handled with the next gyroscope
+ *         sample, at most one gyroscope sample period later.
+ * @param  None
+ * @retval None
+ */
+void RunFusedFlightControl(void) {
+    sensorReading_TypeDef readings[FCB_SENSOR_NBR];
+    uint32_t events;
+
+    if (!isPipelineFused) {
+        return;
+    }
+
+    if (0 != (events = FetchFlightControlEvents(readings))) {
+        ProcessFlightControlEvents(events, readings);
+    }
+}
+#endif
+
+/*
+ * @brief  Initializes the state estimation from the first sensor samples. If a warm start state is stored in flash
+ *         and the UAV is at rest, the stored gyroscope biases & error covariances are used and fewer accelerometer and
+ *         magnetometer samples are needed, else the estimator converges from its default state. If the gyroscope
+ *         readings are steady over the startup window, their mean seeds the gyroscope biases and is added to the
+ *         gyroscope bias vs temperature table.
+ * @param  None
+ * @retval None
+ */
 void initKalmanFiler(void) {
-    float32_t startupSensorValues[3];
-    uint32_t nbrOfSamples[3] = {0, 0, 0};
-	FlightControlMsg_TypeDef msg;
+    StateWarmStartType warmStart;
+    SensorNoiseType sensorNoise;
+    float32_t startupSensorValues[3] = {0.0, 0.0, 0.0};
+    float32_t gyroMean[3] = {0.0, 0.0, 0.0};
+    float32_t gyroSquaredDeviationSum[3] = {0.0, 0.0, 0.0};
+    float32_t accNormSquared, deviation;
+    uint32_t nbrOfSamples[FCB_SENSOR_NBR] = {0, 0, 0, 0};
+    uint32_t stationaryGyroSamples = (uint32_t) STATE_STATIONARY_GYRO_WINDOW * GyroDataRateHz() / 1000;
+    uint32_t accSamplesNeeded = 5, magSamplesNeeded = 5, gyroSamplesNeeded = stationaryGyroSamples;
+    uint8_t useWarmStart = 0;
+    uint8_t isAccAtRest = 1;
+    uint8_t isStationary;
+    uint8_t i;
+    sensorReading_TypeDef readings[FCB_SENSOR_NBR];
+    uint32_t events;
+
+	if (FLASH_OK == ReadStateWarmStartFromFlash(&warmStart)) {
+	    useWarmStart = 1;
+	    accSamplesNeeded = 2;
+	    magSamplesNeeded = 1;
+	    gyroSamplesNeeded = stationaryGyroSamples > STATE_WARM_START_GYRO_SAMPLES ? stationaryGyroSamples
+	            : STATE_WARM_START_GYRO_SAMPLES;
+	}
 
 	// Get some samples from accelerometer and magnetometer to be used as start values for Kalman filter.
-    while (nbrOfSamples[ACC_IDX] < 5 && nbrOfSamples[MAG_IDX] < 5) {
-    	xQueueReceive(qFlightControl, &msg,  FLIGHT_CONTROL_QUEUE_TIMEOUT);
-
-    	switch (msg.sensorReading.sensorType) {
-//    	case GYRO_IDX:
-//    		gotFirstSensorSamples &= GOT_GYRO_SENSOR_SAMPLE;
-//    		break;
-    	case ACC_IDX:
-    		startupSensorValues[0] = msg.sensorReading.xyz[0];
-    		startupSensorValues[1] = msg.sensorReading.xyz[1];
+    while (nbrOfSamples[ACC_IDX] < accSamplesNeeded || nbrOfSamples[MAG_IDX] < magSamplesNeeded
+            || nbrOfSamples[GYRO_IDX] < gyroSamplesNeeded) {
+    	events = WaitForFlightControlEvents(readings);
+    	TaskWatchdogCheckIn(TASK_WATCHDOG_FLIGHT_CONTROL);
+
+    	if (events & (1 << GYRO_IDX)) {
+    	    /* At rest the gyroscope reads its bias, otherwise the UAV is moving and the stored state is not used */
+    	    for (i = 0; useWarmStart && i < 3; i++) {
+    	        if (fabsf(readings[GYRO_IDX].xyz[i] - warmStart.angleRateBias[i]) > STATE_WARM_START_MAX_GYRO_DEVIATION) {
+    	            useWarmStart = 0;
+    	        }
+    	    }
+    	    nbrOfSamples[GYRO_IDX]++;
+
+    	    /* Running mean and sum of squared deviations (Welford), for the variance gate of the stationary window */
+    	    if (nbrOfSamples[GYRO_IDX] <= stationaryGyroSamples) {
+    	        for (i = 0; i < 3; i++) {
+    	            deviation = readings[GYRO_IDX].xyz[i] - gyroMean[i];
+    	            gyroMean[i] += deviation / nbrOfSamples[GYRO_IDX];
+    	            gyroSquaredDeviationSum[i] += deviation * (readings[GYRO_IDX].xyz[i] - gyroMean[i]);
+    	        }
+    	    }
+    	}
+    	if (events & (1 << ACC_IDX)) {
+    	    arm_dot_prod_f32(readings[ACC_IDX].xyz, readings[ACC_IDX].xyz, 3, &accNormSquared);
+    	    if (accNormSquared < G_ACC*G_ACC*(1.0f-STATE_WARM_START_ACC_NORM_TOLERANCE)*(1.0f-STATE_WARM_START_ACC_NORM_TOLERANCE)
+    	            || accNormSquared > G_ACC*G_ACC*(1.0f+STATE_WARM_START_ACC_NORM_TOLERANCE)*(1.0f+STATE_WARM_START_ACC_NORM_TOLERANCE)) {
+    	        useWarmStart = 0;
+    	        isAccAtRest = 0;
+    	    }
+    	    GetAttitudeFromAccelerometer(startupSensorValues, readings[ACC_IDX].xyz);
     		nbrOfSamples[ACC_IDX]++;
-    		break;
-    	case MAG_IDX:
-    		if (nbrOfSamples[ACC_IDX]) {
-    			startupSensorValues[2] = GetMagYawAngle(msg.sensorReading.xyz, startupSensorValues[0], startupSensorValues[1]);
-    			nbrOfSamples[MAG_IDX]++;
-    		}
-    		break;
-    	default:
-			break;
     	}
+    	if ((events & (1 << MAG_IDX)) && nbrOfSamples[ACC_IDX]) {
+    		startupSensorValues[2] = GetMagYawAngle(readings[MAG_IDX].xyz, startupSensorValues[0], startupSensorValues[1])
+    		        + GetMagDeclination();
+    		toMaxRadian(&startupSensorValues[2]);
+    		nbrOfSamples[MAG_IDX]++;
+    	}
+
+    	/* Not at rest, fall back to waiting for the cold start samples */
+    	if (!useWarmStart) {
+    	    accSamplesNeeded = 5;
+    	    magSamplesNeeded = 5;
+    	    gyroSamplesNeeded = stationaryGyroSamples;
+    	}
+    }
+
+    isStationary = isAccAtRest && stationaryGyroSamples > 1;
+    for (i = 0; isStationary && i < 3; i++) {
+        if (!(gyroSquaredDeviationSum[i] / (stationaryGyroSamples - 1) < STATE_STATIONARY_GYRO_MAX_VARIANCE)) {
+            isStationary = 0;
+        }
+    }
+
+#ifdef FCB_GYRO_SYNCHRONOUS_PIPELINE
+    /* Predicted once per gyroscope sample, the gyroscope data rate is measured over the startup samples */
+    if (GetSensorDataRateHz(GYRO_IDX) > 0.0f) {
+        flightControlSamplePeriod = 1.0f/GetSensorDataRateHz(GYRO_IDX);
     }
+#endif
 
-    /* Init the states for the Kalman filter */
+    /* Init the states for the Kalman filter, with the measurement noise of the stored characterisation */
+    if (FLASH_OK == ReadSensorNoiseFromFlash(&sensorNoise)) {
+        SeedSensorNoise(&sensorNoise);
+    }
     InitStatesXYZ(startupSensorValues);
-    InitStateEstimationTimeEvent();
+    if (useWarmStart) {
+        WarmStartStates(&warmStart);
+    }
+    if (isStationary && FCB_OK == SeedGyroBiases(gyroMean)) {
+        AddGyroTempCompensationPoint(gyroMean);
+    }
+    PublishStateSnapshot();
+    ESTIMATOR_LOG_INIT();
+}
+
+/*
+ * @brief  Saves the current gyroscope biases & error covariances to flash as warm start for the next boot
+ * @note   Flash erase/write halts the CPU, so this is only allowed in idle mode (i.e. on the ground)
+ * @param  None
+ * @retval FCB_OK if saved, else FCB_ERR
+ */
+FcbRetValType SaveStateWarmStart(void) {
+    StateWarmStartType warmStart;
+
+    if (FLIGHT_CONTROL_IDLE != GetFlightControlMode() || FCB_OK != GetStateWarmStart(&warmStart)) {
+        return FCB_ERR;
+    }
+
+    if (FLASH_OK != WriteStateWarmStartToFlash(&warmStart)) {
+        return FCB_ERR;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Saves the result of the latest sensor noise characterisation to flash, whose measurement noise seeds the
+ *         estimator from the next boot
+ * @note   Flash erase/write halts the CPU, so this is only allowed in idle mode (i.e. on the ground)
+ * @param  None
+ * @retval FCB_OK if saved, else FCB_ERR
+ */
+FcbRetValType SaveSensorNoise(void) {
+    SensorNoiseType sensorNoise;
+
+    if (FLIGHT_CONTROL_IDLE != GetFlightControlMode() || SENSOR_NOISE_DONE != GetSensorNoise(&sensorNoise)) {
+        return FCB_ERR;
+    }
+
+    if (FLASH_OK != WriteSensorNoiseToFlash(&sensorNoise)) {
+        return FCB_ERR;
+    }
+
+    return FCB_OK;
 }
 
 void setMaxLimitForReferenceSignal(float32_t maxZVelocity, float32_t maxRollAngle, float32_t maxPitchAngle, float32_t maxYawAngleRate) {
@@ -476,6 +1411,73 @@ void getMaxLimitForReferenceSignal(float32_t* maxZVelocity, float32_t* maxRollAn
 	*maxYawAngleRate = refSignalsLimits.yawAngleRate;
 }
 
+/*
+ * @brief  Sets the reference limits without storing them, effective from the next control cycle. The yaw angle limit is
+ *         fixed.
+ * @param  limits : Max Z velocity [m/s], roll and pitch angles [rad] and yaw rate [rad/s]
+ * @retval FCB_OK if set, FCB_ERR if a limit is out of the range of its parameter
+ */
+FcbRetValType SetReferenceMaxLimits(const RefSignals_TypeDef* limits) {
+	if (!(limits->zVelocity >= 0.0f && limits->zVelocity <= REF_LIMIT_PARAM_MAX_Z_VELOCITY)
+			|| !(limits->rollAngle >= 0.0f && limits->rollAngle <= REF_LIMIT_PARAM_MAX_ROLLPITCH_ANGLE)
+			|| !(limits->pitchAngle >= 0.0f && limits->pitchAngle <= REF_LIMIT_PARAM_MAX_ROLLPITCH_ANGLE)
+			|| !(limits->yawAngleRate >= 0.0f && limits->yawAngleRate <= REF_LIMIT_PARAM_MAX_YAW_RATE)) {
+		return FCB_ERR;
+	}
+
+	FCB_SUSPEND_SCHEDULER();
+	refSignalsLimits.zVelocity = limits->zVelocity;
+	refSignalsLimits.rollAngle = limits->rollAngle;
+	refSignalsLimits.pitchAngle = limits->pitchAngle;
+	refSignalsLimits.yawAngle = DEFAULT_MAX_YAW_ANGLE;
+	refSignalsLimits.yawAngleRate = limits->yawAngleRate;
+	FCB_RESUME_SCHEDULER();
+
+	return FCB_OK;
+}
+
+/*
+ * @brief  Gets the reference limits
+ * @param  limits : Destination of the limits
+ * @retval None.
+ */
+void GetReferenceMaxLimits(RefSignals_TypeDef* limits) {
+	FCB_SUSPEND_SCHEDULER();
+	*limits = refSignalsLimits;
+	FCB_RESUME_SCHEDULER();
+}
+
+/*
+ * @brief  Gets the reference limit parameters, for the parameter table
+ * @param  None.
+ * @retval The parameter group
+ */
+const ParamGroup_TypeDef* GetReferenceLimitParamGroup(void) {
+	return &refLimitParamGroup;
+}
+
+/*
+ * @brief  Saves the current reference limits to flash, from where they are loaded at startup
+ * @param  None.
+ * @retval FCB_OK if saved, FCB_ERR if writing the flash failed
+ */
+static FcbRetValType SaveReferenceMaxLimits(void) {
+	if (FLASH_OK != WriteReferenceMaxLimitsToFlash(&refSignalsLimits)) {
+		return FCB_ERR;
+	}
+
+	return FCB_OK;
+}
+
+/*
+ * @brief  Checks the flight control task in with the task watchdog
+ * @param  None.
+ * @retval None.
+ */
+static void IndicateFlightControlAlive(void) {
+	TaskWatchdogCheckIn(TASK_WATCHDOG_FLIGHT_CONTROL);
+}
+
 /**
  * @brief  Flight control task function
  * @param  argument : Unused parameter
@@ -484,8 +1486,6 @@ void getMaxLimitForReferenceSignal(float32_t* maxZVelocity, float32_t* maxRollAn
 static void FlightControlTask(void const *argument) {
 	(void) argument;
 
-	uint32_t ledFlashCounter = 0;
-
     if (SensorRegisterAccClientCallback(SendCorrectionUpdateToFlightControl)) {
     	ErrorHandler();
     }
@@ -499,43 +1499,270 @@ static void FlightControlTask(void const *argument) {
 	if (FLASH_OK != ReadReferenceMaxLimitsFromFlash(&refSignalsLimits)) {
 		setMaxLimitForReferenceSignalToDefault();
 	}
+	InitStickCurves();
+	InitRcSmoothing();
+	InitEstimatorNoise();
+	InitMagHeading();
+	InitParamProfiles();
+#ifdef FCB_CRASH_DETECTION
+	InitCrashDetection();
+#endif
+#ifdef FCB_MOTOR_FAILURE_DETECTION
+	InitMotorFailureDetection();
+#endif
+	if (FCB_OK != FlightModeInit()) {
+		ErrorHandler();
+	}
+
+    flightControlSamplePeriod = FLIGHT_CONTROL_SAMPLE_PERIOD;
 
     initKalmanFiler();
+#ifndef FCB_GYRO_SYNCHRONOUS_PIPELINE
+    InitStateEstimationTimeEvent();
+#endif
+    BootTimingMark(BOOT_PHASE_ESTIMATOR_INIT);
+
+    SetLoopDeadlines();
+
+    /* The control cycles check in, from the SENSORS task when the pipeline is fused */
+    TaskWatchdogRegister(TASK_WATCHDOG_FLIGHT_CONTROL);
+
+#ifdef FCB_FUSED_SENSOR_PIPELINE
+    /* From here on the SENSORS task runs the flight control, see RunFusedFlightControl(). Suspended instead of
+     * deleted, as the stack may be a static CCM RAM buffer that FreeRTOS would free to the heap. */
+    taskENTER_CRITICAL();
+    isPipelineFused = true;
+    taskEXIT_CRITICAL();
+    vTaskSuspend(NULL);
+#endif
 
 	for (;;) {
-        FlightControlMsg_TypeDef msg;
+        sensorReading_TypeDef readings[FCB_SENSOR_NBR];
+        uint32_t events;
 
-        if (pdFALSE == xQueueReceive(qFlightControl, &msg,  FLIGHT_CONTROL_QUEUE_TIMEOUT)) {
+        if (0 == (events = WaitForFlightControlEvents(readings))) {
             /*
-             * if no message was received, interrupts from the sensors
+             * if no event was received, interrupts from the sensors
              * aren't arriving and this is a serious error.
              */
             ErrorHandler();
         }
 
-        switch (msg.type) {
-        case PREDICTION_UPDATE:
-            UpdatePredictionState();
-            // break;
-        case FLIGHT_CONTROL_UPDATE:
-            /* Perform flight control activities */
+        ProcessFlightControlEvents(events, readings);
+    }
+}
+
+/*
+ * @brief  Handles the fetched flight control events: the sensor corrections, the prediction and the flight control
+ *         update in that order
+ * @param  events : Pending event bits
+ * @param  readings : Sensor samples, the entries with their pending bit set are valid
+ * @retval None
+ */
+static void ProcessFlightControlEvents(const uint32_t events, sensorReading_TypeDef readings[FCB_SENSOR_NBR]) {
+    uint8_t sensor;
+
+    /* The init takes the following samples itself, the other events are dropped until it is done */
+    if (events & FLIGHT_CONTROL_EVENT_INIT_BIT) {
+        if (FLIGHT_CONTROL_IDLE == flightControlMode) {
+            /* the gyroscope data rate may have changed, see fcb_sensor_timing.h */
+            flightControlSamplePeriod = FLIGHT_CONTROL_SAMPLE_PERIOD;
+            initKalmanFiler();
+            SetLoopDeadlines();
+            return;
+        }
+        taskENTER_CRITICAL();
+        flightControlEventsPending |= FLIGHT_CONTROL_EVENT_INIT_BIT;
+        taskEXIT_CRITICAL();
+    }
+
+    /* Corrections first, so that the flight control update below uses the newest estimate */
+    for (sensor = 0; sensor < FCB_SENSOR_NBR; sensor++) {
+        if (!(events & (1 << sensor))) {
+            continue;
+        }
+        /* The rate mode control path uses the gyroscope only. The attitude is corrected again after it, the
+         * accelerometer innovation gate accepts the drifted estimate within STATE_ACC_GATE_MAX_CONSECUTIVE_REJECTS
+         * samples at the latest. */
+        if (FLIGHT_CONTROL_RATE == flightControlMode && (ACC_IDX == sensor || MAG_IDX == sensor)) {
+            continue;
+        }
+#ifdef FCB_GYRO_SYNCHRONOUS_PIPELINE
+        if (GYRO_IDX == sensor) {
+            /* Predict up to the gyroscope sample, correct with it and update the motors right away */
+            LatencyMonitorBegin(readings[GYRO_IDX].timestamp, readings[GYRO_IDX].fetchTimestamp);
+            DeadlineMonitorBegin(DEADLINE_LOOP_ESTIMATOR);
+            PredictStates();
+            CorrectStates(GYRO_IDX, &readings[GYRO_IDX]);
+            DeadlineMonitorEnd(DEADLINE_LOOP_ESTIMATOR);
+            LatencyMonitorMark(LATENCY_STAGE_CORRECTION);
+            DeadlineMonitorBegin(DEADLINE_LOOP_OUTER);
             UpdateFlightControl();
+            DeadlineMonitorEnd(DEADLINE_LOOP_OUTER);
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+            UpdateRateControl();
+#endif
+            IndicateFlightControlAlive();
+            continue;
+        }
+#endif
+        if (GYRO_IDX == sensor) {
+            LatencyMonitorBegin(readings[GYRO_IDX].timestamp, readings[GYRO_IDX].fetchTimestamp);
+        }
+        CorrectStates((FcbSensorIndexType) sensor, &readings[sensor]);
+        if (GYRO_IDX == sensor) {
+            LatencyMonitorMark(LATENCY_STAGE_CORRECTION);
+        }
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+        /* The inner loop runs right after the gyroscope correction, separate from the outer loop */
+        if (GYRO_IDX == sensor) {
+#ifdef FCB_CONTROL_EXECUTIVE
+            UpdateControlExecutive(readings[GYRO_IDX].xyz);
+#else
+            UpdateRateControl();
+#endif
+        }
+#endif
+    }
 
-            /* Blink with LED to indicate thread is alive */
-            if(ledFlashCounter % 200 == 0) {
-            	BSP_LED_Toggle(LED6);
-            }
+    if (events & FLIGHT_CONTROL_EVENT_PREDICTION_BIT) {
+        DeadlineMonitorBegin(DEADLINE_LOOP_ESTIMATOR);
+        PredictStates();
+        DeadlineMonitorEnd(DEADLINE_LOOP_ESTIMATOR);
+    }
+    /* The readers in other tasks get the states of this cycle as a whole, a replay publishes its own */
+    if ((events & (FLIGHT_CONTROL_EVENT_PREDICTION_BIT | ((1 << FCB_SENSOR_NBR) - 1)))
+            && !ESTIMATOR_REPLAY_IS_ACTIVE()) {
+        PublishStateSnapshot();
+    }
+    /* On a receiver failsafe the update reads the inactive receiver snapshot and goes to the failsafe state */
+    if (events & (FLIGHT_CONTROL_EVENT_PREDICTION_BIT | FLIGHT_CONTROL_EVENT_UPDATE_BIT
+            | FLIGHT_CONTROL_EVENT_FAILSAFE_BIT)) {
+        /* Perform flight control activities, the periodic ones on the prediction events */
+        if (events & FLIGHT_CONTROL_EVENT_PREDICTION_BIT) {
+            DeadlineMonitorBegin(DEADLINE_LOOP_OUTER);
+        }
+        UpdateFlightControl();
+#ifdef FCB_CONTROL_EXECUTIVE
+        SetControlExecutiveSetpoint();
+#endif
+        DeadlineMonitorEnd(DEADLINE_LOOP_OUTER);
+        IndicateFlightControlAlive();
+    }
+    /* The state stream to the FMS, of the latest published snapshot */
+    FmsLinkUpdateState();
+}
+
+/*
+ * @brief  Runs the state estimation prediction and records it for a replay, unless a replay owns the estimator
+ * @param  None
+ * @retval None
+ */
+static void PredictStates(void) {
+    uint32_t timestamp;
+
+    if (ESTIMATOR_REPLAY_IS_ACTIVE()) {
+        return;
+    }
 
-            ledFlashCounter++;
+    timestamp = GetTimestamp();
+    UpdatePredictionStateAt(timestamp);
+    ESTIMATOR_LOG_PREDICTION(timestamp);
+}
 
-            break;
-        case CORRECTION_UPDATE:
-            UpdateCorrectionState(msg.sensorReading.sensorType, msg.sensorReading.xyz);
-            break;
-        default:
-            break;
+/*
+ * @brief  Runs the state estimation correction with a sensor sample and records it for a replay, unless a replay owns
+ *         the estimator
+ * @param  sensor : Sensor of the sample
+ * @param  reading : Sample
+ * @retval None
+ */
+static void CorrectStates(const FcbSensorIndexType sensor, const sensorReading_TypeDef* reading) {
+    uint32_t timestamp;
+
+    if (ESTIMATOR_REPLAY_IS_ACTIVE()) {
+        return;
+    }
+
+    /* The estimate lags the motion by the group delay of the gyroscope and the sample by its own, so the sample is
+     * fused at the time of the estimate it matches, see fcb_sensor_timing.h */
+    timestamp = reading->timestamp
+            - (uint32_t) ((int32_t) GetSensorGroupDelayCycles(sensor) - (int32_t) GetSensorGroupDelayCycles(GYRO_IDX));
+
+    UpdateCorrectionState(sensor, reading->xyz, timestamp);
+    ESTIMATOR_LOG_CORRECTION(sensor, reading->xyz, timestamp);
+}
+
+/*
+ * @brief  Sets the expected periods of the loops, the rate loop runs on every PID_RATE_LOOP_GYRO_DIVISOR:th
+ *         gyroscope sample
+ * @param  None
+ * @retval None
+ */
+static void SetLoopDeadlines(void) {
+    DeadlineMonitorSetPeriod(DEADLINE_LOOP_ESTIMATOR, flightControlSamplePeriod);
+    DeadlineMonitorSetPeriod(DEADLINE_LOOP_OUTER, flightControlSamplePeriod);
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+    DeadlineMonitorSetPeriod(DEADLINE_LOOP_INNER, (float32_t) PID_RATE_LOOP_GYRO_DIVISOR/GyroDataRateHz());
+#endif
+}
+
+/*
+ * @brief  Waits for flight control events and fetches them together with the newest sample of each sensor
+ * @param  readings : Destination for the sensor samples, only the entries with their pending bit set are written
+ * @retval The pending event bits, 0 on timeout
+ */
+static uint32_t WaitForFlightControlEvents(sensorReading_TypeDef readings[FCB_SENSOR_NBR]) {
+    if (pdFALSE == xSemaphoreTake(semFlightControl, FLIGHT_CONTROL_EVENT_TIMEOUT)) {
+        return 0;
+    }
+
+    return FetchFlightControlEvents(readings);
+}
+
+/*
+ * @brief  Fetches the pending flight control events together with the newest sample of each sensor
+ * @param  readings : Destination for the sensor samples, only the entries with their pending bit set are written
+ * @retval The pending event bits, 0 if there are none
+ */
+static uint32_t FetchFlightControlEvents(sensorReading_TypeDef readings[FCB_SENSOR_NBR]) {
+    uint32_t events;
+    uint8_t sensor;
+
+    taskENTER_CRITICAL();
+    WakeLatencyWoken(WAKE_LATENCY_SENSORS_TO_FLIGHT);
+    events = flightControlEventsPending;
+    flightControlEventsPending = 0;
+    for (sensor = 0; sensor < FCB_SENSOR_NBR; sensor++) {
+        if (events & (1 << sensor)) {
+            readings[sensor] = sensorMailbox[sensor];
         }
     }
+    taskEXIT_CRITICAL();
+
+    return events;
+}
+
+/*
+ * @brief  Flags a flight control event as pending from an interrupt and wakes the flight control task
+ * @param  eventBit : Event bit to set
+ * @retval None
+ */
+static void SetFlightControlEventFromISR(const uint32_t eventBit) {
+    portBASE_TYPE higherPriorityTaskWoken = pdFALSE;
+    unsigned portBASE_TYPE savedInterruptStatus;
+
+    savedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+    if (flightControlEventsPending & eventBit) {
+        SENSOR_LOAD_TEST_COUNT_DROP(SENSOR_LOAD_DROP_FLIGHT_EVENT);
+    }
+    flightControlEventsPending |= eventBit;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(savedInterruptStatus);
+
+    /* fails harmlessly if already given - the task then handles this event on the pending wake-up */
+    xSemaphoreGiveFromISR(semFlightControl, &higherPriorityTaskWoken);
+
+    portYIELD_FROM_ISR(higherPriorityTaskWoken);
 }
 
 /**
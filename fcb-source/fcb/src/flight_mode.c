@@ -0,0 +1,527 @@
+/******************************************************************************
+ * @file    flight_mode.c
+ * @brief   Table driven flight mode state machine, see flight_mode.h
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "flight_mode.h"
+
+#include "state_estimation.h"
+#include "fcb_sensor_watchdog.h"
+#include "fcb_sensor_self_test.h"
+#include "fcb_accelerometer_magnetometer.h"
+#include "fcb_battery.h"
+#include "esc_telemetry.h"
+#include "prearm_checks.h"
+#include "fms_link.h"
+#include "deferred_work.h"
+#include "deferred_log.h"
+#include "task_watchdog.h"
+#include "event_journal.h"
+#include "fcb_port.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+#include <stdio.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+typedef struct {
+    const char* name;
+    enum FlightControlMode controlMode;
+    uint8_t entryActions;       // FLIGHT_MODE_ACTION_* bits
+    uint8_t exitActions;
+} FlightModeStateInfo_TypeDef;
+
+/* A transition that is allowed from each state of a mask, if its guards hold */
+typedef struct {
+    uint32_t fromStates;        // FLIGHT_MODE_STATE_BIT() mask
+    FlightModeStateType to;
+    uint32_t guards;            // FLIGHT_MODE_GUARD() mask
+} FlightModeRule_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+
+#define FLIGHT_MODE_STATE_BIT(STATE)    (1UL << (STATE))
+
+#define FLIGHT_MODE_FLYING_STATES       (FLIGHT_MODE_STATE_BIT(FLIGHT_MODE_RAW) \
+                                        | FLIGHT_MODE_STATE_BIT(FLIGHT_MODE_ATTITUDE) \
+                                        | FLIGHT_MODE_STATE_BIT(FLIGHT_MODE_RATE) \
+                                        | FLIGHT_MODE_STATE_BIT(FLIGHT_MODE_ALTITUDE_HOLD) \
+                                        | FLIGHT_MODE_STATE_BIT(FLIGHT_MODE_AUTONOMOUS))
+#define FLIGHT_MODE_ARMED_STATES        (FLIGHT_MODE_STATE_BIT(FLIGHT_MODE_ARMED_IDLE) | FLIGHT_MODE_FLYING_STATES)
+
+#define FLIGHT_MODE_ARMING_GUARDS       (FLIGHT_MODE_GUARD(FLIGHT_MODE_REJECT_RECEIVER) \
+                                        | FLIGHT_MODE_GUARD(FLIGHT_MODE_REJECT_THROTTLE) \
+                                        | FLIGHT_MODE_GUARD(FLIGHT_MODE_REJECT_CALIBRATION) \
+                                        | FLIGHT_MODE_GUARD(FLIGHT_MODE_REJECT_SENSORS) \
+                                        | FLIGHT_MODE_GUARD(FLIGHT_MODE_REJECT_ESTIMATOR) \
+                                        | FLIGHT_MODE_GUARD(FLIGHT_MODE_REJECT_BATTERY) \
+                                        | FLIGHT_MODE_GUARD(FLIGHT_MODE_REJECT_ESC) \
+                                        | FLIGHT_MODE_GUARD(FLIGHT_MODE_REJECT_WATCHDOG) \
+                                        | FLIGHT_MODE_GUARD(FLIGHT_MODE_REJECT_SELF_TEST) \
+                                        | FLIGHT_MODE_GUARD(FLIGHT_MODE_REJECT_PREARM))
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Every state starts with cleared references and controllers, as the flight modes always have */
+static const FlightModeStateInfo_TypeDef flightModeStates[FLIGHT_MODE_NBR] = {
+    { "disarmed", FLIGHT_CONTROL_IDLE, FLIGHT_MODE_ACTION_RESET_CONTROL, 0 },
+    { "armed-idle", FLIGHT_CONTROL_IDLE, FLIGHT_MODE_ACTION_RESET_CONTROL, 0 },
+    { "raw", FLIGHT_CONTROL_RAW, FLIGHT_MODE_ACTION_RESET_CONTROL, 0 },
+    { "attitude", FLIGHT_CONTROL_PID, FLIGHT_MODE_ACTION_RESET_CONTROL, 0 },
+    { "rate", FLIGHT_CONTROL_RATE, FLIGHT_MODE_ACTION_RESET_CONTROL, 0 },
+    { "altitude-hold", FLIGHT_CONTROL_ALTITUDE_HOLD,
+            FLIGHT_MODE_ACTION_RESET_CONTROL | FLIGHT_MODE_ACTION_CAPTURE_ALTITUDE | FLIGHT_MODE_ACTION_BUMPLESS_THRUST,
+            FLIGHT_MODE_ACTION_BUMPLESS_THRUST },
+    { "autonomous", FLIGHT_CONTROL_AUTONOMOUS, FLIGHT_MODE_ACTION_RESET_CONTROL, 0 },
+    { "failsafe", FLIGHT_CONTROL_IDLE, FLIGHT_MODE_ACTION_RESET_CONTROL, 0 }
+};
+
+/* The allowed transitions, the first rule from the current to the requested state applies. Armed idle only enters
+ * the flight modes with the throttle low, in flight they change into each other as the switches are moved. */
+static const FlightModeRule_TypeDef flightModeRules[] = {
+    { FLIGHT_MODE_STATE_BIT(FLIGHT_MODE_DISARMED), FLIGHT_MODE_ARMED_IDLE, FLIGHT_MODE_ARMING_GUARDS },
+    { FLIGHT_MODE_ARMED_STATES, FLIGHT_MODE_DISARMED, 0 },
+    { FLIGHT_MODE_ARMED_STATES, FLIGHT_MODE_FAILSAFE, 0 },
+    { FLIGHT_MODE_STATE_BIT(FLIGHT_MODE_FAILSAFE), FLIGHT_MODE_DISARMED, FLIGHT_MODE_GUARD(FLIGHT_MODE_REJECT_RECEIVER) },
+    { FLIGHT_MODE_STATE_BIT(FLIGHT_MODE_ARMED_IDLE), FLIGHT_MODE_RAW, FLIGHT_MODE_GUARD(FLIGHT_MODE_REJECT_THROTTLE) },
+    { FLIGHT_MODE_STATE_BIT(FLIGHT_MODE_ARMED_IDLE), FLIGHT_MODE_ATTITUDE,
+            FLIGHT_MODE_GUARD(FLIGHT_MODE_REJECT_THROTTLE) },
+    { FLIGHT_MODE_STATE_BIT(FLIGHT_MODE_ARMED_IDLE), FLIGHT_MODE_RATE, FLIGHT_MODE_GUARD(FLIGHT_MODE_REJECT_THROTTLE) },
+    { FLIGHT_MODE_STATE_BIT(FLIGHT_MODE_ARMED_IDLE), FLIGHT_MODE_ALTITUDE_HOLD,
+            FLIGHT_MODE_GUARD(FLIGHT_MODE_REJECT_THROTTLE) | FLIGHT_MODE_GUARD(FLIGHT_MODE_REJECT_BAROMETER) },
+    { FLIGHT_MODE_STATE_BIT(FLIGHT_MODE_ARMED_IDLE), FLIGHT_MODE_AUTONOMOUS,
+            FLIGHT_MODE_GUARD(FLIGHT_MODE_REJECT_THROTTLE) },
+    { FLIGHT_MODE_FLYING_STATES, FLIGHT_MODE_RAW, 0 },
+    { FLIGHT_MODE_FLYING_STATES, FLIGHT_MODE_ATTITUDE, 0 },
+    { FLIGHT_MODE_FLYING_STATES, FLIGHT_MODE_RATE, 0 },
+    { FLIGHT_MODE_FLYING_STATES, FLIGHT_MODE_ALTITUDE_HOLD, FLIGHT_MODE_GUARD(FLIGHT_MODE_REJECT_BAROMETER) },
+    { FLIGHT_MODE_FLYING_STATES, FLIGHT_MODE_AUTONOMOUS, 0 }
+};
+
+static const char* const flightModeRejectNames[FLIGHT_MODE_REJECT_NBR] = {
+    "none",
+    "not allowed from the current state",
+    "receiver inactive",
+    "throttle not low",
+    "sensors not calibrated",
+    "sensor unhealthy",
+    "estimator not converged",
+    "battery critical",
+    "ESC unhealthy",
+    "barometer unhealthy",
+    "reset by the watchdog",
+    "sensor self-test running or failed",
+    "pre-arm check failed"
+};
+
+/* Written by the flight control task, read by the other tasks with the scheduler suspended */
+static FlightModeStatusType flightModeStatus;
+static FlightModeLogEntryType flightModeLog[FLIGHT_MODE_LOG_LENGTH];
+static uint32_t flightModeLogCount = 0; // Entries written since startup
+
+static DeferredWorkId_TypeDef fmsReportWorkId = DEFERRED_WORK_INVALID_ID;
+
+/* Progress of PrintFlightModeLogNext(), used by the CLI commands only */
+static bool isLogPrintStarted = false;
+static uint32_t printNextEntry = 0;         // Of the entries written since startup
+static uint32_t printEndEntry = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+static const FlightModeRule_TypeDef* FindRule(const FlightModeStateType from, const FlightModeStateType to);
+static FlightModeRejectType CheckGuards(const uint32_t guards, const FlightModeRequestType* request);
+static bool IsGuardHolding(const FlightModeRejectType guard, const FlightModeRequestType* request);
+static void RejectRequest(const FlightModeStateType to, const FlightModeRejectType reason);
+static void AppendLogEntry(const uint32_t timestamp, const FlightModeStateType from, const FlightModeStateType to,
+        const FlightModeRejectType reason);
+static uint32_t GetTimestampMs(void);
+static void SendFmsReport(void* argument);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Starts the state machine in the disarmed state and registers the FMS status report
+ * @param  None.
+ * @retval FCB_OK if started, FCB_ERR if the report could not be registered
+ */
+FcbRetValType FlightModeInit(void) {
+    memset(&flightModeStatus, 0, sizeof(flightModeStatus));
+    flightModeStatus.state = FLIGHT_MODE_DISARMED;
+    flightModeStatus.previousState = FLIGHT_MODE_DISARMED;
+    flightModeStatus.rejectedState = FLIGHT_MODE_DISARMED;
+    flightModeStatus.rejectReason = FLIGHT_MODE_REJECT_NONE;
+    flightModeLogCount = 0;
+
+    return DeferredWorkRegister("FlightMode", SendFmsReport, NULL, DEFERRED_WORKER_LOW, &fmsReportWorkId);
+}
+
+/*
+ * @brief  Takes the requested state if a rule allows the transition from the current state and its guards hold
+ * @param  request : Requested state and receiver inputs of the control cycle
+ * @param  transition : Set to the transition taken, if any
+ * @retval true if the state changed, else false
+ */
+bool UpdateFlightModeState(const FlightModeRequestType* request, FlightModeTransitionType* transition) {
+    FlightModeStateType const current = flightModeStatus.state;
+    FlightModeStateType target;
+    const FlightModeRule_TypeDef* rule;
+    FlightModeRejectType reason;
+    uint32_t timestamp;
+
+    if ((FLIGHT_MODE_ARMED_STATES & FLIGHT_MODE_STATE_BIT(current))
+            && (!request->isReceiverActive || request->isEscFault || request->isCrash)) {
+        /* The switches are not valid, a motor cannot be relied on or the UAV has crashed */
+        target = FLIGHT_MODE_FAILSAFE;
+    } else if (!request->isReceiverActive) {
+        /* The switches are not valid, a UAV that is not armed keeps its state */
+        target = current;
+    } else if (FLIGHT_MODE_DISARMED == current && FLIGHT_MODE_DISARMED != request->state) {
+        /* Arming goes through armed idle, the requested state follows on the next control cycle */
+        target = FLIGHT_MODE_ARMED_IDLE;
+    } else {
+        target = request->state;
+    }
+
+    if (target == current) {
+        /* The request is served, the latest rejection is void */
+        if (FLIGHT_MODE_REJECT_NONE != flightModeStatus.rejectReason) {
+            flightModeStatus.rejectReason = FLIGHT_MODE_REJECT_NONE;
+            DeferredWorkPost(fmsReportWorkId);
+        }
+        return false;
+    }
+
+    rule = FindRule(current, target);
+    reason = (NULL == rule) ? FLIGHT_MODE_REJECT_TRANSITION : CheckGuards(rule->guards, request);
+    if (FLIGHT_MODE_REJECT_NONE != reason) {
+        RejectRequest(target, reason);
+        return false;
+    }
+
+    timestamp = GetTimestampMs();
+    flightModeStatus.previousState = current;
+    flightModeStatus.state = target;
+    flightModeStatus.rejectReason = FLIGHT_MODE_REJECT_NONE;
+    flightModeStatus.timestamp = timestamp;
+    flightModeStatus.transitions++;
+    AppendLogEntry(timestamp, current, target, FLIGHT_MODE_REJECT_NONE);
+    LOG2("Flight mode %s -> %s", flightModeStates[current].name, flightModeStates[target].name);
+    DeferredWorkPost(fmsReportWorkId);
+
+    if (FLIGHT_MODE_FAILSAFE == target) {
+        EventJournalRecord(EVENT_JOURNAL_FAILSAFE, (uint8_t) current,
+                (request->isReceiverActive ? 0 : EVENT_JOURNAL_FAILSAFE_RECEIVER)
+                | (request->isEscFault ? EVENT_JOURNAL_FAILSAFE_ESC : 0)
+                | (request->isCrash ? EVENT_JOURNAL_FAILSAFE_CRASH : 0));
+    }
+
+    transition->from = current;
+    transition->to = target;
+    transition->actions = flightModeStates[current].exitActions | flightModeStates[target].entryActions;
+
+    return true;
+}
+
+/*
+ * @brief  Gets the current state
+ * @param  None.
+ * @retval State
+ */
+FlightModeStateType GetFlightModeState(void) {
+    return flightModeStatus.state;
+}
+
+/*
+ * @brief  Gets a consistent copy of the state, the latest rejection and the counters
+ * @param  dstStatus : Destination
+ * @retval None.
+ */
+void GetFlightModeStatus(FlightModeStatusType* dstStatus) {
+    FCB_SUSPEND_SCHEDULER();
+    *dstStatus = flightModeStatus;
+    FCB_RESUME_SCHEDULER();
+}
+
+/*
+ * @brief  Gets the flight control mode run in a state
+ * @param  state : State
+ * @retval Flight control mode, FLIGHT_CONTROL_IDLE for an invalid state
+ */
+enum FlightControlMode GetFlightModeControlMode(const FlightModeStateType state) {
+    if (state >= FLIGHT_MODE_NBR) {
+        return FLIGHT_CONTROL_IDLE;
+    }
+
+    return flightModeStates[state].controlMode;
+}
+
+/*
+ * @brief  Gets the flying state that runs a flight control mode
+ * @param  mode : Flight control mode
+ * @retval State, FLIGHT_MODE_DISARMED if no flying state runs the mode
+ */
+FlightModeStateType GetFlightModeStateOfControlMode(const enum FlightControlMode mode) {
+    uint8_t state;
+
+    for (state = 0; state < FLIGHT_MODE_NBR; state++) {
+        if ((FLIGHT_MODE_FLYING_STATES & FLIGHT_MODE_STATE_BIT(state)) && mode == flightModeStates[state].controlMode) {
+            return (FlightModeStateType) state;
+        }
+    }
+
+    return FLIGHT_MODE_DISARMED;
+}
+
+/*
+ * @brief  Gets the name of a state
+ * @param  state : State
+ * @retval Name, or "?" for an invalid state
+ */
+const char* GetFlightModeStateName(const FlightModeStateType state) {
+    if (state >= FLIGHT_MODE_NBR) {
+        return "?";
+    }
+
+    return flightModeStates[state].name;
+}
+
+/*
+ * @brief  Gets the description of a rejection reason
+ * @param  reason : Rejection reason
+ * @retval Description, or "?" for an invalid reason
+ */
+const char* GetFlightModeRejectName(const FlightModeRejectType reason) {
+    if (reason >= FLIGHT_MODE_REJECT_NBR) {
+        return "?";
+    }
+
+    return flightModeRejectNames[reason];
+}
+
+/*
+ * @brief  Prints the next part of the flight mode transition log: the status, then the entries oldest first, as many
+ *         as fit. The parts are printed one per call, so that a CLI command sends each as one output chunk. Entries
+ *         overwritten by newer ones while the log is printed are skipped, the entries logged meanwhile are not printed.
+ * @param  dst : Destination string buffer, each part fits in 256 bytes
+ * @param  dstSize : Size of dst
+ * @retval true if more parts follow, false if done, the next call starts over with the status
+ */
+bool PrintFlightModeLogNext(char* dst, const size_t dstSize) {
+    FlightModeStatusType status;
+    FlightModeLogEntryType entry;
+    uint32_t count;
+    size_t length = 0;
+    size_t entryLength;
+
+    if (!isLogPrintStarted) {
+        FCB_SUSPEND_SCHEDULER();
+        status = flightModeStatus;
+        count = flightModeLogCount;
+        FCB_RESUME_SCHEDULER();
+
+        length = (size_t) snprintf(dst, dstSize, "\nFlight mode %s, %lu transitions, %lu rejections\n",
+                flightModeStates[status.state].name, status.transitions, status.rejections);
+        if (FLIGHT_MODE_REJECT_NONE != status.rejectReason && length < dstSize) {
+            snprintf(dst + length, dstSize - length, "Rejected %s: %s\n",
+                    flightModeStates[status.rejectedState].name, flightModeRejectNames[status.rejectReason]);
+        }
+
+        printNextEntry = (count > FLIGHT_MODE_LOG_LENGTH) ? count - FLIGHT_MODE_LOG_LENGTH : 0;
+        printEndEntry = count;
+        isLogPrintStarted = (printNextEntry < printEndEntry);
+        return isLogPrintStarted;
+    }
+
+    dst[0] = '\0';
+    while (printNextEntry < printEndEntry) {
+        FCB_SUSPEND_SCHEDULER();
+        count = flightModeLogCount;
+        entry = flightModeLog[printNextEntry % FLIGHT_MODE_LOG_LENGTH];
+        FCB_RESUME_SCHEDULER();
+
+        if (count - printNextEntry > FLIGHT_MODE_LOG_LENGTH) {
+            printNextEntry = count - FLIGHT_MODE_LOG_LENGTH;
+            continue;
+        }
+
+        entryLength = (size_t) snprintf(dst + length, dstSize - length, "%10lu ms  %s -> %s%s%s\n", entry.timestamp,
+                flightModeStates[entry.from].name, flightModeStates[entry.to].name,
+                (FLIGHT_MODE_REJECT_NONE != entry.reason) ? " rejected: " : "",
+                (FLIGHT_MODE_REJECT_NONE != entry.reason) ? flightModeRejectNames[entry.reason] : "");
+        if (entryLength >= dstSize - length) {
+            if (length > 0) {
+                dst[length] = '\0'; // Printed in the next part
+            } else {
+                printNextEntry++; // Cut to dst
+            }
+            break;
+        }
+        length += entryLength;
+        printNextEntry++;
+    }
+
+    isLogPrintStarted = (printNextEntry < printEndEntry);
+    return isLogPrintStarted;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Finds the rule of a transition
+ * @param  from : Current state
+ * @param  to : Requested state
+ * @retval Rule, NULL if the transition is not allowed
+ */
+static const FlightModeRule_TypeDef* FindRule(const FlightModeStateType from, const FlightModeStateType to) {
+    uint8_t i;
+
+    for (i = 0; i < sizeof(flightModeRules)/sizeof(flightModeRules[0]); i++) {
+        if (to == flightModeRules[i].to && (flightModeRules[i].fromStates & FLIGHT_MODE_STATE_BIT(from))) {
+            return &flightModeRules[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * @brief  Checks the guards of a rule in the order of FlightModeRejectType
+ * @param  guards : FLIGHT_MODE_GUARD() mask
+ * @param  request : Receiver inputs of the control cycle
+ * @retval The reason of the first guard that does not hold, FLIGHT_MODE_REJECT_NONE if all hold
+ */
+static FlightModeRejectType CheckGuards(const uint32_t guards, const FlightModeRequestType* request) {
+    uint8_t guard;
+
+    for (guard = FLIGHT_MODE_REJECT_RECEIVER; guard < FLIGHT_MODE_REJECT_NBR; guard++) {
+        if ((guards & FLIGHT_MODE_GUARD(guard)) && !IsGuardHolding((FlightModeRejectType) guard, request)) {
+            return (FlightModeRejectType) guard;
+        }
+    }
+
+    return FLIGHT_MODE_REJECT_NONE;
+}
+
+/*
+ * @brief  Evaluates one guard
+ * @param  guard : Rejection reason of the guard
+ * @param  request : Receiver inputs of the control cycle
+ * @retval true if the guard holds, else false
+ */
+static bool IsGuardHolding(const FlightModeRejectType guard, const FlightModeRequestType* request) {
+    switch (guard) {
+    case FLIGHT_MODE_REJECT_RECEIVER:
+        return request->isReceiverActive;
+    case FLIGHT_MODE_REJECT_THROTTLE:
+        return request->isThrottleLow;
+    case FLIGHT_MODE_REJECT_CALIBRATION:
+        return IsAccMagCalibrated();
+    case FLIGHT_MODE_REJECT_SENSORS:
+        return IsSensorHealthy(GYRO_IDX) && IsSensorHealthy(ACC_IDX) && IsSensorHealthy(MAG_IDX);
+    case FLIGHT_MODE_REJECT_ESTIMATOR:
+        return IsStateEstimationConverged();
+    case FLIGHT_MODE_REJECT_BATTERY:
+#ifdef FCB_BATTERY_MONITOR
+        /* In flight a critical battery is only warned of, stopping the motors would drop the UAV */
+        return BATTERY_CRITICAL != GetBatteryStatus();
+#else
+        return true;
+#endif
+    case FLIGHT_MODE_REJECT_ESC:
+#ifdef MOTOR_ESC_TELEMETRY
+        return IsEscTelemetryHealthy();
+#else
+        return true;
+#endif
+    case FLIGHT_MODE_REJECT_BAROMETER:
+        return IsSensorHealthy(BARO_IDX) && SENSOR_SELF_TEST_FAILED != GetSensorSelfTestStatus(BARO_IDX);
+    case FLIGHT_MODE_REJECT_WATCHDOG:
+        return !IsWatchdogResetPending();
+    case FLIGHT_MODE_REJECT_SELF_TEST:
+        return IsSensorSelfTestPassed();
+    case FLIGHT_MODE_REJECT_PREARM:
+        return 0 == GetPreArmFailures();
+    default:
+        return true;
+    }
+}
+
+/*
+ * @brief  Keeps the current state on a rejected request. A request that is rejected for the same reason again on the
+ *         following control cycles is only logged and reported once.
+ * @param  to : Requested state
+ * @param  reason : Rejection reason
+ * @retval None.
+ */
+static void RejectRequest(const FlightModeStateType to, const FlightModeRejectType reason) {
+    uint32_t timestamp;
+
+    if (reason == flightModeStatus.rejectReason && to == flightModeStatus.rejectedState) {
+        return;
+    }
+
+    timestamp = GetTimestampMs();
+    flightModeStatus.rejectedState = to;
+    flightModeStatus.rejectReason = reason;
+    flightModeStatus.timestamp = timestamp;
+    flightModeStatus.rejections++;
+    AppendLogEntry(timestamp, flightModeStatus.state, to, reason);
+    LOG3("WARNING: flight mode %s -> %s rejected, %s", flightModeStates[flightModeStatus.state].name,
+            flightModeStates[to].name, flightModeRejectNames[reason]);
+    DeferredWorkPost(fmsReportWorkId);
+}
+
+/*
+ * @brief  Appends a transition or rejection to the log, overwriting the oldest entry when full
+ * @param  timestamp : [ms]
+ * @param  from : Current state
+ * @param  to : New or requested state
+ * @param  reason : Rejection reason, FLIGHT_MODE_REJECT_NONE for a transition
+ * @retval None.
+ */
+static void AppendLogEntry(const uint32_t timestamp, const FlightModeStateType from, const FlightModeStateType to,
+        const FlightModeRejectType reason) {
+    FlightModeLogEntryType* entry = &flightModeLog[flightModeLogCount % FLIGHT_MODE_LOG_LENGTH];
+
+    entry->timestamp = timestamp;
+    entry->from = (uint8_t) from;
+    entry->to = (uint8_t) to;
+    entry->reason = (uint8_t) reason;
+    flightModeLogCount++;
+}
+
+/*
+ * @brief  Gets the time since startup
+ * @param  None.
+ * @retval Time [ms]
+ */
+static uint32_t GetTimestampMs(void) {
+    return (uint32_t) xTaskGetTickCount() * portTICK_RATE_MS;
+}
+
+/*
+ * @brief  Sends the latest status to the FMS, deferred work handler. Posts that arrive before it runs coalesce, the
+ *         FMS gets the status after the latest of them.
+ * @param  argument : Not used
+ * @retval None.
+ */
+static void SendFmsReport(void* argument) {
+    FlightModeStatusType status;
+    FmsFlightModeStatus_TypeDef report;
+
+    (void) argument;
+
+    GetFlightModeStatus(&status);
+    report.timestamp = status.timestamp;
+    report.rejections = status.rejections;
+    report.state = (uint8_t) status.state;
+    report.previousState = (uint8_t) status.previousState;
+    report.rejectedState = (uint8_t) status.rejectedState;
+    report.rejectReason = (uint8_t) status.rejectReason;
+
+    /* Not sent if no FMS has been heard from, it gets the status with the next transition then */
+    (void) FmsLinkSendFlightModeStatus(&report);
+}
@@ -0,0 +1,175 @@
+/******************************************************************************
+ * @file    hil_mode.c
+ * @author  Dragonfly
+ * @brief   Hardware-in-the-loop mode. The RPC_HIL_STEP requests of the host
+ *          simulator are handled in the RX work item of the com port, their
+ *          samples are posted to the flight control mailboxes as the SENSORS
+ *          task posts the physical ones, which the flight control drops while
+ *          HIL mode is active. The motor output keeps the commanded values for the
+ *          responses instead of sending them to the ESCs.
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "hil_mode.h"
+
+#ifdef FCB_HIL_MODE
+
+#include "flight_control.h"
+#include "estimator_replay.h"
+#include "common.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+#include <math.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+static volatile bool isHilActive = false;
+
+/* Written by the motor output in the flight control context, read by the RPC handler, both in critical sections */
+static uint16_t hilMotorValues[MOTOR_OUTPUT_CHANNELS];
+
+/* Private function prototypes -----------------------------------------------*/
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Enters HIL mode, from then on the flight control gets the simulated samples only and the motors are locked
+ * @param  None
+ * @retval FCB_OK if entered, FCB_ERR if the flight control is not in idle mode
+ */
+FcbRetValType HilModeEnable(void) {
+    /* The mode check and the switch are one step for the tasks, the flight control cannot arm in between */
+    taskENTER_CRITICAL();
+    if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        taskEXIT_CRITICAL();
+        return FCB_ERR;
+    }
+    memset(hilMotorValues, 0, sizeof(hilMotorValues));
+    isHilActive = true;
+    taskEXIT_CRITICAL();
+
+    /* No output is sent from here on, this ends one that is still running */
+    ShutdownMotors();
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Leaves HIL mode, the flight control gets the physical samples and drives the motors again. A replay of the
+ *         estimator is ended, the estimator is initialized again from the physical samples.
+ * @param  None
+ * @retval FCB_OK if left or not active, FCB_ERR if the flight control is not in idle mode
+ */
+FcbRetValType HilModeDisable(void) {
+    taskENTER_CRITICAL();
+    if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        taskEXIT_CRITICAL();
+        return FCB_ERR;
+    }
+    isHilActive = false;
+    taskEXIT_CRITICAL();
+
+#ifdef FCB_ESTIMATOR_REPLAY
+    EstimatorReplayEnd();
+#endif
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Checks if HIL mode is active
+ * @param  None
+ * @retval true if active
+ */
+bool HilModeIsActive(void) {
+    return isHilActive;
+}
+
+/*
+ * @brief  Handles a simulation step: posts the samples of the request to the flight control and writes the response
+ * @note   The flight control runs on the samples after this returns, so the motor values are those of the samples of
+ *         an earlier step, the previous one if the host step period is longer than the control computation.
+ * @param  request : RPC_HIL_STEP request payload, see HIL_STEP_HEADER_SIZE
+ * @param  requestSize : Size of request
+ * @param  response : Destination of the HIL_STEP_RESPONSE_SIZE bytes response payload
+ * @retval FCB_OK if handled, FCB_ERR if HIL mode is not active or the request is malformed, then nothing is posted
+ */
+FcbRetValType HilModeStep(const uint8_t* request, const uint8_t requestSize, uint8_t* response) {
+    float32_t samples[FCB_SENSOR_NBR][3];
+    uint16_t motorValues[MOTOR_OUTPUT_CHANNELS];
+    uint32_t hostTime, fcbTime, timestamp;
+    uint8_t mask, offset;
+    uint8_t sensor, axis;
+
+    if (!isHilActive || requestSize < HIL_STEP_HEADER_SIZE) {
+        return FCB_ERR;
+    }
+
+    mask = request[4];
+    if ((mask >> FCB_SENSOR_NBR) != 0
+            || requestSize != HIL_STEP_HEADER_SIZE + __builtin_popcount(mask) * HIL_STEP_SAMPLE_SIZE) {
+        return FCB_ERR;
+    }
+
+    /* All samples are checked before any is posted, the estimation cannot recover from NaN */
+    offset = HIL_STEP_HEADER_SIZE;
+    for (sensor = 0; sensor < FCB_SENSOR_NBR; sensor++) {
+        if (mask & (1 << sensor)) {
+            memcpy(samples[sensor], &request[offset], HIL_STEP_SAMPLE_SIZE);
+            offset += HIL_STEP_SAMPLE_SIZE;
+            for (axis = 0; axis < 3; axis++) {
+                if (!isfinite(samples[sensor][axis])) {
+                    return FCB_ERR;
+                }
+            }
+        }
+    }
+
+    /* The samples are taken now as far as the flight control knows, the gyroscope first as with physical ones */
+    memcpy(&hostTime, &request[0], 4);
+    timestamp = GetTimestamp();
+    fcbTime = (uint32_t) GetMicroseconds();
+    for (sensor = 0; sensor < FCB_SENSOR_NBR; sensor++) {
+        if (mask & (1 << sensor)) {
+            SendSimulatedSampleToFlightControl((FcbSensorIndexType) sensor, samples[sensor], timestamp);
+        }
+    }
+
+    taskENTER_CRITICAL();
+    memcpy(motorValues, hilMotorValues, sizeof(motorValues));
+    taskEXIT_CRITICAL();
+
+    /* The Cortex-M4 is little endian, like the payload */
+    memcpy(&response[0], &hostTime, 4);
+    memcpy(&response[4], &fcbTime, 4);
+    memcpy(&response[8], motorValues, sizeof(motorValues));
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Keeps the motor values of the flight control for the simulator, called by the motor output in HIL mode
+ * @param  ctrlVal : values [0,65535] indicating amount of motor thrust, motors 1-4
+ * @retval None
+ */
+void HilModeSetMotorValues(const uint16_t ctrlVal[MOTOR_OUTPUT_CHANNELS]) {
+    taskENTER_CRITICAL();
+    memcpy(hilMotorValues, ctrlVal, sizeof(hilMotorValues));
+    taskEXIT_CRITICAL();
+}
+
+#endif /* FCB_HIL_MODE */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,192 @@
+/******************************************************************************
+ * @file    mag_heading.c
+ * @brief   Disturbance checks of the magnetometer samples against a reference
+ *          field, and the declination of the heading, see mag_heading.h
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "mag_heading.h"
+
+#include "flash.h"
+#include "flight_control.h"
+#include "airframe.h"
+#include "fast_math.h"
+
+#include <math.h>
+#include <string.h>
+
+/* Private define ------------------------------------------------------------*/
+#define MAG_HEADING_MIN_FIELD_TOLERANCE     0.01f
+
+/* Private variables ---------------------------------------------------------*/
+
+/* The settings, written by the parameter table with the scheduler suspended */
+static volatile float32_t magDeclination = 0.0f;
+static volatile float32_t magFieldTolerance = MAG_HEADING_DEFAULT_FIELD_TOLERANCE;
+static volatile float32_t magThrottleNoiseGain = MAG_HEADING_DEFAULT_THROTTLE_NOISE_GAIN;
+
+/* The reference and the sums it is averaged from, only used by the flight control task */
+static float32_t referenceFieldStrength;
+static float32_t fieldStrengthSum;
+static float32_t inclinationSum;
+static uint32_t referenceSampleCount;
+
+static MagHeadingStatsType magHeadingStats;
+
+static const Param_TypeDef magHeadingParamTable[] = {
+	{ "MAG_DECL", PARAM_TYPE_FLOAT, &magDeclination, -PI, PI },
+	{ "MAG_FIELD_TOL", PARAM_TYPE_FLOAT, &magFieldTolerance, MAG_HEADING_MIN_FIELD_TOLERANCE,
+			MAG_HEADING_MAX_FIELD_TOLERANCE },
+	{ "MAG_THR_NOISE", PARAM_TYPE_FLOAT, &magThrottleNoiseGain, 0.0, MAG_HEADING_MAX_THROTTLE_NOISE_GAIN }
+};
+
+/* Private function prototypes -----------------------------------------------*/
+static RAMFUNC float32_t ThrottleNoiseScale(void);
+static FcbRetValType SaveMagHeadingSettings(void);
+
+static const ParamGroup_TypeDef magHeadingParamGroup = { magHeadingParamTable,
+		sizeof(magHeadingParamTable) / sizeof(magHeadingParamTable[0]), NULL, SaveMagHeadingSettings };
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Loads the stored settings, or keeps the defaults if there are none or they are invalid
+ * @param  None.
+ * @retval None.
+ */
+void InitMagHeading(void) {
+	MagHeadingSettingsType settings;
+
+	if (FLASH_OK == ReadMagHeadingSettingsFromFlash(&settings) && fabsf(settings.declination) <= PI
+			&& settings.fieldTolerance >= MAG_HEADING_MIN_FIELD_TOLERANCE
+			&& settings.fieldTolerance <= MAG_HEADING_MAX_FIELD_TOLERANCE && settings.throttleNoiseGain >= 0.0f
+			&& settings.throttleNoiseGain <= MAG_HEADING_MAX_THROTTLE_NOISE_GAIN) {
+		magDeclination = settings.declination;
+		magFieldTolerance = settings.fieldTolerance;
+		magThrottleNoiseGain = settings.throttleNoiseGain;
+	}
+
+	ResetMagHeading();
+}
+
+/*
+ * @brief  Clears the reference and the statistics
+ * @param  None.
+ * @retval None.
+ */
+void ResetMagHeading(void) {
+	referenceFieldStrength = 0.0f;
+	fieldStrengthSum = 0.0f;
+	inclinationSum = 0.0f;
+	referenceSampleCount = 0;
+	memset(&magHeadingStats, 0, sizeof(magHeadingStats));
+	magHeadingStats.noiseScale = 1.0f;
+}
+
+/*
+ * @brief  Compares the strength and the inclination of the field with the reference. The first samples are averaged
+ *         into the reference instead. A deviation d with tolerance t inflates the noise with (d/t)^2, a deviation above
+ *         the tolerance rejects the sample.
+ * @param  magValues : Calibrated magnetometer sample
+ * @param  trig : Attitude trigonometry to tilt compensate with
+ * @retval Factor of the yaw measurement noise, at least 1, or 0 to skip the sample
+ */
+RAMFUNC float32_t MagHeadingNoiseScale(const float32_t* magValues, const AttitudeTrigCacheType* trig) {
+	float32_t inertialMag[3];
+	float32_t fieldStrength, inclination, fieldDeviation, inclinationDeviation;
+
+	arm_dot_prod_f32((float32_t*) magValues, (float32_t*) magValues, 3, &fieldStrength);
+	fieldStrength = sqrtf(fieldStrength);
+	if (fieldStrength <= 0.0f) {
+		magHeadingStats.fieldRejected++;
+		return 0.0f;
+	}
+
+	/* The inclination is the angle of the field below the horizontal plane, "down" is the third component */
+	Vector3DTiltCompensateCached(inertialMag, magValues, trig);
+	inclination = FastAsinf(fmaxf(-1.0f, fminf(inertialMag[2] / fieldStrength, 1.0f)));
+	magHeadingStats.inclination = inclination;
+
+	if (referenceSampleCount < MAG_HEADING_REFERENCE_SAMPLES) {
+		fieldStrengthSum += fieldStrength;
+		inclinationSum += inclination;
+		referenceSampleCount++;
+		if (MAG_HEADING_REFERENCE_SAMPLES == referenceSampleCount) {
+			referenceFieldStrength = fieldStrengthSum / MAG_HEADING_REFERENCE_SAMPLES;
+			magHeadingStats.referenceInclination = inclinationSum / MAG_HEADING_REFERENCE_SAMPLES;
+			magHeadingStats.isReferenceSet = true;
+		}
+		magHeadingStats.fieldStrength = 1.0f;
+		magHeadingStats.noiseScale = ThrottleNoiseScale();
+		magHeadingStats.accepted++;
+		return magHeadingStats.noiseScale;
+	}
+
+	magHeadingStats.fieldStrength = fieldStrength / referenceFieldStrength;
+	fieldDeviation = fabsf(magHeadingStats.fieldStrength - 1.0f) / magFieldTolerance;
+	inclinationDeviation = fabsf(inclination - magHeadingStats.referenceInclination)
+			/ MAG_HEADING_INCLINATION_TOLERANCE;
+
+	if (fieldDeviation > 1.0f) {
+		magHeadingStats.fieldRejected++;
+		return 0.0f;
+	}
+	if (inclinationDeviation > 1.0f) {
+		magHeadingStats.inclinationRejected++;
+		return 0.0f;
+	}
+
+	magHeadingStats.noiseScale = (1.0f + fieldDeviation*fieldDeviation + inclinationDeviation*inclinationDeviation)
+			* ThrottleNoiseScale();
+	magHeadingStats.accepted++;
+	return magHeadingStats.noiseScale;
+}
+
+float32_t GetMagDeclination(void) {
+	return magDeclination;
+}
+
+void GetMagHeadingStats(MagHeadingStatsType* dstStats) {
+	*dstStats = magHeadingStats;
+}
+
+const ParamGroup_TypeDef* GetMagHeadingParamGroup(void) {
+	return &magHeadingParamGroup;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Gets the factor the noise is inflated with for the motor currents, from the commanded thrust
+ * @param  None.
+ * @retval Factor, 1 to 1 + MAG_THR_NOISE
+ */
+static RAMFUNC float32_t ThrottleNoiseScale(void) {
+	float32_t throttle = fmaxf(0.0f, fminf(GetThrustControlSignal() / MAX_THRUST, 1.0f));
+
+	return 1.0f + magThrottleNoiseGain*throttle*throttle;
+}
+
+/*
+ * @brief  Saves the heading parameters to flash
+ * @param  None.
+ * @retval FCB_OK if saved, else FCB_ERR
+ */
+static FcbRetValType SaveMagHeadingSettings(void) {
+	MagHeadingSettingsType settings;
+
+	settings.declination = magDeclination;
+	settings.fieldTolerance = magFieldTolerance;
+	settings.throttleNoiseGain = magThrottleNoiseGain;
+
+	return FLASH_OK == WriteMagHeadingSettingsToFlash(&settings) ? FCB_OK : FCB_ERR;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -30,16 +30,41 @@
 #include "flight_control.h"
 #include "rotation_transformation.h"
 #include "pid_control.h"
+#include "param_table.h"
+#include "flash.h"
 #include "receiver.h"
 #include "task_status.h"
 #include "usbd_cdc_if.h"
+#include "usbd_log_if.h"
 #include "com_cli.h"
+#include "telemetry.h"
+#include "com_mavlink.h"
+#include "blackbox.h"
+#include "deferred_log.h"
+#include "trace_recorder.h"
 #include "fcb_error.h"
+#include "crash_dump.h"
+#include "scope_probe.h"
+#include "cpu_headroom.h"
+#include "boot_timing.h"
+#include "ccm_ram.h"
 #include "fcb_retval.h"
 #include "fcb_sensors.h"
 #include "fcb_gyroscope.h"
 #include "state_estimation.h"
 #include "uart.h"
+#include "control_executive.h"
+#include "benchmark.h"
+#include "estimator_replay.h"
+#include "wcet_test.h"
+#include "esc_telemetry.h"
+#include "dronecan.h"
+#include "firmware_update.h"
+#include "task_watchdog.h"
+#include "led_status.h"
+#include "prearm_checks.h"
+#include "perf_snapshot.h"
+#include "event_journal.h"
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -71,9 +96,18 @@ int main(void) {
 	 * system_stm32f30x.c file
 	 */
 
+	/* Starts the ROM bootloader instead, if requested before the reset, see firmware_update.h */
+	CheckBootloaderRequest();
+
+	/* The .ccmram section is not loaded by the startup code, see ccm_ram.h */
+	InitCcmRam();
+
 	/* Init system at low level */
 	InitSystem();
 
+	/* Idle loop baseline of the CPU headroom meter, while nothing else runs */
+	CalibrateCpuHeadroom();
+
 	/* Initialize RTOS tasks */
 	InitRTOS();
 
@@ -101,15 +135,35 @@ static void InitSystem(void) {
 	 */
 	HAL_Init();
 
+#ifdef FCB_TRACE_RECORDER
+	/* Start the trace recorder before any kernel object is created, so that all of them are traced */
+	InitTraceRecorder();
+#endif
+
 	/* Initialize the CRC peripheral */
 	InitCRC();
 
+	/* Find the settings store in flash, before any settings are read. If it fails, the settings keep their defaults. */
+	InitFlashSettings();
+
+	/* Record the startup in the event journal, before the watchdog reset is latched and the reset flags are cleared */
+	InitEventJournal();
+
+	/* Latch a watchdog reset and start the task watchdog, before the reset flags are cleared below */
+	InitTaskWatchdog();
+
+	/* Copy the dump of a crash before the reset to the settings store */
+	InitCrashDump();
+
 	/* Initialize Programmable Voltage Detection (PVD) */
 	ConfigPVD();
 
 	/* Configure the system clock to 72 Mhz */
 	ConfigSystemClock();
 
+	/* Start the sensor sample timestamp counter */
+	InitTimestampCounter();
+
 	/* Initialize Command Line Interface for USB communication */
 	RegisterCLICommands();
 
@@ -119,13 +173,31 @@ static void InitSystem(void) {
 	/* Init on-board LEDs */
 	InitLEDs();
 
+	/* Show the status of the UAV with the LEDs once the scheduler runs */
+	InitLedStatus();
+
+	/* Evaluate the pre-arm checks once the scheduler runs, arming is rejected until they have passed */
+	if (FCB_OK != InitPreArmChecks()) {
+		ErrorHandler();
+	}
+
+	/* Configure the scope probe stage marker outputs, if compiled in */
+	InitScopeProbe();
+
 	/* Init User button */
 	BSP_PB_Init(BUTTON_USER, BUTTON_MODE_EXTI);
 
-	/* Init sensor reading */
+#ifdef FCB_CONTROL_EXECUTIVE
+	/* Before the gyroscope samples start to trigger it */
+	ControlExecutiveConfig();
+#endif
+
+#ifndef FCB_BENCHMARK_BUILD
+	/* Init sensor reading, the benchmark build has no sensor interrupts to disturb the timing */
 	if (FCB_OK != FcbSensorsConfig()) {
 		ErrorHandler();
 	}
+#endif
 
 	/* Init the rotation matrix */
 	InitRotationMatrix();
@@ -134,14 +206,31 @@ static void InitSystem(void) {
 	/* Initialize PID control variables */
 	InitPIDControllers();
 
+	/* Register the tunable parameters of the subsystems */
+	InitParamTable();
+
 	/* Setup motor output timer */
 	MotorControlConfig();
 
+#ifdef MOTOR_ESC_TELEMETRY
+	/* Polled through the DShot frames, the first request goes with the first frame */
+	if (FCB_OK != EscTelemetryConfig()) {
+		ErrorHandler();
+	}
+#endif
+
 	/* Setup receiver timers for receiver input */
 	ReceiverInputConfig();
 
-	/* Setup timer for task status command*/
+	/* Start the task status sampling for the task-status command */
 	InitMonitoring();
+
+#ifdef FCB_PERF_SNAPSHOT
+	/* Start the performance snapshots, after the settings store has loaded the baseline */
+	InitPerfSnapshot();
+#endif
+
+	BootTimingMark(BOOT_PHASE_SYSTEM_INIT);
 }
 
 /**
@@ -152,17 +241,40 @@ static void InitSystem(void) {
  */
 static void InitRTOS(void) {
 	/* # CREATE THREADS ####################################################### */
+#ifdef FCB_BENCHMARK_BUILD
+	/* Only the benchmark runner, the com ports and the log */
+	CreateBenchmarkTask();
+	CreateUSBComTasks();
+	CreateUARTComTasks();
+	CreateLogWork();
+#else
 	CreateFlightControlTask();
 #if defined(USE_USB_COM)
 	CreateUSBComTasks();
+	CreateTelemetryTask();
+#ifdef FCB_USB_MASS_STORAGE
+	CreateUSBMscWork();
+#endif
 #endif
 	CreateUARTComTasks();
-
-	/* # CREATE QUEUES ######################################################## */
-#if defined(USE_USB_COM)
-	CreateUSBComQueues();
+	InitMavlink(); /* The streams are sent by the telemetry task, USB builds only */
+	CreateFlashWriterWork();
+	CreateBlackboxWork();
+	CreateLogWork();
+	CreateFirmwareUpdateWork();
+#ifdef FCB_TRACE_RECORDER
+	CreateTraceTask();
+#endif
+#ifdef FCB_ESTIMATOR_REPLAY
+	CreateEstimatorLogTask();
+#endif
+#ifdef FCB_WCET_TEST
+	CreateWcetTestTask();
+#endif
+#ifdef FCB_CAN_BUS
+	CreateDroneCanTask();
+#endif
 #endif
-	CreateUARTComQueues();
 
 	/* # CREATE SEMAPHORES #################################################### */
 	CreateCLISemaphores();
@@ -175,6 +287,7 @@ static void InitRTOS(void) {
 	 * Currently using heap2.c
 	 * See ST UM1722 manual section 1.6 for more information.
 	 */
+	BootTimingMark(BOOT_PHASE_SCHEDULER_START);
 	vTaskStartScheduler();
 }
 
@@ -6,7 +6,8 @@
  *
  *          The ESC:s are of the T-motor brand and can
  *          withstand up to 30 A continuous current. They take up to 400 Hz pulse
- *          control signals.
+ *          control signals. OneShot125 and DShot ESC:s are supported as well,
+ *          see MOTOR_OUTPUT_PROTOCOL, these get one output per motor update.
  *
  *          The motors are also of T-motor brand (U3 Power Type model) with a KV
  *          value of 700. Coupled with the 11x3.7 carbon fibre propellers, they
@@ -16,9 +17,23 @@
 /* Includes ------------------------------------------------------------------*/
 #include "motor_control.h"
 
+#include "motor_mixer.h"
+#include "thrust_curve.h"
 #include "fcb_error.h"
 #include "receiver.h"
 #include "common.h"
+#include "telemetry_aggregate.h"
+#include "latency_monitor.h"
+#include "profiler.h"
+#include "scope_probe.h"
+#include "hil_mode.h"
+#include "wcet_test.h"
+#include "fcb_battery.h"
+#include "flash.h"
+#include "system_identification.h"
+#include "esc_telemetry.h"
+#include "dronecan.h"
+#include "fixed_format.h"
 #include "dragonfly_fcb.pb.h"
 #include "pb_encode.h"
 #include "usbd_cdc_if.h"
@@ -31,14 +46,69 @@
 #include <stdio.h>
 
 /* Private typedef -----------------------------------------------------------*/
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+typedef enum {
+	DSHOT_IDLE = 0,     // Ready for the next frame, the answers of the previous one are not decoded yet
+	DSHOT_SENDING,      // Frame bursts, the DMA interrupt at the last one turns the lines around
+	DSHOT_RECEIVING     // Port samples, the DMA interrupt at the last one turns the lines back to outputs
+} DshotPhase_TypeDef;
+
+/* Answer of one motor as it is decoded from the port samples */
+typedef struct {
+	bool isStarted;     // The start bit, the first falling edge, has been seen
+	bool level;
+	uint16_t lastEdge;  // [sample]
+	uint8_t bits;
+	uint32_t value;     // Bits received so far, a 1 for each edge
+} DshotDecoder_TypeDef;
+#endif
 
 /* Private define ------------------------------------------------------------*/
-#define MOTOR_CONTROL_PRINT_SAMPLING_TASK_PRIO			1
-#define MOTOR_CONTROL_PRINT_MINIMUM_SAMPLING_TIME		2	// Motor control updated every 2.5 ms
 #define MOTOR_CONTROL_PRINT_MAX_STRING_SIZE				96
 
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+#define MOTOR_PINS                                      (MOTOR_GPIO_PIN_CHANNEL1 | MOTOR_GPIO_PIN_CHANNEL2 \
+                                                        | MOTOR_GPIO_PIN_CHANNEL3 | MOTOR_GPIO_PIN_CHANNEL4)
+#define MOTOR_PINS_MODER_MASK                           (GPIO_MODER_MODER12 | GPIO_MODER_MODER13 \
+                                                        | GPIO_MODER_MODER14 | GPIO_MODER_MODER15)
+#define MOTOR_PINS_MODER_AF                             (GPIO_MODER_MODER12_1 | GPIO_MODER_MODER13_1 \
+                                                        | GPIO_MODER_MODER14_1 | GPIO_MODER_MODER15_1)
+
+/* Port samples are read as half words from IDR, with an interrupt at the last one */
+#define DSHOT_RX_DMA_CONFIG                             (DMA_CCR_PL | DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_0 | DMA_CCR_MINC \
+                                                        | DMA_CCR_TCIE)
+
+#define DSHOT_TELEMETRY_INVALID                         UINT32_MAX
+#define DSHOT_TELEMETRY_STOPPED_PERIOD                  0x0FFF // Answered by a stopped motor
+#endif
+
+/* Pulse timing of the analog protocols, see MOTOR_OUTPUT_PERIOD */
+#if (MOTOR_OUTPUT_PROTOCOL == MOTOR_PROTOCOL_ONESHOT125)
+#define MOTOR_PULSE_PERIOD                              ONESHOT125_OUTPUT_PERIOD
+#define MOTOR_PULSE_MIN                                 ONESHOT125_MIN_OUTPUT
+#define MOTOR_PULSE_MAX                                 ONESHOT125_MAX_OUTPUT
+#else
+#define MOTOR_PULSE_PERIOD                              MOTOR_OUTPUT_PERIOD
+#define MOTOR_PULSE_MIN                                 ESC_MIN_OUTPUT
+#define MOTOR_PULSE_MAX                                 ESC_MAX_OUTPUT
+#endif
+
+/* Shortest gap of the analog pulses to the end of their period */
+#define MOTOR_PULSE_MIN_GAP                             (MOTOR_PULSE_PERIOD/40)
+
+/* Compare value that produces no output pulse */
+#if MOTOR_OUTPUT_IS_DSHOT
+#define MOTOR_NO_PULSE                                  0
+#else
+#define MOTOR_NO_PULSE                                  (MOTOR_PULSE_PERIOD + 1)
+#endif
+
 /* Private macro -------------------------------------------------------------*/
 
+/* Scales a motor control value [0,65535] to [0,RANGE] with a shift instead of a division by UINT16_MAX. Both ends of
+ * the range are exact for RANGE < 65536. */
+#define SCALE_MOTOR_VALUE(VAL, RANGE)                   ((((uint32_t) (VAL) + 1) * (uint32_t) (RANGE)) >> 16)
+
 /* Private variables ---------------------------------------------------------*/
 typedef struct {
 	uint16_t Motor1;
@@ -47,65 +117,79 @@ typedef struct {
 	uint16_t Motor4;
 } MotorControlValues_TypeDef;
 
-typedef enum {
-	MOTOR_NEG_ROTATION = -1,
-	MOTOR_POS_ROTATION = 1
-} MotorMomentSign;
-
-typedef struct {
-	MotorMomentSign rollDir;	// Depends on the motor location relative to aircraft CoG
-	MotorMomentSign pitchDir;	// Depends on the motor location relative to aircraft CoG
-	MotorMomentSign yawDir;		// Depends on the motor rotational direction (CCW or CW)
-} MotorProperties_TypeDef;
-
 /* Motor control value struct declaration*/
 static MotorControlValues_TypeDef MotorControlValues;
 
-static MotorProperties_TypeDef Motor1Properties;
-static MotorProperties_TypeDef Motor2Properties;
-static MotorProperties_TypeDef Motor3Properties;
-static MotorProperties_TypeDef Motor4Properties;
-
 /* Timer time base handler */
 static TIM_HandleTypeDef MotorControlTimHandle;
 
-/* Task handle for printing of sensor values task */
-xTaskHandle MotorControlPrintSamplingTaskHandle = NULL;
-static volatile uint16_t motorControlPrintSampleTime;
-static volatile uint16_t motorControlPrintSampleDuration;
+/* Analog pulse widths [ticks], see EscOutputsType. Set in idle mode only, while the motors are not allocated. */
+static uint32_t escMinPulse = MOTOR_PULSE_MIN;
+static uint32_t escIdlePulse = MOTOR_PULSE_MIN;
+static uint32_t escMaxPulse = MOTOR_PULSE_MAX;
+
+#if MOTOR_OUTPUT_IS_DSHOT
+/* DShot compare values, one CCR1-4 burst per bit. The trailing slots stay zero to end the frame low. */
+static uint32_t dshotDmaBuffer[DSHOT_FRAME_SLOTS][MOTOR_OUTPUT_CHANNELS];
+#endif
+
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+static volatile DshotPhase_TypeDef dshotPhase = DSHOT_IDLE;
+static volatile bool isDshotAnswerPending = false;
+static uint32_t dshotTxDmaConfig;
+
+/* Samples of the whole motor port, from the end of a frame */
+static uint16_t dshotTelemetryBuffer[DSHOT_TELEMETRY_SAMPLES];
+
+static const uint16_t motorPins[MOTOR_OUTPUT_CHANNELS] = { MOTOR_GPIO_PIN_CHANNEL1, MOTOR_GPIO_PIN_CHANNEL2,
+		MOTOR_GPIO_PIN_CHANNEL3, MOTOR_GPIO_PIN_CHANNEL4 };
+
+/* GCR 5 bit codes to nibbles, 0xFF for the codes that are not used */
+static const uint8_t gcrDecodeTable[32] = {
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x09, 0x0A, 0x0B, 0xFF, 0x0D, 0x0E, 0x0F,
+		0xFF, 0xFF, 0x02, 0x03, 0xFF, 0x05, 0x06, 0x07, 0xFF, 0x00, 0x08, 0x01, 0xFF, 0x04, 0x0C, 0xFF };
+
+/* Decoded by the context that sends the motor outputs, published double buffered to the SENSORS task */
+static MotorTelemetryType motorTelemetry[2];
+static volatile uint32_t motorTelemetrySequence = 0;
+static uint8_t motorTelemetryErrors[MOTOR_OUTPUT_CHANNELS]; // In a row
+static uint32_t motorTelemetryAnswers[MOTOR_OUTPUT_CHANNELS];
+static uint32_t motorTelemetryLost[MOTOR_OUTPUT_CHANNELS];
+#endif
 
 /* Private function prototypes -----------------------------------------------*/
-static void MotorControlPrintSamplingTask(void const *argument);
-static void SetMotor1(const uint16_t ctrlVal);
-static void SetMotor2(const uint16_t ctrlVal);
-static void SetMotor3(const uint16_t ctrlVal);
-static void SetMotor4(const uint16_t ctrlVal);
-static void SaturateMotorSignalValues();
+static void LoadMotorOutputs(const uint16_t ctrlVal[MOTOR_OUTPUT_CHANNELS], const uint8_t stopMask);
+static uint8_t IsMotorOutputBusy(void);
+static void TriggerMotorOutput(void);
+static RAMFUNC bool OutputMotors(const uint16_t ctrlVal[MOTOR_OUTPUT_CHANNELS], const uint8_t stopMask);
+static bool IsValidEscOutputs(const EscOutputsType* outputs);
+static RAMFUNC void ToAchievedMoments(const float32_t achieved[MIXER_AXES_NBR], const float32_t k, const float u2,
+		const float u3, const float u4, const float32_t moments[3], float32_t achievedMoments[3]);
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+static void DecodeDshotTelemetry(void);
+static void DecodeDshotEdge(DshotDecoder_TypeDef* decoder, const uint16_t sample, const bool level);
+static uint32_t DecodeDshotAnswer(const DshotDecoder_TypeDef* decoder);
+#endif
 
 /* Exported functions --------------------------------------------------------*/
 
 /*
- * @brief  Initializes and configures the timer used to produce PWM output to control the ESC:s with.
+ * @brief  Initializes and configures the timer used to produce PWM, OneShot125 or DShot output to control the ESC:s
+ *         with.
  * @param  None.
  * @retval None.
  */
 void MotorControlConfig(void) {
-	/* Configure each of the motors' properties */
-	Motor1Properties.rollDir = MOTOR_NEG_ROTATION;
-	Motor1Properties.pitchDir = MOTOR_POS_ROTATION;
-	Motor1Properties.yawDir = MOTOR_POS_ROTATION;
-
-	Motor2Properties.rollDir = MOTOR_POS_ROTATION;
-	Motor2Properties.pitchDir = MOTOR_POS_ROTATION;
-	Motor2Properties.yawDir = MOTOR_NEG_ROTATION;
-
-	Motor3Properties.rollDir = MOTOR_POS_ROTATION;
-	Motor3Properties.pitchDir = MOTOR_NEG_ROTATION;
-	Motor3Properties.yawDir = MOTOR_POS_ROTATION;
-
-	Motor4Properties.rollDir = MOTOR_NEG_ROTATION;
-	Motor4Properties.pitchDir = MOTOR_NEG_ROTATION;
-	Motor4Properties.yawDir = MOTOR_NEG_ROTATION;
+	EscOutputsType escOutputs;
+
+	/* Load the motor layout, the thrust curves and the ESC pulse widths */
+	MotorMixerInit();
+	InitThrustCurves();
+	if (FLASH_OK == ReadEscOutputsFromFlash(&escOutputs) && IsValidEscOutputs(&escOutputs)) {
+		escMinPulse = escOutputs.minPulse*MOTOR_TICKS_PER_US;
+		escIdlePulse = escOutputs.idlePulse*MOTOR_TICKS_PER_US;
+		escMaxPulse = escOutputs.maxPulse*MOTOR_TICKS_PER_US;
+	}
 
 	/*##-1- Configure the TIM peripheral #######################################*/
 
@@ -115,7 +199,11 @@ void MotorControlConfig(void) {
 	/* Initialize Motor TIM peripheral timebase */
 	MotorControlTimHandle.Instance = TIM_MOTOR;
 	MotorControlTimHandle.Init.Prescaler = SystemCoreClock / MOTOR_OUTPUT_COUNTER_CLOCK - 1;
-	MotorControlTimHandle.Init.Period = MOTOR_OUTPUT_PERIOD;
+#if MOTOR_OUTPUT_IS_DSHOT
+	MotorControlTimHandle.Init.Period = DSHOT_BIT_PERIOD - 1;
+#else
+	MotorControlTimHandle.Init.Period = MOTOR_PULSE_PERIOD;
+#endif
 	MotorControlTimHandle.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
 	MotorControlTimHandle.Init.CounterMode = TIM_COUNTERMODE_UP;
 	if (HAL_TIM_PWM_Init(&MotorControlTimHandle) != HAL_OK) {
@@ -123,35 +211,57 @@ void MotorControlConfig(void) {
 		ErrorHandler();
 	}
 
+#if MOTOR_OUTPUT_IS_DSHOT
+	/* Each DMA request writes CCR1-4 through DMAR */
+	MotorControlTimHandle.Instance->DCR = TIM_DMABase_CCR1 | TIM_DMABurstLength_4Transfers;
+	MotorControlTimHandle.hdma[MOTOR_DSHOT_DMA_ID]->Instance->CPAR = (uint32_t) &MotorControlTimHandle.Instance->DMAR;
+	MotorControlTimHandle.hdma[MOTOR_DSHOT_DMA_ID]->Instance->CMAR = (uint32_t) dshotDmaBuffer;
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+	/* The interrupt at the end of each frame turns the lines around */
+	dshotTxDmaConfig = MotorControlTimHandle.hdma[MOTOR_DSHOT_DMA_ID]->Instance->CCR | DMA_CCR_TCIE;
+	MotorControlTimHandle.hdma[MOTOR_DSHOT_DMA_ID]->Instance->CCR = dshotTxDmaConfig;
+#endif
+#else
+	/* Stop the counter after each period, TriggerMotorOutput() restarts it */
+	MotorControlTimHandle.Instance->CR1 |= TIM_CR1_OPM;
+#endif
+
 	/*##-2- Configure the PWM channels #########################################*/
-	/* Common configuration for all channels */
+	/* Common configuration for all channels, the compare values are preloaded and applied on update events */
+#if MOTOR_OUTPUT_IS_DSHOT && !defined(MOTOR_DSHOT_BIDIRECTIONAL)
 	ocConfig.OCMode = TIM_OCMODE_PWM1;
+#elif defined(MOTOR_DSHOT_BIDIRECTIONAL)
+	/* Inverted, the lines idle high and each bit starts low */
+	ocConfig.OCMode = TIM_OCMODE_PWM2;
+#else
+	ocConfig.OCMode = TIM_OCMODE_PWM2;
+#endif
 	ocConfig.OCPolarity = TIM_OCPOLARITY_HIGH;
 	ocConfig.OCFastMode = TIM_OCFAST_ENABLE;
 
 	/* Set the pulse value for Motor 1 */
-	ocConfig.Pulse = 0;
+	ocConfig.Pulse = MOTOR_NO_PULSE;
 	if (HAL_TIM_PWM_ConfigChannel(&MotorControlTimHandle, &ocConfig, MOTOR1_CHANNEL) != HAL_OK) {
 		/* Configuration Error */
 		ErrorHandler();
 	}
 
 	/* Set the pulse value for Motor 2 */
-	ocConfig.Pulse = 0;
+	ocConfig.Pulse = MOTOR_NO_PULSE;
 	if (HAL_TIM_PWM_ConfigChannel(&MotorControlTimHandle, &ocConfig, MOTOR2_CHANNEL) != HAL_OK) {
 		/* Configuration Error */
 		ErrorHandler();
 	}
 
 	/* Set the pulse value for Motor 3 */
-	ocConfig.Pulse = 0;
+	ocConfig.Pulse = MOTOR_NO_PULSE;
 	if (HAL_TIM_PWM_ConfigChannel(&MotorControlTimHandle, &ocConfig, MOTOR3_CHANNEL) != HAL_OK) {
 		/* Configuration Error */
 		ErrorHandler();
 	}
 
 	/* Set the pulse value for Motor 4 */
-	ocConfig.Pulse = 0;
+	ocConfig.Pulse = MOTOR_NO_PULSE;
 	if (HAL_TIM_PWM_ConfigChannel(&MotorControlTimHandle, &ocConfig, MOTOR4_CHANNEL) != HAL_OK) {
 		/* Configuration Error */
 		ErrorHandler();
@@ -181,15 +291,23 @@ void MotorControlConfig(void) {
 }
 
 /*
- * @brief  Sets the motor control PWM (sent to ESC) for motors 1-4
+ * @brief  Sets the motor control output (sent to ESC) for motors 1-4. All four outputs are updated together and sent
+ *         right away. An update that arrives while the previous one is still being sent is dropped.
  * @param  ctrlValMotorX: value [0,65535] indicating amount of motor thrust. X == 1, 2, 3, 4
  * @retval None.
  */
 void SetMotors(uint16_t ctrlValMotor1, uint16_t ctrlValMotor2, uint16_t ctrlValMotor3, uint16_t ctrlValMotor4) {
-	SetMotor1(ctrlValMotor1);
-	SetMotor2(ctrlValMotor2);
-	SetMotor3(ctrlValMotor3);
-	SetMotor4(ctrlValMotor4);
+	const uint16_t ctrlVal[MOTOR_OUTPUT_CHANNELS] = { ctrlValMotor1, ctrlValMotor2, ctrlValMotor3, ctrlValMotor4 };
+
+	if (!OutputMotors(ctrlVal, 0)) {
+		return;
+	}
+	LatencyMonitorMark(LATENCY_STAGE_MOTOR);
+
+	AggregateSample(AGGREGATE_MOTOR_1, ctrlValMotor1);
+	AggregateSample(AGGREGATE_MOTOR_2, ctrlValMotor2);
+	AggregateSample(AGGREGATE_MOTOR_3, ctrlValMotor3);
+	AggregateSample(AGGREGATE_MOTOR_4, ctrlValMotor4);
 }
 
 /*
@@ -213,26 +331,24 @@ void PrintMotorControlValues(void) {
  * @retval None.
  */
 void MotorAllocationRaw(void) {
-	int32_t u1, u2, u3, u4, m1, m2, m3, m4;
+	Receiver_Snapshot_TypeDef receiverSnapshot;
+	float32_t u[MIXER_AXES_NBR];
+	int32_t m[MIXER_MAX_MOTORS];
 
-	/* Calculate raw control signals for throttle, roll, pitch, yaw */
-	u1 = (GetThrottleReceiverChannel()-INT16_MIN); // Re-scale to uint16
-	u2 = -u1*GetAileronReceiverChannel()/INT16_MAX;
-	u3 = -u1*GetElevatorReceiverChannel()/INT16_MAX;
-	u4 = -u1*GetRudderReceiverChannel()/INT16_MAX;
+	GetReceiverSnapshot(&receiverSnapshot);
 
-	/* Map raw control signals to motor output */
-	m1 = u1 + Motor1Properties.rollDir*u2 + Motor1Properties.pitchDir*u3 + Motor1Properties.yawDir*u4;
-	m2 = u1 + Motor2Properties.rollDir*u2 + Motor2Properties.pitchDir*u3 + Motor2Properties.yawDir*u4;
-	m3 = u1 + Motor3Properties.rollDir*u2 + Motor3Properties.pitchDir*u3 + Motor3Properties.yawDir*u4;
-	m4 = u1 + Motor4Properties.rollDir*u2 + Motor4Properties.pitchDir*u3 + Motor4Properties.yawDir*u4;
+	/* Calculate raw control signals for throttle, roll, pitch, yaw */
+	u[MIXER_THRUST_IDX] = (receiverSnapshot.Throttle-INT16_MIN); // Re-scale to uint16
+	u[MIXER_ROLL_IDX] = -u[MIXER_THRUST_IDX]*receiverSnapshot.Aileron/INT16_MAX;
+	u[MIXER_PITCH_IDX] = -u[MIXER_THRUST_IDX]*receiverSnapshot.Elevator/INT16_MAX;
+	u[MIXER_YAW_IDX] = -u[MIXER_THRUST_IDX]*receiverSnapshot.Rudder/INT16_MAX;
 
-	/* Saturate motor signal values [0, UINT16_MAX] */
-	SaturateMotorSignalValues(&m1, &m2, &m3, &m4);
+	/* Map raw control signals to desaturated motor output [0, UINT16_MAX] */
+	MotorMixerRaw(u, m);
 
-	if (IsReceiverActive()) {
+	if (receiverSnapshot.IsActive) {
 		/* Set the motor signal values */
-		SetMotors(m1, m2, m3, m4);
+		SetMotors(m[0], m[1], m[2], m[3]);
 	} else {
 		ShutdownMotors();
 	}
@@ -244,11 +360,34 @@ void MotorAllocationRaw(void) {
  * @retval None.
  */
 void ShutdownMotors(void) {
-	/* Set the output compare pulses to zero width */
-	__HAL_TIM_SetCompare(&MotorControlTimHandle, MOTOR1_CHANNEL, 0);
-	__HAL_TIM_SetCompare(&MotorControlTimHandle, MOTOR2_CHANNEL, 0);
-	__HAL_TIM_SetCompare(&MotorControlTimHandle, MOTOR3_CHANNEL, 0);
-	__HAL_TIM_SetCompare(&MotorControlTimHandle, MOTOR4_CHANNEL, 0);
+#if MOTOR_OUTPUT_IS_DSHOT || defined(FCB_HIL_MODE) || defined(DRONECAN_ESC_COMMANDS)
+	const uint16_t stop[MOTOR_OUTPUT_CHANNELS] = { 0, 0, 0, 0 };
+#endif
+
+#ifdef FCB_HIL_MODE
+	if (HilModeIsActive()) {
+		HilModeSetMotorValues(stop);
+	}
+#endif
+
+#if MOTOR_OUTPUT_IS_DSHOT
+	/* Send the motor stop command, DShot ESC:s expect frames to keep coming */
+	if (!IsMotorOutputBusy()) {
+		LoadMotorOutputs(stop, 0);
+		TriggerMotorOutput();
+	}
+#else
+	/* Set the output compare pulses to zero width, no further periods are triggered */
+	__HAL_TIM_SetCompare(&MotorControlTimHandle, MOTOR1_CHANNEL, MOTOR_NO_PULSE);
+	__HAL_TIM_SetCompare(&MotorControlTimHandle, MOTOR2_CHANNEL, MOTOR_NO_PULSE);
+	__HAL_TIM_SetCompare(&MotorControlTimHandle, MOTOR3_CHANNEL, MOTOR_NO_PULSE);
+	__HAL_TIM_SetCompare(&MotorControlTimHandle, MOTOR4_CHANNEL, MOTOR_NO_PULSE);
+#endif
+
+#ifdef DRONECAN_ESC_COMMANDS
+	/* DroneCAN ESC:s hold the latest command until their own timeout */
+	(void) DroneCanSendEscCommands(stop);
+#endif
 
 	/* Set the motor struct values to zero */
 	MotorControlValues.Motor1 = 0;
@@ -259,76 +398,159 @@ void ShutdownMotors(void) {
 
 /*
  * @brief  Allocates the desired thrust force and moments to corresponding motor action. Data has been fitted to map
- * 		   thrust force [N] and roll/pitch/yaw moments [Nm] to motor output signal values of each of the four motors.
+ * 		   thrust force [N] and roll/pitch/yaw moments [Nm] to motor output signal values of each motor, see
+ * 		   motor_mixer.c. The fits hold at the nominal battery voltage, the forces are scaled up as the battery sags,
+ * 		   see fcb_battery.h. The linear signal values of the mixer are then mapped through the thrust curve of each
+ * 		   motor, see thrust_curve.h. With FCB_SYSTEM_IDENTIFICATION the excitation is added to the moments first,
+ * 		   see system_identification.h.
  * @param  u1 : thrust force [N]
  * @param  u2 : roll moment [Nm]
  * @param  u3 : pitch moment [Nm]
  * @param  u4 : yaw moment [Nm]
+ * @param  achievedMoments : Destination roll, pitch & yaw moments [Nm] the motor limits left of u2-u4, for the
+ * 		   anti-windup of the moment controllers, see ApplyPIDAllocationFeedback()
  * @retval None.
  */
-void MotorAllocationPhysical(const float u1, const float u2, const float u3, const float u4) {
-	int32_t m1, m2, m3, m4;
+RAMFUNC void MotorAllocationPhysical(const float u1, const float u2, const float u3, const float u4,
+		float32_t achievedMoments[3]) {
+	PROFILE_SCOPE(PROFILE_PROBE_MOTOR_ALLOCATION);
+	const float32_t k = BATTERY_THRUST_COMPENSATION();
+	float32_t moments[3] = { u2, u3, u4 };
+	float32_t achieved[MIXER_AXES_NBR];
+	int32_t m[MIXER_MAX_MOTORS];
+
+#ifdef FCB_SYSTEM_IDENTIFICATION
+	AddSystemIdentificationExcitation(moments);
+#endif
+	const float32_t u[MIXER_AXES_NBR] = { k*u1, k*moments[0], k*moments[1], k*moments[2] };
 
 	/* Calculate physical motor control allocation. Remember that Z points down, so u1 will be negative. */
-	m1 = (int32_t) (-THRUST_ALLOC_COEFF*u1 - THRUST_ALLOC_OFFSET - ROLLPITCH_ALLOC_COEFF*u2 + ROLLPITCH_ALLOC_COEFF*u3 + YAW_ALLOC_COEFF*u4);
-	m2 = (int32_t) (-THRUST_ALLOC_COEFF*u1 - THRUST_ALLOC_OFFSET + ROLLPITCH_ALLOC_COEFF*u2 + ROLLPITCH_ALLOC_COEFF*u3 - YAW_ALLOC_COEFF*u4);
-	m3 = (int32_t) (-THRUST_ALLOC_COEFF*u1 - THRUST_ALLOC_OFFSET + ROLLPITCH_ALLOC_COEFF*u2 - ROLLPITCH_ALLOC_COEFF*u3 + YAW_ALLOC_COEFF*u4);
-	m4 = (int32_t) (-THRUST_ALLOC_COEFF*u1 - THRUST_ALLOC_OFFSET - ROLLPITCH_ALLOC_COEFF*u2 - ROLLPITCH_ALLOC_COEFF*u3 - YAW_ALLOC_COEFF*u4);
-
-	/* Saturate motor signal values [0, UINT16_MAX] */
-	SaturateMotorSignalValues(&m1, &m2, &m3, &m4);
+	MotorMixerPhysical(u, m, achieved);
+	LinearizeMotorThrust(m);
+	ToAchievedMoments(achieved, k, u2, u3, u4, moments, achievedMoments);
 
 	if (IsReceiverActive()) {
 		/* Set the motor signal values */
-		SetMotors(m1, m2, m3, m4);
+		SetMotors(m[0], m[1], m[2], m[3]);
 	} else {
 		ShutdownMotors();
 	}
 }
 
+#ifdef FCB_CONTROL_EXECUTIVE
 /*
- * @brief  Creates a task to sample print motor signal values over USB.
- * @param  sampleTime : Sets how often a sample should be printed.
- * @param  sampleDuration : Sets for how long sampling should be performed.
- * @retval MOTORCTRL_OK if thread started, else MOTORCTRL_ERROR.
+ * @brief  As MotorAllocationPhysical(), for the control executive. Uses no FreeRTOS API, nor the profiler, latency
+ *         monitor or telemetry aggregates, which the flight control task updates.
+ * @param  u1 : thrust force [N]
+ * @param  u2 : roll moment [Nm]
+ * @param  u3 : pitch moment [Nm]
+ * @param  u4 : yaw moment [Nm]
+ * @param  achievedMoments : Destination roll, pitch & yaw moments [Nm] the motor limits left of u2-u4
+ * @retval None.
  */
-MotorControlErrorStatus StartMotorControlSamplingTask(const uint16_t sampleTime, const uint32_t sampleDuration) {
-	if(sampleTime < MOTOR_CONTROL_PRINT_MINIMUM_SAMPLING_TIME)
-		motorControlPrintSampleTime = MOTOR_CONTROL_PRINT_MINIMUM_SAMPLING_TIME;
-	else
-		motorControlPrintSampleTime = sampleTime;
-
-	motorControlPrintSampleDuration = sampleDuration;
-
-	/* Motor control signal value print sampling handler thread creation
-	 * Task function pointer: MotorControlPrintSamplingTask
-	 * Task name: MOTORCTRL_PRINT_SAMPL
-	 * Stack depth: 2*configMINIMAL_STACK_SIZE
-	 * Parameter: NULL
-	 * Priority: MOTOR_CONTROL_PRINT_SAMPLING_TASK_PRIO (0 to configMAX_PRIORITIES-1 possible)
-	 * Handle: MotorControlPrintSamplingTaskHandle
-	 * */
-	if (pdPASS != xTaskCreate((pdTASK_CODE )MotorControlPrintSamplingTask, (signed portCHAR*)"MOTORCTRL_PRINT_SAMPL",
-			2*configMINIMAL_STACK_SIZE, NULL, MOTOR_CONTROL_PRINT_SAMPLING_TASK_PRIO, &MotorControlPrintSamplingTaskHandle)) {
-		ErrorHandler();
-		return MOTORCTRL_ERROR;
+RAMFUNC void MotorAllocationPhysicalFromISR(const float u1, const float u2, const float u3, const float u4,
+		float32_t achievedMoments[3]) {
+	const float32_t k = BATTERY_THRUST_COMPENSATION();
+	float32_t moments[3] = { u2, u3, u4 };
+	float32_t achieved[MIXER_AXES_NBR];
+	int32_t m[MIXER_MAX_MOTORS];
+	uint16_t ctrlVal[MOTOR_OUTPUT_CHANNELS];
+	uint8_t i;
+
+#ifdef FCB_SYSTEM_IDENTIFICATION
+	AddSystemIdentificationExcitation(moments);
+#endif
+	const float32_t u[MIXER_AXES_NBR] = { k*u1, k*moments[0], k*moments[1], k*moments[2] };
+
+	MotorMixerPhysical(u, m, achieved);
+	LinearizeMotorThrust(m);
+	ToAchievedMoments(achieved, k, u2, u3, u4, moments, achievedMoments);
+
+	if (IsReceiverActive()) {
+		for (i = 0; i < MOTOR_OUTPUT_CHANNELS; i++) {
+			ctrlVal[i] = (uint16_t) m[i];
+		}
+		(void) OutputMotors(ctrlVal, 0);
+	} else {
+		ShutdownMotors();
+	}
+}
+#endif
+
+/*
+ * @brief  Sets the motor outputs of the bench tests in idle mode, see motor_test.h and thrust_curve.h. The motors of
+ *         the stop mask get the ESC min pulse, or the DShot motor stop, instead of the idle pulse of a value of 0.
+ * @param  ctrlVal : values [0,65535] indicating amount of motor thrust, motors 1-4
+ * @param  stopMask : Bit 0 for motor 1 and so on, set for the motors to keep stopped
+ * @retval None.
+ */
+void SetBenchMotors(const uint16_t ctrlVal[MOTOR_OUTPUT_CHANNELS], const uint8_t stopMask) {
+	uint16_t benchVal[MOTOR_OUTPUT_CHANNELS];
+	uint8_t i;
+
+	for (i = 0; i < MOTOR_OUTPUT_CHANNELS; i++) {
+		benchVal[i] = (stopMask & (1 << i)) ? 0 : ctrlVal[i];
+	}
+
+	if (OutputMotors(benchVal, stopMask)) {
+		AggregateSample(AGGREGATE_MOTOR_1, benchVal[0]);
+		AggregateSample(AGGREGATE_MOTOR_2, benchVal[1]);
+		AggregateSample(AGGREGATE_MOTOR_3, benchVal[2]);
+		AggregateSample(AGGREGATE_MOTOR_4, benchVal[3]);
+	}
+}
+
+/*
+ * @brief  Sets the pulse widths of the analog protocols, effective from the next motor output on
+ * @param  outputs : Pulse widths, min <= idle < max within the pulse period
+ * @retval FCB_OK if set, FCB_ERR if not in idle mode or if the pulse widths are not valid
+ */
+FcbRetValType SetEscOutputs(const EscOutputsType* outputs) {
+	if (FLIGHT_CONTROL_IDLE != GetFlightControlMode() || !IsValidEscOutputs(outputs)) {
+		return FCB_ERR;
 	}
 
-	return MOTORCTRL_OK;
+	taskENTER_CRITICAL();
+	escMinPulse = outputs->minPulse*MOTOR_TICKS_PER_US;
+	escIdlePulse = outputs->idlePulse*MOTOR_TICKS_PER_US;
+	escMaxPulse = outputs->maxPulse*MOTOR_TICKS_PER_US;
+	taskEXIT_CRITICAL();
+
+	return FCB_OK;
 }
 
 /*
- * @brief  Stops motor control print sampling by deleting the task.
+ * @brief  Gets the pulse widths of the analog protocols
+ * @param  outputs : Destination of the pulse widths
+ * @retval None.
+ */
+void GetEscOutputs(EscOutputsType* outputs) {
+	taskENTER_CRITICAL();
+	outputs->minPulse = escMinPulse/MOTOR_TICKS_PER_US;
+	outputs->idlePulse = escIdlePulse/MOTOR_TICKS_PER_US;
+	outputs->maxPulse = escMaxPulse/MOTOR_TICKS_PER_US;
+	taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Saves the pulse widths of the analog protocols to flash
  * @param  None.
- * @retval MOTORCTRL_OK if task deleted, MOTORCTRL_ERROR if not.
+ * @retval FCB_OK if saved, FCB_ERR if not in idle mode or if writing the flash failed
  */
-MotorControlErrorStatus StopMotorControlSamplingTask(void) {
-	if(MotorControlPrintSamplingTaskHandle != NULL) {
-		vTaskDelete(MotorControlPrintSamplingTaskHandle);
-		MotorControlPrintSamplingTaskHandle = NULL;
-		return MOTORCTRL_OK;
+FcbRetValType SaveEscOutputs(void) {
+	EscOutputsType outputs;
+
+	/* The ESC outputs are a consistent set only while disarmed, in flight the mixer keeps changing them */
+	if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+		return FCB_ERR;
+	}
+
+	GetEscOutputs(&outputs);
+	if (FLASH_OK != WriteEscOutputsToFlash(&outputs)) {
+		return FCB_ERR;
 	}
-	return MOTORCTRL_ERROR;
+
+	return FCB_OK;
 }
 
 /*
@@ -351,99 +573,441 @@ uint16_t GetMotorValue(uint8_t motorNumber) {
     }
 }
 
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+/*
+ * @brief  Handles the DMA interrupt at the end of a DShot frame and at the end of the answer samples. At the end of the
+ *         frame its last, idle slot is being output, so the lines are released to the pull-ups before the ESC:s
+ *         answer. The timer then runs at the sample rate and requests the port samples through the same DMA channel,
+ *         until this interrupt turns everything back for the next frame.
+ * @param  None.
+ * @retval None.
+ */
+void MotorDshotDmaIRQHandler(void) {
+	DMA_HandleTypeDef* hdma = MotorControlTimHandle.hdma[MOTOR_DSHOT_DMA_ID];
+
+	__HAL_DMA_CLEAR_FLAG(hdma, __HAL_DMA_GET_TC_FLAG_INDEX(hdma));
+	__HAL_TIM_DISABLE_DMA(&MotorControlTimHandle, MOTOR_DSHOT_DMA_REQUEST);
+	__HAL_DMA_DISABLE(hdma);
+
+	if (DSHOT_SENDING == dshotPhase) {
+		MOTOR_PIN_PORT->MODER &= ~MOTOR_PINS_MODER_MASK;
+
+		/* CCR1 is 0, so the CC1 request comes at every sample period */
+		MotorControlTimHandle.Instance->ARR = DSHOT_TELEMETRY_SAMPLE_PERIOD - 1;
+		MotorControlTimHandle.Instance->CNT = 0;
+
+		hdma->Instance->CCR = DSHOT_RX_DMA_CONFIG;
+		hdma->Instance->CPAR = (uint32_t) &MOTOR_PIN_PORT->IDR;
+		hdma->Instance->CMAR = (uint32_t) dshotTelemetryBuffer;
+		hdma->Instance->CNDTR = DSHOT_TELEMETRY_SAMPLES;
+		dshotPhase = DSHOT_RECEIVING;
+		__HAL_DMA_ENABLE(hdma);
+		__HAL_TIM_ENABLE_DMA(&MotorControlTimHandle, MOTOR_DSHOT_DMA_REQUEST);
+	} else {
+		MotorControlTimHandle.Instance->ARR = DSHOT_BIT_PERIOD - 1;
+		MotorControlTimHandle.Instance->CNT = 0;
+
+		/* Rewound by TriggerMotorOutput() */
+		hdma->Instance->CCR = dshotTxDmaConfig;
+		hdma->Instance->CPAR = (uint32_t) &MotorControlTimHandle.Instance->DMAR;
+		hdma->Instance->CMAR = (uint32_t) dshotDmaBuffer;
+
+		/* The compare values are 0, i.e. idle high */
+		MOTOR_PIN_PORT->MODER |= MOTOR_PINS_MODER_AF;
+		isDshotAnswerPending = true;
+		dshotPhase = DSHOT_IDLE;
+	}
+}
+
+/*
+ * @brief  Gets the latest motor telemetry if it is newer than a given one. Double buffered, so that it can be read
+ *         from any context, e.g. the SENSORS task.
+ * @param  dstTelemetry : destination
+ * @param  lastSequence : sequence of the latest telemetry the caller has used
+ * @retval true if a newer telemetry was copied
+ */
+bool GetMotorTelemetry(MotorTelemetryType* dstTelemetry, const uint32_t lastSequence) {
+	uint32_t sequence;
+
+	do {
+		sequence = motorTelemetrySequence;
+		__DMB();
+		if (sequence == lastSequence) {
+			return false;
+		}
+		*dstTelemetry = motorTelemetry[sequence & 1];
+		__DMB();
+	} while (sequence != motorTelemetrySequence);
+
+	return true;
+}
+
+/*
+ * @brief  Prints the motor telemetry and the answer statistics
+ * @param  dst : destination string
+ * @param  dstSize : size of dst
+ * @retval Length of the string
+ */
+size_t PrintMotorTelemetry(char* dst, const size_t dstSize) {
+	MotorTelemetryType telemetry;
+	char rateString[16];
+	size_t length;
+	uint8_t i;
+
+	memset(&telemetry, 0, sizeof(telemetry));
+	(void) GetMotorTelemetry(&telemetry, UINT32_MAX);
+
+	length = (size_t) snprintf(dst, dstSize, "\nBidirectional DShot telemetry, %lu frames\n", telemetry.sequence);
+	for (i = 0; i < MOTOR_OUTPUT_CHANNELS && length < dstSize; i++) {
+		FormatFixed(rateString, sizeof(rateString), telemetry.rotationHz[i], 1);
+		length += (size_t) snprintf(dst + length, dstSize - length,
+				"M%u: %s, eRPM:%lu, rotation:%s [Hz], answers:%lu, lost:%lu\n", (unsigned int) (i + 1),
+				telemetry.isValid[i] ? "valid" : "STALE", telemetry.eRpm[i], rateString, motorTelemetryAnswers[i],
+				motorTelemetryLost[i]);
+	}
+
+	return length;
+}
+#endif
+
 /* Private functions ---------------------------------------------------------*/
 
-/**
- * @brief  Task code handles motor control signal print sampling
- * @param  argument : Unused parameter
- * @retval None
+/*
+ * @brief  Converts the moments achieved by the mixer back to the commanded ones, i.e. without the battery compensation
+ *         and the system identification excitation, so that they only differ where the motor limits took a part away
+ * @param  achieved : Thrust force [N] and roll, pitch & yaw moments [Nm] achieved by MotorMixerPhysical()
+ * @param  k : Battery thrust compensation the commands were scaled with
+ * @param  u2 : Commanded roll moment [Nm]
+ * @param  u3 : Commanded pitch moment [Nm]
+ * @param  u4 : Commanded yaw moment [Nm]
+ * @param  moments : Roll, pitch & yaw moments [Nm] with the excitation, before the compensation
+ * @param  achievedMoments : Destination roll, pitch & yaw moments [Nm]
+ * @retval None.
  */
-static void MotorControlPrintSamplingTask(void const *argument) {
-	(void) argument;
+static RAMFUNC void ToAchievedMoments(const float32_t achieved[MIXER_AXES_NBR], const float32_t k, const float u2,
+		const float u3, const float u4, const float32_t moments[3], float32_t achievedMoments[3]) {
+	achievedMoments[0] = achieved[MIXER_ROLL_IDX]/k - (moments[0] - u2);
+	achievedMoments[1] = achieved[MIXER_PITCH_IDX]/k - (moments[1] - u3);
+	achievedMoments[2] = achieved[MIXER_YAW_IDX]/k - (moments[2] - u4);
+}
 
-	portTickType xLastWakeTime;
-	portTickType xSampleStartTime;
+/*
+ * @brief  Converts the motor control values to the output of the selected protocol in one pass and loads them. The
+ *         timer compare values are preloaded, so the new values take effect together at the next update event.
+ * @param  ctrlVal : values [0,65535] indicating amount of motor thrust, motors 1-4, 0 for the stopped ones
+ * @param  stopMask : Motors to get the ESC min pulse instead of the idle pulse, see SetBenchMotors()
+ * @retval None.
+ */
+static void LoadMotorOutputs(const uint16_t ctrlVal[MOTOR_OUTPUT_CHANNELS], const uint8_t stopMask) {
+#if MOTOR_OUTPUT_IS_DSHOT
+	uint16_t frame;
+	uint8_t i, j;
+#ifdef MOTOR_ESC_TELEMETRY
+	/* One ESC at a time answers on the shared telemetry line */
+	const uint8_t telemetryRequest = EscTelemetryNextRequest();
+#endif
+
+	/* The stopped motors have a value of 0, the motor stop */
+	(void) stopMask;
+
+	for (i = 0; i < MOTOR_OUTPUT_CHANNELS; i++) {
+		/* 11 bit throttle (0 = motor stop), telemetry request bit, 4 bit checksum */
+		frame = (ctrlVal[i] == 0) ? 0
+				: DSHOT_MIN_THROTTLE + SCALE_MOTOR_VALUE(ctrlVal[i], DSHOT_MAX_THROTTLE - DSHOT_MIN_THROTTLE);
+#ifdef MOTOR_ESC_TELEMETRY
+		frame = (frame << 1) | (i == telemetryRequest ? 1 : 0);
+#else
+		frame <<= 1;
+#endif
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+		/* Inverted checksum, which asks for the eRPM answer */
+		frame = (frame << 4) | ((~(frame ^ (frame >> 4) ^ (frame >> 8))) & 0x0F);
+#else
+		frame = (frame << 4) | ((frame ^ (frame >> 4) ^ (frame >> 8)) & 0x0F);
+#endif
+
+		/* Most significant bit first */
+		for (j = 0; j < DSHOT_FRAME_BITS; j++) {
+			dshotDmaBuffer[j][i] = (frame & (0x8000 >> j)) ? DSHOT_BIT_1 : DSHOT_BIT_0;
+		}
+	}
+#else
+	uint32_t ccrVal[MOTOR_OUTPUT_CHANNELS];
+	uint8_t i;
+
+	/* PWM mode 2, the output is high from the compare value to the end of the period */
+	for (i = 0; i < MOTOR_OUTPUT_CHANNELS; i++) {
+		if (stopMask & (1 << i)) {
+			ccrVal[i] = MOTOR_PULSE_PERIOD + 1 - escMinPulse;
+		} else {
+			ccrVal[i] = MOTOR_PULSE_PERIOD + 1 - escIdlePulse - SCALE_MOTOR_VALUE(ctrlVal[i], escMaxPulse - escIdlePulse);
+		}
+	}
 
-	/* Initialise the xLastWakeTime variable with the current time */
-	xLastWakeTime = xTaskGetTickCount();
-	xSampleStartTime = xLastWakeTime;
+	__HAL_TIM_SetCompare(&MotorControlTimHandle, MOTOR1_CHANNEL, ccrVal[0]);
+	__HAL_TIM_SetCompare(&MotorControlTimHandle, MOTOR2_CHANNEL, ccrVal[1]);
+	__HAL_TIM_SetCompare(&MotorControlTimHandle, MOTOR3_CHANNEL, ccrVal[2]);
+	__HAL_TIM_SetCompare(&MotorControlTimHandle, MOTOR4_CHANNEL, ccrVal[3]);
+#endif
+}
 
-	for (;;) {
-		vTaskDelayUntil(&xLastWakeTime, motorControlPrintSampleTime);
+/*
+ * @brief  Loads and sends the motor outputs, unless the previous ones are still being sent, and keeps the values
+ * @param  ctrlVal : values [0,65535] indicating amount of motor thrust, motors 1-4
+ * @param  stopMask : Motors to keep stopped, see LoadMotorOutputs()
+ * @retval true if sent, false if dropped
+ */
+static RAMFUNC bool OutputMotors(const uint16_t ctrlVal[MOTOR_OUTPUT_CHANNELS], const uint8_t stopMask) {
+#ifdef FCB_HIL_MODE
+	/* Interlock: the values go to the simulator only, the outputs are never triggered and the ESCs see no pulses */
+	if (HilModeIsActive()) {
+		HilModeSetMotorValues(ctrlVal);
+		return true;
+	}
+#endif
 
-		PrintMotorControlValues();
+	/* Interlock: the WCET test runs the control path in idle mode, the outputs are never triggered */
+	if (WCET_TEST_IS_ACTIVE()) {
+		return true;
+	}
 
-		/* If sampling duration exceeded, delete task to stop sampling */
-		if (xTaskGetTickCount() >= xSampleStartTime + motorControlPrintSampleDuration * configTICK_RATE_HZ)
-			StopMotorControlSamplingTask();
+	if (IsMotorOutputBusy()) {
+		return false;
 	}
+
+	LoadMotorOutputs(ctrlVal, stopMask);
+	TriggerMotorOutput();
+	SCOPE_PROBE_MARK(SCOPE_PROBE_STAGE_MOTOR);
+#ifdef DRONECAN_ESC_COMMANDS
+	/* A command that finds the previous one pending is dropped like the timer outputs, the next period follows */
+	(void) DroneCanSendEscCommands(ctrlVal);
+#endif
+
+	MotorControlValues.Motor1 = ctrlVal[0];
+	MotorControlValues.Motor2 = ctrlVal[1];
+	MotorControlValues.Motor3 = ctrlVal[2];
+	MotorControlValues.Motor4 = ctrlVal[3];
+
+	return true;
 }
 
 /*
- * @brief  Sets the motor control PWM (sent to ESC) for motor 1
- * @param  ctrlVal: value [0,65535] indicating amount of motor thrust
- * @retval None.
+ * @brief  Checks if the previous motor output is still being sent
+ * @param  None.
+ * @retval 1 if busy, else 0
  */
-static void SetMotor1(const uint16_t ctrlVal) {
-	uint32_t ccrVal = ESC_MIN_OUTPUT + ctrlVal * (ESC_MAX_OUTPUT - ESC_MIN_OUTPUT) / UINT16_MAX;
-	__HAL_TIM_SetCompare(&MotorControlTimHandle, MOTOR1_CHANNEL, (uint16_t)ccrVal);
-	MotorControlValues.Motor1 = ctrlVal;
+static uint8_t IsMotorOutputBusy(void) {
+#if defined(MOTOR_DSHOT_BIDIRECTIONAL)
+	/* Until the answers have been sampled */
+	return (dshotPhase != DSHOT_IDLE);
+#elif MOTOR_OUTPUT_IS_DSHOT
+	DMA_HandleTypeDef* hdma = MotorControlTimHandle.hdma[MOTOR_DSHOT_DMA_ID];
+
+	return (hdma != NULL && hdma->Instance->CNDTR != 0);
+#else
+	/* The counter stops by itself at the end of the period */
+	return (MotorControlTimHandle.Instance->CR1 & TIM_CR1_CEN) != 0;
+#endif
 }
 
 /*
- * @brief  Sets the motor control PWM (sent to ESC) for motor 2
- * @param  ctrlVal: value [0,65535] indicating amount of motor thrust
+ * @brief  Starts the output of the values loaded by LoadMotorOutputs()
+ * @param  None.
  * @retval None.
  */
-static void SetMotor2(const uint16_t ctrlVal) {
-	uint32_t ccrVal = ESC_MIN_OUTPUT + ctrlVal * (ESC_MAX_OUTPUT - ESC_MIN_OUTPUT) / UINT16_MAX;
-	__HAL_TIM_SetCompare(&MotorControlTimHandle, MOTOR2_CHANNEL, (uint16_t)ccrVal);
-	MotorControlValues.Motor2 = ctrlVal;
+static void TriggerMotorOutput(void) {
+#if MOTOR_OUTPUT_IS_DSHOT
+	DMA_HandleTypeDef* hdma = MotorControlTimHandle.hdma[MOTOR_DSHOT_DMA_ID];
+
+	/* Not configured yet, e.g. when called by the error handler at startup */
+	if (hdma == NULL) {
+		return;
+	}
+
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+	/* Before the samples of the previous frame are overwritten */
+	if (isDshotAnswerPending) {
+		isDshotAnswerPending = false;
+		DecodeDshotTelemetry();
+	}
+	dshotPhase = DSHOT_SENDING;
+#endif
+
+	/* Rewind the DMA to the first bit, the transfer starts at the next CC1 event (CCR1 is 0 between frames). The
+	 * burst of each bit is applied at the following update event. */
+	__HAL_TIM_DISABLE_DMA(&MotorControlTimHandle, MOTOR_DSHOT_DMA_REQUEST);
+	__HAL_DMA_DISABLE(hdma);
+	hdma->Instance->CNDTR = DSHOT_FRAME_SLOTS * MOTOR_OUTPUT_CHANNELS;
+	__HAL_DMA_ENABLE(hdma);
+	__HAL_TIM_ENABLE_DMA(&MotorControlTimHandle, MOTOR_DSHOT_DMA_REQUEST);
+#else
+	/* Force an update event to apply the preloaded compare values together, then run one period */
+	MotorControlTimHandle.Instance->EGR = TIM_EGR_UG;
+	__HAL_TIM_ENABLE(&MotorControlTimHandle);
+#endif
 }
 
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
 /*
- * @brief  Sets the motor control PWM (sent to ESC) for motor 3
- * @param  ctrlVal: value [0,65535] indicating amount of motor thrust
+ * @brief  Decodes the answers to the previous frame from the port samples and publishes the motor telemetry. A motor
+ *         that misses an answer keeps its previous eRPM for DSHOT_TELEMETRY_MAX_ERRORS frames.
+ * @param  None.
  * @retval None.
  */
-static void SetMotor3(const uint16_t ctrlVal) {
-	uint32_t ccrVal = ESC_MIN_OUTPUT + ctrlVal * (ESC_MAX_OUTPUT - ESC_MIN_OUTPUT) / UINT16_MAX;
-	__HAL_TIM_SetCompare(&MotorControlTimHandle, MOTOR3_CHANNEL, (uint16_t)ccrVal);
-	MotorControlValues.Motor3 = ctrlVal;
+static void DecodeDshotTelemetry(void) {
+	DshotDecoder_TypeDef decoders[MOTOR_OUTPUT_CHANNELS];
+	uint32_t const sequence = motorTelemetrySequence + 1;
+	MotorTelemetryType* telemetry = &motorTelemetry[sequence & 1];
+	uint16_t previous = MOTOR_PINS; // Idle high
+	uint16_t changed;
+	uint32_t eRpm;
+	uint16_t i;
+	uint8_t j;
+
+	memset(decoders, 0, sizeof(decoders));
+	*telemetry = motorTelemetry[motorTelemetrySequence & 1];
+
+	/* One pass over the samples of all motors, which only looks closer at the edges */
+	for (i = 0; i < DSHOT_TELEMETRY_SAMPLES; i++) {
+		changed = (dshotTelemetryBuffer[i] ^ previous) & MOTOR_PINS;
+		previous = dshotTelemetryBuffer[i];
+		if (0 == changed) {
+			continue;
+		}
+		for (j = 0; j < MOTOR_OUTPUT_CHANNELS; j++) {
+			if (changed & motorPins[j]) {
+				DecodeDshotEdge(&decoders[j], i, (previous & motorPins[j]) != 0);
+			}
+		}
+	}
+
+	for (j = 0; j < MOTOR_OUTPUT_CHANNELS; j++) {
+		eRpm = DecodeDshotAnswer(&decoders[j]);
+		if (DSHOT_TELEMETRY_INVALID != eRpm) {
+			telemetry->isValid[j] = true;
+			telemetry->eRpm[j] = eRpm;
+			telemetry->rotationHz[j] = (float32_t) eRpm / (60.0f * (float32_t) (MOTOR_POLES / 2));
+			motorTelemetryErrors[j] = 0;
+			motorTelemetryAnswers[j]++;
+		} else {
+			motorTelemetryLost[j]++;
+			if (motorTelemetryErrors[j] < DSHOT_TELEMETRY_MAX_ERRORS) {
+				motorTelemetryErrors[j]++;
+			} else {
+				telemetry->isValid[j] = false;
+			}
+		}
+	}
+
+	telemetry->sequence = sequence;
+	__DMB();
+	motorTelemetrySequence = sequence;
 }
 
 /*
- * @brief  Sets the motor control PWM (sent to ESC) for motor 4
- * @param  ctrlVal: value [0,65535] indicating amount of motor thrust
+ * @brief  Adds the run of bits up to an edge of a motor line to its answer. Each edge is a 1 and the bits until the
+ *         next one are 0, which gives the GCR code.
+ * @param  decoder : answer of the motor
+ * @param  sample : index of the edge
+ * @param  level : line level after the edge
  * @retval None.
  */
-static void SetMotor4(const uint16_t ctrlVal) {
-	uint32_t ccrVal = ESC_MIN_OUTPUT + ctrlVal * (ESC_MAX_OUTPUT - ESC_MIN_OUTPUT) / UINT16_MAX;
-	__HAL_TIM_SetCompare(&MotorControlTimHandle, MOTOR4_CHANNEL, (uint16_t)ccrVal);
-	MotorControlValues.Motor4 = ctrlVal;
+static void DecodeDshotEdge(DshotDecoder_TypeDef* decoder, const uint16_t sample, const bool level) {
+	uint32_t runBits;
+
+	if (!decoder->isStarted) {
+		/* The start bit is the first falling edge, the line idles high before it */
+		if (!level) {
+			decoder->isStarted = true;
+			decoder->level = level;
+			decoder->lastEdge = sample;
+		}
+		return;
+	}
+
+	/* The answer is complete, or broken */
+	if (decoder->bits >= DSHOT_TELEMETRY_BITS) {
+		return;
+	}
+
+	/* Rounded to whole bits, which takes up the drift between the ESC clock and the sample clock */
+	runBits = ((uint32_t) (sample - decoder->lastEdge) * DSHOT_TELEMETRY_SAMPLE_PERIOD + DSHOT_TELEMETRY_BIT_PERIOD/2)
+			/ DSHOT_TELEMETRY_BIT_PERIOD;
+
+	/* GCR codes have no more than two zeros in a row */
+	if (0 == runBits || runBits > 3) {
+		decoder->bits = DSHOT_TELEMETRY_BITS + 1;
+		return;
+	}
+
+	decoder->value = (decoder->value << runBits) | (1U << (runBits - 1));
+	decoder->bits += runBits;
+	decoder->level = level;
+	decoder->lastEdge = sample;
+}
+
+/*
+ * @brief  Decodes the answer of a motor, a 12 bit eRPM period with a 4 bit checksum, GCR coded
+ * @param  decoder : answer of the motor
+ * @retval eRPM, 0 for a stopped motor, DSHOT_TELEMETRY_INVALID if there was no valid answer
+ */
+static uint32_t DecodeDshotAnswer(const DshotDecoder_TypeDef* decoder) {
+	uint32_t value = decoder->value;
+	uint32_t decoded = 0;
+	uint32_t period;
+	uint32_t checksum;
+	uint8_t fillBits;
+	uint8_t nibble;
+	uint8_t i;
+
+	if (!decoder->isStarted || decoder->bits > DSHOT_TELEMETRY_BITS || decoder->bits + 3 < DSHOT_TELEMETRY_BITS) {
+		return DSHOT_TELEMETRY_INVALID;
+	}
+
+	/* A last run at the high level has no edge at its end, it is what is left of the answer */
+	if (decoder->bits < DSHOT_TELEMETRY_BITS) {
+		fillBits = DSHOT_TELEMETRY_BITS - decoder->bits;
+		value = (value << fillBits) | (1U << (fillBits - 1));
+	}
+
+	/* The start bit is left out, the first nibble received is the most significant */
+	for (i = 0; i < 4; i++) {
+		nibble = gcrDecodeTable[value & 0x1F];
+		if (0xFF == nibble) {
+			return DSHOT_TELEMETRY_INVALID;
+		}
+		decoded |= (uint32_t) nibble << (4*i);
+		value >>= 5;
+	}
+
+	checksum = decoded ^ (decoded >> 4) ^ (decoded >> 8) ^ (decoded >> 12);
+	if ((checksum & 0x0F) != 0x0F) {
+		return DSHOT_TELEMETRY_INVALID;
+	}
+
+	decoded >>= 4;
+	if (DSHOT_TELEMETRY_STOPPED_PERIOD == decoded) {
+		return 0;
+	}
+
+	/* Electrical period [us] with a 3 bit exponent and a 9 bit mantissa */
+	period = (decoded & 0x1FF) << (decoded >> 9);
+	if (0 == period) {
+		return DSHOT_TELEMETRY_INVALID;
+	}
+
+	return (60000000U + period/2) / period;
 }
+#endif
 
-static void SaturateMotorSignalValues(int32_t* m1, int32_t* m2, int32_t* m3, int32_t* m4)
-{
-	/* Check unsigned 16-bit overflow */
-	if (!IS_NOT_GREATER_UINT16_MAX(*m1))
-		*m1 = UINT16_MAX;
-	if (!IS_NOT_GREATER_UINT16_MAX(*m2))
-		*m2 = UINT16_MAX;
-	if (!IS_NOT_GREATER_UINT16_MAX(*m3))
-		*m3 = UINT16_MAX;
-	if (!IS_NOT_GREATER_UINT16_MAX(*m4))
-		*m4 = UINT16_MAX;
-
-	/* Check unsigned 16-bit underflow (less than zero) */
-	if (!IS_POS(*m1))
-		*m1 = 0;
-	if (!IS_POS(*m2))
-		*m2 = 0;
-	if (!IS_POS(*m3))
-		*m3 = 0;
-	if (!IS_POS(*m4))
-		*m4 = 0;
+/*
+ * @brief  Checks the pulse widths of the analog protocols
+ * @param  outputs : Pulse widths [us]
+ * @retval true if min <= idle < max and the max pulse ends within its period, else false
+ */
+static bool IsValidEscOutputs(const EscOutputsType* outputs) {
+	return outputs->minPulse > 0 && outputs->minPulse <= outputs->idlePulse && outputs->idlePulse < outputs->maxPulse
+			&& (uint32_t) outputs->maxPulse*MOTOR_TICKS_PER_US <= MOTOR_PULSE_PERIOD - MOTOR_PULSE_MIN_GAP;
 }
 
 /**
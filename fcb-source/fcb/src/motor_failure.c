@@ -0,0 +1,465 @@
+/******************************************************************************
+ * @file    motor_failure.c
+ * @brief   Motor failure detection and the degraded mode of the stabilized
+ *          flight modes, see motor_failure.h
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "motor_failure.h"
+
+#include "flight_mode.h"
+#include "motor_control.h"
+#include "motor_mixer.h"
+#include "state_estimation.h"
+#include "esc_telemetry.h"
+#include "system_identification.h"
+#include "flash.h"
+#include "fixed_format.h"
+#include "deferred_log.h"
+#include "common.h"
+#include "fcb_port.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Private variables ---------------------------------------------------------*/
+
+static const char* const motorFailureCauseNames[MOTOR_FAILURE_CAUSE_NBR] = {
+    "none", "residual", "desync", "stopped"
+};
+
+/* Set by the CLI with the scheduler suspended, read by the flight control task */
+static MotorFailureSettingsType motorFailureSettings = {
+    MOTOR_FAILURE_DEFAULT_DETECTION_TIME, MOTOR_FAILURE_DEFAULT_RESIDUAL_SHARE
+};
+
+/* Written by the flight control task, read by the other tasks with the scheduler suspended */
+static MotorFailureStatusType motorFailureStatus;
+
+/* Used by the flight control task only */
+static bool isResidualStarted = false;
+static float32_t previousRates[2];                  // Roll & pitch rates of the previous control cycle [rad/s]
+static float32_t filteredAcceleration[2];           // [rad/s^2]
+static float32_t filteredMoments[2];                // Commanded [Nm]
+static float32_t residualTrim[2];                   // [Nm]
+static uint8_t candidateMotor = MIXER_NO_FAILED_MOTOR;
+static float32_t candidateDuration = 0.0f;          // [s]
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+static uint32_t motorTelemetrySequence = 0;
+static float32_t stoppedDuration[MOTOR_OUTPUT_CHANNELS];    // [s]
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+static void ResetMotorFailureDetection(void);
+static bool IsResidualDetectionActive(void);
+static uint8_t UpdateMomentResidual(const MotorFailureSettingsType* settings, const float32_t dt);
+static uint8_t GetTelemetryFailedMotor(const float32_t dt, MotorFailureCauseType* dstCause);
+static bool IsValidMotorFailureSettings(const MotorFailureSettingsType* settings);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Loads the stored settings, or keeps the defaults if there are none or they are not valid
+ * @param  None.
+ * @retval None.
+ */
+void InitMotorFailureDetection(void) {
+    MotorFailureSettingsType settings;
+
+    if (FLASH_OK == ReadMotorFailureSettingsFromFlash(&settings) && IsValidMotorFailureSettings(&settings)) {
+        motorFailureSettings = settings;
+    }
+    ResetMotorFailureDetection();
+}
+
+/*
+ * @brief  Evaluates the moment residual and the telemetry of the latest control cycle and latches a failure once one
+ *         is detected, which switches the mixer to the degraded mode. The latch and the mixer are released in the
+ *         disarmed state.
+ * @param  None.
+ * @retval true on the control cycle a failure is detected, else false
+ */
+bool UpdateMotorFailureDetection(void) {
+    const enum FlightControlMode mode = GetFlightControlMode();
+    const float32_t dt = GetFlightControlSamplePeriod();
+    MotorFailureSettingsType settings;
+    MotorFailureCauseType cause = MOTOR_FAILURE_CAUSE_NONE;
+    uint8_t motor, residualMotor, flags = 0;
+    bool isDegraded;
+
+    FCB_SUSPEND_SCHEDULER();
+    settings = motorFailureSettings;
+    FCB_RESUME_SCHEDULER();
+
+    if (motorFailureStatus.isFailed && FLIGHT_MODE_DISARMED == GetFlightModeState()) {
+        (void) MotorMixerSetFailedMotor(MIXER_NO_FAILED_MOTOR);
+        motorFailureStatus.isFailed = false;
+        motorFailureStatus.isDegraded = false;
+    }
+
+    /* Watched in the flying states that mix physical commands only, with a fresh start on every one */
+    if (FLIGHT_CONTROL_IDLE == mode || FLIGHT_CONTROL_RAW == mode || motorFailureStatus.isFailed) {
+        ResetMotorFailureDetection();
+        motorFailureStatus.flags = motorFailureStatus.isFailed ?
+                (uint8_t) (MOTOR_FAILURE_FLAG_DETECTED | ((motorFailureStatus.motor + 1) << 4)) : 0;
+        return false;
+    }
+
+    motor = GetTelemetryFailedMotor(dt, &cause);
+    if (MIXER_NO_FAILED_MOTOR != motor) {
+        flags |= MOTOR_FAILURE_FLAG_TELEMETRY;
+    }
+
+    residualMotor = UpdateMomentResidual(&settings, dt);
+    if (MIXER_NO_FAILED_MOTOR != residualMotor) {
+        flags |= MOTOR_FAILURE_FLAG_RESIDUAL;
+        if (MOTOR_FAILURE_CAUSE_NONE == cause && candidateDuration >= settings.detectionTime) {
+            motor = residualMotor;
+            cause = MOTOR_FAILURE_CAUSE_RESIDUAL;
+        }
+    }
+
+    if (MOTOR_FAILURE_CAUSE_NONE == cause) {
+        motorFailureStatus.flags = flags;
+        return false;
+    }
+
+    isDegraded = (FCB_OK == MotorMixerSetFailedMotor(motor));
+
+    FCB_SUSPEND_SCHEDULER();
+    motorFailureStatus.isFailed = true;
+    motorFailureStatus.isDegraded = isDegraded;
+    motorFailureStatus.motor = motor;
+    motorFailureStatus.cause = cause;
+    motorFailureStatus.flags = flags | MOTOR_FAILURE_FLAG_DETECTED | (uint8_t) ((motor + 1) << 4);
+    motorFailureStatus.failures++;
+    motorFailureStatus.timestamp = (uint32_t) xTaskGetTickCount() * portTICK_RATE_MS;
+    FCB_RESUME_SCHEDULER();
+
+    if (isDegraded) {
+        LOG2("MOTOR FAILURE: motor %u lost (%s), yaw given up, descend and land", motor + 1,
+                motorFailureCauseNames[cause]);
+    } else {
+        LOG2("MOTOR FAILURE: motor %u lost (%s), the other motors cannot hold the attitude", motor + 1,
+                motorFailureCauseNames[cause]);
+    }
+
+    return true;
+}
+
+/*
+ * @brief  Checks if a failure is latched
+ * @param  None.
+ * @retval true from a detected failure until disarmed, else false
+ */
+bool IsMotorFailureDetected(void) {
+    return motorFailureStatus.isFailed;
+}
+
+/*
+ * @brief  Limits the references of the stabilized flight modes for a controlled descent while a failure is latched
+ * @param  refSignals : References to limit
+ * @retval true if limited, else false
+ */
+bool LimitMotorFailureRefSignals(RefSignals_TypeDef* refSignals) {
+    if (!motorFailureStatus.isFailed) {
+        return false;
+    }
+
+    refSignals->zVelocity = fmaxf(refSignals->zVelocity, MOTOR_FAILURE_DESCENT_VELOCITY);
+    refSignals->rollAngle = fmaxf(-MOTOR_FAILURE_MAX_TILT, fminf(refSignals->rollAngle, MOTOR_FAILURE_MAX_TILT));
+    refSignals->pitchAngle = fmaxf(-MOTOR_FAILURE_MAX_TILT, fminf(refSignals->pitchAngle, MOTOR_FAILURE_MAX_TILT));
+    refSignals->yawAngleRate = 0.0f;
+
+    return true;
+}
+
+/*
+ * @brief  Sets the settings, effective from the next control cycle
+ * @param  settings : Detection time and residual share, see MotorFailureSettingsType
+ * @retval FCB_OK if set, FCB_ERR if the time or the share is out of range
+ */
+FcbRetValType SetMotorFailureSettings(const MotorFailureSettingsType* settings) {
+    if (!IsValidMotorFailureSettings(settings)) {
+        return FCB_ERR;
+    }
+
+    FCB_SUSPEND_SCHEDULER();
+    motorFailureSettings = *settings;
+    FCB_RESUME_SCHEDULER();
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Gets the settings
+ * @param  settings : Destination of the settings
+ * @retval None.
+ */
+void GetMotorFailureSettings(MotorFailureSettingsType* settings) {
+    FCB_SUSPEND_SCHEDULER();
+    *settings = motorFailureSettings;
+    FCB_RESUME_SCHEDULER();
+}
+
+/*
+ * @brief  Saves the settings to flash
+ * @param  None.
+ * @retval FCB_OK if saved, FCB_ERR if not in idle mode or if writing the flash failed
+ */
+FcbRetValType SaveMotorFailureSettings(void) {
+    MotorFailureSettingsType settings;
+
+    /* Saved while disarmed, when the settings are not in use by a motor failure response */
+    if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        return FCB_ERR;
+    }
+
+    GetMotorFailureSettings(&settings);
+    if (FLASH_OK != WriteMotorFailureSettingsToFlash(&settings)) {
+        return FCB_ERR;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Gets the status of the detection
+ * @param  dstStatus : Destination of the status
+ * @retval None.
+ */
+void GetMotorFailureStatus(MotorFailureStatusType* dstStatus) {
+    FCB_SUSPEND_SCHEDULER();
+    *dstStatus = motorFailureStatus;
+    FCB_RESUME_SCHEDULER();
+}
+
+/*
+ * @brief  Gets the name of a failure cause
+ * @param  cause : Failure cause
+ * @retval The name
+ */
+const char* GetMotorFailureCauseName(const MotorFailureCauseType cause) {
+    return (cause < MOTOR_FAILURE_CAUSE_NBR) ? motorFailureCauseNames[cause] : "unknown";
+}
+
+size_t PrintMotorFailure(char* dst, const size_t dstSize) {
+    MotorFailureSettingsType settings;
+    MotorFailureStatusType status;
+    float32_t values[4];
+    size_t length;
+
+    GetMotorFailureSettings(&settings);
+    GetMotorFailureStatus(&status);
+
+    values[0] = settings.detectionTime;
+    values[1] = settings.residualShare;
+    values[2] = status.residual[0];
+    values[3] = status.residual[1];
+    length = FormatFixedList(dst, dstSize,
+            "Motor failure detection: detection time %1.3f s, residual share %1.2f\r\n"
+            "Moment residual: roll %1.3f Nm, pitch %1.3f Nm\r\n", values, 4);
+    if (length < dstSize) {
+        length += (size_t) snprintf(dst + length, dstSize - length,
+                "%s, %lu failures, latest motor %u %s at %lu ms\r\n",
+                status.isFailed ? (status.isDegraded ? "FAILED, degraded until disarmed" : "FAILED, not degraded")
+                : "no failure", status.failures, status.motor + 1, GetMotorFailureCauseName(status.cause),
+                status.timestamp);
+    }
+
+    return (length < dstSize) ? length : dstSize - 1;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Restarts the residual filters and the condition durations
+ * @param  None.
+ * @retval None.
+ */
+static void ResetMotorFailureDetection(void) {
+    isResidualStarted = false;
+    candidateMotor = MIXER_NO_FAILED_MOTOR;
+    candidateDuration = 0.0f;
+    motorFailureStatus.residual[0] = motorFailureStatus.residual[1] = 0.0f;
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+    memset(stoppedDuration, 0, sizeof(stoppedDuration));
+#endif
+}
+
+/*
+ * @brief  Checks if the commanded moments are the ones applied. The system identification adds its excitation in the
+ *         motor allocation, past the commands.
+ * @param  None.
+ * @retval true if the residual is valid, else false
+ */
+static bool IsResidualDetectionActive(void) {
+#ifdef FCB_SYSTEM_IDENTIFICATION
+    SysIdStatusType sysIdStatus;
+
+    GetSystemIdentificationStatus(&sysIdStatus);
+    if (SYSID_RUNNING == sysIdStatus.state) {
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+/*
+ * @brief  Updates the roll & pitch moment residual and the motor whose commanded moment it matches. The moment a motor
+ *         gives is its mixer factors times AT*LENGTH_ARM times its motor signal, so its loss leaves the negative of
+ *         it in the residual.
+ * @param  settings : Settings
+ * @param  dt : Control cycle period [s]
+ * @retval Index of the motor the residual matches, MIXER_NO_FAILED_MOTOR if none. The time it has matched is in
+ *         candidateDuration.
+ */
+static uint8_t UpdateMomentResidual(const MotorFailureSettingsType* settings, const float32_t dt) {
+    const float32_t inertia[2] = { IXX, IYY };
+    const float32_t filterGain = dt / (MOTOR_FAILURE_FILTER_TIME + dt);
+    const float32_t trimGain = dt / (MOTOR_FAILURE_TRIM_TIME + dt);
+    MotorMixerSettings_TypeDef mixer;
+    float32_t rates[3], moments[2], residual[2], signature[2];
+    float32_t share, bestShare = 0.0f;
+    uint8_t i, motor, bestMotor = MIXER_NO_FAILED_MOTOR;
+    uint16_t command;
+
+    GetUnbiasedBodyRates(rates);
+    moments[0] = GetRollControlSignal();
+    moments[1] = GetPitchControlSignal();
+
+    if (!isResidualStarted) {
+        for (i = 0; i < 2; i++) {
+            previousRates[i] = rates[i];
+            filteredAcceleration[i] = 0.0f;
+            filteredMoments[i] = moments[i];
+            residualTrim[i] = -moments[i];
+        }
+        isResidualStarted = true;
+        return MIXER_NO_FAILED_MOTOR;
+    }
+
+    for (i = 0; i < 2; i++) {
+        filteredAcceleration[i] += filterGain*((rates[i] - previousRates[i])/dt - filteredAcceleration[i]);
+        filteredMoments[i] += filterGain*(moments[i] - filteredMoments[i]);
+        previousRates[i] = rates[i];
+        residual[i] = inertia[i]*filteredAcceleration[i] - filteredMoments[i];
+    }
+
+    if (settings->detectionTime <= 0.0f || !IsResidualDetectionActive()) {
+        candidateDuration = 0.0f;
+        return MIXER_NO_FAILED_MOTOR;
+    }
+
+    MotorMixerGetSettings(&mixer);
+    for (motor = 0; motor < mixer.nbrOfMotors; motor++) {
+        command = GetMotorValue(motor + 1);
+        if (command < MOTOR_FAILURE_MIN_COMMAND) {
+            continue;
+        }
+
+        /* The share of the moment of the motor that is missing */
+        signature[0] = -AT*LENGTH_ARM*mixer.factors[motor][MIXER_ROLL_IDX]*command;
+        signature[1] = -AT*LENGTH_ARM*mixer.factors[motor][MIXER_PITCH_IDX]*command;
+        share = ((residual[0] - residualTrim[0])*signature[0] + (residual[1] - residualTrim[1])*signature[1])
+                / (signature[0]*signature[0] + signature[1]*signature[1]);
+        if (share > bestShare) {
+            bestShare = share;
+            bestMotor = motor;
+        }
+    }
+
+    if (bestShare < settings->residualShare) {
+        bestMotor = MIXER_NO_FAILED_MOTOR;
+    }
+
+    /* The trim follows the residual while no motor is suspected, so that a failure is not trimmed out */
+    if (MIXER_NO_FAILED_MOTOR == bestMotor) {
+        residualTrim[0] += trimGain*(residual[0] - residualTrim[0]);
+        residualTrim[1] += trimGain*(residual[1] - residualTrim[1]);
+    }
+    motorFailureStatus.residual[0] = residual[0] - residualTrim[0];
+    motorFailureStatus.residual[1] = residual[1] - residualTrim[1];
+
+    if (bestMotor != candidateMotor) {
+        candidateMotor = bestMotor;
+        candidateDuration = 0.0f;
+    }
+    if (MIXER_NO_FAILED_MOTOR != candidateMotor) {
+        candidateDuration += dt;
+    }
+
+    return candidateMotor;
+}
+
+/*
+ * @brief  Checks the ESC telemetry and the motor rotation rates for a failed motor, the ones that are built in
+ * @param  dt : Control cycle period [s]
+ * @param  dstCause : Destination of the cause, left as is if no motor has failed
+ * @retval Index of the failed motor, MIXER_NO_FAILED_MOTOR if none
+ */
+static uint8_t GetTelemetryFailedMotor(const float32_t dt, MotorFailureCauseType* dstCause) {
+#ifdef MOTOR_ESC_TELEMETRY
+    EscTelemetryType escTelemetry[MOTOR_OUTPUT_CHANNELS];
+#endif
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+    static MotorTelemetryType motorTelemetry;
+#endif
+    uint8_t motor;
+
+    (void) dt;
+    (void) dstCause;
+    (void) motor;
+
+#ifdef MOTOR_ESC_TELEMETRY
+    GetEscTelemetry(escTelemetry);
+    for (motor = 0; motor < MOTOR_OUTPUT_CHANNELS; motor++) {
+        if (ESC_HEALTH_DESYNC == escTelemetry[motor].health) {
+            *dstCause = MOTOR_FAILURE_CAUSE_DESYNC;
+            return motor;
+        }
+    }
+#endif
+
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+    /* The latest answers are kept between the frames, a stopped motor keeps counting */
+    if (GetMotorTelemetry(&motorTelemetry, motorTelemetrySequence)) {
+        motorTelemetrySequence = motorTelemetry.sequence;
+    }
+    for (motor = 0; motor < MOTOR_OUTPUT_CHANNELS; motor++) {
+        if (motorTelemetry.isValid[motor] && motorTelemetry.eRpm[motor] < MOTOR_FAILURE_MIN_ERPM
+                && GetMotorValue(motor + 1) >= MOTOR_FAILURE_MIN_COMMAND) {
+            stoppedDuration[motor] += dt;
+        } else {
+            stoppedDuration[motor] = 0.0f;
+        }
+        if (stoppedDuration[motor] >= MOTOR_FAILURE_STOPPED_TIME) {
+            *dstCause = MOTOR_FAILURE_CAUSE_STOPPED;
+            return motor;
+        }
+    }
+#endif
+
+    return MIXER_NO_FAILED_MOTOR;
+}
+
+/*
+ * @brief  Checks the settings against the limits of motor_failure.h
+ * @param  settings : Settings
+ * @retval true if valid, else false
+ */
+static bool IsValidMotorFailureSettings(const MotorFailureSettingsType* settings) {
+    return settings->detectionTime >= 0.0f && settings->detectionTime <= MOTOR_FAILURE_MAX_TIME
+            && settings->residualShare > 0.0f && settings->residualShare <= 1.0f;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
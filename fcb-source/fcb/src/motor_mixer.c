@@ -0,0 +1,780 @@
+/******************************************************************************
+ * @brief   Motor mixer. The thrust and roll, pitch & yaw commands are mapped
+ *          to the motors with one matrix multiplication, the matrix is built
+ *          from per motor factors stored in flash. The physical commands are
+ *          allocated in per motor thrust [N], which the thrust fit of the
+ *          motors then maps to the linear motor signal, and the thrust curves
+ *          of thrust_curve.h are applied last by the caller. The result is
+ *          desaturated within per motor command limits by priority: the roll &
+ *          pitch are scaled down if the limits cannot hold their spread, the
+ *          yaw is then scaled into what is left, unless the priority setting
+ *          scales it with the roll & pitch, and the collective thrust is
+ *          shifted last so that no motor is saturated. The commands achieved
+ *          by the allocation are returned to the caller, e.g. for the
+ *          anti-windup of the controllers. All MIXER_MAX_MOTORS rows are
+ *          always computed, so the execution time does not depend on the
+ *          number of motors. With FCB_AIRFRAME_FIXED_MIXER the physical mixer
+ *          is instead compiled for the layout of FCB_AIRFRAME, see airframe.h.
+ *
+ *          Once a motor has failed, see motor_failure.h, the physical commands
+ *          are mixed with a degraded matrix instead, which allocates the
+ *          thrust, roll & pitch to the remaining motors and leaves the yaw
+ *          uncontrolled, and the failed motor is given the idle output.
+ *
+ * @license
+ * Dragonfly FCB firmware to control the Dragonfly quadrotor UAV
+ * Copyright (C) 2016  ÅF Technology South: Dragonfly Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *****************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "motor_mixer.h"
+
+#include "motor_control.h"
+#include "flight_control.h"
+#include "fcb_error.h"
+#include "common.h"
+#include "fcb_port.h"
+
+#include <string.h>
+#include <stdbool.h>
+#include <float.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+    uint8_t nbrOfMotors;
+    const float32_t (*factors)[MIXER_AXES_NBR]; // In motor order, see MotorMixerSettings_TypeDef
+} MixerGeometryDef_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define MIXER_DEFAULT_GEOMETRY  ((MixerGeometry_TypeDef) FCB_AIRFRAME)
+
+#ifdef FCB_AIRFRAME_FIXED_MIXER
+#if (AIRFRAME_NBR_OF_MOTORS > MOTOR_OUTPUT_CHANNELS)
+#error "FCB_AIRFRAME has more motors than there are motor outputs"
+#endif
+
+/* Motor thrust [N] per command unit of FCB_AIRFRAME, as ApplySettings() computes them. The column sums of squares of
+ * the symmetric layouts are the number of motors for the thrust & yaw, and half of it for the roll & pitch. */
+#define AIRFRAME_THRUST_UNIT        (-1.0f/AIRFRAME_NBR_OF_MOTORS)
+#define AIRFRAME_ROLLPITCH_UNIT     (2.0f/LENGTH_ARM/AIRFRAME_NBR_OF_MOTORS)
+#define AIRFRAME_YAW_UNIT           (AT/AQ/AIRFRAME_NBR_OF_MOTORS)
+#endif
+
+/* Allocation without stored settings: roll & pitch first and the whole motor command range */
+#define MIXER_DEFAULT_PRIORITY      MIXER_PRIORITY_ROLLPITCH_YAW_THRUST
+#define MIXER_DEFAULT_MIN_COMMAND   0.0f
+#define MIXER_DEFAULT_MAX_COMMAND   1.0f
+
+/* Private macro -------------------------------------------------------------*/
+
+#ifdef FCB_AIRFRAME_FIXED_MIXER
+/* Thrust, roll & pitch and yaw part of a motor of FCB_AIRFRAME, the factor and unit products are constants */
+#define MIX_AIRFRAME_MOTOR(M, U) do { \
+        thrust[M] = airframeFactors[M][MIXER_THRUST_IDX]*AIRFRAME_THRUST_UNIT*(U)[MIXER_THRUST_IDX]; \
+        rollPitch[M] = airframeFactors[M][MIXER_ROLL_IDX]*AIRFRAME_ROLLPITCH_UNIT*(U)[MIXER_ROLL_IDX] \
+                + airframeFactors[M][MIXER_PITCH_IDX]*AIRFRAME_ROLLPITCH_UNIT*(U)[MIXER_PITCH_IDX]; \
+        yaw[M] = airframeFactors[M][MIXER_YAW_IDX]*AIRFRAME_YAW_UNIT*(U)[MIXER_YAW_IDX]; \
+    } while (0)
+#endif
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Motor thrust [N] per unit thrust force [N], roll & pitch moment [Nm] and yaw moment [Nm]. The drag torque follows the
+ * thrust as AQ/AT, since it is AQ*m and the thrust AT*m + BT. */
+static const float32_t physicalCommandUnits[MIXER_AXES_NBR] = {
+    -1.0f, 1.0f/LENGTH_ARM, 1.0f/LENGTH_ARM, AT/AQ
+};
+
+static const float32_t quadXFactors[AIRFRAME_QUAD_X_MOTORS][MIXER_AXES_NBR] = AIRFRAME_QUAD_X_FACTORS;
+static const float32_t quadPlusFactors[AIRFRAME_QUAD_PLUS_MOTORS][MIXER_AXES_NBR] = AIRFRAME_QUAD_PLUS_FACTORS;
+static const float32_t hexXFactors[AIRFRAME_HEX_X_MOTORS][MIXER_AXES_NBR] = AIRFRAME_HEX_X_FACTORS;
+static const float32_t octoXFactors[AIRFRAME_OCTO_X_MOTORS][MIXER_AXES_NBR] = AIRFRAME_OCTO_X_FACTORS;
+
+/* Indexed by MixerGeometry_TypeDef */
+static const MixerGeometryDef_TypeDef mixerGeometries[MIXER_GEOMETRY_NBR] = {
+    { AIRFRAME_QUAD_X_MOTORS, quadXFactors },
+    { AIRFRAME_QUAD_PLUS_MOTORS, quadPlusFactors },
+    { AIRFRAME_HEX_X_MOTORS, hexXFactors },
+    { AIRFRAME_OCTO_X_MOTORS, octoXFactors }
+};
+
+#ifdef FCB_AIRFRAME_FIXED_MIXER
+static const float32_t airframeFactors[AIRFRAME_NBR_OF_MOTORS][MIXER_AXES_NBR] = AIRFRAME_FACTORS;
+#endif
+
+static MotorMixerSettings_TypeDef mixerSettings;
+static MotorMixerAllocation_TypeDef mixerAllocation;
+
+/* Mixer matrices [motor thrust (physical) or motor signal value (raw) per command unit], the rows of unused motors
+ * repeat the first motor */
+static float32_t physicalMatrixData[MIXER_MAX_MOTORS*MIXER_AXES_NBR];
+static float32_t rawMatrixData[MIXER_MAX_MOTORS*MIXER_AXES_NBR];
+#ifndef FCB_AIRFRAME_FIXED_MIXER
+static arm_matrix_instance_f32 physicalMatrix = { MIXER_MAX_MOTORS, MIXER_AXES_NBR, physicalMatrixData };
+#endif
+static arm_matrix_instance_f32 rawMatrix = { MIXER_MAX_MOTORS, MIXER_AXES_NBR, rawMatrixData };
+
+/* Physical mixer matrix without the failed motor and with a zero yaw column, see MotorMixerSetFailedMotor() */
+static float32_t degradedMatrixData[MIXER_MAX_MOTORS*MIXER_AXES_NBR];
+static arm_matrix_instance_f32 degradedMatrix = { MIXER_MAX_MOTORS, MIXER_AXES_NBR, degradedMatrixData };
+static uint8_t failedMotor = MIXER_NO_FAILED_MOTOR;
+
+/* Thrust force [N], roll & pitch moments [Nm] per motor thrust [N] and yaw moment [Nm] per motor thrust above BT [N],
+ * zero for the unused motors. Used to compute the commands the allocation achieved. */
+static float32_t effectivenessData[MIXER_MAX_MOTORS*MIXER_AXES_NBR];
+
+/* Motor command limits of mixerAllocation, in motor thrust [N] for the physical mixer and in motor signal values for
+ * the raw mixer */
+static float32_t physicalLowerLimits[MIXER_MAX_MOTORS], physicalUpperLimits[MIXER_MAX_MOTORS];
+static float32_t rawLowerLimits[MIXER_MAX_MOTORS], rawUpperLimits[MIXER_MAX_MOTORS];
+
+/* Private function prototypes -----------------------------------------------*/
+static void SetGeometryFactors(const MixerGeometry_TypeDef geometry, MotorMixerSettings_TypeDef* dstSettings);
+static FcbRetValType ApplySettings(const MotorMixerSettings_TypeDef* settings);
+static FcbRetValType ApplyAllocation(const MotorMixerAllocation_TypeDef* allocation);
+static FcbRetValType BuildDegradedMatrix(const uint8_t motor, float32_t dstData[MIXER_MAX_MOTORS*MIXER_AXES_NBR]);
+static void Mix(const arm_matrix_instance_f32* matrix, const float32_t u[MIXER_AXES_NBR],
+        const float32_t lower[MIXER_MAX_MOTORS], const float32_t upper[MIXER_MAX_MOTORS], const uint8_t excludedMotor,
+        float32_t values[MIXER_MAX_MOTORS]);
+#ifdef FCB_AIRFRAME_FIXED_MIXER
+static RAMFUNC void MixAirframe(const float32_t u[MIXER_AXES_NBR], float32_t values[MIXER_MAX_MOTORS]);
+#endif
+static RAMFUNC void Desaturate(const float32_t thrust[MIXER_MAX_MOTORS], const float32_t rollPitch[MIXER_MAX_MOTORS],
+        const float32_t yaw[MIXER_MAX_MOTORS], const float32_t lower[MIXER_MAX_MOTORS],
+        const float32_t upper[MIXER_MAX_MOTORS], const uint8_t excludedMotor, float32_t values[MIXER_MAX_MOTORS]);
+static RAMFUNC float32_t MaxCommandScale(const float32_t base[MIXER_MAX_MOTORS],
+        const float32_t delta[MIXER_MAX_MOTORS], const float32_t lower[MIXER_MAX_MOTORS],
+        const float32_t upper[MIXER_MAX_MOTORS], const bool isMixed[MIXER_MAX_MOTORS]);
+static RAMFUNC int32_t ToMotorValue(const float32_t value);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Loads the mixer settings from flash, or the default quad X layout without airmode if there are none, and the
+ *         allocation settings, or the roll & pitch priority over the whole motor range. Called before the scheduler
+ *         is started.
+ * @param  None
+ * @retval None
+ */
+void MotorMixerInit(void) {
+    MotorMixerSettings_TypeDef settings;
+    MotorMixerAllocation_TypeDef allocation;
+    uint8_t motor;
+
+    if (FLASH_OK != ReadMotorMixerSettingsFromFlash(&settings)
+#ifdef FCB_AIRFRAME_FIXED_MIXER
+            || AIRFRAME_NBR_OF_MOTORS != settings.nbrOfMotors
+            || 0 != memcmp(settings.factors, airframeFactors, sizeof(airframeFactors))
+#endif
+            || FCB_OK != ApplySettings(&settings)) {
+        memset(&settings, 0, sizeof(settings));
+        SetGeometryFactors(MIXER_DEFAULT_GEOMETRY, &settings);
+        settings.airmode = 0;
+        if (FCB_OK != ApplySettings(&settings)) {
+            ErrorHandler();
+        }
+    }
+
+    if (FLASH_OK == ReadMixerAllocationFromFlash(&allocation) && FCB_OK == ApplyAllocation(&allocation)) {
+        return;
+    }
+
+    allocation.priority = MIXER_DEFAULT_PRIORITY;
+    for (motor = 0; motor < MIXER_MAX_MOTORS; motor++) {
+        allocation.minCommand[motor] = MIXER_DEFAULT_MIN_COMMAND;
+        allocation.maxCommand[motor] = MIXER_DEFAULT_MAX_COMMAND;
+    }
+    if (FCB_OK != ApplyAllocation(&allocation)) {
+        ErrorHandler();
+    }
+}
+
+/*
+ * @brief  Configures the mixer with a predefined layout and stores it in flash
+ * @param  geometry : Motor layout
+ * @param  airmode : 1 to raise the thrust at low throttle to keep attitude authority, else 0
+ * @retval FCB_OK if configured, FCB_ERR if not in idle mode, if the layout has more motors than there are motor
+ *         outputs or if the flash write failed
+ */
+FcbRetValType MotorMixerConfig(const MixerGeometry_TypeDef geometry, const uint8_t airmode) {
+    MotorMixerSettings_TypeDef settings;
+    FcbRetValType status;
+
+    if (geometry >= MIXER_GEOMETRY_NBR || airmode > 1 || FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        return FCB_ERR;
+    }
+#ifdef FCB_AIRFRAME_FIXED_MIXER
+    if (geometry != MIXER_DEFAULT_GEOMETRY) {
+        return FCB_ERR;
+    }
+#endif
+
+    memset(&settings, 0, sizeof(settings));
+    SetGeometryFactors(geometry, &settings);
+    settings.airmode = airmode;
+
+    /* Swap the matrices atomically w.r.t. the flight control task */
+    FCB_ENTER_CRITICAL();
+    status = ApplySettings(&settings);
+    FCB_EXIT_CRITICAL();
+
+    if (FCB_OK != status) {
+        return FCB_ERR;
+    }
+
+    if (FLASH_OK != WriteMotorMixerSettingsToFlash(&mixerSettings)) {
+        return FCB_ERR;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Sets the airmode of the current layout without storing it, effective from the next control cycle
+ * @param  airmode : 1 to raise the thrust at low throttle to keep attitude authority, else 0
+ * @retval FCB_OK if set, FCB_ERR if the airmode is invalid
+ */
+FcbRetValType MotorMixerSetAirmode(const uint8_t airmode) {
+    if (airmode > 1) {
+        return FCB_ERR;
+    }
+
+    FCB_ENTER_CRITICAL();
+    mixerSettings.airmode = airmode;
+    FCB_EXIT_CRITICAL();
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Sets the allocation priority and the per motor command limits without storing them, effective from the next
+ *         control cycle
+ * @param  allocation : Allocation settings
+ * @retval FCB_OK if set, FCB_ERR if the priority is invalid or a motor has no range between its limits
+ */
+FcbRetValType MotorMixerSetAllocation(const MotorMixerAllocation_TypeDef* allocation) {
+    FcbRetValType status;
+
+    FCB_ENTER_CRITICAL();
+    status = ApplyAllocation(allocation);
+    FCB_EXIT_CRITICAL();
+
+    return status;
+}
+
+/*
+ * @brief  Gets the current allocation settings
+ * @param  dstAllocation : Destination settings
+ * @retval None
+ */
+void MotorMixerGetAllocation(MotorMixerAllocation_TypeDef* dstAllocation) {
+    FCB_ENTER_CRITICAL();
+    *dstAllocation = mixerAllocation;
+    FCB_EXIT_CRITICAL();
+}
+
+/*
+ * @brief  Stores the current allocation settings in flash
+ * @param  None
+ * @retval FCB_OK if stored, FCB_ERR if not in idle mode or if the flash write failed
+ */
+FcbRetValType MotorMixerSaveAllocation(void) {
+    MotorMixerAllocation_TypeDef allocation;
+
+    if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        return FCB_ERR;
+    }
+
+    MotorMixerGetAllocation(&allocation);
+    if (FLASH_OK != WriteMixerAllocationToFlash(&allocation)) {
+        return FCB_ERR;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Gets the current mixer settings
+ * @param  dstSettings : Destination settings
+ * @retval None
+ */
+void MotorMixerGetSettings(MotorMixerSettings_TypeDef* dstSettings) {
+    FCB_ENTER_CRITICAL();
+    *dstSettings = mixerSettings;
+    FCB_EXIT_CRITICAL();
+}
+
+/*
+ * @brief  Gets the number of motors of the current layout
+ * @param  None
+ * @retval Number of motors
+ */
+uint8_t MotorMixerGetNbrOfMotors(void) {
+    return (uint8_t) mixerSettings.nbrOfMotors;
+}
+
+/*
+ * @brief  Sets the failed motor, from then on the physical commands are mixed to the other motors without the yaw
+ *         moment, or clears it. Called by the flight control task.
+ * @param  motor : Failed motor index, from 0, or MIXER_NO_FAILED_MOTOR to mix to all motors again
+ * @retval FCB_OK if set, FCB_ERR if the motor is not in the layout or the other motors cannot control the thrust, roll
+ *         & pitch, the mixer is then left unchanged
+ */
+FcbRetValType MotorMixerSetFailedMotor(const uint8_t motor) {
+    float32_t data[MIXER_MAX_MOTORS*MIXER_AXES_NBR];
+
+    if (MIXER_NO_FAILED_MOTOR == motor) {
+        failedMotor = MIXER_NO_FAILED_MOTOR;
+        return FCB_OK;
+    }
+
+    if (motor >= mixerSettings.nbrOfMotors || FCB_OK != BuildDegradedMatrix(motor, data)) {
+        return FCB_ERR;
+    }
+
+    /* Swap the matrix atomically w.r.t. the control executive */
+    FCB_ENTER_CRITICAL();
+    memcpy(degradedMatrixData, data, sizeof(degradedMatrixData));
+    failedMotor = motor;
+    FCB_EXIT_CRITICAL();
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Gets the failed motor
+ * @param  None
+ * @retval Failed motor index, from 0, or MIXER_NO_FAILED_MOTOR
+ */
+uint8_t MotorMixerGetFailedMotor(void) {
+    return failedMotor;
+}
+
+/*
+ * @brief  Allocates physical commands to the motor thrusts and maps them to motor signal values, based on the thrust
+ *         T(m) = AT*m + BT and drag torque Q(m) = AQ*m data fits of the motors
+ * @param  u : Thrust force [N] (negative upwards since Z points down) and roll, pitch & yaw moments [Nm]
+ * @param  motorValues : Destination motor signal values [0, UINT16_MAX], 0 for the motors not in the layout and the
+ *         failed motor
+ * @param  achieved : Destination thrust force [N] and roll, pitch & yaw moments [Nm] of the allocated motor thrusts,
+ *         as u where the motor limits did not take anything away
+ * @retval None
+ */
+RAMFUNC void MotorMixerPhysical(const float32_t u[MIXER_AXES_NBR], int32_t motorValues[MIXER_MAX_MOTORS],
+        float32_t achieved[MIXER_AXES_NBR]) {
+    float32_t thrust[MIXER_MAX_MOTORS];
+    uint8_t motor, axis;
+
+    if (MIXER_NO_FAILED_MOTOR != failedMotor) {
+        Mix(&degradedMatrix, u, physicalLowerLimits, physicalUpperLimits, failedMotor, thrust);
+    } else {
+#ifdef FCB_AIRFRAME_FIXED_MIXER
+        MixAirframe(u, thrust);
+#else
+        Mix(&physicalMatrix, u, physicalLowerLimits, physicalUpperLimits, MIXER_NO_FAILED_MOTOR, thrust);
+#endif
+    }
+
+    for (axis = 0; axis < MIXER_AXES_NBR; axis++) {
+        achieved[axis] = 0.0f;
+    }
+
+    for (motor = 0; motor < MIXER_MAX_MOTORS; motor++) {
+        const float32_t* effectiveness = &effectivenessData[motor*MIXER_AXES_NBR];
+
+        if (motor == failedMotor || motor >= mixerSettings.nbrOfMotors) {
+            motorValues[motor] = 0;
+            continue;
+        }
+
+        achieved[MIXER_THRUST_IDX] += effectiveness[MIXER_THRUST_IDX]*thrust[motor];
+        achieved[MIXER_ROLL_IDX] += effectiveness[MIXER_ROLL_IDX]*thrust[motor];
+        achieved[MIXER_PITCH_IDX] += effectiveness[MIXER_PITCH_IDX]*thrust[motor];
+        achieved[MIXER_YAW_IDX] += effectiveness[MIXER_YAW_IDX]*(thrust[motor] - BT);
+
+        motorValues[motor] = ToMotorValue((thrust[motor] - BT)/AT);
+    }
+}
+
+/*
+ * @brief  Mixes raw commands, e.g. RC receiver input, to motor signal values
+ * @param  u : Thrust and roll, pitch & yaw commands in motor signal value units
+ * @param  motorValues : Destination motor signal values [0, UINT16_MAX], 0 for the motors not in the layout
+ * @retval None
+ */
+void MotorMixerRaw(const float32_t u[MIXER_AXES_NBR], int32_t motorValues[MIXER_MAX_MOTORS]) {
+    float32_t values[MIXER_MAX_MOTORS];
+    uint8_t motor;
+
+    Mix(&rawMatrix, u, rawLowerLimits, rawUpperLimits, MIXER_NO_FAILED_MOTOR, values);
+
+    for (motor = 0; motor < MIXER_MAX_MOTORS; motor++) {
+        motorValues[motor] = (motor < mixerSettings.nbrOfMotors) ? ToMotorValue(values[motor]) : 0;
+    }
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Sets the number of motors and the per motor factors of a predefined layout
+ * @param  geometry : Motor layout
+ * @param  dstSettings : Destination settings
+ * @retval None
+ */
+static void SetGeometryFactors(const MixerGeometry_TypeDef geometry, MotorMixerSettings_TypeDef* dstSettings) {
+    const MixerGeometryDef_TypeDef* geometryDef = &mixerGeometries[geometry];
+
+    dstSettings->nbrOfMotors = geometryDef->nbrOfMotors;
+    memcpy(dstSettings->factors, geometryDef->factors, geometryDef->nbrOfMotors*sizeof(dstSettings->factors[0]));
+}
+
+/*
+ * @brief  Validates settings and builds the mixer matrices from them, must not be interrupted by the flight control
+ *         task once it is running. For the symmetric layouts the matrix columns
+ *         are orthogonal, so the pseudo-inverse of the motor effectiveness is each factor divided by the sum of
+ *         squares of its column.
+ * @param  settings : Settings to apply
+ * @retval FCB_OK if applied, FCB_ERR if invalid or with more motors than there are motor outputs
+ */
+static FcbRetValType ApplySettings(const MotorMixerSettings_TypeDef* settings) {
+    float32_t physicalData[MIXER_MAX_MOTORS*MIXER_AXES_NBR], rawData[MIXER_MAX_MOTORS*MIXER_AXES_NBR];
+    float32_t effectiveness[MIXER_MAX_MOTORS*MIXER_AXES_NBR];
+    float32_t sumOfSquares[MIXER_AXES_NBR], maxAbs[MIXER_AXES_NBR];
+    uint8_t motor, axis;
+
+    if (settings->nbrOfMotors < 1 || settings->nbrOfMotors > MOTOR_OUTPUT_CHANNELS || settings->airmode > 1) {
+        return FCB_ERR;
+    }
+
+    for (axis = 0; axis < MIXER_AXES_NBR; axis++) {
+        sumOfSquares[axis] = 0.0;
+        maxAbs[axis] = 0.0;
+        for (motor = 0; motor < settings->nbrOfMotors; motor++) {
+            float32_t factor = settings->factors[motor][axis];
+
+            sumOfSquares[axis] += factor*factor;
+            if (fabsf(factor) > maxAbs[axis]) {
+                maxAbs[axis] = fabsf(factor);
+            }
+        }
+
+        /* Every axis must be controllable, also rejects NaN from erased flash */
+        if (!(sumOfSquares[axis] > 0.0f)) {
+            return FCB_ERR;
+        }
+    }
+
+    for (motor = 0; motor < MIXER_MAX_MOTORS; motor++) {
+        uint8_t row = (motor < settings->nbrOfMotors) ? motor : 0;
+
+        for (axis = 0; axis < MIXER_AXES_NBR; axis++) {
+            float32_t factor = settings->factors[row][axis];
+
+            physicalData[motor*MIXER_AXES_NBR + axis] = factor/sumOfSquares[axis]*physicalCommandUnits[axis];
+            rawData[motor*MIXER_AXES_NBR + axis] = factor/maxAbs[axis];
+            effectiveness[motor*MIXER_AXES_NBR + axis] = (motor < settings->nbrOfMotors) ?
+                    factor/physicalCommandUnits[axis] : 0.0f;
+        }
+    }
+
+    mixerSettings = *settings;
+    memcpy(physicalMatrixData, physicalData, sizeof(physicalMatrixData));
+    memcpy(rawMatrixData, rawData, sizeof(rawMatrixData));
+    memcpy(effectivenessData, effectiveness, sizeof(effectivenessData));
+    failedMotor = MIXER_NO_FAILED_MOTOR;
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Validates allocation settings and computes the motor command limits of both mixers from them, must not be
+ *         interrupted by the flight control task once it is running
+ * @param  allocation : Settings to apply
+ * @retval FCB_OK if applied, FCB_ERR if the priority is invalid or a motor has no range between its limits
+ */
+static FcbRetValType ApplyAllocation(const MotorMixerAllocation_TypeDef* allocation) {
+    uint8_t motor;
+
+    if (allocation->priority >= MIXER_PRIORITY_NBR) {
+        return FCB_ERR;
+    }
+
+    /* Also rejects NaN from erased flash */
+    for (motor = 0; motor < MIXER_MAX_MOTORS; motor++) {
+        if (!(allocation->minCommand[motor] >= 0.0f && allocation->minCommand[motor] < allocation->maxCommand[motor]
+                && allocation->maxCommand[motor] <= 1.0f)) {
+            return FCB_ERR;
+        }
+    }
+
+    mixerAllocation = *allocation;
+    for (motor = 0; motor < MIXER_MAX_MOTORS; motor++) {
+        rawLowerLimits[motor] = allocation->minCommand[motor]*MIXER_MOTOR_SIGNAL_MAX;
+        rawUpperLimits[motor] = allocation->maxCommand[motor]*MIXER_MOTOR_SIGNAL_MAX;
+        physicalLowerLimits[motor] = AT*rawLowerLimits[motor] + BT;
+        physicalUpperLimits[motor] = AT*rawUpperLimits[motor] + BT;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Builds the physical mixer matrix of the motors other than a failed one. With the yaw left out the thrust,
+ *         roll & pitch effectiveness E of the remaining motors is 3 x N, and the matrix is its pseudo-inverse
+ *         E^T*(E*E^T)^-1. For a quad the opposite motor of the failed one then only follows the roll & pitch
+ *         commands, and the other two carry the thrust.
+ * @param  motor : Failed motor index, from 0
+ * @param  dstData : Destination matrix data, MIXER_MAX_MOTORS x MIXER_AXES_NBR, the rows of the failed and the unused
+ *         motors repeat the first remaining motor
+ * @retval FCB_OK if built, FCB_ERR if E*E^T is singular
+ */
+static FcbRetValType BuildDegradedMatrix(const uint8_t motor, float32_t dstData[MIXER_MAX_MOTORS*MIXER_AXES_NBR]) {
+    float32_t effectiveness[3*MIXER_MAX_MOTORS], gramData[3*3], gramInverseData[3*3];
+    arm_matrix_instance_f32 gram = { 3, 3, gramData };
+    arm_matrix_instance_f32 gramInverse = { 3, 3, gramInverseData };
+    uint8_t row, column, i, firstRow;
+
+    /* Thrust force [N] and roll & pitch moments [Nm] per motor thrust [N], zero for the failed and unused motors */
+    for (row = 0; row < 3; row++) {
+        for (column = 0; column < MIXER_MAX_MOTORS; column++) {
+            effectiveness[row*MIXER_MAX_MOTORS + column] = (column < mixerSettings.nbrOfMotors && column != motor) ?
+                    mixerSettings.factors[column][row]/physicalCommandUnits[row] : 0.0f;
+        }
+    }
+
+    for (row = 0; row < 3; row++) {
+        for (column = 0; column < 3; column++) {
+            gramData[row*3 + column] = 0.0f;
+            for (i = 0; i < MIXER_MAX_MOTORS; i++) {
+                gramData[row*3 + column] += effectiveness[row*MIXER_MAX_MOTORS + i]
+                        *effectiveness[column*MIXER_MAX_MOTORS + i];
+            }
+        }
+    }
+
+    if (ARM_MATH_SUCCESS != arm_mat_inverse_f32(&gram, &gramInverse)) {
+        return FCB_ERR;
+    }
+
+    for (i = 0; i < MIXER_MAX_MOTORS; i++) {
+        for (column = 0; column < 3; column++) {
+            dstData[i*MIXER_AXES_NBR + column] = 0.0f;
+            for (row = 0; row < 3; row++) {
+                dstData[i*MIXER_AXES_NBR + column] += effectiveness[row*MIXER_MAX_MOTORS + i]
+                        *gramInverseData[row*3 + column];
+            }
+        }
+        dstData[i*MIXER_AXES_NBR + MIXER_YAW_IDX] = 0.0f;
+    }
+
+    firstRow = (0 == motor) ? 1 : 0;
+    for (i = 0; i < MIXER_MAX_MOTORS; i++) {
+        if (i == motor || i >= mixerSettings.nbrOfMotors) {
+            memcpy(&dstData[i*MIXER_AXES_NBR], &dstData[firstRow*MIXER_AXES_NBR], MIXER_AXES_NBR*sizeof(float32_t));
+        }
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Mixes commands to the motors and desaturates them
+ * @param  matrix : Mixer matrix, MIXER_MAX_MOTORS x MIXER_AXES_NBR
+ * @param  u : Thrust and roll, pitch & yaw commands
+ * @param  lower : Lower limit of each motor, in the unit of the matrix
+ * @param  upper : Upper limit of each motor, in the unit of the matrix
+ * @param  excludedMotor : Motor left out of the desaturation, or MIXER_NO_FAILED_MOTOR
+ * @param  values : Destination value of each motor, in the unit of the matrix, 0 for the motors not mixed
+ * @retval None
+ */
+static void Mix(const arm_matrix_instance_f32* matrix, const float32_t u[MIXER_AXES_NBR],
+        const float32_t lower[MIXER_MAX_MOTORS], const float32_t upper[MIXER_MAX_MOTORS], const uint8_t excludedMotor,
+        float32_t values[MIXER_MAX_MOTORS]) {
+    float32_t rollPitchCommands[MIXER_AXES_NBR] = { 0.0, u[MIXER_ROLL_IDX], u[MIXER_PITCH_IDX], 0.0 };
+    float32_t rollPitch[MIXER_MAX_MOTORS], yaw[MIXER_MAX_MOTORS], thrust[MIXER_MAX_MOTORS];
+    arm_matrix_instance_f32 commandVector = { MIXER_AXES_NBR, 1, rollPitchCommands };
+    arm_matrix_instance_f32 rollPitchVector = { MIXER_MAX_MOTORS, 1, rollPitch };
+    uint8_t motor;
+
+    /* Roll & pitch part of all motors in one pass, the thrust and yaw parts are column scalings */
+    arm_mat_mult_f32(matrix, &commandVector, &rollPitchVector);
+
+    for (motor = 0; motor < MIXER_MAX_MOTORS; motor++) {
+        thrust[motor] = matrix->pData[motor*MIXER_AXES_NBR + MIXER_THRUST_IDX]*u[MIXER_THRUST_IDX];
+        yaw[motor] = matrix->pData[motor*MIXER_AXES_NBR + MIXER_YAW_IDX]*u[MIXER_YAW_IDX];
+    }
+
+    Desaturate(thrust, rollPitch, yaw, lower, upper, excludedMotor, values);
+}
+
+#ifdef FCB_AIRFRAME_FIXED_MIXER
+/*
+ * @brief  Mixes physical commands to motor thrusts with the constant factors of FCB_AIRFRAME and desaturates them
+ * @param  u : Thrust force [N] and roll, pitch & yaw moments [Nm]
+ * @param  values : Destination motor thrusts [N], 0 for the motors not in the layout
+ * @retval None
+ */
+static RAMFUNC void MixAirframe(const float32_t u[MIXER_AXES_NBR], float32_t values[MIXER_MAX_MOTORS]) {
+    float32_t rollPitch[MIXER_MAX_MOTORS], yaw[MIXER_MAX_MOTORS], thrust[MIXER_MAX_MOTORS];
+
+    /* Unrolled, so that the constant factors fold into the multiplications */
+    MIX_AIRFRAME_MOTOR(0, u);
+    MIX_AIRFRAME_MOTOR(1, u);
+    MIX_AIRFRAME_MOTOR(2, u);
+    MIX_AIRFRAME_MOTOR(3, u);
+#if (AIRFRAME_NBR_OF_MOTORS > 4)
+    MIX_AIRFRAME_MOTOR(4, u);
+    MIX_AIRFRAME_MOTOR(5, u);
+#endif
+#if (AIRFRAME_NBR_OF_MOTORS > 6)
+    MIX_AIRFRAME_MOTOR(6, u);
+    MIX_AIRFRAME_MOTOR(7, u);
+#endif
+
+    Desaturate(thrust, rollPitch, yaw, physicalLowerLimits, physicalUpperLimits, MIXER_NO_FAILED_MOTOR, values);
+}
+#endif
+
+/*
+ * @brief  Desaturates the mixed motors by priority, see the file header. The motors not in the layout and the excluded
+ *         one are left out, so their rows are never read.
+ * @param  thrust : Thrust part of each motor
+ * @param  rollPitch : Roll & pitch part of each motor
+ * @param  yaw : Yaw part of each motor
+ * @param  lower : Lower limit of each motor
+ * @param  upper : Upper limit of each motor
+ * @param  excludedMotor : Motor left out, or MIXER_NO_FAILED_MOTOR
+ * @param  values : Destination value of each motor within its limits, 0 for the motors left out
+ * @retval None
+ */
+static RAMFUNC void Desaturate(const float32_t thrust[MIXER_MAX_MOTORS], const float32_t rollPitch[MIXER_MAX_MOTORS],
+        const float32_t yaw[MIXER_MAX_MOTORS], const float32_t lower[MIXER_MAX_MOTORS],
+        const float32_t upper[MIXER_MAX_MOTORS], const uint8_t excludedMotor, float32_t values[MIXER_MAX_MOTORS]) {
+    const bool isYawSeparate = (MIXER_PRIORITY_ROLLPITCH_YAW_THRUST == mixerAllocation.priority);
+    float32_t first[MIXER_MAX_MOTORS], second[MIXER_MAX_MOTORS];
+    float32_t scale, shiftMin = -FLT_MAX, shiftMax = FLT_MAX, shift = 0.0;
+    bool isMixed[MIXER_MAX_MOTORS];
+    uint8_t motor;
+
+    for (motor = 0; motor < MIXER_MAX_MOTORS; motor++) {
+        isMixed[motor] = motor < mixerSettings.nbrOfMotors && motor != excludedMotor;
+        if (isMixed[motor]) {
+            first[motor] = isYawSeparate ? rollPitch[motor] : rollPitch[motor] + yaw[motor];
+            second[motor] = isYawSeparate ? yaw[motor] : 0.0f;
+            values[motor] = thrust[motor];
+        }
+    }
+
+    /* Scale down the roll & pitch if the limits cannot hold their spread, then the yaw into what is left */
+    scale = MaxCommandScale(values, first, lower, upper, isMixed);
+    for (motor = 0; motor < MIXER_MAX_MOTORS; motor++) {
+        if (isMixed[motor]) {
+            values[motor] += scale*first[motor];
+        }
+    }
+
+    scale = MaxCommandScale(values, second, lower, upper, isMixed);
+    for (motor = 0; motor < MIXER_MAX_MOTORS; motor++) {
+        if (isMixed[motor]) {
+            values[motor] += scale*second[motor];
+            shiftMin = (lower[motor] - values[motor] > shiftMin) ? lower[motor] - values[motor] : shiftMin;
+            shiftMax = (upper[motor] - values[motor] < shiftMax) ? upper[motor] - values[motor] : shiftMax;
+        }
+    }
+
+    /* Shift the thrust to keep the attitude authority. It is always lowered at high throttle, but only raised at low
+     * throttle in airmode, since the motors would otherwise spin up with zero throttle. */
+    if (shiftMax < 0.0f) {
+        shift = shiftMax;
+    } else if (mixerSettings.airmode && shiftMin > 0.0f) {
+        shift = (shiftMin < shiftMax) ? shiftMin : shiftMax;
+    }
+
+    /* Clips at the lower limits without airmode, beyond that only rounding */
+    for (motor = 0; motor < MIXER_MAX_MOTORS; motor++) {
+        float32_t value = 0.0;
+
+        if (isMixed[motor]) {
+            value = values[motor] + shift;
+            value = (value < lower[motor]) ? lower[motor] : value;
+            value = (value > upper[motor]) ? upper[motor] : value;
+        }
+        values[motor] = value;
+    }
+}
+
+/*
+ * @brief  Finds the largest part of a command that the motors can take on top of what they already have, with a
+ *         common thrust shift. For each pair of motors whose values spread with the command, the one going up needs
+ *         room below its upper limit for what the other one lacks to its lower limit.
+ * @param  base : Value of each motor so far
+ * @param  delta : Part of the command of each motor
+ * @param  lower : Lower limit of each motor
+ * @param  upper : Upper limit of each motor
+ * @param  isMixed : Motors to take into account
+ * @retval Scale of the command [0, 1]
+ */
+static RAMFUNC float32_t MaxCommandScale(const float32_t base[MIXER_MAX_MOTORS],
+        const float32_t delta[MIXER_MAX_MOTORS], const float32_t lower[MIXER_MAX_MOTORS],
+        const float32_t upper[MIXER_MAX_MOTORS], const bool isMixed[MIXER_MAX_MOTORS]) {
+    float32_t scale = 1.0, room;
+    uint8_t i, j;
+
+    for (i = 0; i < MIXER_MAX_MOTORS; i++) {
+        for (j = 0; j < MIXER_MAX_MOTORS; j++) {
+            if (!isMixed[i] || !isMixed[j] || delta[j] <= delta[i]) {
+                continue;
+            }
+
+            /* Only divides for the pairs that limit the scale */
+            room = (upper[j] - base[j]) - (lower[i] - base[i]);
+            if (room < scale*(delta[j] - delta[i])) {
+                scale = room/(delta[j] - delta[i]);
+            }
+        }
+    }
+
+    return (scale > 0.0f) ? scale : 0.0f;
+}
+
+/*
+ * @brief  Converts a linear motor signal to a motor signal value
+ * @param  value : Motor signal
+ * @retval Motor signal value [0, UINT16_MAX]
+ */
+static RAMFUNC int32_t ToMotorValue(const float32_t value) {
+    int32_t motorValue = (int32_t) value;
+
+    /* The limits are within the range, beyond that only rounding */
+    if (!IS_NOT_GREATER_UINT16_MAX(motorValue)) {
+        motorValue = UINT16_MAX;
+    }
+    if (!IS_POS(motorValue)) {
+        motorValue = 0;
+    }
+
+    return motorValue;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,290 @@
+/******************************************************************************
+ * @file    motor_test.c
+ * @brief   Interlocked bench motor test and ESC endpoint calibration, see
+ *          motor_test.h
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "motor_test.h"
+
+#include "flight_control.h"
+#include "thrust_curve.h"
+#include "usbd_cdc_if.h"
+#include "fixed_format.h"
+#include "fcb_port.h"
+
+#include <string.h>
+#include <stdio.h>
+
+/* Private variables ---------------------------------------------------------*/
+
+static const char* const motorTestStateNames[MOTOR_TEST_STATE_NBR] = {
+    "locked", "unlocked", "spinning", "ESC calibration, max pulse", "ESC calibration, min pulse"
+};
+
+/* Set by the CLI and the RPC, run by the flight control task */
+static MotorTestStateType motorTestState = MOTOR_TEST_LOCKED;
+static uint8_t motorTestMotor = 0;
+static float32_t motorTestOutput = 0.0f;
+static portTickType motorTestStartTick = 0;     // Of the unlock, the test or the calibration step
+static uint32_t motorTestTimeout = 0;           // [ms] from motorTestStartTick
+
+/* Private function prototypes -----------------------------------------------*/
+static bool IsMotorTestInterlockClosed(void);
+static void SetMotorTestState(const MotorTestStateType state, const uint32_t timeout);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Unlocks the motor test and the ESC calibration with the props-off confirmation
+ * @param  confirmation : MOTOR_TEST_UNLOCK_PHRASE, not null terminated
+ * @param  length : Length of the confirmation
+ * @retval FCB_OK if unlocked, FCB_ERR if the confirmation does not match or an interlock does not hold
+ */
+FcbRetValType UnlockMotorTest(const char* confirmation, const size_t length) {
+    if (NULL == confirmation || length != strlen(MOTOR_TEST_UNLOCK_PHRASE)
+            || 0 != strncmp(confirmation, MOTOR_TEST_UNLOCK_PHRASE, length) || !IsMotorTestInterlockClosed()) {
+        return FCB_ERR;
+    }
+
+    FCB_ENTER_CRITICAL();
+    if (MOTOR_TEST_LOCKED == motorTestState || MOTOR_TEST_UNLOCKED == motorTestState) {
+        SetMotorTestState(MOTOR_TEST_UNLOCKED, MOTOR_TEST_UNLOCK_TIMEOUT);
+    }
+    FCB_EXIT_CRITICAL();
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Stops a running test or calibration and locks the motor test
+ * @param  None.
+ * @retval None.
+ */
+void LockMotorTest(void) {
+    FCB_ENTER_CRITICAL();
+    SetMotorTestState(MOTOR_TEST_LOCKED, 0);
+    FCB_EXIT_CRITICAL();
+}
+
+/*
+ * @brief  Starts or changes the motor test
+ * @param  motor : Motor index, 0 for motor 1
+ * @param  output : Output in [0, MOTOR_TEST_MAX_OUTPUT]
+ * @param  duration : Duration of the test [ms], in (0, MOTOR_TEST_MAX_DURATION]
+ * @retval FCB_OK if started, FCB_ERR if locked, an interlock does not hold or the motor, output or duration is invalid
+ */
+FcbRetValType StartMotorTest(const uint8_t motor, const float32_t output, const uint16_t duration) {
+    FcbRetValType status = FCB_ERR;
+
+    if (motor >= MOTOR_OUTPUT_CHANNELS || !(output >= 0.0f && output <= MOTOR_TEST_MAX_OUTPUT) || 0 == duration
+            || duration > MOTOR_TEST_MAX_DURATION || !IsMotorTestInterlockClosed()) {
+        return FCB_ERR;
+    }
+
+    /* The motor outputs are the motor test's from here on */
+    StopThrustTest();
+
+    FCB_ENTER_CRITICAL();
+    if (MOTOR_TEST_LOCKED != motorTestState) {
+        motorTestMotor = motor;
+        motorTestOutput = output;
+        SetMotorTestState(MOTOR_TEST_SPINNING, duration);
+        status = FCB_OK;
+    }
+    FCB_EXIT_CRITICAL();
+
+    return status;
+}
+
+/*
+ * @brief  Stops a running test or aborts a running calibration, the motor test stays unlocked
+ * @param  None.
+ * @retval None.
+ */
+void StopMotorTest(void) {
+    FCB_ENTER_CRITICAL();
+    if (MOTOR_TEST_LOCKED != motorTestState) {
+        SetMotorTestState(MOTOR_TEST_UNLOCKED, MOTOR_TEST_UNLOCK_TIMEOUT);
+    }
+    FCB_EXIT_CRITICAL();
+}
+
+/*
+ * @brief  Starts the ESC calibration with the max pulse on all motors
+ * @param  None.
+ * @retval FCB_OK if started, FCB_ERR if locked, an interlock does not hold or the motor output protocol is DShot
+ */
+FcbRetValType StartEscCalibration(void) {
+    FcbRetValType status = FCB_ERR;
+
+    if (MOTOR_OUTPUT_IS_DSHOT || !IsMotorTestInterlockClosed()) {
+        return FCB_ERR;
+    }
+
+    StopThrustTest();
+
+    FCB_ENTER_CRITICAL();
+    if (MOTOR_TEST_LOCKED != motorTestState) {
+        SetMotorTestState(MOTOR_TEST_ESC_CALIBRATION_HIGH, ESC_CALIBRATION_HIGH_TIMEOUT);
+        status = FCB_OK;
+    }
+    FCB_EXIT_CRITICAL();
+
+    return status;
+}
+
+/*
+ * @brief  Steps the ESC calibration from the max pulse to the min pulse, and from the min pulse to its end
+ * @param  None.
+ * @retval FCB_OK if stepped, FCB_ERR if no calibration is running or an interlock does not hold
+ */
+FcbRetValType NextEscCalibrationStep(void) {
+    FcbRetValType status = FCB_OK;
+
+    if (!IsMotorTestInterlockClosed()) {
+        return FCB_ERR;
+    }
+
+    FCB_ENTER_CRITICAL();
+    if (MOTOR_TEST_ESC_CALIBRATION_HIGH == motorTestState) {
+        SetMotorTestState(MOTOR_TEST_ESC_CALIBRATION_LOW, ESC_CALIBRATION_LOW_TIMEOUT);
+    } else if (MOTOR_TEST_ESC_CALIBRATION_LOW == motorTestState) {
+        SetMotorTestState(MOTOR_TEST_UNLOCKED, MOTOR_TEST_UNLOCK_TIMEOUT);
+    } else {
+        status = FCB_ERR;
+    }
+    FCB_EXIT_CRITICAL();
+
+    return status;
+}
+
+/*
+ * @brief  Checks the interlocks and the timeouts, and outputs the running test or calibration
+ * @param  None.
+ * @retval true if a test or calibration is running, else false
+ */
+bool UpdateMotorTest(void) {
+    uint16_t ctrlVal[MOTOR_OUTPUT_CHANNELS] = { 0, 0, 0, 0 };
+    const bool isInterlockClosed = IsMotorTestInterlockClosed();
+    MotorTestStateType state;
+    uint8_t stopMask = 0;
+    uint8_t i;
+
+    FCB_ENTER_CRITICAL();
+    if (!isInterlockClosed) {
+        SetMotorTestState(MOTOR_TEST_LOCKED, 0);
+    } else if (MOTOR_TEST_LOCKED != motorTestState
+            && (xTaskGetTickCount() - motorTestStartTick) * portTICK_RATE_MS > motorTestTimeout) {
+        /* An expired unlock locks, a test or a calibration step that has timed out falls back to the unlock */
+        if (MOTOR_TEST_UNLOCKED == motorTestState) {
+            SetMotorTestState(MOTOR_TEST_LOCKED, 0);
+        } else {
+            SetMotorTestState(MOTOR_TEST_UNLOCKED, MOTOR_TEST_UNLOCK_TIMEOUT);
+        }
+    }
+    state = motorTestState;
+    if (MOTOR_TEST_SPINNING == state) {
+        ctrlVal[motorTestMotor] = (uint16_t) (motorTestOutput * UINT16_MAX);
+        stopMask = (uint8_t) (MOTOR_ALL_MASK & ~(1 << motorTestMotor));
+    }
+    FCB_EXIT_CRITICAL();
+
+    switch (state) {
+    case MOTOR_TEST_SPINNING:
+        break;
+    case MOTOR_TEST_ESC_CALIBRATION_HIGH:
+        for (i = 0; i < MOTOR_OUTPUT_CHANNELS; i++) {
+            ctrlVal[i] = UINT16_MAX;
+        }
+        break;
+    case MOTOR_TEST_ESC_CALIBRATION_LOW:
+        stopMask = MOTOR_ALL_MASK;
+        break;
+    default:
+        return false;
+    }
+
+    SetBenchMotors(ctrlVal, stopMask);
+
+    return true;
+}
+
+/*
+ * @brief  Gets the state of the motor test
+ * @param  dstStatus : Destination of the status
+ * @retval None.
+ */
+void GetMotorTestStatus(MotorTestStatusType* dstStatus) {
+    uint32_t elapsed;
+
+    FCB_ENTER_CRITICAL();
+    elapsed = (xTaskGetTickCount() - motorTestStartTick) * portTICK_RATE_MS;
+    dstStatus->state = motorTestState;
+    dstStatus->motor = motorTestMotor;
+    dstStatus->output = motorTestOutput;
+    dstStatus->remaining = (elapsed < motorTestTimeout) ? motorTestTimeout - elapsed : 0;
+    FCB_EXIT_CRITICAL();
+}
+
+size_t PrintMotorTestStatus(char* dst, const size_t dstSize) {
+    MotorTestStatusType status;
+    EscOutputsType escOutputs;
+    float32_t values[2];
+    size_t length;
+
+    GetMotorTestStatus(&status);
+    GetEscOutputs(&escOutputs);
+
+    length = (size_t) snprintf(dst, dstSize, "Motor test: %s", motorTestStateNames[status.state]);
+    if (MOTOR_TEST_SPINNING == status.state && length < dstSize) {
+        length += (size_t) snprintf(dst + length, dstSize - length, ", motor %u", status.motor + 1);
+        values[0] = status.output;
+        if (length < dstSize) {
+            length += FormatFixedList(dst + length, dstSize - length, " at output %1.3f", values, 1);
+        }
+    }
+    if (MOTOR_TEST_LOCKED != status.state && length < dstSize) {
+        values[1] = (float32_t) status.remaining / 1000.0f;
+        length += FormatFixedList(dst + length, dstSize - length, ", %1.1f s left", &values[1], 1);
+    }
+    if (length < dstSize) {
+        length += (size_t) snprintf(dst + length, dstSize - length,
+                "\r\nESC outputs: min %u us, idle %u us, max %u us%s\r\n", escOutputs.minPulse, escOutputs.idlePulse,
+                escOutputs.maxPulse, MOTOR_OUTPUT_IS_DSHOT ? " (not used by DShot)" : "");
+    }
+
+    return (length < dstSize) ? length : dstSize - 1;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Checks the interlocks of the motor test other than the unlock, i.e. idle mode and the USB connection
+ * @param  None.
+ * @retval true if the motor test may run, else false
+ */
+static bool IsMotorTestInterlockClosed(void) {
+    return FLIGHT_CONTROL_IDLE == GetFlightControlMode() && IsUSBComConfigured();
+}
+
+/*
+ * @brief  Sets the state of the motor test and restarts its timeout, called within a critical section
+ * @param  state : New state
+ * @param  timeout : Of the state [ms], 0 if it has none
+ * @retval None.
+ */
+static void SetMotorTestState(const MotorTestStateType state, const uint32_t timeout) {
+    motorTestState = state;
+    motorTestStartTick = xTaskGetTickCount();
+    motorTestTimeout = timeout;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
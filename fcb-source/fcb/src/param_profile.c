@@ -0,0 +1,199 @@
+/******************************************************************************
+ * @file    param_profile.c
+ * @brief   Switchable parameter profiles, see param_profile.h
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "param_profile.h"
+
+#include "motor_mixer.h"
+#include "flash.h"
+#include "fcb_port.h"
+
+#include <stdio.h>
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Set by the CLI and the RPC with the scheduler suspended */
+static ParamProfileType profiles[PARAM_PROFILE_NBR];
+static bool isProfileSaved[PARAM_PROFILE_NBR];
+static int8_t activeProfile = PARAM_PROFILE_NONE;
+
+/* Private function prototypes -----------------------------------------------*/
+static void LoadParamProfiles(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Loads the saved profiles from flash
+ * @param  None.
+ * @retval None.
+ */
+void InitParamProfiles(void) {
+    LoadParamProfiles();
+}
+
+/*
+ * @brief  Applies a saved profile to the current values, part by part
+ * @param  profileIdx : Profile index
+ * @retval FCB_OK if applied, FCB_ERR if the index is invalid, the profile is not saved or a value is invalid
+ */
+FcbRetValType SelectParamProfile(const uint8_t profileIdx) {
+    FcbRetValType status = FCB_OK;
+    ParamProfileType profile;
+    uint8_t axis;
+
+    if (profileIdx >= PARAM_PROFILE_NBR) {
+        return FCB_ERR;
+    }
+
+    FCB_SUSPEND_SCHEDULER();
+    profile = profiles[profileIdx];
+    if (!isProfileSaved[profileIdx]) {
+        status = FCB_ERR;
+    }
+    FCB_RESUME_SCHEDULER();
+
+    if (FCB_OK != status) {
+        return FCB_ERR;
+    }
+
+    /* Each setter checks its values and computes what the control cycle uses before it swaps them in */
+    if (FCB_OK != SetAllPIDGains(&profile.pidGains) || FCB_OK != SetReferenceMaxLimits(&profile.referenceMaxLimits)
+            || FCB_OK != MotorMixerSetAirmode((uint8_t) profile.airmode)) {
+        status = FCB_ERR;
+    }
+    for (axis = 0; axis < STICK_AXIS_NBR; axis++) {
+        if (FCB_OK != SetStickCurve((StickAxisType) axis, &profile.stickCurves.curves[axis])) {
+            status = FCB_ERR;
+        }
+    }
+    if (profile.isGyroFilterSet && FCB_OK != SensorFilterSwitch(GYRO_IDX, &profile.gyroFilter)) {
+        status = FCB_ERR;
+    }
+
+    FCB_SUSPEND_SCHEDULER();
+    activeProfile = (int8_t) profileIdx;
+    FCB_RESUME_SCHEDULER();
+
+    return status;
+}
+
+/*
+ * @brief  Saves the current values to a profile in flash
+ * @param  profileIdx : Profile index
+ * @retval FCB_OK if saved, FCB_ERR if the index is invalid, not in idle mode or if writing the flash failed
+ */
+FcbRetValType SaveParamProfile(const uint8_t profileIdx) {
+    MotorMixerSettings_TypeDef mixerSettings;
+    ParamProfileType profile;
+    uint8_t axis;
+
+    /* The profile is gathered from several modules, only while disarmed do they hold one consistent set */
+    if (profileIdx >= PARAM_PROFILE_NBR || FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        return FCB_ERR;
+    }
+
+    GetAllPIDGains(&profile.pidGains);
+    GetReferenceMaxLimits(&profile.referenceMaxLimits);
+    for (axis = 0; axis < STICK_AXIS_NBR; axis++) {
+        GetStickCurve((StickAxisType) axis, &profile.stickCurves.curves[axis]);
+    }
+    profile.isGyroFilterSet = (FCB_OK == SensorFilterGetConfig(GYRO_IDX, &profile.gyroFilter)) ? 1 : 0;
+    MotorMixerGetSettings(&mixerSettings);
+    profile.airmode = mixerSettings.airmode;
+
+    FCB_SUSPEND_SCHEDULER();
+    profiles[profileIdx] = profile;
+    isProfileSaved[profileIdx] = true;
+    FCB_RESUME_SCHEDULER();
+
+    /* The whole page is rewritten, after a failure the profiles are the ones left in flash */
+    if (FLASH_OK != WriteParamProfilesToFlash(profiles, isProfileSaved)) {
+        LoadParamProfiles();
+        return FCB_ERR;
+    }
+
+    FCB_SUSPEND_SCHEDULER();
+    activeProfile = (int8_t) profileIdx;
+    FCB_RESUME_SCHEDULER();
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Gets the active profile
+ * @param  None.
+ * @retval The index of the profile selected or saved last, or PARAM_PROFILE_NONE for the base settings
+ */
+int8_t GetActiveParamProfile(void) {
+    return activeProfile;
+}
+
+/*
+ * @brief  Checks if a profile is saved
+ * @param  profileIdx : Profile index
+ * @retval true if saved, else false
+ */
+bool IsParamProfileSaved(const uint8_t profileIdx) {
+    return profileIdx < PARAM_PROFILE_NBR && isProfileSaved[profileIdx];
+}
+
+size_t PrintParamProfiles(char* dst, const size_t dstSize) {
+    const int8_t active = GetActiveParamProfile();
+    size_t length;
+    uint8_t i;
+
+    if (PARAM_PROFILE_NONE == active) {
+        length = (size_t) snprintf(dst, dstSize, "Active profile: none, base settings\r\n");
+    } else {
+        length = (size_t) snprintf(dst, dstSize, "Active profile: %d\r\n", active + 1);
+    }
+
+    for (i = 0; i < PARAM_PROFILE_NBR && length < dstSize; i++) {
+        FCB_SUSPEND_SCHEDULER();
+        if (!isProfileSaved[i]) {
+            length += (size_t) snprintf(dst + length, dstSize - length, "Profile %u: not saved\r\n", i + 1);
+        } else {
+            length += (size_t) snprintf(dst + length, dstSize - length, "Profile %u: saved, airmode %s, %s\r\n", i + 1,
+                    profiles[i].airmode ? "on" : "off",
+                    profiles[i].isGyroFilterSet ? "gyro filter set" : "keeps the gyro filter");
+        }
+        FCB_RESUME_SCHEDULER();
+    }
+
+    return (length < dstSize) ? length : dstSize - 1;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Loads the profiles from flash, a slot without a valid profile is not saved
+ * @param  None.
+ * @retval None.
+ */
+static void LoadParamProfiles(void) {
+    ParamProfileType profile;
+    bool isSaved;
+    uint8_t i;
+
+    for (i = 0; i < PARAM_PROFILE_NBR; i++) {
+        isSaved = (FLASH_OK == ReadParamProfileFromFlash(i, &profile));
+
+        FCB_SUSPEND_SCHEDULER();
+        isProfileSaved[i] = isSaved;
+        if (isSaved) {
+            profiles[i] = profile;
+        }
+        FCB_RESUME_SCHEDULER();
+    }
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,452 @@
+/*****************************************************************************
+ * @brief   Parameter table. The subsystems describe their tunable parameters
+ *          in groups, with the storage they use them from, and the table
+ *          numbers them consecutively in the group order below. The IDs are
+ *          stable for a build, tools look the names up with the parameter
+ *          info. Writes are checked against the ranges first and then done
+ *          with the scheduler suspended, together with the apply function of
+ *          each written group, so that the control tasks never see a partly
+ *          written set. All groups are saved to flash in one page write.
+ *
+ * @license
+ * Dragonfly FCB firmware to control the Dragonfly quadrotor UAV
+ * Copyright (C) 2016  ÅF Technology South: Dragonfly Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *****************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "param_table.h"
+
+#include "flight_control.h"
+#include "pid_control.h"
+#include "com_mavlink.h"
+#include "blackbox.h"
+#include "fcb_accelerometer_magnetometer.h"
+#include "fcb_sensor_orientation.h"
+#include "rc_smoothing.h"
+#include "mag_heading.h"
+#include "state_estimation.h"
+#include "flash.h"
+#include "fcb_error.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+#include <math.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private define ------------------------------------------------------------*/
+#define PARAM_GROUP_NBR         9
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Registered groups, in ID order, set up before the scheduler is started */
+static const ParamGroup_TypeDef* paramGroups[PARAM_GROUP_NBR];
+static uint16_t nbrOfParams = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+static const Param_TypeDef* LocateParam(const uint16_t id, uint8_t* groupIdx);
+static float32_t ReadParamValue(const Param_TypeDef* param);
+static void WriteParamValue(const Param_TypeDef* param, const float32_t value);
+static bool IsValidParamValue(const Param_TypeDef* param, const float32_t value);
+static bool ReadVarint(const uint8_t* msg, const uint16_t msgSize, uint16_t* pos, uint32_t* value);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Registers the parameter groups of the subsystems. Called once at startup, before the scheduler is started.
+ * @param  None
+ * @retval None
+ */
+void InitParamTable(void) {
+    uint8_t i;
+
+    /* New groups go last, so that the IDs of the others are kept */
+    paramGroups[0] = GetReferenceLimitParamGroup();
+    paramGroups[1] = GetPIDParamGroup();
+    paramGroups[2] = GetMavlinkParamGroup();
+    paramGroups[3] = GetBlackboxParamGroup();
+    paramGroups[4] = GetMagCalibrationParamGroup();
+    paramGroups[5] = GetSensorOrientationParamGroup();
+    paramGroups[6] = GetRcSmoothingParamGroup();
+    paramGroups[7] = GetEstimatorNoiseParamGroup();
+    paramGroups[8] = GetMagHeadingParamGroup();
+
+    nbrOfParams = 0;
+    for (i = 0; i < PARAM_GROUP_NBR; i++) {
+        nbrOfParams += paramGroups[i]->nbrOfParams;
+    }
+
+    /* The table would not fit its message */
+    if (nbrOfParams > PARAM_MAX_NBR) {
+        ErrorHandler();
+    }
+}
+
+/*
+ * @brief  Gets the number of parameters in the table
+ * @param  None
+ * @retval The number of parameters, their IDs are 0 to the number - 1
+ */
+uint16_t GetNbrOfParams(void) {
+    return nbrOfParams;
+}
+
+/*
+ * @brief  Gets the description of a parameter
+ * @param  id : Parameter ID
+ * @retval The parameter, NULL if it does not exist
+ */
+const Param_TypeDef* GetParam(const uint16_t id) {
+    uint8_t groupIdx;
+
+    return LocateParam(id, &groupIdx);
+}
+
+/*
+ * @brief  Looks up a parameter by its name
+ * @param  name : Parameter name, need not be null terminated
+ * @param  nameLength : Length of name
+ * @retval The parameter ID, -1 if not found
+ */
+int16_t FindParamId(const char* name, const size_t nameLength) {
+    const Param_TypeDef* param;
+    uint16_t id;
+
+    for (id = 0; id < nbrOfParams; id++) {
+        param = GetParam(id);
+        if (strlen(param->name) == nameLength && !strncmp(param->name, name, nameLength)) {
+            return (int16_t) id;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * @brief  Gets the value of a parameter
+ * @param  id : Parameter ID
+ * @param  value : Destination value
+ * @retval FCB_OK if got, FCB_ERR if the parameter does not exist
+ */
+FcbRetValType GetParamValue(const uint16_t id, float32_t* value) {
+    const Param_TypeDef* param = GetParam(id);
+
+    if (NULL == param) {
+        return FCB_ERR;
+    }
+
+    *value = ReadParamValue(param);
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Sets the value of a parameter
+ * @param  id : Parameter ID
+ * @param  value : New value
+ * @retval FCB_OK if set, FCB_ERR if the parameter does not exist or the value is out of its range
+ */
+FcbRetValType SetParamValue(const uint16_t id, const float32_t value) {
+    return SetParamValues(id, &value, 1);
+}
+
+/*
+ * @brief  Sets the values of consecutive parameters at once. Either all or none of them are set.
+ * @param  firstId : ID of the first parameter
+ * @param  values : New values, in ID order
+ * @param  nbrOfValues : Number of values
+ * @retval FCB_OK if set, FCB_ERR if a parameter does not exist or a value is out of its range
+ */
+FcbRetValType SetParamValues(const uint16_t firstId, const float32_t* values, const uint16_t nbrOfValues) {
+    bool isGroupWritten[PARAM_GROUP_NBR] = { false };
+    const Param_TypeDef* param;
+    uint8_t groupIdx;
+    uint16_t i;
+
+    if (firstId + nbrOfValues > nbrOfParams) {
+        return FCB_ERR;
+    }
+
+    for (i = 0; i < nbrOfValues; i++) {
+        if (!IsValidParamValue(GetParam(firstId + i), values[i])) {
+            return FCB_ERR;
+        }
+    }
+
+    /* The control tasks pick up a group once it is complete, e.g. the PID coefficients are computed from all gains */
+    vTaskSuspendAll();
+    for (i = 0; i < nbrOfValues; i++) {
+        param = LocateParam(firstId + i, &groupIdx);
+        WriteParamValue(param, values[i]);
+        isGroupWritten[groupIdx] = true;
+    }
+    for (groupIdx = 0; groupIdx < PARAM_GROUP_NBR; groupIdx++) {
+        if (isGroupWritten[groupIdx] && NULL != paramGroups[groupIdx]->apply) {
+            paramGroups[groupIdx]->apply();
+        }
+    }
+    xTaskResumeAll();
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Saves the current values of all groups to flash, from where the subsystems load them at startup. The
+ *         settings are written in one flash batch, so the settings page is erased once. Called under the CLI mutex,
+ *         which keeps the batch to one task.
+ * @param  None
+ * @retval FCB_OK if saved, FCB_ERR if not in idle mode or if writing the flash failed
+ */
+FcbRetValType SaveParams(void) {
+    uint8_t i;
+
+    /* All groups are copied while disarmed, so that the batch holds one consistent set of parameters */
+    if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        return FCB_ERR;
+    }
+
+    if (FLASH_OK != StartFlashSettingsBatch()) {
+        return FCB_ERR;
+    }
+
+    for (i = 0; i < PARAM_GROUP_NBR; i++) {
+        if (NULL != paramGroups[i]->save && FCB_OK != paramGroups[i]->save()) {
+            AbortFlashSettingsBatch();
+            return FCB_ERR;
+        }
+    }
+
+    if (FLASH_OK != EndFlashSettingsBatch()) {
+        return FCB_ERR;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Encodes the values of the whole table as a ParamTableProto message, see param_table.h. There is no
+ *         generated code for it, the fields are written with the nanopb encoding primitives.
+ * @param  stream : Destination stream
+ * @retval true if encoded, false if the stream is too small
+ */
+bool EncodeParamTable(pb_ostream_t* stream) {
+    float32_t values[PARAM_MAX_NBR];
+    uint16_t id;
+
+    /* One snapshot, so that the values are from the same control cycles */
+    vTaskSuspendAll();
+    for (id = 0; id < nbrOfParams; id++) {
+        values[id] = ReadParamValue(GetParam(id));
+    }
+    xTaskResumeAll();
+
+    if (!pb_encode_tag(stream, PB_WT_VARINT, 1) || !pb_encode_varint(stream, 0)
+            || !pb_encode_tag(stream, PB_WT_STRING, 2) || !pb_encode_varint(stream, nbrOfParams*sizeof(float32_t))) {
+        return false;
+    }
+
+    for (id = 0; id < nbrOfParams; id++) {
+        if (!pb_encode_fixed32(stream, &values[id])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * @brief  Decodes a ParamTableProto message, see param_table.h. The values may be packed or not, other fields are
+ *         skipped.
+ * @param  msg : Encoded message
+ * @param  msgSize : Size of msg
+ * @param  firstId : Destination for the ID of the first value
+ * @param  values : Destination values, PARAM_MAX_NBR
+ * @param  nbrOfValues : Destination for the number of values
+ * @retval FCB_OK if decoded, FCB_ERR if the message is malformed or has too many values
+ */
+FcbRetValType DecodeParamTable(const uint8_t* msg, const uint16_t msgSize, uint16_t* firstId, float32_t* values,
+        uint16_t* nbrOfValues) {
+    uint16_t pos = 0;
+    uint16_t end;
+    uint32_t key;
+    uint32_t value;
+
+    *firstId = 0;
+    *nbrOfValues = 0;
+
+    while (pos < msgSize) {
+        if (!ReadVarint(msg, msgSize, &pos, &key)) {
+            return FCB_ERR;
+        }
+
+        switch (key & 0x07) {
+        case PB_WT_VARINT:
+            if (!ReadVarint(msg, msgSize, &pos, &value)) {
+                return FCB_ERR;
+            }
+            if (1 == (key >> 3)) {
+                if (value > UINT16_MAX) {
+                    return FCB_ERR;
+                }
+                *firstId = (uint16_t) value;
+            }
+            break;
+
+        case PB_WT_32BIT:
+            if (pos + sizeof(float32_t) > msgSize) {
+                return FCB_ERR;
+            }
+            if (2 == (key >> 3)) {
+                if (*nbrOfValues >= PARAM_MAX_NBR) {
+                    return FCB_ERR;
+                }
+                memcpy(&values[(*nbrOfValues)++], &msg[pos], sizeof(float32_t)); // Little endian, like the message
+            }
+            pos += sizeof(float32_t);
+            break;
+
+        case PB_WT_64BIT:
+            /* Checked before the skip, which could otherwise wrap pos past the end back into the message */
+            if (pos + 8 > msgSize) {
+                return FCB_ERR;
+            }
+            pos += 8;
+            break;
+
+        case PB_WT_STRING:
+            if (!ReadVarint(msg, msgSize, &pos, &value) || value > (uint32_t) (msgSize - pos)) {
+                return FCB_ERR;
+            }
+            end = pos + value;
+            if (2 == (key >> 3)) {
+                if (0 != value % sizeof(float32_t) || *nbrOfValues + value/sizeof(float32_t) > PARAM_MAX_NBR) {
+                    return FCB_ERR;
+                }
+                for (; pos < end; pos += sizeof(float32_t)) {
+                    memcpy(&values[(*nbrOfValues)++], &msg[pos], sizeof(float32_t));
+                }
+            }
+            pos = end;
+            break;
+
+        default:
+            return FCB_ERR;
+        }
+    }
+
+    return (pos == msgSize) ? FCB_OK : FCB_ERR;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Finds a parameter and its group
+ * @param  id : Parameter ID
+ * @param  groupIdx : Destination for the index of its group
+ * @retval The parameter, NULL if it does not exist
+ */
+static const Param_TypeDef* LocateParam(const uint16_t id, uint8_t* groupIdx) {
+    uint16_t firstId = 0;
+    uint8_t i;
+
+    for (i = 0; i < PARAM_GROUP_NBR && id < nbrOfParams; i++) {
+        if (id < firstId + paramGroups[i]->nbrOfParams) {
+            *groupIdx = i;
+            return &paramGroups[i]->params[id - firstId];
+        }
+        firstId += paramGroups[i]->nbrOfParams;
+    }
+
+    return NULL;
+}
+
+/*
+ * @brief  Reads the storage of a parameter
+ * @param  param : Parameter
+ * @retval The value
+ */
+static float32_t ReadParamValue(const Param_TypeDef* param) {
+    if (PARAM_TYPE_UINT16 == param->type) {
+        return (float32_t) *(volatile uint16_t*) param->value;
+    }
+
+    return *(volatile float32_t*) param->value;
+}
+
+/*
+ * @brief  Writes the storage of a parameter
+ * @param  param : Parameter
+ * @param  value : Value, checked by IsValidParamValue()
+ * @retval None
+ */
+static void WriteParamValue(const Param_TypeDef* param, const float32_t value) {
+    if (PARAM_TYPE_UINT16 == param->type) {
+        *(volatile uint16_t*) param->value = (uint16_t) value;
+    } else {
+        *(volatile float32_t*) param->value = value;
+    }
+}
+
+/*
+ * @brief  Checks a new parameter value against the range and type of the parameter
+ * @param  param : Parameter, NULL if it does not exist
+ * @param  value : New value
+ * @retval true if valid
+ */
+static bool IsValidParamValue(const Param_TypeDef* param, const float32_t value) {
+    /* The range check cannot catch NaN */
+    if (NULL == param || !isfinite(value) || value < param->min || value > param->max) {
+        return false;
+    }
+
+    return PARAM_TYPE_UINT16 != param->type || floorf(value) == value;
+}
+
+/*
+ * @brief  Reads a protobuf varint
+ * @param  msg : Message
+ * @param  msgSize : Size of msg
+ * @param  pos : Position in the message, advanced past the varint
+ * @param  value : Destination value
+ * @retval true if read, false if the varint is truncated or longer than 32 bits
+ */
+static bool ReadVarint(const uint8_t* msg, const uint16_t msgSize, uint16_t* pos, uint32_t* value) {
+    uint8_t shift;
+
+    *value = 0;
+    for (shift = 0; shift < 32 && *pos < msgSize; shift += 7) {
+        *value |= (uint32_t) (msg[*pos] & 0x7F) << shift;
+        if (!(msg[(*pos)++] & 0x80)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,429 @@
+/******************************************************************************
+ * @file    pid_autotune.c
+ * @brief   Relay feedback autotuning of the moment controllers, see
+ *          pid_autotune.h
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "pid_autotune.h"
+
+#include "flight_control.h"
+#include "state_estimation.h"
+#include "fixed_format.h"
+#include "fcb_port.h"
+
+#include <stdio.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+typedef struct {
+    const char* name;
+    PIDControllerIndex_TypeDef controller;
+    float32_t inertia;          // Scaling of the controller output to the moment [kg*m^2]
+    float32_t maxMoment;        // [Nm]
+} AutotuneAxis_TypeDef;
+
+/* Limit cycle measurement, set up by the flight control task before the relay is enabled and then written by the
+ * context of the moment controllers only */
+typedef struct {
+    float32_t output;           // Relay amplitude d [Nm]
+    float32_t sign;             // Of the current relay output, +1 or -1
+    uint32_t samples;           // Since the relay was engaged
+    uint32_t timeoutSamples;
+    uint32_t lastRiseSample;    // Of the latest switch to the positive output, 0 before the first one
+    float32_t errorMin;         // Of the current cycle
+    float32_t errorMax;
+    uint8_t cycles;             // Completed, including the AUTOTUNE_SETTLE_CYCLES
+    float32_t sumPeriods;       // [samples] of the measured cycles
+    float32_t sumAmplitudes;
+} AutotuneRelay_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+
+/* The controllers that set the moments */
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+#define AUTOTUNE_ROLL_CONTROLLER        PID_ROLL_RATE_IDX
+#define AUTOTUNE_PITCH_CONTROLLER       PID_PITCH_RATE_IDX
+#else
+#define AUTOTUNE_ROLL_CONTROLLER        PID_ROLL_ANGLE_IDX
+#define AUTOTUNE_PITCH_CONTROLLER       PID_PITCH_ANGLE_IDX
+#endif
+
+/* Ziegler-Nichols PID rules of the ultimate gain and period */
+#define AUTOTUNE_RULE_K                 ((float32_t) 0.6)
+#define AUTOTUNE_RULE_TI                ((float32_t) 0.5)
+#define AUTOTUNE_RULE_TD                ((float32_t) 0.125)
+
+/* Private variables ---------------------------------------------------------*/
+
+static const AutotuneAxis_TypeDef autotuneAxes[AUTOTUNE_AXIS_NBR] = {
+    { "roll", AUTOTUNE_ROLL_CONTROLLER, IXX, MAX_ROLLPITCH_MOM },
+    { "pitch", AUTOTUNE_PITCH_CONTROLLER, IYY, MAX_ROLLPITCH_MOM },
+    { "yaw", PID_YAW_RATE_IDX, IZZ, MAX_YAW_MOM }
+};
+
+static const char* autotuneStateNames[] = { "off", "waiting for centred sticks", "relay", "proposed", "failed" };
+
+/* Written by the flight control task, and by the CLI with the scheduler suspended */
+static AutotuneStatusType autotuneStatus = { AUTOTUNE_OFF };
+
+/* Set by the flight control task, the context of the moment controllers runs the relay while it is set */
+static volatile bool isRelayEnabled = false;
+
+/* Set by the context of the moment controllers, which then hands the axis back to its controller */
+static volatile bool isRelayMeasured = false;
+static volatile bool isRelayTimedOut = false;
+
+static AutotuneRelay_TypeDef autotuneRelay;
+
+/* Private function prototypes -----------------------------------------------*/
+static bool IsRelayEngageable(void);
+static void EngageRelay(void);
+static void EvaluateLimitCycle(void);
+static RAMFUNC void CompleteRelayCycle(AutotuneRelay_TypeDef* relay);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Starts an autotune of an axis, the relay engages once the attitude flight mode is flown with the sticks
+ *         centred
+ * @param  axis : Axis to tune
+ * @retval FCB_OK if started, FCB_ERR if the axis is not valid
+ */
+FcbRetValType StartAutotune(const AutotuneAxisType axis) {
+    if (axis >= AUTOTUNE_AXIS_NBR) {
+        return FCB_ERR;
+    }
+
+    /* The flight control task updates the autotune, keep it out without masking interrupts */
+    FCB_SUSPEND_SCHEDULER();
+    isRelayEnabled = false;
+    autotuneStatus.state = AUTOTUNE_WAITING;
+    autotuneStatus.axis = axis;
+    autotuneStatus.controller = autotuneAxes[axis].controller;
+    autotuneStatus.cycles = 0;
+    autotuneStatus.interruptions = 0;
+    autotuneStatus.amplitude = 0.0f;
+    autotuneStatus.period = 0.0f;
+    autotuneStatus.ultimateGain = 0.0f;
+    FCB_RESUME_SCHEDULER();
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Stops a running autotune, also discards a pending proposal
+ * @param  None.
+ * @retval None.
+ */
+void StopAutotune(void) {
+    FCB_SUSPEND_SCHEDULER();
+    isRelayEnabled = false;
+    autotuneStatus.state = AUTOTUNE_OFF;
+    FCB_RESUME_SCHEDULER();
+}
+
+/*
+ * @brief  Sets the pending proposal to the gains of the tuned controller
+ * @param  None.
+ * @retval FCB_OK if set, FCB_ERR if there is no proposal or the gains were not set
+ */
+FcbRetValType AcceptAutotune(void) {
+    PIDGains_TypeDef proposal;
+    PIDControllerIndex_TypeDef controller;
+    bool isProposed;
+
+    FCB_SUSPEND_SCHEDULER();
+    isProposed = (AUTOTUNE_PROPOSED == autotuneStatus.state);
+    proposal = autotuneStatus.proposal;
+    controller = autotuneStatus.controller;
+    FCB_RESUME_SCHEDULER();
+
+    if (!isProposed || FCB_OK != SetPIDGains(controller, &proposal)) {
+        return FCB_ERR;
+    }
+
+    StopAutotune();
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Discards the pending proposal, the gains are kept
+ * @param  None.
+ * @retval None.
+ */
+void DiscardAutotune(void) {
+    StopAutotune();
+}
+
+/*
+ * @brief  Engages the relay while the attitude flight mode is flown with the sticks centred and the attitude within
+ *         AUTOTUNE_MAX_ANGLE, and releases it otherwise. Evaluates the limit cycle once it has been measured.
+ * @param  None.
+ * @retval None.
+ */
+void UpdateAutotune(void) {
+    bool isEngageable = IsRelayEngageable();
+
+    FCB_SUSPEND_SCHEDULER();
+    switch (autotuneStatus.state) {
+    case AUTOTUNE_WAITING:
+        if (isEngageable) {
+            EngageRelay();
+            autotuneStatus.state = AUTOTUNE_RELAY;
+        }
+        break;
+
+    case AUTOTUNE_RELAY:
+        if (isRelayMeasured) {
+            isRelayEnabled = false;
+            EvaluateLimitCycle();
+        } else if (isRelayTimedOut) {
+            isRelayEnabled = false;
+            autotuneStatus.state = AUTOTUNE_FAILED;
+        } else if (!isEngageable) {
+            /* The measurement starts over when the relay is engaged again */
+            isRelayEnabled = false;
+            autotuneStatus.interruptions++;
+            autotuneStatus.state = AUTOTUNE_WAITING;
+        }
+        if (autotuneRelay.cycles > AUTOTUNE_SETTLE_CYCLES) {
+            autotuneStatus.cycles = autotuneRelay.cycles - AUTOTUNE_SETTLE_CYCLES;
+        }
+        break;
+
+    default:
+        break;
+    }
+    FCB_RESUME_SCHEDULER();
+}
+
+/*
+ * @brief  Gets the controller the relay replaces
+ * @param  None.
+ * @retval The controller index, PID_NBR_CONTROLLERS if the relay is not running
+ */
+RAMFUNC PIDControllerIndex_TypeDef GetAutotuneRelayController(void) {
+    if (!isRelayEnabled || isRelayMeasured || isRelayTimedOut) {
+        return PID_NBR_CONTROLLERS;
+    }
+
+    return autotuneStatus.controller;
+}
+
+/*
+ * @brief  Switches the relay with hysteresis on the control error, and measures the period and amplitude of each limit
+ *         cycle, from one switch to the positive output to the next
+ * @param  error : Reference less state of the tuned controller
+ * @retval Relay output [Nm]
+ */
+RAMFUNC float32_t UpdateAutotuneRelay(const float32_t error) {
+    AutotuneRelay_TypeDef* relay = &autotuneRelay;
+
+    relay->samples++;
+    relay->errorMin = (error < relay->errorMin) ? error : relay->errorMin;
+    relay->errorMax = (error > relay->errorMax) ? error : relay->errorMax;
+
+    if (relay->sign < 0.0f && error > AUTOTUNE_RELAY_HYSTERESIS) {
+        relay->sign = 1.0f;
+        if (relay->lastRiseSample > 0) {
+            CompleteRelayCycle(relay);
+        }
+        relay->lastRiseSample = relay->samples;
+        relay->errorMin = error;
+        relay->errorMax = error;
+    } else if (relay->sign > 0.0f && error < -AUTOTUNE_RELAY_HYSTERESIS) {
+        relay->sign = -1.0f;
+    }
+
+    if (relay->samples >= relay->timeoutSamples) {
+        isRelayTimedOut = true;
+    }
+
+    return relay->sign*relay->output;
+}
+
+/*
+ * @brief  Gets the autotune status
+ * @param  dstStatus : Destination of the status
+ * @retval None.
+ */
+void GetAutotuneStatus(AutotuneStatusType* dstStatus) {
+    FCB_SUSPEND_SCHEDULER();
+    *dstStatus = autotuneStatus;
+    FCB_RESUME_SCHEDULER();
+}
+
+/*
+ * @brief  Gets the name of an axis, as the CLI takes it
+ * @param  axis : Axis
+ * @retval The name, "unknown" if the axis is not valid
+ */
+const char* GetAutotuneAxisName(const AutotuneAxisType axis) {
+    return (axis < AUTOTUNE_AXIS_NBR) ? autotuneAxes[axis].name : "unknown";
+}
+
+/*
+ * @brief  Prints the autotune state, the measured limit cycle and the pending proposal next to the current gains
+ * @param  dst : Destination string
+ * @param  dstSize : Size of the destination
+ * @retval Length of the printed string
+ */
+size_t PrintAutotuneStatus(char* dst, const size_t dstSize) {
+    AutotuneStatusType status;
+    PIDGains_TypeDef gains;
+    float32_t values[3];
+    size_t length;
+
+    GetAutotuneStatus(&status);
+
+    length = (size_t) snprintf(dst, dstSize, "Autotune: %s", autotuneStateNames[status.state]);
+    if (AUTOTUNE_OFF == status.state) {
+        if (length < dstSize) {
+            length += (size_t) snprintf(dst + length, dstSize - length, "\r\n");
+        }
+        return (length < dstSize) ? length : dstSize - 1;
+    }
+
+    if (length < dstSize) {
+        length += (size_t) snprintf(dst + length, dstSize - length, ", %s axis, cycles %u/%u, interruptions %lu\r\n",
+                GetAutotuneAxisName(status.axis), (unsigned int) status.cycles, (unsigned int) AUTOTUNE_MEASURE_CYCLES,
+                status.interruptions);
+    }
+
+    if ((AUTOTUNE_PROPOSED == status.state) && length < dstSize) {
+        values[0] = status.amplitude;
+        values[1] = status.period;
+        values[2] = status.ultimateGain;
+        length += FormatFixedList(dst + length, dstSize - length,
+                "Limit cycle amplitude %1.4f, period %1.4f s, Ku %1.4f\r\n", values, 3);
+        values[0] = status.proposal.K;
+        values[1] = status.proposal.Ti;
+        values[2] = status.proposal.Td;
+        if (length < dstSize) {
+            length += FormatFixedList(dst + length, dstSize - length, "Proposed K %1.4f, Ti %1.4f, Td %1.4f\r\n",
+                    values, 3);
+        }
+        if (FCB_OK == GetPIDGains(status.controller, &gains) && length < dstSize) {
+            values[0] = gains.K;
+            values[1] = gains.Ti;
+            values[2] = gains.Td;
+            length += FormatFixedList(dst + length, dstSize - length, "Current  K %1.4f, Ti %1.4f, Td %1.4f\r\n",
+                    values, 3);
+        }
+    }
+
+    return (length < dstSize) ? length : dstSize - 1;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Checks that the pilot flies the attitude mode with the sticks centred, and that the attitude is within
+ *         AUTOTUNE_MAX_ANGLE
+ * @param  None.
+ * @retval true if the relay may drive the axis
+ */
+static bool IsRelayEngageable(void) {
+    return FLIGHT_CONTROL_PID == GetFlightControlMode()
+            && fabsf(GetRollAngleReferenceSignal()) < AUTOTUNE_MAX_STICK_ANGLE
+            && fabsf(GetPitchAngleReferenceSignal()) < AUTOTUNE_MAX_STICK_ANGLE
+            && fabsf(GetYawAngularRateReferenceSignal()) < AUTOTUNE_MAX_STICK_RATE
+            && fabsf(GetRollAngle()) < AUTOTUNE_MAX_ANGLE
+            && fabsf(GetPitchAngle()) < AUTOTUNE_MAX_ANGLE;
+}
+
+/*
+ * @brief  Sets up a new limit cycle measurement and enables the relay. Called with the scheduler suspended, while
+ *         the relay is not enabled.
+ * @param  None.
+ * @retval None.
+ */
+static void EngageRelay(void) {
+    const AutotuneAxis_TypeDef* axis = &autotuneAxes[autotuneStatus.axis];
+
+    autotuneRelay.output = AUTOTUNE_RELAY_OUTPUT*axis->maxMoment;
+    autotuneRelay.sign = -1.0f;
+    autotuneRelay.samples = 0;
+    autotuneRelay.timeoutSamples = (uint32_t) (AUTOTUNE_TIMEOUT/GetPIDSamplePeriod(axis->controller));
+    autotuneRelay.lastRiseSample = 0;
+    autotuneRelay.errorMin = 0.0f;
+    autotuneRelay.errorMax = 0.0f;
+    autotuneRelay.cycles = 0;
+    autotuneRelay.sumPeriods = 0.0f;
+    autotuneRelay.sumAmplitudes = 0.0f;
+    autotuneStatus.cycles = 0;
+
+    isRelayMeasured = false;
+    isRelayTimedOut = false;
+    isRelayEnabled = true;
+}
+
+/*
+ * @brief  Computes the ultimate gain and period of the measured limit cycle and the proposed gains of them. Called
+ *         with the scheduler suspended, after the relay has been disabled.
+ * @param  None.
+ * @retval None.
+ */
+static void EvaluateLimitCycle(void) {
+    const AutotuneAxis_TypeDef* axis = &autotuneAxes[autotuneStatus.axis];
+    float32_t root, Kc, Ti, Td;
+
+    autotuneStatus.amplitude = autotuneRelay.sumAmplitudes/AUTOTUNE_MEASURE_CYCLES;
+    autotuneStatus.period = autotuneRelay.sumPeriods/AUTOTUNE_MEASURE_CYCLES*GetPIDSamplePeriod(axis->controller);
+
+    /* A limit cycle within the hysteresis is noise */
+    if (!(autotuneStatus.amplitude > AUTOTUNE_RELAY_HYSTERESIS) || !(autotuneStatus.period > 0.0f)) {
+        autotuneStatus.state = AUTOTUNE_FAILED;
+        return;
+    }
+
+    /* Describing function of the relay with hysteresis, the gain is that of the unscaled controller output */
+    arm_sqrt_f32(autotuneStatus.amplitude*autotuneStatus.amplitude
+            - AUTOTUNE_RELAY_HYSTERESIS*AUTOTUNE_RELAY_HYSTERESIS, &root);
+    autotuneStatus.ultimateGain = 4.0f*autotuneRelay.output/(PI*root*axis->inertia);
+
+    Kc = AUTOTUNE_RULE_K*autotuneStatus.ultimateGain;
+    Ti = AUTOTUNE_RULE_TI*autotuneStatus.period;
+    Td = AUTOTUNE_RULE_TD*autotuneStatus.period;
+
+    autotuneStatus.proposal.K = Kc;
+#if defined(PID_USE_CLASSIC_FORM)
+    autotuneStatus.proposal.Ti = Ti;
+    autotuneStatus.proposal.Td = Td;
+#else
+    /* The parallel form takes the integral and derivative gains */
+    autotuneStatus.proposal.Ti = Kc/Ti;
+    autotuneStatus.proposal.Td = Kc*Td;
+#endif
+    autotuneStatus.state = AUTOTUNE_PROPOSED;
+}
+
+/*
+ * @brief  Adds a completed limit cycle to the measurement, once the relay transient has settled
+ * @param  relay : Measurement
+ * @retval None.
+ */
+static RAMFUNC void CompleteRelayCycle(AutotuneRelay_TypeDef* relay) {
+    relay->cycles++;
+    if (relay->cycles <= AUTOTUNE_SETTLE_CYCLES) {
+        return;
+    }
+
+    relay->sumPeriods += (float32_t) (relay->samples - relay->lastRiseSample);
+    relay->sumAmplitudes += 0.5f*(relay->errorMax - relay->errorMin);
+
+    if (relay->cycles >= AUTOTUNE_SETTLE_CYCLES + AUTOTUNE_MEASURE_CYCLES) {
+        isRelayMeasured = true;
+    }
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
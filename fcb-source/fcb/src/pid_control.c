@@ -29,159 +29,782 @@
 #include "state_estimation.h"
 #include "flight_control.h"
 #include "motor_control.h"
+#include "fcb_gyroscope.h"
+#include "profiler.h"
+#include "scope_probe.h"
+#include "ccm_ram.h"
+#include "fcb_port.h"
+#include "fcb_battery.h"
+#include "telemetry_aggregate.h"
+#include "pid_autotune.h"
 
-#include <stdbool.h>
+#include <stddef.h>
 
 /* Private typedef -----------------------------------------------------------*/
 typedef struct
 {
   float32_t K;					// PID gain parameter
-  float32_t Ti;					// PID integration time parameter
+  float32_t Ti;					// PID integration time (classic form) or integral gain (parallel form), 0 for no integral action
   float32_t Td;					// PID derivative time parameter
-  float32_t Tt;					// Anti-windup tracking parameter
   float32_t Beta;				// Set-point weighting 0-1
   float32_t Gamma;				// Derivative set-point weighting 0-1
   float32_t N;					// Derivative action filter constant
-  float32_t P;					// Proportional control part
-  float32_t I;					// Integration control part
-  float32_t D;					// Derivative control part
-  float32_t preState;			// Previous control state value
-  float32_t preRef;				// Previous reference signal value
   float32_t upperSatLimit;		// Upper saturation limit of control signal
   float32_t lowerSatLimit;		// Lower saturation limit of control signal
   float32_t ctrlSignalScaling;	// Scaling of PID control signal
   float32_t ctrlSignalOffset;	// Static offset of PID control signal
-  bool useIntegralAction;		// Sets if intergral action should be used or not
+  float32_t Kff;				// Setpoint feed-forward gain of the reference derivative, 0 for no feed-forward
+  float32_t Tff;				// Setpoint feed-forward filter time constant [s]
+}PIDParams_TypeDef;
+
+/* Discrete controller coefficients, computed from PIDParams_TypeDef by ComputePIDCoefficients() */
+typedef struct
+{
+  float32_t kPRef;				// Proportional gain of the reference signal
+  float32_t kPState;			// Proportional gain of the control state
+  float32_t kI;					// Integral gain per sample
+  float32_t aD;					// Derivative filter pole
+  float32_t kDRef;				// Derivative gain of the reference signal change
+  float32_t kDState;			// Derivative gain of the control state change
+  float32_t kT;					// Anti-windup tracking gain per sample
+  float32_t upperSatLimit;		// Upper saturation limit of control signal
+  float32_t lowerSatLimit;		// Lower saturation limit of control signal
+  float32_t ctrlSignalScaling;	// Scaling of PID control signal
+  float32_t ctrlSignalOffset;	// Static offset of PID control signal
+  float32_t aFF;				// Feed-forward filter pole
+  float32_t kFF;				// Feed-forward gain of the reference signal change
+}PIDCoefficients_TypeDef;
+
+/* Discrete controller state */
+typedef struct
+{
+  float32_t I;					// Integration control part
+  float32_t D;					// Derivative control part
+  float32_t FF;					// Setpoint feed-forward part
+  float32_t preState;			// Previous control state value
+  float32_t preRef;				// Previous reference signal value
 }PIDController_TypeDef;
 
 /* Private define ------------------------------------------------------------*/
-#define CONTROL_PERIOD			((float32_t) FLIGHT_CONTROL_TASK_PERIOD/1000.0)
+#define CONTROL_PERIOD			GetFlightControlSamplePeriod()
+#define RATE_CONTROL_PERIOD		((float32_t) PID_RATE_LOOP_GYRO_DIVISOR/GyroDataRateHz())
+
+/* The roll/pitch angle controllers output rate references in cascaded mode and moments otherwise */
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+#define ANGLE_CTRL_K			K_ARP
+#define ANGLE_CTRL_TD			0.0
+#define ANGLE_CTRL_SAT_LIMIT	MAX_ROLLPITCH_RATE
+#define ROLL_ANGLE_CTRL_SCALING		1.0
+#define PITCH_ANGLE_CTRL_SCALING	1.0
+#else
+#define ANGLE_CTRL_K			K_RP
+#define ANGLE_CTRL_TD			TD_RP
+#define ANGLE_CTRL_SAT_LIMIT	MAX_ROLLPITCH_MOM
+#define ROLL_ANGLE_CTRL_SCALING		IXX
+#define PITCH_ANGLE_CTRL_SCALING	IYY
+#endif
+
+/* Range of controllers updated by UpdatePIDControlSignals(), the rate loop updates the rest */
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+#define OUTER_LOOP_FIRST_IDX	PID_Z_VELOCITY_IDX
+#else
+#define OUTER_LOOP_FIRST_IDX	PID_ROLL_ANGLE_IDX
+#endif
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+#define OUTER_LOOP_LAST_IDX		PID_PITCH_ANGLE_IDX
+#else
+#define OUTER_LOOP_LAST_IDX		PID_YAW_RATE_IDX
+#endif
+
+/* First of the controllers that set the moments, the last ones, which the gain schedule scales */
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+#define MOMENT_CTRL_FIRST_IDX	PID_ROLL_RATE_IDX
+#else
+#define MOMENT_CTRL_FIRST_IDX	PID_ROLL_ANGLE_IDX
+#endif
+
+/* Gain range of the parameter table */
+#define PID_PARAM_MAX_GAIN		(float32_t) 1000.0
 
 /* Private macro -------------------------------------------------------------*/
 
+/* Range of the gain schedule scales, false for NaN */
+#define IS_PID_GAIN_SCALE(X)	((X) >= PID_SCHEDULE_MIN_SCALE && (X) <= PID_SCHEDULE_MAX_SCALE)
+
+/* Parameter table entries of the gains of a controller, named PID_<name>_K/TI/TD */
+#define PID_GAIN_PARAMS(NAME, IDX) \
+	{ "PID_" NAME "_K", PARAM_TYPE_FLOAT, &pidParams[IDX].K, -PID_PARAM_MAX_GAIN, PID_PARAM_MAX_GAIN }, \
+	{ "PID_" NAME "_TI", PARAM_TYPE_FLOAT, &pidParams[IDX].Ti, 0.0, PID_PARAM_MAX_GAIN }, \
+	{ "PID_" NAME "_TD", PARAM_TYPE_FLOAT, &pidParams[IDX].Td, 0.0, PID_PARAM_MAX_GAIN }
+
 /* Private variables ---------------------------------------------------------*/
-static PIDController_TypeDef AltCtrl;
-static PIDController_TypeDef RollCtrl;
-static PIDController_TypeDef PitchCtrl;
-static PIDController_TypeDef YawCtrl;
+
+/* Default controller parameters, indexed by PIDControllerIndex_TypeDef */
+static const PIDParams_TypeDef defaultPIDParams[PID_NBR_CONTROLLERS] = {
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+	/* Altitude: Z position error to Z velocity reference, limited as the pilot climb rate */
+	{ K_ALT, TI_ALT, TD_ALT, BETA_ALT, GAMMA_ALT, N_ALT, DEFAULT_MAX_Z_VELOCITY, -DEFAULT_MAX_Z_VELOCITY, 1.0, 0.0,
+			KFF_ALT, TFF_ALT },
+#endif
+	/* Z velocity: negative lower limit since Z points to earth, scaled with mass and offset by gravity to obtain thrust */
+	{ K_VZ, TI_VZ, TD_VZ, BETA_VZ, GAMMA_VZ, N_VZ, 0.0, -MAX_THRUST, MASS, -G_ACC, KFF_VZ, TFF_VZ },
+	{ ANGLE_CTRL_K, TI_RP, ANGLE_CTRL_TD, BETA_RP, GAMMA_RP, N_RP, ANGLE_CTRL_SAT_LIMIT, -ANGLE_CTRL_SAT_LIMIT,
+			ROLL_ANGLE_CTRL_SCALING, 0.0, KFF_RP, TFF_RP },
+	{ ANGLE_CTRL_K, TI_RP, ANGLE_CTRL_TD, BETA_RP, GAMMA_RP, N_RP, ANGLE_CTRL_SAT_LIMIT, -ANGLE_CTRL_SAT_LIMIT,
+			PITCH_ANGLE_CTRL_SCALING, 0.0, KFF_RP, TFF_RP },
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+	{ K_RR, TI_RR, TD_RR, BETA_RR, GAMMA_RR, N_RR, MAX_ROLLPITCH_MOM, -MAX_ROLLPITCH_MOM, IXX, 0.0, KFF_RR, TFF_RR },
+	{ K_RR, TI_RR, TD_RR, BETA_RR, GAMMA_RR, N_RR, MAX_ROLLPITCH_MOM, -MAX_ROLLPITCH_MOM, IYY, 0.0, KFF_RR, TFF_RR },
+#endif
+	{ K_YR, TI_YR, TD_YR, BETA_YR, GAMMA_YR, N_YR, MAX_YAW_MOM, -MAX_YAW_MOM, IZZ, 0.0, KFF_YR, TFF_YR }
+};
+
+static PIDParams_TypeDef pidParams[PID_NBR_CONTROLLERS];
+static PIDController_TypeDef pidControllers[PID_NBR_CONTROLLERS] CCM_RAM;
+
+/* Double buffered coefficient sets. New gains are computed into the inactive set, which the flight control task
+ * switches to at the start of its next control cycle, so that a cycle never runs with a partly updated set. */
+static PIDCoefficients_TypeDef pidCoefficients[2][PID_NBR_CONTROLLERS] CCM_RAM;
+static volatile uint8_t activeCoefficientsIdx = 0;
+static volatile uint8_t coefficientsSwapPending = 0;
+static float32_t pidCoefficientsPeriod = 0.0; /* flight control sample period of the newest coefficients [s] */
+
+/* Control states, reference signals and control signals, indexed by PIDControllerIndex_TypeDef */
+static float32_t pidStates[PID_NBR_CONTROLLERS] CCM_RAM;
+static float32_t pidRefs[PID_NBR_CONTROLLERS] CCM_RAM;
+static float32_t pidOutputs[PID_NBR_CONTROLLERS] CCM_RAM;
+
+#ifdef PID_USE_GAIN_SCHEDULING
+/* Breakpoint tables, written with the scheduler suspended as the gains */
+static PIDGainSchedule_TypeDef pidGainSchedule;
+
+/* Scales of the latest schedule evaluation, and the product of them in the newest coefficients */
+static float32_t throttleGainScale = 1.0;
+static float32_t batteryGainScale = 1.0;
+static float32_t pidGainScale = 1.0;
+#endif
 
 /* Private function prototypes -----------------------------------------------*/
-static float32_t UpdatePIDControl(PIDController_TypeDef* ctrlParams, float32_t ctrlState, float32_t refSignal);
+static void LoadPIDParams(void);
+#ifdef PID_USE_GAIN_SCHEDULING
+static void LoadPIDGainSchedule(void);
+static float32_t InterpolatePIDGainSchedule(const float32_t scales[PID_SCHEDULE_BREAKPOINTS], const float32_t x);
+#endif
+static void PublishPIDCoefficients(void);
+static void ComputePIDCoefficients(PIDControllerIndex_TypeDef idx, PIDCoefficients_TypeDef* coeffs);
+static RAMFUNC void UpdatePIDControllers(const uint8_t firstIdx, const uint8_t lastIdx);
+
+/* The gains in the parameter table, indexed as 3*PIDControllerIndex_TypeDef + K/Ti/Td. Written with the scheduler
+ * suspended, as by SetPIDGains(). */
+static const Param_TypeDef pidParamTable[3*PID_NBR_CONTROLLERS] = {
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+	PID_GAIN_PARAMS("ALT", PID_ALTITUDE_IDX),
+#endif
+	PID_GAIN_PARAMS("ZVEL", PID_Z_VELOCITY_IDX),
+	PID_GAIN_PARAMS("ROLL", PID_ROLL_ANGLE_IDX),
+	PID_GAIN_PARAMS("PITCH", PID_PITCH_ANGLE_IDX),
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+	PID_GAIN_PARAMS("ROLLRATE", PID_ROLL_RATE_IDX),
+	PID_GAIN_PARAMS("PITCHRATE", PID_PITCH_RATE_IDX),
+#endif
+	PID_GAIN_PARAMS("YAWRATE", PID_YAW_RATE_IDX)
+};
+
+static const ParamGroup_TypeDef pidParamGroup = { pidParamTable, 3*PID_NBR_CONTROLLERS, PublishPIDCoefficients,
+		SavePIDGains };
 
 /* Exported functions --------------------------------------------------------*/
 
 /*
- * @brief	Initializes the PID controllers, i.e. sets controller parameters.
+ * @brief	Initializes the PID controllers with the gains stored in flash, or the defaults if there are none, and
+ * 			resets the controller states. Called once at startup, before the scheduler is started.
  * @param	None.
  * @retval	None.
  */
 void InitPIDControllers(void) {
-	/* Initialize Altitude Controller */
-	AltCtrl.K = K_VZ;
-	AltCtrl.Ti = TI_VZ;
-	AltCtrl.Td = TD_VZ;
-	AltCtrl.Tt = 0.0;
-	AltCtrl.Beta = BETA_VZ;
-	AltCtrl.Gamma = GAMMA_VZ;
-	AltCtrl.N = N_VZ;
-	AltCtrl.P = 0.0;
-	AltCtrl.I = 0.0;
-	AltCtrl.D = 0.0;
-	AltCtrl.preState = 0.0;
-	AltCtrl.preRef = 0.0;
-	AltCtrl.upperSatLimit = 0.0;
-	AltCtrl.lowerSatLimit = -MAX_THRUST;	// Negative lower limit since Z points to earth
-	AltCtrl.ctrlSignalScaling = MASS;		// Scale with mass to obtain thrust force
-	AltCtrl.ctrlSignalOffset = -G_ACC;		// Gravity offset
-	AltCtrl.useIntegralAction = false;
-
-	/* Rule of thumb method to set this: sqrt(Ti*Td) in classic PID form
-	 * TODO If Td==0 (PI control), a different value needs to be set to Tt
-	 * */
-	if(AltCtrl.useIntegralAction && AltCtrl.Ti >= 0.0) {
-		arm_sqrt_f32(AltCtrl.Td/AltCtrl.Ti, &AltCtrl.Tt); // Rule of thumb method to set this (sqrt(Ti*Td) in classic PID form)
-	}
-
-	/* Initialize Roll Controller */
-	RollCtrl.K = K_RP;
-	RollCtrl.Ti = TI_RP;
-	RollCtrl.Td = TD_RP;
-	RollCtrl.Tt = 0.0;
-	RollCtrl.Beta = BETA_RP;
-	RollCtrl.Gamma = GAMMA_RP;
-	RollCtrl.N = N_RP;
-	RollCtrl.P = 0.0;
-	RollCtrl.I = 0.0;
-	RollCtrl.D = 0.0;
-	RollCtrl.preState = 0.0;
-	RollCtrl.preRef = 0.0;
-	RollCtrl.upperSatLimit = MAX_ROLLPITCH_MOM;
-	RollCtrl.lowerSatLimit = -MAX_ROLLPITCH_MOM;
-	RollCtrl.ctrlSignalScaling = IXX;
-	RollCtrl.ctrlSignalOffset = 0.0;
-	RollCtrl.useIntegralAction = false;
-
-	if(RollCtrl.useIntegralAction && RollCtrl.Ti >= 0.0) {
-		arm_sqrt_f32(RollCtrl.Td/RollCtrl.Ti, &RollCtrl.Tt); // Rule of thumb method to set this (sqrt(Ti*Td) in classic PID form)
-	}
-
-	/* Initialize Pitch Controller */
-	PitchCtrl.K = K_RP;
-	PitchCtrl.Ti = TI_RP;
-	PitchCtrl.Td = TD_RP;
-	PitchCtrl.Tt = 0.0;
-	PitchCtrl.Beta = BETA_RP;
-	PitchCtrl.Gamma = GAMMA_RP;
-	PitchCtrl.N = N_RP;
-	PitchCtrl.P = 0.0;
-	PitchCtrl.I = 0.0;
-	PitchCtrl.D = 0.0;
-	PitchCtrl.preState = 0.0;
-	PitchCtrl.preRef = 0.0;
-	PitchCtrl.upperSatLimit = MAX_ROLLPITCH_MOM;
-	PitchCtrl.lowerSatLimit = -MAX_ROLLPITCH_MOM;
-	PitchCtrl.ctrlSignalScaling = IYY;
-	PitchCtrl.ctrlSignalOffset = 0.0;
-	PitchCtrl.useIntegralAction = false;
-
-	if(PitchCtrl.useIntegralAction && PitchCtrl.Ti >= 0.0) {
-		arm_sqrt_f32(PitchCtrl.Td/PitchCtrl.Ti, &PitchCtrl.Tt); // Rule of thumb method to set this (sqrt(Ti*Td) in classic PID form)
-	}
-
-	/* Initialize Yaw Controller */
-	YawCtrl.K = K_YR;
-	YawCtrl.Ti = TI_YR;
-	YawCtrl.Td = TD_YR;
-	YawCtrl.Tt = 0.0;
-	YawCtrl.Beta = BETA_YR;
-	YawCtrl.Gamma = GAMMA_YR;
-	YawCtrl.N = N_YR;
-	YawCtrl.P = 0.0;
-	YawCtrl.I = 0.0;
-	YawCtrl.D = 0.0;
-	YawCtrl.preState = 0.0;
-	YawCtrl.preRef = 0.0;
-	YawCtrl.upperSatLimit = MAX_YAW_MOM;
-	YawCtrl.lowerSatLimit = -MAX_YAW_MOM;
-	YawCtrl.ctrlSignalScaling = IZZ;
-	YawCtrl.ctrlSignalOffset = 0.0;
-	YawCtrl.useIntegralAction = false;
-
-	if(YawCtrl.useIntegralAction && YawCtrl.Ti >= 0.0) {
-		arm_sqrt_f32(YawCtrl.Td/YawCtrl.Ti, &YawCtrl.Tt); // Rule of thumb method to set this (sqrt(Ti*Td) in classic PID form)
-	}
-}
-
-/*
- * @brief  Update PID control and set control signals
+	uint8_t idx;
+
+	CcmRamRegisterObject("pidControllers", pidControllers, sizeof(pidControllers));
+	CcmRamRegisterObject("pidCoefficients", pidCoefficients, sizeof(pidCoefficients));
+
+	LoadPIDParams();
+#ifdef PID_USE_GAIN_SCHEDULING
+	LoadPIDGainSchedule();
+#endif
+
+	for (idx = 0; idx < PID_NBR_CONTROLLERS; idx++) {
+		ComputePIDCoefficients((PIDControllerIndex_TypeDef) idx, &pidCoefficients[0][idx]);
+	}
+	activeCoefficientsIdx = 0;
+	coefficientsSwapPending = 0;
+	pidCoefficientsPeriod = CONTROL_PERIOD;
+
+	ResetPIDControllers();
+}
+
+/*
+ * @brief	Resets the PID controller states, called by the flight control task on flight mode transitions. Pending
+ * 			gain changes are applied, and the coefficients are recomputed if the flight control sample period has
+ * 			changed, e.g. when the flight control task has started.
+ * @param	None.
+ * @retval	None.
+ */
+void ResetPIDControllers(void) {
+	uint8_t idx;
+
+	if (pidCoefficientsPeriod != CONTROL_PERIOD) {
+		FCB_SUSPEND_SCHEDULER();
+		PublishPIDCoefficients();
+		FCB_RESUME_SCHEDULER();
+	}
+	SwapPIDCoefficients();
+
+	for (idx = 0; idx < PID_NBR_CONTROLLERS; idx++) {
+		pidControllers[idx].I = 0.0;
+		pidControllers[idx].D = 0.0;
+		pidControllers[idx].FF = 0.0;
+		pidControllers[idx].preState = 0.0;
+		pidControllers[idx].preRef = 0.0;
+		pidRefs[idx] = 0.0;
+	}
+}
+
+/*
+ * @brief  Sets the gains of a controller. The new coefficients take effect at the start of the next control cycle,
+ *         the controller states are kept.
+ * @param  idx : Controller index
+ * @param  gains : K, Ti and Td, see PIDGains_TypeDef
+ * @retval FCB_OK if set, FCB_ERR if the index or the gains are invalid
+ */
+FcbRetValType SetPIDGains(const PIDControllerIndex_TypeDef idx, const PIDGains_TypeDef* gains) {
+	if (idx >= PID_NBR_CONTROLLERS || NULL == gains || gains->Ti < 0.0f || gains->Td < 0.0f) {
+		return FCB_ERR;
+	}
+
+	/* The flight control task may recompute the coefficients too, keep it out without masking interrupts */
+	FCB_SUSPEND_SCHEDULER();
+	pidParams[idx].K = gains->K;
+	pidParams[idx].Ti = gains->Ti;
+	pidParams[idx].Td = gains->Td;
+	PublishPIDCoefficients();
+	FCB_RESUME_SCHEDULER();
+
+	return FCB_OK;
+}
+
+/*
+ * @brief  Gets the gains of a controller
+ * @param  idx : Controller index
+ * @param  gains : Destination for K, Ti and Td
+ * @retval FCB_OK if read, FCB_ERR if the index is invalid
+ */
+FcbRetValType GetPIDGains(const PIDControllerIndex_TypeDef idx, PIDGains_TypeDef* gains) {
+	if (idx >= PID_NBR_CONTROLLERS || NULL == gains) {
+		return FCB_ERR;
+	}
+
+	FCB_SUSPEND_SCHEDULER();
+	gains->K = pidParams[idx].K;
+	gains->Ti = pidParams[idx].Ti;
+	gains->Td = pidParams[idx].Td;
+	FCB_RESUME_SCHEDULER();
+
+	return FCB_OK;
+}
+
+/*
+ * @brief  Sets the gains of all controllers at once, so that the control cycles never run a mix of the previous and
+ *         the new gains. The new coefficients are computed by the caller and take effect at the start of the next
+ *         control cycle, the controller states are kept.
+ * @param  settings : Gains of all controllers, see PIDGainSettings_TypeDef
+ * @retval FCB_OK if set, FCB_ERR if the controller set has changed or any gains are invalid
+ */
+FcbRetValType SetAllPIDGains(const PIDGainSettings_TypeDef* settings) {
+	uint8_t idx;
+
+	if (NULL == settings || PID_NBR_CONTROLLERS != settings->nbrOfControllers) {
+		return FCB_ERR;
+	}
+	for (idx = 0; idx < PID_NBR_CONTROLLERS; idx++) {
+		if (!(settings->gains[idx].Ti >= 0.0f) || !(settings->gains[idx].Td >= 0.0f)) {
+			return FCB_ERR;
+		}
+	}
+
+	FCB_SUSPEND_SCHEDULER();
+	for (idx = 0; idx < PID_NBR_CONTROLLERS; idx++) {
+		pidParams[idx].K = settings->gains[idx].K;
+		pidParams[idx].Ti = settings->gains[idx].Ti;
+		pidParams[idx].Td = settings->gains[idx].Td;
+	}
+	PublishPIDCoefficients();
+	FCB_RESUME_SCHEDULER();
+
+	return FCB_OK;
+}
+
+/*
+ * @brief  Gets the gains of all controllers
+ * @param  settings : Destination for the gains
+ * @retval None.
+ */
+void GetAllPIDGains(PIDGainSettings_TypeDef* settings) {
+	uint8_t idx;
+
+	settings->nbrOfControllers = PID_NBR_CONTROLLERS;
+	FCB_SUSPEND_SCHEDULER();
+	for (idx = 0; idx < PID_NBR_CONTROLLERS; idx++) {
+		settings->gains[idx].K = pidParams[idx].K;
+		settings->gains[idx].Ti = pidParams[idx].Ti;
+		settings->gains[idx].Td = pidParams[idx].Td;
+	}
+	FCB_RESUME_SCHEDULER();
+}
+
+/*
+ * @brief  Saves the current gains and setpoint feed-forwards of all controllers to flash, from where they are loaded
+ *         at startup
+ * @param  None.
+ * @retval FCB_OK if saved, FCB_ERR if not in idle mode or if writing the flash failed
+ */
+FcbRetValType SavePIDGains(void) {
+	PIDGainSettings_TypeDef settings;
+	PIDFeedForwardSettings_TypeDef feedForwardSettings;
+	uint8_t idx;
+
+	/* Copy the gains while disarmed, when neither the gain schedule nor a profile switch changes them */
+	if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+		return FCB_ERR;
+	}
+
+	settings.nbrOfControllers = PID_NBR_CONTROLLERS;
+	for (idx = 0; idx < PID_NBR_CONTROLLERS; idx++) {
+		GetPIDGains((PIDControllerIndex_TypeDef) idx, &settings.gains[idx]);
+	}
+
+	feedForwardSettings.nbrOfControllers = PID_NBR_CONTROLLERS;
+	for (idx = 0; idx < PID_NBR_CONTROLLERS; idx++) {
+		GetPIDFeedForward((PIDControllerIndex_TypeDef) idx, &feedForwardSettings.feedForwards[idx]);
+	}
+
+	if (FLASH_OK != WritePIDGainsToFlash(&settings) || FLASH_OK != WritePIDFeedForwardToFlash(&feedForwardSettings)) {
+		return FCB_ERR;
+	}
+
+	return FCB_OK;
+}
+
+/*
+ * @brief  Sets the setpoint feed-forward of a controller, effective from the next control cycle on as the gains
+ * @param  idx : Controller index
+ * @param  feedForward : Gain and filter time constant, see PIDFeedForward_TypeDef
+ * @retval FCB_OK if set, FCB_ERR if the index is invalid or the time constant negative
+ */
+FcbRetValType SetPIDFeedForward(const PIDControllerIndex_TypeDef idx, const PIDFeedForward_TypeDef* feedForward) {
+	if (idx >= PID_NBR_CONTROLLERS || NULL == feedForward || !(feedForward->Tf >= 0.0f)) {
+		return FCB_ERR;
+	}
+
+	FCB_SUSPEND_SCHEDULER();
+	pidParams[idx].Kff = feedForward->K;
+	pidParams[idx].Tff = feedForward->Tf;
+	PublishPIDCoefficients();
+	FCB_RESUME_SCHEDULER();
+
+	return FCB_OK;
+}
+
+/*
+ * @brief  Gets the setpoint feed-forward of a controller
+ * @param  idx : Controller index
+ * @param  feedForward : Destination for the gain and filter time constant
+ * @retval FCB_OK if read, FCB_ERR if the index is invalid
+ */
+FcbRetValType GetPIDFeedForward(const PIDControllerIndex_TypeDef idx, PIDFeedForward_TypeDef* feedForward) {
+	if (idx >= PID_NBR_CONTROLLERS || NULL == feedForward) {
+		return FCB_ERR;
+	}
+
+	FCB_SUSPEND_SCHEDULER();
+	feedForward->K = pidParams[idx].Kff;
+	feedForward->Tf = pidParams[idx].Tff;
+	FCB_RESUME_SCHEDULER();
+
+	return FCB_OK;
+}
+
+/*
+ * @brief  Gets the sample period of a controller, the rate loop period for the inner loop of the cascaded control and
+ *         the flight control sample period otherwise
+ * @param  idx : Controller index
+ * @retval Sample period [s]
+ */
+float32_t GetPIDSamplePeriod(const PIDControllerIndex_TypeDef idx) {
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+	return (idx >= PID_ROLL_RATE_IDX) ? RATE_CONTROL_PERIOD : CONTROL_PERIOD;
+#else
+	(void) idx;
+	return CONTROL_PERIOD;
+#endif
+}
+
+/*
+ * @brief  Gets the PID gains parameters, for the parameter table
+ * @param  None.
+ * @retval The parameter group
+ */
+const ParamGroup_TypeDef* GetPIDParamGroup(void) {
+	return &pidParamGroup;
+}
+
+/*
+ * @brief  Gets the P, I and D parts of the last control signal of a controller, scaled as the control signal and
+ *         before the saturation. Called from the flight control task, after the controller update.
+ * @param  idx : Controller index
+ * @param  terms : Destination for the P, I and D parts
+ * @retval None.
+ */
+void GetPIDTerms(const PIDControllerIndex_TypeDef idx, float32_t terms[3]) {
+	const PIDCoefficients_TypeDef* coeff = &pidCoefficients[activeCoefficientsIdx][idx];
+	const PIDController_TypeDef* ctrl = &pidControllers[idx];
+
+	terms[0] = (coeff->kPRef*ctrl->preRef - coeff->kPState*ctrl->preState)*coeff->ctrlSignalScaling;
+	terms[1] = ctrl->I*coeff->ctrlSignalScaling;
+	terms[2] = ctrl->D*coeff->ctrlSignalScaling;
+}
+
+/*
+ * @brief  Checks if the last control signal of a controller is at one of its saturation limits. Called from the
+ *         flight control task, after the controller update.
+ * @param  idx : Controller index
+ * @retval true if saturated, else false
+ */
+bool IsPIDOutputSaturated(const PIDControllerIndex_TypeDef idx) {
+	const PIDCoefficients_TypeDef* coeff = &pidCoefficients[activeCoefficientsIdx][idx];
+
+	return pidOutputs[idx] >= coeff->upperSatLimit || pidOutputs[idx] <= coeff->lowerSatLimit;
+}
+
+/*
+ * @brief  Gets the control error of the last update of a controller, its reference less its state, in the unit of
+ *         the controller input
+ * @param  idx : Controller index
+ * @retval The control error
+ */
+float32_t GetPIDControlError(const PIDControllerIndex_TypeDef idx) {
+	return pidControllers[idx].preRef - pidControllers[idx].preState;
+}
+
+#ifdef PID_USE_GAIN_SCHEDULING
+/*
+ * @brief  Evaluates the gain schedule on every PID_SCHEDULE_DIVISOR:th call and recomputes the coefficients into the
+ *         inactive set if the scale of the moment controllers has changed, which the next control cycle swaps to.
+ *         Called by the flight control task once per control cycle, before the PID control update.
+ * @param  thrust : Thrust of the latest control cycle [N], negative upwards
+ * @retval None.
+ */
+void UpdatePIDGainSchedule(const float32_t thrust) {
+	static uint16_t cycleCounter = 0;
+	float32_t cellVoltage = -1.0;
+	float32_t scales[2];
+#ifdef FCB_BATTERY_MONITOR
+	FcbBatteryStateType battery;
+#endif
+
+	if (++cycleCounter < PID_SCHEDULE_DIVISOR) {
+		return;
+	}
+	cycleCounter = 0;
+
+#ifdef FCB_BATTERY_MONITOR
+	GetBatteryState(&battery);
+	if (battery.cells > 0) {
+		cellVoltage = battery.voltage/battery.cells;
+	}
+#endif
+
+	/* The CLI may set the tables, keep it out without masking interrupts */
+	FCB_SUSPEND_SCHEDULER();
+	throttleGainScale = InterpolatePIDGainSchedule(pidGainSchedule.throttleScales, -thrust/MAX_THRUST);
+	/* Without a connected battery the voltage is not known, so it does not scale the gains */
+	batteryGainScale = (cellVoltage < 0.0f) ? 1.0f : InterpolatePIDGainSchedule(pidGainSchedule.batteryScales,
+			(cellVoltage - PID_SCHEDULE_MIN_CELL_VOLTAGE)
+			/(PID_SCHEDULE_MAX_CELL_VOLTAGE - PID_SCHEDULE_MIN_CELL_VOLTAGE));
+	scales[0] = throttleGainScale;
+	scales[1] = batteryGainScale;
+
+	if (fabsf(scales[0]*scales[1] - pidGainScale) >= PID_SCHEDULE_MIN_CHANGE) {
+		pidGainScale = scales[0]*scales[1];
+		PublishPIDCoefficients();
+	}
+	FCB_RESUME_SCHEDULER();
+
+	AggregateSamples(AGGREGATE_PID_THROTTLE_SCALE, scales, 2);
+}
+
+/*
+ * @brief  Gets the scales of the latest gain schedule evaluation
+ * @param  throttleScale : Destination of the scale of the throttle table
+ * @param  batteryScale : Destination of the scale of the battery table
+ * @retval None.
+ */
+void GetPIDGainScheduleScales(float32_t* throttleScale, float32_t* batteryScale) {
+	FCB_SUSPEND_SCHEDULER();
+	*throttleScale = throttleGainScale;
+	*batteryScale = batteryGainScale;
+	FCB_RESUME_SCHEDULER();
+}
+
+/*
+ * @brief  Sets the gain schedule breakpoint tables, evaluated from the next schedule update on
+ * @param  schedule : Scales in [PID_SCHEDULE_MIN_SCALE, PID_SCHEDULE_MAX_SCALE]
+ * @retval FCB_OK if set, FCB_ERR if a scale is out of range
+ */
+FcbRetValType SetPIDGainSchedule(const PIDGainSchedule_TypeDef* schedule) {
+	uint8_t i;
+
+	if (NULL == schedule) {
+		return FCB_ERR;
+	}
+	for (i = 0; i < PID_SCHEDULE_BREAKPOINTS; i++) {
+		if (!IS_PID_GAIN_SCALE(schedule->throttleScales[i]) || !IS_PID_GAIN_SCALE(schedule->batteryScales[i])) {
+			return FCB_ERR;
+		}
+	}
+
+	FCB_SUSPEND_SCHEDULER();
+	pidGainSchedule = *schedule;
+	FCB_RESUME_SCHEDULER();
+
+	return FCB_OK;
+}
+
+/*
+ * @brief  Gets the gain schedule breakpoint tables
+ * @param  schedule : Destination of the tables
+ * @retval None.
+ */
+void GetPIDGainSchedule(PIDGainSchedule_TypeDef* schedule) {
+	FCB_SUSPEND_SCHEDULER();
+	*schedule = pidGainSchedule;
+	FCB_RESUME_SCHEDULER();
+}
+
+/*
+ * @brief  Saves the gain schedule breakpoint tables to flash, from where they are loaded at startup
+ * @param  None.
+ * @retval FCB_OK if saved, FCB_ERR if not in idle mode or if writing the flash failed
+ */
+FcbRetValType SavePIDGainSchedule(void) {
+	PIDGainSchedule_TypeDef schedule;
+
+	/* The schedule is copied while disarmed, so that its breakpoints are saved as one consistent set */
+	if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+		return FCB_ERR;
+	}
+
+	GetPIDGainSchedule(&schedule);
+	if (FLASH_OK != WritePIDGainScheduleToFlash(&schedule)) {
+		return FCB_ERR;
+	}
+
+	return FCB_OK;
+}
+#endif
+
+/*
+ * @brief  Update PID control and set control signals. In cascaded mode this is the outer loop, which sets the thrust
+ *         and the roll/pitch rate references, the moments are then set by UpdatePIDRateControlSignals().
  * @param  ctrlSignals : Control signals struct
  * @retval None.
  */
-void UpdatePIDControlSignals(CtrlSignals_TypeDef* ctrlSignals) {
-    // ctrlSignals->thrust = UpdatePIDControl(&AltCtrl, GetZVelocity(), GetZVelocityReferenceSignal()); // TODO control altitude later
-    ctrlSignals->rollMoment = UpdatePIDControl(&RollCtrl, GetRollAngle(), GetRollAngleReferenceSignal());
-    ctrlSignals->pitchMoment = UpdatePIDControl(&PitchCtrl, GetPitchAngle(), GetPitchAngleReferenceSignal());
-    ctrlSignals->yawMoment = UpdatePIDControl(&YawCtrl, GetYawRate(), GetYawAngularRateReferenceSignal()); // TODO should be GetYawRate()
+RAMFUNC void UpdatePIDControlSignals(CtrlSignals_TypeDef* ctrlSignals) {
+	PROFILE_SCOPE(PROFILE_PROBE_PID);
+	SCOPE_PROBE_SCOPE(SCOPE_PROBE_STAGE_PID);
+
+	/* A control cycle starts here, also in cascaded mode where the rate loop then runs with the same set */
+	SwapPIDCoefficients();
+
+	pidStates[PID_Z_VELOCITY_IDX] = GetZVelocity();
+	pidRefs[PID_Z_VELOCITY_IDX] = GetZVelocityReferenceSignal();
+	pidStates[PID_ROLL_ANGLE_IDX] = GetRollAngle();
+	pidRefs[PID_ROLL_ANGLE_IDX] = GetRollAngleReferenceSignal();
+	pidStates[PID_PITCH_ANGLE_IDX] = GetPitchAngle();
+	pidRefs[PID_PITCH_ANGLE_IDX] = GetPitchAngleReferenceSignal();
+#ifndef PID_USE_CASCADED_RATE_CONTROL
+	pidStates[PID_YAW_RATE_IDX] = GetYawRate();
+	pidRefs[PID_YAW_RATE_IDX] = GetYawAngularRateReferenceSignal();
+#endif
+
+	UpdatePIDControllers(OUTER_LOOP_FIRST_IDX, OUTER_LOOP_LAST_IDX);
+
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+	ctrlSignals->thrust = pidOutputs[PID_Z_VELOCITY_IDX];
+#endif
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+	/* Body rate references of the rate loop */
+	pidRefs[PID_ROLL_RATE_IDX] = pidOutputs[PID_ROLL_ANGLE_IDX];
+	pidRefs[PID_PITCH_RATE_IDX] = pidOutputs[PID_PITCH_ANGLE_IDX];
+#else
+	ctrlSignals->rollMoment = pidOutputs[PID_ROLL_ANGLE_IDX];
+	ctrlSignals->pitchMoment = pidOutputs[PID_PITCH_ANGLE_IDX];
+	ctrlSignals->yawMoment = pidOutputs[PID_YAW_RATE_IDX];
+#endif
+}
+
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+/*
+ * @brief  Update the altitude controller of the altitude hold flight mode, before UpdatePIDControlSignals() in the
+ *         same control cycle
+ * @param  refZPosition : Held Z position [m], positive downwards
+ * @retval Z velocity reference [m/s], positive downwards
+ */
+RAMFUNC float32_t UpdatePIDAltitudeControl(const float32_t refZPosition) {
+	/* The control cycle starts here, UpdatePIDControlSignals() then keeps the same set */
+	SwapPIDCoefficients();
+
+	pidStates[PID_ALTITUDE_IDX] = GetZPosition();
+	pidRefs[PID_ALTITUDE_IDX] = refZPosition;
+
+	UpdatePIDControllers(PID_ALTITUDE_IDX, PID_ALTITUDE_IDX);
+
+	return pidOutputs[PID_ALTITUDE_IDX];
+}
+
+/*
+ * @brief  Initializes the vertical controller states after ResetPIDControllers(), so that the thrust continues from
+ *         the given one at zero velocity error instead of stepping to the hover thrust. Used for a bumpless transfer
+ *         into and out of the altitude hold flight mode.
+ * @param  thrust : Thrust of the previous flight mode [N], negative upwards
+ * @retval None.
+ */
+void InitPIDVerticalControlState(const float32_t thrust) {
+	const PIDCoefficients_TypeDef* coeff = &pidCoefficients[activeCoefficientsIdx][PID_Z_VELOCITY_IDX];
+
+	/* The integral part takes the difference to the hover feed-forward, i.e. the mass scaled gravity offset */
+	if (coeff->ctrlSignalScaling != 0.0f) {
+		pidControllers[PID_Z_VELOCITY_IDX].I = thrust/coeff->ctrlSignalScaling - coeff->ctrlSignalOffset;
+	}
+	/* No derivative kick from the states the reset cleared */
+	pidControllers[PID_Z_VELOCITY_IDX].preState = GetZVelocity();
+	pidControllers[PID_ALTITUDE_IDX].preState = GetZPosition();
+}
+#endif
+
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+/*
+ * @brief  Update the inner rate loop of the cascaded control, i.e. the roll, pitch & yaw moments
+ * @param  ctrlSignals : Control signals struct
+ * @retval None.
+ */
+RAMFUNC void UpdatePIDRateControlSignals(CtrlSignals_TypeDef* ctrlSignals) {
+	pidStates[PID_ROLL_RATE_IDX] = GetRollRate();
+	pidStates[PID_PITCH_RATE_IDX] = GetPitchRate();
+	pidStates[PID_YAW_RATE_IDX] = GetYawRate();
+	pidRefs[PID_YAW_RATE_IDX] = GetYawAngularRateReferenceSignal();
+
+	UpdatePIDControllers(PID_ROLL_RATE_IDX, PID_YAW_RATE_IDX);
+
+	ctrlSignals->rollMoment = pidOutputs[PID_ROLL_RATE_IDX];
+	ctrlSignals->pitchMoment = pidOutputs[PID_PITCH_RATE_IDX];
+	ctrlSignals->yawMoment = pidOutputs[PID_YAW_RATE_IDX];
+}
+
+/*
+ * @brief  Update the rate loop alone in the rate flight mode. It closes on the unbiased gyroscope body rates, so no
+ *         attitude estimate is involved, and every update is a control cycle of its own.
+ * @param  ctrlSignals : Control signals struct, the thrust is left as set by the caller
+ * @param  refRates : Roll, pitch & yaw body rate references [rad/s]
+ * @retval None.
+ */
+RAMFUNC void UpdatePIDRateModeControlSignals(CtrlSignals_TypeDef* ctrlSignals, const float32_t refRates[3]) {
+	float32_t bodyRates[3];
+
+	SwapPIDCoefficients();
+
+	GetUnbiasedBodyRates(bodyRates);
+	UpdatePIDRateLoop(ctrlSignals, bodyRates, refRates);
+}
+
+/*
+ * @brief  Updates the rate controllers from given body rates and references, without any coefficient swap or state
+ *         estimate access. Used by the control executive, and uses no FreeRTOS API.
+ * @param  ctrlSignals : Control signals struct, the moments are set
+ * @param  rates : Roll, pitch & yaw body rates [rad/s]
+ * @param  refRates : Roll, pitch & yaw body rate references [rad/s]
+ * @retval None.
+ */
+RAMFUNC void UpdatePIDRateLoop(CtrlSignals_TypeDef* ctrlSignals, const float32_t rates[3], const float32_t refRates[3]) {
+	pidStates[PID_ROLL_RATE_IDX] = rates[ROLL_IDX];
+	pidRefs[PID_ROLL_RATE_IDX] = refRates[ROLL_IDX];
+	pidStates[PID_PITCH_RATE_IDX] = rates[PITCH_IDX];
+	pidRefs[PID_PITCH_RATE_IDX] = refRates[PITCH_IDX];
+	pidStates[PID_YAW_RATE_IDX] = rates[YAW_IDX];
+	pidRefs[PID_YAW_RATE_IDX] = refRates[YAW_IDX];
+
+	UpdatePIDControllers(PID_ROLL_RATE_IDX, PID_YAW_RATE_IDX);
+
+	ctrlSignals->rollMoment = pidOutputs[PID_ROLL_RATE_IDX];
+	ctrlSignals->pitchMoment = pidOutputs[PID_PITCH_RATE_IDX];
+	ctrlSignals->yawMoment = pidOutputs[PID_YAW_RATE_IDX];
+}
+
+/*
+ * @brief  Gets the rate references of the latest outer loop update, as UpdatePIDRateControlSignals() uses them
+ * @param  refRates : Destination roll, pitch & yaw body rate references [rad/s]
+ * @retval None.
+ */
+void GetPIDRateLoopReferences(float32_t refRates[3]) {
+	refRates[ROLL_IDX] = pidOutputs[PID_ROLL_ANGLE_IDX];
+	refRates[PITCH_IDX] = pidOutputs[PID_PITCH_ANGLE_IDX];
+	refRates[YAW_IDX] = GetYawAngularRateReferenceSignal();
+}
+#endif
+
+/*
+ * @brief  Back calculation anti-windup of the moment controllers with the moments the motor allocation achieved. The
+ *         controller update has tracked its own saturation limits, this tracks on to the achieved moment, so that an
+ *         integral part does not wind up while the motor limits take a part of its moment away, e.g. of the yaw under
+ *         the roll & pitch priority of motor_mixer.h. Called after the allocation of the latest moment update, uses no
+ *         FreeRTOS API.
+ * @param  ctrlSignals : Control signals of the allocation
+ * @param  achievedMoments : Roll, pitch & yaw moments [Nm] the allocation achieved, see MotorAllocationPhysical()
+ * @retval None.
+ */
+RAMFUNC void ApplyPIDAllocationFeedback(const CtrlSignals_TypeDef* ctrlSignals, const float32_t achievedMoments[3]) {
+	const PIDCoefficients_TypeDef* coeffs = pidCoefficients[activeCoefficientsIdx];
+#ifdef PID_AUTOTUNE
+	PIDControllerIndex_TypeDef relayIdx;
+#endif
+
+	pidControllers[MOMENT_CTRL_FIRST_IDX].I += coeffs[MOMENT_CTRL_FIRST_IDX].kT
+			*(achievedMoments[ROLL_IDX] - ctrlSignals->rollMoment);
+	pidControllers[MOMENT_CTRL_FIRST_IDX + 1].I += coeffs[MOMENT_CTRL_FIRST_IDX + 1].kT
+			*(achievedMoments[PITCH_IDX] - ctrlSignals->pitchMoment);
+	pidControllers[PID_YAW_RATE_IDX].I += coeffs[PID_YAW_RATE_IDX].kT
+			*(achievedMoments[YAW_IDX] - ctrlSignals->yawMoment);
+
+#ifdef PID_AUTOTUNE
+	/* The integral part of the controller the relay replaces stays held off */
+	relayIdx = GetAutotuneRelayController();
+	if (relayIdx >= MOMENT_CTRL_FIRST_IDX && relayIdx <= PID_YAW_RATE_IDX) {
+		pidControllers[relayIdx].I = 0.0;
+	}
+#endif
+}
+
+/*
+ * @brief	Switches to the newest coefficient set, if one is pending. Called by the flight control task between
+ * 			control cycles only.
+ * @param	None.
+ * @retval	None.
+ */
+void SwapPIDCoefficients(void) {
+	/* Publishing runs with the scheduler suspended, so a pending set is always complete here */
+	if (coefficientsSwapPending) {
+		activeCoefficientsIdx ^= 1;
+		coefficientsSwapPending = 0;
+	}
 }
 
 /*
@@ -199,69 +822,234 @@ void ResetCtrlSignals(CtrlSignals_TypeDef* ctrlSignals) {
 /* Private functions ---------------------------------------------------------*/
 
 /*
- * @brief	Updates a PID control value based on current state and reference signal
- * @param	ctrlParams : Reference to PID parameter struct
- * @param	ctrlState : The control state value
- * @param	refSignal : The control reference signal value
- * @retval	PID control signal value
+ * @brief	Loads the default parameters and replaces their gains and setpoint feed-forwards with the ones stored in
+ * 			flash, if valid
+ * @param	None.
+ * @retval	None.
+ */
+static void LoadPIDParams(void) {
+	PIDGainSettings_TypeDef settings;
+	PIDFeedForwardSettings_TypeDef feedForwardSettings;
+	uint8_t useFlashGains, useFlashFeedForwards;
+	uint8_t idx;
+
+	useFlashGains = (FLASH_OK == ReadPIDGainsFromFlash(&settings) && PID_NBR_CONTROLLERS == settings.nbrOfControllers);
+	for (idx = 0; idx < PID_NBR_CONTROLLERS && useFlashGains; idx++) {
+		if (settings.gains[idx].Ti < 0.0f || settings.gains[idx].Td < 0.0f) {
+			useFlashGains = 0;
+		}
+	}
+
+	useFlashFeedForwards = (FLASH_OK == ReadPIDFeedForwardFromFlash(&feedForwardSettings)
+			&& PID_NBR_CONTROLLERS == feedForwardSettings.nbrOfControllers);
+	for (idx = 0; idx < PID_NBR_CONTROLLERS && useFlashFeedForwards; idx++) {
+		if (!(feedForwardSettings.feedForwards[idx].Tf >= 0.0f)) {
+			useFlashFeedForwards = 0;
+		}
+	}
+
+	for (idx = 0; idx < PID_NBR_CONTROLLERS; idx++) {
+		pidParams[idx] = defaultPIDParams[idx];
+		if (useFlashGains) {
+			pidParams[idx].K = settings.gains[idx].K;
+			pidParams[idx].Ti = settings.gains[idx].Ti;
+			pidParams[idx].Td = settings.gains[idx].Td;
+		}
+		if (useFlashFeedForwards) {
+			pidParams[idx].Kff = feedForwardSettings.feedForwards[idx].K;
+			pidParams[idx].Tff = feedForwardSettings.feedForwards[idx].Tf;
+		}
+	}
+}
+
+#ifdef PID_USE_GAIN_SCHEDULING
+/*
+ * @brief	Loads the gain schedule tables stored in flash, or scales of 1.0 if there are none or any is out of range
+ * @param	None.
+ * @retval	None.
  */
-static float32_t UpdatePIDControl(PIDController_TypeDef* ctrlParams, float32_t ctrlState, float32_t refSignal) {
-	float32_t controlSignal, tmpControlSignal;
+static void LoadPIDGainSchedule(void) {
+	PIDGainSchedule_TypeDef schedule;
+	uint8_t i;
+
+	if (FLASH_OK == ReadPIDGainScheduleFromFlash(&schedule) && FCB_OK == SetPIDGainSchedule(&schedule)) {
+		return;
+	}
+
+	for (i = 0; i < PID_SCHEDULE_BREAKPOINTS; i++) {
+		pidGainSchedule.throttleScales[i] = 1.0;
+		pidGainSchedule.batteryScales[i] = 1.0;
+	}
+}
 
-	/* Calculate Proportional control part */
-	ctrlParams->P = ctrlParams->K*(ctrlParams->Beta*refSignal - ctrlState);
+/*
+ * @brief	Interpolates a scale of a gain schedule table linearly between its breakpoints
+ * @param	scales : Scales at the evenly spaced breakpoints
+ * @param	x : Position over the breakpoints, 0 at the first and 1 at the last, held beyond them
+ * @retval	Scale
+ */
+static float32_t InterpolatePIDGainSchedule(const float32_t scales[PID_SCHEDULE_BREAKPOINTS], const float32_t x) {
+	float32_t position;
+	uint8_t i;
+
+	if (!(x > 0.0f)) {
+		return scales[0];
+	} else if (x >= 1.0f) {
+		return scales[PID_SCHEDULE_BREAKPOINTS - 1];
+	}
+
+	position = x*(PID_SCHEDULE_BREAKPOINTS - 1);
+	i = (uint8_t) position;
+
+	return scales[i] + (position - i)*(scales[i + 1] - scales[i]);
+}
+#endif
+
+/*
+ * @brief	Computes the coefficients of all controllers into the inactive set and marks it for the swap. Must be
+ * 			called with the scheduler suspended, so that two tasks never write the inactive set at the same time.
+ * @param	None.
+ * @retval	None.
+ */
+static void PublishPIDCoefficients(void) {
+	PIDCoefficients_TypeDef* coeffs = pidCoefficients[activeCoefficientsIdx ^ 1];
+	uint8_t idx;
+
+	for (idx = 0; idx < PID_NBR_CONTROLLERS; idx++) {
+		ComputePIDCoefficients((PIDControllerIndex_TypeDef) idx, &coeffs[idx]);
+	}
+	pidCoefficientsPeriod = CONTROL_PERIOD;
+	coefficientsSwapPending = 1;
+}
+
+/*
+ * @brief	Computes the discrete coefficients of a controller from its parameters and sample period, so that the
+ * 			update needs no divisions
+ * @param	idx : Controller index
+ * @param	ctrl : Destination coefficients
+ * @retval	None.
+ */
+static void ComputePIDCoefficients(PIDControllerIndex_TypeDef idx, PIDCoefficients_TypeDef* ctrl) {
+	const PIDParams_TypeDef* params = &pidParams[idx];
+	float32_t h, derivativeDenominator, Tt = 0.0;
+
+	h = GetPIDSamplePeriod(idx);
+
+	derivativeDenominator = params->Td + params->N*h;
+
+	ctrl->kPState = params->K;
+	ctrl->kPRef = params->K*params->Beta;
+	ctrl->aD = (derivativeDenominator > 0.0f) ? params->Td/derivativeDenominator : 0.0f;
 
 #if defined(PID_USE_CLASSIC_FORM)
 	/* Classic form based on: u(t) = K*e(t) + K/Ti*integr(e(t)) + K*Td*deriv(e(t))
 	 * */
+	ctrl->kI = (params->Ti > 0.0f) ? params->K*h/params->Ti : 0.0f;
+	ctrl->kDState = (derivativeDenominator > 0.0f) ? params->K*params->Td*params->N/derivativeDenominator : 0.0f;
 
-	/* Calculate Integral control part */
-	if(ctrlParams->Ti > 0.0) {
-		ctrlParams->I += ctrlParams->K*CONTROL_PERIOD/ctrlParams->Ti*(refSignal - ctrlState);
+	/* Rule of thumb for the anti-windup tracking time: sqrt(Ti*Td), Ti for PI control */
+	if (params->Ti > 0.0f) {
+		if (params->Td > 0.0f) {
+			arm_sqrt_f32(params->Ti*params->Td, &Tt);
+		} else {
+			Tt = params->Ti;
+		}
 	}
 
-	/* Calculate Derivative control part */
-	ctrlParams->D = ctrlParams->Td / (ctrlParams->Td + ctrlParams->N * CONTROL_PERIOD)*ctrlParams->D
-			+ ctrlParams->K * ctrlParams->Td * ctrlParams->N / (ctrlParams->Td + ctrlParams->N * CONTROL_PERIOD )
-			* (ctrlParams->Gamma * (refSignal - ctrlParams->preRef) - (ctrlState - ctrlParams->preState));
-
 #elif defined(PID_USE_PARALLEL_FORM)
 	/* Parallel form based on: u(t) = K*e(t) + Ti*integr(e(t)) - Td*deriv(y(t))
 	 * */
+	ctrl->kI = (params->Ti > 0.0f) ? params->Ti*h : 0.0f;
+	ctrl->kDState = (derivativeDenominator > 0.0f) ? params->Td*params->N/derivativeDenominator : 0.0f;
 
-	/* Calculate Integral control part */
-	if(ctrlParams->useIntegralAction) {
-		ctrlParams->I += ctrlParams->Ti*CONTROL_PERIOD*(refSignal - ctrlState);
+	/* Rule of thumb for the anti-windup tracking time, sqrt(Ti*Td) or Ti of the equivalent classic form */
+	if (params->Ti > 0.0f) {
+		if (params->Td > 0.0f) {
+			arm_sqrt_f32(params->Td/params->Ti, &Tt);
+		} else {
+			Tt = params->K/params->Ti;
+		}
 	}
+#endif
+	ctrl->kDRef = ctrl->kDState*params->Gamma;
+
+#ifdef PID_USE_GAIN_SCHEDULING
+	/* The scheduled scale multiplies the K, Ti & Td parts, the derivative filter pole and the anti-windup tracking time
+	 * only depend on their ratios and are kept */
+	if (idx >= MOMENT_CTRL_FIRST_IDX) {
+		ctrl->kPState *= pidGainScale;
+		ctrl->kPRef *= pidGainScale;
+		ctrl->kI *= pidGainScale;
+		ctrl->kDState *= pidGainScale;
+		ctrl->kDRef *= pidGainScale;
+	}
+#endif
 
-	/* Calculate Derivative control part */
-	ctrlParams->D = ctrlParams->Td/(ctrlParams->Td + ctrlParams->N * CONTROL_PERIOD)*ctrlParams->D
-			+ ctrlParams->Td*ctrlParams->N/(ctrlParams->Td + ctrlParams->N * CONTROL_PERIOD)
-			* (ctrlParams->Gamma*(refSignal - ctrlParams->preRef) - (ctrlState - ctrlParams->preState));
+	/* Backward Euler low-pass filter of the reference derivative, not gain scheduled since it follows the model */
+	ctrl->aFF = (params->Tff + h > 0.0f) ? params->Tff/(params->Tff + h) : 0.0f;
+	ctrl->kFF = (params->Tff + h > 0.0f) ? params->Kff/(params->Tff + h) : 0.0f;
 
+	/* The saturation error is scaled back to the unscaled integral part */
+	ctrl->kT = (Tt > 0.0f && params->ctrlSignalScaling != 0.0f) ? h/(Tt*params->ctrlSignalScaling) : 0.0f;
+
+	ctrl->upperSatLimit = params->upperSatLimit;
+	ctrl->lowerSatLimit = params->lowerSatLimit;
+	ctrl->ctrlSignalScaling = params->ctrlSignalScaling;
+	ctrl->ctrlSignalOffset = params->ctrlSignalOffset;
+}
+
+/*
+ * @brief	Updates a range of controllers from pidStates and pidRefs to pidOutputs. Unused parts have zero
+ * 			coefficients, so all controllers run the same branch free arithmetic except for the saturation.
+ * @param	firstIdx : First controller to update
+ * @param	lastIdx : Last controller to update, inclusive
+ * @retval	None.
+ */
+static RAMFUNC void UpdatePIDControllers(const uint8_t firstIdx, const uint8_t lastIdx) {
+	const PIDCoefficients_TypeDef* coeffs = pidCoefficients[activeCoefficientsIdx];
+	uint8_t idx;
+#ifdef PID_AUTOTUNE
+	PIDControllerIndex_TypeDef relayIdx;
 #endif
 
-	/* Calculate sum of P-I-D parts to obtain the control signal and add offset part. Multiply with scaling factor. */
-	controlSignal = (ctrlParams->P + ctrlParams->I + ctrlParams->D + ctrlParams->ctrlSignalOffset) * ctrlParams->ctrlSignalScaling;
+	for (idx = firstIdx; idx <= lastIdx; idx++) {
+		const PIDCoefficients_TypeDef* coeff = &coeffs[idx];
+		PIDController_TypeDef* ctrl = &pidControllers[idx];
+		float32_t ctrlState = pidStates[idx];
+		float32_t refSignal = pidRefs[idx];
+		float32_t controlSignal, tmpControlSignal;
 
-	/* Saturate controller output */
-	tmpControlSignal = controlSignal;
-	if (controlSignal < ctrlParams->lowerSatLimit) {
-		controlSignal = ctrlParams->lowerSatLimit;
-	} else if (controlSignal > ctrlParams->upperSatLimit) {
-		controlSignal = ctrlParams->upperSatLimit;
-	}
+		/* Integral and derivative control parts */
+		ctrl->I += coeff->kI*(refSignal - ctrlState);
+		ctrl->D = coeff->aD*ctrl->D + coeff->kDRef*(refSignal - ctrl->preRef) - coeff->kDState*(ctrlState - ctrl->preState);
+		ctrl->FF = coeff->aFF*ctrl->FF + coeff->kFF*(refSignal - ctrl->preRef);
 
-	/* Perform back calculation anti-windup scheme to avoid integral part windup */
-	if(ctrlParams->useIntegralAction) {
-		ctrlParams->I += CONTROL_PERIOD/ctrlParams->Tt*(controlSignal-tmpControlSignal);
-	}
+		/* Sum of P-I-D parts, feed-forward and offset part, multiplied with scaling factor */
+		tmpControlSignal = (coeff->kPRef*refSignal - coeff->kPState*ctrlState + ctrl->I + ctrl->D + ctrl->FF
+				+ coeff->ctrlSignalOffset)*coeff->ctrlSignalScaling;
+
+		/* Saturate controller output */
+		controlSignal = (tmpControlSignal < coeff->lowerSatLimit) ? coeff->lowerSatLimit : tmpControlSignal;
+		controlSignal = (controlSignal > coeff->upperSatLimit) ? coeff->upperSatLimit : controlSignal;
+
+		/* Back calculation anti-windup scheme to avoid integral part windup */
+		ctrl->I += coeff->kT*(controlSignal - tmpControlSignal);
 
-	/* Update previous control state and reference signal variables */
-	ctrlParams->preState = ctrlState;
-	ctrlParams->preRef = refSignal;
+		/* Update previous control state and reference signal variables */
+		ctrl->preState = ctrlState;
+		ctrl->preRef = refSignal;
 
-	return controlSignal;
+		pidOutputs[idx] = controlSignal;
+	}
+
+#ifdef PID_AUTOTUNE
+	/* The relay of a running autotune replaces the output of the tuned controller, whose integral part is held off */
+	relayIdx = GetAutotuneRelayController();
+	if (relayIdx >= firstIdx && relayIdx <= lastIdx) {
+		pidOutputs[relayIdx] = UpdateAutotuneRelay(pidRefs[relayIdx] - pidStates[relayIdx]);
+		pidControllers[relayIdx].I = 0.0;
+	}
+#endif
 }
 
 /**
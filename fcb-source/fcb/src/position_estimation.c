@@ -0,0 +1,404 @@
+/******************************************************************************
+ * @brief   GPS aided inertial position and velocity estimation in the NED frame.
+ *          The accelerometer, rotated to the inertial frame with the DCM, is
+ *          integrated into the nominal position and velocity, and an error
+ *          state Kalman filter tracks the covariance of their errors and of
+ *          the accelerometer bias. The barometer and GPS corrections are
+ *          injected into the nominal states, after which the errors are zero.
+ *
+ *          The axes are decoupled, three filters of position, velocity and
+ *          acceleration bias, so that every measurement is a scalar update of
+ *          a 3x3 covariance, without matrix inversions. The down axis is
+ *          corrected with the barometer and the GPS vertical velocity, the
+ *          GPS height is not used since its datum differs from the barometric
+ *          altitude. North and east are relative to the first usable GPS fix.
+ *
+ * @license
+ * Dragonfly FCB firmware to control the Dragonfly quadrotor UAV
+ * Copyright (C) 2016  ÅF Technology South: Dragonfly Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *****************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "position_estimation.h"
+#include "fcb_gps.h"
+
+#ifdef FCB_GPS
+
+#include "flight_control.h"
+#include "common.h"
+#include "fixed_format.h"
+#include "fcb_port.h"
+
+#include <math.h>
+#include <string.h>
+#include <stdio.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* States of an axis */
+enum {
+    INS_POSITION_IDX = 0,
+    INS_VELOCITY_IDX,
+    INS_ACC_BIAS_IDX,
+    INS_STATES_N
+};
+
+typedef struct InsAxisState {
+    bool isInitialized;
+    float32_t x[INS_STATES_N];              /* nominal position [m], velocity [m/s] and acceleration bias [m/s^2] */
+    float32_t p[INS_STATES_N][INS_STATES_N]; /* error covariance, symmetric */
+    uint16_t consecutiveRejects;
+} InsAxisStateType;
+
+/* Private define ------------------------------------------------------------*/
+#define INS_DEG_E7_TO_RAD   (PI / 180.0e7f)
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Updated by the flight control task only, in critical sections for the readers in the other tasks */
+static InsAxisStateType insAxes[POSITION_AXES_N];
+static PositionEstimationStatsType insStats;
+
+/* Origin of north and east, the first usable GPS fix */
+static bool isHomeSet = false;
+static int32_t homeLatitude;     /* [1e-7 deg] */
+static int32_t homeLongitude;    /* [1e-7 deg] */
+static float32_t homeCosLatitude;
+
+static uint32_t gpsSequence = 0;
+static uint32_t lastGpsFusionTick = 0; /* [ms] */
+
+/* Set by ResetPositionEstimation, handled in the flight control task */
+static volatile bool isResetRequested = false;
+
+/* Private function prototypes -----------------------------------------------*/
+static void HandleResetRequest(void);
+static void InitAxis(InsAxisStateType* pAxis, const uint8_t measuredState, const float32_t measurement,
+        const float32_t measurementNoise);
+static void CorrectAxis(InsAxisStateType* pAxis, const uint8_t measuredState, const float32_t measurement,
+        const float32_t variance);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Integrates the inertial acceleration into the nominal states and propagates their error covariances
+ * @param  inertialAcc : Specific force measured by the accelerometer in the inertial (NED) frame, e.g. -G_ACC
+ *         along down at rest [m/s^2]
+ * @param  dt : Time since the previous accelerometer sample [s]
+ * @retval None
+ */
+void PositionEstimationPredict(const float32_t inertialAcc[POSITION_AXES_N], const float32_t dt) {
+    float32_t const deltaT = (dt < INS_MAX_DT) ? dt : INS_MAX_DT;
+    float32_t const g1 = 0.5f*deltaT*deltaT; /* noise input of the acceleration to the position and velocity */
+    float32_t const g2 = deltaT;
+    float32_t const qAcc = INS_ACC_NOISE*INS_ACC_NOISE;
+    float32_t const qBias = INS_ACC_BIAS_NOISE*INS_ACC_BIAS_NOISE*deltaT;
+    float32_t fp[INS_STATES_N][INS_STATES_N];
+    float32_t acc;
+    uint8_t axis, i;
+
+    HandleResetRequest();
+
+    for (axis = 0; axis < POSITION_AXES_N; axis++) {
+        InsAxisStateType* pAxis = &insAxes[axis];
+        if (!pAxis->isInitialized) {
+            continue;
+        }
+
+        acc = inertialAcc[axis] - pAxis->x[INS_ACC_BIAS_IDX];
+        if (POSITION_DOWN_IDX == axis) {
+            acc += G_ACC;
+        }
+
+        /* P = F*P*F' + Q with F = [1 dt -dt^2/2; 0 1 -dt; 0 0 1] */
+        for (i = 0; i < INS_STATES_N; i++) {
+            fp[0][i] = pAxis->p[0][i] + g2*pAxis->p[1][i] - g1*pAxis->p[2][i];
+            fp[1][i] = pAxis->p[1][i] - g2*pAxis->p[2][i];
+            fp[2][i] = pAxis->p[2][i];
+        }
+
+        FCB_ENTER_CRITICAL();
+        pAxis->x[INS_POSITION_IDX] += deltaT*(pAxis->x[INS_VELOCITY_IDX] + 0.5f*deltaT*acc);
+        pAxis->x[INS_VELOCITY_IDX] += deltaT*acc;
+        for (i = 0; i < INS_STATES_N; i++) {
+            pAxis->p[i][0] = fp[i][0] + g2*fp[i][1] - g1*fp[i][2];
+            pAxis->p[i][1] = fp[i][1] - g2*fp[i][2];
+            pAxis->p[i][2] = fp[i][2];
+        }
+
+        pAxis->p[0][0] += qAcc*g1*g1;
+        pAxis->p[0][1] += qAcc*g1*g2;
+        pAxis->p[1][0] += qAcc*g1*g2;
+        pAxis->p[1][1] += qAcc*g2*g2;
+        pAxis->p[2][2] += qBias;
+        FCB_EXIT_CRITICAL();
+    }
+}
+
+/*
+ * @brief  Corrects the down axis with the barometric altitude, the first sample initialises it
+ * @param  altitude : Barometric altitude [m]
+ * @retval None
+ */
+void PositionEstimationCorrectBaro(const float32_t altitude) {
+    InsAxisStateType* pAxis = &insAxes[POSITION_DOWN_IDX];
+
+    HandleResetRequest();
+
+    if (!pAxis->isInitialized) {
+        InitAxis(pAxis, INS_POSITION_IDX, -altitude, INS_BARO_NOISE);
+        return;
+    }
+
+    CorrectAxis(pAxis, INS_POSITION_IDX, -altitude, INS_BARO_NOISE*INS_BARO_NOISE);
+    insStats.baroFusions++;
+}
+
+/*
+ * @brief  Fuses the latest GPS solution if it is new and usable, the first one sets the home position and
+ *         initialises north and east
+ * @param  None
+ * @retval None
+ */
+void PositionEstimationCorrectGps(void) {
+    FcbGpsSolutionType solution;
+    float32_t positionVariance, velocityVariance, north, east;
+    uint8_t axis;
+
+    if (!GetNewGpsSolution(&solution, gpsSequence)) {
+        return;
+    }
+    gpsSequence = solution.sequence;
+
+    HandleResetRequest();
+
+    if (!IsGpsSolutionUsable(&solution)) {
+        insStats.gpsUnusable++;
+        return;
+    }
+
+    if (!isHomeSet) {
+        homeLatitude = solution.latitude;
+        homeLongitude = solution.longitude;
+        homeCosLatitude = cosf(INS_DEG_E7_TO_RAD*(float32_t) solution.latitude);
+        isHomeSet = true;
+    }
+
+    /* The differences in integer 1e-7 deg keep the resolution of the solution, about 1 cm */
+    north = INS_EARTH_RADIUS*INS_DEG_E7_TO_RAD*(float32_t) (solution.latitude - homeLatitude);
+    east = INS_EARTH_RADIUS*INS_DEG_E7_TO_RAD*homeCosLatitude*(float32_t) (solution.longitude - homeLongitude);
+
+    positionVariance = fmaxf(solution.horizontalAccuracy, INS_GPS_MIN_POSITION_NOISE);
+    positionVariance *= positionVariance;
+    velocityVariance = fmaxf(solution.speedAccuracy, INS_GPS_MIN_VELOCITY_NOISE);
+    velocityVariance *= velocityVariance;
+
+    if (!insAxes[POSITION_NORTH_IDX].isInitialized) {
+        InitAxis(&insAxes[POSITION_NORTH_IDX], INS_POSITION_IDX, north, sqrtf(positionVariance));
+        InitAxis(&insAxes[POSITION_EAST_IDX], INS_POSITION_IDX, east, sqrtf(positionVariance));
+        insAxes[POSITION_NORTH_IDX].x[INS_VELOCITY_IDX] = solution.velocityNed[POSITION_NORTH_IDX];
+        insAxes[POSITION_EAST_IDX].x[INS_VELOCITY_IDX] = solution.velocityNed[POSITION_EAST_IDX];
+    } else {
+        CorrectAxis(&insAxes[POSITION_NORTH_IDX], INS_POSITION_IDX, north, positionVariance);
+        CorrectAxis(&insAxes[POSITION_EAST_IDX], INS_POSITION_IDX, east, positionVariance);
+    }
+
+    for (axis = 0; axis < POSITION_AXES_N; axis++) {
+        if (insAxes[axis].isInitialized) {
+            CorrectAxis(&insAxes[axis], INS_VELOCITY_IDX, solution.velocityNed[axis], velocityVariance);
+        }
+    }
+
+    insStats.gpsFusions++;
+    lastGpsFusionTick = HAL_GetTick();
+}
+
+/*
+ * @brief  Requests the states and the home position to be set from the next measurements, e.g. before a flight
+ *         from another place
+ * @param  None
+ * @retval None
+ */
+void ResetPositionEstimation(void) {
+    isResetRequested = true;
+}
+
+void GetNedPosition(float32_t dstPosition[POSITION_AXES_N]) {
+    uint8_t axis;
+
+    FCB_ENTER_CRITICAL();
+    for (axis = 0; axis < POSITION_AXES_N; axis++) {
+        dstPosition[axis] = insAxes[axis].x[INS_POSITION_IDX];
+    }
+    FCB_EXIT_CRITICAL();
+}
+
+void GetNedVelocity(float32_t dstVelocity[POSITION_AXES_N]) {
+    uint8_t axis;
+
+    FCB_ENTER_CRITICAL();
+    for (axis = 0; axis < POSITION_AXES_N; axis++) {
+        dstVelocity[axis] = insAxes[axis].x[INS_VELOCITY_IDX];
+    }
+    FCB_EXIT_CRITICAL();
+}
+
+/*
+ * @brief  Checks that the horizontal position is tracked, i.e. a GPS solution was fused within GPS_TIMEOUT
+ * @param  None
+ * @retval true if valid
+ */
+bool IsPositionValid(void) {
+    bool isValid;
+
+    FCB_ENTER_CRITICAL();
+    isValid = insAxes[POSITION_NORTH_IDX].isInitialized && insStats.gpsFusions > 0
+            && (HAL_GetTick() - lastGpsFusionTick) <= GPS_TIMEOUT;
+    FCB_EXIT_CRITICAL();
+
+    return isValid;
+}
+
+void GetPositionEstimationStats(PositionEstimationStatsType* dstStats) {
+    FCB_ENTER_CRITICAL();
+    *dstStats = insStats;
+    FCB_EXIT_CRITICAL();
+}
+
+size_t PrintPositionStates(char* dst, const size_t dstSize) {
+    InsAxisStateType axes[POSITION_AXES_N];
+    PositionEstimationStatsType stats;
+    char values[INS_STATES_N + 1][3][16];
+    size_t length;
+    uint8_t axis, state;
+
+    FCB_ENTER_CRITICAL();
+    memcpy(axes, insAxes, sizeof(axes));
+    stats = insStats;
+    FCB_EXIT_CRITICAL();
+
+    for (axis = 0; axis < POSITION_AXES_N; axis++) {
+        for (state = 0; state < INS_STATES_N; state++) {
+            FormatFixed(values[state][axis], sizeof(values[state][axis]), axes[axis].x[state], 2);
+        }
+        FormatFixed(values[INS_STATES_N][axis], sizeof(values[INS_STATES_N][axis]),
+                sqrtf(axes[axis].p[INS_POSITION_IDX][INS_POSITION_IDX]), 2);
+    }
+
+    length = (size_t) snprintf(dst, dstSize,
+            "\nPosition (NED) %s\nposition: %s, %s, %s [m] (std %s, %s, %s)\nvelocity: %s, %s, %s [m/s]\n"
+            "accBias: %s, %s, %s [m/s^2]\ngpsFusions:%u, gpsUnusable:%u, baroFusions:%u, rejected:%u, resets:%u\n",
+            IsPositionValid() ? "valid" : "NOT VALID", values[0][0], values[0][1], values[0][2], values[3][0],
+            values[3][1], values[3][2], values[1][0], values[1][1], values[1][2], values[2][0], values[2][1],
+            values[2][2], (unsigned int) stats.gpsFusions, (unsigned int) stats.gpsUnusable,
+            (unsigned int) stats.baroFusions, (unsigned int) stats.innovationRejected, (unsigned int) stats.resets);
+
+    return length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+static void HandleResetRequest(void) {
+    if (!isResetRequested) {
+        return;
+    }
+
+    FCB_ENTER_CRITICAL();
+    memset(insAxes, 0, sizeof(insAxes));
+    memset(&insStats, 0, sizeof(insStats));
+    isHomeSet = false;
+    isResetRequested = false;
+    FCB_EXIT_CRITICAL();
+}
+
+/*
+ * Sets one state of an axis to a measurement, the others to zero, and the error covariance to the initial noise
+ */
+static void InitAxis(InsAxisStateType* pAxis, const uint8_t measuredState, const float32_t measurement,
+        const float32_t measurementNoise) {
+    float32_t const initNoise[INS_STATES_N] = { INS_INIT_POSITION_NOISE, INS_INIT_VELOCITY_NOISE,
+            INS_INIT_ACC_BIAS_NOISE };
+    float32_t const measuredNoise = fminf(measurementNoise, initNoise[measuredState]);
+    uint8_t state;
+
+    FCB_ENTER_CRITICAL();
+    memset(pAxis, 0, sizeof(InsAxisStateType));
+    for (state = 0; state < INS_STATES_N; state++) {
+        pAxis->p[state][state] = initNoise[state]*initNoise[state];
+    }
+    pAxis->x[measuredState] = measurement;
+    pAxis->p[measuredState][measuredState] = measuredNoise*measuredNoise;
+    pAxis->isInitialized = true;
+    FCB_EXIT_CRITICAL();
+}
+
+/*
+ * Scalar Kalman update of an axis with a measurement of one of its states, gated on the innovation
+ */
+static void CorrectAxis(InsAxisStateType* pAxis, const uint8_t measuredState, const float32_t measurement,
+        const float32_t variance) {
+    float32_t const innovation = measurement - pAxis->x[measuredState];
+    float32_t const innovationVariance = pAxis->p[measuredState][measuredState] + variance;
+    float32_t gain[INS_STATES_N], measuredRow[INS_STATES_N];
+    uint8_t i, j;
+
+    if (innovation*innovation > INS_INNOVATION_GATE*INS_INNOVATION_GATE*innovationVariance) {
+        insStats.innovationRejected++;
+        if (++pAxis->consecutiveRejects >= INS_MAX_CONSECUTIVE_REJECTS) {
+            /* The states have diverged, e.g. from a GPS outage or a barometer step, and would not recover */
+            InitAxis(pAxis, measuredState, measurement, sqrtf(variance));
+            insStats.resets++;
+        }
+        return;
+    }
+    pAxis->consecutiveRejects = 0;
+
+    for (i = 0; i < INS_STATES_N; i++) {
+        gain[i] = pAxis->p[i][measuredState]/innovationVariance;
+        measuredRow[i] = pAxis->p[measuredState][i];
+    }
+
+    /* Inject the estimated errors into the nominal states, P = (I - K*H)*P */
+    FCB_ENTER_CRITICAL();
+    for (i = 0; i < INS_STATES_N; i++) {
+        pAxis->x[i] += gain[i]*innovation;
+    }
+    for (i = 0; i < INS_STATES_N; i++) {
+        for (j = i; j < INS_STATES_N; j++) {
+            pAxis->p[i][j] -= gain[i]*measuredRow[j];
+        }
+    }
+    for (i = 1; i < INS_STATES_N; i++) {
+        for (j = 0; j < i; j++) {
+            pAxis->p[i][j] = pAxis->p[j][i];
+        }
+    }
+    FCB_EXIT_CRITICAL();
+}
+
+#endif /* FCB_GPS */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
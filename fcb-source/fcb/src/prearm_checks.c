@@ -0,0 +1,311 @@
+/******************************************************************************
+ * @file    prearm_checks.c
+ * @brief   Pre-arm checklist, see prearm_checks.h
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "prearm_checks.h"
+
+#include "rate_groups.h"
+#include "state_estimation.h"
+#include "receiver.h"
+#include "fcb_sensor_watchdog.h"
+#include "fcb_sensor_self_test.h"
+#include "fcb_accelerometer_magnetometer.h"
+#include "fcb_battery.h"
+#include "flash.h"
+#include "task_watchdog.h"
+#include "cpu_headroom.h"
+#include "fcb_port.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <math.h>
+#include <stdio.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Returns true if the check passes */
+typedef bool (*PreArmCheckFunc)(void);
+
+typedef struct {
+    const char* name;
+    PreArmCheckFunc check;
+} PreArmCheck_TypeDef;
+
+/* Private function prototypes -----------------------------------------------*/
+static void EvaluatePreArmChecks(void* argument);
+static bool CheckSensors(void);
+static bool CheckCalibration(void);
+static bool CheckEstimator(void);
+static bool CheckLevel(void);
+static bool CheckReceiver(void);
+static bool CheckBattery(void);
+static bool CheckFlash(void);
+static bool CheckReset(void);
+static bool CheckCpu(void);
+static bool IsCalibrationStored(void);
+static uint32_t GetTimestampMs(void);
+
+/* Private variables ---------------------------------------------------------*/
+
+/* In PreArmCheckType order */
+static const PreArmCheck_TypeDef preArmChecks[PREARM_CHECK_NBR] = {
+    { "sensors healthy", CheckSensors },
+    { "sensors calibrated", CheckCalibration },
+    { "estimator converged", CheckEstimator },
+    { "level", CheckLevel },
+    { "receiver calibrated and active", CheckReceiver },
+    { "battery not low", CheckBattery },
+    { "no pending flash write", CheckFlash },
+    { "last reset clean", CheckReset },
+    { "CPU headroom", CheckCpu }
+};
+
+/* Written by the rate group task, read by the other tasks with the scheduler suspended. The flight control task reads
+ * the failures alone, a single word. */
+static PreArmStatusType preArmStatus = { PREARM_CHECK_ALL, 0, 0 };
+
+static RateGroupJobId_TypeDef preArmJobId = RATE_GROUP_INVALID_ID;
+
+/* If the calibration records are in the settings store, read at the first evaluation and again only after a
+ * calibration was written, see GetFlashCalibrationWriteCount(). Only used by the rate group task. */
+static bool isCalibrationStored = false;
+static bool isCalibrationStoreRead = false;
+static uint32_t calibrationWriteCount = 0;
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Registers the evaluation of the checks with its rate group, the checks fail until it has run once
+ * @param  None.
+ * @retval FCB_OK if registered, else FCB_ERR
+ */
+FcbRetValType InitPreArmChecks(void) {
+    return RateGroupRegister("PREARM", EvaluatePreArmChecks, NULL, RATE_GROUP_20HZ, PREARM_CHECKS_PHASE,
+            &preArmJobId);
+}
+
+/*
+ * @brief  Gets the checks that failed on the latest evaluation
+ * @param  None.
+ * @retval PREARM_CHECK_BIT() mask, 0 if all passed
+ */
+uint32_t GetPreArmFailures(void) {
+    return preArmStatus.failures;
+}
+
+/*
+ * @brief  Gets the failures, evaluation count and time of the latest change as one consistent copy
+ * @param  dstStatus : Status out
+ * @retval None.
+ */
+void GetPreArmStatus(PreArmStatusType* dstStatus) {
+    FCB_SUSPEND_SCHEDULER();
+    *dstStatus = preArmStatus;
+    FCB_RESUME_SCHEDULER();
+}
+
+/*
+ * @brief  Gets the description of a check
+ * @param  check : Pre-arm check
+ * @retval Description, or "?" for an invalid check
+ */
+const char* GetPreArmCheckName(const PreArmCheckType check) {
+    if (check >= PREARM_CHECK_NBR) {
+        return "?";
+    }
+
+    return preArmChecks[check].name;
+}
+
+/*
+ * @brief  Prints the status and the result of each check, truncated to the buffer
+ * @param  dst : Destination buffer
+ * @param  dstSize : Size of the destination buffer
+ * @retval Length of the string written, without the terminator
+ */
+size_t PrintPreArmChecks(char* dst, const size_t dstSize) {
+    PreArmStatusType status;
+    size_t length;
+    uint8_t check;
+
+    GetPreArmStatus(&status);
+
+    length = (size_t) snprintf(dst, dstSize, "\nPre-arm checks %s, %lu evaluations, changed at %lu ms\n",
+            (0 == status.failures) ? "passed" : "failed", status.evaluations, status.timestamp);
+
+    for (check = 0; check < PREARM_CHECK_NBR && length < dstSize; check++) {
+        length += (size_t) snprintf(dst + length, dstSize - length, "%-32s %s\n", preArmChecks[check].name,
+                (status.failures & PREARM_CHECK_BIT(check)) ? "FAIL" : "ok");
+    }
+
+    return (length < dstSize) ? length : dstSize - 1;
+}
+
+/*
+ * @brief  Encodes the status as the PREARM_STATUS_MSG_ENUM message, see prearm_checks.h
+ * @param  stream : Output stream, at least PREARM_STATUS_MSG_MAX_SIZE bytes
+ * @retval true if encoded, false if the stream is full
+ */
+bool EncodePreArmStatus(pb_ostream_t* stream) {
+    PreArmStatusType status;
+
+    GetPreArmStatus(&status);
+
+    return pb_encode_tag(stream, PB_WT_VARINT, 1) && pb_encode_varint(stream, status.failures)
+            && pb_encode_tag(stream, PB_WT_VARINT, 2) && pb_encode_varint(stream, status.evaluations)
+            && pb_encode_tag(stream, PB_WT_VARINT, 3) && pb_encode_varint(stream, status.timestamp);
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Evaluates all checks, rate group job
+ * @param  argument : Unused
+ * @retval None.
+ */
+static void EvaluatePreArmChecks(void* argument) {
+    uint32_t failures = 0;
+    uint8_t check;
+
+    (void) argument;
+
+    for (check = 0; check < PREARM_CHECK_NBR; check++) {
+        if (!preArmChecks[check].check()) {
+            failures |= PREARM_CHECK_BIT(check);
+        }
+    }
+
+    FCB_SUSPEND_SCHEDULER();
+    if (failures != preArmStatus.failures) {
+        preArmStatus.failures = failures;
+        preArmStatus.timestamp = GetTimestampMs();
+    }
+    preArmStatus.evaluations++;
+    FCB_RESUME_SCHEDULER();
+}
+
+/*
+ * @brief  Checks that the gyroscope, accelerometer and magnetometer are healthy and passed their self-test
+ * @param  None.
+ * @retval true if the check passes, else false
+ */
+static bool CheckSensors(void) {
+    return IsSensorHealthy(GYRO_IDX) && IsSensorHealthy(ACC_IDX) && IsSensorHealthy(MAG_IDX)
+            && IsSensorSelfTestPassed();
+}
+
+/*
+ * @brief  Checks that the accelerometer and magnetometer calibrations are in the settings store and that the sensors
+ *         are not being calibrated. The store is only read again after a calibration was written.
+ * @param  None.
+ * @retval true if the check passes, else false
+ */
+static bool CheckCalibration(void) {
+    uint32_t writeCount = GetFlashCalibrationWriteCount();
+
+    /* A write after the count was taken changes it again, and is read on the next evaluation */
+    if (!isCalibrationStoreRead || writeCount != calibrationWriteCount) {
+        calibrationWriteCount = writeCount;
+        isCalibrationStored = IsCalibrationStored();
+        isCalibrationStoreRead = true;
+    }
+
+    return isCalibrationStored && IsAccMagCalibrated();
+}
+
+/*
+ * @brief  Checks that the state estimation has converged
+ * @param  None.
+ * @retval true if the check passes, else false
+ */
+static bool CheckEstimator(void) {
+    return IsStateEstimationConverged();
+}
+
+/*
+ * @brief  Checks that roll and pitch are within PREARM_MAX_TILT_ANGLE
+ * @param  None.
+ * @retval true if the check passes, else false
+ */
+static bool CheckLevel(void) {
+    return fabsf(GetRollAngle()) <= PREARM_MAX_TILT_ANGLE && fabsf(GetPitchAngle()) <= PREARM_MAX_TILT_ANGLE;
+}
+
+/*
+ * @brief  Checks that the receiver is calibrated, active and not in failsafe
+ * @param  None.
+ * @retval true if the check passes, else false
+ */
+static bool CheckReceiver(void) {
+    return IsReceiverCalibrated() && RECEIVER_OK == IsReceiverActive() && !IsReceiverFailsafe();
+}
+
+/*
+ * @brief  Checks that the battery is neither low nor critical, always passes without FCB_BATTERY_MONITOR
+ * @param  None.
+ * @retval true if the check passes, else false
+ */
+static bool CheckBattery(void) {
+#ifdef FCB_BATTERY_MONITOR
+    /* Not connected is not measured, e.g. on USB power at the bench */
+    return BATTERY_LOW != GetBatteryStatus() && BATTERY_CRITICAL != GetBatteryStatus();
+#else
+    return true;
+#endif
+}
+
+/*
+ * @brief  Checks that no settings are waiting for the flash writer
+ * @param  None.
+ * @retval true if the check passes, else false
+ */
+static bool CheckFlash(void) {
+    return !IsFlashWritePending();
+}
+
+/*
+ * @brief  Checks that the last reset was not by the watchdog
+ * @param  None.
+ * @retval true if the check passes, else false
+ */
+static bool CheckReset(void) {
+    return !IsWatchdogResetPending();
+}
+
+/*
+ * @brief  Checks that the CPU headroom is not low
+ * @param  None.
+ * @retval true if the check passes, else false
+ */
+static bool CheckCpu(void) {
+    return !IsCpuHeadroomLow();
+}
+
+/*
+ * @brief  Checks that the accelerometer and magnetometer calibration records are in the settings store, where they
+ *         have passed the CRC check
+ * @param  None.
+ * @retval true if they are stored, else false
+ */
+static bool IsCalibrationStored(void) {
+    float32_t calibrationValues[MAG_CALIB_IDX_MAX];
+
+    if (FLASH_OK != ReadAccCalibrationValuesFromFlash(calibrationValues)) {
+        return false;
+    }
+
+    return FLASH_OK == ReadMagEllipsoidCalibrationFromFlash(calibrationValues)
+            || FLASH_OK == ReadMagCalibrationValuesFromFlash(calibrationValues);
+}
+
+/*
+ * @brief  Gets the time since startup
+ * @param  None.
+ * @retval Time [ms]
+ */
+static uint32_t GetTimestampMs(void) {
+    return (uint32_t) xTaskGetTickCount() * portTICK_RATE_MS;
+}
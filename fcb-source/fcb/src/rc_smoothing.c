@@ -0,0 +1,188 @@
+/******************************************************************************
+ * @file    rc_smoothing.c
+ * @brief   PT2 low-pass filter of the stick references with a cutoff from
+ *          the measured receiver frame rate, see rc_smoothing.h
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "rc_smoothing.h"
+
+#include "flash.h"
+#include "common.h"
+
+#include <string.h>
+
+/* Private define ------------------------------------------------------------*/
+#define RC_SMOOTHING_FRAME_RATE_WEIGHT  0.05f   // Weight of a new frame period in the measured one
+#define RC_SMOOTHING_MAX_FRAME_PERIOD   100000  // [us] Longer frame gaps are not measured
+
+/* Private variables ---------------------------------------------------------*/
+
+/* The settings, written by the parameter table with the scheduler suspended */
+static volatile uint16_t isRcSmoothingEnabled = 1;
+static volatile float32_t rcSmoothingCutoffSetting = 0.0f;
+
+/* Measured frame period, the time constant of each PT1 stage and the stage states, only used by the flight control
+ * task besides the apply function of the parameter table */
+static float32_t framePeriod = 1.0f / RC_SMOOTHING_DEFAULT_FRAME_RATE; // [s]
+static uint32_t previousFrameTimestamp = 0; // [core clock cycles]
+static float32_t timeConstant; // [s]
+static float32_t stageStates[2][STICK_AXIS_NBR];
+
+static const Param_TypeDef rcSmoothingParamTable[] = {
+	{ "RC_SMOOTH", PARAM_TYPE_UINT16, &isRcSmoothingEnabled, 0.0, 1.0 },
+	{ "RC_SMOOTH_HZ", PARAM_TYPE_FLOAT, &rcSmoothingCutoffSetting, 0.0, RC_SMOOTHING_MAX_CUTOFF }
+};
+
+/* Private function prototypes -----------------------------------------------*/
+static float32_t GetRcSmoothingCutoff(void);
+static void UpdateRcSmoothingTimeConstant(void);
+static FcbRetValType SaveRcSmoothingSettings(void);
+
+static const ParamGroup_TypeDef rcSmoothingParamGroup = { rcSmoothingParamTable,
+		sizeof(rcSmoothingParamTable) / sizeof(rcSmoothingParamTable[0]), UpdateRcSmoothingTimeConstant,
+		SaveRcSmoothingSettings };
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Loads the stored settings, or keeps the defaults if there are none or they are invalid
+ * @param  None.
+ * @retval None.
+ */
+void InitRcSmoothing(void) {
+	RcSmoothingSettingsType settings;
+
+	if (FLASH_OK == ReadRcSmoothingSettingsFromFlash(&settings) && settings.isEnabled <= 1
+			&& settings.cutoffHz >= 0.0f && settings.cutoffHz <= RC_SMOOTHING_MAX_CUTOFF) {
+		isRcSmoothingEnabled = settings.isEnabled;
+		rcSmoothingCutoffSetting = settings.cutoffHz;
+	}
+
+	UpdateRcSmoothingTimeConstant();
+	memset(stageStates, 0, sizeof(stageStates));
+}
+
+/*
+ * @brief  Averages the period between consecutive frames, a gap of missed frames is not measured
+ * @param  frameTimestamp : Time the frame was completed [core clock cycles]
+ * @param  isNextFrame : true if no frame was missed since the previous call
+ * @retval None.
+ */
+void RcSmoothingNewFrame(const uint32_t frameTimestamp, const bool isNextFrame) {
+	uint32_t period = TimestampToMicroseconds(frameTimestamp - previousFrameTimestamp);
+
+	previousFrameTimestamp = frameTimestamp;
+	if (!isNextFrame || 0 == period || period > RC_SMOOTHING_MAX_FRAME_PERIOD) {
+		return;
+	}
+
+	framePeriod += RC_SMOOTHING_FRAME_RATE_WEIGHT * (period * 1e-6f - framePeriod);
+	if (0.0f == rcSmoothingCutoffSetting) {
+		UpdateRcSmoothingTimeConstant();
+	}
+}
+
+/*
+ * @brief  Runs the two PT1 stages of each axis, k = T/(T + tau)
+ * @param  refs : References indexed by StickAxisType, filtered in place
+ * @param  samplePeriod : Time since the previous call [s]
+ * @retval None.
+ */
+RAMFUNC void RcSmoothingApply(float32_t refs[STICK_AXIS_NBR], const float32_t samplePeriod) {
+	float32_t k;
+	uint8_t axis;
+
+	if (!isRcSmoothingEnabled) {
+		return;
+	}
+
+	k = samplePeriod / (samplePeriod + timeConstant);
+	for (axis = 0; axis < STICK_AXIS_NBR; axis++) {
+		stageStates[0][axis] += k * (refs[axis] - stageStates[0][axis]);
+		stageStates[1][axis] += k * (stageStates[0][axis] - stageStates[1][axis]);
+		refs[axis] = stageStates[1][axis];
+	}
+}
+
+/*
+ * @brief  Sets both stages of each axis to the references
+ * @param  refs : References indexed by StickAxisType
+ * @retval None.
+ */
+void RcSmoothingReset(const float32_t refs[STICK_AXIS_NBR]) {
+	memcpy(stageStates[0], refs, sizeof(stageStates[0]));
+	memcpy(stageStates[1], refs, sizeof(stageStates[1]));
+}
+
+/*
+ * @brief  Gets the frame rate, the cutoff and the latency the filter adds
+ * @param  status : Status out
+ * @retval None.
+ */
+void GetRcSmoothingStatus(RcSmoothingStatusType* status) {
+	status->isEnabled = (0 != isRcSmoothingEnabled);
+	status->frameRateHz = 1.0f / framePeriod;
+	status->cutoffHz = GetRcSmoothingCutoff();
+	status->latencyMs = status->isEnabled ? 2.0f * timeConstant * 1000.0f : 0.0f;
+}
+
+const ParamGroup_TypeDef* GetRcSmoothingParamGroup(void) {
+	return &rcSmoothingParamGroup;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Gets the fixed cutoff, or the one of the measured frame rate, within the cutoff limits
+ * @param  None.
+ * @retval The cutoff [Hz]
+ */
+static float32_t GetRcSmoothingCutoff(void) {
+	float32_t cutoff = rcSmoothingCutoffSetting;
+
+	if (0.0f == cutoff) {
+		cutoff = RC_SMOOTHING_AUTO_CUTOFF_RATIO / framePeriod;
+	}
+
+	if (cutoff < RC_SMOOTHING_MIN_CUTOFF) {
+		cutoff = RC_SMOOTHING_MIN_CUTOFF;
+	} else if (cutoff > RC_SMOOTHING_MAX_CUTOFF) {
+		cutoff = RC_SMOOTHING_MAX_CUTOFF;
+	}
+
+	return cutoff;
+}
+
+/*
+ * @brief  Sets the PT1 time constant of the cutoff. Also the apply function of the parameter group, called with the
+ *         scheduler suspended.
+ * @param  None.
+ * @retval None.
+ */
+static void UpdateRcSmoothingTimeConstant(void) {
+	timeConstant = 1.0f / (2.0f * PI * GetRcSmoothingCutoff());
+}
+
+/*
+ * @brief  Saves the RC smoothing parameters to flash
+ * @param  None.
+ * @retval FCB_OK if saved, else FCB_ERR
+ */
+static FcbRetValType SaveRcSmoothingSettings(void) {
+	RcSmoothingSettingsType settings;
+
+	settings.isEnabled = isRcSmoothingEnabled;
+	settings.cutoffHz = rcSmoothingCutoffSetting;
+
+	return FLASH_OK == WriteRcSmoothingSettingsToFlash(&settings) ? FCB_OK : FCB_ERR;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
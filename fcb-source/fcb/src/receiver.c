@@ -15,6 +15,39 @@
  *          ~1 ms when the transmitter control stick is held in one direction and
  *          ~2 ms when it is held in the opposite direction.
  *
+ *          _SERIAL RECEIVERS_
+ *          Instead of the separate PWM channels, RECEIVER_INPUT_PROTOCOL can
+ *          select a PPM-sum, SBUS or DSM receiver, see receiver_serial.c. The
+ *          channels of each decoded frame are converted to the same timer
+ *          tick pulse widths as the PWM channels and passed to
+ *          UpdateReceiverChannelsFromFrame(), so the calibration and the
+ *          channel getters work the same regardless of the protocol.
+ *
+ *          _DEFERRED PWM DECODING_
+ *          With RECEIVER_PWM_DEFERRED_DECODING defined, the timers capture
+ *          both pulse edges, so the IC polarity is never toggled. The capture
+ *          interrupt only stores the edge timestamp, and ReceiverPWMDecodeTask
+ *          decodes the pulses of all channels a few times per RC frame.
+ *
+ *          _CHANNEL MAP AND MODE RANGES_
+ *          A channel map in flash assigns an input to each receiver function
+ *          and can reverse it, so that transmitters with another channel order
+ *          work without recompiling. With PWM the input is one of the six
+ *          capture pins, with PPM-sum, SBUS and DSM a channel of the frame.
+ *          The mode range table then selects the flight mode of the snapshot
+ *          from the mapped channels, e.g. the raw mode while aux1 is within
+ *          [80, 100] % of its range. It is evaluated once per RC frame, when
+ *          the snapshot is published. The defaults are the former fixed gear
+ *          and aux1 switch positions.
+ *
+ *          _FAILSAFE_
+ *          Every RC frame with all channels restarts a watchdog timer. If
+ *          it elapses, RECEIVER_FAILSAFE_TIMEOUT after the latest complete
+ *          frame, the receiver is inactive and the flight control is notified
+ *          at once, instead of after the ~1 s channel inactivity timeout.
+ *          GetReceiverLinkStats() holds the failsafe and per channel dropout
+ *          counters for link quality telemetry.
+ *
  *          _PERFORMING A CALIBRATION_
  *          To perform a calibration of the receiver channels, the function
  *          StartReceiverCalibration() must be called. The receiver channels
@@ -55,13 +88,18 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "receiver.h"
+#include "receiver_serial.h"
 
 #include "flash.h"
+#include "flight_control.h"
 #include "common.h"
 #include "fcb_error.h"
+#include "task_watchdog.h"
+#include "rate_groups.h"
 #include "dragonfly_fcb.pb.h"
 #include "pb_encode.h"
 #include "usbd_cdc_if.h"
+#include "telemetry.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -100,28 +138,56 @@ typedef struct {
 	uint16_t PreviousRisingCountTimerPeriodCount;
 	uint16_t PulseTimerCount;
 	ReceiverErrorStatus IsActive;
+	uint8_t SnapshotFlag; // Marks the channel as updated for the pending receiver snapshot
+	uint32_t PulseCount; // Link quality counters, see Receiver_ChannelLinkStats_TypeDef
+	uint32_t DropoutCount;
+	uint32_t LastPulseTimestamp; // [core clock cycles]
+	uint32_t PulsePeriod; // Filtered time between pulses [core clock cycles]
+#ifdef RECEIVER_PWM_DEFERRED_DECODING
+	uint32_t EdgeCounts[RECEIVER_PWM_EDGE_BUFFER_SIZE]; // Written by the capture interrupt only
+	uint8_t EdgeHead; // Written by the capture interrupt only
+	uint8_t EdgeTail; // Written by the decode task only
+	uint32_t PreviousEdgeCount;
+	uint32_t DecodedRisingCount;
+	bool HasPreviousEdge;
+	bool HasDecodedRising;
+	uint32_t LastPulseTime; // [us] Low word of GetMicroseconds()
+#endif
 } Receiver_IC_Values_TypeDef;
 
 typedef struct {
 	uint32_t midSamplesPulseSum;
 	uint16_t midPulseSamplesCount;
 	uint16_t channelCalibrationPulseSamples;
-	uint16_t maxSamplesBuffer[RECEIVER_CALIBRATION_SAMPLES_BUFFER_SIZE];
-	uint16_t tmpMaxIndex;
-	uint16_t tmpMaxBufferMinValue;
-	uint16_t minSamplesBuffer[RECEIVER_CALIBRATION_SAMPLES_BUFFER_SIZE];
-	uint16_t tmpMinIndex;
-	uint16_t tmpMinBufferMaxValue;
-	bool maxBufferUpdated;
-	bool minBufferUpdated;
+	uint32_t maxPulseEstimate; // Scaled by 2^RECEIVER_CALIBRATION_ESTIMATE_SHIFT
+	uint32_t minPulseEstimate; // Scaled by 2^RECEIVER_CALIBRATION_ESTIMATE_SHIFT
 } Receiver_ChannelCalibrationSampling_TypeDef;
 
 /* Private define ------------------------------------------------------------*/
-#define RECEIVER_PRINT_SAMPLING_TASK_PRIO				1
+#define RECEIVER_PWM_DECODE_TASK_PRIO					configMAX_PRIORITIES-2 // Below flight control only
 #define RECEIVER_PRINT_MINIMUM_SAMPLING_TIME			22	// Since the receiver pulses have this update frequency
 #define RECEIVER_SAMPLING_MAX_STRING_SIZE				160
-#define RECEIVER_SWITCH_ON_MIN_VAL						INT16_MAX*8/10
-#define RECEIVER_SWITCH_OFF_MAX_VAL						INT16_MIN*8/10
+#define RECEIVER_SWITCH_ON_MIN_PERCENT					80	// Default mode ranges of the gear and aux1 switches
+#define RECEIVER_SWITCH_OFF_MAX_PERCENT					-80
+#define RECEIVER_SWITCH_MID_MAX_ABS_PERCENT				20
+
+#define RECEIVER_SNAPSHOT_THROTTLE_FLAG					(1 << RECEIVER_SNAPSHOT_THROTTLE)
+#define RECEIVER_SNAPSHOT_AILERON_FLAG					(1 << RECEIVER_SNAPSHOT_AILERON)
+#define RECEIVER_SNAPSHOT_ELEVATOR_FLAG					(1 << RECEIVER_SNAPSHOT_ELEVATOR)
+#define RECEIVER_SNAPSHOT_RUDDER_FLAG					(1 << RECEIVER_SNAPSHOT_RUDDER)
+#define RECEIVER_SNAPSHOT_GEAR_FLAG						(1 << RECEIVER_SNAPSHOT_GEAR)
+#define RECEIVER_SNAPSHOT_AUX1_FLAG						(1 << RECEIVER_SNAPSHOT_AUX1)
+#define RECEIVER_SNAPSHOT_ALL_FLAGS						((1 << RECEIVER_SNAPSHOT_CHANNELS_NBR) - 1)
+
+#define RECEIVER_FAILSAFE_TIMEOUT_CYCLES				(SystemCoreClock/1000*RECEIVER_FAILSAFE_TIMEOUT)
+#define RECEIVER_LINK_PERIOD_FILTER_SHIFT				3	// Pulse periods are filtered with a 1/8 gain
+
+#ifdef RECEIVER_PWM_DEFERRED_DECODING
+#define RECEIVER_PWM_IC_POLARITY						TIM_ICPOLARITY_BOTHEDGE
+#define RECEIVER_PWM_AUX_COUNTER_CLOCK					(RECEIVER_TIM_COUNTER_CLOCK/RECEIVER_PWM_AUX_TICK_MULTIPLIER)
+#else
+#define RECEIVER_PWM_IC_POLARITY						TIM_ICPOLARITY_RISING
+#endif
 
 /* Private macro -------------------------------------------------------------*/
 #define IS_RECEIVER_PULSE_VALID(PULSE_TIM_CNT, CURR_PERIOD_CNT, PRE_PERIOD_CNT)	(((PULSE_TIM_CNT) <= RECEIVER_MAX_VALID_IC_PULSE_COUNT) \
@@ -153,15 +219,34 @@ static TIM_IC_InitTypeDef Aux1ChannelICConfig;
 static Receiver_Pulse_States_TypeDef ReceiverPulseStates;
 
 /* Structs for each channel's timer count values */
-static volatile Receiver_IC_Values_TypeDef ThrottleICValues;
-static volatile Receiver_IC_Values_TypeDef AileronICValues;
-static volatile Receiver_IC_Values_TypeDef ElevatorICValues;
-static volatile Receiver_IC_Values_TypeDef RudderICValues;
-static volatile Receiver_IC_Values_TypeDef GearICValues;
-static volatile Receiver_IC_Values_TypeDef Aux1ICValues;
+static volatile Receiver_IC_Values_TypeDef ThrottleICValues = { .SnapshotFlag = RECEIVER_SNAPSHOT_THROTTLE_FLAG };
+static volatile Receiver_IC_Values_TypeDef AileronICValues = { .SnapshotFlag = RECEIVER_SNAPSHOT_AILERON_FLAG };
+static volatile Receiver_IC_Values_TypeDef ElevatorICValues = { .SnapshotFlag = RECEIVER_SNAPSHOT_ELEVATOR_FLAG };
+static volatile Receiver_IC_Values_TypeDef RudderICValues = { .SnapshotFlag = RECEIVER_SNAPSHOT_RUDDER_FLAG };
+static volatile Receiver_IC_Values_TypeDef GearICValues = { .SnapshotFlag = RECEIVER_SNAPSHOT_GEAR_FLAG };
+static volatile Receiver_IC_Values_TypeDef Aux1ICValues = { .SnapshotFlag = RECEIVER_SNAPSHOT_AUX1_FLAG };
+
+/* IC values structs indexed as the receiver snapshot channels */
+static volatile Receiver_IC_Values_TypeDef* const receiverICValues[RECEIVER_SNAPSHOT_CHANNELS_NBR] = {
+		[RECEIVER_SNAPSHOT_THROTTLE] = &ThrottleICValues,
+		[RECEIVER_SNAPSHOT_AILERON] = &AileronICValues,
+		[RECEIVER_SNAPSHOT_ELEVATOR] = &ElevatorICValues,
+		[RECEIVER_SNAPSHOT_RUDDER] = &RudderICValues,
+		[RECEIVER_SNAPSHOT_GEAR] = &GearICValues,
+		[RECEIVER_SNAPSHOT_AUX1] = &Aux1ICValues };
 
 /* Struct for all receiver channel's calibration values */
 static volatile Receiver_CalibrationValues_TypeDef CalibrationValues;
+
+/* Calibration values indexed as the receiver snapshot channels */
+static volatile Receiver_IC_ChannelCalibrationValues_TypeDef* const
+		channelCalibrationValues[RECEIVER_SNAPSHOT_CHANNELS_NBR] = {
+			[RECEIVER_SNAPSHOT_THROTTLE] = &CalibrationValues.ThrottleChannel,
+			[RECEIVER_SNAPSHOT_AILERON] = &CalibrationValues.AileronChannel,
+			[RECEIVER_SNAPSHOT_ELEVATOR] = &CalibrationValues.ElevatorChannel,
+			[RECEIVER_SNAPSHOT_RUDDER] = &CalibrationValues.RudderChannel,
+			[RECEIVER_SNAPSHOT_GEAR] = &CalibrationValues.GearChannel,
+			[RECEIVER_SNAPSHOT_AUX1] = &CalibrationValues.Aux1Channel };
 static volatile ReceiverCalibrationState receiverCalibrationState;
 static volatile uint32_t receiverCalibrationStartTime;
 static volatile bool receiverCalibrationStartSaturatingMessageSent;
@@ -174,45 +259,105 @@ static volatile Receiver_ChannelCalibrationSampling_TypeDef RudderCalibrationSam
 static volatile Receiver_ChannelCalibrationSampling_TypeDef GearCalibrationSampling;
 static volatile Receiver_ChannelCalibrationSampling_TypeDef Aux1CalibrationSampling;
 
+/* Calibration sampling structs indexed as the receiver snapshot channels */
+static volatile Receiver_ChannelCalibrationSampling_TypeDef* const
+		calibrationSamplings[RECEIVER_SNAPSHOT_CHANNELS_NBR] = {
+			[RECEIVER_SNAPSHOT_THROTTLE] = &ThrottleCalibrationSampling,
+			[RECEIVER_SNAPSHOT_AILERON] = &AileronCalibrationSampling,
+			[RECEIVER_SNAPSHOT_ELEVATOR] = &ElevatorCalibrationSampling,
+			[RECEIVER_SNAPSHOT_RUDDER] = &RudderCalibrationSampling,
+			[RECEIVER_SNAPSHOT_GEAR] = &GearCalibrationSampling,
+			[RECEIVER_SNAPSHOT_AUX1] = &Aux1CalibrationSampling };
+
+/* Receiver snapshots, written by the context updating the channels only. The published snapshot is the one indexed
+ * by the lowest bit of the sequence, so a new snapshot is written without touching the one being read. */
+static volatile Receiver_Snapshot_TypeDef receiverSnapshots[2];
+static volatile uint32_t receiverSnapshotSequence;
+static uint8_t receiverSnapshotPendingFlags;
+
+/* Channel maps, the one in use indexed by channelMapIndex. The channels may be updated by a priority 0 interrupt,
+ * which critical sections do not mask, so a new map is written to the other one before switching the index. */
+static volatile Receiver_ChannelMap_TypeDef channelMaps[2];
+static volatile uint8_t channelMapIndex;
+
+static const char* const receiverModeNames[RECEIVER_MODE_NBR] = {
+		[RECEIVER_MODE_NONE] = "none",
+		[RECEIVER_MODE_ARM] = "arm",
+		[RECEIVER_MODE_RAW] = "raw",
+		[RECEIVER_MODE_STABILIZED] = "stabilized",
+		[RECEIVER_MODE_ATTITUDE] = "attitude",
+		[RECEIVER_MODE_RATE] = "rate",
+		[RECEIVER_MODE_ALTITUDE_HOLD] = "althold",
+		[RECEIVER_MODE_AUTONOMOUS] = "autonomous" };
+
+/* RC failsafe watchdog state. The receiver is in failsafe until the first complete frame. */
+static volatile bool receiverFailsafe = true;
+static volatile uint32_t receiverCompleteFrameTimestamp; // [core clock cycles]
+static volatile uint32_t receiverFrameCount;
+static volatile uint32_t receiverFailsafeCount;
+
 /* Timer reset counters for each timer */
 static volatile uint16_t PrimaryReceiverTimerPeriodCount;
 static volatile uint16_t AuxReceiverTimerPeriodCount;
 
-/* Task handle for printing of receiver values task */
-xTaskHandle ReceiverPrintSamplingTaskHandle = NULL;
+/* Rate group job that times out the receiver calibration and prompts for the stick saturation */
+static RateGroupJobId_TypeDef receiverCalibrationJobId;
 
-static volatile uint16_t receiverPrintSampleTime;
-static volatile uint16_t receiverPrintSampleDuration;
+#ifdef RECEIVER_PWM_DEFERRED_DECODING
+/* Task handle for the PWM edge decoding task */
+xTaskHandle ReceiverPWMDecodeTaskHandle = NULL;
+#endif
 
 /* Private function prototypes -----------------------------------------------*/
 static ReceiverErrorStatus InitReceiverCalibrationValues(void);
 static ReceiverErrorStatus LoadReceiverCalibrationValuesFromFlash(
 		volatile Receiver_CalibrationValues_TypeDef* calibrationValues);
 static void SetDefaultReceiverCalibrationValues(volatile Receiver_CalibrationValues_TypeDef* calibrationValues);
+#if (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_PWM)
 static ReceiverErrorStatus PrimaryReceiverInputConfig(void);
 static ReceiverErrorStatus AuxReceiverInput_Config(void);
+#endif
+static ReceiverErrorStatus ReceiverFailsafeWatchdogConfig(void);
 
 static ReceiverErrorStatus UpdateReceiverChannel(TIM_HandleTypeDef* TimHandle, TIM_IC_InitTypeDef* TimIC,
 		Pulse_State* channelInputState, volatile Receiver_IC_Values_TypeDef* ChannelICValues,
-		const uint32_t receiverChannel, volatile const uint16_t ReceiverTimerPeriodCount,
-		volatile Receiver_ChannelCalibrationSampling_TypeDef* ChannelCalibrationSampling);
+		const uint32_t receiverChannel, volatile const uint16_t ReceiverTimerPeriodCount);
+static ReceiverErrorStatus UpdateReceiverFrameChannel(volatile Receiver_IC_Values_TypeDef* ChannelICValues,
+		const uint16_t* channelPulseTicks, const uint8_t nbrOfChannels, const uint8_t frameChannel,
+		const uint32_t framePeriodTicks);
+static void UpdateChannelPulse(volatile Receiver_IC_Values_TypeDef* ChannelICValues,
+		const uint16_t channelPulseTimerCount);
+static void PublishReceiverSnapshot(const uint8_t updatedChannels);
 static ReceiverErrorStatus UpdateChannelCalibrationSamples(
 		volatile Receiver_ChannelCalibrationSampling_TypeDef* channelCalibrationSampling,
 		const uint16_t channelPulseTimerCount);
 
 static int16_t GetSignedReceiverChannel(volatile const Receiver_IC_Values_TypeDef* ChannelICValues,
 		volatile const Receiver_IC_ChannelCalibrationValues_TypeDef* ChannelCalibrationValues);
-
+static void InitReceiverChannelMap(void);
+static ReceiverErrorStatus IsChannelMapValid(const Receiver_ChannelMap_TypeDef* channelMap);
+static int16_t GetMappedReceiverChannel(volatile const Receiver_ChannelMap_TypeDef* channelMap,
+		const uint8_t receiverChannel);
+static ReceiverModeType EvaluateReceiverModeRanges(volatile const Receiver_ChannelMap_TypeDef* channelMap,
+		const int16_t channelValues[RECEIVER_SNAPSHOT_CHANNELS_NBR]);
+
+#if (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_PWM)
 static ReceiverErrorStatus IsReceiverChannelActive(volatile Receiver_IC_Values_TypeDef* ChannelICValues,
 		const uint16_t ReceiverTimerPeriodCount);
+#endif
 static ReceiverErrorStatus IsCalibrationValuesValid(
 		volatile const Receiver_CalibrationValues_TypeDef* calibrationValues);
 
 static void EnforceNewCalibrationValues(volatile Receiver_CalibrationValues_TypeDef* newCalibrationValues);
 static void ResetCalibrationSampling(volatile Receiver_ChannelCalibrationSampling_TypeDef* channelCalibrationSampling);
+static void ReceiverCalibrationStep(void* argument);
+#ifndef RECEIVER_PWM_DEFERRED_DECODING
 static void ReceiverToggleICPolarity(TIM_HandleTypeDef* htim, TIM_IC_InitTypeDef* sConfig, uint32_t Channel);
-
-static void ReceiverPrintSamplingTask(void const *argument);
+#else
+static void DecodeReceiverChannelEdges(volatile Receiver_IC_Values_TypeDef* ChannelICValues,
+		const uint32_t counterMask, const uint32_t tickMultiplier);
+static void ReceiverPWMDecodeTask(void const *argument);
+#endif
 
 /* Exported functions --------------------------------------------------------*/
 
@@ -223,60 +368,47 @@ static void ReceiverPrintSamplingTask(void const *argument);
  */
 ReceiverErrorStatus ReceiverInputConfig(void) {
 	InitReceiverCalibrationValues();
+	InitReceiverChannelMap();
+
+	/* The frames are sampled as they are published, the rate group only checks on the calibration. No task of its own
+	 * is needed, which saves its stack on the FreeRTOS heap. */
+	if (FCB_OK != RateGroupRegister("RC_CALIB", ReceiverCalibrationStep, NULL, RATE_GROUP_20HZ,
+			RECEIVER_CALIBRATION_PHASE, &receiverCalibrationJobId)) {
+		ErrorHandler();
+		return RECEIVER_ERROR;
+	}
 
+#if (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_PWM)
 	if (!PrimaryReceiverInputConfig())
 		return RECEIVER_ERROR;
 
 	if (!AuxReceiverInput_Config())
 		return RECEIVER_ERROR;
 
-	return RECEIVER_OK;
-}
-
-/*
- * @brief  Creates a task to sample print receiver values over USB
- * @param  sampleTime : Sets how often a sample should be printed
- * @param  sampleDuration : Sets for how long sampling should be performed
- * @retval RECEIVER_OK if thread started, else RECEIVER_ERROR
- */
-ReceiverErrorStatus StartReceiverSamplingTask(const uint16_t sampleTime, const uint32_t sampleDuration) {
-	if(sampleTime < RECEIVER_PRINT_MINIMUM_SAMPLING_TIME)
-		receiverPrintSampleTime = RECEIVER_PRINT_MINIMUM_SAMPLING_TIME;
-	else
-		receiverPrintSampleTime = sampleTime;
-
-	receiverPrintSampleDuration = sampleDuration;
-
-	/* Receiver value print sampling handler thread creation
-	 * Task function pointer: ReceiverPrintSamplingTask
-	 * Task name: RC_PRINT_SAMPL
-	 * Stack depth: 2*configMINIMAL_STACK_SIZE
+#ifdef RECEIVER_PWM_DEFERRED_DECODING
+	/* Receiver PWM edge decoding task
+	 * Function: ReceiverPWMDecodeTask
+	 * Task name (for debugging): RC_PWM_DECODE
+	 * Stack size: configMINIMAL_STACK_SIZE
 	 * Parameter: NULL
-	 * Priority: RECEIVER_PRINT_SAMPLING_TASK_PRIO (0 to configMAX_PRIORITIES-1 possible)
-	 * Handle: ReceiverPrintSamplingTask
+	 * Priority: RECEIVER_PWM_DECODE_TASK_PRIO (0 to configMAX_PRIORITIES-1 possible)
+	 * Handle: ReceiverPWMDecodeTaskHandle
 	 * */
-	if (pdPASS != xTaskCreate((pdTASK_CODE )ReceiverPrintSamplingTask, (signed portCHAR*)"RC_PRINT_SAMPL",
-					2*configMINIMAL_STACK_SIZE, NULL, RECEIVER_PRINT_SAMPLING_TASK_PRIO,
-					&ReceiverPrintSamplingTaskHandle)) {
+	if (pdPASS != xTaskCreate((pdTASK_CODE )ReceiverPWMDecodeTask, (signed portCHAR*)"RC_PWM_DECODE",
+					configMINIMAL_STACK_SIZE, NULL, RECEIVER_PWM_DECODE_TASK_PRIO, &ReceiverPWMDecodeTaskHandle)) {
 		ErrorHandler();
 		return RECEIVER_ERROR;
 	}
+#endif
+#else
+	if (!SerialReceiverInputConfig())
+		return RECEIVER_ERROR;
+#endif
 
-	return RECEIVER_OK;
-}
+	if (!ReceiverFailsafeWatchdogConfig())
+		return RECEIVER_ERROR;
 
-/*
- * @brief  Stops receiver print sampling by deleting the task
- * @param  None
- * @retval RECEIVER_OK if task deleted
- */
-ReceiverErrorStatus StopReceiverSamplingTask(void) {
-	if(ReceiverPrintSamplingTaskHandle != NULL) {
-		vTaskDelete(ReceiverPrintSamplingTaskHandle);
-		ReceiverPrintSamplingTaskHandle = NULL;
-		return RECEIVER_OK;
-	}
-	return RECEIVER_ERROR;
+	return RECEIVER_OK;
 }
 
 /*
@@ -285,7 +417,7 @@ ReceiverErrorStatus StopReceiverSamplingTask(void) {
  * @retval throttle value [-32768, 32767]
  */
 int16_t GetThrottleReceiverChannel(void) {
-	return GetSignedReceiverChannel(&ThrottleICValues, &CalibrationValues.ThrottleChannel);
+	return GetMappedReceiverChannel(&channelMaps[channelMapIndex], RECEIVER_SNAPSHOT_THROTTLE);
 }
 
 /*
@@ -294,7 +426,7 @@ int16_t GetThrottleReceiverChannel(void) {
  * @retval aileron value [-32768, 32767]
  */
 int16_t GetAileronReceiverChannel(void) {
-	return GetSignedReceiverChannel(&AileronICValues, &CalibrationValues.AileronChannel);
+	return GetMappedReceiverChannel(&channelMaps[channelMapIndex], RECEIVER_SNAPSHOT_AILERON);
 }
 
 /*
@@ -303,7 +435,7 @@ int16_t GetAileronReceiverChannel(void) {
  * @retval elevator value [-32768, 32767]
  */
 int16_t GetElevatorReceiverChannel(void) {
-	return GetSignedReceiverChannel(&ElevatorICValues, &CalibrationValues.ElevatorChannel);
+	return GetMappedReceiverChannel(&channelMaps[channelMapIndex], RECEIVER_SNAPSHOT_ELEVATOR);
 }
 
 /*
@@ -312,7 +444,7 @@ int16_t GetElevatorReceiverChannel(void) {
  * @retval rudder value [-32768, 32767]
  */
 int16_t GetRudderReceiverChannel(void) {
-	return GetSignedReceiverChannel(&RudderICValues, &CalibrationValues.RudderChannel);
+	return GetMappedReceiverChannel(&channelMaps[channelMapIndex], RECEIVER_SNAPSHOT_RUDDER);
 }
 
 /*
@@ -321,7 +453,7 @@ int16_t GetRudderReceiverChannel(void) {
  * @retval gear value [-32768, 32767]
  */
 int16_t GetGearReceiverChannel(void) {
-	return GetSignedReceiverChannel(&GearICValues, &CalibrationValues.GearChannel);
+	return GetMappedReceiverChannel(&channelMaps[channelMapIndex], RECEIVER_SNAPSHOT_GEAR);
 }
 
 /*
@@ -330,7 +462,7 @@ int16_t GetGearReceiverChannel(void) {
  * @retval aux1 value [-32768, 32767]
  */
 int16_t GetAux1ReceiverChannel(void) {
-	return GetSignedReceiverChannel(&Aux1ICValues, &CalibrationValues.Aux1Channel);
+	return GetMappedReceiverChannel(&channelMaps[channelMapIndex], RECEIVER_SNAPSHOT_AUX1);
 }
 
 /*
@@ -442,27 +574,202 @@ uint32_t GetAux1ReceiverChannelPeriodTicks(void) {
 }
 
 /*
- * @brief  Return boolean indicating if raw flight mode should be used (gear and aux1 switched to 1)
+ * @brief  Returns the mode selected by the receiver mode ranges for the current channel values
  * @param  None
- * @retval bool indicating if raw flight mode set from receiver
+ * @retval The mode, RECEIVER_MODE_NONE if no mode range is active or an arm range is inactive
  */
-bool GetReceiverRawFlightSet(void) {
-	if(GetGearReceiverChannel() >= RECEIVER_SWITCH_ON_MIN_VAL && GetAux1ReceiverChannel() >= RECEIVER_SWITCH_ON_MIN_VAL)
-		return true;
-	else
-		return false;
+ReceiverModeType GetReceiverMode(void) {
+	volatile const Receiver_ChannelMap_TypeDef* channelMap = &channelMaps[channelMapIndex];
+	int16_t channelValues[RECEIVER_SNAPSHOT_CHANNELS_NBR];
+	uint8_t i;
+
+	for (i = 0; i < RECEIVER_SNAPSHOT_CHANNELS_NBR; i++)
+		channelValues[i] = GetMappedReceiverChannel(channelMap, i);
+
+	return EvaluateReceiverModeRanges(channelMap, channelValues);
 }
 
 /*
- * @brief  Return boolean indicating if PID flight mode should be used (gear set to 1, aux1 set to 0)
+ * @brief  Gets the name of a receiver mode, as used by the CLI
+ * @param  mode : The mode
+ * @retval Name of the mode, "?" if unknown
+ */
+const char* GetReceiverModeName(const ReceiverModeType mode) {
+	return mode < RECEIVER_MODE_NBR ? receiverModeNames[mode] : "?";
+}
+
+/*
+ * @brief  Gets the channel map and mode ranges in use
+ * @param  dstMap : Destination channel map
+ * @retval None
+ */
+void GetReceiverChannelMap(Receiver_ChannelMap_TypeDef* dstMap) {
+	*dstMap = channelMaps[channelMapIndex];
+}
+
+/*
+ * @brief  Gets the default channel map: the receiver functions on their own PWM inputs or the RECEIVER_FRAME_*
+ *         frame channels, none reversed, and the mode ranges of the gear and aux1 switch positions. Gear on arms, then
+ *         aux1 on selects the raw mode, off the stabilized mode and mid the autonomous mode.
+ * @param  dstMap : Destination channel map
+ * @retval None
+ */
+void GetDefaultReceiverChannelMap(Receiver_ChannelMap_TypeDef* dstMap) {
+	memset(dstMap, 0, sizeof(Receiver_ChannelMap_TypeDef));
+
+#if (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_PWM)
+	dstMap->Inputs[RECEIVER_SNAPSHOT_THROTTLE] = RECEIVER_SNAPSHOT_THROTTLE;
+	dstMap->Inputs[RECEIVER_SNAPSHOT_AILERON] = RECEIVER_SNAPSHOT_AILERON;
+	dstMap->Inputs[RECEIVER_SNAPSHOT_ELEVATOR] = RECEIVER_SNAPSHOT_ELEVATOR;
+	dstMap->Inputs[RECEIVER_SNAPSHOT_RUDDER] = RECEIVER_SNAPSHOT_RUDDER;
+	dstMap->Inputs[RECEIVER_SNAPSHOT_GEAR] = RECEIVER_SNAPSHOT_GEAR;
+	dstMap->Inputs[RECEIVER_SNAPSHOT_AUX1] = RECEIVER_SNAPSHOT_AUX1;
+#else
+	dstMap->Inputs[RECEIVER_SNAPSHOT_THROTTLE] = RECEIVER_FRAME_THROTTLE_CHANNEL;
+	dstMap->Inputs[RECEIVER_SNAPSHOT_AILERON] = RECEIVER_FRAME_AILERON_CHANNEL;
+	dstMap->Inputs[RECEIVER_SNAPSHOT_ELEVATOR] = RECEIVER_FRAME_ELEVATOR_CHANNEL;
+	dstMap->Inputs[RECEIVER_SNAPSHOT_RUDDER] = RECEIVER_FRAME_RUDDER_CHANNEL;
+	dstMap->Inputs[RECEIVER_SNAPSHOT_GEAR] = RECEIVER_FRAME_GEAR_CHANNEL;
+	dstMap->Inputs[RECEIVER_SNAPSHOT_AUX1] = RECEIVER_FRAME_AUX1_CHANNEL;
+#endif
+
+	dstMap->ModeRanges[0] = (Receiver_ModeRange_TypeDef) { RECEIVER_SNAPSHOT_GEAR, RECEIVER_MODE_ARM,
+			RECEIVER_SWITCH_ON_MIN_PERCENT, 100 };
+	dstMap->ModeRanges[1] = (Receiver_ModeRange_TypeDef) { RECEIVER_SNAPSHOT_AUX1, RECEIVER_MODE_RAW,
+			RECEIVER_SWITCH_ON_MIN_PERCENT, 100 };
+	dstMap->ModeRanges[2] = (Receiver_ModeRange_TypeDef) { RECEIVER_SNAPSHOT_AUX1, RECEIVER_MODE_STABILIZED,
+			-100, RECEIVER_SWITCH_OFF_MAX_PERCENT };
+	dstMap->ModeRanges[3] = (Receiver_ModeRange_TypeDef) { RECEIVER_SNAPSHOT_AUX1, RECEIVER_MODE_AUTONOMOUS,
+			-RECEIVER_SWITCH_MID_MAX_ABS_PERCENT, RECEIVER_SWITCH_MID_MAX_ABS_PERCENT };
+}
+
+/*
+ * @brief  Takes a channel map and mode ranges into use from the next RC frame. The UAV must be in idle mode.
+ * @param  channelMap : The new channel map
+ * @retval RECEIVER_OK if set, RECEIVER_ERROR if the map is invalid or the UAV is not in idle mode
+ */
+ReceiverErrorStatus SetReceiverChannelMap(const Receiver_ChannelMap_TypeDef* channelMap) {
+	uint8_t nextIndex = channelMapIndex ^ 1;
+
+	if (FLIGHT_CONTROL_IDLE != GetFlightControlMode() || !IsChannelMapValid(channelMap))
+		return RECEIVER_ERROR;
+
+	/* The map not in use is only read by a snapshot published before the previous change */
+	channelMaps[nextIndex] = *channelMap;
+	__DMB();
+	channelMapIndex = nextIndex;
+
+	return RECEIVER_OK;
+}
+
+/*
+ * @brief  Saves the channel map and mode ranges in use to flash. The UAV must be in idle mode.
  * @param  None
- * @retval bool indicating if raw flight mode set from receiver
+ * @retval RECEIVER_OK if saved, else RECEIVER_ERROR
  */
-bool GetReceiverPIDFlightSet(void) {
-	if(GetGearReceiverChannel() >= RECEIVER_SWITCH_ON_MIN_VAL && GetAux1ReceiverChannel() <= RECEIVER_SWITCH_OFF_MAX_VAL)
-		return true;
-	else
-		return false;
+ReceiverErrorStatus SaveReceiverChannelMap(void) {
+	Receiver_ChannelMap_TypeDef channelMap;
+
+	/* The channel map is copied while disarmed, so that a remap in flight is never half saved */
+	if (FLIGHT_CONTROL_IDLE != GetFlightControlMode())
+		return RECEIVER_ERROR;
+
+	GetReceiverChannelMap(&channelMap);
+
+	return FLASH_OK == WriteReceiverChannelMapToFlash(&channelMap) ? RECEIVER_OK : RECEIVER_ERROR;
+}
+
+/*
+ * @brief  Gets the receiver snapshot of the latest complete RC frame. The channel values are normalized when the
+ *         frame completes, so reading the snapshot costs no more than the copy.
+ * @param  dstSnapshot : Destination snapshot
+ * @retval RECEIVER_OK if the receiver is active and the snapshot recent, else RECEIVER_ERROR
+ */
+ReceiverErrorStatus GetReceiverSnapshot(Receiver_Snapshot_TypeDef* dstSnapshot) {
+	uint32_t sequence;
+
+	/* The writer may be a priority 0 interrupt, which critical sections do not mask. Copy again if a snapshot was
+	 * published while copying. */
+	do {
+		sequence = receiverSnapshotSequence;
+		__DMB();
+		*dstSnapshot = receiverSnapshots[sequence & 1];
+		__DMB();
+	} while (sequence != receiverSnapshotSequence);
+
+	if (receiverFailsafe || (uint32_t) GetMicroseconds() - dstSnapshot->Timestamp > RECEIVER_SNAPSHOT_TIMEOUT*1000)
+		dstSnapshot->IsActive = RECEIVER_ERROR;
+
+	return dstSnapshot->IsActive;
+}
+
+/*
+ * @brief  Gets the sequence number of the latest receiver snapshot. Polling it tells when a new RC frame has
+ *         completed, also when the snapshot is published from an interrupt above the RTOS syscall priority.
+ * @param  None
+ * @retval Sequence number, see Receiver_Snapshot_TypeDef
+ */
+uint32_t GetReceiverSnapshotSequence(void) {
+	return receiverSnapshotSequence;
+}
+
+/*
+ * @brief  Handles the failsafe watchdog TIM period elapsed interrupt. The receiver enters failsafe if no complete RC
+ *         frame has arrived within RECEIVER_FAILSAFE_TIMEOUT, and the flight control is notified.
+ * @param  None
+ * @retval None
+ */
+void ReceiverFailsafeTimerElapsed(void) {
+	if (receiverFailsafe || GetTimestamp() - receiverCompleteFrameTimestamp < RECEIVER_FAILSAFE_TIMEOUT_CYCLES)
+		return;
+
+	/* A frame completed by a priority 0 interrupt in between has restarted the watchdog, then it is not a failsafe */
+	receiverFailsafe = true;
+	__DMB();
+	if (GetTimestamp() - receiverCompleteFrameTimestamp < RECEIVER_FAILSAFE_TIMEOUT_CYCLES) {
+		receiverFailsafe = false;
+		return;
+	}
+
+	receiverFailsafeCount++;
+	SendReceiverFailsafeToFlightControl();
+}
+
+/*
+ * @brief  Checks if the receiver is in failsafe, i.e. no complete RC frame has arrived within RECEIVER_FAILSAFE_TIMEOUT
+ * @param  None
+ * @retval true if in failsafe
+ */
+bool IsReceiverFailsafe(void) {
+	return receiverFailsafe;
+}
+
+/*
+ * @brief  Gets the receiver link quality counters. The counters are read while they are updated, so they may be
+ *         from consecutive frames.
+ * @param  dstStats : Destination link statistics
+ * @retval None
+ */
+void GetReceiverLinkStats(Receiver_LinkStats_TypeDef* dstStats) {
+	volatile Receiver_IC_Values_TypeDef* channelICValues;
+	uint32_t now = GetTimestamp();
+	uint32_t pulsePeriod;
+	uint8_t i;
+
+	for (i = 0; i < RECEIVER_SNAPSHOT_CHANNELS_NBR; i++) {
+		channelICValues = receiverICValues[i];
+		pulsePeriod = channelICValues->PulsePeriod;
+		dstStats->Channels[i].PulseCount = channelICValues->PulseCount;
+		dstStats->Channels[i].DropoutCount = channelICValues->DropoutCount;
+		if (pulsePeriod > 0 && now - channelICValues->LastPulseTimestamp < RECEIVER_FAILSAFE_TIMEOUT_CYCLES)
+			dstStats->Channels[i].PulseRate = SystemCoreClock / pulsePeriod;
+		else
+			dstStats->Channels[i].PulseRate = 0;
+	}
+
+	dstStats->FrameCount = receiverFrameCount;
+	dstStats->FailsafeCount = receiverFailsafeCount;
+	dstStats->IsFailsafe = receiverFailsafe;
 }
 
 /*
@@ -516,10 +823,13 @@ ReceiverErrorStatus StartReceiverCalibration(void) {
 		/* Set the calibration start time */
 		receiverCalibrationStartTime = HAL_GetTick();
 		receiverCalibrationStartSaturatingMessageSent = false;
+		__DMB();
 		receiverCalibrationState = RECEIVER_CALIBRATION_IN_PROGRESS;
 
 		/* Start printing calibration samples */
-		StartReceiverSamplingTask(RECEIVER_PRINT_MINIMUM_SAMPLING_TIME, RECEIVER_MAX_CALIBRATION_DURATION/configTICK_RATE_HZ);
+		USBComSendString("Set RC transmitter sticks to middle positions\r\n");
+		StartTelemetry(RC_VALUES_MSG_ENUM, NO_SERIALIZATION, RECEIVER_PRINT_MINIMUM_SAMPLING_TIME,
+				RECEIVER_MAX_CALIBRATION_DURATION/configTICK_RATE_HZ);
 
 		return RECEIVER_OK;
 	}
@@ -546,6 +856,11 @@ ReceiverErrorStatus StopReceiverCalibration(void) {
 	/* Check so that receiver calibration is currently being performed */
 	if (receiverCalibrationState == RECEIVER_CALIBRATION_IN_PROGRESS) {
 
+		/* Stop sampling so that the samples are not updated while being evaluated. The frames are only sampled while
+		 * the calibration is in progress, see PublishReceiverSnapshot(). */
+		receiverCalibrationState = RECEIVER_CALIBRATION_WAITING;
+		__DMB();
+
 		/* Check so that each channel has collected enough pulse samples during calibration */
 		if (ThrottleCalibrationSampling.channelCalibrationPulseSamples < RECEIVER_CALIBRATION_MIN_PULSE_COUNT)
 			returnStatus = RECEIVER_ERROR;
@@ -580,31 +895,31 @@ ReceiverErrorStatus StopReceiverCalibration(void) {
 			errorMsgPrinted = true;
 		}
 
-		/* Calculate mean of max and mean sample buffers and store in temporary calibration values struct */
-		tmpCalibrationValues.ThrottleChannel.ChannelMaxCount = UInt16Mean(
-				(uint16_t*) &ThrottleCalibrationSampling.maxSamplesBuffer[0], RECEIVER_CALIBRATION_SAMPLES_BUFFER_SIZE);
-		tmpCalibrationValues.ThrottleChannel.ChannelMinCount = UInt16Mean(
-				(uint16_t*) &ThrottleCalibrationSampling.minSamplesBuffer[0], RECEIVER_CALIBRATION_SAMPLES_BUFFER_SIZE);
-		tmpCalibrationValues.AileronChannel.ChannelMaxCount = UInt16Mean(
-				(uint16_t*) &AileronCalibrationSampling.maxSamplesBuffer[0], RECEIVER_CALIBRATION_SAMPLES_BUFFER_SIZE);
-		tmpCalibrationValues.AileronChannel.ChannelMinCount = UInt16Mean(
-				(uint16_t*) &AileronCalibrationSampling.minSamplesBuffer[0], RECEIVER_CALIBRATION_SAMPLES_BUFFER_SIZE);
-		tmpCalibrationValues.ElevatorChannel.ChannelMaxCount = UInt16Mean(
-				(uint16_t*) &ElevatorCalibrationSampling.maxSamplesBuffer[0], RECEIVER_CALIBRATION_SAMPLES_BUFFER_SIZE);
-		tmpCalibrationValues.ElevatorChannel.ChannelMinCount = UInt16Mean(
-				(uint16_t*) &ElevatorCalibrationSampling.minSamplesBuffer[0], RECEIVER_CALIBRATION_SAMPLES_BUFFER_SIZE);
-		tmpCalibrationValues.RudderChannel.ChannelMaxCount = UInt16Mean(
-				(uint16_t*) &RudderCalibrationSampling.maxSamplesBuffer[0], RECEIVER_CALIBRATION_SAMPLES_BUFFER_SIZE);
-		tmpCalibrationValues.RudderChannel.ChannelMinCount = UInt16Mean(
-				(uint16_t*) &RudderCalibrationSampling.minSamplesBuffer[0], RECEIVER_CALIBRATION_SAMPLES_BUFFER_SIZE);
-		tmpCalibrationValues.GearChannel.ChannelMaxCount = UInt16Mean(
-				(uint16_t*) &GearCalibrationSampling.maxSamplesBuffer[0], RECEIVER_CALIBRATION_SAMPLES_BUFFER_SIZE);
-		tmpCalibrationValues.GearChannel.ChannelMinCount = UInt16Mean(
-				(uint16_t*) &GearCalibrationSampling.minSamplesBuffer[0], RECEIVER_CALIBRATION_SAMPLES_BUFFER_SIZE);
-		tmpCalibrationValues.Aux1Channel.ChannelMaxCount = UInt16Mean(
-				(uint16_t*) &Aux1CalibrationSampling.maxSamplesBuffer[0], RECEIVER_CALIBRATION_SAMPLES_BUFFER_SIZE);
-		tmpCalibrationValues.Aux1Channel.ChannelMinCount = UInt16Mean(
-				(uint16_t*) &Aux1CalibrationSampling.minSamplesBuffer[0], RECEIVER_CALIBRATION_SAMPLES_BUFFER_SIZE);
+		/* Store the max and min pulse estimates in temporary calibration values struct */
+		tmpCalibrationValues.ThrottleChannel.ChannelMaxCount = ThrottleCalibrationSampling.maxPulseEstimate
+				>> RECEIVER_CALIBRATION_ESTIMATE_SHIFT;
+		tmpCalibrationValues.ThrottleChannel.ChannelMinCount = ThrottleCalibrationSampling.minPulseEstimate
+				>> RECEIVER_CALIBRATION_ESTIMATE_SHIFT;
+		tmpCalibrationValues.AileronChannel.ChannelMaxCount = AileronCalibrationSampling.maxPulseEstimate
+				>> RECEIVER_CALIBRATION_ESTIMATE_SHIFT;
+		tmpCalibrationValues.AileronChannel.ChannelMinCount = AileronCalibrationSampling.minPulseEstimate
+				>> RECEIVER_CALIBRATION_ESTIMATE_SHIFT;
+		tmpCalibrationValues.ElevatorChannel.ChannelMaxCount = ElevatorCalibrationSampling.maxPulseEstimate
+				>> RECEIVER_CALIBRATION_ESTIMATE_SHIFT;
+		tmpCalibrationValues.ElevatorChannel.ChannelMinCount = ElevatorCalibrationSampling.minPulseEstimate
+				>> RECEIVER_CALIBRATION_ESTIMATE_SHIFT;
+		tmpCalibrationValues.RudderChannel.ChannelMaxCount = RudderCalibrationSampling.maxPulseEstimate
+				>> RECEIVER_CALIBRATION_ESTIMATE_SHIFT;
+		tmpCalibrationValues.RudderChannel.ChannelMinCount = RudderCalibrationSampling.minPulseEstimate
+				>> RECEIVER_CALIBRATION_ESTIMATE_SHIFT;
+		tmpCalibrationValues.GearChannel.ChannelMaxCount = GearCalibrationSampling.maxPulseEstimate
+				>> RECEIVER_CALIBRATION_ESTIMATE_SHIFT;
+		tmpCalibrationValues.GearChannel.ChannelMinCount = GearCalibrationSampling.minPulseEstimate
+				>> RECEIVER_CALIBRATION_ESTIMATE_SHIFT;
+		tmpCalibrationValues.Aux1Channel.ChannelMaxCount = Aux1CalibrationSampling.maxPulseEstimate
+				>> RECEIVER_CALIBRATION_ESTIMATE_SHIFT;
+		tmpCalibrationValues.Aux1Channel.ChannelMinCount = Aux1CalibrationSampling.minPulseEstimate
+				>> RECEIVER_CALIBRATION_ESTIMATE_SHIFT;
 
 		/* Calculate sticks calibration mid-point mean value */
 		tmpCalibrationValues.ThrottleChannel.ChannelMidCount = ThrottleCalibrationSampling.midSamplesPulseSum
@@ -637,11 +952,8 @@ ReceiverErrorStatus StopReceiverCalibration(void) {
 			EnforceNewCalibrationValues(&tmpCalibrationValues);
 		}
 
-		/* Reset calibration states to waiting so a new calibration may be initiated */
-		receiverCalibrationState = RECEIVER_CALIBRATION_WAITING;
-
 		/* Stop printing calibration samples */
-		StopReceiverSamplingTask();
+		StopTelemetry(RC_VALUES_MSG_ENUM);
 
 		return returnStatus;
 	}
@@ -673,12 +985,34 @@ void ResetReceiverCalibrationValues(void)
 	EnforceNewCalibrationValues(&tmpCalibrationValues);
 }
 
+/*
+ * @brief  Checks if the receiver has a stored calibration. The calibration record has passed the CRC check of the
+ *         settings store, and its values are checked as when they are loaded at startup.
+ * @param  None.
+ * @retval true if calibrated and not being calibrated, else false
+ */
+bool IsReceiverCalibrated(void) {
+	Receiver_CalibrationValues_TypeDef storedCalibrationValues;
+
+	if (receiverCalibrationState == RECEIVER_CALIBRATION_IN_PROGRESS)
+		return false;
+
+	return RECEIVER_OK == LoadReceiverCalibrationValuesFromFlash(&storedCalibrationValues);
+}
+
 /*
  * @brief  Checks if the RC transmission between transmitter and receiver is active.
  * @param  None.
  * @retval RECEIVER_OK if transmission is active, else RECEIVER_ERROR.
  */
 ReceiverErrorStatus IsReceiverActive(void) {
+	if (receiverFailsafe)
+		return RECEIVER_ERROR;
+
+#if (RECEIVER_INPUT_PROTOCOL != RECEIVER_PROTOCOL_PWM)
+	/* A frame carries all channels, so the frames themselves tell if the transmission is active */
+	return IsSerialReceiverActive();
+#else
 	ReceiverErrorStatus aileronChannelActive;
 	ReceiverErrorStatus elevatorChannelActive;
 	ReceiverErrorStatus rudderChannelActive;
@@ -691,6 +1025,7 @@ ReceiverErrorStatus IsReceiverActive(void) {
 	rudderChannelActive = IsReceiverChannelActive(&RudderICValues, PrimaryReceiverTimerPeriodCount);
 
 	return (aileronChannelActive && elevatorChannelActive && rudderChannelActive);
+#endif
 }
 
 /**
@@ -863,7 +1198,7 @@ uint16_t GetAux1ReceiverCalibrationMinValue(void) {
 ReceiverErrorStatus UpdateReceiverThrottleChannel(void) {
 	return UpdateReceiverChannel(&PrimaryReceiverTimHandle, &ThrottleChannelICConfig,
 			&ReceiverPulseStates.ThrottleInputState, &ThrottleICValues, PRIMARY_RECEIVER_THROTTLE_CHANNEL,
-			PrimaryReceiverTimerPeriodCount, &ThrottleCalibrationSampling);
+			PrimaryReceiverTimerPeriodCount);
 }
 
 /*
@@ -874,7 +1209,7 @@ ReceiverErrorStatus UpdateReceiverThrottleChannel(void) {
 ReceiverErrorStatus UpdateReceiverAileronChannel(void) {
 	return UpdateReceiverChannel(&PrimaryReceiverTimHandle, &AileronChannelICConfig,
 			&ReceiverPulseStates.AileronInputState, &AileronICValues, PRIMARY_RECEIVER_AILERON_CHANNEL,
-			PrimaryReceiverTimerPeriodCount, &AileronCalibrationSampling);
+			PrimaryReceiverTimerPeriodCount);
 }
 
 /*
@@ -885,7 +1220,7 @@ ReceiverErrorStatus UpdateReceiverAileronChannel(void) {
 ReceiverErrorStatus UpdateReceiverElevatorChannel(void) {
 	return UpdateReceiverChannel(&PrimaryReceiverTimHandle, &ElevatorChannelICConfig,
 			&ReceiverPulseStates.ElevatorInputState, &ElevatorICValues, PRIMARY_RECEIVER_ELEVATOR_CHANNEL,
-			PrimaryReceiverTimerPeriodCount, &ElevatorCalibrationSampling);
+			PrimaryReceiverTimerPeriodCount);
 }
 
 /*
@@ -896,7 +1231,7 @@ ReceiverErrorStatus UpdateReceiverElevatorChannel(void) {
 ReceiverErrorStatus UpdateReceiverRudderChannel(void) {
 	return UpdateReceiverChannel(&PrimaryReceiverTimHandle, &RudderChannelICConfig,
 			&ReceiverPulseStates.RudderInputState, &RudderICValues, PRIMARY_RECEIVER_RUDDER_CHANNEL,
-			PrimaryReceiverTimerPeriodCount, &RudderCalibrationSampling);
+			PrimaryReceiverTimerPeriodCount);
 }
 
 /*
@@ -906,7 +1241,7 @@ ReceiverErrorStatus UpdateReceiverRudderChannel(void) {
  */
 ReceiverErrorStatus UpdateReceiverGearChannel(void) {
 	return UpdateReceiverChannel(&AuxReceiverTimHandle, &GearChannelICConfig, &ReceiverPulseStates.GearInputState,
-			&GearICValues, AUX_RECEIVER_GEAR_CHANNEL, AuxReceiverTimerPeriodCount, &GearCalibrationSampling);
+			&GearICValues, AUX_RECEIVER_GEAR_CHANNEL, AuxReceiverTimerPeriodCount);
 }
 
 /*
@@ -916,7 +1251,42 @@ ReceiverErrorStatus UpdateReceiverGearChannel(void) {
  */
 ReceiverErrorStatus UpdateReceiverAux1Channel(void) {
 	return UpdateReceiverChannel(&AuxReceiverTimHandle, &Aux1ChannelICConfig, &ReceiverPulseStates.Aux1InputState,
-			&Aux1ICValues, AUX_RECEIVER_AUX1_CHANNEL, AuxReceiverTimerPeriodCount, &Aux1CalibrationSampling);
+			&Aux1ICValues, AUX_RECEIVER_AUX1_CHANNEL, AuxReceiverTimerPeriodCount);
+}
+
+/*
+ * @brief  Updates the receiver channels from a decoded PPM-sum, SBUS or DSM frame. Called from the interrupt that
+ *         completed the frame.
+ * @param  channelPulseTicks : Channel pulse widths in receiver timer ticks, in frame channel order
+ * @param  nbrOfChannels : Number of channels in channelPulseTicks
+ * @param  framePeriodTicks : Time since the previous frame in receiver timer ticks
+ * @retval RECEIVER_OK if all receiver functions had valid pulses, else RECEIVER_ERROR
+ */
+ReceiverErrorStatus UpdateReceiverChannelsFromFrame(const uint16_t* channelPulseTicks, const uint8_t nbrOfChannels,
+		const uint32_t framePeriodTicks) {
+	volatile const uint8_t* inputs = channelMaps[channelMapIndex].Inputs;
+	ReceiverErrorStatus errorStatus = RECEIVER_OK;
+
+	if (!UpdateReceiverFrameChannel(&ThrottleICValues, channelPulseTicks,
+			nbrOfChannels, inputs[RECEIVER_SNAPSHOT_THROTTLE], framePeriodTicks))
+		errorStatus = RECEIVER_ERROR;
+	if (!UpdateReceiverFrameChannel(&AileronICValues, channelPulseTicks,
+			nbrOfChannels, inputs[RECEIVER_SNAPSHOT_AILERON], framePeriodTicks))
+		errorStatus = RECEIVER_ERROR;
+	if (!UpdateReceiverFrameChannel(&ElevatorICValues, channelPulseTicks,
+			nbrOfChannels, inputs[RECEIVER_SNAPSHOT_ELEVATOR], framePeriodTicks))
+		errorStatus = RECEIVER_ERROR;
+	if (!UpdateReceiverFrameChannel(&RudderICValues, channelPulseTicks,
+			nbrOfChannels, inputs[RECEIVER_SNAPSHOT_RUDDER], framePeriodTicks))
+		errorStatus = RECEIVER_ERROR;
+	if (!UpdateReceiverFrameChannel(&GearICValues, channelPulseTicks,
+			nbrOfChannels, inputs[RECEIVER_SNAPSHOT_GEAR], framePeriodTicks))
+		errorStatus = RECEIVER_ERROR;
+	if (!UpdateReceiverFrameChannel(&Aux1ICValues, channelPulseTicks,
+			nbrOfChannels, inputs[RECEIVER_SNAPSHOT_AUX1], framePeriodTicks))
+		errorStatus = RECEIVER_ERROR;
+
+	return errorStatus;
 }
 
 /*
@@ -1026,6 +1396,34 @@ static ReceiverErrorStatus LoadReceiverCalibrationValuesFromFlash(
 	return RECEIVER_OK;
 }
 
+/*
+ * @brief  Initializes the RC failsafe watchdog timer, which is restarted by every complete RC frame
+ * @param  None.
+ * @retval RECEIVER_OK if configured without errors, else RECEIVER_ERROR
+ */
+static ReceiverErrorStatus ReceiverFailsafeWatchdogConfig(void) {
+	/* Set the failsafe TIM instance */
+	ReceiverFailsafeTimHandle.Instance = RECEIVER_FAILSAFE_TIM;
+
+	/* Elapses RECEIVER_FAILSAFE_TIMEOUT after the latest restart */
+	ReceiverFailsafeTimHandle.Init.Period = RECEIVER_FAILSAFE_TIMEOUT*(RECEIVER_FAILSAFE_TIM_COUNTER_CLOCK/1000) - 1;
+	ReceiverFailsafeTimHandle.Init.Prescaler = SystemCoreClock / RECEIVER_FAILSAFE_TIM_COUNTER_CLOCK - 1;
+	ReceiverFailsafeTimHandle.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+	ReceiverFailsafeTimHandle.Init.CounterMode = TIM_COUNTERMODE_UP;
+	if (HAL_TIM_Base_Init(&ReceiverFailsafeTimHandle) != HAL_OK) {
+		ErrorHandler();
+		return RECEIVER_ERROR;
+	}
+
+	if (HAL_TIM_Base_Start_IT(&ReceiverFailsafeTimHandle) != HAL_OK) {
+		ErrorHandler();
+		return RECEIVER_ERROR;
+	}
+
+	return RECEIVER_OK;
+}
+
+#if (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_PWM)
 /*
  * @brief  Initializes reading from the receiver primary input channels, i.e. throttle aileron,
  *     elevator and rudder channels. The signals are encoded as pulses of ~1-2 ms.
@@ -1040,7 +1438,11 @@ static ReceiverErrorStatus PrimaryReceiverInputConfig(void) {
 	PrimaryReceiverTimHandle.Instance = PRIMARY_RECEIVER_TIM;
 
 	/* Initialize TIM peripheral to maximum period with suitable counter clocking (receiver input period is ~22 ms) */
+#ifdef RECEIVER_PWM_DEFERRED_DECODING
+	PrimaryReceiverTimHandle.Init.Period = RECEIVER_PWM_PRIMARY_COUNTER_PERIOD;
+#else
 	PrimaryReceiverTimHandle.Init.Period = RECEIVER_COUNTER_PERIOD;
+#endif
 	PrimaryReceiverTimHandle.Init.Prescaler = SystemCoreClock / RECEIVER_TIM_COUNTER_CLOCK - 1;
 	PrimaryReceiverTimHandle.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
 	PrimaryReceiverTimHandle.Init.CounterMode = TIM_COUNTERMODE_UP;
@@ -1060,7 +1462,7 @@ static ReceiverErrorStatus PrimaryReceiverInputConfig(void) {
 	/* Common configuration */
 	ThrottleChannelICConfig.ICPrescaler = TIM_ICPSC_DIV1;
 	ThrottleChannelICConfig.ICFilter = 0;
-	ThrottleChannelICConfig.ICPolarity = TIM_ICPOLARITY_RISING;
+	ThrottleChannelICConfig.ICPolarity = RECEIVER_PWM_IC_POLARITY;
 	ThrottleChannelICConfig.ICSelection = TIM_ICSELECTION_DIRECTTI;
 	/* Configure the Input Capture of throttle channel */
 	if (HAL_TIM_IC_ConfigChannel(&PrimaryReceiverTimHandle, &ThrottleChannelICConfig, PRIMARY_RECEIVER_THROTTLE_CHANNEL)
@@ -1072,7 +1474,7 @@ static ReceiverErrorStatus PrimaryReceiverInputConfig(void) {
 
 	AileronChannelICConfig.ICPrescaler = TIM_ICPSC_DIV1;
 	AileronChannelICConfig.ICFilter = 0;
-	AileronChannelICConfig.ICPolarity = TIM_ICPOLARITY_RISING;
+	AileronChannelICConfig.ICPolarity = RECEIVER_PWM_IC_POLARITY;
 	AileronChannelICConfig.ICSelection = TIM_ICSELECTION_DIRECTTI;
 	/* Configure the Input Capture of aileron channel */
 	if (HAL_TIM_IC_ConfigChannel(&PrimaryReceiverTimHandle, &AileronChannelICConfig, PRIMARY_RECEIVER_AILERON_CHANNEL)
@@ -1084,7 +1486,7 @@ static ReceiverErrorStatus PrimaryReceiverInputConfig(void) {
 
 	ElevatorChannelICConfig.ICPrescaler = TIM_ICPSC_DIV1;
 	ElevatorChannelICConfig.ICFilter = 0;
-	ElevatorChannelICConfig.ICPolarity = TIM_ICPOLARITY_RISING;
+	ElevatorChannelICConfig.ICPolarity = RECEIVER_PWM_IC_POLARITY;
 	ElevatorChannelICConfig.ICSelection = TIM_ICSELECTION_DIRECTTI;
 	/* Configure the Input Capture of elevator channel */
 	if (HAL_TIM_IC_ConfigChannel(&PrimaryReceiverTimHandle, &ElevatorChannelICConfig, PRIMARY_RECEIVER_ELEVATOR_CHANNEL)
@@ -1096,7 +1498,7 @@ static ReceiverErrorStatus PrimaryReceiverInputConfig(void) {
 
 	RudderChannelICConfig.ICPrescaler = TIM_ICPSC_DIV1;
 	RudderChannelICConfig.ICFilter = 0;
-	RudderChannelICConfig.ICPolarity = TIM_ICPOLARITY_RISING;
+	RudderChannelICConfig.ICPolarity = RECEIVER_PWM_IC_POLARITY;
 	RudderChannelICConfig.ICSelection = TIM_ICSELECTION_DIRECTTI;
 	/* Configure the Input Capture of rudder channel */
 	if (HAL_TIM_IC_ConfigChannel(&PrimaryReceiverTimHandle, &RudderChannelICConfig, PRIMARY_RECEIVER_RUDDER_CHANNEL)
@@ -1131,12 +1533,14 @@ static ReceiverErrorStatus PrimaryReceiverInputConfig(void) {
 		ErrorHandler();
 	}
 
+#ifndef RECEIVER_PWM_DEFERRED_DECODING
 	/*##-4- Start the Time Base update interrupt mode ##########################*/
 	if (HAL_TIM_Base_Start_IT(&PrimaryReceiverTimHandle) != HAL_OK) {
 		/* Starting Error */
 		errorStatus = RECEIVER_ERROR;
 		ErrorHandler();
 	}
+#endif
 	return errorStatus;
 }
 
@@ -1155,7 +1559,11 @@ static ReceiverErrorStatus AuxReceiverInput_Config(void) {
 
 	/* Initialize TIM peripheral to maximum period with suitable counter clocking (receiver input period is ~22 ms) */
 	AuxReceiverTimHandle.Init.Period = RECEIVER_COUNTER_PERIOD;
+#ifdef RECEIVER_PWM_DEFERRED_DECODING
+	AuxReceiverTimHandle.Init.Prescaler = SystemCoreClock / RECEIVER_PWM_AUX_COUNTER_CLOCK - 1;
+#else
 	AuxReceiverTimHandle.Init.Prescaler = SystemCoreClock / RECEIVER_TIM_COUNTER_CLOCK - 1;
+#endif
 	AuxReceiverTimHandle.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
 	AuxReceiverTimHandle.Init.CounterMode = TIM_COUNTERMODE_UP;
 	if (HAL_TIM_Base_Init(&AuxReceiverTimHandle) != HAL_OK) {
@@ -1174,7 +1582,7 @@ static ReceiverErrorStatus AuxReceiverInput_Config(void) {
 	/* Common configuration */
 	GearChannelICConfig.ICPrescaler = TIM_ICPSC_DIV1;
 	GearChannelICConfig.ICFilter = 0;
-	GearChannelICConfig.ICPolarity = TIM_ICPOLARITY_RISING;
+	GearChannelICConfig.ICPolarity = RECEIVER_PWM_IC_POLARITY;
 	GearChannelICConfig.ICSelection = TIM_ICSELECTION_DIRECTTI;
 	/* Configure the Input Capture of gear channel */
 	if (HAL_TIM_IC_ConfigChannel(&AuxReceiverTimHandle, &GearChannelICConfig, AUX_RECEIVER_GEAR_CHANNEL) != HAL_OK) {
@@ -1185,7 +1593,7 @@ static ReceiverErrorStatus AuxReceiverInput_Config(void) {
 
 	Aux1ChannelICConfig.ICPrescaler = TIM_ICPSC_DIV1;
 	Aux1ChannelICConfig.ICFilter = 0;
-	Aux1ChannelICConfig.ICPolarity = TIM_ICPOLARITY_RISING;
+	Aux1ChannelICConfig.ICPolarity = RECEIVER_PWM_IC_POLARITY;
 	Aux1ChannelICConfig.ICSelection = TIM_ICSELECTION_DIRECTTI;
 	/* Configure the Input Capture of aux1 channel */
 	if (HAL_TIM_IC_ConfigChannel(&AuxReceiverTimHandle, &Aux1ChannelICConfig, AUX_RECEIVER_AUX1_CHANNEL) != HAL_OK) {
@@ -1207,15 +1615,18 @@ static ReceiverErrorStatus AuxReceiverInput_Config(void) {
 		ErrorHandler();
 	}
 
+#ifndef RECEIVER_PWM_DEFERRED_DECODING
 	/*##-4- Start the Time Base update interrupt mode ##########################*/
 	if (HAL_TIM_Base_Start_IT(&AuxReceiverTimHandle) != HAL_OK) {
 		/* Starting Error */
 		errorStatus = RECEIVER_ERROR;
 		ErrorHandler();
 	}
+#endif
 
 	return errorStatus;
 }
+#endif
 
 /*
  * @brief  Updates a receiver channel IC counts. The channel is specified by the function parameters.
@@ -1225,13 +1636,24 @@ static ReceiverErrorStatus AuxReceiverInput_Config(void) {
  * @param  ChannelICValues : Reference to the channels IC value struct
  * @param  receiverChannel : TIM Channel
  * @param  ReceiverTimerPeriodCount : Reference to the timer period count variable (primary or aux)
- * @param  ChannelCalibrationSampling : Reference to channel's calibration sampling struct
  * @retval RECEIVER_OK if valid pulse or period detected, else RECEIVER_ERROR
  */
 static ReceiverErrorStatus UpdateReceiverChannel(TIM_HandleTypeDef* TimHandle, TIM_IC_InitTypeDef* TimIC,
 		Pulse_State* channelInputState, volatile Receiver_IC_Values_TypeDef* ChannelICValues,
-		const uint32_t receiverChannel, volatile const uint16_t ReceiverTimerPeriodCount,
-		volatile Receiver_ChannelCalibrationSampling_TypeDef* ChannelCalibrationSampling) {
+		const uint32_t receiverChannel, volatile const uint16_t ReceiverTimerPeriodCount) {
+#ifdef RECEIVER_PWM_DEFERRED_DECODING
+	uint8_t nextEdgeHead = (ChannelICValues->EdgeHead + 1) % RECEIVER_PWM_EDGE_BUFFER_SIZE;
+
+	/* Both edges are captured, only store the edge count for ReceiverPWMDecodeTask. If the buffer is full the edge is
+	 * dropped, and the decoding resynchronizes on the next pulse. */
+	if (nextEdgeHead == ChannelICValues->EdgeTail)
+		return RECEIVER_ERROR;
+
+	ChannelICValues->EdgeCounts[ChannelICValues->EdgeHead] = HAL_TIM_ReadCapturedValue(TimHandle, receiverChannel);
+	ChannelICValues->EdgeHead = nextEdgeHead;
+
+	return RECEIVER_OK;
+#else
 	ReceiverErrorStatus errorStatus = RECEIVER_OK;
 
 	/* Detected rising pulse edge */
@@ -1284,17 +1706,7 @@ static ReceiverErrorStatus UpdateReceiverChannel(TIM_HandleTypeDef* TimHandle, T
 		/* Sanity check of pulse count before updating it */
 		if (IS_RECEIVER_PULSE_VALID(tempPulseTimerCount, ReceiverTimerPeriodCount,
 				ChannelICValues->PreviousRisingCountTimerPeriodCount)) {
-			ChannelICValues->PulseTimerCount = tempPulseTimerCount;
-			ChannelICValues->IsActive = RECEIVER_OK; // Set channel to active
-
-			/* Check if calibration is being performed */
-			if (receiverCalibrationState == RECEIVER_CALIBRATION_IN_PROGRESS) {
-				/* Check if max calibration time has been reached (time out) */
-				if (HAL_GetTick() > RECEIVER_MAX_CALIBRATION_DURATION + receiverCalibrationStartTime)
-					receiverCalibrationState = RECEIVER_CALIBRATION_WAITING;
-				else
-					UpdateChannelCalibrationSamples(ChannelCalibrationSampling, tempPulseTimerCount);
-			}
+			UpdateChannelPulse(ChannelICValues, tempPulseTimerCount);
 		} else
 			errorStatus = RECEIVER_ERROR;
 	}
@@ -1303,53 +1715,265 @@ static ReceiverErrorStatus UpdateReceiverChannel(TIM_HandleTypeDef* TimHandle, T
 	ReceiverToggleICPolarity(TimHandle, TimIC, receiverChannel);
 
 	return errorStatus;
+#endif
 }
 
 /*
- * @brief  Updates the receiver channel's calibration samples
- * @param  channelCalibrationSampling : calibration sampling struct
+ * @brief  Updates a receiver channel IC values from a frame channel
+ * @param  ChannelICValues : Reference to the channels IC value struct
+ * @param  channelPulseTicks : Channel pulse widths of the frame in receiver timer ticks
+ * @param  nbrOfChannels : Number of channels in the frame
+ * @param  frameChannel : Frame channel carrying the receiver channel
+ * @param  framePeriodTicks : Time since the previous frame in receiver timer ticks
+ * @retval RECEIVER_OK if the frame had a valid pulse for the channel, else RECEIVER_ERROR
+ */
+static ReceiverErrorStatus UpdateReceiverFrameChannel(volatile Receiver_IC_Values_TypeDef* ChannelICValues,
+		const uint16_t* channelPulseTicks, const uint8_t nbrOfChannels, const uint8_t frameChannel,
+		const uint32_t framePeriodTicks) {
+	uint16_t pulseTimerCount;
+
+	if (frameChannel >= nbrOfChannels)
+		return RECEIVER_ERROR;
+
+	pulseTimerCount = channelPulseTicks[frameChannel];
+	if (pulseTimerCount > RECEIVER_MAX_VALID_IC_PULSE_COUNT || pulseTimerCount < RECEIVER_MIN_VALID_IC_PULSE_COUNT)
+		return RECEIVER_ERROR;
+
+	ChannelICValues->PeriodCount = framePeriodTicks;
+	UpdateChannelPulse(ChannelICValues, pulseTimerCount);
+
+	return RECEIVER_OK;
+}
+
+/*
+ * @brief  Sets a new valid pulse of a receiver channel and publishes the receiver snapshot when the frame is complete
+ * @param  ChannelICValues : Reference to the channels IC value struct
  * @param  channelPulseTimerCount : The pulse count value
- * @retval RECEIVER_OK if updated correctly
+ * @retval None
  */
-static ReceiverErrorStatus UpdateChannelCalibrationSamples(
-		volatile Receiver_ChannelCalibrationSampling_TypeDef* channelCalibrationSampling,
+static void UpdateChannelPulse(volatile Receiver_IC_Values_TypeDef* ChannelICValues,
 		const uint16_t channelPulseTimerCount) {
-	uint16_t i;
-
-	/* # Find the min value in the buffer containing the max values ########### */
-	if (channelCalibrationSampling->maxBufferUpdated) {
-		for (i = 0; i < RECEIVER_CALIBRATION_SAMPLES_BUFFER_SIZE; i++) {
-			if (channelCalibrationSampling->tmpMaxBufferMinValue > channelCalibrationSampling->maxSamplesBuffer[i]) {
-				channelCalibrationSampling->tmpMaxBufferMinValue = channelCalibrationSampling->maxSamplesBuffer[i];
-				channelCalibrationSampling->tmpMaxIndex = i;
-				channelCalibrationSampling->maxBufferUpdated = false;
-			}
+	uint32_t timestamp = GetTimestamp();
+	uint32_t pulsePeriod = timestamp - ChannelICValues->LastPulseTimestamp;
+
+	ChannelICValues->PulseTimerCount = channelPulseTimerCount;
+	ChannelICValues->IsActive = RECEIVER_OK; // Set channel to active
+
+	/* Update the link quality counters, a period spanning a dropout is not filtered */
+	if (ChannelICValues->PulseCount > 0 && pulsePeriod < RECEIVER_FAILSAFE_TIMEOUT_CYCLES) {
+		if (0 == ChannelICValues->PulsePeriod)
+			ChannelICValues->PulsePeriod = pulsePeriod;
+		else
+			ChannelICValues->PulsePeriod += ((int32_t) (pulsePeriod - ChannelICValues->PulsePeriod))
+					>> RECEIVER_LINK_PERIOD_FILTER_SHIFT;
+	}
+	ChannelICValues->LastPulseTimestamp = timestamp;
+	ChannelICValues->PulseCount++;
+
+	/* The frame is complete when all channels have updated. A channel updating twice first means another channel
+	 * missed the frame, then the frame is published with the missing channel's previous value. */
+	if (receiverSnapshotPendingFlags & ChannelICValues->SnapshotFlag) {
+		PublishReceiverSnapshot(receiverSnapshotPendingFlags);
+		receiverSnapshotPendingFlags = 0;
+	}
+	receiverSnapshotPendingFlags |= ChannelICValues->SnapshotFlag;
+	if (RECEIVER_SNAPSHOT_ALL_FLAGS == receiverSnapshotPendingFlags) {
+		PublishReceiverSnapshot(receiverSnapshotPendingFlags);
+		receiverSnapshotPendingFlags = 0;
+	}
+}
+
+/*
+ * @brief  Normalizes the receiver channels and publishes them as the latest receiver snapshot
+ * @param  updatedChannels : RECEIVER_SNAPSHOT_*_FLAG bits of the channels that have updated in the frame
+ * @retval None
+ */
+static void PublishReceiverSnapshot(const uint8_t updatedChannels) {
+	volatile const Receiver_ChannelMap_TypeDef* channelMap = &channelMaps[channelMapIndex];
+	Receiver_Snapshot_TypeDef snapshot;
+	int16_t channelValues[RECEIVER_SNAPSHOT_CHANNELS_NBR];
+	uint32_t nextSequence = receiverSnapshotSequence + 1;
+	uint8_t i;
+
+	for (i = 0; i < RECEIVER_SNAPSHOT_CHANNELS_NBR; i++) {
+		if (!(updatedChannels & (1 << i)))
+			receiverICValues[i]->DropoutCount++;
+	}
+	receiverFrameCount++;
+
+	/* Only a frame with all channels restarts the failsafe watchdog, also if the missing channel is still active */
+	if (RECEIVER_SNAPSHOT_ALL_FLAGS == updatedChannels) {
+		__HAL_TIM_SetCounter(&ReceiverFailsafeTimHandle, 0);
+		receiverCompleteFrameTimestamp = GetTimestamp();
+		__DMB();
+		receiverFailsafe = false;
+	}
+
+	for (i = 0; i < RECEIVER_SNAPSHOT_CHANNELS_NBR; i++) {
+		channelValues[i] = GetMappedReceiverChannel(channelMap, i);
+#if (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_PWM)
+		snapshot.PulseTicks[i] = receiverICValues[channelMap->Inputs[i]]->PulseTimerCount;
+#else
+		snapshot.PulseTicks[i] = receiverICValues[i]->PulseTimerCount;
+#endif
+	}
+	snapshot.Throttle = channelValues[RECEIVER_SNAPSHOT_THROTTLE];
+	snapshot.Aileron = channelValues[RECEIVER_SNAPSHOT_AILERON];
+	snapshot.Elevator = channelValues[RECEIVER_SNAPSHOT_ELEVATOR];
+	snapshot.Rudder = channelValues[RECEIVER_SNAPSHOT_RUDDER];
+	snapshot.Gear = channelValues[RECEIVER_SNAPSHOT_GEAR];
+	snapshot.Aux1 = channelValues[RECEIVER_SNAPSHOT_AUX1];
+	snapshot.Mode = EvaluateReceiverModeRanges(channelMap, channelValues);
+	snapshot.UpdatedChannels = updatedChannels;
+	snapshot.IsActive = IsReceiverActive();
+	snapshot.Timestamp = (uint32_t) GetMicroseconds();
+	snapshot.FrameTimestamp = GetTimestamp();
+	snapshot.Sequence = nextSequence;
+
+	receiverSnapshots[nextSequence & 1] = snapshot;
+	__DMB();
+	receiverSnapshotSequence = nextSequence;
+
+	/* Samples only the channels that have updated in the frame */
+	if (receiverCalibrationState == RECEIVER_CALIBRATION_IN_PROGRESS) {
+		for (i = 0; i < RECEIVER_SNAPSHOT_CHANNELS_NBR; i++) {
+			if (updatedChannels & (1 << i))
+				UpdateChannelCalibrationSamples(calibrationSamplings[i], snapshot.PulseTicks[i]);
 		}
 	}
+}
 
-	/* If the pulse value is larger than the min value of the max value buffer, replace it */
-	if (channelPulseTimerCount > channelCalibrationSampling->tmpMaxBufferMinValue) {
-		channelCalibrationSampling->tmpMaxBufferMinValue = 0xFFFF;
-		channelCalibrationSampling->maxSamplesBuffer[channelCalibrationSampling->tmpMaxIndex] = channelPulseTimerCount;
-		channelCalibrationSampling->maxBufferUpdated = true;
+/*
+ * @brief  Loads the channel map from flash, or the default map if there is none or it is invalid
+ * @param  None
+ * @retval None
+ */
+static void InitReceiverChannelMap(void) {
+	Receiver_ChannelMap_TypeDef channelMap;
+
+	if (!ReadReceiverChannelMapFromFlash(&channelMap) || !IsChannelMapValid(&channelMap))
+		GetDefaultReceiverChannelMap(&channelMap);
+
+	channelMaps[0] = channelMap;
+	channelMapIndex = 0;
+}
+
+/*
+ * @brief  Checks that the inputs exist and that the used mode ranges have a receiver channel, a known mode and
+ *         limits within [-100, 100] %
+ * @param  channelMap : The channel map
+ * @retval RECEIVER_OK if valid, else RECEIVER_ERROR
+ */
+static ReceiverErrorStatus IsChannelMapValid(const Receiver_ChannelMap_TypeDef* channelMap) {
+#if (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_PWM)
+	const uint8_t nbrOfInputs = RECEIVER_SNAPSHOT_CHANNELS_NBR;
+#else
+	const uint8_t nbrOfInputs = RECEIVER_MAX_CHANNELS;
+#endif
+	const Receiver_ModeRange_TypeDef* range;
+	uint8_t i;
+
+	for (i = 0; i < RECEIVER_SNAPSHOT_CHANNELS_NBR; i++) {
+		if (channelMap->Inputs[i] >= nbrOfInputs)
+			return RECEIVER_ERROR;
 	}
 
-	/* # Find the max value in the buffer containing the min values ########### */
-	if (channelCalibrationSampling->minBufferUpdated) {
-		for (i = 0; i < RECEIVER_CALIBRATION_SAMPLES_BUFFER_SIZE; i++) {
-			if (channelCalibrationSampling->tmpMinBufferMaxValue < channelCalibrationSampling->minSamplesBuffer[i]) {
-				channelCalibrationSampling->tmpMinBufferMaxValue = channelCalibrationSampling->minSamplesBuffer[i];
-				channelCalibrationSampling->tmpMinIndex = i;
-				channelCalibrationSampling->minBufferUpdated = false;
-			}
+	if (channelMap->ReversedChannels & ~RECEIVER_SNAPSHOT_ALL_FLAGS)
+		return RECEIVER_ERROR;
+
+	for (i = 0; i < RECEIVER_MODE_RANGES_NBR; i++) {
+		range = &channelMap->ModeRanges[i];
+		if (range->Mode >= RECEIVER_MODE_NBR)
+			return RECEIVER_ERROR;
+		if (RECEIVER_MODE_NONE != range->Mode && (range->Channel >= RECEIVER_SNAPSHOT_CHANNELS_NBR
+				|| range->MinPercent < -100 || range->MaxPercent > 100 || range->MinPercent > range->MaxPercent))
+			return RECEIVER_ERROR;
+	}
+
+	return RECEIVER_OK;
+}
+
+/*
+ * @brief  Returns the normalized value of a receiver function from its mapped input, reversed if set. For the
+ *         frame protocols the frame channel of the input is already decoded into the function's own IC values.
+ * @param  channelMap : The channel map
+ * @param  receiverChannel : Receiver function, as the snapshot channels
+ * @retval channel value [-32768, 32767]
+ */
+static int16_t GetMappedReceiverChannel(volatile const Receiver_ChannelMap_TypeDef* channelMap,
+		const uint8_t receiverChannel) {
+#if (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_PWM)
+	uint8_t input = channelMap->Inputs[receiverChannel];
+#else
+	uint8_t input = receiverChannel;
+#endif
+	int16_t value = GetSignedReceiverChannel(receiverICValues[input], channelCalibrationValues[input]);
+
+	/* The ones' complement maps [-32768, 32767] onto itself reversed */
+	if (channelMap->ReversedChannels & (1 << receiverChannel))
+		value = ~value;
+
+	return value;
+}
+
+/*
+ * @brief  Evaluates the mode ranges, each active while its channel is within its limits. The first active mode
+ *         range selects the mode, and if there are arm ranges, one of them must be active too.
+ * @param  channelMap : The channel map with the mode ranges
+ * @param  channelValues : Normalized channel values, as the snapshot channels
+ * @retval The mode, RECEIVER_MODE_NONE if no mode range is active or no arm range is
+ */
+static ReceiverModeType EvaluateReceiverModeRanges(volatile const Receiver_ChannelMap_TypeDef* channelMap,
+		const int16_t channelValues[RECEIVER_SNAPSHOT_CHANNELS_NBR]) {
+	ReceiverModeType mode = RECEIVER_MODE_NONE;
+	bool hasArmRange = false;
+	bool isArmed = false;
+	bool isActive;
+	int32_t percent;
+	uint8_t i;
+
+	for (i = 0; i < RECEIVER_MODE_RANGES_NBR; i++) {
+		volatile const Receiver_ModeRange_TypeDef* range = &channelMap->ModeRanges[i];
+
+		if (RECEIVER_MODE_NONE == range->Mode)
+			continue;
+
+		/* Rounded to the nearest percent, so that both ends of the channel range reach +/-100 % */
+		percent = (int32_t) channelValues[range->Channel] * 100;
+		percent = (percent + (percent < 0 ? -(1 << 14) : (1 << 14))) / (1 << 15);
+		isActive = (percent >= range->MinPercent && percent <= range->MaxPercent);
+
+		if (RECEIVER_MODE_ARM == range->Mode) {
+			hasArmRange = true;
+			isArmed = isArmed || isActive;
+		} else if (isActive && RECEIVER_MODE_NONE == mode) {
+			mode = (ReceiverModeType) range->Mode;
 		}
 	}
 
-	/* If the pulse value is larger than the min value of the max value buffer, replace it */
-	if (channelPulseTimerCount < channelCalibrationSampling->tmpMinBufferMaxValue) {
-		channelCalibrationSampling->tmpMinBufferMaxValue = 0;
-		channelCalibrationSampling->minSamplesBuffer[channelCalibrationSampling->tmpMinIndex] = channelPulseTimerCount;
-		channelCalibrationSampling->minBufferUpdated = true;
+	return (!hasArmRange || isArmed) ? mode : RECEIVER_MODE_NONE;
+}
+
+/*
+ * @brief  Updates the receiver channel's calibration samples
+ * @param  channelCalibrationSampling : calibration sampling struct
+ * @param  channelPulseTimerCount : The pulse count value
+ * @retval RECEIVER_OK if updated correctly
+ */
+static ReceiverErrorStatus UpdateChannelCalibrationSamples(
+		volatile Receiver_ChannelCalibrationSampling_TypeDef* channelCalibrationSampling,
+		const uint16_t channelPulseTimerCount) {
+	uint32_t scaledPulseCount = (uint32_t) channelPulseTimerCount << RECEIVER_CALIBRATION_ESTIMATE_SHIFT;
+
+	/* The extreme estimates move a fraction of the way towards pulses beyond them and never back. A single glitch
+	 * pulse hardly moves them, while a stick held at its end position for a few frames is tracked. */
+	if (scaledPulseCount > channelCalibrationSampling->maxPulseEstimate) {
+		channelCalibrationSampling->maxPulseEstimate += (scaledPulseCount - channelCalibrationSampling->maxPulseEstimate)
+				>> RECEIVER_CALIBRATION_ESTIMATE_ATTACK_SHIFT;
+	}
+	if (scaledPulseCount < channelCalibrationSampling->minPulseEstimate) {
+		channelCalibrationSampling->minPulseEstimate -= (channelCalibrationSampling->minPulseEstimate - scaledPulseCount)
+				>> RECEIVER_CALIBRATION_ESTIMATE_ATTACK_SHIFT;
 	}
 
 	/* Check if stick is in its mid position and during the first seconds of calibration sampling */
@@ -1366,6 +1990,7 @@ static ReceiverErrorStatus UpdateChannelCalibrationSamples(
 	return RECEIVER_OK;
 }
 
+#if (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_PWM)
 /*
  * @brief  Checks if the RC transmission between transmitter and receiver is active for a specified channel.
  * @param  ChannelICValues : Reference to a channel's IC values struct
@@ -1374,6 +1999,12 @@ static ReceiverErrorStatus UpdateChannelCalibrationSamples(
  */
 static ReceiverErrorStatus IsReceiverChannelActive(volatile Receiver_IC_Values_TypeDef* ChannelICValues,
 		const uint16_t ReceiverTimerPeriodCount) {
+#ifdef RECEIVER_PWM_DEFERRED_DECODING
+	/* The timer update interrupts are not used, so the time since the last decoded pulse is checked instead */
+	(void) ReceiverTimerPeriodCount;
+	if ((uint32_t) GetMicroseconds() - ChannelICValues->LastPulseTime > RECEIVER_PWM_CHANNEL_INACTIVE_TIMEOUT*1000)
+		ChannelICValues->IsActive = RECEIVER_ERROR;
+#else
 	uint32_t periodsSinceLastChannelPulse;
 
 	/* Check how many timer resets have been performed since the last rising pulse edge */
@@ -1382,9 +2013,11 @@ static ReceiverErrorStatus IsReceiverChannelActive(volatile Receiver_IC_Values_T
 	/* Set channel as inactive if too many periods have passed since last channel pulse update */
 	if (periodsSinceLastChannelPulse > IS_RECEIVER_CHANNEL_INACTIVE_PERIODS_COUNT)
 		ChannelICValues->IsActive = RECEIVER_ERROR;
+#endif
 
 	return ChannelICValues->IsActive;
 }
+#endif
 
 /*
  * @brief  Checks if receiver calibration values are valid
@@ -1472,25 +2105,18 @@ static void EnforceNewCalibrationValues(volatile Receiver_CalibrationValues_Type
 static void ResetCalibrationSampling(volatile Receiver_ChannelCalibrationSampling_TypeDef* channelCalibrationSampling) {
 	channelCalibrationSampling->channelCalibrationPulseSamples = 0;
 
-	/* Reset max values sampling */
-	channelCalibrationSampling->maxBufferUpdated = false;
-	for(uint16_t i = 0; i < RECEIVER_CALIBRATION_SAMPLES_BUFFER_SIZE; i++)
-		channelCalibrationSampling->maxSamplesBuffer[i] = RECEIVER_CALIBRATION_BUFFER_INIT_VALUE;
-	channelCalibrationSampling->tmpMaxBufferMinValue = RECEIVER_CALIBRATION_BUFFER_INIT_VALUE;
-	channelCalibrationSampling->tmpMaxIndex = 0;
-
-	/* Reset min values sampling */
-	channelCalibrationSampling->minBufferUpdated = false;
-	for(uint16_t i = 0; i < RECEIVER_CALIBRATION_SAMPLES_BUFFER_SIZE; i++)
-			channelCalibrationSampling->minSamplesBuffer[i] = RECEIVER_CALIBRATION_BUFFER_INIT_VALUE;
-	channelCalibrationSampling->tmpMinBufferMaxValue = RECEIVER_CALIBRATION_BUFFER_INIT_VALUE;
-	channelCalibrationSampling->tmpMinIndex = 0;
+	/* Reset the extreme estimates, they start from the mid of the default pulse range */
+	channelCalibrationSampling->maxPulseEstimate = (uint32_t) RECEIVER_CALIBRATION_BUFFER_INIT_VALUE
+			<< RECEIVER_CALIBRATION_ESTIMATE_SHIFT;
+	channelCalibrationSampling->minPulseEstimate = (uint32_t) RECEIVER_CALIBRATION_BUFFER_INIT_VALUE
+			<< RECEIVER_CALIBRATION_ESTIMATE_SHIFT;
 
 	/* Reset mid values sampling */
 	channelCalibrationSampling->midPulseSamplesCount = 0;
 	channelCalibrationSampling->midSamplesPulseSum = 0;
 }
 
+#ifndef RECEIVER_PWM_DEFERRED_DECODING
 /**
  * @brief  Toggles the IC polarity
  * @param  htim : timer handle reference
@@ -1570,40 +2196,104 @@ static void ReceiverToggleICPolarity(TIM_HandleTypeDef* htim, TIM_IC_InitTypeDef
 	/* Enable the Input Capture channel */
 	TIM_CCxChannelCmd(htim->Instance, Channel, TIM_CCx_ENABLE);
 }
+#else
+/*
+ * @brief  Decodes the edge counts a capture interrupt has stored for a receiver channel. Both edges are captured, so
+ *         the edge polarity is told from the interval before it: only the high phase of the signal is within the
+ *         valid pulse range, the low phase is the rest of the ~22 ms period.
+ * @param  ChannelICValues : Reference to the channels IC value struct
+ * @param  counterMask : Max value of the channel's TIM counter
+ * @param  tickMultiplier : Receiver timer ticks per count of the channel's TIM counter
+ * @retval None
+ */
+static void DecodeReceiverChannelEdges(volatile Receiver_IC_Values_TypeDef* ChannelICValues,
+		const uint32_t counterMask, const uint32_t tickMultiplier) {
+	uint32_t edgeCount;
+	uint32_t intervalTimerCount;
+	uint32_t periodTimerCount;
+
+	while (ChannelICValues->EdgeTail != ChannelICValues->EdgeHead) {
+		edgeCount = ChannelICValues->EdgeCounts[ChannelICValues->EdgeTail];
+		ChannelICValues->EdgeTail = (ChannelICValues->EdgeTail + 1) % RECEIVER_PWM_EDGE_BUFFER_SIZE;
+
+		if (ChannelICValues->HasPreviousEdge) {
+			intervalTimerCount = ((edgeCount - ChannelICValues->PreviousEdgeCount) & counterMask) * tickMultiplier;
+
+			/* A valid pulse means the previous edge was rising and this edge is falling */
+			if (intervalTimerCount <= RECEIVER_MAX_VALID_IC_PULSE_COUNT
+					&& intervalTimerCount >= RECEIVER_MIN_VALID_IC_PULSE_COUNT) {
+				if (ChannelICValues->HasDecodedRising) {
+					periodTimerCount = ((ChannelICValues->PreviousEdgeCount - ChannelICValues->DecodedRisingCount)
+							& counterMask) * tickMultiplier;
+					if (IS_RECEIVER_PERIOD_VALID(periodTimerCount))
+						ChannelICValues->PeriodCount = periodTimerCount;
+				}
+				ChannelICValues->DecodedRisingCount = ChannelICValues->PreviousEdgeCount;
+				ChannelICValues->HasDecodedRising = true;
+
+				ChannelICValues->LastPulseTime = (uint32_t) GetMicroseconds();
+				UpdateChannelPulse(ChannelICValues, intervalTimerCount);
+			}
+		}
+
+		ChannelICValues->PreviousEdgeCount = edgeCount;
+		ChannelICValues->HasPreviousEdge = true;
+	}
+}
 
 /**
- * @brief  Task code handles receiver print sampling
+ * @brief  Task code decodes the PWM edge counts of all receiver channels
  * @param  argument : Unused parameter
  * @retval None
  */
-static void ReceiverPrintSamplingTask(void const *argument) {
+static void ReceiverPWMDecodeTask(void const *argument) {
 	(void) argument;
 
 	portTickType xLastWakeTime;
-	portTickType xSampleStartTime;
 
 	/* Initialise the xLastWakeTime variable with the current time */
 	xLastWakeTime = xTaskGetTickCount();
-	xSampleStartTime = xLastWakeTime;
-
-	if(receiverCalibrationState == RECEIVER_CALIBRATION_IN_PROGRESS)
-		USBComSendString("Set RC transmitter sticks to middle positions\r\n");
+	TaskWatchdogRegister(TASK_WATCHDOG_RECEIVER);
 
 	for (;;) {
-		vTaskDelayUntil(&xLastWakeTime, receiverPrintSampleTime);
+		vTaskDelayUntil(&xLastWakeTime, RECEIVER_PWM_DECODE_PERIOD / portTICK_RATE_MS);
+		TaskWatchdogCheckIn(TASK_WATCHDOG_RECEIVER);
+
+		DecodeReceiverChannelEdges(&ThrottleICValues, RECEIVER_PWM_PRIMARY_COUNTER_PERIOD, 1);
+		DecodeReceiverChannelEdges(&AileronICValues, RECEIVER_PWM_PRIMARY_COUNTER_PERIOD, 1);
+		DecodeReceiverChannelEdges(&ElevatorICValues, RECEIVER_PWM_PRIMARY_COUNTER_PERIOD, 1);
+		DecodeReceiverChannelEdges(&RudderICValues, RECEIVER_PWM_PRIMARY_COUNTER_PERIOD, 1);
+		DecodeReceiverChannelEdges(&GearICValues, RECEIVER_COUNTER_PERIOD,
+				RECEIVER_PWM_AUX_TICK_MULTIPLIER);
+		DecodeReceiverChannelEdges(&Aux1ICValues, RECEIVER_COUNTER_PERIOD,
+				RECEIVER_PWM_AUX_TICK_MULTIPLIER);
+	}
+}
+#endif
 
-		/* Check if calibrating and if so, check that each stick channel has collected enough pulse samples when sticks were centered */
-		if (receiverCalibrationState == RECEIVER_CALIBRATION_IN_PROGRESS && !receiverCalibrationStartSaturatingMessageSent
-				&& ThrottleCalibrationSampling.midPulseSamplesCount >= RECEIVER_CALIBRATION_MIN_MID_PULSE_COUNT && AileronCalibrationSampling.midPulseSamplesCount >= RECEIVER_CALIBRATION_MIN_MID_PULSE_COUNT && ElevatorCalibrationSampling.midPulseSamplesCount >= RECEIVER_CALIBRATION_MIN_MID_PULSE_COUNT && RudderCalibrationSampling.midPulseSamplesCount >= RECEIVER_CALIBRATION_MIN_MID_PULSE_COUNT) {
-			USBComSendString("\n\nStart saturating RC transmitter sticks and switches\n\n\r\n");
-			receiverCalibrationStartSaturatingMessageSent = true;
-		}
+/**
+ * @brief  Rate group job that times out the receiver calibration, and asks for the sticks and switches to be saturated
+ *         once the sticks have been sampled centered
+ * @param  argument : Unused parameter
+ * @retval None
+ */
+static void ReceiverCalibrationStep(void* argument) {
+	(void) argument;
 
-		PrintReceiverValues();
+	if (receiverCalibrationState != RECEIVER_CALIBRATION_IN_PROGRESS)
+		return;
+
+	/* Check if max calibration time has been reached (time out) */
+	if (HAL_GetTick() > RECEIVER_MAX_CALIBRATION_DURATION + receiverCalibrationStartTime) {
+		receiverCalibrationState = RECEIVER_CALIBRATION_WAITING;
+		return;
+	}
 
-		/* If sampling duration exceeded, delete task to stop sampling */
-		if (xTaskGetTickCount() >= xSampleStartTime + receiverPrintSampleDuration * configTICK_RATE_HZ)
-			StopReceiverSamplingTask();
+	/* Check that each stick channel has collected enough pulse samples when sticks were centered */
+	if (!receiverCalibrationStartSaturatingMessageSent
+			&& ThrottleCalibrationSampling.midPulseSamplesCount >= RECEIVER_CALIBRATION_MIN_MID_PULSE_COUNT && AileronCalibrationSampling.midPulseSamplesCount >= RECEIVER_CALIBRATION_MIN_MID_PULSE_COUNT && ElevatorCalibrationSampling.midPulseSamplesCount >= RECEIVER_CALIBRATION_MIN_MID_PULSE_COUNT && RudderCalibrationSampling.midPulseSamplesCount >= RECEIVER_CALIBRATION_MIN_MID_PULSE_COUNT) {
+		USBComSendString("\n\nStart saturating RC transmitter sticks and switches\n\n\r\n");
+		receiverCalibrationStartSaturatingMessageSent = true;
 	}
 }
 
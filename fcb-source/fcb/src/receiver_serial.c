@@ -0,0 +1,442 @@
+/******************************************************************************
+ * @brief   File contains functionality for reading RC receivers that send all
+ *          channels on one signal: PPM-sum, Futaba SBUS and Spektrum DSM
+ *          satellites. RECEIVER_INPUT_PROTOCOL in receiver.h selects which one
+ *          is connected, instead of the separate PWM channels.
+ *
+ *          _SBUS AND DSM_
+ *          The receiver UART writes every received byte to a ring buffer with
+ *          circular DMA. No interrupt fires until the line goes idle after a
+ *          frame, so each frame costs a single interrupt, in which the bytes
+ *          received since the previous idle line are decoded as one frame.
+ *          Frames of the wrong size, e.g. after a reception error, are dropped.
+ *
+ *          _PPM-SUM_
+ *          The channels are sent as the intervals between pulses on one pin,
+ *          followed by a longer gap that ends the frame. The primary receiver
+ *          TIM captures one edge per channel on its throttle channel input.
+ *
+ *          Decoded channels are converted to receiver TIM ticks, i.e. the pulse
+ *          widths a PWM receiver would output, and passed on to receiver.c.
+ *
+ * @license
+ * Dragonfly FCB firmware to control the Dragonfly quadrotor UAV
+ * Copyright (C) 2016  ÅF Technology South: Dragonfly Project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ *****************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "receiver_serial.h"
+
+#include "common.h"
+#include "fcb_error.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "stm32f3xx_hal.h"
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private define ------------------------------------------------------------*/
+#define RECEIVER_TICKS_PER_US           (RECEIVER_TIM_COUNTER_CLOCK/1000000)
+#define SERIAL_RECEIVER_MAX_FRAME_SIZE  SBUS_FRAME_SIZE
+
+#define SERIAL_RECEIVER_UART_ERROR_FLAGS    (UART_FLAG_PE | UART_FLAG_FE | UART_FLAG_NE | UART_FLAG_ORE)
+#define SERIAL_RECEIVER_UART_ERROR_CLEAR    (UART_CLEAR_PEF | UART_CLEAR_FEF | UART_CLEAR_NEF | UART_CLEAR_OREF)
+
+/* Private macro -------------------------------------------------------------*/
+
+/* SBUS 172..1811 spans 1000 us +/-512 us with 0.625 us per step */
+#define SBUS_VALUE_TO_PULSE_TICKS(VALUE)        ((uint16_t) ((7040 + 5*(uint32_t) (VALUE)) * RECEIVER_TICKS_PER_US / 8))
+
+/* DSM values span 903..2103 us, with 1024 or 2048 steps */
+#define DSM_1024_VALUE_TO_PULSE_TICKS(VALUE)    ((uint16_t) ((903*1024 + 1200*(uint32_t) (VALUE)) * RECEIVER_TICKS_PER_US / 1024))
+#define DSM_2048_VALUE_TO_PULSE_TICKS(VALUE)    ((uint16_t) ((903*2048 + 1200*(uint32_t) (VALUE)) * RECEIVER_TICKS_PER_US / 2048))
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Latest channel pulse widths [receiver TIM ticks], written by the interrupt that completes a frame */
+static volatile uint16_t channelPulseTicks[RECEIVER_MAX_CHANNELS];
+static volatile uint8_t nbrOfFrameChannels;
+
+static volatile uint32_t lastFrameTime;         // [us] Low word of GetMicroseconds() at the latest valid frame
+static volatile uint32_t lastFrameTimestamp;    // [core clock cycles] see GetTimestamp()
+static volatile bool frameReceived = false;
+static volatile bool receiverFailsafe = false;
+
+#if RECEIVER_INPUT_IS_UART
+/* Circular DMA ring buffer and the position the latest frame ended at */
+static uint8_t uartRxBuffer[SERIAL_RECEIVER_DMA_BUFFER_SIZE];
+static uint16_t uartRxReadIndex = 0;
+#elif (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_PPM)
+/* Channels of the PPM-sum frame in progress */
+static uint16_t ppmChannelPulseTicks[RECEIVER_MAX_CHANNELS];
+static uint8_t ppmChannelIndex = 0;
+static bool ppmFrameValid = false;
+static uint32_t ppmPreviousCaptureCount;
+static uint32_t ppmFrameStartCount;
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+#if (RECEIVER_INPUT_PROTOCOL != RECEIVER_PROTOCOL_PWM)
+static void PublishFrame(const uint8_t nbrOfChannels, const uint32_t framePeriodTicks);
+#endif
+
+#if RECEIVER_INPUT_IS_UART
+static ReceiverErrorStatus SerialReceiverUartConfig(void);
+static void HandleUartFrame(const uint8_t* frame, const uint16_t frameSize);
+#if (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_SBUS)
+static void HandleSbusFrame(const uint8_t* frame);
+#else
+static void HandleDsmFrame(const uint8_t* frame);
+#endif
+#elif (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_PPM)
+static ReceiverErrorStatus PPMReceiverInputConfig(void);
+#endif
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Initializes the input of the receiver selected by RECEIVER_INPUT_PROTOCOL
+ * @param  None
+ * @retval RECEIVER_OK if configured without errors, else RECEIVER_ERROR
+ */
+ReceiverErrorStatus SerialReceiverInputConfig(void) {
+#if RECEIVER_INPUT_IS_UART
+	return SerialReceiverUartConfig();
+#elif (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_PPM)
+	return PPMReceiverInputConfig();
+#else
+	return RECEIVER_ERROR;
+#endif
+}
+
+/*
+ * @brief  Checks if the serial receiver is receiving valid frames from the transmitter
+ * @param  None
+ * @retval RECEIVER_OK if transmission is active, else RECEIVER_ERROR
+ */
+ReceiverErrorStatus IsSerialReceiverActive(void) {
+	if (!frameReceived || receiverFailsafe)
+		return RECEIVER_ERROR;
+
+	if ((uint32_t) GetMicroseconds() - lastFrameTime > SERIAL_RECEIVER_INACTIVE_TIMEOUT*1000)
+		return RECEIVER_ERROR;
+
+	return RECEIVER_OK;
+}
+
+/*
+ * @brief  Handles the receiver UART interrupt, which is the idle line after each frame
+ * @param  None
+ * @retval None
+ */
+void SerialReceiverUartIRQHandler(void) {
+#if RECEIVER_INPUT_IS_UART
+	uint8_t frame[SERIAL_RECEIVER_MAX_FRAME_SIZE];
+	uint16_t writeIndex;
+	uint16_t frameSize;
+	uint16_t i;
+	bool rxError;
+
+	if (!__HAL_UART_GET_FLAG(&SerialReceiverUartHandle, UART_FLAG_IDLE))
+		return;
+
+	/* Reception errors since the previous idle line belong to this frame */
+	rxError = (SerialReceiverUartHandle.Instance->ISR & SERIAL_RECEIVER_UART_ERROR_FLAGS) != 0;
+	__HAL_UART_CLEAR_IT(&SerialReceiverUartHandle, UART_CLEAR_IDLEF | SERIAL_RECEIVER_UART_ERROR_CLEAR);
+
+	writeIndex = (SERIAL_RECEIVER_DMA_BUFFER_SIZE - SerialReceiverUartHandle.hdmarx->Instance->CNDTR)
+			% SERIAL_RECEIVER_DMA_BUFFER_SIZE;
+	frameSize = (writeIndex + SERIAL_RECEIVER_DMA_BUFFER_SIZE - uartRxReadIndex) % SERIAL_RECEIVER_DMA_BUFFER_SIZE;
+
+	if (!rxError && frameSize <= SERIAL_RECEIVER_MAX_FRAME_SIZE) {
+		for (i = 0; i < frameSize; i++) {
+			frame[i] = uartRxBuffer[(uartRxReadIndex + i) % SERIAL_RECEIVER_DMA_BUFFER_SIZE];
+		}
+		HandleUartFrame(frame, frameSize);
+	}
+
+	uartRxReadIndex = writeIndex;
+#endif
+}
+
+/*
+ * @brief  Handles a PPM-sum input capture, i.e. the end of a channel or of the frame sync gap
+ * @param  None
+ * @retval None
+ */
+void UpdateReceiverPPMChannel(void) {
+#if (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_PPM)
+	uint32_t captureCount = HAL_TIM_ReadCapturedValue(&PrimaryReceiverTimHandle, RECEIVER_PPM_CHANNEL);
+	uint32_t pulseCount = captureCount - ppmPreviousCaptureCount; // 32 bit counter, wraps correctly
+
+	ppmPreviousCaptureCount = captureCount;
+
+	if (pulseCount >= RECEIVER_PPM_SYNC_MIN_COUNT) {
+		/* Sync gap, the frame in progress is complete */
+		if (ppmFrameValid && ppmChannelIndex >= RECEIVER_PPM_MIN_CHANNELS) {
+			memcpy((void*) channelPulseTicks, ppmChannelPulseTicks, ppmChannelIndex * sizeof(uint16_t));
+			PublishFrame(ppmChannelIndex, captureCount - ppmFrameStartCount);
+		}
+
+		ppmFrameStartCount = captureCount;
+		ppmChannelIndex = 0;
+		ppmFrameValid = true;
+	} else if (ppmFrameValid) {
+		/* A missed or extra edge shifts all following channels, so the rest of the frame is dropped */
+		if (ppmChannelIndex < RECEIVER_MAX_CHANNELS && pulseCount <= RECEIVER_MAX_VALID_IC_PULSE_COUNT
+				&& pulseCount >= RECEIVER_MIN_VALID_IC_PULSE_COUNT)
+			ppmChannelPulseTicks[ppmChannelIndex++] = pulseCount;
+		else
+			ppmFrameValid = false;
+	}
+#endif
+}
+
+/*
+ * @brief  Gets the number of channels in the latest frame
+ * @param  None
+ * @retval Number of channels, 0 before the first frame
+ */
+uint8_t GetReceiverNumberOfChannels(void) {
+	return nbrOfFrameChannels;
+}
+
+/*
+ * @brief  Gets the latest pulse width of any frame channel, also those not used by the flight control
+ * @param  channel : Frame channel, 0 = first
+ * @retval Pulse width [receiver TIM ticks], 0 if the channel is not in the frame
+ */
+uint16_t GetReceiverChannelPulseTicks(const uint8_t channel) {
+	if (channel >= nbrOfFrameChannels)
+		return 0;
+
+	return channelPulseTicks[channel];
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+#if (RECEIVER_INPUT_PROTOCOL != RECEIVER_PROTOCOL_PWM)
+/*
+ * @brief  Passes the decoded channels on to the receiver channels and updates the receiver activity
+ * @param  nbrOfChannels : Number of channels in the frame
+ * @param  framePeriodTicks : Time since the previous frame [receiver TIM ticks]
+ * @retval None
+ */
+static void PublishFrame(const uint8_t nbrOfChannels, const uint32_t framePeriodTicks) {
+	nbrOfFrameChannels = nbrOfChannels;
+	lastFrameTime = (uint32_t) GetMicroseconds();
+	frameReceived = true;
+
+	UpdateReceiverChannelsFromFrame((const uint16_t*) channelPulseTicks, nbrOfChannels, framePeriodTicks);
+}
+#endif
+
+#if RECEIVER_INPUT_IS_UART
+/*
+ * @brief  Configures the receiver UART for the selected protocol and starts the circular DMA reception
+ * @param  None
+ * @retval RECEIVER_OK if configured without errors, else RECEIVER_ERROR
+ */
+static ReceiverErrorStatus SerialReceiverUartConfig(void) {
+	SerialReceiverUartHandle.Instance = SERIAL_RECEIVER_UART;
+	SerialReceiverUartHandle.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+	SerialReceiverUartHandle.Init.Mode = UART_MODE_RX;
+
+#if (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_SBUS)
+	/* 8 data bits and even parity */
+	SerialReceiverUartHandle.Init.BaudRate = SBUS_BAUDRATE;
+	SerialReceiverUartHandle.Init.WordLength = UART_WORDLENGTH_9B;
+	SerialReceiverUartHandle.Init.StopBits = UART_STOPBITS_2;
+	SerialReceiverUartHandle.Init.Parity = UART_PARITY_EVEN;
+
+	/* SBUS is inverted, which the USART can undo so that no external inverter is needed */
+	SerialReceiverUartHandle.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_RXINVERT_INIT
+			| UART_ADVFEATURE_RXOVERRUNDISABLE_INIT;
+	SerialReceiverUartHandle.AdvancedInit.RxPinLevelInvert = UART_ADVFEATURE_RXINV_ENABLE;
+#else
+	SerialReceiverUartHandle.Init.BaudRate = DSM_BAUDRATE;
+	SerialReceiverUartHandle.Init.WordLength = UART_WORDLENGTH_8B;
+	SerialReceiverUartHandle.Init.StopBits = UART_STOPBITS_1;
+	SerialReceiverUartHandle.Init.Parity = UART_PARITY_NONE;
+
+	SerialReceiverUartHandle.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_RXOVERRUNDISABLE_INIT;
+#endif
+	/* An overrun must not stop the DMA reception, the frame it corrupted is dropped anyway */
+	SerialReceiverUartHandle.AdvancedInit.OverrunDisable = UART_ADVFEATURE_OVERRUN_DISABLE;
+
+	if (HAL_UART_Init(&SerialReceiverUartHandle) != HAL_OK) {
+		ErrorHandler();
+		return RECEIVER_ERROR;
+	}
+
+	if (HAL_UART_Receive_DMA(&SerialReceiverUartHandle, uartRxBuffer, SERIAL_RECEIVER_DMA_BUFFER_SIZE) != HAL_OK) {
+		ErrorHandler();
+		return RECEIVER_ERROR;
+	}
+
+	/* The ring buffer is read at the idle line only, so the DMA interrupts are not needed */
+	__HAL_DMA_DISABLE_IT(SerialReceiverUartHandle.hdmarx, DMA_IT_HT | DMA_IT_TC | DMA_IT_TE);
+	__HAL_UART_CLEAR_IT(&SerialReceiverUartHandle, UART_CLEAR_IDLEF);
+	__HAL_UART_ENABLE_IT(&SerialReceiverUartHandle, UART_IT_IDLE);
+
+	return RECEIVER_OK;
+}
+
+/*
+ * @brief  Handles the bytes received between two idle lines
+ * @param  frame : Received bytes
+ * @param  frameSize : Number of received bytes
+ * @retval None
+ */
+static void HandleUartFrame(const uint8_t* frame, const uint16_t frameSize) {
+#if (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_SBUS)
+	if (SBUS_FRAME_SIZE == frameSize && SBUS_HEADER_BYTE == frame[0])
+		HandleSbusFrame(frame);
+#else
+	if (DSM_FRAME_SIZE == frameSize)
+		HandleDsmFrame(frame);
+#endif
+}
+
+#if (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_SBUS)
+/*
+ * @brief  Decodes an SBUS frame, 16 channels of 11 bits packed LSB first after the header byte
+ * @param  frame : SBUS frame of SBUS_FRAME_SIZE bytes
+ * @retval None
+ */
+static void HandleSbusFrame(const uint8_t* frame) {
+	uint32_t timestamp = GetTimestamp();
+	uint32_t bits = 0;
+	uint8_t bitCount = 0;
+	uint8_t channel = 0;
+	uint8_t i;
+
+	/* In failsafe the receiver sends its failsafe positions, which are not used */
+	if (frame[SBUS_FLAGS_BYTE] & SBUS_FLAG_FAILSAFE) {
+		receiverFailsafe = true;
+		return;
+	}
+	receiverFailsafe = false;
+
+	for (i = 1; i < SBUS_FLAGS_BYTE && channel < SBUS_NBR_OF_CHANNELS; i++) {
+		bits |= (uint32_t) frame[i] << bitCount;
+		bitCount += 8;
+		if (bitCount >= 11) {
+			channelPulseTicks[channel++] = SBUS_VALUE_TO_PULSE_TICKS(bits & 0x07FF);
+			bits >>= 11;
+			bitCount -= 11;
+		}
+	}
+
+	PublishFrame(SBUS_NBR_OF_CHANNELS,
+			(timestamp - lastFrameTimestamp) / (SystemCoreClock / RECEIVER_TIM_COUNTER_CLOCK));
+	lastFrameTimestamp = timestamp;
+}
+#else
+/*
+ * @brief  Decodes a DSM frame: a fades and a system byte followed by 7 big endian channel words, each holding a
+ *         channel number and value. Frames may carry different channels, the others keep their values.
+ * @param  frame : DSM frame of DSM_FRAME_SIZE bytes
+ * @retval None
+ */
+static void HandleDsmFrame(const uint8_t* frame) {
+	uint32_t timestamp = GetTimestamp();
+	bool is1024 = (DSM_SYSTEM_DSM2_1024_22MS == frame[DSM_SYSTEM_BYTE]);
+	uint8_t nbrOfChannels = nbrOfFrameChannels;
+	uint8_t channel;
+	uint16_t word;
+	uint8_t i;
+
+	for (i = 0; i < DSM_FRAME_CHANNEL_WORDS; i++) {
+		word = ((uint16_t) frame[2 + 2*i] << 8) | frame[3 + 2*i];
+		if (DSM_UNUSED_CHANNEL_WORD == word)
+			continue;
+
+		/* 11 bit values have the channel number in bits 11-14, 10 bit values in bits 10-13 */
+		if (is1024) {
+			channel = (word >> 10) & 0x0F;
+			if (channel < RECEIVER_MAX_CHANNELS)
+				channelPulseTicks[channel] = DSM_1024_VALUE_TO_PULSE_TICKS(word & 0x03FF);
+		} else {
+			channel = (word >> 11) & 0x0F;
+			if (channel < RECEIVER_MAX_CHANNELS)
+				channelPulseTicks[channel] = DSM_2048_VALUE_TO_PULSE_TICKS(word & 0x07FF);
+		}
+
+		if (channel < RECEIVER_MAX_CHANNELS && channel >= nbrOfChannels)
+			nbrOfChannels = channel + 1;
+	}
+
+	PublishFrame(nbrOfChannels, (timestamp - lastFrameTimestamp) / (SystemCoreClock / RECEIVER_TIM_COUNTER_CLOCK));
+	lastFrameTimestamp = timestamp;
+}
+#endif
+#elif (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_PPM)
+/*
+ * @brief  Configures the primary receiver TIM to capture the PPM-sum edges on a single input
+ * @param  None
+ * @retval RECEIVER_OK if configured without errors, else RECEIVER_ERROR
+ */
+static ReceiverErrorStatus PPMReceiverInputConfig(void) {
+	TIM_IC_InitTypeDef ppmChannelICConfig;
+
+	/*##-1- Configure the Primary Receiver TIM peripheral ######################*/
+	/* Free running 32 bit counter, so the capture differences need no period count */
+	PrimaryReceiverTimHandle.Instance = PRIMARY_RECEIVER_TIM;
+	PrimaryReceiverTimHandle.Init.Period = RECEIVER_PPM_COUNTER_PERIOD;
+	PrimaryReceiverTimHandle.Init.Prescaler = SystemCoreClock / RECEIVER_TIM_COUNTER_CLOCK - 1;
+	PrimaryReceiverTimHandle.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+	PrimaryReceiverTimHandle.Init.CounterMode = TIM_COUNTERMODE_UP;
+	if (HAL_TIM_IC_Init(&PrimaryReceiverTimHandle) != HAL_OK) {
+		/* Initialization Error */
+		ErrorHandler();
+		return RECEIVER_ERROR;
+	}
+
+	/*##-2- Configure the Input Capture channel ################################*/
+	/* Only one edge per channel is captured, so the polarity never has to be toggled */
+	ppmChannelICConfig.ICPrescaler = TIM_ICPSC_DIV1;
+	ppmChannelICConfig.ICFilter = 0;
+	ppmChannelICConfig.ICPolarity = RECEIVER_PPM_IC_POLARITY;
+	ppmChannelICConfig.ICSelection = TIM_ICSELECTION_DIRECTTI;
+	if (HAL_TIM_IC_ConfigChannel(&PrimaryReceiverTimHandle, &ppmChannelICConfig, RECEIVER_PPM_CHANNEL) != HAL_OK) {
+		/* Configuration Error */
+		ErrorHandler();
+		return RECEIVER_ERROR;
+	}
+
+	/*##-3- Start the Input Capture in interrupt mode ##########################*/
+	if (HAL_TIM_IC_Start_IT(&PrimaryReceiverTimHandle, RECEIVER_PPM_CHANNEL) != HAL_OK) {
+		/* Starting Error */
+		ErrorHandler();
+		return RECEIVER_ERROR;
+	}
+
+	return RECEIVER_OK;
+}
+#endif
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -25,29 +25,40 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "rotation_transformation.h"
+#include "fast_math.h"
+#include "matrix3.h"
 
 #include <math.h>
+#include <string.h>
+#include <stdbool.h>
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+#define ANG_RATE_MATRIX_MIN_COS_PITCH   0.1f // Closer to 0 the transformation matrix is too close to becoming singular
+#define DCM_RENORMALIZE_INTERVAL        8   // Incremental DCM updates between re-orthonormalizations
 /* Private macro -------------------------------------------------------------*/
 
 /* Private variables ---------------------------------------------------------*/
-static arm_matrix_instance_f32 DCM; // From inertial/world frame to body frame
-static float32_t DCMf32[9];
-static arm_matrix_instance_f32 DCMInv; // From body frame to inertial/world frame
-static float32_t DCMInvf32[9];
+static float32_t DCMf32[9]; // From inertial/world frame to body frame
+static float32_t DCMInvf32[9]; // From body frame to inertial/world frame
+static uint32_t DCMUpdatesSinceRenormalize = 0;
 
-static arm_matrix_instance_f32 angRateMatrix; // Used to transform angular rate from body to inertial/worl frame
-static float32_t angRateMatrixf32[9];
+static float32_t angRateMatrixf32[9]; // Used to transform angular rate from body to inertial/worl frame
+static bool angRateMatrixCached = false; // true if angRateMatrix was built from attitudeTrigCache
+static uint32_t angRateMatrixGeneration; // attitudeTrigCache generation angRateMatrix was built from
+
+static AttitudeTrigCacheType attitudeTrigCache = { 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0 };
 
 /* [Unit: Gauss] Set to the magnetic vector in Malmö, SE, year 2015 (Components in north, east, down convention)
 * Data used from http://www.ngdc.noaa.gov/geomag-web/
 * TODO: Optionally, perform calibration of this vector at system startup */
 // float32_t inertialMagneticVector[3] = {0.171045, 0.01055, 0.472443};
-float32_t inertialMagneticVectorNormalized[3] = {0.340345, 0.0209924, 0.940066};
+float32_t inertialMagneticVectorNormalized[3] = {0.340345f, 0.0209924f, 0.940066f};
 
 /* Private function prototypes -----------------------------------------------*/
+static void CalculateRollPitchTrig(AttitudeTrigCacheType* trig, const float32_t roll, const float32_t pitch);
+static TransformationErrorStatus BuildAngularRotationMatrix(const AttitudeTrigCacheType* trig);
+static TransformationErrorStatus MultiplyAngularRotationMatrix(float32_t* rateDst, const float32_t* bodyAngularRates);
 
 /* Exported functions --------------------------------------------------------*/
 
@@ -57,16 +68,6 @@ float32_t inertialMagneticVectorNormalized[3] = {0.340345, 0.0209924, 0.940066};
  * @retval None
  */
 void InitRotationMatrix(void) {
-	float32_t DCMInvInit[9] =
-	{
-			1.0,     0.0,     0.0,
-			0.0,     1.0,     0.0,
-			0.0,     0.0,     1.0,
-	};
-
-	/* Initialize the inverse DCM to the unit matrix (3x3) */
-	arm_mat_init_f32(&DCMInv, 3, 3, DCMInvInit);
-
 	/* Initializes the DCM to the unit matrix (3x3) */
 	UpdateRotationMatrix(0.0, 0.0, 0.0);
 }
@@ -86,9 +87,6 @@ void InitAngularRotationMatrix(void) {
     angRateMatrixf32[6] = 0.0;
     angRateMatrixf32[7] = 0.0;
     angRateMatrixf32[8] = 1.0;
-
-    /* Initialize the angular rate matrix to the unit matrix (3x3) */
-    arm_mat_init_f32(&angRateMatrix, 3, 3, angRateMatrixf32);
 }
 
 /*
@@ -99,14 +97,24 @@ void InitAngularRotationMatrix(void) {
  * @retval None
  */
 void UpdateRotationMatrix(const float32_t roll, const float32_t pitch, const float32_t yaw) {
-    float32_t sinRoll, cosRoll, sinPitch, cosPitch, sinYaw, cosYaw;
+    AttitudeTrigCacheType trig;
+
+    CalculateRollPitchTrig(&trig, roll, pitch);
+    trig.sinYaw = arm_sin_f32(yaw);
+    trig.cosYaw = arm_cos_f32(yaw);
+
+    UpdateRotationMatrixCached(&trig);
+}
 
-    sinRoll = arm_sin_f32(roll);
-    cosRoll = arm_cos_f32(roll);
-    sinPitch = arm_sin_f32(pitch);
-    cosPitch = arm_cos_f32(pitch);
-    sinYaw = arm_sin_f32(yaw);
-    cosYaw = arm_cos_f32(yaw);
+/*
+ * @brief  Updates the Direction Cosine Matrix from precalculated attitude trigonometry
+ * @param  trig : Attitude trigonometry, e.g. from GetAttitudeTrigCache()
+ * @retval None
+ */
+void UpdateRotationMatrixCached(const AttitudeTrigCacheType* trig) {
+    float32_t sinRoll = trig->sinRoll, cosRoll = trig->cosRoll;
+    float32_t sinPitch = trig->sinPitch, cosPitch = trig->cosPitch;
+    float32_t sinYaw = trig->sinYaw, cosYaw = trig->cosYaw;
 
 	/* Calculate the DCM based on roll, pitch and yaw angles */
     DCMf32[0] = cosPitch*cosYaw;
@@ -119,12 +127,81 @@ void UpdateRotationMatrix(const float32_t roll, const float32_t pitch, const flo
     DCMf32[7] = -sinRoll*cosYaw+cosRoll*sinPitch*sinYaw;
     DCMf32[8] = cosRoll*cosPitch;
 
-	/* Init the DCM that transforms FROM the inertial frame TO the body frame */
-	arm_mat_init_f32(&DCM, 3, 3, angRateMatrixf32);
+	DCMUpdatesSinceRenormalize = 0;
 
 	/* Calculate the DCM inverse, which is the same as matrix transpose since DCM is an orthonormal matrix. The inverse
 	 * transforms FROM the body frame TO the inertial frame*/
-	arm_mat_trans_f32(&DCM, &DCMInv);
+	Mat3Transpose(DCMInvf32, DCMf32);
+}
+
+/*
+ * @brief  Rotates the Direction Cosine Matrix by body angular rates over a time step (first order/small angle update)
+ *         and re-orthonormalizes it every DCM_RENORMALIZE_INTERVAL updates. Cheaper than rebuilding it from angles.
+ * @param  bodyAngularRates : Unbiased body frame angular rates [rad/s]
+ * @param  dt : Time step [s]
+ * @retval None
+ */
+void UpdateRotationMatrixFromGyro(const float32_t* bodyAngularRates, const float32_t dt) {
+	float32_t angle[3] = { bodyAngularRates[0]*dt, bodyAngularRates[1]*dt, bodyAngularRates[2]*dt };
+	float32_t delta[3];
+	uint8_t row;
+
+	/* d/dt(DCMInv) = DCMInv*[w x], i.e. each row r of DCMInv changes with r x w */
+	for (row = 0; row < 3; row++) {
+		Vector3DCrossProduct(delta, &DCMInvf32[3*row], angle);
+		DCMInvf32[3*row] += delta[0];
+		DCMInvf32[3*row+1] += delta[1];
+		DCMInvf32[3*row+2] += delta[2];
+	}
+
+	if (++DCMUpdatesSinceRenormalize >= DCM_RENORMALIZE_INTERVAL) {
+		float32_t* row0 = &DCMInvf32[0];
+		float32_t* row1 = &DCMInvf32[3];
+		float32_t* row2 = &DCMInvf32[6];
+		float32_t error, scale, tmp0[3], tmp1[3];
+		uint8_t i;
+
+		/* Share the orthogonality error between the first two rows and make the third perpendicular to both */
+		arm_dot_prod_f32(row0, row1, 3, &error);
+		for (i = 0; i < 3; i++) {
+			tmp0[i] = row0[i] - 0.5f*error*row1[i];
+			tmp1[i] = row1[i] - 0.5f*error*row0[i];
+		}
+		memcpy(row0, tmp0, sizeof(tmp0));
+		memcpy(row1, tmp1, sizeof(tmp1));
+		Vector3DCrossProduct(row2, row0, row1);
+
+		/* Normalize the rows, first order Taylor expansion of 1/sqrt(x) around 1 */
+		for (row = 0; row < 3; row++) {
+			arm_dot_prod_f32(&DCMInvf32[3*row], &DCMInvf32[3*row], 3, &scale);
+			arm_scale_f32(&DCMInvf32[3*row], 0.5f*(3.0f - scale), &DCMInvf32[3*row], 3);
+		}
+
+		DCMUpdatesSinceRenormalize = 0;
+	}
+
+	/* The DCM transforms FROM the inertial frame TO the body frame */
+	Mat3Transpose(DCMf32, DCMInvf32);
+}
+
+/*
+ * @brief  Transforms a vector FROM the body frame TO the inertial frame with the Direction Cosine Matrix
+ * @param  dstVector : Inertial frame vector, may be the same as srcVector
+ * @param  srcVector : Body frame vector
+ * @retval None
+ */
+void Vector3DBodyToInertial(float32_t* dstVector, const float32_t* srcVector) {
+	Mat3MulVec3(dstVector, DCMInvf32, srcVector);
+}
+
+/*
+ * @brief  Transforms a vector FROM the inertial frame TO the body frame with the Direction Cosine Matrix
+ * @param  dstVector : Body frame vector, may be the same as srcVector
+ * @param  srcVector : Inertial frame vector
+ * @retval None
+ */
+void Vector3DInertialToBody(float32_t* dstVector, const float32_t* srcVector) {
+	Mat3MulVec3(dstVector, DCMf32, srcVector);
 }
 
 /*
@@ -135,36 +212,12 @@ void UpdateRotationMatrix(const float32_t roll, const float32_t pitch, const flo
  * @retval TRANSF_OK if transformation is OK, else TRANSF_ERROR
  */
 TransformationErrorStatus UpdateAngularRotationMatrix(const float32_t roll, const float32_t pitch) {
-    float32_t sinRoll, cosRoll, sinPitch, cosPitch, tanPitch, secPitch;
-
-    sinRoll = arm_sin_f32(roll);
-    cosRoll = arm_cos_f32(roll);
-    sinPitch = arm_sin_f32(pitch);
-    cosPitch = arm_cos_f32(pitch);
-
-    /* Check so that transformation matrix is not too close to becoming singular */
-    if (fabsf(cosPitch) < 0.1) {
-        return TRANSF_ERROR;
-    }
-
-    tanPitch = sinPitch/cosPitch;
-    secPitch = 1.0/cosPitch;
-
-    /* Calculate the angular rate transformation matrix based on roll and pitch angles*/
-    angRateMatrixf32[0] = 1.0;
-    angRateMatrixf32[1] = sinRoll*tanPitch;
-    angRateMatrixf32[2] = cosRoll*tanPitch;
-    angRateMatrixf32[3] = 0.0;
-    angRateMatrixf32[4] = cosRoll;
-    angRateMatrixf32[5] = -sinRoll;
-    angRateMatrixf32[6] = 0.0;
-    angRateMatrixf32[7] = sinRoll*secPitch;
-    angRateMatrixf32[8] = cosRoll*secPitch;
+    AttitudeTrigCacheType trig;
 
-    /* Init the DCM that transforms FROM the inertial frame TO the body frame */
-    arm_mat_init_f32(&angRateMatrix, 3, 3, angRateMatrixf32);
+    CalculateRollPitchTrig(&trig, roll, pitch);
 
-    return TRANSF_OK;
+    angRateMatrixCached = false;
+    return BuildAngularRotationMatrix(&trig);
 }
 
 /*
@@ -181,8 +234,8 @@ void GetAttitudeFromAccelerometer(float32_t* dstAttitude, float32_t const * body
   Vector3DNormalize(accNormalized, (float32_t*) bodyAccelerometerReadings);
 
   /* Calculate roll and pitch Euler angles  */
-  dstAttitude[0] = atan2f(-accNormalized[1], -accNormalized[2]); // Roll-Phi need sign on both params to get right section of unit circle
-  dstAttitude[1] = asinf(accNormalized[0]); // Pitch-Theta (direction of g and minus sign cancel)
+  dstAttitude[0] = FastAtan2f(-accNormalized[1], -accNormalized[2]); // Roll-Phi need sign on both params to get right section of unit circle
+  dstAttitude[1] = FastAsinf(accNormalized[0]); // Pitch-Theta (direction of g and minus sign cancel)
 }
 
 /*
@@ -210,20 +263,20 @@ void GetAttitudeFromMagnetometer(float32_t* dstAttitude, float32_t* bodyMagnetic
 
 	/* Get the angle for the body to the inertial frame vectors rotated around rotation vector axis */
 	arm_dot_prod_f32(bodyMagneticVectorNormalized, inertialMagneticVectorNormalized, 3, &dotProd);
-	rotationAngle = acosf(dotProd);
+	rotationAngle = FastAcosf(dotProd);
 
 	/* Calculate the axis/angle quaternion representation (q = q0 + q1*i + q2*j + q3*k) */
-	cosHalfAngle = arm_cos_f32(rotationAngle*0.5);
-	sinHalfAngle = arm_sin_f32(rotationAngle*0.5);
+	cosHalfAngle = arm_cos_f32(rotationAngle*0.5f);
+	sinHalfAngle = arm_sin_f32(rotationAngle*0.5f);
 	q0 = cosHalfAngle;
 	q1 = rotationAxisVectorNormalized[0]*sinHalfAngle;
 	q2 = rotationAxisVectorNormalized[1]*sinHalfAngle;
 	q3 = rotationAxisVectorNormalized[2]*sinHalfAngle;
 
 	/* From the quaternion, the Euler angles (roll, pitch, yaw) are obtained */
-	dstAttitude[0] = atan2f(2.0*q0*q1 + 2.0*q2*q3, q0*q0 - q1*q1 - q2*q2 + q3*q3); // Roll-Phi
-	dstAttitude[1] = asinf(2.0*q0*q2 - 2.0*q1*q3); // Pitch-Theta
-	dstAttitude[2] = atan2f(2.0*q0*q3 + 2.0*q1*q2, q0*q0 + q1*q1 - q2*q2 - q3*q3); // Yaw-Psi
+	dstAttitude[0] = FastAtan2f(2.0f*q0*q1 + 2.0f*q2*q3, q0*q0 - q1*q1 - q2*q2 + q3*q3); // Roll-Phi
+	dstAttitude[1] = FastAsinf(2.0f*q0*q2 - 2.0f*q1*q3); // Pitch-Theta
+	dstAttitude[2] = FastAtan2f(2.0f*q0*q3 + 2.0f*q1*q2, q0*q0 + q1*q1 - q2*q2 - q3*q3); // Yaw-Psi
 }
 
 /*
@@ -246,14 +299,13 @@ void Vector3DCrossProduct(float32_t* dstVector, const float32_t* srcVector1, con
  * @retval None
  */
 void Vector3DNormalize(float32_t* dstVector, float32_t* srcVector) {
-	float32_t norm;
+	float32_t normSquared;
 
-	/* Calculate norm of source vector */
-	arm_dot_prod_f32(srcVector, srcVector, 3, &norm);
-	norm = sqrt(norm);
+	/* Calculate squared norm of source vector */
+	arm_dot_prod_f32(srcVector, srcVector, 3, &normSquared);
 
 	/* Normalize the vector to unit length and store it in destination vector */
-	arm_scale_f32(srcVector, 1.0/norm, dstVector, 3);
+	arm_scale_f32(srcVector, FastInvSqrtf(normSquared), dstVector, 3);
 }
 
 /*
@@ -263,14 +315,30 @@ void Vector3DNormalize(float32_t* dstVector, float32_t* srcVector) {
  * @retval None
  */
 void Vector3DTiltCompensate(float32_t* dstVector, float32_t* srcVector, float32_t roll, float32_t pitch) {
-	dstVector[0] = srcVector[0]*arm_cos_f32(pitch)
-                 + srcVector[2]*arm_sin_f32(pitch);
-	dstVector[1] = srcVector[0]*arm_sin_f32(roll)*arm_sin_f32(pitch)
-                 + srcVector[1]*arm_cos_f32(roll)
-                 - srcVector[2]*arm_sin_f32(roll)*arm_cos_f32(pitch);
-	dstVector[2] = -srcVector[0]*arm_cos_f32(roll)*arm_sin_f32(pitch)
-                 + srcVector[1]*arm_sin_f32(roll)
-                 + srcVector[2]*arm_cos_f32(roll)*arm_cos_f32(pitch);
+    AttitudeTrigCacheType trig;
+
+    CalculateRollPitchTrig(&trig, roll, pitch);
+    Vector3DTiltCompensateCached(dstVector, srcVector, &trig);
+}
+
+/*
+ * @brief  Tilt compensate the input 3D vector of magnetic values using precalculated attitude trigonometry
+ * @param  dstVector : tilt compensated vector result, may be the same as srcVector
+ * @param  srcVector : normalized vector with magnetic sensor values
+ * @param  trig : Attitude trigonometry, e.g. from GetAttitudeTrigCache()
+ * @retval None
+ */
+void Vector3DTiltCompensateCached(float32_t* dstVector, const float32_t* srcVector, const AttitudeTrigCacheType* trig) {
+    float32_t x = srcVector[0], y = srcVector[1], z = srcVector[2];
+
+	dstVector[0] = x*trig->cosPitch
+                 + z*trig->sinPitch;
+	dstVector[1] = x*trig->sinRoll*trig->sinPitch
+                 + y*trig->cosRoll
+                 - z*trig->sinRoll*trig->cosPitch;
+	dstVector[2] = -x*trig->cosRoll*trig->sinPitch
+                 + y*trig->sinRoll
+                 + z*trig->cosRoll*trig->cosPitch;
 }
 
 /*
@@ -281,15 +349,30 @@ void Vector3DTiltCompensate(float32_t* dstVector, float32_t* srcVector, float32_
  * @retval yawAngle : yaw angle in radians
  */
 float32_t GetMagYawAngle(float32_t* magValues, const float32_t roll, const float32_t pitch)
+{
+    AttitudeTrigCacheType trig;
+
+    CalculateRollPitchTrig(&trig, roll, pitch);
+    return GetMagYawAngleCached(magValues, &trig);
+}
+
+/*
+ * @brief  Returns the yaw angle calculated from magnetometer values with tilt compensation from precalculated
+ *         attitude trigonometry
+ * @param  magValues : Vector containing 3D magnetometer values
+ * @param  trig : Attitude trigonometry, e.g. from GetAttitudeTrigCache()
+ * @retval yawAngle : yaw angle in radians
+ */
+float32_t GetMagYawAngleCached(float32_t* magValues, const AttitudeTrigCacheType* trig)
 {
 	float32_t normalizedMag[3];
 	float32_t yawAngle;
 
 	Vector3DNormalize(normalizedMag, magValues);
-	Vector3DTiltCompensate(normalizedMag, normalizedMag, roll, pitch);
+	Vector3DTiltCompensateCached(normalizedMag, normalizedMag, trig);
 
     /* Equation found in LSM303DLH Application Note document. Minus sign in first parameter in atan2 to get correct rotation direction around Z axis ("down") */
-    yawAngle = atan2f(-normalizedMag[1], normalizedMag[0]);
+    yawAngle = FastAtan2f(-normalizedMag[1], normalizedMag[0]);
 
 	return yawAngle;
 }
@@ -306,31 +389,125 @@ float32_t GetMagYawAngle(float32_t* magValues, const float32_t roll, const float
 TransformationErrorStatus GetEulerAngularRates(float32_t* rateDst, const float32_t* bodyAngularRates, const float32_t roll, const float32_t pitch)
 {
     TransformationErrorStatus status = TRANSF_OK;
-    arm_status arm_math_status = ARM_MATH_SUCCESS;
-    arm_matrix_instance_f32 pqr;
-    arm_matrix_instance_f32 eulerRates;
 
     status = UpdateAngularRotationMatrix(roll, pitch);
     if (status != TRANSF_OK) {
         return status;
     }
 
-    arm_mat_init_f32(&pqr, 3, 1, (float32_t*) bodyAngularRates);
-    arm_mat_init_f32(&eulerRates, 3, 1, rateDst);
-    arm_math_status = arm_mat_mult_f32(&angRateMatrix, &pqr, &eulerRates);
-    if (arm_math_status != ARM_MATH_SUCCESS) {
-        return TRANSF_ERROR;
+    return MultiplyAngularRotationMatrix(rateDst, bodyAngularRates);
+}
+
+/*
+ * @brief  Calculates the angular rate around the Euler angle axes based on input angular rate values
+ *         from body frame and precalculated attitude trigonometry. The transformation matrix is only
+ *         recalculated when the trigonometry generation changes.
+ * @param  rateDst : Output vector containing Euler angular rates [rad/s]
+ * @param  bodyAngularRates : Input body frame angular rates [rad/s]
+ * @param  trig : Attitude trigonometry from GetAttitudeTrigCache()
+ * @retval TRANSF_OK if transformation valid, else TRANSF_ERROR
+ */
+TransformationErrorStatus GetEulerAngularRatesCached(float32_t* rateDst, const float32_t* bodyAngularRates,
+        const AttitudeTrigCacheType* trig)
+{
+    TransformationErrorStatus status = TRANSF_OK;
+
+    if (!angRateMatrixCached || angRateMatrixGeneration != trig->generation) {
+        status = BuildAngularRotationMatrix(trig);
+        angRateMatrixCached = (status == TRANSF_OK);
+        angRateMatrixGeneration = trig->generation;
+        if (status != TRANSF_OK) {
+            return status;
+        }
     }
 
-    rateDst[0] = eulerRates.pData[0];
-    rateDst[1] = eulerRates.pData[1];
-    rateDst[2] = eulerRates.pData[2];
+    return MultiplyAngularRotationMatrix(rateDst, bodyAngularRates);
+}
 
-    return status;
+/*
+ * @brief  Calculates the attitude trigonometry shared by the transformations until the next update
+ * @param  roll : roll angle [rad]
+ * @param  pitch : pitch angle [rad]
+ * @param  yaw : yaw angle [rad]
+ * @retval None
+ */
+void UpdateAttitudeTrigCache(const float32_t roll, const float32_t pitch, const float32_t yaw) {
+    CalculateRollPitchTrig(&attitudeTrigCache, roll, pitch);
+    attitudeTrigCache.sinYaw = arm_sin_f32(yaw);
+    attitudeTrigCache.cosYaw = arm_cos_f32(yaw);
+    attitudeTrigCache.generation++;
+}
+
+/*
+ * @brief  Gets the attitude trigonometry of the latest UpdateAttitudeTrigCache()
+ * @param  None
+ * @retval Pointer to the attitude trigonometry
+ */
+const AttitudeTrigCacheType* GetAttitudeTrigCache(void) {
+    return &attitudeTrigCache;
 }
 
 /* Private functions ---------------------------------------------------------*/
 
+/*
+ * @brief  Calculates the roll and pitch part of the attitude trigonometry
+ * @param  trig : Destination, yaw and generation are not changed
+ * @param  roll : roll angle [rad]
+ * @param  pitch : pitch angle [rad]
+ * @retval None
+ */
+static void CalculateRollPitchTrig(AttitudeTrigCacheType* trig, const float32_t roll, const float32_t pitch) {
+    trig->sinRoll = arm_sin_f32(roll);
+    trig->cosRoll = arm_cos_f32(roll);
+    trig->sinPitch = arm_sin_f32(pitch);
+    trig->cosPitch = arm_cos_f32(pitch);
+
+    if (fabsf(trig->cosPitch) < ANG_RATE_MATRIX_MIN_COS_PITCH) {
+        trig->tanPitch = 0.0f;
+        trig->secPitch = 0.0f;
+    } else {
+        trig->secPitch = 1.0f/trig->cosPitch;
+        trig->tanPitch = trig->sinPitch*trig->secPitch;
+    }
+}
+
+/*
+ * @brief  Calculates the angular rate transformation matrix
+ * @param  trig : Attitude trigonometry
+ * @retval TRANSF_OK if transformation is OK, else TRANSF_ERROR
+ */
+static TransformationErrorStatus BuildAngularRotationMatrix(const AttitudeTrigCacheType* trig) {
+    /* Check so that transformation matrix is not too close to becoming singular */
+    if (fabsf(trig->cosPitch) < ANG_RATE_MATRIX_MIN_COS_PITCH) {
+        return TRANSF_ERROR;
+    }
+
+    /* Calculate the angular rate transformation matrix based on roll and pitch angles*/
+    angRateMatrixf32[0] = 1.0;
+    angRateMatrixf32[1] = trig->sinRoll*trig->tanPitch;
+    angRateMatrixf32[2] = trig->cosRoll*trig->tanPitch;
+    angRateMatrixf32[3] = 0.0;
+    angRateMatrixf32[4] = trig->cosRoll;
+    angRateMatrixf32[5] = -trig->sinRoll;
+    angRateMatrixf32[6] = 0.0;
+    angRateMatrixf32[7] = trig->sinRoll*trig->secPitch;
+    angRateMatrixf32[8] = trig->cosRoll*trig->secPitch;
+
+    return TRANSF_OK;
+}
+
+/*
+ * @brief  Transforms body frame angular rates with the angular rate transformation matrix
+ * @param  rateDst : Output vector containing Euler angular rates [rad/s]
+ * @param  bodyAngularRates : Input body frame angular rates [rad/s]
+ * @retval TRANSF_OK if transformation valid, else TRANSF_ERROR
+ */
+static TransformationErrorStatus MultiplyAngularRotationMatrix(float32_t* rateDst, const float32_t* bodyAngularRates) {
+    Mat3MulVec3(rateDst, angRateMatrixf32, bodyAngularRates);
+
+    return TRANSF_OK;
+}
+
 /**
  * @}
  */
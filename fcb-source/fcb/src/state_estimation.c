@@ -24,116 +24,312 @@
 /* Includes ------------------------------------------------------------------*/
 #include "state_estimation.h"
 
-#include "stm32f3xx.h"
-
 #include "string.h"
 #include "math.h"
 
-#include "FreeRTOS.h"
-#include "task.h"
-#include "semphr.h"
-
-#include "dragonfly_fcb.pb.h"
-#include "pb_encode.h"
-
 #include "fcb_sensors.h"
 #include "fcb_gyroscope.h"
+#include "fcb_gyro_redundancy.h"
 #include "fcb_error.h"
 #include "rotation_transformation.h"
+#include "attitude_quaternion.h"
+#include "coning_integrator.h"
 #include "fcb_accelerometer_magnetometer.h"
+#include "fcb_sensor_watchdog.h"
+#include "fcb_vibration_monitor.h"
+#include "fcb_gps.h"
+#include "position_estimation.h"
+#include "mag_heading.h"
+#include "l3gd20.h"
+#include "lsm303dlhc.h"
 #include "fcb_retval.h"
-#include "usbd_cdc_if.h"
+#include "common.h"
+#include "ccm_ram.h"
+#include "fixed_format.h"
+#include "profiler.h"
+#include "scope_probe.h"
+#include "fcb_port.h"
 
 /* Private define ------------------------------------------------------------*/
 #define USE_CTRLSIGNAL_IN_PREDICTION_MODEL      0
 
-#define STATE_PRINT_SAMPLING_TASK_PRIO          1
-#define STATE_PRINT_MINIMUM_SAMPLING_TIME       20  // updated every 2.5 ms
-#define STATE_PRINT_MAX_STRING_SIZE             288
+#define DCM_REANCHOR_PREDICTIONS                20  // Predictions between rebuilding the DCM from the estimated attitude
+#define DCM_UPDATE_MAX_DT                       0.05f // Upper limit of the DCM integration step [s]
 
-enum {
-    VAR_SAMPLE_MAX = 100
-};
-/* number of samples for variance - max 256 */
+#define GYRO_BIAS_INIT_VARIANCE                 0.01f // Initial error covariance of the bias states [(rad/s)^2]
+
+#define STATE_PRINT_MAX_STRING_SIZE             320 // The states, then the counters, are sent separately
+
+#define STATE_HISTORY_EXPIRED                   -1 // Sample delay older than the state history, see GetSampleDelay()
+
+#ifndef MIN
+#define MIN(a, b)                               (((a) < (b)) ? (a) : (b))
+#endif
+
+/* Running mean and sum of squared deviations of the samples of a sensor (Welford), per axis */
 typedef struct FcbSensorVarianceCalc {
-    float32_t samples[3][VAR_SAMPLE_MAX];
+    uint32_t samples;
+    float32_t mean[3];
+    float32_t m2[3];
 } FcbSensorVarianceCalcType;
 
+#ifdef FCB_DELAYED_FUSION
+/* Kalman states and error covariances after a prediction, indexed by FcbRPYIndexType */
+typedef struct StateHistoryEntry {
+    uint32_t timestamp; /* of the prediction [core clock cycles] */
+    float32_t angle[AXES_NPR];
+    float32_t angleRate[AXES_NPR];
+    float32_t angleRateBias[AXES_NPR];
+    float32_t p11[AXES_NPR];
+    float32_t p12[AXES_NPR];
+    float32_t p13[AXES_NPR];
+    float32_t p21[AXES_NPR];
+    float32_t p22[AXES_NPR];
+    float32_t p31[AXES_NPR];
+    float32_t p32[AXES_NPR];
+} StateHistoryEntryType;
+#endif
+
 /* Private variables ---------------------------------------------------------*/
-static AttitudeStateVectorType rollState = { 0.0, 0.0, 0.0 };
-static AttitudeStateVectorType pitchState = { 0.0, 0.0, 0.0 };
-static AttitudeStateVectorType yawState = { 0.0, 0.0, 0.0 };
+/* Updated on every gyroscope sample, in the CCM SRAM with FCB_CCM_RAM */
+static AttitudeStatesType attitudeState CCM_RAM;
+static AttitudeStatesType attitudeStateInternal CCM_RAM;
 
-static AttitudeStateVectorType rollStateInternal = { 0.0, 0.0, 0.0 };
-static AttitudeStateVectorType pitchStateInternal = { 0.0, 0.0, 0.0 };
-static AttitudeStateVectorType yawStateInternal = { 0.0, 0.0, 0.0 };
+static KalmanFilterBankType attitudeEstimator CCM_RAM;
 
-static KalmanFilterType rollEstimator;
-static KalmanFilterType pitchEstimator;
-static KalmanFilterType yawEstimator;
+static VerticalStatesType verticalState CCM_RAM;
+static uint8_t verticalStateInitialized = 0; /* set by the first barometer sample */
 
-/* Task handle for printing of sensor values task */
-static volatile uint16_t statePrintSampleTime;
-static volatile uint16_t statePrintSampleDuration;
-xTaskHandle StatePrintSamplingTaskHandle = NULL;
+/* State snapshots, written by the flight control task only, or by the estimator replay while it owns the estimator.
+ * The published snapshot is the one indexed by the lowest bit of the sequence, so a new snapshot is written without
+ * touching the one being read. */
+static volatile StateSnapshotType stateSnapshots[2];
+static volatile uint32_t stateSnapshotSequence = 0;
+static uint32_t predictionTimestamp = 0; /* of the latest prediction */
 
+#ifndef FCB_QUATERNION_ATTITUDE_ESTIMATION
+/* Set when the Kalman gains are constant (FCB_STEADY_STATE_KALMAN), the error covariances are then not updated */
+static uint8_t useSteadyStateGains = 0;
+#endif
+
+#if USE_CTRLSIGNAL_IN_PREDICTION_MODEL
+/* Rotational inertia around the roll, pitch & yaw axes */
+static const float32_t attitudeInertia[AXES_NPR] = { IXX, IYY, IZZ };
+#endif
+
+#ifndef FCB_QUATERNION_ATTITUDE_ESTIMATION
 static float32_t sensorAttitudeRPY[3] = { 0.0f, 0.0f, 0.0f };
 static float32_t sensorAttitudeRateRPY[3] = { 0.0f, 0.0f, 0.0f };
+#endif
+
+/* Latest gyroscope sample minus the estimated bias [rad/s], body frame */
+static float32_t unbiasedBodyRates[3] = { 0.0f, 0.0f, 0.0f };
+
+#if defined(FCB_CONING_COMPENSATION) && !defined(FCB_QUATERNION_ATTITUDE_ESTIMATION)
+/* Rotation of the unbiased gyroscope samples since the latest prediction */
+static ConingIntegratorType gyroIntegrator CCM_RAM;
+#endif
+
+/* [core clock cycles] sample times of the latest corrections, see GetTimestamp() */
+static uint32_t magLastCorrectionTimestamp = 0;
+static uint32_t accLastCorrectionTimestamp = 0;
+static uint32_t gyroLastCorrectionTimestamp = 0;
+static uint32_t baroLastCorrectionTimestamp = 0;
+
+/* Sensor watchdog stalls at the latest correction of each sensor, see GetSensorStalls() */
+static uint32_t correctionStalls[FCB_SENSOR_NBR] = { 0, 0, 0, 0 };
+
+#if defined(FCB_REDUNDANT_GYRO) && !defined(FCB_QUATERNION_ATTITUDE_ESTIMATION)
+/* Gyroscope source changes of the voting at the latest gyroscope correction, see GetGyroVoteSourceChanges() */
+static uint32_t correctionGyroSourceChanges = 0;
+#endif
+
+static uint32_t predictionsSinceDCMAnchor = 0;
+
+/* Predictions since the latest initialization, saturating, see IsStateEstimationConverged() */
+static uint32_t predictionsSinceInit = 0;
+
+/* Parameters of the latest initialization, see GetStateInit() */
+static StateInitType stateInit;
+
+/* Roll/pitch noise of an accelerometer sample of the latest initialization, which the vibration noise adds to */
+static float32_t accNoiseR1 = R1_ACCRP;
+
+/* Sensor noise characterisation, updated by the flight control task and started and read in critical sections */
+static FcbSensorVarianceCalcType sensorVariance[FCB_SENSOR_NBR];
+static SensorNoiseType sensorNoise;
+static volatile SensorNoiseStatusType sensorNoiseStatus = SENSOR_NOISE_IDLE;
+static float32_t sensorNoiseDuration = 0.0f; /* [s] */
+static float32_t sensorNoiseElapsed = 0.0f; /* [s] of gyroscope samples */
+
+/* Measurement noise seeded from a characterisation, used by InitStatesXYZ() */
+static float32_t seededR1[AXES_NPR];
+static float32_t seededR2[AXES_NPR];
+static uint8_t isSensorNoiseSeeded = 0;
+
+/* Noise parameters, written by the parameter table with the scheduler suspended. A retune is taken by the next
+ * prediction, in the task that runs the estimator. */
+static volatile EstimatorNoiseSettingsType noiseSettings = { Q1_RP, Q2_RP, Q1_Y, Q2_Y, Q3_CAL, { 0.0f, 0.0f, 0.0f },
+        { 0.0f, 0.0f, 0.0f } };
+static volatile uint8_t isNoiseRetunePending = 0;
+
+static const Param_TypeDef noiseParamTable[] = {
+    { "EST_Q1_RP", PARAM_TYPE_FLOAT, &noiseSettings.q1RollPitch, 0.0, ESTIMATOR_NOISE_PARAM_MAX },
+    { "EST_Q2_RP", PARAM_TYPE_FLOAT, &noiseSettings.q2RollPitch, 0.0, ESTIMATOR_NOISE_PARAM_MAX },
+    { "EST_Q1_Y", PARAM_TYPE_FLOAT, &noiseSettings.q1Yaw, 0.0, ESTIMATOR_NOISE_PARAM_MAX },
+    { "EST_Q2_Y", PARAM_TYPE_FLOAT, &noiseSettings.q2Yaw, 0.0, ESTIMATOR_NOISE_PARAM_MAX },
+    { "EST_Q3", PARAM_TYPE_FLOAT, &noiseSettings.q3, 0.0, ESTIMATOR_NOISE_PARAM_MAX },
+    { "EST_R1_ROLL", PARAM_TYPE_FLOAT, &noiseSettings.r1[ROLL_IDX], 0.0, ESTIMATOR_NOISE_PARAM_MAX },
+    { "EST_R1_PITCH", PARAM_TYPE_FLOAT, &noiseSettings.r1[PITCH_IDX], 0.0, ESTIMATOR_NOISE_PARAM_MAX },
+    { "EST_R1_YAW", PARAM_TYPE_FLOAT, &noiseSettings.r1[YAW_IDX], 0.0, ESTIMATOR_NOISE_PARAM_MAX },
+    { "EST_R2_ROLL", PARAM_TYPE_FLOAT, &noiseSettings.r2[ROLL_IDX], 0.0, ESTIMATOR_NOISE_PARAM_MAX },
+    { "EST_R2_PITCH", PARAM_TYPE_FLOAT, &noiseSettings.r2[PITCH_IDX], 0.0, ESTIMATOR_NOISE_PARAM_MAX },
+    { "EST_R2_YAW", PARAM_TYPE_FLOAT, &noiseSettings.r2[YAW_IDX], 0.0, ESTIMATOR_NOISE_PARAM_MAX }
+};
+
+/* Only counted by the Kalman filter, the quaternion filter has its own norm gate */
+static AccCorrectionGateStatsType accGateStats = { 0, 0, 0, 1.0f };
+#ifndef FCB_QUATERNION_ATTITUDE_ESTIMATION
+static uint16_t accConsecutiveInnovationRejects = 0;
+#endif
 
-static portTickType magLastCorrectionTick = 0;
-static portTickType accLastCorrectionTick = 0;
+static DelayedFusionStatsType delayedFusionStats = { 0, 0, 0 };
+#ifdef FCB_DELAYED_FUSION
+/* Ring buffer of the latest predictions, too large for the CCM RAM */
+static StateHistoryEntryType stateHistory[STATE_HISTORY_LENGTH];
+static uint8_t stateHistoryNewest = 0;
+static uint8_t stateHistoryCount = 0;
+#endif
 
 /* Private function prototypes -----------------------------------------------*/
-static void StateInit(KalmanFilterType * Estimator, float32_t q1, float32_t q2, float32_t q3, float32_t r1, float32_t r2);
-static void PredictAttitudeState(KalmanFilterType* pEstimator, AttitudeStateVectorType * pState,
-        float32_t const inertia, float32_t const ctrl, float32_t const tSinceLastCorrection);
-static void CorrectAttitudeState(const float32_t sensorAngle, KalmanFilterType* pEstimator,
-		AttitudeStateVectorType* pStateInternal, AttitudeStateVectorType* pState);
-static void CorrectAttitudeRateState(const float32_t sensorRate, KalmanFilterType* pEstimator,
-        AttitudeStateVectorType* pStateInternal, AttitudeStateVectorType* pState);
-static void StatePrintSamplingTask(void const *argument);
+static void StateInit(FcbRPYIndexType axis, float32_t q1, float32_t q2, float32_t q3, float32_t r1, float32_t r2);
+static void InitAttitudeNoise(const StateInitType* init);
+static void SetInitNoise(StateInitType* init);
+static void RetuneNoise(void);
+static void RequestNoiseRetune(void);
+static FcbRetValType SaveNoiseParams(void);
+static void UpdateSensorNoise(FcbSensorIndexType sensor, float32_t const * pXYZ, uint32_t const timestamp);
+static void FinishSensorNoise(void);
+static float32_t ClampNoiseVariance(float32_t const variance, float32_t const defaultVariance);
+#ifndef FCB_QUATERNION_ATTITUDE_ESTIMATION
+static RAMFUNC void PredictAttitudeStates(float32_t const ctrl[AXES_NPR], float32_t const tSinceLastCorrection[AXES_NPR],
+        float32_t const * pAngleIncrement);
+static RAMFUNC void CorrectAttitudeStates(float32_t const sensorAngle[AXES_NPR], uint8_t const firstAxis,
+        uint8_t const lastAxis, float32_t const noiseScale);
+static RAMFUNC void CorrectAttitudeRateStates(float32_t const sensorRate[AXES_NPR]);
+static RAMFUNC uint8_t AccCorrectionGate(float32_t const * pAccMeterXYZ, float32_t const sensorAngle[AXES_NPR],
+        float32_t const refAngle[AXES_NPR], float32_t const refP11[AXES_NPR], float32_t const noiseScale);
+static RAMFUNC void FuseAttitudeSample(float32_t const sensorAngle[AXES_NPR], uint8_t const firstAxis,
+        uint8_t const lastAxis, float32_t const noiseScale, float32_t const * pAccMeterXYZ, uint32_t const timestamp);
+#endif
+#ifdef FCB_DELAYED_FUSION
+static RAMFUNC StateHistoryEntryType * GetStateHistory(uint8_t const age);
+static RAMFUNC void StoreStateHistory(StateHistoryEntryType * pEntry);
+static RAMFUNC int8_t GetSampleDelay(uint32_t const timestamp);
+static RAMFUNC void CorrectDelayedAttitudeStates(float32_t const sensorAngle[AXES_NPR], uint8_t const firstAxis,
+        uint8_t const lastAxis, float32_t const noiseScale, uint8_t const delay);
+#endif
+static RAMFUNC uint8_t SensorStalledSinceCorrection(FcbSensorIndexType sensor);
+#if defined(FCB_REDUNDANT_GYRO) && !defined(FCB_QUATERNION_ATTITUDE_ESTIMATION)
+static void ReopenGyroBiasOnSourceChange(void);
+#endif
+static RAMFUNC float32_t AccVibrationNoiseScale(void);
+static void PredictVerticalStates(float32_t const * pInertialAcc, float32_t const dt);
+static void CorrectVerticalStates(float32_t const altitude, float32_t const dt);
+#ifdef FCB_STEADY_STATE_KALMAN
+static void SolveSteadyStateGains(void);
+#endif
+
+static const ParamGroup_TypeDef noiseParamGroup = { noiseParamTable,
+        sizeof(noiseParamTable) / sizeof(noiseParamTable[0]), RequestNoiseRetune, SaveNoiseParams };
 
 /* Exported functions --------------------------------------------------------*/
 
 /*
- * @brief  Initializes the Kalman state estimator
- * @param  None
+ * @brief  Initializes the Kalman state estimator at the nominal prediction period and the current time
+ * @param  initAngles : Initial roll, pitch & yaw angles [rad]
  * @retval None
  */
 void InitStatesXYZ(float32_t initAngles[3]) {
-    StateInit(&rollEstimator, 	Q1_RP, 	Q2_RP, 	Q3_CAL, R1_ACCRP, 	GYRO_X_AXIS_VARIANCE);
-    StateInit(&pitchEstimator, 	Q1_RP, 	Q2_RP, 	Q3_CAL, R1_ACCRP, 	GYRO_Y_AXIS_VARIANCE);
-    StateInit(&yawEstimator, 	Q1_Y, 	Q2_Y, 	Q3_CAL, R1_MAG, 	GYRO_Z_AXIS_VARIANCE);
+    StateInitType init;
 
-    rollState.angle = initAngles[0];
-    rollState.angleRate = 0.0;
-    rollState.angleRateBias = 0.0;
-    rollState.angleRateUnbiased = rollState.angleRate - rollState.angleRateBias;
+    memcpy(init.angles, initAngles, sizeof(init.angles));
+#ifdef FCB_GYRO_SYNCHRONOUS_PIPELINE
+    /* Predicted once per gyroscope sample */
+    init.predictionPeriod = GetFlightControlSamplePeriod();
+#else
+    init.predictionPeriod = 1.0f/((float32_t)(SystemCoreClock/(STATE_ESTIMATION_TIME_UPDATE_PERIOD+1)/STATE_ESTIMATION_TIME_UPDATE_PRESCALER));
+#endif
+    init.timestamp = GetTimestamp();
+    SetInitNoise(&init);
 
-    pitchState.angle = initAngles[1];
-    pitchState.angleRate = 0.0;
-    pitchState.angleRateBias = 0.0;
-    pitchState.angleRateUnbiased = pitchState.angleRate - pitchState.angleRateBias;
+    InitStatesFrom(&init);
+}
 
-    yawState.angle = initAngles[2];
-    yawState.angleRate = 0.0;
-    yawState.angleRateBias = 0.0;
-    yawState.angleRateUnbiased = yawState.angleRate - yawState.angleRateBias;
+/*
+ * @brief  Initializes the Kalman state estimator with the given parameters. The estimator output only depends on
+ *         these and on the following prediction times and sensor samples, so a replay from the same parameters, see
+ *         estimator_replay.h, gives the same estimates.
+ * @param  init : Initial angles, prediction period, the time the corrections are counted from and the noise
+ * @retval None
+ */
+void InitStatesFrom(const StateInitType* init) {
+    uint8_t axis;
+
+    stateInit = *init;
+
+    CcmRamRegisterObject("attitudeEstimator", &attitudeEstimator, sizeof(attitudeEstimator));
+    CcmRamRegisterObject("attitudeState", &attitudeState, sizeof(attitudeState));
+    CcmRamRegisterObject("attitudeStateInt", &attitudeStateInternal, sizeof(attitudeStateInternal));
+    CcmRamRegisterObject("verticalState", &verticalState, sizeof(verticalState));
+#if defined(FCB_CONING_COMPENSATION) && !defined(FCB_QUATERNION_ATTITUDE_ESTIMATION)
+    CcmRamRegisterObject("gyroIntegrator", &gyroIntegrator, sizeof(gyroIntegrator));
+    ConingIntegratorReset(&gyroIntegrator);
+#endif
+
+    InitAttitudeNoise(init);
 
-    rollStateInternal.angle = initAngles[0];
-    rollStateInternal.angleRate = 0.0;
-    rollStateInternal.angleRateBias = 0.0; // TODO init to gyroscope reading
-    rollStateInternal.angleRateUnbiased = rollState.angleRate - rollState.angleRateBias;
+    attitudeEstimator.h = init->predictionPeriod;
 
-    pitchStateInternal.angle = initAngles[1];
-    pitchStateInternal.angleRate = 0.0;
-    pitchStateInternal.angleRateBias = 0.0; // TODO init to gyroscope reading
-    pitchStateInternal.angleRateUnbiased = pitchState.angleRate - pitchState.angleRateBias;
+    for (axis = 0; axis < AXES_NPR; axis++) {
+        attitudeState.angle[axis] = init->angles[axis];
+        attitudeState.angleRate[axis] = 0.0;
+        attitudeState.angleRateBias[axis] = 0.0;
+        attitudeState.angleRateUnbiased[axis] = attitudeState.angleRate[axis] - attitudeState.angleRateBias[axis];
+
+        attitudeStateInternal.angle[axis] = init->angles[axis];
+        attitudeStateInternal.angleRate[axis] = 0.0;
+        attitudeStateInternal.angleRateBias[axis] = 0.0; // Seeded by SeedGyroBiases() if at rest at startup
+        attitudeStateInternal.angleRateUnbiased[axis] = attitudeState.angleRateUnbiased[axis];
+    }
 
-    yawStateInternal.angle = initAngles[2];
-    yawStateInternal.angleRate = 0.0;
-    yawStateInternal.angleRateBias = 0.0; // TODO init to gyroscope reading
-    yawStateInternal.angleRateUnbiased = yawState.angleRate - yawState.angleRateBias;
+#ifdef FCB_STEADY_STATE_KALMAN
+    useSteadyStateGains = 0;
+    SolveSteadyStateGains();
+    useSteadyStateGains = 1;
+#endif
+
+    accLastCorrectionTimestamp = magLastCorrectionTimestamp = gyroLastCorrectionTimestamp = init->timestamp;
+    baroLastCorrectionTimestamp = accLastCorrectionTimestamp;
+    ResetMagHeading();
+#ifndef FCB_QUATERNION_ATTITUDE_ESTIMATION
+    accConsecutiveInnovationRejects = 0;
+#endif
+#ifdef FCB_DELAYED_FUSION
+    stateHistoryCount = 0;
+#endif
+
+    /* Start from the first barometer sample */
+    verticalStateInitialized = 0;
+
+#ifdef FCB_QUATERNION_ATTITUDE_ESTIMATION
+    QuaternionAttitudeInit(init->angles);
+#endif
+
+    UpdateAttitudeTrigCache(init->angles[ROLL_IDX], init->angles[PITCH_IDX], init->angles[YAW_IDX]);
+    UpdateRotationMatrixCached(GetAttitudeTrigCache());
+    predictionsSinceDCMAnchor = 0;
+    predictionsSinceInit = 0;
 }
 
 /*
@@ -144,6 +340,7 @@ void InitStatesXYZ(float32_t initAngles[3]) {
 StateEstimationStatus InitStateEstimationTimeEvent(void) {
     StateEstimationStatus status = STATE_EST_OK;
 
+#ifndef FCB_HOST_BUILD /* On a host, the harness steps the estimation */
     /*##-1- Configure the TIM peripheral #######################################*/
 
     /* Set STATE_ESTIMATION_UPDATE_TIM instance */
@@ -166,6 +363,7 @@ StateEstimationStatus InitStateEstimationTimeEvent(void) {
         status = STATE_EST_ERROR;
         ErrorHandler();
     }
+#endif
 
     return status;
 }
@@ -175,15 +373,84 @@ StateEstimationStatus InitStateEstimationTimeEvent(void) {
  * @param  None
  * @retval None
  */
-void UpdatePredictionState(void) {
-	uint32_t currentTick = xTaskGetTickCount();
-	float32_t timeSinceLastAccCorrection = ((float32_t)currentTick - accLastCorrectionTick) / configTICK_RATE_HZ;
-	float32_t timeSinceLastMagCorrection = ((float32_t)currentTick - magLastCorrectionTick) / configTICK_RATE_HZ;
+RAMFUNC void UpdatePredictionState(void) {
+	UpdatePredictionStateAt(GetTimestamp());
+}
+
+/*
+ * @brief  State estimation time-update at a given time, e.g. the logged one of a replayed prediction
+ * @param  timestamp : Time of the prediction [core clock cycles], see GetTimestamp()
+ * @retval None
+ */
+RAMFUNC void UpdatePredictionStateAt(const uint32_t timestamp) {
+	PROFILE_SCOPE(PROFILE_PROBE_PREDICTION);
+	SCOPE_PROBE_SCOPE(SCOPE_PROBE_STAGE_PREDICTION);
+
+	predictionTimestamp = timestamp;
+
+#ifdef FCB_STEADY_STATE_KALMAN
+	/* Solving the constant gains takes too long for a control cycle in flight, the retune waits for idle mode */
+	if (isNoiseRetunePending && FLIGHT_CONTROL_IDLE == GetFlightControlMode()) {
+#else
+	if (isNoiseRetunePending) {
+#endif
+		isNoiseRetunePending = 0;
+		RetuneNoise();
+	}
+
+#ifdef FCB_QUATERNION_ATTITUDE_ESTIMATION
+	/* The quaternion is integrated per gyroscope sample, or rotated by their coning compensated rotation here with
+	 * FCB_CONING_COMPENSATION, then only publish its Euler angles */
+	QuaternionAttitudePropagate();
+	QuaternionAttitudeGetAngles(attitudeState.angle);
+	QuaternionAttitudeGetRates(attitudeState.angleRate);
+	QuaternionAttitudeGetRates(attitudeState.angleRateUnbiased);
+
+	UpdateAttitudeTrigCache(attitudeState.angle[ROLL_IDX], attitudeState.angle[PITCH_IDX], attitudeState.angle[YAW_IDX]);
+#else
+	float32_t timeSinceLastAccCorrection = TimestampToSeconds(timestamp - accLastCorrectionTimestamp);
+	float32_t timeSinceLastMagCorrection = TimestampToSeconds(timestamp - magLastCorrectionTimestamp);
+
+	float32_t ctrl[AXES_NPR] = { GetRollControlSignal(), GetPitchControlSignal(), GetYawControlSignal() };
+	float32_t tSinceLastCorrection[AXES_NPR] = { timeSinceLastAccCorrection, timeSinceLastAccCorrection,
+	        timeSinceLastMagCorrection };
+	float32_t const * pAngleIncrement = NULL;
+#ifdef FCB_CONING_COMPENSATION
+	float32_t rotation[3], rotationDt, angleIncrement[AXES_NPR];
+
+	/* The gyroscope samples since the previous prediction rotate the attitude as one coning compensated rotation */
+	if (ConingIntegratorTake(&gyroIntegrator, rotation, &rotationDt) > 0) {
+	    GetEulerAngleIncrement(angleIncrement, attitudeStateInternal.angle, rotation);
+	    pAngleIncrement = angleIncrement;
+	}
+#endif
 
-	/* Run prediction step for attitude estimators */
-    PredictAttitudeState(&rollEstimator, &rollStateInternal, IXX, GetRollControlSignal(), timeSinceLastAccCorrection);
-    PredictAttitudeState(&pitchEstimator, &pitchStateInternal, IYY, GetPitchControlSignal(), timeSinceLastAccCorrection);
-    PredictAttitudeState(&yawEstimator, &yawStateInternal, IZZ, GetYawControlSignal(), timeSinceLastMagCorrection);
+	/* Run prediction step for all attitude estimators */
+    PredictAttitudeStates(ctrl, tSinceLastCorrection, pAngleIncrement);
+
+#ifdef FCB_DELAYED_FUSION
+    stateHistoryNewest = (stateHistoryNewest + 1) % STATE_HISTORY_LENGTH;
+    if (stateHistoryCount < STATE_HISTORY_LENGTH) {
+        stateHistoryCount++;
+    }
+    stateHistory[stateHistoryNewest].timestamp = timestamp;
+    StoreStateHistory(&stateHistory[stateHistoryNewest]);
+#endif
+
+    /* Corrections until the next prediction transform with the trigonometry of the predicted attitude */
+    UpdateAttitudeTrigCache(attitudeStateInternal.angle[ROLL_IDX], attitudeStateInternal.angle[PITCH_IDX],
+            attitudeStateInternal.angle[YAW_IDX]);
+#endif
+
+    /* Remove the drift of the gyroscope propagated DCM w.r.t. the estimated attitude, no trigonometry needed */
+    if (++predictionsSinceDCMAnchor >= DCM_REANCHOR_PREDICTIONS) {
+        UpdateRotationMatrixCached(GetAttitudeTrigCache());
+        predictionsSinceDCMAnchor = 0;
+    }
+
+    if (predictionsSinceInit < UINT32_MAX) {
+        predictionsSinceInit++;
+    }
 }
 
 /* GetRoll
@@ -192,7 +459,7 @@ void UpdatePredictionState(void) {
  * @retval Roll angle state
  */
 float32_t GetRollAngle(void) {
-    return rollState.angle;
+    return attitudeState.angle[ROLL_IDX];
 }
 
 /* GetPitch
@@ -201,7 +468,7 @@ float32_t GetRollAngle(void) {
  * @retval Pitch angle state
  */
 float32_t GetPitchAngle(void) {
-    return pitchState.angle;
+    return attitudeState.angle[PITCH_IDX];
 }
 
 /* GetYaw
@@ -210,7 +477,7 @@ float32_t GetPitchAngle(void) {
  * @retval Yaw angle state
  */
 float32_t GetYawAngle(void) {
-    return yawState.angle;
+    return attitudeState.angle[YAW_IDX];
 }
 
 /*
@@ -219,7 +486,7 @@ float32_t GetYawAngle(void) {
  * @retval Roll rate
  */
 float32_t GetRollRate(void) {
-    return rollState.angleRateUnbiased;
+    return attitudeState.angleRateUnbiased[ROLL_IDX];
 }
 
 /* GetPitch
@@ -228,7 +495,7 @@ float32_t GetRollRate(void) {
  * @retval Pitch rate
  */
 float32_t GetPitchRate(void) {
-    return pitchState.angleRateUnbiased;
+    return attitudeState.angleRateUnbiased[PITCH_IDX];
 }
 
 /* GetYaw
@@ -237,15 +504,537 @@ float32_t GetPitchRate(void) {
  * @retval Yaw rate
  */
 float32_t GetYawRate(void) {
-    return yawState.angleRateUnbiased;
+    return attitudeState.angleRateUnbiased[YAW_IDX];
+}
+
+/*
+ * @brief  Gets the latest gyroscope sample minus the estimated bias, i.e. the body rates without the Euler angle
+ *         rate transformation
+ * @param  dstRates : Destination vector for the roll, pitch and yaw body rates [rad/s]
+ * @retval None
+ */
+void GetUnbiasedBodyRates(float32_t* dstRates) {
+    dstRates[ROLL_IDX] = unbiasedBodyRates[ROLL_IDX];
+    dstRates[PITCH_IDX] = unbiasedBodyRates[PITCH_IDX];
+    dstRates[YAW_IDX] = unbiasedBodyRates[YAW_IDX];
+}
+
+/*
+ * @brief  Gets the vertical position
+ * @param  None
+ * @retval Z position [m], positive downwards
+ */
+float32_t GetZPosition(void) {
+    return verticalState.zPosition;
+}
+
+/*
+ * @brief  Gets the vertical velocity
+ * @param  None
+ * @retval Z velocity [m/s], positive downwards
+ */
+float32_t GetZVelocity(void) {
+    return verticalState.zVelocity;
 }
 
+/*
+ * @brief  Publishes the current states as a snapshot, once per control cycle after its corrections and prediction.
+ *         Must be called by the context updating the states only.
+ * @param  None
+ * @retval None
+ */
+void PublishStateSnapshot(void) {
+    StateSnapshotType snapshot;
+    uint32_t nextSequence = stateSnapshotSequence + 1;
+    uint8_t axis;
+
+    for (axis = 0; axis < AXES_NPR; axis++) {
+        snapshot.angle[axis] = attitudeState.angle[axis];
+        snapshot.angleRate[axis] = attitudeState.angleRate[axis];
+        snapshot.angleRateBias[axis] = attitudeState.angleRateBias[axis];
+        snapshot.angleRateUnbiased[axis] = attitudeState.angleRateUnbiased[axis];
+        snapshot.p11[axis] = attitudeEstimator.p11[axis];
+        snapshot.p22[axis] = attitudeEstimator.p22[axis];
+        snapshot.p33[axis] = attitudeEstimator.p33[axis];
+    }
+    snapshot.zPosition = verticalState.zPosition;
+    snapshot.zVelocity = verticalState.zVelocity;
+    snapshot.timestamp = predictionTimestamp;
+    snapshot.sequence = nextSequence;
+
+    stateSnapshots[nextSequence & 1] = snapshot;
+    FCB_MEMORY_BARRIER();
+    stateSnapshotSequence = nextSequence;
+}
+
+/*
+ * @brief  Gets the latest published state snapshot, i.e. states of the same control cycle. For the readers outside
+ *         the flight control task, the Get...Angle() and Get...Rate() getters read the states as they are updated.
+ * @param  dstSnapshot : Destination snapshot
+ * @retval None
+ */
+void GetStateSnapshot(StateSnapshotType* dstSnapshot) {
+    uint32_t sequence;
+
+    /* The reader is preempted by the flight control task, copy again if a snapshot was published while copying */
+    do {
+        sequence = stateSnapshotSequence;
+        FCB_MEMORY_BARRIER();
+        *dstSnapshot = stateSnapshots[sequence & 1];
+        FCB_MEMORY_BARRIER();
+    } while (sequence != stateSnapshotSequence);
+}
+
+/*
+ * @brief  Gets the parameters of the latest initialization of the estimator
+ * @param  dstInit : Destination for the parameters
+ * @retval None
+ */
+void GetStateInit(StateInitType* dstInit) {
+    *dstInit = stateInit;
+}
+
+/*
+ * @brief  Checks whether the estimates have settled since the latest initialization, see STATE_CONVERGENCE_TIME
+ * @param  None
+ * @retval true if converged, else false
+ */
+bool IsStateEstimationConverged(void) {
+    if ((float32_t) predictionsSinceInit * attitudeEstimator.h < STATE_CONVERGENCE_TIME) {
+        return false;
+    }
+
+#ifndef FCB_QUATERNION_ATTITUDE_ESTIMATION
+    /* The constant gains have converged covariances from the start */
+    if (!useSteadyStateGains && (attitudeEstimator.p11[ROLL_IDX] > STATE_CONVERGED_MAX_ANGLE_VARIANCE
+            || attitudeEstimator.p11[PITCH_IDX] > STATE_CONVERGED_MAX_ANGLE_VARIANCE)) {
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+/*
+ * @brief  Gets the accelerometer correction gate counters
+ * @param  dstStats : Destination for the counters
+ * @retval None
+ */
+void GetAccCorrectionGateStats(AccCorrectionGateStatsType* dstStats) {
+    FCB_ENTER_CRITICAL();
+    *dstStats = accGateStats;
+    FCB_EXIT_CRITICAL();
+}
+
+/*
+ * @brief  Gets the statistics of the samples fused at an earlier prediction, all zero without FCB_DELAYED_FUSION
+ * @param  dstStats : Destination statistics
+ * @retval None
+ */
+void GetDelayedFusionStats(DelayedFusionStatsType* dstStats) {
+    FCB_ENTER_CRITICAL();
+    *dstStats = delayedFusionStats;
+    FCB_EXIT_CRITICAL();
+}
+
+/*
+ * @brief  Gets the current gyroscope biases and error covariances to persist as warm start for the next boot
+ * @param  dstWarmStart : Destination warm start state
+ * @retval FCB_OK if copied, FCB_ERR if the Kalman estimator is not in use
+ */
+FcbRetValType GetStateWarmStart(StateWarmStartType* dstWarmStart) {
+#ifdef FCB_QUATERNION_ATTITUDE_ESTIMATION
+    (void) dstWarmStart;
+    return FCB_ERR;
+#else
+    KalmanFilterBankType * pEstimator = &attitudeEstimator;
+
+    /* Consistent snapshot w.r.t. the flight control task */
+    FCB_ENTER_CRITICAL();
+    memcpy(dstWarmStart->angleRateBias, attitudeStateInternal.angleRateBias, sizeof(dstWarmStart->angleRateBias));
+    memcpy(dstWarmStart->p11, pEstimator->p11, sizeof(dstWarmStart->p11));
+    memcpy(dstWarmStart->p12, pEstimator->p12, sizeof(dstWarmStart->p12));
+    memcpy(dstWarmStart->p13, pEstimator->p13, sizeof(dstWarmStart->p13));
+    memcpy(dstWarmStart->p21, pEstimator->p21, sizeof(dstWarmStart->p21));
+    memcpy(dstWarmStart->p22, pEstimator->p22, sizeof(dstWarmStart->p22));
+    memcpy(dstWarmStart->p23, pEstimator->p23, sizeof(dstWarmStart->p23));
+    memcpy(dstWarmStart->p31, pEstimator->p31, sizeof(dstWarmStart->p31));
+    memcpy(dstWarmStart->p32, pEstimator->p32, sizeof(dstWarmStart->p32));
+    memcpy(dstWarmStart->p33, pEstimator->p33, sizeof(dstWarmStart->p33));
+    FCB_EXIT_CRITICAL();
+
+    return FCB_OK;
+#endif
+}
+
+/*
+ * @brief  Starts the estimator from persisted gyroscope biases and error covariances instead of the default ones
+ * @note   Must be called after InitStatesXYZ(), which it partly overrides
+ * @param  warmStart : Warm start state, e.g. read from flash
+ * @retval FCB_OK if the states were warm started, FCB_ERR if the warm start state is not plausible
+ */
+FcbRetValType WarmStartStates(const StateWarmStartType* warmStart) {
+#ifdef FCB_QUATERNION_ATTITUDE_ESTIMATION
+    (void) warmStart;
+    return FCB_ERR;
+#else
+    KalmanFilterBankType * pEstimator = &attitudeEstimator;
+    uint8_t axis;
+
+    for (axis = 0; axis < AXES_NPR; axis++) {
+        /* Covariance diagonal must be positive, which also rejects NaN */
+        if (!(fabsf(warmStart->angleRateBias[axis]) <= STATE_WARM_START_MAX_BIAS)
+                || !(warmStart->p11[axis] > 0.0f) || !(warmStart->p22[axis] > 0.0f) || !(warmStart->p33[axis] > 0.0f)) {
+            return FCB_ERR;
+        }
+    }
+
+    for (axis = 0; axis < AXES_NPR; axis++) {
+        pEstimator->p11[axis] = warmStart->p11[axis];
+        pEstimator->p12[axis] = warmStart->p12[axis];
+        pEstimator->p13[axis] = warmStart->p13[axis];
+        pEstimator->p21[axis] = warmStart->p21[axis];
+        pEstimator->p22[axis] = warmStart->p22[axis];
+        pEstimator->p23[axis] = warmStart->p23[axis];
+        pEstimator->p31[axis] = warmStart->p31[axis];
+        pEstimator->p32[axis] = warmStart->p32[axis];
+        pEstimator->p33[axis] = warmStart->p33[axis];
+
+        attitudeStateInternal.angleRateBias[axis] = warmStart->angleRateBias[axis];
+        attitudeStateInternal.angleRateUnbiased[axis] = attitudeStateInternal.angleRate[axis]
+                - attitudeStateInternal.angleRateBias[axis];
+        attitudeState.angleRateBias[axis] = attitudeStateInternal.angleRateBias[axis];
+        attitudeState.angleRateUnbiased[axis] = attitudeStateInternal.angleRateUnbiased[axis];
+    }
+
+    return FCB_OK;
+#endif
+}
+
+
+/*
+ * @brief  Starts the gyroscope bias states from biases measured at rest, e.g. the mean gyroscope reading during the
+ *         startup, instead of having the estimator converge to them from zero or the warm start biases
+ * @note   Must be called after InitStatesXYZ() and WarmStartStates(). The bias error covariances are kept.
+ * @param  biases : Measured gyroscope biases [rad/s]
+ * @retval FCB_OK if the biases were seeded, FCB_ERR if they are not plausible
+ */
+FcbRetValType SeedGyroBiases(const float32_t biases[AXES_NPR]) {
+#ifdef FCB_QUATERNION_ATTITUDE_ESTIMATION
+    (void) biases;
+    return FCB_ERR;
+#else
+    uint8_t axis;
+
+    for (axis = 0; axis < AXES_NPR; axis++) {
+        /* Also rejects NaN */
+        if (!(fabsf(biases[axis]) <= STATE_WARM_START_MAX_BIAS)) {
+            return FCB_ERR;
+        }
+    }
+
+    /* The bias states are Euler angle rates, which equal body rates at rest on level ground */
+    for (axis = 0; axis < AXES_NPR; axis++) {
+        attitudeStateInternal.angleRateBias[axis] = biases[axis];
+        attitudeStateInternal.angleRateUnbiased[axis] = attitudeStateInternal.angleRate[axis]
+                - attitudeStateInternal.angleRateBias[axis];
+        attitudeState.angleRateBias[axis] = attitudeStateInternal.angleRateBias[axis];
+        attitudeState.angleRateUnbiased[axis] = attitudeStateInternal.angleRateUnbiased[axis];
+    }
+
+    return FCB_OK;
+#endif
+}
+
+/*
+ * @brief  Starts the sensor noise characterisation, which runs on the samples passed to the estimator
+ * @note   The UAV must be at rest on the ground for the whole duration, it stops if it moves
+ * @param  duration : Of the characterisation, SENSOR_NOISE_MIN_DURATION to SENSOR_NOISE_MAX_DURATION [s]
+ * @retval FCB_OK if started, FCB_ERR if flight control is not idle or the duration is out of range
+ */
+FcbRetValType StartSensorNoiseCharacterisation(const float32_t duration) {
+    if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()
+            || !(duration >= SENSOR_NOISE_MIN_DURATION && duration <= SENSOR_NOISE_MAX_DURATION)) {
+        return FCB_ERR;
+    }
+
+    FCB_ENTER_CRITICAL();
+    memset(sensorVariance, 0, sizeof(sensorVariance));
+    sensorNoiseDuration = duration;
+    sensorNoiseElapsed = 0.0f;
+    sensorNoiseStatus = SENSOR_NOISE_RUNNING;
+    FCB_EXIT_CRITICAL();
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Gets the status and the result of the latest sensor noise characterisation
+ * @param  dstNoise : Destination for the result, only valid if SENSOR_NOISE_DONE is returned
+ * @retval Status of the characterisation
+ */
+SensorNoiseStatusType GetSensorNoise(SensorNoiseType* dstNoise) {
+    SensorNoiseStatusType status;
+
+    FCB_ENTER_CRITICAL();
+    *dstNoise = sensorNoise;
+    status = sensorNoiseStatus;
+    FCB_EXIT_CRITICAL();
+
+    return status;
+}
+
+/*
+ * @brief  Seeds the measurement noise of the following InitStatesXYZ() calls from a characterisation, e.g. as read
+ *         from flash. The variances are clamped to SENSOR_NOISE_MAX_RATIO of the hand-tuned defaults.
+ * @param  noise : Result of a characterisation
+ * @retval FCB_OK if seeded, FCB_ERR if a variance is not positive
+ */
+FcbRetValType SeedSensorNoise(const SensorNoiseType* noise) {
+    uint8_t axis;
+
+    for (axis = 0; axis < AXES_NPR; axis++) {
+        /* Also rejects NaN */
+        if (!(noise->r1[axis] > 0.0f && noise->r2[axis] > 0.0f)) {
+            return FCB_ERR;
+        }
+    }
+
+    seededR1[ROLL_IDX] = ClampNoiseVariance(noise->r1[ROLL_IDX], R1_ACCRP);
+    seededR1[PITCH_IDX] = ClampNoiseVariance(noise->r1[PITCH_IDX], R1_ACCRP);
+    seededR1[YAW_IDX] = ClampNoiseVariance(noise->r1[YAW_IDX], R1_MAG);
+    seededR2[ROLL_IDX] = ClampNoiseVariance(noise->r2[ROLL_IDX], GYRO_X_AXIS_VARIANCE);
+    seededR2[PITCH_IDX] = ClampNoiseVariance(noise->r2[PITCH_IDX], GYRO_Y_AXIS_VARIANCE);
+    seededR2[YAW_IDX] = ClampNoiseVariance(noise->r2[YAW_IDX], GYRO_Z_AXIS_VARIANCE);
+    isSensorNoiseSeeded = 1;
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Prints the status and the result of the latest sensor noise characterisation, and the measurement noise
+ *         the estimator was initialized with
+ * @param  dst : Destination string
+ * @param  dstSize : Size of the destination
+ * @retval Length of the string, as snprintf
+ */
+size_t PrintSensorNoise(char* dst, const size_t dstSize) {
+    static const char* sensorNames[FCB_SENSOR_NBR] = { "gyro", "acc", "mag", "baro" };
+    static const char* statusNames[] = { "not run", "running", "done", "stopped, not at rest",
+            "stopped, too few samples" };
+    SensorNoiseType noise;
+    SensorNoiseStatusType status;
+    StateInitType init;
+    char values[6][16];
+    size_t length;
+    uint8_t sensor, axis;
+
+    status = GetSensorNoise(&noise);
+    GetStateInit(&init);
+
+    length = (size_t) snprintf(dst, dstSize, "\nSensor noise characterisation: %s", statusNames[status]);
+    if (SENSOR_NOISE_RUNNING == status && length < dstSize) {
+        length += (size_t) snprintf(dst + length, dstSize - length, " (%u of %u s)",
+                (unsigned int) sensorNoiseElapsed, (unsigned int) sensorNoiseDuration);
+    }
+    if (length < dstSize) {
+        length += (size_t) snprintf(dst + length, dstSize - length, "\n");
+    }
+
+    if (SENSOR_NOISE_DONE == status) {
+        for (sensor = 0; sensor < FCB_SENSOR_NBR && length < dstSize; sensor++) {
+            for (axis = 0; axis < 3; axis++) {
+                FormatFixed(values[axis], sizeof(values[axis]), noise.mean[sensor][axis], 4);
+                FormatFixed(values[3 + axis], sizeof(values[3 + axis]), 1.0e6f*noise.variance[sensor][axis], 3);
+            }
+            length += (size_t) snprintf(dst + length, dstSize - length,
+                    "%-5s samples:%u, mean: %s, %s, %s, variance: %s, %s, %s [1e-6]\n", sensorNames[sensor],
+                    (unsigned int) noise.samples[sensor], values[0], values[1], values[2], values[3], values[4],
+                    values[5]);
+        }
+        for (axis = 0; axis < AXES_NPR; axis++) {
+            FormatFixed(values[axis], sizeof(values[axis]), 1.0e6f*noise.r1[axis], 3);
+            FormatFixed(values[3 + axis], sizeof(values[3 + axis]), 1.0e6f*noise.r2[axis], 3);
+        }
+        if (length < dstSize) {
+            length += (size_t) snprintf(dst + length, dstSize - length,
+                    "measured R1 (RPY): %s, %s, %s, R2: %s, %s, %s [1e-6]\n", values[0], values[1], values[2],
+                    values[3], values[4], values[5]);
+        }
+    }
+
+    for (axis = 0; axis < AXES_NPR; axis++) {
+        FormatFixed(values[axis], sizeof(values[axis]), 1.0e6f*init.r1[axis], 3);
+        FormatFixed(values[3 + axis], sizeof(values[3 + axis]), 1.0e6f*init.r2[axis], 3);
+    }
+    if (length < dstSize) {
+        length += (size_t) snprintf(dst + length, dstSize - length,
+                "in use%s R1 (RPY): %s, %s, %s, R2: %s, %s, %s [1e-6]\n", isSensorNoiseSeeded ? " (seeded)" : "",
+                values[0], values[1], values[2], values[3], values[4], values[5]);
+    }
+
+    return length;
+}
+
+/*
+ * @brief  Loads the stored noise parameters, or keeps the defaults if there are none or a value is out of range.
+ *         Called by the flight control task at startup, before the estimator is initialized.
+ * @param  None
+ * @retval None
+ */
+void InitEstimatorNoise(void) {
+    EstimatorNoiseSettingsType settings;
+    const float32_t* values = (const float32_t*) &settings; // All fields are floats
+    uint8_t i;
+
+    if (FLASH_OK != ReadEstimatorNoiseFromFlash(&settings)) {
+        return;
+    }
+
+    for (i = 0; i < sizeof(settings) / sizeof(float32_t); i++) {
+        /* Also rejects NaN */
+        if (!(values[i] >= 0.0f && values[i] <= ESTIMATOR_NOISE_PARAM_MAX)) {
+            return;
+        }
+    }
+
+    noiseSettings = settings;
+}
+
+/*
+ * @brief  Gets the noise parameters, for the parameter table. EST_Q* are the process noise of roll and pitch (RP), yaw
+ *         (Y) and the angle rate biases, EST_R1_* and EST_R2_* the attitude and attitude rate measurement noise of
+ *         each axis, 0 for the characterised or default variance.
+ * @param  None
+ * @retval The parameter group
+ */
+const ParamGroup_TypeDef* GetEstimatorNoiseParamGroup(void) {
+    return &noiseParamGroup;
+}
 
 /* Private functions ---------------------------------------------------------*/
 
 /*
- * @brief  Initializes an angular state Kalman estimator
- * @param  Estimator : Kalman estimator struct
+ * @brief  Adds a sample to the running mean and variance of its sensor, and stops the characterisation if the UAV
+ *         is not at rest or once the duration has passed
+ * @param  sensor : Sensor of the sample
+ * @param  pXYZ : Sample as passed to UpdateCorrectionState(), the altitude for the barometer
+ * @param  timestamp : Time the sample was taken [core clock cycles]
+ * @retval None
+ */
+static void UpdateSensorNoise(FcbSensorIndexType sensor, float32_t const * pXYZ, uint32_t const timestamp) {
+    static uint32_t lastGyroTimestamp = 0;
+    FcbSensorVarianceCalcType* pVariance = &sensorVariance[sensor];
+    uint8_t const axes = (BARO_IDX == sensor) ? 1 : 3;
+    float32_t deviation, accNormSquared;
+    uint8_t axis;
+
+    if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        sensorNoiseStatus = SENSOR_NOISE_MOVED;
+        return;
+    }
+
+    /* At rest, as for the warm start: the gyroscope readings stay close to their mean and the accelerometer only
+     * measures gravity */
+    if (GYRO_IDX == sensor && pVariance->samples > 0) {
+        for (axis = 0; axis < 3; axis++) {
+            if (fabsf(pXYZ[axis] - pVariance->mean[axis]) > STATE_WARM_START_MAX_GYRO_DEVIATION) {
+                sensorNoiseStatus = SENSOR_NOISE_MOVED;
+                return;
+            }
+        }
+    } else if (ACC_IDX == sensor) {
+        accNormSquared = pXYZ[0]*pXYZ[0] + pXYZ[1]*pXYZ[1] + pXYZ[2]*pXYZ[2];
+        if (fabsf(sqrtf(accNormSquared) - G_ACC) > STATE_WARM_START_ACC_NORM_TOLERANCE*G_ACC) {
+            sensorNoiseStatus = SENSOR_NOISE_MOVED;
+            return;
+        }
+    }
+
+    pVariance->samples++;
+    for (axis = 0; axis < axes; axis++) {
+        deviation = pXYZ[axis] - pVariance->mean[axis];
+        pVariance->mean[axis] += deviation / pVariance->samples;
+        pVariance->m2[axis] += deviation * (pXYZ[axis] - pVariance->mean[axis]);
+    }
+
+    if (GYRO_IDX == sensor) {
+        if (pVariance->samples > 1) {
+            sensorNoiseElapsed += TimestampToSeconds(timestamp - lastGyroTimestamp);
+        }
+        lastGyroTimestamp = timestamp;
+        if (sensorNoiseElapsed >= sensorNoiseDuration) {
+            FinishSensorNoise();
+        }
+    }
+}
+
+/*
+ * @brief  Computes the result of the characterisation from the running statistics, the roll, pitch & yaw noise as
+ *         the first order propagation of the sensor noise through the attitude computation at the mean sample
+ * @param  None
+ * @retval None
+ */
+static void FinishSensorNoise(void) {
+    SensorNoiseType noise;
+    float32_t const * accMean;
+    float32_t const * accVariance;
+    float32_t const * magMean;
+    float32_t const * magVariance;
+    float32_t yzSquared, accNormSquared, xySquared;
+    uint8_t sensor, axis;
+
+    for (sensor = 0; sensor < FCB_SENSOR_NBR; sensor++) {
+        noise.samples[sensor] = sensorVariance[sensor].samples;
+        for (axis = 0; axis < 3; axis++) {
+            noise.mean[sensor][axis] = sensorVariance[sensor].mean[axis];
+            noise.variance[sensor][axis] = (sensorVariance[sensor].samples > 1) ?
+                    sensorVariance[sensor].m2[axis] / (sensorVariance[sensor].samples - 1) : 0.0f;
+        }
+        if (BARO_IDX != sensor && noise.samples[sensor] < SENSOR_NOISE_MIN_SAMPLES) {
+            sensorNoiseStatus = SENSOR_NOISE_TOO_FEW_SAMPLES;
+            return;
+        }
+    }
+
+    /* Roll = atan2(-ay, -az) and pitch = asin(ax / |a|), see GetAttitudeFromAccelerometer() */
+    accMean = noise.mean[ACC_IDX];
+    accVariance = noise.variance[ACC_IDX];
+    yzSquared = accMean[1]*accMean[1] + accMean[2]*accMean[2];
+    accNormSquared = yzSquared + accMean[0]*accMean[0];
+    noise.r1[ROLL_IDX] = (accMean[2]*accMean[2]*accVariance[1] + accMean[1]*accMean[1]*accVariance[2])
+            / (yzSquared*yzSquared);
+    noise.r1[PITCH_IDX] = (yzSquared*yzSquared*accVariance[0] + accMean[0]*accMean[0]*(accMean[1]*accMean[1]
+            *accVariance[1] + accMean[2]*accMean[2]*accVariance[2])) / (yzSquared*accNormSquared*accNormSquared);
+
+    /* Yaw from the horizontal field components at rest on level ground */
+    magMean = noise.mean[MAG_IDX];
+    magVariance = noise.variance[MAG_IDX];
+    xySquared = magMean[0]*magMean[0] + magMean[1]*magMean[1];
+    noise.r1[YAW_IDX] = (magMean[0]*magMean[0]*magVariance[1] + magMean[1]*magMean[1]*magVariance[0])
+            / (xySquared*xySquared);
+
+    /* The rate states are Euler angle rates, which equal body rates at rest on level ground */
+    for (axis = 0; axis < AXES_NPR; axis++) {
+        noise.r2[axis] = noise.variance[GYRO_IDX][axis];
+    }
+
+    sensorNoise = noise;
+    sensorNoiseStatus = SENSOR_NOISE_DONE;
+}
+
+static float32_t ClampNoiseVariance(float32_t const variance, float32_t const defaultVariance) {
+    if (variance < defaultVariance / SENSOR_NOISE_MAX_RATIO) {
+        return defaultVariance / SENSOR_NOISE_MAX_RATIO;
+    } else if (variance > defaultVariance * SENSOR_NOISE_MAX_RATIO) {
+        return defaultVariance * SENSOR_NOISE_MAX_RATIO;
+    }
+    return variance;
+}
+
+/*
+ * @brief  Initializes the angular state Kalman estimator of one axis
+ * @param  axis : Roll, pitch or yaw index into the estimator bank
  * @param  q1 : Attitude state model noise variance
  * @param  q2 : Attitude rate state model noise variance
  * @param  q3 : Bias state model noise variance
@@ -253,71 +1042,237 @@ float32_t GetYawRate(void) {
  * @param  r2 : Attitude rate sensor noise variance
  * @retval None
  */
-static void StateInit(KalmanFilterType * Estimator, float32_t q1, float32_t q2, float32_t q3, float32_t r1, float32_t r2) {
+static void StateInit(FcbRPYIndexType axis, float32_t q1, float32_t q2, float32_t q3, float32_t r1, float32_t r2) {
+    KalmanFilterBankType * pEstimator = &attitudeEstimator;
+
     /* P matrix init is the Identity matrix*/
-    Estimator->p11 = 0.1;
-    Estimator->p12 = 0.0;
-    Estimator->p13 = 0.0;
-    Estimator->p21 = 0.0;
-    Estimator->p22 = 1.0;
-    Estimator->p23 = 0.0;
-    Estimator->p31 = 0.0;
-    Estimator->p32 = 0.0;
-    Estimator->p33 = 0.01;
+    pEstimator->p11[axis] = 0.1f;
+    pEstimator->p12[axis] = 0.0f;
+    pEstimator->p13[axis] = 0.0f;
+    pEstimator->p21[axis] = 0.0f;
+    pEstimator->p22[axis] = 1.0f;
+    pEstimator->p23[axis] = 0.0f;
+    pEstimator->p31[axis] = 0.0f;
+    pEstimator->p32[axis] = 0.0f;
+    pEstimator->p33[axis] = GYRO_BIAS_INIT_VARIANCE;
+
+    pEstimator->q1[axis] = q1;
+    pEstimator->q2[axis] = q2;
+    pEstimator->q3[axis] = q3;
+    pEstimator->r1[axis] = r1;
+    pEstimator->r2[axis] = r2;
+}
 
-    Estimator->q1 = q1;
-    Estimator->q2 = q2;
-    Estimator->q3 = q3;
-    Estimator->r1 = r1;
-    Estimator->r2 = r2;
+/*
+ * @brief  Sets the noise of the attitude estimators and resets their error covariances
+ * @param  init : Initialization holding the noise
+ * @retval None
+ */
+static void InitAttitudeNoise(const StateInitType* init) {
+    StateInit(ROLL_IDX, init->q1[ROLL_IDX], init->q2[ROLL_IDX], init->q3[ROLL_IDX], init->r1[ROLL_IDX],
+            init->r2[ROLL_IDX]);
+    StateInit(PITCH_IDX, init->q1[PITCH_IDX], init->q2[PITCH_IDX], init->q3[PITCH_IDX], init->r1[PITCH_IDX],
+            init->r2[PITCH_IDX]);
+    StateInit(YAW_IDX, init->q1[YAW_IDX], init->q2[YAW_IDX], init->q3[YAW_IDX], init->r1[YAW_IDX] / MAG_DECIMATION,
+            init->r2[YAW_IDX]);
+    accNoiseR1 = 0.5f*(init->r1[ROLL_IDX] + init->r1[PITCH_IDX]);
+}
 
-    Estimator->h = 1.0/((float32_t)(SystemCoreClock/(STATE_ESTIMATION_TIME_UPDATE_PERIOD+1)/STATE_ESTIMATION_TIME_UPDATE_PRESCALER));
+/*
+ * @brief  Sets the noise of an initialization from the noise parameters. A measurement noise parameter of 0 gives the
+ *         seeded characterisation, or the hand-tuned default.
+ * @param  init : Initialization to set the noise of
+ * @retval None
+ */
+static void SetInitNoise(StateInitType* init) {
+    float32_t r1[AXES_NPR] = { R1_ACCRP, R1_ACCRP, R1_MAG };
+    float32_t r2[AXES_NPR] = { GYRO_X_AXIS_VARIANCE, GYRO_Y_AXIS_VARIANCE, GYRO_Z_AXIS_VARIANCE };
+    uint8_t axis;
+
+    if (isSensorNoiseSeeded) {
+        memcpy(r1, seededR1, sizeof(r1));
+        memcpy(r2, seededR2, sizeof(r2));
+    }
+
+    for (axis = 0; axis < AXES_NPR; axis++) {
+        init->r1[axis] = (noiseSettings.r1[axis] > 0.0f) ? noiseSettings.r1[axis] : r1[axis];
+        init->r2[axis] = (noiseSettings.r2[axis] > 0.0f) ? noiseSettings.r2[axis] : r2[axis];
+        init->q3[axis] = noiseSettings.q3;
+    }
+    init->q1[ROLL_IDX] = init->q1[PITCH_IDX] = noiseSettings.q1RollPitch;
+    init->q2[ROLL_IDX] = init->q2[PITCH_IDX] = noiseSettings.q2RollPitch;
+    init->q1[YAW_IDX] = noiseSettings.q1Yaw;
+    init->q2[YAW_IDX] = noiseSettings.q2Yaw;
+}
+
+/*
+ * @brief  Applies the noise parameters to the running estimator between two predictions and resets the error
+ *         covariances, the states are kept. The latest initialization takes the new noise, so that a capture started
+ *         later logs it. A capture already running is not told, its replay diverges from the retune on.
+ * @param  None
+ * @retval None
+ */
+static void RetuneNoise(void) {
+#ifdef FCB_STEADY_STATE_KALMAN
+    AttitudeStatesType states;
+#endif
+
+    SetInitNoise(&stateInit);
+    InitAttitudeNoise(&stateInit);
+#ifdef FCB_DELAYED_FUSION
+    /* The history holds the covariances of the old noise */
+    stateHistoryCount = 0;
+#endif
+
+#ifdef FCB_STEADY_STATE_KALMAN
+    /* The solver runs the filter on the states */
+    states = attitudeStateInternal;
+    useSteadyStateGains = 0;
+    SolveSteadyStateGains();
+    useSteadyStateGains = 1;
+    attitudeStateInternal = states;
+#endif
+}
+
+/*
+ * @brief  Has the next prediction retune the estimator. The apply function of the parameter group, called with the
+ *         scheduler suspended.
+ * @param  None
+ * @retval None
+ */
+static void RequestNoiseRetune(void) {
+    isNoiseRetunePending = 1;
+}
+
+/*
+ * @brief  Saves the noise parameters to flash
+ * @param  None
+ * @retval FCB_OK if saved, else FCB_ERR
+ */
+static FcbRetValType SaveNoiseParams(void) {
+    EstimatorNoiseSettingsType settings = noiseSettings;
+
+    return FLASH_OK == WriteEstimatorNoiseToFlash(&settings) ? FCB_OK : FCB_ERR;
 }
 
 /*
  * @brief  State estimation sensor value update
  * @param  sensorType : Type of sensor (accelerometer, gyroscope, magnetometer)
  * @param  pXYZ : Pointer to sensor values array
+ * @param  timestamp : Time the sensor sample was taken [core clock cycles]
  * @retval None
  */
-void UpdateCorrectionState(FcbSensorIndexType sensorType, float32_t const * pXYZ) {
+RAMFUNC void UpdateCorrectionState(FcbSensorIndexType sensorType, float32_t const * pXYZ, uint32_t timestamp) {
+    PROFILE_SCOPE(PROFILE_PROBE_CORRECTION);
+    SCOPE_PROBE_SCOPE(SCOPE_PROBE_STAGE_CORRECTION);
+
+    if (SENSOR_NOISE_RUNNING == sensorNoiseStatus) {
+        UpdateSensorNoise(sensorType, pXYZ, timestamp);
+    }
 
     switch (sensorType) { /* interpret values according to sensor type */
     case GYRO_IDX: {
+        float32_t const timeSinceLastGyroSample = TimestampToSeconds(timestamp - gyroLastCorrectionTimestamp);
+#ifdef FCB_QUATERNION_ATTITUDE_ESTIMATION
+        QuaternionAttitudeUpdateGyro(pXYZ, timeSinceLastGyroSample);
+        QuaternionAttitudeGetRates(unbiasedBodyRates);
+#else
         /* run correction step */
         float32_t const * pSensorAngleRate = pXYZ;
         TransformationErrorStatus status = TRANSF_OK;
-        status = GetEulerAngularRates(sensorAttitudeRateRPY, pSensorAngleRate, GetRollAngle(), GetPitchAngle());
+        uint8_t axis;
+        status = GetEulerAngularRatesCached(sensorAttitudeRateRPY, pSensorAngleRate, GetAttitudeTrigCache());
         if (status != TRANSF_OK) {
             ErrorHandler();
         }
 
-        CorrectAttitudeRateState(sensorAttitudeRateRPY[ROLL_IDX], &rollEstimator, &rollStateInternal, &rollState);
-        CorrectAttitudeRateState(sensorAttitudeRateRPY[PITCH_IDX], &pitchEstimator, &pitchStateInternal, &pitchState);
-        CorrectAttitudeRateState(sensorAttitudeRateRPY[YAW_IDX], &yawEstimator, &yawStateInternal, &yawState);
+#ifdef FCB_REDUNDANT_GYRO
+        ReopenGyroBiasOnSourceChange();
+#endif
+        CorrectAttitudeRateStates(sensorAttitudeRateRPY);
+
+        /* The bias states are Euler angle rates, which equal body rates for small roll and pitch angles */
+        for (axis = 0; axis < AXES_NPR; axis++) {
+            unbiasedBodyRates[axis] = pXYZ[axis] - attitudeStateInternal.angleRateBias[axis];
+        }
+#ifdef FCB_CONING_COMPENSATION
+        ConingIntegratorUpdate(&gyroIntegrator, unbiasedBodyRates, MIN(timeSinceLastGyroSample, DCM_UPDATE_MAX_DT));
+#endif
+#endif
+        /* Propagate the DCM with the gyroscope between the re-anchorings to the estimated attitude */
+        UpdateRotationMatrixFromGyro(unbiasedBodyRates, MIN(timeSinceLastGyroSample, DCM_UPDATE_MAX_DT));
+
+        gyroLastCorrectionTimestamp = timestamp;
     }
         break;
     case ACC_IDX: {
         /* run correction step */
         float32_t const * pAccMeterXYZ = pXYZ; /* interpret values as accelerations */
+        float32_t const noiseScale = AccVibrationNoiseScale();
+        float32_t inertialAcc[3];
+        if (SensorStalledSinceCorrection(ACC_IDX)) {
+            accLastCorrectionTimestamp = timestamp;
+            break;
+        }
+#ifdef FCB_QUATERNION_ATTITUDE_ESTIMATION
+        /* the correction gains scale with the time step */
+        QuaternionAttitudeCorrectAcc(pAccMeterXYZ,
+                TimestampToSeconds(timestamp - accLastCorrectionTimestamp) / noiseScale);
+#else
         GetAttitudeFromAccelerometer(sensorAttitudeRPY, pAccMeterXYZ);
-        CorrectAttitudeState(sensorAttitudeRPY[ROLL_IDX], &rollEstimator, &rollStateInternal, &rollState);
-        CorrectAttitudeState(sensorAttitudeRPY[PITCH_IDX], &pitchEstimator, &pitchStateInternal, &pitchState);
+        FuseAttitudeSample(sensorAttitudeRPY, ROLL_IDX, PITCH_IDX, noiseScale, pAccMeterXYZ, timestamp);
+#endif
+        /* Measured specific force in the inertial (NED) frame, e.g. -G_ACC along Z at rest */
+        Vector3DBodyToInertial(inertialAcc, pAccMeterXYZ);
+        PredictVerticalStates(inertialAcc, TimestampToSeconds(timestamp - accLastCorrectionTimestamp));
+#ifdef FCB_GPS
+        PositionEstimationPredict(inertialAcc, TimestampToSeconds(timestamp - accLastCorrectionTimestamp));
+        PositionEstimationCorrectGps();
+#endif
 
-        accLastCorrectionTick = xTaskGetTickCount();
+        accLastCorrectionTimestamp = timestamp;
     }
         break;
     case MAG_IDX: {
         /* run correction step */
         float32_t const * pMagMeter = pXYZ;
-        sensorAttitudeRPY[YAW_IDX] = GetMagYawAngle((float32_t*) pMagMeter, GetRollAngle(), GetPitchAngle());
-        CorrectAttitudeState(sensorAttitudeRPY[YAW_IDX], &yawEstimator, &yawStateInternal, &yawState);
+        float32_t noiseScale;
+        if (SensorStalledSinceCorrection(MAG_IDX)) {
+            magLastCorrectionTimestamp = timestamp;
+            break;
+        }
+        /* A disturbed sample is skipped, the yaw is predicted from the gyroscope until the field is clean again */
+        noiseScale = MagHeadingNoiseScale(pMagMeter, GetAttitudeTrigCache());
+        if (0.0f == noiseScale) {
+            magLastCorrectionTimestamp = timestamp;
+            break;
+        }
+#ifdef FCB_QUATERNION_ATTITUDE_ESTIMATION
+        QuaternionAttitudeCorrectMag((float32_t*) pMagMeter,
+                TimestampToSeconds(timestamp - magLastCorrectionTimestamp) / noiseScale);
+#else
+        /* True heading, the declination turns the magnetic one */
+        sensorAttitudeRPY[YAW_IDX] = GetMagYawAngleCached((float32_t*) pMagMeter, GetAttitudeTrigCache())
+                + GetMagDeclination();
+        toMaxRadian(&sensorAttitudeRPY[YAW_IDX]);
+        FuseAttitudeSample(sensorAttitudeRPY, YAW_IDX, YAW_IDX, noiseScale, NULL, timestamp);
+#endif
 
-        magLastCorrectionTick = xTaskGetTickCount();
+        magLastCorrectionTimestamp = timestamp;
     }
         break;
     case BARO_IDX: {
+        /* run correction step */
+        if (SensorStalledSinceCorrection(BARO_IDX)) {
+            baroLastCorrectionTimestamp = timestamp;
+            break;
+        }
+        CorrectVerticalStates(pXYZ[0], TimestampToSeconds(timestamp - baroLastCorrectionTimestamp));
+#ifdef FCB_GPS
+        PositionEstimationCorrectBaro(pXYZ[0]);
+#endif
 
+        baroLastCorrectionTimestamp = timestamp;
     }
     	break;
     default:
@@ -326,254 +1281,661 @@ void UpdateCorrectionState(FcbSensorIndexType sensorType, float32_t const * pXYZ
 }
 
 /*
- * @brief	Performs the prediction step of the Kalman filtering.
- * @param 	pEstimator: Pointer to KalmanFilterType struct (roll pitch or yaw estimator)
- * @param 	pState: Pointer to struct member of AngleStateVectorType (roll, pitch or yaw)
- * @param   inertia: Rotational inertia around axis
- * @param   ctrl: Physical control action ([Nm] for attitude)
+ * @brief  Checks if the sensor watchdog found a sensor stalled since its latest correction. The first
+ *         sample after a stall then only restarts the correction interval, a correction over the whole
+ *         stall would integrate a stale interval. The gyroscope interval is limited by DCM_UPDATE_MAX_DT.
+ * @param  sensor : Sensor index
+ * @retval 1 if stalled since the latest correction, else 0
+ */
+static RAMFUNC uint8_t SensorStalledSinceCorrection(FcbSensorIndexType sensor) {
+    uint32_t const stalls = GetSensorStalls(sensor);
+
+    if (stalls == correctionStalls[sensor]) {
+        return 0;
+    }
+
+    correctionStalls[sensor] = stalls;
+    return 1;
+}
+
+#if defined(FCB_REDUNDANT_GYRO) && !defined(FCB_QUATERNION_ATTITUDE_ESTIMATION)
+/*
+ * @brief  Opens the bias estimate again after the gyroscope voting changed the gyroscope of an axis. The bias
+ *         difference of the two is only estimated by the voting, so the bias states are given their initial error
+ *         covariance and converge from their current value. The steady state gains have no covariances to reset.
+ * @param  None
+ * @retval None
+ */
+static void ReopenGyroBiasOnSourceChange(void) {
+    KalmanFilterBankType * pEstimator = &attitudeEstimator;
+    uint32_t const changes = GetGyroVoteSourceChanges();
+    uint8_t axis;
+
+    if (changes == correctionGyroSourceChanges) {
+        return;
+    }
+    correctionGyroSourceChanges = changes;
+
+    if (useSteadyStateGains) {
+        return;
+    }
+
+    for (axis = 0; axis < AXES_NPR; axis++) {
+        pEstimator->p13[axis] = 0.0f;
+        pEstimator->p23[axis] = 0.0f;
+        pEstimator->p31[axis] = 0.0f;
+        pEstimator->p32[axis] = 0.0f;
+        pEstimator->p33[axis] = GYRO_BIAS_INIT_VARIANCE;
+    }
+}
+#endif
+
+/*
+ * @brief  Gets the factor the attitude noise of an accelerometer sample is inflated with for the vibration measured
+ *         by the vibration monitor, see STATE_ACC_VIBRATION_MAX_NOISE_SCALE
+ * @param  None
+ * @retval Factor, 1 to STATE_ACC_VIBRATION_MAX_NOISE_SCALE
+ */
+static RAMFUNC float32_t AccVibrationNoiseScale(void) {
+    float32_t noiseScale = STATE_ACC_VIBRATION_MAX_NOISE_SCALE;
+
+    if (!IsVibrationClipping(ACC_IDX)) {
+        noiseScale = MIN(1.0f + GetVibrationVariance(ACC_IDX) / (G_ACC*G_ACC*accNoiseR1),
+                STATE_ACC_VIBRATION_MAX_NOISE_SCALE);
+    }
+
+    accGateStats.noiseScale = noiseScale;
+    return noiseScale;
+}
+
+#ifndef FCB_QUATERNION_ATTITUDE_ESTIMATION
+/*
+ * @brief	Performs the prediction step of the Kalman filtering for roll, pitch & yaw in one pass.
+ * @param   ctrl: Physical control actions ([Nm] for attitude)
+ * @param   tSinceLastCorrection: Time since the last attitude correction of each axis [s]
+ * @param   pAngleIncrement: Angle increments of the gyroscope rotation since the previous prediction, see
+ *          FCB_CONING_COMPENSATION, or NULL to integrate the angle rate states per axis
  * @retval 	None
  */
-static void PredictAttitudeState(KalmanFilterType* pEstimator,
-                                 AttitudeStateVectorType * pState,
-                                 float32_t const inertia,
-                                 float32_t const ctrl,
-                                 float32_t const tSinceLastCorrection) {
-    float32_t p11_tmp = pEstimator->p11;
-    float32_t p12_tmp = pEstimator->p12;
-    float32_t p13_tmp = pEstimator->p13;
-    float32_t p21_tmp = pEstimator->p21;
-    float32_t p22_tmp = pEstimator->p22;
-    float32_t p23_tmp = pEstimator->p23;
-    float32_t p31_tmp = pEstimator->p31;
-    float32_t p32_tmp = pEstimator->p32;
-    float32_t p33_tmp = pEstimator->p33;
-    float32_t h = pEstimator->h;
-    float32_t deltaT = MIN(pEstimator->h, tSinceLastCorrection);
-
-    /* Prediction */
-    /* Step 1: Calculate a priori state estimation*/
+static RAMFUNC void PredictAttitudeStates(float32_t const ctrl[AXES_NPR], float32_t const tSinceLastCorrection[AXES_NPR],
+        float32_t const * pAngleIncrement) {
+    KalmanFilterBankType * pEstimator = &attitudeEstimator;
+    AttitudeStatesType * pState = &attitudeStateInternal;
+    float32_t const h = pEstimator->h;
+    uint8_t axis;
+
+#if !USE_CTRLSIGNAL_IN_PREDICTION_MODEL
+    (void) ctrl;
+#endif
+
+    /* the axes are independent, which keeps the FPU pipeline busy */
+    for (axis = 0; axis < AXES_NPR; axis++) {
+        float32_t p11_tmp = pEstimator->p11[axis];
+        float32_t p12_tmp = pEstimator->p12[axis];
+        float32_t p13_tmp = pEstimator->p13[axis];
+        float32_t p21_tmp = pEstimator->p21[axis];
+        float32_t p22_tmp = pEstimator->p22[axis];
+        float32_t p23_tmp = pEstimator->p23[axis];
+        float32_t p31_tmp = pEstimator->p31[axis];
+        float32_t p32_tmp = pEstimator->p32[axis];
+        float32_t p33_tmp = pEstimator->p33[axis];
+        float32_t deltaT = MIN(h, tSinceLastCorrection[axis]);
+        float32_t angleStep = deltaT * (pState->angleRate[axis] - pState->angleRateBias[axis]);
+
+        /* Prediction */
+        /* Step 1: Calculate a priori state estimation*/
+
+        /* The whole rotation of the gyroscope samples replaces the rate integration of the axis */
+        if (NULL != pAngleIncrement) {
+            angleStep = pAngleIncrement[axis];
+        }
 
 #if USE_CTRLSIGNAL_IN_PREDICTION_MODEL
-    pState->angle += deltaT * (pState->angleRate - pState->angleRateBias) + h*h/(2 * inertia) * ctrl;
-    pState->angleRate += h / inertia * ctrl;
+        pState->angle[axis] += angleStep + h*h/(2 * attitudeInertia[axis]) * ctrl[axis];
+        pState->angleRate[axis] += h / attitudeInertia[axis] * ctrl[axis];
 #else
-    pState->angle += deltaT * (pState->angleRate - pState->angleRateBias);
+        pState->angle[axis] += angleStep;
 #endif
 
-    /* pState->angleRateBias not estimated, see equations in section "State Estimation Theory" */
-    pState->angleRateUnbiased = pState->angleRate - pState->angleRateBias; // Update the unbiased rate state
-    toMaxRadian(&pState->angle);
+        /* angleRateBias not estimated, see equations in section "State Estimation Theory" */
+        pState->angleRateUnbiased[axis] = pState->angleRate[axis] - pState->angleRateBias[axis]; // Update the unbiased rate state
+        toMaxRadian(&pState->angle[axis]);
 
-    /* Step 2: Calculate a priori error covariance matrix P*/
-    pEstimator->p11 = p11_tmp + h*(p12_tmp-p13_tmp+p21_tmp-p31_tmp) + h*h*(p22_tmp-p23_tmp-p32_tmp+p33_tmp) + pEstimator->q1;
-    pEstimator->p12 = p12_tmp + h*(p22_tmp-p32_tmp);
-    pEstimator->p13 = p13_tmp + h*(p23_tmp-p33_tmp);
+        /* Step 2: Calculate a priori error covariance matrix P, constant with steady-state gains */
+        if (useSteadyStateGains) {
+            continue;
+        }
+        pEstimator->p11[axis] = p11_tmp + h*(p12_tmp-p13_tmp+p21_tmp-p31_tmp) + h*h*(p22_tmp-p23_tmp-p32_tmp+p33_tmp) + pEstimator->q1[axis];
+        pEstimator->p12[axis] = p12_tmp + h*(p22_tmp-p32_tmp);
+        pEstimator->p13[axis] = p13_tmp + h*(p23_tmp-p33_tmp);
 
-    pEstimator->p21 = p21_tmp + h*(p22_tmp-p23_tmp);
-    pEstimator->p22 = p22_tmp + pEstimator->q2;
-    pEstimator->p23 = p23_tmp;
+        pEstimator->p21[axis] = p21_tmp + h*(p22_tmp-p23_tmp);
+        pEstimator->p22[axis] = p22_tmp + pEstimator->q2[axis];
+        /* p23 unchanged */
 
-    pEstimator->p31 = p31_tmp + h*(p32_tmp-p33_tmp);
-    pEstimator->p32 = p32_tmp;
-    pEstimator->p33 = p33_tmp + pEstimator->q3;
+        pEstimator->p31[axis] = p31_tmp + h*(p32_tmp-p33_tmp);
+        /* p32 unchanged */
+        pEstimator->p33[axis] = p33_tmp + pEstimator->q3[axis];
+    }
 }
 
 /*
- * @brief	Performs the correction part of the Kalman filtering.
- * @param 	newAngle: Pointer to measured angle using accelerometer or magnetometer (roll, pitch or yaw)
- * @param 	pEstimator: Pointer to KalmanFilterType struct (roll pitch or yaw estimator)
- * @param 	stateAngle: Pointer to struct member of StateVectorType (roll, pitch or yaw)
- * @param 	stateRateBias: Pointer to struct member of StateVectorType (rollRateBias, pitchRateBias or yawRateBias)
- * @retval 	None
+ * @brief   Corrects the attitude with an accelerometer or magnetometer sample, at the prediction before the time it was
+ *          taken with FCB_DELAYED_FUSION, else at the latest prediction
+ * @param   sensorAngle: Measured angles, indexed by FcbRPYIndexType
+ * @param   firstAxis: First axis (roll, pitch or yaw) to correct
+ * @param   lastAxis: Last axis to correct, inclusive
+ * @param   noiseScale: Factor of the measurement noise, see AccVibrationNoiseScale()
+ * @param   pAccMeterXYZ: Accelerometer sample to gate the correction with, see AccCorrectionGate(), NULL for none
+ * @param   timestamp: Time the sample was taken [core clock cycles]
+ * @retval  None
  */
-static void CorrectAttitudeState(const float32_t sensorAngle, KalmanFilterType* pEstimator,
-		AttitudeStateVectorType* pStateInternal, AttitudeStateVectorType* pState) {
-    float32_t y1, s11, s12, s21, s22, InvDetS;
-    float32_t p11_tmp, p12_tmp, p13_tmp, p21_tmp, p22_tmp, p23_tmp, p31_tmp, p32_tmp, p33_tmp;
-
-    p11_tmp = pEstimator->p11; p12_tmp = pEstimator->p12; p13_tmp = pEstimator->p13;
-    p21_tmp = pEstimator->p21; p22_tmp = pEstimator->p22; p23_tmp = pEstimator->p23;
-    p31_tmp = pEstimator->p31; p32_tmp = pEstimator->p32; p33_tmp = pEstimator->p33;
+static RAMFUNC void FuseAttitudeSample(float32_t const sensorAngle[AXES_NPR], uint8_t const firstAxis,
+        uint8_t const lastAxis, float32_t const noiseScale, float32_t const * pAccMeterXYZ, uint32_t const timestamp) {
+    float32_t const * pRefAngle = attitudeStateInternal.angle;
+    float32_t const * pRefP11 = attitudeEstimator.p11;
+#ifdef FCB_DELAYED_FUSION
+    int8_t const delay = GetSampleDelay(timestamp);
+
+    if (STATE_HISTORY_EXPIRED == delay) {
+        return;
+    } else if (delay > 0) {
+        pRefAngle = GetStateHistory((uint8_t) delay)->angle;
+        pRefP11 = GetStateHistory((uint8_t) delay)->p11;
+    }
+#else
+    (void) timestamp;
+#endif
 
-    /* Correction */
-    /* Step3: Calculate y, difference between a-priori state and measurement z */
-    y1 = sensorAngle - pStateInternal->angle;
-    toMaxRadian(&y1);
+    if (pAccMeterXYZ && !AccCorrectionGate(pAccMeterXYZ, sensorAngle, pRefAngle, pRefP11, noiseScale)) {
+        return;
+    }
 
-    /* Step 4: Calculate innovation covariance matrix S */
-    s11 = p11_tmp + pEstimator->r1;
-    s12 = p12_tmp;
-    s21 = p21_tmp;
-    s22 = p22_tmp + pEstimator->r2;
+#ifdef FCB_DELAYED_FUSION
+    if (delay > 0) {
+        CorrectDelayedAttitudeStates(sensorAngle, firstAxis, lastAxis, noiseScale, (uint8_t) delay);
+        return;
+    }
+#endif
 
-    /* Step 5: Calculate Kalman gain */
-    InvDetS = 1/(s11*s22 - s12*s21);
-    pEstimator->k11 = InvDetS * (p11_tmp*s22 - p12_tmp*s21);
-    pEstimator->k21 = InvDetS * (p21_tmp*s22 - p22_tmp*s21);
-    pEstimator->k31 = InvDetS * (p31_tmp*s22 - p32_tmp*s21);
+    CorrectAttitudeStates(sensorAngle, firstAxis, lastAxis, noiseScale);
+#ifdef FCB_DELAYED_FUSION
+    /* Later delayed samples compare with the corrected latest prediction */
+    if (stateHistoryCount > 0) {
+        StoreStateHistory(GetStateHistory(0));
+    }
+#endif
+}
 
-    /* Step 6: Update a posteriori state estimation */
-    pStateInternal->angle += pEstimator->k11*y1;
-    pStateInternal->angleRate += pEstimator->k21*y1;
-    pStateInternal->angleRateBias += pEstimator->k31*y1;
-    toMaxRadian(&pStateInternal->angle);
+/*
+ * @brief	Performs the attitude correction part of the Kalman filtering for a range of axes in one pass.
+ * @param 	sensorAngle: Measured angles using accelerometer or magnetometer, indexed by FcbRPYIndexType
+ * @param 	firstAxis: First axis (roll, pitch or yaw) to correct
+ * @param 	lastAxis: Last axis to correct, inclusive
+ * @retval 	None
+ */
+static RAMFUNC void CorrectAttitudeStates(float32_t const sensorAngle[AXES_NPR], uint8_t const firstAxis,
+        uint8_t const lastAxis, float32_t const noiseScale) {
+    KalmanFilterBankType * pEstimator = &attitudeEstimator;
+    AttitudeStatesType * pStateInternal = &attitudeStateInternal;
+    uint8_t axis;
+
+    for (axis = firstAxis; axis <= lastAxis; axis++) {
+        float32_t y1, s11, s12, s21, s22, InvDetS, k11, k21, k31;
+        float32_t p11_tmp = pEstimator->p11[axis];
+        float32_t p12_tmp = pEstimator->p12[axis];
+        float32_t p13_tmp = pEstimator->p13[axis];
+        float32_t p21_tmp = pEstimator->p21[axis];
+        float32_t p22_tmp = pEstimator->p22[axis];
+        float32_t p31_tmp = pEstimator->p31[axis];
+        float32_t p32_tmp = pEstimator->p32[axis];
+
+        /* Correction */
+        /* Step3: Calculate y, difference between a-priori state and measurement z */
+        y1 = sensorAngle[axis] - pStateInternal->angle[axis];
+        toMaxRadian(&y1);
+
+        if (useSteadyStateGains) {
+            k11 = pEstimator->k11[axis] / noiseScale;
+            k21 = pEstimator->k21[axis] / noiseScale;
+            k31 = pEstimator->k31[axis] / noiseScale;
+        } else {
+            /* Step 4: Calculate innovation covariance matrix S */
+            s11 = p11_tmp + pEstimator->r1[axis]*noiseScale;
+            s12 = p12_tmp;
+            s21 = p21_tmp;
+            s22 = p22_tmp + pEstimator->r2[axis];
+
+            /* Step 5: Calculate Kalman gain */
+            InvDetS = 1/(s11*s22 - s12*s21);
+            k11 = InvDetS * (p11_tmp*s22 - p12_tmp*s21);
+            k21 = InvDetS * (p21_tmp*s22 - p22_tmp*s21);
+            k31 = InvDetS * (p31_tmp*s22 - p32_tmp*s21);
+
+            pEstimator->k11[axis] = k11;
+            pEstimator->k21[axis] = k21;
+            pEstimator->k31[axis] = k31;
+        }
 
-    /* Step 7: Update a posteriori error covariance matrix P
-     * NOTE: This is only half of the P matrix update, i.e. the parts that are related to the attitude measurement */
+        /* Step 6: Update a posteriori state estimation */
+        pStateInternal->angle[axis] += k11*y1;
+        pStateInternal->angleRate[axis] += k21*y1;
+        pStateInternal->angleRateBias[axis] += k31*y1;
+        toMaxRadian(&pStateInternal->angle[axis]);
+
+        if (!useSteadyStateGains) {
+            /* Step 7: Update a posteriori error covariance matrix P
+             * NOTE: This is only half of the P matrix update, i.e. the parts that are related to the attitude measurement */
+            pEstimator->p11[axis] = p11_tmp - p11_tmp*k11;
+            pEstimator->p12[axis] = p12_tmp - p12_tmp*k11;
+            pEstimator->p13[axis] = p13_tmp - p13_tmp*k11;
+
+            pEstimator->p21[axis] = p21_tmp - p11_tmp*k21;
+            pEstimator->p22[axis] = p22_tmp - p12_tmp*k21;
+            pEstimator->p23[axis] -= p13_tmp*k21;
+
+            pEstimator->p31[axis] = p31_tmp - p11_tmp*k31;
+            pEstimator->p32[axis] = p32_tmp - p12_tmp*k31;
+            pEstimator->p33[axis] -= p13_tmp*k31;
+        }
 
-    pEstimator->p11 = p11_tmp - p11_tmp*pEstimator->k11;
-    pEstimator->p12 = p12_tmp - p12_tmp*pEstimator->k11;
-    pEstimator->p13 = p13_tmp - p13_tmp*pEstimator->k11;
+        /* Update real states (i.e. filter output) by copying internal state from correction */
+        attitudeState.angle[axis] = pStateInternal->angle[axis];
+    }
+}
 
-    pEstimator->p21 = p21_tmp - p11_tmp*pEstimator->k21;
-    pEstimator->p22 = p22_tmp - p12_tmp*pEstimator->k21;
-    pEstimator->p23 = p23_tmp - p13_tmp*pEstimator->k21;
+/*
+ * @brief   Decides if an accelerometer sample is used for the roll/pitch correction and counts the outcome
+ * @param   pAccMeterXYZ: Accelerometer sample [m/s^2]
+ * @param   sensorAngle: Roll and pitch calculated from the sample, indexed by FcbRPYIndexType
+ * @param   refAngle: Predicted angles the sample is compared with, indexed by FcbRPYIndexType
+ * @param   refP11: Attitude error variances of the predicted angles, indexed by FcbRPYIndexType
+ * @param   noiseScale: Factor of the measurement noise, see AccVibrationNoiseScale()
+ * @retval  1 if the sample should be used, 0 if it should be skipped
+ */
+static RAMFUNC uint8_t AccCorrectionGate(float32_t const * pAccMeterXYZ, float32_t const sensorAngle[AXES_NPR],
+        float32_t const refAngle[AXES_NPR], float32_t const refP11[AXES_NPR], float32_t const noiseScale) {
+    float32_t const normSquaredMin = G_ACC*G_ACC*(1.0f-STATE_ACC_GATE_NORM_TOLERANCE)*(1.0f-STATE_ACC_GATE_NORM_TOLERANCE);
+    float32_t const normSquaredMax = G_ACC*G_ACC*(1.0f+STATE_ACC_GATE_NORM_TOLERANCE)*(1.0f+STATE_ACC_GATE_NORM_TOLERANCE);
+    float32_t normSquared, y1;
+    uint8_t axis;
+
+    normSquared = pAccMeterXYZ[0]*pAccMeterXYZ[0] + pAccMeterXYZ[1]*pAccMeterXYZ[1] + pAccMeterXYZ[2]*pAccMeterXYZ[2];
+    if (normSquared < normSquaredMin || normSquared > normSquaredMax) {
+        accGateStats.normRejected++;
+        return 0;
+    }
 
-    pEstimator->p31 = p31_tmp - p11_tmp*pEstimator->k31;
-    pEstimator->p32 = p32_tmp - p12_tmp*pEstimator->k31;
-    pEstimator->p33 = p33_tmp - p13_tmp*pEstimator->k31;
+    if (accConsecutiveInnovationRejects < STATE_ACC_GATE_MAX_CONSECUTIVE_REJECTS) {
+        for (axis = ROLL_IDX; axis <= PITCH_IDX; axis++) {
+            y1 = sensorAngle[axis] - refAngle[axis];
+            toMaxRadian(&y1);
+
+            /* Compare with the innovation variance s11 = p11 + r1 */
+            if (y1*y1 > STATE_ACC_GATE_INNOVATION_SIGMAS*STATE_ACC_GATE_INNOVATION_SIGMAS
+                    *(refP11[axis] + attitudeEstimator.r1[axis]*noiseScale)) {
+                accConsecutiveInnovationRejects++;
+                accGateStats.innovationRejected++;
+                return 0;
+            }
+        }
+    }
 
-    /* Update real states (i.e. filter output) by copying internal state from correction */
-    pState->angle = pStateInternal->angle;
+    accConsecutiveInnovationRejects = 0;
+    accGateStats.accepted++;
+    return 1;
 }
 
 /*
- * @brief   Performs the correction part of the Kalman filtering.
- * @param   newAngle: Pointer to measured angle using accelerometer or magnetometer (roll, pitch or yaw)
- * @param   pEstimator: Pointer to KalmanFilterType struct (roll pitch or yaw estimator)
- * @param   stateAngle: Pointer to struct member of StateVectorType (roll, pitch or yaw)
- * @param   stateRateBias: Pointer to struct member of StateVectorType (rollRateBias, pitchRateBias or yawRateBias)
+ * @brief   Performs the attitude rate correction part of the Kalman filtering for roll, pitch & yaw in one pass.
+ * @param   sensorRate: Measured Euler angle rates using the gyroscope, indexed by FcbRPYIndexType
  * @retval  None
  */
-static void CorrectAttitudeRateState(const float32_t sensorRate, KalmanFilterType* pEstimator,
-        AttitudeStateVectorType* pStateInternal, AttitudeStateVectorType* pState) {
-    float32_t y2, s11, s12, s21, s22, InvDetS;
-    float32_t p11_tmp, p12_tmp, p13_tmp, p21_tmp, p22_tmp, p23_tmp, p31_tmp, p32_tmp, p33_tmp;
-
-    p11_tmp = pEstimator->p11; p12_tmp = pEstimator->p12; p13_tmp = pEstimator->p13;
-    p21_tmp = pEstimator->p21; p22_tmp = pEstimator->p22; p23_tmp = pEstimator->p23;
-    p31_tmp = pEstimator->p31; p32_tmp = pEstimator->p32; p33_tmp = pEstimator->p33;
-
-    /* Correction */
-    /* Step3: Calculate y, difference between a-priori state and measurement z */
-    y2 = sensorRate - pStateInternal->angleRate;
-
-    /* Step 4: Calculate innovation covariance matrix S */
-    s11 = p11_tmp + pEstimator->r1;
-    s12 = p12_tmp;
-    s21 = p21_tmp;
-    s22 = p22_tmp + pEstimator->r2;
-
-    /* Step 5: Calculate Kalman gains */
-    InvDetS = 1/(s11*s22 - s12*s21);
-    pEstimator->k12 = InvDetS * (p12_tmp*s11 - p11_tmp*s12);
-    pEstimator->k22 = InvDetS * (p22_tmp*s11 - p21_tmp*s12);
-    pEstimator->k32 = InvDetS * (p32_tmp*s11 + p31_tmp*s12);
-
-    /* Step 6: Update a posteriori state estimation */
-    pStateInternal->angle = pStateInternal->angle + pEstimator->k12 * y2;
-    pStateInternal->angleRate = pStateInternal->angleRate + pEstimator->k22 * y2;
-    pStateInternal->angleRateBias = pStateInternal->angleRateBias + pEstimator->k32 * y2;
-    pStateInternal->angleRateUnbiased = pStateInternal->angleRate - pStateInternal->angleRateBias; // Update the unbiased rate state
-
-    /* Step 7: Update a posteriori error covariance matrix P
-     * NOTE: This is only half of the P matrix update, i.e. the parts that are related to the attitude rate measurement */
-    pEstimator->p11 = p11_tmp - p21_tmp*pEstimator->k12;
-    pEstimator->p12 = p12_tmp - p22_tmp*pEstimator->k12;
-    pEstimator->p13 = p13_tmp - p23_tmp*pEstimator->k12;
-
-    pEstimator->p21 = p21_tmp - p21_tmp*pEstimator->k22;
-    pEstimator->p22 = p22_tmp - p22_tmp*pEstimator->k22;
-    pEstimator->p23 = p23_tmp - p23_tmp*pEstimator->k22;
-
-    pEstimator->p31 = p31_tmp - p21_tmp*pEstimator->k32;
-    pEstimator->p32 = p32_tmp - p22_tmp*pEstimator->k32;
-    pEstimator->p33 = p33_tmp - p23_tmp*pEstimator->k32;
-
-    /* Update real states (i.e. filter output) by copying internal state from correction */
-    pState->angleRate = pStateInternal->angleRate;
-    pState->angleRateBias = pStateInternal->angleRateBias;
-    pState->angleRateUnbiased = pStateInternal->angleRateUnbiased;
+static RAMFUNC void CorrectAttitudeRateStates(float32_t const sensorRate[AXES_NPR]) {
+    KalmanFilterBankType * pEstimator = &attitudeEstimator;
+    AttitudeStatesType * pStateInternal = &attitudeStateInternal;
+    uint8_t axis;
+
+    /* the axes are independent, which keeps the FPU pipeline busy */
+    for (axis = 0; axis < AXES_NPR; axis++) {
+        float32_t y2, s11, s12, s21, s22, InvDetS, k12, k22, k32;
+        float32_t p11_tmp = pEstimator->p11[axis];
+        float32_t p12_tmp = pEstimator->p12[axis];
+        float32_t p21_tmp = pEstimator->p21[axis];
+        float32_t p22_tmp = pEstimator->p22[axis];
+        float32_t p23_tmp = pEstimator->p23[axis];
+        float32_t p31_tmp = pEstimator->p31[axis];
+        float32_t p32_tmp = pEstimator->p32[axis];
+
+        /* Correction */
+        /* Step3: Calculate y, difference between a-priori state and measurement z */
+        y2 = sensorRate[axis] - pStateInternal->angleRate[axis];
+
+        if (useSteadyStateGains) {
+            k12 = pEstimator->k12[axis];
+            k22 = pEstimator->k22[axis];
+            k32 = pEstimator->k32[axis];
+        } else {
+            /* Step 4: Calculate innovation covariance matrix S */
+            s11 = p11_tmp + pEstimator->r1[axis];
+            s12 = p12_tmp;
+            s21 = p21_tmp;
+            s22 = p22_tmp + pEstimator->r2[axis];
+
+            /* Step 5: Calculate Kalman gains */
+            InvDetS = 1/(s11*s22 - s12*s21);
+            k12 = InvDetS * (p12_tmp*s11 - p11_tmp*s12);
+            k22 = InvDetS * (p22_tmp*s11 - p21_tmp*s12);
+            k32 = InvDetS * (p32_tmp*s11 + p31_tmp*s12);
+
+            pEstimator->k12[axis] = k12;
+            pEstimator->k22[axis] = k22;
+            pEstimator->k32[axis] = k32;
+        }
+
+        /* Step 6: Update a posteriori state estimation */
+        pStateInternal->angle[axis] += k12 * y2;
+        pStateInternal->angleRate[axis] += k22 * y2;
+        pStateInternal->angleRateBias[axis] += k32 * y2;
+        pStateInternal->angleRateUnbiased[axis] = pStateInternal->angleRate[axis] - pStateInternal->angleRateBias[axis]; // Update the unbiased rate state
+
+        if (!useSteadyStateGains) {
+            /* Step 7: Update a posteriori error covariance matrix P
+             * NOTE: This is only half of the P matrix update, i.e. the parts that are related to the attitude rate measurement */
+            pEstimator->p11[axis] = p11_tmp - p21_tmp*k12;
+            pEstimator->p12[axis] = p12_tmp - p22_tmp*k12;
+            pEstimator->p13[axis] -= p23_tmp*k12;
+
+            pEstimator->p21[axis] = p21_tmp - p21_tmp*k22;
+            pEstimator->p22[axis] = p22_tmp - p22_tmp*k22;
+            pEstimator->p23[axis] = p23_tmp - p23_tmp*k22;
+
+            pEstimator->p31[axis] = p31_tmp - p21_tmp*k32;
+            pEstimator->p32[axis] = p32_tmp - p22_tmp*k32;
+            pEstimator->p33[axis] -= p23_tmp*k32;
+        }
+
+        /* Update real states (i.e. filter output) by copying internal state from correction */
+        attitudeState.angleRate[axis] = pStateInternal->angleRate[axis];
+        attitudeState.angleRateBias[axis] = pStateInternal->angleRateBias[axis];
+        attitudeState.angleRateUnbiased[axis] = pStateInternal->angleRateUnbiased[axis];
+    }
 }
 
-///////////////////////////////////////////////////////////////////////////////
-//                 Debug printing functions
-///////////////////////////////////////////////////////////////////////////////
+#ifdef FCB_DELAYED_FUSION
+/*
+ * @brief   Gets a prediction in the state history
+ * @param   age: Number of predictions before the latest one, below stateHistoryCount
+ * @retval  History entry
+ */
+static RAMFUNC StateHistoryEntryType * GetStateHistory(uint8_t const age) {
+    return &stateHistory[(stateHistoryNewest + STATE_HISTORY_LENGTH - age) % STATE_HISTORY_LENGTH];
+}
 
-/**
- * @brief  Task code handles state (angle, rate, ratebias) print sampling
- * @param  argument : Unused parameter
- * @retval None
+/*
+ * @brief   Copies the current Kalman states and the error covariances used by a correction to a history entry
+ * @param   pEntry: Destination history entry, its timestamp is kept
+ * @retval  None
  */
-static void StatePrintSamplingTask(void const *argument) {
-    (void) argument;
+static RAMFUNC void StoreStateHistory(StateHistoryEntryType * pEntry) {
+    KalmanFilterBankType * pEstimator = &attitudeEstimator;
+
+    memcpy(pEntry->angle, attitudeStateInternal.angle, sizeof(pEntry->angle));
+    memcpy(pEntry->angleRate, attitudeStateInternal.angleRate, sizeof(pEntry->angleRate));
+    memcpy(pEntry->angleRateBias, attitudeStateInternal.angleRateBias, sizeof(pEntry->angleRateBias));
+    memcpy(pEntry->p11, pEstimator->p11, sizeof(pEntry->p11));
+    memcpy(pEntry->p12, pEstimator->p12, sizeof(pEntry->p12));
+    memcpy(pEntry->p13, pEstimator->p13, sizeof(pEntry->p13));
+    memcpy(pEntry->p21, pEstimator->p21, sizeof(pEntry->p21));
+    memcpy(pEntry->p22, pEstimator->p22, sizeof(pEntry->p22));
+    memcpy(pEntry->p31, pEstimator->p31, sizeof(pEntry->p31));
+    memcpy(pEntry->p32, pEstimator->p32, sizeof(pEntry->p32));
+}
 
-    portTickType xLastWakeTime;
-    portTickType xSampleStartTime;
+/*
+ * @brief   Finds the latest prediction at or before the time a sample was taken and counts delayed samples
+ * @param   timestamp: Time the sample was taken [core clock cycles]
+ * @retval  Number of predictions the found one is before the latest one, 0 if the sample is not delayed or there
+ *          is no history yet, STATE_HISTORY_EXPIRED if the sample was taken before the oldest prediction
+ */
+static RAMFUNC int8_t GetSampleDelay(uint32_t const timestamp) {
+    uint8_t age;
+
+    if (0 == stateHistoryCount) {
+        return 0;
+    }
 
-    /* Initialize the xLastWakeTime variable with the current time */
-    xLastWakeTime = xTaskGetTickCount();
-    xSampleStartTime = xLastWakeTime;
+    for (age = 0; age < stateHistoryCount; age++) {
+        if ((int32_t) (timestamp - GetStateHistory(age)->timestamp) >= 0) {
+            if (age > 0) {
+                delayedFusionStats.delayed++;
+                if (age > delayedFusionStats.maxDelay) {
+                    delayedFusionStats.maxDelay = age;
+                }
+            }
+            return (int8_t) age;
+        }
+    }
 
-    for (;;) {
-        vTaskDelayUntil(&xLastWakeTime, statePrintSampleTime);
+    delayedFusionStats.expired++;
+    return STATE_HISTORY_EXPIRED;
+}
 
-        PrintStateValues();
+/*
+ * @brief	Performs the attitude correction of CorrectAttitudeStates() for a sample taken before the latest prediction.
+ *          The innovation and the gains are those of the prediction before the sample. The state correction dx is
+ *          propagated to each later prediction, n predictions after, with the transition matrix of the prediction,
+ *          F^n = [1 nh -nh; 0 1 0; 0 0 1], and the covariance correction K*H*P_delayed with F^n*(.)*F^n'.
+ * @param 	sensorAngle: Measured angles using accelerometer or magnetometer, indexed by FcbRPYIndexType
+ * @param 	firstAxis: First axis (roll, pitch or yaw) to correct
+ * @param 	lastAxis: Last axis to correct, inclusive
+ * @param   noiseScale: Factor of the measurement noise, see AccVibrationNoiseScale()
+ * @param   delay: Number of predictions before the latest one to correct at, see GetSampleDelay()
+ * @retval 	None
+ */
+static RAMFUNC void CorrectDelayedAttitudeStates(float32_t const sensorAngle[AXES_NPR], uint8_t const firstAxis,
+        uint8_t const lastAxis, float32_t const noiseScale, uint8_t const delay) {
+    KalmanFilterBankType * pEstimator = &attitudeEstimator;
+    AttitudeStatesType * pStateInternal = &attitudeStateInternal;
+    StateHistoryEntryType const * pDelayed = GetStateHistory(delay);
+    StateHistoryEntryType * pEntry;
+    float32_t const h = pEstimator->h;
+    uint8_t axis, age;
+
+    for (axis = firstAxis; axis <= lastAxis; axis++) {
+        float32_t y1, s11, s12, s21, s22, InvDetS, k11, k21, k31, dAngle, dRate, dBias, t, c1, a1;
+        float32_t p11_tmp = pDelayed->p11[axis];
+        float32_t p12_tmp = pDelayed->p12[axis];
+        float32_t p13_tmp = pDelayed->p13[axis];
+        float32_t p21_tmp = pDelayed->p21[axis];
+        float32_t p22_tmp = pDelayed->p22[axis];
+        float32_t p31_tmp = pDelayed->p31[axis];
+        float32_t p32_tmp = pDelayed->p32[axis];
+
+        y1 = sensorAngle[axis] - pDelayed->angle[axis];
+        toMaxRadian(&y1);
+
+        if (useSteadyStateGains) {
+            k11 = pEstimator->k11[axis] / noiseScale;
+            k21 = pEstimator->k21[axis] / noiseScale;
+            k31 = pEstimator->k31[axis] / noiseScale;
+        } else {
+            s11 = p11_tmp + pEstimator->r1[axis]*noiseScale;
+            s12 = p12_tmp;
+            s21 = p21_tmp;
+            s22 = p22_tmp + pEstimator->r2[axis];
+
+            InvDetS = 1/(s11*s22 - s12*s21);
+            k11 = InvDetS * (p11_tmp*s22 - p12_tmp*s21);
+            k21 = InvDetS * (p21_tmp*s22 - p22_tmp*s21);
+            k31 = InvDetS * (p31_tmp*s22 - p32_tmp*s21);
+        }
 
-        /* If sampling duration exceeded, delete task to stop sampling */
-        if (xTaskGetTickCount() >= xSampleStartTime + statePrintSampleDuration * configTICK_RATE_HZ)
-            StopStateSamplingTask();
+        dAngle = k11*y1;
+        dRate = k21*y1;
+        dBias = k31*y1;
+
+        /* The predictions between integrate the unbiased rate over about h each */
+        for (age = delay; ; age--) {
+            pEntry = GetStateHistory(age);
+            t = (float32_t) (delay - age) * h;
+            pEntry->angle[axis] += dAngle + t*(dRate - dBias);
+            pEntry->angleRate[axis] += dRate;
+            pEntry->angleRateBias[axis] += dBias;
+            toMaxRadian(&pEntry->angle[axis]);
+            if (0 == age) {
+                break;
+            }
+        }
+
+        /* The current states include the gyroscope corrections since the latest prediction */
+        t = (float32_t) delay * h;
+        pStateInternal->angle[axis] += dAngle + t*(dRate - dBias);
+        pStateInternal->angleRate[axis] += dRate;
+        pStateInternal->angleRateBias[axis] += dBias;
+        toMaxRadian(&pStateInternal->angle[axis]);
+
+        if (!useSteadyStateGains) {
+            /* K*H*P_delayed = k*[p11 p12 p13], its first row and column propagated by F^n. The covariances in the
+             * history are kept, they are only read for the gains of later delayed samples. */
+            c1 = k11 + t*(k21 - k31);
+            a1 = p11_tmp + t*(p12_tmp - p13_tmp);
+
+            pEstimator->p11[axis] -= c1*a1;
+            pEstimator->p12[axis] -= c1*p12_tmp;
+            pEstimator->p13[axis] -= c1*p13_tmp;
+
+            pEstimator->p21[axis] -= k21*a1;
+            pEstimator->p22[axis] -= k21*p12_tmp;
+            pEstimator->p23[axis] -= k21*p13_tmp;
+
+            pEstimator->p31[axis] -= k31*a1;
+            pEstimator->p32[axis] -= k31*p12_tmp;
+            pEstimator->p33[axis] -= k31*p13_tmp;
+        }
+
+        /* Update real states (i.e. filter output) by copying internal state from correction */
+        attitudeState.angle[axis] = pStateInternal->angle[axis];
     }
 }
+#endif
+#endif
 
 /*
- * @brief  Creates a task to print states over USB.
- * @param  sampleTime : Sets how often a sample should be printed.
- * @param  sampleDuration : Sets for how long sampling should be performed.
- * @retval MOTORCTRL_OK if thread started, else MOTORCTRL_ERROR.
+ * @brief   Integrates the gravity compensated vertical acceleration into the vertical states
+ * @param   pInertialAcc: The accelerometer sensor readings rotated to the inertial (NED) frame [m/s^2]
+ * @param   dt: Time since the previous accelerometer sample [s]
+ * @retval  None
  */
-FcbRetValType StartStateSamplingTask(const uint16_t sampleTime, const uint32_t sampleDuration) {
+static void PredictVerticalStates(float32_t const * pInertialAcc, float32_t const dt) {
+    float32_t zAcc, deltaT;
 
-    // TODO do not start a new task if one is already running, just update sampleTime/sampleDuration
-
-    if (sampleTime < STATE_PRINT_MINIMUM_SAMPLING_TIME) {
-        statePrintSampleTime = STATE_PRINT_MINIMUM_SAMPLING_TIME;
-    } else {
-        statePrintSampleTime = sampleTime;
+    if (!verticalStateInitialized) {
+        return;
     }
 
-    statePrintSampleDuration = sampleDuration;
+    deltaT = MIN(dt, VERTICAL_ESTIMATION_MAX_DT);
 
-    /* State value print sampling handler thread creation
-     * Task function pointer: StatePrintSamplingTask
-     * Task name: STATE_PRINT_SAMPL
-     * Stack depth: 2*configMINIMAL_STACK_SIZE
-     * Parameter: NULL
-     * Priority: STATE_PRINT_SAMPLING_TASK_PRIO (0 to configMAX_PRIORITIES-1 possible)
-     * Handle: StatePrintSamplingTaskHandle
-     **/
-    if (pdPASS
-            != xTaskCreate((pdTASK_CODE )StatePrintSamplingTask, (signed portCHAR*)"STATE_PRINT_SAMPL",
-                    3*configMINIMAL_STACK_SIZE, NULL, STATE_PRINT_SAMPLING_TASK_PRIO, &StatePrintSamplingTaskHandle)) {
-        ErrorHandler();
-        return FCB_ERR;
+    /* Inertial Z component of the measured specific force plus gravity */
+    zAcc = pInertialAcc[2] + G_ACC - verticalState.zAccBias;
+
+    verticalState.zPosition += deltaT*(verticalState.zVelocity + 0.5f*deltaT*zAcc);
+    verticalState.zVelocity += deltaT*zAcc;
+}
+
+/*
+ * @brief   Corrects the vertical states with the barometric altitude. Third order complementary filter with all
+ *          poles at -1/VERTICAL_ESTIMATION_TIME_CONSTANT.
+ * @param   altitude: Barometric altitude [m]
+ * @param   dt: Time since the previous barometer sample [s]
+ * @retval  None
+ */
+static void CorrectVerticalStates(float32_t const altitude, float32_t const dt) {
+    float32_t const k1 = 3.0f/VERTICAL_ESTIMATION_TIME_CONSTANT;
+    float32_t const k2 = k1/VERTICAL_ESTIMATION_TIME_CONSTANT;
+    float32_t const k3 = k2/(3.0f*VERTICAL_ESTIMATION_TIME_CONSTANT);
+    float32_t error, deltaT;
+
+    if (!verticalStateInitialized) {
+        verticalState.zPosition = -altitude;
+        verticalState.zVelocity = 0.0;
+        verticalState.zAccBias = 0.0;
+        verticalStateInitialized = 1;
+        return;
     }
-    return FCB_OK;
+
+    deltaT = MIN(dt, VERTICAL_ESTIMATION_MAX_DT);
+    error = -altitude - verticalState.zPosition;
+
+    verticalState.zPosition += k1*deltaT*error;
+    verticalState.zVelocity += k2*deltaT*error;
+    verticalState.zAccBias -= k3*deltaT*error;
 }
 
+#ifdef FCB_STEADY_STATE_KALMAN
 /*
- * @brief  Stops motor control print sampling by deleting the task.
- * @param  None.
- * @retval MOTORCTRL_OK if task deleted, MOTORCTRL_ERROR if not.
+ * @brief   Solves the steady-state Kalman gains by running the covariance recursion with the prediction rate and
+ *          the measured sensor data rates until the gains converge.
+ * @note    The measurements equal the a priori states, so the states set by InitStatesXYZ() are not changed
+ * @param   None
+ * @retval  None
  */
-FcbRetValType StopStateSamplingTask(void) {
-    if (StatePrintSamplingTaskHandle != NULL) {
-        vTaskDelete(StatePrintSamplingTaskHandle);
-        StatePrintSamplingTaskHandle = NULL;
-        return FCB_OK;
+static void SolveSteadyStateGains(void) {
+    KalmanFilterBankType * pEstimator = &attitudeEstimator;
+    float32_t * const gains[] = { pEstimator->k11, pEstimator->k21, pEstimator->k31,
+            pEstimator->k12, pEstimator->k22, pEstimator->k32 };
+    float32_t prevGains[6][AXES_NPR];
+    float32_t const ctrl[AXES_NPR] = { 0.0f, 0.0f, 0.0f };
+    float32_t const h = pEstimator->h;
+    float32_t const tSinceLastCorrection[AXES_NPR] = { h, h, h };
+    float32_t const gyroSamplesPerStep = h * GetSensorDataRateHz(GYRO_IDX);
+    float32_t const accSamplesPerStep = h * GetSensorDataRateHz(ACC_IDX);
+    float32_t const magSamplesPerStep = h * GetSensorDataRateHz(MAG_IDX) / MAG_DECIMATION;
+    float32_t gyroSamples = 0.0f, accSamples = 0.0f, magSamples = 0.0f;
+    uint32_t const stepsPerCheck = (uint32_t) (1.0f/h + 0.5f);
+    uint32_t const maxSteps = (uint32_t) (STEADY_STATE_KALMAN_MAX_SOLVE_TIME/h);
+    uint32_t step;
+    uint8_t i, axis, converged;
+
+    memset(prevGains, 0, sizeof(prevGains));
+
+    for (step = 1; step <= maxSteps; step++) {
+        PredictAttitudeStates(ctrl, tSinceLastCorrection, NULL);
+
+        for (gyroSamples += gyroSamplesPerStep; gyroSamples >= 1.0f; gyroSamples -= 1.0f) {
+            CorrectAttitudeRateStates(attitudeStateInternal.angleRate);
+        }
+        for (accSamples += accSamplesPerStep; accSamples >= 1.0f; accSamples -= 1.0f) {
+            CorrectAttitudeStates(attitudeStateInternal.angle, ROLL_IDX, PITCH_IDX, 1.0f);
+        }
+        for (magSamples += magSamplesPerStep; magSamples >= 1.0f; magSamples -= 1.0f) {
+            CorrectAttitudeStates(attitudeStateInternal.angle, YAW_IDX, YAW_IDX, 1.0f);
+        }
+
+        if (step % stepsPerCheck) {
+            continue;
+        }
+
+        /* Converged when no gain changed noticeably during the last simulated second */
+        converged = 1;
+        for (i = 0; i < 6; i++) {
+            for (axis = 0; axis < AXES_NPR; axis++) {
+                if (fabsf(gains[i][axis] - prevGains[i][axis]) > STEADY_STATE_KALMAN_GAIN_TOLERANCE*fabsf(gains[i][axis])) {
+                    converged = 0;
+                }
+                prevGains[i][axis] = gains[i][axis];
+            }
+        }
+        if (converged) {
+            break;
+        }
     }
-    return FCB_ERR;
 }
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//                 Debug printing functions
+///////////////////////////////////////////////////////////////////////////////
 
 /*
  * @brief Prints the state values
@@ -581,9 +1943,17 @@ FcbRetValType StopStateSamplingTask(void) {
  * @retval None
  */
 void PrintStateValues(void) {
-    static char stateString[STATE_PRINT_MAX_STRING_SIZE]; // TODO when debug printing is cleaned up, this shouldn't be needed as static
-
+    char stateString[STATE_PRINT_MAX_STRING_SIZE];
     float32_t sensorAttitude[3], accValues[3], magValues[3], gyroValues[3];
+    float32_t printValues[15];
+    StateSnapshotType snapshot;
+    AccCorrectionGateStatsType gateStats;
+    DelayedFusionStatsType delayedStats;
+    MagHeadingStatsType magStats;
+    char noiseScaleString[16];
+    char magNoiseScaleString[16];
+    size_t length;
+    uint8_t i;
 
     // TODO Delete sensor attitude printouts later
     /* Get magnetometer values */
@@ -594,20 +1964,50 @@ void PrintStateValues(void) {
 
     /* Calculate roll, pitch, yaw based on accelerometer and magnetometer values */
     GetAttitudeFromAccelerometer(sensorAttitude, accValues);
-    sensorAttitude[2] = GetMagYawAngle(magValues, sensorAttitude[0], sensorAttitude[1]);
+    sensorAttitude[2] = GetMagYawAngle(magValues, sensorAttitude[0], sensorAttitude[1]) + GetMagDeclination();
+    toMaxRadian(&sensorAttitude[2]);
 
     /* Get gyro values [rad/s] */
     GetGyroAngleDot(&gyroValues[0], &gyroValues[1], &gyroValues[2]);
 
-    snprintf((char*) stateString, STATE_PRINT_MAX_STRING_SIZE,
-            "States [deg]:\nroll: %1.3f\npitch: %1.3f\nyaw: %1.3f\nrollRate: %1.3f\npitchRate: %1.3f\nyawRate: %1.3f\nrollRateBias: %1.3f\npitchRateBias: %1.3f\nyawRateBias: %1.3f\naccRoll:%1.3f, accPitch:%1.3f, magYaw:%1.3f\ngyroRoll:%1.3f, gyroPitch:%1.3f, gyroYaw:%1.3f\n\r\n",
-            Radian2Degree(rollState.angle), Radian2Degree(pitchState.angle), Radian2Degree(yawState.angle),
-            Radian2Degree(rollState.angleRate), Radian2Degree(pitchState.angleRate), Radian2Degree(yawState.angleRate),
-            Radian2Degree(rollState.angleRateBias), Radian2Degree(pitchState.angleRateBias), Radian2Degree(yawState.angleRateBias),
-            Radian2Degree(sensorAttitude[0]), Radian2Degree(sensorAttitude[1]), Radian2Degree(sensorAttitude[2]),
-            Radian2Degree(gyroValues[0]), Radian2Degree(gyroValues[1]), Radian2Degree(gyroValues[2]));
+    GetStateSnapshot(&snapshot);
+    GetAccCorrectionGateStats(&gateStats);
+    GetDelayedFusionStats(&delayedStats);
+    FormatFixed(noiseScaleString, sizeof(noiseScaleString), gateStats.noiseScale, 2);
+    GetMagHeadingStats(&magStats);
+    FormatFixed(magNoiseScaleString, sizeof(magNoiseScaleString), magStats.noiseScale, 2);
+
+    for (i = 0; i < 3; i++) {
+        printValues[i] = Radian2Degree(snapshot.angle[i]);
+        printValues[3 + i] = Radian2Degree(snapshot.angleRate[i]);
+        printValues[6 + i] = Radian2Degree(snapshot.angleRateBias[i]);
+        printValues[9 + i] = Radian2Degree(sensorAttitude[i]);
+        printValues[12 + i] = Radian2Degree(gyroValues[i]);
+    }
+
+    /* No float printf, the integer counters are formatted after the fixed-point values */
+    FormatFixedList(stateString, STATE_PRINT_MAX_STRING_SIZE,
+            "States [deg]:\nroll: %1.3f\npitch: %1.3f\nyaw: %1.3f\nrollRate: %1.3f\npitchRate: %1.3f\nyawRate: %1.3f\nrollRateBias: %1.3f\npitchRateBias: %1.3f\nyawRateBias: %1.3f\naccRoll:%1.3f, accPitch:%1.3f, magYaw:%1.3f\ngyroRoll:%1.3f, gyroPitch:%1.3f, gyroYaw:%1.3f\n",
+            printValues, 15);
+    FCB_CONSOLE_SEND_STRING(stateString); // Send string over USB
+
+    length = (size_t) snprintf(stateString, STATE_PRINT_MAX_STRING_SIZE,
+            "accGate accepted:%lu, normRejected:%lu, innovationRejected:%lu, noiseScale:%s\n",
+            (unsigned long) gateStats.accepted, (unsigned long) gateStats.normRejected,
+            (unsigned long) gateStats.innovationRejected, noiseScaleString);
+    if (length < STATE_PRINT_MAX_STRING_SIZE) {
+        length += (size_t) snprintf(&stateString[length], STATE_PRINT_MAX_STRING_SIZE - length,
+                "magHeading accepted:%lu, fieldRejected:%lu, inclinationRejected:%lu, noiseScale:%s\n",
+                (unsigned long) magStats.accepted, (unsigned long) magStats.fieldRejected,
+                (unsigned long) magStats.inclinationRejected, magNoiseScaleString);
+    }
+    if (length < STATE_PRINT_MAX_STRING_SIZE) {
+        snprintf(&stateString[length], STATE_PRINT_MAX_STRING_SIZE - length,
+                "delayedFusion delayed:%lu, expired:%lu, maxDelay:%lu\n\r\n", (unsigned long) delayedStats.delayed,
+                (unsigned long) delayedStats.expired, (unsigned long) delayedStats.maxDelay);
+    }
 
-    USBComSendString(stateString); // Send string over USB
+    FCB_CONSOLE_SEND_STRING(stateString); // Send string over USB
 }
 
 
@@ -0,0 +1,242 @@
+/******************************************************************************
+ * @file    stick_curves.c
+ * @brief   Stick curves compiled into interpolating lookup tables, see
+ *          stick_curves.h
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stick_curves.h"
+
+#include "flight_control.h"
+#include "flash.h"
+#include "fixed_format.h"
+#include "fcb_port.h"
+#include "ccm_ram.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Table of a curve over the deflection outside the deadband, the position in the table of a channel value v is
+ * |v|*gain - offset, so the deadband is exact however few points the table has */
+typedef struct {
+    float32_t positiveGain;     // [1/channel value]
+    float32_t negativeGain;     // [1/channel value]
+    float32_t offset;
+    float32_t points[STICK_CURVE_LUT_SIZE];
+} StickCurveLut_TypeDef;
+
+/* Private variables ---------------------------------------------------------*/
+
+static StickCurveType stickCurves[STICK_AXIS_NBR];
+
+/* Written with the scheduler suspended, read by the flight control task, in the CCM SRAM with FCB_CCM_RAM */
+static StickCurveLut_TypeDef stickCurveLuts[STICK_AXIS_NBR] CCM_RAM;
+
+static const char* const stickAxisNames[STICK_AXIS_NBR] = { "throttle", "roll", "pitch", "yaw" };
+
+/* Private function prototypes -----------------------------------------------*/
+static bool IsValidStickCurve(const StickCurveType* curve);
+static void BuildStickCurveLut(const StickCurveType* curve, StickCurveLut_TypeDef* lut);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Loads the stored curves, or the defaults if there are none or any is not valid, and builds their tables
+ * @param  None.
+ * @retval None.
+ */
+void InitStickCurves(void) {
+    StickCurveSettingsType settings;
+    bool useFlashCurves;
+    uint8_t axis;
+
+    CcmRamRegisterObject("stickCurveLuts", stickCurveLuts, sizeof(stickCurveLuts));
+
+    useFlashCurves = (FLASH_OK == ReadStickCurvesFromFlash(&settings));
+    for (axis = 0; axis < STICK_AXIS_NBR && useFlashCurves; axis++) {
+        useFlashCurves = IsValidStickCurve(&settings.curves[axis]);
+    }
+
+    for (axis = 0; axis < STICK_AXIS_NBR; axis++) {
+        if (useFlashCurves) {
+            stickCurves[axis] = settings.curves[axis];
+        } else {
+            stickCurves[axis].deadband = STICK_CURVE_DEFAULT_DEADBAND;
+            stickCurves[axis].expo = STICK_CURVE_DEFAULT_EXPO;
+            stickCurves[axis].superRate = STICK_CURVE_DEFAULT_SUPER_RATE;
+        }
+        BuildStickCurveLut(&stickCurves[axis], &stickCurveLuts[axis]);
+    }
+}
+
+/*
+ * @brief  Sets the curve of an axis. The table is built aside and swapped in, so the flight control task sees either
+ *         the old or the new curve.
+ * @param  axis : Stick axis
+ * @param  curve : Deadband, expo and super rate, see StickCurveType
+ * @retval FCB_OK if set, FCB_ERR if the axis or the curve is invalid
+ */
+FcbRetValType SetStickCurve(const StickAxisType axis, const StickCurveType* curve) {
+    StickCurveLut_TypeDef lut;
+
+    if (axis >= STICK_AXIS_NBR || NULL == curve || !IsValidStickCurve(curve)) {
+        return FCB_ERR;
+    }
+
+    BuildStickCurveLut(curve, &lut);
+
+    FCB_SUSPEND_SCHEDULER();
+    stickCurves[axis] = *curve;
+    stickCurveLuts[axis] = lut;
+    FCB_RESUME_SCHEDULER();
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Gets the curve of an axis
+ * @param  axis : Stick axis
+ * @param  curve : Destination
+ * @retval FCB_OK if read, FCB_ERR if the axis is invalid
+ */
+FcbRetValType GetStickCurve(const StickAxisType axis, StickCurveType* curve) {
+    if (axis >= STICK_AXIS_NBR || NULL == curve) {
+        return FCB_ERR;
+    }
+
+    FCB_SUSPEND_SCHEDULER();
+    *curve = stickCurves[axis];
+    FCB_RESUME_SCHEDULER();
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Saves the curves of all axes to flash, from where they are loaded at startup
+ * @param  None.
+ * @retval FCB_OK if saved, FCB_ERR if not in idle mode or if writing the flash failed
+ */
+FcbRetValType SaveStickCurves(void) {
+    StickCurveSettingsType settings;
+    uint8_t axis;
+
+    /* The curves are copied while disarmed, when no stick input or profile switch changes them halfway */
+    if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        return FCB_ERR;
+    }
+
+    for (axis = 0; axis < STICK_AXIS_NBR; axis++) {
+        GetStickCurve((StickAxisType) axis, &settings.curves[axis]);
+    }
+
+    if (FLASH_OK != WriteStickCurvesToFlash(&settings)) {
+        return FCB_ERR;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Maps a receiver channel value through the table of an axis, interpolating between its two nearest points
+ * @param  axis : Stick axis, not checked
+ * @param  receiverValue : Channel value in [INT16_MIN, INT16_MAX]
+ * @retval Shaped stick in [-1, 1]
+ */
+RAMFUNC float32_t ApplyStickCurve(const StickAxisType axis, const int32_t receiverValue) {
+    const StickCurveLut_TypeDef* lut = &stickCurveLuts[axis];
+    float32_t position, value;
+    uint32_t idx;
+
+    /* Position in the table, full deflection is the last point on both sides */
+    if (receiverValue >= 0) {
+        position = (float32_t) receiverValue * lut->positiveGain - lut->offset;
+    } else {
+        position = (float32_t) -receiverValue * lut->negativeGain - lut->offset;
+    }
+
+    if (position <= 0.0f) {
+        return 0.0f;
+    }
+
+    idx = (uint32_t) position;
+    if (idx >= STICK_CURVE_LUT_SIZE - 1) {
+        value = lut->points[STICK_CURVE_LUT_SIZE - 1];
+    } else {
+        value = lut->points[idx] + (position - (float32_t) idx) * (lut->points[idx + 1] - lut->points[idx]);
+    }
+
+    return receiverValue >= 0 ? value : -value;
+}
+
+/*
+ * @brief  Gets the name of a stick axis
+ * @param  axis : Stick axis
+ * @retval Name, or "?" for an invalid axis
+ */
+const char* GetStickAxisName(const StickAxisType axis) {
+    if (axis >= STICK_AXIS_NBR) {
+        return "?";
+    }
+
+    return stickAxisNames[axis];
+}
+
+size_t PrintStickCurves(char* dst, const size_t dstSize) {
+    StickCurveType curve;
+    float32_t values[3];
+    size_t length;
+    uint8_t axis;
+
+    length = (size_t) snprintf(dst, dstSize, "\nStick curves\naxis\t\tdeadband\texpo\t\tsuper rate\n");
+    for (axis = 0; axis < STICK_AXIS_NBR && length < dstSize; axis++) {
+        GetStickCurve((StickAxisType) axis, &curve);
+        length += (size_t) snprintf(dst + length, dstSize - length, "%s\t%s", stickAxisNames[axis],
+                (strlen(stickAxisNames[axis]) < 8) ? "\t" : "");
+        values[0] = curve.deadband;
+        values[1] = curve.expo;
+        values[2] = curve.superRate;
+        if (length < dstSize) {
+            length += FormatFixedList(dst + length, dstSize - length, "%1.3f\t\t%1.3f\t\t%1.3f\n", values, 3);
+        }
+    }
+
+    return length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Checks that a curve is within the ranges of StickCurveType
+ * @param  curve : Curve
+ * @retval true if valid, else false
+ */
+static bool IsValidStickCurve(const StickCurveType* curve) {
+    return curve->deadband >= 0.0f && curve->deadband <= STICK_CURVE_MAX_DEADBAND
+            && curve->expo >= 0.0f && curve->expo <= 1.0f
+            && curve->superRate >= 0.0f && curve->superRate <= STICK_CURVE_MAX_SUPER_RATE;
+}
+
+/*
+ * @brief  Samples a curve at STICK_CURVE_LUT_SIZE evenly spaced deflections from the deadband to full deflection
+ * @param  curve : Curve, valid
+ * @param  lut : Destination table, its points rise from 0 to 1
+ * @retval None.
+ */
+static void BuildStickCurveLut(const StickCurveType* curve, StickCurveLut_TypeDef* lut) {
+    float32_t scale = (float32_t) (STICK_CURVE_LUT_SIZE - 1) / (1.0f - curve->deadband);
+    float32_t x, y;
+    uint8_t i;
+
+    lut->positiveGain = scale / INT16_MAX;
+    lut->negativeGain = scale / -INT16_MIN;
+    lut->offset = scale * curve->deadband;
+
+    for (i = 0; i < STICK_CURVE_LUT_SIZE; i++) {
+        x = (float32_t) i / (STICK_CURVE_LUT_SIZE - 1);
+        y = (1.0f - curve->expo) * x + curve->expo * x * x * x;
+        lut->points[i] = y * (1.0f - curve->superRate) / (1.0f - curve->superRate * x);
+    }
+}
@@ -10,20 +10,28 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "receiver.h"
+#include "receiver_serial.h"
 #include "fcb_sensors.h"
 #include "fcb_gyroscope.h"
 #include "fcb_accelerometer_magnetometer.h"
+#include "fcb_barometer.h"
+#include "fcb_sensor_watchdog.h"
+#include "fcb_sensor_load_test.h"
 #include "fcb_error.h"
 #include "usbd_cdc_if.h"
 #include "uart.h"
 #include "state_estimation.h"
+#include "common.h"
+#include "deferred_log.h"
+#include "sd_card.h"
 
 #include "stm32f3_discovery.h"
 
 #include "FreeRTOS.h"
 #include "task.h"
 #include "semphr.h"
-#include "task_status.h"
+
+#include "isr_context.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
@@ -49,17 +57,22 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
     case USER_BUTTON_PIN:
         UserButtonPressed++;
         if (UserButtonPressed > 0x7) {
-            BSP_LED_Toggle(LED7);
             UserButtonPressed = 0x0;
         }
         break;
+#ifdef FCB_EXTERNAL_IMU
+    case GPIO_EXTERNAL_IMU_DRDY:
+#endif
     case GPIO_GYRO_DRDY:
-        FcbSendSensorMessageFromISR(FCB_SENSOR_GYRO_DATA_READY);
+        FcbSensorDrdyTimestampFromISR(GYRO_IDX);
+        GyroscopeDataReadyFromISR();
         break;
     case GPIO_ACCELEROMETER_DRDY:
+        FcbSensorDrdyTimestampFromISR(ACC_IDX);
         FcbSendSensorMessageFromISR(FCB_SENSOR_ACC_DATA_READY);
         break;
     case GPIO_MAGNETOMETER_DRDY:
+        FcbSensorDrdyTimestampFromISR(MAG_IDX);
         FcbSendSensorMessageFromISR(FCB_SENSOR_MAGNETO_DATA_READY);
         break;
     default:
@@ -73,7 +86,7 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin) {
  * @retval none
  */
 void HAL_PWR_PVDCallback(void) {
-	USBComSendString("Error: PVD\n");
+	LOG0("Error: PVD");
 
 	/* Voltage drop detected - Go to error handler */
 	ErrorHandler();
@@ -85,15 +98,9 @@ void HAL_PWR_PVDCallback(void) {
  * @retval None
  */
 void HAL_SYSTICK_Callback(void) {
-#if 1
+	/* Sees every wrap of the cycle counter, see GetTimestamp64() */
+	(void) GetTimestamp64();
 
-	static uint32_t kicks = 0;
-	kicks++;
-
-	if ((kicks % 1000) == 0) {
-		BSP_LED_Toggle(LED9);
-	}
-#endif
 	if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) {
 		xPortSysTickHandler();
 	}
@@ -111,10 +118,18 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
 		PrimaryReceiverTimerPeriodCountIncrement();
 	} else if (htim->Instance == AUX_RECEIVER_TIM) {
 		AuxReceiverTimerPeriodCountIncrement();
-	} else if (htim->Instance == TASK_STATUS_TIM){
-		IncreaseTaskStatusTimerPeriodCount();
 	} else if (htim->Instance == STATE_ESTIMATION_UPDATE_TIM){
 		SendPredictionUpdateToFlightControl();
+	} else if (htim->Instance == RECEIVER_FAILSAFE_TIM){
+		ReceiverFailsafeTimerElapsed();
+	} else if (htim->Instance == BAROMETER_TIM) {
+		BarometerTimerElapsedFromISR();
+	} else if (htim->Instance == SENSOR_WATCHDOG_TIM) {
+		SensorWatchdogTimerElapsedFromISR();
+#ifdef FCB_SENSOR_LOAD_TEST
+	} else if (htim->Instance == SENSOR_LOAD_TEST_TIM) {
+		SensorLoadTestTickFromISR();
+#endif
     }
 }
 
@@ -125,6 +140,10 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
  */
 void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim) {
 	if (htim->Instance == PRIMARY_RECEIVER_TIM) {
+#if (RECEIVER_INPUT_PROTOCOL == RECEIVER_PROTOCOL_PPM)
+		if (htim->Channel == RECEIVER_PPM_ACTIVE_CHANNEL)
+			UpdateReceiverPPMChannel();
+#else
 		if (htim->Channel == PRIMARY_RECEIVER_THROTTLE_ACTIVE_CHANNEL)
 			UpdateReceiverThrottleChannel();
 		else if (htim->Channel == PRIMARY_RECEIVER_AILERON_ACTIVE_CHANNEL)
@@ -133,6 +152,7 @@ void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim) {
 			UpdateReceiverElevatorChannel();
 		else if (htim->Channel == PRIMARY_RECEIVER_RUDDER_ACTIVE_CHANNEL)
 			UpdateReceiverRudderChannel();
+#endif
 	} else if (htim->Instance == AUX_RECEIVER_TIM) {
 		if (htim->Channel == AUX_RECEIVER_GEAR_ACTIVE_CHANNEL)
 			UpdateReceiverGearChannel();
@@ -142,40 +162,99 @@ void HAL_TIM_IC_CaptureCallback(TIM_HandleTypeDef *htim) {
 }
 
 /**
-  * @brief  Tx Transfer completed callback
-  * @param  UartHandle: UART handle.
+  * @brief  UART error callbacks
+  * @param  UartHandle: UART handle
+  * @note   This example shows a simple way to report transfer error, and you can
+  *         add your own implementation.
   * @retval None
   */
-void HAL_UART_TxCpltCallback(UART_HandleTypeDef *UartHandle)
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *UartHandle)
 {
     if(UartHandle->Instance == UART) {
-        HandleUartTxCallback(UartHandle);
+        HandleUartErrorCallback(UartHandle);
     }
 }
 
 /**
-  * @brief  Rx Transfer completed callback
-  * @param  UartHandle: UART handle
+  * @brief  SPI Tx/Rx Transfer completed callback
+  * @param  hspi: SPI handle
   * @retval None
   */
-void HAL_UART_RxCpltCallback(UART_HandleTypeDef *UartHandle)
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi)
 {
-    if(UartHandle->Instance == UART) {
-        HandleUartRxCallback(UartHandle);
+    if(GYRO_IO_IsSPIHandle(hspi)) {
+        GyroscopeDMACompleteFromISR();
     }
 }
 
+#ifdef FCB_SD_CARD
 /**
-  * @brief  UART error callbacks
-  * @param  UartHandle: UART handle
-  * @note   This example shows a simple way to report transfer error, and you can
-  *         add your own implementation.
+  * @brief  SPI Tx Transfer completed callback
+  * @param  hspi: SPI handle
   * @retval None
   */
-void HAL_UART_ErrorCallback(UART_HandleTypeDef *UartHandle)
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
 {
-    if(UartHandle->Instance == UART) {
-        HandleUartErrorCallback(UartHandle);
+    if(SdCardIsSPIHandle(hspi)) {
+        SdCardDMACompleteFromISR();
+    }
+}
+#endif
+
+/**
+  * @brief  SPI error callback
+  * @param  hspi: SPI handle
+  * @retval None
+  */
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
+{
+    if(GYRO_IO_IsSPIHandle(hspi)) {
+        GyroscopeDMAErrorFromISR();
+    }
+#ifdef FCB_SD_CARD
+    else if(SdCardIsSPIHandle(hspi)) {
+        SdCardDMAErrorFromISR();
+    }
+#endif
+}
+
+/**
+  * @brief  I2C memory write completed callback
+  * @param  hi2c: I2C handle
+  * @retval None
+  */
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    if(I2Cbar_IsI2CHandle(hi2c)) {
+        BarometerConversionStartedFromISR();
+    }
+}
+
+/**
+  * @brief  I2C memory read completed callback
+  * @param  hi2c: I2C handle
+  * @retval None
+  */
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    if(I2Cx_IsI2CHandle(hi2c)) {
+        AccMagReadCompleteFromISR();
+    } else if(I2Cbar_IsI2CHandle(hi2c)) {
+        BarometerReadCompleteFromISR();
+    }
+}
+
+/**
+  * @brief  I2C error callback
+  * @param  hi2c: I2C handle
+  * @retval None
+  */
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+    if(I2Cx_IsI2CHandle(hi2c)) {
+        AccMagReadErrorFromISR();
+    } else if(I2Cbar_IsI2CHandle(hi2c)) {
+        BarometerReadErrorFromISR();
     }
 }
 
@@ -53,10 +53,17 @@
 
 #include "motor_control.h"
 #include "receiver.h"
+#include "receiver_serial.h"
 #include "state_estimation.h"
 #include "uart.h"
-
-#include "task_status.h"
+#include "fcb_sensor_load_test.h"
+#include "fcb_barometer.h"
+#include "fcb_sensor_watchdog.h"
+#include "fcb_gps.h"
+#include "esc_telemetry.h"
+#include "fcb_battery.h"
+#include "sd_card.h"
+#include "can_bus.h"
 
 /** @addtogroup STM32F3xx_HAL_Driver
  * @{
@@ -71,6 +78,10 @@
 /* Private define ------------------------------------------------------------*/
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
+#if MOTOR_OUTPUT_IS_DSHOT
+static DMA_HandleTypeDef hdma_motor;
+#endif
+
 /* Private function prototypes -----------------------------------------------*/
 /* Exported functions ---------------------------------------------------------*/
 
@@ -171,16 +182,6 @@ void HAL_TIM_Base_MspInit(TIM_HandleTypeDef *htim) {
 
         /* Enable the AUX_RECEIVER_TIM global Interrupt */
         HAL_NVIC_EnableIRQ(AUX_RECEIVER_TIM_IRQn);
-    } else if (htim->Instance == TASK_STATUS_TIM) {
-        /*##-1- Enable peripherals and GPIO Clocks #################################*/
-        /* TIM Task status clock enable */
-        TASK_STATUS_TIM_CLK_ENABLE();
-
-        /*##-2- Configure the NVIC for TASK_STATUS_TIM ############################*/
-        HAL_NVIC_SetPriority(TASK_STATUS_TIM_IRQn, TASK_STATUS_TIM_IRQ_PREEMPT_PRIO, TASK_STATUS_TIM_IRQ_SUB_PRIO);
-
-        /* Enable the TASK_STATUS_TIM global Interrupt */
-        HAL_NVIC_EnableIRQ(TASK_STATUS_TIM_IRQn);
     } else if (htim->Instance == STATE_ESTIMATION_UPDATE_TIM) {
         /*##-1- Enable peripherals and GPIO Clocks #################################*/
         /* TIM State estimation update clock enable */
@@ -192,6 +193,51 @@ void HAL_TIM_Base_MspInit(TIM_HandleTypeDef *htim) {
 
         /* Enable the STATE_ESTIMATION_UPDATE_TIM global Interrupt */
         HAL_NVIC_EnableIRQ(STATE_ESTIMATION_UPDATE_TIM_IRQn);
+    } else if (htim->Instance == RECEIVER_FAILSAFE_TIM) {
+        /*##-1- Enable peripherals and GPIO Clocks #################################*/
+        /* Receiver failsafe TIM clock enable */
+        RECEIVER_FAILSAFE_TIM_CLK_ENABLE();
+
+        /*##-2- Configure the NVIC for RECEIVER_FAILSAFE_TIM #######################*/
+        HAL_NVIC_SetPriority(RECEIVER_FAILSAFE_TIM_IRQn, RECEIVER_FAILSAFE_TIM_IRQ_PREEMPT_PRIO,
+        RECEIVER_FAILSAFE_TIM_IRQ_SUB_PRIO);
+
+        /* Enable the RECEIVER_FAILSAFE_TIM global Interrupt */
+        HAL_NVIC_EnableIRQ(RECEIVER_FAILSAFE_TIM_IRQn);
+    } else if (htim->Instance == BAROMETER_TIM) {
+        /*##-1- Enable peripherals and GPIO Clocks #################################*/
+        /* Barometer conversion TIM clock enable */
+        BAROMETER_TIM_CLK_ENABLE();
+
+        /*##-2- Configure the NVIC for BAROMETER_TIM ###############################*/
+        HAL_NVIC_SetPriority(BAROMETER_TIM_IRQn, BAROMETER_TIM_IRQ_PREEMPT_PRIO, BAROMETER_TIM_IRQ_SUB_PRIO);
+
+        /* Enable the BAROMETER_TIM global Interrupt */
+        HAL_NVIC_EnableIRQ(BAROMETER_TIM_IRQn);
+    } else if (htim->Instance == SENSOR_WATCHDOG_TIM) {
+        /*##-1- Enable peripherals and GPIO Clocks #################################*/
+        /* Sensor watchdog TIM clock enable */
+        SENSOR_WATCHDOG_TIM_CLK_ENABLE();
+
+        /*##-2- Configure the NVIC for SENSOR_WATCHDOG_TIM #########################*/
+        HAL_NVIC_SetPriority(SENSOR_WATCHDOG_TIM_IRQn, SENSOR_WATCHDOG_TIM_IRQ_PREEMPT_PRIO,
+        SENSOR_WATCHDOG_TIM_IRQ_SUB_PRIO);
+
+        /* Enable the SENSOR_WATCHDOG_TIM global Interrupt */
+        HAL_NVIC_EnableIRQ(SENSOR_WATCHDOG_TIM_IRQn);
+#ifdef FCB_SENSOR_LOAD_TEST
+    } else if (htim->Instance == SENSOR_LOAD_TEST_TIM) {
+        /*##-1- Enable peripherals and GPIO Clocks #################################*/
+        /* Sensor load test TIM clock enable */
+        SENSOR_LOAD_TEST_TIM_CLK_ENABLE();
+
+        /*##-2- Configure the NVIC for SENSOR_LOAD_TEST_TIM ########################*/
+        HAL_NVIC_SetPriority(SENSOR_LOAD_TEST_TIM_IRQn, SENSOR_LOAD_TEST_TIM_IRQ_PREEMPT_PRIO,
+        SENSOR_LOAD_TEST_TIM_IRQ_SUB_PRIO);
+
+        /* Enable the SENSOR_LOAD_TEST_TIM global Interrupt */
+        HAL_NVIC_EnableIRQ(SENSOR_LOAD_TEST_TIM_IRQn);
+#endif
     }
 }
 
@@ -208,12 +254,23 @@ void HAL_TIM_Base_MspDeInit(TIM_HandleTypeDef *htim) {
     } else if(htim->Instance == AUX_RECEIVER_TIM) {
         /* Aux receiver TIM Peripheral clock disable */
         AUX_RECEIVER_TIM_CLK_DISABLE();
-    } else if(htim->Instance == TASK_STATUS_TIM) {
-        /* Task status TIM Peripheral clock disable */
-        TASK_STATUS_TIM_CLK_DISABLE();
     } else if(htim->Instance == STATE_ESTIMATION_UPDATE_TIM) {
         /* State estimation update TIM Peripheral clock disable */
         STATE_ESTIMATION_UPDATE_TIM_CLK_DISABLE();
+    } else if(htim->Instance == RECEIVER_FAILSAFE_TIM) {
+        /* Receiver failsafe TIM Peripheral clock disable */
+        RECEIVER_FAILSAFE_TIM_CLK_DISABLE();
+    } else if(htim->Instance == BAROMETER_TIM) {
+        /* Barometer conversion TIM Peripheral clock disable */
+        BAROMETER_TIM_CLK_DISABLE();
+    } else if(htim->Instance == SENSOR_WATCHDOG_TIM) {
+        /* Sensor watchdog TIM Peripheral clock disable */
+        SENSOR_WATCHDOG_TIM_CLK_DISABLE();
+#ifdef FCB_SENSOR_LOAD_TEST
+    } else if(htim->Instance == SENSOR_LOAD_TEST_TIM) {
+        /* Sensor load test TIM Peripheral clock disable */
+        SENSOR_LOAD_TEST_TIM_CLK_DISABLE();
+#endif
     }
 }
 
@@ -254,6 +311,31 @@ void HAL_TIM_PWM_MspInit(TIM_HandleTypeDef *htim) {
 		/* Motor channel 4 pin */
 		GPIO_InitStruct.Pin = MOTOR_GPIO_PIN_CHANNEL4;
 		HAL_GPIO_Init(MOTOR_PIN_PORT, &GPIO_InitStruct);
+
+#if MOTOR_OUTPUT_IS_DSHOT
+		/* Configure the DMA handler for the DShot frame bursts, the transfers are started by the motor control */
+		MOTOR_DSHOT_DMA_CLK_ENABLE();
+
+		hdma_motor.Instance                 = MOTOR_DSHOT_DMA_CHANNEL;
+		hdma_motor.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+		hdma_motor.Init.PeriphInc           = DMA_PINC_DISABLE;
+		hdma_motor.Init.MemInc              = DMA_MINC_ENABLE;
+		hdma_motor.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+		hdma_motor.Init.MemDataAlignment    = DMA_MDATAALIGN_WORD;
+		hdma_motor.Init.Mode                = DMA_NORMAL;
+		hdma_motor.Init.Priority            = DMA_PRIORITY_VERY_HIGH;
+
+		HAL_DMA_Init(&hdma_motor);
+
+		/* Associate the initialized DMA handle to the motor TIM handle */
+		__HAL_LINKDMA(htim, hdma[MOTOR_DSHOT_DMA_ID], hdma_motor);
+
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+		/* The end of each frame and of its answer samples, see MotorDshotDmaIRQHandler() */
+		HAL_NVIC_SetPriority(MOTOR_DSHOT_DMA_IRQn, MOTOR_DSHOT_DMA_IRQ_PREEMPT_PRIO, MOTOR_DSHOT_DMA_IRQ_SUB_PRIO);
+		HAL_NVIC_EnableIRQ(MOTOR_DSHOT_DMA_IRQn);
+#endif
+#endif
 	}
 }
 
@@ -374,9 +456,118 @@ void HAL_UART_MspInit(UART_HandleTypeDef *huart)
 {
   static DMA_HandleTypeDef hdma_tx;
   static DMA_HandleTypeDef hdma_rx;
+  static DMA_HandleTypeDef hdma_receiver_rx;
+#ifdef FCB_GPS
+  static DMA_HandleTypeDef hdma_gps_rx;
+#endif
 
   GPIO_InitTypeDef GPIO_InitStruct;
 
+  if (huart->Instance == SERIAL_RECEIVER_UART)
+  {
+    /*##-1- Enable peripherals and GPIO Clocks ###############################*/
+    SERIAL_RECEIVER_UART_RX_GPIO_CLK_ENABLE();
+    SERIAL_RECEIVER_UART_CLK_ENABLE();
+    SERIAL_RECEIVER_UART_DMA_CLK_ENABLE();
+
+    /*##-2- Configure peripheral GPIO ########################################*/
+    GPIO_InitStruct.Pin       = SERIAL_RECEIVER_UART_RX_PIN;
+    GPIO_InitStruct.Mode      = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull      = GPIO_PULLUP;
+    GPIO_InitStruct.Speed     = GPIO_SPEED_HIGH;
+    GPIO_InitStruct.Alternate = SERIAL_RECEIVER_UART_RX_AF;
+
+    HAL_GPIO_Init(SERIAL_RECEIVER_UART_RX_GPIO_PORT, &GPIO_InitStruct);
+
+    /*##-3- Configure the DMA channel ########################################*/
+    /* Circular reception into the frame ring buffer */
+    hdma_receiver_rx.Instance                 = SERIAL_RECEIVER_UART_RX_DMA_CHANNEL;
+    hdma_receiver_rx.Init.Direction           = DMA_PERIPH_TO_MEMORY;
+    hdma_receiver_rx.Init.PeriphInc           = DMA_PINC_DISABLE;
+    hdma_receiver_rx.Init.MemInc              = DMA_MINC_ENABLE;
+    hdma_receiver_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_receiver_rx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+    hdma_receiver_rx.Init.Mode                = DMA_CIRCULAR;
+    hdma_receiver_rx.Init.Priority            = DMA_PRIORITY_MEDIUM;
+
+    HAL_DMA_Init(&hdma_receiver_rx);
+
+    /* Associate the initialized DMA handle to the the UART handle */
+    __HAL_LINKDMA(huart, hdmarx, hdma_receiver_rx);
+
+    /*##-4- Configure the NVIC for the idle line interrupt ###################*/
+    HAL_NVIC_SetPriority(SERIAL_RECEIVER_UART_IRQn, SERIAL_RECEIVER_UART_IRQ_PREEMPT_PRIO,
+        SERIAL_RECEIVER_UART_IRQ_SUB_PRIO);
+    HAL_NVIC_EnableIRQ(SERIAL_RECEIVER_UART_IRQn);
+    return;
+  }
+
+#ifdef FCB_GPS
+  if (huart->Instance == GPS_UART)
+  {
+    /*##-1- Enable peripherals and GPIO Clocks ###############################*/
+    GPS_UART_GPIO_CLK_ENABLE();
+    GPS_UART_CLK_ENABLE();
+    GPS_UART_DMA_CLK_ENABLE();
+
+    /*##-2- Configure peripheral GPIO ########################################*/
+    GPIO_InitStruct.Pin       = GPS_UART_TX_PIN | GPS_UART_RX_PIN;
+    GPIO_InitStruct.Mode      = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull      = GPIO_PULLUP;
+    GPIO_InitStruct.Speed     = GPIO_SPEED_HIGH;
+    GPIO_InitStruct.Alternate = GPS_UART_AF;
+
+    HAL_GPIO_Init(GPS_UART_GPIO_PORT, &GPIO_InitStruct);
+
+    /*##-3- Configure the DMA channel ########################################*/
+    /* Circular reception into the message ring buffer, the configuration is sent without DMA */
+    hdma_gps_rx.Instance                 = GPS_UART_RX_DMA_CHANNEL;
+    hdma_gps_rx.Init.Direction           = DMA_PERIPH_TO_MEMORY;
+    hdma_gps_rx.Init.PeriphInc           = DMA_PINC_DISABLE;
+    hdma_gps_rx.Init.MemInc              = DMA_MINC_ENABLE;
+    hdma_gps_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_gps_rx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+    hdma_gps_rx.Init.Mode                = DMA_CIRCULAR;
+    hdma_gps_rx.Init.Priority            = DMA_PRIORITY_LOW;
+
+    HAL_DMA_Init(&hdma_gps_rx);
+
+    /* Associate the initialized DMA handle to the the UART handle */
+    __HAL_LINKDMA(huart, hdmarx, hdma_gps_rx);
+
+    /*##-4- Configure the NVIC for the idle line interrupt ###################*/
+    HAL_NVIC_SetPriority(GPS_UART_IRQn, GPS_UART_IRQ_PREEMPT_PRIO, GPS_UART_IRQ_SUB_PRIO);
+    HAL_NVIC_EnableIRQ(GPS_UART_IRQn);
+    return;
+  }
+#endif
+
+#ifdef MOTOR_ESC_TELEMETRY
+  if (huart->Instance == ESC_TELEMETRY_UART)
+  {
+    /*##-1- Enable peripherals and GPIO Clocks ###############################*/
+    ESC_TELEMETRY_UART_GPIO_CLK_ENABLE();
+    ESC_TELEMETRY_UART_CLK_ENABLE();
+
+    /*##-2- Configure peripheral GPIO ########################################*/
+    /* Receive only, the open drain telemetry outputs of the ESC:s share the line */
+    GPIO_InitStruct.Pin       = ESC_TELEMETRY_UART_RX_PIN;
+    GPIO_InitStruct.Mode      = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull      = GPIO_PULLUP;
+    GPIO_InitStruct.Speed     = GPIO_SPEED_HIGH;
+    GPIO_InitStruct.Alternate = ESC_TELEMETRY_UART_AF;
+
+    HAL_GPIO_Init(ESC_TELEMETRY_UART_GPIO_PORT, &GPIO_InitStruct);
+
+    /*##-3- Configure the NVIC for the receive interrupt #####################*/
+    /* No DMA, the USART3 RX request shares DMA1 channel 3 with the gyroscope SPI TX */
+    HAL_NVIC_SetPriority(ESC_TELEMETRY_UART_IRQn, ESC_TELEMETRY_UART_IRQ_PREEMPT_PRIO,
+        ESC_TELEMETRY_UART_IRQ_SUB_PRIO);
+    HAL_NVIC_EnableIRQ(ESC_TELEMETRY_UART_IRQn);
+    return;
+  }
+#endif
+
   /*##-1- Enable peripherals and GPIO Clocks #################################*/
   /* Enable GPIO TX/RX clock */
   UART_TX_GPIO_CLK_ENABLE();
@@ -420,11 +611,11 @@ void HAL_UART_MspInit(UART_HandleTypeDef *huart)
   /* Associate the initialized DMA handle to the UART handle */
   __HAL_LINKDMA(huart, hdmatx, hdma_tx);
 
-  /* Configure the DMA handler for reception process */
+  /* Configure the DMA handler for reception process, circular into the RX ring buffer */
   hdma_rx.Instance                 = UART_RX_DMA_STREAM;
   hdma_rx.Init.Direction           = DMA_PERIPH_TO_MEMORY;
   hdma_rx.Init.PeriphInc           = DMA_PINC_DISABLE;
-  hdma_rx.Init.MemInc              = DMA_MINC_DISABLE;
+  hdma_rx.Init.MemInc              = DMA_MINC_ENABLE;
   hdma_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
   hdma_rx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
   hdma_rx.Init.Mode                = DMA_CIRCULAR;
@@ -440,9 +631,13 @@ void HAL_UART_MspInit(UART_HandleTypeDef *huart)
   HAL_NVIC_SetPriority(UART_DMA_TX_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY, 0);
   HAL_NVIC_EnableIRQ(UART_DMA_TX_IRQn);
 
-  /* NVIC configuration for DMA transfer complete interrupt (USARTx_RX) */
+  /* NVIC configuration for DMA half and full transfer interrupts (USARTx_RX) */
   HAL_NVIC_SetPriority(UART_DMA_RX_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY, 0);
   HAL_NVIC_EnableIRQ(UART_DMA_RX_IRQn);
+
+  /* NVIC configuration for the UART idle line interrupt, same priority as the RX DMA since both read the ring buffer */
+  HAL_NVIC_SetPriority(UART_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(UART_IRQn);
 }
 
 /**
@@ -480,7 +675,150 @@ void HAL_UART_MspDeInit(UART_HandleTypeDef *huart)
   /*##-4- Disable the NVIC for DMA ###########################################*/
   HAL_NVIC_DisableIRQ(UART_DMA_TX_IRQn);
   HAL_NVIC_DisableIRQ(UART_DMA_RX_IRQn);
+  HAL_NVIC_DisableIRQ(UART_IRQn);
+}
+
+#ifdef FCB_SD_CARD
+/**
+  * @brief SPI MSP Initialization
+  *        Configures the SD card SPI pins, its chip select and the TX DMA channel the sectors are sent by. The
+  *        gyroscope SPI is configured by the BSP.
+  * @param hspi: SPI handle pointer
+  * @retval None
+  */
+void HAL_SPI_MspInit(SPI_HandleTypeDef *hspi)
+{
+  static DMA_HandleTypeDef hdma_sd_tx;
+  GPIO_InitTypeDef GPIO_InitStruct;
+
+  if (hspi->Instance == SD_CARD_SPI)
+  {
+    /*##-1- Enable peripherals and GPIO Clocks ###############################*/
+    SD_CARD_SPI_GPIO_CLK_ENABLE();
+    SD_CARD_SPI_CLK_ENABLE();
+    SD_CARD_SPI_DMA_CLK_ENABLE();
+
+    /*##-2- Configure peripheral GPIO ########################################*/
+    GPIO_InitStruct.Pin       = SD_CARD_SPI_SCK_PIN | SD_CARD_SPI_MOSI_PIN;
+    GPIO_InitStruct.Mode      = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull      = GPIO_NOPULL;
+    GPIO_InitStruct.Speed     = GPIO_SPEED_HIGH;
+    GPIO_InitStruct.Alternate = SD_CARD_SPI_AF;
+
+    HAL_GPIO_Init(SD_CARD_SPI_GPIO_PORT, &GPIO_InitStruct);
+
+    GPIO_InitStruct.Pin       = SD_CARD_SPI_MISO_PIN;
+    GPIO_InitStruct.Pull      = GPIO_PULLUP;
+
+    HAL_GPIO_Init(SD_CARD_SPI_GPIO_PORT, &GPIO_InitStruct);
+
+    /* Chip select, deselected */
+    HAL_GPIO_WritePin(SD_CARD_CS_GPIO_PORT, SD_CARD_CS_PIN, GPIO_PIN_SET);
+    GPIO_InitStruct.Pin       = SD_CARD_CS_PIN;
+    GPIO_InitStruct.Mode      = GPIO_MODE_OUTPUT_PP;
+    GPIO_InitStruct.Pull      = GPIO_PULLUP;
+
+    HAL_GPIO_Init(SD_CARD_CS_GPIO_PORT, &GPIO_InitStruct);
+
+    /*##-3- Configure the DMA channel ########################################*/
+    /* Sectors are sent by DMA, the bytes received meanwhile are dropped. Reception is polled. */
+    hdma_sd_tx.Instance                 = SD_CARD_SPI_TX_DMA_CHANNEL;
+    hdma_sd_tx.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+    hdma_sd_tx.Init.PeriphInc           = DMA_PINC_DISABLE;
+    hdma_sd_tx.Init.MemInc              = DMA_MINC_ENABLE;
+    hdma_sd_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_sd_tx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+    hdma_sd_tx.Init.Mode                = DMA_NORMAL;
+    hdma_sd_tx.Init.Priority            = DMA_PRIORITY_LOW;
+
+    HAL_DMA_Init(&hdma_sd_tx);
+
+    /* Associate the initialized DMA handle to the the SPI handle */
+    __HAL_LINKDMA(hspi, hdmatx, hdma_sd_tx);
+
+    /*##-4- Configure the NVIC for the DMA ###################################*/
+    HAL_NVIC_SetPriority(SD_CARD_SPI_DMA_TX_IRQn, SD_CARD_SPI_DMA_IRQ_PREEMPT_PRIO, SD_CARD_SPI_DMA_IRQ_SUB_PRIO);
+    HAL_NVIC_EnableIRQ(SD_CARD_SPI_DMA_TX_IRQn);
+  }
+}
+#endif
+
+#if defined(FCB_BATTERY_MONITOR) && !defined(BATTERY_INPUT_IS_DRONECAN)
+/**
+ * @brief ADC MSP Initialization
+ *        Configures the battery channel pins as analog inputs and the circular DMA channel of the battery ADC
+ * @param hadc: ADC handle pointer
+ * @retval None
+ */
+void HAL_ADC_MspInit(ADC_HandleTypeDef *hadc) {
+	static DMA_HandleTypeDef hdma_battery;
+	GPIO_InitTypeDef GPIO_InitStruct;
+
+	if (hadc->Instance == BATTERY_ADC) {
+		BATTERY_GPIO_CLK_ENABLE();
+		BATTERY_ADC_CLK_ENABLE();
+		BATTERY_ADC_DMA_CLK_ENABLE();
+
+		GPIO_InitStruct.Pin = BATTERY_VOLTAGE_PIN;
+#ifdef FCB_BATTERY_CURRENT_SENSOR
+		GPIO_InitStruct.Pin |= BATTERY_CURRENT_PIN;
+#endif
+		GPIO_InitStruct.Mode = GPIO_MODE_ANALOG;
+		GPIO_InitStruct.Pull = GPIO_NOPULL;
+		HAL_GPIO_Init(BATTERY_GPIO_PORT, &GPIO_InitStruct);
+
+		/* Circular conversions into the averaged buffer, without interrupts */
+		hdma_battery.Instance = BATTERY_ADC_DMA_CHANNEL;
+		hdma_battery.Init.Direction = DMA_PERIPH_TO_MEMORY;
+		hdma_battery.Init.PeriphInc = DMA_PINC_DISABLE;
+		hdma_battery.Init.MemInc = DMA_MINC_ENABLE;
+		hdma_battery.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+		hdma_battery.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+		hdma_battery.Init.Mode = DMA_CIRCULAR;
+		hdma_battery.Init.Priority = DMA_PRIORITY_LOW;
+
+		HAL_DMA_Init(&hdma_battery);
+
+		__HAL_LINKDMA(hadc, DMA_Handle, hdma_battery);
+	}
+}
+#endif
+
+#ifdef FCB_CAN_BUS
+/**
+  * @brief CAN MSP Initialization
+  *        Configures the bxCAN pins and the NVIC of its FIFO 1 and TX interrupts
+  * @param hcan: CAN handle pointer
+  * @retval None
+  */
+void HAL_CAN_MspInit(CAN_HandleTypeDef *hcan)
+{
+  GPIO_InitTypeDef GPIO_InitStruct;
+
+  /*##-1- Enable peripherals and GPIO Clocks #################################*/
+  CAN_BUS_GPIO_CLK_ENABLE();
+  CAN_BUS_CLK_ENABLE();
+
+  /*##-2- Configure peripheral GPIO ##########################################*/
+  GPIO_InitStruct.Pin       = CAN_BUS_TX_PIN;
+  GPIO_InitStruct.Mode      = GPIO_MODE_AF_PP;
+  GPIO_InitStruct.Pull      = GPIO_NOPULL;
+  GPIO_InitStruct.Speed     = GPIO_SPEED_HIGH;
+  GPIO_InitStruct.Alternate = CAN_BUS_AF;
+  HAL_GPIO_Init(CAN_BUS_GPIO_PORT, &GPIO_InitStruct);
+
+  /* Recessive without a transceiver, which keeps the peripheral from seeing a dominant bus */
+  GPIO_InitStruct.Pin       = CAN_BUS_RX_PIN;
+  GPIO_InitStruct.Pull      = GPIO_PULLUP;
+  HAL_GPIO_Init(CAN_BUS_GPIO_PORT, &GPIO_InitStruct);
+
+  /*##-3- Configure the NVIC #################################################*/
+  HAL_NVIC_SetPriority(CAN_BUS_RX_IRQn, CAN_BUS_IRQ_PREEMPT_PRIO, CAN_BUS_IRQ_SUB_PRIO);
+  HAL_NVIC_EnableIRQ(CAN_BUS_RX_IRQn);
+  HAL_NVIC_SetPriority(CAN_BUS_TX_IRQn, CAN_BUS_IRQ_PREEMPT_PRIO, CAN_BUS_IRQ_SUB_PRIO);
+  HAL_NVIC_EnableIRQ(CAN_BUS_TX_IRQn);
 }
+#endif
 
 /**
  * @}
@@ -15,10 +15,27 @@
 #include "stm32f3_discovery.h"
 
 #include "fcb_error.h"
-#include "task_status.h"
 #include "receiver.h"
+#include "receiver_serial.h"
 #include "state_estimation.h"
 #include "uart.h"
+#include "common.h"
+#include "trace_recorder.h"
+#include "scope_probe.h"
+#include "isr_monitor.h"
+#include "control_executive.h"
+#include "fcb_sensor_load_test.h"
+#include "fcb_barometer.h"
+#include "fcb_sensor_watchdog.h"
+#include "fcb_gps.h"
+#include "motor_control.h"
+#include "esc_telemetry.h"
+#include "sd_card.h"
+#include "can_bus.h"
+#include "fcb_gyroscope.h"
+#include "benchmark.h"
+
+#include "isr_context.h"
 
 /** @addtogroup STM32F3-Discovery_Demo STM32F3-Discovery_Demo
  * @{
@@ -47,28 +64,25 @@ void NMI_Handler(void) {
 }
 
 /**
- * @brief  This function handles Hard Fault exception.
+ * @brief  This function handles Hard Fault exception. Naked, so that no prologue moves the stack pointer or LR before
+ *         they are passed on to GetRegistersFromStack(), which does not return.
  * @param  None
  * @retval None
  */
-void HardFault_Handler(void) {
+__attribute__((naked)) void HardFault_Handler(void) {
 
-	/* Determine which stack is used */
+	/* Determine which stack is used, pass the fault frame and EXC_RETURN */
 	__asm volatile
 	(
 			" tst lr, #4                                                \n"
 			" ite eq                                                    \n"
 			" mrseq r0, msp                                             \n"
 			" mrsne r0, psp                                             \n"
-			" ldr r1, [r0, #24]                                         \n"
+			" mov r1, lr                                                \n"
 			" ldr r2, handler2_address_const                            \n"
 			" bx r2                                                     \n"
 			" handler2_address_const: .word GetRegistersFromStack       \n"
 	);
-
-	ErrorHandler();
-	while (1) {
-	}
 }
 
 /**
@@ -136,7 +150,9 @@ void DebugMon_Handler(void) {
  * @retval None
  */
 void SysTick_Handler(void) {
+	ISR_MONITOR_BEGIN(ISR_MONITOR_SYSTICK);
 	HAL_SYSTICK_IRQHandler();
+	ISR_MONITOR_END(ISR_MONITOR_SYSTICK);
 }
 
 /******************************************************************************/
@@ -152,7 +168,9 @@ void SysTick_Handler(void) {
  * @retval None
  */
 void PVD_IRQHandler(void) {
+	ISR_MONITOR_BEGIN(ISR_MONITOR_PVD);
 	HAL_PWR_PVD_IRQHandler();
+	ISR_MONITOR_END(ISR_MONITOR_PVD);
 }
 
 /**
@@ -161,7 +179,9 @@ void PVD_IRQHandler(void) {
  * @retval None
  */
 void PRIMARY_RECEIVER_TIM_IRQHandler(void) {
+	ISR_MONITOR_BEGIN(ISR_MONITOR_PRIMARY_RECEIVER);
 	HAL_TIM_IRQHandler(&PrimaryReceiverTimHandle);
+	ISR_MONITOR_END(ISR_MONITOR_PRIMARY_RECEIVER);
 }
 
 /**
@@ -170,16 +190,20 @@ void PRIMARY_RECEIVER_TIM_IRQHandler(void) {
  * @retval None
  */
 void AUX_RECEIVER_TIM_IRQHandler(void) {
+	ISR_MONITOR_BEGIN(ISR_MONITOR_AUX_RECEIVER);
 	HAL_TIM_IRQHandler(&AuxReceiverTimHandle);
+	ISR_MONITOR_END(ISR_MONITOR_AUX_RECEIVER);
 }
 
 /**
- * @brief  This function handles the TASK_STATUS_TIM timer interrupt request.
+ * @brief  This function handles the SERIAL_RECEIVER_UART interrupt request.
  * @param  None
  * @retval None
  */
-void TASK_STATUS_TIM_IRQHandler(void) {
-	HAL_TIM_IRQHandler(&TaskStatusTimHandle);
+void SERIAL_RECEIVER_UART_IRQHandler(void) {
+	ISR_MONITOR_BEGIN(ISR_MONITOR_SERIAL_RECEIVER);
+	SerialReceiverUartIRQHandler();
+	ISR_MONITOR_END(ISR_MONITOR_SERIAL_RECEIVER);
 }
 
 /**
@@ -188,8 +212,158 @@ void TASK_STATUS_TIM_IRQHandler(void) {
  * @retval None
  */
 void STATE_ESTIMATION_UPDATE_TIM_IRQHandler(void) {
+    ISR_MONITOR_BEGIN(ISR_MONITOR_STATE_ESTIMATION);
+    TRACE_ISR_BEGIN(TRACE_ISR_STATE_ESTIMATION);
     HAL_TIM_IRQHandler(&StateEstimationTimHandle);
+    TRACE_ISR_END();
+    ISR_MONITOR_END(ISR_MONITOR_STATE_ESTIMATION);
+}
+
+#ifdef FCB_CONTROL_EXECUTIVE
+/**
+ * @brief  This function handles the CONTROL_EXECUTIVE interrupt request, pended by the gyroscope DMA complete.
+ * @param  None
+ * @retval None
+ */
+void CONTROL_EXECUTIVE_IRQHandler(void) {
+	ISR_MONITOR_BEGIN(ISR_MONITOR_CONTROL_EXECUTIVE);
+	ControlExecutiveIRQHandler();
+	ISR_MONITOR_END(ISR_MONITOR_CONTROL_EXECUTIVE);
 }
+#endif
+
+#ifdef FCB_BENCHMARK_BUILD
+/**
+ * @brief  This function handles the BENCHMARK_IPC interrupt request, pended by the signalling benchmarks.
+ * @param  None
+ * @retval None
+ */
+void BENCHMARK_IPC_IRQHandler(void) {
+	BenchmarkIpcIRQHandler();
+}
+#endif
+
+#ifdef FCB_SENSOR_LOAD_TEST
+/**
+ * @brief  This function handles the SENSOR_LOAD_TEST_TIM timer interrupt request.
+ * @param  None
+ * @retval None
+ */
+void SENSOR_LOAD_TEST_TIM_IRQHandler(void) {
+	ISR_MONITOR_BEGIN(ISR_MONITOR_SENSOR_LOAD_TEST);
+	HAL_TIM_IRQHandler(&SensorLoadTestTimHandle);
+	ISR_MONITOR_END(ISR_MONITOR_SENSOR_LOAD_TEST);
+}
+#endif
+
+/**
+ * @brief  This function handles the RECEIVER_FAILSAFE_TIM timer interrupt request.
+ * @param  None
+ * @retval None
+ */
+void RECEIVER_FAILSAFE_TIM_IRQHandler(void) {
+	ISR_MONITOR_BEGIN(ISR_MONITOR_RECEIVER_FAILSAFE);
+	HAL_TIM_IRQHandler(&ReceiverFailsafeTimHandle);
+	ISR_MONITOR_END(ISR_MONITOR_RECEIVER_FAILSAFE);
+}
+
+/**
+ * @brief  This function handles the BAROMETER_TIM timer interrupt request, the end of a conversion.
+ * @param  None
+ * @retval None
+ */
+void BAROMETER_TIM_IRQHandler(void) {
+	ISR_MONITOR_BEGIN(ISR_MONITOR_BARO_TIM);
+	HAL_TIM_IRQHandler(&BarometerTimHandle);
+	ISR_MONITOR_END(ISR_MONITOR_BARO_TIM);
+}
+
+/**
+ * @brief  This function handles the SENSOR_WATCHDOG_TIM timer interrupt request, the watchdog tick.
+ * @param  None
+ * @retval None
+ */
+void SENSOR_WATCHDOG_TIM_IRQHandler(void) {
+	ISR_MONITOR_BEGIN(ISR_MONITOR_SENSOR_WATCHDOG_TIM);
+	HAL_TIM_IRQHandler(&SensorWatchdogTimHandle);
+	ISR_MONITOR_END(ISR_MONITOR_SENSOR_WATCHDOG_TIM);
+}
+
+#ifdef FCB_GPS
+/**
+ * @brief  This function handles the GPS_UART interrupt request, the idle line after a burst of messages.
+ * @param  None
+ * @retval None
+ */
+void GPS_UART_IRQHandler(void) {
+	ISR_MONITOR_BEGIN(ISR_MONITOR_GPS_UART);
+	GpsUartIRQHandler();
+	ISR_MONITOR_END(ISR_MONITOR_GPS_UART);
+}
+#endif
+
+#ifdef MOTOR_DSHOT_BIDIRECTIONAL
+/**
+ * @brief  This function handles the motor DMA interrupt request, the end of a DShot frame or of its answer samples.
+ * @param  None
+ * @retval None
+ */
+void MOTOR_DSHOT_DMA_IRQHandler(void) {
+	ISR_MONITOR_BEGIN(ISR_MONITOR_MOTOR_DMA);
+	MotorDshotDmaIRQHandler();
+	ISR_MONITOR_END(ISR_MONITOR_MOTOR_DMA);
+}
+#endif
+
+#ifdef MOTOR_ESC_TELEMETRY
+/**
+ * @brief  This function handles the ESC_TELEMETRY_UART interrupt request, a received byte of an ESC answer.
+ * @param  None
+ * @retval None
+ */
+void ESC_TELEMETRY_UART_IRQHandler(void) {
+	ISR_MONITOR_BEGIN(ISR_MONITOR_ESC_TELEMETRY_UART);
+	EscTelemetryUartIRQHandler();
+	ISR_MONITOR_END(ISR_MONITOR_ESC_TELEMETRY_UART);
+}
+#endif
+
+#ifdef FCB_SD_CARD
+/**
+ * @brief  This function handles the SD card SPI TX DMA interrupt request, the end of a sent sector
+ * @param  None
+ * @retval None
+ */
+void SD_CARD_SPI_DMA_TX_IRQHandler(void) {
+	ISR_MONITOR_BEGIN(ISR_MONITOR_SD_CARD_DMA);
+	SdCardDmaIRQHandler();
+	ISR_MONITOR_END(ISR_MONITOR_SD_CARD_DMA);
+}
+#endif
+
+#ifdef FCB_CAN_BUS
+/**
+ * @brief  This function handles the bxCAN FIFO 1 interrupt request, received frames or an overrun
+ * @param  None
+ * @retval None
+ */
+void CAN_BUS_RX_IRQHandler(void) {
+	ISR_MONITOR_BEGIN(ISR_MONITOR_CAN_RX);
+	CanBusRxIRQHandler();
+	ISR_MONITOR_END(ISR_MONITOR_CAN_RX);
+}
+
+/**
+ * @brief  This function handles the bxCAN TX interrupt request, a completed mailbox request
+ * @param  None
+ * @retval None
+ */
+void CAN_BUS_TX_IRQHandler(void) {
+	ISR_MONITOR_BEGIN(ISR_MONITOR_CAN_TX);
+	CanBusTxIRQHandler();
+	ISR_MONITOR_END(ISR_MONITOR_CAN_TX);
+}
+#endif
 
 /**
  * @brief  This function handles USB Handler.
@@ -202,7 +376,9 @@ void USB_LP_CAN_RX0_IRQHandler(void)
 void USB_LP_IRQHandler(void)
 #endif
 {
+	ISR_MONITOR_BEGIN(ISR_MONITOR_USB);
 	HAL_PCD_IRQHandler(&hpcd);
+	ISR_MONITOR_END(ISR_MONITOR_USB);
 }
 
 /**
@@ -225,24 +401,53 @@ void USBWakeUp_RMP_IRQHandler(void)
  * @retval None
  */
 void EXTI0_IRQHandler(void) {
+	ISR_MONITOR_BEGIN(ISR_MONITOR_USER_BUTTON);
 	HAL_GPIO_EXTI_IRQHandler(USER_BUTTON_PIN);
+	ISR_MONITOR_END(ISR_MONITOR_USER_BUTTON);
 }
 
 void EXTI1_IRQHandler(void) {
   /* gyroscope data ready */
+	ISR_MONITOR_BEGIN(ISR_MONITOR_GYRO_DRDY);
+	TRACE_ISR_BEGIN(TRACE_ISR_GYRO_DRDY);
+	SCOPE_PROBE_BEGIN(SCOPE_PROBE_STAGE_DRDY);
 	HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_1);
+	SCOPE_PROBE_END(SCOPE_PROBE_STAGE_DRDY);
+	TRACE_ISR_END();
+	ISR_MONITOR_END(ISR_MONITOR_GYRO_DRDY);
 }
 
+#ifdef FCB_EXTERNAL_IMU
+void EXTI15_10_IRQHandler(void) {
+  /* external IMU data ready */
+	ISR_MONITOR_BEGIN(ISR_MONITOR_GYRO_DRDY);
+	TRACE_ISR_BEGIN(TRACE_ISR_GYRO_DRDY);
+	SCOPE_PROBE_BEGIN(SCOPE_PROBE_STAGE_DRDY);
+	HAL_GPIO_EXTI_IRQHandler(GPIO_EXTERNAL_IMU_DRDY);
+	SCOPE_PROBE_END(SCOPE_PROBE_STAGE_DRDY);
+	TRACE_ISR_END();
+	ISR_MONITOR_END(ISR_MONITOR_GYRO_DRDY);
+}
+#endif
+
 void EXTI4_IRQHandler(void)
 {
   /* accelerometer data ready */
+  ISR_MONITOR_BEGIN(ISR_MONITOR_ACC_DRDY);
+  TRACE_ISR_BEGIN(TRACE_ISR_ACC_DRDY);
   HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_4);
+  TRACE_ISR_END();
+  ISR_MONITOR_END(ISR_MONITOR_ACC_DRDY);
 }
 
 void EXTI2_TS_IRQHandler(void)
 {
   /* magnetometer data ready */
+  ISR_MONITOR_BEGIN(ISR_MONITOR_MAG_DRDY);
+  TRACE_ISR_BEGIN(TRACE_ISR_MAG_DRDY);
   HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_2);
+  TRACE_ISR_END();
+  ISR_MONITOR_END(ISR_MONITOR_MAG_DRDY);
 }
 
 /**
@@ -254,7 +459,25 @@ void EXTI2_TS_IRQHandler(void)
   */
 void UART_DMA_RX_IRQHandler(void)
 {
-  HAL_DMA_IRQHandler(UartHandle.hdmarx);
+  ISR_MONITOR_BEGIN(ISR_MONITOR_UART_DMA_RX);
+  UartDmaRxIRQHandler();
+  ISR_MONITOR_END(ISR_MONITOR_UART_DMA_RX);
+}
+
+/**
+  * @brief  This function handles UART interrupt request.
+  * @param  None
+  * @retval None
+  * @Note   This function is redefined in "uart.h", only the idle line
+  *         interrupt is enabled
+  */
+void UART_IRQHandler(void)
+{
+  ISR_MONITOR_BEGIN(ISR_MONITOR_UART);
+  TRACE_ISR_BEGIN(TRACE_ISR_UART);
+  UartIRQHandler();
+  TRACE_ISR_END();
+  ISR_MONITOR_END(ISR_MONITOR_UART);
 }
 
 /**
@@ -266,7 +489,107 @@ void UART_DMA_RX_IRQHandler(void)
   */
 void UART_DMA_TX_IRQHandler(void)
 {
-  HAL_DMA_IRQHandler(UartHandle.hdmatx);
+  ISR_MONITOR_BEGIN(ISR_MONITOR_UART_DMA_TX);
+  UartDmaTxIRQHandler();
+  ISR_MONITOR_END(ISR_MONITOR_UART_DMA_TX);
+}
+
+/**
+  * @brief  This function handles DMA interrupt request.
+  * @param  None
+  * @retval None
+  * @Note   This function is redefined in "common.h" and related to DMA channel
+  *         used for feeding the CRC peripheral
+  */
+void CRC_DMA_IRQHandler(void)
+{
+  ISR_MONITOR_BEGIN(ISR_MONITOR_CRC_DMA);
+  CRCDmaIRQHandler();
+  ISR_MONITOR_END(ISR_MONITOR_CRC_DMA);
+}
+
+/**
+  * @brief  This function handles DMA interrupt request.
+  * @param  None
+  * @retval None
+  * @Note   This function is redefined in "stm32f3_discovery.h" and related to DMA
+  *         channel used for gyroscope SPI data reception
+  */
+void DISCOVERY_SPIx_DMA_RX_IRQHandler(void)
+{
+  ISR_MONITOR_BEGIN(ISR_MONITOR_GYRO_DMA_RX);
+  GYRO_IO_DMA_RX_IRQHandler();
+  ISR_MONITOR_END(ISR_MONITOR_GYRO_DMA_RX);
+}
+
+/**
+  * @brief  This function handles DMA interrupt request.
+  * @param  None
+  * @retval None
+  * @Note   This function is redefined in "stm32f3_discovery.h" and related to DMA
+  *         channel used for gyroscope SPI data transmission
+  */
+void DISCOVERY_SPIx_DMA_TX_IRQHandler(void)
+{
+  ISR_MONITOR_BEGIN(ISR_MONITOR_GYRO_DMA_TX);
+  GYRO_IO_DMA_TX_IRQHandler();
+  ISR_MONITOR_END(ISR_MONITOR_GYRO_DMA_TX);
+}
+
+/**
+  * @brief  This function handles I2C event interrupt request.
+  * @param  None
+  * @retval None
+  * @Note   This function is redefined in "stm32f3_discovery.h" and related to
+  *         the I2C bus of the accelerometer/magnetometer
+  */
+void DISCOVERY_I2Cx_EV_IRQHandler(void)
+{
+  ISR_MONITOR_BEGIN(ISR_MONITOR_I2C_EV);
+  I2Cx_EV_IRQHandler();
+  ISR_MONITOR_END(ISR_MONITOR_I2C_EV);
+}
+
+/**
+  * @brief  This function handles I2C error interrupt request.
+  * @param  None
+  * @retval None
+  * @Note   This function is redefined in "stm32f3_discovery.h" and related to
+  *         the I2C bus of the accelerometer/magnetometer
+  */
+void DISCOVERY_I2Cx_ER_IRQHandler(void)
+{
+  ISR_MONITOR_BEGIN(ISR_MONITOR_I2C_ER);
+  I2Cx_ER_IRQHandler();
+  ISR_MONITOR_END(ISR_MONITOR_I2C_ER);
+}
+
+/**
+  * @brief  This function handles I2C event interrupt request.
+  * @param  None
+  * @retval None
+  * @Note   This function is redefined in "stm32f3_discovery.h" and related to
+  *         the I2C bus of the barometer
+  */
+void DISCOVERY_I2Cbar_EV_IRQHandler(void)
+{
+  ISR_MONITOR_BEGIN(ISR_MONITOR_I2C_BARO_EV);
+  I2Cbar_EV_IRQHandler();
+  ISR_MONITOR_END(ISR_MONITOR_I2C_BARO_EV);
+}
+
+/**
+  * @brief  This function handles I2C error interrupt request.
+  * @param  None
+  * @retval None
+  * @Note   This function is redefined in "stm32f3_discovery.h" and related to
+  *         the I2C bus of the barometer
+  */
+void DISCOVERY_I2Cbar_ER_IRQHandler(void)
+{
+  ISR_MONITOR_BEGIN(ISR_MONITOR_I2C_BARO_ER);
+  I2Cbar_ER_IRQHandler();
+  ISR_MONITOR_END(ISR_MONITOR_I2C_BARO_ER);
 }
 
 /**
@@ -0,0 +1,369 @@
+/******************************************************************************
+ * @file    system_identification.c
+ * @brief   On-board system identification by an excitation of the moment
+ *          commands, see system_identification.h
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "system_identification.h"
+
+#include "flight_control.h"
+#include "pid_control.h"
+#include "seqlock.h"
+#include "fixed_format.h"
+#include "fcb_port.h"
+
+#include <math.h>
+#include <stdio.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Excitation generator, set up by the flight control task before the excitation is enabled and then written by the
+ * contexts of the motor allocation only */
+typedef struct {
+    uint8_t axis;
+    SysIdSignalType signal;
+    float32_t amplitude;        // [Nm]
+    uint32_t samples;           // Since the excitation was enabled
+    uint32_t durationSamples;
+    uint32_t fadeSamples;
+    float32_t phase;            // Chirp phase [rad], in [0, 2*pi)
+    float32_t phaseStep;        // Chirp phase change of the next sample [rad]
+    float32_t phaseStepRatio;   // Of consecutive phase steps, the exponential sweep
+    uint16_t lfsr;              // PRBS sequence state
+    uint16_t bitSamples;        // PRBS samples per bit
+    uint16_t bitCounter;        // PRBS samples left of the current bit
+} SysIdGenerator_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+
+/* Controller of the moment commands, of which the motor allocation runs at the sample period */
+#define SYSID_RATE_CONTROLLER           PID_YAW_RATE_IDX
+
+/* x^16 + x^14 + x^13 + x^11, Galois form */
+#define SYSID_PRBS_TAPS                 0xB400u
+#define SYSID_PRBS_SEED                 0xACE1u
+
+/* Private variables ---------------------------------------------------------*/
+
+static const char* sysIdAxisNames[SYSID_AXIS_NBR] = { "roll", "pitch", "yaw" };
+static const char* sysIdSignalNames[SYSID_SIGNAL_NBR] = { "chirp", "prbs" };
+static const char* sysIdStateNames[] = { "off", "running", "done", "aborted" };
+
+/* Written by the flight control task, and by the CLI with the scheduler suspended */
+static SysIdStatusType sysIdStatus = { SYSID_OFF };
+
+/* Set by the flight control task, the contexts of the motor allocation add the excitation while it is set */
+static volatile bool isSysIdEnabled = false;
+
+/* Set by the contexts of the motor allocation once the excitation has run for its duration */
+static volatile bool isSysIdDone = false;
+
+static SysIdGenerator_TypeDef sysIdGenerator;
+
+/* Written by the contexts of the motor allocation, read by the blackbox of the flight control task. Two copies, the
+ * sequence lock publishes one while the other is written. */
+static SeqLock_TypeDef seqLockSample;
+static SysIdSampleType sysIdSamples[2];
+
+/* Private function prototypes -----------------------------------------------*/
+static bool IsStabilizedFlightMode(void);
+static FcbRetValType ValidateConfig(const SysIdConfigType* config, const float32_t samplePeriod);
+static void EnableExcitation(void);
+static RAMFUNC float32_t GenerateExcitation(SysIdGenerator_TypeDef* generator);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Starts an identification in a stabilized flight mode, the excitation is added from the next control cycle
+ * @param  config : Excitation configuration
+ * @retval FCB_OK if started, FCB_ERR if not in a stabilized flight mode or if the configuration is not valid
+ */
+FcbRetValType StartSystemIdentification(const SysIdConfigType* config) {
+    const float32_t samplePeriod = GetPIDSamplePeriod(SYSID_RATE_CONTROLLER);
+
+    if (!IsStabilizedFlightMode() || FCB_OK != ValidateConfig(config, samplePeriod)) {
+        return FCB_ERR;
+    }
+
+    /* The flight control task updates the identification, keep it out without masking interrupts */
+    FCB_SUSPEND_SCHEDULER();
+    isSysIdEnabled = false;
+    sysIdStatus.config = *config;
+    sysIdStatus.samplePeriod = samplePeriod;
+    sysIdStatus.elapsed = 0.0f;
+    EnableExcitation();
+    sysIdStatus.state = SYSID_RUNNING;
+    FCB_RESUME_SCHEDULER();
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Stops a running identification
+ * @param  None.
+ * @retval None.
+ */
+void StopSystemIdentification(void) {
+    FCB_SUSPEND_SCHEDULER();
+    isSysIdEnabled = false;
+    if (SYSID_RUNNING == sysIdStatus.state) {
+        sysIdStatus.state = SYSID_ABORTED;
+    }
+    FCB_RESUME_SCHEDULER();
+}
+
+/*
+ * @brief  Ends the identification when the excitation has run for its duration or the flight mode has left the
+ *         stabilized modes
+ * @param  None.
+ * @retval None.
+ */
+void UpdateSystemIdentification(void) {
+    bool isStabilized = IsStabilizedFlightMode();
+
+    FCB_SUSPEND_SCHEDULER();
+    if (SYSID_RUNNING == sysIdStatus.state) {
+        if (isSysIdDone) {
+            isSysIdEnabled = false;
+            sysIdStatus.state = SYSID_DONE;
+        } else if (!isStabilized) {
+            isSysIdEnabled = false;
+            sysIdStatus.state = SYSID_ABORTED;
+        }
+        sysIdStatus.elapsed = sysIdGenerator.samples*sysIdStatus.samplePeriod;
+    }
+    FCB_RESUME_SCHEDULER();
+}
+
+/*
+ * @brief  Adds the excitation to the moment command of the identified axis, and records the excitation and the moment
+ *         commands of the allocation for the blackbox
+ * @param  moments : Roll, pitch and yaw moment commands [Nm], changed in place
+ * @retval None.
+ */
+RAMFUNC void AddSystemIdentificationExcitation(float32_t moments[3]) {
+    SysIdGenerator_TypeDef* generator = &sysIdGenerator;
+    SysIdSampleType* sample;
+    float32_t excitation = 0.0f;
+    uint8_t axis = 0;
+
+    if (isSysIdEnabled && !isSysIdDone) {
+        if (generator->samples >= generator->durationSamples) {
+            isSysIdDone = true;
+        } else {
+            excitation = GenerateExcitation(generator);
+            moments[generator->axis] += excitation;
+            axis = generator->axis + 1;
+        }
+    }
+
+    sample = &sysIdSamples[SeqLockWriteBegin(&seqLockSample)];
+    sample->axis = axis;
+    sample->excitation = excitation;
+    sample->moments[0] = moments[0];
+    sample->moments[1] = moments[1];
+    sample->moments[2] = moments[2];
+    SeqLockWriteEnd(&seqLockSample);
+}
+
+/*
+ * @brief  Gets the excitation and the moment commands of the latest motor allocation
+ * @param  dstSample : Destination of the sample
+ * @retval None.
+ */
+void GetSystemIdentificationSample(SysIdSampleType* dstSample) {
+    uint32_t sequence;
+
+    do {
+        sequence = SeqLockReadBegin(&seqLockSample);
+        *dstSample = sysIdSamples[SEQLOCK_COPY(sequence)];
+    } while (SeqLockReadRetry(&seqLockSample, sequence));
+}
+
+/*
+ * @brief  Gets the identification status
+ * @param  dstStatus : Destination of the status
+ * @retval None.
+ */
+void GetSystemIdentificationStatus(SysIdStatusType* dstStatus) {
+    FCB_SUSPEND_SCHEDULER();
+    *dstStatus = sysIdStatus;
+    FCB_RESUME_SCHEDULER();
+}
+
+/*
+ * @brief  Gets the name of an axis, as the CLI takes it
+ * @param  axis : Axis
+ * @retval The name, "unknown" if the axis is not valid
+ */
+const char* GetSysIdAxisName(const SysIdAxisType axis) {
+    return (axis < SYSID_AXIS_NBR) ? sysIdAxisNames[axis] : "unknown";
+}
+
+/*
+ * @brief  Gets the name of an excitation signal, as the CLI takes it
+ * @param  signal : Excitation signal
+ * @retval The name, "unknown" if the signal is not valid
+ */
+const char* GetSysIdSignalName(const SysIdSignalType signal) {
+    return (signal < SYSID_SIGNAL_NBR) ? sysIdSignalNames[signal] : "unknown";
+}
+
+/*
+ * @brief  Prints the identification state, its configuration and progress
+ * @param  dst : Destination string
+ * @param  dstSize : Size of the destination
+ * @retval Length of the printed string
+ */
+size_t PrintSystemIdentificationStatus(char* dst, const size_t dstSize) {
+    SysIdStatusType status;
+    float32_t values[5];
+    size_t length;
+
+    GetSystemIdentificationStatus(&status);
+
+    length = (size_t) snprintf(dst, dstSize, "System identification: %s", sysIdStateNames[status.state]);
+    if (SYSID_OFF != status.state && length < dstSize) {
+        length += (size_t) snprintf(dst + length, dstSize - length, ", %s %s", GetSysIdSignalName(status.config.signal),
+                GetSysIdAxisName(status.config.axis));
+        values[0] = status.config.amplitude;
+        values[1] = status.config.fMin;
+        values[2] = status.config.fMax;
+        values[3] = status.elapsed;
+        values[4] = status.config.duration;
+        if (length < dstSize) {
+            length += FormatFixedList(dst + length, dstSize - length,
+                    ", amplitude %1.4f Nm, %1.2f to %1.2f Hz, %1.1f of %1.1f s", values, 5);
+        }
+    }
+    if (length < dstSize) {
+        length += (size_t) snprintf(dst + length, dstSize - length, "\r\n");
+    }
+
+    return (length < dstSize) ? length : dstSize - 1;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Checks that the flight mode stabilizes the UAV, so that the excitation is added on top of the control
+ * @param  None.
+ * @retval true in any of the stabilized flight modes
+ */
+static bool IsStabilizedFlightMode(void) {
+    enum FlightControlMode mode = GetFlightControlMode();
+
+    return FLIGHT_CONTROL_IDLE != mode && FLIGHT_CONTROL_RAW != mode;
+}
+
+/*
+ * @brief  Checks an excitation configuration against the limits of system_identification.h
+ * @param  config : Excitation configuration
+ * @param  samplePeriod : Of the motor allocation [s]
+ * @retval FCB_OK if valid, FCB_ERR otherwise
+ */
+static FcbRetValType ValidateConfig(const SysIdConfigType* config, const float32_t samplePeriod) {
+    const float32_t maxMoment = (SYSID_AXIS_YAW == config->axis) ? MAX_YAW_MOM : MAX_ROLLPITCH_MOM;
+
+    if (config->axis >= SYSID_AXIS_NBR || config->signal >= SYSID_SIGNAL_NBR) {
+        return FCB_ERR;
+    }
+    if (!(config->amplitude > 0.0f && config->amplitude <= SYSID_MAX_AMPLITUDE*maxMoment)) {
+        return FCB_ERR;
+    }
+    if (!(config->duration >= SYSID_MIN_DURATION && config->duration <= SYSID_MAX_DURATION)) {
+        return FCB_ERR;
+    }
+    if (!(config->fMax <= SYSID_MAX_FREQUENCY_RATIO/samplePeriod && config->fMax >= SYSID_MIN_FREQUENCY)) {
+        return FCB_ERR;
+    }
+    if (SYSID_SIGNAL_CHIRP == config->signal
+            && !(config->fMin >= SYSID_MIN_FREQUENCY && config->fMin < config->fMax)) {
+        return FCB_ERR;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Sets up the excitation generator of the configuration and enables the excitation. Called with the scheduler
+ *         suspended, while the excitation is not enabled.
+ * @param  None.
+ * @retval None.
+ */
+static void EnableExcitation(void) {
+    const SysIdConfigType* config = &sysIdStatus.config;
+    const float32_t h = sysIdStatus.samplePeriod;
+    float32_t bitSamples;
+
+    sysIdGenerator.axis = (uint8_t) config->axis;
+    sysIdGenerator.signal = config->signal;
+    sysIdGenerator.amplitude = config->amplitude;
+    sysIdGenerator.samples = 0;
+    sysIdGenerator.durationSamples = (uint32_t) (config->duration/h);
+    sysIdGenerator.fadeSamples = (uint32_t) (SYSID_FADE_TIME/h);
+
+    /* The chirp frequency rises by a constant ratio per sample, from fMin to fMax over the duration */
+    sysIdGenerator.phase = 0.0f;
+    sysIdGenerator.phaseStep = 0.0f;
+    sysIdGenerator.phaseStepRatio = 1.0f;
+    if (SYSID_SIGNAL_CHIRP == config->signal) {
+        sysIdGenerator.phaseStep = 2.0f*PI*config->fMin*h;
+        sysIdGenerator.phaseStepRatio = expf(logf(config->fMax/config->fMin)*h/config->duration);
+    }
+
+    /* The bit rate of the PRBS puts its flat spectrum up to fMax */
+    bitSamples = 1.0f/(SYSID_PRBS_BIT_RATE_FACTOR*config->fMax*h);
+    sysIdGenerator.lfsr = SYSID_PRBS_SEED;
+    sysIdGenerator.bitSamples = (bitSamples < 1.0f) ? 1 : (uint16_t) (bitSamples + 0.5f);
+    sysIdGenerator.bitCounter = 0;
+
+    isSysIdDone = false;
+    isSysIdEnabled = true;
+}
+
+/*
+ * @brief  Generates the next excitation sample, faded in and out at the start and end of the duration
+ * @param  generator : Excitation generator
+ * @retval Excitation [Nm]
+ */
+static RAMFUNC float32_t GenerateExcitation(SysIdGenerator_TypeDef* generator) {
+    const uint32_t remaining = generator->durationSamples - generator->samples;
+    float32_t excitation;
+    float32_t fade = 1.0f;
+
+    if (SYSID_SIGNAL_CHIRP == generator->signal) {
+        excitation = arm_sin_f32(generator->phase);
+        generator->phase += generator->phaseStep;
+        if (generator->phase >= 2.0f*PI) {
+            generator->phase -= 2.0f*PI;
+        }
+        generator->phaseStep *= generator->phaseStepRatio;
+    } else {
+        if (0 == generator->bitCounter) {
+            generator->lfsr = (generator->lfsr >> 1) ^ (-(generator->lfsr & 1u) & SYSID_PRBS_TAPS);
+            generator->bitCounter = generator->bitSamples;
+        }
+        generator->bitCounter--;
+        excitation = (generator->lfsr & 1u) ? 1.0f : -1.0f;
+    }
+
+    if (generator->samples < generator->fadeSamples) {
+        fade = (float32_t) generator->samples/generator->fadeSamples;
+    } else if (remaining < generator->fadeSamples) {
+        fade = (float32_t) remaining/generator->fadeSamples;
+    }
+    generator->samples++;
+
+    return fade*generator->amplitude*excitation;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
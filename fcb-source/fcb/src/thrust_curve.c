@@ -0,0 +1,443 @@
+/******************************************************************************
+ * @file    thrust_curve.c
+ * @brief   Thrust curves inverted into interpolating lookup tables, and the
+ *          motor test of their identification, see thrust_curve.h
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "thrust_curve.h"
+
+#include "flight_control.h"
+#include "fcb_battery.h"
+#include "flash.h"
+#include "fixed_format.h"
+#include "fcb_port.h"
+#include "ccm_ram.h"
+
+#include <string.h>
+#include <stdio.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* A point of the identification, scaled to BATTERY_NOMINAL_CELL_VOLTAGE */
+typedef struct {
+    float32_t output;           // In [0, 1]
+    float32_t thrust;           // [N]
+} ThrustTestPoint_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+
+/* Bisection steps of the inversion, to below one motor signal value */
+#define THRUST_CURVE_INVERSION_STEPS    17
+
+/* Private variables ---------------------------------------------------------*/
+
+static ThrustCurveType thrustCurves[MOTOR_OUTPUT_CHANNELS];
+
+/* Outputs [0, UINT16_MAX] at the evenly spaced motor signal values of the linear fit, written in idle mode only, in
+ * the CCM SRAM with FCB_CCM_RAM */
+static float32_t thrustCurveLuts[MOTOR_OUTPUT_CHANNELS][THRUST_CURVE_LUT_SIZE] CCM_RAM;
+
+/* Motor test, set by the CLI and run by the flight control task */
+static bool isThrustTestActive = false;
+static uint8_t thrustTestMotor = 0;
+static float32_t thrustTestOutput = 0.0f;
+static portTickType thrustTestStartTick = 0;
+
+static ThrustTestPoint_TypeDef thrustTestPoints[THRUST_TEST_MAX_POINTS];
+static uint8_t thrustTestPointCount = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+static bool IsValidThrustCurve(const ThrustCurveType* curve);
+static float32_t GetCurveThrust(const ThrustCurveType* curve, const float32_t output);
+static void BuildThrustCurveLut(const ThrustCurveType* curve, float32_t lut[THRUST_CURVE_LUT_SIZE]);
+static float32_t GetNominalThrustScale(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Loads the stored curves, or the defaults if there are none or any is not valid, and builds their tables
+ * @param  None.
+ * @retval None.
+ */
+void InitThrustCurves(void) {
+    ThrustCurveSettingsType settings;
+    bool useFlashCurves;
+    uint8_t motor;
+
+    CcmRamRegisterObject("thrustCurveLuts", thrustCurveLuts, sizeof(thrustCurveLuts));
+
+    useFlashCurves = (FLASH_OK == ReadThrustCurvesFromFlash(&settings));
+    for (motor = 0; motor < MOTOR_OUTPUT_CHANNELS && useFlashCurves; motor++) {
+        useFlashCurves = IsValidThrustCurve(&settings.curves[motor]);
+    }
+
+    for (motor = 0; motor < MOTOR_OUTPUT_CHANNELS; motor++) {
+        if (useFlashCurves) {
+            thrustCurves[motor] = settings.curves[motor];
+        } else {
+            thrustCurves[motor].c[0] = THRUST_CURVE_DEFAULT_C0;
+            thrustCurves[motor].c[1] = THRUST_CURVE_DEFAULT_C1;
+            thrustCurves[motor].c[2] = THRUST_CURVE_DEFAULT_C2;
+        }
+        BuildThrustCurveLut(&thrustCurves[motor], thrustCurveLuts[motor]);
+    }
+}
+
+/*
+ * @brief  Sets the curve of a motor. The table is built aside and copied in a critical section, the motors are not
+ *         allocated in idle mode.
+ * @param  motor : Motor index, 0 for motor 1
+ * @param  curve : Thrust curve, see ThrustCurveType
+ * @retval FCB_OK if set, FCB_ERR if not in idle mode or if the motor or the curve is invalid
+ */
+FcbRetValType SetThrustCurve(const uint8_t motor, const ThrustCurveType* curve) {
+    float32_t lut[THRUST_CURVE_LUT_SIZE];
+
+    if (motor >= MOTOR_OUTPUT_CHANNELS || NULL == curve || !IsValidThrustCurve(curve)
+            || FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        return FCB_ERR;
+    }
+
+    BuildThrustCurveLut(curve, lut);
+
+    FCB_ENTER_CRITICAL();
+    thrustCurves[motor] = *curve;
+    memcpy(thrustCurveLuts[motor], lut, sizeof(lut));
+    FCB_EXIT_CRITICAL();
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Gets the curve of a motor
+ * @param  motor : Motor index, 0 for motor 1
+ * @param  curve : Destination
+ * @retval FCB_OK if read, FCB_ERR if the motor is invalid
+ */
+FcbRetValType GetThrustCurve(const uint8_t motor, ThrustCurveType* curve) {
+    if (motor >= MOTOR_OUTPUT_CHANNELS || NULL == curve) {
+        return FCB_ERR;
+    }
+
+    FCB_ENTER_CRITICAL();
+    *curve = thrustCurves[motor];
+    FCB_EXIT_CRITICAL();
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Saves the curves of all motors to flash, from where they are loaded at startup
+ * @param  None.
+ * @retval FCB_OK if saved, FCB_ERR if not in idle mode or if writing the flash failed
+ */
+FcbRetValType SaveThrustCurves(void) {
+    ThrustCurveSettingsType settings;
+    uint8_t motor;
+
+    /* Copy the curves while disarmed, so that all motors are saved from the same consistent set */
+    if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        return FCB_ERR;
+    }
+
+    for (motor = 0; motor < MOTOR_OUTPUT_CHANNELS; motor++) {
+        GetThrustCurve(motor, &settings.curves[motor]);
+    }
+
+    if (FLASH_OK != WriteThrustCurvesToFlash(&settings)) {
+        return FCB_ERR;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Maps the motor signal values of the linear fit through the table of each motor, interpolating between its
+ *         two nearest points. A value of 0 stays 0, so that the motors do not start below the onset of their curves.
+ * @param  motorValues : Motor signal values [0, UINT16_MAX], mapped in place
+ * @retval None.
+ */
+RAMFUNC void LinearizeMotorThrust(int32_t motorValues[MOTOR_OUTPUT_CHANNELS]) {
+    const float32_t scale = (float32_t) (THRUST_CURVE_LUT_SIZE - 1) / UINT16_MAX;
+    float32_t position;
+    uint32_t idx;
+    uint8_t motor;
+
+    for (motor = 0; motor < MOTOR_OUTPUT_CHANNELS; motor++) {
+        const float32_t* lut = thrustCurveLuts[motor];
+
+        if (motorValues[motor] <= 0) {
+            continue;
+        }
+
+        position = (float32_t) motorValues[motor] * scale;
+        idx = (uint32_t) position;
+        if (idx >= THRUST_CURVE_LUT_SIZE - 1) {
+            motorValues[motor] = (int32_t) lut[THRUST_CURVE_LUT_SIZE - 1];
+        } else {
+            motorValues[motor] = (int32_t) (lut[idx] + (position - (float32_t) idx) * (lut[idx + 1] - lut[idx]));
+        }
+    }
+}
+
+/*
+ * @brief  Starts or changes the motor test of the identification. The points of the previous motor are dropped when
+ *         another one is tested.
+ * @param  motor : Motor index, 0 for motor 1
+ * @param  output : Output in [0, THRUST_TEST_MAX_OUTPUT]
+ * @retval FCB_OK if started, FCB_ERR if not in idle mode or if the motor or the output is invalid
+ */
+FcbRetValType StartThrustTest(const uint8_t motor, const float32_t output) {
+    if (motor >= MOTOR_OUTPUT_CHANNELS || !(output >= 0.0f && output <= THRUST_TEST_MAX_OUTPUT)
+            || FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        return FCB_ERR;
+    }
+
+    FCB_ENTER_CRITICAL();
+    if (motor != thrustTestMotor) {
+        thrustTestPointCount = 0;
+    }
+    thrustTestMotor = motor;
+    thrustTestOutput = output;
+    thrustTestStartTick = xTaskGetTickCount();
+    isThrustTestActive = true;
+    FCB_EXIT_CRITICAL();
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Stops the motor test, its points are kept for the fit
+ * @param  None.
+ * @retval None.
+ */
+void StopThrustTest(void) {
+    isThrustTestActive = false;
+}
+
+/*
+ * @brief  Outputs the test motor, the others stopped, until the test is stopped or has timed out
+ * @param  None.
+ * @retval true if a test is running, else false
+ */
+bool UpdateThrustTest(void) {
+    uint16_t ctrlVal[MOTOR_OUTPUT_CHANNELS] = { 0, 0, 0, 0 };
+    uint8_t stopMask = 0;
+
+    FCB_ENTER_CRITICAL();
+    if (isThrustTestActive && xTaskGetTickCount() - thrustTestStartTick > THRUST_TEST_TIMEOUT/portTICK_RATE_MS) {
+        isThrustTestActive = false;
+    }
+    if (isThrustTestActive) {
+        ctrlVal[thrustTestMotor] = (uint16_t) (thrustTestOutput * UINT16_MAX);
+        stopMask = (uint8_t) (MOTOR_ALL_MASK & ~(1 << thrustTestMotor));
+    }
+    FCB_EXIT_CRITICAL();
+
+    if (!isThrustTestActive) {
+        return false;
+    }
+
+    /* The raw outputs, without the curves being identified, the other motors stopped */
+    SetBenchMotors(ctrlVal, stopMask);
+
+    return true;
+}
+
+/*
+ * @brief  Records the load cell thrust at the output of the running test, scaled to the nominal voltage
+ * @param  thrust : Measured thrust [N]
+ * @retval FCB_OK if recorded, FCB_ERR if no test is running, the thrust is negative or all points are used
+ */
+FcbRetValType AddThrustTestPoint(const float32_t thrust) {
+    const float32_t nominalScale = GetNominalThrustScale();
+    FcbRetValType status = FCB_ERR;
+
+    if (!(thrust >= 0.0f)) {
+        return FCB_ERR;
+    }
+
+    FCB_ENTER_CRITICAL();
+    if (isThrustTestActive && thrustTestPointCount < THRUST_TEST_MAX_POINTS) {
+        thrustTestPoints[thrustTestPointCount].output = thrustTestOutput;
+        thrustTestPoints[thrustTestPointCount].thrust = thrust * nominalScale;
+        thrustTestPointCount++;
+        status = FCB_OK;
+    }
+    FCB_EXIT_CRITICAL();
+
+    return status;
+}
+
+/*
+ * @brief  Fits a quadratic curve to the points of the tested motor, solving the normal equations with Cramer's rule,
+ *         and sets it
+ * @param  dstCurve : Destination of the fitted curve
+ * @param  dstRmsError : Destination of the RMS thrust error of the points [N]
+ * @param  dstMotor : Destination of the motor index
+ * @retval FCB_OK if fitted and set, FCB_ERR if there are too few points, if they do not determine a curve or if the
+ *         curve is not valid
+ */
+FcbRetValType FitThrustTestCurve(ThrustCurveType* dstCurve, float32_t* dstRmsError, uint8_t* dstMotor) {
+    ThrustTestPoint_TypeDef points[THRUST_TEST_MAX_POINTS];
+    float32_t s[5] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }; // Sums of x^k
+    float32_t t[3] = { 0.0f, 0.0f, 0.0f };             // Sums of x^k*T
+    float32_t det, error, sumOfSquares = 0.0f;
+    uint8_t count, motor, i;
+
+    FCB_ENTER_CRITICAL();
+    count = thrustTestPointCount;
+    motor = thrustTestMotor;
+    memcpy(points, thrustTestPoints, sizeof(points));
+    FCB_EXIT_CRITICAL();
+
+    if (count < THRUST_TEST_MIN_POINTS) {
+        return FCB_ERR;
+    }
+
+    for (i = 0; i < count; i++) {
+        const float32_t x = points[i].output;
+
+        s[0] += 1.0f;
+        s[1] += x;
+        s[2] += x*x;
+        s[3] += x*x*x;
+        s[4] += x*x*x*x;
+        t[0] += points[i].thrust;
+        t[1] += x*points[i].thrust;
+        t[2] += x*x*points[i].thrust;
+    }
+
+    /* Normal equations [s0 s1 s2; s1 s2 s3; s2 s3 s4] * c = t, at least three distinct outputs make them regular */
+    det = s[0]*(s[2]*s[4] - s[3]*s[3]) - s[1]*(s[1]*s[4] - s[3]*s[2]) + s[2]*(s[1]*s[3] - s[2]*s[2]);
+    if (!(fabsf(det) > 1e-9f)) {
+        return FCB_ERR;
+    }
+    dstCurve->c[0] = (t[0]*(s[2]*s[4] - s[3]*s[3]) - s[1]*(t[1]*s[4] - s[3]*t[2]) + s[2]*(t[1]*s[3] - s[2]*t[2])) / det;
+    dstCurve->c[1] = (s[0]*(t[1]*s[4] - s[3]*t[2]) - t[0]*(s[1]*s[4] - s[3]*s[2]) + s[2]*(s[1]*t[2] - t[1]*s[2])) / det;
+    dstCurve->c[2] = (s[0]*(s[2]*t[2] - t[1]*s[3]) - s[1]*(s[1]*t[2] - t[1]*s[2]) + t[0]*(s[1]*s[3] - s[2]*s[2])) / det;
+
+    for (i = 0; i < count; i++) {
+        error = GetCurveThrust(dstCurve, points[i].output) - points[i].thrust;
+        sumOfSquares += error*error;
+    }
+    *dstRmsError = sqrtf(sumOfSquares / (float32_t) count);
+    *dstMotor = motor;
+
+    return SetThrustCurve(motor, dstCurve);
+}
+
+size_t PrintThrustCurves(char* dst, const size_t dstSize) {
+    ThrustCurveType curve;
+    float32_t values[4];
+    size_t length;
+    uint8_t motor;
+
+    length = (size_t) snprintf(dst, dstSize, "\nThrust curves [N], T = c0 + c1*x + c2*x^2\nmotor\tc0\t\tc1\t\tc2\t\tfull\n");
+    for (motor = 0; motor < MOTOR_OUTPUT_CHANNELS && length < dstSize; motor++) {
+        GetThrustCurve(motor, &curve);
+        length += (size_t) snprintf(dst + length, dstSize - length, "%u\t", motor + 1);
+        values[0] = curve.c[0];
+        values[1] = curve.c[1];
+        values[2] = curve.c[2];
+        values[3] = GetCurveThrust(&curve, 1.0f);
+        if (length < dstSize) {
+            length += FormatFixedList(dst + length, dstSize - length, "%1.4f\t\t%1.4f\t\t%1.4f\t\t%1.3f\n", values, 4);
+        }
+    }
+
+    values[0] = AIRFRAME_MOTOR_MAX_THRUST;
+    if (length < dstSize) {
+        length += FormatFixedList(dst + length, dstSize - length, "Full thrust of the linear fit: %1.3f N\n", values, 1);
+    }
+    if (length < dstSize) {
+        length += (size_t) snprintf(dst + length, dstSize - length, "Test points of motor %u: %u\n",
+                thrustTestMotor + 1, thrustTestPointCount);
+    }
+
+    return length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Checks that a curve is finite and rises over the whole output range. The slope is linear in the output, so
+ *         it is positive everywhere if it is at both ends.
+ * @param  curve : Curve
+ * @retval true if valid, else false
+ */
+static bool IsValidThrustCurve(const ThrustCurveType* curve) {
+    return curve->c[1] > 0.0f && curve->c[1] + 2.0f*curve->c[2] > 0.0f && GetCurveThrust(curve, 1.0f) > 0.0f
+            && fabsf(curve->c[0]) < AIRFRAME_MOTOR_MAX_THRUST && fabsf(curve->c[2]) < 4.0f*AIRFRAME_MOTOR_MAX_THRUST;
+}
+
+/*
+ * @brief  Evaluates a curve
+ * @param  curve : Curve
+ * @param  output : Output in [0, 1]
+ * @retval Thrust [N]
+ */
+static float32_t GetCurveThrust(const ThrustCurveType* curve, const float32_t output) {
+    return curve->c[0] + (curve->c[1] + curve->c[2]*output)*output;
+}
+
+/*
+ * @brief  Inverts a curve at THRUST_CURVE_LUT_SIZE evenly spaced motor signal values of the linear fit, by bisection
+ *         since the curve rises. A thrust beyond that of full output gives full output.
+ * @param  curve : Curve, valid
+ * @param  lut : Destination table of outputs [0, UINT16_MAX]
+ * @retval None.
+ */
+static void BuildThrustCurveLut(const ThrustCurveType* curve, float32_t lut[THRUST_CURVE_LUT_SIZE]) {
+    float32_t thrust, low, high, mid;
+    uint8_t i, step;
+
+    for (i = 0; i < THRUST_CURVE_LUT_SIZE; i++) {
+        thrust = AT * (float32_t) i / (THRUST_CURVE_LUT_SIZE - 1) * UINT16_MAX + BT;
+        low = 0.0f;
+        high = 1.0f;
+        if (thrust >= GetCurveThrust(curve, 1.0f)) {
+            low = 1.0f;
+        }
+        for (step = 0; step < THRUST_CURVE_INVERSION_STEPS && low < high; step++) {
+            mid = 0.5f*(low + high);
+            if (GetCurveThrust(curve, mid) < thrust) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+        lut[i] = low * UINT16_MAX;
+    }
+}
+
+/*
+ * @brief  Gets the factor from the thrust at the current pack voltage to the thrust at the nominal one, see
+ *         GetBatteryThrustCompensation()
+ * @param  None.
+ * @retval Factor, 1 without a battery monitor or a connected battery
+ */
+static float32_t GetNominalThrustScale(void) {
+#ifdef FCB_BATTERY_MONITOR
+    FcbBatteryStateType battery;
+    float32_t ratio;
+
+    GetBatteryState(&battery);
+    if (battery.cells > 0 && battery.voltage > 0.0f) {
+        ratio = BATTERY_NOMINAL_CELL_VOLTAGE * (float32_t) battery.cells / battery.voltage;
+        return ratio*ratio;
+    }
+#endif
+
+    return 1.0f;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,395 @@
+/******************************************************************************
+ * @file    wcet_test.c
+ * @author  Dragonfly
+ * @brief   Worst-case execution time test. The WCET task applies the loads
+ *          that are not driven by the flight control itself, the CLI commands,
+ *          the telemetry streams and the queued flash writes, and checks the
+ *          measured maxima against the budgets when the test ends. The flight
+ *          control, the motor output, the magnetometer driver and the flash
+ *          writer apply the rest while WCET_TEST_IS_ACTIVE().
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "wcet_test.h"
+
+#ifdef FCB_WCET_TEST
+
+#include "wcet_budget.h"
+#include "flight_control.h"
+#include "flash.h"
+#include "telemetry.h"
+#include "com_cli.h"
+#include "profiler.h"
+#include "deadline_monitor.h"
+#include "latency_monitor.h"
+#include "fcb_error.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Where the maximum of a checked stage comes from */
+typedef enum {
+    WCET_SOURCE_PROFILE = 0,        // Profiling probe, ProfileProbe_TypeDef
+    WCET_SOURCE_LOOP_TIME,          // Control loop execution time, DeadlineLoop_TypeDef
+    WCET_SOURCE_LOOP_JITTER,        // Control loop period jitter, DeadlineLoop_TypeDef
+    WCET_SOURCE_LATENCY             // Gyroscope data ready to motor output latency
+} WcetSource_TypeDef;
+
+typedef struct {
+    const char* name;
+    WcetSource_TypeDef source;
+    uint8_t index;                  // Probe or loop of the source
+    uint32_t budget;                // [us], 0 if not checked
+} WcetBudget_TypeDef;
+
+typedef struct {
+    bool isMeasured;                // False if the stage did not run in this build or test
+    uint32_t max;                   // [us]
+} WcetMeasurement_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define WCET_TEST_TASK_PRIO             1 // That of the low deferred worker, which runs the CLI commands
+#define WCET_TEST_TASK_STACK_DEPTH      (3*configMINIMAL_STACK_SIZE) // As the low deferred worker
+
+#define WCET_BUDGET_NBR                 (sizeof(wcetBudgets)/sizeof(wcetBudgets[0]))
+#define WCET_CLI_COMMAND_NBR            (sizeof(wcetCliCommands)/sizeof(wcetCliCommands[0]))
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+static const WcetBudget_TypeDef wcetBudgets[] = {
+    { "prediction", WCET_SOURCE_PROFILE, PROFILE_PROBE_PREDICTION, WCET_BUDGET_PREDICTION },
+    { "correction", WCET_SOURCE_PROFILE, PROFILE_PROBE_CORRECTION, WCET_BUDGET_CORRECTION },
+    { "pid", WCET_SOURCE_PROFILE, PROFILE_PROBE_PID, WCET_BUDGET_PID },
+    { "motor_allocation", WCET_SOURCE_PROFILE, PROFILE_PROBE_MOTOR_ALLOCATION, WCET_BUDGET_MOTOR_ALLOCATION },
+    { "gyro_fetch", WCET_SOURCE_PROFILE, PROFILE_PROBE_GYRO_FETCH, WCET_BUDGET_GYRO_FETCH },
+    { "gyro_drdy_isr", WCET_SOURCE_PROFILE, PROFILE_PROBE_GYRO_DRDY_ISR, WCET_BUDGET_GYRO_DRDY_ISR },
+    { "gyro_dma_isr", WCET_SOURCE_PROFILE, PROFILE_PROBE_GYRO_DMA_ISR, WCET_BUDGET_GYRO_DMA_ISR },
+    { "ref_signals", WCET_SOURCE_PROFILE, PROFILE_PROBE_REF_SIGNALS, WCET_BUDGET_REF_SIGNALS },
+    { "baro_fetch", WCET_SOURCE_PROFILE, PROFILE_PROBE_BARO_FETCH, WCET_BUDGET_BARO_FETCH },
+    { "inner_loop", WCET_SOURCE_LOOP_TIME, DEADLINE_LOOP_INNER, WCET_BUDGET_INNER_LOOP },
+    { "outer_loop", WCET_SOURCE_LOOP_TIME, DEADLINE_LOOP_OUTER, WCET_BUDGET_OUTER_LOOP },
+    { "estimator_loop", WCET_SOURCE_LOOP_TIME, DEADLINE_LOOP_ESTIMATOR, WCET_BUDGET_ESTIMATOR_LOOP },
+    { "inner_loop_jitter", WCET_SOURCE_LOOP_JITTER, DEADLINE_LOOP_INNER, WCET_BUDGET_INNER_LOOP_JITTER },
+    { "outer_loop_jitter", WCET_SOURCE_LOOP_JITTER, DEADLINE_LOOP_OUTER, WCET_BUDGET_OUTER_LOOP_JITTER },
+    { "estimator_loop_jitter", WCET_SOURCE_LOOP_JITTER, DEADLINE_LOOP_ESTIMATOR, WCET_BUDGET_ESTIMATOR_LOOP_JITTER },
+    { "gyro_to_motor", WCET_SOURCE_LATENCY, 0, WCET_BUDGET_GYRO_TO_MOTOR },
+};
+
+/* Read-only commands that format their output, run in turn, the output is dropped */
+static const char* const wcetCliCommands[] = {
+    "get-states",
+    "get-sensors",
+    "get-motors",
+    "get-deadline-stats",
+};
+
+static const char* const wcetResultNames[] = { "NOT RUN", "RUNNING", "PASSED", "FAILED", "ABORTED" };
+
+static xTaskHandle WcetTestTaskHandle = NULL;
+static xSemaphoreHandle wcetTestStartSem = NULL;
+
+static volatile bool isWcetTestActive = false;
+static volatile bool isWcetTestStopRequested = false;
+static volatile WcetTestResult_TypeDef wcetTestResult = WCET_TEST_NOT_RUN;
+
+/* Written by the starting task before the test task is woken, and by the test task while the result is running */
+static uint32_t wcetTestDuration;       // [ms]
+static volatile uint32_t wcetTestElapsed; // [ms]
+static volatile uint32_t wcetTestCliRuns;
+static volatile uint32_t wcetTestFlashWrites;
+
+/* Written by the test task before the result is set, read after */
+static WcetMeasurement_TypeDef wcetMeasurements[WCET_BUDGET_NBR];
+
+/* Used by the test task only */
+static ProfileSnapshot_TypeDef wcetProfileSnapshot;
+static DeadlineLoopStats_TypeDef wcetLoopStats[DEADLINE_LOOP_NBR];
+static LatencyStats_TypeDef wcetLatencyStats;
+static uint8_t wcetCliIn[MAX_CLI_COMMAND_SIZE];
+static uint8_t wcetCliOut[MAX_CLI_OUTPUT_SIZE];
+
+/* Private function prototypes -----------------------------------------------*/
+static void WcetTestTask(void const *argument);
+static void RunWcetTestCliCommand(void);
+static void QueueWcetTestFlashWrite(void);
+static void EvaluateWcetTest(const bool isComplete);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Creates the WCET test task, which is idle until a test is started
+ * @param  None
+ * @retval None
+ */
+void CreateWcetTestTask(void) {
+    vSemaphoreCreateBinary(wcetTestStartSem);
+    if (NULL == wcetTestStartSem) {
+        ErrorHandler();
+        return;
+    }
+    xSemaphoreTake(wcetTestStartSem, 0);
+
+    /* WCET test task creation
+     * Task function pointer: WcetTestTask
+     * Task name: WCET_TEST
+     * Stack depth: WCET_TEST_TASK_STACK_DEPTH
+     * Parameter: NULL
+     * Priority: WCET_TEST_TASK_PRIO (0 to configMAX_PRIORITIES-1 possible)
+     * Handle: WcetTestTaskHandle
+     * */
+    if (pdPASS != xTaskCreate((pdTASK_CODE )WcetTestTask, (signed portCHAR*)"WCET_TEST",
+            WCET_TEST_TASK_STACK_DEPTH, NULL, WCET_TEST_TASK_PRIO, &WcetTestTaskHandle)) {
+        ErrorHandler();
+    }
+}
+
+/*
+ * @brief  Starts a WCET test, the results of the previous one are cleared. The profiling, deadline and latency
+ *         statistics are cleared when it starts, and all telemetry is stopped when it ends.
+ * @param  duration : [ms] at most WCET_TEST_MAX_DURATION
+ * @retval FCB_OK if started, FCB_ERR if a test is running, the flight control is not in idle mode or the duration is
+ *         out of range
+ */
+FcbRetValType WcetTestStart(const uint32_t duration) {
+    if (NULL == wcetTestStartSem || 0 == duration || duration > WCET_TEST_MAX_DURATION) {
+        return FCB_ERR;
+    }
+
+    /* The mode check and the start are one step for the tasks, the flight control cannot arm in between */
+    taskENTER_CRITICAL();
+    if (WCET_TEST_RUNNING == wcetTestResult || FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        taskEXIT_CRITICAL();
+        return FCB_ERR;
+    }
+    wcetTestDuration = duration;
+    wcetTestElapsed = 0;
+    isWcetTestStopRequested = false;
+    wcetTestResult = WCET_TEST_RUNNING;
+    taskEXIT_CRITICAL();
+
+    xSemaphoreGive(wcetTestStartSem);
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Aborts the running WCET test, if any. The load is removed within a tick.
+ * @param  None
+ * @retval None
+ */
+void WcetTestStop(void) {
+    isWcetTestStopRequested = true;
+}
+
+/*
+ * @brief  Checks if the worst-case load is applied and the motor outputs are interlocked
+ * @param  None
+ * @retval true if active
+ */
+bool WcetTestIsActive(void) {
+    return isWcetTestActive;
+}
+
+/*
+ * @brief  Gets the result of the running or the last WCET test
+ * @param  None
+ * @retval The result
+ */
+WcetTestResult_TypeDef GetWcetTestResult(void) {
+    return wcetTestResult;
+}
+
+/*
+ * @brief  Prints the result of the running or the last WCET test, with the measured maxima and their budgets once it
+ *         has ended
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @retval Length of the report string
+ */
+size_t WcetTestPrint(char* dst, const size_t dstSize) {
+    const WcetTestResult_TypeDef result = wcetTestResult;
+    size_t length;
+    uint8_t i;
+
+    length = snprintf(dst, dstSize, "WCET test: %s, %lu of %lu ms, %lu CLI commands, %lu flash writes queued\r\n",
+            wcetResultNames[result], (unsigned long) wcetTestElapsed, (unsigned long) wcetTestDuration,
+            (unsigned long) wcetTestCliRuns, (unsigned long) wcetTestFlashWrites);
+
+    if (WCET_TEST_NOT_RUN == result || WCET_TEST_RUNNING == result) {
+        return length;
+    }
+
+    if (length < dstSize) {
+        length += snprintf(dst + length, dstSize - length, "%-22s %9s %12s\r\n", "stage", "max [us]", "budget [us]");
+    }
+    for (i = 0; i < WCET_BUDGET_NBR && length < dstSize; i++) {
+        if (!wcetMeasurements[i].isMeasured) {
+            length += snprintf(dst + length, dstSize - length, "%-22s %9s %12lu  n/a\r\n", wcetBudgets[i].name, "-",
+                    (unsigned long) wcetBudgets[i].budget);
+        } else {
+            length += snprintf(dst + length, dstSize - length, "%-22s %9lu %12lu  %s\r\n", wcetBudgets[i].name,
+                    (unsigned long) wcetMeasurements[i].max, (unsigned long) wcetBudgets[i].budget,
+                    (0 == wcetBudgets[i].budget) ? "-" :
+                            ((wcetMeasurements[i].max > wcetBudgets[i].budget) ? "FAIL" : "ok"));
+        }
+    }
+
+    return length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Task code of the WCET test, applies the load of a started test each tick until it ends
+ * @param  argument : Unused parameter
+ * @retval None
+ */
+static void WcetTestTask(void const *argument) {
+    portTickType startTick;
+    uint32_t elapsed, lastFlashWrite;
+
+    (void) argument;
+
+    while (1) {
+        xSemaphoreTake(wcetTestStartSem, portMAX_DELAY);
+
+        /* The maxima of the test only */
+        ProfileReset();
+        DeadlineMonitorReset();
+        LatencyMonitorReset();
+        wcetTestCliRuns = 0;
+        wcetTestFlashWrites = 0;
+
+        StartAllTelemetry((wcetTestDuration + 999) / 1000);
+
+        startTick = xTaskGetTickCount();
+        elapsed = 0;
+        lastFlashWrite = 0;
+        isWcetTestActive = true;
+
+        while (!isWcetTestStopRequested && FLIGHT_CONTROL_IDLE == GetFlightControlMode()
+                && elapsed < wcetTestDuration) {
+            RunWcetTestCliCommand();
+
+            if (elapsed - lastFlashWrite >= WCET_TEST_FLASH_WRITE_PERIOD) {
+                QueueWcetTestFlashWrite();
+                lastFlashWrite = elapsed;
+            }
+
+            vTaskDelay(1);
+            elapsed = (xTaskGetTickCount() - startTick) * portTICK_RATE_MS;
+            wcetTestElapsed = elapsed;
+        }
+
+        isWcetTestActive = false;
+        StopAllTelemetry();
+
+        EvaluateWcetTest(elapsed >= wcetTestDuration);
+    }
+}
+
+/*
+ * @brief  Runs the next of the CLI commands, as a com port session does
+ * @param  None
+ * @retval None
+ */
+static void RunWcetTestCliCommand(void) {
+    static uint8_t commandIdx = 0;
+    uint16_t dataLength;
+
+    strncpy((char*) wcetCliIn, wcetCliCommands[commandIdx], sizeof(wcetCliIn) - 1);
+    commandIdx = (commandIdx + 1) % WCET_CLI_COMMAND_NBR;
+
+    /* No session is active, the output the commands send on their own is dropped */
+    TakeCLIMutex();
+    while (pdFALSE != CLIParser(wcetCliIn, wcetCliOut, &dataLength)) {
+    }
+    GiveCLIMutex();
+
+    wcetTestCliRuns++;
+}
+
+/*
+ * @brief  Queues the stored reference limits to the flash writer again. The writer holds the record until the test
+ *         ends, so the record of each write replaces the queued one of the previous and a single one is programmed.
+ * @param  None
+ * @retval None
+ */
+static void QueueWcetTestFlashWrite(void) {
+    RefSignals_TypeDef referenceMaxLimits;
+
+    if (FLASH_OK == ReadReferenceMaxLimitsFromFlash(&referenceMaxLimits)
+            && FLASH_OK == WriteReferenceMaxLimitsToFlash(&referenceMaxLimits)) {
+        wcetTestFlashWrites++;
+    }
+}
+
+/*
+ * @brief  Collects the maxima of the test and checks them against their budgets
+ * @param  isComplete : The test ran for its duration
+ * @retval None
+ */
+static void EvaluateWcetTest(const bool isComplete) {
+    const uint32_t cyclesPerUs = SystemCoreClock / 1000000;
+    const WcetBudget_TypeDef* budget;
+    bool isWithinBudget = true;
+    uint32_t cycles;
+    uint8_t i;
+
+    ProfileGetSnapshot(&wcetProfileSnapshot, false);
+    DeadlineMonitorGetStats(wcetLoopStats);
+    LatencyMonitorGetStats(&wcetLatencyStats);
+
+    for (i = 0; i < WCET_BUDGET_NBR; i++) {
+        budget = &wcetBudgets[i];
+        switch (budget->source) {
+        case WCET_SOURCE_PROFILE:
+            wcetMeasurements[i].isMeasured = wcetProfileSnapshot.probe[budget->index].count > 0;
+            cycles = wcetProfileSnapshot.probe[budget->index].max;
+            break;
+        case WCET_SOURCE_LOOP_TIME:
+            wcetMeasurements[i].isMeasured = wcetLoopStats[budget->index].executions > 0;
+            cycles = wcetLoopStats[budget->index].wcet;
+            break;
+        case WCET_SOURCE_LOOP_JITTER:
+            wcetMeasurements[i].isMeasured = wcetLoopStats[budget->index].expectedPeriod > 0
+                    && wcetLoopStats[budget->index].periods > 0;
+            cycles = wcetLoopStats[budget->index].maxJitter;
+            break;
+        case WCET_SOURCE_LATENCY:
+        default:
+            wcetMeasurements[i].isMeasured = wcetLatencyStats.count > 0;
+            cycles = wcetLatencyStats.total.max;
+            break;
+        }
+        wcetMeasurements[i].max = (cycles + cyclesPerUs - 1) / cyclesPerUs;
+
+        if (wcetMeasurements[i].isMeasured && 0 != budget->budget && wcetMeasurements[i].max > budget->budget) {
+            isWithinBudget = false;
+        }
+    }
+
+    if (!isComplete) {
+        wcetTestResult = WCET_TEST_ABORTED;
+    } else {
+        wcetTestResult = isWithinBudget ? WCET_TEST_PASSED : WCET_TEST_FAILED;
+    }
+}
+
+#endif /* FCB_WCET_TEST */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,236 @@
+/******************************************************************************
+ * @file    fuzz_com.c
+ * @author  Dragonfly
+ * @brief   Fuzz harness of the host build over the receive path of the UART
+ *          transport: the FMS link frames, and behind them in the session the
+ *          binary RPC requests, the MAVLink frames and the CLI lines with all
+ *          the commands RegisterCLICommands() registers. The received data is
+ *          handled as HandleUartRxSpan() and HandleUartRxWork() of uart.c do,
+ *          in spans with a time gap between them, so that the RX timeouts of
+ *          the parsers are reached. The modules the commands and the handlers
+ *          call into are those of fuzz_port.c. The checksums of the frames
+ *          also match when zero, see COM_CHECKSUM_MATCH() of communication.h.
+ *
+ *          An input is:
+ *
+ *            byte 0      span size - 1 [bytes]
+ *            byte 1      gap before each span [ms]
+ *            bytes 2..   the received data
+ *
+ *          The harness is built for libFuzzer, or as a program that runs the
+ *          files given, or stdin, once each, for AFL and for reproducing a
+ *          finding, see host/Makefile:
+ *
+ *            build/fuzz_com corpus/      libFuzzer
+ *            build/fuzz_com crash-file   the program
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "fuzz_port.h"
+#include "host_port.h"
+
+#include "com_session.h"
+#include "com_cli.h"
+#include "com_mavlink.h"
+#include "fms_link.h"
+#include "param_table.h"
+#include "pid_control.h"
+#include "state_estimation.h"
+#include "mag_heading.h"
+#include "motor_mixer.h"
+#include "fcb_error.h"
+#include "ring_buffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+/* Private define ------------------------------------------------------------*/
+#define FUZZ_RX_BUFFER_SIZE         512 // As UART_RX_BUFFER_SIZE of uart.c [bytes]
+#define FUZZ_HEADER_SIZE            2 // Span size and gap [bytes]
+#define FUZZ_INPUT_GAP              1000 // Between the inputs, longer than the RX timeouts [ms]
+#define FUZZ_MAX_FILE_SIZE          65536 // Largest input the program reads [bytes]
+
+/* Private variables ---------------------------------------------------------*/
+static bool isInitialized = false;
+
+static uint8_t rxBufferArray[FUZZ_RX_BUFFER_SIZE];
+static RingBuffer_TypeDef rxRingBuffer;
+static ComSession_TypeDef session;
+
+/* Private function prototypes -----------------------------------------------*/
+static void InitHarness(void);
+static void HandleRxSpan(const uint8_t* data, const uint16_t dataSize);
+static FcbRetValType FuzzSend(const uint8_t* data, const uint16_t size);
+#ifndef FUZZ_COM_LIBFUZZER
+static int RunFile(FILE* file, const char* name);
+#endif
+
+/* Exported functions --------------------------------------------------------*/
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+/*
+ * @brief  Handles an input as received data, see the file header for its format
+ * @param  data : Input
+ * @param  size : Size of the input [bytes]
+ * @retval 0, as libFuzzer expects
+ */
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    uint16_t spanSize;
+    uint8_t gap;
+    size_t offset;
+
+    if (!isInitialized) {
+        InitHarness();
+        isInitialized = true;
+    }
+
+    if (size < FUZZ_HEADER_SIZE) {
+        return 0;
+    }
+
+    spanSize = data[0] + 1;
+    gap = data[1];
+
+    for (offset = FUZZ_HEADER_SIZE; offset < size; offset += spanSize) {
+        if (spanSize > size - offset) {
+            spanSize = size - offset;
+        }
+
+        FuzzPortAdvanceTime(gap);
+        HandleRxSpan(&data[offset], spanSize);
+    }
+
+    /* Partial frames of this input time out, a partial CLI line is dropped as if the line was reset */
+    FuzzPortAdvanceTime(FUZZ_INPUT_GAP);
+    session.cliInLength = 0;
+
+    return 0;
+}
+
+#ifndef FUZZ_COM_LIBFUZZER
+int main(int argc, char* argv[]) {
+    FILE* file;
+    int i;
+
+    if (argc < 2) {
+        return RunFile(stdin, "stdin");
+    }
+
+    for (i = 1; i < argc; i++) {
+        file = fopen(argv[i], "rb");
+        if (file == NULL) {
+            perror(argv[i]);
+            return 2;
+        }
+
+        RunFile(file, argv[i]);
+        fclose(file);
+    }
+
+    return 0;
+}
+#endif
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Initializes the modules the receive path uses, in the order of main.c, and the session
+ * @param  None
+ * @retval None
+ */
+static void InitHarness(void) {
+    HostPortReset();
+    RegisterCLICommands();
+    InitPIDControllers();
+    InitEstimatorNoise();
+    InitMagHeading();
+    MotorMixerInit();
+    InitParamTable();
+    InitMavlink();
+    CreateCLISemaphores();
+
+    if (SUCCESS != RingBufferInit(&rxRingBuffer, rxBufferArray, sizeof(rxBufferArray))) {
+        ErrorHandler();
+    }
+
+    ComSessionInit(&session, &rxRingBuffer, FuzzSend);
+}
+
+/*
+ * @brief  Handles a span of received data as the UART RX interrupt and the RX work item do
+ * @param  data : Received bytes
+ * @param  dataSize : Number of bytes
+ * @retval None
+ */
+static void HandleRxSpan(const uint8_t* data, const uint16_t dataSize) {
+    uint16_t runStart = 0;
+    uint16_t i;
+
+    for (i = 0; i < dataSize; i++) {
+        if (FmsLinkHandleRxByte(data[i])) {
+            if (i > runStart) {
+                RingBufferPutData(&rxRingBuffer, &data[runStart], i - runStart);
+            }
+            runStart = i + 1;
+        }
+    }
+
+    if (dataSize > runStart) {
+        RingBufferPutData(&rxRingBuffer, &data[runStart], dataSize - runStart);
+    }
+
+    ComSessionHandleRxData(&session);
+}
+
+/*
+ * @brief  Sends session output, reads it all so that the sanitizers check the buffer of the sender
+ * @param  data : Reference to the data to be sent
+ * @param  size : Size of data to be sent
+ * @retval FCB_OK
+ */
+static FcbRetValType FuzzSend(const uint8_t* data, const uint16_t size) {
+    volatile uint8_t sink;
+    uint16_t i;
+
+    for (i = 0; i < size; i++) {
+        sink = data[i];
+    }
+    (void) sink;
+
+    return FCB_OK;
+}
+
+#ifndef FUZZ_COM_LIBFUZZER
+/*
+ * @brief  Runs the contents of a file as one input
+ * @param  file : File to read
+ * @param  name : Name of the file, for the messages
+ * @retval 0 if the input was run, else 2
+ */
+static int RunFile(FILE* file, const char* name) {
+    static uint8_t input[FUZZ_MAX_FILE_SIZE];
+    size_t size;
+
+    size = fread(input, 1, sizeof(input), file);
+    if (ferror(file)) {
+        perror(name);
+        return 2;
+    }
+
+    LLVMFuzzerTestOneInput(input, size);
+
+    return 0;
+}
+#endif
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
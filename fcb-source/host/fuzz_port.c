@@ -0,0 +1,992 @@
+/******************************************************************************
+ * @file    fuzz_port.c
+ * @author  Dragonfly
+ * @brief   The fuzz port, the kernel and the target modules the communication
+ *          modules call into, with the host port of host_port.c. The tick is
+ *          moved on by the harness only. The modules answer as a flight
+ *          controller on the bench: the setters take their values, the
+ *          getters return zeroed states, and the print functions fill the
+ *          whole destination as a truncated print does, so that the sanitizers
+ *          check the size the caller passes.
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "fuzz_port.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+
+#include "telemetry.h"
+#include "telemetry_aggregate.h"
+#include "uart.h"
+#include "usbd_log_if.h"
+#include "blackbox.h"
+#include "flight_control.h"
+#include "flight_mode.h"
+#include "motor_control.h"
+#include "motor_test.h"
+#include "param_profile.h"
+#include "prearm_checks.h"
+#include "rc_smoothing.h"
+#include "receiver.h"
+#include "stick_curves.h"
+#include "thrust_curve.h"
+#include "fcb_accelerometer_magnetometer.h"
+#include "fcb_barometer.h"
+#include "fcb_gyroscope.h"
+#include "fcb_sensor_filter.h"
+#include "fcb_sensor_orientation.h"
+#include "fcb_sensor_self_test.h"
+#include "fcb_sensor_timing.h"
+#include "fcb_sensor_watchdog.h"
+#include "fcb_sensors.h"
+#include "fcb_vibration_monitor.h"
+#include "boot_timing.h"
+#include "ccm_ram.h"
+#include "common.h"
+#include "crash_dump.h"
+#include "deadline_monitor.h"
+#include "deferred_log.h"
+#include "deferred_work.h"
+#include "event_journal.h"
+#include "fast_math.h"
+#include "firmware_update.h"
+#include "flash.h"
+#include "latency_monitor.h"
+#include "led_status.h"
+#include "matrix3.h"
+#include "rate_groups.h"
+#include "ring_buffer.h"
+#include "scope_probe.h"
+#include "task_status.h"
+#include "task_watchdog.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+/* Private define ------------------------------------------------------------*/
+#define CRC32_POLYNOMIAL            0x04C11DB7 // As the CRC unit with its reset configuration, see common.c
+
+/* Private variables ---------------------------------------------------------*/
+static uint32_t timeMs;
+static uint8_t mutexDummy;
+
+static float32_t maxRefSignals[5]; // z velocity, roll, pitch, yaw angle and yaw rate limits
+static enum FlightControlMode stabilizedFlightMode = FLIGHT_CONTROL_PID;
+
+/* No USB data arrives, the ring stays empty */
+RingBuffer_TypeDef USBCOMRxRingBuffer;
+xSemaphoreHandle USBCOMRxDataSem;
+
+/* The parameters of the modules outside the fuzz build */
+static const ParamGroup_TypeDef emptyParamGroup = { NULL, 0, NULL, NULL };
+
+/* Private function prototypes -----------------------------------------------*/
+static size_t PrintFill(char* dst, const size_t dstSize);
+static uint32_t UpdateCRC(uint32_t crc, const uint8_t* data, const uint32_t size);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Moves the tick and the microsecond time on, e.g. between the received spans, so that the RX timeouts of the
+ *         parsers expire
+ * @param  ms : Time step [ms]
+ * @retval None
+ */
+void FuzzPortAdvanceTime(const uint32_t ms) {
+    timeMs += ms;
+}
+
+/* FreeRTOS kernel -----------------------------------------------------------*/
+
+uint32_t HAL_GetTick(void) {
+    return timeMs;
+}
+
+portTickType xTaskGetTickCount(void) {
+    return (portTickType) (timeMs / portTICK_RATE_MS);
+}
+
+portTickType xTaskGetTickCountFromISR(void) {
+    return xTaskGetTickCount();
+}
+
+void vTaskSuspendAll(void) {
+}
+
+signed portBASE_TYPE xTaskResumeAll(void) {
+    return pdFALSE;
+}
+
+/* The harness is the only task, a mutex or semaphore is always available */
+xQueueHandle xQueueCreateMutex(unsigned char ucQueueType) {
+    (void) ucQueueType;
+    return (xQueueHandle) &mutexDummy;
+}
+
+signed portBASE_TYPE xQueueGenericSend(xQueueHandle xQueue, const void * const pvItemToQueue,
+        portTickType xTicksToWait, portBASE_TYPE xCopyPosition) {
+    (void) xQueue;
+    (void) pvItemToQueue;
+    (void) xTicksToWait;
+    (void) xCopyPosition;
+    return pdTRUE;
+}
+
+signed portBASE_TYPE xQueueGenericReceive(xQueueHandle xQueue, void * const pvBuffer, portTickType xTicksToWait,
+        portBASE_TYPE xJustPeek) {
+    (void) xQueue;
+    (void) pvBuffer;
+    (void) xTicksToWait;
+    (void) xJustPeek;
+    return pdTRUE;
+}
+
+void* pvPortMalloc(size_t xSize) {
+    return malloc(xSize);
+}
+
+/* common.c ------------------------------------------------------------------*/
+
+uint64_t GetMicroseconds(void) {
+    return (uint64_t) timeMs * 1000;
+}
+
+uint32_t CalculateCRC(const uint8_t* dataBuffer, const uint32_t dataBufferSize) {
+    return UpdateCRC(0xFFFFFFFF, dataBuffer, dataBufferSize);
+}
+
+uint32_t ContinueCRC(const uint32_t crc, const uint8_t* dataBuffer, const uint32_t dataBufferSize) {
+    return UpdateCRC(crc, dataBuffer, dataBufferSize);
+}
+
+/* As the target without the scheduler, the callers fall back to CalculateCRC() */
+FcbRetValType StartCRCWithDMA(const uint32_t crc, const uint8_t* dataBuffer, const uint32_t dataBufferSize) {
+    (void) crc;
+    (void) dataBuffer;
+    (void) dataBufferSize;
+    return FCB_ERR;
+}
+
+FcbRetValType WaitCRCWithDMA(uint32_t* crc, const uint32_t timeout) {
+    (void) crc;
+    (void) timeout;
+    return FCB_ERR;
+}
+
+/* deferred_log.c ------------------------------------------------------------*/
+
+void LogRecord(const char* format, const uint32_t arg0, const uint32_t arg1, const uint32_t arg2,
+        const uint32_t arg3) {
+    (void) format;
+    (void) arg0;
+    (void) arg1;
+    (void) arg2;
+    (void) arg3;
+}
+
+bool LogRateLimitPass(LogRateLimit_TypeDef* limit, const uint32_t intervalMs, uint32_t* suppressed) {
+    (void) limit;
+    (void) intervalMs;
+    *suppressed = 0;
+    return true;
+}
+
+void GetLogStatus(LogStatus_TypeDef* status) {
+    memset(status, 0, sizeof(LogStatus_TypeDef));
+}
+
+void SetLogSinks(const uint8_t sinks) {
+    (void) sinks;
+}
+
+/* telemetry.c, telemetry_aggregate.c ----------------------------------------*/
+
+FcbRetValType EncodeTelemetryMsg(const enum ProtoMessageTypeEnum msgType, uint8_t* dst, const size_t dstSize,
+        size_t* encodedSize) {
+    (void) msgType;
+    memset(dst, 0, dstSize);
+    *encodedSize = dstSize;
+    return FCB_OK;
+}
+
+FcbRetValType GetTelemetryMsgType(const char* msgName, const size_t msgNameLength,
+        enum ProtoMessageTypeEnum* msgType) {
+    (void) msgName;
+    (void) msgNameLength;
+    *msgType = RC_VALUES_MSG_ENUM;
+    return FCB_OK;
+}
+
+size_t PrintCompactPrecision(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+FcbRetValType SetCompactPrecision(const char* groupName, const size_t groupNameLength, const uint8_t decimals) {
+    (void) groupName;
+    (void) groupNameLength;
+    (void) decimals;
+    return FCB_OK;
+}
+
+void SetTelemetryOutput(const TelemetryOutput output) {
+    (void) output;
+}
+
+FcbRetValType StartTelemetry(const enum ProtoMessageTypeEnum msgType, const SerializationType serialization,
+        const uint16_t sampleTime, const uint32_t sampleDuration) {
+    (void) msgType;
+    (void) serialization;
+    (void) sampleTime;
+    (void) sampleDuration;
+    return FCB_OK;
+}
+
+void StopAllTelemetry(void) {
+}
+
+FcbRetValType StopTelemetry(const enum ProtoMessageTypeEnum msgType) {
+    (void) msgType;
+    return FCB_OK;
+}
+
+FcbRetValType SetAggregateGroupWindowSize(const char* groupName, const size_t groupNameLength,
+        const uint16_t windowSize) {
+    (void) groupName;
+    (void) groupNameLength;
+    (void) windowSize;
+    return FCB_OK;
+}
+
+/* uart.c, usbd_log_if.c -----------------------------------------------------*/
+
+uint32_t GetUartBaudRate(void) {
+    return 115200;
+}
+
+UartStatus SaveUartSettings(void) {
+    return UART_OK;
+}
+
+UartStatus SetUartBaudRate(const uint32_t baudRate) {
+    (void) baudRate;
+    return UART_OK;
+}
+
+/* The harness checks all the data sent, see FuzzSend() of fuzz_com.c */
+UartStatus UartSendData(const uint8_t* sendData, const uint16_t sendDataSize) {
+    volatile uint8_t sink;
+    uint16_t i;
+
+    for (i = 0; i < sendDataSize; i++) {
+        sink = sendData[i];
+    }
+    (void) sink;
+
+    return UART_OK;
+}
+
+UartStatus UartSendPriorityData(const uint8_t* sendData, const uint16_t sendDataSize) {
+    return UartSendData(sendData, sendDataSize);
+}
+
+uint32_t GetUSBLogDroppedBytes(void) {
+    return 0;
+}
+
+/* blackbox.c ----------------------------------------------------------------*/
+
+FcbRetValType EraseBlackbox(void) {
+    return FCB_OK;
+}
+
+const ParamGroup_TypeDef* GetBlackboxParamGroup(void) {
+    return &emptyParamGroup;
+}
+
+void GetBlackboxStatus(BlackboxStatus_TypeDef* status) {
+    memset(status, 0, sizeof(BlackboxStatus_TypeDef));
+}
+
+FcbRetValType ReadBlackbox(const uint32_t offset, uint8_t* dst, const uint16_t size) {
+    (void) offset;
+    memset(dst, 0, size);
+    return FCB_OK;
+}
+
+/* flight_control.c, flight_mode.c -------------------------------------------*/
+
+const ParamGroup_TypeDef* GetReferenceLimitParamGroup(void) {
+    return &emptyParamGroup;
+}
+
+enum FlightControlMode GetStabilizedFlightMode(void) {
+    return stabilizedFlightMode;
+}
+
+FcbRetValType SaveSensorNoise(void) {
+    return FCB_OK;
+}
+
+FcbRetValType SaveStateWarmStart(void) {
+    return FCB_OK;
+}
+
+FlightControlErrorStatus SetStabilizedFlightMode(const enum FlightControlMode mode) {
+    stabilizedFlightMode = mode;
+    return FLIGHTCTRL_OK;
+}
+
+void getMaxLimitForReferenceSignal(float32_t* maxZVelocity, float32_t* maxRollAngle, float32_t* maxPitchAngle,
+        float32_t* maxYawAngle, float32_t* maxYawAngleRate) {
+    *maxZVelocity = maxRefSignals[0];
+    *maxRollAngle = maxRefSignals[1];
+    *maxPitchAngle = maxRefSignals[2];
+    *maxYawAngle = maxRefSignals[3];
+    *maxYawAngleRate = maxRefSignals[4];
+}
+
+void setMaxLimitForReferenceSignal(float32_t maxZVelocity, float32_t maxRollAngle, float32_t maxPitchAngle,
+        float32_t maxYawAngleRate) {
+    maxRefSignals[0] = maxZVelocity;
+    maxRefSignals[1] = maxRollAngle;
+    maxRefSignals[2] = maxPitchAngle;
+    maxRefSignals[4] = maxYawAngleRate;
+}
+
+const char* GetFlightModeRejectName(const FlightModeRejectType reason) {
+    (void) reason;
+    return "n/a";
+}
+
+FlightModeStateType GetFlightModeState(void) {
+    return FLIGHT_MODE_DISARMED;
+}
+
+const char* GetFlightModeStateName(const FlightModeStateType state) {
+    (void) state;
+    return "n/a";
+}
+
+void GetFlightModeStatus(FlightModeStatusType* dstStatus) {
+    memset(dstStatus, 0, sizeof(FlightModeStatusType));
+}
+
+bool PrintFlightModeLogNext(char* dst, const size_t dstSize) {
+    PrintFill(dst, dstSize);
+    return false;
+}
+
+/* motor_control.c, motor_test.c, thrust_curve.c -----------------------------*/
+
+void GetEscOutputs(EscOutputsType* outputs) {
+    memset(outputs, 0, sizeof(EscOutputsType));
+}
+
+uint16_t GetMotorValue(uint8_t motorNumber) {
+    (void) motorNumber;
+    return 0;
+}
+
+FcbRetValType SaveEscOutputs(void) {
+    return FCB_OK;
+}
+
+FcbRetValType SetEscOutputs(const EscOutputsType* outputs) {
+    (void) outputs;
+    return FCB_OK;
+}
+
+void GetMotorTestStatus(MotorTestStatusType* dstStatus) {
+    memset(dstStatus, 0, sizeof(MotorTestStatusType));
+}
+
+void LockMotorTest(void) {
+}
+
+FcbRetValType NextEscCalibrationStep(void) {
+    return FCB_OK;
+}
+
+size_t PrintMotorTestStatus(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+FcbRetValType StartEscCalibration(void) {
+    return FCB_OK;
+}
+
+FcbRetValType StartMotorTest(const uint8_t motor, const float32_t output, const uint16_t duration) {
+    (void) motor;
+    (void) output;
+    (void) duration;
+    return FCB_OK;
+}
+
+void StopMotorTest(void) {
+}
+
+FcbRetValType UnlockMotorTest(const char* confirmation, const size_t length) {
+    (void) confirmation;
+    (void) length;
+    return FCB_OK;
+}
+
+FcbRetValType AddThrustTestPoint(const float32_t thrust) {
+    (void) thrust;
+    return FCB_OK;
+}
+
+/* No test points are recorded */
+FcbRetValType FitThrustTestCurve(ThrustCurveType* dstCurve, float32_t* dstRmsError, uint8_t* dstMotor) {
+    (void) dstCurve;
+    (void) dstRmsError;
+    (void) dstMotor;
+    return FCB_ERR;
+}
+
+size_t PrintThrustCurves(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+FcbRetValType SaveThrustCurves(void) {
+    return FCB_OK;
+}
+
+FcbRetValType SetThrustCurve(const uint8_t motor, const ThrustCurveType* curve) {
+    (void) motor;
+    (void) curve;
+    return FCB_OK;
+}
+
+FcbRetValType StartThrustTest(const uint8_t motor, const float32_t output) {
+    (void) motor;
+    (void) output;
+    return FCB_OK;
+}
+
+void StopThrustTest(void) {
+}
+
+/* param_profile.c, prearm_checks.c ------------------------------------------*/
+
+int8_t GetActiveParamProfile(void) {
+    return -1;
+}
+
+size_t PrintParamProfiles(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+FcbRetValType SaveParamProfile(const uint8_t profileIdx) {
+    (void) profileIdx;
+    return FCB_OK;
+}
+
+FcbRetValType SelectParamProfile(const uint8_t profileIdx) {
+    (void) profileIdx;
+    return FCB_OK;
+}
+
+uint32_t GetPreArmFailures(void) {
+    return 0;
+}
+
+size_t PrintPreArmChecks(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+/* rc_smoothing.c, receiver.c, stick_curves.c --------------------------------*/
+
+const ParamGroup_TypeDef* GetRcSmoothingParamGroup(void) {
+    return &emptyParamGroup;
+}
+
+void GetRcSmoothingStatus(RcSmoothingStatusType* status) {
+    memset(status, 0, sizeof(RcSmoothingStatusType));
+}
+
+uint16_t GetAileronReceiverCalibrationMaxValue(void) {
+    return 0;
+}
+
+uint16_t GetAileronReceiverCalibrationMidValue(void) {
+    return 0;
+}
+
+uint16_t GetAileronReceiverCalibrationMinValue(void) {
+    return 0;
+}
+
+int16_t GetAileronReceiverChannel(void) {
+    return 0;
+}
+
+uint16_t GetAux1ReceiverCalibrationMaxValue(void) {
+    return 0;
+}
+
+uint16_t GetAux1ReceiverCalibrationMidValue(void) {
+    return 0;
+}
+
+uint16_t GetAux1ReceiverCalibrationMinValue(void) {
+    return 0;
+}
+
+int16_t GetAux1ReceiverChannel(void) {
+    return 0;
+}
+
+uint16_t GetElevatorReceiverCalibrationMaxValue(void) {
+    return 0;
+}
+
+uint16_t GetElevatorReceiverCalibrationMidValue(void) {
+    return 0;
+}
+
+uint16_t GetElevatorReceiverCalibrationMinValue(void) {
+    return 0;
+}
+
+int16_t GetElevatorReceiverChannel(void) {
+    return 0;
+}
+
+uint16_t GetGearReceiverCalibrationMaxValue(void) {
+    return 0;
+}
+
+uint16_t GetGearReceiverCalibrationMidValue(void) {
+    return 0;
+}
+
+uint16_t GetGearReceiverCalibrationMinValue(void) {
+    return 0;
+}
+
+int16_t GetGearReceiverChannel(void) {
+    return 0;
+}
+
+uint16_t GetRudderReceiverCalibrationMaxValue(void) {
+    return 0;
+}
+
+uint16_t GetRudderReceiverCalibrationMidValue(void) {
+    return 0;
+}
+
+uint16_t GetRudderReceiverCalibrationMinValue(void) {
+    return 0;
+}
+
+int16_t GetRudderReceiverChannel(void) {
+    return 0;
+}
+
+uint16_t GetThrottleReceiverCalibrationMaxValue(void) {
+    return 0;
+}
+
+uint16_t GetThrottleReceiverCalibrationMidValue(void) {
+    return 0;
+}
+
+uint16_t GetThrottleReceiverCalibrationMinValue(void) {
+    return 0;
+}
+
+int16_t GetThrottleReceiverChannel(void) {
+    return 0;
+}
+
+void GetReceiverChannelMap(Receiver_ChannelMap_TypeDef* dstMap) {
+    memset(dstMap, 0, sizeof(Receiver_ChannelMap_TypeDef));
+}
+
+void GetReceiverLinkStats(Receiver_LinkStats_TypeDef* dstStats) {
+    memset(dstStats, 0, sizeof(Receiver_LinkStats_TypeDef));
+}
+
+ReceiverModeType GetReceiverMode(void) {
+    return RECEIVER_MODE_NONE;
+}
+
+const char* GetReceiverModeName(const ReceiverModeType mode) {
+    (void) mode;
+    return "n/a";
+}
+
+ReceiverErrorStatus GetReceiverSnapshot(Receiver_Snapshot_TypeDef* dstSnapshot) {
+    memset(dstSnapshot, 0, sizeof(Receiver_Snapshot_TypeDef));
+    return RECEIVER_OK;
+}
+
+ReceiverErrorStatus IsReceiverActive(void) {
+    return RECEIVER_ERROR;
+}
+
+void ResetReceiverCalibrationValues(void) {
+}
+
+ReceiverErrorStatus SaveReceiverChannelMap(void) {
+    return RECEIVER_OK;
+}
+
+ReceiverErrorStatus SetReceiverChannelMap(const Receiver_ChannelMap_TypeDef* channelMap) {
+    (void) channelMap;
+    return RECEIVER_OK;
+}
+
+ReceiverErrorStatus StartReceiverCalibration(void) {
+    return RECEIVER_OK;
+}
+
+ReceiverErrorStatus StopReceiverCalibration(void) {
+    return RECEIVER_OK;
+}
+
+const char* GetStickAxisName(const StickAxisType axis) {
+    (void) axis;
+    return "n/a";
+}
+
+size_t PrintStickCurves(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+FcbRetValType SaveStickCurves(void) {
+    return FCB_OK;
+}
+
+FcbRetValType SetStickCurve(const StickAxisType axis, const StickCurveType* curve) {
+    (void) axis;
+    (void) curve;
+    return FCB_OK;
+}
+
+/* Sensor modules ------------------------------------------------------------*/
+
+FcbRetValType ClearAccMagTempCompensation(void) {
+    return FCB_OK;
+}
+
+void GetAccMagTempCompensation(FcbAccMagTempCompensationType* dstCompensation) {
+    memset(dstCompensation, 0, sizeof(FcbAccMagTempCompensationType));
+}
+
+int16_t GetAccMagTemperature(void) {
+    return 0;
+}
+
+const ParamGroup_TypeDef* GetMagCalibrationParamGroup(void) {
+    return &emptyParamGroup;
+}
+
+FcbRetValType SetAccMagTempCompensationEnabled(uint8_t enable) {
+    (void) enable;
+    return FCB_OK;
+}
+
+void StartAccMagMtrCalibration(uint32_t samples) {
+    (void) samples;
+}
+
+size_t PrintBarometerStats(char * dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+FcbRetValType SetBarometerConfig(const uint8_t oss, const uint32_t temperaturePeriod) {
+    (void) oss;
+    (void) temperaturePeriod;
+    return FCB_OK;
+}
+
+FcbRetValType SetBarometerReference(const BarometerReferenceType reference, const uint32_t pressure) {
+    (void) reference;
+    (void) pressure;
+    return FCB_OK;
+}
+
+FcbRetValType ClearGyroTempCompensation(void) {
+    return FCB_OK;
+}
+
+void GetGyroTempCompensation(FcbGyroTempCompensationType* dstCompensation) {
+    memset(dstCompensation, 0, sizeof(FcbGyroTempCompensationType));
+}
+
+int8_t GetGyroTemperature(void) {
+    return 0;
+}
+
+FcbRetValType SetGyroTempCompensationEnabled(uint8_t enable) {
+    (void) enable;
+    return FCB_OK;
+}
+
+FcbRetValType SensorFilterConfig(FcbSensorIndexType sensor, const FcbSensorFilterConfigType * config) {
+    (void) sensor;
+    (void) config;
+    return FCB_OK;
+}
+
+const ParamGroup_TypeDef* GetSensorOrientationParamGroup(void) {
+    return &emptyParamGroup;
+}
+
+size_t PrintSensorOrientation(char * dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+size_t PrintSensorHealthReport(char * dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+size_t PrintSensorTiming(char * dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+FcbRetValType SetSensorTiming(FcbSensorIndexType sensor, const FcbSensorTimingConfigType * config) {
+    (void) sensor;
+    (void) config;
+    return FCB_OK;
+}
+
+bool IsSensorHealthy(FcbSensorIndexType sensor) {
+    (void) sensor;
+    return true;
+}
+
+size_t PrintSensorWatchdogStats(char * dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+void ResetSensorWatchdogStats(void) {
+}
+
+size_t PrintSensorDataRateStats(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+void ResetSensorDataRateStats(void) {
+}
+
+size_t PrintVibrationStats(char * dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+void ResetVibrationStats(void) {
+}
+
+/* Utility modules -----------------------------------------------------------*/
+
+size_t BootTimingPrint(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+size_t CcmRamPrint(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+/* No crash dump is kept */
+void ClearCrashDump(void) {
+}
+
+size_t CrashDumpPrint(char* dst, const size_t dstSize, const CrashDump_TypeDef* dump) {
+    (void) dump;
+    return PrintFill(dst, dstSize);
+}
+
+size_t CrashDumpPrintLogEntry(char* dst, const size_t dstSize, const CrashDump_TypeDef* dump,
+        const uint8_t entryIdx) {
+    (void) dump;
+    (void) entryIdx;
+    return PrintFill(dst, dstSize);
+}
+
+/* As crash_dump.c encodes a dump without a crash */
+bool EncodeCrashDump(pb_ostream_t* stream, const CrashDump_TypeDef* dump) {
+    return pb_encode_tag(stream, PB_WT_VARINT, 1) && pb_encode_varint(stream, dump->cause);
+}
+
+bool EncodeCrashDumpLogEntry(pb_ostream_t* stream, const CrashDump_TypeDef* dump, const uint8_t entryIdx) {
+    (void) dump;
+    (void) entryIdx;
+    return pb_encode_tag(stream, PB_WT_VARINT, 1) && pb_encode_varint(stream, CRASH_CAUSE_NONE);
+}
+
+bool GetCrashDump(CrashDump_TypeDef* dump) {
+    memset(dump, 0, sizeof(CrashDump_TypeDef));
+    return false;
+}
+
+size_t DeadlineMonitorPrint(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+void DeadlineMonitorReset(void) {
+}
+
+size_t DeferredWorkPrint(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+void DeferredWorkReset(void) {
+}
+
+/* The journal is empty */
+FcbRetValType ClearEventJournal(void) {
+    return FCB_OK;
+}
+
+bool GetEventJournalRecord(const uint16_t idx, EventJournalRecordType* dstRecord) {
+    (void) idx;
+    (void) dstRecord;
+    return false;
+}
+
+void GetEventJournalStatus(EventJournalStatusType* dstStatus) {
+    memset(dstStatus, 0, sizeof(EventJournalStatusType));
+}
+
+size_t PrintEventJournalRecord(char* dst, const size_t dstSize, const EventJournalRecordType* record) {
+    (void) record;
+    return PrintFill(dst, dstSize);
+}
+
+size_t PrintEventJournalStatus(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+size_t FastMathBenchmark(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+FcbRetValType GetFirmwareImageInfo(FirmwareImageInfo_TypeDef* info) {
+    memset(info, 0, sizeof(FirmwareImageInfo_TypeDef));
+    return FCB_OK;
+}
+
+size_t PrintFirmwareInfo(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+FcbRetValType RebootToBootloader(void) {
+    return FCB_ERR;
+}
+
+void AbortFlashSettingsBatch(void) {
+}
+
+FlashErrorStatus EndFlashSettingsBatch(void) {
+    return FLASH_OK;
+}
+
+FlashErrorStatus StartFlashSettingsBatch(void) {
+    return FLASH_OK;
+}
+
+size_t LatencyMonitorPrint(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+void LatencyMonitorReset(void) {
+}
+
+size_t PrintLedStatus(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+size_t Matrix3Benchmark(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+size_t RateGroupPrint(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+void RateGroupReset(void) {
+}
+
+const char* GetScopeProbeStageName(const ScopeProbeStage_TypeDef stage) {
+    (void) stage;
+    return "n/a";
+}
+
+size_t ScopeProbePrint(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+void SetScopeProbeChannel(const ScopeProbeStage_TypeDef stage, const uint8_t channel) {
+    (void) stage;
+    (void) channel;
+}
+
+bool TaskStatusPrintNext(char* dst, const size_t dstSize) {
+    PrintFill(dst, dstSize);
+    return false;
+}
+
+void ClearWatchdogReset(void) {
+}
+
+bool IsWatchdogResetPending(void) {
+    return false;
+}
+
+size_t PrintTaskWatchdog(char* dst, const size_t dstSize) {
+    return PrintFill(dst, dstSize);
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Fills the destination string as a print that was truncated to it
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @retval dstSize, the length of a truncated print
+ */
+static size_t PrintFill(char* dst, const size_t dstSize) {
+    if (dstSize > 0) {
+        memset(dst, '.', dstSize - 1);
+        dst[dstSize - 1] = '\0';
+    }
+
+    return dstSize;
+}
+
+/*
+ * @brief  Continues a CRC-32 as the CRC unit calculates it, byte-wise MSB first without reflection or final XOR
+ * @param  crc : CRC of the preceding data, 0xFFFFFFFF to start
+ * @param  data : Data
+ * @param  size : Size of data [bytes]
+ * @retval CRC
+ */
+static uint32_t UpdateCRC(uint32_t crc, const uint8_t* data, const uint32_t size) {
+    uint32_t i;
+    uint8_t bit;
+
+    for (i = 0; i < size; i++) {
+        crc ^= (uint32_t) data[i] << 24;
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ CRC32_POLYNOMIAL : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,32 @@
+/******************************************************************************
+ * @file    fuzz_port.h
+ * @author  Dragonfly
+ * @brief   Header file of the fuzz port, which stands in for the kernel and the
+ *          target modules around the communication modules of the fuzz
+ *          harness: the tick, the mutexes, the CRC unit and the modules the
+ *          CLI commands and RPC handlers call into, see host/Makefile.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __FUZZ_PORT_H
+#define __FUZZ_PORT_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+/* Exported types ------------------------------------------------------------*/
+/* Exported macro ------------------------------------------------------------*/
+/* Exported function prototypes --------------------------------------------- */
+void FuzzPortAdvanceTime(const uint32_t ms);
+
+#endif /* __FUZZ_PORT_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,343 @@
+/******************************************************************************
+ * @file    host_port.c
+ * @author  Dragonfly
+ * @brief   The host port, the target modules the estimation, control and mixer
+ *          modules call into, replaced by what the host harness sets. The
+ *          flash settings are kept in RAM with the keys of flash.c, so that a
+ *          saved setting reads back until HostPortReset().
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "host_port.h"
+
+#include "fcb_port.h"
+#include "fcb_error.h"
+#include "fcb_gyroscope.h"
+#include "fcb_accelerometer_magnetometer.h"
+#include "fcb_sensor_watchdog.h"
+#include "fcb_vibration_monitor.h"
+#include "ccm_ram.h"
+#include "common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+/* Private define ------------------------------------------------------------*/
+#define HOST_PORT_SETTINGS_SIZE     256 // Largest settings record [bytes]
+#define RAD_TO_DEG                  180/PI // As in common.c
+
+/* Private variables ---------------------------------------------------------*/
+uint32_t SystemCoreClock = HOST_PORT_CORE_CLOCK;
+
+/* As in fcb_gyroscope.c */
+const float32_t GYRO_X_AXIS_VARIANCE = 0.098603f;
+const float32_t GYRO_Y_AXIS_VARIANCE = 0.104274f;
+const float32_t GYRO_Z_AXIS_VARIANCE = 0.103256f;
+
+static uint32_t timestamp;
+static float32_t gyroSample[3];
+static float32_t accSample[3];
+static float32_t magSample[3];
+
+static enum FlightControlMode flightControlMode;
+static RefSignals_TypeDef refSignals;
+static CtrlSignals_TypeDef ctrlSignals;
+
+static uint8_t settingsStore[FLASH_KEY_NBR][HOST_PORT_SETTINGS_SIZE];
+static bool isSettingsStored[FLASH_KEY_NBR];
+
+/* Private function prototypes -----------------------------------------------*/
+static FlashErrorStatus ReadSettings(const FlashSettingsKey key, void* dstSettings, const size_t size);
+static FlashErrorStatus WriteSettings(const FlashSettingsKey key, const void* settings, const size_t size);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Clears the inputs and the stored settings, e.g. between the runs of a sweep
+ * @param  None
+ * @retval None
+ */
+void HostPortReset(void) {
+    timestamp = 0;
+    memset(gyroSample, 0, sizeof(gyroSample));
+    memset(accSample, 0, sizeof(accSample));
+    memset(magSample, 0, sizeof(magSample));
+    flightControlMode = FLIGHT_CONTROL_IDLE;
+    memset(&refSignals, 0, sizeof(refSignals));
+    memset(&ctrlSignals, 0, sizeof(ctrlSignals));
+    memset(isSettingsStored, 0, sizeof(isSettingsStored));
+}
+
+/*
+ * @brief  Sets the time GetTimestamp() returns
+ * @param  newTimestamp : Timestamp [core clock cycles], see HOST_PORT_TIMESTAMP()
+ * @retval None
+ */
+void HostPortSetTimestamp(const uint32_t newTimestamp) {
+    timestamp = newTimestamp;
+}
+
+/*
+ * @brief  Sets the latest samples of the sensors, as the sensor modules return them
+ * @param  gyro : Body rates [rad/s]
+ * @param  acc : Accelerations [m/s^2]
+ * @param  mag : Magnetic field [gauss]
+ * @retval None
+ */
+void HostPortSetSensors(const float32_t gyro[3], const float32_t acc[3], const float32_t mag[3]) {
+    memcpy(gyroSample, gyro, sizeof(gyroSample));
+    memcpy(accSample, acc, sizeof(accSample));
+    memcpy(magSample, mag, sizeof(magSample));
+}
+
+/*
+ * @brief  Sets what the flight control task reports to the estimation and control modules
+ * @param  mode : Flight control mode
+ * @param  newRefSignals : Reference signals
+ * @param  newCtrlSignals : Control signals of the latest control cycle
+ * @retval None
+ */
+void HostPortSetFlightControl(const enum FlightControlMode mode, const RefSignals_TypeDef* newRefSignals,
+        const CtrlSignals_TypeDef* newCtrlSignals) {
+    flightControlMode = mode;
+    refSignals = *newRefSignals;
+    ctrlSignals = *newCtrlSignals;
+}
+
+/* common.c ------------------------------------------------------------------*/
+
+uint32_t GetTimestamp(void) {
+    return timestamp;
+}
+
+float32_t TimestampToSeconds(const uint32_t timestampDelta) {
+    return (float32_t) timestampDelta / (float32_t) SystemCoreClock;
+}
+
+float32_t Radian2Degree(float32_t radian) {
+    float32_t degree = radian*RAD_TO_DEG;
+
+    while (degree > 180) {
+        degree -= 360;
+    }
+    while (degree < -180) {
+        degree += 360;
+    }
+
+    return degree;
+}
+
+void toMaxRadian(float32_t *radian) {
+    while (*radian > PI) {
+        *radian -= 2*PI;
+    }
+    while (*radian < -PI) {
+        *radian += 2*PI;
+    }
+}
+
+/* fcb_error.c ---------------------------------------------------------------*/
+
+void ErrorHandler(void) {
+    fprintf(stderr, "ErrorHandler called from %p\n", __builtin_return_address(0));
+    abort();
+}
+
+/* ccm_ram.c -----------------------------------------------------------------*/
+
+void CcmRamRegisterObject(const char* name, const void* address, const size_t size) {
+    (void) name;
+    (void) address;
+    (void) size;
+}
+
+/* Sensor modules ------------------------------------------------------------*/
+
+uint16_t GyroDataRateHz(void) {
+    return HOST_PORT_GYRO_RATE;
+}
+
+void GetGyroAngleDot(float32_t * xAngleDot, float32_t * yAngleDot, float32_t * zAngleDot) {
+    *xAngleDot = gyroSample[0];
+    *yAngleDot = gyroSample[1];
+    *zAngleDot = gyroSample[2];
+}
+
+void GetAcceleration(float32_t * xDotDot, float32_t * yDotDot, float32_t * zDotDot) {
+    *xDotDot = accSample[0];
+    *yDotDot = accSample[1];
+    *zDotDot = accSample[2];
+}
+
+void GetMagVector(float32_t * x, float32_t * y, float32_t * z) {
+    *x = magSample[0];
+    *y = magSample[1];
+    *z = magSample[2];
+}
+
+uint32_t GetSensorStalls(FcbSensorIndexType sensor) {
+    (void) sensor;
+    return 0;
+}
+
+float32_t GetVibrationVariance(FcbSensorIndexType sensor) {
+    (void) sensor;
+    return 0.0f;
+}
+
+bool IsVibrationClipping(FcbSensorIndexType sensor) {
+    (void) sensor;
+    return false;
+}
+
+/* flight_control.c ----------------------------------------------------------*/
+
+enum FlightControlMode GetFlightControlMode(void) {
+    return flightControlMode;
+}
+
+float32_t GetFlightControlSamplePeriod(void) {
+    return FLIGHT_CONTROL_TASK_PERIOD/1000.0f;
+}
+
+float32_t GetZVelocityReferenceSignal(void) {
+    return refSignals.zVelocity;
+}
+
+float32_t GetRollAngleReferenceSignal(void) {
+    return refSignals.rollAngle;
+}
+
+float32_t GetPitchAngleReferenceSignal(void) {
+    return refSignals.pitchAngle;
+}
+
+float32_t GetYawAngleReferenceSignal(void) {
+    return refSignals.yawAngle;
+}
+
+float32_t GetYawAngularRateReferenceSignal(void) {
+    return refSignals.yawAngleRate;
+}
+
+float32_t GetThrustControlSignal(void) {
+    return ctrlSignals.thrust;
+}
+
+float32_t GetRollControlSignal(void) {
+    return ctrlSignals.rollMoment;
+}
+
+float32_t GetPitchControlSignal(void) {
+    return ctrlSignals.pitchMoment;
+}
+
+float32_t GetYawControlSignal(void) {
+    return ctrlSignals.yawMoment;
+}
+
+/* flash.c -------------------------------------------------------------------*/
+
+FlashErrorStatus ReadMotorMixerSettingsFromFlash(MotorMixerSettings_TypeDef* motorMixerSettings) {
+    return ReadSettings(FLASH_KEY_MOTOR_MIXER, motorMixerSettings, sizeof(MotorMixerSettings_TypeDef));
+}
+
+FlashErrorStatus WriteMotorMixerSettingsToFlash(const MotorMixerSettings_TypeDef* motorMixerSettings) {
+    return WriteSettings(FLASH_KEY_MOTOR_MIXER, motorMixerSettings, sizeof(MotorMixerSettings_TypeDef));
+}
+
+FlashErrorStatus ReadMixerAllocationFromFlash(MotorMixerAllocation_TypeDef* mixerAllocation) {
+    return ReadSettings(FLASH_KEY_MIXER_ALLOCATION, mixerAllocation, sizeof(MotorMixerAllocation_TypeDef));
+}
+
+FlashErrorStatus WriteMixerAllocationToFlash(const MotorMixerAllocation_TypeDef* mixerAllocation) {
+    return WriteSettings(FLASH_KEY_MIXER_ALLOCATION, mixerAllocation, sizeof(MotorMixerAllocation_TypeDef));
+}
+
+FlashErrorStatus ReadPIDGainsFromFlash(PIDGainSettings_TypeDef* pidGainSettings) {
+    return ReadSettings(FLASH_KEY_PID_GAINS, pidGainSettings, sizeof(PIDGainSettings_TypeDef));
+}
+
+FlashErrorStatus WritePIDGainsToFlash(const PIDGainSettings_TypeDef* pidGainSettings) {
+    return WriteSettings(FLASH_KEY_PID_GAINS, pidGainSettings, sizeof(PIDGainSettings_TypeDef));
+}
+
+FlashErrorStatus ReadPIDGainScheduleFromFlash(PIDGainSchedule_TypeDef* pidGainSchedule) {
+    return ReadSettings(FLASH_KEY_PID_GAIN_SCHEDULE, pidGainSchedule, sizeof(PIDGainSchedule_TypeDef));
+}
+
+FlashErrorStatus WritePIDGainScheduleToFlash(const PIDGainSchedule_TypeDef* pidGainSchedule) {
+    return WriteSettings(FLASH_KEY_PID_GAIN_SCHEDULE, pidGainSchedule, sizeof(PIDGainSchedule_TypeDef));
+}
+
+FlashErrorStatus ReadPIDFeedForwardFromFlash(PIDFeedForwardSettings_TypeDef* pidFeedForwardSettings) {
+    return ReadSettings(FLASH_KEY_PID_FEED_FORWARD, pidFeedForwardSettings, sizeof(PIDFeedForwardSettings_TypeDef));
+}
+
+FlashErrorStatus WritePIDFeedForwardToFlash(const PIDFeedForwardSettings_TypeDef* pidFeedForwardSettings) {
+    return WriteSettings(FLASH_KEY_PID_FEED_FORWARD, pidFeedForwardSettings, sizeof(PIDFeedForwardSettings_TypeDef));
+}
+
+FlashErrorStatus ReadEstimatorNoiseFromFlash(EstimatorNoiseSettingsType* estimatorNoise) {
+    return ReadSettings(FLASH_KEY_ESTIMATOR_NOISE, estimatorNoise, sizeof(EstimatorNoiseSettingsType));
+}
+
+FlashErrorStatus WriteEstimatorNoiseToFlash(const EstimatorNoiseSettingsType* estimatorNoise) {
+    return WriteSettings(FLASH_KEY_ESTIMATOR_NOISE, estimatorNoise, sizeof(EstimatorNoiseSettingsType));
+}
+
+FlashErrorStatus ReadMagHeadingSettingsFromFlash(MagHeadingSettingsType* magHeadingSettings) {
+    return ReadSettings(FLASH_KEY_MAG_HEADING, magHeadingSettings, sizeof(MagHeadingSettingsType));
+}
+
+FlashErrorStatus WriteMagHeadingSettingsToFlash(const MagHeadingSettingsType* magHeadingSettings) {
+    return WriteSettings(FLASH_KEY_MAG_HEADING, magHeadingSettings, sizeof(MagHeadingSettingsType));
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Reads a setting saved since the last HostPortReset()
+ * @param  key : Key of the setting
+ * @param  dstSettings : Destination
+ * @param  size : Size of the setting [bytes]
+ * @retval FLASH_OK if it was saved, else FLASH_ERROR as for an empty flash
+ */
+static FlashErrorStatus ReadSettings(const FlashSettingsKey key, void* dstSettings, const size_t size) {
+    if (key >= FLASH_KEY_NBR || size > HOST_PORT_SETTINGS_SIZE || !isSettingsStored[key]) {
+        return FLASH_ERROR;
+    }
+
+    memcpy(dstSettings, settingsStore[key], size);
+
+    return FLASH_OK;
+}
+
+/*
+ * @brief  Saves a setting
+ * @param  key : Key of the setting
+ * @param  settings : Setting to save
+ * @param  size : Size of the setting [bytes]
+ * @retval FLASH_OK if saved, else FLASH_ERROR
+ */
+static FlashErrorStatus WriteSettings(const FlashSettingsKey key, const void* settings, const size_t size) {
+    if (key >= FLASH_KEY_NBR || size > HOST_PORT_SETTINGS_SIZE) {
+        return FLASH_ERROR;
+    }
+
+    memcpy(settingsStore[key], settings, size);
+    isSettingsStored[key] = true;
+
+    return FLASH_OK;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,49 @@
+/******************************************************************************
+ * @file    host_port.h
+ * @author  Dragonfly
+ * @brief   Header file of the host port, which stands in for the target
+ *          modules around the estimation, control and mixer modules of the
+ *          host build: the timestamp counter, the sensor drivers, the flight
+ *          control task and the flash settings. The harness sets the inputs
+ *          here before it steps the modules, see host/Makefile.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __HOST_PORT_H
+#define __HOST_PORT_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "arm_math.h"
+#include "flight_control.h"
+#include "pid_control.h"
+
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+#define HOST_PORT_CORE_CLOCK        72000000 // As the FCB, the timestamps count core clock cycles [Hz]
+#define HOST_PORT_GYRO_RATE         760 // Data rate of the L3GD20 as the FCB sets it [Hz]
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported macro ------------------------------------------------------------*/
+
+/* Converts a simulated time to a timestamp, see GetTimestamp() */
+#define HOST_PORT_TIMESTAMP(seconds) ((uint32_t) ((uint64_t) ((seconds) * HOST_PORT_CORE_CLOCK)))
+
+/* Exported function prototypes --------------------------------------------- */
+void HostPortReset(void);
+void HostPortSetTimestamp(const uint32_t timestamp);
+void HostPortSetSensors(const float32_t gyro[3], const float32_t acc[3], const float32_t mag[3]);
+void HostPortSetFlightControl(const enum FlightControlMode mode, const RefSignals_TypeDef* refSignals,
+        const CtrlSignals_TypeDef* ctrlSignals);
+
+#endif /* __HOST_PORT_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
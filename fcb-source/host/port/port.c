@@ -0,0 +1,66 @@
+/******************************************************************************
+ * @file    port.c
+ * @author  Dragonfly
+ * @brief   FreeRTOS port functions of the host build, see portmacro.h. The
+ *          scheduler is not started on the host, the modules are called from
+ *          the thread of the harness.
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Private variables ---------------------------------------------------------*/
+static unsigned portBASE_TYPE criticalNesting = 0;
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Yields to another task, there is none on the host
+ * @param  None
+ * @retval None
+ */
+void vPortYield(void) {
+}
+
+/*
+ * @brief  Enters a critical section, only the nesting is checked on the host
+ * @param  None
+ * @retval None
+ */
+void vPortEnterCritical(void) {
+    criticalNesting++;
+}
+
+/*
+ * @brief  Exits a critical section
+ * @param  None
+ * @retval None
+ */
+void vPortExitCritical(void) {
+    configASSERT(criticalNesting > 0);
+    criticalNesting--;
+}
+
+/*
+ * @brief  Reports a failed configASSERT and aborts, so that a harness or fuzzer sees the failure instead of a hang
+ * @param  file : Source file of the assert
+ * @param  line : Line of the assert
+ * @retval None, does not return
+ */
+void vPortHostAssert(const char* file, const int line) {
+    fprintf(stderr, "configASSERT failed at %s:%d\n", file, line);
+    abort();
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
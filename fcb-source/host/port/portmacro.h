@@ -0,0 +1,66 @@
+/******************************************************************************
+ * @file    portmacro.h
+ * @author  Dragonfly
+ * @brief   FreeRTOS port macros of the host build, in place of the ARM_CM4F
+ *          port. The host build runs the modules from one thread without the
+ *          scheduler, so the critical sections and yields do nothing and a
+ *          failed configASSERT aborts. See host/Makefile.
+ ******************************************************************************/
+
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+/* Includes -----------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+#define portCHAR                char
+#define portFLOAT               float
+#define portDOUBLE              double
+#define portLONG                long
+#define portSHORT               short
+#define portSTACK_TYPE          unsigned portLONG
+#define portBASE_TYPE           long
+
+/* Ticks wrap at 32 bits as on the target */
+typedef uint32_t portTickType;
+#define portMAX_DELAY           ( portTickType ) 0xffffffff
+
+#define portSTACK_GROWTH        ( -1 )
+#define portTICK_RATE_MS        ( ( portTickType ) 1000 / configTICK_RATE_HZ )
+#define portBYTE_ALIGNMENT      8
+
+/* Exported macro ------------------------------------------------------------*/
+
+void vPortYield(void);
+void vPortEnterCritical(void);
+void vPortExitCritical(void);
+void vPortHostAssert(const char* file, const int line);
+
+#define portYIELD()                             vPortYield()
+#define portEND_SWITCHING_ISR(xSwitchRequired)  (void) (xSwitchRequired)
+#define portYIELD_FROM_ISR(x)                   portEND_SWITCHING_ISR(x)
+
+#define portSET_INTERRUPT_MASK_FROM_ISR()       0
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x)    (void) (x)
+#define portDISABLE_INTERRUPTS()
+#define portENABLE_INTERRUPTS()
+#define portENTER_CRITICAL()                    vPortEnterCritical()
+#define portEXIT_CRITICAL()                     vPortExitCritical()
+
+#define portTASK_FUNCTION_PROTO(vFunction, pvParameters) void vFunction(void *pvParameters)
+#define portTASK_FUNCTION(vFunction, pvParameters) void vFunction(void *pvParameters)
+
+#define portNOP()
+
+#endif /* PORTMACRO_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
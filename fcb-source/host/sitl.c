@@ -0,0 +1,496 @@
+/******************************************************************************
+ * @file    sitl.c
+ * @author  Dragonfly
+ * @brief   Software-in-the-loop driver of the host build. It closes the loop of
+ *          the state estimation, the cascaded PID control and the motor mixer
+ *          around the airframe model of airframe_sim.h, in the order the flight
+ *          control task runs them, see ProcessFlightControlEvents() of
+ *          flight_control.c: the gyroscope correction and the rate loop on
+ *          every gyroscope sample, the accelerometer and barometer corrections
+ *          at their data rates, and the prediction and the outer loop of the
+ *          altitude hold mode every FLIGHT_CONTROL_TASK_PERIOD. The model has
+ *          no magnetometer, the yaw is left to the gyroscope, and the
+ *          barometer reads the true altitude with white noise.
+ *
+ *          The scenario takes off to SITL_HOVER_ALTITUDE and steps the roll,
+ *          the pitch and the yaw rate references in turn. The driver runs it
+ *          once, sweeps the controller gains over it, or sweeps a motor
+ *          failure over the failed motor and the time the detection of
+ *          motor_failure.h takes:
+ *
+ *            build/sitl              one run, prints a trace every 100 ms
+ *            build/sitl gains        the gain sweep
+ *            build/sitl failsafe     the motor failure sweep
+ *
+ *          The exit status is 1 if the nominal run diverges, so that it can
+ *          gate a change of the flight code.
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "host_port.h"
+
+#include "airframe_sim.h"
+#include "state_estimation.h"
+#include "pid_control.h"
+#include "motor_mixer.h"
+#include "motor_failure.h"
+#include "flight_control.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+typedef struct {
+    float32_t duration;             // [s]
+    uint8_t failedMotor;            // From 0, MIXER_NO_FAILED_MOTOR for none
+    float32_t failureTime;          // [s]
+    float32_t detectionDelay;       // From the failure to the degraded mixer [s], < 0 for no detection
+    bool isTraced;
+} SitlScenario_TypeDef;
+
+typedef struct {
+    float32_t rmsAttitudeError;     // Roll & pitch from the settling on [rad]
+    float32_t rmsEstimationError;   // Roll & pitch estimates from the settling on [rad]
+    float32_t rmsYawRateError;      // From the settling on [rad/s]
+    float32_t rmsAltitudeError;     // From the settling on [m]
+    float32_t maxTilt;              // From the settling on [rad]
+    float32_t touchdownVelocity;    // Down on touchdown after the take-off [m/s]
+    float32_t touchdownTime;        // [s], 0 if still flying
+    bool isDiverged;                // Tilted over SITL_DIVERGED_TILT in the air, or non-finite states
+} SitlResult_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+
+#define SITL_STEP_TIME              (1.0f/HOST_PORT_GYRO_RATE) // [s]
+#define SITL_CONTROL_PERIOD         ((float32_t) FLIGHT_CONTROL_TASK_PERIOD/1000.0f) // [s]
+#define SITL_ACC_PERIOD             (1.0f/200.0f) // Data rate of the LSM303DLHC as lsm303dlhc.c sets it [s]
+#define SITL_ACC_PHASE              (SITL_ACC_PERIOD/2) // The sensors run asynchronous to the prediction timer [s]
+#define SITL_BARO_PERIOD            (1.0f/40.0f) // About the BMP180 at its highest resolution [s]
+#define SITL_BARO_NOISE             ((float32_t) 0.1) // [m] standard deviation
+#define SITL_BARO_SEED              0x9E3779B9
+
+/* Scenario */
+#define SITL_HOVER_ALTITUDE         ((float32_t) 3.0) // [m]
+#define SITL_SETTLE_TIME            ((float32_t) 4.0) // Take-off to the hover altitude [s]
+#define SITL_DURATION               ((float32_t) 10.0) // [s]
+#define SITL_STEP_ANGLE             ((float32_t) 10*PI/180) // Roll & pitch reference steps [rad]
+#define SITL_STEP_YAW_RATE          ((float32_t) 1.0) // Yaw rate reference step [rad/s]
+#define SITL_TRACE_PERIOD           ((float32_t) 0.1) // [s]
+
+/* Outcome limits */
+#define SITL_DIVERGED_TILT          ((float32_t) 60*PI/180) // [rad]
+#define SITL_CRASH_VELOCITY         ((float32_t) 2.0) // Touchdown velocity of a crash [m/s]
+
+/* Motor failure sweep */
+#define SITL_FAILURE_TIME           SITL_SETTLE_TIME // In hover [s]
+#define SITL_FAILURE_DURATION       ((float32_t) 15.0) // Until the touchdown at the latest [s]
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Scales of the gain sweep, applied to K of a controller group */
+static const float32_t gainScales[] = { 0.25f, 0.5f, 0.75f, 1.0f, 1.5f, 2.0f, 3.0f, 4.0f };
+
+/* Controller groups of the gain sweep */
+static const struct {
+    const char* name;
+    PIDControllerIndex_TypeDef first;
+    PIDControllerIndex_TypeDef last;
+} gainGroups[] = {
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+    { "roll & pitch rate", PID_ROLL_RATE_IDX, PID_PITCH_RATE_IDX },
+#endif
+    { "roll & pitch angle", PID_ROLL_ANGLE_IDX, PID_PITCH_ANGLE_IDX },
+    { "yaw rate", PID_YAW_RATE_IDX, PID_YAW_RATE_IDX },
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+    { "altitude & z velocity", PID_ALTITUDE_IDX, PID_Z_VELOCITY_IDX },
+#endif
+};
+
+/* Detection times of the motor failure sweep [s], < 0 for none */
+static const float32_t detectionDelays[] = { -1.0f, 0.05f, MOTOR_FAILURE_DEFAULT_DETECTION_TIME, 0.2f, 0.5f };
+
+/* Private function prototypes -----------------------------------------------*/
+static void InitSitl(AirframeSim_TypeDef* sim, const float32_t gainScale, const PIDControllerIndex_TypeDef first,
+        const PIDControllerIndex_TypeDef last);
+static void RunScenario(const SitlScenario_TypeDef* scenario, const float32_t gainScale,
+        const PIDControllerIndex_TypeDef first, const PIDControllerIndex_TypeDef last, SitlResult_TypeDef* result);
+static void SetScenarioRefSignals(const float32_t time, RefSignals_TypeDef* refSignals);
+static void AllocateMotors(CtrlSignals_TypeDef* ctrlSignals, int32_t motorValues[MIXER_MAX_MOTORS]);
+static bool IsFlying(const SitlResult_TypeDef* result);
+static const char* GetOutcomeName(const SitlResult_TypeDef* result);
+static float32_t RandomNormal(uint32_t* state);
+static int RunNominal(void);
+static void RunGainSweep(void);
+static void RunFailsafeSweep(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        return RunNominal();
+    }
+    if (0 == strcmp(argv[1], "gains")) {
+        RunGainSweep();
+        return 0;
+    }
+    if (0 == strcmp(argv[1], "failsafe")) {
+        RunFailsafeSweep();
+        return 0;
+    }
+
+    fprintf(stderr, "usage: %s [gains|failsafe]\n", argv[0]);
+    return 2;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Runs the scenario once with the default gains and prints the trace and the result
+ * @param  None
+ * @retval 0 if the run stayed upright and in the air, else 1
+ */
+static int RunNominal(void) {
+    const SitlScenario_TypeDef scenario = { SITL_DURATION, MIXER_NO_FAILED_MOTOR, 0.0f, -1.0f, true };
+    SitlResult_TypeDef result;
+
+    RunScenario(&scenario, 1.0f, PID_ROLL_ANGLE_IDX, PID_ROLL_ANGLE_IDX, &result);
+
+    printf("RMS roll & pitch error %.2f deg (estimate %.2f deg), RMS yaw rate error %.2f rad/s, RMS altitude error "
+            "%.2f m, max tilt %.1f deg: %s\n", (double) (result.rmsAttitudeError*180/PI),
+            (double) (result.rmsEstimationError*180/PI), (double) result.rmsYawRateError,
+            (double) result.rmsAltitudeError, (double) (result.maxTilt*180/PI), GetOutcomeName(&result));
+
+    return IsFlying(&result) ? 0 : 1;
+}
+
+/*
+ * @brief  Runs the scenario with K of each controller group scaled by each of gainScales, the other gains at their
+ *         defaults, and prints the tracking errors
+ * @param  None
+ * @retval None
+ */
+static void RunGainSweep(void) {
+    const SitlScenario_TypeDef scenario = { SITL_DURATION, MIXER_NO_FAILED_MOTOR, 0.0f, -1.0f, false };
+    SitlResult_TypeDef result;
+    PIDGains_TypeDef gains;
+    uint8_t group, scale;
+
+    for (group = 0; group < sizeof(gainGroups)/sizeof(gainGroups[0]); group++) {
+        /* A controller that is off by default, e.g. the yaw rate one, has nothing to scale */
+        HostPortReset();
+        InitPIDControllers();
+        (void) GetPIDGains(gainGroups[group].first, &gains);
+        if (0.0f == gains.K) {
+            printf("%s: K is 0, not swept\n", gainGroups[group].name);
+            continue;
+        }
+
+        printf("%s\n  %-6s %12s %12s %14s %10s %9s\n", gainGroups[group].name, "K", "att RMS deg", "est RMS deg",
+                "yaw RMS rad/s", "alt RMS m", "tilt deg");
+
+        for (scale = 0; scale < sizeof(gainScales)/sizeof(gainScales[0]); scale++) {
+            RunScenario(&scenario, gainScales[scale], gainGroups[group].first, gainGroups[group].last, &result);
+            printf("  x%-5.2f %12.2f %12.2f %14.2f %10.2f %9.1f %s\n", (double) gainScales[scale],
+                    (double) (result.rmsAttitudeError*180/PI), (double) (result.rmsEstimationError*180/PI),
+                    (double) result.rmsYawRateError, (double) result.rmsAltitudeError,
+                    (double) (result.maxTilt*180/PI), GetOutcomeName(&result));
+        }
+    }
+}
+
+/*
+ * @brief  Stops each motor in hover with each of detectionDelays until the mixer leaves it out and the references are
+ *         limited to the descent, as motor_failure.c does, and prints how the UAV gets down
+ * @param  None
+ * @retval None
+ */
+static void RunFailsafeSweep(void) {
+    SitlScenario_TypeDef scenario = { SITL_FAILURE_DURATION, 0, SITL_FAILURE_TIME, 0.0f, false };
+    SitlResult_TypeDef result;
+    uint8_t motor, delay;
+
+    printf("%-6s %-10s %10s %14s %12s\n", "motor", "detection", "tilt deg", "touchdown m/s", "fall s");
+
+    for (motor = 0; motor < AIRFRAME_NBR_OF_MOTORS; motor++) {
+        for (delay = 0; delay < sizeof(detectionDelays)/sizeof(detectionDelays[0]); delay++) {
+            scenario.failedMotor = motor;
+            scenario.detectionDelay = detectionDelays[delay];
+            RunScenario(&scenario, 1.0f, PID_ROLL_ANGLE_IDX, PID_ROLL_ANGLE_IDX, &result);
+
+            if (scenario.detectionDelay < 0.0f) {
+                printf("%-6u %-10s", motor + 1, "none");
+            } else {
+                printf("%-6u %-10.2f", motor + 1, (double) scenario.detectionDelay);
+            }
+            printf(" %10.1f %14.2f %12.2f %s\n", (double) (result.maxTilt*180/PI),
+                    (double) result.touchdownVelocity, (double) (result.touchdownTime - scenario.failureTime),
+                    GetOutcomeName(&result));
+        }
+    }
+}
+
+/*
+ * @brief  Initializes the model on the ground and the flight code as at arming, with K of the given controllers scaled
+ * @param  sim : Model instance
+ * @param  gainScale : Scale of K
+ * @param  first : First controller to scale
+ * @param  last : Last controller to scale
+ * @retval None
+ */
+static void InitSitl(AirframeSim_TypeDef* sim, const float32_t gainScale, const PIDControllerIndex_TypeDef first,
+        const PIDControllerIndex_TypeDef last) {
+    AirframeSimConfig_TypeDef config;
+    float32_t initAngles[3] = { 0.0f, 0.0f, 0.0f };
+    PIDGains_TypeDef gains;
+    uint8_t idx;
+
+    AirframeSimGetDefaultConfig(&config);
+    AirframeSimInit(sim, &config);
+
+    HostPortReset();
+    MotorMixerInit();
+    (void) MotorMixerSetFailedMotor(MIXER_NO_FAILED_MOTOR);
+    InitEstimatorNoise();
+    InitPIDControllers();
+
+    for (idx = first; idx <= last; idx++) {
+        (void) GetPIDGains((PIDControllerIndex_TypeDef) idx, &gains);
+        gains.K *= gainScale;
+        (void) SetPIDGains((PIDControllerIndex_TypeDef) idx, &gains);
+    }
+    ResetPIDControllers();
+
+    InitStatesXYZ(initAngles);
+}
+
+/*
+ * @brief  Runs a scenario from the ground
+ * @param  scenario : Duration, motor failure and trace
+ * @param  gainScale : Scale of K of the controllers first to last
+ * @param  first : First controller to scale
+ * @param  last : Last controller to scale
+ * @param  result : Destination tracking errors and outcome
+ * @retval None
+ */
+static void RunScenario(const SitlScenario_TypeDef* scenario, const float32_t gainScale,
+        const PIDControllerIndex_TypeDef first, const PIDControllerIndex_TypeDef last, SitlResult_TypeDef* result) {
+    static AirframeSim_TypeDef sim;
+    RefSignals_TypeDef refSignals;
+    CtrlSignals_TypeDef ctrlSignals;
+    int32_t motorValues[MIXER_MAX_MOTORS];
+    float32_t gyro[3], acc[3], attitude[3];
+    const float32_t mag[3] = { 0.0f, 0.0f, 0.0f };
+    float32_t nextPrediction = 0.0f, nextAcc = SITL_ACC_PHASE, nextBaro = 0.0f, nextTrace = 0.0f;
+    float32_t altitude, altitudeHoldRef, tilt, prevVelocity;
+    float32_t attitudeErrorSum = 0.0f, estimationErrorSum = 0.0f, yawRateErrorSum = 0.0f, altitudeErrorSum = 0.0f;
+    bool isPredictionDue, isAirborne = false, isDetected = false;
+    uint32_t timestamp, samples = 0;
+    uint32_t baroNoiseState = SITL_BARO_SEED;
+
+    InitSitl(&sim, gainScale, first, last);
+    memset(result, 0, sizeof(SitlResult_TypeDef));
+    memset(&refSignals, 0, sizeof(refSignals));
+    memset(motorValues, 0, sizeof(motorValues));
+    ResetCtrlSignals(&ctrlSignals);
+    altitudeHoldRef = -SITL_HOVER_ALTITUDE;
+
+    while (sim.time < scenario->duration) {
+        AirframeSimGetSensors(&sim, gyro, acc);
+        timestamp = HOST_PORT_TIMESTAMP(sim.time);
+        HostPortSetTimestamp(timestamp);
+        HostPortSetSensors(gyro, acc, mag);
+
+        isPredictionDue = (sim.time >= nextPrediction);
+        if (isPredictionDue) {
+            nextPrediction += SITL_CONTROL_PERIOD;
+        }
+
+        /* The gyroscope correction and the inner loop on every sample */
+        UpdateCorrectionState(GYRO_IDX, gyro, timestamp);
+#ifdef PID_USE_CASCADED_RATE_CONTROL
+        UpdatePIDRateControlSignals(&ctrlSignals);
+        AllocateMotors(&ctrlSignals, motorValues);
+#endif
+
+        if (sim.time >= nextAcc) {
+            UpdateCorrectionState(ACC_IDX, acc, timestamp);
+            nextAcc += SITL_ACC_PERIOD;
+        }
+        if (sim.time >= nextBaro) {
+            altitude = -sim.position[2] + SITL_BARO_NOISE*RandomNormal(&baroNoiseState);
+            UpdateCorrectionState(BARO_IDX, &altitude, timestamp);
+            nextBaro += SITL_BARO_PERIOD;
+        }
+
+        if (isPredictionDue) {
+            UpdatePredictionStateAt(timestamp);
+        }
+        PublishStateSnapshot();
+
+        /* The outer loop of the altitude hold mode, see SetAltitudeHoldRefSignals() of flight_control.c */
+        if (isPredictionDue) {
+            SetScenarioRefSignals(sim.time, &refSignals);
+            if (isDetected) {
+                /* As LimitMotorFailureRefSignals() */
+                refSignals.zVelocity = fmaxf(refSignals.zVelocity, MOTOR_FAILURE_DESCENT_VELOCITY);
+                refSignals.rollAngle = fmaxf(-MOTOR_FAILURE_MAX_TILT, fminf(refSignals.rollAngle, MOTOR_FAILURE_MAX_TILT));
+                refSignals.pitchAngle = fmaxf(-MOTOR_FAILURE_MAX_TILT, fminf(refSignals.pitchAngle, MOTOR_FAILURE_MAX_TILT));
+                refSignals.yawAngleRate = 0.0f;
+            }
+#ifdef PID_USE_VERTICAL_VELOCITY_CONTROL
+            if (0.0f != refSignals.zVelocity) {
+                altitudeHoldRef = GetZPosition();
+            }
+            refSignals.zVelocity = fmaxf(-(float32_t) DEFAULT_MAX_Z_VELOCITY, fminf(refSignals.zVelocity
+                    + UpdatePIDAltitudeControl(altitudeHoldRef), (float32_t) DEFAULT_MAX_Z_VELOCITY));
+#endif
+            HostPortSetFlightControl(FLIGHT_CONTROL_ALTITUDE_HOLD, &refSignals, &ctrlSignals);
+            UpdatePIDControlSignals(&ctrlSignals);
+#ifndef PID_USE_CASCADED_RATE_CONTROL
+            AllocateMotors(&ctrlSignals, motorValues);
+#endif
+        }
+
+        /* The failed motor stops, the mixer leaves it out once it is detected */
+        if (MIXER_NO_FAILED_MOTOR != scenario->failedMotor && sim.time >= scenario->failureTime) {
+            motorValues[scenario->failedMotor] = 0;
+            if (!isDetected && scenario->detectionDelay >= 0.0f
+                    && sim.time >= scenario->failureTime + scenario->detectionDelay) {
+                isDetected = (FCB_OK == MotorMixerSetFailedMotor(scenario->failedMotor));
+            }
+        }
+
+        prevVelocity = sim.velocity[2];
+        AirframeSimStep(&sim, motorValues, SITL_STEP_TIME);
+
+        /* Outcome, from the true states of the model */
+        AirframeSimGetAttitude(&sim, attitude);
+        tilt = acosf(fmaxf(-1.0f, fminf(cosf(attitude[0])*cosf(attitude[1]), 1.0f)));
+        if (!isfinite(tilt) || !isfinite(sim.position[2])) {
+            result->isDiverged = true;
+            break;
+        }
+        if (!sim.onGround) {
+            isAirborne = true;
+        } else if (isAirborne) {
+            /* A run is over on the touchdown after the take-off */
+            result->touchdownVelocity = prevVelocity;
+            result->touchdownTime = sim.time;
+            break;
+        }
+        if (tilt > SITL_DIVERGED_TILT) {
+            result->isDiverged = true;
+        }
+        if (sim.time >= SITL_SETTLE_TIME) {
+            attitudeErrorSum += (attitude[0] - refSignals.rollAngle)*(attitude[0] - refSignals.rollAngle)
+                    + (attitude[1] - refSignals.pitchAngle)*(attitude[1] - refSignals.pitchAngle);
+            estimationErrorSum += (attitude[0] - GetRollAngle())*(attitude[0] - GetRollAngle())
+                    + (attitude[1] - GetPitchAngle())*(attitude[1] - GetPitchAngle());
+            yawRateErrorSum += (sim.angleRate[2] - refSignals.yawAngleRate)*(sim.angleRate[2] - refSignals.yawAngleRate);
+            altitudeErrorSum += (sim.position[2] + SITL_HOVER_ALTITUDE)*(sim.position[2] + SITL_HOVER_ALTITUDE);
+            samples++;
+            result->maxTilt = fmaxf(result->maxTilt, tilt);
+        }
+
+        if (scenario->isTraced && sim.time >= nextTrace) {
+            printf("t %5.2f  alt %5.2f (est %5.2f)  roll %6.2f (ref %6.2f)  pitch %6.2f (ref %6.2f)  yaw rate %5.2f"
+                    "  est roll %6.2f pitch %6.2f\n", (double) sim.time, (double) -sim.position[2],
+                    (double) -GetZPosition(), (double) (attitude[0]*180/PI), (double) (refSignals.rollAngle*180/PI),
+                    (double) (attitude[1]*180/PI), (double) (refSignals.pitchAngle*180/PI),
+                    (double) sim.angleRate[2], (double) (GetRollAngle()*180/PI), (double) (GetPitchAngle()*180/PI));
+            nextTrace += SITL_TRACE_PERIOD;
+        }
+    }
+
+    if (samples > 0) {
+        result->rmsAttitudeError = sqrtf(attitudeErrorSum/(2*samples));
+        result->rmsEstimationError = sqrtf(estimationErrorSum/(2*samples));
+        result->rmsYawRateError = sqrtf(yawRateErrorSum/samples);
+        result->rmsAltitudeError = sqrtf(altitudeErrorSum/samples);
+    }
+}
+
+/*
+ * @brief  Sets the references of the scenario: the climb to the hover altitude, which the altitude controller does,
+ *         then a roll step, a pitch step and a yaw rate step of a second each
+ * @param  time : Scenario time [s]
+ * @param  refSignals : Destination references
+ * @retval None
+ */
+static void SetScenarioRefSignals(const float32_t time, RefSignals_TypeDef* refSignals) {
+    memset(refSignals, 0, sizeof(RefSignals_TypeDef));
+
+    if (time >= SITL_SETTLE_TIME && time < SITL_SETTLE_TIME + 1.0f) {
+        refSignals->rollAngle = SITL_STEP_ANGLE;
+    } else if (time >= SITL_SETTLE_TIME + 2.0f && time < SITL_SETTLE_TIME + 3.0f) {
+        refSignals->pitchAngle = -SITL_STEP_ANGLE;
+    } else if (time >= SITL_SETTLE_TIME + 4.0f && time < SITL_SETTLE_TIME + 5.0f) {
+        refSignals->yawAngleRate = SITL_STEP_YAW_RATE;
+    }
+}
+
+/*
+ * @brief  Allocates the control signals to the motors as MotorAllocationPhysical() of motor_control.c at the nominal
+ *         battery voltage, and feeds the achieved moments back to the moment controllers. The thrust curve is left
+ *         out, as the motors of the model are the linear fit the mixer inverts.
+ * @param  ctrlSignals : Control signals
+ * @param  motorValues : Destination motor signal values
+ * @retval None
+ */
+static void AllocateMotors(CtrlSignals_TypeDef* ctrlSignals, int32_t motorValues[MIXER_MAX_MOTORS]) {
+    const float32_t u[MIXER_AXES_NBR] = { ctrlSignals->thrust, ctrlSignals->rollMoment, ctrlSignals->pitchMoment,
+            ctrlSignals->yawMoment };
+    float32_t achieved[MIXER_AXES_NBR];
+    float32_t achievedMoments[3];
+
+    MotorMixerPhysical(u, motorValues, achieved);
+
+    achievedMoments[0] = achieved[MIXER_ROLL_IDX];
+    achievedMoments[1] = achieved[MIXER_PITCH_IDX];
+    achievedMoments[2] = achieved[MIXER_YAW_IDX];
+    ApplyPIDAllocationFeedback(ctrlSignals, achievedMoments);
+}
+
+/*
+ * @brief  Checks if a run ended upright in the air
+ * @param  result : Result of the run
+ * @retval true if flying, else false
+ */
+static bool IsFlying(const SitlResult_TypeDef* result) {
+    return !result->isDiverged && 0.0f == result->touchdownTime;
+}
+
+/*
+ * @brief  Gets the outcome of a run: flying, diverged in the air, landed, or crashed tilted over or down too fast
+ * @param  result : Result of the run
+ * @retval Name of the outcome
+ */
+static const char* GetOutcomeName(const SitlResult_TypeDef* result) {
+    if (0.0f == result->touchdownTime) {
+        return result->isDiverged ? "DIVERGED" : "FLYING";
+    }
+
+    return (result->isDiverged || result->touchdownVelocity > SITL_CRASH_VELOCITY) ? "CRASHED" : "LANDED";
+}
+
+/*
+ * @brief  Draws from an approximately standard normal distribution, the sum of 12 uniform xorshift draws
+ * @param  state : Generator state, not zero
+ * @retval Sample
+ */
+static float32_t RandomNormal(uint32_t* state) {
+    float32_t sum = 0.0f;
+    uint8_t i;
+
+    for (i = 0; i < 12; i++) {
+        *state ^= *state << 13;
+        *state ^= *state >> 17;
+        *state ^= *state << 5;
+        sum += (float32_t) *state/UINT32_MAX;
+    }
+
+    return sum - 6.0f;
+}
@@ -11,7 +11,9 @@
 
 #include "fcb_retval.h"
 #include "fcb_sensors.h"
+#include "fcb_sensor_calibration.h"
 #include "stm32f3_discovery.h"
+#include "param_table.h"
 
 #include "arm_math.h"
 #include <stdint.h>
@@ -32,6 +34,44 @@
  */
 #define GPIO_ACCELEROMETER_DRDY GPIO_PIN_4
 
+/**
+ * Uncomment to run the accelerometer at a higher data rate with the
+ * LSM303DLHC FIFO in stream mode. The FIFO watermark interrupt then
+ * replaces data ready on the same pin and all samples in the FIFO
+ * are read with one multi-byte read.
+ */
+//#define FCB_ACC_FIFO_MODE
+
+/**
+ * FIFO level that triggers a batch read in FCB_ACC_FIFO_MODE, i.e.
+ * the typical number of samples per batch.
+ */
+#define ACC_FIFO_WATERMARK 16
+
+/**
+ * Default output data rate of the magnetometer. Heading drifts slowly, so a rate
+ * well below the 220 Hz maximum keeps the I2C bus load of the magnetometer
+ * reads low.
+ */
+#define MAG_OUTPUT_DATA_RATE LSM303DLHC_ODR_75_HZ
+
+/**
+ * Number of magnetometer samples averaged into one published sample. The
+ * calibration, the clients and the yaw correction run at the output data
+ * rate divided by this, see R1_MAG. 1 publishes every sample.
+ */
+#define MAG_DECIMATION 3
+
+/**
+ * Max number of samples passed to the client callback per accelerometer
+ * interrupt. Clients queueing the samples should dimension for this.
+ */
+#ifdef FCB_ACC_FIFO_MODE
+#define ACC_MAX_SAMPLES_PER_READ 32 /* LSM303DLHC acc FIFO size */
+#else
+#define ACC_MAX_SAMPLES_PER_READ 1
+#endif
+
 /**
  *
  */
@@ -51,6 +91,16 @@ enum FcbAccMagMode {
  */
 uint8_t FcbInitialiseAccMagSensor(void);
 
+/**
+ * Registers the calibration solver with the low priority deferred worker and
+ * creates its job queue and job pool. Called at startup, before the scheduler
+ * is started, so that a calibration does not allocate from the FreeRTOS heap
+ * in flight.
+ *
+ * @retval FCB_OK, FCB_ERR_INIT otherwise
+ */
+uint8_t FcbInitAccMagCalibrationSolver(void);
+
 
 uint8_t SensorRegisterAccClientCallback(SendCorrectionUpdateCallback_TypeDef cbk);
 
@@ -71,10 +121,21 @@ void FetchDataFromAccelerometer(void);
  *
  * @note samples param is intended for future use
  *
+ * @note The calibration of each sensor is solved by a low priority task once
+ *       its samples are taken, the new values are saved to flash and used
+ *       from when the task is done.
+ *
  * @see ACCMAG_CALIBRATION_SAMPLES_N
  */
 void StartAccMagMtrCalibration(uint32_t samples);
 
+/**
+ * @return true once the sensors are initialised and no calibration samples
+ *         are being taken, i.e. GetAcceleration and GetMagVector return
+ *         calibrated values. Checked before arming.
+ */
+bool IsAccMagCalibrated(void);
+
 
 /*
  * get the current calibrated reading from the accelerometer.
@@ -90,7 +151,7 @@ void GetAcceleration(float32_t * xDotDot, float32_t * yDotDot, float32_t * zDotD
 
 
 /**
- * As GetAcceleration bus does not take/release mutex. This function
+ * As GetAcceleration but does not check the sequence lock. This function
  * is OK to use from the tFcbThread context like inside a FcbSensorCbk
  * function
   */
@@ -104,6 +165,67 @@ void GetAccelerationNoMutex(float32_t * xDotDot, float32_t * yDotDot, float32_t
 void FetchDataFromMagnetometer(void);
 
 
+/**
+ * Queues a non-blocking read of the accelerometer. The read is
+ * started directly if the I2C bus is idle, else chained after the
+ * ongoing read. Completion is signalled with a
+ * FCB_SENSOR_ACC_READ_COMPLETE message.
+ */
+void RequestDataFromAccelerometer(void);
+
+
+/**
+ * As RequestDataFromAccelerometer but for the magnetometer,
+ * completion is signalled with FCB_SENSOR_MAGNETO_READ_COMPLETE.
+ */
+void RequestDataFromMagnetometer(void);
+
+
+/**
+ * Processes the data of a completed non-blocking read and starts the
+ * next queued read. Called on FCB_SENSOR_ACC_READ_COMPLETE and
+ * FCB_SENSOR_MAGNETO_READ_COMPLETE.
+ */
+void HandleAccMagReadComplete(void);
+
+
+/**
+ * Signals completion of a non-blocking read to the SENSORS task.
+ * Called from the I2C receive complete ISR.
+ */
+void AccMagReadCompleteFromISR(void);
+
+
+/**
+ * Signals a failed non-blocking read to the SENSORS task, which
+ * retries with a blocking read. Called from the I2C error ISR.
+ */
+void AccMagReadErrorFromISR(void);
+
+
+/**
+ * Runs a recovery step of a stalled accelerometer or magnetometer,
+ * called by the sensor watchdog. Both share the I2C1 bus, so a bus
+ * reset also restarts the read of the other.
+ *
+ * @param sensor ACC_IDX or MAG_IDX
+ * @param step see FcbSensorRecoveryType
+ */
+void RecoverAccMagSensor(FcbSensorIndexType sensor, FcbSensorRecoveryType step);
+
+/**
+ * Reconfigures the accelerometer or the magnetometer with the data rate and
+ * high-pass cutoff nearest to the requested ones, which are written back.
+ * Called by the sensors task.
+ *
+ * @param sensor ACC_IDX or MAG_IDX
+ * @param dataRateHz data rate [Hz]
+ * @param highPassHz high-pass cutoff [Hz], 0 for off, always off for MAG_IDX
+ * @retval FCB_OK, or FCB_ERR if not supported
+ */
+uint8_t SetAccMagRates(FcbSensorIndexType sensor, float32_t * dataRateHz, float32_t * highPassHz);
+
+
 /*
  * get the current reading from the magnetometer.
  *
@@ -122,7 +244,7 @@ void GetMagVector(float32_t * x, float32_t * y, float32_t * z);
 
 
 /**
- * As GetMagVector bus does not take/release mutex. This function
+ * As GetMagVector but does not check the sequence lock. This function
  * is OK to use from the tFcbThread context like inside a FcbSensorCbk
  * function
   */
@@ -134,6 +256,52 @@ void GetMagVectorNoMutex(float32_t * x, float32_t * y, float32_t * z);
  */
 void PrintAccelerometerValues(void);
 
+/**
+ * Gets the magnetometer calibration parameters, for the parameter table.
+ *
+ * MAG_ONLINE_CAL enables the in-flight refinement of the magnetometer
+ * offset, which is saved to flash when disarmed.
+ */
+const ParamGroup_TypeDef* GetMagCalibrationParamGroup(void);
+
+/**
+ * Fuses a new mounting rotation and trim into the calibrations, see
+ * fcb_sensor_orientation.h. Called with the scheduler suspended.
+ */
+void UpdateAccMagOrientation(void);
+
+/*
+ * Get the last read LSM303DLHC die temperature [deg C /
+ * LSM303DLHC_TEMP_SENSITIVITY]. The temperature has a part specific offset,
+ * so it is relative and only used by the temperature compensation.
+ */
+int16_t GetAccMagTemperature(void);
+
+/*
+ * Get a copy of the accelerometer and magnetometer offset and scale vs
+ * temperature points. Each calibration adds a point at its temperature, and
+ * once a sensor has points spread over ACCMAG_TEMP_COMP_MIN_SPREAD the per
+ * axis slopes fitted through them correct the raw samples to the temperature
+ * of its calibration in use. When enabled.
+ */
+void GetAccMagTempCompensation(FcbAccMagTempCompensationType* dstCompensation);
+
+/*
+ * Enables or disables the temperature compensation and saves the setting to
+ * flash. Idle mode only.
+ *
+ * @retval FCB_OK, error otherwise
+ */
+FcbRetValType SetAccMagTempCompensationEnabled(uint8_t enable);
+
+/*
+ * Clears all points of the temperature compensation but those of the
+ * calibrations in use, and saves it to flash. Idle mode only.
+ *
+ * @retval FCB_OK, error otherwise
+ */
+FcbRetValType ClearAccMagTempCompensation(void);
+
 #endif /* FCB_ACCELEROMETER_H */
 
 /**
@@ -9,13 +9,115 @@
 #define INC_FCB_BAROMETER_H_
 
 #include <stdint.h>
+#include <stddef.h>
 #include <arm_math.h>
 #include "fcb_sensors.h"
+#include "fcb_retval.h"
+#include "stm32f3xx_hal.h"
+
+/*
+ * The BMP180 is run by a state machine in the SENSORS task. A conversion is
+ * started with a non-blocking I2C write, the conversion timer is started when
+ * the write completes and runs for the conversion time of the measurement,
+ * then the result is read with a non-blocking I2C read. The next conversion is
+ * started as soon as a read completes, so pressures follow each other at the
+ * conversion time of the over sampling setting. The temperature the pressures
+ * are compensated with is refreshed every temperature period only.
+ */
+
+/* Pressure over sampling setting at startup, 0 to BMP180_OSS_MAX, see SetBarometerConfig */
+#define BAROMETER_DEFAULT_OSS                   0
+/* Temperature refresh period at startup [ms] */
+#define BAROMETER_DEFAULT_TEMPERATURE_PERIOD    1000
+#define BAROMETER_MAX_TEMPERATURE_PERIOD        10000 // [ms]
+
+/* Standard sea level pressure, the altitude reference at startup [Pa] */
+#define BAROMETER_STANDARD_PRESSURE             101325.0f
+/* Range of a fixed reference pressure, see SetBarometerReference [Pa] */
+#define BAROMETER_MIN_REFERENCE_PRESSURE        80000
+#define BAROMETER_MAX_REFERENCE_PRESSURE        110000
+/* Low-pass filter coefficient of the arming reference, per pressure sample */
+#define BAROMETER_ARMING_REFERENCE_ALPHA        0.02f
+
+/* The barometer is restarted when its state machine did not step for this long [ms] */
+#define BAROMETER_TIMEOUT                       100
+/* Wait before the next conversion after a failed transfer [ms] */
+#define BAROMETER_RETRY_DELAY                   10
+
+/* Conversion timer, one pulse at 1 MHz */
+#define BAROMETER_TIM                           TIM16
+#define BAROMETER_TIM_CLK_ENABLE()              __TIM16_CLK_ENABLE()
+#define BAROMETER_TIM_CLK_DISABLE()             __TIM16_CLK_DISABLE()
+#define BAROMETER_TIM_IRQn                      TIM1_UP_TIM16_IRQn
+#define BAROMETER_TIM_IRQHandler                TIM1_UP_TIM16_IRQHandler
+#define BAROMETER_TIM_IRQ_PREEMPT_PRIO          6 // Signals the RTOS, see configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY
+#define BAROMETER_TIM_IRQ_SUB_PRIO              0
+
+/**
+ * Reference pressure the altitude is computed against
+ */
+typedef enum {
+    BAROMETER_REFERENCE_STANDARD = 0,   /* BAROMETER_STANDARD_PRESSURE, altitude above sea level */
+    BAROMETER_REFERENCE_FIXED,          /* a set pressure, e.g. the local QNH */
+    BAROMETER_REFERENCE_ARMING          /* the pressure filtered in idle mode, frozen when leaving it */
+} BarometerReferenceType;
+
+/**
+ * Configuration and statistics of the barometer, the statistics are cleared
+ * when the configuration is changed.
+ */
+typedef struct FcbBarometerStats {
+    uint8_t oss;                    /* pressure over sampling setting */
+    uint32_t temperaturePeriod;     /* [ms] */
+    BarometerReferenceType reference;
+    float32_t referencePressure;    /* current [Pa] */
+    uint32_t pressureSamples;
+    uint32_t temperatureSamples;
+    uint32_t failures;              /* failed transfers, retried after BAROMETER_RETRY_DELAY */
+    uint32_t timeouts;              /* restarts after BAROMETER_TIMEOUT */
+    uint32_t busRecoveries;         /* bus resets after a stuck bus or a bus error */
+    uint32_t duration;              /* since the statistics were cleared [ms] */
+    int32_t temperature;            /* last read [0.1 deg C] */
+    float32_t altitude;             /* last computed [m] */
+} FcbBarometerStatsType;
+
+extern TIM_HandleTypeDef BarometerTimHandle;
 
 uint8_t FcbInitialiseBarometer(void);
 uint8_t SensorRegisterBaroClientCallback(SendCorrectionUpdateCallback_TypeDef cbk);
 
-void FetchDataFromBarometer(void);
+void RequestDataFromBarometer(void);
+void HandleBarometerReadComplete(void);
+void CheckBarometerTimeout(void);
+
+void BarometerConversionStartedFromISR(void);
+void BarometerTimerElapsedFromISR(void);
+void BarometerReadCompleteFromISR(void);
+void BarometerReadErrorFromISR(void);
+
+/**
+ * Sets the pressure over sampling and the temperature refresh period, taken
+ * into use from the next conversion.
+ *
+ * @param oss 0 to BMP180_OSS_MAX
+ * @param temperaturePeriod [ms] 1 to BAROMETER_MAX_TEMPERATURE_PERIOD
+ * @return FCB_OK, FCB_ERR if out of range or not in idle mode
+ */
+FcbRetValType SetBarometerConfig(const uint8_t oss, const uint32_t temperaturePeriod);
+
+/**
+ * Sets the reference pressure of the altitude, the arming reference restarts
+ * from the next pressure.
+ *
+ * @param reference see BarometerReferenceType
+ * @param pressure [Pa] BAROMETER_MIN_REFERENCE_PRESSURE to BAROMETER_MAX_REFERENCE_PRESSURE, used for BAROMETER_REFERENCE_FIXED only
+ * @return FCB_OK, FCB_ERR if out of range or not in idle mode
+ */
+FcbRetValType SetBarometerReference(const BarometerReferenceType reference, const uint32_t pressure);
+
+void GetBarometerStats(FcbBarometerStatsType * dstStats);
+size_t PrintBarometerStats(char * dst, const size_t dstSize);
+
 void GetAltitude(float32_t * alt);
 
 #endif /* INC_FCB_BAROMETER_H_ */
@@ -0,0 +1,143 @@
+#ifndef FCB_BATTERY_H
+#define FCB_BATTERY_H
+
+#include "fcb_retval.h"
+#include "stm32f3xx_hal.h"
+#include "arm_math.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @file fcb_battery.h
+ *
+ * Battery monitor on ADC3. The pack voltage, through a divider, and the
+ * output of an optional current sensor are converted continuously into a
+ * circular DMA buffer of BATTERY_ADC_OVERSAMPLING conversions per channel.
+ * The F303 ADC has no hardware oversampling, so the whole buffer is averaged
+ * when the monitor is updated, which costs no interrupts at all.
+ *
+ * The flight control task updates the monitor every BATTERY_UPDATE_PERIOD.
+ * The thrust of the fitted motor signal falls with about the square of the
+ * pack voltage, so the motor allocation scales the commanded forces and
+ * moments by (nominal/filtered voltage)^2, see
+ * GetBatteryThrustCompensation(), and the thrust and the tuning hold as the
+ * pack sags.
+ *
+ * The cell count is detected from the first connected voltage. Below
+ * BATTERY_LOW_CELL_VOLTAGE for BATTERY_LEVEL_DELAY the battery is low, a
+ * warning. Below BATTERY_CRITICAL_CELL_VOLTAGE it is critical and the flight
+ * control does not leave idle mode. A battery going critical in flight does
+ * not stop the motors, which would drop the UAV.
+ */
+
+/* Uncomment when the battery voltage divider is connected to BATTERY_VOLTAGE_PIN, to run the battery monitor and
+ * the thrust compensation */
+//#define FCB_BATTERY_MONITOR
+
+/* Uncomment when a current sensor is connected to BATTERY_CURRENT_PIN as well, to measure the consumed charge */
+//#define FCB_BATTERY_CURRENT_SENSOR
+
+/* Uncomment with FCB_BATTERY_MONITOR to take the voltage and the current from the BatteryInfo of a DroneCAN power
+ * module instead of ADC3, see dronecan.h */
+//#define BATTERY_INPUT_IS_DRONECAN
+
+#if defined(BATTERY_INPUT_IS_DRONECAN) && defined(FCB_BATTERY_CURRENT_SENSOR)
+#error "BATTERY_INPUT_IS_DRONECAN measures the current with the power module, not with FCB_BATTERY_CURRENT_SENSOR"
+#endif
+
+/* Battery voltage on PB1 (ADC3_IN1) and current on PB0 (ADC3_IN12), the ADC3 DMA request is on DMA2 channel 5 */
+#define BATTERY_ADC                             ADC3
+#define BATTERY_ADC_CLK_ENABLE()                __ADC34_CLK_ENABLE()
+#define BATTERY_ADC_DMA_CLK_ENABLE()            __DMA2_CLK_ENABLE()
+#define BATTERY_ADC_DMA_CHANNEL                 DMA2_Channel5 // ADC3 request, its interrupts are not used
+#define BATTERY_GPIO_CLK_ENABLE()               __GPIOB_CLK_ENABLE()
+#define BATTERY_GPIO_PORT                       GPIOB
+#define BATTERY_VOLTAGE_PIN                     GPIO_PIN_1
+#define BATTERY_VOLTAGE_ADC_CHANNEL             ADC_CHANNEL_1
+#define BATTERY_CURRENT_PIN                     GPIO_PIN_0
+#define BATTERY_CURRENT_ADC_CHANNEL             ADC_CHANNEL_12
+
+#ifdef FCB_BATTERY_CURRENT_SENSOR
+#define BATTERY_ADC_CHANNELS                    2
+#else
+#define BATTERY_ADC_CHANNELS                    1
+#endif
+
+/* At 18 MHz and 601.5 sampling cycles, for the source impedance of the divider, a conversion takes 34 us and an
+ * update averages the last 2-4 ms */
+#define BATTERY_ADC_OVERSAMPLING                64      // Conversions per channel averaged by an update
+#define BATTERY_ADC_REFERENCE                   3.3f    // [V]
+#define BATTERY_ADC_FULL_SCALE                  4095.0f
+#define BATTERY_VOLTAGE_SCALE                   11.0f   // Divider ratio, 10k over 1k, up to 36 V
+#define BATTERY_CURRENT_SCALE                   17.0f   // [A/V] of the current sensor output
+#define BATTERY_CURRENT_OFFSET                  0.0f    // [V] current sensor output at 0 A
+
+#define BATTERY_UPDATE_PERIOD                   20      // [ms]
+#define BATTERY_VOLTAGE_TIME_CONSTANT           0.2f    // [s] of the filtered voltage
+#define BATTERY_MIN_CONNECTED_VOLTAGE           5.0f    // [V] below it the FCB is powered from USB only
+
+#define BATTERY_MAX_CELL_VOLTAGE                4.35f   // [V] for the cell count detection
+#define BATTERY_NOMINAL_CELL_VOLTAGE            3.8f    // [V] the motor thrust fits are valid at
+#define BATTERY_LOW_CELL_VOLTAGE                3.5f    // [V]
+#define BATTERY_CRITICAL_CELL_VOLTAGE           3.3f    // [V]
+#define BATTERY_LEVEL_HYSTERESIS                0.1f    // [V] per cell above a level to leave it
+#define BATTERY_LEVEL_DELAY                     2000    // [ms] below a level to enter it, a throttle punch sags too
+
+/* Limits of the force scaling, around a full and an empty pack */
+#define BATTERY_MIN_THRUST_COMPENSATION         0.8f
+#define BATTERY_MAX_THRUST_COMPENSATION         1.4f
+
+typedef enum {
+    BATTERY_NOT_CONNECTED = 0,  /* or not measured */
+    BATTERY_OK,
+    BATTERY_LOW,                /* warning */
+    BATTERY_CRITICAL            /* no arming */
+} FcbBatteryStatusType;
+
+/**
+ * State of the battery monitor
+ */
+typedef struct FcbBatteryState {
+    FcbBatteryStatusType status;
+    uint8_t cells;              /* detected, 0 while not connected */
+    float32_t voltage;          /* filtered [V] */
+    float32_t rawVoltage;       /* average of the latest update [V] */
+    float32_t current;          /* [A], 0 without FCB_BATTERY_CURRENT_SENSOR */
+    float32_t consumed;         /* since the battery was connected [mAh] */
+    float32_t thrustCompensation; /* factor of the commanded forces */
+} FcbBatteryStateType;
+
+#ifdef FCB_BATTERY_MONITOR
+#define BATTERY_THRUST_COMPENSATION()           GetBatteryThrustCompensation()
+#else
+#define BATTERY_THRUST_COMPENSATION()           (1.0f)
+#endif
+
+/**
+ * Calibrates the ADC and starts the continuous conversions. Called by the
+ * SENSORS task.
+ *
+ * @return FCB_OK, FCB_ERR_INIT if the ADC could not be started
+ */
+FcbRetValType FcbInitialiseBattery(void);
+
+/**
+ * Averages the converted samples and updates the state, every
+ * BATTERY_UPDATE_PERIOD. Called by the flight control task on every control
+ * cycle.
+ */
+void BatteryMonitorUpdate(void);
+
+/**
+ * @return factor to scale the commanded thrust force and moments with, 1 if
+ * no battery is connected
+ */
+float32_t GetBatteryThrustCompensation(void);
+
+FcbBatteryStatusType GetBatteryStatus(void);
+void GetBatteryState(FcbBatteryStateType * dstState);
+size_t PrintBatteryState(char * dst, const size_t dstSize);
+
+#endif /* FCB_BATTERY_H */
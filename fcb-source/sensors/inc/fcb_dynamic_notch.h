@@ -0,0 +1,96 @@
+#ifndef FCB_DYNAMIC_NOTCH_H
+#define FCB_DYNAMIC_NOTCH_H
+
+#include "fcb_retval.h"
+#include "arm_math.h"
+#include "ram_func.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @file fcb_dynamic_notch.h
+ *
+ * Notches on the gyroscope samples that follow the dominant vibration peaks
+ * found by a spectral analysis of the samples, for builds without the motor
+ * telemetry of the RPM filter, or to catch frame resonances it does not.
+ *
+ * The gyroscope context collects DYN_NOTCH_FFT_SIZE samples of the notch
+ * input, after the sensor and RPM filters, into a frame and leaves it to the
+ * analysis. The flight control task posts the analysis to the high priority
+ * deferred worker, which windows each axis, runs arm_rfft_fast_f32 and takes
+ * the DYN_NOTCH_PEAKS highest local maxima of the power spectrum within
+ * [DYN_NOTCH_MIN_HZ, DYN_NOTCH_MAX_NYQUIST_FRACTION of the Nyquist frequency]
+ * and DYN_NOTCH_MIN_PEAK_RATIO over the mean power of that band. A new frame
+ * is only collected once the previous one has been analysed, so at most one
+ * analysis of 3 FFTs runs per frame period.
+ *
+ * The notch centers move towards the peaks by at most DYN_NOTCH_MAX_STEP_HZ
+ * per analysis and hold when no peak is found. The coefficients are
+ * published double-buffered and taken by the gyroscope context between two
+ * samples, with the notch state kept, so a retune does not glitch the
+ * filtered rates. The cost in the gyroscope context is 3*DYN_NOTCH_PEAKS
+ * biquads per sample at most.
+ */
+
+/* Uncomment to run the notches that track the gyroscope spectrum */
+//#define FCB_DYNAMIC_NOTCH
+
+#define DYN_NOTCH_FFT_SIZE                      256     // The FFT tables are set up for 256, 3 Hz bins and 0.34 s frames at 760 Hz
+#define DYN_NOTCH_PEAKS                         2       // Notches per axis
+#define DYN_NOTCH_Q                             4.0f
+#define DYN_NOTCH_MIN_HZ                        80.0f   // Below it the airframe motion, which must not be notched
+#define DYN_NOTCH_MAX_NYQUIST_FRACTION          0.9f
+#define DYN_NOTCH_MIN_PEAK_RATIO                5.0f    // Power of a peak over the mean power of the band
+#define DYN_NOTCH_SMOOTHING                     0.5f    // Weight of a new peak in its notch center
+#define DYN_NOTCH_MAX_STEP_HZ                   20.0f   // Max move of a notch center per analysis
+#define DYN_NOTCH_LOG_CHANGE_HZ                 10.0f   // A notch center is logged when moved this far from its last log
+
+/**
+ * Statistics of the analysis, cleared by ResetDynamicNotchStats()
+ */
+typedef struct FcbDynamicNotchStats {
+    uint32_t analyses;
+    uint32_t peaks;             /* found by the analyses, all axes */
+    uint32_t lastCycles;        /* of the latest analysis, including any preemption [core clock cycles] */
+    uint32_t maxCycles;         /* [core clock cycles] */
+    uint64_t sumCycles;         /* [core clock cycles] */
+    uint64_t startTimestamp;    /* for the duty cycle of the analysis [core clock cycles] */
+} FcbDynamicNotchStatsType;
+
+/**
+ * Sets up the analysis for the current gyroscope data rate and registers it
+ * with the deferred worker. Called by the SENSORS task after the sensors are
+ * configured.
+ *
+ * @return FCB_OK, FCB_ERR if the work item could not be registered
+ */
+FcbRetValType DynamicNotchInit(void);
+
+/**
+ * Moves the analysis to a changed gyroscope data rate, see
+ * fcb_sensor_timing.h. The notches restart with the next analysis. Called by
+ * the SENSORS task.
+ */
+void DynamicNotchDataRateChanged(void);
+
+/**
+ * Collects one gyroscope sample for the analysis and filters it in place.
+ * Called by the SENSORS task, or by the control executive, which then owns
+ * the filter state. Uses no FreeRTOS API.
+ *
+ * @param xyz the sample, overwritten with the filtered sample
+ */
+RAMFUNC void DynamicNotchApply(float32_t * xyz);
+
+/**
+ * Posts the analysis of a collected frame. Called by the flight control task
+ * on every control cycle.
+ */
+void DynamicNotchUpdate(void);
+
+void ResetDynamicNotchStats(void);
+size_t PrintDynamicNotch(char * dst, const size_t dstSize);
+
+#endif /* FCB_DYNAMIC_NOTCH_H */
@@ -0,0 +1,148 @@
+#ifndef FCB_GPS_H
+#define FCB_GPS_H
+
+#include "fcb_retval.h"
+#include "stm32f3xx_hal.h"
+#include "arm_math.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @file fcb_gps.h
+ *
+ * Driver of a u-blox GPS receiver on GPS_UART, speaking the UBX binary
+ * protocol. At startup the receiver is switched to UBX only at
+ * GPS_BAUDRATE, from GPS_DEFAULT_BAUDRATE as well as from GPS_BAUDRATE in
+ * case it kept its configuration over an FCB reset, and set to send a
+ * NAV-PVT solution every GPS_MEASUREMENT_PERIOD. There is no ACK handling,
+ * the received solutions show that the configuration was taken.
+ *
+ * The UART writes the received bytes to a ring buffer with circular DMA,
+ * which is parsed in the idle line interrupt after each burst, so that a
+ * solution costs one interrupt. The latest solution is read by the
+ * position estimator, see position_estimation.h.
+ */
+
+/* Uncomment when a GPS receiver is connected to GPS_UART, to run the driver and the position estimator */
+//#define FCB_GPS
+
+#if defined(FCB_GPS) && defined(FCB_BENCHMARK_BUILD)
+#error "The benchmark build signals through the GPS_UART vector, FCB_GPS cannot be used with FCB_BENCHMARK_BUILD"
+#endif
+
+/* Uncomment with FCB_GPS to take the solutions from a DroneCAN GNSS node instead of GPS_UART, see dronecan.h */
+//#define GPS_INPUT_IS_DRONECAN
+
+/* GPS UART on PC10 (TX) and PC11 (RX), the RX DMA request of UART4 is on DMA2 channel 3 */
+#define GPS_UART                                UART4
+#define GPS_UART_CLK_ENABLE()                   __UART4_CLK_ENABLE()
+#define GPS_UART_DMA_CLK_ENABLE()               __DMA2_CLK_ENABLE()
+#define GPS_UART_GPIO_CLK_ENABLE()              __GPIOC_CLK_ENABLE()
+#define GPS_UART_TX_PIN                         GPIO_PIN_10
+#define GPS_UART_RX_PIN                         GPIO_PIN_11
+#define GPS_UART_GPIO_PORT                      GPIOC
+#define GPS_UART_AF                             GPIO_AF5_UART4
+#define GPS_UART_RX_DMA_CHANNEL                 DMA2_Channel3 // UART4_RX request, its interrupts are not used
+#define GPS_UART_IRQn                           UART4_IRQn
+#define GPS_UART_IRQHandler                     UART4_IRQHandler
+#define GPS_UART_IRQ_PREEMPT_PRIO               8 // Masked by the critical sections the solution is read in
+#define GPS_UART_IRQ_SUB_PRIO                   0
+
+#define GPS_DEFAULT_BAUDRATE                    9600    // u-blox factory setting
+#define GPS_BAUDRATE                            115200
+#define GPS_CONFIG_TX_TIMEOUT                   100     // [ms] per configuration message
+#define GPS_BAUDRATE_SWITCH_DELAY               100     // [ms] for the receiver to apply a new port configuration
+#define GPS_MEASUREMENT_PERIOD                  200     // [ms] 5 Hz solutions
+
+/* DMA ring buffer, holds more than two NAV-PVT messages */
+#define GPS_DMA_BUFFER_SIZE                     256
+#define GPS_UBX_MAX_PAYLOAD_SIZE                100
+
+/* A solution is used for navigation only with a 3D fix of at least this quality */
+#define GPS_MIN_SATELLITES                      6
+#define GPS_MAX_HORIZONTAL_ACCURACY             5.0f    // [m]
+
+/* The receiver is lost without a solution for this long */
+#define GPS_TIMEOUT                             1000    // [ms]
+
+/**
+ * Navigation solution, from a UBX NAV-PVT message
+ */
+typedef struct FcbGpsSolution {
+    uint32_t sequence;          /* counts the received solutions */
+    uint32_t timestamp;         /* of the reception [core clock cycles] */
+    uint32_t iTow;              /* GPS time of week [ms] */
+    uint8_t fixType;            /* 0 none, 2 2D, 3 3D, 4 GNSS and dead reckoning */
+    bool fixOk;                 /* within the accuracy masks of the receiver */
+    uint8_t numSv;              /* satellites used */
+    int32_t latitude;           /* [1e-7 deg] */
+    int32_t longitude;          /* [1e-7 deg] */
+    float32_t heightMsl;        /* [m] */
+    float32_t velocityNed[3];   /* [m/s] */
+    float32_t horizontalAccuracy; /* [m] */
+    float32_t verticalAccuracy; /* [m] */
+    float32_t speedAccuracy;    /* [m/s] */
+} FcbGpsSolutionType;
+
+/**
+ * Reception statistics, cleared by ResetGpsStats()
+ */
+typedef struct FcbGpsStats {
+    uint32_t messages;          /* UBX messages with a valid checksum */
+    uint32_t solutions;         /* of which NAV-PVT */
+    uint32_t checksumErrors;
+    uint32_t rxErrors;          /* bursts with UART framing, noise or overrun errors */
+    uint32_t lastRxTick;        /* [ms] of the latest solution */
+} FcbGpsStatsType;
+
+extern UART_HandleTypeDef GpsUartHandle;
+
+/**
+ * Configures the receiver and starts the reception. Called by the SENSORS
+ * task, blocks for the configuration at the default baud rate.
+ *
+ * @return FCB_OK, FCB_ERR_INIT if the UART could not be started
+ */
+FcbRetValType FcbInitialiseGps(void);
+
+/**
+ * Parses the bytes received since the previous idle line. Called from the
+ * GPS_UART interrupt.
+ */
+void GpsUartIRQHandler(void);
+
+/**
+ * Gets the latest solution if it is newer than a given one.
+ *
+ * @param dstSolution destination
+ * @param lastSequence sequence of the latest solution the caller has used
+ * @return true if a newer solution was copied
+ */
+bool GetNewGpsSolution(FcbGpsSolutionType * dstSolution, const uint32_t lastSequence);
+
+/**
+ * Sets the latest solution from a receiver other than the one on GPS_UART,
+ * with GPS_INPUT_IS_DRONECAN. Called from tasks.
+ *
+ * @param solution received solution, its sequence is not used
+ */
+void SetGpsSolution(const FcbGpsSolutionType * solution);
+
+/**
+ * @param solution a received solution
+ * @return true if it has a 3D fix within GPS_MIN_SATELLITES and GPS_MAX_HORIZONTAL_ACCURACY
+ */
+bool IsGpsSolutionUsable(const FcbGpsSolutionType * solution);
+
+/**
+ * @return true if a solution has been received within GPS_TIMEOUT
+ */
+bool IsGpsActive(void);
+
+void GetGpsStats(FcbGpsStatsType * dstStats);
+void ResetGpsStats(void);
+size_t PrintGpsStats(char * dst, const size_t dstSize);
+
+#endif /* FCB_GPS_H */
@@ -0,0 +1,116 @@
+#ifndef FCB_GYRO_REDUNDANCY_H
+#define FCB_GYRO_REDUNDANCY_H
+
+#include "ram_func.h"
+#include "arm_math.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @file fcb_gyro_redundancy.h
+ *
+ * Cross-check and per axis selection of two gyroscopes, the external SPI IMU
+ * and the L3GD20 on the board, see FCB_REDUNDANT_GYRO. Both are read for
+ * every sample: the one whose data ready clocks the gyroscope path, and the
+ * other one with a polled read. Gyroscope 0 is the one used at startup, its
+ * bias is the one of the temperature compensation and the estimator.
+ *
+ * Each axis of each gyroscope is tested on every sample:
+ *  - read: GYRO_VOTE_READ_FAILURES reads in a row failed
+ *  - stuck: the output has not changed for GYRO_VOTE_STUCK_TIME
+ *  - range: the output is at the full scale of the part, see
+ *    VibrationClippedAxes
+ * A failed test makes the axis faulty for GYRO_VOTE_FAULT_HOLD_TIME.
+ *
+ * Each axis takes the sample of its selected gyroscope, and selects the other
+ * one when the selected one becomes faulty and the other one is not. The
+ * selection is not changed back, so an intermittent fault does not toggle it.
+ * While both axes are fault free their difference is low pass filtered, and
+ * the sample of gyroscope 1 is used less this offset. The two biases
+ * then match and the switch is glitch free, the filters downstream keep their
+ * state. A difference beyond GYRO_VOTE_MAX_DIFFERENCE for longer than
+ * GYRO_VOTE_DISAGREE_TIME is a disagreement. Of two gyroscopes neither can be
+ * outvoted, so an unexplained disagreement keeps the selection and is only
+ * counted, see GyroVoteStatsType.
+ *
+ * A stall of the gyroscope that clocks the samples is found by the sensor
+ * watchdog. Its first recovery step hands the data ready over to the other
+ * gyroscope if that one is healthy, see GyroVoteSensorStalled, and the
+ * gyroscope path then runs at the data rate of the other part.
+ *
+ * The two parts share SPI1, so the redundancy covers a failed part, not a
+ * failed bus. Both are turned to the quadcopter axes by the same rotation, the
+ * external IMU is to be mounted with its axes along those of the L3GD20.
+ */
+
+#define GYRO_VOTE_SENSORS               2
+#define GYRO_VOTE_READ_FAILURES         3       // Failed reads in a row before all axes are faulty
+#define GYRO_VOTE_STUCK_TIME            100     // [ms] an unchanged axis is stuck after
+#define GYRO_VOTE_FAULT_HOLD_TIME       500     // [ms] an axis stays faulty after its last failed test
+#define GYRO_VOTE_MAX_DIFFERENCE        0.35f   // [rad/s] 20 dps, above the transients of the different filters
+#define GYRO_VOTE_DISAGREE_TIME         50      // [ms] a difference lasts before the gyroscopes disagree
+#define GYRO_VOTE_OFFSET_TIME_CONSTANT  2.0f    // [s] of the low pass filter of the bias difference
+
+/* The tests an axis failed, see above */
+typedef enum {
+    GYRO_VOTE_FAULT_READ = 0x01,
+    GYRO_VOTE_FAULT_STUCK = 0x02,
+    GYRO_VOTE_FAULT_RANGE = 0x04
+} GyroVoteFaultType;
+
+typedef struct GyroVoteStats {
+    bool isEnabled;                             /* a second gyroscope answered at startup */
+    uint8_t source[3];                          /* gyroscope selected per axis */
+    uint8_t faults[GYRO_VOTE_SENSORS][3];       /* GyroVoteFaultType mask per axis */
+    bool isDisagreeing[3];
+    float32_t offset[3];                        /* [rad/s] gyroscope 1 less gyroscope 0 */
+    uint32_t faultCounts[GYRO_VOTE_SENSORS];    /* failed tests */
+    uint32_t sourceChanges;                     /* axis selection changes, see GetGyroVoteSourceChanges */
+    uint32_t disagreements;
+} GyroVoteStatsType;
+
+/**
+ * Starts the voting. Called by InitialiseGyroscope.
+ *
+ * @param names of the two gyroscopes, or the second NULL if it did not answer,
+ *        which disables the voting; the sample of gyroscope 0 is then passed on
+ * @param fullScale of the two gyroscopes [rad/s]
+ */
+void GyroVoteInit(const char * const names[GYRO_VOTE_SENSORS], const float32_t fullScale[GYRO_VOTE_SENSORS]);
+
+/**
+ * Tests the samples of the two gyroscopes and selects an axis each. Called by
+ * the SENSORS task for every sample.
+ *
+ * @param samples [rad/s] sensor axes, a failed read of isValid false is ignored
+ * @param isValid per gyroscope
+ * @param timestamp [core clock cycles] of the sample
+ * @param voted [rad/s] sensor axes, in the bias of gyroscope 0
+ */
+RAMFUNC void GyroVote(const float32_t samples[GYRO_VOTE_SENSORS][3], const bool isValid[GYRO_VOTE_SENSORS],
+        const uint32_t timestamp, float32_t * voted);
+
+/**
+ * Makes all axes of a gyroscope faulty, for the one that stalled while
+ * clocking the samples. Called by the SENSORS task.
+ */
+void GyroVoteSensorStalled(const uint8_t sensor);
+
+/**
+ * @return true if the voting is enabled and no axis of the gyroscope is faulty
+ */
+bool IsGyroVoteSensorHealthy(const uint8_t sensor);
+
+/**
+ * Counts the changes of the selected gyroscope of an axis. The estimator
+ * checks it with every gyroscope sample and opens its bias estimate again
+ * after a change, as the offset of the bias difference is only estimated.
+ */
+uint32_t GetGyroVoteSourceChanges(void);
+
+void GetGyroVoteStats(GyroVoteStatsType * dstStats);
+size_t PrintGyroVote(char * dst, const size_t dstSize);
+
+#endif /* FCB_GYRO_REDUNDANCY_H */
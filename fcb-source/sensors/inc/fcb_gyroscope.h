@@ -3,13 +3,17 @@
 /**
  * @file fcb_gyroscope.h
  *
- * This file exports the API to the L3GD20 gyroscope.
+ * This file exports the API to the gyroscope, the L3GD20 on the board or
+ * an external SPI IMU, see FCB_EXTERNAL_IMU. The part is accessed through
+ * its GYRO_DrvTypeDef driver.
  */
 
 #include "fcb_retval.h"
 #include "stm32f3_discovery.h"
 #include "arm_math.h"
 #include "fcb_sensors.h"
+#include "fcb_sensor_calibration.h"
+#include "ram_func.h"
 
 
 /**
@@ -28,6 +32,51 @@ extern const float32_t GYRO_AXIS_VARIANCE_ROUGH;
  */
 #define GPIO_GYRO_DRDY GPIO_PIN_1
 
+/**
+ * Uncomment to probe for an ICM-20602 on the external SPI IMU connector
+ * at boot, see IMU_IO_Init. When it answers it is used at 1 kHz instead
+ * of the L3GD20, else the L3GD20 is used. The temperature compensation
+ * table is part specific and is measured again after a change of part.
+ */
+//#define FCB_EXTERNAL_IMU
+
+/**
+ * Uncomment with FCB_EXTERNAL_IMU to run the ICM-20602 and the L3GD20 both
+ * and vote between them per axis, see fcb_gyro_redundancy.h. The one that
+ * answers first clocks the samples, the other one is read by a polled read
+ * per sample.
+ */
+//#define FCB_REDUNDANT_GYRO
+
+/**
+ * The data ready input from the external IMU, the gyroscope data ready
+ * when it is used.
+ */
+#define GPIO_EXTERNAL_IMU_DRDY IMU_INT_PIN
+
+/**
+ * Uncomment to run the gyroscope from its FIFO, the L3GD20 at 760 Hz
+ * in stream mode. The FIFO watermark interrupt then replaces data ready
+ * on the same pin and all samples in the FIFO are read in one burst.
+ */
+//#define FCB_GYRO_FIFO_MODE
+
+/**
+ * FIFO level that triggers a batch read in FCB_GYRO_FIFO_MODE, i.e.
+ * the typical number of samples per batch.
+ */
+#define GYRO_FIFO_WATERMARK 8
+
+/**
+ * Max number of samples passed to the client callback per gyroscope
+ * interrupt. Clients queueing the samples should dimension for this.
+ */
+#ifdef FCB_GYRO_FIFO_MODE
+#define GYRO_MAX_SAMPLES_PER_READ 32 /* L3GD20 FIFO size */
+#else
+#define GYRO_MAX_SAMPLES_PER_READ 1
+#endif
+
 
 /**
  * Initialises gyroscope.
@@ -36,6 +85,29 @@ extern const float32_t GYRO_AXIS_VARIANCE_ROUGH;
  */
 uint8_t InitialiseGyroscope(void);
 
+/**
+ * Nominal output data rate of the gyroscope in use [Hz], valid once
+ * the gyroscope is initialised.
+ */
+uint16_t GyroDataRateHz(void);
+
+/**
+ * Reconfigures the gyroscope in use with the data rate and filters nearest to
+ * the requested ones, which are written back. Called by the sensors task.
+ *
+ * @param dataRateHz data rate [Hz]
+ * @param lowPassHz low-pass cutoff [Hz], 0 for the widest
+ * @param highPassHz high-pass cutoff [Hz], 0 for off
+ * @retval FCB_OK, or FCB_ERR if the gyroscope does not support it
+ */
+uint8_t SetGyroscopeRates(float32_t * dataRateHz, float32_t * lowPassHz, float32_t * highPassHz);
+
+/**
+ * Converts raw output register values of the gyroscope in use to
+ * angular rates [rad/s], sensor axes.
+ */
+RAMFUNC void GyroConvertXYZ(const int16_t * rawData, float32_t * gyroscopeData);
+
 uint8_t SensorRegisterGyroClientCallback(SendCorrectionUpdateCallback_TypeDef cbk);
 
 
@@ -43,19 +115,111 @@ uint8_t SensorRegisterGyroClientCallback(SendCorrectionUpdateCallback_TypeDef cb
  * Fetches data (rotation speed, or angle dot) from gyroscope
  * sensor.
  */
-void FetchDataFromGyroscope(void);
+RAMFUNC void FetchDataFromGyroscope(void);
+
+/**
+ * Runs a recovery step of a stalled gyroscope, called by the sensor watchdog.
+ *
+ * @param step see FcbSensorRecoveryType
+ */
+void RecoverGyroscope(FcbSensorRecoveryType step);
+
+/**
+ * Handles the gyroscope DRDY interrupt by starting a DMA burst read
+ * of the output registers. Called from ISR.
+ */
+RAMFUNC void GyroscopeDataReadyFromISR(void);
+
+/**
+ * Handles completion of the DMA burst read started by
+ * GyroscopeDataReadyFromISR and wakes the SENSORS task. Called from ISR.
+ */
+RAMFUNC void GyroscopeDMACompleteFromISR(void);
+
+/**
+ * Handles a failed DMA burst read, a polled read is requested instead.
+ * Called from ISR.
+ */
+void GyroscopeDMAErrorFromISR(void);
+
+/**
+ * Converts and publishes the sample of the last completed DMA burst read.
+ */
+RAMFUNC void FetchDMADataFromGyroscope(void);
+
+/**
+ * Fuses the board axes turn with the mounting rotation and trim, see
+ * fcb_sensor_orientation.h. Called at startup and upon new orientation values.
+ */
+void UpdateGyroscopeOrientation(void);
+
+/**
+ * Rotates a sample to the quadcopter axes, passes it to the vibration monitor,
+ * compensates and filters it, without storing it. Used by the control executive on its own samples.
+ */
+RAMFUNC void ProcessGyroscopeSample(const float32_t * gyroscopeData, float32_t * angleDot);
 
 /*
  * get the current reading from the gyroscope.
  *
- * It is updated at a rate of 94.5Hz (configurable).
+ * It is updated at a rate of 94.5Hz (configurable). Never blocks the
+ * SENSORS task, the read is retried if a new sample arrives meanwhile.
  */
 void GetGyroAngleDot(float32_t * xAngleDot, float32_t * yAngleDot, float32_t * zAngleDot);
 
 /*
- * As GetGyroAngleDot but does not take/release mutex, OK to use in
+ * As GetGyroAngleDot but does not check the sequence lock, OK to use in
  * FcbSensorCbk functions which are called in the SENSRS task context
  */
 void GetGyroAngleDotNoMutex(float32_t * xAngleDot, float32_t * yAngleDot, float32_t * zAngleDot);
 
+/*
+ * Get the timestamp [core clock cycles] of the latest gyroscope sample. In
+ * FCB_GYRO_FIFO_MODE the samples of a batch get timestamps interpolated
+ * back from the time of the read using the nominal data rate.
+ *
+ * Does not check the sequence lock, intended for use in the client callback
+ * which is called in the SENSORS task context.
+ */
+uint32_t GetGyroSampleTimestampNoMutex(void);
+
+/*
+ * Get the last read gyroscope temperature [deg C]. The L3GD20 temperature has
+ * a part specific offset, so it is relative and only used to index the bias
+ * vs temperature table.
+ */
+int8_t GetGyroTemperature(void);
+
+/*
+ * Get a copy of the gyroscope bias vs temperature table. When enabled, the
+ * bias interpolated at the current temperature is subtracted from all samples
+ * before they are filtered and published.
+ */
+void GetGyroTempCompensation(FcbGyroTempCompensationType* dstCompensation);
+
+/*
+ * Enables or disables the bias vs temperature table and saves the setting to
+ * flash. Idle mode only.
+ *
+ * @retval FCB_OK, error otherwise
+ */
+FcbRetValType SetGyroTempCompensationEnabled(uint8_t enable);
+
+/*
+ * Clears all bins of the bias vs temperature table and saves it to flash.
+ * Idle mode only.
+ *
+ * @retval FCB_OK, error otherwise
+ */
+FcbRetValType ClearGyroTempCompensation(void);
+
+/*
+ * Adds a rest bias measurement at the current temperature to the table and
+ * saves it to flash. The measurement is of compensated samples, i.e. the
+ * residual bias. Only if the table is enabled and in idle mode.
+ *
+ * @retval FCB_OK, error otherwise
+ */
+FcbRetValType AddGyroTempCompensationPoint(const float32_t residualBias[3]);
+
 #endif /* GYROSCOPE_H */
@@ -0,0 +1,57 @@
+#ifndef FCB_RPM_FILTER_H
+#define FCB_RPM_FILTER_H
+
+#include "motor_control.h"
+#include "arm_math.h"
+#include "ram_func.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @file fcb_rpm_filter.h
+ *
+ * Notches on the gyroscope samples that follow the rotation rate of each
+ * motor and its harmonics, from the bidirectional DShot telemetry, see
+ * MOTOR_DSHOT_BIDIRECTIONAL. They remove the motor noise at the frequencies
+ * where it is and nowhere else, so the low-pass of the sensor filter can be
+ * set higher, with less delay in the rate loop.
+ *
+ * The coefficients are recomputed whenever a new telemetry has arrived. The
+ * notch of a harmonic is left out while its motor has no valid telemetry, or
+ * while the harmonic is outside [RPM_FILTER_MIN_HZ,
+ * RPM_FILTER_MAX_NYQUIST_FRACTION of the Nyquist frequency], and its state is
+ * cleared when it comes back. The cost is up to
+ * MOTOR_OUTPUT_CHANNELS*RPM_FILTER_HARMONICS biquads per axis and sample.
+ */
+
+/* Uncomment to run the motor notches on the gyroscope samples */
+//#define FCB_RPM_FILTER
+
+#if defined(FCB_RPM_FILTER) && !defined(MOTOR_DSHOT_BIDIRECTIONAL)
+#error "FCB_RPM_FILTER needs the motor telemetry of MOTOR_DSHOT_BIDIRECTIONAL"
+#endif
+
+#define RPM_FILTER_HARMONICS                    3       // The rotation rate and its 2nd and 3rd harmonics
+#define RPM_FILTER_Q                            5.0f    // i.e. a -3 dB bandwidth of a fifth of the frequency
+#define RPM_FILTER_MIN_HZ                       40.0f   // Below idle, and too wide to notch without delay
+#define RPM_FILTER_MAX_NYQUIST_FRACTION         0.9f
+
+/**
+ * Clears the notches, for the current gyroscope data rate. Called by the
+ * SENSORS task after the sensors are configured.
+ */
+void RpmFilterInit(void);
+
+/**
+ * Filters one gyroscope sample in place. Called by the SENSORS task, or by
+ * the control executive, which then owns the filter state. Uses no FreeRTOS
+ * API.
+ *
+ * @param xyz the sample, overwritten with the filtered sample
+ */
+RAMFUNC void RpmFilterApply(float32_t * xyz);
+
+size_t PrintRpmFilter(char * dst, const size_t dstSize);
+
+#endif /* FCB_RPM_FILTER_H */
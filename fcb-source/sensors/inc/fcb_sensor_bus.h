@@ -0,0 +1,88 @@
+#ifndef FCB_SENSOR_BUS_H
+#define FCB_SENSOR_BUS_H
+
+#include "fcb_sensors.h"
+#include "fcb_retval.h"
+#include "arm_math.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @file fcb_sensor_bus.h
+ *
+ * Publish/subscribe bus for sensor samples. Every sensor has a ring of
+ * fixed sample slots which the SENSORS task (the only writer) fills with
+ * each new sample. Subscribers, e.g. the state estimator, a logger or
+ * telemetry, each have their own read cursor and read the samples straight
+ * from the ring, without copies or locking.
+ *
+ * A subscriber that falls behind by more than SENSOR_BUS_RING_SIZE samples
+ * loses the oldest ones, which is counted as overrun.
+ */
+
+enum {
+    SENSOR_BUS_RING_SIZE = 16, /* must be a power of 2 */
+    SENSOR_BUS_MAX_SUBSCRIBERS = 4 /* per sensor */
+};
+
+/**
+ * One sample slot of the ring.
+ *
+ * @see SendCorrectionUpdateCallback_TypeDef for how to interpret xyz
+ */
+typedef struct FcbSensorSample {
+    float32_t xyz[3];
+    uint32_t timestamp; /* [core clock cycles] see GetTimestamp() */
+    uint32_t sequence; /* number of samples published before this one */
+} FcbSensorSampleType;
+
+/**
+ * Adds a subscriber to the samples of a sensor. The subscriber gets the
+ * samples published after this call.
+ *
+ * @param sensor see FcbSensorIndexType
+ * @param subscriber set to the id to use with SensorBusRead
+ * @return FCB_OK, FCB_ERR if the sensor has SENSOR_BUS_MAX_SUBSCRIBERS already
+ */
+FcbRetValType SensorBusSubscribe(FcbSensorIndexType sensor, uint8_t * subscriber);
+
+/**
+ * Writes a new sample to the ring of a sensor. Only called in the
+ * SENSORS task context.
+ *
+ * @param sensor see FcbSensorIndexType
+ * @param xyz the sample, only xyz[0] is used for the barometer
+ * @param timestamp time the sample was taken [core clock cycles]
+ */
+void SensorBusPublish(FcbSensorIndexType sensor, const float32_t * xyz, uint32_t timestamp);
+
+/**
+ * Gets the oldest sample not yet read by a subscriber and moves its cursor
+ * past it. The returned slot is in the ring itself, once done with it call
+ * SensorBusSampleStillValid to check it wasn't overwritten in the meantime.
+ *
+ * @param sensor see FcbSensorIndexType
+ * @param subscriber id from SensorBusSubscribe
+ * @param sequence set to the sequence number of the returned sample
+ * @return the sample, NULL if there is no unread sample
+ */
+const FcbSensorSampleType * SensorBusRead(FcbSensorIndexType sensor, uint8_t subscriber, uint32_t * sequence);
+
+/**
+ * Checks that the slot of a sample returned by SensorBusRead hasn't been
+ * reused by the writer, i.e. that the subscriber wasn't lapped while using it.
+ *
+ * @param sensor see FcbSensorIndexType
+ * @param sequence sequence number given by SensorBusRead
+ */
+bool SensorBusSampleStillValid(FcbSensorIndexType sensor, uint32_t sequence);
+
+/**
+ * Gets the number of samples a subscriber has lost by falling behind.
+ *
+ * @param sensor see FcbSensorIndexType
+ * @param subscriber id from SensorBusSubscribe
+ */
+uint32_t SensorBusGetOverruns(FcbSensorIndexType sensor, uint8_t subscriber);
+
+#endif /* FCB_SENSOR_BUS_H */
@@ -6,6 +6,8 @@
 #ifndef FCB_SENSOR_CALIBRATION_H
 #define FCB_SENSOR_CALIBRATION_H
 
+#include <stdint.h>
+
 typedef enum FcbSensorCalibrationParmIndex {
   X_OFFSET_CALIB_IDX = 0,
   Y_OFFSET_CALIB_IDX = 1,
@@ -15,4 +17,83 @@ typedef enum FcbSensorCalibrationParmIndex {
   Z_SCALING_CALIB_IDX = 5,
   CALIB_IDX_MAX = 6} FcbSensorCalibrationParmIndex;
 
+/*
+ * Magnetometer ellipsoid calibration: offset and the symmetric correction
+ * matrix W, of which the upper triangle is stored. Calibrated values are
+ * W * (value - offset).
+ */
+typedef enum FcbMagCalibrationParmIndex {
+  MAG_X_OFFSET_CALIB_IDX = 0,
+  MAG_Y_OFFSET_CALIB_IDX = 1,
+  MAG_Z_OFFSET_CALIB_IDX = 2,
+  MAG_XX_CORRECTION_CALIB_IDX = 3,
+  MAG_YY_CORRECTION_CALIB_IDX = 4,
+  MAG_ZZ_CORRECTION_CALIB_IDX = 5,
+  MAG_XY_CORRECTION_CALIB_IDX = 6,
+  MAG_XZ_CORRECTION_CALIB_IDX = 7,
+  MAG_YZ_CORRECTION_CALIB_IDX = 8,
+  MAG_CALIB_IDX_MAX = 9} FcbMagCalibrationParmIndex;
+
+/*
+ * Magnetometer online calibration settings as stored in flash
+ */
+typedef struct {
+  uint16_t isOnlineCalibrationEnabled; /* refine the offset in flight, 0 or 1 */
+} FcbMagOnlineCalibrationSettingsType;
+
+/*
+ * Gyroscope bias vs temperature table. The bins are indexed by the relative
+ * L3GD20 temperature, bin i holds the rest bias measured around
+ * GYRO_TEMP_COMP_MIN_TEMP + (i + 0.5) * GYRO_TEMP_COMP_BIN_WIDTH.
+ */
+#define GYRO_TEMP_COMP_BINS         16
+#define GYRO_TEMP_COMP_BIN_WIDTH    8   /* [deg C] */
+#define GYRO_TEMP_COMP_MIN_TEMP     -64 /* [deg C, relative], lower edge of the first bin */
+
+typedef struct {
+  uint16_t isEnabled; /* apply and learn the table, 0 or 1 */
+  uint16_t validBins; /* bit i set if bin i holds a measured bias */
+  float bias[GYRO_TEMP_COMP_BINS][3]; /* [rad/s], board axes, see fcb_sensor_orientation.h */
+} FcbGyroTempCompensationType;
+
+/*
+ * Accelerometer and magnetometer offset and scale vs temperature, see
+ * fcb_accelerometer_magnetometer.h. Each calibration adds a point at the
+ * relative LSM303DLHC die temperature it was made at, point 0 is the one of
+ * the calibration in use. The points are in the board axes, the offsets in
+ * the calibrated unit and the scales relative to the sensitivity of the part.
+ */
+#define ACCMAG_TEMP_COMP_POINTS     4
+#define ACCMAG_TEMP_COMP_MIN_SPREAD 40  /* [deg C / 8], 5 deg C, points closer than this replace each other */
+
+enum {
+  ACCMAG_TEMP_COMP_ACC = 0,
+  ACCMAG_TEMP_COMP_MAG = 1,
+  ACCMAG_TEMP_COMP_SENSORS = 2
+};
+
+typedef struct {
+  uint16_t nbrOfPoints;
+  int16_t temperature[ACCMAG_TEMP_COMP_POINTS]; /* [deg C / LSM303DLHC_TEMP_SENSITIVITY, relative] */
+  float offset[ACCMAG_TEMP_COMP_POINTS][3];
+  float scale[ACCMAG_TEMP_COMP_POINTS][3];
+} FcbAccMagTempPointsType;
+
+typedef struct {
+  uint16_t isEnabled; /* apply the fitted slopes, 0 or 1 */
+  FcbAccMagTempPointsType sensor[ACCMAG_TEMP_COMP_SENSORS];
+} FcbAccMagTempCompensationType;
+
+/*
+ * Mounting rotation of the sensor board and level trim as stored in flash,
+ * see fcb_sensor_orientation.h
+ */
+typedef struct {
+  float mountRoll; /* [rad] */
+  float mountPitch;
+  float mountYaw;
+  float trimRoll;
+  float trimPitch;
+} FcbSensorOrientationSettingsType;
+
 #endif /* FCB_SENSOR_CALIBRATION_H */
@@ -0,0 +1,132 @@
+#ifndef FCB_SENSOR_FILTER_H
+#define FCB_SENSOR_FILTER_H
+
+#include "fcb_sensors.h"
+#include "fcb_retval.h"
+#include "arm_math.h"
+#include <stdint.h>
+
+/**
+ * @file fcb_sensor_filter.h
+ *
+ * Filter stage between the sensor reads and the sensor clients. A filter
+ * is a cascade of a low-pass and up to SENSOR_FILTER_MAX_NOTCHES notch
+ * biquads which is run on all three axes of a sample in one pass.
+ *
+ * Coefficients are computed when a filter is configured and stored in
+ * flash together with the data rate they were computed for. At start-up
+ * they are only used if the sensor still runs at that data rate.
+ *
+ * The worst case cost is SENSOR_FILTER_MAX_STAGES biquads per axis and
+ * sample, so the stage holds a fixed cycle budget at full gyro data rate.
+ */
+
+enum {
+    SENSOR_FILTER_MAX_NOTCHES = 2,
+    SENSOR_FILTER_MAX_STAGES = 1 + SENSOR_FILTER_MAX_NOTCHES, /* low-pass + notches */
+    SENSOR_FILTER_COEFFS_PER_STAGE = 5 /* b0, b1, b2, a1, a2 */
+};
+
+/**
+ * Filter configuration of one sensor, a frequency of 0 disables that stage
+ */
+typedef struct FcbSensorFilterConfig {
+    float32_t lowPassCutoffHz; /* 2nd order Butterworth */
+    float32_t notchCenterHz[SENSOR_FILTER_MAX_NOTCHES];
+    float32_t notchQ[SENSOR_FILTER_MAX_NOTCHES];
+} FcbSensorFilterConfigType;
+
+/**
+ * Coefficients of one sensor filter, stages in CMSIS-DSP biquad layout
+ * { b0, b1, b2, a1, a2 } with a1 & a2 negated as for arm_biquad_cascade_df1_f32
+ */
+typedef struct FcbSensorFilterCoeffs {
+    float32_t sampleRateHz; /* data rate the coefficients were computed for */
+    uint32_t nbrOfStages; /* 0 means no filtering */
+    float32_t coeffs[SENSOR_FILTER_MAX_STAGES * SENSOR_FILTER_COEFFS_PER_STAGE];
+} FcbSensorFilterCoeffsType;
+
+/**
+ * Filter settings as stored in flash
+ */
+typedef struct FcbSensorFilterSettings {
+    FcbSensorFilterCoeffsType sensor[FCB_SENSOR_NBR];
+} FcbSensorFilterSettingsType;
+
+/**
+ * Loads the filter coefficients from flash, a sensor without valid stored
+ * coefficients is not filtered. Call after the sensors are configured as
+ * the stored data rates are checked against the current ones.
+ */
+void SensorFilterInit(void);
+
+/**
+ * Computes the coefficients for a sensor filter at the current sensor data
+ * rate, starts using them and stores them in flash.
+ *
+ * @param sensor GYRO_IDX or ACC_IDX
+ * @param config frequencies must be below the Nyquist frequency
+ * @return FCB_OK, FCB_ERR if sensor or config is not valid
+ */
+FcbRetValType SensorFilterConfig(FcbSensorIndexType sensor, const FcbSensorFilterConfigType * config);
+
+/**
+ * Computes the coefficients for a sensor filter at the current sensor data
+ * rate and starts using them, without storing them. The filter state is kept,
+ * so that the filtered signal stays continuous when switched in flight.
+ *
+ * @param sensor GYRO_IDX or ACC_IDX
+ * @param config frequencies must be below the Nyquist frequency
+ * @return FCB_OK, FCB_ERR if sensor or config is not valid
+ */
+FcbRetValType SensorFilterSwitch(FcbSensorIndexType sensor, const FcbSensorFilterConfigType * config);
+
+/**
+ * Gets the frequencies of a sensor filter, which are only known for a filter
+ * configured or switched since startup, the stored coefficients do not keep
+ * them.
+ *
+ * @param sensor GYRO_IDX or ACC_IDX
+ * @param config destination
+ * @return FCB_OK, FCB_ERR if the filter has not been configured or switched
+ *         since startup
+ */
+FcbRetValType SensorFilterGetConfig(FcbSensorIndexType sensor, FcbSensorFilterConfigType * config);
+
+/**
+ * Recomputes the filters for changed sensor data rates, see
+ * fcb_sensor_timing.h. A filter not configured since startup is disabled
+ * instead, as its frequencies are not known. Called by the SENSORS task.
+ */
+void SensorFilterDataRateChanged(void);
+
+/**
+ * Gets the group delay of a sensor filter at low frequencies, where the
+ * estimator uses the samples.
+ *
+ * @param sensor see FcbSensorIndexType
+ * @return delay [s], 0 if the sensor is not filtered
+ */
+float32_t SensorFilterGroupDelay(FcbSensorIndexType sensor);
+
+/**
+ * Filters one sample in place. Only called in the SENSORS task context.
+ *
+ * @param sensor see FcbSensorIndexType
+ * @param xyz the sample, overwritten with the filtered sample
+ */
+void SensorFilterApply(FcbSensorIndexType sensor, float32_t * xyz);
+
+/**
+ * Computes the coefficients of a notch biquad, in the layout of
+ * FcbSensorFilterCoeffsType. Used for the notches that track the motors, see
+ * fcb_rpm_filter.h.
+ *
+ * @param centerHz below the Nyquist frequency
+ * @param q quality factor, the center frequency over the -3 dB bandwidth
+ * @param sampleRateHz data rate of the filtered sensor
+ * @param pCoeffs destination, SENSOR_FILTER_COEFFS_PER_STAGE values
+ */
+void SensorFilterNotchCoeffs(float32_t centerHz, float32_t q, float32_t sampleRateHz, float32_t * pCoeffs);
+
+#endif /* FCB_SENSOR_FILTER_H */
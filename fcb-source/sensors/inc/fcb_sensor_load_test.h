@@ -0,0 +1,165 @@
+#ifndef FCB_SENSOR_LOAD_TEST_H
+#define FCB_SENSOR_LOAD_TEST_H
+
+#include "fcb_sensors.h"
+#include "fcb_retval.h"
+#include "stm32f3xx_hal.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @file fcb_sensor_load_test.h
+ *
+ * Bench stress test of the sensor pipeline. A timer sets the software
+ * interrupt event bits of the gyroscope, accelerometer and magnetometer
+ * data ready EXTI lines at configurable rates, far above the output data
+ * rates of the sensors, so the data ready ISRs, the SENSORS task and the
+ * flight control run as they would on real interrupts. The drivers do not
+ * read the sensors while the test is active, they pass on the sample of
+ * their last real read instead, so the estimation stays on sane values.
+ *
+ * The test counts the events lost at each hand-over of the pipeline, the
+ * time from a data ready interrupt to the driver passing on its sample and
+ * the time the SENSORS task is busy. The interrupt time of the triggered
+ * handlers is in the ISR statistics, see isr_monitor.h.
+ *
+ * The test runs in idle mode only and ends when the flight control leaves
+ * it. Once it ends the drivers read the sensors again, which restarts
+ * their data ready interrupts. The measured sensor data rates include the
+ * synthetic interrupts, clear them with ResetSensorDataRateStats after.
+ */
+
+/* Uncomment to compile in the sensor load test and its CLI commands. Uses TIM15, leave commented for flight builds. */
+//#define FCB_SENSOR_LOAD_TEST
+
+#if defined(FCB_SENSOR_LOAD_TEST) && defined(FCB_CONTROL_EXECUTIVE)
+#error "The control executive takes the gyroscope samples of the DMA reads, which the load test replaces"
+#endif
+
+#define SENSOR_LOAD_TEST_TIM                    TIM15
+#define SENSOR_LOAD_TEST_TIM_CLK_ENABLE()       __TIM15_CLK_ENABLE()
+#define SENSOR_LOAD_TEST_TIM_CLK_DISABLE()      __TIM15_CLK_DISABLE()
+#define SENSOR_LOAD_TEST_TIM_IRQn               TIM1_BRK_TIM15_IRQn
+#define SENSOR_LOAD_TEST_TIM_IRQHandler         TIM1_BRK_TIM15_IRQHandler
+#define SENSOR_LOAD_TEST_TIM_IRQ_PREEMPT_PRIO   configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY // Same as the data ready EXTIs
+#define SENSOR_LOAD_TEST_TIM_IRQ_SUB_PRIO       0
+
+enum {
+    SENSOR_LOAD_TEST_TICK_RATE = 20000, /* trigger timer rate [Hz], the highest trigger rate of a sensor */
+    SENSOR_LOAD_TEST_MAX_DURATION = 600000, /* [ms] */
+    SENSOR_LOAD_TEST_SENSORS = 3 /* sensors with a data ready interrupt, GYRO_IDX to MAG_IDX */
+};
+
+/**
+ * Hand-overs of the pipeline where an event or sample can be lost, i.e.
+ * merged with or overwritten by the next one before it is handled.
+ */
+typedef enum SensorLoadTestDrop {
+    SENSOR_LOAD_DROP_EXTI = 0, /* trigger while the interrupt of the previous one was pending */
+    SENSOR_LOAD_DROP_SENSOR_EVENT, /* sensor event while the same one was pending, qFcbSensors */
+    SENSOR_LOAD_DROP_FLIGHT_EVENT, /* flight control event while the same one was pending */
+    SENSOR_LOAD_DROP_MAILBOX, /* sample overwritten in the flight control mailbox before fetched */
+    SENSOR_LOAD_DROP_NBR
+} SensorLoadTestDropType;
+
+typedef struct SensorLoadTestSensorStats {
+    uint32_t rateHz; /* requested trigger rate, 0 if not triggered */
+    uint32_t triggers; /* software triggered data ready interrupts */
+    uint32_t samples; /* held samples passed on by the driver */
+    uint32_t maxLatency; /* data ready interrupt to sample passed on [core clock cycles] */
+    uint64_t sumLatency; /* [core clock cycles] */
+} SensorLoadTestSensorStatsType;
+
+/**
+ * Statistics of the running or the last load test.
+ */
+typedef struct SensorLoadTestStats {
+    bool isActive;
+    uint32_t duration; /* requested [ms] */
+    uint32_t elapsed; /* [ms] */
+    SensorLoadTestSensorStatsType sensor[SENSOR_LOAD_TEST_SENSORS];
+    uint32_t drops[SENSOR_LOAD_DROP_NBR];
+    uint64_t sensorsTaskCycles; /* time the SENSORS task was busy handling events [core clock cycles] */
+} SensorLoadTestStatsType;
+
+#ifdef FCB_SENSOR_LOAD_TEST
+
+/* Count a lost event or sample at a hand-over, called with the interrupts masked */
+#define SENSOR_LOAD_TEST_COUNT_DROP(DROP)           SensorLoadTestCountDrop(DROP)
+/* True while the drivers pass on held samples instead of reading the sensors */
+#define SENSOR_LOAD_TEST_IS_ACTIVE()                SensorLoadTestIsActive()
+
+#else
+
+#define SENSOR_LOAD_TEST_COUNT_DROP(DROP)           ((void) 0)
+#define SENSOR_LOAD_TEST_IS_ACTIVE()                (false)
+
+#endif /* FCB_SENSOR_LOAD_TEST */
+
+#ifdef FCB_SENSOR_LOAD_TEST
+
+extern TIM_HandleTypeDef SensorLoadTestTimHandle;
+
+/**
+ * Starts a load test, the statistics of the previous one are cleared.
+ *
+ * @param rateHz trigger rate per sensor, GYRO_IDX to MAG_IDX, 0 to leave
+ *        a sensor alone, at most SENSOR_LOAD_TEST_TICK_RATE
+ * @param duration [ms] at most SENSOR_LOAD_TEST_MAX_DURATION
+ * @return FCB_OK, FCB_ERR if a test is active, the flight control is not
+ *         in idle mode or the rates or the duration are out of range
+ */
+FcbRetValType SensorLoadTestStart(const uint32_t rateHz[SENSOR_LOAD_TEST_SENSORS], const uint32_t duration);
+
+/**
+ * Ends the active load test before its duration, if any.
+ */
+void SensorLoadTestStop(void);
+
+/**
+ * Handles a tick of the trigger timer, from HAL_TIM_PeriodElapsedCallback.
+ */
+void SensorLoadTestTickFromISR(void);
+
+/**
+ * Checks if the drivers pass on held samples instead of reading the sensors.
+ */
+bool SensorLoadTestIsActive(void);
+
+/**
+ * Counts a held sample passed on by a driver and its latency from the data
+ * ready interrupt. Only called in the SENSORS task context.
+ *
+ * @param sensor GYRO_IDX to MAG_IDX
+ */
+void SensorLoadTestSample(FcbSensorIndexType sensor);
+
+/**
+ * Counts a lost event or sample at a hand-over of the pipeline while a test
+ * is active. Called with the interrupts masked.
+ *
+ * @param drop see SensorLoadTestDropType
+ */
+void SensorLoadTestCountDrop(SensorLoadTestDropType drop);
+
+/**
+ * Counts the time the SENSORS task took to handle its pending events while
+ * a test is active. Only called in the SENSORS task context.
+ *
+ * @param cycles [core clock cycles]
+ */
+void SensorLoadTestSensorsTaskRun(uint32_t cycles);
+
+void GetSensorLoadTestStats(SensorLoadTestStatsType * dstStats);
+
+/**
+ * Formats the statistics of the running or the last load test.
+ *
+ * @return see snprintf
+ */
+size_t SensorLoadTestPrint(char * dst, const size_t dstSize);
+
+#endif /* FCB_SENSOR_LOAD_TEST */
+
+#endif /* FCB_SENSOR_LOAD_TEST_H */
@@ -0,0 +1,66 @@
+#ifndef FCB_SENSOR_ORIENTATION_H
+#define FCB_SENSOR_ORIENTATION_H
+
+#include "fcb_sensor_calibration.h"
+#include "fcb_retval.h"
+#include "param_table.h"
+#include "arm_math.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @file fcb_sensor_orientation.h
+ *
+ * Mounting rotation of the sensor board and level trim. The gyroscope,
+ * accelerometer and magnetometer samples are first turned from their sensor
+ * axes to the board axes, the quadcopter axes of a board mounted as designed,
+ * see the "Sensors" wiki page. The calibrations are in the board axes, so they
+ * are kept when the board is mounted in another way.
+ *
+ * The board axes are then rotated to the quadcopter axes by
+ *
+ *   R = Ry(trimPitch) * Rx(trimRoll) * Rz(mountYaw) * Ry(mountPitch) * Rx(mountRoll)
+ *
+ * i.e. the mounting angles are the attitude of the board in the quadcopter
+ * axes, as the Euler angles of the UAV, and the trim is a further small tilt
+ * of the board: a board that is rolled right by a degree reads level with a
+ * roll trim of a degree. The trim is applied to all three sensors, so that
+ * the gyroscope and the magnetometer stay in the axes of the accelerometer.
+ *
+ * The rotation is not an extra step per sample, it is fused into the scale,
+ * axes turn and calibration of each sensor when one of them changes, see the
+ * sensor modules. A sample is then a single matrix multiply-add from its raw
+ * value.
+ */
+
+#define SENSOR_ORIENTATION_MAX_MOUNT_ANGLE      PI                  // [rad]
+#define SENSOR_ORIENTATION_MAX_TRIM             (10.0f*PI/180.0f)   // [rad]
+
+/**
+ * Loads the mounting angles and the trim from flash. Called by the SENSORS
+ * task before the sensors are initialised, which take the rotation from
+ * GetSensorOrientationMatrix.
+ */
+void SensorOrientationInit(void);
+
+/**
+ * @param dstRotation rotation from the board axes to the quadcopter axes,
+ *        see above
+ */
+void GetSensorOrientationMatrix(float32_t dstRotation[3][3]);
+
+void GetSensorOrientationSettings(FcbSensorOrientationSettingsType * dstSettings);
+
+/**
+ * Gets the orientation parameters, for the parameter table.
+ *
+ * SENS_ROLL, SENS_PITCH and SENS_YAW are the mounting angles, TRIM_ROLL and
+ * TRIM_PITCH the level trim. A new value takes effect with the next sample of
+ * each sensor.
+ */
+const ParamGroup_TypeDef* GetSensorOrientationParamGroup(void);
+
+size_t PrintSensorOrientation(char * dst, const size_t dstSize);
+
+#endif /* FCB_SENSOR_ORIENTATION_H */
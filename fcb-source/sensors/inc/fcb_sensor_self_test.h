@@ -0,0 +1,127 @@
+#ifndef FCB_SENSOR_SELF_TEST_H
+#define FCB_SENSOR_SELF_TEST_H
+
+#include "fcb_sensors.h"
+#include "fcb_retval.h"
+#include "arm_math.h"
+#include "pb_encode.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @file fcb_sensor_self_test.h
+ *
+ * Power-on self-test and health report of the sensors. Each sensor gets two
+ * checks at startup:
+ *
+ * - the built-in check of the part: the electrostatic self-test of the
+ *   gyroscope, whose output change is compared with the data sheet, see
+ *   GyroSelfTest, and the check of the calibration E2PROM of the barometer.
+ *   The LSM303DLHC has no self-test, so the accelerometer and magnetometer
+ *   report SENSOR_SELF_TEST_UNSUPPORTED.
+ * - the noise floor, the mean and standard deviation of the first
+ *   published samples, see SensorSelfTestUpdate. An output that does not
+ *   change at all is stuck, and the accelerometer must measure gravity.
+ *
+ * The gyroscope, accelerometer and magnetometer must pass both before the
+ * UAV is armed, a failed barometer blocks the altitude hold mode. The
+ * accelerometer and magnetometer publish once calibrated, so their noise
+ * floors are taken after the calibration.
+ */
+
+#define SENSOR_SELF_TEST_SAMPLES                16      // Averaged per self-test mode
+#define SENSOR_SELF_TEST_SETTLE_TIME            50      // [ms] after a change of the self-test mode
+#define SENSOR_SELF_TEST_MIN_RATIO              0.5f    // Of the typical output change, the data sheet gives no bounds
+#define SENSOR_SELF_TEST_MAX_RATIO              1.5f
+
+#define SENSOR_NOISE_GYRO_SAMPLES               256
+#define SENSOR_NOISE_ACC_SAMPLES                128
+#define SENSOR_NOISE_MAG_SAMPLES                32      // Decimated, see MAG_DECIMATION
+#define SENSOR_NOISE_BARO_SAMPLES               32
+#define SENSOR_NOISE_MIN_GRAVITY                0.8f    // Of G_ACC, for the mean norm of the accelerometer
+#define SENSOR_NOISE_MAX_GRAVITY                1.2f
+
+/* The SENSOR_HEALTH_MSG_ENUM message, encoded without generated nanopb code.
+ *   message SensorHealthProto {
+ *     repeated SensorHealthReportProto sensors = 1;    // In FcbSensorIndexType order
+ *   }
+ *   message SensorHealthReportProto {
+ *     optional uint32 sensor = 1;                      // FcbSensorIndexType
+ *     optional uint32 status = 2;                      // FcbSensorSelfTestStatusType
+ *     optional uint32 self_test = 3;                   // FcbSensorSelfTestStatusType
+ *     repeated float self_test_change = 4 [packed=true];
+ *     optional float self_test_expected = 5;
+ *     repeated float mean = 6 [packed=true];
+ *     repeated float noise = 7 [packed=true];
+ *     optional uint32 samples = 8;
+ *   } */
+#define SENSOR_HEALTH_REPORT_MAX_SIZE           64      // [bytes] of an encoded SensorHealthReportProto
+
+typedef enum {
+    SENSOR_SELF_TEST_NOT_RUN = 0,   /* or running */
+    SENSOR_SELF_TEST_PASSED,
+    SENSOR_SELF_TEST_FAILED,
+    SENSOR_SELF_TEST_UNSUPPORTED    /* the part has no built-in check */
+} FcbSensorSelfTestStatusType;
+
+/**
+ * Health report of a sensor, written by the SENSORS task
+ */
+typedef struct FcbSensorHealthReport {
+    FcbSensorSelfTestStatusType status;     /* of both checks, SENSOR_SELF_TEST_NOT_RUN until both are done */
+    FcbSensorSelfTestStatusType selfTest;   /* built-in check of the part */
+    float32_t selfTestChange[3];            /* output change in self-test, gyroscope only [rad/s] */
+    float32_t selfTestExpected;             /* typical output change of the data sheet [rad/s] */
+    float32_t mean[3];                      /* of the noise floor samples, xyz[0] for the barometer */
+    float32_t noise[3];                     /* standard deviation of the noise floor samples */
+    uint16_t samples;                       /* of the noise floor */
+    const char* failure;                    /* what failed, NULL if nothing did */
+} FcbSensorHealthReportType;
+
+/**
+ * Subscribes to the samples of the sensors for their noise floors. Called
+ * by the SENSORS task after the sensors are initialised.
+ *
+ * @return FCB_OK, FCB_ERR if a subscription failed
+ */
+FcbRetValType SensorSelfTestInit(void);
+
+/**
+ * Sets the result of the built-in check of a sensor, called when the sensor
+ * is initialised.
+ *
+ * @param sensor see FcbSensorIndexType
+ * @param selfTest result
+ * @param change output change in self-test, NULL if not measured
+ * @param expected typical output change
+ */
+void SensorSelfTestSetResult(FcbSensorIndexType sensor, FcbSensorSelfTestStatusType selfTest,
+        const float32_t * change, float32_t expected);
+
+/**
+ * Adds the new samples to the noise floors that are not complete yet and
+ * checks the completed ones. Called by the SENSORS task on every
+ * FCB_SENSOR_WATCHDOG_TICK.
+ */
+void SensorSelfTestUpdate(void);
+
+/**
+ * @param sensor see FcbSensorIndexType
+ * @return the status of both checks of the sensor
+ */
+FcbSensorSelfTestStatusType GetSensorSelfTestStatus(FcbSensorIndexType sensor);
+
+/**
+ * @return true if the gyroscope, accelerometer and magnetometer have passed,
+ *         required to arm
+ */
+bool IsSensorSelfTestPassed(void);
+
+const char* GetSensorSelfTestStatusName(FcbSensorSelfTestStatusType status);
+void GetSensorHealthReport(FcbSensorIndexType sensor, FcbSensorHealthReportType * dstReport);
+size_t PrintSensorHealthReport(char * dst, const size_t dstSize);
+bool EncodeSensorHealth(pb_ostream_t * stream);
+
+#endif /* FCB_SENSOR_SELF_TEST_H */
@@ -0,0 +1,108 @@
+#ifndef FCB_SENSOR_TIMING_H
+#define FCB_SENSOR_TIMING_H
+
+#include "fcb_sensors.h"
+#include "fcb_retval.h"
+#include "ram_func.h"
+#include "arm_math.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @file fcb_sensor_timing.h
+ *
+ * Data rates and on-chip filters of the gyroscope, the accelerometer and the
+ * magnetometer, set at runtime in idle mode. The sensors support a few rates
+ * and cutoffs each, the nearest ones are used. A change reconfigures the
+ * sensor in the SENSORS task and then moves everything that depends on its
+ * data rate: the sensor filters, the motor and dynamic notches, the nominal
+ * data ready intervals and the vibration monitor. The estimator is then
+ * initialised again, which also sets the control sample period and the loop
+ * deadlines from the new gyroscope rate.
+ *
+ * Each sensor has a group delay at low frequencies, the delay of the sample
+ * after the motion it measures: the on-chip low-pass, modelled as a first
+ * order one at its cutoff, or at half the data rate if it is not known, the
+ * magnetometer averaging and the sensor filter. The estimator corrects with
+ * the samples at their timestamps less this delay.
+ */
+
+#define SENSOR_TIMING_SENSOR_NBR    BARO_IDX    /* the barometer is polled at its own rate */
+
+/**
+ * Requested rates of one sensor, 0 data rate for the sensor default
+ */
+typedef struct FcbSensorTimingConfig {
+    float32_t dataRateHz;
+    float32_t lowPassHz;    /* on-chip low-pass cutoff, 0 for the widest */
+    float32_t highPassHz;   /* on-chip high-pass cutoff, 0 for off */
+} FcbSensorTimingConfigType;
+
+/**
+ * Sensor timing settings as stored in flash
+ */
+typedef struct FcbSensorTimingSettings {
+    FcbSensorTimingConfigType sensor[SENSOR_TIMING_SENSOR_NBR];
+} FcbSensorTimingSettingsType;
+
+/**
+ * Rates in use by one sensor
+ */
+typedef struct FcbSensorTiming {
+    float32_t dataRateHz;
+    float32_t lowPassHz;    /* 0 if the low-pass is not known */
+    float32_t highPassHz;   /* 0 if off */
+    float32_t groupDelay;   /* [s], including the sensor filter */
+} FcbSensorTimingType;
+
+/**
+ * Reconfigures the sensors with the stored rates. Called by the SENSORS task
+ * after the sensors are initialised and before anything takes their data
+ * rates.
+ */
+void SensorTimingInit(void);
+
+/**
+ * Stores the rates of a sensor and has the SENSORS task apply them. Idle mode
+ * only.
+ *
+ * @param sensor GYRO_IDX, ACC_IDX or MAG_IDX
+ * @param config requested rates, the magnetometer has no filters
+ * @return FCB_OK, FCB_ERR if not idle, a change is pending, the config is not
+ *         valid or it could not be stored
+ */
+FcbRetValType SetSensorTiming(FcbSensorIndexType sensor, const FcbSensorTimingConfigType * config);
+
+/**
+ * Applies a pending change of SetSensorTiming. Called by the SENSORS task on
+ * FCB_SENSOR_TIMING_CHANGE.
+ */
+void ApplySensorTiming(void);
+
+/**
+ * Gets the rates in use by a sensor.
+ *
+ * @param sensor see FcbSensorIndexType
+ * @param timing destination, all 0 for the barometer
+ */
+void GetSensorTiming(FcbSensorIndexType sensor, FcbSensorTimingType * timing);
+
+/**
+ * Gets the group delay of a sensor, for the estimator.
+ *
+ * @param sensor see FcbSensorIndexType
+ * @return delay [core clock cycles]
+ */
+RAMFUNC uint32_t GetSensorGroupDelayCycles(FcbSensorIndexType sensor);
+
+/**
+ * Prints the rates in use by the sensors as a table.
+ *
+ * @param dst destination string buffer
+ * @param dstSize size of dst
+ * @return length of the table string
+ */
+size_t PrintSensorTiming(char * dst, const size_t dstSize);
+
+#endif /* FCB_SENSOR_TIMING_H */
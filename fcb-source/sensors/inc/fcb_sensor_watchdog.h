@@ -0,0 +1,108 @@
+#ifndef FCB_SENSOR_WATCHDOG_H
+#define FCB_SENSOR_WATCHDOG_H
+
+#include "fcb_sensors.h"
+#include "fcb_retval.h"
+#include "ram_func.h"
+#include "stm32f3xx_hal.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @file fcb_sensor_watchdog.h
+ *
+ * Watchdog of the sensors. The sensor modules feed it with every sample read,
+ * see SensorWatchdogFeed. A hardware timer wakes the SENSORS task every
+ * SENSOR_WATCHDOG_PERIOD, which then checks that every sensor has given a
+ * sample within its timeout, SENSOR_WATCHDOG_MISSED_SAMPLES data ready
+ * intervals of its output data rate (see GetSensorDrdyInterval).
+ *
+ * A sensor that has not is unhealthy, and the recovery steps of
+ * FcbSensorRecoveryType are tried in turn, one per timeout, until it gives
+ * samples again. The barometer restarts itself, see CheckBarometerTimeout,
+ * so its health is only tracked. The estimator restarts the correction
+ * interval of a sensor after each stall, see GetSensorStalls.
+ *
+ * The gyroscope is needed to fly, so it not recovering within
+ * SENSOR_WATCHDOG_GYRO_MAX_STALL is a fatal error.
+ */
+
+#define SENSOR_WATCHDOG_PERIOD                  10      // [ms]
+#define SENSOR_WATCHDOG_MISSED_SAMPLES          10      // Expected samples missed before a sensor is unhealthy
+#define SENSOR_WATCHDOG_MIN_TIMEOUT             (2 * SENSOR_WATCHDOG_PERIOD) // [ms]
+#define SENSOR_WATCHDOG_BARO_TIMEOUT            200     // [ms] longer than BAROMETER_TIMEOUT, the barometer restarts itself first
+#define SENSOR_WATCHDOG_GYRO_MAX_STALL          2000    // [ms]
+
+/* Watchdog timer, free running at 10 kHz */
+#define SENSOR_WATCHDOG_TIM                     TIM17
+#define SENSOR_WATCHDOG_TIM_CLK_ENABLE()        __TIM17_CLK_ENABLE()
+#define SENSOR_WATCHDOG_TIM_CLK_DISABLE()       __TIM17_CLK_DISABLE()
+#define SENSOR_WATCHDOG_TIM_IRQn                TIM1_TRG_COM_TIM17_IRQn
+#define SENSOR_WATCHDOG_TIM_IRQHandler          TIM1_TRG_COM_TIM17_IRQHandler
+#define SENSOR_WATCHDOG_TIM_IRQ_PREEMPT_PRIO    7 // Signals the RTOS, see configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY
+#define SENSOR_WATCHDOG_TIM_IRQ_SUB_PRIO        0
+
+/**
+ * Health and recovery statistics of a sensor, cleared by
+ * ResetSensorWatchdogStats() except for the health.
+ */
+typedef struct FcbSensorWatchdogStats {
+    bool isHealthy;
+    uint32_t timeout;           /* [ms] */
+    uint32_t stalls;            /* times the sensor became unhealthy */
+    uint32_t recoveries[SENSOR_RECOVERY_NBR]; /* recovery steps tried, see FcbSensorRecoveryType */
+    uint32_t unhealthyTime;     /* [ms] in total */
+    uint32_t maxStall;          /* [ms] longest time unhealthy */
+} FcbSensorWatchdogStatsType;
+
+extern TIM_HandleTypeDef SensorWatchdogTimHandle;
+
+/**
+ * Computes the timeouts from the data rates of the initialised sensors and
+ * starts the watchdog timer. Called by the SENSORS task.
+ *
+ * @return FCB_OK, FCB_ERR_INIT if the timer could not be started
+ */
+FcbRetValType SensorWatchdogInit(void);
+
+/**
+ * Checks the sensors and runs the next recovery step of the unhealthy ones.
+ * Called by the SENSORS task on FCB_SENSOR_WATCHDOG_TICK.
+ */
+void SensorWatchdogCheck(void);
+
+/**
+ * Counts a sample read from a sensor, called by the SENSORS task for every
+ * sample, also while calibrating.
+ *
+ * @param sensor see FcbSensorIndexType
+ */
+RAMFUNC void SensorWatchdogFeed(FcbSensorIndexType sensor);
+
+/**
+ * Signals FCB_SENSOR_WATCHDOG_TICK to the SENSORS task, called from the
+ * period elapsed callback of SENSOR_WATCHDOG_TIM.
+ */
+void SensorWatchdogTimerElapsedFromISR(void);
+
+/**
+ * @param sensor see FcbSensorIndexType
+ * @return false if the sensor has not given a sample within its timeout
+ */
+bool IsSensorHealthy(FcbSensorIndexType sensor);
+
+/**
+ * Gets the number of times a sensor became unhealthy since startup, which
+ * the estimator compares with the count at its last correction.
+ *
+ * @param sensor see FcbSensorIndexType
+ */
+uint32_t GetSensorStalls(FcbSensorIndexType sensor);
+
+void GetSensorWatchdogStats(FcbSensorIndexType sensor, FcbSensorWatchdogStatsType * dstStats);
+void ResetSensorWatchdogStats(void);
+size_t PrintSensorWatchdogStats(char * dst, const size_t dstSize);
+
+#endif /* FCB_SENSOR_WATCHDOG_H */
@@ -7,14 +7,16 @@
 #include "fcb_retval.h"
 #include "arm_math.h"
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 /**
  * @file fcb_sensors.h
  *
  * The sensors send Data Ready interrupts and when they are received,
- * the ISRs send a message to the qFcbSensors queue. The SENSORS
- * task is pended on that queue, the message is checked and the
- * task fetches the data from the sensor.
+ * the ISRs set a pending bit per event and give a semaphore. The SENSORS
+ * task is pended on that semaphore, checks the pending bits and
+ * fetches the data from the sensors.
  *
  * The SENSORS task then delegates functionality according
  * to sensor.
@@ -33,6 +35,14 @@ typedef enum FcbSensorIndex {
  * accelerometer values as array of accelerations for x y z
  * magmnetometer values as array of x y z
  */
+/**
+ * A measured data rate is used once this many data ready intervals have
+ * been measured, if it is within SENSOR_RATE_MAX_DEVIATION of the nominal
+ * rate. Else the nominal rate of the sensor driver is used.
+ */
+#define SENSOR_RATE_MIN_INTERVALS   20
+#define SENSOR_RATE_MAX_DEVIATION   0.1f // Relative to the nominal rate
+
 typedef enum FcbAxleIndex {
   X_IDX = 0,
   Y_IDX = 1,
@@ -40,28 +50,53 @@ typedef enum FcbAxleIndex {
 } FcbAxisIndexType; /* as above */
 
 
-/**
- * declared public as queue sizes & memory are a resources
- * common to all tasks in this cpu.
- *
- * @todo tune size
- */
-enum { FCB_SENSORS_QUEUE_SIZE = FCB_SENSOR_NBR*4 };
-
-#define FCB_SENSORS_Q_MSG_SIZE (sizeof(FcbSensorMsgType))
-
 /**
  * Enumeration must fit in uint8_t
  *
- * @see FcbSensorMsg
+ * @see FcbSendSensorMessageFromISR
  */
 typedef enum FcbSensorEvent {
     FCB_SENSOR_GYRO_DATA_READY = 0x0A,
+    FCB_SENSOR_GYRO_DMA_COMPLETE = 0x0B, /* gyro sample already read by SPI DMA burst */
     FCB_SENSOR_ACC_DATA_READY = 0x1A,
+    FCB_SENSOR_ACC_READ_COMPLETE = 0x1B, /* non-blocking I2C read done */
     FCB_SENSOR_MAGNETO_DATA_READY = 0x2A,
-	FCB_SENSOR_BAR_DATA_READY = 0x3A
+    FCB_SENSOR_MAGNETO_READ_COMPLETE = 0x2B, /* non-blocking I2C read done */
+	FCB_SENSOR_BAR_DATA_READY = 0x3A, /* conversion timer elapsed */
+	FCB_SENSOR_BAR_READ_COMPLETE = 0x3B, /* non-blocking I2C transfer done or failed */
+	FCB_SENSOR_WATCHDOG_TICK = 0x4A, /* sensor watchdog timer elapsed, see fcb_sensor_watchdog.h */
+	FCB_SENSOR_TIMING_CHANGE = 0x5A /* sensor data rate set, see fcb_sensor_timing.h */
 } FcbSensorEventType;
 
+/**
+ * Recovery steps of a stalled sensor, tried in this order by the sensor
+ * watchdog, see fcb_sensor_watchdog.h
+ */
+typedef enum FcbSensorRecovery {
+    SENSOR_RECOVERY_REARM = 0,  /* clear the data ready interrupt and read the sensor, which releases its data ready line */
+    SENSOR_RECOVERY_RESET,      /* configure the sensor again */
+    SENSOR_RECOVERY_BUS,        /* reset the bus of the sensor */
+    SENSOR_RECOVERY_NBR
+} FcbSensorRecoveryType;
+
+/**
+ * Data rate statistics of a sensor, measured from its data ready interrupts
+ * since startup or since ResetSensorDataRateStats(). In the FIFO modes the
+ * interrupt is the FIFO watermark, so the intervals span several samples.
+ */
+typedef struct FcbSensorDataRateStats {
+    float32_t nominalRateHz;    /* configured output data rate, 0 if the sensor has no data ready interrupt */
+    float32_t measuredRateHz;   /* samples per second over the measured intervals, 0 if none */
+    bool isMeasuredRateUsed;    /* see GetSensorDataRateHz() */
+    uint32_t drdys;             /* data ready interrupts */
+    uint32_t missedDrdys;       /* interrupts missing from intervals longer than 1.5 nominal intervals */
+    uint32_t readFailures;      /* failed sample reads, retried */
+    uint32_t meanInterval;      /* [us] */
+    uint32_t minInterval;       /* [us], over the intervals without missed interrupts */
+    uint32_t maxInterval;       /* [us], as above */
+    uint32_t jitter;            /* standard deviation of the interval [us], as above */
+} FcbSensorDataRateStatsType;
+
 /**
  * This is a callback client code registers with a sensor.
  *
@@ -74,14 +109,16 @@ typedef enum FcbSensorEvent {
  *
  * @param sensorType: type of sensor
  * @param xyz pointer-to-array with XYZ reading for this sensor. Use FcbAxleIndexType to index into array.
+ * @param timestamp time the sample was taken [core clock cycles], see GetTimestamp()
  *
  * @see FcbSensorIndexType
  */
-typedef void (*SendCorrectionUpdateCallback_TypeDef)(FcbSensorIndexType sensorType, float32_t xyz[3]);
+typedef void (*SendCorrectionUpdateCallback_TypeDef)(FcbSensorIndexType sensorType, float32_t xyz[3],
+        uint32_t timestamp);
 
 
 /**
- * Creates a task which is pended on a queue. The tasks runs when FreeRTOS scheduler
+ * Creates a task which is pended on a semaphore. The tasks runs when FreeRTOS scheduler
  * is launched.
  * @note This function must be called before the scheduler is started.
  *
@@ -101,19 +138,100 @@ int FcbSensorsConfig(void);
 void FcbSensorsInitGpioPinForInterrupt(GPIO_TypeDef  *GPIOx, uint32_t pin);
 
 /**
- * posts a FcbSensorMessage to the queue which is
- * polled by SENSORS task.
+ * flags a FcbSensorEvent as pending and wakes the SENSORS task.
+ * Several events of the same kind before the task runs are handled once.
  *
  * @param event see FcbSensorEventType
  */
 void FcbSendSensorMessageFromISR(uint8_t event);
 
-// TODO Description
+/**
+ * As FcbSendSensorMessageFromISR but for task context.
+ *
+ * @param event see FcbSensorEventType
+ */
 void FcbSendSensorMessage(uint8_t event);
 
+/**
+ * Records the time of a sensor data ready interrupt. To be called first
+ * thing in the EXTI callback so the timestamp is as close as possible to
+ * the moment the sample was taken.
+ *
+ * @param sensor see FcbSensorIndexType
+ */
+void FcbSensorDrdyTimestampFromISR(FcbSensorIndexType sensor);
+
+/**
+ * Gets the time of the latest data ready interrupt of a sensor.
+ *
+ * @param sensor see FcbSensorIndexType
+ * @return timestamp [core clock cycles], see GetTimestamp()
+ */
+uint32_t GetSensorDrdyTimestamp(FcbSensorIndexType sensor);
+
+/**
+ * Counts a failed sample read of a sensor, for the data rate statistics.
+ *
+ * @param sensor see FcbSensorIndexType
+ */
+void FcbSensorReadFailed(FcbSensorIndexType sensor);
+
+/**
+ * As FcbSensorReadFailed but for interrupt context.
+ *
+ * @param sensor see FcbSensorIndexType
+ */
+void FcbSensorReadFailedFromISR(FcbSensorIndexType sensor);
+
+/**
+ * Gets the data rate of a sensor, the measured one when it is valid, see
+ * SENSOR_RATE_MIN_INTERVALS, else the nominal one.
+ *
+ * @param sensor see FcbSensorIndexType
+ * @return data rate [Hz], 0 if the sensor is not initialised yet
+ */
+float32_t GetSensorDataRateHz(FcbSensorIndexType sensor);
+
+/**
+ * Gets the nominal time between the data ready interrupts of a sensor, in
+ * the FIFO modes the interrupt is the FIFO watermark.
+ *
+ * @param sensor see FcbSensorIndexType
+ * @return interval [us], 0 if the sensor has no data ready interrupt or is not initialised yet
+ */
+uint32_t GetSensorDrdyInterval(FcbSensorIndexType sensor);
+
+/**
+ * Gets the data rate statistics of a sensor.
+ *
+ * @param sensor see FcbSensorIndexType
+ * @param stats destination statistics
+ */
+void GetSensorDataRateStats(FcbSensorIndexType sensor, FcbSensorDataRateStatsType* stats);
+
+/**
+ * Clears the data rate statistics of all sensors. The measured data rates
+ * are used again once enough new intervals have been measured.
+ */
+void ResetSensorDataRateStats(void);
+
+/**
+ * Takes the nominal data rates of the sensors, so that the data ready ISRs
+ * can detect missed interrupts, and clears the data rate statistics. Called
+ * by the SENSORS task after the sensors are configured.
+ */
+void UpdateSensorDataRates(void);
+
+/**
+ * Prints the data rate statistics of all sensors as a table.
+ *
+ * @param dst destination string buffer
+ * @param dstSize size of dst
+ * @return length of the table string
+ */
+size_t PrintSensorDataRateStats(char* dst, const size_t dstSize);
+
 /* Debug Print functions ---------------------------------------------------------*/
 void PrintSensorValues(void);
-FcbRetValType StartSensorSamplingTask(const uint16_t sampleTime, const uint32_t sampleDuration);
-FcbRetValType StopSensorSamplingTask(void);
 
 #endif /* FCB_SENSORS_H */
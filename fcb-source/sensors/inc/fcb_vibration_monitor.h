@@ -0,0 +1,105 @@
+#ifndef FCB_VIBRATION_MONITOR_H
+#define FCB_VIBRATION_MONITOR_H
+
+#include "fcb_sensors.h"
+#include "ram_func.h"
+#include "arm_math.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @file fcb_vibration_monitor.h
+ *
+ * Vibration and clipping monitor of the gyroscope and the accelerometer, run
+ * on every sample before the sensor filter, which would hide the vibration.
+ *
+ * The vibration of an axis is the RMS of the sample high-passed at
+ * VIBRATION_HIGH_PASS_CUTOFF, which removes the motion of the airframe,
+ * averaged over an exponential window of VIBRATION_RMS_TIME_CONSTANT. A sample
+ * clips on an axis within VIBRATION_CLIP_MARGIN of the full scale. Both are
+ * first order running statistics, a few multiplications per axis and sample.
+ *
+ * The health score of a sensor is 100 up to its good vibration level and
+ * falls linearly to 0 at its bad level, scaled down by the running rate of
+ * clipped samples to 0 at VIBRATION_MAX_CLIP_RATE. The estimator inflates
+ * the accelerometer noise with the vibration, see GetVibrationVariance.
+ */
+
+#define VIBRATION_HIGH_PASS_CUTOFF      10.0f   // [Hz]
+#define VIBRATION_RMS_TIME_CONSTANT     0.5f    // [s]
+#define VIBRATION_CLIP_MARGIN           0.98f   // Of the full scale
+#define VIBRATION_CLIPPING_RATE         0.001f  // Running rate of clipped samples above which a sensor is clipping
+#define VIBRATION_MAX_CLIP_RATE         0.01f   // Running rate of clipped samples at which the health score is 0
+
+/* The accelerometer runs at +-2 g, so 1 g of headroom on the z axis while hovering */
+#define VIBRATION_ACC_GOOD_RMS          2.0f    // [m/s^2]
+#define VIBRATION_ACC_BAD_RMS           8.0f    // [m/s^2]
+#define VIBRATION_GYRO_GOOD_RMS         0.2f    // [rad/s]
+#define VIBRATION_GYRO_BAD_RMS          2.0f    // [rad/s]
+
+/**
+ * Vibration statistics of a sensor, the counters and the max are cleared by
+ * ResetVibrationStats()
+ */
+typedef struct FcbVibrationStats {
+    float32_t rms[3];           /* running per axis, in the unit of the samples */
+    float32_t maxRms;           /* highest running RMS of any axis */
+    uint32_t clips[3];          /* clipped samples per axis */
+    uint32_t samples;
+    float32_t clipRate;         /* running fraction of samples clipped on any axis */
+    uint8_t health;             /* 0 to 100 */
+} FcbVibrationStatsType;
+
+/**
+ * Sets the filter coefficients from the nominal data rates, samples are only
+ * monitored after this. Called by the SENSORS task once the sensors run.
+ */
+void VibrationMonitorInit(void);
+
+/**
+ * @param sample three axes
+ * @param fullScale of the sensor, in the unit of the sample
+ * @return bit mask of the axes within VIBRATION_CLIP_MARGIN of the full scale
+ */
+RAMFUNC uint8_t VibrationClippedAxes(const float32_t * sample, const float32_t fullScale);
+
+/**
+ * As VibrationClippedAxes for a raw sample of a 16 bit sensor output, left
+ * justified as read from the register of a lower resolution sensor.
+ */
+RAMFUNC uint8_t VibrationClippedAxesRaw(const int16_t * rawData);
+
+/**
+ * Updates the statistics with a sample. Called for every sample of a sensor,
+ * from one context per sensor: the SENSORS task, or the control executive
+ * for the gyroscope.
+ *
+ * @param sensor GYRO_IDX or ACC_IDX
+ * @param sample three axes in FCB axes, not filtered
+ * @param clippedAxes see VibrationClippedAxes
+ */
+RAMFUNC void VibrationMonitorUpdate(FcbSensorIndexType sensor, const float32_t * sample, const uint8_t clippedAxes);
+
+/**
+ * Gets the running vibration variance summed over the axes, without locking.
+ * Only to be called in the context updating the sensor.
+ *
+ * @param sensor GYRO_IDX or ACC_IDX
+ * @return [(unit of the samples)^2], 0 for other sensors
+ */
+RAMFUNC float32_t GetVibrationVariance(FcbSensorIndexType sensor);
+
+/**
+ * As GetVibrationVariance, for the running rate of clipped samples.
+ *
+ * @return true if above VIBRATION_CLIPPING_RATE
+ */
+RAMFUNC bool IsVibrationClipping(FcbSensorIndexType sensor);
+
+void GetVibrationStats(FcbSensorIndexType sensor, FcbVibrationStatsType * dstStats);
+void ResetVibrationStats(void);
+size_t PrintVibrationStats(char * dst, const size_t dstSize);
+
+#endif /* FCB_VIBRATION_MONITOR_H */
@@ -17,22 +17,41 @@
 #include "fcb_accelerometer_magnetometer.h"
 #include "fcb_sensor_calibration.h"
 #include "sphere_calibration.h"
+#include "ellipsoid_calibration.h"
+#include "mag_offset_estimator.h"
 #include "fcb_sensors.h"
+#include "fcb_sensor_bus.h"
+#include "fcb_sensor_watchdog.h"
+#include "fcb_sensor_self_test.h"
+#include "fcb_sensor_orientation.h"
+#include "fcb_vibration_monitor.h"
+#include "fcb_sensor_filter.h"
+#include "fcb_sensor_load_test.h"
+#include "wcet_test.h"
 #include "fcb_error.h"
 #include "lsm303dlhc.h"
 #include "usbd_cdc_if.h"
+#include "telemetry_aggregate.h"
 #include "arm_math.h"
 #include "trace.h"
 #include "flash.h"
+#include "flight_control.h"
+#include "common.h"
+#include "seqlock.h"
+#include "fixed_format.h"
+#include "buffer_monitor.h"
+#include "mem_pool.h"
+#include "fcb_diag.h"
+#include "deferred_work.h"
 
 #include "FreeRTOS.h"
 #include "FreeRTOSConfig.h"
 #include "task.h"
 #include "semphr.h"
+#include "queue.h"
 #include <stdint.h>
 #include <stdio.h>
 
-#define FCB_ACCMAG_DEBUG
 
 enum {
     ACCMAG_AXES_N = 3
@@ -42,43 +61,203 @@ enum {
     ACCMAG_SAMPLING_MAX_STRING_SIZE = 128
 };
 
-enum { NBR_OF_SAMPLES_IN_EACH_POSITION  = 20 };
-enum { NBR_SAMPLE_POSITIONS = 6 };
-enum { NBR_OF_SAMPLES_BETWEEN_EACH_POSITION = 1000 };
+/* Non-blocking reads of the acc & mag output registers, both share the I2C1 bus */
+enum {
+    ACCMAG_I2C_READ_NONE = 0x00,
+    ACCMAG_I2C_READ_ACC = 0x01,
+    ACCMAG_I2C_READ_MAG = 0x02
+};
 
-typedef enum {
-	MOVING,
-	IN_POSITION
-} AccCalibSamplePosition_t;
+enum { ACCMAG_I2C_READ_TIMEOUT = 10 }; /* [ms] a read not completed within this time is abandoned */
+
+#ifdef FCB_ACC_FIFO_MODE
+#define ACC_FIFO_DATA_RATE LSM303DLHC_ODR_400_HZ
+#define ACC_FIFO_DATA_RATE_HZ 400
+#endif
+
+/* Accelerometer calibration: the samples of a window are used if the device was at rest during the window, i.e. the
+ * variance of all axes is low, and are counted to the face that is down, i.e. to the axis nearest to gravity. The
+ * faces may be taken in any order, the calibration is done once each of them has enough samples. */
+enum { NBR_OF_SAMPLES_IN_EACH_POSITION  = 50 };
+enum { NBR_SAMPLE_POSITIONS = 6 }; /* the faces +X, -X, +Y, -Y, +Z and -Z */
+enum { ACC_CALIB_REST_WINDOW = 25 }; /* samples per rest check */
+#define ACC_CALIB_REST_MAX_VARIANCE 0.02f /* [(m/s^2)^2] per axis */
+#define ACC_CALIB_FACE_MIN_ALIGNMENT 0.9f /* min share of the norm along the nearest axis, about 25 deg tilt */
+enum { ACC_CALIB_SAMPLE_SHIFT = 4 }; /* the 12-bit samples are left aligned, the sphere fit takes them right aligned */
+
+/* The calibration fits are solved by the low priority deferred worker, the SENSORS task only accumulates the samples */
+enum { ACCMAG_CALIB_QUEUE_LENGTH = 2 }; /* the magnetometer and the accelerometer job of one calibration */
+
+/* In-flight refinement of the magnetometer offset, see updateMagOnlineCalibration */
+enum { MAG_ONLINE_CAL_DECIMATION = 1 }; /* every averaged magnetometer sample is used, see MAG_DECIMATION */
+enum { MAG_ONLINE_CAL_MIN_UPDATES = 200 }; /* estimate updates before it is used */
+#define MAG_ONLINE_CAL_MIN_RADIUS 0.8f /* the estimated field radius, 1 when calibrated */
+#define MAG_ONLINE_CAL_MAX_RADIUS 1.2f
+#define MAG_ONLINE_CAL_MAX_CORRECTION 0.25f /* max distance of the estimate from the stored offset */
+#define MAG_ONLINE_CAL_SAVE_DELTA 0.01f /* an offset changed more than this is saved when disarmed */
+
+/* Offset and scale vs temperature, see FcbAccMagTempCompensationType */
+#define ACCMAG_TEMP_READ_PERIOD 1000 /* [ms] between the die temperature reads, it changes slowly */
+#define ACCMAG_TEMP_COMP_MAX_EXTRAPOLATION 80 /* [deg C / 8] beyond the points, further out the fit is held */
+#define ACCMAG_TEMP_COMP_MIN_SCALE 0.8f /* relative scale change limits, a fit giving one outside is not used */
+#define ACCMAG_TEMP_COMP_MAX_SCALE 1.2f
+
+typedef struct {
+	uint8_t sensor; /* MAG_IDX or ACC_IDX */
+	int16_t temperature; /* die temperature when the samples were taken */
+	union {
+		EllipsoidObservations_TypeDef ellipsoid; /* MAG_IDX */
+		SphereObservations_TypeDef sphere; /* ACC_IDX */
+	} observations;
+} AccMagCalibJob_TypeDef;
 
 /* print-to-usb com port sampling */
 static uint32_t nbrOfSamplesForCalibration;
 
-static float32_t sXYZDotDot[] = { 0, 0, 0 }; /* not volatile - only print thread reads */
-static float32_t sXYZMagVector[] = { 0, 0, 0 }; /* not volatile - only print thread reads */
+/* Two copies each, the sequence lock publishes one while the other is written */
+static float32_t sXYZDotDot[2][ACCMAG_AXES_N];
+static float32_t sXYZMagVector[2][ACCMAG_AXES_N];
 
-static xSemaphoreHandle mutexAcc;
-static xSemaphoreHandle mutexMag;
+static SeqLock_TypeDef seqLockAcc; /* guards sXYZDotDot */
+static SeqLock_TypeDef seqLockMag; /* guards sXYZMagVector */
 
 /**
- * Magnetometer calibration offset & scaling coefficients
+ * Magnetometer calibration offset & soft-iron correction matrix
+ *
+ * @see FcbMagCalibrationParmIndex for what the numbers mean.
+ */
+static float32_t sXYZMagCalPrm[MAG_CALIB_IDX_MAX] = { 0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 0.0, 0.0, 0.0 };
+
+/**
+ * Accelerometer calibration offset & scaling coefficients
  *
  * @see FcbSensorCalibrationParmIndex for what the numbers mean.
  */
-static float32_t sXYZMagCalPrm[CALIB_IDX_MAX] = { 0.0, 0.0, 0.0, 1.0, 1.0, 1.0 };
 static float32_t sXYZAccCalPrm[CALIB_IDX_MAX] = { 0.0, 0.0, 0.0, 1.0, 1.0, 1.0 };
 
+/* Sensor axes to board axes, see adjustAxesOrientation */
+static const float32_t sAxesOrientation[ACCMAG_AXES_N] = { 1.0f, -1.0f, -1.0f };
+
+/**
+ * Sensor scale, board axes orientation, calibration and the mounting rotation
+ * fused into one matrix multiply-add on the raw samples: value = gain * raw -
+ * bias. The magnetometer calibration also corrects the cross-axis coupling of
+ * soft iron.
+ *
+ * @see fuseCalibration
+ */
+static float32_t sAccGain[ACCMAG_AXES_N][ACCMAG_AXES_N];
+static float32_t sAccBias[ACCMAG_AXES_N];
+static float32_t sMagGain[ACCMAG_AXES_N][ACCMAG_AXES_N];
+static float32_t sMagBias[ACCMAG_AXES_N];
+
+/* Sum of the raw magnetometer samples averaged into the next published one */
+static int32_t sMagRawSum[ACCMAG_AXES_N];
+static uint8_t sMagRawSumSamples = 0;
+
+/* Magnetometer output data rate, MAG_OUTPUT_DATA_RATE until set at runtime */
+static uint8_t sMagDataRate = MAG_OUTPUT_DATA_RATE;
+
+/* Magnetometer calibration samples, only accessed by the SENSORS task while calibrating */
+static EllipsoidObservations_TypeDef magObservations;
+
+/* The magnetometer bias of the stored calibration, sMagBias is refined from it in flight */
+static float32_t sMagCalBias[ACCMAG_AXES_N];
+static MagOffsetEstimator_TypeDef magOffsetEstimator;
+static volatile bool isMagOnlineCalRestartPending = true;
+static volatile uint16_t isMagOnlineCalEnabled = 0;
+
+/* Temperature compensation points and the per axis slopes fitted through them, with the scale slope relative to the
+ * scale of the calibration in use. The raw samples are corrected as gain * raw - offset, which is the identity at the
+ * temperature of that calibration. Written under a critical section by the lower priority tasks, the SENSORS task
+ * reads without locking, as the gyroscope temperature compensation. */
+static FcbAccMagTempCompensationType sAccMagTempCompensation;
+static float32_t sAccMagOffsetSlope[ACCMAG_TEMP_COMP_SENSORS][ACCMAG_AXES_N]; /* [unit / (deg C / 8)] */
+static float32_t sAccMagScaleSlope[ACCMAG_TEMP_COMP_SENSORS][ACCMAG_AXES_N]; /* [1 / (deg C / 8)] */
+static float32_t sAccMagTempGain[ACCMAG_TEMP_COMP_SENSORS][ACCMAG_AXES_N] = { { 1.0, 1.0, 1.0 }, { 1.0, 1.0, 1.0 } };
+static float32_t sAccMagTempOffset[ACCMAG_TEMP_COMP_SENSORS][ACCMAG_AXES_N]; /* [LSB] */
+static int16_t sAccMagTemperature = 0; /* [deg C / LSM303DLHC_TEMP_SENSITIVITY, relative] */
+static uint16_t sMagSamplesSinceTemperatureRead = 0;
+
+static const Param_TypeDef magCalibrationParamTable[] = {
+	{ "MAG_ONLINE_CAL", PARAM_TYPE_UINT16, &isMagOnlineCalEnabled, 0.0, 1.0 }
+};
+
+static DeferredWorkId_TypeDef accMagCalibWorkId = DEFERRED_WORK_INVALID_ID;
+static xQueueHandle accMagCalibQueue = NULL; /* of AccMagCalibJob_TypeDef pointers into accMagCalibJobPool */
+static BufferStats_TypeDef accMagCalibQueueStats;
+static MemPool_TypeDef accMagCalibJobPool;
+static uint64_t accMagCalibJobStorage[MEM_POOL_STORAGE_SIZE(sizeof(AccMagCalibJob_TypeDef), ACCMAG_CALIB_QUEUE_LENGTH)];
 
 static enum FcbAccMagMode accMagMode = ACCMAGMTR_UNINITIALISED;
 
+/* I2C read queue - pending & active are only written in SENSORS task context */
+static uint8_t i2cPendingReads = ACCMAG_I2C_READ_NONE;
+static volatile uint8_t i2cActiveRead = ACCMAG_I2C_READ_NONE;
+static uint32_t i2cActiveReadStartTime = 0;
+static volatile bool i2cActiveReadFailed = false;
+static uint8_t i2cActiveReadSamples = 1;
+static uint32_t i2cActiveReadTimestamp = 0; /* [core clock cycles] time of the newest sample read */
+static uint8_t i2cRxBuffer[LSM303DLHC_XYZ_BUFFER_SIZE * ACC_MAX_SAMPLES_PER_READ];
+#ifdef FCB_ACC_FIFO_MODE
+static bool i2cActiveReadIsFIFOLevel = false; /* the active accelerometer read is of the FIFO level, not the samples */
+#endif
+
+#ifdef FCB_SENSOR_LOAD_TEST
+/* The active read passes on the held samples, the bus is not used during the sensor load test */
+static bool i2cActiveReadHeld = false;
+static int16_t sLoadTestAccRawData[ACCMAG_AXES_N] = { 0, 0, 0 }; /* last real samples */
+static int16_t sLoadTestMagRawData[ACCMAG_AXES_N] = { 0, 0, 0 };
+#endif
+
 /* static fcn declarations */
 
 static SendCorrectionUpdateCallback_TypeDef SendCorrectionUpdateCallback = NULL;
-static void setXYZVector(float32_t *srcVector, float32_t *dstVector);
+static void setXYZVector(SeqLock_TypeDef *lock, float32_t *srcVector, float32_t dstVectors[2][ACCMAG_AXES_N]);
 void adjustAxesOrientation(float32_t *xyzValues);
-static void applayCalibrationPrmToRawData(float32_t *calPrmVector, float32_t *xyzValues);
-bool handleAccSampling(float32_t *acceleroMeterData);
+static void fuseCalibration(const float32_t correction[][ACCMAG_AXES_N], const float32_t *offset,
+        const float32_t *sensorScale, float32_t gain[][ACCMAG_AXES_N], float32_t *bias);
+static void updateFusedCalibration(const float32_t *calPrmVector, const float32_t *sensorScale,
+        float32_t gain[][ACCMAG_AXES_N], float32_t *bias);
+static void updateMatrixFusedCalibration(const float32_t *calPrmVector, const float32_t *sensorScale,
+        float32_t gain[][ACCMAG_AXES_N], float32_t *bias);
+static void applyMatrixFusedCalibration(const float32_t *rawData, const float32_t gain[][ACCMAG_AXES_N],
+        const float32_t *bias, float32_t *xyzValues);
+bool handleAccSampling(const int16_t *rawData);
 uint8_t CheckCalParams(float32_t* magCalPrms);
+static uint8_t CheckMagCalParams(const float32_t* calPrms);
+static void updateAccFusedCalibration(void);
+static void updateMagFusedCalibration(void);
+static void publishAccCalibration(const float32_t *calPrmVector);
+static void publishMagCalibration(const float32_t *calPrmVector);
+static void updateMagOnlineCalibration(float32_t *magnetoMeterData);
+static void readAccMagTemperature(void);
+static void fitAccMagTempCompensation(uint8_t sensor);
+static void updateAccMagTempCompensation(void);
+static void compensateAccMagTemperature(uint8_t sensor, float32_t *rawData);
+static void addAccMagTempCompensationPoint(uint8_t sensor, int16_t temperature, const float32_t *offset,
+        const float32_t *scale);
+static FcbRetValType saveAccMagTempCompensation(void);
+static void saveMagOnlineCalibration(void);
+static void restartMagOnlineCalibration(void);
+static FcbRetValType saveMagCalibrationSettings(void);
+static void submitCalibrationJob(uint8_t sensor);
+static void AccMagCalibrationWork(void *argument);
+static void solveCalibrationJob(const AccMagCalibJob_TypeDef *job);
+static void processAccelerometerData(const int16_t *rawData, uint32_t timestamp);
+static void processMagnetometerData(const int16_t *rawData, uint32_t timestamp);
+static void requestAccMagRead(uint8_t read);
+static void startNextAccMagRead(void);
+#ifdef FCB_ACC_FIFO_MODE
+static HAL_StatusTypeDef startAccelerometerFIFORead(void);
+static HAL_StatusTypeDef continueAccelerometerFIFORead(void);
+static uint32_t accelerometerFIFOSampleTimestamp(uint32_t readTimestamp, uint8_t sample, uint8_t nbrOfSamples);
+#endif
+
+/* A changed MAG_ONLINE_CAL restarts the estimate from the stored offset */
+static const ParamGroup_TypeDef magCalibrationParamGroup = { magCalibrationParamTable,
+        sizeof(magCalibrationParamTable) / sizeof(magCalibrationParamTable[0]), restartMagOnlineCalibration,
+        saveMagCalibrationSettings };
 
 /* public fcn definitions */
 
@@ -86,20 +265,14 @@ uint8_t FcbInitialiseAccMagSensor(void) {
     uint8_t retVal = FCB_OK;
     FlashErrorStatus flash_status = FLASH_OK;
     float32_t sXYZCalPrmTemp[CALIB_IDX_MAX];
+    float32_t sMagCalPrmTemp[MAG_CALIB_IDX_MAX];
+    FcbMagOnlineCalibrationSettingsType magOnlineCalSettings;
 
     if (accMagMode != ACCMAGMTR_UNINITIALISED) {
         /* they are already initialised - this is a logical error. */
         return FCB_ERR_INIT;
     }
 
-    if (NULL == (mutexAcc = xSemaphoreCreateMutex())) {
-        return FCB_ERR_INIT;
-    }
-
-    if (NULL == (mutexMag = xSemaphoreCreateMutex())) {
-        return FCB_ERR_INIT;
-    }
-
     /* configure STM32 interrupts & GPIO */
     ACCELERO_DRDY_GPIO_CLK_ENABLE(); /* GPIOE clock */
 
@@ -122,7 +295,17 @@ uint8_t FcbInitialiseAccMagSensor(void) {
     /* ISSUE1_TODO - fetch accelerometer calib from flash */
 
     LSM303DLHC_AccConfig();
+#ifdef FCB_ACC_FIFO_MODE
+    if (LSM303DLHC_AccConfigFIFO(ACC_FIFO_DATA_RATE, ACC_FIFO_WATERMARK) != 0) {
+        return FCB_ERR_INIT;
+    }
+#endif
     LSM303DLHC_MagInit();
+    LSM303DLHC_MagConfigDataRate(sMagDataRate);
+
+    /* the LSM303DLHC has no self-test, only the noise floors are checked */
+    SensorSelfTestSetResult(ACC_IDX, SENSOR_SELF_TEST_UNSUPPORTED, NULL, 0.0f);
+    SensorSelfTestSetResult(MAG_IDX, SENSOR_SELF_TEST_UNSUPPORTED, NULL, 0.0f);
 
     /* do a pre-read to get the DRDY interrupts going. Since we trig on
      * rising flank and the sensor has data from power-on, by the time we get
@@ -130,13 +313,32 @@ uint8_t FcbInitialiseAccMagSensor(void) {
      * sensor to load a new set of values into its registers.
      */
     float32_t dummyData[3];
-    LSM303DLHC_AccReadXYZ(sXYZDotDot);
+#ifdef FCB_ACC_FIFO_MODE
+    /* drain the FIFO so the watermark interrupt goes low */
+    uint8_t nbrOfSamples = 0;
+    if (HAL_OK == LSM303DLHC_AccReadFIFOLevel(&nbrOfSamples) && nbrOfSamples > 0) {
+        LSM303DLHC_AccReadFIFO(i2cRxBuffer, nbrOfSamples);
+    }
+#else
+    LSM303DLHC_AccReadXYZ(dummyData);
+#endif
     LSM303DLHC_MagReadXYZ(dummyData);
 
-    flash_status = ReadMagCalibrationValuesFromFlash(sXYZCalPrmTemp);
-    if(flash_status == FLASH_OK && CheckCalParams(sXYZCalPrmTemp) == FCB_OK) {
+    flash_status = ReadMagEllipsoidCalibrationFromFlash(sMagCalPrmTemp);
+    if(flash_status == FLASH_OK && CheckMagCalParams(sMagCalPrmTemp) == FCB_OK) {
         // If previously saved calibration params found, copy these to used params
-        memcpy(sXYZMagCalPrm, sXYZCalPrmTemp, sizeof(sXYZMagCalPrm));
+        memcpy(sXYZMagCalPrm, sMagCalPrmTemp, sizeof(sXYZMagCalPrm));
+    } else {
+        // Offset & scaling saved before the ellipsoid calibration, a diagonal correction matrix
+        flash_status = ReadMagCalibrationValuesFromFlash(sXYZCalPrmTemp);
+        if(flash_status == FLASH_OK && CheckCalParams(sXYZCalPrmTemp) == FCB_OK) {
+            sXYZMagCalPrm[MAG_X_OFFSET_CALIB_IDX] = sXYZCalPrmTemp[X_OFFSET_CALIB_IDX];
+            sXYZMagCalPrm[MAG_Y_OFFSET_CALIB_IDX] = sXYZCalPrmTemp[Y_OFFSET_CALIB_IDX];
+            sXYZMagCalPrm[MAG_Z_OFFSET_CALIB_IDX] = sXYZCalPrmTemp[Z_OFFSET_CALIB_IDX];
+            sXYZMagCalPrm[MAG_XX_CORRECTION_CALIB_IDX] = 1.0f / sXYZCalPrmTemp[X_SCALING_CALIB_IDX];
+            sXYZMagCalPrm[MAG_YY_CORRECTION_CALIB_IDX] = 1.0f / sXYZCalPrmTemp[Y_SCALING_CALIB_IDX];
+            sXYZMagCalPrm[MAG_ZZ_CORRECTION_CALIB_IDX] = 1.0f / sXYZCalPrmTemp[Z_SCALING_CALIB_IDX];
+        }
     }
 
     flash_status = ReadAccCalibrationValuesFromFlash(sXYZCalPrmTemp);
@@ -145,10 +347,55 @@ uint8_t FcbInitialiseAccMagSensor(void) {
         memcpy(sXYZAccCalPrm, sXYZCalPrmTemp, sizeof(sXYZAccCalPrm));
     }
 
+    updateAccFusedCalibration();
+    updateMagFusedCalibration();
+
+    /* Compensation from the first sample, enabled by default as it needs points at two temperatures to do anything */
+    if (FLASH_OK != ReadAccMagTempCompensationFromFlash(&sAccMagTempCompensation)
+            || sAccMagTempCompensation.isEnabled > 1
+            || sAccMagTempCompensation.sensor[ACCMAG_TEMP_COMP_ACC].nbrOfPoints > ACCMAG_TEMP_COMP_POINTS
+            || sAccMagTempCompensation.sensor[ACCMAG_TEMP_COMP_MAG].nbrOfPoints > ACCMAG_TEMP_COMP_POINTS) {
+        memset(&sAccMagTempCompensation, 0, sizeof(sAccMagTempCompensation));
+        sAccMagTempCompensation.isEnabled = 1;
+    }
+    fitAccMagTempCompensation(ACCMAG_TEMP_COMP_ACC);
+    fitAccMagTempCompensation(ACCMAG_TEMP_COMP_MAG);
+    readAccMagTemperature();
+
+    if (FLASH_OK == ReadMagOnlineCalibrationSettingsFromFlash(&magOnlineCalSettings)
+            && magOnlineCalSettings.isOnlineCalibrationEnabled <= 1) {
+        isMagOnlineCalEnabled = magOnlineCalSettings.isOnlineCalibrationEnabled;
+    }
+
     accMagMode = ACCMAGMTR_FETCHING;
     return retVal;
 }
 
+uint8_t FcbInitAccMagCalibrationSolver(void) {
+    if (FCB_OK != MemPoolInit(&accMagCalibJobPool, "accMagCalib", accMagCalibJobStorage,
+            sizeof(AccMagCalibJob_TypeDef), ACCMAG_CALIB_QUEUE_LENGTH)) {
+        return FCB_ERR_INIT;
+    }
+
+    accMagCalibQueue = xQueueCreate(ACCMAG_CALIB_QUEUE_LENGTH, sizeof(AccMagCalibJob_TypeDef*));
+    if (NULL == accMagCalibQueue) {
+        ErrorHandler();
+        return FCB_ERR_INIT;
+    }
+    BufferStatsReset(&accMagCalibQueueStats);
+    BufferMonitorRegister("accMagCalib", ACCMAG_CALIB_QUEUE_LENGTH, &accMagCalibQueueStats);
+
+    /* The fits run seldom and only when not flying, so they share the stack of the low priority worker instead of
+     * having a task of their own. The UART session waits while a fit is solved. */
+    if (FCB_OK != DeferredWorkRegister("AccMagCalib", AccMagCalibrationWork, NULL, DEFERRED_WORKER_LOW,
+            &accMagCalibWorkId)) {
+        ErrorHandler();
+        return FCB_ERR_INIT;
+    }
+
+    return FCB_OK;
+}
+
 uint8_t SensorRegisterAccClientCallback(SendCorrectionUpdateCallback_TypeDef cbk) {
   if (NULL != SendCorrectionUpdateCallback) {
     return FCB_ERR;
@@ -159,25 +406,19 @@ uint8_t SensorRegisterAccClientCallback(SendCorrectionUpdateCallback_TypeDef cbk
   return FCB_OK;
 }
 
-void setXYZVector(float32_t *srcVector, float32_t *dstVector) {
-	if (pdTRUE != xSemaphoreTake(mutexMag, portMAX_DELAY /* wait forever */)) {
-		ErrorHandler();
-		return;
-	}
+void setXYZVector(SeqLock_TypeDef *lock, float32_t *srcVector, float32_t dstVectors[2][ACCMAG_AXES_N]) {
+	float32_t *dstVector = dstVectors[SeqLockWriteBegin(lock)];
 
 	dstVector[X_IDX] = srcVector[X_IDX];
 	dstVector[Y_IDX] = srcVector[Y_IDX];
 	dstVector[Z_IDX] = srcVector[Z_IDX];
-
-	if (pdTRUE != xSemaphoreGive(mutexMag)) {
-		ErrorHandler();
-		return;
-	}
+	SeqLockWriteEnd(lock);
 }
 
 void adjustAxesOrientation(float32_t *xyzValues) {
-	/* adjust sensor axes to the axes of the quadcopter fuselage
-	 * see "Sensors" page in Wiki.
+	/* adjust sensor axes to the board axes, the axes of the quadcopter fuselage
+	 * with the board mounted as designed, see "Sensors" page in Wiki and
+	 * fcb_sensor_orientation.h.
 	 *
 	 * NOTE: X axis is already aligned
 	 */
@@ -185,149 +426,873 @@ void adjustAxesOrientation(float32_t *xyzValues) {
 	xyzValues[Z_IDX] = -xyzValues[Z_IDX];
 }
 
-void applayCalibrationPrmToRawData(float32_t *calPrmVector, float32_t *xyzValues) {
-	xyzValues[X_IDX] = (xyzValues[X_IDX] - calPrmVector[X_OFFSET_CALIB_IDX])
-					/ calPrmVector[X_SCALING_CALIB_IDX];
-	xyzValues[Y_IDX] = (xyzValues[Y_IDX] - calPrmVector[Y_OFFSET_CALIB_IDX])
-					/ calPrmVector[Y_SCALING_CALIB_IDX];
-	xyzValues[Z_IDX] = (xyzValues[Z_IDX] - calPrmVector[Z_OFFSET_CALIB_IDX])
-					/ calPrmVector[Z_SCALING_CALIB_IDX];
+/*
+ * Precomputes the gain matrix and bias so that gain * raw - bias equals the
+ * sensor value scaled, turned to the board axes (see adjustAxesOrientation),
+ * calibrated as correction * (value - offset) and rotated to the quadcopter
+ * axes (see fcb_sensor_orientation.h). The calibration is in the board axes,
+ * so it holds for any mounting.
+ */
+static void fuseCalibration(const float32_t correction[][ACCMAG_AXES_N], const float32_t *offset,
+        const float32_t *sensorScale, float32_t gain[][ACCMAG_AXES_N], float32_t *bias) {
+	float32_t rotation[ACCMAG_AXES_N][ACCMAG_AXES_N];
+	float32_t rotatedCorrection;
+	uint8_t i, j, k;
+
+	GetSensorOrientationMatrix(rotation);
+
+	for (i = 0; i < ACCMAG_AXES_N; i++) {
+		bias[i] = 0.0f;
+		for (j = 0; j < ACCMAG_AXES_N; j++) {
+			rotatedCorrection = 0.0f;
+			for (k = 0; k < ACCMAG_AXES_N; k++) {
+				rotatedCorrection += rotation[i][k] * correction[k][j];
+			}
+			gain[i][j] = rotatedCorrection * sAxesOrientation[j] * sensorScale[j];
+			bias[i] += rotatedCorrection * offset[j];
+		}
+	}
 }
 
-bool handleAccSampling(float32_t *acceleroMeterData) {
-	static uint32_t sampleIndex = 0;
-	static AccCalibSamplePosition_t sampleInPosition = MOVING;
-	static uint32_t samplePosition = 0;
-	bool calibrationDone = false;
-
-	if (samplePosition < NBR_SAMPLE_POSITIONS) {
-		// We will take samples from a number of different positions.
-		if (sampleInPosition == IN_POSITION) {
-			// Device is in new position
-			if (sampleIndex < NBR_OF_SAMPLES_IN_EACH_POSITION) {
-				// Add the sample to the calibration algorithm.
-				adjustAxesOrientation(acceleroMeterData);
-				addNewSample(acceleroMeterData);
-				sampleIndex++;
-			} else {
-				// All samples for this position is done. Inform the user to put the device in a new position.
-				sampleIndex = 0;
-				sampleInPosition = MOVING;
-				samplePosition++;
+/*
+ * Precomputes gain and bias of a calibration as (value - offset) / scaling,
+ * see fuseCalibration. Called whenever calibration parameters change.
+ */
+static void updateFusedCalibration(const float32_t *calPrmVector, const float32_t *sensorScale,
+        float32_t gain[][ACCMAG_AXES_N], float32_t *bias) {
+	const float32_t correction[ACCMAG_AXES_N][ACCMAG_AXES_N] = {
+		{ 1.0f / calPrmVector[X_SCALING_CALIB_IDX], 0.0f, 0.0f },
+		{ 0.0f, 1.0f / calPrmVector[Y_SCALING_CALIB_IDX], 0.0f },
+		{ 0.0f, 0.0f, 1.0f / calPrmVector[Z_SCALING_CALIB_IDX] }
+	};
+
+	fuseCalibration(correction, &calPrmVector[X_OFFSET_CALIB_IDX], sensorScale, gain, bias);
+}
+
+/*
+ * Precomputes the gain matrix and bias of a calibration as W * (value -
+ * offset), see fuseCalibration. Called whenever calibration parameters change.
+ */
+static void updateMatrixFusedCalibration(const float32_t *calPrmVector, const float32_t *sensorScale,
+        float32_t gain[][ACCMAG_AXES_N], float32_t *bias) {
+	const float32_t correction[ACCMAG_AXES_N][ACCMAG_AXES_N] = {
+		{ calPrmVector[MAG_XX_CORRECTION_CALIB_IDX], calPrmVector[MAG_XY_CORRECTION_CALIB_IDX],
+				calPrmVector[MAG_XZ_CORRECTION_CALIB_IDX] },
+		{ calPrmVector[MAG_XY_CORRECTION_CALIB_IDX], calPrmVector[MAG_YY_CORRECTION_CALIB_IDX],
+				calPrmVector[MAG_YZ_CORRECTION_CALIB_IDX] },
+		{ calPrmVector[MAG_XZ_CORRECTION_CALIB_IDX], calPrmVector[MAG_YZ_CORRECTION_CALIB_IDX],
+				calPrmVector[MAG_ZZ_CORRECTION_CALIB_IDX] }
+	};
+
+	fuseCalibration(correction, &calPrmVector[MAG_X_OFFSET_CALIB_IDX], sensorScale, gain, bias);
+}
+
+static void applyMatrixFusedCalibration(const float32_t *rawData, const float32_t gain[][ACCMAG_AXES_N],
+        const float32_t *bias, float32_t *xyzValues) {
+	float32_t x = rawData[X_IDX];
+	float32_t y = rawData[Y_IDX];
+	float32_t z = rawData[Z_IDX];
+
+	xyzValues[X_IDX] = gain[X_IDX][X_IDX] * x + gain[X_IDX][Y_IDX] * y + gain[X_IDX][Z_IDX] * z - bias[X_IDX];
+	xyzValues[Y_IDX] = gain[Y_IDX][X_IDX] * x + gain[Y_IDX][Y_IDX] * y + gain[Y_IDX][Z_IDX] * z - bias[Y_IDX];
+	xyzValues[Z_IDX] = gain[Z_IDX][X_IDX] * x + gain[Z_IDX][Y_IDX] * y + gain[Z_IDX][Z_IDX] * z - bias[Z_IDX];
+}
+
+static void updateAccFusedCalibration(void) {
+	float32_t scale = LSM303DLHC_AccScale();
+	float32_t sensorScale[ACCMAG_AXES_N] = { scale, scale, scale };
+
+	updateFusedCalibration(sXYZAccCalPrm, sensorScale, sAccGain, sAccBias);
+}
 
-				USBComSendString("Move device to next position\n");
+static void updateMagFusedCalibration(void) {
+	float32_t sensorScale[ACCMAG_AXES_N];
+
+	LSM303DLHC_MagScale(sensorScale);
+	updateMatrixFusedCalibration(sXYZMagCalPrm, sensorScale, sMagGain, sMagBias);
+	memcpy(sMagCalBias, sMagBias, sizeof(sMagCalBias));
+	isMagOnlineCalRestartPending = true;
+}
+
+/*
+ * Replace the calibration parameters, gain and bias used by the SENSORS task
+ * from a lower priority task. The SENSORS task cannot be preempted by the
+ * caller, so it never sees a half written set once the copy is done without
+ * interruption.
+ */
+static void publishAccCalibration(const float32_t *calPrmVector) {
+	float32_t scale = LSM303DLHC_AccScale();
+	float32_t sensorScale[ACCMAG_AXES_N] = { scale, scale, scale };
+	float32_t gain[ACCMAG_AXES_N][ACCMAG_AXES_N];
+	float32_t bias[ACCMAG_AXES_N];
+
+	updateFusedCalibration(calPrmVector, sensorScale, gain, bias);
+
+	taskENTER_CRITICAL();
+	memcpy(sXYZAccCalPrm, calPrmVector, sizeof(sXYZAccCalPrm));
+	memcpy(sAccGain, gain, sizeof(sAccGain));
+	memcpy(sAccBias, bias, sizeof(sAccBias));
+	taskEXIT_CRITICAL();
+}
+
+static void publishMagCalibration(const float32_t *calPrmVector) {
+	float32_t sensorScale[ACCMAG_AXES_N];
+	float32_t gain[ACCMAG_AXES_N][ACCMAG_AXES_N];
+	float32_t bias[ACCMAG_AXES_N];
+
+	LSM303DLHC_MagScale(sensorScale);
+	updateMatrixFusedCalibration(calPrmVector, sensorScale, gain, bias);
+
+	taskENTER_CRITICAL();
+	memcpy(sXYZMagCalPrm, calPrmVector, sizeof(sXYZMagCalPrm));
+	memcpy(sMagGain, gain, sizeof(sMagGain));
+	memcpy(sMagBias, bias, sizeof(sMagBias));
+	memcpy(sMagCalBias, bias, sizeof(sMagCalBias));
+	isMagOnlineCalRestartPending = true;
+	taskEXIT_CRITICAL();
+}
+
+/*
+ * Refines the magnetometer offset in flight by recursive least squares on
+ * every MAG_ONLINE_CAL_DECIMATION:th sample, at a fixed cost per update. The
+ * estimate replaces the offset once it has converged to a plausible sphere
+ * near the stored offset, and is saved to flash when disarmed. Called by the
+ * SENSORS task with each calibrated sample.
+ */
+static void updateMagOnlineCalibration(float32_t *magnetoMeterData) {
+	static uint8_t decimationCounter = 0;
+	float32_t sample[ACCMAG_AXES_N];
+	float32_t offset[ACCMAG_AXES_N];
+	float32_t correction[ACCMAG_AXES_N];
+	float32_t radius, correctionSquared;
+
+#ifdef FCB_WCET_TEST
+	static bool isWcetTestEstimate = false;
+
+	/* Worst case of the WCET test: an update on every sample, whether enabled or not. The estimate is neither applied
+	 * nor saved, it restarts from the stored offset after the test. */
+	if (WCET_TEST_IS_ACTIVE()) {
+		arm_add_f32(magnetoMeterData, sMagBias, sample, ACCMAG_AXES_N);
+		MagOffsetEstimatorUpdate(&magOffsetEstimator, sample);
+		MagOffsetEstimatorGet(&magOffsetEstimator, offset, &radius);
+		isWcetTestEstimate = true;
+		return;
+	}
+	if (isWcetTestEstimate) {
+		isWcetTestEstimate = false;
+		isMagOnlineCalRestartPending = true;
+	}
+#endif
+
+	if (isMagOnlineCalRestartPending) {
+		isMagOnlineCalRestartPending = false;
+		memcpy(sMagBias, sMagCalBias, sizeof(sMagBias));
+		MagOffsetEstimatorInit(&magOffsetEstimator, sMagCalBias);
+		decimationCounter = 0;
+	}
+
+	if (!isMagOnlineCalEnabled || ++decimationCounter < MAG_ONLINE_CAL_DECIMATION) {
+		return;
+	}
+	decimationCounter = 0;
+
+	/* soft-iron corrected, offset not removed */
+	arm_add_f32(magnetoMeterData, sMagBias, sample, ACCMAG_AXES_N);
+
+	if (MagOffsetEstimatorUpdate(&magOffsetEstimator, sample)
+			&& magOffsetEstimator.nbrOfUpdates >= MAG_ONLINE_CAL_MIN_UPDATES) {
+		MagOffsetEstimatorGet(&magOffsetEstimator, offset, &radius);
+		arm_sub_f32(offset, sMagCalBias, correction, ACCMAG_AXES_N);
+		arm_dot_prod_f32(correction, correction, ACCMAG_AXES_N, &correctionSquared);
+
+		if (radius > MAG_ONLINE_CAL_MIN_RADIUS && radius < MAG_ONLINE_CAL_MAX_RADIUS
+				&& correctionSquared < MAG_ONLINE_CAL_MAX_CORRECTION * MAG_ONLINE_CAL_MAX_CORRECTION) {
+			memcpy(sMagBias, offset, sizeof(sMagBias));
+		}
+	}
+
+	if (FLIGHT_CONTROL_IDLE == GetFlightControlMode()) {
+		saveMagOnlineCalibration();
+	}
+}
+
+/*
+ * Saves the refined magnetometer offset, if it has moved from the stored one.
+ * The bias is R * W * offset, see fuseCalibration.
+ */
+static void saveMagOnlineCalibration(void) {
+	float32_t calPrm[MAG_CALIB_IDX_MAX];
+	float32_t correctionData[ACCMAG_AXES_N * ACCMAG_AXES_N];
+	float32_t correctionInvData[ACCMAG_AXES_N * ACCMAG_AXES_N];
+	float32_t rotation[ACCMAG_AXES_N][ACCMAG_AXES_N];
+	float32_t boardBias[ACCMAG_AXES_N];
+	float32_t delta[ACCMAG_AXES_N];
+	float32_t deltaSquared;
+	uint8_t i;
+	arm_matrix_instance_f32 correction, correctionInv, bias, offset;
+
+	arm_sub_f32(sMagBias, sMagCalBias, delta, ACCMAG_AXES_N);
+	arm_dot_prod_f32(delta, delta, ACCMAG_AXES_N, &deltaSquared);
+	if (deltaSquared < MAG_ONLINE_CAL_SAVE_DELTA * MAG_ONLINE_CAL_SAVE_DELTA) {
+		return;
+	}
+
+	memcpy(calPrm, sXYZMagCalPrm, sizeof(calPrm));
+	correctionData[0] = calPrm[MAG_XX_CORRECTION_CALIB_IDX];
+	correctionData[1] = correctionData[3] = calPrm[MAG_XY_CORRECTION_CALIB_IDX];
+	correctionData[2] = correctionData[6] = calPrm[MAG_XZ_CORRECTION_CALIB_IDX];
+	correctionData[4] = calPrm[MAG_YY_CORRECTION_CALIB_IDX];
+	correctionData[5] = correctionData[7] = calPrm[MAG_YZ_CORRECTION_CALIB_IDX];
+	correctionData[8] = calPrm[MAG_ZZ_CORRECTION_CALIB_IDX];
+
+	/* The rotation is orthonormal, its inverse is its transpose */
+	GetSensorOrientationMatrix(rotation);
+	for (i = 0; i < ACCMAG_AXES_N; i++) {
+		boardBias[i] = rotation[X_IDX][i] * sMagBias[X_IDX] + rotation[Y_IDX][i] * sMagBias[Y_IDX]
+				+ rotation[Z_IDX][i] * sMagBias[Z_IDX];
+	}
+
+	arm_mat_init_f32(&correction, ACCMAG_AXES_N, ACCMAG_AXES_N, correctionData);
+	arm_mat_init_f32(&correctionInv, ACCMAG_AXES_N, ACCMAG_AXES_N, correctionInvData);
+	arm_mat_init_f32(&bias, ACCMAG_AXES_N, 1, boardBias);
+	arm_mat_init_f32(&offset, ACCMAG_AXES_N, 1, &calPrm[MAG_X_OFFSET_CALIB_IDX]);
+
+	if (ARM_MATH_SUCCESS != arm_mat_inverse_f32(&correction, &correctionInv)
+			|| ARM_MATH_SUCCESS != arm_mat_mult_f32(&correctionInv, &bias, &offset)
+			|| FLASH_OK != WriteMagEllipsoidCalibrationToFlash(calPrm)) {
+		return;
+	}
+
+	taskENTER_CRITICAL();
+	memcpy(sXYZMagCalPrm, calPrm, sizeof(sXYZMagCalPrm));
+	memcpy(sMagCalBias, sMagBias, sizeof(sMagCalBias));
+	updateAccMagTempCompensation(); /* of the new offset */
+	taskEXIT_CRITICAL();
+}
+
+/*
+ * Restarts the in-flight offset estimate from the stored offset, upon a new
+ * MAG_ONLINE_CAL value. Called with the scheduler suspended.
+ */
+static void restartMagOnlineCalibration(void) {
+	isMagOnlineCalRestartPending = true;
+}
+
+/*
+ * Saves the magnetometer calibration parameters to flash
+ */
+static FcbRetValType saveMagCalibrationSettings(void) {
+	FcbMagOnlineCalibrationSettingsType settings;
+
+	settings.isOnlineCalibrationEnabled = isMagOnlineCalEnabled;
+
+	return FLASH_OK == WriteMagOnlineCalibrationSettingsToFlash(&settings) ? FCB_OK : FCB_ERR;
+}
+
+const ParamGroup_TypeDef* GetMagCalibrationParamGroup(void) {
+	return &magCalibrationParamGroup;
+}
+
+/*
+ * Fuses a new mounting rotation into the calibrations. Called with the
+ * scheduler suspended, so that the SENSORS task does not see a partial update.
+ * The magnetometer offset refined in flight restarts from the stored one.
+ */
+void UpdateAccMagOrientation(void) {
+	updateAccFusedCalibration();
+	updateMagFusedCalibration();
+}
+
+int16_t GetAccMagTemperature(void) {
+	return sAccMagTemperature;
+}
+
+void GetAccMagTempCompensation(FcbAccMagTempCompensationType* dstCompensation) {
+	taskENTER_CRITICAL();
+	memcpy(dstCompensation, &sAccMagTempCompensation, sizeof(FcbAccMagTempCompensationType));
+	taskEXIT_CRITICAL();
+}
+
+FcbRetValType SetAccMagTempCompensationEnabled(uint8_t enable) {
+	if (enable > 1 || FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+		return FCB_ERR;
+	}
+
+	taskENTER_CRITICAL();
+	sAccMagTempCompensation.isEnabled = enable;
+	updateAccMagTempCompensation();
+	taskEXIT_CRITICAL();
+
+	return saveAccMagTempCompensation();
+}
+
+FcbRetValType ClearAccMagTempCompensation(void) {
+	uint8_t sensor;
+
+	if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+		return FCB_ERR;
+	}
+
+	taskENTER_CRITICAL();
+	for (sensor = 0; sensor < ACCMAG_TEMP_COMP_SENSORS; sensor++) {
+		if (sAccMagTempCompensation.sensor[sensor].nbrOfPoints > 1) {
+			sAccMagTempCompensation.sensor[sensor].nbrOfPoints = 1;
+		}
+		fitAccMagTempCompensation(sensor);
+	}
+	updateAccMagTempCompensation();
+	taskEXIT_CRITICAL();
+
+	return saveAccMagTempCompensation();
+}
+
+/*
+ * Reads the die temperature and updates the temperature compensation. A
+ * failed read keeps the previous temperature. The magnetometer output is read
+ * by the caller before, so the bus is idle. Called from the SENSORS task.
+ */
+static void readAccMagTemperature(void) {
+	int16_t temperature;
+
+	sMagSamplesSinceTemperatureRead = 0;
+
+#ifdef FCB_SENSOR_LOAD_TEST
+	if (SensorLoadTestIsActive()) {
+		return; /* the bus is not used during the sensor load test */
+	}
+#endif
+
+	if (HAL_OK == LSM303DLHC_MagReadTemperature(&temperature)) {
+		sAccMagTemperature = temperature;
+		updateAccMagTempCompensation();
+	}
+}
+
+/*
+ * Least squares fit of a line through the offset and scale points of each
+ * axis. With less than two points, i.e. less than ACCMAG_TEMP_COMP_MIN_SPREAD
+ * apart, the slopes are zero. Called at startup or with the scheduler locked.
+ */
+static void fitAccMagTempCompensation(uint8_t sensor) {
+	const FcbAccMagTempPointsType *points = &sAccMagTempCompensation.sensor[sensor];
+	float32_t meanTemperature = 0.0f, meanOffset, meanScale;
+	float32_t temperatureDeviation, sumSquares = 0.0f;
+	uint16_t i;
+	uint8_t axis;
+
+	memset(sAccMagOffsetSlope[sensor], 0, sizeof(sAccMagOffsetSlope[sensor]));
+	memset(sAccMagScaleSlope[sensor], 0, sizeof(sAccMagScaleSlope[sensor]));
+	if (points->nbrOfPoints < 2) {
+		return;
+	}
+
+	for (i = 0; i < points->nbrOfPoints; i++) {
+		meanTemperature += (float32_t) points->temperature[i] / points->nbrOfPoints;
+	}
+	for (i = 0; i < points->nbrOfPoints; i++) {
+		temperatureDeviation = points->temperature[i] - meanTemperature;
+		sumSquares += temperatureDeviation * temperatureDeviation;
+	}
+
+	for (axis = 0; axis < ACCMAG_AXES_N; axis++) {
+		meanOffset = meanScale = 0.0f;
+		for (i = 0; i < points->nbrOfPoints; i++) {
+			meanOffset += points->offset[i][axis] / points->nbrOfPoints;
+			meanScale += points->scale[i][axis] / points->nbrOfPoints;
+		}
+		for (i = 0; i < points->nbrOfPoints; i++) {
+			temperatureDeviation = points->temperature[i] - meanTemperature;
+			sAccMagOffsetSlope[sensor][axis] += temperatureDeviation * (points->offset[i][axis] - meanOffset)
+					/ sumSquares;
+			sAccMagScaleSlope[sensor][axis] += temperatureDeviation * (points->scale[i][axis] - meanScale)
+					/ sumSquares;
+		}
+		/* relative to the calibration in use */
+		sAccMagScaleSlope[sensor][axis] /= points->scale[0][axis];
+	}
+}
+
+/*
+ * Computes the correction of the raw samples at the current temperature. The
+ * fitted offset and scale change from the temperature of the calibration in
+ * use, T0, is removed in the board axes as
+ *   value' = (value - offset(T)) / s(T) + offset(T0)
+ * and turned to raw LSB, where the fused calibration is applied after. Called
+ * from the SENSORS task or with the scheduler locked.
+ */
+static void updateAccMagTempCompensation(void) {
+	const FcbAccMagTempPointsType *points;
+	float32_t sensorScale[ACCMAG_TEMP_COMP_SENSORS][ACCMAG_AXES_N];
+	const float32_t *calOffset[ACCMAG_TEMP_COMP_SENSORS] = { &sXYZAccCalPrm[X_OFFSET_CALIB_IDX],
+			&sXYZMagCalPrm[MAG_X_OFFSET_CALIB_IDX] };
+	int16_t minTemperature, maxTemperature, temperature;
+	float32_t deltaTemperature = 0.0f, scaleChange[ACCMAG_AXES_N], offsetChange;
+	uint16_t i;
+	uint8_t sensor, axis;
+	bool isValid;
+
+	sensorScale[ACCMAG_TEMP_COMP_ACC][X_IDX] = LSM303DLHC_AccScale();
+	sensorScale[ACCMAG_TEMP_COMP_ACC][Y_IDX] = sensorScale[ACCMAG_TEMP_COMP_ACC][X_IDX];
+	sensorScale[ACCMAG_TEMP_COMP_ACC][Z_IDX] = sensorScale[ACCMAG_TEMP_COMP_ACC][X_IDX];
+	LSM303DLHC_MagScale(sensorScale[ACCMAG_TEMP_COMP_MAG]);
+
+	for (sensor = 0; sensor < ACCMAG_TEMP_COMP_SENSORS; sensor++) {
+		points = &sAccMagTempCompensation.sensor[sensor];
+		isValid = sAccMagTempCompensation.isEnabled && points->nbrOfPoints >= 2;
+
+		if (isValid) {
+			/* held beyond the extrapolation limit */
+			minTemperature = maxTemperature = points->temperature[0];
+			for (i = 1; i < points->nbrOfPoints; i++) {
+				if (points->temperature[i] < minTemperature) {
+					minTemperature = points->temperature[i];
+				} else if (points->temperature[i] > maxTemperature) {
+					maxTemperature = points->temperature[i];
+				}
 			}
-		} else {
-			// Wait some time for the device to be put in a new position.
-			if (sampleIndex < NBR_OF_SAMPLES_BETWEEN_EACH_POSITION) {
-				// Still more time to wait.
-				sampleIndex++;
-			} else {
-				// Time to start to take some samples. Also inform the user about this.
-				sampleIndex = 0;
-				sampleInPosition = IN_POSITION;
+			temperature = sAccMagTemperature;
+			if (temperature < minTemperature - ACCMAG_TEMP_COMP_MAX_EXTRAPOLATION) {
+				temperature = minTemperature - ACCMAG_TEMP_COMP_MAX_EXTRAPOLATION;
+			} else if (temperature > maxTemperature + ACCMAG_TEMP_COMP_MAX_EXTRAPOLATION) {
+				temperature = maxTemperature + ACCMAG_TEMP_COMP_MAX_EXTRAPOLATION;
+			}
+			deltaTemperature = (float32_t) (temperature - points->temperature[0]);
 
-				USBComSendString("Start sampling for this position\n");
+			for (axis = 0; axis < ACCMAG_AXES_N; axis++) {
+				scaleChange[axis] = 1.0f + sAccMagScaleSlope[sensor][axis] * deltaTemperature;
+				if (!(scaleChange[axis] > ACCMAG_TEMP_COMP_MIN_SCALE && scaleChange[axis] < ACCMAG_TEMP_COMP_MAX_SCALE)) {
+					isValid = false;
+				}
 			}
 		}
+
+		for (axis = 0; axis < ACCMAG_AXES_N; axis++) {
+			if (isValid) {
+				offsetChange = sAccMagOffsetSlope[sensor][axis] * deltaTemperature;
+				sAccMagTempGain[sensor][axis] = 1.0f / scaleChange[axis];
+				sAccMagTempOffset[sensor][axis] = ((calOffset[sensor][axis] + offsetChange) / scaleChange[axis]
+						- calOffset[sensor][axis]) / (sAxesOrientation[axis] * sensorScale[sensor][axis]);
+			} else {
+				sAccMagTempGain[sensor][axis] = 1.0f;
+				sAccMagTempOffset[sensor][axis] = 0.0f;
+			}
+		}
+	}
+}
+
+/*
+ * Corrects a raw sample to the temperature of the calibration in use, see
+ * updateAccMagTempCompensation
+ */
+static void compensateAccMagTemperature(uint8_t sensor, float32_t *rawData) {
+	rawData[X_IDX] = sAccMagTempGain[sensor][X_IDX] * rawData[X_IDX] - sAccMagTempOffset[sensor][X_IDX];
+	rawData[Y_IDX] = sAccMagTempGain[sensor][Y_IDX] * rawData[Y_IDX] - sAccMagTempOffset[sensor][Y_IDX];
+	rawData[Z_IDX] = sAccMagTempGain[sensor][Z_IDX] * rawData[Z_IDX] - sAccMagTempOffset[sensor][Z_IDX];
+}
+
+/*
+ * Adds the offset and scale of a new calibration as point 0 and fits the
+ * slopes again. Points closer than ACCMAG_TEMP_COMP_MIN_SPREAD to it are
+ * replaced, and the oldest point is dropped when full. Called by
+ * AccMagCalibrationWork once the calibration is published.
+ */
+static void addAccMagTempCompensationPoint(uint8_t sensor, int16_t temperature, const float32_t *offset,
+        const float32_t *scale) {
+	FcbAccMagTempPointsType *points = &sAccMagTempCompensation.sensor[sensor];
+	FcbAccMagTempPointsType previous;
+	uint16_t i, nbrOfPoints = 0;
+
+	taskENTER_CRITICAL();
+	memcpy(&previous, points, sizeof(previous));
+
+	/* keep the other points, newest first, after the new one */
+	for (i = 0; i < previous.nbrOfPoints && nbrOfPoints < ACCMAG_TEMP_COMP_POINTS - 1; i++) {
+		if (previous.temperature[i] > temperature - ACCMAG_TEMP_COMP_MIN_SPREAD
+				&& previous.temperature[i] < temperature + ACCMAG_TEMP_COMP_MIN_SPREAD) {
+			continue;
+		}
+		points->temperature[nbrOfPoints + 1] = previous.temperature[i];
+		memcpy(points->offset[nbrOfPoints + 1], previous.offset[i], sizeof(points->offset[0]));
+		memcpy(points->scale[nbrOfPoints + 1], previous.scale[i], sizeof(points->scale[0]));
+		nbrOfPoints++;
+	}
+	points->temperature[0] = temperature;
+	memcpy(points->offset[0], offset, sizeof(points->offset[0]));
+	memcpy(points->scale[0], scale, sizeof(points->scale[0]));
+	points->nbrOfPoints = nbrOfPoints + 1;
+
+	fitAccMagTempCompensation(sensor);
+	updateAccMagTempCompensation();
+	taskEXIT_CRITICAL();
+
+	saveAccMagTempCompensation();
+}
+
+/*
+ * Saves a copy of the temperature compensation points to flash
+ */
+static FcbRetValType saveAccMagTempCompensation(void) {
+	FcbAccMagTempCompensationType compensation;
+
+	GetAccMagTempCompensation(&compensation);
+
+	return FLASH_OK == WriteAccMagTempCompensationToFlash(&compensation) ? FCB_OK : FCB_ERR;
+}
+
+/*
+ * Hands the samples accumulated for the sensor over to AccMagCalibrationWork
+ */
+static void submitCalibrationJob(uint8_t sensor) {
+	AccMagCalibJob_TypeDef *job = MemPoolAlloc(&accMagCalibJobPool);
+
+	if (NULL == job) {
+		if (MAG_IDX == sensor) {
+			EllipsoidClearObservations(&magObservations);
+		} else {
+			clearObservationMatrices();
+		}
+		BufferStatsRecordFull(&accMagCalibQueueStats);
+		USBComSendString("ERROR: calibration solver busy, samples discarded\n");
+		return;
+	}
+
+	job->sensor = sensor;
+	job->temperature = sAccMagTemperature;
+	if (MAG_IDX == sensor) {
+		job->observations.ellipsoid = magObservations;
+		EllipsoidClearObservations(&magObservations);
 	} else {
-		// Calibration done, return true and reset internal variables.
-		calibrationDone = true;
-		sampleIndex = 0;
-		sampleInPosition = MOVING;
-		samplePosition = 0;
+		takeObservations(&job->observations.sphere);
 	}
 
-	return calibrationDone;
+	/* The queue has room for all the blocks of the pool */
+	if (pdPASS != xQueueSend(accMagCalibQueue, &job, 0)) {
+		MemPoolFree(&accMagCalibJobPool, job);
+		BufferStatsRecordFull(&accMagCalibQueueStats);
+		USBComSendString("ERROR: calibration solver busy, samples discarded\n");
+	} else {
+		BufferStatsRecordLevel(&accMagCalibQueueStats, uxQueueMessagesWaiting(accMagCalibQueue));
+		DeferredWorkPost(accMagCalibWorkId);
+	}
+}
+
+/*
+ * Solves the ellipsoid fit (magnetometer) or sphere fit (accelerometer) of
+ * the submitted calibration samples, stores the result in flash and publishes
+ * it to the SENSORS task
+ */
+static void AccMagCalibrationWork(void *argument) {
+	(void) argument;
+	AccMagCalibJob_TypeDef *job;
+
+	/* Posts coalesce, all the queued jobs are solved */
+	while (pdPASS == xQueueReceive(accMagCalibQueue, &job, 0)) {
+		solveCalibrationJob(job);
+		MemPoolFree(&accMagCalibJobPool, job);
+	}
+}
+
+/*
+ * Solves a calibration job of AccMagCalibrationWork and uses the result if
+ * the fit succeeded
+ */
+static void solveCalibrationJob(const AccMagCalibJob_TypeDef *job) {
+	float32_t calPrm[MAG_CALIB_IDX_MAX];
+	float32_t scale[ACCMAG_AXES_N];
+	char string[160];
+
+	if (MAG_IDX == job->sensor) {
+		if (FCB_OK != EllipsoidCalibrate(&job->observations.ellipsoid, calPrm)
+				|| FCB_OK != CheckMagCalParams(calPrm)) {
+			USBComSendString("ERROR: magnetometer calibration fit failed, previous calibration kept\n");
+			return;
+		}
+
+		WriteMagEllipsoidCalibrationToFlash(calPrm);
+		publishMagCalibration(calPrm);
+
+		/* the scale of an axis is the inverse of its correction, as of the offset & scaling calibration */
+		scale[X_IDX] = 1.0f / calPrm[MAG_XX_CORRECTION_CALIB_IDX];
+		scale[Y_IDX] = 1.0f / calPrm[MAG_YY_CORRECTION_CALIB_IDX];
+		scale[Z_IDX] = 1.0f / calPrm[MAG_ZZ_CORRECTION_CALIB_IDX];
+		addAccMagTempCompensationPoint(ACCMAG_TEMP_COMP_MAG, job->temperature, &calPrm[MAG_X_OFFSET_CALIB_IDX], scale);
+
+		FormatFixedList(string, sizeof(string),
+				"Calib mag value: %f\t: %f\t: %f: %f\t: %f\t: %f: %f\t: %f\t: %f\n", calPrm, MAG_CALIB_IDX_MAX);
+	} else {
+		/* The samples are right aligned, see handleAccSampling */
+		if (FCB_OK != calibrate(&job->observations.sphere, LSM303DLHC_AccScale() * (1 << ACC_CALIB_SAMPLE_SHIFT),
+				calPrm)) {
+			USBComSendString("ERROR: accelerometer calibration fit failed, previous calibration kept\n");
+			return;
+		}
+
+		WriteAccCalibrationValuesToFlash(calPrm);
+		publishAccCalibration(calPrm);
+		addAccMagTempCompensationPoint(ACCMAG_TEMP_COMP_ACC, job->temperature, &calPrm[X_OFFSET_CALIB_IDX],
+				&calPrm[X_SCALING_CALIB_IDX]);
+
+		FormatFixedList(string, sizeof(string), "Calib acc value: %f\t: %f\t: %f: %f\t: %f\t: %f\n", calPrm,
+				CALIB_IDX_MAX);
+	}
+	USBComSendString(string);
+}
+
+/*
+ * Collects the accelerometer calibration samples of the six faces. Samples are
+ * gathered in windows, and the samples of a window taken at rest are added to
+ * the calibration if its face still needs samples.
+ *
+ * @param rawData raw sample, in sensor axes
+ * @return true when all faces have enough samples
+ */
+bool handleAccSampling(const int16_t *rawData) {
+	static const char *faceNames[NBR_SAMPLE_POSITIONS] = { "+X", "-X", "+Y", "-Y", "+Z", "-Z" };
+	static int16_t windowSamples[ACC_CALIB_REST_WINDOW][ACCMAG_AXES_N];
+	static uint32_t faceSamples[NBR_SAMPLE_POSITIONS] = { 0 };
+	static uint32_t sampleIndex = 0;
+	float32_t scale = LSM303DLHC_AccScale() * (1 << ACC_CALIB_SAMPLE_SHIFT);
+	float32_t mean[ACCMAG_AXES_N] = { 0.0, 0.0, 0.0 };
+	float32_t variance[ACCMAG_AXES_N] = { 0.0, 0.0, 0.0 };
+	float32_t deviation, norm;
+	uint8_t axis, nearestAxis, face, otherFace, facesLeft;
+	uint32_t i;
+	char string[48];
+
+	/* Right aligned and in board axes, as adjustAxesOrientation. The dropped bits are always zero. */
+	windowSamples[sampleIndex][X_IDX] = rawData[X_IDX] >> ACC_CALIB_SAMPLE_SHIFT;
+	windowSamples[sampleIndex][Y_IDX] = -(rawData[Y_IDX] >> ACC_CALIB_SAMPLE_SHIFT);
+	windowSamples[sampleIndex][Z_IDX] = -(rawData[Z_IDX] >> ACC_CALIB_SAMPLE_SHIFT);
+	if (++sampleIndex < ACC_CALIB_REST_WINDOW) {
+		return false;
+	}
+	sampleIndex = 0;
+
+	/* Rest check, in m/s^2 */
+	for (i = 0; i < ACC_CALIB_REST_WINDOW; i++) {
+		for (axis = 0; axis < ACCMAG_AXES_N; axis++) {
+			mean[axis] += windowSamples[i][axis] * scale / ACC_CALIB_REST_WINDOW;
+		}
+	}
+	for (i = 0; i < ACC_CALIB_REST_WINDOW; i++) {
+		for (axis = 0; axis < ACCMAG_AXES_N; axis++) {
+			deviation = windowSamples[i][axis] * scale - mean[axis];
+			variance[axis] += deviation * deviation / (ACC_CALIB_REST_WINDOW - 1);
+		}
+	}
+	for (axis = 0; axis < ACCMAG_AXES_N; axis++) {
+		if (variance[axis] > ACC_CALIB_REST_MAX_VARIANCE) {
+			return false;
+		}
+	}
+
+	/* Face that is down, gravity is then measured along its axis */
+	nearestAxis = X_IDX;
+	for (axis = Y_IDX; axis < ACCMAG_AXES_N; axis++) {
+		if (fabsf(mean[axis]) > fabsf(mean[nearestAxis])) {
+			nearestAxis = axis;
+		}
+	}
+	arm_sqrt_f32(mean[X_IDX] * mean[X_IDX] + mean[Y_IDX] * mean[Y_IDX] + mean[Z_IDX] * mean[Z_IDX], &norm);
+	if (fabsf(mean[nearestAxis]) < ACC_CALIB_FACE_MIN_ALIGNMENT * norm) {
+		return false;
+	}
+	face = 2 * nearestAxis + (mean[nearestAxis] < 0.0f ? 1 : 0);
+	if (faceSamples[face] >= NBR_OF_SAMPLES_IN_EACH_POSITION) {
+		return false;
+	}
+
+	for (i = 0; i < ACC_CALIB_REST_WINDOW; i++) {
+		addNewSample(windowSamples[i]);
+	}
+	faceSamples[face] += ACC_CALIB_REST_WINDOW;
+	if (faceSamples[face] < NBR_OF_SAMPLES_IN_EACH_POSITION) {
+		return false;
+	}
+
+	facesLeft = 0;
+	for (otherFace = 0; otherFace < NBR_SAMPLE_POSITIONS; otherFace++) {
+		if (faceSamples[otherFace] < NBR_OF_SAMPLES_IN_EACH_POSITION) {
+			facesLeft++;
+		}
+	}
+	snprintf(string, sizeof(string), "Accelerometer face %s done, %u left\n", faceNames[face], facesLeft);
+	USBComSendString(string);
+
+	if (facesLeft > 0) {
+		return false;
+	}
+
+	// Calibration done, reset internal variables.
+	memset(faceSamples, 0, sizeof(faceSamples));
+
+	return true;
 }
 
 void FetchDataFromAccelerometer(void) {
-    float32_t acceleroMeterData[3] = { 0.0f, 0.0f, 0.0f };
+    int16_t rawData[ACCMAG_AXES_N] = { 0, 0, 0 };
     HAL_StatusTypeDef status = HAL_OK;
+#ifdef FCB_ACC_FIFO_MODE
+    uint8_t nbrOfSamples = 0;
+    uint8_t i;
+    uint32_t readTimestamp;
+
+    if (ACCMAGMTR_UNINITIALISED == accMagMode) {
+        return;
+    }
+
+    status = LSM303DLHC_AccReadFIFOLevel(&nbrOfSamples);
+    readTimestamp = GetTimestamp();
+    if (status == HAL_OK && nbrOfSamples > 0) {
+        status = LSM303DLHC_AccReadFIFO(i2cRxBuffer, nbrOfSamples);
+    }
+    if (status != HAL_OK) { // Handle accelerometer read timeout error
+#if DIAG_ENABLED(ACCMAG, DIAG_ERROR)
+        LOG0("ERROR: LSM303DLHC_AccReadFIFO");
+#endif
+        FcbSensorReadFailed(ACC_IDX);
+        FcbSendSensorMessage(FCB_SENSOR_ACC_DATA_READY);
+        return;
+    }
+
+    for (i = 0; i < nbrOfSamples; i++) {
+        LSM303DLHC_AccRawXYZ(&i2cRxBuffer[i * LSM303DLHC_XYZ_BUFFER_SIZE], rawData);
+        processAccelerometerData(rawData, accelerometerFIFOSampleTimestamp(readTimestamp, i, nbrOfSamples));
+    }
+#else
 
     if (ACCMAGMTR_UNINITIALISED != accMagMode) {
-        status = LSM303DLHC_AccReadXYZ(acceleroMeterData);
+        status = LSM303DLHC_AccReadRawXYZ(rawData);
         if (status != HAL_OK) { // Handle accelerometer read timeout error
-#ifdef FCB_ACCMAG_DEBUG
-            USBComSendString("ERROR: LSM303DLHC_AccReadXYZ\n");
+#if DIAG_ENABLED(ACCMAG, DIAG_ERROR)
+            LOG0("ERROR: LSM303DLHC_AccReadRawXYZ");
 #endif
+            FcbSensorReadFailed(ACC_IDX);
             FcbSendSensorMessage(FCB_SENSOR_ACC_DATA_READY);
             return;
         }
     }
 
+    processAccelerometerData(rawData, GetSensorDrdyTimestamp(ACC_IDX));
+#endif
+}
+
+static void processAccelerometerData(const int16_t *rawData, uint32_t timestamp) {
+	float32_t acceleroMeterData[ACCMAG_AXES_N];
+	float32_t raw[ACCMAG_AXES_N];
+
+	SensorWatchdogFeed(ACC_IDX);
+
 	if (ACCMAGMTR_FETCHING == accMagMode) {
-		adjustAxesOrientation(acceleroMeterData);
-		applayCalibrationPrmToRawData(sXYZAccCalPrm, acceleroMeterData);
-		setXYZVector(acceleroMeterData, sXYZDotDot);
+		raw[X_IDX] = rawData[X_IDX];
+		raw[Y_IDX] = rawData[Y_IDX];
+		raw[Z_IDX] = rawData[Z_IDX];
+		compensateAccMagTemperature(ACCMAG_TEMP_COMP_ACC, raw);
+		applyMatrixFusedCalibration(raw, sAccGain, sAccBias, acceleroMeterData);
+		VibrationMonitorUpdate(ACC_IDX, acceleroMeterData, VibrationClippedAxesRaw(rawData));
+		SensorFilterApply(ACC_IDX, acceleroMeterData);
+		setXYZVector(&seqLockAcc, acceleroMeterData, sXYZDotDot);
+		SensorBusPublish(ACC_IDX, acceleroMeterData, timestamp);
+		AggregateSamples(AGGREGATE_ACC_X, acceleroMeterData, ACCMAG_AXES_N);
 
 	    if (SendCorrectionUpdateCallback != NULL) {
-            SendCorrectionUpdateCallback(ACC_IDX, sXYZDotDot);
+            SendCorrectionUpdateCallback(ACC_IDX, sXYZDotDot[SEQLOCK_PUBLISHED(&seqLockAcc)], timestamp);
 	    }
 	} else if (ACCMTR_CALIBRATING == accMagMode) {
-		if (handleAccSampling(acceleroMeterData)) {
-			calibrate(sXYZAccCalPrm);
-			WriteAccCalibrationValuesToFlash(sXYZAccCalPrm);
-
-			char string[100];
-			snprintf(string, 100,
-					"Calib acc value: %f\t: %f\t: %f: %f\t: %f\t: %f\n",
-					sXYZAccCalPrm[0], sXYZAccCalPrm[1], sXYZAccCalPrm[2],
-					sXYZAccCalPrm[3], sXYZAccCalPrm[4], sXYZAccCalPrm[5]);
-			USBComSendString(string);
-
-			/* calibration done */
+		if (handleAccSampling(rawData)) {
+			/* sampling done, the new calibration is used once solved */
+			submitCalibrationJob(ACC_IDX);
 			accMagMode = ACCMAGMTR_FETCHING;
 		}
 	}
 }
 
 void StartAccMagMtrCalibration(uint32_t samples) {
+    EllipsoidClearObservations(&magObservations);
     nbrOfSamplesForCalibration = samples;
+    sMagRawSumSamples = 0;
     accMagMode = MAGMTR_CALIBRATING;
 }
 
+bool IsAccMagCalibrated(void) {
+    return ACCMAGMTR_FETCHING == accMagMode;
+}
+
 void FetchDataFromMagnetometer(void) {
 	HAL_StatusTypeDef status = HAL_OK;
-	float32_t magnetoMeterData[3] = { 0.0f, 0.0f, 0.0f };
+	int16_t rawData[ACCMAG_AXES_N] = { 0, 0, 0 };
 
 	if (ACCMAGMTR_UNINITIALISED != accMagMode) {
-		status = LSM303DLHC_MagReadXYZ(magnetoMeterData);
+		status = LSM303DLHC_MagReadRawXYZ(rawData);
 		if (status != HAL_OK) {
-#ifdef FCB_ACCMAG_DEBUG
-			USBComSendString("ERROR: LSM303DLHC_MagReadXYZ\n");
+#if DIAG_ENABLED(ACCMAG, DIAG_ERROR)
+			LOG0("ERROR: LSM303DLHC_MagReadRawXYZ");
 #endif
+			FcbSensorReadFailed(MAG_IDX);
 			FcbSendSensorMessage(FCB_SENSOR_MAGNETO_DATA_READY);
 			return;
 		}
 	}
 
+	processMagnetometerData(rawData, GetSensorDrdyTimestamp(MAG_IDX));
+}
+
+/*
+ * Averages MAG_DECIMATION raw samples into one, which is temperature
+ * compensated, calibrated, published and corrects the yaw with the timestamp
+ * of its newest sample. The raw samples are used as they are while
+ * calibrating. The die temperature is read every ACCMAG_TEMP_READ_PERIOD.
+ */
+static void processMagnetometerData(const int16_t *rawData, uint32_t timestamp) {
+	float32_t magnetoMeterData[ACCMAG_AXES_N];
+	float32_t rawMean[ACCMAG_AXES_N];
+	uint8_t i;
+
+	SensorWatchdogFeed(MAG_IDX);
+
+	if (++sMagSamplesSinceTemperatureRead >= (uint32_t) (ACCMAG_TEMP_READ_PERIOD * LSM303DLHC_MagDataRateHz() / 1000)) {
+		readAccMagTemperature();
+	}
+
 	if (ACCMAGMTR_FETCHING == accMagMode) {
-		adjustAxesOrientation(magnetoMeterData);
-		applayCalibrationPrmToRawData(sXYZMagCalPrm, magnetoMeterData);
-		setXYZVector(magnetoMeterData, sXYZMagVector);
+		for (i = 0; i < ACCMAG_AXES_N; i++) {
+			sMagRawSum[i] = (sMagRawSumSamples ? sMagRawSum[i] : 0) + rawData[i];
+		}
+		if (++sMagRawSumSamples < MAG_DECIMATION) {
+			return;
+		}
+		for (i = 0; i < ACCMAG_AXES_N; i++) {
+			rawMean[i] = (float32_t) sMagRawSum[i] * (1.0f / MAG_DECIMATION);
+		}
+		sMagRawSumSamples = 0;
+
+		compensateAccMagTemperature(ACCMAG_TEMP_COMP_MAG, rawMean);
+		applyMatrixFusedCalibration(rawMean, sMagGain, sMagBias, magnetoMeterData);
+		updateMagOnlineCalibration(magnetoMeterData);
+		setXYZVector(&seqLockMag, magnetoMeterData, sXYZMagVector);
+		SensorBusPublish(MAG_IDX, magnetoMeterData, timestamp);
 
 		if (SendCorrectionUpdateCallback != NULL) {
-			SendCorrectionUpdateCallback(MAG_IDX, sXYZMagVector);
+			SendCorrectionUpdateCallback(MAG_IDX, sXYZMagVector[SEQLOCK_PUBLISHED(&seqLockMag)], timestamp);
 		}
 	} else if (MAGMTR_CALIBRATING == accMagMode) {
 		static uint32_t sampleIndex = 0;
 		if (sampleIndex < nbrOfSamplesForCalibration) {
+			float32_t scale[ACCMAG_AXES_N];
+
+			/* uncalibrated */
+			LSM303DLHC_MagScale(scale);
+			magnetoMeterData[X_IDX] = (float32_t) rawData[X_IDX] * scale[X_IDX];
+			magnetoMeterData[Y_IDX] = (float32_t) rawData[Y_IDX] * scale[Y_IDX];
+			magnetoMeterData[Z_IDX] = (float32_t) rawData[Z_IDX] * scale[Z_IDX];
+
 			adjustAxesOrientation(magnetoMeterData);
-			addNewSample(magnetoMeterData);
+			EllipsoidAddSample(&magObservations, magnetoMeterData);
 			sampleIndex++;
 		} else {
-			calibrate(sXYZMagCalPrm);
+			submitCalibrationJob(MAG_IDX);
 
-			WriteMagCalibrationValuesToFlash(sXYZMagCalPrm);
-
-			char string[100];
-			snprintf(string, 100,
-					"Calib mag value: %f\t: %f\t: %f: %f\t: %f\t: %f\n",
-					sXYZMagCalPrm[0], sXYZMagCalPrm[1], sXYZMagCalPrm[2],
-					sXYZMagCalPrm[3], sXYZMagCalPrm[4], sXYZMagCalPrm[5]);
-			USBComSendString(string);
-			USBComSendString("\nMove device to first position for Accelerometer calibration.\n");
+			USBComSendString("\nHold the device still with each of its six faces down in turn for Accelerometer calibration.\n");
 
 			/* calibration done */
 			accMagMode = ACCMTR_CALIBRATING;
@@ -336,75 +1301,388 @@ void FetchDataFromMagnetometer(void) {
 	}
 }
 
-void GetAcceleration(float32_t * xDotDot, float32_t * yDotDot, float32_t * zDotDot) {
-    if (pdTRUE != xSemaphoreTake(mutexAcc, portMAX_DELAY /* wait forever */)) {
-        ErrorHandler();
-        return;
-    }
+void RequestDataFromAccelerometer(void) {
+    requestAccMagRead(ACCMAG_I2C_READ_ACC);
+}
 
-    *xDotDot = sXYZDotDot[X_IDX];
-    *yDotDot = sXYZDotDot[Y_IDX];
-    *zDotDot = sXYZDotDot[Z_IDX];
+void RequestDataFromMagnetometer(void) {
+    requestAccMagRead(ACCMAG_I2C_READ_MAG);
+}
 
-    if (pdTRUE != xSemaphoreGive(mutexAcc)) {
-        ErrorHandler();
-        return;
+void AccMagReadCompleteFromISR(void) {
+    if (ACCMAG_I2C_READ_ACC == i2cActiveRead) {
+        FcbSendSensorMessageFromISR(FCB_SENSOR_ACC_READ_COMPLETE);
+    } else if (ACCMAG_I2C_READ_MAG == i2cActiveRead) {
+        FcbSendSensorMessageFromISR(FCB_SENSOR_MAGNETO_READ_COMPLETE);
     }
 }
 
-void GetAccelerationNoMutex(float32_t * xDotDot, float32_t * yDotDot, float32_t * zDotDot) {
-    *xDotDot = sXYZDotDot[X_IDX];
-    *yDotDot = sXYZDotDot[Y_IDX];
-    *zDotDot = sXYZDotDot[Z_IDX];
+void AccMagReadErrorFromISR(void) {
+    i2cActiveReadFailed = true;
+    AccMagReadCompleteFromISR();
 }
 
-void GetMagVector(float32_t * x, float32_t * y, float32_t * z) {
-    if (pdTRUE != xSemaphoreTake(mutexMag, portMAX_DELAY /* wait forever */)) {
-        ErrorHandler();
+void RecoverAccMagSensor(FcbSensorIndexType sensor, FcbSensorRecoveryType step) {
+    uint8_t read = (ACC_IDX == sensor) ? ACCMAG_I2C_READ_ACC : ACCMAG_I2C_READ_MAG;
+    uint8_t abandonedRead = i2cActiveRead;
+
+    if (ACCMAGMTR_UNINITIALISED == accMagMode || (ACC_IDX != sensor && MAG_IDX != sensor)) {
         return;
     }
 
-    *x = sXYZMagVector[X_IDX];
-    *y = sXYZMagVector[Y_IDX];
-    *z = sXYZMagVector[Z_IDX];
+    if (SENSOR_RECOVERY_REARM == step) {
+        /* a rising edge was missed, the pin stays high until the data is read */
+        if (ACC_IDX == sensor) {
+            __HAL_GPIO_EXTI_CLEAR_IT(GPIO_PIN_4);
+            HAL_NVIC_EnableIRQ(EXTI4_IRQn);
+        } else {
+            __HAL_GPIO_EXTI_CLEAR_IT(GPIO_PIN_2);
+            HAL_NVIC_EnableIRQ(EXTI2_TSC_IRQn);
+        }
+        requestAccMagRead(read); /* also abandons a timed out active read */
+        return;
+    }
 
-    if (pdTRUE != xSemaphoreGive(mutexMag)) {
-        ErrorHandler();
+    /* the active read is restarted after the bus has been used */
+    i2cActiveRead = ACCMAG_I2C_READ_NONE;
+    i2cActiveReadFailed = false;
+
+    if (SENSOR_RECOVERY_RESET == step) {
+        if (ACC_IDX == sensor) {
+            LSM303DLHC_AccConfig();
+#ifdef FCB_ACC_FIFO_MODE
+            if (LSM303DLHC_AccConfigFIFO(ACC_FIFO_DATA_RATE, ACC_FIFO_WATERMARK) != 0) {
+#if DIAG_ENABLED(ACCMAG, DIAG_ERROR)
+                LOG0("ERROR: LSM303DLHC_AccConfigFIFO");
+#endif
+            }
+#endif
+        } else {
+            LSM303DLHC_MagInit();
+            LSM303DLHC_MagConfigDataRate(sMagDataRate);
+            sMagRawSumSamples = 0;
+        }
+    } else if (SENSOR_RECOVERY_BUS == step) {
+        I2Cx_ResetBus();
+    }
+
+    requestAccMagRead(read | abandonedRead);
+}
+
+/*
+ * @brief  Reconfigures the accelerometer or the magnetometer with the data rate and high-pass cutoff nearest to
+ *         the requested ones, with the reset step of the recovery. In FIFO mode the accelerometer FIFO keeps its
+ *         own data rate. The magnetometer has no high-pass filter.
+ * @param  sensor : ACC_IDX or MAG_IDX
+ * @param  dataRateHz : Requested data rate in, selected one out [Hz]
+ * @param  highPassHz : Requested high-pass cutoff in, selected one out [Hz], 0 for off
+ * @retval FCB_OK, or FCB_ERR if not supported
+ */
+uint8_t SetAccMagRates(FcbSensorIndexType sensor, float32_t * dataRateHz, float32_t * highPassHz) {
+    if (ACCMAGMTR_UNINITIALISED == accMagMode) {
+        return FCB_ERR;
+    }
+
+    if (ACC_IDX == sensor) {
+        if (LSM303DLHC_AccSetRates(dataRateHz, highPassHz) != 0) {
+            return FCB_ERR;
+        }
+    } else if (MAG_IDX == sensor) {
+        if (*dataRateHz <= 0.0f) {
+            return FCB_ERR;
+        }
+        sMagDataRate = LSM303DLHC_MagNearestDataRate(dataRateHz);
+        *highPassHz = 0.0f;
+    } else {
+        return FCB_ERR;
+    }
+
+    RecoverAccMagSensor(sensor, SENSOR_RECOVERY_RESET);
+
+    if (ACC_IDX == sensor) {
+        *dataRateHz = (float32_t) LSM303DLHC_AccDataRateHz();
+    }
+    return FCB_OK;
+}
+
+void HandleAccMagReadComplete(void) {
+    int16_t rawData[ACCMAG_AXES_N] = { 0, 0, 0 };
+    uint8_t completedRead = i2cActiveRead;
+    uint8_t i;
+
+    i2cActiveRead = ACCMAG_I2C_READ_NONE;
+
+#ifdef FCB_SENSOR_LOAD_TEST
+    if (i2cActiveReadHeld) {
+        i2cActiveReadHeld = false;
+        if (ACCMAG_I2C_READ_ACC == completedRead) {
+            processAccelerometerData(sLoadTestAccRawData, i2cActiveReadTimestamp);
+            SensorLoadTestSample(ACC_IDX);
+        } else if (ACCMAG_I2C_READ_MAG == completedRead) {
+            processMagnetometerData(sLoadTestMagRawData, i2cActiveReadTimestamp);
+            SensorLoadTestSample(MAG_IDX);
+        }
+        startNextAccMagRead();
         return;
     }
+#endif
+
+    if (i2cActiveReadFailed) {
+        /* retry with a blocking read, it also re-initialises the bus on failure */
+        i2cActiveReadFailed = false;
+        if (ACCMAG_I2C_READ_ACC == completedRead) {
+            FcbSensorReadFailed(ACC_IDX);
+            FetchDataFromAccelerometer();
+        } else if (ACCMAG_I2C_READ_MAG == completedRead) {
+            FcbSensorReadFailed(MAG_IDX);
+            FetchDataFromMagnetometer();
+        }
+#ifdef FCB_ACC_FIFO_MODE
+    } else if (ACCMAG_I2C_READ_ACC == completedRead && i2cActiveReadIsFIFOLevel) {
+        /* the samples are read next, before the other queued reads */
+        if (HAL_OK == continueAccelerometerFIFORead()) {
+            return;
+        }
+#endif
+    } else if (ACCMAG_I2C_READ_ACC == completedRead) {
+        /* the whole batch is passed on at once, oldest sample first */
+        for (i = 0; i < i2cActiveReadSamples; i++) {
+            LSM303DLHC_AccRawXYZ(&i2cRxBuffer[i * LSM303DLHC_XYZ_BUFFER_SIZE], rawData);
+#ifdef FCB_SENSOR_LOAD_TEST
+            memcpy(sLoadTestAccRawData, rawData, sizeof(sLoadTestAccRawData));
+#endif
+#ifdef FCB_ACC_FIFO_MODE
+            processAccelerometerData(rawData,
+                    accelerometerFIFOSampleTimestamp(i2cActiveReadTimestamp, i, i2cActiveReadSamples));
+#else
+            processAccelerometerData(rawData, i2cActiveReadTimestamp);
+#endif
+        }
+    } else if (ACCMAG_I2C_READ_MAG == completedRead) {
+        LSM303DLHC_MagRawXYZ(i2cRxBuffer, rawData);
+#ifdef FCB_SENSOR_LOAD_TEST
+        memcpy(sLoadTestMagRawData, rawData, sizeof(sLoadTestMagRawData));
+#endif
+        processMagnetometerData(rawData, i2cActiveReadTimestamp);
+    }
+
+    /* chain the next queued read */
+    startNextAccMagRead();
+}
+
+void GetAcceleration(float32_t * xDotDot, float32_t * yDotDot, float32_t * zDotDot) {
+    uint32_t sequence;
+
+    do {
+        sequence = SeqLockReadBegin(&seqLockAcc);
+        *xDotDot = sXYZDotDot[SEQLOCK_COPY(sequence)][X_IDX];
+        *yDotDot = sXYZDotDot[SEQLOCK_COPY(sequence)][Y_IDX];
+        *zDotDot = sXYZDotDot[SEQLOCK_COPY(sequence)][Z_IDX];
+    } while (SeqLockReadRetry(&seqLockAcc, sequence));
+}
+
+void GetAccelerationNoMutex(float32_t * xDotDot, float32_t * yDotDot, float32_t * zDotDot) {
+    const float32_t *dotDot = sXYZDotDot[SEQLOCK_PUBLISHED(&seqLockAcc)];
+
+    *xDotDot = dotDot[X_IDX];
+    *yDotDot = dotDot[Y_IDX];
+    *zDotDot = dotDot[Z_IDX];
+}
+
+void GetMagVector(float32_t * x, float32_t * y, float32_t * z) {
+    uint32_t sequence;
+
+    do {
+        sequence = SeqLockReadBegin(&seqLockMag);
+        *x = sXYZMagVector[SEQLOCK_COPY(sequence)][X_IDX];
+        *y = sXYZMagVector[SEQLOCK_COPY(sequence)][Y_IDX];
+        *z = sXYZMagVector[SEQLOCK_COPY(sequence)][Z_IDX];
+    } while (SeqLockReadRetry(&seqLockMag, sequence));
 }
 
 void GetMagVectorNoMutex(float32_t * x, float32_t * y, float32_t * z) {
-    *x = sXYZMagVector[X_IDX];
-    *y = sXYZMagVector[Y_IDX];
-    *z = sXYZMagVector[Z_IDX];
+    const float32_t *magVector = sXYZMagVector[SEQLOCK_PUBLISHED(&seqLockMag)];
+
+    *x = magVector[X_IDX];
+    *y = magVector[Y_IDX];
+    *z = magVector[Z_IDX];
 }
 
 void PrintAccelerometerValues(void) {
     static char sampleString[ACCMAG_SAMPLING_MAX_STRING_SIZE];
 
     // TODO use mutex
-    snprintf((char*) sampleString, ACCMAG_SAMPLING_MAX_STRING_SIZE,
-            "Accelerometer readings [m/(s * s)]:\nAccX: %f\nAccY: %f\nAccZ: %f\n\r\n", sXYZDotDot[X_IDX],
-            sXYZDotDot[Y_IDX], sXYZDotDot[Z_IDX]);
+    FormatFixedList(sampleString, ACCMAG_SAMPLING_MAX_STRING_SIZE,
+            "Accelerometer readings [m/(s * s)]:\nAccX: %f\nAccY: %f\nAccZ: %f\n\r\n",
+            sXYZDotDot[SEQLOCK_PUBLISHED(&seqLockAcc)], 3);
 
     USBComSendString(sampleString);
 }
 
+/*
+ * Queues a read of the acc or mag output registers. Called in the SENSORS
+ * task context only.
+ */
+static void requestAccMagRead(uint8_t read) {
+    if (ACCMAGMTR_UNINITIALISED == accMagMode) {
+        return;
+    }
+
+    i2cPendingReads |= read;
+    startNextAccMagRead();
+}
+
+/*
+ * Starts the next queued read unless one is already ongoing, in which case it
+ * is started once the ongoing read completes. Accelerometer reads go first.
+ * If a read can't be started the blocking read is used instead.
+ */
+static void startNextAccMagRead(void) {
+    HAL_StatusTypeDef status = HAL_OK;
+    uint8_t nextRead;
+
+    if (ACCMAG_I2C_READ_NONE != i2cActiveRead) {
+        if (HAL_GetTick() - i2cActiveReadStartTime <= ACCMAG_I2C_READ_TIMEOUT) {
+            return;
+        }
+        /* completion was never signalled, e.g. the read complete interrupt was lost */
+        i2cActiveRead = ACCMAG_I2C_READ_NONE;
+    }
+
+    while (ACCMAG_I2C_READ_NONE != i2cPendingReads) {
+        nextRead = (i2cPendingReads & ACCMAG_I2C_READ_ACC) ? ACCMAG_I2C_READ_ACC : ACCMAG_I2C_READ_MAG;
+        i2cPendingReads &= ~nextRead;
+
+        /* must be set before starting, completion may be signalled at any time after that */
+        i2cActiveRead = nextRead;
+        i2cActiveReadStartTime = HAL_GetTick();
+
+        i2cActiveReadSamples = 1;
+#ifdef FCB_ACC_FIFO_MODE
+        i2cActiveReadIsFIFOLevel = false;
+#endif
+
+#ifdef FCB_SENSOR_LOAD_TEST
+        if (SensorLoadTestIsActive()) {
+            /* completed at once, HandleAccMagReadComplete passes the held sample on */
+            i2cActiveReadTimestamp = GetSensorDrdyTimestamp((ACCMAG_I2C_READ_ACC == nextRead) ? ACC_IDX : MAG_IDX);
+            i2cActiveReadHeld = true;
+            FcbSendSensorMessage((ACCMAG_I2C_READ_ACC == nextRead) ?
+                    FCB_SENSOR_ACC_READ_COMPLETE : FCB_SENSOR_MAGNETO_READ_COMPLETE);
+            return;
+        }
+#endif
+
+        if (ACCMAG_I2C_READ_ACC == nextRead) {
+#ifdef FCB_ACC_FIFO_MODE
+            status = startAccelerometerFIFORead();
+#else
+            i2cActiveReadTimestamp = GetSensorDrdyTimestamp(ACC_IDX);
+            status = LSM303DLHC_AccStartReadXYZ_IT(i2cRxBuffer);
+#endif
+        } else {
+            i2cActiveReadTimestamp = GetSensorDrdyTimestamp(MAG_IDX);
+            status = LSM303DLHC_MagStartReadXYZ_IT(i2cRxBuffer);
+        }
+
+        if (HAL_OK == status) {
+            return;
+        }
+
+        i2cActiveRead = ACCMAG_I2C_READ_NONE;
+
+        if (ACCMAG_I2C_READ_ACC == nextRead) {
+            FetchDataFromAccelerometer();
+        } else {
+            FetchDataFromMagnetometer();
+        }
+    }
+}
+
+#ifdef FCB_ACC_FIFO_MODE
+/*
+ * Starts a non-blocking read of the FIFO level, the first of the two reads of
+ * a FIFO batch. Its completion starts the read of the samples, see
+ * continueAccelerometerFIFORead.
+ */
+static HAL_StatusTypeDef startAccelerometerFIFORead(void) {
+    i2cActiveReadIsFIFOLevel = true;
+    i2cActiveReadTimestamp = GetTimestamp();
+
+    return LSM303DLHC_AccStartReadFIFOLevel_IT(i2cRxBuffer);
+}
+
+/*
+ * Starts a non-blocking read of all unread samples, with the FIFO level read by
+ * startAccelerometerFIFORead. Only called from HandleAccMagReadComplete, which
+ * has cleared the active read. An empty FIFO has nothing to read, a read that
+ * can't be started falls back to FetchDataFromAccelerometer.
+ */
+static HAL_StatusTypeDef continueAccelerometerFIFORead(void) {
+    uint8_t nbrOfSamples = LSM303DLHC_AccFIFOLevel(i2cRxBuffer[0]);
+
+    i2cActiveReadIsFIFOLevel = false;
+    if (0 == nbrOfSamples) {
+        return HAL_ERROR;
+    }
+
+    i2cActiveRead = ACCMAG_I2C_READ_ACC;
+    i2cActiveReadStartTime = HAL_GetTick();
+    i2cActiveReadSamples = nbrOfSamples;
+
+    if (HAL_OK == LSM303DLHC_AccStartReadFIFO_IT(i2cRxBuffer, nbrOfSamples)) {
+        return HAL_OK;
+    }
+
+    i2cActiveRead = ACCMAG_I2C_READ_NONE;
+    FetchDataFromAccelerometer();
+    return HAL_ERROR;
+}
+
+/*
+ * The newest sample of a FIFO batch is taken to be from the time the FIFO
+ * level was read, the earlier ones are spaced by the nominal sample period.
+ */
+static uint32_t accelerometerFIFOSampleTimestamp(uint32_t readTimestamp, uint8_t sample, uint8_t nbrOfSamples) {
+    return readTimestamp - (nbrOfSamples - 1 - sample) * (SystemCoreClock / ACC_FIFO_DATA_RATE_HZ);
+}
+#endif
+
 uint8_t CheckCalParams(float32_t* calPrms) {
 	uint8_t status = FCB_OK;
 
-	if (calPrms[X_SCALING_CALIB_IDX] < 0.1) {
+	if (calPrms[X_SCALING_CALIB_IDX] < 0.1f) {
 		status = FCB_ERR;
-	} else if (calPrms[Y_SCALING_CALIB_IDX] < 0.1) {
+	} else if (calPrms[Y_SCALING_CALIB_IDX] < 0.1f) {
 		status = FCB_ERR;
-	} else if (calPrms[Z_SCALING_CALIB_IDX] < 0.1) {
+	} else if (calPrms[Z_SCALING_CALIB_IDX] < 0.1f) {
 		status = FCB_ERR;
 	}
 
 	return status;
 }
 
+/*
+ * Checks that a magnetometer calibration is usable: no NaNs, and the positive
+ * diagonal of a positive definite correction matrix
+ */
+static uint8_t CheckMagCalParams(const float32_t* calPrms) {
+	uint8_t i;
+
+	for (i = 0; i < MAG_CALIB_IDX_MAX; i++) {
+		if (isnan(calPrms[i])) {
+			return FCB_ERR;
+		}
+	}
+
+	if (!(calPrms[MAG_XX_CORRECTION_CALIB_IDX] > 0.0f) || !(calPrms[MAG_YY_CORRECTION_CALIB_IDX] > 0.0f)
+			|| !(calPrms[MAG_ZZ_CORRECTION_CALIB_IDX] > 0.0f)) {
+		return FCB_ERR;
+	}
+
+	return FCB_OK;
+}
+
 /**
  * @}
  */
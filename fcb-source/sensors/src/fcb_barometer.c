@@ -8,26 +8,38 @@
 #include "fcb_barometer.h"
 #include "bmp180.h"
 #include "fcb_sensors.h"
+#include "fcb_sensor_bus.h"
+#include "fcb_sensor_watchdog.h"
+#include "fcb_sensor_self_test.h"
+#include "flight_control.h"
 #include "fcb_error.h"
 
 #include "fcb_retval.h"
+#include "common.h"
+#include "fast_math.h"
+#include "profiler.h"
 #include "arm_math.h"
 
 #include "FreeRTOS.h"
-#include "semphr.h"
-#include "timers.h"
+#include "task.h"
 #include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
 
 /* Private define ------------------------------------------------------------*/
 
-// Define the period for starting and reading new pressure values in mSec.
-// Note that the actual period set to the timer will be half of this as also one
-// temperature reading will done for every pressure reading. Minimum time for both
-// temperature and pressure readings are 4.5 mSec each (without any filters).
-#define FCB_SENSOR_BAR_PERIOD	10
+#define BAROMETER_TIM_RATE      1000000 // Counter clock [Hz]
+#define BAROMETER_RETRY_TIME    (BAROMETER_RETRY_DELAY * (BAROMETER_TIM_RATE / 1000))
 
 /* Private typedef -----------------------------------------------------------*/
 
+typedef enum {
+    BARO_STATE_IDLE = 0,        /* not initialised */
+    BARO_STATE_CONVERSION,      /* conversion start written or conversion timer running */
+    BARO_STATE_READ,            /* result read ongoing */
+    BARO_STATE_RETRY_WAIT       /* conversion timer running after a failed transfer */
+} BarometerStateType;
+
 typedef enum {
 	PRESSURE_MEASUREMENT = 0x30,
 	TEMPERATURE_MEASUREMENT = 0x31
@@ -37,57 +49,192 @@ typedef enum {
 
 /* Private variables ---------------------------------------------------------*/
 
-static xTimerHandle barometerTimer;
+TIM_HandleTypeDef BarometerTimHandle;
+
+/* State machine, only stepped in the SENSORS task */
+static BarometerStateType barometerState = BARO_STATE_IDLE;
 static CurrentMeasurementType currentMeasurementType;
+static uint8_t conversionOss; /* over sampling of the ongoing pressure conversion */
+static uint32_t lastStepTick;
+static uint32_t lastTemperatureTick;
+
+/* Read by the write complete ISR to start the conversion timer [us] */
+static volatile uint32_t conversionTime;
+static volatile bool isTransferFailed = false;
+
+/* Set by SetBarometerConfig, taken into use at the next conversion */
+static uint8_t configOss = BAROMETER_DEFAULT_OSS;
+static uint32_t configTemperaturePeriod = BAROMETER_DEFAULT_TEMPERATURE_PERIOD;
+
+/* Altitude reference, the inverse is what the pressures are scaled with */
+static BarometerReferenceType referenceType = BAROMETER_REFERENCE_STANDARD;
+static float32_t referencePressure = BAROMETER_STANDARD_PRESSURE;
+static float32_t invReferencePressure = 1.0f / BAROMETER_STANDARD_PRESSURE;
+static bool isReferenceInitialised = true;
+
+static FcbBarometerStatsType barometerStats;
+static uint32_t statsStartTick;
 
 static SendCorrectionUpdateCallback_TypeDef SendCorrectionUpdateCallback = NULL;
 static float32_t sAltitude;
 
 /* Private function prototypes -----------------------------------------------*/
 
-static void InitBarometerTimeEvent(void);
+static FcbRetValType InitBarometerTimer(void);
+static void StartBarometerTimer(uint32_t duration);
+static void StartNextConversion(void);
+static void RetryConversion(HAL_StatusTypeDef status);
+static void ResetBarometerStats(void);
+static void UpdateReferencePressure(int32_t pressure);
 static float32_t CalcAltitudeFromPressure(int32_t pressure);
 
 /* Exported functions --------------------------------------------------------*/
 
 uint8_t FcbInitialiseBarometer(void) {
-    uint8_t retVal = FCB_OK;
-
     BMP180_init();
+    SensorSelfTestSetResult(BARO_IDX, BMP180_IsCalibValid() ? SENSOR_SELF_TEST_PASSED : SENSOR_SELF_TEST_FAILED, NULL,
+            0.0f);
 
-    currentMeasurementType = TEMPERATURE_MEASUREMENT;
-    InitBarometerTimeEvent();
-    BMP180_StartTemperatureMeasure();
+    if (FCB_OK != InitBarometerTimer()) {
+        ErrorHandler();
+        return FCB_ERR_INIT;
+    }
+
+    ResetBarometerStats();
 
-    return retVal;
+    /* a temperature first, the pressures are compensated with it */
+    lastTemperatureTick = xTaskGetTickCount() - configTemperaturePeriod;
+    StartNextConversion();
+
+    return FCB_OK;
 }
 
-void vTimerCallback( xTimerHandle pxTimer ) {
-	FcbSendSensorMessage(FCB_SENSOR_BAR_DATA_READY);
+/*
+ * Handles FCB_SENSOR_BAR_DATA_READY, the conversion timer elapsed. Reads the
+ * finished conversion, or restarts the conversion after a failed transfer.
+ */
+void RequestDataFromBarometer(void) {
+    HAL_StatusTypeDef status;
+
+    if (BARO_STATE_RETRY_WAIT == barometerState) {
+        StartNextConversion();
+        return;
+    }
+
+    if (BARO_STATE_CONVERSION != barometerState) {
+        return; /* stale event of a transfer ended by a restart */
+    }
+
+    lastStepTick = xTaskGetTickCount();
+    barometerState = BARO_STATE_READ;
+    isTransferFailed = false;
+
+    if (PRESSURE_MEASUREMENT == currentMeasurementType) {
+        status = BMP180_StartReadPressure_IT();
+    } else {
+        status = BMP180_StartReadTemperature_IT();
+    }
+
+    if (HAL_OK != status) {
+        RetryConversion(status);
+    }
 }
 
-void FetchDataFromBarometer(void) {
-    if (currentMeasurementType == PRESSURE_MEASUREMENT) {
-        int32_t pressureData = 0;
-        BMP180_ReadPressureValue(&pressureData);
-        float32_t newAltitude = CalcAltitudeFromPressure(pressureData);
+/*
+ * Handles FCB_SENSOR_BAR_READ_COMPLETE, a read completed or a transfer failed.
+ * The next conversion is started before the result is processed.
+ */
+void HandleBarometerReadComplete(void) {
+    PROFILE_SCOPE(PROFILE_PROBE_BARO_FETCH);
+
+    if (BARO_STATE_CONVERSION != barometerState && BARO_STATE_READ != barometerState) {
+        return;
+    }
+
+    if (isTransferFailed || BARO_STATE_CONVERSION == barometerState) {
+        /* only the error callback completes in the conversion state */
+        RetryConversion(HAL_ERROR);
+        return;
+    }
+
+    if (PRESSURE_MEASUREMENT == currentMeasurementType) {
+        uint8_t oss = conversionOss;
+        int32_t pressureData = BMP180_ConvertPressureValue(oss);
+        uint32_t timestamp = GetTimestamp();
+        float32_t newAltitude[3];
+
+        StartNextConversion();
+
+        UpdateReferencePressure(pressureData);
+        newAltitude[0] = CalcAltitudeFromPressure(pressureData);
+        newAltitude[1] = 0.0f; /* callbacks take 3 values */
+        newAltitude[2] = 0.0f;
+
+        SensorWatchdogFeed(BARO_IDX);
+        SensorBusPublish(BARO_IDX, newAltitude, timestamp);
 
         if (SendCorrectionUpdateCallback != NULL) {
-            SendCorrectionUpdateCallback(BARO_IDX, &newAltitude);
+            SendCorrectionUpdateCallback(BARO_IDX, newAltitude, timestamp);
         }
 
-        sAltitude = newAltitude;
+        sAltitude = newAltitude[0];
+
+        taskENTER_CRITICAL();
+        barometerStats.pressureSamples++;
+        barometerStats.altitude = newAltitude[0];
+        barometerStats.referencePressure = referencePressure;
+        taskEXIT_CRITICAL();
+    } else {
+        BMP180_UpdateInternalTempValue();
+        lastTemperatureTick = xTaskGetTickCount();
+
+        StartNextConversion();
+
+        taskENTER_CRITICAL();
+        barometerStats.temperatureSamples++;
+        barometerStats.temperature = BMP180_GetTemperature();
+        taskEXIT_CRITICAL();
+    }
+}
+
+/*
+ * Restarts the barometer if a completion of the state machine never arrived,
+ * called on every tick of the sensor watchdog.
+ */
+void CheckBarometerTimeout(void) {
+    if (BARO_STATE_IDLE == barometerState || xTaskGetTickCount() - lastStepTick < BAROMETER_TIMEOUT) {
+        return;
+    }
+
+    __HAL_TIM_DISABLE(&BarometerTimHandle);
+    I2Cbar_ResetBus();
+
+    taskENTER_CRITICAL();
+    barometerStats.timeouts++;
+    barometerStats.busRecoveries++;
+    taskEXIT_CRITICAL();
+
+    StartNextConversion();
+}
+
+/*
+ * The conversion start was written, the conversion runs from now on
+ */
+void BarometerConversionStartedFromISR(void) {
+    StartBarometerTimer(conversionTime);
+}
+
+void BarometerTimerElapsedFromISR(void) {
+    FcbSendSensorMessageFromISR(FCB_SENSOR_BAR_DATA_READY);
+}
+
+void BarometerReadCompleteFromISR(void) {
+    FcbSendSensorMessageFromISR(FCB_SENSOR_BAR_READ_COMPLETE);
+}
 
-        // Start a new temperature measurement.
-		currentMeasurementType = TEMPERATURE_MEASUREMENT;
-        BMP180_StartTemperatureMeasure();
-	}
-	else if (currentMeasurementType == TEMPERATURE_MEASUREMENT) {
-		BMP180_UpdateInternalTempValue();
-		// Start a new pressure measurement.
-		currentMeasurementType = PRESSURE_MEASUREMENT;
-        BMP180_StartPressureMeasure();
-	}
+void BarometerReadErrorFromISR(void) {
+    isTransferFailed = true;
+    BarometerReadCompleteFromISR();
 }
 
 uint8_t SensorRegisterBaroClientCallback(SendCorrectionUpdateCallback_TypeDef cbk) {
@@ -100,32 +247,235 @@ uint8_t SensorRegisterBaroClientCallback(SendCorrectionUpdateCallback_TypeDef cb
     return FCB_OK;
 }
 
+/*
+ * @brief  Sets the pressure over sampling and the temperature refresh period
+ * @param  oss : 0 to BMP180_OSS_MAX
+ * @param  temperaturePeriod : [ms] 1 to BAROMETER_MAX_TEMPERATURE_PERIOD
+ * @retval FCB_OK, FCB_ERR if out of range or not in idle mode
+ */
+FcbRetValType SetBarometerConfig(const uint8_t oss, const uint32_t temperaturePeriod) {
+    if (oss > BMP180_OSS_MAX || temperaturePeriod < 1 || temperaturePeriod > BAROMETER_MAX_TEMPERATURE_PERIOD
+            || FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        return FCB_ERR;
+    }
+
+    taskENTER_CRITICAL();
+    configOss = oss;
+    configTemperaturePeriod = temperaturePeriod;
+    ResetBarometerStats();
+    taskEXIT_CRITICAL();
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Sets the reference pressure of the altitude
+ * @param  reference : see BarometerReferenceType
+ * @param  pressure : [Pa] BAROMETER_MIN_REFERENCE_PRESSURE to BAROMETER_MAX_REFERENCE_PRESSURE, fixed reference only
+ * @retval FCB_OK, FCB_ERR if out of range or not in idle mode
+ */
+FcbRetValType SetBarometerReference(const BarometerReferenceType reference, const uint32_t pressure) {
+    if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        return FCB_ERR;
+    }
+
+    taskENTER_CRITICAL();
+    switch (reference) {
+    case BAROMETER_REFERENCE_STANDARD:
+        referencePressure = BAROMETER_STANDARD_PRESSURE;
+        isReferenceInitialised = true;
+        break;
+    case BAROMETER_REFERENCE_FIXED:
+        if (pressure < BAROMETER_MIN_REFERENCE_PRESSURE || pressure > BAROMETER_MAX_REFERENCE_PRESSURE) {
+            taskEXIT_CRITICAL();
+            return FCB_ERR;
+        }
+        referencePressure = (float32_t) pressure;
+        isReferenceInitialised = true;
+        break;
+    case BAROMETER_REFERENCE_ARMING:
+        /* kept until the first pressure */
+        isReferenceInitialised = false;
+        break;
+    default:
+        taskEXIT_CRITICAL();
+        return FCB_ERR;
+    }
+    referenceType = reference;
+    invReferencePressure = 1.0f / referencePressure;
+    ResetBarometerStats();
+    taskEXIT_CRITICAL();
+
+    return FCB_OK;
+}
+
+void GetBarometerStats(FcbBarometerStatsType * dstStats) {
+    taskENTER_CRITICAL();
+    *dstStats = barometerStats;
+    dstStats->duration = xTaskGetTickCount() - statsStartTick;
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Formats the barometer configuration and statistics
+ * @param  dst : String buffer
+ * @param  dstSize : Size of dst
+ * @retval see snprintf
+ */
+size_t PrintBarometerStats(char * dst, const size_t dstSize) {
+    FcbBarometerStatsType stats;
+    uint32_t rate = 0; /* [0.1 Hz] */
+    static const char * const referenceNames[] = { "standard", "fixed", "arming" };
+
+    GetBarometerStats(&stats);
+
+    if (stats.duration > 0) {
+        rate = (uint32_t) ((uint64_t) stats.pressureSamples * 10000 / stats.duration);
+    }
+
+    return snprintf(dst, dstSize, "Barometer: oss %u, temperature period %u ms, pressure conversion %u us\r\n"
+            "Pressures: %u (%u.%u Hz), temperatures: %u, failures: %u, timeouts: %u, bus recoveries: %u, over %u ms\r\n"
+            "Temperature: %d.%u C, altitude: %d cm, reference: %s %u Pa\r\n",
+            (unsigned int) stats.oss, (unsigned int) stats.temperaturePeriod,
+            (unsigned int) BMP180_GetPressureConversionTime(stats.oss), (unsigned int) stats.pressureSamples,
+            (unsigned int) (rate / 10), (unsigned int) (rate % 10), (unsigned int) stats.temperatureSamples,
+            (unsigned int) stats.failures, (unsigned int) stats.timeouts, (unsigned int) stats.busRecoveries,
+            (unsigned int) stats.duration,
+            (int) (stats.temperature / 10), (unsigned int) ((stats.temperature < 0 ? -stats.temperature :
+                    stats.temperature) % 10), (int) (stats.altitude * 100.0f), referenceNames[stats.reference],
+            (unsigned int) (stats.referencePressure + 0.5f));
+}
+
 void GetAltitude(float32_t * alt) {
     *alt = sAltitude;
 }
 
 /* Private functions ---------------------------------------------------------*/
 
-static void InitBarometerTimeEvent(void) {
-	barometerTimer = xTimerCreate((signed char *)"BarometerTimer",         // Just a text name, not used by the kernel.
-			                      FCB_SENSOR_BAR_PERIOD,                   // The timer period in ticks.
-                                  pdTRUE,                                  // The timer will auto-reload it selves when expired.
-                                  (void *)PRESSURE_MEASUREMENT,            // Assign timer a unique id.
-                                  vTimerCallback                           // Timer calls this callback when it expires.
-                                  );
+/*
+ * Configures the conversion timer, TIM16 is on APB2 and counts at the core
+ * clock before the prescaler. One pulse, started for each conversion.
+ */
+static FcbRetValType InitBarometerTimer(void) {
+    BarometerTimHandle.Instance = BAROMETER_TIM;
+    BarometerTimHandle.Init.Period = 0xFFFF;
+    BarometerTimHandle.Init.Prescaler = SystemCoreClock / BAROMETER_TIM_RATE - 1;
+    BarometerTimHandle.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    BarometerTimHandle.Init.CounterMode = TIM_COUNTERMODE_UP;
+    BarometerTimHandle.Init.RepetitionCounter = 0;
+
+    if (HAL_OK != HAL_TIM_Base_Init(&BarometerTimHandle)) {
+        return FCB_ERR;
+    }
+
+    BarometerTimHandle.Instance->CR1 |= TIM_CR1_OPM;
+
+    return FCB_OK;
+}
+
+/*
+ * Starts the conversion timer, FCB_SENSOR_BAR_DATA_READY is sent when it
+ * elapses. Called from the SENSORS task and from the I2C write complete ISR.
+ */
+static void StartBarometerTimer(uint32_t duration) {
+    __HAL_TIM_DISABLE(&BarometerTimHandle);
+    __HAL_TIM_SetCounter(&BarometerTimHandle, 0);
+    __HAL_TIM_SetAutoreload(&BarometerTimHandle, duration - 1);
+    __HAL_TIM_CLEAR_IT(&BarometerTimHandle, TIM_IT_UPDATE);
+    __HAL_TIM_ENABLE_IT(&BarometerTimHandle, TIM_IT_UPDATE);
+    __HAL_TIM_ENABLE(&BarometerTimHandle);
+}
 
-	if (barometerTimer == NULL ) {
-		ErrorHandler();
+/*
+ * Starts a temperature conversion if the temperature period passed, else a
+ * pressure conversion with the configured over sampling
+ */
+static void StartNextConversion(void) {
+    HAL_StatusTypeDef status;
+    uint32_t now = xTaskGetTickCount();
+
+    lastStepTick = now;
+    barometerState = BARO_STATE_CONVERSION;
+    isTransferFailed = false;
+
+    if (now - lastTemperatureTick >= configTemperaturePeriod) {
+        currentMeasurementType = TEMPERATURE_MEASUREMENT;
+        conversionTime = BMP180_GetTemperatureConversionTime();
+        status = BMP180_StartTemperatureMeasure_IT();
+    } else {
+        currentMeasurementType = PRESSURE_MEASUREMENT;
+        conversionOss = configOss;
+        conversionTime = BMP180_GetPressureConversionTime(conversionOss);
+        status = BMP180_StartPressureMeasure_IT(conversionOss);
     }
 
-    if (xTimerStart(barometerTimer, 0) != pdPASS ) {
-      	ErrorHandler();
+    if (HAL_OK != status) {
+        RetryConversion(status);
     }
 }
 
-static float32_t CalcAltitudeFromPressure(int32_t pressure) {
-	float32_t tmp = powf((float32_t)pressure / 101325.0f, 1.0f/5.255f);
-	float32_t altitude = 44330.0f * ( 1.0f - tmp);
+/*
+ * Counts a failed transfer and starts the next conversion after
+ * BAROMETER_RETRY_DELAY. A bus that stays busy, a timeout or a bus error
+ * resets the bus first, a not acknowledged transfer is only retried.
+ */
+static void RetryConversion(HAL_StatusTypeDef status) {
+    bool isBusReset = (HAL_BUSY == status || HAL_TIMEOUT == status
+            || 0 != (I2Cbar_GetError() & (HAL_I2C_ERROR_BERR | HAL_I2C_ERROR_ARLO | HAL_I2C_ERROR_TIMEOUT)));
+
+    lastStepTick = xTaskGetTickCount();
+    barometerState = BARO_STATE_RETRY_WAIT;
+
+    if (isBusReset) {
+        I2Cbar_ResetBus();
+    }
+
+    taskENTER_CRITICAL();
+    barometerStats.failures++;
+    if (isBusReset) {
+        barometerStats.busRecoveries++;
+    }
+    taskEXIT_CRITICAL();
+
+    StartBarometerTimer(BAROMETER_RETRY_TIME);
+}
+
+/*
+ * Clears the statistics, called with the interrupts masked or before the state machine runs
+ */
+static void ResetBarometerStats(void) {
+    int32_t temperature = barometerStats.temperature;
+    float32_t altitude = barometerStats.altitude;
+
+    memset(&barometerStats, 0, sizeof(barometerStats));
+    barometerStats.oss = configOss;
+    barometerStats.temperaturePeriod = configTemperaturePeriod;
+    barometerStats.reference = referenceType;
+    barometerStats.referencePressure = referencePressure;
+    barometerStats.temperature = temperature;
+    barometerStats.altitude = altitude;
+    statsStartTick = xTaskGetTickCount();
+}
 
-	return altitude;
+/*
+ * Follows the pressure with the arming reference while in idle mode, so that
+ * the altitude is relative to the take-off point. The reference freezes when
+ * the flight control leaves idle mode, there is no step in the altitude then.
+ */
+static void UpdateReferencePressure(int32_t pressure) {
+    if (BAROMETER_REFERENCE_ARMING != referenceType || FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        return;
+    }
+
+    if (!isReferenceInitialised) {
+        referencePressure = (float32_t) pressure;
+        isReferenceInitialised = true;
+    } else {
+        referencePressure += BAROMETER_ARMING_REFERENCE_ALPHA * ((float32_t) pressure - referencePressure);
+    }
+    invReferencePressure = 1.0f / referencePressure;
+}
+
+static float32_t CalcAltitudeFromPressure(int32_t pressure) {
+    return FastBarometricAltitude((float32_t) pressure * invReferencePressure);
 }
@@ -0,0 +1,326 @@
+/******************************************************************************
+ * @file    fcb_battery.c
+ * @author  Dragonfly
+ * @brief   Implementation of interface publicised in fcb_battery.h
+ ******************************************************************************/
+
+#include "fcb_battery.h"
+
+#ifdef FCB_BATTERY_MONITOR
+
+#include "telemetry_aggregate.h"
+#include "deferred_log.h"
+#include "fixed_format.h"
+#ifdef BATTERY_INPUT_IS_DRONECAN
+#include "dronecan.h"
+#endif
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+/* Private define ------------------------------------------------------------*/
+#define BATTERY_ADC_BUFFER_SIZE     (BATTERY_ADC_CHANNELS * BATTERY_ADC_OVERSAMPLING)
+#define BATTERY_VOLTAGE_IDX         0
+#define BATTERY_CURRENT_IDX         1
+
+/* Private variables ---------------------------------------------------------*/
+#ifndef BATTERY_INPUT_IS_DRONECAN
+static ADC_HandleTypeDef batteryAdcHandle;
+
+/* Circular DMA buffer, the channels of a sequence are interleaved */
+static volatile uint16_t batteryAdcBuffer[BATTERY_ADC_BUFFER_SIZE];
+#endif
+static bool isBatteryInputStarted = false;
+
+/* Written by the flight control task, read by other tasks in critical sections */
+static FcbBatteryStateType batteryState;
+
+/* Level the voltage is below, waiting for BATTERY_LEVEL_DELAY to enter it */
+static FcbBatteryStatusType pendingStatus = BATTERY_NOT_CONNECTED;
+static uint32_t pendingStatusTick = 0;
+static uint32_t lastUpdateTick = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+#ifndef BATTERY_INPUT_IS_DRONECAN
+static float32_t averageAdcChannel(const uint8_t channelIdx);
+#endif
+static void updateBatteryStatus(const uint32_t tick, const float32_t cellVoltage);
+static float32_t levelCellVoltage(const FcbBatteryStatusType status);
+static const char* batteryStatusString(const FcbBatteryStatusType status);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Calibrates ADC3 and starts the continuous conversions of the battery channels into the DMA buffer. With
+ *         BATTERY_INPUT_IS_DRONECAN only the state is reset, the DRONECAN task receives the measurements.
+ * @param  None
+ * @retval FCB_OK if started, FCB_ERR_INIT if the ADC could not be configured
+ */
+FcbRetValType FcbInitialiseBattery(void) {
+#ifdef BATTERY_INPUT_IS_DRONECAN
+    memset(&batteryState, 0, sizeof(batteryState));
+    batteryState.thrustCompensation = 1.0f;
+    isBatteryInputStarted = true;
+
+    return FCB_OK;
+#else
+    ADC_ChannelConfTypeDef channelConfig;
+
+    memset(&batteryState, 0, sizeof(batteryState));
+    batteryState.thrustCompensation = 1.0f;
+
+    batteryAdcHandle.Instance = BATTERY_ADC;
+    batteryAdcHandle.Init.ClockPrescaler = ADC_CLOCK_SYNC_PCLK_DIV4;
+    batteryAdcHandle.Init.Resolution = ADC_RESOLUTION12b;
+    batteryAdcHandle.Init.DataAlign = ADC_DATAALIGN_RIGHT;
+    batteryAdcHandle.Init.ScanConvMode = ADC_SCAN_ENABLE;
+    batteryAdcHandle.Init.EOCSelection = EOC_SEQ_CONV;
+    batteryAdcHandle.Init.LowPowerAutoWait = DISABLE;
+    batteryAdcHandle.Init.ContinuousConvMode = ENABLE;
+    batteryAdcHandle.Init.NbrOfConversion = BATTERY_ADC_CHANNELS;
+    batteryAdcHandle.Init.DiscontinuousConvMode = DISABLE;
+    batteryAdcHandle.Init.NbrOfDiscConversion = 1;
+    batteryAdcHandle.Init.ExternalTrigConv = ADC_SOFTWARE_START;
+    batteryAdcHandle.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_NONE;
+    batteryAdcHandle.Init.DMAContinuousRequests = ENABLE;
+    batteryAdcHandle.Init.Overrun = OVR_DATA_OVERWRITTEN;
+    if (HAL_OK != HAL_ADC_Init(&batteryAdcHandle)) {
+        return FCB_ERR_INIT;
+    }
+
+    /* Calibration needs the ADC disabled, before the first conversion is started */
+    if (HAL_OK != HAL_ADCEx_Calibration_Start(&batteryAdcHandle, ADC_SINGLE_ENDED)) {
+        return FCB_ERR_INIT;
+    }
+
+    channelConfig.Channel = BATTERY_VOLTAGE_ADC_CHANNEL;
+    channelConfig.Rank = ADC_REGULAR_RANK_1;
+    channelConfig.SamplingTime = ADC_SAMPLETIME_601CYCLES_5;
+    channelConfig.SingleDiff = ADC_SINGLE_ENDED;
+    channelConfig.OffsetNumber = ADC_OFFSET_NONE;
+    channelConfig.Offset = 0;
+    if (HAL_OK != HAL_ADC_ConfigChannel(&batteryAdcHandle, &channelConfig)) {
+        return FCB_ERR_INIT;
+    }
+
+#ifdef FCB_BATTERY_CURRENT_SENSOR
+    channelConfig.Channel = BATTERY_CURRENT_ADC_CHANNEL;
+    channelConfig.Rank = ADC_REGULAR_RANK_2;
+    if (HAL_OK != HAL_ADC_ConfigChannel(&batteryAdcHandle, &channelConfig)) {
+        return FCB_ERR_INIT;
+    }
+#endif
+
+    if (HAL_OK != HAL_ADC_Start_DMA(&batteryAdcHandle, (uint32_t*) batteryAdcBuffer, BATTERY_ADC_BUFFER_SIZE)) {
+        return FCB_ERR_INIT;
+    }
+
+    /* The buffer is averaged whenever the monitor is updated, so neither the DMA nor the ADC interrupts are needed */
+    __HAL_DMA_DISABLE_IT(batteryAdcHandle.DMA_Handle, DMA_IT_HT | DMA_IT_TC | DMA_IT_TE);
+    __HAL_ADC_DISABLE_IT(&batteryAdcHandle, ADC_IT_OVR);
+
+    isBatteryInputStarted = true;
+
+    return FCB_OK;
+#endif
+}
+
+void BatteryMonitorUpdate(void) {
+    uint32_t const tick = HAL_GetTick();
+    FcbBatteryStateType newState;
+    float32_t dt;
+    float32_t values[3];
+#ifdef BATTERY_INPUT_IS_DRONECAN
+    DroneCanBattery_TypeDef droneCanBattery;
+    bool isDroneCanBatteryFresh;
+#endif
+
+    if (!isBatteryInputStarted || tick - lastUpdateTick < BATTERY_UPDATE_PERIOD) {
+        return;
+    }
+    dt = (lastUpdateTick != 0) ? (float32_t) (tick - lastUpdateTick) / (float32_t) 1000.0 :
+            (float32_t) BATTERY_UPDATE_PERIOD / (float32_t) 1000.0;
+    lastUpdateTick = tick;
+
+    newState = batteryState;
+#ifdef BATTERY_INPUT_IS_DRONECAN
+    /* A power module that stopped reporting reads as a disconnected battery */
+    isDroneCanBatteryFresh = GetDroneCanBattery(&droneCanBattery);
+    newState.rawVoltage = isDroneCanBatteryFresh ? droneCanBattery.voltage : 0.0f;
+#else
+    newState.rawVoltage = averageAdcChannel(BATTERY_VOLTAGE_IDX) * BATTERY_VOLTAGE_SCALE;
+#endif
+
+    if (newState.rawVoltage < BATTERY_MIN_CONNECTED_VOLTAGE) {
+        if (BATTERY_NOT_CONNECTED != newState.status) {
+            LOG0("WARNING: battery disconnected");
+        }
+        newState.status = BATTERY_NOT_CONNECTED;
+        newState.cells = 0;
+        newState.voltage = newState.rawVoltage;
+        newState.current = 0.0f;
+        newState.thrustCompensation = 1.0f;
+        pendingStatus = BATTERY_NOT_CONNECTED;
+    } else {
+        if (0 == newState.cells) {
+            /* Just connected and without load, the unfiltered voltage is close to the open circuit voltage */
+            newState.cells = (uint8_t) ceilf(newState.rawVoltage / BATTERY_MAX_CELL_VOLTAGE);
+            newState.voltage = newState.rawVoltage;
+            newState.consumed = 0.0f;
+            newState.status = BATTERY_OK;
+            pendingStatus = BATTERY_OK;
+            LOG1("Battery connected, %lu cells", (uint32_t) newState.cells);
+        } else {
+            newState.voltage += (1.0f - expf(-dt / BATTERY_VOLTAGE_TIME_CONSTANT))
+                    * (newState.rawVoltage - newState.voltage);
+        }
+
+#if defined(FCB_BATTERY_CURRENT_SENSOR) || defined(BATTERY_INPUT_IS_DRONECAN)
+#ifdef BATTERY_INPUT_IS_DRONECAN
+        newState.current = droneCanBattery.current;
+#else
+        newState.current = (averageAdcChannel(BATTERY_CURRENT_IDX) - BATTERY_CURRENT_OFFSET) * BATTERY_CURRENT_SCALE;
+#endif
+        if (newState.current < 0.0f) {
+            newState.current = 0.0f;
+        }
+        newState.consumed += newState.current * dt / 3.6f; // [A s] to [mAh]
+#endif
+
+        newState.thrustCompensation = (BATTERY_NOMINAL_CELL_VOLTAGE * (float32_t) newState.cells) / newState.voltage;
+        newState.thrustCompensation *= newState.thrustCompensation;
+        if (newState.thrustCompensation < BATTERY_MIN_THRUST_COMPENSATION) {
+            newState.thrustCompensation = BATTERY_MIN_THRUST_COMPENSATION;
+        } else if (newState.thrustCompensation > BATTERY_MAX_THRUST_COMPENSATION) {
+            newState.thrustCompensation = BATTERY_MAX_THRUST_COMPENSATION;
+        }
+    }
+
+    taskENTER_CRITICAL();
+    batteryState = newState;
+    taskEXIT_CRITICAL();
+
+    if (BATTERY_NOT_CONNECTED != newState.status) {
+        updateBatteryStatus(tick, newState.voltage / (float32_t) newState.cells);
+    }
+
+    values[0] = newState.voltage;
+    values[1] = newState.current;
+    values[2] = newState.consumed;
+    AggregateSamples(AGGREGATE_BATTERY_VOLTAGE, values, 3);
+}
+
+float32_t GetBatteryThrustCompensation(void) {
+    return batteryState.thrustCompensation;
+}
+
+FcbBatteryStatusType GetBatteryStatus(void) {
+    return batteryState.status;
+}
+
+void GetBatteryState(FcbBatteryStateType * dstState) {
+    taskENTER_CRITICAL();
+    *dstState = batteryState;
+    taskEXIT_CRITICAL();
+}
+
+size_t PrintBatteryState(char * dst, const size_t dstSize) {
+    FcbBatteryStateType state;
+    char valueStrings[5][16];
+
+    GetBatteryState(&state);
+
+    FormatFixed(valueStrings[0], sizeof(valueStrings[0]), state.voltage, 2);
+    FormatFixed(valueStrings[1], sizeof(valueStrings[1]), (state.cells > 0) ? state.voltage / state.cells : 0.0f, 2);
+    FormatFixed(valueStrings[2], sizeof(valueStrings[2]), state.current, 1);
+    FormatFixed(valueStrings[3], sizeof(valueStrings[3]), state.consumed, 0);
+    FormatFixed(valueStrings[4], sizeof(valueStrings[4]), state.thrustCompensation, 3);
+
+    return (size_t) snprintf(dst, dstSize,
+            "\nBattery %s\ncells:%u, voltage:%s [V], cell:%s [V], current:%s [A], consumed:%s [mAh], "
+            "thrust compensation:%s\n", batteryStatusString(state.status), (unsigned int) state.cells,
+            valueStrings[0], valueStrings[1], valueStrings[2], valueStrings[3], valueStrings[4]);
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+#ifndef BATTERY_INPUT_IS_DRONECAN
+/*
+ * Average of the buffered conversions of a channel [V at the pin]. A sequence
+ * may be mid-way, which makes one sample of a channel newer than the others.
+ */
+static float32_t averageAdcChannel(const uint8_t channelIdx) {
+    uint32_t sum = 0;
+    uint16_t i;
+
+    for (i = channelIdx; i < BATTERY_ADC_BUFFER_SIZE; i += BATTERY_ADC_CHANNELS) {
+        sum += batteryAdcBuffer[i];
+    }
+
+    return ((float32_t) sum / (float32_t) BATTERY_ADC_OVERSAMPLING) * BATTERY_ADC_REFERENCE / BATTERY_ADC_FULL_SCALE;
+}
+#endif
+
+/*
+ * Enters a lower level after the cell voltage has been below it for
+ * BATTERY_LEVEL_DELAY, and leaves it once the voltage has recovered above it by
+ * BATTERY_LEVEL_HYSTERESIS, e.g. after a throttle punch
+ */
+static void updateBatteryStatus(const uint32_t tick, const float32_t cellVoltage) {
+    FcbBatteryStatusType const status = batteryState.status;
+    FcbBatteryStatusType level = BATTERY_OK;
+
+    if (cellVoltage < BATTERY_CRITICAL_CELL_VOLTAGE) {
+        level = BATTERY_CRITICAL;
+    } else if (cellVoltage < BATTERY_LOW_CELL_VOLTAGE) {
+        level = BATTERY_LOW;
+    }
+
+    if (level > status) {
+        if (level != pendingStatus) {
+            pendingStatus = level;
+            pendingStatusTick = tick;
+            return;
+        }
+        if (tick - pendingStatusTick < BATTERY_LEVEL_DELAY) {
+            return;
+        }
+    } else if (level == status || cellVoltage < levelCellVoltage(status) + BATTERY_LEVEL_HYSTERESIS) {
+        pendingStatus = status;
+        return;
+    }
+
+    pendingStatus = level;
+    batteryState.status = level; // Written by this task only
+    if (BATTERY_CRITICAL == level) {
+        LOG0("ERROR: battery critical, land now");
+    } else {
+        LOG1("WARNING: battery %s", batteryStatusString(level));
+    }
+}
+
+static float32_t levelCellVoltage(const FcbBatteryStatusType status) {
+    return (BATTERY_CRITICAL == status) ? BATTERY_CRITICAL_CELL_VOLTAGE : BATTERY_LOW_CELL_VOLTAGE;
+}
+
+static const char* batteryStatusString(const FcbBatteryStatusType status) {
+    switch (status) {
+    case BATTERY_OK:
+        return "OK";
+    case BATTERY_LOW:
+        return "LOW";
+    case BATTERY_CRITICAL:
+        return "CRITICAL";
+    case BATTERY_NOT_CONNECTED:
+    default:
+        return "not connected";
+    }
+}
+
+#endif /* FCB_BATTERY_MONITOR */
@@ -0,0 +1,465 @@
+/******************************************************************************
+ * @file    fcb_dynamic_notch.c
+ * @author  Dragonfly
+ * @brief   Implementation of interface publicised in fcb_dynamic_notch.h
+ ******************************************************************************/
+
+#include "fcb_dynamic_notch.h"
+
+#ifdef FCB_DYNAMIC_NOTCH
+
+#include "fcb_sensor_filter.h"
+#include "fcb_gyroscope.h"
+#include "deferred_work.h"
+#include "deferred_log.h"
+#include "fixed_format.h"
+#include "common.h"
+#include "control_executive.h"
+#include "arm_common_tables.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+
+/* Private define ------------------------------------------------------------*/
+enum {
+    DYN_NOTCH_AXES_N = 3,
+    DYN_NOTCH_BINS = DYN_NOTCH_FFT_SIZE / 2
+};
+
+#if DYN_NOTCH_FFT_SIZE != 256
+#error "The real FFT is set up for 256 samples, see dynamicNotchFft"
+#endif
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* The frame is written by the gyroscope context while collecting and read by the analysis otherwise */
+typedef enum {
+    DYN_NOTCH_FRAME_COLLECTING = 0,
+    DYN_NOTCH_FRAME_READY,
+    DYN_NOTCH_FRAME_ANALYSING
+} DynNotchFrameStateType;
+
+/**
+ * Notches of all axes as published by the analysis
+ */
+typedef struct DynNotchSet {
+    bool isActive[DYN_NOTCH_AXES_N][DYN_NOTCH_PEAKS];
+    float32_t coeffs[DYN_NOTCH_AXES_N][DYN_NOTCH_PEAKS][SENSOR_FILTER_COEFFS_PER_STAGE];
+} DynNotchSetType;
+
+/* Private variables ---------------------------------------------------------*/
+static float32_t dynNotchSampleRateHz = 0.0f;
+static DeferredWorkId_TypeDef dynNotchWorkId = DEFERRED_WORK_INVALID_ID;
+
+static float32_t dynNotchFrame[DYN_NOTCH_AXES_N][DYN_NOTCH_FFT_SIZE];
+static volatile uint32_t dynNotchFrameState = DYN_NOTCH_FRAME_COLLECTING;
+static uint32_t dynNotchFrameCount = 0;
+
+/* Used by the analysis only */
+static arm_rfft_fast_instance_f32 dynamicNotchFft;
+static float32_t dynNotchWindow[DYN_NOTCH_FFT_SIZE];
+static float32_t dynNotchFftIn[DYN_NOTCH_FFT_SIZE];     /* the windowed axis, then its power spectrum */
+static float32_t dynNotchFftOut[DYN_NOTCH_FFT_SIZE];
+static float32_t dynNotchCenterHz[DYN_NOTCH_AXES_N][DYN_NOTCH_PEAKS];
+static float32_t dynNotchLoggedHz[DYN_NOTCH_AXES_N][DYN_NOTCH_PEAKS];
+static uint32_t dynNotchMinBin = 1;
+static uint32_t dynNotchMaxBin = DYN_NOTCH_BINS - 2;
+
+/* Written by the analysis, read by the gyroscope context, which may preempt it */
+static DynNotchSetType dynNotchSets[2];
+static volatile uint32_t dynNotchSetSequence = 0;
+
+/* Used by the gyroscope context only */
+static DynNotchSetType dynNotchActiveSet;
+static uint32_t dynNotchActiveSequence = 0;
+static float32_t dynNotchS1[DYN_NOTCH_AXES_N][DYN_NOTCH_PEAKS];
+static float32_t dynNotchS2[DYN_NOTCH_AXES_N][DYN_NOTCH_PEAKS];
+
+/* Written by the analysis, read by other tasks in critical sections */
+static FcbDynamicNotchStatsType dynNotchStats;
+
+/* Private function prototypes -----------------------------------------------*/
+static void setBand(void);
+static void analyseFrame(void * argument);
+static uint8_t findPeaks(float32_t * peaksHz);
+static void updateCenters(const uint8_t axis, float32_t * peaksHz, const uint8_t nbrOfPeaks);
+static void publishNotches(void);
+static RAMFUNC void takeNotches(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Sets up the window, the FFT and the band of the analysis and registers it with the high priority worker
+ * @param  None
+ * @retval FCB_OK, FCB_ERR if the work item could not be registered
+ */
+FcbRetValType DynamicNotchInit(void) {
+    uint32_t i;
+
+    setBand();
+
+    /* Hann window, the leakage of a strong peak would otherwise hide a second one */
+    for (i = 0; i < DYN_NOTCH_FFT_SIZE; i++) {
+        dynNotchWindow[i] = 0.5f - 0.5f * arm_cos_f32(2.0f * PI * (float32_t) i / (float32_t) DYN_NOTCH_FFT_SIZE);
+    }
+
+    /* arm_rfft_fast_init_f32() of this CMSIS version sets no twiddle tables, so the instance is set up here */
+    dynamicNotchFft.Sint.fftLen = DYN_NOTCH_BINS;
+    dynamicNotchFft.Sint.pTwiddle = (float32_t *) twiddleCoef_128;
+    dynamicNotchFft.Sint.pBitRevTable = (uint16_t *) armBitRevIndexTable128;
+    dynamicNotchFft.Sint.bitRevLength = ARMBITREVINDEXTABLE_128_TABLE_LENGTH;
+    dynamicNotchFft.fftLenRFFT = DYN_NOTCH_FFT_SIZE;
+    dynamicNotchFft.pTwiddleRFFT = (float32_t *) twiddleCoef_rfft_256;
+
+    memset(dynNotchCenterHz, 0, sizeof(dynNotchCenterHz));
+    memset(dynNotchLoggedHz, 0, sizeof(dynNotchLoggedHz));
+    ResetDynamicNotchStats();
+
+    return DeferredWorkRegister("DynNotch", analyseFrame, NULL, DEFERRED_WORKER_HIGH, &dynNotchWorkId);
+}
+
+/*
+ * @brief  Moves the band of the analysis to the new gyroscope data rate. The notches stop until the next analysis
+ *         publishes them for the new rate, and the frame being collected restarts.
+ * @param  None
+ * @retval None
+ */
+void DynamicNotchDataRateChanged(void) {
+#ifdef FCB_CONTROL_EXECUTIVE
+    ControlExecutiveSuspend();
+#endif
+    taskENTER_CRITICAL();
+    setBand();
+    memset(dynNotchActiveSet.isActive, 0, sizeof(dynNotchActiveSet.isActive));
+    if (dynNotchFrameState == DYN_NOTCH_FRAME_COLLECTING) {
+        dynNotchFrameCount = 0;
+    }
+    taskEXIT_CRITICAL();
+#ifdef FCB_CONTROL_EXECUTIVE
+    ControlExecutiveResume();
+#endif
+}
+
+/*
+ * @brief  Collects a sample into the frame while one is collected, takes newly published notches and runs the active
+ *         ones on all axes
+ * @param  xyz : Sample, filtered in place
+ * @retval None
+ */
+RAMFUNC void DynamicNotchApply(float32_t * xyz) {
+    uint8_t axis, peak;
+
+    /* The notch input, the spectrum would otherwise lose the peaks to their own notches */
+    if (dynNotchFrameState == DYN_NOTCH_FRAME_COLLECTING) {
+        for (axis = 0; axis < DYN_NOTCH_AXES_N; axis++) {
+            dynNotchFrame[axis][dynNotchFrameCount] = xyz[axis];
+        }
+        if (++dynNotchFrameCount >= DYN_NOTCH_FFT_SIZE) {
+            __DMB();
+            dynNotchFrameState = DYN_NOTCH_FRAME_READY;
+        }
+    }
+
+    if (dynNotchSetSequence != dynNotchActiveSequence) {
+        takeNotches();
+    }
+
+    for (axis = 0; axis < DYN_NOTCH_AXES_N; axis++) {
+        for (peak = 0; peak < DYN_NOTCH_PEAKS; peak++) {
+            const float32_t * coeffs = dynNotchActiveSet.coeffs[axis][peak];
+            float32_t x, y;
+
+            if (!dynNotchActiveSet.isActive[axis][peak]) {
+                continue;
+            }
+
+            x = xyz[axis];
+            y = coeffs[0] * x + dynNotchS1[axis][peak];
+            dynNotchS1[axis][peak] = coeffs[1] * x + coeffs[3] * y + dynNotchS2[axis][peak];
+            dynNotchS2[axis][peak] = coeffs[2] * x + coeffs[4] * y;
+            xyz[axis] = y;
+        }
+    }
+}
+
+/*
+ * @brief  Posts the analysis once a frame has been collected
+ * @param  None
+ * @retval None
+ */
+void DynamicNotchUpdate(void) {
+    if (dynNotchFrameState == DYN_NOTCH_FRAME_READY) {
+        dynNotchFrameState = DYN_NOTCH_FRAME_ANALYSING;
+        DeferredWorkPost(dynNotchWorkId);
+    }
+}
+
+/*
+ * @brief  Clears the statistics and restarts the duty cycle measurement
+ * @param  None
+ * @retval None
+ */
+void ResetDynamicNotchStats(void) {
+    taskENTER_CRITICAL();
+    memset(&dynNotchStats, 0, sizeof(dynNotchStats));
+    dynNotchStats.startTimestamp = GetTimestamp64();
+    taskEXIT_CRITICAL();
+}
+
+size_t PrintDynamicNotch(char * dst, const size_t dstSize) {
+    FcbDynamicNotchStatsType stats;
+    char frequencyString[16];
+    char dutyString[16];
+    uint64_t elapsed;
+    size_t length;
+    uint8_t axis, peak;
+
+    taskENTER_CRITICAL();
+    stats = dynNotchStats;
+    taskEXIT_CRITICAL();
+
+    elapsed = GetTimestamp64() - stats.startTimestamp;
+    FormatFixed(dutyString, sizeof(dutyString),
+            elapsed > 0 ? 100.0f * (float32_t) stats.sumCycles / (float32_t) elapsed : 0.0f, 3);
+
+    length = (size_t) snprintf(dst, dstSize, "\nDynamic notch, %u point FFT, %u Hz sample rate\n"
+            "Analyses: %lu, peaks: %lu\nCycles last: %lu, max: %lu, duty: %s %%\n",
+            (unsigned int) DYN_NOTCH_FFT_SIZE, (unsigned int) dynNotchSampleRateHz, stats.analyses, stats.peaks,
+            stats.lastCycles, stats.maxCycles, dutyString);
+
+    /* The centers are those of the analysis, they may be one update ahead of the notches in use */
+    for (axis = 0; axis < DYN_NOTCH_AXES_N && length < dstSize; axis++) {
+        length += (size_t) snprintf(dst + length, dstSize - length, "Axis %u [Hz]:", (unsigned int) axis);
+        for (peak = 0; peak < DYN_NOTCH_PEAKS && length < dstSize; peak++) {
+            if (dynNotchCenterHz[axis][peak] > 0.0f) {
+                FormatFixed(frequencyString, sizeof(frequencyString), dynNotchCenterHz[axis][peak], 1);
+            } else {
+                strncpy(frequencyString, "off", sizeof(frequencyString));
+            }
+            length += (size_t) snprintf(dst + length, dstSize - length, " %s", frequencyString);
+        }
+        if (length < dstSize) {
+            length += (size_t) snprintf(dst + length, dstSize - length, "\n");
+        }
+    }
+
+    return length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Sets the data rate and the band of the analysis from the gyroscope
+ */
+static void setBand(void) {
+    dynNotchSampleRateHz = (float32_t) GyroDataRateHz();
+
+    /* A peak is a local maximum, so the band excludes the first and the last bin */
+    dynNotchMinBin = (uint32_t) (DYN_NOTCH_MIN_HZ * DYN_NOTCH_FFT_SIZE / dynNotchSampleRateHz);
+    dynNotchMaxBin = (uint32_t) (DYN_NOTCH_MAX_NYQUIST_FRACTION * DYN_NOTCH_BINS);
+    if (dynNotchMinBin < 1) {
+        dynNotchMinBin = 1;
+    }
+    if (dynNotchMaxBin > DYN_NOTCH_BINS - 2) {
+        dynNotchMaxBin = DYN_NOTCH_BINS - 2;
+    }
+}
+
+/*
+ * Work item handler, finds the peaks of each axis of the collected frame,
+ * moves the notches towards them and starts the next frame
+ */
+static void analyseFrame(void * argument) {
+    float32_t peaksHz[DYN_NOTCH_PEAKS];
+    uint32_t start = GetTimestamp();
+    uint32_t cycles;
+    uint32_t nbrOfPeaks = 0;
+    uint8_t axis, peaks;
+
+    (void) argument;
+
+    if (dynNotchFrameState != DYN_NOTCH_FRAME_ANALYSING) {
+        return;
+    }
+
+    for (axis = 0; axis < DYN_NOTCH_AXES_N; axis++) {
+        arm_mult_f32(dynNotchFrame[axis], dynNotchWindow, dynNotchFftIn, DYN_NOTCH_FFT_SIZE);
+        arm_rfft_fast_f32(&dynamicNotchFft, dynNotchFftIn, dynNotchFftOut, 0);
+        arm_cmplx_mag_squared_f32(dynNotchFftOut, dynNotchFftIn, DYN_NOTCH_BINS);
+
+        peaks = findPeaks(peaksHz);
+        updateCenters(axis, peaksHz, peaks);
+        nbrOfPeaks += peaks;
+    }
+
+    /* The frame is released before the publication, so the next one starts with the new notches */
+    dynNotchFrameCount = 0;
+    __DMB();
+    dynNotchFrameState = DYN_NOTCH_FRAME_COLLECTING;
+
+    publishNotches();
+
+    cycles = GetTimestamp() - start;
+    taskENTER_CRITICAL();
+    dynNotchStats.analyses++;
+    dynNotchStats.peaks += nbrOfPeaks;
+    dynNotchStats.lastCycles = cycles;
+    dynNotchStats.sumCycles += cycles;
+    if (cycles > dynNotchStats.maxCycles) {
+        dynNotchStats.maxCycles = cycles;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * Finds the highest local maxima of the power spectrum in dynNotchFftIn
+ * within the band, refined between the bins by a parabola through the
+ * maximum and its neighbours. Returns the number of peaks in peaksHz, in
+ * ascending frequency.
+ */
+static uint8_t findPeaks(float32_t * peaksHz) {
+    const float32_t * power = dynNotchFftIn;
+    float32_t peakPowers[DYN_NOTCH_PEAKS];
+    uint32_t peakBins[DYN_NOTCH_PEAKS];
+    float32_t threshold = 0.0f;
+    uint8_t nbrOfPeaks = 0;
+    uint32_t bin;
+    uint8_t i, j;
+
+    for (bin = dynNotchMinBin; bin <= dynNotchMaxBin; bin++) {
+        threshold += power[bin];
+    }
+    threshold *= DYN_NOTCH_MIN_PEAK_RATIO / (float32_t) (dynNotchMaxBin - dynNotchMinBin + 1);
+
+    /* Insertion into the highest peaks so far, in descending power */
+    for (bin = dynNotchMinBin; bin <= dynNotchMaxBin; bin++) {
+        if (power[bin] <= threshold || power[bin] <= power[bin - 1] || power[bin] < power[bin + 1]) {
+            continue;
+        }
+
+        for (i = 0; i < nbrOfPeaks && peakPowers[i] >= power[bin]; i++) {
+        }
+        if (i >= DYN_NOTCH_PEAKS) {
+            continue;
+        }
+        if (nbrOfPeaks < DYN_NOTCH_PEAKS) {
+            nbrOfPeaks++;
+        }
+        for (j = nbrOfPeaks - 1; j > i; j--) {
+            peakPowers[j] = peakPowers[j - 1];
+            peakBins[j] = peakBins[j - 1];
+        }
+        peakPowers[i] = power[bin];
+        peakBins[i] = bin;
+    }
+
+    for (i = 0; i < nbrOfPeaks; i++) {
+        float32_t below = power[peakBins[i] - 1], above = power[peakBins[i] + 1];
+        float32_t curvature = below - 2.0f * peakPowers[i] + above;
+        float32_t offset = curvature < 0.0f ? 0.5f * (below - above) / curvature : 0.0f;
+
+        peaksHz[i] = ((float32_t) peakBins[i] + offset) * dynNotchSampleRateHz / (float32_t) DYN_NOTCH_FFT_SIZE;
+    }
+
+    /* Ascending frequency, so that a notch follows the same peak from one frame to the next */
+    for (i = 1; i < nbrOfPeaks; i++) {
+        for (j = i; j > 0 && peaksHz[j - 1] > peaksHz[j]; j--) {
+            float32_t swap = peaksHz[j];
+            peaksHz[j] = peaksHz[j - 1];
+            peaksHz[j - 1] = swap;
+        }
+    }
+
+    return nbrOfPeaks;
+}
+
+/*
+ * Moves the notch centers of an axis towards its peaks, the notches without
+ * a peak hold. A notch that has no center yet takes its peak as it is.
+ */
+static void updateCenters(const uint8_t axis, float32_t * peaksHz, const uint8_t nbrOfPeaks) {
+    float32_t * centersHz = dynNotchCenterHz[axis];
+    uint8_t peak;
+
+    for (peak = 0; peak < nbrOfPeaks; peak++) {
+        float32_t step;
+
+        if (centersHz[peak] <= 0.0f) {
+            centersHz[peak] = peaksHz[peak];
+        } else {
+            step = DYN_NOTCH_SMOOTHING * (peaksHz[peak] - centersHz[peak]);
+            if (step > DYN_NOTCH_MAX_STEP_HZ) {
+                step = DYN_NOTCH_MAX_STEP_HZ;
+            } else if (step < -DYN_NOTCH_MAX_STEP_HZ) {
+                step = -DYN_NOTCH_MAX_STEP_HZ;
+            }
+            centersHz[peak] += step;
+        }
+
+        if (centersHz[peak] - dynNotchLoggedHz[axis][peak] > DYN_NOTCH_LOG_CHANGE_HZ
+                || dynNotchLoggedHz[axis][peak] - centersHz[peak] > DYN_NOTCH_LOG_CHANGE_HZ) {
+            dynNotchLoggedHz[axis][peak] = centersHz[peak];
+            LOG3("Dynamic notch, axis %lu notch %lu at %lu Hz", (uint32_t) axis, (uint32_t) peak,
+                    (uint32_t) (centersHz[peak] + 0.5f));
+        }
+    }
+}
+
+/*
+ * Computes the coefficients of the notches that have a center into the
+ * buffer the gyroscope context is not reading and publishes it
+ */
+static void publishNotches(void) {
+    uint32_t next = dynNotchSetSequence + 1;
+    DynNotchSetType * set = &dynNotchSets[next & 1];
+    uint8_t axis, peak;
+
+    for (axis = 0; axis < DYN_NOTCH_AXES_N; axis++) {
+        for (peak = 0; peak < DYN_NOTCH_PEAKS; peak++) {
+            set->isActive[axis][peak] = dynNotchCenterHz[axis][peak] > 0.0f;
+            if (set->isActive[axis][peak]) {
+                SensorFilterNotchCoeffs(dynNotchCenterHz[axis][peak], DYN_NOTCH_Q, dynNotchSampleRateHz,
+                        set->coeffs[axis][peak]);
+            }
+        }
+    }
+
+    __DMB();
+    dynNotchSetSequence = next;
+}
+
+/*
+ * Copies the latest published notches, the state of a running notch is kept
+ * across the new coefficients and a notch that is switched on starts cleared
+ */
+static RAMFUNC void takeNotches(void) {
+    DynNotchSetType set;
+    uint32_t sequence;
+    uint8_t axis, peak;
+
+    do {
+        sequence = dynNotchSetSequence;
+        __DMB();
+        set = dynNotchSets[sequence & 1];
+        __DMB();
+    } while (sequence != dynNotchSetSequence);
+
+    for (axis = 0; axis < DYN_NOTCH_AXES_N; axis++) {
+        for (peak = 0; peak < DYN_NOTCH_PEAKS; peak++) {
+            if (set.isActive[axis][peak] && !dynNotchActiveSet.isActive[axis][peak]) {
+                dynNotchS1[axis][peak] = 0.0f;
+                dynNotchS2[axis][peak] = 0.0f;
+            }
+        }
+    }
+
+    dynNotchActiveSet = set;
+    dynNotchActiveSequence = sequence;
+}
+
+#endif /* FCB_DYNAMIC_NOTCH */
@@ -0,0 +1,442 @@
+/******************************************************************************
+ * @file    fcb_gps.c
+ * @author  Dragonfly
+ * @brief   Implementation of interface publicised in fcb_gps.h
+ ******************************************************************************/
+
+#include "fcb_gps.h"
+
+#ifdef FCB_GPS
+
+#include "fcb_error.h"
+#include "common.h"
+#include "fixed_format.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+
+/* Private define ------------------------------------------------------------*/
+#define UBX_SYNC_CHAR_1             0xB5
+#define UBX_SYNC_CHAR_2             0x62
+#define UBX_FRAME_OVERHEAD          8       // Sync chars, class, id, length and checksum
+
+#define UBX_CLASS_NAV               0x01
+#define UBX_ID_NAV_PVT              0x07
+#define UBX_CLASS_CFG               0x06
+#define UBX_ID_CFG_PRT              0x00
+#define UBX_ID_CFG_MSG              0x01
+#define UBX_ID_CFG_RATE             0x08
+
+#define UBX_NAV_PVT_SIZE            92
+#define UBX_NAV_PVT_FLAGS_FIX_OK    0x01
+
+#define UBX_CFG_PRT_SIZE            20
+#define UBX_CFG_PRT_UART1           1
+#define UBX_CFG_PRT_MODE_8N1        0x000008D0
+#define UBX_PROTO_UBX               0x0001
+
+#define GPS_UART_ERROR_FLAGS        (UART_FLAG_PE | UART_FLAG_FE | UART_FLAG_NE | UART_FLAG_ORE)
+#define GPS_UART_ERROR_CLEAR        (UART_CLEAR_PEF | UART_CLEAR_FEF | UART_CLEAR_NEF | UART_CLEAR_OREF)
+
+/* Private typedef -----------------------------------------------------------*/
+typedef enum {
+    UBX_RX_WAIT_SYNC_1 = 0,
+    UBX_RX_WAIT_SYNC_2,
+    UBX_RX_CLASS,
+    UBX_RX_ID,
+    UBX_RX_LENGTH_LOW,
+    UBX_RX_LENGTH_HIGH,
+    UBX_RX_PAYLOAD,
+    UBX_RX_CHECKSUM_A,
+    UBX_RX_CHECKSUM_B
+} UbxRxStateType;
+
+/* Private variables ---------------------------------------------------------*/
+UART_HandleTypeDef GpsUartHandle;
+
+/* Circular DMA ring buffer and the position the latest burst ended at */
+static uint8_t gpsRxBuffer[GPS_DMA_BUFFER_SIZE];
+static uint16_t gpsRxReadIndex = 0;
+
+/* Message parser state, used by the GPS_UART interrupt only */
+static UbxRxStateType rxState = UBX_RX_WAIT_SYNC_1;
+static uint8_t rxClass;
+static uint8_t rxId;
+static uint16_t rxLength;
+static uint16_t rxCount;
+static uint8_t rxChecksumA;
+static uint8_t rxChecksumB;
+static uint8_t rxPayload[GPS_UBX_MAX_PAYLOAD_SIZE];
+
+/* Latest solution, written by the GPS_UART interrupt and read in critical sections */
+static FcbGpsSolutionType gpsSolution;
+static FcbGpsStatsType gpsStats;
+
+/* Private function prototypes -----------------------------------------------*/
+static FcbRetValType initGpsUart(const uint32_t baudRate);
+static FcbRetValType sendUbxMessage(const uint8_t msgClass, const uint8_t msgId, const uint8_t * payload,
+        const uint16_t length);
+static FcbRetValType sendPortConfig(void);
+static void parseUbxByte(const uint8_t rxByte);
+static void handleUbxMessage(void);
+static void handleNavPvt(const uint8_t * payload);
+static uint16_t getU2(const uint8_t * src);
+static uint32_t getU4(const uint8_t * src);
+static void setU2(uint8_t * dst, const uint16_t value);
+static void setU4(uint8_t * dst, const uint32_t value);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Switches the receiver to UBX at GPS_BAUDRATE, enables the NAV-PVT solutions and starts the reception
+ * @param  None
+ * @retval FCB_OK if started, FCB_ERR_INIT if the UART could not be configured
+ */
+FcbRetValType FcbInitialiseGps(void) {
+    uint8_t msgConfig[3] = { UBX_CLASS_NAV, UBX_ID_NAV_PVT, 1 }; // One solution per navigation solution
+    uint8_t rateConfig[6];
+
+    memset(&gpsSolution, 0, sizeof(gpsSolution));
+    memset(&gpsStats, 0, sizeof(gpsStats));
+
+    /* From the factory setting, then from GPS_BAUDRATE in case the receiver kept the configuration */
+    if (FCB_OK != initGpsUart(GPS_DEFAULT_BAUDRATE) || FCB_OK != sendPortConfig()) {
+        return FCB_ERR_INIT;
+    }
+    vTaskDelay(GPS_BAUDRATE_SWITCH_DELAY / portTICK_RATE_MS);
+    if (FCB_OK != initGpsUart(GPS_BAUDRATE) || FCB_OK != sendPortConfig()) {
+        return FCB_ERR_INIT;
+    }
+    vTaskDelay(GPS_BAUDRATE_SWITCH_DELAY / portTICK_RATE_MS);
+
+    setU2(&rateConfig[0], GPS_MEASUREMENT_PERIOD);
+    setU2(&rateConfig[2], 1); // Navigation solution per measurement
+    setU2(&rateConfig[4], 1); // GPS time reference
+    if (FCB_OK != sendUbxMessage(UBX_CLASS_CFG, UBX_ID_CFG_RATE, rateConfig, sizeof(rateConfig))
+            || FCB_OK != sendUbxMessage(UBX_CLASS_CFG, UBX_ID_CFG_MSG, msgConfig, sizeof(msgConfig))) {
+        return FCB_ERR_INIT;
+    }
+
+    if (HAL_OK != HAL_UART_Receive_DMA(&GpsUartHandle, gpsRxBuffer, GPS_DMA_BUFFER_SIZE)) {
+        return FCB_ERR_INIT;
+    }
+
+    /* The ring buffer is read at the idle line only, so the DMA interrupts are not needed */
+    __HAL_DMA_DISABLE_IT(GpsUartHandle.hdmarx, DMA_IT_HT | DMA_IT_TC | DMA_IT_TE);
+    __HAL_UART_CLEAR_IT(&GpsUartHandle, UART_CLEAR_IDLEF | GPS_UART_ERROR_CLEAR);
+    __HAL_UART_ENABLE_IT(&GpsUartHandle, UART_IT_IDLE);
+
+    return FCB_OK;
+}
+
+void GpsUartIRQHandler(void) {
+    uint16_t writeIndex;
+    bool rxError;
+
+    if (!__HAL_UART_GET_FLAG(&GpsUartHandle, UART_FLAG_IDLE)) {
+        return;
+    }
+
+    rxError = (GpsUartHandle.Instance->ISR & GPS_UART_ERROR_FLAGS) != 0;
+    __HAL_UART_CLEAR_IT(&GpsUartHandle, UART_CLEAR_IDLEF | GPS_UART_ERROR_CLEAR);
+
+    writeIndex = (GPS_DMA_BUFFER_SIZE - GpsUartHandle.hdmarx->Instance->CNDTR) % GPS_DMA_BUFFER_SIZE;
+
+    if (rxError) {
+        /* The message in progress lost bytes, its checksum would fail anyway */
+        gpsStats.rxErrors++;
+        rxState = UBX_RX_WAIT_SYNC_1;
+    }
+
+    while (gpsRxReadIndex != writeIndex) {
+        parseUbxByte(gpsRxBuffer[gpsRxReadIndex]);
+        gpsRxReadIndex = (gpsRxReadIndex + 1) % GPS_DMA_BUFFER_SIZE;
+    }
+}
+
+bool GetNewGpsSolution(FcbGpsSolutionType * dstSolution, const uint32_t lastSequence) {
+    bool isNew = false;
+
+    taskENTER_CRITICAL();
+    if (gpsSolution.sequence != lastSequence) {
+        *dstSolution = gpsSolution;
+        isNew = true;
+    }
+    taskEXIT_CRITICAL();
+
+    return isNew;
+}
+
+void SetGpsSolution(const FcbGpsSolutionType * solution) {
+    uint32_t sequence;
+
+    taskENTER_CRITICAL();
+    sequence = gpsSolution.sequence;
+    gpsSolution = *solution;
+    gpsSolution.sequence = sequence + 1;
+
+    gpsStats.messages++;
+    gpsStats.solutions++;
+    gpsStats.lastRxTick = HAL_GetTick();
+    taskEXIT_CRITICAL();
+}
+
+bool IsGpsSolutionUsable(const FcbGpsSolutionType * solution) {
+    return solution->fixOk && solution->fixType >= 3 && solution->numSv >= GPS_MIN_SATELLITES
+            && solution->horizontalAccuracy <= GPS_MAX_HORIZONTAL_ACCURACY;
+}
+
+bool IsGpsActive(void) {
+    return gpsSolution.sequence > 0 && (HAL_GetTick() - gpsStats.lastRxTick) <= GPS_TIMEOUT;
+}
+
+void GetGpsStats(FcbGpsStatsType * dstStats) {
+    taskENTER_CRITICAL();
+    *dstStats = gpsStats;
+    taskEXIT_CRITICAL();
+}
+
+void ResetGpsStats(void) {
+    taskENTER_CRITICAL();
+    gpsStats.messages = 0;
+    gpsStats.solutions = 0;
+    gpsStats.checksumErrors = 0;
+    gpsStats.rxErrors = 0;
+    taskEXIT_CRITICAL();
+}
+
+size_t PrintGpsStats(char * dst, const size_t dstSize) {
+    FcbGpsSolutionType solution;
+    FcbGpsStatsType stats;
+    char accuracyStrings[3][16];
+    size_t length;
+
+    memset(&solution, 0, sizeof(solution));
+    GetNewGpsSolution(&solution, 0);
+    GetGpsStats(&stats);
+
+    FormatFixed(accuracyStrings[0], sizeof(accuracyStrings[0]), solution.horizontalAccuracy, 2);
+    FormatFixed(accuracyStrings[1], sizeof(accuracyStrings[1]), solution.verticalAccuracy, 2);
+    FormatFixed(accuracyStrings[2], sizeof(accuracyStrings[2]), solution.speedAccuracy, 2);
+
+    length = (size_t) snprintf(dst, dstSize,
+            "\nGPS %s\nfix:%u%s, satellites:%u, lat:%ld, lon:%ld [1e-7 deg], hAcc:%s, vAcc:%s [m], sAcc:%s [m/s]\n"
+            "messages:%u, solutions:%u, checksumErrors:%u, rxErrors:%u\n",
+            IsGpsActive() ? "active" : "LOST", (unsigned int) solution.fixType, solution.fixOk ? " ok" : "",
+            (unsigned int) solution.numSv, (long) solution.latitude, (long) solution.longitude,
+            accuracyStrings[0], accuracyStrings[1], accuracyStrings[2], (unsigned int) stats.messages,
+            (unsigned int) stats.solutions, (unsigned int) stats.checksumErrors, (unsigned int) stats.rxErrors);
+
+    return length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Configures GPS_UART at a baud rate, the MSP is only initialised the first time
+ */
+static FcbRetValType initGpsUart(const uint32_t baudRate) {
+    GpsUartHandle.Instance = GPS_UART;
+    GpsUartHandle.Init.BaudRate = baudRate;
+    GpsUartHandle.Init.WordLength = UART_WORDLENGTH_8B;
+    GpsUartHandle.Init.StopBits = UART_STOPBITS_1;
+    GpsUartHandle.Init.Parity = UART_PARITY_NONE;
+    GpsUartHandle.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+    GpsUartHandle.Init.Mode = UART_MODE_TX_RX;
+
+    /* An overrun must not stop the DMA reception, the message it corrupted fails its checksum */
+    GpsUartHandle.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_RXOVERRUNDISABLE_INIT;
+    GpsUartHandle.AdvancedInit.OverrunDisable = UART_ADVFEATURE_OVERRUN_DISABLE;
+
+    if (HAL_OK != HAL_UART_Init(&GpsUartHandle)) {
+        return FCB_ERR;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * Sends a UBX message, blocking until its last byte is sent
+ */
+static FcbRetValType sendUbxMessage(const uint8_t msgClass, const uint8_t msgId, const uint8_t * payload,
+        const uint16_t length) {
+    uint8_t frame[UBX_FRAME_OVERHEAD + UBX_CFG_PRT_SIZE];
+    uint8_t checksumA = 0, checksumB = 0;
+    uint16_t i;
+
+    if (length > UBX_CFG_PRT_SIZE) {
+        return FCB_ERR;
+    }
+
+    frame[0] = UBX_SYNC_CHAR_1;
+    frame[1] = UBX_SYNC_CHAR_2;
+    frame[2] = msgClass;
+    frame[3] = msgId;
+    setU2(&frame[4], length);
+    memcpy(&frame[6], payload, length);
+
+    /* 8-bit Fletcher checksum over the class, id, length and payload */
+    for (i = 2; i < 6 + length; i++) {
+        checksumA += frame[i];
+        checksumB += checksumA;
+    }
+    frame[6 + length] = checksumA;
+    frame[7 + length] = checksumB;
+
+    if (HAL_OK != HAL_UART_Transmit(&GpsUartHandle, frame, UBX_FRAME_OVERHEAD + length, GPS_CONFIG_TX_TIMEOUT)) {
+        return FCB_ERR;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * Sets UART1 of the receiver to 8N1 at GPS_BAUDRATE with UBX in and out only
+ */
+static FcbRetValType sendPortConfig(void) {
+    uint8_t portConfig[UBX_CFG_PRT_SIZE];
+
+    memset(portConfig, 0, sizeof(portConfig));
+    portConfig[0] = UBX_CFG_PRT_UART1;
+    setU4(&portConfig[4], UBX_CFG_PRT_MODE_8N1);
+    setU4(&portConfig[8], GPS_BAUDRATE);
+    setU2(&portConfig[12], UBX_PROTO_UBX);
+    setU2(&portConfig[14], UBX_PROTO_UBX);
+
+    return sendUbxMessage(UBX_CLASS_CFG, UBX_ID_CFG_PRT, portConfig, sizeof(portConfig));
+}
+
+/*
+ * Feeds a received byte to the UBX message parser, NMEA and other messages are skipped
+ */
+static void parseUbxByte(const uint8_t rxByte) {
+    switch (rxState) {
+    case UBX_RX_WAIT_SYNC_1:
+        if (UBX_SYNC_CHAR_1 == rxByte) {
+            rxState = UBX_RX_WAIT_SYNC_2;
+        }
+        break;
+
+    case UBX_RX_WAIT_SYNC_2:
+        if (UBX_SYNC_CHAR_2 == rxByte) {
+            rxChecksumA = 0;
+            rxChecksumB = 0;
+            rxState = UBX_RX_CLASS;
+        } else if (UBX_SYNC_CHAR_1 != rxByte) {
+            rxState = UBX_RX_WAIT_SYNC_1;
+        }
+        break;
+
+    case UBX_RX_CLASS:
+    case UBX_RX_ID:
+    case UBX_RX_LENGTH_LOW:
+    case UBX_RX_LENGTH_HIGH:
+    case UBX_RX_PAYLOAD:
+        rxChecksumA += rxByte;
+        rxChecksumB += rxChecksumA;
+
+        if (UBX_RX_CLASS == rxState) {
+            rxClass = rxByte;
+            rxState = UBX_RX_ID;
+        } else if (UBX_RX_ID == rxState) {
+            rxId = rxByte;
+            rxState = UBX_RX_LENGTH_LOW;
+        } else if (UBX_RX_LENGTH_LOW == rxState) {
+            rxLength = rxByte;
+            rxState = UBX_RX_LENGTH_HIGH;
+        } else if (UBX_RX_LENGTH_HIGH == rxState) {
+            rxLength |= (uint16_t) rxByte << 8;
+            rxCount = 0;
+            if (rxLength > GPS_UBX_MAX_PAYLOAD_SIZE) {
+                rxState = UBX_RX_WAIT_SYNC_1; // Not a message used here
+            } else {
+                rxState = (rxLength > 0) ? UBX_RX_PAYLOAD : UBX_RX_CHECKSUM_A;
+            }
+        } else {
+            rxPayload[rxCount++] = rxByte;
+            if (rxCount >= rxLength) {
+                rxState = UBX_RX_CHECKSUM_A;
+            }
+        }
+        break;
+
+    case UBX_RX_CHECKSUM_A:
+        if (rxChecksumA == rxByte) {
+            rxState = UBX_RX_CHECKSUM_B;
+        } else {
+            gpsStats.checksumErrors++;
+            rxState = UBX_RX_WAIT_SYNC_1;
+        }
+        break;
+
+    case UBX_RX_CHECKSUM_B:
+        if (rxChecksumB == rxByte) {
+            handleUbxMessage();
+        } else {
+            gpsStats.checksumErrors++;
+        }
+        rxState = UBX_RX_WAIT_SYNC_1;
+        break;
+
+    default:
+        rxState = UBX_RX_WAIT_SYNC_1;
+        break;
+    }
+}
+
+static void handleUbxMessage(void) {
+    gpsStats.messages++;
+
+    if (UBX_CLASS_NAV == rxClass && UBX_ID_NAV_PVT == rxId && UBX_NAV_PVT_SIZE == rxLength) {
+        handleNavPvt(rxPayload);
+    }
+}
+
+/*
+ * Decodes a NAV-PVT payload, little endian, into the latest solution
+ */
+static void handleNavPvt(const uint8_t * payload) {
+    gpsSolution.timestamp = GetTimestamp();
+    gpsSolution.iTow = getU4(&payload[0]);
+    gpsSolution.fixType = payload[20];
+    gpsSolution.fixOk = (payload[21] & UBX_NAV_PVT_FLAGS_FIX_OK) != 0;
+    gpsSolution.numSv = payload[23];
+    gpsSolution.longitude = (int32_t) getU4(&payload[24]);
+    gpsSolution.latitude = (int32_t) getU4(&payload[28]);
+    gpsSolution.heightMsl = 0.001f * (float32_t) (int32_t) getU4(&payload[36]);
+    gpsSolution.horizontalAccuracy = 0.001f * (float32_t) getU4(&payload[40]);
+    gpsSolution.verticalAccuracy = 0.001f * (float32_t) getU4(&payload[44]);
+    gpsSolution.velocityNed[0] = 0.001f * (float32_t) (int32_t) getU4(&payload[48]);
+    gpsSolution.velocityNed[1] = 0.001f * (float32_t) (int32_t) getU4(&payload[52]);
+    gpsSolution.velocityNed[2] = 0.001f * (float32_t) (int32_t) getU4(&payload[56]);
+    gpsSolution.speedAccuracy = 0.001f * (float32_t) getU4(&payload[68]);
+    gpsSolution.sequence++;
+
+    gpsStats.solutions++;
+    gpsStats.lastRxTick = HAL_GetTick();
+}
+
+static uint16_t getU2(const uint8_t * src) {
+    return (uint16_t) src[0] | ((uint16_t) src[1] << 8);
+}
+
+static uint32_t getU4(const uint8_t * src) {
+    return (uint32_t) getU2(&src[0]) | ((uint32_t) getU2(&src[2]) << 16);
+}
+
+static void setU2(uint8_t * dst, const uint16_t value) {
+    dst[0] = (uint8_t) value;
+    dst[1] = (uint8_t) (value >> 8);
+}
+
+static void setU4(uint8_t * dst, const uint32_t value) {
+    setU2(&dst[0], (uint16_t) value);
+    setU2(&dst[2], (uint16_t) (value >> 16));
+}
+
+#endif /* FCB_GPS */
@@ -0,0 +1,295 @@
+/******************************************************************************
+ * @file    fcb_gyro_redundancy.c
+ * @author  Dragonfly
+ * @brief   Implementation of interface publicised in fcb_gyro_redundancy.h
+ ******************************************************************************/
+
+#include "fcb_gyro_redundancy.h"
+#include "fcb_vibration_monitor.h"
+#include "fcb_diag.h"
+#include "fixed_format.h"
+#include "common.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+/* Private define ------------------------------------------------------------*/
+enum {
+    VOTE_AXES_N = 3
+};
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Test state of a gyroscope */
+typedef struct GyroVoteSensor {
+    const char * name;
+    float32_t fullScale;                        /* [rad/s] */
+    float32_t sample[VOTE_AXES_N];              /* last valid sample */
+    uint32_t changeTimestamp[VOTE_AXES_N];      /* [core clock cycles] the axis last changed */
+    uint32_t faultTimestamp[VOTE_AXES_N];       /* [core clock cycles] the axis last failed a test */
+    uint8_t readFailures;                       /* in a row */
+} GyroVoteSensorType;
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Only written by the SENSORS task, the stats are copied with it locked out */
+static GyroVoteSensorType voteSensors[GYRO_VOTE_SENSORS];
+static GyroVoteStatsType voteStats;
+static uint32_t disagreeTimestamp[VOTE_AXES_N]; /* [core clock cycles] the difference started, 0 if none */
+static uint32_t lastVoteTimestamp = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+static void testSensor(const uint8_t sensor, const float32_t * sample, const bool isValid, const uint32_t timestamp);
+static void setFault(const uint8_t sensor, const uint8_t axis, const uint8_t fault, const uint32_t timestamp);
+static void compareAxis(const uint8_t axis, const float32_t alpha, const uint32_t timestamp);
+static void selectAxisSource(const uint8_t axis);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Starts the voting of two gyroscopes, or disables it if the second one did not answer
+ * @param  names : Gyroscope names, the second one NULL if there is none
+ * @param  fullScale : Full scale of each gyroscope [rad/s]
+ * @retval None
+ */
+void GyroVoteInit(const char * const names[GYRO_VOTE_SENSORS], const float32_t fullScale[GYRO_VOTE_SENSORS]) {
+    uint8_t sensor;
+
+    memset(voteSensors, 0, sizeof(voteSensors));
+    memset(&voteStats, 0, sizeof(voteStats));
+    memset(disagreeTimestamp, 0, sizeof(disagreeTimestamp));
+
+    for (sensor = 0; sensor < GYRO_VOTE_SENSORS; sensor++) {
+        voteSensors[sensor].name = (NULL != names[sensor]) ? names[sensor] : "none";
+        voteSensors[sensor].fullScale = fullScale[sensor];
+    }
+    voteStats.isEnabled = NULL != names[1];
+    lastVoteTimestamp = GetTimestamp();
+}
+
+RAMFUNC void GyroVote(const float32_t samples[GYRO_VOTE_SENSORS][3], const bool isValid[GYRO_VOTE_SENSORS],
+        const uint32_t timestamp, float32_t * voted) {
+    float32_t dt;
+    uint8_t sensor, axis;
+
+    if (!voteStats.isEnabled) {
+        memcpy(voted, samples[0], VOTE_AXES_N * sizeof(float32_t));
+        return;
+    }
+
+    for (sensor = 0; sensor < GYRO_VOTE_SENSORS; sensor++) {
+        testSensor(sensor, samples[sensor], isValid[sensor], timestamp);
+    }
+
+    dt = TimestampToSeconds(timestamp - lastVoteTimestamp);
+    lastVoteTimestamp = timestamp;
+
+    for (axis = 0; axis < VOTE_AXES_N; axis++) {
+        compareAxis(axis, dt / (GYRO_VOTE_OFFSET_TIME_CONSTANT + dt), timestamp);
+        selectAxisSource(axis);
+
+        /* in the bias of gyroscope 0, see voteStats.offset */
+        if (0 == voteStats.source[axis]) {
+            voted[axis] = voteSensors[0].sample[axis];
+        } else {
+            voted[axis] = voteSensors[1].sample[axis] - voteStats.offset[axis];
+        }
+    }
+}
+
+/*
+ * @brief  Makes all axes of a gyroscope faulty at once, for a stall found by the sensor watchdog: the voting does not
+ *         see the samples that were not read
+ * @param  sensor : Gyroscope index
+ * @retval None
+ */
+void GyroVoteSensorStalled(const uint8_t sensor) {
+    const uint32_t timestamp = GetTimestamp();
+    uint8_t axis;
+
+    if (!voteStats.isEnabled || sensor >= GYRO_VOTE_SENSORS) {
+        return;
+    }
+
+    for (axis = 0; axis < VOTE_AXES_N; axis++) {
+        setFault(sensor, axis, GYRO_VOTE_FAULT_READ, timestamp);
+        selectAxisSource(axis);
+    }
+}
+
+bool IsGyroVoteSensorHealthy(const uint8_t sensor) {
+    if (!voteStats.isEnabled || sensor >= GYRO_VOTE_SENSORS) {
+        return false;
+    }
+
+    return 0 == (voteStats.faults[sensor][0] | voteStats.faults[sensor][1] | voteStats.faults[sensor][2]);
+}
+
+uint32_t GetGyroVoteSourceChanges(void) {
+    return voteStats.sourceChanges;
+}
+
+void GetGyroVoteStats(GyroVoteStatsType * dstStats) {
+    taskENTER_CRITICAL();
+    *dstStats = voteStats;
+    taskEXIT_CRITICAL();
+}
+
+size_t PrintGyroVote(char * dst, const size_t dstSize) {
+    static const char axisNames[VOTE_AXES_N] = { 'x', 'y', 'z' };
+    GyroVoteStatsType stats;
+    char offsetString[16];
+    size_t length;
+    uint8_t axis;
+
+    GetGyroVoteStats(&stats);
+
+    length = (size_t) snprintf(dst, dstSize, "\nGyroscope redundancy: %s\n0: %s, %u failed tests\n"
+            "1: %s, %u failed tests\nSource changes: %u, disagreements: %u\n%-5s%-12s%-8s%-8s%-11s%s\n",
+            stats.isEnabled ? "voting" : "off, no second gyroscope", voteSensors[0].name,
+            (unsigned int) stats.faultCounts[0], voteSensors[1].name, (unsigned int) stats.faultCounts[1],
+            (unsigned int) stats.sourceChanges, (unsigned int) stats.disagreements, "Axis", "Source", "Faults0",
+            "Faults1", "Disagrees", "Offset[rad/s]");
+
+    for (axis = 0; axis < VOTE_AXES_N && length < dstSize; axis++) {
+        FormatFixed(offsetString, sizeof(offsetString), stats.offset[axis], 4);
+        length += (size_t) snprintf(dst + length, dstSize - length, "%-5c%-12s0x%-6x0x%-6x%-11s%s\n",
+                axisNames[axis], voteSensors[stats.source[axis]].name, (unsigned int) stats.faults[0][axis],
+                (unsigned int) stats.faults[1][axis], stats.isDisagreeing[axis] ? "yes" : "no", offsetString);
+    }
+
+    return (length < dstSize) ? length : dstSize - 1;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Runs the read, stuck and range tests of a gyroscope sample, and ends the faults older than
+ *         GYRO_VOTE_FAULT_HOLD_TIME
+ * @param  sensor : Gyroscope index
+ * @param  sample : Sample [rad/s], not used if not valid
+ * @param  isValid : false if the read failed
+ * @param  timestamp : Sample time [core clock cycles]
+ * @retval None
+ */
+static void testSensor(const uint8_t sensor, const float32_t * sample, const bool isValid, const uint32_t timestamp) {
+    const uint32_t cyclesPerMs = SystemCoreClock / 1000;
+    GyroVoteSensorType * const state = &voteSensors[sensor];
+    uint8_t clippedAxes;
+    uint8_t axis;
+
+    for (axis = 0; axis < VOTE_AXES_N; axis++) {
+        if (voteStats.faults[sensor][axis]
+                && timestamp - state->faultTimestamp[axis] >= GYRO_VOTE_FAULT_HOLD_TIME * cyclesPerMs) {
+            voteStats.faults[sensor][axis] = 0;
+        }
+    }
+
+    if (!isValid) {
+        if (state->readFailures < GYRO_VOTE_READ_FAILURES) {
+            state->readFailures++;
+        }
+        if (state->readFailures >= GYRO_VOTE_READ_FAILURES) {
+            for (axis = 0; axis < VOTE_AXES_N; axis++) {
+                setFault(sensor, axis, GYRO_VOTE_FAULT_READ, timestamp);
+            }
+        }
+        return;
+    }
+    state->readFailures = 0;
+
+    clippedAxes = VibrationClippedAxes(sample, state->fullScale);
+
+    for (axis = 0; axis < VOTE_AXES_N; axis++) {
+        /* a new sample of a live part differs in the noise, a slower part repeats its sample until the next one */
+        if (sample[axis] != state->sample[axis]) {
+            state->changeTimestamp[axis] = timestamp;
+        } else if (timestamp - state->changeTimestamp[axis] >= GYRO_VOTE_STUCK_TIME * cyclesPerMs) {
+            setFault(sensor, axis, GYRO_VOTE_FAULT_STUCK, timestamp);
+        }
+
+        if (clippedAxes & (1 << axis)) {
+            setFault(sensor, axis, GYRO_VOTE_FAULT_RANGE, timestamp);
+        }
+
+        state->sample[axis] = sample[axis];
+    }
+}
+
+static void setFault(const uint8_t sensor, const uint8_t axis, const uint8_t fault, const uint32_t timestamp) {
+    if (!(voteStats.faults[sensor][axis] & fault)) {
+        voteStats.faultCounts[sensor]++;
+    }
+    voteStats.faults[sensor][axis] |= fault;
+    voteSensors[sensor].faultTimestamp[axis] = timestamp;
+}
+
+/*
+ * @brief  Compares an axis of the two gyroscopes when both are fault free. Updates the offset of gyroscope 1 while
+ *         they agree, else tracks the disagreement.
+ * @param  axis : Axis index
+ * @param  alpha : Low pass filter coefficient of the offset
+ * @param  timestamp : Sample time [core clock cycles]
+ * @retval None
+ */
+static void compareAxis(const uint8_t axis, const float32_t alpha, const uint32_t timestamp) {
+    const float32_t difference = voteSensors[1].sample[axis] - voteSensors[0].sample[axis];
+
+    if (voteStats.faults[0][axis] || voteStats.faults[1][axis]) {
+        /* explained by the fault, the offset is kept for the switch */
+        disagreeTimestamp[axis] = 0;
+        voteStats.isDisagreeing[axis] = false;
+        return;
+    }
+
+    if (fabsf(difference - voteStats.offset[axis]) <= GYRO_VOTE_MAX_DIFFERENCE) {
+        disagreeTimestamp[axis] = 0;
+        voteStats.isDisagreeing[axis] = false;
+        voteStats.offset[axis] += alpha * (difference - voteStats.offset[axis]);
+        return;
+    }
+
+    if (0 == disagreeTimestamp[axis]) {
+        disagreeTimestamp[axis] = timestamp | 1; /* not 0 */
+    } else if (!voteStats.isDisagreeing[axis]
+            && timestamp - disagreeTimestamp[axis] >= GYRO_VOTE_DISAGREE_TIME * (SystemCoreClock / 1000)) {
+        voteStats.isDisagreeing[axis] = true;
+        voteStats.disagreements++;
+#if DIAG_ENABLED(GYRO, DIAG_ERROR)
+        LOG1("ERROR: gyroscopes disagree on axis %lu, see gyro-redundancy", (uint32_t) axis);
+#endif
+    }
+}
+
+/*
+ * @brief  Selects the other gyroscope for an axis if the selected one is faulty and the other one is not
+ * @param  axis : Axis index
+ * @retval None
+ */
+static void selectAxisSource(const uint8_t axis) {
+    const uint8_t source = voteStats.source[axis];
+    const uint8_t other = 1 - source;
+
+    if (voteStats.faults[source][axis] && !voteStats.faults[other][axis]) {
+        voteStats.source[axis] = other;
+        voteStats.sourceChanges++;
+#if DIAG_ENABLED(GYRO, DIAG_ERROR)
+        LOG1("ERROR: gyroscope axis %lu failed over, see gyro-redundancy", (uint32_t) axis);
+#endif
+    }
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -9,23 +9,61 @@
 /* Includes ------------------------------------------------------------------*/
 #include "fcb_gyroscope.h"
 #include "fcb_sensors.h"
+#include "fcb_sensor_bus.h"
+#include "fcb_sensor_watchdog.h"
+#include "fcb_sensor_self_test.h"
+#include "fcb_sensor_orientation.h"
+#include "fcb_vibration_monitor.h"
+#include "fcb_sensor_filter.h"
+#include "fcb_rpm_filter.h"
+#include "fcb_dynamic_notch.h"
+#include "fcb_sensor_load_test.h"
+#include "flight_control.h"
+#include "control_executive.h"
+#include "flash.h"
 #include "l3gd20.h"
+#ifdef FCB_EXTERNAL_IMU
+#include "icm20602.h"
+#endif
+#ifdef FCB_REDUNDANT_GYRO
+#if !defined(FCB_EXTERNAL_IMU) || defined(FCB_GYRO_FIFO_MODE) || defined(FCB_CONTROL_EXECUTIVE)
+#error "FCB_REDUNDANT_GYRO needs FCB_EXTERNAL_IMU, and votes in the SENSORS task, not in FIFO or executive mode"
+#endif
+#include "fcb_gyro_redundancy.h"
+#endif
 
 
 #include "fcb_error.h"
+#include "common.h"
+#include "seqlock.h"
+#include "profiler.h"
+#include "scope_probe.h"
+#include "fcb_diag.h"
 #include "FreeRTOS.h"
+#include "task.h"
 #include "semphr.h"
 #include "usbd_cdc_if.h"
+#include "telemetry_aggregate.h"
 
 #include "trace.h"
 
 #include <string.h>
+#include <math.h>
 #include <stdio.h>
 
 /* Private typedef -----------------------------------------------------------*/
 
+/* A supported gyroscope and the MCU pin of its data ready interrupt */
+typedef struct {
+    const char * name;
+    GYRO_DrvTypeDef * driver;
+    GPIO_TypeDef * drdyPort;
+    uint16_t drdyPin;
+    IRQn_Type drdyIRQn;
+} GyroDriverEntryType;
+
 /* Private define ------------------------------------------------------------*/
-#define FCB_GYRO_DEBUG
+#define GYRO_TEMP_READ_PERIOD       1000 // Between the temperature reads [ms], the die temperature changes slowly
 
 /* static & local declarations */
 
@@ -35,10 +73,10 @@ enum { XDOT_IDX = 0 }; /* index of sGyroXYZAngleDot & ditto Offset */
 enum { YDOT_IDX = 1 }; /* as above */
 enum { ZDOT_IDX = 2 }; /* as above */
 
-const float32_t GYRO_X_AXIS_VARIANCE = 0.098603; // TODO These could be used to set Kalman filters Correction variance (R)
-const float32_t GYRO_Y_AXIS_VARIANCE = 0.104274;
-const float32_t GYRO_Z_AXIS_VARIANCE = 0.103256;
-const float32_t GYRO_AXIS_VARIANCE_ROUGH = 0.000256;
+const float32_t GYRO_X_AXIS_VARIANCE = 0.098603f; // TODO These could be used to set Kalman filters Correction variance (R)
+const float32_t GYRO_Y_AXIS_VARIANCE = 0.104274f;
+const float32_t GYRO_Z_AXIS_VARIANCE = 0.103256f;
+const float32_t GYRO_AXIS_VARIANCE_ROUGH = 0.000256f;
 
 
 /**
@@ -49,45 +87,179 @@ const float32_t GYRO_AXIS_VARIANCE_ROUGH = 0.000256;
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 
-static float32_t sGyroXYZAngleDot[3] = { 0.0, 0.0, 0.0 }; /* not volatile - only print thread reads */
-static xSemaphoreHandle mutexGyro;
+/* Probed in order at boot, the first that configures is used */
+static const GyroDriverEntryType sGyroDrivers[] = {
+#ifdef FCB_EXTERNAL_IMU
+    { "ICM-20602", &Icm20602Drv, IMU_INT_GPIO_PORT, IMU_INT_PIN, IMU_INT_EXTI_IRQn },
+#endif
+    { "L3GD20", &L3gd20Drv, GYRO_INT_GPIO_PORT, GYRO_INT2_PIN, GYRO_INT2_EXTI_IRQn }
+};
+
+/* not changed after InitialiseGyroscope, except by SwapGyroscopeClock */
+static GYRO_DrvTypeDef * sGyroDrv = &L3gd20Drv;
+static const GyroDriverEntryType * sGyroDriverEntry = NULL; /* ditto, NULL before */
+
+#ifdef FCB_REDUNDANT_GYRO
+/* The gyroscopes of the voting, 0 is the one configured first and the other one NULL if it did not answer, and the
+ * index of the one whose data ready clocks the samples */
+static const GyroDriverEntryType * sGyroVoteEntries[GYRO_VOTE_SENSORS] = { NULL, NULL };
+static uint8_t sGyroClockIdx = 0;
+#endif
+
+/* Two copies, the sequence lock publishes one while the other is written */
+static float32_t sGyroXYZAngleDot[2][3];
+static SeqLock_TypeDef seqLockGyro; /* guards sGyroXYZAngleDot & sGyroSampleTimestamp */
+
+/* Raw sample of the last completed DMA burst read, written in ISR context */
+static volatile int16_t sGyroDmaRawData[3] = { 0, 0, 0 };
+
+static uint32_t sGyroSampleTimestamp[2]; /* [core clock cycles] time of the sample in sGyroXYZAngleDot */
+
+/* Sensor axes to quadcopter axes: the turn to the board axes, see the "Sensors" wiki page, then the mounting rotation
+ * and trim, see fcb_sensor_orientation.h. Written with the SENSORS task and the control executive locked out, see
+ * UpdateGyroscopeOrientation. */
+static float32_t sGyroRotation[3][3] = {
+    { 0.0f, -1.0f, 0.0f },
+    { -1.0f, 0.0f, 0.0f },
+    { 0.0f, 0.0f, -1.0f }
+};
+
+/* Bias vs temperature table and the bias it gives at the last read temperature, in board axes, and the bias in
+ * quadcopter axes, which is subtracted from the samples. Written under a critical section by the lower priority
+ * tasks, the SENSORS task or the control executive reads without locking. An axis is a single word, the bias changes
+ * slowly enough that a mixed update does not matter. */
+static FcbGyroTempCompensationType sGyroTempCompensation;
+static float32_t sGyroTempBias[3] = { 0.0, 0.0, 0.0 };
+static float32_t sGyroRotatedTempBias[3] = { 0.0, 0.0, 0.0 };
+static float32_t sGyroFullScale = 0.0f; /* [rad/s] set by InitialiseGyroscope */
+static int8_t sGyroTemperature = 0; /* [deg C, relative] */
+static uint16_t sGyroSamplesSinceTemperatureRead = 0;
+
+#ifdef FCB_GYRO_FIFO_MODE
+static int16_t sGyroFifoRawData[GYRO_MAX_SAMPLES_PER_READ][3];
+#endif
+
+#ifdef FCB_SENSOR_LOAD_TEST
+static float32_t sLoadTestGyroData[3] = { 0.0, 0.0, 0.0 }; /* [rad/s] last real sample, passed on during the test */
+#endif
 
 /* Private function prototypes -----------------------------------------------*/
+static const GyroDriverEntryType * ConfigGyroscopeDriver(void);
+static void EnableGyroscopeDrdy(const GyroDriverEntryType * entry);
+#ifdef FCB_REDUNDANT_GYRO
+static void InitialiseGyroVote(const GyroDriverEntryType * primary);
+static void VoteGyroscopeData(const float32_t * clockData, uint32_t timestamp, float32_t * votedData);
+static bool SwapGyroscopeClock(void);
+#endif
+static void UpdateGyroscopeData(const float * gyroscopeData, uint32_t timestamp);
+static void PublishGyroscopeData(const float32_t * angleDot, uint32_t timestamp);
+static void GyroSelfTest(void);
+static FcbRetValType ReadGyroSelfTestMean(int8_t sign, float32_t * mean);
+static void ReadGyroTemperature(void);
+static void UpdateGyroTempBias(void);
+static void RotateGyroTempBias(const float32_t rotation[3][3]);
+static FcbRetValType SaveGyroTempCompensation(void);
+#ifdef FCB_GYRO_FIFO_MODE
+static void FetchFIFODataFromGyroscope(void);
+#endif
 
 /* Exported functions --------------------------------------------------------*/
 
 /* global fcn definitions */
 uint8_t InitialiseGyroscope(void) {
     uint8_t retVal = FCB_OK;
-    GPIO_InitTypeDef GPIO_InitStructure;
+    const GyroDriverEntryType * entry;
+    const int16_t fullScaleRawData[3] = { INT16_MAX, INT16_MAX, INT16_MAX };
+    float32_t fullScale[3];
 
-    if (NULL == (mutexGyro = xSemaphoreCreateMutex())) {
-      return FCB_ERR_INIT;
+    /* sets full scale (and sensitivity) plus data rate of the gyroscope, enables its bus and pin clocks */
+    entry = ConfigGyroscopeDriver();
+    if (entry == NULL) {
+        /* Initialization Error */
+        ErrorHandler();
+        return FCB_ERR;
     }
+    sGyroDrv = entry->driver;
+    sGyroDriverEntry = entry;
 
-    /* configure GYRO DRDY (data ready) interrupt */
-    GYRO_CS_GPIO_CLK_ENABLE(); /* happens to be GPIOE */
+    /* for the clipping detection of the vibration monitor */
+    sGyroDrv->ConvertXYZ(fullScaleRawData, fullScale);
+    sGyroFullScale = (fullScale[XDOT_IDX] >= 0.0f) ? fullScale[XDOT_IDX] : -fullScale[XDOT_IDX];
 
-    GPIO_InitStructure.Pin = GPIO_PIN_1; /* STM32F3 doc UM1570 page 27/36 */
-    GPIO_InitStructure.Mode = GPIO_MODE_IT_RISING;
-    GPIO_InitStructure.Pull = GPIO_NOPULL;
-    GPIO_InitStructure.Speed = GPIO_SPEED_HIGH;
-    HAL_GPIO_Init(GYRO_INT_GPIO_PORT, &GPIO_InitStructure);
+#ifdef FCB_REDUNDANT_GYRO
+    /* configures the other gyroscope, if it answers */
+    InitialiseGyroVote(entry);
+#endif
 
-    HAL_NVIC_SetPriority(EXTI1_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY, 0);
-    HAL_NVIC_EnableIRQ(EXTI1_IRQn);
+    /* the mounting rotation, see SensorOrientationInit */
+    UpdateGyroscopeOrientation();
 
-    /* sets full scale (and sensitivity) plus data rate of L3GD20 gyroscope */
-    if(L3GD20_Config() != 0)
-    {
-        /* Initialization Error */
-    	ErrorHandler();
+    /* polled, before the FIFO and the data ready interrupt */
+    GyroSelfTest();
+
+#ifdef FCB_GYRO_FIFO_MODE
+    /* watermark interrupt is routed to the DRDY pin, so no GPIO changes */
+    if (sGyroDrv->ConfigFIFO == NULL || sGyroDrv->ConfigFIFO(GYRO_FIFO_WATERMARK) != 0) {
+        ErrorHandler();
+    }
+#endif
+
+    EnableGyroscopeDrdy(entry);
+
+    /* Apply the stored temperature compensation from the first sample */
+    if (FLASH_OK != ReadGyroTempCompensationFromFlash(&sGyroTempCompensation)) {
+        memset(&sGyroTempCompensation, 0, sizeof(sGyroTempCompensation));
+    }
+    ReadGyroTemperature();
+
+    FetchDataFromGyroscope(); /* necessary so a fresh DRDY can be triggered */
+    return retVal;
+}
+
+uint16_t GyroDataRateHz(void) {
+    return sGyroDrv->DataRateHz();
+}
+
+/*
+ * @brief  Reconfigures the gyroscope in use with the data rate and filters nearest to the requested ones. The
+ *         data ready interrupt is off meanwhile, so no read overlaps the reconfiguration. In FIFO mode the FIFO
+ *         keeps its own data rate.
+ * @param  dataRateHz : Requested data rate in, selected one out [Hz]
+ * @param  lowPassHz : Requested low-pass cutoff in, selected one out [Hz], 0 for the widest
+ * @param  highPassHz : Requested high-pass cutoff in, selected one out [Hz], 0 for off
+ * @retval FCB_OK, or FCB_ERR if the gyroscope does not support it
+ */
+uint8_t SetGyroscopeRates(float32_t * dataRateHz, float32_t * lowPassHz, float32_t * highPassHz) {
+    uint8_t retVal = FCB_OK;
+
+    if (sGyroDriverEntry == NULL || sGyroDrv->SetRates == NULL
+            || sGyroDrv->SetRates(dataRateHz, lowPassHz, highPassHz) != 0) {
+        return FCB_ERR;
+    }
+
+    HAL_NVIC_DisableIRQ(sGyroDriverEntry->drdyIRQn);
+
+    if (sGyroDrv->Config() != 0) {
+        retVal = FCB_ERR;
+    }
+#ifdef FCB_GYRO_FIFO_MODE
+    if (sGyroDrv->ConfigFIFO(GYRO_FIFO_WATERMARK) != 0) {
+        retVal = FCB_ERR;
     }
+#endif
+    *dataRateHz = (float32_t) sGyroDrv->DataRateHz();
+
+    __HAL_GPIO_EXTI_CLEAR_IT(sGyroDriverEntry->drdyPin);
+    HAL_NVIC_EnableIRQ(sGyroDriverEntry->drdyIRQn);
 
     FetchDataFromGyroscope(); /* necessary so a fresh DRDY can be triggered */
     return retVal;
 }
 
+RAMFUNC void GyroConvertXYZ(const int16_t * rawData, float32_t * gyroscopeData) {
+    sGyroDrv->ConvertXYZ(rawData, gyroscopeData);
+}
+
 uint8_t SensorRegisterGyroClientCallback(SendCorrectionUpdateCallback_TypeDef cbk) {
   if (NULL != SendCorrectionUpdateCallback) {
     return FCB_ERR;
@@ -98,71 +270,702 @@ uint8_t SensorRegisterGyroClientCallback(SendCorrectionUpdateCallback_TypeDef cb
   return FCB_OK;
 }
 
-void FetchDataFromGyroscope(void) {
+RAMFUNC void FetchDataFromGyroscope(void) {
+    PROFILE_SCOPE(PROFILE_PROBE_GYRO_FETCH);
+
+#ifdef FCB_SENSOR_LOAD_TEST
+    if (SensorLoadTestIsActive()) {
+        UpdateGyroscopeData(sLoadTestGyroData, GetSensorDrdyTimestamp(GYRO_IDX));
+        SensorLoadTestSample(GYRO_IDX);
+        return;
+    }
+#endif
+
+#ifdef FCB_GYRO_FIFO_MODE
+    FetchFIFODataFromGyroscope();
+#else
     float gyroscopeData[3] = { 0.0f, 0.0f, 0.0f };
     HAL_StatusTypeDef status = HAL_OK;
 
-    /* paranoia - this is used for calculations to reduce the time this function
-     * needs to hold the mutexMag
-     */
-    float lGyroXYZAngleDot[3] = { 0.0f, 0.0f, 0.0f };
-
     /* returns rad/s */
-    status = L3GD20_ReadXYZAngRate(gyroscopeData);
+    status = sGyroDrv->GetXYZ(gyroscopeData);
     if (status != HAL_OK) {
-#ifdef FCB_GYRO_DEBUG
-        USBComSendString("ERROR: L3GD20_ReadXYZAngRate\n");
+#if DIAG_ENABLED(GYRO, DIAG_ERROR)
+        LOG0("ERROR: gyroscope GetXYZ");
 #endif
+        FcbSensorReadFailed(GYRO_IDX);
         FcbSendSensorMessage(FCB_SENSOR_GYRO_DATA_READY); // Re-send data ready read request if read fails
         return;
     }
 
-    /* see "Sensors" wiki page for gyroscope vs Quadcopter axes orientations */
-    lGyroXYZAngleDot[XDOT_IDX] = -gyroscopeData[YDOT_IDX];
-    lGyroXYZAngleDot[YDOT_IDX] = -gyroscopeData[XDOT_IDX];
-    lGyroXYZAngleDot[ZDOT_IDX] = -gyroscopeData[ZDOT_IDX];
+    UpdateGyroscopeData(gyroscopeData, GetSensorDrdyTimestamp(GYRO_IDX));
+#endif
+}
 
-    if (pdTRUE != xSemaphoreTake(mutexGyro,  portMAX_DELAY /* wait forever */)) {
-      ErrorHandler();
-      return;
+/*
+ * @brief  Runs a recovery step of a stalled gyroscope, see fcb_sensor_watchdog.h.
+ *         Every step ends with a polled read, which also clears a data ready
+ *         signal that was missed.
+ * @param  step : Recovery step
+ * @retval None
+ */
+void RecoverGyroscope(FcbSensorRecoveryType step) {
+    if (sGyroDriverEntry == NULL) {
+        return;
     }
 
-    sGyroXYZAngleDot[XDOT_IDX] = lGyroXYZAngleDot[XDOT_IDX];
-    sGyroXYZAngleDot[YDOT_IDX] = lGyroXYZAngleDot[YDOT_IDX];
-    sGyroXYZAngleDot[ZDOT_IDX] = lGyroXYZAngleDot[ZDOT_IDX];
+#ifdef FCB_REDUNDANT_GYRO
+    /* the data ready of the other gyroscope takes over at once, the stalled one is then only read by the voting */
+    if (SENSOR_RECOVERY_REARM == step && SwapGyroscopeClock()) {
+        FetchDataFromGyroscope();
+        return;
+    }
+#endif
 
-    if (pdTRUE != xSemaphoreGive(mutexGyro)) {
-      ErrorHandler();
-      return;
+    switch (step) {
+    case SENSOR_RECOVERY_REARM:
+        __HAL_GPIO_EXTI_CLEAR_IT(sGyroDriverEntry->drdyPin);
+        HAL_NVIC_EnableIRQ(sGyroDriverEntry->drdyIRQn);
+        break;
+    case SENSOR_RECOVERY_RESET:
+        if (sGyroDrv->Config() != 0) {
+#if DIAG_ENABLED(GYRO, DIAG_ERROR)
+            LOG0("ERROR: gyroscope reconfiguration");
+#endif
+        }
+#ifdef FCB_GYRO_FIFO_MODE
+        if (sGyroDrv->ConfigFIFO(GYRO_FIFO_WATERMARK) != 0) {
+#if DIAG_ENABLED(GYRO, DIAG_ERROR)
+            LOG0("ERROR: gyroscope FIFO reconfiguration");
+#endif
+        }
+#endif
+        break;
+    case SENSOR_RECOVERY_BUS:
+        GYRO_IO_ResetBus();
+        break;
+    default:
+        return;
     }
 
-    if (SendCorrectionUpdateCallback != NULL) {
-        SendCorrectionUpdateCallback(GYRO_IDX, sGyroXYZAngleDot);
+    FetchDataFromGyroscope();
+}
+
+RAMFUNC void GyroscopeDataReadyFromISR(void) {
+    PROFILE_SCOPE(PROFILE_PROBE_GYRO_DRDY_ISR);
+
+#ifdef FCB_GYRO_FIFO_MODE
+    /* FIFO watermark reached, the whole FIFO is drained in task context */
+    FcbSendSensorMessageFromISR(FCB_SENSOR_GYRO_DATA_READY);
+#else
+    /* Kick off the burst read, the SENSORS task is woken on transfer complete.
+     * Fall back to a polled read in task context if the SPI bus is busy, or
+     * pass the held sample on there during the sensor load test */
+    if (SENSOR_LOAD_TEST_IS_ACTIVE() || sGyroDrv->StartReadXYZDMA() != HAL_OK) {
+        FcbSendSensorMessageFromISR(FCB_SENSOR_GYRO_DATA_READY);
     }
+#endif
+}
+
+RAMFUNC void GyroscopeDMACompleteFromISR(void) {
+    PROFILE_SCOPE(PROFILE_PROBE_GYRO_DMA_ISR);
+    int16_t rawData[3];
+
+    sGyroDrv->FinishReadXYZDMA(rawData);
+
+    sGyroDmaRawData[XDOT_IDX] = rawData[XDOT_IDX];
+    sGyroDmaRawData[YDOT_IDX] = rawData[YDOT_IDX];
+    sGyroDmaRawData[ZDOT_IDX] = rawData[ZDOT_IDX];
+
+#ifdef FCB_CONTROL_EXECUTIVE
+    /* The executive processes the sample and closes the rate loop before the SENSORS task gets it */
+    ControlExecutiveTriggerFromISR(rawData, GetSensorDrdyTimestamp(GYRO_IDX));
+#endif
+
+    FcbSendSensorMessageFromISR(FCB_SENSOR_GYRO_DMA_COMPLETE);
+}
+
+void GyroscopeDMAErrorFromISR(void) {
+    sGyroDrv->AbortReadXYZDMA(); /* release chip select */
+    FcbSensorReadFailedFromISR(GYRO_IDX);
+    FcbSendSensorMessageFromISR(FCB_SENSOR_GYRO_DATA_READY); // Retry with a polled read
+}
+
+RAMFUNC void FetchDMADataFromGyroscope(void) {
+    PROFILE_SCOPE(PROFILE_PROBE_GYRO_FETCH);
+#ifdef FCB_CONTROL_EXECUTIVE
+    float32_t lGyroXYZAngleDot[3];
+
+    SCOPE_PROBE_MARK(SCOPE_PROBE_STAGE_FETCH);
+
+    /* Already processed by the control executive */
+    ControlExecutiveGetGyroSample(lGyroXYZAngleDot);
+    PublishGyroscopeData(lGyroXYZAngleDot, GetSensorDrdyTimestamp(GYRO_IDX));
+#else
+    float gyroscopeData[3] = { 0.0f, 0.0f, 0.0f };
+    int16_t rawData[3];
+
+    taskENTER_CRITICAL();
+    rawData[XDOT_IDX] = sGyroDmaRawData[XDOT_IDX];
+    rawData[YDOT_IDX] = sGyroDmaRawData[YDOT_IDX];
+    rawData[ZDOT_IDX] = sGyroDmaRawData[ZDOT_IDX];
+    taskEXIT_CRITICAL();
+
+    /* returns rad/s */
+    GyroConvertXYZ(rawData, gyroscopeData);
+
+    UpdateGyroscopeData(gyroscopeData, GetSensorDrdyTimestamp(GYRO_IDX));
+#endif
 }
 
 
 void GetGyroAngleDot(float32_t * xAngleDot, float32_t * yAngleDot, float * zAngleDot) {
-  if (pdTRUE != xSemaphoreTake(mutexGyro,  portMAX_DELAY /* wait forever */)) {
-    ErrorHandler();
-    return;
+  uint32_t sequence;
+
+  do {
+    sequence = SeqLockReadBegin(&seqLockGyro);
+    *xAngleDot = sGyroXYZAngleDot[SEQLOCK_COPY(sequence)][XDOT_IDX];
+    *yAngleDot = sGyroXYZAngleDot[SEQLOCK_COPY(sequence)][YDOT_IDX];
+    *zAngleDot = sGyroXYZAngleDot[SEQLOCK_COPY(sequence)][ZDOT_IDX];
+  } while (SeqLockReadRetry(&seqLockGyro, sequence));
+}
+
+
+void GetGyroAngleDotNoMutex(float32_t * xAngleDot, float32_t * yAngleDot, float * zAngleDot) {
+  const float32_t * angleDot = sGyroXYZAngleDot[SEQLOCK_PUBLISHED(&seqLockGyro)];
+
+  *xAngleDot = angleDot[XDOT_IDX];
+  *yAngleDot = angleDot[YDOT_IDX];
+  *zAngleDot = angleDot[ZDOT_IDX];
+}
+
+uint32_t GetGyroSampleTimestampNoMutex(void) {
+  return sGyroSampleTimestamp[SEQLOCK_PUBLISHED(&seqLockGyro)];
+}
+
+int8_t GetGyroTemperature(void) {
+  return sGyroTemperature;
+}
+
+void GetGyroTempCompensation(FcbGyroTempCompensationType* dstCompensation) {
+  taskENTER_CRITICAL();
+  memcpy(dstCompensation, &sGyroTempCompensation, sizeof(FcbGyroTempCompensationType));
+  taskEXIT_CRITICAL();
+}
+
+FcbRetValType SetGyroTempCompensationEnabled(uint8_t enable) {
+  if (enable > 1 || FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+    return FCB_ERR;
   }
 
-  *xAngleDot = sGyroXYZAngleDot[XDOT_IDX];
-  *yAngleDot = sGyroXYZAngleDot[YDOT_IDX];
-  *zAngleDot = sGyroXYZAngleDot[ZDOT_IDX];
+  taskENTER_CRITICAL();
+  sGyroTempCompensation.isEnabled = enable;
+  UpdateGyroTempBias();
+  taskEXIT_CRITICAL();
+
+  return SaveGyroTempCompensation();
+}
 
-  if (pdTRUE != xSemaphoreGive(mutexGyro)) {
-    ErrorHandler();
-    return;
+FcbRetValType ClearGyroTempCompensation(void) {
+  if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+    return FCB_ERR;
   }
+
+  taskENTER_CRITICAL();
+  sGyroTempCompensation.validBins = 0;
+  memset(sGyroTempCompensation.bias, 0, sizeof(sGyroTempCompensation.bias));
+  UpdateGyroTempBias();
+  taskEXIT_CRITICAL();
+
+  return SaveGyroTempCompensation();
 }
 
+FcbRetValType AddGyroTempCompensationPoint(const float32_t residualBias[3]) {
+  float32_t rotation[3][3];
+  float32_t boardResidualBias[3];
+  int16_t bin;
+  uint8_t i;
 
-void GetGyroAngleDotNoMutex(float32_t * xAngleDot, float32_t * yAngleDot, float * zAngleDot) {
-  *xAngleDot = sGyroXYZAngleDot[XDOT_IDX];
-  *yAngleDot = sGyroXYZAngleDot[YDOT_IDX];
-  *zAngleDot = sGyroXYZAngleDot[ZDOT_IDX];
+  if (!sGyroTempCompensation.isEnabled || FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+    return FCB_ERR;
+  }
+
+  bin = (sGyroTemperature - GYRO_TEMP_COMP_MIN_TEMP) / GYRO_TEMP_COMP_BIN_WIDTH;
+  if (bin < 0) {
+    bin = 0;
+  } else if (bin >= GYRO_TEMP_COMP_BINS) {
+    bin = GYRO_TEMP_COMP_BINS - 1;
+  }
+
+  /* The table is in board axes, the rotation is orthonormal */
+  GetSensorOrientationMatrix(rotation);
+  for (i = 0; i < 3; i++) {
+    boardResidualBias[i] = rotation[0][i] * residualBias[0] + rotation[1][i] * residualBias[1]
+        + rotation[2][i] * residualBias[2];
+  }
+
+  taskENTER_CRITICAL();
+  for (i = 0; i < 3; i++) {
+    /* The samples were compensated with sGyroTempBias, the rest bias is the sum. Measurements in an already
+     * measured bin are averaged with the previous ones, with a weight halving per measurement. */
+    if (sGyroTempCompensation.validBins & (1 << bin)) {
+      sGyroTempCompensation.bias[bin][i] = 0.5f * (sGyroTempCompensation.bias[bin][i]
+          + sGyroTempBias[i] + boardResidualBias[i]);
+    } else {
+      sGyroTempCompensation.bias[bin][i] = sGyroTempBias[i] + boardResidualBias[i];
+    }
+  }
+  sGyroTempCompensation.validBins |= 1 << bin;
+  UpdateGyroTempBias();
+  taskEXIT_CRITICAL();
+
+  return SaveGyroTempCompensation();
+}
+
+void UpdateGyroscopeOrientation(void) {
+    static const float32_t boardAxes[3][3] = {
+        { 0.0f, -1.0f, 0.0f },
+        { -1.0f, 0.0f, 0.0f },
+        { 0.0f, 0.0f, -1.0f }
+    };
+    float32_t orientation[3][3];
+    float32_t rotation[3][3];
+    uint8_t i, j;
+
+    GetSensorOrientationMatrix(orientation);
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 3; j++) {
+            rotation[i][j] = orientation[i][0] * boardAxes[0][j] + orientation[i][1] * boardAxes[1][j]
+                    + orientation[i][2] * boardAxes[2][j];
+        }
+    }
+
+#ifdef FCB_CONTROL_EXECUTIVE
+    /* it processes its samples in its interrupt */
+    ControlExecutiveSuspend();
+#endif
+    taskENTER_CRITICAL();
+    memcpy(sGyroRotation, rotation, sizeof(sGyroRotation));
+    RotateGyroTempBias(orientation);
+    taskEXIT_CRITICAL();
+#ifdef FCB_CONTROL_EXECUTIVE
+    ControlExecutiveResume();
+#endif
+}
+
+/*
+ * Rotates a gyroscope sample (rad/s, sensor axes) to quadcopter axes, removes
+ * the temperature dependent bias and filters it. Called by the SENSORS task,
+ * or by the control executive, which then owns the filter state. Uses no
+ * FreeRTOS API.
+ */
+RAMFUNC void ProcessGyroscopeSample(const float32_t * gyroscopeData, float32_t * angleDot) {
+    const float32_t x = gyroscopeData[XDOT_IDX];
+    const float32_t y = gyroscopeData[YDOT_IDX];
+    const float32_t z = gyroscopeData[ZDOT_IDX];
+
+    /* the board axes turn, mounting rotation and trim in one, see sGyroRotation */
+    angleDot[XDOT_IDX] = sGyroRotation[XDOT_IDX][XDOT_IDX] * x + sGyroRotation[XDOT_IDX][YDOT_IDX] * y
+            + sGyroRotation[XDOT_IDX][ZDOT_IDX] * z;
+    angleDot[YDOT_IDX] = sGyroRotation[YDOT_IDX][XDOT_IDX] * x + sGyroRotation[YDOT_IDX][YDOT_IDX] * y
+            + sGyroRotation[YDOT_IDX][ZDOT_IDX] * z;
+    angleDot[ZDOT_IDX] = sGyroRotation[ZDOT_IDX][XDOT_IDX] * x + sGyroRotation[ZDOT_IDX][YDOT_IDX] * y
+            + sGyroRotation[ZDOT_IDX][ZDOT_IDX] * z;
+
+    /* before the filter, which removes the vibration. The full scale is of the sensor axes. */
+    VibrationMonitorUpdate(GYRO_IDX, angleDot, VibrationClippedAxes(gyroscopeData, sGyroFullScale));
+
+    angleDot[XDOT_IDX] -= sGyroRotatedTempBias[XDOT_IDX];
+    angleDot[YDOT_IDX] -= sGyroRotatedTempBias[YDOT_IDX];
+    angleDot[ZDOT_IDX] -= sGyroRotatedTempBias[ZDOT_IDX];
+
+    SensorFilterApply(GYRO_IDX, angleDot);
+#ifdef FCB_RPM_FILTER
+    RpmFilterApply(angleDot);
+#endif
+#ifdef FCB_DYNAMIC_NOTCH
+    /* after the motor notches, so that its analysis finds what they leave */
+    DynamicNotchApply(angleDot);
+#endif
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+#ifdef FCB_GYRO_FIFO_MODE
+/*
+ * Drains the gyroscope FIFO and passes the samples on oldest first. The last
+ * sample is taken to be from the time of the read and the earlier ones are
+ * spaced by the nominal sample period.
+ */
+static void FetchFIFODataFromGyroscope(void) {
+    float gyroscopeData[3] = { 0.0f, 0.0f, 0.0f };
+    HAL_StatusTypeDef status = HAL_OK;
+    uint8_t nbrOfSamples = 0;
+    uint8_t i;
+    uint32_t readTimestamp;
+    uint32_t samplePeriod = SystemCoreClock / GyroDataRateHz(); /* [core clock cycles] */
+
+    status = sGyroDrv->ReadFIFO(&sGyroFifoRawData[0][0], GYRO_MAX_SAMPLES_PER_READ, &nbrOfSamples);
+    readTimestamp = GetTimestamp();
+    if (status != HAL_OK) {
+#if DIAG_ENABLED(GYRO, DIAG_ERROR)
+        LOG0("ERROR: gyroscope ReadFIFO");
+#endif
+        FcbSensorReadFailed(GYRO_IDX);
+        FcbSendSensorMessage(FCB_SENSOR_GYRO_DATA_READY); // Re-send data ready read request if read fails
+        return;
+    }
+
+    for (i = 0; i < nbrOfSamples; i++) {
+        /* returns rad/s */
+        GyroConvertXYZ(sGyroFifoRawData[i], gyroscopeData);
+        UpdateGyroscopeData(gyroscopeData, readTimestamp - (nbrOfSamples - 1 - i) * samplePeriod);
+    }
+}
+#endif
+
+/*
+ * Configures the first of sGyroDrivers that answers on its bus.
+ * Returns NULL if none does.
+ */
+static const GyroDriverEntryType * ConfigGyroscopeDriver(void) {
+    uint8_t i;
+
+    for (i = 0; i < sizeof(sGyroDrivers) / sizeof(sGyroDrivers[0]); i++) {
+        if (sGyroDrivers[i].driver->Config() == 0) {
+            return &sGyroDrivers[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Configures the data ready interrupt of a gyroscope, STM32F3 doc UM1570 page
+ * 27/36 for the L3GD20
+ */
+static void EnableGyroscopeDrdy(const GyroDriverEntryType * entry) {
+    GPIO_InitTypeDef GPIO_InitStructure;
+
+    GPIO_InitStructure.Pin = entry->drdyPin;
+    GPIO_InitStructure.Mode = GPIO_MODE_IT_RISING;
+    GPIO_InitStructure.Pull = GPIO_NOPULL;
+    GPIO_InitStructure.Speed = GPIO_SPEED_HIGH;
+    HAL_GPIO_Init(entry->drdyPort, &GPIO_InitStructure);
+    __HAL_GPIO_EXTI_CLEAR_IT(entry->drdyPin);
+
+    HAL_NVIC_SetPriority(entry->drdyIRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(entry->drdyIRQn);
+}
+
+#ifdef FCB_REDUNDANT_GYRO
+/*
+ * Configures the first other gyroscope of sGyroDrivers that answers and
+ * starts the voting. Its data ready is not enabled, it is read by
+ * VoteGyroscopeData.
+ */
+static void InitialiseGyroVote(const GyroDriverEntryType * primary) {
+    const int16_t fullScaleRawData[3] = { INT16_MAX, INT16_MAX, INT16_MAX };
+    const char * names[GYRO_VOTE_SENSORS] = { primary->name, NULL };
+    float32_t fullScale[3];
+    float32_t voteFullScale[GYRO_VOTE_SENSORS] = { sGyroFullScale, 0.0f };
+    uint8_t i;
+
+    sGyroVoteEntries[0] = primary;
+    for (i = 0; i < sizeof(sGyroDrivers) / sizeof(sGyroDrivers[0]); i++) {
+        if (&sGyroDrivers[i] != primary && sGyroDrivers[i].driver->Config() == 0) {
+            sGyroVoteEntries[1] = &sGyroDrivers[i];
+            names[1] = sGyroDrivers[i].name;
+            sGyroDrivers[i].driver->ConvertXYZ(fullScaleRawData, fullScale);
+            voteFullScale[1] = fabsf(fullScale[XDOT_IDX]);
+            break;
+        }
+    }
+
+    GyroVoteInit(names, voteFullScale);
+}
+
+/*
+ * Reads the gyroscope that does not clock the samples and votes between the
+ * two, a failed read is passed on to the voting as such
+ */
+static void VoteGyroscopeData(const float32_t * clockData, uint32_t timestamp, float32_t * votedData) {
+    const uint8_t other = 1 - sGyroClockIdx;
+    float32_t samples[GYRO_VOTE_SENSORS][3];
+    bool isValid[GYRO_VOTE_SENSORS];
+
+    memcpy(samples[sGyroClockIdx], clockData, sizeof(samples[0]));
+    isValid[sGyroClockIdx] = true;
+    isValid[other] = sGyroVoteEntries[other] != NULL
+            && sGyroVoteEntries[other]->driver->GetXYZ(samples[other]) == HAL_OK;
+
+    GyroVote(samples, isValid, timestamp, votedData);
+}
+
+/*
+ * Hands the data ready over to the other gyroscope after a stall of the one
+ * that clocks the samples, if the other one is healthy. As the stalled one
+ * gives no data ready, no burst read of it runs meanwhile.
+ */
+static bool SwapGyroscopeClock(void) {
+    const uint8_t other = 1 - sGyroClockIdx;
+
+    if (sGyroVoteEntries[other] == NULL || !IsGyroVoteSensorHealthy(other)) {
+        return false;
+    }
+
+    GyroVoteSensorStalled(sGyroClockIdx);
+
+    /* masked in the EXTI, the IRQ of a line 10 to 15 is shared */
+    taskENTER_CRITICAL();
+    EXTI->IMR &= ~((uint32_t) sGyroDriverEntry->drdyPin);
+    sGyroDriverEntry = sGyroVoteEntries[other];
+    sGyroDrv = sGyroDriverEntry->driver;
+    sGyroClockIdx = other;
+    taskEXIT_CRITICAL();
+
+    EnableGyroscopeDrdy(sGyroDriverEntry);
+
+#if DIAG_ENABLED(GYRO, DIAG_ERROR)
+    LOG1("ERROR: gyroscope stalled, data ready of gyroscope %lu takes over", (uint32_t) other);
+#endif
+    return true;
+}
+#endif
+
+/*
+ * Runs the electrostatic self-test of the gyroscope and reports its result,
+ * see fcb_sensor_self_test.h. The output change is half the difference of the
+ * means in the positive and the negative self-test, so a steady rotation of
+ * the UAV cancels out. Every axis must change by SENSOR_SELF_TEST_MIN_RATIO to
+ * SENSOR_SELF_TEST_MAX_RATIO of the typical change.
+ */
+static void GyroSelfTest(void) {
+    FcbSensorSelfTestStatusType result = SENSOR_SELF_TEST_PASSED;
+    float32_t positive[3], negative[3], change[3];
+    float32_t expected;
+    uint8_t axis;
+
+    if (NULL == sGyroDrv->SelfTest || NULL == sGyroDrv->SelfTestChange) {
+        SensorSelfTestSetResult(GYRO_IDX, SENSOR_SELF_TEST_UNSUPPORTED, NULL, 0.0f);
+        return;
+    }
+    expected = sGyroDrv->SelfTestChange();
+
+    if (FCB_OK != ReadGyroSelfTestMean(1, positive) || FCB_OK != ReadGyroSelfTestMean(-1, negative)) {
+        result = SENSOR_SELF_TEST_FAILED;
+        memset(change, 0, sizeof(change));
+    } else {
+        for (axis = 0; axis < 3; axis++) {
+            change[axis] = fabsf(positive[axis] - negative[axis]) / 2.0f;
+            if (change[axis] < SENSOR_SELF_TEST_MIN_RATIO * expected
+                    || change[axis] > SENSOR_SELF_TEST_MAX_RATIO * expected) {
+                result = SENSOR_SELF_TEST_FAILED;
+            }
+        }
+    }
+
+    /* back to normal mode, also after a failed read */
+    if (sGyroDrv->SelfTest(0) != HAL_OK) {
+        result = SENSOR_SELF_TEST_FAILED;
+    }
+    vTaskDelay(SENSOR_SELF_TEST_SETTLE_TIME / portTICK_RATE_MS);
+
+    SensorSelfTestSetResult(GYRO_IDX, result, change, expected);
+}
+
+/*
+ * Sets a self-test mode and averages SENSOR_SELF_TEST_SAMPLES polled samples
+ * of it [rad/s], once the output has settled
+ */
+static FcbRetValType ReadGyroSelfTestMean(int8_t sign, float32_t * mean) {
+    const portTickType samplePeriod = (1000 / sGyroDrv->DataRateHz() + 1) / portTICK_RATE_MS;
+    float32_t sample[3];
+    uint8_t i, axis;
+
+    if (sGyroDrv->SelfTest(sign) != HAL_OK) {
+        return FCB_ERR;
+    }
+    vTaskDelay(SENSOR_SELF_TEST_SETTLE_TIME / portTICK_RATE_MS);
+
+    memset(mean, 0, 3 * sizeof(float32_t));
+    for (i = 0; i < SENSOR_SELF_TEST_SAMPLES; i++) {
+        vTaskDelay(samplePeriod);
+        if (sGyroDrv->GetXYZ(sample) != HAL_OK) {
+            return FCB_ERR;
+        }
+        for (axis = 0; axis < 3; axis++) {
+            mean[axis] += sample[axis] / (float32_t) SENSOR_SELF_TEST_SAMPLES;
+        }
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * Reads the gyroscope temperature and updates the bias of the temperature
+ * compensation. A failed read keeps the previous temperature.
+ */
+static void ReadGyroTemperature(void) {
+#ifdef FCB_REDUNDANT_GYRO
+    /* the table is of gyroscope 0, the voting keeps its bias */
+    GYRO_DrvTypeDef * const driver = sGyroVoteEntries[0]->driver;
+#else
+    GYRO_DrvTypeDef * const driver = sGyroDrv;
+#endif
+    int8_t temperature;
+
+    if (driver->ReadTemperature(&temperature) == HAL_OK) {
+        sGyroTemperature = temperature;
+        UpdateGyroTempBias();
+    }
+    sGyroSamplesSinceTemperatureRead = 0;
+}
+
+/*
+ * Interpolates the bias at the current temperature between the centres of the
+ * nearest measured bins below and above it. Outside of the measured ones the
+ * bias of the nearest bin is used, and with none measured the bias is zero.
+ * Called from the SENSORS task or with the scheduler locked.
+ */
+static void UpdateGyroTempBias(void) {
+    int16_t lowerBin = -1, upperBin = -1;
+    int16_t bin;
+    float32_t binCentre, weight;
+    float32_t rotation[3][3];
+    uint8_t i;
+
+    GetSensorOrientationMatrix(rotation);
+
+    for (bin = 0; bin < GYRO_TEMP_COMP_BINS && sGyroTempCompensation.isEnabled; bin++) {
+        if (!(sGyroTempCompensation.validBins & (1 << bin))) {
+            continue;
+        }
+        binCentre = GYRO_TEMP_COMP_MIN_TEMP + (bin + 0.5f) * GYRO_TEMP_COMP_BIN_WIDTH;
+        if (binCentre <= sGyroTemperature) {
+            lowerBin = bin;
+        } else if (upperBin < 0) {
+            upperBin = bin;
+        }
+    }
+
+    if (lowerBin < 0 && upperBin < 0) {
+        sGyroTempBias[XDOT_IDX] = sGyroTempBias[YDOT_IDX] = sGyroTempBias[ZDOT_IDX] = 0.0;
+        RotateGyroTempBias(rotation);
+        return;
+    }
+    if (lowerBin < 0) {
+        lowerBin = upperBin;
+    } else if (upperBin < 0) {
+        upperBin = lowerBin;
+    }
+
+    weight = 0.0;
+    if (upperBin != lowerBin) {
+        weight = (sGyroTemperature - (GYRO_TEMP_COMP_MIN_TEMP + (lowerBin + 0.5f) * GYRO_TEMP_COMP_BIN_WIDTH))
+                / ((upperBin - lowerBin) * GYRO_TEMP_COMP_BIN_WIDTH);
+    }
+    for (i = 0; i < 3; i++) {
+        sGyroTempBias[i] = sGyroTempCompensation.bias[lowerBin][i]
+                + weight * (sGyroTempCompensation.bias[upperBin][i] - sGyroTempCompensation.bias[lowerBin][i]);
+    }
+    RotateGyroTempBias(rotation);
+}
+
+/*
+ * Turns the bias of the temperature compensation from the board axes to the
+ * quadcopter axes, in which it is subtracted from the samples.
+ */
+static void RotateGyroTempBias(const float32_t rotation[3][3]) {
+    uint8_t i;
+
+    for (i = 0; i < 3; i++) {
+        sGyroRotatedTempBias[i] = rotation[i][XDOT_IDX] * sGyroTempBias[XDOT_IDX]
+                + rotation[i][YDOT_IDX] * sGyroTempBias[YDOT_IDX] + rotation[i][ZDOT_IDX] * sGyroTempBias[ZDOT_IDX];
+    }
+}
+
+/*
+ * Saves a copy of the temperature compensation table to flash
+ */
+static FcbRetValType SaveGyroTempCompensation(void) {
+    FcbGyroTempCompensationType compensation;
+
+    GetGyroTempCompensation(&compensation);
+    if (FLASH_OK != WriteGyroTempCompensationToFlash(&compensation)) {
+        return FCB_ERR;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * Processes a gyroscope sample (rad/s, sensor axes), stores it and passes it
+ * on to the registered client.
+ */
+static void UpdateGyroscopeData(const float * gyroscopeData, uint32_t timestamp) {
+    /* paranoia - this is used for calculations to reduce the time
+     * readers may have to retry
+     */
+    float lGyroXYZAngleDot[3] = { 0.0f, 0.0f, 0.0f };
+#ifdef FCB_REDUNDANT_GYRO
+    float32_t votedData[3];
+#endif
+
+    SCOPE_PROBE_MARK(SCOPE_PROBE_STAGE_FETCH);
+
+#ifdef FCB_SENSOR_LOAD_TEST
+    if (!SensorLoadTestIsActive()) {
+        memcpy(sLoadTestGyroData, gyroscopeData, sizeof(sLoadTestGyroData));
+    }
+#endif
+
+#ifdef FCB_REDUNDANT_GYRO
+    /* not during the load test, whose held sample would be found stuck */
+    if (!SENSOR_LOAD_TEST_IS_ACTIVE()) {
+        VoteGyroscopeData(gyroscopeData, timestamp, votedData);
+        gyroscopeData = votedData;
+    }
+#endif
+
+#ifdef FCB_CONTROL_EXECUTIVE
+    /* A polled read, the filter state is shared with the executive */
+    ControlExecutiveSuspend();
+    ProcessGyroscopeSample(gyroscopeData, lGyroXYZAngleDot);
+    ControlExecutiveResume();
+#else
+    ProcessGyroscopeSample(gyroscopeData, lGyroXYZAngleDot);
+#endif
+
+    PublishGyroscopeData(lGyroXYZAngleDot, timestamp);
+}
+
+/*
+ * Stores a processed gyroscope sample and passes it on to the registered
+ * client.
+ */
+static void PublishGyroscopeData(const float32_t * lGyroXYZAngleDot, uint32_t timestamp) {
+    uint32_t copy;
+
+    SensorWatchdogFeed(GYRO_IDX);
+
+    copy = SeqLockWriteBegin(&seqLockGyro);
+    sGyroXYZAngleDot[copy][XDOT_IDX] = lGyroXYZAngleDot[XDOT_IDX];
+    sGyroXYZAngleDot[copy][YDOT_IDX] = lGyroXYZAngleDot[YDOT_IDX];
+    sGyroXYZAngleDot[copy][ZDOT_IDX] = lGyroXYZAngleDot[ZDOT_IDX];
+    sGyroSampleTimestamp[copy] = timestamp;
+    SeqLockWriteEnd(&seqLockGyro);
+
+    SensorBusPublish(GYRO_IDX, lGyroXYZAngleDot, timestamp);
+    AggregateSamples(AGGREGATE_GYRO_X, lGyroXYZAngleDot, 3);
+
+    if (SendCorrectionUpdateCallback != NULL) {
+        SendCorrectionUpdateCallback(GYRO_IDX, sGyroXYZAngleDot[copy], timestamp);
+    }
+
+    if (++sGyroSamplesSinceTemperatureRead >= (uint32_t) GYRO_TEMP_READ_PERIOD * GyroDataRateHz() / 1000) {
+        ReadGyroTemperature();
+    }
 }
 
 /**
@@ -0,0 +1,153 @@
+/******************************************************************************
+ * @file    fcb_rpm_filter.c
+ * @author  Dragonfly
+ * @brief   Implementation of interface publicised in fcb_rpm_filter.h
+ ******************************************************************************/
+
+#include "fcb_rpm_filter.h"
+
+#ifdef FCB_RPM_FILTER
+
+#include "fcb_sensor_filter.h"
+#include "fcb_gyroscope.h"
+#include "fixed_format.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+
+/* Private define ------------------------------------------------------------*/
+enum {
+    RPM_FILTER_AXES_N = 3
+};
+
+/* Private typedef -----------------------------------------------------------*/
+
+/**
+ * Notch of one motor harmonic, transposed direct form II state as in the
+ * sensor filter
+ */
+typedef struct RpmNotch {
+    bool isActive;
+    float32_t centerHz;
+    float32_t coeffs[SENSOR_FILTER_COEFFS_PER_STAGE];
+    float32_t s1[RPM_FILTER_AXES_N];
+    float32_t s2[RPM_FILTER_AXES_N];
+} RpmNotchType;
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Used by the context that processes the gyroscope samples only */
+static RpmNotchType rpmNotches[MOTOR_OUTPUT_CHANNELS][RPM_FILTER_HARMONICS];
+static float32_t rpmFilterSampleRateHz = 0.0f;
+static uint32_t telemetrySequence = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+static void updateNotches(const MotorTelemetryType * telemetry);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Clears the notches and takes the gyroscope data rate
+ * @param  None
+ * @retval None
+ */
+void RpmFilterInit(void) {
+    memset(rpmNotches, 0, sizeof(rpmNotches));
+    rpmFilterSampleRateHz = (float32_t) GyroDataRateHz();
+    telemetrySequence = 0;
+}
+
+/*
+ * @brief  Runs the active motor notches on all axes of one gyroscope sample
+ * @param  xyz : Sample, filtered in place
+ * @retval None
+ */
+RAMFUNC void RpmFilterApply(float32_t * xyz) {
+    MotorTelemetryType telemetry;
+    uint8_t motor, harmonic, axis;
+
+    if (GetMotorTelemetry(&telemetry, telemetrySequence)) {
+        telemetrySequence = telemetry.sequence;
+        updateNotches(&telemetry);
+    }
+
+    for (motor = 0; motor < MOTOR_OUTPUT_CHANNELS; motor++) {
+        for (harmonic = 0; harmonic < RPM_FILTER_HARMONICS; harmonic++) {
+            RpmNotchType * notch = &rpmNotches[motor][harmonic];
+            float32_t b0 = notch->coeffs[0], b1 = notch->coeffs[1], b2 = notch->coeffs[2];
+            float32_t a1 = notch->coeffs[3], a2 = notch->coeffs[4];
+
+            if (!notch->isActive) {
+                continue;
+            }
+
+            for (axis = 0; axis < RPM_FILTER_AXES_N; axis++) {
+                float32_t x = xyz[axis];
+                float32_t y = b0 * x + notch->s1[axis];
+
+                notch->s1[axis] = b1 * x + a1 * y + notch->s2[axis];
+                notch->s2[axis] = b2 * x + a2 * y;
+                xyz[axis] = y;
+            }
+        }
+    }
+}
+
+size_t PrintRpmFilter(char * dst, const size_t dstSize) {
+    char frequencyString[16];
+    size_t length;
+    uint8_t motor, harmonic;
+
+    length = (size_t) snprintf(dst, dstSize, "\nRPM filter, notch centers of the harmonics [Hz]\n");
+    for (motor = 0; motor < MOTOR_OUTPUT_CHANNELS && length < dstSize; motor++) {
+        length += (size_t) snprintf(dst + length, dstSize - length, "M%u:", (unsigned int) (motor + 1));
+        for (harmonic = 0; harmonic < RPM_FILTER_HARMONICS && length < dstSize; harmonic++) {
+            if (rpmNotches[motor][harmonic].isActive) {
+                FormatFixed(frequencyString, sizeof(frequencyString), rpmNotches[motor][harmonic].centerHz, 1);
+            } else {
+                strncpy(frequencyString, "off", sizeof(frequencyString));
+            }
+            length += (size_t) snprintf(dst + length, dstSize - length, " %s", frequencyString);
+        }
+        if (length < dstSize) {
+            length += (size_t) snprintf(dst + length, dstSize - length, "\n");
+        }
+    }
+
+    return length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Recomputes the notches for the latest motor rotation rates, a notch that is
+ * switched on starts from a cleared state
+ */
+static void updateNotches(const MotorTelemetryType * telemetry) {
+    float32_t const maxHz = RPM_FILTER_MAX_NYQUIST_FRACTION * rpmFilterSampleRateHz / 2.0f;
+    uint8_t motor, harmonic;
+
+    for (motor = 0; motor < MOTOR_OUTPUT_CHANNELS; motor++) {
+        for (harmonic = 0; harmonic < RPM_FILTER_HARMONICS; harmonic++) {
+            RpmNotchType * notch = &rpmNotches[motor][harmonic];
+            float32_t centerHz = telemetry->rotationHz[motor] * (float32_t) (harmonic + 1);
+
+            if (!telemetry->isValid[motor] || centerHz < RPM_FILTER_MIN_HZ || centerHz > maxHz) {
+                notch->isActive = false;
+                continue;
+            }
+
+            if (!notch->isActive) {
+                memset(notch->s1, 0, sizeof(notch->s1));
+                memset(notch->s2, 0, sizeof(notch->s2));
+            }
+            SensorFilterNotchCoeffs(centerHz, RPM_FILTER_Q, rpmFilterSampleRateHz, notch->coeffs);
+            notch->centerHz = centerHz;
+            notch->isActive = true;
+        }
+    }
+}
+
+#endif /* FCB_RPM_FILTER */
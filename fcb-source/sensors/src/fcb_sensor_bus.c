@@ -0,0 +1,182 @@
+/******************************************************************************
+ * @file    fcb_sensor_bus.c
+ * @author  Dragonfly
+ * @brief   Implementation of interface publicised in fcb_sensor_bus.h
+ ******************************************************************************/
+
+#include "fcb_sensor_bus.h"
+#include "fcb_error.h"
+#include "ccm_ram.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Private define ------------------------------------------------------------*/
+#define SENSOR_BUS_RING_MASK    (SENSOR_BUS_RING_SIZE - 1)
+
+/* Private typedef -----------------------------------------------------------*/
+
+/**
+ * Sample ring of one sensor. head is the sequence number the next sample
+ * gets and is only written by the publisher, each cursor is only written by
+ * its subscriber.
+ */
+typedef struct FcbSensorBusRing {
+    FcbSensorSampleType slots[SENSOR_BUS_RING_SIZE];
+    volatile uint32_t head;
+    uint8_t nbrOfSubscribers;
+    uint32_t cursors[SENSOR_BUS_MAX_SUBSCRIBERS];
+    uint32_t overruns[SENSOR_BUS_MAX_SUBSCRIBERS];
+} FcbSensorBusRingType;
+
+/* Private variables ---------------------------------------------------------*/
+/* Written on every sample, in the CCM SRAM with FCB_CCM_RAM */
+static FcbSensorBusRingType sensorBusRings[FCB_SENSOR_NBR] CCM_RAM;
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Adds a subscriber to the samples of a sensor
+ * @param  sensor : Sensor index
+ * @param  subscriber : Set to the subscriber id
+ * @retval FCB_OK if subscribed, else FCB_ERR
+ */
+FcbRetValType SensorBusSubscribe(FcbSensorIndexType sensor, uint8_t * subscriber) {
+    FcbSensorBusRingType * pRing;
+    FcbRetValType retVal = FCB_OK;
+
+    if (sensor >= FCB_SENSOR_NBR) {
+        return FCB_ERR;
+    }
+
+    pRing = &sensorBusRings[sensor];
+
+    taskENTER_CRITICAL();
+    if (pRing->nbrOfSubscribers < SENSOR_BUS_MAX_SUBSCRIBERS) {
+        *subscriber = pRing->nbrOfSubscribers;
+        pRing->cursors[*subscriber] = pRing->head;
+        pRing->overruns[*subscriber] = 0;
+        pRing->nbrOfSubscribers++;
+    } else {
+        retVal = FCB_ERR;
+    }
+    taskEXIT_CRITICAL();
+
+    return retVal;
+}
+
+/*
+ * @brief  Writes a sample to the ring of a sensor
+ * @param  sensor : Sensor index
+ * @param  xyz : Sample values, only xyz[0] is used for the barometer
+ * @param  timestamp : Sample time [core clock cycles]
+ * @retval None
+ */
+void SensorBusPublish(FcbSensorIndexType sensor, const float32_t * xyz, uint32_t timestamp) {
+    FcbSensorBusRingType * pRing;
+    FcbSensorSampleType * pSlot;
+    uint32_t sequence;
+
+    if (sensor >= FCB_SENSOR_NBR) {
+        return;
+    }
+
+    pRing = &sensorBusRings[sensor];
+    sequence = pRing->head;
+    pSlot = &pRing->slots[sequence & SENSOR_BUS_RING_MASK];
+
+    pSlot->xyz[X_IDX] = xyz[X_IDX];
+    if (BARO_IDX == sensor) {
+        pSlot->xyz[Y_IDX] = 0.0f;
+        pSlot->xyz[Z_IDX] = 0.0f;
+    } else {
+        pSlot->xyz[Y_IDX] = xyz[Y_IDX];
+        pSlot->xyz[Z_IDX] = xyz[Z_IDX];
+    }
+    pSlot->timestamp = timestamp;
+    pSlot->sequence = sequence;
+
+    /* the slot must be complete before readers can see it */
+    __DMB();
+    pRing->head = sequence + 1;
+}
+
+/*
+ * @brief  Gets the oldest unread sample of a subscriber
+ * @param  sensor : Sensor index
+ * @param  subscriber : Subscriber id
+ * @param  sequence : Set to the sequence number of the sample
+ * @retval Sample slot, NULL if none unread
+ */
+const FcbSensorSampleType * SensorBusRead(FcbSensorIndexType sensor, uint8_t subscriber, uint32_t * sequence) {
+    FcbSensorBusRingType * pRing;
+    uint32_t head;
+    uint32_t cursor;
+
+    if (sensor >= FCB_SENSOR_NBR || subscriber >= sensorBusRings[sensor].nbrOfSubscribers) {
+        return NULL;
+    }
+
+    pRing = &sensorBusRings[sensor];
+    head = pRing->head;
+    __DMB();
+    cursor = pRing->cursors[subscriber];
+
+    if (cursor == head) {
+        return NULL;
+    }
+
+    /* lapped, skip to the oldest sample that isn't being overwritten next */
+    if (head - cursor >= SENSOR_BUS_RING_SIZE) {
+        pRing->overruns[subscriber] += head - cursor - (SENSOR_BUS_RING_SIZE - 1);
+        cursor = head - (SENSOR_BUS_RING_SIZE - 1);
+    }
+
+    pRing->cursors[subscriber] = cursor + 1;
+    *sequence = cursor;
+
+    return &pRing->slots[cursor & SENSOR_BUS_RING_MASK];
+}
+
+/*
+ * @brief  Checks that the slot of a sample hasn't been reused
+ * @param  sensor : Sensor index
+ * @param  sequence : Sequence number of the sample
+ * @retval true if still valid
+ */
+bool SensorBusSampleStillValid(FcbSensorIndexType sensor, uint32_t sequence) {
+    if (sensor >= FCB_SENSOR_NBR) {
+        return false;
+    }
+
+    /* the publisher starts reusing the slot once head reaches sequence + RING_SIZE */
+    __DMB();
+    return (sensorBusRings[sensor].head - sequence) < SENSOR_BUS_RING_SIZE;
+}
+
+/*
+ * @brief  Gets the number of samples lost by a subscriber
+ * @param  sensor : Sensor index
+ * @param  subscriber : Subscriber id
+ * @retval Number of lost samples
+ */
+uint32_t SensorBusGetOverruns(FcbSensorIndexType sensor, uint8_t subscriber) {
+    if (sensor >= FCB_SENSOR_NBR || subscriber >= sensorBusRings[sensor].nbrOfSubscribers) {
+        return 0;
+    }
+
+    return sensorBusRings[sensor].overruns[subscriber];
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,423 @@
+/******************************************************************************
+ * @file    fcb_sensor_filter.c
+ * @author  Dragonfly
+ * @brief   Implementation of interface publicised in fcb_sensor_filter.h
+ ******************************************************************************/
+
+#include "fcb_sensor_filter.h"
+#include "fcb_error.h"
+#include "flash.h"
+#include "fcb_gyroscope.h"
+#include "lsm303dlhc.h"
+#include "control_executive.h"
+#include "deferred_log.h"
+#include "ccm_ram.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+/* Private define ------------------------------------------------------------*/
+#define SENSOR_FILTER_LOW_PASS_Q    0.7071f /* Butterworth */
+
+enum {
+    SENSOR_FILTER_AXES_N = 3
+};
+
+/* Private typedef -----------------------------------------------------------*/
+
+/**
+ * Transposed direct form II state, two words per stage and axis
+ */
+typedef struct FcbSensorFilterState {
+    float32_t s1[SENSOR_FILTER_MAX_STAGES][SENSOR_FILTER_AXES_N];
+    float32_t s2[SENSOR_FILTER_MAX_STAGES][SENSOR_FILTER_AXES_N];
+} FcbSensorFilterStateType;
+
+/* Private variables ---------------------------------------------------------*/
+static FcbSensorFilterSettingsType sensorFilterSettings; /* only nbrOfStages 0 until SensorFilterInit */
+static FcbSensorFilterStateType sensorFilterStates[FCB_SENSOR_NBR] CCM_RAM;
+/* frequencies of the filters configured or switched since startup, the stored coefficients do not keep them */
+static FcbSensorFilterConfigType sensorFilterConfigs[FCB_SENSOR_NBR];
+static bool isSensorFilterConfigured[FCB_SENSOR_NBR];
+/* of the coefficients in use, see SensorFilterGroupDelay */
+static volatile float32_t sensorFilterGroupDelays[FCB_SENSOR_NBR];
+
+/* Private function prototypes -----------------------------------------------*/
+static float32_t sensorDataRateHz(FcbSensorIndexType sensor);
+static FcbRetValType computeCoeffs(FcbSensorIndexType sensor, const FcbSensorFilterConfigType * config,
+        FcbSensorFilterCoeffsType * pCoeffs);
+static void useCoeffs(FcbSensorIndexType sensor, const FcbSensorFilterConfigType * config,
+        const FcbSensorFilterCoeffsType * pCoeffs, bool isStateCleared);
+static float32_t groupDelay(const FcbSensorFilterCoeffsType * pCoeffs);
+static void disableFilter(FcbSensorIndexType sensor);
+static void lowPassCoeffs(float32_t cutoffHz, float32_t sampleRateHz, float32_t * pCoeffs);
+static void storeCoeffs(float32_t b0, float32_t b1, float32_t b2, float32_t a0, float32_t a1, float32_t a2,
+        float32_t * pCoeffs);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Loads the sensor filter coefficients from flash
+ * @param  None
+ * @retval None
+ */
+void SensorFilterInit(void) {
+    FcbSensorFilterSettingsType settings;
+    uint8_t sensor;
+
+    CcmRamRegisterObject("sensorFilterStates", sensorFilterStates, sizeof(sensorFilterStates));
+    memset(sensorFilterStates, 0, sizeof(sensorFilterStates));
+    memset(&sensorFilterSettings, 0, sizeof(sensorFilterSettings));
+    for (sensor = 0; sensor < FCB_SENSOR_NBR; sensor++) {
+        sensorFilterGroupDelays[sensor] = 0.0f;
+    }
+
+    if (FLASH_OK != ReadSensorFilterSettingsFromFlash(&settings)) {
+        return;
+    }
+
+    for (sensor = 0; sensor < FCB_SENSOR_NBR; sensor++) {
+        FcbSensorFilterCoeffsType * pCoeffs = &settings.sensor[sensor];
+
+        /* coefficients are only valid for the data rate they were computed for */
+        if (pCoeffs->nbrOfStages <= SENSOR_FILTER_MAX_STAGES
+                && pCoeffs->sampleRateHz > 0.0f
+                && pCoeffs->sampleRateHz == sensorDataRateHz((FcbSensorIndexType) sensor)) {
+            sensorFilterSettings.sensor[sensor] = *pCoeffs;
+            sensorFilterGroupDelays[sensor] = groupDelay(pCoeffs);
+        }
+    }
+}
+
+/*
+ * @brief  Configures and stores the filter of a sensor
+ * @param  sensor : Sensor index, GYRO_IDX or ACC_IDX
+ * @param  config : Filter frequencies
+ * @retval FCB_OK if configured, else FCB_ERR
+ */
+FcbRetValType SensorFilterConfig(FcbSensorIndexType sensor, const FcbSensorFilterConfigType * config) {
+    FcbSensorFilterCoeffsType coeffs;
+
+    if (FCB_OK != computeCoeffs(sensor, config, &coeffs)) {
+        return FCB_ERR;
+    }
+
+    useCoeffs(sensor, config, &coeffs, true);
+
+    if (FLASH_OK != WriteSensorFilterSettingsToFlash(&sensorFilterSettings)) {
+        return FCB_ERR;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Switches the filter of a sensor without storing it, keeping the filter state
+ * @param  sensor : Sensor index, GYRO_IDX or ACC_IDX
+ * @param  config : Filter frequencies
+ * @retval FCB_OK if switched, else FCB_ERR
+ */
+FcbRetValType SensorFilterSwitch(FcbSensorIndexType sensor, const FcbSensorFilterConfigType * config) {
+    FcbSensorFilterCoeffsType coeffs;
+
+    if (FCB_OK != computeCoeffs(sensor, config, &coeffs)) {
+        return FCB_ERR;
+    }
+
+    useCoeffs(sensor, config, &coeffs, false);
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Gets the filter configuration of a sensor
+ * @param  sensor : Sensor index, GYRO_IDX or ACC_IDX
+ * @param  config : Destination of the filter frequencies
+ * @retval FCB_OK if read, FCB_ERR if the filter has not been configured or switched since startup
+ */
+FcbRetValType SensorFilterGetConfig(FcbSensorIndexType sensor, FcbSensorFilterConfigType * config) {
+    FcbRetValType status = FCB_ERR;
+
+    if (sensor >= FCB_SENSOR_NBR || NULL == config) {
+        return FCB_ERR;
+    }
+
+    taskENTER_CRITICAL();
+    if (isSensorFilterConfigured[sensor]) {
+        *config = sensorFilterConfigs[sensor];
+        status = FCB_OK;
+    }
+    taskEXIT_CRITICAL();
+
+    return status;
+}
+
+/*
+ * @brief  Recomputes the filters configured since startup for the new sensor data rates and stores them. A filter
+ *         whose frequencies are not known, or are above the new Nyquist frequency, is disabled instead, since its
+ *         coefficients would move its frequencies.
+ * @param  None
+ * @retval None
+ */
+void SensorFilterDataRateChanged(void) {
+    FcbSensorFilterCoeffsType coeffs;
+    FcbSensorFilterConfigType config;
+    bool isChanged = false;
+    uint8_t sensor;
+
+    for (sensor = 0; sensor < FCB_SENSOR_NBR; sensor++) {
+        if (0 == sensorFilterSettings.sensor[sensor].nbrOfStages
+                || sensorFilterSettings.sensor[sensor].sampleRateHz == sensorDataRateHz((FcbSensorIndexType) sensor)) {
+            continue;
+        }
+
+        if (FCB_OK == SensorFilterGetConfig((FcbSensorIndexType) sensor, &config)
+                && FCB_OK == computeCoeffs((FcbSensorIndexType) sensor, &config, &coeffs)) {
+            useCoeffs((FcbSensorIndexType) sensor, &config, &coeffs, true);
+        } else {
+            disableFilter((FcbSensorIndexType) sensor);
+            LOG1("WARNING: sensor %u filter disabled, reconfigure it for the new data rate", sensor);
+        }
+        isChanged = true;
+    }
+
+    if (isChanged && FLASH_OK != WriteSensorFilterSettingsToFlash(&sensorFilterSettings)) {
+        LOG0("WARNING: sensor filters not stored");
+    }
+}
+
+/*
+ * @brief  Gets the group delay of the filter of a sensor at low frequencies
+ * @param  sensor : Sensor index
+ * @retval Group delay [s], 0 if not filtered
+ */
+float32_t SensorFilterGroupDelay(FcbSensorIndexType sensor) {
+    if (sensor >= FCB_SENSOR_NBR) {
+        return 0.0f;
+    }
+
+    return sensorFilterGroupDelays[sensor];
+}
+
+/*
+ * @brief  Runs the filter cascade of a sensor on all axes of one sample
+ * @param  sensor : Sensor index
+ * @param  xyz : Sample, filtered in place
+ * @retval None
+ */
+void SensorFilterApply(FcbSensorIndexType sensor, float32_t * xyz) {
+    const FcbSensorFilterCoeffsType * pCoeffs;
+    FcbSensorFilterStateType * pState;
+    uint32_t stage;
+    uint8_t axis;
+
+    if (sensor >= FCB_SENSOR_NBR) {
+        return;
+    }
+
+    pCoeffs = &sensorFilterSettings.sensor[sensor];
+    pState = &sensorFilterStates[sensor];
+
+    for (stage = 0; stage < pCoeffs->nbrOfStages; stage++) {
+        const float32_t * c = &pCoeffs->coeffs[stage * SENSOR_FILTER_COEFFS_PER_STAGE];
+        float32_t b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+
+        /* the axes are independent, which lets the FPU pipeline overlap them */
+        for (axis = 0; axis < SENSOR_FILTER_AXES_N; axis++) {
+            float32_t x = xyz[axis];
+            float32_t y = b0 * x + pState->s1[stage][axis];
+
+            pState->s1[stage][axis] = b1 * x + a1 * y + pState->s2[stage][axis];
+            pState->s2[stage][axis] = b2 * x + a2 * y;
+            xyz[axis] = y;
+        }
+    }
+}
+
+/*
+ * @brief  Computes a notch, see the "Audio EQ Cookbook" by R. Bristow-Johnson
+ * @param  centerHz : Center frequency
+ * @param  q : Quality factor
+ * @param  sampleRateHz : Sensor data rate
+ * @param  pCoeffs : Destination, one stage
+ * @retval None
+ */
+void SensorFilterNotchCoeffs(float32_t centerHz, float32_t q, float32_t sampleRateHz, float32_t * pCoeffs) {
+    float32_t w0 = 2.0f * PI * centerHz / sampleRateHz;
+    float32_t cosW0 = cosf(w0);
+    float32_t alpha = sinf(w0) / (2.0f * q);
+
+    storeCoeffs(1.0f, -2.0f * cosW0, 1.0f, 1.0f + alpha, -2.0f * cosW0, 1.0f - alpha, pCoeffs);
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+static float32_t sensorDataRateHz(FcbSensorIndexType sensor) {
+    switch (sensor) {
+    case GYRO_IDX:
+        return (float32_t) GyroDataRateHz();
+    case ACC_IDX:
+        return (float32_t) LSM303DLHC_AccDataRateHz();
+    default:
+        return 0.0f;
+    }
+}
+
+/*
+ * @brief  Computes the coefficients of a sensor filter at the current sensor data rate
+ * @param  sensor : Sensor index, GYRO_IDX or ACC_IDX
+ * @param  config : Filter frequencies
+ * @param  pCoeffs : Destination
+ * @retval FCB_OK if computed, FCB_ERR if the sensor or a frequency is not valid
+ */
+static FcbRetValType computeCoeffs(FcbSensorIndexType sensor, const FcbSensorFilterConfigType * config,
+        FcbSensorFilterCoeffsType * pCoeffs) {
+    float32_t nyquistHz;
+    uint8_t i;
+
+    if ((GYRO_IDX != sensor && ACC_IDX != sensor) || NULL == config) {
+        return FCB_ERR;
+    }
+
+    memset(pCoeffs, 0, sizeof(*pCoeffs));
+    pCoeffs->sampleRateHz = sensorDataRateHz(sensor);
+    nyquistHz = pCoeffs->sampleRateHz / 2.0f;
+
+    if (config->lowPassCutoffHz > 0.0f) {
+        if (config->lowPassCutoffHz >= nyquistHz) {
+            return FCB_ERR;
+        }
+        lowPassCoeffs(config->lowPassCutoffHz, pCoeffs->sampleRateHz,
+                &pCoeffs->coeffs[pCoeffs->nbrOfStages * SENSOR_FILTER_COEFFS_PER_STAGE]);
+        pCoeffs->nbrOfStages++;
+    }
+
+    for (i = 0; i < SENSOR_FILTER_MAX_NOTCHES; i++) {
+        if (config->notchCenterHz[i] > 0.0f) {
+            if (config->notchCenterHz[i] >= nyquistHz || config->notchQ[i] <= 0.0f) {
+                return FCB_ERR;
+            }
+            SensorFilterNotchCoeffs(config->notchCenterHz[i], config->notchQ[i], pCoeffs->sampleRateHz,
+                    &pCoeffs->coeffs[pCoeffs->nbrOfStages * SENSOR_FILTER_COEFFS_PER_STAGE]);
+            pCoeffs->nbrOfStages++;
+        }
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Starts using the coefficients of a sensor filter
+ * @param  sensor : Sensor index
+ * @param  config : Filter frequencies of the coefficients
+ * @param  pCoeffs : Coefficients
+ * @param  isStateCleared : true to restart the filter from zero, false to keep the state so that the filtered signal
+ *         stays continuous in flight
+ * @retval None
+ */
+static void useCoeffs(FcbSensorIndexType sensor, const FcbSensorFilterConfigType * config,
+        const FcbSensorFilterCoeffsType * pCoeffs, bool isStateCleared) {
+    /* swap coefficients and clear the state if asked atomically w.r.t. the SENSORS task, and the control executive
+     * which runs above the critical section */
+#ifdef FCB_CONTROL_EXECUTIVE
+    ControlExecutiveSuspend();
+#endif
+    taskENTER_CRITICAL();
+    sensorFilterSettings.sensor[sensor] = *pCoeffs;
+    if (isStateCleared) {
+        memset(&sensorFilterStates[sensor], 0, sizeof(sensorFilterStates[sensor]));
+    }
+    sensorFilterConfigs[sensor] = *config;
+    isSensorFilterConfigured[sensor] = true;
+    sensorFilterGroupDelays[sensor] = groupDelay(pCoeffs);
+    taskEXIT_CRITICAL();
+#ifdef FCB_CONTROL_EXECUTIVE
+    ControlExecutiveResume();
+#endif
+}
+
+/*
+ * @brief  Computes the group delay of a filter cascade at low frequencies. Per biquad it is
+ *         sum(k*b_k)/sum(b_k) - sum(k*a_k)/sum(a_k) samples, with a_0 = 1.
+ * @param  pCoeffs : Coefficients
+ * @retval Group delay [s], 0 if not filtered
+ */
+static float32_t groupDelay(const FcbSensorFilterCoeffsType * pCoeffs) {
+    float32_t delaySamples = 0.0f;
+    uint32_t stage;
+
+    if (pCoeffs->sampleRateHz <= 0.0f) {
+        return 0.0f;
+    }
+
+    for (stage = 0; stage < pCoeffs->nbrOfStages; stage++) {
+        const float32_t * c = &pCoeffs->coeffs[stage * SENSOR_FILTER_COEFFS_PER_STAGE];
+        float32_t bSum = c[0] + c[1] + c[2];
+        float32_t aSum = 1.0f - c[3] - c[4]; /* a1 & a2 are stored negated */
+
+        /* a stage that blocks DC has no group delay there */
+        if (fabsf(bSum) > 1e-6f && fabsf(aSum) > 1e-6f) {
+            delaySamples += (c[1] + 2.0f * c[2]) / bSum - (-c[3] - 2.0f * c[4]) / aSum;
+        }
+    }
+
+    return delaySamples / pCoeffs->sampleRateHz;
+}
+
+/*
+ * @brief  Stops filtering a sensor and clears its state
+ * @param  sensor : Sensor index
+ * @retval None
+ */
+static void disableFilter(FcbSensorIndexType sensor) {
+#ifdef FCB_CONTROL_EXECUTIVE
+    ControlExecutiveSuspend();
+#endif
+    taskENTER_CRITICAL();
+    memset(&sensorFilterSettings.sensor[sensor], 0, sizeof(sensorFilterSettings.sensor[sensor]));
+    memset(&sensorFilterStates[sensor], 0, sizeof(sensorFilterStates[sensor]));
+    isSensorFilterConfigured[sensor] = false;
+    sensorFilterGroupDelays[sensor] = 0.0f;
+    taskEXIT_CRITICAL();
+#ifdef FCB_CONTROL_EXECUTIVE
+    ControlExecutiveResume();
+#endif
+}
+
+/*
+ * 2nd order low-pass, see the "Audio EQ Cookbook" by R. Bristow-Johnson
+ */
+static void lowPassCoeffs(float32_t cutoffHz, float32_t sampleRateHz, float32_t * pCoeffs) {
+    float32_t w0 = 2.0f * PI * cutoffHz / sampleRateHz;
+    float32_t cosW0 = cosf(w0);
+    float32_t alpha = sinf(w0) / (2.0f * SENSOR_FILTER_LOW_PASS_Q);
+
+    storeCoeffs((1.0f - cosW0) / 2.0f, 1.0f - cosW0, (1.0f - cosW0) / 2.0f,
+            1.0f + alpha, -2.0f * cosW0, 1.0f - alpha, pCoeffs);
+}
+
+/*
+ * Normalises by a0 and stores in CMSIS-DSP biquad layout (a1 & a2 negated)
+ */
+static void storeCoeffs(float32_t b0, float32_t b1, float32_t b2, float32_t a0, float32_t a1, float32_t a2,
+        float32_t * pCoeffs) {
+    pCoeffs[0] = b0 / a0;
+    pCoeffs[1] = b1 / a0;
+    pCoeffs[2] = b2 / a0;
+    pCoeffs[3] = -a1 / a0;
+    pCoeffs[4] = -a2 / a0;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
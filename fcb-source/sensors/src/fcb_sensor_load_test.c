@@ -0,0 +1,329 @@
+/******************************************************************************
+ * @file    fcb_sensor_load_test.c
+ * @author  Dragonfly
+ * @brief   Implementation of interface publicised in fcb_sensor_load_test.h
+ ******************************************************************************/
+
+#include "fcb_sensor_load_test.h"
+
+#ifdef FCB_SENSOR_LOAD_TEST
+
+#include "fcb_gyroscope.h"
+#include "fcb_accelerometer_magnetometer.h"
+#include "flight_control.h"
+#include "cpu_headroom.h"
+#include "common.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+
+/* Private define ------------------------------------------------------------*/
+#define CYCLES_PER_US           (SystemCoreClock / 1000000)
+#define TICKS_PER_MS            (SENSOR_LOAD_TEST_TICK_RATE / 1000)
+
+/* Private variables ---------------------------------------------------------*/
+TIM_HandleTypeDef SensorLoadTestTimHandle;
+
+/* Data ready EXTI line of each sensor, the line number is the pin number */
+static const uint32_t sensorExtiLines[SENSOR_LOAD_TEST_SENSORS] = {
+    GPIO_GYRO_DRDY, GPIO_ACCELEROMETER_DRDY, GPIO_MAGNETOMETER_DRDY
+};
+
+/* Read requests that clear the data ready line of each sensor once the test ends */
+static const uint8_t sensorReadEvents[SENSOR_LOAD_TEST_SENSORS] = {
+    FCB_SENSOR_GYRO_DATA_READY, FCB_SENSOR_ACC_DATA_READY, FCB_SENSOR_MAGNETO_DATA_READY
+};
+
+static const char * sensorNames[SENSOR_LOAD_TEST_SENSORS] = { "Gyro", "Acc", "Mag" };
+
+static bool isTimerInitialised = false;
+static volatile bool isLoadTestActive = false;
+
+/* Written by the timer ISR and, with the interrupts masked, by the pipeline */
+static SensorLoadTestStatsType loadTestStats;
+static uint32_t tickPhases[SENSOR_LOAD_TEST_SENSORS]; /* a trigger each time one passes SENSOR_LOAD_TEST_TICK_RATE */
+static uint32_t ticks;
+static uint32_t durationTicks;
+
+/* Private function prototypes -----------------------------------------------*/
+static FcbRetValType _InitLoadTestTimer(void);
+static void _EndLoadTestFromISR(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Starts a load test
+ * @param  rateHz : Trigger rate per sensor [Hz], 0 to leave a sensor alone
+ * @param  duration : Test duration [ms]
+ * @retval FCB_OK if started, else FCB_ERR
+ */
+FcbRetValType SensorLoadTestStart(const uint32_t rateHz[SENSOR_LOAD_TEST_SENSORS], const uint32_t duration) {
+    bool isAnyTriggered = false;
+    uint8_t sensor;
+
+    if (0 == duration || duration > SENSOR_LOAD_TEST_MAX_DURATION) {
+        return FCB_ERR;
+    }
+
+    for (sensor = 0; sensor < SENSOR_LOAD_TEST_SENSORS; sensor++) {
+        if (rateHz[sensor] > SENSOR_LOAD_TEST_TICK_RATE) {
+            return FCB_ERR;
+        }
+        isAnyTriggered = isAnyTriggered || (rateHz[sensor] > 0);
+    }
+
+    if (!isAnyTriggered) {
+        return FCB_ERR;
+    }
+
+    if (!isTimerInitialised) {
+        if (FCB_OK != _InitLoadTestTimer()) {
+            return FCB_ERR;
+        }
+        isTimerInitialised = true;
+    }
+
+    /* The mode check and the start are one step for the tasks, the flight control cannot arm in between */
+    taskENTER_CRITICAL();
+    if (isLoadTestActive || FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        taskEXIT_CRITICAL();
+        return FCB_ERR;
+    }
+    memset(&loadTestStats, 0, sizeof(loadTestStats));
+    for (sensor = 0; sensor < SENSOR_LOAD_TEST_SENSORS; sensor++) {
+        loadTestStats.sensor[sensor].rateHz = rateHz[sensor];
+        tickPhases[sensor] = 0;
+    }
+    loadTestStats.duration = duration;
+    ticks = 0;
+    durationTicks = duration * TICKS_PER_MS;
+    isLoadTestActive = true;
+    taskEXIT_CRITICAL();
+
+    __HAL_TIM_SetCounter(&SensorLoadTestTimHandle, 0);
+    if (HAL_OK != HAL_TIM_Base_Start_IT(&SensorLoadTestTimHandle)) {
+        SensorLoadTestStop();
+        return FCB_ERR;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Ends the active load test, the drivers read the sensors again
+ * @param  None
+ * @retval None
+ */
+void SensorLoadTestStop(void) {
+    bool wasActive;
+    uint8_t sensor;
+
+    taskENTER_CRITICAL();
+    wasActive = isLoadTestActive;
+    if (wasActive) {
+        HAL_TIM_Base_Stop_IT(&SensorLoadTestTimHandle);
+        isLoadTestActive = false;
+    }
+    taskEXIT_CRITICAL();
+
+    if (wasActive) {
+        for (sensor = 0; sensor < SENSOR_LOAD_TEST_SENSORS; sensor++) {
+            FcbSendSensorMessage(sensorReadEvents[sensor]);
+        }
+    }
+}
+
+/*
+ * @brief  Triggers the data ready interrupts that are due at this tick
+ * @param  None
+ * @retval None
+ */
+void SensorLoadTestTickFromISR(void) {
+    uint32_t pendingLines = EXTI->PR;
+    uint32_t triggerLines = 0;
+    uint8_t sensor;
+
+    if (!isLoadTestActive) {
+        return;
+    }
+
+    ticks++;
+    loadTestStats.elapsed = ticks / TICKS_PER_MS;
+
+    if (ticks >= durationTicks || FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+        _EndLoadTestFromISR();
+        return;
+    }
+
+    for (sensor = 0; sensor < SENSOR_LOAD_TEST_SENSORS; sensor++) {
+        tickPhases[sensor] += loadTestStats.sensor[sensor].rateHz;
+        if (tickPhases[sensor] >= SENSOR_LOAD_TEST_TICK_RATE) {
+            tickPhases[sensor] -= SENSOR_LOAD_TEST_TICK_RATE;
+            loadTestStats.sensor[sensor].triggers++;
+            if (pendingLines & sensorExtiLines[sensor]) {
+                loadTestStats.drops[SENSOR_LOAD_DROP_EXTI]++;
+            } else {
+                triggerLines |= sensorExtiLines[sensor];
+            }
+        }
+    }
+
+    /* Taken once this handler returns, the data ready EXTIs have the same priority. The handlers clear the bits. */
+    EXTI->SWIER |= triggerLines;
+}
+
+/*
+ * @brief  Checks if a load test is active
+ * @param  None
+ * @retval true if active
+ */
+bool SensorLoadTestIsActive(void) {
+    return isLoadTestActive;
+}
+
+/*
+ * @brief  Counts a held sample passed on by a driver
+ * @param  sensor : Sensor index
+ * @retval None
+ */
+void SensorLoadTestSample(FcbSensorIndexType sensor) {
+    uint32_t latency = GetTimestamp() - GetSensorDrdyTimestamp(sensor);
+    SensorLoadTestSensorStatsType * pStats;
+
+    if ((uint32_t) sensor >= SENSOR_LOAD_TEST_SENSORS) {
+        return;
+    }
+
+    pStats = &loadTestStats.sensor[sensor];
+
+    taskENTER_CRITICAL();
+    pStats->samples++;
+    pStats->sumLatency += latency;
+    if (latency > pStats->maxLatency) {
+        pStats->maxLatency = latency;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Counts a lost event or sample, called with the interrupts masked
+ * @param  drop : Hand-over of the loss
+ * @retval None
+ */
+void SensorLoadTestCountDrop(SensorLoadTestDropType drop) {
+    if (isLoadTestActive && drop < SENSOR_LOAD_DROP_NBR) {
+        loadTestStats.drops[drop]++;
+    }
+}
+
+/*
+ * @brief  Counts the time the SENSORS task took to handle its pending events
+ * @param  cycles : Handling time [core clock cycles]
+ * @retval None
+ */
+void SensorLoadTestSensorsTaskRun(uint32_t cycles) {
+    if (isLoadTestActive) {
+        taskENTER_CRITICAL();
+        loadTestStats.sensorsTaskCycles += cycles;
+        taskEXIT_CRITICAL();
+    }
+}
+
+/*
+ * @brief  Gets the statistics of the running or the last load test
+ * @param  dstStats : Destination of the statistics
+ * @retval None
+ */
+void GetSensorLoadTestStats(SensorLoadTestStatsType * dstStats) {
+    taskENTER_CRITICAL();
+    *dstStats = loadTestStats;
+    dstStats->isActive = isLoadTestActive;
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Formats the statistics of the running or the last load test
+ * @param  dst : Destination string
+ * @param  dstSize : Size of dst
+ * @retval Length of the formatted string, see snprintf
+ */
+size_t SensorLoadTestPrint(char * dst, const size_t dstSize) {
+    SensorLoadTestStatsType stats;
+    CpuHeadroom_TypeDef headroom;
+    uint32_t meanLatency, busyTime;
+    size_t length;
+    uint8_t sensor;
+
+    GetSensorLoadTestStats(&stats);
+    GetCpuHeadroom(&headroom);
+
+    length = (size_t) snprintf(dst, dstSize, "\nSensor load test: %s, %lu of %lu ms\n",
+            stats.isActive ? "active" : "stopped", stats.elapsed, stats.duration);
+
+    for (sensor = 0; sensor < SENSOR_LOAD_TEST_SENSORS && length < dstSize; sensor++) {
+        meanLatency = 0;
+        if (stats.sensor[sensor].samples > 0) {
+            meanLatency = (uint32_t) (stats.sensor[sensor].sumLatency / stats.sensor[sensor].samples);
+        }
+        length += (size_t) snprintf(dst + length, dstSize - length,
+                "%s: %lu Hz, triggers: %lu, samples: %lu, data ready to sample mean: %lu us, max: %lu us\n",
+                sensorNames[sensor], stats.sensor[sensor].rateHz, stats.sensor[sensor].triggers,
+                stats.sensor[sensor].samples, meanLatency / CYCLES_PER_US,
+                stats.sensor[sensor].maxLatency / CYCLES_PER_US);
+    }
+
+    busyTime = (uint32_t) (stats.sensorsTaskCycles / (CYCLES_PER_US * 1000));
+    if (length < dstSize) {
+        length += (size_t) snprintf(dst + length, dstSize - length,
+                "Lost, interrupt pending: %lu, sensor event pending: %lu, flight control event pending: %lu, "
+                "mailbox overwritten: %lu\nSENSORS task busy: %lu ms (%lu %%)\nCPU headroom: %u.%02u %%\n",
+                stats.drops[SENSOR_LOAD_DROP_EXTI], stats.drops[SENSOR_LOAD_DROP_SENSOR_EVENT],
+                stats.drops[SENSOR_LOAD_DROP_FLIGHT_EVENT], stats.drops[SENSOR_LOAD_DROP_MAILBOX], busyTime,
+                (stats.elapsed > 0) ? busyTime * 100 / stats.elapsed : 0, headroom.headroom / 100,
+                headroom.headroom % 100);
+    }
+
+    return length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Configures the trigger timer, TIM15 is on APB2 and counts at the core clock
+ */
+static FcbRetValType _InitLoadTestTimer(void) {
+    SensorLoadTestTimHandle.Instance = SENSOR_LOAD_TEST_TIM;
+    SensorLoadTestTimHandle.Init.Period = SystemCoreClock / SENSOR_LOAD_TEST_TICK_RATE - 1;
+    SensorLoadTestTimHandle.Init.Prescaler = 0;
+    SensorLoadTestTimHandle.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    SensorLoadTestTimHandle.Init.CounterMode = TIM_COUNTERMODE_UP;
+    SensorLoadTestTimHandle.Init.RepetitionCounter = 0;
+
+    if (HAL_OK != HAL_TIM_Base_Init(&SensorLoadTestTimHandle)) {
+        return FCB_ERR;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * Ends the test from the timer ISR. The data ready lines of the sensors stay
+ * high until the sensors are read, the reads restart their interrupts.
+ */
+static void _EndLoadTestFromISR(void) {
+    uint8_t sensor;
+
+    HAL_TIM_Base_Stop_IT(&SensorLoadTestTimHandle);
+    isLoadTestActive = false;
+
+    for (sensor = 0; sensor < SENSOR_LOAD_TEST_SENSORS; sensor++) {
+        FcbSendSensorMessageFromISR(sensorReadEvents[sensor]);
+    }
+}
+
+#endif /* FCB_SENSOR_LOAD_TEST */
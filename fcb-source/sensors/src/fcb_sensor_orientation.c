@@ -0,0 +1,213 @@
+/******************************************************************************
+ * @file    fcb_sensor_orientation.c
+ * @author  Dragonfly
+ * @brief   Implementation of interface publicised in fcb_sensor_orientation.h
+ ******************************************************************************/
+
+#include "fcb_sensor_orientation.h"
+#include "fcb_gyroscope.h"
+#include "fcb_accelerometer_magnetometer.h"
+#include "flash.h"
+#include "fixed_format.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+/* Private define ------------------------------------------------------------*/
+enum {
+    ORIENTATION_AXES_N = 3
+};
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Written by the parameter table with the scheduler suspended, see applySensorOrientation */
+static volatile FcbSensorOrientationSettingsType orientationSettings = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+/* Rotation from the board axes to the quadcopter axes, rebuilt from orientationSettings */
+static float32_t orientationMatrix[ORIENTATION_AXES_N][ORIENTATION_AXES_N] = {
+    { 1.0f, 0.0f, 0.0f },
+    { 0.0f, 1.0f, 0.0f },
+    { 0.0f, 0.0f, 1.0f }
+};
+
+static const Param_TypeDef orientationParamTable[] = {
+    { "SENS_ROLL", PARAM_TYPE_FLOAT, &orientationSettings.mountRoll, -SENSOR_ORIENTATION_MAX_MOUNT_ANGLE,
+            SENSOR_ORIENTATION_MAX_MOUNT_ANGLE },
+    { "SENS_PITCH", PARAM_TYPE_FLOAT, &orientationSettings.mountPitch, -SENSOR_ORIENTATION_MAX_MOUNT_ANGLE,
+            SENSOR_ORIENTATION_MAX_MOUNT_ANGLE },
+    { "SENS_YAW", PARAM_TYPE_FLOAT, &orientationSettings.mountYaw, -SENSOR_ORIENTATION_MAX_MOUNT_ANGLE,
+            SENSOR_ORIENTATION_MAX_MOUNT_ANGLE },
+    { "TRIM_ROLL", PARAM_TYPE_FLOAT, &orientationSettings.trimRoll, -SENSOR_ORIENTATION_MAX_TRIM,
+            SENSOR_ORIENTATION_MAX_TRIM },
+    { "TRIM_PITCH", PARAM_TYPE_FLOAT, &orientationSettings.trimPitch, -SENSOR_ORIENTATION_MAX_TRIM,
+            SENSOR_ORIENTATION_MAX_TRIM }
+};
+
+/* Private function prototypes -----------------------------------------------*/
+static void updateOrientationMatrix(void);
+static void multiplyRotation(float32_t dst[][ORIENTATION_AXES_N], const float32_t left[][ORIENTATION_AXES_N],
+        const float32_t right[][ORIENTATION_AXES_N]);
+static void applySensorOrientation(void);
+static FcbRetValType saveSensorOrientation(void);
+
+/* A new rotation is fused into the calibrations of the sensors at once */
+static const ParamGroup_TypeDef orientationParamGroup = { orientationParamTable,
+        sizeof(orientationParamTable) / sizeof(orientationParamTable[0]), applySensorOrientation,
+        saveSensorOrientation };
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Loads the orientation settings from flash, if valid, and builds the rotation
+ * @param  None
+ * @retval None
+ */
+void SensorOrientationInit(void) {
+    FcbSensorOrientationSettingsType settings;
+
+    if (FLASH_OK == ReadSensorOrientationSettingsFromFlash(&settings)
+            && fabsf(settings.mountRoll) <= SENSOR_ORIENTATION_MAX_MOUNT_ANGLE
+            && fabsf(settings.mountPitch) <= SENSOR_ORIENTATION_MAX_MOUNT_ANGLE
+            && fabsf(settings.mountYaw) <= SENSOR_ORIENTATION_MAX_MOUNT_ANGLE
+            && fabsf(settings.trimRoll) <= SENSOR_ORIENTATION_MAX_TRIM
+            && fabsf(settings.trimPitch) <= SENSOR_ORIENTATION_MAX_TRIM) {
+        orientationSettings = settings;
+    }
+
+    updateOrientationMatrix();
+}
+
+void GetSensorOrientationMatrix(float32_t dstRotation[3][3]) {
+    memcpy(dstRotation, orientationMatrix, sizeof(orientationMatrix));
+}
+
+void GetSensorOrientationSettings(FcbSensorOrientationSettingsType * dstSettings) {
+    taskENTER_CRITICAL();
+    *dstSettings = orientationSettings;
+    taskEXIT_CRITICAL();
+}
+
+const ParamGroup_TypeDef* GetSensorOrientationParamGroup(void) {
+    return &orientationParamGroup;
+}
+
+size_t PrintSensorOrientation(char * dst, const size_t dstSize) {
+    FcbSensorOrientationSettingsType settings;
+    float32_t angles[ORIENTATION_AXES_N];
+    char valueStrings[2][48];
+    size_t length;
+    uint8_t i;
+
+    GetSensorOrientationSettings(&settings);
+
+    angles[0] = settings.mountRoll * 180.0f / PI;
+    angles[1] = settings.mountPitch * 180.0f / PI;
+    angles[2] = settings.mountYaw * 180.0f / PI;
+    FormatFixedList(valueStrings[0], sizeof(valueStrings[0]), "%1.2f, %1.2f, %1.2f", angles, 3);
+    angles[0] = settings.trimRoll * 180.0f / PI;
+    angles[1] = settings.trimPitch * 180.0f / PI;
+    FormatFixedList(valueStrings[1], sizeof(valueStrings[1]), "%1.2f, %1.2f", angles, 2);
+
+    length = (size_t) snprintf(dst, dstSize, "\nSensor orientation\nMounting roll, pitch, yaw: %s [deg]\n"
+            "Trim roll, pitch: %s [deg]\nBoard to quadcopter axes:\n", valueStrings[0], valueStrings[1]);
+
+    for (i = 0; i < ORIENTATION_AXES_N && length < dstSize; i++) {
+        FormatFixedList(valueStrings[0], sizeof(valueStrings[0]), "%1.4f, %1.4f, %1.4f", orientationMatrix[i], 3);
+        length += (size_t) snprintf(dst + length, dstSize - length, "  %s\n", valueStrings[0]);
+    }
+
+    return (length < dstSize) ? length : dstSize - 1;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Builds the rotation from the board axes to the quadcopter axes, see fcb_sensor_orientation.h
+ * @param  None
+ * @retval None
+ */
+static void updateOrientationMatrix(void) {
+    float32_t sr, cr, sp, cp, sy, cy, str, ctr, stp, ctp;
+    float32_t mount[ORIENTATION_AXES_N][ORIENTATION_AXES_N];
+    float32_t trim[ORIENTATION_AXES_N][ORIENTATION_AXES_N];
+
+    sr = arm_sin_f32(orientationSettings.mountRoll);
+    cr = arm_cos_f32(orientationSettings.mountRoll);
+    sp = arm_sin_f32(orientationSettings.mountPitch);
+    cp = arm_cos_f32(orientationSettings.mountPitch);
+    sy = arm_sin_f32(orientationSettings.mountYaw);
+    cy = arm_cos_f32(orientationSettings.mountYaw);
+    str = arm_sin_f32(orientationSettings.trimRoll);
+    ctr = arm_cos_f32(orientationSettings.trimRoll);
+    stp = arm_sin_f32(orientationSettings.trimPitch);
+    ctp = arm_cos_f32(orientationSettings.trimPitch);
+
+    /* Rz(yaw) * Ry(pitch) * Rx(roll) */
+    mount[0][0] = cy * cp;
+    mount[0][1] = cy * sp * sr - sy * cr;
+    mount[0][2] = cy * sp * cr + sy * sr;
+    mount[1][0] = sy * cp;
+    mount[1][1] = sy * sp * sr + cy * cr;
+    mount[1][2] = sy * sp * cr - cy * sr;
+    mount[2][0] = -sp;
+    mount[2][1] = cp * sr;
+    mount[2][2] = cp * cr;
+
+    /* Ry(trimPitch) * Rx(trimRoll) */
+    trim[0][0] = ctp;
+    trim[0][1] = stp * str;
+    trim[0][2] = stp * ctr;
+    trim[1][0] = 0.0f;
+    trim[1][1] = ctr;
+    trim[1][2] = -str;
+    trim[2][0] = -stp;
+    trim[2][1] = ctp * str;
+    trim[2][2] = ctp * ctr;
+
+    multiplyRotation(orientationMatrix, trim, mount);
+}
+
+static void multiplyRotation(float32_t dst[][ORIENTATION_AXES_N], const float32_t left[][ORIENTATION_AXES_N],
+        const float32_t right[][ORIENTATION_AXES_N]) {
+    uint8_t i, j, k;
+
+    for (i = 0; i < ORIENTATION_AXES_N; i++) {
+        for (j = 0; j < ORIENTATION_AXES_N; j++) {
+            dst[i][j] = 0.0f;
+            for (k = 0; k < ORIENTATION_AXES_N; k++) {
+                dst[i][j] += left[i][k] * right[k][j];
+            }
+        }
+    }
+}
+
+/*
+ * @brief  Rebuilds the rotation and fuses it into the calibrations of the sensors, upon new orientation values.
+ *         Called with the scheduler suspended.
+ * @param  None
+ * @retval None
+ */
+static void applySensorOrientation(void) {
+    updateOrientationMatrix();
+    UpdateGyroscopeOrientation();
+    UpdateAccMagOrientation();
+}
+
+/*
+ * @brief  Saves the orientation settings to flash
+ * @param  None
+ * @retval FCB_OK if saved, else FCB_ERR
+ */
+static FcbRetValType saveSensorOrientation(void) {
+    FcbSensorOrientationSettingsType settings;
+
+    GetSensorOrientationSettings(&settings);
+
+    return FLASH_OK == WriteSensorOrientationSettingsToFlash(&settings) ? FCB_OK : FCB_ERR;
+}
@@ -0,0 +1,363 @@
+/******************************************************************************
+ * @file    fcb_sensor_self_test.c
+ * @author  Dragonfly
+ * @brief   Implementation of interface publicised in fcb_sensor_self_test.h
+ ******************************************************************************/
+
+#include "fcb_sensor_self_test.h"
+#include "fcb_sensor_bus.h"
+#include "flight_control.h"
+#include "deferred_log.h"
+#include "fixed_format.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+/**
+ * Noise floor of a sensor, Welford's running mean and sum of squared
+ * deviations per axis. Only used by the SENSORS task.
+ */
+typedef struct SensorNoiseState {
+    bool isSubscribed;
+    uint8_t subscriber;
+    uint16_t samples;
+    float32_t mean[3];
+    float32_t m2[3];
+} SensorNoiseStateType;
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Written by the SENSORS task in critical sections */
+static FcbSensorHealthReportType healthReports[FCB_SENSOR_NBR];
+
+static SensorNoiseStateType noiseStates[FCB_SENSOR_NBR];
+
+static const char* sensorNames[FCB_SENSOR_NBR] = { "gyro", "acc", "mag", "baro" };
+static const uint8_t sensorAxes[FCB_SENSOR_NBR] = { 3, 3, 3, 1 };
+static const uint16_t noiseSamples[FCB_SENSOR_NBR] = { SENSOR_NOISE_GYRO_SAMPLES, SENSOR_NOISE_ACC_SAMPLES,
+        SENSOR_NOISE_MAG_SAMPLES, SENSOR_NOISE_BARO_SAMPLES };
+static const char* selfTestFailures[FCB_SENSOR_NBR] = { "self-test output change out of bounds", NULL, NULL,
+        "calibration E2PROM invalid" };
+
+/* Private function prototypes -----------------------------------------------*/
+static void addNoiseSample(FcbSensorIndexType sensor, const float32_t * xyz);
+static void checkNoiseFloor(FcbSensorIndexType sensor);
+static void updateStatus(FcbSensorIndexType sensor);
+static bool encodeSensorHealthReport(pb_ostream_t * stream, FcbSensorIndexType sensor,
+        const FcbSensorHealthReportType * report);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Subscribes to the samples of every sensor for its noise floor
+ * @param  None
+ * @retval FCB_OK if subscribed, else FCB_ERR
+ */
+FcbRetValType SensorSelfTestInit(void) {
+    FcbRetValType retVal = FCB_OK;
+    uint8_t sensor;
+
+    for (sensor = 0; sensor < FCB_SENSOR_NBR; sensor++) {
+        if (FCB_OK == SensorBusSubscribe((FcbSensorIndexType) sensor, &noiseStates[sensor].subscriber)) {
+            noiseStates[sensor].isSubscribed = true;
+        } else {
+            retVal = FCB_ERR;
+        }
+    }
+
+    return retVal;
+}
+
+void SensorSelfTestSetResult(FcbSensorIndexType sensor, FcbSensorSelfTestStatusType selfTest,
+        const float32_t * change, float32_t expected) {
+    FcbSensorHealthReportType* report;
+
+    if (sensor >= FCB_SENSOR_NBR) {
+        return;
+    }
+    report = &healthReports[sensor];
+
+    taskENTER_CRITICAL();
+    report->selfTest = selfTest;
+    if (NULL != change) {
+        memcpy(report->selfTestChange, change, sizeof(report->selfTestChange));
+    }
+    report->selfTestExpected = expected;
+    if (SENSOR_SELF_TEST_FAILED == selfTest && NULL == report->failure) {
+        report->failure = selfTestFailures[sensor];
+    }
+    updateStatus(sensor);
+    taskEXIT_CRITICAL();
+
+    if (SENSOR_SELF_TEST_FAILED == selfTest) {
+        LOG2("ERROR: %s self-test failed, %s", sensorNames[sensor], selfTestFailures[sensor]);
+    }
+}
+
+/*
+ * @brief  Adds the unread samples of the sensors to their noise floors, and checks the floors that are complete
+ * @param  None
+ * @retval None
+ */
+void SensorSelfTestUpdate(void) {
+    const FcbSensorSampleType* sample;
+    SensorNoiseStateType* state;
+    uint32_t sequence;
+    float32_t xyz[3];
+    uint8_t sensor;
+
+    for (sensor = 0; sensor < FCB_SENSOR_NBR; sensor++) {
+        state = &noiseStates[sensor];
+
+        while (state->isSubscribed && state->samples < noiseSamples[sensor]
+                && NULL != (sample = SensorBusRead((FcbSensorIndexType) sensor, state->subscriber, &sequence))) {
+            memcpy(xyz, sample->xyz, sizeof(xyz));
+            if (SensorBusSampleStillValid((FcbSensorIndexType) sensor, sequence)) {
+                addNoiseSample((FcbSensorIndexType) sensor, xyz);
+            }
+        }
+
+        if (state->isSubscribed && state->samples >= noiseSamples[sensor]) {
+            /* Done, the later samples are not read anymore */
+            state->isSubscribed = false;
+            checkNoiseFloor((FcbSensorIndexType) sensor);
+        }
+    }
+}
+
+FcbSensorSelfTestStatusType GetSensorSelfTestStatus(FcbSensorIndexType sensor) {
+    if (sensor >= FCB_SENSOR_NBR) {
+        return SENSOR_SELF_TEST_NOT_RUN;
+    }
+
+    return healthReports[sensor].status;
+}
+
+bool IsSensorSelfTestPassed(void) {
+    return SENSOR_SELF_TEST_PASSED == GetSensorSelfTestStatus(GYRO_IDX)
+            && SENSOR_SELF_TEST_PASSED == GetSensorSelfTestStatus(ACC_IDX)
+            && SENSOR_SELF_TEST_PASSED == GetSensorSelfTestStatus(MAG_IDX);
+}
+
+const char* GetSensorSelfTestStatusName(FcbSensorSelfTestStatusType status) {
+    switch (status) {
+    case SENSOR_SELF_TEST_PASSED:
+        return "passed";
+    case SENSOR_SELF_TEST_FAILED:
+        return "FAILED";
+    case SENSOR_SELF_TEST_UNSUPPORTED:
+        return "none";
+    case SENSOR_SELF_TEST_NOT_RUN:
+    default:
+        return "running";
+    }
+}
+
+void GetSensorHealthReport(FcbSensorIndexType sensor, FcbSensorHealthReportType * dstReport) {
+    if (sensor >= FCB_SENSOR_NBR) {
+        memset(dstReport, 0, sizeof(FcbSensorHealthReportType));
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    *dstReport = healthReports[sensor];
+    taskEXIT_CRITICAL();
+}
+
+size_t PrintSensorHealthReport(char * dst, const size_t dstSize) {
+    FcbSensorHealthReportType report;
+    char valueStrings[2][48];
+    size_t length;
+    uint8_t sensor;
+
+    length = (size_t) snprintf(dst, dstSize, "\nSensor health: %s\n%-6s%9s%10s%9s  %-30s%s\n",
+            IsSensorSelfTestPassed() ? "ok" : "arming blocked", "Sensor", "Status", "SelfTest", "Samples",
+            "Mean", "Noise");
+
+    for (sensor = 0; sensor < FCB_SENSOR_NBR && length < dstSize; sensor++) {
+        GetSensorHealthReport((FcbSensorIndexType) sensor, &report);
+
+        if (1 == sensorAxes[sensor]) {
+            FormatFixed(valueStrings[0], sizeof(valueStrings[0]), report.mean[0], 2);
+            FormatFixed(valueStrings[1], sizeof(valueStrings[1]), report.noise[0], 3);
+        } else {
+            FormatFixedList(valueStrings[0], sizeof(valueStrings[0]), "%1.3f, %1.3f, %1.3f", report.mean, 3);
+            FormatFixedList(valueStrings[1], sizeof(valueStrings[1]), "%1.4f, %1.4f, %1.4f", report.noise, 3);
+        }
+        length += (size_t) snprintf(dst + length, dstSize - length, "%-6s%9s%10s%9u  %-30s%s\n",
+                sensorNames[sensor], GetSensorSelfTestStatusName(report.status),
+                GetSensorSelfTestStatusName(report.selfTest), (unsigned int) report.samples, valueStrings[0],
+                valueStrings[1]);
+
+        if (GYRO_IDX == sensor && SENSOR_SELF_TEST_NOT_RUN != report.selfTest
+                && SENSOR_SELF_TEST_UNSUPPORTED != report.selfTest && length < dstSize) {
+            FormatFixedList(valueStrings[0], sizeof(valueStrings[0]), "%1.3f, %1.3f, %1.3f", report.selfTestChange,
+                    3);
+            FormatFixed(valueStrings[1], sizeof(valueStrings[1]), report.selfTestExpected, 3);
+            length += (size_t) snprintf(dst + length, dstSize - length,
+                    "      self-test change %s [rad/s], typical %s\n", valueStrings[0], valueStrings[1]);
+        }
+        if (NULL != report.failure && length < dstSize) {
+            length += (size_t) snprintf(dst + length, dstSize - length, "      %s\n", report.failure);
+        }
+    }
+
+    return (length < dstSize) ? length : dstSize - 1;
+}
+
+/*
+ * @brief  Encodes the health reports as a SensorHealthProto, see fcb_sensor_self_test.h
+ * @param  stream : Destination stream
+ * @retval true if encoded, false if the stream is too small
+ */
+bool EncodeSensorHealth(pb_ostream_t * stream) {
+    FcbSensorHealthReportType report;
+    uint8_t sensor;
+
+    for (sensor = 0; sensor < FCB_SENSOR_NBR; sensor++) {
+        GetSensorHealthReport((FcbSensorIndexType) sensor, &report);
+        if (!encodeSensorHealthReport(stream, (FcbSensorIndexType) sensor, &report)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Adds a sample to the running mean and sum of squared deviations of a sensor,
+ * and publishes the noise floor so far
+ */
+static void addNoiseSample(FcbSensorIndexType sensor, const float32_t * xyz) {
+    SensorNoiseStateType* state = &noiseStates[sensor];
+    FcbSensorHealthReportType* report = &healthReports[sensor];
+    float32_t noise[3] = { 0.0f, 0.0f, 0.0f };
+    float32_t delta;
+    uint8_t axis;
+
+    state->samples++;
+    for (axis = 0; axis < sensorAxes[sensor]; axis++) {
+        delta = xyz[axis] - state->mean[axis];
+        state->mean[axis] += delta / (float32_t) state->samples;
+        state->m2[axis] += delta * (xyz[axis] - state->mean[axis]);
+        if (state->samples > 1) {
+            noise[axis] = sqrtf(state->m2[axis] / (float32_t) (state->samples - 1));
+        }
+    }
+
+    taskENTER_CRITICAL();
+    report->samples = state->samples;
+    memcpy(report->mean, state->mean, sizeof(report->mean));
+    memcpy(report->noise, noise, sizeof(report->noise));
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * Checks a complete noise floor: an output that has not changed at all is
+ * stuck, and the accelerometer at rest or carried must measure about gravity
+ */
+static void checkNoiseFloor(FcbSensorIndexType sensor) {
+    FcbSensorHealthReportType* report = &healthReports[sensor];
+    const char* failure = NULL;
+    float32_t norm = 0.0f;
+    bool isStuck = true;
+    uint8_t axis;
+
+    for (axis = 0; axis < sensorAxes[sensor]; axis++) {
+        if (noiseStates[sensor].m2[axis] > 0.0f) {
+            isStuck = false;
+        }
+        norm += noiseStates[sensor].mean[axis] * noiseStates[sensor].mean[axis];
+    }
+    norm = sqrtf(norm);
+
+    if (isStuck) {
+        failure = "stuck output";
+    } else if (ACC_IDX == sensor
+            && (norm < SENSOR_NOISE_MIN_GRAVITY * G_ACC || norm > SENSOR_NOISE_MAX_GRAVITY * G_ACC)) {
+        failure = "gravity out of range";
+    }
+
+    taskENTER_CRITICAL();
+    if (NULL == report->failure) {
+        report->failure = failure;
+    }
+    updateStatus(sensor);
+    taskEXIT_CRITICAL();
+
+    if (NULL != failure) {
+        LOG2("ERROR: %s health check failed, %s", sensorNames[sensor], failure);
+    }
+}
+
+/*
+ * Updates the status of both checks, called in a critical section
+ */
+static void updateStatus(FcbSensorIndexType sensor) {
+    FcbSensorHealthReportType* report = &healthReports[sensor];
+
+    if (NULL != report->failure) {
+        report->status = SENSOR_SELF_TEST_FAILED;
+    } else if (report->samples >= noiseSamples[sensor] && SENSOR_SELF_TEST_NOT_RUN != report->selfTest) {
+        report->status = SENSOR_SELF_TEST_PASSED;
+    } else {
+        report->status = SENSOR_SELF_TEST_NOT_RUN;
+    }
+}
+
+/*
+ * Encodes a health report as a SensorHealthReportProto submessage, field 1 of
+ * SensorHealthProto
+ */
+static bool encodeSensorHealthReport(pb_ostream_t * stream, FcbSensorIndexType sensor,
+        const FcbSensorHealthReportType * report) {
+    uint8_t reportBuffer[SENSOR_HEALTH_REPORT_MAX_SIZE];
+    pb_ostream_t reportStream = pb_ostream_from_buffer(reportBuffer, sizeof(reportBuffer));
+    const uint8_t axes = sensorAxes[sensor];
+    uint8_t i;
+
+    if (!pb_encode_tag(&reportStream, PB_WT_VARINT, 1) || !pb_encode_varint(&reportStream, sensor)
+            || !pb_encode_tag(&reportStream, PB_WT_VARINT, 2) || !pb_encode_varint(&reportStream, report->status)
+            || !pb_encode_tag(&reportStream, PB_WT_VARINT, 3) || !pb_encode_varint(&reportStream, report->selfTest)
+            || !pb_encode_tag(&reportStream, PB_WT_STRING, 4) || !pb_encode_varint(&reportStream, 3 * 4)) {
+        return false;
+    }
+    for (i = 0; i < 3; i++) {
+        if (!pb_encode_fixed32(&reportStream, &report->selfTestChange[i])) {
+            return false;
+        }
+    }
+    if (!pb_encode_tag(&reportStream, PB_WT_32BIT, 5) || !pb_encode_fixed32(&reportStream, &report->selfTestExpected)
+            || !pb_encode_tag(&reportStream, PB_WT_STRING, 6) || !pb_encode_varint(&reportStream, axes * 4)) {
+        return false;
+    }
+    for (i = 0; i < axes; i++) {
+        if (!pb_encode_fixed32(&reportStream, &report->mean[i])) {
+            return false;
+        }
+    }
+    if (!pb_encode_tag(&reportStream, PB_WT_STRING, 7) || !pb_encode_varint(&reportStream, axes * 4)) {
+        return false;
+    }
+    for (i = 0; i < axes; i++) {
+        if (!pb_encode_fixed32(&reportStream, &report->noise[i])) {
+            return false;
+        }
+    }
+    if (!pb_encode_tag(&reportStream, PB_WT_VARINT, 8) || !pb_encode_varint(&reportStream, report->samples)) {
+        return false;
+    }
+
+    return pb_encode_tag(stream, PB_WT_STRING, 1)
+            && pb_encode_string(stream, reportBuffer, reportStream.bytes_written);
+}
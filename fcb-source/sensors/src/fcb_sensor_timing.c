@@ -0,0 +1,321 @@
+/******************************************************************************
+ * @file    fcb_sensor_timing.c
+ * @author  Dragonfly
+ * @brief   Implementation of interface publicised in fcb_sensor_timing.h
+ ******************************************************************************/
+
+#include "fcb_sensor_timing.h"
+#include "fcb_gyroscope.h"
+#include "fcb_accelerometer_magnetometer.h"
+#include "fcb_sensor_filter.h"
+#include "fcb_rpm_filter.h"
+#include "fcb_dynamic_notch.h"
+#include "fcb_vibration_monitor.h"
+#include "flight_control.h"
+#include "control_executive.h"
+#include "deferred_log.h"
+#include "fixed_format.h"
+#include "flash.h"
+#include "lsm303dlhc.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Requested rates as stored, written by the task calling SetSensorTiming in a critical section */
+static FcbSensorTimingSettingsType sensorTimingSettings;
+
+/* Rates in use and the delay without the sensor filter, written by the SENSORS task and read by other tasks in
+ * critical sections */
+static FcbSensorTimingType sensorTimings[SENSOR_TIMING_SENSOR_NBR];
+
+/* Delay of the sensor itself, without the sensor filter [core clock cycles] */
+static volatile uint32_t sensorGroupDelayCycles[SENSOR_TIMING_SENSOR_NBR];
+
+/* The change of SetSensorTiming that the SENSORS task has not applied yet */
+static volatile bool isSensorTimingPending = false;
+static FcbSensorIndexType pendingSensor;
+
+static const char* sensorNames[SENSOR_TIMING_SENSOR_NBR] = { "gyro", "acc", "mag" };
+
+/* Private function prototypes -----------------------------------------------*/
+static FcbRetValType applyToSensor(FcbSensorIndexType sensor, const FcbSensorTimingConfigType * config);
+static void updateNominalTiming(FcbSensorIndexType sensor);
+static void updateGroupDelay(FcbSensorIndexType sensor);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Reconfigures the sensors with the stored rates, the others keep their defaults
+ * @param  None
+ * @retval None
+ */
+void SensorTimingInit(void) {
+    uint8_t sensor;
+
+    if (FLASH_OK != ReadSensorTimingSettingsFromFlash(&sensorTimingSettings)) {
+        memset(&sensorTimingSettings, 0, sizeof(sensorTimingSettings));
+    }
+
+    for (sensor = 0; sensor < SENSOR_TIMING_SENSOR_NBR; sensor++) {
+        updateNominalTiming((FcbSensorIndexType) sensor);
+        if (sensorTimingSettings.sensor[sensor].dataRateHz > 0.0f
+                && FCB_OK != applyToSensor((FcbSensorIndexType) sensor, &sensorTimingSettings.sensor[sensor])) {
+            LOG1("WARNING: %s stored data rate not supported", sensorNames[sensor]);
+        }
+        updateGroupDelay((FcbSensorIndexType) sensor);
+    }
+}
+
+/*
+ * @brief  Stores the rates of a sensor and signals the SENSORS task to apply them
+ * @param  sensor : Sensor index, GYRO_IDX, ACC_IDX or MAG_IDX
+ * @param  config : Requested rates
+ * @retval FCB_OK if stored, else FCB_ERR
+ */
+FcbRetValType SetSensorTiming(FcbSensorIndexType sensor, const FcbSensorTimingConfigType * config) {
+    FcbSensorTimingSettingsType settings;
+
+    if (FLIGHT_CONTROL_IDLE != GetFlightControlMode() || sensor >= SENSOR_TIMING_SENSOR_NBR || NULL == config
+            || config->dataRateHz <= 0.0f || config->lowPassHz < 0.0f || config->highPassHz < 0.0f
+            || config->lowPassHz >= config->dataRateHz / 2.0f || config->highPassHz >= config->dataRateHz / 2.0f) {
+        return FCB_ERR;
+    }
+
+    taskENTER_CRITICAL();
+    if (isSensorTimingPending) {
+        taskEXIT_CRITICAL();
+        return FCB_ERR;
+    }
+    sensorTimingSettings.sensor[sensor] = *config;
+    settings = sensorTimingSettings;
+    pendingSensor = sensor;
+    isSensorTimingPending = true;
+    taskEXIT_CRITICAL();
+
+    FcbSendSensorMessage(FCB_SENSOR_TIMING_CHANGE);
+
+    if (FLASH_OK != WriteSensorTimingSettingsToFlash(&settings)) {
+        return FCB_ERR;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Reconfigures the sensor of the pending change and moves everything depending on its data rate
+ * @param  None
+ * @retval None
+ */
+void ApplySensorTiming(void) {
+    FcbSensorTimingConfigType config;
+    FcbSensorTimingType timing;
+    FcbSensorIndexType sensor;
+    uint8_t i;
+
+    taskENTER_CRITICAL();
+    if (!isSensorTimingPending) {
+        taskEXIT_CRITICAL();
+        return;
+    }
+    sensor = pendingSensor;
+    config = sensorTimingSettings.sensor[sensor];
+    taskEXIT_CRITICAL();
+
+    if (FCB_OK != applyToSensor(sensor, &config)) {
+        LOG1("WARNING: %s data rate not supported", sensorNames[sensor]);
+    }
+
+    SensorFilterDataRateChanged();
+    if (GYRO_IDX == sensor) {
+        /* the notches are run by the gyroscope context, which may run above the critical section */
+#ifdef FCB_RPM_FILTER
+#ifdef FCB_CONTROL_EXECUTIVE
+        ControlExecutiveSuspend();
+#endif
+        taskENTER_CRITICAL();
+        RpmFilterInit();
+        taskEXIT_CRITICAL();
+#ifdef FCB_CONTROL_EXECUTIVE
+        ControlExecutiveResume();
+#endif
+#endif
+#ifdef FCB_DYNAMIC_NOTCH
+        DynamicNotchDataRateChanged();
+#endif
+    }
+    UpdateSensorDataRates();
+    VibrationMonitorInit();
+
+    for (i = 0; i < SENSOR_TIMING_SENSOR_NBR; i++) {
+        updateGroupDelay((FcbSensorIndexType) i);
+    }
+
+    isSensorTimingPending = false;
+
+    /* sets the control sample period and the loop deadlines for the new gyroscope rate too */
+    ReinitStateEstimation();
+
+    GetSensorTiming(sensor, &timing);
+    LOG3("sensor timing: %s at %u mHz, delay %u us", sensorNames[sensor], (uint32_t) (timing.dataRateHz * 1000.0f),
+            (uint32_t) (timing.groupDelay * 1e6f));
+}
+
+/*
+ * @brief  Gets the rates in use by a sensor
+ * @param  sensor : Sensor index
+ * @param  timing : Destination
+ * @retval None
+ */
+void GetSensorTiming(FcbSensorIndexType sensor, FcbSensorTimingType * timing) {
+    if (sensor >= SENSOR_TIMING_SENSOR_NBR) {
+        memset(timing, 0, sizeof(*timing));
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    *timing = sensorTimings[sensor];
+    taskEXIT_CRITICAL();
+    timing->groupDelay += SensorFilterGroupDelay(sensor);
+}
+
+/*
+ * @brief  Gets the group delay of a sensor, including its sensor filter
+ * @param  sensor : Sensor index
+ * @retval Delay [core clock cycles], 0 for the barometer
+ */
+RAMFUNC uint32_t GetSensorGroupDelayCycles(FcbSensorIndexType sensor) {
+    if (sensor >= SENSOR_TIMING_SENSOR_NBR) {
+        return 0;
+    }
+
+    return sensorGroupDelayCycles[sensor] + (uint32_t) (SensorFilterGroupDelay(sensor) * (float32_t) SystemCoreClock);
+}
+
+/*
+ * @brief  Prints the rates in use by the sensors
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @retval Length of the table string
+ */
+size_t PrintSensorTiming(char * dst, const size_t dstSize) {
+    FcbSensorTimingType timing;
+    char rateString[16], lowPassString[16], highPassString[16], delayString[16];
+    size_t length;
+    uint8_t sensor;
+
+    length = (size_t) snprintf(dst, dstSize, "\nSensor timing\n%-6s%10s%13s%14s%11s\n",
+            "Sensor", "Rate[Hz]", "LowPass[Hz]", "HighPass[Hz]", "Delay[ms]");
+
+    for (sensor = 0; sensor < SENSOR_TIMING_SENSOR_NBR && length < dstSize; sensor++) {
+        GetSensorTiming((FcbSensorIndexType) sensor, &timing);
+        FormatFixed(rateString, sizeof(rateString), timing.dataRateHz, 2);
+        FormatFixed(lowPassString, sizeof(lowPassString), timing.lowPassHz, 2);
+        FormatFixed(highPassString, sizeof(highPassString), timing.highPassHz, 3);
+        FormatFixed(delayString, sizeof(delayString), timing.groupDelay * 1000.0f, 2);
+        length += (size_t) snprintf(dst + length, dstSize - length, "%-6s%10s%13s%14s%11s\n",
+                sensorNames[sensor], rateString, timing.lowPassHz > 0.0f ? lowPassString : "-",
+                timing.highPassHz > 0.0f ? highPassString : "off", delayString);
+    }
+
+    return length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Reconfigures one sensor with the rates nearest to the requested ones and
+ * keeps the selected ones
+ */
+static FcbRetValType applyToSensor(FcbSensorIndexType sensor, const FcbSensorTimingConfigType * config) {
+    FcbSensorTimingConfigType selected = *config;
+    uint8_t status;
+
+    if (GYRO_IDX == sensor) {
+        status = SetGyroscopeRates(&selected.dataRateHz, &selected.lowPassHz, &selected.highPassHz);
+    } else {
+        /* the accelerometer low-pass follows its data rate, the magnetometer has no filters */
+        selected.lowPassHz = 0.0f;
+        status = SetAccMagRates(sensor, &selected.dataRateHz, &selected.highPassHz);
+    }
+
+    if (FCB_OK != status) {
+        updateNominalTiming(sensor);
+        return FCB_ERR;
+    }
+
+    taskENTER_CRITICAL();
+    sensorTimings[sensor].dataRateHz = selected.dataRateHz;
+    sensorTimings[sensor].lowPassHz = selected.lowPassHz;
+    sensorTimings[sensor].highPassHz = selected.highPassHz;
+    taskEXIT_CRITICAL();
+
+    return FCB_OK;
+}
+
+/*
+ * Takes the data rate of a sensor from its driver, with the filters of the
+ * driver defaults
+ */
+static void updateNominalTiming(FcbSensorIndexType sensor) {
+    float32_t dataRateHz;
+
+    switch (sensor) {
+    case GYRO_IDX:
+        dataRateHz = (float32_t) GyroDataRateHz();
+        break;
+    case ACC_IDX:
+        dataRateHz = (float32_t) LSM303DLHC_AccDataRateHz();
+        break;
+    default:
+        dataRateHz = LSM303DLHC_MagDataRateHz();
+        break;
+    }
+
+    taskENTER_CRITICAL();
+    sensorTimings[sensor].dataRateHz = dataRateHz;
+    sensorTimings[sensor].lowPassHz = 0.0f;
+    sensorTimings[sensor].highPassHz = 0.0f;
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * Models the on-chip low-pass as first order, with a delay of 1/(2*pi*cutoff)
+ * at low frequencies. The magnetometer samples are averaged by MAG_DECIMATION,
+ * which delays them by half the averaged span.
+ */
+static void updateGroupDelay(FcbSensorIndexType sensor) {
+    float32_t dataRateHz = sensorTimings[sensor].dataRateHz;
+    float32_t cutoffHz = sensorTimings[sensor].lowPassHz;
+    float32_t delay = 0.0f;
+
+    if (dataRateHz > 0.0f) {
+        if (cutoffHz <= 0.0f) {
+            cutoffHz = dataRateHz / 2.0f;
+        }
+        delay = 1.0f / (2.0f * PI * cutoffHz);
+        if (MAG_IDX == sensor) {
+            delay += (float32_t) (MAG_DECIMATION - 1) / (2.0f * dataRateHz);
+        }
+    }
+
+    taskENTER_CRITICAL();
+    sensorTimings[sensor].groupDelay = delay;
+    sensorGroupDelayCycles[sensor] = (uint32_t) (delay * (float32_t) SystemCoreClock);
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
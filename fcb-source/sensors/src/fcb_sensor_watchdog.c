@@ -0,0 +1,256 @@
+/******************************************************************************
+ * @file    fcb_sensor_watchdog.c
+ * @author  Dragonfly
+ * @brief   Implementation of interface publicised in fcb_sensor_watchdog.h
+ ******************************************************************************/
+
+#include "fcb_sensor_watchdog.h"
+#include "fcb_gyroscope.h"
+#include "fcb_accelerometer_magnetometer.h"
+#include "fcb_error.h"
+#include "fcb_diag.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+
+/* Private define ------------------------------------------------------------*/
+#define SENSOR_WATCHDOG_TIM_RATE    10000 // Counter clock [Hz]
+
+/* Private typedef -----------------------------------------------------------*/
+
+/**
+ * Watchdog state of a sensor, only written by the SENSORS task
+ */
+typedef struct SensorWatchdogState {
+    volatile uint32_t samples;  /* counted by SensorWatchdogFeed */
+    uint32_t checkedSamples;    /* samples at the last check */
+    uint32_t lastSampleTick;    /* [ms] of the check that found the latest sample */
+    uint32_t lastRecoveryTick;  /* [ms] of the latest recovery step */
+    uint8_t nextRecovery;       /* FcbSensorRecoveryType */
+    volatile uint32_t stalls;   /* since startup, see GetSensorStalls */
+    FcbSensorWatchdogStatsType stats;
+} SensorWatchdogStateType;
+
+/* Private variables ---------------------------------------------------------*/
+TIM_HandleTypeDef SensorWatchdogTimHandle;
+
+static SensorWatchdogStateType watchdogStates[FCB_SENSOR_NBR];
+static const char* sensorNames[FCB_SENSOR_NBR] = { "gyro", "acc", "mag", "baro" };
+
+/* Private function prototypes -----------------------------------------------*/
+static void recoverSensor(FcbSensorIndexType sensor, FcbSensorRecoveryType step);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Computes the sensor timeouts and starts the watchdog timer
+ * @param  None
+ * @retval FCB_OK if the timer was started, else FCB_ERR_INIT
+ */
+FcbRetValType SensorWatchdogInit(void) {
+    SensorWatchdogStateType* state;
+    uint32_t now = HAL_GetTick();
+    uint32_t interval;
+    uint8_t sensor;
+
+    for (sensor = 0; sensor < FCB_SENSOR_NBR; sensor++) {
+        state = &watchdogStates[sensor];
+        memset(state, 0, sizeof(SensorWatchdogStateType));
+
+        interval = GetSensorDrdyInterval((FcbSensorIndexType) sensor);
+        if (interval > 0) {
+            state->stats.timeout = (SENSOR_WATCHDOG_MISSED_SAMPLES * interval + 999) / 1000;
+        } else {
+            state->stats.timeout = SENSOR_WATCHDOG_BARO_TIMEOUT;
+        }
+        if (state->stats.timeout < SENSOR_WATCHDOG_MIN_TIMEOUT) {
+            state->stats.timeout = SENSOR_WATCHDOG_MIN_TIMEOUT;
+        }
+
+        state->lastSampleTick = now;
+        state->stats.isHealthy = true;
+    }
+
+    SensorWatchdogTimHandle.Instance = SENSOR_WATCHDOG_TIM;
+    SensorWatchdogTimHandle.Init.Period = SENSOR_WATCHDOG_PERIOD * (SENSOR_WATCHDOG_TIM_RATE / 1000) - 1;
+    SensorWatchdogTimHandle.Init.Prescaler = SystemCoreClock / SENSOR_WATCHDOG_TIM_RATE - 1;
+    SensorWatchdogTimHandle.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    SensorWatchdogTimHandle.Init.CounterMode = TIM_COUNTERMODE_UP;
+    SensorWatchdogTimHandle.Init.RepetitionCounter = 0;
+
+    if (HAL_OK != HAL_TIM_Base_Init(&SensorWatchdogTimHandle)
+            || HAL_OK != HAL_TIM_Base_Start_IT(&SensorWatchdogTimHandle)) {
+        return FCB_ERR_INIT;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Checks that every sensor has given a sample within its timeout.
+ *         An unhealthy sensor gets its next recovery step once per timeout.
+ * @param  None
+ * @retval None
+ */
+void SensorWatchdogCheck(void) {
+    SensorWatchdogStateType* state;
+    uint32_t now = HAL_GetTick();
+    uint32_t samples, stall;
+    uint8_t sensor;
+
+    for (sensor = 0; sensor < FCB_SENSOR_NBR; sensor++) {
+        state = &watchdogStates[sensor];
+        samples = state->samples;
+        stall = now - state->lastSampleTick;
+
+        if (samples != state->checkedSamples) {
+            state->checkedSamples = samples;
+            state->lastSampleTick = now;
+            if (!state->stats.isHealthy) {
+#if DIAG_ENABLED(SENSORS, DIAG_ERROR)
+                LOG2("Sensor %lu recovered after %lu ms", (uint32_t) sensor, stall);
+#endif
+                taskENTER_CRITICAL();
+                state->stats.isHealthy = true;
+                state->stats.unhealthyTime += stall;
+                if (stall > state->stats.maxStall) {
+                    state->stats.maxStall = stall;
+                }
+                taskEXIT_CRITICAL();
+            }
+            continue;
+        }
+
+        if (stall <= state->stats.timeout) {
+            continue;
+        }
+
+        if (state->stats.isHealthy) {
+#if DIAG_ENABLED(SENSORS, DIAG_ERROR)
+            LOG1("ERROR: sensor %lu stalled, see get-sensor-rates", (uint32_t) sensor);
+#endif
+            taskENTER_CRITICAL();
+            state->stats.isHealthy = false;
+            state->stats.stalls++;
+            taskEXIT_CRITICAL();
+            state->stalls++;
+            state->nextRecovery = SENSOR_RECOVERY_REARM;
+        } else if (now - state->lastRecoveryTick < state->stats.timeout) {
+            continue;
+        }
+
+        if (BARO_IDX == sensor) {
+            /* restarts itself, see CheckBarometerTimeout */
+            continue;
+        }
+
+        if (GYRO_IDX == sensor && stall > SENSOR_WATCHDOG_GYRO_MAX_STALL) {
+            ErrorHandler();
+        }
+
+        recoverSensor((FcbSensorIndexType) sensor, (FcbSensorRecoveryType) state->nextRecovery);
+        taskENTER_CRITICAL();
+        state->stats.recoveries[state->nextRecovery]++;
+        taskEXIT_CRITICAL();
+        state->lastRecoveryTick = now;
+        state->nextRecovery = (state->nextRecovery + 1) % SENSOR_RECOVERY_NBR;
+    }
+}
+
+RAMFUNC void SensorWatchdogFeed(FcbSensorIndexType sensor) {
+    if (sensor < FCB_SENSOR_NBR) {
+        watchdogStates[sensor].samples++;
+    }
+}
+
+void SensorWatchdogTimerElapsedFromISR(void) {
+    FcbSendSensorMessageFromISR(FCB_SENSOR_WATCHDOG_TICK);
+}
+
+bool IsSensorHealthy(FcbSensorIndexType sensor) {
+    if (sensor >= FCB_SENSOR_NBR) {
+        return false;
+    }
+
+    return watchdogStates[sensor].stats.isHealthy;
+}
+
+uint32_t GetSensorStalls(FcbSensorIndexType sensor) {
+    if (sensor >= FCB_SENSOR_NBR) {
+        return 0;
+    }
+
+    return watchdogStates[sensor].stalls;
+}
+
+void GetSensorWatchdogStats(FcbSensorIndexType sensor, FcbSensorWatchdogStatsType * dstStats) {
+    if (sensor >= FCB_SENSOR_NBR) {
+        memset(dstStats, 0, sizeof(FcbSensorWatchdogStatsType));
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    *dstStats = watchdogStates[sensor].stats;
+    taskEXIT_CRITICAL();
+}
+
+void ResetSensorWatchdogStats(void) {
+    FcbSensorWatchdogStatsType* stats;
+    uint8_t sensor;
+
+    for (sensor = 0; sensor < FCB_SENSOR_NBR; sensor++) {
+        stats = &watchdogStates[sensor].stats;
+
+        taskENTER_CRITICAL();
+        stats->stalls = 0;
+        memset(stats->recoveries, 0, sizeof(stats->recoveries));
+        stats->unhealthyTime = 0;
+        stats->maxStall = 0;
+        taskEXIT_CRITICAL();
+    }
+}
+
+size_t PrintSensorWatchdogStats(char * dst, const size_t dstSize) {
+    FcbSensorWatchdogStatsType stats;
+    size_t length;
+    uint8_t sensor;
+
+    length = (size_t) snprintf(dst, dstSize, "\nSensor watchdog\n%-6s%8s%12s%8s%8s%8s%8s%14s%13s\n", "Sensor",
+            "Health", "Timeout[ms]", "Stalls", "Rearms", "Resets", "BusRst", "Unhealthy[ms]", "MaxStall[ms]");
+
+    for (sensor = 0; sensor < FCB_SENSOR_NBR && length < dstSize; sensor++) {
+        GetSensorWatchdogStats((FcbSensorIndexType) sensor, &stats);
+        length += (size_t) snprintf(dst + length, dstSize - length, "%-6s%8s%12u%8u%8u%8u%8u%14u%13u\n",
+                sensorNames[sensor], stats.isHealthy ? "ok" : "STALL", (unsigned int) stats.timeout,
+                (unsigned int) stats.stalls, (unsigned int) stats.recoveries[SENSOR_RECOVERY_REARM],
+                (unsigned int) stats.recoveries[SENSOR_RECOVERY_RESET],
+                (unsigned int) stats.recoveries[SENSOR_RECOVERY_BUS], (unsigned int) stats.unhealthyTime,
+                (unsigned int) stats.maxStall);
+    }
+
+    return length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Runs a recovery step of the gyroscope, accelerometer or magnetometer
+ */
+static void recoverSensor(FcbSensorIndexType sensor, FcbSensorRecoveryType step) {
+    switch (sensor) {
+    case GYRO_IDX:
+        RecoverGyroscope(step);
+        break;
+    case ACC_IDX:
+    case MAG_IDX:
+        RecoverAccMagSensor(sensor, step);
+        break;
+    default:
+        break;
+    }
+}
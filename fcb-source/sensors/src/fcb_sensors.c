@@ -10,17 +10,38 @@
 #include "fcb_accelerometer_magnetometer.h"
 #include "fcb_gyroscope.h"
 #include "fcb_barometer.h"
+#include "fcb_sensor_filter.h"
+#include "fcb_rpm_filter.h"
+#include "fcb_dynamic_notch.h"
+#include "fcb_sensor_load_test.h"
+#include "fcb_sensor_watchdog.h"
+#include "fcb_sensor_self_test.h"
+#include "fcb_sensor_orientation.h"
+#include "fcb_sensor_timing.h"
+#include "fcb_vibration_monitor.h"
+#include "fcb_gps.h"
+#include "fcb_battery.h"
+#include "flight_control.h"
 #include "fcb_error.h"
+#include "task_watchdog.h"
 #include "fcb_retval.h"
+#include "common.h"
 #include "dragonfly_fcb.pb.h"
 #include "pb_encode.h"
 #include "usbd_cdc_if.h"
+#include "fixed_format.h"
+#include "trace_recorder.h"
+#include "wake_latency.h"
+#include "ccm_ram.h"
+#include "boot_timing.h"
+#include "fcb_diag.h"
+#include "lsm303dlhc.h"
 
 #include "arm_math.h"
 
 #include "FreeRTOS.h"
 #include "task.h"
-#include "queue.h"
+#include "semphr.h"
 
 #include <stdint.h>
 #include <stdbool.h>
@@ -28,31 +49,51 @@
 #include <stdio.h>
 
 /* Private define ------------------------------------------------------------*/
-#define FCB_SENSORS_DEBUG // Define to enable sensor debug functions
-
 #define PROCESS_SENSORS_TASK_PRIO					configMAX_PRIORITIES-1 // Max priority
+#ifdef FCB_FUSED_SENSOR_PIPELINE
+#define PROCESS_SENSORS_TASK_STACK_DEPTH			(6 * configMINIMAL_STACK_SIZE) // Runs the flight control too
+#else
+#define PROCESS_SENSORS_TASK_STACK_DEPTH			(4 * configMINIMAL_STACK_SIZE)
+#endif
 
-#define SENSOR_DRDY_TIMEOUT                         500 // [ms]
-#define SENSOR_ERROR_TIMEOUT                        2000 // [ms]
+#define SENSOR_ERROR_TIMEOUT                        2000 // [ms] without any event, the sensor watchdog ticks too
 
 #define	SENSOR_PRINT_MAX_STRING_SIZE				192
-#define SENSOR_PRINT_SAMPLING_TASK_PRIO				1
-#define SENSOR_PRINT_MINIMUM_SAMPLING_TIME			10 // [ms]
+
+/* Samples per data ready interrupt, the FIFO modes interrupt at the FIFO watermark */
+#ifdef FCB_GYRO_FIFO_MODE
+#define GYRO_SAMPLES_PER_DRDY                       GYRO_FIFO_WATERMARK
+#else
+#define GYRO_SAMPLES_PER_DRDY                       1
+#endif
+#ifdef FCB_ACC_FIFO_MODE
+#define ACC_SAMPLES_PER_DRDY                        ACC_FIFO_WATERMARK
+#else
+#define ACC_SAMPLES_PER_DRDY                        1
+#endif
+#define MAG_SAMPLES_PER_DRDY                        1
 
 /* Private typedef -----------------------------------------------------------*/
 
 /**
- * Messages sent to the SENSORS queue
+ * Pending flags of the SENSORS task, one bit per FcbSensorEvent.
  *
- * The messages are sent as uin8_t under the assumption that
- * less than 255 different kinds of messages will ever be
- * needed.
+ * Repeated events of a kind collapse into one bit, so signalling can't
+ * overflow no matter how many DRDY interrupts arrive before the task runs.
  *
- * @see FcbSensorEvent
+ * @see _SensorEventBit
  */
-typedef struct FcbSensorMsg {
-    uint8_t event;
-} FcbSensorMsgType;
+enum {
+    SENSOR_EVENT_GYRO_DMA_COMPLETE_BIT = 0x01,
+    SENSOR_EVENT_GYRO_DATA_READY_BIT = 0x02,
+    SENSOR_EVENT_ACCMAG_READ_COMPLETE_BIT = 0x04,
+    SENSOR_EVENT_ACC_DATA_READY_BIT = 0x08,
+    SENSOR_EVENT_MAGNETO_DATA_READY_BIT = 0x10,
+    SENSOR_EVENT_BAR_DATA_READY_BIT = 0x20,
+    SENSOR_EVENT_BAR_READ_COMPLETE_BIT = 0x40,
+    SENSOR_EVENT_WATCHDOG_TICK_BIT = 0x80,
+    SENSOR_EVENT_TIMING_CHANGE_BIT = 0x100
+};
 
 /* Private macro -------------------------------------------------------------*/
 
@@ -60,32 +101,48 @@ typedef struct FcbSensorMsg {
 /* static data declarations */
 
 static xTaskHandle hSensorsTask;
-static xQueueHandle qFcbSensors = NULL;
+#ifdef FCB_CCM_RAM
+static portSTACK_TYPE sensorsTaskStack[PROCESS_SENSORS_TASK_STACK_DEPTH] CCM_RAM; /* instead of the FreeRTOS heap */
+#endif
+static xSemaphoreHandle semFcbSensors = NULL; /* given whenever a pending bit is set */
+static volatile uint32_t fcbSensorEventsPending = 0;
+static volatile uint32_t sensorDrdyTimestamp[FCB_SENSOR_NBR]; /* [core clock cycles] */
 
 uint8_t sensorSampleRateDone = 0;
 
+/* The interval statistics are written by the data ready ISR of the sensor only, and cleared in a critical section */
 typedef struct FcbSensorDataRateCalc {
-    uint32_t lastDrdyTime;      // [ms]
+    bool hasDrdyTimestamp;      // lastDrdyTimestamp is set
+    uint32_t lastDrdyTimestamp; // [core clock cycles]
+    uint32_t nominalInterval;   // [core clock cycles], 0 until the sensor is initialised
+    uint32_t drdys;
+    uint32_t intervals;         // Nominal intervals in intervalSum, a missed interrupt adds one
+    uint64_t intervalSum;       // [core clock cycles]
+    uint32_t missedDrdys;
+    uint32_t readFailures;
+    uint32_t jitterIntervals;   // Intervals without missed interrupts, measured against nominalInterval
+    int64_t deviationSum;       // Of the intervals from nominalInterval [core clock cycles]
+    uint64_t deviationSquaredSum; // [core clock cycles^2]
+    uint32_t minInterval;       // [core clock cycles]
+    uint32_t maxInterval;       // [core clock cycles]
 } FcbSensorDataRateCalcType;
 
 static FcbSensorDataRateCalcType sensorDrdyCalc[FCB_SENSOR_NBR] = { { 0} };
-
-/* Task handle for printing of sensor values task */
-xTaskHandle SensorPrintSamplingTaskHandle = NULL;
-static volatile uint16_t sensorPrintSampleTime;
-static volatile uint16_t sensorPrintSampleDuration;
+static float32_t sensorNominalRateHz[FCB_SENSOR_NBR] = { 0.0 };
+static const uint8_t sensorSamplesPerDrdy[FCB_SENSOR_NBR] = { GYRO_SAMPLES_PER_DRDY, ACC_SAMPLES_PER_DRDY,
+        MAG_SAMPLES_PER_DRDY, 1 };
+static const char* sensorNames[FCB_SENSOR_NBR] = { "gyro", "acc", "mag", "baro" };
 
 /* Private function prototypes -----------------------------------------------*/
 static void _ProcessSensorValues(void*);
-static void _FetchSensorAtTimeout(uint8_t event);
-
-static void _DebugFlashLEDs(uint8_t event);
-static void _SensorPrintSamplingTask(void const *argument);
+static uint32_t _SensorEventBit(uint8_t event);
+static void _UpdateSensorDataRateFromISR(FcbSensorIndexType sensor, uint32_t timestamp);
+static float32_t _MeasuredDataRateHz(const FcbSensorDataRateCalcType* calc, FcbSensorIndexType sensor);
 
 /* Exported functions --------------------------------------------------------*/
 
 /*
- * @brief  Initialises the sensor processing queue and thread
+ * @brief  Initialises the sensor processing semaphore and thread
  * @param  None
  * @retval FCB_OK if thread started, else FCB_ERR
  */
@@ -93,104 +150,292 @@ int FcbSensorsConfig(void) {
     portBASE_TYPE rtosRetVal;
     int retVal = FCB_OK;
 
-    if (0 == (qFcbSensors = xQueueCreate(FCB_SENSORS_QUEUE_SIZE, FCB_SENSORS_Q_MSG_SIZE))) {
+    vSemaphoreCreateBinary(semFcbSensors);
+    if (NULL == semFcbSensors) {
         ErrorHandler();
         retVal = FCB_ERR_INIT;
     }
-
-    if (pdPASS != (rtosRetVal = xTaskCreate((pdTASK_CODE )_ProcessSensorValues, (signed portCHAR*)"SENSORS",
-                    4 * configMINIMAL_STACK_SIZE, NULL /* parameter */,PROCESS_SENSORS_TASK_PRIO /* priority */,
-                    &hSensorsTask))) {
+    xSemaphoreTake(semFcbSensors, 0); /* created given, start with nothing pending */
+    TRACE_OBJECT_NAME(semFcbSensors, "qFcbSensors");
+
+#ifdef FCB_CCM_RAM
+    CcmRamRegisterObject("SENSORS stack", sensorsTaskStack, sizeof(sensorsTaskStack));
+    rtosRetVal = xTaskGenericCreate((pdTASK_CODE )_ProcessSensorValues, (signed portCHAR*)"SENSORS",
+            PROCESS_SENSORS_TASK_STACK_DEPTH, NULL /* parameter */, PROCESS_SENSORS_TASK_PRIO /* priority */,
+            &hSensorsTask, sensorsTaskStack, NULL);
+#else
+    rtosRetVal = xTaskCreate((pdTASK_CODE )_ProcessSensorValues, (signed portCHAR*)"SENSORS",
+            PROCESS_SENSORS_TASK_STACK_DEPTH, NULL /* parameter */, PROCESS_SENSORS_TASK_PRIO /* priority */,
+            &hSensorsTask);
+#endif
+    if (pdPASS != rtosRetVal) {
         ErrorHandler();
         retVal = FCB_ERR_INIT;
     }
 
-    return retVal;
-}
-
-bool GetSensorDrdyCalcIndex(uint8_t event, uint32_t *index) {
-    bool retVal = true;
-	switch (event) {
-    case FCB_SENSOR_GYRO_DATA_READY:
-    	*index = GYRO_IDX;
-        break;
-    case FCB_SENSOR_ACC_DATA_READY:
-    	*index = ACC_IDX;
-        break;
-    case FCB_SENSOR_MAGNETO_DATA_READY:
-    	*index = MAG_IDX;
-        break;
-    default:
-        retVal = false;
-        break;
+    /* The kernel objects the sensors use later are created now, from the heap, the SENSORS task allocates none */
+    if (FCB_OK != FcbInitAccMagCalibrationSolver()) {
+        retVal = FCB_ERR_INIT;
     }
 
-	return retVal;
+    return retVal;
 }
 
 /*
- * @brief  Handles data ready interrupt from each sensor, adds sensor read request message to queue
+ * @brief  Handles data ready interrupt from each sensor, flags the sensor read
+ *         request as pending and wakes the SENSORS task
  * @param  event : Sensor data ready event enum
  * @retval None
  */
 void FcbSendSensorMessageFromISR(uint8_t event) {
-    FcbSensorMsgType msg = { 0 };
     portBASE_TYPE higherPriorityTaskWoken = pdFALSE;
+    unsigned portBASE_TYPE savedInterruptStatus;
+    uint32_t eventBit = _SensorEventBit(event);
 
-#ifdef FCB_SENSORS_DEBUG
-    _DebugFlashLEDs(event);
-#endif
+    if (0 == eventBit) {
+        return;
+    }
 
-    uint32_t sensorDrdyCalcIndex = 0;
-    if (!GetSensorDrdyCalcIndex(event, &sensorDrdyCalcIndex)) {
-    	return;
+    /* sensor ISRs may nest, so the read-modify-write must be masked */
+    savedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+    if (fcbSensorEventsPending & eventBit) {
+        SENSOR_LOAD_TEST_COUNT_DROP(SENSOR_LOAD_DROP_SENSOR_EVENT);
     }
+    fcbSensorEventsPending |= eventBit;
+    if (eventBit & (SENSOR_EVENT_GYRO_DMA_COMPLETE_BIT | SENSOR_EVENT_GYRO_DATA_READY_BIT)) {
+        WakeLatencySignal(WAKE_LATENCY_ISR_TO_SENSORS, GetTimestamp());
+    }
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(savedInterruptStatus);
 
-    msg.event = event;
-    sensorDrdyCalc[sensorDrdyCalcIndex].lastDrdyTime = HAL_GetTick();
+    /* fails harmlessly if already given - the task then handles this event on the pending wake-up */
+    xSemaphoreGiveFromISR(semFcbSensors, &higherPriorityTaskWoken);
 
-    if (pdTRUE != xQueueSendFromISR(qFcbSensors, &msg, &higherPriorityTaskWoken)) {
-        if(pdFALSE != xQueueIsQueueFullFromISR(qFcbSensors)) {
-            // If the queue is full, empty it
-            xQueueReset(qFcbSensors);
+    portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
 
-            // Then add a message of each event type
-            msg.event = FCB_SENSOR_GYRO_DATA_READY;
-            if (pdTRUE != xQueueSendFromISR(qFcbSensors, &msg, &higherPriorityTaskWoken)) {
-                ErrorHandler();
-            }
+/*
+ * @brief  Flags a sensor read request as pending, e.g. to retry a failed read
+ * @param  event : Sensor read data event enum
+ * @retval None
+ */
+void FcbSendSensorMessage(uint8_t event) {
+    uint32_t eventBit = _SensorEventBit(event);
 
-            msg.event = FCB_SENSOR_ACC_DATA_READY;
-            if (pdTRUE != xQueueSendFromISR(qFcbSensors, &msg, &higherPriorityTaskWoken)) {
-                ErrorHandler();
-            }
+    if (0 == eventBit) {
+        return;
+    }
 
-            msg.event = FCB_SENSOR_MAGNETO_DATA_READY;
-            if (pdTRUE != xQueueSendFromISR(qFcbSensors, &msg, &higherPriorityTaskWoken)) {
-                ErrorHandler();
-            }
-        } else {
-            ErrorHandler();
-        }
+    taskENTER_CRITICAL();
+    if (fcbSensorEventsPending & eventBit) {
+        SENSOR_LOAD_TEST_COUNT_DROP(SENSOR_LOAD_DROP_SENSOR_EVENT);
     }
+    fcbSensorEventsPending |= eventBit;
+    taskEXIT_CRITICAL();
 
-    portYIELD_FROM_ISR(higherPriorityTaskWoken);
+    xSemaphoreGive(semFcbSensors);
 }
 
 /*
- * @brief  Adds sensor read request message to queue
- * @param  event : Sensor read data event enum
+ * @brief  Records the time of a sensor data ready interrupt
+ * @param  sensor : Sensor index
  * @retval None
  */
-void FcbSendSensorMessage(uint8_t event) {
-    FcbSensorMsgType msg = { 0 };
-    uint8_t status;
+void FcbSensorDrdyTimestampFromISR(FcbSensorIndexType sensor) {
+    uint32_t timestamp = GetTimestamp();
 
-    msg.event = event;
+    if (sensor < FCB_SENSOR_NBR) {
+        sensorDrdyTimestamp[sensor] = timestamp;
+        _UpdateSensorDataRateFromISR(sensor, timestamp);
+    }
+}
 
-    if (pdTRUE != (status = xQueueSend(qFcbSensors, &msg, portMAX_DELAY))) {
-        ErrorHandler();
+/*
+ * @brief  Gets the time of the latest data ready interrupt of a sensor
+ * @param  sensor : Sensor index
+ * @retval Timestamp [core clock cycles]
+ */
+uint32_t GetSensorDrdyTimestamp(FcbSensorIndexType sensor) {
+    if (sensor < FCB_SENSOR_NBR) {
+        return sensorDrdyTimestamp[sensor];
+    }
+
+    return GetTimestamp();
+}
+
+/*
+ * @brief  Counts a failed sample read of a sensor
+ * @param  sensor : Sensor index
+ * @retval None
+ */
+void FcbSensorReadFailed(FcbSensorIndexType sensor) {
+    if (sensor < FCB_SENSOR_NBR) {
+        taskENTER_CRITICAL();
+        sensorDrdyCalc[sensor].readFailures++;
+        taskEXIT_CRITICAL();
+    }
+}
+
+/*
+ * @brief  Counts a failed sample read of a sensor from an ISR
+ * @param  sensor : Sensor index
+ * @retval None
+ */
+void FcbSensorReadFailedFromISR(FcbSensorIndexType sensor) {
+    unsigned portBASE_TYPE savedInterruptStatus;
+
+    if (sensor < FCB_SENSOR_NBR) {
+        savedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+        sensorDrdyCalc[sensor].readFailures++;
+        portCLEAR_INTERRUPT_MASK_FROM_ISR(savedInterruptStatus);
+    }
+}
+
+/*
+ * @brief  Gets the data rate of a sensor, the measured one if it is based on at least SENSOR_RATE_MIN_INTERVALS
+ *         intervals and within SENSOR_RATE_MAX_DEVIATION of the nominal one, else the nominal one
+ * @param  sensor : Sensor index
+ * @retval Data rate [Hz], 0 if the sensor is not initialised yet
+ */
+float32_t GetSensorDataRateHz(FcbSensorIndexType sensor) {
+    FcbSensorDataRateStatsType stats;
+
+    GetSensorDataRateStats(sensor, &stats);
+
+    return stats.isMeasuredRateUsed ? stats.measuredRateHz : stats.nominalRateHz;
+}
+
+/*
+ * @brief  Gets the nominal time between the data ready interrupts of a sensor
+ * @param  sensor : Sensor index
+ * @retval Interval [us], 0 if the sensor has no nominal data rate
+ */
+uint32_t GetSensorDrdyInterval(FcbSensorIndexType sensor) {
+    if (sensor >= FCB_SENSOR_NBR || sensorNominalRateHz[sensor] <= 0.0f) {
+        return 0;
+    }
+
+    return (uint32_t) (1000000.0f * sensorSamplesPerDrdy[sensor] / sensorNominalRateHz[sensor]);
+}
+
+/*
+ * @brief  Gets the data rate statistics of a sensor
+ * @param  sensor : Sensor index
+ * @param  stats : Destination statistics
+ * @retval None
+ */
+void GetSensorDataRateStats(FcbSensorIndexType sensor, FcbSensorDataRateStatsType* stats) {
+    FcbSensorDataRateCalcType calc;
+    float32_t cyclesPerUs = (float32_t) SystemCoreClock / 1000000.0f;
+    float32_t meanDeviation, variance;
+
+    memset(stats, 0, sizeof(FcbSensorDataRateStatsType));
+    if (sensor >= FCB_SENSOR_NBR) {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    calc = sensorDrdyCalc[sensor];
+    taskEXIT_CRITICAL();
+
+    stats->nominalRateHz = sensorNominalRateHz[sensor];
+    stats->measuredRateHz = _MeasuredDataRateHz(&calc, sensor);
+    stats->isMeasuredRateUsed = calc.intervals >= SENSOR_RATE_MIN_INTERVALS && stats->nominalRateHz > 0.0f
+            && fabsf(stats->measuredRateHz - stats->nominalRateHz) <= SENSOR_RATE_MAX_DEVIATION*stats->nominalRateHz;
+    stats->drdys = calc.drdys;
+    stats->missedDrdys = calc.missedDrdys;
+    stats->readFailures = calc.readFailures;
+
+    if (calc.intervals > 0) {
+        stats->meanInterval = (uint32_t) ((float32_t) calc.intervalSum / calc.intervals / cyclesPerUs);
+    }
+    if (calc.jitterIntervals > 0) {
+        stats->minInterval = (uint32_t) (calc.minInterval / cyclesPerUs);
+        stats->maxInterval = (uint32_t) (calc.maxInterval / cyclesPerUs);
+        meanDeviation = (float32_t) calc.deviationSum / calc.jitterIntervals;
+        variance = (float32_t) calc.deviationSquaredSum / calc.jitterIntervals - meanDeviation*meanDeviation;
+        stats->jitter = (variance > 0.0f) ? (uint32_t) (sqrtf(variance) / cyclesPerUs) : 0;
+    }
+}
+
+/*
+ * @brief  Clears the data rate statistics of all sensors
+ * @param  None
+ * @retval None
+ */
+void ResetSensorDataRateStats(void) {
+    FcbSensorDataRateCalcType* calc;
+    uint8_t sensor;
+
+    for (sensor = 0; sensor < FCB_SENSOR_NBR; sensor++) {
+        calc = &sensorDrdyCalc[sensor];
+
+        /* The timestamp of the latest interrupt is kept so that the next interval is measured */
+        taskENTER_CRITICAL();
+        calc->drdys = 0;
+        calc->intervals = 0;
+        calc->intervalSum = 0;
+        calc->missedDrdys = 0;
+        calc->readFailures = 0;
+        calc->jitterIntervals = 0;
+        calc->deviationSum = 0;
+        calc->deviationSquaredSum = 0;
+        calc->minInterval = 0;
+        calc->maxInterval = 0;
+        taskEXIT_CRITICAL();
+    }
+}
+
+/*
+ * @brief  Prints the data rate statistics of all sensors as a table
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @retval Length of the table string
+ */
+size_t PrintSensorDataRateStats(char* dst, const size_t dstSize) {
+    FcbSensorDataRateStatsType stats;
+    char nominalString[16], measuredString[16];
+    size_t length;
+    uint8_t sensor;
+
+    length = (size_t) snprintf(dst, dstSize, "\nSensor data rates\n%-6s%12s%13s%6s%11s%11s%9s%9s%9s%8s%10s\n",
+            "Sensor", "Nominal[Hz]", "Measured[Hz]", "Used", "Period[us]", "Jitter[us]", "Min[us]", "Max[us]",
+            "DRDYs", "Missed", "ReadFail");
+
+    for (sensor = 0; sensor < FCB_SENSOR_NBR && length < dstSize; sensor++) {
+        GetSensorDataRateStats((FcbSensorIndexType) sensor, &stats);
+        FormatFixed(nominalString, sizeof(nominalString), stats.nominalRateHz, 2);
+        FormatFixed(measuredString, sizeof(measuredString), stats.measuredRateHz, 2);
+        length += (size_t) snprintf(dst + length, dstSize - length, "%-6s%12s%13s%6s%11lu%11lu%9lu%9lu%9lu%8lu%10lu\n",
+                sensorNames[sensor], nominalString, measuredString, stats.isMeasuredRateUsed ? "meas" : "nom",
+                stats.meanInterval, stats.jitter, stats.minInterval, stats.maxInterval, stats.drdys,
+                stats.missedDrdys, stats.readFailures);
+    }
+
+    return length;
+}
+
+/*
+ * @brief  Stores the nominal data rates of the sensors, so that the data ready ISRs can detect missed interrupts
+ * @param  None
+ * @retval None
+ */
+void UpdateSensorDataRates(void) {
+    uint8_t sensor;
+
+    sensorNominalRateHz[GYRO_IDX] = (float32_t) GyroDataRateHz();
+    sensorNominalRateHz[ACC_IDX] = (float32_t) LSM303DLHC_AccDataRateHz();
+    sensorNominalRateHz[MAG_IDX] = LSM303DLHC_MagDataRateHz();
+
+    /* The barometer is polled by a timer and has no data ready interrupt */
+    for (sensor = 0; sensor < BARO_IDX; sensor++) {
+        taskENTER_CRITICAL();
+        sensorDrdyCalc[sensor].nominalInterval = (uint32_t) ((float32_t) SystemCoreClock
+                * sensorSamplesPerDrdy[sensor] / sensorNominalRateHz[sensor]);
+        taskEXIT_CRITICAL();
     }
+
+    /* The intervals while the sensors were configured are not representative */
+    ResetSensorDataRateStats();
 }
 
 void FcbSensorsInitGpioPinForInterrupt(GPIO_TypeDef  *GPIOx, uint32_t pin) {
@@ -204,30 +449,116 @@ void FcbSensorsInitGpioPinForInterrupt(GPIO_TypeDef  *GPIOx, uint32_t pin) {
 
 /* Private functions ---------------------------------------------------------*/
 
-static void _FetchSensorAtTimeout(uint8_t event) {
-    uint32_t sensorDrdyCalcIndex;
-    if (!GetSensorDrdyCalcIndex(event, &sensorDrdyCalcIndex)) {
-    	// Not a valid event.
-    	return;
-    }
-
-    // lastDrdyTime must be read before HAL_GetTick(), as lastDrdyTime is updated from a ISR.
-	// Else lastDrdyTime could be increased after HAL_GetTick() and timeSinceDrdy < 0.
-	uint32_t lastDrdyTime = sensorDrdyCalc[sensorDrdyCalcIndex].lastDrdyTime;
-	uint32_t timeSinceDrdy = HAL_GetTick() - lastDrdyTime;
-	if (timeSinceDrdy > SENSOR_ERROR_TIMEOUT) {
-		ErrorHandler();
-	} else if (timeSinceDrdy > SENSOR_DRDY_TIMEOUT) {
-		FetchDataFromGyroscope();
-	}
+/*
+ * Measures the interval since the previous data ready interrupt of a sensor.
+ * An interval longer than 1.5 nominal intervals has missed interrupts, it is
+ * counted as that many nominal intervals and is left out of the jitter.
+ */
+static void _UpdateSensorDataRateFromISR(FcbSensorIndexType sensor, uint32_t timestamp) {
+    FcbSensorDataRateCalcType* calc = &sensorDrdyCalc[sensor];
+    uint32_t interval = timestamp - calc->lastDrdyTimestamp;
+    uint32_t nominalInterval = calc->nominalInterval;
+    uint32_t missed;
+    int32_t deviation;
+
+    calc->drdys++;
+    calc->lastDrdyTimestamp = timestamp;
+    if (!calc->hasDrdyTimestamp) {
+        calc->hasDrdyTimestamp = true;
+        return;
+    }
+
+    if (nominalInterval > 0 && interval > nominalInterval + nominalInterval/2) {
+        missed = (interval + nominalInterval/2) / nominalInterval - 1;
+        calc->missedDrdys += missed;
+        calc->intervals += missed + 1;
+        calc->intervalSum += interval;
+        return;
+    }
+
+    calc->intervals++;
+    calc->intervalSum += interval;
+
+    if (nominalInterval > 0) {
+        deviation = (int32_t) (interval - nominalInterval);
+        calc->deviationSum += deviation;
+        calc->deviationSquaredSum += (uint64_t) ((int64_t) deviation * deviation);
+        if (0 == calc->jitterIntervals || interval < calc->minInterval) {
+            calc->minInterval = interval;
+        }
+        if (interval > calc->maxInterval) {
+            calc->maxInterval = interval;
+        }
+        calc->jitterIntervals++;
+    }
+}
+
+/*
+ * Gets the measured samples per second of a sensor, 0 if no interval is measured
+ */
+static float32_t _MeasuredDataRateHz(const FcbSensorDataRateCalcType* calc, FcbSensorIndexType sensor) {
+    if (0 == calc->intervalSum) {
+        return 0.0;
+    }
+
+    return (float32_t) ((float64_t) SystemCoreClock * sensorSamplesPerDrdy[sensor] * calc->intervals
+            / calc->intervalSum);
+}
+
+/*
+ * Maps a FcbSensorEvent to its pending bit, 0 if no such event
+ */
+static uint32_t _SensorEventBit(uint8_t event) {
+    switch (event) {
+    case FCB_SENSOR_GYRO_DMA_COMPLETE:
+        return SENSOR_EVENT_GYRO_DMA_COMPLETE_BIT;
+    case FCB_SENSOR_GYRO_DATA_READY:
+        return SENSOR_EVENT_GYRO_DATA_READY_BIT;
+    case FCB_SENSOR_ACC_READ_COMPLETE:
+    case FCB_SENSOR_MAGNETO_READ_COMPLETE:
+        return SENSOR_EVENT_ACCMAG_READ_COMPLETE_BIT; /* only one acc/mag read is ongoing at a time */
+    case FCB_SENSOR_ACC_DATA_READY:
+        return SENSOR_EVENT_ACC_DATA_READY_BIT;
+    case FCB_SENSOR_MAGNETO_DATA_READY:
+        return SENSOR_EVENT_MAGNETO_DATA_READY_BIT;
+    case FCB_SENSOR_BAR_DATA_READY:
+        return SENSOR_EVENT_BAR_DATA_READY_BIT;
+    case FCB_SENSOR_BAR_READ_COMPLETE:
+        return SENSOR_EVENT_BAR_READ_COMPLETE_BIT;
+    case FCB_SENSOR_WATCHDOG_TICK:
+        return SENSOR_EVENT_WATCHDOG_TICK_BIT;
+    case FCB_SENSOR_TIMING_CHANGE:
+        return SENSOR_EVENT_TIMING_CHANGE_BIT;
+    default:
+        return 0;
+    }
 }
 
 static void _ProcessSensorValues(void* val __attribute__ ((unused))) {
     /*
      * configures the sensors to start giving Data Ready interrupts
-     * and then polls the queue in an infinite loop
+     * and then pends on the pending events in an infinite loop
      */
-    FcbSensorMsgType msg;
+    uint32_t events;
+#ifdef FCB_SENSOR_LOAD_TEST
+    uint32_t runStart;
+#endif
+
+#if defined(FCB_GPS) && !defined(GPS_INPUT_IS_DRONECAN)
+    /* first, its configuration blocks for a few hundred ms and the sensors would miss their samples */
+    if (FCB_OK != FcbInitialiseGps()) {
+        ErrorHandler();
+    }
+#endif
+
+#ifdef FCB_BATTERY_MONITOR
+    if (FCB_OK != FcbInitialiseBattery()) {
+        ErrorHandler();
+    }
+#endif
+
+    /* before the sensors, which fuse the rotation into their calibrations */
+    SensorOrientationInit();
 
     if (FCB_OK != InitialiseGyroscope()) {
         ErrorHandler();
@@ -241,108 +572,102 @@ static void _ProcessSensorValues(void* val __attribute__ ((unused))) {
     	ErrorHandler();
     }
 
+    /* the stored data rates and bandwidths, before anything takes the data rates */
+    SensorTimingInit();
+
+    /* after the sensors as the stored coefficients depend on their data rates */
+    SensorFilterInit();
+#ifdef FCB_RPM_FILTER
+    RpmFilterInit();
+#endif
+#ifdef FCB_DYNAMIC_NOTCH
+    if (FCB_OK != DynamicNotchInit()) {
+        ErrorHandler();
+    }
+#endif
+    UpdateSensorDataRates();
+    VibrationMonitorInit();
+    if (FCB_OK != SensorSelfTestInit()) {
+        ErrorHandler();
+    }
+    if (FCB_OK != SensorWatchdogInit()) {
+        ErrorHandler();
+    }
+    BootTimingMark(BOOT_PHASE_SENSORS_INIT);
+    TaskWatchdogRegister(TASK_WATCHDOG_SENSORS);
+
     while (1) {
-        if (pdFALSE == xQueueReceive(qFcbSensors, &msg,  SENSOR_ERROR_TIMEOUT)) {
+        if (pdFALSE == xSemaphoreTake(semFcbSensors, SENSOR_ERROR_TIMEOUT)) {
             /*
-             * if no message was received, interrupts from the sensors
+             * if no event was signalled, interrupts from the sensors
              * aren't arriving and this is a serious error.
              */
             ErrorHandler();
         }
+        TaskWatchdogCheckIn(TASK_WATCHDOG_SENSORS);
+
+#ifdef FCB_SENSOR_LOAD_TEST
+        runStart = GetTimestamp();
+#endif
+
+        taskENTER_CRITICAL();
+        WakeLatencyWoken(WAKE_LATENCY_ISR_TO_SENSORS);
+        events = fcbSensorEventsPending;
+        fcbSensorEventsPending = 0;
+        taskEXIT_CRITICAL();
 
-        switch (msg.event) {
-        case FCB_SENSOR_GYRO_DATA_READY:
+        /* gyro first as it feeds the attitude rate estimate */
+        if (events & SENSOR_EVENT_GYRO_DMA_COMPLETE_BIT) {
+            FetchDMADataFromGyroscope();
+        }
+        if (events & SENSOR_EVENT_GYRO_DATA_READY_BIT) {
             FetchDataFromGyroscope();
-            break;
-        case FCB_SENSOR_ACC_DATA_READY:
-            FetchDataFromAccelerometer();
-            break;
-        case FCB_SENSOR_MAGNETO_DATA_READY:
-            FetchDataFromMagnetometer();
-            break;
-        case FCB_SENSOR_BAR_DATA_READY:
-        	FetchDataFromBarometer();
-        	break;
+        }
+#ifdef FCB_FUSED_SENSOR_PIPELINE
+        /* Estimation, control and motor update on the new gyroscope sample before the slower sensors */
+        RunFusedFlightControl();
+#endif
+        if (events & SENSOR_EVENT_ACCMAG_READ_COMPLETE_BIT) {
+            HandleAccMagReadComplete();
+        }
+        if (events & SENSOR_EVENT_ACC_DATA_READY_BIT) {
+            RequestDataFromAccelerometer();
+        }
+        if (events & SENSOR_EVENT_MAGNETO_DATA_READY_BIT) {
+            RequestDataFromMagnetometer();
+        }
+        if (events & SENSOR_EVENT_BAR_READ_COMPLETE_BIT) {
+            HandleBarometerReadComplete();
+        }
+        if (events & SENSOR_EVENT_BAR_DATA_READY_BIT) {
+            RequestDataFromBarometer();
         }
 
-        /* Check for sensor data ready read timeouts */
-        _FetchSensorAtTimeout(FCB_SENSOR_GYRO_DATA_READY);
-        _FetchSensorAtTimeout(FCB_SENSOR_ACC_DATA_READY);
-        _FetchSensorAtTimeout(FCB_SENSOR_MAGNETO_DATA_READY);
+        /* Recovery of the sensors that stopped giving samples */
+        if (events & SENSOR_EVENT_WATCHDOG_TICK_BIT) {
+            SensorWatchdogCheck();
+            CheckBarometerTimeout();
+            SensorSelfTestUpdate();
+        }
 
-    }
-}
+        /* Reconfiguration in idle mode, after the samples of this wake-up */
+        if (events & SENSOR_EVENT_TIMING_CHANGE_BIT) {
+            ApplySensorTiming();
+        }
 
-static void _DebugFlashLEDs(uint8_t event) {
-    static uint32_t acc_cbk_sensor_counter = 0;
-    static uint32_t mag_cbk_sensor_counter = 0;
-    static uint32_t gyro_cbk_sensor_counter = 0;
-
-    if(event == FCB_SENSOR_ACC_DATA_READY) {
-    	if ((acc_cbk_sensor_counter % 200) == 0) {
-    		BSP_LED_Toggle(LED5);
-    	}
-    	acc_cbk_sensor_counter++;
-    } else if(event == FCB_SENSOR_MAGNETO_DATA_READY) {
-    	if ((mag_cbk_sensor_counter % 200) == 0) {
-    		BSP_LED_Toggle(LED3);
-    	}
-    	mag_cbk_sensor_counter++;
-    } else if(event == FCB_SENSOR_GYRO_DATA_READY) {
-    	if ((gyro_cbk_sensor_counter % 200) == 0) {
-    		BSP_LED_Toggle(LED4);
-    	}
-    	gyro_cbk_sensor_counter++;
+#ifdef FCB_FUSED_SENSOR_PIPELINE
+        /* Corrections with the samples of the slower sensors */
+        RunFusedFlightControl();
+#endif
+
+#ifdef FCB_SENSOR_LOAD_TEST
+        SensorLoadTestSensorsTaskRun(GetTimestamp() - runStart);
+#endif
     }
 }
 
 /* Debug Print functions ---------------------------------------------------------*/
 
-/*
- * @brief  Creates a task to sample print sensor values over USB
- * @param  sampleTime : Sets how often samples should be printed
- * @param  sampleDuration : Sets for how long sampling should be performed
- * @retval FCB_OK if thread started, else FCB_ERR
- */
-FcbRetValType StartSensorSamplingTask(const uint16_t sampleTime, const uint32_t sampleDuration) {
-  if(sampleTime < SENSOR_PRINT_MINIMUM_SAMPLING_TIME)
-    sensorPrintSampleTime = SENSOR_PRINT_MINIMUM_SAMPLING_TIME;
-  else
-    sensorPrintSampleTime = sampleTime;
-
-  sensorPrintSampleDuration = sampleDuration;
-
-  /* Sensor value print sampling handler thread creation
-   * Task function pointer: SensorPrintSamplingTask
-   * Task name: SENS_PRINT_SAMPL
-   * Stack depth: 2*configMINIMAL_STACK_SIZE
-   * Parameter: NULL
-   * Priority: SENSOR_PRINT_SAMPLING_TASK_PRIO (0 to configMAX_PRIORITIES-1 possible)
-   * Handle: SensorPrintSamplingTaskHandle
-   * */
-  if (pdPASS != xTaskCreate((pdTASK_CODE )_SensorPrintSamplingTask, (signed portCHAR*)"SENS_PRINT_SAMPL",
-      3*configMINIMAL_STACK_SIZE, NULL, SENSOR_PRINT_SAMPLING_TASK_PRIO, &SensorPrintSamplingTaskHandle)) {
-    ErrorHandler();
-    return FCB_ERR;
-  }
-
-  return FCB_OK;
-}
-
-/*
- * @brief  Stops sensor print sampling by deleting the task
- * @param  None
- * @retval FCB_OK if task deleted, FCB_ERR if not
- */
-FcbRetValType StopSensorSamplingTask(void) {
-  if(SensorPrintSamplingTaskHandle != NULL) {
-    vTaskDelete(SensorPrintSamplingTaskHandle);
-    SensorPrintSamplingTaskHandle = NULL;
-    return FCB_OK;
-  }
-  return FCB_ERR;
-}
-
 /**
  * @brief  Prints the latest sensor values to the USB com port
  * @param  none
@@ -350,45 +675,18 @@ FcbRetValType StopSensorSamplingTask(void) {
  */
 void PrintSensorValues(void) {
   char sensorString[SENSOR_PRINT_MAX_STRING_SIZE];
-  float32_t accX, accY, accZ, gyroX, gyroY, gyroZ, magX, magY, magZ;
+  float32_t sensorValues[9];
 
   /* Get the latest sensor values */
-  GetAcceleration(&accX, &accY, &accZ);
-  GetGyroAngleDot(&gyroX, &gyroY, &gyroZ);
-  GetMagVector(&magX, &magY, &magZ);
+  GetAcceleration(&sensorValues[0], &sensorValues[1], &sensorValues[2]);
+  GetGyroAngleDot(&sensorValues[3], &sensorValues[4], &sensorValues[5]);
+  GetMagVector(&sensorValues[6], &sensorValues[7], &sensorValues[8]);
 
-  snprintf((char*) sensorString, SENSOR_PRINT_MAX_STRING_SIZE,
-          "AccXYZ: %f, %f, %f\r\nGyrXYZ: %f, %f, %f\r\nMagXYZ: %f, %f, %f\n\r\n",
-          accX, accY, accZ, gyroX, gyroY, gyroZ, magX, magY, magZ);
+  FormatFixedList(sensorString, SENSOR_PRINT_MAX_STRING_SIZE,
+          "AccXYZ: %f, %f, %f\r\nGyrXYZ: %f, %f, %f\r\nMagXYZ: %f, %f, %f\n\r\n", sensorValues, 9);
   USBComSendString(sensorString);
 }
 
-/**
- * @brief  Task code handles sensor print sampling
- * @param  argument : Unused parameter
- * @retval None
- */
-static void _SensorPrintSamplingTask(void const *argument) {
-  (void) argument;
-
-  portTickType xLastWakeTime;
-  portTickType xSampleStartTime;
-
-  /* Initialise the xLastWakeTime variable with the current time */
-  xLastWakeTime = xTaskGetTickCount();
-  xSampleStartTime = xLastWakeTime;
-
-  for (;;) {
-    vTaskDelayUntil(&xLastWakeTime, sensorPrintSampleTime);
-
-    PrintSensorValues();
-
-    /* If sampling duration exceeded, delete task to stop sampling */
-    if (xTaskGetTickCount() >= xSampleStartTime + sensorPrintSampleDuration * configTICK_RATE_HZ)
-      StopSensorSamplingTask();
-  }
-}
-
 /**
  * @}
  */
@@ -0,0 +1,298 @@
+/******************************************************************************
+ * @file    fcb_vibration_monitor.c
+ * @author  Dragonfly
+ * @brief   Implementation of interface publicised in fcb_vibration_monitor.h
+ ******************************************************************************/
+
+#include "fcb_vibration_monitor.h"
+#include "telemetry_aggregate.h"
+#include "control_executive.h"
+#include "fixed_format.h"
+#include "ccm_ram.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+/* Private define ------------------------------------------------------------*/
+#define VIBRATION_CLIP_RAW_LIMIT    ((int16_t) (VIBRATION_CLIP_MARGIN * INT16_MAX))
+
+enum {
+    VIBRATION_AXES_N = 3
+};
+
+/* Private typedef -----------------------------------------------------------*/
+
+/**
+ * Running statistics of a sensor, written by the context updating the sensor
+ * only, and cleared in a critical section
+ */
+typedef struct VibrationMonitorState {
+    bool isActive;              /* set by VibrationMonitorInit */
+    float32_t highPassAlpha;    /* per sample, of the low-pass subtracted from the sample */
+    float32_t rmsAlpha;         /* per sample, of the variance and clip rate averages */
+    float32_t mean[VIBRATION_AXES_N];
+    float32_t variance[VIBRATION_AXES_N];
+    float32_t maxVariance;
+    float32_t clipRate;
+    uint32_t clips[VIBRATION_AXES_N];
+    uint32_t samples;
+} VibrationMonitorStateType;
+
+/* Private variables ---------------------------------------------------------*/
+static VibrationMonitorStateType vibrationStates[FCB_SENSOR_NBR] CCM_RAM; /* gyroscope and accelerometer only */
+static const char* sensorNames[FCB_SENSOR_NBR] = { "gyro", "acc", "mag", "baro" };
+
+/* Private function prototypes -----------------------------------------------*/
+static RAMFUNC float32_t maxAxisVariance(const VibrationMonitorStateType * state);
+static RAMFUNC uint8_t healthScore(FcbSensorIndexType sensor, float32_t maxRms, float32_t clipRate);
+static RAMFUNC void aggregateVibration(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Sets the running statistics coefficients from the nominal data rates
+ * @param  None
+ * @retval None
+ */
+void VibrationMonitorInit(void) {
+    VibrationMonitorStateType* state;
+    float32_t rateHz;
+    uint8_t sensor;
+
+    CcmRamRegisterObject("vibrationStates", vibrationStates, sizeof(vibrationStates));
+
+    for (sensor = GYRO_IDX; sensor <= ACC_IDX; sensor++) {
+        state = &vibrationStates[sensor];
+        rateHz = GetSensorDataRateHz((FcbSensorIndexType) sensor);
+        if (rateHz <= 0.0f) {
+            continue;
+        }
+
+        memset(state, 0, sizeof(VibrationMonitorStateType));
+        state->highPassAlpha = 1.0f - expf(-2.0f * PI * VIBRATION_HIGH_PASS_CUTOFF / rateHz);
+        state->rmsAlpha = 1.0f - expf(-1.0f / (VIBRATION_RMS_TIME_CONSTANT * rateHz));
+        state->isActive = true; /* last, the gyroscope may be updated from the control executive */
+    }
+}
+
+RAMFUNC uint8_t VibrationClippedAxes(const float32_t * sample, const float32_t fullScale) {
+    float32_t const limit = VIBRATION_CLIP_MARGIN * fullScale;
+    uint8_t clippedAxes = 0;
+    uint8_t axis;
+
+    for (axis = 0; axis < VIBRATION_AXES_N; axis++) {
+        if (sample[axis] >= limit || sample[axis] <= -limit) {
+            clippedAxes |= (uint8_t) (1 << axis);
+        }
+    }
+
+    return clippedAxes;
+}
+
+RAMFUNC uint8_t VibrationClippedAxesRaw(const int16_t * rawData) {
+    uint8_t clippedAxes = 0;
+    uint8_t axis;
+
+    for (axis = 0; axis < VIBRATION_AXES_N; axis++) {
+        if (rawData[axis] >= VIBRATION_CLIP_RAW_LIMIT || rawData[axis] <= -VIBRATION_CLIP_RAW_LIMIT) {
+            clippedAxes |= (uint8_t) (1 << axis);
+        }
+    }
+
+    return clippedAxes;
+}
+
+/*
+ * @brief  Updates the running statistics of a sensor with a sample
+ * @param  sensor : GYRO_IDX or ACC_IDX
+ * @param  sample : Three axes, not filtered
+ * @param  clippedAxes : Bit mask of the clipped axes
+ * @retval None
+ */
+RAMFUNC void VibrationMonitorUpdate(FcbSensorIndexType sensor, const float32_t * sample, const uint8_t clippedAxes) {
+    VibrationMonitorStateType* state;
+    float32_t highPassed, variance;
+    uint8_t axis;
+
+    if (sensor > ACC_IDX || !vibrationStates[sensor].isActive) {
+        return;
+    }
+    state = &vibrationStates[sensor];
+
+    for (axis = 0; axis < VIBRATION_AXES_N; axis++) {
+        if (state->samples == 0) {
+            state->mean[axis] = sample[axis]; /* no step at the start */
+        }
+        state->mean[axis] += state->highPassAlpha * (sample[axis] - state->mean[axis]);
+        highPassed = sample[axis] - state->mean[axis];
+        state->variance[axis] += state->rmsAlpha * (highPassed * highPassed - state->variance[axis]);
+
+        if (clippedAxes & (1 << axis)) {
+            state->clips[axis]++;
+        }
+    }
+
+    state->clipRate += state->rmsAlpha * ((clippedAxes ? 1.0f : 0.0f) - state->clipRate);
+    state->samples++;
+
+    variance = maxAxisVariance(state);
+    if (variance > state->maxVariance) {
+        state->maxVariance = variance;
+    }
+
+    if (ACC_IDX == sensor) {
+        aggregateVibration();
+    }
+}
+
+RAMFUNC float32_t GetVibrationVariance(FcbSensorIndexType sensor) {
+    if (sensor > ACC_IDX) {
+        return 0.0f;
+    }
+
+    return vibrationStates[sensor].variance[0] + vibrationStates[sensor].variance[1]
+            + vibrationStates[sensor].variance[2];
+}
+
+RAMFUNC bool IsVibrationClipping(FcbSensorIndexType sensor) {
+    if (sensor > ACC_IDX) {
+        return false;
+    }
+
+    return vibrationStates[sensor].clipRate > VIBRATION_CLIPPING_RATE;
+}
+
+void GetVibrationStats(FcbSensorIndexType sensor, FcbVibrationStatsType * dstStats) {
+    VibrationMonitorStateType state;
+    uint8_t axis;
+
+    memset(dstStats, 0, sizeof(FcbVibrationStatsType));
+    if (sensor > ACC_IDX) {
+        return;
+    }
+
+    /* the control executive updates the gyroscope above the critical section */
+#ifdef FCB_CONTROL_EXECUTIVE
+    ControlExecutiveSuspend();
+#endif
+    taskENTER_CRITICAL();
+    state = vibrationStates[sensor];
+    taskEXIT_CRITICAL();
+#ifdef FCB_CONTROL_EXECUTIVE
+    ControlExecutiveResume();
+#endif
+
+    for (axis = 0; axis < VIBRATION_AXES_N; axis++) {
+        dstStats->rms[axis] = sqrtf(state.variance[axis]);
+        dstStats->clips[axis] = state.clips[axis];
+    }
+    dstStats->maxRms = sqrtf(state.maxVariance);
+    dstStats->samples = state.samples;
+    dstStats->clipRate = state.clipRate;
+    dstStats->health = healthScore(sensor, sqrtf(maxAxisVariance(&state)), state.clipRate);
+}
+
+void ResetVibrationStats(void) {
+    uint8_t sensor;
+
+#ifdef FCB_CONTROL_EXECUTIVE
+    ControlExecutiveSuspend();
+#endif
+    for (sensor = GYRO_IDX; sensor <= ACC_IDX; sensor++) {
+        taskENTER_CRITICAL();
+        memset(vibrationStates[sensor].clips, 0, sizeof(vibrationStates[sensor].clips));
+        vibrationStates[sensor].maxVariance = 0.0f;
+        taskEXIT_CRITICAL();
+    }
+#ifdef FCB_CONTROL_EXECUTIVE
+    ControlExecutiveResume();
+#endif
+}
+
+size_t PrintVibrationStats(char * dst, const size_t dstSize) {
+    FcbVibrationStatsType stats;
+    char rmsStrings[VIBRATION_AXES_N + 1][16], clipRateString[16];
+    size_t length;
+    uint8_t sensor, axis;
+
+    length = (size_t) snprintf(dst, dstSize, "\nVibration\n%-6s%10s%10s%10s%10s%9s%9s%9s%12s%8s\n", "Sensor", "RmsX",
+            "RmsY", "RmsZ", "MaxRms", "ClipsX", "ClipsY", "ClipsZ", "ClipRate[%]", "Health");
+
+    for (sensor = GYRO_IDX; sensor <= ACC_IDX && length < dstSize; sensor++) {
+        GetVibrationStats((FcbSensorIndexType) sensor, &stats);
+        for (axis = 0; axis < VIBRATION_AXES_N; axis++) {
+            FormatFixed(rmsStrings[axis], sizeof(rmsStrings[axis]), stats.rms[axis], 3);
+        }
+        FormatFixed(rmsStrings[VIBRATION_AXES_N], sizeof(rmsStrings[VIBRATION_AXES_N]), stats.maxRms, 3);
+        FormatFixed(clipRateString, sizeof(clipRateString), 100.0f * stats.clipRate, 2);
+        length += (size_t) snprintf(dst + length, dstSize - length, "%-6s%10s%10s%10s%10s%9u%9u%9u%12s%8u\n",
+                sensorNames[sensor], rmsStrings[0], rmsStrings[1], rmsStrings[2], rmsStrings[VIBRATION_AXES_N],
+                (unsigned int) stats.clips[0], (unsigned int) stats.clips[1], (unsigned int) stats.clips[2],
+                clipRateString, (unsigned int) stats.health);
+    }
+
+    if (length < dstSize) {
+        length += (size_t) snprintf(dst + length, dstSize - length,
+                "RMS of the samples high-passed at %u Hz, gyro [rad/s], acc [m/s^2]\n",
+                (unsigned int) VIBRATION_HIGH_PASS_CUTOFF);
+    }
+
+    return length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+static RAMFUNC float32_t maxAxisVariance(const VibrationMonitorStateType * state) {
+    float32_t variance = state->variance[0];
+
+    if (state->variance[1] > variance) {
+        variance = state->variance[1];
+    }
+    if (state->variance[2] > variance) {
+        variance = state->variance[2];
+    }
+
+    return variance;
+}
+
+/*
+ * Health score from the vibration of the worst axis and the clip rate, 0 to 100
+ */
+static RAMFUNC uint8_t healthScore(FcbSensorIndexType sensor, float32_t maxRms, float32_t clipRate) {
+    float32_t const good = (GYRO_IDX == sensor) ? VIBRATION_GYRO_GOOD_RMS : VIBRATION_ACC_GOOD_RMS;
+    float32_t const bad = (GYRO_IDX == sensor) ? VIBRATION_GYRO_BAD_RMS : VIBRATION_ACC_BAD_RMS;
+    float32_t score;
+
+    score = (bad - maxRms) / (bad - good);
+    score *= 1.0f - clipRate / VIBRATION_MAX_CLIP_RATE;
+
+    if (score <= 0.0f || maxRms >= bad || clipRate >= VIBRATION_MAX_CLIP_RATE) {
+        return 0;
+    } else if (score >= 1.0f) {
+        return 100;
+    }
+
+    return (uint8_t) (100.0f * score);
+}
+
+/*
+ * Samples the vibration of both sensors and the lower health score to the
+ * telemetry aggregates, at the accelerometer rate in the SENSORS task
+ */
+static RAMFUNC void aggregateVibration(void) {
+    float32_t values[3];
+    float32_t gyroRms = sqrtf(maxAxisVariance(&vibrationStates[GYRO_IDX]));
+    float32_t accRms = sqrtf(maxAxisVariance(&vibrationStates[ACC_IDX]));
+    uint8_t gyroHealth = healthScore(GYRO_IDX, gyroRms, vibrationStates[GYRO_IDX].clipRate);
+    uint8_t accHealth = healthScore(ACC_IDX, accRms, vibrationStates[ACC_IDX].clipRate);
+
+    values[0] = gyroRms;
+    values[1] = accRms;
+    values[2] = (float32_t) ((gyroHealth < accHealth) ? gyroHealth : accHealth);
+    AggregateSamples(AGGREGATE_VIBRATION_GYRO, values, 3);
+}
@@ -0,0 +1,45 @@
+/******************************************************************************
+ * @file    boot_timing.h
+ * @author  Dragonfly
+ * @brief   Header file for the boot phase timestamps. Each start up step marks
+ *          the time it completed, so that the time from power on to armable
+ *          can be split into the steps that took it. The times are measured
+ *          from InitTimestampCounter(), just after the system clock is set up.
+ ******************************************************************************/
+
+#ifndef __BOOT_TIMING_H
+#define __BOOT_TIMING_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported types ------------------------------------------------------------*/
+
+/* In the order they are expected to complete. The phases after the scheduler start run in parallel tasks. */
+typedef enum {
+	BOOT_PHASE_SYSTEM_INIT = 0,         // InitSystem() done, peripherals and kernel objects of the drivers
+	BOOT_PHASE_SCHEDULER_START,         // Tasks created, the scheduler is started
+	BOOT_PHASE_USB_START,               // USB device started, the host may enumerate it
+	BOOT_PHASE_SENSORS_INIT,            // Sensors configured, data ready interrupts running
+	BOOT_PHASE_ESTIMATOR_INIT,          // State estimation initialized from the first samples, the UAV is armable
+	BOOT_PHASE_NBR
+} BootPhase_TypeDef;
+
+/* Exported function prototypes --------------------------------------------- */
+void BootTimingMark(const BootPhase_TypeDef phase);
+bool GetBootPhaseTime(const BootPhase_TypeDef phase, uint64_t* dstTime);
+size_t BootTimingPrint(char* dst, const size_t dstSize);
+
+#endif /* __BOOT_TIMING_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,81 @@
+/******************************************************************************
+ * @file    buffer_monitor.h
+ * @author  Dragonfly
+ * @brief   Header file for the buffer occupancy monitor, which keeps the
+ *          high-water mark, the overflow count and the time at full of the
+ *          ring buffers, queues and mailboxes, so that they can be sized
+ *          from data. The producer of a buffer records its statistics, the
+ *          buffer registers them by name to be reported.
+ ******************************************************************************/
+
+#ifndef __BUFFER_MONITOR_H
+#define __BUFFER_MONITOR_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "pb_encode.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define BUFFER_MONITOR_MAX_BUFFERS  12      // Buffers registered beyond this are not reported
+#define BUFFER_NAME_LEN             12      // Reported names are cut to this
+
+/* The BUFFER_STATS_MSG_ENUM message, encoded without generated nanopb code:
+ *   message BufferStatsProto {
+ *     repeated BufferProto buffers = 1;            // As many as fit, the rest in the next message
+ *   }
+ *   message BufferProto {
+ *     optional string name = 1;
+ *     optional uint32 capacity = 2;                // [bytes or entries]
+ *     optional uint32 high_water = 3;              // Most stored since startup [bytes or entries]
+ *     optional uint32 overflows = 4;               // Puts that did not fit since startup
+ *     optional uint32 full_time = 5;               // Time the producer found no room since startup [ms]
+ *   } */
+
+/* Worst case size of a BufferProto submessage with its tag and length */
+#define BUFFER_MSG_MAX_SIZE         (1 + 1 + 2 + BUFFER_NAME_LEN + 2*(1 + 3) + 2*(1 + 5))
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Occupancy statistics of a buffer, written by its producer only */
+typedef struct {
+	uint16_t highWater;             // Most stored at a put [bytes or entries]
+	uint32_t overflows;             // Puts that did not fit, dropped by the RX paths or waited for by the TX paths
+	uint32_t fullTime;              // Sum of the full periods, from a put that did not fit to the next one that did [ms]
+	uint32_t fullSince;             // Start of the current full period [ms]
+	volatile bool isFull;
+} BufferStats_TypeDef;
+
+/* Reported status of a buffer */
+typedef struct {
+	char name[BUFFER_NAME_LEN + 1];
+	uint16_t capacity;              // [bytes or entries]
+	uint16_t highWater;             // [bytes or entries]
+	uint32_t overflows;
+	uint32_t fullTime;              // Including the current full period [ms]
+} BufferStatus_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported function prototypes --------------------------------------------- */
+void BufferMonitorRegister(const char* name, const uint16_t capacity, const BufferStats_TypeDef* stats);
+void BufferStatsReset(BufferStats_TypeDef* stats);
+void BufferStatsRecordLevel(BufferStats_TypeDef* stats, const uint16_t level);
+void BufferStatsRecordFull(BufferStats_TypeDef* stats);
+uint8_t GetBufferStatus(BufferStatus_TypeDef* dstStatus, const uint8_t maxBuffers);
+bool GetBufferStatusByIndex(const uint8_t index, BufferStatus_TypeDef* dstStatus);
+size_t BufferMonitorPrint(char* dst, const size_t dstSize);
+bool EncodeBufferStats(pb_ostream_t* stream);
+
+#endif /* __BUFFER_MONITOR_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,150 @@
+/******************************************************************************
+ * @file    can_bus.h
+ * @brief   Header file for the bxCAN driver, extended frames only. The frames
+ *          that pass the hardware filters of CanBusAddFilter() are received
+ *          to FIFO 1, whose interrupt only copies them to a queue for the
+ *          task of the protocol layer, see dronecan.h. TX mailbox 0 is
+ *          reserved for CanBusTransmitFromControl(), which the control path
+ *          calls without any FreeRTOS API and which never waits. The other
+ *          frames are queued and loaded into mailboxes 1 and 2 by the TX
+ *          mailbox empty interrupt. The peripheral sends the pending frame
+ *          with the highest priority identifier first.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __CAN_BUS_H
+#define __CAN_BUS_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "stm32f3xx_hal.h"
+
+#include "fcb_retval.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Uncomment when a CAN transceiver is connected to CAN_BUS_RX_PIN and CAN_BUS_TX_PIN, to run the DroneCAN node */
+//#define FCB_CAN_BUS
+
+#if defined(FCB_CAN_BUS) && (defined(USE_USB_COM) || defined(FCB_BENCHMARK_BUILD))
+#error "USB and bxCAN share the packet SRAM of the STM32F303, FCB_CAN_BUS needs the UART com port instead of USB"
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+
+/* bxCAN on PD0 (RX) and PD1 (TX). Its RX0 and TX interrupts share the vectors with the USB, so FIFO 1 is used. */
+#define CAN_BUS_CLK_ENABLE()            __CAN_CLK_ENABLE()
+#define CAN_BUS_GPIO_CLK_ENABLE()       __GPIOD_CLK_ENABLE()
+#define CAN_BUS_GPIO_PORT               GPIOD
+#define CAN_BUS_RX_PIN                  GPIO_PIN_0
+#define CAN_BUS_TX_PIN                  GPIO_PIN_1
+#define CAN_BUS_AF                      GPIO_AF7_CAN
+#define CAN_BUS_RX_IRQn                 CAN_RX1_IRQn
+#define CAN_BUS_RX_IRQHandler           CAN_RX1_IRQHandler
+#define CAN_BUS_TX_IRQn                 USB_HP_CAN_TX_IRQn
+#define CAN_BUS_TX_IRQHandler           USB_HP_CAN_TX_IRQHandler
+#define CAN_BUS_IRQ_PREEMPT_PRIO        11 // Below the sensor and control interrupts, at or below the syscall priority
+#define CAN_BUS_IRQ_SUB_PRIO            0
+
+/* 1 Mbit/s from the 36 MHz APB1 clock, 18 time quanta per bit and the sample point at 16/18 = 89 % */
+#define CAN_BUS_PRESCALER               2
+#define CAN_BUS_SJW                     CAN_SJW_1TQ
+#define CAN_BUS_BS1                     CAN_BS1_15TQ
+#define CAN_BUS_BS2                     CAN_BS2_2TQ
+
+#define CAN_BUS_RX_QUEUE_SIZE           32      // Frames, 4 ms of a fully loaded bus
+#define CAN_BUS_TX_QUEUE_SIZE           16      // Frames waiting for mailbox 1 or 2
+#define CAN_BUS_MAX_FILTERS             14      // Filter banks of the STM32F303, one per CanBusAddFilter()
+
+#define CAN_BUS_EXT_ID_MASK             0x1FFFFFFF
+#define CAN_BUS_MAX_DATA_LENGTH         8
+
+/* Exported types ------------------------------------------------------------*/
+
+typedef struct {
+    uint32_t id;                    // 29 bit extended identifier
+    uint8_t length;                 // [bytes] 0-8
+    uint8_t data[CAN_BUS_MAX_DATA_LENGTH];
+} CanFrame_TypeDef;
+
+typedef struct {
+    uint32_t framesReceived;        // Received frames that passed the filters
+    uint32_t framesSent;            // From all mailboxes
+    uint32_t rxOverruns;            // Frames lost to a full FIFO 1 or a full RX queue
+    uint32_t txQueueFull;           // Frames not queued by CanBusTransmit()
+    uint32_t controlDropped;        // Frames of CanBusTransmitFromControl() that found mailbox 0 busy
+    uint32_t txErrors;              // Mailbox requests completed without a successful transmission
+    uint8_t txErrorCounter;         // TEC
+    uint8_t rxErrorCounter;         // REC
+    uint8_t lastErrorCode;          // LEC, 0 no error
+    bool isErrorPassive;
+    bool isBusOff;                  // Recovers by itself after 128 occurrences of 11 recessive bits
+} CanBusStats_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+
+/**
+ * Configures the bxCAN, enables its interrupts and joins the bus. Nothing is
+ * received until a filter is added.
+ *
+ * @return FCB_OK, FCB_ERR_INIT if the peripheral did not leave its
+ *         initialisation mode or the RX queue could not be created
+ */
+FcbRetValType CanBusInit(void);
+
+/**
+ * Adds a 32 bit mask filter of extended data frames, in the next free filter
+ * bank.
+ *
+ * @param id identifier bits to match
+ * @param mask identifier bits that have to match id
+ * @return FCB_OK, FCB_ERR if all CAN_BUS_MAX_FILTERS banks are used
+ */
+FcbRetValType CanBusAddFilter(const uint32_t id, const uint32_t mask);
+
+/**
+ * Waits for a received frame. Called by one task only.
+ *
+ * @param dstFrame destination
+ * @param timeout [ticks] to wait
+ * @return true if a frame was received
+ */
+bool CanBusReceive(CanFrame_TypeDef* dstFrame, const uint32_t timeout);
+
+/**
+ * Queues a frame for mailbox 1 or 2, does not wait. Called from tasks.
+ *
+ * @param frame frame to send
+ * @return FCB_OK if queued, FCB_ERR if the TX queue is full
+ */
+FcbRetValType CanBusTransmit(const CanFrame_TypeDef* frame);
+
+/**
+ * Loads a frame into mailbox 0, unless the previous one is still pending,
+ * and does not wait. Uses no FreeRTOS API, called by the context that loads
+ * the motor outputs, which may be the control executive.
+ *
+ * @param frame frame to send
+ * @return true if loaded, false if dropped
+ */
+bool CanBusTransmitFromControl(const CanFrame_TypeDef* frame);
+
+void CanBusRxIRQHandler(void);
+void CanBusTxIRQHandler(void);
+void GetCanBusStats(CanBusStats_TypeDef* dstStats);
+size_t PrintCanBusStats(char* dst, const size_t dstSize);
+
+#endif /* __CAN_BUS_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,58 @@
+/******************************************************************************
+ * @file    ccm_ram.h
+ * @author  Dragonfly
+ * @brief   Header file for the placement of hot data in the core coupled
+ *          memory. The 8 KB CCM SRAM of the STM32F303 has no wait states and
+ *          is reached by the core only, so the control path data placed there
+ *          is never stalled by the USB, UART or sensor DMA transfers on the
+ *          bus matrix. For the same reason DMA buffers must never be placed
+ *          there.
+ ******************************************************************************/
+
+#ifndef __CCM_RAM_H
+#define __CCM_RAM_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Comment out to keep the CCM_RAM objects in the SRAM. The task stacks of the control path, the sensor rings and
+ * filters, the estimator, the controllers, the curve tables and the vibration and telemetry aggregate statistics take
+ * about 8 KB of the CCM SRAM, which the SRAM has to make up for then. The CCMRAM region and the .ccmram output section
+ * are in ldscripts/mem.ld and ldscripts/sections.ld. The section is not loaded and zeroed by InitCcmRam(), so only
+ * objects without initializers may be placed there. The linker reports an overflow of the region at link time, and
+ * the map file lists what landed where. */
+#define FCB_CCM_RAM
+
+#define CCM_RAM_BASE                0x10000000
+#define CCM_RAM_SIZE                (8*1024)
+
+/* Objects recorded for the placement report, see CcmRamRegisterObject() */
+#define CCM_RAM_MAX_OBJECTS         16
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported macro ------------------------------------------------------------*/
+#ifdef FCB_CCM_RAM
+#define CCM_RAM                     __attribute__((section(".ccmram")))
+#else
+#define CCM_RAM
+#endif /* FCB_CCM_RAM */
+
+/* Exported function prototypes --------------------------------------------- */
+void InitCcmRam(void);
+void CcmRamRegisterObject(const char* name, const void* address, const size_t size);
+size_t CcmRamPrint(char* dst, const size_t dstSize);
+
+#endif /* __CCM_RAM_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -12,8 +12,20 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f3xx.h"
+#include "fcb_retval.h"
 #include <arm_math.h>
+#include <stdbool.h>
 /* Exported constants --------------------------------------------------------*/
+
+/* Memory to memory DMA channel that feeds the CRC peripheral, see AccumulateCRCWithDMA() and StartCRCWithDMA() */
+#define CRC_DMA_CLK_ENABLE()			__DMA2_CLK_ENABLE()
+#define CRC_DMA_CHANNEL					DMA2_Channel1
+#define CRC_DMA_IRQn					DMA2_Channel1_IRQn
+#define CRC_DMA_IRQHandler				DMA2_Channel1_IRQHandler
+
+/* Below this size the CPU calculates a CRC faster than the DMA transfer is set up and waited for [bytes] */
+#define CRC_DMA_MIN_SIZE				64
+
 /* Exported types ------------------------------------------------------------*/
 /* Exported macro ------------------------------------------------------------*/
 
@@ -25,6 +37,14 @@
 /* Exported function prototypes --------------------------------------------- */
 void InitCRC(void);
 uint32_t CalculateCRC(const uint8_t* dataBuffer, const uint32_t dataBufferSize);
+uint32_t AccumulateCRC(const uint8_t* dataBuffer, const uint32_t dataBufferSize);
+uint32_t AccumulateCRCWithDMA(const uint8_t* dataBuffer, const uint32_t dataBufferSize);
+uint32_t ContinueCRC(const uint32_t crc, const uint8_t* dataBuffer, const uint32_t dataBufferSize);
+FcbRetValType StartCRCWithDMA(const uint32_t crc, const uint8_t* dataBuffer, const uint32_t dataBufferSize);
+FcbRetValType WaitCRCWithDMA(uint32_t* crc, const uint32_t timeout);
+bool IsCRCWithDMADone(void);
+FcbRetValType ContinueCRCWithDMA(uint32_t* crc, const uint8_t* dataBuffer, const uint32_t dataBufferSize);
+void CRCDmaIRQHandler(void);
 uint16_t UInt16Mean(const uint16_t* buffer, const uint16_t length);
 void ConfigPVD(void);
 void InitLEDs(void);
@@ -32,6 +52,13 @@ void LEDsOff(void);
 float32_t Radian2Degree(float32_t radian);
 void toMaxRadian(float32_t *radian);
 
+void InitTimestampCounter(void);
+uint32_t GetTimestamp(void);
+uint64_t GetTimestamp64(void);
+uint64_t GetMicroseconds(void);
+float32_t TimestampToSeconds(const uint32_t timestampDelta);
+uint32_t TimestampToMicroseconds(const uint32_t timestampDelta);
+
 #endif /* __COMMON_H */
 
 /**
@@ -0,0 +1,67 @@
+/******************************************************************************
+ * @file    cpu_headroom.h
+ * @author  Dragonfly
+ * @brief   Header file for the CPU headroom meter. The idle hook counts
+ *          fixed-length spin loops, which are compared with the count of the
+ *          same loop measured with nothing else running at startup. The ratio
+ *          is the share of the CPU left over for new work.
+ ******************************************************************************/
+
+#ifndef __CPU_HEADROOM_H
+#define __CPU_HEADROOM_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "pb_encode.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Spin iterations per idle hook call. The idle task loop around the hook is not part of the startup baseline, the
+ * longer the spin the smaller its share, about 2 % at 256 iterations. */
+#define CPU_HEADROOM_SPIN_LOOPS             256
+#define CPU_HEADROOM_CALIBRATION_TIME       20      // No-load baseline measurement at startup [ms]
+#define CPU_HEADROOM_SETTLE_TIME            5000    // Startup time not part of the minimum [ms]
+#define CPU_HEADROOM_LOW                    2000    // Headroom below this is low, shown by the heartbeat LED [0.01 %]
+
+/* The CPU_HEADROOM_MSG_ENUM message, encoded without generated nanopb code:
+ *   message CpuHeadroomProto {
+ *     optional uint32 headroom = 1;                // Over the last sample period [0.01 %]
+ *     optional uint32 min_headroom = 2;            // Least since CPU_HEADROOM_SETTLE_TIME after startup [0.01 %]
+ *     optional uint32 idle_loops = 3;              // Spin loops of the idle hook in the last sample period
+ *     optional uint32 baseline = 4;                // Spin loops per second with no load
+ *   } */
+
+#define CPU_HEADROOM_MSG_MAX_SIZE           (4*(1 + 5))
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+	uint16_t headroom;              // Over the last sample period [0.01 %]
+	uint16_t minHeadroom;           // Least since CPU_HEADROOM_SETTLE_TIME after startup [0.01 %]
+	uint32_t idleLoops;             // Spin loops in the last sample period
+	uint32_t baseline;              // Spin loops per second with no load
+} CpuHeadroom_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported function prototypes --------------------------------------------- */
+void CalibrateCpuHeadroom(void);
+void CpuHeadroomIdleHook(void);
+void UpdateCpuHeadroom(void);
+void GetCpuHeadroom(CpuHeadroom_TypeDef* dstHeadroom);
+bool IsCpuHeadroomLow(void);
+size_t CpuHeadroomPrint(char* dst, const size_t dstSize);
+bool EncodeCpuHeadroom(pb_ostream_t* stream);
+
+#endif /* __CPU_HEADROOM_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
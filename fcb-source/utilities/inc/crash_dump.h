@@ -0,0 +1,129 @@
+/******************************************************************************
+ * @file    crash_dump.h
+ * @author  Dragonfly
+ * @brief   Header file for the crash dump. A hard fault or a call of
+ *          ErrorHandler() stores the fault frame, the fault status registers,
+ *          the current task, the stack above the fault frame and the newest
+ *          log entries in RAM that is not initialized at startup, and resets
+ *          the board. At the next startup the dump is copied to the settings
+ *          store in flash, where it is kept until it is cleared. A task that
+ *          misses its watchdog deadline is dumped the same way from the
+ *          context it was switched out with, and the IWDG resets the board,
+ *          see task_watchdog.h.
+ ******************************************************************************/
+
+#ifndef __CRASH_DUMP_H
+#define __CRASH_DUMP_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "deferred_log.h"
+#include "pb_encode.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define CRASH_DUMP_STACK_WORDS          16      // Stack words above the fault frame
+#define CRASH_DUMP_LOG_ENTRIES          8       // Newest log entries
+#define CRASH_DUMP_TASK_NAME_LEN        16      // configMAX_TASK_NAME_LEN
+
+/* A crash this soon after startup is a quick crash. After CRASH_DUMP_MAX_QUICK_CRASHES quick crashes in a row the board
+ * is not reset anymore but stopped with all LEDs on, so that a failure at startup does not reset it over and over, or
+ * reset to the ROM bootloader with FCB_QUICK_CRASH_BOOTLOADER, see firmware_update.h. */
+#define CRASH_DUMP_QUICK_CRASH_TIME     5000    // [ms]
+#define CRASH_DUMP_MAX_QUICK_CRASHES    3
+
+/* The CRASH_DUMP_MSG_ENUM message, encoded without generated nanopb code. The first message holds the dump without its
+ * log entries, then one message per log entry follows.
+ *   message CrashDumpProto {
+ *     optional uint32 cause = 1;                   // CrashCause_TypeDef, 0 if there is no dump
+ *     optional uint32 crashes = 2;                 // Crashes since the dump was last cleared
+ *     optional uint32 uptime = 3;                  // Time from startup to the crash [ms]
+ *     repeated uint32 registers = 4 [packed=true]; // R0, R1, R2, R3, R12, LR, PC, xPSR of the fault frame
+ *     optional uint32 exc_return = 5;              // LR at the fault handler entry, 0 for ErrorHandler()
+ *     optional uint32 sp = 6;                      // Stack pointer after the fault frame
+ *     repeated uint32 fault_status = 7 [packed=true]; // CFSR, HFSR, DFSR, AFSR, MMFAR, BFAR
+ *     optional string task = 8;                    // Task running at the crash, empty before the scheduler started
+ *     repeated uint32 stack = 9 [packed=true];     // Stack words above the fault frame
+ *     optional string log_entry = 10;              // A formatted log entry, in the messages after the first
+ *   } */
+
+/* Worst case size of a CrashDumpProto message with the dump, and with a log entry */
+#define CRASH_DUMP_MSG_MAX_SIZE         (3*(1 + 5) + 2*(2 + 8*5) + 2*(1 + 5) + 2 + CRASH_DUMP_TASK_NAME_LEN \
+        + 2 + CRASH_DUMP_STACK_WORDS*5)
+#define CRASH_DUMP_LOG_MSG_MAX_SIZE     (2 + LOG_LINE_MAX_SIZE)
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+	CRASH_CAUSE_NONE = 0,
+	CRASH_CAUSE_HARD_FAULT,
+	CRASH_CAUSE_ERROR_HANDLER,
+	CRASH_CAUSE_WATCHDOG            // The task missed its deadline, the registers are of its saved context
+} CrashCause_TypeDef;
+
+typedef enum {
+	CRASH_REG_R0 = 0,
+	CRASH_REG_R1,
+	CRASH_REG_R2,
+	CRASH_REG_R3,
+	CRASH_REG_R12,
+	CRASH_REG_LR,
+	CRASH_REG_PC,
+	CRASH_REG_PSR,
+	CRASH_REG_NBR
+} CrashRegister_TypeDef;
+
+typedef enum {
+	CRASH_FAULT_CFSR = 0,           // Configurable fault status, MMFSR, BFSR and UFSR
+	CRASH_FAULT_HFSR,               // Hard fault status
+	CRASH_FAULT_DFSR,               // Debug fault status
+	CRASH_FAULT_AFSR,               // Auxiliary fault status
+	CRASH_FAULT_MMFAR,              // Memory management fault address, valid if CFSR MMARVALID
+	CRASH_FAULT_BFAR,               // Bus fault address, valid if CFSR BFARVALID
+	CRASH_FAULT_NBR
+} CrashFaultRegister_TypeDef;
+
+/* Stored in RAM and in the settings store, keep it word aligned and within FLASH_SETTINGS_MAX_RECORD_SIZE */
+typedef struct {
+	uint32_t magic;                 // CRASH_DUMP_MAGIC for a dump, written after the rest
+	uint32_t firmwareId;            // Of the firmware that crashed, the log formats are in its flash
+	uint32_t cause;                 // CrashCause_TypeDef
+	uint32_t crashes;
+	uint32_t uptime;                // [ms]
+	uint32_t registers[CRASH_REG_NBR];
+	uint32_t excReturn;
+	uint32_t stackPointer;
+	uint32_t faultStatus[CRASH_FAULT_NBR];
+	char taskName[CRASH_DUMP_TASK_NAME_LEN];
+	uint32_t stack[CRASH_DUMP_STACK_WORDS];
+	uint32_t stackWords;            // Valid words of stack
+	LogEntry_TypeDef logEntries[CRASH_DUMP_LOG_ENTRIES]; // Oldest first
+	uint32_t logEntriesNbr;
+	uint32_t checksum;              // Of the words before it, see CrashDumpChecksum()
+} CrashDump_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported function prototypes --------------------------------------------- */
+void InitCrashDump(void);
+void CrashDumpFromFault(uint32_t* faultStack, const uint32_t excReturn);
+void CrashDumpFromError(const uint32_t returnAddress);
+void CrashDumpFromWatchdog(void* task);
+bool GetCrashDump(CrashDump_TypeDef* dump);
+void ClearCrashDump(void);
+size_t CrashDumpPrint(char* dst, const size_t dstSize, const CrashDump_TypeDef* dump);
+size_t CrashDumpPrintLogEntry(char* dst, const size_t dstSize, const CrashDump_TypeDef* dump, const uint8_t entryIdx);
+bool EncodeCrashDump(pb_ostream_t* stream, const CrashDump_TypeDef* dump);
+bool EncodeCrashDumpLogEntry(pb_ostream_t* stream, const CrashDump_TypeDef* dump, const uint8_t entryIdx);
+
+#endif /* __CRASH_DUMP_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
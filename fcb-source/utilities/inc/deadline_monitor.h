@@ -0,0 +1,95 @@
+/******************************************************************************
+ * @file    deadline_monitor.h
+ * @author  Dragonfly
+ * @brief   Header file for the control loop deadline monitor, which checks
+ *          the period and the execution time of the periodic loops of the
+ *          flight control task against their expected period, and keeps
+ *          jitter, overrun and worst-case execution time statistics
+ ******************************************************************************/
+
+#ifndef __DEADLINE_MONITOR_H
+#define __DEADLINE_MONITOR_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "arm_math.h"
+#include "pb_encode.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* An update that starts more than this share of the expected period late has missed its deadline */
+#define DEADLINE_LATE_MARGIN        50      // [%]
+
+/* A loop is flagged for this long after its last overrun */
+#define DEADLINE_FLAG_HOLD_TIME     1000    // [ms]
+
+/* The DEADLINE_STATS_MSG_ENUM message, encoded without generated nanopb code:
+ *   message DeadlineStatsProto {
+ *     optional uint32 overrun_flags = 1;           // See GetDeadlineOverrunFlags()
+ *     optional uint32 core_clock = 2;              // [Hz], to convert the cycles to time
+ *     repeated DeadlineLoopProto loops = 3;        // The monitored loops
+ *   }
+ *   message DeadlineLoopProto {
+ *     optional uint32 loop = 1;                    // DeadlineLoop_TypeDef
+ *     optional uint32 expected_period = 2;         // [core clock cycles]
+ *     optional uint32 periods = 3;                 // Number of measured periods
+ *     optional uint32 max_period = 4;              // [core clock cycles]
+ *     optional uint32 max_jitter = 5;              // [core clock cycles]
+ *     optional uint32 late_starts = 6;
+ *     optional uint32 long_executions = 7;
+ *     optional uint32 wcet = 8;                    // [core clock cycles]
+ *   } */
+
+/* Worst case size of a DeadlineLoopProto submessage with its tag and length, and of the whole message */
+#define DEADLINE_LOOP_MSG_MAX_SIZE  (1 + 1 + 8*(1 + 5))
+#define DEADLINE_STATS_MSG_MAX_SIZE (2*(1 + 5) + DEADLINE_LOOP_NBR*DEADLINE_LOOP_MSG_MAX_SIZE)
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Periodic loops of the flight control task */
+typedef enum {
+	DEADLINE_LOOP_INNER = 0,        // Rate loop of PID_USE_CASCADED_RATE_CONTROL, UpdateRateControl()
+	DEADLINE_LOOP_OUTER,            // Flight control update, UpdateFlightControl()
+	DEADLINE_LOOP_ESTIMATOR,        // State prediction, with the gyroscope correction in FCB_GYRO_SYNCHRONOUS_PIPELINE
+	DEADLINE_LOOP_NBR
+} DeadlineLoop_TypeDef;
+
+typedef struct {
+	uint32_t expectedPeriod;        // [core clock cycles], 0 if the loop is not monitored
+	uint32_t periods;               // Number of measured periods, from one update start to the next
+	uint32_t minPeriod;             // [core clock cycles]
+	uint32_t maxPeriod;             // [core clock cycles]
+	uint32_t maxJitter;             // Largest deviation of a period from the expected one [core clock cycles]
+	uint64_t jitterSum;             // [core clock cycles]
+	uint32_t lateStarts;            // Updates started more than DEADLINE_LATE_MARGIN late
+	uint32_t executions;            // Number of measured executions
+	uint32_t wcet;                  // Worst-case execution time [core clock cycles]
+	uint64_t executionSum;          // [core clock cycles]
+	uint32_t longExecutions;        // Executions longer than the expected period
+} DeadlineLoopStats_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported function prototypes --------------------------------------------- */
+void DeadlineMonitorSetPeriod(const DeadlineLoop_TypeDef loop, const float32_t period);
+void DeadlineMonitorBegin(const DeadlineLoop_TypeDef loop);
+void DeadlineMonitorEnd(const DeadlineLoop_TypeDef loop);
+uint8_t GetDeadlineOverrunFlags(void);
+void DeadlineMonitorGetStats(DeadlineLoopStats_TypeDef dstStats[DEADLINE_LOOP_NBR]);
+void DeadlineMonitorReset(void);
+size_t DeadlineMonitorPrint(char* dst, const size_t dstSize);
+bool EncodeDeadlineStats(pb_ostream_t* stream);
+
+#endif /* __DEADLINE_MONITOR_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,93 @@
+/******************************************************************************
+ * @file    deferred_log.h
+ * @author  Dragonfly
+ * @brief   Header file for the deferred logger. Call sites record a format
+ *          string and its raw arguments into a RAM ring in a few cycles, the
+ *          low priority deferred worker formats the records and sends them to
+ *          the log sinks. The ring is polled at 20 Hz.
+ *          Recording never blocks, so it may be used from the control path
+ *          and from ISRs.
+ *
+ *          The ring also carries the binary data of the USB log endpoint, see
+ *          USBLogSendData(). A data record takes as many slots as it needs and
+ *          is sent from the ring in place by the log work, in order with the
+ *          messages, so that the endpoint has no buffer of its own.
+ ******************************************************************************/
+
+#ifndef __DEFERRED_LOG_H
+#define __DEFERRED_LOG_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define LOG_ARGS_MAX                4
+#define LOG_RING_SIZE               32      // Slots of 28 bytes, a message takes one, must be a power of 2
+#define LOG_DATA_MAX_SIZE           256     // [bytes] Of a data record, a telemetry pack buffer
+#define LOG_LINE_MAX_SIZE           96      // A formatted record is cut to this
+
+/* Log sinks, the formatted records are sent to each enabled one */
+#define LOG_SINK_USB                0x01    // USB com port
+#define LOG_SINK_BLACKBOX           0x02    // Log frames of the blackbox session, see blackbox.h
+#define LOG_SINKS_DEFAULT           LOG_SINK_USB
+
+#define LOG_RATE_LIMIT_INTERVAL     1000    // [ms] Default interval of rate limited call sites
+
+/* Exported types ------------------------------------------------------------*/
+
+/* A log message as recorded, formatted with FormatLogEntry() */
+typedef struct {
+	uint32_t timestamp;             // [ms]
+	const char* format;
+	uint32_t args[LOG_ARGS_MAX];
+} LogEntry_TypeDef;
+
+typedef struct {
+	uint32_t recorded;              // Slots taken in the ring since startup, one by each message and more by data
+	uint32_t dropped;               // Messages dropped since startup, because the ring was full
+} LogStatus_TypeDef;
+
+/* State of a rate limited call site, e.g. of errors caused by line noise, zero initialised */
+typedef struct {
+	uint32_t lastTime;              // [ms] Of the latest record
+	uint32_t suppressed;            // Calls suppressed since the latest record
+	bool hasRecorded;
+} LogRateLimit_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* The format must be a string literal without a line end, its address identifies it in the ring. Arguments are 32 bit
+ * integers or pointers to static strings, floats are logged as scaled integers. */
+#define LOG0(FMT)                   LogRecord((FMT), 0, 0, 0, 0)
+#define LOG1(FMT, A0)               LogRecord((FMT), (uint32_t) (A0), 0, 0, 0)
+#define LOG2(FMT, A0, A1)           LogRecord((FMT), (uint32_t) (A0), (uint32_t) (A1), 0, 0)
+#define LOG3(FMT, A0, A1, A2)       LogRecord((FMT), (uint32_t) (A0), (uint32_t) (A1), (uint32_t) (A2), 0)
+#define LOG4(FMT, A0, A1, A2, A3)   LogRecord((FMT), (uint32_t) (A0), (uint32_t) (A1), (uint32_t) (A2), \
+                                            (uint32_t) (A3))
+
+/* Exported function prototypes --------------------------------------------- */
+void CreateLogWork(void);
+void LogRecord(const char* format, const uint32_t arg0, const uint32_t arg1, const uint32_t arg2,
+		const uint32_t arg3);
+bool LogRecordData(const uint8_t* data, const uint16_t size);
+void LogDataSentFromISR(void);
+void SetLogSinks(const uint8_t sinks);
+uint8_t GetLogSinks(void);
+void GetLogStatus(LogStatus_TypeDef* status);
+uint8_t GetLastLogEntries(LogEntry_TypeDef* dstEntries, const uint8_t maxEntries);
+bool LogRateLimitPass(LogRateLimit_TypeDef* limit, const uint32_t intervalMs, uint32_t* suppressed);
+size_t FormatLogEntry(char* dst, const size_t dstSize, const LogEntry_TypeDef* entry);
+
+#endif /* __DEFERRED_LOG_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
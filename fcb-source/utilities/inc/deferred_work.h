@@ -0,0 +1,70 @@
+/******************************************************************************
+ * @file    deferred_work.h
+ * @author  Dragonfly
+ * @brief   Header file for the deferred work module, the common path from an
+ *          interrupt to the task code that handles it. A driver registers a
+ *          work item with its handler and a worker at startup, and its ISR
+ *          posts the item. Posts of an item that has not been run yet
+ *          coalesce into one run, so the handler must take all the work that
+ *          is ready, like a task woken by a binary semaphore.
+ ******************************************************************************/
+
+#ifndef __DEFERRED_WORK_H
+#define __DEFERRED_WORK_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "fcb_retval.h"
+
+#include "FreeRTOS.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define DEFERRED_WORK_MAX_ITEMS             10      // At most 32, the pending items of a worker are a bit mask
+#define DEFERRED_WORK_INVALID_ID            0xFF
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Worker tasks, the handlers of the items of one worker run one after another in the order of registration */
+typedef enum {
+	DEFERRED_WORKER_HIGH = 0,           // Below the flight control and sensors tasks, for short driver handlers
+	DEFERRED_WORKER_LOW,                // Communication priority, for handlers that may block
+	DEFERRED_WORKER_NBR
+} DeferredWorker_TypeDef;
+
+typedef void (*DeferredWorkHandler_TypeDef)(void* argument);
+
+typedef uint8_t DeferredWorkId_TypeDef;
+
+typedef struct {
+	uint32_t posts;                     // Posts, including the coalesced ones
+	uint32_t coalesced;                 // Posts of an item already pending
+	uint32_t runs;                      // Handler runs
+	uint32_t maxLatency;                // Max time from the first post to the start of the run [core clock cycles]
+	uint64_t sumLatency;                // [core clock cycles]
+	uint32_t maxRunTime;                // Max time of a handler run [core clock cycles]
+} DeferredWorkStats_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported function prototypes --------------------------------------------- */
+FcbRetValType DeferredWorkRegister(const char* name, const DeferredWorkHandler_TypeDef handler, void* argument,
+		const DeferredWorker_TypeDef worker, DeferredWorkId_TypeDef* dstId);
+bool DeferredWorkPost(const DeferredWorkId_TypeDef id);
+bool DeferredWorkPostFromISR(const DeferredWorkId_TypeDef id, portBASE_TYPE* pxHigherPriorityTaskWoken);
+void DeferredWorkGetStats(const DeferredWorkId_TypeDef id, DeferredWorkStats_TypeDef* dstStats);
+void DeferredWorkReset(void);
+size_t DeferredWorkPrint(char* dst, const size_t dstSize);
+
+#endif /* __DEFERRED_WORK_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,42 @@
+/******************************************************************************
+ * @file    ellipsoid_calibration.h
+ * @author  Dragonfly
+ * @brief   Header file for the least squares ellipsoid fit used for the hard-
+ *          and soft-iron calibration of the magnetometer
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __ELLIPSOID_CALIBRATION_H
+#define __ELLIPSOID_CALIBRATION_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "fcb_retval.h"
+#include "fcb_sensor_calibration.h"
+
+#include <arm_math.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define ELLIPSOID_TERMS_N           9       // Terms of the ellipsoid equation of a sample
+#define ELLIPSOID_MIN_SAMPLES       20      // Fewer samples are not fitted
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Sufficient statistics of the samples for the least squares fit of an ellipsoid
+ *   a*x^2 + b*y^2 + c*z^2 + 2*d*x*y + 2*e*x*z + 2*f*y*z + 2*g*x + 2*h*y + 2*i*z = 1
+ * with t = [x^2 y^2 z^2 2xy 2xz 2yz 2x 2y 2z] as the terms of a sample. Accumulated one sample at a time, so the
+ * samples themselves are not kept. */
+typedef struct {
+	float32_t ttSum[ELLIPSOID_TERMS_N * (ELLIPSOID_TERMS_N + 1) / 2]; // Upper triangle of the sum of t * t', by rows
+	float32_t tSum[ELLIPSOID_TERMS_N];                                // Sum of t
+	uint32_t N;                                                       // Number of samples
+} EllipsoidObservations_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions --------------------------------------------------------*/
+void EllipsoidClearObservations(EllipsoidObservations_TypeDef* observations);
+void EllipsoidAddSample(EllipsoidObservations_TypeDef* observations, const float32_t sample[3]);
+FcbRetValType EllipsoidCalibrate(const EllipsoidObservations_TypeDef* observations,
+		float32_t calibParams[MAG_CALIB_IDX_MAX]);
+
+#endif /* __ELLIPSOID_CALIBRATION_H */
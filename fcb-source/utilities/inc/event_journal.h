@@ -0,0 +1,150 @@
+/******************************************************************************
+ * @file    event_journal.h
+ * @author  Dragonfly
+ * @brief   Header file for the event journal and the flight odometer. The
+ *          journal keeps the events that matter after the fact over resets
+ *          and power cycles: the startups, arming, disarming, failsafe
+ *          entries, sensor faults, watchdog resets, crashes, motor failures
+ *          and calibration changes. Each event is a fixed size record, time
+ *          stamped with the boot count and the tick of the boot, appended to
+ *          the journal area of the flash, see FLASH_JOURNAL_START_ADDR.
+ *
+ *          The area is a ring of pages. The records are appended to the
+ *          active page, a page header with a sequence number tells the newest
+ *          page, and once the active page is nearly full the oldest page is
+ *          erased and becomes the active one, so the erases rotate over the
+ *          pages and the oldest events are dropped. A record is programmed a
+ *          word at a time with its check word last, so that an interrupted
+ *          record is recognized.
+ *
+ *          Events are queued in RAM by EventJournalRecord() from any task and
+ *          programmed by a job of the 20 Hz rate group. Pages are erased in
+ *          idle mode only, as the CPU stalls while the flash is erased, and
+ *          EVENT_JOURNAL_RESERVE_RECORDS records are kept free for a flight.
+ *          The same job watches the flight mode, the sensors, the crash and
+ *          motor failure detections for their events and keeps the odometer:
+ *          the total flight and armed time, the arm cycles and the largest
+ *          acceleration, saved to the settings store on every disarm.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __EVENT_JOURNAL_H
+#define __EVENT_JOURNAL_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "arm_math.h"
+#include "fcb_retval.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported types ------------------------------------------------------------*/
+
+/* The types are stored with the records, so new types are appended */
+typedef enum {
+	EVENT_JOURNAL_BOOT = 0,         // Value: the RCC reset flags of the startup, RCC->CSR
+	EVENT_JOURNAL_ARM,              // Value: the arm cycles since the odometer was started
+	EVENT_JOURNAL_DISARM,           // Arg: the largest acceleration while armed [0.1 g], value: the armed time [ms]
+	EVENT_JOURNAL_FAILSAFE,         // Arg: the flight mode it was entered from, value: EVENT_JOURNAL_FAILSAFE_* bits
+	EVENT_JOURNAL_SENSOR_FAULT,     // Arg: the sensor, FcbSensorIndexType, value: its stalls since startup
+	EVENT_JOURNAL_WATCHDOG_RESET,   // Arg: the task that missed its deadline, TASK_WATCHDOG_NBR for the supervisor
+	EVENT_JOURNAL_CALIBRATION,      // Arg: the settings key, FlashSettingsKey
+	EVENT_JOURNAL_CRASH,            // Crash detected
+	EVENT_JOURNAL_MOTOR_FAILURE,    // Arg: the motor, from 0
+	EVENT_JOURNAL_CLEARED,          // Value: the records dropped for a full queue before the clear
+	EVENT_JOURNAL_TYPE_NBR
+} EventJournalType;
+
+typedef struct {
+	uint16_t bootCount;             // Since the journal was first used, from 1
+	uint8_t type;                   // See EventJournalType
+	uint8_t arg;
+	uint32_t tick;                  // Since the startup [ms]
+	uint32_t value;
+} EventJournalRecordType;
+
+/* Flight odometer as stored in flash */
+typedef struct {
+	uint32_t flightTime;            // In the flight modes that run the motors [s]
+	uint32_t armedTime;             // [s]
+	uint32_t armCycles;
+	float32_t maxAcceleration;      // Largest norm of the acceleration while armed [g]
+} EventJournalOdometerType;
+
+typedef struct {
+	uint16_t bootCount;
+	uint16_t records;               // In flash
+	uint16_t pendingRecords;        // Queued to be programmed
+	uint32_t droppedRecords;        // Since startup, for a full queue
+	uint32_t sequence;              // Of the active page, 0 if the journal is not formatted yet
+	uint32_t writeErrors;           // Since startup
+} EventJournalStatusType;
+
+/* Exported constants --------------------------------------------------------*/
+#define EVENT_JOURNAL_PHASE             10      // [ms] in the 20 Hz rate group, between the task watchdog and LEDs
+#define EVENT_JOURNAL_QUEUE_LENGTH      16      // Records
+#define EVENT_JOURNAL_RECORD_SIZE       16      // [bytes] in flash, the page header is the size of a record
+#define EVENT_JOURNAL_RESERVE_RECORDS   16      // Free records of the active page below which it is rotated in idle
+
+/* Causes of a failsafe entry */
+#define EVENT_JOURNAL_FAILSAFE_RECEIVER 0x01    // The receiver is not active
+#define EVENT_JOURNAL_FAILSAFE_ESC      0x02    // An ESC reports a fault
+#define EVENT_JOURNAL_FAILSAFE_CRASH    0x04    // A crash is latched
+
+#define EVENT_JOURNAL_MAX_STRING_SIZE   384     // Of PrintEventJournalStatus()
+#define EVENT_JOURNAL_RECORD_STRING_SIZE 80     // Of PrintEventJournalRecord()
+
+/* Exported function prototypes --------------------------------------------- */
+
+/**
+ * Finds the active page and the newest record in the journal area, records
+ * the startup with the next boot count, loads the odometer and registers the
+ * journal job with its rate group. Called at startup after the settings
+ * store is initialised and before the reset flags are cleared.
+ */
+void InitEventJournal(void);
+
+/**
+ * Queues an event to be programmed by the journal job, time stamped now.
+ * Dropped if the queue is full. May be called from any task, not from ISRs.
+ *
+ * @param type see EventJournalType
+ * @param arg see EventJournalType
+ * @param value see EventJournalType
+ */
+void EventJournalRecord(const EventJournalType type, const uint8_t arg, const uint32_t value);
+
+/**
+ * Requests the journal to be erased by the journal job, which then records
+ * the clear. The odometer is kept.
+ *
+ * @return FCB_OK if requested, FCB_ERR if not in idle mode
+ */
+FcbRetValType ClearEventJournal(void);
+
+/**
+ * Reads a record from flash, the oldest first.
+ *
+ * @param idx index of the record from the oldest, below the records of the status
+ * @param dstRecord destination record
+ * @return true if read, false if there is no valid record at the index
+ */
+bool GetEventJournalRecord(const uint16_t idx, EventJournalRecordType* dstRecord);
+
+void GetEventJournalStatus(EventJournalStatusType* dstStatus);
+void GetOdometer(EventJournalOdometerType* dstOdometer);
+const char* GetEventJournalTypeName(const EventJournalType type);
+size_t PrintEventJournalStatus(char* dst, const size_t dstSize);
+size_t PrintEventJournalRecord(char* dst, const size_t dstSize, const EventJournalRecordType* record);
+
+#endif /* __EVENT_JOURNAL_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
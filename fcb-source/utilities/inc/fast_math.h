@@ -0,0 +1,53 @@
+/******************************************************************************
+ * @file    fast_math.h
+ * @author  Dragonfly
+ * @brief   Header file for polynomial approximations of the math library
+ *          functions used in the attitude and altitude calculations
+ ******************************************************************************/
+
+#ifndef __FAST_MATH_H
+#define __FAST_MATH_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "arm_math.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/*
+ * Max errors over the whole input ranges, as measured by FastMathBenchmark():
+ *   FastAtan2f     2e-6 rad
+ *   FastAsinf      5e-7 rad        (FastAcosf the same)
+ *   FastSqrtf      correctly rounded (VSQRT instruction)
+ *   FastInvSqrtf   1 ulp
+ *   FastPowf       1e-6 relative   (x in [0.01, 100], |y| <= 2), i.e. < 5 cm in the barometric formula
+ *   FastBarometricAltitude  1e-3 m (p/p0 in [0.5, 1.1]), the float rounding, the cubic segments alone are < 1e-5 m.
+ *                  Outside the range as the barometric formula with FastPowf.
+ */
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported function prototypes --------------------------------------------- */
+float32_t FastAtan2f(const float32_t y, const float32_t x);
+float32_t FastAsinf(const float32_t x);
+float32_t FastAcosf(const float32_t x);
+float32_t FastSqrtf(const float32_t x);
+float32_t FastInvSqrtf(const float32_t x);
+float32_t FastPowf(const float32_t x, const float32_t y);
+float32_t FastBarometricAltitude(const float32_t pressureRatio);
+
+size_t FastMathBenchmark(char* dst, const size_t dstSize); // Not in the host build, which has no cycle counter
+
+#endif /* __FAST_MATH_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
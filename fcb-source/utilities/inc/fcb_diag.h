@@ -0,0 +1,62 @@
+/******************************************************************************
+ * @file    fcb_diag.h
+ * @author  Dragonfly
+ * @brief   Compile time diagnostic levels of the modules. The diagnostics are
+ *          put in #if DIAG_ENABLED(MODULE, LEVEL) blocks, so a module below the
+ *          level has none of it compiled in, and a release build (__FCB_RELEASE__)
+ *          has no diagnostics at all. Diagnostic messages go through the
+ *          deferred log, which never blocks and may be used from ISRs.
+ ******************************************************************************/
+
+#ifndef __FCB_DIAG_H
+#define __FCB_DIAG_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "deferred_log.h"
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Diagnostic levels, each includes the ones below it */
+#define DIAG_OFF                    0
+#define DIAG_ERROR                  1   // Failed operations, e.g. sensor reads, as LOG messages
+#define DIAG_VERBOSE                2   // Activity indications, e.g. LED toggles on the sensor data ready interrupts
+
+/* Levels of the modules, may be set on the compiler command line */
+#ifndef DIAG_LEVEL_SENSORS
+#define DIAG_LEVEL_SENSORS          DIAG_VERBOSE    // fcb_sensors.c, the data ready and sensor event handling
+#endif
+#ifndef DIAG_LEVEL_GYRO
+#define DIAG_LEVEL_GYRO             DIAG_ERROR      // fcb_gyroscope.c
+#endif
+#ifndef DIAG_LEVEL_ACCMAG
+#define DIAG_LEVEL_ACCMAG           DIAG_ERROR      // fcb_accelerometer_magnetometer.c
+#endif
+
+/* A release build has no diagnostics, whatever the levels above */
+#ifdef __FCB_RELEASE__
+#undef DIAG_LEVEL_SENSORS
+#undef DIAG_LEVEL_GYRO
+#undef DIAG_LEVEL_ACCMAG
+#define DIAG_LEVEL_SENSORS          DIAG_OFF
+#define DIAG_LEVEL_GYRO             DIAG_OFF
+#define DIAG_LEVEL_ACCMAG           DIAG_OFF
+#endif
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported macro ------------------------------------------------------------*/
+
+/* For #if, true if MODULE (e.g. GYRO for DIAG_LEVEL_GYRO) has diagnostics of LEVEL */
+#define DIAG_ENABLED(MODULE, LEVEL) (DIAG_LEVEL_##MODULE >= (LEVEL))
+
+/* Exported function prototypes --------------------------------------------- */
+
+#endif /* __FCB_DIAG_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -7,9 +7,10 @@
 /*
  * This is called when we encounter an error state.
  *
- * It lights up all the LEDs, then goes into infinite loop.
+ * It stores a crash dump and resets the board. After repeated crashes right
+ * after startup it lights up all the LEDs, then goes into infinite loop.
  */
 void ErrorHandler(void);
-void GetRegistersFromStack(uint32_t* pulFaultStackAddress);
+void GetRegistersFromStack(uint32_t* pulFaultStackAddress, uint32_t excReturn);
 
 #endif
@@ -0,0 +1,67 @@
+/******************************************************************************
+ * @file    fcb_port.h
+ * @author  Dragonfly
+ * @brief   The platform services the estimation, control and mixer modules use:
+ *          the RTOS, the memory barrier, the flash settings and the USB
+ *          console. The modules include this header instead of the HAL, RTOS
+ *          and USB headers. With FCB_HOST_BUILD defined the modules are
+ *          compiled for a desktop, see host/Makefile. There is a single thread,
+ *          so the critical sections and the scheduler suspension are empty, and
+ *          the flash settings are provided by the host harness.
+ ******************************************************************************/
+
+#ifndef __FCB_PORT_H
+#define __FCB_PORT_H
+
+/* Includes -----------------------------------------------------------------*/
+#ifdef FCB_HOST_BUILD
+#include <stdio.h>
+#else
+#include "stm32f3xx.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "usbd_cdc_if.h"
+#endif
+
+#include "flash.h"
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Define on the compiler command line of a desktop build */
+//#define FCB_HOST_BUILD
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported macro ------------------------------------------------------------*/
+
+#ifdef FCB_HOST_BUILD
+#define FCB_ENTER_CRITICAL()
+#define FCB_EXIT_CRITICAL()
+#define FCB_SUSPEND_SCHEDULER()
+#define FCB_RESUME_SCHEDULER()
+#define FCB_MEMORY_BARRIER()            __sync_synchronize()
+#define FCB_CONSOLE_SEND_STRING(str)    fputs((str), stdout)
+#else
+/* Masks the RTOS interrupts, for short copies shared with ISRs or the flight control task */
+#define FCB_ENTER_CRITICAL()            taskENTER_CRITICAL()
+#define FCB_EXIT_CRITICAL()             taskEXIT_CRITICAL()
+/* Keeps the other tasks out without masking interrupts, for longer updates shared between tasks only */
+#define FCB_SUSPEND_SCHEDULER()         vTaskSuspendAll()
+#define FCB_RESUME_SCHEDULER()          xTaskResumeAll()
+/* Orders the memory accesses of a lock-free publication, e.g. the state snapshot seqlock */
+#define FCB_MEMORY_BARRIER()            __DMB()
+/* Prints on the USB CDC console */
+#define FCB_CONSOLE_SEND_STRING(str)    USBComSendString(str)
+#endif
+
+/* Exported function prototypes --------------------------------------------- */
+
+#endif /* __FCB_PORT_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,100 @@
+/******************************************************************************
+ * @file    firmware_update.h
+ * @author  Dragonfly
+ * @brief   Header file for the firmware update over USB. The STM32F303 has a
+ *          USB DFU bootloader in its system memory, which is normally started
+ *          with the BOOT0 pin. RebootToBootloader() starts it from the
+ *          running firmware instead: it leaves a request in RAM that is not
+ *          initialized at startup and resets the board, and the next startup
+ *          jumps to the ROM bootloader before anything else is set up. The
+ *          board then enumerates as a DfuSe device, e.g. for
+ *            dfu-util -a 0 -s 0x08000000:leave -D fcb.bin
+ *          which erases and programs only the pages of the image, so the
+ *          flight log, the profiles and the settings above it are kept. The
+ *          ROM bootloader needs the 8 MHz HSE clock of the STM32F3 Discovery.
+ *
+ *          The bootloader is in ROM and cannot be overwritten, so a failed or
+ *          broken update is recovered by starting it again. With
+ *          FCB_QUICK_CRASH_BOOTLOADER, a firmware that keeps crashing right
+ *          after startup, see crash_dump.h, starts it by itself.
+ *
+ *          The image is identified by DF_FCB_VERSION, its size and its CRC,
+ *          see GetFirmwareImageInfo(), so that a host can check the
+ *          programmed image against the file it has uploaded.
+ ******************************************************************************/
+
+#ifndef __FIRMWARE_UPDATE_H
+#define __FIRMWARE_UPDATE_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "fcb_retval.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Uncomment to start the ROM bootloader after CRASH_DUMP_MAX_QUICK_CRASHES quick crashes in a row, instead of stopping
+ * with all LEDs on, so that a firmware that crashes at startup can be replaced over USB without the BOOT0 pin */
+//#define FCB_QUICK_CRASH_BOOTLOADER
+
+#define FIRMWARE_SYSTEM_MEMORY_ADDR     0x1FFFD800  // ROM bootloader of the STM32F303xB/C
+#define FIRMWARE_REBOOT_DELAY           200         // [ms] from the request to the reset, for the reply to be sent
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+	uint32_t startAddress;
+	uint32_t size;                  // [bytes] of the code and the initialized data
+	uint32_t crc;                   // As ContinueCRC() from DEFAULT_CRC_INITVALUE
+} FirmwareImageInfo_TypeDef;
+
+/* Exported function prototypes --------------------------------------------- */
+
+/**
+ * Jumps to the ROM bootloader if it was requested before the last reset.
+ * Called first thing in main(), with the clocks and peripherals at their
+ * reset state.
+ */
+void CheckBootloaderRequest(void);
+
+/**
+ * Registers the delayed reset of RebootToBootloader() with the low priority
+ * deferred worker. Called at startup, before the scheduler is started.
+ */
+void CreateFirmwareUpdateWork(void);
+
+/**
+ * Starts the ROM bootloader after FIRMWARE_REBOOT_DELAY, in idle mode only.
+ *
+ * @return FCB_OK, FCB_ERR if not in idle mode or the reset could not be
+ *         scheduled
+ */
+FcbRetValType RebootToBootloader(void);
+
+/**
+ * Makes the next reset start the ROM bootloader, without resetting. Takes no
+ * locks, so that it may be called by the crash handling.
+ */
+void RequestBootloaderOnReset(void);
+
+/**
+ * Gets the size and the CRC of the running image. The CRC is calculated over
+ * the whole image, which takes a few ms.
+ *
+ * @param info destination
+ * @return FCB_OK, FCB_ERR if the CRC could not be calculated
+ */
+FcbRetValType GetFirmwareImageInfo(FirmwareImageInfo_TypeDef* info);
+size_t PrintFirmwareInfo(char* dst, const size_t dstSize);
+
+#endif /* __FIRMWARE_UPDATE_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
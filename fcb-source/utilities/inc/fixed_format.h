@@ -0,0 +1,40 @@
+/******************************************************************************
+ * @file    fixed_format.h
+ * @author  Dragonfly
+ * @brief   Header file for the fixed-point number formatter used by the text
+ *          print paths instead of the newlib float printf
+ ******************************************************************************/
+
+#ifndef __FIXED_FORMAT_H
+#define __FIXED_FORMAT_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "arm_math.h"
+
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Max number of decimals, 10^decimals must fit the fraction in 32 bits */
+#define FIXED_FORMAT_MAX_DECIMALS       6
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported function prototypes --------------------------------------------- */
+int32_t ToFixed(const float32_t value, const uint8_t decimals);
+size_t FormatFixed(char* dst, const size_t dstSize, const float32_t value, const uint8_t decimals);
+size_t FormatFixedList(char* dst, const size_t dstSize, const char* format, const float32_t* values,
+		const uint8_t valuesNbr);
+
+#endif /* __FIXED_FORMAT_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
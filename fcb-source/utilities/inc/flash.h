@@ -14,6 +14,24 @@
 #include "stm32f3xx.h"
 #include "receiver.h"
 #include "flight_control.h"
+#include "fcb_sensor_filter.h"
+#include "state_estimation.h"
+#include "motor_mixer.h"
+#include "pid_control.h"
+#include "uart.h"
+#include "blackbox.h"
+#include "fcb_sensor_calibration.h"
+#include "crash_dump.h"
+#include "stick_curves.h"
+#include "thrust_curve.h"
+#include "crash_detection.h"
+#include "motor_failure.h"
+#include "param_profile.h"
+#include "rc_smoothing.h"
+#include "mag_heading.h"
+#include "fcb_sensor_timing.h"
+#include "event_journal.h"
+#include "perf_snapshot.h"
 
 /* Exported constants --------------------------------------------------------*/
 /* Flash definitions */
@@ -31,48 +49,160 @@
 #define FLASH_SETTINGS_BYTE_SIZE        FLASH_TOTAL_SIZE + FLASH_BASE_ADDR  - FLASH_SETTINGS_START_ADDR // 32 kB reserved for data storage
 #define FLASH_SETTINGS_PAGE_SIZE        FLASH_SETTINGS_BYTE_SIZE / FLASH_PAGE_SIZE
 
-/* NOTE: When adding settings to pages below (especially when storing multiple types of setting on the same page), make
- * sure that their addresses/data offsets do not overlap so that saving one setting partially (or completely) overwrites
- * something else. Settings should be saved with a CRC value stored in front of it.
- */
+/* Event journal area, the bottom of the data areas. Its pages are programmed a word at a time and erased one at a time
+ * in idle mode only, in turn, see event_journal.h. */
+#define FLASH_JOURNAL_START_ADDR        0x08030000      // Make sure this area is not used by linker (see ROM range in .ld file).
+#define FLASH_JOURNAL_SIZE              0x1000
+#define FLASH_JOURNAL_NBR_OF_PAGES      (FLASH_JOURNAL_SIZE / FLASH_PAGE_SIZE)
+
+/* Flight data log area, just below the settings. Programmed a word at a time in flight and erased in idle mode only. */
+#define FLASH_LOG_START_ADDR            (FLASH_JOURNAL_START_ADDR + FLASH_JOURNAL_SIZE)
+#define FLASH_LOG_SIZE                  0x6800
+#define FLASH_LOG_NBR_OF_PAGES          (FLASH_LOG_SIZE / FLASH_PAGE_SIZE)
+
+/* Parameter profiles page, the top page of the log area. The profiles are records like the ones of the settings store,
+ * one slot per profile, and the whole page is erased and programmed together in idle mode only. */
+#define FLASH_PROFILES_START_ADDR       (FLASH_LOG_START_ADDR + FLASH_LOG_SIZE)
+#define FLASH_PROFILES_SIZE             FLASH_PAGE_SIZE
 
-/* Receiver calibration values settings */
-#define FLASH_RECEIVER_CALIBRATION_PAGE         FLASH_SETTINGS_START_PAGE       // Storage page (must be >= FLASH_SETTINGS_START_ADDR)
-#define FLASH_RECEIVER_CALIBRATION_DATA_OFFSET  0                               // Storage byte offset from page base address (has to be word aligned)
-#define FLASH_RECEIVER_CALIBRATION_SIZE         sizeof(Receiver_CalibrationValues_TypeDef) + HAL_CRC_LENGTH_32B/4       // Added room for CRC
-#define FLASH_RECEIVER_CALIBRATION_END			FLASH_RECEIVER_CALIBRATION_DATA_OFFSET + FLASH_RECEIVER_CALIBRATION_SIZE
-/* Max reference signal limits settings */
-#define FLASH_REFERENCE_MAX_LIMITS_PAGE         FLASH_SETTINGS_START_PAGE       // Storage page (must be >= FLASH_SETTINGS_START_ADDR)
-#define FLASH_REFERENCE_MAX_LIMITS_DATA_OFFSET  FLASH_RECEIVER_CALIBRATION_END  // Storage byte offset from page base address (has to be word aligned)
-#define FLASH_REFERENCE_MAX_LIMITS_SIZE         sizeof(RefSignals_TypeDef) + HAL_CRC_LENGTH_32B/4       // Added room for CRC
-#define FLASH_REFERENCE_MAX_LIMITS_END          FLASH_REFERENCE_MAX_LIMITS_DATA_OFFSET + FLASH_REFERENCE_MAX_LIMITS_SIZE
-/* Magnetometer calibration values */
-#define FLASH_MAG_CALIBRATION_PAGE              FLASH_SETTINGS_START_PAGE       // Storage page (must be >= FLASH_SETTINGS_START_ADDR)
-#define FLASH_MAG_CALIBRATION_DATA_OFFSET       FLASH_REFERENCE_MAX_LIMITS_END  // Storage byte offset from page base address (has to be word aligned)
-#define FLASH_MAG_CALIBRATION_SIZE              sizeof(float32_t) * 6
-#define FLASH_MAG_CALIBRATION_END               FLASH_MAG_CALIBRATION_DATA_OFFSET + FLASH_MAG_CALIBRATION_SIZE
-/* Accelerometer calibration values */
-#define FLASH_ACC_CALIBRATION_PAGE              FLASH_SETTINGS_START_PAGE       // Storage page (must be >= FLASH_SETTINGS_START_ADDR)
-#define FLASH_ACC_CALIBRATION_DATA_OFFSET       FLASH_MAG_CALIBRATION_END  // Storage byte offset from page base address (has to be word aligned)
-#define FLASH_ACC_CALIBRATION_SIZE              sizeof(float32_t) * 6
-#define FLASH_ACC_CALIBRATION_END               FLASH_ACC_CALIBRATION_DATA_OFFSET + FLASH_ACC_CALIBRATION_SIZE
+/* Settings store: an append-only log of records in one active page of the settings area at a time. A record is a
+ * header word (key, version of the settings struct of the key, data size), the data padded to whole words and a CRC
+ * word over header and data, programmed last so that an interrupted write is recognized. The newest valid record of a
+ * key holds its value. When the active page is full, the newest records are copied to the next page of the area, which
+ * then becomes the active one, and the old page is erased, so the erases rotate over all pages of the area. Written
+ * settings are queued in RAM and programmed by the flash writer work item while flight control is idle, since the CPU
+ * stalls while the flash is busy. The flash address of the newest record of each key is indexed at startup, and the
+ * settings are read from there, or from the queue if a newer record is queued. Settings of a previous version of their
+ * struct are migrated to the current one and rewritten at startup, so that the calibrations and the tuning are kept
+ * over firmware updates. */
+#define FLASH_SETTINGS_STORE_FIRST_PAGE     FLASH_SETTINGS_START_PAGE
+#define FLASH_SETTINGS_STORE_NBR_OF_PAGES   (FLASH_SETTINGS_SIZE / FLASH_PAGE_SIZE)
+#define FLASH_SETTINGS_MAX_RECORD_SIZE      512     // Max data size of a record [bytes]
 
 /* Exported types ------------------------------------------------------------*/
 typedef enum {
 	FLASH_ERROR = 0, FLASH_OK = !FLASH_ERROR
 } FlashErrorStatus;
 
+/* Keys of the stored settings. The values are stored with the records, so new keys are appended. */
+typedef enum {
+	FLASH_KEY_RECEIVER_CALIBRATION = 0,
+	FLASH_KEY_REFERENCE_MAX_LIMITS,
+	FLASH_KEY_MAG_CALIBRATION,
+	FLASH_KEY_ACC_CALIBRATION,
+	FLASH_KEY_SENSOR_FILTER,
+	FLASH_KEY_STATE_WARM_START,
+	FLASH_KEY_MOTOR_MIXER,
+	FLASH_KEY_PID_GAINS,
+	FLASH_KEY_UART_SETTINGS,
+	FLASH_KEY_BLACKBOX_SETTINGS,
+	FLASH_KEY_MAG_ELLIPSOID_CALIBRATION,
+	FLASH_KEY_MAG_ONLINE_CALIBRATION,
+	FLASH_KEY_GYRO_TEMP_COMPENSATION,
+	FLASH_KEY_CRASH_DUMP,
+	FLASH_KEY_SENSOR_NOISE,
+	FLASH_KEY_STICK_CURVES,
+	FLASH_KEY_THRUST_CURVES,
+	FLASH_KEY_PID_GAIN_SCHEDULE,
+	FLASH_KEY_PID_FEED_FORWARD,
+	FLASH_KEY_ESC_OUTPUTS,
+	FLASH_KEY_CRASH_DETECTION,
+	FLASH_KEY_SENSOR_ORIENTATION,
+	FLASH_KEY_ACCMAG_TEMP_COMPENSATION,
+	FLASH_KEY_RC_SMOOTHING,
+	FLASH_KEY_RECEIVER_CHANNEL_MAP,
+	FLASH_KEY_ESTIMATOR_NOISE,
+	FLASH_KEY_MAG_HEADING,
+	FLASH_KEY_SENSOR_TIMING,
+	FLASH_KEY_MOTOR_FAILURE,
+	FLASH_KEY_ODOMETER,
+	FLASH_KEY_MIXER_ALLOCATION,
+	FLASH_KEY_PERF_BASELINE,
+	FLASH_KEY_NBR
+} FlashSettingsKey;
+
 /* Exported macro ------------------------------------------------------------*/
 
 /* Exported function prototypes --------------------------------------------- */
+FlashErrorStatus InitFlashSettings(void);
+void CreateFlashWriterWork(void);
 FlashErrorStatus ReadCalibrationValuesFromFlash(volatile Receiver_CalibrationValues_TypeDef* receiverCalibrationValues);
 FlashErrorStatus WriteCalibrationValuesToFlash(const Receiver_CalibrationValues_TypeDef* receiverCalibrationValues);
 FlashErrorStatus ReadReferenceMaxLimitsFromFlash(RefSignals_TypeDef* receiverMaxLimits);
 FlashErrorStatus WriteReferenceMaxLimitsToFlash( const RefSignals_TypeDef* receiverMaxLimits);
 FlashErrorStatus ReadMagCalibrationValuesFromFlash(float32_t magCalibrationValues[6]);
 FlashErrorStatus WriteMagCalibrationValuesToFlash(const float32_t magCalibrationValues[6]);
+FlashErrorStatus ReadMagEllipsoidCalibrationFromFlash(float32_t magCalibrationValues[MAG_CALIB_IDX_MAX]);
+FlashErrorStatus WriteMagEllipsoidCalibrationToFlash(const float32_t magCalibrationValues[MAG_CALIB_IDX_MAX]);
+FlashErrorStatus ReadMagOnlineCalibrationSettingsFromFlash(FcbMagOnlineCalibrationSettingsType* settings);
+FlashErrorStatus WriteMagOnlineCalibrationSettingsToFlash(const FcbMagOnlineCalibrationSettingsType* settings);
+FlashErrorStatus ReadGyroTempCompensationFromFlash(FcbGyroTempCompensationType* compensation);
+FlashErrorStatus WriteGyroTempCompensationToFlash(const FcbGyroTempCompensationType* compensation);
 FlashErrorStatus ReadAccCalibrationValuesFromFlash(float32_t accCalibrationValues[6]);
 FlashErrorStatus WriteAccCalibrationValuesToFlash(const float32_t accCalibrationValues[6]);
+FlashErrorStatus ReadSensorFilterSettingsFromFlash(FcbSensorFilterSettingsType* sensorFilterSettings);
+FlashErrorStatus WriteSensorFilterSettingsToFlash(const FcbSensorFilterSettingsType* sensorFilterSettings);
+FlashErrorStatus ReadStateWarmStartFromFlash(StateWarmStartType* stateWarmStart);
+FlashErrorStatus WriteStateWarmStartToFlash(const StateWarmStartType* stateWarmStart);
+FlashErrorStatus ReadMotorMixerSettingsFromFlash(MotorMixerSettings_TypeDef* motorMixerSettings);
+FlashErrorStatus WriteMotorMixerSettingsToFlash(const MotorMixerSettings_TypeDef* motorMixerSettings);
+FlashErrorStatus ReadPIDGainsFromFlash(PIDGainSettings_TypeDef* pidGainSettings);
+FlashErrorStatus WritePIDGainsToFlash(const PIDGainSettings_TypeDef* pidGainSettings);
+FlashErrorStatus ReadUartSettingsFromFlash(UartSettings_TypeDef* uartSettings);
+FlashErrorStatus WriteUartSettingsToFlash(const UartSettings_TypeDef* uartSettings);
+FlashErrorStatus ReadBlackboxSettingsFromFlash(BlackboxSettings_TypeDef* blackboxSettings);
+FlashErrorStatus WriteBlackboxSettingsToFlash(const BlackboxSettings_TypeDef* blackboxSettings);
+FlashErrorStatus ReadCrashDumpFromFlash(CrashDump_TypeDef* crashDump);
+FlashErrorStatus WriteCrashDumpToFlash(const CrashDump_TypeDef* crashDump);
+FlashErrorStatus ReadSensorNoiseFromFlash(SensorNoiseType* sensorNoise);
+FlashErrorStatus WriteSensorNoiseToFlash(const SensorNoiseType* sensorNoise);
+FlashErrorStatus ReadStickCurvesFromFlash(StickCurveSettingsType* stickCurves);
+FlashErrorStatus WriteStickCurvesToFlash(const StickCurveSettingsType* stickCurves);
+FlashErrorStatus ReadThrustCurvesFromFlash(ThrustCurveSettingsType* thrustCurves);
+FlashErrorStatus WriteThrustCurvesToFlash(const ThrustCurveSettingsType* thrustCurves);
+FlashErrorStatus ReadPIDGainScheduleFromFlash(PIDGainSchedule_TypeDef* pidGainSchedule);
+FlashErrorStatus WritePIDGainScheduleToFlash(const PIDGainSchedule_TypeDef* pidGainSchedule);
+FlashErrorStatus ReadPIDFeedForwardFromFlash(PIDFeedForwardSettings_TypeDef* pidFeedForwardSettings);
+FlashErrorStatus WritePIDFeedForwardToFlash(const PIDFeedForwardSettings_TypeDef* pidFeedForwardSettings);
+FlashErrorStatus ReadEscOutputsFromFlash(EscOutputsType* escOutputs);
+FlashErrorStatus WriteEscOutputsToFlash(const EscOutputsType* escOutputs);
+FlashErrorStatus ReadCrashDetectionSettingsFromFlash(CrashDetectionSettingsType* crashDetectionSettings);
+FlashErrorStatus WriteCrashDetectionSettingsToFlash(const CrashDetectionSettingsType* crashDetectionSettings);
+FlashErrorStatus ReadSensorOrientationSettingsFromFlash(FcbSensorOrientationSettingsType* sensorOrientationSettings);
+FlashErrorStatus WriteSensorOrientationSettingsToFlash(
+		const FcbSensorOrientationSettingsType* sensorOrientationSettings);
+FlashErrorStatus ReadAccMagTempCompensationFromFlash(FcbAccMagTempCompensationType* compensation);
+FlashErrorStatus WriteAccMagTempCompensationToFlash(const FcbAccMagTempCompensationType* compensation);
+FlashErrorStatus ReadRcSmoothingSettingsFromFlash(RcSmoothingSettingsType* rcSmoothingSettings);
+FlashErrorStatus WriteRcSmoothingSettingsToFlash(const RcSmoothingSettingsType* rcSmoothingSettings);
+FlashErrorStatus ReadReceiverChannelMapFromFlash(Receiver_ChannelMap_TypeDef* channelMap);
+FlashErrorStatus WriteReceiverChannelMapToFlash(const Receiver_ChannelMap_TypeDef* channelMap);
+FlashErrorStatus ReadEstimatorNoiseFromFlash(EstimatorNoiseSettingsType* estimatorNoise);
+FlashErrorStatus WriteEstimatorNoiseToFlash(const EstimatorNoiseSettingsType* estimatorNoise);
+FlashErrorStatus ReadMagHeadingSettingsFromFlash(MagHeadingSettingsType* magHeadingSettings);
+FlashErrorStatus WriteMagHeadingSettingsToFlash(const MagHeadingSettingsType* magHeadingSettings);
+FlashErrorStatus ReadSensorTimingSettingsFromFlash(FcbSensorTimingSettingsType* sensorTimingSettings);
+FlashErrorStatus WriteSensorTimingSettingsToFlash(const FcbSensorTimingSettingsType* sensorTimingSettings);
+FlashErrorStatus ReadMotorFailureSettingsFromFlash(MotorFailureSettingsType* motorFailureSettings);
+FlashErrorStatus WriteMotorFailureSettingsToFlash(const MotorFailureSettingsType* motorFailureSettings);
+FlashErrorStatus ReadOdometerFromFlash(EventJournalOdometerType* odometer);
+FlashErrorStatus WriteOdometerToFlash(const EventJournalOdometerType* odometer);
+FlashErrorStatus ReadMixerAllocationFromFlash(MotorMixerAllocation_TypeDef* mixerAllocation);
+FlashErrorStatus WriteMixerAllocationToFlash(const MotorMixerAllocation_TypeDef* mixerAllocation);
+FlashErrorStatus ReadPerfBaselineFromFlash(PerfBaseline_TypeDef* perfBaseline);
+FlashErrorStatus WritePerfBaselineToFlash(const PerfBaseline_TypeDef* perfBaseline);
+FlashErrorStatus ReadParamProfileFromFlash(const uint8_t profileIdx, ParamProfileType* profile);
+FlashErrorStatus WriteParamProfilesToFlash(const ParamProfileType profiles[PARAM_PROFILE_NBR],
+		const bool isProfileValid[PARAM_PROFILE_NBR]);
+FlashErrorStatus StartFlashSettingsBatch(void);
+FlashErrorStatus EndFlashSettingsBatch(void);
+void AbortFlashSettingsBatch(void);
+bool IsFlashWritePending(void);
+uint32_t GetFlashCalibrationWriteCount(void);
+FlashErrorStatus EraseFlashLogPage(const uint16_t pageIdx);
+FlashErrorStatus ProgramFlashLogWord(const uint32_t offset, const uint32_t word);
+FlashErrorStatus EraseFlashJournalPage(const uint16_t pageIdx);
+FlashErrorStatus ProgramFlashJournalWord(const uint32_t offset, const uint32_t word);
 
 #endif /* __FLASH_H */
 
@@ -0,0 +1,38 @@
+/******************************************************************************
+ * @file    isr_context.h
+ * @author  Dragonfly
+ * @brief   Static check for the translation units that only contain interrupt
+ *          handlers and HAL callbacks. Included after all other includes, it
+ *          poisons the com port, UART and string formatting functions, so a
+ *          call to one of them from those files does not compile. They block,
+ *          allocate or take hundreds of cycles and must not run in an ISR; a
+ *          handler records a LOG message (deferred_log.h) or defers the work
+ *          to a task (deferred_work.h) instead.
+ *          Functions in other files that run in ISR context (the ...FromISR
+ *          ones) use only the same ISR safe calls, see fcb_diag.h.
+ ******************************************************************************/
+
+#ifndef __ISR_CONTEXT_H
+#define __ISR_CONTEXT_H
+
+/* Exported constants --------------------------------------------------------*/
+/* Exported types ------------------------------------------------------------*/
+/* Exported macro ------------------------------------------------------------*/
+
+#pragma GCC poison USBComSendString USBComSendData
+#pragma GCC poison UartSendData UartSendStaticData UartSendString
+#pragma GCC poison ComSessionSendData ComSessionSendString
+#pragma GCC poison printf sprintf snprintf vsnprintf trace_printf
+
+/* Exported function prototypes --------------------------------------------- */
+
+#endif /* __ISR_CONTEXT_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
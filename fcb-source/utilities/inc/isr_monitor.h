@@ -0,0 +1,111 @@
+/******************************************************************************
+ * @file    isr_monitor.h
+ * @author  Dragonfly
+ * @brief   Header file for the interrupt monitor, which counts the calls and
+ *          the execution time of each interrupt handler in core clock cycles
+ *          with the DWT cycle counter, so that the interrupt priorities can be
+ *          placed from data and heavy handlers found. The handlers of
+ *          stm32f3xx_it.c are instrumented with ISR_MONITOR_BEGIN() and
+ *          ISR_MONITOR_END().
+ ******************************************************************************/
+
+#ifndef __ISR_MONITOR_H
+#define __ISR_MONITOR_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Uncomment to compile the interrupt instrumentation and its statistics in. Each monitored handler costs two cycle
+ * counter reads and a short section with the interrupts disabled, leave commented for flight builds. */
+//#define FCB_ISR_MONITOR
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Monitored interrupt handlers */
+typedef enum {
+	ISR_MONITOR_SYSTICK = 0,        // SysTick, HAL and kernel tick
+	ISR_MONITOR_PVD,                // PVD, supply voltage detection
+	ISR_MONITOR_GYRO_DRDY,          // EXTI1, gyroscope data ready
+	ISR_MONITOR_MAG_DRDY,           // EXTI2, magnetometer data ready
+	ISR_MONITOR_ACC_DRDY,           // EXTI4, accelerometer data ready
+	ISR_MONITOR_USER_BUTTON,        // EXTI0, user button
+	ISR_MONITOR_GYRO_DMA_RX,        // DMA1 channel 2, gyroscope SPI reception
+	ISR_MONITOR_GYRO_DMA_TX,        // DMA1 channel 3, gyroscope SPI transmission
+	ISR_MONITOR_I2C_EV,             // I2C1 event, accelerometer/magnetometer bus
+	ISR_MONITOR_I2C_ER,             // I2C1 error, accelerometer/magnetometer bus
+	ISR_MONITOR_STATE_ESTIMATION,   // TIM7, STATE_ESTIMATION_UPDATE_TIM
+	ISR_MONITOR_PRIMARY_RECEIVER,   // TIM2, receiver input capture
+	ISR_MONITOR_AUX_RECEIVER,       // TIM3, auxiliary receiver input capture
+	ISR_MONITOR_RECEIVER_FAILSAFE,  // TIM6, receiver failsafe timeout
+	ISR_MONITOR_SERIAL_RECEIVER,    // USART1, serial receiver
+	ISR_MONITOR_UART,               // USART2, UART idle line
+	ISR_MONITOR_UART_DMA_RX,        // DMA1 channel 6, UART reception
+	ISR_MONITOR_UART_DMA_TX,        // DMA1 channel 7, UART transmission
+	ISR_MONITOR_CRC_DMA,            // DMA2 channel 1, CRC peripheral feed
+	ISR_MONITOR_USB,                // USB low priority
+	ISR_MONITOR_CONTROL_EXECUTIVE,  // UART5, the control executive, see control_executive.h
+	ISR_MONITOR_SENSOR_LOAD_TEST,   // TIM15, sensor load test triggers, see fcb_sensor_load_test.h
+	ISR_MONITOR_I2C_BARO_EV,        // I2C2 event, barometer bus
+	ISR_MONITOR_I2C_BARO_ER,        // I2C2 error, barometer bus
+	ISR_MONITOR_BARO_TIM,           // TIM16, barometer conversion timer
+	ISR_MONITOR_SENSOR_WATCHDOG_TIM, // TIM17, sensor watchdog tick, see fcb_sensor_watchdog.h
+	ISR_MONITOR_GPS_UART,           // UART4, GPS receiver idle line, see fcb_gps.h
+	ISR_MONITOR_MOTOR_DMA,          // DMA1 channel 1, bidirectional DShot line turnaround, see motor_control.h
+	ISR_MONITOR_ESC_TELEMETRY_UART, // USART3, ESC telemetry bytes, see esc_telemetry.h
+	ISR_MONITOR_SD_CARD_DMA,        // DMA1 channel 5, SD card sector sent, see sd_card.h
+	ISR_MONITOR_CAN_RX,             // bxCAN FIFO 1, received frames, see can_bus.h
+	ISR_MONITOR_CAN_TX,             // bxCAN TX mailbox empty
+	ISR_MONITOR_NBR
+} IsrMonitorVector_TypeDef;
+
+typedef struct {
+	uint32_t count;                 // Number of calls
+	uint64_t cycles;                // Sum of the execution times [core clock cycles]
+	uint32_t maxCycles;             // [core clock cycles]
+} IsrStats_TypeDef;
+
+/* Statistics of all handlers, copied at one instant */
+typedef struct {
+	IsrStats_TypeDef isr[ISR_MONITOR_NBR];
+	uint32_t duration;              // Time since the statistics were cleared [ms]
+	uint32_t coreClock;             // [Hz]
+} IsrSnapshot_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+#ifdef FCB_ISR_MONITOR
+
+/* Measures from ISR_MONITOR_BEGIN() to ISR_MONITOR_END() of the same handler, excluding the handlers that preempt it */
+#define ISR_MONITOR_BEGIN(VECTOR)       uint32_t isrMonitorStart = DWT->CYCCNT; \
+                                        uint32_t isrMonitorNested = IsrMonitorGetExclusiveSum()
+#define ISR_MONITOR_END(VECTOR)         IsrMonitorRecord((VECTOR), isrMonitorStart, isrMonitorNested)
+
+#else
+
+#define ISR_MONITOR_BEGIN(VECTOR)       ((void) 0)
+#define ISR_MONITOR_END(VECTOR)         ((void) 0)
+
+#endif /* FCB_ISR_MONITOR */
+
+/* Exported function prototypes --------------------------------------------- */
+uint32_t IsrMonitorGetExclusiveSum(void);
+void IsrMonitorRecord(const IsrMonitorVector_TypeDef vector, const uint32_t start, const uint32_t exclusiveSumAtStart);
+void IsrMonitorGetSnapshot(IsrSnapshot_TypeDef* dstSnapshot);
+uint32_t IsrMonitorGetStats(const IsrMonitorVector_TypeDef vector, IsrStats_TypeDef* dstStats);
+void IsrMonitorReset(void);
+size_t IsrMonitorPrint(char* dst, const size_t dstSize, const IsrSnapshot_TypeDef* snapshot);
+
+#endif /* __ISR_MONITOR_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,69 @@
+/******************************************************************************
+ * @file    latency_monitor.h
+ * @author  Dragonfly
+ * @brief   Header file for the end-to-end control latency monitor, which
+ *          measures the time from a gyroscope data ready interrupt to the
+ *          motor output that uses the sample, and from a completed RC frame
+ *          to the first motor output after its setpoints were applied
+ ******************************************************************************/
+
+#ifndef __LATENCY_MONITOR_H
+#define __LATENCY_MONITOR_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Histogram bin k counts end-to-end latencies in [2^k, 2^(k+1)) us, the last bin everything above */
+#define LATENCY_HISTOGRAM_BINS      16
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Pipeline stages in the order they are passed */
+typedef enum {
+	LATENCY_STAGE_DRDY = 0,         // Gyroscope data ready interrupt, i.e. the sample timestamp
+	LATENCY_STAGE_FETCH,            // Sample read, filtered and handed to the flight control task
+	LATENCY_STAGE_CORRECTION,       // Estimator correction with the sample done
+	LATENCY_STAGE_CONTROL,          // PID control signals done
+	LATENCY_STAGE_MOTOR,            // Motor compare values written
+	LATENCY_STAGE_NBR
+} LatencyStage_TypeDef;
+
+typedef struct {
+	uint32_t min;                   // [core clock cycles]
+	uint32_t max;                   // [core clock cycles]
+	uint64_t sum;                   // [core clock cycles]
+} LatencyStageStats_TypeDef;
+
+typedef struct {
+	uint32_t count;                                     // Number of complete measurements
+	LatencyStageStats_TypeDef total;                    // DRDY to motor write
+	LatencyStageStats_TypeDef stage[LATENCY_STAGE_NBR]; // Previous stage to this stage, LATENCY_STAGE_DRDY unused
+	uint32_t histogram[LATENCY_HISTOGRAM_BINS];         // Total latency, see LATENCY_HISTOGRAM_BINS
+	uint32_t rcFrameCount;                              // Number of complete RC frame measurements
+	LatencyStageStats_TypeDef rcFrame;                  // RC frame completed to motor write
+} LatencyStats_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported function prototypes --------------------------------------------- */
+void LatencyMonitorBegin(const uint32_t drdyTimestamp, const uint32_t fetchTimestamp);
+void LatencyMonitorMark(const LatencyStage_TypeDef stage);
+void LatencyMonitorBeginRcFrame(const uint32_t frameTimestamp);
+void LatencyMonitorGetStats(LatencyStats_TypeDef* dstStats);
+void LatencyMonitorReset(void);
+size_t LatencyMonitorPrint(char* dst, const size_t dstSize);
+
+#endif /* __LATENCY_MONITOR_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,81 @@
+/******************************************************************************
+ * @file    led_status.h
+ * @author  Dragonfly
+ * @brief   Header file for the LED status patterns. The 20 Hz rate group steps through a
+ *          pattern for every active status of the UAV and writes the eight
+ *          LEDs of the STM32F3 Discovery, so that no other code sets an LED.
+ *          The statuses are read from their subsystems on every step, see
+ *          IsLedStatusActive(), so the control loop, the sensors and the
+ *          interrupt handlers do not know of the LEDs.
+ *
+ *          A pattern lights a group of LEDs, the ring of the board by colour,
+ *          with a blink sequence. Where the groups of active statuses overlap,
+ *          each LED shows the status of the highest priority, so e.g. a low
+ *          battery blinks the red LEDs while the green ones still show armed.
+ *          The error stop of ErrorHandler() lights all LEDs and stops the
+ *          patterns, see LedStatusStop().
+ ******************************************************************************/
+
+#ifndef __LED_STATUS_H
+#define __LED_STATUS_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "rate_groups.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define LED_STATUS_STEP_PERIOD          RATE_GROUP_20HZ_PERIOD  // [ms] of a step of the blink sequences
+#define LED_STATUS_PHASE                25      // [ms] in the rate group, between the task watchdog supervisor runs
+#define LED_STATUS_SEQUENCE_STEPS       20      // Steps per sequence, 1 s
+
+/* Exported types ------------------------------------------------------------*/
+
+/* In priority order, the highest first */
+typedef enum {
+	LED_STATUS_FAILSAFE = 0,        // All LEDs, fast blink
+	LED_STATUS_SENSOR_FAULT,        // Red, on: unhealthy or failed its self-test
+	LED_STATUS_LOW_BATTERY,         // Red, double blink: low or critical, FCB_BATTERY_MONITOR only
+	LED_STATUS_CPU_OVERLOAD,        // Blue, fast blink: low CPU headroom
+	LED_STATUS_CALIBRATING,         // Orange, slow blink: the accelerometer and magnetometer are not calibrated yet
+	LED_STATUS_PREARM_FAILED,       // Orange, double blink: disarmed with a failed pre-arm check, see prearm_checks.h
+	LED_STATUS_ARMED,               // Green, on
+	LED_STATUS_DISARMED,            // Green, short flash every second
+	LED_STATUS_NBR
+} LedStatusType;
+
+/* Exported function prototypes --------------------------------------------- */
+
+/**
+ * Registers the steps of the patterns with their rate group. Called at startup
+ * after the LEDs are initialised, the patterns start with the scheduler.
+ */
+void InitLedStatus(void);
+
+/**
+ * @param status LED status
+ * @return true if the status is active now
+ */
+bool IsLedStatusActive(const LedStatusType status);
+
+/**
+ * Stops the patterns for good, the LEDs keep their state after this. Takes no
+ * locks, so that it may be called by the error handling.
+ */
+void LedStatusStop(void);
+
+const char* GetLedStatusName(const LedStatusType status);
+size_t PrintLedStatus(char* dst, const size_t dstSize);
+
+#endif /* __LED_STATUS_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
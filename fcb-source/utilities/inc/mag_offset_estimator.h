@@ -0,0 +1,38 @@
+/******************************************************************************
+ * @file    mag_offset_estimator.h
+ * @author  Dragonfly
+ * @brief   Header file for the recursive least squares estimator of the
+ *          magnetometer hard-iron offset, which refines the offset of the
+ *          ground calibration from the samples taken in flight
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __MAG_OFFSET_ESTIMATOR_H
+#define __MAG_OFFSET_ESTIMATOR_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <arm_math.h>
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define MAG_OFFSET_PARAMS_N         4       // Offset x, y, z and radius^2 - |offset|^2
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Fit of |y|^2 = 2 * y' * b + k to soft-iron corrected samples y = W * x, where b is the offset and k the squared field
+ * radius minus |b|^2. Linear in b and k, so each sample is one fixed cost RLS update. */
+typedef struct {
+	float32_t theta[MAG_OFFSET_PARAMS_N];                       // b and k
+	float32_t P[MAG_OFFSET_PARAMS_N][MAG_OFFSET_PARAMS_N];      // Covariance of theta
+	float32_t lastSample[3];                                    // Last sample used for an update
+	uint32_t nbrOfUpdates;
+} MagOffsetEstimator_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions --------------------------------------------------------*/
+void MagOffsetEstimatorInit(MagOffsetEstimator_TypeDef* estimator, const float32_t offset[3]);
+bool MagOffsetEstimatorUpdate(MagOffsetEstimator_TypeDef* estimator, const float32_t sample[3]);
+void MagOffsetEstimatorGet(const MagOffsetEstimator_TypeDef* estimator, float32_t offset[3], float32_t* radius);
+
+#endif /* __MAG_OFFSET_ESTIMATOR_H */
@@ -0,0 +1,125 @@
+/******************************************************************************
+ * @file    matrix3.h
+ * @author  Dragonfly
+ * @brief   Fixed size 3x3 matrix and 3-vector kernels. The CMSIS arm_mat_*
+ *          functions check the dimensions and loop over rows and columns,
+ *          which for a 3x3 costs more than the 27 multiply-adds. These are
+ *          unrolled, and each element is a plain sum of products so that the
+ *          compiler contracts it to a VMUL and chained VFMAs.
+ *          Matrices are row major float32_t[9], as in arm_matrix_instance_f32.
+ ******************************************************************************/
+
+#ifndef __MATRIX3_H
+#define __MATRIX3_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "arm_math.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Exported constants --------------------------------------------------------*/
+/* Exported types ------------------------------------------------------------*/
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+
+/*
+ * @brief  Matrix vector product dst = m*v
+ * @param  dst : Output vector, may be the same as v
+ * @param  m : 3x3 matrix
+ * @param  v : Input vector
+ * @retval None
+ */
+static inline void Mat3MulVec3(float32_t* dst, const float32_t* m, const float32_t* v) {
+	float32_t x = v[0], y = v[1], z = v[2];
+
+	dst[0] = m[0]*x + m[1]*y + m[2]*z;
+	dst[1] = m[3]*x + m[4]*y + m[5]*z;
+	dst[2] = m[6]*x + m[7]*y + m[8]*z;
+}
+
+/*
+ * @brief  Transposed matrix vector product dst = m'*v, without forming the transpose
+ * @param  dst : Output vector, may be the same as v
+ * @param  m : 3x3 matrix
+ * @param  v : Input vector
+ * @retval None
+ */
+static inline void Mat3TransMulVec3(float32_t* dst, const float32_t* m, const float32_t* v) {
+	float32_t x = v[0], y = v[1], z = v[2];
+
+	dst[0] = m[0]*x + m[3]*y + m[6]*z;
+	dst[1] = m[1]*x + m[4]*y + m[7]*z;
+	dst[2] = m[2]*x + m[5]*y + m[8]*z;
+}
+
+/*
+ * @brief  Matrix transpose dst = m'
+ * @param  dst : Output matrix, must not be the same as m
+ * @param  m : 3x3 matrix
+ * @retval None
+ */
+static inline void Mat3Transpose(float32_t* dst, const float32_t* m) {
+	dst[0] = m[0]; dst[1] = m[3]; dst[2] = m[6];
+	dst[3] = m[1]; dst[4] = m[4]; dst[5] = m[7];
+	dst[6] = m[2]; dst[7] = m[5]; dst[8] = m[8];
+}
+
+/*
+ * @brief  Matrix product dst = a*b
+ * @param  dst : Output matrix, must not be the same as a or b
+ * @param  a : Left 3x3 matrix
+ * @param  b : Right 3x3 matrix
+ * @retval None
+ */
+static inline void Mat3Mul(float32_t* dst, const float32_t* a, const float32_t* b) {
+	uint8_t row;
+
+	/* Each row of dst is a row of a times b, the loop is unrolled at -O1 and above */
+	for (row = 0; row < 3; row++) {
+		float32_t a0 = a[3*row], a1 = a[3*row+1], a2 = a[3*row+2];
+
+		dst[3*row] = a0*b[0] + a1*b[3] + a2*b[6];
+		dst[3*row+1] = a0*b[1] + a1*b[4] + a2*b[7];
+		dst[3*row+2] = a0*b[2] + a1*b[5] + a2*b[8];
+	}
+}
+
+/*
+ * @brief  Symmetric covariance propagation dst = f*p*f' + q, e.g. the Kalman prediction of a 3 state filter. Only
+ *         the upper triangle is calculated and mirrored, so dst is symmetric even with rounding.
+ * @param  dst : Output covariance, may be the same as p
+ * @param  f : 3x3 state transition matrix
+ * @param  p : 3x3 symmetric covariance
+ * @param  q : Diagonal of the process noise covariance (3 elements)
+ * @retval None
+ */
+static inline void Mat3Propagate(float32_t* dst, const float32_t* f, const float32_t* p, const float32_t* q) {
+	float32_t fp[9];
+
+	Mat3Mul(fp, f, p);
+
+	dst[0] = fp[0]*f[0] + fp[1]*f[1] + fp[2]*f[2] + q[0];
+	dst[1] = fp[0]*f[3] + fp[1]*f[4] + fp[2]*f[5];
+	dst[2] = fp[0]*f[6] + fp[1]*f[7] + fp[2]*f[8];
+	dst[4] = fp[3]*f[3] + fp[4]*f[4] + fp[5]*f[5] + q[1];
+	dst[5] = fp[3]*f[6] + fp[4]*f[7] + fp[5]*f[8];
+	dst[8] = fp[6]*f[6] + fp[7]*f[7] + fp[8]*f[8] + q[2];
+	dst[3] = dst[1];
+	dst[6] = dst[2];
+	dst[7] = dst[5];
+}
+
+size_t Matrix3Benchmark(char* dst, const size_t dstSize); // Not in the host build, which has no cycle counter
+
+#endif /* __MATRIX3_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
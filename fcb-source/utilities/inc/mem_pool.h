@@ -0,0 +1,68 @@
+/******************************************************************************
+ * @file    mem_pool.h
+ * @author  Dragonfly
+ * @brief   Header file for the fixed-size block memory pools. A pool hands out
+ *          blocks of one size from a static array, in constant time, for the
+ *          buffers that are passed between tasks at run time, so that they do
+ *          not come from the FreeRTOS heap. A pool that is empty fails the
+ *          allocation, which is counted, and never waits.
+ ******************************************************************************/
+
+#ifndef __MEM_POOL_H
+#define __MEM_POOL_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "fcb_retval.h"
+
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define MEM_POOL_MAX_POOLS              8       // Registered pools shown by MemPoolPrint()
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Elements of the uint64_t storage array of a pool. The blocks are 8 byte aligned for any member type, and each
+ * block holds the free list link while it is free. */
+#define MEM_POOL_BLOCK_UNITS(BLOCK_SIZE)                (((BLOCK_SIZE) + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+#define MEM_POOL_STORAGE_SIZE(BLOCK_SIZE, BLOCKS)       (MEM_POOL_BLOCK_UNITS(BLOCK_SIZE) * (BLOCKS))
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+	uint16_t blockSize;                 // [bytes], rounded up to a multiple of 8
+	uint16_t blocks;
+	uint16_t used;
+	uint16_t peakUsed;                  // Most blocks in use at once since startup
+	uint32_t allocations;               // Successful allocations since startup
+	uint32_t failures;                  // Allocations from an empty pool since startup
+} MemPoolStats_TypeDef;
+
+typedef struct MemPoolBlock {
+	struct MemPoolBlock* next;
+} MemPoolBlock_TypeDef;
+
+typedef struct {
+	const char* name;
+	uint64_t* storage;
+	MemPoolBlock_TypeDef* freeList;
+	MemPoolStats_TypeDef stats;
+} MemPool_TypeDef;
+
+/* Exported function prototypes --------------------------------------------- */
+FcbRetValType MemPoolInit(MemPool_TypeDef* pool, const char* name, uint64_t* storage, const size_t blockSize,
+		const uint16_t blocks);
+void* MemPoolAlloc(MemPool_TypeDef* pool);
+void MemPoolFree(MemPool_TypeDef* pool, void* block);
+void MemPoolGetStats(const MemPool_TypeDef* pool, MemPoolStats_TypeDef* dstStats);
+size_t MemPoolPrint(char* dst, const size_t dstSize, uint8_t* nextPool);
+
+#endif /* __MEM_POOL_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
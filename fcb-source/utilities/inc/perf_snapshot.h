@@ -0,0 +1,113 @@
+/******************************************************************************
+ * @file    perf_snapshot.h
+ * @author  Dragonfly
+ * @brief   Header file for the performance snapshot, one flat set of the
+ *          counters of the profiler, the deadline monitor, the ISR monitor,
+ *          the task status, the CPU headroom meter, the buffer monitor and
+ *          the sensor data rates, so that their figures under flight load
+ *          are seen, exported and compared in one place. The 1 Hz rate group
+ *          takes a snapshot every PerfSnapshotSetPeriod() seconds. Like the
+ *          statistics it is made of, it covers the time since they were last
+ *          cleared, see PerfSnapshotReset().
+ *
+ *          A snapshot can be saved to the settings store as the baseline,
+ *          with the CRC of the firmware image it was taken with. Every new
+ *          snapshot is compared with the baseline, also with one saved by a
+ *          previous firmware build, and a field that is more than
+ *          PERF_REGRESSION_TOLERANCE worse is flagged as a regression. A
+ *          baseline of a build with another set of fields is not read, see
+ *          CopyRecordSettings(), and has to be saved again.
+ *
+ *          The snapshot is printed as a table with the baseline, as CSV or as
+ *          its regressions by the CLI, and sent with the PERF_SNAPSHOT_MSG_ENUM
+ *          telemetry message at the rate telemetry is started with. The
+ *          baseline settings record is kept without FCB_PERF_SNAPSHOT.
+ ******************************************************************************/
+
+#ifndef __PERF_SNAPSHOT_H
+#define __PERF_SNAPSHOT_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "fcb_retval.h"
+#include "profiler.h"
+#include "deadline_monitor.h"
+#include "fcb_sensors.h"
+#include "pb_encode.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Uncomment to compile in the performance snapshots and their CLI commands and telemetry message. The snapshot,
+ * its baseline and scratch copy take about 1 KB of RAM, and most of its fields are zero without FCB_PROFILING and
+ * FCB_ISR_MONITOR, leave commented for flight builds. */
+//#define FCB_PERF_SNAPSHOT
+
+#define PERF_SNAPSHOT_PHASE                 770     // [ms] in the 1 Hz rate group, after the task status sample
+#define PERF_SNAPSHOT_DEFAULT_PERIOD        1       // [s] between the snapshots
+#define PERF_SNAPSHOT_MAX_PERIOD            3600    // [s]
+
+/* A field is a regression if it is worse than the baseline by more than this share of the baseline, and by more than
+ * one unit, so that a counter going from 0 to 1 is not flagged */
+#define PERF_REGRESSION_TOLERANCE           10      // [%]
+
+/* The profiler maximum and mean of each probe, the deadline monitor worst case execution time, maximum jitter and late
+ * starts of each loop, the system fields and the measured rate and missed data ready interrupts of each sensor */
+#define PERF_SNAPSHOT_SYSTEM_FIELD_NBR      7
+#define PERF_SNAPSHOT_FIELD_NBR             (2*PROFILE_PROBE_NBR + 3*DEADLINE_LOOP_NBR \
+											+ PERF_SNAPSHOT_SYSTEM_FIELD_NBR + 2*FCB_SENSOR_NBR)
+
+/* The PERF_SNAPSHOT_MSG_ENUM message, encoded without generated nanopb code. The fields do not fit one telemetry
+ * frame, each message carries the next PERF_SNAPSHOT_MSG_FIELDS of them, in the order of the CSV columns.
+ *   message PerfSnapshotProto {
+ *     optional uint32 timestamp = 1;               // Of the snapshot [ms]
+ *     optional uint32 field_count = 2;             // PERF_SNAPSHOT_FIELD_NBR
+ *     optional uint32 first_field = 3;             // Field index of values[0]
+ *     repeated uint32 values = 4 [packed = true];
+ *     optional uint32 regressions = 5;             // Bit n set if field first_field + n regressed
+ *     optional uint32 baseline_crc = 6;            // Firmware image CRC of the baseline, left out without a baseline
+ *   } */
+#define PERF_SNAPSHOT_MSG_FIELDS            16
+#define PERF_SNAPSHOT_MSG_MAX_SIZE          (3*(1 + 5) + 1 + 1 + 5*PERF_SNAPSHOT_MSG_FIELDS + 2*(1 + 5))
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+	uint32_t timestamp;             // Time since startup [ms], 0 before the first snapshot
+	uint32_t values[PERF_SNAPSHOT_FIELD_NBR];
+} PerfSnapshot_TypeDef;
+
+/* Baseline as stored in flash */
+typedef struct {
+	uint32_t imageCrc;              // Of the firmware the snapshot was taken with, see GetFirmwareImageInfo()
+	uint32_t imageSize;             // [bytes]
+	PerfSnapshot_TypeDef snapshot;
+} PerfBaseline_TypeDef;
+
+/* Exported function prototypes --------------------------------------------- */
+#ifdef FCB_PERF_SNAPSHOT
+void InitPerfSnapshot(void);
+FcbRetValType PerfSnapshotSetPeriod(const uint16_t period);
+uint16_t PerfSnapshotGetPeriod(void);
+void PerfSnapshotGet(PerfSnapshot_TypeDef* dstSnapshot);
+void PerfSnapshotReset(void);
+const char* GetPerfSnapshotFieldName(const uint8_t field);
+FcbRetValType PerfBaselineSave(void);
+bool PerfBaselineGet(PerfBaseline_TypeDef* dstBaseline);
+size_t PerfSnapshotPrint(char* dst, const size_t dstSize);
+size_t PerfSnapshotPrintCsv(char* dst, const size_t dstSize);
+size_t PerfBaselineCompare(char* dst, const size_t dstSize);
+bool EncodePerfSnapshot(pb_ostream_t* stream);
+#endif /* FCB_PERF_SNAPSHOT */
+
+#endif /* __PERF_SNAPSHOT_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
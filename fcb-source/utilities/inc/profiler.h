@@ -0,0 +1,117 @@
+/******************************************************************************
+ * @file    profiler.h
+ * @author  Dragonfly
+ * @brief   Header file for the execution time profiler, which measures the
+ *          cost of hot functions and ISRs in core clock cycles with the DWT
+ *          cycle counter
+ ******************************************************************************/
+
+#ifndef __PROFILER_H
+#define __PROFILER_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "pb_encode.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Uncomment to compile the profiling probes and their statistics in. Each probe costs two cycle counter reads and a
+ * short critical section, the statistics about 1 KB of RAM, leave commented for flight builds. */
+//#define FCB_PROFILING
+
+/* Histogram bin k counts durations in [2^k, 2^(k+1)) cycles, the first bin also 0 and 1, the last bin everything
+ * above. 2^23 cycles are 116 ms at 72 MHz. */
+#define PROFILE_HISTOGRAM_BINS      24
+
+/* The PROFILE_STATS_MSG_ENUM message, one per probe, encoded without generated nanopb code:
+ *   message ProfileProbeProto {
+ *     optional uint32 probe = 1;                       // ProfileProbe_TypeDef
+ *     optional uint32 count = 2;                       // Number of measurements
+ *     optional uint32 min_cycles = 3;
+ *     optional uint32 max_cycles = 4;
+ *     optional uint32 mean_cycles = 5;
+ *     optional uint32 core_clock = 6;                  // [Hz], to convert the cycles to time
+ *     repeated uint32 histogram = 7 [packed = true];   // See PROFILE_HISTOGRAM_BINS
+ *   } */
+
+/* Worst case size of the message: tag and varint of the six scalars, the histogram tag, length and varints */
+#define PROFILE_PROBE_MSG_MAX_SIZE  (6*(1 + 5) + 1 + 1 + 5*PROFILE_HISTOGRAM_BINS)
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Measured code sections */
+typedef enum {
+	PROFILE_PROBE_PREDICTION = 0,   // UpdatePredictionState()
+	PROFILE_PROBE_CORRECTION,       // UpdateCorrectionState()
+	PROFILE_PROBE_PID,              // UpdatePIDControlSignals()
+	PROFILE_PROBE_MOTOR_ALLOCATION, // MotorAllocationPhysical()
+	PROFILE_PROBE_GYRO_FETCH,       // FetchDataFromGyroscope() and FetchDMADataFromGyroscope()
+	PROFILE_PROBE_GYRO_DRDY_ISR,    // GyroscopeDataReadyFromISR()
+	PROFILE_PROBE_GYRO_DMA_ISR,     // GyroscopeDMACompleteFromISR()
+	PROFILE_PROBE_REF_SIGNALS,      // SetRefSignals()
+	PROFILE_PROBE_BARO_FETCH,       // HandleBarometerReadComplete()
+	PROFILE_PROBE_NBR
+} ProfileProbe_TypeDef;
+
+typedef struct {
+	uint32_t count;                                 // Number of measurements
+	uint32_t min;                                   // [core clock cycles]
+	uint32_t max;                                   // [core clock cycles]
+	uint64_t sum;                                   // [core clock cycles]
+	uint32_t histogram[PROFILE_HISTOGRAM_BINS];     // See PROFILE_HISTOGRAM_BINS
+} ProfileProbeStats_TypeDef;
+
+/* Statistics of all probes, copied at one instant */
+typedef struct {
+	ProfileProbeStats_TypeDef probe[PROFILE_PROBE_NBR];
+	uint32_t coreClock;                             // [Hz]
+} ProfileSnapshot_TypeDef;
+
+/* Open measurement of PROFILE_SCOPE() */
+typedef struct {
+	ProfileProbe_TypeDef probe;
+	uint32_t start;                                 // [core clock cycles]
+} ProfileScope_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+#ifdef FCB_PROFILING
+
+/* Measures from here to the end of the enclosing block, including early returns. Once per block. */
+#define PROFILE_SCOPE(PROBE)        ProfileScope_TypeDef profileScope __attribute__((cleanup(ProfileEndScope))) \
+                                            = { (PROBE), DWT->CYCCNT }
+
+/* Measures from PROFILE_BEGIN() to PROFILE_END() of the same probe in the same block */
+#define PROFILE_BEGIN(PROBE)        uint32_t profileStart##PROBE = DWT->CYCCNT
+#define PROFILE_END(PROBE)          ProfileRecord((PROBE), DWT->CYCCNT - profileStart##PROBE)
+
+#else
+
+#define PROFILE_SCOPE(PROBE)        ((void) 0)
+#define PROFILE_BEGIN(PROBE)        ((void) 0)
+#define PROFILE_END(PROBE)          ((void) 0)
+
+#endif /* FCB_PROFILING */
+
+/* Exported function prototypes --------------------------------------------- */
+void ProfileRecord(const ProfileProbe_TypeDef probe, const uint32_t cycles);
+void ProfileEndScope(const ProfileScope_TypeDef* scope);
+void ProfileGetSnapshot(ProfileSnapshot_TypeDef* dstSnapshot, const bool reset);
+void ProfileGetProbeStats(const ProfileProbe_TypeDef probe, ProfileProbeStats_TypeDef* dstStats);
+void ProfileReset(void);
+size_t ProfilePrint(char* dst, const size_t dstSize, const ProfileSnapshot_TypeDef* snapshot);
+bool EncodeProfileProbe(pb_ostream_t* stream, const ProfileSnapshot_TypeDef* snapshot,
+		const ProfileProbe_TypeDef probe);
+
+#endif /* __PROFILER_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
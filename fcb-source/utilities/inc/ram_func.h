@@ -0,0 +1,41 @@
+/******************************************************************************
+ * @file    ram_func.h
+ * @author  Dragonfly
+ * @brief   Header file for running the time critical code from SRAM. At
+ *          72 MHz the flash needs two wait states and the STM32F303 has no
+ *          ART accelerator, so branchy code stalls on the instruction fetches
+ *          that miss the prefetch buffer. The estimator, controller, mixer and
+ *          gyroscope functions are marked RAMFUNC on their prototypes and
+ *          definitions, compare their PROFILE_PROBE_* cycles in builds with
+ *          and without FCB_RAM_FUNC.
+ ******************************************************************************/
+
+#ifndef __RAM_FUNC_H
+#define __RAM_FUNC_H
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Uncomment to run the RAMFUNC functions from SRAM. They are placed in a .data input section, so the startup code
+ * copies them with the initialized data and the linker scripts need no changes. The code takes SRAM from the heap
+ * and the static data, see the size of .data in the map file. */
+//#define FCB_RAM_FUNC
+
+/* Exported macro ------------------------------------------------------------*/
+#ifdef FCB_RAM_FUNC
+/* The SRAM is out of the branch range of the flash, the long call reaches it through a register. Not inlined, or
+ * the code would run from the flash caller. */
+#define RAMFUNC                     __attribute__((section(".data.ramfunc"), long_call, noinline))
+#else
+#define RAMFUNC
+#endif /* FCB_RAM_FUNC */
+
+#endif /* __RAM_FUNC_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,95 @@
+/******************************************************************************
+ * @file    rate_groups.h
+ * @author  Dragonfly
+ * @brief   Header file for the rate groups, the common scheduler of periodic
+ *          work. Each group runs its jobs at a fixed rate derived from the
+ *          RTOS tick, so the periods of all groups are multiples of one tick
+ *          and do not drift against each other. A job is registered at
+ *          startup into a group with a phase, the tick within the group
+ *          period it is released on, so that the heavy jobs of a group can be
+ *          spread over its period instead of all being released together.
+ *
+ *          The groups share two tasks, so that they cost two stacks at most:
+ *          the 1 kHz, 200 Hz and 50 Hz groups run in the fast task, the 20 Hz
+ *          and 1 Hz groups in the slow one, one priority lower. A fast group
+ *          pre-empts the slow ones but never the other way round, and within
+ *          a task the jobs of the faster group released together run first.
+ *          Both tasks run below the sensors, the flight control and the high
+ *          deferred work worker, and above the communication tasks. A release
+ *          of a job whose previous release has not been run yet is skipped
+ *          and counted, and so is a run that ends after the next release was
+ *          due, e.g. behind a long job of a slower group of its task.
+ *
+ *          The sensor sampling, the state prediction and the barometer
+ *          conversions keep their hardware timers, since they need a finer
+ *          timing than the tick.
+ ******************************************************************************/
+
+#ifndef __RATE_GROUPS_H
+#define __RATE_GROUPS_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "fcb_retval.h"
+
+#include "FreeRTOS.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define RATE_GROUP_MAX_JOBS                 10      // At most 32, the pending jobs of a group are a bit mask
+#define RATE_GROUP_INVALID_ID               0xFF
+
+/* Group periods [ms], one tick each */
+#define RATE_GROUP_1KHZ_PERIOD              1
+#define RATE_GROUP_200HZ_PERIOD             5
+#define RATE_GROUP_50HZ_PERIOD              20
+#define RATE_GROUP_20HZ_PERIOD              50
+#define RATE_GROUP_1HZ_PERIOD               1000
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Rate groups in priority order, the fastest first */
+typedef enum {
+	RATE_GROUP_1KHZ = 0,
+	RATE_GROUP_200HZ,
+	RATE_GROUP_50HZ,
+	RATE_GROUP_20HZ,
+	RATE_GROUP_1HZ,
+	RATE_GROUP_NBR
+} RateGroup_TypeDef;
+
+typedef void (*RateGroupJob_TypeDef)(void* argument);
+
+typedef uint8_t RateGroupJobId_TypeDef;
+
+typedef struct {
+	uint32_t releases;                  // Releases, including the skipped ones
+	uint32_t skipped;                   // Releases of a job whose previous release had not been run yet
+	uint32_t runs;                      // Job runs
+	uint32_t late;                      // Runs that ended after the next release was due
+	uint32_t maxLatency;                // Max time from the release to the start of the run [core clock cycles]
+	uint32_t maxRunTime;                // Max time of a job run [core clock cycles]
+} RateGroupJobStats_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported function prototypes --------------------------------------------- */
+FcbRetValType RateGroupRegister(const char* name, const RateGroupJob_TypeDef job, void* argument,
+		const RateGroup_TypeDef group, const uint16_t phase, RateGroupJobId_TypeDef* dstId);
+void RateGroupTickHook(void);
+void RateGroupGetStats(const RateGroupJobId_TypeDef id, RateGroupJobStats_TypeDef* dstStats);
+void RateGroupReset(void);
+size_t RateGroupPrint(char* dst, const size_t dstSize);
+
+#endif /* __RATE_GROUPS_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,61 @@
+/******************************************************************************
+ * @file    ring_buffer.h
+ * @author  Dragonfly
+ * @brief   Header file for single producer, single consumer ring buffers
+ ******************************************************************************/
+
+#ifndef __RING_BUFFER_H
+#define __RING_BUFFER_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "buffer_monitor.h"
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Max ring buffer size, the free running 16 bit indices must be able to tell a full buffer from an empty one */
+#define RING_BUFFER_MAX_SIZE            32768
+
+/* Exported types ------------------------------------------------------------*/
+
+/* The head is only written by the producer and the tail only by the consumer, so one ISR or task may put data while
+ * another one gets data without a lock. Both indices run freely and are masked when the array is accessed. */
+typedef struct {
+	uint8_t* bufferArray;      // Pointer to buffer storage array
+	uint16_t mask;             // Buffer storage array size - 1, the size being a power of two
+	volatile uint16_t head;    // Index of the next byte to put, written by the producer only
+	volatile uint16_t tail;    // Index of the next byte to get, written by the consumer only
+	BufferStats_TypeDef stats; // Occupancy, written by the producer only, see buffer_monitor.h
+} RingBuffer_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported function prototypes --------------------------------------------- */
+ErrorStatus RingBufferInit(RingBuffer_TypeDef* ring, uint8_t* bufferArray, const uint16_t bufferSize);
+uint16_t RingBufferGetUsed(const RingBuffer_TypeDef* ring);
+uint16_t RingBufferGetFree(const RingBuffer_TypeDef* ring);
+bool RingBufferIsEmpty(const RingBuffer_TypeDef* ring);
+
+/* Producer side */
+uint16_t RingBufferPeekWrite(RingBuffer_TypeDef* ring, uint8_t** span);
+void RingBufferCommitWrite(RingBuffer_TypeDef* ring, const uint16_t size);
+ErrorStatus RingBufferPutData(RingBuffer_TypeDef* ring, const uint8_t* data, const uint16_t size);
+void RingBufferRecordFull(RingBuffer_TypeDef* ring);
+
+/* Consumer side */
+uint16_t RingBufferPeekRead(RingBuffer_TypeDef* ring, uint8_t** span);
+void RingBufferCommitRead(RingBuffer_TypeDef* ring, const uint16_t size);
+uint16_t RingBufferGetData(RingBuffer_TypeDef* ring, uint8_t* dst, const uint16_t maxSize);
+uint16_t RingBufferGetUntil(RingBuffer_TypeDef* ring, uint8_t* dst, const uint16_t maxSize, const uint8_t delimiter);
+
+#endif /* __RING_BUFFER_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
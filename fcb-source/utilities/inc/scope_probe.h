@@ -0,0 +1,107 @@
+/******************************************************************************
+ * @file    scope_probe.h
+ * @author  Dragonfly
+ * @brief   Header file for the scope probe stage markers, which drive spare
+ *          GPIO pins or the DAC output at the stages of the sensor to motor
+ *          pipeline, so that their timing can be measured with an
+ *          oscilloscope or a logic analyzer. A mapping table selects the
+ *          output of each stage at run time.
+ ******************************************************************************/
+
+#ifndef __SCOPE_PROBE_H
+#define __SCOPE_PROBE_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Uncomment one to compile the stage markers in. GPIO marks the stages on SCOPE_PROBE_GPIO_CHANNELS spare pins, PC6
+ * to PC9 on the P2 header of the discovery board. DAC writes the code of the stage to DAC1 channel 1 on PA4, so that
+ * one probe shows the sequence of the stages. Leave both commented for flight builds. */
+//#define FCB_SCOPE_PROBE_GPIO
+//#define FCB_SCOPE_PROBE_DAC
+
+#if defined(FCB_SCOPE_PROBE_GPIO) && defined(FCB_SCOPE_PROBE_DAC)
+#error "Select either FCB_SCOPE_PROBE_GPIO or FCB_SCOPE_PROBE_DAC"
+#endif
+
+#if defined(FCB_SCOPE_PROBE_GPIO) || defined(FCB_SCOPE_PROBE_DAC)
+#define FCB_SCOPE_PROBE
+#endif
+
+#define SCOPE_PROBE_GPIO_PORT               GPIOC
+#define SCOPE_PROBE_GPIO_CLK_ENABLE()       __GPIOC_CLK_ENABLE()
+#define SCOPE_PROBE_GPIO_CHANNELS           4           // PC6, PC7, PC8, PC9
+
+/* DAC level of a stage code, 12-bit right aligned. Stage s is shown as (s + 1)*SCOPE_PROBE_DAC_STEP, 0 when idle. */
+#define SCOPE_PROBE_DAC_STEP                512
+
+#define SCOPE_PROBE_CHANNEL_NONE            0xFF        // Stage not marked
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Marked pipeline stages */
+typedef enum {
+	SCOPE_PROBE_STAGE_DRDY = 0,         // Gyroscope DRDY EXTI handler, high while it runs
+	SCOPE_PROBE_STAGE_FETCH,            // Gyroscope sample fetched and converted, toggles
+	SCOPE_PROBE_STAGE_PREDICTION,       // UpdatePredictionState(), high while it runs
+	SCOPE_PROBE_STAGE_CORRECTION,       // UpdateCorrectionState(), high while it runs
+	SCOPE_PROBE_STAGE_PID,              // UpdatePIDControlSignals(), high while it runs
+	SCOPE_PROBE_STAGE_MOTOR,            // SetMotors() output commit, toggles
+	SCOPE_PROBE_STAGE_NBR
+} ScopeProbeStage_TypeDef;
+
+/* Open marker of SCOPE_PROBE_SCOPE() */
+typedef struct {
+	ScopeProbeStage_TypeDef stage;
+	uint32_t previous;                  // DAC level before the stage
+} ScopeProbeScope_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+#ifdef FCB_SCOPE_PROBE
+
+/* Marks from here to the end of the enclosing block, including early returns. Once per block. */
+#define SCOPE_PROBE_SCOPE(STAGE)        ScopeProbeScope_TypeDef scopeProbeScope \
+                                                __attribute__((cleanup(ScopeProbeEndScope))) \
+                                                = { (STAGE), ScopeProbeBegin(STAGE) }
+
+/* Marks from SCOPE_PROBE_BEGIN() to SCOPE_PROBE_END() of the same stage in the same block */
+#define SCOPE_PROBE_BEGIN(STAGE)        uint32_t scopeProbePrevious##STAGE = ScopeProbeBegin(STAGE)
+#define SCOPE_PROBE_END(STAGE)          ScopeProbeEnd((STAGE), scopeProbePrevious##STAGE)
+
+/* Marks an instant, an edge on GPIO and a step to the stage code on the DAC */
+#define SCOPE_PROBE_MARK(STAGE)         ScopeProbeMark(STAGE)
+
+#else
+
+#define SCOPE_PROBE_SCOPE(STAGE)        ((void) 0)
+#define SCOPE_PROBE_BEGIN(STAGE)        ((void) 0)
+#define SCOPE_PROBE_END(STAGE)          ((void) 0)
+#define SCOPE_PROBE_MARK(STAGE)         ((void) 0)
+
+#endif /* FCB_SCOPE_PROBE */
+
+/* Exported function prototypes --------------------------------------------- */
+void InitScopeProbe(void);
+uint32_t ScopeProbeBegin(const ScopeProbeStage_TypeDef stage);
+void ScopeProbeEnd(const ScopeProbeStage_TypeDef stage, const uint32_t previous);
+void ScopeProbeEndScope(const ScopeProbeScope_TypeDef* scope);
+void ScopeProbeMark(const ScopeProbeStage_TypeDef stage);
+void SetScopeProbeChannel(const ScopeProbeStage_TypeDef stage, const uint8_t channel);
+uint8_t GetScopeProbeChannel(const ScopeProbeStage_TypeDef stage);
+const char* GetScopeProbeStageName(const ScopeProbeStage_TypeDef stage);
+size_t ScopeProbePrint(char* dst, const size_t dstSize);
+
+#endif /* __SCOPE_PROBE_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,148 @@
+/******************************************************************************
+ * @file    sd_card.h
+ * @brief   Header file for the microSD card driver, in SPI mode, and its media
+ *          driver glue for the FAT-SL filesystem. Sectors written one after
+ *          the other are streamed as one multiple block write (CMD25), each
+ *          sector sent by DMA from one of two buffers while the next one is
+ *          copied to the other, so that a flight log is written at the card's
+ *          sequential rate instead of waiting for the programming of every
+ *          single sector. The stream is stopped by the first access that does
+ *          not follow it, a read, or SdCardFlush(). Reads are polled. Not
+ *          thread safe, the card is used by one task only.
+ ******************************************************************************/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SD_CARD_H
+#define __SD_CARD_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "stm32f3xx_hal.h"
+
+#include "fcb_retval.h"
+#include "api_mdriver.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Uncomment when a microSD socket is wired to SD_CARD_SPI, the blackbox then logs to files on the card */
+//#define FCB_SD_CARD
+
+/* Exported constants --------------------------------------------------------*/
+
+/* SPI2 on PB13 (SCK), PB14 (MISO) and PB15 (MOSI), chip select on PB10. The SPI2 TX DMA request is on DMA1 channel 5,
+ * the RX request on channel 4. The card's MISO needs the pull-up, a card in SPI mode leaves it floating when
+ * deselected. */
+#define SD_CARD_SPI                     SPI2
+#define SD_CARD_SPI_CLK_ENABLE()        __SPI2_CLK_ENABLE()
+#define SD_CARD_SPI_GPIO_CLK_ENABLE()   __GPIOB_CLK_ENABLE()
+#define SD_CARD_SPI_GPIO_PORT           GPIOB
+#define SD_CARD_SPI_SCK_PIN             GPIO_PIN_13
+#define SD_CARD_SPI_MISO_PIN            GPIO_PIN_14
+#define SD_CARD_SPI_MOSI_PIN            GPIO_PIN_15
+#define SD_CARD_SPI_AF                  GPIO_AF5_SPI2
+#define SD_CARD_CS_GPIO_PORT            GPIOB
+#define SD_CARD_CS_PIN                  GPIO_PIN_10
+
+#define SD_CARD_SPI_DMA_CLK_ENABLE()    __DMA1_CLK_ENABLE()
+#define SD_CARD_SPI_TX_DMA_CHANNEL      DMA1_Channel5 // SPI2_TX request
+#define SD_CARD_SPI_DMA_TX_IRQn         DMA1_Channel5_IRQn
+#define SD_CARD_SPI_DMA_TX_IRQHandler   DMA1_Channel5_IRQHandler
+#define SD_CARD_SPI_DMA_IRQ_PREEMPT_PRIO 10 // Gives the DMA semaphore, so at or below the syscall priority
+#define SD_CARD_SPI_DMA_IRQ_SUB_PRIO    0
+
+/* The card is identified at at most 400 kHz, then clocked at 18 MHz (PCLK1/2), the limit of the default speed mode
+ * is 25 MHz */
+#define SD_CARD_SPI_INIT_PRESCALER      SPI_BAUDRATEPRESCALER_128
+#define SD_CARD_SPI_PRESCALER           SPI_BAUDRATEPRESCALER_2
+
+#define SD_CARD_SECTOR_SIZE             512
+#define SD_CARD_INIT_TIMEOUT            1000    // [ms] For the card to leave the idle state, ACMD41
+#define SD_CARD_READ_TIMEOUT            100     // [ms] For the data token of a read
+#define SD_CARD_BUSY_TIMEOUT            500     // [ms] For the programming of a block, the specification allows 250 ms
+#define SD_CARD_DMA_TIMEOUT             10      // [ms] For the DMA of a block, 230 us at 18 MHz
+
+/* Exported types ------------------------------------------------------------*/
+
+typedef enum {
+    SD_CARD_NONE = 0,               // Not initialised, or no card answered
+    SD_CARD_SDV1,                   // Version 1 standard capacity
+    SD_CARD_SDSC,                   // Version 2 standard capacity, byte addressed
+    SD_CARD_SDHC,                   // Version 2 high or extended capacity, sector addressed
+    SD_CARD_TYPE_NBR
+} SdCardType;
+
+typedef struct {
+    SdCardType type;
+    uint32_t sectors;               // Card capacity [sectors]
+    uint32_t sectorsWritten;        // Since the card was initialised
+    uint32_t sectorsRead;           // Since the card was initialised
+    uint32_t multiBlockWrites;      // Streams of written sectors, CMD25, since the card was initialised
+    uint32_t errors;                // Failed commands, transfers and timeouts, since startup
+    uint32_t maxBusyTime;           // Longest wait for a block to be programmed [ms]
+} SdCardStats_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions ------------------------------------------------------- */
+
+/**
+ * Configures the SPI and identifies the card. Also done to recover from an
+ * error or a card change, the statistics except the errors restart.
+ *
+ * @return FCB_OK if a card is ready, FCB_ERR_INIT if none answered or it is
+ *         not supported
+ */
+FcbRetValType SdCardInit(void);
+
+/**
+ * Writes a sector. A sector that follows the previously written one continues
+ * the multiple block write, the call then returns once the previous sector is
+ * programmed and this one is being sent. The data is copied, it may be reused
+ * when the call returns.
+ *
+ * @param data SD_CARD_SECTOR_SIZE bytes to write
+ * @param sector sector number
+ * @return FCB_OK if written, FCB_ERR if this or the previous sector of the
+ *         stream failed, the card then has to be initialised again
+ */
+FcbRetValType SdCardWriteSector(const uint8_t* data, const uint32_t sector);
+
+FcbRetValType SdCardReadSector(uint8_t* dst, const uint32_t sector);
+
+/**
+ * Ends an ongoing multiple block write and waits for the card to program the
+ * last sector, so that all written data is on the card.
+ *
+ * @return FCB_OK if flushed, FCB_ERR if the last sector failed
+ */
+FcbRetValType SdCardFlush(void);
+
+/**
+ * Initialises the FAT-SL media driver of the card, see F_DRIVERINIT. The card
+ * is to be initialised by SdCardInit() first.
+ *
+ * @param driverParam unused
+ * @return the driver, NULL if the card is not initialised
+ */
+F_DRIVER* SdCardDriverInit(unsigned long driverParam);
+
+bool SdCardIsReady(void);
+bool SdCardIsSPIHandle(const SPI_HandleTypeDef* hspi);
+void SdCardDMACompleteFromISR(void);
+void SdCardDMAErrorFromISR(void);
+void SdCardDmaIRQHandler(void);
+void GetSdCardStats(SdCardStats_TypeDef* dstStats);
+const char* GetSdCardTypeName(const SdCardType type);
+
+#endif /* __SD_CARD_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
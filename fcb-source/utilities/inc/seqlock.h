@@ -0,0 +1,58 @@
+/******************************************************************************
+ * @file    seqlock.h
+ * @author  Dragonfly
+ * @brief   Header file for double buffered sequence locks protecting small
+ *          shared data that has a single writer
+ ******************************************************************************/
+
+#ifndef __SEQLOCK_H
+#define __SEQLOCK_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Exported types ------------------------------------------------------------*/
+
+/*
+ * The guarded data is kept in two copies. The writer fills the copy that is
+ * not published and publishes it by incrementing the sequence, so a reader
+ * always finds a stable copy and never waits for the writer. A reader retries
+ * only if the writer published again while it copied, i.e. if the writer
+ * preempted it.
+ *
+ * Usage, writer:
+ *   copy = SeqLockWriteBegin(&lock); ...update data[copy]...; SeqLockWriteEnd(&lock);
+ * reader:
+ *   do { seq = SeqLockReadBegin(&lock); ...copy data[SEQLOCK_COPY(seq)]...; } while (SeqLockReadRetry(&lock, seq));
+ */
+typedef struct {
+	volatile uint32_t sequence;
+} SeqLock_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Index of the copy of the data that a sequence publishes */
+#define SEQLOCK_COPY(SEQUENCE)      ((SEQUENCE) & 1)
+
+/* Index of the latest published copy, for the writer that reads its own data back */
+#define SEQLOCK_PUBLISHED(LOCK)     SEQLOCK_COPY((LOCK)->sequence)
+
+/* Exported function prototypes --------------------------------------------- */
+uint32_t SeqLockWriteBegin(SeqLock_TypeDef* lock);
+void SeqLockWriteEnd(SeqLock_TypeDef* lock);
+uint32_t SeqLockReadBegin(SeqLock_TypeDef* lock);
+bool SeqLockReadRetry(SeqLock_TypeDef* lock, const uint32_t startSequence);
+
+#endif /* __SEQLOCK_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
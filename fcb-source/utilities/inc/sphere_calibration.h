@@ -11,10 +11,32 @@
 #ifndef __SPHERE_CALIBRATION_H
 #define __SPHERE_CALIBRATION_H
 
+#include "fcb_retval.h"
+
 #include <arm_math.h>
+#include <stdint.h>
+
+/* The sums of the observations are exact integers. With the sample magnitude limited to 12 bits, the largest sums, of
+ * products of squares, fit in 64 bits for up to 2^19 samples. */
+#define SPHERE_MAX_SAMPLE_MAGNITUDE 2048
+#define SPHERE_MAX_SAMPLES          (1UL << 19)
+
+//observation summary, the sufficient statistics of the samples for the sphere fit
+typedef struct {
+	int64_t mu[3]; //sum of all observations in each dimension
+	int64_t mu2[3];  //sum of squares of all observations in each dimension
+	int64_t ipXX[6]; //Symmetric matrix of inner products of observations with themselves
+	int64_t ipX2X[3][3]; //matrix of inner products of squares of observations with the observations
+	int64_t ipX2X2[6]; //Symmetric matrix of inner products of squares of observations with themselves
+	int32_t N;  //The number of observations
 
+	int16_t obsMin[3]; // Keep track of min observation in each dimension to guess parameters
+	int16_t obsMax[3]; // Keep track of max observation in each dimension to guess parameters
+} SphereObservations_TypeDef;
 
-void addNewSample(const float32_t samples[3]);
-void calibrate(float32_t calibParams[6]);
+void addNewSample(const int16_t samples[3]);
+void clearObservationMatrices(void);
+void takeObservations(SphereObservations_TypeDef* observations);
+FcbRetValType calibrate(const SphereObservations_TypeDef* observations, float32_t scale, float32_t calibParams[6]);
 
 #endif /* __SPHERE_CALIBRATION_H */
@@ -9,17 +9,69 @@
 #ifndef TASK_STATUS_H
 #define TASK_STATUS_H
 
+/* Includes ------------------------------------------------------------------*/
+#include "FreeRTOS.h"
+#include "pb_encode.h"
+#include "rate_groups.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
 /* Exported constants --------------------------------------------------------*/
-#define TASK_STATUS_TIM	                    TIM15
-#define TASK_STATUS_TIM_CLK_ENABLE()        __TIM15_CLK_ENABLE()
-#define	TASK_STATUS_TIM_CLK_DISABLE()       __TIM15_CLK_DISABLE()
-#define TASK_STATUS_TIM_IRQn	            TIM15_IRQn
-#define TASK_STATUS_TIM_IRQHandler	        TIM15_IRQHandler
-#define TASK_STATUS_TIM_IRQ_PREEMPT_PRIO    0
-#define TASK_STATUS_TIM_IRQ_SUB_PRIO        0
+#define TASK_STATUS_MAX_TASKS               12      // The tasks of a build with all options, more are not sampled
+#define TASK_STATUS_SAMPLE_PERIOD           RATE_GROUP_1HZ_PERIOD // [ms]
+#define TASK_STATUS_SAMPLE_PHASE            510     // [ms] in the rate group, clear of the 20 Hz releases
+#define TASK_STATUS_WINDOW_SAMPLES          3       // Samples kept, the load window is one period less
+#define TASK_STATUS_LOW_STACK               64      // [bytes] Tasks with less free stack are marked in the table
+
+/* The run time counter is the 32 bit DWT cycle counter, which wraps every 2^32 / SystemCoreClock, about 59 s at 72 MHz.
+ * Differences of counter values are exact over shorter intervals, so the load window must stay well below that. */
+#if TASK_STATUS_SAMPLE_PERIOD*(TASK_STATUS_WINDOW_SAMPLES - 1) > 30000
+#error "The task load window must be shorter than the run time counter wrap"
+#endif
+
+/* The TASK_STATUS_MSG_ENUM message, encoded without generated nanopb code and sent once per sample:
+ *   message TaskStatusProto {
+ *     optional uint32 heap_total = 1;              // [bytes]
+ *     optional uint32 heap_free = 2;               // [bytes]
+ *     optional uint32 heap_min_free = 3;           // Least free heap since startup [bytes]
+ *     optional uint32 failed_allocations = 4;      // Since startup
+ *     optional uint32 window = 5;                  // Load window [ms]
+ *     repeated TaskUsageProto tasks = 6;           // As many as fit, the rest in the next message
+ *     optional uint32 runtime_allocations = 7;     // Allocations after the scheduler was started
+ *   }
+ *   message TaskUsageProto {
+ *     optional string name = 1;
+ *     optional uint32 stack_free = 2;              // Least free stack since the task was created [bytes]
+ *     optional uint32 load = 3;                    // Share of the window running [0.01 %]
+ *   } */
+
+/* Worst case size of a TaskUsageProto submessage with its tag and length */
+#define TASK_USAGE_MSG_MAX_SIZE             (2 + 2 + configMAX_TASK_NAME_LEN + 1 + 3 + 1 + 3)
+
+/* Exported types ------------------------------------------------------------*/
 
-/* Exported variables --------------------------------------------------------*/
-TIM_HandleTypeDef    TaskStatusTimHandle;
+/* Status of a task over the load window */
+typedef struct {
+	char name[configMAX_TASK_NAME_LEN];
+	unsigned portBASE_TYPE priority;
+	uint16_t load;                  // Share of the window running [0.01 %]
+	uint32_t contextSwitches;       // Times switched in during the window
+	uint16_t stackHighWaterMark;    // Least free stack since the task was created [bytes]
+} TaskStatus_TypeDef;
+
+/* Usage of the FreeRTOS heap, heap_2 */
+typedef struct {
+	size_t total;                   // configTOTAL_HEAP_SIZE less the alignment [bytes]
+	size_t free;                    // [bytes]
+	size_t minimumEverFree;         // Least free since startup [bytes]
+	uint32_t allocations;           // Successful pvPortMalloc calls since startup
+	uint32_t frees;                 // vPortFree calls since startup
+	uint32_t failedAllocations;     // Failed pvPortMalloc calls since startup
+	size_t lastFailedSize;          // Size of the last failed request with its block header [bytes], 0 if none
+	uint32_t runtimeAllocations;    // Successful pvPortMalloc calls after the scheduler was started
+	uint32_t runtimeFrees;          // vPortFree calls after the scheduler was started
+} HeapStatus_TypeDef;
 
 /* Exported functions ------------------------------------------------------- */
 void InitMonitoring(void);
@@ -28,8 +80,20 @@ unsigned getRunTimeCounterValue(void);
 
 void configureTimerForRunTimeStats(void);
 
-void IncreaseTaskStatusTimerPeriodCount(void);
+uint8_t GetTaskStatus(TaskStatus_TypeDef* dstStatus, const uint8_t maxTasks, uint32_t* windowLength);
+
+bool GetTaskStatusByIndex(const uint8_t index, TaskStatus_TypeDef* dstStatus, uint32_t* windowLength);
+
+uint16_t GetMinStackHighWaterMark(void);
+
+bool TaskStatusPrintNext(char* dst, const size_t dstSize);
+
+void GetHeapStatus(HeapStatus_TypeDef* dstStatus);
+
+bool EncodeTaskStatus(pb_ostream_t* stream);
+
+void TaskStatusTraceMalloc(void* block, const size_t size);
 
-uint32_t GetTaskStatusTimerPeriodCount(void);
+void TaskStatusTraceFree(void* block, const size_t size);
 
 #endif
@@ -0,0 +1,103 @@
+/******************************************************************************
+ * @file    task_watchdog.h
+ * @author  Dragonfly
+ * @brief   Header file for the task watchdog. The independent watchdog (IWDG)
+ *          resets the board unless it is fed within TASK_WATCHDOG_TIMEOUT,
+ *          and a supervisor job feeds it only while every registered
+ *          critical task has checked in within its deadline. A deadlocked
+ *          mutex, a stuck bus transfer or a task spinning in a loop thus ends
+ *          in a reset instead of the motors holding their last outputs.
+ *
+ *          A critical task registers itself before its loop and then checks
+ *          in on every iteration. When a task misses its deadline, the
+ *          supervisor stores a crash dump with the name of the task and the
+ *          registers it was switched out with, see CrashDumpFromWatchdog(),
+ *          and stops feeding, so the IWDG resets the board. The supervisor
+ *          runs in the 20 Hz rate group, so a task that spins above its
+ *          priority or runs with the interrupts disabled starves it, and the
+ *          IWDG resets the board without a dump.
+ *
+ *          A reset by the IWDG is latched at startup and keeps the UAV from
+ *          arming until it is cleared, see IsWatchdogResetPending(). The IWDG
+ *          runs from the LSI clock, it is stopped while the core is halted by
+ *          a debugger but cannot be stopped otherwise once started.
+ ******************************************************************************/
+
+#ifndef __TASK_WATCHDOG_H
+#define __TASK_WATCHDOG_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "rate_groups.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Uncomment to start the IWDG and its supervisor, see above. The check-ins and the reset latch work without it. */
+//#define FCB_TASK_WATCHDOG
+
+#define TASK_WATCHDOG_PERIOD            RATE_GROUP_20HZ_PERIOD  // [ms] of the supervisor
+#define TASK_WATCHDOG_PHASE             0       // [ms] in the rate group
+#define TASK_WATCHDOG_TIMEOUT           500     // [ms] of the IWDG at the nominal LSI clock, 30 to 50 kHz
+#define TASK_WATCHDOG_PRESCALER         64      // IWDG_PRESCALER_64
+#define TASK_WATCHDOG_RELOAD            ((TASK_WATCHDOG_TIMEOUT*LSI_VALUE)/(TASK_WATCHDOG_PRESCALER*1000)) // 12 bits
+
+/* Deadlines of the critical tasks, above the longest flash page erase, in which the CPU stalls */
+#define TASK_WATCHDOG_SENSORS_DEADLINE          200     // [ms]
+#define TASK_WATCHDOG_FLIGHT_CONTROL_DEADLINE   200     // [ms]
+#define TASK_WATCHDOG_RECEIVER_DEADLINE         200     // [ms]
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+	TASK_WATCHDOG_SENSORS = 0,
+	TASK_WATCHDOG_FLIGHT_CONTROL,   // Checked in by the SENSORS task with FCB_FUSED_SENSOR_PIPELINE
+	TASK_WATCHDOG_RECEIVER,         // RC_PWM_DECODE, RECEIVER_PWM_DEFERRED_DECODING only
+	TASK_WATCHDOG_NBR
+} TaskWatchdogId_TypeDef;
+
+/* Exported function prototypes --------------------------------------------- */
+
+/**
+ * Latches a reset by the IWDG and starts the supervisor, which starts the IWDG
+ * once the scheduler runs. Called at startup before InitCrashDump(), which
+ * clears the reset flags.
+ */
+void InitTaskWatchdog(void);
+
+/**
+ * Starts watching the calling task, which is to check in from now on.
+ *
+ * @param id task
+ */
+void TaskWatchdogRegister(const TaskWatchdogId_TypeDef id);
+
+/**
+ * Checks in the calling task, without any lock. Called on every iteration of
+ * its loop.
+ *
+ * @param id task
+ */
+void TaskWatchdogCheckIn(const TaskWatchdogId_TypeDef id);
+
+/**
+ * @return true if the last reset was by the IWDG and it is not cleared yet,
+ *         the UAV is not armed then
+ */
+bool IsWatchdogResetPending(void);
+void ClearWatchdogReset(void);
+
+size_t PrintTaskWatchdog(char* dst, const size_t dstSize);
+
+#endif /* __TASK_WATCHDOG_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
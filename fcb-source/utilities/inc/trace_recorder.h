@@ -0,0 +1,110 @@
+/******************************************************************************
+ * @file    trace_recorder.h
+ * @author  Dragonfly
+ * @brief   Header file for the integration of the FreeRTOS+Trace recorder
+ *          (Tracealyzer v2.5), which records the task switches, the queue and
+ *          semaphore events and the ISRs of the sensors, the state estimation
+ *          timer and the UART in RAM. Compiled in with FCB_TRACE_RECORDER, see
+ *          FreeRTOSConfig.h, and configured in trcConfig.h.
+ *
+ *          Snapshot mode: the events are kept in the RAM ring of the recorder,
+ *          the whole recorder data is sent over the USB log endpoint on
+ *          request, or read by the debugger, and opened as a trace dump.
+ *          Stream mode: the events are sent over the USB log endpoint as they
+ *          are recorded, and the recorder data without its events when the
+ *          stream starts and stops. The host puts the streamed events in place
+ *          of the event ring to get a trace longer than the ring.
+ ******************************************************************************/
+
+#ifndef __TRACE_RECORDER_H
+#define __TRACE_RECORDER_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+#include "fcb_retval.h"
+
+#include "FreeRTOS.h"
+
+#include <stdbool.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* The TRACE_DATA_MSG_ENUM message, encoded without generated nanopb code:
+ *   message TraceDataProto {
+ *     optional uint32 kind = 1;        // TraceDataKind_TypeDef
+ *     optional uint32 offset = 2;      // Recorder data: byte offset of data in it. Events: number of the first event.
+ *     optional uint32 size = 3;        // Recorder data: its total size [bytes]. Events: 4, the size of an event.
+ *     optional bytes data = 4;
+ *   } */
+
+#define TRACE_DATA_CHUNK_SIZE       128     // Data bytes per message, a multiple of the event size
+#define TRACE_DATA_MSG_MAX_SIZE     (3*(1 + 5) + 1 + 2 + TRACE_DATA_CHUNK_SIZE)
+
+/* Exported types ------------------------------------------------------------*/
+
+/* ISRs of the trace, the recorder handles start at 1. NISR in trcConfig.h is at least TRACE_ISR_NBR - 1. */
+typedef enum {
+	TRACE_ISR_GYRO_DRDY = 1,        // EXTI1, gyroscope data ready
+	TRACE_ISR_MAG_DRDY,             // EXTI2, magnetometer data ready
+	TRACE_ISR_ACC_DRDY,             // EXTI4, accelerometer data ready
+	TRACE_ISR_STATE_ESTIMATION,     // TIM7, STATE_ESTIMATION_UPDATE_TIM
+	TRACE_ISR_UART,                 // USART2, UART idle line
+	TRACE_ISR_NBR
+} TraceISR_TypeDef;
+
+typedef enum {
+	TRACE_MODE_SNAPSHOT = 0,        // Events kept in the RAM ring, sent on request
+	TRACE_MODE_STREAM               // Events sent over the USB log endpoint as they are recorded
+} TraceMode_TypeDef;
+
+typedef enum {
+	TRACE_DATA_RECORDER = 0,        // Part of the recorder data, RecorderDataType of trcBase.h
+	TRACE_DATA_EVENTS               // Streamed events
+} TraceDataKind_TypeDef;
+
+typedef struct {
+	bool isActive;                  // The recorder stores events
+	TraceMode_TypeDef mode;
+	uint32_t recordedEvents;        // Since the recorder was started
+	uint32_t streamedEvents;        // Stream mode: sent over the USB log endpoint since the stream started
+	uint32_t lostEvents;            // Stream mode: overwritten in the ring before they were sent
+	const char* error;              // Error of the recorder, NULL if none
+} TraceStatus_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+#ifdef FCB_TRACE_RECORDER
+
+/* Mark the beginning and the end of a traced ISR handler. A yield from the handler only pends the context switch, which
+ * is recorded after the end. */
+#define TRACE_ISR_BEGIN(ISR)            vTraceStoreISRBegin(ISR)
+#define TRACE_ISR_END()                 vTraceStoreISREnd()
+
+/* Names a queue, semaphore or mutex in the trace, right after it is created */
+#define TRACE_OBJECT_NAME(OBJECT, NAME) vTraceSetQueueName((OBJECT), (NAME))
+
+#else
+
+#define TRACE_ISR_BEGIN(ISR)            ((void) 0)
+#define TRACE_ISR_END()                 ((void) 0)
+#define TRACE_OBJECT_NAME(OBJECT, NAME) ((void) 0)
+
+#endif /* FCB_TRACE_RECORDER */
+
+/* Exported function prototypes --------------------------------------------- */
+void InitTraceRecorder(void);
+void CreateTraceTask(void);
+FcbRetValType StartTraceRecorder(const TraceMode_TypeDef mode);
+void StopTraceRecorder(void);
+FcbRetValType SendTraceSnapshot(void);
+void GetTraceStatus(TraceStatus_TypeDef* status);
+
+#endif /* __TRACE_RECORDER_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,66 @@
+/******************************************************************************
+ * @file    wake_latency.h
+ * @author  Dragonfly
+ * @brief   Header file for the wake latency monitor, which measures the time
+ *          from the signalling of a task to the task running, for the gyroscope
+ *          sample handoffs from the interrupts to the SENSORS task and from the
+ *          SENSORS task to the flight control task. The signalling side calls
+ *          WakeLatencySignal() where it gives the semaphore or sends to the
+ *          queue and the woken side WakeLatencyWoken() right after the take or
+ *          receive returns, so that any wake mechanism is measured the same way.
+ ******************************************************************************/
+
+#ifndef __WAKE_LATENCY_H
+#define __WAKE_LATENCY_H
+
+/* Includes -----------------------------------------------------------------*/
+#include "stm32f3xx.h"
+
+#include <stddef.h>
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Uncomment to compile the wake latency statistics in. Each handoff costs a cycle counter read on both sides, the
+ * statistics about 0.6 KB of RAM, leave commented for flight builds. */
+//#define FCB_WAKE_LATENCY
+
+/* Histogram bin k counts wake latencies in [k, k+1) us, the last bin everything above */
+#define WAKE_LATENCY_HISTOGRAM_BINS     64
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Measured handoffs */
+typedef enum {
+	WAKE_LATENCY_ISR_TO_SENSORS = 0,    // Gyroscope data ready or DMA complete interrupt to the SENSORS task
+	WAKE_LATENCY_SENSORS_TO_FLIGHT,     // Gyroscope sample in the mailbox to the flight control task, none with
+	                                    // FCB_FUSED_SENSOR_PIPELINE
+	WAKE_LATENCY_NBR
+} WakeLatencyHandoff_TypeDef;
+
+typedef struct {
+	uint32_t count;                                     // Number of wake-ups
+	uint32_t min;                                       // [core clock cycles]
+	uint32_t max;                                       // [core clock cycles]
+	uint64_t sum;                                       // [core clock cycles]
+	uint32_t histogram[WAKE_LATENCY_HISTOGRAM_BINS];    // See WAKE_LATENCY_HISTOGRAM_BINS
+} WakeLatencyStats_TypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported function prototypes --------------------------------------------- */
+void WakeLatencySignal(const WakeLatencyHandoff_TypeDef handoff, const uint32_t timestamp);
+void WakeLatencyWoken(const WakeLatencyHandoff_TypeDef handoff);
+void WakeLatencyGetStats(const WakeLatencyHandoff_TypeDef handoff, WakeLatencyStats_TypeDef* dstStats);
+void WakeLatencyReset(void);
+size_t WakeLatencyPrint(char* dst, const size_t dstSize);
+
+#endif /* __WAKE_LATENCY_H */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,149 @@
+/******************************************************************************
+ * @file    boot_timing.c
+ * @author  Dragonfly
+ * @brief   Boot phase timestamps. A phase is marked once, by the code that
+ *          completes it, with the 64-bit microsecond clock. The startup
+ *          report is printed by the get-boot-time command, and the time to
+ *          armable is also logged when the last phase is marked.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "boot_timing.h"
+
+#include "common.h"
+#include "deferred_log.h"
+
+#include "FreeRTOS.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+
+/* Indexed by BootPhase_TypeDef */
+static const char* bootPhaseNames[BOOT_PHASE_NBR] = { "System init", "Scheduler", "USB", "Sensors", "Estimator" };
+
+static uint64_t bootPhaseTimes[BOOT_PHASE_NBR];     // [us]
+static uint32_t bootPhasesMarked = 0;               // One bit per phase
+
+/* Private function prototypes -----------------------------------------------*/
+static void GetBootPhaseTimes(uint64_t* dstTimes, uint32_t* dstMarked);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Marks the completion of a boot phase, only the first mark of a phase is kept. Safe to call before the
+ *         scheduler is started.
+ * @param  phase : Boot phase
+ * @retval None
+ */
+void BootTimingMark(const BootPhase_TypeDef phase) {
+	unsigned portBASE_TYPE savedInterruptStatus;
+	uint64_t now = GetMicroseconds();
+	bool isFirstMark = false;
+
+	if (phase >= BOOT_PHASE_NBR) {
+		return;
+	}
+
+	savedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+	if (!(bootPhasesMarked & (1UL << phase))) {
+		bootPhaseTimes[phase] = now;
+		bootPhasesMarked |= 1UL << phase;
+		isFirstMark = true;
+	}
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(savedInterruptStatus);
+
+	if (isFirstMark && BOOT_PHASE_ESTIMATOR_INIT == phase) {
+		LOG1("Armable %lu ms after the clock setup, see get-boot-time", (uint32_t) (now / 1000));
+	}
+}
+
+/*
+ * @brief  Gets the time a boot phase completed
+ * @param  phase : Boot phase
+ * @param  dstTime : Destination time since InitTimestampCounter() [us]
+ * @retval true if the phase is completed, else false
+ */
+bool GetBootPhaseTime(const BootPhase_TypeDef phase, uint64_t* dstTime) {
+	uint64_t times[BOOT_PHASE_NBR];
+	uint32_t marked;
+
+	if (phase >= BOOT_PHASE_NBR) {
+		return false;
+	}
+
+	GetBootPhaseTimes(times, &marked);
+	*dstTime = times[phase];
+
+	return (marked & (1UL << phase)) != 0;
+}
+
+/*
+ * @brief  Prints the completion time of each boot phase and its time since the previous completed one
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @retval Length of the string
+ */
+size_t BootTimingPrint(char* dst, const size_t dstSize) {
+	uint64_t times[BOOT_PHASE_NBR];
+	uint64_t previousTime = 0;
+	uint32_t marked;
+	uint32_t time, delta;
+	size_t length;
+	uint8_t i;
+
+	GetBootPhaseTimes(times, &marked);
+
+	length = (size_t) snprintf(dst, dstSize, "\nBoot phases, completed after the clock setup in ms\n%-14s%12s%12s\n",
+			"Phase", "Done", "Step");
+
+	for (i = 0; i < BOOT_PHASE_NBR && length < dstSize; i++) {
+		if (!(marked & (1UL << i))) {
+			length += (size_t) snprintf(dst + length, dstSize - length, "%-14s%12s%12s\n", bootPhaseNames[i], "-",
+					"-");
+			continue;
+		}
+
+		/* The phases after the scheduler start overlap, a step is the time since the latest earlier completion */
+		time = (uint32_t) times[i];
+		delta = (times[i] > previousTime) ? (uint32_t) (times[i] - previousTime) : 0;
+		if (times[i] > previousTime) {
+			previousTime = times[i];
+		}
+		length += (size_t) snprintf(dst + length, dstSize - length, "%-14s%8lu.%03lu%8lu.%03lu\n", bootPhaseNames[i],
+				(unsigned long) (time / 1000), (unsigned long) (time % 1000), (unsigned long) (delta / 1000),
+				(unsigned long) (delta % 1000));
+	}
+
+	return length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Gets a consistent copy of the boot phase times
+ * @param  dstTimes : Destination times, BOOT_PHASE_NBR elements [us]
+ * @param  dstMarked : Destination bit mask of the completed phases
+ * @retval None
+ */
+static void GetBootPhaseTimes(uint64_t* dstTimes, uint32_t* dstMarked) {
+	unsigned portBASE_TYPE savedInterruptStatus;
+
+	savedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+	memcpy(dstTimes, bootPhaseTimes, sizeof(bootPhaseTimes));
+	*dstMarked = bootPhasesMarked;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(savedInterruptStatus);
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
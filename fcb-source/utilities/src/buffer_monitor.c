@@ -0,0 +1,215 @@
+/******************************************************************************
+ * @file    buffer_monitor.c
+ * @author  Dragonfly
+ * @brief   Buffer occupancy monitor. The producer of a buffer records the
+ *          level after each put and each put that did not fit, in a few
+ *          instructions and without locks since it is the only writer. The
+ *          buffers register their statistics at initialization, the reader
+ *          copies them without synchronization, which may mix one counter of
+ *          a put with the others of the previous one.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "buffer_monitor.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+	const char* name;
+	uint16_t capacity;              // [bytes or entries]
+	const BufferStats_TypeDef* stats;
+} BufferEntry_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+
+/* Written at initialization only */
+static BufferEntry_TypeDef buffers[BUFFER_MONITOR_MAX_BUFFERS];
+static uint8_t nbrOfBuffers = 0;
+
+/* First buffer of the next BUFFER_STATS_MSG_ENUM message */
+static uint8_t nextEncodedBuffer = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+static bool EncodeBufferStatus(pb_ostream_t* stream, const BufferStatus_TypeDef* status);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Registers the statistics of a buffer to be reported. Called once per buffer at initialization.
+ * @param  name : Static name string, reported up to BUFFER_NAME_LEN characters
+ * @param  capacity : Size of the buffer [bytes or entries]
+ * @param  stats : Statistics of the buffer, recorded by its producer
+ * @retval None
+ */
+void BufferMonitorRegister(const char* name, const uint16_t capacity, const BufferStats_TypeDef* stats) {
+	if (nbrOfBuffers >= BUFFER_MONITOR_MAX_BUFFERS) {
+		return;
+	}
+
+	buffers[nbrOfBuffers].name = name;
+	buffers[nbrOfBuffers].capacity = capacity;
+	buffers[nbrOfBuffers].stats = stats;
+	nbrOfBuffers++;
+}
+
+/*
+ * @brief  Clears the statistics of a buffer, when the buffer is initialized
+ * @param  stats : Statistics of the buffer
+ * @retval None
+ */
+void BufferStatsReset(BufferStats_TypeDef* stats) {
+	memset(stats, 0, sizeof(BufferStats_TypeDef));
+}
+
+/*
+ * @brief  Records the level of a buffer after a put, which ends a full period. Producer only.
+ * @param  stats : Statistics of the buffer
+ * @param  level : Stored bytes or entries after the put
+ * @retval None
+ */
+void BufferStatsRecordLevel(BufferStats_TypeDef* stats, const uint16_t level) {
+	if (level > stats->highWater) {
+		stats->highWater = level;
+	}
+	if (stats->isFull) {
+		stats->fullTime += HAL_GetTick() - stats->fullSince;
+		stats->isFull = false;
+	}
+}
+
+/*
+ * @brief  Records a put that did not fit, which starts a full period unless one is going on. Producer only.
+ * @param  stats : Statistics of the buffer
+ * @retval None
+ */
+void BufferStatsRecordFull(BufferStats_TypeDef* stats) {
+	stats->overflows++;
+	if (!stats->isFull) {
+		stats->fullSince = HAL_GetTick();
+		stats->isFull = true;
+	}
+}
+
+/*
+ * @brief  Gets the status of the registered buffers
+ * @param  dstStatus : Destination status, maxBuffers
+ * @param  maxBuffers : Size of dstStatus
+ * @retval Number of buffers copied
+ */
+uint8_t GetBufferStatus(BufferStatus_TypeDef* dstStatus, const uint8_t maxBuffers) {
+	uint8_t i = 0;
+
+	while (i < maxBuffers && GetBufferStatusByIndex(i, &dstStatus[i])) {
+		i++;
+	}
+
+	return i;
+}
+
+/*
+ * @brief  Gets the status of one registered buffer
+ * @param  index : Registration order of the buffer
+ * @param  dstStatus : Destination status
+ * @retval true if copied, false if fewer buffers are registered
+ */
+bool GetBufferStatusByIndex(const uint8_t index, BufferStatus_TypeDef* dstStatus) {
+	const BufferStats_TypeDef* stats;
+
+	if (index >= nbrOfBuffers) {
+		return false;
+	}
+
+	stats = buffers[index].stats;
+	strncpy(dstStatus->name, buffers[index].name, BUFFER_NAME_LEN);
+	dstStatus->name[BUFFER_NAME_LEN] = '\0';
+	dstStatus->capacity = buffers[index].capacity;
+	dstStatus->highWater = stats->highWater;
+	dstStatus->overflows = stats->overflows;
+	dstStatus->fullTime = stats->fullTime + (stats->isFull ? HAL_GetTick() - stats->fullSince : 0);
+
+	return true;
+}
+
+/*
+ * @brief  Prints the status of the registered buffers as a table
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @retval Length of the table string
+ */
+size_t BufferMonitorPrint(char* dst, const size_t dstSize) {
+	BufferStatus_TypeDef status;
+	size_t length;
+	uint8_t i;
+
+	length = (size_t) snprintf(dst, dstSize, "\nBuffer occupancy since startup\n%-14s%9s%9s%6s%11s%10s\n", "Buffer",
+			"Capacity", "High", "[%]", "Overflows", "Full[ms]");
+
+	for (i = 0; i < nbrOfBuffers && length < dstSize && GetBufferStatusByIndex(i, &status); i++) {
+		length += (size_t) snprintf(dst + length, dstSize - length, "%-14s%9u%9u%6u%11lu%10lu\n", status.name,
+				status.capacity, status.highWater, (0 == status.capacity) ? 0 : 100*status.highWater/status.capacity,
+				(unsigned long) status.overflows, (unsigned long) status.fullTime);
+	}
+
+	return length;
+}
+
+/*
+ * @brief  Encodes the status of as many registered buffers as fit as a BufferStatsProto message, see
+ *         buffer_monitor.h. The buffers that do not fit are sent in the next message.
+ * @param  stream : Destination stream
+ * @retval true if encoded, false if the stream is too small
+ */
+bool EncodeBufferStats(pb_ostream_t* stream) {
+	BufferStatus_TypeDef status;
+	uint8_t i;
+
+	for (i = (nextEncodedBuffer < nbrOfBuffers) ? nextEncodedBuffer : 0; i < nbrOfBuffers; i++) {
+		if (stream->max_size - stream->bytes_written < BUFFER_MSG_MAX_SIZE) {
+			break;
+		}
+		if (!GetBufferStatusByIndex(i, &status) || !EncodeBufferStatus(stream, &status)) {
+			return false;
+		}
+	}
+	nextEncodedBuffer = (i < nbrOfBuffers) ? i : 0;
+
+	return true;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Encodes the status of a buffer as a BufferProto submessage, see buffer_monitor.h
+ * @param  stream : Destination stream
+ * @param  status : Status of the buffer
+ * @retval true if encoded, false if the stream is too small
+ */
+static bool EncodeBufferStatus(pb_ostream_t* stream, const BufferStatus_TypeDef* status) {
+	uint8_t bufferMsg[BUFFER_MSG_MAX_SIZE];
+	pb_ostream_t bufferStream = pb_ostream_from_buffer(bufferMsg, sizeof(bufferMsg));
+
+	if (!pb_encode_tag(&bufferStream, PB_WT_STRING, 1)
+			|| !pb_encode_string(&bufferStream, (const uint8_t*) status->name, strlen(status->name))
+			|| !pb_encode_tag(&bufferStream, PB_WT_VARINT, 2) || !pb_encode_varint(&bufferStream, status->capacity)
+			|| !pb_encode_tag(&bufferStream, PB_WT_VARINT, 3) || !pb_encode_varint(&bufferStream, status->highWater)
+			|| !pb_encode_tag(&bufferStream, PB_WT_VARINT, 4) || !pb_encode_varint(&bufferStream, status->overflows)
+			|| !pb_encode_tag(&bufferStream, PB_WT_VARINT, 5) || !pb_encode_varint(&bufferStream, status->fullTime)) {
+		return false;
+	}
+
+	/* Field 1 of BufferStatsProto, length delimited */
+	return pb_encode_tag(stream, PB_WT_STRING, 1) && pb_encode_string(stream, bufferMsg, bufferStream.bytes_written);
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
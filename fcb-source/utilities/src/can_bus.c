@@ -0,0 +1,317 @@
+/******************************************************************************
+ * @file    can_bus.c
+ * @brief   bxCAN driver with interrupt driven mailboxes and hardware filters,
+ *          see can_bus.h
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "can_bus.h"
+
+#ifdef FCB_CAN_BUS
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include <string.h>
+#include <stdio.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private define ------------------------------------------------------------*/
+#define CAN_BUS_CONTROL_MAILBOX         0
+#define CAN_BUS_FIRST_QUEUED_MAILBOX    1
+#define CAN_BUS_MAILBOXES               3
+#define CAN_BUS_MAILBOX_TSR_SHIFT       8       // Between the request completed bits of the mailboxes in TSR
+#define CAN_BUS_LAST_ERROR_CODES        8
+
+/* Private macro -------------------------------------------------------------*/
+#define CAN_BUS_QUEUED_MAILBOXES_EMPTY  ((CAN_TSR_TME0 << CAN_BUS_FIRST_QUEUED_MAILBOX) \
+                                        | (CAN_TSR_TME0 << (CAN_BUS_FIRST_QUEUED_MAILBOX + 1)))
+
+/* Private function prototypes -----------------------------------------------*/
+static void LoadCanBusTxMailboxes(void);
+static void WriteCanBusMailbox(const uint8_t mailbox, const CanFrame_TypeDef* frame);
+
+/* Private variables ---------------------------------------------------------*/
+static CAN_HandleTypeDef CanBusHandle;
+
+/* Written by the RX interrupt, read by the protocol task */
+static xQueueHandle canBusRxQueue = NULL;
+
+/* Frames for mailboxes 1 and 2, written by tasks and read by the TX interrupt in critical sections */
+static CanFrame_TypeDef canBusTxQueue[CAN_BUS_TX_QUEUE_SIZE];
+static uint8_t txQueueReadIndex = 0;
+static uint8_t txQueueCount = 0;
+
+static uint8_t nbrOfFilters = 0;
+
+/* Error counters and flags are read from the peripheral by GetCanBusStats() */
+static CanBusStats_TypeDef canBusStats;
+
+static const char* const lastErrorCodeNames[CAN_BUS_LAST_ERROR_CODES] = { "none", "stuff", "form", "ack",
+        "bit recessive", "bit dominant", "CRC", "software" };
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Configures the bxCAN at 1 Mbit/s with automatic bus-off recovery and retransmission, priority by
+ *         identifier, and enables the FIFO 1 and TX mailbox empty interrupts
+ * @param  None
+ * @retval FCB_OK if on the bus, FCB_ERR_INIT otherwise
+ */
+FcbRetValType CanBusInit(void) {
+    if (NULL == canBusRxQueue) {
+        memset(&canBusStats, 0, sizeof(canBusStats));
+        canBusRxQueue = xQueueCreate(CAN_BUS_RX_QUEUE_SIZE, sizeof(CanFrame_TypeDef));
+        if (NULL == canBusRxQueue) {
+            return FCB_ERR_INIT;
+        }
+    }
+
+    CanBusHandle.Instance = CAN;
+    CanBusHandle.Init.Prescaler = CAN_BUS_PRESCALER;
+    CanBusHandle.Init.Mode = CAN_MODE_NORMAL;
+    CanBusHandle.Init.SJW = CAN_BUS_SJW;
+    CanBusHandle.Init.BS1 = CAN_BUS_BS1;
+    CanBusHandle.Init.BS2 = CAN_BUS_BS2;
+    CanBusHandle.Init.TTCM = DISABLE;
+    CanBusHandle.Init.ABOM = ENABLE;
+    CanBusHandle.Init.AWUM = DISABLE;
+    CanBusHandle.Init.NART = DISABLE;
+    CanBusHandle.Init.RFLM = DISABLE;
+    CanBusHandle.Init.TXFP = DISABLE;
+    if (HAL_OK != HAL_CAN_Init(&CanBusHandle)) {
+        return FCB_ERR_INIT;
+    }
+
+    __HAL_CAN_ENABLE_IT(&CanBusHandle, CAN_IT_FMP1 | CAN_IT_FOV1 | CAN_IT_TME);
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Configures the next filter bank as a 32 bit identifier and mask filter to FIFO 1, of extended data frames
+ * @param  id : Identifier bits to match
+ * @param  mask : Identifier bits that have to match
+ * @retval FCB_OK if added, FCB_ERR if all filter banks are used
+ */
+FcbRetValType CanBusAddFilter(const uint32_t id, const uint32_t mask) {
+    CAN_FilterConfTypeDef filterConfig;
+    uint32_t const filterId = ((id & CAN_BUS_EXT_ID_MASK) << 3) | CAN_ID_EXT | CAN_RTR_DATA;
+    uint32_t const filterMask = ((mask & CAN_BUS_EXT_ID_MASK) << 3) | CAN_ID_EXT | CAN_RTR_REMOTE;
+
+    if (nbrOfFilters >= CAN_BUS_MAX_FILTERS) {
+        return FCB_ERR;
+    }
+
+    filterConfig.FilterIdHigh = filterId >> 16;
+    filterConfig.FilterIdLow = filterId & 0xFFFF;
+    filterConfig.FilterMaskIdHigh = filterMask >> 16;
+    filterConfig.FilterMaskIdLow = filterMask & 0xFFFF;
+    filterConfig.FilterFIFOAssignment = CAN_FILTER_FIFO1;
+    filterConfig.FilterNumber = nbrOfFilters;
+    filterConfig.FilterMode = CAN_FILTERMODE_IDMASK;
+    filterConfig.FilterScale = CAN_FILTERSCALE_32BIT;
+    filterConfig.FilterActivation = ENABLE;
+    filterConfig.BankNumber = CAN_BUS_MAX_FILTERS; // Start bank of a second CAN, which the STM32F303 does not have
+    if (HAL_OK != HAL_CAN_ConfigFilter(&CanBusHandle, &filterConfig)) {
+        return FCB_ERR;
+    }
+
+    nbrOfFilters++;
+
+    return FCB_OK;
+}
+
+bool CanBusReceive(CanFrame_TypeDef* dstFrame, const uint32_t timeout) {
+    return pdTRUE == xQueueReceive(canBusRxQueue, dstFrame, (portTickType) timeout);
+}
+
+/*
+ * @brief  Queues a frame and loads it right away if mailboxes 1 and 2 are empty
+ * @param  frame : Frame to send
+ * @retval FCB_OK if queued, FCB_ERR if the TX queue is full
+ */
+FcbRetValType CanBusTransmit(const CanFrame_TypeDef* frame) {
+    FcbRetValType retVal = FCB_OK;
+
+    taskENTER_CRITICAL();
+    if (txQueueCount < CAN_BUS_TX_QUEUE_SIZE) {
+        canBusTxQueue[(txQueueReadIndex + txQueueCount) % CAN_BUS_TX_QUEUE_SIZE] = *frame;
+        txQueueCount++;
+        LoadCanBusTxMailboxes();
+    } else {
+        canBusStats.txQueueFull++;
+        retVal = FCB_ERR;
+    }
+    taskEXIT_CRITICAL();
+
+    return retVal;
+}
+
+/*
+ * @brief  Loads a frame into mailbox 0, which no other context writes, if it is empty. A frame that is still pending
+ *         is not aborted, it is sent before the dropped one would have been.
+ * @param  frame : Frame to send
+ * @retval true if loaded, false if dropped
+ */
+bool CanBusTransmitFromControl(const CanFrame_TypeDef* frame) {
+    if (NULL == canBusRxQueue || !(CAN->TSR & (CAN_TSR_TME0 << CAN_BUS_CONTROL_MAILBOX))) {
+        canBusStats.controlDropped++;
+        return false;
+    }
+
+    WriteCanBusMailbox(CAN_BUS_CONTROL_MAILBOX, frame);
+
+    return true;
+}
+
+/*
+ * @brief  Copies the frames of FIFO 1 to the RX queue, the FIFO holds 3 frames only
+ * @param  None
+ * @retval None
+ */
+void CanBusRxIRQHandler(void) {
+    CAN_FIFOMailBox_TypeDef* const fifoMailbox = &CAN->sFIFOMailBox[CAN_FIFO1];
+    portBASE_TYPE higherPriorityTaskWoken = pdFALSE;
+    CanFrame_TypeDef frame;
+    uint32_t data;
+    uint8_t i;
+
+    if (CAN->RF1R & CAN_RF1R_FOVR1) {
+        canBusStats.rxOverruns++;
+        CAN->RF1R = CAN_RF1R_FOVR1;
+    }
+
+    while (CAN->RF1R & CAN_RF1R_FMP1) {
+        frame.id = (fifoMailbox->RIR >> 3) & CAN_BUS_EXT_ID_MASK;
+        frame.length = (uint8_t) (fifoMailbox->RDTR & CAN_RDT1R_DLC);
+        if (frame.length > CAN_BUS_MAX_DATA_LENGTH) {
+            frame.length = CAN_BUS_MAX_DATA_LENGTH;
+        }
+        data = fifoMailbox->RDLR;
+        for (i = 0; i < 4; i++) {
+            frame.data[i] = (uint8_t) (data >> (8 * i));
+        }
+        data = fifoMailbox->RDHR;
+        for (i = 0; i < 4; i++) {
+            frame.data[4 + i] = (uint8_t) (data >> (8 * i));
+        }
+
+        /* Release the output mailbox for the next frame */
+        CAN->RF1R = CAN_RF1R_RFOM1;
+
+        canBusStats.framesReceived++;
+        if (pdTRUE != xQueueSendFromISR(canBusRxQueue, &frame, &higherPriorityTaskWoken)) {
+            canBusStats.rxOverruns++;
+        }
+    }
+
+    portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
+
+/*
+ * @brief  Counts the completed mailbox requests and loads the next queued frames
+ * @param  None
+ * @retval None
+ */
+void CanBusTxIRQHandler(void) {
+    uint32_t const tsr = CAN->TSR;
+    uint32_t requestCompleted;
+    uint8_t mailbox;
+
+    for (mailbox = 0; mailbox < CAN_BUS_MAILBOXES; mailbox++) {
+        requestCompleted = CAN_TSR_RQCP0 << (CAN_BUS_MAILBOX_TSR_SHIFT * mailbox);
+        if (tsr & requestCompleted) {
+            if (tsr & (CAN_TSR_TXOK0 << (CAN_BUS_MAILBOX_TSR_SHIFT * mailbox))) {
+                canBusStats.framesSent++;
+            } else {
+                canBusStats.txErrors++;
+            }
+            CAN->TSR = requestCompleted;
+        }
+    }
+
+    LoadCanBusTxMailboxes();
+}
+
+void GetCanBusStats(CanBusStats_TypeDef* dstStats) {
+    uint32_t esr;
+
+    taskENTER_CRITICAL();
+    *dstStats = canBusStats;
+    taskEXIT_CRITICAL();
+
+    esr = CAN->ESR;
+    dstStats->txErrorCounter = (uint8_t) ((esr & CAN_ESR_TEC) >> 16);
+    dstStats->rxErrorCounter = (uint8_t) ((esr & CAN_ESR_REC) >> 24);
+    dstStats->lastErrorCode = (uint8_t) ((esr & CAN_ESR_LEC) >> 4);
+    dstStats->isErrorPassive = (esr & CAN_ESR_EPVF) != 0;
+    dstStats->isBusOff = (esr & CAN_ESR_BOFF) != 0;
+}
+
+size_t PrintCanBusStats(char* dst, const size_t dstSize) {
+    CanBusStats_TypeDef stats;
+
+    GetCanBusStats(&stats);
+
+    return (size_t) snprintf(dst, dstSize,
+            "\nCAN bus %s\nreceived:%lu, sent:%lu, rxOverruns:%lu, txQueueFull:%lu, controlDropped:%lu, txErrors:%lu\n"
+            "TEC:%u, REC:%u, last error:%s\n",
+            stats.isBusOff ? "BUS OFF" : (stats.isErrorPassive ? "error passive" : "error active"),
+            stats.framesReceived, stats.framesSent, stats.rxOverruns, stats.txQueueFull, stats.controlDropped,
+            stats.txErrors, (unsigned int) stats.txErrorCounter, (unsigned int) stats.rxErrorCounter,
+            lastErrorCodeNames[stats.lastErrorCode % CAN_BUS_LAST_ERROR_CODES]);
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Loads the next queued frames once mailboxes 1 and 2 are both empty, the earlier frame to the lower mailbox.
+ *         Frames of equal identifiers, e.g. of a multi-frame transfer, are sent from the lower mailbox first, so the
+ *         frames keep their order. Called in a critical section or by the TX interrupt.
+ * @param  None
+ * @retval None
+ */
+static void LoadCanBusTxMailboxes(void) {
+    uint8_t mailbox;
+
+    if ((CAN->TSR & CAN_BUS_QUEUED_MAILBOXES_EMPTY) != CAN_BUS_QUEUED_MAILBOXES_EMPTY) {
+        return;
+    }
+
+    for (mailbox = CAN_BUS_FIRST_QUEUED_MAILBOX; mailbox < CAN_BUS_MAILBOXES && txQueueCount > 0; mailbox++) {
+        WriteCanBusMailbox(mailbox, &canBusTxQueue[txQueueReadIndex]);
+        txQueueReadIndex = (txQueueReadIndex + 1) % CAN_BUS_TX_QUEUE_SIZE;
+        txQueueCount--;
+    }
+}
+
+/*
+ * @brief  Writes a frame to an empty mailbox and requests its transmission
+ * @param  mailbox : Mailbox index
+ * @param  frame : Frame to send
+ * @retval None
+ */
+static void WriteCanBusMailbox(const uint8_t mailbox, const CanFrame_TypeDef* frame) {
+    CAN_TxMailBox_TypeDef* const txMailbox = &CAN->sTxMailBox[mailbox];
+
+    txMailbox->TDTR = frame->length;
+    txMailbox->TDLR = (uint32_t) frame->data[0] | ((uint32_t) frame->data[1] << 8) | ((uint32_t) frame->data[2] << 16)
+            | ((uint32_t) frame->data[3] << 24);
+    txMailbox->TDHR = (uint32_t) frame->data[4] | ((uint32_t) frame->data[5] << 8) | ((uint32_t) frame->data[6] << 16)
+            | ((uint32_t) frame->data[7] << 24);
+    txMailbox->TIR = ((frame->id & CAN_BUS_EXT_ID_MASK) << 3) | CAN_ID_EXT | CAN_TI0R_TXRQ;
+}
+
+#endif /* FCB_CAN_BUS */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,144 @@
+/******************************************************************************
+ * @file    ccm_ram.c
+ * @author  Dragonfly
+ * @brief   CCM SRAM placement. Zeroes the .ccmram section at startup and keeps
+ *          a table of the hot objects, registered by their modules at
+ *          initialization, to report which memory each of them landed in.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "ccm_ram.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+	const char* name;
+	const void* address;
+	size_t size;
+} CcmRamObject_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define SRAM_BASE_ADDRESS           0x20000000
+#define SRAM_SIZE                   (40*1024)
+#define FLASH_SIZE                  (256*1024)
+
+/* Private macro -------------------------------------------------------------*/
+#define IS_IN_REGION(ADDRESS, BASE, SIZE)   ((uint32_t) (ADDRESS) >= (BASE) && (uint32_t) (ADDRESS) < (BASE) + (SIZE))
+
+/* Private variables ---------------------------------------------------------*/
+#ifdef FCB_CCM_RAM
+/* Defined by the linker script */
+extern uint32_t __ccmram_start__;
+extern uint32_t __ccmram_end__;
+#endif
+
+static CcmRamObject_TypeDef ccmRamObjects[CCM_RAM_MAX_OBJECTS];
+static uint8_t nbrOfObjects = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+static const char* GetRegionName(const void* address);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Zeroes the .ccmram section. Called first thing in main(), before any CCM_RAM object is used.
+ * @param  None
+ * @retval None
+ */
+void InitCcmRam(void) {
+#ifdef FCB_CCM_RAM
+	uint32_t* word;
+
+	for (word = &__ccmram_start__; word < &__ccmram_end__; word++) {
+		*word = 0;
+	}
+#endif
+}
+
+/*
+ * @brief  Records a hot object for the placement report. Registering the same object again does nothing, further
+ *         objects than CCM_RAM_MAX_OBJECTS are not recorded. Called at initialization only, by one task at a time.
+ * @param  name : Name of the object, must stay valid
+ * @param  address : Address of the object
+ * @param  size : Size of the object [bytes]
+ * @retval None
+ */
+void CcmRamRegisterObject(const char* name, const void* address, const size_t size) {
+	uint8_t i;
+
+	for (i = 0; i < nbrOfObjects && ccmRamObjects[i].address != address; i++);
+
+	if (i == nbrOfObjects && nbrOfObjects < CCM_RAM_MAX_OBJECTS) {
+		ccmRamObjects[i].name = name;
+		ccmRamObjects[i].address = address;
+		ccmRamObjects[i].size = size;
+		nbrOfObjects++;
+	}
+}
+
+/*
+ * @brief  Prints the memory region, address and size of the registered objects and the CCM SRAM usage
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @retval Length of the table string
+ */
+size_t CcmRamPrint(char* dst, const size_t dstSize) {
+	size_t ccmObjectBytes = 0;
+	size_t length;
+	uint8_t i;
+
+	length = (size_t) snprintf(dst, dstSize, "\nHot object placement\n%-20s%-8s%12s%8s\n", "Object", "Region",
+			"Address", "Size");
+
+	for (i = 0; i < nbrOfObjects && length < dstSize; i++) {
+		ccmObjectBytes += IS_IN_REGION(ccmRamObjects[i].address, CCM_RAM_BASE, CCM_RAM_SIZE) ? ccmRamObjects[i].size : 0;
+		length += (size_t) snprintf(dst + length, dstSize - length, "%-20s%-8s  0x%08lx%8u\n", ccmRamObjects[i].name,
+				GetRegionName(ccmRamObjects[i].address), (uint32_t) ccmRamObjects[i].address,
+				(unsigned int) ccmRamObjects[i].size);
+	}
+
+	if (length < dstSize) {
+#ifdef FCB_CCM_RAM
+		length += (size_t) snprintf(dst + length, dstSize - length, "CCM: %u of %u bytes used, %u by the above\n",
+				(unsigned int) ((uint32_t) &__ccmram_end__ - (uint32_t) &__ccmram_start__), CCM_RAM_SIZE,
+				(unsigned int) ccmObjectBytes);
+#else
+		length += (size_t) snprintf(dst + length, dstSize - length, "CCM placement not compiled in, see FCB_CCM_RAM, "
+				"%u bytes in CCM\n", (unsigned int) ccmObjectBytes);
+#endif
+	}
+
+	return length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Gets the name of the memory region of an address
+ * @param  address : Address
+ * @retval Name of the region
+ */
+static const char* GetRegionName(const void* address) {
+	if (IS_IN_REGION(address, CCM_RAM_BASE, CCM_RAM_SIZE)) {
+		return "CCM";
+	}
+	if (IS_IN_REGION(address, SRAM_BASE_ADDRESS, SRAM_SIZE)) {
+		return "SRAM";
+	}
+	if (IS_IN_REGION(address, FLASH_BASE, FLASH_SIZE)) {
+		return "Flash";
+	}
+
+	return "Other";
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -12,15 +12,38 @@
 
 #include "stm32f3_discovery.h"
 
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+#define CRC_DMA_TIMEOUT		10	// [ms]
+#define CRC_DMA_MAX_SIZE	UINT16_MAX	// A DMA transfer is at most this many items
 /* Private macro -------------------------------------------------------------*/
 
 /* Private variables ---------------------------------------------------------*/
 
 CRC_HandleTypeDef CrcHandle;
+static DMA_HandleTypeDef CrcDmaHandle;
+
+/* Asynchronous CRC job, see StartCRCWithDMA(). The owner mutex is held by the task from the start of its job until it
+ * has waited for the result. While a job is running the CRC peripheral is its own, the synchronous functions wait for
+ * it to finish first. */
+static xSemaphoreHandle crcJobMutex = NULL;
+static xSemaphoreHandle crcJobDoneSem = NULL;
+static volatile bool isCRCJobRunning = false;
+static volatile bool isCRCJobFailed = false;
+static volatile uint32_t crcJobResult = 0;
+
+/* Upper word of the 64-bit timestamp and the cycle counter value it was last extended at, see GetTimestamp64() */
+static uint32_t timestampHigh = 0;
+static uint32_t timestampLastLow = 0;
 
 /* Private function prototypes -----------------------------------------------*/
+static void WaitForCRCJob(void);
+static void CRCJobComplete(DMA_HandleTypeDef* hdma);
+static void CRCJobError(DMA_HandleTypeDef* hdma);
 
 /* Exported functions --------------------------------------------------------*/
 
@@ -53,6 +76,36 @@ void InitCRC(void)
 		/* Initialization Error */
 		ErrorHandler();
 	}
+
+	/* Memory to memory DMA channel, with the data as source and the CRC data register as fixed destination. Bytes are
+	 * transferred, as bytes are written by CalculateCRC, so that both give the same CRC. */
+	CRC_DMA_CLK_ENABLE();
+
+	CrcDmaHandle.Instance = CRC_DMA_CHANNEL;
+	CrcDmaHandle.Init.Direction = DMA_MEMORY_TO_MEMORY;
+	CrcDmaHandle.Init.PeriphInc = DMA_PINC_ENABLE;
+	CrcDmaHandle.Init.MemInc = DMA_MINC_DISABLE;
+	CrcDmaHandle.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	CrcDmaHandle.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	CrcDmaHandle.Init.Mode = DMA_NORMAL;
+	CrcDmaHandle.Init.Priority = DMA_PRIORITY_LOW;
+
+	if (HAL_DMA_Init(&CrcDmaHandle) != HAL_OK) {
+		/* Initialization Error */
+		ErrorHandler();
+	}
+
+	CrcDmaHandle.XferCpltCallback = CRCJobComplete;
+	CrcDmaHandle.XferErrorCallback = CRCJobError;
+
+	HAL_NVIC_SetPriority(CRC_DMA_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY, 0);
+	HAL_NVIC_EnableIRQ(CRC_DMA_IRQn);
+
+	crcJobMutex = xSemaphoreCreateMutex();
+	crcJobDoneSem = xSemaphoreCreateBinary();
+	if (crcJobMutex == NULL || crcJobDoneSem == NULL) {
+		ErrorHandler();
+	}
 }
 
 /*
@@ -65,12 +118,209 @@ uint32_t CalculateCRC(const uint8_t* dataBuffer, const uint32_t dataBufferSize)
 
 	uint32_t crcVal;
 
+	WaitForCRCJob();
+
 	/* Compute the CRC of dataBuffer */
 	crcVal = HAL_CRC_Calculate(&CrcHandle, (uint32_t*) dataBuffer, dataBufferSize);
 
 	return crcVal;
 }
 
+/*
+ * @brief  Continues a Cyclic Redundancy Check (CRC) started by CalculateCRC with more data
+ * @param  dataBuffer : Pointer to data buffer (byte array)
+ * @param  dataBufferSize : byte size of dataBuffer
+ * @retval CRC value of all data since the last CalculateCRC call
+ */
+uint32_t AccumulateCRC(const uint8_t* dataBuffer, const uint32_t dataBufferSize) {
+
+	uint32_t crcVal;
+
+	WaitForCRCJob();
+
+	/* Compute the CRC of dataBuffer, starting from the previously computed CRC */
+	crcVal = HAL_CRC_Accumulate(&CrcHandle, (uint32_t*) dataBuffer, dataBufferSize);
+
+	return crcVal;
+}
+
+/*
+ * @brief  Continues a Cyclic Redundancy Check (CRC) started by CalculateCRC with more data, which is fed to the CRC
+ *         peripheral by DMA instead of the CPU. Waits for the transfer, so the caller must keep others from using the
+ *         CRC peripheral, as with AccumulateCRC. The data must not be in CCM RAM, which the DMA cannot read.
+ * @param  dataBuffer : Pointer to data buffer (byte array)
+ * @param  dataBufferSize : byte size of dataBuffer
+ * @retval CRC value of all data since the last CalculateCRC call
+ */
+uint32_t AccumulateCRCWithDMA(const uint8_t* dataBuffer, const uint32_t dataBufferSize) {
+
+	if (0 == dataBufferSize || dataBufferSize > CRC_DMA_MAX_SIZE)
+		return AccumulateCRC(dataBuffer, dataBufferSize);
+
+	WaitForCRCJob();
+
+	if (HAL_DMA_Start(&CrcDmaHandle, (uint32_t) dataBuffer, (uint32_t) &CrcHandle.Instance->DR, dataBufferSize) != HAL_OK
+			|| HAL_DMA_PollForTransfer(&CrcDmaHandle, HAL_DMA_FULL_TRANSFER, CRC_DMA_TIMEOUT) != HAL_OK) {
+		/* The CRC of a partial transfer does not match, so the data is rejected by the caller */
+		HAL_DMA_Abort(&CrcDmaHandle);
+		ErrorHandler();
+	}
+
+	return CrcHandle.Instance->DR;
+}
+
+/*
+ * @brief  Continues a Cyclic Redundancy Check (CRC) from a CRC value returned before, so that a CRC can be calculated
+ *         in parts with other calculations in between. The CRC peripheral is loaded with the value as its initial
+ *         value, which is restored afterwards. The output is not inverted, so the value is the CRC register.
+ * @param  crc : CRC of the data before dataBuffer, DEFAULT_CRC_INITVALUE to start a new CRC
+ * @param  dataBuffer : Pointer to data buffer (byte array)
+ * @param  dataBufferSize : byte size of dataBuffer
+ * @retval CRC value of the data before and of dataBuffer
+ */
+uint32_t ContinueCRC(const uint32_t crc, const uint8_t* dataBuffer, const uint32_t dataBufferSize) {
+
+	uint32_t crcVal;
+
+	WaitForCRCJob();
+
+	__HAL_CRC_INITIALCRCVALUE_CONFIG(&CrcHandle, crc);
+	__HAL_CRC_DR_RESET(&CrcHandle);
+
+	crcVal = HAL_CRC_Accumulate(&CrcHandle, (uint32_t*) dataBuffer, dataBufferSize);
+
+	__HAL_CRC_INITIALCRCVALUE_CONFIG(&CrcHandle, DEFAULT_CRC_INITVALUE);
+
+	return crcVal;
+}
+
+/*
+ * @brief  Starts an asynchronous CRC: the data is fed to the CRC peripheral by DMA while the calling task goes on, and
+ *         the result is collected with WaitCRCWithDMA(), which the task must call before it starts another one. Only
+ *         one job runs at a time, this waits until the job of another task has been collected. Called from tasks,
+ *         once the scheduler is started. The data must not be in CCM RAM and must be kept until the job is done.
+ * @param  crc : CRC of the data before dataBuffer, DEFAULT_CRC_INITVALUE to start a new CRC, as with ContinueCRC
+ * @param  dataBuffer : Pointer to data buffer (byte array)
+ * @param  dataBufferSize : byte size of dataBuffer, 1 to 65535
+ * @retval FCB_OK if started, FCB_ERR if the size is invalid or the scheduler is not running
+ */
+FcbRetValType StartCRCWithDMA(const uint32_t crc, const uint8_t* dataBuffer, const uint32_t dataBufferSize) {
+	HAL_StatusTypeDef status;
+
+	if (0 == dataBufferSize || dataBufferSize > CRC_DMA_MAX_SIZE
+			|| taskSCHEDULER_RUNNING != xTaskGetSchedulerState()) {
+		return FCB_ERR;
+	}
+
+	xSemaphoreTake(crcJobMutex, portMAX_DELAY);
+	xSemaphoreTake(crcJobDoneSem, 0); // Clears a completion left by a timed out job
+
+	/* Keep the synchronous users out until the job is marked running, they wait for it from then on */
+	vTaskSuspendAll();
+
+	__HAL_CRC_INITIALCRCVALUE_CONFIG(&CrcHandle, crc);
+	__HAL_CRC_DR_RESET(&CrcHandle);
+
+	isCRCJobFailed = false;
+	isCRCJobRunning = true;
+	status = HAL_DMA_Start_IT(&CrcDmaHandle, (uint32_t) dataBuffer, (uint32_t) &CrcHandle.Instance->DR, dataBufferSize);
+	if (status != HAL_OK) {
+		isCRCJobRunning = false;
+		__HAL_CRC_INITIALCRCVALUE_CONFIG(&CrcHandle, DEFAULT_CRC_INITVALUE);
+	}
+
+	xTaskResumeAll();
+
+	if (status != HAL_OK) {
+		xSemaphoreGive(crcJobMutex);
+		return FCB_ERR;
+	}
+
+	return FCB_OK;
+}
+
+/*
+ * @brief  Waits for the CRC job started by StartCRCWithDMA() of the calling task, and releases the CRC peripheral
+ * @param  crc : Destination for the CRC of the data before and of the buffer of the job
+ * @param  timeout : Max time to wait [ms], the job is aborted after it
+ * @retval FCB_OK if the CRC is calculated, FCB_ERR if the job failed or timed out
+ */
+FcbRetValType WaitCRCWithDMA(uint32_t* crc, const uint32_t timeout) {
+	FcbRetValType retVal = FCB_OK;
+
+	if (pdTRUE != xSemaphoreTake(crcJobDoneSem, timeout / portTICK_RATE_MS)) {
+		taskENTER_CRITICAL();
+		if (isCRCJobRunning) {
+			HAL_DMA_Abort(&CrcDmaHandle);
+			__HAL_CRC_INITIALCRCVALUE_CONFIG(&CrcHandle, DEFAULT_CRC_INITVALUE);
+			isCRCJobFailed = true;
+			isCRCJobRunning = false;
+		}
+		taskEXIT_CRITICAL();
+	}
+
+	if (isCRCJobFailed) {
+		retVal = FCB_ERR;
+	} else {
+		*crc = crcJobResult;
+	}
+
+	xSemaphoreGive(crcJobMutex);
+
+	return retVal;
+}
+
+/*
+ * @brief  Checks if the CRC job started by StartCRCWithDMA() is done, so that WaitCRCWithDMA() returns at once
+ * @param  None
+ * @retval true if done, else false
+ */
+bool IsCRCWithDMADone(void) {
+	return !isCRCJobRunning;
+}
+
+/*
+ * @brief  Continues a CRC with a buffer fed to the CRC peripheral by DMA, for streams of chunks such as framed messages
+ *         and log blocks. The calling task blocks until the chunk is done, the CPU is free for the other tasks
+ *         meanwhile. Chunks smaller than CRC_DMA_MIN_SIZE, and all chunks before the scheduler is started, are
+ *         calculated by the CPU.
+ * @param  crc : CRC of the previous chunks, DEFAULT_CRC_INITVALUE for the first one, updated with this chunk
+ * @param  dataBuffer : Pointer to data buffer (byte array)
+ * @param  dataBufferSize : byte size of dataBuffer
+ * @retval FCB_OK if the CRC is updated, FCB_ERR if the DMA transfer failed
+ */
+FcbRetValType ContinueCRCWithDMA(uint32_t* crc, const uint8_t* dataBuffer, const uint32_t dataBufferSize) {
+	uint32_t offset = 0;
+	uint32_t chunkSize;
+
+	if (dataBufferSize < CRC_DMA_MIN_SIZE || taskSCHEDULER_RUNNING != xTaskGetSchedulerState()) {
+		vTaskSuspendAll();
+		*crc = ContinueCRC(*crc, dataBuffer, dataBufferSize);
+		xTaskResumeAll();
+		return FCB_OK;
+	}
+
+	while (offset < dataBufferSize) {
+		chunkSize = dataBufferSize - offset > CRC_DMA_MAX_SIZE ? CRC_DMA_MAX_SIZE : dataBufferSize - offset;
+		if (FCB_OK != StartCRCWithDMA(*crc, &dataBuffer[offset], chunkSize)
+				|| FCB_OK != WaitCRCWithDMA(crc, CRC_DMA_TIMEOUT))
+			return FCB_ERR;
+
+		offset += chunkSize;
+	}
+
+	return FCB_OK;
+}
+
+/*
+ * @brief  Handles the interrupt of the CRC DMA channel. Called from CRC_DMA_IRQHandler.
+ * @param  None
+ * @retval None
+ */
+void CRCDmaIRQHandler(void) {
+	HAL_DMA_IRQHandler(&CrcDmaHandle);
+}
+
 /**
  * @brief  Configures the Programmable Voltage Detection (PVD) resources.
  * @param  None
@@ -182,10 +432,134 @@ void toMaxRadian(float32_t *radian) {
 
 /* Private functions ---------------------------------------------------------*/
 
+/*
+ * @brief  Waits for a running CRC job to finish, before the CRC peripheral is used by the CPU. The callers keep the
+ *         tasks from starting a new one, and a job only takes the time of its DMA transfer.
+ * @param  None
+ * @retval None
+ */
+static void WaitForCRCJob(void) {
+	while (isCRCJobRunning) {
+	}
+}
+
+/*
+ * @brief  Transfer complete callback of the CRC DMA channel, collects the CRC of the job and signals its task
+ * @param  hdma : DMA handle
+ * @retval None
+ */
+static void CRCJobComplete(DMA_HandleTypeDef* hdma) {
+	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+	(void) hdma;
+
+	crcJobResult = CrcHandle.Instance->DR;
+	__HAL_CRC_INITIALCRCVALUE_CONFIG(&CrcHandle, DEFAULT_CRC_INITVALUE);
+	isCRCJobRunning = false;
+
+	xSemaphoreGiveFromISR(crcJobDoneSem, &xHigherPriorityTaskWoken);
+	portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+}
+
+/*
+ * @brief  Transfer error callback of the CRC DMA channel, fails the job and signals its task
+ * @param  hdma : DMA handle
+ * @retval None
+ */
+static void CRCJobError(DMA_HandleTypeDef* hdma) {
+	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+	(void) hdma;
+
+	__HAL_CRC_INITIALCRCVALUE_CONFIG(&CrcHandle, DEFAULT_CRC_INITVALUE);
+	isCRCJobFailed = true;
+	isCRCJobRunning = false;
+
+	xSemaphoreGiveFromISR(crcJobDoneSem, &xHigherPriorityTaskWoken);
+	portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+}
+
 /**
  * @}
  */
 
+/*
+ * @brief  Starts the DWT cycle counter used for sensor sample timestamps.
+ *         A timestamp is the core clock cycle count, it wraps after about
+ *         60 s at 72 MHz so only differences shorter than that are valid.
+ * @param  None
+ * @retval None
+ */
+void InitTimestampCounter(void) {
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	timestampHigh = 0;
+	timestampLastLow = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/*
+ * @brief  Gets the current timestamp, safe to call from ISRs
+ * @param  None
+ * @retval Timestamp [core clock cycles]
+ */
+uint32_t GetTimestamp(void) {
+	return DWT->CYCCNT;
+}
+
+/*
+ * @brief  Gets the current timestamp extended to 64 bits, safe to call from ISRs. A wrap of the cycle counter is only
+ *         seen if this is called at least once per wrap period, about 60 s at 72 MHz, the SysTick callback does so.
+ * @param  None
+ * @retval Timestamp [core clock cycles]
+ */
+uint64_t GetTimestamp64(void) {
+	uint32_t primask;
+	uint32_t low;
+	uint64_t timestamp;
+
+	/* Any priority may call, the extension is updated with all interrupts disabled */
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	low = DWT->CYCCNT;
+	if (low < timestampLastLow) {
+		timestampHigh++;
+	}
+	timestampLastLow = low;
+	timestamp = ((uint64_t) timestampHigh << 32) | low;
+
+	__set_PRIMASK(primask);
+
+	return timestamp;
+}
+
+/*
+ * @brief  Gets the monotonic microsecond clock, safe to call from ISRs. The low word alone wraps after 71 minutes,
+ *         differences of low words are exact for intervals shorter than that.
+ * @param  None
+ * @retval Time since InitTimestampCounter() [us]
+ */
+uint64_t GetMicroseconds(void) {
+	return GetTimestamp64() / (SystemCoreClock / 1000000);
+}
+
+/*
+ * @brief  Converts the difference of two timestamps to seconds
+ * @param  timestampDelta : later timestamp minus earlier timestamp
+ * @retval Time [s]
+ */
+float32_t TimestampToSeconds(const uint32_t timestampDelta) {
+	return (float32_t) timestampDelta / (float32_t) SystemCoreClock;
+}
+
+/*
+ * @brief  Converts the difference of two timestamps to microseconds
+ * @param  timestampDelta : later timestamp minus earlier timestamp
+ * @retval Time [us]
+ */
+uint32_t TimestampToMicroseconds(const uint32_t timestampDelta) {
+	return timestampDelta / (SystemCoreClock / 1000000);
+}
+
 /**
  * @}
  */
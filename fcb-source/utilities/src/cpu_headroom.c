@@ -0,0 +1,171 @@
+/******************************************************************************
+ * @file    cpu_headroom.c
+ * @author  Dragonfly
+ * @brief   CPU headroom meter. The idle task runs CpuHeadroomIdleHook()
+ *          whenever no other task is ready, counting one spin loop per call.
+ *          The same loop is run with the interrupts disabled at startup to
+ *          get the count of an idle CPU. The count is only written by the idle
+ *          task and read by the sampling timer, without locks. With tickless
+ *          idle the CPU would sleep instead of spinning, it is not used.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "cpu_headroom.h"
+
+#include <stdio.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+#define HEADROOM_FULL               10000   // [0.01 %]
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+
+/* Written by the idle task only */
+static volatile uint32_t idleLoops = 0;
+
+/* Written by the sampling timer, read without synchronization */
+static CpuHeadroom_TypeDef cpuHeadroom = { HEADROOM_FULL, HEADROOM_FULL, 0, 0 };
+
+/* Idle loops and cycle counter at the last sample */
+static uint32_t lastIdleLoops = 0;
+static uint32_t lastSampleCycles = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Measures the idle loops per second with no load. Called once at startup, after the system clock and the
+ *         cycle counter are configured and before the scheduler is started.
+ * @param  None
+ * @retval None
+ */
+void CalibrateCpuHeadroom(void) {
+	uint32_t calibrationCycles = (SystemCoreClock / 1000) * CPU_HEADROOM_CALIBRATION_TIME;
+	uint32_t primask;
+	uint32_t start;
+	uint32_t elapsed;
+
+	/* Nothing but the spin loop, the interrupts pending meanwhile are served afterwards */
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	idleLoops = 0;
+	start = DWT->CYCCNT;
+	do {
+		CpuHeadroomIdleHook();
+		elapsed = DWT->CYCCNT - start;
+	} while (elapsed < calibrationCycles);
+
+	cpuHeadroom.baseline = (uint32_t) ((uint64_t) idleLoops * SystemCoreClock / elapsed);
+	lastIdleLoops = idleLoops;
+	lastSampleCycles = DWT->CYCCNT;
+
+	__set_PRIMASK(primask);
+}
+
+/*
+ * @brief  Counts a spin loop of the idle task. Called by the FreeRTOS idle hook, must not block.
+ * @param  None
+ * @retval None
+ */
+void CpuHeadroomIdleHook(void) {
+	uint16_t i;
+
+	for (i = 0; i < CPU_HEADROOM_SPIN_LOOPS; i++) {
+		__NOP();
+	}
+
+	idleLoops++;
+}
+
+/*
+ * @brief  Updates the headroom over the time since the last update. Called once per sample period by the task status
+ *         timer, the period is measured with the cycle counter, so it must stay below its wrap.
+ * @param  None
+ * @retval None
+ */
+void UpdateCpuHeadroom(void) {
+	uint32_t loops = idleLoops;
+	uint32_t now = DWT->CYCCNT;
+	uint64_t expectedLoops;
+	uint32_t headroom;
+
+	cpuHeadroom.idleLoops = loops - lastIdleLoops;
+	expectedLoops = (uint64_t) cpuHeadroom.baseline * (now - lastSampleCycles) / SystemCoreClock;
+	lastIdleLoops = loops;
+	lastSampleCycles = now;
+
+	if (0 == expectedLoops) {
+		return;
+	}
+
+	headroom = (uint32_t) ((uint64_t) cpuHeadroom.idleLoops * HEADROOM_FULL / expectedLoops);
+	cpuHeadroom.headroom = (headroom < HEADROOM_FULL) ? (uint16_t) headroom : HEADROOM_FULL;
+
+	/* The initialization of the tasks right after startup is not representative */
+	if (HAL_GetTick() >= CPU_HEADROOM_SETTLE_TIME && cpuHeadroom.headroom < cpuHeadroom.minHeadroom) {
+		cpuHeadroom.minHeadroom = cpuHeadroom.headroom;
+	}
+}
+
+/*
+ * @brief  Gets the CPU headroom, which may mix the fields of two samples
+ * @param  dstHeadroom : Destination headroom
+ * @retval None
+ */
+void GetCpuHeadroom(CpuHeadroom_TypeDef* dstHeadroom) {
+	*dstHeadroom = cpuHeadroom;
+}
+
+/*
+ * @brief  Checks if the headroom of the last sample period is below CPU_HEADROOM_LOW. May be called from an ISR.
+ * @param  None
+ * @retval true if low, else false
+ */
+bool IsCpuHeadroomLow(void) {
+	return cpuHeadroom.headroom < CPU_HEADROOM_LOW;
+}
+
+/*
+ * @brief  Prints the CPU headroom
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @retval Length of the string
+ */
+size_t CpuHeadroomPrint(char* dst, const size_t dstSize) {
+	CpuHeadroom_TypeDef headroom;
+
+	GetCpuHeadroom(&headroom);
+
+	return (size_t) snprintf(dst, dstSize, "CPU headroom %u.%02u %%, minimum %u.%02u %%\n"
+			"Idle loops %lu per sample, %lu per second with no load\n", headroom.headroom / 100,
+			headroom.headroom % 100, headroom.minHeadroom / 100, headroom.minHeadroom % 100, headroom.idleLoops,
+			headroom.baseline);
+}
+
+/*
+ * @brief  Encodes the CPU headroom as a CpuHeadroomProto message, see cpu_headroom.h
+ * @param  stream : Destination stream
+ * @retval true if encoded, false if the stream is too small
+ */
+bool EncodeCpuHeadroom(pb_ostream_t* stream) {
+	CpuHeadroom_TypeDef headroom;
+
+	GetCpuHeadroom(&headroom);
+
+	return pb_encode_tag(stream, PB_WT_VARINT, 1) && pb_encode_varint(stream, headroom.headroom)
+			&& pb_encode_tag(stream, PB_WT_VARINT, 2) && pb_encode_varint(stream, headroom.minHeadroom)
+			&& pb_encode_tag(stream, PB_WT_VARINT, 3) && pb_encode_varint(stream, headroom.idleLoops)
+			&& pb_encode_tag(stream, PB_WT_VARINT, 4) && pb_encode_varint(stream, headroom.baseline);
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,544 @@
+/******************************************************************************
+ * @file    crash_dump.c
+ * @author  Dragonfly
+ * @brief   Crash dump. The dump is built in the .noinit section, which the
+ *          startup code neither clears nor initializes, so it survives the
+ *          software reset that follows the crash. It is only used when its
+ *          magic and checksum are right, as the section holds random data
+ *          after power on. The capture runs in the fault handler or with the
+ *          system in an unknown state, so it takes no locks, calls no kernel
+ *          functions that could block and checks every address it reads.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "crash_dump.h"
+
+#include "firmware_update.h"
+#include "flash.h"
+#include "common.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+#define CRASH_DUMP_MAGIC                0x504D4443  // "CDMP"
+#define QUICK_CRASH_MAGIC               0x48535243  // "CRSH"
+
+/* The fault frame, and the extended frame with the FPU registers when EXC_RETURN bit 4 is clear */
+#define FAULT_FRAME_WORDS               8
+#define FAULT_FRAME_FP_WORDS            26
+#define EXC_RETURN_STANDARD_FRAME       0x00000010
+#define PSR_STACK_ALIGN                 0x00000200  // The frame was aligned to 8 bytes with one word of padding
+#define CONTROL_SPSEL                   0x00000002  // Thread mode uses the process stack
+
+/* Saved by the context switch of the ARM_CM4F port below the exception frame: R4 to R11 and EXC_RETURN, then S16 to
+ * S31 after them if EXC_RETURN bit 4 is clear */
+#define TASK_CONTEXT_WORDS              9
+#define TASK_CONTEXT_FP_WORDS           16
+
+/* On-chip RAM of the STM32F303VC: 40 kB SRAM and 8 kB CCM RAM */
+#define CRASH_SRAM_SIZE                 0xA000
+#define CRASH_CCM_RAM_SIZE              0x2000
+
+/* Vector table words, Cortex-M4 exceptions and STM32F303 interrupts */
+#define VECTOR_TABLE_WORDS              (16 + 82)
+
+#define CRASH_DUMP_NOINIT               __attribute__((section(".noinit")))
+
+/* Private macro -------------------------------------------------------------*/
+#define IS_RAM_RANGE(ADDR, SIZE)        ((((ADDR) >= SRAM_BASE) && ((ADDR) + (SIZE) <= SRAM_BASE + CRASH_SRAM_SIZE)) \
+        || (((ADDR) >= CCMDATARAM_BASE) && ((ADDR) + (SIZE) <= CCMDATARAM_BASE + CRASH_CCM_RAM_SIZE)))
+#define IS_FLASH_ADDR(ADDR)             (((ADDR) >= FLASH_BASE_ADDR) && ((ADDR) < FLASH_BASE_ADDR + FLASH_TOTAL_SIZE))
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Kept over the reset after a crash */
+static CrashDump_TypeDef crashDump CRASH_DUMP_NOINIT;
+static uint32_t quickCrashMagic CRASH_DUMP_NOINIT;
+static uint32_t quickCrashes CRASH_DUMP_NOINIT;     // Quick crashes in a row, valid if quickCrashMagic is set
+
+static uint32_t firmwareId = 0;
+
+static const char* crashCauseNames[] = { "none", "hard fault", "ErrorHandler()", "watchdog" };
+static const char* crashRegisterNames[CRASH_REG_NBR] = { "R0", "R1", "R2", "R3", "R12", "LR", "PC", "xPSR" };
+static const char* crashFaultRegisterNames[CRASH_FAULT_NBR] = { "CFSR", "HFSR", "DFSR", "AFSR", "MMFAR", "BFAR" };
+
+/* Private function prototypes -----------------------------------------------*/
+static void BeginCrashDump(const CrashCause_TypeDef cause);
+static void CopyTaskName(const char* taskName);
+static void CopyFaultFrame(const uint32_t stackAddr, const uint32_t excReturn);
+static void CopyStack(const uint32_t stackPointer);
+static void EndCrashDump(void);
+static uint32_t CrashDumpChecksum(const CrashDump_TypeDef* dump);
+static bool IsCrashDumpValid(const CrashDump_TypeDef* dump);
+static uint32_t GetFirmwareId(void);
+static bool EncodePackedWords(pb_ostream_t* stream, const uint32_t field, const uint32_t* words, const uint32_t count);
+static size_t FormatCrashLogEntry(char* dst, const size_t dstSize, const CrashDump_TypeDef* dump,
+		const uint8_t entryIdx);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Copies the dump of a crash before the last reset to the settings store. Called once at startup, after the
+ *         settings store is initialized and before the tasks are created.
+ * @param  None
+ * @retval None
+ */
+void InitCrashDump(void) {
+	CrashDump_TypeDef storedDump; // On the main stack, which is all free before the scheduler is started
+
+	firmwareId = GetFirmwareId();
+
+	/* Only resets by a crash count as quick crashes in a row, not power on or the reset button */
+	if (QUICK_CRASH_MAGIC != quickCrashMagic || !__HAL_RCC_GET_FLAG(RCC_FLAG_SFTRST)) {
+		quickCrashMagic = QUICK_CRASH_MAGIC;
+		quickCrashes = 0;
+	}
+	__HAL_RCC_CLEAR_RESET_FLAGS();
+
+	if (!IsCrashDumpValid(&crashDump)) {
+		return;
+	}
+
+	crashDump.crashes = 1;
+	if (FLASH_OK == ReadCrashDumpFromFlash(&storedDump) && IsCrashDumpValid(&storedDump)) {
+		crashDump.crashes += storedDump.crashes;
+	}
+	crashDump.checksum = CrashDumpChecksum(&crashDump);
+
+	if (FLASH_OK != WriteCrashDumpToFlash(&crashDump)) {
+		LOG0("Crash dump could not be saved to flash");
+	}
+	LOG2("Restarted after a crash at PC 0x%08lx, %lu crashes, see crash-dump", crashDump.registers[CRASH_REG_PC],
+			crashDump.crashes);
+
+	/* Stored, not copied again at the next startup */
+	crashDump.magic = 0;
+}
+
+/*
+ * @brief  Stores a crash dump of a hard fault and resets the board, unless it had too many quick crashes in a row.
+ *         Called by the hard fault handler, with the motors already shut down.
+ * @param  faultStack : Stack pointer at the fault handler entry, pointing to the fault frame
+ * @param  excReturn : LR at the fault handler entry
+ * @retval None, returns only if the board is not reset
+ */
+void CrashDumpFromFault(uint32_t* faultStack, const uint32_t excReturn) {
+	BeginCrashDump(CRASH_CAUSE_HARD_FAULT);
+	crashDump.excReturn = excReturn;
+	crashDump.faultStatus[CRASH_FAULT_CFSR] = SCB->CFSR;
+	crashDump.faultStatus[CRASH_FAULT_HFSR] = SCB->HFSR;
+	crashDump.faultStatus[CRASH_FAULT_DFSR] = SCB->DFSR;
+	crashDump.faultStatus[CRASH_FAULT_AFSR] = SCB->AFSR;
+	crashDump.faultStatus[CRASH_FAULT_MMFAR] = SCB->MMFAR;
+	crashDump.faultStatus[CRASH_FAULT_BFAR] = SCB->BFAR;
+
+	/* A fault while stacking, e.g. a stack overflow, leaves no frame to read */
+	CopyFaultFrame((uint32_t) faultStack, excReturn);
+
+	EndCrashDump();
+}
+
+/*
+ * @brief  Stores a crash dump of a call of ErrorHandler() and resets the board, unless it had too many quick crashes in
+ *         a row. The motors are already shut down.
+ * @param  returnAddress : Return address of the ErrorHandler() call, stored as the PC
+ * @retval None, returns only if the board is not reset
+ */
+void CrashDumpFromError(const uint32_t returnAddress) {
+	BeginCrashDump(CRASH_CAUSE_ERROR_HANDLER);
+	crashDump.registers[CRASH_REG_PC] = returnAddress;
+	crashDump.registers[CRASH_REG_PSR] = __get_xPSR();
+
+	/* Thread mode on the process stack in a task, else the main stack, which interrupts always use */
+	CopyStack((0 == __get_IPSR() && (__get_CONTROL() & CONTROL_SPSEL)) ? __get_PSP() : __get_MSP());
+
+	EndCrashDump();
+}
+
+/*
+ * @brief  Stores a crash dump of a task that missed its watchdog deadline, without resetting the board, which the IWDG
+ *         does. Called by the watchdog supervisor, while the task is switched out.
+ * @param  task : Handle of the task
+ * @retval None
+ */
+void CrashDumpFromWatchdog(void* task) {
+	uint32_t stackAddr;
+	const uint32_t* context;
+
+	BeginCrashDump(CRASH_CAUSE_WATCHDOG);
+	memset(crashDump.taskName, 0, sizeof(crashDump.taskName));
+
+	if (NULL != task) {
+		CopyTaskName((const char*) pcTaskGetTaskName(task));
+
+		/* The first word of a task control block is the top of its stack, where its context was saved */
+		stackAddr = *(const uint32_t*) task;
+		if (IS_RAM_RANGE(stackAddr, TASK_CONTEXT_WORDS*sizeof(uint32_t))) {
+			context = (const uint32_t*) stackAddr;
+			crashDump.excReturn = context[TASK_CONTEXT_WORDS - 1];
+			stackAddr += TASK_CONTEXT_WORDS*sizeof(uint32_t);
+			if (!(crashDump.excReturn & EXC_RETURN_STANDARD_FRAME)) {
+				stackAddr += TASK_CONTEXT_FP_WORDS*sizeof(uint32_t);
+			}
+			CopyFaultFrame(stackAddr, crashDump.excReturn);
+		} else {
+			crashDump.stackPointer = stackAddr;
+		}
+	}
+
+	crashDump.magic = CRASH_DUMP_MAGIC;
+	crashDump.checksum = CrashDumpChecksum(&crashDump);
+}
+
+/*
+ * @brief  Gets the crash dump in the settings store
+ * @param  dump : Destination dump
+ * @retval true if there is a dump, else false
+ */
+bool GetCrashDump(CrashDump_TypeDef* dump) {
+	if (FLASH_OK != ReadCrashDumpFromFlash(dump) || !IsCrashDumpValid(dump)) {
+		memset(dump, 0, sizeof(CrashDump_TypeDef));
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * @brief  Clears the crash dump in the settings store, which also restarts the crash count
+ * @param  None
+ * @retval None
+ */
+void ClearCrashDump(void) {
+	/* The dump of the last crash is in the store already, the RAM one is only filled again by the next crash */
+	memset(&crashDump, 0, sizeof(CrashDump_TypeDef));
+	WriteCrashDumpToFlash(&crashDump);
+}
+
+/*
+ * @brief  Prints a crash dump as text, up to its log entries, see CrashDumpPrintLogEntry()
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @param  dump : Dump to print, see GetCrashDump()
+ * @retval Length of the string
+ */
+size_t CrashDumpPrint(char* dst, const size_t dstSize, const CrashDump_TypeDef* dump) {
+	size_t length;
+	uint8_t i;
+
+	if (CRASH_CAUSE_NONE == dump->cause || dump->cause >= sizeof(crashCauseNames)/sizeof(crashCauseNames[0])) {
+		return (size_t) snprintf(dst, dstSize, "\nNo crash dump\n");
+	}
+
+	length = (size_t) snprintf(dst, dstSize, "\nCrash dump: %s at %lu ms, %lu crashes since cleared\nTask: %s\n",
+			crashCauseNames[dump->cause], dump->uptime, dump->crashes,
+			('\0' != dump->taskName[0]) ? dump->taskName : "none");
+
+	for (i = 0; i < CRASH_REG_NBR && length < dstSize; i++) {
+		length += (size_t) snprintf(dst + length, dstSize - length, "%s 0x%08lx%s", crashRegisterNames[i],
+				dump->registers[i], (3 == i % 4) ? "\n" : " ");
+	}
+	for (i = 0; i < CRASH_FAULT_NBR && length < dstSize; i++) {
+		length += (size_t) snprintf(dst + length, dstSize - length, "%s 0x%08lx%s", crashFaultRegisterNames[i],
+				dump->faultStatus[i], (CRASH_FAULT_NBR - 1 == i) ? "\n" : " ");
+	}
+	if (length < dstSize) {
+		length += (size_t) snprintf(dst + length, dstSize - length, "EXC_RETURN 0x%08lx SP 0x%08lx\nStack:",
+				dump->excReturn, dump->stackPointer);
+	}
+	for (i = 0; i < dump->stackWords && i < CRASH_DUMP_STACK_WORDS && length < dstSize; i++) {
+		length += (size_t) snprintf(dst + length, dstSize - length, "%s 0x%08lx", (0 == i % 4) ? "\n" : "",
+				dump->stack[i]);
+	}
+	if (length < dstSize) {
+		length += (size_t) snprintf(dst + length, dstSize - length, "\nLog entries:\n");
+	}
+
+	return length;
+}
+
+/*
+ * @brief  Prints a log entry of a crash dump as a line of text, after CrashDumpPrint()
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst, LOG_LINE_MAX_SIZE + 1 bytes take any entry
+ * @param  dump : Dump of the entry, see GetCrashDump()
+ * @param  entryIdx : Index of the entry, oldest first
+ * @retval Length of the string, 0 if the dump has no such entry
+ */
+size_t CrashDumpPrintLogEntry(char* dst, const size_t dstSize, const CrashDump_TypeDef* dump, const uint8_t entryIdx) {
+	size_t length;
+
+	if (dstSize < 2) {
+		return 0;
+	}
+
+	length = FormatCrashLogEntry(dst, dstSize - 1, dump, entryIdx);
+	if (length > 0) {
+		dst[length++] = '\n';
+	}
+	dst[length] = '\0';
+
+	return length;
+}
+
+/*
+ * @brief  Encodes a crash dump without its log entries as a CrashDumpProto message, see crash_dump.h
+ * @param  stream : Destination stream
+ * @param  dump : Dump to encode, see GetCrashDump()
+ * @retval true if encoded, false if the stream is too small
+ */
+bool EncodeCrashDump(pb_ostream_t* stream, const CrashDump_TypeDef* dump) {
+	if (!pb_encode_tag(stream, PB_WT_VARINT, 1) || !pb_encode_varint(stream, dump->cause)) {
+		return false;
+	}
+	if (CRASH_CAUSE_NONE == dump->cause) {
+		return true;
+	}
+
+	return pb_encode_tag(stream, PB_WT_VARINT, 2) && pb_encode_varint(stream, dump->crashes)
+			&& pb_encode_tag(stream, PB_WT_VARINT, 3) && pb_encode_varint(stream, dump->uptime)
+			&& EncodePackedWords(stream, 4, dump->registers, CRASH_REG_NBR)
+			&& pb_encode_tag(stream, PB_WT_VARINT, 5) && pb_encode_varint(stream, dump->excReturn)
+			&& pb_encode_tag(stream, PB_WT_VARINT, 6) && pb_encode_varint(stream, dump->stackPointer)
+			&& EncodePackedWords(stream, 7, dump->faultStatus, CRASH_FAULT_NBR)
+			&& pb_encode_tag(stream, PB_WT_STRING, 8) && pb_encode_string(stream, (const uint8_t*) dump->taskName,
+					strnlen(dump->taskName, CRASH_DUMP_TASK_NAME_LEN))
+			&& EncodePackedWords(stream, 9, dump->stack,
+					(dump->stackWords < CRASH_DUMP_STACK_WORDS) ? dump->stackWords : CRASH_DUMP_STACK_WORDS);
+}
+
+/*
+ * @brief  Encodes a log entry of a crash dump as a CrashDumpProto message, see crash_dump.h
+ * @param  stream : Destination stream
+ * @param  dump : Dump of the entry, see GetCrashDump()
+ * @param  entryIdx : Index of the entry, below dump->logEntriesNbr
+ * @retval true if encoded, false if the stream is too small
+ */
+bool EncodeCrashDumpLogEntry(pb_ostream_t* stream, const CrashDump_TypeDef* dump, const uint8_t entryIdx) {
+	char line[LOG_LINE_MAX_SIZE];
+	size_t length;
+
+	length = FormatCrashLogEntry(line, sizeof(line), dump, entryIdx);
+
+	return pb_encode_tag(stream, PB_WT_STRING, 10) && pb_encode_string(stream, (const uint8_t*) line, length);
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Starts a crash dump in RAM, with everything that does not depend on the cause
+ * @param  cause : Cause of the crash
+ * @retval None
+ */
+static void BeginCrashDump(const CrashCause_TypeDef cause) {
+	memset(&crashDump, 0, sizeof(CrashDump_TypeDef));
+	crashDump.firmwareId = firmwareId;
+	crashDump.cause = cause;
+	crashDump.uptime = HAL_GetTick();
+
+	/* The name of the running task, taken from its control block without any lock */
+	if (taskSCHEDULER_NOT_STARTED != xTaskGetSchedulerState()) {
+		CopyTaskName((const char*) pcTaskGetTaskName(NULL));
+	}
+
+	crashDump.logEntriesNbr = GetLastLogEntries(crashDump.logEntries, CRASH_DUMP_LOG_ENTRIES);
+}
+
+/*
+ * @brief  Copies a task name from its control block, which is checked to be in RAM
+ * @param  taskName : Name of the task
+ * @retval None
+ */
+static void CopyTaskName(const char* taskName) {
+	uint8_t i;
+
+	if (IS_RAM_RANGE((uint32_t) taskName, CRASH_DUMP_TASK_NAME_LEN)) {
+		for (i = 0; i < CRASH_DUMP_TASK_NAME_LEN - 1 && '\0' != taskName[i]; i++) {
+			crashDump.taskName[i] = taskName[i];
+		}
+	}
+}
+
+/*
+ * @brief  Copies the registers of an exception frame and the stack above it
+ * @param  stackAddr : Address of the frame
+ * @param  excReturn : EXC_RETURN of the frame, which tells if it has the FPU registers
+ * @retval None
+ */
+static void CopyFaultFrame(const uint32_t stackAddr, const uint32_t excReturn) {
+	const uint32_t* frame = (const uint32_t*) stackAddr;
+	uint32_t frameWords = (excReturn & EXC_RETURN_STANDARD_FRAME) ? FAULT_FRAME_WORDS : FAULT_FRAME_FP_WORDS;
+	uint8_t i;
+
+	if (!IS_RAM_RANGE(stackAddr, FAULT_FRAME_WORDS*sizeof(uint32_t))) {
+		crashDump.stackPointer = stackAddr;
+		return;
+	}
+
+	for (i = 0; i < CRASH_REG_NBR; i++) {
+		crashDump.registers[i] = frame[i];
+	}
+	if (crashDump.registers[CRASH_REG_PSR] & PSR_STACK_ALIGN) {
+		frameWords++;
+	}
+	CopyStack(stackAddr + frameWords*sizeof(uint32_t));
+}
+
+/*
+ * @brief  Copies the stack words from a stack pointer up to the end of the RAM
+ * @param  stackPointer : First word to copy
+ * @retval None
+ */
+static void CopyStack(const uint32_t stackPointer) {
+	const uint32_t* stack = (const uint32_t*) stackPointer;
+
+	crashDump.stackPointer = stackPointer;
+	for (crashDump.stackWords = 0; crashDump.stackWords < CRASH_DUMP_STACK_WORDS
+			&& IS_RAM_RANGE(stackPointer, (crashDump.stackWords + 1)*sizeof(uint32_t)); crashDump.stackWords++) {
+		crashDump.stack[crashDump.stackWords] = stack[crashDump.stackWords];
+	}
+}
+
+/*
+ * @brief  Completes the crash dump in RAM and resets the board, unless it had too many quick crashes in a row. With
+ *         FCB_QUICK_CRASH_BOOTLOADER, it then resets the board to the ROM bootloader instead.
+ * @param  None
+ * @retval None, returns only if the board is not reset
+ */
+static void EndCrashDump(void) {
+	crashDump.magic = CRASH_DUMP_MAGIC;
+	crashDump.checksum = CrashDumpChecksum(&crashDump);
+
+	if (QUICK_CRASH_MAGIC != quickCrashMagic) {
+		quickCrashMagic = QUICK_CRASH_MAGIC; /* Crashed before InitCrashDump() */
+		quickCrashes = 0;
+	}
+	quickCrashes = (crashDump.uptime < CRASH_DUMP_QUICK_CRASH_TIME) ? quickCrashes + 1 : 0;
+
+	if (quickCrashes < CRASH_DUMP_MAX_QUICK_CRASHES) {
+		NVIC_SystemReset();
+	}
+
+#ifdef FCB_QUICK_CRASH_BOOTLOADER
+	/* The quick crashes count again from the bootloader, which leaves to the firmware on the next reset */
+	quickCrashes = 0;
+	RequestBootloaderOnReset();
+	NVIC_SystemReset();
+#endif
+}
+
+/*
+ * @brief  Calculates the checksum of a crash dump, the inverted sum of its words before the checksum
+ * @param  dump : Dump
+ * @retval Checksum
+ */
+static uint32_t CrashDumpChecksum(const CrashDump_TypeDef* dump) {
+	const uint32_t* words = (const uint32_t*) dump;
+	uint32_t sum = 0;
+	uint16_t i;
+
+	for (i = 0; i < offsetof(CrashDump_TypeDef, checksum)/sizeof(uint32_t); i++) {
+		sum += words[i];
+	}
+
+	return ~sum;
+}
+
+/*
+ * @brief  Checks that a crash dump is complete
+ * @param  dump : Dump
+ * @retval true if valid, else false
+ */
+static bool IsCrashDumpValid(const CrashDump_TypeDef* dump) {
+	return CRASH_DUMP_MAGIC == dump->magic && CrashDumpChecksum(dump) == dump->checksum;
+}
+
+/*
+ * @brief  Identifies the firmware by the sum of its vector table, which changes with the addresses of the handlers
+ * @param  None
+ * @retval Firmware identifier
+ */
+static uint32_t GetFirmwareId(void) {
+	const uint32_t* vectors = (const uint32_t*) SCB->VTOR;
+	uint32_t sum = 0;
+	uint8_t i;
+
+	for (i = 0; i < VECTOR_TABLE_WORDS; i++) {
+		sum += vectors[i];
+	}
+
+	return sum;
+}
+
+/*
+ * @brief  Encodes words as a packed repeated uint32 field
+ * @param  stream : Destination stream
+ * @param  field : Field number
+ * @param  words : Words to encode
+ * @param  count : Number of words
+ * @retval true if encoded, false if the stream is too small
+ */
+static bool EncodePackedWords(pb_ostream_t* stream, const uint32_t field, const uint32_t* words, const uint32_t count) {
+	pb_ostream_t sizeStream = PB_OSTREAM_SIZING;
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		pb_encode_varint(&sizeStream, words[i]);
+	}
+
+	if (!pb_encode_tag(stream, PB_WT_STRING, field) || !pb_encode_varint(stream, sizeStream.bytes_written)) {
+		return false;
+	}
+	for (i = 0; i < count; i++) {
+		if (!pb_encode_varint(stream, words[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * @brief  Formats a log entry of a crash dump. The format strings are in the flash of the firmware that crashed, the
+ *         entries of another firmware are printed raw.
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @param  dump : Dump of the entry
+ * @param  entryIdx : Index of the entry
+ * @retval Length of the string, cut to dstSize - 1
+ */
+static size_t FormatCrashLogEntry(char* dst, const size_t dstSize, const CrashDump_TypeDef* dump,
+		const uint8_t entryIdx) {
+	const LogEntry_TypeDef* entry = &dump->logEntries[entryIdx];
+	int length;
+
+	if (entryIdx >= dump->logEntriesNbr || entryIdx >= CRASH_DUMP_LOG_ENTRIES || 0 == dstSize) {
+		return 0;
+	}
+
+	if (dump->firmwareId == firmwareId && IS_FLASH_ADDR((uint32_t) entry->format)) {
+		return FormatLogEntry(dst, dstSize, entry);
+	}
+
+	length = snprintf(dst, dstSize, "%lu format 0x%08lx: 0x%08lx 0x%08lx 0x%08lx 0x%08lx", entry->timestamp,
+			(uint32_t) entry->format, entry->args[0], entry->args[1], entry->args[2], entry->args[3]);
+	if (length < 0) {
+		length = 0;
+	}
+
+	return ((size_t) length < dstSize) ? (size_t) length : dstSize - 1;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,312 @@
+/******************************************************************************
+ * @file    deadline_monitor.c
+ * @author  Dragonfly
+ * @brief   Control loop deadline monitor. Each monitored loop stamps the
+ *          start and the end of its updates with the DWT cycle counter. The
+ *          time between two starts is the period, checked against the
+ *          expected period for jitter and late starts, and the time from
+ *          the start to the end is the execution time, checked for the
+ *          worst case and for executions longer than the period. A monitor
+ *          call costs a cycle counter read and a short critical section, so
+ *          it stays on in flight builds.
+ *          Stamping is done by the flight control task only.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "deadline_monitor.h"
+
+#include "common.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+#define CYCLES_PER_US      (SystemCoreClock / 1000000)
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static DeadlineLoopStats_TypeDef loopStats[DEADLINE_LOOP_NBR];
+
+/* Start of the latest update of each loop [core clock cycles] */
+static uint32_t beginTimestamps[DEADLINE_LOOP_NBR];
+static uint8_t hasBegun[DEADLINE_LOOP_NBR];
+static uint8_t isExecuting[DEADLINE_LOOP_NBR];
+
+/* Time of the latest overrun of each loop [ms], valid if hasOverrun */
+static uint32_t overrunTicks[DEADLINE_LOOP_NBR];
+static uint8_t hasOverrun[DEADLINE_LOOP_NBR];
+
+/* Private function prototypes -----------------------------------------------*/
+static void ResetLoopStats(DeadlineLoopStats_TypeDef* stats);
+static bool EncodeDeadlineLoop(pb_ostream_t* stream, const DeadlineLoop_TypeDef loop,
+		const DeadlineLoopStats_TypeDef* stats);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Sets the expected period of a loop and starts monitoring it
+ * @param  loop : Monitored loop
+ * @param  period : Expected time between the starts of two updates [s], 0 to stop monitoring
+ * @retval None
+ */
+void DeadlineMonitorSetPeriod(const DeadlineLoop_TypeDef loop, const float32_t period) {
+	if (loop >= DEADLINE_LOOP_NBR) {
+		return;
+	}
+
+	taskENTER_CRITICAL();
+	ResetLoopStats(&loopStats[loop]);
+	loopStats[loop].expectedPeriod = (uint32_t) (period * SystemCoreClock);
+	hasBegun[loop] = 0;
+	isExecuting[loop] = 0;
+	hasOverrun[loop] = 0;
+	taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Stamps the start of an update, which completes the period since the previous start
+ * @param  loop : Monitored loop
+ * @retval None
+ */
+void DeadlineMonitorBegin(const DeadlineLoop_TypeDef loop) {
+	uint32_t timestamp = GetTimestamp();
+	DeadlineLoopStats_TypeDef* stats;
+	uint32_t period;
+	uint32_t jitter;
+
+	if (loop >= DEADLINE_LOOP_NBR || 0 == loopStats[loop].expectedPeriod) {
+		return;
+	}
+	stats = &loopStats[loop];
+
+	if (hasBegun[loop]) {
+		period = timestamp - beginTimestamps[loop];
+		jitter = (period > stats->expectedPeriod) ? period - stats->expectedPeriod : stats->expectedPeriod - period;
+
+		/* The reader copies the statistics in a critical section */
+		taskENTER_CRITICAL();
+		stats->periods++;
+		if (period < stats->minPeriod) {
+			stats->minPeriod = period;
+		}
+		if (period > stats->maxPeriod) {
+			stats->maxPeriod = period;
+		}
+		if (jitter > stats->maxJitter) {
+			stats->maxJitter = jitter;
+		}
+		stats->jitterSum += jitter;
+		if (period > stats->expectedPeriod + stats->expectedPeriod / 100 * DEADLINE_LATE_MARGIN) {
+			stats->lateStarts++;
+			overrunTicks[loop] = HAL_GetTick();
+			hasOverrun[loop] = 1;
+		}
+		taskEXIT_CRITICAL();
+	}
+
+	beginTimestamps[loop] = timestamp;
+	hasBegun[loop] = 1;
+	isExecuting[loop] = 1;
+}
+
+/*
+ * @brief  Stamps the end of an update, ignored without a start since the last end
+ * @param  loop : Monitored loop
+ * @retval None
+ */
+void DeadlineMonitorEnd(const DeadlineLoop_TypeDef loop) {
+	DeadlineLoopStats_TypeDef* stats;
+	uint32_t execution;
+
+	if (loop >= DEADLINE_LOOP_NBR || !isExecuting[loop]) {
+		return;
+	}
+	stats = &loopStats[loop];
+	execution = GetTimestamp() - beginTimestamps[loop];
+	isExecuting[loop] = 0;
+
+	/* The reader copies the statistics in a critical section */
+	taskENTER_CRITICAL();
+	stats->executions++;
+	stats->executionSum += execution;
+	if (execution > stats->wcet) {
+		stats->wcet = execution;
+	}
+	if (execution > stats->expectedPeriod) {
+		stats->longExecutions++;
+		overrunTicks[loop] = HAL_GetTick();
+		hasOverrun[loop] = 1;
+	}
+	taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Gets the loops with a late start or a long execution in the last DEADLINE_FLAG_HOLD_TIME. Read by the
+ *         telemetry and the blackbox.
+ * @param  None
+ * @retval Bit (1 << DeadlineLoop_TypeDef) set for each such loop, 0 if all loops keep their deadlines
+ */
+uint8_t GetDeadlineOverrunFlags(void) {
+	uint32_t tick = HAL_GetTick();
+	uint8_t flags = 0;
+	uint8_t i;
+
+	for (i = 0; i < DEADLINE_LOOP_NBR; i++) {
+		if (hasOverrun[i] && tick - overrunTicks[i] < DEADLINE_FLAG_HOLD_TIME) {
+			flags |= 1 << i;
+		}
+	}
+
+	return flags;
+}
+
+/*
+ * @brief  Gets a consistent copy of the deadline statistics
+ * @param  dstStats : Destination statistics, indexed by DeadlineLoop_TypeDef
+ * @retval None
+ */
+void DeadlineMonitorGetStats(DeadlineLoopStats_TypeDef dstStats[DEADLINE_LOOP_NBR]) {
+	taskENTER_CRITICAL();
+	memcpy(dstStats, loopStats, sizeof(loopStats));
+	taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Clears the deadline statistics and overrun flags, the expected periods are kept
+ * @param  None
+ * @retval None
+ */
+void DeadlineMonitorReset(void) {
+	uint8_t i;
+
+	taskENTER_CRITICAL();
+	for (i = 0; i < DEADLINE_LOOP_NBR; i++) {
+		ResetLoopStats(&loopStats[i]);
+		hasOverrun[i] = 0;
+	}
+	taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Prints the deadline statistics as a table
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @retval Length of the table string
+ */
+size_t DeadlineMonitorPrint(char* dst, const size_t dstSize) {
+	static const char* loopNames[DEADLINE_LOOP_NBR] = { "Inner", "Outer", "Estimator" };
+	DeadlineLoopStats_TypeDef stats[DEADLINE_LOOP_NBR];
+	uint32_t cyclesPerUs = CYCLES_PER_US;
+	size_t length;
+	uint8_t i;
+
+	DeadlineMonitorGetStats(stats);
+
+	length = (size_t) snprintf(dst, dstSize, "\nDeadlines [us], overrun flags 0x%02x\n%-10s%7s%7s%7s%7s%7s%9s%7s%7s%7s\n",
+			GetDeadlineOverrunFlags(), "Loop", "Period", "Min", "Max", "MaxJit", "AvgJit", "Late", "WCET", "AvgExe",
+			"Long");
+
+	for (i = 0; i < DEADLINE_LOOP_NBR && length < dstSize; i++) {
+		if (0 == stats[i].expectedPeriod) {
+			length += (size_t) snprintf(dst + length, dstSize - length, "%-10s not monitored\n", loopNames[i]);
+		} else if (0 == stats[i].periods || 0 == stats[i].executions) {
+			length += (size_t) snprintf(dst + length, dstSize - length, "%-10s%7lu no updates\n", loopNames[i],
+					(unsigned long) (stats[i].expectedPeriod / cyclesPerUs));
+		} else {
+			length += (size_t) snprintf(dst + length, dstSize - length,
+					"%-10s%7lu%7lu%7lu%7lu%7lu%9lu%7lu%7lu%7lu\n", loopNames[i],
+					(unsigned long) (stats[i].expectedPeriod / cyclesPerUs),
+					(unsigned long) (stats[i].minPeriod / cyclesPerUs),
+					(unsigned long) (stats[i].maxPeriod / cyclesPerUs),
+					(unsigned long) (stats[i].maxJitter / cyclesPerUs),
+					(unsigned long) (stats[i].jitterSum / stats[i].periods / cyclesPerUs),
+					(unsigned long) stats[i].lateStarts,
+					(unsigned long) (stats[i].wcet / cyclesPerUs),
+					(unsigned long) (stats[i].executionSum / stats[i].executions / cyclesPerUs),
+					(unsigned long) stats[i].longExecutions);
+		}
+	}
+
+	return length;
+}
+
+/*
+ * @brief  Encodes the overrun flags and the statistics of the monitored loops as a DeadlineStatsProto message, see
+ *         deadline_monitor.h
+ * @param  stream : Destination stream
+ * @retval true if encoded, false if the stream is too small
+ */
+bool EncodeDeadlineStats(pb_ostream_t* stream) {
+	DeadlineLoopStats_TypeDef stats[DEADLINE_LOOP_NBR];
+	uint8_t i;
+
+	DeadlineMonitorGetStats(stats);
+
+	if (!pb_encode_tag(stream, PB_WT_VARINT, 1) || !pb_encode_varint(stream, GetDeadlineOverrunFlags())
+			|| !pb_encode_tag(stream, PB_WT_VARINT, 2) || !pb_encode_varint(stream, SystemCoreClock)) {
+		return false;
+	}
+
+	for (i = 0; i < DEADLINE_LOOP_NBR; i++) {
+		if (stats[i].expectedPeriod > 0 && !EncodeDeadlineLoop(stream, (DeadlineLoop_TypeDef) i, &stats[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Clears the statistics of one loop, except its expected period
+ * @param  stats : Loop statistics
+ * @retval None
+ */
+static void ResetLoopStats(DeadlineLoopStats_TypeDef* stats) {
+	uint32_t expectedPeriod = stats->expectedPeriod;
+
+	memset(stats, 0, sizeof(DeadlineLoopStats_TypeDef));
+	stats->expectedPeriod = expectedPeriod;
+	stats->minPeriod = UINT32_MAX;
+}
+
+/*
+ * @brief  Encodes the statistics of one loop as a DeadlineLoopProto submessage, see deadline_monitor.h
+ * @param  stream : Destination stream
+ * @param  loop : Monitored loop
+ * @param  stats : Statistics of the loop
+ * @retval true if encoded, false if the stream is too small
+ */
+static bool EncodeDeadlineLoop(pb_ostream_t* stream, const DeadlineLoop_TypeDef loop,
+		const DeadlineLoopStats_TypeDef* stats) {
+	uint8_t loopBuffer[DEADLINE_LOOP_MSG_MAX_SIZE];
+	pb_ostream_t loopStream = pb_ostream_from_buffer(loopBuffer, sizeof(loopBuffer));
+
+	if (!pb_encode_tag(&loopStream, PB_WT_VARINT, 1) || !pb_encode_varint(&loopStream, loop)
+			|| !pb_encode_tag(&loopStream, PB_WT_VARINT, 2) || !pb_encode_varint(&loopStream, stats->expectedPeriod)
+			|| !pb_encode_tag(&loopStream, PB_WT_VARINT, 3) || !pb_encode_varint(&loopStream, stats->periods)
+			|| !pb_encode_tag(&loopStream, PB_WT_VARINT, 4) || !pb_encode_varint(&loopStream, stats->maxPeriod)
+			|| !pb_encode_tag(&loopStream, PB_WT_VARINT, 5) || !pb_encode_varint(&loopStream, stats->maxJitter)
+			|| !pb_encode_tag(&loopStream, PB_WT_VARINT, 6) || !pb_encode_varint(&loopStream, stats->lateStarts)
+			|| !pb_encode_tag(&loopStream, PB_WT_VARINT, 7) || !pb_encode_varint(&loopStream, stats->longExecutions)
+			|| !pb_encode_tag(&loopStream, PB_WT_VARINT, 8) || !pb_encode_varint(&loopStream, stats->wcet)) {
+		return false;
+	}
+
+	/* Field 3 of DeadlineStatsProto, length delimited */
+	return pb_encode_tag(stream, PB_WT_STRING, 3) && pb_encode_string(stream, loopBuffer, loopStream.bytes_written);
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,479 @@
+/******************************************************************************
+ * @file    deferred_log.c
+ * @author  Dragonfly
+ * @brief   Deferred logger. The ring of records has many producers, tasks and
+ *          ISRs, and the log work as its only consumer. A producer reserves a
+ *          record by incrementing the head with an exclusive load/store pair,
+ *          fills it and publishes it by writing its sequence number last. The
+ *          consumer takes the records in order and stops at one that is
+ *          reserved but not yet published. A record that does not fit the
+ *          ring is dropped and counted, producers never wait.
+ *
+ *          A data record of the USB log endpoint is a header slot with its
+ *          data following it over the next slots, never wrapping, so that the
+ *          endpoint sends it in place. Its slots are released when the
+ *          transfer is done, with their sequence numbers cleared, as the data
+ *          has overwritten those of all but the first.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "deferred_log.h"
+
+#include "blackbox.h"
+#include "fcb_error.h"
+#include "usbd_cdc_if.h"
+#include "usbd_log_if.h"
+#include "trace_recorder.h"
+#include "deferred_work.h"
+#include "rate_groups.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Header of a data record, laid over the timestamp and format of a message */
+typedef struct {
+	uint16_t size;                  // Of the data [bytes], 0 for the padding up to the end of the ring
+	uint16_t slots;                 // Taken by the record, with its header
+	const char* format;             // NULL, which tells a data record from a message
+} LogDataHeader_TypeDef;
+
+typedef struct {
+	volatile uint32_t sequence;     // Ticket + 1 once published, the ticket being the head at the reservation
+	union {
+		LogEntry_TypeDef entry;     // Message
+		LogDataHeader_TypeDef data; // Data record, the data follows the header
+	} content;
+} LogRecord_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define LOG_POLL_PHASE              5       // [ms] in the 20 Hz rate group, before the event journal
+
+/* Offset of the data of a data record in its first slot */
+#define LOG_DATA_OFFSET             (offsetof(LogRecord_TypeDef, content) + sizeof(LogDataHeader_TypeDef))
+
+_Static_assert(offsetof(LogEntry_TypeDef, format) == offsetof(LogDataHeader_TypeDef, format),
+		"The format of a message and of a data header must overlap");
+_Static_assert(LOG_DATA_OFFSET + LOG_DATA_MAX_SIZE <= (LOG_RING_SIZE / 2) * sizeof(LogRecord_TypeDef),
+		"A data record must fit half of the ring, as it may need padding up to the end of the ring");
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static LogRecord_TypeDef logRing[LOG_RING_SIZE];
+static volatile uint32_t logHead = 0;       // Next ticket to reserve, written by the producers
+static volatile uint32_t logTail = 0;       // Next ticket to take, written by the consumer only
+static volatile uint32_t logDropped = 0;
+static volatile uint8_t logSinks = LOG_SINKS_DEFAULT;
+
+static bool isLogDataSending = false;       // A data record is being sent by the USB log endpoint, log work only
+
+/* The producers do not post the work, an ISR above the FreeRTOS syscall priority may log. It is posted by the poll
+ * job when the ring has records, and by the USB log endpoint when a data record has been sent. */
+static DeferredWorkId_TypeDef logWorkId = DEFERRED_WORK_INVALID_ID;
+static RateGroupJobId_TypeDef logPollJobId;
+
+/* Private function prototypes -----------------------------------------------*/
+static void LogWork(void* argument);
+static void LogPoll(void* argument);
+static void AtomicIncrement(volatile uint32_t* value);
+static void PublishLogData(const uint32_t ticket, const uint8_t* data, const uint16_t size, const uint16_t slots);
+static void SendLogRecord(const LogRecord_TypeDef* record);
+static bool SendLogData(const LogDataHeader_TypeDef* header);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Registers the log work, which formats the records and sends them to the log sinks, with the low priority
+ *         deferred worker, and the job that polls the ring with the 20 Hz rate group
+ * @param  None
+ * @retval None
+ */
+void CreateLogWork(void) {
+	if (FCB_OK != DeferredWorkRegister("Log", LogWork, NULL, DEFERRED_WORKER_LOW, &logWorkId)
+			|| FCB_OK != RateGroupRegister("LOG", LogPoll, NULL, RATE_GROUP_20HZ, LOG_POLL_PHASE, &logPollJobId)) {
+		ErrorHandler();
+	}
+}
+
+/*
+ * @brief  Records a log message, formatted later by the log work. May be called from an ISR.
+ * @param  format : printf format string literal, for up to LOG_ARGS_MAX 32 bit arguments
+ * @param  arg0 : First argument
+ * @param  arg1 : Second argument
+ * @param  arg2 : Third argument
+ * @param  arg3 : Fourth argument
+ * @retval None
+ */
+void LogRecord(const char* format, const uint32_t arg0, const uint32_t arg1, const uint32_t arg2,
+		const uint32_t arg3) {
+	LogRecord_TypeDef* record;
+	uint32_t ticket;
+
+	/* The tail only moves on, so a full ring seen here is at most too pessimistic */
+	do {
+		ticket = __LDREXW(&logHead);
+		if (ticket - logTail >= LOG_RING_SIZE) {
+			__CLREX();
+			AtomicIncrement(&logDropped);
+			return;
+		}
+	} while (__STREXW(ticket + 1, &logHead));
+
+	record = &logRing[ticket & (LOG_RING_SIZE - 1)];
+	record->content.entry.timestamp = HAL_GetTick();
+	record->content.entry.format = format;
+	record->content.entry.args[0] = arg0;
+	record->content.entry.args[1] = arg1;
+	record->content.entry.args[2] = arg2;
+	record->content.entry.args[3] = arg3;
+
+	__DMB(); /* record must be complete before it is published */
+	record->sequence = ticket + 1;
+}
+
+/*
+ * @brief  Records data to send over the USB log endpoint, sent by the log work. May be called from an ISR.
+ * @param  data : Data to send
+ * @param  size : Size of data, at most LOG_DATA_MAX_SIZE [bytes]
+ * @retval true if recorded, false if too large or if it did not fit the ring, the data is dropped
+ */
+bool LogRecordData(const uint8_t* data, const uint16_t size) {
+	const uint16_t slots = (uint16_t) ((LOG_DATA_OFFSET + size + sizeof(LogRecord_TypeDef) - 1)
+			/ sizeof(LogRecord_TypeDef));
+	uint32_t ticket;
+	uint32_t padding;
+
+	if (0 == size || size > LOG_DATA_MAX_SIZE) {
+		return false;
+	}
+
+	/* The data does not wrap, the slots up to the end of the ring are padding if it would */
+	do {
+		ticket = __LDREXW(&logHead);
+		padding = LOG_RING_SIZE - (ticket & (LOG_RING_SIZE - 1));
+		padding = (padding < slots) ? padding : 0;
+		if (ticket + padding + slots - logTail > LOG_RING_SIZE) {
+			__CLREX();
+			return false;
+		}
+	} while (__STREXW(ticket + padding + slots, &logHead));
+
+	if (padding > 0) {
+		PublishLogData(ticket, NULL, 0, (uint16_t) padding);
+	}
+	PublishLogData(ticket + padding, data, size, slots);
+
+	return true;
+}
+
+/*
+ * @brief  Posts the log work when the USB log endpoint has sent a data record or dropped it. Function called from ISR.
+ * @param  None
+ * @retval None
+ */
+void LogDataSentFromISR(void) {
+	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+
+	if (logWorkId != DEFERRED_WORK_INVALID_ID) {
+		DeferredWorkPostFromISR(logWorkId, &xHigherPriorityTaskWoken);
+		portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+	}
+}
+
+/*
+ * @brief  Lets a call site record at most once per interval, the calls in between are counted. May be called from an
+ *         ISR, as long as each call site is used from one context only.
+ * @param  limit : State of the call site
+ * @param  intervalMs : Minimum time between records [ms]
+ * @param  suppressed : Destination for the number of calls suppressed since the previous record
+ * @retval true if the call site should record now, else false
+ */
+bool LogRateLimitPass(LogRateLimit_TypeDef* limit, const uint32_t intervalMs, uint32_t* suppressed) {
+	uint32_t now = HAL_GetTick();
+
+	if (limit->hasRecorded && now - limit->lastTime < intervalMs) {
+		limit->suppressed++;
+		return false;
+	}
+
+	*suppressed = limit->suppressed;
+	limit->suppressed = 0;
+	limit->lastTime = now;
+	limit->hasRecorded = true;
+	return true;
+}
+
+/*
+ * @brief  Sets the sinks the formatted log records are sent to
+ * @param  sinks : LOG_SINK_USB and/or LOG_SINK_BLACKBOX, 0 to discard the records
+ * @retval None
+ */
+void SetLogSinks(const uint8_t sinks) {
+	logSinks = sinks;
+}
+
+/*
+ * @brief  Gets the sinks the formatted log records are sent to
+ * @param  None
+ * @retval LOG_SINK_USB and/or LOG_SINK_BLACKBOX
+ */
+uint8_t GetLogSinks(void) {
+	return logSinks;
+}
+
+/*
+ * @brief  Gets the log record counters
+ * @param  status : Destination status
+ * @retval None
+ */
+void GetLogStatus(LogStatus_TypeDef* status) {
+	status->dropped = logDropped;
+	status->recorded = logHead;
+}
+
+/*
+ * @brief  Gets the newest published log messages still in the ring, sent or not. Takes no lock, so that it may be
+ *         called from a fault handler. A record overwritten while it is copied may be mixed with its successor.
+ * @param  dstEntries : Destination entries, oldest first
+ * @param  maxEntries : Size of dstEntries
+ * @retval Number of entries copied
+ */
+uint8_t GetLastLogEntries(LogEntry_TypeDef* dstEntries, const uint8_t maxEntries) {
+	const uint32_t head = logHead;
+	const uint32_t tail = logTail;
+	const uint32_t oldest = (head > LOG_RING_SIZE) ? head - LOG_RING_SIZE : 0;
+	const LogRecord_TypeDef* record;
+	uint32_t first = tail;          // Ticket of the oldest sent message to copy
+	uint32_t sequence;
+	uint8_t unsent = 0;
+	uint8_t skipped = 0;
+	uint8_t nbrOfEntries = 0;
+
+	/* The records not sent yet are walked from the tail, a data record by its size, up to one that may be reserved
+	 * but not yet published by a producer that was interrupted */
+	for (sequence = tail; sequence != head && logRing[sequence & (LOG_RING_SIZE - 1)].sequence == sequence + 1;) {
+		record = &logRing[sequence & (LOG_RING_SIZE - 1)];
+		if (NULL == record->content.data.format) {
+			sequence += (record->content.data.slots > 0) ? record->content.data.slots : 1;
+		} else {
+			sequence++;
+			unsent++;
+		}
+	}
+
+	/* The sent messages are walked back from the tail, the slots of the sent data records have been cleared */
+	for (sequence = tail; sequence > oldest && nbrOfEntries + unsent < maxEntries; sequence--) {
+		record = &logRing[(sequence - 1) & (LOG_RING_SIZE - 1)];
+		if (record->sequence == sequence) {
+			first = sequence - 1;
+			nbrOfEntries++;
+		} else if (0 != record->sequence) {
+			break;
+		}
+	}
+
+	for (sequence = first; sequence != tail; sequence++) {
+		record = &logRing[sequence & (LOG_RING_SIZE - 1)];
+		if (record->sequence == sequence + 1) {
+			*dstEntries++ = record->content.entry;
+		}
+	}
+
+	/* The newest of the messages not sent yet */
+	for (sequence = tail; sequence != head && logRing[sequence & (LOG_RING_SIZE - 1)].sequence == sequence + 1
+			&& nbrOfEntries < maxEntries;) {
+		record = &logRing[sequence & (LOG_RING_SIZE - 1)];
+		if (NULL == record->content.data.format) {
+			sequence += (record->content.data.slots > 0) ? record->content.data.slots : 1;
+		} else {
+			sequence++;
+			if (unsent - skipped > maxEntries - nbrOfEntries) {
+				skipped++;
+			} else {
+				*dstEntries++ = record->content.entry;
+				nbrOfEntries++;
+			}
+		}
+	}
+
+	return nbrOfEntries;
+}
+
+/*
+ * @brief  Formats a log entry as a line without its line end, its time first
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @param  entry : Entry to format
+ * @retval Length of the line, cut to dstSize - 1
+ */
+size_t FormatLogEntry(char* dst, const size_t dstSize, const LogEntry_TypeDef* entry) {
+	int length;
+
+	length = snprintf(dst, dstSize, "%lu ", (unsigned long) entry->timestamp);
+	if (length >= 0 && (size_t) length < dstSize) {
+		length += snprintf(dst + length, dstSize - length, entry->format, entry->args[0], entry->args[1],
+				entry->args[2], entry->args[3]);
+	}
+	if (length < 0) {
+		length = 0;
+	}
+
+	return ((size_t) length < dstSize) ? (size_t) length : dstSize - 1;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief  Rate group job that posts the log work when the ring has records
+ * @param  argument : Unused parameter
+ * @retval None
+ */
+static void LogPoll(void* argument) {
+	(void) argument;
+
+	if (logTail != logHead)
+		DeferredWorkPost(logWorkId);
+}
+
+/**
+ * @brief  Deferred work takes the published records from the ring, formats the messages and sends them to the log
+ *         sinks, and sends the data records over the USB log endpoint
+ * @param  argument : Unused parameter
+ * @retval None
+ */
+static void LogWork(void* argument) {
+	LogRecord_TypeDef record;
+	LogRecord_TypeDef* next;
+	uint16_t i;
+
+	(void) argument;
+
+	while (logTail != logHead) {
+		next = &logRing[logTail & (LOG_RING_SIZE - 1)];
+		if (next->sequence != logTail + 1) {
+			break; /* Reserved by a producer that has been preempted, taken on the next poll */
+		}
+
+		if (NULL == next->content.data.format) {
+			if (!SendLogData(&next->content.data)) {
+				break; /* Being sent, taken when the endpoint posts the work */
+			}
+
+			/* The sequence numbers are cleared, the data has overwritten those of the slots after the first */
+			for (i = next->content.data.slots; i > 0; i--) {
+				logRing[(logTail + i - 1) & (LOG_RING_SIZE - 1)].sequence = 0;
+			}
+			__DMB();
+			logTail += (next->content.data.slots > 0) ? next->content.data.slots : 1;
+			continue;
+		}
+
+		/* The record may be reserved again once the tail has moved past it */
+		memcpy(&record, next, sizeof(record));
+		__DMB();
+		logTail++;
+
+		SendLogRecord(&record);
+	}
+}
+
+/*
+ * @brief  Increments a counter shared by tasks and ISRs without masking interrupts
+ * @param  value : Counter
+ * @retval None
+ */
+static void AtomicIncrement(volatile uint32_t* value) {
+	uint32_t count;
+
+	do {
+		count = __LDREXW(value);
+	} while (__STREXW(count + 1, value));
+}
+
+/*
+ * @brief  Fills and publishes a data record, or the padding up to the end of the ring
+ * @param  ticket : Ticket of the first slot
+ * @param  data : Data, NULL for the padding
+ * @param  size : Size of data, 0 for the padding [bytes]
+ * @param  slots : Slots reserved for the record
+ * @retval None
+ */
+static void PublishLogData(const uint32_t ticket, const uint8_t* data, const uint16_t size, const uint16_t slots) {
+	LogRecord_TypeDef* record = &logRing[ticket & (LOG_RING_SIZE - 1)];
+
+	record->content.data.size = size;
+	record->content.data.slots = slots;
+	record->content.data.format = NULL;
+	if (size > 0) {
+		memcpy((uint8_t*) record + LOG_DATA_OFFSET, data, size);
+	}
+
+	__DMB(); /* record must be complete before it is published */
+	record->sequence = ticket + 1;
+}
+
+/*
+ * @brief  Formats a record as a line, its time first, and sends it to the log sinks
+ * @param  record : Record to send
+ * @retval None
+ */
+static void SendLogRecord(const LogRecord_TypeDef* record) {
+	static char line[LOG_LINE_MAX_SIZE];
+	uint8_t sinks = logSinks;
+	size_t length;
+
+	if (0 == sinks) {
+		return;
+	}
+
+	/* Room is left for the line end */
+	length = FormatLogEntry(line, LOG_LINE_MAX_SIZE - 1, &record->content.entry);
+	line[length++] = '\n';
+	line[length] = '\0';
+
+	if (sinks & LOG_SINK_USB) {
+		USBComSendString(line);
+	}
+	if (sinks & LOG_SINK_BLACKBOX) {
+		BlackboxLogText(line, (uint16_t) length);
+	}
+}
+
+/*
+ * @brief  Sends a data record over the USB log endpoint, from the ring in place. Called again for the same record
+ *         until it is done.
+ * @param  header : Header of the data record, the data follows it
+ * @retval true if the record is done with, sent, dropped or padding, false while it is being sent
+ */
+static bool SendLogData(const LogDataHeader_TypeDef* header) {
+	if (isLogDataSending) {
+		if (USBLogIsSending()) {
+			return false;
+		}
+		isLogDataSending = false;
+		return true;
+	}
+
+	/* The data is dropped if the USB is not configured */
+	if (header->size > 0 && USBD_OK == USBLogTransmit((const uint8_t*) header + sizeof(LogDataHeader_TypeDef),
+			header->size)) {
+		isLogDataSending = true;
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
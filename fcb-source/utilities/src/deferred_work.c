@@ -0,0 +1,333 @@
+/******************************************************************************
+ * @file    deferred_work.c
+ * @author  Dragonfly
+ * @brief   Deferred work module. Each worker task has a binary semaphore and a
+ *          bit mask of its pending items. A post sets the bit of the item,
+ *          stamps it if it was not already pending and gives the semaphore.
+ *          The worker takes the whole mask at once and runs the handlers of
+ *          the set bits, so an item posted again while its handler runs is
+ *          run once more afterwards and no post is lost. The worker of an
+ *          item is created when its first item is registered at startup, so
+ *          only the workers in use cost a stack. Posting is allowed from the
+ *          ISRs at or below configMAX_SYSCALL_INTERRUPT_PRIORITY only.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "deferred_work.h"
+
+#include "common.h"
+#include "fcb_error.h"
+#include "trace_recorder.h"
+
+#include "task.h"
+#include "semphr.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+	const char* name;
+	DeferredWorkHandler_TypeDef handler;
+	void* argument;
+	DeferredWorker_TypeDef worker;
+	uint32_t postTimestamp;             // First post since the last run [core clock cycles]
+	DeferredWorkStats_TypeDef stats;
+} DeferredWorkItem_TypeDef;
+
+typedef struct {
+	const char* name;
+	unsigned portBASE_TYPE priority;
+	unsigned short stackDepth;
+} DeferredWorkerConfig_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define CYCLES_PER_US      (SystemCoreClock / 1000000)
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+
+/* Indexed by DeferredWorker_TypeDef. The high worker runs the blackbox flush and the dynamic notch analysis, which
+ * must keep up with the control loop and never block. The low worker runs the UART and USB sessions, the mass
+ * storage, the acc & mag calibration fits, the flash writer, the log, the flight mode reports and the reboot, which
+ * may block, so it has the stack the CLI commands need. */
+static const DeferredWorkerConfig_TypeDef workerConfigs[DEFERRED_WORKER_NBR] = {
+	{ "WORK_HIGH", configMAX_PRIORITIES-2, 2*configMINIMAL_STACK_SIZE },
+	{ "WORK_LOW", 1, 3*configMINIMAL_STACK_SIZE }
+};
+
+/* Written at startup only, apart from the stamps and statistics, which are guarded by critical sections */
+static DeferredWorkItem_TypeDef workItems[DEFERRED_WORK_MAX_ITEMS];
+static uint8_t workItemCount = 0;
+
+static volatile uint32_t workerPending[DEFERRED_WORKER_NBR];
+static xSemaphoreHandle workerSems[DEFERRED_WORKER_NBR];
+static xTaskHandle workerTaskHandles[DEFERRED_WORKER_NBR];
+
+/* Private function prototypes -----------------------------------------------*/
+static void CreateDeferredWorker(const DeferredWorker_TypeDef worker);
+static bool SetWorkPending(DeferredWorkItem_TypeDef* item);
+static void DeferredWorkTask(void const *argument);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Registers a work item, and creates its worker task unless it exists. Called at startup, before the
+ *         scheduler is started.
+ * @param  name : Item name for the statistics, a string literal
+ * @param  handler : Function run by the worker for the posts of the item
+ * @param  argument : Argument passed to the handler
+ * @param  worker : Worker that runs the handler
+ * @param  dstId : Destination id of the item, to post it with
+ * @retval FCB_OK if registered, FCB_ERR if the worker is invalid or there are DEFERRED_WORK_MAX_ITEMS already
+ */
+FcbRetValType DeferredWorkRegister(const char* name, const DeferredWorkHandler_TypeDef handler, void* argument,
+		const DeferredWorker_TypeDef worker, DeferredWorkId_TypeDef* dstId) {
+	DeferredWorkItem_TypeDef* item;
+
+	*dstId = DEFERRED_WORK_INVALID_ID;
+
+	if (worker >= DEFERRED_WORKER_NBR || handler == NULL || workItemCount >= DEFERRED_WORK_MAX_ITEMS) {
+		ErrorHandler();
+		return FCB_ERR;
+	}
+
+	if (workerSems[worker] == NULL) {
+		CreateDeferredWorker(worker);
+	}
+
+	item = &workItems[workItemCount];
+	item->name = name;
+	item->handler = handler;
+	item->argument = argument;
+	item->worker = worker;
+
+	*dstId = workItemCount++;
+
+	return FCB_OK;
+}
+
+/*
+ * @brief  Posts a work item from a task
+ * @param  id : Item id, see DeferredWorkRegister()
+ * @retval true if the item was queued, false if it was already pending or the id is invalid
+ */
+bool DeferredWorkPost(const DeferredWorkId_TypeDef id) {
+	bool queued;
+
+	if (id >= workItemCount) {
+		return false;
+	}
+
+	taskENTER_CRITICAL();
+	queued = SetWorkPending(&workItems[id]);
+	taskEXIT_CRITICAL();
+
+	if (queued) {
+		xSemaphoreGive(workerSems[workItems[id].worker]);
+	}
+
+	return queued;
+}
+
+/*
+ * @brief  Posts a work item from an ISR. The caller yields with portYIELD_FROM_ISR(), so that the posts of one
+ *         interrupt cost one context switch at most.
+ * @param  id : Item id, see DeferredWorkRegister()
+ * @param  pxHigherPriorityTaskWoken : Set to pdTRUE if the worker has a higher priority than the interrupted task
+ * @retval true if the item was queued, false if it was already pending or the id is invalid
+ */
+bool DeferredWorkPostFromISR(const DeferredWorkId_TypeDef id, portBASE_TYPE* pxHigherPriorityTaskWoken) {
+	unsigned portBASE_TYPE savedInterruptStatus;
+	bool queued;
+
+	if (id >= workItemCount) {
+		return false;
+	}
+
+	savedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+	queued = SetWorkPending(&workItems[id]);
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(savedInterruptStatus);
+
+	if (queued) {
+		xSemaphoreGiveFromISR(workerSems[workItems[id].worker], pxHigherPriorityTaskWoken);
+	}
+
+	return queued;
+}
+
+/*
+ * @brief  Gets a consistent copy of the statistics of a work item
+ * @param  id : Item id
+ * @param  dstStats : Destination statistics
+ * @retval None
+ */
+void DeferredWorkGetStats(const DeferredWorkId_TypeDef id, DeferredWorkStats_TypeDef* dstStats) {
+	if (id >= workItemCount) {
+		memset(dstStats, 0, sizeof(DeferredWorkStats_TypeDef));
+		return;
+	}
+
+	taskENTER_CRITICAL();
+	*dstStats = workItems[id].stats;
+	taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Clears the statistics of all work items
+ * @param  None
+ * @retval None
+ */
+void DeferredWorkReset(void) {
+	uint8_t i;
+
+	for (i = 0; i < workItemCount; i++) {
+		taskENTER_CRITICAL();
+		memset(&workItems[i].stats, 0, sizeof(DeferredWorkStats_TypeDef));
+		taskEXIT_CRITICAL();
+	}
+}
+
+/*
+ * @brief  Prints the statistics of all work items as a table
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @retval Length of the table string
+ */
+size_t DeferredWorkPrint(char* dst, const size_t dstSize) {
+	DeferredWorkStats_TypeDef stats;
+	uint32_t cyclesPerUs = CYCLES_PER_US;
+	size_t length;
+	uint8_t i;
+
+	length = (size_t) snprintf(dst, dstSize, "\nDeferred work, latency from the first post to the run in us\n"
+			"%-12s%-11s%9s%9s%9s%7s%7s%8s\n", "Item", "Worker", "Posts", "Coalesc", "Runs", "AvgLat", "MaxLat",
+			"MaxRun");
+
+	for (i = 0; i < workItemCount && length < dstSize; i++) {
+		DeferredWorkGetStats(i, &stats);
+
+		length += (size_t) snprintf(dst + length, dstSize - length, "%-12s%-11s%9lu%9lu%9lu%7lu%7lu%8lu\n",
+				workItems[i].name, workerConfigs[workItems[i].worker].name, (unsigned long) stats.posts,
+				(unsigned long) stats.coalesced, (unsigned long) stats.runs,
+				(0 == stats.runs) ? 0UL : (unsigned long) (stats.sumLatency / stats.runs / cyclesPerUs),
+				(unsigned long) (stats.maxLatency / cyclesPerUs), (unsigned long) (stats.maxRunTime / cyclesPerUs));
+	}
+
+	return length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Creates the semaphore and the task of a worker
+ * @param  worker : Worker
+ * @retval None
+ */
+static void CreateDeferredWorker(const DeferredWorker_TypeDef worker) {
+	workerSems[worker] = xSemaphoreCreateBinary();
+	if (workerSems[worker] == NULL) {
+		ErrorHandler();
+		return;
+	}
+	TRACE_OBJECT_NAME(workerSems[worker], workerConfigs[worker].name);
+
+	/* Deferred work worker task creation
+	 * Task function pointer: DeferredWorkTask
+	 * Task name: see workerConfigs
+	 * Stack depth: see workerConfigs
+	 * Parameter: The worker, see DeferredWorker_TypeDef
+	 * Priority: see workerConfigs (0 to configMAX_PRIORITIES-1 possible)
+	 * Handle: workerTaskHandles[worker]
+	 * */
+	if (pdPASS != xTaskCreate((pdTASK_CODE )DeferredWorkTask, (signed portCHAR*)workerConfigs[worker].name,
+			workerConfigs[worker].stackDepth, (void*) worker, workerConfigs[worker].priority,
+			&workerTaskHandles[worker])) {
+		ErrorHandler();
+	}
+}
+
+/*
+ * @brief  Sets a work item pending and counts the post. To be called with the interrupts masked.
+ * @param  item : Work item
+ * @retval true if the item was not pending, so the worker is to be signalled, else false
+ */
+static bool SetWorkPending(DeferredWorkItem_TypeDef* item) {
+	uint32_t itemBit = 1UL << (item - workItems);
+
+	item->stats.posts++;
+
+	if (workerPending[item->worker] & itemBit) {
+		item->stats.coalesced++;
+		return false;
+	}
+
+	item->postTimestamp = GetTimestamp();
+	workerPending[item->worker] |= itemBit;
+
+	return true;
+}
+
+/**
+ * @brief  Task code of a worker, runs the handlers of the pending items of the worker
+ * @param  argument : The worker, see DeferredWorker_TypeDef
+ * @retval None
+ */
+static void DeferredWorkTask(void const *argument) {
+	DeferredWorker_TypeDef worker = (DeferredWorker_TypeDef) (uint32_t) argument;
+	DeferredWorkItem_TypeDef* item;
+	uint32_t postTimestamps[DEFERRED_WORK_MAX_ITEMS];
+	uint32_t pending;
+	uint32_t startTimestamp;
+	uint32_t latency;
+	uint32_t runTime;
+	uint8_t i;
+
+	for (;;) {
+		/* A give for posts that were taken with an earlier set leaves an empty set, which is skipped */
+		if (pdPASS != xSemaphoreTake(workerSems[worker], portMAX_DELAY)) {
+			continue;
+		}
+
+		/* The stamps are copied with the set, an item posted again meanwhile is stamped again for its next run */
+		taskENTER_CRITICAL();
+		pending = workerPending[worker];
+		workerPending[worker] = 0;
+		for (i = 0; i < workItemCount; i++) {
+			postTimestamps[i] = workItems[i].postTimestamp;
+		}
+		taskEXIT_CRITICAL();
+
+		for (i = 0; pending != 0; i++, pending >>= 1) {
+			if (!(pending & 1)) {
+				continue;
+			}
+
+			item = &workItems[i];
+			startTimestamp = GetTimestamp();
+			item->handler(item->argument);
+			runTime = GetTimestamp() - startTimestamp;
+
+			taskENTER_CRITICAL();
+			latency = startTimestamp - postTimestamps[i];
+			if (latency > item->stats.maxLatency) {
+				item->stats.maxLatency = latency;
+			}
+			item->stats.sumLatency += latency;
+			if (runTime > item->stats.maxRunTime) {
+				item->stats.maxRunTime = runTime;
+			}
+			item->stats.runs++;
+			taskEXIT_CRITICAL();
+		}
+	}
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,298 @@
+/******************************************************************************
+ * @file    ellipsoid_calibration.c
+ * @author  Dragonfly
+ * @brief   Least squares ellipsoid fit for the hard- and soft-iron calibration
+ *          of the magnetometer. The samples are reduced to the sums of their
+ *          ellipsoid terms as they arrive, the fit then solves the 9x9 normal
+ *          equations and turns the ellipsoid into an offset and a symmetric
+ *          correction matrix which maps it onto the unit sphere.
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "ellipsoid_calibration.h"
+
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+#define EIGEN_JACOBI_MAX_SWEEPS     10
+#define EIGEN_JACOBI_EPSILON        1e-9f   // Off-diagonal elements below this are taken as zero
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+
+/* Normal equation matrix, factored in place, only the acc/mag calibration work item fits ellipsoids. Declared as
+ * static so that the stack of the low deferred worker is not loaded with it. */
+static float32_t normalMatrixData[ELLIPSOID_TERMS_N * ELLIPSOID_TERMS_N];
+
+/* Private function prototypes -----------------------------------------------*/
+static FcbRetValType SolveCholesky(float32_t* a, float32_t* b, const uint32_t n);
+static void SymmetricEigen3(float32_t a[3][3], float32_t v[3][3]);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Clears the statistics, to start a new set of samples
+ * @param  observations : Statistics to clear
+ * @retval None
+ */
+void EllipsoidClearObservations(EllipsoidObservations_TypeDef* observations) {
+	memset(observations, 0, sizeof(EllipsoidObservations_TypeDef));
+}
+
+/*
+ * @brief  Adds a sample to the statistics
+ * @param  observations : Statistics to add the sample to
+ * @param  sample : x, y and z of the sample
+ * @retval None
+ */
+void EllipsoidAddSample(EllipsoidObservations_TypeDef* observations, const float32_t sample[3]) {
+	float32_t t[ELLIPSOID_TERMS_N];
+	uint32_t i, j, idx = 0;
+
+	t[0] = sample[0] * sample[0];
+	t[1] = sample[1] * sample[1];
+	t[2] = sample[2] * sample[2];
+	t[3] = 2.0f * sample[0] * sample[1];
+	t[4] = 2.0f * sample[0] * sample[2];
+	t[5] = 2.0f * sample[1] * sample[2];
+	t[6] = 2.0f * sample[0];
+	t[7] = 2.0f * sample[1];
+	t[8] = 2.0f * sample[2];
+
+	for (i = 0; i < ELLIPSOID_TERMS_N; i++) {
+		observations->tSum[i] += t[i];
+		for (j = i; j < ELLIPSOID_TERMS_N; j++) {
+			observations->ttSum[idx++] += t[i] * t[j];
+		}
+	}
+
+	observations->N++;
+}
+
+/*
+ * @brief  Fits an ellipsoid to the samples and gives the offset (its center) and the symmetric correction matrix W
+ *         with which W * (sample - offset) lies on the unit sphere. W corrects both the per axis scaling and the
+ *         cross-axis coupling of soft iron. Takes some thousands of floating point operations, so it is run by the
+ *         acc/mag calibration work item on the low deferred worker.
+ * @param  observations : Statistics of the samples
+ * @param  calibParams : Destination of the calibration, see FcbMagCalibrationParmIndex, unchanged upon error
+ * @retval FCB_OK if fitted, FCB_ERR if there are too few samples or they do not span an ellipsoid
+ */
+FcbRetValType EllipsoidCalibrate(const EllipsoidObservations_TypeDef* observations,
+		float32_t calibParams[MAG_CALIB_IDX_MAX]) {
+	arm_matrix_instance_f32 quadricMatrix, quadricMatrixInv, linearVector, centerVector, quadricCenterVector;
+	float32_t coeffs[ELLIPSOID_TERMS_N], termScales[ELLIPSOID_TERMS_N];
+	float32_t quadric[3][3], quadricCopy[3][3], quadricInv[3][3];
+	float32_t linear[3], center[3], quadricCenter[3];
+	float32_t eigenVectors[3][3], eigenRoots[3], correction[3][3];
+	float32_t scale;
+	uint32_t i, j, k, idx = 0;
+
+	if (observations->N < ELLIPSOID_MIN_SAMPLES) {
+		return FCB_ERR;
+	}
+
+	/* Least squares: (sum of t * t') * coeffs = sum of t. The terms differ in magnitude, the equations are solved for
+	 * coeffs scaled by the square roots of the diagonal, which keeps the single precision factorization accurate. */
+	for (i = 0; i < ELLIPSOID_TERMS_N; i++) {
+		float32_t diagonal = observations->ttSum[i * ELLIPSOID_TERMS_N - i * (i - 1) / 2];
+
+		if (!(diagonal > 0.0f)) {
+			return FCB_ERR;
+		}
+		arm_sqrt_f32(diagonal, &termScales[i]);
+		termScales[i] = 1.0f / termScales[i];
+	}
+
+	for (i = 0; i < ELLIPSOID_TERMS_N; i++) {
+		for (j = i; j < ELLIPSOID_TERMS_N; j++) {
+			normalMatrixData[i * ELLIPSOID_TERMS_N + j] = observations->ttSum[idx] * termScales[i] * termScales[j];
+			normalMatrixData[j * ELLIPSOID_TERMS_N + i] = normalMatrixData[i * ELLIPSOID_TERMS_N + j];
+			idx++;
+		}
+		coeffs[i] = observations->tSum[i] * termScales[i];
+	}
+
+	/* The scaled normal matrix is symmetric positive definite for samples that span an ellipsoid */
+	if (FCB_OK != SolveCholesky(normalMatrixData, coeffs, ELLIPSOID_TERMS_N)) {
+		return FCB_ERR;
+	}
+	arm_mult_f32(coeffs, termScales, coeffs, ELLIPSOID_TERMS_N);
+
+	/* The ellipsoid is x' * Q * x + 2 * l' * x = 1 */
+	quadric[0][0] = coeffs[0];
+	quadric[1][1] = coeffs[1];
+	quadric[2][2] = coeffs[2];
+	quadric[0][1] = quadric[1][0] = coeffs[3];
+	quadric[0][2] = quadric[2][0] = coeffs[4];
+	quadric[1][2] = quadric[2][1] = coeffs[5];
+	linear[0] = coeffs[6];
+	linear[1] = coeffs[7];
+	linear[2] = coeffs[8];
+
+	/* Its center is c = -inv(Q) * l, around which it is (x - c)' * Q * (x - c) = 1 + c' * Q * c */
+	memcpy(quadricCopy, quadric, sizeof(quadricCopy));
+	arm_mat_init_f32(&quadricMatrix, 3, 3, &quadricCopy[0][0]);
+	arm_mat_init_f32(&quadricMatrixInv, 3, 3, &quadricInv[0][0]);
+	arm_mat_init_f32(&linearVector, 3, 1, linear);
+	arm_mat_init_f32(&centerVector, 3, 1, center);
+
+	if (ARM_MATH_SUCCESS != arm_mat_inverse_f32(&quadricMatrix, &quadricMatrixInv)
+			|| ARM_MATH_SUCCESS != arm_mat_mult_f32(&quadricMatrixInv, &linearVector, &centerVector)) {
+		return FCB_ERR;
+	}
+	arm_scale_f32(center, -1.0f, center, 3);
+
+	arm_mat_init_f32(&quadricMatrix, 3, 3, &quadric[0][0]);
+	arm_mat_init_f32(&quadricCenterVector, 3, 1, quadricCenter);
+	arm_mat_mult_f32(&quadricMatrix, &centerVector, &quadricCenterVector);
+	arm_dot_prod_f32(center, quadricCenter, 3, &scale);
+	scale += 1.0f;
+
+	if (!(scale > 0.0f)) {
+		return FCB_ERR;
+	}
+
+	/* Normalized to (x - c)' * M * (x - c) = 1, with M = W * W for the symmetric W = V * sqrt(D) * V' */
+	arm_scale_f32(&quadric[0][0], 1.0f / scale, &quadric[0][0], 9);
+	SymmetricEigen3(quadric, eigenVectors);
+
+	for (i = 0; i < 3; i++) {
+		if (!(quadric[i][i] > 0.0f)) {
+			return FCB_ERR; // Not an ellipsoid
+		}
+		arm_sqrt_f32(quadric[i][i], &eigenRoots[i]);
+	}
+
+	for (i = 0; i < 3; i++) {
+		for (j = i; j < 3; j++) {
+			float32_t w = 0.0f;
+
+			for (k = 0; k < 3; k++) {
+				w += eigenVectors[i][k] * eigenRoots[k] * eigenVectors[j][k];
+			}
+			correction[i][j] = correction[j][i] = w;
+		}
+	}
+
+	calibParams[MAG_X_OFFSET_CALIB_IDX] = center[0];
+	calibParams[MAG_Y_OFFSET_CALIB_IDX] = center[1];
+	calibParams[MAG_Z_OFFSET_CALIB_IDX] = center[2];
+	calibParams[MAG_XX_CORRECTION_CALIB_IDX] = correction[0][0];
+	calibParams[MAG_YY_CORRECTION_CALIB_IDX] = correction[1][1];
+	calibParams[MAG_ZZ_CORRECTION_CALIB_IDX] = correction[2][2];
+	calibParams[MAG_XY_CORRECTION_CALIB_IDX] = correction[0][1];
+	calibParams[MAG_XZ_CORRECTION_CALIB_IDX] = correction[0][2];
+	calibParams[MAG_YZ_CORRECTION_CALIB_IDX] = correction[1][2];
+
+	return FCB_OK;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Solves a * x = b in place by the Cholesky factorization a = L * L', with no inverse to store
+ * @param  a : Symmetric positive definite n x n matrix, row-major, its lower triangle is replaced by L
+ * @param  b : Right-hand side, replaced by the solution x
+ * @param  n : Order of a
+ * @retval FCB_OK if solved, FCB_ERR if a is not positive definite
+ */
+static FcbRetValType SolveCholesky(float32_t* a, float32_t* b, const uint32_t n) {
+	float32_t sum;
+	uint32_t i, j, k;
+
+	for (j = 0; j < n; j++) {
+		sum = a[j * n + j];
+		for (k = 0; k < j; k++) {
+			sum -= a[j * n + k] * a[j * n + k];
+		}
+		if (!(sum > 0.0f)) {
+			return FCB_ERR;
+		}
+		arm_sqrt_f32(sum, &a[j * n + j]);
+
+		for (i = j + 1; i < n; i++) {
+			sum = a[i * n + j];
+			for (k = 0; k < j; k++) {
+				sum -= a[i * n + k] * a[j * n + k];
+			}
+			a[i * n + j] = sum / a[j * n + j];
+		}
+	}
+
+	/* Forward substitution L * y = b, then back substitution L' * x = y */
+	for (i = 0; i < n; i++) {
+		sum = b[i];
+		for (k = 0; k < i; k++) {
+			sum -= a[i * n + k] * b[k];
+		}
+		b[i] = sum / a[i * n + i];
+	}
+	for (i = n; i-- > 0;) {
+		sum = b[i];
+		for (k = i + 1; k < n; k++) {
+			sum -= a[k * n + i] * b[k];
+		}
+		b[i] = sum / a[i * n + i];
+	}
+
+	return FCB_OK;
+}
+
+/*
+ * @brief  Diagonalizes a symmetric 3x3 matrix by cyclic Jacobi rotations, a = v * d * v'
+ * @param  a : Symmetric matrix, replaced by the diagonal matrix d of its eigenvalues
+ * @param  v : Destination of the eigenvectors, as columns
+ * @retval None
+ */
+static void SymmetricEigen3(float32_t a[3][3], float32_t v[3][3]) {
+	uint32_t sweep, p, q, k;
+	float32_t theta, t, c, s, root;
+
+	memset(v, 0, 9 * sizeof(float32_t));
+	v[0][0] = v[1][1] = v[2][2] = 1.0f;
+
+	for (sweep = 0; sweep < EIGEN_JACOBI_MAX_SWEEPS; sweep++) {
+		if (fabsf(a[0][1]) + fabsf(a[0][2]) + fabsf(a[1][2]) < EIGEN_JACOBI_EPSILON) {
+			return;
+		}
+
+		for (p = 0; p < 2; p++) {
+			for (q = p + 1; q < 3; q++) {
+				if (fabsf(a[p][q]) < EIGEN_JACOBI_EPSILON) {
+					continue;
+				}
+
+				/* Rotation angle that zeroes a[p][q] */
+				theta = (a[q][q] - a[p][p]) / (2.0f * a[p][q]);
+				arm_sqrt_f32(theta * theta + 1.0f, &root);
+				t = (theta >= 0.0f ? 1.0f : -1.0f) / (fabsf(theta) + root);
+				arm_sqrt_f32(t * t + 1.0f, &root);
+				c = 1.0f / root;
+				s = t * c;
+
+				for (k = 0; k < 3; k++) {
+					float32_t akp = a[k][p];
+					float32_t akq = a[k][q];
+					a[k][p] = c * akp - s * akq;
+					a[k][q] = s * akp + c * akq;
+				}
+				for (k = 0; k < 3; k++) {
+					float32_t apk = a[p][k];
+					float32_t aqk = a[q][k];
+					a[p][k] = c * apk - s * aqk;
+					a[q][k] = s * apk + c * aqk;
+				}
+				for (k = 0; k < 3; k++) {
+					float32_t vkp = v[k][p];
+					float32_t vkq = v[k][q];
+					v[k][p] = c * vkp - s * vkq;
+					v[k][q] = s * vkp + c * vkq;
+				}
+			}
+		}
+	}
+}
+
+/*****END OF FILE****/
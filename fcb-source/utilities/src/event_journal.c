@@ -0,0 +1,661 @@
+/******************************************************************************
+ * @file    event_journal.c
+ * @author  Dragonfly
+ * @brief   Event journal and flight odometer, see event_journal.h. A page of
+ *          the journal area is a header slot and record slots of
+ *          EVENT_JOURNAL_RECORD_SIZE bytes. The header holds a magic, the
+ *          sequence number of the page and its complement. A record is the
+ *          boot count, type and arg word, the tick, the value and a check
+ *          word over the other three. The records of a page are appended
+ *          without gaps, so the first erased slot is the next one to write.
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "event_journal.h"
+
+#include "flash.h"
+#include "flight_mode.h"
+#include "flight_control.h"
+#include "crash_detection.h"
+#include "motor_failure.h"
+#include "fcb_sensors.h"
+#include "fcb_sensor_watchdog.h"
+#include "fcb_sensor_self_test.h"
+#include "fcb_accelerometer_magnetometer.h"
+#include "rate_groups.h"
+#include "deferred_log.h"
+#include "fcb_error.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+#define EVENT_JOURNAL_PAGE_MAGIC        0x4C4E4A45  // "EJNL"
+#define EVENT_JOURNAL_RECORD_MAGIC      0x5645524A  // "JREV", taken into the check word
+
+#define EVENT_JOURNAL_SLOTS_PER_PAGE    (FLASH_PAGE_SIZE / EVENT_JOURNAL_RECORD_SIZE)   // The header is slot 0
+#define EVENT_JOURNAL_ERASED_WORD       0xFFFFFFFF
+
+/* Private macro -------------------------------------------------------------*/
+#define JOURNAL_SLOT_OFFSET(PAGE, SLOT) \
+	((uint32_t) (PAGE) * FLASH_PAGE_SIZE + (uint32_t) (SLOT) * EVENT_JOURNAL_RECORD_SIZE)
+#define JOURNAL_WORD(OFFSET)            (*(const volatile uint32_t*) (FLASH_JOURNAL_START_ADDR + (OFFSET)))
+
+/* Private variables ---------------------------------------------------------*/
+static const char* const eventJournalTypeNames[EVENT_JOURNAL_TYPE_NBR] = {
+	"boot",
+	"arm",
+	"disarm",
+	"failsafe",
+	"sensor fault",
+	"watchdog reset",
+	"calibration",
+	"crash",
+	"motor failure",
+	"cleared"
+};
+
+/* Queue of the records to program, written by any task and read by the journal job */
+static EventJournalRecordType recordQueue[EVENT_JOURNAL_QUEUE_LENGTH];
+static uint16_t queueHead = 0;
+static uint16_t queueCount = 0;
+static uint32_t droppedRecords = 0;
+
+/* Written by the journal job, and at startup */
+static uint8_t activePage = 0;
+static uint32_t activeSequence = 0;     // 0 if no page is valid
+static uint16_t writeSlot = 1;          // Next slot of the active page
+static uint16_t pageRecords[FLASH_JOURNAL_NBR_OF_PAGES]; // Used slots, the records and interrupted ones
+static uint32_t writeErrors = 0;
+static volatile bool isClearRequested = false;
+static bool isOpenFailed = false;       // Logged once
+
+static uint16_t bootCount = 0;
+static bool isInitialized = false;
+
+/* Odometer, kept by the journal job */
+static EventJournalOdometerType odometer;
+static FlightModeStateType lastState = FLIGHT_MODE_DISARMED;
+static uint32_t lastStepTick = 0;       // [ms]
+static uint32_t armTick = 0;            // [ms]
+static uint32_t armedRemainder = 0;     // [ms] below a second of the armed time
+static uint32_t flightRemainder = 0;    // [ms] below a second of the flight time
+static float32_t armMaxAcceleration = 0.0f; // [g] of the latest arm cycle
+
+/* Latest conditions seen by the journal job, an event is recorded when they are entered */
+static bool wasSensorFault[MAG_IDX + 1];
+static bool wasCrash = false;
+static bool wasMotorFailure = false;
+
+static RateGroupJobId_TypeDef eventJournalJobId = RATE_GROUP_INVALID_ID;
+
+/* Private function prototypes -----------------------------------------------*/
+static void EventJournalStep(void* argument);
+static void UpdateOdometer(const uint32_t now);
+static void WatchFaults(void);
+static void ProgramQueuedRecords(void);
+static void EraseJournal(void);
+static bool OpenPage(const uint8_t page, const uint32_t sequence);
+static bool IsPageValid(const uint8_t page, uint32_t* dstSequence);
+static bool IsSlotErased(const uint8_t page, const uint16_t slot);
+static bool ReadSlot(const uint8_t page, const uint16_t slot, EventJournalRecordType* dstRecord);
+static uint32_t GetRecordWord0(const EventJournalRecordType* record);
+static uint32_t GetTickMs(void);
+static void LockQueue(void);
+static void UnlockQueue(void);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Finds the active page and the boot count, records the startup, loads the odometer and registers the
+ *         journal job with its rate group
+ * @param  None
+ * @retval None
+ */
+void InitEventJournal(void) {
+	EventJournalRecordType record;
+	uint16_t newestBootCount = 0;
+	uint32_t sequence;
+	uint16_t slot;
+	uint8_t page;
+
+	activeSequence = 0;
+
+	for (page = 0; page < FLASH_JOURNAL_NBR_OF_PAGES; page++) {
+		pageRecords[page] = 0;
+		if (!IsPageValid(page, &sequence)) {
+			continue;
+		}
+
+		if (sequence > activeSequence) {
+			activeSequence = sequence;
+			activePage = page;
+		}
+
+		for (slot = 1; slot < EVENT_JOURNAL_SLOTS_PER_PAGE && !IsSlotErased(page, slot); slot++) {
+			pageRecords[page] = slot;
+			if (ReadSlot(page, slot, &record) && record.bootCount > newestBootCount) {
+				newestBootCount = record.bootCount;
+			}
+		}
+	}
+
+	/* A journal without valid pages, e.g. a new board, is formatted by the job in idle mode */
+	writeSlot = (0 != activeSequence) ? pageRecords[activePage] + 1 : EVENT_JOURNAL_SLOTS_PER_PAGE;
+	bootCount = (UINT16_MAX == newestBootCount) ? 1 : newestBootCount + 1;
+	isInitialized = true;
+
+	/* The reset flags are still set, they are cleared later in the startup */
+	EventJournalRecord(EVENT_JOURNAL_BOOT, 0, RCC->CSR);
+
+	if (FLASH_OK != ReadOdometerFromFlash(&odometer)) {
+		memset(&odometer, 0, sizeof(odometer));
+	}
+
+	if (FCB_OK != RateGroupRegister("JOURNAL", EventJournalStep, NULL, RATE_GROUP_20HZ, EVENT_JOURNAL_PHASE,
+			&eventJournalJobId)) {
+		ErrorHandler();
+	}
+}
+
+/*
+ * @brief  Queues an event to be programmed by the journal job
+ * @param  type : Event type
+ * @param  arg : Argument of the type
+ * @param  value : Value of the type
+ * @retval None
+ */
+void EventJournalRecord(const EventJournalType type, const uint8_t arg, const uint32_t value) {
+	EventJournalRecordType* record;
+
+	/* Settings rewritten while the store is initialized are no news */
+	if (!isInitialized || type >= EVENT_JOURNAL_TYPE_NBR) {
+		return;
+	}
+
+	LockQueue();
+	if (queueCount < EVENT_JOURNAL_QUEUE_LENGTH) {
+		record = &recordQueue[(queueHead + queueCount) % EVENT_JOURNAL_QUEUE_LENGTH];
+		record->bootCount = bootCount;
+		record->type = (uint8_t) type;
+		record->arg = arg;
+		record->tick = GetTickMs();
+		record->value = value;
+		queueCount++;
+	} else {
+		droppedRecords++;
+	}
+	UnlockQueue();
+}
+
+/*
+ * @brief  Requests the journal to be erased by the journal job
+ * @param  None
+ * @retval FCB_OK if requested, FCB_ERR if not in idle mode
+ */
+FcbRetValType ClearEventJournal(void) {
+	if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+		return FCB_ERR;
+	}
+
+	isClearRequested = true;
+	return FCB_OK;
+}
+
+/*
+ * @brief  Reads a record from flash, the oldest first
+ * @param  idx : Index of the record from the oldest
+ * @param  dstRecord : Destination record
+ * @retval true if read, false if there is no valid record at the index
+ */
+bool GetEventJournalRecord(const uint16_t idx, EventJournalRecordType* dstRecord) {
+	uint16_t remaining = idx;
+	uint8_t i, page;
+
+	if (0 == activeSequence) {
+		return false;
+	}
+
+	/* The page after the active one is the oldest */
+	for (i = 1; i <= FLASH_JOURNAL_NBR_OF_PAGES; i++) {
+		page = (activePage + i) % FLASH_JOURNAL_NBR_OF_PAGES;
+		if (remaining < pageRecords[page]) {
+			return ReadSlot(page, remaining + 1, dstRecord);
+		}
+		remaining -= pageRecords[page];
+	}
+
+	return false;
+}
+
+/*
+ * @brief  Gets the journal status
+ * @param  dstStatus : Destination status
+ * @retval None
+ */
+void GetEventJournalStatus(EventJournalStatusType* dstStatus) {
+	uint8_t page;
+
+	LockQueue();
+	dstStatus->bootCount = bootCount;
+	dstStatus->pendingRecords = queueCount;
+	dstStatus->droppedRecords = droppedRecords;
+	dstStatus->sequence = activeSequence;
+	dstStatus->writeErrors = writeErrors;
+	dstStatus->records = 0;
+	for (page = 0; page < FLASH_JOURNAL_NBR_OF_PAGES; page++) {
+		dstStatus->records += pageRecords[page];
+	}
+	UnlockQueue();
+}
+
+/*
+ * @brief  Gets the odometer, with the time of an ongoing flight
+ * @param  dstOdometer : Destination odometer
+ * @retval None
+ */
+void GetOdometer(EventJournalOdometerType* dstOdometer) {
+	LockQueue();
+	*dstOdometer = odometer;
+	UnlockQueue();
+}
+
+/*
+ * @brief  Gets the name of an event type
+ * @param  type : Event type
+ * @retval Name, "unknown" if out of range
+ */
+const char* GetEventJournalTypeName(const EventJournalType type) {
+	if (type >= EVENT_JOURNAL_TYPE_NBR) {
+		return "unknown";
+	}
+
+	return eventJournalTypeNames[type];
+}
+
+/*
+ * @brief  Prints the odometer and the journal status
+ * @param  dst : Destination string
+ * @param  dstSize : Size of dst, at least EVENT_JOURNAL_MAX_STRING_SIZE for all of it
+ * @retval Length of the string, excluding the null termination
+ */
+size_t PrintEventJournalStatus(char* dst, const size_t dstSize) {
+	EventJournalStatusType status;
+	EventJournalOdometerType odo;
+	size_t length;
+
+	GetEventJournalStatus(&status);
+	GetOdometer(&odo);
+
+	length = (size_t) snprintf(dst, dstSize,
+			"\nOdometer: flight %lu:%02lu:%02lu, armed %lu:%02lu:%02lu, %lu arm cycles, max %.1f g\n",
+			odo.flightTime / 3600, (odo.flightTime / 60) % 60, odo.flightTime % 60,
+			odo.armedTime / 3600, (odo.armedTime / 60) % 60, odo.armedTime % 60, odo.armCycles,
+			(double) odo.maxAcceleration);
+	if (length < dstSize) {
+		length += (size_t) snprintf(dst + length, dstSize - length,
+				"Event journal: boot %u, %u records, %u pending, %lu dropped, %lu write errors, page sequence %lu\n",
+				status.bootCount, status.records, status.pendingRecords, status.droppedRecords, status.writeErrors,
+				status.sequence);
+	}
+
+	return (length < dstSize) ? length : dstSize - 1;
+}
+
+/*
+ * @brief  Prints a record on a line
+ * @param  dst : Destination string
+ * @param  dstSize : Size of dst, at least EVENT_JOURNAL_RECORD_STRING_SIZE for all of it
+ * @param  record : Record
+ * @retval Length of the string, excluding the null termination
+ */
+size_t PrintEventJournalRecord(char* dst, const size_t dstSize, const EventJournalRecordType* record) {
+	int length;
+
+	length = snprintf(dst, dstSize, "%5u %10lu ms  %-14s %3u %10lu (0x%08lx)\n", record->bootCount, record->tick,
+			GetEventJournalTypeName((EventJournalType) record->type), record->arg, record->value, record->value);
+
+	if (length < 0) {
+		return 0;
+	}
+
+	return ((size_t) length < dstSize) ? (size_t) length : dstSize - 1;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Job of the 20 Hz rate group: keeps the odometer, records the faults, erases pages in idle mode and
+ *         programs the queued records
+ * @param  argument : Not used
+ * @retval None
+ */
+static void EventJournalStep(void* argument) {
+	uint32_t const now = GetTickMs();
+	bool isIdle;
+
+	(void) argument;
+
+	UpdateOdometer(now);
+	WatchFaults();
+
+	isIdle = (FLIGHT_CONTROL_IDLE == GetFlightControlMode());
+	if (isIdle && isClearRequested) {
+		EraseJournal();
+		isClearRequested = false;
+	} else if (isIdle && EVENT_JOURNAL_SLOTS_PER_PAGE - writeSlot < EVENT_JOURNAL_RESERVE_RECORDS) {
+		/* The oldest page is erased ahead, so that a flight finds the active page with room */
+		if (!OpenPage((0 != activeSequence) ? (activePage + 1) % FLASH_JOURNAL_NBR_OF_PAGES : 0,
+				activeSequence + 1) && !isOpenFailed) {
+			LOG0("ERROR: event journal page not erased");
+			isOpenFailed = true;
+		}
+	}
+
+	ProgramQueuedRecords();
+}
+
+/*
+ * @brief  Adds the time since the previous step to the odometer while armed and records arming and disarming. The
+ *         odometer is saved on disarming.
+ * @param  now : Tick [ms]
+ * @retval None
+ */
+static void UpdateOdometer(const uint32_t now) {
+	FlightModeStateType const state = GetFlightModeState();
+	uint32_t const elapsed = now - lastStepTick;
+	float32_t acc[3], accNorm;
+
+	lastStepTick = now;
+
+	if (FLIGHT_MODE_DISARMED != state) {
+		if (FLIGHT_MODE_DISARMED == lastState) {
+			armTick = now;
+			armMaxAcceleration = 0.0f;
+			LockQueue();
+			odometer.armCycles++;
+			UnlockQueue();
+			EventJournalRecord(EVENT_JOURNAL_ARM, 0, odometer.armCycles);
+		}
+
+		GetAcceleration(&acc[0], &acc[1], &acc[2]);
+		accNorm = sqrtf(acc[0]*acc[0] + acc[1]*acc[1] + acc[2]*acc[2]) / G_ACC;
+		armMaxAcceleration = fmaxf(armMaxAcceleration, accNorm);
+
+		LockQueue();
+		armedRemainder += elapsed;
+		odometer.armedTime += armedRemainder / 1000;
+		armedRemainder %= 1000;
+		if (FLIGHT_CONTROL_IDLE != GetFlightModeControlMode(state)) {
+			flightRemainder += elapsed;
+			odometer.flightTime += flightRemainder / 1000;
+			flightRemainder %= 1000;
+		}
+		odometer.maxAcceleration = fmaxf(odometer.maxAcceleration, accNorm);
+		UnlockQueue();
+	} else if (FLIGHT_MODE_DISARMED != lastState) {
+		EventJournalRecord(EVENT_JOURNAL_DISARM, (uint8_t) fminf(10.0f*armMaxAcceleration + 0.5f, UINT8_MAX),
+				now - armTick);
+		if (FLASH_OK != WriteOdometerToFlash(&odometer)) {
+			LOG0("ERROR: odometer not saved");
+		}
+	}
+
+	lastState = state;
+}
+
+/*
+ * @brief  Records the sensor faults, crashes and motor failures as they are entered
+ * @param  None
+ * @retval None
+ */
+static void WatchFaults(void) {
+	MotorFailureStatusType motorFailure;
+	FcbSensorIndexType sensor;
+	bool isCondition;
+
+	for (sensor = GYRO_IDX; sensor <= MAG_IDX; sensor++) {
+		isCondition = !IsSensorHealthy(sensor) || SENSOR_SELF_TEST_FAILED == GetSensorSelfTestStatus(sensor);
+		if (isCondition && !wasSensorFault[sensor]) {
+			EventJournalRecord(EVENT_JOURNAL_SENSOR_FAULT, (uint8_t) sensor, GetSensorStalls(sensor));
+		}
+		wasSensorFault[sensor] = isCondition;
+	}
+
+	isCondition = IsCrashDetected();
+	if (isCondition && !wasCrash) {
+		EventJournalRecord(EVENT_JOURNAL_CRASH, 0, 0);
+	}
+	wasCrash = isCondition;
+
+	isCondition = IsMotorFailureDetected();
+	if (isCondition && !wasMotorFailure) {
+		GetMotorFailureStatus(&motorFailure);
+		EventJournalRecord(EVENT_JOURNAL_MOTOR_FAILURE, motorFailure.motor, (uint32_t) motorFailure.cause);
+	}
+	wasMotorFailure = isCondition;
+}
+
+/*
+ * @brief  Programs the queued records to the active page while it has room. A record is taken off the queue once it
+ *         is programmed, a full page keeps the rest queued until the next page is erased in idle mode.
+ * @param  None
+ * @retval None
+ */
+static void ProgramQueuedRecords(void) {
+	EventJournalRecordType record;
+	uint32_t words[EVENT_JOURNAL_RECORD_SIZE / FLASH_WORD_BYTE_SIZE];
+	uint32_t offset;
+	bool isProgrammed;
+	uint8_t i;
+
+	while (0 != activeSequence && writeSlot < EVENT_JOURNAL_SLOTS_PER_PAGE) {
+		LockQueue();
+		if (0 == queueCount) {
+			UnlockQueue();
+			break;
+		}
+		record = recordQueue[queueHead];
+		UnlockQueue();
+
+		words[0] = GetRecordWord0(&record);
+		words[1] = record.tick;
+		words[2] = record.value;
+		words[3] = words[0] ^ words[1] ^ words[2] ^ EVENT_JOURNAL_RECORD_MAGIC;
+
+		/* The check word last, an interrupted record is not valid */
+		offset = JOURNAL_SLOT_OFFSET(activePage, writeSlot);
+		isProgrammed = true;
+		for (i = 0; i < EVENT_JOURNAL_RECORD_SIZE / FLASH_WORD_BYTE_SIZE && isProgrammed; i++) {
+			isProgrammed = (FLASH_OK == ProgramFlashJournalWord(offset + i*FLASH_WORD_BYTE_SIZE, words[i]));
+		}
+
+		/* The slot is used either way, a failed record is retried in the next slot on the next step */
+		pageRecords[activePage] = writeSlot;
+		writeSlot++;
+
+		if (!isProgrammed) {
+			writeErrors++;
+			break;
+		}
+
+		LockQueue();
+		queueHead = (queueHead + 1) % EVENT_JOURNAL_QUEUE_LENGTH;
+		queueCount--;
+		UnlockQueue();
+	}
+}
+
+/*
+ * @brief  Erases all pages of the journal and records the clear on the first one, with the next sequence number so
+ *         that a page left from before the clear cannot be taken for a newer one
+ * @param  None
+ * @retval None
+ */
+static void EraseJournal(void) {
+	uint32_t const sequence = activeSequence + 1;
+	uint8_t page;
+
+	for (page = 0; page < FLASH_JOURNAL_NBR_OF_PAGES; page++) {
+		if (FLASH_OK != EraseFlashJournalPage(page)) {
+			writeErrors++;
+		}
+		pageRecords[page] = 0;
+	}
+
+	activeSequence = 0;
+	writeSlot = EVENT_JOURNAL_SLOTS_PER_PAGE;
+	if (!OpenPage(0, sequence)) {
+		LOG0("ERROR: event journal not cleared");
+		return;
+	}
+
+	EventJournalRecord(EVENT_JOURNAL_CLEARED, 0, droppedRecords);
+	LOG0("Event journal cleared");
+}
+
+/*
+ * @brief  Erases a page and makes it the active one
+ * @param  page : Page index in the journal area
+ * @param  sequence : Sequence number of the page, above the ones of the other pages
+ * @retval true if opened, false if it could not be erased or programmed
+ */
+static bool OpenPage(const uint8_t page, const uint32_t sequence) {
+	uint32_t const offset = JOURNAL_SLOT_OFFSET(page, 0);
+
+	pageRecords[page] = 0;
+
+	if (FLASH_OK != EraseFlashJournalPage(page)
+			|| FLASH_OK != ProgramFlashJournalWord(offset, EVENT_JOURNAL_PAGE_MAGIC)
+			|| FLASH_OK != ProgramFlashJournalWord(offset + FLASH_WORD_BYTE_SIZE, sequence)
+			|| FLASH_OK != ProgramFlashJournalWord(offset + 2*FLASH_WORD_BYTE_SIZE, ~sequence)) {
+		writeErrors++;
+		return false;
+	}
+
+	activePage = page;
+	activeSequence = sequence;
+	writeSlot = 1;
+
+	return true;
+}
+
+/*
+ * @brief  Checks the header of a page
+ * @param  page : Page index in the journal area
+ * @param  dstSequence : Destination sequence number of a valid page
+ * @retval true if valid, else false
+ */
+static bool IsPageValid(const uint8_t page, uint32_t* dstSequence) {
+	uint32_t const offset = JOURNAL_SLOT_OFFSET(page, 0);
+	uint32_t const sequence = JOURNAL_WORD(offset + FLASH_WORD_BYTE_SIZE);
+
+	if (EVENT_JOURNAL_PAGE_MAGIC != JOURNAL_WORD(offset) || 0 == sequence
+			|| ~sequence != JOURNAL_WORD(offset + 2*FLASH_WORD_BYTE_SIZE)) {
+		return false;
+	}
+
+	*dstSequence = sequence;
+	return true;
+}
+
+/*
+ * @brief  Checks if a slot is unused
+ * @param  page : Page index in the journal area
+ * @param  slot : Slot index in the page
+ * @retval true if all of its words are erased, else false
+ */
+static bool IsSlotErased(const uint8_t page, const uint16_t slot) {
+	uint32_t const offset = JOURNAL_SLOT_OFFSET(page, slot);
+	uint8_t i;
+
+	for (i = 0; i < EVENT_JOURNAL_RECORD_SIZE / FLASH_WORD_BYTE_SIZE; i++) {
+		if (EVENT_JOURNAL_ERASED_WORD != JOURNAL_WORD(offset + i*FLASH_WORD_BYTE_SIZE)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * @brief  Reads the record of a slot
+ * @param  page : Page index in the journal area
+ * @param  slot : Slot index in the page, from 1
+ * @param  dstRecord : Destination record
+ * @retval true if the record is valid, false if it was interrupted or the slot is erased
+ */
+static bool ReadSlot(const uint8_t page, const uint16_t slot, EventJournalRecordType* dstRecord) {
+	uint32_t const offset = JOURNAL_SLOT_OFFSET(page, slot);
+	uint32_t const word0 = JOURNAL_WORD(offset);
+	uint32_t const tick = JOURNAL_WORD(offset + FLASH_WORD_BYTE_SIZE);
+	uint32_t const value = JOURNAL_WORD(offset + 2*FLASH_WORD_BYTE_SIZE);
+
+	if ((word0 ^ tick ^ value ^ EVENT_JOURNAL_RECORD_MAGIC) != JOURNAL_WORD(offset + 3*FLASH_WORD_BYTE_SIZE)) {
+		return false;
+	}
+
+	dstRecord->bootCount = (uint16_t) word0;
+	dstRecord->type = (uint8_t) (word0 >> 16);
+	dstRecord->arg = (uint8_t) (word0 >> 24);
+	dstRecord->tick = tick;
+	dstRecord->value = value;
+
+	return true;
+}
+
+/*
+ * @brief  Packs the boot count, type and arg of a record into its first word
+ * @param  record : Record
+ * @retval Word
+ */
+static uint32_t GetRecordWord0(const EventJournalRecordType* record) {
+	return (uint32_t) record->bootCount | ((uint32_t) record->type << 16) | ((uint32_t) record->arg << 24);
+}
+
+/*
+ * @brief  Gets the tick since the startup, 0 before the scheduler is started
+ * @param  None
+ * @retval Tick [ms]
+ */
+static uint32_t GetTickMs(void) {
+	return (uint32_t) (xTaskGetTickCount() * portTICK_RATE_MS);
+}
+
+/*
+ * @brief  Keeps the other tasks from the queue and the odometer, by suspending the scheduler. Events are also recorded
+ *         before the scheduler is started, when the scheduler calls would leave the interrupts masked, so it is then
+ *         left alone.
+ * @param  None
+ * @retval None
+ */
+static void LockQueue(void) {
+	if (taskSCHEDULER_NOT_STARTED != xTaskGetSchedulerState()) {
+		vTaskSuspendAll();
+	}
+}
+
+/*
+ * @brief  Ends LockQueue()
+ * @param  None
+ * @retval None
+ */
+static void UnlockQueue(void) {
+	if (taskSCHEDULER_NOT_STARTED != xTaskGetSchedulerState()) {
+		xTaskResumeAll();
+	}
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,390 @@
+/******************************************************************************
+ * @file    fast_math.c
+ * @author  Dragonfly
+ * @brief   Polynomial approximations of the math library functions used in
+ *          the attitude and altitude calculations. The newlib versions handle
+ *          errno and full double/subnormal accuracy and cost hundreds of
+ *          cycles each on the Cortex-M4F, these use a few multiply-adds and
+ *          the VSQRT instruction.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "fast_math.h"
+
+#ifndef FCB_HOST_BUILD
+#include "common.h"
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef union {
+	float32_t f;
+	uint32_t u;
+} FloatBits_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define HALF_PI             1.57079632679f
+#define LOG2_E              1.44269504089f
+#define LN_2                0.69314718056f
+#define SQRT_2              1.41421356237f
+
+#define BENCHMARK_SAMPLES   500
+
+/* Barometric formula h = BAROMETRIC_SCALE * (1 - (p/p0)^BAROMETRIC_EXPONENT) */
+#define BAROMETRIC_SCALE    44330.0f
+#define BAROMETRIC_EXPONENT (1.0f/5.255f)
+
+/* Pressure ratio range of the altitude table, about -800 to 5500 m */
+#define ALTITUDE_LUT_MIN_RATIO  0.5f
+#define ALTITUDE_LUT_MAX_RATIO  1.1f
+#define ALTITUDE_LUT_SEGMENTS   32
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+
+/*
+ * Cubic Hermite segments of the barometric formula, with the exact values and
+ * derivatives at the segment ends, evaluated in double precision offline. The
+ * altitude of segment i is c0 + t*(c1 + t*(c2 + t*c3)) [m], t in [0, 1) the
+ * position of the pressure ratio in the segment.
+ */
+static const float32_t altitudeSegments[ALTITUDE_LUT_SEGMENTS][4] = {
+	{ 5478.01243f, -277.250149f, 4.20683232f, -0.0904081481f },
+	{ 5204.8787f, -269.107709f, 3.93584843f, -0.0816745492f },
+	{ 4939.62517f, -261.481036f, 3.69102755f, -0.0740467604f },
+	{ 4681.76111f, -254.321121f, 3.46905919f, -0.0673537209f },
+	{ 4430.8417f, -247.585064f, 3.2671446f, -0.0614553343f },
+	{ 4186.46232f, -241.235141f, 3.08290419f, -0.0562360984f },
+	{ 3948.25385f, -235.23804f, 2.91430404f, -0.0516001929f },
+	{ 3715.87851f, -229.564233f, 2.759597f, -0.0474676608f },
+	{ 3489.02641f, -224.187442f, 2.61727526f, -0.0437714157f },
+	{ 3267.41247f, -219.084206f, 2.48603187f, -0.040454879f },
+	{ 3050.77384f, -214.233507f, 2.36472926f, -0.0374701015f },
+	{ 2838.86759f, -209.616458f, 2.25237345f, -0.0347762603f },
+	{ 2631.46873f, -205.21604f, 2.14809271f, -0.0323384486f },
+	{ 2428.36845f, -201.01687f, 2.05111986f, -0.0301266948f },
+	{ 2229.37257f, -197.005011f, 1.96077746f, -0.0281151647f },
+	{ 2034.30022f, -193.167801f, 1.8764655f, -0.0262815071f },
+	{ 1842.9826f, -189.493715f, 1.7976509f, -0.0246063163f },
+	{ 1655.26193f, -185.972232f, 1.72385871f, -0.023072687f },
+	{ 1470.99049f, -182.593732f, 1.65466465f, -0.021665845f },
+	{ 1290.02976f, -179.349401f, 1.58968869f, -0.0203728389f },
+	{ 1112.24967f, -176.231142f, 1.52858961f, -0.0191822822f },
+	{ 937.527936f, -173.231509f, 1.47106032f, -0.0180841359f },
+	{ 765.749403f, -170.343641f, 1.4168238f, -0.0170695256f },
+	{ 596.805516f, -167.561202f, 1.36562963f, -0.016130586f },
+	{ 430.593813f, -164.878335f, 1.31725096f, -0.0152603292f },
+	{ 267.017469f, -162.289614f, 1.27148188f, -0.0144525321f },
+	{ 105.984885f, -159.790008f, 1.22813515f, -0.01370164f },
+	{ -52.5906893f, -157.374842f, 1.18704015f, -0.0130026841f },
+	{ -208.791494f, -155.03977f, 1.14804118f, -0.0123512102f },
+	{ -362.695574f, -152.780741f, 1.11099587f, -0.0117432176f },
+	{ -514.377062f, -150.593979f, 1.07577386f, -0.0111751055f },
+	{ -663.906443f, -148.475957f, 1.04225557f, -0.0106436276f }
+};
+
+#ifndef FCB_HOST_BUILD
+/* Keeps the benchmark loops from being optimised away */
+static volatile float32_t benchmarkSink;
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+static float32_t AtanUnit(const float32_t z);
+#ifndef FCB_HOST_BUILD
+static void UpdateMaxError(float32_t* maxError, const double error);
+#endif
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Four quadrant arctangent
+ * @param  y : y coordinate
+ * @param  x : x coordinate
+ * @retval Angle in [-pi, pi] [rad], 0 if x and y are 0
+ */
+float32_t FastAtan2f(const float32_t y, const float32_t x) {
+	float32_t absX = fabsf(x), absY = fabsf(y);
+	float32_t angle;
+
+	if (absX == 0.0f && absY == 0.0f) {
+		return 0.0f;
+	}
+
+	/* Reduce to an argument in [0, 1] */
+	if (absY <= absX) {
+		angle = AtanUnit(absY / absX);
+	} else {
+		angle = HALF_PI - AtanUnit(absX / absY);
+	}
+
+	if (x < 0.0f) {
+		angle = PI - angle;
+	}
+	if (y < 0.0f) {
+		angle = -angle;
+	}
+
+	return angle;
+}
+
+/*
+ * @brief  Arcsine, see Abramowitz & Stegun 4.4.46
+ * @param  x : Value in [-1, 1], values outside are limited to the range
+ * @retval Angle in [-pi/2, pi/2] [rad]
+ */
+float32_t FastAsinf(const float32_t x) {
+	float32_t absX = fabsf(x);
+	float32_t angle;
+
+	if (absX > 1.0f) {
+		absX = 1.0f;
+	}
+
+	angle = HALF_PI - FastSqrtf(1.0f - absX)
+			* (1.5707963050f + absX * (-0.2145988016f + absX * (0.0889789874f + absX * (-0.0501743046f
+			+ absX * (0.0308918810f + absX * (-0.0170881256f + absX * (0.0066700901f + absX * -0.0012624911f)))))));
+
+	return (x < 0.0f) ? -angle : angle;
+}
+
+/*
+ * @brief  Arccosine
+ * @param  x : Value in [-1, 1], values outside are limited to the range
+ * @retval Angle in [0, pi] [rad]
+ */
+float32_t FastAcosf(const float32_t x) {
+	return HALF_PI - FastAsinf(x);
+}
+
+/*
+ * @brief  Square root with the FPU instruction, without the errno handling of sqrtf
+ * @param  x : Value >= 0
+ * @retval Square root of x
+ */
+float32_t FastSqrtf(const float32_t x) {
+#if (__FPU_USED == 1)
+	float32_t root;
+
+	__ASM volatile ("vsqrt.f32 %0, %1" : "=t" (root) : "t" (x));
+	return root;
+#else
+	return sqrtf(x);
+#endif
+}
+
+/*
+ * @brief  Reciprocal square root, e.g. to normalise vectors with multiplications instead of divisions
+ * @param  x : Value > 0
+ * @retval 1/sqrt(x)
+ */
+float32_t FastInvSqrtf(const float32_t x) {
+	return 1.0f / FastSqrtf(x);
+}
+
+/*
+ * @brief  Power function as exp2(y*log2(x)), accurate enough for the barometric formula
+ * @param  x : Base > 0, 0 is returned for x <= 0
+ * @param  y : Exponent
+ * @retval x^y
+ */
+float32_t FastPowf(const float32_t x, const float32_t y) {
+	FloatBits_TypeDef bits;
+	float32_t mantissa, t, t2, log2X, z, fraction, result;
+	int32_t exponent;
+
+	if (x <= 0.0f) {
+		return 0.0f;
+	}
+
+	/* x = mantissa * 2^exponent with mantissa in [sqrt(2)/2, sqrt(2)) */
+	bits.f = x;
+	exponent = (int32_t) ((bits.u >> 23) & 0xFF) - 127;
+	bits.u = (bits.u & 0x007FFFFF) | 0x3F800000;
+	mantissa = bits.f;
+	if (mantissa > SQRT_2) {
+		mantissa *= 0.5f;
+		exponent++;
+	}
+
+	/* ln(m) = 2*atanh((m-1)/(m+1)), series converges fast for |t| < 0.172 */
+	t = (mantissa - 1.0f) / (mantissa + 1.0f);
+	t2 = t * t;
+	log2X = (float32_t) exponent
+			+ 2.0f * LOG2_E * t * (1.0f + t2 * (1.0f/3.0f + t2 * (1.0f/5.0f + t2 * (1.0f/7.0f + t2 * (1.0f/9.0f)))));
+
+	/* 2^z = 2^n * e^(f*ln(2)) with n integer and f in [-0.5, 0.5] */
+	z = y * log2X;
+	if (z > 127.0f) {
+		z = 127.0f;
+	} else if (z < -126.0f) {
+		return 0.0f;
+	}
+	exponent = (int32_t) (z + ((z >= 0.0f) ? 0.5f : -0.5f));
+	fraction = (z - (float32_t) exponent) * LN_2;
+	result = 1.0f + fraction * (1.0f + fraction * (1.0f/2.0f + fraction * (1.0f/6.0f + fraction * (1.0f/24.0f
+			+ fraction * (1.0f/120.0f + fraction * (1.0f/720.0f))))));
+
+	bits.u = (uint32_t) (exponent + 127) << 23;
+
+	return result * bits.f;
+}
+
+/*
+ * @brief  Altitude by the international barometric formula, 44330*(1 - (p/p0)^(1/5.255)), from a table of cubic
+ *         segments for pressure ratios in [ALTITUDE_LUT_MIN_RATIO, ALTITUDE_LUT_MAX_RATIO], with FastPowf outside
+ * @param  pressureRatio : Pressure over the reference pressure, p/p0
+ * @retval Altitude above the reference pressure [m]
+ */
+float32_t FastBarometricAltitude(const float32_t pressureRatio) {
+	const float32_t* c;
+	float32_t x, t;
+	int32_t i;
+
+	if (!(pressureRatio >= ALTITUDE_LUT_MIN_RATIO && pressureRatio < ALTITUDE_LUT_MAX_RATIO)) {
+		return BAROMETRIC_SCALE * (1.0f - FastPowf(pressureRatio, BAROMETRIC_EXPONENT));
+	}
+
+	x = (pressureRatio - ALTITUDE_LUT_MIN_RATIO)
+			* ((float32_t) ALTITUDE_LUT_SEGMENTS / (ALTITUDE_LUT_MAX_RATIO - ALTITUDE_LUT_MIN_RATIO));
+	i = (int32_t) x;
+	if (i > ALTITUDE_LUT_SEGMENTS - 1) {
+		i = ALTITUDE_LUT_SEGMENTS - 1; /* rounding just below the max ratio */
+	}
+	t = x - (float32_t) i;
+	c = altitudeSegments[i];
+
+	return c[0] + t * (c[1] + t * (c[2] + t * c[3]));
+}
+
+#ifndef FCB_HOST_BUILD
+/*
+ * @brief  Measures max error against the double precision math library and cycles per call against the single
+ *         precision math library, and prints them as a table
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @retval Length of the table string
+ */
+size_t FastMathBenchmark(char* dst, const size_t dstSize) {
+	float32_t maxError[7] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	uint32_t fastCycles[7], libCycles[7], altitudePowCycles;
+	uint32_t start;
+	float32_t in, in2, in3;
+	double dIn, dIn2, error; /* The reference is double precision on purpose, explicit conversions only */
+	uint16_t i;
+
+	/* Accuracy */
+	for (i = 0; i < BENCHMARK_SAMPLES; i++) {
+		in = -1.0f + 2.0f * (float32_t) i / (BENCHMARK_SAMPLES - 1); /* [-1, 1] */
+		in2 = 0.01f + 100.0f * (float32_t) i / (BENCHMARK_SAMPLES - 1); /* (0, 100] */
+		in3 = ALTITUDE_LUT_MIN_RATIO + (ALTITUDE_LUT_MAX_RATIO - ALTITUDE_LUT_MIN_RATIO) * (float32_t) i
+				/ BENCHMARK_SAMPLES; /* [min, max) pressure ratio */
+
+		dIn = (double) in;
+		dIn2 = (double) in2;
+
+		error = fabs((double) FastAtan2f(in, 1.0f - 2.0f * in * in) - atan2(dIn, (double) (1.0f - 2.0f * in * in)));
+		UpdateMaxError(&maxError[0], error);
+		error = fabs((double) FastAsinf(in) - asin(dIn));
+		UpdateMaxError(&maxError[1], error);
+		error = fabs((double) FastAcosf(in) - acos(dIn));
+		UpdateMaxError(&maxError[2], error);
+		error = fabs((double) FastSqrtf(in2) - sqrt(dIn2)) / sqrt(dIn2);
+		UpdateMaxError(&maxError[3], error);
+		error = fabs((double) FastInvSqrtf(in2) - 1.0 / sqrt(dIn2)) * sqrt(dIn2);
+		UpdateMaxError(&maxError[4], error);
+		error = fabs((double) FastPowf(in2, 2.0f * in) - pow(dIn2, 2.0 * dIn)) / pow(dIn2, 2.0 * dIn);
+		UpdateMaxError(&maxError[5], error);
+		error = fabs((double) FastBarometricAltitude(in3)
+				- (double) BAROMETRIC_SCALE * (1.0 - pow((double) in3, 1.0 / 5.255)));
+		UpdateMaxError(&maxError[6], error);
+	}
+
+	/* Cycles, same inputs for both */
+#define BENCHMARK_LOOP(dstCycles, expr) \
+	start = GetTimestamp(); \
+	for (i = 0; i < BENCHMARK_SAMPLES; i++) { \
+		in = -1.0f + 2.0f * (float32_t) i / (BENCHMARK_SAMPLES - 1); \
+		in2 = 0.01f + 100.0f * (float32_t) i / (BENCHMARK_SAMPLES - 1); \
+		in3 = ALTITUDE_LUT_MIN_RATIO + (ALTITUDE_LUT_MAX_RATIO - ALTITUDE_LUT_MIN_RATIO) * (float32_t) i \
+				/ BENCHMARK_SAMPLES; \
+		benchmarkSink = (expr); \
+	} \
+	dstCycles = (GetTimestamp() - start) / BENCHMARK_SAMPLES;
+
+	BENCHMARK_LOOP(fastCycles[0], FastAtan2f(in, in2));
+	BENCHMARK_LOOP(libCycles[0], atan2f(in, in2));
+	BENCHMARK_LOOP(fastCycles[1], FastAsinf(in));
+	BENCHMARK_LOOP(libCycles[1], asinf(in));
+	BENCHMARK_LOOP(fastCycles[2], FastAcosf(in));
+	BENCHMARK_LOOP(libCycles[2], acosf(in));
+	BENCHMARK_LOOP(fastCycles[3], FastSqrtf(in2));
+	BENCHMARK_LOOP(libCycles[3], sqrtf(in2));
+	BENCHMARK_LOOP(fastCycles[4], FastInvSqrtf(in2));
+	BENCHMARK_LOOP(libCycles[4], 1.0f / sqrtf(in2));
+	BENCHMARK_LOOP(fastCycles[5], FastPowf(in2, in));
+	BENCHMARK_LOOP(libCycles[5], powf(in2, in));
+	BENCHMARK_LOOP(fastCycles[6], FastBarometricAltitude(in3));
+	BENCHMARK_LOOP(libCycles[6], BAROMETRIC_SCALE * (1.0f - powf(in3, BAROMETRIC_EXPONENT)));
+	BENCHMARK_LOOP(altitudePowCycles, BAROMETRIC_SCALE * (1.0f - FastPowf(in3, BAROMETRIC_EXPONENT)));
+#undef BENCHMARK_LOOP
+
+	/* Loop overhead (input generation) is included in both cycle counts */
+	return (size_t) snprintf(dst, dstSize,
+			"\nFunction\t Max error\t Fast [cyc]\t Lib [cyc]\n"
+			"atan2\t\t %.2e rad\t %lu\t\t %lu\n"
+			"asin\t\t %.2e rad\t %lu\t\t %lu\n"
+			"acos\t\t %.2e rad\t %lu\t\t %lu\n"
+			"sqrt\t\t %.2e rel\t %lu\t\t %lu\n"
+			"invsqrt\t\t %.2e rel\t %lu\t\t %lu\n"
+			"pow\t\t %.2e rel\t %lu\t\t %lu\n"
+			"baroalt\t\t %.2e m\t %lu\t\t %lu\t(with FastPowf %lu)\n",
+			(double) maxError[0], (unsigned long) fastCycles[0], (unsigned long) libCycles[0],
+			(double) maxError[1], (unsigned long) fastCycles[1], (unsigned long) libCycles[1],
+			(double) maxError[2], (unsigned long) fastCycles[2], (unsigned long) libCycles[2],
+			(double) maxError[3], (unsigned long) fastCycles[3], (unsigned long) libCycles[3],
+			(double) maxError[4], (unsigned long) fastCycles[4], (unsigned long) libCycles[4],
+			(double) maxError[5], (unsigned long) fastCycles[5], (unsigned long) libCycles[5],
+			(double) maxError[6], (unsigned long) fastCycles[6], (unsigned long) libCycles[6],
+			(unsigned long) altitudePowCycles);
+}
+#endif /* FCB_HOST_BUILD */
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Arctangent for arguments in [0, 1], minimax polynomial with max error 2e-6 rad
+ * @param  z : Argument in [0, 1]
+ * @retval Angle [rad]
+ */
+static float32_t AtanUnit(const float32_t z) {
+	float32_t z2 = z * z;
+
+	return z * (0.99997726f + z2 * (-0.33262347f + z2 * (0.19354346f + z2 * (-0.11643287f
+			+ z2 * (0.05265332f + z2 * -0.01172120f)))));
+}
+
+#ifndef FCB_HOST_BUILD
+/*
+ * @brief  Keeps the largest error of a benchmark
+ * @param  maxError : Largest error so far
+ * @param  error : New error
+ * @retval None
+ */
+static void UpdateMaxError(float32_t* maxError, const double error) {
+	if ((float32_t) error > *maxError) {
+		*maxError = (float32_t) error;
+	}
+}
+#endif /* FCB_HOST_BUILD */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,169 @@
+/******************************************************************************
+ * @file    firmware_update.c
+ * @author  Dragonfly
+ * @brief   Firmware update over USB with the ROM bootloader, see
+ *          firmware_update.h. The request is kept in the .noinit section,
+ *          like the crash dump, and a flag of the reset flags is not needed
+ *          for it, as the section holds random data after power on only and
+ *          the magic is cleared before the jump.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "firmware_update.h"
+
+#include "main.h"
+#include "flight_control.h"
+#include "flash.h"
+#include "common.h"
+#include "deferred_work.h"
+#include "fcb_error.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+
+/* Private define ------------------------------------------------------------*/
+#define BOOTLOADER_REQUEST_MAGIC        0x4C544F42  // "BOTL"
+
+#define FIRMWARE_NOINIT                 __attribute__((section(".noinit")))
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Defined by the linker script: the load address of the initialized data, which follows the code, and its bounds */
+extern uint32_t _sidata;
+extern uint32_t _sdata;
+extern uint32_t _edata;
+
+/* Kept over the reset */
+static uint32_t bootloaderRequest FIRMWARE_NOINIT;
+
+static DeferredWorkId_TypeDef rebootWorkId = DEFERRED_WORK_INVALID_ID;
+
+/* Private function prototypes -----------------------------------------------*/
+static void RebootWork(void* argument);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Jumps to the ROM bootloader if requested, with the system memory mapped at 0 as when started by BOOT0. Only
+ *         SystemInit() has run, so no clock, interrupt or peripheral has to be restored first.
+ * @param  None
+ * @retval None, returns only if the bootloader is not requested
+ */
+void CheckBootloaderRequest(void) {
+	const uint32_t* vectors = (const uint32_t*) FIRMWARE_SYSTEM_MEMORY_ADDR;
+
+	if (BOOTLOADER_REQUEST_MAGIC != bootloaderRequest) {
+		return;
+	}
+
+	/* The next reset, e.g. by the DFU leave request, starts the firmware again */
+	bootloaderRequest = 0;
+
+	__SYSCFG_CLK_ENABLE();
+	__HAL_REMAPMEMORY_SYSTEMFLASH();
+
+	__set_MSP(vectors[0]);
+	((void (*)(void)) vectors[1])();
+}
+
+/*
+ * @brief  Registers the delayed reset to the ROM bootloader with the low priority deferred worker
+ * @param  None
+ * @retval None
+ */
+void CreateFirmwareUpdateWork(void) {
+	if (FCB_OK != DeferredWorkRegister("Reboot", RebootWork, NULL, DEFERRED_WORKER_LOW, &rebootWorkId)) {
+		ErrorHandler();
+	}
+}
+
+/*
+ * @brief  Schedules the reset to the ROM bootloader, so that the reply to the request is sent first
+ * @param  None
+ * @retval FCB_OK if scheduled, FCB_ERR if not in idle mode or the reset work is not registered
+ */
+FcbRetValType RebootToBootloader(void) {
+	if (FLIGHT_CONTROL_IDLE != GetFlightControlMode() || DEFERRED_WORK_INVALID_ID == rebootWorkId) {
+		return FCB_ERR;
+	}
+
+	/* A request while one is pending is coalesced with it */
+	DeferredWorkPost(rebootWorkId);
+
+	return FCB_OK;
+}
+
+/*
+ * @brief  Sets the bootloader request for the next reset
+ * @param  None
+ * @retval None
+ */
+void RequestBootloaderOnReset(void) {
+	bootloaderRequest = BOOTLOADER_REQUEST_MAGIC;
+}
+
+/*
+ * @brief  Gets the bounds and the CRC of the running image, the code followed by the initialized data
+ * @param  info : Destination of the image info
+ * @retval FCB_OK if read, FCB_ERR if the CRC could not be calculated
+ */
+FcbRetValType GetFirmwareImageInfo(FirmwareImageInfo_TypeDef* info) {
+	const uint32_t imageEnd = (uint32_t) &_sidata + ((uint32_t) &_edata - (uint32_t) &_sdata);
+
+	info->startAddress = FLASH_BASE_ADDR;
+	info->size = imageEnd - FLASH_BASE_ADDR;
+	info->crc = DEFAULT_CRC_INITVALUE;
+
+	return ContinueCRCWithDMA(&info->crc, (const uint8_t*) info->startAddress, info->size);
+}
+
+size_t PrintFirmwareInfo(char* dst, const size_t dstSize) {
+	FirmwareImageInfo_TypeDef info;
+	size_t length;
+
+	length = (size_t) snprintf(dst, dstSize, "Firmware %s\r\n", DF_FCB_VERSION);
+
+	if (length < dstSize) {
+		if (FCB_OK != GetFirmwareImageInfo(&info)) {
+			length += (size_t) snprintf(dst + length, dstSize - length, "Image CRC could not be calculated\r\n");
+		} else {
+			length += (size_t) snprintf(dst + length, dstSize - length,
+					"Image 0x%08lx, %lu bytes, CRC 0x%08lx, %lu bytes free below the event journal\r\n",
+					info.startAddress, info.size, info.crc, FLASH_JOURNAL_START_ADDR - info.startAddress - info.size);
+		}
+	}
+
+	return (length < dstSize) ? length : dstSize - 1;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Waits FIRMWARE_REBOOT_DELAY and resets to the ROM bootloader, unless the UAV has been armed since the
+ *         request. Blocks the low priority worker, no other work is needed once the board is reset.
+ * @param  argument : Unused
+ * @retval None
+ */
+static void RebootWork(void* argument) {
+	(void) argument;
+
+	vTaskDelay(FIRMWARE_REBOOT_DELAY / portTICK_RATE_MS);
+
+	if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+		return;
+	}
+
+	RequestBootloaderOnReset();
+	NVIC_SystemReset();
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,230 @@
+/******************************************************************************
+ * @file    fixed_format.c
+ * @author  Dragonfly
+ * @brief   Fixed-point number formatter. The newlib printf converts floats
+ *          through double precision code, takes thousands of cycles per
+ *          value and several hundred bytes of stack. The values printed by
+ *          the text telemetry only need a few decimals, which fit in 32 bit
+ *          integers, so they are formatted with integer arithmetic instead.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "fixed_format.h"
+
+#include <math.h>
+#include <stdint.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+
+/* Largest integer part that is formatted, larger values are printed as "inf" */
+#define FIXED_FORMAT_MAX_INTEGER        4294967040.0f   // Largest float below 2^32
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static const uint32_t decimalScales[FIXED_FORMAT_MAX_DECIMALS + 1] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+/* Private function prototypes -----------------------------------------------*/
+static size_t PutChar(char* dst, const size_t dstSize, size_t length, const char c);
+static size_t PutUnsigned(char* dst, const size_t dstSize, size_t length, uint32_t value, uint8_t minDigits);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Converts a value to a fixed-point integer, the compact binary alternative to formatting it
+ * @param  value : Value to convert
+ * @param  decimals : Number of decimals, the value is scaled by 10^decimals [0, FIXED_FORMAT_MAX_DECIMALS]
+ * @retval Value scaled and rounded to the nearest integer, saturated to the int32_t range, 0 for NaN
+ */
+int32_t ToFixed(const float32_t value, const uint8_t decimals) {
+	float32_t scaled;
+
+	if (isnan(value)) {
+		return 0;
+	}
+
+	scaled = value * (float32_t) decimalScales[(decimals > FIXED_FORMAT_MAX_DECIMALS) ? FIXED_FORMAT_MAX_DECIMALS
+			: decimals];
+
+	if (scaled >= 2147483520.0f) {
+		return INT32_MAX;
+	}
+	if (scaled <= -2147483648.0f) {
+		return INT32_MIN;
+	}
+
+	return (int32_t) ((scaled < 0.0f) ? scaled - 0.5f : scaled + 0.5f);
+}
+
+/*
+ * @brief  Formats a value with a fixed number of decimals, like "%1.<decimals>f"
+ * @param  dst : Destination string buffer, always null terminated if dstSize > 0
+ * @param  dstSize : Size of dst
+ * @param  value : Value to format
+ * @param  decimals : Number of decimals [0, FIXED_FORMAT_MAX_DECIMALS]
+ * @retval Length of the formatted string, which is truncated if not less than dstSize
+ */
+size_t FormatFixed(char* dst, const size_t dstSize, const float32_t value, const uint8_t decimals) {
+	uint8_t fracDigits = (decimals > FIXED_FORMAT_MAX_DECIMALS) ? FIXED_FORMAT_MAX_DECIMALS : decimals;
+	float32_t absValue = fabsf(value);
+	uint32_t intPart;
+	uint32_t fracPart;
+	size_t length = 0;
+
+	if (dstSize > 0) {
+		dst[0] = '\0';
+	}
+
+	if (isnan(value)) {
+		length = PutChar(dst, dstSize, length, 'n');
+		length = PutChar(dst, dstSize, length, 'a');
+		return PutChar(dst, dstSize, length, 'n');
+	}
+
+	if (value < 0.0f) {
+		length = PutChar(dst, dstSize, length, '-');
+	}
+
+	if (absValue > FIXED_FORMAT_MAX_INTEGER) {
+		length = PutChar(dst, dstSize, length, 'i');
+		length = PutChar(dst, dstSize, length, 'n');
+		return PutChar(dst, dstSize, length, 'f');
+	}
+
+	/* The fraction of a float is exact, so only the scaling rounds */
+	intPart = (uint32_t) absValue;
+	fracPart = (uint32_t) ((absValue - (float32_t) intPart) * (float32_t) decimalScales[fracDigits] + 0.5f);
+	if (fracPart >= decimalScales[fracDigits]) {
+		intPart++;
+		fracPart -= decimalScales[fracDigits];
+	}
+
+	length = PutUnsigned(dst, dstSize, length, intPart, 1);
+	if (fracDigits > 0) {
+		length = PutChar(dst, dstSize, length, '.');
+		length = PutUnsigned(dst, dstSize, length, fracPart, fracDigits);
+	}
+
+	return length;
+}
+
+/*
+ * @brief  Formats a string with float values, a subset of snprintf. "%f" is replaced by the next value with 6
+ *         decimals, "%1.3f" (any width, which is ignored) with 3 decimals, "%%" by '%'. Other characters are copied.
+ * @param  dst : Destination string buffer, always null terminated if dstSize > 0
+ * @param  dstSize : Size of dst
+ * @param  format : Format string
+ * @param  values : Values to format, in the order of the conversions
+ * @param  valuesNbr : Number of values, conversions without a value are copied as they are
+ * @retval Length of the formatted string, which is truncated if not less than dstSize
+ */
+size_t FormatFixedList(char* dst, const size_t dstSize, const char* format, const float32_t* values,
+		const uint8_t valuesNbr) {
+	const char* conversion;
+	uint8_t decimals;
+	uint8_t valueIdx = 0;
+	size_t length = 0;
+
+	while (*format != '\0') {
+		if (*format != '%') {
+			length = PutChar(dst, dstSize, length, *format++);
+			continue;
+		}
+
+		/* Parse "%[width][.precision]f" */
+		conversion = format++;
+		if (*format == '%') {
+			length = PutChar(dst, dstSize, length, *format++);
+			continue;
+		}
+		while (*format >= '0' && *format <= '9') {
+			format++;
+		}
+		decimals = FIXED_FORMAT_MAX_DECIMALS;
+		if (*format == '.') {
+			format++;
+			decimals = 0;
+			while (*format >= '0' && *format <= '9') {
+				decimals = decimals * 10 + (*format++ - '0');
+				if (decimals > FIXED_FORMAT_MAX_DECIMALS) {
+					decimals = FIXED_FORMAT_MAX_DECIMALS;
+				}
+			}
+		}
+
+		if (*format != 'f' || valueIdx >= valuesNbr) {
+			/* Not a float conversion, copy it */
+			while (conversion < format) {
+				length = PutChar(dst, dstSize, length, *conversion++);
+			}
+			continue;
+		}
+		format++;
+
+		length += FormatFixed((length < dstSize) ? &dst[length] : NULL, (length < dstSize) ? dstSize - length : 0,
+				values[valueIdx++], decimals);
+	}
+
+	if (dstSize > 0) {
+		dst[(length < dstSize) ? length : dstSize - 1] = '\0';
+	}
+
+	return length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Puts a character at the end of a string, as long as there is room for it and the null terminator
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @param  length : Length of the string so far
+ * @param  c : Character to put
+ * @retval Length of the string with the character, also if it did not fit
+ */
+static size_t PutChar(char* dst, const size_t dstSize, size_t length, const char c) {
+	if (length + 1 < dstSize) {
+		dst[length] = c;
+		dst[length + 1] = '\0';
+	}
+
+	return length + 1;
+}
+
+/*
+ * @brief  Puts the decimal digits of an unsigned value at the end of a string
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @param  length : Length of the string so far
+ * @param  value : Value to put
+ * @param  minDigits : Min number of digits, padded with leading zeros
+ * @retval Length of the string with the digits, also if they did not fit
+ */
+static size_t PutUnsigned(char* dst, const size_t dstSize, size_t length, uint32_t value, uint8_t minDigits) {
+	char digits[10];
+	uint8_t digitsNbr = 0;
+
+	do {
+		digits[digitsNbr++] = '0' + (value % 10);
+		value /= 10;
+	} while (value > 0 && digitsNbr < sizeof(digits));
+
+	while (digitsNbr < minDigits && digitsNbr < sizeof(digits)) {
+		digits[digitsNbr++] = '0';
+	}
+
+	while (digitsNbr > 0) {
+		length = PutChar(dst, dstSize, length, digits[--digitsNbr]);
+	}
+
+	return length;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
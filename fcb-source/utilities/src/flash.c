@@ -23,35 +23,257 @@
 /* Includes ------------------------------------------------------------------*/
 #include "flash.h"
 #include "common.h"
+#include "fcb_error.h"
+#include "wcet_test.h"
+#include "deferred_work.h"
+#include "rate_groups.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
 #include <string.h>
+#include <stdbool.h>
 
 /* Private typedef -----------------------------------------------------------*/
+
+/* Block of the fixed layout used before the settings store: a CRC word followed by the data */
+typedef struct {
+	FlashSettingsKey key;
+	uint16_t offset;
+	uint16_t size;
+} LegacySettingsBlock_TypeDef;
+
 /* Private define ------------------------------------------------------------*/
 
+/* Store page header: magic, sequence number and the active marker. The marker is programmed once the page holds the
+ * newest records of all keys, the active page with the highest sequence number is the one in use. */
+#define STORE_PAGE_MAGIC                0x31544553  // "SET1"
+#define STORE_PAGE_ACTIVE               0x00000000
+#define STORE_PAGE_SEQUENCE_OFFSET      4
+#define STORE_PAGE_ACTIVE_OFFSET        8
+#define STORE_PAGE_HEADER_SIZE          12
+
+#define STORE_RECORD_HEADER_SIZE        FLASH_WORD_BYTE_SIZE
+#define STORE_RECORD_CRC_SIZE           FLASH_WORD_BYTE_SIZE
+#define STORE_ERASED_WORD               0xFFFFFFFF
+#define STORE_ERASED_HALF_WORD          0xFFFF
+
+#define FLASH_WRITER_CHECK_PHASE        270 // [ms] in the 1 Hz rate group, clear of the 20 Hz releases
+#define FLASH_WRITER_QUEUE_SIZE         768 // [bytes] The largest record and a few small ones
+
+/* Offsets of the fixed layout used before the settings store, all in the first settings page. Each block was sized with
+ * 8 bytes of CRC room, except the magnetometer and accelerometer ones which have none and overlap the next block. */
+#define LEGACY_RECEIVER_CALIBRATION_OFFSET  0
+#define LEGACY_REFERENCE_MAX_LIMITS_OFFSET  (sizeof(Receiver_CalibrationValues_TypeDef) + 8)
+#define LEGACY_MAG_CALIBRATION_OFFSET       (LEGACY_REFERENCE_MAX_LIMITS_OFFSET + sizeof(RefSignals_TypeDef) + 8)
+#define LEGACY_ACC_CALIBRATION_OFFSET       (LEGACY_MAG_CALIBRATION_OFFSET + 6*sizeof(float32_t))
+#define LEGACY_SENSOR_FILTER_OFFSET         (LEGACY_ACC_CALIBRATION_OFFSET + 6*sizeof(float32_t) + FLASH_WORD_BYTE_SIZE)
+#define LEGACY_STATE_WARM_START_OFFSET      (LEGACY_SENSOR_FILTER_OFFSET + sizeof(FcbSensorFilterSettingsType) + 8)
+#define LEGACY_MOTOR_MIXER_OFFSET           (LEGACY_STATE_WARM_START_OFFSET + sizeof(StateWarmStartType) + 8)
+#define LEGACY_PID_GAINS_OFFSET             (LEGACY_MOTOR_MIXER_OFFSET + sizeof(MotorMixerSettings_TypeDef) + 8)
+#define LEGACY_UART_SETTINGS_OFFSET         (LEGACY_PID_GAINS_OFFSET + sizeof(PIDGainSettings_TypeDef) + 8)
+
 /* Private macro -------------------------------------------------------------*/
 #define IS_VALID_FLASH_ADDR(ADDR)	(((ADDR) >= FLASH_BASE_ADDR) && ((ADDR) < (FLASH_BASE_ADDR + FLASH_TOTAL_SIZE)))
 
-#define IS_VALID_SETTINGS_PAGE(PAGE)	(((PAGE) >= FLASH_SETTINGS_START_PAGE) && ((PAGE) <= FLASH_SETTINGS_END_PAGE))
+#define STORE_PAGE_ADDR(IDX)		(FLASH_BASE_ADDR + (FLASH_SETTINGS_STORE_FIRST_PAGE + (IDX)) * FLASH_PAGE_SIZE)
+#define FLASH_WORD(ADDR)			(*(const volatile uint32_t*) (ADDR))
+
+/* Places a function in RAM, it is copied there with the initialized data at startup. The long call reaches it from
+ * flash. */
+#define FLASH_RAM_FUNC				__attribute__((section(".data.flash_ram_func"), long_call, noinline))
+
+#define WORD_ALIGN(SIZE)			(((SIZE) + FLASH_WORD_BYTE_SIZE - 1) & ~(FLASH_WORD_BYTE_SIZE - 1))
+#define STORE_RECORD_SIZE(SIZE)		(STORE_RECORD_HEADER_SIZE + WORD_ALIGN(SIZE) + STORE_RECORD_CRC_SIZE)
+
+#define STORE_RECORD_HEADER(KEY, VERSION, SIZE)	\
+	((uint32_t) (KEY) | ((uint32_t) (VERSION) << 8) | ((uint32_t) (SIZE) << 16))
+#define STORE_RECORD_KEY(HEADER)		((HEADER) & 0xFF)
+#define STORE_RECORD_VERSION(HEADER)	(((HEADER) >> 8) & 0xFF)
+#define STORE_RECORD_DATA_SIZE(HEADER)	((HEADER) >> 16)
 
-#define IS_VALID_PAGE_OFFSET_SIZE(OFFSET,SIZE)	(((OFFSET) + (SIZE)) <= FLASH_PAGE_SIZE)
+/* Header of a record of the current settings struct of a key */
+#define SETTINGS_RECORD_HEADER(KEY, SIZE)	STORE_RECORD_HEADER(KEY, settingsVersions[KEY], SIZE)
+
+/* The header of a profile slot holds the profile index as its key */
+#define PROFILE_RECORD_SIZE			STORE_RECORD_SIZE(sizeof(ParamProfileType))
+#define PROFILE_RECORD_ADDR(IDX)	(FLASH_PROFILES_START_ADDR + (IDX) * PROFILE_RECORD_SIZE)
+#define PROFILE_RECORD_HEADER(IDX)	STORE_RECORD_HEADER(IDX, 0, sizeof(ParamProfileType))
+
+_Static_assert(FLASH_KEY_NBR <= 0x100, "The settings keys do not fit the record header");
+_Static_assert(PARAM_PROFILE_NBR * PROFILE_RECORD_SIZE <= FLASH_PROFILES_SIZE,
+		"The parameter profiles do not fit the profiles page");
+_Static_assert(STORE_RECORD_SIZE(FLASH_SETTINGS_MAX_RECORD_SIZE) <= FLASH_WRITER_QUEUE_SIZE,
+		"The largest record does not fit the flash writer queue");
 
 /* Private variables ---------------------------------------------------------*/
 
+/* Previous layout blocks, imported once when no store page is found. Of two overlapping blocks only the one written
+ * last passes its CRC check. */
+static const LegacySettingsBlock_TypeDef legacySettingsBlocks[] = {
+	{ FLASH_KEY_RECEIVER_CALIBRATION, LEGACY_RECEIVER_CALIBRATION_OFFSET, sizeof(Receiver_CalibrationValues_TypeDef) },
+	{ FLASH_KEY_REFERENCE_MAX_LIMITS, LEGACY_REFERENCE_MAX_LIMITS_OFFSET, sizeof(RefSignals_TypeDef) },
+	{ FLASH_KEY_MAG_CALIBRATION, LEGACY_MAG_CALIBRATION_OFFSET, 6*sizeof(float32_t) },
+	{ FLASH_KEY_ACC_CALIBRATION, LEGACY_ACC_CALIBRATION_OFFSET, 6*sizeof(float32_t) },
+	{ FLASH_KEY_SENSOR_FILTER, LEGACY_SENSOR_FILTER_OFFSET, sizeof(FcbSensorFilterSettingsType) },
+	{ FLASH_KEY_STATE_WARM_START, LEGACY_STATE_WARM_START_OFFSET, sizeof(StateWarmStartType) },
+	{ FLASH_KEY_MOTOR_MIXER, LEGACY_MOTOR_MIXER_OFFSET, sizeof(MotorMixerSettings_TypeDef) },
+	{ FLASH_KEY_PID_GAINS, LEGACY_PID_GAINS_OFFSET, sizeof(PIDGainSettings_TypeDef) },
+	{ FLASH_KEY_UART_SETTINGS, LEGACY_UART_SETTINGS_OFFSET, sizeof(UartSettings_TypeDef) }
+};
+
+static const uint32_t storePageActiveMarker = STORE_PAGE_ACTIVE;
+
+/* Version of the settings struct of each key, stored in the header of its records. When a struct changes, the version
+ * of its key is incremented and MigrateSettings() converts the records of the previous versions, so that a firmware
+ * update keeps the stored settings. All settings structs are at their first version, as are the records written
+ * before the header held versions. */
+static const uint8_t settingsVersions[FLASH_KEY_NBR] = { 0 };
+
+/* Flash address of the newest valid record of each key, 0 if there is none. Built at startup by InitFlashSettings(). */
+static uint32_t settingsIndex[FLASH_KEY_NBR];
+
+/* Size of the current settings struct of each key, indexed by FlashSettingsKey */
+static const uint16_t settingsSizes[FLASH_KEY_NBR] = {
+	sizeof(Receiver_CalibrationValues_TypeDef),
+	sizeof(RefSignals_TypeDef),
+	6*sizeof(float32_t),
+	6*sizeof(float32_t),
+	sizeof(FcbSensorFilterSettingsType),
+	sizeof(StateWarmStartType),
+	sizeof(MotorMixerSettings_TypeDef),
+	sizeof(PIDGainSettings_TypeDef),
+	sizeof(UartSettings_TypeDef),
+	sizeof(BlackboxSettings_TypeDef),
+	MAG_CALIB_IDX_MAX*sizeof(float32_t),
+	sizeof(FcbMagOnlineCalibrationSettingsType),
+	sizeof(FcbGyroTempCompensationType),
+	sizeof(CrashDump_TypeDef),
+	sizeof(SensorNoiseType),
+	sizeof(StickCurveSettingsType),
+	sizeof(ThrustCurveSettingsType),
+	sizeof(PIDGainSchedule_TypeDef),
+	sizeof(PIDFeedForwardSettings_TypeDef),
+	sizeof(EscOutputsType),
+	sizeof(CrashDetectionSettingsType),
+	sizeof(FcbSensorOrientationSettingsType),
+	sizeof(FcbAccMagTempCompensationType),
+	sizeof(RcSmoothingSettingsType),
+	sizeof(Receiver_ChannelMap_TypeDef),
+	sizeof(EstimatorNoiseSettingsType),
+	sizeof(MagHeadingSettingsType),
+	sizeof(FcbSensorTimingSettingsType),
+	sizeof(MotorFailureSettingsType),
+	sizeof(EventJournalOdometerType),
+	sizeof(MotorMixerAllocation_TypeDef),
+	sizeof(PerfBaseline_TypeDef)
+};
+
+/* Active store page, as an index into the settings area, and the page offset the next record is programmed at */
+static uint8_t activeStorePageIdx = 0;
+static uint16_t storeWriteOffset = FLASH_PAGE_SIZE;
+static uint32_t activeStoreSequence = 0;
+static bool isStoreInitialized = false;
+
+/* Records waiting for the flash writer, laid out as they are programmed, at most one per key. Only settings that
+ * differ from their newest record are queued, so the queue holds the few keys changed since the last flush. An active
+ * settings batch, see StartFlashSettingsBatch(), collects its records after pendingBatchOffset. Declared as static so
+ * stack/RTOS stack is not loaded with this. */
+static uint8_t pendingRecords[FLASH_WRITER_QUEUE_SIZE];
+static uint16_t pendingRecordsSize = 0;
+static uint16_t pendingBatchOffset = 0;
+static bool isSettingsBatchActive = false;
+
+/* Counts the writes of calibration records and the aborted batches, which may have dropped some, so that a reader of
+ * the calibration knows when to read it again. Written under the store lock, read without locks, a single word. */
+static uint32_t calibrationWriteCount = 0;
+
+/* The flash writer runs on the low priority deferred worker, posted when records are queued and once a second while
+ * they are pending */
+static DeferredWorkId_TypeDef flashWriterWorkId = DEFERRED_WORK_INVALID_ID;
+static RateGroupJobId_TypeDef flashWriterJobId = RATE_GROUP_INVALID_ID;
+
 /* Private function prototypes -----------------------------------------------*/
-static FlashErrorStatus WriteSettingsToFlash(const uint8_t* writeSettingsData, const uint16_t writeSettingsDataSize,
-		const uint8_t settingsPageNbr, const uint16_t settingsPageOffset);
-static FlashErrorStatus ReadSettingsFromFlash(uint8_t* readSettingsData, const uint16_t readSettingsDataSize,
-		const uint8_t settingsPageNbr, const uint16_t settingsPageOffset);
+static FlashErrorStatus WriteSettingsToFlash(const FlashSettingsKey key, const uint8_t* writeSettingsData,
+		const uint16_t writeSettingsDataSize);
+static FlashErrorStatus ReadSettingsFromFlash(const FlashSettingsKey key, uint8_t* readSettingsData,
+		const uint16_t readSettingsDataSize);
+
+static void FlashWriterWork(void* argument);
+static void FlashWriterCheck(void* argument);
+static FlashErrorStatus FlushPendingRecords(void);
+static FlashErrorStatus QueueRecord(const FlashSettingsKey key, const uint8_t* data, const uint16_t dataSize,
+		const uint32_t crc);
+static uint16_t RemovePendingRecord(const FlashSettingsKey key, const uint16_t fromOffset, const uint16_t toOffset);
+static int32_t FindPendingRecord(const FlashSettingsKey key, const uint16_t fromOffset, const uint16_t toOffset);
+static bool IsSettingsUnchanged(const FlashSettingsKey key, const uint8_t* data, const uint16_t dataSize);
+static void WakeFlashWriter(void);
+static bool CopyRecordSettings(const FlashSettingsKey key, const uint32_t header, const uint8_t* data,
+		uint8_t* dstData);
+static void MigrateStoredSettings(void);
+static bool MigrateSettings(const FlashSettingsKey key, const uint8_t version, const uint8_t* data,
+		const uint16_t dataSize, uint8_t* dstData);
+static void RewriteMigratedSettings(const FlashSettingsKey key, const uint8_t* data);
+static bool IsCalibrationKey(const FlashSettingsKey key);
+
+static void LockSettingsStore(void);
+static void UnlockSettingsStore(void);
+static bool FindActiveStorePage(void);
+static void ScanStorePage(void);
+static FlashErrorStatus FormatStore(void);
+static FlashErrorStatus CompactStore(const uint16_t neededSize);
+static FlashErrorStatus OpenStorePage(const uint8_t pageIdx, const uint32_t sequence);
+static FlashErrorStatus AppendRecord(const uint32_t header, const uint8_t* data, const uint32_t crc);
+static bool IsValidRecord(const uint32_t recordAddr);
+static uint32_t CalculateRecordCRC(const uint32_t header, const uint8_t* data, const uint16_t dataSize);
+
+static FlashErrorStatus EraseFlashPage(const uint32_t pageAddr);
+static FlashErrorStatus ProgramFlashWords(const uint32_t addr, const uint8_t* data, const uint16_t size);
+static bool IsFlashErased(const uint32_t addr, const uint32_t size);
+static FLASH_RAM_FUNC uint32_t EraseFlashPageFromRAM(const uint32_t pageAddr);
+static FLASH_RAM_FUNC uint32_t ProgramFlashWordFromRAM(const uint32_t addr, const uint32_t word);
 
-static FlashErrorStatus WriteFlashPage(const uint32_t* writeData,
-		const uint8_t pageNbr);
-static FlashErrorStatus ReadFlashPage(uint8_t * readData, const uint8_t pageNbr);
-static uint32_t ReadFlashWord(const uint8_t pageNbr, const uint16_t pageOffset);
-static FlashErrorStatus ReadFlashBytes(uint8_t * readData, const uint32_t startAddr, const uint32_t nbrOfBytes);
+/* Exported functions --------------------------------------------------------*/
 
-static uint32_t GetFlashPageOffsetAddress(const uint8_t pageNbr, const uint16_t pageOffset);
+/*
+ * @brief  Finds the active page of the settings store, builds the index of the newest records in one pass over the
+ *         page and rewrites the records of previous settings versions in the current ones. If there is no store yet,
+ *         one is formatted and the settings of the previous fixed layout are imported. Called once at startup, after
+ *         the CRC peripheral is initialized and before any settings are read.
+ * @param  None
+ * @retval FLASH_OK if the store is ready, else FLASH_ERROR
+ */
+FlashErrorStatus InitFlashSettings(void) {
+	FlashErrorStatus status = FLASH_OK;
 
-/* Exported functions --------------------------------------------------------*/
+	memset(settingsIndex, 0x00, sizeof(settingsIndex));
+
+	if (FindActiveStorePage())
+		ScanStorePage();
+	else
+		status = FormatStore();
+
+	isStoreInitialized = (FLASH_OK == status);
+
+	if (isStoreInitialized)
+		MigrateStoredSettings();
+
+	return status;
+}
+
+/*
+ * @brief  Registers the flash writer, which programs the written settings to flash when flight control is idle. Until
+ *         it is registered, settings are written to flash directly.
+ * @param  None
+ * @retval None
+ */
+void CreateFlashWriterWork(void) {
+	if (FCB_OK != DeferredWorkRegister("FlashWriter", FlashWriterWork, NULL, DEFERRED_WORKER_LOW, &flashWriterWorkId)
+			|| FCB_OK != RateGroupRegister("FLASH_WRITER", FlashWriterCheck, NULL, RATE_GROUP_1HZ,
+					FLASH_WRITER_CHECK_PHASE, &flashWriterJobId)) {
+		ErrorHandler();
+	}
+}
 
 /*
  * @brief  Reads previously stored receiver calibration values from flash memory
@@ -62,8 +284,8 @@ FlashErrorStatus ReadCalibrationValuesFromFlash(volatile Receiver_CalibrationVal
 	FlashErrorStatus status = FLASH_OK;
 
 	/* Read receiver calibration settings from flash, if valid data exists */
-	status = ReadSettingsFromFlash((uint8_t*) receiverCalibrationValues, sizeof(Receiver_CalibrationValues_TypeDef),
-			FLASH_RECEIVER_CALIBRATION_PAGE, FLASH_RECEIVER_CALIBRATION_DATA_OFFSET);
+	status = ReadSettingsFromFlash(FLASH_KEY_RECEIVER_CALIBRATION, (uint8_t*) receiverCalibrationValues,
+			sizeof(Receiver_CalibrationValues_TypeDef));
 
 	return status;
 }
@@ -77,8 +299,8 @@ FlashErrorStatus WriteCalibrationValuesToFlash( const Receiver_CalibrationValues
 	FlashErrorStatus status = FLASH_OK;
 
 	/* Write receiver calibration settings to flash */
-	status = WriteSettingsToFlash((uint8_t*) receiverCalibrationValues, sizeof(Receiver_CalibrationValues_TypeDef),
-			FLASH_RECEIVER_CALIBRATION_PAGE, FLASH_RECEIVER_CALIBRATION_DATA_OFFSET);
+	status = WriteSettingsToFlash(FLASH_KEY_RECEIVER_CALIBRATION, (uint8_t*) receiverCalibrationValues,
+			sizeof(Receiver_CalibrationValues_TypeDef));
 
 	return status;
 }
@@ -92,8 +314,8 @@ FlashErrorStatus ReadReferenceMaxLimitsFromFlash(RefSignals_TypeDef* referenceMa
 	FlashErrorStatus status = FLASH_OK;
 
 	/* Read reference calibration settings from flash, if valid data exists */
-	status = ReadSettingsFromFlash((uint8_t*) referenceMaxLimits, sizeof(RefSignals_TypeDef),
-			FLASH_REFERENCE_MAX_LIMITS_PAGE, FLASH_REFERENCE_MAX_LIMITS_DATA_OFFSET);
+	status = ReadSettingsFromFlash(FLASH_KEY_REFERENCE_MAX_LIMITS, (uint8_t*) referenceMaxLimits,
+			sizeof(RefSignals_TypeDef));
 
 	return status;
 }
@@ -107,8 +329,8 @@ FlashErrorStatus WriteReferenceMaxLimitsToFlash( const RefSignals_TypeDef* refer
 	FlashErrorStatus status = FLASH_OK;
 
 	/* Write reference calibration settings to flash */
-	status = WriteSettingsToFlash((uint8_t*) referenceMaxLimits, sizeof(RefSignals_TypeDef),
-			FLASH_REFERENCE_MAX_LIMITS_PAGE, FLASH_REFERENCE_MAX_LIMITS_DATA_OFFSET);
+	status = WriteSettingsToFlash(FLASH_KEY_REFERENCE_MAX_LIMITS, (uint8_t*) referenceMaxLimits,
+			sizeof(RefSignals_TypeDef));
 
 	return status;
 }
@@ -122,8 +344,8 @@ FlashErrorStatus ReadMagCalibrationValuesFromFlash(float32_t magCalibrationValue
 	FlashErrorStatus status = FLASH_OK;
 
 	/* Read receiver calibration settings from flash, if valid data exists */
-	status = ReadSettingsFromFlash((uint8_t*) magCalibrationValues, FLASH_MAG_CALIBRATION_SIZE,
-			FLASH_MAG_CALIBRATION_PAGE, FLASH_MAG_CALIBRATION_DATA_OFFSET);
+	status = ReadSettingsFromFlash(FLASH_KEY_MAG_CALIBRATION, (uint8_t*) magCalibrationValues,
+			6*sizeof(float32_t));
 
 	return status;
 }
@@ -137,8 +359,100 @@ FlashErrorStatus WriteMagCalibrationValuesToFlash(const float32_t magCalibration
 	FlashErrorStatus status = FLASH_OK;
 
 	/* Write receiver calibration settings to flash */
-	status = WriteSettingsToFlash((uint8_t*) magCalibrationValues, FLASH_MAG_CALIBRATION_SIZE,
-			FLASH_MAG_CALIBRATION_PAGE, FLASH_MAG_CALIBRATION_DATA_OFFSET);
+	status = WriteSettingsToFlash(FLASH_KEY_MAG_CALIBRATION, (uint8_t*) magCalibrationValues,
+			6*sizeof(float32_t));
+
+	return status;
+}
+
+/*
+ * @brief  Reads previously stored magnetometer ellipsoid calibration values from flash memory
+ * @param  magCalibrationValues : Pointer to magnetometer calibration values to which values will enter, see
+ *         FcbMagCalibrationParmIndex
+ * @retval FLASH_OK if calibration values read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadMagEllipsoidCalibrationFromFlash(float32_t magCalibrationValues[MAG_CALIB_IDX_MAX]) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read magnetometer calibration settings from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_MAG_ELLIPSOID_CALIBRATION, (uint8_t*) magCalibrationValues,
+			MAG_CALIB_IDX_MAX*sizeof(float32_t));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the magnetometer ellipsoid calibration values to flash memory for persistent storage
+ * @param  magCalibrationValues : Pointer to magnetometer calibration values to be saved, see
+ *         FcbMagCalibrationParmIndex
+ * @retval FLASH_OK if calibration values written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteMagEllipsoidCalibrationToFlash(const float32_t magCalibrationValues[MAG_CALIB_IDX_MAX]) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write magnetometer calibration settings to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_MAG_ELLIPSOID_CALIBRATION, (uint8_t*) magCalibrationValues,
+			MAG_CALIB_IDX_MAX*sizeof(float32_t));
+
+	return status;
+}
+
+/*
+ * @brief  Reads previously stored magnetometer online calibration settings from flash memory
+ * @param  settings : Pointer to settings struct to which values will enter
+ * @retval FLASH_OK if settings read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadMagOnlineCalibrationSettingsFromFlash(FcbMagOnlineCalibrationSettingsType* settings) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read magnetometer online calibration settings from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_MAG_ONLINE_CALIBRATION, (uint8_t*) settings,
+			sizeof(FcbMagOnlineCalibrationSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the magnetometer online calibration settings to flash memory for persistent storage
+ * @param  settings : Pointer to settings struct to be saved
+ * @retval FLASH_OK if settings written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteMagOnlineCalibrationSettingsToFlash(const FcbMagOnlineCalibrationSettingsType* settings) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write magnetometer online calibration settings to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_MAG_ONLINE_CALIBRATION, (uint8_t*) settings,
+			sizeof(FcbMagOnlineCalibrationSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Reads the previously stored gyroscope bias vs temperature table from flash memory
+ * @param  compensation : Pointer to table struct to which values will enter
+ * @retval FLASH_OK if table read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadGyroTempCompensationFromFlash(FcbGyroTempCompensationType* compensation) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read gyroscope temperature compensation from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_GYRO_TEMP_COMPENSATION, (uint8_t*) compensation,
+			sizeof(FcbGyroTempCompensationType));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the gyroscope bias vs temperature table to flash memory for persistent storage
+ * @param  compensation : Pointer to table struct to be saved
+ * @retval FLASH_OK if table written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteGyroTempCompensationToFlash(const FcbGyroTempCompensationType* compensation) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write gyroscope temperature compensation to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_GYRO_TEMP_COMPENSATION, (uint8_t*) compensation,
+			sizeof(FcbGyroTempCompensationType));
 
 	return status;
 }
@@ -152,8 +466,8 @@ FlashErrorStatus ReadAccCalibrationValuesFromFlash(float32_t accCalibrationValue
 	FlashErrorStatus status = FLASH_OK;
 
 	/* Read receiver calibration settings from flash, if valid data exists */
-	status = ReadSettingsFromFlash((uint8_t*) accCalibrationValues, FLASH_ACC_CALIBRATION_SIZE,
-			FLASH_ACC_CALIBRATION_PAGE, FLASH_ACC_CALIBRATION_DATA_OFFSET);
+	status = ReadSettingsFromFlash(FLASH_KEY_ACC_CALIBRATION, (uint8_t*) accCalibrationValues,
+			6*sizeof(float32_t));
 
 	return status;
 }
@@ -167,197 +481,1769 @@ FlashErrorStatus WriteAccCalibrationValuesToFlash(const float32_t accCalibration
 	FlashErrorStatus status = FLASH_OK;
 
 	/* Write receiver calibration settings to flash */
-	status = WriteSettingsToFlash((uint8_t*) accCalibrationValues, FLASH_ACC_CALIBRATION_SIZE,
-			FLASH_ACC_CALIBRATION_PAGE, FLASH_ACC_CALIBRATION_DATA_OFFSET);
+	status = WriteSettingsToFlash(FLASH_KEY_ACC_CALIBRATION, (uint8_t*) accCalibrationValues,
+			6*sizeof(float32_t));
 
 	return status;
 }
 
-/* Private functions ---------------------------------------------------------*/
+/*
+ * @brief  Reads previously stored sensor filter coefficients from flash memory
+ * @param  sensorFilterSettings : Pointer to sensor filter settings struct to which values will enter
+ * @retval FLASH_OK if filter settings read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadSensorFilterSettingsFromFlash(FcbSensorFilterSettingsType* sensorFilterSettings) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read sensor filter settings from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_SENSOR_FILTER, (uint8_t*) sensorFilterSettings,
+			sizeof(FcbSensorFilterSettingsType));
+
+	return status;
+}
 
 /*
- * @brief  Writes the settings to flash memory for persistent storage while also adding a CRC value for the stored data
- * @param  writeSettingsData : uint8_t pointer to settings to be saved
- * @param  writeSettingsDataSize : writeSettingsData byte size
- * @retval FLASH_OK if settings written succesfully to flash, else FLASH_ERROR
+ * @brief  Writes the sensor filter coefficients to flash memory for persistent storage
+ * @param  sensorFilterSettings : Pointer to sensor filter settings struct to be saved
+ * @retval FLASH_OK if filter settings written succesfully to flash, else FLASH_ERROR
  */
-static FlashErrorStatus WriteSettingsToFlash(const uint8_t* writeSettingsData, const uint16_t writeSettingsDataSize,
-		const uint8_t settingsPageNbr, const uint16_t settingsPageOffset) {
-	/* Check so that page is valid and that there is enough space on page to store the settings together with CRC*/
+FlashErrorStatus WriteSensorFilterSettingsToFlash(const FcbSensorFilterSettingsType* sensorFilterSettings) {
+	FlashErrorStatus status = FLASH_OK;
 
-	if (!IS_VALID_SETTINGS_PAGE(settingsPageNbr)
-			|| !IS_VALID_PAGE_OFFSET_SIZE(settingsPageOffset, writeSettingsDataSize + FLASH_WORD_BYTE_SIZE))
-		return FLASH_ERROR;
+	/* Write sensor filter settings to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_SENSOR_FILTER, (uint8_t*) sensorFilterSettings,
+			sizeof(FcbSensorFilterSettingsType));
 
-	/* Read the whole page and store it in tmpPage - required since when writing a page, its entire contents must first be erased */
-	static uint8_t tmpPage[FLASH_PAGE_SIZE]; // Declared as static so stack/RTOS stack is not loaded with this
-	memset(tmpPage, 0x00, sizeof(tmpPage));
-	if (!ReadFlashPage(tmpPage, settingsPageNbr))
-		return FLASH_ERROR;
+	return status;
+}
 
-	/* Copy data to tmpPage at offset+1 location (CRC stored at first index) */
-	memcpy(&tmpPage[settingsPageOffset + FLASH_WORD_BYTE_SIZE], writeSettingsData,
-			writeSettingsDataSize);
+/*
+ * @brief  Reads the previously stored state estimation warm start from flash memory
+ * @param  stateWarmStart : Pointer to warm start struct to which values will enter
+ * @retval FLASH_OK if warm start read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadStateWarmStartFromFlash(StateWarmStartType* stateWarmStart) {
+	FlashErrorStatus status = FLASH_OK;
 
-	/* Take the CRC of the data to be inserted into flash storage, except for the first index which is reserved for the CRC itself */
-	uint32_t crcValue = CalculateCRC(&tmpPage[settingsPageOffset + FLASH_WORD_BYTE_SIZE],
-			writeSettingsDataSize);
-	memcpy(&tmpPage[settingsPageOffset], (uint8_t*) &crcValue, FLASH_WORD_BYTE_SIZE);
-	if (!WriteFlashPage((uint32_t*) tmpPage, settingsPageNbr))
-		return FLASH_ERROR;
+	/* Read state warm start from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_STATE_WARM_START, (uint8_t*) stateWarmStart,
+			sizeof(StateWarmStartType));
 
-	return FLASH_OK;
+	return status;
 }
 
 /*
- * @brief  Reads previously stored receiver calibration values from flash memory
- * @param  receiverCalibrationValues : Pointer to receiver calibration values struct to which values will enter
- * @retval FLASH_OK if calibration values read succesfully from flash, else FLASH_ERROR
+ * @brief  Writes the state estimation warm start to flash memory for persistent storage
+ * @param  stateWarmStart : Pointer to warm start struct to be saved
+ * @retval FLASH_OK if warm start written succesfully to flash, else FLASH_ERROR
  */
-static FlashErrorStatus ReadSettingsFromFlash(uint8_t* readSettingsData, const uint16_t readSettingsDataSize,
-		const uint8_t settingsPageNbr, const uint16_t settingsPageOffset) {
+FlashErrorStatus WriteStateWarmStartToFlash(const StateWarmStartType* stateWarmStart) {
+	FlashErrorStatus status = FLASH_OK;
 
-	uint8_t tmpSettings[readSettingsDataSize];
-	uint32_t CRC_Calculated;
+	/* Write state warm start to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_STATE_WARM_START, (uint8_t*) stateWarmStart,
+			sizeof(StateWarmStartType));
 
-	/* Check so that page is valid and that space after offset is large enough on page to store the settings together with CRC */
-	if (!IS_VALID_SETTINGS_PAGE(settingsPageNbr)
-			|| !IS_VALID_PAGE_OFFSET_SIZE(settingsPageOffset, readSettingsDataSize + FLASH_WORD_BYTE_SIZE))
-		return FLASH_ERROR;
+	return status;
+}
 
-	/* First, get the stored CRC, stored at first offset index */
-	uint32_t CRC_Stored = ReadFlashWord(settingsPageNbr, settingsPageOffset);
+/*
+ * @brief  Reads previously stored motor mixer settings from flash memory
+ * @param  motorMixerSettings : Pointer to mixer settings struct to which values will enter
+ * @retval FLASH_OK if mixer settings read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadMotorMixerSettingsFromFlash(MotorMixerSettings_TypeDef* motorMixerSettings) {
+	FlashErrorStatus status = FLASH_OK;
 
-	/* Read the stored settings data and store it in tmpSettings, added word size to the offset to skip pass the stored CRC */
-	if (!ReadFlashBytes(tmpSettings,
-			GetFlashPageOffsetAddress(settingsPageNbr, settingsPageOffset + FLASH_WORD_BYTE_SIZE),
-			readSettingsDataSize))
-		return FLASH_ERROR;
+	/* Read motor mixer settings from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_MOTOR_MIXER, (uint8_t*) motorMixerSettings,
+			sizeof(MotorMixerSettings_TypeDef));
 
-	/* Calculate CRC of loaded settings bytes */
-	CRC_Calculated = CalculateCRC(tmpSettings, readSettingsDataSize);
+	return status;
+}
 
-	/* Check data integrity by comparing the calculated CRC with the one stored when setting were saved */
-	if (CRC_Calculated == CRC_Stored) {
-		memcpy(readSettingsData, tmpSettings, readSettingsDataSize);
-		return FLASH_OK;
-	}
+/*
+ * @brief  Writes the motor mixer settings to flash memory for persistent storage
+ * @param  motorMixerSettings : Pointer to mixer settings struct to be saved
+ * @retval FLASH_OK if mixer settings written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteMotorMixerSettingsToFlash(const MotorMixerSettings_TypeDef* motorMixerSettings) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write motor mixer settings to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_MOTOR_MIXER, (uint8_t*) motorMixerSettings,
+			sizeof(MotorMixerSettings_TypeDef));
 
-	/* No valid settings values were loaded, perhaps settings has not been stored yet */
-	return FLASH_ERROR;
+	return status;
 }
 
 /*
- * @brief  Writes one page (2048 bytes on STM32F303VC) of data to the flash
- * @param  writeData : pointer to data array, which is to be written to the flash page
- * @param  pageNbr : Specifies flash page
- * @retval FLASH_OK if flash operation successful, else FLASH_ERROR
+ * @brief  Reads previously stored PID gains from flash memory
+ * @param  pidGainSettings : Pointer to PID gain settings struct to which values will enter
+ * @retval FLASH_OK if PID gains read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadPIDGainsFromFlash(PIDGainSettings_TypeDef* pidGainSettings) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read PID gains from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_PID_GAINS, (uint8_t*) pidGainSettings,
+			sizeof(PIDGainSettings_TypeDef));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the PID gains to flash memory for persistent storage
+ * @param  pidGainSettings : Pointer to PID gain settings struct to be saved
+ * @retval FLASH_OK if PID gains written succesfully to flash, else FLASH_ERROR
  */
-static FlashErrorStatus WriteFlashPage(const uint32_t* writeData, const uint8_t pageNbr) {
-	HAL_StatusTypeDef HALStatus = HAL_OK;
+FlashErrorStatus WritePIDGainsToFlash(const PIDGainSettings_TypeDef* pidGainSettings) {
+	FlashErrorStatus status = FLASH_OK;
 
-	/* Unlock the Flash Program Erase controller */
-	HALStatus = HAL_FLASH_Unlock();
+	/* Write PID gains to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_PID_GAINS, (uint8_t*) pidGainSettings,
+			sizeof(PIDGainSettings_TypeDef));
 
-	/* Erase flash page and clear all pending flags before writing to it */
-	FLASH_PageErase(FLASH_BASE_ADDR + pageNbr * FLASH_PAGE_SIZE);
+	return status;
+}
 
-	CLEAR_BIT(FLASH->CR, FLASH_CR_PER); // Needed for flash writing to work (set when page is erased)
+/*
+ * @brief  Reads previously stored UART link settings from flash memory
+ * @param  uartSettings : Pointer to UART settings struct to which values will enter
+ * @retval FLASH_OK if UART settings read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadUartSettingsFromFlash(UartSettings_TypeDef* uartSettings) {
+	FlashErrorStatus status = FLASH_OK;
 
-	/* Program Flash */
-	uint32_t address = FLASH_BASE_ADDR + pageNbr * FLASH_PAGE_SIZE;
-	uint32_t i = 0;
+	/* Read UART settings from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_UART_SETTINGS, (uint8_t*) uartSettings,
+			sizeof(UartSettings_TypeDef));
 
-	while (i < FLASH_PAGE_SIZE / FLASH_WORD_BYTE_SIZE && HALStatus == HAL_OK && IS_VALID_FLASH_ADDR(address)) {
-		if (writeData[i] != ReadFlashWord(pageNbr, i * FLASH_WORD_BYTE_SIZE)) // To prevent unnecessary writing (if byte values should == 0xFF anyway)
-			HALStatus = HAL_FLASH_Program(TYPEPROGRAM_WORD, address, writeData[i]); // Word size is 32 bits/4 bytes => 1 page = 2048 bytes = 512 words
+	return status;
+}
 
-		address += FLASH_WORD_BYTE_SIZE;
-		i++;
-	}
+/*
+ * @brief  Writes the UART link settings to flash memory for persistent storage
+ * @param  uartSettings : Pointer to UART settings struct to be saved
+ * @retval FLASH_OK if UART settings written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteUartSettingsToFlash(const UartSettings_TypeDef* uartSettings) {
+	FlashErrorStatus status = FLASH_OK;
 
-	if (HALStatus != HAL_OK) {
-		HAL_FLASH_Lock();
-		return FLASH_ERROR;
-	}
+	/* Write UART settings to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_UART_SETTINGS, (uint8_t*) uartSettings,
+			sizeof(UartSettings_TypeDef));
 
-	HALStatus = HAL_FLASH_Lock();
+	return status;
+}
 
-	if (HALStatus != HAL_OK)
-		return FLASH_ERROR;
+/*
+ * @brief  Reads previously stored blackbox settings from flash memory
+ * @param  blackboxSettings : Pointer to blackbox settings struct to which values will enter
+ * @retval FLASH_OK if blackbox settings read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadBlackboxSettingsFromFlash(BlackboxSettings_TypeDef* blackboxSettings) {
+	FlashErrorStatus status = FLASH_OK;
 
-	return FLASH_OK;
+	/* Read blackbox settings from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_BLACKBOX_SETTINGS, (uint8_t*) blackboxSettings,
+			sizeof(BlackboxSettings_TypeDef));
+
+	return status;
 }
 
 /*
- * @brief  Reads one page (2048 bytes on STM32F303VC) of flash memory
- * @param  readData : pointer to the byte array where the read data is stored
- * @param  pageNbr : the flash page number from which data is read
- * @retval FLASH_OK if flash operation successful, else FLASH_ERROR
+ * @brief  Writes the blackbox settings to flash memory for persistent storage
+ * @param  blackboxSettings : Pointer to blackbox settings struct to be saved
+ * @retval FLASH_OK if blackbox settings written succesfully to flash, else FLASH_ERROR
  */
-static FlashErrorStatus ReadFlashPage(uint8_t * readData, const uint8_t pageNbr) {
-	uint32_t i = 0;
-	uint32_t address = FLASH_BASE_ADDR + pageNbr * FLASH_PAGE_SIZE;
+FlashErrorStatus WriteBlackboxSettingsToFlash(const BlackboxSettings_TypeDef* blackboxSettings) {
+	FlashErrorStatus status = FLASH_OK;
 
-	if (!IS_VALID_FLASH_ADDR(address))
-		return FLASH_ERROR;
+	/* Write blackbox settings to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_BLACKBOX_SETTINGS, (uint8_t*) blackboxSettings,
+			sizeof(BlackboxSettings_TypeDef));
 
-	while (i < FLASH_PAGE_SIZE) {
-		readData[i] = *((uint8_t *) address);
-		address++;
-		i++;
-	}
+	return status;
+}
 
-	return FLASH_OK;
+/*
+ * @brief  Reads the previously stored crash dump from flash memory
+ * @param  crashDump : Pointer to crash dump struct to which the dump will enter
+ * @retval FLASH_OK if crash dump read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadCrashDumpFromFlash(CrashDump_TypeDef* crashDump) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read crash dump from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_CRASH_DUMP, (uint8_t*) crashDump, sizeof(CrashDump_TypeDef));
+
+	return status;
 }
 
 /*
- * @brief  Reads one word (32 bits/4 bytes) of flash memory from flash
- * @param  pageNbr : flash page number
- * @param  pageOffset : offset from pageNbr base (in bytes)
- * @retval word value as an unsigned 32-bit integer
+ * @brief  Writes a crash dump to flash memory for persistent storage
+ * @param  crashDump : Pointer to crash dump struct to be saved
+ * @retval FLASH_OK if crash dump written succesfully to flash, else FLASH_ERROR
  */
-static uint32_t ReadFlashWord(const uint8_t pageNbr, const uint16_t pageOffset) {
-	uint32_t address = FLASH_BASE_ADDR + pageNbr * FLASH_PAGE_SIZE + pageOffset;
+FlashErrorStatus WriteCrashDumpToFlash(const CrashDump_TypeDef* crashDump) {
+	FlashErrorStatus status = FLASH_OK;
 
-	/* Check flash address validity */
-	if (!IS_VALID_FLASH_ADDR(address))
-		return 0xFFFFFFFF;
+	/* Write crash dump to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_CRASH_DUMP, (uint8_t*) crashDump, sizeof(CrashDump_TypeDef));
 
-	return *((uint32_t *) address);
+	return status;
 }
 
 /*
- * @brief  Reads a specifiable amount of bytes from the flash memory starting from startAddr
- * @param  readData : pointer to the byte array where the read bytes are stored
- * @param  startAddr : start read address in flash
- * @param  nbrOfBytes : Number of bytes to be read
- * @retval FLASH_OK if flash operation successful, else FLASH_ERROR
+ * @brief  Reads the previously stored sensor noise characterisation from flash memory
+ * @param  sensorNoise : Pointer to characterisation struct to which values will enter
+ * @retval FLASH_OK if characterisation read succesfully from flash, else FLASH_ERROR
  */
-static FlashErrorStatus ReadFlashBytes(uint8_t * readData, const uint32_t startAddr, const uint32_t nbrOfBytes) {
-	uint32_t i = 0;
-	uint32_t address = startAddr;
+FlashErrorStatus ReadSensorNoiseFromFlash(SensorNoiseType* sensorNoise) {
+	FlashErrorStatus status = FLASH_OK;
 
-	while (i < nbrOfBytes && IS_VALID_FLASH_ADDR(address)) {
-		readData[i] = *((uint8_t *) address);
-		address++;
-		i++;
-	}
+	/* Read sensor noise characterisation from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_SENSOR_NOISE, (uint8_t*) sensorNoise, sizeof(SensorNoiseType));
 
-	if (i < nbrOfBytes - 1)
-		return FLASH_ERROR;
+	return status;
+}
 
-	return FLASH_OK;
+/*
+ * @brief  Writes a sensor noise characterisation to flash memory for persistent storage
+ * @param  sensorNoise : Pointer to characterisation struct to be saved
+ * @retval FLASH_OK if characterisation written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteSensorNoiseToFlash(const SensorNoiseType* sensorNoise) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write sensor noise characterisation to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_SENSOR_NOISE, (uint8_t*) sensorNoise, sizeof(SensorNoiseType));
+
+	return status;
+}
+
+/*
+ * @brief  Reads the previously stored stick curves from flash memory
+ * @param  stickCurves : Pointer to settings struct to which values will enter
+ * @retval FLASH_OK if curves read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadStickCurvesFromFlash(StickCurveSettingsType* stickCurves) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read stick curves from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_STICK_CURVES, (uint8_t*) stickCurves, sizeof(StickCurveSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the stick curves to flash memory for persistent storage
+ * @param  stickCurves : Pointer to settings struct to be saved
+ * @retval FLASH_OK if curves written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteStickCurvesToFlash(const StickCurveSettingsType* stickCurves) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write stick curves to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_STICK_CURVES, (uint8_t*) stickCurves, sizeof(StickCurveSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Reads the motor thrust curves from flash memory
+ * @param  thrustCurves : Pointer to settings struct to which values will enter
+ * @retval FLASH_OK if curves read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadThrustCurvesFromFlash(ThrustCurveSettingsType* thrustCurves) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read thrust curves from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_THRUST_CURVES, (uint8_t*) thrustCurves, sizeof(ThrustCurveSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the motor thrust curves to flash memory for persistent storage
+ * @param  thrustCurves : Pointer to settings struct to be saved
+ * @retval FLASH_OK if curves written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteThrustCurvesToFlash(const ThrustCurveSettingsType* thrustCurves) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write thrust curves to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_THRUST_CURVES, (uint8_t*) thrustCurves, sizeof(ThrustCurveSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Reads the PID gain schedule tables from flash memory
+ * @param  pidGainSchedule : Pointer to settings struct to which values will enter
+ * @retval FLASH_OK if tables read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadPIDGainScheduleFromFlash(PIDGainSchedule_TypeDef* pidGainSchedule) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read gain schedule tables from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_PID_GAIN_SCHEDULE, (uint8_t*) pidGainSchedule,
+			sizeof(PIDGainSchedule_TypeDef));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the PID gain schedule tables to flash memory for persistent storage
+ * @param  pidGainSchedule : Pointer to settings struct to be saved
+ * @retval FLASH_OK if tables written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WritePIDGainScheduleToFlash(const PIDGainSchedule_TypeDef* pidGainSchedule) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write gain schedule tables to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_PID_GAIN_SCHEDULE, (uint8_t*) pidGainSchedule,
+			sizeof(PIDGainSchedule_TypeDef));
+
+	return status;
+}
+
+/*
+ * @brief  Reads previously stored PID setpoint feed-forwards from flash memory
+ * @param  pidFeedForwardSettings : Pointer to settings struct to which values will enter
+ * @retval FLASH_OK if feed-forwards read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadPIDFeedForwardFromFlash(PIDFeedForwardSettings_TypeDef* pidFeedForwardSettings) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read PID feed-forwards from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_PID_FEED_FORWARD, (uint8_t*) pidFeedForwardSettings,
+			sizeof(PIDFeedForwardSettings_TypeDef));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the PID setpoint feed-forwards to flash memory for persistent storage
+ * @param  pidFeedForwardSettings : Pointer to settings struct to be saved
+ * @retval FLASH_OK if feed-forwards written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WritePIDFeedForwardToFlash(const PIDFeedForwardSettings_TypeDef* pidFeedForwardSettings) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write PID feed-forwards to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_PID_FEED_FORWARD, (uint8_t*) pidFeedForwardSettings,
+			sizeof(PIDFeedForwardSettings_TypeDef));
+
+	return status;
+}
+
+/*
+ * @brief  Reads the ESC pulse widths from flash memory
+ * @param  escOutputs : Pointer to settings struct to which values will enter
+ * @retval FLASH_OK if pulse widths read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadEscOutputsFromFlash(EscOutputsType* escOutputs) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read ESC pulse widths from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_ESC_OUTPUTS, (uint8_t*) escOutputs, sizeof(EscOutputsType));
+
+	return status;
 }
 
 /*
- * @brief  Calculates the flash address corresponding to input page and offset from page base
- * @param  pageNbr : page number
- * @param  pageOffset : byte offset from page base
- * @retval Flash address
+ * @brief  Writes the ESC pulse widths to flash memory for persistent storage
+ * @param  escOutputs : Pointer to settings struct to be saved
+ * @retval FLASH_OK if pulse widths written succesfully to flash, else FLASH_ERROR
  */
-static uint32_t GetFlashPageOffsetAddress(const uint8_t pageNbr, const uint16_t pageOffset) {
-	return FLASH_BASE_ADDR + pageNbr * FLASH_PAGE_SIZE + pageOffset;
+FlashErrorStatus WriteEscOutputsToFlash(const EscOutputsType* escOutputs) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write ESC pulse widths to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_ESC_OUTPUTS, (uint8_t*) escOutputs, sizeof(EscOutputsType));
+
+	return status;
+}
+
+/*
+ * @brief  Reads the crash detection settings from flash memory
+ * @param  crashDetectionSettings : Pointer to settings struct to which values will enter
+ * @retval FLASH_OK if settings read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadCrashDetectionSettingsFromFlash(CrashDetectionSettingsType* crashDetectionSettings) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read crash detection settings from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_CRASH_DETECTION, (uint8_t*) crashDetectionSettings,
+			sizeof(CrashDetectionSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the crash detection settings to flash memory for persistent storage
+ * @param  crashDetectionSettings : Pointer to settings struct to be saved
+ * @retval FLASH_OK if settings written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteCrashDetectionSettingsToFlash(const CrashDetectionSettingsType* crashDetectionSettings) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write crash detection settings to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_CRASH_DETECTION, (uint8_t*) crashDetectionSettings,
+			sizeof(CrashDetectionSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Reads the sensor board mounting rotation and level trim from flash memory
+ * @param  sensorOrientationSettings : Pointer to settings struct to which values will enter
+ * @retval FLASH_OK if settings read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadSensorOrientationSettingsFromFlash(FcbSensorOrientationSettingsType* sensorOrientationSettings) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read sensor orientation settings from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_SENSOR_ORIENTATION, (uint8_t*) sensorOrientationSettings,
+			sizeof(FcbSensorOrientationSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the sensor board mounting rotation and level trim to flash memory for persistent storage
+ * @param  sensorOrientationSettings : Pointer to settings struct to be saved
+ * @retval FLASH_OK if settings written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteSensorOrientationSettingsToFlash(
+		const FcbSensorOrientationSettingsType* sensorOrientationSettings) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write sensor orientation settings to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_SENSOR_ORIENTATION, (uint8_t*) sensorOrientationSettings,
+			sizeof(FcbSensorOrientationSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Reads the accelerometer and magnetometer temperature compensation points from flash memory
+ * @param  compensation : Pointer to compensation struct to which values will enter
+ * @retval FLASH_OK if compensation read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadAccMagTempCompensationFromFlash(FcbAccMagTempCompensationType* compensation) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read acc/mag temperature compensation from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_ACCMAG_TEMP_COMPENSATION, (uint8_t*) compensation,
+			sizeof(FcbAccMagTempCompensationType));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the accelerometer and magnetometer temperature compensation points to flash memory for persistent
+ *         storage
+ * @param  compensation : Pointer to compensation struct to be saved
+ * @retval FLASH_OK if compensation written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteAccMagTempCompensationToFlash(const FcbAccMagTempCompensationType* compensation) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write acc/mag temperature compensation to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_ACCMAG_TEMP_COMPENSATION, (uint8_t*) compensation,
+			sizeof(FcbAccMagTempCompensationType));
+
+	return status;
+}
+
+/*
+ * @brief  Reads the RC smoothing settings from flash memory
+ * @param  rcSmoothingSettings : Pointer to settings struct to which values will enter
+ * @retval FLASH_OK if settings read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadRcSmoothingSettingsFromFlash(RcSmoothingSettingsType* rcSmoothingSettings) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read RC smoothing settings from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_RC_SMOOTHING, (uint8_t*) rcSmoothingSettings,
+			sizeof(RcSmoothingSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the RC smoothing settings to flash memory for persistent storage
+ * @param  rcSmoothingSettings : Pointer to settings struct to be saved
+ * @retval FLASH_OK if settings written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteRcSmoothingSettingsToFlash(const RcSmoothingSettingsType* rcSmoothingSettings) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write RC smoothing settings to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_RC_SMOOTHING, (uint8_t*) rcSmoothingSettings,
+			sizeof(RcSmoothingSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Reads the receiver channel map and mode ranges from flash
+ * @param  channelMap : Pointer to channel map struct to which values will enter
+ * @retval FLASH_OK if valid values read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadReceiverChannelMapFromFlash(Receiver_ChannelMap_TypeDef* channelMap) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read receiver channel map from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_RECEIVER_CHANNEL_MAP, (uint8_t*) channelMap,
+			sizeof(Receiver_ChannelMap_TypeDef));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the receiver channel map and mode ranges to flash memory for persistent storage
+ * @param  channelMap : Pointer to channel map struct to be saved
+ * @retval FLASH_OK if settings written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteReceiverChannelMapToFlash(const Receiver_ChannelMap_TypeDef* channelMap) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write receiver channel map to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_RECEIVER_CHANNEL_MAP, (uint8_t*) channelMap,
+			sizeof(Receiver_ChannelMap_TypeDef));
+
+	return status;
+}
+
+/*
+ * @brief  Reads the estimator noise parameters from flash
+ * @param  estimatorNoise : Pointer to noise settings struct to which values will enter
+ * @retval FLASH_OK if valid values read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadEstimatorNoiseFromFlash(EstimatorNoiseSettingsType* estimatorNoise) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read estimator noise from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_ESTIMATOR_NOISE, (uint8_t*) estimatorNoise,
+			sizeof(EstimatorNoiseSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the estimator noise parameters to flash memory for persistent storage
+ * @param  estimatorNoise : Pointer to noise settings struct to be saved
+ * @retval FLASH_OK if settings written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteEstimatorNoiseToFlash(const EstimatorNoiseSettingsType* estimatorNoise) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write estimator noise to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_ESTIMATOR_NOISE, (uint8_t*) estimatorNoise,
+			sizeof(EstimatorNoiseSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Reads the magnetometer heading settings from flash
+ * @param  magHeadingSettings : Pointer to heading settings struct to which values will enter
+ * @retval FLASH_OK if valid values read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadMagHeadingSettingsFromFlash(MagHeadingSettingsType* magHeadingSettings) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read heading settings from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_MAG_HEADING, (uint8_t*) magHeadingSettings,
+			sizeof(MagHeadingSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the magnetometer heading settings to flash memory for persistent storage
+ * @param  magHeadingSettings : Pointer to heading settings struct to be saved
+ * @retval FLASH_OK if settings written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteMagHeadingSettingsToFlash(const MagHeadingSettingsType* magHeadingSettings) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write heading settings to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_MAG_HEADING, (uint8_t*) magHeadingSettings,
+			sizeof(MagHeadingSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Reads the sensor data rate and bandwidth settings from flash
+ * @param  sensorTimingSettings : Pointer to sensor timing settings struct to which values will enter
+ * @retval FLASH_OK if valid values read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadSensorTimingSettingsFromFlash(FcbSensorTimingSettingsType* sensorTimingSettings) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read sensor timing settings from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_SENSOR_TIMING, (uint8_t*) sensorTimingSettings,
+			sizeof(FcbSensorTimingSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the sensor data rate and bandwidth settings to flash memory for persistent storage
+ * @param  sensorTimingSettings : Pointer to sensor timing settings struct to be saved
+ * @retval FLASH_OK if settings written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteSensorTimingSettingsToFlash(const FcbSensorTimingSettingsType* sensorTimingSettings) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write sensor timing settings to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_SENSOR_TIMING, (uint8_t*) sensorTimingSettings,
+			sizeof(FcbSensorTimingSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Reads the motor failure detection settings from flash memory
+ * @param  motorFailureSettings : Pointer to settings struct to which values will enter
+ * @retval FLASH_OK if settings read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadMotorFailureSettingsFromFlash(MotorFailureSettingsType* motorFailureSettings) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read motor failure detection settings from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_MOTOR_FAILURE, (uint8_t*) motorFailureSettings,
+			sizeof(MotorFailureSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the motor failure detection settings to flash memory for persistent storage
+ * @param  motorFailureSettings : Pointer to settings struct to be saved
+ * @retval FLASH_OK if settings written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteMotorFailureSettingsToFlash(const MotorFailureSettingsType* motorFailureSettings) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write motor failure detection settings to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_MOTOR_FAILURE, (uint8_t*) motorFailureSettings,
+			sizeof(MotorFailureSettingsType));
+
+	return status;
+}
+
+/*
+ * @brief  Reads the previously stored flight odometer from flash memory
+ * @param  odometer : Pointer to odometer struct to which values will enter
+ * @retval FLASH_OK if the odometer read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadOdometerFromFlash(EventJournalOdometerType* odometer) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read the odometer from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_ODOMETER, (uint8_t*) odometer, sizeof(EventJournalOdometerType));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the flight odometer to flash memory for persistent storage
+ * @param  odometer : Pointer to odometer struct to be saved
+ * @retval FLASH_OK if the odometer written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteOdometerToFlash(const EventJournalOdometerType* odometer) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write the odometer to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_ODOMETER, (uint8_t*) odometer, sizeof(EventJournalOdometerType));
+
+	return status;
+}
+
+/*
+ * @brief  Reads the previously stored motor mixer allocation settings from flash memory
+ * @param  mixerAllocation : Pointer to settings struct to which values will enter
+ * @retval FLASH_OK if settings read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadMixerAllocationFromFlash(MotorMixerAllocation_TypeDef* mixerAllocation) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read the allocation priority and motor command limits from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_MIXER_ALLOCATION, (uint8_t*) mixerAllocation,
+			sizeof(MotorMixerAllocation_TypeDef));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the motor mixer allocation settings to flash memory for persistent storage
+ * @param  mixerAllocation : Pointer to settings struct to be saved
+ * @retval FLASH_OK if settings written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteMixerAllocationToFlash(const MotorMixerAllocation_TypeDef* mixerAllocation) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write the allocation priority and motor command limits to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_MIXER_ALLOCATION, (uint8_t*) mixerAllocation,
+			sizeof(MotorMixerAllocation_TypeDef));
+
+	return status;
+}
+
+/*
+ * @brief  Reads the previously stored performance baseline from flash memory
+ * @param  perfBaseline : Pointer to baseline struct to which values will enter
+ * @retval FLASH_OK if baseline read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadPerfBaselineFromFlash(PerfBaseline_TypeDef* perfBaseline) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Read the baseline snapshot and its firmware image CRC from flash, if valid data exists */
+	status = ReadSettingsFromFlash(FLASH_KEY_PERF_BASELINE, (uint8_t*) perfBaseline, sizeof(PerfBaseline_TypeDef));
+
+	return status;
+}
+
+/*
+ * @brief  Writes the performance baseline to flash memory for persistent storage
+ * @param  perfBaseline : Pointer to baseline struct to be saved
+ * @retval FLASH_OK if baseline written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WritePerfBaselineToFlash(const PerfBaseline_TypeDef* perfBaseline) {
+	FlashErrorStatus status = FLASH_OK;
+
+	/* Write the baseline snapshot and its firmware image CRC to flash */
+	status = WriteSettingsToFlash(FLASH_KEY_PERF_BASELINE, (uint8_t*) perfBaseline, sizeof(PerfBaseline_TypeDef));
+
+	return status;
+}
+
+/*
+ * @brief  Reads a parameter profile from the profiles page
+ * @param  profileIdx : Profile index, below PARAM_PROFILE_NBR
+ * @param  profile : Pointer to profile struct to which values will enter
+ * @retval FLASH_OK if a valid profile read succesfully from flash, else FLASH_ERROR
+ */
+FlashErrorStatus ReadParamProfileFromFlash(const uint8_t profileIdx, ParamProfileType* profile) {
+	uint32_t recordAddr;
+	bool isValid;
+
+	if (profileIdx >= PARAM_PROFILE_NBR)
+		return FLASH_ERROR;
+
+	/* A slot of another profile size, e.g. of a previous firmware, is not valid */
+	recordAddr = PROFILE_RECORD_ADDR(profileIdx);
+	LockSettingsStore();
+	isValid = PROFILE_RECORD_HEADER(profileIdx) == FLASH_WORD(recordAddr)
+			&& IsValidRecord(recordAddr);
+	UnlockSettingsStore();
+
+	if (!isValid)
+		return FLASH_ERROR;
+
+	memcpy(profile, (const uint8_t*) (recordAddr + STORE_RECORD_HEADER_SIZE), sizeof(ParamProfileType));
+
+	return FLASH_OK;
+}
+
+/*
+ * @brief  Writes all parameter profiles to the profiles page, which is erased first. The CPU stalls for the whole
+ *         erase, so this is for idle mode only.
+ * @param  profiles : Profiles to be saved
+ * @param  isProfileValid : Which profiles to save, the slots of the others are left erased
+ * @retval FLASH_OK if profiles written succesfully to flash, else FLASH_ERROR
+ */
+FlashErrorStatus WriteParamProfilesToFlash(const ParamProfileType profiles[PARAM_PROFILE_NBR],
+		const bool isProfileValid[PARAM_PROFILE_NBR]) {
+	FlashErrorStatus status;
+	uint32_t recordAddr;
+	uint32_t header;
+	uint32_t crc;
+	uint8_t i;
+
+	LockSettingsStore();
+
+	status = EraseFlashPage(FLASH_PROFILES_START_ADDR);
+
+	/* The CRC word is programmed last, as for the store records */
+	for (i = 0; i < PARAM_PROFILE_NBR && FLASH_OK == status; i++) {
+		if (!isProfileValid[i])
+			continue;
+
+		recordAddr = PROFILE_RECORD_ADDR(i);
+		header = PROFILE_RECORD_HEADER(i);
+		crc = CalculateRecordCRC(header, (const uint8_t*) &profiles[i], sizeof(ParamProfileType));
+
+		status = ProgramFlashWords(recordAddr, (const uint8_t*) &header, STORE_RECORD_HEADER_SIZE);
+		if (FLASH_OK == status)
+			status = ProgramFlashWords(recordAddr + STORE_RECORD_HEADER_SIZE, (const uint8_t*) &profiles[i],
+					sizeof(ParamProfileType));
+		if (FLASH_OK == status)
+			status = ProgramFlashWords(recordAddr + PROFILE_RECORD_SIZE - STORE_RECORD_CRC_SIZE, (const uint8_t*) &crc,
+					STORE_RECORD_CRC_SIZE);
+	}
+
+	UnlockSettingsStore();
+
+	return status;
+}
+
+/*
+ * @brief  Starts a settings batch. The settings written until EndFlashSettingsBatch() are queued to the flash writer
+ *         together, so that they are programmed after at most one page compaction, or not at all if the batch is
+ *         aborted.
+ * @param  None
+ * @retval FLASH_OK if started, FLASH_ERROR if a batch is already active
+ */
+FlashErrorStatus StartFlashSettingsBatch(void) {
+	FlashErrorStatus status = FLASH_OK;
+
+	LockSettingsStore();
+
+	if (isSettingsBatchActive) {
+		status = FLASH_ERROR;
+	} else {
+		isSettingsBatchActive = true;
+		pendingBatchOffset = pendingRecordsSize;
+	}
+
+	UnlockSettingsStore();
+
+	return status;
+}
+
+/*
+ * @brief  Ends a settings batch and queues the settings written since StartFlashSettingsBatch() to the flash writer.
+ *         Without the flash writer they are written to flash directly.
+ * @param  None
+ * @retval FLASH_OK if queued or written, FLASH_ERROR if no batch is active or if writing the flash failed
+ */
+FlashErrorStatus EndFlashSettingsBatch(void) {
+	uint16_t offset;
+	uint16_t removedSize;
+	uint32_t header;
+
+	LockSettingsStore();
+
+	if (!isSettingsBatchActive) {
+		UnlockSettingsStore();
+		return FLASH_ERROR;
+	}
+
+	/* The batch records replace the ones of the same keys queued before the batch */
+	offset = pendingBatchOffset;
+	while (offset < pendingRecordsSize) {
+		memcpy(&header, &pendingRecords[offset], STORE_RECORD_HEADER_SIZE);
+		removedSize = RemovePendingRecord((FlashSettingsKey) STORE_RECORD_KEY(header), 0, pendingBatchOffset);
+		offset += STORE_RECORD_SIZE(STORE_RECORD_DATA_SIZE(header)) - removedSize;
+	}
+
+	isSettingsBatchActive = false;
+
+	UnlockSettingsStore();
+
+	if (DEFERRED_WORK_INVALID_ID == flashWriterWorkId)
+		return FlushPendingRecords();
+
+	WakeFlashWriter();
+
+	return FLASH_OK;
+}
+
+/*
+ * @brief  Ends a settings batch without writing the settings written since StartFlashSettingsBatch()
+ * @param  None
+ * @retval None
+ */
+void AbortFlashSettingsBatch(void) {
+	LockSettingsStore();
+
+	if (isSettingsBatchActive) {
+		isSettingsBatchActive = false;
+		pendingRecordsSize = pendingBatchOffset;
+		calibrationWriteCount++;
+	}
+
+	UnlockSettingsStore();
+}
+
+/*
+ * @brief  Checks if settings are queued to the flash writer, which programs them once flight control is idle. Read
+ *         without locks, the size is a single halfword.
+ * @param  None
+ * @retval true if settings are waiting to be programmed, else false
+ */
+bool IsFlashWritePending(void) {
+	return 0 != pendingRecordsSize;
+}
+
+/*
+ * @brief  Gets the count of calibration record writes, which changes whenever a calibration may have been stored or
+ *         dropped since the previous call. Read without locks, the count is a single word.
+ * @param  None
+ * @retval Count since startup
+ */
+uint32_t GetFlashCalibrationWriteCount(void) {
+	return calibrationWriteCount;
+}
+
+/*
+ * @brief  Erases a page of the flight data log area. The CPU stalls for the whole erase, so this is for idle mode only.
+ * @param  pageIdx : Page index in the log area
+ * @retval FLASH_OK if erased, else FLASH_ERROR
+ */
+FlashErrorStatus EraseFlashLogPage(const uint16_t pageIdx) {
+	FlashErrorStatus status;
+
+	if (pageIdx >= FLASH_LOG_NBR_OF_PAGES)
+		return FLASH_ERROR;
+
+	/* Kept apart from the settings store writes, which also unlock and lock the flash */
+	LockSettingsStore();
+	status = EraseFlashPage(FLASH_LOG_START_ADDR + pageIdx * FLASH_PAGE_SIZE);
+	UnlockSettingsStore();
+
+	return status;
+}
+
+/*
+ * @brief  Programs an erased word of the flight data log area. The CPU stalls for one word only, the critical section
+ *         keeps other flash users out for that long, so this may be done in flight between control cycles.
+ * @param  offset : Word aligned byte offset in the log area
+ * @param  word : Word to program
+ * @retval FLASH_OK if programmed, else FLASH_ERROR
+ */
+FlashErrorStatus ProgramFlashLogWord(const uint32_t offset, const uint32_t word) {
+	uint32_t flashStatus;
+
+	if (offset > FLASH_LOG_SIZE - FLASH_WORD_BYTE_SIZE || 0 != (offset & (FLASH_WORD_BYTE_SIZE - 1)))
+		return FLASH_ERROR;
+
+	taskENTER_CRITICAL();
+	HAL_FLASH_Unlock();
+	flashStatus = ProgramFlashWordFromRAM(FLASH_LOG_START_ADDR + offset, word);
+	HAL_FLASH_Lock();
+	taskEXIT_CRITICAL();
+
+	if (0 != flashStatus || word != FLASH_WORD(FLASH_LOG_START_ADDR + offset))
+		return FLASH_ERROR;
+
+	return FLASH_OK;
+}
+
+/*
+ * @brief  Erases a page of the event journal area. The CPU stalls while the page is erased, so this is only done in
+ *         idle mode.
+ * @param  pageIdx : Page index in the journal area, below FLASH_JOURNAL_NBR_OF_PAGES
+ * @retval FLASH_OK if erased, else FLASH_ERROR
+ */
+FlashErrorStatus EraseFlashJournalPage(const uint16_t pageIdx) {
+	FlashErrorStatus status;
+
+	if (pageIdx >= FLASH_JOURNAL_NBR_OF_PAGES)
+		return FLASH_ERROR;
+
+	LockSettingsStore();
+	status = EraseFlashPage(FLASH_JOURNAL_START_ADDR + pageIdx * FLASH_PAGE_SIZE);
+	UnlockSettingsStore();
+
+	return status;
+}
+
+/*
+ * @brief  Programs an erased word of the event journal area, like ProgramFlashLogWord()
+ * @param  offset : Word aligned byte offset in the journal area
+ * @param  word : Word to program
+ * @retval FLASH_OK if programmed, else FLASH_ERROR
+ */
+FlashErrorStatus ProgramFlashJournalWord(const uint32_t offset, const uint32_t word) {
+	uint32_t flashStatus;
+
+	if (offset > FLASH_JOURNAL_SIZE - FLASH_WORD_BYTE_SIZE || 0 != (offset & (FLASH_WORD_BYTE_SIZE - 1)))
+		return FLASH_ERROR;
+
+	taskENTER_CRITICAL();
+	HAL_FLASH_Unlock();
+	flashStatus = ProgramFlashWordFromRAM(FLASH_JOURNAL_START_ADDR + offset, word);
+	HAL_FLASH_Lock();
+	taskEXIT_CRITICAL();
+
+	if (0 != flashStatus || word != FLASH_WORD(FLASH_JOURNAL_START_ADDR + offset))
+		return FLASH_ERROR;
+
+	return FLASH_OK;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Writes settings to the store as a new record of their key. The record is queued to the flash writer,
+ *         without it the record is programmed directly. Settings equal to the newest record of their key are not
+ *         written again.
+ * @param  key : Settings key
+ * @param  writeSettingsData : uint8_t pointer to settings to be saved
+ * @param  writeSettingsDataSize : writeSettingsData byte size, at most FLASH_SETTINGS_MAX_RECORD_SIZE
+ * @retval FLASH_OK if settings queued or written succesfully to flash, else FLASH_ERROR
+ */
+static FlashErrorStatus WriteSettingsToFlash(const FlashSettingsKey key, const uint8_t* writeSettingsData,
+		const uint16_t writeSettingsDataSize) {
+	FlashErrorStatus status = FLASH_OK;
+	const uint16_t recordSize = STORE_RECORD_SIZE(writeSettingsDataSize);
+	bool isQueued = false;
+	uint32_t crc;
+
+	if (key >= FLASH_KEY_NBR || writeSettingsDataSize > FLASH_SETTINGS_MAX_RECORD_SIZE)
+		return FLASH_ERROR;
+
+	LockSettingsStore();
+
+	if (isStoreInitialized && IsSettingsUnchanged(key, writeSettingsData, writeSettingsDataSize)) {
+		UnlockSettingsStore();
+		return FLASH_OK;
+	}
+
+	crc = CalculateRecordCRC(SETTINGS_RECORD_HEADER(key, writeSettingsDataSize), writeSettingsData,
+			writeSettingsDataSize);
+
+	if (!isStoreInitialized) {
+		status = FLASH_ERROR;
+	} else if (isSettingsBatchActive || DEFERRED_WORK_INVALID_ID != flashWriterWorkId) {
+		status = QueueRecord(key, writeSettingsData, writeSettingsDataSize, crc);
+		isQueued = !isSettingsBatchActive;
+	} else {
+		/* Most writes fit the active page and only program a few words, a full page is compacted first */
+		if (storeWriteOffset + recordSize > FLASH_PAGE_SIZE)
+			status = CompactStore(recordSize);
+
+		if (FLASH_OK == status)
+			status = AppendRecord(SETTINGS_RECORD_HEADER(key, writeSettingsDataSize), writeSettingsData, crc);
+	}
+
+	if (FLASH_OK == status && IsCalibrationKey(key))
+		calibrationWriteCount++;
+
+	UnlockSettingsStore();
+
+	if (FLASH_OK == status && isQueued)
+		WakeFlashWriter();
+
+	if (FLASH_OK == status && IsCalibrationKey(key))
+		EventJournalRecord(EVENT_JOURNAL_CALIBRATION, (uint8_t) key, 0);
+
+	return status;
+}
+
+/*
+ * @brief  Reads settings from the newest record of their key, a queued one or else the indexed one in the store. The
+ *         records were CRC checked when indexed or queued, so they are only copied. The records of an active batch
+ *         are read once it has ended.
+ * @param  key : Settings key
+ * @param  readSettingsData : uint8_t pointer to which the settings are read
+ * @param  readSettingsDataSize : readSettingsData byte size, which must be the stored size
+ * @retval FLASH_OK if settings read succesfully, else FLASH_ERROR, e.g. if the settings have not been stored yet
+ */
+static FlashErrorStatus ReadSettingsFromFlash(const FlashSettingsKey key, uint8_t* readSettingsData,
+		const uint16_t readSettingsDataSize) {
+	FlashErrorStatus status = FLASH_ERROR;
+	int32_t offset;
+	uint32_t header;
+
+	if (key >= FLASH_KEY_NBR || readSettingsDataSize != settingsSizes[key])
+		return FLASH_ERROR;
+
+	LockSettingsStore();
+
+	offset = FindPendingRecord(key, 0, isSettingsBatchActive ? pendingBatchOffset : pendingRecordsSize);
+	if (offset >= 0) {
+		memcpy(&header, &pendingRecords[offset], STORE_RECORD_HEADER_SIZE);
+		if (CopyRecordSettings(key, header, &pendingRecords[offset + STORE_RECORD_HEADER_SIZE], readSettingsData))
+			status = FLASH_OK;
+	} else if (0 != settingsIndex[key]) {
+		if (CopyRecordSettings(key, FLASH_WORD(settingsIndex[key]),
+				(const uint8_t*) (settingsIndex[key] + STORE_RECORD_HEADER_SIZE), readSettingsData))
+			status = FLASH_OK;
+	}
+
+	UnlockSettingsStore();
+
+	return status;
+}
+
+/*
+ * @brief  Programs the queued settings records to flash. Erasing and programming the flash stalls the CPU on
+ *         instruction fetches, including the flight control loop and the sensor interrupts, so it is only done while
+ *         flight control is idle, i.e. disarmed.
+ * @param  argument : Unused
+ * @retval None
+ */
+static void FlashWriterWork(void* argument) {
+	(void) argument;
+
+	/* The WCET test holds the records as in flight, its load runs in idle mode */
+	if (FLIGHT_CONTROL_IDLE == GetFlightControlMode() && !WCET_TEST_IS_ACTIVE() && 0 != pendingRecordsSize)
+		FlushPendingRecords();
+}
+
+/*
+ * @brief  Posts the flash writer while records are pending, so that the records queued in flight are programmed once
+ *         flight control is idle again. Runs in the 1 Hz rate group.
+ * @param  argument : Unused
+ * @retval None
+ */
+static void FlashWriterCheck(void* argument) {
+	(void) argument;
+
+	if (0 != pendingRecordsSize)
+		WakeFlashWriter();
+}
+
+/*
+ * @brief  Programs the queued records before an active batch to the store, compacting the store first if they do not
+ *         fit the active page. The records are programmed one at a time, with the store unlocked in between. Records
+ *         that fail to be programmed are dropped rather than retried, so that a failing page is not erased over and
+ *         over.
+ * @param  None
+ * @retval FLASH_OK if programmed, else FLASH_ERROR
+ */
+static FlashErrorStatus FlushPendingRecords(void) {
+	FlashErrorStatus status = FLASH_OK;
+	uint16_t flushSize;
+	uint16_t recordSize;
+	uint32_t header;
+	uint32_t crc;
+
+	LockSettingsStore();
+
+	flushSize = isSettingsBatchActive ? pendingBatchOffset : pendingRecordsSize;
+	if (storeWriteOffset + flushSize > FLASH_PAGE_SIZE)
+		status = CompactStore(flushSize);
+
+	UnlockSettingsStore();
+
+	for (;;) {
+		LockSettingsStore();
+
+		if (0 == (isSettingsBatchActive ? pendingBatchOffset : pendingRecordsSize)) {
+			UnlockSettingsStore();
+			break;
+		}
+
+		memcpy(&header, &pendingRecords[0], STORE_RECORD_HEADER_SIZE);
+		recordSize = STORE_RECORD_SIZE(STORE_RECORD_DATA_SIZE(header));
+		memcpy(&crc, &pendingRecords[recordSize - STORE_RECORD_CRC_SIZE], STORE_RECORD_CRC_SIZE);
+
+		/* Records queued after the compaction may not fit, they are left for the next flush */
+		if (FLASH_OK == status && storeWriteOffset + recordSize > FLASH_PAGE_SIZE) {
+			UnlockSettingsStore();
+			WakeFlashWriter();
+			break;
+		}
+
+		if (FLASH_OK != status
+				|| FLASH_OK != AppendRecord(header, &pendingRecords[STORE_RECORD_HEADER_SIZE], crc))
+			status = FLASH_ERROR;
+
+		RemovePendingRecord((FlashSettingsKey) STORE_RECORD_KEY(header), 0, recordSize);
+
+		UnlockSettingsStore();
+	}
+
+	return status;
+}
+
+/*
+ * @brief  Queues a record to the flash writer, replacing a queued record of the same key. In a batch, only records of
+ *         the batch are replaced. Called with the store locked.
+ * @param  key : Settings key
+ * @param  data : Record data
+ * @param  dataSize : data byte size
+ * @param  crc : Record CRC, see CalculateRecordCRC()
+ * @retval FLASH_OK if queued, FLASH_ERROR if the queue is full
+ */
+static FlashErrorStatus QueueRecord(const FlashSettingsKey key, const uint8_t* data, const uint16_t dataSize,
+		const uint32_t crc) {
+	const uint16_t recordSize = STORE_RECORD_SIZE(dataSize);
+	const uint32_t header = SETTINGS_RECORD_HEADER(key, dataSize);
+
+	RemovePendingRecord(key, isSettingsBatchActive ? pendingBatchOffset : 0, pendingRecordsSize);
+
+	if (pendingRecordsSize + recordSize > sizeof(pendingRecords))
+		return FLASH_ERROR;
+
+	memset(&pendingRecords[pendingRecordsSize], 0xFF, recordSize);
+	memcpy(&pendingRecords[pendingRecordsSize], &header, STORE_RECORD_HEADER_SIZE);
+	memcpy(&pendingRecords[pendingRecordsSize + STORE_RECORD_HEADER_SIZE], data, dataSize);
+	memcpy(&pendingRecords[pendingRecordsSize + recordSize - STORE_RECORD_CRC_SIZE], &crc, STORE_RECORD_CRC_SIZE);
+	pendingRecordsSize += recordSize;
+
+	return FLASH_OK;
+}
+
+/*
+ * @brief  Removes the queued record of a key within an offset range, moving the later records down. Called with the
+ *         store locked.
+ * @param  key : Settings key
+ * @param  fromOffset : First offset of the range, at a record
+ * @param  toOffset : End offset of the range, at a record or the end of the queue
+ * @retval Byte size of the removed record, 0 if there was none
+ */
+static uint16_t RemovePendingRecord(const FlashSettingsKey key, const uint16_t fromOffset, const uint16_t toOffset) {
+	int32_t offset = FindPendingRecord(key, fromOffset, toOffset);
+	uint16_t recordSize;
+	uint32_t header;
+
+	if (offset < 0)
+		return 0;
+
+	memcpy(&header, &pendingRecords[offset], STORE_RECORD_HEADER_SIZE);
+	recordSize = STORE_RECORD_SIZE(STORE_RECORD_DATA_SIZE(header));
+
+	memmove(&pendingRecords[offset], &pendingRecords[offset + recordSize],
+			pendingRecordsSize - offset - recordSize);
+	pendingRecordsSize -= recordSize;
+	if (isSettingsBatchActive && offset < pendingBatchOffset)
+		pendingBatchOffset -= recordSize;
+
+	return recordSize;
+}
+
+/*
+ * @brief  Finds the queued record of a key within an offset range. Called with the store locked.
+ * @param  key : Settings key
+ * @param  fromOffset : First offset of the range, at a record
+ * @param  toOffset : End offset of the range, at a record or the end of the queue
+ * @retval Offset of the record, -1 if there is none
+ */
+static int32_t FindPendingRecord(const FlashSettingsKey key, const uint16_t fromOffset, const uint16_t toOffset) {
+	uint16_t offset = fromOffset;
+	uint32_t header;
+
+	while (offset < toOffset) {
+		memcpy(&header, &pendingRecords[offset], STORE_RECORD_HEADER_SIZE);
+		if (key == STORE_RECORD_KEY(header))
+			return offset;
+
+		offset += STORE_RECORD_SIZE(STORE_RECORD_DATA_SIZE(header));
+	}
+
+	return -1;
+}
+
+/*
+ * @brief  Checks if settings equal the newest record of their key, queued or in the store, so that they need not be
+ *         written. In a batch, the records of the batch are the newest ones. Called with the store locked.
+ * @param  key : Settings key
+ * @param  data : Settings data
+ * @param  dataSize : data byte size
+ * @retval true if unchanged, else false
+ */
+static bool IsSettingsUnchanged(const FlashSettingsKey key, const uint8_t* data, const uint16_t dataSize) {
+	const uint32_t header = SETTINGS_RECORD_HEADER(key, dataSize);
+	int32_t offset = -1;
+
+	if (isSettingsBatchActive)
+		offset = FindPendingRecord(key, pendingBatchOffset, pendingRecordsSize);
+	if (offset < 0)
+		offset = FindPendingRecord(key, 0, isSettingsBatchActive ? pendingBatchOffset : pendingRecordsSize);
+
+	if (offset >= 0)
+		return 0 == memcmp(&pendingRecords[offset], &header, STORE_RECORD_HEADER_SIZE)
+				&& 0 == memcmp(&pendingRecords[offset + STORE_RECORD_HEADER_SIZE], data, dataSize);
+
+	return 0 != settingsIndex[key] && header == FLASH_WORD(settingsIndex[key])
+			&& 0 == memcmp((const uint8_t*) (settingsIndex[key] + STORE_RECORD_HEADER_SIZE), data, dataSize);
+}
+
+/*
+ * @brief  Copies the settings of a record to the current settings struct of their key. A record of a previous version
+ *         of the struct is migrated. Records of an unknown version or of another size than the settings struct, e.g.
+ *         saved by a newer version, are not read, as with a CRC mismatch.
+ * @param  key : Settings key
+ * @param  header : Record header
+ * @param  data : Record data
+ * @param  dstData : Destination of the current settings struct
+ * @retval true if copied, else false
+ */
+static bool CopyRecordSettings(const FlashSettingsKey key, const uint32_t header, const uint8_t* data,
+		uint8_t* dstData) {
+	if (settingsVersions[key] == STORE_RECORD_VERSION(header)) {
+		if (STORE_RECORD_DATA_SIZE(header) != settingsSizes[key])
+			return false;
+
+		memcpy(dstData, data, settingsSizes[key]);
+		return true;
+	}
+
+	return STORE_RECORD_VERSION(header) < settingsVersions[key]
+			&& MigrateSettings(key, STORE_RECORD_VERSION(header), data, STORE_RECORD_DATA_SIZE(header), dstData);
+}
+
+/*
+ * @brief  Migrates the indexed records of previous versions of the settings struct of their key and rewrites them, so
+ *         that they are migrated once. The queue is empty at startup, the migrated settings are built in it. Called at
+ *         startup, before the flash writer is registered.
+ * @param  None
+ * @retval None
+ */
+static void MigrateStoredSettings(void) {
+	uint32_t header;
+	uint8_t key;
+
+	for (key = 0; key < FLASH_KEY_NBR; key++) {
+		if (0 == settingsIndex[key])
+			continue;
+
+		header = FLASH_WORD(settingsIndex[key]);
+		if (STORE_RECORD_VERSION(header) < settingsVersions[key]
+				&& MigrateSettings((FlashSettingsKey) key, STORE_RECORD_VERSION(header),
+						(const uint8_t*) (settingsIndex[key] + STORE_RECORD_HEADER_SIZE), STORE_RECORD_DATA_SIZE(header),
+						pendingRecords))
+			RewriteMigratedSettings((FlashSettingsKey) key, pendingRecords);
+	}
+}
+
+/*
+ * @brief  Converts settings of a previous version of the settings struct of their key to the current struct. A case is
+ *         added for a key whose version is incremented, converting each previous version, e.g. by copying the fields
+ *         that are kept, and setting the default of a new field. A version that cannot be converted is left to the
+ *         defaults of its module.
+ * @param  key : Settings key
+ * @param  version : Version of the stored settings, below the current version of the key
+ * @param  data : Stored settings
+ * @param  dataSize : data byte size
+ * @param  dstData : Destination of the current settings struct
+ * @retval true if converted, else false
+ */
+static bool MigrateSettings(const FlashSettingsKey key, const uint8_t version, const uint8_t* data,
+		const uint16_t dataSize, uint8_t* dstData) {
+	(void) version;
+	(void) data;
+	(void) dataSize;
+	(void) dstData;
+
+	switch (key) {
+	default:
+		return false;
+	}
+}
+
+/*
+ * @brief  Writes migrated settings as a record of the current version, so that they are migrated once. The record of
+ *         the previous version is kept until then, and migrated again on every read and at the next startup if the
+ *         write fails. Called at startup, before the flash writer is registered.
+ * @param  key : Settings key
+ * @param  data : Migrated settings, of the current settings struct of the key
+ * @retval None
+ */
+static void RewriteMigratedSettings(const FlashSettingsKey key, const uint8_t* data) {
+	const uint16_t dataSize = settingsSizes[key];
+	const uint32_t header = SETTINGS_RECORD_HEADER(key, dataSize);
+	FlashErrorStatus status = FLASH_OK;
+
+	if (storeWriteOffset + STORE_RECORD_SIZE(dataSize) > FLASH_PAGE_SIZE)
+		status = CompactStore(STORE_RECORD_SIZE(dataSize));
+
+	if (FLASH_OK == status)
+		AppendRecord(header, data, CalculateRecordCRC(header, data, dataSize));
+}
+
+/*
+ * @brief  Tells the keys of the sensor and receiver calibrations, whose writes are recorded in the event journal
+ * @param  key : Settings key
+ * @retval true if a calibration, else false
+ */
+static bool IsCalibrationKey(const FlashSettingsKey key) {
+	switch (key) {
+	case FLASH_KEY_RECEIVER_CALIBRATION:
+	case FLASH_KEY_MAG_CALIBRATION:
+	case FLASH_KEY_ACC_CALIBRATION:
+	case FLASH_KEY_MAG_ELLIPSOID_CALIBRATION:
+	case FLASH_KEY_GYRO_TEMP_COMPENSATION:
+	case FLASH_KEY_SENSOR_ORIENTATION:
+	case FLASH_KEY_ACCMAG_TEMP_COMPENSATION:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * @brief  Posts the flash writer, if it has been registered
+ * @param  None
+ * @retval None
+ */
+static void WakeFlashWriter(void) {
+	DeferredWorkPost(flashWriterWorkId);
+}
+
+/*
+ * @brief  Keeps the other tasks from using the store and the shared CRC peripheral, by suspending the scheduler. Flash
+ *         programming stalls the CPU anyway. Settings are also read and written before the scheduler is started, when
+ *         the scheduler calls would leave the interrupts masked, so it is then left alone.
+ * @param  None
+ * @retval None
+ */
+static void LockSettingsStore(void) {
+	if (taskSCHEDULER_NOT_STARTED != xTaskGetSchedulerState())
+		vTaskSuspendAll();
+}
+
+/*
+ * @brief  Ends LockSettingsStore()
+ * @param  None
+ * @retval None
+ */
+static void UnlockSettingsStore(void) {
+	if (taskSCHEDULER_NOT_STARTED != xTaskGetSchedulerState())
+		xTaskResumeAll();
+}
+
+/*
+ * @brief  Finds the active store page, the one with the highest sequence number of those marked active. A page of an
+ *         interrupted compaction has no active marker, the page it was compacted from is then still used.
+ * @param  None
+ * @retval true if found, false if there is no store
+ */
+static bool FindActiveStorePage(void) {
+	bool isFound = false;
+	uint32_t pageAddr;
+	uint8_t i;
+
+	for (i = 0; i < FLASH_SETTINGS_STORE_NBR_OF_PAGES; i++) {
+		pageAddr = STORE_PAGE_ADDR(i);
+		if (STORE_PAGE_MAGIC == FLASH_WORD(pageAddr) && STORE_PAGE_ACTIVE == FLASH_WORD(pageAddr + STORE_PAGE_ACTIVE_OFFSET)
+				&& (!isFound || FLASH_WORD(pageAddr + STORE_PAGE_SEQUENCE_OFFSET) > activeStoreSequence)) {
+			activeStorePageIdx = i;
+			activeStoreSequence = FLASH_WORD(pageAddr + STORE_PAGE_SEQUENCE_OFFSET);
+			isFound = true;
+		}
+	}
+
+	return isFound;
+}
+
+/*
+ * @brief  Indexes the valid records of the active store page and finds the end of its log. Records that fail their CRC
+ *         check, e.g. interrupted writes, are skipped. A corrupt record header ends the log, the rest of the page is
+ *         then left unused until the next compaction.
+ * @param  None
+ * @retval None
+ */
+static void ScanStorePage(void) {
+	const uint32_t pageAddr = STORE_PAGE_ADDR(activeStorePageIdx);
+	uint16_t offset = STORE_PAGE_HEADER_SIZE;
+	uint32_t header;
+
+	while (offset + STORE_RECORD_HEADER_SIZE <= FLASH_PAGE_SIZE) {
+		header = FLASH_WORD(pageAddr + offset);
+		if (STORE_ERASED_WORD == header)
+			break;
+
+		if (STORE_RECORD_DATA_SIZE(header) > FLASH_SETTINGS_MAX_RECORD_SIZE
+				|| offset + STORE_RECORD_SIZE(STORE_RECORD_DATA_SIZE(header)) > FLASH_PAGE_SIZE) {
+			offset = FLASH_PAGE_SIZE;
+			break;
+		}
+
+		if (STORE_RECORD_KEY(header) < FLASH_KEY_NBR && IsValidRecord(pageAddr + offset))
+			settingsIndex[STORE_RECORD_KEY(header)] = pageAddr + offset;
+
+		offset += STORE_RECORD_SIZE(STORE_RECORD_DATA_SIZE(header));
+	}
+
+	storeWriteOffset = offset;
+}
+
+/*
+ * @brief  Formats the store in the second page of the settings area, imports the valid blocks of the previous fixed
+ *         layout from the first page and then erases that page
+ * @param  None
+ * @retval FLASH_OK if formatted, else FLASH_ERROR
+ */
+static FlashErrorStatus FormatStore(void) {
+	const uint32_t legacyPageAddr = STORE_PAGE_ADDR(0);
+	const uint8_t* blockData;
+	uint8_t i;
+
+	if (!OpenStorePage(1, 1))
+		return FLASH_ERROR;
+
+	for (i = 0; i < sizeof(legacySettingsBlocks) / sizeof(legacySettingsBlocks[0]); i++) {
+		blockData = (const uint8_t*) (legacyPageAddr + legacySettingsBlocks[i].offset + FLASH_WORD_BYTE_SIZE);
+		if (legacySettingsBlocks[i].offset + FLASH_WORD_BYTE_SIZE + legacySettingsBlocks[i].size <= FLASH_PAGE_SIZE
+				&& CalculateCRC(blockData, legacySettingsBlocks[i].size)
+						== FLASH_WORD(legacyPageAddr + legacySettingsBlocks[i].offset)
+				&& !AppendRecord(STORE_RECORD_HEADER(legacySettingsBlocks[i].key, 0, legacySettingsBlocks[i].size),
+						blockData, CalculateRecordCRC(STORE_RECORD_HEADER(legacySettingsBlocks[i].key, 0,
+								legacySettingsBlocks[i].size), blockData, legacySettingsBlocks[i].size)))
+			return FLASH_ERROR;
+	}
+
+	if (!ProgramFlashWords(STORE_PAGE_ADDR(1) + STORE_PAGE_ACTIVE_OFFSET, (const uint8_t*) &storePageActiveMarker,
+			FLASH_WORD_BYTE_SIZE))
+		return FLASH_ERROR;
+
+	if (!IsFlashErased(legacyPageAddr, FLASH_PAGE_SIZE))
+		return EraseFlashPage(legacyPageAddr);
+
+	return FLASH_OK;
+}
+
+/*
+ * @brief  Copies the newest records of all keys to the next page of the settings area, which becomes the active page,
+ *         and erases the old one. Called with the store locked.
+ * @param  neededSize : Byte size of the records to be appended after the compaction
+ * @retval FLASH_OK if compacted with room for neededSize, else FLASH_ERROR
+ */
+static FlashErrorStatus CompactStore(const uint16_t neededSize) {
+	const uint32_t oldPageAddr = STORE_PAGE_ADDR(activeStorePageIdx);
+	uint32_t oldIndex[FLASH_KEY_NBR];
+	uint32_t liveSize = STORE_PAGE_HEADER_SIZE;
+	uint16_t dataSize;
+	uint8_t key;
+
+	for (key = 0; key < FLASH_KEY_NBR; key++) {
+		if (0 != settingsIndex[key])
+			liveSize += STORE_RECORD_SIZE(STORE_RECORD_DATA_SIZE(FLASH_WORD(settingsIndex[key])));
+	}
+
+	if (liveSize + neededSize > FLASH_PAGE_SIZE)
+		return FLASH_ERROR;
+
+	memcpy(oldIndex, settingsIndex, sizeof(oldIndex));
+
+	if (!OpenStorePage((activeStorePageIdx + 1) % FLASH_SETTINGS_STORE_NBR_OF_PAGES, activeStoreSequence + 1))
+		return FLASH_ERROR;
+
+	/* The records are copied with their headers and CRCs, i.e. in their versions, the old page stays the active one
+	 * until the new one is marked */
+	for (key = 0; key < FLASH_KEY_NBR; key++) {
+		if (0 != oldIndex[key]) {
+			dataSize = STORE_RECORD_DATA_SIZE(FLASH_WORD(oldIndex[key]));
+			if (!AppendRecord(FLASH_WORD(oldIndex[key]), (const uint8_t*) (oldIndex[key] + STORE_RECORD_HEADER_SIZE),
+					FLASH_WORD(oldIndex[key] + STORE_RECORD_SIZE(dataSize) - STORE_RECORD_CRC_SIZE)))
+				return FLASH_ERROR;
+		}
+	}
+
+	if (!ProgramFlashWords(STORE_PAGE_ADDR(activeStorePageIdx) + STORE_PAGE_ACTIVE_OFFSET,
+			(const uint8_t*) &storePageActiveMarker, FLASH_WORD_BYTE_SIZE))
+		return FLASH_ERROR;
+
+	return EraseFlashPage(oldPageAddr);
+}
+
+/*
+ * @brief  Makes a page of the settings area the one records are appended to, erasing it if needed and programming its
+ *         magic and sequence number. The index is cleared, as the records are appended anew.
+ * @param  pageIdx : Page index in the settings area
+ * @param  sequence : Sequence number of the page
+ * @retval FLASH_OK if opened, else FLASH_ERROR
+ */
+static FlashErrorStatus OpenStorePage(const uint8_t pageIdx, const uint32_t sequence) {
+	const uint32_t pageAddr = STORE_PAGE_ADDR(pageIdx);
+	const uint32_t pageHeader[2] = { STORE_PAGE_MAGIC, sequence };
+
+	if (!IsFlashErased(pageAddr, FLASH_PAGE_SIZE) && !EraseFlashPage(pageAddr))
+		return FLASH_ERROR;
+
+	if (!ProgramFlashWords(pageAddr, (const uint8_t*) pageHeader, sizeof(pageHeader)))
+		return FLASH_ERROR;
+
+	activeStorePageIdx = pageIdx;
+	activeStoreSequence = sequence;
+	storeWriteOffset = STORE_PAGE_HEADER_SIZE;
+	memset(settingsIndex, 0x00, sizeof(settingsIndex));
+
+	return FLASH_OK;
+}
+
+/*
+ * @brief  Programs a record at the end of the log of the active page and indexes it. The CRC word is programmed last.
+ * @param  header : Record header, see STORE_RECORD_HEADER()
+ * @param  data : Record data
+ * @param  crc : Record CRC, see CalculateRecordCRC()
+ * @retval FLASH_OK if programmed, FLASH_ERROR if the record does not fit or programming failed
+ */
+static FlashErrorStatus AppendRecord(const uint32_t header, const uint8_t* data, const uint32_t crc) {
+	const uint32_t recordAddr = STORE_PAGE_ADDR(activeStorePageIdx) + storeWriteOffset;
+	const uint16_t dataSize = STORE_RECORD_DATA_SIZE(header);
+
+	if (storeWriteOffset + STORE_RECORD_SIZE(dataSize) > FLASH_PAGE_SIZE)
+		return FLASH_ERROR;
+
+	/* A record that fails to program keeps its space, the log continues after it */
+	storeWriteOffset += STORE_RECORD_SIZE(dataSize);
+
+	if (!ProgramFlashWords(recordAddr, (const uint8_t*) &header, STORE_RECORD_HEADER_SIZE)
+			|| !ProgramFlashWords(recordAddr + STORE_RECORD_HEADER_SIZE, data, dataSize)
+			|| !ProgramFlashWords(recordAddr + STORE_RECORD_SIZE(dataSize) - STORE_RECORD_CRC_SIZE, (const uint8_t*) &crc,
+					STORE_RECORD_CRC_SIZE) || !IsValidRecord(recordAddr))
+		return FLASH_ERROR;
+
+	settingsIndex[STORE_RECORD_KEY(header)] = recordAddr;
+
+	return FLASH_OK;
+}
+
+/*
+ * @brief  Checks the CRC of a store record
+ * @param  recordAddr : Flash address of the record
+ * @retval true if valid, else false
+ */
+static bool IsValidRecord(const uint32_t recordAddr) {
+	const uint32_t header = FLASH_WORD(recordAddr);
+	const uint16_t dataSize = STORE_RECORD_DATA_SIZE(header);
+
+	return CalculateRecordCRC(header, (const uint8_t*) (recordAddr + STORE_RECORD_HEADER_SIZE), dataSize)
+			== FLASH_WORD(recordAddr + STORE_RECORD_SIZE(dataSize) - STORE_RECORD_CRC_SIZE);
+}
+
+/*
+ * @brief  Calculates the CRC of a store record, over its header and data. The data is fed to the CRC peripheral by DMA.
+ * @param  header : Record header
+ * @param  data : Record data
+ * @param  dataSize : data byte size
+ * @retval CRC value
+ */
+static uint32_t CalculateRecordCRC(const uint32_t header, const uint8_t* data, const uint16_t dataSize) {
+	CalculateCRC((const uint8_t*) &header, STORE_RECORD_HEADER_SIZE);
+
+	return AccumulateCRCWithDMA(data, dataSize);
+}
+
+/*
+ * @brief  Erases one page (2048 bytes on STM32F303VC) of the flash
+ * @param  pageAddr : Flash page address
+ * @retval FLASH_OK if flash operation successful, else FLASH_ERROR
+ */
+static FlashErrorStatus EraseFlashPage(const uint32_t pageAddr) {
+	uint32_t flashStatus;
+
+	if (!IS_VALID_FLASH_ADDR(pageAddr))
+		return FLASH_ERROR;
+
+	HAL_FLASH_Unlock();
+	flashStatus = EraseFlashPageFromRAM(pageAddr);
+	HAL_FLASH_Lock();
+
+	if (0 != flashStatus || !IsFlashErased(pageAddr, FLASH_PAGE_SIZE))
+		return FLASH_ERROR;
+
+	return FLASH_OK;
+}
+
+/*
+ * @brief  Programs erased flash words. A last partial word is padded with erased bytes.
+ * @param  addr : Word aligned flash address
+ * @param  data : Data to program
+ * @param  size : data byte size
+ * @retval FLASH_OK if flash operation successful, else FLASH_ERROR
+ */
+static FlashErrorStatus ProgramFlashWords(const uint32_t addr, const uint8_t* data, const uint16_t size) {
+	uint32_t flashStatus = 0;
+	uint32_t word;
+	uint16_t i;
+
+	if (!IS_VALID_FLASH_ADDR(addr) || !IS_VALID_FLASH_ADDR(addr + size - 1))
+		return FLASH_ERROR;
+
+	HAL_FLASH_Unlock();
+
+	for (i = 0; i < size && 0 == flashStatus; i += FLASH_WORD_BYTE_SIZE) {
+		word = STORE_ERASED_WORD;
+		memcpy(&word, &data[i], (size - i < FLASH_WORD_BYTE_SIZE) ? size - i : FLASH_WORD_BYTE_SIZE);
+
+		/* Erased words are left as they are */
+		if (STORE_ERASED_WORD != word)
+			flashStatus = ProgramFlashWordFromRAM(addr + i, word);
+	}
+
+	HAL_FLASH_Lock();
+
+	if (0 != flashStatus)
+		return FLASH_ERROR;
+
+	return FLASH_OK;
+}
+
+/*
+ * @brief  Checks if flash memory is erased
+ * @param  addr : Word aligned flash address
+ * @param  size : Byte size to check, whole words
+ * @retval true if all words are erased, else false
+ */
+static bool IsFlashErased(const uint32_t addr, const uint32_t size) {
+	uint32_t i;
+
+	for (i = 0; i < size; i += FLASH_WORD_BYTE_SIZE) {
+		if (STORE_ERASED_WORD != FLASH_WORD(addr + i))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * @brief  Erases a flash page, from RAM so that the CPU is not stalled fetching this code while the flash is busy. It
+ *         accesses the flash registers only, the flash must be unlocked.
+ * @param  pageAddr : Flash page address
+ * @retval The flash error flags, 0 if successful
+ */
+static FLASH_RAM_FUNC uint32_t EraseFlashPageFromRAM(const uint32_t pageAddr) {
+	uint32_t flashStatus;
+
+	FLASH->SR = FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPERR;
+	FLASH->CR |= FLASH_CR_PER;
+	FLASH->AR = pageAddr;
+	FLASH->CR |= FLASH_CR_STRT;
+
+	while (FLASH->SR & FLASH_SR_BSY) {
+	}
+
+	FLASH->CR &= ~FLASH_CR_PER;
+	flashStatus = FLASH->SR & (FLASH_SR_PGERR | FLASH_SR_WRPERR);
+	FLASH->SR = FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPERR;
+
+	return flashStatus;
+}
+
+/*
+ * @brief  Programs a flash word as two half words, from RAM so that the CPU is not stalled fetching this code while the
+ *         flash is busy. It accesses the flash registers only, the flash must be unlocked.
+ * @param  addr : Word aligned flash address
+ * @param  word : Word to program
+ * @retval The flash error flags, 0 if successful
+ */
+static FLASH_RAM_FUNC uint32_t ProgramFlashWordFromRAM(const uint32_t addr, const uint32_t word) {
+	uint32_t flashStatus = 0;
+	uint8_t i;
+
+	FLASH->SR = FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPERR;
+	FLASH->CR |= FLASH_CR_PG;
+
+	for (i = 0; i < 2 && 0 == flashStatus; i++) {
+		if (STORE_ERASED_HALF_WORD != (uint16_t) (word >> (16 * i))) {
+			*(volatile uint16_t*) (addr + 2 * i) = (uint16_t) (word >> (16 * i));
+
+			while (FLASH->SR & FLASH_SR_BSY) {
+			}
+
+			flashStatus = FLASH->SR & (FLASH_SR_PGERR | FLASH_SR_WRPERR);
+		}
+	}
+
+	FLASH->CR &= ~FLASH_CR_PG;
+	FLASH->SR = FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPERR;
+
+	return flashStatus;
 }
 
 /**
@@ -10,6 +10,10 @@
 #include "FreeRTOS.h"
 #include "task.h"
 #include "fcb_error.h"
+#include "task_status.h"
+#include "deferred_log.h"
+#include "cpu_headroom.h"
+#include "rate_groups.h"
 
 #include "usbd_cdc_if.h"
 
@@ -43,18 +47,36 @@ void vApplicationStackOverflowHook(xTaskHandle xTask, signed char *pcTaskName) {
 }
 
 /*
- * @brief  FreeRTOS application/task malloc failed hook
- * @param  xTask : Task handle
- * @param  pcTaskName : Task name string
+ * @brief  FreeRTOS idle hook, called on every pass of the idle task loop. Counts the spin loops of the CPU headroom
+ *         meter, see cpu_headroom.h, so it must never block.
+ * @param  None
  * @retval None
  */
-void vApplicationMallocFailedHook(xTaskHandle xTask, signed char *pcTaskName) {
-	(void) xTask;
-	char hookString[HOOK_STRING_SIZE];
-	memset(hookString, 0x00, sizeof(hookString));
+void vApplicationIdleHook(void) {
+	CpuHeadroomIdleHook();
+}
+
+/*
+ * @brief  FreeRTOS tick hook, called from the tick interrupt on every tick. Releases the jobs of the rate groups, see
+ *         rate_groups.h.
+ * @param  None
+ * @retval None
+ */
+void vApplicationTickHook(void) {
+	RateGroupTickHook();
+}
+
+/*
+ * @brief  FreeRTOS malloc failed hook, called by pvPortMalloc before it returns NULL. The failure is counted by the
+ *         heap monitor, see task_status.h, and the caller handles the NULL return.
+ * @param  None
+ * @retval None
+ */
+void vApplicationMallocFailedHook(void) {
+	HeapStatus_TypeDef heap;
+
+	/* The details are logged deferred, formatting them here would take the stack of the calling task */
+	GetHeapStatus(&heap);
 	USBComSendString("FreeRTOS malloc failed\n");
-	strncat(hookString, (char*)pcTaskName, HOOK_STRING_SIZE - strlen(hookString) - 1);
-	strncat(hookString, "\r\n", HOOK_STRING_SIZE - strlen(hookString) - 1);
-	USBComSendString(hookString);
-	ErrorHandler();
+	LOG3("Malloc failed: %lu bytes, %lu free, %lu failures", heap.lastFailedSize, heap.free, heap.failedAllocations);
 }
@@ -0,0 +1,269 @@
+/******************************************************************************
+ * @file    isr_monitor.c
+ * @author  Dragonfly
+ * @brief   Interrupt monitor. ISR_MONITOR_END() takes the cycles from the
+ *          start of a handler minus the exclusive cycles of the handlers that
+ *          completed meanwhile, which all preempted it, so that every cycle is
+ *          accounted to one handler only and the loads add up. Handlers of any
+ *          priority are recorded, above configMAX_SYSCALL_INTERRUPT_PRIORITY
+ *          too, so the statistics are updated with all interrupts disabled.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "isr_monitor.h"
+
+#include "receiver.h"
+#include "receiver_serial.h"
+#include "state_estimation.h"
+#include "uart.h"
+#include "control_executive.h"
+#include "fcb_sensor_load_test.h"
+#include "fcb_barometer.h"
+#include "fcb_sensor_watchdog.h"
+#include "fcb_gps.h"
+#include "motor_control.h"
+#include "esc_telemetry.h"
+#include "sd_card.h"
+#include "can_bus.h"
+#include "common.h"
+#include "stm32f3_discovery.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+	const char* name;
+	IRQn_Type irqn;
+} IsrVector_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#if defined (USE_USB_INTERRUPT_REMAPPED)
+#define ISR_MONITOR_USB_IRQn        USB_LP_IRQn
+#else
+#define ISR_MONITOR_USB_IRQn        USB_LP_CAN_RX0_IRQn
+#endif
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+
+/* Indexed by IsrMonitorVector_TypeDef */
+static const IsrVector_TypeDef isrVectors[ISR_MONITOR_NBR] = {
+	{ "SysTick", SysTick_IRQn },
+	{ "PVD", PVD_IRQn },
+	{ "GyroDRDY", EXTI1_IRQn },
+	{ "MagDRDY", EXTI2_TSC_IRQn },
+	{ "AccDRDY", EXTI4_IRQn },
+	{ "Button", USER_BUTTON_EXTI_IRQn },
+	{ "GyroDmaRx", DISCOVERY_SPIx_DMA_RX_IRQn },
+	{ "GyroDmaTx", DISCOVERY_SPIx_DMA_TX_IRQn },
+	{ "I2C-EV", DISCOVERY_I2Cx_EV_IRQn },
+	{ "I2C-ER", DISCOVERY_I2Cx_ER_IRQn },
+	{ "StateEstTIM", STATE_ESTIMATION_UPDATE_TIM_IRQn },
+	{ "RcvTIM", PRIMARY_RECEIVER_TIM_IRQn },
+	{ "AuxRcvTIM", AUX_RECEIVER_TIM_IRQn },
+	{ "FailsafeTIM", RECEIVER_FAILSAFE_TIM_IRQn },
+	{ "SerialRcv", SERIAL_RECEIVER_UART_IRQn },
+	{ "UART", UART_IRQn },
+	{ "UartDmaRx", UART_DMA_RX_IRQn },
+	{ "UartDmaTx", UART_DMA_TX_IRQn },
+	{ "CrcDma", CRC_DMA_IRQn },
+	{ "USB", ISR_MONITOR_USB_IRQn },
+	{ "CtrlExec", CONTROL_EXECUTIVE_IRQn },
+	{ "LoadTestTIM", SENSOR_LOAD_TEST_TIM_IRQn },
+	{ "I2C-Baro-EV", DISCOVERY_I2Cbar_EV_IRQn },
+	{ "I2C-Baro-ER", DISCOVERY_I2Cbar_ER_IRQn },
+	{ "BaroTIM", BAROMETER_TIM_IRQn },
+	{ "SensorWdTIM", SENSOR_WATCHDOG_TIM_IRQn },
+	{ "GpsUART", GPS_UART_IRQn },
+	{ "MotorDma", MOTOR_DSHOT_DMA_IRQn },
+	{ "EscTlmUART", ESC_TELEMETRY_UART_IRQn },
+	{ "SdCardDma", SD_CARD_SPI_DMA_TX_IRQn },
+	{ "CanRx", CAN_BUS_RX_IRQn },
+	{ "CanTx", CAN_BUS_TX_IRQn }
+};
+
+#ifdef FCB_ISR_MONITOR
+static IsrStats_TypeDef isrStats[ISR_MONITOR_NBR];
+#endif
+
+/* Sum of the exclusive cycles of all recorded handlers, wraps */
+static volatile uint32_t exclusiveSum = 0;
+
+/* Start of the statistics [ms] */
+static uint32_t statsStart = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Gets the sum of the exclusive cycles of all recorded handlers, at the start of a measurement
+ * @param  None
+ * @retval Sum [core clock cycles], wraps
+ */
+uint32_t IsrMonitorGetExclusiveSum(void) {
+	return exclusiveSum;
+}
+
+/*
+ * @brief  Records a call of a handler. Called at the end of the handler.
+ * @param  vector : Handler
+ * @param  start : Cycle counter at the start of the handler
+ * @param  exclusiveSumAtStart : IsrMonitorGetExclusiveSum() at the start of the handler
+ * @retval None
+ */
+void IsrMonitorRecord(const IsrMonitorVector_TypeDef vector, const uint32_t start, const uint32_t exclusiveSumAtStart) {
+#ifdef FCB_ISR_MONITOR
+	IsrStats_TypeDef* stats;
+	uint32_t primask;
+	uint32_t cycles;
+
+	if (vector >= ISR_MONITOR_NBR) {
+		return;
+	}
+
+	stats = &isrStats[vector];
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	/* The handlers that completed since the start preempted this one */
+	cycles = (DWT->CYCCNT - start) - (exclusiveSum - exclusiveSumAtStart);
+	exclusiveSum += cycles;
+
+	if (cycles > stats->maxCycles) {
+		stats->maxCycles = cycles;
+	}
+	stats->cycles += cycles;
+	stats->count++;
+
+	__set_PRIMASK(primask);
+#else
+	(void) vector;
+	(void) start;
+	(void) exclusiveSumAtStart;
+#endif
+}
+
+/*
+ * @brief  Gets a copy of the statistics of all handlers, each handler consistent in itself, all zero without
+ *         FCB_ISR_MONITOR
+ * @param  dstSnapshot : Destination snapshot
+ * @retval None
+ */
+void IsrMonitorGetSnapshot(IsrSnapshot_TypeDef* dstSnapshot) {
+#ifdef FCB_ISR_MONITOR
+	uint32_t primask;
+	uint8_t i;
+
+	for (i = 0; i < ISR_MONITOR_NBR; i++) {
+		primask = __get_PRIMASK();
+		__disable_irq();
+		dstSnapshot->isr[i] = isrStats[i];
+		__set_PRIMASK(primask);
+	}
+#else
+	memset(dstSnapshot->isr, 0, sizeof(dstSnapshot->isr));
+#endif
+
+	dstSnapshot->duration = HAL_GetTick() - statsStart;
+	dstSnapshot->coreClock = SystemCoreClock;
+}
+
+/*
+ * @brief  Gets a consistent copy of the statistics of one handler, all zero without FCB_ISR_MONITOR
+ * @param  vector : Handler to copy
+ * @param  dstStats : Destination statistics
+ * @retval Time since the statistics were cleared [ms]
+ */
+uint32_t IsrMonitorGetStats(const IsrMonitorVector_TypeDef vector, IsrStats_TypeDef* dstStats) {
+#ifdef FCB_ISR_MONITOR
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	*dstStats = isrStats[vector];
+	__set_PRIMASK(primask);
+#else
+	(void) vector;
+	memset(dstStats, 0, sizeof(IsrStats_TypeDef));
+#endif
+
+	return HAL_GetTick() - statsStart;
+}
+
+/*
+ * @brief  Clears the statistics of all handlers
+ * @param  None
+ * @retval None
+ */
+void IsrMonitorReset(void) {
+#ifdef FCB_ISR_MONITOR
+	uint32_t primask;
+	uint8_t i;
+
+	for (i = 0; i < ISR_MONITOR_NBR; i++) {
+		primask = __get_PRIMASK();
+		__disable_irq();
+		memset(&isrStats[i], 0, sizeof(IsrStats_TypeDef));
+		__set_PRIMASK(primask);
+	}
+#endif
+
+	statsStart = HAL_GetTick();
+}
+
+/*
+ * @brief  Prints the statistics of the handlers that were called as a table with their NVIC priority, rate and load
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @param  snapshot : Statistics to print, see IsrMonitorGetSnapshot()
+ * @retval Length of the table string
+ */
+size_t IsrMonitorPrint(char* dst, const size_t dstSize, const IsrSnapshot_TypeDef* snapshot) {
+	uint64_t windowCycles = (uint64_t) snapshot->duration*(snapshot->coreClock/1000);
+	uint64_t totalCycles = 0;
+	uint32_t load;
+	size_t length;
+	uint8_t i;
+
+#ifndef FCB_ISR_MONITOR
+	return (size_t) snprintf(dst, dstSize, "\nInterrupt monitor not compiled in, see FCB_ISR_MONITOR\n");
+#endif
+
+	length = (size_t) snprintf(dst, dstSize, "\nInterrupts over %lu ms, load of the CPU in 0.01 %%\n"
+			"%-12s%5s%10s%8s%8s%8s%7s\n", snapshot->duration, "Handler", "Prio", "Count", "Rate", "Mean", "Max",
+			"Load");
+
+	for (i = 0; i < ISR_MONITOR_NBR && length < dstSize; i++) {
+		const IsrStats_TypeDef* stats = &snapshot->isr[i];
+
+		if (0 == stats->count) {
+			continue;
+		}
+
+		totalCycles += stats->cycles;
+		load = (0 == windowCycles) ? 0 : (uint32_t) (10000*stats->cycles/windowCycles);
+		length += (size_t) snprintf(dst + length, dstSize - length, "%-12s%5lu%10lu%8lu%8lu%8lu%7lu\n",
+				isrVectors[i].name, NVIC_GetPriority(isrVectors[i].irqn), stats->count,
+				(0 == snapshot->duration) ? 0 : (uint32_t) ((uint64_t) 1000*stats->count/snapshot->duration),
+				(uint32_t) (stats->cycles/stats->count), stats->maxCycles, load);
+	}
+
+	if (length < dstSize) {
+		load = (0 == windowCycles) ? 0 : (uint32_t) (10000*totalCycles/windowCycles);
+		length += (size_t) snprintf(dst + length, dstSize - length, "Total load %lu.%02lu %%, cycles at %lu Hz\n",
+				load/100, load%100, snapshot->coreClock);
+	}
+
+	return length;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
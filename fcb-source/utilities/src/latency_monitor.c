@@ -0,0 +1,277 @@
+/******************************************************************************
+ * @file    latency_monitor.c
+ * @author  Dragonfly
+ * @brief   End-to-end control latency monitor. A measurement starts when the
+ *          flight control task processes a gyroscope sample, each pipeline
+ *          stage stamps it with the DWT cycle counter, and the motor output
+ *          completes it. The measurement always follows the newest gyroscope
+ *          sample: a sample that is superseded before a motor output restarts
+ *          it, and stages passed without an open measurement are ignored.
+ *          An RC frame measurement runs alongside it, from the completion of
+ *          a receiver frame to the first motor output after the flight
+ *          control applied the frame's setpoints.
+ *          Stamping is done by the flight control task only, or by the
+ *          SENSORS task with FCB_FUSED_SENSOR_PIPELINE.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "latency_monitor.h"
+
+#include "common.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+#define CYCLES_PER_US      (SystemCoreClock / 1000000)
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static LatencyStats_TypeDef latencyStats;
+
+/* Stage timestamps of the open measurement [core clock cycles] */
+static uint32_t stageTimestamps[LATENCY_STAGE_NBR];
+static uint8_t measurementOpen = 0;
+
+/* Completion time of the RC frame of the open RC frame measurement [core clock cycles] */
+static uint32_t rcFrameTimestamp;
+static uint8_t rcFrameMeasurementOpen = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+static void ResetStageStats(LatencyStageStats_TypeDef* stats);
+static void UpdateStageStats(LatencyStageStats_TypeDef* stats, const uint32_t cycles);
+static void CompleteMeasurement(void);
+static void CompleteRcFrameMeasurement(const uint32_t motorTimestamp);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Starts a measurement for a gyroscope sample, replacing an open one
+ * @param  drdyTimestamp : Time of the data ready interrupt [core clock cycles]
+ * @param  fetchTimestamp : Time the sample was handed to the flight control task [core clock cycles]
+ * @retval None
+ */
+void LatencyMonitorBegin(const uint32_t drdyTimestamp, const uint32_t fetchTimestamp) {
+	stageTimestamps[LATENCY_STAGE_DRDY] = drdyTimestamp;
+	stageTimestamps[LATENCY_STAGE_FETCH] = fetchTimestamp;
+	measurementOpen = 1;
+}
+
+/*
+ * @brief  Stamps a stage of the open measurement with the current time. LATENCY_STAGE_MOTOR completes it.
+ * @param  stage : Stage that has just been passed, LATENCY_STAGE_CORRECTION or later
+ * @retval None
+ */
+void LatencyMonitorMark(const LatencyStage_TypeDef stage) {
+	uint32_t timestamp = GetTimestamp();
+
+	if (LATENCY_STAGE_MOTOR == stage && rcFrameMeasurementOpen) {
+		CompleteRcFrameMeasurement(timestamp);
+	}
+
+	if (!measurementOpen || stage <= LATENCY_STAGE_FETCH || stage >= LATENCY_STAGE_NBR) {
+		return;
+	}
+
+	stageTimestamps[stage] = timestamp;
+
+	if (LATENCY_STAGE_MOTOR == stage) {
+		CompleteMeasurement();
+	}
+}
+
+/*
+ * @brief  Starts an RC frame measurement when the setpoints of an RC frame are applied, replacing an open one
+ * @param  frameTimestamp : Time the RC frame was completed [core clock cycles]
+ * @retval None
+ */
+void LatencyMonitorBeginRcFrame(const uint32_t frameTimestamp) {
+	rcFrameTimestamp = frameTimestamp;
+	rcFrameMeasurementOpen = 1;
+}
+
+/*
+ * @brief  Gets a consistent copy of the latency statistics
+ * @param  dstStats : Destination statistics
+ * @retval None
+ */
+void LatencyMonitorGetStats(LatencyStats_TypeDef* dstStats) {
+	taskENTER_CRITICAL();
+	*dstStats = latencyStats;
+	taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Clears the latency statistics
+ * @param  None
+ * @retval None
+ */
+void LatencyMonitorReset(void) {
+	uint8_t i;
+
+	taskENTER_CRITICAL();
+	latencyStats.count = 0;
+	ResetStageStats(&latencyStats.total);
+	for (i = 0; i < LATENCY_STAGE_NBR; i++) {
+		ResetStageStats(&latencyStats.stage[i]);
+	}
+	memset(latencyStats.histogram, 0, sizeof(latencyStats.histogram));
+	latencyStats.rcFrameCount = 0;
+	ResetStageStats(&latencyStats.rcFrame);
+	measurementOpen = 0;
+	rcFrameMeasurementOpen = 0;
+	taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Prints the latency statistics as a table
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @retval Length of the table string
+ */
+size_t LatencyMonitorPrint(char* dst, const size_t dstSize) {
+	static const char* stageNames[LATENCY_STAGE_NBR] = { "DRDY", "Fetch", "Correction", "Control", "Motor" };
+	LatencyStats_TypeDef stats;
+	LatencyStageStats_TypeDef* stageStats;
+	uint32_t cyclesPerUs = CYCLES_PER_US;
+	size_t length;
+	uint8_t i;
+
+	LatencyMonitorGetStats(&stats);
+
+	if (0 == stats.count) {
+		return (size_t) snprintf(dst, dstSize, "No latency measurements\n");
+	}
+
+	length = (size_t) snprintf(dst, dstSize, "\nLatency [us] (%lu samples)\n%-12s%8s%8s%8s\n",
+			(unsigned long) stats.count, "Stage", "Min", "Avg", "Max");
+
+	/* Stage 0 is the data ready interrupt itself, print the total in its place */
+	for (i = 0; i < LATENCY_STAGE_NBR && length < dstSize; i++) {
+		stageStats = (LATENCY_STAGE_DRDY == i) ? &stats.total : &stats.stage[i];
+		length += (size_t) snprintf(dst + length, dstSize - length, "%-12s%8lu%8lu%8lu\n",
+				(LATENCY_STAGE_DRDY == i) ? "Total" : stageNames[i],
+				(unsigned long) (stageStats->min / cyclesPerUs),
+				(unsigned long) (stageStats->sum / stats.count / cyclesPerUs),
+				(unsigned long) (stageStats->max / cyclesPerUs));
+	}
+
+	for (i = 0; i < LATENCY_HISTOGRAM_BINS && length < dstSize; i++) {
+		if (stats.histogram[i] > 0) {
+			length += (size_t) snprintf(dst + length, dstSize - length, "<%-10lu%8lu\n", 2UL << i,
+					(unsigned long) stats.histogram[i]);
+		}
+	}
+
+	if (stats.rcFrameCount > 0 && length < dstSize) {
+		length += (size_t) snprintf(dst + length, dstSize - length, "%-12s%8lu%8lu%8lu (%lu frames)\n", "RC frame",
+				(unsigned long) (stats.rcFrame.min / cyclesPerUs),
+				(unsigned long) (stats.rcFrame.sum / stats.rcFrameCount / cyclesPerUs),
+				(unsigned long) (stats.rcFrame.max / cyclesPerUs), (unsigned long) stats.rcFrameCount);
+	}
+
+	return length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Clears the statistics of one stage
+ * @param  stats : Stage statistics
+ * @retval None
+ */
+static void ResetStageStats(LatencyStageStats_TypeDef* stats) {
+	stats->min = UINT32_MAX;
+	stats->max = 0;
+	stats->sum = 0;
+}
+
+/*
+ * @brief  Adds a duration to the statistics of one stage
+ * @param  stats : Stage statistics
+ * @param  cycles : Duration [core clock cycles]
+ * @retval None
+ */
+static void UpdateStageStats(LatencyStageStats_TypeDef* stats, const uint32_t cycles) {
+	if (cycles < stats->min) {
+		stats->min = cycles;
+	}
+	if (cycles > stats->max) {
+		stats->max = cycles;
+	}
+	stats->sum += cycles;
+}
+
+/*
+ * @brief  Adds the open measurement to the statistics and closes it
+ * @param  None
+ * @retval None
+ */
+static void CompleteMeasurement(void) {
+	uint32_t total = stageTimestamps[LATENCY_STAGE_MOTOR] - stageTimestamps[LATENCY_STAGE_DRDY];
+	uint32_t totalUs = total / CYCLES_PER_US;
+	uint32_t bin;
+	uint8_t i;
+
+	measurementOpen = 0;
+
+	/* A stage that was not passed since the measurement started, e.g. no PID in raw mode, has a stale timestamp */
+	for (i = LATENCY_STAGE_FETCH; i < LATENCY_STAGE_NBR; i++) {
+		if (stageTimestamps[i] - stageTimestamps[i - 1] > total) {
+			return;
+		}
+	}
+
+	/* Floor of log2, latencies below 2 us land in the first bin */
+	bin = (totalUs < 2) ? 0 : 31 - __CLZ(totalUs);
+	if (bin >= LATENCY_HISTOGRAM_BINS) {
+		bin = LATENCY_HISTOGRAM_BINS - 1;
+	}
+
+	/* The reader copies the statistics in a critical section */
+	taskENTER_CRITICAL();
+	if (0 == latencyStats.count) {
+		ResetStageStats(&latencyStats.total);
+		for (i = 0; i < LATENCY_STAGE_NBR; i++) {
+			ResetStageStats(&latencyStats.stage[i]);
+		}
+	}
+	latencyStats.count++;
+	UpdateStageStats(&latencyStats.total, total);
+	for (i = LATENCY_STAGE_FETCH; i < LATENCY_STAGE_NBR; i++) {
+		UpdateStageStats(&latencyStats.stage[i], stageTimestamps[i] - stageTimestamps[i - 1]);
+	}
+	latencyStats.histogram[bin]++;
+	taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Adds the open RC frame measurement to the statistics and closes it
+ * @param  motorTimestamp : Time of the motor write [core clock cycles]
+ * @retval None
+ */
+static void CompleteRcFrameMeasurement(const uint32_t motorTimestamp) {
+	rcFrameMeasurementOpen = 0;
+
+	/* The reader copies the statistics in a critical section */
+	taskENTER_CRITICAL();
+	if (0 == latencyStats.rcFrameCount) {
+		ResetStageStats(&latencyStats.rcFrame);
+	}
+	latencyStats.rcFrameCount++;
+	UpdateStageStats(&latencyStats.rcFrame, motorTimestamp - rcFrameTimestamp);
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,209 @@
+/******************************************************************************
+ * @file    led_status.c
+ * @author  Dragonfly
+ * @brief   LED status patterns, see led_status.h. Only the 20 Hz rate group writes
+ *          the LEDs, and only the ones that change, as BSP_LED_On() and
+ *          BSP_LED_Off() are a write to the port each.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "led_status.h"
+
+#include "flight_mode.h"
+#include "fcb_sensor_watchdog.h"
+#include "fcb_sensor_self_test.h"
+#include "fcb_accelerometer_magnetometer.h"
+#include "fcb_battery.h"
+#include "cpu_headroom.h"
+#include "prearm_checks.h"
+#include "fcb_error.h"
+#include "rate_groups.h"
+#include "stm32f3_discovery.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+	const char* name;
+	uint8_t leds;                   // LED_STATUS_LED() mask
+	uint32_t sequence;              // Bit n lights the LEDs in step n of LED_STATUS_SEQUENCE_STEPS
+} LedPattern_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define LED_STATUS_LED(LED)             (1U << (LED))
+
+#define LED_STATUS_ALL                  0xFF
+#define LED_STATUS_RED                  (LED_STATUS_LED(LED3) | LED_STATUS_LED(LED10))
+#define LED_STATUS_BLUE                 (LED_STATUS_LED(LED4) | LED_STATUS_LED(LED9))
+#define LED_STATUS_ORANGE               (LED_STATUS_LED(LED5) | LED_STATUS_LED(LED8))
+#define LED_STATUS_GREEN                (LED_STATUS_LED(LED6) | LED_STATUS_LED(LED7))
+
+/* Sequences of LED_STATUS_SEQUENCE_STEPS steps */
+#define LED_STATUS_ON                   0x000FFFFF
+#define LED_STATUS_FAST_BLINK           0x000CCCCC  // 5 Hz
+#define LED_STATUS_SLOW_BLINK           0x000003FF  // 1 Hz
+#define LED_STATUS_DOUBLE_BLINK         0x0000000D
+#define LED_STATUS_FLASH                0x00000001
+
+/* Private variables ---------------------------------------------------------*/
+static const LedPattern_TypeDef ledPatterns[LED_STATUS_NBR] = {
+	{ "failsafe", LED_STATUS_ALL, LED_STATUS_FAST_BLINK },
+	{ "sensor fault", LED_STATUS_RED, LED_STATUS_ON },
+	{ "low battery", LED_STATUS_RED, LED_STATUS_DOUBLE_BLINK },
+	{ "CPU overload", LED_STATUS_BLUE, LED_STATUS_FAST_BLINK },
+	{ "calibrating", LED_STATUS_ORANGE, LED_STATUS_SLOW_BLINK },
+	{ "pre-arm check failed", LED_STATUS_ORANGE, LED_STATUS_DOUBLE_BLINK },
+	{ "armed", LED_STATUS_GREEN, LED_STATUS_ON },
+	{ "disarmed", LED_STATUS_GREEN, LED_STATUS_FLASH }
+};
+
+/* Used by the rate group task only, except for the stop */
+static uint8_t ledStep = 0;
+static uint8_t ledsLit = 0;
+static volatile bool isStopped = false;
+
+static RateGroupJobId_TypeDef ledStatusJobId = RATE_GROUP_INVALID_ID;
+
+/* Private function prototypes -----------------------------------------------*/
+static void LedStatusStep(void* argument);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Registers the steps of the patterns with their rate group, which runs once the scheduler is started
+ * @param  None
+ * @retval None
+ */
+void InitLedStatus(void) {
+	if (FCB_OK != RateGroupRegister("LED_STATUS", LedStatusStep, NULL, RATE_GROUP_20HZ, LED_STATUS_PHASE,
+			&ledStatusJobId)) {
+		ErrorHandler();
+	}
+}
+
+/*
+ * @brief  Checks a status with its subsystem, without locks
+ * @param  status : LED status
+ * @retval true if active, else false
+ */
+bool IsLedStatusActive(const LedStatusType status) {
+	const FlightModeStateType state = GetFlightModeState();
+
+	switch (status) {
+	case LED_STATUS_FAILSAFE:
+		return FLIGHT_MODE_FAILSAFE == state;
+	case LED_STATUS_SENSOR_FAULT:
+		return !IsSensorHealthy(GYRO_IDX) || !IsSensorHealthy(ACC_IDX) || !IsSensorHealthy(MAG_IDX)
+				|| SENSOR_SELF_TEST_FAILED == GetSensorSelfTestStatus(GYRO_IDX)
+				|| SENSOR_SELF_TEST_FAILED == GetSensorSelfTestStatus(ACC_IDX)
+				|| SENSOR_SELF_TEST_FAILED == GetSensorSelfTestStatus(MAG_IDX);
+	case LED_STATUS_LOW_BATTERY:
+#ifdef FCB_BATTERY_MONITOR
+		return BATTERY_LOW == GetBatteryStatus() || BATTERY_CRITICAL == GetBatteryStatus();
+#else
+		return false;
+#endif
+	case LED_STATUS_CPU_OVERLOAD:
+		return IsCpuHeadroomLow();
+	case LED_STATUS_CALIBRATING:
+		return !IsAccMagCalibrated();
+	case LED_STATUS_PREARM_FAILED:
+		return FLIGHT_MODE_DISARMED == state && 0 != GetPreArmFailures();
+	case LED_STATUS_ARMED:
+		return FLIGHT_MODE_DISARMED != state && FLIGHT_MODE_FAILSAFE != state;
+	case LED_STATUS_DISARMED:
+		return FLIGHT_MODE_DISARMED == state;
+	default:
+		return false;
+	}
+}
+
+/*
+ * @brief  Stops the patterns, the callback does not write the LEDs anymore
+ * @param  None
+ * @retval None
+ */
+void LedStatusStop(void) {
+	isStopped = true;
+}
+
+const char* GetLedStatusName(const LedStatusType status) {
+	return (status < LED_STATUS_NBR) ? ledPatterns[status].name : "unknown";
+}
+
+size_t PrintLedStatus(char* dst, const size_t dstSize) {
+	size_t length;
+	uint8_t status;
+
+	length = (size_t) snprintf(dst, dstSize, "LED status:");
+
+	for (status = 0; status < LED_STATUS_NBR && length < dstSize; status++) {
+		if (IsLedStatusActive((LedStatusType) status)) {
+			length += (size_t) snprintf(dst + length, dstSize - length, " %s", ledPatterns[status].name);
+		}
+	}
+
+	if (length < dstSize) {
+		length += (size_t) snprintf(dst + length, dstSize - length, "\r\n");
+	}
+
+	return (length < dstSize) ? length : dstSize - 1;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Steps the patterns of the active statuses. Each LED takes the step of the highest priority active status
+ *         whose group it is in, and is off if there is none.
+ * @param  argument : Unused
+ * @retval None
+ */
+static void LedStatusStep(void* argument) {
+	uint8_t assigned = 0;
+	uint8_t lit = 0;
+	uint8_t leds;
+	uint8_t status, led;
+
+	(void) argument;
+
+	if (isStopped) {
+		return;
+	}
+
+	for (status = 0; status < LED_STATUS_NBR && LED_STATUS_ALL != assigned; status++) {
+		leds = ledPatterns[status].leds & (uint8_t) ~assigned;
+		if (0 == leds || !IsLedStatusActive((LedStatusType) status)) {
+			continue;
+		}
+
+		assigned |= leds;
+		if (ledPatterns[status].sequence & (1UL << ledStep)) {
+			lit |= leds;
+		}
+	}
+
+	for (led = 0; led < LEDn; led++) {
+		if ((lit ^ ledsLit) & LED_STATUS_LED(led)) {
+			if (lit & LED_STATUS_LED(led)) {
+				BSP_LED_On((Led_TypeDef) led);
+			} else {
+				BSP_LED_Off((Led_TypeDef) led);
+			}
+		}
+	}
+	ledsLit = lit;
+
+	ledStep = (ledStep + 1 < LED_STATUS_SEQUENCE_STEPS) ? ledStep + 1 : 0;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
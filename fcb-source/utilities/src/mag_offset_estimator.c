@@ -0,0 +1,130 @@
+/******************************************************************************
+ * @file    mag_offset_estimator.c
+ * @author  Dragonfly
+ * @brief   Recursive least squares estimator of the magnetometer hard-iron
+ *          offset. Each update takes a fixed number of operations, about a
+ *          hundred multiply-adds, and the forgetting factor lets the estimate
+ *          follow offsets which drift, e.g. with a new payload.
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "mag_offset_estimator.h"
+
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+#define MAG_OFFSET_FORGETTING_FACTOR    0.998f  // Weight of the past per update, a memory of about 500 updates
+#define MAG_OFFSET_INITIAL_VARIANCE     0.1f    // Of the initial offset, in squared calibrated units
+#define MAG_OFFSET_MAX_TRACE            1.0f    // The past is not forgotten beyond this covariance trace
+#define MAG_OFFSET_MIN_SAMPLE_STEP      0.05f   // Samples closer than this to the last used one are skipped
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Starts the estimate from an offset, e.g. the one of the ground calibration, with a unit field radius
+ * @param  estimator : Estimator to initialize
+ * @param  offset : Initial offset
+ * @retval None
+ */
+void MagOffsetEstimatorInit(MagOffsetEstimator_TypeDef* estimator, const float32_t offset[3]) {
+	float32_t offsetSquared;
+	uint8_t i;
+
+	memset(estimator, 0, sizeof(MagOffsetEstimator_TypeDef));
+
+	arm_dot_prod_f32((float32_t*) offset, (float32_t*) offset, 3, &offsetSquared);
+	memcpy(estimator->theta, offset, 3 * sizeof(float32_t));
+	estimator->theta[3] = 1.0f - offsetSquared;
+
+	for (i = 0; i < MAG_OFFSET_PARAMS_N; i++) {
+		estimator->P[i][i] = MAG_OFFSET_INITIAL_VARIANCE;
+	}
+}
+
+/*
+ * @brief  Updates the estimate with a soft-iron corrected sample. Samples too close to the last used one add little
+ *         but covariance windup while the field seen stays the same, e.g. on a straight course, and are skipped.
+ * @param  estimator : Estimator to update
+ * @param  sample : Soft-iron corrected sample, offset not removed
+ * @retval true if the estimate was updated, else false
+ */
+bool MagOffsetEstimatorUpdate(MagOffsetEstimator_TypeDef* estimator, const float32_t sample[3]) {
+	float32_t phi[MAG_OFFSET_PARAMS_N];
+	float32_t Pphi[MAG_OFFSET_PARAMS_N];
+	float32_t gain[MAG_OFFSET_PARAMS_N];
+	float32_t delta[3];
+	float32_t stepSquared, sampleSquared, prediction, denominator, lambda, trace;
+	uint8_t i, j;
+
+	arm_sub_f32((float32_t*) sample, estimator->lastSample, delta, 3);
+	arm_dot_prod_f32(delta, delta, 3, &stepSquared);
+	if (estimator->nbrOfUpdates > 0 && stepSquared < MAG_OFFSET_MIN_SAMPLE_STEP * MAG_OFFSET_MIN_SAMPLE_STEP) {
+		return false;
+	}
+
+	phi[0] = 2.0f * sample[0];
+	phi[1] = 2.0f * sample[1];
+	phi[2] = 2.0f * sample[2];
+	phi[3] = 1.0f;
+	arm_dot_prod_f32((float32_t*) sample, (float32_t*) sample, 3, &sampleSquared);
+
+	/* P * phi and phi' * P * phi, P is symmetric */
+	denominator = 0.0f;
+	trace = 0.0f;
+	for (i = 0; i < MAG_OFFSET_PARAMS_N; i++) {
+		arm_dot_prod_f32(estimator->P[i], phi, MAG_OFFSET_PARAMS_N, &Pphi[i]);
+		denominator += phi[i] * Pphi[i];
+		trace += estimator->P[i][i];
+	}
+
+	lambda = trace < MAG_OFFSET_MAX_TRACE ? MAG_OFFSET_FORGETTING_FACTOR : 1.0f;
+	denominator += lambda;
+
+	/* theta += K * (|y|^2 - phi' * theta), with K = P * phi / (lambda + phi' * P * phi) */
+	arm_dot_prod_f32(phi, estimator->theta, MAG_OFFSET_PARAMS_N, &prediction);
+	arm_scale_f32(Pphi, 1.0f / denominator, gain, MAG_OFFSET_PARAMS_N);
+	for (i = 0; i < MAG_OFFSET_PARAMS_N; i++) {
+		estimator->theta[i] += gain[i] * (sampleSquared - prediction);
+	}
+
+	/* P = (P - K * phi' * P) / lambda, computed on the upper triangle to keep P symmetric */
+	for (i = 0; i < MAG_OFFSET_PARAMS_N; i++) {
+		for (j = i; j < MAG_OFFSET_PARAMS_N; j++) {
+			estimator->P[i][j] = (estimator->P[i][j] - gain[i] * Pphi[j]) / lambda;
+			estimator->P[j][i] = estimator->P[i][j];
+		}
+	}
+
+	memcpy(estimator->lastSample, sample, sizeof(estimator->lastSample));
+	estimator->nbrOfUpdates++;
+
+	return true;
+}
+
+/*
+ * @brief  Gets the estimated offset and field radius
+ * @param  estimator : Estimator
+ * @param  offset : Destination of the offset
+ * @param  radius : Destination of the radius, 0 if the estimate is not a sphere
+ * @retval None
+ */
+void MagOffsetEstimatorGet(const MagOffsetEstimator_TypeDef* estimator, float32_t offset[3], float32_t* radius) {
+	float32_t radiusSquared;
+
+	memcpy(offset, estimator->theta, 3 * sizeof(float32_t));
+
+	arm_dot_prod_f32((float32_t*) offset, (float32_t*) offset, 3, &radiusSquared);
+	radiusSquared += estimator->theta[3];
+	if (radiusSquared > 0.0f) {
+		arm_sqrt_f32(radiusSquared, radius);
+	} else {
+		*radius = 0.0f;
+	}
+}
+
+/*****END OF FILE****/
@@ -0,0 +1,157 @@
+/******************************************************************************
+ * @file    matrix3.c
+ * @author  Dragonfly
+ * @brief   Benchmark of the fixed size 3x3 kernels in matrix3.h against the
+ *          CMSIS matrix functions they replace.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "matrix3.h"
+
+#ifndef FCB_HOST_BUILD
+
+#include "common.h"
+
+#include <math.h>
+#include <stdio.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+#define BENCHMARK_SAMPLES   500
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+
+/* Keeps the benchmark loops from being optimised away */
+static volatile float32_t benchmarkSink;
+
+/* Private function prototypes -----------------------------------------------*/
+static void UpdateMaxError(float32_t* maxError, const float32_t* a, const float32_t* b, const uint8_t n);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Measures max difference and cycles per call of the 3x3 kernels against the CMSIS matrix functions, and
+ *         prints them as a table
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @retval Length of the table string
+ */
+size_t Matrix3Benchmark(char* dst, const size_t dstSize) {
+	float32_t a[9] = { 0.9f, -0.3f, 0.2f, 0.3f, 0.95f, -0.1f, -0.2f, 0.1f, 0.97f };
+	float32_t b[9] = { 1.0f, 0.004f, 0.0f, 0.0f, 1.0f, -0.004f, 0.0f, 0.0f, 1.0f };
+	float32_t p[9] = { 0.1f, 0.01f, 0.0f, 0.01f, 1.0f, 0.02f, 0.0f, 0.02f, 0.5f };
+	float32_t q[3] = { 1e-4f, 1e-3f, 1e-5f };
+	float32_t v[3] = { 0.5f, -1.5f, 2.0f };
+	float32_t fast[9], lib[9], tmp[9], trans[9];
+	arm_matrix_instance_f32 matA, matB, matP, matV, matLib, matTmp, matTrans;
+	float32_t maxError[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	uint32_t fastCycles[4], libCycles[4];
+	uint32_t start;
+	uint16_t i;
+
+	/* The CMSIS instances are initialised once, as a caller keeping them static would */
+	arm_mat_init_f32(&matA, 3, 3, a);
+	arm_mat_init_f32(&matB, 3, 3, b);
+	arm_mat_init_f32(&matP, 3, 3, p);
+	arm_mat_init_f32(&matV, 3, 1, v);
+	arm_mat_init_f32(&matTmp, 3, 3, tmp);
+	arm_mat_init_f32(&matTrans, 3, 3, trans);
+
+	/* Accuracy, the kernels sum in a different order and may contract to FMA */
+	Mat3Mul(fast, a, b);
+	arm_mat_init_f32(&matLib, 3, 3, lib);
+	arm_mat_mult_f32(&matA, &matB, &matLib);
+	UpdateMaxError(&maxError[0], fast, lib, 9);
+
+	Mat3MulVec3(fast, a, v);
+	arm_mat_init_f32(&matLib, 3, 1, lib);
+	arm_mat_mult_f32(&matA, &matV, &matLib);
+	UpdateMaxError(&maxError[1], fast, lib, 3);
+
+	Mat3TransMulVec3(fast, a, v);
+	arm_mat_trans_f32(&matA, &matTrans);
+	arm_mat_mult_f32(&matTrans, &matV, &matLib);
+	UpdateMaxError(&maxError[2], fast, lib, 3);
+
+	Mat3Propagate(fast, a, p, q);
+	arm_mat_init_f32(&matLib, 3, 3, lib);
+	arm_mat_mult_f32(&matA, &matP, &matTmp);
+	arm_mat_trans_f32(&matA, &matTrans);
+	arm_mat_mult_f32(&matTmp, &matTrans, &matLib);
+	lib[0] += q[0];
+	lib[4] += q[1];
+	lib[8] += q[2];
+	UpdateMaxError(&maxError[3], fast, lib, 9);
+
+	/* Cycles, the input is perturbed each iteration so that the calls are not hoisted out of the loop */
+#define BENCHMARK_LOOP(dstCycles, stmt) \
+	start = GetTimestamp(); \
+	for (i = 0; i < BENCHMARK_SAMPLES; i++) { \
+		v[0] = (float32_t) i; \
+		a[0] = (float32_t) i; \
+		stmt; \
+		benchmarkSink = fast[0] + lib[0]; \
+	} \
+	dstCycles = (GetTimestamp() - start) / BENCHMARK_SAMPLES;
+
+	arm_mat_init_f32(&matLib, 3, 3, lib);
+	BENCHMARK_LOOP(fastCycles[0], Mat3Mul(fast, a, b));
+	BENCHMARK_LOOP(libCycles[0], arm_mat_mult_f32(&matA, &matB, &matLib));
+
+	arm_mat_init_f32(&matLib, 3, 1, lib);
+	BENCHMARK_LOOP(fastCycles[1], Mat3MulVec3(fast, a, v));
+	BENCHMARK_LOOP(libCycles[1], arm_mat_mult_f32(&matA, &matV, &matLib));
+
+	BENCHMARK_LOOP(fastCycles[2], Mat3TransMulVec3(fast, a, v));
+	BENCHMARK_LOOP(libCycles[2], arm_mat_trans_f32(&matA, &matTrans); arm_mat_mult_f32(&matTrans, &matV, &matLib));
+
+	arm_mat_init_f32(&matLib, 3, 3, lib);
+	BENCHMARK_LOOP(fastCycles[3], Mat3Propagate(fast, a, p, q));
+	BENCHMARK_LOOP(libCycles[3], arm_mat_mult_f32(&matA, &matP, &matTmp); arm_mat_trans_f32(&matA, &matTrans);
+			arm_mat_mult_f32(&matTmp, &matTrans, &matLib); lib[0] += q[0]; lib[4] += q[1]; lib[8] += q[2]);
+#undef BENCHMARK_LOOP
+
+	/* Loop overhead is included in both cycle counts */
+	return (size_t) snprintf(dst, dstSize,
+			"\nKernel\t\t Max diff\t Fast [cyc]\t CMSIS [cyc]\n"
+			"mat3*mat3\t %.2e\t %lu\t\t %lu\n"
+			"mat3*vec3\t %.2e\t %lu\t\t %lu\n"
+			"mat3'*vec3\t %.2e\t %lu\t\t %lu\n"
+			"f*p*f'+q\t %.2e\t %lu\t\t %lu\n",
+			(double) maxError[0], (unsigned long) fastCycles[0], (unsigned long) libCycles[0],
+			(double) maxError[1], (unsigned long) fastCycles[1], (unsigned long) libCycles[1],
+			(double) maxError[2], (unsigned long) fastCycles[2], (unsigned long) libCycles[2],
+			(double) maxError[3], (unsigned long) fastCycles[3], (unsigned long) libCycles[3]);
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Keeps the largest element difference of a benchmark
+ * @param  maxError : Largest difference so far
+ * @param  a : First result
+ * @param  b : Second result
+ * @param  n : Number of elements
+ * @retval None
+ */
+static void UpdateMaxError(float32_t* maxError, const float32_t* a, const float32_t* b, const uint8_t n) {
+	uint8_t i;
+
+	for (i = 0; i < n; i++) {
+		if (fabsf(a[i] - b[i]) > *maxError) {
+			*maxError = fabsf(a[i] - b[i]);
+		}
+	}
+}
+
+#endif /* FCB_HOST_BUILD */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,189 @@
+/******************************************************************************
+ * @file    mem_pool.c
+ * @author  Dragonfly
+ * @brief   Fixed-size block memory pools. The free blocks of a pool are a
+ *          singly linked list through the blocks themselves, so an allocation
+ *          takes the head and a free pushes the block back, both in constant
+ *          time with the interrupts masked for a few instructions. The pools
+ *          are initialized at startup and may then be used from tasks and from
+ *          ISRs at or below configMAX_SYSCALL_INTERRUPT_PRIORITY.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "mem_pool.h"
+
+#include "fcb_error.h"
+
+#include "FreeRTOS.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+
+/* Written at startup only */
+static MemPool_TypeDef* memPools[MEM_POOL_MAX_POOLS];
+static uint8_t memPoolCount = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Initializes a pool with all its blocks free and registers it for MemPoolPrint(). Called at startup.
+ * @param  pool : Pool
+ * @param  name : Pool name for the statistics, a string literal
+ * @param  storage : Storage of the blocks, of MEM_POOL_STORAGE_SIZE(blockSize, blocks) elements
+ * @param  blockSize : Size of a block [bytes]
+ * @param  blocks : Number of blocks
+ * @retval FCB_OK if initialized, FCB_ERR if the block size is too large or there are MEM_POOL_MAX_POOLS already
+ */
+FcbRetValType MemPoolInit(MemPool_TypeDef* pool, const char* name, uint64_t* storage, const size_t blockSize,
+		const uint16_t blocks) {
+	size_t blockUnits = MEM_POOL_BLOCK_UNITS(blockSize);
+	uint16_t i;
+
+	if (blockUnits * sizeof(uint64_t) > UINT16_MAX || memPoolCount >= MEM_POOL_MAX_POOLS) {
+		ErrorHandler();
+		return FCB_ERR;
+	}
+
+	memset(pool, 0, sizeof(MemPool_TypeDef));
+	pool->name = name;
+	pool->storage = storage;
+	pool->stats.blockSize = (uint16_t) (blockUnits * sizeof(uint64_t));
+	pool->stats.blocks = blocks;
+
+	/* Linked in storage order, the first allocation gets the first block */
+	for (i = blocks; i > 0; i--) {
+		MemPoolBlock_TypeDef* block = (MemPoolBlock_TypeDef*) &storage[(i - 1) * blockUnits];
+		block->next = pool->freeList;
+		pool->freeList = block;
+	}
+
+	memPools[memPoolCount++] = pool;
+
+	return FCB_OK;
+}
+
+/*
+ * @brief  Allocates a block of a pool
+ * @param  pool : Pool
+ * @retval The block, NULL if the pool is empty
+ */
+void* MemPoolAlloc(MemPool_TypeDef* pool) {
+	unsigned portBASE_TYPE savedInterruptStatus;
+	MemPoolBlock_TypeDef* block;
+
+	savedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+
+	block = pool->freeList;
+	if (block != NULL) {
+		pool->freeList = block->next;
+		pool->stats.used++;
+		pool->stats.allocations++;
+		if (pool->stats.used > pool->stats.peakUsed) {
+			pool->stats.peakUsed = pool->stats.used;
+		}
+	} else {
+		pool->stats.failures++;
+	}
+
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(savedInterruptStatus);
+
+	return block;
+}
+
+/*
+ * @brief  Returns a block to its pool. A block that is not one of the pool is an error and is not freed.
+ * @param  pool : Pool the block was allocated from
+ * @param  block : Block, NULL is ignored
+ * @retval None
+ */
+void MemPoolFree(MemPool_TypeDef* pool, void* block) {
+	unsigned portBASE_TYPE savedInterruptStatus;
+	size_t offset;
+
+	if (NULL == block) {
+		return;
+	}
+
+	offset = (size_t) ((uint8_t*) block - (uint8_t*) pool->storage);
+	if ((uint8_t*) block < (uint8_t*) pool->storage || offset % pool->stats.blockSize != 0
+			|| offset / pool->stats.blockSize >= pool->stats.blocks) {
+		ErrorHandler();
+		return;
+	}
+
+	savedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+
+	((MemPoolBlock_TypeDef*) block)->next = pool->freeList;
+	pool->freeList = (MemPoolBlock_TypeDef*) block;
+	pool->stats.used--;
+
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(savedInterruptStatus);
+}
+
+/*
+ * @brief  Gets a consistent copy of the statistics of a pool
+ * @param  pool : Pool
+ * @param  dstStats : Destination statistics
+ * @retval None
+ */
+void MemPoolGetStats(const MemPool_TypeDef* pool, MemPoolStats_TypeDef* dstStats) {
+	unsigned portBASE_TYPE savedInterruptStatus;
+
+	savedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+	*dstStats = pool->stats;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(savedInterruptStatus);
+}
+
+/*
+ * @brief  Prints the statistics of the registered pools from nextPool on, as many as fit whole in dst, after the
+ *         table header if nextPool is the first one. A long table is thereby printed over several calls.
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @param  nextPool : First pool to print, 0 for the header, set to the first pool not printed
+ * @retval Length of the string, 0 once all pools have been printed
+ */
+size_t MemPoolPrint(char* dst, const size_t dstSize, uint8_t* nextPool) {
+	MemPoolStats_TypeDef stats;
+	size_t length = 0;
+	size_t rowLength;
+
+	if (*nextPool >= memPoolCount || 0 == dstSize) {
+		return 0;
+	}
+
+	if (0 == *nextPool) {
+		length = (size_t) snprintf(dst, dstSize, "%-14s%7s%7s%6s%6s%11s%9s\n", "Pool", "Block", "Blocks", "Used",
+				"Peak", "Allocs", "Failed");
+	}
+
+	while (*nextPool < memPoolCount && length < dstSize) {
+		MemPoolGetStats(memPools[*nextPool], &stats);
+		rowLength = (size_t) snprintf(dst + length, dstSize - length, "%-14s%7u%7u%6u%6u%11lu%9lu\n",
+				memPools[*nextPool]->name, stats.blockSize, stats.blocks, stats.used, stats.peakUsed,
+				(unsigned long) stats.allocations, (unsigned long) stats.failures);
+		if (rowLength >= dstSize - length) {
+			dst[length] = '\0'; // Printed in the next call
+			break;
+		}
+		length += rowLength;
+		(*nextPool)++;
+	}
+
+	return length;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,577 @@
+/******************************************************************************
+ * @file    perf_snapshot.c
+ * @author  Dragonfly
+ * @brief   Performance snapshot and baseline compare, see perf_snapshot.h.
+ *          The snapshot is taken by the rate group task and read by the CLI
+ *          and telemetry tasks, each with the scheduler suspended. The
+ *          statistics it is made of are read one probe, loop, handler or
+ *          buffer at a time, and the readers print and encode it one field at
+ *          a time, so that no task needs a copy of it or of the statistics.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "perf_snapshot.h"
+
+#ifdef FCB_PERF_SNAPSHOT
+
+#include "isr_monitor.h"
+#include "buffer_monitor.h"
+#include "task_status.h"
+#include "cpu_headroom.h"
+#include "firmware_update.h"
+#include "flight_control.h"
+#include "flash.h"
+#include "rate_groups.h"
+#include "fcb_error.h"
+#include "fcb_port.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+	const char* name;
+	const char* unit;
+	bool isLowerWorse;              // For the margins and rates, else a higher value is worse
+} PerfField_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+
+/* First field of each group, in the order of the CSV columns */
+#define PERF_FIELD_PROFILE_MAX      0
+#define PERF_FIELD_PROFILE_MEAN     (PERF_FIELD_PROFILE_MAX + PROFILE_PROBE_NBR)
+#define PERF_FIELD_DEADLINE         (PERF_FIELD_PROFILE_MEAN + PROFILE_PROBE_NBR)   // Per loop, see PERF_FIELD_WCET
+#define PERF_FIELD_SYSTEM           (PERF_FIELD_DEADLINE + 3*DEADLINE_LOOP_NBR)
+#define PERF_FIELD_SENSOR_RATE      (PERF_FIELD_SYSTEM + PERF_SNAPSHOT_SYSTEM_FIELD_NBR)
+#define PERF_FIELD_SENSOR_MISSED    (PERF_FIELD_SENSOR_RATE + FCB_SENSOR_NBR)
+
+/* Offsets in the deadline fields of a loop */
+#define PERF_FIELD_WCET             0
+#define PERF_FIELD_JITTER           1
+#define PERF_FIELD_LATE             2
+
+/* Offsets in the system fields */
+#define PERF_FIELD_ISR_LOAD         0
+#define PERF_FIELD_ISR_MAX          1
+#define PERF_FIELD_BUFFER_FILL      2
+#define PERF_FIELD_BUFFER_OVERFLOWS 3
+#define PERF_FIELD_HEADROOM         4
+#define PERF_FIELD_STACK            5
+#define PERF_FIELD_HEAP             6
+
+#define PERF_LOAD_FULL              10000   // [0.01 %]
+
+/* Private macro -------------------------------------------------------------*/
+#define PERF_FIELD_BIT(FIELD)       (1ULL << (FIELD))
+
+/* Private variables ---------------------------------------------------------*/
+
+/* In the order of the snapshot values */
+static const PerfField_TypeDef perfFields[PERF_SNAPSHOT_FIELD_NBR] = {
+	{ "prediction_max", "cycles", false },
+	{ "correction_max", "cycles", false },
+	{ "pid_max", "cycles", false },
+	{ "motor_alloc_max", "cycles", false },
+	{ "gyro_fetch_max", "cycles", false },
+	{ "gyro_drdy_isr_max", "cycles", false },
+	{ "gyro_dma_isr_max", "cycles", false },
+	{ "ref_signals_max", "cycles", false },
+	{ "baro_fetch_max", "cycles", false },
+	{ "prediction_mean", "cycles", false },
+	{ "correction_mean", "cycles", false },
+	{ "pid_mean", "cycles", false },
+	{ "motor_alloc_mean", "cycles", false },
+	{ "gyro_fetch_mean", "cycles", false },
+	{ "gyro_drdy_isr_mean", "cycles", false },
+	{ "gyro_dma_isr_mean", "cycles", false },
+	{ "ref_signals_mean", "cycles", false },
+	{ "baro_fetch_mean", "cycles", false },
+	{ "inner_wcet", "cycles", false },
+	{ "inner_jitter", "cycles", false },
+	{ "inner_late", "count", false },
+	{ "outer_wcet", "cycles", false },
+	{ "outer_jitter", "cycles", false },
+	{ "outer_late", "count", false },
+	{ "estimator_wcet", "cycles", false },
+	{ "estimator_jitter", "cycles", false },
+	{ "estimator_late", "count", false },
+	{ "isr_load", "0.01%", false },
+	{ "isr_max", "cycles", false },
+	{ "buffer_fill_max", "%", false },
+	{ "buffer_overflows", "count", false },
+	{ "cpu_headroom_min", "0.01%", true },
+	{ "stack_free_min", "bytes", true },
+	{ "heap_free_min", "bytes", true },
+	{ "gyro_rate", "0.01Hz", true },
+	{ "acc_rate", "0.01Hz", true },
+	{ "mag_rate", "0.01Hz", true },
+	{ "baro_rate", "0.01Hz", true },
+	{ "gyro_missed", "count", false },
+	{ "acc_missed", "count", false },
+	{ "mag_missed", "count", false },
+	{ "baro_missed", "count", false }
+};
+
+/* Written by the rate group task, and the baseline by a CLI command, each with the scheduler suspended */
+static PerfSnapshot_TypeDef perfSnapshot;
+static uint64_t perfRegressions = 0;    // PERF_FIELD_BIT() mask of the latest snapshot
+static PerfBaseline_TypeDef perfBaseline;
+static bool isPerfBaselineValid = false;
+
+static uint16_t perfSnapshotPeriod = PERF_SNAPSHOT_DEFAULT_PERIOD;
+static uint16_t secondsSinceSnapshot = 0;
+
+/* Snapshot being taken by the rate group task, published to perfSnapshot when complete */
+static PerfSnapshot_TypeDef snapshotScratch;
+
+/* Next field of the PERF_SNAPSHOT_MSG_ENUM message, telemetry task only */
+static uint8_t nextEncodedField = 0;
+
+static RateGroupJobId_TypeDef perfSnapshotJobId = RATE_GROUP_INVALID_ID;
+
+/* Private function prototypes -----------------------------------------------*/
+static void PerfSnapshotJob(void* argument);
+static void CaptureSystemFields(uint32_t values[PERF_SNAPSHOT_SYSTEM_FIELD_NBR]);
+static bool IsPerfRegression(const uint8_t field, const uint32_t value, const uint32_t baseline);
+static bool GetPerfSnapshotField(const uint8_t field, uint32_t* value, uint32_t* baselineValue);
+
+/* Exported functions --------------------------------------------------------*/
+
+/**
+ * @brief  Loads the baseline from the settings store and starts taking snapshots in the 1 Hz rate group. Called
+ *         once at startup, after the settings store is initialized.
+ * @param  None
+ * @retval None
+ */
+void InitPerfSnapshot(void) {
+	isPerfBaselineValid = (FLASH_OK == ReadPerfBaselineFromFlash(&perfBaseline));
+
+	if (FCB_OK != RateGroupRegister("PERF_SNAPSHOT", PerfSnapshotJob, NULL, RATE_GROUP_1HZ, PERF_SNAPSHOT_PHASE,
+			&perfSnapshotJobId)) {
+		ErrorHandler();
+	}
+}
+
+/**
+ * @brief  Sets the time between the snapshots, not stored
+ * @param  period : Time between the snapshots [s], [1, PERF_SNAPSHOT_MAX_PERIOD]
+ * @retval FCB_OK if set, else FCB_ERR
+ */
+FcbRetValType PerfSnapshotSetPeriod(const uint16_t period) {
+	if (period < 1 || period > PERF_SNAPSHOT_MAX_PERIOD) {
+		return FCB_ERR;
+	}
+
+	perfSnapshotPeriod = period;
+
+	return FCB_OK;
+}
+
+uint16_t PerfSnapshotGetPeriod(void) {
+	return perfSnapshotPeriod;
+}
+
+void PerfSnapshotGet(PerfSnapshot_TypeDef* dstSnapshot) {
+	FCB_SUSPEND_SCHEDULER();
+	*dstSnapshot = perfSnapshot;
+	FCB_RESUME_SCHEDULER();
+}
+
+/**
+ * @brief  Clears the profiler, deadline monitor, ISR monitor and sensor data rate statistics, so that the next
+ *         snapshots cover the time from now, e.g. a flight. The buffer high water marks and the least CPU headroom,
+ *         stack and heap since startup cannot be cleared.
+ * @param  None
+ * @retval None
+ */
+void PerfSnapshotReset(void) {
+	ProfileReset();
+	DeadlineMonitorReset();
+	IsrMonitorReset();
+	ResetSensorDataRateStats();
+}
+
+/**
+ * @brief  Gets the name of a snapshot field, as in the CSV header
+ * @param  field : Field index, below PERF_SNAPSHOT_FIELD_NBR
+ * @retval Name, or "?" for an invalid field
+ */
+const char* GetPerfSnapshotFieldName(const uint8_t field) {
+	if (field >= PERF_SNAPSHOT_FIELD_NBR) {
+		return "?";
+	}
+
+	return perfFields[field].name;
+}
+
+/**
+ * @brief  Saves the latest snapshot as the baseline, with the CRC of the running firmware image. Runs the image CRC,
+ *         to be called from a CLI command.
+ * @param  None
+ * @retval FCB_OK if saved, FCB_ERR if not in idle mode, before the first snapshot or if the write failed
+ */
+FcbRetValType PerfBaselineSave(void) {
+	FirmwareImageInfo_TypeDef imageInfo;
+	PerfBaseline_TypeDef baseline;
+
+	if (FLIGHT_CONTROL_IDLE != GetFlightControlMode()) {
+		return FCB_ERR;
+	}
+
+	PerfSnapshotGet(&baseline.snapshot);
+	if (0 == baseline.snapshot.timestamp || FCB_OK != GetFirmwareImageInfo(&imageInfo)) {
+		return FCB_ERR;
+	}
+
+	baseline.imageCrc = imageInfo.crc;
+	baseline.imageSize = imageInfo.size;
+	if (FLASH_OK != WritePerfBaselineToFlash(&baseline)) {
+		return FCB_ERR;
+	}
+
+	FCB_SUSPEND_SCHEDULER();
+	perfBaseline = baseline;
+	isPerfBaselineValid = true;
+	FCB_RESUME_SCHEDULER();
+
+	return FCB_OK;
+}
+
+/**
+ * @brief  Gets the baseline the snapshots are compared with
+ * @param  dstBaseline : Destination baseline
+ * @retval true if there is a baseline, else false
+ */
+bool PerfBaselineGet(PerfBaseline_TypeDef* dstBaseline) {
+	bool isValid;
+
+	FCB_SUSPEND_SCHEDULER();
+	*dstBaseline = perfBaseline;
+	isValid = isPerfBaselineValid;
+	FCB_RESUME_SCHEDULER();
+
+	return isValid;
+}
+
+/**
+ * @brief  Prints the latest snapshot as a table with the baseline and the regressions
+ * @param  dst : Destination string
+ * @param  dstSize : Size of the destination string
+ * @retval Length of the string
+ */
+size_t PerfSnapshotPrint(char* dst, const size_t dstSize) {
+	uint32_t value;
+	uint32_t baselineValue;
+	bool isRegression;
+	char baselineString[12];
+	size_t length;
+	uint8_t field;
+
+	/* Read without the lock, the baseline only changes when saved from the CLI */
+	length = (size_t) snprintf(dst, dstSize, "\nPerformance snapshot at %lu ms, every %u s\n", perfSnapshot.timestamp,
+			perfSnapshotPeriod);
+	if (isPerfBaselineValid) {
+		length += (size_t) snprintf(dst + length, (length < dstSize) ? dstSize - length : 0,
+				"Baseline of image CRC 0x%08lX taken at %lu ms\n", perfBaseline.imageCrc,
+				perfBaseline.snapshot.timestamp);
+	} else {
+		length += (size_t) snprintf(dst + length, (length < dstSize) ? dstSize - length : 0, "No baseline\n");
+	}
+
+	for (field = 0; field < PERF_SNAPSHOT_FIELD_NBR && length < dstSize; field++) {
+		isRegression = GetPerfSnapshotField(field, &value, &baselineValue);
+		if (isPerfBaselineValid) {
+			snprintf(baselineString, sizeof(baselineString), "%lu", baselineValue);
+		} else {
+			strcpy(baselineString, "-");
+		}
+		length += (size_t) snprintf(dst + length, dstSize - length, "%-20s %-7s %10lu %10s %s\n",
+				perfFields[field].name, perfFields[field].unit, value, baselineString,
+				isRegression ? "REGRESSION" : "");
+	}
+
+	return (length < dstSize) ? length : dstSize - 1;
+}
+
+/**
+ * @brief  Prints the latest snapshot as CSV, a header line with the field names and a line with the values, both
+ *         starting with the timestamp [ms]. Rows of several prints can be appended under one header.
+ * @param  dst : Destination string
+ * @param  dstSize : Size of the destination string
+ * @retval Length of the string
+ */
+size_t PerfSnapshotPrintCsv(char* dst, const size_t dstSize) {
+	uint32_t value;
+	uint32_t baselineValue;
+	size_t length;
+	uint8_t field;
+
+	length = (size_t) snprintf(dst, dstSize, "timestamp");
+	for (field = 0; field < PERF_SNAPSHOT_FIELD_NBR && length < dstSize; field++) {
+		length += (size_t) snprintf(dst + length, dstSize - length, ",%s", perfFields[field].name);
+	}
+
+	if (length < dstSize) {
+		length += (size_t) snprintf(dst + length, dstSize - length, "\n%lu", perfSnapshot.timestamp);
+	}
+	for (field = 0; field < PERF_SNAPSHOT_FIELD_NBR && length < dstSize; field++) {
+		GetPerfSnapshotField(field, &value, &baselineValue);
+		length += (size_t) snprintf(dst + length, dstSize - length, ",%lu", value);
+	}
+
+	if (length < dstSize) {
+		length += (size_t) snprintf(dst + length, dstSize - length, "\n");
+	}
+
+	return (length < dstSize) ? length : dstSize - 1;
+}
+
+/**
+ * @brief  Prints the fields of the latest snapshot that regressed against the baseline, and whether the baseline was
+ *         taken with the running firmware image. Runs the image CRC, to be called from a CLI command.
+ * @param  dst : Destination string
+ * @param  dstSize : Size of the destination string
+ * @retval Length of the string
+ */
+size_t PerfBaselineCompare(char* dst, const size_t dstSize) {
+	FirmwareImageInfo_TypeDef imageInfo;
+	uint32_t value;
+	uint32_t baselineValue;
+	uint8_t regressionCount = 0;
+	size_t length;
+	uint8_t field;
+
+	/* Read without the lock, the baseline only changes when saved from the CLI */
+	if (!isPerfBaselineValid) {
+		return (size_t) snprintf(dst, dstSize, "No baseline, save one with save-perf-baseline\n");
+	}
+
+	if (FCB_OK != GetFirmwareImageInfo(&imageInfo)) {
+		imageInfo.crc = 0;
+	}
+
+	length = (size_t) snprintf(dst, dstSize, "\nBaseline of image CRC 0x%08lX, running image CRC 0x%08lX%s\n",
+			perfBaseline.imageCrc, imageInfo.crc, (perfBaseline.imageCrc == imageInfo.crc) ? ", same build" : "");
+
+	for (field = 0; field < PERF_SNAPSHOT_FIELD_NBR && length < dstSize; field++) {
+		if (GetPerfSnapshotField(field, &value, &baselineValue)) {
+			length += (size_t) snprintf(dst + length, dstSize - length, "%-20s %10lu -> %10lu %s\n",
+					perfFields[field].name, baselineValue, value, perfFields[field].unit);
+			regressionCount++;
+		}
+	}
+
+	if (length < dstSize) {
+		length += (size_t) snprintf(dst + length, dstSize - length, "%u of %u fields regressed by more than %u %%\n",
+				regressionCount, PERF_SNAPSHOT_FIELD_NBR, PERF_REGRESSION_TOLERANCE);
+	}
+
+	return (length < dstSize) ? length : dstSize - 1;
+}
+
+/**
+ * @brief  Encodes the next PERF_SNAPSHOT_MSG_FIELDS fields of the latest snapshot as a PerfSnapshotProto message, see
+ *         perf_snapshot.h. The fields rotate over the messages, from the telemetry task only.
+ * @param  stream : Destination stream
+ * @retval true if encoded, else false
+ */
+bool EncodePerfSnapshot(pb_ostream_t* stream) {
+	uint8_t valuesBuffer[5*PERF_SNAPSHOT_MSG_FIELDS];
+	pb_ostream_t valuesStream = pb_ostream_from_buffer(valuesBuffer, sizeof(valuesBuffer));
+	const uint8_t firstField = nextEncodedField;
+	uint32_t regressions = 0;
+	uint32_t value;
+	uint32_t baselineValue;
+	uint8_t fields;
+	uint8_t i;
+
+	fields = PERF_SNAPSHOT_FIELD_NBR - firstField;
+	fields = (fields > PERF_SNAPSHOT_MSG_FIELDS) ? PERF_SNAPSHOT_MSG_FIELDS : fields;
+	nextEncodedField = (firstField + fields < PERF_SNAPSHOT_FIELD_NBR) ? firstField + fields : 0;
+
+	/* Packed, so the value varints follow each other in one length delimited field */
+	for (i = 0; i < fields; i++) {
+		if (GetPerfSnapshotField(firstField + i, &value, &baselineValue)) {
+			regressions |= (uint32_t) PERF_FIELD_BIT(i);
+		}
+		if (!pb_encode_varint(&valuesStream, value)) {
+			return false;
+		}
+	}
+
+	if (!pb_encode_tag(stream, PB_WT_VARINT, 1) || !pb_encode_varint(stream, perfSnapshot.timestamp)
+			|| !pb_encode_tag(stream, PB_WT_VARINT, 2) || !pb_encode_varint(stream, PERF_SNAPSHOT_FIELD_NBR)
+			|| !pb_encode_tag(stream, PB_WT_VARINT, 3) || !pb_encode_varint(stream, firstField)
+			|| !pb_encode_tag(stream, PB_WT_STRING, 4)
+			|| !pb_encode_string(stream, valuesBuffer, valuesStream.bytes_written)
+			|| !pb_encode_tag(stream, PB_WT_VARINT, 5) || !pb_encode_varint(stream, regressions)) {
+		return false;
+	}
+
+	/* Read without the lock, the baseline only changes when saved from the CLI */
+	if (isPerfBaselineValid) {
+		return pb_encode_tag(stream, PB_WT_VARINT, 6) && pb_encode_varint(stream, perfBaseline.imageCrc);
+	}
+
+	return true;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief  Takes a snapshot every perfSnapshotPeriod and compares it with the baseline, rate group job
+ * @param  argument : Unused
+ * @retval None
+ */
+static void PerfSnapshotJob(void* argument) {
+	FcbSensorDataRateStatsType sensorStats;
+	ProfileProbeStats_TypeDef probeStats;
+	DeadlineLoopStats_TypeDef loopStats[DEADLINE_LOOP_NBR];
+	uint32_t* values = snapshotScratch.values;
+	uint64_t regressions = 0;
+	uint8_t i;
+
+	(void) argument;
+
+	if (++secondsSinceSnapshot < perfSnapshotPeriod) {
+		return;
+	}
+	secondsSinceSnapshot = 0;
+
+	for (i = 0; i < PROFILE_PROBE_NBR; i++) {
+		ProfileGetProbeStats((ProfileProbe_TypeDef) i, &probeStats);
+		values[PERF_FIELD_PROFILE_MAX + i] = probeStats.max;
+		values[PERF_FIELD_PROFILE_MEAN + i] = (probeStats.count > 0) ?
+				(uint32_t) (probeStats.sum / probeStats.count) : 0;
+	}
+
+	DeadlineMonitorGetStats(loopStats);
+	for (i = 0; i < DEADLINE_LOOP_NBR; i++) {
+		values[PERF_FIELD_DEADLINE + 3*i + PERF_FIELD_WCET] = loopStats[i].wcet;
+		values[PERF_FIELD_DEADLINE + 3*i + PERF_FIELD_JITTER] = loopStats[i].maxJitter;
+		values[PERF_FIELD_DEADLINE + 3*i + PERF_FIELD_LATE] = loopStats[i].lateStarts;
+	}
+
+	CaptureSystemFields(&values[PERF_FIELD_SYSTEM]);
+
+	for (i = 0; i < FCB_SENSOR_NBR; i++) {
+		GetSensorDataRateStats((FcbSensorIndexType) i, &sensorStats);
+		values[PERF_FIELD_SENSOR_RATE + i] = (uint32_t) (sensorStats.measuredRateHz*100.0f + 0.5f);
+		values[PERF_FIELD_SENSOR_MISSED + i] = sensorStats.missedDrdys;
+	}
+
+	snapshotScratch.timestamp = (uint32_t) xTaskGetTickCount() * portTICK_RATE_MS;
+
+	FCB_SUSPEND_SCHEDULER();
+	if (isPerfBaselineValid) {
+		for (i = 0; i < PERF_SNAPSHOT_FIELD_NBR; i++) {
+			if (IsPerfRegression(i, values[i], perfBaseline.snapshot.values[i])) {
+				regressions |= PERF_FIELD_BIT(i);
+			}
+		}
+	}
+	perfSnapshot = snapshotScratch;
+	perfRegressions = regressions;
+	FCB_RESUME_SCHEDULER();
+}
+
+/**
+ * @brief  Captures the interrupt load, buffer and memory fields of a snapshot
+ * @param  values : Destination system fields, in the order of the PERF_FIELD_ISR_LOAD offsets
+ * @retval None
+ */
+static void CaptureSystemFields(uint32_t values[PERF_SNAPSHOT_SYSTEM_FIELD_NBR]) {
+	CpuHeadroom_TypeDef headroom;
+	HeapStatus_TypeDef heap;
+	IsrStats_TypeDef isrStats;
+	BufferStatus_TypeDef bufferStatus;
+	uint64_t isrCycles = 0;
+	uint64_t windowCycles;
+	uint32_t window = 0;
+	uint8_t i;
+
+	values[PERF_FIELD_ISR_MAX] = 0;
+	for (i = 0; i < ISR_MONITOR_NBR; i++) {
+		window = IsrMonitorGetStats((IsrMonitorVector_TypeDef) i, &isrStats);
+		isrCycles += isrStats.cycles;
+		if (isrStats.maxCycles > values[PERF_FIELD_ISR_MAX]) {
+			values[PERF_FIELD_ISR_MAX] = isrStats.maxCycles;
+		}
+	}
+	windowCycles = (uint64_t) window * (SystemCoreClock / 1000);
+	values[PERF_FIELD_ISR_LOAD] = (windowCycles > 0) ? (uint32_t) (isrCycles * PERF_LOAD_FULL / windowCycles) : 0;
+
+	values[PERF_FIELD_BUFFER_FILL] = 0;
+	values[PERF_FIELD_BUFFER_OVERFLOWS] = 0;
+	for (i = 0; GetBufferStatusByIndex(i, &bufferStatus); i++) {
+		uint32_t fill = (bufferStatus.capacity > 0) ?
+				(uint32_t) bufferStatus.highWater * 100 / bufferStatus.capacity : 0;
+
+		if (fill > values[PERF_FIELD_BUFFER_FILL]) {
+			values[PERF_FIELD_BUFFER_FILL] = fill;
+		}
+		values[PERF_FIELD_BUFFER_OVERFLOWS] += bufferStatus.overflows;
+	}
+
+	GetCpuHeadroom(&headroom);
+	values[PERF_FIELD_HEADROOM] = headroom.minHeadroom;
+
+	values[PERF_FIELD_STACK] = GetMinStackHighWaterMark();
+
+	GetHeapStatus(&heap);
+	values[PERF_FIELD_HEAP] = (uint32_t) heap.minimumEverFree;
+}
+
+/**
+ * @brief  Checks if a field is worse than the baseline by more than PERF_REGRESSION_TOLERANCE, and by more than one
+ *         unit
+ * @param  field : Field index
+ * @param  value : Value of the field
+ * @param  baseline : Value of the field in the baseline
+ * @retval true if the field regressed, else false
+ */
+static bool IsPerfRegression(const uint8_t field, const uint32_t value, const uint32_t baseline) {
+	uint32_t margin = (uint32_t) ((uint64_t) baseline * PERF_REGRESSION_TOLERANCE / 100);
+
+	margin = (margin > 1) ? margin : 1;
+
+	if (perfFields[field].isLowerWorse) {
+		return value < baseline && baseline - value > margin;
+	}
+
+	return value > baseline && value - baseline > margin;
+}
+
+/**
+ * @brief  Gets a field of the latest snapshot with its baseline value and whether it regressed, at one instant. The
+ *         fields of a table printed while a new snapshot is published may come from the two snapshots.
+ * @param  field : Field index, below PERF_SNAPSHOT_FIELD_NBR
+ * @param  value : Destination value
+ * @param  baselineValue : Destination baseline value, meaningless without a baseline
+ * @retval true if the field regressed, else false
+ */
+static bool GetPerfSnapshotField(const uint8_t field, uint32_t* value, uint32_t* baselineValue) {
+	bool isRegression;
+
+	FCB_SUSPEND_SCHEDULER();
+	*value = perfSnapshot.values[field];
+	*baselineValue = perfBaseline.snapshot.values[field];
+	isRegression = (0 != (perfRegressions & PERF_FIELD_BIT(field)));
+	FCB_RESUME_SCHEDULER();
+
+	return isRegression;
+}
+
+#endif /* FCB_PERF_SNAPSHOT */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,243 @@
+/******************************************************************************
+ * @file    profiler.c
+ * @author  Dragonfly
+ * @brief   Execution time profiler. The probes of profiler.h stamp the start
+ *          and end of a code section with the DWT cycle counter and add the
+ *          duration to the statistics of the probe. Probes are recorded from
+ *          tasks and ISRs alike, so the statistics are updated with the
+ *          interrupts masked. Durations include the preemption by higher
+ *          priority tasks and ISRs, so the minimum is the best estimate of
+ *          the cost of the section itself.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "profiler.h"
+#include "ram_func.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+#ifdef FCB_PROFILING
+static ProfileProbeStats_TypeDef probeStats[PROFILE_PROBE_NBR];
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Adds a duration to the statistics of a probe. May be called from an ISR.
+ * @param  probe : Probe
+ * @param  cycles : Duration [core clock cycles]
+ * @retval None
+ */
+void ProfileRecord(const ProfileProbe_TypeDef probe, const uint32_t cycles) {
+#ifdef FCB_PROFILING
+	ProfileProbeStats_TypeDef* stats;
+	portBASE_TYPE savedInterruptStatus;
+	uint32_t bin;
+
+	if (probe >= PROFILE_PROBE_NBR) {
+		return;
+	}
+
+	/* Floor of log2, durations below 2 cycles land in the first bin */
+	bin = (cycles < 2) ? 0 : 31 - __CLZ(cycles);
+	if (bin >= PROFILE_HISTOGRAM_BINS) {
+		bin = PROFILE_HISTOGRAM_BINS - 1;
+	}
+
+	stats = &probeStats[probe];
+
+	/* Probed ISRs may preempt a probed task, e.g. the gyroscope ISRs the estimator */
+	savedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+	if (0 == stats->count || cycles < stats->min) {
+		stats->min = cycles;
+	}
+	if (cycles > stats->max) {
+		stats->max = cycles;
+	}
+	stats->sum += cycles;
+	stats->count++;
+	stats->histogram[bin]++;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(savedInterruptStatus);
+#else
+	(void) probe;
+	(void) cycles;
+#endif
+}
+
+/*
+ * @brief  Completes the measurement of PROFILE_SCOPE() when its block is left
+ * @param  scope : Open measurement
+ * @retval None
+ */
+void ProfileEndScope(const ProfileScope_TypeDef* scope) {
+	ProfileRecord(scope->probe, DWT->CYCCNT - scope->start);
+}
+
+/*
+ * @brief  Gets a consistent copy of the statistics of all probes, all zero without FCB_PROFILING
+ * @param  dstSnapshot : Destination snapshot
+ * @param  reset : true to clear the statistics in the same critical section, so that consecutive snapshots cover
+ *         consecutive intervals without a gap
+ * @retval None
+ */
+void ProfileGetSnapshot(ProfileSnapshot_TypeDef* dstSnapshot, const bool reset) {
+#ifdef FCB_PROFILING
+	taskENTER_CRITICAL();
+	memcpy(dstSnapshot->probe, probeStats, sizeof(probeStats));
+	if (reset) {
+		memset(probeStats, 0, sizeof(probeStats));
+	}
+	taskEXIT_CRITICAL();
+#else
+	(void) reset;
+	memset(dstSnapshot->probe, 0, sizeof(dstSnapshot->probe));
+#endif
+
+	dstSnapshot->coreClock = SystemCoreClock;
+}
+
+/*
+ * @brief  Gets a consistent copy of the statistics of one probe, all zero without FCB_PROFILING
+ * @param  probe : Probe to copy
+ * @param  dstStats : Destination statistics
+ * @retval None
+ */
+void ProfileGetProbeStats(const ProfileProbe_TypeDef probe, ProfileProbeStats_TypeDef* dstStats) {
+#ifdef FCB_PROFILING
+	taskENTER_CRITICAL();
+	*dstStats = probeStats[probe];
+	taskEXIT_CRITICAL();
+#else
+	(void) probe;
+	memset(dstStats, 0, sizeof(ProfileProbeStats_TypeDef));
+#endif
+}
+
+/*
+ * @brief  Clears the statistics of all probes
+ * @param  None
+ * @retval None
+ */
+void ProfileReset(void) {
+#ifdef FCB_PROFILING
+	taskENTER_CRITICAL();
+	memset(probeStats, 0, sizeof(probeStats));
+	taskEXIT_CRITICAL();
+#endif
+}
+
+/*
+ * @brief  Prints a snapshot as a table, with the non-empty histogram bins below each probe
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @param  snapshot : Snapshot to print
+ * @retval Length of the table string
+ */
+size_t ProfilePrint(char* dst, const size_t dstSize, const ProfileSnapshot_TypeDef* snapshot) {
+	static const char* probeNames[PROFILE_PROBE_NBR] = { "Prediction", "Correction", "PID", "MotorAlloc",
+			"GyroFetch", "GyroDrdyISR", "GyroDmaISR", "RefSignals", "BaroFetch" };
+	const ProfileProbeStats_TypeDef* stats;
+	uint32_t cyclesPerUs = snapshot->coreClock / 1000000;
+	uint32_t mean;
+	size_t length;
+	uint8_t i, j;
+
+#ifndef FCB_PROFILING
+	length = (size_t) snprintf(dst, dstSize, "Profiling not compiled in, see FCB_PROFILING in profiler.h\n");
+#else
+	length = 0;
+#endif
+
+	if (length < dstSize) {
+#ifdef FCB_RAM_FUNC
+		length += (size_t) snprintf(dst + length, dstSize - length, "\nProfile [cycles], RAMFUNC code in SRAM\n");
+#else
+		length += (size_t) snprintf(dst + length, dstSize - length, "\nProfile [cycles], RAMFUNC code in flash\n");
+#endif
+	}
+
+	if (length < dstSize) {
+		length += (size_t) snprintf(dst + length, dstSize - length, "%-12s%10s%8s%8s%8s%8s\n",
+				"Probe", "Count", "Min", "Avg", "Max", "Avg[us]");
+	}
+
+	for (i = 0; i < PROFILE_PROBE_NBR && length < dstSize; i++) {
+		stats = &snapshot->probe[i];
+		if (0 == stats->count) {
+			length += (size_t) snprintf(dst + length, dstSize - length, "%-12s%10s\n", probeNames[i], "-");
+			continue;
+		}
+
+		mean = (uint32_t) (stats->sum / stats->count);
+		length += (size_t) snprintf(dst + length, dstSize - length, "%-12s%10lu%8lu%8lu%8lu%8lu\n", probeNames[i],
+				(unsigned long) stats->count, (unsigned long) stats->min, (unsigned long) mean,
+				(unsigned long) stats->max, (unsigned long) (cyclesPerUs > 0 ? mean / cyclesPerUs : 0));
+
+		for (j = 0; j < PROFILE_HISTOGRAM_BINS && length < dstSize; j++) {
+			if (stats->histogram[j] > 0) {
+				length += (size_t) snprintf(dst + length, dstSize - length, " <%lu:%lu", 2UL << j,
+						(unsigned long) stats->histogram[j]);
+			}
+		}
+		if (length < dstSize) {
+			length += (size_t) snprintf(dst + length, dstSize - length, "\n");
+		}
+	}
+
+	return length;
+}
+
+/*
+ * @brief  Encodes the statistics of one probe of a snapshot as a ProfileProbeProto message, see profiler.h
+ * @param  stream : Destination stream
+ * @param  snapshot : Snapshot
+ * @param  probe : Probe to encode
+ * @retval true if encoded, else false
+ */
+bool EncodeProfileProbe(pb_ostream_t* stream, const ProfileSnapshot_TypeDef* snapshot,
+		const ProfileProbe_TypeDef probe) {
+	const ProfileProbeStats_TypeDef* stats = &snapshot->probe[probe];
+	uint8_t histogramBuffer[5*PROFILE_HISTOGRAM_BINS];
+	pb_ostream_t histogramStream = pb_ostream_from_buffer(histogramBuffer, sizeof(histogramBuffer));
+	uint32_t mean = (stats->count > 0) ? (uint32_t) (stats->sum / stats->count) : 0;
+	uint8_t i;
+
+	if (!pb_encode_tag(stream, PB_WT_VARINT, 1) || !pb_encode_varint(stream, probe)
+			|| !pb_encode_tag(stream, PB_WT_VARINT, 2) || !pb_encode_varint(stream, stats->count)
+			|| !pb_encode_tag(stream, PB_WT_VARINT, 3) || !pb_encode_varint(stream, stats->min)
+			|| !pb_encode_tag(stream, PB_WT_VARINT, 4) || !pb_encode_varint(stream, stats->max)
+			|| !pb_encode_tag(stream, PB_WT_VARINT, 5) || !pb_encode_varint(stream, mean)
+			|| !pb_encode_tag(stream, PB_WT_VARINT, 6) || !pb_encode_varint(stream, snapshot->coreClock)) {
+		return false;
+	}
+
+	/* Packed, so the histogram varints follow each other in one length delimited field */
+	for (i = 0; i < PROFILE_HISTOGRAM_BINS; i++) {
+		if (!pb_encode_varint(&histogramStream, stats->histogram[i])) {
+			return false;
+		}
+	}
+
+	return pb_encode_tag(stream, PB_WT_STRING, 7)
+			&& pb_encode_string(stream, histogramBuffer, histogramStream.bytes_written);
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,358 @@
+/******************************************************************************
+ * @file    rate_groups.c
+ * @author  Dragonfly
+ * @brief   Rate groups, see rate_groups.h. The RTOS tick hook steps a slot
+ *          counter per group through its period and releases the jobs whose
+ *          phase is the slot: it sets their bits in the pending mask of the
+ *          task that runs the group, stamps them and gives the semaphore of
+ *          the task. The task takes the whole mask at once and runs the set
+ *          jobs of its faster group first, each group in the order of
+ *          registration, like a deferred work worker. A task is created when
+ *          the first job of one of its groups is registered at startup, so
+ *          only the tasks in use cost a stack.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "rate_groups.h"
+
+#include "common.h"
+#include "fcb_error.h"
+#include "trace_recorder.h"
+
+#include "task.h"
+#include "semphr.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+	const char* name;
+	RateGroupJob_TypeDef job;
+	void* argument;
+	RateGroup_TypeDef group;
+	uint16_t phase;                     // [ticks] within the group period
+	uint32_t releaseTimestamp;          // Of the pending release [core clock cycles]
+	RateGroupJobStats_TypeDef stats;
+} RateGroupJobItem_TypeDef;
+
+typedef enum {
+	RATE_GROUP_TASK_FAST = 0,           // The 1 kHz, 200 Hz and 50 Hz groups
+	RATE_GROUP_TASK_SLOW,               // The 20 Hz and 1 Hz groups
+	RATE_GROUP_TASK_NBR
+} RateGroupTask_TypeDef;
+
+typedef struct {
+	const char* name;
+	portTickType period;                // [ticks]
+	RateGroupTask_TypeDef task;
+} RateGroupConfig_TypeDef;
+
+typedef struct {
+	const char* name;
+	unsigned portBASE_TYPE priority;
+	unsigned short stackDepth;
+} RateGroupTaskConfig_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define CYCLES_PER_US      (SystemCoreClock / 1000000)
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+
+/* Indexed by RateGroup_TypeDef, in priority order within each task */
+static const RateGroupConfig_TypeDef groupConfigs[RATE_GROUP_NBR] = {
+	{ "RG_1KHZ", RATE_GROUP_1KHZ_PERIOD / portTICK_RATE_MS, RATE_GROUP_TASK_FAST },
+	{ "RG_200HZ", RATE_GROUP_200HZ_PERIOD / portTICK_RATE_MS, RATE_GROUP_TASK_FAST },
+	{ "RG_50HZ", RATE_GROUP_50HZ_PERIOD / portTICK_RATE_MS, RATE_GROUP_TASK_FAST },
+	{ "RG_20HZ", RATE_GROUP_20HZ_PERIOD / portTICK_RATE_MS, RATE_GROUP_TASK_SLOW },
+	{ "RG_1HZ", RATE_GROUP_1HZ_PERIOD / portTICK_RATE_MS, RATE_GROUP_TASK_SLOW }
+};
+
+/* Indexed by RateGroupTask_TypeDef. The fast task one priority below the high deferred work worker, the slow task
+ * one below the fast one. */
+static const RateGroupTaskConfig_TypeDef taskConfigs[RATE_GROUP_TASK_NBR] = {
+	{ "RG_FAST", configMAX_PRIORITIES-3, 2*configMINIMAL_STACK_SIZE },
+	{ "RG_SLOW", configMAX_PRIORITIES-4, 2*configMINIMAL_STACK_SIZE }
+};
+
+/* Written at startup only, apart from the stamps and statistics, which are guarded by critical sections */
+static RateGroupJobItem_TypeDef jobItems[RATE_GROUP_MAX_JOBS];
+static uint8_t jobItemCount = 0;
+
+/* The slots are only used by the tick hook */
+static portTickType groupSlots[RATE_GROUP_NBR];
+static volatile uint32_t taskPending[RATE_GROUP_TASK_NBR];
+static xSemaphoreHandle taskSems[RATE_GROUP_TASK_NBR];
+static xTaskHandle taskHandles[RATE_GROUP_TASK_NBR];
+
+/* Private function prototypes -----------------------------------------------*/
+static void CreateRateGroupTask(const RateGroupTask_TypeDef task);
+static void RateGroupTask(void const *argument);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Registers a periodic job, and creates the task that runs its group unless it exists. Called at startup,
+ *         before the scheduler is started.
+ * @param  name : Job name for the statistics, a string literal
+ * @param  job : Function run by the group task on every release of the job
+ * @param  argument : Argument passed to the job
+ * @param  group : Rate group that runs the job
+ * @param  phase : Tick within the group period the job is released on [ms], less than the group period
+ * @param  dstId : Destination id of the job, for its statistics
+ * @retval FCB_OK if registered, FCB_ERR if the group or phase is invalid or there are RATE_GROUP_MAX_JOBS already
+ */
+FcbRetValType RateGroupRegister(const char* name, const RateGroupJob_TypeDef job, void* argument,
+		const RateGroup_TypeDef group, const uint16_t phase, RateGroupJobId_TypeDef* dstId) {
+	RateGroupJobItem_TypeDef* item;
+
+	*dstId = RATE_GROUP_INVALID_ID;
+
+	if (group >= RATE_GROUP_NBR || job == NULL || phase / portTICK_RATE_MS >= groupConfigs[group].period
+			|| jobItemCount >= RATE_GROUP_MAX_JOBS) {
+		ErrorHandler();
+		return FCB_ERR;
+	}
+
+	if (taskSems[groupConfigs[group].task] == NULL) {
+		CreateRateGroupTask(groupConfigs[group].task);
+	}
+
+	item = &jobItems[jobItemCount];
+	item->name = name;
+	item->job = job;
+	item->argument = argument;
+	item->group = group;
+	item->phase = (uint16_t) (phase / portTICK_RATE_MS);
+
+	*dstId = jobItemCount++;
+
+	return FCB_OK;
+}
+
+/*
+ * @brief  Steps the groups one tick and releases the jobs due. Called from the RTOS tick hook, with the scheduler
+ *         running or suspended.
+ * @param  None
+ * @retval None
+ */
+void RateGroupTickHook(void) {
+	portBASE_TYPE higherPriorityTaskWoken = pdFALSE;
+	uint32_t released[RATE_GROUP_TASK_NBR] = { 0 };
+	RateGroupJobItem_TypeDef* item;
+	RateGroupTask_TypeDef task;
+	uint32_t itemBit;
+	uint32_t timestamp;
+	uint8_t group;
+	uint8_t i;
+
+	if (0 == jobItemCount) {
+		return;
+	}
+
+	timestamp = GetTimestamp();
+
+	/* The tick hook runs at the kernel interrupt priority, so the group tasks cannot run in between */
+	for (i = 0; i < jobItemCount; i++) {
+		item = &jobItems[i];
+		if (item->phase != groupSlots[item->group]) {
+			continue;
+		}
+
+		task = groupConfigs[item->group].task;
+		itemBit = 1UL << i;
+		item->stats.releases++;
+		if (taskPending[task] & itemBit) {
+			item->stats.skipped++;
+			continue;
+		}
+
+		item->releaseTimestamp = timestamp;
+		taskPending[task] |= itemBit;
+		released[task] |= itemBit;
+	}
+
+	for (group = 0; group < RATE_GROUP_NBR; group++) {
+		if (++groupSlots[group] >= groupConfigs[group].period) {
+			groupSlots[group] = 0;
+		}
+	}
+
+	for (task = RATE_GROUP_TASK_FAST; task < RATE_GROUP_TASK_NBR; task++) {
+		if (0 != released[task]) {
+			xSemaphoreGiveFromISR(taskSems[task], &higherPriorityTaskWoken);
+		}
+	}
+
+	portEND_SWITCHING_ISR(higherPriorityTaskWoken);
+}
+
+/*
+ * @brief  Gets a consistent copy of the statistics of a job
+ * @param  id : Job id
+ * @param  dstStats : Destination statistics
+ * @retval None
+ */
+void RateGroupGetStats(const RateGroupJobId_TypeDef id, RateGroupJobStats_TypeDef* dstStats) {
+	if (id >= jobItemCount) {
+		memset(dstStats, 0, sizeof(RateGroupJobStats_TypeDef));
+		return;
+	}
+
+	taskENTER_CRITICAL();
+	*dstStats = jobItems[id].stats;
+	taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Clears the statistics of all jobs
+ * @param  None
+ * @retval None
+ */
+void RateGroupReset(void) {
+	uint8_t i;
+
+	for (i = 0; i < jobItemCount; i++) {
+		taskENTER_CRITICAL();
+		memset(&jobItems[i].stats, 0, sizeof(RateGroupJobStats_TypeDef));
+		taskEXIT_CRITICAL();
+	}
+}
+
+/*
+ * @brief  Prints the statistics of all jobs as a table
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @retval Length of the table string
+ */
+size_t RateGroupPrint(char* dst, const size_t dstSize) {
+	RateGroupJobStats_TypeDef stats;
+	uint32_t cyclesPerUs = CYCLES_PER_US;
+	size_t length;
+	uint8_t i;
+
+	length = (size_t) snprintf(dst, dstSize, "\nRate groups, phase in ms, latency from the release to the run in us\n"
+			"%-12s%-10s%6s%9s%8s%9s%6s%7s%8s\n", "Job", "Group", "Phase", "Releases", "Skipped", "Runs", "Late",
+			"MaxLat", "MaxRun");
+
+	for (i = 0; i < jobItemCount && length < dstSize; i++) {
+		RateGroupGetStats(i, &stats);
+
+		length += (size_t) snprintf(dst + length, dstSize - length, "%-12s%-10s%6lu%9lu%8lu%9lu%6lu%7lu%8lu\n",
+				jobItems[i].name, groupConfigs[jobItems[i].group].name,
+				(unsigned long) (jobItems[i].phase * portTICK_RATE_MS), (unsigned long) stats.releases,
+				(unsigned long) stats.skipped, (unsigned long) stats.runs, (unsigned long) stats.late,
+				(unsigned long) (stats.maxLatency / cyclesPerUs), (unsigned long) (stats.maxRunTime / cyclesPerUs));
+	}
+
+	return length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Creates the semaphore and the task that runs rate groups
+ * @param  task : Rate group task
+ * @retval None
+ */
+static void CreateRateGroupTask(const RateGroupTask_TypeDef task) {
+	taskSems[task] = xSemaphoreCreateBinary();
+	if (taskSems[task] == NULL) {
+		ErrorHandler();
+		return;
+	}
+	TRACE_OBJECT_NAME(taskSems[task], taskConfigs[task].name);
+
+	/* Rate group task creation
+	 * Task function pointer: RateGroupTask
+	 * Task name: see taskConfigs
+	 * Stack depth: see taskConfigs
+	 * Parameter: The task, see RateGroupTask_TypeDef
+	 * Priority: see taskConfigs (0 to configMAX_PRIORITIES-1 possible)
+	 * Handle: taskHandles[task]
+	 * */
+	if (pdPASS != xTaskCreate((pdTASK_CODE )RateGroupTask, (signed portCHAR*)taskConfigs[task].name,
+			taskConfigs[task].stackDepth, (void*) task, taskConfigs[task].priority, &taskHandles[task])) {
+		ErrorHandler();
+	}
+}
+
+/**
+ * @brief  Task code of the rate group tasks, runs the released jobs of the groups of the task, the faster group first
+ * @param  argument : The task, see RateGroupTask_TypeDef
+ * @retval None
+ */
+static void RateGroupTask(void const *argument) {
+	RateGroupTask_TypeDef task = (RateGroupTask_TypeDef) (uint32_t) argument;
+	RateGroupJobItem_TypeDef* item;
+	uint32_t releaseTimestamps[RATE_GROUP_MAX_JOBS];
+	uint32_t pending;
+	uint32_t periodCycles;
+	uint32_t startTimestamp;
+	uint32_t endTimestamp;
+	uint32_t latency;
+	uint32_t runTime;
+	uint8_t group;
+	uint8_t i;
+
+	for (;;) {
+		/* A give for releases that were taken with an earlier mask leaves an empty mask, which is skipped */
+		if (pdPASS != xSemaphoreTake(taskSems[task], portMAX_DELAY)) {
+			continue;
+		}
+
+		/* The stamps are copied with the mask, a job released again meanwhile is stamped again for its next run */
+		taskENTER_CRITICAL();
+		pending = taskPending[task];
+		taskPending[task] = 0;
+		for (i = 0; i < jobItemCount; i++) {
+			releaseTimestamps[i] = jobItems[i].releaseTimestamp;
+		}
+		taskEXIT_CRITICAL();
+
+		for (group = 0; group < RATE_GROUP_NBR && pending != 0; group++) {
+			if (groupConfigs[group].task != task) {
+				continue;
+			}
+
+			periodCycles = groupConfigs[group].period * portTICK_RATE_MS * (SystemCoreClock / 1000);
+
+			for (i = 0; i < jobItemCount; i++) {
+				item = &jobItems[i];
+				if (!(pending & (1UL << i)) || item->group != group) {
+					continue;
+				}
+				pending &= ~(1UL << i);
+
+				startTimestamp = GetTimestamp();
+				item->job(item->argument);
+				endTimestamp = GetTimestamp();
+				runTime = endTimestamp - startTimestamp;
+
+				taskENTER_CRITICAL();
+				latency = startTimestamp - releaseTimestamps[i];
+				if (latency > item->stats.maxLatency) {
+					item->stats.maxLatency = latency;
+				}
+				if (runTime > item->stats.maxRunTime) {
+					item->stats.maxRunTime = runTime;
+				}
+				if (endTimestamp - releaseTimestamps[i] > periodCycles) {
+					item->stats.late++;
+				}
+				item->stats.runs++;
+				taskEXIT_CRITICAL();
+			}
+		}
+	}
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,254 @@
+/******************************************************************************
+ * @file    ring_buffer.c
+ * @author  Dragonfly
+ * @brief   Single producer, single consumer ring buffers. The size is a power
+ *          of two, so the free running indices are masked instead of taken
+ *          modulo, and the used size is their difference. The producer only
+ *          moves the head and the consumer only moves the tail, which lets an
+ *          ISR and a task share a buffer without critical sections. Data can
+ *          be accessed in place as contiguous spans (peek, then commit), for
+ *          DMA transfers and for parsers that scan it in bulk. The producer
+ *          also records the occupancy statistics of the buffer.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "ring_buffer.h"
+
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+
+/* Keeps data accesses on their side of an index update, for the compiler and for the DMA */
+#ifdef FCB_HOST_BUILD
+#define RING_BUFFER_BARRIER()           __sync_synchronize()
+#else
+#define RING_BUFFER_BARRIER()           __ASM volatile ("dmb" ::: "memory")
+#endif
+
+/* Private variables ---------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Initializes the ring buffer as empty
+ * @param  ring : Pointer to the declared RingBuffer_TypeDef buffer
+ * @param  bufferArray : Storage array of the buffer
+ * @param  bufferSize : Size of the storage array, a power of two [1, RING_BUFFER_MAX_SIZE]
+ * @retval SUCCESS if initialized, ERROR if the size is not a power of two
+ */
+ErrorStatus RingBufferInit(RingBuffer_TypeDef* ring, uint8_t* bufferArray, const uint16_t bufferSize) {
+	if (0 == bufferSize || bufferSize > RING_BUFFER_MAX_SIZE || 0 != (bufferSize & (bufferSize - 1))) {
+		return ERROR;
+	}
+
+	ring->bufferArray = bufferArray;
+	ring->mask = bufferSize - 1;
+	ring->head = 0;
+	ring->tail = 0;
+	BufferStatsReset(&ring->stats);
+
+	return SUCCESS;
+}
+
+/*
+ * @brief  Gets the number of bytes stored in the buffer
+ * @param  ring : Pointer to the declared RingBuffer_TypeDef buffer
+ * @retval Number of stored bytes, a lower bound for the consumer and an upper bound for the producer
+ */
+uint16_t RingBufferGetUsed(const RingBuffer_TypeDef* ring) {
+	return (uint16_t) (ring->head - ring->tail);
+}
+
+/*
+ * @brief  Gets the free space in the buffer
+ * @param  ring : Pointer to the declared RingBuffer_TypeDef buffer
+ * @retval Number of free bytes, a lower bound for the producer
+ */
+uint16_t RingBufferGetFree(const RingBuffer_TypeDef* ring) {
+	return ring->mask + 1 - RingBufferGetUsed(ring);
+}
+
+/*
+ * @brief  Checks if the buffer is empty
+ * @param  ring : Pointer to the declared RingBuffer_TypeDef buffer
+ * @retval true if buffer is empty, false if it is NOT empty
+ */
+bool RingBufferIsEmpty(const RingBuffer_TypeDef* ring) {
+	return ring->head == ring->tail;
+}
+
+/*
+ * @brief  Gets the contiguous free space at the head of the buffer, to be written in place. Producer only.
+ * @param  ring : Pointer to the declared RingBuffer_TypeDef buffer
+ * @param  span : Set to the start of the free space
+ * @retval Size of the contiguous free space, less than the free space if it wraps around the end of the array
+ */
+uint16_t RingBufferPeekWrite(RingBuffer_TypeDef* ring, uint8_t** span) {
+	uint16_t headIdx = ring->head & ring->mask;
+	uint16_t freeSize = RingBufferGetFree(ring);
+	uint16_t spanSize = ring->mask + 1 - headIdx;
+
+	/* Write the space only after the tail that released it */
+	RING_BUFFER_BARRIER();
+
+	*span = &ring->bufferArray[headIdx];
+
+	return (freeSize < spanSize) ? freeSize : spanSize;
+}
+
+/*
+ * @brief  Publishes bytes written in place to the consumer. Producer only.
+ * @param  ring : Pointer to the declared RingBuffer_TypeDef buffer
+ * @param  size : Number of bytes written, at most the size returned by RingBufferPeekWrite
+ * @retval None
+ */
+void RingBufferCommitWrite(RingBuffer_TypeDef* ring, const uint16_t size) {
+	RING_BUFFER_BARRIER();
+	ring->head += size;
+	BufferStatsRecordLevel(&ring->stats, RingBufferGetUsed(ring));
+}
+
+/*
+ * @brief  Copies data in to the buffer, all of it or nothing. Producer only.
+ * @param  ring : Pointer to the declared RingBuffer_TypeDef buffer
+ * @param  data : Data to put
+ * @param  size : Size of data
+ * @retval SUCCESS if data put in buffer, ERROR if not enough free space in buffer
+ */
+ErrorStatus RingBufferPutData(RingBuffer_TypeDef* ring, const uint8_t* data, const uint16_t size) {
+	uint8_t* span;
+	uint16_t spanSize;
+
+	if (RingBufferGetFree(ring) < size) {
+		RingBufferRecordFull(ring);
+		return ERROR;
+	}
+
+	/* The data is copied in at most two parts, before and after the wrap-around */
+	spanSize = RingBufferPeekWrite(ring, &span);
+	if (spanSize >= size) {
+		memcpy(span, data, size);
+	} else {
+		memcpy(span, data, spanSize);
+		memcpy(ring->bufferArray, &data[spanSize], size - spanSize);
+	}
+
+	RingBufferCommitWrite(ring, size);
+
+	return SUCCESS;
+}
+
+/*
+ * @brief  Records that data did not fit in the buffer, for a producer that waits for room instead of putting it with
+ *         RingBufferPutData(). Producer only.
+ * @param  ring : Pointer to the declared RingBuffer_TypeDef buffer
+ * @retval None
+ */
+void RingBufferRecordFull(RingBuffer_TypeDef* ring) {
+	BufferStatsRecordFull(&ring->stats);
+}
+
+/*
+ * @brief  Gets the contiguous stored data at the tail of the buffer, to be read in place. Consumer only.
+ * @param  ring : Pointer to the declared RingBuffer_TypeDef buffer
+ * @param  span : Set to the start of the stored data
+ * @retval Size of the contiguous stored data, less than the stored size if it wraps around the end of the array
+ */
+uint16_t RingBufferPeekRead(RingBuffer_TypeDef* ring, uint8_t** span) {
+	uint16_t tailIdx = ring->tail & ring->mask;
+	uint16_t usedSize = RingBufferGetUsed(ring);
+	uint16_t spanSize = ring->mask + 1 - tailIdx;
+
+	/* Read the data only after the head that published it */
+	RING_BUFFER_BARRIER();
+
+	*span = &ring->bufferArray[tailIdx];
+
+	return (usedSize < spanSize) ? usedSize : spanSize;
+}
+
+/*
+ * @brief  Releases bytes read in place to the producer. Consumer only.
+ * @param  ring : Pointer to the declared RingBuffer_TypeDef buffer
+ * @param  size : Number of bytes read, at most the size returned by RingBufferPeekRead
+ * @retval None
+ */
+void RingBufferCommitRead(RingBuffer_TypeDef* ring, const uint16_t size) {
+	RING_BUFFER_BARRIER();
+	ring->tail += size;
+}
+
+/*
+ * @brief  Copies data out of the buffer. Consumer only.
+ * @param  ring : Pointer to the declared RingBuffer_TypeDef buffer
+ * @param  dst : Destination of the data
+ * @param  maxSize : Max number of bytes to get
+ * @retval Number of bytes copied, less than maxSize if the buffer held less
+ */
+uint16_t RingBufferGetData(RingBuffer_TypeDef* ring, uint8_t* dst, const uint16_t maxSize) {
+	uint8_t* span;
+	uint16_t spanSize;
+	uint16_t copied = 0;
+
+	while (copied < maxSize && (spanSize = RingBufferPeekRead(ring, &span)) > 0) {
+		if (spanSize > maxSize - copied) {
+			spanSize = maxSize - copied;
+		}
+		memcpy(&dst[copied], span, spanSize);
+		RingBufferCommitRead(ring, spanSize);
+		copied += spanSize;
+	}
+
+	return copied;
+}
+
+/*
+ * @brief  Copies data out of the buffer up to and including a delimiter, e.g. the end of a command line. Consumer
+ *         only.
+ * @param  ring : Pointer to the declared RingBuffer_TypeDef buffer
+ * @param  dst : Destination of the data
+ * @param  maxSize : Max number of bytes to get
+ * @retval Number of bytes copied. The last one is the delimiter if it was found, else the buffer was emptied or
+ *         maxSize bytes were copied.
+ */
+uint16_t RingBufferGetUntil(RingBuffer_TypeDef* ring, uint8_t* dst, const uint16_t maxSize, const uint8_t delimiter) {
+	uint8_t* span;
+	uint8_t* delimiterPtr;
+	uint16_t spanSize;
+	uint16_t copied = 0;
+
+	while (copied < maxSize && (spanSize = RingBufferPeekRead(ring, &span)) > 0) {
+		if (spanSize > maxSize - copied) {
+			spanSize = maxSize - copied;
+		}
+
+		delimiterPtr = memchr(span, delimiter, spanSize);
+		if (NULL != delimiterPtr) {
+			spanSize = delimiterPtr - span + 1;
+		}
+
+		memcpy(&dst[copied], span, spanSize);
+		RingBufferCommitRead(ring, spanSize);
+		copied += spanSize;
+
+		if (NULL != delimiterPtr) {
+			break;
+		}
+	}
+
+	return copied;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
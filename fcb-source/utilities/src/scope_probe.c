@@ -0,0 +1,262 @@
+/******************************************************************************
+ * @file    scope_probe.c
+ * @author  Dragonfly
+ * @brief   Scope probe stage markers. Each stage is mapped to a channel, a
+ *          spare GPIO pin with FCB_SCOPE_PROBE_GPIO, or enabled on the DAC
+ *          with FCB_SCOPE_PROBE_DAC, where every mapped stage writes its own
+ *          code. The markers run in tasks and ISRs alike. A pin is set and
+ *          reset through BSRR, a single store, so stages on different pins
+ *          need no lock. Stages mapped to the same pin or sharing the DAC
+ *          overlap on the trace.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "scope_probe.h"
+
+#include <stdio.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+#define SCOPE_PROBE_DAC_IDLE                0
+
+/* Private macro -------------------------------------------------------------*/
+#define IS_SCOPE_PROBE_CHANNEL(CHANNEL)     ((CHANNEL) < SCOPE_PROBE_GPIO_CHANNELS)
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Mapping table, indexed by ScopeProbeStage_TypeDef. PREDICTION and CORRECTION are off by default, map one of them in
+ * place of another stage to probe it. */
+static volatile uint8_t stageChannels[SCOPE_PROBE_STAGE_NBR] = {
+	0,                                  // DRDY
+	1,                                  // FETCH
+	SCOPE_PROBE_CHANNEL_NONE,           // PREDICTION
+	SCOPE_PROBE_CHANNEL_NONE,           // CORRECTION
+	2,                                  // PID
+	3                                   // MOTOR
+};
+
+static const char* stageNames[SCOPE_PROBE_STAGE_NBR] = { "drdy", "fetch", "prediction", "correction", "pid",
+		"motor" };
+
+#ifdef FCB_SCOPE_PROBE_GPIO
+static const uint16_t channelPins[SCOPE_PROBE_GPIO_CHANNELS] = { GPIO_PIN_6, GPIO_PIN_7, GPIO_PIN_8, GPIO_PIN_9 };
+#endif
+
+#ifdef FCB_SCOPE_PROBE_DAC
+static DAC_HandleTypeDef scopeProbeDacHandle;
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Configures the marker outputs, all low or idle. Does nothing unless the markers are compiled in.
+ * @param  None
+ * @retval None
+ */
+void InitScopeProbe(void) {
+#ifdef FCB_SCOPE_PROBE_GPIO
+	GPIO_InitTypeDef GPIO_InitStruct;
+	uint8_t i;
+
+	SCOPE_PROBE_GPIO_CLK_ENABLE();
+
+	GPIO_InitStruct.Pin = 0;
+	for (i = 0; i < SCOPE_PROBE_GPIO_CHANNELS; i++) {
+		GPIO_InitStruct.Pin |= channelPins[i];
+	}
+	GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+	GPIO_InitStruct.Pull = GPIO_NOPULL;
+	GPIO_InitStruct.Speed = GPIO_SPEED_HIGH;
+	HAL_GPIO_Init(SCOPE_PROBE_GPIO_PORT, &GPIO_InitStruct);
+	HAL_GPIO_WritePin(SCOPE_PROBE_GPIO_PORT, GPIO_InitStruct.Pin, GPIO_PIN_RESET);
+#endif
+
+#ifdef FCB_SCOPE_PROBE_DAC
+	GPIO_InitTypeDef GPIO_InitStruct;
+	DAC_ChannelConfTypeDef channelConf = { DAC_TRIGGER_NONE, DAC_OUTPUTBUFFER_ENABLE };
+
+	__GPIOA_CLK_ENABLE();
+	__DAC1_CLK_ENABLE();
+
+	/* DAC1 channel 1 output on PA4 */
+	GPIO_InitStruct.Pin = GPIO_PIN_4;
+	GPIO_InitStruct.Mode = GPIO_MODE_ANALOG;
+	GPIO_InitStruct.Pull = GPIO_NOPULL;
+	HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+	scopeProbeDacHandle.Instance = DAC1;
+	if (HAL_OK != HAL_DAC_Init(&scopeProbeDacHandle)
+			|| HAL_OK != HAL_DAC_ConfigChannel(&scopeProbeDacHandle, &channelConf, DAC1_CHANNEL_1)
+			|| HAL_OK != HAL_DAC_SetValue(&scopeProbeDacHandle, DAC1_CHANNEL_1, DAC_ALIGN_12B_R, SCOPE_PROBE_DAC_IDLE)
+			|| HAL_OK != HAL_DAC_Start(&scopeProbeDacHandle, DAC1_CHANNEL_1)) {
+		/* No markers, the pipeline runs on without them */
+		return;
+	}
+#endif
+}
+
+/*
+ * @brief  Marks the start of a stage: sets its pin, or writes its code to the DAC. May be called from an ISR.
+ * @param  stage : Stage
+ * @retval The DAC level before the stage, to be passed on to ScopeProbeEnd()
+ */
+uint32_t ScopeProbeBegin(const ScopeProbeStage_TypeDef stage) {
+	uint32_t previous = SCOPE_PROBE_DAC_IDLE;
+	uint8_t channel = stageChannels[stage];
+
+	if (!IS_SCOPE_PROBE_CHANNEL(channel)) {
+		return previous;
+	}
+
+#ifdef FCB_SCOPE_PROBE_GPIO
+	SCOPE_PROBE_GPIO_PORT->BSRRL = channelPins[channel];
+#endif
+
+#ifdef FCB_SCOPE_PROBE_DAC
+	/* Straight to the holding register, the HAL call costs more than the marker is worth */
+	previous = DAC1->DHR12R1;
+	DAC1->DHR12R1 = (stage + 1)*SCOPE_PROBE_DAC_STEP - 1;
+#endif
+
+	return previous;
+}
+
+/*
+ * @brief  Marks the end of a stage: resets its pin, or restores the DAC level before it. May be called from an ISR.
+ * @param  stage : Stage
+ * @param  previous : Return value of ScopeProbeBegin() of the stage
+ * @retval None
+ */
+void ScopeProbeEnd(const ScopeProbeStage_TypeDef stage, const uint32_t previous) {
+	uint8_t channel = stageChannels[stage];
+
+	(void) previous;
+	if (!IS_SCOPE_PROBE_CHANNEL(channel)) {
+		return;
+	}
+
+#ifdef FCB_SCOPE_PROBE_GPIO
+	SCOPE_PROBE_GPIO_PORT->BSRRH = channelPins[channel];
+#endif
+
+#ifdef FCB_SCOPE_PROBE_DAC
+	DAC1->DHR12R1 = previous;
+#endif
+}
+
+/*
+ * @brief  Completes the marker of SCOPE_PROBE_SCOPE() when its block is left
+ * @param  scope : Open marker
+ * @retval None
+ */
+void ScopeProbeEndScope(const ScopeProbeScope_TypeDef* scope) {
+	ScopeProbeEnd(scope->stage, scope->previous);
+}
+
+/*
+ * @brief  Marks an instant of a stage: toggles its pin, or writes its code to the DAC until the next marker. May be
+ *         called from an ISR.
+ * @param  stage : Stage
+ * @retval None
+ */
+void ScopeProbeMark(const ScopeProbeStage_TypeDef stage) {
+	uint8_t channel = stageChannels[stage];
+
+	if (!IS_SCOPE_PROBE_CHANNEL(channel)) {
+		return;
+	}
+
+#ifdef FCB_SCOPE_PROBE_GPIO
+	if (SCOPE_PROBE_GPIO_PORT->ODR & channelPins[channel]) {
+		SCOPE_PROBE_GPIO_PORT->BSRRH = channelPins[channel];
+	} else {
+		SCOPE_PROBE_GPIO_PORT->BSRRL = channelPins[channel];
+	}
+#endif
+
+#ifdef FCB_SCOPE_PROBE_DAC
+	DAC1->DHR12R1 = (stage + 1)*SCOPE_PROBE_DAC_STEP - 1;
+#endif
+}
+
+/*
+ * @brief  Maps a stage to a marker channel. A stage moved off a pin while it is marked may leave the pin high.
+ * @param  stage : Stage
+ * @param  channel : GPIO channel, below SCOPE_PROBE_GPIO_CHANNELS, any of them enables the stage on the DAC, or
+ *         SCOPE_PROBE_CHANNEL_NONE
+ * @retval None
+ */
+void SetScopeProbeChannel(const ScopeProbeStage_TypeDef stage, const uint8_t channel) {
+	if (stage < SCOPE_PROBE_STAGE_NBR) {
+		stageChannels[stage] = IS_SCOPE_PROBE_CHANNEL(channel) ? channel : SCOPE_PROBE_CHANNEL_NONE;
+	}
+}
+
+/*
+ * @brief  Gets the marker channel of a stage
+ * @param  stage : Stage
+ * @retval Channel, SCOPE_PROBE_CHANNEL_NONE if the stage is not marked
+ */
+uint8_t GetScopeProbeChannel(const ScopeProbeStage_TypeDef stage) {
+	return (stage < SCOPE_PROBE_STAGE_NBR) ? stageChannels[stage] : SCOPE_PROBE_CHANNEL_NONE;
+}
+
+/*
+ * @brief  Gets the name of a stage, as used by the CLI
+ * @param  stage : Stage
+ * @retval Name, NULL for an invalid stage
+ */
+const char* GetScopeProbeStageName(const ScopeProbeStage_TypeDef stage) {
+	return (stage < SCOPE_PROBE_STAGE_NBR) ? stageNames[stage] : NULL;
+}
+
+/*
+ * @brief  Prints the mapping table
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @retval Length of the table string
+ */
+size_t ScopeProbePrint(char* dst, const size_t dstSize) {
+	size_t length;
+	uint8_t channel;
+	uint8_t i;
+
+#if defined(FCB_SCOPE_PROBE_GPIO)
+	length = (size_t) snprintf(dst, dstSize, "\nScope probe stages on PC6 to PC9\nStage\t\tChannel\tPin\n");
+#elif defined(FCB_SCOPE_PROBE_DAC)
+	length = (size_t) snprintf(dst, dstSize, "\nScope probe stages on the DAC, PA4\nStage\t\tChannel\tLevel\n");
+#else
+	length = (size_t) snprintf(dst, dstSize, "\nScope probe markers not compiled in\nStage\t\tChannel\n");
+#endif
+
+	for (i = 0; i < SCOPE_PROBE_STAGE_NBR && length < dstSize; i++) {
+		channel = stageChannels[i];
+		if (!IS_SCOPE_PROBE_CHANNEL(channel)) {
+			length += (size_t) snprintf(dst + length, dstSize - length, "%-12s\t-\n", stageNames[i]);
+			continue;
+		}
+
+#if defined(FCB_SCOPE_PROBE_GPIO)
+		length += (size_t) snprintf(dst + length, dstSize - length, "%-12s\t%u\tPC%u\n", stageNames[i], channel,
+				(unsigned int) (6 + channel));
+#elif defined(FCB_SCOPE_PROBE_DAC)
+		length += (size_t) snprintf(dst + length, dstSize - length, "%-12s\t%u\t%u\n", stageNames[i], channel,
+				(unsigned int) ((i + 1)*SCOPE_PROBE_DAC_STEP - 1));
+#else
+		length += (size_t) snprintf(dst + length, dstSize - length, "%-12s\t%u\n", stageNames[i], channel);
+#endif
+	}
+
+	return length;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,725 @@
+/******************************************************************************
+ * @file    sd_card.c
+ * @brief   MicroSD card driver in SPI mode, with streamed multiple block
+ *          writes and the FAT-SL media driver glue, see sd_card.h
+ ******************************************************************************/
+
+/* Includes ------------------------------------------------------------------*/
+#include "sd_card.h"
+
+#ifdef FCB_SD_CARD
+
+#include "fat_sl.h"
+#include "deferred_log.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private define ------------------------------------------------------------*/
+
+/* Commands, SPI mode */
+#define SD_CMD_GO_IDLE_STATE            0
+#define SD_CMD_SEND_IF_COND             8
+#define SD_CMD_SEND_CSD                 9
+#define SD_CMD_SET_BLOCKLEN             16
+#define SD_CMD_READ_SINGLE_BLOCK        17
+#define SD_CMD_WRITE_MULTIPLE_BLOCK     25
+#define SD_CMD_APP_CMD                  55
+#define SD_CMD_READ_OCR                 58
+#define SD_ACMD_SD_SEND_OP_COND         41
+
+#define SD_R1_IDLE                      0x01
+#define SD_R1_ILLEGAL_COMMAND           0x04
+#define SD_R1_NO_RESPONSE               0xFF
+#define SD_R1_RESPONSE_BYTES            10      // Bytes the R1 response may be delayed by
+
+#define SD_IF_COND_ARG                  0x1AA   // 2.7-3.6 V, check pattern 0xAA
+#define SD_OP_COND_HCS                  0x40000000
+#define SD_OCR_CCS                      0x40    // Of the first OCR byte
+
+#define SD_TOKEN_START_BLOCK            0xFE    // Single block read and write, CSD
+#define SD_TOKEN_START_MULTI_WRITE      0xFC
+#define SD_TOKEN_STOP_MULTI_WRITE       0xFD
+#define SD_DATA_RESPONSE_MASK           0x1F
+#define SD_DATA_RESPONSE_ACCEPTED       0x05
+
+#define SD_CSD_SIZE                     16
+#define SD_CRC_SIZE                     2
+
+#define SD_CMD0_ATTEMPTS                10
+#define SD_SPI_TIMEOUT                  10      // [ms] Of a polled transfer
+#define SD_POLLS_BEFORE_DELAY           64      // Busy polls, about 0.2 ms, before the task sleeps between them
+
+#define SD_CARD_DRIVER_ERR              1       // Media driver functions return 0 when successful
+
+/* Private macro -------------------------------------------------------------*/
+#define SD_CS_LOW()                     HAL_GPIO_WritePin(SD_CARD_CS_GPIO_PORT, SD_CARD_CS_PIN, GPIO_PIN_RESET)
+#define SD_CS_HIGH()                    HAL_GPIO_WritePin(SD_CARD_CS_GPIO_PORT, SD_CARD_CS_PIN, GPIO_PIN_SET)
+
+/* Private function prototypes -----------------------------------------------*/
+static FcbRetValType ConfigSdCardSpi(const uint32_t prescaler);
+static FcbRetValType IdentifySdCard(void);
+static uint8_t SdSpiExchange(const uint8_t txByte);
+static void SdSpiReceive(uint8_t* dst, const uint16_t size);
+static void SelectSdCard(void);
+static void DeselectSdCard(void);
+static uint8_t SendSdCommand(const uint8_t cmd, const uint32_t arg);
+static uint8_t SendSdAppCommand(const uint8_t cmd, const uint32_t arg);
+static FcbRetValType WaitSdCardReady(const uint32_t timeout);
+static FcbRetValType WaitSdDataToken(void);
+static FcbRetValType FinishSdStreamBlock(void);
+static FcbRetValType StopSdStream(void);
+static void FailSdCard(void);
+static uint32_t GetSdCardAddress(const uint32_t sector);
+static int SdDriverWriteSector(F_DRIVER* driver, void* data, unsigned long sector);
+static int SdDriverReadSector(F_DRIVER* driver, void* data, unsigned long sector);
+static int SdDriverGetPhy(F_DRIVER* driver, F_PHY* phy);
+static long SdDriverGetStatus(F_DRIVER* driver);
+
+/* Private variables ---------------------------------------------------------*/
+static SPI_HandleTypeDef SdCardSpiHandle;
+
+/* Given by the DMA complete and error interrupts */
+static xSemaphoreHandle sdDmaSemaphore = NULL;
+static volatile bool isSdDmaFailed = false;
+
+/* Sectors sent by DMA, one is sent while the next one is copied to the other */
+static uint8_t sdDmaBuffers[2][SD_CARD_SECTOR_SIZE];
+static uint8_t sdDmaBufferIndex = 0;
+
+/* Multiple block write state */
+static bool isSdStreaming = false;
+static bool isSdBlockPending = false;   // A sector was sent, its data response and programming not yet waited for
+static uint32_t sdStreamNextSector = 0;
+
+static bool isSdCardReady = false;
+static SdCardStats_TypeDef sdCardStats;
+
+static F_DRIVER sdCardDriver;
+
+static const char* const sdCardTypeNames[SD_CARD_TYPE_NBR] = { "none", "SDv1", "SDSC", "SDHC" };
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Configures the SPI and identifies the card at the identification clock rate, then sets the data clock rate
+ * @param  None
+ * @retval FCB_OK if a card is ready, FCB_ERR_INIT otherwise
+ */
+FcbRetValType SdCardInit(void) {
+    uint32_t errors = sdCardStats.errors;
+    uint8_t i;
+
+    isSdCardReady = false;
+    isSdStreaming = false;
+    isSdBlockPending = false;
+    memset(&sdCardStats, 0, sizeof(sdCardStats));
+    sdCardStats.errors = errors;
+
+    if (NULL == sdDmaSemaphore) {
+        vSemaphoreCreateBinary(sdDmaSemaphore);
+        if (NULL == sdDmaSemaphore) {
+            return FCB_ERR_INIT;
+        }
+    }
+    (void) xSemaphoreTake(sdDmaSemaphore, 0);
+
+    if (FCB_OK != ConfigSdCardSpi(SD_CARD_SPI_INIT_PRESCALER)) {
+        return FCB_ERR_INIT;
+    }
+
+    /* At least 74 clocks with the card deselected to enter the native mode */
+    DeselectSdCard();
+    for (i = 0; i < 10; i++) {
+        (void) SdSpiExchange(0xFF);
+    }
+
+    SelectSdCard();
+    if (FCB_OK != IdentifySdCard()) {
+        DeselectSdCard();
+        sdCardStats.type = SD_CARD_NONE;
+        return FCB_ERR_INIT;
+    }
+    DeselectSdCard();
+
+    if (FCB_OK != ConfigSdCardSpi(SD_CARD_SPI_PRESCALER)) {
+        return FCB_ERR_INIT;
+    }
+
+    isSdCardReady = true;
+    LOG2("SD card: type %lu, %lu MB", sdCardStats.type, sdCardStats.sectors / (1024*1024/SD_CARD_SECTOR_SIZE));
+    return FCB_OK;
+}
+
+/*
+ * @brief  Writes a sector, as the next block of a multiple block write. A sector that does not follow the previously
+ *         written one ends the ongoing multiple block write and starts a new one.
+ * @param  data : SD_CARD_SECTOR_SIZE bytes to write, copied
+ * @param  sector : Sector number
+ * @retval FCB_OK if written, FCB_ERR otherwise
+ */
+FcbRetValType SdCardWriteSector(const uint8_t* data, const uint32_t sector) {
+    if (!isSdCardReady || sector >= sdCardStats.sectors) {
+        return FCB_ERR;
+    }
+
+    if (isSdStreaming && sector != sdStreamNextSector) {
+        if (FCB_OK != StopSdStream()) {
+            return FCB_ERR;
+        }
+    }
+
+    if (!isSdStreaming) {
+        SelectSdCard();
+        if (0 != SendSdCommand(SD_CMD_WRITE_MULTIPLE_BLOCK, GetSdCardAddress(sector))) {
+            FailSdCard();
+            return FCB_ERR;
+        }
+        isSdStreaming = true;
+        sdStreamNextSector = sector;
+        sdCardStats.multiBlockWrites++;
+    }
+
+    /* Copied while the previous sector is sent from the other buffer */
+    memcpy(sdDmaBuffers[sdDmaBufferIndex], data, SD_CARD_SECTOR_SIZE);
+
+    if (isSdBlockPending && FCB_OK != FinishSdStreamBlock()) {
+        return FCB_ERR;
+    }
+
+    (void) SdSpiExchange(SD_TOKEN_START_MULTI_WRITE);
+    isSdDmaFailed = false;
+    if (HAL_OK != HAL_SPI_Transmit_DMA(&SdCardSpiHandle, sdDmaBuffers[sdDmaBufferIndex], SD_CARD_SECTOR_SIZE)) {
+        FailSdCard();
+        return FCB_ERR;
+    }
+
+    isSdBlockPending = true;
+    sdDmaBufferIndex ^= 1;
+    sdStreamNextSector++;
+    return FCB_OK;
+}
+
+/*
+ * @brief  Reads a sector, polled. Ends an ongoing multiple block write first.
+ * @param  dst : Destination of SD_CARD_SECTOR_SIZE bytes
+ * @param  sector : Sector number
+ * @retval FCB_OK if read, FCB_ERR otherwise
+ */
+FcbRetValType SdCardReadSector(uint8_t* dst, const uint32_t sector) {
+    uint8_t crc[SD_CRC_SIZE];
+
+    if (!isSdCardReady || sector >= sdCardStats.sectors || FCB_OK != StopSdStream()) {
+        return FCB_ERR;
+    }
+
+    SelectSdCard();
+    if (0 != SendSdCommand(SD_CMD_READ_SINGLE_BLOCK, GetSdCardAddress(sector)) || FCB_OK != WaitSdDataToken()) {
+        FailSdCard();
+        return FCB_ERR;
+    }
+
+    SdSpiReceive(dst, SD_CARD_SECTOR_SIZE);
+    SdSpiReceive(crc, SD_CRC_SIZE);
+    DeselectSdCard();
+
+    sdCardStats.sectorsRead++;
+    return FCB_OK;
+}
+
+/*
+ * @brief  Ends an ongoing multiple block write, when the card has programmed all of it
+ * @param  None
+ * @retval FCB_OK if flushed, FCB_ERR otherwise
+ */
+FcbRetValType SdCardFlush(void) {
+    if (!isSdCardReady) {
+        return FCB_ERR;
+    }
+
+    return StopSdStream();
+}
+
+/*
+ * @brief  Initialises the FAT-SL media driver of the card
+ * @param  driverParam : Unused
+ * @retval The driver, NULL if the card is not ready
+ */
+F_DRIVER* SdCardDriverInit(unsigned long driverParam) {
+    (void) driverParam;
+
+    if (!isSdCardReady) {
+        return NULL;
+    }
+
+    memset(&sdCardDriver, 0, sizeof(sdCardDriver));
+    sdCardDriver.writesector = SdDriverWriteSector;
+    sdCardDriver.readsector = SdDriverReadSector;
+    sdCardDriver.getphy = SdDriverGetPhy;
+    sdCardDriver.getstatus = SdDriverGetStatus;
+
+    return &sdCardDriver;
+}
+
+/*
+ * @brief  Tells if the card is initialised and has not failed since
+ * @param  None
+ * @retval true if ready
+ */
+bool SdCardIsReady(void) {
+    return isSdCardReady;
+}
+
+/*
+ * @brief  Tells if a SPI handle is the one of the card, for the HAL callbacks
+ * @param  hspi : SPI handle
+ * @retval true if it is
+ */
+bool SdCardIsSPIHandle(const SPI_HandleTypeDef* hspi) {
+    return hspi == &SdCardSpiHandle;
+}
+
+/*
+ * @brief  Wakes the writing task when a sector is sent. Called by HAL_SPI_TxCpltCallback().
+ * @param  None
+ * @retval None
+ */
+void SdCardDMACompleteFromISR(void) {
+    portBASE_TYPE higherPriorityTaskWoken = pdFALSE;
+
+    xSemaphoreGiveFromISR(sdDmaSemaphore, &higherPriorityTaskWoken);
+    portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
+
+/*
+ * @brief  Fails the sector being sent and wakes the writing task. Called by HAL_SPI_ErrorCallback().
+ * @param  None
+ * @retval None
+ */
+void SdCardDMAErrorFromISR(void) {
+    portBASE_TYPE higherPriorityTaskWoken = pdFALSE;
+
+    isSdDmaFailed = true;
+    xSemaphoreGiveFromISR(sdDmaSemaphore, &higherPriorityTaskWoken);
+    portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
+
+/*
+ * @brief  Handles the SPI TX DMA interrupt
+ * @param  None
+ * @retval None
+ */
+void SdCardDmaIRQHandler(void) {
+    HAL_DMA_IRQHandler(SdCardSpiHandle.hdmatx);
+}
+
+/*
+ * @brief  Gets the card statistics
+ * @param  dstStats : Destination of the statistics
+ * @retval None
+ */
+void GetSdCardStats(SdCardStats_TypeDef* dstStats) {
+    taskENTER_CRITICAL();
+    memcpy(dstStats, &sdCardStats, sizeof(sdCardStats));
+    taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Gets the name of a card type
+ * @param  type : Card type
+ * @retval The name
+ */
+const char* GetSdCardTypeName(const SdCardType type) {
+    return (type < SD_CARD_TYPE_NBR) ? sdCardTypeNames[type] : "?";
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Configures the SPI as master, mode 0, 8-bit frames, at a clock rate. The GPIO and the TX DMA are configured
+ *         by HAL_SPI_MspInit() at the first call.
+ * @param  prescaler : SPI_BAUDRATEPRESCALER_x of PCLK1
+ * @retval FCB_OK if configured, FCB_ERR_INIT otherwise
+ */
+static FcbRetValType ConfigSdCardSpi(const uint32_t prescaler) {
+    SdCardSpiHandle.Instance = SD_CARD_SPI;
+    SdCardSpiHandle.Init.Mode = SPI_MODE_MASTER;
+    SdCardSpiHandle.Init.Direction = SPI_DIRECTION_2LINES;
+    SdCardSpiHandle.Init.DataSize = SPI_DATASIZE_8BIT;
+    SdCardSpiHandle.Init.CLKPolarity = SPI_POLARITY_LOW;
+    SdCardSpiHandle.Init.CLKPhase = SPI_PHASE_1EDGE;
+    SdCardSpiHandle.Init.NSS = SPI_NSS_SOFT;
+    SdCardSpiHandle.Init.BaudRatePrescaler = prescaler;
+    SdCardSpiHandle.Init.FirstBit = SPI_FIRSTBIT_MSB;
+    SdCardSpiHandle.Init.TIMode = SPI_TIMODE_DISABLED;
+    SdCardSpiHandle.Init.CRCCalculation = SPI_CRCCALCULATION_DISABLED;
+    SdCardSpiHandle.Init.CRCPolynomial = 7;
+    SdCardSpiHandle.Init.CRCLength = SPI_CRC_LENGTH_DATASIZE;
+    SdCardSpiHandle.Init.NSSPMode = SPI_NSS_PULSE_DISABLED;
+
+    if (HAL_OK != HAL_SPI_Init(&SdCardSpiHandle)) {
+        return FCB_ERR_INIT;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Takes the selected card to the SPI mode ready state and reads its type and capacity
+ * @param  None
+ * @retval FCB_OK if identified, FCB_ERR_INIT otherwise
+ */
+static FcbRetValType IdentifySdCard(void) {
+    uint8_t ocr[4];
+    uint8_t csd[SD_CSD_SIZE + SD_CRC_SIZE];
+    uint32_t start, cSize, opCondArg;
+    uint8_t r1, i;
+
+    /* CMD0 with CS low enters the SPI mode */
+    for (i = 0, r1 = SD_R1_NO_RESPONSE; i < SD_CMD0_ATTEMPTS && SD_R1_IDLE != r1; i++) {
+        r1 = SendSdCommand(SD_CMD_GO_IDLE_STATE, 0);
+    }
+    if (SD_R1_IDLE != r1) {
+        return FCB_ERR_INIT;
+    }
+
+    /* Version 2 cards echo the voltage range and the check pattern, version 1 cards do not know the command */
+    r1 = SendSdCommand(SD_CMD_SEND_IF_COND, SD_IF_COND_ARG);
+    if (SD_R1_IDLE == r1) {
+        SdSpiReceive(ocr, sizeof(ocr));
+        if (SD_IF_COND_ARG != (((uint32_t) (ocr[2] & 0x0F) << 8) | ocr[3])) {
+            return FCB_ERR_INIT;
+        }
+        sdCardStats.type = SD_CARD_SDSC;
+        opCondArg = SD_OP_COND_HCS;
+    } else if (r1 & SD_R1_ILLEGAL_COMMAND) {
+        sdCardStats.type = SD_CARD_SDV1;
+        opCondArg = 0;
+    } else {
+        return FCB_ERR_INIT;
+    }
+
+    start = HAL_GetTick();
+    while (0 != (r1 = SendSdAppCommand(SD_ACMD_SD_SEND_OP_COND, opCondArg))) {
+        if (SD_R1_IDLE != r1 || HAL_GetTick() - start > SD_CARD_INIT_TIMEOUT) {
+            return FCB_ERR_INIT; // Also MMC cards, which do not know ACMD41
+        }
+        vTaskDelay(1);
+    }
+
+    if (SD_CARD_SDSC == sdCardStats.type) {
+        if (0 != SendSdCommand(SD_CMD_READ_OCR, 0)) {
+            return FCB_ERR_INIT;
+        }
+        SdSpiReceive(ocr, sizeof(ocr));
+        if (ocr[0] & SD_OCR_CCS) {
+            sdCardStats.type = SD_CARD_SDHC;
+        }
+    }
+
+    /* Byte addressed cards may have another default block length */
+    if (SD_CARD_SDHC != sdCardStats.type && 0 != SendSdCommand(SD_CMD_SET_BLOCKLEN, SD_CARD_SECTOR_SIZE)) {
+        return FCB_ERR_INIT;
+    }
+
+    if (0 != SendSdCommand(SD_CMD_SEND_CSD, 0) || FCB_OK != WaitSdDataToken()) {
+        return FCB_ERR_INIT;
+    }
+    SdSpiReceive(csd, sizeof(csd));
+
+    if (1 == (csd[0] >> 6)) {
+        /* CSD version 2: (C_SIZE + 1) * 512 kB */
+        cSize = ((uint32_t) (csd[7] & 0x3F) << 16) | ((uint32_t) csd[8] << 8) | csd[9];
+        sdCardStats.sectors = (cSize + 1) * 1024;
+    } else {
+        /* CSD version 1: (C_SIZE + 1) * 2^(C_SIZE_MULT + 2) blocks of 2^READ_BL_LEN bytes */
+        cSize = ((uint32_t) (csd[6] & 0x03) << 10) | ((uint32_t) csd[7] << 2) | (csd[8] >> 6);
+        sdCardStats.sectors = (cSize + 1) << ((((csd[9] & 0x03) << 1) | (csd[10] >> 7)) + 2 + (csd[5] & 0x0F) - 9);
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Sends a byte and returns the byte received meanwhile
+ * @param  txByte : Byte to send, 0xFF to only receive
+ * @retval The received byte, 0xFF if the transfer failed
+ */
+static uint8_t SdSpiExchange(const uint8_t txByte) {
+    uint8_t tx = txByte;
+    uint8_t rx;
+
+    if (HAL_OK != HAL_SPI_TransmitReceive(&SdCardSpiHandle, &tx, &rx, 1, SD_SPI_TIMEOUT)) {
+        return 0xFF;
+    }
+
+    return rx;
+}
+
+/*
+ * @brief  Receives bytes, sending 0xFF
+ * @param  dst : Destination of the bytes
+ * @param  size : Number of bytes
+ * @retval None
+ */
+static void SdSpiReceive(uint8_t* dst, const uint16_t size) {
+    /* Each byte is sent before the one received in its place is written */
+    memset(dst, 0xFF, size);
+    if (HAL_OK != HAL_SPI_TransmitReceive(&SdCardSpiHandle, dst, dst, size, SD_SPI_TIMEOUT)) {
+        memset(dst, 0xFF, size);
+    }
+}
+
+static void SelectSdCard(void) {
+    SD_CS_LOW();
+    (void) SdSpiExchange(0xFF);
+}
+
+/*
+ * @brief  Deselects the card, with one more byte for it to release MISO
+ * @param  None
+ * @retval None
+ */
+static void DeselectSdCard(void) {
+    SD_CS_HIGH();
+    (void) SdSpiExchange(0xFF);
+}
+
+/*
+ * @brief  Sends a command to the selected card, when it is not busy, and receives the R1 response. The bytes of a
+ *         R3 or R7 response that follow R1 are to be received by the caller.
+ * @param  cmd : Command index
+ * @param  arg : Command argument
+ * @retval R1, SD_R1_NO_RESPONSE if the card did not respond
+ */
+static uint8_t SendSdCommand(const uint8_t cmd, const uint32_t arg) {
+    uint8_t frame[6];
+    uint8_t r1 = SD_R1_NO_RESPONSE;
+    uint8_t i;
+
+    if (SD_CMD_GO_IDLE_STATE != cmd && FCB_OK != WaitSdCardReady(SD_CARD_BUSY_TIMEOUT)) {
+        return SD_R1_NO_RESPONSE;
+    }
+
+    frame[0] = 0x40 | cmd;
+    frame[1] = (uint8_t) (arg >> 24);
+    frame[2] = (uint8_t) (arg >> 16);
+    frame[3] = (uint8_t) (arg >> 8);
+    frame[4] = (uint8_t) arg;
+
+    /* The CRC is only checked for CMD0 and CMD8 in SPI mode */
+    if (SD_CMD_GO_IDLE_STATE == cmd) {
+        frame[5] = 0x95;
+    } else if (SD_CMD_SEND_IF_COND == cmd) {
+        frame[5] = 0x87;
+    } else {
+        frame[5] = 0x01;
+    }
+
+    for (i = 0; i < sizeof(frame); i++) {
+        (void) SdSpiExchange(frame[i]);
+    }
+
+    for (i = 0; i < SD_R1_RESPONSE_BYTES && (r1 & 0x80); i++) {
+        r1 = SdSpiExchange(0xFF);
+    }
+
+    return r1;
+}
+
+static uint8_t SendSdAppCommand(const uint8_t cmd, const uint32_t arg) {
+    uint8_t r1 = SendSdCommand(SD_CMD_APP_CMD, 0);
+
+    if (r1 > SD_R1_IDLE) {
+        return r1;
+    }
+
+    return SendSdCommand(cmd, arg);
+}
+
+/*
+ * @brief  Waits for the selected card to not be busy, MISO high. Polls for about 0.2 ms, then sleeps a tick between
+ *         the polls, so that lower priority tasks run while a block is programmed.
+ * @param  timeout : Max wait [ms]
+ * @retval FCB_OK if ready, FCB_ERR otherwise
+ */
+static FcbRetValType WaitSdCardReady(const uint32_t timeout) {
+    uint32_t start = HAL_GetTick();
+    uint32_t busyTime;
+    uint16_t polls = 0;
+
+    while (0xFF != SdSpiExchange(0xFF)) {
+        busyTime = HAL_GetTick() - start;
+        if (busyTime > timeout) {
+            return FCB_ERR;
+        }
+        if (++polls >= SD_POLLS_BEFORE_DELAY) {
+            vTaskDelay(1);
+        }
+    }
+
+    busyTime = HAL_GetTick() - start;
+    if (busyTime > sdCardStats.maxBusyTime) {
+        sdCardStats.maxBusyTime = busyTime;
+    }
+
+    return FCB_OK;
+}
+
+/*
+ * @brief  Waits for the start block token of a read
+ * @param  None
+ * @retval FCB_OK if received, FCB_ERR otherwise
+ */
+static FcbRetValType WaitSdDataToken(void) {
+    uint32_t start = HAL_GetTick();
+    uint16_t polls = 0;
+    uint8_t token;
+
+    while (0xFF == (token = SdSpiExchange(0xFF))) {
+        if (HAL_GetTick() - start > SD_CARD_READ_TIMEOUT) {
+            return FCB_ERR;
+        }
+        if (++polls >= SD_POLLS_BEFORE_DELAY) {
+            vTaskDelay(1);
+        }
+    }
+
+    return (SD_TOKEN_START_BLOCK == token) ? FCB_OK : FCB_ERR;
+}
+
+/*
+ * @brief  Waits for the DMA of the sent sector of the multiple block write, sends its dummy CRC and waits for the
+ *         card to accept and program it
+ * @param  None
+ * @retval FCB_OK if programmed, FCB_ERR otherwise, the card has then failed
+ */
+static FcbRetValType FinishSdStreamBlock(void) {
+    uint8_t response;
+
+    isSdBlockPending = false;
+
+    if (pdTRUE != xSemaphoreTake(sdDmaSemaphore, SD_CARD_DMA_TIMEOUT / portTICK_RATE_MS) || isSdDmaFailed) {
+        FailSdCard();
+        return FCB_ERR;
+    }
+
+    (void) SdSpiExchange(0xFF);
+    (void) SdSpiExchange(0xFF);
+    response = SdSpiExchange(0xFF);
+
+    if (SD_DATA_RESPONSE_ACCEPTED != (response & SD_DATA_RESPONSE_MASK)
+            || FCB_OK != WaitSdCardReady(SD_CARD_BUSY_TIMEOUT)) {
+        FailSdCard();
+        return FCB_ERR;
+    }
+
+    sdCardStats.sectorsWritten++;
+    return FCB_OK;
+}
+
+/*
+ * @brief  Ends the multiple block write, if any, when the card has programmed its last sector
+ * @param  None
+ * @retval FCB_OK if ended, FCB_ERR otherwise
+ */
+static FcbRetValType StopSdStream(void) {
+    if (!isSdStreaming) {
+        return FCB_OK;
+    }
+
+    if (isSdBlockPending && FCB_OK != FinishSdStreamBlock()) {
+        return FCB_ERR;
+    }
+
+    /* The card signals busy from the byte after the stop token */
+    (void) SdSpiExchange(SD_TOKEN_STOP_MULTI_WRITE);
+    (void) SdSpiExchange(0xFF);
+    if (FCB_OK != WaitSdCardReady(SD_CARD_BUSY_TIMEOUT)) {
+        FailSdCard();
+        return FCB_ERR;
+    }
+
+    DeselectSdCard();
+    isSdStreaming = false;
+    return FCB_OK;
+}
+
+/*
+ * @brief  Stops an ongoing transfer and marks the card as failed, it is to be initialised again. FAT-SL sees it as
+ *         removed and mounts the volume again.
+ * @param  None
+ * @retval None
+ */
+static void FailSdCard(void) {
+    if (HAL_SPI_STATE_READY != HAL_SPI_GetState(&SdCardSpiHandle)) {
+        (void) HAL_DMA_Abort(SdCardSpiHandle.hdmatx);
+        CLEAR_BIT(SdCardSpiHandle.Instance->CR2, SPI_CR2_TXDMAEN);
+        SdCardSpiHandle.State = HAL_SPI_STATE_READY;
+    }
+
+    DeselectSdCard();
+    isSdStreaming = false;
+    isSdBlockPending = false;
+    isSdCardReady = false;
+    sdCardStats.errors++;
+}
+
+static uint32_t GetSdCardAddress(const uint32_t sector) {
+    return (SD_CARD_SDHC == sdCardStats.type) ? sector : sector * SD_CARD_SECTOR_SIZE;
+}
+
+static int SdDriverWriteSector(F_DRIVER* driver, void* data, unsigned long sector) {
+    (void) driver;
+    return (FCB_OK == SdCardWriteSector(data, sector)) ? 0 : SD_CARD_DRIVER_ERR;
+}
+
+static int SdDriverReadSector(F_DRIVER* driver, void* data, unsigned long sector) {
+    (void) driver;
+    return (FCB_OK == SdCardReadSector(data, sector)) ? 0 : SD_CARD_DRIVER_ERR;
+}
+
+/*
+ * @brief  Gets the card geometry for FAT-SL, the usual translated one of cards
+ * @param  driver : Media driver
+ * @param  phy : Destination of the geometry
+ * @retval 0
+ */
+static int SdDriverGetPhy(F_DRIVER* driver, F_PHY* phy) {
+    (void) driver;
+
+    phy->number_of_sectors = sdCardStats.sectors;
+    phy->bytes_per_sector = SD_CARD_SECTOR_SIZE;
+    phy->media_descriptor = F_MEDIADESC_REMOVABLE;
+    phy->sector_per_track = 63;
+    phy->number_of_heads = 255;
+    phy->number_of_cylinders = (unsigned short) (sdCardStats.sectors / (63 * 255));
+
+    return 0;
+}
+
+/*
+ * @brief  Gets the card status for FAT-SL, a failed card is missing until it is initialised again
+ * @param  driver : Media driver
+ * @retval F_ST_MISSING if failed, 0 otherwise
+ */
+static long SdDriverGetStatus(F_DRIVER* driver) {
+    (void) driver;
+    return isSdCardReady ? 0 : F_ST_MISSING;
+}
+
+#endif /* FCB_SD_CARD */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
@@ -0,0 +1,72 @@
+/******************************************************************************
+ * @file    seqlock.c
+ * @author  Dragonfly
+ * @brief   Functions for double buffered sequence locks protecting small
+ *          shared data that has a single writer
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "seqlock.h"
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Marks the start of a write, only one writer is allowed. The writer fills the unpublished copy completely,
+ *         starting from the published one if it only updates a part of the data.
+ * @param  lock : Pointer to the sequence lock
+ * @retval Index of the copy to write
+ */
+uint32_t SeqLockWriteBegin(SeqLock_TypeDef* lock) {
+	return SEQLOCK_COPY(lock->sequence + 1);
+}
+
+/*
+ * @brief  Marks the end of a write and publishes the written copy
+ * @param  lock : Pointer to the sequence lock
+ * @retval None
+ */
+void SeqLockWriteEnd(SeqLock_TypeDef* lock) {
+	__DMB(); /* copy must be complete before it is published */
+	lock->sequence++;
+}
+
+/*
+ * @brief  Starts a read. Never waits, the copy the sequence publishes is not written until the writer has published
+ *         the other one, so it may also be called from an ISR.
+ * @param  lock : Pointer to the sequence lock
+ * @retval Sequence to pass to SEQLOCK_COPY and SeqLockReadRetry
+ */
+uint32_t SeqLockReadBegin(SeqLock_TypeDef* lock) {
+	uint32_t sequence = lock->sequence;
+
+	__DMB(); /* copy must be read after the sequence that published it */
+
+	return sequence;
+}
+
+/*
+ * @brief  Checks if the copy read since SeqLockReadBegin may be torn, i.e. the writer published the other copy
+ *         meanwhile, after which it may be writing this one again
+ * @param  lock : Pointer to the sequence lock
+ * @param  startSequence : Value returned by SeqLockReadBegin
+ * @retval true if the read must be redone
+ */
+bool SeqLockReadRetry(SeqLock_TypeDef* lock, const uint32_t startSequence) {
+	__DMB();
+	return lock->sequence != startSequence;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
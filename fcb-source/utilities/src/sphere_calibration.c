@@ -13,71 +13,91 @@
 #include <arm_math.h>
 
 /* Private typedef -----------------------------------------------------------*/
+
+//moments of the observations, i.e. the sums divided by N, in units of the radius guessed from the observed ranges
+typedef struct {
+	float32_t mu[3];
+	float32_t mu2[3];
+	float32_t ipXX[6];
+	float32_t ipX2X[3][3];
+	float32_t ipX2X2[6];
+} SphereMoments_TypeDef;
+
 /* Private define ------------------------------------------------------------*/
+#define SPHERE_MIN_SAMPLES      10  // Fewer samples are not fitted
+#define SPHERE_MAX_ITERATIONS   20
 
 /* Private variables ---------------------------------------------------------*/
 
-//observation summary structures
-float32_t mu[3]; //sum of all observations in each dimension
-float32_t mu2[3];  //sum of squares of all observations in each dimension
-float32_t ipXX[6]; //Symmetric matrix of inner products of observations with themselves
-float32_t ipX2X[3][3]; //matrix of inner products of squares of observations with the observations
-float32_t ipX2X2[6]; //Symmetric matrix of inner products of squares of observations with themselves
-int32_t N;  //The number of observations
-
-float32_t obsMin[3]; // Keep track of min observation in each dimension to guess parameters
-float32_t obsMax[3]; // Keep track of max observation in each dimension to guess parameters
+//observation summary accumulated by addNewSample, handed over to the solver by takeObservations
+static SphereObservations_TypeDef obs;
 
 /* Private function prototypes -----------------------------------------------*/
 uint32_t upperTriangularIndex(uint32_t i, uint32_t j);
 
-void computeGNMatrices(float32_t JtJ[][6], float32_t JtR[], float32_t beta[6]);
+static float32_t computeMoments(const SphereObservations_TypeDef* o, SphereMoments_TypeDef* m);
+void computeGNMatrices(const SphereMoments_TypeDef* m, float32_t JtJ[][6], float32_t JtR[], float32_t beta[6]);
 
 /* Exported functions --------------------------------------------------------*/
 
 void clearObservationMatrices() {
-	memset(mu, 0, sizeof(mu));
-	memset(mu2, 0, sizeof(mu));
-	memset(ipXX, 0, sizeof(ipXX));
-	memset(ipX2X, 0, sizeof(ipX2X));
-	memset(ipX2X2, 0, sizeof(ipX2X2));
-	memset(obsMin, 0, sizeof(obsMin));
-	memset(obsMax, 0, sizeof(obsMax));
-	N = 0;
+	memset(&obs, 0, sizeof(obs));
 }
 
-void addNewSample(const float32_t samples[3]) {
+/*
+ * Adds a sample to the observations. The sums are accumulated in integers, so that they stay exact for any number of
+ * samples up to SPHERE_MAX_SAMPLES. Samples beyond that, or larger than SPHERE_MAX_SAMPLE_MAGNITUDE, are skipped.
+ */
+void addNewSample(const int16_t samples[3]) {
     uint32_t i, j;
+    int32_t squareObs[3];
+
+    if (obs.N >= (int32_t) SPHERE_MAX_SAMPLES) {
+        return;
+    }
+    for (i=0; i < 3; ++i) {
+        if (samples[i] > SPHERE_MAX_SAMPLE_MAGNITUDE || samples[i] < -SPHERE_MAX_SAMPLE_MAGNITUDE) {
+            return;
+        }
+    }
 
     //increment sample count
-    ++N;
+    ++obs.N;
 
-    float32_t squareObs[3];
     for (i=0; i < 3; ++i) {
-        squareObs[i] = samples[i]*samples[i];  //square of 16-bit int will fit in 32-bit int
+        squareObs[i] = (int32_t) samples[i]*samples[i];  //square of 12-bit int will fit in 32-bit int
     }
 
     for (i=0; i < 3; ++i) {
         //Keep track of min and max in each dimension
-        obsMin[i] = (samples[i] < obsMin[i]) ? samples[i] : obsMin[i];
-        obsMax[i] = (samples[i] > obsMax[i]) ? samples[i] : obsMax[i];
+        obs.obsMin[i] = (samples[i] < obs.obsMin[i]) ? samples[i] : obs.obsMin[i];
+        obs.obsMax[i] = (samples[i] > obs.obsMax[i]) ? samples[i] : obs.obsMax[i];
 
         //accumulate sum and sum of squares in each dimension
-        mu[i] += samples[i];
-        mu2[i] += squareObs[i];
+        obs.mu[i] += samples[i];
+        obs.mu2[i] += squareObs[i];
 
         //accumulate inner products of the vector of observations and the vector of squared observations.
         for(j=0;j<3;++j) {
-            ipX2X[i][j] += squareObs[i]*samples[j];
+            obs.ipX2X[i][j] += (int64_t) squareObs[i]*samples[j];
             if(i <= j) {
                 uint32_t idx = upperTriangularIndex(i,j);
-                ipXX[idx] += samples[i]*samples[j];
-                ipX2X2[idx] += squareObs[i]*squareObs[j];
+                obs.ipXX[idx] += (int32_t) samples[i]*samples[j];
+                obs.ipX2X2[idx] += (int64_t) squareObs[i]*squareObs[j];
             }
         }
     }
 }
 
+/*
+ * Hands the observations accumulated by addNewSample over to the caller, e.g. to be solved by calibrate in another
+ * task, and starts a new set
+ */
+void takeObservations(SphereObservations_TypeDef* observations) {
+	*observations = obs;
+	clearObservationMatrices();
+}
+
 
 uint32_t upperTriangularIndex(uint32_t i, uint32_t j) {
   if (i > j) {
@@ -89,11 +109,46 @@ uint32_t upperTriangularIndex(uint32_t i, uint32_t j) {
   return (j*(j+1))/2 + i;
 }
 
-void guessParameters(float32_t beta[6]) {
+void guessParameters(const SphereObservations_TypeDef* o, float32_t unit, float32_t beta[6]) {
     for(int i=0;i<3;++i) {
-      beta[i] = (obsMax[i] + obsMin[i]) / 2.0;
-      beta[3+i] = (obsMax[i] - obsMin[i]) / 2.0;
+      beta[i] = (o->obsMax[i] + o->obsMin[i]) / (2.0f * unit);
+      beta[3+i] = (o->obsMax[i] - o->obsMin[i]) / (2.0f * unit);
+  }
+}
+
+/*
+ * Converts the exact sums to moments in units of the mean half range of the observations, so that the values the
+ * Gauss-Newton matrices are computed from are all of order 1 whatever the number of samples and the sensor scale.
+ * Returns the unit, or 0 if the observations have no range.
+ */
+static float32_t computeMoments(const SphereObservations_TypeDef* o, SphereMoments_TypeDef* m) {
+  uint32_t i, j;
+  float32_t unit = 0.0;
+  float32_t unit2, unit3, unit4;
+
+  for (i=0; i<3; ++i) {
+    unit += (o->obsMax[i] - o->obsMin[i]) / 6.0f;
   }
+  if (!(unit > 0.0f) || o->N <= 0) {
+    return 0.0f;
+  }
+  unit2 = unit*unit;
+  unit3 = unit2*unit;
+  unit4 = unit2*unit2;
+
+  for (i=0; i<3; ++i) {
+    m->mu[i] = (float32_t) o->mu[i] / o->N / unit;
+    m->mu2[i] = (float32_t) o->mu2[i] / o->N / unit2;
+    for (j=0; j<3; ++j) {
+      m->ipX2X[i][j] = (float32_t) o->ipX2X[i][j] / o->N / unit3;
+    }
+  }
+  for (i=0; i<6; ++i) {
+    m->ipXX[i] = (float32_t) o->ipXX[i] / o->N / unit2;
+    m->ipX2X2[i] = (float32_t) o->ipX2X2[i] / o->N / unit4;
+  }
+
+  return unit;
 }
 
 void clearGNMatrices(float32_t JtJ[][6], float32_t JtR[]){
@@ -106,28 +161,28 @@ void clearGNMatrices(float32_t JtJ[][6], float32_t JtR[]){
     }
 }
 
-void computeGNMatrices(float JtJ[][6], float JtR[], float32_t beta[6]) {
+void computeGNMatrices(const SphereMoments_TypeDef* m, float JtJ[][6], float JtR[], float32_t beta[6]) {
   uint32_t i,j;
 
   float32_t beta2[6]; //precompute the squares of the model parameters
   for (i=0; i<6; ++i) {
-    beta2[i] = pow(beta[i],2);
+    beta2[i] = beta[i]*beta[i];
   }
 
   //compute the inner product of the vector of residuals with the constant 1 vector, the vector of
   // observations, and the vector of squared observations.
-  float32_t r = N; //sum of residuals
+  float32_t r = 1.0; //mean of residuals, the moments are means
   float32_t rx[3];  //Inner product of vector of residuals with each observation vector
   float32_t rx2[3];  //Inner product of vector of residuals with each square observation vector
 
   //now correct the r statistics
   for(i=0 ;i<3; ++i) {
-    r -= (beta2[i]*N + mu2[i] - 2*beta[i]*mu[i])/beta2[3+i];
-    rx[i] = mu[i];
-    rx2[i] = mu2[i];
+    r -= (beta2[i] + m->mu2[i] - 2*beta[i]*m->mu[i])/beta2[3+i];
+    rx[i] = m->mu[i];
+    rx2[i] = m->mu2[i];
     for(j=0;j<3;++j) {
-      rx[i] -= (beta2[j]*mu[i] + ipX2X[j][i] - 2*ipXX[upperTriangularIndex(i,j)]*beta[j])/beta2[3+j];
-      rx2[i] -= (beta2[j]*mu2[i] + ipX2X2[upperTriangularIndex(i,j)] - 2*ipX2X[i][j]*beta[j])/beta2[3+j];
+      rx[i] -= (beta2[j]*m->mu[i] + m->ipX2X[j][i] - 2*m->ipXX[upperTriangularIndex(i,j)]*beta[j])/beta2[3+j];
+      rx2[i] -= (beta2[j]*m->mu2[i] + m->ipX2X2[upperTriangularIndex(i,j)] - 2*m->ipX2X[i][j]*beta[j])/beta2[3+j];
     }
   }
 
@@ -139,17 +194,17 @@ void computeGNMatrices(float JtJ[][6], float JtR[], float32_t beta[6]) {
     //Now compute the product of the transpose of the jacobian with itself
     //Start with the diagonal blocks
     for(j=i;j<3;++j) {
-      JtJ[i][j] = JtJ[j][i] = 4*(ipXX[upperTriangularIndex(i,j)] - beta[i]*mu[j] - beta[j]*mu[i] + beta[i]*beta[j]*N)/(beta2[3+i]*beta2[3+j]);
+      JtJ[i][j] = JtJ[j][i] = 4*(m->ipXX[upperTriangularIndex(i,j)] - beta[i]*m->mu[j] - beta[j]*m->mu[i] + beta[i]*beta[j])/(beta2[3+i]*beta2[3+j]);
       JtJ[3+i][3+j] = JtJ[3+j][3+i]
-                =  4*(ipX2X2[upperTriangularIndex(i,j)] - 2*beta[j]*ipX2X[i][j] + beta2[j]*mu2[i]
-                       -2*beta[i]*ipX2X[j][i] + 4*beta[i]*beta[j]*ipXX[upperTriangularIndex(i,j)] - 2*beta[i]*beta2[j]*mu[i]
-                       +beta2[i]*mu2[j] - 2*beta2[i]*beta[j]*mu[j] + beta2[i]*beta2[j]*N)/pow(beta[3+i]*beta[3+j], 3);
+                =  4*(m->ipX2X2[upperTriangularIndex(i,j)] - 2*beta[j]*m->ipX2X[i][j] + beta2[j]*m->mu2[i]
+                       -2*beta[i]*m->ipX2X[j][i] + 4*beta[i]*beta[j]*m->ipXX[upperTriangularIndex(i,j)] - 2*beta[i]*beta2[j]*m->mu[i]
+                       +beta2[i]*m->mu2[j] - 2*beta2[i]*beta[j]*m->mu[j] + beta2[i]*beta2[j])/(beta2[3+i]*beta[3+i]*beta2[3+j]*beta[3+j]);
     }
     //then get the off diagonal blocks
     for(j=0;j<3;++j) {
       JtJ[i][3+j] = JtJ[3+j][i]
-          = 4*(ipX2X[j][i] - 2*beta[j]*ipXX[upperTriangularIndex(i,j)] + beta2[j]*mu[i]
-                -beta[i]*mu2[j] + 2*beta[i]*beta[j]*mu[j] - beta[i]*beta2[j]*N)/(beta2[3+i]*beta2[3+j]*beta[3+j]);
+          = 4*(m->ipX2X[j][i] - 2*beta[j]*m->ipXX[upperTriangularIndex(i,j)] + beta2[j]*m->mu[i]
+                -beta[i]*m->mu2[j] + 2*beta[i]*beta[j]*m->mu[j] - beta[i]*beta2[j])/(beta2[3+i]*beta2[3+j]*beta[3+j]);
     }
   }
 }
@@ -165,7 +220,7 @@ void findDelta(float32_t JtJ[][6], float32_t JtR[]){
 	for(i=0;i<6;++i) {
 		//eliminate all nonzero entries below JS[i][i]
 
-		if( JtJ[i][i] == 0.0) {
+		if( JtJ[i][i] == 0.0f) {
 //      	Serial.print("Diagonal entry ");
 //      	Serial.print(i);
 //      	Serial.print(" is zero!\n");
@@ -173,7 +228,7 @@ void findDelta(float32_t JtJ[][6], float32_t JtR[]){
 
 		for(j=i+1;j<6;++j) {
 			lambda = JtJ[j][i]/JtJ[i][i];
-			if(lambda != 0.0) {
+			if(lambda != 0.0f) {
 				JtR[j] -= lambda*JtR[i];
 				for(k=i;k<6;++k) {
 					JtJ[j][k] -= lambda*JtJ[i][k];
@@ -194,21 +249,36 @@ void findDelta(float32_t JtJ[][6], float32_t JtR[]){
 	}
 }
 
-void calibrate(float32_t calibParams[6]) {
+/*
+ * Solves the sphere fit of a set of observations. Takes up to 20 Gauss-Newton iterations, so it is run by a low
+ * priority task rather than the one sampling the sensor. The parameters are the offsets and radii, in the units of
+ * the samples times the scale.
+ */
+FcbRetValType calibrate(const SphereObservations_TypeDef* observations, float32_t scale, float32_t calibParams[6]) {
+	SphereMoments_TypeDef moments;
+	float32_t unit;
 	//Final calibration parameters
 	float32_t beta[6];
 
-	guessParameters(beta);
+	if (observations->N < SPHERE_MIN_SAMPLES) {
+		return FCB_ERR;
+	}
+	unit = computeMoments(observations, &moments);
+	if (!(unit > 0.0f)) {
+		return FCB_ERR;
+	}
+
+	guessParameters(observations, unit, beta);
 	float32_t JtJ[6][6];
 	float32_t JtR[6];
 	clearGNMatrices(JtJ,JtR);
 
-	float32_t eps = 0.000000001;
-	int num_iterations = 20;
-	float32_t change = 100.0;
+	float32_t eps = 0.000000001f;
+	int num_iterations = SPHERE_MAX_ITERATIONS;
+	float32_t change = 100.0f;
 
 	while (--num_iterations >=0 && change > eps) {
-		computeGNMatrices(JtJ, JtR, beta);
+		computeGNMatrices(&moments, JtJ, JtR, beta);
 		findDelta(JtJ, JtR);
 
 		change = JtR[0]*JtR[0] +
@@ -218,14 +288,16 @@ void calibrate(float32_t calibParams[6]) {
 				JtR[4]*JtR[4]*(beta[4]*beta[4]) +
 				JtR[5]*JtR[5]*(beta[5]*beta[5]);
 
-		if (!isnan(change)) {
-			uint32_t i;
-			for(i=0; i<6; ++i) {
-				beta[i] -= JtR[i];
+		if (isnan(change)) {
+			return FCB_ERR;
+		}
 
-				if(i >=3) {
-					beta[i] = fabs(beta[i]);
-				}
+		uint32_t i;
+		for(i=0; i<6; ++i) {
+			beta[i] -= JtR[i];
+
+			if(i >=3) {
+				beta[i] = fabsf(beta[i]);
 			}
 		}
 		clearGNMatrices(JtJ,JtR);
@@ -233,9 +305,8 @@ void calibrate(float32_t calibParams[6]) {
 
 	uint32_t i;
 	for (i=0; i<6; i++) {
-		calibParams[i] = beta[i];
+		calibParams[i] = beta[i] * unit * scale;
 	}
 
-	clearObservationMatrices();
+	return FCB_OK;
 }
-
@@ -1,131 +1,494 @@
 /**
  ******************************************************************************
  * @file    task_status.c
- * @brief   Task status module responsible for handling the timer needed for
- * 			vTaskGetRunTimeStats() function.
+ * @brief   Task status module. Drives the FreeRTOS run time statistics with
+ * 			the DWT cycle counter and samples the run time, stack high-water
+ * 			mark and context switches of each task periodically, so that the
+ * 			task load is reported over a sliding window instead of since boot.
+ * 			Also monitors the FreeRTOS heap through the heap_2 trace macros.
  ******************************************************************************
  */
 /* Includes ------------------------------------------------------------------*/
 #include "FreeRTOSConfig.h"
 #include "stm32f3xx_hal.h"
-#include "trace.h"
 #include "task_status.h"
+#include "fcb_error.h"
+#include "cpu_headroom.h"
+#include "mem_pool.h"
+#include "rate_groups.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <string.h>
 
 /* Private typedef -----------------------------------------------------------*/
 
+/* Run time and context switches of one task at a sample */
+typedef struct {
+	unsigned portBASE_TYPE taskNumber;      // Unique per created task, matches a task between samples
+	unsigned long runTime;                  // [core clock cycles]
+	unsigned portBASE_TYPE contextSwitches;
+} TaskSample_TypeDef;
+
+typedef struct {
+	unsigned long totalRunTime;             // Run time counter at the sample [core clock cycles]
+	uint8_t nbrOfTasks;
+	TaskSample_TypeDef task[TASK_STATUS_MAX_TASKS];
+} TaskSnapshot_TypeDef;
+
+/* Parts printed by TaskStatusPrintNext(), in order */
+typedef enum {
+	TASK_STATUS_PRINT_HEADER = 0,   // Takes the snapshot the other parts are printed from
+	TASK_STATUS_PRINT_TASKS,
+	TASK_STATUS_PRINT_LOAD,
+	TASK_STATUS_PRINT_HEAP,
+	TASK_STATUS_PRINT_POOLS
+} TaskStatusPrintPart_TypeDef;
+
 /* Private define ------------------------------------------------------------*/
-#define PERIOD	0xFFFF
-#define INIT_ERROR	0
-#define	START_ERROR	1
+#define IDLE_TASK_NAME	"IDLE"
+#define HEAP_SIZE		(configTOTAL_HEAP_SIZE - portBYTE_ALIGNMENT) // As configADJUSTED_HEAP_SIZE of heap_2
 
 /* Private macro -------------------------------------------------------------*/
 
 /* Private variables ---------------------------------------------------------*/
-volatile unsigned long ulHighFrequencyTimerTicks;
-static uint32_t TaskStatusTimerPeriodCount = 0;
-static uint32_t uwPrescalerValue = 0;
+static RateGroupJobId_TypeDef taskStatusJobId = RATE_GROUP_INVALID_ID;
+
+/* Kept static, the rate group task that samples has a small stack */
+static xTaskStatusType systemState[TASK_STATUS_MAX_TASKS];
+static TaskSnapshot_TypeDef snapshots[TASK_STATUS_WINDOW_SAMPLES];
+static uint8_t newestSnapshot = 0;
+static uint8_t nbrOfSnapshots = 0;
+
+/* Status over the window of the last sample, read and written with the scheduler suspended */
+static TaskStatus_TypeDef taskStatus[TASK_STATUS_MAX_TASKS];
+static uint8_t nbrOfTaskStatus = 0;
+static uint32_t taskStatusWindow = 0;       // [ms]
+
+/* Heap counters, written by the heap_2 trace macros with the scheduler suspended */
+static size_t heapMinimumEverFree = HEAP_SIZE;
+static uint32_t heapAllocations = 0;
+static uint32_t heapFrees = 0;
+static uint32_t heapFailedAllocations = 0;
+static size_t heapLastFailedSize = 0;
+static uint32_t heapRuntimeAllocations = 0;
+static uint32_t heapRuntimeFrees = 0;
+
+/* Progress of TaskStatusPrintNext(), used by the CLI commands only */
+static uint8_t printNextRow = 0;            // Next task or memory pool
+static TaskStatusPrintPart_TypeDef printPart = TASK_STATUS_PRINT_HEADER;
+
+/* First task of the next TASK_STATUS_MSG_ENUM message */
+static uint8_t nextEncodedTask = 0;
 
 /* Private function prototypes -----------------------------------------------*/
-static void Error_Handler(uint8_t errorType);
+static void TaskStatusSample(void* argument);
+static const TaskSample_TypeDef* FindTaskSample(const TaskSnapshot_TypeDef* snapshot,
+		const unsigned portBASE_TYPE taskNumber);
+static bool EncodeTaskUsage(pb_ostream_t* stream, const TaskStatus_TypeDef* status);
+static size_t HeapStatusPrint(char* dst, const size_t dstSize);
 
 /* Exported functions --------------------------------------------------------*/
 
 /**
-  * @brief  This function sets up TASK STATUS timer, defined in task_status.h
+  * @brief  This function starts the periodic sampling of the task status
   * @param  None
   * @retval None
   */
 void InitMonitoring(void){
+	if (FCB_OK != RateGroupRegister("TASK_STATUS", TaskStatusSample, NULL, RATE_GROUP_1HZ, TASK_STATUS_SAMPLE_PHASE,
+			&taskStatusJobId)) {
+		ErrorHandler();
+	}
+}
 
-	/* Compute the prescaler value to have TIM counter clock equal to 10 KHz */
-	  uwPrescalerValue = (uint32_t) (SystemCoreClock / 10000) - 1;
+/**
+  * @brief  This function makes sure the DWT cycle counter runs for the task status feature. It is started by
+  * 		InitTimestampCounter() already, but not reset here since the sensor timestamps use it too.
+  * @param  None
+  * @retval None
+  */
+void configureTimerForRunTimeStats(void)
+{
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
 
-	  /* Set TIMx instance */
-	  TaskStatusTimHandle.Instance = TASK_STATUS_TIM;
+/**
+  * @brief  This function gets the run time counter value for the task status feature.
+  * @param  None
+  * @retval The DWT cycle counter [core clock cycles]
+  */
+unsigned getRunTimeCounterValue(void)
+{
+	return DWT->CYCCNT;
+}
 
-	  /* Initialize TIMx peripheral */
-	  TaskStatusTimHandle.Init.Period = PERIOD;//10000 - 1;
-	  TaskStatusTimHandle.Init.Prescaler = uwPrescalerValue;
-	  TaskStatusTimHandle.Init.ClockDivision = 0;
-	  TaskStatusTimHandle.Init.CounterMode = TIM_COUNTERMODE_UP;
+/**
+  * @brief  Gets the status of the tasks over the load window of the last sample
+  * @param  dstStatus : Destination status, maxTasks
+  * @param  maxTasks : Size of dstStatus
+  * @param  windowLength : Destination for the length of the window [ms], 0 before the second sample
+  * @retval Number of tasks copied
+  */
+uint8_t GetTaskStatus(TaskStatus_TypeDef* dstStatus, const uint8_t maxTasks, uint32_t* windowLength) {
+	uint8_t nbrOfTasks;
 
-	  if(HAL_TIM_Base_Init(&TaskStatusTimHandle) != HAL_OK)
-	  {
-	    Error_Handler(INIT_ERROR);
-	  }
+	vTaskSuspendAll();
+	nbrOfTasks = (nbrOfTaskStatus < maxTasks) ? nbrOfTaskStatus : maxTasks;
+	memcpy(dstStatus, taskStatus, nbrOfTasks * sizeof(TaskStatus_TypeDef));
+	*windowLength = taskStatusWindow;
+	xTaskResumeAll();
 
-	   /* Start Channel1 */
-	   if(HAL_TIM_Base_Start_IT(&TaskStatusTimHandle) != HAL_OK)
-	   {
-	     Error_Handler(START_ERROR);
-	   }
+	return nbrOfTasks;
+}
 
+/**
+  * @brief  Gets the status of one task over the load window of the last sample
+  * @param  index : Order of the task in the sample
+  * @param  dstStatus : Destination status
+  * @param  windowLength : Destination for the length of the window [ms], 0 before the second sample
+  * @retval true if copied, false if the last sample has fewer tasks
+  */
+bool GetTaskStatusByIndex(const uint8_t index, TaskStatus_TypeDef* dstStatus, uint32_t* windowLength) {
+	bool found;
+
+	vTaskSuspendAll();
+	found = (index < nbrOfTaskStatus);
+	if (found) {
+		*dstStatus = taskStatus[index];
+	}
+	*windowLength = taskStatusWindow;
+	xTaskResumeAll();
+
+	return found;
 }
 
 /**
-  * @brief  This function is called from the callback function in stm32f3xx_hal_callback.c
-  * 		and it increases the period counter for the timer.
+  * @brief  Gets the least free stack of the tasks, as of the last sample
   * @param  None
+  * @retval Least stack high water mark of the tasks [bytes], 0 before the first sample
+  */
+uint16_t GetMinStackHighWaterMark(void) {
+	uint16_t minHighWaterMark = (nbrOfTaskStatus > 0) ? UINT16_MAX : 0;
+	uint8_t i;
+
+	vTaskSuspendAll();
+	for (i = 0; i < nbrOfTaskStatus; i++) {
+		if (taskStatus[i].stackHighWaterMark < minHighWaterMark) {
+			minHighWaterMark = taskStatus[i].stackHighWaterMark;
+		}
+	}
+	xTaskResumeAll();
+
+	return minHighWaterMark;
+}
+
+/**
+  * @brief  Prints the next part of the task status: the table header, as many task rows as fit, the CPU load as the
+  * 		share of the window not idle with the headroom, the heap usage and the memory pools. The parts are printed
+  * 		one per call, so that a CLI command sends each as one output chunk and the table is not limited by the
+  * 		size of an output buffer. The rows are read one at a time, the table stops early if a sample in between
+  * 		has fewer tasks. Called by the CLI under its mutex.
+  * @param  dst : Destination string buffer, each part fits in 256 bytes
+  * @param  dstSize : Size of dst
+  * @retval true if more parts follow, false if done, the next call starts over with a new snapshot
+  */
+bool TaskStatusPrintNext(char* dst, const size_t dstSize) {
+	TaskStatus_TypeDef status;
+	uint32_t windowLength;
+	uint16_t idleLoad = 0;
+	size_t length = 0;
+	size_t rowLength;
+	uint8_t i;
+	bool moreToFollow = true;
+
+	switch (printPart) {
+	case TASK_STATUS_PRINT_HEADER:
+		if (!GetTaskStatusByIndex(0, &status, &windowLength) || 0 == windowLength) {
+			snprintf(dst, dstSize, "No task status sample yet\n");
+			return false;
+		}
+		snprintf(dst, dstSize, "\nTask status over %lu ms\n%-16s%6s%9s%10s%10s\n", (unsigned long) windowLength,
+				"Task", "Prio", "Load[%]", "Switches", "Stack[b]");
+		printNextRow = 0;
+		printPart = TASK_STATUS_PRINT_TASKS;
+		break;
+
+	case TASK_STATUS_PRINT_TASKS:
+		dst[0] = '\0';
+		while (GetTaskStatusByIndex(printNextRow, &status, &windowLength)) {
+			rowLength = (size_t) snprintf(dst + length, dstSize - length, "%-16s%6lu%6u.%02u%10lu%10u%s\n",
+					status.name, (unsigned long) status.priority, status.load / 100, status.load % 100,
+					(unsigned long) status.contextSwitches, status.stackHighWaterMark,
+					(status.stackHighWaterMark < TASK_STATUS_LOW_STACK) ? " low" : "");
+			if (rowLength >= dstSize - length && length > 0) {
+				dst[length] = '\0'; // Printed in the next part
+				break;
+			}
+			length += rowLength;
+			printNextRow++;
+		}
+		if (!GetTaskStatusByIndex(printNextRow, &status, &windowLength)) {
+			printPart = TASK_STATUS_PRINT_LOAD;
+		}
+		break;
+
+	case TASK_STATUS_PRINT_LOAD:
+		for (i = 0; GetTaskStatusByIndex(i, &status, &windowLength); i++) {
+			if (0 == strncmp(status.name, IDLE_TASK_NAME, configMAX_TASK_NAME_LEN)) {
+				idleLoad = status.load;
+			}
+		}
+		length = (size_t) snprintf(dst, dstSize, "CPU load: %u.%02u %%\n", (10000 - idleLoad) / 100,
+				(10000 - idleLoad) % 100);
+		if (length < dstSize) {
+			CpuHeadroomPrint(dst + length, dstSize - length);
+		}
+		printPart = TASK_STATUS_PRINT_HEAP;
+		break;
+
+	case TASK_STATUS_PRINT_HEAP:
+		HeapStatusPrint(dst, dstSize);
+		printNextRow = 0;
+		printPart = TASK_STATUS_PRINT_POOLS;
+		break;
+
+	case TASK_STATUS_PRINT_POOLS:
+	default:
+		moreToFollow = (MemPoolPrint(dst, dstSize, &printNextRow) > 0);
+		break;
+	}
+
+	if (!moreToFollow) {
+		printPart = TASK_STATUS_PRINT_HEADER;
+	}
+
+	return moreToFollow;
+}
+
+/**
+  * @brief  Gets the usage of the FreeRTOS heap
+  * @param  dstStatus : Destination status
   * @retval None
   */
-void IncreaseTaskStatusTimerPeriodCount(void){
-	TaskStatusTimerPeriodCount++;
+void GetHeapStatus(HeapStatus_TypeDef* dstStatus) {
+	vTaskSuspendAll();
+	dstStatus->total = HEAP_SIZE;
+	dstStatus->free = xPortGetFreeHeapSize();
+	dstStatus->minimumEverFree = heapMinimumEverFree;
+	dstStatus->allocations = heapAllocations;
+	dstStatus->frees = heapFrees;
+	dstStatus->failedAllocations = heapFailedAllocations;
+	dstStatus->lastFailedSize = heapLastFailedSize;
+	dstStatus->runtimeAllocations = heapRuntimeAllocations;
+	dstStatus->runtimeFrees = heapRuntimeFrees;
+	xTaskResumeAll();
 }
 
 /**
-  * @brief  This function returns the period count. Used for debugging.
-  * @param  None
-  * @retval TaskStatusTimerPeriodCount: The number of periods elapsed.
+  * @brief  Encodes the heap usage and the stack and load of as many tasks as fit as a TaskStatusProto message, see
+  * 		task_status.h. The tasks that do not fit are sent in the next message.
+  * @param  stream : Destination stream
+  * @retval true if encoded, false if the stream is too small
   */
-uint32_t GetTaskStatusTimerPeriodCount(void){
-	return TaskStatusTimerPeriodCount;
+bool EncodeTaskStatus(pb_ostream_t* stream) {
+	TaskStatus_TypeDef status;
+	HeapStatus_TypeDef heap;
+	uint32_t windowLength;
+	uint8_t i;
+
+	if (!GetTaskStatusByIndex(0, &status, &windowLength) || 0 == windowLength) {
+		return true; /* No sample yet, the frame is left out */
+	}
+	GetHeapStatus(&heap);
+
+	if (!pb_encode_tag(stream, PB_WT_VARINT, 1) || !pb_encode_varint(stream, heap.total)
+			|| !pb_encode_tag(stream, PB_WT_VARINT, 2) || !pb_encode_varint(stream, heap.free)
+			|| !pb_encode_tag(stream, PB_WT_VARINT, 3) || !pb_encode_varint(stream, heap.minimumEverFree)
+			|| !pb_encode_tag(stream, PB_WT_VARINT, 4) || !pb_encode_varint(stream, heap.failedAllocations)
+			|| !pb_encode_tag(stream, PB_WT_VARINT, 5) || !pb_encode_varint(stream, windowLength)
+			|| !pb_encode_tag(stream, PB_WT_VARINT, 7) || !pb_encode_varint(stream, heap.runtimeAllocations)) {
+		return false;
+	}
+
+	/* The tasks are read one at a time, a copy of all of them is too large for the stack of the telemetry task */
+	i = GetTaskStatusByIndex(nextEncodedTask, &status, &windowLength) ? nextEncodedTask : 0;
+	for (; GetTaskStatusByIndex(i, &status, &windowLength); i++) {
+		if (stream->max_size - stream->bytes_written < TASK_USAGE_MSG_MAX_SIZE) {
+			break;
+		}
+		if (!EncodeTaskUsage(stream, &status)) {
+			return false;
+		}
+	}
+	nextEncodedTask = GetTaskStatusByIndex(i, &status, &windowLength) ? i : 0;
+
+	return true;
 }
 
 /**
-  * @brief  This function configures and resets the TIMx timer and the 32bit timer
-  * 		for the task status feature.
-  * @param  None
+  * @brief  Updates the heap counters after an allocation, called by heap_2 through traceMALLOC
+  * @param  block : Allocated block, NULL if the allocation failed
+  * @param  size : Requested size with the block header and alignment [bytes], 0 for a request of 0 bytes
   * @retval None
   */
-void configureTimerForRunTimeStats(void)
-{
-	//GetTimer
-	TaskStatusTimHandle.State = HAL_TIM_STATE_RESET;
-    ulHighFrequencyTimerTicks = 0UL;
+void TaskStatusTraceMalloc(void* block, const size_t size) {
+	size_t freeSize;
+
+	if (NULL == block) {
+		if (size > 0) {
+			heapFailedAllocations++;
+			heapLastFailedSize = size;
+		}
+		return;
+	}
+
+	heapAllocations++;
+	/* The kernel objects are all created before the scheduler is started, a later allocation is one to remove */
+	if (taskSCHEDULER_NOT_STARTED != xTaskGetSchedulerState()) {
+		heapRuntimeAllocations++;
+	}
+	freeSize = xPortGetFreeHeapSize();
+	if (freeSize < heapMinimumEverFree) {
+		heapMinimumEverFree = freeSize;
+	}
 }
 
 /**
-  * @brief  This function gets the 32bit timer value for the task status feature.
-  * @param  None
-  * @retval ulHighFrequencyTimerTicks: The 32bit timer value.
+  * @brief  Updates the heap counters after a free, called by heap_2 through traceFREE
+  * @param  block : Freed block
+  * @param  size : Size of the block [bytes]
+  * @retval None
   */
-unsigned getRunTimeCounterValue(void)
-{
-	ulHighFrequencyTimerTicks = __HAL_TIM_GetCounter(&TaskStatusTimHandle) + PERIOD*TaskStatusTimerPeriodCount;
-    return ulHighFrequencyTimerTicks;
+void TaskStatusTraceFree(void* block, const size_t size) {
+	(void) block;
+	(void) size;
+
+	heapFrees++;
+	if (taskSCHEDULER_NOT_STARTED != xTaskGetSchedulerState()) {
+		heapRuntimeFrees++;
+	}
 }
 
 /* Private functions ---------------------------------------------------------*/
 
 /**
-  * @brief  This function is executed in case of error occurrence.
-  * @param  None
+  * @brief  Prints the heap usage
+  * @param  dst : Destination string buffer
+  * @param  dstSize : Size of dst
+  * @retval Length of the string
+  */
+static size_t HeapStatusPrint(char* dst, const size_t dstSize) {
+	HeapStatus_TypeDef heap;
+
+	GetHeapStatus(&heap);
+	return (size_t) snprintf(dst, dstSize, "Heap: %u of %u bytes free, least free %u\n"
+			"Heap allocations: %lu, frees: %lu, failed: %lu, last failed size: %u bytes\n"
+			"Heap allocations after start: %lu, frees after start: %lu\n",
+			(unsigned) heap.free, (unsigned) heap.total, (unsigned) heap.minimumEverFree,
+			(unsigned long) heap.allocations, (unsigned long) heap.frees, (unsigned long) heap.failedAllocations,
+			(unsigned) heap.lastFailedSize, (unsigned long) heap.runtimeAllocations,
+			(unsigned long) heap.runtimeFrees);
+}
+
+/**
+  * @brief  Samples the run time and context switches of all tasks and updates their status over the window
+  * @param  argument : Unused
   * @retval None
   */
-static void Error_Handler(uint8_t errorType)
-{
-	switch(errorType){
+static void TaskStatusSample(void* argument) {
+	TaskSnapshot_TypeDef* newest;
+	const TaskSnapshot_TypeDef* oldest;
+	const TaskSample_TypeDef* oldSample;
+	unsigned portBASE_TYPE nbrOfTasks;
+	unsigned long totalRunTime;
+	unsigned long windowRunTime;
+	uint8_t i;
 
-	case 0:
-		trace_printf("TASK STATUS Error_Handler: INIT ERROR");
-		break;
+	(void) argument;
 
-	case 1:
-		trace_printf("TASK STATUS Error_Handler: START ERROR");
-		break;
+	newestSnapshot = (nbrOfSnapshots > 0) ? (newestSnapshot + 1) % TASK_STATUS_WINDOW_SAMPLES : 0;
+	if (nbrOfSnapshots < TASK_STATUS_WINDOW_SAMPLES) {
+		nbrOfSnapshots++;
 	}
+	newest = &snapshots[newestSnapshot];
+	oldest = &snapshots[(nbrOfSnapshots < TASK_STATUS_WINDOW_SAMPLES) ? 0
+			: (newestSnapshot + 1) % TASK_STATUS_WINDOW_SAMPLES];
 
-	while(1)
-	{
+	/* With the scheduler suspended deleted tasks are not freed, so the handles stay valid for the switch counts */
+	vTaskSuspendAll();
+	nbrOfTasks = uxTaskGetSystemState(systemState, TASK_STATUS_MAX_TASKS, &totalRunTime);
+
+	/* More tasks than TASK_STATUS_MAX_TASKS are not sampled at all, reported as no tasks */
+	newest->totalRunTime = totalRunTime;
+	newest->nbrOfTasks = (uint8_t) nbrOfTasks;
+	for (i = 0; i < nbrOfTasks; i++) {
+		newest->task[i].taskNumber = systemState[i].xTaskNumber;
+		newest->task[i].runTime = systemState[i].ulRunTimeCounter;
+		newest->task[i].contextSwitches = uxTaskGetTaskNumber(systemState[i].xHandle);
 	}
+
+	/* Counter differences are exact modulo 2^32, see TASK_STATUS_WINDOW_SAMPLES */
+	windowRunTime = newest->totalRunTime - oldest->totalRunTime;
+	nbrOfTaskStatus = (uint8_t) nbrOfTasks;
+	taskStatusWindow = (newest != oldest) ? windowRunTime / (SystemCoreClock / 1000) : 0;
+
+	for (i = 0; i < nbrOfTasks; i++) {
+		/* Tasks created within the window started with zero run time and switches */
+		oldSample = FindTaskSample(oldest, newest->task[i].taskNumber);
+
+		strncpy(taskStatus[i].name, (const char*) systemState[i].pcTaskName, configMAX_TASK_NAME_LEN - 1);
+		taskStatus[i].name[configMAX_TASK_NAME_LEN - 1] = '\0';
+		taskStatus[i].priority = systemState[i].uxCurrentPriority;
+		taskStatus[i].stackHighWaterMark = systemState[i].usStackHighWaterMark * sizeof(portSTACK_TYPE);
+		taskStatus[i].contextSwitches = newest->task[i].contextSwitches - (oldSample ? oldSample->contextSwitches : 0);
+		taskStatus[i].load = (windowRunTime > 0) ? (uint16_t) ((uint64_t) (newest->task[i].runTime
+				- (oldSample ? oldSample->runTime : 0)) * 10000 / windowRunTime) : 0;
+	}
+	xTaskResumeAll();
+
+	UpdateCpuHeadroom();
+}
+
+/**
+  * @brief  Finds the sample of a task in a snapshot
+  * @param  snapshot : Snapshot to search
+  * @param  taskNumber : Number of the task
+  * @retval Sample of the task, NULL if the task is not in the snapshot
+  */
+static const TaskSample_TypeDef* FindTaskSample(const TaskSnapshot_TypeDef* snapshot,
+		const unsigned portBASE_TYPE taskNumber) {
+	uint8_t i;
+
+	for (i = 0; i < snapshot->nbrOfTasks; i++) {
+		if (snapshot->task[i].taskNumber == taskNumber) {
+			return &snapshot->task[i];
+		}
+	}
+
+	return NULL;
+}
+
+/**
+  * @brief  Encodes the stack and load of a task as a TaskUsageProto submessage, see task_status.h
+  * @param  stream : Destination stream
+  * @param  status : Status of the task
+  * @retval true if encoded, false if the stream is too small
+  */
+static bool EncodeTaskUsage(pb_ostream_t* stream, const TaskStatus_TypeDef* status) {
+	uint8_t usageBuffer[TASK_USAGE_MSG_MAX_SIZE];
+	pb_ostream_t usageStream = pb_ostream_from_buffer(usageBuffer, sizeof(usageBuffer));
+
+	if (!pb_encode_tag(&usageStream, PB_WT_STRING, 1)
+			|| !pb_encode_string(&usageStream, (const uint8_t*) status->name, strlen(status->name))
+			|| !pb_encode_tag(&usageStream, PB_WT_VARINT, 2) || !pb_encode_varint(&usageStream, status->stackHighWaterMark)
+			|| !pb_encode_tag(&usageStream, PB_WT_VARINT, 3) || !pb_encode_varint(&usageStream, status->load)) {
+		return false;
+	}
+
+	/* Field 6 of TaskStatusProto, length delimited */
+	return pb_encode_tag(stream, PB_WT_STRING, 6) && pb_encode_string(stream, usageBuffer, usageStream.bytes_written);
 }
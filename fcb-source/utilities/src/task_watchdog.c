@@ -0,0 +1,269 @@
+/******************************************************************************
+ * @file    task_watchdog.c
+ * @author  Dragonfly
+ * @brief   Task watchdog, see task_watchdog.h. The check-ins are single word
+ *          stores of the tick count, which the supervisor reads without a
+ *          lock. The task that missed its deadline is kept in the .noinit
+ *          section over the IWDG reset, like the crash dump, and only trusted
+ *          together with its magic and the IWDG reset flag.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "task_watchdog.h"
+
+#include "crash_dump.h"
+#include "event_journal.h"
+#include "deferred_log.h"
+#include "fcb_error.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct {
+	const char* name;
+	uint32_t deadline;              // [ms]
+} TaskWatchdogInfo_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define TASK_WATCHDOG_MISS_MAGIC        0x53494D57  // "WMIS"
+
+#define TASK_WATCHDOG_NOINIT            __attribute__((section(".noinit")))
+
+/* Private variables ---------------------------------------------------------*/
+static const TaskWatchdogInfo_TypeDef taskWatchdogInfo[TASK_WATCHDOG_NBR] = {
+	{ "sensors", TASK_WATCHDOG_SENSORS_DEADLINE },
+	{ "flight control", TASK_WATCHDOG_FLIGHT_CONTROL_DEADLINE },
+	{ "receiver", TASK_WATCHDOG_RECEIVER_DEADLINE }
+};
+
+/* Kept over the IWDG reset, valid if missMagic is set */
+static uint32_t missMagic TASK_WATCHDOG_NOINIT;
+static uint32_t missedTask TASK_WATCHDOG_NOINIT;
+
+/* Written by the checking in tasks, read by the supervisor */
+static volatile portTickType lastCheckIn[TASK_WATCHDOG_NBR];
+static xTaskHandle checkedInTask[TASK_WATCHDOG_NBR];
+static volatile bool isRegistered[TASK_WATCHDOG_NBR];
+
+/* Written by the supervisor */
+static uint32_t maxCheckInAge[TASK_WATCHDOG_NBR]; // [ms] seen by the supervisor
+#ifdef FCB_TASK_WATCHDOG
+static bool isStarved = false;          // A task missed its deadline, the IWDG is not fed anymore
+static bool isIwdgStarted = false;
+#endif
+
+/* Of the last reset, latched at startup */
+static bool isWatchdogReset = false;
+static uint32_t resetMissedTask = TASK_WATCHDOG_NBR; // TASK_WATCHDOG_NBR if the supervisor was starved itself
+
+#ifdef FCB_TASK_WATCHDOG
+static IWDG_HandleTypeDef iwdgHandle;
+static RateGroupJobId_TypeDef taskWatchdogJobId = RATE_GROUP_INVALID_ID;
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+#ifdef FCB_TASK_WATCHDOG
+static void TaskWatchdogSupervise(void* argument);
+static void StartIwdg(void);
+#endif
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Latches a reset by the IWDG and, with FCB_TASK_WATCHDOG, registers the supervisor with its rate group
+ * @param  None
+ * @retval None
+ */
+void InitTaskWatchdog(void) {
+	isWatchdogReset = (RESET != __HAL_RCC_GET_FLAG(RCC_FLAG_IWDGRST));
+	resetMissedTask = (isWatchdogReset && TASK_WATCHDOG_MISS_MAGIC == missMagic && missedTask < TASK_WATCHDOG_NBR)
+			? missedTask : TASK_WATCHDOG_NBR;
+	missMagic = 0;
+
+	if (isWatchdogReset) {
+		EventJournalRecord(EVENT_JOURNAL_WATCHDOG_RESET, (uint8_t) resetMissedTask, 0);
+		if (TASK_WATCHDOG_NBR != resetMissedTask) {
+			LOG1("WARNING: reset by the watchdog, the %s task missed its deadline, see crash-dump",
+					taskWatchdogInfo[resetMissedTask].name);
+		} else {
+			LOG0("WARNING: reset by the watchdog, the supervisor did not run");
+		}
+	}
+
+#ifdef FCB_TASK_WATCHDOG
+	if (FCB_OK != RateGroupRegister("TASK_WDOG", TaskWatchdogSupervise, NULL, RATE_GROUP_20HZ, TASK_WATCHDOG_PHASE,
+			&taskWatchdogJobId)) {
+		ErrorHandler();
+	}
+#endif
+}
+
+/*
+ * @brief  Starts watching the calling task from now on
+ * @param  id : Task
+ * @retval None
+ */
+void TaskWatchdogRegister(const TaskWatchdogId_TypeDef id) {
+	if (id >= TASK_WATCHDOG_NBR) {
+		return;
+	}
+
+	taskENTER_CRITICAL();
+	lastCheckIn[id] = xTaskGetTickCount();
+	checkedInTask[id] = xTaskGetCurrentTaskHandle();
+	isRegistered[id] = true;
+	taskEXIT_CRITICAL();
+}
+
+/*
+ * @brief  Checks in the calling task
+ * @param  id : Task
+ * @retval None
+ */
+void TaskWatchdogCheckIn(const TaskWatchdogId_TypeDef id) {
+	if (id < TASK_WATCHDOG_NBR) {
+		lastCheckIn[id] = xTaskGetTickCount();
+	}
+}
+
+/*
+ * @brief  Checks if the last reset was by the IWDG
+ * @param  None
+ * @retval true until cleared, else false
+ */
+bool IsWatchdogResetPending(void) {
+	return isWatchdogReset;
+}
+
+/*
+ * @brief  Clears the latched IWDG reset, so that the UAV can be armed again
+ * @param  None
+ * @retval None
+ */
+void ClearWatchdogReset(void) {
+	isWatchdogReset = false;
+}
+
+size_t PrintTaskWatchdog(char* dst, const size_t dstSize) {
+	portTickType now = xTaskGetTickCount();
+	size_t length;
+	uint8_t i;
+
+#ifdef FCB_TASK_WATCHDOG
+	length = (size_t) snprintf(dst, dstSize, "Task watchdog: %s, IWDG timeout %u ms\r\n",
+			isStarved ? "deadline missed, reset pending" : (isIwdgStarted ? "running" : "starting"),
+			TASK_WATCHDOG_TIMEOUT);
+#else
+	length = (size_t) snprintf(dst, dstSize, "Task watchdog: not compiled in, FCB_TASK_WATCHDOG\r\n");
+#endif
+
+	if (length < dstSize) {
+		if (!isWatchdogReset) {
+			length += (size_t) snprintf(dst + length, dstSize - length, "Last reset: not by the watchdog\r\n");
+		} else if (TASK_WATCHDOG_NBR != resetMissedTask) {
+			length += (size_t) snprintf(dst + length, dstSize - length,
+					"Last reset: by the watchdog, the %s task missed its deadline, arming blocked\r\n",
+					taskWatchdogInfo[resetMissedTask].name);
+		} else {
+			length += (size_t) snprintf(dst + length, dstSize - length,
+					"Last reset: by the watchdog, the supervisor did not run, arming blocked\r\n");
+		}
+	}
+
+	for (i = 0; i < TASK_WATCHDOG_NBR && length < dstSize; i++) {
+		if (!isRegistered[i]) {
+			length += (size_t) snprintf(dst + length, dstSize - length, "%-15s not registered\r\n",
+					taskWatchdogInfo[i].name);
+		} else {
+			length += (size_t) snprintf(dst + length, dstSize - length,
+					"%-15s checked in %u ms ago, max %u ms, deadline %u ms\r\n", taskWatchdogInfo[i].name,
+					(unsigned int) ((now - lastCheckIn[i]) * portTICK_RATE_MS), (unsigned int) maxCheckInAge[i],
+					(unsigned int) taskWatchdogInfo[i].deadline);
+		}
+	}
+
+	return (length < dstSize) ? length : dstSize - 1;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+#ifdef FCB_TASK_WATCHDOG
+/*
+ * @brief  Feeds the IWDG if every registered task has checked in within its deadline. On the first miss, stores the
+ *         crash dump of the task and stops feeding, the IWDG then resets the board.
+ * @param  argument : Unused
+ * @retval None
+ */
+static void TaskWatchdogSupervise(void* argument) {
+	const portTickType now = xTaskGetTickCount();
+	uint32_t age;
+	uint8_t i;
+
+	(void) argument;
+
+	if (!isIwdgStarted) {
+		StartIwdg();
+	}
+
+	if (isStarved) {
+		return;
+	}
+
+	for (i = 0; i < TASK_WATCHDOG_NBR; i++) {
+		if (!isRegistered[i]) {
+			continue;
+		}
+
+		age = (uint32_t) ((now - lastCheckIn[i]) * portTICK_RATE_MS);
+		if (age > maxCheckInAge[i]) {
+			maxCheckInAge[i] = age;
+		}
+
+		if (age > taskWatchdogInfo[i].deadline) {
+			isStarved = true;
+			missedTask = i;
+			missMagic = TASK_WATCHDOG_MISS_MAGIC;
+
+			/* Logged first, so that the entry is in the dump */
+			LOG2("ERROR: the %s task missed its deadline by %lu ms, watchdog reset", taskWatchdogInfo[i].name,
+					age - taskWatchdogInfo[i].deadline);
+			CrashDumpFromWatchdog(checkedInTask[i]);
+			return;
+		}
+	}
+
+	HAL_IWDG_Refresh(&iwdgHandle);
+}
+
+/*
+ * @brief  Starts the IWDG, which is stopped while the core is halted by a debugger
+ * @param  None
+ * @retval None
+ */
+static void StartIwdg(void) {
+	__HAL_FREEZE_IWDG_DBGMCU();
+
+	iwdgHandle.Instance = IWDG;
+	iwdgHandle.Init.Prescaler = IWDG_PRESCALER_64;
+	iwdgHandle.Init.Reload = TASK_WATCHDOG_RELOAD;
+	iwdgHandle.Init.Window = IWDG_WINDOW_DISABLE;
+
+	if (HAL_OK != HAL_IWDG_Init(&iwdgHandle) || HAL_OK != HAL_IWDG_Start(&iwdgHandle)) {
+		ErrorHandler();
+	}
+
+	isIwdgStarted = true;
+}
+#endif
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
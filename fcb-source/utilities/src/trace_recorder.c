@@ -0,0 +1,374 @@
+/******************************************************************************
+ * @file    trace_recorder.c
+ * @author  Dragonfly
+ * @brief   Integration of the FreeRTOS+Trace recorder. The recorder stores the
+ *          events in its RAM ring from the kernel hooks and the traced ISRs,
+ *          the trace task sends the ring or the new events over the USB log
+ *          endpoint as TRACE_DATA_MSG_ENUM frames. Requests from the CLI are
+ *          carried out by the trace task, so that only it starts, stops and
+ *          reads the recorder.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "trace_recorder.h"
+
+#ifdef FCB_TRACE_RECORDER
+
+#include "fcb_error.h"
+#include "communication.h"
+#include "proto_frame.h"
+#include "state_estimation.h"
+#include "uart.h"
+#include "usbd_log_if.h"
+#include "pb_encode.h"
+
+#include "task.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+typedef enum {
+	TRACE_REQUEST_NONE = 0,
+	TRACE_REQUEST_START_SNAPSHOT,
+	TRACE_REQUEST_START_STREAM,
+	TRACE_REQUEST_STOP,
+	TRACE_REQUEST_SNAPSHOT
+} TraceRequest_TypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define TRACE_TASK_PRIO             1
+#define TRACE_TASK_PERIOD           10      // [ms]
+
+#define TRACE_EVENT_SIZE            4       // [bytes]
+
+/* Events this close to being overwritten are counted as lost, the recorder clears the oldest entries of multi-entry
+ * events ahead of its write position */
+#define TRACE_STREAM_MARGIN         16      // [events]
+
+#define TRACE_SEND_RETRIES          100     // Rounds of 1 ms waiting for room in the USB log buffer
+
+#if TRACE_ISR_NBR - 1 > NISR
+#error "NISR in trcConfig.h is smaller than the number of traced ISRs"
+#endif
+
+#if TRACE_DATA_CHUNK_SIZE % TRACE_EVENT_SIZE != 0
+#error "TRACE_DATA_CHUNK_SIZE must be a multiple of the event size"
+#endif
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static xTaskHandle TraceTaskHandle = NULL;
+
+static volatile TraceRequest_TypeDef traceRequest = TRACE_REQUEST_NONE;
+static volatile TraceMode_TypeDef traceMode = TRACE_MODE_SNAPSHOT;
+
+/* Stream mode, written by the trace task only */
+static volatile uint32_t streamedEvents = 0;
+static volatile uint32_t lostEvents = 0;
+
+static uint8_t traceChunk[TRACE_DATA_CHUNK_SIZE];
+static uint8_t traceFrame[PROTO_FRAME_MAX_SIZE(TRACE_DATA_MSG_MAX_SIZE)];
+
+/* Private function prototypes -----------------------------------------------*/
+static void TraceTask(void const *argument);
+static FcbRetValType PostTraceRequest(const TraceRequest_TypeDef request);
+static void HandleTraceRequest(const TraceRequest_TypeDef request);
+static void StreamTraceEvents(void);
+static bool SendRecorderData(const bool withEvents);
+static bool SendTraceData(const TraceDataKind_TypeDef kind, const uint32_t offset, const uint32_t size,
+		const uint8_t* data, const uint16_t length);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Initializes the recorder and starts it in snapshot mode. Call before any kernel object is created, the
+ *         recorder only traces the objects created after it.
+ * @param  None
+ * @retval None
+ */
+void InitTraceRecorder(void) {
+	vTraceInitTraceData();
+
+	/* An error of the recorder is kept and reported by the trace status, it does not stop the FCB */
+	(void) uiTraceStart();
+}
+
+/*
+ * @brief  Names the traced ISRs with their priorities and creates the trace task. Call after the interrupts have
+ *         been configured.
+ * @param  None
+ * @retval None
+ */
+void CreateTraceTask(void) {
+	vTraceSetISRProperties(TRACE_ISR_GYRO_DRDY, "GYRO_DRDY", (char) NVIC_GetPriority(EXTI1_IRQn));
+	vTraceSetISRProperties(TRACE_ISR_MAG_DRDY, "MAG_DRDY", (char) NVIC_GetPriority(EXTI2_TSC_IRQn));
+	vTraceSetISRProperties(TRACE_ISR_ACC_DRDY, "ACC_DRDY", (char) NVIC_GetPriority(EXTI4_IRQn));
+	vTraceSetISRProperties(TRACE_ISR_STATE_ESTIMATION, "STATE_EST_TIM",
+			(char) NVIC_GetPriority(STATE_ESTIMATION_UPDATE_TIM_IRQn));
+	vTraceSetISRProperties(TRACE_ISR_UART, "UART", (char) NVIC_GetPriority(UART_IRQn));
+
+	/* Trace task creation
+	 * Task function pointer: TraceTask
+	 * Task name: TRACE
+	 * Stack depth: 2*configMINIMAL_STACK_SIZE
+	 * Parameter: NULL
+	 * Priority: TRACE_TASK_PRIO (0 to configMAX_PRIORITIES-1 possible)
+	 * Handle: TraceTaskHandle
+	 * */
+	if (pdPASS != xTaskCreate((pdTASK_CODE )TraceTask, (signed portCHAR*)"TRACE",
+			2*configMINIMAL_STACK_SIZE, NULL, TRACE_TASK_PRIO, &TraceTaskHandle)) {
+		ErrorHandler();
+	}
+}
+
+/*
+ * @brief  Clears the recorded events and starts the recorder, within TRACE_TASK_PERIOD
+ * @param  mode : Snapshot or stream mode
+ * @retval FCB_OK if requested, FCB_ERR if a previous request is still pending
+ */
+FcbRetValType StartTraceRecorder(const TraceMode_TypeDef mode) {
+	return PostTraceRequest((TRACE_MODE_STREAM == mode) ? TRACE_REQUEST_START_STREAM : TRACE_REQUEST_START_SNAPSHOT);
+}
+
+/*
+ * @brief  Stops the recorder within TRACE_TASK_PERIOD. In stream mode the remaining events and the recorder data
+ *         are sent. The events stay in the ring for a snapshot.
+ * @param  None
+ * @retval None
+ */
+void StopTraceRecorder(void) {
+	(void) PostTraceRequest(TRACE_REQUEST_STOP);
+}
+
+/*
+ * @brief  Stops the recorder and sends the whole recorder data over the USB log endpoint, within TRACE_TASK_PERIOD
+ * @param  None
+ * @retval FCB_OK if requested, FCB_ERR in stream mode or if a previous request is still pending
+ */
+FcbRetValType SendTraceSnapshot(void) {
+	if (TRACE_MODE_STREAM == traceMode) {
+		return FCB_ERR;
+	}
+
+	return PostTraceRequest(TRACE_REQUEST_SNAPSHOT);
+}
+
+/*
+ * @brief  Gets the state and the event counters of the recorder
+ * @param  status : Destination status
+ * @retval None
+ */
+void GetTraceStatus(TraceStatus_TypeDef* status) {
+	status->isActive = (0 != RecorderDataPtr->recorderActive);
+	status->mode = traceMode;
+	status->recordedEvents = RecorderDataPtr->numEvents;
+	status->streamedEvents = streamedEvents;
+	status->lostEvents = lostEvents;
+	status->error = xTraceGetLastError();
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief  Task code carries out the requests and sends the new events in stream mode
+ * @param  argument : Unused parameter
+ * @retval None
+ */
+static void TraceTask(void const *argument) {
+	TraceRequest_TypeDef request;
+
+	(void) argument;
+
+	for (;;) {
+		vTaskDelay(TRACE_TASK_PERIOD / portTICK_RATE_MS);
+
+		request = traceRequest;
+		if (TRACE_REQUEST_NONE != request) {
+			HandleTraceRequest(request);
+			traceRequest = TRACE_REQUEST_NONE;
+		}
+
+		if (TRACE_MODE_STREAM == traceMode && RecorderDataPtr->recorderActive) {
+			StreamTraceEvents();
+		}
+	}
+}
+
+/*
+ * @brief  Posts a request to the trace task
+ * @param  request : Request
+ * @retval FCB_OK if posted, FCB_ERR if a previous request is still pending
+ */
+static FcbRetValType PostTraceRequest(const TraceRequest_TypeDef request) {
+	FcbRetValType retVal = FCB_ERR;
+
+	taskENTER_CRITICAL();
+	if (TRACE_REQUEST_NONE == traceRequest) {
+		traceRequest = request;
+		retVal = FCB_OK;
+	}
+	taskEXIT_CRITICAL();
+
+	return retVal;
+}
+
+/*
+ * @brief  Carries out a request in the trace task
+ * @param  request : Request
+ * @retval None
+ */
+static void HandleTraceRequest(const TraceRequest_TypeDef request) {
+	switch (request) {
+	case TRACE_REQUEST_START_SNAPSHOT:
+	case TRACE_REQUEST_START_STREAM:
+		vTraceStop();
+		vTraceClear();
+		traceMode = (TRACE_REQUEST_START_STREAM == request) ? TRACE_MODE_STREAM : TRACE_MODE_SNAPSHOT;
+		streamedEvents = 0;
+		lostEvents = 0;
+
+		/* The host needs the object table and the time base before the first events */
+		if (uiTraceStart() && TRACE_MODE_STREAM == traceMode) {
+			SendRecorderData(false);
+		}
+		break;
+	case TRACE_REQUEST_STOP:
+		vTraceStop();
+		if (TRACE_MODE_STREAM == traceMode) {
+			StreamTraceEvents();
+			SendRecorderData(false);
+		}
+		break;
+	case TRACE_REQUEST_SNAPSHOT:
+		/* The ring must not change while it is sent */
+		vTraceStop();
+		SendRecorderData(true);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * @brief  Sends the events recorded since the last call, oldest first. The events are sent in order and numbered
+ *         since the stream started, so the host notices lost ones.
+ * @param  None
+ * @retval None
+ */
+static void StreamTraceEvents(void) {
+	uint32_t pendingEvents;
+	uint32_t firstIndex;
+	uint32_t nbrOfEvents;
+
+	for (;;) {
+		/* The recorder stores events from tasks and ISRs at kernel interrupt priority in critical sections */
+		taskENTER_CRITICAL();
+		pendingEvents = RecorderDataPtr->numEvents - streamedEvents;
+		if (pendingEvents > EVENT_BUFFER_SIZE - TRACE_STREAM_MARGIN) {
+			lostEvents += pendingEvents - (EVENT_BUFFER_SIZE - TRACE_STREAM_MARGIN);
+			streamedEvents += pendingEvents - (EVENT_BUFFER_SIZE - TRACE_STREAM_MARGIN);
+			pendingEvents = EVENT_BUFFER_SIZE - TRACE_STREAM_MARGIN;
+		}
+
+		/* The oldest pending events, up to the end of the ring */
+		firstIndex = (RecorderDataPtr->nextFreeIndex + EVENT_BUFFER_SIZE - pendingEvents) % EVENT_BUFFER_SIZE;
+		nbrOfEvents = pendingEvents;
+		if (nbrOfEvents > TRACE_DATA_CHUNK_SIZE / TRACE_EVENT_SIZE) {
+			nbrOfEvents = TRACE_DATA_CHUNK_SIZE / TRACE_EVENT_SIZE;
+		}
+		if (firstIndex + nbrOfEvents > EVENT_BUFFER_SIZE) {
+			nbrOfEvents = EVENT_BUFFER_SIZE - firstIndex;
+		}
+		memcpy(traceChunk, &RecorderDataPtr->eventData[firstIndex * TRACE_EVENT_SIZE], nbrOfEvents * TRACE_EVENT_SIZE);
+		taskEXIT_CRITICAL();
+
+		if (0 == nbrOfEvents) {
+			return;
+		}
+
+		if (!SendTraceData(TRACE_DATA_EVENTS, streamedEvents, TRACE_EVENT_SIZE, traceChunk,
+				(uint16_t) (nbrOfEvents * TRACE_EVENT_SIZE))) {
+			return; /* USB log buffer full, the events are sent on the next round */
+		}
+		streamedEvents += nbrOfEvents;
+	}
+}
+
+/*
+ * @brief  Sends the recorder data in chunks, waiting for room in the USB log buffer
+ * @param  withEvents : true to send the event ring too, false to skip it
+ * @retval true if sent, false if the USB log endpoint did not take it
+ */
+static bool SendRecorderData(const bool withEvents) {
+	const uint8_t* recorderData = (const uint8_t*) RecorderDataPtr;
+	const uint32_t eventsOffset = offsetof(RecorderDataType, eventData);
+	uint32_t offset = 0;
+	uint16_t length;
+	uint8_t retries = 0;
+
+	while (offset < sizeof(RecorderDataType)) {
+		if (!withEvents && eventsOffset == offset) {
+			offset += sizeof(RecorderDataPtr->eventData);
+			continue;
+		}
+
+		length = (sizeof(RecorderDataType) - offset < TRACE_DATA_CHUNK_SIZE) ?
+				(uint16_t) (sizeof(RecorderDataType) - offset) : TRACE_DATA_CHUNK_SIZE;
+		if (!withEvents && offset < eventsOffset && offset + length > eventsOffset) {
+			length = (uint16_t) (eventsOffset - offset);
+		}
+
+		if (SendTraceData(TRACE_DATA_RECORDER, offset, sizeof(RecorderDataType), &recorderData[offset], length)) {
+			offset += length;
+			retries = 0;
+		} else if (++retries < TRACE_SEND_RETRIES) {
+			vTaskDelay(1 / portTICK_RATE_MS);
+		} else {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * @brief  Encodes trace data as a TRACE_DATA_MSG_ENUM frame and sends it over the USB log endpoint
+ * @param  kind : Recorder data or streamed events
+ * @param  offset : Byte offset in the recorder data, or number of the first event
+ * @param  size : Size of the recorder data, or of an event
+ * @param  data : Data, at most TRACE_DATA_CHUNK_SIZE bytes
+ * @param  length : Length of data
+ * @retval true if sent, false if the USB log endpoint did not take it
+ */
+static bool SendTraceData(const TraceDataKind_TypeDef kind, const uint32_t offset, const uint32_t size,
+		const uint8_t* data, const uint16_t length) {
+	ProtoFrameStream_TypeDef frame;
+	size_t frameLength;
+
+	ProtoFrameBegin(&frame, traceFrame, sizeof(traceFrame), TRACE_DATA_MSG_ENUM);
+	if (!pb_encode_tag(&frame.stream, PB_WT_VARINT, 1) || !pb_encode_varint(&frame.stream, kind)
+			|| !pb_encode_tag(&frame.stream, PB_WT_VARINT, 2) || !pb_encode_varint(&frame.stream, offset)
+			|| !pb_encode_tag(&frame.stream, PB_WT_VARINT, 3) || !pb_encode_varint(&frame.stream, size)
+			|| !pb_encode_tag(&frame.stream, PB_WT_STRING, 4) || !pb_encode_string(&frame.stream, data, length)) {
+		return false;
+	}
+
+	frameLength = ProtoFrameEnd(&frame);
+	if (0 == frameLength) {
+		return false;
+	}
+
+	return USBD_OK == USBLogSendData(traceFrame, (uint16_t) frameLength);
+}
+
+#endif /* FCB_TRACE_RECORDER */
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/
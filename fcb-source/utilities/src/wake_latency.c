@@ -0,0 +1,248 @@
+/******************************************************************************
+ * @file    wake_latency.c
+ * @author  Dragonfly
+ * @brief   Wake latency monitor. A handoff is stamped with the DWT cycle
+ *          counter when it is signalled and completed when the woken task
+ *          runs. Signals that arrive while one is pending coalesce into the
+ *          first, like the wake-ups themselves, so the latency is that of the
+ *          oldest sample waiting. Both calls are made with the interrupts
+ *          masked, inside the critical sections that already guard the
+ *          pending event bits of the handoffs.
+ ******************************************************************************/
+
+/* Includes -----------------------------------------------------------------*/
+#include "wake_latency.h"
+
+#include "common.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+#define CYCLES_PER_US      (SystemCoreClock / 1000000)
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+#ifdef FCB_WAKE_LATENCY
+static WakeLatencyStats_TypeDef wakeLatencyStats[WAKE_LATENCY_NBR];
+
+/* Signal time of the pending wake-up of each handoff [core clock cycles] */
+static uint32_t signalTimestamps[WAKE_LATENCY_NBR];
+static uint8_t signalPending[WAKE_LATENCY_NBR];
+#endif
+
+/* Indexed by WakeLatencyHandoff_TypeDef, to be updated with the wake mechanism of the handoff so that the printed
+ * statistics of builds with different mechanisms can be told apart */
+static const char* handoffNames[WAKE_LATENCY_NBR] = { "ISR->SENSORS", "SENSORS->FC" };
+static const char* mechanismNames[WAKE_LATENCY_NBR] = { "semaphore", "semaphore" };
+
+/* Private function prototypes -----------------------------------------------*/
+static uint32_t GetPercentile(const WakeLatencyStats_TypeDef* stats, const uint32_t perMille);
+
+/* Exported functions --------------------------------------------------------*/
+
+/*
+ * @brief  Stamps the signalling of a handoff, unless a signal is already pending. To be called with the interrupts
+ *         masked, from an ISR or a task.
+ * @param  handoff : Handoff
+ * @param  timestamp : Time of the signal [core clock cycles]
+ * @retval None
+ */
+void WakeLatencySignal(const WakeLatencyHandoff_TypeDef handoff, const uint32_t timestamp) {
+#ifdef FCB_WAKE_LATENCY
+	if (handoff >= WAKE_LATENCY_NBR || signalPending[handoff]) {
+		return;
+	}
+
+	signalTimestamps[handoff] = timestamp;
+	signalPending[handoff] = 1;
+#else
+	(void) handoff;
+	(void) timestamp;
+#endif
+}
+
+/*
+ * @brief  Completes the pending signal of a handoff with the current time. To be called by the woken task with the
+ *         interrupts masked, right after its take or receive returned. Does nothing without a pending signal.
+ * @param  handoff : Handoff
+ * @retval None
+ */
+void WakeLatencyWoken(const WakeLatencyHandoff_TypeDef handoff) {
+#ifdef FCB_WAKE_LATENCY
+	WakeLatencyStats_TypeDef* stats;
+	uint32_t cycles;
+	uint32_t bin;
+
+	if (handoff >= WAKE_LATENCY_NBR || !signalPending[handoff]) {
+		return;
+	}
+
+	cycles = GetTimestamp() - signalTimestamps[handoff];
+	signalPending[handoff] = 0;
+
+	bin = cycles / CYCLES_PER_US;
+	if (bin >= WAKE_LATENCY_HISTOGRAM_BINS) {
+		bin = WAKE_LATENCY_HISTOGRAM_BINS - 1;
+	}
+
+	stats = &wakeLatencyStats[handoff];
+	if (0 == stats->count || cycles < stats->min) {
+		stats->min = cycles;
+	}
+	if (cycles > stats->max) {
+		stats->max = cycles;
+	}
+	stats->sum += cycles;
+	stats->count++;
+	stats->histogram[bin]++;
+#else
+	(void) handoff;
+#endif
+}
+
+/*
+ * @brief  Gets a consistent copy of the statistics of a handoff, all zero without FCB_WAKE_LATENCY
+ * @param  handoff : Handoff
+ * @param  dstStats : Destination statistics
+ * @retval None
+ */
+void WakeLatencyGetStats(const WakeLatencyHandoff_TypeDef handoff, WakeLatencyStats_TypeDef* dstStats) {
+#ifdef FCB_WAKE_LATENCY
+	if (handoff >= WAKE_LATENCY_NBR) {
+		memset(dstStats, 0, sizeof(WakeLatencyStats_TypeDef));
+		return;
+	}
+
+	taskENTER_CRITICAL();
+	*dstStats = wakeLatencyStats[handoff];
+	taskEXIT_CRITICAL();
+#else
+	(void) handoff;
+	memset(dstStats, 0, sizeof(WakeLatencyStats_TypeDef));
+#endif
+}
+
+/*
+ * @brief  Clears the statistics of all handoffs
+ * @param  None
+ * @retval None
+ */
+void WakeLatencyReset(void) {
+#ifdef FCB_WAKE_LATENCY
+	taskENTER_CRITICAL();
+	memset(wakeLatencyStats, 0, sizeof(wakeLatencyStats));
+	memset(signalPending, 0, sizeof(signalPending));
+	taskEXIT_CRITICAL();
+#endif
+}
+
+/*
+ * @brief  Prints the statistics of all handoffs as a table with percentiles, followed by the non-empty histogram bins
+ * @param  dst : Destination string buffer
+ * @param  dstSize : Size of dst
+ * @retval Length of the table string
+ */
+size_t WakeLatencyPrint(char* dst, const size_t dstSize) {
+	WakeLatencyStats_TypeDef stats[WAKE_LATENCY_NBR];
+	uint32_t cyclesPerUs = CYCLES_PER_US;
+	size_t length;
+	uint8_t i;
+	uint8_t bin;
+
+#ifndef FCB_WAKE_LATENCY
+	return (size_t) snprintf(dst, dstSize, "\nWake latency not compiled in, see FCB_WAKE_LATENCY in wake_latency.h\n");
+#endif
+
+	for (i = 0; i < WAKE_LATENCY_NBR; i++) {
+		WakeLatencyGetStats((WakeLatencyHandoff_TypeDef) i, &stats[i]);
+	}
+
+	length = (size_t) snprintf(dst, dstSize, "\nWake latency [us]\n%-14s%-11s%9s%6s%6s%6s%6s%6s%6s\n", "Handoff",
+			"Mechanism", "Count", "Min", "Avg", "P50", "P90", "P99", "Max");
+
+	for (i = 0; i < WAKE_LATENCY_NBR && length < dstSize; i++) {
+		if (0 == stats[i].count) {
+			length += (size_t) snprintf(dst + length, dstSize - length, "%-14s%-11s%9u\n", handoffNames[i],
+					mechanismNames[i], 0);
+			continue;
+		}
+
+		length += (size_t) snprintf(dst + length, dstSize - length, "%-14s%-11s%9lu%6lu%6lu%6lu%6lu%6lu%6lu\n",
+				handoffNames[i], mechanismNames[i], (unsigned long) stats[i].count,
+				(unsigned long) (stats[i].min / cyclesPerUs),
+				(unsigned long) (stats[i].sum / stats[i].count / cyclesPerUs),
+				(unsigned long) GetPercentile(&stats[i], 500), (unsigned long) GetPercentile(&stats[i], 900),
+				(unsigned long) GetPercentile(&stats[i], 990), (unsigned long) (stats[i].max / cyclesPerUs));
+	}
+
+	if (length < dstSize) {
+		length += (size_t) snprintf(dst + length, dstSize - length, "%-8s", "<[us]");
+	}
+	for (i = 0; i < WAKE_LATENCY_NBR && length < dstSize; i++) {
+		length += (size_t) snprintf(dst + length, dstSize - length, "%14s", handoffNames[i]);
+	}
+	if (length < dstSize) {
+		length += (size_t) snprintf(dst + length, dstSize - length, "\n");
+	}
+
+	for (bin = 0; bin < WAKE_LATENCY_HISTOGRAM_BINS && length < dstSize; bin++) {
+		for (i = 0; i < WAKE_LATENCY_NBR && 0 == stats[i].histogram[bin]; i++);
+		if (WAKE_LATENCY_NBR == i) {
+			continue;
+		}
+
+		if (WAKE_LATENCY_HISTOGRAM_BINS - 1 == bin) {
+			length += (size_t) snprintf(dst + length, dstSize - length, "%-8s", "more");
+		} else {
+			length += (size_t) snprintf(dst + length, dstSize - length, "%-8u", bin + 1);
+		}
+		for (i = 0; i < WAKE_LATENCY_NBR && length < dstSize; i++) {
+			length += (size_t) snprintf(dst + length, dstSize - length, "%14lu",
+					(unsigned long) stats[i].histogram[bin]);
+		}
+		if (length < dstSize) {
+			length += (size_t) snprintf(dst + length, dstSize - length, "\n");
+		}
+	}
+
+	return length;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * @brief  Gets a percentile from the histogram of a handoff, as the upper edge of the bin that holds it, at most the
+ *         maximum
+ * @param  stats : Statistics of the handoff, with at least one wake-up
+ * @param  perMille : Percentile [0.1 %]
+ * @retval Percentile [us]
+ */
+static uint32_t GetPercentile(const WakeLatencyStats_TypeDef* stats, const uint32_t perMille) {
+	uint32_t maxUs = stats->max / CYCLES_PER_US;
+	uint64_t rank = ((uint64_t) stats->count * perMille + 999) / 1000;
+	uint64_t cumulative = 0;
+	uint8_t bin;
+
+	for (bin = 0; bin < WAKE_LATENCY_HISTOGRAM_BINS - 1; bin++) {
+		cumulative += stats->histogram[bin];
+		if (cumulative >= rank) {
+			return (bin + 1U < maxUs) ? bin + 1U : maxUs;
+		}
+	}
+
+	return maxUs;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
+/*****END OF FILE****/